@@ -0,0 +1,79 @@
+/* AdcStream.h
+ *
+ * Streaming acquisition of one analog input, published over Cyphal/UDP.
+ *
+ * TIM6 triggers the conversions of ADC1 at ADC_STREAM_SAMPLE_HZ; DMA1
+ * stream 6 moves the samples in double buffer mode into blocks of
+ * ADC_STREAM_BLOCK_SAMPLES taken from a small pool. When a block is full,
+ * the DMA interrupt gives the DMA the next free block and hands the full
+ * one to the stream task through a lock-free single-producer
+ * single-consumer ring; the task publishes it and hands it back through a
+ * second ring. Nothing is locked or copied before libudpard serializes the
+ * block into its frames: the message header sits in front of the samples,
+ * in the block itself.
+ *
+ * A block completing while no free block is left is sampled over again
+ * and counted as an overrun; the sequence number published with each block
+ * shows the gap. The latency of a block runs from its last sample to the
+ * queuing of its transfer.
+ */
+#ifndef INC_ADCSTREAM_H_
+#define INC_ADCSTREAM_H_
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* ADC1 input 15, PA3 (A0 on the Zio connector) */
+#define ADC_STREAM_CHANNEL             15u
+
+#define ADC_STREAM_SAMPLE_HZ           20000u
+
+/* Samples per block, of 16 bits: a block is one transfer of two frames at
+ * the default MTU, published every 51 ms. The pool holds a power of two
+ * blocks, two of them being filled by the DMA at any time */
+#define ADC_STREAM_BLOCK_SAMPLES       1024u
+#define ADC_STREAM_BLOCK_COUNT         8u
+
+/* Subject of the blocks: uint32 sequence, uint64 timestamp of the first
+ * sample (synchronized time in microseconds, 0 if unknown), uint16 sample
+ * rate in hertz, uint16 sample count, then the samples */
+#define ADC_STREAM_SUBJECT_ID          1200u
+#define ADC_STREAM_PRIORITY            UdpardPriorityFast
+
+/* Same priority as the UART DMA streams: the handler only notifies the
+ * stream task */
+#define ADC_STREAM_IRQ_PRIORITY        5
+
+/* Stack of the stream task, in words */
+#define ADC_STREAM_STACK_SIZE          256
+
+typedef struct
+{
+    uint32_t ulBlocks;                  /* Blocks filled by the DMA */
+    uint32_t ulOverruns;                /* Blocks sampled over, no free block */
+    uint32_t ulPublished;               /* Blocks queued for transmission */
+    uint32_t ulPublishFailures;         /* Blocks the node could not queue */
+    uint32_t ulAdcOverruns;             /* Conversions lost before the DMA read them */
+    uint32_t ulDmaErrors;               /* DMA transfer errors; the stream stops */
+    uint32_t ulLatencyLastUs;           /* Last sample to queued transfer */
+    uint32_t ulLatencyMaxUs;
+    uint64_t ullLatencySumUs;           /* Over ulPublished blocks */
+} AdcStreamStats_t;
+
+/**
+ * @brief  Set up the ADC, its timer and DMA stream, create the stream task
+ *         and start sampling. To be called after xCyphalServicesStart().
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xAdcStreamStart(UBaseType_t uxPriority);
+
+void vAdcStreamGetStats(AdcStreamStats_t *pxStats);
+
+/* Derive the sampling timer again after a change of the APB1 clock;
+ * interrupts disabled */
+void vAdcStreamClockChanged(void);
+
+/* Register the "adcstream" CLI command */
+void vAdcStreamRegisterCLICommands(void);
+
+#endif /* INC_ADCSTREAM_H_ */
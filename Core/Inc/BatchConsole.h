@@ -0,0 +1,54 @@
+/* BatchConsole.h
+ *
+ * Machine-oriented console on its own TCP port, for test rigs and
+ * provisioning scripts: no prompt, no echo and no line editing.
+ *
+ * Both directions carry frames made of a 2-byte big-endian length and that
+ * many bytes. A request is a command line, without line end. Its response is
+ * a JSON object:
+ *
+ *   {"id":3,"output":"...","status":0}
+ *
+ * where id is the rank of the request on the connection, from 1, output the
+ * text of the command (JSON escaped) and status a BATCH_STATUS_xxx code;
+ * "truncated":true is added when the output did not fit in a frame.
+ * Requests may be sent without waiting for the responses: they are executed
+ * one after the other, and answered in order.
+ *
+ * One client is served at a time; the next one is accepted once it leaves.
+ */
+#ifndef INC_BATCHCONSOLE_H_
+#define INC_BATCHCONSOLE_H_
+
+#include "FreeRTOS.h"
+
+/* TCP port of the batch console */
+#define BATCH_CONSOLE_PORT             2323u
+
+/* Largest response frame, header included; longer outputs are cut */
+#define BATCH_CONSOLE_RESPONSE_SIZE    4096u
+
+/* Input buffer; holds at least one request of the longest command line */
+#define BATCH_CONSOLE_RX_SIZE          512u
+
+/* A client neither sending nor reading for this long is dropped */
+#define BATCH_CONSOLE_TIMEOUT_MS       30000u
+
+/* Stack of the task, in words; commands are executed on it */
+#define BATCH_CONSOLE_TASK_STACK_SIZE  512
+
+/* Status of a response */
+#define BATCH_STATUS_OK                0   /* Command executed */
+#define BATCH_STATUS_UNKNOWN_COMMAND   1
+#define BATCH_STATUS_BAD_PARAMETERS    2   /* Wrong number of parameters */
+#define BATCH_STATUS_BUSY              3   /* CLI unavailable, try again */
+#define BATCH_STATUS_TOO_LONG          4   /* Command line of configCOMMAND_INT_MAX_INPUT_SIZE or more */
+
+/**
+ * @brief  Create the batch console task; after vCommandConsoleDualInit().
+ * @param  uxPriority  Task priority.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xBatchConsoleStart(UBaseType_t uxPriority);
+
+#endif /* INC_BATCHCONSOLE_H_ */
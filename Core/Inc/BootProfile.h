@@ -0,0 +1,44 @@
+/* BootProfile.h
+ *
+ * Timeline of the start-up: the phases of main() and initTask(), then the
+ * network milestones (link up, first DHCP request, lease bound), stamped
+ * with the microsecond clock, so that a change of the bring-up order can be
+ * measured from cold boot to first packet. The clock starts in
+ * vMonoClockInit(), right after the system clock configuration; what comes
+ * before (MPU, caches, HAL) is not on the timeline.
+ *
+ * Only the first mark of each phase is kept, so a link flapping later on
+ * does not move "link up". The "boot" command prints the marks with the
+ * time elapsed since the previous one.
+ */
+#ifndef INC_BOOTPROFILE_H_
+#define INC_BOOTPROFILE_H_
+
+#include "FreeRTOS.h"
+#include "core/net.h"
+#include "dhcp/dhcp_client.h"
+
+/* Marks kept, at most */
+#define BOOT_PROFILE_MAX_MARKS     24
+
+/**
+ * @brief  Stamp the end of a phase. pcPhase must be a string constant: the
+ *         pointer is kept and compared, not the text. Callable from tasks,
+ *         before the scheduler starts as well.
+ */
+void vBootProfileMark(const char *pcPhase);
+
+/**
+ * @brief  Mark "link up" the first time the link of pxInterface comes up.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xBootProfileWatchLink(NetInterface *pxInterface);
+
+/* DHCP client state change callback (DhcpClientSettings.stateChangeEvent):
+ * marks the first request sent and the first lease bound */
+void vBootProfileDhcpStateChange(DhcpClientContext *pxContext, NetInterface *pxInterface, DhcpState eState);
+
+/* Register the "boot" CLI command */
+void vBootProfileRegisterCLICommands(void);
+
+#endif /* INC_BOOTPROFILE_H_ */
@@ -0,0 +1,121 @@
+/* ClockGovernor.h
+ *
+ * Load-adaptive core clock: the CPU runs at one of three levels, chosen
+ * from the CPU load and the traffic waiting in the Ethernet ring, so that
+ * a lightly loaded node draws less power without slowing its bursts.
+ *
+ *  level  PLL1            CPU      HCLK     APB      VOS  flash
+ *  full   N 275, P 1   550 MHz  275 MHz  137.5 MHz   0    3 WS   (boot)
+ *  half   N 275, P 1   275 MHz  275 MHz  137.5 MHz   0    3 WS
+ *  low    N 160, P 2   160 MHz   80 MHz   40 MHz     3    2 WS
+ *
+ * Full and half only differ by the CPU divider: the buses, and everything
+ * clocked from them, are untouched and the change takes a few cycles. Low
+ * relocks PLL1 at a lower voltage: the core runs on the HSE meanwhile,
+ * with interrupts disabled for the PLL lock and the regulator ramp (some
+ * 100 to 300 us). The APB dividers stay at /2 in every level, which the
+ * HAL time base (TIM23) assumes; the timers of APB1 keep integer MHz
+ * clocks in all of them.
+ *
+ * Once the clocks have changed, still with interrupts disabled, the
+ * governor derives again what depends on them:
+ *  - the microsecond clock (MonoClock.h), restarted at the time measured
+ *    across the change on the cycle counter;
+ *  - the PTP clock of the MAC: its addend follows HCLK, and the time it
+ *    lost or gained during the change is made up by an offset;
+ *  - the SysTick period (the tick in progress is scaled) and the run-time
+ *    counter of the statistics (RunTimeStats.h);
+ *  - the HAL time base, the sampling timer of AdcStream.h, and the baud
+ *    rate of USART2, USART3 and USART6 when they are clocked from APB.
+ * The MDIO clock divider (/124) stays within the PHY limits at 80 MHz.
+ *
+ * Every CLOCK_GOVERNOR_PERIOD_MS, the busy time of the CPU is measured
+ * from the run time of the idle task. The governor goes straight to full
+ * when the load reaches CLOCK_GOVERNOR_UP_PERMILLE, when
+ * CLOCK_GOVERNOR_RX_BACKLOG frames wait in the receive ring or when the
+ * driver had to leave frames for the next wakeup; it steps one level down
+ * after CLOCK_GOVERNOR_HOLD_SAMPLES samples in a row whose load, scaled to
+ * the lower clock, stays below CLOCK_GOVERNOR_DOWN_PERMILLE. Network
+ * standby (LowPower.h) holds the full level, which Stop mode restores on
+ * wakeup.
+ *
+ * Caveats: a byte on a UART or a frame on the wire may be lost during a
+ * relock; the SysTick falls behind by about the relock time at each one;
+ * the kernel clocks taken from pll1_q follow the level; timings of the
+ * statistics, traces and benchmarks mix the rates across a change. The
+ * sampling wakes the core every period, so a unit sleeping most of the
+ * time in tickless idle is better served by a fixed level.
+ */
+#ifndef INC_CLOCKGOVERNOR_H_
+#define INC_CLOCKGOVERNOR_H_
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* Sampling period, which bounds the reaction to a burst */
+#define CLOCK_GOVERNOR_PERIOD_MS           50u
+
+/* Load, in tenths of a percent, sending the clock to full */
+#define CLOCK_GOVERNOR_UP_PERMILLE         700u
+
+/* Load predicted at the lower level below which the clock steps down */
+#define CLOCK_GOVERNOR_DOWN_PERMILLE       500u
+
+/* Samples in a row below the down threshold before a step down */
+#define CLOCK_GOVERNOR_HOLD_SAMPLES        20u
+
+/* Frames waiting in the receive ring sending the clock to full */
+#define CLOCK_GOVERNOR_RX_BACKLOG          4u
+
+/* 1: the governor starts in automatic mode, 0: at the boot clock */
+#ifndef CLOCK_GOVERNOR_AUTO
+#define CLOCK_GOVERNOR_AUTO                1
+#endif
+
+/* Stack of the task, in words */
+#define CLOCK_GOVERNOR_TASK_STACK_SIZE     256
+
+typedef enum
+{
+    eClockLevelFull = 0,
+    eClockLevelHalf,
+    eClockLevelLow,
+    eClockLevelCount
+} ClockLevel_t;
+
+typedef struct
+{
+    ClockLevel_t eLevel;
+    BaseType_t xAuto;
+    uint32_t ulBusyPermille;            /* Over the last sample */
+    uint32_t ulRxBacklog;
+    uint32_t ulEntries[eClockLevelCount];
+    uint64_t ullLevelUs[eClockLevelCount];
+    uint32_t ulLongestUs;               /* Longest change, interrupts disabled */
+    uint32_t ulLastUs;
+} ClockGovernorStats_t;
+
+/**
+ * @brief  Create the governor task. To be called after netBringUp(), the
+ *         PTP clock and the UARTs being set up at the boot clock.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xClockGovernorStart(UBaseType_t uxPriority);
+
+/**
+ * @brief  Leave the level to the governor (xAuto) or hold eLevel; the
+ *         change is made by the task, within a few ticks.
+ */
+void vClockGovernorSetMode(BaseType_t xAuto, ClockLevel_t eLevel);
+
+/* State and counters of the governor */
+void vClockGovernorGetStats(ClockGovernorStats_t *pxStats);
+
+/* pdTRUE when the clocks are those of SystemClock_Config(); safe from any
+ * context */
+BaseType_t xClockGovernorAtBootClock(void);
+
+/* Register the "clock" CLI command */
+void vClockGovernorRegisterCLICommands(void);
+
+#endif /* INC_CLOCKGOVERNOR_H_ */
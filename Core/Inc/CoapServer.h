@@ -0,0 +1,127 @@
+/* CoapServer.h
+ *
+ * CoAP server (RFC 7252) for the dashboards, with Observe (RFC 7641) so
+ * that they are sent the values as they change instead of polling for them,
+ * and Block2 (RFC 7959) for the representations longer than a datagram.
+ *
+ * Requests are handled on the UDP fast path: the datagram is parsed in place
+ * in the TCP/IP task, the resource is found by walking the tree of path
+ * segments and the response is built directly in the transmit buffer, with
+ * no socket, queue or task switch in between. Confirmable requests are
+ * remembered for the exchange lifetime in a cache of
+ * COAP_SERVER_DEDUP_ENTRIES entries, so that a retransmitted request gets
+ * the same response (short ones are kept, longer ones rebuilt) rather than
+ * being executed twice; a repeated non-confirmable request is dropped.
+ *
+ * vCoapServerNotify() only marks a resource as changed. The server task then
+ * reads the representation once, whatever the number of observers, and
+ * sends the notifications COAP_SERVER_BATCH datagrams per socket call.
+ * Notifications are non-confirmable, except one every
+ * COAP_SERVER_CON_INTERVAL_MS per observer: an observer which does not
+ * acknowledge it, or which answers a notification with a reset, is removed.
+ * Representations longer than the block size are sent block by block, the
+ * notifications carrying the first block only.
+ *
+ * Resource handlers run with the server lock held, in the TCP/IP task for
+ * requests and in the server task for notifications, one at a time: they
+ * should only copy values, and must not call the socket API.
+ */
+#ifndef INC_COAPSERVER_H_
+#define INC_COAPSERVER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* Resources, path segments included, and their longest segment */
+#define COAP_SERVER_MAX_RESOURCES      32
+#define COAP_SERVER_SEGMENT_SIZE       24u
+
+/* Deepest path handled */
+#define COAP_SERVER_MAX_DEPTH          8u
+
+/* Observers of all resources together */
+#define COAP_SERVER_MAX_OBSERVERS      64
+
+/* Largest representation of a resource */
+#define COAP_SERVER_MAX_REPRESENTATION 2048u
+
+/* Block size exponent: blocks of 16 << 5 = 512 bytes */
+#define COAP_SERVER_BLOCK_SZX          5u
+
+/* Largest datagram, a full block and its options */
+#define COAP_SERVER_MAX_MESSAGE        576u
+
+/* Requests remembered, with their response when it fits */
+#define COAP_SERVER_DEDUP_ENTRIES      32
+#define COAP_SERVER_DEDUP_RESPONSE     96u
+#define COAP_SERVER_EXCHANGE_LIFETIME_MS 247000u
+
+/* Notifications handed to one socketSendMsgBatch() call */
+#define COAP_SERVER_BATCH              8
+
+/* A confirmable notification is sent to each observer this often, and
+   retransmitted from ACK_TIMEOUT, doubled MAX_RETRANSMIT times */
+#define COAP_SERVER_CON_INTERVAL_MS    60000u
+#define COAP_SERVER_ACK_TIMEOUT_MS     2000u
+#define COAP_SERVER_MAX_RETRANSMIT     4u
+
+/* Stack of the task, in words; notification handlers run on it */
+#define COAP_SERVER_TASK_STACK_SIZE    512
+
+/* Content format given to the PUT and POST handlers for a request without one */
+#define COAP_SERVER_NO_FORMAT          0xFFFFu
+
+/* Writes the representation of the resource; returns its length, at most xSize */
+typedef size_t (*CoapGetHandler_t)(void *pvContext, uint8_t *pucBuffer, size_t xSize);
+
+/* Handles a PUT or POST; returns the response code, COAP_CODE(2, 4) for
+   instance */
+typedef uint8_t (*CoapPutHandler_t)(void *pvContext, uint8_t ucMethod, const uint8_t *pucPayload,
+                                    size_t xLength, uint16_t usContentFormat);
+
+typedef struct
+{
+    uint32_t ulRequests;
+    uint32_t ulDuplicates;          /* Retransmitted requests answered from the cache or dropped */
+    uint32_t ulBadRequests;         /* Malformed, or with an unsupported critical option */
+    uint32_t ulBlocks;              /* Responses carrying a Block2 option */
+    uint32_t ulNotifications;       /* Non-confirmable notifications */
+    uint32_t ulConfirmable;         /* Confirmable notifications, retransmissions included */
+    uint32_t ulRetransmitted;
+    uint32_t ulBatches;             /* socketSendMsgBatch() calls */
+    uint32_t ulObserversAdded;
+    uint32_t ulObserversRemoved;    /* Cancelled, reset or unacknowledged */
+    uint32_t ulObserversRefused;    /* Table full */
+} CoapServerStats_t;
+
+/**
+ * @brief  Create the server task, which serves the CoAP port once the
+ *         network is up.
+ * @param  uxPriority  Task priority.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xCoapServerStart(UBaseType_t uxPriority);
+
+/**
+ * @brief  Add a resource, and the path segments leading to it.
+ * @param  pcPath           Path, "sensors/temperature" for instance.
+ * @param  usContentFormat  Content format of the representation.
+ * @param  xObservable      pdTRUE to accept observers.
+ * @param  pxGet            Representation for GET, NULL if not allowed.
+ * @param  pxPut            Handler of PUT and POST, NULL if not allowed.
+ * @param  pvContext        Passed to the handlers.
+ * @return Handle of the resource, or -1 if the path is invalid, taken or the table full.
+ */
+int32_t lCoapServerAddResource(const char *pcPath, uint16_t usContentFormat, BaseType_t xObservable,
+                               CoapGetHandler_t pxGet, CoapPutHandler_t pxPut, void *pvContext);
+
+/* The representation of the resource changed: notify its observers */
+void vCoapServerNotify(int32_t lResource);
+
+void vCoapServerGetStats(CoapServerStats_t *pxStats);
+
+/* Register the "coap" CLI command */
+void vCoapServerRegisterCLICommands(void);
+
+#endif /* INC_COAPSERVER_H_ */
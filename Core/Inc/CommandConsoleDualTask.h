@@ -15,6 +15,7 @@
 #include "task.h"
 #include "stream_buffer.h"
 #include "semphr.h"
+#include "queue.h"
 #include "FreeRTOS_CLI.h"
 
 /* Default task config */
@@ -28,19 +29,103 @@
 
 #define COMMAND_CONSOLE_DUAL_TASK_PRIO 	( tskIDLE_PRIORITY + 1 )
 
+/* Number of worker tasks executing commands received over Telnet */
+#define COMMAND_CONSOLE_DUAL_WORKER_COUNT	2
+
+/* Command lines remembered per console (recalled with the up / down arrows) */
+#define COMMAND_CONSOLE_DUAL_HISTORY_DEPTH	4
+
+/* Candidates listed when Tab completes an ambiguous command name */
+#define COMMAND_CONSOLE_DUAL_COMPLETE_LIST	16
+
+/* Static output sink per executing task, and the limit it may grow to on the heap */
+#define COMMAND_CONSOLE_DUAL_SINK_SIZE		256
+#define COMMAND_CONSOLE_DUAL_SINK_MAX_SIZE	2048
+
+/* Background jobs: number of concurrent jobs and per-job context storage */
+#define COMMAND_CONSOLE_DUAL_MAX_JOBS			4
+#define COMMAND_CONSOLE_DUAL_JOB_CONTEXT_SIZE	( configCOMMAND_INT_MAX_INPUT_SIZE + 8 )
+
+
+
+/**
+ * Result of one invocation of a background job function
+ */
+typedef enum
+{
+	eConsoleJobMore = 0,	// More output for this step, call again immediately
+	eConsoleJobWait,		// Step complete, call again after the job period
+	eConsoleJobDone			// Job finished
+} eConsoleJobResult;
+
+/**
+ * Result of eCommandConsoleRun()
+ */
+typedef enum
+{
+	eConsoleRunOk = 0,				// Command executed, its output delivered
+	eConsoleRunUnknownCommand,		// No such command
+	eConsoleRunBadParameters,		// Wrong number of parameters, or line too long
+	eConsoleRunBusy					// CLI held for too long (commands being registered)
+} eConsoleRunResult;
+
+/**
+ * Receives the output of a command run by eCommandConsoleRun(), in pieces
+ */
+typedef void ( *ConsoleOutputFunction_t )( const char *pcData, size_t xLength, void *pvContext );
+
+/**
+ * Background job function. Output written to pcWriteBuffer (NUL terminated)
+ * is sent to the console that started the job; pvContext points to the job's
+ * private copy of the context passed to uxCommandConsoleJobStart().
+ */
+typedef eConsoleJobResult ( *ConsoleJobFunction_t )( char *pcWriteBuffer, size_t xWriteBufferLen, void *pvContext );
+
 
 
 /**
  * @brief Initialize and start Serial and Telnet Command Console Tasks
  * @param xSerialRxStream, stream buffer handle to receive stream from serial
- * @param xSerialTxStream, stream buffer handle to transmit stream to serial
- * @param xTelnetRxStream, stream buffer handle to receive stream from telnet
- * @param xTelnetTxStream, stream buffer handle to transmit stream to telnet
- */
-void vCommandConsoleDualInit(	StreamBufferHandle_t xSerialRxStream,
-								StreamBufferHandle_t xSerialTxStream,
-								StreamBufferHandle_t xTelnetRxStream,
-								StreamBufferHandle_t xTelnetTxStream );
+ * @note  Output is written with vSerialTaskWrite() and xTelnetTaskWrite(),
+ *        straight into the UART DMA and socket TX buffers; Telnet input comes
+ *        from the stream buffers of TelnetTask, so xTelnetTaskStart() must be
+ *        called first
+ */
+void vCommandConsoleDualInit(	StreamBufferHandle_t xSerialRxStream );
+
+/**
+ * @brief Start a background job; to be called from a CLI command interpreter
+ * @param pcName, job name shown by the "jobs" command (not copied)
+ * @param pxFunction, job function, run by the job runner task
+ * @param pvContext, context copied into the job, may be NULL
+ * @param xContextLength, size of the context, at most COMMAND_CONSOLE_DUAL_JOB_CONTEXT_SIZE
+ * @param xPeriod, ticks between job steps
+ * @return job identifier (> 0), or 0 if no job slot is free or no console is executing a command
+ *
+ * The job's output goes to the console that executed the calling command. Jobs
+ * are listed with "jobs" and stopped with "kill <id>" or Ctrl-C on that console.
+ */
+UBaseType_t uxCommandConsoleJobStart(	const char *pcName,
+										ConsoleJobFunction_t pxFunction,
+										const void *pvContext,
+										size_t xContextLength,
+										TickType_t xPeriod );
+
+/**
+ * @brief Execute one command line for a machine-driven transport (no line
+ *        editing, no prompt, no error text)
+ * @param pcCommand, command line, shorter than configCOMMAND_INT_MAX_INPUT_SIZE
+ * @param pxOutput, called with the output of the command as it is produced
+ * @param pvContext, passed to pxOutput
+ * @return eConsoleRunOk, or why the command did not run
+ *
+ * Not reentrant: a single task (the batch console) may call it. Commands run in
+ * that task, which is not a console executor, so they cannot start background
+ * jobs.
+ */
+eConsoleRunResult eCommandConsoleRun(	const char *pcCommand,
+										ConsoleOutputFunction_t pxOutput,
+										void *pvContext );
 
 
 #endif /* INC_COMMANDCONSOLEDUALTASK_H_ */
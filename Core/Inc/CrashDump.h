@@ -0,0 +1,116 @@
+/* CrashDump.h
+ *
+ * Crash dumps in the backup SRAM. A failed configASSERT(), a task stack
+ * overflow (configCHECK_FOR_STACK_OVERFLOW) and the fault exceptions write
+ * a dump then reset the MCU, rather than spinning with the interrupts
+ * masked: the board comes back on the network, and the dump survives the
+ * reset, the backup SRAM being cleared neither by a system reset nor by the
+ * startup code (nor on VBAT, the backup regulator being on).
+ *
+ * The dump holds the reason, the registers stacked by the exception and the
+ * fault status registers, the running task, the latest events of the trace
+ * recorder ring (TraceRecorder.h) and the network counters. It is kept
+ * until cleared or overwritten by the next crash, and read with the "crash"
+ * command or over UDP: any datagram to CRASH_DUMP_PORT is answered with the
+ * CrashDump_t as it is in the backup SRAM, a datagram "clear" first erases
+ * the dump. A dump is valid if ulMagic is CRASH_DUMP_MAGIC and ulCheck
+ * matches.
+ *
+ * With a debugger attached, the core stops on a breakpoint before the reset.
+ */
+#ifndef INC_CRASHDUMP_H_
+#define INC_CRASHDUMP_H_
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "core/net.h"
+#include "core/socket_reactor.h"
+#include "TraceRecorder.h"
+
+/* Latest trace events kept; with the counters, the dump fits in a frame */
+#define CRASH_DUMP_TRACE_EVENTS        48u
+
+/* UDP port the dump is read from */
+#define CRASH_DUMP_PORT                17001u
+
+#define CRASH_DUMP_MAGIC               0x48535243u     /* "CRSH" */
+
+/* Reasons */
+#define CRASH_REASON_ASSERT            1u
+#define CRASH_REASON_STACK_OVERFLOW    2u
+#define CRASH_REASON_FAULT             3u              /* ulException gives the fault */
+#define CRASH_REASON_WATCHDOG          4u              /* cTask missed its deadline */
+
+/* Dump, little endian; ulSize lets the host check its layout, which depends
+ * on NET_INTERFACE_COUNT */
+typedef struct
+{
+    uint32_t ulMagic;
+    uint32_t ulCheck;               /* Complement of the sum of the words after it */
+    uint32_t ulSize;                /* sizeof(CrashDump_t) */
+    uint32_t ulCrashCount;          /* Dumps written since the backup domain was reset */
+    uint32_t ulReason;
+    uint32_t ulException;           /* Exception number, 0 in thread mode */
+    uint32_t ulUptimeMs;
+    uint32_t ulCycles;              /* DWT cycle counter */
+    /* Exception frame as stacked; for an assertion or a stack overflow,
+     * only PC (the caller) and SP are set; for a watchdog reset, the frame
+     * the stalled task was switched out with */
+    uint32_t ulR0;
+    uint32_t ulR1;
+    uint32_t ulR2;
+    uint32_t ulR3;
+    uint32_t ulR12;
+    uint32_t ulLr;
+    uint32_t ulPc;
+    uint32_t ulPsr;
+    uint32_t ulSp;                  /* Before the exception */
+    uint32_t ulExcReturn;
+    /* System control block */
+    uint32_t ulCfsr;
+    uint32_t ulHfsr;
+    uint32_t ulMmfar;
+    uint32_t ulBfar;
+    uint32_t ulAfsr;
+    uint32_t ulAssertLine;          /* Watchdog reset: time overdue, in milliseconds */
+    char cAssertFile[32];           /* End of the path */
+    char cTask[configMAX_TASK_NAME_LEN];
+    uint32_t ulTraceCount;
+    TraceEvent_t xTrace[CRASH_DUMP_TRACE_EVENTS];
+    NetStats xNet;
+} CrashDump_t;
+
+/**
+ * @brief  Clock the backup SRAM, check the dump left by the last crash and
+ *         enable the configurable fault exceptions. To be called first
+ *         thing after HAL_Init().
+ */
+void vCrashDumpInit(void);
+
+/**
+ * @brief  Dump of the last crash.
+ * @return The dump, NULL if there is none.
+ */
+const CrashDump_t *pxCrashDumpGet(void);
+
+void vCrashDumpClear(void);
+
+/**
+ * @brief  Answer the dump requests on CRASH_DUMP_PORT from the socket
+ *         reactor.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xCrashDumpListen(SocketReactorContext *pxReactor);
+
+/* configASSERT() failure; does not return */
+void vCrashDumpAssert(const char *pcFile, uint32_t ulLine) __attribute__((noreturn));
+
+/* Dump of a task that missed its watchdog deadline, then reset; called by
+ * the supervisor, the stalled task being switched out */
+void vCrashDumpTaskStall(TaskHandle_t xTask, uint32_t ulOverdueMs) __attribute__((noreturn));
+
+/* Register the "crash" CLI command */
+void vCrashDumpRegisterCLICommands(void);
+
+#endif /* INC_CRASHDUMP_H_ */
@@ -0,0 +1,38 @@
+/* CyphalCrc.h */
+#ifndef INC_CYPHALCRC_H_
+#define INC_CYPHALCRC_H_
+
+#include "FreeRTOS.h"
+
+/* Blocks shorter than this are left to the slice-by-8 implementation of
+ * libudpard, which beats the register setup of the peripheral on them */
+#define CYPHAL_CRC_HW_MIN_SIZE     64
+
+/* Usage of the CRC peripheral */
+typedef struct
+{
+    BaseType_t xHardware;       /* pdTRUE once the self-test has passed */
+    uint32_t ulBlocks;          /* Blocks computed by the peripheral */
+    uint32_t ulBytes;           /* Bytes computed by the peripheral */
+} CyphalCrcStats_t;
+
+/**
+ * @brief  Clock and self-test the CRC peripheral against a bitwise CRC-32C;
+ *         on failure the peripheral stays unused. To be called before the
+ *         first libudpard call.
+ * @return pdPASS if the peripheral is used, pdFAIL otherwise.
+ */
+BaseType_t xCyphalCrcInit(void);
+
+/**
+ * @brief  UDPARD_TRANSFER_CRC_ADD_HOOK: add xSize bytes to the running
+ *         CRC-32C ulCrc (before the output XOR) on the CRC peripheral. The
+ *         caller serializes the calls, as for all libudpard state.
+ * @return pdTRUE with the CRC in *pulOut, or pdFALSE if the block is short
+ *         or the peripheral unavailable.
+ */
+BaseType_t xCyphalCrcAdd(uint32_t ulCrc, size_t xSize, const void *pvData, uint32_t *pulOut);
+
+void vCyphalCrcGetStats(CyphalCrcStats_t *pxStats);
+
+#endif /* INC_CYPHALCRC_H_ */
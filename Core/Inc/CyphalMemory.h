@@ -0,0 +1,50 @@
+/* CyphalMemory.h */
+#ifndef INC_CYPHALMEMORY_H_
+#define INC_CYPHALMEMORY_H_
+
+#include "FreeRTOS.h"
+#include "udpard.h"
+
+/* Blocks are kept aligned on 8 bytes, as libudpard requires max_align_t */
+#define CYPHAL_POOL_ALIGNMENT          8
+#define CYPHAL_POOL_BLOCK_SIZE(size)   (((size) + CYPHAL_POOL_ALIGNMENT - 1) & ~(size_t) (CYPHAL_POOL_ALIGNMENT - 1))
+
+/* Usage of a pool */
+typedef struct
+{
+    size_t xBlockSize;
+    UBaseType_t uxBlockCount;
+    UBaseType_t uxUsed;         /* Blocks currently allocated */
+    UBaseType_t uxPeak;         /* Highest uxUsed since boot */
+    uint32_t ulFailures;        /* Pool empty, or request larger than a block */
+    size_t xLargestRequest;     /* Largest size requested, to check the sizing */
+} CyphalPoolStats_t;
+
+/* Fixed block pool; the free list is threaded through the free blocks */
+typedef struct
+{
+    uint8_t *pucStart;
+    uint8_t *pucEnd;
+    void *pvFree;
+    CyphalPoolStats_t xStats;
+} CyphalPool_t;
+
+/**
+ * @brief  Carve pvStorage into uxBlockCount blocks of xBlockSize bytes.
+ *         xBlockSize must be a multiple of CYPHAL_POOL_ALIGNMENT.
+ */
+void vCyphalPoolInit(CyphalPool_t *pxPool, void *pvStorage, size_t xBlockSize, UBaseType_t uxBlockCount);
+
+/**
+ * @brief  UdpardMemoryAllocate / UdpardMemoryDeallocate on the pool passed
+ *         as user reference. Both run in constant time, a free list pop or
+ *         push, and mask no interrupt; the caller serializes them.
+ */
+void *pvCyphalPoolAllocate(void *pvPool, size_t xSize);
+void vCyphalPoolFree(void *pvPool, size_t xSize, void *pvBlock);
+
+/* libudpard memory resource and deleter backed by the pool */
+struct UdpardMemoryResource xCyphalPoolResource(CyphalPool_t *pxPool);
+struct UdpardMemoryDeleter xCyphalPoolDeleter(CyphalPool_t *pxPool);
+
+#endif /* INC_CYPHALMEMORY_H_ */
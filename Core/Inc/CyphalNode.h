@@ -0,0 +1,271 @@
+/* CyphalNode.h */
+#ifndef INC_CYPHALNODE_H_
+#define INC_CYPHALNODE_H_
+
+#include "FreeRTOS.h"
+#include "udpard.h"
+#include "CyphalMemory.h"
+#include "CyphalCrc.h"
+#include "net_config.h"
+
+/* Node-ID of this board on the Cyphal/UDP network. With CYPHAL_NODE_PNP
+ * the node starts anonymous and gets its node-ID from an allocator
+ * (CyphalPnp.c), asking for this one the first time */
+#define CYPHAL_NODE_ID                     42
+#define CYPHAL_NODE_PNP                    1
+
+/* Unique-ID of the node, as in uavcan.node.GetInfo and plug-and-play */
+#define CYPHAL_NODE_UNIQUE_ID_SIZE         16
+
+/* Redundant interfaces the node runs on, netInterface[0] onwards: each
+ * transfer is sent on all of them and received from whichever delivers it
+ * first. At most UDPARD_NETWORK_INTERFACE_COUNT_MAX and NET_INTERFACE_COUNT;
+ * the single-interface profile of net_config.h leaves only the port */
+#if (NET_INTERFACE_COUNT > 1)
+#define CYPHAL_NODE_IFACE_COUNT            2
+#else
+#define CYPHAL_NODE_IFACE_COUNT            1
+#endif
+
+/* Subjects and RPC services the node can receive at once; the services
+ * of CyphalServices.c take three */
+#define CYPHAL_NODE_MAX_SUBSCRIPTIONS      4
+#define CYPHAL_NODE_MAX_SERVICES           8
+
+/* Receiving sockets: one per subscription and interface, plus the RPC
+ * socket of each interface */
+#define CYPHAL_NODE_SOCKET_COUNT           ((CYPHAL_NODE_MAX_SUBSCRIPTIONS + 1) * CYPHAL_NODE_IFACE_COUNT)
+
+/* Frames held by the transmission queue of each interface. The TX pool has
+ * one block per entry of every queue, plus one per frame the stack may
+ * still hold once popped from a queue (NET_MEM_MAX_TX_HOLDS, the zero-copy
+ * holds of the Ethernet driver), so that it cannot run out before a queue
+ * is full */
+#define CYPHAL_NODE_TX_QUEUE_CAPACITY      16
+#define CYPHAL_NODE_TX_IN_FLIGHT           8
+#define CYPHAL_NODE_TX_BLOCK_COUNT         (CYPHAL_NODE_TX_QUEUE_CAPACITY * CYPHAL_NODE_IFACE_COUNT + \
+                                            CYPHAL_NODE_TX_IN_FLIGHT + \
+                                            CYPHAL_NODE_LAUNCH_SLOTS * CYPHAL_NODE_IFACE_COUNT)
+
+/* Time-triggered frames (xCyphalNodePublishAt) taken out of the queue of
+ * each interface to wait for their launch time, so that they do not hold
+ * up the frames behind them */
+#define CYPHAL_NODE_LAUNCH_SLOTS           4
+
+/* A time-triggered frame is handed to the stack this long before its
+ * launch time, at least two service cycles, and the MAC holds it until the
+ * PTP time matches. Everything queued behind it in the ring of the MAC
+ * waits as well, for this long at worst */
+#define CYPHAL_NODE_LAUNCH_LEAD_US         3000u
+
+/* Time-triggered frames not sent this long after their launch time are
+ * dropped */
+#define CYPHAL_NODE_LAUNCH_SLACK_US        2000u
+
+/* Period of the service cycle, which drops expired frames and runs the
+ * cycle hook; received datagrams and new frames are handled at once */
+#define CYPHAL_NODE_CYCLE_US               1000u
+
+/* Period of uavcan.node.Heartbeat.1.0 (at most 1 s per the specification) */
+#define CYPHAL_NODE_HEARTBEAT_PERIOD_US    1000000u
+
+/* Fixed block pools serving libudpard, one per resource. Block sizes hold
+ * the largest object of each on Cortex-M7; "cyphal" prints the largest
+ * size requested from each pool to check them:
+ *  - TX item: libudpard item header and a datagram of up to the default
+ *    MTU plus the Cyphal header and CRC
+ *  - RX datagram: a received datagram, owned by libudpard until the
+ *    transfer it belongs to is consumed
+ *  - RX session: state per remote node and port (about 300 bytes)
+ *  - RX fragment: handle per datagram of a transfer being reassembled */
+#define CYPHAL_NODE_TX_BLOCK_SIZE          1536
+#define CYPHAL_NODE_RX_DATAGRAM_SIZE       1536
+#define CYPHAL_NODE_RX_DATAGRAM_COUNT      16
+#define CYPHAL_NODE_RX_SESSION_SIZE        384
+#define CYPHAL_NODE_RX_SESSION_COUNT       16
+#define CYPHAL_NODE_RX_FRAGMENT_SIZE       64
+#define CYPHAL_NODE_RX_FRAGMENT_COUNT      32
+
+/* Received datagrams handed over to libudpard in their network buffer
+ * (the ETH RX buffer when loaned by the driver) rather than copied into
+ * the RX datagram pool. Held buffers are not available to the driver or
+ * the stack until their transfer is consumed or times out, so this is no
+ * more than the spare buffers of the driver,
+ * STM32H7XX_ETH_RX_LOAN_BUFFER_COUNT */
+#define CYPHAL_NODE_RX_HELD_COUNT          4
+
+/* Fragments held by the transfers being reassembled over all ports (one
+ * datagram each), beyond which the port receiving a new fragment evicts
+ * its oldest transfer. Keeps datagram blocks free, so that partial
+ * transfers which never complete cannot starve the reception of others */
+#define CYPHAL_NODE_RX_QUOTA               (CYPHAL_NODE_RX_DATAGRAM_COUNT - 4)
+
+/* Section of the RX pools: the DTCM, only ever accessed by the CPU since
+ * the sockets copy received datagrams out of the network buffers. The TX
+ * items are sent in place and stay in the AXI SRAM, which the Ethernet DMA
+ * reaches */
+#define CYPHAL_NODE_POOL_SECTION           ".dtcm_bss"
+
+/* Multicast TTL of outgoing datagrams, as recommended by Cyphal/UDP */
+#define CYPHAL_NODE_MULTICAST_TTL          16
+
+/* Stack of the node task, in words */
+#define CYPHAL_NODE_STACK_SIZE             512
+
+/* Health and mode reported by the heartbeat */
+#define CYPHAL_HEALTH_NOMINAL              0
+#define CYPHAL_HEALTH_ADVISORY             1
+#define CYPHAL_HEALTH_CAUTION              2
+#define CYPHAL_HEALTH_WARNING              3
+
+#define CYPHAL_MODE_OPERATIONAL            0
+#define CYPHAL_MODE_INITIALIZATION         1
+#define CYPHAL_MODE_MAINTENANCE            2
+#define CYPHAL_MODE_SOFTWARE_UPDATE        3
+
+/* A message received on a subject. Runs in the node task; the payload is
+ * freed once the callback returns */
+typedef void (*CyphalMessageCallback_t)(const struct UdpardRxTransfer *pxTransfer, void *pvParam);
+
+/* A request or response received on an RPC service. Runs in the node task */
+typedef void (*CyphalServiceCallback_t)(const struct UdpardRxRPCTransfer *pxTransfer, void *pvParam);
+
+/* Called once per service cycle from the node task, for periodic publishers */
+typedef void (*CyphalCycleHook_t)(UdpardMicrosecond ullNowUs);
+
+/* Pools, in the order of CyphalNodeStats_t.xPools */
+#define CYPHAL_POOL_TX_ITEM                0
+#define CYPHAL_POOL_RX_DATAGRAM            1
+#define CYPHAL_POOL_RX_SESSION             2
+#define CYPHAL_POOL_RX_FRAGMENT            3
+#define CYPHAL_POOL_COUNT                  4
+
+/* Counters of one interface */
+typedef struct
+{
+    uint32_t ulTxFrames;          /* Datagrams sent */
+    uint32_t ulTxLinkDown;        /* Datagrams dropped, link down */
+    uint32_t ulRxDatagrams;       /* Datagrams received, duplicates included */
+} CyphalIfaceStats_t;
+
+/* Node counters, over all interfaces */
+typedef struct
+{
+    uint32_t ulTxFrames;          /* Datagrams sent */
+    uint32_t ulTxExpired;         /* Datagrams dropped past their deadline */
+    uint32_t ulTxErrors;          /* Datagrams the stack refused */
+    uint32_t ulTxQueueFull;       /* Transfers rejected by the queue */
+    uint32_t ulTxTimed;           /* Datagrams sent with a PTP launch time */
+    uint32_t ulTxUntimed;         /* Time-triggered datagrams sent by the node
+                                   * task, the PTP slave not being locked */
+    uint32_t ulRxDatagrams;       /* Datagrams received */
+    uint32_t ulRxInPlace;         /* Of which handed over in their network buffer */
+    uint32_t ulRxTransfers;       /* Transfers reassembled */
+    uint32_t ulRxDropped;         /* Datagrams dropped, RX datagram pool empty */
+    uint32_t ulRxFragments;       /* Fragments held by transfers being reassembled */
+    uint32_t ulRxTruncated;       /* Transfers truncated to the extent of their port */
+    uint32_t ulRxEvicted;         /* Partial transfers evicted by the fragment quotas */
+    uint32_t ulRxLate;            /* Partial transfers dropped past the transfer-ID timeout */
+    uint32_t ulRxQuotaDrops;      /* Datagrams dropped, quota reached with nothing to evict */
+    CyphalIfaceStats_t xIfaces[CYPHAL_NODE_IFACE_COUNT];
+    CyphalPoolStats_t xPools[CYPHAL_POOL_COUNT];
+    CyphalCrcStats_t xCrc;
+} CyphalNodeStats_t;
+
+/**
+ * @brief  Create the node task, which opens the sockets and starts
+ *         publishing the heartbeat. To be called after netInit().
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xCyphalNodeStart(UBaseType_t uxPriority);
+
+/**
+ * @brief  Subscribe to a subject; joins its multicast group.
+ * @param  usSubjectId Subject-ID, up to UDPARD_SUBJECT_ID_MAX.
+ * @param  xExtent Largest payload kept, longer messages are truncated.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xCyphalNodeSubscribe(UdpardPortID usSubjectId, size_t xExtent,
+                                CyphalMessageCallback_t pxCallback, void *pvParam);
+
+/**
+ * @brief  Accept requests (xIsRequest) or responses for an RPC service.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xCyphalNodeListen(UdpardPortID usServiceId, BaseType_t xIsRequest, size_t xExtent,
+                             CyphalServiceCallback_t pxCallback, void *pvParam);
+
+/**
+ * @brief  Queue a message; the frames still queued after ulTimeoutUs are
+ *         dropped. *pxTransferId is incremented on success. May be called
+ *         from any task.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xCyphalNodePublish(UdpardPortID usSubjectId, enum UdpardPriority ePriority,
+                              UdpardTransferID *pxTransferId, const void *pvData, size_t xLength,
+                              uint32_t ulTimeoutUs);
+
+/**
+ * @brief  Queue a message to go out at ullLaunchUs on the microsecond
+ *         clock. Once the PTP slave is locked, the MAC sends its frames
+ *         when the PTP time reaches the matching time, with a jitter of
+ *         about a microsecond; otherwise the node task sends them at the
+ *         first service cycle past ullLaunchUs. Frames not sent within
+ *         CYPHAL_NODE_LAUNCH_SLACK_US are dropped. A launch time closer
+ *         than CYPHAL_NODE_LAUNCH_LEAD_US may be missed by the MAC, the
+ *         frames then going out at once.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xCyphalNodePublishAt(UdpardPortID usSubjectId, enum UdpardPriority ePriority,
+                                UdpardTransferID *pxTransferId, const void *pvData, size_t xLength,
+                                UdpardMicrosecond ullLaunchUs);
+
+/**
+ * @brief  Queue a request to a server; *pxTransferId is incremented on
+ *         success.
+ */
+BaseType_t xCyphalNodeRequest(UdpardPortID usServiceId, UdpardNodeID usServerNodeId,
+                              enum UdpardPriority ePriority, UdpardTransferID *pxTransferId,
+                              const void *pvData, size_t xLength, uint32_t ulTimeoutUs);
+
+/**
+ * @brief  Queue the response to a request, with the transfer-ID and priority
+ *         of the request.
+ */
+BaseType_t xCyphalNodeRespond(const struct UdpardRxRPCTransfer *pxRequest,
+                              const void *pvData, size_t xLength, uint32_t ulTimeoutUs);
+
+/* Set the health and mode reported by the heartbeat */
+void vCyphalNodeSetStatus(uint8_t ucHealth, uint8_t ucMode, uint8_t ucVendorStatus);
+
+/* Install the hook called once per service cycle (NULL to remove it) */
+void vCyphalNodeSetCycleHook(CyphalCycleHook_t pxHook);
+
+/* Take and release xNodeMutex, for code outside the node that uses what
+ * libudpard shares, e.g. the CRC peripheral (no-op until the node starts) */
+void vCyphalNodeLock(void);
+void vCyphalNodeUnlock(void);
+
+/**
+ * @brief  Give the anonymous node its node-ID: the RPC sockets open and the
+ *         heartbeat starts. Only once.
+ * @return pdPASS on success, pdFAIL if the node already has a node-ID.
+ */
+BaseType_t xCyphalNodeSetNodeId(UdpardNodeID usNodeId);
+
+/* Node-ID of the node, UDPARD_NODE_ID_UNSET while anonymous */
+UdpardNodeID usCyphalNodeGetNodeId(void);
+
+/* Copy the CYPHAL_NODE_UNIQUE_ID_SIZE bytes of the unique-ID: the 96-bit
+ * device ID of the MCU, zero padded */
+void vCyphalNodeGetUniqueId(uint8_t *pucUniqueId);
+
+/* Microseconds since boot, the time base of deadlines and timestamps */
+UdpardMicrosecond ullCyphalNodeNowUs(void);
+
+void vCyphalNodeGetStats(CyphalNodeStats_t *pxStats);
+
+/* Register the "cyphal" CLI command */
+void vCyphalNodeRegisterCLICommands(void);
+
+#endif /* INC_CYPHALNODE_H_ */
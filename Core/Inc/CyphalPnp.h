@@ -0,0 +1,74 @@
+/* CyphalPnp.h
+ *
+ * Plug-and-play node-ID allocation of the Cyphal node, over
+ * uavcan.pnp.NodeIDAllocationData.2.0 (the version for transports with a
+ * large MTU, Cyphal/UDP included).
+ *
+ * Client: the anonymous node publishes its unique-ID along with the node-ID
+ * it would like, until an allocator answers with the node-ID granted; the
+ * node then takes it (xCyphalNodeSetNodeId). The node-ID granted is kept in
+ * the flash store and asked for again after a reboot: an allocator which
+ * granted it before answers the first request with it, so that the node
+ * rejoins in one round trip. The first request of a node with a cached
+ * node-ID goes out within CYPHAL_PNP_FAST_JOIN_JITTER_MS. Without one, and
+ * between retries, requests wait a random time between
+ * CYPHAL_PNP_REQUEST_MIN_MS and CYPHAL_PNP_REQUEST_MAX_MS, so that the
+ * nodes of a machine powering up spread their requests instead of all
+ * asking at once.
+ *
+ * Allocator (CYPHAL_PNP_ALLOCATOR): a node with a node-ID answers the
+ * requests it receives, from a table of the unique-IDs it has granted
+ * node-IDs to, kept in the flash store. A unique-ID found there gets its
+ * node-ID back; otherwise the node-ID asked for if free, else the nearest
+ * free one in the range of the allocator.
+ */
+#ifndef INC_CYPHALPNP_H_
+#define INC_CYPHALPNP_H_
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "CyphalNode.h"
+
+/* Delay of the first request with a cached node-ID, and between the other
+ * requests, random within the bounds */
+#define CYPHAL_PNP_FAST_JOIN_JITTER_MS      20u
+#define CYPHAL_PNP_REQUEST_MIN_MS           200u
+#define CYPHAL_PNP_REQUEST_MAX_MS           1000u
+
+/* Allocator, off by default: one per network is enough. Node-IDs are
+ * granted within the range, which must leave out statically configured
+ * nodes; the table holds the nodes granted a node-ID */
+#define CYPHAL_PNP_ALLOCATOR                0
+#define CYPHAL_PNP_ALLOCATOR_FIRST_ID       1u
+#define CYPHAL_PNP_ALLOCATOR_LAST_ID        127u
+#define CYPHAL_PNP_ALLOCATOR_ENTRIES        64
+
+/* Stack of the client task, in words */
+#define CYPHAL_PNP_STACK_SIZE               256
+
+typedef struct
+{
+    UdpardNodeID usCachedNodeId;        /* From the flash store, UNSET if none */
+    uint32_t ulRequests;                /* Requests published */
+    uint32_t ulJoinMs;                  /* From start to the node-ID, 0 until then */
+    uint32_t ulGranted;                 /* Allocator: requests answered */
+    uint32_t ulNewEntries;              /* Allocator: unique-IDs added to the table */
+    uint32_t ulExhausted;               /* Allocator: requests left unanswered,
+                                         * no node-ID or entry left */
+    uint32_t ulEntries;                 /* Allocator: entries of the table */
+} CyphalPnpStats_t;
+
+/**
+ * @brief  Subscribe to the allocation messages and, if the node is still
+ *         anonymous, create the client task. To be called after
+ *         xCyphalNodeStart().
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xCyphalPnpStart(UBaseType_t uxPriority);
+
+void vCyphalPnpGetStats(CyphalPnpStats_t *pxStats);
+
+/* Register the "cyphalpnp" CLI command */
+void vCyphalPnpRegisterCLICommands(void);
+
+#endif /* INC_CYPHALPNP_H_ */
@@ -0,0 +1,164 @@
+/* CyphalServices.h
+ *
+ * RPC service servers of the Cyphal/UDP node (CyphalNode.c): a handler per
+ * service-ID, answered from the node task, and the standard services every
+ * node is expected to provide:
+ *  - uavcan.node.GetInfo.1.0, serialized once at start;
+ *  - uavcan.register.Access.1.0 and uavcan.register.List.1.0, over the
+ *    registers added by the application, found through an index sorted by
+ *    name;
+ *  - uavcan.node.port.List.0.1, the ports of the node, published every
+ *    CYPHAL_SERVICES_PORT_LIST_PERIOD_US from a payload rebuilt only when a
+ *    port is added.
+ *
+ * Discovery tools query every node of the network at once, so a response
+ * to a static service costs no serialization: a service given a cached
+ * response (GetInfo, or any application service through
+ * xCyphalServicesSetCachedResponse) is answered straight from it.
+ */
+#ifndef INC_CYPHALSERVICES_H_
+#define INC_CYPHALSERVICES_H_
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "CyphalNode.h"
+
+/* Services served at once, the three standard ones included; each takes
+ * one of the CYPHAL_NODE_MAX_SERVICES ports of the node */
+#define CYPHAL_SERVICES_MAX_HANDLERS        6
+
+/* Registers, and ports declared by the application for the port list */
+#define CYPHAL_SERVICES_MAX_REGISTERS       32
+#define CYPHAL_SERVICES_MAX_PORTS           16
+
+/* Largest response; GetInfo takes at most 313 bytes and Access 267 */
+#define CYPHAL_SERVICES_RESPONSE_SIZE       320
+
+/* Responses still queued after this long are dropped */
+#define CYPHAL_SERVICES_RESPONSE_TIMEOUT_US 1000000u
+
+/* Period of uavcan.node.port.List (at most 10 s per the specification) */
+#define CYPHAL_SERVICES_PORT_LIST_PERIOD_US 5000000u
+
+/* Reported by GetInfo; the name takes up to 50 characters */
+#define CYPHAL_SERVICES_NODE_NAME           "com.example.h723.node"
+#define CYPHAL_SERVICES_HW_VERSION_MAJOR    1
+#define CYPHAL_SERVICES_HW_VERSION_MINOR    0
+#define CYPHAL_SERVICES_SW_VERSION_MAJOR    1
+#define CYPHAL_SERVICES_SW_VERSION_MINOR    0
+
+/* Returned by a handler which does not respond */
+#define CYPHAL_SERVICE_NO_RESPONSE          ((size_t) -1)
+
+/* Serialize the response to pxRequest into pucResponse, of xCapacity bytes,
+ * and return its length. Runs in the node task; pucResponse is reused for
+ * the next request once this returns */
+typedef size_t (*CyphalServiceHandler_t)(const struct UdpardRxRPCTransfer *pxRequest,
+                                         uint8_t *pucResponse, size_t xCapacity, void *pvParam);
+
+/* Register types: the tags of uavcan.register.Value.1.0 supported here.
+ * Values are arrays of usCount elements; a string or unstructured value
+ * holds up to usCount bytes, a string being NUL-terminated when shorter */
+#define CYPHAL_REGISTER_STRING              1
+#define CYPHAL_REGISTER_UNSTRUCTURED        2
+#define CYPHAL_REGISTER_INTEGER64           4
+#define CYPHAL_REGISTER_INTEGER32           5
+#define CYPHAL_REGISTER_INTEGER16           6
+#define CYPHAL_REGISTER_INTEGER8            7
+#define CYPHAL_REGISTER_NATURAL64           8
+#define CYPHAL_REGISTER_NATURAL32           9
+#define CYPHAL_REGISTER_NATURAL16           10
+#define CYPHAL_REGISTER_NATURAL8            11
+#define CYPHAL_REGISTER_REAL64              12
+#define CYPHAL_REGISTER_REAL32              13
+
+/* Register flags */
+#define CYPHAL_REGISTER_MUTABLE             0x01u
+#define CYPHAL_REGISTER_PERSISTENT          0x02u
+
+struct CyphalRegister;
+
+/* A register was written through uavcan.register.Access. Runs in the node
+ * task, after the new value was stored */
+typedef void (*CyphalRegisterChanged_t)(const struct CyphalRegister *pxRegister);
+
+/* A register; kept by reference, so it must outlive the node */
+typedef struct CyphalRegister
+{
+    const char *pcName;                 /* Up to 255 characters */
+    void *pvValue;
+    uint16_t usCount;
+    uint8_t ucType;
+    uint8_t ucFlags;
+    CyphalRegisterChanged_t pxChanged;  /* NULL if not needed */
+    void *pvParam;
+} CyphalRegister_t;
+
+/* Kinds of ports declared for the port list; the servers of this module
+ * and the heartbeat and port list publishers are listed without it */
+#define CYPHAL_PORT_PUBLISHER               0
+#define CYPHAL_PORT_SUBSCRIBER              1
+#define CYPHAL_PORT_CLIENT                  2
+
+typedef struct
+{
+    uint32_t ulRequests;                /* Requests received */
+    uint32_t ulCached;                  /* Answered from a cached response */
+    uint32_t ulNoResponse;              /* Handler gave no response */
+    uint32_t ulRespondErrors;           /* Responses the node could not queue */
+    uint32_t ulRegisterReads;           /* Access requests without a write */
+    uint32_t ulRegisterWrites;          /* Access requests which changed a value */
+    uint32_t ulRegisterRejects;         /* Writes to an immutable register, or
+                                         * of the wrong type or size */
+    uint32_t ulRegisterUnknown;         /* Access to an unknown name */
+    uint32_t ulPortLists;               /* Port lists published */
+} CyphalServicesStats_t;
+
+/**
+ * @brief  Serve GetInfo, register Access and List, and publish the port
+ *         list. To be called after xCyphalNodeStart(); takes over the
+ *         cycle hook of the node.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xCyphalServicesStart(void);
+
+/**
+ * @brief  Serve a service with pxHandler.
+ * @param  xExtent Largest request kept, longer ones are truncated.
+ * @return pdPASS on success, pdFAIL if the service is already served or no
+ *         slot is left.
+ */
+BaseType_t xCyphalServicesAdd(UdpardPortID usServiceId, size_t xExtent,
+                              CyphalServiceHandler_t pxHandler, void *pvParam);
+
+/**
+ * @brief  Answer every request of a served service with the same response
+ *         instead of calling its handler; NULL goes back to the handler.
+ *         The response is kept by reference and must stay valid.
+ * @return pdPASS on success, pdFAIL if the service is not served.
+ */
+BaseType_t xCyphalServicesSetCachedResponse(UdpardPortID usServiceId, const void *pvResponse, size_t xLength);
+
+/**
+ * @brief  Expose a register through uavcan.register.Access and List.
+ * @return pdPASS on success, pdFAIL if the name is taken, the type or size
+ *         is not supported, or the table is full.
+ */
+BaseType_t xCyphalServicesAddRegister(const CyphalRegister_t *pxRegister);
+
+/* Find a register by name, NULL if there is none */
+const CyphalRegister_t *pxCyphalServicesFindRegister(const char *pcName);
+
+/**
+ * @brief  List a port of the application in uavcan.node.port.List.
+ * @param  ucKind CYPHAL_PORT_PUBLISHER, _SUBSCRIBER or _CLIENT.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xCyphalServicesDeclarePort(uint8_t ucKind, UdpardPortID usPortId);
+
+void vCyphalServicesGetStats(CyphalServicesStats_t *pxStats);
+
+/* Register the "cyphalsrv" CLI command */
+void vCyphalServicesRegisterCLICommands(void);
+
+#endif /* INC_CYPHALSERVICES_H_ */
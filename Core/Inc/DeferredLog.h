@@ -0,0 +1,137 @@
+/* DeferredLog.h
+ *
+ * Backend of the TRACE_xxx macros of debug.h, selected at compile time.
+ *
+ * LOG_BACKEND_PRINTF keeps the CycloneTCP behaviour: the caller formats the
+ * message with fprintf() on its own stack, with the scheduler suspended,
+ * and the text reaches the serial TX ring through _write().
+ *
+ * LOG_BACKEND_DEFERRED takes the formatting out of the caller: the format
+ * string pointer and the values of the arguments are copied into a binary
+ * ring, the text of %s arguments included as the string may not outlive
+ * the call, and a low priority task formats the records and writes each
+ * line to the serial TX ring in one call. Slots are reserved with
+ * LDREX / STREX as in the trace recorder, so logging may happen from tasks
+ * and interrupts alike; a record that does not fit is dropped and counted.
+ *
+ * With both backends, messages pass a runtime level: the level of the
+ * module (source file) they come from if set with the "log" command, the
+ * global one otherwise. Each call site caches the level that applies to it
+ * and looks it up again only after a change, so a filtered message costs
+ * two loads and a compare. The compile-time TRACE_LEVEL of each file still
+ * removes the messages above it altogether.
+ *
+ * This header is included by os_port_config.h, hence by debug.h, and only
+ * needs the standard headers.
+ */
+#ifndef INC_DEFERREDLOG_H_
+#define INC_DEFERREDLOG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Backends */
+#define LOG_BACKEND_PRINTF             0
+#define LOG_BACKEND_DEFERRED           1
+
+/* Backend of the TRACE_xxx macros; a host build prints them directly */
+#ifndef LOG_BACKEND
+#ifdef USE_POSIX
+#define LOG_BACKEND                    LOG_BACKEND_PRINTF
+#else
+#define LOG_BACKEND                    LOG_BACKEND_DEFERRED
+#endif
+#endif
+
+/* Size of the ring, in bytes; a power of two */
+#define LOG_BUFFER_SIZE                4096u
+
+/* Largest record: header, arguments and copied strings */
+#define LOG_RECORD_MAX                 256u
+
+/* Message formatted by the log task before it is written out; longer
+ * messages are cut */
+#define LOG_LINE_MAX                   384u
+
+/* Modules whose level may be set apart from the global one */
+#define LOG_MAX_MODULES                8
+
+/* Stack of the log task, in words; it also sends the syslog datagrams
+ * through the TCP/IP stack (SyslogSink.h) */
+#define LOG_TASK_STACK_SIZE            1024
+
+/* Longest wait of the log task: records written from interrupts do not
+ * wake it up */
+#define LOG_TASK_POLL_MS               1000u
+
+/* Call site of a message: the level that applies to it, cached */
+typedef struct
+{
+    const char *pcFile;
+    uint16_t usGeneration;          /* Of the levels the cache was taken at */
+    uint8_t ucLevel;
+} LogSite_t;
+
+/* Incremented on every change of the levels */
+extern volatile uint16_t usDeferredLogGeneration;
+
+/* Look up the level of a call site */
+void vDeferredLogResolveSite(LogSite_t *pxSite);
+
+static inline int xDeferredLogSiteEnabled(LogSite_t *pxSite, uint8_t ucLevel)
+{
+    if (pxSite->usGeneration != usDeferredLogGeneration)
+    {
+        vDeferredLogResolveSite(pxSite);
+    }
+
+    return (ucLevel <= pxSite->ucLevel);
+}
+
+/* Copy a message to the ring; task or interrupt context */
+void vDeferredLogWrite(LogSite_t *pxSite, uint8_t ucLevel, const char *pcFormat, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#if (LOG_BACKEND == LOG_BACKEND_DEFERRED)
+#define LOG_EMIT(site, level, ...)     vDeferredLogWrite((site), (level), __VA_ARGS__)
+#else
+#define LOG_EMIT(site, level, ...)     osSuspendAllTasks(), fprintf(stderr, __VA_ARGS__), osResumeAllTasks()
+#endif
+
+/* Message of a given level (TRACE_LEVEL_xxx), filtered at runtime */
+#define LOG_WRITE(level, ...) \
+    do \
+    { \
+        static LogSite_t xLogSite = { __FILE__, 0, 0 }; \
+        if (xDeferredLogSiteEnabled(&xLogSite, (level))) \
+        { \
+            LOG_EMIT(&xLogSite, (level), __VA_ARGS__); \
+        } \
+    } while (0)
+
+/* Used by debug.h for every TRACE_xxx message */
+#define TRACE_PRINTF_LEVEL(level, ...) LOG_WRITE((level), __VA_ARGS__)
+
+/**
+ * @brief  Set a runtime level.
+ * @param  pcModule  Source file name, with or without extension; NULL for
+ *                   the global level.
+ * @param  ucLevel   TRACE_LEVEL_xxx.
+ * @return 0 on success, -1 if the module table is full.
+ */
+int32_t lDeferredLogSetLevel(const char *pcModule, uint8_t ucLevel);
+
+/* Module name of a source path: base name, extension removed; returns its
+ * length and points ppcName to it */
+size_t xDeferredLogModuleName(const char *pcPath, const char **ppcName);
+
+/* Forget the levels of every module */
+void vDeferredLogClearModules(void);
+
+/* Create the log task; records written before it runs are kept */
+long xDeferredLogStart(unsigned long uxPriority);
+
+/* Register the "log" CLI command */
+void vDeferredLogRegisterCLICommands(void);
+
+#endif /* INC_DEFERREDLOG_H_ */
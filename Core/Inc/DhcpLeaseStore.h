@@ -0,0 +1,22 @@
+/* DhcpLeaseStore.h */
+#ifndef INC_DHCPLEASESTORE_H_
+#define INC_DHCPLEASESTORE_H_
+
+#include "core/net.h"
+#include "dhcp/dhcp_client.h"
+
+/**
+ * @brief  DHCP client callback, retrieve the lease saved before the last
+ *         power-down or reset.
+ * @return NO_ERROR if a valid lease was found, ERROR_NOT_FOUND otherwise.
+ */
+error_t xDhcpLeaseStoreLoad(DhcpClientContext *pxContext, NetInterface *pxInterface, DhcpClientLease *pxLease);
+
+/**
+ * @brief  DHCP client callback, save a new lease or invalidate the saved
+ *         one (pxLease is NULL). The write is queued to the flash store and
+ *         done by its task; an unchanged lease is not written again.
+ */
+void vDhcpLeaseStoreSave(DhcpClientContext *pxContext, NetInterface *pxInterface, const DhcpClientLease *pxLease);
+
+#endif /* INC_DHCPLEASESTORE_H_ */
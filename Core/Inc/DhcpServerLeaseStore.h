@@ -0,0 +1,26 @@
+/* DhcpServerLeaseStore.h */
+#ifndef INC_DHCPSERVERLEASESTORE_H_
+#define INC_DHCPSERVERLEASESTORE_H_
+
+#include "FreeRTOS.h"
+#include "core/net.h"
+#include "dhcp/dhcp_server.h"
+
+/* Stack of the store task, in words */
+#define DHCP_SERVER_LEASE_STORE_STACK_SIZE   256
+
+/**
+ * @brief  Restore the lease table saved before the last power-down or reset
+ *         and create the task that saves it. To be called between
+ *         dhcpServerInit() and dhcpServerStart().
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xDhcpServerLeaseStoreStart(DhcpServerContext *pxContext, UBaseType_t uxPriority);
+
+/**
+ * @brief  DHCP server callback, the lease table changed. Runs in the TCP/IP
+ *         task, so it only wakes up the store task.
+ */
+void vDhcpServerLeaseStoreNotify(DhcpServerContext *pxContext);
+
+#endif /* INC_DHCPSERVERLEASESTORE_H_ */
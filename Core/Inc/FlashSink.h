@@ -0,0 +1,42 @@
+/* FlashSink.h
+ *
+ * TFTP sink (see TftpServer.h) storing the file written into a staging slot
+ * of the internal flash, for the firmware images pushed to the board.
+ *
+ * The erases and programs go through the flash store (FlashStore.h), which
+ * runs them from the ITCM in its own task. The slot is erased as a whole
+ * when the transfer opens, before the first block is acknowledged: the
+ * STM32H723 has a single bank, from which the code runs, so code left in
+ * flash stalls for the whole erase whenever it is done, and doing it up
+ * front keeps the stall out of the transfer. The data is then queued to the
+ * store FLASH_SINK_CHUNK_SIZE bytes at a time, the server going on with the
+ * next blocks while the store programs. The first flash word of the slot is
+ * a header, programmed last, once the file has been received and
+ * programmed entirely: an erased header means no image, and a transfer cut
+ * short never leaves one that looks complete.
+ */
+#ifndef INC_FLASHSINK_H_
+#define INC_FLASHSINK_H_
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "TftpServer.h"
+
+/* Sectors 4 and 5, kept out of the FLASH region of the linker script; the
+ * flash store uses the two above */
+#define FLASH_SINK_FIRST_SECTOR        FLASH_SECTOR_4
+#define FLASH_SINK_SECTORS             2u
+#define FLASH_SINK_ADDRESS             0x08080000u
+#define FLASH_SINK_SIZE                (FLASH_SINK_SECTORS * FLASH_SECTOR_SIZE)
+
+extern const TftpSink_t xFlashSink;
+
+/**
+ * @brief  Image of the last complete transfer.
+ * @param  ppucImage  Receives its address in flash.
+ * @param  pulSize    Receives its size, in bytes.
+ * @return pdPASS if the slot holds an image, pdFAIL otherwise.
+ */
+BaseType_t xFlashSinkGetImage(const uint8_t **ppucImage, uint32_t *pulSize);
+
+#endif /* INC_FLASHSINK_H_ */
@@ -0,0 +1,140 @@
+/* FlashStore.h
+ *
+ * Flash storage service: the one writer of the internal flash. Callers
+ * queue their requests, with a copy of the data, in a RAM stream buffer and
+ * return; a low-priority task programs and erases, then reports the
+ * outcome through the callback of the request, in its own context.
+ *
+ * The STM32H723 has a single bank, from which the code runs: while an
+ * operation is in progress, any read of the flash stalls the bus until it
+ * ends, a few tens of microseconds for a flash word and up to seconds for a
+ * sector erase. The primitives of the service therefore run from the ITCM
+ * (TCM_CODE) and touch the registers only, no HAL; the vector table is moved
+ * to the DTCM at start so that interrupts are taken, and the scheduler and
+ * the Ethernet interrupt run from the ITCM (TcmPlacement.h). Code left in
+ * flash keeps running as long as it hits the instruction cache. What the
+ * service guarantees is that no erase sits on the path of a write: sectors
+ * are erased in the background, once the queue has been idle for
+ * FLASH_STORE_ERASE_IDLE_MS, ahead of the time they are needed.
+ *
+ * Two uses:
+ *
+ * - Records: small values under a 16-bit key (the DHCP leases, etc.),
+ *   appended to a log over the two store sectors, one active at a time. A
+ *   record is a header flash word (key, length, CRC-32 of the data) then its
+ *   data; the last valid record of a key is its value. Once the active
+ *   sector is full, the latest record of each key is copied to the other
+ *   one, whose header is programmed last and so marks the copy complete;
+ *   the old sector is then erased in the background. The sectors alternate,
+ *   which spreads the erases evenly over them.
+ *
+ * - Raw erases and programs of the sectors outside the store and the code,
+ *   for the firmware images staged by FlashSink.
+ */
+#ifndef INC_FLASHSTORE_H_
+#define INC_FLASHSTORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* Sectors 6 and 7, kept out of the FLASH region of the linker script */
+#define FLASH_STORE_FIRST_SECTOR       6u
+#define FLASH_STORE_SECTORS            2u
+#define FLASH_STORE_ADDRESS            0x080C0000u
+
+/* Raw requests below this sector, which hold the code, are refused */
+#define FLASH_STORE_RAW_FIRST_SECTOR   4u
+
+/* Programming unit of the STM32H7, 256 bits */
+#define FLASH_STORE_WORD_SIZE          32u
+
+/* Keys of the records */
+#define FLASH_STORE_KEY_DHCP_LEASE           1u
+#define FLASH_STORE_KEY_DHCP_SERVER_LEASES   2u
+#define FLASH_STORE_KEY_CYPHAL_NODE_ID       3u
+#define FLASH_STORE_KEY_CYPHAL_PNP_TABLE     4u
+
+/* Keys held at once, and largest record or raw program */
+#define FLASH_STORE_MAX_KEYS           16
+#define FLASH_STORE_MAX_DATA_SIZE      2048u
+
+/* Bytes of the RAM queue, request headers and data together */
+#define FLASH_STORE_QUEUE_SIZE         6144u
+
+/* Idle time of the queue before a pending erase starts, in milliseconds */
+#define FLASH_STORE_ERASE_IDLE_MS      2000u
+
+/* Stack of the store task, in words */
+#define FLASH_STORE_STACK_SIZE         384
+
+/* Completion of a request, called from the store task */
+typedef void (*FlashStoreCallback_t)(BaseType_t xResult, void *pvParam);
+
+typedef struct
+{
+    uint32_t ulActiveSector;    /* FLASH_STORE_SECTORS if none yet */
+    uint32_t ulUsedBytes;       /* Of the active sector */
+    uint32_t ulKeys;
+    uint32_t ulWrites;          /* Records appended */
+    uint32_t ulCompactions;
+    uint32_t ulErases;          /* Sectors erased, raw ones included */
+    uint32_t ulPrograms;        /* Flash words programmed */
+    uint32_t ulErrors;          /* Requests failed */
+    uint32_t ulQueued;          /* Bytes waiting in the queue */
+    uint32_t ulEraseCount[FLASH_STORE_SECTORS];
+    BaseType_t xErasePending;
+} FlashStoreStats_t;
+
+/**
+ * @brief  Move the vector table to the DTCM, scan the store sectors and
+ *         create the store task. To be called before any other function of
+ *         the service; records can be read from then on, before the
+ *         scheduler starts as well.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xFlashStoreStart(UBaseType_t uxPriority);
+
+/**
+ * @brief  Queue a new value of a key; a zero length deletes the key. The
+ *         data is copied, pvData can be reused on return.
+ * @param  pxCallback  Called once the record is in flash, or has failed;
+ *                     NULL for none.
+ * @param  xTimeout    Time to wait for room in the queue; 0 from the TCP/IP
+ *                     task.
+ * @return pdPASS if queued, pdFAIL otherwise.
+ */
+BaseType_t xFlashStoreWrite(uint16_t usKey, const void *pvData, size_t xLength,
+                            FlashStoreCallback_t pxCallback, void *pvParam, TickType_t xTimeout);
+
+/**
+ * @brief  Copy the value of a key, as of the last completed write.
+ * @param  pxLength  Receives the length of the value, which may exceed
+ *                   xSize; only xSize bytes are copied then.
+ * @return pdPASS if the key has a value, pdFAIL otherwise.
+ */
+BaseType_t xFlashStoreRead(uint16_t usKey, void *pvData, size_t xSize, size_t *pxLength);
+
+/**
+ * @brief  Queue the erase of ulSectors sectors from ulFirstSector, outside
+ *         the store and the code.
+ * @return pdPASS if queued, pdFAIL otherwise.
+ */
+BaseType_t xFlashStoreErase(uint32_t ulFirstSector, uint32_t ulSectors,
+                            FlashStoreCallback_t pxCallback, void *pvParam, TickType_t xTimeout);
+
+/**
+ * @brief  Queue the programming of erased flash outside the store and the
+ *         code. ulAddress must be aligned on a flash word; the end of the
+ *         last word is padded as erased flash. The data is copied.
+ * @return pdPASS if queued, pdFAIL otherwise.
+ */
+BaseType_t xFlashStoreProgram(uint32_t ulAddress, const void *pvData, size_t xLength,
+                              FlashStoreCallback_t pxCallback, void *pvParam, TickType_t xTimeout);
+
+void vFlashStoreGetStats(FlashStoreStats_t *pxStats);
+
+/* Register the "flashstore" CLI command */
+void vFlashStoreRegisterCLICommands(void);
+
+#endif /* INC_FLASHSTORE_H_ */
@@ -0,0 +1,80 @@
+/* FleetTest.h
+ *
+ * Node side of the fleet test: latency, throughput and loss between many
+ * boards on one network, driven by Tools/fleet_test.py over the batch
+ * console.
+ *
+ * A node can, independently of one another:
+ *  - publish timestamped messages on FLEET_TEST_SUBJECT_ID over Cyphal/UDP
+ *    at a given rate and size ("fleet publish");
+ *  - count the messages of that subject from every other node ("fleet
+ *    listen");
+ *  - stream timestamped records to another node over TCP ("fleet tcp"),
+ *    at a given rate or as fast as the connection goes;
+ *  - accept such streams on FLEET_TEST_TCP_PORT ("fleet server").
+ * All-to-all is every node publishing and listening; fan-in is every node
+ * publishing, or streaming, to a gateway that alone listens.
+ *
+ * Messages and records carry the send time on the reference timescale of
+ * the microsecond clock (MonoClock.h), i.e. the PTP time once the slave is
+ * locked; the one-way latency is the difference with the reference time of
+ * the reception, and is only taken when both ends are synchronized. Per
+ * peer (node-ID for Cyphal, IPv4 address for TCP), the receiver keeps the
+ * messages and bytes received, the sequence gaps (lost) and the sequence
+ * numbers seen again or late (reordered), and the latency minimum, mean,
+ * maximum and a histogram in powers of two from 64 us. The sender counts
+ * what it sent and what could not be queued; the CPU load is measured from
+ * the last "fleet reset".
+ *
+ * The TCP server takes FLEET_TEST_MAX_CONNECTIONS streams at once, a bound
+ * set by the socket table; larger fan-ins are run in groups by the script.
+ * The Cyphal figures do not depend on the number of senders.
+ */
+#ifndef INC_FLEETTEST_H_
+#define INC_FLEETTEST_H_
+
+#include "FreeRTOS.h"
+
+/* Subject of the test messages, in the unregulated range */
+#define FLEET_TEST_SUBJECT_ID          6000u
+
+/* TCP port of the stream sink */
+#define FLEET_TEST_TCP_PORT            5002u
+
+/* Peers tracked by a receiver; the senders beyond are counted as unknown */
+#define FLEET_TEST_MAX_PEERS           64u
+
+/* Streams accepted at once */
+#define FLEET_TEST_MAX_CONNECTIONS     8u
+
+/* Size of the messages and records: the header, up to one Cyphal frame */
+#define FLEET_TEST_HEADER_SIZE         16u
+#define FLEET_TEST_MAX_SIZE            1024u
+
+/* Highest rate of the periodic senders, bounded by the tick */
+#define FLEET_TEST_MAX_RATE_HZ         1000u
+
+/* Time a message may wait in the Cyphal queue before it is dropped */
+#define FLEET_TEST_TX_TIMEOUT_US       100000u
+
+/* Buckets of the latency histogram: below 64 us, then [32 << b, 64 << b)
+ * us, the last one open */
+#define FLEET_TEST_HIST_BUCKETS        12u
+
+/* Peers printed by one "fleet peers" command, to fit a batch response */
+#define FLEET_TEST_PEERS_PER_PAGE      16u
+
+/* Stack of the task, in words */
+#define FLEET_TEST_TASK_STACK_SIZE     512
+
+/**
+ * @brief  Create the test task; it stays idle until the CLI starts a role.
+ *         To be called after xCyphalNodeStart().
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xFleetTestStart(UBaseType_t uxPriority);
+
+/* Register the "fleet" CLI command */
+void vFleetTestRegisterCLICommands(void);
+
+#endif /* INC_FLEETTEST_H_ */
@@ -54,6 +54,10 @@
 /* USER CODE BEGIN 0 */
   extern void configureTimerForRunTimeStats(void);
   extern unsigned long getRunTimeCounterValue(void);
+  extern void vLowPowerPreSleep(uint32_t *pulExpectedIdleTime);
+  extern void vLowPowerPostSleep(uint32_t ulExpectedIdleTime);
+  extern void vCrashDumpAssert(const char *pcFile, uint32_t ulLine);
+  #include "TraceRecorderHooks.h"
 /* USER CODE END 0 */
 #endif
 #define configENABLE_FPU                         1
@@ -70,7 +74,7 @@
 #define configMINIMAL_STACK_SIZE                 ((uint16_t)128)
 #define configTOTAL_HEAP_SIZE                    ((size_t)32768)
 #define configMAX_TASK_NAME_LEN                  ( 16 )
-#define configGENERATE_RUN_TIME_STATS            0
+#define configGENERATE_RUN_TIME_STATS            1
 #define configUSE_TRACE_FACILITY                 1
 #define configUSE_STATS_FORMATTING_FUNCTIONS     1
 #define configUSE_16_BIT_TICKS                   0
@@ -103,6 +107,7 @@ to exclude the API function. */
 #define INCLUDE_vTaskDelayUntil              1
 #define INCLUDE_vTaskDelay                   1
 #define INCLUDE_xTaskGetSchedulerState       1
+#define INCLUDE_xTaskGetIdleTaskHandle       1
 
 /* Cortex-M specific definitions. */
 #ifdef __NVIC_PRIO_BITS
@@ -132,10 +137,15 @@ See http://www.FreeRTOS.org/RTOS-Cortex-M3-M4.html. */
 /* Normal assert() semantics without relying on the provision of an assert.h
 header file. */
 /* USER CODE BEGIN 1 */
-#define configASSERT( x ) 					if ((x) == 0) {taskDISABLE_INTERRUPTS(); for( ;; );}
+/* A failed assertion writes a crash dump and resets (CrashDump.h) */
+#define configASSERT( x ) 					if ((x) == 0) {vCrashDumpAssert(__FILE__, __LINE__);}
+/* Canary at the end of each stack, checked at every context switch */
+#define configCHECK_FOR_STACK_OVERFLOW		2
 
 #define configCOMMAND_INT_MAX_INPUT_SIZE	128U
 #define configCOMMAND_INT_MAX_OUTPUT_SIZE  	128U
+#define configCOMMAND_INT_MAX_COMMANDS		128U	/* Size of the sorted command table */
+#define configCOMMAND_INT_PREFIX_MATCH		1		/* "nets" runs "netstat" */
 //#define configUART_COMMAND_CONSOLE_STACK  	256U
 
 /* USER CODE END 1 */
@@ -158,6 +168,38 @@ standard names. */
 
 /* USER CODE BEGIN Defines */
 /* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
+/* Tickless idle (LowPower.c): the SysTick is stopped while every task is
+blocked. It runs from the CPU clock divided by 8, so that one reload spans up
+to ~240 ms at 550 MHz rather than ~30 ms. */
+#define configUSE_TICKLESS_IDLE                  1
+#define configSYSTICK_CLOCK_HZ                   ( SystemCoreClock / 8 )
+#define configPRE_SLEEP_PROCESSING( x )          vLowPowerPreSleep( &( x ) )
+#define configPOST_SLEEP_PROCESSING( x )         vLowPowerPostSleep( ( x ) )
+
+/* Binary event trace (TraceRecorder.c), driven by the "trace" command. The
+macros expand in tasks.c, queue.c and stream_buffer.c, where the TCB and queue
+fields they read are visible. Semaphores and mutexes are queues, so their
+take and give show as receive and send. */
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+#if ( TRACE_RECORDER == 1 )
+#define configINCLUDE_TRACE_RELATED_CLI_COMMANDS 1
+#define traceTASK_SWITCHED_IN()                  vTraceRecorderTaskSwitchedIn( pxCurrentTCB->uxTCBNumber )
+#define traceQUEUE_SEND( pxQueue )               vTraceRecorderQueue( TRACE_EVENT_QUEUE_SEND, ( pxQueue ), ( pxQueue )->ucQueueType )
+#define traceQUEUE_SEND_FROM_ISR( pxQueue )      vTraceRecorderQueue( TRACE_EVENT_QUEUE_SEND, ( pxQueue ), ( pxQueue )->ucQueueType )
+#define traceQUEUE_SEND_FAILED( pxQueue )        vTraceRecorderQueue( TRACE_EVENT_QUEUE_SEND_FAILED, ( pxQueue ), ( pxQueue )->ucQueueType )
+#define traceQUEUE_RECEIVE( pxQueue )            vTraceRecorderQueue( TRACE_EVENT_QUEUE_RECEIVE, ( pxQueue ), ( pxQueue )->ucQueueType )
+#define traceQUEUE_RECEIVE_FROM_ISR( pxQueue )   vTraceRecorderQueue( TRACE_EVENT_QUEUE_RECEIVE, ( pxQueue ), ( pxQueue )->ucQueueType )
+#define traceQUEUE_RECEIVE_FAILED( pxQueue )     vTraceRecorderQueue( TRACE_EVENT_QUEUE_RECEIVE_FAILED, ( pxQueue ), ( pxQueue )->ucQueueType )
+#define traceBLOCKING_ON_QUEUE_SEND( pxQueue )   vTraceRecorderQueue( TRACE_EVENT_QUEUE_BLOCK_SEND, ( pxQueue ), ( pxQueue )->ucQueueType )
+#define traceBLOCKING_ON_QUEUE_RECEIVE( pxQueue ) vTraceRecorderQueue( TRACE_EVENT_QUEUE_BLOCK_RECEIVE, ( pxQueue ), ( pxQueue )->ucQueueType )
+#define traceSTREAM_BUFFER_SEND( xStreamBuffer, xBytesSent )                  vTraceRecorderStream( TRACE_EVENT_STREAM_SEND, ( xStreamBuffer ), ( xBytesSent ) )
+#define traceSTREAM_BUFFER_SEND_FROM_ISR( xStreamBuffer, xBytesSent )         vTraceRecorderStream( TRACE_EVENT_STREAM_SEND, ( xStreamBuffer ), ( xBytesSent ) )
+#define traceSTREAM_BUFFER_RECEIVE( xStreamBuffer, xReceivedLength )          vTraceRecorderStream( TRACE_EVENT_STREAM_RECEIVE, ( xStreamBuffer ), ( xReceivedLength ) )
+#define traceSTREAM_BUFFER_RECEIVE_FROM_ISR( xStreamBuffer, xReceivedLength ) vTraceRecorderStream( TRACE_EVENT_STREAM_RECEIVE, ( xStreamBuffer ), ( xReceivedLength ) )
+#define traceBLOCKING_ON_STREAM_BUFFER_SEND( xStreamBuffer )                  vTraceRecorderStream( TRACE_EVENT_STREAM_BLOCK, ( xStreamBuffer ), 0 )
+#define traceBLOCKING_ON_STREAM_BUFFER_RECEIVE( xStreamBuffer )               vTraceRecorderStream( TRACE_EVENT_STREAM_BLOCK, ( xStreamBuffer ), 1 )
+#endif
+#endif
 /* USER CODE END Defines */
 
 #endif /* FREERTOS_CONFIG_H */
@@ -0,0 +1,77 @@
+/* HttpServer.h
+ *
+ * HTTP/1.1 server of the web UI.
+ *
+ * The UI is a set of prebuilt, gzip-compressed files in a const image which
+ * stays in flash (see Tools/pack_webui.py): responses are sent from the image
+ * itself, never copied to RAM first, and need no file system. Each file has a
+ * strong entity tag computed when the image is built, so a request whose
+ * If-None-Match names it is answered 304 without touching the file, and a
+ * Cache-Control policy: pages are revalidated on each load, the files they
+ * reference are reused for a while without asking.
+ *
+ * Connections are kept alive, up to HTTP_SERVER_MAX_REQUESTS requests, and
+ * one task and one socketPoll() serve at most HTTP_SERVER_MAX_CONNECTIONS
+ * of them. When the table is full, the connection idle for longest is closed
+ * to make room, which browsers keeping spare connections open cope with.
+ * Sockets are written without blocking, so a slow client holds no other.
+ */
+#ifndef INC_HTTPSERVER_H_
+#define INC_HTTPSERVER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* Connections open at once */
+#define HTTP_SERVER_MAX_CONNECTIONS    4
+
+/* Requests on one connection before it is closed */
+#define HTTP_SERVER_MAX_REQUESTS       100u
+
+/* Idle keep-alive connections are closed after this */
+#define HTTP_SERVER_IDLE_TIMEOUT_MS    5000u
+
+/* Largest request head, request line and header fields */
+#define HTTP_SERVER_RX_SIZE            1024u
+
+/* Stack of the task, in words */
+#define HTTP_SERVER_TASK_STACK_SIZE    512
+
+/* One file of the image, always gzip-compressed */
+typedef struct
+{
+    const char *pcPath;             /* "/index.html" */
+    const char *pcContentType;
+    const char *pcCacheControl;
+    const char *pcEtag;             /* Quoted, as sent */
+    const uint8_t *pucData;
+    uint32_t ulLength;
+} HttpAsset_t;
+
+typedef struct
+{
+    uint32_t ulRequests;
+    uint32_t ulOk;
+    uint32_t ulNotModified;
+    uint32_t ulErrors;              /* 4xx responses */
+    uint32_t ulBytesSent;           /* Bodies only */
+    uint32_t ulAccepted;
+    uint32_t ulEvicted;             /* Idle connections closed for a new one */
+} HttpServerStats_t;
+
+/**
+ * @brief  Create the server task.
+ * @param  uxPriority  Task priority.
+ * @param  pxAssets    Image to serve; "/" is served "/index.html".
+ * @param  xCount      Files in the image.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xHttpServerStart(UBaseType_t uxPriority, const HttpAsset_t *pxAssets, size_t xCount);
+
+void vHttpServerGetStats(HttpServerStats_t *pxStats);
+
+/* Register the "http" CLI command */
+void vHttpServerRegisterCLICommands(void);
+
+#endif /* INC_HTTPSERVER_H_ */
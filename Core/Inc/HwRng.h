@@ -0,0 +1,58 @@
+/* HwRng.h
+ *
+ * True random numbers from the RNG peripheral, clocked by the HSI48. A
+ * pool of HW_RNG_POOL_WORDS words is kept full by the RNG interrupt, so
+ * that readers take a word without waiting for the generator: a word
+ * costs a short critical section, from a task or an interrupt. The
+ * interrupt is masked while the pool is full and unmasked once it is half
+ * empty.
+ *
+ * The TCP/IP stack draws from the pool through NET_RAND_SOURCE (net_config.h):
+ * netGetRand(), DNS query IDs, TCP initial sequence numbers, ephemeral
+ * ports and the rest. If the pool runs dry, which takes a burst of more
+ * than HW_RNG_POOL_WORDS words, the word comes from a xorshift generator
+ * keyed by every hardware word, and the draw is counted as a fallback.
+ * Seed and clock errors of the generator are recovered from in the
+ * interrupt and counted.
+ */
+#ifndef INC_HWRNG_H_
+#define INC_HWRNG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Words of the pool; a power of two */
+#define HW_RNG_POOL_WORDS          32u
+
+/* Below the interrupts of the packet path: the refill can wait */
+#define HW_RNG_IRQ_PRIORITY        14
+
+typedef struct
+{
+    uint32_t ulDrawn;           /* Words taken from the pool */
+    uint32_t ulFallbacks;       /* Words taken with the pool empty */
+    uint32_t ulGenerated;       /* Words read from the generator */
+    uint32_t ulSeedErrors;
+    uint32_t ulClockErrors;
+    uint32_t ulLevel;           /* Words in the pool */
+} HwRngStats_t;
+
+/**
+ * @brief  Start the HSI48 and the generator, then wait for the pool to
+ *         fill, a few hundred microseconds. To be called once the system
+ *         clock is set, before the TCP/IP stack starts.
+ */
+void vHwRngInit(void);
+
+/* Random word; never waits */
+uint32_t ulHwRngGet(void);
+
+/* Random bytes; never waits */
+void vHwRngGetData(uint8_t *pucData, size_t xLength);
+
+void vHwRngGetStats(HwRngStats_t *pxStats);
+
+/* Register the "rng" CLI command */
+void vHwRngRegisterCLICommands(void);
+
+#endif /* INC_HWRNG_H_ */
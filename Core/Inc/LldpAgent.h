@@ -0,0 +1,60 @@
+/* LldpAgent.h
+ *
+ * LLDP (IEEE 802.1AB) transmit-only agent, so that the switches of the plant
+ * list this node among their neighbours.
+ *
+ * The LLDPDU is serialized once, into a cache, and every frame is a copy of
+ * it: it is rebuilt only when what it advertises changes, i.e. the host name,
+ * the IPv4 address or the link state. Link changes are signalled by the
+ * stack and answered at once, with LLDP_AGENT_FAST_TX_COUNT frames a second
+ * apart so that the switch learns the node quickly; the host name and the
+ * address are compared with the cached values at each transmission.
+ *
+ * The LLDPDU holds the mandatory TLVs (chassis ID: MAC address, port ID:
+ * interface name, TTL), then the port description, system name, system
+ * description, system capabilities (station only) and the IPv4 management
+ * address.
+ */
+#ifndef INC_LLDPAGENT_H_
+#define INC_LLDPAGENT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* msgTxInterval, in seconds, and msgTxHold: the TTL advertised is their
+   product plus one */
+#define LLDP_AGENT_TX_INTERVAL_S       30u
+#define LLDP_AGENT_TX_HOLD             4u
+
+/* Frames sent a second apart when the link comes up (txFastInit) */
+#define LLDP_AGENT_FAST_TX_COUNT       4u
+
+/* System description TLV */
+#define LLDP_AGENT_SYS_DESCR           "STM32H723 CycloneTCP node"
+
+/* Stack of the task, in words */
+#define LLDP_AGENT_TASK_STACK_SIZE     384
+
+typedef struct
+{
+    uint32_t ulFrames;              /* LLDPDUs sent */
+    uint32_t ulRebuilds;            /* Times the cached LLDPDU was serialized */
+    uint32_t ulTxErrors;
+    uint32_t ulLength;              /* Size of the cached LLDPDU */
+} LldpAgentStats_t;
+
+/**
+ * @brief  Create the agent task.
+ * @param  uxInterface  Index of the interface advertised.
+ * @param  uxPriority   Task priority.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xLldpAgentStart(UBaseType_t uxInterface, UBaseType_t uxPriority);
+
+void vLldpAgentGetStats(LldpAgentStats_t *pxStats);
+
+/* Register the "lldp" CLI command */
+void vLldpAgentRegisterCLICommands(void);
+
+#endif /* INC_LLDPAGENT_H_ */
@@ -0,0 +1,50 @@
+/* LowPower.h
+ *
+ * Tickless idle profile for battery-backed units. With configUSE_TICKLESS_IDLE
+ * the idle task stops the SysTick and sleeps (WFI) until the next task
+ * timeout or interrupt, instead of waking on each of the 1 kHz ticks. The
+ * hooks below run around each sleep: they stop the HAL time base (TIM23,
+ * which would otherwise wake the core every millisecond) and account the
+ * time spent asleep on the microsecond clock.
+ *
+ * The TCP/IP stack takes part with NET_TICKLESS_SUPPORT: its periodic
+ * operations, spread over intervals of 100 ms to 1 s, are gathered into one
+ * deadline for the net task (see netTick()), so that an idle, connected
+ * device only wakes for the link polling (NIC_TICK_INTERVAL) and the
+ * operations that are actually due.
+ *
+ * Network standby goes one step further: the MAC enters its power-down mode
+ * (Wake-on-LAN) and discards every frame but a magic packet or a unicast
+ * frame for the device, the PHY powers down while the cable is unplugged
+ * (EDPD; the LAN8742 has no Energy Efficient Ethernet), and the idle task
+ * enters Stop mode instead of Sleep. The ETH wakeup line brings the MCU back
+ * on the first wakeup frame and the stack resumes normal operation. Kernel
+ * time stands still in Stop mode, so standby is meant for a device that has
+ * nothing to do until contacted, not for one with timeouts running.
+ */
+#ifndef INC_LOWPOWER_H_
+#define INC_LOWPOWER_H_
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* configPRE_SLEEP_PROCESSING: called with interrupts disabled */
+void vLowPowerPreSleep(uint32_t *pulExpectedIdleTime);
+
+/* configPOST_SLEEP_PROCESSING: called on wakeup, interrupts still disabled */
+void vLowPowerPostSleep(uint32_t ulExpectedIdleTime);
+
+/* Enter network standby, ulEvents being a mask of STM32H7XX_ETH_WAKEUP_*;
+ * pdFAIL if Wake-on-LAN is not built in or standby is already on */
+BaseType_t xLowPowerEnterNetStandby(uint32_t ulEvents);
+
+/* Leave network standby before any wakeup frame */
+void vLowPowerExitNetStandby(void);
+
+/* pdTRUE while the MAC waits for a wakeup frame */
+BaseType_t xLowPowerIsNetStandby(void);
+
+/* Register the "lowpower" CLI command */
+void vLowPowerRegisterCLICommands(void);
+
+#endif /* INC_LOWPOWER_H_ */
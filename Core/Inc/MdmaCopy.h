@@ -0,0 +1,78 @@
+/* MdmaCopy.h
+ *
+ * Memory-to-memory copies on the MDMA. A copy of MDMA_COPY_MIN_LENGTH bytes
+ * or more is handed to the MDMA, which moves it while the core does other
+ * work: the unaligned head and tail of the destination, at most a cache line
+ * each, are copied by the CPU, the source is cleaned from the D-cache and the
+ * destination invalidated around the transfer. Shorter copies, and copies
+ * that find the MDMA busy with another one, are done by the CPU before the
+ * call returns. The MDMA reaches every RAM, the TCMs included.
+ *
+ * xMdmaCopyStart() returns at once and calls back from the MDMA interrupt.
+ * vMdmaCopy() blocks the calling task until the copy is done, so that other
+ * tasks run meanwhile; it is what the TCP/IP stack uses for its bulk copies
+ * (NET_BULK_COPY in net_config.h: socket buffers, driver TX). Waiting costs a
+ * task switch, which the CPU outruns below MDMA_COPY_BLOCK_LENGTH bytes, and
+ * it is not possible from an interrupt, with the interrupts masked or before
+ * the scheduler starts: the CPU copies then.
+ */
+#ifndef INC_MDMACOPY_H_
+#define INC_MDMACOPY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* Shortest copy given to the MDMA by xMdmaCopyStart() */
+#define MDMA_COPY_MIN_LENGTH           512u
+
+/* Shortest copy vMdmaCopy() waits for */
+#define MDMA_COPY_BLOCK_LENGTH         4096u
+
+/* Longest transfer, one block of the MDMA; vMdmaCopy() splits longer ones */
+#define MDMA_COPY_MAX_LENGTH           65536u
+
+/* Longest wait of vMdmaCopy() for a transfer, in milliseconds; the CPU
+ * then cancels it and copies */
+#define MDMA_COPY_TIMEOUT_MS           10u
+
+/* Below the interrupts of the packet path */
+#define MDMA_COPY_IRQ_PRIORITY         6
+
+/* Completion of a copy, called from the MDMA interrupt */
+typedef void (*MdmaCopyCallback_t)(void *pvContext);
+
+typedef struct
+{
+    uint32_t ulDmaCopies;       /* Copies moved by the MDMA */
+    uint32_t ulDmaBytes;
+    uint32_t ulCpuCopies;       /* Copies done by the CPU */
+    uint32_t ulCpuBytes;
+    uint32_t ulBusy;            /* Copies that found the MDMA busy */
+    uint32_t ulErrors;          /* Transfer errors, the CPU copied instead */
+    uint32_t ulTimeouts;        /* Transfers cancelled by vMdmaCopy() */
+} MdmaCopyStats_t;
+
+/* Configure the channels; to be called before the TCP/IP stack starts */
+void vMdmaCopyInit(void);
+
+/**
+ * @brief  Start a copy; from a task, or an interrupt up to
+ *         configMAX_SYSCALL_INTERRUPT_PRIORITY.
+ * @param  pxCallback  Called once the MDMA is done, NULL for none.
+ * @return pdTRUE if the MDMA moves the data: neither buffer may be touched
+ *         until the callback. pdFALSE if the CPU has copied it already; the
+ *         callback is not called.
+ */
+BaseType_t xMdmaCopyStart(void *pvDest, const void *pvSrc, size_t xLength,
+                          MdmaCopyCallback_t pxCallback, void *pvContext);
+
+/* Copy, waiting for the MDMA if the copy is long enough; a memcpy() otherwise */
+void vMdmaCopy(void *pvDest, const void *pvSrc, size_t xLength);
+
+void vMdmaCopyGetStats(MdmaCopyStats_t *pxStats);
+
+/* Register the "mdma" CLI command */
+void vMdmaCopyRegisterCLICommands(void);
+
+#endif /* INC_MDMACOPY_H_ */
@@ -0,0 +1,99 @@
+/* MemTag.h
+ *
+ * Allocation accounting per subsystem, to find which one grows.
+ *
+ * Every allocation of osAllocMem(), of the network memory pool
+ * (memPoolAlloc(), netBufferAlloc() and the buffer allocators built on it),
+ * of the libudpard pools and of the console output sinks is charged to a
+ * tag: the subsystem that asked for the memory. A tag holds the bytes live,
+ * their peak, and the allocations, frees and failures counted since boot.
+ *
+ * The tag of a call site comes from its source file, looked up the first
+ * time the site allocates and cached in a static byte of the site
+ * (MEM_TAG_SITE()): tcp*.c are charged to "tcp", dns*.c, mdns*.c to "dns",
+ * the rest of CycloneTCP to "net", and so on. The buffer allocators of the
+ * stack pass the tag of their caller down, and a network buffer that grows
+ * charges its new chunks to the tag of its first block, so that a datagram
+ * built by the DNS client counts against "dns" rather than against the IP
+ * layer.
+ *
+ * osAllocMem() blocks start with a header of MEM_TAG_HEADER_SIZE bytes
+ * holding the tag and the size, which osFreeMem() credits back; pool
+ * blocks keep their tag in a table beside the pool.
+ */
+#ifndef INC_MEMTAG_H_
+#define INC_MEMTAG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* 1 to charge allocations to their subsystem, 0 to leave them untagged */
+#define MEM_TAG_SUPPORT                1
+
+/* Header in front of each osAllocMem() block; keeps the 8-byte alignment */
+#define MEM_TAG_HEADER_SIZE            8u
+
+typedef enum
+{
+    eMemTagOther = 0,
+    eMemTagNet,                 /* IP, ARP, NIC and the rest of CycloneTCP */
+    eMemTagTcp,
+    eMemTagUdp,
+    eMemTagDns,                 /* DNS, mDNS, NBNS, LLMNR */
+    eMemTagHttp,                /* HTTP server and client, WebSocket */
+    eMemTagTls,
+    eMemTagUdpard,              /* libudpard pools of the Cyphal node */
+    eMemTagCli,                 /* Console output sinks */
+    eMemTagCount
+} MemTag_t;
+
+/* Tag of a call site not looked up yet */
+#define MEM_TAG_UNRESOLVED             0xFFu
+
+/* Tag of the calling source file, looked up once per call site */
+#define MEM_TAG_SITE()                                                   \
+    __extension__ ({                                                     \
+        static uint8_t ucMemTagSite = MEM_TAG_UNRESOLVED;                \
+        if (ucMemTagSite == MEM_TAG_UNRESOLVED)                          \
+        {                                                                \
+            ucMemTagSite = ucMemTagOfFile(__FILE__);                     \
+        }                                                                \
+        ucMemTagSite;                                                    \
+    })
+
+typedef struct
+{
+    size_t xLive;               /* Bytes allocated and not freed yet */
+    size_t xPeak;               /* Highest xLive since boot */
+    uint32_t ulAllocs;
+    uint32_t ulFrees;
+    uint32_t ulFailures;        /* Allocations refused */
+} MemTagStats_t;
+
+/* Tag of a source file path (__FILE__) */
+uint8_t ucMemTagOfFile(const char *pcPath);
+
+const char *pcMemTagName(uint8_t ucTag);
+
+/* Count an allocation of xBytes, its release, or a refused allocation.
+   Task or interrupt context */
+void vMemTagCharge(uint8_t ucTag, size_t xBytes);
+void vMemTagCredit(uint8_t ucTag, size_t xBytes);
+void vMemTagFailure(uint8_t ucTag);
+
+void vMemTagGetStats(uint8_t ucTag, MemTagStats_t *pxStats);
+
+/**
+ * @brief  osAllocMem() charged to ucTag; osAllocMem() expands to it with
+ *         the tag of the call site. Freed by osFreeMem().
+ * @return The block, or NULL if the heap has no room.
+ */
+void *osAllocMemTagged(size_t size, uint8_t ucTag);
+
+/* Tag of a block returned by osAllocMemTagged() */
+uint8_t ucMemTagOfBlock(const void *pv);
+
+/* Register the "memtags" CLI command */
+void vMemTagRegisterCLICommands(void);
+
+#endif /* INC_MEMTAG_H_ */
@@ -0,0 +1,48 @@
+/* MemoryLayout.h
+ *
+ * Memory attributes of the Cortex-M7, set before any peripheral is started.
+ * The instruction and data caches are enabled, and the MPU maps the AXI SRAM
+ * and the D2 and D3 SRAMs as normal memory, write-back with read and write
+ * allocation. The first MEMORY_NO_CACHE_SIZE bytes of the D2 SRAM are left
+ * out of the data cache: the linker scripts place the ".ram_no_cache" section
+ * there, which holds what a DMA controller and the CPU share at a finer grain
+ * than a cache line, the Ethernet descriptor rings and the circular buffer of
+ * the UART receive DMA. The other DMA buffers stay cacheable and are
+ * maintained by their drivers (STM32H7XX_ETH_CACHE_MAINTENANCE, the UART
+ * transmit path).
+ *
+ * The MPU regions are read back at boot, along with the cache state and the
+ * bounds of the section; the "memmap" command reports them.
+ */
+#ifndef INC_MEMORYLAYOUT_H_
+#define INC_MEMORYLAYOUT_H_
+
+#include "FreeRTOS.h"
+
+/* Non-cacheable region, as in the linker scripts (RAM_D2_NC). The size is a
+ * power of two and the base a multiple of it, as the MPU requires */
+#define MEMORY_NO_CACHE_BASE           0x30000000u
+#define MEMORY_NO_CACHE_SIZE           (2u * 1024u)
+
+/* Section of the linker scripts */
+#define MEMORY_NO_CACHE_SECTION        ".ram_no_cache"
+
+/* Data shared with a DMA controller without cache maintenance */
+#define MEMORY_NO_CACHE                __attribute__((section(MEMORY_NO_CACHE_SECTION), aligned(32)))
+
+/**
+ * @brief  Program the MPU regions, then enable the instruction and data caches.
+ *         Called once, after MPU_Config() and before any DMA is started.
+ */
+void vMemoryLayoutInit(void);
+
+/**
+ * @brief  Check the MPU regions, the caches and the non-cacheable section.
+ * @return pdPASS if the layout is as described above, pdFAIL otherwise.
+ */
+BaseType_t xMemoryLayoutCheck(void);
+
+/* Register the "memmap" CLI command */
+void vMemoryLayoutRegisterCLICommands(void);
+
+#endif /* INC_MEMORYLAYOUT_H_ */
@@ -0,0 +1,62 @@
+/* MicroBench.h
+ *
+ * On-target micro-benchmarks of the primitives the firmware is built on,
+ * to characterize a hardware revision or a build configuration from the
+ * console: memory copies between the RAMs, the Internet checksum, the
+ * network buffer pool, the Cyphal/UDP CRC and serialization, stream
+ * buffers, the scheduler, and the telemetry encoder (TelemetryEncoder.h).
+ *
+ * Every figure is a count of DWT cycles (started by RunTimeStats) over
+ * MICRO_BENCH_RUNS runs; the minimum shows the cost of the code, the
+ * average and the maximum what interrupts and other tasks add. The copies,
+ * the checksums and the CRC run with interrupts masked; the copies start
+ * with both buffers evicted from the data cache, so that they show the
+ * memories rather than the cache. The allocator, libudpard and the kernel
+ * objects run with interrupts enabled, as they require.
+ *
+ * The buffers come from the region heaps (RegionHeap.h) for the DTCM, the
+ * AXI SRAM and the D3 SRAM, from the top of the ITCM above the code, and
+ * from a static block of the non-cacheable section. The cacheable D2 SRAM is
+ * taken whole by the large TCP buffers and the capture ring, so it is only
+ * read, from the start of the region.
+ *
+ * "bench [group]" prints one CSV line per measurement, after a comment line
+ * giving the core clock, the device revision and the build options:
+ *   bench,<group>,<test>,<bytes>,<runs>,<min>,<avg>,<max>,<min ns>,<MB/s>
+ * A test that cannot run (e.g. no room left in a heap) reports 0 runs.
+ */
+#ifndef INC_MICROBENCH_H_
+#define INC_MICROBENCH_H_
+
+#include "FreeRTOS.h"
+
+/* Runs of each measurement */
+#define MICRO_BENCH_RUNS               32u
+
+/* Bytes per copy */
+#define MICRO_BENCH_COPY_SIZE          512u
+
+/* Checksum lengths: a minimal segment and a full UDP payload */
+#define MICRO_BENCH_SHORT_SIZE         64u
+#define MICRO_BENCH_LONG_SIZE          1472u
+
+/* Stream buffer of the throughput test, and bytes moved per run */
+#define MICRO_BENCH_STREAM_SIZE        256u
+#define MICRO_BENCH_STREAM_BYTES       1024u
+
+/* Status document of the telemetry encoding: maps of ten fields, and the
+ * buffer it is written to */
+#define MICRO_BENCH_TELEMETRY_GROUPS   20u
+#define MICRO_BENCH_TELEMETRY_SIZE     8192u
+
+/* Start of the D2 SRAM past the non-cacheable block (RAM_D2 in the linker
+ * scripts) */
+#define MICRO_BENCH_D2_BASE            0x30000800u
+
+/* Stack of the task answering the scheduler tests, in words */
+#define MICRO_BENCH_HELPER_STACK_SIZE  128
+
+/* Register the "bench" CLI command */
+void vMicroBenchRegisterCLICommands(void);
+
+#endif /* INC_MICROBENCH_H_ */
@@ -0,0 +1,149 @@
+/* ModbusClient.h
+ *
+ * Modbus/TCP client polling the meters, drives and remote I/O of the cell.
+ *
+ * The application declares its devices and, for each of them, the register
+ * ranges to read and how often. Ranges of a device in the same table and at
+ * the same period are merged into one request when they are contiguous or
+ * separated by at most MODBUS_CLIENT_MAX_GAP addresses, up to the largest
+ * quantity of a read: ten polls of neighbouring registers cost one
+ * transaction. The due times of the requests are spread over their period,
+ * so that the devices are not all polled in the same tick.
+ *
+ * One task and one socketPoll() serve every connection. Requests are not
+ * sent one round trip at a time: up to the pipeline depth of a device are
+ * outstanding at once, matched to their responses by transaction
+ * identifier, and devices behind the same address and port (units of a
+ * gateway) share one connection. Connections are opened without blocking;
+ * when there are more endpoints than MODBUS_CLIENT_MAX_CONNECTIONS, the
+ * connection idle for longest is closed to make room.
+ *
+ * Data is written to the destination of each poll, then its callback is
+ * called, in the client task. Single reads and writes can also be made from
+ * any task; they go before the polls and block until their response, the
+ * timeout, or the failure of the connection.
+ */
+#ifndef INC_MODBUSCLIENT_H_
+#define INC_MODBUSCLIENT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* Devices, polls and merged requests declared at once */
+#define MODBUS_CLIENT_MAX_DEVICES      64
+#define MODBUS_CLIENT_MAX_POLLS        128
+#define MODBUS_CLIENT_MAX_REQUESTS     128
+
+/* Connections open at once, each with up to this many outstanding requests */
+#define MODBUS_CLIENT_MAX_CONNECTIONS  16
+#define MODBUS_CLIENT_MAX_OUTSTANDING  8
+
+/* Default number of outstanding requests per device; 1 for devices which
+   only handle one transaction at a time */
+#define MODBUS_CLIENT_PIPELINE         4u
+
+/* Addresses read and discarded to merge two polls into one request */
+#define MODBUS_CLIENT_MAX_GAP          8u
+
+/* Single reads and writes queued at once */
+#define MODBUS_CLIENT_MAX_TRANSFERS    4
+
+/* Wait for a response, and for a connection to be established */
+#define MODBUS_CLIENT_TIMEOUT_MS       500u
+#define MODBUS_CLIENT_CONNECT_MS       1000u
+
+/* Consecutive timeouts before a device is deemed offline */
+#define MODBUS_CLIENT_MAX_TIMEOUTS     3u
+
+/* Delay before polling an offline device, or one whose connection failed */
+#define MODBUS_CLIENT_RETRY_MS         5000u
+
+/* A device not reading its requests for this long is dropped */
+#define MODBUS_CLIENT_SEND_TIMEOUT_MS  100u
+
+/* Stack of the task, in words; poll callbacks run on it */
+#define MODBUS_CLIENT_TASK_STACK_SIZE  768
+
+/* Status of a poll or transfer: 0, a Modbus exception code, or one of these */
+#define MODBUS_CLIENT_OK               0x000u
+#define MODBUS_CLIENT_TIMEOUT          0x100u
+#define MODBUS_CLIENT_NO_CONNECTION    0x101u
+#define MODBUS_CLIENT_BAD_RESPONSE     0x102u
+
+typedef enum
+{
+    eModbusCoils = 0,
+    eModbusDiscreteInputs,
+    eModbusHoldingRegs,
+    eModbusInputRegs
+} ModbusTable_t;
+
+/* Called in the client task after each poll, the data copied on success */
+typedef void (*ModbusPollCallback_t)(void *pvContext, uint32_t ulStatus);
+
+typedef struct
+{
+    uint32_t ulRequests;            /* Requests sent */
+    uint32_t ulResponses;           /* Responses matched to their request */
+    uint32_t ulExceptions;          /* Responses with an exception code */
+    uint32_t ulTimeouts;
+    uint32_t ulOverruns;            /* Polls due while still outstanding */
+    uint32_t ulMaxLatencyMs;        /* Longest time to a response */
+    uint32_t ulTotalLatencyMs;
+} ModbusClientStats_t;
+
+/**
+ * @brief  Create the client task.
+ * @param  uxPriority  Task priority.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xModbusClientStart(UBaseType_t uxPriority);
+
+/**
+ * @brief  Declare a device.
+ * @param  pcAddress   IPv4 address, as text.
+ * @param  usPort      TCP port, 0 for the Modbus/TCP port.
+ * @param  ucUnitId    Unit identifier, for devices behind a gateway.
+ * @param  ucPipeline  Outstanding requests at once, 0 for MODBUS_CLIENT_PIPELINE.
+ * @return Index of the device, or -1 if the address is invalid or the table full.
+ */
+int32_t lModbusClientAddDevice(const char *pcAddress, uint16_t usPort, uint8_t ucUnitId, uint8_t ucPipeline);
+
+/**
+ * @brief  Read a range of a device periodically.
+ * @param  lDevice     Index from lModbusClientAddDevice().
+ * @param  eTable      Table to read.
+ * @param  usAddress   First address.
+ * @param  usCount     Quantity: up to 125 registers or 2000 bits.
+ * @param  ulPeriodMs  Interval between two reads.
+ * @param  pvDest      usCount uint16_t registers, or bits packed eight per
+ *                     byte (the first in bit 0); NULL to only call the callback.
+ * @param  pxCallback  Called after each read, may be NULL.
+ * @param  pvContext   Passed to the callback.
+ * @return pdPASS on success, pdFAIL if a parameter is invalid or the table full.
+ */
+BaseType_t xModbusClientAddPoll(int32_t lDevice, ModbusTable_t eTable, uint16_t usAddress, uint16_t usCount,
+                                uint32_t ulPeriodMs, void *pvDest, ModbusPollCallback_t pxCallback, void *pvContext);
+
+/**
+ * @brief  Read a range once, blocking.
+ * @param  pvDest  As for xModbusClientAddPoll().
+ * @return MODBUS_CLIENT_OK, an exception code or a MODBUS_CLIENT_ error.
+ */
+uint32_t ulModbusClientRead(int32_t lDevice, ModbusTable_t eTable, uint16_t usAddress, uint16_t usCount,
+                            void *pvDest);
+
+/* Write holding registers (function 6 for one, 16 for more), blocking */
+uint32_t ulModbusClientWriteRegs(int32_t lDevice, uint16_t usAddress, const uint16_t *pusValues, uint16_t usCount);
+
+/* Write a coil (function 5), blocking */
+uint32_t ulModbusClientWriteCoil(int32_t lDevice, uint16_t usAddress, BaseType_t xValue);
+
+/* Counters of a device; pdFAIL if there is no such device */
+BaseType_t xModbusClientGetStats(int32_t lDevice, ModbusClientStats_t *pxStats);
+
+/* Register the "modbusc" CLI command */
+void vModbusClientRegisterCLICommands(void);
+
+#endif /* INC_MODBUSCLIENT_H_ */
@@ -0,0 +1,105 @@
+/* ModbusRtuGateway.h
+ *
+ * Modbus/TCP to Modbus RTU gateway, for the devices of the cell on the
+ * RS-485 bus of USART6.
+ *
+ * Masters connect on MODBUS_RTU_GATEWAY_PORT; the unit identifier of each
+ * request is the address of the RTU slave (1 to 247). One task owns the
+ * connections, through ModbusTcp.h as the server does, and hands the
+ * requests to the bus task; the bus task keeps a queue per slave and
+ * serves the slaves with requests in turn, so that one master polling a
+ * device heavily does not hold back the others. A slave which stopped answering is deemed offline
+ * after MODBUS_RTU_GATEWAY_MAX_FAILURES requests in a row were left without
+ * a valid response: its requests are then answered at once with exception
+ * 11 (gateway target device failed to respond) until a new attempt after
+ * MODBUS_RTU_GATEWAY_RETRY_MS.
+ *
+ * The frame timing is in the hardware: the receiver timeout of the USART
+ * (RTOF) signals the end of a response after t3.5 of silence, the driver
+ * enable output of the USART switches the transceiver, and the RX DMA runs
+ * on a circular buffer; the bus task sleeps until the response is complete
+ * and no software timer is involved in the framing.
+ *
+ * Responses to reads (functions 1 to 4) are kept for
+ * MODBUS_RTU_GATEWAY_CACHE_MS: a range polled by several masters is read
+ * once from the bus in that interval. A write to a slave empties its entries, and reads of a slave
+ * with writes outstanding always go to the bus.
+ */
+#ifndef INC_MODBUSRTUGATEWAY_H_
+#define INC_MODBUSRTUGATEWAY_H_
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* TCP port of the gateway; the Modbus/TCP port is that of ModbusServer.c */
+#define MODBUS_RTU_GATEWAY_PORT             5020u
+
+/* Masters connected at once */
+#define MODBUS_RTU_GATEWAY_MAX_CONNECTIONS  4
+
+/* Requests queued for the bus at once, all slaves together */
+#define MODBUS_RTU_GATEWAY_MAX_REQUESTS     16
+
+/* RS-485 line: 8 data bits, even parity, 1 stop bit (Modbus default).
+ * USART6: PG14 TX, PG9 RX, PG8 DE */
+#define MODBUS_RTU_GATEWAY_BAUD_RATE        19200u
+
+/* Wait for the first byte of a response, after the end of the request */
+#define MODBUS_RTU_GATEWAY_RESPONSE_TIMEOUT_MS  200u
+
+/* Sends of a request without a valid response before exception 11 */
+#define MODBUS_RTU_GATEWAY_ATTEMPTS         2u
+
+/* Requests without a valid response before a slave is deemed offline, and
+ * the delay before it is tried again */
+#define MODBUS_RTU_GATEWAY_MAX_FAILURES     3u
+#define MODBUS_RTU_GATEWAY_RETRY_MS         5000u
+
+/* Read responses kept, and for how long; a lifetime of 0 disables the
+ * cache */
+#define MODBUS_RTU_GATEWAY_CACHE_ENTRIES    16
+#define MODBUS_RTU_GATEWAY_CACHE_MS         250u
+
+/* A connection silent for this long is closed */
+#define MODBUS_RTU_GATEWAY_IDLE_TIMEOUT_MS  60000u
+
+/* A master not reading its responses for this long is dropped */
+#define MODBUS_RTU_GATEWAY_SEND_TIMEOUT_MS  100u
+
+#define MODBUS_RTU_GATEWAY_IRQ_PRIORITY     5
+
+/* Stacks of the two tasks, in words */
+#define MODBUS_RTU_GATEWAY_TASK_STACK_SIZE  512
+
+typedef struct
+{
+    uint32_t ulRequests;            /* Received from the masters */
+    uint32_t ulCacheHits;           /* Answered from the cache */
+    uint32_t ulForwarded;           /* Requests handed to the bus task */
+    uint32_t ulTransactions;        /* Requests sent on the bus, retries included */
+    uint32_t ulTimeouts;            /* Sends without a response */
+    uint32_t ulBadFrames;           /* Responses with a bad CRC, slave or function */
+    uint32_t ulExceptions;          /* Exceptions from the slaves */
+    uint32_t ulOffline;             /* Answered 11 for an offline slave */
+    uint32_t ulStale;               /* Responses for a closed connection */
+    uint32_t ulLineErrors;          /* USART framing, noise, parity and overrun */
+    uint32_t ulMaxBusUs;            /* Longest transaction on the bus, from the */
+    uint64_t ullTotalBusUs;         /* start of the request to its response */
+    uint32_t ulMaxTurnaroundUs;     /* Longest time from the reception of a */
+    uint64_t ullTotalTurnaroundUs;  /* forwarded request to its response */
+} ModbusRtuGatewayStats_t;
+
+/**
+ * @brief  Set up USART6 and create the connection and bus tasks.
+ * @param  uxPriority  Priority of the connection task; the bus task runs
+ *                     one above.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xModbusRtuGatewayStart(UBaseType_t uxPriority);
+
+void vModbusRtuGatewayGetStats(ModbusRtuGatewayStats_t *pxStats);
+
+/* Register the "modbusgw" CLI command */
+void vModbusRtuGatewayRegisterCLICommands(void);
+
+#endif /* INC_MODBUSRTUGATEWAY_H_ */
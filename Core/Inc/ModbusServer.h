@@ -0,0 +1,88 @@
+/* ModbusServer.h
+ *
+ * Modbus/TCP server for the PLCs and SCADA masters of the cell.
+ *
+ * One task serves up to MODBUS_SERVER_MAX_CONNECTIONS masters at once: it
+ * waits on the listening socket and every connection in a single
+ * socketPoll(), and answers each request as soon as it is complete, so a
+ * slow or idle master never delays the others. Pipelined requests are all
+ * answered, in order, from one wake-up. When the table is full, a new
+ * connection replaces the one idle for longest, as the Modbus/TCP
+ * implementation guide recommends.
+ *
+ * The registers are served from a snapshot of the application data kept in
+ * two copies: the application fills the copy not in use and then publishes
+ * it by bumping a sequence number (as MonoClock.c does for its reference),
+ * so reads take no lock and never wait for the application; a read which
+ * overlapped a publication is simply copied again. Writes from a master go
+ * through the same update path, then the write callback tells the
+ * application which registers changed.
+ *
+ * Supported functions: 1, 2, 3, 4, 5, 6, 15 and 16, for any unit identifier.
+ * The time from the reception of a request to the sending of its response
+ * is recorded per function code.
+ */
+#ifndef INC_MODBUSSERVER_H_
+#define INC_MODBUSSERVER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* Masters connected at once */
+#define MODBUS_SERVER_MAX_CONNECTIONS  8
+
+/* Size of each table of the register map */
+#define MODBUS_SERVER_COILS            256u
+#define MODBUS_SERVER_DISCRETE_INPUTS  256u
+#define MODBUS_SERVER_HOLDING_REGS     256u
+#define MODBUS_SERVER_INPUT_REGS       256u
+
+/* A connection silent for this long is closed */
+#define MODBUS_SERVER_IDLE_TIMEOUT_MS  60000u
+
+/* A master not reading its responses for this long is dropped */
+#define MODBUS_SERVER_SEND_TIMEOUT_MS  100u
+
+/* Stack of the task, in words */
+#define MODBUS_SERVER_TASK_STACK_SIZE  512
+
+/* Register map; bits are packed eight per byte, address 0 in bit 0 */
+typedef struct
+{
+    uint8_t ucCoils[(MODBUS_SERVER_COILS + 7u) / 8u];
+    uint8_t ucDiscreteInputs[(MODBUS_SERVER_DISCRETE_INPUTS + 7u) / 8u];
+    uint16_t usHoldingRegs[MODBUS_SERVER_HOLDING_REGS];
+    uint16_t usInputRegs[MODBUS_SERVER_INPUT_REGS];
+} ModbusRegisterMap_t;
+
+/* Called in the server task once a master changed coils (function 5 or 15)
+   or holding registers (function 6 or 16) */
+typedef void (*ModbusWriteCallback_t)(uint8_t ucFunction, uint16_t usAddress, uint16_t usCount);
+
+/**
+ * @brief  Create the server task, listening on the Modbus/TCP port.
+ * @param  uxPriority  Task priority.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xModbusServerStart(UBaseType_t uxPriority);
+
+/**
+ * @brief  Start changing the register map. Updates are serialized: the
+ *         caller holds the map until vModbusServerCommitUpdate().
+ * @return The copy to change, holding the values currently served.
+ */
+ModbusRegisterMap_t *pxModbusServerBeginUpdate(void);
+
+/* Serve the map changed since pxModbusServerBeginUpdate() */
+void vModbusServerCommitUpdate(void);
+
+/* Copy of the map currently served, lock-free */
+void vModbusServerReadMap(ModbusRegisterMap_t *pxMap);
+
+void vModbusServerSetWriteCallback(ModbusWriteCallback_t pxCallback);
+
+/* Register the "modbus" CLI command */
+void vModbusServerRegisterCLICommands(void);
+
+#endif /* INC_MODBUSSERVER_H_ */
@@ -0,0 +1,128 @@
+/* ModbusTcp.h
+ *
+ * Modbus/TCP framing shared by the server (ModbusServer.h), the client
+ * (ModbusClient.h) and the RTU gateway (ModbusRtuGateway.h), and the
+ * connection handling of the two which accept masters.
+ *
+ * A ModbusTcpServer_t holds a listening socket and a table of connections,
+ * all owned by one task. The task adds the listener and the connections to
+ * its socketPoll() with uxModbusTcpPollSet(), and hands the result to
+ * vModbusTcpPollDone(): new connections are accepted, replacing the one
+ * idle for longest when the table is full, and the data received is cut
+ * into requests, each passed whole, MBAP header included, to the request
+ * handler. A handler which cannot take a request yet leaves it in the
+ * buffer: vModbusTcpProcess() hands it over again later, and the
+ * connection is left out of the poll while its buffer is full, so that TCP
+ * flow control holds the master back.
+ */
+#ifndef INC_MODBUSTCP_H_
+#define INC_MODBUSTCP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "core/net.h"
+#include "core/socket.h"
+#include "modbus/modbus_common.h"
+
+/* Size of the MBAP header, unit identifier included */
+#define MODBUS_MBAP_SIZE               7u
+
+/* Largest quantity of each request, from the Modbus application protocol */
+#define MODBUS_MAX_READ_BITS           2000u
+#define MODBUS_MAX_READ_REGS           125u
+#define MODBUS_MAX_WRITE_BITS          1968u
+#define MODBUS_MAX_WRITE_REGS          123u
+
+#define MODBUS_READ16(p)               ((uint16_t) (((uint16_t) (p)[0] << 8) | (p)[1]))
+
+/* Returned by xModbusTcpFrameSize() for an invalid header */
+#define MODBUS_TCP_BAD_FRAME           ((size_t) -1)
+
+typedef enum
+{
+    eModbusTcpTaken = 0,            /* Answered, or queued for an answer */
+    eModbusTcpLater,                /* Left in the buffer for the next call */
+    eModbusTcpDrop                  /* The connection is to be closed */
+} ModbusTcpResult_t;
+
+typedef struct
+{
+    Socket *pxSocket;               /* NULL for a free entry */
+    IpAddr xPeer;
+    uint16_t usPeerPort;
+    uint16_t usGeneration;          /* Changed at each accept */
+    systime_t xLastActivity;
+    uint64_t ullRxUs;               /* Last reception */
+    size_t xRxUsed;
+    uint8_t ucRx[2u * MODBUS_MAX_ADU_SIZE];
+} ModbusTcpConnection_t;
+
+/* One complete request: MBAP header, then xPduLength bytes of PDU. xMore
+ * tells whether the header of another request follows in the buffer */
+typedef ModbusTcpResult_t (*ModbusTcpHandler_t)(ModbusTcpConnection_t *pxConnection, const uint8_t *pucFrame,
+                                                size_t xPduLength, BaseType_t xMore);
+
+typedef struct
+{
+    /* Set by the owner before xModbusTcpListen() */
+    ModbusTcpConnection_t *pxConnections;
+    UBaseType_t uxMaxConnections;
+    systime_t xIdleTimeoutMs;       /* A connection silent for this long is closed */
+    systime_t xSendTimeoutMs;       /* A master not reading its responses is dropped */
+    ModbusTcpHandler_t pxHandler;
+
+    Socket *pxListener;
+    uint16_t usGeneration;
+    uint32_t ulAccepted;
+    uint32_t ulEvicted;
+    uint32_t ulIdleClosed;
+    uint32_t ulFramingErrors;
+} ModbusTcpServer_t;
+
+/**
+ * @brief  Open the listening socket.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xModbusTcpListen(ModbusTcpServer_t *pxServer, uint16_t usPort);
+
+/**
+ * @brief  Fill the events of a socketPoll(): the listener first, then the
+ *         connections, unless xReceive is pdFALSE.
+ * @param  pxEvents   Room for 1 + uxMaxConnections events.
+ * @param  ppxOwners  Connection of each event, NULL for the listener.
+ * @return Number of events.
+ */
+UBaseType_t uxModbusTcpPollSet(ModbusTcpServer_t *pxServer, SocketEventDesc *pxEvents,
+                               ModbusTcpConnection_t **ppxOwners, BaseType_t xReceive);
+
+/* Receive on the connections and accept on the listener as polled, once
+ * socketPoll() succeeded */
+void vModbusTcpPollDone(ModbusTcpServer_t *pxServer, const SocketEventDesc *pxEvents,
+                        ModbusTcpConnection_t * const *ppxOwners, UBaseType_t uxCount);
+
+/* Hand the complete requests of the buffer to the handler, closing the
+ * connection if it asks to or if a header is invalid */
+void vModbusTcpProcess(ModbusTcpServer_t *pxServer, ModbusTcpConnection_t *pxConnection);
+
+/* Close the connections silent for longer than xIdleTimeoutMs */
+void vModbusTcpCloseIdle(ModbusTcpServer_t *pxServer);
+
+void vModbusTcpClose(ModbusTcpConnection_t *pxConnection);
+
+/* Number of connections open */
+UBaseType_t uxModbusTcpConnections(const ModbusTcpServer_t *pxServer);
+
+/* Write the MBAP header in front of the xPduLength bytes of PDU at
+ * pucAdu + MODBUS_MBAP_SIZE */
+void vModbusTcpWriteMbap(uint8_t *pucAdu, uint16_t usTransaction, uint8_t ucUnit, size_t xPduLength);
+
+/**
+ * @brief  Check the MBAP header at the start of pucData.
+ * @param  xMinPdu  Shortest PDU accepted.
+ * @return Size of the frame, 0 while it is not complete, or
+ *         MODBUS_TCP_BAD_FRAME if the header is invalid.
+ */
+size_t xModbusTcpFrameSize(const uint8_t *pucData, size_t xAvailable, size_t xMinPdu);
+
+#endif /* INC_MODBUSTCP_H_ */
@@ -0,0 +1,58 @@
+/* MonoClock.h */
+#ifndef INC_MONOCLOCK_H_
+#define INC_MONOCLOCK_H_
+
+#include <stdint.h>
+
+/* Rate of the clock */
+#define MONO_CLOCK_HZ              1000000u
+
+/* Priority of the TIM5 update interrupt. It calls no FreeRTOS API, and must
+ * not be preempted between clearing the update flag and counting the wrap,
+ * so it is the highest one */
+#define MONO_CLOCK_IRQ_PRIORITY    0
+
+/**
+ * @brief  Start TIM5 as a free running MONO_CLOCK_HZ counter. To be called
+ *         once the clocks are configured, before the scheduler starts; the
+ *         clock reads 0 until then.
+ */
+void vMonoClockInit(void);
+
+/**
+ * @brief  Microseconds since vMonoClockInit(): monotonic over 64 bits and
+ *         lock-free, so usable from any task, interrupt or critical section.
+ */
+uint64_t ullMonoClockNowUs(void);
+
+/**
+ * @brief  Map the clock onto a reference timescale, e.g. the PTP time: at
+ *         local time ullLocalUs the reference read ullReferenceUs, and it
+ *         runs lRatePpb parts per billion faster than the local clock.
+ *         Callers are serialized, but should agree on who owns the map (the
+ *         PTP slave when locked, else the SNTP client).
+ */
+void vMonoClockSetReference(uint64_t ullLocalUs, uint64_t ullReferenceUs, int32_t lRatePpb);
+
+/* Forget the reference timescale, e.g. when synchronization is lost */
+void vMonoClockClearReference(void);
+
+/**
+ * @brief  Reference time of a local time (e.g. the receive time of a
+ *         frame), lock-free like ullMonoClockNowUs().
+ * @return The reference time in microseconds, or 0 if none is set.
+ */
+uint64_t ullMonoClockToReferenceUs(uint64_t ullLocalUs);
+
+/**
+ * @brief  Follow a change of the APB1 clock: derive the prescaler again and
+ *         restart the clock at ullNowUs, the time the caller measured across
+ *         the change. Called with interrupts disabled, after SystemCoreClock
+ *         is updated.
+ */
+void vMonoClockRetime(uint64_t ullNowUs);
+
+/* TIM5 update interrupt: counts the wraps of the 32-bit counter */
+void vMonoClockIrqHandler(void);
+
+#endif /* INC_MONOCLOCK_H_ */
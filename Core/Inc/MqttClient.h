@@ -0,0 +1,138 @@
+/* MqttClient.h
+ *
+ * MQTT 3.1.1 client for telemetry, over plain TCP.
+ *
+ * Publishing does not wait for the broker: the message is copied into one of
+ * MQTT_CLIENT_WINDOW slots and the call returns. The client task encodes the
+ * queued messages back to back into one buffer handed to a single
+ * socketSend(), so that small messages share TCP segments. A QoS 1 or 2
+ * message keeps its slot until the broker acknowledges it: up to
+ * MQTT_CLIENT_WINDOW messages are in flight at once, rather than one per
+ * round trip, and publishers wait for a slot (up to their timeout) once the
+ * window is full.
+ *
+ * The session is persistent (MQTT_CLIENT_CLEAN_SESSION 0). After a
+ * reconnection the messages still in flight are sent again, in the order
+ * they were first sent: PUBLISH with the DUP flag, or PUBREL for the QoS 2
+ * messages the broker already acknowledged with PUBREC. The queued messages
+ * follow. A connection that lasted is reestablished at once; failed attempts
+ * and short lived connections back off up to MQTT_CLIENT_RETRY_MAX_MS.
+ *
+ * Subscribed messages are handed to a callback, in the client task. An
+ * incoming QoS 2 message is delivered when its PUBLISH arrives: one resent by
+ * the broker after a reconnection may be delivered twice.
+ */
+#ifndef INC_MQTTCLIENT_H_
+#define INC_MQTTCLIENT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* Default TCP port of the broker */
+#define MQTT_CLIENT_PORT               1883u
+
+/* Messages queued or in flight at once */
+#define MQTT_CLIENT_WINDOW             32
+
+/* Largest message, topic and payload together */
+#define MQTT_CLIENT_MESSAGE_SIZE       256u
+
+/* Packets are gathered up to this size before being sent, one TCP segment */
+#define MQTT_CLIENT_BATCH_SIZE         1460u
+
+/* Largest incoming packet; longer messages are acknowledged but not delivered */
+#define MQTT_CLIENT_RX_SIZE            1024u
+
+/* TCP send buffer, from the large buffer pool when available */
+#define MQTT_CLIENT_TX_BUFFER_SIZE     8192u
+
+/* Keep alive interval announced to the broker, in seconds */
+#define MQTT_CLIENT_KEEP_ALIVE_S       60u
+
+/* 1 to start a new session on each connection, 0 to resume it */
+#define MQTT_CLIENT_CLEAN_SESSION      0
+
+/* Delay before a reconnection, doubled after each failed attempt */
+#define MQTT_CLIENT_RETRY_MIN_MS       100u
+#define MQTT_CLIENT_RETRY_MAX_MS       10000u
+
+/* Connection set up and blocked sends give up after this long */
+#define MQTT_CLIENT_TIMEOUT_MS         5000u
+
+/* Topic filters subscribed at once, and their longest length */
+#define MQTT_CLIENT_MAX_SUBSCRIPTIONS  4
+#define MQTT_CLIENT_FILTER_SIZE        64u
+
+/* Longest broker host name */
+#define MQTT_CLIENT_HOST_SIZE          64u
+
+/* Stack of the task, in words; subscription callbacks run on it */
+#define MQTT_CLIENT_TASK_STACK_SIZE    512
+
+/* Called with each message matching the filter of a subscription */
+typedef void (*MqttMessageCallback_t)(const char *pcTopic, size_t xTopicLength,
+                                      const uint8_t *pucPayload, size_t xLength, uint8_t ucQos);
+
+typedef struct
+{
+    uint32_t ulPublished;           /* Messages queued by xMqttClientPublish() */
+    uint32_t ulSent;                /* PUBLISH packets sent for the first time */
+    uint32_t ulAcked;               /* QoS 1 and 2 messages acknowledged */
+    uint32_t ulRetransmitted;       /* PUBLISH and PUBREL sent again after a reconnection */
+    uint32_t ulDropped;             /* Publish calls that found no free slot in time */
+    uint32_t ulReceived;            /* Messages received on subscriptions */
+    uint32_t ulBatches;             /* socketSend() calls */
+    uint32_t ulConnects;            /* Connections accepted by the broker */
+    uint32_t ulFailures;            /* Connection attempts failed or refused */
+} MqttClientStats_t;
+
+/**
+ * @brief  Create the client task.
+ * @param  uxPriority  Task priority.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xMqttClientStart(UBaseType_t uxPriority);
+
+/**
+ * @brief  Set the broker; the client connects, and then stays connected.
+ * @param  pcHost  Host name or address of the broker.
+ * @param  usPort  TCP port, 0 for MQTT_CLIENT_PORT.
+ * @return pdPASS on success, pdFAIL if the name is too long.
+ */
+BaseType_t xMqttClientConnect(const char *pcHost, uint16_t usPort);
+
+/* Leave the broker; the queued and in flight messages are kept */
+void vMqttClientDisconnect(void);
+
+BaseType_t xMqttClientIsConnected(void);
+
+/**
+ * @brief  Queue a message.
+ * @param  pcTopic    Topic name, without wildcards.
+ * @param  pvPayload  Payload, xLength bytes.
+ * @param  ucQos      Quality of service, 0 to 2.
+ * @param  xTimeout   Ticks to wait for a free slot when the window is full.
+ * @return pdPASS once queued, pdFAIL if too long or no slot was freed in time.
+ */
+BaseType_t xMqttClientPublish(const char *pcTopic, const void *pvPayload, size_t xLength,
+                              uint8_t ucQos, TickType_t xTimeout);
+
+/**
+ * @brief  Subscribe to a topic filter, on every (re)connection from now on.
+ * @param  pcFilter    Topic filter, '+' and '#' wildcards allowed.
+ * @param  ucQos       Highest quality of service requested, 0 to 2.
+ * @param  pxCallback  Called in the client task with each matching message.
+ * @return pdPASS on success, pdFAIL if the table is full or the filter too long.
+ */
+BaseType_t xMqttClientSubscribe(const char *pcFilter, uint8_t ucQos, MqttMessageCallback_t pxCallback);
+
+/* Messages queued or waiting for their acknowledgment */
+UBaseType_t uxMqttClientInFlight(void);
+
+void vMqttClientGetStats(MqttClientStats_t *pxStats);
+
+/* Register the "mqtt" CLI command */
+void vMqttClientRegisterCLICommands(void);
+
+#endif /* INC_MQTTCLIENT_H_ */
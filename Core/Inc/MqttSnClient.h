@@ -0,0 +1,122 @@
+/* MqttSnClient.h
+ *
+ * MQTT-SN 1.2 client for telemetry over UDP, for sites behind slow or
+ * metered links where the TCP handshake, the MQTT headers and one round
+ * trip per message cost too much.
+ *
+ * The gateway is configured, not searched for (no ADVERTISE / SEARCHGW
+ * traffic), and topics are predefined topic IDs agreed with the gateway,
+ * so that no REGISTER exchange is needed: a PUBLISH carries 7 bytes of
+ * header. Three levels are offered:
+ *
+ *  - QoS -1: sent at once, connected or not, never acknowledged;
+ *  - QoS 0: sent once connected, never acknowledged;
+ *  - QoS 1: kept until PUBACK, resent with DUP every
+ *    MQTT_SN_CLIENT_RETRY_MS, up to MQTT_SN_CLIENT_WINDOW in flight.
+ *
+ * Queued messages linger up to MQTT_SN_CLIENT_LINGER_MS so that a burst
+ * leaves with a single socketSendMsgBatch() call: one wake-up of the radio
+ * rather than one per message. Once nothing is left to send or to be
+ * acknowledged for MQTT_SN_CLIENT_IDLE_MS, the client goes to sleep
+ * (DISCONNECT with a duration); it wakes up every MQTT_SN_CLIENT_SLEEP_S
+ * with a PINGREQ for the gateway to keep the session, and reconnects as
+ * soon as a message is queued. The session is kept across reconnections:
+ * QoS 1 messages in flight are resent in order.
+ */
+#ifndef INC_MQTTSNCLIENT_H_
+#define INC_MQTTSNCLIENT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* Default UDP port of the gateway */
+#define MQTT_SN_CLIENT_PORT            1884u
+
+/* Messages queued or waiting for PUBACK at once */
+#define MQTT_SN_CLIENT_WINDOW          16
+
+/* Largest payload of a message */
+#define MQTT_SN_CLIENT_MESSAGE_SIZE    128u
+
+/* Datagrams handed to one socketSendMsgBatch() call */
+#define MQTT_SN_CLIENT_BATCH           8
+
+/* Longest wait of a queued message for others to join its batch */
+#define MQTT_SN_CLIENT_LINGER_MS       20u
+
+/* Retransmission of CONNECT, PINGREQ and QoS 1 messages, and tries before
+   the gateway is deemed lost */
+#define MQTT_SN_CLIENT_RETRY_MS        10000u
+#define MQTT_SN_CLIENT_RETRIES         4u
+
+/* Delay before connecting again once the gateway is lost */
+#define MQTT_SN_CLIENT_RECONNECT_MS    30000u
+
+/* Keep alive announced in CONNECT, in seconds */
+#define MQTT_SN_CLIENT_KEEP_ALIVE_S    300u
+
+/* Sleep after this long without traffic, for this many seconds between
+   wake-ups; a duration of 0 keeps the client awake */
+#define MQTT_SN_CLIENT_IDLE_MS         1000u
+#define MQTT_SN_CLIENT_SLEEP_S         60u
+
+/* 1 to start a new session on each connection, 0 to resume it */
+#define MQTT_SN_CLIENT_CLEAN_SESSION   0
+
+/* Stack of the task, in words */
+#define MQTT_SN_CLIENT_TASK_STACK_SIZE 384
+
+/* Quality of service of xMqttSnClientPublish() */
+#define MQTT_SN_QOS_MINUS_ONE          (-1)
+
+typedef struct
+{
+    uint32_t ulPublished;           /* Messages queued by xMqttSnClientPublish() */
+    uint32_t ulSent;                /* PUBLISH sent for the first time */
+    uint32_t ulAcked;               /* QoS 1 messages acknowledged */
+    uint32_t ulRetransmitted;       /* PUBLISH sent again */
+    uint32_t ulRejected;            /* QoS 1 messages refused by the gateway */
+    uint32_t ulDropped;             /* Publish calls that found no free slot in time */
+    uint32_t ulDatagrams;
+    uint32_t ulBatches;             /* socketSendMsgBatch() calls */
+    uint32_t ulConnects;            /* CONNACK accepted */
+    uint32_t ulSleeps;              /* Transitions to the asleep state */
+    uint32_t ulGatewayLost;         /* Retries exhausted */
+} MqttSnClientStats_t;
+
+/**
+ * @brief  Create the client task.
+ * @param  uxPriority  Task priority.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xMqttSnClientStart(UBaseType_t uxPriority);
+
+/**
+ * @brief  Set the gateway; the client connects when it has a message to send.
+ * @param  pcAddress  IPv4 address, as text; NULL stops the client.
+ * @param  usPort     UDP port, 0 for MQTT_SN_CLIENT_PORT.
+ * @return pdPASS on success, pdFAIL if the address is invalid.
+ */
+BaseType_t xMqttSnClientConfigure(const char *pcAddress, uint16_t usPort);
+
+/**
+ * @brief  Queue a message on a predefined topic.
+ * @param  usTopicId  Predefined topic ID.
+ * @param  pvPayload  Payload, xLength bytes.
+ * @param  xQos       MQTT_SN_QOS_MINUS_ONE, 0 or 1.
+ * @param  xTimeout   Ticks to wait for a free slot when the window is full.
+ * @return pdPASS once queued, pdFAIL if too long or no slot was freed in time.
+ */
+BaseType_t xMqttSnClientPublish(uint16_t usTopicId, const void *pvPayload, size_t xLength,
+                                BaseType_t xQos, TickType_t xTimeout);
+
+/* Messages queued or waiting for PUBACK */
+UBaseType_t uxMqttSnClientPending(void);
+
+void vMqttSnClientGetStats(MqttSnClientStats_t *pxStats);
+
+/* Register the "mqttsn" CLI command */
+void vMqttSnClientRegisterCLICommands(void);
+
+#endif /* INC_MQTTSNCLIENT_H_ */
@@ -0,0 +1,46 @@
+/* NetBench.h */
+#ifndef INC_NETBENCH_H_
+#define INC_NETBENCH_H_
+
+#include "FreeRTOS.h"
+
+/* Default ports: iperf2 and the RFC 862 echo service */
+#define NET_BENCH_IPERF_PORT          5001
+#define NET_BENCH_ECHO_PORT           7
+
+/* Defaults of an iperf client run */
+#define NET_BENCH_DEFAULT_SECONDS     10
+#define NET_BENCH_DEFAULT_UDP_RATE    1000000u   /* bit/s, as iperf2 */
+#define NET_BENCH_DEFAULT_LENGTH      1470       /* UDP payload per datagram */
+
+/* Largest read / write; one frame worth of UDP payload */
+#define NET_BENCH_BUFFER_SIZE         1472
+
+/* A UDP server run ends if no datagram arrives for this long */
+#define NET_BENCH_UDP_IDLE_MS         2000
+
+/* TCP receive window of the server and send buffer of the client; served
+ * from the large buffer pool in D2 SRAM, half of it each so that a server
+ * and a client run can coexist */
+#define NET_BENCH_TCP_WINDOW          16384
+
+/* Socket timeout, bounds the reaction time to "iperf stop" */
+#define NET_BENCH_POLL_MS             200
+
+/* Period of the interval reports printed by "iperf" */
+#define NET_BENCH_REPORT_MS           1000
+
+/* Stack of the benchmark task, in words */
+#define NET_BENCH_STACK_SIZE          512
+
+/**
+ * @brief  Create the benchmark task; it stays idle until a test is started
+ *         from the CLI.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xNetBenchStart(UBaseType_t uxPriority);
+
+/* Register the "iperf" and "udp-echo" CLI commands */
+void vNetBenchRegisterCLICommands(void);
+
+#endif /* INC_NETBENCH_H_ */
@@ -0,0 +1,8 @@
+/* NetCLICommands.h */
+#ifndef INC_NETCLICOMMANDS_H_
+#define INC_NETCLICOMMANDS_H_
+
+/* Register the TCP/IP stack diagnostic CLI commands ("netstat", "net-latency", "link-up", "ss", "dhcp-server", "loopback") */
+void vRegisterNetCLICommands(void);
+
+#endif /* INC_NETCLICOMMANDS_H_ */
@@ -0,0 +1,52 @@
+/* NetReplay.h
+ *
+ * Deterministic load test of the receive path: frames of a traffic mix, kept
+ * in flash, are handed to nicProcessPacket() at a set rate as if the
+ * Ethernet driver had received them, so that every change of the stack can
+ * be measured against the same load, without a test network.
+ *
+ *   replay <mix> [pkt/s] [count] | stop | show
+ *
+ * The mixes are "arp", "mdns", "tcp", "cyphal", "storm" (broadcast UDP) and
+ * "mix", a blend of them led by TCP bulk data. The frames come from 198.18.0.0/15
+ * (RFC 2544 benchmarking) and locally administered MAC addresses; the
+ * unicast ones are addressed to the interface. What the stack sends back
+ * (ARP replies, TCP resets, mDNS answers) goes out on the link.
+ *
+ * Each frame is timed with the DWT cycle counter from nicProcessPacket() to
+ * its return, per frame type. The run also reports how late the replay task
+ * woke against its schedule, the CPU load, and the frames the stack dropped
+ * (counters of core/net_stats.h over the run).
+ */
+#ifndef INC_NETREPLAY_H_
+#define INC_NETREPLAY_H_
+
+#include "FreeRTOS.h"
+
+/* Defaults of a run */
+#define NET_REPLAY_DEFAULT_RATE        1000u      /* pkt/s; 0 for as fast as possible */
+#define NET_REPLAY_DEFAULT_COUNT       10000u
+
+/* Frames injected under one hold of the stack mutex, at most */
+#define NET_REPLAY_BATCH               32u
+
+/* Bytes of flash frames materialized in RAM at the start of a run */
+#define NET_REPLAY_POOL_SIZE           2048u
+
+/* Period of the progress lines printed by "replay" */
+#define NET_REPLAY_REPORT_MS           1000
+
+/* Stack of the replay task, in words */
+#define NET_REPLAY_STACK_SIZE          512
+
+/**
+ * @brief  Create the replay task; it stays idle until a run is started
+ *         from the CLI.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xNetReplayStart(UBaseType_t uxPriority);
+
+/* Register the "replay" CLI command */
+void vNetReplayRegisterCLICommands(void);
+
+#endif /* INC_NETREPLAY_H_ */
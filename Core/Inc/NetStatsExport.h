@@ -0,0 +1,50 @@
+/* NetStatsExport.h */
+#ifndef INC_NETSTATSEXPORT_H_
+#define INC_NETSTATSEXPORT_H_
+
+#include "FreeRTOS.h"
+#include "core/net.h"
+
+/* Size of an exported datagram; every counter fits with room to spare (the
+ * report of three interfaces outgrows a single Ethernet frame and is sent
+ * fragmented) */
+#define NET_STATS_EXPORT_BUFFER_SIZE   2048
+
+/* Stack of the export task, in words */
+#define NET_STATS_EXPORT_STACK_SIZE    384
+
+/**
+ * @brief  Format one line of the network statistics report.
+ * @param  pxStats   Snapshot taken with xNetStatsSnapshot().
+ * @param  uxLine    Line index, starting at 0.
+ * @param  pcBuffer  Output buffer, terminated with CR LF.
+ * @param  xLength   Size of the output buffer.
+ * @return pdTRUE if the line exists, pdFALSE past the last line.
+ */
+BaseType_t xNetStatsFormatLine(const NetStats *pxStats, UBaseType_t uxLine, char *pcBuffer, size_t xLength);
+
+/**
+ * @brief  Number of lines of the network statistics report.
+ */
+UBaseType_t uxNetStatsLineCount(void);
+
+/**
+ * @brief  Take a snapshot of every interface and protocol counter.
+ */
+void vNetStatsSnapshot(NetStats *pxStats);
+
+/**
+ * @brief  Send the report periodically to a UDP collector.
+ * @param  pxAddr    Collector address.
+ * @param  usPort    Collector UDP port.
+ * @param  ulPeriod  Period in milliseconds, 0 to stop exporting.
+ */
+void vNetStatsExportConfigure(const IpAddr *pxAddr, uint16_t usPort, uint32_t ulPeriod);
+
+/**
+ * @brief  Create the export task; it stays idle until configured.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xNetStatsExportStart(UBaseType_t uxPriority);
+
+#endif /* INC_NETSTATSEXPORT_H_ */
@@ -0,0 +1,75 @@
+/* PacketCapture.h
+ *
+ * Packet capture of a deployed unit, without a mirror port: the frames of
+ * the Ethernet interface that pass a filter are streamed as pcapng over TCP,
+ * so that
+ *
+ *   nc <board> 19000 | wireshark -k -i -
+ *
+ * shows them live. Capture starts when a client connects and stops when it
+ * leaves; one client is served at a time.
+ *
+ * The frames are taken by the tap of the TCP/IP stack (core/net_capture.h):
+ * a BPF program runs on every frame received or sent, and the ones it keeps
+ * are copied into a ring, which this task drains into the connection. The
+ * stack never waits for the client: when the ring is full the frames are
+ * dropped, and counted. The stream itself shares the link it observes, so a
+ * capture of everything at line rate only holds for bursts the ring absorbs;
+ * a filter, or a shorter snaplen, keeps the rest.
+ *
+ * The filter is written with the "capture filter" command, in a small
+ * subset of the pcap syntax: primitives separated by spaces, all of which
+ * must match, each possibly preceded by "not":
+ *
+ *   ip | ip6 | arp | tcp | udp | icmp | host A.B.C.D | [tcp|udp] port N
+ *
+ * for instance "udp port 9382 not host 192.168.1.10". The frames of the
+ * capture connection itself are always left out.
+ */
+#ifndef INC_PACKETCAPTURE_H_
+#define INC_PACKETCAPTURE_H_
+
+#include "FreeRTOS.h"
+
+/* TCP port of the capture server */
+#define PACKET_CAPTURE_PORT            19000u
+
+/* Bytes of pcapng blocks gathered before a send */
+#define PACKET_CAPTURE_TX_SIZE         4096u
+
+/* Longest time a captured frame waits before being sent, in milliseconds */
+#define PACKET_CAPTURE_FLUSH_MS        50u
+
+/* A client that does not read the stream for this long is dropped */
+#define PACKET_CAPTURE_TIMEOUT_MS      10000u
+
+/* Longest filter expression */
+#define PACKET_CAPTURE_FILTER_SIZE     96u
+
+/* Stack of the task, in words */
+#define PACKET_CAPTURE_STACK_SIZE      512
+
+/**
+ * @brief  Set the filter of the capture, applied at once if one is running.
+ * @param  pcFilter  Filter expression; empty to capture every frame.
+ * @return pdPASS on success, pdFAIL if the expression is invalid.
+ */
+BaseType_t xPacketCaptureSetFilter(const char *pcFilter);
+
+/**
+ * @brief  Set the number of bytes kept of each frame.
+ * @param  ulSnapLen  0 for the largest, NET_CAPTURE_MAX_SNAP_LEN.
+ */
+void vPacketCaptureSetSnapLen(uint32_t ulSnapLen);
+
+/**
+ * @brief  Create the capture server task.
+ * @param  uxPriority  Task priority.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xPacketCaptureStart(UBaseType_t uxPriority);
+
+/* Register the "capture" CLI command */
+void vPacketCaptureRegisterCLICommands(void);
+
+#endif /* INC_PACKETCAPTURE_H_ */
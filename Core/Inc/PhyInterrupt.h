@@ -0,0 +1,37 @@
+/* PhyInterrupt.h
+ *
+ * External interrupt line driver (ExtIntDriver) for the nINT output of the
+ * LAN8742. Once registered with netSetExtIntDriver(), lan8742Tick() stops
+ * reading the BMSR over MDIO every NIC_TICK_INTERVAL: the PHY pulls nINT
+ * low on auto-negotiation complete or link down (LAN8742_IMR), the EXTI
+ * interrupt flags a PHY event to the TCP/IP task, and the MDIO reads are
+ * only done then, by lan8742EventHandler(), which also releases nINT by
+ * reading the interrupt source register.
+ *
+ * nINT shares its pin with REFCLKO: it is only available when the 50 MHz
+ * reference clock comes from an external oscillator (nINTSEL strapped
+ * low). The NUCLEO-H723ZG uses REFCLKO, so the line has to be wired on the
+ * board before APP_USE_PHY_INTERRUPT is enabled in main.c.
+ */
+#ifndef INC_PHYINTERRUPT_H_
+#define INC_PHYINTERRUPT_H_
+
+#include "core/net.h"
+
+/* Pin of nINT; active low, pulled up on the MCU side */
+#define PHY_INT_GPIO_PORT          GPIOD
+#define PHY_INT_GPIO_PIN           GPIO_PIN_3
+#define PHY_INT_GPIO_CLK_ENABLE()  __HAL_RCC_GPIOD_CLK_ENABLE()
+
+/* EXTI line of the pin, with a vector of its own so that disabling it
+ * leaves the other lines alone */
+#define PHY_INT_IRQn               EXTI3_IRQn
+#define PHY_INT_IRQHandler         EXTI3_IRQHandler
+
+/* Same priority as the Ethernet MAC interrupt: both only signal netEvent */
+#define PHY_INT_IRQ_PRIORITY       12
+
+/* The driver, to pass to netSetExtIntDriver() */
+extern const ExtIntDriver xPhyExtIntDriver;
+
+#endif /* INC_PHYINTERRUPT_H_ */
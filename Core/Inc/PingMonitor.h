@@ -0,0 +1,95 @@
+/* PingMonitor.h
+ *
+ * Continuous latency monitoring of a few hosts by ICMP echo.
+ *
+ * Each target is probed at its own period, down to a few milliseconds, by
+ * a single task: the requests go straight to the IPv4 layer and the replies
+ * come back through the Echo Reply callback of the stack, timestamped when
+ * the network task processes them, so that no socket, no blocking receive
+ * and no task per target are needed. Every probe carries the identifier of
+ * the monitor and a sequence number of its own; the number indexes a table
+ * of PING_MONITOR_MAX_PROBES outstanding probes, which holds the target and
+ * the send time, and a reply is matched in one lookup.
+ *
+ * A probe not answered within PING_MONITOR_TIMEOUT_MS is lost; a reply
+ * arriving after that is counted as late. The table must hold the probes
+ * sent during one timeout: when it is full, the oldest probe is given up
+ * as lost before its timeout.
+ *
+ * Per target, the monitor keeps the round trip times (minimum, mean,
+ * maximum, and a histogram in powers of two from 128 us), the loss, and the
+ * interarrival jitter of RFC 3550 computed on the round trip times. They
+ * are shown by the "pingmon" command and published over MQTT every
+ * PING_MONITOR_PUBLISH_S seconds while the client is connected.
+ */
+#ifndef INC_PINGMONITOR_H_
+#define INC_PINGMONITOR_H_
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* Targets probed at once */
+#define PING_MONITOR_MAX_TARGETS       8
+
+/* Outstanding probes, a power of two dividing 65536 */
+#define PING_MONITOR_MAX_PROBES        256u
+
+/* Shortest period of a target, and wait for a reply */
+#define PING_MONITOR_MIN_PERIOD_MS     5u
+#define PING_MONITOR_TIMEOUT_MS        1000u
+
+/* Data bytes after the ICMP header */
+#define PING_MONITOR_PAYLOAD_SIZE      32u
+
+/* Buckets of the RTT histogram: below 128 us, then [64 << b, 128 << b) us,
+   the last one open */
+#define PING_MONITOR_HIST_BUCKETS      12u
+
+/* Interval of the MQTT summaries, 0 to publish none; the topic is the
+   prefix followed by the address of the target */
+#define PING_MONITOR_PUBLISH_S         10u
+#define PING_MONITOR_TOPIC             "pingmon/"
+
+/* Stack of the task, in words */
+#define PING_MONITOR_TASK_STACK_SIZE   512
+
+typedef struct
+{
+    uint32_t ulSent;
+    uint32_t ulReceived;
+    uint32_t ulLost;                    /* Not answered in time */
+    uint32_t ulLate;                    /* Answered after being counted lost */
+    uint32_t ulSendErrors;              /* No route or no buffer */
+    uint32_t ulLastUs;
+    uint32_t ulMinUs;
+    uint32_t ulMaxUs;
+    uint64_t ullSumUs;                  /* Over ulReceived replies */
+    uint32_t ulJitterUs;
+    uint32_t ulHist[PING_MONITOR_HIST_BUCKETS];
+} PingMonitorStats_t;
+
+/**
+ * @brief  Create the monitor task and register for the Echo Replies.
+ * @param  uxPriority  Task priority; the send times are taken in this task.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xPingMonitorStart(UBaseType_t uxPriority);
+
+/**
+ * @brief  Probe a host periodically.
+ * @param  pcAddress   IPv4 address, as text.
+ * @param  ulPeriodMs  Interval between two probes, PING_MONITOR_MIN_PERIOD_MS at least.
+ * @return Index of the target, or -1 if a parameter is invalid or the table full.
+ */
+int32_t lPingMonitorAddTarget(const char *pcAddress, uint32_t ulPeriodMs);
+
+/* Stop probing a target; its outstanding probes are forgotten */
+BaseType_t xPingMonitorRemoveTarget(int32_t lTarget);
+
+/* Counters of a target; pdFAIL if there is no such target */
+BaseType_t xPingMonitorGetStats(int32_t lTarget, PingMonitorStats_t *pxStats);
+
+/* Register the "pingmon" CLI command */
+void vPingMonitorRegisterCLICommands(void);
+
+#endif /* INC_PINGMONITOR_H_ */
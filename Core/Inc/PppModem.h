@@ -0,0 +1,79 @@
+/* PppModem.h
+ *
+ * Cellular modem on USART2, the fallback uplink of the node: PPP over the
+ * HDLC driver of CycloneTCP (ppp/ppp_hdlc.c), the interface "ppp0".
+ *
+ * Both directions use DMA, as the console does in SerialTask.c. DMA1
+ * stream 2 receives into a circular buffer drained on line idle and on the
+ * half and full transfer interrupts, straight into the RX ring of the PPP
+ * context; DMA1 stream 3 sends from the TX ring itself, the HDLC driver
+ * having already stuffed the frames there, so no byte is copied on the way
+ * out. RTS/CTS flow control keeps the modem from overrunning the receiver
+ * at 921600 baud.
+ *
+ * The dial task brings the modem online with AT commands, runs LCP and
+ * IPCP through pppConnect(), then sleeps until the link goes down and
+ * dials again. The Ethernet interface comes first in the interface table,
+ * hence is preferred by source address selection whenever it holds an
+ * address; ppp0 carries the traffic otherwise.
+ */
+#ifndef INC_PPPMODEM_H_
+#define INC_PPPMODEM_H_
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "core/net.h"
+
+/* USART2 on the Zio connector: PD5 TX, PD6 RX, PD4 RTS and PA0 CTS (PD3,
+ * the other CTS pin, is the nINT line of PhyInterrupt.h) */
+#define PPP_MODEM_BAUD_RATE            921600u
+
+/* Circular RX DMA buffer; a multiple of the cache line */
+#define PPP_MODEM_RX_DMA_SIZE          1024u
+
+/* Same priority as the console UART: the handlers only signal netEvent */
+#define PPP_MODEM_IRQ_PRIORITY         5
+
+/* Packet data context of the operator and PAP credentials (empty for most
+ * operators) */
+#define PPP_MODEM_APN                  "internet"
+#define PPP_MODEM_USERNAME             ""
+#define PPP_MODEM_PASSWORD             ""
+
+/* Timeouts of an AT command and of the LCP / IPCP negotiation, delay
+ * before dialing again after a failure or a hang-up */
+#define PPP_MODEM_AT_TIMEOUT_MS        2000u
+#define PPP_MODEM_CONNECT_TIMEOUT_MS   30000u
+#define PPP_MODEM_REDIAL_DELAY_MS      10000u
+
+/* Stack of the dial task, in words */
+#define PPP_MODEM_TASK_STACK_SIZE      384
+
+typedef struct
+{
+    uint32_t ulRxBytes;             /* Received by the RX DMA */
+    uint32_t ulRxDropped;           /* Lost to a full RX ring */
+    uint32_t ulTxBytes;             /* Sent by the TX DMA */
+    uint32_t ulOverruns;            /* USART overrun errors */
+    uint32_t ulErrors;              /* Framing and noise errors */
+    uint32_t ulDials;               /* Dial attempts */
+    uint32_t ulConnects;            /* Sessions that reached IPCP Opened */
+} PppModemStats_t;
+
+/* The driver, to pass to netSetUartDriver() */
+extern const UartDriver xPppModemUartDriver;
+
+/**
+ * @brief  Create the dial task.
+ * @param  pxInterface  PPP interface, already configured.
+ * @param  uxPriority   Task priority.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xPppModemStart(NetInterface *pxInterface, UBaseType_t uxPriority);
+
+void vPppModemGetStats(PppModemStats_t *pxStats);
+
+/* Register the "ppp" CLI command */
+void vPppModemRegisterCLICommands(void);
+
+#endif /* INC_PPPMODEM_H_ */
@@ -0,0 +1,88 @@
+/* PtpSlave.h */
+#ifndef INC_PTPSLAVE_H_
+#define INC_PTPSLAVE_H_
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* PTP domain followed by the slave */
+#define PTP_DOMAIN                     0
+
+/* Announce intervals without a message before the master is dropped */
+#define PTP_ANNOUNCE_RECEIPT_TIMEOUT   3
+
+/* Offsets beyond this are corrected by stepping the clock rather than by
+ * the servo, in nanoseconds */
+#define PTP_STEP_THRESHOLD_NS          100000
+
+/* The slave is locked once PTP_LOCK_COUNT offsets in a row are within
+ * PTP_LOCK_THRESHOLD_NS, and only then publishes the PTP time as the
+ * reference of the microsecond clock */
+#define PTP_LOCK_THRESHOLD_NS          1000
+#define PTP_LOCK_COUNT                 4
+
+/* PI servo gains, in thousandths per second of Sync interval: those of
+ * linuxptp for hardware time stamps */
+#define PTP_SERVO_KP_PERMILLE          700
+#define PTP_SERVO_KI_PERMILLE          300
+
+/* Weight of a new sample in the mean path delay and rate averages, as a
+ * power of two */
+#define PTP_FILTER_SHIFT               3
+
+/* Wake-up period of the task when no message arrives, bounds the master
+ * timeout detection */
+#define PTP_POLL_MS                    250
+
+/* Stack of the slave task, in words */
+#define PTP_SLAVE_STACK_SIZE           384
+
+typedef enum
+{
+    ePtpListening = 0,      /* No master */
+    ePtpUncalibrated,       /* Following a master, not locked yet */
+    ePtpSlave               /* Locked to the master */
+} PtpState_t;
+
+/* Synchronization state and message counters */
+typedef struct
+{
+    PtpState_t eState;
+    uint8_t ucMasterIdentity[8];    /* Clock identity of the master port */
+    uint16_t usMasterPort;          /* Port number of the master port */
+    uint32_t ulMasterAddr;          /* IPv4 address, network byte order */
+    int64_t llOffsetNs;             /* Last offset from the master */
+    int64_t llMeanPathDelayNs;
+    int32_t lFreqPpb;               /* Frequency correction of the PTP clock */
+    uint32_t ulSteps;               /* Clock steps */
+    uint32_t ulAnnounces;
+    uint32_t ulSyncs;
+    uint32_t ulFollowUps;
+    uint32_t ulDelayReqs;
+    uint32_t ulDelayResps;
+    uint32_t ulRxStampMissed;       /* Sync messages not time stamped */
+    uint32_t ulTxStampMissed;       /* Delay_Resp messages without a Delay_Req
+                                     * transmit time stamp */
+    uint32_t ulDropped;             /* Malformed or unexpected messages */
+} PtpSlaveStats_t;
+
+/**
+ * @brief  Create the slave task, following the masters reachable through
+ *         netInterface[uxInterface]. To be called once the interface is
+ *         configured.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xPtpSlaveStart(UBaseType_t uxInterface, UBaseType_t uxPriority);
+
+void vPtpSlaveGetStats(PtpSlaveStats_t *pxStats);
+
+/**
+ * @brief  ETH_TX_TIMESTAMP_HOOK: transmit time of the Delay_Req sent with
+ *         the time stamping identifier lTimestampId. Runs in the TCP/IP task.
+ */
+void vPtpSlaveTxTimestamp(int32_t lTimestampId, uint32_t ulSeconds, uint32_t ulNanoseconds);
+
+/* Register the "ptp" CLI command */
+void vPtpSlaveRegisterCLICommands(void);
+
+#endif /* INC_PTPSLAVE_H_ */
@@ -35,7 +35,11 @@
 #define RTE_CYCLONE_TCP_DNS_CLIENT
 #define RTE_CYCLONE_TCP_MDNS_CLIENT
 #define RTE_CYCLONE_TCP_MDNS_RESPONDER
+#define RTE_CYCLONE_TCP_DNS_SD_RESPONDER
 #define RTE_CYCLONE_TCP_HTTP_CLIENT
 #define RTE_CYCLONE_TCP_PING
+#define RTE_CYCLONE_TCP_NAT
+#define RTE_CYCLONE_TCP_PPP
+#define RTE_CYCLONE_TCP_PAP
 
 #endif /* __RTE_COMPONENTS_H__ */
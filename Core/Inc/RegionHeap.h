@@ -0,0 +1,61 @@
+/* RegionHeap.h
+ *
+ * Allocation from a chosen SRAM of the STM32H723. The FreeRTOS heap (heap_4,
+ * configTOTAL_HEAP_SIZE) stays in the AXI SRAM of the D1 domain; the DTCM and
+ * the SRAM4 of the D3 domain each get a heap of their own, described like the
+ * regions of heap_5, so that a caller picks the memory that suits its use:
+ *
+ * - eRegionHeapDtcm: single-cycle CPU access, not reachable by the Ethernet
+ *   DMA. For control blocks and buffers only touched by the CPU.
+ * - eRegionHeapD1: the FreeRTOS heap, for bulk buffers (pvPortMalloc).
+ * - eRegionHeapD3: reachable by the Ethernet DMA and cached like the D1
+ *   SRAM. For frame buffers beyond the network memory pool.
+ *
+ * The AHB SRAMs of the D2 domain hold the large TCP buffers
+ * (TCP_LARGE_BUFFER_SECTION) and are not part of any heap.
+ */
+#ifndef INC_REGIONHEAP_H_
+#define INC_REGIONHEAP_H_
+
+#include <stddef.h>
+#include "FreeRTOS.h"
+
+/* Sizes of the heaps of the DTCM and of the D3 SRAM, in bytes */
+#define REGION_HEAP_DTCM_SIZE          (16u * 1024u)
+#define REGION_HEAP_D3_SIZE            (16u * 1024u)
+
+/* Sections of the linker scripts */
+#define REGION_HEAP_DTCM_SECTION       ".dtcm_bss"
+#define REGION_HEAP_D3_SECTION         ".ram_d3"
+
+typedef enum
+{
+    eRegionHeapDtcm = 0,
+    eRegionHeapD1,
+    eRegionHeapD3,
+    eRegionHeapCount
+} RegionHeapId_t;
+
+/**
+ * @brief  Allocate xSize bytes from a region, portBYTE_ALIGNMENT aligned.
+ *         Task context only, as pvPortMalloc().
+ * @return The block, or NULL if the region cannot serve it.
+ */
+void *pvRegionHeapAlloc(RegionHeapId_t eRegion, size_t xSize);
+
+/* Free a block of any region; the region is found from its address */
+void vRegionHeapFree(void *pv);
+
+/* Region holding a block, eRegionHeapCount if in none */
+RegionHeapId_t eRegionHeapOf(const void *pv);
+
+/* Usage of a region, in the format of vPortGetHeapStats() */
+void vRegionHeapGetStats(RegionHeapId_t eRegion, HeapStats_t *pxStats);
+
+/* Total size of a region, in bytes */
+size_t xRegionHeapGetSize(RegionHeapId_t eRegion);
+
+/* Name of a region, as shown by "query-heap" */
+const char *pcRegionHeapName(RegionHeapId_t eRegion);
+
+#endif /* INC_REGIONHEAP_H_ */
@@ -0,0 +1,49 @@
+/* ResourceMonitor.h
+ *
+ * RAM budget of the running application, to size stacks and pools from
+ * measurements rather than guesses. A task samples, once a period:
+ *  - the stack high-water mark of every task (the fewest words ever left);
+ *  - the free and lowest free bytes of every heap (RegionHeap.h, TlsfHeap.h);
+ *  - the blocks of the network memory pool in use, and their peak;
+ *  - the sockets of the socket table in use, and their peak;
+ *  - the fill of the serial stream buffers, and its peak.
+ *
+ * The "resources" command prints the last sample, tasks with the least
+ * stack left first. A summary goes out as a uavcan.diagnostic.Record on
+ * Cyphal/UDP, with the WARNING severity when a task is within
+ * RESOURCE_MONITOR_STACK_MARGIN words of its stack end or the pool is full.
+ */
+#ifndef INC_RESOURCEMONITOR_H_
+#define INC_RESOURCEMONITOR_H_
+
+#include "FreeRTOS.h"
+
+/* Period of the samples, in milliseconds */
+#define RESOURCE_MONITOR_PERIOD_MS     1000u
+
+/* Period of the Cyphal publication, in samples; 0 not to publish */
+#define RESOURCE_MONITOR_PUBLISH_EVERY 10u
+
+/* Tasks sampled, at most */
+#define RESOURCE_MONITOR_MAX_TASKS     32
+
+/* Stack left, in words, under which a task is reported as a warning */
+#define RESOURCE_MONITOR_STACK_MARGIN  32u
+
+/* Subject of uavcan.diagnostic.Record.1.1 (fixed port-ID) */
+#define RESOURCE_MONITOR_SUBJECT_ID    8184u
+
+/* Stack of the monitor task, in words */
+#define RESOURCE_MONITOR_STACK_SIZE    384
+
+/**
+ * @brief  Create the monitor task, which takes a sample at once and then
+ *         every RESOURCE_MONITOR_PERIOD_MS.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xResourceMonitorStart(UBaseType_t uxPriority);
+
+/* Register the "resources" CLI command */
+void vResourceMonitorRegisterCLICommands(void);
+
+#endif /* INC_RESOURCEMONITOR_H_ */
@@ -0,0 +1,56 @@
+/* RunTimeStats.h */
+#ifndef INC_RUNTIMESTATS_H_
+#define INC_RUNTIMESTATS_H_
+
+#include <stdint.h>
+
+/* Rate of the counter handed to FreeRTOS for per-task run-time accounting */
+#define RUN_TIME_STATS_COUNTER_HZ    1000000u
+
+/* Maximum number of tasks reported by the "cpu-stats" command */
+#define RUN_TIME_STATS_MAX_TASKS     24
+
+/* Interrupt sources whose execution time is measured */
+#define RUN_TIME_STATS_ISR_ETH       0   /* Ethernet MAC (CycloneTCP driver) */
+#define RUN_TIME_STATS_ISR_USART3    1   /* USART3 and its RX / TX DMA streams */
+#define RUN_TIME_STATS_ISR_TIMEBASE  2   /* TIM23 HAL timebase */
+#define RUN_TIME_STATS_ISR_USART2    3   /* USART2 and its DMA streams (PPP modem) */
+#define RUN_TIME_STATS_ISR_USART6    4   /* USART6 and its TX DMA stream (Modbus RTU) */
+#define RUN_TIME_STATS_ISR_ADC       5   /* DMA stream of the ADC (AdcStream) */
+#define RUN_TIME_STATS_ISR_COUNT     6
+
+/* Start the DWT cycle counter (portCONFIGURE_TIMER_FOR_RUN_TIME_STATS) */
+void configureTimerForRunTimeStats(void);
+
+/* Fold the run-time counter at a change of SystemCoreClock; interrupts disabled */
+void vRunTimeStatsClockChanged(void);
+
+/* Run-time counter for FreeRTOS, RUN_TIME_STATS_COUNTER_HZ (portGET_RUN_TIME_COUNTER_VALUE) */
+unsigned long getRunTimeCounterValue(void);
+
+/* CPU cycles since the counter was started, extended to 64 bits; safe from any context */
+uint64_t ullRunTimeStatsGetCycles(void);
+
+/* Must run at least once per CYCCNT wrap (a few seconds); called from the tick hook */
+void vRunTimeStatsTickHook(void);
+
+/* Bracket an interrupt handler to account its execution time to a source */
+void vRunTimeStatsIsrEnter(uint32_t ulSource);
+void vRunTimeStatsIsrExit(uint32_t ulSource);
+
+/* CPU load measurement between two samples */
+typedef struct
+{
+    uint32_t ulTotal;   /* Run-time counter value */
+    uint32_t ulIdle;    /* Run time of the idle task */
+} RunTimeLoadSample_t;
+
+void vRunTimeStatsGetLoadSample(RunTimeLoadSample_t *pxSample);
+
+/* CPU load between two samples, in tenths of a percent */
+uint32_t ulRunTimeStatsLoadPermille(const RunTimeLoadSample_t *pxStart, const RunTimeLoadSample_t *pxEnd);
+
+/* Register the "cpu-stats" CLI command */
+void vRunTimeStatsRegisterCLICommands(void);
+
+#endif /* INC_RUNTIMESTATS_H_ */
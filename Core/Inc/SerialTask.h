@@ -1,4 +1,17 @@
-/* SerialTask.h */
+/* SerialTask.h
+ *
+ * Console UART (USART3): RX by circular DMA into a stream buffer, TX by DMA
+ * from a byte ring.
+ *
+ * The TX ring takes printf(), the TRACE_xxx messages and the other writers
+ * from any task or interrupt at once: a writer reserves a span of the ring
+ * with LDREX / STREX, copies its bytes and adds their count to the commit
+ * counter. The TX task sends the bytes up to the reserve index whenever the
+ * commit counter has caught up with it, i.e. no writer is half way through
+ * its span. Writers never wait for one another; bytes that do not fit are
+ * dropped and counted. Tasks wake the TX task, interrupts leave their bytes
+ * to its next poll.
+ */
 #ifndef INC_SERIALTASK_H_
 #define INC_SERIALTASK_H_
 
@@ -7,12 +20,28 @@
 #include "FreeRTOS.h"
 #include "stream_buffer.h"
 #include "semphr.h"
+#include "task.h"
 
-/* Sizes for RX and TX byte streams */
-#define SERIAL_TASK_RX_BUFFER_SIZE   configCOMMAND_INT_MAX_INPUT_SIZE
-#define SERIAL_TASK_TX_BUFFER_SIZE   configCOMMAND_INT_MAX_OUTPUT_SIZE
+/* Size of the RX byte stream */
+#define SERIAL_TASK_RX_BUFFER_SIZE   256
 #define SERIAL_TASK_TRIGGER_LEVEL     1
 
+/* Size of the TX ring, a power of two */
+#define SERIAL_TASK_TX_RING_SIZE     2048u
+
+/* Period at which the TX task looks for bytes queued from interrupts */
+#define SERIAL_TASK_TX_POLL_MS       10u
+
+/* Size of the circular RX DMA ring (independent of the RX stream) */
+#define SERIAL_TASK_RX_DMA_SIZE      256
+
+/* Largest single TX DMA transfer, and slack added to the TX completion timeout */
+#define SERIAL_TASK_TX_DMA_SIZE      256
+#define SERIAL_TASK_TX_TIMEOUT_MS    10u
+
+/* Bounce buffer of vSerialTaskWrite(), for data the UART DMA cannot reach */
+#define SERIAL_TASK_TX_BOUNCE_SIZE   512
+
 /* If defined, a loopback test task (RX->TX echo) will be available. */
 //#define SERIAL_TASK_LOOPBACK    /* comment out to disable loopback */
 
@@ -24,12 +53,47 @@ void vSerialTaskInit(UBaseType_t xTxPriority, UBaseType_t xRxPriority);
 void vSerialLoopbackTestStart(UBaseType_t uxPriority);
 #endif
 
-/* Get handles to the byte stream buffers */
+/* Get the handle of the RX byte stream */
 StreamBufferHandle_t xSerialTaskGetRxStreamHandle(void);
-StreamBufferHandle_t xSerialTaskGetTxStreamHandle(void);
 
-/* Send helpers for byte stream */
+/* Receive statistics */
+typedef struct
+{
+    uint32_t ulReceived;   /* bytes taken from the DMA ring */
+    uint32_t ulDropped;    /* bytes lost because the RX stream was full */
+    uint32_t ulOverruns;   /* UART overrun errors (DMA restarted) */
+    uint32_t ulErrors;     /* framing, noise and parity errors */
+} SerialRxStats_t;
+
+/* Get a snapshot of the receive statistics */
+void vSerialTaskGetRxStats(SerialRxStats_t *pxStats);
+
+/* Transmit statistics of the TX ring */
+typedef struct
+{
+    uint32_t ulQueued;     /* bytes written into the ring */
+    uint32_t ulDropped;    /* bytes lost because the ring was full */
+    uint32_t ulOverflows;  /* writes cut short or refused for lack of room */
+    size_t xUsed;          /* bytes waiting in the ring */
+    size_t xPeak;          /* most bytes seen waiting by the TX task */
+} SerialTxStats_t;
+
+/* Get a snapshot of the transmit statistics */
+void vSerialTaskGetTxStats(SerialTxStats_t *pxStats);
+
+/* Queue bytes on the TX ring; from any task or interrupt, never blocks.
+   What does not fit is dropped */
 void vSerialPutChar(char c);
 void vSerialPutString(const char * buf, size_t len);
 
+/* Queue bytes on the TX ring, waiting up to xTicksToWait for room (tasks
+   only; interrupts do not wait). A write that fits in the ring is queued
+   in one span, or not at all. Returns the number of bytes queued */
+size_t xSerialTaskPut(const void *pvData, size_t xLength, TickType_t xTicksToWait);
+
+/* Send a buffer by DMA, bypassing the TX ring, and wait until it is out:
+   straight from the buffer if the DMA can reach it (not in the TCM), through
+   a bounce buffer otherwise. Blocks while the TX task sends queued bytes */
+void vSerialTaskWrite(const void *pvData, size_t xLength);
+
 #endif /* INC_SERIALTASK_H_ */
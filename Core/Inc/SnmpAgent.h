@@ -0,0 +1,75 @@
+/* SnmpAgent.h
+ *
+ * Read-only SNMPv1/v2c agent serving the system, interfaces, IP, TCP and UDP
+ * groups of MIB-II (RFC 1213), for the NMS walking every device each minute.
+ *
+ * The objects are a table compiled in OID order, each with the kind of its
+ * index: a walk step is a binary search for the object and then for the next
+ * instance, never a scan of every object. The counters are those of the
+ * network statistics (net_stats.h), read once per request rather than per
+ * variable; TCP connections are listed from a sorted copy of the socket
+ * table, taken with the stack locked for the time of the copy only.
+ *
+ * The agent runs in a task of its own, below the real-time and network tasks,
+ * and serves at most SNMP_AGENT_MAX_RATE requests per second, with bursts of
+ * SNMP_AGENT_BURST: beyond, requests are dropped and the NMS retries, so a
+ * walk slows down rather than taking the CPU.
+ */
+#ifndef INC_SNMPAGENT_H_
+#define INC_SNMPAGENT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* Community granting read access */
+#define SNMP_AGENT_COMMUNITY           "public"
+
+/* Values of the system group */
+#define SNMP_AGENT_SYS_DESCR           "STM32H723 CycloneTCP node"
+#define SNMP_AGENT_SYS_CONTACT         ""
+#define SNMP_AGENT_SYS_LOCATION        ""
+
+/* Requests served per second, and the burst allowed above the rate */
+#define SNMP_AGENT_MAX_RATE            50u
+#define SNMP_AGENT_BURST               20u
+
+/* Variables of a request, and repetitions of a GetBulk served at most */
+#define SNMP_AGENT_MAX_VARBINDS        32u
+#define SNMP_AGENT_MAX_REPETITIONS     32u
+
+/* Largest response: one Ethernet frame without fragmentation */
+#define SNMP_AGENT_MAX_RESPONSE        1472u
+
+/* Stack of the task, in words */
+#define SNMP_AGENT_TASK_STACK_SIZE     768
+
+typedef struct
+{
+    uint32_t ulInPkts;
+    uint32_t ulOutPkts;
+    uint32_t ulBadVersions;
+    uint32_t ulBadCommunities;
+    uint32_t ulParseErrors;
+    uint32_t ulRateLimited;         /* Requests dropped above the rate */
+    uint32_t ulGets;
+    uint32_t ulGetNexts;
+    uint32_t ulGetBulks;
+    uint32_t ulSets;                /* Refused: the agent is read-only */
+    uint32_t ulVarbindsOut;
+    uint32_t ulTooBigs;
+} SnmpAgentStats_t;
+
+/**
+ * @brief  Create the agent task, which serves the SNMP port.
+ * @param  uxPriority  Task priority, below the real-time tasks.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xSnmpAgentStart(UBaseType_t uxPriority);
+
+void vSnmpAgentGetStats(SnmpAgentStats_t *pxStats);
+
+/* Register the "snmp" CLI command */
+void vSnmpAgentRegisterCLICommands(void);
+
+#endif /* INC_SNMPAGENT_H_ */
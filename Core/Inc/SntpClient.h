@@ -0,0 +1,92 @@
+/* SntpClient.h
+ *
+ * SNTPv4 client (RFC 4330) giving the board UTC when no PTP master is
+ * there, so that logs and telemetry carry comparable timestamps across the
+ * fleet.
+ *
+ * Each poll is a burst of SNTP_CLIENT_BURST requests; of the valid answers,
+ * the one with the smallest round-trip delay gives the offset, as its error
+ * is bounded by half that delay (the clock filter of NTP), and the spread of
+ * the others around it gives the jitter. The receive time of an answer is
+ * the one taken by the Ethernet driver (SocketMsg.rxTime), not the time the
+ * task got to it. The MAC time stamps PTP event frames only, so its
+ * hardware time stamps are not available for NTP.
+ *
+ * The microsecond clock itself is never changed (see MonoClock.c): the UTC
+ * time is published as its reference timescale, a linear map which is slewed
+ * rather than stepped. At each poll the map is restarted where it stands, at
+ * a rate that absorbs the offset by the next poll, within
+ * SNTP_CLIENT_MAX_SLEW_PPM, on top of the estimated frequency error of the
+ * local oscillator. Only the first synchronization, or an offset beyond
+ * SNTP_CLIENT_STEP_THRESHOLD_US, steps the map.
+ *
+ * PTP takes precedence: while the PTP slave is locked it owns the reference,
+ * and the client only measures.
+ */
+#ifndef INC_SNTPCLIENT_H_
+#define INC_SNTPCLIENT_H_
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* UDP port of the servers */
+#define SNTP_CLIENT_PORT               123u
+
+/* Seconds between polls */
+#define SNTP_CLIENT_POLL_S             64u
+
+/* Requests per poll, their spacing, and how long an answer is waited for */
+#define SNTP_CLIENT_BURST              4u
+#define SNTP_CLIENT_BURST_SPACING_MS   250u
+#define SNTP_CLIENT_TIMEOUT_MS         1000u
+
+/* Offsets beyond this step the reference instead of slewing it (as ntpd) */
+#define SNTP_CLIENT_STEP_THRESHOLD_US  128000
+
+/* Largest rate correction of the reference, frequency and slew together */
+#define SNTP_CLIENT_MAX_SLEW_PPM       500
+
+/* Weight of a new measurement in the frequency estimate, as a power of two */
+#define SNTP_CLIENT_FREQ_SHIFT         1
+
+/* Stack of the task, in words */
+#define SNTP_CLIENT_TASK_STACK_SIZE    384
+
+typedef struct
+{
+    BaseType_t xSynchronized;       /* The offsets below are from a server */
+    BaseType_t xPublished;          /* UTC is the reference of the clock */
+    uint32_t ulServerAddr;          /* IPv4 address, network byte order */
+    uint8_t ucStratum;
+    int64_t llOffsetUs;             /* Server minus local, at the last poll */
+    uint32_t ulDelayUs;             /* Round trip of the sample kept */
+    uint32_t ulJitterUs;            /* RMS of the burst around that sample */
+    int32_t lFreqPpb;               /* Frequency error of the local clock */
+    int32_t lRatePpb;               /* Rate of the reference, slew included */
+    uint32_t ulPolls;
+    uint32_t ulRequests;
+    uint32_t ulResponses;
+    uint32_t ulTimeouts;
+    uint32_t ulRejected;            /* Invalid, unsynchronized or kiss-o'-death */
+    uint32_t ulSteps;
+} SntpClientStats_t;
+
+/**
+ * @brief  Create the client task; it stays idle until configured.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xSntpClientStart(UBaseType_t uxPriority);
+
+/**
+ * @brief  Set the server, and poll it now.
+ * @param  pcAddress  IPv4 address, as text; NULL stops the client.
+ * @return pdPASS on success, pdFAIL if the address is invalid.
+ */
+BaseType_t xSntpClientConfigure(const char *pcAddress);
+
+void vSntpClientGetStats(SntpClientStats_t *pxStats);
+
+/* Register the "sntp" CLI command */
+void vSntpClientRegisterCLICommands(void);
+
+#endif /* INC_SNTPCLIENT_H_ */
@@ -0,0 +1,150 @@
+/* StaticAlloc.h
+ *
+ * Static allocation profile of the application.
+ *
+ * With APP_STATIC_ALLOCATION set, the tasks of the application, their
+ * stacks, and the stream buffers, queues and mutexes they use are allocated
+ * at link time in APP_STATIC_SECTION rather than from the FreeRTOS heap, so
+ * that the map file gives the RAM they take and boot cannot fail on an
+ * exhausted or fragmented heap. The events, semaphores and mutexes of the
+ * TCP/IP stack are static already (os_port_freertos.c, with
+ * configSUPPORT_STATIC_ALLOCATION), and the TCP/IP task is given its
+ * storage through its task parameters. The heap is then left to the
+ * network buffers and to the few objects whose size is only known at run
+ * time (the line buffers of the console engines).
+ *
+ * Each object is declared once with an APP_xxx_STORAGE macro at file scope
+ * and created with the matching xApp... macro, which falls back to the
+ * dynamic FreeRTOS call when the profile is off; the storage then expands
+ * to nothing. The _ARRAY variants serve per-session objects.
+ */
+#ifndef INC_STATICALLOC_H_
+#define INC_STATICALLOC_H_
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "stream_buffer.h"
+
+/* 1 for the static profile, 0 to allocate from the FreeRTOS heap */
+#define APP_STATIC_ALLOCATION              1
+
+/* Section of the static objects, in the AXI SRAM (see the linker scripts)
+ * where the DMA controllers reach buffers passed from a task stack. Not
+ * zeroed at start: every object is initialised by its create call */
+#define APP_STATIC_SECTION                 ".rtos_static"
+
+#if (APP_STATIC_ALLOCATION == 1)
+
+#if (configSUPPORT_STATIC_ALLOCATION != 1)
+#error "APP_STATIC_ALLOCATION requires configSUPPORT_STATIC_ALLOCATION"
+#endif
+
+#define APP_STATIC_DATA                    __attribute__((section(APP_STATIC_SECTION), aligned(8)))
+
+/* Tasks: TCB and stack, the stack depth in words */
+#define APP_TASK_STORAGE(xName, uxStackWords) \
+    static StaticTask_t xName##Tcb APP_STATIC_DATA; \
+    static StackType_t xName##Stack[(uxStackWords)] APP_STATIC_DATA
+#define APP_TASK_STORAGE_ARRAY(xName, uxCount, uxStackWords) \
+    static StaticTask_t xName##Tcb[(uxCount)] APP_STATIC_DATA; \
+    static StackType_t xName##Stack[(uxCount)][(uxStackWords)] APP_STATIC_DATA
+/* Task storage in another section, e.g. the DTCM (TcmPlacement.h) */
+#define APP_TASK_STORAGE_IN(xName, uxStackWords, pcSection) \
+    static StaticTask_t xName##Tcb __attribute__((section(pcSection), aligned(8))); \
+    static StackType_t xName##Stack[(uxStackWords)] __attribute__((section(pcSection), aligned(8)))
+
+#define xAppTaskCreate(xName, pxCode, pcName, uxStackWords, pvParam, uxPriority, pxHandle) \
+    xAppTaskCreateStatic((pxCode), (pcName), (uxStackWords), (pvParam), (uxPriority), (pxHandle), \
+                         xName##Stack, &xName##Tcb)
+#define xAppTaskCreateAt(xName, uxIndex, pxCode, pcName, uxStackWords, pvParam, uxPriority, pxHandle) \
+    xAppTaskCreateStatic((pxCode), (pcName), (uxStackWords), (pvParam), (uxPriority), (pxHandle), \
+                         xName##Stack[(uxIndex)], &xName##Tcb[(uxIndex)])
+
+/* Stream buffers: the storage area takes one byte more than the size */
+#define APP_STREAM_STORAGE(xName, xSize) \
+    static StaticStreamBuffer_t xName##Struct APP_STATIC_DATA; \
+    static uint8_t xName##Area[(xSize) + 1] APP_STATIC_DATA
+#define APP_STREAM_STORAGE_ARRAY(xName, uxCount, xSize) \
+    static StaticStreamBuffer_t xName##Struct[(uxCount)] APP_STATIC_DATA; \
+    static uint8_t xName##Area[(uxCount)][(xSize) + 1] APP_STATIC_DATA
+
+#define xAppStreamBufferCreate(xName, xSize, xTrigger) \
+    xStreamBufferCreateStatic((xSize), (xTrigger), xName##Area, &xName##Struct)
+#define xAppStreamBufferCreateAt(xName, uxIndex, xSize, xTrigger) \
+    xStreamBufferCreateStatic((xSize), (xTrigger), xName##Area[(uxIndex)], &xName##Struct[(uxIndex)])
+
+/* Mutexes, and binary and counting semaphores which use the same storage */
+#define APP_MUTEX_STORAGE(xName) \
+    static StaticSemaphore_t xName##Struct APP_STATIC_DATA
+#define APP_MUTEX_STORAGE_ARRAY(xName, uxCount) \
+    static StaticSemaphore_t xName##Struct[(uxCount)] APP_STATIC_DATA
+
+#define xAppSemaphoreCreateMutex(xName) \
+    xSemaphoreCreateMutexStatic(&xName##Struct)
+#define xAppSemaphoreCreateMutexAt(xName, uxIndex) \
+    xSemaphoreCreateMutexStatic(&xName##Struct[(uxIndex)])
+#define xAppSemaphoreCreateBinary(xName) \
+    xSemaphoreCreateBinaryStatic(&xName##Struct)
+#define xAppSemaphoreCreateCounting(xName, uxMax, uxInitial) \
+    xSemaphoreCreateCountingStatic((uxMax), (uxInitial), &xName##Struct)
+
+/* Queues */
+#define APP_QUEUE_STORAGE(xName, uxLength, xItemSize) \
+    static StaticQueue_t xName##Struct APP_STATIC_DATA; \
+    static uint8_t xName##Area[(uxLength) * (xItemSize)] APP_STATIC_DATA
+
+#define xAppQueueCreate(xName, uxLength, xItemSize) \
+    xQueueCreateStatic((uxLength), (xItemSize), xName##Area, &xName##Struct)
+
+/* xTaskCreate() semantics over xTaskCreateStatic() */
+static inline BaseType_t xAppTaskCreateStatic(TaskFunction_t pxCode, const char *pcName, uint32_t ulStackWords,
+                                              void *pvParam, UBaseType_t uxPriority, TaskHandle_t *pxHandle,
+                                              StackType_t *pxStack, StaticTask_t *pxTcb)
+{
+    TaskHandle_t xHandle = xTaskCreateStatic(pxCode, pcName, ulStackWords, pvParam, uxPriority, pxStack, pxTcb);
+
+    if (pxHandle != NULL)
+    {
+        *pxHandle = xHandle;
+    }
+
+    return (xHandle != NULL) ? pdPASS : pdFAIL;
+}
+
+#else
+
+#define APP_TASK_STORAGE(xName, uxStackWords)
+#define APP_TASK_STORAGE_ARRAY(xName, uxCount, uxStackWords)
+#define APP_TASK_STORAGE_IN(xName, uxStackWords, pcSection)
+#define xAppTaskCreate(xName, pxCode, pcName, uxStackWords, pvParam, uxPriority, pxHandle) \
+    xTaskCreate((pxCode), (pcName), (uxStackWords), (pvParam), (uxPriority), (pxHandle))
+#define xAppTaskCreateAt(xName, uxIndex, pxCode, pcName, uxStackWords, pvParam, uxPriority, pxHandle) \
+    xTaskCreate((pxCode), (pcName), (uxStackWords), (pvParam), (uxPriority), (pxHandle))
+
+#define APP_STREAM_STORAGE(xName, xSize)
+#define APP_STREAM_STORAGE_ARRAY(xName, uxCount, xSize)
+#define xAppStreamBufferCreate(xName, xSize, xTrigger) \
+    xStreamBufferCreate((xSize), (xTrigger))
+#define xAppStreamBufferCreateAt(xName, uxIndex, xSize, xTrigger) \
+    xStreamBufferCreate((xSize), (xTrigger))
+
+#define APP_MUTEX_STORAGE(xName)
+#define APP_MUTEX_STORAGE_ARRAY(xName, uxCount)
+#define xAppSemaphoreCreateMutex(xName) \
+    xSemaphoreCreateMutex()
+#define xAppSemaphoreCreateMutexAt(xName, uxIndex) \
+    xSemaphoreCreateMutex()
+#define xAppSemaphoreCreateBinary(xName) \
+    xSemaphoreCreateBinary()
+#define xAppSemaphoreCreateCounting(xName, uxMax, uxInitial) \
+    xSemaphoreCreateCounting((uxMax), (uxInitial))
+
+#define APP_QUEUE_STORAGE(xName, uxLength, xItemSize)
+#define xAppQueueCreate(xName, uxLength, xItemSize) \
+    xQueueCreate((uxLength), (xItemSize))
+
+#endif /* APP_STATIC_ALLOCATION */
+
+#endif /* INC_STATICALLOC_H_ */
@@ -0,0 +1,101 @@
+/* SyslogSink.h
+ *
+ * Remote log sink: the messages formatted by the log task (DeferredLog.h)
+ * are also sent to a syslog collector over UDP, as RFC 5424 messages.
+ *
+ * Messages are batched, several per datagram and one per line, and a batch
+ * goes out when it is full or SYSLOG_SINK_FLUSH_MS after its first message;
+ * SYSLOG_SINK_BATCH set to 0 sends one message per datagram as RFC 5426
+ * expects, for collectors that do not split datagrams on line ends. Each
+ * source (source file, as for the log levels) has a token bucket: past its
+ * burst, its messages are counted and dropped, and the count is sent once
+ * the source is allowed again. When a batch cannot be sent, it is dropped
+ * as a whole rather than held, so that a dead link never backs up into the
+ * log ring.
+ *
+ * Once the microsecond clock has a reference timescale (SntpClient.h,
+ * PtpSlave.h), the messages carry the time they were written, to the
+ * millisecond of the tick; the PTP timescale is TAI, ahead of UTC by the
+ * leap seconds. The date and the time of day are cached by the formatter
+ * (formatTimestamp() of date_time.h), so that a timestamp costs a few
+ * divisions at any message rate. Before synchronization the timestamp is
+ * the NILVALUE. The "meta" structured data gives the uptime at the time the
+ * message was written and a sequence number, for the collector to order
+ * messages and count losses.
+ */
+#ifndef INC_SYSLOGSINK_H_
+#define INC_SYSLOGSINK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* 1 to build the sink, 0 to compile it out */
+#define SYSLOG_SINK                    1
+
+/* Default UDP port of the collector */
+#define SYSLOG_SINK_PORT               514u
+
+/* 1 to send several messages per datagram, one per line */
+#define SYSLOG_SINK_BATCH              1
+
+/* Largest datagram, within one Ethernet frame */
+#define SYSLOG_SINK_DATAGRAM_SIZE      1200u
+
+/* Longest time a message waits in a batch */
+#define SYSLOG_SINK_FLUSH_MS           250u
+
+/* Sources with a token bucket of their own; the others share the last one */
+#define SYSLOG_SINK_MAX_SOURCES        8
+
+/* Default rate limit of each source: messages per second, and burst */
+#define SYSLOG_SINK_RATE               20u
+#define SYSLOG_SINK_BURST              50u
+
+/* Syslog facility of every message (local0) */
+#define SYSLOG_SINK_FACILITY           16u
+
+typedef struct
+{
+    uint32_t ulSubmitted;           /* Messages handed to the sink */
+    uint32_t ulSent;                /* Messages in datagrams sent */
+    uint32_t ulDatagrams;
+    uint32_t ulRateLimited;         /* Messages over the rate of their source */
+    uint32_t ulDropped;             /* Messages in batches that could not be sent */
+    uint32_t ulSendErrors;
+} SyslogSinkStats_t;
+
+/**
+ * @brief  Set the collector.
+ * @param  pcAddress  IPv4 address, as text; NULL stops the sink.
+ * @param  usPort     UDP port, 0 for SYSLOG_SINK_PORT.
+ * @return pdPASS on success, pdFAIL if the address is invalid.
+ */
+BaseType_t xSyslogSinkConfigure(const char *pcAddress, uint16_t usPort);
+
+/* Rate limit of every source, in messages per second; 0 for no limit */
+void vSyslogSinkSetRate(uint32_t ulRate, uint32_t ulBurst);
+
+/**
+ * @brief  Queue a message; called by the log task only.
+ * @param  ucLevel        TRACE_LEVEL_xxx of the message.
+ * @param  pcSource       Source name, xSourceLength characters.
+ * @param  ulTick         Tick count when the message was written.
+ * @param  pcText         Message, line ends included.
+ */
+void vSyslogSinkSubmit(uint8_t ucLevel, const char *pcSource, size_t xSourceLength,
+                       uint32_t ulTick, const char *pcText, size_t xLength);
+
+/**
+ * @brief  Send the pending batch if it is due, or now if xForce is set.
+ *         Called by the log task only.
+ * @return Ticks until the pending batch is due, portMAX_DELAY if none.
+ */
+TickType_t xSyslogSinkFlush(BaseType_t xForce);
+
+void vSyslogSinkGetStats(SyslogSinkStats_t *pxStats);
+
+/* Register the "syslog" CLI command */
+void vSyslogSinkRegisterCLICommands(void);
+
+#endif /* INC_SYSLOGSINK_H_ */
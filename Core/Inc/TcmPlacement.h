@@ -0,0 +1,41 @@
+/* TcmPlacement.h
+ *
+ * Placement of the hot path in the tightly coupled memories of the
+ * Cortex-M7. Code in ".itcm_text" is copied to the ITCM at start and runs
+ * with no wait state, whatever the state of the flash cache lines; data in
+ * ".dtcm_bss" is reached by the CPU in a single cycle, but by no DMA
+ * controller except the MDMA. Besides the functions marked TCM_CODE below
+ * and __net_fast_func in CycloneTCP (NET_FAST_CODE_SECTION), the linker
+ * scripts place the FreeRTOS scheduler and libudpard objects in the ITCM.
+ *
+ * The "tcm" command reports the use of both memories, where the hot
+ * functions run from and what they take in cycles. The flash layout to
+ * compare with is built with TCM_PLACEMENT set to 0, NET_FAST_CODE_SECTION
+ * and SOCKET_TABLE_SECTION left undefined and the object lines of the
+ * .itcm_text section removed.
+ */
+#ifndef INC_TCMPLACEMENT_H_
+#define INC_TCMPLACEMENT_H_
+
+/* 1 to run the hot path from the TCMs, 0 for the default sections */
+#define TCM_PLACEMENT                  1
+
+/* Sections of the linker scripts */
+#define TCM_CODE_SECTION               ".itcm_text"
+#define TCM_DATA_SECTION               ".dtcm_bss"
+
+/* Iterations of each measurement of the "tcm" command, the best is kept */
+#define TCM_BENCH_RUNS                 32
+
+#if (TCM_PLACEMENT == 1)
+#define TCM_CODE                       __attribute__((section(TCM_CODE_SECTION)))
+#define TCM_BSS                        __attribute__((section(TCM_DATA_SECTION)))
+#else
+#define TCM_CODE
+#define TCM_BSS
+#endif
+
+/* Register the "tcm" CLI command */
+void vTcmPlacementRegisterCLICommands(void);
+
+#endif /* INC_TCMPLACEMENT_H_ */
@@ -0,0 +1,117 @@
+/* TelemetryEncoder.h
+ *
+ * Streaming encoder of telemetry documents, in CBOR (RFC 8949) or compact
+ * JSON through the same calls: maps, arrays, keys and values are written in
+ * order straight into a buffer owned by the caller, without allocation and
+ * without formatting into temporary strings.
+ *
+ * When the buffer fills up, its content is handed to a flush callback and
+ * the buffer reused, so that a document of any size leaves through a small
+ * one, piece by piece: one chunk each of the body of an HTTP request with
+ * xTelemetryHttpFlush(). Without a callback the document must fit: an MQTT
+ * publish buffer, a Cyphal transfer payload or a UDP datagram, sent by the
+ * caller once xTelemetryFinish() succeeded.
+ *
+ * Errors are sticky: a failed flush, a full buffer without a callback, or
+ * containers nested deeper than TELEMETRY_MAX_DEPTH turn the calls that
+ * follow into no-ops and are reported by xTelemetryFinish(), so that the
+ * fields of a document are written without checking each one.
+ *
+ * Decimal values are a mantissa and a count of decimals, carried as decimal
+ * fractions (tag 4) in CBOR and as numbers in JSON, without floating point
+ * formatting. Containers of unknown size take indefinite lengths in CBOR;
+ * the count of a definite one is not checked. Values written at the top
+ * level follow each other as a CBOR sequence, or one JSON text per line.
+ */
+#ifndef INC_TELEMETRYENCODER_H_
+#define INC_TELEMETRYENCODER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* Containers open at once */
+#define TELEMETRY_MAX_DEPTH            16u
+
+/* Element count of a container whose size is not known in advance */
+#define TELEMETRY_INDEFINITE           0xFFFFFFFFu
+
+/* Decimals of a decimal value, beyond which it is rejected */
+#define TELEMETRY_MAX_DECIMALS         18u
+
+typedef enum
+{
+    eTelemetryCbor = 0,
+    eTelemetryJson
+} TelemetryFormat_t;
+
+/* Takes the xLength bytes of a full buffer; pdPASS if they were sent */
+typedef BaseType_t (*TelemetryFlush_t)(void *pvContext, const uint8_t *pucData, size_t xLength);
+
+typedef struct
+{
+    uint8_t *pucBuffer;
+    size_t xSize;
+    size_t xUsed;
+    size_t xFlushed;                    /* Handed to the callback */
+    TelemetryFlush_t pxFlush;
+    void *pvContext;
+    TelemetryFormat_t eFormat;
+    BaseType_t xError;
+    BaseType_t xAfterKey;
+    uint32_t ulDepth;
+    uint32_t ulNotEmpty;                /* One bit per depth */
+    uint32_t ulMaps;
+    uint32_t ulIndefinite;
+} TelemetryEncoder_t;
+
+/**
+ * @brief  Start a document.
+ * @param  pxFlush    Callback taking the buffer when it is full, NULL if the
+ *                    document must fit in it.
+ * @param  pvContext  Passed to the callback.
+ */
+void vTelemetryInit(TelemetryEncoder_t *pxEnc, TelemetryFormat_t eFormat, uint8_t *pucBuffer, size_t xSize,
+                    TelemetryFlush_t pxFlush, void *pvContext);
+
+/* Open a map or an array of ulCount elements (pairs for a map), or of
+ * TELEMETRY_INDEFINITE; vTelemetryEnd() closes the last one opened */
+void vTelemetryBeginMap(TelemetryEncoder_t *pxEnc, uint32_t ulCount);
+void vTelemetryBeginArray(TelemetryEncoder_t *pxEnc, uint32_t ulCount);
+void vTelemetryEnd(TelemetryEncoder_t *pxEnc);
+
+/* Key of the next value of a map */
+void vTelemetryKey(TelemetryEncoder_t *pxEnc, const char *pcKey);
+
+/* Values */
+void vTelemetryUint(TelemetryEncoder_t *pxEnc, uint64_t ullValue);
+void vTelemetryInt(TelemetryEncoder_t *pxEnc, int64_t llValue);
+void vTelemetryDecimal(TelemetryEncoder_t *pxEnc, int64_t llMantissa, uint32_t ulDecimals);
+void vTelemetryBool(TelemetryEncoder_t *pxEnc, BaseType_t xValue);
+void vTelemetryNull(TelemetryEncoder_t *pxEnc);
+void vTelemetryString(TelemetryEncoder_t *pxEnc, const char *pcValue);
+/* A byte string in CBOR, a string of hexadecimal digits in JSON */
+void vTelemetryBytes(TelemetryEncoder_t *pxEnc, const uint8_t *pucData, size_t xLength);
+
+/* A key and its value */
+void vTelemetryFieldUint(TelemetryEncoder_t *pxEnc, const char *pcKey, uint64_t ullValue);
+void vTelemetryFieldInt(TelemetryEncoder_t *pxEnc, const char *pcKey, int64_t llValue);
+void vTelemetryFieldDecimal(TelemetryEncoder_t *pxEnc, const char *pcKey, int64_t llMantissa, uint32_t ulDecimals);
+void vTelemetryFieldBool(TelemetryEncoder_t *pxEnc, const char *pcKey, BaseType_t xValue);
+void vTelemetryFieldString(TelemetryEncoder_t *pxEnc, const char *pcKey, const char *pcValue);
+
+/**
+ * @brief  End the document, handing what is left to the callback if any.
+ * @return pdPASS if every container was closed and nothing failed.
+ */
+BaseType_t xTelemetryFinish(TelemetryEncoder_t *pxEnc);
+
+/* Bytes of the document so far, flushed or in the buffer */
+size_t xTelemetryLength(const TelemetryEncoder_t *pxEnc);
+
+/* Flush callback writing each buffer as a part of the body of an HTTP
+ * request (one chunk with chunked transfer encoding); pvContext is the
+ * HttpClientContext, whose request header was written */
+BaseType_t xTelemetryHttpFlush(void *pvContext, const uint8_t *pucData, size_t xLength);
+
+#endif /* INC_TELEMETRYENCODER_H_ */
@@ -5,22 +5,54 @@
 #include "FreeRTOS.h"
 #include "stream_buffer.h"
 #include "task.h"
+#include "core/net.h"
+#include "core/socket_reactor.h"
+
+/* Number of concurrent Telnet sessions (at most 16) */
+#define TELNET_MAX_SESSIONS      2
+
+/* Notification bits sent to the console task registered with vTelnetTaskSetConsoleTask() */
+#define TELNET_NOTIFY_RX(s)      ( 1UL << ( s ) )          // input pending on session s
+#define TELNET_NOTIFY_OPEN(s)    ( 1UL << ( ( s ) + 16 ) ) // a client attached to session s
 
 /**
  * @brief  Get the handle to the Rx stream buffer for Telnet input.
+ * @param  uxSession  Session index, 0 to TELNET_MAX_SESSIONS - 1.
+ */
+StreamBufferHandle_t xTelnetTaskGetRxStreamHandle(UBaseType_t uxSession);
+
+/**
+ * @brief  Register the task notified when a session receives input or opens.
+ * @param  xTask  Task handle; notified with TELNET_NOTIFY_RX / TELNET_NOTIFY_OPEN bits.
  */
-StreamBufferHandle_t xTelnetTaskGetRxStreamHandle(void);
+void vTelnetTaskSetConsoleTask(TaskHandle_t xTask);
 
 /**
- * @brief  Get the handle to the Tx stream buffer for Telnet output.
+ * @brief  Write console output straight into the TX buffer of a session's
+ *         socket, and push it out.
+ * @param  uxSession  Session index.
+ * @param  pvData     Data to send to the Telnet client.
+ * @param  xLength    Number of bytes to send.
+ * @return Number of bytes consumed (always xLength; output is dropped when no
+ *         client is attached, and the call blocks while the TCP window keeps
+ *         the TX buffer full).
  */
-StreamBufferHandle_t xTelnetTaskGetTxStreamHandle(void);
+size_t xTelnetTaskWrite(UBaseType_t uxSession, const void *pvData, size_t xLength);
 
 /**
- * @brief  Create and start the TelnetTask.
- * @param  uxPriority  Task priority for the TelnetTask.
+ * @brief  Create the session resources (the Rx streams the console reads).
+ * @param  uxPriority  Unused: the sessions are served by the socket reactor.
  * @return pdPASS on success, pdFAIL otherwise.
  */
 BaseType_t xTelnetTaskStart(UBaseType_t uxPriority);
 
+/**
+ * @brief  Open the listening socket and serve the sessions from a socket
+ *         reactor, instead of one task per session. Called once the TCP/IP
+ *         stack is started.
+ * @param  pxReactor  Reactor running the socket handlers.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xTelnetTaskListen(SocketReactorContext *pxReactor);
+
 #endif // TELNET_TASK_H
@@ -0,0 +1,84 @@
+/* TftpServer.h
+ *
+ * Write-only TFTP server (RFC 1350) for pushing firmware images to the
+ * board, with the option extension (RFC 2347), blksize up to one Ethernet
+ * frame (RFC 2348), timeout and tsize (RFC 2349) and windowsize (RFC 7440):
+ * the client sends windowsize blocks per acknowledgment instead of one, so a
+ * transfer is no longer bounded by one round trip per block.
+ *
+ * Blocks are taken on the UDP fast path of the transfer port, in the TCP/IP
+ * task: each in-order block is copied into a ring, and the window is
+ * acknowledged at once if the ring has room for the next one. The server
+ * task drains the ring into the sink; while the sink is behind, the
+ * acknowledgment of a full window waits for room, which paces the client
+ * without losing blocks. A block out of order is answered with the
+ * acknowledgment of the last block in order, from which the client resends
+ * the window. The last block is acknowledged only once the sink has stored
+ * the whole file.
+ *
+ * One transfer runs at a time; a write request meanwhile is refused as busy.
+ */
+#ifndef INC_TFTPSERVER_H_
+#define INC_TFTPSERVER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* Largest blksize: an Ethernet frame less the IPv4, UDP and TFTP headers */
+#define TFTP_SERVER_MAX_BLOCK_SIZE     1468u
+
+/* Largest windowsize granted; a window also never exceeds half the ring */
+#define TFTP_SERVER_MAX_WINDOW         16u
+
+/* Ring between the fast path and the sink, in bytes */
+#define TFTP_SERVER_RING_SIZE          32768u
+
+/* Timeout, unless the client sets one, and retransmissions before giving up */
+#define TFTP_SERVER_TIMEOUT_S          2u
+#define TFTP_SERVER_RETRIES            5u
+
+/* Stack of the task, in words */
+#define TFTP_SERVER_TASK_STACK_SIZE    512
+
+/* Where the files go. Write() is called with the data in order, Close()
+ * once, and last; each returns pdFAIL on error, which ends the transfer.
+ * Open() may take long (an erase): the write request is answered after it */
+typedef struct
+{
+    BaseType_t (*pxOpen)(const char *pcName, uint32_t ulSize);     /* ulSize 0 if not announced */
+    BaseType_t (*pxWrite)(const uint8_t *pucData, size_t xLength);
+    BaseType_t (*pxClose)(BaseType_t xCommit);                     /* pdFALSE to discard */
+    uint32_t ulCapacity;                                           /* Largest file, in bytes */
+} TftpSink_t;
+
+typedef struct
+{
+    uint32_t ulTransfers;
+    uint32_t ulCompleted;
+    uint32_t ulFailed;
+    uint32_t ulRefused;             /* Busy, read requests, bad options */
+    uint32_t ulBytes;               /* Of the completed transfers */
+    uint32_t ulLastBytes;
+    uint32_t ulLastMs;
+    uint32_t ulLastBlockSize;
+    uint32_t ulLastWindow;
+    uint32_t ulOutOfOrder;          /* Blocks answered with an earlier ACK */
+    uint32_t ulDeferredAcks;        /* Windows acknowledged late, sink behind */
+    uint32_t ulTimeouts;
+} TftpServerStats_t;
+
+/**
+ * @brief  Create the server task.
+ * @param  uxPriority  Task priority.
+ * @param  pxSink      Where the files written go.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xTftpServerStart(UBaseType_t uxPriority, const TftpSink_t *pxSink);
+
+void vTftpServerGetStats(TftpServerStats_t *pxStats);
+
+/* Register the "tftp" CLI command */
+void vTftpServerRegisterCLICommands(void);
+
+#endif /* INC_TFTPSERVER_H_ */
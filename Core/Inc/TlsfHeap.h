@@ -0,0 +1,81 @@
+/* TlsfHeap.h
+ *
+ * Two-level segregated fit allocator behind osAllocMem() / osFreeMem().
+ *
+ * heap_4 walks its free list to find a block and suspends the scheduler for
+ * the walk, so the time an allocation takes grows with the fragmentation of
+ * the heap. TLSF keeps one free list per size class, a class being a power
+ * of two (first level) split in TLSF_SL_COUNT linear steps (second level),
+ * with a bitmap of the non-empty lists at each level: finding a block, and
+ * merging a freed block with its neighbours, take a fixed number of steps
+ * whatever the state of the heap. The short critical section of each call
+ * masks the interrupts up to configMAX_SYSCALL_INTERRUPT_PRIORITY, so the
+ * allocator may also be called from interrupts.
+ *
+ * The FreeRTOS objects keep using heap_4; TLSF serves the TCP/IP stack,
+ * whose network buffers come through osAllocMem() when the memory pool
+ * (NET_MEM_POOL_SUPPORT) is disabled.
+ */
+#ifndef INC_TLSFHEAP_H_
+#define INC_TLSFHEAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* 1 to serve osAllocMem() / osFreeMem() from TLSF, 0 for heap_4 */
+#define TLSF_HEAP_SUPPORT              1
+
+/* Size of the TLSF pool, placed in the AXI SRAM where the Ethernet DMA
+ * reaches network buffers; at most 1 << TLSF_FL_MAX bytes */
+#define TLSF_HEAP_SIZE                 (32u * 1024u)
+
+/* 1 to check the whole heap after every allocation and free (debug: the
+ * check walks every block, with interrupts masked) */
+#define TLSF_HEAP_CHECK                0
+
+/* Second-level subdivisions of each power of two, as a power of two */
+#define TLSF_SL_LOG2                   4
+
+/* Largest block class, as a power of two */
+#define TLSF_FL_MAX                    16
+
+/* State and usage of the heap */
+typedef struct
+{
+    size_t xSize;                   /* Bytes available to blocks at start */
+    size_t xFree;                   /* Bytes in free blocks */
+    size_t xMinFree;                /* Lowest xFree since start */
+    size_t xLargestFree;            /* Largest block that can be allocated */
+    uint32_t ulFreeBlocks;
+    uint32_t ulUsedBlocks;
+    uint32_t ulAllocations;
+    uint32_t ulFrees;
+    uint32_t ulFailures;            /* Allocations refused */
+    uint32_t ulFragmentationPermille;   /* 1000 * (1 - largest / free) */
+    uint32_t ulMaxAllocCycles;      /* Slowest allocation, in CPU cycles */
+    uint32_t ulMaxFreeCycles;       /* Slowest free, in CPU cycles */
+} TlsfHeapStats_t;
+
+/**
+ * @brief  Allocate xSize bytes, 8-byte aligned. Task or interrupt context.
+ * @return The block, or NULL if no free block is large enough.
+ */
+void *pvTlsfHeapAlloc(size_t xSize);
+
+/* Free a block returned by pvTlsfHeapAlloc(); NULL is ignored */
+void vTlsfHeapFree(void *pv);
+
+void vTlsfHeapGetStats(TlsfHeapStats_t *pxStats);
+
+/**
+ * @brief  Walk every block and check the physical chain, the free lists and
+ *         their bitmaps against each other.
+ * @return pdPASS if the heap is consistent, pdFAIL otherwise.
+ */
+BaseType_t xTlsfHeapCheck(void);
+
+/* Register the "tlsf" CLI command */
+void vTlsfHeapRegisterCLICommands(void);
+
+#endif /* INC_TLSFHEAP_H_ */
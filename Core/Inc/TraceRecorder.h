@@ -0,0 +1,124 @@
+/* TraceRecorder.h
+ *
+ * Binary event trace of the scheduler, the interrupts, the queues and stream
+ * buffers and the TCP/IP stack, streamed over UDP to a host that decodes it
+ * (Tools/trace_decode.py).
+ *
+ * Each event is a fixed-size record: the low 32 bits of the DWT cycle
+ * counter, a type, a small identifier (task number, interrupt source, queue
+ * type...), a 16-bit argument and the address of the object involved. The
+ * records go to a ring buffer of the DTCM that tasks and interrupts reserve
+ * slots in with LDREX / STREX, so recording never masks interrupts nor
+ * takes a lock; the hooks of the FreeRTOS trace macros and of the
+ * interrupt handlers may therefore run in any context. The ring is drained
+ * by a low priority task into datagrams whose header carries the 64-bit
+ * cycle count at sending time, from which the host rebuilds the full time
+ * of each record. When the ring is full new events are dropped and counted,
+ * the count being sent with each datagram. While no host is set, the
+ * streamer drops the oldest records instead, keeping the latest half of the
+ * ring for the crash dumps (CrashDump.h).
+ *
+ * The event types and the hooks, needed by FreeRTOSConfig.h before any
+ * FreeRTOS type exists, are in TraceRecorderHooks.h. The hooks cost a load
+ * and a branch while no trace is running. Tracing itself shows in the
+ * trace: the streamer task and the datagrams it sends go through the same
+ * scheduler and stack as the rest.
+ */
+#ifndef INC_TRACERECORDER_H_
+#define INC_TRACERECORDER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "TraceRecorderHooks.h"
+
+/* Records of the ring buffer, a power of two */
+#define TRACE_RECORDER_EVENTS          1024u
+
+/* Records per datagram; with the header, a datagram fits in one frame */
+#define TRACE_STREAM_MAX_EVENTS        112u
+
+/* Period at which the ring buffer is drained, in milliseconds */
+#define TRACE_STREAM_PERIOD_MS         10u
+
+/* Period at which the task list is sent again, in milliseconds */
+#define TRACE_STREAM_TASKS_PERIOD_MS   1000u
+
+/* Default UDP port of the host */
+#define TRACE_STREAM_PORT              17000u
+
+/* Stack of the streamer task, in words */
+#define TRACE_STREAM_STACK_SIZE        384
+
+/* Most tasks described in a task list datagram */
+#define TRACE_STREAM_MAX_TASKS         24
+
+/* Datagram header */
+#define TRACE_STREAM_MAGIC             0x31435254u     /* "TRC1" */
+#define TRACE_STREAM_EVENTS            0u              /* Followed by TraceEvent_t records */
+#define TRACE_STREAM_TASKS             1u              /* Followed by TraceTaskEntry_t entries */
+
+/* Record of the ring buffer and of the event datagrams, little endian */
+typedef struct
+{
+    uint32_t ulCycles;              /* Low 32 bits of the cycle counter */
+    uint8_t ucType;                 /* TRACE_EVENT_xxx */
+    uint8_t ucId;
+    uint16_t usArg;
+    uint32_t ulObject;
+} TraceEvent_t;
+
+/* Header of every datagram */
+typedef struct
+{
+    uint32_t ulMagic;               /* TRACE_STREAM_MAGIC */
+    uint16_t usKind;                /* TRACE_STREAM_EVENTS or TRACE_STREAM_TASKS */
+    uint16_t usCount;               /* Records or entries that follow */
+    uint32_t ulSequence;            /* Datagrams sent since the trace started */
+    uint32_t ulDropped;             /* Events dropped since the trace started */
+    uint64_t ullCycles;             /* Cycle counter when the datagram was built */
+    uint32_t ulCpuHz;               /* Rate of the cycle counter */
+} __attribute__((packed)) TraceStreamHeader_t;
+
+/* Entry of a task list datagram */
+typedef struct
+{
+    uint16_t usNumber;              /* As in TRACE_EVENT_TASK_SWITCH */
+    uint8_t ucPriority;
+    uint8_t ucState;                /* eTaskState */
+    char cName[configMAX_TASK_NAME_LEN];
+} TraceTaskEntry_t;
+
+/**
+ * @brief  Set the host the trace is streamed to.
+ * @param  pcAddress  IPv4 address, as text; NULL keeps the current one.
+ * @param  usPort     UDP port, 0 for TRACE_STREAM_PORT.
+ * @return pdPASS on success, pdFAIL if the address is invalid.
+ */
+BaseType_t xTraceRecorderSetHost(const char *pcAddress, uint16_t usPort);
+
+/* pdTRUE once a host has been set */
+BaseType_t xTraceRecorderHasHost(void);
+
+/* Control of the recording, as used by the "trace" command */
+void vTraceStart(void);
+void vTraceStop(void);
+void vTraceClear(void);
+
+/* Events dropped since the trace started, ring buffer full */
+uint32_t ulTraceRecorderDropped(void);
+
+/**
+ * @brief  Copy the latest records still in the ring, oldest first, without
+ *         consuming them. Takes no lock: callable from a fault handler.
+ * @return Records copied, at most uxMax.
+ */
+UBaseType_t uxTraceRecorderLatest(TraceEvent_t *pxOut, UBaseType_t uxMax);
+
+/**
+ * @brief  Create the streamer task; it stays idle until a trace is started.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xTraceRecorderStart(UBaseType_t uxPriority);
+
+#endif /* INC_TRACERECORDER_H_ */
@@ -0,0 +1,55 @@
+/* TraceRecorderHooks.h
+ *
+ * Event types and recording hooks of the trace recorder (TraceRecorder.h).
+ * This header only needs <stdint.h>: FreeRTOSConfig.h includes it for the
+ * FreeRTOS trace macros, and the CycloneTCP configuration for the hooks of
+ * the stack.
+ */
+#ifndef INC_TRACERECORDERHOOKS_H_
+#define INC_TRACERECORDERHOOKS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* 1 to build the recorder and its hooks, 0 to compile them out */
+#define TRACE_RECORDER                 1
+
+/* Event types */
+#define TRACE_EVENT_NONE               0u   /* Slot reserved, not written yet */
+#define TRACE_EVENT_TASK_SWITCH        1u   /* ucId: task number */
+#define TRACE_EVENT_ISR_ENTER          2u   /* ucId: RUN_TIME_STATS_ISR_xxx */
+#define TRACE_EVENT_ISR_EXIT           3u
+#define TRACE_EVENT_QUEUE_SEND         4u   /* ucId: queue type; ulObject: queue */
+#define TRACE_EVENT_QUEUE_SEND_FAILED  5u
+#define TRACE_EVENT_QUEUE_RECEIVE      6u
+#define TRACE_EVENT_QUEUE_RECEIVE_FAILED 7u
+#define TRACE_EVENT_QUEUE_BLOCK_SEND   8u
+#define TRACE_EVENT_QUEUE_BLOCK_RECEIVE 9u
+#define TRACE_EVENT_STREAM_SEND        10u  /* usArg: bytes; ulObject: stream buffer */
+#define TRACE_EVENT_STREAM_RECEIVE     11u
+#define TRACE_EVENT_STREAM_BLOCK       12u  /* usArg: 0 on send, 1 on receive */
+#define TRACE_EVENT_USER               13u  /* ucId: TRACE_USER_xxx */
+
+/* Identifiers of the TRACE_EVENT_USER events */
+#define TRACE_USER_NET_EVENT_ENTER     0u   /* TCP/IP task handles NIC / PHY events */
+#define TRACE_USER_NET_EVENT_EXIT      1u
+#define TRACE_USER_NET_TICK_ENTER      2u   /* Periodic operations of the stack */
+#define TRACE_USER_NET_TICK_EXIT       3u   /* usArg: ms to the next one, capped */
+
+#if (TRACE_RECORDER == 1)
+
+/* Hooks of the FreeRTOS trace macros */
+void vTraceRecorderTaskSwitchedIn(uint32_t ulTaskNumber);
+void vTraceRecorderQueue(uint8_t ucType, const void *pvQueue, uint8_t ucQueueType);
+void vTraceRecorderStream(uint8_t ucType, const void *pvStreamBuffer, size_t xBytes);
+
+/* Hooks of the interrupt handlers, called by vRunTimeStatsIsrEnter / Exit */
+void vTraceRecorderIsrEnter(uint32_t ulSource);
+void vTraceRecorderIsrExit(uint32_t ulSource);
+
+/* Events of the application and of the stack; usable from any context */
+void vTraceRecorderUserEvent(uint8_t ucId, uint16_t usArg, uint32_t ulObject);
+
+#endif
+
+#endif /* INC_TRACERECORDERHOOKS_H_ */
@@ -0,0 +1,71 @@
+/* Watchdog.h
+ *
+ * Task supervision on the independent watchdog (IWDG1). Each critical task
+ * registers a heartbeat deadline and calls vWatchdogKick() once per pass of
+ * its loop; a task that blocks for input waits for WATCHDOG_IDLE_WAIT_MS at
+ * most, so that it kicks while idle as well. The supervisor task checks the
+ * heartbeats every WATCHDOG_PERIOD_MS and feeds the IWDG only while every
+ * registered task is within its deadline.
+ *
+ * Once a task is late, the supervisor stops feeding, logs the heartbeat
+ * statistics of every task, and WATCHDOG_REPORT_MS later writes a crash
+ * dump of the most overdue task (CrashDump.h), with the frame it was
+ * switched out with, and resets. If the supervisor itself stops running,
+ * at its priority or above, the IWDG resets the MCU WATCHDOG_TIMEOUT_MS
+ * after the last feed; the "crash" command then shows the IWDG1 reset flag.
+ *
+ * A deadline only counts from the first kick of the task, so that a task a
+ * profile leaves out, or that starts late, is not reported. The IWDG stops
+ * while the core is halted by a debugger.
+ */
+#ifndef INC_WATCHDOG_H_
+#define INC_WATCHDOG_H_
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Timeout of the IWDG, in milliseconds; 8191 at most */
+#define WATCHDOG_TIMEOUT_MS            4000u
+
+/* Period of the checks and of the feeds, in milliseconds */
+#define WATCHDOG_PERIOD_MS             250u
+
+/* Delay between the report of a late task and the reset, in milliseconds,
+ * for the log to go out */
+#define WATCHDOG_REPORT_MS             1000u
+
+/* Longest wait of a supervised task for input, in milliseconds */
+#define WATCHDOG_IDLE_WAIT_MS          1000u
+
+/* Default deadline of the supervised tasks, in milliseconds */
+#define WATCHDOG_DEADLINE_MS           3000u
+
+/* Tasks supervised, at most */
+#define WATCHDOG_MAX_TASKS             8
+
+/* Stack of the supervisor task, in words */
+#define WATCHDOG_STACK_SIZE            256
+
+/**
+ * @brief  Create the supervisor task, which starts the IWDG when it first
+ *         runs. Tasks may register before or after.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xWatchdogStart(UBaseType_t uxPriority);
+
+/**
+ * @brief  Supervise a task.
+ * @param  xTask         Task to supervise; NULL for the calling task.
+ * @param  ulDeadlineMs  Longest time between two kicks.
+ * @return pdPASS on success, pdFAIL if the table is full.
+ */
+BaseType_t xWatchdogRegister(TaskHandle_t xTask, uint32_t ulDeadlineMs);
+
+/* Heartbeat of the calling task; does nothing for a task not registered */
+void vWatchdogKick(void);
+
+/* Register the "watchdog" CLI command */
+void vWatchdogRegisterCLICommands(void);
+
+#endif /* INC_WATCHDOG_H_ */
@@ -0,0 +1,13 @@
+/* WebAssets.h
+ *
+ * Web UI packed into flash by Tools/pack_webui.py (WebAssets.c).
+ */
+#ifndef INC_WEBASSETS_H_
+#define INC_WEBASSETS_H_
+
+#include "HttpServer.h"
+
+extern const HttpAsset_t xWebAssets[];
+extern const size_t xWebAssetCount;
+
+#endif /* INC_WEBASSETS_H_ */
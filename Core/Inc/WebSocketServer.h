@@ -0,0 +1,88 @@
+/* WebSocketServer.h
+ *
+ * WebSocket server (RFC 6455) streaming live telemetry to the browser
+ * dashboards, instead of having them poll the device over HTTP.
+ *
+ * The application publishes binary frames from any task. Each frame is stored
+ * once, its header already formatted, in a ring of WS_SERVER_RING_FRAMES
+ * entries, and the server task sends it to every open client. A client is
+ * never waited for: its socket is written without blocking, and a client more
+ * than WS_SERVER_CLIENT_QUEUE frames behind skips the oldest ones, counted as
+ * dropped, so that a slow browser only loses frames of its own.
+ *
+ * Clients are pinged every WS_SERVER_PING_INTERVAL_MS and closed when nothing
+ * is heard from them for WS_SERVER_TIMEOUT_MS. Their masked frames are
+ * unmasked a word at a time; pings are answered, other data frames are
+ * ignored.
+ */
+#ifndef INC_WEBSOCKETSERVER_H_
+#define INC_WEBSOCKETSERVER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* TCP port, and the path of the telemetry stream */
+#define WS_SERVER_PORT                 8081u
+#define WS_SERVER_PATH                 "/telemetry"
+
+/* Browsers connected at once */
+#define WS_SERVER_MAX_CLIENTS          8
+
+/* Frames published and not yet sent to every client */
+#define WS_SERVER_RING_FRAMES          16u
+
+/* Frames a client may be behind before the oldest are dropped; less than
+   WS_SERVER_RING_FRAMES */
+#define WS_SERVER_CLIENT_QUEUE         8u
+
+/* Largest payload of a telemetry frame */
+#define WS_SERVER_MAX_PAYLOAD          512u
+
+/* Opening handshake request, and frames received from a client */
+#define WS_SERVER_RX_SIZE              512u
+
+/* Keepalive and timeouts */
+#define WS_SERVER_PING_INTERVAL_MS     10000u
+#define WS_SERVER_TIMEOUT_MS           30000u
+#define WS_SERVER_HANDSHAKE_TIMEOUT_MS 5000u
+
+/* Stack of the task, in words */
+#define WS_SERVER_TASK_STACK_SIZE      512
+
+typedef struct
+{
+    uint32_t ulPublished;
+    uint32_t ulSent;                /* Frames sent, to all clients together */
+    uint32_t ulDropped;             /* Frames skipped for slow clients */
+    uint32_t ulAccepted;
+    uint32_t ulRejected;            /* Bad handshakes, or no room left */
+    uint32_t ulTimedOut;
+} WebSocketServerStats_t;
+
+/**
+ * @brief  Create the server task.
+ * @param  uxPriority  Task priority.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t xWebSocketServerStart(UBaseType_t uxPriority);
+
+/**
+ * @brief  Send a binary frame to every connected client, without blocking on
+ *         any of them.
+ * @param  pvData   Payload, copied.
+ * @param  xLength  Up to WS_SERVER_MAX_PAYLOAD bytes.
+ * @return pdPASS on success, pdFAIL if the server is not started or the frame
+ *         too long.
+ */
+BaseType_t xWebSocketServerPublish(const void *pvData, size_t xLength);
+
+/* Clients with their opening handshake done */
+UBaseType_t uxWebSocketServerClients(void);
+
+void vWebSocketServerGetStats(WebSocketServerStats_t *pxStats);
+
+/* Register the "ws" CLI command */
+void vWebSocketServerRegisterCLICommands(void);
+
+#endif /* INC_WEBSOCKETSERVER_H_ */
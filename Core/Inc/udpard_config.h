@@ -0,0 +1,30 @@
+/* udpard_config.h
+ *
+ * Build configuration of libudpard, included by udpard.h and udpard.c:
+ * udpard.h names this header as the default UDPARD_CONFIG_HEADER, so every
+ * build picks it up without a compiler define.
+ */
+#ifndef INC_UDPARD_CONFIG_H_
+#define INC_UDPARD_CONFIG_H_
+
+#include "CyphalCrc.h"
+
+/* Transfer CRCs of long blocks on the CRC peripheral */
+#define UDPARD_TRANSFER_CRC_ADD_HOOK(crc, size, data, out) \
+    (xCyphalCrcAdd((crc), (size), (data), (out)) != pdFALSE)
+
+/* Sessions of node-IDs 0..127, the usual allocation range, are found by
+ * index rather than in the session tree: 512 bytes per RX port */
+#define UDPARD_RX_SESSION_TABLE_SIZE   128U
+
+/* TX queues as one FIFO per priority: constant-time enqueue and dequeue of
+ * the frames published every millisecond */
+#define UDPARD_TX_PRIORITY_FIFO        1U
+
+/* Fragments held per RX port by the transfers being reassembled, beyond
+ * which the oldest transfer of the port is evicted: transfers of up to
+ * 8 datagrams, about 11 KB at the default MTU. The node shares a global
+ * quota across its ports as well (CYPHAL_NODE_RX_QUOTA) */
+#define UDPARD_RX_FRAGMENT_QUOTA       8U
+
+#endif /* INC_UDPARD_CONFIG_H_ */
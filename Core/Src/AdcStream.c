@@ -0,0 +1,514 @@
+/* AdcStream.c
+ *
+ * ADC1, TIM6 and DMA1 stream 6 of the acquisition pipeline, and the stream
+ * task publishing the blocks (see AdcStream.h).
+ *
+ * The ADC and its timer are set up on their registers, as TIM5 is in
+ * MonoClock.c, the HAL ADC driver not being part of the build; the DMA
+ * stream goes through the HAL, as those of the UARTs do.
+ *
+ * Each block belongs to exactly one of the DMA (the two blocks it is
+ * filling, in ucDmaBlock), the full ring, the stream task, or the free
+ * ring. Each ring has one producer and one consumer, the DMA interrupt and
+ * the stream task, one way or the other: an entry is written before the
+ * head moving past it is published, and read before the tail moving past
+ * it is, so neither side ever masks the other.
+ */
+#include "AdcStream.h"
+#include "CyphalNode.h"
+#include "CyphalServices.h"
+#include "MonoClock.h"
+#include "RunTimeStats.h"
+#include "StaticAlloc.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "stm32h7xx_hal.h"
+#include <stdio.h>
+#include <string.h>
+
+#if ((ADC_STREAM_BLOCK_COUNT & (ADC_STREAM_BLOCK_COUNT - 1u)) != 0u) || (ADC_STREAM_BLOCK_COUNT < 4u)
+#error "ADC_STREAM_BLOCK_COUNT must be a power of two, at least 4"
+#endif
+
+#define ADC_STREAM_CACHE_LINE          32u
+
+/* Message header, right in front of the samples; the line holding it is
+ * never written by the DMA */
+#define ADC_STREAM_HEADER_SIZE         16u
+#define ADC_STREAM_SAMPLES_OFFSET      ADC_STREAM_CACHE_LINE
+#define ADC_STREAM_SAMPLES_SIZE        (ADC_STREAM_BLOCK_SAMPLES * 2u)
+#define ADC_STREAM_BLOCK_SIZE          (ADC_STREAM_SAMPLES_OFFSET + ADC_STREAM_SAMPLES_SIZE)
+#define ADC_STREAM_MESSAGE_SIZE        (ADC_STREAM_HEADER_SIZE + ADC_STREAM_SAMPLES_SIZE)
+
+/* From the first sample of a block to its last */
+#define ADC_STREAM_BLOCK_SPAN_US       ((uint64_t) (ADC_STREAM_BLOCK_SAMPLES - 1u) * 1000000u / ADC_STREAM_SAMPLE_HZ)
+
+/* A block queued for longer than it takes to fill the next one is stale */
+#define ADC_STREAM_PUBLISH_TIMEOUT_US  ((uint32_t) (ADC_STREAM_BLOCK_SPAN_US + 1000000u / ADC_STREAM_SAMPLE_HZ))
+
+/* Bound of each wait on the ADC during its start-up */
+#define ADC_STREAM_INIT_TIMEOUT_MS     10u
+
+/* ADC kernel clock: per_ck, the HSI at 64 MHz, divided by 8 (CCR.PRESC),
+ * hence BOOST for 6.25 to 12.5 MHz; 32.5 cycles of sampling (SMP) are
+ * well within a period at ADC_STREAM_SAMPLE_HZ */
+#define ADC_STREAM_PRESC               (0x4u << ADC_CCR_PRESC_Pos)
+#define ADC_STREAM_BOOST               (0x1u << ADC_CR_BOOST_Pos)
+#define ADC_STREAM_SMP                 0x4u
+
+/* External trigger 13 of ADC1 and ADC2: TIM6 TRGO */
+#define ADC_STREAM_EXTSEL_TIM6_TRGO    (13u << ADC_CFGR_EXTSEL_Pos)
+
+typedef struct
+{
+    uint8_t ucBlock;
+    uint32_t ulSequence;                /* Blocks filled before this one */
+    uint64_t ullDoneUs;                 /* Local time of the last sample */
+} AdcStreamEntry_t;
+
+/* Both rings hold every block at most, so a push never fails */
+typedef struct
+{
+    volatile uint32_t ulHead;           /* Written by the producer only */
+    volatile uint32_t ulTail;           /* Written by the consumer only */
+    AdcStreamEntry_t xEntries[ADC_STREAM_BLOCK_COUNT];
+} AdcStreamRing_t;
+
+static uint8_t ucBlocks[ADC_STREAM_BLOCK_COUNT][ADC_STREAM_BLOCK_SIZE] __attribute__((aligned(ADC_STREAM_CACHE_LINE)));
+
+static DMA_HandleTypeDef hdma_adc1;
+
+/* Full blocks from the DMA interrupt to the task, free ones back */
+static AdcStreamRing_t xFullRing;
+static AdcStreamRing_t xFreeRing;
+
+/* Blocks in M0AR and M1AR, only accessed by the DMA interrupt once started */
+static uint8_t ucDmaBlock[2];
+
+static TaskHandle_t xStreamTask = NULL;
+APP_TASK_STORAGE(xStreamTask, ADC_STREAM_STACK_SIZE);
+
+static UdpardTransferID xTransferId = 0;
+
+/* Set by the DMA callbacks for the handler */
+static BaseType_t xIsrWoken;
+
+/* Block counters are written by the DMA interrupt, the others by the task */
+static AdcStreamStats_t xStats;
+
+static BaseType_t prvRingPush(AdcStreamRing_t *pxRing, const AdcStreamEntry_t *pxEntry)
+{
+    uint32_t ulHead = pxRing->ulHead;
+
+    if (ulHead - pxRing->ulTail >= ADC_STREAM_BLOCK_COUNT)
+    {
+        return pdFALSE;
+    }
+
+    pxRing->xEntries[ulHead % ADC_STREAM_BLOCK_COUNT] = *pxEntry;
+
+    /* The entry is in place before the consumer can see it */
+    __DMB();
+    pxRing->ulHead = ulHead + 1u;
+    return pdTRUE;
+}
+
+static BaseType_t prvRingPop(AdcStreamRing_t *pxRing, AdcStreamEntry_t *pxEntry)
+{
+    uint32_t ulTail = pxRing->ulTail;
+
+    if (pxRing->ulHead == ulTail)
+    {
+        return pdFALSE;
+    }
+    __DMB();
+
+    *pxEntry = pxRing->xEntries[ulTail % ADC_STREAM_BLOCK_COUNT];
+
+    /* The entry is read before the producer can reuse it */
+    __DMB();
+    pxRing->ulTail = ulTail + 1u;
+    return pdTRUE;
+}
+
+static uint32_t prvRingCount(const AdcStreamRing_t *pxRing)
+{
+    return pxRing->ulHead - pxRing->ulTail;
+}
+
+/* A block is full, ulMemory being the DMA memory it was in (0 or 1): the
+ * DMA is filling the other one, so this one is given the next free block */
+static void prvBlockDone(uint32_t ulMemory)
+{
+    AdcStreamEntry_t xNext;
+    AdcStreamEntry_t xDone;
+
+    xDone.ullDoneUs = ullMonoClockNowUs();
+    xDone.ulSequence = xStats.ulBlocks++;
+
+    if (prvRingPop(&xFreeRing, &xNext) == pdFALSE)
+    {
+        /* The DMA fills the same block again */
+        xStats.ulOverruns++;
+        return;
+    }
+
+    (void) HAL_DMAEx_ChangeMemory(&hdma_adc1, (uint32_t) &ucBlocks[xNext.ucBlock][ADC_STREAM_SAMPLES_OFFSET],
+                                  (ulMemory == 0u) ? MEMORY0 : MEMORY1);
+
+    xDone.ucBlock = ucDmaBlock[ulMemory];
+    ucDmaBlock[ulMemory] = xNext.ucBlock;
+    (void) prvRingPush(&xFullRing, &xDone);
+
+    vTaskNotifyGiveFromISR(xStreamTask, &xIsrWoken);
+}
+
+static void prvM0Done(DMA_HandleTypeDef *hdma)
+{
+    (void) hdma;
+    prvBlockDone(0);
+}
+
+static void prvM1Done(DMA_HandleTypeDef *hdma)
+{
+    (void) hdma;
+    prvBlockDone(1);
+}
+
+static void prvDmaError(DMA_HandleTypeDef *hdma)
+{
+    (void) hdma;
+    xStats.ulDmaErrors++;
+}
+
+void DMA1_Stream6_IRQHandler(void)
+{
+    vRunTimeStatsIsrEnter(RUN_TIME_STATS_ISR_ADC);
+
+    xIsrWoken = pdFALSE;
+    HAL_DMA_IRQHandler(&hdma_adc1);
+
+    vRunTimeStatsIsrExit(RUN_TIME_STATS_ISR_ADC);
+    portYIELD_FROM_ISR(xIsrWoken);
+}
+
+static void prvPutU16(uint8_t *pucOut, uint16_t usValue)
+{
+    pucOut[0] = (uint8_t) usValue;
+    pucOut[1] = (uint8_t) (usValue >> 8);
+}
+
+static void prvPutU32(uint8_t *pucOut, uint32_t ulValue)
+{
+    prvPutU16(pucOut, (uint16_t) ulValue);
+    prvPutU16(&pucOut[2], (uint16_t) (ulValue >> 16));
+}
+
+/* Publish a full block from where the DMA left it: the header is written
+ * in front of the samples, and libudpard copies both into its frames */
+static void prvPublish(const AdcStreamEntry_t *pxEntry)
+{
+    uint8_t *pucMessage = &ucBlocks[pxEntry->ucBlock][ADC_STREAM_SAMPLES_OFFSET - ADC_STREAM_HEADER_SIZE];
+    uint64_t ullTimestampUs = ullMonoClockToReferenceUs(pxEntry->ullDoneUs - ADC_STREAM_BLOCK_SPAN_US);
+    uint64_t ullLatencyUs;
+
+    /* Drop the lines the CPU may hold from the last use of the block */
+    SCB_InvalidateDCache_by_Addr(&ucBlocks[pxEntry->ucBlock][ADC_STREAM_SAMPLES_OFFSET],
+                                 (int32_t) ADC_STREAM_SAMPLES_SIZE);
+
+    prvPutU32(&pucMessage[0], pxEntry->ulSequence);
+    prvPutU32(&pucMessage[4], (uint32_t) ullTimestampUs);
+    prvPutU32(&pucMessage[8], (uint32_t) (ullTimestampUs >> 32));
+    prvPutU16(&pucMessage[12], (uint16_t) ADC_STREAM_SAMPLE_HZ);
+    prvPutU16(&pucMessage[14], (uint16_t) ADC_STREAM_BLOCK_SAMPLES);
+
+    if (xCyphalNodePublish(ADC_STREAM_SUBJECT_ID, ADC_STREAM_PRIORITY, &xTransferId,
+                           pucMessage, ADC_STREAM_MESSAGE_SIZE, ADC_STREAM_PUBLISH_TIMEOUT_US) != pdPASS)
+    {
+        xStats.ulPublishFailures++;
+        return;
+    }
+
+    ullLatencyUs = ullMonoClockNowUs() - pxEntry->ullDoneUs;
+    xStats.ulPublished++;
+    xStats.ulLatencyLastUs = (uint32_t) ullLatencyUs;
+    if (xStats.ulLatencyLastUs > xStats.ulLatencyMaxUs)
+    {
+        xStats.ulLatencyMaxUs = xStats.ulLatencyLastUs;
+    }
+    xStats.ullLatencySumUs += ullLatencyUs;
+}
+
+static void prvStreamTask(void *pvParameters)
+{
+    AdcStreamEntry_t xEntry;
+
+    (void) pvParameters;
+
+    for (;;)
+    {
+        (void) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (prvRingPop(&xFullRing, &xEntry) == pdTRUE)
+        {
+            prvPublish(&xEntry);
+            (void) prvRingPush(&xFreeRing, &xEntry);
+        }
+
+        if ((ADC1->ISR & ADC_ISR_OVR) != 0)
+        {
+            ADC1->ISR = ADC_ISR_OVR;
+            xStats.ulAdcOverruns++;
+        }
+    }
+}
+
+static BaseType_t prvWaitAdc(volatile uint32_t *pulRegister, uint32_t ulMask, uint32_t ulValue)
+{
+    uint32_t ulStart = HAL_GetTick();
+
+    while ((*pulRegister & ulMask) != ulValue)
+    {
+        if (HAL_GetTick() - ulStart > ADC_STREAM_INIT_TIMEOUT_MS)
+        {
+            return pdFAIL;
+        }
+    }
+    return pdPASS;
+}
+
+static BaseType_t prvAdcInit(void)
+{
+    GPIO_InitTypeDef xGpio = {0};
+
+    __HAL_RCC_ADC_CONFIG(RCC_ADCCLKSOURCE_CLKP);
+    __HAL_RCC_ADC12_CLK_ENABLE();
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+
+    xGpio.Pin = GPIO_PIN_3;
+    xGpio.Mode = GPIO_MODE_ANALOG;
+    xGpio.Pull = GPIO_NOPULL;
+    HAL_GPIO_Init(GPIOA, &xGpio);
+
+    ADC12_COMMON->CCR = ADC_STREAM_PRESC;
+
+    /* Out of deep power-down, regulator on */
+    ADC1->CR = ADC_STREAM_BOOST;
+    ADC1->CR = ADC_STREAM_BOOST | ADC_CR_ADVREGEN;
+    if (prvWaitAdc(&ADC1->ISR, ADC_ISR_LDORDY, ADC_ISR_LDORDY) != pdPASS)
+    {
+        return pdFAIL;
+    }
+
+    /* Offset and linearity calibration, single-ended */
+    ADC1->CR |= ADC_CR_ADCALLIN;
+    ADC1->CR |= ADC_CR_ADCAL;
+    if (prvWaitAdc(&ADC1->CR, ADC_CR_ADCAL, 0) != pdPASS)
+    {
+        return pdFAIL;
+    }
+
+    ADC1->ISR = ADC_ISR_ADRDY;
+    ADC1->CR |= ADC_CR_ADEN;
+    if (prvWaitAdc(&ADC1->ISR, ADC_ISR_ADRDY, ADC_ISR_ADRDY) != pdPASS)
+    {
+        return pdFAIL;
+    }
+
+    /* 16 bits, one conversion per rising edge of TIM6 TRGO, read by the
+     * DMA in circular mode; a sample the DMA missed is overwritten */
+    ADC1->CFGR = ADC_CFGR_DMNGT_0 | ADC_CFGR_DMNGT_1 | ADC_CFGR_EXTEN_0 | ADC_STREAM_EXTSEL_TIM6_TRGO |
+                 ADC_CFGR_OVRMOD;
+    ADC1->PCSEL_RES0 = 1u << ADC_STREAM_CHANNEL;
+    ADC1->SQR1 = ADC_STREAM_CHANNEL << ADC_SQR1_SQ1_Pos;
+#if (ADC_STREAM_CHANNEL < 10u)
+    ADC1->SMPR1 = ADC_STREAM_SMP << (3u * ADC_STREAM_CHANNEL);
+#else
+    ADC1->SMPR2 = ADC_STREAM_SMP << (3u * (ADC_STREAM_CHANNEL - 10u));
+#endif
+    ADC1->ISR = ADC_ISR_OVR;
+
+    return pdPASS;
+}
+
+static BaseType_t prvDmaInit(void)
+{
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    hdma_adc1.Instance = DMA1_Stream6;
+    hdma_adc1.Init.Request = DMA_REQUEST_ADC1;
+    hdma_adc1.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_adc1.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_adc1.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_adc1.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+    hdma_adc1.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+    hdma_adc1.Init.Mode = DMA_CIRCULAR;
+    hdma_adc1.Init.Priority = DMA_PRIORITY_HIGH;
+    hdma_adc1.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(&hdma_adc1) != HAL_OK)
+    {
+        return pdFAIL;
+    }
+
+    hdma_adc1.XferCpltCallback = prvM0Done;
+    hdma_adc1.XferM1CpltCallback = prvM1Done;
+    hdma_adc1.XferErrorCallback = prvDmaError;
+
+    HAL_NVIC_SetPriority(DMA1_Stream6_IRQn, ADC_STREAM_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+    return pdPASS;
+}
+
+/* Period of TIM6 at ADC_STREAM_SAMPLE_HZ, from the current APB1 clock */
+static void prvTimerPeriod(void)
+{
+    uint32_t ulTimerHz = HAL_RCC_GetPCLK1Freq();
+    uint32_t ulTicks;
+    uint32_t ulPrescaler;
+
+    /* As for TIM5 in MonoClock.c */
+    if ((RCC->D2CFGR & RCC_D2CFGR_D2PPRE1) != RCC_D2CFGR_D2PPRE1_DIV1)
+    {
+        ulTimerHz *= 2u;
+    }
+
+    ulTicks = ulTimerHz / ADC_STREAM_SAMPLE_HZ;
+    ulPrescaler = (ulTicks - 1u) / 65536u;
+
+    TIM6->PSC = ulPrescaler;
+    TIM6->ARR = ulTicks / (ulPrescaler + 1u) - 1u;
+    TIM6->EGR = TIM_EGR_UG;
+    TIM6->SR = 0;
+}
+
+/* TIM6 TRGO on each update, at ADC_STREAM_SAMPLE_HZ */
+static void prvTimerStart(void)
+{
+    __HAL_RCC_TIM6_CLK_ENABLE();
+
+    TIM6->CR1 = TIM_CR1_URS;
+    TIM6->CR2 = TIM_CR2_MMS_1;
+    prvTimerPeriod();
+    TIM6->CR1 |= TIM_CR1_CEN;
+}
+
+void vAdcStreamClockChanged(void)
+{
+    /* The sample in progress is restarted */
+    if (__HAL_RCC_TIM6_IS_CLK_ENABLED() && (TIM6->CR1 & TIM_CR1_CEN) != 0)
+    {
+        prvTimerPeriod();
+    }
+}
+
+BaseType_t xAdcStreamStart(UBaseType_t uxPriority)
+{
+    AdcStreamEntry_t xEntry = {0};
+    uint8_t i;
+
+    if (xStreamTask != NULL)
+    {
+        return pdFAIL;
+    }
+
+    /* The DMA starts on the first two blocks, the others are free */
+    memset(&xFullRing, 0, sizeof(xFullRing));
+    memset(&xFreeRing, 0, sizeof(xFreeRing));
+    ucDmaBlock[0] = 0;
+    ucDmaBlock[1] = 1;
+    for (i = 2; i < ADC_STREAM_BLOCK_COUNT; i++)
+    {
+        xEntry.ucBlock = i;
+        (void) prvRingPush(&xFreeRing, &xEntry);
+    }
+
+    if (xAppTaskCreate(xStreamTask, prvStreamTask, "AdcStream", ADC_STREAM_STACK_SIZE, NULL, uxPriority,
+                       &xStreamTask) != pdPASS)
+    {
+        return pdFAIL;
+    }
+
+    (void) xCyphalServicesDeclarePort(CYPHAL_PORT_PUBLISHER, ADC_STREAM_SUBJECT_ID);
+
+    if (prvAdcInit() != pdPASS || prvDmaInit() != pdPASS ||
+        HAL_DMAEx_MultiBufferStart_IT(&hdma_adc1, (uint32_t) &ADC1->DR,
+                                      (uint32_t) &ucBlocks[0][ADC_STREAM_SAMPLES_OFFSET],
+                                      (uint32_t) &ucBlocks[1][ADC_STREAM_SAMPLES_OFFSET],
+                                      ADC_STREAM_BLOCK_SAMPLES) != HAL_OK)
+    {
+        return pdFAIL;
+    }
+
+    /* Conversions wait for the triggers of the timer */
+    ADC1->CR |= ADC_CR_ADSTART;
+    prvTimerStart();
+    return pdPASS;
+}
+
+void vAdcStreamGetStats(AdcStreamStats_t *pxStats)
+{
+    taskENTER_CRITICAL();
+    *pxStats = xStats;
+    taskEXIT_CRITICAL();
+}
+
+static BaseType_t prvAdcStreamCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xAdcStream =
+{
+    "adcstream",
+    "\r\nadcstream:\r\n ADC streaming pipeline: block counters, drops and latency\r\n",
+    prvAdcStreamCommand,
+    0
+};
+
+/* Block and latency counters copied on the first line: the average
+ * latency divides two of them, which must come from the same copy */
+static AdcStreamStats_t xAdcReport;
+static UBaseType_t uxAdcLine = 0;
+
+static BaseType_t prvAdcStreamCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    (void) pcCommandString;
+
+    if (uxAdcLine == 0)
+    {
+        if (xStreamTask == NULL)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "ADC stream not running\r\n");
+            return pdFALSE;
+        }
+
+        vAdcStreamGetStats(&xAdcReport);
+    }
+
+    switch (uxAdcLine++)
+    {
+    case 0:
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "adc: channel=%u rate=%luHz block=%u samples pool=%u free=%lu subject=%u\r\n",
+                 (unsigned int) ADC_STREAM_CHANNEL, (unsigned long) ADC_STREAM_SAMPLE_HZ,
+                 (unsigned int) ADC_STREAM_BLOCK_SAMPLES, (unsigned int) ADC_STREAM_BLOCK_COUNT,
+                 (unsigned long) prvRingCount(&xFreeRing), (unsigned int) ADC_STREAM_SUBJECT_ID);
+        return pdTRUE;
+    case 1:
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "blocks: filled=%lu published=%lu overruns=%lu publish-fail=%lu adc-ovr=%lu dma-err=%lu\r\n",
+                 (unsigned long) xAdcReport.ulBlocks, (unsigned long) xAdcReport.ulPublished,
+                 (unsigned long) xAdcReport.ulOverruns, (unsigned long) xAdcReport.ulPublishFailures,
+                 (unsigned long) xAdcReport.ulAdcOverruns, (unsigned long) xAdcReport.ulDmaErrors);
+        return pdTRUE;
+    default:
+        uxAdcLine = 0;
+        snprintf(pcWriteBuffer, xWriteBufferLen, "latency: last=%luus max=%luus avg=%luus\r\n",
+                 (unsigned long) xAdcReport.ulLatencyLastUs, (unsigned long) xAdcReport.ulLatencyMaxUs,
+                 (unsigned long) ((xAdcReport.ulPublished != 0) ?
+                                  xAdcReport.ullLatencySumUs / xAdcReport.ulPublished : 0));
+        return pdFALSE;
+    }
+}
+
+void vAdcStreamRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xAdcStream);
+}
@@ -0,0 +1,264 @@
+/* BatchConsole.c
+ *
+ * Framing and JSON responses of the batch console (see BatchConsole.h); the
+ * commands themselves are executed by eCommandConsoleRun().
+ */
+#include "BatchConsole.h"
+#include "CommandConsoleDualTask.h"
+#include "StaticAlloc.h"
+#include "task.h"
+#include "core/net.h"
+#include "core/socket.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Room kept at the end of a response for the fields after the output */
+#define BATCH_RESPONSE_TAIL            40u
+
+/* Request frames waiting to be executed */
+static uint8_t ucRxBuffer[BATCH_CONSOLE_RX_SIZE];
+static size_t xRxUsed = 0;
+static uint32_t ulRxSkip = 0;                   /* Bytes left of a request too long */
+
+/* Response being built */
+static char cResponse[BATCH_CONSOLE_RESPONSE_SIZE];
+static size_t xResponseUsed = 0;
+static BaseType_t xResponseTruncated = pdFALSE;
+
+static char cCommand[configCOMMAND_INT_MAX_INPUT_SIZE];
+static uint32_t ulRequestId = 0;
+
+APP_TASK_STORAGE(xBatchTask, BATCH_CONSOLE_TASK_STACK_SIZE);
+
+static void prvBatchConsoleTask(void *pvParameters);
+
+static void prvResponseBegin(void)
+{
+    /* The length goes in the first two bytes once known */
+    xResponseUsed = 2u + (size_t) snprintf(&cResponse[2], sizeof(cResponse) - 2u,
+                                           "{\"id\":%lu,\"output\":\"", (unsigned long) ulRequestId);
+    xResponseTruncated = pdFALSE;
+}
+
+/* Output of the command, escaped into the response */
+static void prvResponseOutput(const char *pcData, size_t xLength, void *pvContext)
+{
+    static const char cHex[] = "0123456789abcdef";
+    const size_t xLimit = sizeof(cResponse) - BATCH_RESPONSE_TAIL;
+    char cEscape[6];
+    size_t xEscape;
+    unsigned char c;
+    size_t i;
+
+    (void) pvContext;
+
+    for (i = 0; i < xLength && xResponseTruncated == pdFALSE; i++)
+    {
+        c = (unsigned char) pcData[i];
+
+        if (c == '"' || c == '\\')
+        {
+            cEscape[0] = '\\';
+            cEscape[1] = (char) c;
+            xEscape = 2;
+        }
+        else if (c == '\n' || c == '\r' || c == '\t')
+        {
+            cEscape[0] = '\\';
+            cEscape[1] = (c == '\n') ? 'n' : ((c == '\r') ? 'r' : 't');
+            xEscape = 2;
+        }
+        else if (c < 0x20u)
+        {
+            memcpy(cEscape, "\\u00", 4);
+            cEscape[4] = cHex[c >> 4];
+            cEscape[5] = cHex[c & 0x0Fu];
+            xEscape = 6;
+        }
+        else
+        {
+            cEscape[0] = (char) c;
+            xEscape = 1;
+        }
+
+        if (xResponseUsed + xEscape > xLimit)
+        {
+            xResponseTruncated = pdTRUE;
+            break;
+        }
+
+        memcpy(&cResponse[xResponseUsed], cEscape, xEscape);
+        xResponseUsed += xEscape;
+    }
+}
+
+static error_t prvResponseSend(Socket *pxClient, uint32_t ulStatus, uint_t uFlags)
+{
+    size_t xLength;
+
+    xResponseUsed += (size_t) snprintf(&cResponse[xResponseUsed], sizeof(cResponse) - xResponseUsed,
+                                       "\",\"status\":%lu%s}", (unsigned long) ulStatus,
+                                       (xResponseTruncated != pdFALSE) ? ",\"truncated\":true" : "");
+
+    xLength = xResponseUsed - 2u;
+    cResponse[0] = (char) (xLength >> 8);
+    cResponse[1] = (char) (xLength & 0xFFu);
+
+    return socketSend(pxClient, cResponse, xResponseUsed, NULL, uFlags);
+}
+
+static uint32_t prvStatus(eConsoleRunResult eResult)
+{
+    switch (eResult)
+    {
+    case eConsoleRunOk:
+        return BATCH_STATUS_OK;
+    case eConsoleRunUnknownCommand:
+        return BATCH_STATUS_UNKNOWN_COMMAND;
+    case eConsoleRunBadParameters:
+        return BATCH_STATUS_BAD_PARAMETERS;
+    default:
+        return BATCH_STATUS_BUSY;
+    }
+}
+
+/* Execute and answer every complete request of the input buffer */
+static error_t prvProcessRequests(Socket *pxClient)
+{
+    size_t xOffset = 0;
+    size_t xLength;
+    size_t xSkipped;
+    uint32_t ulStatus;
+    uint_t uFlags;
+    error_t err = NO_ERROR;
+
+    while (err == NO_ERROR)
+    {
+        /* Tail of a request too long, already answered */
+        if (ulRxSkip > 0)
+        {
+            xSkipped = MIN(ulRxSkip, xRxUsed - xOffset);
+            ulRxSkip -= xSkipped;
+            xOffset += xSkipped;
+            if (ulRxSkip > 0)
+            {
+                break;
+            }
+        }
+
+        if (xRxUsed - xOffset < 2u)
+        {
+            break;
+        }
+        xLength = ((size_t) ucRxBuffer[xOffset] << 8) | ucRxBuffer[xOffset + 1u];
+
+        if (xLength < sizeof(cCommand))
+        {
+            if (xRxUsed - xOffset < 2u + xLength)
+            {
+                break;
+            }
+            memcpy(cCommand, &ucRxBuffer[xOffset + 2u], xLength);
+            cCommand[xLength] = '\0';
+            xOffset += 2u + xLength;
+        }
+        else
+        {
+            xOffset += 2u;
+            ulRxSkip = (uint32_t) xLength;
+        }
+
+        ulRequestId++;
+        prvResponseBegin();
+
+        if (ulRxSkip > 0)
+        {
+            ulStatus = BATCH_STATUS_TOO_LONG;
+        }
+        else
+        {
+            ulStatus = prvStatus(eCommandConsoleRun(cCommand, prvResponseOutput, NULL));
+        }
+
+        /* Let Nagle merge the responses of pipelined requests; push out the
+           last one */
+        uFlags = (xRxUsed - xOffset >= 2u) ? 0 : SOCKET_FLAG_NO_DELAY;
+        err = prvResponseSend(pxClient, ulStatus, uFlags);
+    }
+
+    /* Keep the beginning of the next request */
+    memmove(ucRxBuffer, &ucRxBuffer[xOffset], xRxUsed - xOffset);
+    xRxUsed -= xOffset;
+
+    return err;
+}
+
+static void prvServeClient(Socket *pxClient)
+{
+    size_t xReceived;
+    error_t err;
+
+    xRxUsed = 0;
+    ulRxSkip = 0;
+    ulRequestId = 0;
+
+    socketSetTimeout(pxClient, BATCH_CONSOLE_TIMEOUT_MS);
+
+    for (;;)
+    {
+        err = socketReceive(pxClient, &ucRxBuffer[xRxUsed], sizeof(ucRxBuffer) - xRxUsed, &xReceived, 0);
+        if (err != NO_ERROR || xReceived == 0)
+        {
+            /* Closed, reset, or silent for too long */
+            break;
+        }
+        xRxUsed += xReceived;
+
+        if (prvProcessRequests(pxClient) != NO_ERROR)
+        {
+            break;
+        }
+    }
+}
+
+static void prvBatchConsoleTask(void *pvParameters)
+{
+    Socket *pxListener;
+    Socket *pxClient;
+
+    (void) pvParameters;
+
+    pxListener = socketOpen(SOCKET_TYPE_STREAM, SOCKET_IP_PROTO_TCP);
+    if (pxListener == NULL)
+    {
+        vTaskDelete(NULL);
+        return;
+    }
+
+    socketBind(pxListener, &IP_ADDR_ANY, BATCH_CONSOLE_PORT);
+    socketListen(pxListener, 1);
+
+    for (;;)
+    {
+        pxClient = socketAccept(pxListener, NULL, NULL);
+        if (pxClient == NULL)
+        {
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+
+        prvServeClient(pxClient);
+        socketClose(pxClient);
+    }
+}
+
+BaseType_t xBatchConsoleStart(UBaseType_t uxPriority)
+{
+    return xAppTaskCreate(xBatchTask,
+                          prvBatchConsoleTask,
+                          "BatchCLI",
+                          BATCH_CONSOLE_TASK_STACK_SIZE,
+                          NULL,
+                          uxPriority,
+                          NULL);
+}
@@ -0,0 +1,128 @@
+/* BootProfile.c
+ *
+ * Start-up timeline (see BootProfile.h). Marks are appended under a
+ * critical section: before the scheduler starts, it leaves the interrupts
+ * masked as FreeRTOS does for any critical section at that stage.
+ */
+#include "BootProfile.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "MonoClock.h"
+#include <stdio.h>
+
+typedef struct
+{
+    const char *pcPhase;
+    uint64_t ullTimeUs;
+} BootMark_t;
+
+static BootMark_t xMarks[BOOT_PROFILE_MAX_MARKS];
+static volatile UBaseType_t uxMarkCount = 0;
+
+static UBaseType_t uxBootLine = 0;
+
+static BaseType_t prvBootCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xBoot =
+{
+    "boot",
+    "\r\nboot:\r\n Start-up timeline, from the clock start to the first DHCP lease\r\n",
+    prvBootCommand,
+    0
+};
+
+void vBootProfileMark(const char *pcPhase)
+{
+    uint64_t ullNow = ullMonoClockNowUs();
+    UBaseType_t i;
+
+    taskENTER_CRITICAL();
+    for (i = 0; i < uxMarkCount; i++)
+    {
+        if (xMarks[i].pcPhase == pcPhase)
+        {
+            break;
+        }
+    }
+    if (i == uxMarkCount && uxMarkCount < BOOT_PROFILE_MAX_MARKS)
+    {
+        xMarks[uxMarkCount].pcPhase = pcPhase;
+        xMarks[uxMarkCount].ullTimeUs = ullNow;
+        uxMarkCount++;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/* Called by the stack with netMutex held */
+static void prvLinkChange(NetInterface *pxInterface, bool_t xLinkState, void *pvParam)
+{
+    (void) pxInterface;
+    (void) pvParam;
+
+    if (xLinkState)
+    {
+        vBootProfileMark("link up");
+    }
+}
+
+BaseType_t xBootProfileWatchLink(NetInterface *pxInterface)
+{
+    error_t err;
+
+    osAcquireMutex(&netMutex);
+    err = netAttachLinkChangeCallback(pxInterface, prvLinkChange, NULL);
+    osReleaseMutex(&netMutex);
+
+    return (err == NO_ERROR) ? pdPASS : pdFAIL;
+}
+
+void vBootProfileDhcpStateChange(DhcpClientContext *pxContext, NetInterface *pxInterface, DhcpState eState)
+{
+    (void) pxContext;
+    (void) pxInterface;
+
+    /* SELECTING and REBOOTING are entered as the first DHCPDISCOVER or
+     * DHCPREQUEST goes out */
+    if (eState == DHCP_STATE_SELECTING || eState == DHCP_STATE_REBOOTING)
+    {
+        vBootProfileMark("dhcp request");
+    }
+    else if (eState == DHCP_STATE_BOUND)
+    {
+        vBootProfileMark("dhcp bound");
+    }
+}
+
+void vBootProfileRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xBoot);
+}
+
+static BaseType_t prvBootCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    UBaseType_t uxCount = uxMarkCount;
+    uint64_t ullPrevious;
+
+    (void) pcCommandString;
+
+    if (uxBootLine == 0)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "\r\n   Time (us)    Phase (us)  Phase\r\n");
+        uxBootLine = (uxCount > 0) ? 1 : 0;
+        return (uxCount > 0) ? pdTRUE : pdFALSE;
+    }
+
+    ullPrevious = (uxBootLine > 1) ? xMarks[uxBootLine - 2].ullTimeUs : 0;
+    snprintf(pcWriteBuffer, xWriteBufferLen, "%12lu  %12lu  %s\r\n",
+             (unsigned long) xMarks[uxBootLine - 1].ullTimeUs,
+             (unsigned long) (xMarks[uxBootLine - 1].ullTimeUs - ullPrevious),
+             xMarks[uxBootLine - 1].pcPhase);
+
+    if (uxBootLine++ >= uxCount)
+    {
+        uxBootLine = 0;
+        return pdFALSE;
+    }
+
+    return pdTRUE;
+}
@@ -0,0 +1,519 @@
+/* ClockGovernor.c
+ *
+ * Levels of the core clock, the changes between them and the policy of the
+ * "clock" governor (see ClockGovernor.h).
+ *
+ * A change runs in the governor task with interrupts disabled, from the
+ * start of the change to the last clock derived again, so that no handler
+ * sees a peripheral programmed for the other level. The time across a
+ * relock is counted in cycles of the DWT counter: at the former CPU clock
+ * up to the switch to the HSE, at the HSE until the switch back, at the
+ * new clock since.
+ */
+#include "ClockGovernor.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "StaticAlloc.h"
+#include "stm32h7xx_hal.h"
+#include "MonoClock.h"
+#include "RunTimeStats.h"
+#include "AdcStream.h"
+#include "LowPower.h"
+#include "core/net.h"
+#include "drivers/mac/stm32h7xx_eth_driver.h"
+#include <stdio.h>
+#include <string.h>
+
+typedef struct
+{
+    const char *pcName;
+    uint32_t ulPllN;                    /* PLL1, from the 2 MHz reference */
+    uint32_t ulPllP;
+    uint32_t ulCpuDiv;                  /* D1CPRE */
+    uint32_t ulAhbDiv;                  /* HPRE */
+    uint32_t ulVos;                     /* PWR_REGULATOR_VOLTAGE_SCALEx */
+    uint32_t ulVosNumber;
+    uint32_t ulLatency;
+    uint32_t ulCpuMhz;
+} ClockLevelConfig_t;
+
+/* Full is the configuration of SystemClock_Config(); the flash latency of
+ * low keeps a margin over the VOS3 table */
+static const ClockLevelConfig_t xLevels[eClockLevelCount] =
+{
+    { "full", 275u, 1u, RCC_SYSCLK_DIV1, RCC_HCLK_DIV2, PWR_REGULATOR_VOLTAGE_SCALE0, 0u, FLASH_LATENCY_3, 550u },
+    { "half", 275u, 1u, RCC_SYSCLK_DIV2, RCC_HCLK_DIV1, PWR_REGULATOR_VOLTAGE_SCALE0, 0u, FLASH_LATENCY_3, 275u },
+    { "low",  160u, 2u, RCC_SYSCLK_DIV1, RCC_HCLK_DIV2, PWR_REGULATOR_VOLTAGE_SCALE3, 3u, FLASH_LATENCY_2, 160u },
+};
+
+/* UARTs whose baud rate follows the APB clock, when it is their kernel
+ * clock */
+static const struct
+{
+    USART_TypeDef *pxInstance;
+    volatile uint32_t *pulEnable;
+    uint32_t ulEnableBit;
+    uint32_t ulSourceMask;              /* Kernel clock selection, 0 for APB */
+    BaseType_t xApb2;
+} xUarts[] =
+{
+    { USART2, &RCC->APB1LENR, RCC_APB1LENR_USART2EN, RCC_D2CCIP2R_USART28SEL, pdFALSE },
+    { USART3, &RCC->APB1LENR, RCC_APB1LENR_USART3EN, RCC_D2CCIP2R_USART28SEL, pdFALSE },
+    { USART6, &RCC->APB2ENR, RCC_APB2ENR_USART6EN, RCC_D2CCIP2R_USART16910SEL, pdTRUE },
+};
+
+#define CLOCK_UART_COUNT    (sizeof(xUarts) / sizeof(xUarts[0]))
+
+/* Divider of each UART and the APB clock it was set for, captured when the
+ * driver wrote it; the last value written here, to tell */
+static uint32_t ulUartDiv[CLOCK_UART_COUNT];
+static uint32_t ulUartDivHz[CLOCK_UART_COUNT];
+static uint32_t ulUartBrr[CLOCK_UART_COUNT];
+
+APP_TASK_STORAGE(xGovernorTask, CLOCK_GOVERNOR_TASK_STACK_SIZE);
+static TaskHandle_t xGovernorHandle = NULL;
+
+/* Mode, written by the CLI, read by the task */
+static volatile BaseType_t xAutoMode = (CLOCK_GOVERNOR_AUTO != 0) ? pdTRUE : pdFALSE;
+static volatile ClockLevel_t eRequested = eClockLevelFull;
+
+/* Written by the task, copied in a critical section */
+static ClockLevel_t eLevel = eClockLevelFull;
+static ClockGovernorStats_t xStats;
+static uint64_t ullLevelSinceUs = 0;
+static uint32_t ulPredictedPermille = 0;
+static uint32_t ulHold = 0;
+
+static BaseType_t prvClockCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xClock =
+{
+    "clock",
+    "\r\nclock [auto|full|half|low]:\r\n Core clock level, load seen by the governor, time per level\r\n",
+    prvClockCommand,
+    -1
+};
+
+static UBaseType_t uxClockLine = 0;
+
+/* Level of the clocks as programmed */
+static ClockLevel_t prvCurrentLevel(void)
+{
+    uint32_t ulPllN = ((RCC->PLL1DIVR & RCC_PLL1DIVR_N1) >> RCC_PLL1DIVR_N1_Pos) + 1u;
+
+    if (ulPllN == xLevels[eClockLevelLow].ulPllN)
+    {
+        return eClockLevelLow;
+    }
+    return ((RCC->D1CFGR & RCC_D1CFGR_D1CPRE) == RCC_SYSCLK_DIV1) ? eClockLevelFull : eClockLevelHalf;
+}
+
+BaseType_t xClockGovernorAtBootClock(void)
+{
+    return (prvCurrentLevel() == eClockLevelFull) ? pdTRUE : pdFALSE;
+}
+
+/* The bus clock stays within its limit in between: the CPU divider goes
+ * first when it grows, the bus divider otherwise */
+static void prvSetDividers(uint32_t ulCpuDiv, uint32_t ulAhbDiv)
+{
+    if (ulCpuDiv > (RCC->D1CFGR & RCC_D1CFGR_D1CPRE))
+    {
+        MODIFY_REG(RCC->D1CFGR, RCC_D1CFGR_D1CPRE, ulCpuDiv);
+        MODIFY_REG(RCC->D1CFGR, RCC_D1CFGR_HPRE, ulAhbDiv);
+    }
+    else
+    {
+        MODIFY_REG(RCC->D1CFGR, RCC_D1CFGR_HPRE, ulAhbDiv);
+        MODIFY_REG(RCC->D1CFGR, RCC_D1CFGR_D1CPRE, ulCpuDiv);
+    }
+}
+
+/* Relock PLL1 for pxTo through the HSE; the cycle counter at the switch to
+ * the HSE and just before the switch back */
+static void prvRelock(const ClockLevelConfig_t *pxTo, uint32_t *pulBridge, uint32_t *pulLocked)
+{
+    __HAL_RCC_SYSCLK_CONFIG(RCC_SYSCLKSOURCE_HSE);
+    while (__HAL_RCC_GET_SYSCLK_SOURCE() != RCC_SYSCLKSOURCE_STATUS_HSE)
+    {
+    }
+    *pulBridge = DWT->CYCCNT;
+    prvSetDividers(RCC_SYSCLK_DIV1, RCC_HCLK_DIV1);
+
+    __HAL_RCC_PLL_DISABLE();
+    while (__HAL_RCC_GET_FLAG(RCC_FLAG_PLLRDY) != 0)
+    {
+    }
+
+    /* Any voltage and wait states do at the HSE */
+    __HAL_PWR_VOLTAGESCALING_CONFIG(pxTo->ulVos);
+    while (!__HAL_PWR_GET_FLAG(PWR_FLAG_VOSRDY))
+    {
+    }
+    __HAL_FLASH_SET_LATENCY(pxTo->ulLatency);
+    while (__HAL_FLASH_GET_LATENCY() != pxTo->ulLatency)
+    {
+    }
+
+    /* Same reference, range and outputs; Q and R keep their dividers */
+    MODIFY_REG(RCC->PLL1DIVR, RCC_PLL1DIVR_N1 | RCC_PLL1DIVR_P1,
+               ((pxTo->ulPllN - 1u) << RCC_PLL1DIVR_N1_Pos) | ((pxTo->ulPllP - 1u) << RCC_PLL1DIVR_P1_Pos));
+    __HAL_RCC_PLL_ENABLE();
+    while (__HAL_RCC_GET_FLAG(RCC_FLAG_PLLRDY) == 0)
+    {
+    }
+
+    prvSetDividers(pxTo->ulCpuDiv, pxTo->ulAhbDiv);
+    *pulLocked = DWT->CYCCNT;
+    __HAL_RCC_SYSCLK_CONFIG(RCC_SYSCLKSOURCE_PLLCLK);
+    while (__HAL_RCC_GET_SYSCLK_SOURCE() != RCC_SYSCLKSOURCE_STATUS_PLLCLK)
+    {
+    }
+}
+
+/* USARTDIV from BRR and back: with 8x oversampling, the low nibble is
+ * stored shifted */
+static uint32_t prvUartDiv(const USART_TypeDef *pxUart, uint32_t ulBrr)
+{
+    return ((pxUart->CR1 & USART_CR1_OVER8) != 0) ? (ulBrr & ~0xFu) | ((ulBrr & 0x7u) << 1) : ulBrr;
+}
+
+static uint32_t prvUartBrr(const USART_TypeDef *pxUart, uint32_t ulDiv)
+{
+    return ((pxUart->CR1 & USART_CR1_OVER8) != 0) ? (ulDiv & ~0xFu) | ((ulDiv & 0xFu) >> 1) : ulDiv;
+}
+
+static void prvRetimeUarts(uint32_t ulOldPclk1Hz, uint32_t ulOldPclk2Hz)
+{
+    USART_TypeDef *pxUart;
+    uint32_t ulNewHz;
+    uint32_t ulBrr;
+    uint32_t ulCr1;
+    uint32_t ulDiv;
+    UBaseType_t i;
+
+    for (i = 0; i < CLOCK_UART_COUNT; i++)
+    {
+        pxUart = xUarts[i].pxInstance;
+        if ((*xUarts[i].pulEnable & xUarts[i].ulEnableBit) == 0 ||
+            (RCC->D2CCIP2R & xUarts[i].ulSourceMask) != 0 || pxUart->BRR == 0)
+        {
+            continue;
+        }
+
+        /* Set up by its driver since the last change */
+        ulBrr = pxUart->BRR;
+        if (ulBrr != ulUartBrr[i])
+        {
+            ulUartDiv[i] = prvUartDiv(pxUart, ulBrr);
+            ulUartDivHz[i] = (xUarts[i].xApb2 != pdFALSE) ? ulOldPclk2Hz : ulOldPclk1Hz;
+        }
+
+        ulNewHz = (xUarts[i].xApb2 != pdFALSE) ? HAL_RCC_GetPCLK2Freq() : HAL_RCC_GetPCLK1Freq();
+        ulDiv = (uint32_t) (((uint64_t) ulUartDiv[i] * ulNewHz + ulUartDivHz[i] / 2u) / ulUartDivHz[i]);
+        ulBrr = prvUartBrr(pxUart, ulDiv);
+
+        /* BRR is only written with the UART disabled */
+        ulCr1 = pxUart->CR1;
+        pxUart->CR1 = ulCr1 & ~USART_CR1_UE;
+        pxUart->BRR = ulBrr;
+        pxUart->CR1 = ulCr1;
+        ulUartBrr[i] = ulBrr;
+    }
+}
+
+/* Change the clocks to eTo and derive again what depends on them */
+static void prvChangeLevel(ClockLevel_t eTo)
+{
+    const ClockLevelConfig_t *pxFrom = &xLevels[eLevel];
+    const ClockLevelConfig_t *pxTo = &xLevels[eTo];
+    uint32_t ulPrimask = __get_PRIMASK();
+    uint32_t ulOldCpuHz;
+    uint32_t ulOldHclkHz;
+    uint32_t ulOldPclk1Hz;
+    uint32_t ulOldPclk2Hz;
+    uint32_t ulStart;
+    uint32_t ulBridge;
+    uint32_t ulLocked;
+    uint64_t ullOldNs;
+    uint64_t ullBridgeNs;
+    uint64_t ullNewNs;
+    uint64_t ullStartUs;
+    uint64_t ullNowUs;
+    int64_t llPtpNs;
+    uint32_t ulUs;
+
+    __disable_irq();
+    ulOldCpuHz = SystemCoreClock;
+    ulOldHclkHz = HAL_RCC_GetHCLKFreq();
+    ulOldPclk1Hz = HAL_RCC_GetPCLK1Freq();
+    ulOldPclk2Hz = HAL_RCC_GetPCLK2Freq();
+    ullStartUs = ullMonoClockNowUs();
+    ulStart = DWT->CYCCNT;
+
+    if (pxTo->ulPllN == pxFrom->ulPllN && pxTo->ulPllP == pxFrom->ulPllP)
+    {
+        /* Same buses: the CPU clock alone */
+        prvSetDividers(pxTo->ulCpuDiv, pxTo->ulAhbDiv);
+        SystemCoreClockUpdate();
+    }
+    else
+    {
+        prvRelock(pxTo, &ulBridge, &ulLocked);
+        SystemCoreClockUpdate();
+
+        ullOldNs = ((uint64_t) (ulBridge - ulStart) * 1000000000u) / ulOldCpuHz;
+        ullBridgeNs = ((uint64_t) (ulLocked - ulBridge) * 1000000000u) / HSE_VALUE;
+        ullNewNs = ((uint64_t) (DWT->CYCCNT - ulLocked) * 1000000000u) / SystemCoreClock;
+        vMonoClockRetime(ullStartUs + (ullOldNs + ullBridgeNs + ullNewNs) / 1000u);
+
+        /* The PTP clock kept the addend of the former HCLK: it ran at the
+         * HSE over the bridge, at the new HCLK since */
+        llPtpNs = (int64_t) ullBridgeNs - (int64_t) ((ullBridgeNs * HSE_VALUE) / ulOldHclkHz) +
+                  (int64_t) ullNewNs - (int64_t) ((ullNewNs * HAL_RCC_GetHCLKFreq()) / ulOldHclkHz);
+        stm32h7xxEthUpdatePtpClock(llPtpNs);
+
+        (void) HAL_InitTick(uwTickPrio);
+        prvRetimeUarts(ulOldPclk1Hz, ulOldPclk2Hz);
+        vAdcStreamClockChanged();
+    }
+
+    vPortRetimeTickInterrupt();
+    vRunTimeStatsClockChanged();
+
+    ullNowUs = ullMonoClockNowUs();
+    __set_PRIMASK(ulPrimask);
+
+    ulUs = (uint32_t) (ullNowUs - ullStartUs);
+
+    taskENTER_CRITICAL();
+    xStats.ullLevelUs[eLevel] += ullNowUs - ullLevelSinceUs;
+    ullLevelSinceUs = ullNowUs;
+    xStats.ulEntries[eTo]++;
+    xStats.ulLastUs = ulUs;
+    if (ulUs > xStats.ulLongestUs)
+    {
+        xStats.ulLongestUs = ulUs;
+    }
+    eLevel = eTo;
+    taskEXIT_CRITICAL();
+}
+
+/* Level the automatic mode asks for, from one sample */
+static ClockLevel_t prvPolicy(uint32_t ulBusy, uint32_t ulBacklog, BaseType_t xBudgetHit)
+{
+    ClockLevel_t eNext;
+
+    if (ulBusy >= CLOCK_GOVERNOR_UP_PERMILLE || ulBacklog >= CLOCK_GOVERNOR_RX_BACKLOG || xBudgetHit != pdFALSE)
+    {
+        ulHold = 0;
+        ulPredictedPermille = 0;
+        return eClockLevelFull;
+    }
+
+    if (eLevel == eClockLevelLow)
+    {
+        ulPredictedPermille = 0;
+        return eLevel;
+    }
+
+    /* The same work at the lower clock */
+    eNext = (ClockLevel_t) (eLevel + 1);
+    ulPredictedPermille = (ulBusy * xLevels[eLevel].ulCpuMhz) / xLevels[eNext].ulCpuMhz;
+    if (ulPredictedPermille >= CLOCK_GOVERNOR_DOWN_PERMILLE)
+    {
+        ulHold = 0;
+        return eLevel;
+    }
+
+    if (++ulHold < CLOCK_GOVERNOR_HOLD_SAMPLES)
+    {
+        return eLevel;
+    }
+    ulHold = 0;
+    return eNext;
+}
+
+static void prvClockGovernorTask(void *pvParameters)
+{
+    RunTimeLoadSample_t xPrev;
+    RunTimeLoadSample_t xNow;
+    Stm32h7xxEthRxStats xRx;
+    uint32_t ulPrevBudget;
+    uint64_t ullPrevUs;
+    uint64_t ullNowUs;
+    uint64_t ullBusyUs;
+    uint32_t ulBusy;
+    uint32_t ulBacklog;
+    ClockLevel_t eTarget;
+
+    (void) pvParameters;
+
+    vRunTimeStatsGetLoadSample(&xPrev);
+    stm32h7xxEthGetRxStats(&xRx);
+    ulPrevBudget = xRx.budgetExhausted;
+    ullPrevUs = ullMonoClockNowUs();
+
+    for (;;)
+    {
+        (void) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CLOCK_GOVERNOR_PERIOD_MS));
+
+        /* Busy time over the wall time: the idle task only counts while the
+         * core is awake */
+        vRunTimeStatsGetLoadSample(&xNow);
+        ullNowUs = ullMonoClockNowUs();
+        ullBusyUs = (uint64_t) ((xNow.ulTotal - xPrev.ulTotal) - (xNow.ulIdle - xPrev.ulIdle)) *
+                    1000000u / RUN_TIME_STATS_COUNTER_HZ;
+        ulBusy = (ullNowUs > ullPrevUs) ? (uint32_t) ((ullBusyUs * 1000u) / (ullNowUs - ullPrevUs)) : 0;
+        if (ulBusy > 1000u)
+        {
+            ulBusy = 1000u;
+        }
+        xPrev = xNow;
+        ullPrevUs = ullNowUs;
+
+        stm32h7xxEthGetRxStats(&xRx);
+        ulBacklog = (uint32_t) stm32h7xxEthGetRxBacklog();
+
+        if (xLowPowerIsNetStandby() != pdFALSE)
+        {
+            /* Stop mode wakes up through SystemClock_Config() */
+            eTarget = eClockLevelFull;
+        }
+        else if (xAutoMode != pdFALSE)
+        {
+            eTarget = prvPolicy(ulBusy, ulBacklog, (xRx.budgetExhausted != ulPrevBudget) ? pdTRUE : pdFALSE);
+        }
+        else
+        {
+            eTarget = eRequested;
+        }
+        ulPrevBudget = xRx.budgetExhausted;
+
+        taskENTER_CRITICAL();
+        xStats.ulBusyPermille = ulBusy;
+        xStats.ulRxBacklog = ulBacklog;
+        taskEXIT_CRITICAL();
+
+        if (eTarget != eLevel)
+        {
+            prvChangeLevel(eTarget);
+        }
+    }
+}
+
+BaseType_t xClockGovernorStart(UBaseType_t uxPriority)
+{
+    memset(&xStats, 0, sizeof(xStats));
+    eLevel = prvCurrentLevel();
+    eRequested = eLevel;
+    ullLevelSinceUs = ullMonoClockNowUs();
+    xStats.ulEntries[eLevel] = 1;
+
+    return xAppTaskCreate(xGovernorTask,
+                          prvClockGovernorTask,
+                          "ClockGov",
+                          CLOCK_GOVERNOR_TASK_STACK_SIZE,
+                          NULL,
+                          uxPriority,
+                          &xGovernorHandle);
+}
+
+void vClockGovernorSetMode(BaseType_t xAuto, ClockLevel_t eNewLevel)
+{
+    if (eNewLevel < eClockLevelCount)
+    {
+        eRequested = eNewLevel;
+    }
+    ulHold = 0;
+    xAutoMode = xAuto;
+
+    if (xGovernorHandle != NULL)
+    {
+        xTaskNotifyGive(xGovernorHandle);
+    }
+}
+
+void vClockGovernorGetStats(ClockGovernorStats_t *pxStats)
+{
+    uint64_t ullNowUs = ullMonoClockNowUs();
+
+    taskENTER_CRITICAL();
+    *pxStats = xStats;
+    pxStats->eLevel = eLevel;
+    pxStats->ullLevelUs[eLevel] += ullNowUs - ullLevelSinceUs;
+    taskEXIT_CRITICAL();
+    pxStats->xAuto = xAutoMode;
+}
+
+void vClockGovernorRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xClock);
+}
+
+static BaseType_t prvClockCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    static ClockGovernorStats_t xReport;
+    const char *pcParameter;
+    BaseType_t xLength;
+    UBaseType_t uxLevel;
+    ClockLevel_t i;
+
+    if (uxClockLine == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xLength);
+        if (pcParameter != NULL)
+        {
+            if (xLength == 4 && strncmp(pcParameter, "auto", 4) == 0)
+            {
+                vClockGovernorSetMode(pdTRUE, eClockLevelCount);
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Clock level left to the governor\r\n");
+                return pdFALSE;
+            }
+            for (i = eClockLevelFull; i < eClockLevelCount; i++)
+            {
+                if ((size_t) xLength == strlen(xLevels[i].pcName) &&
+                    strncmp(pcParameter, xLevels[i].pcName, (size_t) xLength) == 0)
+                {
+                    vClockGovernorSetMode(pdFALSE, i);
+                    snprintf(pcWriteBuffer, xWriteBufferLen, "Clock held at %s\r\n", xLevels[i].pcName);
+                    return pdFALSE;
+                }
+            }
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: clock [auto|full|half|low]\r\n");
+            return pdFALSE;
+        }
+        vClockGovernorGetStats(&xReport);
+    }
+
+    switch (uxClockLine++)
+    {
+    case 0:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "clock: %s (%s), cpu %lu MHz, hclk %lu MHz, pclk %lu MHz, VOS%lu\r\n",
+                 xLevels[xReport.eLevel].pcName, (xReport.xAuto != pdFALSE) ? "auto" : "held",
+                 (unsigned long) (SystemCoreClock / 1000000u), (unsigned long) (HAL_RCC_GetHCLKFreq() / 1000000u),
+                 (unsigned long) (HAL_RCC_GetPCLK1Freq() / 1000000u), (unsigned long) xLevels[xReport.eLevel].ulVosNumber);
+        return pdTRUE;
+    case 1:
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "load: %lu.%lu%%, %lu.%lu%% at the next level, rx backlog %lu, hold %lu/%u\r\n",
+                 (unsigned long) (xReport.ulBusyPermille / 10u), (unsigned long) (xReport.ulBusyPermille % 10u),
+                 (unsigned long) (ulPredictedPermille / 10u), (unsigned long) (ulPredictedPermille % 10u),
+                 (unsigned long) xReport.ulRxBacklog, (unsigned long) ulHold, CLOCK_GOVERNOR_HOLD_SAMPLES);
+        return pdTRUE;
+    case 2:
+    case 3:
+    case 4:
+        uxLevel = uxClockLine - 3u;
+        snprintf(pcWriteBuffer, xWriteBufferLen, "  %-4s %lu entries, %lu.%03lu s\r\n",
+                 xLevels[uxLevel].pcName, (unsigned long) xReport.ulEntries[uxLevel],
+                 (unsigned long) (xReport.ullLevelUs[uxLevel] / 1000000u),
+                 (unsigned long) ((xReport.ullLevelUs[uxLevel] / 1000u) % 1000u));
+        return pdTRUE;
+    default:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "changes: last %lu us, longest %lu us\r\n",
+                 (unsigned long) xReport.ulLastUs, (unsigned long) xReport.ulLongestUs);
+        uxClockLine = 0;
+        return pdFALSE;
+    }
+}
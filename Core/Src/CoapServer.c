@@ -0,0 +1,1326 @@
+/* CoapServer.c
+ *
+ * Message parsing, resource tree, deduplication cache, observers and
+ * notifications of the CoAP server (see CoapServer.h). The tree and the
+ * observers are shared by the fast path handler, in the TCP/IP task, and the
+ * server task, under xCoapMutex; the server task never holds it across a
+ * socket call, since the TCP/IP task takes it with the stack locked. The
+ * deduplication cache belongs to the fast path handler.
+ */
+#include "CoapServer.h"
+#include "StaticAlloc.h"
+#include "task.h"
+#include "semphr.h"
+#include "FreeRTOS_CLI.h"
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/udp.h"
+#include "coap/coap_common.h"
+#include "coap/coap_option.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+#define COAP_VERSION_SHIFT             6u
+#define COAP_NO_RESOURCE               (-1)
+
+/* Longest option value read in a request */
+#define COAP_MAX_UINT_OPTION           4u
+
+typedef struct
+{
+    char cName[COAP_SERVER_SEGMENT_SIZE];
+    int16_t sParent;
+    int16_t sFirstChild;
+    int16_t sNextSibling;
+    uint16_t usContentFormat;
+    BaseType_t xObservable;
+    CoapGetHandler_t pxGet;
+    CoapPutHandler_t pxPut;
+    void *pvContext;
+    UBaseType_t uxObservers;
+    uint32_t ulObserveSeq;          /* Of the last notification, 24 bits on the wire */
+    volatile BaseType_t xChanged;   /* Set by vCoapServerNotify() */
+    BaseType_t xResend;             /* A confirmable notification is due again */
+} CoapResource_t;
+
+typedef struct
+{
+    int16_t sResource;              /* COAP_NO_RESOURCE for a free entry */
+    IpAddr xPeer;
+    uint16_t usPort;
+    uint8_t ucToken[COAP_MAX_TOKEN_LEN];
+    uint8_t ucTokenLength;
+    uint8_t ucSzx;                  /* Block size of the first block of notifications */
+    uint16_t usMid;                 /* Of the last notification */
+    BaseType_t xConPending;         /* An acknowledgment is awaited */
+    BaseType_t xResend;
+    uint8_t ucRetries;
+    uint32_t ulTimeoutMs;
+    systime_t xConSent;
+    systime_t xLastCon;
+} CoapObserver_t;
+
+typedef struct
+{
+    IpAddr xPeer;                   /* Unused entry while its length is 0 */
+    uint16_t usPort;
+    uint16_t usMid;
+    systime_t xTime;
+    uint16_t usLength;              /* Of the response kept; 0 to build it again */
+    uint8_t ucResponse[COAP_SERVER_DEDUP_RESPONSE];
+} CoapDedupEntry_t;
+
+/* Fields of a request, pointing into the datagram */
+typedef struct
+{
+    uint8_t ucType;
+    uint8_t ucCode;
+    uint16_t usMid;
+    uint8_t ucTokenLength;
+    const uint8_t *pucToken;
+    const uint8_t *pucSegments[COAP_SERVER_MAX_DEPTH];
+    uint8_t ucSegmentLengths[COAP_SERVER_MAX_DEPTH];
+    uint8_t ucSegments;
+    BaseType_t xTooDeep;
+    BaseType_t xBadOption;          /* Unrecognized critical option */
+    int32_t lObserve;               /* -1 when absent */
+    int32_t lAccept;
+    int32_t lBlock2;
+    int32_t lContentFormat;
+    const uint8_t *pucPayload;
+    size_t xPayloadLength;
+} CoapRequest_t;
+
+/* Shared under xCoapMutex */
+static CoapResource_t xResources[COAP_SERVER_MAX_RESOURCES];
+static UBaseType_t uxResources = 0;
+static CoapObserver_t xObservers[COAP_SERVER_MAX_OBSERVERS];
+static uint16_t usNextMid = 0;
+static CoapServerStats_t xStats;
+static SemaphoreHandle_t xCoapMutex = NULL;
+static OsEvent xCoapEvent;
+
+/* Owned by the fast path handler */
+static uint8_t ucRx[COAP_SERVER_MAX_MESSAGE];
+static uint8_t ucRender[COAP_SERVER_MAX_REPRESENTATION];
+static CoapDedupEntry_t xDedup[COAP_SERVER_DEDUP_ENTRIES];
+static UBaseType_t uxDedupNext = 0;
+
+/* Owned by the server task */
+static Socket *pxNotifySocket = NULL;
+static uint8_t ucNotifyRender[COAP_SERVER_MAX_REPRESENTATION];
+static uint8_t ucBatchData[COAP_SERVER_BATCH][COAP_SERVER_MAX_MESSAGE];
+static SocketMsg xBatch[COAP_SERVER_BATCH];
+static systime_t xNextWake;
+
+APP_TASK_STORAGE(xCoapTask, COAP_SERVER_TASK_STACK_SIZE);
+APP_MUTEX_STORAGE(xCoapMutex);
+
+static BaseType_t prvCoapCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xCoap =
+{
+    "coap",
+    "\r\ncoap:\r\n CoAP resources, observers and counters\r\n",
+    prvCoapCommand,
+    -1
+};
+
+/* FNV-1a, the entity tag of a representation */
+static uint32_t prvHash(const uint8_t *pucData, size_t xLength)
+{
+    uint32_t ulHash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < xLength; i++)
+    {
+        ulHash = (ulHash ^ pucData[i]) * 16777619u;
+    }
+
+    return ulHash;
+}
+
+static uint8_t *prvPutOption(uint8_t *pucOut, uint16_t *pusLast, uint16_t usNumber, const uint8_t *pucValue,
+                             size_t xLength)
+{
+    uint16_t usDelta = (uint16_t) (usNumber - *pusLast);
+    uint8_t *pucHeader = pucOut++;
+    uint8_t ucDelta;
+    uint8_t ucLength;
+
+    if (usDelta < COAP_OPT_DELTA_MINUS_8_BITS)
+    {
+        ucDelta = (uint8_t) usDelta;
+    }
+    else if (usDelta < COAP_OPT_DELTA_MINUS_16_BITS)
+    {
+        ucDelta = COAP_OPT_DELTA_8_BITS;
+        *pucOut++ = (uint8_t) (usDelta - COAP_OPT_DELTA_MINUS_8_BITS);
+    }
+    else
+    {
+        ucDelta = COAP_OPT_DELTA_16_BITS;
+        *pucOut++ = (uint8_t) ((usDelta - COAP_OPT_DELTA_MINUS_16_BITS) >> 8);
+        *pucOut++ = (uint8_t) ((usDelta - COAP_OPT_DELTA_MINUS_16_BITS) & 0xFFu);
+    }
+
+    /* The values written here are short */
+    if (xLength < COAP_OPT_LEN_MINUS_8_BITS)
+    {
+        ucLength = (uint8_t) xLength;
+    }
+    else
+    {
+        ucLength = COAP_OPT_LEN_8_BITS;
+        *pucOut++ = (uint8_t) (xLength - COAP_OPT_LEN_MINUS_8_BITS);
+    }
+
+    *pucHeader = (uint8_t) ((ucDelta << 4) | ucLength);
+    memcpy(pucOut, pucValue, xLength);
+    *pusLast = usNumber;
+
+    return pucOut + xLength;
+}
+
+/* Unsigned integer option, in as few bytes as the value needs */
+static uint8_t *prvPutUintOption(uint8_t *pucOut, uint16_t *pusLast, uint16_t usNumber, uint32_t ulValue)
+{
+    uint8_t ucValue[4];
+    size_t xLength = 0;
+    int32_t i;
+
+    for (i = 3; i >= 0; i--)
+    {
+        if (xLength > 0 || ((ulValue >> (8 * i)) & 0xFFu) != 0)
+        {
+            ucValue[xLength++] = (uint8_t) (ulValue >> (8 * i));
+        }
+    }
+
+    return prvPutOption(pucOut, pusLast, usNumber, ucValue, xLength);
+}
+
+static uint8_t *prvPutHeader(uint8_t *pucOut, uint8_t ucType, uint8_t ucCode, uint16_t usMid,
+                             const uint8_t *pucToken, uint8_t ucTokenLength)
+{
+    pucOut[0] = (uint8_t) ((COAP_VERSION_1 << COAP_VERSION_SHIFT) | (ucType << 4) | ucTokenLength);
+    pucOut[1] = ucCode;
+    pucOut[2] = (uint8_t) (usMid >> 8);
+    pucOut[3] = (uint8_t) (usMid & 0xFFu);
+    if (ucTokenLength > 0)
+    {
+        memcpy(&pucOut[COAP_HEADER_SIZE], pucToken, ucTokenLength);
+    }
+
+    return &pucOut[COAP_HEADER_SIZE + ucTokenLength];
+}
+
+/* Options and payload of block ulBlock of a representation; the Block2
+   option is added when the representation takes several blocks or the
+   client asked for one. Returns NULL if the block is past the end */
+static uint8_t *prvPutRepresentation(uint8_t *pucOut, const CoapResource_t *pxResource, int32_t lObserveSeq,
+                                     const uint8_t *pucData, size_t xLength, uint32_t ulEtag,
+                                     uint32_t ulBlock, uint8_t ucSzx, BaseType_t xBlockAsked)
+{
+    size_t xBlockSize = (size_t) 16u << ucSzx;
+    size_t xOffset = (size_t) ulBlock * xBlockSize;
+    size_t xChunk;
+    uint8_t ucEtag[4];
+    uint16_t usLast = 0;
+    BaseType_t xMore;
+
+    if (xOffset > xLength || (xOffset == xLength && ulBlock > 0))
+    {
+        return NULL;
+    }
+
+    xChunk = MIN(xBlockSize, xLength - xOffset);
+    xMore = (xOffset + xChunk < xLength) ? pdTRUE : pdFALSE;
+
+    ucEtag[0] = (uint8_t) (ulEtag >> 24);
+    ucEtag[1] = (uint8_t) (ulEtag >> 16);
+    ucEtag[2] = (uint8_t) (ulEtag >> 8);
+    ucEtag[3] = (uint8_t) (ulEtag & 0xFFu);
+    pucOut = prvPutOption(pucOut, &usLast, COAP_OPT_ETAG, ucEtag, sizeof(ucEtag));
+
+    if (lObserveSeq >= 0)
+    {
+        pucOut = prvPutUintOption(pucOut, &usLast, COAP_OPT_OBSERVE, (uint32_t) lObserveSeq & 0xFFFFFFu);
+    }
+
+    pucOut = prvPutUintOption(pucOut, &usLast, COAP_OPT_CONTENT_FORMAT, pxResource->usContentFormat);
+
+    if (xMore != pdFALSE || xBlockAsked != pdFALSE)
+    {
+        pucOut = prvPutUintOption(pucOut, &usLast, COAP_OPT_BLOCK2,
+                                  (ulBlock << 4) | ((xMore != pdFALSE) ? 0x08u : 0u) | ucSzx);
+        if (ulBlock == 0)
+        {
+            pucOut = prvPutUintOption(pucOut, &usLast, COAP_OPT_SIZE2, (uint32_t) xLength);
+        }
+    }
+
+    if (xChunk > 0)
+    {
+        *pucOut++ = COAP_PAYLOAD_MARKER;
+        memcpy(pucOut, &pucData[xOffset], xChunk);
+        pucOut += xChunk;
+    }
+
+    return pucOut;
+}
+
+/* Unsigned integer option value, or -1 if too long */
+static int32_t prvUintValue(const uint8_t *pucValue, size_t xLength)
+{
+    uint32_t ulValue = 0;
+    size_t i;
+
+    if (xLength >= COAP_MAX_UINT_OPTION)
+    {
+        return -1;
+    }
+
+    for (i = 0; i < xLength; i++)
+    {
+        ulValue = (ulValue << 8) | pucValue[i];
+    }
+
+    return (int32_t) ulValue;
+}
+
+/* Extended option delta or length; pdFALSE if reserved or truncated */
+static BaseType_t prvOptionField(const uint8_t *pucData, size_t xLength, size_t *pxPos, uint32_t *pulField)
+{
+    if (*pulField == COAP_OPT_DELTA_8_BITS)
+    {
+        if (*pxPos + 1u > xLength)
+        {
+            return pdFALSE;
+        }
+        *pulField = pucData[(*pxPos)++] + COAP_OPT_DELTA_MINUS_8_BITS;
+    }
+    else if (*pulField == COAP_OPT_DELTA_16_BITS)
+    {
+        if (*pxPos + 2u > xLength)
+        {
+            return pdFALSE;
+        }
+        *pulField = (((uint32_t) pucData[*pxPos] << 8) | pucData[*pxPos + 1u]) + COAP_OPT_DELTA_MINUS_16_BITS;
+        *pxPos += 2u;
+    }
+    else if (*pulField == COAP_OPT_DELTA_RESERVED)
+    {
+        return pdFALSE;
+    }
+
+    return pdTRUE;
+}
+
+/* pdFALSE if the message is malformed */
+static BaseType_t prvParse(const uint8_t *pucData, size_t xLength, CoapRequest_t *pxRequest)
+{
+    size_t xPos;
+    uint32_t ulNumber = 0;
+    uint32_t ulDelta;
+    uint32_t ulLength;
+
+    memset(pxRequest, 0, sizeof(*pxRequest));
+    pxRequest->lObserve = -1;
+    pxRequest->lAccept = -1;
+    pxRequest->lBlock2 = -1;
+    pxRequest->lContentFormat = -1;
+
+    if (xLength < COAP_HEADER_SIZE)
+    {
+        return pdFALSE;
+    }
+
+    pxRequest->ucType = (uint8_t) ((pucData[0] >> 4) & 0x03u);
+    pxRequest->ucTokenLength = (uint8_t) (pucData[0] & 0x0Fu);
+    pxRequest->ucCode = pucData[1];
+    pxRequest->usMid = (uint16_t) (((uint16_t) pucData[2] << 8) | pucData[3]);
+    pxRequest->pucToken = &pucData[COAP_HEADER_SIZE];
+
+    if ((pucData[0] >> COAP_VERSION_SHIFT) != COAP_VERSION_1 || pxRequest->ucTokenLength > COAP_MAX_TOKEN_LEN ||
+        xLength < COAP_HEADER_SIZE + (size_t) pxRequest->ucTokenLength)
+    {
+        return pdFALSE;
+    }
+
+    xPos = COAP_HEADER_SIZE + pxRequest->ucTokenLength;
+    while (xPos < xLength)
+    {
+        if (pucData[xPos] == COAP_PAYLOAD_MARKER)
+        {
+            /* A marker must be followed by a payload */
+            xPos++;
+            if (xPos == xLength)
+            {
+                return pdFALSE;
+            }
+            pxRequest->pucPayload = &pucData[xPos];
+            pxRequest->xPayloadLength = xLength - xPos;
+            break;
+        }
+
+        ulDelta = pucData[xPos] >> 4;
+        ulLength = pucData[xPos] & 0x0Fu;
+        xPos++;
+        if (prvOptionField(pucData, xLength, &xPos, &ulDelta) == pdFALSE ||
+            prvOptionField(pucData, xLength, &xPos, &ulLength) == pdFALSE || xPos + ulLength > xLength)
+        {
+            return pdFALSE;
+        }
+
+        ulNumber += ulDelta;
+        switch (ulNumber)
+        {
+        case COAP_OPT_URI_PATH:
+            if (pxRequest->ucSegments < COAP_SERVER_MAX_DEPTH && ulLength < COAP_SERVER_SEGMENT_SIZE)
+            {
+                pxRequest->pucSegments[pxRequest->ucSegments] = &pucData[xPos];
+                pxRequest->ucSegmentLengths[pxRequest->ucSegments++] = (uint8_t) ulLength;
+            }
+            else
+            {
+                pxRequest->xTooDeep = pdTRUE;
+            }
+            break;
+        case COAP_OPT_OBSERVE:
+            pxRequest->lObserve = prvUintValue(&pucData[xPos], ulLength);
+            break;
+        case COAP_OPT_ACCEPT:
+            pxRequest->lAccept = prvUintValue(&pucData[xPos], ulLength);
+            break;
+        case COAP_OPT_BLOCK2:
+            pxRequest->lBlock2 = prvUintValue(&pucData[xPos], ulLength);
+            break;
+        case COAP_OPT_CONTENT_FORMAT:
+            pxRequest->lContentFormat = prvUintValue(&pucData[xPos], ulLength);
+            break;
+        case COAP_OPT_URI_HOST:
+        case COAP_OPT_URI_PORT:
+        case COAP_OPT_URI_QUERY:
+            /* This server has a single origin and no query parameters */
+            break;
+        default:
+            /* Odd numbers are critical: the request cannot be served
+               without understanding them */
+            if ((ulNumber & 1u) != 0)
+            {
+                pxRequest->xBadOption = pdTRUE;
+            }
+            break;
+        }
+
+        xPos += ulLength;
+    }
+
+    return pdTRUE;
+}
+
+/* Resource at the path of the request, or COAP_NO_RESOURCE */
+static int16_t prvFindResource(const CoapRequest_t *pxRequest)
+{
+    int16_t sNode = 0;
+    int16_t sChild;
+    uint8_t i;
+
+    if (pxRequest->xTooDeep != pdFALSE)
+    {
+        return COAP_NO_RESOURCE;
+    }
+
+    for (i = 0; i < pxRequest->ucSegments; i++)
+    {
+        for (sChild = xResources[sNode].sFirstChild; sChild != COAP_NO_RESOURCE;
+             sChild = xResources[sChild].sNextSibling)
+        {
+            if (strlen(xResources[sChild].cName) == pxRequest->ucSegmentLengths[i] &&
+                memcmp(xResources[sChild].cName, pxRequest->pucSegments[i], pxRequest->ucSegmentLengths[i]) == 0)
+            {
+                break;
+            }
+        }
+        if (sChild == COAP_NO_RESOURCE)
+        {
+            return COAP_NO_RESOURCE;
+        }
+        sNode = sChild;
+    }
+
+    return sNode;
+}
+
+/* "/a/b" path of a resource */
+static void prvFormatPath(int16_t sResource, char *pcBuffer, size_t xSize)
+{
+    int16_t sPath[COAP_SERVER_MAX_DEPTH];
+    size_t xUsed = 0;
+    UBaseType_t uxDepth = 0;
+
+    for (; sResource > 0 && uxDepth < COAP_SERVER_MAX_DEPTH; sResource = xResources[sResource].sParent)
+    {
+        sPath[uxDepth++] = sResource;
+    }
+
+    pcBuffer[0] = '\0';
+    while (uxDepth > 0 && xUsed < xSize)
+    {
+        xUsed += (size_t) snprintf(&pcBuffer[xUsed], xSize - xUsed, "/%s", xResources[sPath[--uxDepth]].cName);
+    }
+}
+
+/* /.well-known/core, in the CoRE link format (RFC 6690) */
+static size_t prvWellKnownCore(void *pvContext, uint8_t *pucBuffer, size_t xSize)
+{
+    char cPath[COAP_SERVER_MAX_DEPTH * COAP_SERVER_SEGMENT_SIZE];
+    char *pcBuffer = (char *) pucBuffer;
+    size_t xUsed = 0;
+    size_t xLink;
+    UBaseType_t i;
+
+    (void) pvContext;
+
+    for (i = 1; i < uxResources; i++)
+    {
+        if ((xResources[i].pxGet == NULL && xResources[i].pxPut == NULL) || xResources[i].pxGet == prvWellKnownCore)
+        {
+            continue;
+        }
+
+        prvFormatPath((int16_t) i, cPath, sizeof(cPath));
+        xLink = strlen(cPath) + 32u;
+        if (xUsed + xLink > xSize)
+        {
+            break;
+        }
+        xUsed += (size_t) snprintf(&pcBuffer[xUsed], xSize - xUsed, "%s<%s>;ct=%u%s", (xUsed > 0) ? "," : "",
+                                   cPath, xResources[i].usContentFormat,
+                                   (xResources[i].xObservable != pdFALSE) ? ";obs" : "");
+    }
+
+    return xUsed;
+}
+
+static void prvRemoveObserver(CoapObserver_t *pxObserver)
+{
+    xResources[pxObserver->sResource].uxObservers--;
+    pxObserver->sResource = COAP_NO_RESOURCE;
+    xStats.ulObserversRemoved++;
+}
+
+/* Observer of the endpoint with this token, or NULL */
+static CoapObserver_t *prvFindObserver(const IpAddr *pxPeer, uint16_t usPort, const uint8_t *pucToken,
+                                       uint8_t ucTokenLength)
+{
+    UBaseType_t i;
+
+    for (i = 0; i < COAP_SERVER_MAX_OBSERVERS; i++)
+    {
+        if (xObservers[i].sResource != COAP_NO_RESOURCE && xObservers[i].usPort == usPort &&
+            xObservers[i].ucTokenLength == ucTokenLength && ipCompAddr(&xObservers[i].xPeer, pxPeer) &&
+            memcmp(xObservers[i].ucToken, pucToken, ucTokenLength) == 0)
+        {
+            return &xObservers[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Add or refresh an observer; pdFALSE if the table is full */
+static BaseType_t prvAddObserver(int16_t sResource, const CoapRequest_t *pxRequest, const IpAddr *pxPeer,
+                                 uint16_t usPort, uint8_t ucSzx, uint16_t usMid)
+{
+    CoapObserver_t *pxObserver;
+    UBaseType_t i;
+
+    pxObserver = prvFindObserver(pxPeer, usPort, pxRequest->pucToken, pxRequest->ucTokenLength);
+    if (pxObserver != NULL && pxObserver->sResource != sResource)
+    {
+        /* Same token for another resource: the previous one is cancelled */
+        prvRemoveObserver(pxObserver);
+        pxObserver = NULL;
+    }
+
+    for (i = 0; pxObserver == NULL && i < COAP_SERVER_MAX_OBSERVERS; i++)
+    {
+        if (xObservers[i].sResource == COAP_NO_RESOURCE)
+        {
+            pxObserver = &xObservers[i];
+            memset(pxObserver, 0, sizeof(*pxObserver));
+            pxObserver->sResource = sResource;
+            pxObserver->xPeer = *pxPeer;
+            pxObserver->usPort = usPort;
+            memcpy(pxObserver->ucToken, pxRequest->pucToken, pxRequest->ucTokenLength);
+            pxObserver->ucTokenLength = pxRequest->ucTokenLength;
+            pxObserver->xLastCon = osGetSystemTime();
+            xResources[sResource].uxObservers++;
+            xStats.ulObserversAdded++;
+        }
+    }
+
+    if (pxObserver == NULL)
+    {
+        xStats.ulObserversRefused++;
+        return pdFALSE;
+    }
+
+    pxObserver->ucSzx = ucSzx;
+    if (pxObserver->xConPending == pdFALSE)
+    {
+        pxObserver->usMid = usMid;
+    }
+
+    return pdTRUE;
+}
+
+/* Execute a request, formatting the response; returns its length */
+static size_t prvHandleRequest(const CoapRequest_t *pxRequest, const IpAddr *pxPeer, uint16_t usPort,
+                               uint8_t *pucOut)
+{
+    CoapObserver_t *pxObserver;
+    CoapResource_t *pxResource = NULL;
+    uint8_t *pucEnd = NULL;
+    uint8_t *pucOptions;
+    uint8_t ucType;
+    uint8_t ucCode;
+    uint8_t ucSzx = COAP_SERVER_BLOCK_SZX;
+    uint32_t ulBlock = 0;
+    int32_t lObserveSeq = -1;
+    int16_t sResource;
+    size_t xLength;
+    uint16_t usMid;
+
+    xSemaphoreTake(xCoapMutex, portMAX_DELAY);
+
+    /* Piggybacked response to a confirmable request, else a new message */
+    ucType = (pxRequest->ucType == COAP_TYPE_CON) ? COAP_TYPE_ACK : COAP_TYPE_NON;
+    usMid = (pxRequest->ucType == COAP_TYPE_CON) ? pxRequest->usMid : usNextMid++;
+    pucOptions = prvPutHeader(pucOut, ucType, COAP_CODE_CONTENT, usMid, pxRequest->pucToken,
+                              pxRequest->ucTokenLength);
+
+    sResource = prvFindResource(pxRequest);
+    if (sResource != COAP_NO_RESOURCE)
+    {
+        pxResource = &xResources[sResource];
+    }
+
+    if (pxRequest->xBadOption != pdFALSE)
+    {
+        ucCode = COAP_CODE_BAD_OPTION;
+    }
+    else if (pxResource == NULL || (pxResource->pxGet == NULL && pxResource->pxPut == NULL))
+    {
+        ucCode = COAP_CODE_NOT_FOUND;
+    }
+    else if (pxRequest->ucCode == COAP_CODE_GET && pxResource->pxGet != NULL)
+    {
+        if (pxRequest->lAccept >= 0 && (uint32_t) pxRequest->lAccept != pxResource->usContentFormat)
+        {
+            ucCode = COAP_CODE_NOT_ACCEPTABLE;
+        }
+        else
+        {
+            ucCode = COAP_CODE_CONTENT;
+            if (pxRequest->lBlock2 >= 0)
+            {
+                /* The smaller of the two block sizes */
+                ulBlock = (uint32_t) pxRequest->lBlock2 >> 4;
+                ucSzx = (uint8_t) MIN((uint32_t) pxRequest->lBlock2 & 0x07u, COAP_SERVER_BLOCK_SZX);
+            }
+
+            if (pxRequest->lObserve == COAP_OBSERVE_REGISTER && pxResource->xObservable != pdFALSE && ulBlock == 0 &&
+                prvAddObserver(sResource, pxRequest, pxPeer, usPort, ucSzx, usMid) != pdFALSE)
+            {
+                lObserveSeq = (int32_t) (pxResource->ulObserveSeq & 0xFFFFFFu);
+            }
+            else if (pxRequest->lObserve != COAP_OBSERVE_REGISTER || ulBlock != 0)
+            {
+                /* A deregistration, or a plain GET with the token of an
+                   observation, ends it; fetching the next blocks does not */
+                pxObserver = prvFindObserver(pxPeer, usPort, pxRequest->pucToken, pxRequest->ucTokenLength);
+                if (pxObserver != NULL && pxObserver->sResource == sResource && pxRequest->lBlock2 < 0)
+                {
+                    prvRemoveObserver(pxObserver);
+                }
+            }
+
+            xLength = pxResource->pxGet(pxResource->pvContext, ucRender, sizeof(ucRender));
+            pucEnd = prvPutRepresentation(pucOptions, pxResource, lObserveSeq, ucRender, xLength,
+                                          prvHash(ucRender, xLength), ulBlock, ucSzx,
+                                          (pxRequest->lBlock2 >= 0) ? pdTRUE : pdFALSE);
+            if (pucEnd == NULL)
+            {
+                ucCode = COAP_CODE_BAD_OPTION;
+            }
+            else if (ulBlock > 0 || pxRequest->lBlock2 >= 0 || xLength > ((size_t) 16u << ucSzx))
+            {
+                xStats.ulBlocks++;
+            }
+        }
+    }
+    else if ((pxRequest->ucCode == COAP_CODE_PUT || pxRequest->ucCode == COAP_CODE_POST) && pxResource->pxPut != NULL)
+    {
+        ucCode = pxResource->pxPut(pxResource->pvContext, pxRequest->ucCode, pxRequest->pucPayload,
+                                   pxRequest->xPayloadLength,
+                                   (pxRequest->lContentFormat >= 0) ? (uint16_t) pxRequest->lContentFormat :
+                                   COAP_SERVER_NO_FORMAT);
+    }
+    else
+    {
+        ucCode = COAP_CODE_METHOD_NOT_ALLOWED;
+    }
+
+    if (ucCode != COAP_CODE_CONTENT || pucEnd == NULL)
+    {
+        pucEnd = pucOptions;
+    }
+    if (ucCode == COAP_CODE_BAD_OPTION)
+    {
+        xStats.ulBadRequests++;
+    }
+    pucOut[1] = ucCode;
+
+    xSemaphoreGive(xCoapMutex);
+
+    return (size_t) (pucEnd - pucOut);
+}
+
+/* Acknowledgment or reset of a notification */
+static void prvHandleReply(const CoapRequest_t *pxReply, const IpAddr *pxPeer, uint16_t usPort)
+{
+    CoapObserver_t *pxObserver;
+    UBaseType_t i;
+
+    xSemaphoreTake(xCoapMutex, portMAX_DELAY);
+
+    for (i = 0; i < COAP_SERVER_MAX_OBSERVERS; i++)
+    {
+        pxObserver = &xObservers[i];
+        if (pxObserver->sResource == COAP_NO_RESOURCE || pxObserver->usMid != pxReply->usMid ||
+            pxObserver->usPort != usPort || !ipCompAddr(&pxObserver->xPeer, pxPeer))
+        {
+            continue;
+        }
+
+        if (pxReply->ucType == COAP_TYPE_RST)
+        {
+            /* The client is no longer interested */
+            prvRemoveObserver(pxObserver);
+        }
+        else if (pxObserver->xConPending != pdFALSE)
+        {
+            pxObserver->xConPending = pdFALSE;
+            pxObserver->xResend = pdFALSE;
+            pxObserver->xLastCon = osGetSystemTime();
+        }
+        break;
+    }
+
+    xSemaphoreGive(xCoapMutex);
+}
+
+/* Request from the endpoint with this message ID seen recently, or NULL */
+static CoapDedupEntry_t *prvDedupFind(const IpAddr *pxPeer, uint16_t usPort, uint16_t usMid, systime_t xNow)
+{
+    UBaseType_t i;
+
+    for (i = 0; i < COAP_SERVER_DEDUP_ENTRIES; i++)
+    {
+        if (xDedup[i].xPeer.length != 0 && xDedup[i].usMid == usMid && xDedup[i].usPort == usPort &&
+            xNow - xDedup[i].xTime < COAP_SERVER_EXCHANGE_LIFETIME_MS && ipCompAddr(&xDedup[i].xPeer, pxPeer))
+        {
+            return &xDedup[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Remember a request, replacing the oldest entry */
+static void prvDedupAdd(const IpAddr *pxPeer, uint16_t usPort, uint16_t usMid, systime_t xNow,
+                        const uint8_t *pucResponse, size_t xLength)
+{
+    CoapDedupEntry_t *pxEntry = &xDedup[uxDedupNext];
+
+    uxDedupNext = (uxDedupNext + 1u) % COAP_SERVER_DEDUP_ENTRIES;
+
+    pxEntry->xPeer = *pxPeer;
+    pxEntry->usPort = usPort;
+    pxEntry->usMid = usMid;
+    pxEntry->xTime = xNow;
+    pxEntry->usLength = 0;
+    if (pucResponse != NULL && xLength <= sizeof(pxEntry->ucResponse))
+    {
+        memcpy(pxEntry->ucResponse, pucResponse, xLength);
+        pxEntry->usLength = (uint16_t) xLength;
+    }
+}
+
+/* Send from the TCP/IP task, the stack being locked already */
+static void prvSendDirect(NetInterface *pxInterface, const IpAddr *pxPeer, uint16_t usPort,
+                          NetBuffer *pxBuffer, size_t xOffset)
+{
+    NetTxAncillary xAncillary = NET_DEFAULT_TX_ANCILLARY;
+
+    (void) udpSendBuffer(pxInterface, NULL, COAP_PORT, pxPeer, usPort, pxBuffer, xOffset, &xAncillary);
+    netBufferFree(pxBuffer);
+}
+
+/* Empty reset, for pings and messages which cannot be processed */
+static void prvSendReset(NetInterface *pxInterface, const IpAddr *pxPeer, uint16_t usPort, uint16_t usMid)
+{
+    NetBuffer *pxBuffer;
+    size_t xOffset;
+    uint8_t *pucOut;
+
+    pxBuffer = udpAllocBuffer(COAP_HEADER_SIZE, &xOffset);
+    if (pxBuffer == NULL)
+    {
+        return;
+    }
+
+    pucOut = netBufferAt(pxBuffer, xOffset, COAP_HEADER_SIZE);
+    (void) prvPutHeader(pucOut, COAP_TYPE_RST, COAP_CODE_EMPTY, usMid, NULL, 0);
+    prvSendDirect(pxInterface, pxPeer, usPort, pxBuffer, xOffset);
+}
+
+/* Fast path handler of the CoAP port, in the TCP/IP task */
+static void prvCoapRx(NetInterface *interface, const IpPseudoHeader *pseudoHeader, const UdpHeader *header,
+                      const NetBuffer *buffer, size_t offset, const NetRxAncillary *ancillary, void *param)
+{
+    CoapRequest_t xRequest;
+    CoapDedupEntry_t *pxEntry;
+    NetBuffer *pxBuffer;
+    systime_t xNow = osGetSystemTime();
+    IpAddr xPeer;
+    uint16_t usPort;
+    uint8_t *pucOut;
+    size_t xLength;
+    size_t xOffset;
+    BaseType_t xMulticast;
+
+    (void) ancillary;
+    (void) param;
+
+    if (pseudoHeader->length != sizeof(Ipv4PseudoHeader))
+    {
+        return;
+    }
+
+    xLength = netBufferGetLength(buffer) - offset;
+    if (xLength > sizeof(ucRx))
+    {
+        xStats.ulBadRequests++;
+        return;
+    }
+    (void) netBufferRead(ucRx, buffer, offset, xLength);
+
+    xPeer.length = sizeof(Ipv4Addr);
+    xPeer.ipv4Addr = pseudoHeader->ipv4Data.srcAddr;
+    usPort = ntohs(header->srcPort);
+    xMulticast = (ipv4IsMulticastAddr(pseudoHeader->ipv4Data.destAddr) ||
+                  pseudoHeader->ipv4Data.destAddr == IPV4_BROADCAST_ADDR) ? pdTRUE : pdFALSE;
+
+    if (prvParse(ucRx, xLength, &xRequest) == pdFALSE)
+    {
+        xStats.ulBadRequests++;
+        if (xLength >= COAP_HEADER_SIZE && xRequest.ucType == COAP_TYPE_CON && xMulticast == pdFALSE)
+        {
+            prvSendReset(interface, &xPeer, usPort, xRequest.usMid);
+        }
+        return;
+    }
+
+    if (xRequest.ucType == COAP_TYPE_ACK || xRequest.ucType == COAP_TYPE_RST)
+    {
+        prvHandleReply(&xRequest, &xPeer, usPort);
+        return;
+    }
+
+    /* Pings, and responses sent to a server, are answered with a reset */
+    if (COAP_GET_CODE_CLASS(xRequest.ucCode) != 0 || xRequest.ucCode == COAP_CODE_EMPTY)
+    {
+        if (xRequest.ucType == COAP_TYPE_CON && xMulticast == pdFALSE)
+        {
+            prvSendReset(interface, &xPeer, usPort, xRequest.usMid);
+        }
+        return;
+    }
+
+    xStats.ulRequests++;
+
+    pxEntry = prvDedupFind(&xPeer, usPort, xRequest.usMid, xNow);
+    if (pxEntry != NULL)
+    {
+        xStats.ulDuplicates++;
+        if (xRequest.ucType != COAP_TYPE_CON)
+        {
+            return;
+        }
+        if (pxEntry->usLength > 0)
+        {
+            pxBuffer = udpAllocBuffer(pxEntry->usLength, &xOffset);
+            if (pxBuffer != NULL)
+            {
+                (void) netBufferWrite(pxBuffer, xOffset, pxEntry->ucResponse, pxEntry->usLength);
+                prvSendDirect(interface, &xPeer, usPort, pxBuffer, xOffset);
+            }
+            return;
+        }
+        /* Too long to be kept: the request is safe to execute again */
+    }
+
+    /* The response is formatted in the buffer it is sent from */
+    pxBuffer = udpAllocBuffer(COAP_SERVER_MAX_MESSAGE, &xOffset);
+    if (pxBuffer == NULL)
+    {
+        return;
+    }
+    pucOut = netBufferAt(pxBuffer, xOffset, COAP_SERVER_MAX_MESSAGE);
+    if (pucOut == NULL)
+    {
+        netBufferFree(pxBuffer);
+        return;
+    }
+
+    xLength = prvHandleRequest(&xRequest, &xPeer, usPort, pucOut);
+
+    if (pxEntry == NULL)
+    {
+        prvDedupAdd(&xPeer, usPort, xRequest.usMid, xNow, pucOut, xLength);
+    }
+
+    /* Errors are not reported to multicast requests (RFC 7252, 8.1) */
+    if (xMulticast != pdFALSE && COAP_GET_CODE_CLASS(pucOut[1]) != COAP_CODE_CLASS_SUCCESS)
+    {
+        netBufferFree(pxBuffer);
+        return;
+    }
+
+    netBufferSetLength(pxBuffer, xOffset + xLength);
+    prvSendDirect(interface, &xPeer, usPort, pxBuffer, xOffset);
+}
+
+static void prvFlushBatch(UBaseType_t uxCount)
+{
+    uint_t uSent = 0;
+
+    if (uxCount == 0)
+    {
+        return;
+    }
+
+    (void) socketSendMsgBatch(pxNotifySocket, xBatch, uxCount, &uSent, 0);
+
+    xSemaphoreTake(xCoapMutex, portMAX_DELAY);
+    xStats.ulBatches++;
+    xSemaphoreGive(xCoapMutex);
+}
+
+/* Notify the observers of a resource which changed, or whose confirmable
+   notification is due again: the representation is read once, and sent
+   COAP_SERVER_BATCH datagrams at a time */
+static void prvNotify(int16_t sResource)
+{
+    CoapResource_t *pxResource = &xResources[sResource];
+    CoapObserver_t *pxObserver;
+    systime_t xNow = osGetSystemTime();
+    BaseType_t xChanged;
+    UBaseType_t uxCount;
+    UBaseType_t i = 0;
+    uint32_t ulEtag;
+    uint32_t ulSeq;
+    uint8_t *pucOut;
+    uint8_t *pucEnd;
+    uint8_t ucType;
+    size_t xLength;
+
+    xSemaphoreTake(xCoapMutex, portMAX_DELAY);
+    xChanged = pxResource->xChanged;
+    pxResource->xChanged = pdFALSE;
+    pxResource->xResend = pdFALSE;
+    if (pxResource->uxObservers == 0)
+    {
+        xSemaphoreGive(xCoapMutex);
+        return;
+    }
+    xLength = pxResource->pxGet(pxResource->pvContext, ucNotifyRender, sizeof(ucNotifyRender));
+    if (xChanged != pdFALSE)
+    {
+        pxResource->ulObserveSeq++;
+    }
+    ulSeq = pxResource->ulObserveSeq;
+    xSemaphoreGive(xCoapMutex);
+
+    ulEtag = prvHash(ucNotifyRender, xLength);
+
+    while (i < COAP_SERVER_MAX_OBSERVERS)
+    {
+        uxCount = 0;
+
+        xSemaphoreTake(xCoapMutex, portMAX_DELAY);
+        for (; i < COAP_SERVER_MAX_OBSERVERS && uxCount < COAP_SERVER_BATCH; i++)
+        {
+            pxObserver = &xObservers[i];
+            if (pxObserver->sResource != sResource || (xChanged == pdFALSE && pxObserver->xResend == pdFALSE))
+            {
+                continue;
+            }
+
+            /* A new notification replaces one not acknowledged yet, which
+               keeps its message ID and retransmission counter */
+            if (pxObserver->xConPending != pdFALSE)
+            {
+                ucType = COAP_TYPE_CON;
+                if (pxObserver->xResend != pdFALSE)
+                {
+                    xStats.ulRetransmitted++;
+                }
+            }
+            else if (xNow - pxObserver->xLastCon >= COAP_SERVER_CON_INTERVAL_MS)
+            {
+                ucType = COAP_TYPE_CON;
+                pxObserver->usMid = usNextMid++;
+                pxObserver->xConPending = pdTRUE;
+                pxObserver->ucRetries = 0;
+                pxObserver->ulTimeoutMs = COAP_SERVER_ACK_TIMEOUT_MS;
+                pxObserver->xConSent = xNow;
+            }
+            else
+            {
+                ucType = COAP_TYPE_NON;
+                pxObserver->usMid = usNextMid++;
+            }
+            pxObserver->xResend = pdFALSE;
+
+            pucOut = ucBatchData[uxCount];
+            pucEnd = prvPutHeader(pucOut, ucType, COAP_CODE_CONTENT, pxObserver->usMid, pxObserver->ucToken,
+                                  pxObserver->ucTokenLength);
+            pucEnd = prvPutRepresentation(pucEnd, pxResource, (int32_t) (ulSeq & 0xFFFFFFu), ucNotifyRender, xLength,
+                                          ulEtag, 0, pxObserver->ucSzx, pdFALSE);
+
+            xBatch[uxCount] = SOCKET_DEFAULT_MSG;
+            xBatch[uxCount].data = pucOut;
+            xBatch[uxCount].size = (size_t) (pucEnd - pucOut);
+            xBatch[uxCount].length = xBatch[uxCount].size;
+            xBatch[uxCount].destIpAddr = pxObserver->xPeer;
+            xBatch[uxCount].destPort = pxObserver->usPort;
+            uxCount++;
+
+            if (ucType == COAP_TYPE_CON)
+            {
+                xStats.ulConfirmable++;
+            }
+            else
+            {
+                xStats.ulNotifications++;
+            }
+        }
+        xSemaphoreGive(xCoapMutex);
+
+        prvFlushBatch(uxCount);
+    }
+}
+
+/* Confirmable notifications not acknowledged in time are sent again, up to
+   COAP_SERVER_MAX_RETRANSMIT times; then the observer is given up */
+static void prvCheckRetransmissions(void)
+{
+    systime_t xNow = osGetSystemTime();
+    CoapObserver_t *pxObserver;
+    UBaseType_t i;
+
+    xSemaphoreTake(xCoapMutex, portMAX_DELAY);
+
+    for (i = 0; i < COAP_SERVER_MAX_OBSERVERS; i++)
+    {
+        pxObserver = &xObservers[i];
+        if (pxObserver->sResource == COAP_NO_RESOURCE || pxObserver->xConPending == pdFALSE ||
+            pxObserver->xResend != pdFALSE)
+        {
+            continue;
+        }
+
+        if (xNow - pxObserver->xConSent < pxObserver->ulTimeoutMs)
+        {
+            if (timeCompare(pxObserver->xConSent + pxObserver->ulTimeoutMs, xNextWake) < 0)
+            {
+                xNextWake = pxObserver->xConSent + pxObserver->ulTimeoutMs;
+            }
+            continue;
+        }
+
+        if (pxObserver->ucRetries >= COAP_SERVER_MAX_RETRANSMIT)
+        {
+            prvRemoveObserver(pxObserver);
+            continue;
+        }
+
+        pxObserver->ucRetries++;
+        pxObserver->xConSent = xNow;
+        pxObserver->ulTimeoutMs *= 2u;
+        pxObserver->xResend = pdTRUE;
+        xResources[pxObserver->sResource].xResend = pdTRUE;
+    }
+
+    xSemaphoreGive(xCoapMutex);
+}
+
+static void prvCoapTask(void *pvParameters)
+{
+    systime_t xNow;
+    UBaseType_t i;
+
+    (void) pvParameters;
+
+    /* Notifications leave from the CoAP port, which the fast path serves */
+    pxNotifySocket = socketOpen(SOCKET_TYPE_DGRAM, SOCKET_IP_PROTO_UDP);
+    if (pxNotifySocket == NULL || socketBind(pxNotifySocket, &IP_ADDR_ANY, COAP_PORT) != NO_ERROR ||
+        udpRegisterFastPath(NULL, COAP_PORT, prvCoapRx, NULL) != NO_ERROR)
+    {
+        vTaskDelete(NULL);
+        return;
+    }
+
+    for (;;)
+    {
+        /* Wake up once a second at least */
+        xNextWake = osGetSystemTime() + 1000u;
+
+        prvCheckRetransmissions();
+
+        for (i = 1; i < uxResources; i++)
+        {
+            if (xResources[i].xChanged != pdFALSE || xResources[i].xResend != pdFALSE)
+            {
+                prvNotify((int16_t) i);
+            }
+        }
+
+        xNow = osGetSystemTime();
+        (void) osWaitForEvent(&xCoapEvent, (timeCompare(xNextWake, xNow) > 0) ? xNextWake - xNow : 0);
+    }
+}
+
+BaseType_t xCoapServerStart(UBaseType_t uxPriority)
+{
+    UBaseType_t i;
+
+    xCoapMutex = xAppSemaphoreCreateMutex(xCoapMutex);
+    if (xCoapMutex == NULL || !osCreateEvent(&xCoapEvent))
+    {
+        return pdFAIL;
+    }
+
+    /* The root of the tree */
+    memset(&xResources[0], 0, sizeof(xResources[0]));
+    xResources[0].sParent = COAP_NO_RESOURCE;
+    xResources[0].sFirstChild = COAP_NO_RESOURCE;
+    xResources[0].sNextSibling = COAP_NO_RESOURCE;
+    uxResources = 1;
+
+    for (i = 0; i < COAP_SERVER_MAX_OBSERVERS; i++)
+    {
+        xObservers[i].sResource = COAP_NO_RESOURCE;
+    }
+
+    (void) lCoapServerAddResource(".well-known/core", COAP_CONTENT_FORMAT_APP_LINK_FORMAT, pdFALSE,
+                                  prvWellKnownCore, NULL, NULL);
+
+    return xAppTaskCreate(xCoapTask,
+                          prvCoapTask,
+                          "CoAP",
+                          COAP_SERVER_TASK_STACK_SIZE,
+                          NULL,
+                          uxPriority,
+                          NULL);
+}
+
+/* Child of the node with this name, created if needed; COAP_NO_RESOURCE if
+   the table is full */
+static int16_t prvChild(int16_t sNode, const char *pcName, size_t xLength)
+{
+    CoapResource_t *pxChild;
+    int16_t sChild;
+
+    for (sChild = xResources[sNode].sFirstChild; sChild != COAP_NO_RESOURCE; sChild = xResources[sChild].sNextSibling)
+    {
+        if (strlen(xResources[sChild].cName) == xLength && memcmp(xResources[sChild].cName, pcName, xLength) == 0)
+        {
+            return sChild;
+        }
+    }
+
+    if (uxResources == COAP_SERVER_MAX_RESOURCES)
+    {
+        return COAP_NO_RESOURCE;
+    }
+
+    sChild = (int16_t) uxResources;
+    pxChild = &xResources[sChild];
+    memset(pxChild, 0, sizeof(*pxChild));
+    memcpy(pxChild->cName, pcName, xLength);
+    pxChild->sParent = sNode;
+    pxChild->sFirstChild = COAP_NO_RESOURCE;
+    pxChild->sNextSibling = xResources[sNode].sFirstChild;
+    xResources[sNode].sFirstChild = sChild;
+    uxResources++;
+
+    return sChild;
+}
+
+int32_t lCoapServerAddResource(const char *pcPath, uint16_t usContentFormat, BaseType_t xObservable,
+                               CoapGetHandler_t pxGet, CoapPutHandler_t pxPut, void *pvContext)
+{
+    CoapResource_t *pxResource;
+    const char *pcSegment = pcPath;
+    const char *pcEnd;
+    int16_t sNode = 0;
+    UBaseType_t uxDepth = 0;
+
+    if (xCoapMutex == NULL || pcPath == NULL || (pxGet == NULL && pxPut == NULL) ||
+        (xObservable != pdFALSE && pxGet == NULL))
+    {
+        return -1;
+    }
+
+    xSemaphoreTake(xCoapMutex, portMAX_DELAY);
+
+    while (*pcSegment != '\0' && sNode != COAP_NO_RESOURCE)
+    {
+        pcEnd = strchr(pcSegment, '/');
+        if (pcEnd == NULL)
+        {
+            pcEnd = pcSegment + strlen(pcSegment);
+        }
+
+        /* Empty segments, from a leading or doubled slash, are skipped */
+        if (pcEnd > pcSegment)
+        {
+            if ((size_t) (pcEnd - pcSegment) >= COAP_SERVER_SEGMENT_SIZE || ++uxDepth > COAP_SERVER_MAX_DEPTH)
+            {
+                sNode = COAP_NO_RESOURCE;
+                break;
+            }
+            sNode = prvChild(sNode, pcSegment, (size_t) (pcEnd - pcSegment));
+        }
+
+        pcSegment = (*pcEnd == '/') ? pcEnd + 1 : pcEnd;
+    }
+
+    if (sNode <= 0 || xResources[sNode].pxGet != NULL || xResources[sNode].pxPut != NULL)
+    {
+        /* Invalid, full, the root, or taken */
+        xSemaphoreGive(xCoapMutex);
+        return -1;
+    }
+
+    pxResource = &xResources[sNode];
+    pxResource->usContentFormat = usContentFormat;
+    pxResource->xObservable = xObservable;
+    pxResource->pxGet = pxGet;
+    pxResource->pxPut = pxPut;
+    pxResource->pvContext = pvContext;
+
+    xSemaphoreGive(xCoapMutex);
+
+    return sNode;
+}
+
+void vCoapServerNotify(int32_t lResource)
+{
+    if (lResource <= 0 || lResource >= COAP_SERVER_MAX_RESOURCES)
+    {
+        return;
+    }
+
+    xResources[lResource].xChanged = pdTRUE;
+    osSetEvent(&xCoapEvent);
+}
+
+void vCoapServerGetStats(CoapServerStats_t *pxStats)
+{
+    xSemaphoreTake(xCoapMutex, portMAX_DELAY);
+    *pxStats = xStats;
+    xSemaphoreGive(xCoapMutex);
+}
+
+static BaseType_t prvCoapCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    static UBaseType_t uxLine = 0;
+    static CoapServerStats_t xSnapshot;
+    char cPath[48];
+
+    (void) pcCommandString;
+
+    if (xCoapMutex == NULL)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "CoAP server not started\r\n");
+        return pdFALSE;
+    }
+
+    if (uxLine == 0)
+    {
+        vCoapServerGetStats(&xSnapshot);
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "requests %lu duplicates %lu bad %lu blocks %lu\r\n",
+                 (unsigned long) xSnapshot.ulRequests, (unsigned long) xSnapshot.ulDuplicates,
+                 (unsigned long) xSnapshot.ulBadRequests, (unsigned long) xSnapshot.ulBlocks);
+        uxLine++;
+        return pdTRUE;
+    }
+
+    if (uxLine == 1u)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "notifications non %lu con %lu retransmitted %lu batches %lu\r\n",
+                 (unsigned long) xSnapshot.ulNotifications, (unsigned long) xSnapshot.ulConfirmable,
+                 (unsigned long) xSnapshot.ulRetransmitted, (unsigned long) xSnapshot.ulBatches);
+        uxLine++;
+        return pdTRUE;
+    }
+
+    if (uxLine == 2u)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "observers added %lu removed %lu refused %lu\r\n",
+                 (unsigned long) xSnapshot.ulObserversAdded, (unsigned long) xSnapshot.ulObserversRemoved,
+                 (unsigned long) xSnapshot.ulObserversRefused);
+        uxLine++;
+        return pdTRUE;
+    }
+
+    /* One line per resource with a handler */
+    pcWriteBuffer[0] = '\0';
+    xSemaphoreTake(xCoapMutex, portMAX_DELAY);
+    for (; uxLine - 3u < uxResources; uxLine++)
+    {
+        if (xResources[uxLine - 3u].pxGet != NULL || xResources[uxLine - 3u].pxPut != NULL)
+        {
+            prvFormatPath((int16_t) (uxLine - 3u), cPath, sizeof(cPath));
+            snprintf(pcWriteBuffer, xWriteBufferLen, "%-40s ct %-4u obs %-3lu seq %lu\r\n", cPath,
+                     xResources[uxLine - 3u].usContentFormat, (unsigned long) xResources[uxLine - 3u].uxObservers,
+                     (unsigned long) (xResources[uxLine - 3u].ulObserveSeq & 0xFFFFFFu));
+            uxLine++;
+            break;
+        }
+    }
+    xSemaphoreGive(xCoapMutex);
+
+    if (uxLine - 3u < uxResources)
+    {
+        return pdTRUE;
+    }
+
+    uxLine = 0;
+    return pdFALSE;
+}
+
+void vCoapServerRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xCoap);
+}
@@ -8,236 +8,1297 @@
  *
  *  This task implements a command console which supports dual serial and telnet
  *  interfaces simultaneously.
+ *
+ *  Every transport (the serial port, each Telnet session) is an instance of
+ *  the same console engine: a line editor with history feeding the shared
+ *  FreeRTOS+CLI interpreter, whose output is collected in an output sink and
+ *  written back through the transport's write function.
+ *
+ *  The CLI mutex only covers command lookup; commands execute concurrently on
+ *  their console's task. Long-running output (monitoring, counters) is produced
+ *  by background jobs, stepped by a job runner task, so a running job never
+ *  holds up the other consoles.
  */
 
 
 #include "CommandConsoleDualTask.h"
+#include "TelnetTask.h"
+#include "SerialTask.h"
+#include "StaticAlloc.h"
+#include "RegionHeap.h"
+#include "MemTag.h"
+#include "Watchdog.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Control characters handled by the line editor */
+#define CONSOLE_CHAR_ETX	0x03	// Ctrl-C
+#define CONSOLE_CHAR_BS		0x08
+#define CONSOLE_CHAR_TAB	0x09
+#define CONSOLE_CHAR_ESC	0x1B
+#define CONSOLE_CHAR_DEL	0x7F
+
+typedef struct ConsoleEngine ConsoleEngine_t;
+
+/**
+ * Transport-specific operations of a console instance
+ */
+typedef void ( *ConsoleWriteFunction_t )( ConsoleEngine_t *pxEngine, const char *pcData, size_t xLength );
+typedef void ( *ConsoleSubmitFunction_t )( ConsoleEngine_t *pxEngine );
 
 /**
- *  Serial Interface Rx / Tx Buffers
+ * Console engine instance: line editor, history and pending command
+ */
+struct ConsoleEngine
+{
+	ConsoleWriteFunction_t pxWrite;		// Sends output to the transport
+	ConsoleSubmitFunction_t pxSubmit;	// Runs (or schedules) pcCommand
+	UBaseType_t uxContext;				// Transport-specific, e.g. Telnet session index
+	const char *pcName;					// Name shown by the "jobs" command
+	const char *pcPrompt;				// Prompt sent after a command or an empty line
+
+	char pcInput[configCOMMAND_INT_MAX_INPUT_SIZE];		// Line being edited
+	size_t uxIndex;										// Characters in pcInput
+	uint8_t ucEscapeState;								// Progress through an ESC [ x sequence
+
+	char pcHistory[COMMAND_CONSOLE_DUAL_HISTORY_DEPTH][configCOMMAND_INT_MAX_INPUT_SIZE];
+	UBaseType_t uxHistoryCount;							// Valid entries in pcHistory
+	UBaseType_t uxHistoryHead;							// Next entry to be written
+	UBaseType_t uxHistoryCursor;						// Entries back while browsing, 0 otherwise
+
+	char pcCommand[configCOMMAND_INT_MAX_INPUT_SIZE];	// Line handed to the interpreter
+	volatile BaseType_t xBusy;							// pdTRUE while pcCommand executes
+};
+
+/**
+ * Output sink: accumulates the output of a command so that it goes out in
+ * as few transport writes as possible; grows from its static buffer into
+ * the DTCM heap (the FreeRTOS heap once it is full) up to
+ * COMMAND_CONSOLE_DUAL_SINK_MAX_SIZE
+ */
+typedef struct
+{
+	char *pcBuffer;			// Current storage
+	size_t xSize;			// Capacity of pcBuffer
+	size_t xUsed;			// Bytes of pending output
+	char *pcStatic;			// Storage used when not grown
+	size_t xStaticSize;		// Capacity of pcStatic
+} ConsoleSink_t;
+
+/**
+ * Task executing commands, and the console whose command it is running
+ */
+typedef struct
+{
+	TaskHandle_t xTask;
+	ConsoleEngine_t * volatile pxEngine;
+} ConsoleExecutor_t;
+
+/**
+ * Background job slot
+ */
+typedef struct
+{
+	UBaseType_t uxId;					// Job identifier, 0 when the slot is free
+	const char *pcName;					// Name shown by the "jobs" command
+	ConsoleJobFunction_t pxFunction;	// Step function
+	ConsoleEngine_t *pxOwner;			// Console receiving the output
+	TickType_t xPeriod;					// Ticks between steps
+	TickType_t xLastRun;				// Tick count of the last step
+	BaseType_t xStarted;				// pdFALSE until the first step ran
+	volatile BaseType_t xCancel;		// Set by "kill" / Ctrl-C
+	uint32_t ulContext[( COMMAND_CONSOLE_DUAL_JOB_CONTEXT_SIZE + 3 ) / 4];	// Copy of the job context
+} ConsoleJob_t;
+
+/**
+ *  Serial Interface Rx Buffer; output goes straight to the UART
  */
 static StreamBufferHandle_t xSerialRxStreamBufferHandle = NULL; // Serial Rx Data console input
-static StreamBufferHandle_t xSerialTxStreamBufferHandle = NULL;	// Serial Tx Data console output
 
 /**
- * Telnet Interface Rx / Tx Buffers
+ * Console instances
+ */
+static ConsoleEngine_t xSerialConsole;
+static ConsoleEngine_t xTelnetConsoles[TELNET_MAX_SESSIONS];
+static ConsoleEngine_t xBatchConsole;
+
+/**
+ * Output sinks, one per task executing commands
+ */
+static char pcSerialSinkBuffer[COMMAND_CONSOLE_DUAL_SINK_SIZE];
+static char pcWorkerSinkBuffers[COMMAND_CONSOLE_DUAL_WORKER_COUNT][COMMAND_CONSOLE_DUAL_SINK_SIZE];
+static ConsoleSink_t xSerialSink;
+static ConsoleSink_t xWorkerSinks[COMMAND_CONSOLE_DUAL_WORKER_COUNT];
+
+/**
+ * Output sink of eCommandConsoleRun() and where its output goes
+ */
+static char pcBatchSinkBuffer[COMMAND_CONSOLE_DUAL_SINK_SIZE];
+static ConsoleSink_t xBatchSink;
+static ConsoleOutputFunction_t pxBatchOutput = NULL;
+static void *pvBatchContext = NULL;
+
+/**
+ * Queue of Telnet consoles with a command ready for the worker pool
  */
-static StreamBufferHandle_t xTelnetRxStreamBufferHandle = NULL;	// Telnet Rx Data console input
-static StreamBufferHandle_t xTelnetTxStreamBufferHandle = NULL; // Telnet Tx Data console output
+static QueueHandle_t xTelnetJobQueue = NULL;
 
 /**
  * Mutex for shared CLI access
  */
 static SemaphoreHandle_t xConsoleMutex = NULL;
 
-static void prvCommandConsoleSerialTask( void * pvParams )
+/**
+ * Executing tasks: the serial console followed by the Telnet workers
+ */
+static ConsoleExecutor_t xExecutors[COMMAND_CONSOLE_DUAL_WORKER_COUNT + 1];
+
+/**
+ * Background jobs, the runner task stepping them and its output sink
+ */
+static ConsoleJob_t xJobs[COMMAND_CONSOLE_DUAL_MAX_JOBS];
+static SemaphoreHandle_t xJobMutex = NULL;
+static TaskHandle_t xJobRunnerTask = NULL;
+static UBaseType_t uxNextJobId = 1;
+static char pcJobSinkBuffer[COMMAND_CONSOLE_DUAL_SINK_SIZE];
+static ConsoleSink_t xJobSink;
+
+/* Storage of the static allocation profile */
+APP_MUTEX_STORAGE( xConsoleMutex );
+APP_MUTEX_STORAGE( xJobMutex );
+APP_QUEUE_STORAGE( xTelnetJobQueue, TELNET_MAX_SESSIONS, sizeof( ConsoleEngine_t * ) );
+APP_TASK_STORAGE( xSerialTask, COMMAND_CONSOLE_DUAL_TASK_STACK_SIZE );
+APP_TASK_STORAGE( xTelnetTask, COMMAND_CONSOLE_DUAL_TASK_STACK_SIZE );
+APP_TASK_STORAGE_ARRAY( xWorkerTask, COMMAND_CONSOLE_DUAL_WORKER_COUNT, COMMAND_CONSOLE_DUAL_TASK_STACK_SIZE );
+APP_TASK_STORAGE( xJobTask, COMMAND_CONSOLE_DUAL_TASK_STACK_SIZE );
+
+
+static void prvConsoleSinkInit( ConsoleSink_t *pxSink, char *pcStatic, size_t xStaticSize )
 {
+	pxSink->pcStatic = pcStatic;
+	pxSink->xStaticSize = xStaticSize;
+	pxSink->pcBuffer = pcStatic;
+	pxSink->xSize = xStaticSize;
+	pxSink->xUsed = 0;
+
+} // prvConsoleSinkInit
+
 
-	char pcInput[configCOMMAND_INT_MAX_INPUT_SIZE];
-	char pcOutput[configCOMMAND_INT_MAX_OUTPUT_SIZE];
-	size_t uxIndex = 0;
+static void prvConsoleSinkFlush( ConsoleSink_t *pxSink, ConsoleEngine_t *pxEngine )
+{
+	if( pxSink->xUsed > 0 )
+	{
+		pxEngine->pxWrite( pxEngine, pxSink->pcBuffer, pxSink->xUsed );
+		pxSink->xUsed = 0;
+	}
+
+} // prvConsoleSinkFlush
+
+
+/**
+ * Make room for at least xMinimum more bytes: grow the sink if allowed and
+ * possible, otherwise send the pending output first
+ */
+static void prvConsoleSinkReserve( ConsoleSink_t *pxSink, ConsoleEngine_t *pxEngine, size_t xMinimum )
+{
+	size_t xNewSize;
+	char *pcNew;
+
+	if( ( pxSink->xSize - pxSink->xUsed ) >= xMinimum )
+	{
+		return;
+	}
+
+	/* Double the capacity, up to the configured limit */
+	xNewSize = pxSink->xSize * 2;
+	if( xNewSize > COMMAND_CONSOLE_DUAL_SINK_MAX_SIZE )
+	{
+		xNewSize = COMMAND_CONSOLE_DUAL_SINK_MAX_SIZE;
+	}
+
+	pcNew = NULL;
+	if( ( xNewSize - pxSink->xUsed ) >= xMinimum )
+	{
+		/* Output is only touched by the CPU: the DTCM serves it best */
+		pcNew = pvRegionHeapAlloc( eRegionHeapDtcm, xNewSize );
+		if( pcNew == NULL )
+		{
+			pcNew = pvRegionHeapAlloc( eRegionHeapD1, xNewSize );
+		}
+	}
+
+	if( pcNew != NULL )
+	{
+		memcpy( pcNew, pxSink->pcBuffer, pxSink->xUsed );
+
+		if( pxSink->pcBuffer != pxSink->pcStatic )
+		{
+			vRegionHeapFree( pxSink->pcBuffer );
+			vMemTagCredit( eMemTagCli, pxSink->xSize );
+		}
+		vMemTagCharge( eMemTagCli, xNewSize );
+
+		pxSink->pcBuffer = pcNew;
+		pxSink->xSize = xNewSize;
+	}
+	else
+	{
+		/* Limit reached or heap exhausted; only the latter is a failure */
+		if( ( xNewSize - pxSink->xUsed ) >= xMinimum )
+		{
+			vMemTagFailure( eMemTagCli );
+		}
+		prvConsoleSinkFlush( pxSink, pxEngine );
+	}
+
+} // prvConsoleSinkReserve
+
+
+/**
+ * Return the sink to its static buffer once a command has completed
+ */
+static void prvConsoleSinkRelease( ConsoleSink_t *pxSink )
+{
+	if( pxSink->pcBuffer != pxSink->pcStatic )
+	{
+		vRegionHeapFree( pxSink->pcBuffer );
+		vMemTagCredit( eMemTagCli, pxSink->xSize );
+		pxSink->pcBuffer = pxSink->pcStatic;
+		pxSink->xSize = pxSink->xStaticSize;
+	}
+
+	pxSink->xUsed = 0;
+
+} // prvConsoleSinkRelease
+
+
+static void prvConsoleWriteString( ConsoleEngine_t *pxEngine, const char *pcString )
+{
+	pxEngine->pxWrite( pxEngine, pcString, strlen( pcString ) );
+
+} // prvConsoleWriteString
+
+
+/**
+ * Return the executor slot of the calling task, NULL if it does not execute commands
+ */
+static ConsoleExecutor_t *prvConsoleCurrentExecutor( void )
+{
+	TaskHandle_t xTask = xTaskGetCurrentTaskHandle();
+	UBaseType_t i;
+
+	for( i = 0; i < ( COMMAND_CONSOLE_DUAL_WORKER_COUNT + 1 ); i++ )
+	{
+		if( xExecutors[i].xTask == xTask )
+		{
+			return &xExecutors[i];
+		}
+	}
+
+	return NULL;
+
+} // prvConsoleCurrentExecutor
+
+
+/**
+ * Call the interpreter of a command found for the pending command of a console
+ * until it has produced all of its output, collected in the sink
+ */
+static void prvConsoleRunCommand( ConsoleEngine_t *pxEngine, ConsoleSink_t *pxSink, const CLI_Command_Definition_t *pxCommand )
+{
+	ConsoleExecutor_t *pxExecutor;
 	BaseType_t xMore;
-	char c;
+	char *pcChunk;
+
+	/* Let uxCommandConsoleJobStart() know which console the command came from */
+	pxExecutor = prvConsoleCurrentExecutor();
+	if( pxExecutor != NULL )
+	{
+		pxExecutor->pxEngine = pxEngine;
+	}
+
+	/* Process all CLI output, appending each chunk to the sink */
+	do
+	{
+		prvConsoleSinkReserve( pxSink, pxEngine, configCOMMAND_INT_MAX_OUTPUT_SIZE );
+
+		pcChunk = &pxSink->pcBuffer[ pxSink->xUsed ];
+		pcChunk[0] = '\0';
+
+		xMore = pxCommand->pxCommandInterpreter( pcChunk, pxSink->xSize - pxSink->xUsed, pxEngine->pcCommand );
+
+		/* A command producing output is alive, however long it runs */
+		vWatchdogKick();
+
+		pxSink->xUsed += strlen( pcChunk );
+
+	} while( xMore != pdFALSE );
+
+	if( pxExecutor != NULL )
+	{
+		pxExecutor->pxEngine = NULL;
+	}
+
+} // prvConsoleRunCommand
+
+
+/**
+ * Run the pending command of a console and send all of its output
+ */
+static void prvConsoleExecute( ConsoleEngine_t *pxEngine, ConsoleSink_t *pxSink )
+{
+	const CLI_Command_Definition_t *pxCommand;
+	char *pcChunk;
+
+	/**
+	 * The mutex only protects the command lookup; note if taking it fails, commands are being
+	 * registered or the CLI is otherwise held for long, so return a prompt only
+	 */
+	if( xSemaphoreTake( xConsoleMutex, COMMAND_CONSOLE_DUAL_WAIT_TIME ) != pdTRUE )
+	{
+		/* Unable to get mutex, return prompt only*/
+		prvConsoleWriteString( pxEngine, pxEngine->pcPrompt );
+		return;
+	}
+
+	pcChunk = pxSink->pcBuffer;
+	pcChunk[0] = '\0';
+	pxCommand = FreeRTOS_CLILookupCommand( pxEngine->pcCommand, pcChunk, pxSink->xSize );
+
+	/* Release mutex */
+	configASSERT( xSemaphoreGive( xConsoleMutex ) ); //TODO:  handle this better....
+
+	if( pxCommand == NULL )
+	{
+		/* Unknown command or wrong parameters: the lookup left an error message */
+		pxSink->xUsed = strlen( pcChunk );
+	}
+	else
+	{
+		prvConsoleRunCommand( pxEngine, pxSink, pxCommand );
+	}
+
+	/* Send the output */
+	prvConsoleSinkFlush( pxSink, pxEngine );
+	prvConsoleSinkRelease( pxSink );
+
+} // prvConsoleExecute
+
+
+eConsoleRunResult eCommandConsoleRun(	const char *pcCommand,
+										ConsoleOutputFunction_t pxOutput,
+										void *pvContext )
+{
+	const CLI_Command_Definition_t *pxCommand;
+	BaseType_t xParametersValid = pdTRUE;
+	size_t xLength = strlen( pcCommand );
+
+	if( xLength >= sizeof( xBatchConsole.pcCommand ) )
+	{
+		return eConsoleRunBadParameters;
+	}
+	memcpy( xBatchConsole.pcCommand, pcCommand, xLength + 1 );
+
+	if( xSemaphoreTake( xConsoleMutex, COMMAND_CONSOLE_DUAL_WAIT_TIME ) != pdTRUE )
+	{
+		return eConsoleRunBusy;
+	}
+
+	pxCommand = FreeRTOS_CLIFindCommand( xBatchConsole.pcCommand, &xParametersValid );
+
+	configASSERT( xSemaphoreGive( xConsoleMutex ) );
+
+	if( pxCommand == NULL )
+	{
+		return eConsoleRunUnknownCommand;
+	}
+	if( xParametersValid == pdFALSE )
+	{
+		return eConsoleRunBadParameters;
+	}
+
+	/* prvBatchWrite() passes whatever the sink flushes on to the caller */
+	pxBatchOutput = pxOutput;
+	pvBatchContext = pvContext;
+
+	prvConsoleRunCommand( &xBatchConsole, &xBatchSink, pxCommand );
+	prvConsoleSinkFlush( &xBatchSink, &xBatchConsole );
+	prvConsoleSinkRelease( &xBatchSink );
+
+	pxBatchOutput = NULL;
+
+	return eConsoleRunOk;
+
+} // eCommandConsoleRun
+
+
+/**
+ * Request termination of the jobs owned by a console (all jobs if NULL);
+ * returns the number of jobs signalled
+ */
+static UBaseType_t prvConsoleJobCancel( ConsoleEngine_t *pxOwner, UBaseType_t uxId )
+{
+	UBaseType_t uxCount = 0;
+	UBaseType_t i;
+
+	xSemaphoreTake( xJobMutex, portMAX_DELAY );
+
+	for( i = 0; i < COMMAND_CONSOLE_DUAL_MAX_JOBS; i++ )
+	{
+		if( xJobs[i].uxId == 0 )
+		{
+			continue;
+		}
+
+		if( ( uxId != 0 && xJobs[i].uxId == uxId ) ||
+			( uxId == 0 && ( pxOwner == NULL || xJobs[i].pxOwner == pxOwner ) ) )
+		{
+			xJobs[i].xCancel = pdTRUE;
+			uxCount++;
+		}
+	}
+
+	xSemaphoreGive( xJobMutex );
+
+	/* Let the runner reap the jobs */
+	if( uxCount > 0 )
+	{
+		xTaskNotifyGive( xJobRunnerTask );
+	}
+
+	return uxCount;
+
+} // prvConsoleJobCancel
+
+
+UBaseType_t uxCommandConsoleJobStart(	const char *pcName,
+										ConsoleJobFunction_t pxFunction,
+										const void *pvContext,
+										size_t xContextLength,
+										TickType_t xPeriod )
+{
+	ConsoleExecutor_t *pxExecutor = prvConsoleCurrentExecutor();
+	ConsoleJob_t *pxJob = NULL;
+	UBaseType_t uxId = 0;
+	UBaseType_t i;
+
+	configASSERT( pxFunction );
+
+	/* Jobs can only be started by a command being executed on a console */
+	if( pxExecutor == NULL || pxExecutor->pxEngine == NULL ||
+		xContextLength > COMMAND_CONSOLE_DUAL_JOB_CONTEXT_SIZE )
+	{
+		return 0;
+	}
+
+	xSemaphoreTake( xJobMutex, portMAX_DELAY );
+
+	for( i = 0; i < COMMAND_CONSOLE_DUAL_MAX_JOBS; i++ )
+	{
+		if( xJobs[i].uxId == 0 )
+		{
+			pxJob = &xJobs[i];
+			break;
+		}
+	}
+
+	if( pxJob != NULL )
+	{
+		pxJob->pcName = pcName;
+		pxJob->pxFunction = pxFunction;
+		pxJob->pxOwner = pxExecutor->pxEngine;
+		pxJob->xPeriod = xPeriod;
+		pxJob->xStarted = pdFALSE;
+		pxJob->xCancel = pdFALSE;
+
+		if( xContextLength > 0 )
+		{
+			memcpy( pxJob->ulContext, pvContext, xContextLength );
+		}
+
+		/* Identifiers are never 0 */
+		uxId = uxNextJobId++;
+		if( uxNextJobId == 0 )
+		{
+			uxNextJobId = 1;
+		}
+		pxJob->uxId = uxId;
+	}
+
+	xSemaphoreGive( xJobMutex );
+
+	if( uxId != 0 )
+	{
+		xTaskNotifyGive( xJobRunnerTask );
+	}
+
+	return uxId;
+
+} // uxCommandConsoleJobStart
+
+
+/**
+ * Run one step of a job and send its output to the owning console
+ */
+static eConsoleJobResult prvConsoleJobStep( ConsoleJob_t *pxJob )
+{
+	eConsoleJobResult eResult;
+	char *pcChunk;
+
+	do
+	{
+		prvConsoleSinkReserve( &xJobSink, pxJob->pxOwner, configCOMMAND_INT_MAX_OUTPUT_SIZE );
+
+		pcChunk = &xJobSink.pcBuffer[ xJobSink.xUsed ];
+		pcChunk[0] = '\0';
+
+		eResult = pxJob->pxFunction( pcChunk, xJobSink.xSize - xJobSink.xUsed, pxJob->ulContext );
+
+		xJobSink.xUsed += strlen( pcChunk );
+
+	} while( eResult == eConsoleJobMore && pxJob->xCancel == pdFALSE );
+
+	prvConsoleSinkFlush( &xJobSink, pxJob->pxOwner );
+	prvConsoleSinkRelease( &xJobSink );
+
+	return eResult;
+
+} // prvConsoleJobStep
+
+
+/**
+ * Free a job slot, telling its console why the job ended
+ */
+static void prvConsoleJobFinish( ConsoleJob_t *pxJob, const char *pcReason )
+{
+	char pcLine[48];
+
+	snprintf( pcLine, sizeof( pcLine ), "\r\n[%lu] %s\r\n", ( unsigned long ) pxJob->uxId, pcReason );
+	prvConsoleWriteString( pxJob->pxOwner, pcLine );
+	prvConsoleWriteString( pxJob->pxOwner, pxJob->pxOwner->pcPrompt );
+
+	xSemaphoreTake( xJobMutex, portMAX_DELAY );
+	pxJob->uxId = 0;
+	xSemaphoreGive( xJobMutex );
+
+} // prvConsoleJobFinish
+
+
+/**
+ * Job runner: steps every job when its period elapses and sleeps until the
+ * next one is due, a job is started or a job is cancelled
+ */
+static void prvCommandConsoleJobTask( void * pvParams )
+{
+	ConsoleJob_t *pxJob;
+	TickType_t xNow;
+	TickType_t xElapsed;
+	TickType_t xWait;
+	UBaseType_t i;
 
 	(void) pvParams;
 
 	while( 1 )
 	{
-		/**
-		 * Wait for received characters via the serial port
-		 */
-		if( xStreamBufferReceive( xSerialRxStreamBufferHandle, &c, 1, portMAX_DELAY) > 0 )
+		xWait = portMAX_DELAY;
+
+		for( i = 0; i < COMMAND_CONSOLE_DUAL_MAX_JOBS; i++ )
 		{
-			#ifdef COMMAND_CONSOLE_DUAL_ECHO_ENABLE
-			/* Echo back raw character if needed; not special chars */
-			if( c != '>' && c != '\r' && c != '\n' )
+			pxJob = &xJobs[i];
+
+			if( pxJob->uxId == 0 )
 			{
-				xStreamBufferSend( xSerialTxStreamBufferHandle, &c, 1, portMAX_DELAY );
+				continue;
 			}
-			#endif
 
-			/* Check for end of command */
-			 if( ( c == '\r' ) || ( c == '\n' ) )
-			 {
-				 if( uxIndex > 0 )
-				 {
-					 // Null terminate input line
-					 pcInput[uxIndex] = '\0';
-
-					 /**
-					  * Try to take mutex to access CLI; note if this fails, it may be due to a long-running
-					  * command being executed on an alternative port, for example if a stream command is being
-					  * executed. TODO:  figure out how to block long running commands
-					  */
-					 if( xSemaphoreTake( xConsoleMutex, COMMAND_CONSOLE_DUAL_WAIT_TIME ) == pdTRUE )
-					 {
-						 /* Process and send all CLI output */
-						 do
-						 {
-							 xMore = FreeRTOS_CLIProcessCommand( pcInput,  pcOutput, configCOMMAND_INT_MAX_OUTPUT_SIZE );
-
-							 if( strlen(pcOutput) > 0 )
-							 {
-								xStreamBufferSend( xSerialTxStreamBufferHandle, pcOutput, strlen( pcOutput ), portMAX_DELAY );
-							 }
-
-						 } while( xMore != pdFALSE );
-
-						 // Reset for next line
-						 uxIndex = 0;
-
-						 /* Release mutex */
-						 configASSERT( xSemaphoreGive( xConsoleMutex ) ); //TODO:  handle this better....
-
-					 }
-					 else
-					 {
-						 /* Unable to get mutex, return prompt only*/
-						 char str[] = "\n\r>";
-						 xStreamBufferSend( xSerialTxStreamBufferHandle, str, strlen(str), portMAX_DELAY );
-					 }
-				 }
-				 else
-				 {
-					 // Received EOC without command, so return prompt only
-					if( c == '\r')
-					{
-						//Send '>'
-						char str[] = "\n\r>";
-						xStreamBufferSend( xSerialTxStreamBufferHandle, str, strlen(str), portMAX_DELAY );
-					}
-
-				 }// else
-
-			 }// if end of command
-			 else
-			 {
-				/* Store character if space remains, else reset buffer */
-				if( uxIndex < ( configCOMMAND_INT_MAX_INPUT_SIZE - 1 ) )
-				{
-					pcInput[ uxIndex++ ] = c;
-				}
-				else
+			if( pxJob->xCancel != pdFALSE )
+			{
+				prvConsoleJobFinish( pxJob, "Terminated" );
+				continue;
+			}
+
+			xNow = xTaskGetTickCount();
+			xElapsed = xNow - pxJob->xLastRun;
+
+			if( pxJob->xStarted == pdFALSE || xElapsed >= pxJob->xPeriod )
+			{
+				pxJob->xStarted = pdTRUE;
+				pxJob->xLastRun = xNow;
+				xElapsed = 0;
+
+				if( prvConsoleJobStep( pxJob ) == eConsoleJobDone )
 				{
-					uxIndex = 0;
+					prvConsoleJobFinish( pxJob, "Done" );
+					continue;
 				}
+			}
 
-			 }//else
+			/* Sleep no longer than until the next job is due */
+			if( ( pxJob->xPeriod - xElapsed ) < xWait )
+			{
+				xWait = pxJob->xPeriod - xElapsed;
+			}
+		}
 
-		}//end if char received
+		ulTaskNotifyTake( pdTRUE, xWait );
+
+	}//end while(1)
+
+} // prvCommandConsoleJobTask
+
+
+/**
+ * "jobs": list the background jobs
+ */
+static BaseType_t prvJobsCommand( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString )
+{
+	size_t xLength = 0;
+	UBaseType_t i;
+	int n;
+
+	(void) pcCommandString;
+
+	n = snprintf( pcWriteBuffer, xWriteBufferLen, "\r\nID  Name             Console   Period\r\n" );
+	xLength = ( n > 0 ) ? ( size_t ) n : 0;
+
+	xSemaphoreTake( xJobMutex, portMAX_DELAY );
+
+	for( i = 0; i < COMMAND_CONSOLE_DUAL_MAX_JOBS && xLength < xWriteBufferLen; i++ )
+	{
+		if( xJobs[i].uxId != 0 )
+		{
+			n = snprintf( &pcWriteBuffer[ xLength ], xWriteBufferLen - xLength, "%-3lu %-16s %-9s %lu ms\r\n",
+						  ( unsigned long ) xJobs[i].uxId, xJobs[i].pcName, xJobs[i].pxOwner->pcName,
+						  ( unsigned long ) ( xJobs[i].xPeriod * portTICK_PERIOD_MS ) );
+			xLength += ( n > 0 ) ? ( size_t ) n : 0;
+		}
+	}
+
+	xSemaphoreGive( xJobMutex );
+
+	return pdFALSE;
+
+} // prvJobsCommand
+
+
+/**
+ * "kill <id>": cancel a background job
+ */
+static BaseType_t prvKillCommand( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString )
+{
+	const char *pcParameter;
+	BaseType_t xParameterLength;
+	UBaseType_t uxId;
+
+	pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 1, &xParameterLength );
+	uxId = ( UBaseType_t ) strtoul( pcParameter, NULL, 10 );
+
+	if( uxId == 0 || prvConsoleJobCancel( NULL, uxId ) == 0 )
+	{
+		snprintf( pcWriteBuffer, xWriteBufferLen, "\r\nNo such job\r\n" );
+	}
+
+	return pdFALSE;
+
+} // prvKillCommand
+
+
+/**
+ * Context of a "watch" job: the command to repeat
+ */
+typedef struct
+{
+	const CLI_Command_Definition_t *pxCommand;
+	char pcCommand[configCOMMAND_INT_MAX_INPUT_SIZE];
+} ConsoleWatchContext_t;
+
+static eConsoleJobResult prvWatchJob( char *pcWriteBuffer, size_t xWriteBufferLen, void *pvContext )
+{
+	ConsoleWatchContext_t *pxWatch = ( ConsoleWatchContext_t * ) pvContext;
+
+	if( pxWatch->pxCommand->pxCommandInterpreter( pcWriteBuffer, xWriteBufferLen, pxWatch->pcCommand ) != pdFALSE )
+	{
+		return eConsoleJobMore;
+	}
+
+	return eConsoleJobWait;
+
+} // prvWatchJob
+
+
+/**
+ * "watch <ms> <command...>": run a command periodically as a background job
+ */
+static BaseType_t prvWatchCommand( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString )
+{
+	ConsoleWatchContext_t xWatch;
+	const char *pcParameter;
+	BaseType_t xParameterLength;
+	unsigned long ulPeriod;
+	UBaseType_t uxId;
+
+	pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 1, &xParameterLength );
+	ulPeriod = ( pcParameter != NULL ) ? strtoul( pcParameter, NULL, 10 ) : 0;
+	pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 2, &xParameterLength );
+
+	if( ulPeriod == 0 || pcParameter == NULL )
+	{
+		snprintf( pcWriteBuffer, xWriteBufferLen, "\r\nUsage: watch <ms> <command...>\r\n" );
+		return pdFALSE;
+	}
+
+	/* The rest of the line is the watched command */
+	strncpy( xWatch.pcCommand, pcParameter, sizeof( xWatch.pcCommand ) - 1 );
+	xWatch.pcCommand[ sizeof( xWatch.pcCommand ) - 1 ] = '\0';
+
+	xSemaphoreTake( xConsoleMutex, portMAX_DELAY );
+	xWatch.pxCommand = FreeRTOS_CLILookupCommand( xWatch.pcCommand, pcWriteBuffer, xWriteBufferLen );
+	xSemaphoreGive( xConsoleMutex );
+
+	if( xWatch.pxCommand == NULL )
+	{
+		return pdFALSE;
+	}
+
+	uxId = uxCommandConsoleJobStart( "watch", prvWatchJob, &xWatch, sizeof( xWatch ), pdMS_TO_TICKS( ulPeriod ) );
+
+	if( uxId != 0 )
+	{
+		snprintf( pcWriteBuffer, xWriteBufferLen, "\r\n[%lu] Started, Ctrl-C or kill %lu to stop\r\n",
+				  ( unsigned long ) uxId, ( unsigned long ) uxId );
+	}
+	else
+	{
+		snprintf( pcWriteBuffer, xWriteBufferLen, "\r\nNo free job slot\r\n" );
+	}
+
+	return pdFALSE;
+
+} // prvWatchCommand
+
+
+static const CLI_Command_Definition_t xJobsCommand =
+{
+	"jobs",
+	"\r\njobs:\r\n Lists the running background jobs\r\n",
+	prvJobsCommand,
+	0
+};
+
+static const CLI_Command_Definition_t xKillCommand =
+{
+	"kill",
+	"\r\nkill <id>:\r\n Terminates a background job\r\n",
+	prvKillCommand,
+	1
+};
+
+static const CLI_Command_Definition_t xWatchCommand =
+{
+	"watch",
+	"\r\nwatch <ms> <command...>:\r\n Runs a command every <ms> milliseconds as a background job\r\n",
+	prvWatchCommand,
+	-1
+};
+
+
+static void prvConsoleReset( ConsoleEngine_t *pxEngine )
+{
+	/* Jobs of the previous user of this console end with it */
+	prvConsoleJobCancel( pxEngine, 0 );
+
+	pxEngine->uxIndex = 0;
+	pxEngine->ucEscapeState = 0;
+	pxEngine->uxHistoryCount = 0;
+	pxEngine->uxHistoryHead = 0;
+	pxEngine->uxHistoryCursor = 0;
+
+} // prvConsoleReset
+
+
+static void prvConsoleInit( ConsoleEngine_t *pxEngine, const char *pcName, ConsoleWriteFunction_t pxWrite,
+							ConsoleSubmitFunction_t pxSubmit, UBaseType_t uxContext, const char *pcPrompt )
+{
+	memset( pxEngine, 0, sizeof( ConsoleEngine_t ) );
+
+	pxEngine->pcName = pcName;
+	pxEngine->pxWrite = pxWrite;
+	pxEngine->pxSubmit = pxSubmit;
+	pxEngine->uxContext = uxContext;
+	pxEngine->pcPrompt = pcPrompt;
+
+} // prvConsoleInit
+
+
+/**
+ * Record a completed line, skipping immediate repeats
+ */
+static void prvConsoleHistoryAdd( ConsoleEngine_t *pxEngine )
+{
+	UBaseType_t uxNewest;
+
+	if( pxEngine->uxHistoryCount > 0 )
+	{
+		uxNewest = ( pxEngine->uxHistoryHead + COMMAND_CONSOLE_DUAL_HISTORY_DEPTH - 1 ) % COMMAND_CONSOLE_DUAL_HISTORY_DEPTH;
+
+		if( strcmp( pxEngine->pcHistory[ uxNewest ], pxEngine->pcInput ) == 0 )
+		{
+			return;
+		}
+	}
+
+	memcpy( pxEngine->pcHistory[ pxEngine->uxHistoryHead ], pxEngine->pcInput, pxEngine->uxIndex + 1 );
+	pxEngine->uxHistoryHead = ( pxEngine->uxHistoryHead + 1 ) % COMMAND_CONSOLE_DUAL_HISTORY_DEPTH;
+
+	if( pxEngine->uxHistoryCount < COMMAND_CONSOLE_DUAL_HISTORY_DEPTH )
+	{
+		pxEngine->uxHistoryCount++;
+	}
+
+} // prvConsoleHistoryAdd
+
+
+/**
+ * Step through the history (xOlder = pdTRUE for the up arrow) and redraw the line
+ */
+static void prvConsoleHistoryRecall( ConsoleEngine_t *pxEngine, BaseType_t xOlder )
+{
+	UBaseType_t uxEntry;
+
+	if( xOlder != pdFALSE )
+	{
+		if( pxEngine->uxHistoryCursor >= pxEngine->uxHistoryCount )
+		{
+			return;
+		}
+		pxEngine->uxHistoryCursor++;
+	}
+	else
+	{
+		if( pxEngine->uxHistoryCursor == 0 )
+		{
+			return;
+		}
+		pxEngine->uxHistoryCursor--;
+	}
+
+	if( pxEngine->uxHistoryCursor > 0 )
+	{
+		uxEntry = ( pxEngine->uxHistoryHead + COMMAND_CONSOLE_DUAL_HISTORY_DEPTH - pxEngine->uxHistoryCursor ) % COMMAND_CONSOLE_DUAL_HISTORY_DEPTH;
+		pxEngine->uxIndex = strlen( pxEngine->pcHistory[ uxEntry ] );
+		memcpy( pxEngine->pcInput, pxEngine->pcHistory[ uxEntry ], pxEngine->uxIndex );
+	}
+	else
+	{
+		/* Back past the newest entry: empty line */
+		pxEngine->uxIndex = 0;
+	}
+
+	/* Clear the terminal line and redraw prompt and recalled text */
+	prvConsoleWriteString( pxEngine, "\r\x1b[K>" );
+	pxEngine->pxWrite( pxEngine, pxEngine->pcInput, pxEngine->uxIndex );
+
+} // prvConsoleHistoryRecall
+
+
+/**
+ * Tab: complete the command name being typed as far as the registered commands
+ * agree on it, or list them when they do not
+ */
+static void prvConsoleComplete( ConsoleEngine_t *pxEngine )
+{
+	const CLI_Command_Definition_t *pxCandidates[ COMMAND_CONSOLE_DUAL_COMPLETE_LIST ];
+	const CLI_Command_Definition_t *pxCommand;
+	UBaseType_t uxMatches;
+	UBaseType_t uxFirst;
+	UBaseType_t i;
+	size_t xCommon;
+	size_t xAdded;
+	char pcNote[24];
+
+	/* Only the command name is completed, not its parameters */
+	if( memchr( pxEngine->pcInput, ' ', pxEngine->uxIndex ) != NULL )
+	{
+		return;
+	}
+
+	if( xSemaphoreTake( xConsoleMutex, COMMAND_CONSOLE_DUAL_WAIT_TIME ) != pdTRUE )
+	{
+		return;
+	}
+
+	uxMatches = FreeRTOS_CLICompleteCommand( pxEngine->pcInput, pxEngine->uxIndex, &uxFirst, &xCommon );
+
+	/* Definitions are static: they stay valid once the mutex is released */
+	for( i = 0; ( i < uxMatches ) && ( i < COMMAND_CONSOLE_DUAL_COMPLETE_LIST ); i++ )
+	{
+		pxCandidates[ i ] = FreeRTOS_CLIGetCommand( uxFirst + i );
+	}
+
+	xSemaphoreGive( xConsoleMutex );
+
+	if( uxMatches == 0 )
+	{
+		prvConsoleWriteString( pxEngine, "\a" );
+		return;
+	}
+
+	pxCommand = pxCandidates[ 0 ];
+
+	if( xCommon > pxEngine->uxIndex || uxMatches == 1 )
+	{
+		/* Extend the line with what all the candidates share, and a space
+		   once the name is complete */
+		xAdded = xCommon - pxEngine->uxIndex;
+		if( ( xCommon + 1 ) >= configCOMMAND_INT_MAX_INPUT_SIZE )
+		{
+			return;
+		}
+
+		memcpy( &pxEngine->pcInput[ pxEngine->uxIndex ], &pxCommand->pcCommand[ pxEngine->uxIndex ], xAdded );
+		if( uxMatches == 1 )
+		{
+			pxEngine->pcInput[ xCommon++ ] = ' ';
+			xAdded++;
+		}
+
+		/* Written even without echo: the terminal cannot know the completion */
+		pxEngine->pxWrite( pxEngine, &pxEngine->pcInput[ pxEngine->uxIndex ], xAdded );
+		pxEngine->uxIndex = xCommon;
+		return;
+	}
+
+	/* Ambiguous and nothing to add: list the candidates, then redraw the line */
+	for( i = 0; ( i < uxMatches ) && ( i < COMMAND_CONSOLE_DUAL_COMPLETE_LIST ); i++ )
+	{
+		prvConsoleWriteString( pxEngine, ( i == 0 ) ? "\r\n" : "  " );
+		prvConsoleWriteString( pxEngine, pxCandidates[ i ]->pcCommand );
+	}
+
+	if( uxMatches > COMMAND_CONSOLE_DUAL_COMPLETE_LIST )
+	{
+		snprintf( pcNote, sizeof( pcNote ), "  (%lu more)", ( unsigned long ) ( uxMatches - COMMAND_CONSOLE_DUAL_COMPLETE_LIST ) );
+		prvConsoleWriteString( pxEngine, pcNote );
+	}
+
+	prvConsoleWriteString( pxEngine, "\r\n>" );
+	pxEngine->pxWrite( pxEngine, pxEngine->pcInput, pxEngine->uxIndex );
+
+} // prvConsoleComplete
+
+
+/**
+ * Line editing for one received character
+ */
+static void prvConsoleInputChar( ConsoleEngine_t *pxEngine, char c )
+{
+	/* Escape sequences: only the up / down arrows (ESC [ A / ESC [ B) are used */
+	if( pxEngine->ucEscapeState == 1 )
+	{
+		pxEngine->ucEscapeState = ( c == '[' ) ? 2 : 0;
+		return;
+	}
+	else if( pxEngine->ucEscapeState == 2 )
+	{
+		pxEngine->ucEscapeState = 0;
+
+		if( c == 'A' || c == 'B' )
+		{
+			prvConsoleHistoryRecall( pxEngine, ( c == 'A' ) ? pdTRUE : pdFALSE );
+		}
+		return;
+	}
+
+	/* Check for end of command */
+	if( ( c == '\r' ) || ( c == '\n' ) )
+	{
+		pxEngine->uxHistoryCursor = 0;
+
+		if( pxEngine->uxIndex > 0 )
+		{
+			// Null terminate input line
+			pxEngine->pcInput[ pxEngine->uxIndex ] = '\0';
+
+			prvConsoleHistoryAdd( pxEngine );
+
+			/* Only one command per console may be in flight */
+			if( pxEngine->xBusy == pdFALSE )
+			{
+				memcpy( pxEngine->pcCommand, pxEngine->pcInput, pxEngine->uxIndex + 1 );
+				pxEngine->xBusy = pdTRUE;
+				pxEngine->pxSubmit( pxEngine );
+			}
+			else
+			{
+				/* Previous command still running, return prompt only */
+				prvConsoleWriteString( pxEngine, pxEngine->pcPrompt );
+			}
+
+			// Reset for next line
+			pxEngine->uxIndex = 0;
+		}
+		else
+		{
+			// Received EOC without command, so return prompt only
+			if( c == '\r' )
+			{
+				prvConsoleWriteString( pxEngine, pxEngine->pcPrompt );
+			}
+		}
+
+	}// if end of command
+	else if( ( c == CONSOLE_CHAR_BS ) || ( c == CONSOLE_CHAR_DEL ) )
+	{
+		if( pxEngine->uxIndex > 0 )
+		{
+			pxEngine->uxIndex--;
+
+			#ifdef COMMAND_CONSOLE_DUAL_ECHO_ENABLE
+			/* Erase the character on the terminal */
+			prvConsoleWriteString( pxEngine, "\b \b" );
+			#endif
+		}
+	}
+	else if( c == CONSOLE_CHAR_ETX )
+	{
+		/* Ctrl-C: stop this console's background jobs and drop the line */
+		pxEngine->uxIndex = 0;
+		pxEngine->uxHistoryCursor = 0;
+
+		if( prvConsoleJobCancel( pxEngine, 0 ) == 0 )
+		{
+			prvConsoleWriteString( pxEngine, "^C" );
+			prvConsoleWriteString( pxEngine, pxEngine->pcPrompt );
+		}
+	}
+	else if( c == CONSOLE_CHAR_ESC )
+	{
+		pxEngine->ucEscapeState = 1;
+	}
+	else if( c == CONSOLE_CHAR_TAB )
+	{
+		pxEngine->uxHistoryCursor = 0;
+		prvConsoleComplete( pxEngine );
+	}
+	else if( ( unsigned char ) c >= ' ' )
+	{
+		#ifdef COMMAND_CONSOLE_DUAL_ECHO_ENABLE
+		/* Echo back raw character if needed; not special chars */
+		if( c != '>' )
+		{
+			pxEngine->pxWrite( pxEngine, &c, 1 );
+		}
+		#endif
+
+		/* Store character if space remains, else reset buffer */
+		if( pxEngine->uxIndex < ( configCOMMAND_INT_MAX_INPUT_SIZE - 1 ) )
+		{
+			pxEngine->pcInput[ pxEngine->uxIndex++ ] = c;
+		}
+		else
+		{
+			pxEngine->uxIndex = 0;
+		}
+	}
+
+	/* Other control characters (e.g. the NUL of a Telnet CR NUL) are ignored */
+
+} // prvConsoleInputChar
+
+
+static void prvConsoleInput( ConsoleEngine_t *pxEngine, const char *pcData, size_t xLength )
+{
+	size_t i;
+
+	for( i = 0; i < xLength; i++ )
+	{
+		prvConsoleInputChar( pxEngine, pcData[i] );
+	}
+
+} // prvConsoleInput
+
+
+/**
+ * Serial transport
+ */
+static void prvSerialWrite( ConsoleEngine_t *pxEngine, const char *pcData, size_t xLength )
+{
+	(void) pxEngine;
+
+	/* Sent by DMA from the sink itself when the UART DMA can reach it; the
+	   console and the job runner take turns on the transmitter */
+	vSerialTaskWrite( pcData, xLength );
+
+} // prvSerialWrite
+
+
+static void prvSerialSubmit( ConsoleEngine_t *pxEngine )
+{
+	/* The serial console runs its commands in its own task */
+	prvConsoleExecute( pxEngine, &xSerialSink );
+	pxEngine->xBusy = pdFALSE;
+
+} // prvSerialSubmit
+
+
+/**
+ * Batch transport: output goes to the callback of eCommandConsoleRun()
+ */
+static void prvBatchWrite( ConsoleEngine_t *pxEngine, const char *pcData, size_t xLength )
+{
+	(void) pxEngine;
+
+	if( pxBatchOutput != NULL )
+	{
+		pxBatchOutput( pcData, xLength, pvBatchContext );
+	}
+
+} // prvBatchWrite
+
+
+/**
+ * Telnet transport
+ */
+static void prvTelnetWrite( ConsoleEngine_t *pxEngine, const char *pcData, size_t xLength )
+{
+	xTelnetTaskWrite( pxEngine->uxContext, pcData, xLength );
+
+} // prvTelnetWrite
+
+
+static void prvTelnetSubmit( ConsoleEngine_t *pxEngine )
+{
+	/* Hand the command over to the worker pool */
+	if( xQueueSend( xTelnetJobQueue, &pxEngine, 0 ) != pdTRUE )
+	{
+		pxEngine->xBusy = pdFALSE;
+		prvConsoleWriteString( pxEngine, pxEngine->pcPrompt );
+	}
+
+} // prvTelnetSubmit
+
+
+static void prvCommandConsoleSerialTask( void * pvParams )
+{
+	uint8_t *pucData;
+	size_t xReceived;
+
+	(void) pvParams;
+
+	/* Commands entered on the serial port execute in this task */
+	xExecutors[0].xTask = xTaskGetCurrentTaskHandle();
+
+	/* A command hung, or waiting forever on the CLI, resets the board */
+	configASSERT( xWatchdogRegister( NULL, WATCHDOG_DEADLINE_MS ) == pdPASS );
+
+	while( 1 )
+	{
+		vWatchdogKick();
+
+		/**
+		 * Wait for received characters via the serial port, taking all
+		 * that are available at once, where the stream holds them
+		 */
+		xReceived = xStreamBufferReceivePeek( xSerialRxStreamBufferHandle, &pucData, pdMS_TO_TICKS( WATCHDOG_IDLE_WAIT_MS ) );
+
+		if( xReceived > 0 )
+		{
+			prvConsoleInput( &xSerialConsole, ( const char * ) pucData, xReceived );
+			( void ) xStreamBufferReceiveConsume( xSerialRxStreamBufferHandle, xReceived );
+		}
 
 	}//end while(1)
 
 } // prvCommandConsoleSerialTask
 
 
+/**
+ * Dispatcher: performs the line editing of every Telnet session and queues
+ * complete commands for the worker tasks, so one session running a command
+ * never stalls the input of the others
+ */
 static void prvCommandConsoleTelnetTask( void * pvParams )
 {
-	char pcInput[configCOMMAND_INT_MAX_INPUT_SIZE];
-	char pcOutput[configCOMMAND_INT_MAX_OUTPUT_SIZE];
-	size_t uxIndex = 0;
-	BaseType_t xMore;
-	char c;
+	StreamBufferHandle_t xStream;
+	uint32_t ulNotifiedValue;
+	UBaseType_t uxSession;
+	uint8_t *pucData;
+	size_t xReceived;
 
 	(void) pvParams;
 
+	configASSERT( xWatchdogRegister( NULL, WATCHDOG_DEADLINE_MS ) == pdPASS );
+
 	while( 1 )
 	{
+		vWatchdogKick();
 
 		/**
-		 * Wait for received characters via the serial port
+		 * Wait for the Telnet relays to signal input or a new connection
 		 */
-		if( xStreamBufferReceive( xTelnetRxStreamBufferHandle, &c, 1, portMAX_DELAY) > 0 )
+		if( xTaskNotifyWait( 0, 0xFFFFFFFFUL, &ulNotifiedValue, pdMS_TO_TICKS( WATCHDOG_IDLE_WAIT_MS ) ) != pdTRUE )
 		{
-			#ifdef COMMAND_CONSOLE_DUAL_ECHO_ENABLE
-			/* Echo back raw character if needed; not special chars */
-			if( c != '>' && c != '\r' && c != '\n' )
+			continue;
+		}
+
+		for( uxSession = 0; uxSession < TELNET_MAX_SESSIONS; uxSession++ )
+		{
+			/* A new client starts with an empty line and no history */
+			if( ( ulNotifiedValue & TELNET_NOTIFY_OPEN( uxSession ) ) != 0 )
 			{
-				xStreamBufferSend( xTelnetTxStreamBufferHandle, &c, 1, portMAX_DELAY );
+				prvConsoleReset( &xTelnetConsoles[ uxSession ] );
 			}
-			#endif
 
-			/* Check for end of command */
-			 if( ( c == '\r' ) || ( c == '\n' ) )
-			 {
-				 if( uxIndex > 0 )
-				 {
-					 // Null terminate input line
-					 pcInput[uxIndex] = '\0';
-
-					 /**
-					  * Try to take mutex to access CLI; note if this fails, it may be due to a long-running
-					  * command being executed on an alternative port, for example if a stream command is being
-					  * executed. TODO:  figure out how to block long running commands
-					  */
-					 if( xSemaphoreTake( xConsoleMutex, COMMAND_CONSOLE_DUAL_WAIT_TIME ) == pdTRUE )
-					 {
-						 /* Process and send all CLI output */
-						 do
-						 {
-							 xMore = FreeRTOS_CLIProcessCommand( pcInput,  pcOutput, configCOMMAND_INT_MAX_OUTPUT_SIZE );
-
-							 if( strlen(pcOutput) > 0 )
-							 {
-								xStreamBufferSend( xTelnetTxStreamBufferHandle, pcOutput, strlen( pcOutput ), portMAX_DELAY );
-							 }
-
-						 } while( xMore != pdFALSE );
-
-						 // Reset for next line
-						 uxIndex = 0;
-
-						 /* Release mutex */
-						 configASSERT( xSemaphoreGive( xConsoleMutex ) ); //TODO:  handle this better....
-
-					 }
-					 else
-					 {
-						 /* Unable to get mutex, return prompt only*/
-						 char str[] = "\r>";
-						 xStreamBufferSend( xTelnetTxStreamBufferHandle, str, strlen(str), portMAX_DELAY );
-					 }
-				 }
-				 else
-				 {
-					 // Received EOC without command, so return prompt only
-					if( c == '\r' )
-					{
-						//Send '>'
-						char str[] = "\r>"; //no newline for telnet
-						xStreamBufferSend( xTelnetTxStreamBufferHandle, str, strlen(str), portMAX_DELAY );
-					}
-
-				 }
-
-			 }// if end of command
-			 else
-			 {
-				/* Store character if space remains, else reset buffer */
-				if( uxIndex < ( configCOMMAND_INT_MAX_INPUT_SIZE - 1 ) )
-				{
-					pcInput[ uxIndex++ ] = c;
-				}
-				else
+			if( ( ulNotifiedValue & TELNET_NOTIFY_RX( uxSession ) ) != 0 )
+			{
+				/* Consume everything received on this session, in place */
+				xStream = xTelnetTaskGetRxStreamHandle( uxSession );
+				while( ( xReceived = xStreamBufferReceivePeek( xStream, &pucData, 0 ) ) > 0 )
 				{
-					uxIndex = 0;
+					prvConsoleInput( &xTelnetConsoles[ uxSession ], ( const char * ) pucData, xReceived );
+					( void ) xStreamBufferReceiveConsume( xStream, xReceived );
 				}
+			}
+		}
 
-			 }
+	}//end while(1)
 
-		}//end if char received
+} // prvCommandConsoleTelnetTask
+
+
+/**
+ * Worker: executes queued Telnet commands and writes the output back to the
+ * session that issued them
+ */
+static void prvCommandConsoleTelnetWorkerTask( void * pvParams )
+{
+	ConsoleSink_t *pxSink = &xWorkerSinks[ ( UBaseType_t ) pvParams ];
+	ConsoleEngine_t *pxEngine;
+
+	xExecutors[ ( UBaseType_t ) pvParams + 1 ].xTask = xTaskGetCurrentTaskHandle();
+
+	while( 1 )
+	{
+		if( xQueueReceive( xTelnetJobQueue, &pxEngine, portMAX_DELAY ) == pdTRUE )
+		{
+			prvConsoleExecute( pxEngine, pxSink );
+
+			/* Session may accept its next command */
+			pxEngine->xBusy = pdFALSE;
+		}
 
 	}//end while(1)
 
-} // prvCommandConsoleTelnetTask
+} // prvCommandConsoleTelnetWorkerTask
 
-void vCommandConsoleDualInit(	StreamBufferHandle_t xSerialRxStream,
-								StreamBufferHandle_t xSerialTxStream,
-								StreamBufferHandle_t xTelnetRxStream,
-								StreamBufferHandle_t xTelnetTxStream )
+void vCommandConsoleDualInit(	StreamBufferHandle_t xSerialRxStream )
 {
 
+	static char pcTelnetNames[TELNET_MAX_SESSIONS][8];
 	BaseType_t ret;
+	TaskHandle_t xDispatcher;
+	UBaseType_t i;
 
 	/**
 	 * Confirm buffers are valid
@@ -245,30 +1306,74 @@ void vCommandConsoleDualInit(	StreamBufferHandle_t xSerialRxStream,
 	xSerialRxStreamBufferHandle = xSerialRxStream;
 	configASSERT( xSerialRxStreamBufferHandle );
 
-	xSerialTxStreamBufferHandle = xSerialTxStream;
-	configASSERT( xSerialTxStreamBufferHandle );
+	for( i = 0; i < TELNET_MAX_SESSIONS; i++ )
+	{
+		configASSERT( xTelnetTaskGetRxStreamHandle( i ) );
+	}
+
+	/**
+	 * Initialize console instances and output sinks
+	 */
+	prvConsoleInit( &xSerialConsole, "serial", prvSerialWrite, prvSerialSubmit, 0, "\n\r>" );
+	prvConsoleSinkInit( &xSerialSink, pcSerialSinkBuffer, sizeof( pcSerialSinkBuffer ) );
+
+	for( i = 0; i < TELNET_MAX_SESSIONS; i++ )
+	{
+		snprintf( pcTelnetNames[i], sizeof( pcTelnetNames[i] ), "telnet%lu", ( unsigned long ) i );
+		prvConsoleInit( &xTelnetConsoles[i], pcTelnetNames[i], prvTelnetWrite, prvTelnetSubmit, i, "\r>" ); //no newline for telnet
+	}
+
+	for( i = 0; i < COMMAND_CONSOLE_DUAL_WORKER_COUNT; i++ )
+	{
+		prvConsoleSinkInit( &xWorkerSinks[i], pcWorkerSinkBuffers[i], sizeof( pcWorkerSinkBuffers[i] ) );
+	}
 
-	xTelnetRxStreamBufferHandle = xTelnetRxStream;
-	configASSERT( xTelnetRxStreamBufferHandle );
+	prvConsoleSinkInit( &xJobSink, pcJobSinkBuffer, sizeof( pcJobSinkBuffer ) );
 
-	xTelnetTxStreamBufferHandle = xTelnetTxStream;
-	configASSERT( xTelnetTxStreamBufferHandle );
+	/* Commands run by eCommandConsoleRun(); never submitted from a line */
+	prvConsoleInit( &xBatchConsole, "batch", prvBatchWrite, NULL, 0, "" );
+	prvConsoleSinkInit( &xBatchSink, pcBatchSinkBuffer, sizeof( pcBatchSinkBuffer ) );
 
 	/**
-	 * Initialize mutex
+	 * Initialize mutex and Telnet job queue
 	 */
-	xConsoleMutex = xSemaphoreCreateMutex();
+	xConsoleMutex = xAppSemaphoreCreateMutex( xConsoleMutex );
 	configASSERT( xConsoleMutex );
 
+	xTelnetJobQueue = xAppQueueCreate( xTelnetJobQueue, TELNET_MAX_SESSIONS, sizeof( ConsoleEngine_t * ) );
+	configASSERT( xTelnetJobQueue );
+
+	xJobMutex = xAppSemaphoreCreateMutex( xJobMutex );
+	configASSERT( xJobMutex );
+
 	/**
 	 * Start tasks...
 	 */
-	ret = xTaskCreate( prvCommandConsoleSerialTask, "CmdDualSerial", COMMAND_CONSOLE_DUAL_TASK_STACK_SIZE, NULL, COMMAND_CONSOLE_DUAL_TASK_PRIO, NULL );
+	ret = xAppTaskCreate( xSerialTask, prvCommandConsoleSerialTask, "CmdDualSerial", COMMAND_CONSOLE_DUAL_TASK_STACK_SIZE, NULL, COMMAND_CONSOLE_DUAL_TASK_PRIO, NULL );
 	configASSERT( ret == pdPASS );
 
-	ret = xTaskCreate( prvCommandConsoleTelnetTask, "CmdDualTelnet", COMMAND_CONSOLE_DUAL_TASK_STACK_SIZE, NULL, COMMAND_CONSOLE_DUAL_TASK_PRIO, NULL );
+	ret = xAppTaskCreate( xTelnetTask, prvCommandConsoleTelnetTask, "CmdDualTelnet", COMMAND_CONSOLE_DUAL_TASK_STACK_SIZE, NULL, COMMAND_CONSOLE_DUAL_TASK_PRIO, &xDispatcher );
 	configASSERT( ret == pdPASS );
 
+	/* Telnet relays notify the dispatcher when input arrives */
+	vTelnetTaskSetConsoleTask( xDispatcher );
+
+	for( i = 0; i < COMMAND_CONSOLE_DUAL_WORKER_COUNT; i++ )
+	{
+		ret = xAppTaskCreateAt( xWorkerTask, i, prvCommandConsoleTelnetWorkerTask, "CmdDualWorker", COMMAND_CONSOLE_DUAL_TASK_STACK_SIZE, ( void * ) i, COMMAND_CONSOLE_DUAL_TASK_PRIO, NULL );
+		configASSERT( ret == pdPASS );
+	}
+
+	ret = xAppTaskCreate( xJobTask, prvCommandConsoleJobTask, "CmdDualJobs", COMMAND_CONSOLE_DUAL_TASK_STACK_SIZE, NULL, COMMAND_CONSOLE_DUAL_TASK_PRIO, &xJobRunnerTask );
+	configASSERT( ret == pdPASS );
+
+	/**
+	 * Register the job control commands
+	 */
+	FreeRTOS_CLIRegisterCommand( &xJobsCommand );
+	FreeRTOS_CLIRegisterCommand( &xKillCommand );
+	FreeRTOS_CLIRegisterCommand( &xWatchCommand );
+
 } // vCommandConsoleDualTask
 
 
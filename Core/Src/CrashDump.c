@@ -0,0 +1,508 @@
+/* CrashDump.c
+ *
+ * Crash dumps in the backup SRAM (see CrashDump.h). The fault handlers are
+ * defined here rather than in stm32h7xx_it.c: they enter through a naked
+ * stub that passes the stack the exception frame was pushed on, before the
+ * compiler pushes anything of its own.
+ *
+ * The crash path takes no lock and calls nothing that may block or
+ * assert: a second crash while a dump is written goes straight to the
+ * reset.
+ */
+#include "CrashDump.h"
+#include "stm32h7xx_hal.h"
+#include "FreeRTOS_CLI.h"
+#include "MonoClock.h"
+#include "NetStatsExport.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Backup SRAM of the backup domain, see the linker scripts */
+#define CRASH_DUMP_SECTION             ".bkp_sram"
+
+/* Basic exception frame, r0-r3, r12, lr, pc, xpsr */
+#define CRASH_DUMP_FRAME_SIZE          (8u * sizeof(uint32_t))
+
+static CrashDump_t xDump __attribute__((section(CRASH_DUMP_SECTION), aligned(32)));
+
+/* RCC reset flags of the last reset, read at start */
+static uint32_t ulResetFlags = 0;
+
+static volatile uint32_t ulCrashing = 0;
+
+static UBaseType_t uxCrashLine = 0;
+
+void vCrashDumpFault(const uint32_t *pulFrame, uint32_t ulExcReturn);
+static BaseType_t prvCrashCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xCrash =
+{
+    "crash",
+    "\r\ncrash [clear]:\r\n Dump of the last crash, kept in the backup SRAM across the reset\r\n",
+    prvCrashCommand,
+    -1
+};
+
+static void prvEnableBackupSram(void)
+{
+    HAL_PWR_EnableBkUpAccess();
+    __HAL_RCC_BKPRAM_CLK_ENABLE();
+}
+
+static uint32_t prvCheck(const CrashDump_t *pxDump)
+{
+    const uint32_t *pulWords = (const uint32_t *) pxDump;
+    uint32_t ulSum = 0;
+    uint32_t i;
+
+    for (i = 2; i < sizeof(*pxDump) / sizeof(uint32_t); i++)
+    {
+        ulSum += pulWords[i];
+    }
+
+    return ~ulSum;
+}
+
+static BaseType_t prvInRam(uint32_t ulAddress, uint32_t ulSize)
+{
+    static const uint32_t ulRanges[][2] =
+    {
+        { 0x20000000u, 0x20020000u },   /* DTCM */
+        { 0x24000000u, 0x24050000u },   /* AXI SRAM */
+        { 0x30000000u, 0x30008000u },   /* SRAM1, SRAM2 */
+        { 0x38000000u, 0x38004000u },   /* SRAM4 */
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(ulRanges) / sizeof(ulRanges[0]); i++)
+    {
+        if (ulAddress >= ulRanges[i][0] && ulAddress <= ulRanges[i][1] - ulSize)
+        {
+            return pdTRUE;
+        }
+    }
+
+    return pdFALSE;
+}
+
+/* Common part of every dump, the crash count carried over */
+static void prvBegin(uint32_t ulReason)
+{
+    uint32_t ulCount = (xDump.ulMagic == CRASH_DUMP_MAGIC || xDump.ulMagic == ~CRASH_DUMP_MAGIC) ? xDump.ulCrashCount : 0;
+    const char *pcTask;
+
+    prvEnableBackupSram();
+
+    memset(&xDump, 0, sizeof(xDump));
+    xDump.ulSize = sizeof(xDump);
+    xDump.ulCrashCount = ulCount + 1u;
+    xDump.ulReason = ulReason;
+    xDump.ulException = __get_IPSR() & 0x1FFu;
+    xDump.ulUptimeMs = (uint32_t) (ullMonoClockNowUs() / 1000u);
+    xDump.ulCycles = DWT->CYCCNT;
+    xDump.ulCfsr = SCB->CFSR;
+    xDump.ulHfsr = SCB->HFSR;
+    xDump.ulMmfar = SCB->MMFAR;
+    xDump.ulBfar = SCB->BFAR;
+    xDump.ulAfsr = SCB->AFSR;
+
+    if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED)
+    {
+        pcTask = pcTaskGetName(NULL);
+        if (pcTask != NULL && prvInRam((uint32_t) pcTask, sizeof(xDump.cTask)) == pdTRUE)
+        {
+            memcpy(xDump.cTask, pcTask, sizeof(xDump.cTask) - 1u);
+        }
+    }
+
+    xDump.ulTraceCount = uxTraceRecorderLatest(xDump.xTrace, CRASH_DUMP_TRACE_EVENTS);
+    vNetStatsSnapshot(&xDump.xNet);
+}
+
+/* Seal the dump, write it back from the D-cache, then reset */
+__attribute__((noreturn)) static void prvCommit(void)
+{
+    xDump.ulCheck = prvCheck(&xDump);
+    xDump.ulMagic = CRASH_DUMP_MAGIC;
+
+    SCB_CleanDCache_by_Addr((uint32_t *) &xDump, (int32_t) sizeof(xDump));
+
+    if ((CoreDebug->DHCSR & CoreDebug_DHCSR_C_DEBUGEN_Msk) != 0)
+    {
+        __BKPT(0);
+    }
+
+    NVIC_SystemReset();
+}
+
+/* A crash in the crash path: the first dump, partial, is dropped */
+static void prvEnter(void)
+{
+    __disable_irq();
+
+    if (ulCrashing != 0)
+    {
+        NVIC_SystemReset();
+    }
+    ulCrashing = 1;
+}
+
+/* Registers stacked on exception entry, and the stack pointer before it */
+static void prvCopyFrame(const uint32_t *pulFrame, uint32_t ulExcReturn)
+{
+    uint32_t ulFrame = (uint32_t) pulFrame;
+
+    xDump.ulExcReturn = ulExcReturn;
+
+    /* The frame may not have been pushed, on a stack overflow */
+    if (prvInRam(ulFrame, CRASH_DUMP_FRAME_SIZE) == pdTRUE)
+    {
+        xDump.ulR0 = pulFrame[0];
+        xDump.ulR1 = pulFrame[1];
+        xDump.ulR2 = pulFrame[2];
+        xDump.ulR3 = pulFrame[3];
+        xDump.ulR12 = pulFrame[4];
+        xDump.ulLr = pulFrame[5];
+        xDump.ulPc = pulFrame[6];
+        xDump.ulPsr = pulFrame[7];
+
+        /* Basic or extended frame, plus the alignment word */
+        ulFrame += ((ulExcReturn & 0x10u) != 0) ? 0x20u : 0x68u;
+        if ((xDump.ulPsr & (1u << 9)) != 0)
+        {
+            ulFrame += 4u;
+        }
+    }
+    xDump.ulSp = ulFrame;
+}
+
+void vCrashDumpAssert(const char *pcFile, uint32_t ulLine)
+{
+    uint32_t ulCaller = (uint32_t) __builtin_return_address(0);
+    size_t xLength = strlen(pcFile);
+
+    prvEnter();
+    prvBegin(CRASH_REASON_ASSERT);
+
+    xDump.ulPc = ulCaller;
+    xDump.ulSp = __get_MSP();
+    if (xDump.ulException == 0 && (__get_CONTROL() & CONTROL_SPSEL_Msk) != 0)
+    {
+        xDump.ulSp = __get_PSP();
+    }
+    xDump.ulAssertLine = ulLine;
+    if (xLength >= sizeof(xDump.cAssertFile))
+    {
+        pcFile += xLength - (sizeof(xDump.cAssertFile) - 1u);
+    }
+    strncpy(xDump.cAssertFile, pcFile, sizeof(xDump.cAssertFile) - 1u);
+
+    prvCommit();
+}
+
+/* Checked when a task is switched out (configCHECK_FOR_STACK_OVERFLOW) */
+void vApplicationStackOverflowHook(TaskHandle_t xTask, char *pcTaskName)
+{
+    (void) xTask;
+
+    prvEnter();
+    prvBegin(CRASH_REASON_STACK_OVERFLOW);
+
+    /* The switched out task, not the one the scheduler runs on behalf of */
+    memset(xDump.cTask, 0, sizeof(xDump.cTask));
+    if (prvInRam((uint32_t) pcTaskName, sizeof(xDump.cTask)) == pdTRUE)
+    {
+        memcpy(xDump.cTask, pcTaskName, sizeof(xDump.cTask) - 1u);
+    }
+    xDump.ulPc = (uint32_t) __builtin_return_address(0);
+    xDump.ulSp = __get_PSP();
+
+    prvCommit();
+}
+
+void vCrashDumpTaskStall(TaskHandle_t xTask, uint32_t ulOverdueMs)
+{
+    /* The saved stack pointer is the first member of the TCB */
+    const uint32_t *pulSaved = *(const uint32_t * const *) xTask;
+    const char *pcName = pcTaskGetName(xTask);
+    uint32_t ulExcReturn;
+
+    prvEnter();
+    prvBegin(CRASH_REASON_WATCHDOG);
+
+    memset(xDump.cTask, 0, sizeof(xDump.cTask));
+    if (prvInRam((uint32_t) pcName, sizeof(xDump.cTask)) == pdTRUE)
+    {
+        memcpy(xDump.cTask, pcName, sizeof(xDump.cTask) - 1u);
+    }
+    xDump.ulAssertLine = ulOverdueMs;
+
+    /* The port saves r4-r11 and EXC_RETURN, and s16-s31 for a task that
+     * used the FPU, below the frame pushed by the exception */
+    if (prvInRam((uint32_t) pulSaved, 9u * sizeof(uint32_t)) == pdTRUE)
+    {
+        ulExcReturn = pulSaved[8];
+        prvCopyFrame(pulSaved + 9u + (((ulExcReturn & 0x10u) == 0) ? 16u : 0u), ulExcReturn);
+    }
+
+    prvCommit();
+}
+
+/* Called by the stub with the stack of the exception frame and EXC_RETURN */
+void vCrashDumpFault(const uint32_t *pulFrame, uint32_t ulExcReturn)
+{
+    prvEnter();
+    prvBegin(CRASH_REASON_FAULT);
+
+    prvCopyFrame(pulFrame, ulExcReturn);
+
+    prvCommit();
+}
+
+/* Stack of the frame from bit 2 of EXC_RETURN, then the C handler */
+__attribute__((naked)) static void prvFaultEntry(void)
+{
+    __asm volatile
+    (
+        "   tst lr, #4              \n"
+        "   ite eq                  \n"
+        "   mrseq r0, msp           \n"
+        "   mrsne r0, psp           \n"
+        "   mov r1, lr              \n"
+        "   b vCrashDumpFault       \n"
+    );
+}
+
+void NMI_Handler(void) __attribute__((alias("prvFaultEntry")));
+void HardFault_Handler(void) __attribute__((alias("prvFaultEntry")));
+void MemManage_Handler(void) __attribute__((alias("prvFaultEntry")));
+void BusFault_Handler(void) __attribute__((alias("prvFaultEntry")));
+void UsageFault_Handler(void) __attribute__((alias("prvFaultEntry")));
+
+void vCrashDumpInit(void)
+{
+    prvEnableBackupSram();
+
+    /* Keeps the backup SRAM on VBAT; the dump survives a reset without it */
+    (void) HAL_PWREx_EnableBkUpReg();
+
+    ulResetFlags = RCC->RSR;
+    __HAL_RCC_CLEAR_RESET_FLAGS();
+
+    /* Memory, bus and usage faults report themselves rather than escalating
+     * to a hard fault */
+    SCB->SHCSR |= SCB_SHCSR_MEMFAULTENA_Msk | SCB_SHCSR_BUSFAULTENA_Msk | SCB_SHCSR_USGFAULTENA_Msk;
+}
+
+const CrashDump_t *pxCrashDumpGet(void)
+{
+    if (xDump.ulMagic != CRASH_DUMP_MAGIC || xDump.ulSize != sizeof(xDump) || xDump.ulCheck != prvCheck(&xDump))
+    {
+        return NULL;
+    }
+
+    return &xDump;
+}
+
+/* The crash count is kept for the next dump */
+void vCrashDumpClear(void)
+{
+    if (xDump.ulMagic == CRASH_DUMP_MAGIC)
+    {
+        xDump.ulMagic = ~CRASH_DUMP_MAGIC;
+    }
+    SCB_CleanDCache_by_Addr((uint32_t *) &xDump, (int32_t) sizeof(xDump));
+}
+
+/*
+ * UDP
+ */
+
+/* Reactor worker context: the request is read without waiting */
+static void prvDumpReadable(Socket *pxSocket, void *pvParam)
+{
+    char cRequest[8];
+    IpAddr xAddr;
+    uint16_t usPort;
+    size_t xReceived;
+
+    (void) pvParam;
+
+    while (socketReceiveFrom(pxSocket, &xAddr, &usPort, cRequest, sizeof(cRequest), &xReceived, 0) == NO_ERROR)
+    {
+        if (xReceived == 5 && memcmp(cRequest, "clear", 5) == 0)
+        {
+            vCrashDumpClear();
+        }
+
+        (void) socketSendTo(pxSocket, &xAddr, usPort, &xDump, sizeof(xDump), NULL, 0);
+    }
+}
+
+static const SocketReactorHandlers xDumpHandlers =
+{
+    NULL,
+    prvDumpReadable,
+    NULL,
+    NULL
+};
+
+BaseType_t xCrashDumpListen(SocketReactorContext *pxReactor)
+{
+    Socket *pxSocket;
+
+    pxSocket = socketOpen(SOCKET_TYPE_DGRAM, SOCKET_IP_PROTO_UDP);
+    if (pxSocket == NULL)
+    {
+        return pdFAIL;
+    }
+
+    /* The handler never waits on the socket */
+    socketSetTimeout(pxSocket, 0);
+
+    if (socketBind(pxSocket, &IP_ADDR_ANY, CRASH_DUMP_PORT) != NO_ERROR ||
+        socketReactorAdd(pxReactor, pxSocket, &xDumpHandlers, NULL) != NO_ERROR)
+    {
+        socketClose(pxSocket);
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+
+/*
+ * CLI
+ */
+
+void vCrashDumpRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xCrash);
+}
+
+static const char *prvReasonName(const CrashDump_t *pxDump)
+{
+    static const char * const pcFaults[] = { "nmi", "hard fault", "memory fault", "bus fault", "usage fault" };
+
+    switch (pxDump->ulReason)
+    {
+    case CRASH_REASON_ASSERT:
+        return "assert";
+    case CRASH_REASON_STACK_OVERFLOW:
+        return "stack overflow";
+    case CRASH_REASON_WATCHDOG:
+        return "watchdog";
+    default:
+        if (pxDump->ulException >= 2u && pxDump->ulException <= 6u)
+        {
+            return pcFaults[pxDump->ulException - 2u];
+        }
+        return "fault";
+    }
+}
+
+static BaseType_t prvCrashCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    const CrashDump_t *pxDump = pxCrashDumpGet();
+    const TraceEvent_t *pxEvent;
+    const char *pcParameter;
+    BaseType_t xParameterLength;
+    UBaseType_t uxLine = uxCrashLine++;
+    UBaseType_t uxNetLines = uxNetStatsLineCount();
+
+    if (uxLine == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterLength);
+        if (pcParameter != NULL && xParameterLength == 5 && strncmp(pcParameter, "clear", 5) == 0)
+        {
+            vCrashDumpClear();
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Crash dump cleared\r\n");
+            uxCrashLine = 0;
+            return pdFALSE;
+        }
+
+        snprintf(pcWriteBuffer, xWriteBufferLen, "reset flags 0x%08lx%s\r\n", (unsigned long) ulResetFlags,
+                 (pxDump == NULL) ? ", no crash dump" : "");
+        if (pxDump == NULL)
+        {
+            uxCrashLine = 0;
+            return pdFALSE;
+        }
+        return pdTRUE;
+    }
+
+    if (pxDump == NULL)
+    {
+        pcWriteBuffer[0] = '\0';
+        uxCrashLine = 0;
+        return pdFALSE;
+    }
+
+    switch (uxLine)
+    {
+    case 1:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "crash %lu: %s, task \"%s\", uptime %lu ms, cycles %lu\r\n",
+                 (unsigned long) pxDump->ulCrashCount, prvReasonName(pxDump), pxDump->cTask,
+                 (unsigned long) pxDump->ulUptimeMs, (unsigned long) pxDump->ulCycles);
+        break;
+    case 2:
+        if (pxDump->ulReason == CRASH_REASON_ASSERT)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "assert %s:%lu, exception %lu\r\n", pxDump->cAssertFile,
+                     (unsigned long) pxDump->ulAssertLine, (unsigned long) pxDump->ulException);
+        }
+        else if (pxDump->ulReason == CRASH_REASON_WATCHDOG)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "overdue %lu ms, exc_return 0x%08lx\r\n",
+                     (unsigned long) pxDump->ulAssertLine, (unsigned long) pxDump->ulExcReturn);
+        }
+        else
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "exception %lu, exc_return 0x%08lx\r\n",
+                     (unsigned long) pxDump->ulException, (unsigned long) pxDump->ulExcReturn);
+        }
+        break;
+    case 3:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "pc 0x%08lx  lr 0x%08lx  sp 0x%08lx  psr 0x%08lx\r\n",
+                 (unsigned long) pxDump->ulPc, (unsigned long) pxDump->ulLr,
+                 (unsigned long) pxDump->ulSp, (unsigned long) pxDump->ulPsr);
+        break;
+    case 4:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "r0 0x%08lx  r1 0x%08lx  r2 0x%08lx  r3 0x%08lx  r12 0x%08lx\r\n",
+                 (unsigned long) pxDump->ulR0, (unsigned long) pxDump->ulR1, (unsigned long) pxDump->ulR2,
+                 (unsigned long) pxDump->ulR3, (unsigned long) pxDump->ulR12);
+        break;
+    case 5:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "cfsr 0x%08lx  hfsr 0x%08lx  mmfar 0x%08lx  bfar 0x%08lx\r\n",
+                 (unsigned long) pxDump->ulCfsr, (unsigned long) pxDump->ulHfsr,
+                 (unsigned long) pxDump->ulMmfar, (unsigned long) pxDump->ulBfar);
+        break;
+    default:
+        /* Network counters as the "netstat" report, then the trace events */
+        if (uxLine < 6u + uxNetLines)
+        {
+            (void) xNetStatsFormatLine(&pxDump->xNet, uxLine - 6u, pcWriteBuffer, xWriteBufferLen);
+        }
+        else if (uxLine == 6u + uxNetLines)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "%lu trace events, oldest first:\r\n",
+                     (unsigned long) pxDump->ulTraceCount);
+        }
+        else
+        {
+            pxEvent = &pxDump->xTrace[uxLine - 7u - uxNetLines];
+            snprintf(pcWriteBuffer, xWriteBufferLen, "  %10lu  type %3u  id %3u  arg %5u  0x%08lx\r\n",
+                     (unsigned long) pxEvent->ulCycles, (unsigned) pxEvent->ucType, (unsigned) pxEvent->ucId,
+                     (unsigned) pxEvent->usArg, (unsigned long) pxEvent->ulObject);
+        }
+        break;
+    }
+
+    if (uxLine + 1u >= 7u + uxNetLines + pxDump->ulTraceCount ||
+        uxLine + 1u >= 7u + uxNetLines + CRASH_DUMP_TRACE_EVENTS)
+    {
+        uxCrashLine = 0;
+        return pdFALSE;
+    }
+
+    return pdTRUE;
+}
@@ -0,0 +1,155 @@
+/* CyphalCrc.c
+ *
+ * Cyphal/UDP transfer CRCs on the CRC peripheral.
+ *
+ * libudpard runs a CRC-32C over the whole payload of every transfer, once
+ * when it is queued and once per datagram received. Its slice-by-8 code
+ * handles short blocks; longer ones are handed over here. The peripheral
+ * takes a programmable polynomial, so it is set up for CRC-32C with the
+ * input bytes and the output reflected, and seeded with the running CRC of
+ * libudpard (bit reversed, as the peripheral register is not reflected) so
+ * that a transfer split over several datagrams chains across calls.
+ *
+ * The data is fed by the CPU, a word per write, rather than by DMA: the
+ * received datagrams and the TX items live in the DTCM, which only the MDMA
+ * reaches, and every call site waits for the result anyway, so a transfer
+ * would only add its setup to the same bus time.
+ *
+ * At start the peripheral is checked against a bitwise reference over all
+ * alignments and a range of lengths; if it disagrees, libudpard keeps the
+ * software implementation.
+ */
+#include "CyphalCrc.h"
+#include "TcmPlacement.h"
+#include "stm32h7xx_hal.h"
+#include <string.h>
+
+/* CRC-32C (Castagnoli), as used by Cyphal/UDP */
+#define CYPHAL_CRC_POLYNOMIAL          0x1EDC6F41u
+#define CYPHAL_CRC_REFLECTED           0x82F63B78u
+#define CYPHAL_CRC_INITIAL             0xFFFFFFFFu
+#define CYPHAL_CRC_CHECK               0xE3069283u     /* Of "123456789" */
+
+/* Self-test pattern, long enough for every alignment of the longest block */
+#define CYPHAL_CRC_TEST_MAX_SIZE       (CYPHAL_CRC_HW_MIN_SIZE + 16)
+
+static CyphalCrcStats_t xStats;
+
+static uint32_t prvReferenceAdd(uint32_t ulCrc, size_t xSize, const uint8_t *pucData)
+{
+    size_t i;
+    int iBit;
+
+    for (i = 0; i < xSize; i++)
+    {
+        ulCrc ^= pucData[i];
+        for (iBit = 0; iBit < 8; iBit++)
+        {
+            ulCrc = (ulCrc >> 1) ^ ((ulCrc & 1u) ? CYPHAL_CRC_REFLECTED : 0u);
+        }
+    }
+
+    return ulCrc;
+}
+
+TCM_CODE static uint32_t prvHardwareAdd(uint32_t ulCrc, size_t xSize, const uint8_t *pucData)
+{
+    uint32_t ulWord;
+
+    /* 32-bit polynomial, input reflected byte by byte, output reflected */
+    CRC->POL = CYPHAL_CRC_POLYNOMIAL;
+    CRC->CR = CRC_CR_REV_IN_0 | CRC_CR_REV_OUT;
+    CRC->INIT = __RBIT(ulCrc);
+    CRC->CR |= CRC_CR_RESET;
+
+    while (xSize > 0 && ((uintptr_t) pucData & 3u) != 0)
+    {
+        *(__IO uint8_t *) &CRC->DR = *pucData++;
+        xSize--;
+    }
+
+    /* A word is processed most significant byte first: swap it so that the
+     * bytes go in memory order */
+    while (xSize >= 4)
+    {
+        memcpy(&ulWord, pucData, sizeof(ulWord));
+        CRC->DR = __REV(ulWord);
+        pucData += 4;
+        xSize -= 4;
+    }
+
+    while (xSize > 0)
+    {
+        *(__IO uint8_t *) &CRC->DR = *pucData++;
+        xSize--;
+    }
+
+    return CRC->DR;
+}
+
+static BaseType_t prvSelfTest(void)
+{
+    static const uint8_t ucCheck[] = "123456789";
+    uint8_t ucPattern[CYPHAL_CRC_TEST_MAX_SIZE + 3];
+    uint32_t ulSeed = 0x12345678u;
+    size_t xOffset;
+    size_t xSize;
+    size_t i;
+
+    if ((prvHardwareAdd(CYPHAL_CRC_INITIAL, 9, ucCheck) ^ CYPHAL_CRC_INITIAL) != CYPHAL_CRC_CHECK)
+    {
+        return pdFAIL;
+    }
+
+    for (i = 0; i < sizeof(ucPattern); i++)
+    {
+        ulSeed = ulSeed * 1664525u + 1013904223u;
+        ucPattern[i] = (uint8_t) (ulSeed >> 24);
+    }
+
+    /* Every alignment, the tail lengths, and a seed other than the initial
+     * value as for a transfer continued from a previous datagram */
+    for (xOffset = 0; xOffset < 4; xOffset++)
+    {
+        for (xSize = CYPHAL_CRC_HW_MIN_SIZE; xSize <= CYPHAL_CRC_TEST_MAX_SIZE; xSize++)
+        {
+            if (prvHardwareAdd(ulSeed, xSize, &ucPattern[xOffset]) !=
+                prvReferenceAdd(ulSeed, xSize, &ucPattern[xOffset]))
+            {
+                return pdFAIL;
+            }
+        }
+    }
+
+    return pdPASS;
+}
+
+BaseType_t xCyphalCrcInit(void)
+{
+    __HAL_RCC_CRC_CLK_ENABLE();
+
+    memset(&xStats, 0, sizeof(xStats));
+    xStats.xHardware = prvSelfTest();
+
+    return xStats.xHardware;
+}
+
+TCM_CODE BaseType_t xCyphalCrcAdd(uint32_t ulCrc, size_t xSize, const void *pvData, uint32_t *pulOut)
+{
+    if (xStats.xHardware == pdFALSE || xSize < CYPHAL_CRC_HW_MIN_SIZE)
+    {
+        return pdFALSE;
+    }
+
+    *pulOut = prvHardwareAdd(ulCrc, xSize, (const uint8_t *) pvData);
+
+    xStats.ulBlocks++;
+    xStats.ulBytes += xSize;
+
+    return pdTRUE;
+}
+
+void vCyphalCrcGetStats(CyphalCrcStats_t *pxStats)
+{
+    *pxStats = xStats;
+}
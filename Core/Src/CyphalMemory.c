@@ -0,0 +1,115 @@
+/* CyphalMemory.c
+ *
+ * Fixed block pools backing the libudpard memory resources.
+ *
+ * libudpard allocates on every frame: a TX queue item per datagram sent, a
+ * fragment handle per datagram received, and a session state per remote
+ * node. Served by heap_4, each of these would walk the free list inside a
+ * critical section. A pool instead holds blocks of a single size, so that
+ * allocation and release are a pop and a push on a singly linked free list:
+ * a bounded handful of instructions, with no fragmentation and no interrupt
+ * masking. One pool per resource keeps a burst on one side (e.g. a long
+ * transfer being reassembled) from starving the others, and makes the
+ * worst case memory of each known from its block count. Blocks are charged
+ * to the "udpard" allocation tag (MemTag.h).
+ */
+#include "CyphalMemory.h"
+#include "MemTag.h"
+#include "task.h"
+
+void vCyphalPoolInit(CyphalPool_t *pxPool, void *pvStorage, size_t xBlockSize, UBaseType_t uxBlockCount)
+{
+    uint8_t *pucStorage = (uint8_t *) pvStorage;
+    UBaseType_t i;
+
+    configASSERT((xBlockSize % CYPHAL_POOL_ALIGNMENT) == 0 && xBlockSize >= sizeof(void *));
+
+    pxPool->pucStart = pucStorage;
+    pxPool->pucEnd = pucStorage + xBlockSize * uxBlockCount;
+    pxPool->pvFree = NULL;
+
+    /* Lowest addresses first, the order does not matter otherwise */
+    for (i = uxBlockCount; i > 0; i--)
+    {
+        *(void **) &pucStorage[(i - 1) * xBlockSize] = pxPool->pvFree;
+        pxPool->pvFree = &pucStorage[(i - 1) * xBlockSize];
+    }
+
+    pxPool->xStats.xBlockSize = xBlockSize;
+    pxPool->xStats.uxBlockCount = uxBlockCount;
+    pxPool->xStats.uxUsed = 0;
+    pxPool->xStats.uxPeak = 0;
+    pxPool->xStats.ulFailures = 0;
+    pxPool->xStats.xLargestRequest = 0;
+}
+
+void *pvCyphalPoolAllocate(void *pvPool, size_t xSize)
+{
+    CyphalPool_t *pxPool = (CyphalPool_t *) pvPool;
+    CyphalPoolStats_t *pxStats = &pxPool->xStats;
+    void *pvBlock = pxPool->pvFree;
+
+    if (xSize > pxStats->xLargestRequest)
+    {
+        pxStats->xLargestRequest = xSize;
+    }
+
+    if (pvBlock == NULL || xSize > pxStats->xBlockSize)
+    {
+        pxStats->ulFailures++;
+        vMemTagFailure(eMemTagUdpard);
+        return NULL;
+    }
+
+    pxPool->pvFree = *(void **) pvBlock;
+
+    if (++pxStats->uxUsed > pxStats->uxPeak)
+    {
+        pxStats->uxPeak = pxStats->uxUsed;
+    }
+    vMemTagCharge(eMemTagUdpard, pxStats->xBlockSize);
+
+    return pvBlock;
+}
+
+void vCyphalPoolFree(void *pvPool, size_t xSize, void *pvBlock)
+{
+    CyphalPool_t *pxPool = (CyphalPool_t *) pvPool;
+
+    /* The size is not needed: received datagrams are freed with their
+     * length rather than with the block size */
+    (void) xSize;
+
+    if (pvBlock == NULL)
+    {
+        return;
+    }
+
+    configASSERT((uint8_t *) pvBlock >= pxPool->pucStart && (uint8_t *) pvBlock < pxPool->pucEnd);
+
+    *(void **) pvBlock = pxPool->pvFree;
+    pxPool->pvFree = pvBlock;
+    pxPool->xStats.uxUsed--;
+    vMemTagCredit(eMemTagUdpard, pxPool->xStats.xBlockSize);
+}
+
+struct UdpardMemoryResource xCyphalPoolResource(CyphalPool_t *pxPool)
+{
+    struct UdpardMemoryResource xResource;
+
+    xResource.user_reference = pxPool;
+    xResource.deallocate = vCyphalPoolFree;
+    xResource.allocate = pvCyphalPoolAllocate;
+
+    return xResource;
+}
+
+struct UdpardMemoryDeleter xCyphalPoolDeleter(CyphalPool_t *pxPool)
+{
+    struct UdpardMemoryDeleter xDeleter;
+
+    xDeleter.user_reference = pxPool;
+    xDeleter.deallocate = vCyphalPoolFree;
+
+    return xDeleter;
+}
@@ -0,0 +1,1359 @@
+/* CyphalNode.c
+ *
+ * Cyphal/UDP node built on libudpard and the CycloneTCP socket API.
+ *
+ * Redundancy: the node runs over CYPHAL_NODE_IFACE_COUNT interfaces at
+ * once, netInterface[0] onwards. Every transfer is queued on each of them,
+ * and each interface has its own sockets, so a frame goes out on all links
+ * without waiting for the others; libudpard keeps the first copy of a
+ * transfer received on any interface and drops the others. When a link
+ * fails, the frames of the remaining ones are already on their way: there
+ * is no failover to wait for. Frames queued on a link that is down are
+ * dropped at once, so that they do not hold TX items until their deadline.
+ *
+ * Transmission: publishers serialize transfers into the libudpard TX queues,
+ * from any task, and wake up the node task, which sends the queued frames
+ * in priority order with the DSCP chosen by libudpard. A frame still queued
+ * past the deadline of its transfer is dropped rather than sent late: by
+ * the node task when it comes out of libudpard, and by the NIC, which gets
+ * the deadline along with the frame, if it then waits in the TX queue of
+ * the interface behind other traffic (NIC_TX_DEADLINE_SUPPORT).
+ * Time-triggered frames (xCyphalNodePublishAt) are taken out of their queue
+ * into a few launch slots, and handed to the stack shortly before their
+ * launch time along with the matching PTP time, at which the Ethernet MAC
+ * sends them (ETH_LAUNCH_TIME_SUPPORT): their jitter is that of the MAC
+ * interrupt rather than of the task scheduling. Without a locked PTP slave
+ * the node task sends them itself, on its service cycle.
+ * Frames are loaned to the stack rather than copied: the TX item pool is a
+ * loan region of the stack, so the Ethernet DMA reads each datagram from
+ * its TX item, behind a separate buffer holding the Ethernet, IP and UDP
+ * headers. The serialization by libudpard is thus the only copy of the
+ * payload. The stack gives the blocks back once sent, and the node task
+ * returns them to the pool.
+ *
+ * Reception: each subject gets its own socket per interface, bound to the Cyphal/UDP port
+ * with SO_REUSEPORT and joined to the multicast group of the subject, so
+ * that the stack delivers every datagram to the socket of its subject only.
+ * RPC services share one socket per interface, joined to the group of the
+ * local node-ID.
+ * A classification rule of the NIC processes the Cyphal/UDP port ahead of
+ * the other traffic, while the frame still sits in its ETH RX buffer. The
+ * network buffer of each datagram is handed over to libudpard as is: with
+ * a frame loaned by the driver, the payload libudpard reassembles is the
+ * one the DMA wrote, and the buffer returns to the driver once libudpard
+ * frees it. Only when all held slots are in use, or the datagram is not
+ * contiguous, is it copied into a pool block. Each
+ * libudpard memory resource has its own fixed block pool (CyphalMemory.c)
+ * in the DTCM, but for the TX items, which the Ethernet DMA must reach.
+ * Transfer CRCs of long blocks run on the CRC peripheral
+ * (CyphalCrc.c). Transfers are timestamped with the time the NIC received
+ * their first frame, on the microsecond clock (MonoClock.c) that also
+ * drives deadlines and transfer-ID timeouts.
+ *
+ * The node task waits on all sockets and on the TX event at once, and wakes
+ * up at least every CYPHAL_NODE_CYCLE_US to drop expired frames, run the
+ * cycle hook of the application and publish uavcan.node.Heartbeat.1.0.
+ *
+ * With CYPHAL_NODE_PNP the node starts anonymous: it can receive messages
+ * and publish single-frame ones, which is all plug-and-play allocation
+ * (CyphalPnp.c) needs, but sends no heartbeat and has no RPC socket. Both
+ * come with the node-ID, through xCyphalNodeSetNodeId().
+ *
+ * All libudpard state, including the pools, is guarded by xNodeMutex.
+ * Callbacks run without it, so they may publish or respond.
+ */
+#include "CyphalNode.h"
+#include "task.h"
+#include "semphr.h"
+#include "FreeRTOS_CLI.h"
+#include "MonoClock.h"
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/nic_rx_class.h"
+#include "drivers/mac/stm32h7xx_eth_driver.h"
+#include "StaticAlloc.h"
+#include "Watchdog.h"
+#include "stm32h7xx_hal.h"
+#include <stdio.h>
+#include <string.h>
+
+#if (CYPHAL_NODE_IFACE_COUNT > NET_INTERFACE_COUNT || CYPHAL_NODE_IFACE_COUNT > UDPARD_NETWORK_INTERFACE_COUNT_MAX)
+#error "CYPHAL_NODE_IFACE_COUNT exceeds the interfaces of the stack or of libudpard"
+#endif
+
+/* Destination port of all Cyphal/UDP datagrams */
+#define CYPHAL_UDP_PORT                9382
+
+/* uavcan.node.Heartbeat.1.0, fixed port-ID and serialized size */
+#define CYPHAL_HEARTBEAT_SUBJECT_ID    7509
+#define CYPHAL_HEARTBEAT_SIZE          7
+
+typedef struct
+{
+    struct UdpardRxSubscription xSubscription;
+    Socket *pxSockets[CYPHAL_NODE_IFACE_COUNT]; /* NULL while the slot is free */
+    CyphalMessageCallback_t pxCallback;
+    void *pvParam;
+} CyphalSubscription_t;
+
+/* Network buffer of a received datagram, owned by libudpard */
+typedef struct
+{
+    NetBuffer *pxBuffer;                /* NULL while the slot is free */
+    const void *pvData;                 /* Datagram passed to libudpard */
+    BaseType_t xReleased;               /* Freed by libudpard, to be released */
+} CyphalRxHeld_t;
+
+/* Time-triggered frame popped from its queue, waiting for its launch time */
+typedef struct
+{
+    struct UdpardTxItem *pxItem;        /* NULL while the slot is free */
+    UdpardMicrosecond ullLaunchUs;
+} CyphalTxLaunch_t;
+
+typedef struct
+{
+    struct UdpardRxRPCPort xPort;
+    BaseType_t xUsed;
+    CyphalServiceCallback_t pxCallback;
+    void *pvParam;
+} CyphalService_t;
+
+static uint8_t ucTxItemBlocks[CYPHAL_NODE_TX_BLOCK_COUNT][CYPHAL_POOL_BLOCK_SIZE(CYPHAL_NODE_TX_BLOCK_SIZE)]
+    __attribute__((aligned(CYPHAL_POOL_ALIGNMENT)));
+static uint8_t ucRxDatagramBlocks[CYPHAL_NODE_RX_DATAGRAM_COUNT][CYPHAL_POOL_BLOCK_SIZE(CYPHAL_NODE_RX_DATAGRAM_SIZE)]
+    __attribute__((section(CYPHAL_NODE_POOL_SECTION), aligned(CYPHAL_POOL_ALIGNMENT)));
+static uint8_t ucRxSessionBlocks[CYPHAL_NODE_RX_SESSION_COUNT][CYPHAL_POOL_BLOCK_SIZE(CYPHAL_NODE_RX_SESSION_SIZE)]
+    __attribute__((section(CYPHAL_NODE_POOL_SECTION), aligned(CYPHAL_POOL_ALIGNMENT)));
+static uint8_t ucRxFragmentBlocks[CYPHAL_NODE_RX_FRAGMENT_COUNT][CYPHAL_POOL_BLOCK_SIZE(CYPHAL_NODE_RX_FRAGMENT_SIZE)]
+    __attribute__((section(CYPHAL_NODE_POOL_SECTION), aligned(CYPHAL_POOL_ALIGNMENT)));
+
+static CyphalPool_t xPools[CYPHAL_POOL_COUNT];
+
+/* TX blocks given back by the stack, threaded through their first word
+ * until the node task returns them to the pool */
+static void *volatile pvTxReleased = NULL;
+
+/* Only accessed by the node task, where libudpard frees received datagrams */
+static CyphalRxHeld_t xRxHeld[CYPHAL_NODE_RX_HELD_COUNT];
+
+/* Only accessed by the node task. Transfers queued by xCyphalNodePublishAt()
+ * carry the address of ucLaunchTag as their user reference; their launch
+ * time is their deadline less CYPHAL_NODE_LAUNCH_SLACK_US */
+static CyphalTxLaunch_t xLaunches[CYPHAL_NODE_IFACE_COUNT][CYPHAL_NODE_LAUNCH_SLOTS];
+static uint8_t ucLaunchTag;
+
+static SemaphoreHandle_t xNodeMutex = NULL;
+static OsEvent xNodeEvent;
+static TaskHandle_t xNodeTask = NULL;
+APP_MUTEX_STORAGE(xNodeMutex);
+APP_TASK_STORAGE(xNodeTask, CYPHAL_NODE_STACK_SIZE);
+
+/* UDPARD_NODE_ID_UNSET while anonymous */
+static UdpardNodeID usLocalNodeId = UDPARD_NODE_ID_UNSET;
+static struct UdpardTx xTx[CYPHAL_NODE_IFACE_COUNT];
+static struct UdpardRxMemoryResources xRxMemory;
+static struct UdpardRxRPCDispatcher xDispatcher;
+#if UDPARD_RX_FRAGMENT_QUOTA > 0
+/* Shared by all RX ports of the node */
+static struct UdpardRxQuota xRxQuota = { .limit = CYPHAL_NODE_RX_QUOTA, .used = 0 };
+#endif
+
+static Socket *pxTxSockets[CYPHAL_NODE_IFACE_COUNT];
+static Socket *pxRpcSockets[CYPHAL_NODE_IFACE_COUNT];
+
+static CyphalSubscription_t xSubscriptions[CYPHAL_NODE_MAX_SUBSCRIPTIONS];
+static CyphalService_t xServices[CYPHAL_NODE_MAX_SERVICES];
+
+static volatile CyphalCycleHook_t pxCycleHook = NULL;
+
+static volatile uint8_t ucHealth = CYPHAL_HEALTH_NOMINAL;
+static volatile uint8_t ucMode = CYPHAL_MODE_OPERATIONAL;
+static volatile uint8_t ucVendorStatus = 0;
+
+static CyphalNodeStats_t xStats;
+
+static void prvCyphalNodeTask(void *pvParameters);
+static void prvTxBlockReleased(void *p);
+static void prvFreeRxDatagram(void *pvPool, size_t xSize, void *pvData);
+
+UdpardMicrosecond ullCyphalNodeNowUs(void)
+{
+    return ullMonoClockNowUs();
+}
+
+static Socket *prvOpenRxSocket(const struct UdpardUDPIPEndpoint *pxEndpoint, NetInterface *pxInterface)
+{
+    Socket *pxSocket;
+    IpAddr xGroup;
+
+    pxSocket = socketOpen(SOCKET_TYPE_DGRAM, SOCKET_IP_PROTO_UDP);
+    if (pxSocket == NULL)
+    {
+        return NULL;
+    }
+
+    xGroup.length = sizeof(Ipv4Addr);
+    xGroup.ipv4Addr = htonl(pxEndpoint->ip_address);
+
+    /* Every subject uses the same port; the group tells them apart. The
+     * socket only sees the datagrams of its own interface */
+    if (socketSetInterface(pxSocket, pxInterface) != NO_ERROR ||
+        socketEnableReusePort(pxSocket, TRUE) != NO_ERROR ||
+        socketBind(pxSocket, &IP_ADDR_ANY, pxEndpoint->udp_port) != NO_ERROR ||
+        socketJoinMulticastGroup(pxSocket, &xGroup) != NO_ERROR)
+    {
+        socketClose(pxSocket);
+        return NULL;
+    }
+
+    return pxSocket;
+}
+
+/* Take the node-ID: the dispatcher learns it, which it can only do once,
+ * and the RPC sockets join its group. Called with xNodeMutex held, or
+ * before the node task runs */
+static BaseType_t prvStartRpc(UdpardNodeID usNodeId)
+{
+    struct UdpardUDPIPEndpoint xEndpoint;
+    UBaseType_t i;
+
+    if (udpardRxRPCDispatcherStart(&xDispatcher, usNodeId, &xEndpoint) < 0)
+    {
+        return pdFAIL;
+    }
+
+    /* Requests and responses addressed to this node */
+    for (i = 0; i < CYPHAL_NODE_IFACE_COUNT; i++)
+    {
+        pxRpcSockets[i] = prvOpenRxSocket(&xEndpoint, &netInterface[i]);
+        if (pxRpcSockets[i] == NULL)
+        {
+            while (i > 0)
+            {
+                i--;
+                socketClose(pxRpcSockets[i]);
+                pxRpcSockets[i] = NULL;
+            }
+            return pdFAIL;
+        }
+    }
+
+    usLocalNodeId = usNodeId;
+    return pdPASS;
+}
+
+BaseType_t xCyphalNodeStart(UBaseType_t uxPriority)
+{
+    NicRxClassRule xRule;
+    UBaseType_t i;
+
+    /* Falls back to the software CRC if the peripheral fails its self-test */
+    (void) xCyphalCrcInit();
+
+    vCyphalPoolInit(&xPools[CYPHAL_POOL_TX_ITEM], ucTxItemBlocks,
+                    sizeof(ucTxItemBlocks[0]), CYPHAL_NODE_TX_BLOCK_COUNT);
+    vCyphalPoolInit(&xPools[CYPHAL_POOL_RX_DATAGRAM], ucRxDatagramBlocks,
+                    sizeof(ucRxDatagramBlocks[0]), CYPHAL_NODE_RX_DATAGRAM_COUNT);
+    vCyphalPoolInit(&xPools[CYPHAL_POOL_RX_SESSION], ucRxSessionBlocks,
+                    sizeof(ucRxSessionBlocks[0]), CYPHAL_NODE_RX_SESSION_COUNT);
+    vCyphalPoolInit(&xPools[CYPHAL_POOL_RX_FRAGMENT], ucRxFragmentBlocks,
+                    sizeof(ucRxFragmentBlocks[0]), CYPHAL_NODE_RX_FRAGMENT_COUNT);
+
+    xRxMemory.session = xCyphalPoolResource(&xPools[CYPHAL_POOL_RX_SESSION]);
+    xRxMemory.fragment = xCyphalPoolResource(&xPools[CYPHAL_POOL_RX_FRAGMENT]);
+    xRxMemory.payload.user_reference = &xPools[CYPHAL_POOL_RX_DATAGRAM];
+    xRxMemory.payload.deallocate = prvFreeRxDatagram;
+
+    xNodeMutex = xAppSemaphoreCreateMutex(xNodeMutex);
+    if (xNodeMutex == NULL || !osCreateEvent(&xNodeEvent) ||
+        memPoolRegisterLoanRegion(ucTxItemBlocks, sizeof(ucTxItemBlocks), prvTxBlockReleased) != NO_ERROR)
+    {
+        return pdFAIL;
+    }
+
+    if (udpardRxRPCDispatcherInit(&xDispatcher, xRxMemory) < 0)
+    {
+        return pdFAIL;
+    }
+
+    for (i = 0; i < CYPHAL_NODE_IFACE_COUNT; i++)
+    {
+        /* The queues share the TX item pool */
+        if (udpardTxInit(&xTx[i], &usLocalNodeId, CYPHAL_NODE_TX_QUEUE_CAPACITY,
+                         xCyphalPoolResource(&xPools[CYPHAL_POOL_TX_ITEM])) < 0)
+        {
+            return pdFAIL;
+        }
+
+        /* Any source port will do; the TTL must let frames cross routers */
+        pxTxSockets[i] = socketOpen(SOCKET_TYPE_DGRAM, SOCKET_IP_PROTO_UDP);
+        if (pxTxSockets[i] == NULL ||
+            socketSetInterface(pxTxSockets[i], &netInterface[i]) != NO_ERROR ||
+            socketSetMulticastTtl(pxTxSockets[i], CYPHAL_NODE_MULTICAST_TTL) != NO_ERROR ||
+            socketBind(pxTxSockets[i], &IP_ADDR_ANY, 0) != NO_ERROR)
+        {
+            return pdFAIL;
+        }
+    }
+
+    /* Cyphal frames are processed as soon as the driver hands them over,
+     * in their RX buffer, rather than held and copied behind bulk traffic */
+    memset(&xRule, 0, sizeof(xRule));
+    xRule.match = NIC_RX_CLASS_MATCH_IP_PROTOCOL | NIC_RX_CLASS_MATCH_DEST_PORT;
+    xRule.ipProtocol = IPV4_PROTOCOL_UDP;
+    xRule.destPort = CYPHAL_UDP_PORT;
+    xRule.classIndex = 0;
+    (void) nicRxClassAddRule(&xRule);
+
+#if (CYPHAL_NODE_PNP == 0)
+    if (prvStartRpc(CYPHAL_NODE_ID) != pdPASS)
+    {
+        return pdFAIL;
+    }
+#endif
+
+    return xAppTaskCreate(xNodeTask, prvCyphalNodeTask, "Cyphal", CYPHAL_NODE_STACK_SIZE, NULL, uxPriority, &xNodeTask);
+}
+
+BaseType_t xCyphalNodeSubscribe(UdpardPortID usSubjectId, size_t xExtent,
+                                CyphalMessageCallback_t pxCallback, void *pvParam)
+{
+    CyphalSubscription_t *pxSubscription = NULL;
+    UBaseType_t i;
+
+    if (xNodeMutex == NULL || pxCallback == NULL)
+    {
+        return pdFAIL;
+    }
+
+    xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+
+    for (i = 0; i < CYPHAL_NODE_MAX_SUBSCRIPTIONS; i++)
+    {
+        if (xSubscriptions[i].pxSockets[0] == NULL)
+        {
+            pxSubscription = &xSubscriptions[i];
+            break;
+        }
+    }
+
+    if (pxSubscription == NULL ||
+        udpardRxSubscriptionInit(&pxSubscription->xSubscription, usSubjectId, xExtent, xRxMemory) < 0)
+    {
+        xSemaphoreGive(xNodeMutex);
+        return pdFAIL;
+    }
+
+    pxSubscription->pxCallback = pxCallback;
+    pxSubscription->pvParam = pvParam;
+#if UDPARD_RX_FRAGMENT_QUOTA > 0
+    pxSubscription->xSubscription.port.shared_quota = &xRxQuota;
+#endif
+
+    for (i = 0; i < CYPHAL_NODE_IFACE_COUNT; i++)
+    {
+        pxSubscription->pxSockets[i] = prvOpenRxSocket(&pxSubscription->xSubscription.udp_ip_endpoint,
+                                                       &netInterface[i]);
+        if (pxSubscription->pxSockets[i] == NULL)
+        {
+            /* The slot stays free */
+            while (i > 0)
+            {
+                i--;
+                socketClose(pxSubscription->pxSockets[i]);
+                pxSubscription->pxSockets[i] = NULL;
+            }
+            udpardRxSubscriptionFree(&pxSubscription->xSubscription);
+            xSemaphoreGive(xNodeMutex);
+            return pdFAIL;
+        }
+    }
+
+    xSemaphoreGive(xNodeMutex);
+
+    /* The node task polls the new socket from its next wake-up */
+    osSetEvent(&xNodeEvent);
+    return pdPASS;
+}
+
+BaseType_t xCyphalNodeListen(UdpardPortID usServiceId, BaseType_t xIsRequest, size_t xExtent,
+                             CyphalServiceCallback_t pxCallback, void *pvParam)
+{
+    CyphalService_t *pxService = NULL;
+    BaseType_t xResult = pdFAIL;
+    UBaseType_t i;
+
+    if (xNodeMutex == NULL || pxCallback == NULL)
+    {
+        return pdFAIL;
+    }
+
+    xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+
+    for (i = 0; i < CYPHAL_NODE_MAX_SERVICES; i++)
+    {
+        if (xServices[i].xUsed == pdFALSE)
+        {
+            pxService = &xServices[i];
+            break;
+        }
+    }
+
+    if (pxService != NULL)
+    {
+        pxService->pxCallback = pxCallback;
+        pxService->pvParam = pvParam;
+        pxService->xPort.user_reference = pxService;
+
+        if (udpardRxRPCDispatcherListen(&xDispatcher, &pxService->xPort, usServiceId,
+                                        xIsRequest != pdFALSE, xExtent) >= 0)
+        {
+#if UDPARD_RX_FRAGMENT_QUOTA > 0
+            pxService->xPort.port.shared_quota = &xRxQuota;
+#endif
+            pxService->xUsed = pdTRUE;
+            xResult = pdPASS;
+        }
+    }
+
+    xSemaphoreGive(xNodeMutex);
+    return xResult;
+}
+
+/* Result of queuing a transfer on one interface: libudpard returns the
+ * number of frames queued, or a negated error code */
+static BaseType_t prvQueuedOn(int32_t lResult)
+{
+    if (lResult == -UDPARD_ERROR_CAPACITY)
+    {
+        xStats.ulTxQueueFull++;
+    }
+
+    return (lResult >= 0) ? pdTRUE : pdFALSE;
+}
+
+/* Common tail of the transmit functions: the transfer is sent once queued
+ * on any interface, the others being redundant */
+static BaseType_t prvQueued(BaseType_t xQueued, UdpardTransferID *pxTransferId)
+{
+    xSemaphoreGive(xNodeMutex);
+
+    if (xQueued == pdFALSE)
+    {
+        return pdFAIL;
+    }
+
+    if (pxTransferId != NULL)
+    {
+        (*pxTransferId)++;
+    }
+
+    osSetEvent(&xNodeEvent);
+    return pdPASS;
+}
+
+BaseType_t xCyphalNodePublish(UdpardPortID usSubjectId, enum UdpardPriority ePriority,
+                              UdpardTransferID *pxTransferId, const void *pvData, size_t xLength,
+                              uint32_t ulTimeoutUs)
+{
+    const struct UdpardPayload xPayload = { .size = xLength, .data = pvData };
+    UdpardMicrosecond ullDeadlineUs;
+    BaseType_t xQueued = pdFALSE;
+    UBaseType_t i;
+
+    if (xNodeMutex == NULL || pxTransferId == NULL)
+    {
+        return pdFAIL;
+    }
+
+    xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+    ullDeadlineUs = ullCyphalNodeNowUs() + ulTimeoutUs;
+    for (i = 0; i < CYPHAL_NODE_IFACE_COUNT; i++)
+    {
+        xQueued |= prvQueuedOn(udpardTxPublish(&xTx[i], ullDeadlineUs, ePriority, usSubjectId,
+                                               *pxTransferId, xPayload, NULL));
+    }
+    return prvQueued(xQueued, pxTransferId);
+}
+
+BaseType_t xCyphalNodePublishAt(UdpardPortID usSubjectId, enum UdpardPriority ePriority,
+                                UdpardTransferID *pxTransferId, const void *pvData, size_t xLength,
+                                UdpardMicrosecond ullLaunchUs)
+{
+    const struct UdpardPayload xPayload = { .size = xLength, .data = pvData };
+    BaseType_t xQueued = pdFALSE;
+    UBaseType_t i;
+
+    if (xNodeMutex == NULL || pxTransferId == NULL || ullLaunchUs == 0)
+    {
+        return pdFAIL;
+    }
+
+    xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+    for (i = 0; i < CYPHAL_NODE_IFACE_COUNT; i++)
+    {
+        xQueued |= prvQueuedOn(udpardTxPublish(&xTx[i], ullLaunchUs + CYPHAL_NODE_LAUNCH_SLACK_US, ePriority,
+                                               usSubjectId, *pxTransferId, xPayload, &ucLaunchTag));
+    }
+    return prvQueued(xQueued, pxTransferId);
+}
+
+BaseType_t xCyphalNodeRequest(UdpardPortID usServiceId, UdpardNodeID usServerNodeId,
+                              enum UdpardPriority ePriority, UdpardTransferID *pxTransferId,
+                              const void *pvData, size_t xLength, uint32_t ulTimeoutUs)
+{
+    const struct UdpardPayload xPayload = { .size = xLength, .data = pvData };
+    UdpardMicrosecond ullDeadlineUs;
+    BaseType_t xQueued = pdFALSE;
+    UBaseType_t i;
+
+    if (xNodeMutex == NULL || pxTransferId == NULL)
+    {
+        return pdFAIL;
+    }
+
+    xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+    ullDeadlineUs = ullCyphalNodeNowUs() + ulTimeoutUs;
+    for (i = 0; i < CYPHAL_NODE_IFACE_COUNT; i++)
+    {
+        xQueued |= prvQueuedOn(udpardTxRequest(&xTx[i], ullDeadlineUs, ePriority, usServiceId,
+                                               usServerNodeId, *pxTransferId, xPayload, NULL));
+    }
+    return prvQueued(xQueued, pxTransferId);
+}
+
+BaseType_t xCyphalNodeRespond(const struct UdpardRxRPCTransfer *pxRequest,
+                              const void *pvData, size_t xLength, uint32_t ulTimeoutUs)
+{
+    const struct UdpardPayload xPayload = { .size = xLength, .data = pvData };
+    UdpardMicrosecond ullDeadlineUs;
+    BaseType_t xQueued = pdFALSE;
+    UBaseType_t i;
+
+    if (xNodeMutex == NULL || pxRequest == NULL || !pxRequest->is_request)
+    {
+        return pdFAIL;
+    }
+
+    xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+    ullDeadlineUs = ullCyphalNodeNowUs() + ulTimeoutUs;
+    for (i = 0; i < CYPHAL_NODE_IFACE_COUNT; i++)
+    {
+        xQueued |= prvQueuedOn(udpardTxRespond(&xTx[i], ullDeadlineUs, pxRequest->base.priority,
+                                               pxRequest->service_id, pxRequest->base.source_node_id,
+                                               pxRequest->base.transfer_id, xPayload, NULL));
+    }
+    return prvQueued(xQueued, NULL);
+}
+
+void vCyphalNodeSetStatus(uint8_t ucNewHealth, uint8_t ucNewMode, uint8_t ucNewVendorStatus)
+{
+    ucHealth = ucNewHealth & 0x03u;
+    ucMode = ucNewMode & 0x07u;
+    ucVendorStatus = ucNewVendorStatus;
+}
+
+void vCyphalNodeSetCycleHook(CyphalCycleHook_t pxHook)
+{
+    pxCycleHook = pxHook;
+}
+
+void vCyphalNodeLock(void)
+{
+    if (xNodeMutex != NULL)
+    {
+        xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+    }
+}
+
+void vCyphalNodeUnlock(void)
+{
+    if (xNodeMutex != NULL)
+    {
+        xSemaphoreGive(xNodeMutex);
+    }
+}
+
+BaseType_t xCyphalNodeSetNodeId(UdpardNodeID usNodeId)
+{
+    BaseType_t xResult = pdFAIL;
+
+    if (xNodeMutex == NULL || usNodeId > UDPARD_NODE_ID_MAX)
+    {
+        return pdFAIL;
+    }
+
+    xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+    if (usLocalNodeId == UDPARD_NODE_ID_UNSET)
+    {
+        xResult = prvStartRpc(usNodeId);
+    }
+    xSemaphoreGive(xNodeMutex);
+
+    /* The node task polls the RPC sockets from its next wake-up */
+    osSetEvent(&xNodeEvent);
+    return xResult;
+}
+
+UdpardNodeID usCyphalNodeGetNodeId(void)
+{
+    return usLocalNodeId;
+}
+
+void vCyphalNodeGetUniqueId(uint8_t *pucUniqueId)
+{
+    uint32_t ulWords[3] = { HAL_GetUIDw0(), HAL_GetUIDw1(), HAL_GetUIDw2() };
+    UBaseType_t i;
+
+    /* The 96-bit device ID, little endian, zero padded */
+    memset(pucUniqueId, 0, CYPHAL_NODE_UNIQUE_ID_SIZE);
+    for (i = 0; i < 12; i++)
+    {
+        pucUniqueId[i] = (uint8_t) (ulWords[i / 4] >> (8 * (i % 4)));
+    }
+}
+
+#if UDPARD_RX_FRAGMENT_QUOTA > 0
+/* Add the reassembly counters of an RX port to the node counters */
+static void prvAddPortStats(CyphalNodeStats_t *pxStats, const struct UdpardRxPort *pxPort)
+{
+    pxStats->ulRxTruncated += (uint32_t) pxPort->stats.truncated_transfers;
+    pxStats->ulRxEvicted += (uint32_t) pxPort->stats.evicted_transfers;
+    pxStats->ulRxLate += (uint32_t) pxPort->stats.late_transfers;
+    pxStats->ulRxQuotaDrops += (uint32_t) pxPort->stats.quota_drops;
+}
+#endif
+
+void vCyphalNodeGetStats(CyphalNodeStats_t *pxStats)
+{
+    UBaseType_t i;
+
+    if (xNodeMutex == NULL)
+    {
+        memset(pxStats, 0, sizeof(*pxStats));
+        return;
+    }
+
+    xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+
+    *pxStats = xStats;
+    for (i = 0; i < CYPHAL_POOL_COUNT; i++)
+    {
+        pxStats->xPools[i] = xPools[i].xStats;
+    }
+    vCyphalCrcGetStats(&pxStats->xCrc);
+
+#if UDPARD_RX_FRAGMENT_QUOTA > 0
+    /* Counted per port by libudpard; those of released ports are lost */
+    pxStats->ulRxFragments = (uint32_t) xRxQuota.used;
+    for (i = 0; i < CYPHAL_NODE_MAX_SUBSCRIPTIONS; i++)
+    {
+        if (xSubscriptions[i].pxSockets[0] != NULL)
+        {
+            prvAddPortStats(pxStats, &xSubscriptions[i].xSubscription.port);
+        }
+    }
+    for (i = 0; i < CYPHAL_NODE_MAX_SERVICES; i++)
+    {
+        if (xServices[i].xUsed != pdFALSE)
+        {
+            prvAddPortStats(pxStats, &xServices[i].xPort.port);
+        }
+    }
+#endif
+
+    xSemaphoreGive(xNodeMutex);
+}
+
+static void prvPublishHeartbeat(UdpardMicrosecond ullNowUs)
+{
+    static UdpardTransferID xTransferId = 0;
+    uint8_t ucPayload[CYPHAL_HEARTBEAT_SIZE];
+    uint32_t ulUptime = (uint32_t) (ullNowUs / 1000000u);
+
+    /* uint32 uptime, then Health, Mode (byte aligned composites) and uint8
+     * vendor_specific_status_code, little endian */
+    ucPayload[0] = (uint8_t) ulUptime;
+    ucPayload[1] = (uint8_t) (ulUptime >> 8);
+    ucPayload[2] = (uint8_t) (ulUptime >> 16);
+    ucPayload[3] = (uint8_t) (ulUptime >> 24);
+    ucPayload[4] = ucHealth;
+    ucPayload[5] = ucMode;
+    ucPayload[6] = ucVendorStatus;
+
+    /* Stale heartbeats are useless; drop them after one period */
+    (void) xCyphalNodePublish(CYPHAL_HEARTBEAT_SUBJECT_ID, UdpardPriorityNominal, &xTransferId,
+                              ucPayload, sizeof(ucPayload), CYPHAL_NODE_HEARTBEAT_PERIOD_US);
+}
+
+/* Called by the stack, possibly from its own task with netMutex held, when
+ * the frame referencing a TX item is freed: cannot take xNodeMutex here */
+static void prvTxBlockReleased(void *p)
+{
+    size_t xIndex = (size_t) ((uint8_t *) p - &ucTxItemBlocks[0][0]) / sizeof(ucTxItemBlocks[0]);
+    void *pvBlock = ucTxItemBlocks[xIndex];
+
+    taskENTER_CRITICAL();
+    *(void **) pvBlock = pvTxReleased;
+    pvTxReleased = pvBlock;
+    taskEXIT_CRITICAL();
+}
+
+static void prvReclaimTx(void)
+{
+    void *pvBlock;
+    void *pvNext;
+
+    taskENTER_CRITICAL();
+    pvBlock = pvTxReleased;
+    pvTxReleased = NULL;
+    taskEXIT_CRITICAL();
+
+    if (pvBlock == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+    while (pvBlock != NULL)
+    {
+        pvNext = *(void **) pvBlock;
+        vCyphalPoolFree(&xPools[CYPHAL_POOL_TX_ITEM], CYPHAL_NODE_TX_BLOCK_SIZE, pvBlock);
+        pvBlock = pvNext;
+    }
+    xSemaphoreGive(xNodeMutex);
+}
+
+/* Launch time of a time-triggered frame, 0 for the others */
+static UdpardMicrosecond prvLaunchTime(const struct UdpardTxItem *pxItem)
+{
+    return (pxItem->user_transfer_reference == &ucLaunchTag) ?
+        pxItem->deadline_usec - CYPHAL_NODE_LAUNCH_SLACK_US : 0;
+}
+
+/* A time-triggered frame goes to the stack CYPHAL_NODE_LAUNCH_LEAD_US ahead
+ * when the MAC can launch it, else at its launch time */
+static BaseType_t prvLaunchDue(UdpardMicrosecond ullLaunchUs, UdpardMicrosecond ullNowUs)
+{
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+    if (ullMonoClockToReferenceUs(ullLaunchUs) != 0)
+    {
+        return (ullLaunchUs <= ullNowUs + CYPHAL_NODE_LAUNCH_LEAD_US) ? pdTRUE : pdFALSE;
+    }
+#endif
+    return (ullLaunchUs <= ullNowUs) ? pdTRUE : pdFALSE;
+}
+
+/* Hand a frame over to the stack. On success the stack owns the block,
+ * which comes back through prvTxBlockReleased() once the frame is out */
+static error_t prvSendItem(UBaseType_t uxIface, const struct UdpardTxItem *pxItem, UdpardMicrosecond ullLaunchUs)
+{
+    SocketMsg xMessage;
+    error_t error;
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+    uint64_t ullReferenceUs = 0;
+#endif
+
+    xMessage = SOCKET_DEFAULT_MSG;
+    xMessage.data = pxItem->datagram_payload.data;
+    xMessage.length = pxItem->datagram_payload.size;
+    xMessage.tos = (uint8_t) (pxItem->dscp << 2);
+    xMessage.destIpAddr.length = sizeof(Ipv4Addr);
+    xMessage.destIpAddr.ipv4Addr = htonl(pxItem->destination.ip_address);
+    xMessage.destPort = pxItem->destination.udp_port;
+
+    /* The frame may still wait in the TX queue of the interface: it is
+     * dropped there too once its deadline has passed */
+    xMessage.deadline = osGetSystemTime() +
+        (systime_t) ((pxItem->deadline_usec - ullCyphalNodeNowUs()) / 1000u);
+
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+    /* The MAC holds the frame until the PTP time of its launch */
+    if (ullLaunchUs != 0)
+    {
+        ullReferenceUs = ullMonoClockToReferenceUs(ullLaunchUs);
+        xMessage.launchTime.s = (uint32_t) (ullReferenceUs / 1000000u);
+        xMessage.launchTime.ns = (uint32_t) (ullReferenceUs % 1000000u) * 1000u;
+    }
+#endif
+
+    error = socketSendLoanedMsg(pxTxSockets[uxIface], &xMessage, 0);
+
+    if (error == NO_ERROR && ullLaunchUs != 0)
+    {
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+        if (ullReferenceUs != 0)
+        {
+            xStats.ulTxTimed++;
+        }
+        else
+#endif
+        {
+            xStats.ulTxUntimed++;
+        }
+    }
+
+    return error;
+}
+
+/* Set a time-triggered frame aside until it is due */
+static BaseType_t prvHoldLaunch(UBaseType_t uxIface, const struct UdpardTxItem *pxItem,
+                                UdpardMicrosecond ullLaunchUs)
+{
+    UBaseType_t i;
+
+    for (i = 0; i < CYPHAL_NODE_LAUNCH_SLOTS; i++)
+    {
+        if (xLaunches[uxIface][i].pxItem == NULL)
+        {
+            xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+            xLaunches[uxIface][i].pxItem = udpardTxPop(&xTx[uxIface], pxItem);
+            xSemaphoreGive(xNodeMutex);
+            xLaunches[uxIface][i].ullLaunchUs = ullLaunchUs;
+            return pdTRUE;
+        }
+    }
+
+    return pdFALSE;
+}
+
+/* Send the time-triggered frames of one interface that are due, dropping
+ * expired ones, and all of them while the link is down */
+static void prvFlushLaunches(UBaseType_t uxIface)
+{
+    CyphalIfaceStats_t *pxIfaceStats = &xStats.xIfaces[uxIface];
+    CyphalTxLaunch_t *pxLaunch;
+    UdpardMicrosecond ullNowUs;
+    UBaseType_t i;
+
+    for (i = 0; i < CYPHAL_NODE_LAUNCH_SLOTS; i++)
+    {
+        pxLaunch = &xLaunches[uxIface][i];
+        ullNowUs = ullCyphalNodeNowUs();
+
+        if (pxLaunch->pxItem == NULL || (netGetLinkState(&netInterface[uxIface]) &&
+            pxLaunch->pxItem->deadline_usec > ullNowUs && !prvLaunchDue(pxLaunch->ullLaunchUs, ullNowUs)))
+        {
+            continue;
+        }
+
+        if (!netGetLinkState(&netInterface[uxIface]))
+        {
+            xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+            udpardTxFree(xTx[uxIface].memory, pxLaunch->pxItem);
+            pxIfaceStats->ulTxLinkDown++;
+            xSemaphoreGive(xNodeMutex);
+        }
+        else if (pxLaunch->pxItem->deadline_usec > ullNowUs)
+        {
+            if (prvSendItem(uxIface, pxLaunch->pxItem, pxLaunch->ullLaunchUs) != NO_ERROR)
+            {
+                /* Retry on the next cycle, until the deadline */
+                xStats.ulTxErrors++;
+                continue;
+            }
+
+            xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+            xStats.ulTxFrames++;
+            pxIfaceStats->ulTxFrames++;
+            xSemaphoreGive(xNodeMutex);
+        }
+        else
+        {
+            xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+            udpardTxFree(xTx[uxIface].memory, pxLaunch->pxItem);
+            xStats.ulTxExpired++;
+            xSemaphoreGive(xNodeMutex);
+        }
+
+        pxLaunch->pxItem = NULL;
+    }
+}
+
+/* Send the frames queued on one interface in priority order, dropping
+ * expired ones, and all of them while the link is down. Only this task
+ * pops the queues, so the item stays valid while the mutex is released for
+ * the send */
+static void prvFlushTxIface(UBaseType_t uxIface)
+{
+    struct UdpardTx *pxTx = &xTx[uxIface];
+    CyphalIfaceStats_t *pxIfaceStats = &xStats.xIfaces[uxIface];
+    const struct UdpardTxItem *pxItem;
+    UdpardMicrosecond ullLaunchUs;
+    error_t error;
+
+    prvFlushLaunches(uxIface);
+
+    for (;;)
+    {
+        xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+        pxItem = udpardTxPeek(pxTx);
+        xSemaphoreGive(xNodeMutex);
+
+        if (pxItem == NULL)
+        {
+            break;
+        }
+
+        if (!netGetLinkState(&netInterface[uxIface]))
+        {
+            /* The other interfaces carry the transfer */
+            xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+            udpardTxFree(pxTx->memory, udpardTxPop(pxTx, pxItem));
+            pxIfaceStats->ulTxLinkDown++;
+            xSemaphoreGive(xNodeMutex);
+        }
+        else if (pxItem->deadline_usec > ullCyphalNodeNowUs())
+        {
+            /* A time-triggered frame not due yet waits in a launch slot;
+             * with none free, the queue waits for one */
+            ullLaunchUs = prvLaunchTime(pxItem);
+            if (ullLaunchUs != 0 && !prvLaunchDue(ullLaunchUs, ullCyphalNodeNowUs()))
+            {
+                if (!prvHoldLaunch(uxIface, pxItem, ullLaunchUs))
+                {
+                    break;
+                }
+                continue;
+            }
+
+            error = prvSendItem(uxIface, pxItem, ullLaunchUs);
+            if (error != NO_ERROR)
+            {
+                /* Out of buffers: retry on the next cycle, until the
+                 * deadline */
+                xStats.ulTxErrors++;
+                break;
+            }
+
+            xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+            (void) udpardTxPop(pxTx, pxItem);
+            xStats.ulTxFrames++;
+            pxIfaceStats->ulTxFrames++;
+            xSemaphoreGive(xNodeMutex);
+        }
+        else
+        {
+            xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+            udpardTxFree(pxTx->memory, udpardTxPop(pxTx, pxItem));
+            xStats.ulTxExpired++;
+            xSemaphoreGive(xNodeMutex);
+        }
+    }
+}
+
+/* Send the queued frames of every interface, one interface not waiting on
+ * another */
+static void prvFlushTx(void)
+{
+    UBaseType_t i;
+
+    for (i = 0; i < CYPHAL_NODE_IFACE_COUNT; i++)
+    {
+        prvFlushTxIface(i);
+    }
+
+    /* Blocks released while sending, or since the last flush */
+    prvReclaimTx();
+}
+
+/* Deleter of received datagrams: a pool block, or a held network buffer,
+ * released by the node task once outside xNodeMutex */
+static void prvFreeRxDatagram(void *pvPool, size_t xSize, void *pvData)
+{
+    CyphalPool_t *pxPool = (CyphalPool_t *) pvPool;
+    UBaseType_t i;
+
+    if (pvData == NULL)
+    {
+        return;
+    }
+
+    if ((uint8_t *) pvData >= pxPool->pucStart && (uint8_t *) pvData < pxPool->pucEnd)
+    {
+        vCyphalPoolFree(pvPool, xSize, pvData);
+        return;
+    }
+
+    for (i = 0; i < CYPHAL_NODE_RX_HELD_COUNT; i++)
+    {
+        if (xRxHeld[i].pxBuffer != NULL && xRxHeld[i].pvData == pvData)
+        {
+            xRxHeld[i].xReleased = pdTRUE;
+            return;
+        }
+    }
+
+    configASSERT(0);
+}
+
+/* Give the network buffers freed by libudpard back to the stack */
+static void prvReleaseRxHeld(void)
+{
+    UBaseType_t i;
+
+    for (i = 0; i < CYPHAL_NODE_RX_HELD_COUNT; i++)
+    {
+        if (xRxHeld[i].pxBuffer != NULL && xRxHeld[i].xReleased)
+        {
+            socketReleaseBuffer(xRxHeld[i].pxBuffer);
+            xRxHeld[i].pxBuffer = NULL;
+            xRxHeld[i].pvData = NULL;
+            xRxHeld[i].xReleased = pdFALSE;
+        }
+    }
+}
+
+/* Hand the next datagram of the socket over to libudpard, in the network
+ * buffer if possible, along with the time its frame was received.
+ * *pxDatagram is empty if it was dropped */
+static BaseType_t prvTakeDatagram(Socket *pxSocket, struct UdpardMutablePayload *pxDatagram,
+                                  UdpardMicrosecond *pullRxTimeUs)
+{
+    SocketMsg xMessage;
+    NetBuffer *pxBuffer;
+    size_t xOffset;
+    void *pvBlock;
+    UBaseType_t i;
+
+    xMessage = SOCKET_DEFAULT_MSG;
+    if (socketReceiveBuffer(pxSocket, &xMessage, &pxBuffer, &xOffset, SOCKET_FLAG_DONT_WAIT) != NO_ERROR)
+    {
+        return pdFALSE;
+    }
+
+    pxDatagram->size = xMessage.length;
+    pxDatagram->data = NULL;
+    *pullRxTimeUs = xMessage.rxTime;
+
+    /* Contiguous payload, in the loaned frame most of the time */
+    if (xMessage.data != NULL)
+    {
+        for (i = 0; i < CYPHAL_NODE_RX_HELD_COUNT; i++)
+        {
+            if (xRxHeld[i].pxBuffer == NULL)
+            {
+                xRxHeld[i].pxBuffer = pxBuffer;
+                xRxHeld[i].pvData = xMessage.data;
+                xRxHeld[i].xReleased = pdFALSE;
+                pxDatagram->data = xMessage.data;
+
+                xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+                xStats.ulRxInPlace++;
+                xSemaphoreGive(xNodeMutex);
+                return pdTRUE;
+            }
+        }
+    }
+
+    xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+    pvBlock = pvCyphalPoolAllocate(&xPools[CYPHAL_POOL_RX_DATAGRAM], CYPHAL_NODE_RX_DATAGRAM_SIZE);
+    if (pvBlock == NULL)
+    {
+        /* Out of memory: the datagram is dropped */
+        pxDatagram->size = 0;
+        xStats.ulRxDropped++;
+    }
+    xSemaphoreGive(xNodeMutex);
+
+    if (pvBlock != NULL)
+    {
+        pxDatagram->size = netBufferRead(pvBlock, pxBuffer, xOffset,
+                                         MIN(xMessage.length, CYPHAL_NODE_RX_DATAGRAM_SIZE));
+        pxDatagram->data = pvBlock;
+    }
+
+    socketReleaseBuffer(pxBuffer);
+
+    return pdTRUE;
+}
+
+/* Drain one socket of interface uxIface into libudpard; pxSubscription is
+ * NULL for the RPC sockets */
+static void prvReceive(Socket *pxSocket, CyphalSubscription_t *pxSubscription, UBaseType_t uxIface)
+{
+    struct UdpardRxTransfer xTransfer;
+    struct UdpardRxRPCTransfer xRpcTransfer;
+    struct UdpardRxRPCPort *pxPort = NULL;
+    struct UdpardMutablePayload xDatagram;
+    UdpardMicrosecond ullRxTimeUs;
+    CyphalService_t *pxService;
+    int_fast8_t lResult;
+
+    while (prvTakeDatagram(pxSocket, &xDatagram, &ullRxTimeUs))
+    {
+        if (xDatagram.data == NULL)
+        {
+            continue;
+        }
+
+        /* libudpard owns the datagram from here on */
+        xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+        xStats.ulRxDatagrams++;
+        xStats.xIfaces[uxIface].ulRxDatagrams++;
+
+        if (pxSubscription != NULL)
+        {
+            lResult = udpardRxSubscriptionReceive(&pxSubscription->xSubscription, ullRxTimeUs,
+                                                  xDatagram, (uint_fast8_t) uxIface, &xTransfer);
+        }
+        else
+        {
+            lResult = udpardRxRPCDispatcherReceive(&xDispatcher, ullRxTimeUs, xDatagram,
+                                                   (uint_fast8_t) uxIface, &pxPort, &xRpcTransfer);
+        }
+
+        if (lResult > 0)
+        {
+            xStats.ulRxTransfers++;
+        }
+        xSemaphoreGive(xNodeMutex);
+
+        if (lResult <= 0)
+        {
+            /* Rejected, or kept for reassembly */
+            prvReleaseRxHeld();
+            continue;
+        }
+
+        if (pxSubscription != NULL)
+        {
+            pxSubscription->pxCallback(&xTransfer, pxSubscription->pvParam);
+        }
+        else
+        {
+            pxService = (CyphalService_t *) pxPort->user_reference;
+            pxService->pxCallback(&xRpcTransfer, pxService->pvParam);
+            xTransfer = xRpcTransfer.base;
+        }
+
+        xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+        udpardRxFragmentFree(xTransfer.payload, xRxMemory.fragment, xRxMemory.payload);
+        xSemaphoreGive(xNodeMutex);
+
+        prvReleaseRxHeld();
+    }
+}
+
+static void prvCyphalNodeTask(void *pvParameters)
+{
+    SocketEventDesc xEvents[CYPHAL_NODE_SOCKET_COUNT];
+    CyphalSubscription_t *pxOwners[CYPHAL_NODE_SOCKET_COUNT];
+    UBaseType_t uxIfaces[CYPHAL_NODE_SOCKET_COUNT];
+    CyphalCycleHook_t pxHook;
+    UdpardMicrosecond ullNowUs;
+    UdpardMicrosecond ullNextCycleUs;
+    UdpardMicrosecond ullNextHeartbeatUs;
+    UBaseType_t uxCount;
+    UBaseType_t i;
+    UBaseType_t j;
+
+    (void) pvParameters;
+
+    ullNextCycleUs = ullCyphalNodeNowUs();
+    ullNextHeartbeatUs = ullNextCycleUs;
+
+    /* The loop runs at least once a cycle */
+    configASSERT(xWatchdogRegister(NULL, WATCHDOG_DEADLINE_MS) == pdPASS);
+
+    for (;;)
+    {
+        vWatchdogKick();
+
+        ullNowUs = ullCyphalNodeNowUs();
+
+        if (ullNowUs >= ullNextCycleUs)
+        {
+            /* Anonymous nodes do not publish the heartbeat */
+            if (ullNowUs >= ullNextHeartbeatUs && usLocalNodeId != UDPARD_NODE_ID_UNSET)
+            {
+                prvPublishHeartbeat(ullNowUs);
+                ullNextHeartbeatUs += CYPHAL_NODE_HEARTBEAT_PERIOD_US;
+                if (ullNextHeartbeatUs <= ullNowUs)
+                {
+                    ullNextHeartbeatUs = ullNowUs + CYPHAL_NODE_HEARTBEAT_PERIOD_US;
+                }
+            }
+
+            pxHook = pxCycleHook;
+            if (pxHook != NULL)
+            {
+                pxHook(ullNowUs);
+            }
+
+            /* Keep the phase of the cycle, unless it fell behind */
+            ullNextCycleUs += CYPHAL_NODE_CYCLE_US;
+            if (ullNextCycleUs <= ullNowUs)
+            {
+                ullNextCycleUs = ullNowUs + CYPHAL_NODE_CYCLE_US;
+            }
+        }
+
+        prvFlushTx();
+
+        /* The subscription table may have grown since the last wait, and
+         * the RPC sockets come with the node-ID */
+        uxCount = 0;
+        xSemaphoreTake(xNodeMutex, portMAX_DELAY);
+        for (j = 0; j < CYPHAL_NODE_IFACE_COUNT; j++)
+        {
+            if (pxRpcSockets[j] != NULL)
+            {
+                xEvents[uxCount].socket = pxRpcSockets[j];
+                xEvents[uxCount].eventMask = SOCKET_EVENT_RX_READY;
+                uxIfaces[uxCount] = j;
+                pxOwners[uxCount++] = NULL;
+            }
+        }
+
+        for (i = 0; i < CYPHAL_NODE_MAX_SUBSCRIPTIONS; i++)
+        {
+            if (xSubscriptions[i].pxSockets[0] != NULL)
+            {
+                for (j = 0; j < CYPHAL_NODE_IFACE_COUNT; j++)
+                {
+                    xEvents[uxCount].socket = xSubscriptions[i].pxSockets[j];
+                    xEvents[uxCount].eventMask = SOCKET_EVENT_RX_READY;
+                    uxIfaces[uxCount] = j;
+                    pxOwners[uxCount++] = &xSubscriptions[i];
+                }
+            }
+        }
+        xSemaphoreGive(xNodeMutex);
+
+        /* Datagrams and new frames are handled at once; otherwise wake up
+         * for the next cycle */
+        ullNowUs = ullCyphalNodeNowUs();
+        if (socketPoll(xEvents, uxCount, &xNodeEvent,
+                       (ullNextCycleUs > ullNowUs) ? (systime_t) ((ullNextCycleUs - ullNowUs + 999u) / 1000u) : 0) != NO_ERROR)
+        {
+            continue;
+        }
+
+        for (i = 0; i < uxCount; i++)
+        {
+            if ((xEvents[i].eventFlags & SOCKET_EVENT_RX_READY) != 0)
+            {
+                prvReceive(xEvents[i].socket, pxOwners[i], uxIfaces[i]);
+            }
+        }
+    }
+}
+
+static BaseType_t prvCyphalCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xCyphal =
+{
+    "cyphal",
+    "\r\ncyphal:\r\n Cyphal/UDP node status, transfer counters per interface and block pool usage\r\n",
+    prvCyphalCommand,
+    0
+};
+
+/* Node counters copied on the first line, the pool lines indexing into
+ * the copy; the launch counters of the MAC are read on their own line */
+static CyphalNodeStats_t xCyphalReport;
+static Stm32h7xxEthLaunchStats xLaunchReport;
+static UBaseType_t uxCyphalLine = 0;
+
+static const char * const pcCyphalPoolNames[CYPHAL_POOL_COUNT] = { "tx-item", "rx-datagram", "rx-session", "rx-fragment" };
+
+static BaseType_t prvCyphalCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    const CyphalPoolStats_t *pxPool;
+    const CyphalIfaceStats_t *pxIface;
+    UBaseType_t uxSubscriptions = 0;
+    UBaseType_t uxLine;
+    UBaseType_t i;
+
+    (void) pcCommandString;
+
+    if (uxCyphalLine == 0)
+    {
+        if (xNodeTask == NULL)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Cyphal node not running\r\n");
+            return pdFALSE;
+        }
+
+        vCyphalNodeGetStats(&xCyphalReport);
+    }
+
+    switch (uxCyphalLine++)
+    {
+    case 0:
+        for (i = 0; i < CYPHAL_NODE_MAX_SUBSCRIPTIONS; i++)
+        {
+            uxSubscriptions += (xSubscriptions[i].pxSockets[0] != NULL) ? 1 : 0;
+        }
+        snprintf(pcWriteBuffer, xWriteBufferLen, "node: id=%u uptime=%lu health=%u mode=%u subjects=%u/%u\r\n",
+                 (unsigned int) usLocalNodeId, (unsigned long) (ullCyphalNodeNowUs() / 1000000u),
+                 (unsigned int) ucHealth, (unsigned int) ucMode,
+                 (unsigned int) uxSubscriptions, (unsigned int) CYPHAL_NODE_MAX_SUBSCRIPTIONS);
+        return pdTRUE;
+    case 1:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "tx: frames=%lu expired=%lu err=%lu qfull=%lu\r\n",
+                 (unsigned long) xCyphalReport.ulTxFrames, (unsigned long) xCyphalReport.ulTxExpired,
+                 (unsigned long) xCyphalReport.ulTxErrors, (unsigned long) xCyphalReport.ulTxQueueFull);
+        return pdTRUE;
+    case 2:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "rx: datagrams=%lu in-place=%lu transfers=%lu dropped=%lu\r\n",
+                 (unsigned long) xCyphalReport.ulRxDatagrams, (unsigned long) xCyphalReport.ulRxInPlace,
+                 (unsigned long) xCyphalReport.ulRxTransfers, (unsigned long) xCyphalReport.ulRxDropped);
+        return pdTRUE;
+    case 3:
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "reassembly: fragments=%lu/%u truncated=%lu evicted=%lu late=%lu quota-drops=%lu\r\n",
+                 (unsigned long) xCyphalReport.ulRxFragments, (unsigned int) CYPHAL_NODE_RX_QUOTA,
+                 (unsigned long) xCyphalReport.ulRxTruncated, (unsigned long) xCyphalReport.ulRxEvicted,
+                 (unsigned long) xCyphalReport.ulRxLate, (unsigned long) xCyphalReport.ulRxQuotaDrops);
+        return pdTRUE;
+    case 4:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "crc: %s blocks=%lu bytes=%lu\r\n",
+                 xCyphalReport.xCrc.xHardware ? "hardware" : "software (self-test failed)",
+                 (unsigned long) xCyphalReport.xCrc.ulBlocks, (unsigned long) xCyphalReport.xCrc.ulBytes);
+        return pdTRUE;
+    case 5:
+        stm32h7xxEthGetLaunchStats(&xLaunchReport);
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "launch: timed=%lu untimed=%lu mac-launched=%lu mac-late=%lu mac-out-of-range=%lu\r\n",
+                 (unsigned long) xCyphalReport.ulTxTimed, (unsigned long) xCyphalReport.ulTxUntimed,
+                 (unsigned long) xLaunchReport.launched, (unsigned long) xLaunchReport.late,
+                 (unsigned long) xLaunchReport.outOfRange);
+        return pdTRUE;
+    default:
+        /* One line per interface, then one per pool */
+        uxLine = uxCyphalLine - 7;
+        if (uxLine < CYPHAL_NODE_IFACE_COUNT)
+        {
+            pxIface = &xCyphalReport.xIfaces[uxLine];
+            snprintf(pcWriteBuffer, xWriteBufferLen,
+                     "iface %s: link=%s tx=%lu link-down=%lu rx=%lu queued=%u nic-expired=%lu\r\n",
+                     netInterface[uxLine].name, netInterface[uxLine].linkState ? "up" : "down",
+                     (unsigned long) pxIface->ulTxFrames, (unsigned long) pxIface->ulTxLinkDown,
+                     (unsigned long) pxIface->ulRxDatagrams, (unsigned int) xTx[uxLine].queue_size,
+                     (unsigned long) nicGetPhysicalInterface(&netInterface[uxLine])->nicTxDeadlineDrops);
+            return pdTRUE;
+        }
+
+        uxLine -= CYPHAL_NODE_IFACE_COUNT;
+        pxPool = &xCyphalReport.xPools[uxLine];
+        snprintf(pcWriteBuffer, xWriteBufferLen, "pool %s: %ux%u used=%u peak=%u fail=%lu max-req=%u\r\n",
+                 pcCyphalPoolNames[uxLine],
+                 (unsigned int) pxPool->uxBlockCount, (unsigned int) pxPool->xBlockSize,
+                 (unsigned int) pxPool->uxUsed, (unsigned int) pxPool->uxPeak,
+                 (unsigned long) pxPool->ulFailures, (unsigned int) pxPool->xLargestRequest);
+        if (uxLine + 1 < CYPHAL_POOL_COUNT)
+        {
+            return pdTRUE;
+        }
+        uxCyphalLine = 0;
+        return pdFALSE;
+    }
+}
+
+void vCyphalNodeRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xCyphal);
+}
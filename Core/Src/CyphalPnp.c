@@ -0,0 +1,380 @@
+/* CyphalPnp.c
+ *
+ * Plug-and-play node-ID allocation, client and allocator, on the
+ * subscriptions and publications of CyphalNode.c.
+ *
+ * Both sides use the one subject of uavcan.pnp.NodeIDAllocationData.2.0:
+ * requests come from anonymous nodes, responses from the allocator. The
+ * subscription callback runs in the node task; it hands a response meant
+ * for this node over to the client task, and answers requests itself when
+ * the allocator is enabled, the publication being queued at once.
+ *
+ * The client task only lives until the node-ID is known. Its counters are
+ * written by it alone, those of the allocator by the node task alone.
+ */
+#include "CyphalPnp.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "FlashStore.h"
+#include "HwRng.h"
+#include "StaticAlloc.h"
+#include <stdio.h>
+#include <string.h>
+
+/* uavcan.pnp.NodeIDAllocationData.2.0: uavcan.node.ID.1.0 node_id, then
+ * uint8[16] unique_id */
+#define CYPHAL_PNP_SUBJECT_ID          8165
+#define CYPHAL_PNP_MESSAGE_SIZE        (2 + CYPHAL_NODE_UNIQUE_ID_SIZE)
+#define CYPHAL_PNP_EXTENT              48
+
+/* A request or response still queued after this long is dropped; the next
+ * request supersedes it anyway */
+#define CYPHAL_PNP_TIMEOUT_US          ((uint32_t) CYPHAL_PNP_REQUEST_MIN_MS * 1000u)
+
+typedef struct
+{
+    uint16_t usNodeId;
+    uint16_t usReserved;
+} CyphalPnpRecord_t;
+
+typedef struct
+{
+    uint8_t ucUniqueId[CYPHAL_NODE_UNIQUE_ID_SIZE];
+    uint16_t usNodeId;
+} CyphalPnpEntry_t;
+
+static TaskHandle_t xPnpTask = NULL;
+APP_TASK_STORAGE(xPnpTask, CYPHAL_PNP_STACK_SIZE);
+
+static uint8_t ucUniqueId[CYPHAL_NODE_UNIQUE_ID_SIZE];
+
+/* Node-ID granted to this node, set by the node task for the client task */
+static volatile UdpardNodeID usGranted = UDPARD_NODE_ID_UNSET;
+
+static UdpardTransferID xRequestTransferId = 0;
+
+#if (CYPHAL_PNP_ALLOCATOR == 1)
+/* Only accessed by the node task, once the table is loaded */
+static CyphalPnpEntry_t xEntries[CYPHAL_PNP_ALLOCATOR_ENTRIES];
+static UBaseType_t uxEntryCount = 0;
+static UdpardTransferID xResponseTransferId = 0;
+#endif
+
+static CyphalPnpStats_t xStats;
+
+static void prvPutMessage(uint8_t *pucOut, UdpardNodeID usNodeId, const uint8_t *pucUniqueId)
+{
+    pucOut[0] = (uint8_t) usNodeId;
+    pucOut[1] = (uint8_t) (usNodeId >> 8);
+    memcpy(&pucOut[2], pucUniqueId, CYPHAL_NODE_UNIQUE_ID_SIZE);
+}
+
+#if (CYPHAL_PNP_ALLOCATOR == 1)
+
+static BaseType_t prvNodeIdTaken(UdpardNodeID usNodeId)
+{
+    UBaseType_t i;
+
+    if (usNodeId == usCyphalNodeGetNodeId())
+    {
+        return pdTRUE;
+    }
+
+    for (i = 0; i < uxEntryCount; i++)
+    {
+        if (xEntries[i].usNodeId == usNodeId)
+        {
+            return pdTRUE;
+        }
+    }
+
+    return pdFALSE;
+}
+
+/* The node-ID asked for if it is free and in range, else the first free
+ * one above it, else the first free one below */
+static UdpardNodeID prvChooseNodeId(UdpardNodeID usPreferred)
+{
+    UdpardNodeID usNodeId;
+
+    if (usPreferred < CYPHAL_PNP_ALLOCATOR_FIRST_ID || usPreferred > CYPHAL_PNP_ALLOCATOR_LAST_ID)
+    {
+        usPreferred = CYPHAL_PNP_ALLOCATOR_LAST_ID;
+    }
+
+    for (usNodeId = usPreferred; usNodeId <= CYPHAL_PNP_ALLOCATOR_LAST_ID; usNodeId++)
+    {
+        if (!prvNodeIdTaken(usNodeId))
+        {
+            return usNodeId;
+        }
+    }
+
+    for (usNodeId = usPreferred; usNodeId > CYPHAL_PNP_ALLOCATOR_FIRST_ID; usNodeId--)
+    {
+        if (!prvNodeIdTaken(usNodeId - 1))
+        {
+            return usNodeId - 1;
+        }
+    }
+
+    return UDPARD_NODE_ID_UNSET;
+}
+
+/* Answer a request; a new entry is saved, the write queued only as this
+ * runs in the node task */
+static void prvAllocate(UdpardNodeID usPreferred, const uint8_t *pucUniqueId)
+{
+    uint8_t ucMessage[CYPHAL_PNP_MESSAGE_SIZE];
+    UdpardNodeID usNodeId = UDPARD_NODE_ID_UNSET;
+    UBaseType_t i;
+
+    /* An allocator needs a node-ID of its own to answer */
+    if (usCyphalNodeGetNodeId() == UDPARD_NODE_ID_UNSET)
+    {
+        return;
+    }
+
+    for (i = 0; i < uxEntryCount; i++)
+    {
+        if (memcmp(xEntries[i].ucUniqueId, pucUniqueId, CYPHAL_NODE_UNIQUE_ID_SIZE) == 0)
+        {
+            usNodeId = xEntries[i].usNodeId;
+            break;
+        }
+    }
+
+    if (usNodeId == UDPARD_NODE_ID_UNSET)
+    {
+        usNodeId = (uxEntryCount < CYPHAL_PNP_ALLOCATOR_ENTRIES) ? prvChooseNodeId(usPreferred) : UDPARD_NODE_ID_UNSET;
+        if (usNodeId == UDPARD_NODE_ID_UNSET)
+        {
+            xStats.ulExhausted++;
+            return;
+        }
+
+        memcpy(xEntries[uxEntryCount].ucUniqueId, pucUniqueId, CYPHAL_NODE_UNIQUE_ID_SIZE);
+        xEntries[uxEntryCount].usNodeId = usNodeId;
+        uxEntryCount++;
+        xStats.ulNewEntries++;
+        xStats.ulEntries = uxEntryCount;
+
+        (void) xFlashStoreWrite(FLASH_STORE_KEY_CYPHAL_PNP_TABLE, xEntries, uxEntryCount * sizeof(xEntries[0]),
+                                NULL, NULL, 0);
+    }
+
+    prvPutMessage(ucMessage, usNodeId, pucUniqueId);
+    if (xCyphalNodePublish(CYPHAL_PNP_SUBJECT_ID, UdpardPriorityNominal, &xResponseTransferId,
+                           ucMessage, sizeof(ucMessage), CYPHAL_PNP_TIMEOUT_US) == pdPASS)
+    {
+        xStats.ulGranted++;
+    }
+}
+
+static void prvLoadTable(void)
+{
+    size_t xLength = 0;
+
+    if (xFlashStoreRead(FLASH_STORE_KEY_CYPHAL_PNP_TABLE, xEntries, sizeof(xEntries), &xLength) != pdPASS ||
+        xLength > sizeof(xEntries) || (xLength % sizeof(xEntries[0])) != 0)
+    {
+        xLength = 0;
+    }
+
+    uxEntryCount = xLength / sizeof(xEntries[0]);
+    xStats.ulEntries = uxEntryCount;
+}
+
+#endif /* CYPHAL_PNP_ALLOCATOR */
+
+/* Allocation messages, in the node task: requests come from anonymous
+ * nodes, responses from an allocator */
+static void prvReceived(const struct UdpardRxTransfer *pxTransfer, void *pvParam)
+{
+    uint8_t ucMessage[CYPHAL_PNP_MESSAGE_SIZE];
+    UdpardNodeID usNodeId;
+
+    (void) pvParam;
+
+    if (udpardGather(pxTransfer->payload, sizeof(ucMessage), ucMessage) < sizeof(ucMessage))
+    {
+        return;
+    }
+    usNodeId = (UdpardNodeID) (ucMessage[0] | (ucMessage[1] << 8));
+
+    if (pxTransfer->source_node_id == UDPARD_NODE_ID_UNSET)
+    {
+#if (CYPHAL_PNP_ALLOCATOR == 1)
+        prvAllocate(usNodeId, &ucMessage[2]);
+#endif
+        return;
+    }
+
+    if (usNodeId <= UDPARD_NODE_ID_MAX && usGranted == UDPARD_NODE_ID_UNSET && xPnpTask != NULL &&
+        memcmp(&ucMessage[2], ucUniqueId, CYPHAL_NODE_UNIQUE_ID_SIZE) == 0)
+    {
+        usGranted = usNodeId;
+        xTaskNotifyGive(xPnpTask);
+    }
+}
+
+/* Random delay between ulMinMs and ulMaxMs */
+static TickType_t prvRandomDelay(uint32_t ulMinMs, uint32_t ulMaxMs)
+{
+    return pdMS_TO_TICKS(ulMinMs + ulHwRngGet() % (ulMaxMs - ulMinMs + 1u));
+}
+
+static void prvPnpTask(void *pvParameters)
+{
+    uint8_t ucMessage[CYPHAL_PNP_MESSAGE_SIZE];
+    CyphalPnpRecord_t xRecord;
+    UdpardNodeID usPreferred;
+    TickType_t xStart = xTaskGetTickCount();
+    TickType_t xWait;
+    BaseType_t xResult;
+
+    (void) pvParameters;
+
+    /* With a cached node-ID, ask for it at once: the allocator knows this
+     * node already. Otherwise wait a random time first, as all the nodes
+     * of the machine are likely starting too */
+    if (xStats.usCachedNodeId != UDPARD_NODE_ID_UNSET)
+    {
+        usPreferred = xStats.usCachedNodeId;
+        xWait = prvRandomDelay(0, CYPHAL_PNP_FAST_JOIN_JITTER_MS);
+    }
+    else
+    {
+        usPreferred = (CYPHAL_NODE_ID <= UDPARD_NODE_ID_MAX) ? CYPHAL_NODE_ID : UDPARD_NODE_ID_MAX;
+        xWait = prvRandomDelay(CYPHAL_PNP_REQUEST_MIN_MS, CYPHAL_PNP_REQUEST_MAX_MS);
+    }
+
+    while (usGranted == UDPARD_NODE_ID_UNSET)
+    {
+        (void) ulTaskNotifyTake(pdTRUE, xWait);
+        if (usGranted != UDPARD_NODE_ID_UNSET)
+        {
+            break;
+        }
+
+        /* Anonymous, hence a single frame */
+        prvPutMessage(ucMessage, usPreferred, ucUniqueId);
+        if (xCyphalNodePublish(CYPHAL_PNP_SUBJECT_ID, UdpardPriorityNominal, &xRequestTransferId,
+                               ucMessage, sizeof(ucMessage), CYPHAL_PNP_TIMEOUT_US) == pdPASS)
+        {
+            xStats.ulRequests++;
+        }
+
+        xWait = prvRandomDelay(CYPHAL_PNP_REQUEST_MIN_MS, CYPHAL_PNP_REQUEST_MAX_MS);
+    }
+
+    xResult = xCyphalNodeSetNodeId(usGranted);
+    configASSERT(xResult == pdPASS);
+    xStats.ulJoinMs = (uint32_t) ((xTaskGetTickCount() - xStart) * portTICK_PERIOD_MS);
+    if (xStats.ulJoinMs == 0)
+    {
+        xStats.ulJoinMs = 1;
+    }
+
+    /* Spare the flash when the allocator gave the same node-ID again */
+    if (usGranted != xStats.usCachedNodeId)
+    {
+        memset(&xRecord, 0, sizeof(xRecord));
+        xRecord.usNodeId = usGranted;
+        (void) xFlashStoreWrite(FLASH_STORE_KEY_CYPHAL_NODE_ID, &xRecord, sizeof(xRecord),
+                                NULL, NULL, portMAX_DELAY);
+    }
+
+    vTaskDelete(NULL);
+}
+
+BaseType_t xCyphalPnpStart(UBaseType_t uxPriority)
+{
+    CyphalPnpRecord_t xRecord;
+    size_t xLength = 0;
+
+    vCyphalNodeGetUniqueId(ucUniqueId);
+
+    xStats.usCachedNodeId = UDPARD_NODE_ID_UNSET;
+    if (xFlashStoreRead(FLASH_STORE_KEY_CYPHAL_NODE_ID, &xRecord, sizeof(xRecord), &xLength) == pdPASS &&
+        xLength == sizeof(xRecord) && xRecord.usNodeId <= UDPARD_NODE_ID_MAX)
+    {
+        xStats.usCachedNodeId = xRecord.usNodeId;
+    }
+
+#if (CYPHAL_PNP_ALLOCATOR == 1)
+    prvLoadTable();
+#endif
+
+    if (xCyphalNodeSubscribe(CYPHAL_PNP_SUBJECT_ID, CYPHAL_PNP_EXTENT, prvReceived, NULL) != pdPASS)
+    {
+        return pdFAIL;
+    }
+
+    if (usCyphalNodeGetNodeId() != UDPARD_NODE_ID_UNSET)
+    {
+        return pdPASS;
+    }
+
+    return xAppTaskCreate(xPnpTask, prvPnpTask, "CyphalPnp", CYPHAL_PNP_STACK_SIZE, NULL, uxPriority, &xPnpTask);
+}
+
+void vCyphalPnpGetStats(CyphalPnpStats_t *pxStats)
+{
+    *pxStats = xStats;
+}
+
+static BaseType_t prvCyphalPnpCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xCyphalPnp =
+{
+    "cyphalpnp",
+    "\r\ncyphalpnp:\r\n Cyphal plug-and-play node-ID allocation state and allocator counters\r\n",
+    prvCyphalPnpCommand,
+    0
+};
+
+static UBaseType_t uxPnpLine = 0;
+
+static BaseType_t prvCyphalPnpCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    CyphalPnpStats_t xReport;
+    UdpardNodeID usNodeId = usCyphalNodeGetNodeId();
+
+    (void) pcCommandString;
+
+    vCyphalPnpGetStats(&xReport);
+
+    if (uxPnpLine++ == 0)
+    {
+        if (usNodeId == UDPARD_NODE_ID_UNSET)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "node-id: anonymous cached=%u requests=%lu\r\n",
+                     (unsigned int) xReport.usCachedNodeId, (unsigned long) xReport.ulRequests);
+        }
+        else
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "node-id: %u cached=%u requests=%lu join=%lums\r\n",
+                     (unsigned int) usNodeId, (unsigned int) xReport.usCachedNodeId,
+                     (unsigned long) xReport.ulRequests, (unsigned long) xReport.ulJoinMs);
+        }
+        return pdTRUE;
+    }
+
+    uxPnpLine = 0;
+#if (CYPHAL_PNP_ALLOCATOR == 1)
+    snprintf(pcWriteBuffer, xWriteBufferLen, "allocator: ids=%u-%u entries=%lu/%u granted=%lu new=%lu exhausted=%lu\r\n",
+             (unsigned int) CYPHAL_PNP_ALLOCATOR_FIRST_ID, (unsigned int) CYPHAL_PNP_ALLOCATOR_LAST_ID,
+             (unsigned long) xReport.ulEntries, (unsigned int) CYPHAL_PNP_ALLOCATOR_ENTRIES,
+             (unsigned long) xReport.ulGranted, (unsigned long) xReport.ulNewEntries,
+             (unsigned long) xReport.ulExhausted);
+#else
+    snprintf(pcWriteBuffer, xWriteBufferLen, "allocator: disabled\r\n");
+#endif
+    return pdFALSE;
+}
+
+void vCyphalPnpRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xCyphalPnp);
+}
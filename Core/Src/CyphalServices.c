@@ -0,0 +1,900 @@
+/* CyphalServices.c
+ *
+ * RPC service servers on the dispatcher of the Cyphal node.
+ *
+ * Each served service takes a port of the node (xCyphalNodeListen), whose
+ * callback runs in the node task: the response is either a cached one,
+ * passed to libudpard as is, or serialized by the handler into a buffer of
+ * this module. Handlers run one at a time in the node task and the node
+ * copies the response into its TX items before returning, so a single
+ * buffer serves them all; no response is allocated.
+ *
+ * GetInfo never changes, hence is serialized once, at start, and served as
+ * a cached response. The uavcan.node.port.List message is kept serialized
+ * too and only rebuilt when a port is added, then published from the cycle
+ * hook of the node.
+ *
+ * Registers are listed in an index sorted by name, built as they are
+ * added: Access finds a name by binary search, and List returns the
+ * registers in the order of their names, which stays the same as long as
+ * none is added, as the specification asks.
+ *
+ * Tables and counters are guarded by xServicesMutex. Handlers and the
+ * change callbacks of the registers run without it.
+ */
+#include "CyphalServices.h"
+#include "semphr.h"
+#include "FreeRTOS_CLI.h"
+#include "StaticAlloc.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Fixed port-IDs of the standard data types */
+#define CYPHAL_GETINFO_SERVICE_ID          430
+#define CYPHAL_REGISTER_ACCESS_SERVICE_ID  384
+#define CYPHAL_REGISTER_LIST_SERVICE_ID    385
+#define CYPHAL_HEARTBEAT_SUBJECT_ID        7509
+#define CYPHAL_PORT_LIST_SUBJECT_ID        7510
+
+/* Serialized request sizes: uavcan.register.Access.1.0 takes a Name (up to
+ * 256 bytes) and a Value (up to 259), List a uint16 index */
+#define CYPHAL_REGISTER_NAME_MAX           255
+#define CYPHAL_REGISTER_ACCESS_REQ_SIZE    515
+#define CYPHAL_REGISTER_LIST_REQ_SIZE      2
+
+/* Access response: uint56 timestamp, then the mutable and persistent bits */
+#define CYPHAL_ACCESS_HEADER_SIZE          8
+
+/* GetInfo response, up to 313 bytes with the longest name */
+#define CYPHAL_GETINFO_SIZE                (6 + 8 + CYPHAL_NODE_UNIQUE_ID_SIZE + 1 + sizeof(CYPHAL_SERVICES_NODE_NAME) - 1 + 1 + 1)
+
+/* Port list: two SubjectIDList.0.1 as sparse lists (delimiter header,
+ * union tag, length and a uint16 per subject) and two ServiceIDList.0.1
+ * masks of 512 bits (delimiter header and the mask) */
+#define CYPHAL_PORT_LIST_MAX_SUBJECTS      (CYPHAL_SERVICES_MAX_PORTS + 2)
+#define CYPHAL_SUBJECT_LIST_SIZE           (4 + 1 + 1 + 2 * CYPHAL_PORT_LIST_MAX_SUBJECTS)
+#define CYPHAL_SERVICE_MASK_BYTES          ((UDPARD_SERVICE_ID_MAX + 1) / 8)
+#define CYPHAL_PORT_LIST_SIZE              (2 * CYPHAL_SUBJECT_LIST_SIZE + 2 * (4 + CYPHAL_SERVICE_MASK_BYTES))
+#define CYPHAL_SPARSE_LIST_TAG             1
+
+typedef struct
+{
+    UdpardPortID usServiceId;
+    BaseType_t xUsed;
+    CyphalServiceHandler_t pxHandler;
+    void *pvParam;
+    const uint8_t *pucCached;           /* NULL while the handler answers */
+    size_t xCachedLength;
+} CyphalHandler_t;
+
+/* Sorted index entry; the length saves a strlen() per comparison */
+typedef struct
+{
+    const CyphalRegister_t *pxRegister;
+    uint8_t ucNameLength;
+} CyphalRegisterEntry_t;
+
+typedef struct
+{
+    uint8_t ucKind;
+    UdpardPortID usPortId;
+} CyphalPort_t;
+
+static SemaphoreHandle_t xServicesMutex = NULL;
+APP_MUTEX_STORAGE(xServicesMutex);
+
+static CyphalHandler_t xHandlers[CYPHAL_SERVICES_MAX_HANDLERS];
+
+static CyphalRegisterEntry_t xRegisters[CYPHAL_SERVICES_MAX_REGISTERS];
+static UBaseType_t uxRegisterCount = 0;
+
+static CyphalPort_t xPorts[CYPHAL_SERVICES_MAX_PORTS];
+static UBaseType_t uxPortCount = 0;
+
+static uint8_t ucPortList[CYPHAL_PORT_LIST_SIZE];
+static size_t xPortListLength = 0;
+static BaseType_t xPortListStale = pdTRUE;
+static UdpardMicrosecond ullNextPortListUs = 0;
+static UdpardTransferID xPortListTransferId = 0;
+
+static uint8_t ucGetInfo[CYPHAL_GETINFO_SIZE];
+
+/* Only accessed by the node task */
+static uint8_t ucRequest[CYPHAL_REGISTER_ACCESS_REQ_SIZE];
+static uint8_t ucResponse[CYPHAL_SERVICES_RESPONSE_SIZE];
+
+static CyphalServicesStats_t xStats;
+
+static void prvPutU16(uint8_t *pucOut, uint16_t usValue)
+{
+    pucOut[0] = (uint8_t) usValue;
+    pucOut[1] = (uint8_t) (usValue >> 8);
+}
+
+static void prvPutU32(uint8_t *pucOut, uint32_t ulValue)
+{
+    pucOut[0] = (uint8_t) ulValue;
+    pucOut[1] = (uint8_t) (ulValue >> 8);
+    pucOut[2] = (uint8_t) (ulValue >> 16);
+    pucOut[3] = (uint8_t) (ulValue >> 24);
+}
+
+static CyphalHandler_t *prvFindHandler(UdpardPortID usServiceId)
+{
+    UBaseType_t i;
+
+    for (i = 0; i < CYPHAL_SERVICES_MAX_HANDLERS; i++)
+    {
+        if (xHandlers[i].xUsed && xHandlers[i].usServiceId == usServiceId)
+        {
+            return &xHandlers[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Callback of every served port, in the node task */
+static void prvServe(const struct UdpardRxRPCTransfer *pxTransfer, void *pvParam)
+{
+    CyphalHandler_t *pxHandler = (CyphalHandler_t *) pvParam;
+    CyphalServiceHandler_t pxFunction;
+    const uint8_t *pucData;
+    size_t xLength;
+    void *pvHandlerParam;
+    BaseType_t xResult;
+
+    xSemaphoreTake(xServicesMutex, portMAX_DELAY);
+    xStats.ulRequests++;
+    pucData = pxHandler->pucCached;
+    xLength = pxHandler->xCachedLength;
+    pxFunction = pxHandler->pxHandler;
+    pvHandlerParam = pxHandler->pvParam;
+    if (pucData != NULL)
+    {
+        xStats.ulCached++;
+    }
+    xSemaphoreGive(xServicesMutex);
+
+    if (pucData == NULL)
+    {
+        xLength = pxFunction(pxTransfer, ucResponse, sizeof(ucResponse), pvHandlerParam);
+        pucData = ucResponse;
+    }
+
+    if (xLength == CYPHAL_SERVICE_NO_RESPONSE)
+    {
+        xResult = pdPASS;
+    }
+    else
+    {
+        xResult = xCyphalNodeRespond(pxTransfer, pucData, xLength, CYPHAL_SERVICES_RESPONSE_TIMEOUT_US);
+    }
+
+    xSemaphoreTake(xServicesMutex, portMAX_DELAY);
+    if (xLength == CYPHAL_SERVICE_NO_RESPONSE)
+    {
+        xStats.ulNoResponse++;
+    }
+    else if (xResult != pdPASS)
+    {
+        xStats.ulRespondErrors++;
+    }
+    xSemaphoreGive(xServicesMutex);
+}
+
+BaseType_t xCyphalServicesAdd(UdpardPortID usServiceId, size_t xExtent,
+                              CyphalServiceHandler_t pxHandler, void *pvParam)
+{
+    CyphalHandler_t *pxSlot = NULL;
+    UBaseType_t i;
+
+    if (xServicesMutex == NULL || pxHandler == NULL || usServiceId > UDPARD_SERVICE_ID_MAX)
+    {
+        return pdFAIL;
+    }
+
+    xSemaphoreTake(xServicesMutex, portMAX_DELAY);
+
+    if (prvFindHandler(usServiceId) == NULL)
+    {
+        for (i = 0; i < CYPHAL_SERVICES_MAX_HANDLERS; i++)
+        {
+            if (!xHandlers[i].xUsed)
+            {
+                pxSlot = &xHandlers[i];
+                break;
+            }
+        }
+    }
+
+    if (pxSlot != NULL)
+    {
+        pxSlot->usServiceId = usServiceId;
+        pxSlot->pxHandler = pxHandler;
+        pxSlot->pvParam = pvParam;
+        pxSlot->pucCached = NULL;
+        pxSlot->xCachedLength = 0;
+
+        /* The slot is taken before the port, whose callback may run at once */
+        pxSlot->xUsed = pdTRUE;
+        if (xCyphalNodeListen(usServiceId, pdTRUE, xExtent, prvServe, pxSlot) != pdPASS)
+        {
+            pxSlot->xUsed = pdFALSE;
+            pxSlot = NULL;
+        }
+        else
+        {
+            xPortListStale = pdTRUE;
+        }
+    }
+
+    xSemaphoreGive(xServicesMutex);
+    return (pxSlot != NULL) ? pdPASS : pdFAIL;
+}
+
+BaseType_t xCyphalServicesSetCachedResponse(UdpardPortID usServiceId, const void *pvResponse, size_t xLength)
+{
+    CyphalHandler_t *pxHandler;
+
+    if (xServicesMutex == NULL)
+    {
+        return pdFAIL;
+    }
+
+    xSemaphoreTake(xServicesMutex, portMAX_DELAY);
+    pxHandler = prvFindHandler(usServiceId);
+    if (pxHandler != NULL)
+    {
+        pxHandler->pucCached = (const uint8_t *) pvResponse;
+        pxHandler->xCachedLength = (pvResponse != NULL) ? xLength : 0;
+    }
+    xSemaphoreGive(xServicesMutex);
+
+    return (pxHandler != NULL) ? pdPASS : pdFAIL;
+}
+
+/* -------------------------------------------------------------------------
+ * Registers
+ * ---------------------------------------------------------------------- */
+
+/* Size of an element of a value of type ucType */
+static size_t prvElementSize(uint8_t ucType)
+{
+    switch (ucType)
+    {
+    case CYPHAL_REGISTER_INTEGER64:
+    case CYPHAL_REGISTER_NATURAL64:
+    case CYPHAL_REGISTER_REAL64:
+        return 8;
+    case CYPHAL_REGISTER_INTEGER32:
+    case CYPHAL_REGISTER_NATURAL32:
+    case CYPHAL_REGISTER_REAL32:
+        return 4;
+    case CYPHAL_REGISTER_INTEGER16:
+    case CYPHAL_REGISTER_NATURAL16:
+        return 2;
+    case CYPHAL_REGISTER_STRING:
+    case CYPHAL_REGISTER_UNSTRUCTURED:
+    case CYPHAL_REGISTER_INTEGER8:
+    case CYPHAL_REGISTER_NATURAL8:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Capacity of the array of a value, 2048 bits at most (256 bytes); above
+ * 255 elements its length is serialized on 16 bits */
+static size_t prvCapacity(uint8_t ucType)
+{
+    size_t xElement = prvElementSize(ucType);
+
+    return (xElement != 0) ? 256u / xElement : 0;
+}
+
+static size_t prvLengthPrefix(uint8_t ucType)
+{
+    return (prvCapacity(ucType) > 255u) ? 2u : 1u;
+}
+
+/* Elements the value of a register holds at present */
+static size_t prvValueCount(const CyphalRegister_t *pxRegister)
+{
+    if (pxRegister->ucType == CYPHAL_REGISTER_STRING)
+    {
+        return strnlen((const char *) pxRegister->pvValue, pxRegister->usCount);
+    }
+
+    return pxRegister->usCount;
+}
+
+/* Serialize a uavcan.register.Value.1.0; pxRegister NULL gives the empty
+ * value. Elements are little endian on the wire as in memory */
+static size_t prvPutValue(uint8_t *pucOut, const CyphalRegister_t *pxRegister)
+{
+    size_t xCount;
+    size_t xPrefix;
+
+    if (pxRegister == NULL)
+    {
+        pucOut[0] = 0;
+        return 1;
+    }
+
+    xCount = prvValueCount(pxRegister);
+    xPrefix = prvLengthPrefix(pxRegister->ucType);
+
+    pucOut[0] = pxRegister->ucType;
+    if (xPrefix == 2)
+    {
+        prvPutU16(&pucOut[1], (uint16_t) xCount);
+    }
+    else
+    {
+        pucOut[1] = (uint8_t) xCount;
+    }
+    memcpy(&pucOut[1 + xPrefix], pxRegister->pvValue, xCount * prvElementSize(pxRegister->ucType));
+
+    return 1 + xPrefix + xCount * prvElementSize(pxRegister->ucType);
+}
+
+/* Compare a name of the wire with the name of an index entry */
+static int prvCompareName(const uint8_t *pucName, size_t xLength, const CyphalRegisterEntry_t *pxEntry)
+{
+    size_t xCommon = (xLength < pxEntry->ucNameLength) ? xLength : pxEntry->ucNameLength;
+    int iResult = memcmp(pucName, pxEntry->pxRegister->pcName, xCommon);
+
+    if (iResult != 0)
+    {
+        return iResult;
+    }
+
+    return (xLength > pxEntry->ucNameLength) ? 1 : (xLength < pxEntry->ucNameLength) ? -1 : 0;
+}
+
+/* Binary search of the index: the position of the name, or where it would
+ * go if *pxFound comes back pdFALSE */
+static UBaseType_t prvSearchRegister(const uint8_t *pucName, size_t xLength, BaseType_t *pxFound)
+{
+    UBaseType_t uxLow = 0;
+    UBaseType_t uxHigh = uxRegisterCount;
+    UBaseType_t uxMiddle;
+    int iResult;
+
+    while (uxLow < uxHigh)
+    {
+        uxMiddle = (uxLow + uxHigh) / 2;
+        iResult = prvCompareName(pucName, xLength, &xRegisters[uxMiddle]);
+        if (iResult == 0)
+        {
+            *pxFound = pdTRUE;
+            return uxMiddle;
+        }
+
+        if (iResult < 0)
+        {
+            uxHigh = uxMiddle;
+        }
+        else
+        {
+            uxLow = uxMiddle + 1;
+        }
+    }
+
+    *pxFound = pdFALSE;
+    return uxLow;
+}
+
+BaseType_t xCyphalServicesAddRegister(const CyphalRegister_t *pxRegister)
+{
+    BaseType_t xFound = pdFALSE;
+    UBaseType_t uxPosition;
+    size_t xLength;
+
+    if (xServicesMutex == NULL || pxRegister == NULL || pxRegister->pcName == NULL ||
+        pxRegister->pvValue == NULL || pxRegister->usCount == 0 ||
+        pxRegister->usCount > prvCapacity(pxRegister->ucType))
+    {
+        return pdFAIL;
+    }
+
+    xLength = strlen(pxRegister->pcName);
+    if (xLength == 0 || xLength > CYPHAL_REGISTER_NAME_MAX)
+    {
+        return pdFAIL;
+    }
+
+    xSemaphoreTake(xServicesMutex, portMAX_DELAY);
+
+    uxPosition = prvSearchRegister((const uint8_t *) pxRegister->pcName, xLength, &xFound);
+    if (xFound || uxRegisterCount == CYPHAL_SERVICES_MAX_REGISTERS)
+    {
+        xSemaphoreGive(xServicesMutex);
+        return pdFAIL;
+    }
+
+    memmove(&xRegisters[uxPosition + 1], &xRegisters[uxPosition],
+            (uxRegisterCount - uxPosition) * sizeof(xRegisters[0]));
+    xRegisters[uxPosition].pxRegister = pxRegister;
+    xRegisters[uxPosition].ucNameLength = (uint8_t) xLength;
+    uxRegisterCount++;
+
+    xSemaphoreGive(xServicesMutex);
+    return pdPASS;
+}
+
+const CyphalRegister_t *pxCyphalServicesFindRegister(const char *pcName)
+{
+    const CyphalRegister_t *pxRegister = NULL;
+    BaseType_t xFound = pdFALSE;
+    UBaseType_t uxPosition;
+
+    if (xServicesMutex == NULL || pcName == NULL)
+    {
+        return NULL;
+    }
+
+    xSemaphoreTake(xServicesMutex, portMAX_DELAY);
+    uxPosition = prvSearchRegister((const uint8_t *) pcName, strlen(pcName), &xFound);
+    if (xFound)
+    {
+        pxRegister = xRegisters[uxPosition].pxRegister;
+    }
+    xSemaphoreGive(xServicesMutex);
+
+    return pxRegister;
+}
+
+/* Store the value of an Access request if the register takes it: mutable,
+ * of the same type, and of the same size but for strings, which may be
+ * shorter. Returns pdTRUE if the register changed */
+static BaseType_t prvWriteValue(const CyphalRegister_t *pxRegister, const uint8_t *pucValue, size_t xSize)
+{
+    size_t xPrefix;
+    size_t xCount;
+    size_t xElement;
+
+    xElement = prvElementSize(pucValue[0]);
+    if (pucValue[0] != pxRegister->ucType || xElement == 0)
+    {
+        return pdFALSE;
+    }
+
+    xPrefix = prvLengthPrefix(pucValue[0]);
+    if (xSize < 1 + xPrefix)
+    {
+        return pdFALSE;
+    }
+    xCount = (xPrefix == 2) ? (size_t) (pucValue[1] | (pucValue[2] << 8)) : pucValue[1];
+
+    if (xSize < 1 + xPrefix + xCount * xElement ||
+        (pxRegister->ucFlags & CYPHAL_REGISTER_MUTABLE) == 0 ||
+        xCount > pxRegister->usCount ||
+        (xCount < pxRegister->usCount && pxRegister->ucType != CYPHAL_REGISTER_STRING))
+    {
+        return pdFALSE;
+    }
+
+    memcpy(pxRegister->pvValue, &pucValue[1 + xPrefix], xCount * xElement);
+    if (xCount < pxRegister->usCount)
+    {
+        ((char *) pxRegister->pvValue)[xCount] = '\0';
+    }
+
+    return pdTRUE;
+}
+
+/* uavcan.register.Access.1.0: write the value if one is given and the
+ * register takes it, then return the value in any case. An unknown name
+ * gets the empty value */
+static size_t prvAccess(const struct UdpardRxRPCTransfer *pxRequest, uint8_t *pucOut, size_t xCapacity, void *pvParam)
+{
+    const CyphalRegister_t *pxRegister = NULL;
+    BaseType_t xFound = pdFALSE;
+    BaseType_t xChanged = pdFALSE;
+    UBaseType_t uxPosition;
+    size_t xSize;
+    size_t xNameLength;
+    size_t xLength;
+
+    (void) pvParam;
+    (void) xCapacity;
+
+    xSize = udpardGather(pxRequest->base.payload, sizeof(ucRequest), ucRequest);
+    xNameLength = (xSize > 0) ? ucRequest[0] : 0;
+    if (xSize < 1 + xNameLength)
+    {
+        return CYPHAL_SERVICE_NO_RESPONSE;
+    }
+
+    xSemaphoreTake(xServicesMutex, portMAX_DELAY);
+
+    uxPosition = prvSearchRegister(&ucRequest[1], xNameLength, &xFound);
+    if (xFound)
+    {
+        pxRegister = xRegisters[uxPosition].pxRegister;
+
+        /* The empty value, or none at all, reads the register */
+        if (xSize > 1 + xNameLength && ucRequest[1 + xNameLength] != 0)
+        {
+            xChanged = prvWriteValue(pxRegister, &ucRequest[1 + xNameLength], xSize - 1 - xNameLength);
+            if (xChanged)
+            {
+                xStats.ulRegisterWrites++;
+            }
+            else
+            {
+                xStats.ulRegisterRejects++;
+            }
+        }
+        else
+        {
+            xStats.ulRegisterReads++;
+        }
+    }
+    else
+    {
+        xStats.ulRegisterUnknown++;
+    }
+
+    /* Timestamp unknown (zero): the value is not sampled */
+    memset(pucOut, 0, CYPHAL_ACCESS_HEADER_SIZE);
+    if (pxRegister != NULL)
+    {
+        pucOut[7] = (uint8_t) (((pxRegister->ucFlags & CYPHAL_REGISTER_MUTABLE) ? 0x01u : 0) |
+                               ((pxRegister->ucFlags & CYPHAL_REGISTER_PERSISTENT) ? 0x02u : 0));
+    }
+    xLength = CYPHAL_ACCESS_HEADER_SIZE + prvPutValue(&pucOut[CYPHAL_ACCESS_HEADER_SIZE], pxRegister);
+
+    xSemaphoreGive(xServicesMutex);
+
+    if (xChanged && pxRegister->pxChanged != NULL)
+    {
+        pxRegister->pxChanged(pxRegister);
+    }
+
+    return xLength;
+}
+
+/* uavcan.register.List.1.0: the name at an index of the sorted index, the
+ * empty name past the end */
+static size_t prvList(const struct UdpardRxRPCTransfer *pxRequest, uint8_t *pucOut, size_t xCapacity, void *pvParam)
+{
+    uint8_t ucIndex[CYPHAL_REGISTER_LIST_REQ_SIZE] = { 0 };
+    UBaseType_t uxIndex;
+    size_t xLength = 0;
+
+    (void) pvParam;
+    (void) xCapacity;
+
+    if (udpardGather(pxRequest->base.payload, sizeof(ucIndex), ucIndex) < sizeof(ucIndex))
+    {
+        return CYPHAL_SERVICE_NO_RESPONSE;
+    }
+    uxIndex = (UBaseType_t) (ucIndex[0] | (ucIndex[1] << 8));
+
+    xSemaphoreTake(xServicesMutex, portMAX_DELAY);
+    if (uxIndex < uxRegisterCount)
+    {
+        xLength = xRegisters[uxIndex].ucNameLength;
+        memcpy(&pucOut[1], xRegisters[uxIndex].pxRegister->pcName, xLength);
+    }
+    xSemaphoreGive(xServicesMutex);
+
+    pucOut[0] = (uint8_t) xLength;
+    return 1 + xLength;
+}
+
+/* -------------------------------------------------------------------------
+ * GetInfo and port list
+ * ---------------------------------------------------------------------- */
+
+/* uavcan.node.GetInfo.1.0 response: protocol, hardware and software
+ * versions, VCS revision, unique-ID, name, and empty image CRC and
+ * certificate */
+static void prvBuildGetInfo(void)
+{
+    uint8_t *pucOut = ucGetInfo;
+
+    *pucOut++ = 1;
+    *pucOut++ = 0;
+    *pucOut++ = CYPHAL_SERVICES_HW_VERSION_MAJOR;
+    *pucOut++ = CYPHAL_SERVICES_HW_VERSION_MINOR;
+    *pucOut++ = CYPHAL_SERVICES_SW_VERSION_MAJOR;
+    *pucOut++ = CYPHAL_SERVICES_SW_VERSION_MINOR;
+    memset(pucOut, 0, 8);
+    pucOut += 8;
+
+    vCyphalNodeGetUniqueId(pucOut);
+    pucOut += CYPHAL_NODE_UNIQUE_ID_SIZE;
+
+    *pucOut++ = (uint8_t) (sizeof(CYPHAL_SERVICES_NODE_NAME) - 1);
+    memcpy(pucOut, CYPHAL_SERVICES_NODE_NAME, sizeof(CYPHAL_SERVICES_NODE_NAME) - 1);
+    pucOut += sizeof(CYPHAL_SERVICES_NODE_NAME) - 1;
+
+    *pucOut++ = 0;
+    *pucOut++ = 0;
+
+    configASSERT((size_t) (pucOut - ucGetInfo) == sizeof(ucGetInfo));
+}
+
+/* Only called until the cached response is set, right after the service */
+static size_t prvGetInfo(const struct UdpardRxRPCTransfer *pxRequest, uint8_t *pucOut, size_t xCapacity, void *pvParam)
+{
+    (void) pxRequest;
+    (void) pvParam;
+
+    if (sizeof(ucGetInfo) > xCapacity)
+    {
+        return CYPHAL_SERVICE_NO_RESPONSE;
+    }
+    memcpy(pucOut, ucGetInfo, sizeof(ucGetInfo));
+    return sizeof(ucGetInfo);
+}
+
+/* SubjectIDList.0.1 as a sparse list of the ports of ucKind, behind its
+ * delimiter header */
+static size_t prvPutSubjectList(uint8_t *pucOut, uint8_t ucKind)
+{
+    size_t xCount = 0;
+    UBaseType_t i;
+
+    if (ucKind == CYPHAL_PORT_PUBLISHER)
+    {
+        prvPutU16(&pucOut[6 + 2 * xCount++], CYPHAL_HEARTBEAT_SUBJECT_ID);
+        prvPutU16(&pucOut[6 + 2 * xCount++], CYPHAL_PORT_LIST_SUBJECT_ID);
+    }
+    for (i = 0; i < uxPortCount; i++)
+    {
+        if (xPorts[i].ucKind == ucKind)
+        {
+            prvPutU16(&pucOut[6 + 2 * xCount++], xPorts[i].usPortId);
+        }
+    }
+
+    prvPutU32(&pucOut[0], (uint32_t) (2 + 2 * xCount));
+    pucOut[4] = CYPHAL_SPARSE_LIST_TAG;
+    pucOut[5] = (uint8_t) xCount;
+
+    return 6 + 2 * xCount;
+}
+
+/* ServiceIDList.0.1: a bit per service-ID, LSB first, behind its delimiter
+ * header. Servers are the services served here */
+static size_t prvPutServiceMask(uint8_t *pucOut, BaseType_t xServers)
+{
+    uint8_t *pucMask = &pucOut[4];
+    UdpardPortID usId;
+    UBaseType_t i;
+
+    prvPutU32(&pucOut[0], CYPHAL_SERVICE_MASK_BYTES);
+    memset(pucMask, 0, CYPHAL_SERVICE_MASK_BYTES);
+
+    if (xServers)
+    {
+        for (i = 0; i < CYPHAL_SERVICES_MAX_HANDLERS; i++)
+        {
+            if (xHandlers[i].xUsed)
+            {
+                usId = xHandlers[i].usServiceId;
+                pucMask[usId / 8] |= (uint8_t) (1u << (usId % 8));
+            }
+        }
+    }
+    else
+    {
+        for (i = 0; i < uxPortCount; i++)
+        {
+            if (xPorts[i].ucKind == CYPHAL_PORT_CLIENT)
+            {
+                usId = xPorts[i].usPortId;
+                pucMask[usId / 8] |= (uint8_t) (1u << (usId % 8));
+            }
+        }
+    }
+
+    return 4 + CYPHAL_SERVICE_MASK_BYTES;
+}
+
+/* uavcan.node.port.List.0.1: publishers, subscribers, clients, servers */
+static void prvBuildPortList(void)
+{
+    size_t xLength = 0;
+
+    xLength += prvPutSubjectList(&ucPortList[xLength], CYPHAL_PORT_PUBLISHER);
+    xLength += prvPutSubjectList(&ucPortList[xLength], CYPHAL_PORT_SUBSCRIBER);
+    xLength += prvPutServiceMask(&ucPortList[xLength], pdFALSE);
+    xLength += prvPutServiceMask(&ucPortList[xLength], pdTRUE);
+
+    configASSERT(xLength <= sizeof(ucPortList));
+    xPortListLength = xLength;
+    xPortListStale = pdFALSE;
+}
+
+BaseType_t xCyphalServicesDeclarePort(uint8_t ucKind, UdpardPortID usPortId)
+{
+    BaseType_t xResult = pdPASS;
+    UBaseType_t i;
+
+    if (xServicesMutex == NULL || ucKind > CYPHAL_PORT_CLIENT ||
+        usPortId > ((ucKind == CYPHAL_PORT_CLIENT) ? UDPARD_SERVICE_ID_MAX : UDPARD_SUBJECT_ID_MAX))
+    {
+        return pdFAIL;
+    }
+
+    xSemaphoreTake(xServicesMutex, portMAX_DELAY);
+
+    for (i = 0; i < uxPortCount; i++)
+    {
+        if (xPorts[i].ucKind == ucKind && xPorts[i].usPortId == usPortId)
+        {
+            break;
+        }
+    }
+
+    if (i == uxPortCount)
+    {
+        if (uxPortCount < CYPHAL_SERVICES_MAX_PORTS)
+        {
+            xPorts[uxPortCount].ucKind = ucKind;
+            xPorts[uxPortCount].usPortId = usPortId;
+            uxPortCount++;
+            xPortListStale = pdTRUE;
+        }
+        else
+        {
+            xResult = pdFAIL;
+        }
+    }
+
+    xSemaphoreGive(xServicesMutex);
+    return xResult;
+}
+
+/* Cycle hook of the node: the port list, rebuilt if a port was added */
+static void prvServicesCycle(UdpardMicrosecond ullNowUs)
+{
+    /* Published once the node has a node-ID */
+    if (ullNowUs < ullNextPortListUs || usCyphalNodeGetNodeId() == UDPARD_NODE_ID_UNSET)
+    {
+        return;
+    }
+    ullNextPortListUs = ullNowUs + CYPHAL_SERVICES_PORT_LIST_PERIOD_US;
+
+    xSemaphoreTake(xServicesMutex, portMAX_DELAY);
+    if (xPortListStale)
+    {
+        prvBuildPortList();
+    }
+
+    /* Superseded by the next one, so no use after a period */
+    if (xCyphalNodePublish(CYPHAL_PORT_LIST_SUBJECT_ID, UdpardPriorityOptional, &xPortListTransferId,
+                           ucPortList, xPortListLength, CYPHAL_SERVICES_PORT_LIST_PERIOD_US) == pdPASS)
+    {
+        xStats.ulPortLists++;
+    }
+    xSemaphoreGive(xServicesMutex);
+}
+
+BaseType_t xCyphalServicesStart(void)
+{
+    xServicesMutex = xAppSemaphoreCreateMutex(xServicesMutex);
+    if (xServicesMutex == NULL)
+    {
+        return pdFAIL;
+    }
+
+    prvBuildGetInfo();
+
+    if (xCyphalServicesAdd(CYPHAL_GETINFO_SERVICE_ID, 0, prvGetInfo, NULL) != pdPASS ||
+        xCyphalServicesSetCachedResponse(CYPHAL_GETINFO_SERVICE_ID, ucGetInfo, sizeof(ucGetInfo)) != pdPASS ||
+        xCyphalServicesAdd(CYPHAL_REGISTER_ACCESS_SERVICE_ID, CYPHAL_REGISTER_ACCESS_REQ_SIZE, prvAccess, NULL) != pdPASS ||
+        xCyphalServicesAdd(CYPHAL_REGISTER_LIST_SERVICE_ID, CYPHAL_REGISTER_LIST_REQ_SIZE, prvList, NULL) != pdPASS)
+    {
+        return pdFAIL;
+    }
+
+    vCyphalNodeSetCycleHook(prvServicesCycle);
+    return pdPASS;
+}
+
+void vCyphalServicesGetStats(CyphalServicesStats_t *pxStats)
+{
+    if (xServicesMutex == NULL)
+    {
+        memset(pxStats, 0, sizeof(*pxStats));
+        return;
+    }
+
+    xSemaphoreTake(xServicesMutex, portMAX_DELAY);
+    *pxStats = xStats;
+    xSemaphoreGive(xServicesMutex);
+}
+
+static BaseType_t prvCyphalServicesCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xCyphalServices =
+{
+    "cyphalsrv",
+    "\r\ncyphalsrv:\r\n Cyphal services served, register and port list counters, and the registers\r\n",
+    prvCyphalServicesCommand,
+    0
+};
+
+/* Service counters copied under xServicesMutex on the first line, rather
+ * than holding it while the CLI writes every line */
+static CyphalServicesStats_t xServicesReport;
+static UBaseType_t uxServicesLine = 0;
+
+static BaseType_t prvCyphalServicesCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    const CyphalRegister_t *pxRegister = NULL;
+    UBaseType_t uxHandlers = 0;
+    UBaseType_t uxLine;
+    UBaseType_t i;
+
+    (void) pcCommandString;
+
+    if (uxServicesLine == 0)
+    {
+        if (xServicesMutex == NULL)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Cyphal services not running\r\n");
+            return pdFALSE;
+        }
+
+        vCyphalServicesGetStats(&xServicesReport);
+    }
+
+    switch (uxServicesLine++)
+    {
+    case 0:
+        for (i = 0; i < CYPHAL_SERVICES_MAX_HANDLERS; i++)
+        {
+            uxHandlers += xHandlers[i].xUsed ? 1 : 0;
+        }
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "services: %u/%u requests=%lu cached=%lu no-response=%lu respond-err=%lu\r\n",
+                 (unsigned int) uxHandlers, (unsigned int) CYPHAL_SERVICES_MAX_HANDLERS,
+                 (unsigned long) xServicesReport.ulRequests, (unsigned long) xServicesReport.ulCached,
+                 (unsigned long) xServicesReport.ulNoResponse, (unsigned long) xServicesReport.ulRespondErrors);
+        return pdTRUE;
+    case 1:
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "registers: %u/%u reads=%lu writes=%lu rejects=%lu unknown=%lu port-lists=%lu\r\n",
+                 (unsigned int) uxRegisterCount, (unsigned int) CYPHAL_SERVICES_MAX_REGISTERS,
+                 (unsigned long) xServicesReport.ulRegisterReads, (unsigned long) xServicesReport.ulRegisterWrites,
+                 (unsigned long) xServicesReport.ulRegisterRejects, (unsigned long) xServicesReport.ulRegisterUnknown,
+                 (unsigned long) xServicesReport.ulPortLists);
+        break;
+    default:
+        /* One line per register, in the order of List */
+        uxLine = uxServicesLine - 3;
+        xSemaphoreTake(xServicesMutex, portMAX_DELAY);
+        if (uxLine < uxRegisterCount)
+        {
+            pxRegister = xRegisters[uxLine].pxRegister;
+        }
+        xSemaphoreGive(xServicesMutex);
+
+        snprintf(pcWriteBuffer, xWriteBufferLen, "  %s: type=%u count=%u%s%s\r\n",
+                 pxRegister->pcName, (unsigned int) pxRegister->ucType, (unsigned int) pxRegister->usCount,
+                 (pxRegister->ucFlags & CYPHAL_REGISTER_MUTABLE) ? " mutable" : "",
+                 (pxRegister->ucFlags & CYPHAL_REGISTER_PERSISTENT) ? " persistent" : "");
+        break;
+    }
+
+    /* More registers to print */
+    if (uxServicesLine - 2 < uxRegisterCount)
+    {
+        return pdTRUE;
+    }
+    uxServicesLine = 0;
+    return pdFALSE;
+}
+
+void vCyphalServicesRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xCyphalServices);
+}
@@ -0,0 +1,773 @@
+/* DeferredLog.c
+ *
+ * Ring of log records and the task that formats them (see DeferredLog.h).
+ *
+ * A record is a header word, the format string pointer, the call site, the
+ * tick count and the arguments, 4-byte aligned: one word per int, long,
+ * size_t or pointer, two per long long or double, and the text of each
+ * string. The header word holds the
+ * size and the level and is written last: it commits the record, and the
+ * log task stops at the first one still zero. A record never wraps: when
+ * it does not fit before the end of the ring, the reservation takes the
+ * end as padding too. The log task zeroes what it consumes, so that any
+ * later record starts on a zero header, and alone moves the tail.
+ */
+#include "DeferredLog.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "SerialTask.h"
+#include "SyslogSink.h"
+#include "StaticAlloc.h"
+#include "stm32h7xx.h"
+#include "debug.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define LOG_BUFFER_MASK                (LOG_BUFFER_SIZE - 1u)
+
+#if ((LOG_BUFFER_SIZE & LOG_BUFFER_MASK) != 0)
+#error LOG_BUFFER_SIZE must be a power of two
+#endif
+
+/* Header word of a record */
+#define LOG_RECORD_COMMITTED           (1u << 31)
+#define LOG_RECORD_PAD                 (1u << 30)
+#define LOG_RECORD_TRUNCATED           (1u << 29)
+#define LOG_RECORD_LEVEL_SHIFT         16
+#define LOG_RECORD_SIZE_MASK           0xFFFFu
+
+/* Header word, format string, call site and tick count */
+#define LOG_RECORD_HEADER_SIZE         16u
+
+/* Arguments, as copied into a record */
+typedef enum
+{
+    eLogArgNone = 0,                /* %% */
+    eLogArgWord,                    /* int, long, size_t, char, pointer */
+    eLogArgLongLong,
+    eLogArgDouble,
+    eLogArgString
+} LogArgClass_t;
+
+/* Conversion of a format string */
+typedef struct
+{
+    LogArgClass_t eClass;
+    uint8_t ucStars;                /* '*' width and precision, an int each */
+} LogSpec_t;
+
+typedef struct
+{
+    char cName[configMAX_TASK_NAME_LEN];
+    uint8_t ucLevel;
+} LogModule_t;
+
+volatile uint16_t usDeferredLogGeneration = 1;
+
+static uint8_t ucLogGlobalLevel = TRACE_LEVEL_DEBUG;
+static LogModule_t xLogModules[LOG_MAX_MODULES];
+
+static uint32_t ulLogBuffer[LOG_BUFFER_SIZE / 4u];
+static volatile uint32_t ulLogHead = 0;
+static volatile uint32_t ulLogTail = 0;
+
+static volatile uint32_t ulLogRecords = 0;
+static volatile uint32_t ulLogDropped = 0;
+static volatile uint32_t ulLogTruncated = 0;
+static uint32_t ulLogDroppedReported = 0;
+
+static TaskHandle_t xLogTask = NULL;
+APP_TASK_STORAGE(xLogTask, LOG_TASK_STACK_SIZE);
+
+static char cLogLine[LOG_LINE_MAX];
+static size_t xLogLineLength = 0;
+
+static const char * const pcLevelNames[] =
+{
+    "off", "fatal", "error", "warning", "info", "debug", "verbose"
+};
+
+#define LOG_LEVEL_COUNT                (sizeof(pcLevelNames) / sizeof(pcLevelNames[0]))
+
+static void prvLogTask(void *pvParameters);
+static BaseType_t prvLogCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xLog =
+{
+    "log",
+    "\r\nlog [<level> [<module>] | clear]:\r\n Show or set the levels of the TRACE messages, globally or per source file\r\n",
+    prvLogCommand,
+    -1
+};
+
+size_t xDeferredLogModuleName(const char *pcPath, const char **ppcName)
+{
+    const char *pcName = pcPath;
+    const char *pc;
+    size_t xLength;
+
+    for (pc = pcPath; *pc != '\0'; pc++)
+    {
+        if (*pc == '/' || *pc == '\\')
+        {
+            pcName = pc + 1;
+        }
+    }
+
+    for (xLength = 0; pcName[xLength] != '\0' && pcName[xLength] != '.'; xLength++)
+    {
+    }
+
+    *ppcName = pcName;
+    return xLength;
+}
+
+void vDeferredLogResolveSite(LogSite_t *pxSite)
+{
+    uint16_t usGeneration;
+    const char *pcName;
+    size_t xLength;
+    uint8_t ucLevel;
+    int i;
+
+    /* A change while looking up leaves the site to look up again */
+    do
+    {
+        usGeneration = usDeferredLogGeneration;
+        ucLevel = ucLogGlobalLevel;
+
+        xLength = xDeferredLogModuleName(pxSite->pcFile, &pcName);
+        for (i = 0; i < LOG_MAX_MODULES; i++)
+        {
+            if (xLogModules[i].cName[0] != '\0' && strlen(xLogModules[i].cName) == xLength &&
+                strncmp(xLogModules[i].cName, pcName, xLength) == 0)
+            {
+                ucLevel = xLogModules[i].ucLevel;
+                break;
+            }
+        }
+    } while (usGeneration != usDeferredLogGeneration);
+
+    pxSite->ucLevel = ucLevel;
+    pxSite->usGeneration = usGeneration;
+}
+
+int32_t lDeferredLogSetLevel(const char *pcModule, uint8_t ucLevel)
+{
+    const char *pcName;
+    size_t xLength;
+    int iFree = -1;
+    int i;
+
+    if (pcModule == NULL)
+    {
+        ucLogGlobalLevel = ucLevel;
+        usDeferredLogGeneration++;
+        return 0;
+    }
+
+    xLength = xDeferredLogModuleName(pcModule, &pcName);
+    if (xLength == 0 || xLength >= sizeof(xLogModules[0].cName))
+    {
+        return -1;
+    }
+
+    vTaskSuspendAll();
+    for (i = 0; i < LOG_MAX_MODULES; i++)
+    {
+        if (xLogModules[i].cName[0] == '\0')
+        {
+            if (iFree < 0)
+            {
+                iFree = i;
+            }
+        }
+        else if (strlen(xLogModules[i].cName) == xLength && strncmp(xLogModules[i].cName, pcName, xLength) == 0)
+        {
+            break;
+        }
+    }
+
+    if (i == LOG_MAX_MODULES && iFree >= 0)
+    {
+        i = iFree;
+        memcpy(xLogModules[i].cName, pcName, xLength);
+        xLogModules[i].cName[xLength] = '\0';
+    }
+
+    if (i < LOG_MAX_MODULES)
+    {
+        xLogModules[i].ucLevel = ucLevel;
+        usDeferredLogGeneration++;
+    }
+    (void) xTaskResumeAll();
+
+    return (i < LOG_MAX_MODULES) ? 0 : -1;
+}
+
+void vDeferredLogClearModules(void)
+{
+    vTaskSuspendAll();
+    memset(xLogModules, 0, sizeof(xLogModules));
+    usDeferredLogGeneration++;
+    (void) xTaskResumeAll();
+}
+
+/* Parse the conversion following a '%'; returns its conversion character */
+static const char *prvParseSpec(const char *pc, LogSpec_t *pxSpec)
+{
+    uint8_t ucLongs = 0;
+
+    pxSpec->eClass = eLogArgWord;
+    pxSpec->ucStars = 0;
+
+    /* Flags, width and precision */
+    while (*pc != '\0' && strchr("-+ #0123456789.*", *pc) != NULL)
+    {
+        if (*pc == '*')
+        {
+            pxSpec->ucStars++;
+        }
+        pc++;
+    }
+
+    /* Length modifiers; long, size_t and ptrdiff_t are 32-bit */
+    while (*pc != '\0' && strchr("hlLqjzt", *pc) != NULL)
+    {
+        if (*pc == 'l' || *pc == 'q' || *pc == 'j')
+        {
+            ucLongs += (*pc == 'l') ? 1 : 2;
+        }
+        pc++;
+    }
+
+    switch (*pc)
+    {
+    case '%':
+        pxSpec->eClass = eLogArgNone;
+        break;
+    case 's':
+        pxSpec->eClass = eLogArgString;
+        break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        pxSpec->eClass = eLogArgDouble;
+        break;
+    case 'n':
+    case '\0':
+        pxSpec->eClass = eLogArgNone;
+        break;
+    default:
+        pxSpec->eClass = (ucLongs >= 2) ? eLogArgLongLong : eLogArgWord;
+        break;
+    }
+
+    return pc;
+}
+
+static void prvAtomicIncrement(volatile uint32_t *pulValue)
+{
+    uint32_t ulValue;
+
+    do
+    {
+        ulValue = __LDREXW(pulValue);
+    } while (__STREXW(ulValue + 1u, pulValue) != 0u);
+}
+
+void vDeferredLogWrite(LogSite_t *pxSite, uint8_t ucLevel, const char *pcFormat, ...)
+{
+    uint32_t ulRecord[LOG_RECORD_MAX / 4u];
+    uint8_t *pucRecord = (uint8_t *) ulRecord;
+    size_t xUsed = LOG_RECORD_HEADER_SIZE;
+    uint32_t ulFlags = LOG_RECORD_COMMITTED;
+    uint32_t ulHead;
+    uint32_t ulPad;
+    uint32_t ulPos;
+    uint32_t ulWord;
+    uint64_t ullValue;
+    double dValue;
+    const char *pcString;
+    const char *pc;
+    LogSpec_t xSpec;
+    size_t xLength;
+    uint8_t ucStar;
+    va_list xArgs;
+
+    ulWord = (uint32_t) xTaskGetTickCount();
+    memcpy(pucRecord + 4, &pcFormat, sizeof(pcFormat));
+    memcpy(pucRecord + 8, &pxSite, sizeof(pxSite));
+    memcpy(pucRecord + 12, &ulWord, 4u);
+
+    /* Copy the arguments as the format string describes them */
+    va_start(xArgs, pcFormat);
+    for (pc = pcFormat; *pc != '\0'; pc++)
+    {
+        if (*pc != '%')
+        {
+            continue;
+        }
+
+        pc = prvParseSpec(pc + 1, &xSpec);
+        if (*pc == '\0')
+        {
+            break;
+        }
+
+        for (ucStar = 0; ucStar < xSpec.ucStars; ucStar++)
+        {
+            ulWord = (uint32_t) va_arg(xArgs, int);
+            if (xUsed + 4u > sizeof(ulRecord))
+            {
+                ulFlags |= LOG_RECORD_TRUNCATED;
+                break;
+            }
+            memcpy(pucRecord + xUsed, &ulWord, 4u);
+            xUsed += 4u;
+        }
+
+        if ((ulFlags & LOG_RECORD_TRUNCATED) != 0)
+        {
+            break;
+        }
+
+        switch (xSpec.eClass)
+        {
+        case eLogArgWord:
+            ulWord = va_arg(xArgs, uint32_t);
+            if (xUsed + 4u > sizeof(ulRecord))
+            {
+                ulFlags |= LOG_RECORD_TRUNCATED;
+                break;
+            }
+            memcpy(pucRecord + xUsed, &ulWord, 4u);
+            xUsed += 4u;
+            break;
+        case eLogArgLongLong:
+            ullValue = va_arg(xArgs, uint64_t);
+            if (xUsed + 8u > sizeof(ulRecord))
+            {
+                ulFlags |= LOG_RECORD_TRUNCATED;
+                break;
+            }
+            memcpy(pucRecord + xUsed, &ullValue, 8u);
+            xUsed += 8u;
+            break;
+        case eLogArgDouble:
+            dValue = va_arg(xArgs, double);
+            if (xUsed + 8u > sizeof(ulRecord))
+            {
+                ulFlags |= LOG_RECORD_TRUNCATED;
+                break;
+            }
+            memcpy(pucRecord + xUsed, &dValue, 8u);
+            xUsed += 8u;
+            break;
+        case eLogArgString:
+            /* Copied with its terminator, cut to what the record holds */
+            pcString = va_arg(xArgs, const char *);
+            if (pcString == NULL)
+            {
+                pcString = "(null)";
+            }
+            if (xUsed + 4u > sizeof(ulRecord))
+            {
+                ulFlags |= LOG_RECORD_TRUNCATED;
+                break;
+            }
+            xLength = strnlen(pcString, sizeof(ulRecord) - xUsed - 1u);
+            memcpy(pucRecord + xUsed, pcString, xLength);
+            pucRecord[xUsed + xLength] = '\0';
+            xUsed += (xLength + 4u) & ~3u;
+            break;
+        default:
+            break;
+        }
+
+        if ((ulFlags & LOG_RECORD_TRUNCATED) != 0)
+        {
+            break;
+        }
+    }
+    va_end(xArgs);
+
+    /* Reserve the record, and the end of the ring if it does not fit there */
+    do
+    {
+        ulHead = __LDREXW(&ulLogHead);
+        ulPos = ulHead & LOG_BUFFER_MASK;
+        ulPad = (ulPos + xUsed > LOG_BUFFER_SIZE) ? (LOG_BUFFER_SIZE - ulPos) : 0u;
+
+        if ((ulHead + ulPad + xUsed - ulLogTail) > LOG_BUFFER_SIZE)
+        {
+            __CLREX();
+            prvAtomicIncrement(&ulLogDropped);
+            return;
+        }
+    } while (__STREXW(ulHead + ulPad + (uint32_t) xUsed, &ulLogHead) != 0u);
+
+    if (ulPad != 0u)
+    {
+        ulLogBuffer[ulPos / 4u] = LOG_RECORD_COMMITTED | LOG_RECORD_PAD | ulPad;
+        ulPos = 0;
+    }
+
+    memcpy(&ulLogBuffer[ulPos / 4u + 1u], pucRecord + 4, xUsed - 4u);
+
+    /* The header word commits the record, once the rest is in place */
+    __DMB();
+    ulLogBuffer[ulPos / 4u] = ulFlags | ((uint32_t) ucLevel << LOG_RECORD_LEVEL_SHIFT) | (uint32_t) xUsed;
+
+    prvAtomicIncrement(&ulLogRecords);
+    if ((ulFlags & LOG_RECORD_TRUNCATED) != 0)
+    {
+        prvAtomicIncrement(&ulLogTruncated);
+    }
+
+    /* Interrupts leave the records to the next poll */
+    if (xLogTask != NULL && __get_IPSR() == 0u && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+    {
+        xTaskNotifyGive(xLogTask);
+    }
+}
+
+/* Write the message out: console, and remote log if enabled */
+static void prvLineOutput(const uint8_t *pucRecord, uint32_t ulHeader)
+{
+    const LogSite_t *pxSite;
+    const char *pcModule;
+    size_t xModuleLength;
+    uint32_t ulTick;
+
+    /* Wait for room rather than lose the end of a message */
+    (void) xSerialTaskPut(cLogLine, xLogLineLength, portMAX_DELAY);
+
+#if (SYSLOG_SINK == 1)
+    if (pucRecord != NULL)
+    {
+        memcpy(&pxSite, pucRecord + 8, sizeof(pxSite));
+        memcpy(&ulTick, pucRecord + 12, 4u);
+        xModuleLength = xDeferredLogModuleName(pxSite->pcFile, &pcModule);
+        vSyslogSinkSubmit((uint8_t) ((ulHeader >> LOG_RECORD_LEVEL_SHIFT) & 0xFFu), pcModule, xModuleLength,
+                          ulTick, cLogLine, xLogLineLength);
+    }
+#else
+    (void) pucRecord;
+    (void) ulHeader;
+    (void) pxSite;
+    (void) pcModule;
+    (void) xModuleLength;
+    (void) ulTick;
+#endif
+
+    xLogLineLength = 0;
+}
+
+/* Append to the message; what does not fit in LOG_LINE_MAX is cut */
+static void prvLineAppend(const char *pc, size_t xLength)
+{
+    xLength = MIN(xLength, sizeof(cLogLine) - xLogLineLength);
+    memcpy(cLogLine + xLogLineLength, pc, xLength);
+    xLogLineLength += xLength;
+}
+
+/* Format one conversion with the values taken from the record */
+static void prvFormatArg(const char *pcSpec, size_t xSpecLength, const LogSpec_t *pxSpec,
+                         const uint8_t *pucArgs, size_t *pxOffset, size_t xEnd)
+{
+    char cSpec[24];
+    char cText[64];
+    const char *pcSrc;
+    char *pcDst;
+    int32_t lStar;
+    uint32_t ulWord;
+    uint64_t ullValue;
+    double dValue;
+    int iLength;
+
+    /* Copy the conversion, with every '*' replaced by the value passed */
+    pcDst = cSpec;
+    for (pcSrc = pcSpec; pcSrc < pcSpec + xSpecLength && pcDst < cSpec + sizeof(cSpec) - 12; pcSrc++)
+    {
+        if (*pcSrc == '*')
+        {
+            if (*pxOffset + 4u > xEnd)
+            {
+                return;
+            }
+            memcpy(&lStar, pucArgs + *pxOffset, 4u);
+            *pxOffset += 4u;
+            pcDst += snprintf(pcDst, 12, "%ld", (long) lStar);
+        }
+        else
+        {
+            *pcDst++ = *pcSrc;
+        }
+    }
+    *pcDst = '\0';
+
+    switch (pxSpec->eClass)
+    {
+    case eLogArgWord:
+        if (*pxOffset + 4u > xEnd)
+        {
+            return;
+        }
+        memcpy(&ulWord, pucArgs + *pxOffset, 4u);
+        *pxOffset += 4u;
+        iLength = snprintf(cText, sizeof(cText), cSpec, ulWord);
+        break;
+    case eLogArgLongLong:
+        if (*pxOffset + 8u > xEnd)
+        {
+            return;
+        }
+        memcpy(&ullValue, pucArgs + *pxOffset, 8u);
+        *pxOffset += 8u;
+        iLength = snprintf(cText, sizeof(cText), cSpec, ullValue);
+        break;
+    case eLogArgDouble:
+        if (*pxOffset + 8u > xEnd)
+        {
+            return;
+        }
+        memcpy(&dValue, pucArgs + *pxOffset, 8u);
+        *pxOffset += 8u;
+        iLength = snprintf(cText, sizeof(cText), cSpec, dValue);
+        break;
+    case eLogArgString:
+        if (*pxOffset >= xEnd)
+        {
+            return;
+        }
+        pcSrc = (const char *) pucArgs + *pxOffset;
+        *pxOffset += (strnlen(pcSrc, xEnd - *pxOffset) + 4u) & ~3u;
+        if (strcmp(cSpec, "%s") == 0)
+        {
+            /* The common case, whatever the length */
+            prvLineAppend(pcSrc, strlen(pcSrc));
+            return;
+        }
+        iLength = snprintf(cText, sizeof(cText), cSpec, pcSrc);
+        break;
+    default:
+        return;
+    }
+
+    if (iLength > 0)
+    {
+        prvLineAppend(cText, MIN((size_t) iLength, sizeof(cText) - 1u));
+    }
+}
+
+static void prvFormatRecord(const uint8_t *pucRecord, uint32_t ulHeader)
+{
+    size_t xEnd = ulHeader & LOG_RECORD_SIZE_MASK;
+    size_t xOffset = LOG_RECORD_HEADER_SIZE;
+    const char *pcFormat;
+    const char *pcStart;
+    const char *pc;
+    LogSpec_t xSpec;
+
+    memcpy(&pcFormat, pucRecord + 4, sizeof(pcFormat));
+
+    for (pc = pcFormat; *pc != '\0'; pc++)
+    {
+        if (*pc != '%')
+        {
+            /* Literal text, up to the next conversion */
+            pcStart = pc;
+            while (pc[1] != '\0' && pc[1] != '%')
+            {
+                pc++;
+            }
+            prvLineAppend(pcStart, (size_t) (pc - pcStart) + 1u);
+            continue;
+        }
+
+        pcStart = pc;
+        pc = prvParseSpec(pc + 1, &xSpec);
+        if (*pc == '\0')
+        {
+            break;
+        }
+
+        if (*pc == '%')
+        {
+            prvLineAppend("%", 1);
+        }
+        else if (xSpec.eClass != eLogArgNone)
+        {
+            if (xOffset >= xEnd && (ulHeader & LOG_RECORD_TRUNCATED) != 0)
+            {
+                prvLineAppend("...\r\n", 5);
+                break;
+            }
+            prvFormatArg(pcStart, (size_t) (pc - pcStart) + 1u, &xSpec, pucRecord, &xOffset, xEnd);
+        }
+    }
+
+    prvLineOutput(pucRecord, ulHeader);
+}
+
+/* Format and free every committed record */
+static void prvLogDrain(void)
+{
+    uint8_t *pucRecord;
+    uint32_t ulHeader;
+    uint32_t ulTail = ulLogTail;
+    uint32_t ulSize;
+    char cNote[48];
+    int iLength;
+
+    while (ulTail != ulLogHead)
+    {
+        pucRecord = (uint8_t *) &ulLogBuffer[(ulTail & LOG_BUFFER_MASK) / 4u];
+        ulHeader = *(volatile uint32_t *) pucRecord;
+        if ((ulHeader & LOG_RECORD_COMMITTED) == 0)
+        {
+            break;
+        }
+        __DMB();
+
+        ulSize = ulHeader & LOG_RECORD_SIZE_MASK;
+        if ((ulHeader & LOG_RECORD_PAD) == 0)
+        {
+            prvFormatRecord(pucRecord, ulHeader);
+        }
+
+        /* Zero the record before the producers can see it as free */
+        memset(pucRecord, 0, ulSize);
+        __DMB();
+        ulTail += ulSize;
+        ulLogTail = ulTail;
+    }
+
+    if (ulLogDropped != ulLogDroppedReported)
+    {
+        iLength = snprintf(cNote, sizeof(cNote), "log: %lu message(s) dropped\r\n",
+                           (unsigned long) (ulLogDropped - ulLogDroppedReported));
+        ulLogDroppedReported = ulLogDropped;
+        prvLineAppend(cNote, (size_t) iLength);
+        prvLineOutput(NULL, 0);
+    }
+}
+
+long xDeferredLogStart(unsigned long uxPriority)
+{
+    return xAppTaskCreate(xLogTask, prvLogTask, "Log", LOG_TASK_STACK_SIZE, NULL, uxPriority, &xLogTask);
+}
+
+static void prvLogTask(void *pvParameters)
+{
+    TickType_t xWait = pdMS_TO_TICKS(LOG_TASK_POLL_MS);
+
+    (void) pvParameters;
+
+    for (;;)
+    {
+        (void) ulTaskNotifyTake(pdTRUE, xWait);
+        prvLogDrain();
+
+        xWait = pdMS_TO_TICKS(LOG_TASK_POLL_MS);
+#if (SYSLOG_SINK == 1)
+        /* Send the pending batch when it is due */
+        xWait = MIN(xWait, xSyslogSinkFlush(pdFALSE));
+#endif
+    }
+}
+
+static BaseType_t prvLogCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    static UBaseType_t uxLine = 0;
+    const char *pcParameter;
+    BaseType_t xLength;
+    char cModule[configMAX_TASK_NAME_LEN];
+    uint8_t ucLevel;
+
+    if (uxLine == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xLength);
+        if (pcParameter != NULL)
+        {
+            if (xLength == 5 && strncmp(pcParameter, "clear", 5) == 0)
+            {
+                vDeferredLogClearModules();
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Module levels cleared\r\n");
+                return pdFALSE;
+            }
+
+            for (ucLevel = 0; ucLevel < LOG_LEVEL_COUNT; ucLevel++)
+            {
+                if (strlen(pcLevelNames[ucLevel]) == (size_t) xLength &&
+                    strncmp(pcParameter, pcLevelNames[ucLevel], xLength) == 0)
+                {
+                    break;
+                }
+            }
+            if (ucLevel == LOG_LEVEL_COUNT)
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen,
+                         "Levels: off, fatal, error, warning, info, debug, verbose\r\n");
+                return pdFALSE;
+            }
+
+            pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xLength);
+            if (pcParameter == NULL)
+            {
+                (void) lDeferredLogSetLevel(NULL, ucLevel);
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Global level: %s\r\n", pcLevelNames[ucLevel]);
+                return pdFALSE;
+            }
+
+            if ((size_t) xLength >= sizeof(cModule))
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Module name too long\r\n");
+                return pdFALSE;
+            }
+            memcpy(cModule, pcParameter, xLength);
+            cModule[xLength] = '\0';
+
+            if (lDeferredLogSetLevel(cModule, ucLevel) != 0)
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Module table full, see \"log clear\"\r\n");
+                return pdFALSE;
+            }
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Level of %s: %s\r\n", cModule, pcLevelNames[ucLevel]);
+            return pdFALSE;
+        }
+
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "backend: %s, level: %s, records=%lu dropped=%lu truncated=%lu, ring %lu/%lu bytes\r\n",
+                 (LOG_BACKEND == LOG_BACKEND_DEFERRED) ? "deferred" : "printf",
+                 pcLevelNames[MIN(ucLogGlobalLevel, LOG_LEVEL_COUNT - 1)],
+                 (unsigned long) ulLogRecords, (unsigned long) ulLogDropped, (unsigned long) ulLogTruncated,
+                 (unsigned long) (ulLogHead - ulLogTail), (unsigned long) LOG_BUFFER_SIZE);
+        uxLine++;
+        return pdTRUE;
+    }
+
+    /* One line per module with a level of its own */
+    while (uxLine <= LOG_MAX_MODULES && xLogModules[uxLine - 1].cName[0] == '\0')
+    {
+        uxLine++;
+    }
+
+    if (uxLine > LOG_MAX_MODULES)
+    {
+        pcWriteBuffer[0] = '\0';
+        uxLine = 0;
+        return pdFALSE;
+    }
+
+    snprintf(pcWriteBuffer, xWriteBufferLen, "module %s: %s\r\n", xLogModules[uxLine - 1].cName,
+             pcLevelNames[MIN(xLogModules[uxLine - 1].ucLevel, LOG_LEVEL_COUNT - 1)]);
+    uxLine++;
+    return pdTRUE;
+}
+
+void vDeferredLogRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xLog);
+}
@@ -0,0 +1,86 @@
+/* DhcpLeaseStore.c
+ *
+ * Persistence of the DHCP lease in the flash store (FlashStore.h), so that
+ * the client can start in INIT-REBOOT state and request its previous address
+ * right after power-on. The lease is the value of FLASH_STORE_KEY_DHCP_LEASE;
+ * invalidating it deletes the key.
+ */
+#include "DhcpLeaseStore.h"
+#include "FlashStore.h"
+#include <string.h>
+
+typedef struct
+{
+    uint32_t ulIpAddr;
+    uint32_t ulServerIpAddr;
+    uint32_t ulLeaseTime;
+} DhcpLeaseRecord_t;
+
+static BaseType_t prvReadRecord(DhcpLeaseRecord_t *pxRecord)
+{
+    size_t xLength;
+
+    if (xFlashStoreRead(FLASH_STORE_KEY_DHCP_LEASE, pxRecord, sizeof(*pxRecord), &xLength) != pdPASS ||
+        xLength != sizeof(*pxRecord))
+    {
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+
+error_t xDhcpLeaseStoreLoad(DhcpClientContext *pxContext, NetInterface *pxInterface, DhcpClientLease *pxLease)
+{
+    DhcpLeaseRecord_t xRecord;
+
+    (void) pxContext;
+    (void) pxInterface;
+
+    if (prvReadRecord(&xRecord) != pdPASS || xRecord.ulIpAddr == IPV4_UNSPECIFIED_ADDR)
+    {
+        return ERROR_NOT_FOUND;
+    }
+
+    pxLease->ipAddr = xRecord.ulIpAddr;
+    pxLease->serverIpAddr = xRecord.ulServerIpAddr;
+    pxLease->leaseTime = xRecord.ulLeaseTime;
+
+    return NO_ERROR;
+}
+
+void vDhcpLeaseStoreSave(DhcpClientContext *pxContext, NetInterface *pxInterface, const DhcpClientLease *pxLease)
+{
+    DhcpLeaseRecord_t xLast;
+    DhcpLeaseRecord_t xRecord;
+    BaseType_t xHasLast;
+
+    (void) pxContext;
+    (void) pxInterface;
+
+    xHasLast = prvReadRecord(&xLast);
+
+    if (pxLease == NULL)
+    {
+        /* Nothing to invalidate otherwise */
+        if (xHasLast == pdPASS)
+        {
+            (void) xFlashStoreWrite(FLASH_STORE_KEY_DHCP_LEASE, NULL, 0, NULL, NULL, 0);
+        }
+        return;
+    }
+
+    memset(&xRecord, 0, sizeof(xRecord));
+    xRecord.ulIpAddr = pxLease->ipAddr;
+    xRecord.ulServerIpAddr = pxLease->serverIpAddr;
+    xRecord.ulLeaseTime = pxLease->leaseTime;
+
+    /* Spare the flash when the lease did not change, the usual case after
+     * a reboot or a cable replug */
+    if (xHasLast == pdPASS && memcmp(&xLast, &xRecord, sizeof(xRecord)) == 0)
+    {
+        return;
+    }
+
+    /* Queued only: this runs in the TCP/IP task */
+    (void) xFlashStoreWrite(FLASH_STORE_KEY_DHCP_LEASE, &xRecord, sizeof(xRecord), NULL, NULL, 0);
+}
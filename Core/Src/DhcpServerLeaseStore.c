@@ -0,0 +1,117 @@
+/* DhcpServerLeaseStore.c
+ *
+ * Persistence of the DHCP server lease table in the flash store
+ * (FlashStore.h), so that clients keep their address across a reboot of the
+ * server and that no address still leased is offered to another client.
+ *
+ * The table is the value of FLASH_STORE_KEY_DHCP_SERVER_LEASES, a count then
+ * the leases; the store keeps the previous value until a new one is
+ * completely programmed.
+ *
+ * The DHCP server coalesces changes for DHCP_SERVER_STORE_DELAY before
+ * invoking its callback, so a mass power-on of clients costs one write.
+ */
+#include "DhcpServerLeaseStore.h"
+#include "FlashStore.h"
+#include "task.h"
+#include "StaticAlloc.h"
+#include <stddef.h>
+#include <string.h>
+
+/* One lease */
+typedef struct
+{
+    uint8_t ucMacAddr[6];
+    uint16_t usReserved;
+    uint32_t ulIpAddr;
+    uint32_t ulRemainingTime;
+} DhcpServerLeaseRecord_t;
+
+/* Value of the key, written up to the last lease */
+typedef struct
+{
+    uint32_t ulCount;
+    DhcpServerLeaseRecord_t xRecords[DHCP_SERVER_MAX_CLIENTS];
+} DhcpServerLeaseSnapshot_t;
+
+#define DHCP_SERVER_SNAPSHOT_SIZE(n)   (offsetof(DhcpServerLeaseSnapshot_t, xRecords) + (n) * sizeof(DhcpServerLeaseRecord_t))
+
+/* The count and 12 bytes a lease */
+#if (4 + DHCP_SERVER_MAX_CLIENTS * 12 > FLASH_STORE_MAX_DATA_SIZE)
+#error DHCP_SERVER_MAX_CLIENTS leases exceed FLASH_STORE_MAX_DATA_SIZE
+#endif
+
+static DhcpServerContext *pxStoreContext = NULL;
+static TaskHandle_t xStoreTask = NULL;
+APP_TASK_STORAGE(xStoreTask, DHCP_SERVER_LEASE_STORE_STACK_SIZE);
+
+/* Working buffers, used by xDhcpServerLeaseStoreStart() then by the task */
+static DhcpServerLease xLeases[DHCP_SERVER_MAX_CLIENTS];
+static DhcpServerLeaseSnapshot_t xSnapshot;
+
+static void prvDhcpServerLeaseStoreTask(void *pvParameters);
+
+BaseType_t xDhcpServerLeaseStoreStart(DhcpServerContext *pxContext, UBaseType_t uxPriority)
+{
+    size_t xLength;
+    uint32_t i;
+
+    pxStoreContext = pxContext;
+
+    if (xFlashStoreRead(FLASH_STORE_KEY_DHCP_SERVER_LEASES, &xSnapshot, sizeof(xSnapshot), &xLength) == pdPASS &&
+        xLength >= DHCP_SERVER_SNAPSHOT_SIZE(0) && xSnapshot.ulCount <= DHCP_SERVER_MAX_CLIENTS &&
+        xLength == DHCP_SERVER_SNAPSHOT_SIZE(xSnapshot.ulCount))
+    {
+        for (i = 0; i < xSnapshot.ulCount; i++)
+        {
+            memcpy(xLeases[i].macAddr.b, xSnapshot.xRecords[i].ucMacAddr, sizeof(MacAddr));
+            xLeases[i].ipAddr = xSnapshot.xRecords[i].ulIpAddr;
+            xLeases[i].remainingTime = xSnapshot.xRecords[i].ulRemainingTime;
+        }
+
+        (void) dhcpServerImportLeases(pxContext, xLeases, xSnapshot.ulCount);
+    }
+
+    return xAppTaskCreate(xStoreTask, prvDhcpServerLeaseStoreTask, "DhcpLeases", DHCP_SERVER_LEASE_STORE_STACK_SIZE,
+                          NULL, uxPriority, &xStoreTask);
+}
+
+void vDhcpServerLeaseStoreNotify(DhcpServerContext *pxContext)
+{
+    (void) pxContext;
+
+    if (xStoreTask != NULL)
+    {
+        xTaskNotifyGive(xStoreTask);
+    }
+}
+
+static void prvDhcpServerLeaseStoreTask(void *pvParameters)
+{
+    uint_t uxCount;
+    uint_t i;
+
+    (void) pvParameters;
+
+    for (;;)
+    {
+        (void) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        if (dhcpServerExportLeases(pxStoreContext, xLeases, DHCP_SERVER_MAX_CLIENTS, &uxCount) != NO_ERROR)
+        {
+            continue;
+        }
+
+        for (i = 0; i < uxCount; i++)
+        {
+            memcpy(xSnapshot.xRecords[i].ucMacAddr, xLeases[i].macAddr.b, sizeof(MacAddr));
+            xSnapshot.xRecords[i].usReserved = 0;
+            xSnapshot.xRecords[i].ulIpAddr = xLeases[i].ipAddr;
+            xSnapshot.xRecords[i].ulRemainingTime = xLeases[i].remainingTime;
+        }
+        xSnapshot.ulCount = uxCount;
+
+        (void) xFlashStoreWrite(FLASH_STORE_KEY_DHCP_SERVER_LEASES, &xSnapshot, DHCP_SERVER_SNAPSHOT_SIZE(uxCount),
+                                NULL, NULL, portMAX_DELAY);
+    }
+}
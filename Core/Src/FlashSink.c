@@ -0,0 +1,208 @@
+/* FlashSink.c
+ *
+ * Staging slot of the firmware images (see FlashSink.h). Called by the TFTP
+ * server task only, which owns the chunk being filled and the write
+ * position.
+ */
+#include "FlashSink.h"
+#include "FlashStore.h"
+#include "stm32h7xx_hal.h"
+#include "StaticAlloc.h"
+#include <stddef.h>
+#include <string.h>
+
+#define FLASH_SINK_MAGIC               0x494D4147u   /* "IMAG" */
+#define FLASH_SINK_WORD_SIZE           FLASH_STORE_WORD_SIZE
+
+/* Data queued to the flash store in one request, whole flash words */
+#define FLASH_SINK_CHUNK_SIZE          512u
+
+/* One flash word, at the start of the slot, the image following it */
+typedef struct
+{
+    uint32_t ulMagic;
+    uint32_t ulSize;
+    uint32_t ulCheck;
+    uint32_t ulReserved[5];
+} FlashSinkHeader_t;
+
+static BaseType_t prvOpen(const char *pcName, uint32_t ulAnnounced);
+static BaseType_t prvWrite(const uint8_t *pucData, size_t xLength);
+static BaseType_t prvClose(BaseType_t xCommit);
+
+const TftpSink_t xFlashSink =
+{
+    prvOpen,
+    prvWrite,
+    prvClose,
+    FLASH_SINK_SIZE - FLASH_SINK_WORD_SIZE
+};
+
+static const FlashSinkHeader_t * const pxHeader = (const FlashSinkHeader_t *) FLASH_SINK_ADDRESS;
+
+static uint8_t ucChunk[FLASH_SINK_CHUNK_SIZE];
+static size_t xChunkLength;
+static uint32_t ulNext;             /* Address of the next chunk */
+static uint32_t ulSize;             /* Bytes written since the open */
+static volatile BaseType_t xFailed;
+
+/* Given by the completion of the requests waited for */
+static SemaphoreHandle_t xDone = NULL;
+APP_MUTEX_STORAGE(xDone);
+
+/* Called by the store task; pvParam is non-NULL for the requests waited for */
+static void prvCompleted(BaseType_t xResult, void *pvParam)
+{
+    if (xResult != pdPASS)
+    {
+        xFailed = pdTRUE;
+    }
+
+    if (pvParam != NULL)
+    {
+        (void) xSemaphoreGive(xDone);
+    }
+}
+
+/* Requests complete in order, so waiting for the last one waits for all */
+static BaseType_t prvWait(BaseType_t xQueued)
+{
+    if (xQueued != pdPASS)
+    {
+        xFailed = pdTRUE;
+        return pdFAIL;
+    }
+
+    (void) xSemaphoreTake(xDone, portMAX_DELAY);
+
+    return (xFailed == pdFALSE) ? pdPASS : pdFAIL;
+}
+
+static BaseType_t prvQueueChunk(void *pvWait)
+{
+    BaseType_t xQueued;
+
+    if (ulNext + xChunkLength > FLASH_SINK_ADDRESS + FLASH_SINK_SIZE)
+    {
+        xFailed = pdTRUE;
+        return pdFAIL;
+    }
+
+    xQueued = xFlashStoreProgram(ulNext, ucChunk, xChunkLength, prvCompleted, pvWait, portMAX_DELAY);
+    ulNext += (uint32_t) xChunkLength;
+    xChunkLength = 0;
+
+    if (xQueued != pdPASS)
+    {
+        xFailed = pdTRUE;
+    }
+
+    return xQueued;
+}
+
+/* The header and the image: only the sectors they cover, if the size is
+ * known. The TFTP task waits for the erase, the other tasks run meanwhile */
+static BaseType_t prvOpen(const char *pcName, uint32_t ulAnnounced)
+{
+    uint32_t ulSectors = FLASH_SINK_SECTORS;
+
+    (void) pcName;
+
+    if (ulAnnounced > xFlashSink.ulCapacity)
+    {
+        return pdFAIL;
+    }
+    if (ulAnnounced != 0)
+    {
+        ulSectors = (FLASH_SINK_WORD_SIZE + ulAnnounced + FLASH_SECTOR_SIZE - 1u) / FLASH_SECTOR_SIZE;
+    }
+
+    if (xDone == NULL)
+    {
+        xDone = xAppSemaphoreCreateBinary(xDone);
+        if (xDone == NULL)
+        {
+            return pdFAIL;
+        }
+    }
+
+    xChunkLength = 0;
+    ulNext = FLASH_SINK_ADDRESS + FLASH_SINK_WORD_SIZE;
+    ulSize = 0;
+    xFailed = pdFALSE;
+
+    return prvWait(xFlashStoreErase(FLASH_SINK_FIRST_SECTOR, ulSectors, prvCompleted, &xDone, portMAX_DELAY));
+}
+
+/* A full chunk is queued once more data follows, without waiting for its
+ * programming, so that the close always has one left; the first failure is
+ * reported by the next call */
+static BaseType_t prvWrite(const uint8_t *pucData, size_t xLength)
+{
+    size_t xCopy;
+
+    if (xFailed != pdFALSE || ulSize + xLength > xFlashSink.ulCapacity)
+    {
+        return pdFAIL;
+    }
+    ulSize += (uint32_t) xLength;
+
+    while (xLength > 0 && xFailed == pdFALSE)
+    {
+        if (xChunkLength == FLASH_SINK_CHUNK_SIZE)
+        {
+            (void) prvQueueChunk(NULL);
+        }
+
+        xCopy = FLASH_SINK_CHUNK_SIZE - xChunkLength;
+        if (xCopy > xLength)
+        {
+            xCopy = xLength;
+        }
+        memcpy(&ucChunk[xChunkLength], pucData, xCopy);
+        xChunkLength += xCopy;
+        pucData += xCopy;
+        xLength -= xCopy;
+    }
+
+    return (xFailed == pdFALSE) ? pdPASS : pdFAIL;
+}
+
+/* The last chunk, padded as erased flash by the store, waited for, then
+ * the header, which is only programmed over a complete image */
+static BaseType_t prvClose(BaseType_t xCommit)
+{
+    FlashSinkHeader_t xHeader;
+
+    if (xCommit == pdFALSE || xFailed != pdFALSE)
+    {
+        return (xCommit == pdFALSE) ? pdPASS : pdFAIL;
+    }
+
+    if (xChunkLength > 0 && prvWait(prvQueueChunk(&xDone)) != pdPASS)
+    {
+        return pdFAIL;
+    }
+
+    memset(&xHeader, 0xFF, sizeof(xHeader));
+    xHeader.ulMagic = FLASH_SINK_MAGIC;
+    xHeader.ulSize = ulSize;
+    xHeader.ulCheck = ~(FLASH_SINK_MAGIC ^ ulSize);
+
+    return prvWait(xFlashStoreProgram(FLASH_SINK_ADDRESS, &xHeader, sizeof(xHeader), prvCompleted, &xDone,
+                                      portMAX_DELAY));
+}
+
+BaseType_t xFlashSinkGetImage(const uint8_t **ppucImage, uint32_t *pulSize)
+{
+    if (pxHeader->ulMagic != FLASH_SINK_MAGIC || pxHeader->ulCheck != ~(FLASH_SINK_MAGIC ^ pxHeader->ulSize) ||
+        pxHeader->ulSize > xFlashSink.ulCapacity)
+    {
+        return pdFAIL;
+    }
+
+    *ppucImage = (const uint8_t *) (FLASH_SINK_ADDRESS + FLASH_SINK_WORD_SIZE);
+    *pulSize = pxHeader->ulSize;
+
+    return pdPASS;
+}
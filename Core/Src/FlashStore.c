@@ -0,0 +1,937 @@
+/* FlashStore.c
+ *
+ * Flash storage service (see FlashStore.h). The store task owns the flash
+ * controller and the state of the log; the index of the keys is shared with
+ * the readers under xIndexMutex, which the task holds while it programs the
+ * store sectors. Requests are a FlashStoreRequest_t then their data in the
+ * stream buffer; the senders take xSendMutex so that the two parts of a
+ * request stay together.
+ */
+#include "FlashStore.h"
+#include "stm32h7xx_hal.h"
+#include "task.h"
+#include "semphr.h"
+#include "stream_buffer.h"
+#include "FreeRTOS_CLI.h"
+#include "StaticAlloc.h"
+#include "TcmPlacement.h"
+#include <stdio.h>
+#include <string.h>
+
+#define FLASH_STORE_SECTOR_MAGIC       0x46535453u   /* "FSTS" */
+#define FLASH_STORE_RECORD_MAGIC       0x46535452u   /* "FSTR" */
+#define FLASH_STORE_ERASED             0xFFFFFFFFu
+
+#define FLASH_STORE_SECTOR_WORDS       (FLASH_SECTOR_SIZE / FLASH_STORE_WORD_SIZE)
+#define FLASH_STORE_DATA_WORDS(n)      (((n) + FLASH_STORE_WORD_SIZE - 1u) / FLASH_STORE_WORD_SIZE)
+#define FLASH_STORE_SECTOR_ADDRESS(s)  (FLASH_STORE_ADDRESS + (s) * FLASH_SECTOR_SIZE)
+#define FLASH_STORE_RAW_ADDRESS        (FLASH_BANK1_BASE + FLASH_STORE_RAW_FIRST_SECTOR * FLASH_SECTOR_SIZE)
+
+/* Initial stack pointer, 15 exceptions, then the interrupts up to the last
+ * one of the STM32H723 */
+#define FLASH_STORE_VECTOR_COUNT       (16u + (uint32_t) TIM24_IRQn + 1u)
+
+/* Sector header, the first flash word of the sector, programmed once the
+ * sector holds the latest record of every key */
+typedef struct
+{
+    uint32_t ulMagic;
+    uint32_t ulSequence;                            /* The higher is the active sector */
+    uint32_t ulEraseCount[FLASH_STORE_SECTORS];     /* Of every sector, as of the header */
+    uint32_t ulCheck;
+    uint32_t ulReserved[3];
+} FlashStoreSectorHeader_t;
+
+/* Record header, one flash word, the data following it */
+typedef struct
+{
+    uint32_t ulMagic;
+    uint16_t usKey;
+    uint16_t usLength;
+    uint32_t ulCrc;                                 /* CRC-32 of the data */
+    uint32_t ulCheck;
+    uint32_t ulReserved[4];
+} FlashStoreRecordHeader_t;
+
+typedef enum
+{
+    FLASH_STORE_REQUEST_WRITE,
+    FLASH_STORE_REQUEST_ERASE,
+    FLASH_STORE_REQUEST_PROGRAM
+} FlashStoreRequestKind_t;
+
+/* Request as queued, ulCount bytes of data following a write or a program */
+typedef struct
+{
+    FlashStoreRequestKind_t eKind;
+    uint32_t ulTarget;                              /* Key, first sector or address */
+    uint32_t ulCount;                               /* Bytes, or sectors of an erase */
+    FlashStoreCallback_t pxCallback;
+    void *pvParam;
+} FlashStoreRequest_t;
+
+typedef enum
+{
+    FLASH_STORE_STATE_ERASED,
+    FLASH_STORE_STATE_ACTIVE,
+    FLASH_STORE_STATE_DIRTY                         /* To be erased */
+} FlashStoreState_t;
+
+/* Latest record of a key */
+typedef struct
+{
+    uint16_t usKey;
+    uint16_t usLength;
+    uint32_t ulAddress;                             /* Of the data */
+} FlashStoreKey_t;
+
+static FlashStoreKey_t xKeys[FLASH_STORE_MAX_KEYS];
+static uint32_t ulKeyCount = 0;
+
+static FlashStoreState_t eState[FLASH_STORE_SECTORS];
+static uint32_t ulEraseCount[FLASH_STORE_SECTORS];
+static uint32_t ulActive = FLASH_STORE_SECTORS;
+static uint32_t ulSequence = 0;
+static uint32_t ulFreeWord = FLASH_STORE_SECTOR_WORDS;    /* In the active sector */
+
+static uint32_t ulWrites = 0;
+static uint32_t ulCompactions = 0;
+static uint32_t ulErases = 0;
+static uint32_t ulPrograms = 0;
+static uint32_t ulErrors = 0;
+
+/* Data of the request being served: a record is received after the room
+ * left for its header, so that both are programmed in one go */
+static uint32_t ulData[(FLASH_STORE_WORD_SIZE + FLASH_STORE_MAX_DATA_SIZE) / sizeof(uint32_t)] __ALIGNED(32);
+/* Flash word being copied by a compaction */
+static uint32_t ulCopy[FLASH_STORE_WORD_SIZE / sizeof(uint32_t)] __ALIGNED(32);
+
+/* Vector table, fetched from the DTCM while the bank is busy; the VTOR
+ * takes a base aligned on the table size rounded up to a power of two */
+static uint32_t ulVectors[FLASH_STORE_VECTOR_COUNT] TCM_BSS __ALIGNED(1024);
+
+static TaskHandle_t xStoreTask = NULL;
+APP_TASK_STORAGE(xStoreTask, FLASH_STORE_STACK_SIZE);
+static StreamBufferHandle_t xQueue = NULL;
+APP_STREAM_STORAGE(xQueue, FLASH_STORE_QUEUE_SIZE);
+static SemaphoreHandle_t xIndexMutex = NULL;
+APP_MUTEX_STORAGE(xIndexMutex);
+static SemaphoreHandle_t xSendMutex = NULL;
+APP_MUTEX_STORAGE(xSendMutex);
+
+static UBaseType_t uxFlashStoreLine = 0;
+
+static void prvFlashStoreTask(void *pvParameters);
+static BaseType_t prvFlashStoreCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xFlashStore =
+{
+    "flashstore",
+    "\r\nflashstore:\r\n Sectors, records and queue of the flash storage service\r\n",
+    prvFlashStoreCommand,
+    0
+};
+
+/*
+ * Flash controller. Nothing below may read the flash, not even for code:
+ * the functions run from the ITCM and only use registers and RAM.
+ */
+
+TCM_CODE static uint32_t prvTakeErrors(void)
+{
+    uint32_t ulFlags = FLASH->SR1 & FLASH_FLAG_ALL_ERRORS_BANK1;
+
+    FLASH->CCR1 = ulFlags | FLASH_FLAG_EOP_BANK1;
+
+    return ulFlags;
+}
+
+TCM_CODE static void prvUnlock(void)
+{
+    if ((FLASH->CR1 & FLASH_CR_LOCK) != 0)
+    {
+        FLASH->KEYR1 = FLASH_KEY1;
+        FLASH->KEYR1 = FLASH_KEY2;
+    }
+}
+
+TCM_CODE static void prvLock(void)
+{
+    FLASH->CR1 |= FLASH_CR_LOCK;
+}
+
+/* One flash word; the queue drains in a few tens of microseconds, short
+ * enough to wait for with the interrupts enabled */
+TCM_CODE static uint32_t prvProgramWord(uint32_t ulAddress, const uint32_t *pulData)
+{
+    volatile uint32_t *pulDest = (volatile uint32_t *) ulAddress;
+    uint32_t i;
+
+    while ((FLASH->SR1 & FLASH_SR_QW) != 0)
+    {
+    }
+
+    FLASH->CR1 |= FLASH_CR_PG;
+    __ISB();
+    __DSB();
+
+    for (i = 0; i < FLASH_NB_32BITWORD_IN_FLASHWORD; i++)
+    {
+        pulDest[i] = pulData[i];
+    }
+
+    __ISB();
+    __DSB();
+
+    while ((FLASH->SR1 & FLASH_SR_QW) != 0)
+    {
+    }
+
+    FLASH->CR1 &= ~FLASH_CR_PG;
+
+    return prvTakeErrors();
+}
+
+/* One sector; the task sleeps a tick at a time until the end of the erase,
+ * the scheduler and the tick interrupt running from the ITCM as well */
+TCM_CODE static uint32_t prvEraseSector(uint32_t ulSector)
+{
+    while ((FLASH->SR1 & FLASH_SR_QW) != 0)
+    {
+    }
+
+#if defined (FLASH_CR_PSIZE)
+    FLASH->CR1 &= ~(FLASH_CR_PSIZE | FLASH_CR_SNB);
+    FLASH->CR1 |= FLASH_CR_SER | FLASH_VOLTAGE_RANGE_3 | (ulSector << FLASH_CR_SNB_Pos) | FLASH_CR_START;
+#else
+    FLASH->CR1 &= ~FLASH_CR_SNB;
+    FLASH->CR1 |= FLASH_CR_SER | (ulSector << FLASH_CR_SNB_Pos) | FLASH_CR_START;
+#endif
+    __DSB();
+
+    while ((FLASH->SR1 & FLASH_SR_QW) != 0)
+    {
+        vTaskDelay(1);
+    }
+
+    FLASH->CR1 &= ~(FLASH_CR_SER | FLASH_CR_SNB);
+
+    return prvTakeErrors();
+}
+
+/* The D-cache may hold the lines of the range from before the operation */
+static BaseType_t prvProgram(uint32_t ulAddress, const uint32_t *pulData, uint32_t ulWords)
+{
+    uint32_t ulFlags = 0;
+    uint32_t i;
+
+    prvUnlock();
+    for (i = 0; i < ulWords && ulFlags == 0; i++)
+    {
+        ulFlags = prvProgramWord(ulAddress + i * FLASH_STORE_WORD_SIZE,
+                                 &pulData[i * (FLASH_STORE_WORD_SIZE / sizeof(uint32_t))]);
+    }
+    prvLock();
+
+    SCB_InvalidateDCache_by_Addr((void *) ulAddress, (int32_t) (ulWords * FLASH_STORE_WORD_SIZE));
+    ulPrograms += i;
+
+    return (ulFlags == 0) ? pdPASS : pdFAIL;
+}
+
+static BaseType_t prvErase(uint32_t ulSector)
+{
+    uint32_t ulFlags;
+
+    prvUnlock();
+    ulFlags = prvEraseSector(ulSector);
+    prvLock();
+
+    SCB_InvalidateDCache_by_Addr((void *) (FLASH_BANK1_BASE + ulSector * FLASH_SECTOR_SIZE), (int32_t) FLASH_SECTOR_SIZE);
+    ulErases++;
+
+    return (ulFlags == 0) ? pdPASS : pdFAIL;
+}
+
+/*
+ * Log of records
+ */
+
+static uint32_t prvCrc32(const uint8_t *pucData, size_t xLength)
+{
+    uint32_t ulCrc = 0xFFFFFFFFu;
+    uint32_t i;
+
+    while (xLength-- > 0)
+    {
+        ulCrc ^= *pucData++;
+        for (i = 0; i < 8; i++)
+        {
+            ulCrc = (ulCrc >> 1) ^ (0xEDB88320u & (0u - (ulCrc & 1u)));
+        }
+    }
+
+    return ~ulCrc;
+}
+
+static uint32_t prvSectorCheck(const FlashStoreSectorHeader_t *pxHeader)
+{
+    uint32_t ulCheck = pxHeader->ulMagic ^ pxHeader->ulSequence;
+    uint32_t i;
+
+    for (i = 0; i < FLASH_STORE_SECTORS; i++)
+    {
+        ulCheck ^= pxHeader->ulEraseCount[i];
+    }
+
+    return ~ulCheck;
+}
+
+static uint32_t prvRecordCheck(const FlashStoreRecordHeader_t *pxHeader)
+{
+    return ~(pxHeader->ulMagic ^ ((uint32_t) pxHeader->usKey | ((uint32_t) pxHeader->usLength << 16)) ^
+             pxHeader->ulCrc);
+}
+
+static FlashStoreKey_t *prvFindKey(uint16_t usKey)
+{
+    uint32_t i;
+
+    for (i = 0; i < ulKeyCount; i++)
+    {
+        if (xKeys[i].usKey == usKey)
+        {
+            return &xKeys[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* New latest record of a key, a zero length removing the key */
+static void prvSetKey(uint16_t usKey, uint16_t usLength, uint32_t ulAddress)
+{
+    FlashStoreKey_t *pxKey = prvFindKey(usKey);
+
+    if (usLength == 0)
+    {
+        if (pxKey != NULL)
+        {
+            *pxKey = xKeys[--ulKeyCount];
+        }
+        return;
+    }
+
+    if (pxKey == NULL)
+    {
+        if (ulKeyCount >= FLASH_STORE_MAX_KEYS)
+        {
+            return;
+        }
+        pxKey = &xKeys[ulKeyCount++];
+        pxKey->usKey = usKey;
+    }
+
+    pxKey->usLength = usLength;
+    pxKey->ulAddress = ulAddress;
+}
+
+/* Index the records of the active sector and find its free space. A damaged
+ * header ends the walk with the sector taken as full, so that the next
+ * write compacts; a record cut short by a reset fails its CRC and is
+ * skipped */
+static void prvScanSector(uint32_t ulSector)
+{
+    const FlashStoreRecordHeader_t *pxHeader;
+    uint32_t ulBase = FLASH_STORE_SECTOR_ADDRESS(ulSector);
+    uint32_t ulWord = 1;
+    uint32_t ulWords;
+
+    ulKeyCount = 0;
+
+    while (ulWord < FLASH_STORE_SECTOR_WORDS)
+    {
+        pxHeader = (const FlashStoreRecordHeader_t *) (ulBase + ulWord * FLASH_STORE_WORD_SIZE);
+
+        if (pxHeader->ulMagic == FLASH_STORE_ERASED)
+        {
+            break;
+        }
+
+        ulWords = 1 + FLASH_STORE_DATA_WORDS(pxHeader->usLength);
+        if (pxHeader->ulMagic != FLASH_STORE_RECORD_MAGIC || pxHeader->ulCheck != prvRecordCheck(pxHeader) ||
+            pxHeader->usLength > FLASH_STORE_MAX_DATA_SIZE || ulWord + ulWords > FLASH_STORE_SECTOR_WORDS)
+        {
+            ulWord = FLASH_STORE_SECTOR_WORDS;
+            break;
+        }
+
+        if (prvCrc32((const uint8_t *) (pxHeader + 1), pxHeader->usLength) == pxHeader->ulCrc)
+        {
+            prvSetKey(pxHeader->usKey, pxHeader->usLength, (uint32_t) (pxHeader + 1));
+        }
+
+        ulWord += ulWords;
+    }
+
+    ulFreeWord = ulWord;
+}
+
+/* The sector with the highest sequence is active, the others are to be
+ * erased unless their first two words are: a sector being filled by a
+ * compaction always has its first record there */
+static void prvScan(void)
+{
+    const FlashStoreSectorHeader_t *pxHeader;
+    const FlashStoreSectorHeader_t *pxActive = NULL;
+    const uint32_t *pulWords;
+    uint32_t s;
+    uint32_t i;
+
+    for (s = 0; s < FLASH_STORE_SECTORS; s++)
+    {
+        pxHeader = (const FlashStoreSectorHeader_t *) FLASH_STORE_SECTOR_ADDRESS(s);
+        pulWords = (const uint32_t *) pxHeader;
+
+        eState[s] = FLASH_STORE_STATE_ERASED;
+        for (i = 0; i < 2 * FLASH_STORE_WORD_SIZE / sizeof(uint32_t); i++)
+        {
+            if (pulWords[i] != FLASH_STORE_ERASED)
+            {
+                eState[s] = FLASH_STORE_STATE_DIRTY;
+                break;
+            }
+        }
+
+        if (pxHeader->ulMagic == FLASH_STORE_SECTOR_MAGIC && pxHeader->ulCheck == prvSectorCheck(pxHeader) &&
+            (pxActive == NULL || (int32_t) (pxHeader->ulSequence - pxActive->ulSequence) > 0))
+        {
+            pxActive = pxHeader;
+            ulActive = s;
+        }
+    }
+
+    if (pxActive != NULL)
+    {
+        eState[ulActive] = FLASH_STORE_STATE_ACTIVE;
+        ulSequence = pxActive->ulSequence;
+        memcpy(ulEraseCount, pxActive->ulEraseCount, sizeof(ulEraseCount));
+        prvScanSector(ulActive);
+    }
+}
+
+static BaseType_t prvEraseStoreSector(uint32_t ulSector)
+{
+    if (prvErase(FLASH_STORE_FIRST_SECTOR + ulSector) != pdPASS)
+    {
+        return pdFAIL;
+    }
+
+    ulEraseCount[ulSector]++;
+    eState[ulSector] = FLASH_STORE_STATE_ERASED;
+
+    return pdPASS;
+}
+
+static uint32_t prvFindDirtySector(void)
+{
+    uint32_t s;
+
+    for (s = 0; s < FLASH_STORE_SECTORS; s++)
+    {
+        if (eState[s] == FLASH_STORE_STATE_DIRTY)
+        {
+            break;
+        }
+    }
+
+    return s;
+}
+
+/* Start the next sector with the latest record of every key but the one
+ * being written, then the new record, in ulData; the header goes last, the
+ * previous sector staying active until then */
+static BaseType_t prvCompact(uint32_t ulWords)
+{
+    const FlashStoreRecordHeader_t *pxNew = (const FlashStoreRecordHeader_t *) ulData;
+    FlashStoreSectorHeader_t *pxHeader = (FlashStoreSectorHeader_t *) ulCopy;
+    uint32_t ulMoved[FLASH_STORE_MAX_KEYS];
+    uint32_t ulNewAddress = 0;
+    uint32_t ulTarget;
+    uint32_t ulBase;
+    uint32_t ulWord = 1;
+    uint32_t ulCount;
+    uint32_t i;
+    uint32_t j;
+
+    ulTarget = (ulActive < FLASH_STORE_SECTORS) ? (ulActive + 1) % FLASH_STORE_SECTORS : 0;
+    ulBase = FLASH_STORE_SECTOR_ADDRESS(ulTarget);
+
+    /* The erase the background did not get to */
+    if (eState[ulTarget] != FLASH_STORE_STATE_ERASED && prvEraseStoreSector(ulTarget) != pdPASS)
+    {
+        return pdFAIL;
+    }
+
+    for (i = 0; i < ulKeyCount; i++)
+    {
+        if (xKeys[i].usKey == pxNew->usKey)
+        {
+            continue;
+        }
+
+        ulCount = 1 + FLASH_STORE_DATA_WORDS(xKeys[i].usLength);
+        if (ulWord + ulCount + ulWords > FLASH_STORE_SECTOR_WORDS)
+        {
+            return pdFAIL;
+        }
+
+        /* Through RAM: the bank cannot be read while it programs */
+        for (j = 0; j < ulCount; j++)
+        {
+            memcpy(ulCopy, (const void *) (xKeys[i].ulAddress - FLASH_STORE_WORD_SIZE + j * FLASH_STORE_WORD_SIZE),
+                   FLASH_STORE_WORD_SIZE);
+            if (prvProgram(ulBase + (ulWord + j) * FLASH_STORE_WORD_SIZE, ulCopy, 1) != pdPASS)
+            {
+                eState[ulTarget] = FLASH_STORE_STATE_DIRTY;
+                return pdFAIL;
+            }
+        }
+
+        ulMoved[i] = ulBase + (ulWord + 1) * FLASH_STORE_WORD_SIZE;
+        ulWord += ulCount;
+    }
+
+    if (pxNew->usLength > 0)
+    {
+        if (prvProgram(ulBase + ulWord * FLASH_STORE_WORD_SIZE, ulData, ulWords) != pdPASS)
+        {
+            eState[ulTarget] = FLASH_STORE_STATE_DIRTY;
+            return pdFAIL;
+        }
+        ulNewAddress = ulBase + (ulWord + 1) * FLASH_STORE_WORD_SIZE;
+        ulWord += ulWords;
+    }
+
+    memset(pxHeader, 0xFF, sizeof(ulCopy));
+    pxHeader->ulMagic = FLASH_STORE_SECTOR_MAGIC;
+    pxHeader->ulSequence = ulSequence + 1;
+    memcpy(pxHeader->ulEraseCount, ulEraseCount, sizeof(ulEraseCount));
+    pxHeader->ulCheck = prvSectorCheck(pxHeader);
+
+    if (prvProgram(ulBase, ulCopy, 1) != pdPASS)
+    {
+        eState[ulTarget] = FLASH_STORE_STATE_DIRTY;
+        return pdFAIL;
+    }
+
+    ulSequence++;
+    if (ulActive < FLASH_STORE_SECTORS)
+    {
+        eState[ulActive] = FLASH_STORE_STATE_DIRTY;
+    }
+    eState[ulTarget] = FLASH_STORE_STATE_ACTIVE;
+    ulActive = ulTarget;
+    ulFreeWord = ulWord;
+    ulCompactions++;
+
+    for (i = 0; i < ulKeyCount; i++)
+    {
+        if (xKeys[i].usKey != pxNew->usKey)
+        {
+            xKeys[i].ulAddress = ulMoved[i];
+        }
+    }
+    prvSetKey(pxNew->usKey, pxNew->usLength, ulNewAddress);
+
+    return pdPASS;
+}
+
+/* Record of ulLength bytes received in ulData, after the room of its header */
+static BaseType_t prvWriteRecord(uint16_t usKey, uint32_t ulLength)
+{
+    FlashStoreRecordHeader_t *pxHeader = (FlashStoreRecordHeader_t *) ulData;
+    uint8_t *pucData = (uint8_t *) ulData + FLASH_STORE_WORD_SIZE;
+    uint32_t ulWords = 1 + FLASH_STORE_DATA_WORDS(ulLength);
+    uint32_t ulAddress;
+    BaseType_t xResult;
+
+    if (prvFindKey(usKey) == NULL)
+    {
+        if (ulLength == 0)
+        {
+            return pdPASS;
+        }
+        if (ulKeyCount >= FLASH_STORE_MAX_KEYS)
+        {
+            return pdFAIL;
+        }
+    }
+
+    memset(&pucData[ulLength], 0xFF, (ulWords - 1) * FLASH_STORE_WORD_SIZE - ulLength);
+    memset(pxHeader, 0xFF, sizeof(*pxHeader));
+    pxHeader->ulMagic = FLASH_STORE_RECORD_MAGIC;
+    pxHeader->usKey = usKey;
+    pxHeader->usLength = (uint16_t) ulLength;
+    pxHeader->ulCrc = prvCrc32(pucData, ulLength);
+    pxHeader->ulCheck = prvRecordCheck(pxHeader);
+
+    (void) xSemaphoreTake(xIndexMutex, portMAX_DELAY);
+
+    if (ulActive >= FLASH_STORE_SECTORS || ulFreeWord + ulWords > FLASH_STORE_SECTOR_WORDS)
+    {
+        xResult = prvCompact(ulWords);
+    }
+    else
+    {
+        /* Skipped even if the programming fails, the words cannot be
+         * programmed twice; the record then fails its CRC */
+        ulAddress = FLASH_STORE_SECTOR_ADDRESS(ulActive) + ulFreeWord * FLASH_STORE_WORD_SIZE;
+        ulFreeWord += ulWords;
+
+        xResult = prvProgram(ulAddress, ulData, ulWords);
+        if (xResult == pdPASS)
+        {
+            prvSetKey(usKey, (uint16_t) ulLength, ulAddress + FLASH_STORE_WORD_SIZE);
+        }
+    }
+
+    (void) xSemaphoreGive(xIndexMutex);
+
+    if (xResult == pdPASS)
+    {
+        ulWrites++;
+    }
+
+    return xResult;
+}
+
+/*
+ * Raw requests
+ */
+
+static BaseType_t prvRawErase(uint32_t ulFirstSector, uint32_t ulSectors)
+{
+    uint32_t i;
+
+    if (ulFirstSector < FLASH_STORE_RAW_FIRST_SECTOR || ulSectors > FLASH_STORE_FIRST_SECTOR - ulFirstSector ||
+        ulFirstSector > FLASH_STORE_FIRST_SECTOR)
+    {
+        return pdFAIL;
+    }
+
+    for (i = 0; i < ulSectors; i++)
+    {
+        if (prvErase(ulFirstSector + i) != pdPASS)
+        {
+            return pdFAIL;
+        }
+    }
+
+    return pdPASS;
+}
+
+/* ulLength bytes received at the start of ulData */
+static BaseType_t prvRawProgram(uint32_t ulAddress, uint32_t ulLength)
+{
+    uint32_t ulWords = FLASH_STORE_DATA_WORDS(ulLength);
+
+    if ((ulAddress % FLASH_STORE_WORD_SIZE) != 0 || ulAddress < FLASH_STORE_RAW_ADDRESS ||
+        ulAddress > FLASH_STORE_ADDRESS || ulWords * FLASH_STORE_WORD_SIZE > FLASH_STORE_ADDRESS - ulAddress)
+    {
+        return pdFAIL;
+    }
+
+    memset((uint8_t *) ulData + ulLength, 0xFF, ulWords * FLASH_STORE_WORD_SIZE - ulLength);
+
+    return prvProgram(ulAddress, ulData, ulWords);
+}
+
+/*
+ * Queue
+ */
+
+static BaseType_t prvSubmit(const FlashStoreRequest_t *pxRequest, const void *pvData, TickType_t xTimeout)
+{
+    size_t xLength = (pxRequest->eKind == FLASH_STORE_REQUEST_ERASE) ? 0 : pxRequest->ulCount;
+    TickType_t xStart = xTaskGetTickCount();
+    BaseType_t xResult = pdFAIL;
+
+    if (xQueue == NULL || xLength > FLASH_STORE_MAX_DATA_SIZE || (xLength > 0 && pvData == NULL))
+    {
+        return pdFAIL;
+    }
+
+    if (xSemaphoreTake(xSendMutex, xTimeout) != pdTRUE)
+    {
+        return pdFAIL;
+    }
+
+    for (;;)
+    {
+        if (xStreamBufferSpacesAvailable(xQueue) >= sizeof(*pxRequest) + xLength)
+        {
+            (void) xStreamBufferSend(xQueue, pxRequest, sizeof(*pxRequest), 0);
+            if (xLength > 0)
+            {
+                (void) xStreamBufferSend(xQueue, pvData, xLength, 0);
+            }
+            xResult = pdPASS;
+            break;
+        }
+
+        if (xTaskGetTickCount() - xStart >= xTimeout)
+        {
+            break;
+        }
+
+        /* The store task frees room as it goes */
+        vTaskDelay(1);
+    }
+
+    (void) xSemaphoreGive(xSendMutex);
+
+    return xResult;
+}
+
+/* The data follows its header in the stream, sent right after it */
+static void prvReceiveData(uint8_t *pucData, size_t xLength)
+{
+    size_t xReceived = 0;
+
+    while (xReceived < xLength)
+    {
+        xReceived += xStreamBufferReceive(xQueue, &pucData[xReceived], xLength - xReceived, portMAX_DELAY);
+    }
+}
+
+static void prvFlashStoreTask(void *pvParameters)
+{
+    FlashStoreRequest_t xRequest;
+    TickType_t xWait;
+    BaseType_t xResult;
+    uint32_t ulDirty;
+
+    (void) pvParameters;
+
+    for (;;)
+    {
+        ulDirty = prvFindDirtySector();
+        xWait = (ulDirty < FLASH_STORE_SECTORS) ? pdMS_TO_TICKS(FLASH_STORE_ERASE_IDLE_MS) : portMAX_DELAY;
+
+        if (xStreamBufferReceive(xQueue, &xRequest, sizeof(xRequest), xWait) != sizeof(xRequest))
+        {
+            /* Idle: get the next sector ready for a compaction */
+            if (ulDirty < FLASH_STORE_SECTORS && prvEraseStoreSector(ulDirty) != pdPASS)
+            {
+                ulErrors++;
+            }
+            continue;
+        }
+
+        switch (xRequest.eKind)
+        {
+        case FLASH_STORE_REQUEST_WRITE:
+            prvReceiveData((uint8_t *) ulData + FLASH_STORE_WORD_SIZE, xRequest.ulCount);
+            xResult = prvWriteRecord((uint16_t) xRequest.ulTarget, xRequest.ulCount);
+            break;
+        case FLASH_STORE_REQUEST_PROGRAM:
+            prvReceiveData((uint8_t *) ulData, xRequest.ulCount);
+            xResult = prvRawProgram(xRequest.ulTarget, xRequest.ulCount);
+            break;
+        default:
+            xResult = prvRawErase(xRequest.ulTarget, xRequest.ulCount);
+            break;
+        }
+
+        if (xResult != pdPASS)
+        {
+            ulErrors++;
+        }
+
+        if (xRequest.pxCallback != NULL)
+        {
+            xRequest.pxCallback(xResult, xRequest.pvParam);
+        }
+    }
+}
+
+/*
+ * API
+ */
+
+static void prvRelocateVectors(void)
+{
+    const uint32_t *pulVectors = (const uint32_t *) SCB->VTOR;
+    uint32_t i;
+
+    for (i = 0; i < FLASH_STORE_VECTOR_COUNT; i++)
+    {
+        ulVectors[i] = pulVectors[i];
+    }
+
+    __DSB();
+    SCB->VTOR = (uint32_t) ulVectors;
+    __DSB();
+    __ISB();
+}
+
+BaseType_t xFlashStoreStart(UBaseType_t uxPriority)
+{
+    prvRelocateVectors();
+    prvScan();
+
+    xQueue = xAppStreamBufferCreate(xQueue, FLASH_STORE_QUEUE_SIZE, sizeof(FlashStoreRequest_t));
+    xIndexMutex = xAppSemaphoreCreateMutex(xIndexMutex);
+    xSendMutex = xAppSemaphoreCreateMutex(xSendMutex);
+    if (xQueue == NULL || xIndexMutex == NULL || xSendMutex == NULL)
+    {
+        return pdFAIL;
+    }
+
+    return xAppTaskCreate(xStoreTask, prvFlashStoreTask, "FlashStore", FLASH_STORE_STACK_SIZE,
+                          NULL, uxPriority, &xStoreTask);
+}
+
+BaseType_t xFlashStoreWrite(uint16_t usKey, const void *pvData, size_t xLength,
+                            FlashStoreCallback_t pxCallback, void *pvParam, TickType_t xTimeout)
+{
+    FlashStoreRequest_t xRequest;
+
+    xRequest.eKind = FLASH_STORE_REQUEST_WRITE;
+    xRequest.ulTarget = usKey;
+    xRequest.ulCount = (uint32_t) xLength;
+    xRequest.pxCallback = pxCallback;
+    xRequest.pvParam = pvParam;
+
+    return prvSubmit(&xRequest, pvData, xTimeout);
+}
+
+BaseType_t xFlashStoreErase(uint32_t ulFirstSector, uint32_t ulSectors,
+                            FlashStoreCallback_t pxCallback, void *pvParam, TickType_t xTimeout)
+{
+    FlashStoreRequest_t xRequest;
+
+    xRequest.eKind = FLASH_STORE_REQUEST_ERASE;
+    xRequest.ulTarget = ulFirstSector;
+    xRequest.ulCount = ulSectors;
+    xRequest.pxCallback = pxCallback;
+    xRequest.pvParam = pvParam;
+
+    return prvSubmit(&xRequest, NULL, xTimeout);
+}
+
+BaseType_t xFlashStoreProgram(uint32_t ulAddress, const void *pvData, size_t xLength,
+                              FlashStoreCallback_t pxCallback, void *pvParam, TickType_t xTimeout)
+{
+    FlashStoreRequest_t xRequest;
+
+    xRequest.eKind = FLASH_STORE_REQUEST_PROGRAM;
+    xRequest.ulTarget = ulAddress;
+    xRequest.ulCount = (uint32_t) xLength;
+    xRequest.pxCallback = pxCallback;
+    xRequest.pvParam = pvParam;
+
+    return prvSubmit(&xRequest, pvData, xTimeout);
+}
+
+/* Before the scheduler starts, the store task cannot be programming and
+ * the mutex is not needed */
+BaseType_t xFlashStoreRead(uint16_t usKey, void *pvData, size_t xSize, size_t *pxLength)
+{
+    const FlashStoreKey_t *pxKey;
+    BaseType_t xLocked = (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED) ? pdTRUE : pdFALSE;
+    BaseType_t xResult = pdFAIL;
+
+    if (xLocked == pdTRUE)
+    {
+        (void) xSemaphoreTake(xIndexMutex, portMAX_DELAY);
+    }
+
+    pxKey = prvFindKey(usKey);
+    if (pxKey != NULL)
+    {
+        *pxLength = pxKey->usLength;
+        memcpy(pvData, (const void *) pxKey->ulAddress, (pxKey->usLength < xSize) ? pxKey->usLength : xSize);
+        xResult = pdPASS;
+    }
+
+    if (xLocked == pdTRUE)
+    {
+        (void) xSemaphoreGive(xIndexMutex);
+    }
+
+    return xResult;
+}
+
+void vFlashStoreGetStats(FlashStoreStats_t *pxStats)
+{
+    pxStats->ulActiveSector = ulActive;
+    pxStats->ulUsedBytes = (ulActive < FLASH_STORE_SECTORS) ? ulFreeWord * FLASH_STORE_WORD_SIZE : 0;
+    pxStats->ulKeys = ulKeyCount;
+    pxStats->ulWrites = ulWrites;
+    pxStats->ulCompactions = ulCompactions;
+    pxStats->ulErases = ulErases;
+    pxStats->ulPrograms = ulPrograms;
+    pxStats->ulErrors = ulErrors;
+    pxStats->ulQueued = (xQueue != NULL) ? (uint32_t) xStreamBufferBytesAvailable(xQueue) : 0;
+    memcpy(pxStats->ulEraseCount, ulEraseCount, sizeof(ulEraseCount));
+    pxStats->xErasePending = (prvFindDirtySector() < FLASH_STORE_SECTORS) ? pdTRUE : pdFALSE;
+}
+
+void vFlashStoreRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xFlashStore);
+}
+
+static BaseType_t prvFlashStoreCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    static FlashStoreStats_t xStats;
+    uint32_t s;
+
+    (void) pcCommandString;
+
+    if (uxFlashStoreLine == 0)
+    {
+        vFlashStoreGetStats(&xStats);
+        if (xStats.ulActiveSector < FLASH_STORE_SECTORS)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "active sector %lu: %lu of %lu bytes, %lu keys\r\n",
+                     (unsigned long) (FLASH_STORE_FIRST_SECTOR + xStats.ulActiveSector),
+                     (unsigned long) xStats.ulUsedBytes, (unsigned long) FLASH_SECTOR_SIZE,
+                     (unsigned long) xStats.ulKeys);
+        }
+        else
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "no active sector, %lu keys\r\n", (unsigned long) xStats.ulKeys);
+        }
+        uxFlashStoreLine++;
+        return pdTRUE;
+    }
+
+    if (uxFlashStoreLine <= FLASH_STORE_SECTORS)
+    {
+        s = (uint32_t) uxFlashStoreLine - 1;
+        snprintf(pcWriteBuffer, xWriteBufferLen, "sector %lu: %lu erases\r\n",
+                 (unsigned long) (FLASH_STORE_FIRST_SECTOR + s), (unsigned long) xStats.ulEraseCount[s]);
+        uxFlashStoreLine++;
+        return pdTRUE;
+    }
+
+    if (uxFlashStoreLine == FLASH_STORE_SECTORS + 1)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "writes=%lu, compactions=%lu, erases=%lu, words=%lu, errors=%lu\r\n",
+                 (unsigned long) xStats.ulWrites, (unsigned long) xStats.ulCompactions,
+                 (unsigned long) xStats.ulErases, (unsigned long) xStats.ulPrograms,
+                 (unsigned long) xStats.ulErrors);
+        uxFlashStoreLine++;
+        return pdTRUE;
+    }
+
+    snprintf(pcWriteBuffer, xWriteBufferLen, "queue: %lu of %lu bytes, erase %s\r\n",
+             (unsigned long) xStats.ulQueued, (unsigned long) FLASH_STORE_QUEUE_SIZE,
+             (xStats.xErasePending != pdFALSE) ? "pending" : "none pending");
+    uxFlashStoreLine = 0;
+
+    return pdFALSE;
+}
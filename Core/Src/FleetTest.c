@@ -0,0 +1,1076 @@
+/* FleetTest.c
+ *
+ * Senders, receivers and counters of the fleet test (see FleetTest.h).
+ *
+ * The CLI writes the configuration under xFleetMutex and wakes the task
+ * through xFleetEvent. The task owns the sockets: it publishes the Cyphal
+ * messages and writes the TCP records when they are due, accepts and reads
+ * the streams of the other nodes, and sleeps in socketPoll() until the next
+ * send time. The Cyphal messages are received in the node task, through
+ * the subscription callback. The peer table and the counters are shared by
+ * both tasks and the CLI, under xFleetMutex.
+ *
+ * A message or record starts with a header, little endian like the Cyphal
+ * serialization: magic (16 bits), total length (16 bits), sequence number
+ * (32 bits), send time on the reference timescale in microseconds, 0 when
+ * the sender is not synchronized (64 bits). The rest is padding.
+ */
+#include "FleetTest.h"
+#include "task.h"
+#include "semphr.h"
+#include "FreeRTOS_CLI.h"
+#include "StaticAlloc.h"
+#include "MonoClock.h"
+#include "RunTimeStats.h"
+#include "CyphalNode.h"
+#include "PtpSlave.h"
+#include "core/net.h"
+#include "core/socket.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FLEET_TEST_MAGIC               0x4654u     /* "FT" */
+
+/* Longest sleep of the task, bounds the reaction to a closed stream */
+#define FLEET_TEST_POLL_MS             100u
+
+/* Connection attempt of the stream source */
+#define FLEET_TEST_CONNECT_TIMEOUT_MS  2000u
+
+/* Reads per stream and per wake-up, so that one stream cannot starve the
+ * others */
+#define FLEET_TEST_READS_PER_WAKE      8u
+
+typedef enum
+{
+    eFleetCyphal = 0,
+    eFleetTcp
+} FleetKind_t;
+
+typedef struct
+{
+    uint8_t ucKind;                 /* FleetKind_t */
+    uint32_t ulId;                  /* Node-ID, or IPv4 address */
+    uint32_t ulReceived;
+    uint64_t ullBytes;
+    uint32_t ulLost;                /* Sequence gaps not filled since */
+    uint32_t ulReordered;           /* Late or duplicate sequence numbers */
+    uint32_t ulNextSeq;
+    uint32_t ulLatencyCount;        /* Messages from a synchronized sender */
+    uint32_t ulMinUs;
+    uint32_t ulMaxUs;
+    uint64_t ullSumUs;
+    uint32_t ulHist[FLEET_TEST_HIST_BUCKETS];
+} FleetPeer_t;
+
+typedef struct
+{
+    BaseType_t xListen;
+    uint32_t ulPublishHz;           /* 0 when not publishing */
+    size_t xPublishSize;
+    BaseType_t xServer;
+    BaseType_t xTcp;
+    IpAddr xTcpPeer;
+    uint32_t ulTcpHz;               /* 0 for as fast as the connection goes */
+    size_t xTcpSize;
+    uint32_t ulTcpGeneration;       /* Changed by every "fleet tcp", to reconnect */
+} FleetConfig_t;
+
+typedef struct
+{
+    uint32_t ulPublished;
+    uint64_t ullPublishedBytes;
+    uint32_t ulPublishErrors;       /* Cyphal TX queue full */
+    uint32_t ulTcpRecords;
+    uint64_t ullTcpBytes;
+    uint32_t ulTcpErrors;           /* Failed connections and resets */
+    uint32_t ulTcpBlocked;          /* Records due while the last one was still pending */
+    uint32_t ulUnknownPeers;        /* Messages from peers beyond the table */
+    uint32_t ulUnsynced;            /* Messages without both timestamps */
+    uint32_t ulClockErrors;         /* Received before they were sent */
+    uint32_t ulMalformed;
+} FleetCounters_t;
+
+/* Inbound stream */
+typedef struct
+{
+    Socket *pxSocket;               /* NULL for a free entry */
+    Ipv4Addr xPeer;
+    size_t xHeaderUsed;
+    size_t xSkip;                   /* Padding left of the current record */
+    uint8_t ucHeader[FLEET_TEST_HEADER_SIZE];
+} FleetConnection_t;
+
+/* Shared, under xFleetMutex */
+static FleetConfig_t xConfig;
+static FleetCounters_t xCounters;
+static FleetPeer_t xPeers[FLEET_TEST_MAX_PEERS];
+static UBaseType_t uxPeerCount = 0;
+static uint64_t ullResetUs;
+static RunTimeLoadSample_t xResetLoad;
+static UBaseType_t uxConnectionCount = 0;
+
+static SemaphoreHandle_t xFleetMutex = NULL;
+static OsEvent xFleetEvent;
+static BaseType_t xSubscribed = pdFALSE;
+
+/* Owned by the task */
+static FleetConnection_t xConnections[FLEET_TEST_MAX_CONNECTIONS];
+static uint8_t ucTx[FLEET_TEST_MAX_SIZE];
+static uint8_t ucRecord[FLEET_TEST_MAX_SIZE];
+static uint8_t ucDiscard[256];
+
+APP_TASK_STORAGE(xFleetTask, FLEET_TEST_TASK_STACK_SIZE);
+APP_MUTEX_STORAGE(xFleetMutex);
+
+/* Reference time of a local time, 0 when not synchronized */
+static uint64_t prvReferenceUs(uint64_t ullLocalUs)
+{
+    return ullMonoClockToReferenceUs(ullLocalUs);
+}
+
+static void prvWriteHeader(uint8_t *pucHeader, size_t xLength, uint32_t ulSeq, uint64_t ullTxUs)
+{
+    UBaseType_t i;
+
+    pucHeader[0] = (uint8_t) FLEET_TEST_MAGIC;
+    pucHeader[1] = (uint8_t) (FLEET_TEST_MAGIC >> 8);
+    pucHeader[2] = (uint8_t) xLength;
+    pucHeader[3] = (uint8_t) (xLength >> 8);
+    for (i = 0; i < 4; i++)
+    {
+        pucHeader[4 + i] = (uint8_t) (ulSeq >> (8 * i));
+    }
+    for (i = 0; i < 8; i++)
+    {
+        pucHeader[8 + i] = (uint8_t) (ullTxUs >> (8 * i));
+    }
+}
+
+/* pdFALSE if the header is not one of the test */
+static BaseType_t prvReadHeader(const uint8_t *pucHeader, size_t *pxLength, uint32_t *pulSeq, uint64_t *pullTxUs)
+{
+    UBaseType_t i;
+
+    if ((pucHeader[0] | (pucHeader[1] << 8)) != FLEET_TEST_MAGIC)
+    {
+        return pdFALSE;
+    }
+
+    *pxLength = (size_t) (pucHeader[2] | (pucHeader[3] << 8));
+    *pulSeq = 0;
+    *pullTxUs = 0;
+    for (i = 0; i < 4; i++)
+    {
+        *pulSeq |= (uint32_t) pucHeader[4 + i] << (8 * i);
+    }
+    for (i = 0; i < 8; i++)
+    {
+        *pullTxUs |= (uint64_t) pucHeader[8 + i] << (8 * i);
+    }
+
+    return (*pxLength >= FLEET_TEST_HEADER_SIZE && *pxLength <= FLEET_TEST_MAX_SIZE) ? pdTRUE : pdFALSE;
+}
+
+/* Entry of a peer, created on its first message; xFleetMutex held */
+static FleetPeer_t *prvPeer(FleetKind_t eKind, uint32_t ulId)
+{
+    FleetPeer_t *pxPeer;
+    UBaseType_t i;
+
+    for (i = 0; i < uxPeerCount; i++)
+    {
+        if (xPeers[i].ucKind == (uint8_t) eKind && xPeers[i].ulId == ulId)
+        {
+            return &xPeers[i];
+        }
+    }
+
+    if (uxPeerCount == FLEET_TEST_MAX_PEERS)
+    {
+        return NULL;
+    }
+
+    pxPeer = &xPeers[uxPeerCount++];
+    memset(pxPeer, 0, sizeof(*pxPeer));
+    pxPeer->ucKind = (uint8_t) eKind;
+    pxPeer->ulId = ulId;
+    pxPeer->ulMinUs = UINT32_MAX;
+
+    return pxPeer;
+}
+
+/* Account for a message or record received at ullRxUs (reference time) */
+static void prvRecord(FleetKind_t eKind, uint32_t ulId, uint32_t ulSeq, size_t xLength, uint64_t ullTxUs,
+                      uint64_t ullRxUs)
+{
+    FleetPeer_t *pxPeer;
+    uint32_t ulLatencyUs;
+    UBaseType_t uxBucket;
+
+    xSemaphoreTake(xFleetMutex, portMAX_DELAY);
+
+    pxPeer = prvPeer(eKind, ulId);
+    if (pxPeer == NULL)
+    {
+        xCounters.ulUnknownPeers++;
+        xSemaphoreGive(xFleetMutex);
+        return;
+    }
+
+    /* Sequence: the first message sets the expected number */
+    if (pxPeer->ulReceived == 0 || ulSeq == pxPeer->ulNextSeq)
+    {
+        pxPeer->ulNextSeq = ulSeq + 1u;
+    }
+    else if ((int32_t) (ulSeq - pxPeer->ulNextSeq) > 0)
+    {
+        pxPeer->ulLost += ulSeq - pxPeer->ulNextSeq;
+        pxPeer->ulNextSeq = ulSeq + 1u;
+    }
+    else
+    {
+        /* Late: it was counted lost when the gap was seen */
+        pxPeer->ulReordered++;
+        if (pxPeer->ulLost > 0)
+        {
+            pxPeer->ulLost--;
+        }
+    }
+
+    pxPeer->ulReceived++;
+    pxPeer->ullBytes += xLength;
+
+    if (ullTxUs == 0 || ullRxUs == 0)
+    {
+        xCounters.ulUnsynced++;
+    }
+    else if (ullRxUs < ullTxUs)
+    {
+        xCounters.ulClockErrors++;
+    }
+    else
+    {
+        ulLatencyUs = (ullRxUs - ullTxUs > UINT32_MAX) ? UINT32_MAX : (uint32_t) (ullRxUs - ullTxUs);
+
+        pxPeer->ulLatencyCount++;
+        pxPeer->ullSumUs += ulLatencyUs;
+        if (ulLatencyUs < pxPeer->ulMinUs)
+        {
+            pxPeer->ulMinUs = ulLatencyUs;
+        }
+        if (ulLatencyUs > pxPeer->ulMaxUs)
+        {
+            pxPeer->ulMaxUs = ulLatencyUs;
+        }
+
+        /* Bucket b > 0 holds [32 << b, 64 << b) */
+        uxBucket = (ulLatencyUs < 64u) ? 0u : (UBaseType_t) (31 - __builtin_clz(ulLatencyUs)) - 5u;
+        if (uxBucket >= FLEET_TEST_HIST_BUCKETS)
+        {
+            uxBucket = FLEET_TEST_HIST_BUCKETS - 1u;
+        }
+        pxPeer->ulHist[uxBucket]++;
+    }
+
+    xSemaphoreGive(xFleetMutex);
+}
+
+/* Messages of the subject, in the node task */
+static void prvReceived(const struct UdpardRxTransfer *pxTransfer, void *pvParam)
+{
+    uint8_t ucHeader[FLEET_TEST_HEADER_SIZE];
+    size_t xLength;
+    uint32_t ulSeq;
+    uint64_t ullTxUs;
+
+    (void) pvParam;
+
+    if (!xConfig.xListen)
+    {
+        return;
+    }
+
+    if (udpardGather(pxTransfer->payload, sizeof(ucHeader), ucHeader) < sizeof(ucHeader) ||
+        !prvReadHeader(ucHeader, &xLength, &ulSeq, &ullTxUs))
+    {
+        xSemaphoreTake(xFleetMutex, portMAX_DELAY);
+        xCounters.ulMalformed++;
+        xSemaphoreGive(xFleetMutex);
+        return;
+    }
+
+    prvRecord(eFleetCyphal, pxTransfer->source_node_id, ulSeq, pxTransfer->payload_size, ullTxUs,
+              prvReferenceUs(pxTransfer->timestamp_usec));
+}
+
+static void prvCloseConnection(FleetConnection_t *pxConnection)
+{
+    socketClose(pxConnection->pxSocket);
+    pxConnection->pxSocket = NULL;
+    uxConnectionCount--;
+}
+
+static void prvAccept(Socket *pxListener)
+{
+    FleetConnection_t *pxConnection = NULL;
+    Socket *pxSocket;
+    IpAddr xPeer;
+    uint16_t usPort;
+    UBaseType_t i;
+
+    pxSocket = socketAccept(pxListener, &xPeer, &usPort);
+    if (pxSocket == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < FLEET_TEST_MAX_CONNECTIONS; i++)
+    {
+        if (xConnections[i].pxSocket == NULL)
+        {
+            pxConnection = &xConnections[i];
+            break;
+        }
+    }
+
+    /* Full: the sender sees a reset and counts an error */
+    if (pxConnection == NULL || xPeer.length != sizeof(Ipv4Addr))
+    {
+        socketClose(pxSocket);
+        return;
+    }
+
+    pxConnection->pxSocket = pxSocket;
+    pxConnection->xPeer = xPeer.ipv4Addr;
+    pxConnection->xHeaderUsed = 0;
+    pxConnection->xSkip = 0;
+    uxConnectionCount++;
+}
+
+static void prvReceiveStream(FleetConnection_t *pxConnection)
+{
+    size_t xReceived;
+    size_t xLength;
+    uint32_t ulSeq;
+    uint64_t ullTxUs;
+    error_t xError;
+    UBaseType_t i;
+
+    for (i = 0; i < FLEET_TEST_READS_PER_WAKE; i++)
+    {
+        if (pxConnection->xSkip > 0)
+        {
+            xError = socketReceive(pxConnection->pxSocket, ucDiscard, MIN(pxConnection->xSkip, sizeof(ucDiscard)),
+                                   &xReceived, SOCKET_FLAG_DONT_WAIT);
+            pxConnection->xSkip -= xReceived;
+        }
+        else
+        {
+            xError = socketReceive(pxConnection->pxSocket, &pxConnection->ucHeader[pxConnection->xHeaderUsed],
+                                   FLEET_TEST_HEADER_SIZE - pxConnection->xHeaderUsed, &xReceived,
+                                   SOCKET_FLAG_DONT_WAIT);
+            pxConnection->xHeaderUsed += xReceived;
+
+            if (pxConnection->xHeaderUsed == FLEET_TEST_HEADER_SIZE)
+            {
+                pxConnection->xHeaderUsed = 0;
+                if (!prvReadHeader(pxConnection->ucHeader, &xLength, &ulSeq, &ullTxUs))
+                {
+                    /* Lost framing: nothing more can be trusted */
+                    xSemaphoreTake(xFleetMutex, portMAX_DELAY);
+                    xCounters.ulMalformed++;
+                    xSemaphoreGive(xFleetMutex);
+                    prvCloseConnection(pxConnection);
+                    return;
+                }
+
+                prvRecord(eFleetTcp, pxConnection->xPeer, ulSeq, xLength, ullTxUs,
+                          prvReferenceUs(ullMonoClockNowUs()));
+                pxConnection->xSkip = xLength - FLEET_TEST_HEADER_SIZE;
+            }
+        }
+
+        if (xError == ERROR_TIMEOUT || xReceived == 0)
+        {
+            /* Nothing left for now */
+            if (xError == NO_ERROR || xError == ERROR_TIMEOUT)
+            {
+                return;
+            }
+            break;
+        }
+        if (xError != NO_ERROR)
+        {
+            break;
+        }
+    }
+
+    /* End of the stream, or reset */
+    if (i < FLEET_TEST_READS_PER_WAKE)
+    {
+        prvCloseConnection(pxConnection);
+    }
+}
+
+static void prvStopServer(Socket **ppxListener)
+{
+    UBaseType_t i;
+
+    for (i = 0; i < FLEET_TEST_MAX_CONNECTIONS; i++)
+    {
+        if (xConnections[i].pxSocket != NULL)
+        {
+            prvCloseConnection(&xConnections[i]);
+        }
+    }
+
+    if (*ppxListener != NULL)
+    {
+        socketClose(*ppxListener);
+        *ppxListener = NULL;
+    }
+}
+
+static Socket *prvStartServer(void)
+{
+    Socket *pxListener;
+
+    pxListener = socketOpen(SOCKET_TYPE_STREAM, SOCKET_IP_PROTO_TCP);
+    if (pxListener == NULL)
+    {
+        return NULL;
+    }
+
+    if (socketBind(pxListener, &IP_ADDR_ANY, FLEET_TEST_TCP_PORT) != NO_ERROR ||
+        socketListen(pxListener, FLEET_TEST_MAX_CONNECTIONS) != NO_ERROR)
+    {
+        socketClose(pxListener);
+        return NULL;
+    }
+
+    return pxListener;
+}
+
+static Socket *prvConnect(const IpAddr *pxPeer)
+{
+    Socket *pxSocket;
+
+    pxSocket = socketOpen(SOCKET_TYPE_STREAM, SOCKET_IP_PROTO_TCP);
+    if (pxSocket == NULL)
+    {
+        return NULL;
+    }
+
+    socketSetTimeout(pxSocket, FLEET_TEST_CONNECT_TIMEOUT_MS);
+    if (socketConnect(pxSocket, pxPeer, FLEET_TEST_TCP_PORT) != NO_ERROR)
+    {
+        socketClose(pxSocket);
+        return NULL;
+    }
+
+    return pxSocket;
+}
+
+/* Write what is left of the current record; pdFALSE if the stream failed */
+static BaseType_t prvSendRecord(Socket *pxSocket, size_t xSize, size_t *pxOffset, BaseType_t xPaced)
+{
+    size_t xWritten = 0;
+    error_t xError;
+
+    xError = socketSend(pxSocket, &ucRecord[*pxOffset], xSize - *pxOffset, &xWritten,
+                        SOCKET_FLAG_DONT_WAIT | (xPaced ? SOCKET_FLAG_NO_DELAY : 0));
+    *pxOffset += xWritten;
+
+    if (xError != NO_ERROR && xError != ERROR_TIMEOUT)
+    {
+        return pdFALSE;
+    }
+
+    if (*pxOffset == xSize)
+    {
+        xSemaphoreTake(xFleetMutex, portMAX_DELAY);
+        xCounters.ulTcpRecords++;
+        xCounters.ullTcpBytes += xSize;
+        xSemaphoreGive(xFleetMutex);
+    }
+
+    return pdTRUE;
+}
+
+static void prvFleetTestTask(void *pvParameters)
+{
+    SocketEventDesc xEvents[2 + FLEET_TEST_MAX_CONNECTIONS];
+    FleetConnection_t *pxOwners[2 + FLEET_TEST_MAX_CONNECTIONS];
+    FleetConfig_t xRun;
+    Socket *pxListener = NULL;
+    Socket *pxClient = NULL;
+    UdpardTransferID xTransferId = 0;
+    uint32_t ulTcpGeneration = 0;
+    uint32_t ulPublishSeq = 0;
+    uint32_t ulTcpSeq = 0;
+    uint64_t ullNextPublishUs = 0;
+    uint64_t ullNextRecordUs = 0;
+    uint64_t ullNowUs;
+    uint64_t ullWakeUs;
+    size_t xRecordOffset = 0;
+    BaseType_t xPublished;
+    BaseType_t xSendNow;
+    UBaseType_t uxCount;
+    UBaseType_t i;
+    systime_t xWait;
+
+    (void) pvParameters;
+
+    for (;;)
+    {
+        xSemaphoreTake(xFleetMutex, portMAX_DELAY);
+        xRun = xConfig;
+        xSemaphoreGive(xFleetMutex);
+
+        /* Server on or off */
+        if (xRun.xServer && pxListener == NULL)
+        {
+            pxListener = prvStartServer();
+        }
+        else if (!xRun.xServer && pxListener != NULL)
+        {
+            prvStopServer(&pxListener);
+        }
+
+        /* Stream source: off, retargeted, or to (re)connect */
+        if (pxClient != NULL && (!xRun.xTcp || xRun.ulTcpGeneration != ulTcpGeneration))
+        {
+            socketClose(pxClient);
+            pxClient = NULL;
+        }
+        if (xRun.xTcp && pxClient == NULL)
+        {
+            ulTcpGeneration = xRun.ulTcpGeneration;
+            pxClient = prvConnect(&xRun.xTcpPeer);
+            xRecordOffset = xRun.xTcpSize;
+            ullNextRecordUs = ullMonoClockNowUs();
+            if (pxClient == NULL)
+            {
+                xSemaphoreTake(xFleetMutex, portMAX_DELAY);
+                xCounters.ulTcpErrors++;
+                xSemaphoreGive(xFleetMutex);
+            }
+        }
+
+        ullNowUs = ullMonoClockNowUs();
+        ullWakeUs = ullNowUs + FLEET_TEST_POLL_MS * 1000u;
+
+        /* Cyphal message due */
+        if (xRun.ulPublishHz != 0)
+        {
+            if (ullNextPublishUs == 0 || ullNowUs > ullNextPublishUs + 1000000u / xRun.ulPublishHz * 4u)
+            {
+                /* First message, or too far behind to catch up */
+                ullNextPublishUs = ullNowUs;
+            }
+
+            if (ullNowUs >= ullNextPublishUs)
+            {
+                prvWriteHeader(ucTx, xRun.xPublishSize, ulPublishSeq, prvReferenceUs(ullMonoClockNowUs()));
+                xPublished = xCyphalNodePublish(FLEET_TEST_SUBJECT_ID, UdpardPriorityNominal, &xTransferId, ucTx,
+                                                xRun.xPublishSize, FLEET_TEST_TX_TIMEOUT_US);
+
+                /* A message not queued keeps its number: the receivers see a gap */
+                ulPublishSeq++;
+                xSemaphoreTake(xFleetMutex, portMAX_DELAY);
+                if (xPublished == pdPASS)
+                {
+                    xCounters.ulPublished++;
+                    xCounters.ullPublishedBytes += xRun.xPublishSize;
+                }
+                else
+                {
+                    xCounters.ulPublishErrors++;
+                }
+                xSemaphoreGive(xFleetMutex);
+
+                ullNextPublishUs += 1000000u / xRun.ulPublishHz;
+            }
+
+            if (ullNextPublishUs < ullWakeUs)
+            {
+                ullWakeUs = ullNextPublishUs;
+            }
+        }
+        else
+        {
+            ullNextPublishUs = 0;
+        }
+
+        /* TCP record due, or the stream to fill */
+        if (pxClient != NULL)
+        {
+            xSendNow = pdFALSE;
+            if (xRun.ulTcpHz == 0)
+            {
+                xSendNow = pdTRUE;
+            }
+            else if (ullNowUs >= ullNextRecordUs)
+            {
+                if (xRecordOffset < xRun.xTcpSize)
+                {
+                    xSemaphoreTake(xFleetMutex, portMAX_DELAY);
+                    xCounters.ulTcpBlocked++;
+                    xSemaphoreGive(xFleetMutex);
+                }
+                else
+                {
+                    xSendNow = pdTRUE;
+                }
+                ullNextRecordUs += 1000000u / xRun.ulTcpHz;
+                if (ullNextRecordUs < ullNowUs)
+                {
+                    ullNextRecordUs = ullNowUs + 1000000u / xRun.ulTcpHz;
+                }
+            }
+
+            /* A new record once the last one is out */
+            if (xSendNow && xRecordOffset >= xRun.xTcpSize)
+            {
+                prvWriteHeader(ucRecord, xRun.xTcpSize, ulTcpSeq++, prvReferenceUs(ullMonoClockNowUs()));
+                xRecordOffset = 0;
+            }
+
+            if (xRecordOffset < xRun.xTcpSize &&
+                !prvSendRecord(pxClient, xRun.xTcpSize, &xRecordOffset, (xRun.ulTcpHz != 0) ? pdTRUE : pdFALSE))
+            {
+                socketClose(pxClient);
+                pxClient = NULL;
+                xSemaphoreTake(xFleetMutex, portMAX_DELAY);
+                xCounters.ulTcpErrors++;
+                xSemaphoreGive(xFleetMutex);
+            }
+
+            if (xRun.ulTcpHz != 0 && ullNextRecordUs < ullWakeUs)
+            {
+                ullWakeUs = ullNextRecordUs;
+            }
+        }
+
+        /* The listener, the streams, and the source while it has data to write */
+        uxCount = 0;
+        if (pxListener != NULL)
+        {
+            xEvents[uxCount].socket = pxListener;
+            xEvents[uxCount].eventMask = SOCKET_EVENT_ACCEPT;
+            pxOwners[uxCount++] = NULL;
+        }
+        for (i = 0; i < FLEET_TEST_MAX_CONNECTIONS; i++)
+        {
+            if (xConnections[i].pxSocket != NULL)
+            {
+                xEvents[uxCount].socket = xConnections[i].pxSocket;
+                xEvents[uxCount].eventMask = SOCKET_EVENT_RX_READY;
+                pxOwners[uxCount++] = &xConnections[i];
+            }
+        }
+        if (pxClient != NULL && (xRun.ulTcpHz == 0 || xRecordOffset < xRun.xTcpSize))
+        {
+            xEvents[uxCount].socket = pxClient;
+            xEvents[uxCount].eventMask = SOCKET_EVENT_TX_READY;
+            pxOwners[uxCount++] = NULL;
+        }
+
+        for (i = 0; i < uxCount; i++)
+        {
+            xEvents[i].eventFlags = 0;
+        }
+
+        ullNowUs = ullMonoClockNowUs();
+        xWait = (ullWakeUs > ullNowUs) ? (systime_t) ((ullWakeUs - ullNowUs) / 1000u) : 0;
+
+        if (uxCount == 0)
+        {
+            (void) osWaitForEvent(&xFleetEvent, xWait);
+        }
+        else if (socketPoll(xEvents, uxCount, &xFleetEvent, xWait) == NO_ERROR)
+        {
+            for (i = 0; i < uxCount; i++)
+            {
+                if (pxOwners[i] != NULL && (xEvents[i].eventFlags & SOCKET_EVENT_RX_READY) != 0)
+                {
+                    prvReceiveStream(pxOwners[i]);
+                }
+                else if (xEvents[i].socket == pxListener && (xEvents[i].eventFlags & SOCKET_EVENT_ACCEPT) != 0)
+                {
+                    prvAccept(pxListener);
+                }
+            }
+        }
+    }
+}
+
+BaseType_t xFleetTestStart(UBaseType_t uxPriority)
+{
+    xFleetMutex = xAppSemaphoreCreateMutex(xFleetMutex);
+    if (xFleetMutex == NULL || !osCreateEvent(&xFleetEvent))
+    {
+        return pdFAIL;
+    }
+
+    memset(&xConfig, 0, sizeof(xConfig));
+    ullResetUs = ullMonoClockNowUs();
+    vRunTimeStatsGetLoadSample(&xResetLoad);
+
+    return xAppTaskCreate(xFleetTask,
+                          prvFleetTestTask,
+                          "Fleet",
+                          FLEET_TEST_TASK_STACK_SIZE,
+                          NULL,
+                          uxPriority,
+                          NULL);
+}
+
+static BaseType_t prvFleetCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xFleet =
+{
+    "fleet",
+    "\r\nfleet [reset|stop|peers [n]|listen|server on|off|publish <hz> <bytes>|off|tcp <ip> <hz> <bytes>|off]:\r\n Fleet test\r\n",
+    prvFleetCommand,
+    -1
+};
+
+/* Report state: "fleet" prints the status lines, "fleet peers" a page */
+static UBaseType_t uxFleetLine = 0;
+static UBaseType_t uxFleetPeer;
+static UBaseType_t uxFleetLast;
+
+/* Parameter uxIndex as a number, ulDefault if absent */
+static uint32_t prvNumber(const char *pcCommandString, UBaseType_t uxIndex, uint32_t ulDefault)
+{
+    const char *pcParameter;
+    BaseType_t xLength;
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, uxIndex, &xLength);
+    return (pcParameter != NULL) ? (uint32_t) strtoul(pcParameter, NULL, 10) : ulDefault;
+}
+
+/* pdTRUE if parameter uxIndex is the word pcWord */
+static BaseType_t prvIsWord(const char *pcCommandString, UBaseType_t uxIndex, const char *pcWord)
+{
+    const char *pcParameter;
+    BaseType_t xLength;
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, uxIndex, &xLength);
+    return (pcParameter != NULL && (size_t) xLength == strlen(pcWord) &&
+            strncmp(pcParameter, pcWord, (size_t) xLength) == 0) ? pdTRUE : pdFALSE;
+}
+
+/* Rate and size of a sender; a rate of 0 is only valid for the stream */
+static BaseType_t prvValidSender(uint32_t ulRate, uint32_t ulSize, BaseType_t xPaced)
+{
+    return ((ulRate != 0 || !xPaced) && ulRate <= FLEET_TEST_MAX_RATE_HZ &&
+            ulSize >= FLEET_TEST_HEADER_SIZE && ulSize <= FLEET_TEST_MAX_SIZE) ? pdTRUE : pdFALSE;
+}
+
+/* "fleet <action> ...": pdTRUE if the command was understood */
+static BaseType_t prvFleetSet(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    char cAddr[16];
+    const char *pcParameter;
+    BaseType_t xLength;
+    uint32_t ulRate;
+    uint32_t ulSize;
+    IpAddr xPeer;
+    BaseType_t xOn = prvIsWord(pcCommandString, 2, "on");
+    BaseType_t xOff = prvIsWord(pcCommandString, 2, "off");
+
+    xSemaphoreTake(xFleetMutex, portMAX_DELAY);
+
+    if (prvIsWord(pcCommandString, 1, "reset"))
+    {
+        memset(&xCounters, 0, sizeof(xCounters));
+        uxPeerCount = 0;
+        ullResetUs = ullMonoClockNowUs();
+        vRunTimeStatsGetLoadSample(&xResetLoad);
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Counters cleared\r\n");
+    }
+    else if (prvIsWord(pcCommandString, 1, "stop"))
+    {
+        xConfig.xListen = pdFALSE;
+        xConfig.ulPublishHz = 0;
+        xConfig.xServer = pdFALSE;
+        xConfig.xTcp = pdFALSE;
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Fleet test stopped\r\n");
+    }
+    else if (prvIsWord(pcCommandString, 1, "listen") && (xOn || xOff))
+    {
+        if (xOn && !xSubscribed)
+        {
+            /* Once for good: libudpard subscriptions are not given back */
+            xSemaphoreGive(xFleetMutex);
+            xSubscribed = xCyphalNodeSubscribe(FLEET_TEST_SUBJECT_ID, FLEET_TEST_MAX_SIZE, prvReceived, NULL);
+            xSemaphoreTake(xFleetMutex, portMAX_DELAY);
+        }
+        xConfig.xListen = xOn && xSubscribed;
+        if (xOn && !xSubscribed)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "No subscription left\r\n");
+        }
+        else
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Listening %s\r\n", xOn ? "on" : "off");
+        }
+    }
+    else if (prvIsWord(pcCommandString, 1, "server") && (xOn || xOff))
+    {
+        xConfig.xServer = xOn;
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Server %s\r\n", xOn ? "on" : "off");
+    }
+    else if (prvIsWord(pcCommandString, 1, "publish") && xOff)
+    {
+        xConfig.ulPublishHz = 0;
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Publishing off\r\n");
+    }
+    else if (prvIsWord(pcCommandString, 1, "publish") &&
+             prvValidSender(ulRate = prvNumber(pcCommandString, 2, 0), ulSize = prvNumber(pcCommandString, 3, 0), pdTRUE))
+    {
+        xConfig.ulPublishHz = ulRate;
+        xConfig.xPublishSize = ulSize;
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Publishing %lu B at %lu Hz on subject %u\r\n", (unsigned long) ulSize,
+                 (unsigned long) ulRate, (unsigned int) FLEET_TEST_SUBJECT_ID);
+    }
+    else if (prvIsWord(pcCommandString, 1, "tcp") && xOff)
+    {
+        xConfig.xTcp = pdFALSE;
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Stream off\r\n");
+    }
+    else if (prvIsWord(pcCommandString, 1, "tcp") &&
+             (pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xLength)) != NULL &&
+             (size_t) xLength < sizeof(cAddr) &&
+             prvValidSender(ulRate = prvNumber(pcCommandString, 3, 0), ulSize = prvNumber(pcCommandString, 4, 0), pdFALSE))
+    {
+        memcpy(cAddr, pcParameter, (size_t) xLength);
+        cAddr[xLength] = '\0';
+        if (ipStringToAddr(cAddr, &xPeer) != NO_ERROR || xPeer.length != sizeof(Ipv4Addr))
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid address %s\r\n", cAddr);
+        }
+        else
+        {
+            xConfig.xTcp = pdTRUE;
+            xConfig.xTcpPeer = xPeer;
+            xConfig.ulTcpHz = ulRate;
+            xConfig.xTcpSize = ulSize;
+            xConfig.ulTcpGeneration++;
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Streaming %lu B records to %s:%u at %lu Hz\r\n",
+                     (unsigned long) ulSize, cAddr, (unsigned int) FLEET_TEST_TCP_PORT, (unsigned long) ulRate);
+        }
+    }
+    else
+    {
+        xSemaphoreGive(xFleetMutex);
+        return pdFALSE;
+    }
+
+    xSemaphoreGive(xFleetMutex);
+    osSetEvent(&xFleetEvent);
+    return pdTRUE;
+}
+
+/* One line of the status */
+static BaseType_t prvFleetStatus(char *pcWriteBuffer, size_t xWriteBufferLen, UBaseType_t uxLine)
+{
+    char cAddr[16];
+    char cPeer[48];
+    FleetCounters_t xCopy;
+    FleetConfig_t xRun;
+    RunTimeLoadSample_t xLoad;
+    PtpSlaveStats_t xPtp;
+    Ipv4Addr xHost = IPV4_UNSPECIFIED_ADDR;
+    uint64_t ullNowUs = ullMonoClockNowUs();
+    UBaseType_t uxPeers;
+    UBaseType_t uxStreams;
+
+    xSemaphoreTake(xFleetMutex, portMAX_DELAY);
+    xCopy = xCounters;
+    xRun = xConfig;
+    uxPeers = uxPeerCount;
+    uxStreams = uxConnectionCount;
+    vRunTimeStatsGetLoadSample(&xLoad);
+    xSemaphoreGive(xFleetMutex);
+
+    switch (uxLine)
+    {
+    case 0:
+        (void) ipv4GetHostAddr(&netInterface[0], &xHost);
+        ipv4AddrToString(xHost, cAddr);
+        vPtpSlaveGetStats(&xPtp);
+        snprintf(pcWriteBuffer, xWriteBufferLen, "fleet,node,%u,%s,%u,%u,%ld,%lu,%lu,%u\r\n",
+                 (unsigned int) usCyphalNodeGetNodeId(), cAddr, (prvReferenceUs(ullNowUs) != 0) ? 1u : 0u,
+                 (xPtp.eState == ePtpSlave) ? 1u : 0u, (long) xPtp.llOffsetNs,
+                 (unsigned long) (ullNowUs - ullResetUs), (unsigned long) ulRunTimeStatsLoadPermille(&xResetLoad, &xLoad),
+                 (unsigned int) uxPeers);
+        return pdTRUE;
+    case 1:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "fleet,tx,%lu,%llu,%lu,%lu,%llu,%lu,%lu\r\n",
+                 (unsigned long) xCopy.ulPublished, (unsigned long long) xCopy.ullPublishedBytes,
+                 (unsigned long) xCopy.ulPublishErrors, (unsigned long) xCopy.ulTcpRecords,
+                 (unsigned long long) xCopy.ullTcpBytes, (unsigned long) xCopy.ulTcpErrors,
+                 (unsigned long) xCopy.ulTcpBlocked);
+        return pdTRUE;
+    case 2:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "fleet,rx,%lu,%lu,%lu,%lu,%u\r\n",
+                 (unsigned long) xCopy.ulUnknownPeers, (unsigned long) xCopy.ulUnsynced,
+                 (unsigned long) xCopy.ulClockErrors, (unsigned long) xCopy.ulMalformed, (unsigned int) uxStreams);
+        return pdTRUE;
+    default:
+        if (xRun.xTcp)
+        {
+            ipv4AddrToString(xRun.xTcpPeer.ipv4Addr, cAddr);
+            snprintf(cPeer, sizeof(cPeer), "%s,%lu,%u", cAddr, (unsigned long) xRun.ulTcpHz,
+                     (unsigned int) xRun.xTcpSize);
+        }
+        else
+        {
+            snprintf(cPeer, sizeof(cPeer), "-,0,0");
+        }
+        snprintf(pcWriteBuffer, xWriteBufferLen, "fleet,cfg,%u,%lu,%u,%u,%s\r\n", xRun.xListen ? 1u : 0u,
+                 (unsigned long) xRun.ulPublishHz, (unsigned int) xRun.xPublishSize, xRun.xServer ? 1u : 0u, cPeer);
+        return pdFALSE;
+    }
+}
+
+/* Two lines per peer: counters and latency, then the histogram */
+static void prvFleetPeer(char *pcWriteBuffer, size_t xWriteBufferLen, UBaseType_t uxPeer, BaseType_t xHistogram)
+{
+    char cId[16];
+    FleetPeer_t xPeer;
+    size_t xUsed;
+    UBaseType_t i;
+
+    xSemaphoreTake(xFleetMutex, portMAX_DELAY);
+    if (uxPeer >= uxPeerCount)
+    {
+        xSemaphoreGive(xFleetMutex);
+        pcWriteBuffer[0] = '\0';
+        return;
+    }
+    xPeer = xPeers[uxPeer];
+    xSemaphoreGive(xFleetMutex);
+
+    if (xHistogram)
+    {
+        xUsed = (size_t) snprintf(pcWriteBuffer, xWriteBufferLen, "fleet,hist,%u", (unsigned int) uxPeer);
+        for (i = 0; i < FLEET_TEST_HIST_BUCKETS && xUsed < xWriteBufferLen; i++)
+        {
+            xUsed += (size_t) snprintf(pcWriteBuffer + xUsed, xWriteBufferLen - xUsed, ",%lu",
+                                       (unsigned long) xPeer.ulHist[i]);
+        }
+        if (xUsed < xWriteBufferLen)
+        {
+            snprintf(pcWriteBuffer + xUsed, xWriteBufferLen - xUsed, "\r\n");
+        }
+        return;
+    }
+
+    if (xPeer.ucKind == (uint8_t) eFleetTcp)
+    {
+        ipv4AddrToString(xPeer.ulId, cId);
+    }
+    else
+    {
+        snprintf(cId, sizeof(cId), "%lu", (unsigned long) xPeer.ulId);
+    }
+
+    snprintf(pcWriteBuffer, xWriteBufferLen, "fleet,peer,%u,%s,%s,%lu,%llu,%lu,%lu,%lu,%lu,%lu,%lu\r\n",
+             (unsigned int) uxPeer, (xPeer.ucKind == (uint8_t) eFleetTcp) ? "tcp" : "cyphal", cId,
+             (unsigned long) xPeer.ulReceived, (unsigned long long) xPeer.ullBytes, (unsigned long) xPeer.ulLost,
+             (unsigned long) xPeer.ulReordered, (unsigned long) xPeer.ulLatencyCount,
+             (unsigned long) ((xPeer.ulLatencyCount != 0) ? xPeer.ulMinUs : 0u),
+             (unsigned long) ((xPeer.ulLatencyCount != 0) ? xPeer.ullSumUs / xPeer.ulLatencyCount : 0u),
+             (unsigned long) xPeer.ulMaxUs);
+}
+
+static BaseType_t prvFleetCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    const char *pcParameter;
+    BaseType_t xLength;
+    UBaseType_t uxPeers;
+
+    if (uxFleetLine == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xLength);
+
+        if (prvIsWord(pcCommandString, 1, "peers"))
+        {
+            xSemaphoreTake(xFleetMutex, portMAX_DELAY);
+            uxPeers = uxPeerCount;
+            xSemaphoreGive(xFleetMutex);
+
+            uxFleetPeer = prvNumber(pcCommandString, 2, 0);
+            uxFleetLast = MIN(uxPeers, uxFleetPeer + FLEET_TEST_PEERS_PER_PAGE);
+            if (uxFleetPeer >= uxFleetLast)
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "fleet,end\r\n");
+                return pdFALSE;
+            }
+
+            /* Odd lines are histograms; past the last, the next page */
+            uxFleetLine = 1;
+        }
+        else if (pcParameter != NULL)
+        {
+            if (!prvFleetSet(pcWriteBuffer, xWriteBufferLen, pcCommandString))
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen,
+                         "Usage: fleet [reset|stop|peers [n]|listen|server on|off|publish <hz> <bytes>|off|tcp <ip> <hz> <bytes>|off]\r\n");
+            }
+            return pdFALSE;
+        }
+        else
+        {
+            /* Status lines, the line number counted from 0x100 */
+            uxFleetLine = 0x100;
+        }
+    }
+
+    if (uxFleetLine >= 0x100)
+    {
+        if (prvFleetStatus(pcWriteBuffer, xWriteBufferLen, uxFleetLine - 0x100))
+        {
+            uxFleetLine++;
+            return pdTRUE;
+        }
+        uxFleetLine = 0;
+        return pdFALSE;
+    }
+
+    if (uxFleetPeer < uxFleetLast)
+    {
+        prvFleetPeer(pcWriteBuffer, xWriteBufferLen, uxFleetPeer, (uxFleetLine & 1u) ? pdFALSE : pdTRUE);
+        if ((uxFleetLine++ & 1u) == 0)
+        {
+            uxFleetPeer++;
+        }
+        return pdTRUE;
+    }
+
+    xSemaphoreTake(xFleetMutex, portMAX_DELAY);
+    uxPeers = uxPeerCount;
+    xSemaphoreGive(xFleetMutex);
+
+    if (uxFleetLast < uxPeers)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "fleet,more,%u\r\n", (unsigned int) uxFleetLast);
+    }
+    else
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "fleet,end\r\n");
+    }
+    uxFleetLine = 0;
+    return pdFALSE;
+}
+
+void vFleetTestRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xFleet);
+}
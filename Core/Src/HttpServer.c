@@ -0,0 +1,622 @@
+/* HttpServer.c
+ *
+ * Connections, request parsing and responses of the HTTP server (see
+ * HttpServer.h). Everything belongs to the server task; the counters are read
+ * by the CLI without a lock, a value at a time.
+ */
+#include "HttpServer.h"
+#include "StaticAlloc.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "core/net.h"
+#include "core/socket.h"
+#include "http/http_common.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Status line and header fields of a response */
+#define HTTP_HEADER_SIZE               320u
+
+typedef struct
+{
+    Socket *pxSocket;               /* NULL for a free entry */
+    IpAddr xPeer;
+    uint16_t usPeerPort;
+    systime_t xLastActivity;
+    UBaseType_t uxRequests;
+    BaseType_t xClose;              /* Close once the response is sent */
+    size_t xHeaderLength;           /* Of the response being sent, 0 if none */
+    size_t xHeaderOffset;
+    const uint8_t *pucBody;         /* In the flash image */
+    size_t xBodyLength;
+    size_t xBodyOffset;
+    size_t xRxUsed;
+    char cRx[HTTP_SERVER_RX_SIZE + 1u];
+    char cHeader[HTTP_HEADER_SIZE];
+} HttpConnection_t;
+
+/* Header fields of a request which are needed, terminated in place */
+typedef struct
+{
+    char *pcIfNoneMatch;
+    char *pcAcceptEncoding;
+    char *pcConnection;
+} HttpRequestFields_t;
+
+/* Owned by the server task */
+static HttpConnection_t xConnections[HTTP_SERVER_MAX_CONNECTIONS];
+static const HttpAsset_t *pxImage = NULL;
+static size_t xImageCount = 0;
+static HttpServerStats_t xStats;
+
+APP_TASK_STORAGE(xHttpTask, HTTP_SERVER_TASK_STACK_SIZE);
+
+static BaseType_t prvHttpCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xHttp =
+{
+    "http",
+    "\r\nhttp:\r\n HTTP server connections and counters\r\n",
+    prvHttpCommand,
+    -1
+};
+
+static const HttpAsset_t *prvFindAsset(const char *pcPath, size_t xLength)
+{
+    size_t i;
+
+    if (xLength == 1u && pcPath[0] == '/')
+    {
+        pcPath = "/index.html";
+        xLength = strlen(pcPath);
+    }
+
+    for (i = 0; i < xImageCount; i++)
+    {
+        if (strlen(pxImage[i].pcPath) == xLength && memcmp(pxImage[i].pcPath, pcPath, xLength) == 0)
+        {
+            return &pxImage[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void prvParseFields(char *pcLine, HttpRequestFields_t *pxFields)
+{
+    static const char *const pcNames[] = { "If-None-Match", "Accept-Encoding", "Connection" };
+    char **ppcValues[] = { &pxFields->pcIfNoneMatch, &pxFields->pcAcceptEncoding, &pxFields->pcConnection };
+    char *pcNext;
+    char *pcEnd;
+    char *pcValue;
+    size_t xName;
+    size_t i;
+
+    memset(pxFields, 0, sizeof(*pxFields));
+
+    for (; pcLine != NULL && *pcLine != '\0'; pcLine = pcNext)
+    {
+        pcEnd = strstr(pcLine, "\r\n");
+        if (pcEnd == NULL)
+        {
+            break;
+        }
+        *pcEnd = '\0';
+        pcNext = pcEnd + 2;
+
+        for (i = 0; i < sizeof(pcNames) / sizeof(pcNames[0]); i++)
+        {
+            xName = strlen(pcNames[i]);
+            if (osStrncasecmp(pcLine, pcNames[i], xName) == 0 && pcLine[xName] == ':')
+            {
+                pcValue = &pcLine[xName + 1u];
+                while (*pcValue == ' ' || *pcValue == '\t')
+                {
+                    pcValue++;
+                }
+                *ppcValues[i] = pcValue;
+            }
+        }
+    }
+}
+
+/* pdTRUE if pcList, a comma separated header value, holds pcToken */
+static BaseType_t prvHasToken(const char *pcList, const char *pcToken)
+{
+    size_t xToken = strlen(pcToken);
+
+    while (pcList != NULL && *pcList != '\0')
+    {
+        while (*pcList == ' ' || *pcList == ',')
+        {
+            pcList++;
+        }
+        if (osStrncasecmp(pcList, pcToken, xToken) == 0 &&
+            (pcList[xToken] == '\0' || pcList[xToken] == ',' || pcList[xToken] == ' ' || pcList[xToken] == ';'))
+        {
+            return pdTRUE;
+        }
+        pcList = strchr(pcList, ',');
+    }
+
+    return pdFALSE;
+}
+
+/* If-None-Match uses the weak comparison (RFC 7232, 3.2): W/"x" matches "x" */
+static BaseType_t prvEtagMatches(const char *pcIfNoneMatch, const char *pcEtag)
+{
+    if (pcIfNoneMatch == NULL)
+    {
+        return pdFALSE;
+    }
+
+    return (strcmp(pcIfNoneMatch, "*") == 0 || strstr(pcIfNoneMatch, pcEtag) != NULL) ? pdTRUE : pdFALSE;
+}
+
+/* A response without a body */
+static void prvRespondStatus(HttpConnection_t *pxConnection, const char *pcStatus)
+{
+    pxConnection->xHeaderLength = (size_t) snprintf(pxConnection->cHeader, sizeof(pxConnection->cHeader),
+                                                    "HTTP/1.1 %s\r\n"
+                                                    "Content-Length: 0\r\n"
+                                                    "%s\r\n", pcStatus,
+                                                    (pxConnection->xClose != pdFALSE) ? "Connection: close\r\n" : "");
+    pxConnection->xBodyLength = 0;
+    xStats.ulErrors++;
+}
+
+/* Parse the request at the head of the receive buffer, if complete, and set up
+   its response; returns the length of the request, 0 if incomplete */
+static size_t prvHandleRequest(HttpConnection_t *pxConnection)
+{
+    HttpRequestFields_t xFields;
+    const HttpAsset_t *pxAsset;
+    char *pcRequest = pxConnection->cRx;
+    char *pcEnd;
+    char *pcTarget;
+    char *pcVersion;
+    size_t xTargetLength;
+    size_t xRequestLength;
+    BaseType_t xHead;
+    BaseType_t xHttp10;
+
+    pxConnection->cRx[pxConnection->xRxUsed] = '\0';
+    pcEnd = strstr(pcRequest, "\r\n\r\n");
+    if (pcEnd == NULL)
+    {
+        if (pxConnection->xRxUsed == HTTP_SERVER_RX_SIZE)
+        {
+            pxConnection->xClose = pdTRUE;
+            prvRespondStatus(pxConnection, "431 Request Header Fields Too Large");
+            return pxConnection->xRxUsed;
+        }
+        return 0;
+    }
+    xRequestLength = (size_t) (pcEnd - pcRequest) + 4u;
+    pcEnd[2] = '\0';
+
+    xStats.ulRequests++;
+    pxConnection->uxRequests++;
+    pxConnection->xBodyOffset = 0;
+    pxConnection->xHeaderOffset = 0;
+
+    /* Request line: method, target and version */
+    pcTarget = strchr(pcRequest, ' ');
+    pcVersion = (pcTarget != NULL) ? strchr(pcTarget + 1, ' ') : NULL;
+    if (pcVersion == NULL || strncmp(pcVersion + 1, "HTTP/1.", 7) != 0)
+    {
+        pxConnection->xClose = pdTRUE;
+        prvRespondStatus(pxConnection, "400 Bad Request");
+        return xRequestLength;
+    }
+    pcTarget++;
+    xHttp10 = (pcVersion[8] == '0') ? pdTRUE : pdFALSE;
+    xHead = (strncmp(pcRequest, "HEAD ", 5) == 0) ? pdTRUE : pdFALSE;
+
+    /* The query string is not used */
+    xTargetLength = (size_t) (pcVersion - pcTarget);
+    pcEnd = memchr(pcTarget, '?', xTargetLength);
+    if (pcEnd != NULL)
+    {
+        xTargetLength = (size_t) (pcEnd - pcTarget);
+    }
+
+    prvParseFields(strstr(pcRequest, "\r\n") + 2, &xFields);
+
+    /* HTTP/1.1 connections persist unless closed, HTTP/1.0 ones only if asked */
+    if ((xHttp10 != pdFALSE && prvHasToken(xFields.pcConnection, "keep-alive") == pdFALSE) ||
+        prvHasToken(xFields.pcConnection, "close") != pdFALSE ||
+        pxConnection->uxRequests >= HTTP_SERVER_MAX_REQUESTS)
+    {
+        pxConnection->xClose = pdTRUE;
+    }
+
+    if (xHead == pdFALSE && strncmp(pcRequest, "GET ", 4) != 0)
+    {
+        prvRespondStatus(pxConnection, "405 Method Not Allowed");
+        return xRequestLength;
+    }
+
+    pxAsset = prvFindAsset(pcTarget, xTargetLength);
+    if (pxAsset == NULL)
+    {
+        prvRespondStatus(pxConnection, "404 Not Found");
+        return xRequestLength;
+    }
+
+    if (prvEtagMatches(xFields.pcIfNoneMatch, pxAsset->pcEtag) != pdFALSE)
+    {
+        /* The copy of the client is current: the file is not read */
+        pxConnection->xHeaderLength = (size_t) snprintf(pxConnection->cHeader, sizeof(pxConnection->cHeader),
+                                                        "HTTP/1.1 304 Not Modified\r\n"
+                                                        "ETag: %s\r\n"
+                                                        "Cache-Control: %s\r\n"
+                                                        "Vary: Accept-Encoding\r\n"
+                                                        "%s\r\n", pxAsset->pcEtag, pxAsset->pcCacheControl,
+                                                        (pxConnection->xClose != pdFALSE) ? "Connection: close\r\n" : "");
+        pxConnection->xBodyLength = 0;
+        xStats.ulNotModified++;
+        return xRequestLength;
+    }
+
+    /* The image only holds compressed files */
+    if (prvHasToken(xFields.pcAcceptEncoding, "gzip") == pdFALSE)
+    {
+        prvRespondStatus(pxConnection, "406 Not Acceptable");
+        return xRequestLength;
+    }
+
+    pxConnection->xHeaderLength = (size_t) snprintf(pxConnection->cHeader, sizeof(pxConnection->cHeader),
+                                                    "HTTP/1.1 200 OK\r\n"
+                                                    "Content-Type: %s\r\n"
+                                                    "Content-Encoding: gzip\r\n"
+                                                    "Content-Length: %lu\r\n"
+                                                    "ETag: %s\r\n"
+                                                    "Cache-Control: %s\r\n"
+                                                    "Vary: Accept-Encoding\r\n"
+                                                    "%s\r\n", pxAsset->pcContentType,
+                                                    (unsigned long) pxAsset->ulLength, pxAsset->pcEtag,
+                                                    pxAsset->pcCacheControl,
+                                                    (pxConnection->xClose != pdFALSE) ? "Connection: close\r\n" : "");
+    pxConnection->pucBody = pxAsset->pucData;
+    pxConnection->xBodyLength = (xHead == pdFALSE) ? pxAsset->ulLength : 0u;
+    xStats.ulOk++;
+
+    return xRequestLength;
+}
+
+static void prvClose(HttpConnection_t *pxConnection)
+{
+    socketClose(pxConnection->pxSocket);
+    pxConnection->pxSocket = NULL;
+}
+
+/* Write what the socket takes without waiting; pdFALSE if the connection
+   failed. xDone is set once the response is complete */
+static BaseType_t prvSendPart(HttpConnection_t *pxConnection, const uint8_t *pucData, size_t *pxOffset,
+                              size_t xLength, BaseType_t *pxDone)
+{
+    size_t xWritten = 0;
+    error_t err;
+
+    *pxDone = pdTRUE;
+    if (*pxOffset == xLength)
+    {
+        return pdTRUE;
+    }
+
+    err = socketSend(pxConnection->pxSocket, &pucData[*pxOffset], xLength - *pxOffset, &xWritten,
+                     SOCKET_FLAG_NO_DELAY);
+    *pxOffset += xWritten;
+    if (xWritten > 0)
+    {
+        pxConnection->xLastActivity = osGetSystemTime();
+    }
+    if (err == ERROR_TIMEOUT)
+    {
+        *pxDone = pdFALSE;
+        return pdTRUE;
+    }
+
+    return (err == NO_ERROR) ? pdTRUE : pdFALSE;
+}
+
+/* Send the responses, the header then the body straight from flash, and
+   handle the requests pipelined behind them */
+static void prvPump(HttpConnection_t *pxConnection)
+{
+    BaseType_t xDone;
+    size_t xConsumed;
+    size_t xSent;
+
+    for (;;)
+    {
+        if (pxConnection->xHeaderLength > 0)
+        {
+            if (prvSendPart(pxConnection, (const uint8_t *) pxConnection->cHeader, &pxConnection->xHeaderOffset,
+                            pxConnection->xHeaderLength, &xDone) == pdFALSE)
+            {
+                prvClose(pxConnection);
+                return;
+            }
+            if (xDone == pdFALSE)
+            {
+                return;
+            }
+
+            xSent = pxConnection->xBodyOffset;
+            if (prvSendPart(pxConnection, pxConnection->pucBody, &pxConnection->xBodyOffset,
+                            pxConnection->xBodyLength, &xDone) == pdFALSE)
+            {
+                prvClose(pxConnection);
+                return;
+            }
+            xStats.ulBytesSent += (uint32_t) (pxConnection->xBodyOffset - xSent);
+            if (xDone == pdFALSE)
+            {
+                return;
+            }
+
+            pxConnection->xHeaderLength = 0;
+            pxConnection->xLastActivity = osGetSystemTime();
+            if (pxConnection->xClose != pdFALSE)
+            {
+                prvClose(pxConnection);
+                return;
+            }
+        }
+
+        xConsumed = prvHandleRequest(pxConnection);
+        if (xConsumed == 0)
+        {
+            return;
+        }
+        memmove(pxConnection->cRx, &pxConnection->cRx[xConsumed], pxConnection->xRxUsed - xConsumed);
+        pxConnection->xRxUsed -= xConsumed;
+    }
+}
+
+static void prvReceive(HttpConnection_t *pxConnection)
+{
+    size_t xReceived = 0;
+    error_t err;
+
+    err = socketReceive(pxConnection->pxSocket, &pxConnection->cRx[pxConnection->xRxUsed],
+                        HTTP_SERVER_RX_SIZE - pxConnection->xRxUsed, &xReceived, SOCKET_FLAG_DONT_WAIT);
+    if (err == ERROR_TIMEOUT)
+    {
+        return;
+    }
+    if (err != NO_ERROR || xReceived == 0)
+    {
+        prvClose(pxConnection);
+        return;
+    }
+
+    pxConnection->xRxUsed += xReceived;
+    pxConnection->xLastActivity = osGetSystemTime();
+}
+
+static void prvAccept(Socket *pxListener)
+{
+    HttpConnection_t *pxConnection = NULL;
+    Socket *pxSocket;
+    IpAddr xPeer;
+    uint16_t usPeerPort;
+    UBaseType_t i;
+
+    pxSocket = socketAccept(pxListener, &xPeer, &usPeerPort);
+    if (pxSocket == NULL)
+    {
+        return;
+    }
+
+    /* A free entry, or else the idle one unused for longest */
+    for (i = 0; i < HTTP_SERVER_MAX_CONNECTIONS; i++)
+    {
+        if (xConnections[i].pxSocket == NULL)
+        {
+            pxConnection = &xConnections[i];
+            break;
+        }
+        if (xConnections[i].xHeaderLength == 0 &&
+            (pxConnection == NULL || timeCompare(xConnections[i].xLastActivity, pxConnection->xLastActivity) < 0))
+        {
+            pxConnection = &xConnections[i];
+        }
+    }
+
+    if (pxConnection == NULL)
+    {
+        /* Every connection is sending a response */
+        socketClose(pxSocket);
+        return;
+    }
+
+    if (pxConnection->pxSocket != NULL)
+    {
+        prvClose(pxConnection);
+        xStats.ulEvicted++;
+    }
+
+    /* Never block on a client */
+    socketSetTimeout(pxSocket, 0);
+
+    pxConnection->pxSocket = pxSocket;
+    pxConnection->xPeer = xPeer;
+    pxConnection->usPeerPort = usPeerPort;
+    pxConnection->xLastActivity = osGetSystemTime();
+    pxConnection->uxRequests = 0;
+    pxConnection->xClose = pdFALSE;
+    pxConnection->xHeaderLength = 0;
+    pxConnection->xRxUsed = 0;
+    xStats.ulAccepted++;
+}
+
+static void prvCloseIdle(void)
+{
+    systime_t xNow = osGetSystemTime();
+    UBaseType_t i;
+
+    for (i = 0; i < HTTP_SERVER_MAX_CONNECTIONS; i++)
+    {
+        if (xConnections[i].pxSocket != NULL && xNow - xConnections[i].xLastActivity >= HTTP_SERVER_IDLE_TIMEOUT_MS)
+        {
+            prvClose(&xConnections[i]);
+        }
+    }
+}
+
+static void prvHttpServerTask(void *pvParameters)
+{
+    SocketEventDesc xEvents[1 + HTTP_SERVER_MAX_CONNECTIONS];
+    HttpConnection_t *pxOwners[1 + HTTP_SERVER_MAX_CONNECTIONS];
+    HttpConnection_t *pxConnection;
+    Socket *pxListener;
+    UBaseType_t uxCount;
+    UBaseType_t i;
+
+    (void) pvParameters;
+
+    pxListener = socketOpen(SOCKET_TYPE_STREAM, SOCKET_IP_PROTO_TCP);
+    if (pxListener == NULL)
+    {
+        vTaskDelete(NULL);
+        return;
+    }
+
+    socketBind(pxListener, &IP_ADDR_ANY, HTTP_PORT);
+    socketListen(pxListener, HTTP_SERVER_MAX_CONNECTIONS);
+
+    for (;;)
+    {
+        /* The listener, then every connection; those sending a response
+           also wait for room in their send buffer */
+        xEvents[0].socket = pxListener;
+        xEvents[0].eventMask = SOCKET_EVENT_ACCEPT;
+        pxOwners[0] = NULL;
+        uxCount = 1;
+
+        for (i = 0; i < HTTP_SERVER_MAX_CONNECTIONS; i++)
+        {
+            pxConnection = &xConnections[i];
+            if (pxConnection->pxSocket != NULL)
+            {
+                xEvents[uxCount].socket = pxConnection->pxSocket;
+                xEvents[uxCount].eventMask = (pxConnection->xRxUsed < HTTP_SERVER_RX_SIZE) ?
+                                             SOCKET_EVENT_RX_READY : 0u;
+                if (pxConnection->xHeaderLength > 0)
+                {
+                    xEvents[uxCount].eventMask |= SOCKET_EVENT_TX_READY;
+                }
+                pxOwners[uxCount++] = pxConnection;
+            }
+        }
+
+        for (i = 0; i < uxCount; i++)
+        {
+            xEvents[i].eventFlags = 0;
+        }
+
+        /* Wake up once a second at least, for the idle timeout */
+        if (socketPoll(xEvents, uxCount, NULL, 1000) == NO_ERROR)
+        {
+            for (i = 1; i < uxCount; i++)
+            {
+                if ((xEvents[i].eventFlags & SOCKET_EVENT_RX_READY) != 0)
+                {
+                    prvReceive(pxOwners[i]);
+                }
+                if (pxOwners[i]->pxSocket != NULL && xEvents[i].eventFlags != 0)
+                {
+                    prvPump(pxOwners[i]);
+                }
+            }
+
+            if ((xEvents[0].eventFlags & SOCKET_EVENT_ACCEPT) != 0)
+            {
+                prvAccept(pxListener);
+            }
+        }
+
+        prvCloseIdle();
+    }
+}
+
+BaseType_t xHttpServerStart(UBaseType_t uxPriority, const HttpAsset_t *pxAssets, size_t xCount)
+{
+    pxImage = pxAssets;
+    xImageCount = xCount;
+
+    return xAppTaskCreate(xHttpTask,
+                          prvHttpServerTask,
+                          "HTTP",
+                          HTTP_SERVER_TASK_STACK_SIZE,
+                          NULL,
+                          uxPriority,
+                          NULL);
+}
+
+void vHttpServerGetStats(HttpServerStats_t *pxStats)
+{
+    *pxStats = xStats;
+}
+
+static BaseType_t prvHttpCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    static UBaseType_t uxLine = 0;
+    HttpServerStats_t xSnapshot;
+    HttpConnection_t *pxConnection;
+    char cPeer[40];
+
+    (void) pcCommandString;
+
+    if (uxLine == 0)
+    {
+        vHttpServerGetStats(&xSnapshot);
+        snprintf(pcWriteBuffer, xWriteBufferLen, "requests %lu ok %lu not modified %lu errors %lu\r\n",
+                 (unsigned long) xSnapshot.ulRequests, (unsigned long) xSnapshot.ulOk,
+                 (unsigned long) xSnapshot.ulNotModified, (unsigned long) xSnapshot.ulErrors);
+        uxLine++;
+        return pdTRUE;
+    }
+
+    if (uxLine == 1u)
+    {
+        vHttpServerGetStats(&xSnapshot);
+        snprintf(pcWriteBuffer, xWriteBufferLen, "bytes %lu accepted %lu evicted %lu files %lu\r\n",
+                 (unsigned long) xSnapshot.ulBytesSent, (unsigned long) xSnapshot.ulAccepted,
+                 (unsigned long) xSnapshot.ulEvicted, (unsigned long) xImageCount);
+        uxLine++;
+        return pdTRUE;
+    }
+
+    /* One line per connection; read racily, as the task owns them */
+    pcWriteBuffer[0] = '\0';
+    for (; uxLine - 2u < HTTP_SERVER_MAX_CONNECTIONS; uxLine++)
+    {
+        pxConnection = &xConnections[uxLine - 2u];
+        if (pxConnection->pxSocket != NULL)
+        {
+            ipAddrToString(&pxConnection->xPeer, cPeer);
+            snprintf(pcWriteBuffer, xWriteBufferLen, "%s:%u requests %lu%s\r\n", cPeer, pxConnection->usPeerPort,
+                     (unsigned long) pxConnection->uxRequests, (pxConnection->xHeaderLength > 0) ? " sending" : "");
+            uxLine++;
+            break;
+        }
+    }
+
+    if (uxLine - 2u < HTTP_SERVER_MAX_CONNECTIONS)
+    {
+        return pdTRUE;
+    }
+
+    uxLine = 0;
+    return pdFALSE;
+}
+
+void vHttpServerRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xHttp);
+}
@@ -0,0 +1,226 @@
+/* HwRng.c
+ *
+ * RNG peripheral driver (see HwRng.h). The pool is shared by the readers
+ * and the interrupt under the FreeRTOS interrupt mask, which the RNG
+ * interrupt is below: readers may run in tasks or in interrupts up to
+ * configMAX_SYSCALL_INTERRUPT_PRIORITY, and before the scheduler starts.
+ * Until then the mask is left set by the first critical section, so the
+ * pool is also refilled by the readers, from the words ready in the FIFO
+ * of the generator.
+ */
+#include "HwRng.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "stm32h7xx_hal.h"
+#include <stdio.h>
+#include <string.h>
+
+#define HW_RNG_POOL_MASK           (HW_RNG_POOL_WORDS - 1u)
+
+#if ((HW_RNG_POOL_WORDS & HW_RNG_POOL_MASK) != 0)
+#error HW_RNG_POOL_WORDS must be a power of two
+#endif
+
+/* Bounded waits of the start-up, in polling rounds */
+#define HW_RNG_START_SPINS         1000000u
+
+static uint32_t ulPool[HW_RNG_POOL_WORDS];
+static uint32_t ulHead = 0;
+static uint32_t ulTail = 0;
+
+/* State of the fallback generator, keyed by every hardware word */
+static uint32_t ulFallbackState = 0;
+
+static HwRngStats_t xStats;
+
+static BaseType_t prvRngCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xRng =
+{
+    "rng",
+    "\r\nrng:\r\n Hardware random number generator: pool, draws and errors\r\n",
+    prvRngCommand,
+    0
+};
+
+/* Recover from the errors of the generator; the words of a faulty seed
+ * are discarded by the conditioning reset */
+static void prvCheckErrors(uint32_t ulStatus)
+{
+    if ((ulStatus & RNG_SR_SEIS) != 0)
+    {
+        RNG->SR = (uint32_t) ~RNG_SR_SEIS;
+        RNG->CR |= RNG_CR_CONDRST;
+        RNG->CR &= ~RNG_CR_CONDRST;
+        xStats.ulSeedErrors++;
+    }
+
+    /* The generator restarts by itself once the clock is correct */
+    if ((ulStatus & RNG_SR_CEIS) != 0)
+    {
+        RNG->SR = (uint32_t) ~RNG_SR_CEIS;
+        xStats.ulClockErrors++;
+    }
+}
+
+/* Move the ready words into the pool; under the interrupt mask */
+static void prvFill(void)
+{
+    uint32_t ulStatus = RNG->SR;
+    uint32_t ulWord;
+
+    prvCheckErrors(ulStatus);
+
+    while ((ulStatus & RNG_SR_DRDY) != 0 && ulHead - ulTail < HW_RNG_POOL_WORDS)
+    {
+        /* A word of 0 is what the generator returns on a seed error */
+        ulWord = RNG->DR;
+        if (ulWord != 0)
+        {
+            ulPool[ulHead & HW_RNG_POOL_MASK] = ulWord;
+            ulHead++;
+            ulFallbackState ^= ulWord;
+            xStats.ulGenerated++;
+        }
+        ulStatus = RNG->SR;
+    }
+
+    if (ulHead - ulTail >= HW_RNG_POOL_WORDS)
+    {
+        RNG->CR &= ~RNG_CR_IE;
+    }
+}
+
+/* Mixer of splitmix32 over a Weyl sequence */
+static uint32_t prvFallback(void)
+{
+    uint32_t ulValue;
+
+    ulFallbackState += 0x9E3779B9u;
+    ulValue = ulFallbackState;
+    ulValue = (ulValue ^ (ulValue >> 16)) * 0x85EBCA6Bu;
+    ulValue = (ulValue ^ (ulValue >> 13)) * 0xC2B2AE35u;
+
+    return ulValue ^ (ulValue >> 16);
+}
+
+void vHwRngInit(void)
+{
+    uint32_t ulSpins = 0;
+
+    /* HSI48, the kernel clock of the RNG (RNGSEL = 0) */
+    RCC->CR |= RCC_CR_HSI48ON;
+    while ((RCC->CR & RCC_CR_HSI48RDY) == 0 && ulSpins++ < HW_RNG_START_SPINS)
+    {
+    }
+    RCC->D2CCIP2R &= ~RCC_D2CCIP2R_RNGSEL;
+    __HAL_RCC_RNG_CLK_ENABLE();
+
+    RNG->CR = RNG_CR_RNGEN;
+
+    /* The interrupts may already be masked by FreeRTOS: fill by polling */
+    for (ulSpins = 0; ulHead < HW_RNG_POOL_WORDS && ulSpins < HW_RNG_START_SPINS; ulSpins++)
+    {
+        prvFill();
+    }
+
+    HAL_NVIC_SetPriority(RNG_IRQn, HW_RNG_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(RNG_IRQn);
+    if (ulHead - ulTail < HW_RNG_POOL_WORDS)
+    {
+        RNG->CR |= RNG_CR_IE;
+    }
+}
+
+uint32_t ulHwRngGet(void)
+{
+    UBaseType_t uxMask;
+    uint32_t ulValue;
+
+    uxMask = taskENTER_CRITICAL_FROM_ISR();
+
+    if (ulHead == ulTail)
+    {
+        prvFill();
+    }
+
+    if (ulHead != ulTail)
+    {
+        ulValue = ulPool[ulTail & HW_RNG_POOL_MASK];
+        ulTail++;
+    }
+    else
+    {
+        ulValue = prvFallback();
+        xStats.ulFallbacks++;
+    }
+    xStats.ulDrawn++;
+
+    /* Half empty: let the interrupt refill */
+    if (ulHead - ulTail <= HW_RNG_POOL_WORDS / 2u)
+    {
+        RNG->CR |= RNG_CR_IE;
+    }
+
+    taskEXIT_CRITICAL_FROM_ISR(uxMask);
+
+    return ulValue;
+}
+
+void vHwRngGetData(uint8_t *pucData, size_t xLength)
+{
+    uint32_t ulWord;
+    size_t xChunk;
+
+    while (xLength > 0)
+    {
+        ulWord = ulHwRngGet();
+        xChunk = (xLength < sizeof(ulWord)) ? xLength : sizeof(ulWord);
+        memcpy(pucData, &ulWord, xChunk);
+        pucData += xChunk;
+        xLength -= xChunk;
+    }
+}
+
+void RNG_IRQHandler(void)
+{
+    UBaseType_t uxMask;
+
+    /* Readers in interrupts above this one take the pool too */
+    uxMask = taskENTER_CRITICAL_FROM_ISR();
+    prvFill();
+    taskEXIT_CRITICAL_FROM_ISR(uxMask);
+}
+
+void vHwRngGetStats(HwRngStats_t *pxStats)
+{
+    UBaseType_t uxMask;
+
+    uxMask = taskENTER_CRITICAL_FROM_ISR();
+    *pxStats = xStats;
+    pxStats->ulLevel = ulHead - ulTail;
+    taskEXIT_CRITICAL_FROM_ISR(uxMask);
+}
+
+void vHwRngRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xRng);
+}
+
+static BaseType_t prvRngCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    HwRngStats_t xShown;
+
+    (void) pcCommandString;
+
+    vHwRngGetStats(&xShown);
+    snprintf(pcWriteBuffer, xWriteBufferLen,
+             "pool %lu/%lu, drawn %lu (%lu fallbacks), generated %lu, errors %lu seed %lu clock\r\n",
+             (unsigned long) xShown.ulLevel, (unsigned long) HW_RNG_POOL_WORDS,
+             (unsigned long) xShown.ulDrawn, (unsigned long) xShown.ulFallbacks,
+             (unsigned long) xShown.ulGenerated, (unsigned long) xShown.ulSeedErrors,
+             (unsigned long) xShown.ulClockErrors);
+
+    return pdFALSE;
+}
@@ -0,0 +1,273 @@
+/* LldpAgent.c
+ *
+ * LLDP transmit agent (see LldpAgent.h). The task owns the cached LLDPDU and
+ * the values it was built from; the stack only notifies it of link changes.
+ */
+#include "LldpAgent.h"
+#include "StaticAlloc.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "core/net.h"
+#include "core/ethernet.h"
+#include "ipv4/ipv4.h"
+#include "lldp/lldp.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Nearest bridge group address (802.1AB, 7.1) */
+static const MacAddr xLldpMulticastAddr = {{{0x01, 0x80, 0xC2, 0x00, 0x00, 0x0E}}};
+
+/* What the LLDPDU advertises; compared as a whole, hence zero-padded */
+typedef struct
+{
+    char cHostname[NET_MAX_HOSTNAME_LEN + 1];
+    char cName[NET_MAX_IF_NAME_LEN + 1];
+    MacAddr xMacAddr;
+    Ipv4Addr xAddr;
+    BaseType_t xLinkUp;
+} LldpLocal_t;
+
+static NetInterface *pxLldpInterface = NULL;
+static LldpLocal_t xLocal;
+static uint8_t ucLldpdu[LLDP_MAX_LLDPDU_SIZE];
+static size_t xLldpduLength = 0;
+
+static LldpAgentStats_t xStats;
+
+static TaskHandle_t xLldpTask = NULL;
+APP_TASK_STORAGE(xLldpTask, LLDP_AGENT_TASK_STACK_SIZE);
+
+static BaseType_t prvLldpCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xLldp =
+{
+    "lldp",
+    "\r\nlldp:\r\n LLDP agent state and counters\r\n",
+    prvLldpCommand,
+    -1
+};
+
+/* Called by the stack with netMutex held */
+static void prvLinkChange(NetInterface *pxInterface, bool_t xLinkState, void *pvParam)
+{
+    (void) pxInterface;
+    (void) xLinkState;
+    (void) pvParam;
+
+    xTaskNotifyGive(xLldpTask);
+}
+
+static void prvReadLocal(LldpLocal_t *pxLocal)
+{
+    memset(pxLocal, 0, sizeof(*pxLocal));
+
+    osAcquireMutex(&netMutex);
+    strncpy(pxLocal->cHostname, pxLldpInterface->hostname, sizeof(pxLocal->cHostname) - 1u);
+    strncpy(pxLocal->cName, pxLldpInterface->name, sizeof(pxLocal->cName) - 1u);
+    pxLocal->xMacAddr = pxLldpInterface->macAddr;
+    pxLocal->xLinkUp = pxLldpInterface->linkState ? pdTRUE : pdFALSE;
+    osReleaseMutex(&netMutex);
+
+    /* Takes netMutex itself; unspecified while no address is valid */
+    (void) ipv4GetHostAddr(pxLldpInterface, &pxLocal->xAddr);
+}
+
+/* TLV: 7-bit type, 9-bit length, then an optional subtype and the value */
+static uint8_t *prvPutTlv(uint8_t *pucOut, uint8_t ucType, int16_t sSubtype, const void *pvValue, size_t xLength)
+{
+    size_t xTotal = xLength + ((sSubtype >= 0) ? 1u : 0u);
+
+    *pucOut++ = (uint8_t) ((ucType << 1) | ((xTotal >> 8) & 0x01u));
+    *pucOut++ = (uint8_t) xTotal;
+    if (sSubtype >= 0)
+    {
+        *pucOut++ = (uint8_t) sSubtype;
+    }
+    if (xLength > 0)
+    {
+        memcpy(pucOut, pvValue, xLength);
+    }
+
+    return pucOut + xLength;
+}
+
+static void prvBuild(void)
+{
+    uint8_t ucValue[16];
+    uint8_t *pucOut = ucLldpdu;
+    uint16_t usTtl = (uint16_t) MIN(LLDP_AGENT_TX_INTERVAL_S * LLDP_AGENT_TX_HOLD + 1u, 65535u);
+    uint32_t ulIfIndex = pxLldpInterface->index + 1u;
+
+    pucOut = prvPutTlv(pucOut, LLDP_TLV_TYPE_CHASSIS_ID, LLDP_CHASSIS_ID_SUBTYPE_MAC_ADDR,
+                       &xLocal.xMacAddr, sizeof(MacAddr));
+    pucOut = prvPutTlv(pucOut, LLDP_TLV_TYPE_PORT_ID, LLDP_PORT_ID_SUBTYPE_INTERFACE_NAME,
+                       xLocal.cName, strlen(xLocal.cName));
+
+    ucValue[0] = (uint8_t) (usTtl >> 8);
+    ucValue[1] = (uint8_t) usTtl;
+    pucOut = prvPutTlv(pucOut, LLDP_TLV_TYPE_TIME_TO_LIVE, -1, ucValue, 2u);
+
+    pucOut = prvPutTlv(pucOut, LLDP_TLV_TYPE_PORT_DESC, -1, xLocal.cName, strlen(xLocal.cName));
+    if (xLocal.cHostname[0] != '\0')
+    {
+        pucOut = prvPutTlv(pucOut, LLDP_TLV_TYPE_SYS_NAME, -1, xLocal.cHostname, strlen(xLocal.cHostname));
+    }
+    pucOut = prvPutTlv(pucOut, LLDP_TLV_TYPE_SYS_DESC, -1, LLDP_AGENT_SYS_DESCR, strlen(LLDP_AGENT_SYS_DESCR));
+
+    /* Capabilities, then those enabled */
+    ucValue[0] = 0;
+    ucValue[1] = LLDP_SYS_CAP_STATION_ONLY;
+    ucValue[2] = 0;
+    ucValue[3] = LLDP_SYS_CAP_STATION_ONLY;
+    pucOut = prvPutTlv(pucOut, LLDP_TLV_TYPE_SYS_CAP, -1, ucValue, 4u);
+
+    /* Address string (length, subtype, address), interface number, no OID */
+    if (xLocal.xAddr != IPV4_UNSPECIFIED_ADDR)
+    {
+        ucValue[0] = 1u + sizeof(Ipv4Addr);
+        ucValue[1] = LLDP_MGMT_ADDR_SUBTYPE_IPV4;
+        memcpy(&ucValue[2], &xLocal.xAddr, sizeof(Ipv4Addr));
+        ucValue[6] = LLDP_IF_NUM_SUBTYPE_IF_INDEX;
+        ucValue[7] = (uint8_t) (ulIfIndex >> 24);
+        ucValue[8] = (uint8_t) (ulIfIndex >> 16);
+        ucValue[9] = (uint8_t) (ulIfIndex >> 8);
+        ucValue[10] = (uint8_t) ulIfIndex;
+        ucValue[11] = 0;
+        pucOut = prvPutTlv(pucOut, LLDP_TLV_TYPE_MGMT_ADDR, -1, ucValue, 12u);
+    }
+
+    pucOut = prvPutTlv(pucOut, LLDP_TLV_TYPE_END_OF_LLDPDU, -1, NULL, 0);
+
+    xLldpduLength = (size_t) (pucOut - ucLldpdu);
+    xStats.ulLength = (uint32_t) xLldpduLength;
+    xStats.ulRebuilds++;
+}
+
+/* Copy of the cache in a network buffer; the driver pads the frame */
+static void prvTransmit(void)
+{
+    NetTxAncillary xAncillary = NET_DEFAULT_TX_ANCILLARY;
+    NetBuffer *pxBuffer;
+    size_t xOffset;
+    error_t err;
+
+    pxBuffer = ethAllocBuffer(xLldpduLength, &xOffset);
+    if (pxBuffer == NULL)
+    {
+        xStats.ulTxErrors++;
+        return;
+    }
+
+    (void) netBufferWrite(pxBuffer, xOffset, ucLldpdu, xLldpduLength);
+
+    osAcquireMutex(&netMutex);
+    err = ethSendFrame(pxLldpInterface, &xLldpMulticastAddr, ETH_TYPE_LLDP, pxBuffer, xOffset, &xAncillary);
+    osReleaseMutex(&netMutex);
+
+    netBufferFree(pxBuffer);
+
+    if (err == NO_ERROR)
+    {
+        xStats.ulFrames++;
+    }
+    else
+    {
+        xStats.ulTxErrors++;
+    }
+}
+
+static void prvLldpTask(void *pvParameters)
+{
+    LldpLocal_t xNow;
+    UBaseType_t uxFast = 0;
+    TickType_t xWait = 0;
+
+    (void) pvParameters;
+
+    memset(&xLocal, 0, sizeof(xLocal));
+
+    for (;;)
+    {
+        (void) ulTaskNotifyTake(pdTRUE, xWait);
+
+        prvReadLocal(&xNow);
+        if (memcmp(&xNow, &xLocal, sizeof(xNow)) != 0)
+        {
+            if (xNow.xLinkUp != pdFALSE && xLocal.xLinkUp == pdFALSE)
+            {
+                uxFast = LLDP_AGENT_FAST_TX_COUNT;
+            }
+            xLocal = xNow;
+            prvBuild();
+        }
+
+        if (xLocal.xLinkUp != pdFALSE)
+        {
+            prvTransmit();
+        }
+        else
+        {
+            uxFast = 0;
+        }
+
+        if (uxFast > 0)
+        {
+            uxFast--;
+        }
+        xWait = pdMS_TO_TICKS((uxFast > 0) ? 1000u : LLDP_AGENT_TX_INTERVAL_S * 1000u);
+    }
+}
+
+BaseType_t xLldpAgentStart(UBaseType_t uxInterface, UBaseType_t uxPriority)
+{
+    error_t err;
+
+    if (uxInterface >= NET_INTERFACE_COUNT)
+    {
+        return pdFAIL;
+    }
+    pxLldpInterface = &netInterface[uxInterface];
+
+    if (xAppTaskCreate(xLldpTask,
+                       prvLldpTask,
+                       "LLDP",
+                       LLDP_AGENT_TASK_STACK_SIZE,
+                       NULL,
+                       uxPriority,
+                       &xLldpTask) != pdPASS)
+    {
+        return pdFAIL;
+    }
+
+    osAcquireMutex(&netMutex);
+    err = netAttachLinkChangeCallback(pxLldpInterface, prvLinkChange, NULL);
+    osReleaseMutex(&netMutex);
+
+    return (err == NO_ERROR) ? pdPASS : pdFAIL;
+}
+
+void vLldpAgentGetStats(LldpAgentStats_t *pxStats)
+{
+    *pxStats = xStats;
+}
+
+static BaseType_t prvLldpCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    LldpAgentStats_t xSnapshot;
+
+    (void) pcCommandString;
+
+    vLldpAgentGetStats(&xSnapshot);
+    snprintf(pcWriteBuffer, xWriteBufferLen, "link %s lldpdu %lu B frames %lu rebuilds %lu errors %lu\r\n",
+             (xLocal.xLinkUp != pdFALSE) ? "up" : "down", (unsigned long) xSnapshot.ulLength,
+             (unsigned long) xSnapshot.ulFrames, (unsigned long) xSnapshot.ulRebuilds,
+             (unsigned long) xSnapshot.ulTxErrors);
+
+    return pdFALSE;
+}
+
+void vLldpAgentRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xLldp);
+}
@@ -0,0 +1,232 @@
+/* LowPower.c
+ *
+ * Sleep hooks of the tickless idle, network standby and "lowpower" command
+ * (see LowPower.h).
+ *
+ * The DWT cycle counter stops while the core sleeps, so the CPU load of
+ * "cpu" counts the idle task for its awake time only; the time asleep is
+ * measured here on TIM5, which keeps running in Sleep mode. TIM5 and the
+ * SysTick both stop in Stop mode, so the time spent in standby is neither
+ * counted nor seen by the kernel.
+ */
+#include "LowPower.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "stm32h7xx_hal.h"
+#include "MonoClock.h"
+#include "ClockGovernor.h"
+#include "core/net.h"
+#include "drivers/mac/stm32h7xx_eth_driver.h"
+#include "drivers/phy/lan8742_driver.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Generated in main.c, restores the PLL after Stop mode */
+extern void SystemClock_Config(void);
+
+/* Sleep accounting, updated with interrupts disabled */
+static volatile uint32_t ulSleeps = 0;
+static volatile uint64_t ullRequestedTicks = 0;
+static volatile uint64_t ullAsleepUs = 0;
+static uint64_t ullSleepStartUs;
+static volatile uint32_t ulStops = 0;
+
+static BaseType_t prvLowPowerCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xLowPower =
+{
+    "lowpower",
+    "\r\nlowpower [standby [magic|unicast] | wake]:\r\n Tickless idle state, time spent asleep and network standby\r\n",
+    prvLowPowerCommand,
+    -1
+};
+
+static UBaseType_t uxLowPowerLine = 0;
+
+void vLowPowerPreSleep(uint32_t *pulExpectedIdleTime)
+{
+    /* The HAL time base only serves timeouts of the drivers, which no task
+     * waits on while the core sleeps */
+    HAL_SuspendTick();
+
+    ulSleeps++;
+    ullRequestedTicks += *pulExpectedIdleTime;
+    ullSleepStartUs = ullMonoClockNowUs();
+
+    /* Stop mode comes back on the boot clock: below it (ClockGovernor.h),
+     * the core sleeps until the governor has restored it */
+    if (xLowPowerIsNetStandby() != pdFALSE && xClockGovernorAtBootClock() != pdFALSE)
+    {
+        /* Nothing but a wakeup frame or an EXTI line ends Stop mode; the
+         * pending interrupt runs once the port re-enables interrupts */
+        ulStops++;
+        HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI);
+
+        /* The core resumes on the HSI */
+        SystemClock_Config();
+
+        /* Tell the port that the wait already happened */
+        *pulExpectedIdleTime = 0;
+    }
+}
+
+void vLowPowerPostSleep(uint32_t ulExpectedIdleTime)
+{
+    (void) ulExpectedIdleTime;
+
+    ullAsleepUs += ullMonoClockNowUs() - ullSleepStartUs;
+    HAL_ResumeTick();
+}
+
+BaseType_t xLowPowerEnterNetStandby(uint32_t ulEvents)
+{
+    error_t xError;
+    NetInterface *pxInterface = &netInterface[0];
+
+    osAcquireMutex(&netMutex);
+    xError = stm32h7xxEthEnterPowerDown(pxInterface, ulEvents);
+#if (LAN8742_EDPD_SUPPORT == DISABLED)
+    if (xError == NO_ERROR)
+    {
+        /* The PHY only powers down once the cable is pulled */
+        lan8742SetEdpdMode(pxInterface, TRUE);
+    }
+#endif
+    osReleaseMutex(&netMutex);
+
+    return (xError == NO_ERROR) ? pdPASS : pdFAIL;
+}
+
+void vLowPowerExitNetStandby(void)
+{
+    NetInterface *pxInterface = &netInterface[0];
+
+    osAcquireMutex(&netMutex);
+    stm32h7xxEthExitPowerDown(pxInterface);
+#if (LAN8742_EDPD_SUPPORT == DISABLED)
+    lan8742SetEdpdMode(pxInterface, FALSE);
+#endif
+    osReleaseMutex(&netMutex);
+}
+
+BaseType_t xLowPowerIsNetStandby(void)
+{
+    Stm32h7xxEthWolStats xStats;
+
+    stm32h7xxEthGetWolStats(&xStats);
+    return (xStats.powerDown != FALSE) ? pdTRUE : pdFALSE;
+}
+
+static BaseType_t prvStandbyCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    const char *pcParameter;
+    BaseType_t xLength;
+    uint32_t ulEvents;
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xLength);
+    if (xLength == 4 && strncmp(pcParameter, "wake", 4) == 0)
+    {
+        vLowPowerExitNetStandby();
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Network standby left\r\n");
+        return pdFALSE;
+    }
+
+    if (xLength != 7 || strncmp(pcParameter, "standby", 7) != 0)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: lowpower [standby [magic|unicast] | wake]\r\n");
+        return pdFALSE;
+    }
+
+    ulEvents = STM32H7XX_ETH_WAKEUP_MAGIC_PACKET | STM32H7XX_ETH_WAKEUP_UNICAST;
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xLength);
+    if (pcParameter != NULL)
+    {
+        if (xLength == 5 && strncmp(pcParameter, "magic", 5) == 0)
+        {
+            ulEvents = STM32H7XX_ETH_WAKEUP_MAGIC_PACKET;
+        }
+        else if (xLength == 7 && strncmp(pcParameter, "unicast", 7) == 0)
+        {
+            ulEvents = STM32H7XX_ETH_WAKEUP_UNICAST;
+        }
+        else
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Unknown wakeup event\r\n");
+            return pdFALSE;
+        }
+    }
+
+    if (xLowPowerEnterNetStandby(ulEvents) != pdPASS)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Network standby not available\r\n");
+        return pdFALSE;
+    }
+
+    /* A reply still being sent when Stop mode is entered goes out on wakeup */
+    snprintf(pcWriteBuffer, xWriteBufferLen, "Network standby, waking on %s\r\n",
+             (ulEvents == STM32H7XX_ETH_WAKEUP_MAGIC_PACKET) ? "magic packet" :
+             (ulEvents == STM32H7XX_ETH_WAKEUP_UNICAST) ? "unicast frame" : "magic packet or unicast frame");
+    return pdFALSE;
+}
+
+static BaseType_t prvLowPowerCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    uint32_t ulCount;
+    uint64_t ullTicks;
+    uint64_t ullAsleep;
+    uint64_t ullUptime;
+    Stm32h7xxEthWolStats xWol;
+    BaseType_t xLength;
+
+    if (uxLowPowerLine == 0 && FreeRTOS_CLIGetParameter(pcCommandString, 1, &xLength) != NULL)
+    {
+        return prvStandbyCommand(pcWriteBuffer, xWriteBufferLen, pcCommandString);
+    }
+
+    switch (uxLowPowerLine++)
+    {
+    case 0:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "tickless: rtos=%s, net=%s, tick %lu Hz, longest sleep %lu ticks\r\n",
+                 (configUSE_TICKLESS_IDLE == 1) ? "on" : "off",
+                 (NET_TICKLESS_SUPPORT == ENABLED) ? "on" : "off",
+                 (unsigned long) configTICK_RATE_HZ,
+                 (unsigned long) (0xFFFFFFul / (configSYSTICK_CLOCK_HZ / configTICK_RATE_HZ)));
+        return pdTRUE;
+    case 1:
+        taskENTER_CRITICAL();
+        ulCount = ulSleeps;
+        ullTicks = ullRequestedTicks;
+        ullAsleep = ullAsleepUs;
+        taskEXIT_CRITICAL();
+
+        ullUptime = ullMonoClockNowUs();
+        snprintf(pcWriteBuffer, xWriteBufferLen, "sleeps=%lu, requested=%lu ticks, asleep=%lu ms (%lu.%lu%% of uptime)\r\n",
+                 (unsigned long) ulCount, (unsigned long) ullTicks, (unsigned long) (ullAsleep / 1000u),
+                 (unsigned long) ((ullUptime > 0) ? (ullAsleep * 100u) / ullUptime : 0),
+                 (unsigned long) ((ullUptime > 0) ? ((ullAsleep * 1000u) / ullUptime) % 10u : 0));
+        return pdTRUE;
+    case 2:
+        stm32h7xxEthGetWolStats(&xWol);
+        snprintf(pcWriteBuffer, xWriteBufferLen, "standby: %s, entered=%lu, stops=%lu, woken by magic=%lu unicast=%lu\r\n",
+                 (xWol.powerDown != FALSE) ? "on" : "off",
+                 (unsigned long) xWol.powerDowns, (unsigned long) ulStops,
+                 (unsigned long) xWol.magicPackets, (unsigned long) xWol.unicastFrames);
+        return pdTRUE;
+    default:
+#if (NET_TICKLESS_SUPPORT == ENABLED)
+        snprintf(pcWriteBuffer, xWriteBufferLen, "net: next periodic operation %lu ms after the last, slack %lu ms\r\n",
+                 (unsigned long) netContext.tickTimeout, (unsigned long) NET_TICKLESS_SLACK);
+#else
+        snprintf(pcWriteBuffer, xWriteBufferLen, "net: periodic operations every %lu ms\r\n",
+                 (unsigned long) NET_TICK_INTERVAL);
+#endif
+        uxLowPowerLine = 0;
+        return pdFALSE;
+    }
+}
+
+void vLowPowerRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xLowPower);
+}
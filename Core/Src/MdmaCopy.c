@@ -0,0 +1,369 @@
+/* MdmaCopy.c
+ *
+ * MDMA copy engine (see MdmaCopy.h). One copy is in flight at a time: on
+ * channel 0 when the source of the transfer is word aligned, on channel 1
+ * otherwise, which reads bytes and packs them into words. The destination
+ * of a transfer is always line aligned. The copy in flight is claimed under
+ * the interrupt mask by its starter, and released by the interrupt once the
+ * channel is done, or by vMdmaCopy() when it cancels it.
+ */
+#include "MdmaCopy.h"
+#include "StaticAlloc.h"
+#include "FreeRTOS_CLI.h"
+#include "task.h"
+#include "semphr.h"
+#include "stm32h7xx_hal.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Line of the D-cache */
+#define MDMA_COPY_LINE                 32u
+#define MDMA_COPY_LINE_MASK            (MDMA_COPY_LINE - 1u)
+
+/* Bytes moved by the channel per request of its FIFO, the most allowed */
+#define MDMA_COPY_BUFFER_LENGTH        128u
+
+typedef struct
+{
+    MDMA_HandleTypeDef *pxChannel;
+    uint8_t *pucDest;           /* Lines moved by the MDMA */
+    const uint8_t *pucSrc;
+    size_t xLength;
+    MdmaCopyCallback_t pxCallback;
+    void *pvContext;
+} MdmaCopyTransfer_t;
+
+static MDMA_HandleTypeDef xWordChannel;
+static MDMA_HandleTypeDef xByteChannel;
+
+static volatile BaseType_t xBusy = pdFALSE;
+static MdmaCopyTransfer_t xActive;
+
+/* Owner of the waits of vMdmaCopy(), and its completion */
+static SemaphoreHandle_t xWaitMutex = NULL;
+APP_MUTEX_STORAGE(xWaitMutex);
+static SemaphoreHandle_t xDone = NULL;
+APP_MUTEX_STORAGE(xDone);
+
+static MdmaCopyStats_t xStats;
+
+static UBaseType_t uxMdmaLine = 0;
+
+static BaseType_t prvMdmaCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xMdma =
+{
+    "mdma",
+    "\r\nmdma:\r\n Copies moved by the MDMA and by the CPU\r\n",
+    prvMdmaCommand,
+    0
+};
+
+static void prvInvalidate(uint8_t *pucDest, size_t xLength)
+{
+    if ((SCB->CCR & SCB_CCR_DC_Msk) != 0)
+    {
+        SCB_InvalidateDCache_by_Addr(pucDest, (int32_t) xLength);
+    }
+}
+
+/* Release the channel and call back; in the MDMA interrupt */
+static void prvRelease(void)
+{
+    MdmaCopyCallback_t pxCallback = xActive.pxCallback;
+    void *pvContext = xActive.pvContext;
+
+    xBusy = pdFALSE;
+
+    if (pxCallback != NULL)
+    {
+        pxCallback(pvContext);
+    }
+}
+
+static void prvTransferDone(MDMA_HandleTypeDef *pxChannel)
+{
+    UBaseType_t uxMask;
+
+    (void) pxChannel;
+
+    /* Lines of the destination may have been fetched meanwhile by
+     * speculative reads */
+    prvInvalidate(xActive.pucDest, xActive.xLength);
+
+    uxMask = taskENTER_CRITICAL_FROM_ISR();
+    xStats.ulDmaCopies++;
+    xStats.ulDmaBytes += xActive.xLength;
+    taskEXIT_CRITICAL_FROM_ISR(uxMask);
+
+    prvRelease();
+}
+
+static void prvTransferError(MDMA_HandleTypeDef *pxChannel)
+{
+    UBaseType_t uxMask;
+
+    (void) pxChannel;
+
+    /* Nothing the MDMA wrote is kept */
+    prvInvalidate(xActive.pucDest, xActive.xLength);
+    memcpy(xActive.pucDest, xActive.pucSrc, xActive.xLength);
+
+    uxMask = taskENTER_CRITICAL_FROM_ISR();
+    xStats.ulErrors++;
+    taskEXIT_CRITICAL_FROM_ISR(uxMask);
+
+    prvRelease();
+}
+
+static void prvChannelInit(MDMA_HandleTypeDef *pxChannel, MDMA_Channel_TypeDef *pxInstance, BaseType_t xWords)
+{
+    HAL_StatusTypeDef xStatus;
+
+    pxChannel->Instance = pxInstance;
+    pxChannel->Init.Request = MDMA_REQUEST_SW;
+    pxChannel->Init.TransferTriggerMode = MDMA_FULL_TRANSFER;
+    pxChannel->Init.Priority = MDMA_PRIORITY_LOW;
+    pxChannel->Init.Endianness = MDMA_LITTLE_ENDIANNESS_PRESERVE;
+    pxChannel->Init.SourceInc = (xWords == pdTRUE) ? MDMA_SRC_INC_WORD : MDMA_SRC_INC_BYTE;
+    pxChannel->Init.DestinationInc = MDMA_DEST_INC_WORD;
+    pxChannel->Init.SourceDataSize = (xWords == pdTRUE) ? MDMA_SRC_DATASIZE_WORD : MDMA_SRC_DATASIZE_BYTE;
+    pxChannel->Init.DestDataSize = MDMA_DEST_DATASIZE_WORD;
+    pxChannel->Init.DataAlignment = MDMA_DATAALIGN_PACKENABLE;
+    pxChannel->Init.BufferTransferLength = MDMA_COPY_BUFFER_LENGTH;
+    /* Bursts of 64 bytes on words, 16 on bytes */
+    pxChannel->Init.SourceBurst = MDMA_SOURCE_BURST_16BEATS;
+    pxChannel->Init.DestBurst = (xWords == pdTRUE) ? MDMA_DEST_BURST_16BEATS : MDMA_DEST_BURST_4BEATS;
+    pxChannel->Init.SourceBlockAddressOffset = 0;
+    pxChannel->Init.DestBlockAddressOffset = 0;
+
+    xStatus = HAL_MDMA_Init(pxChannel);
+    configASSERT(xStatus == HAL_OK);
+
+    pxChannel->XferCpltCallback = prvTransferDone;
+    pxChannel->XferErrorCallback = prvTransferError;
+}
+
+void vMdmaCopyInit(void)
+{
+    __HAL_RCC_MDMA_CLK_ENABLE();
+
+    prvChannelInit(&xWordChannel, MDMA_Channel0, pdTRUE);
+    prvChannelInit(&xByteChannel, MDMA_Channel1, pdFALSE);
+
+    xWaitMutex = xAppSemaphoreCreateMutex(xWaitMutex);
+    xDone = xAppSemaphoreCreateBinary(xDone);
+    configASSERT(xWaitMutex != NULL && xDone != NULL);
+
+    HAL_NVIC_SetPriority(MDMA_IRQn, MDMA_COPY_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(MDMA_IRQn);
+}
+
+static void prvCpuCopy(void *pvDest, const void *pvSrc, size_t xLength)
+{
+    UBaseType_t uxMask;
+
+    memcpy(pvDest, pvSrc, xLength);
+
+    uxMask = taskENTER_CRITICAL_FROM_ISR();
+    xStats.ulCpuCopies++;
+    xStats.ulCpuBytes += xLength;
+    taskEXIT_CRITICAL_FROM_ISR(uxMask);
+}
+
+BaseType_t xMdmaCopyStart(void *pvDest, const void *pvSrc, size_t xLength,
+                          MdmaCopyCallback_t pxCallback, void *pvContext)
+{
+    uint8_t *pucDest = (uint8_t *) pvDest;
+    const uint8_t *pucSrc = (const uint8_t *) pvSrc;
+    size_t xHead = (MDMA_COPY_LINE - ((uint32_t) pucDest & MDMA_COPY_LINE_MASK)) & MDMA_COPY_LINE_MASK;
+    size_t xMiddle = 0;
+    MDMA_HandleTypeDef *pxChannel;
+    BaseType_t xClaimed = pdFALSE;
+    UBaseType_t uxMask;
+
+    /* Whole lines of the destination */
+    if (xLength > xHead)
+    {
+        xMiddle = (xLength - xHead) & ~((size_t) MDMA_COPY_LINE_MASK);
+    }
+
+    if (xMiddle >= MDMA_COPY_MIN_LENGTH && xMiddle <= MDMA_COPY_MAX_LENGTH)
+    {
+        pxChannel = (((uint32_t) (pucSrc + xHead) & 3u) == 0) ? &xWordChannel : &xByteChannel;
+
+        uxMask = taskENTER_CRITICAL_FROM_ISR();
+        if (xBusy == pdFALSE)
+        {
+            xBusy = pdTRUE;
+            xActive.pxChannel = pxChannel;
+            xActive.pucDest = pucDest + xHead;
+            xActive.pucSrc = pucSrc + xHead;
+            xActive.xLength = xMiddle;
+            xActive.pxCallback = pxCallback;
+            xActive.pvContext = pvContext;
+            xClaimed = pdTRUE;
+        }
+        else
+        {
+            xStats.ulBusy++;
+        }
+        taskEXIT_CRITICAL_FROM_ISR(uxMask);
+    }
+
+    if (xClaimed == pdFALSE)
+    {
+        prvCpuCopy(pvDest, pvSrc, xLength);
+        return pdFALSE;
+    }
+
+    /* The head and the tail share their lines with other data */
+    memcpy(pucDest, pucSrc, xHead);
+    memcpy(pucDest + xHead + xMiddle, pucSrc + xHead + xMiddle, xLength - xHead - xMiddle);
+
+    /* The MDMA reads the memory and writes whole lines of the destination,
+     * none of which may be written back over its data */
+    if ((SCB->CCR & SCB_CCR_DC_Msk) != 0)
+    {
+        SCB_CleanDCache_by_Addr((uint32_t *) (pucSrc + xHead), (int32_t) xMiddle);
+    }
+    prvInvalidate(pucDest + xHead, xMiddle);
+
+    if (HAL_MDMA_Start_IT(pxChannel, (uint32_t) (pucSrc + xHead), (uint32_t) (pucDest + xHead),
+                          (uint32_t) xMiddle, 1) != HAL_OK)
+    {
+        memcpy(pucDest + xHead, pucSrc + xHead, xMiddle);
+
+        uxMask = taskENTER_CRITICAL_FROM_ISR();
+        xStats.ulErrors++;
+        xBusy = pdFALSE;
+        taskEXIT_CRITICAL_FROM_ISR(uxMask);
+
+        return pdFALSE;
+    }
+
+    return pdTRUE;
+}
+
+static void prvWake(void *pvContext)
+{
+    BaseType_t xWoken = pdFALSE;
+
+    (void) pvContext;
+
+    xSemaphoreGiveFromISR(xDone, &xWoken);
+    portYIELD_FROM_ISR(xWoken);
+}
+
+/* Take back the transfer in flight from the MDMA, and copy it */
+static void prvCancel(void)
+{
+    BaseType_t xCancelled = pdFALSE;
+
+    /* The completion may come just before: the channel is then free */
+    taskENTER_CRITICAL();
+    if (xBusy == pdTRUE)
+    {
+        __HAL_MDMA_DISABLE_IT(xActive.pxChannel, MDMA_IT_TE | MDMA_IT_CTC | MDMA_IT_BT | MDMA_IT_BRT | MDMA_IT_BFTC);
+        xStats.ulTimeouts++;
+        xCancelled = pdTRUE;
+    }
+    taskEXIT_CRITICAL();
+
+    if (xCancelled == pdTRUE)
+    {
+        (void) HAL_MDMA_Abort(xActive.pxChannel);
+        prvInvalidate(xActive.pucDest, xActive.xLength);
+        memcpy(xActive.pucDest, xActive.pucSrc, xActive.xLength);
+        xBusy = pdFALSE;
+    }
+}
+
+/* A task that may block */
+static BaseType_t prvCanWait(void)
+{
+    if (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING || xPortIsInsideInterrupt() == pdTRUE)
+    {
+        return pdFALSE;
+    }
+
+    return (__get_BASEPRI() == 0 && __get_PRIMASK() == 0) ? pdTRUE : pdFALSE;
+}
+
+void vMdmaCopy(void *pvDest, const void *pvSrc, size_t xLength)
+{
+    uint8_t *pucDest = (uint8_t *) pvDest;
+    const uint8_t *pucSrc = (const uint8_t *) pvSrc;
+    size_t xChunk;
+
+    if (xLength < MDMA_COPY_BLOCK_LENGTH || xWaitMutex == NULL || prvCanWait() == pdFALSE ||
+        xSemaphoreTake(xWaitMutex, 0) != pdTRUE)
+    {
+        prvCpuCopy(pvDest, pvSrc, xLength);
+        return;
+    }
+
+    while (xLength > 0)
+    {
+        xChunk = (xLength < MDMA_COPY_MAX_LENGTH) ? xLength : MDMA_COPY_MAX_LENGTH;
+
+        /* A completion left over by a cancelled transfer */
+        (void) xSemaphoreTake(xDone, 0);
+
+        if (xMdmaCopyStart(pucDest, pucSrc, xChunk, prvWake, NULL) == pdTRUE &&
+            xSemaphoreTake(xDone, pdMS_TO_TICKS(MDMA_COPY_TIMEOUT_MS)) != pdTRUE)
+        {
+            prvCancel();
+        }
+
+        pucDest += xChunk;
+        pucSrc += xChunk;
+        xLength -= xChunk;
+    }
+
+    xSemaphoreGive(xWaitMutex);
+}
+
+void MDMA_IRQHandler(void)
+{
+    HAL_MDMA_IRQHandler(&xWordChannel);
+    HAL_MDMA_IRQHandler(&xByteChannel);
+}
+
+void vMdmaCopyGetStats(MdmaCopyStats_t *pxStats)
+{
+    UBaseType_t uxMask;
+
+    uxMask = taskENTER_CRITICAL_FROM_ISR();
+    *pxStats = xStats;
+    taskEXIT_CRITICAL_FROM_ISR(uxMask);
+}
+
+void vMdmaCopyRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xMdma);
+}
+
+static BaseType_t prvMdmaCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    static MdmaCopyStats_t xShown;
+
+    (void) pcCommandString;
+
+    if (uxMdmaLine == 0)
+    {
+        vMdmaCopyGetStats(&xShown);
+        snprintf(pcWriteBuffer, xWriteBufferLen, "MDMA %lu copies, %lu bytes; CPU %lu copies, %lu bytes\r\n",
+                 (unsigned long) xShown.ulDmaCopies, (unsigned long) xShown.ulDmaBytes,
+                 (unsigned long) xShown.ulCpuCopies, (unsigned long) xShown.ulCpuBytes);
+        uxMdmaLine = 1;
+        return pdTRUE;
+    }
+
+    snprintf(pcWriteBuffer, xWriteBufferLen, "busy %lu, errors %lu, timeouts %lu, %s\r\n",
+             (unsigned long) xShown.ulBusy, (unsigned long) xShown.ulErrors,
+             (unsigned long) xShown.ulTimeouts, (xBusy == pdTRUE) ? "transfer in flight" : "idle");
+    uxMdmaLine = 0;
+
+    return pdFALSE;
+}
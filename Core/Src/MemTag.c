@@ -0,0 +1,311 @@
+/* MemTag.c
+ *
+ * Allocation accounting per subsystem (see MemTag.h).
+ *
+ * The counters of a tag are updated in a short critical section that masks
+ * the interrupts up to configMAX_SYSCALL_INTERRUPT_PRIORITY, as the TLSF
+ * heap does, since osAllocMem() may be called from interrupts.
+ *
+ * The "memtags" command shows, per tag, the bytes live and their peak, the
+ * allocation rate since the previous display, and the growth of the live
+ * bytes since "memtags mark": a slow leak shows as a growth that keeps
+ * rising from one display to the next while the rate stays flat.
+ */
+#include "MemTag.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "TlsfHeap.h"
+#include "os_port.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MEM_TAG_MAGIC                  0x6D74u
+
+typedef struct
+{
+    uint32_t ulSize;
+    uint16_t usMagic;
+    uint8_t ucTag;
+    uint8_t ucReserved;
+} MemTagHeader_t;
+
+typedef struct
+{
+    const char *pcPrefix;       /* Start of the file name */
+    uint8_t ucTag;
+} MemTagRule_t;
+
+/* First match wins; files of CycloneTCP matching none are charged to "net" */
+static const MemTagRule_t xRules[] =
+{
+    { "tcp", eMemTagTcp },
+    { "udp", eMemTagUdp },
+    { "dns", eMemTagDns },
+    { "mdns", eMemTagDns },
+    { "nbns", eMemTagDns },
+    { "llmnr", eMemTagDns },
+    { "http", eMemTagHttp },
+    { "Http", eMemTagHttp },
+    { "web_socket", eMemTagHttp },
+    { "WebSocket", eMemTagHttp },
+    { "tls", eMemTagTls },
+    { "Cyphal", eMemTagUdpard },
+    { "udpard", eMemTagUdpard },
+    { "CommandConsole", eMemTagCli },
+    { "FreeRTOS_CLI", eMemTagCli },
+};
+
+static const char * const pcTagNames[eMemTagCount] =
+{
+    "other", "net", "tcp", "udp", "dns", "http", "tls", "udpard", "cli"
+};
+
+static MemTagStats_t xTagStats[eMemTagCount];
+
+/* Live bytes at the last "memtags mark" */
+static size_t xTagMark[eMemTagCount];
+
+/* Per-tag counters of the report in progress; the allocation rates are
+ * computed against the counts and the tick of the previous report */
+static MemTagStats_t xTagReport[eMemTagCount];
+static uint32_t ulPrevAllocs[eMemTagCount];
+static TickType_t xPrevReportTick = 0;
+static TickType_t xReportElapsed = 0;
+static UBaseType_t uxMemTagLine = 0;
+
+static inline uint8_t prvTag(uint8_t ucTag)
+{
+    return (ucTag < eMemTagCount) ? ucTag : (uint8_t) eMemTagOther;
+}
+
+uint8_t ucMemTagOfFile(const char *pcPath)
+{
+    const char *pcName = pcPath;
+    const char *pc;
+    size_t i;
+
+    for (pc = pcPath; *pc != '\0'; pc++)
+    {
+        if (*pc == '/' || *pc == '\\')
+        {
+            pcName = pc + 1;
+        }
+    }
+
+    for (i = 0; i < sizeof(xRules) / sizeof(xRules[0]); i++)
+    {
+        if (strncmp(pcName, xRules[i].pcPrefix, strlen(xRules[i].pcPrefix)) == 0)
+        {
+            return xRules[i].ucTag;
+        }
+    }
+
+    return (strstr(pcPath, "cyclone_tcp") != NULL) ? (uint8_t) eMemTagNet : (uint8_t) eMemTagOther;
+}
+
+const char *pcMemTagName(uint8_t ucTag)
+{
+    return pcTagNames[prvTag(ucTag)];
+}
+
+void vMemTagCharge(uint8_t ucTag, size_t xBytes)
+{
+    MemTagStats_t *pxStats = &xTagStats[prvTag(ucTag)];
+    UBaseType_t uxMask;
+
+    uxMask = taskENTER_CRITICAL_FROM_ISR();
+    {
+        pxStats->xLive += xBytes;
+        if (pxStats->xLive > pxStats->xPeak)
+        {
+            pxStats->xPeak = pxStats->xLive;
+        }
+        pxStats->ulAllocs++;
+    }
+    taskEXIT_CRITICAL_FROM_ISR(uxMask);
+}
+
+void vMemTagCredit(uint8_t ucTag, size_t xBytes)
+{
+    MemTagStats_t *pxStats = &xTagStats[prvTag(ucTag)];
+    UBaseType_t uxMask;
+
+    uxMask = taskENTER_CRITICAL_FROM_ISR();
+    {
+        configASSERT(pxStats->xLive >= xBytes);
+        pxStats->xLive -= xBytes;
+        pxStats->ulFrees++;
+    }
+    taskEXIT_CRITICAL_FROM_ISR(uxMask);
+}
+
+void vMemTagFailure(uint8_t ucTag)
+{
+    MemTagStats_t *pxStats = &xTagStats[prvTag(ucTag)];
+    UBaseType_t uxMask;
+
+    uxMask = taskENTER_CRITICAL_FROM_ISR();
+    pxStats->ulFailures++;
+    taskEXIT_CRITICAL_FROM_ISR(uxMask);
+}
+
+void vMemTagGetStats(uint8_t ucTag, MemTagStats_t *pxStats)
+{
+    UBaseType_t uxMask;
+
+    uxMask = taskENTER_CRITICAL_FROM_ISR();
+    *pxStats = xTagStats[prvTag(ucTag)];
+    taskEXIT_CRITICAL_FROM_ISR(uxMask);
+}
+
+#if (MEM_TAG_SUPPORT == 1)
+
+/* The heap behind osAllocMem(): TLSF, or heap_4 without it */
+static void *prvHeapAlloc(size_t xSize)
+{
+#if (TLSF_HEAP_SUPPORT == 1)
+    return pvTlsfHeapAlloc(xSize);
+#else
+    return pvPortMalloc(xSize);
+#endif
+}
+
+static void prvHeapFree(void *pv)
+{
+#if (TLSF_HEAP_SUPPORT == 1)
+    vTlsfHeapFree(pv);
+#else
+    vPortFree(pv);
+#endif
+}
+
+void *osAllocMemTagged(size_t size, uint8_t ucTag)
+{
+    MemTagHeader_t *pxHeader;
+
+    ucTag = prvTag(ucTag);
+
+    pxHeader = (MemTagHeader_t *) prvHeapAlloc(size + MEM_TAG_HEADER_SIZE);
+    if (pxHeader == NULL)
+    {
+        vMemTagFailure(ucTag);
+        return NULL;
+    }
+
+    pxHeader->ulSize = (uint32_t) size;
+    pxHeader->usMagic = MEM_TAG_MAGIC;
+    pxHeader->ucTag = ucTag;
+    pxHeader->ucReserved = 0;
+    vMemTagCharge(ucTag, size);
+
+    return (uint8_t *) pxHeader + MEM_TAG_HEADER_SIZE;
+}
+
+uint8_t ucMemTagOfBlock(const void *pv)
+{
+    const MemTagHeader_t *pxHeader = (const MemTagHeader_t *) ((const uint8_t *) pv - MEM_TAG_HEADER_SIZE);
+
+    return (pxHeader->usMagic == MEM_TAG_MAGIC) ? pxHeader->ucTag : (uint8_t) eMemTagOther;
+}
+
+/* Strong definitions over the weak ones of os_port_freertos.c (and in place
+   of those of TlsfHeap.c); the name in parentheses is not the macro */
+void *(osAllocMem)(size_t size)
+{
+    return osAllocMemTagged(size, eMemTagOther);
+}
+
+void osFreeMem(void *p)
+{
+    MemTagHeader_t *pxHeader;
+
+    if (p == NULL)
+    {
+        return;
+    }
+
+    pxHeader = (MemTagHeader_t *) ((uint8_t *) p - MEM_TAG_HEADER_SIZE);
+
+    /* Not from osAllocMem(), or freed twice */
+    configASSERT(pxHeader->usMagic == MEM_TAG_MAGIC);
+
+    vMemTagCredit(pxHeader->ucTag, pxHeader->ulSize);
+    pxHeader->usMagic = 0;
+    prvHeapFree(pxHeader);
+}
+
+#endif /* MEM_TAG_SUPPORT */
+
+static BaseType_t prvMemTagCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xMemTags =
+{
+    "memtags",
+    "\r\nmemtags [mark]:\r\n Live bytes, peak and allocation rate per subsystem; mark sets the base of the growth column\r\n",
+    prvMemTagCommand,
+    -1
+};
+
+static BaseType_t prvMemTagCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    const MemTagStats_t *pxStats;
+    const char *pcParameter;
+    BaseType_t xParameterLength;
+    TickType_t xNow;
+    UBaseType_t uxTag;
+    uint32_t ulRate;
+
+    if (uxMemTagLine == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterLength);
+        for (uxTag = 0; uxTag < eMemTagCount; uxTag++)
+        {
+            vMemTagGetStats((uint8_t) uxTag, &xTagReport[uxTag]);
+        }
+
+        if (pcParameter != NULL && xParameterLength == 4 && strncmp(pcParameter, "mark", 4) == 0)
+        {
+            for (uxTag = 0; uxTag < eMemTagCount; uxTag++)
+            {
+                xTagMark[uxTag] = xTagReport[uxTag].xLive;
+            }
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Growth counted from now\r\n");
+            return pdFALSE;
+        }
+
+        xNow = xTaskGetTickCount();
+        xReportElapsed = xNow - xPrevReportTick;
+        xPrevReportTick = xNow;
+
+        snprintf(pcWriteBuffer, xWriteBufferLen, "tag          live      peak    allocs     frees  failed  alloc/s    growth\r\n");
+        uxMemTagLine++;
+        return pdTRUE;
+    }
+
+    uxTag = uxMemTagLine - 1;
+    pxStats = &xTagReport[uxTag];
+
+    /* Allocations per second since the previous display */
+    ulRate = (xReportElapsed > 0)
+        ? (uint32_t) (((uint64_t) (pxStats->ulAllocs - ulPrevAllocs[uxTag]) * configTICK_RATE_HZ) / xReportElapsed) : 0;
+    ulPrevAllocs[uxTag] = pxStats->ulAllocs;
+
+    snprintf(pcWriteBuffer, xWriteBufferLen, "%-8s %8lu  %8lu  %8lu  %8lu  %6lu  %7lu  %+8ld\r\n",
+             pcMemTagName((uint8_t) uxTag), (unsigned long) pxStats->xLive, (unsigned long) pxStats->xPeak,
+             (unsigned long) pxStats->ulAllocs, (unsigned long) pxStats->ulFrees,
+             (unsigned long) pxStats->ulFailures, (unsigned long) ulRate,
+             (long) pxStats->xLive - (long) xTagMark[uxTag]);
+
+    if (++uxMemTagLine > eMemTagCount)
+    {
+        uxMemTagLine = 0;
+        return pdFALSE;
+    }
+    return pdTRUE;
+}
+
+void vMemTagRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xMemTags);
+}
@@ -0,0 +1,233 @@
+/* MemoryLayout.c
+ *
+ * MPU regions and caches of the Cortex-M7 (see MemoryLayout.h), and the
+ * "memmap" command.
+ *
+ * Region 0, set by MPU_Config(), denies the 4 GB space outside the memories
+ * and the system area. The regions below take precedence over it, and over
+ * each other in increasing order: the non-cacheable region overlaps the start
+ * of the cacheable D2 SRAM region. The flash keeps its default attributes,
+ * write-through, which suits memory the CPU only reads.
+ */
+#include "MemoryLayout.h"
+#include "FreeRTOS_CLI.h"
+#include "stm32h7xx_hal.h"
+#include "core/net.h"
+#include "drivers/mac/stm32h7xx_eth_driver.h"
+#include <stdio.h>
+
+/* With the data cache enabled, the Ethernet buffers are maintained by the
+ * driver: only the descriptors fit in the non-cacheable region */
+#if (STM32H7XX_ETH_CACHE_MAINTENANCE != ENABLED)
+#error STM32H7XX_ETH_CACHE_MAINTENANCE must be enabled along with the data cache
+#endif
+
+/* Defined by the linker scripts */
+extern uint32_t _sram_no_cache;
+extern uint32_t _eram_no_cache;
+
+/* An MPU region programmed by vMemoryLayoutInit() */
+typedef struct
+{
+    const char *pcName;
+    uint8_t ucNumber;
+    uint32_t ulBase;
+    uint8_t ucSize;          /* MPU_REGION_SIZE_xxx */
+    uint8_t ucCacheable;     /* Write-back cacheable, else non-cacheable and shareable */
+} MemoryMpuRegion_t;
+
+static const MemoryMpuRegion_t xRegions[] =
+{
+    { "axi-sram", MPU_REGION_NUMBER1, 0x24000000u, MPU_REGION_SIZE_512KB, 1 },
+    { "d2-sram", MPU_REGION_NUMBER2, 0x30000000u, MPU_REGION_SIZE_32KB, 1 },
+    { "d3-sram", MPU_REGION_NUMBER3, 0x38000000u, MPU_REGION_SIZE_16KB, 1 },
+    { "no-cache", MPU_REGION_NUMBER4, MEMORY_NO_CACHE_BASE, MPU_REGION_SIZE_2KB, 0 }
+};
+
+#define MEMORY_REGIONS                 (sizeof(xRegions) / sizeof(xRegions[0]))
+
+/* The size field of the no-cache region must match MEMORY_NO_CACHE_SIZE */
+#define MEMORY_REGION_BYTES(size)      (2u << (size))
+
+static BaseType_t prvMemmapCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xMemmap =
+{
+    "memmap",
+    "\r\nmemmap:\r\n MPU regions, cache state and non-cacheable section\r\n",
+    prvMemmapCommand,
+    0
+};
+
+static UBaseType_t uxMemmapLine = 0;
+
+/* RASR value written by HAL_MPU_ConfigRegion() for a region of the table */
+static uint32_t prvRegionAttributes(const MemoryMpuRegion_t *pxRegion, MPU_Region_InitTypeDef *pxInit)
+{
+    pxInit->Enable = MPU_REGION_ENABLE;
+    pxInit->Number = pxRegion->ucNumber;
+    pxInit->BaseAddress = pxRegion->ulBase;
+    pxInit->Size = pxRegion->ucSize;
+    pxInit->SubRegionDisable = 0x00;
+    pxInit->TypeExtField = MPU_TEX_LEVEL1;
+    pxInit->AccessPermission = MPU_REGION_FULL_ACCESS;
+
+    if (pxRegion->ucCacheable)
+    {
+        /* Normal memory, write-back, read and write allocate */
+        pxInit->DisableExec = MPU_INSTRUCTION_ACCESS_ENABLE;
+        pxInit->IsShareable = MPU_ACCESS_NOT_SHAREABLE;
+        pxInit->IsCacheable = MPU_ACCESS_CACHEABLE;
+        pxInit->IsBufferable = MPU_ACCESS_BUFFERABLE;
+    }
+    else
+    {
+        /* Normal memory, non-cacheable; never holds code */
+        pxInit->DisableExec = MPU_INSTRUCTION_ACCESS_DISABLE;
+        pxInit->IsShareable = MPU_ACCESS_SHAREABLE;
+        pxInit->IsCacheable = MPU_ACCESS_NOT_CACHEABLE;
+        pxInit->IsBufferable = MPU_ACCESS_NOT_BUFFERABLE;
+    }
+
+    return ((uint32_t) pxInit->DisableExec << MPU_RASR_XN_Pos) |
+           ((uint32_t) pxInit->AccessPermission << MPU_RASR_AP_Pos) |
+           ((uint32_t) pxInit->TypeExtField << MPU_RASR_TEX_Pos) |
+           ((uint32_t) pxInit->IsShareable << MPU_RASR_S_Pos) |
+           ((uint32_t) pxInit->IsCacheable << MPU_RASR_C_Pos) |
+           ((uint32_t) pxInit->IsBufferable << MPU_RASR_B_Pos) |
+           ((uint32_t) pxInit->SubRegionDisable << MPU_RASR_SRD_Pos) |
+           ((uint32_t) pxInit->Size << MPU_RASR_SIZE_Pos) |
+           ((uint32_t) pxInit->Enable << MPU_RASR_ENABLE_Pos);
+}
+
+/* Whether the MPU holds the region as programmed */
+static BaseType_t prvRegionValid(const MemoryMpuRegion_t *pxRegion)
+{
+    MPU_Region_InitTypeDef xInit;
+    uint32_t ulRasr = prvRegionAttributes(pxRegion, &xInit);
+
+    MPU->RNR = pxRegion->ucNumber;
+
+    return ((MPU->RBAR & MPU_RBAR_ADDR_Msk) == pxRegion->ulBase && MPU->RASR == ulRasr) ? pdPASS : pdFAIL;
+}
+
+/* Whether an area lies within the non-cacheable region */
+static BaseType_t prvInNoCache(uint32_t ulStart, uint32_t ulEnd)
+{
+    return (ulStart >= MEMORY_NO_CACHE_BASE && ulEnd <= MEMORY_NO_CACHE_BASE + MEMORY_NO_CACHE_SIZE) ? pdPASS : pdFAIL;
+}
+
+void vMemoryLayoutInit(void)
+{
+    MPU_Region_InitTypeDef xInit;
+    size_t i;
+
+    HAL_MPU_Disable();
+
+    for (i = 0; i < MEMORY_REGIONS; i++)
+    {
+        (void) prvRegionAttributes(&xRegions[i], &xInit);
+        HAL_MPU_ConfigRegion(&xInit);
+    }
+
+    HAL_MPU_Enable(MPU_PRIVILEGED_DEFAULT);
+
+    /* Both functions invalidate the cache before enabling it */
+    SCB_EnableICache();
+    SCB_EnableDCache();
+}
+
+BaseType_t xMemoryLayoutCheck(void)
+{
+    uint32_t ulStart = (uint32_t) (uintptr_t) &_sram_no_cache;
+    uint32_t ulEnd = (uint32_t) (uintptr_t) &_eram_no_cache;
+    size_t i;
+
+    /* The MPU masks the low bits of the base with the size */
+    if (MEMORY_REGION_BYTES(MPU_REGION_SIZE_2KB) != MEMORY_NO_CACHE_SIZE ||
+        (MEMORY_NO_CACHE_BASE & (MEMORY_NO_CACHE_SIZE - 1u)) != 0)
+    {
+        return pdFAIL;
+    }
+
+    if ((MPU->CTRL & MPU_CTRL_ENABLE_Msk) == 0 ||
+        (SCB->CCR & SCB_CCR_IC_Msk) == 0 || (SCB->CCR & SCB_CCR_DC_Msk) == 0)
+    {
+        return pdFAIL;
+    }
+
+    for (i = 0; i < MEMORY_REGIONS; i++)
+    {
+        if (prvRegionValid(&xRegions[i]) != pdPASS)
+        {
+            return pdFAIL;
+        }
+    }
+
+    /* The linker fails if the section outgrows RAM_D2_NC; this catches a
+     * region of the scripts moved without MEMORY_NO_CACHE_BASE */
+    if (prvInNoCache(ulStart, ulEnd) != pdPASS)
+    {
+        return pdFAIL;
+    }
+
+    /* Once the Ethernet MAC is started, its rings must be in the section */
+    if (ETH->DMACTDLAR != 0 && prvInNoCache(ETH->DMACTDLAR, ETH->DMACTDLAR + 1u) != pdPASS)
+    {
+        return pdFAIL;
+    }
+    if (ETH->DMACRDLAR != 0 && prvInNoCache(ETH->DMACRDLAR, ETH->DMACRDLAR + 1u) != pdPASS)
+    {
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+
+static BaseType_t prvMemmapCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    const MemoryMpuRegion_t *pxRegion;
+
+    (void) pcCommandString;
+
+    if (uxMemmapLine < MEMORY_REGIONS)
+    {
+        pxRegion = &xRegions[uxMemmapLine++];
+        snprintf(pcWriteBuffer, xWriteBufferLen, "mpu %u: %-9s 0x%08lx %6lu bytes %s %s\r\n",
+                 (unsigned int) pxRegion->ucNumber, pxRegion->pcName, (unsigned long) pxRegion->ulBase,
+                 (unsigned long) MEMORY_REGION_BYTES(pxRegion->ucSize),
+                 pxRegion->ucCacheable ? "write-back" : "non-cacheable",
+                 (prvRegionValid(pxRegion) == pdPASS) ? "ok" : "MISMATCH");
+        return pdTRUE;
+    }
+
+    switch (uxMemmapLine++ - MEMORY_REGIONS)
+    {
+    case 0:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "caches: i=%s d=%s\r\n",
+                 ((SCB->CCR & SCB_CCR_IC_Msk) != 0) ? "on" : "off",
+                 ((SCB->CCR & SCB_CCR_DC_Msk) != 0) ? "on" : "off");
+        return pdTRUE;
+    case 1:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "%s: 0x%08lx-0x%08lx, %lu of %lu bytes\r\n",
+                 MEMORY_NO_CACHE_SECTION, (unsigned long) (uintptr_t) &_sram_no_cache,
+                 (unsigned long) (uintptr_t) &_eram_no_cache,
+                 (unsigned long) ((uintptr_t) &_eram_no_cache - (uintptr_t) &_sram_no_cache),
+                 (unsigned long) MEMORY_NO_CACHE_SIZE);
+        return pdTRUE;
+    case 2:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "eth rings: tx 0x%08lx rx 0x%08lx\r\n",
+                 (unsigned long) ETH->DMACTDLAR, (unsigned long) ETH->DMACRDLAR);
+        return pdTRUE;
+    default:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "check: %s\r\n",
+                 (xMemoryLayoutCheck() == pdPASS) ? "pass" : "FAIL");
+        uxMemmapLine = 0;
+        return pdFALSE;
+    }
+}
+
+void vMemoryLayoutRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xMemmap);
+}
@@ -0,0 +1,711 @@
+/* MicroBench.c
+ *
+ * "bench" command: timed micro-benchmarks of the core primitives (see
+ * MicroBench.h).
+ *
+ * The tests are listed in a table, each with a number of variants (e.g. the
+ * pairs of regions of the copies); the command takes one measurement per
+ * output line, so that a long suite never holds the console for more than
+ * a few hundred microseconds at a time. Buffers are allocated for one
+ * measurement and freed after it.
+ *
+ * The scheduler tests bounce a binary semaphore off a helper task created
+ * on first use, one priority level above the caller so that giving the
+ * semaphore switches to it at once: "switch" is the time from the give to
+ * the helper running, "sem-rtt" the time until the caller has taken the
+ * answer back.
+ */
+#include "MicroBench.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "stream_buffer.h"
+#include "FreeRTOS_CLI.h"
+#include "stm32h7xx_hal.h"
+#include "StaticAlloc.h"
+#include "RegionHeap.h"
+#include "MemoryLayout.h"
+#include "TcmPlacement.h"
+#include "CyphalCrc.h"
+#include "CyphalMemory.h"
+#include "CyphalNode.h"
+#include "TelemetryEncoder.h"
+#include "core/net.h"
+#include "core/ip.h"
+#include "udpard.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Size of the ITCM, as in the linker scripts */
+#define MICRO_BENCH_ITCM_SIZE          (64u * 1024u)
+
+/* Frames of the largest transfer serialized, and room for each TX item */
+#define MICRO_BENCH_TX_ITEMS           3u
+#define MICRO_BENCH_TX_BLOCK_SIZE      1536u
+
+/* Defined by the linker scripts */
+extern uint32_t _eitcm_text;
+
+typedef enum
+{
+    eBenchItcm = 0,
+    eBenchDtcm,
+    eBenchD1,
+    eBenchD2,
+    eBenchD3,
+    eBenchNoCache,
+    eBenchRegionCount
+} MicroBenchRegion_t;
+
+static const char * const pcRegionNames[eBenchRegionCount] =
+{
+    "itcm", "dtcm", "d1", "d2", "d3", "nc"
+};
+
+/* Cycle counts of one measurement */
+typedef struct
+{
+    char cName[16];
+    uint32_t ulBytes;
+    uint32_t ulRuns;
+    uint32_t ulMin;
+    uint32_t ulMax;
+    uint64_t ullSum;
+} MicroBenchResult_t;
+
+typedef struct
+{
+    const char *pcGroup;
+    UBaseType_t uxVariants;
+    void (*pxRun)(UBaseType_t uxVariant, MicroBenchResult_t *pxResult);
+} MicroBenchTest_t;
+
+static void prvBenchMemcpy(UBaseType_t uxVariant, MicroBenchResult_t *pxResult);
+static void prvBenchChecksum(UBaseType_t uxVariant, MicroBenchResult_t *pxResult);
+static void prvBenchNetBuffer(UBaseType_t uxVariant, MicroBenchResult_t *pxResult);
+static void prvBenchCrc(UBaseType_t uxVariant, MicroBenchResult_t *pxResult);
+static void prvBenchPublish(UBaseType_t uxVariant, MicroBenchResult_t *pxResult);
+static void prvBenchStream(UBaseType_t uxVariant, MicroBenchResult_t *pxResult);
+static void prvBenchScheduler(UBaseType_t uxVariant, MicroBenchResult_t *pxResult);
+static void prvBenchTelemetry(UBaseType_t uxVariant, MicroBenchResult_t *pxResult);
+
+/* Payloads serialized by udpardTxPublish: one frame, and three */
+static const size_t xPublishSizes[] = { 8u, 256u, 2u * UDPARD_MTU_DEFAULT + 64u };
+
+/* Chunks moved through the stream buffer */
+static const size_t xStreamChunks[] = { 16u, 64u, 256u };
+
+#define MICRO_BENCH_COUNT(x)           (sizeof(x) / sizeof((x)[0]))
+
+static const MicroBenchTest_t xTests[] =
+{
+    /* Every source, into every region but the D2 SRAM */
+    { "memcpy", eBenchRegionCount * (eBenchRegionCount - 1), prvBenchMemcpy },
+    /* Short and long, aligned and not */
+    { "checksum", 4, prvBenchChecksum },
+    /* Alloc then free, short and long */
+    { "netbuf", 4, prvBenchNetBuffer },
+    { "udpard", 1, prvBenchCrc },
+    { "udpard", MICRO_BENCH_COUNT(xPublishSizes), prvBenchPublish },
+    { "stream", MICRO_BENCH_COUNT(xStreamChunks), prvBenchStream },
+    { "sched", 2, prvBenchScheduler },
+    /* CBOR and JSON */
+    { "telemetry", 2, prvBenchTelemetry }
+};
+
+/* Block of the non-cacheable section: a source and a destination */
+static uint8_t ucNoCache[2u * MICRO_BENCH_COPY_SIZE] MEMORY_NO_CACHE;
+
+/* Stream buffer of the throughput test */
+static StreamBufferHandle_t xStream = NULL;
+APP_STREAM_STORAGE(xStream, MICRO_BENCH_STREAM_SIZE);
+
+/* Helper task of the scheduler tests */
+static TaskHandle_t xHelperTask = NULL;
+static SemaphoreHandle_t xPing = NULL;
+static SemaphoreHandle_t xPong = NULL;
+static volatile uint32_t ulHelperWoken;
+APP_TASK_STORAGE(xHelperTask, MICRO_BENCH_HELPER_STACK_SIZE);
+APP_MUTEX_STORAGE(xPing);
+APP_MUTEX_STORAGE(xPong);
+
+static void prvResultStart(MicroBenchResult_t *pxResult, uint32_t ulBytes)
+{
+    pxResult->ulBytes = ulBytes;
+    pxResult->ulRuns = 0;
+    pxResult->ulMin = UINT32_MAX;
+    pxResult->ulMax = 0;
+    pxResult->ullSum = 0;
+}
+
+static void prvResultAdd(MicroBenchResult_t *pxResult, uint32_t ulCycles)
+{
+    pxResult->ulRuns++;
+    pxResult->ullSum += ulCycles;
+    if (ulCycles < pxResult->ulMin)
+    {
+        pxResult->ulMin = ulCycles;
+    }
+    if (ulCycles > pxResult->ulMax)
+    {
+        pxResult->ulMax = ulCycles;
+    }
+}
+
+/* Cache-line aligned buffer of xSize bytes in a region, NULL if it has no
+ * room; *ppvBlock receives what to free, if anything. uxSlot picks one of
+ * the two buffers of the static regions */
+static uint8_t *prvRegionBuffer(MicroBenchRegion_t eRegion, UBaseType_t uxSlot, size_t xSize, void **ppvBlock)
+{
+    uintptr_t xBase;
+    void *pvBlock = NULL;
+
+    *ppvBlock = NULL;
+
+    switch (eRegion)
+    {
+    case eBenchItcm:
+        /* Above the code copied at start, which must leave room */
+        xBase = MICRO_BENCH_ITCM_SIZE - (uxSlot + 1u) * MICRO_BENCH_COPY_SIZE;
+        if (xSize > MICRO_BENCH_COPY_SIZE || xBase < (uintptr_t) &_eitcm_text)
+        {
+            return NULL;
+        }
+        return (uint8_t *) xBase;
+    case eBenchD2:
+        /* Read only: the region belongs to the TCP/IP stack */
+        return (uxSlot == 0 && xSize <= MICRO_BENCH_COPY_SIZE) ? (uint8_t *) MICRO_BENCH_D2_BASE : NULL;
+    case eBenchNoCache:
+        return (xSize <= MICRO_BENCH_COPY_SIZE) ? &ucNoCache[uxSlot * MICRO_BENCH_COPY_SIZE] : NULL;
+    case eBenchDtcm:
+        pvBlock = pvRegionHeapAlloc(eRegionHeapDtcm, xSize + 32u);
+        break;
+    case eBenchD1:
+        pvBlock = pvRegionHeapAlloc(eRegionHeapD1, xSize + 32u);
+        break;
+    case eBenchD3:
+        pvBlock = pvRegionHeapAlloc(eRegionHeapD3, xSize + 32u);
+        break;
+    default:
+        break;
+    }
+
+    if (pvBlock == NULL)
+    {
+        return NULL;
+    }
+
+    *ppvBlock = pvBlock;
+    return (uint8_t *) (((uintptr_t) pvBlock + 31u) & ~(uintptr_t) 31u);
+}
+
+static void prvBenchMemcpy(UBaseType_t uxVariant, MicroBenchResult_t *pxResult)
+{
+    MicroBenchRegion_t eSrc = (MicroBenchRegion_t) (uxVariant / (eBenchRegionCount - 1));
+    MicroBenchRegion_t eDst = (MicroBenchRegion_t) (uxVariant % (eBenchRegionCount - 1));
+    void *pvSrcBlock;
+    void *pvDstBlock;
+    uint8_t *pucSrc;
+    uint8_t *pucDst;
+    uint32_t ulStart;
+    uint32_t ulCycles;
+    UBaseType_t i;
+
+    /* The destinations skip the D2 SRAM */
+    if (eDst >= eBenchD2)
+    {
+        eDst = (MicroBenchRegion_t) (eDst + 1);
+    }
+
+    snprintf(pxResult->cName, sizeof(pxResult->cName), "%s>%s", pcRegionNames[eSrc], pcRegionNames[eDst]);
+    prvResultStart(pxResult, MICRO_BENCH_COPY_SIZE);
+
+    pucSrc = prvRegionBuffer(eSrc, 0, MICRO_BENCH_COPY_SIZE, &pvSrcBlock);
+    pucDst = prvRegionBuffer(eDst, 1, MICRO_BENCH_COPY_SIZE, &pvDstBlock);
+
+    if (pucSrc != NULL && pucDst != NULL)
+    {
+        if (eSrc != eBenchD2)
+        {
+            memset(pucSrc, 0x5A, MICRO_BENCH_COPY_SIZE);
+        }
+
+        for (i = 0; i < MICRO_BENCH_RUNS; i++)
+        {
+            taskENTER_CRITICAL();
+            /* Both buffers in memory and out of the cache */
+            SCB_CleanInvalidateDCache_by_Addr((uint32_t *) pucSrc, MICRO_BENCH_COPY_SIZE);
+            SCB_CleanInvalidateDCache_by_Addr((uint32_t *) pucDst, MICRO_BENCH_COPY_SIZE);
+            ulStart = DWT->CYCCNT;
+            memcpy(pucDst, pucSrc, MICRO_BENCH_COPY_SIZE);
+            __DSB();
+            ulCycles = DWT->CYCCNT - ulStart;
+            taskEXIT_CRITICAL();
+
+            prvResultAdd(pxResult, ulCycles);
+        }
+    }
+
+    vRegionHeapFree(pvSrcBlock);
+    vRegionHeapFree(pvDstBlock);
+}
+
+static void prvBenchChecksum(UBaseType_t uxVariant, MicroBenchResult_t *pxResult)
+{
+    size_t xLength = (uxVariant & 1u) ? MICRO_BENCH_LONG_SIZE : MICRO_BENCH_SHORT_SIZE;
+    size_t xOffset = (uxVariant & 2u) ? 1u : 0u;
+    volatile uint16_t usSink;
+    void *pvBlock;
+    uint8_t *pucData;
+    uint32_t ulStart;
+    uint32_t ulCycles;
+    UBaseType_t i;
+
+    snprintf(pxResult->cName, sizeof(pxResult->cName), "%s", xOffset ? "unaligned" : "aligned");
+    prvResultStart(pxResult, xLength);
+
+    pucData = prvRegionBuffer(eBenchD1, 0, MICRO_BENCH_LONG_SIZE + 1u, &pvBlock);
+    if (pucData == NULL)
+    {
+        return;
+    }
+    memset(pucData, 0xA5, MICRO_BENCH_LONG_SIZE + 1u);
+
+    for (i = 0; i < MICRO_BENCH_RUNS; i++)
+    {
+        taskENTER_CRITICAL();
+        ulStart = DWT->CYCCNT;
+        usSink = ipCalcChecksum(pucData + xOffset, xLength);
+        ulCycles = DWT->CYCCNT - ulStart;
+        taskEXIT_CRITICAL();
+
+        (void) usSink;
+        prvResultAdd(pxResult, ulCycles);
+    }
+
+    vRegionHeapFree(pvBlock);
+}
+
+static void prvBenchNetBuffer(UBaseType_t uxVariant, MicroBenchResult_t *pxResult)
+{
+    size_t xLength = (uxVariant & 1u) ? ETH_MAX_FRAME_SIZE : MICRO_BENCH_SHORT_SIZE;
+    BaseType_t xFree = (uxVariant & 2u) ? pdTRUE : pdFALSE;
+    NetBuffer *pxBuffer;
+    uint32_t ulStart;
+    uint32_t ulCycles;
+    UBaseType_t i;
+
+    snprintf(pxResult->cName, sizeof(pxResult->cName), "%s", xFree ? "free" : "alloc");
+    prvResultStart(pxResult, xLength);
+
+    for (i = 0; i < MICRO_BENCH_RUNS; i++)
+    {
+        ulStart = DWT->CYCCNT;
+        pxBuffer = netBufferAlloc(xLength);
+        ulCycles = DWT->CYCCNT - ulStart;
+
+        if (pxBuffer == NULL)
+        {
+            /* Pool exhausted by the traffic, the run is not counted */
+            continue;
+        }
+
+        ulStart = DWT->CYCCNT;
+        netBufferFree(pxBuffer);
+        if (xFree)
+        {
+            ulCycles = DWT->CYCCNT - ulStart;
+        }
+
+        prvResultAdd(pxResult, ulCycles);
+    }
+}
+
+static void prvBenchCrc(UBaseType_t uxVariant, MicroBenchResult_t *pxResult)
+{
+    void *pvBlock;
+    uint8_t *pucData;
+    uint32_t ulCrc;
+    uint32_t ulStart;
+    uint32_t ulCycles;
+    BaseType_t xDone;
+    UBaseType_t i;
+
+    (void) uxVariant;
+
+    snprintf(pxResult->cName, sizeof(pxResult->cName), "crc-hw");
+    prvResultStart(pxResult, MICRO_BENCH_LONG_SIZE);
+
+    pucData = prvRegionBuffer(eBenchD1, 0, MICRO_BENCH_LONG_SIZE, &pvBlock);
+    if (pucData == NULL)
+    {
+        return;
+    }
+    memset(pucData, 0xA5, MICRO_BENCH_LONG_SIZE);
+
+    /* The peripheral is shared with the node task */
+    vCyphalNodeLock();
+    for (i = 0; i < MICRO_BENCH_RUNS; i++)
+    {
+        taskENTER_CRITICAL();
+        ulStart = DWT->CYCCNT;
+        xDone = xCyphalCrcAdd(0xFFFFFFFFu, MICRO_BENCH_LONG_SIZE, pucData, &ulCrc);
+        ulCycles = DWT->CYCCNT - ulStart;
+        taskEXIT_CRITICAL();
+
+        /* The peripheral failed its self-test: libudpard uses its own code */
+        if (!xDone)
+        {
+            break;
+        }
+        prvResultAdd(pxResult, ulCycles);
+    }
+    vCyphalNodeUnlock();
+
+    vRegionHeapFree(pvBlock);
+}
+
+static void prvBenchPublish(UBaseType_t uxVariant, MicroBenchResult_t *pxResult)
+{
+    static const UdpardNodeID usNodeId = 1;
+    struct UdpardTx xTx;
+    struct UdpardPayload xPayload;
+    const struct UdpardTxItem *pxItem;
+    CyphalPool_t xPool;
+    void *pvStorage;
+    void *pvBlock;
+    uint8_t *pucData;
+    uint32_t ulStart;
+    uint32_t ulCycles;
+    int32_t lFrames;
+    UBaseType_t i;
+
+    snprintf(pxResult->cName, sizeof(pxResult->cName), "publish");
+    prvResultStart(pxResult, xPublishSizes[uxVariant]);
+
+    /* A queue of its own, on a pool freed after the test */
+    pvStorage = pvRegionHeapAlloc(eRegionHeapD1, MICRO_BENCH_TX_ITEMS * MICRO_BENCH_TX_BLOCK_SIZE);
+    pucData = prvRegionBuffer(eBenchD1, 0, xPublishSizes[uxVariant], &pvBlock);
+    if (pvStorage == NULL || pucData == NULL)
+    {
+        vRegionHeapFree(pvStorage);
+        vRegionHeapFree(pvBlock);
+        return;
+    }
+    memset(pucData, 0xA5, xPublishSizes[uxVariant]);
+
+    vCyphalPoolInit(&xPool, pvStorage, MICRO_BENCH_TX_BLOCK_SIZE, MICRO_BENCH_TX_ITEMS);
+    (void) udpardTxInit(&xTx, &usNodeId, MICRO_BENCH_TX_ITEMS, xCyphalPoolResource(&xPool));
+
+    xPayload.size = xPublishSizes[uxVariant];
+    xPayload.data = pucData;
+
+    /* The CRC goes through the peripheral shared with the node task */
+    vCyphalNodeLock();
+    for (i = 0; i < MICRO_BENCH_RUNS; i++)
+    {
+        ulStart = DWT->CYCCNT;
+        lFrames = udpardTxPublish(&xTx, UINT64_MAX, UdpardPriorityNominal, 100, i, xPayload, NULL);
+        ulCycles = DWT->CYCCNT - ulStart;
+
+        while ((pxItem = udpardTxPeek(&xTx)) != NULL)
+        {
+            udpardTxFree(xTx.memory, udpardTxPop(&xTx, pxItem));
+        }
+
+        if (lFrames < 0)
+        {
+            break;
+        }
+        prvResultAdd(pxResult, ulCycles);
+    }
+    vCyphalNodeUnlock();
+
+    vRegionHeapFree(pvStorage);
+    vRegionHeapFree(pvBlock);
+}
+
+static void prvBenchStream(UBaseType_t uxVariant, MicroBenchResult_t *pxResult)
+{
+    size_t xChunk = xStreamChunks[uxVariant];
+    size_t xMoved;
+    void *pvBlock;
+    uint8_t *pucData;
+    uint32_t ulStart;
+    uint32_t ulCycles;
+    UBaseType_t i;
+
+    snprintf(pxResult->cName, sizeof(pxResult->cName), "chunk-%u", (unsigned int) xChunk);
+    prvResultStart(pxResult, MICRO_BENCH_STREAM_BYTES);
+
+    if (xStream == NULL)
+    {
+        xStream = xAppStreamBufferCreate(xStream, MICRO_BENCH_STREAM_SIZE, 1);
+    }
+
+    pucData = prvRegionBuffer(eBenchD1, 0, 2u * MICRO_BENCH_STREAM_SIZE, &pvBlock);
+    if (xStream == NULL || pucData == NULL)
+    {
+        vRegionHeapFree(pvBlock);
+        return;
+    }
+    memset(pucData, 0xA5, MICRO_BENCH_STREAM_SIZE);
+
+    /* Written then read back by the same task: the copies and the API */
+    for (i = 0; i < MICRO_BENCH_RUNS; i++)
+    {
+        ulStart = DWT->CYCCNT;
+        for (xMoved = 0; xMoved < MICRO_BENCH_STREAM_BYTES; xMoved += xChunk)
+        {
+            (void) xStreamBufferSend(xStream, pucData, xChunk, 0);
+            (void) xStreamBufferReceive(xStream, pucData + MICRO_BENCH_STREAM_SIZE, xChunk, 0);
+        }
+        ulCycles = DWT->CYCCNT - ulStart;
+
+        prvResultAdd(pxResult, ulCycles);
+    }
+
+    (void) xStreamBufferReset(xStream);
+    vRegionHeapFree(pvBlock);
+}
+
+static void prvHelperTask(void *pvParameters)
+{
+    (void) pvParameters;
+
+    for (;;)
+    {
+        (void) xSemaphoreTake(xPing, portMAX_DELAY);
+        ulHelperWoken = DWT->CYCCNT;
+        (void) xSemaphoreGive(xPong);
+    }
+}
+
+static void prvBenchScheduler(UBaseType_t uxVariant, MicroBenchResult_t *pxResult)
+{
+    UBaseType_t uxPriority = uxTaskPriorityGet(NULL) + 1u;
+    uint32_t ulStart;
+    uint32_t ulCycles;
+    UBaseType_t i;
+
+    snprintf(pxResult->cName, sizeof(pxResult->cName), "%s", (uxVariant == 0) ? "switch" : "sem-rtt");
+    prvResultStart(pxResult, 0);
+
+    if (uxPriority > configMAX_PRIORITIES - 1u)
+    {
+        /* The helper would not preempt the caller */
+        return;
+    }
+
+    if (xHelperTask == NULL)
+    {
+        xPing = xAppSemaphoreCreateBinary(xPing);
+        xPong = xAppSemaphoreCreateBinary(xPong);
+        if (xPing == NULL || xPong == NULL ||
+            xAppTaskCreate(xHelperTask, prvHelperTask, "bench", MICRO_BENCH_HELPER_STACK_SIZE, NULL,
+                           uxPriority, &xHelperTask) != pdPASS)
+        {
+            return;
+        }
+    }
+
+    /* The commands may run in tasks of different priorities */
+    vTaskPrioritySet(xHelperTask, uxPriority);
+
+    for (i = 0; i < MICRO_BENCH_RUNS; i++)
+    {
+        ulStart = DWT->CYCCNT;
+        (void) xSemaphoreGive(xPing);
+        (void) xSemaphoreTake(xPong, portMAX_DELAY);
+        ulCycles = ((uxVariant == 0) ? ulHelperWoken : DWT->CYCCNT) - ulStart;
+
+        prvResultAdd(pxResult, ulCycles);
+    }
+}
+
+/* A status document of MICRO_BENCH_TELEMETRY_GROUPS maps of ten fields */
+static void prvTelemetryDocument(TelemetryEncoder_t *pxEnc, uint32_t ulSeed)
+{
+    static const char * const pcGroups[] =
+    {
+        "eth", "ip", "udp", "tcp", "icmp", "arp", "dhcp", "dns", "ptp", "sntp",
+        "cyphal", "modbus", "mqtt", "coap", "http", "ppp", "adc", "heap", "cpu", "power"
+    };
+    uint32_t ulValue = ulSeed;
+    UBaseType_t i;
+
+    vTelemetryBeginMap(pxEnc, TELEMETRY_INDEFINITE);
+    for (i = 0; i < MICRO_BENCH_TELEMETRY_GROUPS; i++)
+    {
+        ulValue = ulValue * 1664525u + 1013904223u;
+        vTelemetryKey(pxEnc, pcGroups[i % MICRO_BENCH_COUNT(pcGroups)]);
+        vTelemetryBeginMap(pxEnc, 10u);
+        vTelemetryFieldUint(pxEnc, "rx_frames", ulValue);
+        vTelemetryFieldUint(pxEnc, "tx_frames", ulValue >> 3);
+        vTelemetryFieldUint(pxEnc, "rx_bytes", (uint64_t) ulValue * 1500u);
+        vTelemetryFieldUint(pxEnc, "tx_bytes", (uint64_t) (ulValue >> 3) * 1500u);
+        vTelemetryFieldUint(pxEnc, "errors", ulValue & 0xFFu);
+        vTelemetryFieldUint(pxEnc, "drops", ulValue & 0x7u);
+        vTelemetryFieldInt(pxEnc, "offset_ns", (int32_t) ulValue >> 12);
+        vTelemetryFieldDecimal(pxEnc, "load", ulValue % 1000u, 1u);
+        vTelemetryFieldBool(pxEnc, "up", (ulValue & 1u) ? pdTRUE : pdFALSE);
+        vTelemetryFieldString(pxEnc, "state", (ulValue & 2u) ? "running" : "idle");
+        vTelemetryEnd(pxEnc);
+    }
+    vTelemetryEnd(pxEnc);
+}
+
+static void prvBenchTelemetry(UBaseType_t uxVariant, MicroBenchResult_t *pxResult)
+{
+    TelemetryEncoder_t xEnc;
+    void *pvBlock;
+    uint8_t *pucData;
+    uint32_t ulStart;
+    uint32_t ulCycles;
+    BaseType_t xDone;
+    UBaseType_t i;
+
+    snprintf(pxResult->cName, sizeof(pxResult->cName), "%s-%u", (uxVariant == 0) ? "cbor" : "json",
+             (unsigned int) (MICRO_BENCH_TELEMETRY_GROUPS * 10u));
+    prvResultStart(pxResult, 0);
+
+    pucData = prvRegionBuffer(eBenchD1, 0, MICRO_BENCH_TELEMETRY_SIZE, &pvBlock);
+    if (pucData == NULL)
+    {
+        return;
+    }
+
+    /* Into one buffer, as for a datagram or a publish */
+    for (i = 0; i < MICRO_BENCH_RUNS; i++)
+    {
+        ulStart = DWT->CYCCNT;
+        vTelemetryInit(&xEnc, (uxVariant == 0) ? eTelemetryCbor : eTelemetryJson, pucData,
+                       MICRO_BENCH_TELEMETRY_SIZE, NULL, NULL);
+        prvTelemetryDocument(&xEnc, i);
+        xDone = xTelemetryFinish(&xEnc);
+        ulCycles = DWT->CYCCNT - ulStart;
+
+        if (xDone != pdPASS)
+        {
+            break;
+        }
+        pxResult->ulBytes = (uint32_t) xTelemetryLength(&xEnc);
+        prvResultAdd(pxResult, ulCycles);
+    }
+
+    vRegionHeapFree(pvBlock);
+}
+
+static BaseType_t prvBenchCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xBench =
+{
+    "bench",
+    "\r\nbench [memcpy|checksum|netbuf|udpard|stream|sched]:\r\n Micro-benchmarks in DWT cycles, as CSV\r\n",
+    prvBenchCommand,
+    -1
+};
+
+/* Report state: the group selected, then the next test and variant */
+static char cBenchGroup[12];
+static UBaseType_t uxBenchLine = 0;
+static UBaseType_t uxBenchTest;
+static UBaseType_t uxBenchVariant;
+
+/* First test of the selected group from uxBenchTest on */
+static BaseType_t prvNextTest(void)
+{
+    while (uxBenchTest < MICRO_BENCH_COUNT(xTests))
+    {
+        if (cBenchGroup[0] == '\0' || strcmp(cBenchGroup, xTests[uxBenchTest].pcGroup) == 0)
+        {
+            return pdTRUE;
+        }
+        uxBenchTest++;
+    }
+
+    return pdFALSE;
+}
+
+static BaseType_t prvBenchCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    const char *pcParameter;
+    BaseType_t xParameterLength;
+    MicroBenchResult_t xResult;
+    const MicroBenchTest_t *pxTest;
+    uint32_t ulAvg;
+    uint32_t ulNs;
+    uint32_t ulMBps;
+
+    if (uxBenchLine == 0)
+    {
+        cBenchGroup[0] = '\0';
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterLength);
+        if (pcParameter != NULL)
+        {
+            snprintf(cBenchGroup, sizeof(cBenchGroup), "%.*s", (int) xParameterLength, pcParameter);
+        }
+
+        uxBenchTest = 0;
+        uxBenchVariant = 0;
+        if (!prvNextTest())
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: bench [memcpy|checksum|netbuf|udpard|stream|sched]\r\n");
+            return pdFALSE;
+        }
+
+        snprintf(pcWriteBuffer, xWriteBufferLen, "\r\n# cpu_hz=%lu rev=0x%04lx dev=0x%03lx tcm=%u static=%u icache=%u dcache=%u\r\n",
+                 (unsigned long) SystemCoreClock, (unsigned long) (DBGMCU->IDCODE >> 16),
+                 (unsigned long) (DBGMCU->IDCODE & 0xFFFu), (unsigned int) TCM_PLACEMENT,
+                 (unsigned int) APP_STATIC_ALLOCATION, (SCB->CCR & SCB_CCR_IC_Msk) ? 1u : 0u,
+                 (SCB->CCR & SCB_CCR_DC_Msk) ? 1u : 0u);
+        uxBenchLine = 1;
+        return pdTRUE;
+    }
+
+    if (uxBenchLine == 1)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "# bench,group,test,bytes,runs,min,avg,max,min_ns,mbps\r\n");
+        uxBenchLine = 2;
+        return pdTRUE;
+    }
+
+    pxTest = &xTests[uxBenchTest];
+    pxTest->pxRun(uxBenchVariant, &xResult);
+
+    if (xResult.ulRuns == 0)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "bench,%s,%s,%lu,0,,,,,\r\n", pxTest->pcGroup, xResult.cName,
+                 (unsigned long) xResult.ulBytes);
+    }
+    else
+    {
+        ulAvg = (uint32_t) (xResult.ullSum / xResult.ulRuns);
+        ulNs = (uint32_t) (((uint64_t) xResult.ulMin * 1000000000u) / SystemCoreClock);
+        ulMBps = (xResult.ulMin == 0) ? 0u :
+                 (uint32_t) (((uint64_t) xResult.ulBytes * SystemCoreClock) / xResult.ulMin / 1000000u);
+        snprintf(pcWriteBuffer, xWriteBufferLen, "bench,%s,%s,%lu,%lu,%lu,%lu,%lu,%lu,%lu\r\n", pxTest->pcGroup,
+                 xResult.cName, (unsigned long) xResult.ulBytes, (unsigned long) xResult.ulRuns,
+                 (unsigned long) xResult.ulMin, (unsigned long) ulAvg, (unsigned long) xResult.ulMax,
+                 (unsigned long) ulNs, (unsigned long) ulMBps);
+    }
+
+    /* Next variant, or first variant of the next test of the group */
+    if (++uxBenchVariant >= pxTest->uxVariants)
+    {
+        uxBenchVariant = 0;
+        uxBenchTest++;
+        if (!prvNextTest())
+        {
+            uxBenchLine = 0;
+            return pdFALSE;
+        }
+    }
+
+    return pdTRUE;
+}
+
+void vMicroBenchRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xBench);
+}
@@ -0,0 +1,1403 @@
+/* ModbusClient.c
+ *
+ * Poll scheduling, connections and transaction matching of the Modbus/TCP
+ * client (see ModbusClient.h). Devices and polls are declared under the
+ * configuration mutex; the client task merges them into requests, and owns
+ * the requests, connections and counters.
+ */
+#include "ModbusClient.h"
+#include "ModbusTcp.h"
+#include "StaticAlloc.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "FreeRTOS_CLI.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Requests of one connection gathered before a send: the reads of a full
+   pipeline, or a write */
+#define MODBUS_CLIENT_TX_SIZE          (MODBUS_CLIENT_MAX_OUTSTANDING * 12u + MODBUS_MAX_ADU_SIZE)
+
+/* Values printed by "modbusc read" */
+#define MODBUS_CLIENT_CLI_COUNT        16u
+
+#define MODBUS_NO_REQUEST              (-1)
+
+typedef struct
+{
+    IpAddr xAddr;
+    uint16_t usPort;
+    uint8_t ucUnitId;
+    uint8_t ucPipeline;
+    uint8_t ucInFlight;
+    uint8_t ucTimeouts;             /* Consecutive */
+    BaseType_t xBackoff;            /* Offline or unreachable until xRetryAt */
+    systime_t xRetryAt;
+    ModbusClientStats_t xStats;
+} ModbusDevice_t;
+
+typedef struct
+{
+    uint8_t ucDevice;
+    uint8_t ucTable;
+    uint16_t usAddress;
+    uint16_t usCount;
+    uint32_t ulPeriodMs;
+    void *pvDest;
+    ModbusPollCallback_t pxCallback;
+    void *pvContext;
+} ModbusPoll_t;
+
+/* Polls merged into one read: ucPolls entries of ucOrder from ucFirst */
+typedef struct
+{
+    uint8_t ucDevice;
+    uint8_t ucTable;
+    uint16_t usAddress;
+    uint16_t usCount;
+    uint8_t ucFirst;
+    uint8_t ucPolls;
+    BaseType_t xOutstanding;
+    uint32_t ulPeriodMs;
+    systime_t xDue;
+} ModbusRequest_t;
+
+/* Single read or write, on the stack of the caller until it completes */
+typedef struct
+{
+    uint8_t ucDevice;
+    uint8_t ucFunction;
+    uint16_t usAddress;
+    uint16_t usCount;
+    void *pvData;                   /* Destination of a read, values of a write */
+    TaskHandle_t xWaiter;
+    systime_t xDeadline;            /* Given up if not sent by then */
+    uint32_t ulStatus;
+} ModbusTransfer_t;
+
+typedef struct
+{
+    uint16_t usTid;
+    uint8_t ucDevice;
+    uint8_t ucFunction;
+    uint16_t usAddress;
+    uint16_t usCount;
+    int16_t sRequest;               /* MODBUS_NO_REQUEST for a transfer, or a request since recompiled */
+    ModbusTransfer_t *pxTransfer;
+    systime_t xSent;
+} ModbusOutstanding_t;
+
+typedef struct
+{
+    Socket *pxSocket;               /* NULL for a free entry */
+    BaseType_t xConnected;          /* pdFALSE while the handshake is in progress */
+    IpAddr xAddr;
+    uint16_t usPort;
+    systime_t xOpened;
+    systime_t xLastActivity;
+    uint16_t usNextTid;
+    UBaseType_t uxOutstanding;
+    ModbusOutstanding_t xOutstanding[MODBUS_CLIENT_MAX_OUTSTANDING];
+    size_t xRxUsed;
+    uint8_t ucRx[2u * MODBUS_MAX_ADU_SIZE];
+} ModbusClientConnection_t;
+
+static const uint8_t ucReadFunctions[4] =
+{
+    MODBUS_FUNCTION_READ_COILS,
+    MODBUS_FUNCTION_READ_DISCRETE_INPUTS,
+    MODBUS_FUNCTION_READ_HOLDING_REGS,
+    MODBUS_FUNCTION_READ_INPUT_REGS
+};
+
+static const char *const pcTableNames[4] = { "co", "di", "hr", "ir" };
+
+/* Declared under xConfigMutex; entries below the counts never change */
+static ModbusDevice_t xDevices[MODBUS_CLIENT_MAX_DEVICES];
+static ModbusPoll_t xPolls[MODBUS_CLIENT_MAX_POLLS];
+static UBaseType_t uxDevices = 0;
+static UBaseType_t uxPolls = 0;
+static volatile BaseType_t xConfigDirty = pdFALSE;
+static SemaphoreHandle_t xConfigMutex = NULL;
+
+static QueueHandle_t xTransferQueue = NULL;
+static OsEvent xClientEvent;
+
+/* Owned by the client task */
+static UBaseType_t uxTaskDevices = 0;
+static uint8_t ucOrder[MODBUS_CLIENT_MAX_POLLS];
+static ModbusRequest_t xRequests[MODBUS_CLIENT_MAX_REQUESTS];
+static UBaseType_t uxRequests = 0;
+static ModbusTransfer_t *pxTransfers[MODBUS_CLIENT_MAX_TRANSFERS];
+static ModbusClientConnection_t xConnections[MODBUS_CLIENT_MAX_CONNECTIONS];
+static int8_t cDeviceConnection[MODBUS_CLIENT_MAX_DEVICES];
+static uint8_t ucTx[MODBUS_CLIENT_TX_SIZE];
+static size_t xTxUsed = 0;
+static systime_t xNextWake;
+static uint32_t ulConnects = 0;
+static uint32_t ulConnectFailures = 0;
+static uint32_t ulEvictions = 0;
+static uint32_t ulStale = 0;
+static uint32_t ulFramingErrors = 0;
+
+APP_TASK_STORAGE(xModbusClientTask, MODBUS_CLIENT_TASK_STACK_SIZE);
+APP_QUEUE_STORAGE(xTransferQueue, MODBUS_CLIENT_MAX_TRANSFERS, sizeof(ModbusTransfer_t *));
+APP_MUTEX_STORAGE(xConfigMutex);
+
+static BaseType_t prvModbusClientCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xModbusClient =
+{
+    "modbusc",
+    "\r\nmodbusc [add <ip> [<port> [<unit>]] | poll | read | write | coil]:\r\n"
+    " Modbus/TCP client devices, polls, reads, writes\r\n",
+    prvModbusClientCommand,
+    -1
+};
+
+static uint16_t prvMaxRead(uint8_t ucTable)
+{
+    return (ucTable < (uint8_t) eModbusHoldingRegs) ? MODBUS_MAX_READ_BITS : MODBUS_MAX_READ_REGS;
+}
+
+/* Order of the merge: device, table, period, then address */
+static BaseType_t prvPollBefore(const ModbusPoll_t *pxA, const ModbusPoll_t *pxB)
+{
+    if (pxA->ucDevice != pxB->ucDevice)
+    {
+        return (pxA->ucDevice < pxB->ucDevice) ? pdTRUE : pdFALSE;
+    }
+    if (pxA->ucTable != pxB->ucTable)
+    {
+        return (pxA->ucTable < pxB->ucTable) ? pdTRUE : pdFALSE;
+    }
+    if (pxA->ulPeriodMs != pxB->ulPeriodMs)
+    {
+        return (pxA->ulPeriodMs < pxB->ulPeriodMs) ? pdTRUE : pdFALSE;
+    }
+    return (pxA->usAddress < pxB->usAddress) ? pdTRUE : pdFALSE;
+}
+
+/* Merge the polls into requests, and spread their due times */
+static void prvCompile(void)
+{
+    const ModbusPoll_t *pxPoll;
+    ModbusRequest_t *pxRequest = NULL;
+    UBaseType_t uxPollCount;
+    uint32_t ulEnd;
+    uint32_t ulPollEnd;
+    systime_t xNow;
+    UBaseType_t i;
+    UBaseType_t j;
+    uint8_t ucIndex;
+
+    xSemaphoreTake(xConfigMutex, portMAX_DELAY);
+    xConfigDirty = pdFALSE;
+    uxTaskDevices = uxDevices;
+    uxPollCount = uxPolls;
+    xSemaphoreGive(xConfigMutex);
+
+    /* Insertion sort: the table is small and mostly sorted already */
+    for (i = 0; i < uxPollCount; i++)
+    {
+        ucIndex = (uint8_t) i;
+        for (j = i; j > 0 && prvPollBefore(&xPolls[ucIndex], &xPolls[ucOrder[j - 1u]]) != pdFALSE; j--)
+        {
+            ucOrder[j] = ucOrder[j - 1u];
+        }
+        ucOrder[j] = ucIndex;
+    }
+
+    uxRequests = 0;
+    for (i = 0; i < uxPollCount; i++)
+    {
+        pxPoll = &xPolls[ucOrder[i]];
+        ulPollEnd = (uint32_t) pxPoll->usAddress + pxPoll->usCount;
+
+        if (pxRequest != NULL && pxRequest->ucDevice == pxPoll->ucDevice && pxRequest->ucTable == pxPoll->ucTable &&
+            pxRequest->ulPeriodMs == pxPoll->ulPeriodMs)
+        {
+            /* Close enough, and the merged read not too long */
+            ulEnd = (uint32_t) pxRequest->usAddress + pxRequest->usCount;
+            if (pxPoll->usAddress <= ulEnd + MODBUS_CLIENT_MAX_GAP &&
+                MAX(ulEnd, ulPollEnd) - pxRequest->usAddress <= prvMaxRead(pxRequest->ucTable))
+            {
+                pxRequest->usCount = (uint16_t) (MAX(ulEnd, ulPollEnd) - pxRequest->usAddress);
+                pxRequest->ucPolls++;
+                continue;
+            }
+        }
+
+        pxRequest = &xRequests[uxRequests++];
+        pxRequest->ucDevice = pxPoll->ucDevice;
+        pxRequest->ucTable = pxPoll->ucTable;
+        pxRequest->usAddress = pxPoll->usAddress;
+        pxRequest->usCount = pxPoll->usCount;
+        pxRequest->ucFirst = (uint8_t) i;
+        pxRequest->ucPolls = 1;
+        pxRequest->xOutstanding = pdFALSE;
+        pxRequest->ulPeriodMs = pxPoll->ulPeriodMs;
+    }
+
+    /* Responses to the previous requests are counted, not delivered */
+    for (i = 0; i < MODBUS_CLIENT_MAX_CONNECTIONS; i++)
+    {
+        for (j = 0; j < xConnections[i].uxOutstanding; j++)
+        {
+            xConnections[i].xOutstanding[j].sRequest = MODBUS_NO_REQUEST;
+        }
+    }
+
+    /* Request i starts i/n of its period from now */
+    xNow = osGetSystemTime();
+    for (i = 0; i < uxRequests; i++)
+    {
+        xRequests[i].xDue = xNow + (systime_t) (((uint64_t) i * xRequests[i].ulPeriodMs) / uxRequests);
+    }
+}
+
+static void prvWakeAt(systime_t xTime)
+{
+    if (timeCompare(xTime, xNextWake) < 0)
+    {
+        xNextWake = xTime;
+    }
+}
+
+/* Unpack usCount values from usOffset of the data of a read response */
+static void prvCopyValues(void *pvDest, uint8_t ucTable, const uint8_t *pucData, uint16_t usOffset, uint16_t usCount)
+{
+    uint16_t *pusRegs = (uint16_t *) pvDest;
+    uint8_t *pucBits = (uint8_t *) pvDest;
+    uint32_t ulBit;
+    uint16_t i;
+
+    if (ucTable >= (uint8_t) eModbusHoldingRegs)
+    {
+        for (i = 0; i < usCount; i++)
+        {
+            pusRegs[i] = MODBUS_READ16(&pucData[2u * (usOffset + i)]);
+        }
+        return;
+    }
+
+    memset(pucBits, 0, (usCount + 7u) / 8u);
+    for (i = 0; i < usCount; i++)
+    {
+        ulBit = (uint32_t) usOffset + i;
+        if (((pucData[ulBit / 8u] >> (ulBit % 8u)) & 1u) != 0)
+        {
+            pucBits[i / 8u] |= (uint8_t) (1u << (i % 8u));
+        }
+    }
+}
+
+static void prvFinishTransfer(ModbusTransfer_t *pxTransfer, uint32_t ulStatus)
+{
+    pxTransfer->ulStatus = ulStatus;
+    xTaskNotifyGive(pxTransfer->xWaiter);
+}
+
+/* Hand the result of a read to the polls merged into it */
+static void prvDeliver(const ModbusRequest_t *pxRequest, uint32_t ulStatus, const uint8_t *pucData)
+{
+    const ModbusPoll_t *pxPoll;
+    uint8_t i;
+
+    for (i = 0; i < pxRequest->ucPolls; i++)
+    {
+        pxPoll = &xPolls[ucOrder[pxRequest->ucFirst + i]];
+        if (ulStatus == MODBUS_CLIENT_OK && pxPoll->pvDest != NULL)
+        {
+            prvCopyValues(pxPoll->pvDest, pxRequest->ucTable, pucData,
+                          (uint16_t) (pxPoll->usAddress - pxRequest->usAddress), pxPoll->usCount);
+        }
+        if (pxPoll->pxCallback != NULL)
+        {
+            pxPoll->pxCallback(pxPoll->pvContext, ulStatus);
+        }
+    }
+}
+
+/* Complete and remove outstanding entry i; pucData is the data of a read */
+static void prvComplete(ModbusClientConnection_t *pxConnection, UBaseType_t i, uint32_t ulStatus,
+                        const uint8_t *pucData)
+{
+    ModbusOutstanding_t xEntry = pxConnection->xOutstanding[i];
+    ModbusTransfer_t *pxTransfer = xEntry.pxTransfer;
+    ModbusRequest_t *pxRequest = NULL;
+
+    /* Order does not matter, the transaction identifier does */
+    pxConnection->xOutstanding[i] = pxConnection->xOutstanding[--pxConnection->uxOutstanding];
+    xDevices[xEntry.ucDevice].ucInFlight--;
+
+    if (pxTransfer != NULL)
+    {
+        if (ulStatus == MODBUS_CLIENT_OK && xEntry.ucFunction <= MODBUS_FUNCTION_READ_INPUT_REGS &&
+            pxTransfer->pvData != NULL)
+        {
+            prvCopyValues(pxTransfer->pvData, (uint8_t) (xEntry.ucFunction - 1u), pucData, 0, xEntry.usCount);
+        }
+        prvFinishTransfer(pxTransfer, ulStatus);
+    }
+    else if (xEntry.sRequest != MODBUS_NO_REQUEST)
+    {
+        pxRequest = &xRequests[xEntry.sRequest];
+        pxRequest->xOutstanding = pdFALSE;
+        prvDeliver(pxRequest, ulStatus, pucData);
+    }
+}
+
+/* Keep the device from being polled for a while */
+static void prvBackoff(ModbusDevice_t *pxDevice)
+{
+    pxDevice->xBackoff = pdTRUE;
+    pxDevice->xRetryAt = osGetSystemTime() + MODBUS_CLIENT_RETRY_MS;
+}
+
+static BaseType_t prvReachable(ModbusDevice_t *pxDevice, systime_t xNow)
+{
+    if (pxDevice->xBackoff != pdFALSE && timeCompare(xNow, pxDevice->xRetryAt) >= 0)
+    {
+        pxDevice->xBackoff = pdFALSE;
+        pxDevice->ucTimeouts = 0;
+    }
+
+    return (pxDevice->xBackoff == pdFALSE) ? pdTRUE : pdFALSE;
+}
+
+static void prvClose(ModbusClientConnection_t *pxConnection)
+{
+    while (pxConnection->uxOutstanding > 0)
+    {
+        prvComplete(pxConnection, pxConnection->uxOutstanding - 1u, MODBUS_CLIENT_NO_CONNECTION, NULL);
+    }
+
+    socketClose(pxConnection->pxSocket);
+    pxConnection->pxSocket = NULL;
+}
+
+/* The endpoint of the connection cannot be reached: all its devices wait */
+static void prvConnectFailed(ModbusClientConnection_t *pxConnection)
+{
+    UBaseType_t i;
+
+    for (i = 0; i < uxTaskDevices; i++)
+    {
+        if (xDevices[i].usPort == pxConnection->usPort && ipCompAddr(&xDevices[i].xAddr, &pxConnection->xAddr))
+        {
+            prvBackoff(&xDevices[i]);
+        }
+    }
+
+    prvClose(pxConnection);
+    ulConnectFailures++;
+}
+
+static void prvConnected(ModbusClientConnection_t *pxConnection)
+{
+    /* Sends may block from now on, but not for long */
+    socketSetTimeout(pxConnection->pxSocket, MODBUS_CLIENT_SEND_TIMEOUT_MS);
+    pxConnection->xConnected = pdTRUE;
+    pxConnection->xLastActivity = osGetSystemTime();
+    ulConnects++;
+}
+
+/* Start a connection to the endpoint of the device, replacing the one idle
+   for longest when the table is full */
+static void prvOpen(const ModbusDevice_t *pxDevice)
+{
+    ModbusClientConnection_t *pxConnection = NULL;
+    Socket *pxSocket;
+    error_t err;
+    UBaseType_t i;
+
+    for (i = 0; i < MODBUS_CLIENT_MAX_CONNECTIONS; i++)
+    {
+        if (xConnections[i].pxSocket == NULL)
+        {
+            pxConnection = &xConnections[i];
+            break;
+        }
+        if (xConnections[i].xConnected != pdFALSE && xConnections[i].uxOutstanding == 0 &&
+            (pxConnection == NULL || timeCompare(xConnections[i].xLastActivity, pxConnection->xLastActivity) < 0))
+        {
+            pxConnection = &xConnections[i];
+        }
+    }
+
+    if (pxConnection == NULL)
+    {
+        /* Every connection is busy: wait for a response */
+        return;
+    }
+
+    if (pxConnection->pxSocket != NULL)
+    {
+        prvClose(pxConnection);
+        ulEvictions++;
+    }
+
+    pxSocket = socketOpen(SOCKET_TYPE_STREAM, SOCKET_IP_PROTO_TCP);
+    if (pxSocket == NULL)
+    {
+        return;
+    }
+
+    pxConnection->pxSocket = pxSocket;
+    pxConnection->xConnected = pdFALSE;
+    pxConnection->xAddr = pxDevice->xAddr;
+    pxConnection->usPort = pxDevice->usPort;
+    pxConnection->xOpened = osGetSystemTime();
+    pxConnection->xLastActivity = pxConnection->xOpened;
+    pxConnection->uxOutstanding = 0;
+    pxConnection->xRxUsed = 0;
+
+    /* With no timeout the SYN is sent and the call returns: the handshake
+       completes while the other devices are polled */
+    socketSetTimeout(pxSocket, 0);
+    err = socketConnect(pxSocket, &pxDevice->xAddr, pxDevice->usPort);
+    if (err == NO_ERROR)
+    {
+        prvConnected(pxConnection);
+    }
+    else if (err != ERROR_TIMEOUT)
+    {
+        prvConnectFailed(pxConnection);
+    }
+}
+
+/* Connection serving each device, or -1 */
+static void prvMapDevices(void)
+{
+    UBaseType_t i;
+    UBaseType_t j;
+
+    for (i = 0; i < uxTaskDevices; i++)
+    {
+        cDeviceConnection[i] = -1;
+        for (j = 0; j < MODBUS_CLIENT_MAX_CONNECTIONS; j++)
+        {
+            if (xConnections[j].pxSocket != NULL && xConnections[j].usPort == xDevices[i].usPort &&
+                ipCompAddr(&xConnections[j].xAddr, &xDevices[i].xAddr))
+            {
+                cDeviceConnection[i] = (int8_t) j;
+                break;
+            }
+        }
+    }
+}
+
+static void prvFlush(ModbusClientConnection_t *pxConnection)
+{
+    if (xTxUsed == 0)
+    {
+        return;
+    }
+
+    /* One segment for the whole pipeline */
+    if (socketSend(pxConnection->pxSocket, ucTx, xTxUsed, NULL, SOCKET_FLAG_NO_DELAY) != NO_ERROR)
+    {
+        xTxUsed = 0;
+        prvClose(pxConnection);
+        return;
+    }
+
+    xTxUsed = 0;
+}
+
+/* Frame a request into the send buffer and record it as outstanding */
+static BaseType_t prvQueueRequest(ModbusClientConnection_t *pxConnection, uint8_t ucDevice, uint8_t ucFunction,
+                                  uint16_t usAddress, uint16_t usCount, const void *pvValues,
+                                  int16_t sRequest, ModbusTransfer_t *pxTransfer)
+{
+    ModbusDevice_t *pxDevice = &xDevices[ucDevice];
+    ModbusOutstanding_t *pxEntry;
+    const uint16_t *pusValues = (const uint16_t *) pvValues;
+    uint8_t *pucFrame;
+    size_t xPduLength;
+    uint16_t usTid;
+    uint16_t i;
+
+    xPduLength = (ucFunction == MODBUS_FUNCTION_WRITE_MULTIPLE_REGS) ? 6u + 2u * usCount : 5u;
+    if (xTxUsed + MODBUS_MBAP_SIZE + xPduLength > sizeof(ucTx))
+    {
+        prvFlush(pxConnection);
+        if (pxConnection->pxSocket == NULL)
+        {
+            return pdFALSE;
+        }
+    }
+
+    usTid = pxConnection->usNextTid++;
+    pucFrame = &ucTx[xTxUsed];
+    vModbusTcpWriteMbap(pucFrame, usTid, pxDevice->ucUnitId, xPduLength);
+    pucFrame[7] = ucFunction;
+    pucFrame[8] = (uint8_t) (usAddress >> 8);
+    pucFrame[9] = (uint8_t) (usAddress & 0xFFu);
+
+    if (ucFunction == MODBUS_FUNCTION_WRITE_SINGLE_COIL || ucFunction == MODBUS_FUNCTION_WRITE_SINGLE_REG)
+    {
+        /* Coil or register value */
+        pucFrame[10] = (uint8_t) (pusValues[0] >> 8);
+        pucFrame[11] = (uint8_t) (pusValues[0] & 0xFFu);
+    }
+    else
+    {
+        pucFrame[10] = (uint8_t) (usCount >> 8);
+        pucFrame[11] = (uint8_t) (usCount & 0xFFu);
+    }
+
+    if (ucFunction == MODBUS_FUNCTION_WRITE_MULTIPLE_REGS)
+    {
+        pucFrame[12] = (uint8_t) (2u * usCount);
+        for (i = 0; i < usCount; i++)
+        {
+            pucFrame[13u + 2u * i] = (uint8_t) (pusValues[i] >> 8);
+            pucFrame[14u + 2u * i] = (uint8_t) (pusValues[i] & 0xFFu);
+        }
+    }
+
+    xTxUsed += MODBUS_MBAP_SIZE + xPduLength;
+
+    pxEntry = &pxConnection->xOutstanding[pxConnection->uxOutstanding++];
+    pxEntry->usTid = usTid;
+    pxEntry->ucDevice = ucDevice;
+    pxEntry->ucFunction = ucFunction;
+    pxEntry->usAddress = usAddress;
+    pxEntry->usCount = usCount;
+    pxEntry->sRequest = sRequest;
+    pxEntry->pxTransfer = pxTransfer;
+    pxEntry->xSent = osGetSystemTime();
+
+    pxDevice->ucInFlight++;
+    pxDevice->xStats.ulRequests++;
+    prvWakeAt(pxEntry->xSent + MODBUS_CLIENT_TIMEOUT_MS);
+
+    return pdTRUE;
+}
+
+static BaseType_t prvHasRoom(const ModbusClientConnection_t *pxConnection, const ModbusDevice_t *pxDevice)
+{
+    return (pxConnection->uxOutstanding < MODBUS_CLIENT_MAX_OUTSTANDING &&
+            pxDevice->ucInFlight < pxDevice->ucPipeline) ? pdTRUE : pdFALSE;
+}
+
+/* Send what is due on an open connection: transfers first, then polls */
+static void prvSendDue(ModbusClientConnection_t *pxConnection, int8_t cConnection, systime_t xNow)
+{
+    ModbusRequest_t *pxRequest;
+    ModbusTransfer_t *pxTransfer;
+    ModbusDevice_t *pxDevice;
+    UBaseType_t i;
+
+    xTxUsed = 0;
+
+    for (i = 0; i < MODBUS_CLIENT_MAX_TRANSFERS && pxConnection->pxSocket != NULL; i++)
+    {
+        pxTransfer = pxTransfers[i];
+        if (pxTransfer == NULL || cDeviceConnection[pxTransfer->ucDevice] != cConnection ||
+            prvHasRoom(pxConnection, &xDevices[pxTransfer->ucDevice]) == pdFALSE)
+        {
+            continue;
+        }
+
+        if (prvQueueRequest(pxConnection, pxTransfer->ucDevice, pxTransfer->ucFunction, pxTransfer->usAddress,
+                            pxTransfer->usCount, pxTransfer->pvData, MODBUS_NO_REQUEST, pxTransfer) != pdFALSE)
+        {
+            pxTransfers[i] = NULL;
+        }
+    }
+
+    for (i = 0; i < uxRequests && pxConnection->pxSocket != NULL; i++)
+    {
+        pxRequest = &xRequests[i];
+        pxDevice = &xDevices[pxRequest->ucDevice];
+        if (cDeviceConnection[pxRequest->ucDevice] != cConnection || pxRequest->xOutstanding != pdFALSE ||
+            pxDevice->xBackoff != pdFALSE ||
+            timeCompare(xNow, pxRequest->xDue) < 0 || prvHasRoom(pxConnection, pxDevice) == pdFALSE)
+        {
+            continue;
+        }
+
+        if (prvQueueRequest(pxConnection, pxRequest->ucDevice, ucReadFunctions[pxRequest->ucTable],
+                            pxRequest->usAddress, pxRequest->usCount, NULL, (int16_t) i, NULL) != pdFALSE)
+        {
+            pxRequest->xOutstanding = pdTRUE;
+            pxRequest->xDue += pxRequest->ulPeriodMs;
+            if (timeCompare(pxRequest->xDue, xNow) <= 0)
+            {
+                /* Fell behind: do not catch up with a burst */
+                pxRequest->xDue = xNow + pxRequest->ulPeriodMs;
+            }
+        }
+    }
+
+    if (pxConnection->pxSocket != NULL)
+    {
+        prvFlush(pxConnection);
+    }
+}
+
+/* Fail the transfers and polls of unreachable devices, send what is due on
+   the open connections, then open the connections the others need: a
+   connection just established sends before it can be chosen for eviction */
+static void prvSchedule(void)
+{
+    systime_t xNow = osGetSystemTime();
+    ModbusRequest_t *pxRequest;
+    ModbusTransfer_t *pxTransfer;
+    ModbusDevice_t *pxDevice;
+    UBaseType_t i;
+
+    prvMapDevices();
+
+    for (i = 0; i < MODBUS_CLIENT_MAX_TRANSFERS; i++)
+    {
+        pxTransfer = pxTransfers[i];
+        if (pxTransfer != NULL &&
+            (prvReachable(&xDevices[pxTransfer->ucDevice], xNow) == pdFALSE ||
+             timeCompare(xNow, pxTransfer->xDeadline) >= 0))
+        {
+            pxTransfers[i] = NULL;
+            prvFinishTransfer(pxTransfer, MODBUS_CLIENT_NO_CONNECTION);
+        }
+        else if (pxTransfer != NULL)
+        {
+            prvWakeAt(pxTransfer->xDeadline);
+        }
+    }
+
+    for (i = 0; i < uxRequests; i++)
+    {
+        pxRequest = &xRequests[i];
+        pxDevice = &xDevices[pxRequest->ucDevice];
+        if (timeCompare(xNow, pxRequest->xDue) < 0)
+        {
+            prvWakeAt(pxRequest->xDue);
+        }
+        else if (pxRequest->xOutstanding != pdFALSE)
+        {
+            /* The previous read of the range has not been answered yet */
+            pxDevice->xStats.ulOverruns++;
+            pxRequest->xDue = xNow + pxRequest->ulPeriodMs;
+            prvWakeAt(pxRequest->xDue);
+        }
+        else if (prvReachable(pxDevice, xNow) == pdFALSE)
+        {
+            /* Let the application know the data is stale */
+            pxRequest->xDue = xNow + pxRequest->ulPeriodMs;
+            prvWakeAt(pxRequest->xDue);
+            prvDeliver(pxRequest, MODBUS_CLIENT_NO_CONNECTION, NULL);
+        }
+    }
+
+    for (i = 0; i < MODBUS_CLIENT_MAX_CONNECTIONS; i++)
+    {
+        if (xConnections[i].pxSocket != NULL && xConnections[i].xConnected != pdFALSE)
+        {
+            prvSendDue(&xConnections[i], (int8_t) i, xNow);
+        }
+    }
+
+    prvMapDevices();
+
+    for (i = 0; i < MODBUS_CLIENT_MAX_TRANSFERS; i++)
+    {
+        pxTransfer = pxTransfers[i];
+        if (pxTransfer != NULL && cDeviceConnection[pxTransfer->ucDevice] < 0)
+        {
+            prvOpen(&xDevices[pxTransfer->ucDevice]);
+            prvMapDevices();
+        }
+    }
+
+    for (i = 0; i < uxRequests; i++)
+    {
+        pxRequest = &xRequests[i];
+        if (cDeviceConnection[pxRequest->ucDevice] < 0 && pxRequest->xOutstanding == pdFALSE &&
+            xDevices[pxRequest->ucDevice].xBackoff == pdFALSE && timeCompare(xNow, pxRequest->xDue) >= 0)
+        {
+            prvOpen(&xDevices[pxRequest->ucDevice]);
+            prvMapDevices();
+        }
+    }
+}
+
+/* Status of a response to the entry, or MODBUS_CLIENT_BAD_RESPONSE */
+static uint32_t prvCheckResponse(const ModbusOutstanding_t *pxEntry, const uint8_t *pucFrame, size_t xPduLength)
+{
+    const uint8_t *pucPdu = &pucFrame[MODBUS_MBAP_SIZE];
+    size_t xBytes;
+
+    if (pucFrame[6] != xDevices[pxEntry->ucDevice].ucUnitId ||
+        (pucPdu[0] & (uint8_t) ~MODBUS_EXCEPTION_MASK) != pxEntry->ucFunction)
+    {
+        return MODBUS_CLIENT_BAD_RESPONSE;
+    }
+
+    if ((pucPdu[0] & MODBUS_EXCEPTION_MASK) != 0)
+    {
+        return (xPduLength == 2u && pucPdu[1] != 0) ? pucPdu[1] : MODBUS_CLIENT_BAD_RESPONSE;
+    }
+
+    if (pxEntry->ucFunction <= MODBUS_FUNCTION_READ_INPUT_REGS)
+    {
+        /* The byte count of what was asked for */
+        xBytes = (pxEntry->ucFunction <= MODBUS_FUNCTION_READ_DISCRETE_INPUTS) ?
+                 (pxEntry->usCount + 7u) / 8u : 2u * pxEntry->usCount;
+        return (xPduLength == 2u + xBytes && pucPdu[1] == xBytes) ? MODBUS_CLIENT_OK : MODBUS_CLIENT_BAD_RESPONSE;
+    }
+
+    /* Writes echo the address */
+    return (xPduLength == 5u && MODBUS_READ16(&pucPdu[1]) == pxEntry->usAddress) ?
+           MODBUS_CLIENT_OK : MODBUS_CLIENT_BAD_RESPONSE;
+}
+
+/* Match every complete response of the input buffer; pdFALSE on a framing
+   error */
+static BaseType_t prvProcessResponses(ModbusClientConnection_t *pxConnection)
+{
+    const uint8_t *pucFrame;
+    ModbusDevice_t *pxDevice;
+    size_t xOffset = 0;
+    size_t xFrame;
+    uint32_t ulLatencyMs;
+    uint32_t ulStatus;
+    uint16_t usTid;
+    UBaseType_t i;
+
+    for (;;)
+    {
+        /* A response has two bytes of PDU at least */
+        pucFrame = &pxConnection->ucRx[xOffset];
+        xFrame = xModbusTcpFrameSize(pucFrame, pxConnection->xRxUsed - xOffset, 2u);
+        if (xFrame == 0)
+        {
+            break;
+        }
+        if (xFrame == MODBUS_TCP_BAD_FRAME)
+        {
+            ulFramingErrors++;
+            return pdFALSE;
+        }
+        xOffset += xFrame;
+
+        usTid = MODBUS_READ16(pucFrame);
+        for (i = 0; i < pxConnection->uxOutstanding && pxConnection->xOutstanding[i].usTid != usTid; i++)
+        {
+        }
+        if (i == pxConnection->uxOutstanding)
+        {
+            /* Timed out already */
+            ulStale++;
+            continue;
+        }
+
+        pxDevice = &xDevices[pxConnection->xOutstanding[i].ucDevice];
+        ulLatencyMs = (uint32_t) (osGetSystemTime() - pxConnection->xOutstanding[i].xSent);
+        ulStatus = prvCheckResponse(&pxConnection->xOutstanding[i], pucFrame, xFrame - MODBUS_MBAP_SIZE);
+
+        pxDevice->xStats.ulResponses++;
+        pxDevice->xStats.ulTotalLatencyMs += ulLatencyMs;
+        pxDevice->xStats.ulMaxLatencyMs = MAX(pxDevice->xStats.ulMaxLatencyMs, ulLatencyMs);
+        if (ulStatus != MODBUS_CLIENT_OK)
+        {
+            pxDevice->xStats.ulExceptions++;
+        }
+        pxDevice->ucTimeouts = 0;
+
+        prvComplete(pxConnection, i, ulStatus, &pucFrame[MODBUS_MBAP_SIZE + 2u]);
+    }
+
+    /* Keep the beginning of the next response */
+    memmove(pxConnection->ucRx, &pxConnection->ucRx[xOffset], pxConnection->xRxUsed - xOffset);
+    pxConnection->xRxUsed -= xOffset;
+
+    return pdTRUE;
+}
+
+static void prvReceive(ModbusClientConnection_t *pxConnection)
+{
+    size_t xReceived = 0;
+    error_t err;
+
+    err = socketReceive(pxConnection->pxSocket, &pxConnection->ucRx[pxConnection->xRxUsed],
+                        sizeof(pxConnection->ucRx) - pxConnection->xRxUsed, &xReceived, SOCKET_FLAG_DONT_WAIT);
+    if (err == ERROR_TIMEOUT)
+    {
+        return;
+    }
+    if (err != NO_ERROR || xReceived == 0)
+    {
+        /* Closed or reset: reopened when next needed */
+        prvClose(pxConnection);
+        return;
+    }
+
+    pxConnection->xRxUsed += xReceived;
+    pxConnection->xLastActivity = osGetSystemTime();
+
+    if (prvProcessResponses(pxConnection) == pdFALSE)
+    {
+        prvClose(pxConnection);
+    }
+}
+
+/* Requests left unanswered, and handshakes taking too long */
+static void prvCheckTimeouts(void)
+{
+    systime_t xNow = osGetSystemTime();
+    ModbusClientConnection_t *pxConnection;
+    ModbusDevice_t *pxDevice;
+    UBaseType_t i;
+    UBaseType_t j;
+
+    for (i = 0; i < MODBUS_CLIENT_MAX_CONNECTIONS; i++)
+    {
+        pxConnection = &xConnections[i];
+        if (pxConnection->pxSocket == NULL)
+        {
+            continue;
+        }
+
+        if (pxConnection->xConnected == pdFALSE)
+        {
+            if (xNow - pxConnection->xOpened >= MODBUS_CLIENT_CONNECT_MS)
+            {
+                prvConnectFailed(pxConnection);
+            }
+            else
+            {
+                prvWakeAt(pxConnection->xOpened + MODBUS_CLIENT_CONNECT_MS);
+            }
+            continue;
+        }
+
+        j = 0;
+        while (j < pxConnection->uxOutstanding)
+        {
+            if (xNow - pxConnection->xOutstanding[j].xSent < MODBUS_CLIENT_TIMEOUT_MS)
+            {
+                prvWakeAt(pxConnection->xOutstanding[j].xSent + MODBUS_CLIENT_TIMEOUT_MS);
+                j++;
+                continue;
+            }
+
+            pxDevice = &xDevices[pxConnection->xOutstanding[j].ucDevice];
+            pxDevice->xStats.ulTimeouts++;
+            if (++pxDevice->ucTimeouts >= MODBUS_CLIENT_MAX_TIMEOUTS)
+            {
+                prvBackoff(pxDevice);
+            }
+
+            /* The last entry takes its place */
+            prvComplete(pxConnection, j, MODBUS_CLIENT_TIMEOUT, NULL);
+        }
+    }
+}
+
+static void prvAcceptTransfers(void)
+{
+    ModbusTransfer_t *pxTransfer;
+    UBaseType_t i;
+
+    for (i = 0; i < MODBUS_CLIENT_MAX_TRANSFERS; i++)
+    {
+        if (pxTransfers[i] == NULL)
+        {
+            if (xQueueReceive(xTransferQueue, &pxTransfer, 0) != pdPASS)
+            {
+                return;
+            }
+            if (pxTransfer->ucDevice >= uxTaskDevices)
+            {
+                /* Added since the last compilation */
+                prvCompile();
+            }
+            pxTransfer->xDeadline = osGetSystemTime() + MODBUS_CLIENT_CONNECT_MS;
+            pxTransfers[i] = pxTransfer;
+        }
+    }
+}
+
+static void prvModbusClientTask(void *pvParameters)
+{
+    SocketEventDesc xEvents[MODBUS_CLIENT_MAX_CONNECTIONS];
+    ModbusClientConnection_t *pxOwners[MODBUS_CLIENT_MAX_CONNECTIONS];
+    systime_t xNow;
+    systime_t xWait;
+    UBaseType_t uxCount;
+    UBaseType_t i;
+
+    (void) pvParameters;
+
+    for (;;)
+    {
+        if (xConfigDirty != pdFALSE)
+        {
+            prvCompile();
+        }
+
+        /* Wake up once a second at least */
+        xNextWake = osGetSystemTime() + 1000u;
+
+        prvAcceptTransfers();
+        prvCheckTimeouts();
+        prvSchedule();
+
+        /* Handshakes in progress and open connections */
+        uxCount = 0;
+        for (i = 0; i < MODBUS_CLIENT_MAX_CONNECTIONS; i++)
+        {
+            if (xConnections[i].pxSocket != NULL)
+            {
+                xEvents[uxCount].socket = xConnections[i].pxSocket;
+                xEvents[uxCount].eventMask = (xConnections[i].xConnected != pdFALSE) ? SOCKET_EVENT_RX_READY :
+                                             (SOCKET_EVENT_CONNECTED | SOCKET_EVENT_CLOSED);
+                xEvents[uxCount].eventFlags = 0;
+                pxOwners[uxCount++] = &xConnections[i];
+            }
+        }
+
+        xNow = osGetSystemTime();
+        xWait = (timeCompare(xNextWake, xNow) > 0) ? xNextWake - xNow : 0;
+
+        if (uxCount == 0)
+        {
+            (void) osWaitForEvent(&xClientEvent, xWait);
+            continue;
+        }
+
+        if (socketPoll(xEvents, uxCount, &xClientEvent, xWait) != NO_ERROR)
+        {
+            continue;
+        }
+
+        for (i = 0; i < uxCount; i++)
+        {
+            if (pxOwners[i]->xConnected != pdFALSE)
+            {
+                if ((xEvents[i].eventFlags & SOCKET_EVENT_RX_READY) != 0)
+                {
+                    prvReceive(pxOwners[i]);
+                }
+            }
+            else if ((xEvents[i].eventFlags & SOCKET_EVENT_CONNECTED) != 0)
+            {
+                prvConnected(pxOwners[i]);
+            }
+            else if ((xEvents[i].eventFlags & SOCKET_EVENT_CLOSED) != 0)
+            {
+                prvConnectFailed(pxOwners[i]);
+            }
+        }
+    }
+}
+
+BaseType_t xModbusClientStart(UBaseType_t uxPriority)
+{
+    xConfigMutex = xAppSemaphoreCreateMutex(xConfigMutex);
+    xTransferQueue = xAppQueueCreate(xTransferQueue, MODBUS_CLIENT_MAX_TRANSFERS, sizeof(ModbusTransfer_t *));
+    if (xConfigMutex == NULL || xTransferQueue == NULL || !osCreateEvent(&xClientEvent))
+    {
+        return pdFAIL;
+    }
+
+    return xAppTaskCreate(xModbusClientTask,
+                          prvModbusClientTask,
+                          "ModbusC",
+                          MODBUS_CLIENT_TASK_STACK_SIZE,
+                          NULL,
+                          uxPriority,
+                          NULL);
+}
+
+int32_t lModbusClientAddDevice(const char *pcAddress, uint16_t usPort, uint8_t ucUnitId, uint8_t ucPipeline)
+{
+    ModbusDevice_t *pxDevice;
+    IpAddr xAddr;
+    int32_t lDevice = -1;
+
+    if (xConfigMutex == NULL || ipStringToAddr(pcAddress, &xAddr) != NO_ERROR || xAddr.length != sizeof(Ipv4Addr))
+    {
+        return -1;
+    }
+
+    xSemaphoreTake(xConfigMutex, portMAX_DELAY);
+    if (uxDevices < MODBUS_CLIENT_MAX_DEVICES)
+    {
+        pxDevice = &xDevices[uxDevices];
+        memset(pxDevice, 0, sizeof(*pxDevice));
+        pxDevice->xAddr = xAddr;
+        pxDevice->usPort = (usPort != 0) ? usPort : MODBUS_TCP_PORT;
+        pxDevice->ucUnitId = ucUnitId;
+        pxDevice->ucPipeline = (uint8_t) MIN((ucPipeline != 0) ? ucPipeline : MODBUS_CLIENT_PIPELINE,
+                                             MODBUS_CLIENT_MAX_OUTSTANDING);
+        lDevice = (int32_t) uxDevices++;
+        xConfigDirty = pdTRUE;
+    }
+    xSemaphoreGive(xConfigMutex);
+
+    osSetEvent(&xClientEvent);
+
+    return lDevice;
+}
+
+BaseType_t xModbusClientAddPoll(int32_t lDevice, ModbusTable_t eTable, uint16_t usAddress, uint16_t usCount,
+                                uint32_t ulPeriodMs, void *pvDest, ModbusPollCallback_t pxCallback, void *pvContext)
+{
+    ModbusPoll_t *pxPoll;
+    BaseType_t xResult = pdFAIL;
+
+    if (xConfigMutex == NULL || (uint32_t) eTable > (uint32_t) eModbusInputRegs || usCount == 0 ||
+        usCount > prvMaxRead((uint8_t) eTable) || (uint32_t) usAddress + usCount > 0x10000u || ulPeriodMs == 0)
+    {
+        return pdFAIL;
+    }
+
+    xSemaphoreTake(xConfigMutex, portMAX_DELAY);
+    if (lDevice >= 0 && (UBaseType_t) lDevice < uxDevices && uxPolls < MODBUS_CLIENT_MAX_POLLS)
+    {
+        pxPoll = &xPolls[uxPolls++];
+        pxPoll->ucDevice = (uint8_t) lDevice;
+        pxPoll->ucTable = (uint8_t) eTable;
+        pxPoll->usAddress = usAddress;
+        pxPoll->usCount = usCount;
+        pxPoll->ulPeriodMs = ulPeriodMs;
+        pxPoll->pvDest = pvDest;
+        pxPoll->pxCallback = pxCallback;
+        pxPoll->pvContext = pvContext;
+        xConfigDirty = pdTRUE;
+        xResult = pdPASS;
+    }
+    xSemaphoreGive(xConfigMutex);
+
+    osSetEvent(&xClientEvent);
+
+    return xResult;
+}
+
+/* Hand a transfer to the client task and wait for its completion, which
+   comes within the connection and response timeouts */
+static uint32_t prvTransfer(int32_t lDevice, uint8_t ucFunction, uint16_t usAddress, uint16_t usCount, void *pvData)
+{
+    ModbusTransfer_t xTransfer;
+    ModbusTransfer_t *pxTransfer = &xTransfer;
+    BaseType_t xKnown;
+
+    if (xConfigMutex == NULL)
+    {
+        return MODBUS_CLIENT_NO_CONNECTION;
+    }
+
+    xSemaphoreTake(xConfigMutex, portMAX_DELAY);
+    xKnown = (lDevice >= 0 && (UBaseType_t) lDevice < uxDevices) ? pdTRUE : pdFALSE;
+    xSemaphoreGive(xConfigMutex);
+    if (xKnown == pdFALSE)
+    {
+        return MODBUS_CLIENT_NO_CONNECTION;
+    }
+
+    /* The task learns about the device before it takes the transfer */
+    xTransfer.ucDevice = (uint8_t) lDevice;
+    xTransfer.ucFunction = ucFunction;
+    xTransfer.usAddress = usAddress;
+    xTransfer.usCount = usCount;
+    xTransfer.pvData = pvData;
+    xTransfer.xWaiter = xTaskGetCurrentTaskHandle();
+    xTransfer.ulStatus = MODBUS_CLIENT_NO_CONNECTION;
+
+    (void) ulTaskNotifyTake(pdTRUE, 0);
+    xQueueSend(xTransferQueue, &pxTransfer, portMAX_DELAY);
+    osSetEvent(&xClientEvent);
+    (void) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    return xTransfer.ulStatus;
+}
+
+uint32_t ulModbusClientRead(int32_t lDevice, ModbusTable_t eTable, uint16_t usAddress, uint16_t usCount,
+                            void *pvDest)
+{
+    if ((uint32_t) eTable > (uint32_t) eModbusInputRegs || usCount == 0 || usCount > prvMaxRead((uint8_t) eTable))
+    {
+        return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+    }
+
+    return prvTransfer(lDevice, ucReadFunctions[eTable], usAddress, usCount, pvDest);
+}
+
+uint32_t ulModbusClientWriteRegs(int32_t lDevice, uint16_t usAddress, const uint16_t *pusValues, uint16_t usCount)
+{
+    if (usCount == 0 || usCount > MODBUS_MAX_WRITE_REGS)
+    {
+        return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+    }
+
+    return prvTransfer(lDevice, (usCount == 1u) ? MODBUS_FUNCTION_WRITE_SINGLE_REG : MODBUS_FUNCTION_WRITE_MULTIPLE_REGS,
+                       usAddress, usCount, (void *) pusValues);
+}
+
+uint32_t ulModbusClientWriteCoil(int32_t lDevice, uint16_t usAddress, BaseType_t xValue)
+{
+    uint16_t usValue = (xValue != pdFALSE) ? MODBUS_COIL_STATE_ON : MODBUS_COIL_STATE_OFF;
+
+    return prvTransfer(lDevice, MODBUS_FUNCTION_WRITE_SINGLE_COIL, usAddress, 1u, &usValue);
+}
+
+BaseType_t xModbusClientGetStats(int32_t lDevice, ModbusClientStats_t *pxStats)
+{
+    if (lDevice < 0 || (UBaseType_t) lDevice >= uxDevices)
+    {
+        return pdFAIL;
+    }
+
+    *pxStats = xDevices[lDevice].xStats;
+    return pdPASS;
+}
+
+static BaseType_t prvParseTable(const char *pcParameter, BaseType_t xLength, ModbusTable_t *peTable)
+{
+    UBaseType_t i;
+
+    for (i = 0; pcParameter != NULL && xLength == 2 && i < 4u; i++)
+    {
+        if (strncmp(pcParameter, pcTableNames[i], 2) == 0)
+        {
+            *peTable = (ModbusTable_t) i;
+            return pdTRUE;
+        }
+    }
+
+    return pdFALSE;
+}
+
+static unsigned long prvNumber(const char *pcCommandString, UBaseType_t uxIndex, unsigned long ulDefault)
+{
+    const char *pcParameter;
+    BaseType_t xLength;
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, uxIndex, &xLength);
+    return (pcParameter != NULL) ? strtoul(pcParameter, NULL, 0) : ulDefault;
+}
+
+/* "modbusc read": the values, eight per line */
+static void prvPrintRead(char *pcWriteBuffer, size_t xWriteBufferLen, int32_t lDevice, ModbusTable_t eTable,
+                         uint16_t usAddress, uint16_t usCount)
+{
+    uint16_t usValues[MODBUS_CLIENT_CLI_COUNT];
+    uint8_t ucBits[(MODBUS_CLIENT_CLI_COUNT + 7u) / 8u];
+    uint32_t ulStatus;
+    size_t xUsed = 0;
+    uint16_t i;
+
+    ulStatus = ulModbusClientRead(lDevice, eTable, usAddress, usCount,
+                                  (eTable >= eModbusHoldingRegs) ? (void *) usValues : (void *) ucBits);
+    if (ulStatus != MODBUS_CLIENT_OK)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Failed, status 0x%lx\r\n", (unsigned long) ulStatus);
+        return;
+    }
+
+    for (i = 0; i < usCount && xUsed < xWriteBufferLen; i++)
+    {
+        if (eTable >= eModbusHoldingRegs)
+        {
+            xUsed += (size_t) snprintf(&pcWriteBuffer[xUsed], xWriteBufferLen - xUsed, "%u%s", usValues[i],
+                                       (i % 8u == 7u || i + 1u == usCount) ? "\r\n" : " ");
+        }
+        else
+        {
+            xUsed += (size_t) snprintf(&pcWriteBuffer[xUsed], xWriteBufferLen - xUsed, "%u%s",
+                                       (ucBits[i / 8u] >> (i % 8u)) & 1u, (i + 1u == usCount) ? "\r\n" : "");
+        }
+    }
+}
+
+static BaseType_t prvModbusClientCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    static UBaseType_t uxLine = 0;
+    const ModbusClientStats_t *pxStats;
+    const ModbusDevice_t *pxDevice;
+    const char *pcParameter;
+    BaseType_t xLength;
+    ModbusTable_t eTable;
+    unsigned long ulDevice;
+    unsigned long ulAddress;
+    unsigned long ulValue;
+    uint16_t usValue;
+    uint32_t ulStatus;
+    int32_t lDevice;
+    char cAddr[40];
+    UBaseType_t uxOpen = 0;
+    UBaseType_t i;
+
+    if (uxLine == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xLength);
+        if (pcParameter != NULL)
+        {
+            ulDevice = prvNumber(pcCommandString, 2, ~0ul);
+            ulAddress = prvNumber(pcCommandString, 3, ~0ul);
+
+            if (xLength == 3 && strncmp(pcParameter, "add", 3) == 0)
+            {
+                pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xLength);
+                if (pcParameter == NULL || (size_t) xLength >= sizeof(cAddr))
+                {
+                    snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: modbusc add <ip> [<port> [<unit>]]\r\n");
+                    return pdFALSE;
+                }
+                memcpy(cAddr, pcParameter, (size_t) xLength);
+                cAddr[xLength] = '\0';
+                lDevice = lModbusClientAddDevice(cAddr, (uint16_t) prvNumber(pcCommandString, 3, 0),
+                                                 (uint8_t) prvNumber(pcCommandString, 4, 1), 0);
+                if (lDevice < 0)
+                {
+                    snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid address or table full\r\n");
+                }
+                else
+                {
+                    snprintf(pcWriteBuffer, xWriteBufferLen, "Device %ld\r\n", (long) lDevice);
+                }
+                return pdFALSE;
+            }
+
+            if (xLength == 4 && strncmp(pcParameter, "poll", 4) == 0)
+            {
+                pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 3, &xLength);
+                if (prvParseTable(pcParameter, xLength, &eTable) == pdFALSE ||
+                    xModbusClientAddPoll((int32_t) ulDevice, eTable, (uint16_t) prvNumber(pcCommandString, 4, 0),
+                                         (uint16_t) prvNumber(pcCommandString, 5, 0),
+                                         (uint32_t) prvNumber(pcCommandString, 6, 0), NULL, NULL, NULL) != pdPASS)
+                {
+                    snprintf(pcWriteBuffer, xWriteBufferLen,
+                             "Usage: modbusc poll <dev> <co|di|hr|ir> <addr> <count> <period-ms>\r\n");
+                }
+                else
+                {
+                    snprintf(pcWriteBuffer, xWriteBufferLen, "Polling\r\n");
+                }
+                return pdFALSE;
+            }
+
+            if (xLength == 4 && strncmp(pcParameter, "read", 4) == 0)
+            {
+                pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 3, &xLength);
+                ulAddress = prvNumber(pcCommandString, 4, ~0ul);
+                ulValue = prvNumber(pcCommandString, 5, 1);
+                if (prvParseTable(pcParameter, xLength, &eTable) == pdFALSE || ulAddress > 0xFFFFu ||
+                    ulValue == 0 || ulValue > MODBUS_CLIENT_CLI_COUNT)
+                {
+                    snprintf(pcWriteBuffer, xWriteBufferLen,
+                             "Usage: modbusc read <dev> <co|di|hr|ir> <addr> [<count>], up to %u\r\n",
+                             MODBUS_CLIENT_CLI_COUNT);
+                    return pdFALSE;
+                }
+                prvPrintRead(pcWriteBuffer, xWriteBufferLen, (int32_t) ulDevice, eTable,
+                             (uint16_t) ulAddress, (uint16_t) ulValue);
+                return pdFALSE;
+            }
+
+            if ((xLength == 5 && strncmp(pcParameter, "write", 5) == 0) ||
+                (xLength == 4 && strncmp(pcParameter, "coil", 4) == 0))
+            {
+                ulValue = prvNumber(pcCommandString, 4, ~0ul);
+                if (ulAddress > 0xFFFFu || ulValue > 0xFFFFu)
+                {
+                    snprintf(pcWriteBuffer, xWriteBufferLen,
+                             "Usage: modbusc write <dev> <addr> <value> | coil <dev> <addr> <0|1>\r\n");
+                    return pdFALSE;
+                }
+                if (xLength == 4)
+                {
+                    ulStatus = ulModbusClientWriteCoil((int32_t) ulDevice, (uint16_t) ulAddress,
+                                                       (ulValue != 0) ? pdTRUE : pdFALSE);
+                }
+                else
+                {
+                    usValue = (uint16_t) ulValue;
+                    ulStatus = ulModbusClientWriteRegs((int32_t) ulDevice, (uint16_t) ulAddress, &usValue, 1u);
+                }
+                if (ulStatus == MODBUS_CLIENT_OK)
+                {
+                    snprintf(pcWriteBuffer, xWriteBufferLen, "Written\r\n");
+                }
+                else
+                {
+                    snprintf(pcWriteBuffer, xWriteBufferLen, "Failed, status 0x%lx\r\n", (unsigned long) ulStatus);
+                }
+                return pdFALSE;
+            }
+
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: modbusc [add | poll | read | write | coil]\r\n");
+            return pdFALSE;
+        }
+
+        for (i = 0; i < MODBUS_CLIENT_MAX_CONNECTIONS; i++)
+        {
+            if (xConnections[i].pxSocket != NULL && xConnections[i].xConnected != pdFALSE)
+            {
+                uxOpen++;
+            }
+        }
+
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "devices %lu polls %lu requests %lu, connections %lu/%u, connects %lu failed %lu evicted %lu\r\n",
+                 (unsigned long) uxDevices, (unsigned long) uxPolls, (unsigned long) uxRequests,
+                 (unsigned long) uxOpen, MODBUS_CLIENT_MAX_CONNECTIONS, (unsigned long) ulConnects,
+                 (unsigned long) ulConnectFailures, (unsigned long) ulEvictions);
+        uxLine++;
+        return pdTRUE;
+    }
+
+    if (uxLine == 1u)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "stale %lu framing-errors %lu\r\n",
+                 (unsigned long) ulStale, (unsigned long) ulFramingErrors);
+        if (uxDevices == 0)
+        {
+            uxLine = 0;
+            return pdFALSE;
+        }
+        uxLine++;
+        return pdTRUE;
+    }
+
+    if (uxLine == 2u)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "dev address          unit  requests responses exc  timeouts overruns avg-ms max-ms\r\n");
+        uxLine++;
+        return pdTRUE;
+    }
+
+    /* One line per device */
+    pxDevice = &xDevices[uxLine - 3u];
+    pxStats = &pxDevice->xStats;
+    ipAddrToString(&pxDevice->xAddr, cAddr);
+    snprintf(pcWriteBuffer, xWriteBufferLen, "%-3lu %-15s%c %4u %9lu %9lu %4lu %9lu %8lu %6lu %6lu\r\n",
+             (unsigned long) (uxLine - 3u), cAddr, (pxDevice->xBackoff != pdFALSE) ? '!' : ' ',
+             pxDevice->ucUnitId, (unsigned long) pxStats->ulRequests, (unsigned long) pxStats->ulResponses,
+             (unsigned long) pxStats->ulExceptions, (unsigned long) pxStats->ulTimeouts,
+             (unsigned long) pxStats->ulOverruns,
+             (unsigned long) ((pxStats->ulResponses > 0) ? pxStats->ulTotalLatencyMs / pxStats->ulResponses : 0),
+             (unsigned long) pxStats->ulMaxLatencyMs);
+
+    if (uxLine - 2u < uxDevices)
+    {
+        uxLine++;
+        return pdTRUE;
+    }
+
+    uxLine = 0;
+    return pdFALSE;
+}
+
+void vModbusClientRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xModbusClient);
+}
@@ -0,0 +1,924 @@
+/* ModbusRtuGateway.c
+ *
+ * Request queues, response cache and RS-485 driver of the Modbus RTU
+ * gateway (see ModbusRtuGateway.h); the connections are those of
+ * ModbusTcp.c.
+ *
+ * A request belongs to the connection task until it is sent to the bus task
+ * through xRequestQueue, and to the bus task until it comes back through
+ * xDoneQueue, so neither the requests nor the slave queues are locked. The
+ * connections, the cache and the free requests belong to the connection
+ * task, the slave queues and the UART to the bus task.
+ *
+ * USART6 and its DMA streams are set up here, as USART2 is in PppModem.c:
+ * the HAL UART callbacks are those of the console.
+ */
+#include "ModbusRtuGateway.h"
+#include "ModbusTcp.h"
+#include "MonoClock.h"
+#include "RunTimeStats.h"
+#include "StaticAlloc.h"
+#include "task.h"
+#include "queue.h"
+#include "FreeRTOS_CLI.h"
+#include "stm32h7xx_hal.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Addresses of the RTU slaves; 0 is the broadcast address */
+#define MODBUS_RTU_MAX_SLAVE           247u
+
+/* Slave address, PDU and CRC */
+#define MODBUS_RTU_MAX_ADU_SIZE        (1u + MODBUS_MAX_PDU_SIZE + 2u)
+#define MODBUS_RTU_MIN_RESPONSE_SIZE   5u
+
+/* The response to a request is read before the next request is sent, so
+ * the circular buffer only has to hold one frame and what noise precedes it */
+#define MODBUS_RTU_RX_DMA_SIZE         512u
+
+#define MODBUS_RTU_CACHE_LINE          32u
+
+/* One character: start, 8 data, parity and stop bits */
+#define MODBUS_RTU_CHAR_US             ((11u * 1000000u + MODBUS_RTU_GATEWAY_BAUD_RATE - 1u) / MODBUS_RTU_GATEWAY_BAUD_RATE)
+
+/* Silence ending a frame, in bit times: 3.5 characters up to 19200 baud,
+ * 1750 us above (Modbus over serial line, 2.5.1.1) */
+#if (MODBUS_RTU_GATEWAY_BAUD_RATE <= 19200u)
+#define MODBUS_RTU_T35_BITS            39u
+#else
+#define MODBUS_RTU_T35_BITS            ((1750u * (MODBUS_RTU_GATEWAY_BAUD_RATE / 100u) + 9999u) / 10000u)
+#endif
+
+/* Notification bits of the bus task */
+#define MODBUS_RTU_NOTIFY_TX           0x01u    /* Last stop bit of the request sent */
+#define MODBUS_RTU_NOTIFY_RX           0x02u    /* Receiver timeout: end of a frame */
+
+/* End of a slave queue */
+#define MODBUS_RTU_NONE                0xFFu
+
+typedef struct
+{
+    BaseType_t xInUse;              /* Owned by the connection task */
+    uint8_t ucConnection;           /* Index in xConnections */
+    uint8_t ucUnit;                 /* Slave address */
+    uint8_t ucNext;                 /* Next in the queue of the slave */
+    uint8_t ucFunction;
+    uint16_t usGeneration;          /* Of the connection when received */
+    uint16_t usTransaction;
+    uint16_t usAddress;             /* Range of a read, the cache key */
+    uint16_t usCount;
+    uint64_t ullRxUs;
+    size_t xLength;                 /* Of the request PDU, then of the response */
+    uint8_t ucPdu[MODBUS_MAX_PDU_SIZE];
+} ModbusGwRequest_t;
+
+typedef struct
+{
+    uint8_t ucHead;                 /* Queued requests, MODBUS_RTU_NONE if none */
+    uint8_t ucTail;
+    uint8_t ucFailures;             /* Requests without a valid response in a row */
+    systime_t xRetryTime;           /* While offline */
+} ModbusGwSlave_t;
+
+typedef struct
+{
+    uint8_t ucUnit;                 /* 0 for a free entry */
+    uint8_t ucFunction;
+    uint16_t usAddress;
+    uint16_t usCount;
+    uint8_t ucLength;
+    systime_t xTime;                /* Of the response */
+    uint8_t ucPdu[MODBUS_MAX_PDU_SIZE];
+} ModbusGwCacheEntry_t;
+
+static UART_HandleTypeDef huart6;
+static DMA_HandleTypeDef hdma_usart6_rx;
+static DMA_HandleTypeDef hdma_usart6_tx;
+
+/* DMA buffers; the CPU never writes the RX ring, so it can be invalidated
+ * as a whole */
+static uint8_t ucRxDma[MODBUS_RTU_RX_DMA_SIZE] __attribute__((aligned(MODBUS_RTU_CACHE_LINE)));
+static uint8_t ucTxAdu[(MODBUS_RTU_MAX_ADU_SIZE + MODBUS_RTU_CACHE_LINE - 1u) & ~(MODBUS_RTU_CACHE_LINE - 1u)]
+    __attribute__((aligned(MODBUS_RTU_CACHE_LINE)));
+
+/* Positions in the RX ring at the end of the request and of the last frame */
+static volatile uint32_t ulRxStart = 0;
+static volatile uint32_t ulRxEnd = 0;
+
+static uint16_t usCrcTable[256];
+
+static QueueHandle_t xRequestQueue = NULL;
+static QueueHandle_t xDoneQueue = NULL;
+static OsEvent xGatewayEvent;
+static TaskHandle_t xBusTask = NULL;
+
+/* Owned by the connection task */
+static ModbusTcpConnection_t xConnections[MODBUS_RTU_GATEWAY_MAX_CONNECTIONS];
+static ModbusTcpServer_t xServer;
+static ModbusGwRequest_t xRequests[MODBUS_RTU_GATEWAY_MAX_REQUESTS];
+static UBaseType_t uxFreeRequests = MODBUS_RTU_GATEWAY_MAX_REQUESTS;
+static ModbusGwCacheEntry_t xCache[MODBUS_RTU_GATEWAY_CACHE_ENTRIES];
+static uint8_t ucWritesPending[MODBUS_RTU_MAX_SLAVE + 1u];
+static uint8_t ucResponse[MODBUS_MAX_ADU_SIZE];
+
+/* Owned by the bus task */
+static ModbusGwSlave_t xSlaves[MODBUS_RTU_MAX_SLAVE + 1u];
+static uint8_t ucRxAdu[MODBUS_RTU_MAX_ADU_SIZE];
+static uint_t uLastSlave = 0;
+
+static ModbusRtuGatewayStats_t xStats;
+
+APP_TASK_STORAGE(xModbusGwTask, MODBUS_RTU_GATEWAY_TASK_STACK_SIZE);
+APP_TASK_STORAGE(xBusTask, MODBUS_RTU_GATEWAY_TASK_STACK_SIZE);
+APP_QUEUE_STORAGE(xRequestQueue, MODBUS_RTU_GATEWAY_MAX_REQUESTS, sizeof(ModbusGwRequest_t *));
+APP_QUEUE_STORAGE(xDoneQueue, MODBUS_RTU_GATEWAY_MAX_REQUESTS, sizeof(ModbusGwRequest_t *));
+
+static BaseType_t prvModbusGwCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xModbusGw =
+{
+    "modbusgw",
+    "\r\nmodbusgw:\r\n Modbus RTU gateway requests, cache, bus errors and latency\r\n",
+    prvModbusGwCommand,
+    -1
+};
+
+/* CRC-16 of Modbus: reflected polynomial 0xA001, initial value 0xFFFF */
+static void prvCrcInit(void)
+{
+    uint16_t usCrc;
+    uint_t i;
+    uint_t j;
+
+    for (i = 0; i < 256u; i++)
+    {
+        usCrc = (uint16_t) i;
+        for (j = 0; j < 8u; j++)
+        {
+            usCrc = ((usCrc & 1u) != 0) ? (uint16_t) ((usCrc >> 1) ^ 0xA001u) : (uint16_t) (usCrc >> 1);
+        }
+        usCrcTable[i] = usCrc;
+    }
+}
+
+static uint16_t prvCrc(const uint8_t *pucData, size_t xLength)
+{
+    uint16_t usCrc = 0xFFFFu;
+
+    while (xLength-- > 0)
+    {
+        usCrc = (uint16_t) ((usCrc >> 8) ^ usCrcTable[(usCrc ^ *pucData++) & 0xFFu]);
+    }
+
+    return usCrc;
+}
+
+static BaseType_t prvIsRead(uint8_t ucFunction)
+{
+    return (ucFunction >= MODBUS_FUNCTION_READ_COILS && ucFunction <= MODBUS_FUNCTION_READ_INPUT_REGS) ? pdTRUE : pdFALSE;
+}
+
+/*-------------------------------------------------------------------------*/
+/* RS-485 line                                                             */
+/*-------------------------------------------------------------------------*/
+
+static uint32_t prvRxHead(void)
+{
+    uint32_t ulHead = MODBUS_RTU_RX_DMA_SIZE - __HAL_DMA_GET_COUNTER(&hdma_usart6_rx);
+
+    return (ulHead >= MODBUS_RTU_RX_DMA_SIZE) ? 0 : ulHead;
+}
+
+/* The last byte is in the USART: wait for its stop bit */
+static void prvTxDmaDone(DMA_HandleTypeDef *hdma)
+{
+    (void) hdma;
+
+    CLEAR_BIT(USART6->CR3, USART_CR3_DMAT);
+    SET_BIT(USART6->CR1, USART_CR1_TCIE);
+}
+
+void USART6_IRQHandler(void)
+{
+    BaseType_t xWoken = pdFALSE;
+    uint32_t ulIsr;
+
+    vRunTimeStatsIsrEnter(RUN_TIME_STATS_ISR_USART6);
+
+    ulIsr = USART6->ISR;
+    if ((ulIsr & (USART_ISR_ORE | USART_ISR_FE | USART_ISR_NE | USART_ISR_PE)) != 0)
+    {
+        USART6->ICR = USART_ICR_ORECF | USART_ICR_FECF | USART_ICR_NECF | USART_ICR_PECF;
+        xStats.ulLineErrors++;
+    }
+
+    /* t3.5 of silence after a character: the frame is complete */
+    if ((ulIsr & USART_ISR_RTOF) != 0)
+    {
+        USART6->ICR = USART_ICR_RTOCF;
+        ulRxEnd = prvRxHead();
+        xTaskNotifyFromISR(xBusTask, MODBUS_RTU_NOTIFY_RX, eSetBits, &xWoken);
+    }
+
+    /* The driver enable output drops with the last stop bit; what is
+     * received from now on (not the echo of the request) is the response */
+    if ((ulIsr & USART_ISR_TC) != 0 && (USART6->CR1 & USART_CR1_TCIE) != 0)
+    {
+        CLEAR_BIT(USART6->CR1, USART_CR1_TCIE);
+        ulRxStart = prvRxHead();
+        xTaskNotifyFromISR(xBusTask, MODBUS_RTU_NOTIFY_TX, eSetBits, &xWoken);
+    }
+
+    vRunTimeStatsIsrExit(RUN_TIME_STATS_ISR_USART6);
+    portYIELD_FROM_ISR(xWoken);
+}
+
+void DMA1_Stream5_IRQHandler(void)
+{
+    vRunTimeStatsIsrEnter(RUN_TIME_STATS_ISR_USART6);
+    HAL_DMA_IRQHandler(&hdma_usart6_tx);
+    vRunTimeStatsIsrExit(RUN_TIME_STATS_ISR_USART6);
+}
+
+static BaseType_t prvLineInit(void)
+{
+    GPIO_InitTypeDef xGpio = {0};
+
+    __HAL_RCC_USART6_CLK_ENABLE();
+    __HAL_RCC_GPIOG_CLK_ENABLE();
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    /* PG8 DE, PG9 RX, PG14 TX */
+    xGpio.Pin = GPIO_PIN_8 | GPIO_PIN_9 | GPIO_PIN_14;
+    xGpio.Mode = GPIO_MODE_AF_PP;
+    xGpio.Pull = GPIO_NOPULL;
+    xGpio.Speed = GPIO_SPEED_FREQ_LOW;
+    xGpio.Alternate = GPIO_AF7_USART6;
+    HAL_GPIO_Init(GPIOG, &xGpio);
+
+    /* 9-bit words: 8 data bits and the parity bit */
+    huart6.Instance = USART6;
+    huart6.Init.BaudRate = MODBUS_RTU_GATEWAY_BAUD_RATE;
+    huart6.Init.WordLength = UART_WORDLENGTH_9B;
+    huart6.Init.StopBits = UART_STOPBITS_1;
+    huart6.Init.Parity = UART_PARITY_EVEN;
+    huart6.Init.Mode = UART_MODE_TX_RX;
+    huart6.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+    huart6.Init.OverSampling = UART_OVERSAMPLING_16;
+    huart6.Init.OneBitSampling = UART_ONE_BIT_SAMPLE_DISABLE;
+    huart6.Init.ClockPrescaler = UART_PRESCALER_DIV1;
+    huart6.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_NO_INIT;
+
+    /* DE asserted one bit time before the start bit and released one bit
+     * time after the stop bit (in sixteenths of a bit) */
+    if (HAL_RS485Ex_Init(&huart6, UART_DE_POLARITY_HIGH, 16u, 16u) != HAL_OK)
+    {
+        return pdFAIL;
+    }
+
+    HAL_UART_ReceiverTimeout_Config(&huart6, MODBUS_RTU_T35_BITS);
+    if (HAL_UART_EnableReceiverTimeout(&huart6) != HAL_OK)
+    {
+        return pdFAIL;
+    }
+
+    hdma_usart6_rx.Instance = DMA1_Stream4;
+    hdma_usart6_rx.Init.Request = DMA_REQUEST_USART6_RX;
+    hdma_usart6_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_usart6_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart6_rx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart6_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart6_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart6_rx.Init.Mode = DMA_CIRCULAR;
+    hdma_usart6_rx.Init.Priority = DMA_PRIORITY_MEDIUM;
+    hdma_usart6_rx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(&hdma_usart6_rx) != HAL_OK)
+    {
+        return pdFAIL;
+    }
+
+    hdma_usart6_tx.Instance = DMA1_Stream5;
+    hdma_usart6_tx.Init = hdma_usart6_rx.Init;
+    hdma_usart6_tx.Init.Request = DMA_REQUEST_USART6_TX;
+    hdma_usart6_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_usart6_tx.Init.Mode = DMA_NORMAL;
+    if (HAL_DMA_Init(&hdma_usart6_tx) != HAL_OK)
+    {
+        return pdFAIL;
+    }
+    hdma_usart6_tx.XferCpltCallback = prvTxDmaDone;
+    hdma_usart6_tx.XferErrorCallback = prvTxDmaDone;
+
+    /* The receiver runs for good; frames are found by their position in the
+     * ring, so the RX stream needs no interrupt */
+    if (HAL_DMA_Start(&hdma_usart6_rx, (uint32_t) &USART6->RDR, (uint32_t) ucRxDma, MODBUS_RTU_RX_DMA_SIZE) != HAL_OK)
+    {
+        return pdFAIL;
+    }
+    SET_BIT(USART6->CR3, USART_CR3_DMAR);
+
+    __HAL_UART_CLEAR_FLAG(&huart6, UART_CLEAR_RTOF | UART_CLEAR_OREF | UART_CLEAR_FEF | UART_CLEAR_NEF | UART_CLEAR_PEF);
+    SET_BIT(USART6->CR1, USART_CR1_RTOIE | USART_CR1_PEIE);
+    SET_BIT(USART6->CR3, USART_CR3_EIE);
+
+    HAL_NVIC_SetPriority(USART6_IRQn, MODBUS_RTU_GATEWAY_IRQ_PRIORITY, 0);
+    HAL_NVIC_SetPriority(DMA1_Stream5_IRQn, MODBUS_RTU_GATEWAY_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(USART6_IRQn);
+    HAL_NVIC_EnableIRQ(DMA1_Stream5_IRQn);
+
+    return pdPASS;
+}
+
+/* Wait for one of the notifications; the others are discarded */
+static BaseType_t prvWaitFor(uint32_t ulBit, TickType_t xTimeout)
+{
+    TimeOut_t xTimeOut;
+    uint32_t ulValue;
+
+    vTaskSetTimeOutState(&xTimeOut);
+    do
+    {
+        if (xTaskNotifyWait(0, 0xFFFFFFFFu, &ulValue, xTimeout) == pdTRUE && (ulValue & ulBit) != 0)
+        {
+            return pdTRUE;
+        }
+    } while (xTaskCheckForTimeOut(&xTimeOut, &xTimeout) == pdFALSE);
+
+    return pdFALSE;
+}
+
+/* Send the ADU of ucTxAdu and receive the frame that follows into ucRxAdu;
+ * returns its length, 0 on a timeout. The line is silent on return: either
+ * the receiver timeout ended the frame, or nothing came */
+static size_t prvTransact(size_t xLength)
+{
+    TickType_t xWait;
+    BaseType_t xLong = pdFALSE;
+    uint32_t ulStart;
+    uint32_t ulEnd;
+    size_t xReceived;
+    size_t n;
+
+    (void) xTaskNotifyWait(0, 0xFFFFFFFFu, NULL, 0);
+
+    /* The DMA reads the memory, not the data cache */
+    SCB_CleanDCache_by_Addr((uint32_t *) ucTxAdu, (int32_t) sizeof(ucTxAdu));
+    if (HAL_DMA_Start_IT(&hdma_usart6_tx, (uint32_t) ucTxAdu, (uint32_t) &USART6->TDR, xLength) != HAL_OK)
+    {
+        return 0;
+    }
+    SET_BIT(USART6->CR3, USART_CR3_DMAT);
+
+    /* Line time of the request, and a margin */
+    if (prvWaitFor(MODBUS_RTU_NOTIFY_TX, pdMS_TO_TICKS((xLength * MODBUS_RTU_CHAR_US) / 1000u + 10u)) == pdFALSE)
+    {
+        (void) HAL_DMA_Abort(&hdma_usart6_tx);
+        CLEAR_BIT(USART6->CR3, USART_CR3_DMAT);
+        CLEAR_BIT(USART6->CR1, USART_CR1_TCIE);
+        return 0;
+    }
+    ulStart = ulRxStart;
+
+    xWait = pdMS_TO_TICKS(MODBUS_RTU_GATEWAY_RESPONSE_TIMEOUT_MS);
+    for (;;)
+    {
+        if (prvWaitFor(MODBUS_RTU_NOTIFY_RX, xWait) == pdFALSE)
+        {
+            /* A long response started in time: give it the time of the
+             * largest frame */
+            if (xLong == pdFALSE && prvRxHead() != ulStart)
+            {
+                xLong = pdTRUE;
+                xWait = pdMS_TO_TICKS((MODBUS_RTU_MAX_ADU_SIZE * MODBUS_RTU_CHAR_US) / 1000u + 10u);
+                continue;
+            }
+            return 0;
+        }
+
+        /* A timeout with nothing new is the end of the echo of the request,
+         * on transceivers which do not disable their receiver */
+        ulEnd = ulRxEnd;
+        if (ulEnd != ulStart)
+        {
+            break;
+        }
+    }
+
+    xReceived = (ulEnd + MODBUS_RTU_RX_DMA_SIZE - ulStart) % MODBUS_RTU_RX_DMA_SIZE;
+    if (xReceived > MODBUS_RTU_MAX_ADU_SIZE)
+    {
+        /* Too long for a frame: noise. Reported as a bad frame */
+        return MODBUS_RTU_MAX_ADU_SIZE + 1u;
+    }
+
+    SCB_InvalidateDCache_by_Addr(ucRxDma, (int32_t) sizeof(ucRxDma));
+    n = MIN(xReceived, MODBUS_RTU_RX_DMA_SIZE - ulStart);
+    memcpy(ucRxAdu, &ucRxDma[ulStart], n);
+    memcpy(&ucRxAdu[n], ucRxDma, xReceived - n);
+
+    return xReceived;
+}
+
+/*-------------------------------------------------------------------------*/
+/* Bus task                                                                */
+/*-------------------------------------------------------------------------*/
+
+static void prvEnqueue(ModbusGwRequest_t *pxRequest)
+{
+    ModbusGwSlave_t *pxSlave = &xSlaves[pxRequest->ucUnit];
+    uint8_t ucIndex = (uint8_t) (pxRequest - xRequests);
+
+    pxRequest->ucNext = MODBUS_RTU_NONE;
+    if (pxSlave->ucHead == MODBUS_RTU_NONE)
+    {
+        pxSlave->ucHead = ucIndex;
+    }
+    else
+    {
+        xRequests[pxSlave->ucTail].ucNext = ucIndex;
+    }
+    pxSlave->ucTail = ucIndex;
+}
+
+/* The first request of the next slave with requests, after the last served */
+static ModbusGwRequest_t *prvDequeue(void)
+{
+    ModbusGwRequest_t *pxRequest;
+    ModbusGwSlave_t *pxSlave;
+    uint_t uSlave = uLastSlave;
+    uint_t i;
+
+    for (i = 0; i < MODBUS_RTU_MAX_SLAVE; i++)
+    {
+        uSlave = (uSlave >= MODBUS_RTU_MAX_SLAVE) ? 1u : uSlave + 1u;
+        pxSlave = &xSlaves[uSlave];
+
+        if (pxSlave->ucHead != MODBUS_RTU_NONE)
+        {
+            pxRequest = &xRequests[pxSlave->ucHead];
+            pxSlave->ucHead = pxRequest->ucNext;
+            uLastSlave = uSlave;
+            return pxRequest;
+        }
+    }
+
+    return NULL;
+}
+
+static void prvSetException(ModbusGwRequest_t *pxRequest, uint8_t ucException)
+{
+    pxRequest->ucPdu[0] = pxRequest->ucFunction | MODBUS_EXCEPTION_MASK;
+    pxRequest->ucPdu[1] = ucException;
+    pxRequest->xLength = 2u;
+}
+
+static BaseType_t prvCheckResponse(size_t xLength, uint8_t ucUnit, uint8_t ucFunction)
+{
+    if (xLength < MODBUS_RTU_MIN_RESPONSE_SIZE || xLength > MODBUS_RTU_MAX_ADU_SIZE)
+    {
+        return pdFALSE;
+    }
+
+    /* The CRC of a frame, its own CRC included, is 0 */
+    return (prvCrc(ucRxAdu, xLength) == 0 && ucRxAdu[0] == ucUnit &&
+            (ucRxAdu[1] & MODBUS_FUNCTION_CODE_MASK) == ucFunction) ? pdTRUE : pdFALSE;
+}
+
+/* Replace the request PDU with the response PDU */
+static void prvServe(ModbusGwRequest_t *pxRequest)
+{
+    ModbusGwSlave_t *pxSlave = &xSlaves[pxRequest->ucUnit];
+    uint64_t ullStartUs;
+    uint32_t ulBusUs;
+    uint16_t usCrc;
+    size_t xLength;
+    size_t xReceived;
+    UBaseType_t uxAttempt;
+
+    if (pxSlave->ucFailures >= MODBUS_RTU_GATEWAY_MAX_FAILURES &&
+        timeCompare(osGetSystemTime(), pxSlave->xRetryTime) < 0)
+    {
+        xStats.ulOffline++;
+        prvSetException(pxRequest, MODBUS_EXCEPTION_GATEWAY_NO_RESPONSE_FROM_TARGET);
+        return;
+    }
+
+    ucTxAdu[0] = pxRequest->ucUnit;
+    memcpy(&ucTxAdu[1], pxRequest->ucPdu, pxRequest->xLength);
+    xLength = 1u + pxRequest->xLength;
+    usCrc = prvCrc(ucTxAdu, xLength);
+    ucTxAdu[xLength++] = (uint8_t) (usCrc & 0xFFu);
+    ucTxAdu[xLength++] = (uint8_t) (usCrc >> 8);
+
+    for (uxAttempt = 0; uxAttempt < MODBUS_RTU_GATEWAY_ATTEMPTS; uxAttempt++)
+    {
+        xStats.ulTransactions++;
+
+        ullStartUs = ullMonoClockNowUs();
+        xReceived = prvTransact(xLength);
+        ulBusUs = (uint32_t) (ullMonoClockNowUs() - ullStartUs);
+
+        xStats.ullTotalBusUs += ulBusUs;
+        if (ulBusUs > xStats.ulMaxBusUs)
+        {
+            xStats.ulMaxBusUs = ulBusUs;
+        }
+
+        if (xReceived == 0)
+        {
+            xStats.ulTimeouts++;
+        }
+        else if (prvCheckResponse(xReceived, pxRequest->ucUnit, pxRequest->ucFunction) == pdFALSE)
+        {
+            xStats.ulBadFrames++;
+        }
+        else
+        {
+            pxRequest->xLength = xReceived - 3u;
+            memcpy(pxRequest->ucPdu, &ucRxAdu[1], pxRequest->xLength);
+            if ((pxRequest->ucPdu[0] & MODBUS_EXCEPTION_MASK) != 0)
+            {
+                xStats.ulExceptions++;
+            }
+
+            pxSlave->ucFailures = 0;
+            return;
+        }
+    }
+
+    if (pxSlave->ucFailures < MODBUS_RTU_GATEWAY_MAX_FAILURES)
+    {
+        pxSlave->ucFailures++;
+    }
+    if (pxSlave->ucFailures >= MODBUS_RTU_GATEWAY_MAX_FAILURES)
+    {
+        pxSlave->xRetryTime = osGetSystemTime() + MODBUS_RTU_GATEWAY_RETRY_MS;
+    }
+
+    prvSetException(pxRequest, MODBUS_EXCEPTION_GATEWAY_NO_RESPONSE_FROM_TARGET);
+}
+
+static void prvBusTask(void *pvParameters)
+{
+    ModbusGwRequest_t *pxRequest;
+    UBaseType_t uxQueued = 0;
+    uint_t i;
+
+    (void) pvParameters;
+
+    for (i = 0; i <= MODBUS_RTU_MAX_SLAVE; i++)
+    {
+        xSlaves[i].ucHead = MODBUS_RTU_NONE;
+    }
+
+    for (;;)
+    {
+        /* Sleep while no slave has a request; take all the new ones before
+         * choosing, so that the turn of the slaves is kept */
+        while (xQueueReceive(xRequestQueue, &pxRequest, (uxQueued == 0) ? portMAX_DELAY : 0) == pdPASS)
+        {
+            prvEnqueue(pxRequest);
+            uxQueued++;
+        }
+
+        pxRequest = prvDequeue();
+        if (pxRequest == NULL)
+        {
+            uxQueued = 0;
+            continue;
+        }
+        uxQueued--;
+
+        prvServe(pxRequest);
+
+        /* Never full: it holds at most every request */
+        (void) xQueueSend(xDoneQueue, &pxRequest, portMAX_DELAY);
+        osSetEvent(&xGatewayEvent);
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/* Connection task                                                         */
+/*-------------------------------------------------------------------------*/
+
+static ModbusGwCacheEntry_t *prvCacheFind(uint8_t ucUnit, uint8_t ucFunction, uint16_t usAddress, uint16_t usCount)
+{
+    systime_t xNow = osGetSystemTime();
+    UBaseType_t i;
+
+    for (i = 0; i < MODBUS_RTU_GATEWAY_CACHE_ENTRIES; i++)
+    {
+        if (xCache[i].ucUnit == ucUnit && xCache[i].ucFunction == ucFunction && xCache[i].usAddress == usAddress &&
+            xCache[i].usCount == usCount && xNow - xCache[i].xTime < MODBUS_RTU_GATEWAY_CACHE_MS)
+        {
+            return &xCache[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Keep a read response: in the entry of the same range, or else a free one,
+ * or else the oldest */
+static void prvCacheStore(const ModbusGwRequest_t *pxRequest)
+{
+    ModbusGwCacheEntry_t *pxEntry = NULL;
+    UBaseType_t i;
+
+    if (MODBUS_RTU_GATEWAY_CACHE_MS == 0)
+    {
+        return;
+    }
+
+    for (i = 0; i < MODBUS_RTU_GATEWAY_CACHE_ENTRIES; i++)
+    {
+        if (xCache[i].ucUnit == pxRequest->ucUnit && xCache[i].ucFunction == pxRequest->ucFunction &&
+            xCache[i].usAddress == pxRequest->usAddress && xCache[i].usCount == pxRequest->usCount)
+        {
+            pxEntry = &xCache[i];
+            break;
+        }
+        if (pxEntry == NULL || (pxEntry->ucUnit != 0 &&
+            (xCache[i].ucUnit == 0 || timeCompare(xCache[i].xTime, pxEntry->xTime) < 0)))
+        {
+            pxEntry = &xCache[i];
+        }
+    }
+
+    pxEntry->ucUnit = pxRequest->ucUnit;
+    pxEntry->ucFunction = pxRequest->ucFunction;
+    pxEntry->usAddress = pxRequest->usAddress;
+    pxEntry->usCount = pxRequest->usCount;
+    pxEntry->ucLength = (uint8_t) pxRequest->xLength;
+    pxEntry->xTime = osGetSystemTime();
+    memcpy(pxEntry->ucPdu, pxRequest->ucPdu, pxRequest->xLength);
+}
+
+static void prvCacheFlush(uint8_t ucUnit)
+{
+    UBaseType_t i;
+
+    for (i = 0; i < MODBUS_RTU_GATEWAY_CACHE_ENTRIES; i++)
+    {
+        if (xCache[i].ucUnit == ucUnit)
+        {
+            xCache[i].ucUnit = 0;
+        }
+    }
+}
+
+static BaseType_t prvSendResponse(ModbusTcpConnection_t *pxConnection, uint16_t usTransaction, uint8_t ucUnit,
+                                  const uint8_t *pucPdu, size_t xLength)
+{
+    vModbusTcpWriteMbap(ucResponse, usTransaction, ucUnit, xLength);
+    memcpy(&ucResponse[MODBUS_MBAP_SIZE], pucPdu, xLength);
+
+    return (socketSend(pxConnection->pxSocket, ucResponse, MODBUS_MBAP_SIZE + xLength, NULL,
+                       SOCKET_FLAG_NO_DELAY) == NO_ERROR) ? pdTRUE : pdFALSE;
+}
+
+/* A response from the bus task */
+static void prvComplete(ModbusGwRequest_t *pxRequest)
+{
+    ModbusTcpConnection_t *pxConnection = &xConnections[pxRequest->ucConnection];
+    uint32_t ulTurnaroundUs;
+
+    if (prvIsRead(pxRequest->ucFunction) == pdFALSE)
+    {
+        /* Whatever the function did, the slave may have changed */
+        ucWritesPending[pxRequest->ucUnit]--;
+        prvCacheFlush(pxRequest->ucUnit);
+    }
+    else if (ucWritesPending[pxRequest->ucUnit] == 0 && (pxRequest->ucPdu[0] & MODBUS_EXCEPTION_MASK) == 0)
+    {
+        prvCacheStore(pxRequest);
+    }
+
+    ulTurnaroundUs = (uint32_t) (ullMonoClockNowUs() - pxRequest->ullRxUs);
+    xStats.ullTotalTurnaroundUs += ulTurnaroundUs;
+    if (ulTurnaroundUs > xStats.ulMaxTurnaroundUs)
+    {
+        xStats.ulMaxTurnaroundUs = ulTurnaroundUs;
+    }
+
+    if (pxConnection->pxSocket != NULL && pxConnection->usGeneration == pxRequest->usGeneration)
+    {
+        if (prvSendResponse(pxConnection, pxRequest->usTransaction, pxRequest->ucUnit, pxRequest->ucPdu,
+                            pxRequest->xLength) == pdFALSE)
+        {
+            vModbusTcpClose(pxConnection);
+        }
+    }
+    else
+    {
+        xStats.ulStale++;
+    }
+
+    pxRequest->xInUse = pdFALSE;
+    uxFreeRequests++;
+}
+
+/* Forward one request, or answer it from the cache or with an exception;
+ * left in the buffer while every request is queued */
+static ModbusTcpResult_t prvHandleRequest(ModbusTcpConnection_t *pxConnection, const uint8_t *pucFrame,
+                                          size_t xPduLength, BaseType_t xMore)
+{
+    ModbusGwCacheEntry_t *pxEntry;
+    ModbusGwRequest_t *pxRequest;
+    const uint8_t *pucPdu = &pucFrame[MODBUS_MBAP_SIZE];
+    uint16_t usTransaction = MODBUS_READ16(pucFrame);
+    uint8_t ucUnit = pucFrame[6];
+    uint8_t ucException[2];
+    UBaseType_t i;
+
+    (void) xMore;
+
+    if (uxFreeRequests == 0)
+    {
+        return eModbusTcpLater;
+    }
+
+    xStats.ulRequests++;
+
+    /* No broadcast: it has no response to return */
+    if (ucUnit == 0 || ucUnit > MODBUS_RTU_MAX_SLAVE)
+    {
+        ucException[0] = pucPdu[0] | MODBUS_EXCEPTION_MASK;
+        ucException[1] = MODBUS_EXCEPTION_GATEWAY_PATH_UNAVAILABLE;
+        return (prvSendResponse(pxConnection, usTransaction, ucUnit, ucException, sizeof(ucException)) != pdFALSE) ?
+               eModbusTcpTaken : eModbusTcpDrop;
+    }
+
+    if (prvIsRead(pucPdu[0]) != pdFALSE && xPduLength == 5u && ucWritesPending[ucUnit] == 0 &&
+        MODBUS_RTU_GATEWAY_CACHE_MS > 0)
+    {
+        pxEntry = prvCacheFind(ucUnit, pucPdu[0], MODBUS_READ16(&pucPdu[1]), MODBUS_READ16(&pucPdu[3]));
+        if (pxEntry != NULL)
+        {
+            xStats.ulCacheHits++;
+            return (prvSendResponse(pxConnection, usTransaction, ucUnit, pxEntry->ucPdu, pxEntry->ucLength) != pdFALSE) ?
+                   eModbusTcpTaken : eModbusTcpDrop;
+        }
+    }
+
+    /* One is free */
+    for (i = 0; xRequests[i].xInUse != pdFALSE; i++)
+    {
+    }
+    pxRequest = &xRequests[i];
+
+    pxRequest->xInUse = pdTRUE;
+    pxRequest->ucConnection = (uint8_t) (pxConnection - xConnections);
+    pxRequest->usGeneration = pxConnection->usGeneration;
+    pxRequest->usTransaction = usTransaction;
+    pxRequest->ucUnit = ucUnit;
+    pxRequest->ucFunction = pucPdu[0];
+    pxRequest->usAddress = (xPduLength >= 5u) ? MODBUS_READ16(&pucPdu[1]) : 0;
+    pxRequest->usCount = (xPduLength >= 5u) ? MODBUS_READ16(&pucPdu[3]) : 0;
+    pxRequest->ullRxUs = pxConnection->ullRxUs;
+    pxRequest->xLength = xPduLength;
+    memcpy(pxRequest->ucPdu, pucPdu, xPduLength);
+
+    if (prvIsRead(pxRequest->ucFunction) == pdFALSE)
+    {
+        ucWritesPending[ucUnit]++;
+    }
+
+    uxFreeRequests--;
+    xStats.ulForwarded++;
+
+    /* Never full: it holds at most every request */
+    (void) xQueueSend(xRequestQueue, &pxRequest, portMAX_DELAY);
+
+    return eModbusTcpTaken;
+}
+
+static void prvModbusGwTask(void *pvParameters)
+{
+    SocketEventDesc xEvents[1 + MODBUS_RTU_GATEWAY_MAX_CONNECTIONS];
+    ModbusTcpConnection_t *pxOwners[1 + MODBUS_RTU_GATEWAY_MAX_CONNECTIONS];
+    ModbusGwRequest_t *pxRequest;
+    UBaseType_t uxCount;
+    UBaseType_t i;
+
+    (void) pvParameters;
+
+    if (xModbusTcpListen(&xServer, MODBUS_RTU_GATEWAY_PORT) != pdPASS)
+    {
+        vTaskDelete(NULL);
+        return;
+    }
+
+    for (;;)
+    {
+        /* Responses first: they free the requests the buffered data waits for */
+        while (xQueueReceive(xDoneQueue, &pxRequest, 0) == pdPASS)
+        {
+            prvComplete(pxRequest);
+        }
+
+        for (i = 0; i < MODBUS_RTU_GATEWAY_MAX_CONNECTIONS; i++)
+        {
+            if (xConnections[i].pxSocket != NULL && xConnections[i].xRxUsed >= MODBUS_MBAP_SIZE)
+            {
+                vModbusTcpProcess(&xServer, &xConnections[i]);
+            }
+        }
+
+        /* While every request is queued, the masters are left to TCP flow
+         * control. Woken by the bus task for each response; once a second
+         * at least, for the idle timeout */
+        uxCount = uxModbusTcpPollSet(&xServer, xEvents, pxOwners, (uxFreeRequests > 0) ? pdTRUE : pdFALSE);
+        if (socketPoll(xEvents, uxCount, &xGatewayEvent, 1000) == NO_ERROR)
+        {
+            vModbusTcpPollDone(&xServer, xEvents, pxOwners, uxCount);
+        }
+
+        vModbusTcpCloseIdle(&xServer);
+    }
+}
+
+BaseType_t xModbusRtuGatewayStart(UBaseType_t uxPriority)
+{
+    prvCrcInit();
+
+    xServer.pxConnections = xConnections;
+    xServer.uxMaxConnections = MODBUS_RTU_GATEWAY_MAX_CONNECTIONS;
+    xServer.xIdleTimeoutMs = MODBUS_RTU_GATEWAY_IDLE_TIMEOUT_MS;
+    xServer.xSendTimeoutMs = MODBUS_RTU_GATEWAY_SEND_TIMEOUT_MS;
+    xServer.pxHandler = prvHandleRequest;
+
+    xRequestQueue = xAppQueueCreate(xRequestQueue, MODBUS_RTU_GATEWAY_MAX_REQUESTS, sizeof(ModbusGwRequest_t *));
+    xDoneQueue = xAppQueueCreate(xDoneQueue, MODBUS_RTU_GATEWAY_MAX_REQUESTS, sizeof(ModbusGwRequest_t *));
+    if (xRequestQueue == NULL || xDoneQueue == NULL || !osCreateEvent(&xGatewayEvent))
+    {
+        return pdFAIL;
+    }
+
+    /* The interrupts notify the bus task: it exists before they are enabled */
+    if (xAppTaskCreate(xBusTask,
+                       prvBusTask,
+                       "ModbusRTU",
+                       MODBUS_RTU_GATEWAY_TASK_STACK_SIZE,
+                       NULL,
+                       uxPriority + 1u,
+                       &xBusTask) != pdPASS)
+    {
+        return pdFAIL;
+    }
+
+    if (prvLineInit() != pdPASS)
+    {
+        return pdFAIL;
+    }
+
+    return xAppTaskCreate(xModbusGwTask,
+                          prvModbusGwTask,
+                          "ModbusGW",
+                          MODBUS_RTU_GATEWAY_TASK_STACK_SIZE,
+                          NULL,
+                          uxPriority,
+                          NULL);
+}
+
+void vModbusRtuGatewayGetStats(ModbusRtuGatewayStats_t *pxStats)
+{
+    *pxStats = xStats;
+}
+
+static BaseType_t prvModbusGwCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    static BaseType_t xSecondLine = pdFALSE;
+    static ModbusRtuGatewayStats_t xSnapshot;
+
+    (void) pcCommandString;
+
+    if (xSecondLine == pdFALSE)
+    {
+        vModbusRtuGatewayGetStats(&xSnapshot);
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "requests %lu cache-hits %lu forwarded %lu sent %lu timeouts %lu bad %lu exceptions %lu\r\n",
+                 (unsigned long) xSnapshot.ulRequests, (unsigned long) xSnapshot.ulCacheHits,
+                 (unsigned long) xSnapshot.ulForwarded, (unsigned long) xSnapshot.ulTransactions,
+                 (unsigned long) xSnapshot.ulTimeouts, (unsigned long) xSnapshot.ulBadFrames,
+                 (unsigned long) xSnapshot.ulExceptions);
+        xSecondLine = pdTRUE;
+        return pdTRUE;
+    }
+
+    snprintf(pcWriteBuffer, xWriteBufferLen,
+             "offline %lu stale %lu line-errors %lu framing %lu bus avg/max %lu/%lu us turnaround avg/max %lu/%lu us\r\n",
+             (unsigned long) xSnapshot.ulOffline, (unsigned long) xSnapshot.ulStale,
+             (unsigned long) xSnapshot.ulLineErrors, (unsigned long) xServer.ulFramingErrors,
+             (unsigned long) ((xSnapshot.ulTransactions > 0) ? xSnapshot.ullTotalBusUs / xSnapshot.ulTransactions : 0),
+             (unsigned long) xSnapshot.ulMaxBusUs,
+             (unsigned long) ((xSnapshot.ulForwarded > 0) ? xSnapshot.ullTotalTurnaroundUs / xSnapshot.ulForwarded : 0),
+             (unsigned long) xSnapshot.ulMaxTurnaroundUs);
+    xSecondLine = pdFALSE;
+    return pdFALSE;
+}
+
+void vModbusRtuGatewayRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xModbusGw);
+}
@@ -0,0 +1,569 @@
+/* ModbusServer.c
+ *
+ * Request handling, register map and latency accounting of the Modbus/TCP
+ * server (see ModbusServer.h); the connections are those of ModbusTcp.c.
+ * The connection table and the counters belong to the server task; the
+ * register map is shared with the application through its two copies and
+ * sequence number.
+ */
+#include "ModbusServer.h"
+#include "ModbusTcp.h"
+#include "MonoClock.h"
+#include "StaticAlloc.h"
+#include "task.h"
+#include "semphr.h"
+#include "FreeRTOS_CLI.h"
+#include "stm32h7xx_hal.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Functions with latency counters of their own; the others share the last */
+#define MODBUS_TRACKED_FUNCTIONS       8u
+#define MODBUS_LATENCY_BUCKETS         4u
+
+/* Time from the reception of a request to the sending of its response */
+typedef struct
+{
+    uint32_t ulRequests;
+    uint32_t ulExceptions;
+    uint64_t ullTotalUs;
+    uint32_t ulMaxUs;
+    uint32_t ulBuckets[MODBUS_LATENCY_BUCKETS];     /* < 100 us, < 1 ms, < 10 ms, more */
+} ModbusLatency_t;
+
+static const uint8_t ucTrackedFunctions[MODBUS_TRACKED_FUNCTIONS] =
+{
+    MODBUS_FUNCTION_READ_COILS,
+    MODBUS_FUNCTION_READ_DISCRETE_INPUTS,
+    MODBUS_FUNCTION_READ_HOLDING_REGS,
+    MODBUS_FUNCTION_READ_INPUT_REGS,
+    MODBUS_FUNCTION_WRITE_SINGLE_COIL,
+    MODBUS_FUNCTION_WRITE_SINGLE_REG,
+    MODBUS_FUNCTION_WRITE_MULTIPLE_COILS,
+    MODBUS_FUNCTION_WRITE_MULTIPLE_REGS
+};
+
+static const uint32_t ulBucketLimitsUs[MODBUS_LATENCY_BUCKETS - 1u] = { 100u, 1000u, 10000u };
+
+/* Register map: the copy served is the one of the sequence number parity */
+static ModbusRegisterMap_t xMaps[2];
+static volatile uint32_t ulMapSeq = 0;
+static SemaphoreHandle_t xUpdateMutex = NULL;
+static ModbusWriteCallback_t pxWriteCallback = NULL;
+
+/* Owned by the server task */
+static ModbusTcpConnection_t xConnections[MODBUS_SERVER_MAX_CONNECTIONS];
+static uint8_t ucResponse[MODBUS_MAX_ADU_SIZE];
+static ModbusLatency_t xLatency[MODBUS_TRACKED_FUNCTIONS + 1u];
+static ModbusTcpServer_t xServer;
+static volatile BaseType_t xResetCounters = pdFALSE;
+
+APP_TASK_STORAGE(xModbusTask, MODBUS_SERVER_TASK_STACK_SIZE);
+APP_MUTEX_STORAGE(xUpdateMutex);
+
+static BaseType_t prvModbusCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xModbus =
+{
+    "modbus",
+    "\r\nmodbus [reset]:\r\n Modbus/TCP connections and latency per function code\r\n",
+    prvModbusCommand,
+    -1
+};
+
+ModbusRegisterMap_t *pxModbusServerBeginUpdate(void)
+{
+    ModbusRegisterMap_t *pxNext;
+    uint32_t ulSeq;
+
+    xSemaphoreTake(xUpdateMutex, portMAX_DELAY);
+
+    /* Only updaters write the maps, and they hold the mutex */
+    ulSeq = ulMapSeq;
+    pxNext = &xMaps[(ulSeq + 1u) & 1u];
+    *pxNext = xMaps[ulSeq & 1u];
+
+    return pxNext;
+}
+
+void vModbusServerCommitUpdate(void)
+{
+    /* The copy must be complete before readers are sent to it */
+    __DMB();
+    ulMapSeq = ulMapSeq + 1u;
+
+    xSemaphoreGive(xUpdateMutex);
+}
+
+/* Bytes of the served map, copied again if a publication overlapped */
+static void prvSnapshotRead(size_t xOffset, void *pvData, size_t xLength)
+{
+    uint32_t ulSeq;
+
+    do
+    {
+        ulSeq = ulMapSeq;
+        __DMB();
+        memcpy(pvData, (const uint8_t *) &xMaps[ulSeq & 1u] + xOffset, xLength);
+        __DMB();
+    } while (ulSeq != ulMapSeq);
+}
+
+void vModbusServerReadMap(ModbusRegisterMap_t *pxMap)
+{
+    prvSnapshotRead(0, pxMap, sizeof(*pxMap));
+}
+
+void vModbusServerSetWriteCallback(ModbusWriteCallback_t pxCallback)
+{
+    pxWriteCallback = pxCallback;
+}
+
+static void prvNotifyWrite(uint8_t ucFunction, uint16_t usAddress, uint16_t usCount)
+{
+    ModbusWriteCallback_t pxCallback = pxWriteCallback;
+
+    if (pxCallback != NULL)
+    {
+        pxCallback(ucFunction, usAddress, usCount);
+    }
+}
+
+/* Functions 1 and 2 */
+static uint8_t prvReadBits(const uint8_t *pucRequest, size_t xLength, size_t xTable, uint32_t ulTableSize,
+                           uint8_t *pucResponse, size_t *pxResponseLength)
+{
+    uint8_t ucBits[(MAX(MODBUS_SERVER_COILS, MODBUS_SERVER_DISCRETE_INPUTS) + 7u) / 8u];
+    uint16_t usAddress;
+    uint16_t usCount;
+    size_t xFirst;
+    size_t xByteCount;
+    size_t i;
+
+    if (xLength != 5u)
+    {
+        return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+    }
+
+    usAddress = MODBUS_READ16(&pucRequest[1]);
+    usCount = MODBUS_READ16(&pucRequest[3]);
+    if (usCount == 0 || usCount > MODBUS_MAX_READ_BITS)
+    {
+        return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+    }
+    if ((uint32_t) usAddress + usCount > ulTableSize)
+    {
+        return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+    }
+
+    /* Copy the bytes holding the bits requested, then realign them */
+    xFirst = usAddress / 8u;
+    prvSnapshotRead(xTable + xFirst, ucBits, (usAddress + usCount - 1u) / 8u - xFirst + 1u);
+
+    xByteCount = (usCount + 7u) / 8u;
+    pucResponse[1] = (uint8_t) xByteCount;
+    memset(&pucResponse[2], 0, xByteCount);
+
+    for (i = 0; i < usCount; i++)
+    {
+        if (MODBUS_TEST_COIL(ucBits, usAddress - xFirst * 8u + i))
+        {
+            MODBUS_SET_COIL(&pucResponse[2], i);
+        }
+    }
+
+    *pxResponseLength = 2u + xByteCount;
+    return 0;
+}
+
+/* Functions 3 and 4 */
+static uint8_t prvReadRegs(const uint8_t *pucRequest, size_t xLength, size_t xTable, uint32_t ulTableSize,
+                           uint8_t *pucResponse, size_t *pxResponseLength)
+{
+    uint16_t usRegs[MODBUS_MAX_READ_REGS];
+    uint16_t usAddress;
+    uint16_t usCount;
+    size_t i;
+
+    if (xLength != 5u)
+    {
+        return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+    }
+
+    usAddress = MODBUS_READ16(&pucRequest[1]);
+    usCount = MODBUS_READ16(&pucRequest[3]);
+    if (usCount == 0 || usCount > MODBUS_MAX_READ_REGS)
+    {
+        return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+    }
+    if ((uint32_t) usAddress + usCount > ulTableSize)
+    {
+        return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+    }
+
+    prvSnapshotRead(xTable + usAddress * sizeof(uint16_t), usRegs, usCount * sizeof(uint16_t));
+
+    pucResponse[1] = (uint8_t) (usCount * 2u);
+    for (i = 0; i < usCount; i++)
+    {
+        pucResponse[2u + 2u * i] = (uint8_t) (usRegs[i] >> 8);
+        pucResponse[3u + 2u * i] = (uint8_t) (usRegs[i] & 0xFFu);
+    }
+
+    *pxResponseLength = 2u + usCount * 2u;
+    return 0;
+}
+
+/* Functions 5 and 6; the response echoes the request */
+static uint8_t prvWriteSingle(const uint8_t *pucRequest, size_t xLength, uint8_t *pucResponse,
+                              size_t *pxResponseLength)
+{
+    ModbusRegisterMap_t *pxMap;
+    uint16_t usAddress;
+    uint16_t usValue;
+
+    if (xLength != 5u)
+    {
+        return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+    }
+
+    usAddress = MODBUS_READ16(&pucRequest[1]);
+    usValue = MODBUS_READ16(&pucRequest[3]);
+
+    if (pucRequest[0] == MODBUS_FUNCTION_WRITE_SINGLE_COIL)
+    {
+        if (usValue != MODBUS_COIL_STATE_ON && usValue != MODBUS_COIL_STATE_OFF)
+        {
+            return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+        }
+        if (usAddress >= MODBUS_SERVER_COILS)
+        {
+            return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+        }
+
+        pxMap = pxModbusServerBeginUpdate();
+        if (usValue == MODBUS_COIL_STATE_ON)
+        {
+            MODBUS_SET_COIL(pxMap->ucCoils, usAddress);
+        }
+        else
+        {
+            MODBUS_RESET_COIL(pxMap->ucCoils, usAddress);
+        }
+        vModbusServerCommitUpdate();
+    }
+    else
+    {
+        if (usAddress >= MODBUS_SERVER_HOLDING_REGS)
+        {
+            return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+        }
+
+        pxMap = pxModbusServerBeginUpdate();
+        pxMap->usHoldingRegs[usAddress] = usValue;
+        vModbusServerCommitUpdate();
+    }
+
+    prvNotifyWrite(pucRequest[0], usAddress, 1);
+
+    memcpy(&pucResponse[1], &pucRequest[1], 4);
+    *pxResponseLength = 5u;
+    return 0;
+}
+
+/* Functions 15 and 16 */
+static uint8_t prvWriteMultiple(const uint8_t *pucRequest, size_t xLength, uint8_t *pucResponse,
+                                size_t *pxResponseLength)
+{
+    const BaseType_t xCoils = (pucRequest[0] == MODBUS_FUNCTION_WRITE_MULTIPLE_COILS) ? pdTRUE : pdFALSE;
+    ModbusRegisterMap_t *pxMap;
+    uint16_t usAddress;
+    uint16_t usCount;
+    size_t xByteCount;
+    size_t i;
+
+    if (xLength < 6u)
+    {
+        return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+    }
+
+    usAddress = MODBUS_READ16(&pucRequest[1]);
+    usCount = MODBUS_READ16(&pucRequest[3]);
+    xByteCount = (xCoils != pdFALSE) ? (usCount + 7u) / 8u : usCount * 2u;
+
+    if (usCount == 0 || usCount > ((xCoils != pdFALSE) ? MODBUS_MAX_WRITE_BITS : MODBUS_MAX_WRITE_REGS) ||
+        pucRequest[5] != xByteCount || xLength != 6u + xByteCount)
+    {
+        return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+    }
+    if ((uint32_t) usAddress + usCount > ((xCoils != pdFALSE) ? MODBUS_SERVER_COILS : MODBUS_SERVER_HOLDING_REGS))
+    {
+        return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+    }
+
+    pxMap = pxModbusServerBeginUpdate();
+    for (i = 0; i < usCount; i++)
+    {
+        if (xCoils == pdFALSE)
+        {
+            pxMap->usHoldingRegs[usAddress + i] = MODBUS_READ16(&pucRequest[6u + 2u * i]);
+        }
+        else if (MODBUS_TEST_COIL((&pucRequest[6]), i))
+        {
+            MODBUS_SET_COIL(pxMap->ucCoils, usAddress + i);
+        }
+        else
+        {
+            MODBUS_RESET_COIL(pxMap->ucCoils, usAddress + i);
+        }
+    }
+    vModbusServerCommitUpdate();
+
+    prvNotifyWrite(pucRequest[0], usAddress, usCount);
+
+    memcpy(&pucResponse[1], &pucRequest[1], 4);
+    *pxResponseLength = 5u;
+    return 0;
+}
+
+/* Answer a request PDU; returns the length of the response PDU */
+static size_t prvHandlePdu(const uint8_t *pucRequest, size_t xLength, uint8_t *pucResponse)
+{
+    size_t xResponseLength = 0;
+    uint8_t ucException;
+
+    pucResponse[0] = pucRequest[0];
+
+    switch (pucRequest[0])
+    {
+    case MODBUS_FUNCTION_READ_COILS:
+        ucException = prvReadBits(pucRequest, xLength, offsetof(ModbusRegisterMap_t, ucCoils),
+                                  MODBUS_SERVER_COILS, pucResponse, &xResponseLength);
+        break;
+
+    case MODBUS_FUNCTION_READ_DISCRETE_INPUTS:
+        ucException = prvReadBits(pucRequest, xLength, offsetof(ModbusRegisterMap_t, ucDiscreteInputs),
+                                  MODBUS_SERVER_DISCRETE_INPUTS, pucResponse, &xResponseLength);
+        break;
+
+    case MODBUS_FUNCTION_READ_HOLDING_REGS:
+        ucException = prvReadRegs(pucRequest, xLength, offsetof(ModbusRegisterMap_t, usHoldingRegs),
+                                  MODBUS_SERVER_HOLDING_REGS, pucResponse, &xResponseLength);
+        break;
+
+    case MODBUS_FUNCTION_READ_INPUT_REGS:
+        ucException = prvReadRegs(pucRequest, xLength, offsetof(ModbusRegisterMap_t, usInputRegs),
+                                  MODBUS_SERVER_INPUT_REGS, pucResponse, &xResponseLength);
+        break;
+
+    case MODBUS_FUNCTION_WRITE_SINGLE_COIL:
+    case MODBUS_FUNCTION_WRITE_SINGLE_REG:
+        ucException = prvWriteSingle(pucRequest, xLength, pucResponse, &xResponseLength);
+        break;
+
+    case MODBUS_FUNCTION_WRITE_MULTIPLE_COILS:
+    case MODBUS_FUNCTION_WRITE_MULTIPLE_REGS:
+        ucException = prvWriteMultiple(pucRequest, xLength, pucResponse, &xResponseLength);
+        break;
+
+    default:
+        ucException = MODBUS_EXCEPTION_ILLEGAL_FUNCTION;
+        break;
+    }
+
+    if (ucException != 0)
+    {
+        pucResponse[0] = pucRequest[0] | MODBUS_EXCEPTION_MASK;
+        pucResponse[1] = ucException;
+        xResponseLength = 2u;
+    }
+
+    return xResponseLength;
+}
+
+static void prvRecordLatency(uint8_t ucFunction, BaseType_t xException, uint32_t ulLatencyUs)
+{
+    ModbusLatency_t *pxLatency;
+    UBaseType_t i;
+
+    for (i = 0; i < MODBUS_TRACKED_FUNCTIONS && ucTrackedFunctions[i] != ucFunction; i++)
+    {
+    }
+    pxLatency = &xLatency[i];
+
+    pxLatency->ulRequests++;
+    pxLatency->ullTotalUs += ulLatencyUs;
+    if (ulLatencyUs > pxLatency->ulMaxUs)
+    {
+        pxLatency->ulMaxUs = ulLatencyUs;
+    }
+    if (xException != pdFALSE)
+    {
+        pxLatency->ulExceptions++;
+    }
+
+    for (i = 0; i < MODBUS_LATENCY_BUCKETS - 1u && ulLatencyUs >= ulBucketLimitsUs[i]; i++)
+    {
+    }
+    pxLatency->ulBuckets[i]++;
+}
+
+/* Answer one request */
+static ModbusTcpResult_t prvHandleRequest(ModbusTcpConnection_t *pxConnection, const uint8_t *pucFrame,
+                                          size_t xPduLength, BaseType_t xMore)
+{
+    size_t xResponseLength;
+    uint8_t ucFunction = pucFrame[MODBUS_MBAP_SIZE];
+    error_t err;
+
+    xResponseLength = prvHandlePdu(&pucFrame[MODBUS_MBAP_SIZE], xPduLength, &ucResponse[MODBUS_MBAP_SIZE]);
+
+    /* Same transaction and unit identifiers */
+    vModbusTcpWriteMbap(ucResponse, MODBUS_READ16(pucFrame), pucFrame[6], xResponseLength);
+
+    /* Let Nagle merge the responses of pipelined requests; push out the
+       last one */
+    err = socketSend(pxConnection->pxSocket, ucResponse, MODBUS_MBAP_SIZE + xResponseLength, NULL,
+                     (xMore != pdFALSE) ? 0 : SOCKET_FLAG_NO_DELAY);
+
+    prvRecordLatency(ucFunction, ((ucResponse[MODBUS_MBAP_SIZE] & MODBUS_EXCEPTION_MASK) != 0) ? pdTRUE : pdFALSE,
+                     (uint32_t) (ullMonoClockNowUs() - pxConnection->ullRxUs));
+
+    return (err == NO_ERROR) ? eModbusTcpTaken : eModbusTcpDrop;
+}
+
+static void prvModbusServerTask(void *pvParameters)
+{
+    SocketEventDesc xEvents[1 + MODBUS_SERVER_MAX_CONNECTIONS];
+    ModbusTcpConnection_t *pxOwners[1 + MODBUS_SERVER_MAX_CONNECTIONS];
+    UBaseType_t uxCount;
+
+    (void) pvParameters;
+
+    if (xModbusTcpListen(&xServer, MODBUS_TCP_PORT) != pdPASS)
+    {
+        vTaskDelete(NULL);
+        return;
+    }
+
+    for (;;)
+    {
+        if (xResetCounters != pdFALSE)
+        {
+            xResetCounters = pdFALSE;
+            memset(xLatency, 0, sizeof(xLatency));
+            xServer.ulEvicted = 0;
+            xServer.ulIdleClosed = 0;
+            xServer.ulFramingErrors = 0;
+        }
+
+        /* Wake up once a second at least, for the idle timeout */
+        uxCount = uxModbusTcpPollSet(&xServer, xEvents, pxOwners, pdTRUE);
+        if (socketPoll(xEvents, uxCount, NULL, 1000) == NO_ERROR)
+        {
+            vModbusTcpPollDone(&xServer, xEvents, pxOwners, uxCount);
+        }
+
+        vModbusTcpCloseIdle(&xServer);
+    }
+}
+
+BaseType_t xModbusServerStart(UBaseType_t uxPriority)
+{
+    xUpdateMutex = xAppSemaphoreCreateMutex(xUpdateMutex);
+    if (xUpdateMutex == NULL)
+    {
+        return pdFAIL;
+    }
+
+    xServer.pxConnections = xConnections;
+    xServer.uxMaxConnections = MODBUS_SERVER_MAX_CONNECTIONS;
+    xServer.xIdleTimeoutMs = MODBUS_SERVER_IDLE_TIMEOUT_MS;
+    xServer.xSendTimeoutMs = MODBUS_SERVER_SEND_TIMEOUT_MS;
+    xServer.pxHandler = prvHandleRequest;
+
+    return xAppTaskCreate(xModbusTask,
+                          prvModbusServerTask,
+                          "Modbus",
+                          MODBUS_SERVER_TASK_STACK_SIZE,
+                          NULL,
+                          uxPriority,
+                          NULL);
+}
+
+static BaseType_t prvModbusCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    static UBaseType_t uxLine = 0;
+    const ModbusLatency_t *pxLatency;
+    const char *pcParameter;
+    BaseType_t xLength;
+
+    if (uxLine == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xLength);
+        if (pcParameter != NULL)
+        {
+            if (xLength == 5 && strncmp(pcParameter, "reset", 5) == 0)
+            {
+                xResetCounters = pdTRUE;
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Counters cleared\r\n");
+            }
+            else
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: modbus [reset]\r\n");
+            }
+            return pdFALSE;
+        }
+
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "connections %lu/%u, accepted=%lu evicted=%lu idle-closed=%lu framing-errors=%lu\r\n",
+                 (unsigned long) uxModbusTcpConnections(&xServer), MODBUS_SERVER_MAX_CONNECTIONS,
+                 (unsigned long) xServer.ulAccepted, (unsigned long) xServer.ulEvicted,
+                 (unsigned long) xServer.ulIdleClosed, (unsigned long) xServer.ulFramingErrors);
+        uxLine++;
+        return pdTRUE;
+    }
+
+    if (uxLine == 1u)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "fc  requests exceptions  avg-us  max-us   <100us    <1ms   <10ms  >=10ms\r\n");
+        uxLine++;
+        return pdTRUE;
+    }
+
+    /* One line per function code, the last one for the others */
+    pxLatency = &xLatency[uxLine - 2u];
+    if (uxLine - 2u < MODBUS_TRACKED_FUNCTIONS)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "%-3u", ucTrackedFunctions[uxLine - 2u]);
+    }
+    else
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "-- ");
+    }
+
+    xLength = (BaseType_t) strlen(pcWriteBuffer);
+    snprintf(&pcWriteBuffer[xLength], xWriteBufferLen - (size_t) xLength,
+             " %8lu %10lu %7lu %7lu %8lu %7lu %7lu %7lu\r\n",
+             (unsigned long) pxLatency->ulRequests, (unsigned long) pxLatency->ulExceptions,
+             (unsigned long) ((pxLatency->ulRequests > 0) ? pxLatency->ullTotalUs / pxLatency->ulRequests : 0),
+             (unsigned long) pxLatency->ulMaxUs,
+             (unsigned long) pxLatency->ulBuckets[0], (unsigned long) pxLatency->ulBuckets[1],
+             (unsigned long) pxLatency->ulBuckets[2], (unsigned long) pxLatency->ulBuckets[3]);
+
+    if (uxLine - 2u < MODBUS_TRACKED_FUNCTIONS)
+    {
+        uxLine++;
+        return pdTRUE;
+    }
+
+    uxLine = 0;
+    return pdFALSE;
+}
+
+void vModbusServerRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xModbus);
+}
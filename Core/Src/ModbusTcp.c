@@ -0,0 +1,259 @@
+/* ModbusTcp.c
+ *
+ * MBAP framing and the connection table of the Modbus/TCP server and RTU
+ * gateway (see ModbusTcp.h). Everything here runs in the task owning the
+ * ModbusTcpServer_t, which is never locked.
+ */
+#include "ModbusTcp.h"
+#include "MonoClock.h"
+#include <string.h>
+
+void vModbusTcpWriteMbap(uint8_t *pucAdu, uint16_t usTransaction, uint8_t ucUnit, size_t xPduLength)
+{
+    /* The length counts the unit identifier and the PDU */
+    pucAdu[0] = (uint8_t) (usTransaction >> 8);
+    pucAdu[1] = (uint8_t) (usTransaction & 0xFFu);
+    pucAdu[2] = (uint8_t) (MODBUS_PROTOCOL_ID >> 8);
+    pucAdu[3] = (uint8_t) (MODBUS_PROTOCOL_ID & 0xFFu);
+    pucAdu[4] = (uint8_t) ((xPduLength + 1u) >> 8);
+    pucAdu[5] = (uint8_t) ((xPduLength + 1u) & 0xFFu);
+    pucAdu[6] = ucUnit;
+}
+
+size_t xModbusTcpFrameSize(const uint8_t *pucData, size_t xAvailable, size_t xMinPdu)
+{
+    uint16_t usLength;
+
+    if (xAvailable < MODBUS_MBAP_SIZE)
+    {
+        return 0;
+    }
+
+    /* The length counts the unit identifier and the PDU */
+    usLength = MODBUS_READ16(&pucData[4]);
+    if (MODBUS_READ16(&pucData[2]) != MODBUS_PROTOCOL_ID || usLength < xMinPdu + 1u ||
+        usLength > MODBUS_MAX_PDU_SIZE + 1u)
+    {
+        return MODBUS_TCP_BAD_FRAME;
+    }
+
+    return (xAvailable < 6u + usLength) ? 0 : 6u + usLength;
+}
+
+BaseType_t xModbusTcpListen(ModbusTcpServer_t *pxServer, uint16_t usPort)
+{
+    pxServer->pxListener = socketOpen(SOCKET_TYPE_STREAM, SOCKET_IP_PROTO_TCP);
+    if (pxServer->pxListener == NULL)
+    {
+        return pdFAIL;
+    }
+
+    if (socketBind(pxServer->pxListener, &IP_ADDR_ANY, usPort) != NO_ERROR ||
+        socketListen(pxServer->pxListener, pxServer->uxMaxConnections) != NO_ERROR)
+    {
+        socketClose(pxServer->pxListener);
+        pxServer->pxListener = NULL;
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+
+void vModbusTcpClose(ModbusTcpConnection_t *pxConnection)
+{
+    socketClose(pxConnection->pxSocket);
+    pxConnection->pxSocket = NULL;
+}
+
+void vModbusTcpProcess(ModbusTcpServer_t *pxServer, ModbusTcpConnection_t *pxConnection)
+{
+    ModbusTcpResult_t eResult = eModbusTcpTaken;
+    size_t xOffset = 0;
+    size_t xFrame;
+
+    while (eResult == eModbusTcpTaken)
+    {
+        xFrame = xModbusTcpFrameSize(&pxConnection->ucRx[xOffset], pxConnection->xRxUsed - xOffset, 1u);
+        if (xFrame == 0)
+        {
+            break;
+        }
+        if (xFrame == MODBUS_TCP_BAD_FRAME)
+        {
+            pxServer->ulFramingErrors++;
+            vModbusTcpClose(pxConnection);
+            return;
+        }
+
+        eResult = pxServer->pxHandler(pxConnection, &pxConnection->ucRx[xOffset], xFrame - MODBUS_MBAP_SIZE,
+                                      (pxConnection->xRxUsed - xOffset - xFrame >= MODBUS_MBAP_SIZE) ? pdTRUE : pdFALSE);
+        if (eResult == eModbusTcpDrop)
+        {
+            vModbusTcpClose(pxConnection);
+            return;
+        }
+        if (eResult == eModbusTcpTaken)
+        {
+            xOffset += xFrame;
+        }
+    }
+
+    /* Keep the beginning of the next request, or the requests not taken */
+    memmove(pxConnection->ucRx, &pxConnection->ucRx[xOffset], pxConnection->xRxUsed - xOffset);
+    pxConnection->xRxUsed -= xOffset;
+}
+
+static void prvReceive(ModbusTcpServer_t *pxServer, ModbusTcpConnection_t *pxConnection)
+{
+    uint64_t ullRxUs = ullMonoClockNowUs();
+    size_t xReceived = 0;
+    error_t err;
+
+    err = socketReceive(pxConnection->pxSocket, &pxConnection->ucRx[pxConnection->xRxUsed],
+                        sizeof(pxConnection->ucRx) - pxConnection->xRxUsed, &xReceived, SOCKET_FLAG_DONT_WAIT);
+    if (err == ERROR_TIMEOUT)
+    {
+        return;
+    }
+    if (err != NO_ERROR || xReceived == 0)
+    {
+        /* Closed or reset */
+        vModbusTcpClose(pxConnection);
+        return;
+    }
+
+    pxConnection->xRxUsed += xReceived;
+    pxConnection->xLastActivity = osGetSystemTime();
+    pxConnection->ullRxUs = ullRxUs;
+
+    vModbusTcpProcess(pxServer, pxConnection);
+}
+
+static void prvAccept(ModbusTcpServer_t *pxServer)
+{
+    ModbusTcpConnection_t *pxConnection = NULL;
+    ModbusTcpConnection_t *pxEntry;
+    Socket *pxSocket;
+    IpAddr xPeer;
+    uint16_t usPeerPort;
+    UBaseType_t i;
+
+    pxSocket = socketAccept(pxServer->pxListener, &xPeer, &usPeerPort);
+    if (pxSocket == NULL)
+    {
+        return;
+    }
+
+    /* A free entry, or else the one idle for longest */
+    for (i = 0; i < pxServer->uxMaxConnections; i++)
+    {
+        pxEntry = &pxServer->pxConnections[i];
+        if (pxEntry->pxSocket == NULL)
+        {
+            pxConnection = pxEntry;
+            break;
+        }
+        if (pxConnection == NULL || timeCompare(pxEntry->xLastActivity, pxConnection->xLastActivity) < 0)
+        {
+            pxConnection = pxEntry;
+        }
+    }
+
+    if (pxConnection->pxSocket != NULL)
+    {
+        vModbusTcpClose(pxConnection);
+        pxServer->ulEvicted++;
+    }
+
+    socketSetTimeout(pxSocket, pxServer->xSendTimeoutMs);
+
+    /* What the owner still holds for the entry is told apart by the
+     * generation */
+    pxConnection->pxSocket = pxSocket;
+    pxConnection->xPeer = xPeer;
+    pxConnection->usPeerPort = usPeerPort;
+    pxConnection->usGeneration = ++pxServer->usGeneration;
+    pxConnection->xLastActivity = osGetSystemTime();
+    pxConnection->xRxUsed = 0;
+    pxServer->ulAccepted++;
+}
+
+UBaseType_t uxModbusTcpPollSet(ModbusTcpServer_t *pxServer, SocketEventDesc *pxEvents,
+                               ModbusTcpConnection_t **ppxOwners, BaseType_t xReceive)
+{
+    ModbusTcpConnection_t *pxConnection;
+    UBaseType_t uxCount;
+    UBaseType_t i;
+
+    pxEvents[0].socket = pxServer->pxListener;
+    pxEvents[0].eventMask = SOCKET_EVENT_ACCEPT;
+    pxEvents[0].eventFlags = 0;
+    ppxOwners[0] = NULL;
+    uxCount = 1;
+
+    for (i = 0; i < pxServer->uxMaxConnections && xReceive != pdFALSE; i++)
+    {
+        pxConnection = &pxServer->pxConnections[i];
+        if (pxConnection->pxSocket != NULL && pxConnection->xRxUsed < sizeof(pxConnection->ucRx))
+        {
+            pxEvents[uxCount].socket = pxConnection->pxSocket;
+            pxEvents[uxCount].eventMask = SOCKET_EVENT_RX_READY;
+            pxEvents[uxCount].eventFlags = 0;
+            ppxOwners[uxCount++] = pxConnection;
+        }
+    }
+
+    return uxCount;
+}
+
+void vModbusTcpPollDone(ModbusTcpServer_t *pxServer, const SocketEventDesc *pxEvents,
+                        ModbusTcpConnection_t * const *ppxOwners, UBaseType_t uxCount)
+{
+    UBaseType_t i;
+
+    /* A handler may have closed a connection polled after it */
+    for (i = 1; i < uxCount; i++)
+    {
+        if ((pxEvents[i].eventFlags & SOCKET_EVENT_RX_READY) != 0 && ppxOwners[i]->pxSocket == pxEvents[i].socket)
+        {
+            prvReceive(pxServer, ppxOwners[i]);
+        }
+    }
+
+    if ((pxEvents[0].eventFlags & SOCKET_EVENT_ACCEPT) != 0)
+    {
+        prvAccept(pxServer);
+    }
+}
+
+void vModbusTcpCloseIdle(ModbusTcpServer_t *pxServer)
+{
+    systime_t xNow = osGetSystemTime();
+    UBaseType_t i;
+
+    for (i = 0; i < pxServer->uxMaxConnections; i++)
+    {
+        if (pxServer->pxConnections[i].pxSocket != NULL &&
+            xNow - pxServer->pxConnections[i].xLastActivity >= pxServer->xIdleTimeoutMs)
+        {
+            vModbusTcpClose(&pxServer->pxConnections[i]);
+            pxServer->ulIdleClosed++;
+        }
+    }
+}
+
+UBaseType_t uxModbusTcpConnections(const ModbusTcpServer_t *pxServer)
+{
+    UBaseType_t uxCount = 0;
+    UBaseType_t i;
+
+    for (i = 0; i < pxServer->uxMaxConnections; i++)
+    {
+        if (pxServer->pxConnections[i].pxSocket != NULL)
+        {
+            uxCount++;
+        }
+    }
+
+    return uxCount;
+}
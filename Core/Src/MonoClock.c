@@ -0,0 +1,188 @@
+/* MonoClock.c
+ *
+ * 64-bit microsecond clock on TIM5, the time base of the TCP/IP stack
+ * (osGetSystemTime()), of the receive time of frames and of libudpard.
+ *
+ * TIM5 is one of the 32-bit timers of the APB1 domain: prescaled to 1 MHz
+ * it wraps every 71 minutes, and its update interrupt counts the wraps. A
+ * reader takes the wrap count, the counter, then the wrap count again, and
+ * starts over if an interrupt counted a wrap in between. A wrap whose
+ * interrupt has not run yet (the reader masks it, or preempted it) shows as
+ * the pending update flag: the counter value then tells whether it was read
+ * before or after the wrap. No interrupt masking is involved, unlike the
+ * tick counter of FreeRTOS, which also only has a 1 ms resolution.
+ *
+ * The DWT cycle counter would be finer, but it wraps every few seconds and
+ * stops in some debug configurations; RunTimeStats.c keeps using it for
+ * profiling.
+ *
+ * When the clock governor (ClockGovernor.h) changes the APB1 clock, the
+ * prescaler is derived again and the counter restarted at the time the
+ * governor measured across the change, so that the clock stays continuous.
+ *
+ * The clock is never stepped nor slewed. A synchronized timescale (the PTP
+ * time, see PtpSlave.c, or UTC from SntpClient.c) is layered on top of it as
+ * a linear map, published in one of two slots: the writer fills the slot not
+ * in use, then switches the sequence number, so that readers in any context
+ * copy a stable slot and only retry if it was rewritten meanwhile.
+ */
+#include "MonoClock.h"
+#include "stm32h7xx_hal.h"
+
+/* Linear map from the local clock onto the reference timescale */
+typedef struct
+{
+    uint64_t ullLocalUs;
+    uint64_t ullReferenceUs;
+    int32_t lRatePpb;
+    uint32_t ulValid;
+} MonoClockReference_t;
+
+/* Wraps of TIM5, only written by its update interrupt */
+static volatile uint32_t ulWraps = 0;
+
+/* Reference map, in the slot selected by the low bit of the sequence */
+static MonoClockReference_t xReferences[2];
+static volatile uint32_t ulReferenceSeq = 0;
+
+/* Clock of the timers of APB1 */
+static uint32_t prvTimerHz(void)
+{
+    uint32_t ulTimerHz = HAL_RCC_GetPCLK1Freq();
+
+    /* The timers of APB1 run at twice its clock when it is divided
+     * (RCC_CFGR.TIMPRE left at its reset value) */
+    if ((RCC->D2CFGR & RCC_D2CFGR_D2PPRE1) != RCC_D2CFGR_D2PPRE1_DIV1)
+    {
+        ulTimerHz *= 2u;
+    }
+
+    return ulTimerHz;
+}
+
+void vMonoClockInit(void)
+{
+    __HAL_RCC_TIM5_CLK_ENABLE();
+
+    /* Free running over 32 bits; URS keeps the update event loading the
+     * prescaler from counting as a wrap */
+    TIM5->CR1 = TIM_CR1_URS;
+    TIM5->PSC = prvTimerHz() / MONO_CLOCK_HZ - 1u;
+    TIM5->ARR = 0xFFFFFFFFu;
+    TIM5->CNT = 0;
+    TIM5->EGR = TIM_EGR_UG;
+    TIM5->SR = 0;
+
+    ulWraps = 0;
+
+    TIM5->DIER = TIM_DIER_UIE;
+    HAL_NVIC_SetPriority(TIM5_IRQn, MONO_CLOCK_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(TIM5_IRQn);
+
+    TIM5->CR1 |= TIM_CR1_CEN;
+}
+
+uint64_t ullMonoClockNowUs(void)
+{
+    uint32_t ulHigh;
+    uint32_t ulLow;
+    uint32_t ulCheck;
+
+    do
+    {
+        ulCheck = ulWraps;
+        ulLow = TIM5->CNT;
+        ulHigh = ulCheck;
+
+        /* Wrapped, but not counted yet: the flag alone does not tell
+         * whether the counter was read before or after the wrap, its value
+         * does, the interrupt being far less than half a period late */
+        if ((TIM5->SR & TIM_SR_UIF) != 0 && ulLow < 0x80000000u)
+        {
+            ulHigh++;
+        }
+    } while (ulCheck != ulWraps);
+
+    return ((uint64_t) ulHigh << 32) | ulLow;
+}
+
+void vMonoClockRetime(uint64_t ullNowUs)
+{
+    /* The update event loads the prescaler at once and clears the counter,
+     * without raising the flag (URS) */
+    TIM5->PSC = prvTimerHz() / MONO_CLOCK_HZ - 1u;
+    TIM5->EGR = TIM_EGR_UG;
+
+    /* A wrap left pending is part of ullNowUs */
+    TIM5->CNT = (uint32_t) ullNowUs;
+    TIM5->SR = (uint32_t) ~TIM_SR_UIF;
+    ulWraps = (uint32_t) (ullNowUs >> 32);
+}
+
+void vMonoClockIrqHandler(void)
+{
+    if ((TIM5->SR & TIM_SR_UIF) != 0)
+    {
+        TIM5->SR = (uint32_t) ~TIM_SR_UIF;
+        ulWraps++;
+    }
+}
+
+static void prvPublishReference(const MonoClockReference_t *pxReference)
+{
+    uint32_t ulPrimask = __get_PRIMASK();
+    uint32_t ulNext;
+
+    /* Writers (PTP and SNTP) must not fill the same slot at once */
+    __disable_irq();
+    ulNext = ulReferenceSeq + 1u;
+    xReferences[ulNext & 1u] = *pxReference;
+
+    /* The slot must be complete before readers are sent to it */
+    __DMB();
+    ulReferenceSeq = ulNext;
+    __set_PRIMASK(ulPrimask);
+}
+
+void vMonoClockSetReference(uint64_t ullLocalUs, uint64_t ullReferenceUs, int32_t lRatePpb)
+{
+    MonoClockReference_t xReference;
+
+    xReference.ullLocalUs = ullLocalUs;
+    xReference.ullReferenceUs = ullReferenceUs;
+    xReference.lRatePpb = lRatePpb;
+    xReference.ulValid = 1u;
+    prvPublishReference(&xReference);
+}
+
+void vMonoClockClearReference(void)
+{
+    MonoClockReference_t xReference = { 0 };
+
+    prvPublishReference(&xReference);
+}
+
+uint64_t ullMonoClockToReferenceUs(uint64_t ullLocalUs)
+{
+    MonoClockReference_t xReference;
+    uint32_t ulSeq;
+    int64_t llDeltaUs;
+
+    do
+    {
+        ulSeq = ulReferenceSeq;
+        __DMB();
+        xReference = xReferences[ulSeq & 1u];
+        __DMB();
+    } while (ulSeq != ulReferenceSeq);
+
+    if (xReference.ulValid == 0u)
+    {
+        return 0;
+    }
+
+    /* Stamps taken before the map was set give a negative delta */
+    llDeltaUs = (int64_t) (ullLocalUs - xReference.ullLocalUs);
+
+    return xReference.ullReferenceUs + (uint64_t) (llDeltaUs + llDeltaUs * xReference.lRatePpb / 1000000000);
+}
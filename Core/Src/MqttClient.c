@@ -0,0 +1,1193 @@
+/* MqttClient.c
+ *
+ * Packet encoding, send window and session of the MQTT client (see
+ * MqttClient.h). The socket, the batch and the receive buffer belong to the
+ * client task; publishers only fill a free slot and queue its index.
+ */
+#include "MqttClient.h"
+#include "StaticAlloc.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "FreeRTOS_CLI.h"
+#include "core/net.h"
+#include "core/socket.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Control packet types, in the high nibble of the first byte */
+#define MQTT_TYPE_CONNECT              1u
+#define MQTT_TYPE_CONNACK              2u
+#define MQTT_TYPE_PUBLISH              3u
+#define MQTT_TYPE_PUBACK               4u
+#define MQTT_TYPE_PUBREC               5u
+#define MQTT_TYPE_PUBREL               6u
+#define MQTT_TYPE_PUBCOMP              7u
+#define MQTT_TYPE_SUBSCRIBE            8u
+#define MQTT_TYPE_PINGREQ              12u
+#define MQTT_TYPE_DISCONNECT           14u
+
+/* First byte of the packets; PUBREL and SUBSCRIBE have the reserved bit 1 set */
+#define MQTT_HEADER(ucType, ucFlags)   ((uint8_t) (((ucType) << 4) | (ucFlags)))
+#define MQTT_FLAG_DUP                  0x08u
+
+/* Flags of CONNECT */
+#define MQTT_CONNECT_CLEAN_SESSION     0x02u
+
+/* Bytes of the payload of the bench messages */
+#define MQTT_BENCH_PAYLOAD             64u
+
+typedef enum
+{
+    eSlotFree = 0,
+    eSlotFilling,                   /* Taken by a publisher */
+    eSlotQueued,                    /* Waiting in the send queue */
+    eSlotSent,                      /* Waiting for PUBACK or PUBREC */
+    eSlotReleased                   /* PUBREL sent, waiting for PUBCOMP */
+} MqttSlotState_t;
+
+/* A message of the send window */
+typedef struct
+{
+    volatile uint8_t ucState;
+    uint8_t ucQos;
+    uint16_t usPacketId;
+    uint16_t usTopicLength;
+    uint16_t usPayloadLength;
+    uint32_t ulSequence;            /* Rank of the first sending, for resending in order */
+    uint8_t ucData[MQTT_CLIENT_MESSAGE_SIZE];   /* Topic, then payload */
+} MqttSlot_t;
+
+typedef struct
+{
+    char cFilter[MQTT_CLIENT_FILTER_SIZE];
+    uint8_t ucQos;
+    MqttMessageCallback_t pxCallback;
+} MqttSubscription_t;
+
+static MqttSlot_t xSlots[MQTT_CLIENT_WINDOW];
+static QueueHandle_t xSendQueue = NULL;         /* Indexes of the queued slots, in order */
+static SemaphoreHandle_t xFreeSlots = NULL;     /* Counts the free slots */
+
+/* Entries below the count never change once added */
+static MqttSubscription_t xSubscriptions[MQTT_CLIENT_MAX_SUBSCRIPTIONS];
+static volatile UBaseType_t uxSubscriptionCount = 0;
+static volatile BaseType_t xSubscribePending = pdFALSE;
+
+/* Broker, changed by xMqttClientConnect() */
+static char cBrokerHost[MQTT_CLIENT_HOST_SIZE];
+static uint16_t usBrokerPort = MQTT_CLIENT_PORT;
+static volatile BaseType_t xBrokerEnabled = pdFALSE;
+static volatile uint32_t ulBrokerGeneration = 0;
+static volatile BaseType_t xConnected = pdFALSE;
+
+static OsEvent xClientEvent;
+static MqttClientStats_t xClientStats;
+
+/* Session state, owned by the client task */
+static Socket *pxClientSocket = NULL;
+static error_t xSessionError = NO_ERROR;
+static int_t iConnackCode = -1;                 /* Return code of CONNACK, -1 until received */
+static uint8_t ucBatch[MQTT_CLIENT_BATCH_SIZE];
+static size_t xBatchUsed = 0;
+static uint8_t ucRxBuffer[MQTT_CLIENT_RX_SIZE];
+static size_t xRxUsed = 0;
+static uint32_t ulRxSkip = 0;                   /* Bytes left of a packet too long */
+static systime_t xLastTx = 0;
+static systime_t xLastRx = 0;
+static BaseType_t xPingSent = pdFALSE;
+static uint16_t usNextPacketId = 1;
+static uint32_t ulNextSequence = 0;
+static char cClientId[24];
+
+APP_TASK_STORAGE(xMqttTask, MQTT_CLIENT_TASK_STACK_SIZE);
+APP_QUEUE_STORAGE(xSendQueue, MQTT_CLIENT_WINDOW, sizeof(uint8_t));
+APP_MUTEX_STORAGE(xFreeSlots);
+
+static BaseType_t prvMqttCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xMqtt =
+{
+    "mqtt",
+    "\r\nmqtt [connect <host> [<port>] | off | pub <topic> <qos> <text> | bench <n> [<qos>]]:\r\n"
+    " MQTT broker, publishing, throughput\r\n",
+    prvMqttCommand,
+    -1
+};
+
+static void prvFreeSlot(MqttSlot_t *pxSlot)
+{
+    pxSlot->ucState = eSlotFree;
+    xSemaphoreGive(xFreeSlots);
+}
+
+/* Send the batch; a failure ends the session */
+static void prvFlush(void)
+{
+    error_t err;
+
+    if (xBatchUsed > 0 && xSessionError == NO_ERROR)
+    {
+        /* Nagle merges the batches sent while earlier ones are unacknowledged */
+        err = socketSend(pxClientSocket, ucBatch, xBatchUsed, NULL, 0);
+        if (err != NO_ERROR)
+        {
+            xSessionError = err;
+        }
+        xClientStats.ulBatches++;
+        xLastTx = osGetSystemTime();
+    }
+    xBatchUsed = 0;
+}
+
+/* Make room for a packet of xLength bytes at most */
+static BaseType_t prvReserve(size_t xLength)
+{
+    if (xBatchUsed + xLength > sizeof(ucBatch))
+    {
+        prvFlush();
+    }
+
+    return (xSessionError == NO_ERROR) ? pdTRUE : pdFALSE;
+}
+
+/* Remaining length field; returns its size */
+static size_t prvPutLength(uint8_t *pucData, uint32_t ulLength)
+{
+    size_t xCount = 0;
+    uint8_t ucByte;
+
+    do
+    {
+        ucByte = (uint8_t) (ulLength & 0x7Fu);
+        ulLength >>= 7;
+        if (ulLength > 0)
+        {
+            ucByte |= 0x80u;
+        }
+        pucData[xCount++] = ucByte;
+    } while (ulLength > 0);
+
+    return xCount;
+}
+
+static size_t prvPutString(uint8_t *pucData, const char *pcText, size_t xLength)
+{
+    pucData[0] = (uint8_t) (xLength >> 8);
+    pucData[1] = (uint8_t) (xLength & 0xFFu);
+    memcpy(&pucData[2], pcText, xLength);
+
+    return 2u + xLength;
+}
+
+/* PUBACK, PUBREC, PUBREL and PUBCOMP */
+static void prvAppendAck(uint8_t ucHeader, uint16_t usPacketId)
+{
+    uint8_t *pucData;
+
+    if (prvReserve(4) != pdFALSE)
+    {
+        pucData = &ucBatch[xBatchUsed];
+        pucData[0] = ucHeader;
+        pucData[1] = 2;
+        pucData[2] = (uint8_t) (usPacketId >> 8);
+        pucData[3] = (uint8_t) (usPacketId & 0xFFu);
+        xBatchUsed += 4;
+    }
+}
+
+static void prvAppendEmpty(uint8_t ucType)
+{
+    if (prvReserve(2) != pdFALSE)
+    {
+        ucBatch[xBatchUsed++] = MQTT_HEADER(ucType, 0u);
+        ucBatch[xBatchUsed++] = 0;
+    }
+}
+
+static void prvAppendPublish(const MqttSlot_t *pxSlot, uint8_t ucFlags)
+{
+    uint32_t ulRemaining;
+    uint8_t *pucData;
+    size_t xCount;
+
+    ulRemaining = 2u + pxSlot->usTopicLength + pxSlot->usPayloadLength + ((pxSlot->ucQos > 0) ? 2u : 0u);
+    if (prvReserve(5u + ulRemaining) == pdFALSE)
+    {
+        return;
+    }
+
+    pucData = &ucBatch[xBatchUsed];
+    pucData[0] = MQTT_HEADER(MQTT_TYPE_PUBLISH, ucFlags | (uint8_t) (pxSlot->ucQos << 1));
+    xCount = 1u + prvPutLength(&pucData[1], ulRemaining);
+    xCount += prvPutString(&pucData[xCount], (const char *) pxSlot->ucData, pxSlot->usTopicLength);
+
+    if (pxSlot->ucQos > 0)
+    {
+        pucData[xCount++] = (uint8_t) (pxSlot->usPacketId >> 8);
+        pucData[xCount++] = (uint8_t) (pxSlot->usPacketId & 0xFFu);
+    }
+
+    memcpy(&pucData[xCount], &pxSlot->ucData[pxSlot->usTopicLength], pxSlot->usPayloadLength);
+    xBatchUsed += xCount + pxSlot->usPayloadLength;
+}
+
+static void prvAppendConnect(void)
+{
+    size_t xIdLength = strlen(cClientId);
+    uint32_t ulRemaining = 10u + 2u + xIdLength;
+    uint8_t *pucData;
+    size_t xCount;
+
+    if (prvReserve(5u + ulRemaining) == pdFALSE)
+    {
+        return;
+    }
+
+    pucData = &ucBatch[xBatchUsed];
+    pucData[0] = MQTT_HEADER(MQTT_TYPE_CONNECT, 0u);
+    xCount = 1u + prvPutLength(&pucData[1], ulRemaining);
+
+    /* Protocol name and level 4 (3.1.1), flags, keep alive */
+    xCount += prvPutString(&pucData[xCount], "MQTT", 4);
+    pucData[xCount++] = 4;
+    pucData[xCount++] = (MQTT_CLIENT_CLEAN_SESSION == 1) ? MQTT_CONNECT_CLEAN_SESSION : 0u;
+    pucData[xCount++] = (uint8_t) (MQTT_CLIENT_KEEP_ALIVE_S >> 8);
+    pucData[xCount++] = (uint8_t) (MQTT_CLIENT_KEEP_ALIVE_S & 0xFFu);
+
+    xCount += prvPutString(&pucData[xCount], cClientId, xIdLength);
+    xBatchUsed += xCount;
+}
+
+/* One SUBSCRIBE for every filter of the table */
+static void prvAppendSubscribe(void)
+{
+    UBaseType_t uxCount = uxSubscriptionCount;
+    uint32_t ulRemaining = 2u;
+    uint8_t *pucData;
+    size_t xCount;
+    size_t xLength;
+    UBaseType_t i;
+
+    if (uxCount == 0)
+    {
+        return;
+    }
+
+    for (i = 0; i < uxCount; i++)
+    {
+        ulRemaining += 3u + strlen(xSubscriptions[i].cFilter);
+    }
+
+    if (prvReserve(5u + ulRemaining) == pdFALSE)
+    {
+        return;
+    }
+
+    pucData = &ucBatch[xBatchUsed];
+    pucData[0] = MQTT_HEADER(MQTT_TYPE_SUBSCRIBE, 0x02u);
+    xCount = 1u + prvPutLength(&pucData[1], ulRemaining);
+
+    /* Packet identifier; SUBACK is not waited for */
+    pucData[xCount++] = 0;
+    pucData[xCount++] = 1;
+
+    for (i = 0; i < uxCount; i++)
+    {
+        xLength = strlen(xSubscriptions[i].cFilter);
+        xCount += prvPutString(&pucData[xCount], xSubscriptions[i].cFilter, xLength);
+        pucData[xCount++] = xSubscriptions[i].ucQos;
+    }
+
+    xBatchUsed += xCount;
+}
+
+/* Identifier not used by a message in flight, never 0 */
+static uint16_t prvNewPacketId(void)
+{
+    uint16_t usPacketId;
+    BaseType_t xUsed;
+    UBaseType_t i;
+
+    do
+    {
+        usPacketId = usNextPacketId++;
+        if (usNextPacketId == 0)
+        {
+            usNextPacketId = 1;
+        }
+
+        xUsed = pdFALSE;
+        for (i = 0; i < MQTT_CLIENT_WINDOW; i++)
+        {
+            if ((xSlots[i].ucState == eSlotSent || xSlots[i].ucState == eSlotReleased) &&
+                xSlots[i].usPacketId == usPacketId)
+            {
+                xUsed = pdTRUE;
+                break;
+            }
+        }
+    } while (xUsed != pdFALSE);
+
+    return usPacketId;
+}
+
+/* Encode the queued messages, until the queue is empty or the session fails */
+static void prvSendQueued(void)
+{
+    MqttSlot_t *pxSlot;
+    uint8_t ucIndex;
+
+    while (xSessionError == NO_ERROR && xQueueReceive(xSendQueue, &ucIndex, 0) == pdPASS)
+    {
+        pxSlot = &xSlots[ucIndex];
+
+        if (pxSlot->ucQos > 0)
+        {
+            pxSlot->usPacketId = prvNewPacketId();
+            pxSlot->ulSequence = ulNextSequence++;
+        }
+
+        prvAppendPublish(pxSlot, 0u);
+        xClientStats.ulSent++;
+
+        /* A QoS 1 or 2 message lost in a failed batch is resent after the
+           reconnection, like the others in flight */
+        if (pxSlot->ucQos > 0)
+        {
+            pxSlot->ucState = eSlotSent;
+        }
+        else
+        {
+            prvFreeSlot(pxSlot);
+        }
+    }
+}
+
+/* Send again the messages left in flight by the previous connection */
+static void prvResendInFlight(void)
+{
+    uint8_t ucOrder[MQTT_CLIENT_WINDOW];
+    UBaseType_t uxCount = 0;
+    MqttSlot_t *pxSlot;
+    UBaseType_t i;
+    UBaseType_t j;
+
+    /* Sort them by first sending; the sequence numbers in flight are close,
+       so their difference is meaningful across a wrap */
+    for (i = 0; i < MQTT_CLIENT_WINDOW; i++)
+    {
+        if (xSlots[i].ucState != eSlotSent && xSlots[i].ucState != eSlotReleased)
+        {
+            continue;
+        }
+
+        for (j = uxCount; j > 0 && (int32_t) (xSlots[ucOrder[j - 1]].ulSequence - xSlots[i].ulSequence) > 0; j--)
+        {
+            ucOrder[j] = ucOrder[j - 1];
+        }
+        ucOrder[j] = (uint8_t) i;
+        uxCount++;
+    }
+
+    for (i = 0; i < uxCount; i++)
+    {
+        pxSlot = &xSlots[ucOrder[i]];
+
+        if (pxSlot->ucState == eSlotSent)
+        {
+            prvAppendPublish(pxSlot, MQTT_FLAG_DUP);
+        }
+        else
+        {
+            prvAppendAck(MQTT_HEADER(MQTT_TYPE_PUBREL, 0x02u), pxSlot->usPacketId);
+        }
+        xClientStats.ulRetransmitted++;
+    }
+}
+
+static MqttSlot_t *prvFindInFlight(uint16_t usPacketId, uint8_t ucState, uint8_t ucQos)
+{
+    UBaseType_t i;
+
+    for (i = 0; i < MQTT_CLIENT_WINDOW; i++)
+    {
+        if (xSlots[i].ucState == ucState && xSlots[i].ucQos == ucQos && xSlots[i].usPacketId == usPacketId)
+        {
+            return &xSlots[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Topic name against a filter with '+' and '#' wildcards */
+static BaseType_t prvTopicMatches(const char *pcFilter, const char *pcTopic, size_t xLength)
+{
+    size_t i = 0;
+
+    while (*pcFilter != '\0')
+    {
+        if (*pcFilter == '#')
+        {
+            return pdTRUE;
+        }
+
+        if (*pcFilter == '+')
+        {
+            while (i < xLength && pcTopic[i] != '/')
+            {
+                i++;
+            }
+            pcFilter++;
+            continue;
+        }
+
+        if (i == xLength)
+        {
+            /* "a/#" matches "a" as well */
+            return (strcmp(pcFilter, "/#") == 0) ? pdTRUE : pdFALSE;
+        }
+
+        if (*pcFilter != pcTopic[i])
+        {
+            return pdFALSE;
+        }
+        pcFilter++;
+        i++;
+    }
+
+    return (i == xLength) ? pdTRUE : pdFALSE;
+}
+
+static void prvDeliver(const char *pcTopic, size_t xTopicLength, const uint8_t *pucPayload, size_t xLength,
+                       uint8_t ucQos)
+{
+    UBaseType_t uxCount = uxSubscriptionCount;
+    UBaseType_t i;
+
+    for (i = 0; i < uxCount; i++)
+    {
+        if (prvTopicMatches(xSubscriptions[i].cFilter, pcTopic, xTopicLength) != pdFALSE)
+        {
+            xClientStats.ulReceived++;
+            xSubscriptions[i].pxCallback(pcTopic, xTopicLength, pucPayload, xLength, ucQos);
+            return;
+        }
+    }
+}
+
+/* An incoming packet; xAvailable is less than ulLength for a message too
+   long for the buffer, which is then acknowledged but not delivered */
+static void prvHandlePacket(uint8_t ucHeader, const uint8_t *pucBody, uint32_t ulLength, size_t xAvailable)
+{
+    MqttSlot_t *pxSlot;
+    uint16_t usPacketId = 0;
+    size_t xTopicLength;
+    size_t xOffset;
+    uint8_t ucQos;
+
+    if (xAvailable >= 2u)
+    {
+        usPacketId = (uint16_t) ((pucBody[0] << 8) | pucBody[1]);
+    }
+
+    switch (ucHeader >> 4)
+    {
+    case MQTT_TYPE_CONNACK:
+        if (xAvailable >= 2u)
+        {
+            iConnackCode = pucBody[1];
+        }
+        break;
+
+    case MQTT_TYPE_PUBLISH:
+        /* The topic length comes first, the identifier after the topic */
+        ucQos = (ucHeader >> 1) & 0x03u;
+        xTopicLength = usPacketId;
+        xOffset = 2u + xTopicLength;
+
+        if (ucQos > 0)
+        {
+            if (xAvailable < xOffset + 2u)
+            {
+                break;
+            }
+            usPacketId = (uint16_t) ((pucBody[xOffset] << 8) | pucBody[xOffset + 1u]);
+            xOffset += 2u;
+        }
+
+        if (xAvailable == ulLength && xOffset <= ulLength)
+        {
+            prvDeliver((const char *) &pucBody[2], xTopicLength, &pucBody[xOffset], ulLength - xOffset, ucQos);
+        }
+
+        if (ucQos == 1)
+        {
+            prvAppendAck(MQTT_HEADER(MQTT_TYPE_PUBACK, 0u), usPacketId);
+        }
+        else if (ucQos == 2)
+        {
+            prvAppendAck(MQTT_HEADER(MQTT_TYPE_PUBREC, 0u), usPacketId);
+        }
+        break;
+
+    case MQTT_TYPE_PUBACK:
+        pxSlot = prvFindInFlight(usPacketId, eSlotSent, 1);
+        if (pxSlot != NULL)
+        {
+            xClientStats.ulAcked++;
+            prvFreeSlot(pxSlot);
+        }
+        break;
+
+    case MQTT_TYPE_PUBREC:
+        pxSlot = prvFindInFlight(usPacketId, eSlotSent, 2);
+        if (pxSlot != NULL)
+        {
+            pxSlot->ucState = eSlotReleased;
+        }
+        /* Released even when unknown, for the broker to forget it */
+        prvAppendAck(MQTT_HEADER(MQTT_TYPE_PUBREL, 0x02u), usPacketId);
+        break;
+
+    case MQTT_TYPE_PUBREL:
+        prvAppendAck(MQTT_HEADER(MQTT_TYPE_PUBCOMP, 0u), usPacketId);
+        break;
+
+    case MQTT_TYPE_PUBCOMP:
+        pxSlot = prvFindInFlight(usPacketId, eSlotReleased, 2);
+        if (pxSlot != NULL)
+        {
+            xClientStats.ulAcked++;
+            prvFreeSlot(pxSlot);
+        }
+        break;
+
+    default:
+        /* SUBACK, UNSUBACK, PINGRESP */
+        break;
+    }
+}
+
+/* Fixed header: 1 if complete, 0 if more bytes are needed, -1 if malformed */
+static int_t prvDecodeHeader(const uint8_t *pucData, size_t xAvailable, size_t *pxHeader, uint32_t *pulLength)
+{
+    uint32_t ulLength = 0;
+    size_t i;
+
+    for (i = 1; i < 5u; i++)
+    {
+        if (i >= xAvailable)
+        {
+            return 0;
+        }
+
+        ulLength |= (uint32_t) (pucData[i] & 0x7Fu) << (7u * (i - 1u));
+        if ((pucData[i] & 0x80u) == 0)
+        {
+            *pxHeader = i + 1u;
+            *pulLength = ulLength;
+            return 1;
+        }
+    }
+
+    return -1;
+}
+
+/* Handle every complete packet of the receive buffer */
+static void prvParseRx(void)
+{
+    size_t xOffset = 0;
+    size_t xHeader = 0;
+    size_t xSkipped;
+    uint32_t ulLength = 0;
+    int_t iResult;
+
+    while (xSessionError == NO_ERROR)
+    {
+        /* Tail of a packet too long, already handled */
+        if (ulRxSkip > 0)
+        {
+            xSkipped = MIN(ulRxSkip, xRxUsed - xOffset);
+            ulRxSkip -= xSkipped;
+            xOffset += xSkipped;
+            if (ulRxSkip > 0)
+            {
+                break;
+            }
+        }
+
+        iResult = prvDecodeHeader(&ucRxBuffer[xOffset], xRxUsed - xOffset, &xHeader, &ulLength);
+        if (iResult < 0)
+        {
+            xSessionError = ERROR_INVALID_SYNTAX;
+            break;
+        }
+        if (iResult == 0)
+        {
+            break;
+        }
+
+        if (xHeader + ulLength <= xRxUsed - xOffset)
+        {
+            prvHandlePacket(ucRxBuffer[xOffset], &ucRxBuffer[xOffset + xHeader], ulLength, ulLength);
+            xOffset += xHeader + ulLength;
+        }
+        else if (xOffset == 0 && xRxUsed == sizeof(ucRxBuffer))
+        {
+            /* Longer than the buffer: handle what it holds, skip the rest */
+            prvHandlePacket(ucRxBuffer[0], &ucRxBuffer[xHeader], ulLength, xRxUsed - xHeader);
+            ulRxSkip = (uint32_t) (xHeader + ulLength - xRxUsed);
+            xOffset = xRxUsed;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    /* Keep the beginning of the next packet */
+    memmove(ucRxBuffer, &ucRxBuffer[xOffset], xRxUsed - xOffset);
+    xRxUsed -= xOffset;
+}
+
+static void prvReceive(uint_t uFlags)
+{
+    size_t xReceived = 0;
+    error_t err;
+
+    err = socketReceive(pxClientSocket, &ucRxBuffer[xRxUsed], sizeof(ucRxBuffer) - xRxUsed, &xReceived, uFlags);
+    if (err == NO_ERROR && xReceived > 0)
+    {
+        xRxUsed += xReceived;
+        xLastRx = osGetSystemTime();
+        xPingSent = pdFALSE;
+        prvParseRx();
+    }
+    else if (err != ERROR_TIMEOUT || (uFlags & SOCKET_FLAG_DONT_WAIT) == 0)
+    {
+        /* Closed, reset, or no answer in time */
+        xSessionError = (err != NO_ERROR) ? err : ERROR_END_OF_STREAM;
+    }
+}
+
+/* Connect to the broker and wait for CONNACK */
+static error_t prvOpenSession(const char *pcHost, uint16_t usPort)
+{
+    IpAddr xAddr;
+    error_t err;
+
+    err = getHostByName(NULL, pcHost, &xAddr, 0);
+    if (err != NO_ERROR)
+    {
+        return err;
+    }
+
+    pxClientSocket = socketOpen(SOCKET_TYPE_STREAM, SOCKET_IP_PROTO_TCP);
+    if (pxClientSocket == NULL)
+    {
+        return ERROR_OUT_OF_RESOURCES;
+    }
+
+    /* Room for a full window of messages, from the large buffer pool */
+    if (socketEnableLargeBuffers(pxClientSocket, TRUE) == NO_ERROR)
+    {
+        socketSetTxBufferSize(pxClientSocket, MQTT_CLIENT_TX_BUFFER_SIZE);
+    }
+    socketSetTimeout(pxClientSocket, MQTT_CLIENT_TIMEOUT_MS);
+
+    err = socketConnect(pxClientSocket, &xAddr, usPort);
+    if (err != NO_ERROR)
+    {
+        return err;
+    }
+
+    xSessionError = NO_ERROR;
+    xBatchUsed = 0;
+    xRxUsed = 0;
+    ulRxSkip = 0;
+    iConnackCode = -1;
+
+    prvAppendConnect();
+    prvFlush();
+
+    /* The broker may send the messages of the session right behind CONNACK */
+    while (xSessionError == NO_ERROR && iConnackCode < 0)
+    {
+        prvReceive(0);
+    }
+
+    if (xSessionError != NO_ERROR)
+    {
+        return xSessionError;
+    }
+
+    return (iConnackCode == 0) ? NO_ERROR : ERROR_CONNECTION_REFUSED;
+}
+
+static void prvRunSession(uint32_t ulGeneration)
+{
+    const systime_t xKeepAlive = MQTT_CLIENT_KEEP_ALIVE_S * 1000u;
+    SocketEventDesc xEventDesc;
+    systime_t xNow;
+    systime_t xWait;
+    systime_t xSilence;
+    systime_t xIdle;
+
+    xSubscribePending = pdFALSE;
+    prvAppendSubscribe();
+    prvResendInFlight();
+    xLastTx = osGetSystemTime();
+    xLastRx = xLastTx;
+    xPingSent = pdFALSE;
+
+    while (xSessionError == NO_ERROR && xBrokerEnabled != pdFALSE && ulBrokerGeneration == ulGeneration)
+    {
+        if (xSubscribePending != pdFALSE)
+        {
+            xSubscribePending = pdFALSE;
+            prvAppendSubscribe();
+        }
+
+        prvSendQueued();
+
+        /* Ping when idle, and when the broker has been silent for long
+           (QoS 0 messages get no answer) */
+        xNow = osGetSystemTime();
+        if (xPingSent == pdFALSE && (xNow - xLastTx >= xKeepAlive || xNow - xLastRx >= xKeepAlive))
+        {
+            prvAppendEmpty(MQTT_TYPE_PINGREQ);
+            xPingSent = pdTRUE;
+        }
+        prvFlush();
+
+        /* The broker answers PINGREQ well within half a keep alive */
+        xNow = osGetSystemTime();
+        xSilence = xNow - xLastRx;
+        if (xSilence >= xKeepAlive + xKeepAlive / 2u)
+        {
+            xSessionError = ERROR_TIMEOUT;
+            break;
+        }
+
+        xWait = xKeepAlive + xKeepAlive / 2u - xSilence;
+        if (xPingSent == pdFALSE)
+        {
+            xIdle = MIN(MAX(xNow - xLastTx, xSilence), xKeepAlive);
+            xWait = MIN(xWait, xKeepAlive - xIdle);
+        }
+
+        /* Publishers and configuration changes set the event */
+        xEventDesc.socket = pxClientSocket;
+        xEventDesc.eventMask = SOCKET_EVENT_RX_READY;
+        xEventDesc.eventFlags = 0;
+        if (socketPoll(&xEventDesc, 1, &xClientEvent, xWait) == NO_ERROR &&
+            (xEventDesc.eventFlags & SOCKET_EVENT_RX_READY) != 0)
+        {
+            prvReceive(SOCKET_FLAG_DONT_WAIT);
+        }
+    }
+
+    /* Leaving on purpose; the session is kept by the broker all the same */
+    if (xSessionError == NO_ERROR)
+    {
+        prvAppendEmpty(MQTT_TYPE_DISCONNECT);
+        prvFlush();
+    }
+}
+
+static void prvMqttClientTask(void *pvParameters)
+{
+    char cHost[MQTT_CLIENT_HOST_SIZE];
+    uint16_t usPort;
+    uint32_t ulGeneration;
+    uint32_t ulRetryMs = 0;
+    systime_t xStart;
+    error_t err;
+
+    (void) pvParameters;
+
+    for (;;)
+    {
+        if (xBrokerEnabled == pdFALSE)
+        {
+            osWaitForEvent(&xClientEvent, INFINITE_DELAY);
+            ulRetryMs = 0;
+            continue;
+        }
+
+        /* Back off, unless the broker is changed meanwhile */
+        ulGeneration = ulBrokerGeneration;
+        xStart = osGetSystemTime();
+        while (ulRetryMs > 0 && xBrokerEnabled != pdFALSE && ulBrokerGeneration == ulGeneration &&
+               osGetSystemTime() - xStart < ulRetryMs)
+        {
+            osWaitForEvent(&xClientEvent, ulRetryMs - (osGetSystemTime() - xStart));
+        }
+        if (xBrokerEnabled == pdFALSE)
+        {
+            continue;
+        }
+
+        taskENTER_CRITICAL();
+        strcpy(cHost, cBrokerHost);
+        usPort = usBrokerPort;
+        ulGeneration = ulBrokerGeneration;
+        taskEXIT_CRITICAL();
+
+        err = prvOpenSession(cHost, usPort);
+        if (err == NO_ERROR)
+        {
+            xClientStats.ulConnects++;
+            xConnected = pdTRUE;
+            xStart = osGetSystemTime();
+            prvRunSession(ulGeneration);
+            xConnected = pdFALSE;
+
+            /* Reconnect at once after a session that lasted, so that a broker
+               closing every connection does not get a storm of them */
+            if (osGetSystemTime() - xStart >= MQTT_CLIENT_RETRY_MAX_MS)
+            {
+                ulRetryMs = 0;
+            }
+            else
+            {
+                ulRetryMs = (ulRetryMs == 0) ? MQTT_CLIENT_RETRY_MIN_MS : MIN(ulRetryMs * 2u, MQTT_CLIENT_RETRY_MAX_MS);
+            }
+        }
+        else
+        {
+            xClientStats.ulFailures++;
+            ulRetryMs = (ulRetryMs == 0) ? MQTT_CLIENT_RETRY_MIN_MS : MIN(ulRetryMs * 2u, MQTT_CLIENT_RETRY_MAX_MS);
+        }
+
+        if (pxClientSocket != NULL)
+        {
+            socketClose(pxClientSocket);
+            pxClientSocket = NULL;
+        }
+    }
+}
+
+BaseType_t xMqttClientStart(UBaseType_t uxPriority)
+{
+    const uint8_t *pucMac = netInterface[0].macAddr.b;
+
+    xSendQueue = xAppQueueCreate(xSendQueue, MQTT_CLIENT_WINDOW, sizeof(uint8_t));
+    xFreeSlots = xAppSemaphoreCreateCounting(xFreeSlots, MQTT_CLIENT_WINDOW, MQTT_CLIENT_WINDOW);
+    if (xSendQueue == NULL || xFreeSlots == NULL || !osCreateEvent(&xClientEvent))
+    {
+        return pdFAIL;
+    }
+
+    /* Stable across reboots, for the broker to find the session again */
+    snprintf(cClientId, sizeof(cClientId), "h7-%02x%02x%02x%02x%02x%02x",
+             pucMac[0], pucMac[1], pucMac[2], pucMac[3], pucMac[4], pucMac[5]);
+
+    return xAppTaskCreate(xMqttTask,
+                          prvMqttClientTask,
+                          "MQTT",
+                          MQTT_CLIENT_TASK_STACK_SIZE,
+                          NULL,
+                          uxPriority,
+                          NULL);
+}
+
+BaseType_t xMqttClientConnect(const char *pcHost, uint16_t usPort)
+{
+    if (strlen(pcHost) >= sizeof(cBrokerHost))
+    {
+        return pdFAIL;
+    }
+
+    taskENTER_CRITICAL();
+    strcpy(cBrokerHost, pcHost);
+    usBrokerPort = (usPort != 0) ? usPort : MQTT_CLIENT_PORT;
+    ulBrokerGeneration++;
+    xBrokerEnabled = pdTRUE;
+    taskEXIT_CRITICAL();
+
+    osSetEvent(&xClientEvent);
+    return pdPASS;
+}
+
+void vMqttClientDisconnect(void)
+{
+    xBrokerEnabled = pdFALSE;
+    osSetEvent(&xClientEvent);
+}
+
+BaseType_t xMqttClientIsConnected(void)
+{
+    return xConnected;
+}
+
+BaseType_t xMqttClientPublish(const char *pcTopic, const void *pvPayload, size_t xLength,
+                              uint8_t ucQos, TickType_t xTimeout)
+{
+    size_t xTopicLength = strlen(pcTopic);
+    MqttSlot_t *pxSlot = NULL;
+    uint8_t ucIndex = 0;
+    UBaseType_t i;
+
+    if (xFreeSlots == NULL || ucQos > 2 || xTopicLength == 0 || xTopicLength + xLength > MQTT_CLIENT_MESSAGE_SIZE)
+    {
+        return pdFAIL;
+    }
+
+    if (xSemaphoreTake(xFreeSlots, xTimeout) != pdPASS)
+    {
+        taskENTER_CRITICAL();
+        xClientStats.ulDropped++;
+        taskEXIT_CRITICAL();
+        return pdFAIL;
+    }
+
+    /* The semaphore guarantees a free slot */
+    taskENTER_CRITICAL();
+    for (i = 0; i < MQTT_CLIENT_WINDOW; i++)
+    {
+        if (xSlots[i].ucState == eSlotFree)
+        {
+            pxSlot = &xSlots[i];
+            pxSlot->ucState = eSlotFilling;
+            ucIndex = (uint8_t) i;
+            break;
+        }
+    }
+    xClientStats.ulPublished++;
+    taskEXIT_CRITICAL();
+    configASSERT(pxSlot != NULL);
+
+    pxSlot->ucQos = ucQos;
+    pxSlot->usTopicLength = (uint16_t) xTopicLength;
+    pxSlot->usPayloadLength = (uint16_t) xLength;
+    memcpy(pxSlot->ucData, pcTopic, xTopicLength);
+    memcpy(&pxSlot->ucData[xTopicLength], pvPayload, xLength);
+    pxSlot->ucState = eSlotQueued;
+
+    /* Never full: it has room for every slot */
+    (void) xQueueSend(xSendQueue, &ucIndex, 0);
+    osSetEvent(&xClientEvent);
+
+    return pdPASS;
+}
+
+BaseType_t xMqttClientSubscribe(const char *pcFilter, uint8_t ucQos, MqttMessageCallback_t pxCallback)
+{
+    MqttSubscription_t *pxSubscription;
+    BaseType_t xResult = pdFAIL;
+
+    if (ucQos > 2 || pxCallback == NULL || strlen(pcFilter) >= MQTT_CLIENT_FILTER_SIZE)
+    {
+        return pdFAIL;
+    }
+
+    taskENTER_CRITICAL();
+    if (uxSubscriptionCount < MQTT_CLIENT_MAX_SUBSCRIPTIONS)
+    {
+        pxSubscription = &xSubscriptions[uxSubscriptionCount];
+        strcpy(pxSubscription->cFilter, pcFilter);
+        pxSubscription->ucQos = ucQos;
+        pxSubscription->pxCallback = pxCallback;
+        uxSubscriptionCount++;
+        xSubscribePending = pdTRUE;
+        xResult = pdPASS;
+    }
+    taskEXIT_CRITICAL();
+
+    if (xResult == pdPASS)
+    {
+        osSetEvent(&xClientEvent);
+    }
+
+    return xResult;
+}
+
+UBaseType_t uxMqttClientInFlight(void)
+{
+    return (xFreeSlots != NULL) ? MQTT_CLIENT_WINDOW - uxSemaphoreGetCount(xFreeSlots) : 0;
+}
+
+void vMqttClientGetStats(MqttClientStats_t *pxStats)
+{
+    *pxStats = xClientStats;
+}
+
+/* Publish ulCount messages and wait for the window to drain */
+static void prvBench(char *pcWriteBuffer, size_t xWriteBufferLen, uint32_t ulCount, uint8_t ucQos)
+{
+    uint8_t ucPayload[MQTT_BENCH_PAYLOAD];
+    TickType_t xStart;
+    TickType_t xElapsed;
+    char cTopic[32];
+    uint32_t ulQueued = 0;
+    uint32_t i;
+
+    snprintf(cTopic, sizeof(cTopic), "bench/%s", cClientId);
+    memset(ucPayload, 'x', sizeof(ucPayload));
+
+    xStart = xTaskGetTickCount();
+    for (i = 0; i < ulCount; i++)
+    {
+        memcpy(ucPayload, &i, sizeof(i));
+        if (xMqttClientPublish(cTopic, ucPayload, sizeof(ucPayload), ucQos,
+                               pdMS_TO_TICKS(MQTT_CLIENT_TIMEOUT_MS)) != pdPASS)
+        {
+            break;
+        }
+        ulQueued++;
+    }
+
+    while (uxMqttClientInFlight() > 0 &&
+           xTaskGetTickCount() - xStart < pdMS_TO_TICKS(ulCount + MQTT_CLIENT_TIMEOUT_MS))
+    {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    xElapsed = xTaskGetTickCount() - xStart;
+    if (xElapsed == 0)
+    {
+        xElapsed = 1;
+    }
+
+    snprintf(pcWriteBuffer, xWriteBufferLen, "%lu of %lu messages at QoS %u in %lu ms: %lu msg/s, %lu left in flight\r\n",
+             (unsigned long) ulQueued, (unsigned long) ulCount, ucQos,
+             (unsigned long) (xElapsed * portTICK_PERIOD_MS),
+             (unsigned long) ((uint64_t) ulQueued * 1000u / (xElapsed * portTICK_PERIOD_MS)),
+             (unsigned long) uxMqttClientInFlight());
+}
+
+static BaseType_t prvMqttCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    static UBaseType_t uxLine = 0;
+    const char *pcParameter;
+    const char *pcTopic;
+    BaseType_t xTopicLength;
+    BaseType_t xLength;
+    char cHost[MQTT_CLIENT_HOST_SIZE];
+    char cTopic[MQTT_CLIENT_FILTER_SIZE];
+    unsigned long ulValue;
+    unsigned long ulQos;
+
+    if (uxLine == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xLength);
+        if (pcParameter != NULL)
+        {
+            if (xLength == 3 && strncmp(pcParameter, "off", 3) == 0)
+            {
+                vMqttClientDisconnect();
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Disconnected, %lu messages kept\r\n",
+                         (unsigned long) uxMqttClientInFlight());
+                return pdFALSE;
+            }
+
+            if (xLength == 7 && strncmp(pcParameter, "connect", 7) == 0)
+            {
+                pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xLength);
+                if (pcParameter == NULL || (size_t) xLength >= sizeof(cHost))
+                {
+                    snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: mqtt connect <host> [<port>]\r\n");
+                    return pdFALSE;
+                }
+                memcpy(cHost, pcParameter, xLength);
+                cHost[xLength] = '\0';
+
+                pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 3, &xLength);
+                ulValue = (pcParameter != NULL) ? strtoul(pcParameter, NULL, 10) : 0;
+                if (ulValue > 65535 || (pcParameter != NULL && ulValue == 0))
+                {
+                    snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid port\r\n");
+                    return pdFALSE;
+                }
+
+                (void) xMqttClientConnect(cHost, (uint16_t) ulValue);
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Connecting to %s port %u\r\n", cHost, usBrokerPort);
+                return pdFALSE;
+            }
+
+            if (xLength == 3 && strncmp(pcParameter, "pub", 3) == 0)
+            {
+                pcTopic = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xTopicLength);
+                pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 3, &xLength);
+                ulQos = (pcParameter != NULL) ? strtoul(pcParameter, NULL, 10) : 3;
+                pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 4, &xLength);
+                if (pcTopic == NULL || pcParameter == NULL || ulQos > 2 || (size_t) xTopicLength >= sizeof(cTopic))
+                {
+                    snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: mqtt pub <topic> <0-2> <text>\r\n");
+                    return pdFALSE;
+                }
+                memcpy(cTopic, pcTopic, xTopicLength);
+                cTopic[xTopicLength] = '\0';
+
+                /* The text is the rest of the line, spaces included */
+                if (xMqttClientPublish(cTopic, pcParameter, strlen(pcParameter), (uint8_t) ulQos, 0) != pdPASS)
+                {
+                    snprintf(pcWriteBuffer, xWriteBufferLen, "Not queued: window full or message too long\r\n");
+                    return pdFALSE;
+                }
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Queued\r\n");
+                return pdFALSE;
+            }
+
+            if (xLength == 5 && strncmp(pcParameter, "bench", 5) == 0)
+            {
+                pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xLength);
+                ulValue = (pcParameter != NULL) ? strtoul(pcParameter, NULL, 10) : 0;
+                pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 3, &xLength);
+                ulQos = (pcParameter != NULL) ? strtoul(pcParameter, NULL, 10) : 1;
+                if (ulValue == 0 || ulQos > 2)
+                {
+                    snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: mqtt bench <count> [<0-2>]\r\n");
+                    return pdFALSE;
+                }
+                if (xMqttClientIsConnected() == pdFALSE)
+                {
+                    snprintf(pcWriteBuffer, xWriteBufferLen, "Not connected\r\n");
+                    return pdFALSE;
+                }
+
+                prvBench(pcWriteBuffer, xWriteBufferLen, (uint32_t) ulValue, (uint8_t) ulQos);
+                return pdFALSE;
+            }
+
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Unknown option\r\n");
+            return pdFALSE;
+        }
+
+        if (xBrokerEnabled != pdFALSE)
+        {
+            taskENTER_CRITICAL();
+            strcpy(cHost, cBrokerHost);
+            taskEXIT_CRITICAL();
+            snprintf(pcWriteBuffer, xWriteBufferLen, "broker: %s port %u, %s, client %s, window %lu/%u\r\n",
+                     cHost, usBrokerPort, (xConnected != pdFALSE) ? "connected" : "connecting",
+                     cClientId, (unsigned long) uxMqttClientInFlight(), MQTT_CLIENT_WINDOW);
+        }
+        else
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "broker: off, window %lu/%u\r\n",
+                     (unsigned long) uxMqttClientInFlight(), MQTT_CLIENT_WINDOW);
+        }
+        uxLine++;
+        return pdTRUE;
+    }
+
+    snprintf(pcWriteBuffer, xWriteBufferLen,
+             "published=%lu sent=%lu acked=%lu retransmitted=%lu dropped=%lu received=%lu "
+             "batches=%lu connects=%lu failures=%lu\r\n",
+             (unsigned long) xClientStats.ulPublished, (unsigned long) xClientStats.ulSent,
+             (unsigned long) xClientStats.ulAcked, (unsigned long) xClientStats.ulRetransmitted,
+             (unsigned long) xClientStats.ulDropped, (unsigned long) xClientStats.ulReceived,
+             (unsigned long) xClientStats.ulBatches, (unsigned long) xClientStats.ulConnects,
+             (unsigned long) xClientStats.ulFailures);
+    uxLine = 0;
+    return pdFALSE;
+}
+
+void vMqttClientRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xMqtt);
+}
@@ -0,0 +1,1022 @@
+/* MqttSnClient.c
+ *
+ * States, send window and batching of the MQTT-SN client (see
+ * MqttSnClient.h). Publishers fill a free slot and queue its index; the
+ * socket, the batch and the connection state belong to the client task.
+ */
+#include "MqttSnClient.h"
+#include "StaticAlloc.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "FreeRTOS_CLI.h"
+#include "core/net.h"
+#include "core/socket.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Message types */
+#define MQTT_SN_CONNECT                0x04u
+#define MQTT_SN_CONNACK                0x05u
+#define MQTT_SN_PUBLISH                0x0Cu
+#define MQTT_SN_PUBACK                 0x0Du
+#define MQTT_SN_PINGREQ                0x16u
+#define MQTT_SN_PINGRESP               0x17u
+#define MQTT_SN_DISCONNECT             0x18u
+
+/* Flags */
+#define MQTT_SN_FLAG_DUP               0x80u
+#define MQTT_SN_FLAG_QOS_1             0x20u
+#define MQTT_SN_FLAG_QOS_MINUS_ONE     0x60u
+#define MQTT_SN_FLAG_CLEAN_SESSION     0x04u
+#define MQTT_SN_FLAG_TOPIC_PREDEFINED  0x01u
+
+/* Return codes of CONNACK and PUBACK */
+#define MQTT_SN_ACCEPTED               0x00u
+#define MQTT_SN_CONGESTION             0x01u
+
+#define MQTT_SN_PROTOCOL_ID            0x01u
+
+/* Header of PUBLISH, and room for CONNECT with the client identifier */
+#define MQTT_SN_PUBLISH_HEADER         7u
+#define MQTT_SN_DATAGRAM_SIZE          (MQTT_SN_CLIENT_MESSAGE_SIZE + MQTT_SN_PUBLISH_HEADER)
+
+/* Wake-ups come a little early, within the duration the gateway waits */
+#define MQTT_SN_WAKE_MS                (MQTT_SN_CLIENT_SLEEP_S * 900u)
+
+/* Bytes of the payload of the bench messages */
+#define MQTT_SN_BENCH_PAYLOAD          32u
+
+typedef enum
+{
+    eSnOff = 0,
+    eSnDisconnected,
+    eSnConnecting,                  /* CONNECT sent, waiting for CONNACK */
+    eSnActive,
+    eSnAsleep,
+    eSnAwake                        /* PINGREQ sent while asleep, waiting for PINGRESP */
+} MqttSnState_t;
+
+typedef enum
+{
+    eSnSlotFree = 0,
+    eSnSlotFilling,                 /* Taken by a publisher */
+    eSnSlotQueued,                  /* Waiting in the send queue */
+    eSnSlotHeld,                    /* Waiting for the connection */
+    eSnSlotSent                     /* QoS 1, waiting for PUBACK */
+} MqttSnSlotState_t;
+
+/* A message of the send window */
+typedef struct
+{
+    volatile uint8_t ucState;
+    int8_t cQos;
+    uint8_t ucLength;
+    uint8_t ucRetries;
+    uint16_t usTopicId;
+    uint16_t usMsgId;
+    uint32_t ulSequence;            /* Rank of the first sending, for resending in order */
+    systime_t xSentAt;
+    uint8_t ucData[MQTT_SN_CLIENT_MESSAGE_SIZE];
+} MqttSnSlot_t;
+
+static const char * const pcStateNames[] =
+{
+    "off", "disconnected", "connecting", "active", "asleep", "awake"
+};
+
+static MqttSnSlot_t xSlots[MQTT_SN_CLIENT_WINDOW];
+static QueueHandle_t xSendQueue = NULL;         /* Indexes of the queued slots, in order */
+static SemaphoreHandle_t xFreeSlots = NULL;     /* Counts the free slots */
+
+/* Gateway, changed by xMqttSnClientConfigure() */
+static IpAddr xGatewayAddr;
+static uint16_t usGatewayPort = MQTT_SN_CLIENT_PORT;
+static volatile BaseType_t xClientEnabled = pdFALSE;
+static volatile uint32_t ulClientGeneration = 0;
+
+static volatile MqttSnState_t eState = eSnOff;
+static OsEvent xClientEvent;
+static MqttSnClientStats_t xClientStats;
+
+/* Owned by the client task */
+static Socket *pxClientSocket = NULL;
+static IpAddr xGateway;
+static uint16_t usPort;
+static uint8_t ucDatagrams[MQTT_SN_CLIENT_BATCH][MQTT_SN_DATAGRAM_SIZE];
+static SocketMsg xBatch[MQTT_SN_CLIENT_BATCH];
+static uint_t uBatchCount = 0;
+static uint8_t ucRxBuffer[32];
+static systime_t xTimer = 0;                    /* Retry, reconnection or wake-up time */
+static uint_t uRetries = 0;
+static systime_t xLastTx = 0;
+static systime_t xLastActivity = 0;
+static BaseType_t xLingering = pdFALSE;
+static systime_t xLingerStart = 0;
+static uint16_t usNextMsgId = 1;
+static uint32_t ulNextSequence = 0;
+static char cClientId[24];
+
+APP_TASK_STORAGE(xMqttSnTask, MQTT_SN_CLIENT_TASK_STACK_SIZE);
+APP_QUEUE_STORAGE(xSendQueue, MQTT_SN_CLIENT_WINDOW, sizeof(uint8_t));
+APP_MUTEX_STORAGE(xFreeSlots);
+
+static BaseType_t prvMqttSnCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xMqttSn =
+{
+    "mqttsn",
+    "\r\nmqttsn [<ip> [<port>] | off | pub <id> <qos> <text> | bench <n> [<qos>]]:\r\n"
+    " MQTT-SN gateway, publishing, throughput\r\n",
+    prvMqttSnCommand,
+    -1
+};
+
+static void prvFreeSlot(MqttSnSlot_t *pxSlot)
+{
+    pxSlot->ucState = eSnSlotFree;
+    xSemaphoreGive(xFreeSlots);
+}
+
+/* Send the datagrams of the batch; lost QoS 1 messages are retransmitted */
+static void prvFlushBatch(void)
+{
+    uint_t uSent = 0;
+
+    if (uBatchCount == 0)
+    {
+        return;
+    }
+
+    (void) socketSendMsgBatch(pxClientSocket, xBatch, uBatchCount, &uSent, 0);
+    xClientStats.ulDatagrams += uSent;
+    xClientStats.ulBatches++;
+    xLastTx = osGetSystemTime();
+    uBatchCount = 0;
+}
+
+/* Buffer of the next datagram of the batch */
+static uint8_t *prvBatchBuffer(void)
+{
+    if (uBatchCount == MQTT_SN_CLIENT_BATCH)
+    {
+        prvFlushBatch();
+    }
+
+    return ucDatagrams[uBatchCount];
+}
+
+static void prvBatchCommit(size_t xLength)
+{
+    SocketMsg *pxMessage = &xBatch[uBatchCount];
+
+    *pxMessage = SOCKET_DEFAULT_MSG;
+    pxMessage->data = ucDatagrams[uBatchCount];
+    pxMessage->size = xLength;
+    pxMessage->length = xLength;
+    pxMessage->destIpAddr = xGateway;
+    pxMessage->destPort = usPort;
+    uBatchCount++;
+}
+
+static void prvAppendPublish(const MqttSnSlot_t *pxSlot, uint8_t ucFlags)
+{
+    uint8_t *pucData = prvBatchBuffer();
+
+    if (pxSlot->cQos == 1)
+    {
+        ucFlags |= MQTT_SN_FLAG_QOS_1;
+    }
+    else if (pxSlot->cQos < 0)
+    {
+        ucFlags |= MQTT_SN_FLAG_QOS_MINUS_ONE;
+    }
+
+    pucData[0] = (uint8_t) (MQTT_SN_PUBLISH_HEADER + pxSlot->ucLength);
+    pucData[1] = MQTT_SN_PUBLISH;
+    pucData[2] = ucFlags | MQTT_SN_FLAG_TOPIC_PREDEFINED;
+    pucData[3] = (uint8_t) (pxSlot->usTopicId >> 8);
+    pucData[4] = (uint8_t) (pxSlot->usTopicId & 0xFFu);
+    pucData[5] = (uint8_t) (pxSlot->usMsgId >> 8);
+    pucData[6] = (uint8_t) (pxSlot->usMsgId & 0xFFu);
+    memcpy(&pucData[MQTT_SN_PUBLISH_HEADER], pxSlot->ucData, pxSlot->ucLength);
+
+    prvBatchCommit(MQTT_SN_PUBLISH_HEADER + pxSlot->ucLength);
+}
+
+static void prvAppendConnect(void)
+{
+    uint8_t *pucData = prvBatchBuffer();
+    size_t xIdLength = strlen(cClientId);
+
+    pucData[0] = (uint8_t) (6u + xIdLength);
+    pucData[1] = MQTT_SN_CONNECT;
+    pucData[2] = (MQTT_SN_CLIENT_CLEAN_SESSION == 1) ? MQTT_SN_FLAG_CLEAN_SESSION : 0u;
+    pucData[3] = MQTT_SN_PROTOCOL_ID;
+    pucData[4] = (uint8_t) (MQTT_SN_CLIENT_KEEP_ALIVE_S >> 8);
+    pucData[5] = (uint8_t) (MQTT_SN_CLIENT_KEEP_ALIVE_S & 0xFFu);
+    memcpy(&pucData[6], cClientId, xIdLength);
+
+    prvBatchCommit(6u + xIdLength);
+}
+
+/* The client identifier tells the gateway a sleeping client woke up */
+static void prvAppendPingReq(BaseType_t xWithClientId)
+{
+    uint8_t *pucData = prvBatchBuffer();
+    size_t xIdLength = (xWithClientId != pdFALSE) ? strlen(cClientId) : 0u;
+
+    pucData[0] = (uint8_t) (2u + xIdLength);
+    pucData[1] = MQTT_SN_PINGREQ;
+    memcpy(&pucData[2], cClientId, xIdLength);
+
+    prvBatchCommit(2u + xIdLength);
+}
+
+/* A duration asks the gateway to keep the session while the client sleeps */
+static void prvAppendDisconnect(uint16_t usDuration)
+{
+    uint8_t *pucData = prvBatchBuffer();
+
+    pucData[0] = (usDuration != 0) ? 4u : 2u;
+    pucData[1] = MQTT_SN_DISCONNECT;
+    pucData[2] = (uint8_t) (usDuration >> 8);
+    pucData[3] = (uint8_t) (usDuration & 0xFFu);
+
+    prvBatchCommit(pucData[0]);
+}
+
+/* Identifier not used by a message in flight, never 0 */
+static uint16_t prvNewMsgId(void)
+{
+    uint16_t usMsgId;
+    BaseType_t xUsed;
+    UBaseType_t i;
+
+    do
+    {
+        usMsgId = usNextMsgId++;
+        if (usNextMsgId == 0)
+        {
+            usNextMsgId = 1;
+        }
+
+        xUsed = pdFALSE;
+        for (i = 0; i < MQTT_SN_CLIENT_WINDOW; i++)
+        {
+            if (xSlots[i].ucState == eSnSlotSent && xSlots[i].usMsgId == usMsgId)
+            {
+                xUsed = pdTRUE;
+                break;
+            }
+        }
+    } while (xUsed != pdFALSE);
+
+    return usMsgId;
+}
+
+static void prvSendFirst(MqttSnSlot_t *pxSlot)
+{
+    prvAppendPublish(pxSlot, 0u);
+    xClientStats.ulSent++;
+
+    if (pxSlot->cQos == 1)
+    {
+        pxSlot->ucState = eSnSlotSent;
+        pxSlot->ucRetries = 0;
+        pxSlot->xSentAt = osGetSystemTime();
+    }
+    else
+    {
+        prvFreeSlot(pxSlot);
+    }
+}
+
+/* Take the queued messages: sent when connected or of QoS -1, held otherwise */
+static void prvDequeue(void)
+{
+    MqttSnSlot_t *pxSlot;
+    uint8_t ucIndex;
+
+    while (xQueueReceive(xSendQueue, &ucIndex, 0) == pdPASS)
+    {
+        pxSlot = &xSlots[ucIndex];
+        pxSlot->ulSequence = ulNextSequence++;
+        pxSlot->usMsgId = (pxSlot->cQos == 1) ? prvNewMsgId() : 0u;
+
+        if (eState == eSnActive || pxSlot->cQos < 0)
+        {
+            prvSendFirst(pxSlot);
+        }
+        else
+        {
+            pxSlot->ucState = eSnSlotHeld;
+        }
+    }
+
+    xLastActivity = osGetSystemTime();
+}
+
+/* Once connected: the messages left in flight again, then the held ones,
+   in the order they were taken */
+static void prvSendAfterConnect(void)
+{
+    uint8_t ucOrder[MQTT_SN_CLIENT_WINDOW];
+    UBaseType_t uxCount = 0;
+    MqttSnSlot_t *pxSlot;
+    UBaseType_t i;
+    UBaseType_t j;
+
+    for (i = 0; i < MQTT_SN_CLIENT_WINDOW; i++)
+    {
+        if (xSlots[i].ucState != eSnSlotSent && xSlots[i].ucState != eSnSlotHeld)
+        {
+            continue;
+        }
+
+        for (j = uxCount; j > 0 && (int32_t) (xSlots[ucOrder[j - 1]].ulSequence - xSlots[i].ulSequence) > 0; j--)
+        {
+            ucOrder[j] = ucOrder[j - 1];
+        }
+        ucOrder[j] = (uint8_t) i;
+        uxCount++;
+    }
+
+    for (i = 0; i < uxCount; i++)
+    {
+        pxSlot = &xSlots[ucOrder[i]];
+
+        if (pxSlot->ucState == eSnSlotSent)
+        {
+            prvAppendPublish(pxSlot, MQTT_SN_FLAG_DUP);
+            pxSlot->ucRetries = 0;
+            pxSlot->xSentAt = osGetSystemTime();
+            xClientStats.ulRetransmitted++;
+        }
+        else
+        {
+            prvSendFirst(pxSlot);
+        }
+    }
+}
+
+/* Messages held or in flight, which need a connection */
+static BaseType_t prvHasUnsent(void)
+{
+    UBaseType_t i;
+
+    for (i = 0; i < MQTT_SN_CLIENT_WINDOW; i++)
+    {
+        if (xSlots[i].ucState == eSnSlotHeld || xSlots[i].ucState == eSnSlotSent)
+        {
+            return pdTRUE;
+        }
+    }
+
+    return pdFALSE;
+}
+
+static void prvGatewayLost(systime_t xNow)
+{
+    xClientStats.ulGatewayLost++;
+    eState = eSnDisconnected;
+    xTimer = xNow + MQTT_SN_CLIENT_RECONNECT_MS;
+}
+
+static void prvConnect(systime_t xNow)
+{
+    prvAppendConnect();
+    eState = eSnConnecting;
+    uRetries = 0;
+    xTimer = xNow + MQTT_SN_CLIENT_RETRY_MS;
+}
+
+/* QoS 1 messages without PUBACK in time are sent again */
+static void prvRetransmit(systime_t xNow)
+{
+    MqttSnSlot_t *pxSlot;
+    UBaseType_t i;
+
+    for (i = 0; i < MQTT_SN_CLIENT_WINDOW && eState == eSnActive; i++)
+    {
+        pxSlot = &xSlots[i];
+        if (pxSlot->ucState != eSnSlotSent || timeCompare(xNow, pxSlot->xSentAt + MQTT_SN_CLIENT_RETRY_MS) < 0)
+        {
+            continue;
+        }
+
+        if (pxSlot->ucRetries >= MQTT_SN_CLIENT_RETRIES)
+        {
+            prvGatewayLost(xNow);
+            break;
+        }
+
+        prvAppendPublish(pxSlot, MQTT_SN_FLAG_DUP);
+        pxSlot->ucRetries++;
+        pxSlot->xSentAt = xNow;
+        xClientStats.ulRetransmitted++;
+    }
+}
+
+/* Advance the state machine and queue what has to be sent */
+static void prvStep(void)
+{
+    systime_t xNow = osGetSystemTime();
+
+    /* Let a burst gather, unless it fills a batch already */
+    if (uxQueueMessagesWaiting(xSendQueue) > 0)
+    {
+        if (xLingering == pdFALSE)
+        {
+            xLingering = pdTRUE;
+            xLingerStart = xNow;
+        }
+
+        if (uxQueueMessagesWaiting(xSendQueue) >= MQTT_SN_CLIENT_BATCH ||
+            xNow - xLingerStart >= MQTT_SN_CLIENT_LINGER_MS)
+        {
+            xLingering = pdFALSE;
+            prvDequeue();
+        }
+    }
+
+    switch (eState)
+    {
+    case eSnDisconnected:
+        if (prvHasUnsent() != pdFALSE && timeCompare(xNow, xTimer) >= 0)
+        {
+            prvConnect(xNow);
+        }
+        break;
+
+    case eSnAsleep:
+        if (prvHasUnsent() != pdFALSE)
+        {
+            prvConnect(xNow);
+        }
+        else if (timeCompare(xNow, xTimer) >= 0)
+        {
+            prvAppendPingReq(pdTRUE);
+            eState = eSnAwake;
+            uRetries = 0;
+            xTimer = xNow + MQTT_SN_CLIENT_RETRY_MS;
+        }
+        break;
+
+    case eSnConnecting:
+    case eSnAwake:
+        if (timeCompare(xNow, xTimer) >= 0)
+        {
+            if (++uRetries > MQTT_SN_CLIENT_RETRIES)
+            {
+                prvGatewayLost(xNow);
+            }
+            else
+            {
+                if (eState == eSnConnecting)
+                {
+                    prvAppendConnect();
+                }
+                else
+                {
+                    prvAppendPingReq(pdTRUE);
+                }
+                xTimer = xNow + MQTT_SN_CLIENT_RETRY_MS;
+            }
+        }
+        break;
+
+    case eSnActive:
+        prvRetransmit(xNow);
+        if (eState != eSnActive)
+        {
+            break;
+        }
+
+        if (MQTT_SN_CLIENT_SLEEP_S > 0 && xLingering == pdFALSE && prvHasUnsent() == pdFALSE &&
+            xNow - xLastActivity >= MQTT_SN_CLIENT_IDLE_MS)
+        {
+            prvAppendDisconnect(MQTT_SN_CLIENT_SLEEP_S);
+            eState = eSnAsleep;
+            xTimer = xNow + MQTT_SN_WAKE_MS;
+            xClientStats.ulSleeps++;
+        }
+        else if (xNow - xLastTx >= MQTT_SN_CLIENT_KEEP_ALIVE_S * 1000u)
+        {
+            prvAppendPingReq(pdFALSE);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void prvSooner(systime_t *pxWait, systime_t xDeadline, systime_t xNow)
+{
+    systime_t xDelay = (timeCompare(xDeadline, xNow) > 0) ? xDeadline - xNow : 0;
+
+    if (xDelay < *pxWait)
+    {
+        *pxWait = xDelay;
+    }
+}
+
+/* Time until prvStep() has something to do, unless a datagram or a message
+   comes first */
+static systime_t prvNextWait(void)
+{
+    systime_t xNow = osGetSystemTime();
+    systime_t xWait = INFINITE_DELAY;
+    UBaseType_t i;
+
+    if (xLingering != pdFALSE)
+    {
+        prvSooner(&xWait, xLingerStart + MQTT_SN_CLIENT_LINGER_MS, xNow);
+    }
+
+    switch (eState)
+    {
+    case eSnDisconnected:
+        if (prvHasUnsent() != pdFALSE)
+        {
+            prvSooner(&xWait, xTimer, xNow);
+        }
+        break;
+
+    case eSnConnecting:
+    case eSnAsleep:
+    case eSnAwake:
+        prvSooner(&xWait, xTimer, xNow);
+        break;
+
+    case eSnActive:
+        if (prvHasUnsent() != pdFALSE)
+        {
+            for (i = 0; i < MQTT_SN_CLIENT_WINDOW; i++)
+            {
+                if (xSlots[i].ucState == eSnSlotSent)
+                {
+                    prvSooner(&xWait, xSlots[i].xSentAt + MQTT_SN_CLIENT_RETRY_MS, xNow);
+                }
+            }
+        }
+        else if (MQTT_SN_CLIENT_SLEEP_S > 0)
+        {
+            prvSooner(&xWait, xLastActivity + MQTT_SN_CLIENT_IDLE_MS, xNow);
+        }
+        prvSooner(&xWait, xLastTx + MQTT_SN_CLIENT_KEEP_ALIVE_S * 1000u, xNow);
+        break;
+
+    default:
+        break;
+    }
+
+    return xWait;
+}
+
+static void prvHandleDatagram(const uint8_t *pucData, size_t xLength)
+{
+    systime_t xNow = osGetSystemTime();
+    MqttSnSlot_t *pxSlot;
+    uint16_t usMsgId;
+    UBaseType_t i;
+
+    /* Only the 1-byte length form is expected from the gateway */
+    if (xLength < 2u || pucData[0] != xLength)
+    {
+        return;
+    }
+
+    switch (pucData[1])
+    {
+    case MQTT_SN_CONNACK:
+        if (eState != eSnConnecting || xLength < 3u)
+        {
+            break;
+        }
+
+        if (pucData[2] == MQTT_SN_ACCEPTED)
+        {
+            eState = eSnActive;
+            xLastActivity = xNow;
+            xClientStats.ulConnects++;
+            prvSendAfterConnect();
+        }
+        else
+        {
+            eState = eSnDisconnected;
+            xTimer = xNow + MQTT_SN_CLIENT_RECONNECT_MS;
+        }
+        break;
+
+    case MQTT_SN_PUBACK:
+        if (xLength < 7u)
+        {
+            break;
+        }
+
+        usMsgId = (uint16_t) ((pucData[4] << 8) | pucData[5]);
+        for (i = 0; i < MQTT_SN_CLIENT_WINDOW; i++)
+        {
+            pxSlot = &xSlots[i];
+            if (pxSlot->ucState != eSnSlotSent || pxSlot->usMsgId != usMsgId)
+            {
+                continue;
+            }
+
+            if (pucData[6] == MQTT_SN_ACCEPTED)
+            {
+                xClientStats.ulAcked++;
+                prvFreeSlot(pxSlot);
+            }
+            else if (pucData[6] == MQTT_SN_CONGESTION)
+            {
+                /* Try again later, without counting it as a loss */
+                pxSlot->xSentAt = xNow;
+            }
+            else
+            {
+                xClientStats.ulRejected++;
+                prvFreeSlot(pxSlot);
+            }
+            break;
+        }
+        xLastActivity = xNow;
+        break;
+
+    case MQTT_SN_PINGRESP:
+        if (eState == eSnAwake)
+        {
+            eState = eSnAsleep;
+            xTimer = xNow + MQTT_SN_WAKE_MS;
+        }
+        break;
+
+    case MQTT_SN_DISCONNECT:
+        /* Also the answer to the DISCONNECT which put the client asleep */
+        if (eState == eSnActive || eState == eSnConnecting)
+        {
+            eState = eSnDisconnected;
+            xTimer = xNow;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void prvReceive(void)
+{
+    IpAddr xSource;
+    uint16_t usSourcePort;
+    size_t xReceived;
+
+    while (socketReceiveFrom(pxClientSocket, &xSource, &usSourcePort, ucRxBuffer, sizeof(ucRxBuffer),
+                             &xReceived, SOCKET_FLAG_DONT_WAIT) == NO_ERROR)
+    {
+        if (usSourcePort == usPort && ipCompAddr(&xSource, &xGateway))
+        {
+            prvHandleDatagram(ucRxBuffer, xReceived);
+        }
+    }
+}
+
+static void prvMqttSnClientTask(void *pvParameters)
+{
+    SocketEventDesc xEventDesc;
+    uint32_t ulGeneration = 0;
+
+    (void) pvParameters;
+
+    pxClientSocket = socketOpen(SOCKET_TYPE_DGRAM, SOCKET_IP_PROTO_UDP);
+    if (pxClientSocket == NULL)
+    {
+        vTaskDelete(NULL);
+        return;
+    }
+    socketBind(pxClientSocket, &IP_ADDR_ANY, 0);
+
+    for (;;)
+    {
+        if (xClientEnabled == pdFALSE)
+        {
+            if (eState == eSnActive)
+            {
+                prvAppendDisconnect(0);
+                prvFlushBatch();
+            }
+            eState = eSnOff;
+            osWaitForEvent(&xClientEvent, INFINITE_DELAY);
+            continue;
+        }
+
+        /* New gateway: connect from scratch */
+        if (eState == eSnOff || ulGeneration != ulClientGeneration)
+        {
+            taskENTER_CRITICAL();
+            xGateway = xGatewayAddr;
+            usPort = usGatewayPort;
+            ulGeneration = ulClientGeneration;
+            taskEXIT_CRITICAL();
+
+            eState = eSnDisconnected;
+            xTimer = osGetSystemTime();
+        }
+
+        prvStep();
+        prvFlushBatch();
+
+        /* Publishers and configuration changes set the event */
+        xEventDesc.socket = pxClientSocket;
+        xEventDesc.eventMask = SOCKET_EVENT_RX_READY;
+        xEventDesc.eventFlags = 0;
+        if (socketPoll(&xEventDesc, 1, &xClientEvent, prvNextWait()) == NO_ERROR &&
+            (xEventDesc.eventFlags & SOCKET_EVENT_RX_READY) != 0)
+        {
+            prvReceive();
+        }
+    }
+}
+
+BaseType_t xMqttSnClientStart(UBaseType_t uxPriority)
+{
+    const uint8_t *pucMac = netInterface[0].macAddr.b;
+
+    xSendQueue = xAppQueueCreate(xSendQueue, MQTT_SN_CLIENT_WINDOW, sizeof(uint8_t));
+    xFreeSlots = xAppSemaphoreCreateCounting(xFreeSlots, MQTT_SN_CLIENT_WINDOW, MQTT_SN_CLIENT_WINDOW);
+    if (xSendQueue == NULL || xFreeSlots == NULL || !osCreateEvent(&xClientEvent))
+    {
+        return pdFAIL;
+    }
+
+    /* Stable across reboots, for the gateway to find the session again */
+    snprintf(cClientId, sizeof(cClientId), "h7-%02x%02x%02x%02x%02x%02x",
+             pucMac[0], pucMac[1], pucMac[2], pucMac[3], pucMac[4], pucMac[5]);
+
+    return xAppTaskCreate(xMqttSnTask,
+                          prvMqttSnClientTask,
+                          "MQTT-SN",
+                          MQTT_SN_CLIENT_TASK_STACK_SIZE,
+                          NULL,
+                          uxPriority,
+                          NULL);
+}
+
+BaseType_t xMqttSnClientConfigure(const char *pcAddress, uint16_t usPort)
+{
+    IpAddr xAddr;
+
+    if (pcAddress == NULL)
+    {
+        xClientEnabled = pdFALSE;
+        osSetEvent(&xClientEvent);
+        return pdPASS;
+    }
+
+    if (ipStringToAddr(pcAddress, &xAddr) != NO_ERROR || xAddr.length != sizeof(Ipv4Addr))
+    {
+        return pdFAIL;
+    }
+
+    taskENTER_CRITICAL();
+    xGatewayAddr = xAddr;
+    usGatewayPort = (usPort != 0) ? usPort : MQTT_SN_CLIENT_PORT;
+    ulClientGeneration++;
+    xClientEnabled = pdTRUE;
+    taskEXIT_CRITICAL();
+
+    osSetEvent(&xClientEvent);
+    return pdPASS;
+}
+
+BaseType_t xMqttSnClientPublish(uint16_t usTopicId, const void *pvPayload, size_t xLength,
+                                BaseType_t xQos, TickType_t xTimeout)
+{
+    MqttSnSlot_t *pxSlot = NULL;
+    uint8_t ucIndex = 0;
+    UBaseType_t i;
+
+    if (xFreeSlots == NULL || xQos < MQTT_SN_QOS_MINUS_ONE || xQos > 1 || xLength > MQTT_SN_CLIENT_MESSAGE_SIZE)
+    {
+        return pdFAIL;
+    }
+
+    if (xSemaphoreTake(xFreeSlots, xTimeout) != pdPASS)
+    {
+        taskENTER_CRITICAL();
+        xClientStats.ulDropped++;
+        taskEXIT_CRITICAL();
+        return pdFAIL;
+    }
+
+    /* The semaphore guarantees a free slot */
+    taskENTER_CRITICAL();
+    for (i = 0; i < MQTT_SN_CLIENT_WINDOW; i++)
+    {
+        if (xSlots[i].ucState == eSnSlotFree)
+        {
+            pxSlot = &xSlots[i];
+            pxSlot->ucState = eSnSlotFilling;
+            ucIndex = (uint8_t) i;
+            break;
+        }
+    }
+    xClientStats.ulPublished++;
+    taskEXIT_CRITICAL();
+    configASSERT(pxSlot != NULL);
+
+    pxSlot->cQos = (int8_t) xQos;
+    pxSlot->usTopicId = usTopicId;
+    pxSlot->ucLength = (uint8_t) xLength;
+    memcpy(pxSlot->ucData, pvPayload, xLength);
+    pxSlot->ucState = eSnSlotQueued;
+
+    /* Never full: it has room for every slot */
+    (void) xQueueSend(xSendQueue, &ucIndex, 0);
+    osSetEvent(&xClientEvent);
+
+    return pdPASS;
+}
+
+UBaseType_t uxMqttSnClientPending(void)
+{
+    return (xFreeSlots != NULL) ? MQTT_SN_CLIENT_WINDOW - uxSemaphoreGetCount(xFreeSlots) : 0;
+}
+
+void vMqttSnClientGetStats(MqttSnClientStats_t *pxStats)
+{
+    *pxStats = xClientStats;
+}
+
+/* Publish ulCount messages on topic 1 and wait for the window to drain */
+static void prvBench(char *pcWriteBuffer, size_t xWriteBufferLen, uint32_t ulCount, BaseType_t xQos)
+{
+    uint8_t ucPayload[MQTT_SN_BENCH_PAYLOAD];
+    TickType_t xStart;
+    TickType_t xElapsed;
+    uint32_t ulQueued = 0;
+    uint32_t i;
+
+    memset(ucPayload, 'x', sizeof(ucPayload));
+
+    xStart = xTaskGetTickCount();
+    for (i = 0; i < ulCount; i++)
+    {
+        memcpy(ucPayload, &i, sizeof(i));
+        if (xMqttSnClientPublish(1, ucPayload, sizeof(ucPayload), xQos,
+                                 pdMS_TO_TICKS(MQTT_SN_CLIENT_RETRY_MS)) != pdPASS)
+        {
+            break;
+        }
+        ulQueued++;
+    }
+
+    while (uxMqttSnClientPending() > 0 &&
+           xTaskGetTickCount() - xStart < pdMS_TO_TICKS(ulCount + MQTT_SN_CLIENT_RETRY_MS))
+    {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    xElapsed = (xTaskGetTickCount() - xStart) * portTICK_PERIOD_MS;
+    if (xElapsed == 0)
+    {
+        xElapsed = 1;
+    }
+
+    snprintf(pcWriteBuffer, xWriteBufferLen, "%lu of %lu messages at QoS %ld in %lu ms: %lu msg/s, %lu pending\r\n",
+             (unsigned long) ulQueued, (unsigned long) ulCount, (long) xQos, (unsigned long) xElapsed,
+             (unsigned long) ((uint64_t) ulQueued * 1000u / xElapsed),
+             (unsigned long) uxMqttSnClientPending());
+}
+
+static BaseType_t prvMqttSnCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    static UBaseType_t uxLine = 0;
+    const char *pcParameter;
+    BaseType_t xLength;
+    char cAddr[40];
+    unsigned long ulValue;
+    long lQos;
+    IpAddr xAddr;
+
+    if (uxLine == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xLength);
+        if (pcParameter != NULL)
+        {
+            if (xLength == 3 && strncmp(pcParameter, "off", 3) == 0)
+            {
+                (void) xMqttSnClientConfigure(NULL, 0);
+                snprintf(pcWriteBuffer, xWriteBufferLen, "MQTT-SN stopped, %lu messages kept\r\n",
+                         (unsigned long) uxMqttSnClientPending());
+                return pdFALSE;
+            }
+
+            if (xLength == 3 && strncmp(pcParameter, "pub", 3) == 0)
+            {
+                pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xLength);
+                ulValue = (pcParameter != NULL) ? strtoul(pcParameter, NULL, 0) : 0;
+                pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 3, &xLength);
+                lQos = (pcParameter != NULL) ? strtol(pcParameter, NULL, 10) : 2;
+                pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 4, &xLength);
+                if (ulValue == 0 || ulValue > 0xFFFEu || lQos < -1 || lQos > 1 || pcParameter == NULL)
+                {
+                    snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: mqttsn pub <topic-id> <-1|0|1> <text>\r\n");
+                    return pdFALSE;
+                }
+
+                /* The text is the rest of the line, spaces included */
+                if (xMqttSnClientPublish((uint16_t) ulValue, pcParameter, strlen(pcParameter),
+                                         (BaseType_t) lQos, 0) != pdPASS)
+                {
+                    snprintf(pcWriteBuffer, xWriteBufferLen, "Not queued: window full or message too long\r\n");
+                    return pdFALSE;
+                }
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Queued\r\n");
+                return pdFALSE;
+            }
+
+            if (xLength == 5 && strncmp(pcParameter, "bench", 5) == 0)
+            {
+                pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xLength);
+                ulValue = (pcParameter != NULL) ? strtoul(pcParameter, NULL, 10) : 0;
+                pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 3, &xLength);
+                lQos = (pcParameter != NULL) ? strtol(pcParameter, NULL, 10) : 1;
+                if (ulValue == 0 || lQos < -1 || lQos > 1)
+                {
+                    snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: mqttsn bench <count> [<-1|0|1>]\r\n");
+                    return pdFALSE;
+                }
+                if (xClientEnabled == pdFALSE)
+                {
+                    snprintf(pcWriteBuffer, xWriteBufferLen, "No gateway\r\n");
+                    return pdFALSE;
+                }
+
+                prvBench(pcWriteBuffer, xWriteBufferLen, (uint32_t) ulValue, (BaseType_t) lQos);
+                return pdFALSE;
+            }
+
+            if ((size_t) xLength >= sizeof(cAddr))
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid address\r\n");
+                return pdFALSE;
+            }
+            memcpy(cAddr, pcParameter, xLength);
+            cAddr[xLength] = '\0';
+
+            pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xLength);
+            ulValue = (pcParameter != NULL) ? strtoul(pcParameter, NULL, 10) : 0;
+            if (ulValue > 65535 || (pcParameter != NULL && ulValue == 0))
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid port\r\n");
+                return pdFALSE;
+            }
+
+            if (xMqttSnClientConfigure(cAddr, (uint16_t) ulValue) != pdPASS)
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid address\r\n");
+                return pdFALSE;
+            }
+            snprintf(pcWriteBuffer, xWriteBufferLen, "MQTT-SN gateway %s port %u\r\n", cAddr, usGatewayPort);
+            return pdFALSE;
+        }
+
+        if (xClientEnabled != pdFALSE)
+        {
+            taskENTER_CRITICAL();
+            xAddr = xGatewayAddr;
+            taskEXIT_CRITICAL();
+            ipAddrToString(&xAddr, cAddr);
+        }
+        else
+        {
+            strcpy(cAddr, "off");
+        }
+
+        snprintf(pcWriteBuffer, xWriteBufferLen, "gateway: %s port %u, %s, client %s, pending %lu/%u\r\n",
+                 cAddr, usGatewayPort, pcStateNames[eState], cClientId,
+                 (unsigned long) uxMqttSnClientPending(), MQTT_SN_CLIENT_WINDOW);
+        uxLine++;
+        return pdTRUE;
+    }
+
+    snprintf(pcWriteBuffer, xWriteBufferLen,
+             "published=%lu sent=%lu acked=%lu retransmitted=%lu rejected=%lu dropped=%lu "
+             "datagrams=%lu batches=%lu connects=%lu sleeps=%lu gateway-lost=%lu\r\n",
+             (unsigned long) xClientStats.ulPublished, (unsigned long) xClientStats.ulSent,
+             (unsigned long) xClientStats.ulAcked, (unsigned long) xClientStats.ulRetransmitted,
+             (unsigned long) xClientStats.ulRejected, (unsigned long) xClientStats.ulDropped,
+             (unsigned long) xClientStats.ulDatagrams, (unsigned long) xClientStats.ulBatches,
+             (unsigned long) xClientStats.ulConnects, (unsigned long) xClientStats.ulSleeps,
+             (unsigned long) xClientStats.ulGatewayLost);
+    uxLine = 0;
+    return pdFALSE;
+}
+
+void vMqttSnClientRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xMqttSn);
+}
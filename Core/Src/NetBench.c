@@ -0,0 +1,942 @@
+/* NetBench.c
+ *
+ * On-target throughput and latency benchmarks built on the CycloneTCP socket
+ * API:
+ *  - iperf2 compatible TCP and UDP server ("iperf -s [-u]") and client
+ *    ("iperf -c <ip> [-u]"). UDP runs use the iperf2 datagram header and
+ *    final server report, so loss, reordering and jitter are exchanged with
+ *    a stock "iperf -u" on the host.
+ *  - A UDP echo responder ("udp-echo") for round-trip latency measurements
+ *    from the host.
+ *
+ * One benchmark runs at a time, in its own task. The CLI command starts it
+ * and attaches a console job that prints a line per second and a summary
+ * with Mbit/s, packets/s, CPU load and the memory pool high-water mark.
+ */
+#include "NetBench.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "CommandConsoleDualTask.h"
+#include "RunTimeStats.h"
+#include "MonoClock.h"
+#include "StaticAlloc.h"
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/tcp_congest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* iperf2 UDP datagram header: id, tv_sec, tv_usec (network byte order) */
+#define IPERF_UDP_HEADER_SIZE      12
+
+/* iperf2 server report following the datagram header (server_hdr_v1) */
+#define IPERF_SERVER_REPORT_SIZE   40
+#define IPERF_HEADER_VERSION1      0x80000000u
+
+/* Retries of the final datagram while waiting for the server report */
+#define IPERF_FIN_RETRIES          10
+#define IPERF_FIN_WAIT_MS          250
+
+typedef enum
+{
+    eBenchIdle = 0,
+    eBenchTcpServer,
+    eBenchUdpServer,
+    eBenchTcpClient,
+    eBenchUdpClient,
+    eBenchUdpEcho
+} BenchMode_t;
+
+/* Parameters of a run, set by the CLI before waking the task */
+typedef struct
+{
+    BenchMode_t eMode;
+    IpAddr xPeer;
+    uint16_t usPort;
+    uint32_t ulSeconds;
+    uint32_t ulRate;        /* bit/s, 0 for unlimited (UDP client) */
+    size_t xLength;
+    TcpCongestAlgoType eCongestAlgo;    /* TCP runs */
+} BenchRequest_t;
+
+/* Outcome of a run, or of one session of a server */
+typedef struct
+{
+    BenchMode_t eMode;
+    uint64_t ullBytes;
+    uint32_t ulPackets;
+    uint64_t ullElapsedUs;
+    uint32_t ulLost;
+    uint32_t ulOutOfOrder;
+    uint32_t ulJitterUs;
+    BaseType_t xPeerReport; /* UDP client: loss and jitter come from the server */
+    uint32_t ulCpuPermille;
+    uint_t uxPoolPeak;
+    uint_t uxPoolSize;
+} BenchResult_t;
+
+/* State of the console job following a run */
+typedef struct
+{
+    uint32_t ulSession;
+    uint64_t ullBytes;
+    uint32_t ulPackets;
+    uint64_t ullTimeUs;
+    BaseType_t xStopAfterReport;
+} BenchMonitor_t;
+
+static TaskHandle_t xBenchTask = NULL;
+APP_TASK_STORAGE(xBenchTask, NET_BENCH_STACK_SIZE);
+static BenchRequest_t xRequest;
+static volatile BenchMode_t eBenchMode = eBenchIdle;
+static volatile BaseType_t xStopRequested = pdFALSE;
+
+/* Progress of the current session, written by the benchmark task only */
+static volatile BaseType_t xSessionActive = pdFALSE;
+static volatile uint64_t ullSessionBytes = 0;
+static volatile uint32_t ulSessionPackets = 0;
+
+/* Completed sessions; xLastResult is valid once ulSessionCount changes */
+static volatile uint32_t ulSessionCount = 0;
+static BenchResult_t xLastResult;
+
+static uint8_t ucBuffer[NET_BENCH_BUFFER_SIZE];
+
+/* Session bookkeeping */
+static uint64_t ullSessionStartUs;
+static RunTimeLoadSample_t xSessionLoad;
+
+static const char * const pcModeNames[] =
+{
+    "idle", "TCP server", "UDP server", "TCP client", "UDP client", "UDP echo"
+};
+
+static BaseType_t prvIperfCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+static BaseType_t prvUdpEchoCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xIperf =
+{
+    "iperf",
+    "\r\niperf -s|-c <ip> [-u -p port -t s -b rate -l len -Z algo] | stop:\r\n"
+    " iperf2 compatible test, algo reno|cubic|bbr-lite\r\n",
+    prvIperfCommand,
+    -1
+};
+
+static const CLI_Command_Definition_t xUdpEcho =
+{
+    "udp-echo",
+    "\r\nudp-echo [port] | stop:\r\n UDP echo responder for round-trip latency tests\r\n",
+    prvUdpEchoCommand,
+    -1
+};
+
+/* Microseconds since boot */
+static uint64_t prvNowUs(void)
+{
+    return ullMonoClockNowUs();
+}
+
+static void prvSessionBegin(void)
+{
+    ullSessionBytes = 0;
+    ulSessionPackets = 0;
+    ullSessionStartUs = prvNowUs();
+    vRunTimeStatsGetLoadSample(&xSessionLoad);
+    xSessionActive = pdTRUE;
+}
+
+static void prvSessionAccount(size_t xLength)
+{
+    ullSessionBytes += xLength;
+    ulSessionPackets++;
+}
+
+/* Close the session; pxResult holds the protocol specific fields */
+static void prvSessionEnd(BenchResult_t *pxResult, uint64_t ullEndUs)
+{
+    RunTimeLoadSample_t xEnd;
+    uint_t uxCurrent;
+
+    vRunTimeStatsGetLoadSample(&xEnd);
+    memPoolGetStats(&uxCurrent, &pxResult->uxPoolPeak, &pxResult->uxPoolSize);
+
+    pxResult->eMode = eBenchMode;
+    pxResult->ullBytes = ullSessionBytes;
+    pxResult->ulPackets = ulSessionPackets;
+    pxResult->ullElapsedUs = ullEndUs - ullSessionStartUs;
+    pxResult->ulCpuPermille = ulRunTimeStatsLoadPermille(&xSessionLoad, &xEnd);
+
+    xLastResult = *pxResult;
+    xSessionActive = pdFALSE;
+    ulSessionCount++;
+}
+
+/* iperf2 timestamps: seconds and microseconds of the sender's clock */
+static void prvIperfStoreHeader(uint8_t *pucHeader, int32_t lId, uint64_t ullUs)
+{
+    STORE32BE((uint32_t) lId, pucHeader);
+    STORE32BE((uint32_t) (ullUs / 1000000u), pucHeader + 4);
+    STORE32BE((uint32_t) (ullUs % 1000000u), pucHeader + 8);
+}
+
+static void prvTcpServer(void)
+{
+    Socket *pxListener;
+    Socket *pxClient;
+    BenchResult_t xResult;
+    uint64_t ullLastUs;
+    size_t xReceived;
+    error_t error;
+
+    pxListener = socketOpen(SOCKET_TYPE_STREAM, SOCKET_IP_PROTO_TCP);
+    if (pxListener == NULL)
+    {
+        return;
+    }
+
+    /* Accepted connections inherit the congestion control algorithm and the
+     * buffer setup; on failure the defaults are kept */
+    socketSetCongestionControl(pxListener, xRequest.eCongestAlgo);
+    if (socketEnableLargeBuffers(pxListener, TRUE) == NO_ERROR)
+    {
+        socketSetRxBufferSize(pxListener, NET_BENCH_TCP_WINDOW);
+    }
+    socketSetTimeout(pxListener, NET_BENCH_POLL_MS);
+    socketBind(pxListener, &IP_ADDR_ANY, xRequest.usPort);
+    socketListen(pxListener, 1);
+
+    while (xStopRequested == pdFALSE)
+    {
+        pxClient = socketAccept(pxListener, NULL, NULL);
+        if (pxClient == NULL)
+        {
+            continue;
+        }
+
+        socketSetTimeout(pxClient, NET_BENCH_POLL_MS);
+        prvSessionBegin();
+        ullLastUs = ullSessionStartUs;
+
+        /* Discard everything until the client closes the connection */
+        while (xStopRequested == pdFALSE)
+        {
+            error = socketReceive(pxClient, ucBuffer, sizeof(ucBuffer), &xReceived, 0);
+            if (xReceived > 0)
+            {
+                prvSessionAccount(xReceived);
+                ullLastUs = prvNowUs();
+            }
+
+            if (error != NO_ERROR && error != ERROR_TIMEOUT)
+            {
+                break;
+            }
+        }
+
+        memset(&xResult, 0, sizeof(xResult));
+        prvSessionEnd(&xResult, ullLastUs);
+        socketClose(pxClient);
+    }
+
+    socketClose(pxListener);
+}
+
+/* Final report sent back to an iperf2 UDP client (server_hdr_v1) */
+static void prvUdpServerReport(Socket *pxSocket, const IpAddr *pxPeer, uint16_t usPeerPort,
+                               const uint8_t *pucFin, uint32_t ulLastId)
+{
+    uint8_t ucReport[IPERF_UDP_HEADER_SIZE + IPERF_SERVER_REPORT_SIZE];
+    uint8_t *p = ucReport + IPERF_UDP_HEADER_SIZE;
+
+    memcpy(ucReport, pucFin, IPERF_UDP_HEADER_SIZE);
+    STORE32BE(IPERF_HEADER_VERSION1, p);
+    STORE32BE((uint32_t) (xLastResult.ullBytes >> 32), p + 4);
+    STORE32BE((uint32_t) xLastResult.ullBytes, p + 8);
+    STORE32BE((uint32_t) (xLastResult.ullElapsedUs / 1000000u), p + 12);
+    STORE32BE((uint32_t) (xLastResult.ullElapsedUs % 1000000u), p + 16);
+    STORE32BE(xLastResult.ulLost, p + 20);
+    STORE32BE(xLastResult.ulOutOfOrder, p + 24);
+    STORE32BE(ulLastId, p + 28);
+    STORE32BE(xLastResult.ulJitterUs / 1000000u, p + 32);
+    STORE32BE(xLastResult.ulJitterUs % 1000000u, p + 36);
+
+    socketSendTo(pxSocket, pxPeer, usPeerPort, ucReport, sizeof(ucReport), NULL, 0);
+}
+
+static void prvUdpServer(void)
+{
+    Socket *pxSocket;
+    BenchResult_t xResult;
+    IpAddr xPeer;
+    uint16_t usPeerPort;
+    size_t xReceived;
+    error_t error;
+    int32_t lId;
+    int32_t lLastId = -1;
+    uint64_t ullNowUs;
+    uint64_t ullLastUs = 0;
+    int64_t llTransit;
+    int64_t llLastTransit = 0;
+    int64_t llDelta;
+    uint64_t ullJitter16 = 0;   /* RFC 1889 jitter, in 1/16 us */
+
+    pxSocket = socketOpen(SOCKET_TYPE_DGRAM, SOCKET_IP_PROTO_UDP);
+    if (pxSocket == NULL)
+    {
+        return;
+    }
+
+    socketSetTimeout(pxSocket, NET_BENCH_POLL_MS);
+    socketBind(pxSocket, &IP_ADDR_ANY, xRequest.usPort);
+
+    memset(&xResult, 0, sizeof(xResult));
+
+    while (xStopRequested == pdFALSE)
+    {
+        error = socketReceiveFrom(pxSocket, &xPeer, &usPeerPort, ucBuffer, sizeof(ucBuffer), &xReceived, 0);
+        ullNowUs = prvNowUs();
+
+        if (error != NO_ERROR)
+        {
+            /* A client that vanished without its final datagram */
+            if (xSessionActive != pdFALSE && (ullNowUs - ullLastUs) > NET_BENCH_UDP_IDLE_MS * 1000u)
+            {
+                prvSessionEnd(&xResult, ullLastUs);
+            }
+            continue;
+        }
+
+        if (xReceived < IPERF_UDP_HEADER_SIZE)
+        {
+            continue;
+        }
+
+        lId = (int32_t) LOAD32BE(ucBuffer);
+
+        /* A negative id ends the run; repeated final datagrams get the same report */
+        if (lId < 0)
+        {
+            if (xSessionActive != pdFALSE)
+            {
+                xResult.ulJitterUs = (uint32_t) (ullJitter16 / 16u);
+                prvSessionEnd(&xResult, ullLastUs);
+            }
+            prvUdpServerReport(pxSocket, &xPeer, usPeerPort, ucBuffer, (uint32_t) (lLastId + 1));
+            continue;
+        }
+
+        if (xSessionActive == pdFALSE)
+        {
+            memset(&xResult, 0, sizeof(xResult));
+            prvSessionBegin();
+            lLastId = lId - 1;
+            ullJitter16 = 0;
+        }
+
+        prvSessionAccount(xReceived);
+        ullLastUs = ullNowUs;
+
+        /* Loss and reordering, as counted by iperf2 */
+        if (lId != lLastId + 1)
+        {
+            if (lId < lLastId + 1)
+            {
+                xResult.ulOutOfOrder++;
+            }
+            else
+            {
+                xResult.ulLost += (uint32_t) (lId - lLastId - 1);
+            }
+        }
+        if (lId > lLastId)
+        {
+            lLastId = lId;
+        }
+
+        /* Jitter: variation of the transit time; the clock offset cancels out */
+        llTransit = (int64_t) ullNowUs -
+                    ((int64_t) LOAD32BE(ucBuffer + 4) * 1000000 + (int64_t) LOAD32BE(ucBuffer + 8));
+        if (ulSessionPackets > 1)
+        {
+            llDelta = llTransit - llLastTransit;
+            if (llDelta < 0)
+            {
+                llDelta = -llDelta;
+            }
+            ullJitter16 += (uint64_t) llDelta - (ullJitter16 + 8) / 16;
+        }
+        llLastTransit = llTransit;
+    }
+
+    if (xSessionActive != pdFALSE)
+    {
+        xResult.ulJitterUs = (uint32_t) (ullJitter16 / 16u);
+        prvSessionEnd(&xResult, ullLastUs);
+    }
+
+    socketClose(pxSocket);
+}
+
+static void prvTcpClient(void)
+{
+    Socket *pxSocket;
+    BenchResult_t xResult;
+    uint64_t ullEndUs;
+    size_t xWritten;
+    error_t error;
+
+    pxSocket = socketOpen(SOCKET_TYPE_STREAM, SOCKET_IP_PROTO_TCP);
+    if (pxSocket == NULL)
+    {
+        return;
+    }
+
+    socketSetCongestionControl(pxSocket, xRequest.eCongestAlgo);
+    if (socketEnableLargeBuffers(pxSocket, TRUE) == NO_ERROR)
+    {
+        socketSetTxBufferSize(pxSocket, NET_BENCH_TCP_WINDOW);
+    }
+    socketSetTimeout(pxSocket, 5000);
+    if (socketConnect(pxSocket, &xRequest.xPeer, xRequest.usPort) != NO_ERROR)
+    {
+        socketClose(pxSocket);
+        return;
+    }
+
+    /* A zeroed first block is the iperf2 header of a plain one-way test */
+    memset(ucBuffer, 0, sizeof(ucBuffer));
+    socketSetTimeout(pxSocket, NET_BENCH_POLL_MS);
+
+    prvSessionBegin();
+    ullEndUs = ullSessionStartUs + (uint64_t) xRequest.ulSeconds * 1000000u;
+
+    while (xStopRequested == pdFALSE && prvNowUs() < ullEndUs)
+    {
+        error = socketSend(pxSocket, ucBuffer, xRequest.xLength, &xWritten, 0);
+        if (xWritten > 0)
+        {
+            prvSessionAccount(xWritten);
+        }
+
+        if (error != NO_ERROR && error != ERROR_TIMEOUT)
+        {
+            break;
+        }
+    }
+
+    /* Elapsed time runs until the peer has everything */
+    socketSetTimeout(pxSocket, 5000);
+    socketShutdown(pxSocket, SOCKET_SD_SEND);
+
+    memset(&xResult, 0, sizeof(xResult));
+    prvSessionEnd(&xResult, prvNowUs());
+
+    socketClose(pxSocket);
+}
+
+static void prvUdpClient(void)
+{
+    Socket *pxSocket;
+    BenchResult_t xResult;
+    IpAddr xPeer;
+    uint16_t usPeerPort;
+    size_t xReceived;
+    uint64_t ullNowUs;
+    uint64_t ullEndUs;
+    uint64_t ullIntervalUs;
+    int32_t lId = 0;
+    UBaseType_t i;
+
+    pxSocket = socketOpen(SOCKET_TYPE_DGRAM, SOCKET_IP_PROTO_UDP);
+    if (pxSocket == NULL)
+    {
+        return;
+    }
+
+    memset(ucBuffer, 0, sizeof(ucBuffer));
+    memset(&xResult, 0, sizeof(xResult));
+
+    /* Inter-datagram gap for the requested rate */
+    ullIntervalUs = (xRequest.ulRate > 0) ?
+                    ((uint64_t) xRequest.xLength * 8u * 1000000u) / xRequest.ulRate : 0;
+
+    prvSessionBegin();
+    ullEndUs = ullSessionStartUs + (uint64_t) xRequest.ulSeconds * 1000000u;
+
+    while (xStopRequested == pdFALSE)
+    {
+        ullNowUs = prvNowUs();
+        if (ullNowUs >= ullEndUs)
+        {
+            break;
+        }
+
+        /* Catch up with the schedule, then sleep for a tick */
+        if (ullIntervalUs > 0 && ullNowUs < ullSessionStartUs + (uint64_t) lId * ullIntervalUs)
+        {
+            vTaskDelay(1);
+            continue;
+        }
+
+        prvIperfStoreHeader(ucBuffer, lId, ullNowUs);
+        if (socketSendTo(pxSocket, &xRequest.xPeer, xRequest.usPort, ucBuffer, xRequest.xLength, NULL, 0) == NO_ERROR)
+        {
+            prvSessionAccount(xRequest.xLength);
+        }
+        lId++;
+
+        if (ullIntervalUs == 0)
+        {
+            taskYIELD();
+        }
+    }
+
+    ullNowUs = prvNowUs();
+
+    /* Final datagram, repeated until the server answers with its report */
+    socketSetTimeout(pxSocket, IPERF_FIN_WAIT_MS);
+    for (i = 0; i < IPERF_FIN_RETRIES; i++)
+    {
+        prvIperfStoreHeader(ucBuffer, -lId, prvNowUs());
+        socketSendTo(pxSocket, &xRequest.xPeer, xRequest.usPort, ucBuffer, xRequest.xLength, NULL, 0);
+
+        if (socketReceiveFrom(pxSocket, &xPeer, &usPeerPort, ucBuffer, sizeof(ucBuffer), &xReceived, 0) == NO_ERROR &&
+            xReceived >= IPERF_UDP_HEADER_SIZE + IPERF_SERVER_REPORT_SIZE)
+        {
+            const uint8_t *p = ucBuffer + IPERF_UDP_HEADER_SIZE;
+
+            xResult.xPeerReport = pdTRUE;
+            xResult.ulLost = LOAD32BE(p + 20);
+            xResult.ulOutOfOrder = LOAD32BE(p + 24);
+            xResult.ulJitterUs = LOAD32BE(p + 32) * 1000000u + LOAD32BE(p + 36);
+            break;
+        }
+    }
+
+    prvSessionEnd(&xResult, ullNowUs);
+
+    socketClose(pxSocket);
+}
+
+static void prvUdpEcho(void)
+{
+    Socket *pxSocket;
+    BenchResult_t xResult;
+    IpAddr xPeer;
+    uint16_t usPeerPort;
+    size_t xReceived;
+
+    pxSocket = socketOpen(SOCKET_TYPE_DGRAM, SOCKET_IP_PROTO_UDP);
+    if (pxSocket == NULL)
+    {
+        return;
+    }
+
+    socketSetTimeout(pxSocket, NET_BENCH_POLL_MS);
+    socketBind(pxSocket, &IP_ADDR_ANY, xRequest.usPort);
+
+    prvSessionBegin();
+
+    while (xStopRequested == pdFALSE)
+    {
+        if (socketReceiveFrom(pxSocket, &xPeer, &usPeerPort, ucBuffer, sizeof(ucBuffer), &xReceived, 0) != NO_ERROR)
+        {
+            continue;
+        }
+
+        socketSendTo(pxSocket, &xPeer, usPeerPort, ucBuffer, xReceived, NULL, 0);
+        prvSessionAccount(xReceived);
+    }
+
+    memset(&xResult, 0, sizeof(xResult));
+    prvSessionEnd(&xResult, prvNowUs());
+
+    socketClose(pxSocket);
+}
+
+static void prvNetBenchTask(void *pvParameters)
+{
+    (void) pvParameters;
+
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        switch (xRequest.eMode)
+        {
+        case eBenchTcpServer: prvTcpServer(); break;
+        case eBenchUdpServer: prvUdpServer(); break;
+        case eBenchTcpClient: prvTcpClient(); break;
+        case eBenchUdpClient: prvUdpClient(); break;
+        case eBenchUdpEcho:   prvUdpEcho();   break;
+        default: break;
+        }
+
+        xSessionActive = pdFALSE;
+        eBenchMode = eBenchIdle;
+    }
+}
+
+BaseType_t xNetBenchStart(UBaseType_t uxPriority)
+{
+    return xAppTaskCreate(xBenchTask, prvNetBenchTask, "NetBench", NET_BENCH_STACK_SIZE, NULL, uxPriority, &xBenchTask);
+}
+
+void vNetBenchRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xIperf);
+    FreeRTOS_CLIRegisterCommand(&xUdpEcho);
+}
+
+/* Hand a request to the benchmark task; fails if a run is in progress */
+static BaseType_t prvBenchRequest(const BenchRequest_t *pxRequest)
+{
+    if (xBenchTask == NULL || eBenchMode != eBenchIdle)
+    {
+        return pdFAIL;
+    }
+
+    xRequest = *pxRequest;
+    xStopRequested = pdFALSE;
+    eBenchMode = pxRequest->eMode;
+    xTaskNotifyGive(xBenchTask);
+
+    return pdPASS;
+}
+
+/* Stop the current run and give it up to a second to wind down */
+static void prvBenchStop(void)
+{
+    UBaseType_t i;
+
+    xStopRequested = pdTRUE;
+    for (i = 0; i < 10 && eBenchMode != eBenchIdle; i++)
+    {
+        vTaskDelay(pdMS_TO_TICKS(NET_BENCH_POLL_MS / 2));
+    }
+}
+
+/* Throughput in kbit/s over a byte count and a duration */
+static uint32_t prvKbps(uint64_t ullBytes, uint64_t ullUs)
+{
+    return (ullUs > 0) ? (uint32_t) ((ullBytes * 8000u) / ullUs) : 0;
+}
+
+static uint32_t prvPerSecond(uint32_t ulCount, uint64_t ullUs)
+{
+    return (ullUs > 0) ? (uint32_t) (((uint64_t) ulCount * 1000000u) / ullUs) : 0;
+}
+
+/* Console job: interval lines while a session runs, a summary when it ends */
+static eConsoleJobResult prvBenchMonitorJob(char *pcWriteBuffer, size_t xWriteBufferLen, void *pvContext)
+{
+    BenchMonitor_t *pxMonitor = (BenchMonitor_t *) pvContext;
+    const BenchResult_t *pxResult = &xLastResult;
+    uint64_t ullNowUs;
+    uint64_t ullBytes;
+    uint32_t ulPackets;
+    uint32_t ulKbps;
+    size_t xLength;
+
+    if (ulSessionCount != pxMonitor->ulSession)
+    {
+        pxMonitor->ulSession = ulSessionCount;
+        pxMonitor->ullBytes = 0;
+        pxMonitor->ulPackets = 0;
+        pxMonitor->ullTimeUs = prvNowUs();
+
+        ulKbps = prvKbps(pxResult->ullBytes, pxResult->ullElapsedUs);
+        xLength = snprintf(pcWriteBuffer, xWriteBufferLen,
+                           "%s: %lu.%02lu Mbit/s, %lu pkt/s over %lu ms, CPU %lu.%lu%%, pool peak %u/%u",
+                           pcModeNames[pxResult->eMode],
+                           (unsigned long) (ulKbps / 1000), (unsigned long) ((ulKbps % 1000) / 10),
+                           (unsigned long) prvPerSecond(pxResult->ulPackets, pxResult->ullElapsedUs),
+                           (unsigned long) (pxResult->ullElapsedUs / 1000u),
+                           (unsigned long) (pxResult->ulCpuPermille / 10), (unsigned long) (pxResult->ulCpuPermille % 10),
+                           pxResult->uxPoolPeak, pxResult->uxPoolSize);
+
+        if ((pxResult->eMode == eBenchUdpServer || pxResult->xPeerReport != pdFALSE) && xLength < xWriteBufferLen)
+        {
+            xLength += snprintf(pcWriteBuffer + xLength, xWriteBufferLen - xLength,
+                                ", lost %lu, reordered %lu, jitter %lu us",
+                                (unsigned long) pxResult->ulLost, (unsigned long) pxResult->ulOutOfOrder,
+                                (unsigned long) pxResult->ulJitterUs);
+        }
+        if (xLength < xWriteBufferLen)
+        {
+            snprintf(pcWriteBuffer + xLength, xWriteBufferLen - xLength, "\r\n");
+        }
+
+        return (pxMonitor->xStopAfterReport != pdFALSE) ? eConsoleJobDone : eConsoleJobWait;
+    }
+
+    if (eBenchMode == eBenchIdle)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Benchmark stopped\r\n");
+        return eConsoleJobDone;
+    }
+
+    if (xSessionActive != pdFALSE)
+    {
+        ullNowUs = prvNowUs();
+        ullBytes = ullSessionBytes;
+        ulPackets = ulSessionPackets;
+
+        /* A new session restarted the counters */
+        if (ullBytes < pxMonitor->ullBytes)
+        {
+            pxMonitor->ullBytes = 0;
+            pxMonitor->ulPackets = 0;
+        }
+
+        ulKbps = prvKbps(ullBytes - pxMonitor->ullBytes, ullNowUs - pxMonitor->ullTimeUs);
+        snprintf(pcWriteBuffer, xWriteBufferLen, "  %lu.%02lu Mbit/s, %lu pkt/s\r\n",
+                 (unsigned long) (ulKbps / 1000), (unsigned long) ((ulKbps % 1000) / 10),
+                 (unsigned long) prvPerSecond(ulPackets - pxMonitor->ulPackets, ullNowUs - pxMonitor->ullTimeUs));
+
+        pxMonitor->ullBytes = ullBytes;
+        pxMonitor->ulPackets = ulPackets;
+        pxMonitor->ullTimeUs = ullNowUs;
+    }
+    else
+    {
+        pxMonitor->ullTimeUs = prvNowUs();
+    }
+
+    return eConsoleJobWait;
+}
+
+/* Start a run and the console job reporting on it */
+static void prvBenchLaunch(char *pcWriteBuffer, size_t xWriteBufferLen, const BenchRequest_t *pxRequest)
+{
+    BenchMonitor_t xMonitor;
+    UBaseType_t uxJob;
+
+    if (prvBenchRequest(pxRequest) != pdPASS)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "A benchmark is already running (%s), stop it first\r\n",
+                 pcModeNames[eBenchMode]);
+        return;
+    }
+
+    memset(&xMonitor, 0, sizeof(xMonitor));
+    xMonitor.ulSession = ulSessionCount;
+    xMonitor.ullTimeUs = prvNowUs();
+    xMonitor.xStopAfterReport = (pxRequest->eMode == eBenchTcpClient || pxRequest->eMode == eBenchUdpClient);
+
+    uxJob = 0;
+    if (pxRequest->eMode != eBenchUdpEcho)
+    {
+        uxJob = uxCommandConsoleJobStart("iperf", prvBenchMonitorJob, &xMonitor, sizeof(xMonitor),
+                                         pdMS_TO_TICKS(NET_BENCH_REPORT_MS));
+    }
+
+    snprintf(pcWriteBuffer, xWriteBufferLen, "%s started on port %u%s\r\n",
+             pcModeNames[pxRequest->eMode], (unsigned) pxRequest->usPort,
+             (uxJob != 0) ? ", reporting as a background job" : "");
+}
+
+/* Parse "1000", "10K" or "100M" into bit/s */
+static uint32_t prvParseRate(const char *pcValue)
+{
+    char *pcEnd;
+    unsigned long ulValue = strtoul(pcValue, &pcEnd, 10);
+
+    if (*pcEnd == 'k' || *pcEnd == 'K')
+    {
+        ulValue *= 1000u;
+    }
+    else if (*pcEnd == 'm' || *pcEnd == 'M')
+    {
+        ulValue *= 1000000u;
+    }
+
+    return (uint32_t) ulValue;
+}
+
+/* Look up a congestion control algorithm by name */
+static BaseType_t prvParseCongestAlgo(const char *pcValue, BaseType_t xLength, TcpCongestAlgoType *peAlgo)
+{
+    static const TcpCongestAlgoType eAlgos[] =
+    {
+        TCP_CONGEST_ALGO_RENO, TCP_CONGEST_ALGO_CUBIC, TCP_CONGEST_ALGO_BBR_LITE
+    };
+    const TcpCongestAlgo *pxAlgo;
+    UBaseType_t i;
+
+    for (i = 0; i < sizeof(eAlgos) / sizeof(eAlgos[0]); i++)
+    {
+        pxAlgo = tcpGetCongestAlgo(eAlgos[i]);
+        if (pxAlgo != NULL && strlen(pxAlgo->name) == (size_t) xLength &&
+            strncmp(pxAlgo->name, pcValue, xLength) == 0)
+        {
+            *peAlgo = eAlgos[i];
+            return pdPASS;
+        }
+    }
+
+    return pdFAIL;
+}
+
+static BaseType_t prvIperfCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    BenchRequest_t xNew;
+    const char *pcParameter;
+    const char *pcValue;
+    BaseType_t xParameterLength;
+    BaseType_t xValueLength;
+    UBaseType_t uxIndex;
+    char cAddr[40];
+    BaseType_t xUdp = pdFALSE;
+
+    memset(&xNew, 0, sizeof(xNew));
+    xNew.usPort = NET_BENCH_IPERF_PORT;
+    xNew.ulSeconds = NET_BENCH_DEFAULT_SECONDS;
+    xNew.ulRate = NET_BENCH_DEFAULT_UDP_RATE;
+    xNew.xLength = 0;
+    xNew.eCongestAlgo = TCP_DEFAULT_CONGEST_ALGO;
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterLength);
+    if (pcParameter == NULL)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: iperf -s [-u] | -c <ip> [-u] [options] | stop\r\n");
+        return pdFALSE;
+    }
+
+    if (xParameterLength == 4 && strncmp(pcParameter, "stop", 4) == 0)
+    {
+        prvBenchStop();
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Stopped\r\n");
+        return pdFALSE;
+    }
+
+    uxIndex = 2;
+    if (xParameterLength == 2 && strncmp(pcParameter, "-c", 2) == 0)
+    {
+        pcValue = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xValueLength);
+        if (pcValue == NULL || (size_t) xValueLength >= sizeof(cAddr))
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Missing server address\r\n");
+            return pdFALSE;
+        }
+        memcpy(cAddr, pcValue, xValueLength);
+        cAddr[xValueLength] = '\0';
+
+        if (ipStringToAddr(cAddr, &xNew.xPeer) != NO_ERROR)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid address\r\n");
+            return pdFALSE;
+        }
+        xNew.eMode = eBenchTcpClient;
+        uxIndex = 3;
+    }
+    else if (xParameterLength == 2 && strncmp(pcParameter, "-s", 2) == 0)
+    {
+        xNew.eMode = eBenchTcpServer;
+    }
+    else
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Expected -s, -c <ip> or stop\r\n");
+        return pdFALSE;
+    }
+
+    /* Options */
+    while ((pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, uxIndex++, &xParameterLength)) != NULL)
+    {
+        if (xParameterLength == 2 && strncmp(pcParameter, "-u", 2) == 0)
+        {
+            xUdp = pdTRUE;
+            continue;
+        }
+
+        pcValue = FreeRTOS_CLIGetParameter(pcCommandString, uxIndex++, &xValueLength);
+        if (xParameterLength != 2 || pcParameter[0] != '-' || pcValue == NULL)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid option\r\n");
+            return pdFALSE;
+        }
+
+        switch (pcParameter[1])
+        {
+        case 'p': xNew.usPort = (uint16_t) strtoul(pcValue, NULL, 10); break;
+        case 't': xNew.ulSeconds = strtoul(pcValue, NULL, 10); break;
+        case 'b': xNew.ulRate = prvParseRate(pcValue); break;
+        case 'l': xNew.xLength = strtoul(pcValue, NULL, 10); break;
+        case 'Z':
+            if (prvParseCongestAlgo(pcValue, xValueLength, &xNew.eCongestAlgo) != pdPASS)
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Unknown congestion control algorithm\r\n");
+                return pdFALSE;
+            }
+            break;
+        default:
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Unknown option -%c\r\n", pcParameter[1]);
+            return pdFALSE;
+        }
+    }
+
+    if (xUdp != pdFALSE)
+    {
+        xNew.eMode = (xNew.eMode == eBenchTcpClient) ? eBenchUdpClient : eBenchUdpServer;
+    }
+
+    if (xNew.xLength == 0)
+    {
+        xNew.xLength = (xUdp != pdFALSE) ? NET_BENCH_DEFAULT_LENGTH : NET_BENCH_BUFFER_SIZE;
+    }
+
+    if (xNew.usPort == 0 || xNew.ulSeconds == 0 ||
+        xNew.xLength < IPERF_UDP_HEADER_SIZE || xNew.xLength > NET_BENCH_BUFFER_SIZE)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid port, time or length (%u..%u bytes)\r\n",
+                 (unsigned) IPERF_UDP_HEADER_SIZE, (unsigned) NET_BENCH_BUFFER_SIZE);
+        return pdFALSE;
+    }
+
+    prvBenchLaunch(pcWriteBuffer, xWriteBufferLen, &xNew);
+    return pdFALSE;
+}
+
+static BaseType_t prvUdpEchoCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    BenchRequest_t xNew;
+    const char *pcParameter;
+    BaseType_t xParameterLength;
+    uint32_t ulKbps;
+
+    memset(&xNew, 0, sizeof(xNew));
+    xNew.eMode = eBenchUdpEcho;
+    xNew.usPort = NET_BENCH_ECHO_PORT;
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterLength);
+    if (pcParameter != NULL && xParameterLength == 4 && strncmp(pcParameter, "stop", 4) == 0)
+    {
+        if (eBenchMode != eBenchUdpEcho)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "The echo responder is not running\r\n");
+            return pdFALSE;
+        }
+
+        prvBenchStop();
+        ulKbps = prvKbps(xLastResult.ullBytes, xLastResult.ullElapsedUs);
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Echoed %lu datagrams (%lu.%02lu Mbit/s average)\r\n",
+                 (unsigned long) xLastResult.ulPackets,
+                 (unsigned long) (ulKbps / 1000), (unsigned long) ((ulKbps % 1000) / 10));
+        return pdFALSE;
+    }
+
+    if (pcParameter != NULL)
+    {
+        xNew.usPort = (uint16_t) strtoul(pcParameter, NULL, 10);
+        if (xNew.usPort == 0)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid port\r\n");
+            return pdFALSE;
+        }
+    }
+
+    prvBenchLaunch(pcWriteBuffer, xWriteBufferLen, &xNew);
+    return pdFALSE;
+}
@@ -0,0 +1,1643 @@
+/* NetCLICommands.c
+ *
+ * CLI commands exposing diagnostics of the CycloneTCP stack.
+ *
+ * netstat prints the interface and protocol counters (NET_STATS_SUPPORT) and
+ * controls their periodic UDP export.
+ *
+ * net-latency prints the receive path latency histograms collected with
+ * NET_LATENCY_SUPPORT, one stage per pair of output lines, so that jitter
+ * can be attributed to interrupt latency and netMutex waits ("irq-to-task"),
+ * batching ("ring-wait") or the protocol layers.
+ *
+ * net-locks prints, for the netMutex and for the socket locks taken
+ * together, how often they were taken, how often a task had to wait (and
+ * for a holder of lower priority), and the wait and hold times, measured
+ * with OS_MUTEX_STATS_SUPPORT.
+ *
+ * link-up prints, per interface, how long the last link-up took to give a
+ * usable address (the "network ready" event of the stack).
+ *
+ * ss lists the open sockets with their state and queued bytes; each TCP
+ * connection is followed by its congestion window, slow start threshold,
+ * windows and their scale factors, RTT estimator, RTO and retransmissions,
+ * as socketGetTcpInfo() snapshots them while the connection keeps running.
+ *
+ * dhcp-server prints the message counters and the binding table occupancy
+ * of the DHCP server running on the first interface, if any.
+ *
+ * loopback prints how the packets sent to the host itself were moved by the
+ * loopback interface: by reference, copied, or flattened on delivery.
+ *
+ * shaper prints the token buckets of the eight DSCP class selectors and of
+ * the rate-limited sockets, and sets their rates (NET_SHAPER_SUPPORT).
+ *
+ * route prints the forwarding counters and the routing table, adds and
+ * deletes routes, and turns forwarding on or off on the Ethernet interfaces
+ * (IPV4_ROUTING_SUPPORT).
+ *
+ * nat prints the translation counters and the session table occupancy of
+ * the NAT, if one is running (NAT_SUPPORT).
+ *
+ * firewall prints the ingress rules in evaluation order with the packets
+ * each matched, adds and deletes rules and sets the default action
+ * (IPV4_FIREWALL_SUPPORT). Rules marked "hw" are enforced by the MAC: the
+ * packets it drops never reach the counters.
+ *
+ * icmp-limit prints the token buckets limiting the Echo Replies and the
+ * ICMP errors, per type and per source, with the messages each let through
+ * and suppressed, and sets their rates (ICMP_RATE_LIMIT_SUPPORT).
+ */
+#include "NetCLICommands.h"
+#include "NetStatsExport.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "core/net.h"
+#include "core/socket.h"
+#include "ipv4/ipv4_routing.h"
+#include "ipv4/ipv4_firewall.h"
+#include "ipv4/ipv4_misc.h"
+#include "ipv4/icmp.h"
+#include "nat/nat.h"
+#include "dhcp/dhcp_server.h"
+#include "drivers/loopback/loopback_driver.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if (NET_STATS_SUPPORT == ENABLED)
+
+/* netstat prints one line per CLI call: the counters are sampled on the
+ * first one, so that the totals of the interface and of the protocols add
+ * up across the lines */
+static NetStats xStatsReport;
+static UBaseType_t uxStatsLine = 0;
+
+static BaseType_t prvNetstatCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xNetstat =
+{
+    "netstat",
+    "\r\nnetstat [reset | export <ip> <port> [ms] | export off]:\r\n Interface and protocol counters, optional UDP export\r\n",
+    prvNetstatCommand,
+    -1
+};
+
+/* "netstat export ...": parse the collector and start or stop the export */
+static void prvNetstatExport(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    char cAddr[40];
+    const char *pcParameter;
+    BaseType_t xParameterLength;
+    IpAddr xAddr;
+    unsigned long ulPort;
+    unsigned long ulPeriod = 1000;
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterLength);
+    if (pcParameter == NULL)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: netstat export <ip> <port> [ms] | off\r\n");
+        return;
+    }
+
+    if (xParameterLength == 3 && strncmp(pcParameter, "off", 3) == 0)
+    {
+        vNetStatsExportConfigure(NULL, 0, 0);
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Export stopped\r\n");
+        return;
+    }
+
+    if ((size_t) xParameterLength >= sizeof(cAddr))
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid address\r\n");
+        return;
+    }
+    memcpy(cAddr, pcParameter, xParameterLength);
+    cAddr[xParameterLength] = '\0';
+
+    if (ipStringToAddr(cAddr, &xAddr) != NO_ERROR)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid address\r\n");
+        return;
+    }
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 3, &xParameterLength);
+    ulPort = (pcParameter != NULL) ? strtoul(pcParameter, NULL, 10) : 0;
+    if (ulPort == 0 || ulPort > 65535)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid port\r\n");
+        return;
+    }
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 4, &xParameterLength);
+    if (pcParameter != NULL)
+    {
+        ulPeriod = strtoul(pcParameter, NULL, 10);
+        if (ulPeriod < 100)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Period must be at least 100 ms\r\n");
+            return;
+        }
+    }
+
+    vNetStatsExportConfigure(&xAddr, (uint16_t) ulPort, ulPeriod);
+    snprintf(pcWriteBuffer, xWriteBufferLen, "Exporting to %s:%lu every %lu ms\r\n",
+             cAddr, ulPort, ulPeriod);
+}
+
+/* "netstat": one report line per call */
+static BaseType_t prvNetstatCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    const char *pcParameter;
+    BaseType_t xParameterLength;
+
+    if (uxStatsLine == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterLength);
+
+        if (pcParameter != NULL)
+        {
+            if (xParameterLength == 5 && strncmp(pcParameter, "reset", 5) == 0)
+            {
+                netStatsReset();
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Counters cleared\r\n");
+            }
+            else if (xParameterLength == 6 && strncmp(pcParameter, "export", 6) == 0)
+            {
+                prvNetstatExport(pcWriteBuffer, xWriteBufferLen, pcCommandString);
+            }
+            else
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: netstat [reset | export <ip> <port> [ms] | export off]\r\n");
+            }
+            return pdFALSE;
+        }
+
+        vNetStatsSnapshot(&xStatsReport);
+    }
+
+    xNetStatsFormatLine(&xStatsReport, uxStatsLine, pcWriteBuffer, xWriteBufferLen);
+
+    /* Done after the last line */
+    if (++uxStatsLine >= uxNetStatsLineCount())
+    {
+        uxStatsLine = 0;
+        return pdFALSE;
+    }
+
+    return pdTRUE;
+}
+
+#endif
+
+#if (NET_LATENCY_SUPPORT == ENABLED)
+
+/* Histograms of every stage taken before the first line, so that the
+ * columns printed per bucket compare the stages over the same packets */
+static NetLatencyHistogram xLatencyReport[NET_LATENCY_STAGE_COUNT];
+static UBaseType_t uxLatencyLine = 0;
+
+static BaseType_t prvNetLatencyCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xNetLatency =
+{
+    "net-latency",
+    "\r\nnet-latency [reset]:\r\n Receive path latency histograms per stage, in microseconds\r\n",
+    prvNetLatencyCommand,
+    -1
+};
+
+/* Bucket counts of a histogram, as one line */
+static void prvPrintBuckets(char *pcWriteBuffer, size_t xWriteBufferLen, const NetLatencyHistogram *pxHistogram)
+{
+    size_t xLength = 0;
+    uint_t i;
+
+    for (i = 0; i < NET_LATENCY_BUCKET_COUNT && xLength < xWriteBufferLen; i++)
+    {
+        xLength += snprintf(pcWriteBuffer + xLength, xWriteBufferLen - xLength, " %lu",
+                            (unsigned long) pxHistogram->buckets[i]);
+    }
+
+    if (xLength < xWriteBufferLen)
+    {
+        snprintf(pcWriteBuffer + xLength, xWriteBufferLen - xLength, "\r\n");
+    }
+}
+
+/* "net-latency": header, then a summary and a bucket line per stage */
+static BaseType_t prvNetLatencyCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    const NetLatencyHistogram *pxHistogram;
+    const char *pcParameter;
+    BaseType_t xParameterLength;
+    UBaseType_t uxStage;
+    size_t xLength;
+    uint_t i;
+
+    if (uxLatencyLine == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterLength);
+
+        if (pcParameter != NULL)
+        {
+            if (xParameterLength == 5 && strncmp(pcParameter, "reset", 5) == 0)
+            {
+                netLatencyReset();
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Latency histograms cleared\r\n");
+            }
+            else
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: net-latency [reset]\r\n");
+            }
+            return pdFALSE;
+        }
+
+        for (uxStage = 0; uxStage < NET_LATENCY_STAGE_COUNT; uxStage++)
+        {
+            netLatencyGetStats(uxStage, &xLatencyReport[uxStage]);
+        }
+
+        /* Bucket upper bounds; the last bucket is open ended */
+        xLength = snprintf(pcWriteBuffer, xWriteBufferLen, "\r\nBuckets (us):");
+        for (i = 0; i < NET_LATENCY_BUCKET_COUNT - 1 && xLength < xWriteBufferLen; i++)
+        {
+            xLength += snprintf(pcWriteBuffer + xLength, xWriteBufferLen - xLength, " <%lu",
+                                (unsigned long) netLatencyGetBucketLimit(i));
+        }
+        if (xLength < xWriteBufferLen)
+        {
+            snprintf(pcWriteBuffer + xLength, xWriteBufferLen - xLength, " more\r\n");
+        }
+    }
+    else
+    {
+        /* Stage 0 ends at the interrupt and is never sampled */
+        uxStage = 1 + (uxLatencyLine - 1) / 2;
+        pxHistogram = &xLatencyReport[uxStage];
+
+        if ((uxLatencyLine & 1) != 0)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "%-12s n=%lu min=%lu avg=%lu max=%lu\r\n",
+                     netLatencyGetStageName(uxStage),
+                     (unsigned long) pxHistogram->count,
+                     (unsigned long) pxHistogram->min,
+                     (unsigned long) ((pxHistogram->count > 0) ? (pxHistogram->sum / pxHistogram->count) : 0),
+                     (unsigned long) pxHistogram->max);
+        }
+        else
+        {
+            prvPrintBuckets(pcWriteBuffer, xWriteBufferLen, pxHistogram);
+        }
+    }
+
+    /* Done after the bucket line of the total stage */
+    if (++uxLatencyLine > 2 * (NET_LATENCY_STAGE_COUNT - 1))
+    {
+        uxLatencyLine = 0;
+        return pdFALSE;
+    }
+
+    return pdTRUE;
+}
+
+#endif
+
+#if (OS_MUTEX_STATS_SUPPORT == ENABLED)
+
+/* Both sets of statistics taken before the first line */
+static OsMutexStats xLockReport[2];
+static UBaseType_t uxLockLine = 0;
+
+static BaseType_t prvNetLocksCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xNetLocks =
+{
+    "net-locks",
+    "\r\nnet-locks [reset]:\r\n Contention and hold times of the netMutex and of the socket locks, in microseconds\r\n",
+    prvNetLocksCommand,
+    -1
+};
+
+/* "net-locks": header, then a line per lock */
+static BaseType_t prvNetLocksCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    static const char * const pcNames[2] = { "netMutex", "sockets" };
+    const OsMutexStats *pxStats;
+    const char *pcParameter;
+    BaseType_t xParameterLength;
+
+    if (uxLockLine == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterLength);
+
+        if (pcParameter != NULL)
+        {
+            if (xParameterLength == 5 && strncmp(pcParameter, "reset", 5) == 0)
+            {
+                osResetMutexStats(&netContext.mutexStats);
+                osResetMutexStats(&netContext.socketLockStats);
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Lock statistics cleared\r\n");
+            }
+            else
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: net-locks [reset]\r\n");
+            }
+            return pdFALSE;
+        }
+
+        osGetMutexStats(&netContext.mutexStats, &xLockReport[0]);
+        osGetMutexStats(&netContext.socketLockStats, &xLockReport[1]);
+
+        snprintf(pcWriteBuffer, xWriteBufferLen, "\r\n%-9s %10s %9s %9s %8s %8s %8s %8s\r\n",
+                 "Lock", "Taken", "Waited", "Inverted", "AvgWait", "MaxWait", "AvgHold", "MaxHold");
+    }
+    else
+    {
+        pxStats = &xLockReport[uxLockLine - 1];
+
+        /* Waits averaged over the contended acquisitions only */
+        snprintf(pcWriteBuffer, xWriteBufferLen, "%-9s %10lu %9lu %9lu %8lu %8lu %8lu %8lu\r\n",
+                 pcNames[uxLockLine - 1],
+                 (unsigned long) pxStats->acquisitions,
+                 (unsigned long) pxStats->contended,
+                 (unsigned long) pxStats->inversions,
+                 (unsigned long) ((pxStats->contended > 0) ? (pxStats->totalWaitUs / pxStats->contended) : 0),
+                 (unsigned long) pxStats->maxWaitUs,
+                 (unsigned long) ((pxStats->acquisitions > 0) ? (pxStats->totalHoldUs / pxStats->acquisitions) : 0),
+                 (unsigned long) pxStats->maxHoldUs);
+    }
+
+    if (++uxLockLine > 2)
+    {
+        uxLockLine = 0;
+        return pdFALSE;
+    }
+
+    return pdTRUE;
+}
+
+#endif
+
+static BaseType_t prvLinkUpCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xLinkUp =
+{
+    "link-up",
+    "\r\nlink-up:\r\n Time from the last link-up to a usable address, per interface\r\n",
+    prvLinkUpCommand,
+    0
+};
+
+static UBaseType_t uxLinkUpLine = 0;
+
+/* "link-up": one interface per call */
+static BaseType_t prvLinkUpCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    NetInterface *pxInterface = &netInterface[uxLinkUpLine];
+    bool_t xLinkState;
+    bool_t xReady;
+    systime_t xLinkUpTime;
+    systime_t xReadyTime;
+
+    (void) pcCommandString;
+
+    osAcquireMutex(&netMutex);
+    xLinkState = pxInterface->linkState;
+    xReady = pxInterface->ready;
+    xLinkUpTime = pxInterface->linkUpTime;
+    xReadyTime = pxInterface->readyTime;
+    osReleaseMutex(&netMutex);
+
+    if (!xLinkState)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "%s: link down\r\n", pxInterface->name);
+    }
+    else if (!xReady)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "%s: link up %lu ms ago, not ready\r\n",
+                 pxInterface->name, (unsigned long) (osGetSystemTime() - xLinkUpTime));
+    }
+    else
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "%s: ready %lu ms after link-up\r\n",
+                 pxInterface->name, (unsigned long) (xReadyTime - xLinkUpTime));
+    }
+
+    if (++uxLinkUpLine >= NET_INTERFACE_COUNT)
+    {
+        uxLinkUpLine = 0;
+        return pdFALSE;
+    }
+
+    return pdTRUE;
+}
+
+static BaseType_t prvSsCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xSs =
+{
+    "ss",
+    "\r\nss:\r\n Open sockets with their state and queues, TCP connections followed by their counters\r\n",
+    prvSsCommand,
+    0
+};
+
+/* Line 0 is the header; then each open socket, followed by two lines of
+   counters when it is a TCP connection */
+static UBaseType_t uxSsLine = 0;
+static UBaseType_t uxSsSocket;
+
+/* Counters of the connection printed on the previous line */
+static SocketTcpInfo xSsInfo;
+
+static const char * const pcTcpStates[] =
+{
+    "CLOSED", "LISTEN", "SYN-SENT", "SYN-RECV", "ESTAB", "CLOSE-WAIT",
+    "LAST-ACK", "FIN-WAIT-1", "FIN-WAIT-2", "CLOSING", "TIME-WAIT"
+};
+
+/* First open socket from uxStart on, SOCKET_MAX_COUNT if none */
+static UBaseType_t prvNextOpenSocket(UBaseType_t uxStart)
+{
+    UBaseType_t i;
+
+    osAcquireMutex(&netMutex);
+    for (i = uxStart; i < SOCKET_MAX_COUNT; i++)
+    {
+        if (socketTable[i].type != SOCKET_TYPE_UNUSED)
+        {
+            break;
+        }
+    }
+    osReleaseMutex(&netMutex);
+
+    return i;
+}
+
+/* "address:port", "*" for the parts not set */
+static void prvFormatEndpoint(char *pcBuffer, size_t xLength, const IpAddr *pxAddr, uint16_t usPort)
+{
+    char cAddr[48];
+
+    if (pxAddr->length == 0)
+    {
+        strcpy(cAddr, "*");
+    }
+    else
+    {
+        (void) ipAddrToString(pxAddr, cAddr);
+    }
+
+    if (usPort == 0)
+    {
+        snprintf(pcBuffer, xLength, "%s:*", cAddr);
+    }
+    else
+    {
+        snprintf(pcBuffer, xLength, "%s:%u", cAddr, (unsigned int) usPort);
+    }
+}
+
+/* "ss": one line per call */
+static BaseType_t prvSsCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    Socket *pxSocket;
+    uint_t uxType;
+    IpAddr xLocalAddr;
+    IpAddr xRemoteAddr;
+    uint16_t usLocalPort;
+    uint16_t usRemotePort;
+    size_t xRecvQueue = 0;
+    size_t xSendQueue = 0;
+    const char *pcProto;
+    const char *pcState = "-";
+    char cLocal[56];
+    char cRemote[56];
+#if (UDP_SUPPORT == ENABLED || RAW_SOCKET_SUPPORT == ENABLED)
+    const SocketQueueItem *pxItem;
+#endif
+
+    (void) pcCommandString;
+
+    if (uxSsLine == 0)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "\r\nSock Proto State       Recv-Q  Send-Q Local                  Peer\r\n");
+        uxSsSocket = prvNextOpenSocket(0);
+        uxSsLine = 1;
+    }
+    else if (uxSsLine == 2)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "     %s cwnd %lu ssthresh %lu wnd %lu/%lu wscale %u/%u buf %lu/%lu\r\n",
+                 (xSsInfo.congestAlgo != NULL) ? xSsInfo.congestAlgo : "-",
+                 (unsigned long) xSsInfo.cwnd, (unsigned long) xSsInfo.ssthresh,
+                 (unsigned long) xSsInfo.sndWnd, (unsigned long) xSsInfo.rcvWnd,
+                 (unsigned int) xSsInfo.sndWndShift, (unsigned int) xSsInfo.rcvWndShift,
+                 (unsigned long) xSsInfo.txBufferSize, (unsigned long) xSsInfo.rxBufferSize);
+        uxSsLine = 3;
+    }
+    else if (uxSsLine == 3)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "     srtt %lu rttvar %lu rto %lu ms retrans %u/%lu dupack %u unacked %lu\r\n",
+                 (unsigned long) xSsInfo.srtt, (unsigned long) xSsInfo.rttvar, (unsigned long) xSsInfo.rto,
+                 (unsigned int) xSsInfo.retransmitCount, (unsigned long) xSsInfo.retransmitTotal,
+                 (unsigned int) xSsInfo.dupAckCount, (unsigned long) xSsInfo.unacked);
+        uxSsSocket = prvNextOpenSocket(uxSsSocket + 1);
+        uxSsLine = 1;
+    }
+    else
+    {
+        pxSocket = &socketTable[uxSsSocket];
+
+        osAcquireMutex(&netMutex);
+        uxType = pxSocket->type;
+        xLocalAddr = pxSocket->localIpAddr;
+        xRemoteAddr = pxSocket->remoteIpAddr;
+        usLocalPort = pxSocket->localPort;
+        usRemotePort = pxSocket->remotePort;
+#if (UDP_SUPPORT == ENABLED || RAW_SOCKET_SUPPORT == ENABLED)
+        if (uxType != SOCKET_TYPE_STREAM)
+        {
+            for (pxItem = pxSocket->receiveQueue; pxItem != NULL; pxItem = pxItem->next)
+            {
+                xRecvQueue += netBufferGetLength(pxItem->buffer) - pxItem->offset;
+            }
+        }
+#endif
+        osReleaseMutex(&netMutex);
+
+        pcProto = (uxType == SOCKET_TYPE_STREAM) ? "tcp" : (uxType == SOCKET_TYPE_DGRAM) ? "udp" : "raw";
+
+        if (uxType == SOCKET_TYPE_STREAM && socketGetTcpInfo(pxSocket, &xSsInfo) == NO_ERROR)
+        {
+            pcState = (xSsInfo.state < sizeof(pcTcpStates) / sizeof(pcTcpStates[0])) ?
+                      pcTcpStates[xSsInfo.state] : "?";
+            xRecvQueue = xSsInfo.rcvQueue;
+            xSendQueue = xSsInfo.sndQueue + xSsInfo.unacked;
+
+            /* Listening and closed sockets have no connection to detail */
+            if (xSsInfo.state != TCP_STATE_CLOSED && xSsInfo.state != TCP_STATE_LISTEN)
+            {
+                uxSsLine = 2;
+            }
+        }
+
+        if (uxType == SOCKET_TYPE_UNUSED)
+        {
+            /* The socket was closed meanwhile */
+            pcWriteBuffer[0] = '\0';
+        }
+        else
+        {
+            prvFormatEndpoint(cLocal, sizeof(cLocal), &xLocalAddr, usLocalPort);
+            prvFormatEndpoint(cRemote, sizeof(cRemote), &xRemoteAddr, usRemotePort);
+            snprintf(pcWriteBuffer, xWriteBufferLen, "%4u %-5s %-10s %7lu %7lu %-22s %s\r\n",
+                     (unsigned int) uxSsSocket, pcProto, pcState, (unsigned long) xRecvQueue,
+                     (unsigned long) xSendQueue, cLocal, cRemote);
+        }
+
+        if (uxSsLine == 1)
+        {
+            uxSsSocket = prvNextOpenSocket(uxSsSocket + 1);
+        }
+    }
+
+    if (uxSsLine == 1 && uxSsSocket >= SOCKET_MAX_COUNT)
+    {
+        uxSsLine = 0;
+        return pdFALSE;
+    }
+
+    return pdTRUE;
+}
+
+#if (IPV4_SUPPORT == ENABLED && DHCP_SERVER_SUPPORT == ENABLED)
+
+static BaseType_t prvDhcpServerCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xDhcpServer =
+{
+    "dhcp-server",
+    "\r\ndhcp-server:\r\n DHCP server message counters and lease table occupancy\r\n",
+    prvDhcpServerCommand,
+    0
+};
+
+/* Server counters taken when the report starts, so that the offers and
+ * the acks printed two lines apart cover the same exchanges */
+static DhcpServerStats xDhcpServerReport;
+static UBaseType_t uxDhcpServerLine = 0;
+
+static BaseType_t prvDhcpServerCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    DhcpServerContext *pxContext = netInterface[0].dhcpServerContext;
+
+    (void) pcCommandString;
+
+    if (uxDhcpServerLine == 0)
+    {
+        if (pxContext == NULL || dhcpServerGetStats(pxContext, &xDhcpServerReport) != NO_ERROR)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "DHCP server not running\r\n");
+            return pdFALSE;
+        }
+    }
+
+    switch (uxDhcpServerLine++)
+    {
+    case 0:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "rx: discover=%lu request=%lu decline=%lu release=%lu inform=%lu\r\n",
+                 (unsigned long) xDhcpServerReport.discoverReceived, (unsigned long) xDhcpServerReport.requestReceived,
+                 (unsigned long) xDhcpServerReport.declineReceived, (unsigned long) xDhcpServerReport.releaseReceived,
+                 (unsigned long) xDhcpServerReport.informReceived);
+        return pdTRUE;
+    case 1:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "tx: offer=%lu ack=%lu nak=%lu\r\n",
+                 (unsigned long) xDhcpServerReport.offerSent, (unsigned long) xDhcpServerReport.ackSent,
+                 (unsigned long) xDhcpServerReport.nakSent);
+        return pdTRUE;
+    case 2:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "drop: rate-limit=%lu holdoff=%lu no-address=%lu\r\n",
+                 (unsigned long) xDhcpServerReport.offerRateLimited, (unsigned long) xDhcpServerReport.offerHoldoff,
+                 (unsigned long) xDhcpServerReport.poolExhausted);
+        return pdTRUE;
+    default:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "bindings: %u/%u leases=%u stores=%lu\r\n",
+                 (unsigned int) xDhcpServerReport.bindings, (unsigned int) DHCP_SERVER_MAX_CLIENTS,
+                 (unsigned int) xDhcpServerReport.validLeases, (unsigned long) xDhcpServerReport.leaseStores);
+        uxDhcpServerLine = 0;
+        return pdFALSE;
+    }
+}
+
+#endif
+
+#if (NET_LOOPBACK_IF_SUPPORT == ENABLED)
+
+static BaseType_t prvLoopbackCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xLoopback =
+{
+    "loopback",
+    "\r\nloopback:\r\n Loopback interface counters (zero-copy, copied, flattened, dropped)\r\n",
+    prvLoopbackCommand,
+    0
+};
+
+static BaseType_t prvLoopbackCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    LoopbackDriverStats xStats;
+
+    (void) pcCommandString;
+
+    loopbackDriverGetStats(&xStats);
+    snprintf(pcWriteBuffer, xWriteBufferLen, "loopback: zero-copy=%lu copied=%lu flattened=%lu dropped=%lu\r\n",
+             (unsigned long) xStats.zeroCopy, (unsigned long) xStats.copied,
+             (unsigned long) xStats.linearized, (unsigned long) xStats.dropped);
+
+    return pdFALSE;
+}
+
+#endif
+
+#if (NET_SHAPER_SUPPORT == ENABLED)
+
+static BaseType_t prvShaperCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xShaper =
+{
+    "shaper",
+    "\r\nshaper [class <0-7> | socket <n>] [<bytes/s> [burst]]:\r\n Token buckets per DSCP class and socket, 0 B/s to remove a limit\r\n",
+    prvShaperCommand,
+    -1
+};
+
+/* Line 0 is the header, lines 1 to 8 the classes, then the shaped sockets */
+static UBaseType_t uxShaperLine = 0;
+
+/* First rate-limited socket from uxStart on, SOCKET_MAX_COUNT if none */
+static UBaseType_t prvNextShapedSocket(UBaseType_t uxStart)
+{
+    UBaseType_t i;
+
+    osAcquireMutex(&netMutex);
+    for (i = uxStart; i < SOCKET_MAX_COUNT; i++)
+    {
+        if (socketTable[i].type != SOCKET_TYPE_UNUSED && socketTable[i].shaper.rate != 0)
+        {
+            break;
+        }
+    }
+    osReleaseMutex(&netMutex);
+
+    return i;
+}
+
+/* "shaper class|socket <n> <rate> [burst]" */
+static void prvShaperSet(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString,
+                         BaseType_t xClass)
+{
+    const char *pcParameter;
+    BaseType_t xParameterLength;
+    unsigned long ulIndex;
+    unsigned long ulRate;
+    unsigned long ulBurst = 0;
+    error_t xError;
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 3, &xParameterLength);
+    if (pcParameter == NULL)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: shaper class <0-7> | socket <n> <bytes/s> [burst]\r\n");
+        return;
+    }
+    ulRate = strtoul(pcParameter, NULL, 10);
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterLength);
+    ulIndex = strtoul(pcParameter, NULL, 10);
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 4, &xParameterLength);
+    if (pcParameter != NULL)
+    {
+        ulBurst = strtoul(pcParameter, NULL, 10);
+    }
+
+    if (xClass)
+    {
+        xError = netShaperSetClassRate((uint_t) ulIndex, (uint32_t) ulRate, (uint32_t) ulBurst);
+    }
+    else if (ulIndex < SOCKET_MAX_COUNT && socketTable[ulIndex].type != SOCKET_TYPE_UNUSED)
+    {
+        xError = socketSetRateLimit(&socketTable[ulIndex], (uint32_t) ulRate, (uint32_t) ulBurst);
+    }
+    else
+    {
+        xError = ERROR_INVALID_SOCKET;
+    }
+
+    if (xError != NO_ERROR)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid %s %lu\r\n", xClass ? "class" : "socket", ulIndex);
+    }
+    else if (ulRate == 0)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "%s %lu unshaped\r\n", xClass ? "Class" : "Socket", ulIndex);
+    }
+    else
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "%s %lu limited to %lu B/s\r\n", xClass ? "Class" : "Socket",
+                 ulIndex, ulRate);
+    }
+}
+
+static void prvPrintBucket(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcName,
+                           const NetShaperBucket *pxBucket)
+{
+    snprintf(pcWriteBuffer, xWriteBufferLen, "%-8s %10lu %8lu %8ld %10lu %12lu %8lu %8lu\r\n",
+             pcName, (unsigned long) pxBucket->rate, (unsigned long) pxBucket->burst, (long) pxBucket->tokens,
+             (unsigned long) pxBucket->packets, (unsigned long) pxBucket->bytes,
+             (unsigned long) pxBucket->delayed, (unsigned long) pxBucket->dropped);
+}
+
+static BaseType_t prvShaperCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    const char *pcParameter;
+    BaseType_t xParameterLength;
+    NetShaperBucket xBucket;
+    UBaseType_t uxSocket;
+    char cName[12];
+
+    if (uxShaperLine == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterLength);
+
+        if (pcParameter != NULL)
+        {
+            if (xParameterLength == 5 && strncmp(pcParameter, "class", 5) == 0)
+            {
+                prvShaperSet(pcWriteBuffer, xWriteBufferLen, pcCommandString, pdTRUE);
+            }
+            else if (xParameterLength == 6 && strncmp(pcParameter, "socket", 6) == 0)
+            {
+                prvShaperSet(pcWriteBuffer, xWriteBufferLen, pcCommandString, pdFALSE);
+            }
+            else
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: shaper [class <0-7> | socket <n> <bytes/s> [burst]]\r\n");
+            }
+            return pdFALSE;
+        }
+
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "\r\nBucket     Rate B/s    Burst   Tokens    Packets        Bytes  Delayed  Dropped\r\n");
+        uxShaperLine = 1;
+        return pdTRUE;
+    }
+
+    if (uxShaperLine <= NET_SHAPER_CLASS_COUNT)
+    {
+        snprintf(cName, sizeof(cName), "cs%u", (unsigned int) (uxShaperLine - 1));
+        (void) netShaperGetClassInfo(uxShaperLine - 1, &xBucket);
+        prvPrintBucket(pcWriteBuffer, xWriteBufferLen, cName, &xBucket);
+
+        /* The sockets follow the last class */
+        uxSocket = (uxShaperLine == NET_SHAPER_CLASS_COUNT) ? prvNextShapedSocket(0) : SOCKET_MAX_COUNT;
+    }
+    else
+    {
+        uxSocket = prvNextShapedSocket(uxShaperLine - 1 - NET_SHAPER_CLASS_COUNT);
+        if (uxSocket < SOCKET_MAX_COUNT)
+        {
+            snprintf(cName, sizeof(cName), "socket%u", (unsigned int) uxSocket);
+            (void) netShaperGetSocketInfo(&socketTable[uxSocket], &xBucket);
+            prvPrintBucket(pcWriteBuffer, xWriteBufferLen, cName, &xBucket);
+            uxSocket = prvNextShapedSocket(uxSocket + 1);
+        }
+        else
+        {
+            /* The socket was closed meanwhile */
+            pcWriteBuffer[0] = '\0';
+        }
+    }
+
+    /* Skip to the next shaped socket, if any */
+    if (uxShaperLine < NET_SHAPER_CLASS_COUNT)
+    {
+        uxShaperLine++;
+    }
+    else if (uxSocket < SOCKET_MAX_COUNT)
+    {
+        uxShaperLine = uxSocket + 1 + NET_SHAPER_CLASS_COUNT;
+    }
+    else
+    {
+        uxShaperLine = 0;
+        return pdFALSE;
+    }
+
+    return pdTRUE;
+}
+
+#endif
+
+#if (IPV4_SUPPORT == ENABLED && IPV4_ROUTING_SUPPORT == ENABLED)
+
+static BaseType_t prvRouteCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xRoute =
+{
+    "route",
+    "\r\nroute [add <net> <mask> <if> [gw] | del <net> <mask> | forward on|off]:\r\n IPv4 routing table and forwarding counters\r\n",
+    prvRouteCommand,
+    -1
+};
+
+/* Lines 0 to 2 are the counters and the header, then one table entry per call */
+static UBaseType_t uxRouteLine = 0;
+
+/* Parse the dotted address given as parameter uxIndex */
+static BaseType_t prvRouteGetAddr(const char *pcCommandString, UBaseType_t uxIndex, Ipv4Addr *pxAddr)
+{
+    char cAddr[16];
+    const char *pcParameter;
+    BaseType_t xParameterLength;
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, uxIndex, &xParameterLength);
+    if (pcParameter == NULL || (size_t) xParameterLength >= sizeof(cAddr))
+    {
+        return pdFALSE;
+    }
+
+    memcpy(cAddr, pcParameter, xParameterLength);
+    cAddr[xParameterLength] = '\0';
+
+    return (ipv4StringToAddr(cAddr, pxAddr) == NO_ERROR) ? pdTRUE : pdFALSE;
+}
+
+/* "route add|del|forward ..." */
+static void prvRouteSet(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString,
+                        const char *pcAction, BaseType_t xActionLength)
+{
+    const char *pcParameter;
+    BaseType_t xParameterLength;
+    Ipv4Addr xNet;
+    Ipv4Addr xMask;
+    Ipv4Addr xGateway = IPV4_UNSPECIFIED_ADDR;
+    NetInterface *pxInterface = NULL;
+    BaseType_t xEnable;
+    error_t xError;
+    UBaseType_t i;
+
+    if (xActionLength == 7 && strncmp(pcAction, "forward", 7) == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterLength);
+        if (pcParameter != NULL && xParameterLength == 2 && strncmp(pcParameter, "on", 2) == 0)
+        {
+            xEnable = pdTRUE;
+        }
+        else if (pcParameter != NULL && xParameterLength == 3 && strncmp(pcParameter, "off", 3) == 0)
+        {
+            xEnable = pdFALSE;
+        }
+        else
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: route forward on|off\r\n");
+            return;
+        }
+
+        /* Packets are only forwarded between Ethernet interfaces */
+        for (i = 0; i < NET_INTERFACE_COUNT; i++)
+        {
+            if (netInterface[i].nicDriver != NULL && netInterface[i].nicDriver->type == NIC_TYPE_ETHERNET)
+            {
+                (void) ipv4EnableRouting(&netInterface[i], xEnable ? TRUE : FALSE);
+            }
+        }
+
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Forwarding %s\r\n", xEnable ? "enabled" : "disabled");
+        return;
+    }
+
+    if (!prvRouteGetAddr(pcCommandString, 2, &xNet) || !prvRouteGetAddr(pcCommandString, 3, &xMask))
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: route add <net> <mask> <if> [gw] | del <net> <mask>\r\n");
+        return;
+    }
+
+    if (xActionLength == 3 && strncmp(pcAction, "del", 3) == 0)
+    {
+        xError = ipv4DeleteRoute(xNet, xMask);
+        snprintf(pcWriteBuffer, xWriteBufferLen, (xError == NO_ERROR) ? "Route deleted\r\n" : "No such route\r\n");
+        return;
+    }
+
+    if (xActionLength != 3 || strncmp(pcAction, "add", 3) != 0)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: route add <net> <mask> <if> [gw] | del <net> <mask>\r\n");
+        return;
+    }
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 4, &xParameterLength);
+    for (i = 0; pcParameter != NULL && i < NET_INTERFACE_COUNT; i++)
+    {
+        if (strlen(netInterface[i].name) == (size_t) xParameterLength &&
+            strncmp(netInterface[i].name, pcParameter, xParameterLength) == 0)
+        {
+            pxInterface = &netInterface[i];
+        }
+    }
+
+    if (pxInterface == NULL)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Unknown interface\r\n");
+        return;
+    }
+
+    /* No gateway for a directly connected network */
+    if (FreeRTOS_CLIGetParameter(pcCommandString, 5, &xParameterLength) != NULL &&
+        !prvRouteGetAddr(pcCommandString, 5, &xGateway))
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid gateway\r\n");
+        return;
+    }
+
+    xError = ipv4AddRoute(xNet, xMask, pxInterface, xGateway, 0);
+    snprintf(pcWriteBuffer, xWriteBufferLen, (xError == NO_ERROR) ? "Route added\r\n" : "Routing table full\r\n");
+}
+
+static BaseType_t prvRouteCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    const char *pcParameter;
+    BaseType_t xParameterLength;
+    Ipv4RoutingStats xStats;
+    Ipv4RoutingTableEntry xEntry;
+    char cNet[16];
+    char cMask[16];
+    char cGateway[16];
+
+    if (uxRouteLine == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterLength);
+        if (pcParameter != NULL)
+        {
+            prvRouteSet(pcWriteBuffer, xWriteBufferLen, pcCommandString, pcParameter, xParameterLength);
+            return pdFALSE;
+        }
+
+        ipv4GetRoutingStats(&xStats);
+        snprintf(pcWriteBuffer, xWriteBufferLen, "\r\nforwarded=%lu in-place=%lu cache-hit=%lu cache-miss=%lu\r\n",
+                 (unsigned long) xStats.forwarded, (unsigned long) xStats.inPlace,
+                 (unsigned long) xStats.cacheHits, (unsigned long) xStats.cacheMisses);
+        uxRouteLine = 1;
+        return pdTRUE;
+    }
+
+    if (uxRouteLine == 1)
+    {
+        ipv4GetRoutingStats(&xStats);
+        snprintf(pcWriteBuffer, xWriteBufferLen, "dropped: no-route=%lu ttl=%lu too-big=%lu header=%lu tx=%lu\r\n",
+                 (unsigned long) xStats.noRoute, (unsigned long) xStats.ttlExceeded,
+                 (unsigned long) xStats.tooBig, (unsigned long) xStats.headerErrors,
+                 (unsigned long) xStats.txErrors);
+        uxRouteLine = 2;
+        return pdTRUE;
+    }
+
+    if (uxRouteLine == 2)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Network          Mask             Gateway          Interface\r\n");
+        uxRouteLine = 3;
+        return pdTRUE;
+    }
+
+    /* Free entries print an empty line */
+    if (ipv4GetRoute(uxRouteLine - 3, &xEntry) == NO_ERROR)
+    {
+        ipv4AddrToString(xEntry.networkDest, cNet);
+        ipv4AddrToString(xEntry.networkMask, cMask);
+        if (xEntry.nextHop != IPV4_UNSPECIFIED_ADDR)
+        {
+            ipv4AddrToString(xEntry.nextHop, cGateway);
+        }
+        else
+        {
+            strcpy(cGateway, "on-link");
+        }
+
+        snprintf(pcWriteBuffer, xWriteBufferLen, "%-16s %-16s %-16s %s\r\n", cNet, cMask, cGateway,
+                 xEntry.interface->name);
+    }
+    else
+    {
+        pcWriteBuffer[0] = '\0';
+    }
+
+    if (++uxRouteLine >= IPV4_ROUTING_TABLE_SIZE + 3)
+    {
+        uxRouteLine = 0;
+        return pdFALSE;
+    }
+
+    return pdTRUE;
+}
+
+#endif
+
+#if (IPV4_SUPPORT == ENABLED && NAT_SUPPORT == ENABLED)
+
+static BaseType_t prvNatCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xNat =
+{
+    "nat",
+    "\r\nnat:\r\n NAT translation counters and session table occupancy\r\n",
+    prvNatCommand,
+    0
+};
+
+/* Counters and active session count read together by natGetStats(): the
+ * session table keeps changing while the lines are printed */
+static NatStats xNatReport;
+static uint_t uxNatSessions;
+static UBaseType_t uxNatLine = 0;
+
+static BaseType_t prvNatCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    NatContext *pxContext = netContext.natContext;
+
+    (void) pcCommandString;
+
+    if (uxNatLine == 0)
+    {
+        if (pxContext == NULL || !pxContext->running)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "NAT not running\r\n");
+            return pdFALSE;
+        }
+
+        natGetStats(pxContext, &xNatReport, &uxNatSessions);
+    }
+
+    switch (uxNatLine++)
+    {
+    case 0:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "\r\npackets: outbound=%lu inbound=%lu icmp-error=%lu\r\n",
+                 (unsigned long) xNatReport.outboundPackets, (unsigned long) xNatReport.inboundPackets,
+                 (unsigned long) xNatReport.icmpErrors);
+        return pdTRUE;
+    case 1:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "sessions: active=%lu/%lu created=%lu expired=%lu\r\n",
+                 (unsigned long) uxNatSessions, (unsigned long) pxContext->numSessions,
+                 (unsigned long) xNatReport.sessionsCreated, (unsigned long) xNatReport.sessionsExpired);
+        return pdTRUE;
+    default:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "dropped: table-full=%lu no-port=%lu other=%lu\r\n",
+                 (unsigned long) xNatReport.tableFull, (unsigned long) xNatReport.portExhausted,
+                 (unsigned long) xNatReport.dropped);
+        uxNatLine = 0;
+        return pdFALSE;
+    }
+}
+
+#endif
+
+#if (IPV4_SUPPORT == ENABLED && IPV4_FIREWALL_SUPPORT == ENABLED)
+
+static BaseType_t prvFirewallCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xFirewall =
+{
+    "firewall",
+    "\r\nfirewall [add accept|drop <match> | del <n>|all | default accept|drop | clear]:\r\n Ingress rules and counters\r\n",
+    prvFirewallCommand,
+    -1
+};
+
+/* Lines 0 and 1 are the counters and the header, then one rule per call */
+static UBaseType_t uxFirewallLine = 0;
+
+/* Copy parameter uxIndex as a string; pdFALSE if missing or too long */
+static BaseType_t prvFirewallGetWord(const char *pcCommandString, UBaseType_t uxIndex, char *pcWord, size_t xSize)
+{
+    const char *pcParameter;
+    BaseType_t xParameterLength;
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, uxIndex, &xParameterLength);
+    if (pcParameter == NULL || (size_t) xParameterLength >= xSize)
+    {
+        return pdFALSE;
+    }
+
+    memcpy(pcWord, pcParameter, xParameterLength);
+    pcWord[xParameterLength] = '\0';
+    return pdTRUE;
+}
+
+/* "a.b.c.d[/len]", a missing length standing for a host */
+static BaseType_t prvFirewallParseNet(char *pcWord, Ipv4Addr *pxAddr, Ipv4Addr *pxMask)
+{
+    char *pcSlash;
+    unsigned long ulLength = 32;
+
+    pcSlash = strchr(pcWord, '/');
+    if (pcSlash != NULL)
+    {
+        *pcSlash = '\0';
+        ulLength = strtoul(pcSlash + 1, NULL, 10);
+        if (ulLength > 32)
+        {
+            return pdFALSE;
+        }
+    }
+
+    if (ipv4StringToAddr(pcWord, pxAddr) != NO_ERROR)
+    {
+        return pdFALSE;
+    }
+
+    *pxMask = (ulLength == 0) ? 0 : htonl(0xFFFFFFFFUL << (32 - ulLength));
+    return pdTRUE;
+}
+
+/* "p" or "p-q" */
+static BaseType_t prvFirewallParsePorts(const char *pcWord, uint16_t *pusMin, uint16_t *pusMax)
+{
+    char *pcEnd;
+    unsigned long ulMin;
+    unsigned long ulMax;
+
+    ulMin = strtoul(pcWord, &pcEnd, 10);
+    ulMax = (*pcEnd == '-') ? strtoul(pcEnd + 1, NULL, 10) : ulMin;
+    if (ulMin == 0 || ulMax < ulMin || ulMax > 65535)
+    {
+        return pdFALSE;
+    }
+
+    *pusMin = (uint16_t) ulMin;
+    *pusMax = (uint16_t) ulMax;
+    return pdTRUE;
+}
+
+/* "firewall add accept|drop ..." */
+static void prvFirewallAdd(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    Ipv4FirewallRule xRule;
+    char cWord[24];
+    char cValue[24];
+    UBaseType_t uxIndex;
+    uint_t uxRule;
+    BaseType_t xValid = pdTRUE;
+    error_t xError;
+
+    memset(&xRule, 0, sizeof(xRule));
+
+    if (!prvFirewallGetWord(pcCommandString, 2, cWord, sizeof(cWord)))
+    {
+        xValid = pdFALSE;
+    }
+    else if (strcmp(cWord, "accept") == 0)
+    {
+        xRule.action = IPV4_FIREWALL_ACTION_ACCEPT;
+    }
+    else if (strcmp(cWord, "drop") == 0)
+    {
+        xRule.action = IPV4_FIREWALL_ACTION_DROP;
+    }
+    else
+    {
+        xValid = pdFALSE;
+    }
+
+    /* Keyword and value pairs, the protocol standing alone */
+    for (uxIndex = 3; xValid && prvFirewallGetWord(pcCommandString, uxIndex, cWord, sizeof(cWord)); uxIndex++)
+    {
+        if (strcmp(cWord, "tcp") == 0)
+        {
+            xRule.protocol = IPV4_PROTOCOL_TCP;
+            continue;
+        }
+        if (strcmp(cWord, "udp") == 0)
+        {
+            xRule.protocol = IPV4_PROTOCOL_UDP;
+            continue;
+        }
+        if (strcmp(cWord, "icmp") == 0)
+        {
+            xRule.protocol = IPV4_PROTOCOL_ICMP;
+            continue;
+        }
+        if (cWord[0] >= '1' && cWord[0] <= '9')
+        {
+            xRule.protocol = (uint8_t) strtoul(cWord, NULL, 10);
+            continue;
+        }
+
+        if (!prvFirewallGetWord(pcCommandString, ++uxIndex, cValue, sizeof(cValue)))
+        {
+            xValid = pdFALSE;
+        }
+        else if (strcmp(cWord, "src") == 0)
+        {
+            xValid = prvFirewallParseNet(cValue, &xRule.srcAddr, &xRule.srcMask);
+        }
+        else if (strcmp(cWord, "dst") == 0)
+        {
+            xValid = prvFirewallParseNet(cValue, &xRule.destAddr, &xRule.destMask);
+        }
+        else if (strcmp(cWord, "sport") == 0)
+        {
+            xValid = prvFirewallParsePorts(cValue, &xRule.srcPortMin, &xRule.srcPortMax);
+        }
+        else if (strcmp(cWord, "dport") == 0)
+        {
+            xValid = prvFirewallParsePorts(cValue, &xRule.destPortMin, &xRule.destPortMax);
+        }
+        else
+        {
+            xValid = pdFALSE;
+        }
+    }
+
+    if (!xValid)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: firewall add accept|drop [proto] [src|dst <a>[/len]] [sport|dport <p>[-q]]\r\n");
+        return;
+    }
+
+    xError = ipv4FirewallAddRule(&xRule, &uxRule);
+    if (xError == ERROR_OUT_OF_RESOURCES)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Rule table full\r\n");
+    }
+    else if (xError != NO_ERROR)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Ports need tcp or udp\r\n");
+    }
+    else
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Rule %u added\r\n", (unsigned int) uxRule);
+    }
+}
+
+/* "firewall add|del|default|clear ..." */
+static void prvFirewallSet(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString,
+                           const char *pcAction, BaseType_t xActionLength)
+{
+    char cWord[8];
+    error_t xError;
+
+    if (xActionLength == 3 && strncmp(pcAction, "add", 3) == 0)
+    {
+        prvFirewallAdd(pcWriteBuffer, xWriteBufferLen, pcCommandString);
+    }
+    else if (xActionLength == 3 && strncmp(pcAction, "del", 3) == 0 &&
+             prvFirewallGetWord(pcCommandString, 2, cWord, sizeof(cWord)))
+    {
+        if (strcmp(cWord, "all") == 0)
+        {
+            xError = ipv4FirewallDeleteAllRules();
+        }
+        else
+        {
+            xError = ipv4FirewallDeleteRule((uint_t) strtoul(cWord, NULL, 10));
+        }
+        snprintf(pcWriteBuffer, xWriteBufferLen, (xError == NO_ERROR) ? "Rule deleted\r\n" : "No such rule\r\n");
+    }
+    else if (xActionLength == 7 && strncmp(pcAction, "default", 7) == 0 &&
+             prvFirewallGetWord(pcCommandString, 2, cWord, sizeof(cWord)) &&
+             (strcmp(cWord, "accept") == 0 || strcmp(cWord, "drop") == 0))
+    {
+        (void) ipv4FirewallSetDefaultAction((cWord[0] == 'a') ? IPV4_FIREWALL_ACTION_ACCEPT : IPV4_FIREWALL_ACTION_DROP);
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Default action: %s\r\n", cWord);
+    }
+    else if (xActionLength == 5 && strncmp(pcAction, "clear", 5) == 0)
+    {
+        ipv4FirewallClearStats();
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Counters cleared\r\n");
+    }
+    else
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: firewall [add ... | del <n>|all | default accept|drop | clear]\r\n");
+    }
+}
+
+/* Address and prefix length, or "any" */
+static void prvFirewallFormatNet(char *pcBuffer, size_t xSize, Ipv4Addr xAddr, Ipv4Addr xMask)
+{
+    char cAddr[16];
+
+    if (xMask == 0)
+    {
+        snprintf(pcBuffer, xSize, "any");
+    }
+    else
+    {
+        ipv4AddrToString(xAddr, cAddr);
+        snprintf(pcBuffer, xSize, "%s/%u", cAddr, (unsigned int) ipv4GetPrefixLength(xMask));
+    }
+}
+
+/* Port range, or "any" */
+static void prvFirewallFormatPorts(char *pcBuffer, size_t xSize, uint16_t usMin, uint16_t usMax)
+{
+    if (usMax == 0)
+    {
+        snprintf(pcBuffer, xSize, "any");
+    }
+    else if (usMin == usMax)
+    {
+        snprintf(pcBuffer, xSize, "%u", (unsigned int) usMin);
+    }
+    else
+    {
+        snprintf(pcBuffer, xSize, "%u-%u", (unsigned int) usMin, (unsigned int) usMax);
+    }
+}
+
+static BaseType_t prvFirewallCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    const char *pcParameter;
+    BaseType_t xParameterLength;
+    Ipv4FirewallStats xStats;
+    Ipv4FirewallEntry xEntry;
+    char cProto[6];
+    char cSrc[20];
+    char cDst[20];
+    char cSport[12];
+    char cDport[12];
+
+    if (uxFirewallLine == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterLength);
+        if (pcParameter != NULL)
+        {
+            prvFirewallSet(pcWriteBuffer, xWriteBufferLen, pcCommandString, pcParameter, xParameterLength);
+            return pdFALSE;
+        }
+
+        ipv4FirewallGetStats(&xStats);
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "\r\nrules=%u hw-filters=%u accepted=%lu dropped=%lu default %s: %lu pkts %lu bytes\r\n",
+                 (unsigned int) xStats.ruleCount, (unsigned int) xStats.hwFilterCount,
+                 (unsigned long) xStats.accepted, (unsigned long) xStats.dropped,
+                 (xStats.defaultAction == IPV4_FIREWALL_ACTION_DROP) ? "drop" : "accept",
+                 (unsigned long) xStats.defaultPackets, (unsigned long) xStats.defaultBytes);
+        uxFirewallLine = 1;
+        return pdTRUE;
+    }
+
+    if (uxFirewallLine == 1)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 " # Action Proto Source             Destination        Sport       Dport             Packets        Bytes\r\n");
+        uxFirewallLine = 2;
+        return pdTRUE;
+    }
+
+    if (ipv4FirewallGetRule(uxFirewallLine - 2, &xEntry) != NO_ERROR)
+    {
+        /* No rule, or deleted meanwhile */
+        pcWriteBuffer[0] = '\0';
+        uxFirewallLine = 0;
+        return pdFALSE;
+    }
+
+    if (xEntry.rule.protocol == 0)
+    {
+        snprintf(cProto, sizeof(cProto), "any");
+    }
+    else
+    {
+        snprintf(cProto, sizeof(cProto), "%s", (xEntry.rule.protocol == IPV4_PROTOCOL_TCP) ? "tcp"
+                 : (xEntry.rule.protocol == IPV4_PROTOCOL_UDP) ? "udp"
+                 : (xEntry.rule.protocol == IPV4_PROTOCOL_ICMP) ? "icmp" : "");
+        if (cProto[0] == '\0')
+        {
+            snprintf(cProto, sizeof(cProto), "%u", (unsigned int) xEntry.rule.protocol);
+        }
+    }
+
+    prvFirewallFormatNet(cSrc, sizeof(cSrc), xEntry.rule.srcAddr, xEntry.rule.srcMask);
+    prvFirewallFormatNet(cDst, sizeof(cDst), xEntry.rule.destAddr, xEntry.rule.destMask);
+    prvFirewallFormatPorts(cSport, sizeof(cSport), xEntry.rule.srcPortMin, xEntry.rule.srcPortMax);
+    prvFirewallFormatPorts(cDport, sizeof(cDport), xEntry.rule.destPortMin, xEntry.rule.destPortMax);
+
+    snprintf(pcWriteBuffer, xWriteBufferLen, "%2u %-6s %-5s %-18s %-18s %-11s %-11s %-2s %10lu %12lu\r\n",
+             (unsigned int) (uxFirewallLine - 2),
+             (xEntry.rule.action == IPV4_FIREWALL_ACTION_DROP) ? "drop" : "accept", cProto, cSrc, cDst,
+             cSport, cDport, xEntry.hardware ? "hw" : "", (unsigned long) xEntry.packets,
+             (unsigned long) xEntry.bytes);
+
+    uxFirewallLine++;
+    return pdTRUE;
+}
+
+#endif
+
+#if (IPV4_SUPPORT == ENABLED && ICMP_RATE_LIMIT_SUPPORT == ENABLED)
+
+static BaseType_t prvIcmpLimitCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xIcmpLimit =
+{
+    "icmp-limit",
+    "\r\nicmp-limit [echo|unreach|ttl|other|source <msgs/s> [burst]]:\r\n ICMP rate limits, 0 msgs/s for none\r\n",
+    prvIcmpLimitCommand,
+    -1
+};
+
+/* Names of the classes, in IcmpRateClass order */
+static const char * const pcIcmpRateClasses[ICMP_RATE_CLASS_COUNT] =
+{
+    "echo", "unreach", "ttl", "other", "source"
+};
+
+/* Line 0 is the header, then one line per class */
+static UBaseType_t uxIcmpLimitLine = 0;
+
+/* "icmp-limit <class> <rate> [burst]" */
+static void prvIcmpLimitSet(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString,
+                            const char *pcClass, BaseType_t xClassLength)
+{
+    const char *pcParameter;
+    BaseType_t xParameterLength;
+    UBaseType_t uxClass;
+    unsigned long ulRate;
+    unsigned long ulBurst;
+    IcmpRateBucket xBucket;
+
+    for (uxClass = 0; uxClass < ICMP_RATE_CLASS_COUNT; uxClass++)
+    {
+        if ((size_t) xClassLength == strlen(pcIcmpRateClasses[uxClass]) &&
+            strncmp(pcClass, pcIcmpRateClasses[uxClass], (size_t) xClassLength) == 0)
+        {
+            break;
+        }
+    }
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterLength);
+    if (uxClass == ICMP_RATE_CLASS_COUNT || pcParameter == NULL)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: icmp-limit [echo|unreach|ttl|other|source <msgs/s> [burst]]\r\n");
+        return;
+    }
+    ulRate = strtoul(pcParameter, NULL, 10);
+
+    /* The burst is kept when not given */
+    (void) icmpGetRateLimitInfo((IcmpRateClass) uxClass, &xBucket);
+    ulBurst = xBucket.burst;
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 3, &xParameterLength);
+    if (pcParameter != NULL)
+    {
+        ulBurst = strtoul(pcParameter, NULL, 10);
+    }
+
+    if (icmpSetRateLimit((IcmpRateClass) uxClass, (uint32_t) ulRate, (uint32_t) ulBurst) != NO_ERROR)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid burst %lu\r\n", ulBurst);
+    }
+    else if (ulRate == 0)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "%s unlimited\r\n", pcIcmpRateClasses[uxClass]);
+    }
+    else
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "%s limited to %lu msgs/s, burst %lu\r\n",
+                 pcIcmpRateClasses[uxClass], ulRate, ulBurst);
+    }
+}
+
+static BaseType_t prvIcmpLimitCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    const char *pcParameter;
+    BaseType_t xParameterLength;
+    IcmpRateBucket xBucket;
+
+    if (uxIcmpLimitLine == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterLength);
+        if (pcParameter != NULL)
+        {
+            prvIcmpLimitSet(pcWriteBuffer, xWriteBufferLen, pcCommandString, pcParameter, xParameterLength);
+            return pdFALSE;
+        }
+
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "\r\nClass    Rate/s  Burst  Tokens       Sent    Limited\r\n");
+        uxIcmpLimitLine = 1;
+        return pdTRUE;
+    }
+
+    (void) icmpGetRateLimitInfo((IcmpRateClass) (uxIcmpLimitLine - 1), &xBucket);
+
+    if (xBucket.rate == 0)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "%-7s %7s %6s %7s %10lu %10lu\r\n",
+                 pcIcmpRateClasses[uxIcmpLimitLine - 1], "-", "-", "-",
+                 (unsigned long) xBucket.sent, (unsigned long) xBucket.limited);
+    }
+    else if (uxIcmpLimitLine - 1 == ICMP_RATE_CLASS_SOURCE)
+    {
+        /* Each source has its own tokens */
+        snprintf(pcWriteBuffer, xWriteBufferLen, "%-7s %7lu %6lu %7s %10lu %10lu\r\n",
+                 pcIcmpRateClasses[uxIcmpLimitLine - 1], (unsigned long) xBucket.rate,
+                 (unsigned long) xBucket.burst, "-", (unsigned long) xBucket.sent,
+                 (unsigned long) xBucket.limited);
+    }
+    else
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "%-7s %7lu %6lu %7lu %10lu %10lu\r\n",
+                 pcIcmpRateClasses[uxIcmpLimitLine - 1], (unsigned long) xBucket.rate,
+                 (unsigned long) xBucket.burst, (unsigned long) (xBucket.credit / 1000),
+                 (unsigned long) xBucket.sent, (unsigned long) xBucket.limited);
+    }
+
+    if (++uxIcmpLimitLine > ICMP_RATE_CLASS_COUNT)
+    {
+        uxIcmpLimitLine = 0;
+        return pdFALSE;
+    }
+
+    return pdTRUE;
+}
+
+#endif
+
+void vRegisterNetCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xLinkUp);
+    FreeRTOS_CLIRegisterCommand(&xSs);
+#if (NET_STATS_SUPPORT == ENABLED)
+    FreeRTOS_CLIRegisterCommand(&xNetstat);
+#endif
+#if (NET_LATENCY_SUPPORT == ENABLED)
+    FreeRTOS_CLIRegisterCommand(&xNetLatency);
+#endif
+#if (OS_MUTEX_STATS_SUPPORT == ENABLED)
+    FreeRTOS_CLIRegisterCommand(&xNetLocks);
+#endif
+#if (IPV4_SUPPORT == ENABLED && DHCP_SERVER_SUPPORT == ENABLED)
+    FreeRTOS_CLIRegisterCommand(&xDhcpServer);
+#endif
+#if (NET_LOOPBACK_IF_SUPPORT == ENABLED)
+    FreeRTOS_CLIRegisterCommand(&xLoopback);
+#endif
+#if (NET_SHAPER_SUPPORT == ENABLED)
+    FreeRTOS_CLIRegisterCommand(&xShaper);
+#endif
+#if (IPV4_SUPPORT == ENABLED && IPV4_ROUTING_SUPPORT == ENABLED)
+    FreeRTOS_CLIRegisterCommand(&xRoute);
+#endif
+#if (IPV4_SUPPORT == ENABLED && NAT_SUPPORT == ENABLED)
+    FreeRTOS_CLIRegisterCommand(&xNat);
+#endif
+#if (IPV4_SUPPORT == ENABLED && IPV4_FIREWALL_SUPPORT == ENABLED)
+    FreeRTOS_CLIRegisterCommand(&xFirewall);
+#endif
+#if (IPV4_SUPPORT == ENABLED && ICMP_RATE_LIMIT_SUPPORT == ENABLED)
+    FreeRTOS_CLIRegisterCommand(&xIcmpLimit);
+#endif
+}
@@ -0,0 +1,713 @@
+/* NetReplay.c
+ *
+ * Traffic replay into the receive path (see NetReplay.h). At the start of a
+ * run the frames of the mix are copied from flash into a pool, addressed to
+ * the interface and given valid checksums. The task then wakes every tick,
+ * and injects the frames due by then in batches, each under one hold of the
+ * stack mutex and between nicBeginRxBatch() and nicEndRxBatch(), as the
+ * driver event handler does. A frame is copied into a receive buffer before
+ * each injection, since the stack converts some headers in place.
+ */
+#include "NetReplay.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "CommandConsoleDualTask.h"
+#include "RunTimeStats.h"
+#include "MonoClock.h"
+#include "StaticAlloc.h"
+#include "stm32h7xx.h"
+#include "core/net.h"
+#include "core/ip.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Fields of a template rewritten for the interface */
+#define REPLAY_PATCH_DST_MAC           0x01u  /* Ethernet destination */
+#define REPLAY_PATCH_DST_IP            0x02u  /* IPv4 destination */
+#define REPLAY_PATCH_ARP_TARGET        0x04u  /* Target protocol address of an ARP request */
+
+/* Offsets in the frames */
+#define REPLAY_ETH_TYPE                12u
+#define REPLAY_IP_HEADER               14u
+#define REPLAY_IP_HEADER_SIZE          20u
+#define REPLAY_IP_PROTOCOL             23u
+#define REPLAY_IP_CHECKSUM             24u
+#define REPLAY_IP_SRC                  26u
+#define REPLAY_IP_DST                  30u
+#define REPLAY_L4_HEADER               34u
+#define REPLAY_ARP_TARGET              38u
+
+/* Frame types */
+typedef enum
+{
+    eReplayArp = 0,
+    eReplayMdns,
+    eReplayTcp,
+    eReplayCyphal,
+    eReplayStorm,
+    eReplayTypeCount
+} ReplayType_t;
+
+/* A frame as kept in flash: its headers, zero-padded up to the length */
+typedef struct
+{
+    const char *pcName;
+    const uint8_t *pucHeader;
+    uint16_t usHeaderLength;
+    uint16_t usFrameLength;
+    uint8_t ucPatch;        /* REPLAY_PATCH_xxx */
+} ReplayTemplate_t;
+
+/* A mix: the sequence of frame types it cycles through */
+typedef struct
+{
+    const char *pcName;
+    const uint8_t *pucSequence;
+    uint8_t ucLength;
+} ReplayMix_t;
+
+/* Timing of one frame type */
+typedef struct
+{
+    uint32_t ulFrames;
+    uint64_t ullCycles;
+    uint32_t ulMinCycles;
+    uint32_t ulMaxCycles;
+} ReplayFrameStats_t;
+
+/* Outcome of a run */
+typedef struct
+{
+    const ReplayMix_t *pxMix;
+    uint32_t ulRate;
+    uint32_t ulCount;
+    uint32_t ulInjected;
+    uint64_t ullElapsedUs;
+    ReplayFrameStats_t xFrames[eReplayTypeCount];
+    uint64_t ullLateSumUs;      /* Wake-up delay against the schedule */
+    uint32_t ulLateMaxUs;
+    uint32_t ulWakeups;
+    uint32_t ulOverruns;        /* Batches cut short with frames still due */
+    uint32_t ulCpuPermille;
+    NetProtocolStats xProtocolDrops;   /* Counters over the run */
+    NetInterfaceStats xInterfaceDrops;
+} ReplayResult_t;
+
+/* Parameters of a run, set by the CLI before waking the task */
+typedef struct
+{
+    const ReplayMix_t *pxMix;
+    uint32_t ulRate;
+    uint32_t ulCount;
+} ReplayRequest_t;
+
+/* State of the console job following a run */
+typedef struct
+{
+    uint32_t ulRun;
+    UBaseType_t uxLine;
+} ReplayMonitor_t;
+
+/* Who-has for the interface address, from 198.18.0.1 */
+static const uint8_t ucArpFrame[] =
+{
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02, 0x52, 0x50, 0x00, 0x00, 0x01, 0x08, 0x06,
+    0x00, 0x01, 0x08, 0x00, 0x06, 0x04, 0x00, 0x01,
+    0x02, 0x52, 0x50, 0x00, 0x00, 0x01, 0xc6, 0x12, 0x00, 0x01,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+/* mDNS query of another host, PTR _googlecast._tcp.local */
+static const uint8_t ucMdnsFrame[] =
+{
+    0x01, 0x00, 0x5e, 0x00, 0x00, 0xfb, 0x02, 0x52, 0x50, 0x00, 0x00, 0x02, 0x08, 0x00,
+    0x45, 0x00, 0x00, 0x44, 0x00, 0x00, 0x40, 0x00, 0xff, 0x11, 0x00, 0x00,
+    0xc6, 0x12, 0x00, 0x02, 0xe0, 0x00, 0x00, 0xfb,
+    0x14, 0xe9, 0x14, 0xe9, 0x00, 0x30, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x0b, '_', 'g', 'o', 'o', 'g', 'l', 'e', 'c', 'a', 's', 't',
+    0x04, '_', 't', 'c', 'p', 0x05, 'l', 'o', 'c', 'a', 'l', 0x00,
+    0x00, 0x0c, 0x00, 0x01
+};
+
+/* Full-sized segment of a bulk transfer to the iperf port */
+static const uint8_t ucTcpFrame[] =
+{
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x52, 0x50, 0x00, 0x00, 0x03, 0x08, 0x00,
+    0x45, 0x00, 0x05, 0xdc, 0x00, 0x00, 0x40, 0x00, 0x40, 0x06, 0x00, 0x00,
+    0xc6, 0x12, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00,
+    0x9c, 0x40, 0x13, 0x89, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+    0x50, 0x18, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00
+};
+
+/* Cyphal/UDP heartbeat of node 100 (subject 7509, group 239.0.29.85) */
+static const uint8_t ucCyphalFrame[] =
+{
+    0x01, 0x00, 0x5e, 0x00, 0x1d, 0x55, 0x02, 0x52, 0x50, 0x00, 0x00, 0x04, 0x08, 0x00,
+    0x45, 0x00, 0x00, 0x3f, 0x00, 0x00, 0x40, 0x00, 0x10, 0x11, 0x00, 0x00,
+    0xc6, 0x12, 0x00, 0x04, 0xef, 0x00, 0x1d, 0x55,
+    0x24, 0xa6, 0x24, 0xa6, 0x00, 0x2b, 0x00, 0x00,
+    0x01, 0x04, 0x64, 0x00, 0xff, 0xff, 0x55, 0x1d, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x8d, 0x74,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x6d, 0x6a, 0x3e, 0xbb
+};
+
+/* NetBIOS name query broadcast, the usual member of a broadcast storm */
+static const uint8_t ucStormFrame[] =
+{
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02, 0x52, 0x50, 0x00, 0x00, 0x05, 0x08, 0x00,
+    0x45, 0x00, 0x00, 0x4e, 0x00, 0x00, 0x00, 0x00, 0x80, 0x11, 0x00, 0x00,
+    0xc6, 0x12, 0x00, 0x05, 0xff, 0xff, 0xff, 0xff,
+    0x00, 0x89, 0x00, 0x89, 0x00, 0x3a, 0x00, 0x00,
+    0x12, 0x34, 0x01, 0x10, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x20, 'C', 'K', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A',
+    'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 0x00,
+    0x00, 0x20, 0x00, 0x01
+};
+
+static const ReplayTemplate_t xTemplates[eReplayTypeCount] =
+{
+    { "arp", ucArpFrame, sizeof(ucArpFrame), 60, REPLAY_PATCH_ARP_TARGET },
+    { "mdns", ucMdnsFrame, sizeof(ucMdnsFrame), sizeof(ucMdnsFrame), 0 },
+    { "tcp", ucTcpFrame, sizeof(ucTcpFrame), 1514, REPLAY_PATCH_DST_MAC | REPLAY_PATCH_DST_IP },
+    { "cyphal", ucCyphalFrame, sizeof(ucCyphalFrame), sizeof(ucCyphalFrame), 0 },
+    { "storm", ucStormFrame, sizeof(ucStormFrame), sizeof(ucStormFrame), 0 }
+};
+
+static const uint8_t ucArpSequence[] = { eReplayArp };
+static const uint8_t ucMdnsSequence[] = { eReplayMdns };
+static const uint8_t ucTcpSequence[] = { eReplayTcp };
+static const uint8_t ucCyphalSequence[] = { eReplayCyphal };
+static const uint8_t ucStormSequence[] = { eReplayStorm };
+
+/* Half TCP bulk data, then Cyphal, broadcasts, mDNS and ARP */
+static const uint8_t ucBlendSequence[] =
+{
+    eReplayTcp, eReplayCyphal, eReplayTcp, eReplayStorm, eReplayTcp, eReplayMdns, eReplayTcp, eReplayCyphal,
+    eReplayTcp, eReplayStorm, eReplayTcp, eReplayArp, eReplayTcp, eReplayCyphal, eReplayTcp, eReplayStorm,
+    eReplayTcp, eReplayMdns, eReplayTcp, eReplayCyphal
+};
+
+static const ReplayMix_t xMixes[] =
+{
+    { "arp", ucArpSequence, sizeof(ucArpSequence) },
+    { "mdns", ucMdnsSequence, sizeof(ucMdnsSequence) },
+    { "tcp", ucTcpSequence, sizeof(ucTcpSequence) },
+    { "cyphal", ucCyphalSequence, sizeof(ucCyphalSequence) },
+    { "storm", ucStormSequence, sizeof(ucStormSequence) },
+    { "mix", ucBlendSequence, sizeof(ucBlendSequence) }
+};
+
+#define REPLAY_MIX_COUNT               (sizeof(xMixes) / sizeof(xMixes[0]))
+
+static TaskHandle_t xReplayTask = NULL;
+APP_TASK_STORAGE(xReplayTask, NET_REPLAY_STACK_SIZE);
+static ReplayRequest_t xRequest;
+static volatile BaseType_t xReplayRunning = pdFALSE;
+static volatile BaseType_t xStopRequested = pdFALSE;
+
+/* Progress of the current run, written by the replay task only */
+static volatile uint32_t ulProgress = 0;
+
+/* Completed runs; xLastResult is valid once ulRunCount is non-zero */
+static volatile uint32_t ulRunCount = 0;
+static ReplayResult_t xLastResult;
+
+/* Frames of the mix as injected, and the buffer the stack receives them in */
+static uint8_t ucPool[NET_REPLAY_POOL_SIZE] __attribute__((aligned(4)));
+static uint16_t usPoolOffset[eReplayTypeCount];
+static uint8_t ucRxFrame[ETH_MAX_FRAME_SIZE] __attribute__((aligned(4)));
+
+/* Line of "replay show" */
+static UBaseType_t uxShowLine = 0;
+
+static BaseType_t prvReplayCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xReplay =
+{
+    "replay",
+    "\r\nreplay <arp|mdns|tcp|cyphal|storm|mix> [pkt/s] [count] | stop | show:\r\n"
+    " Inject recorded traffic into the RX path, timed\r\n",
+    prvReplayCommand,
+    -1
+};
+
+/* Checksum of an IPv4 header, or of a transport segment and its pseudo header */
+static void prvStoreChecksums(uint8_t *pucFrame, size_t xLength)
+{
+    uint8_t ucPseudo[12];
+    uint8_t *pucSegment = pucFrame + REPLAY_L4_HEADER;
+    size_t xSegmentLength = xLength - REPLAY_L4_HEADER;
+    size_t xChecksumOffset;
+    uint16_t usChecksum;
+
+    if (LOAD16BE(pucFrame + REPLAY_ETH_TYPE) != ETH_TYPE_IPV4)
+    {
+        return;
+    }
+
+    memset(pucFrame + REPLAY_IP_CHECKSUM, 0, 2);
+    usChecksum = ipCalcChecksum(pucFrame + REPLAY_IP_HEADER, REPLAY_IP_HEADER_SIZE);
+    memcpy(pucFrame + REPLAY_IP_CHECKSUM, &usChecksum, 2);
+
+    switch (pucFrame[REPLAY_IP_PROTOCOL])
+    {
+    case IPV4_PROTOCOL_TCP: xChecksumOffset = 16; break;
+    case IPV4_PROTOCOL_UDP: xChecksumOffset = 6; break;
+    default: return;
+    }
+
+    memcpy(ucPseudo, pucFrame + REPLAY_IP_SRC, 8);
+    ucPseudo[8] = 0;
+    ucPseudo[9] = pucFrame[REPLAY_IP_PROTOCOL];
+    STORE16BE((uint16_t) xSegmentLength, ucPseudo + 10);
+
+    memset(pucSegment + xChecksumOffset, 0, 2);
+    usChecksum = ipCalcUpperLayerChecksum(ucPseudo, sizeof(ucPseudo), pucSegment, xSegmentLength);
+
+    /* A zero UDP checksum means none */
+    if (usChecksum == 0 && pucFrame[REPLAY_IP_PROTOCOL] == IPV4_PROTOCOL_UDP)
+    {
+        usChecksum = 0xFFFF;
+    }
+    memcpy(pucSegment + xChecksumOffset, &usChecksum, 2);
+}
+
+/* Copy the frames of a mix into the pool, for the interface */
+static BaseType_t prvMaterialize(NetInterface *pxInterface, const ReplayMix_t *pxMix)
+{
+    const ReplayTemplate_t *pxTemplate;
+    Ipv4Addr xHostAddr;
+    uint8_t *pucFrame;
+    size_t xOffset = 0;
+    UBaseType_t i;
+
+    if (ipv4GetHostAddr(pxInterface, &xHostAddr) != NO_ERROR || xHostAddr == IPV4_UNSPECIFIED_ADDR)
+    {
+        return pdFAIL;
+    }
+
+    for (i = 0; i < eReplayTypeCount; i++)
+    {
+        usPoolOffset[i] = UINT16_MAX;
+    }
+
+    for (i = 0; i < pxMix->ucLength; i++)
+    {
+        pxTemplate = &xTemplates[pxMix->pucSequence[i]];
+        if (usPoolOffset[pxMix->pucSequence[i]] != UINT16_MAX)
+        {
+            continue;
+        }
+        if (xOffset + pxTemplate->usFrameLength > sizeof(ucPool))
+        {
+            return pdFAIL;
+        }
+
+        pucFrame = ucPool + xOffset;
+        memset(pucFrame, 0, pxTemplate->usFrameLength);
+        memcpy(pucFrame, pxTemplate->pucHeader, pxTemplate->usHeaderLength);
+
+        if ((pxTemplate->ucPatch & REPLAY_PATCH_DST_MAC) != 0)
+        {
+            memcpy(pucFrame, pxInterface->macAddr.b, sizeof(MacAddr));
+        }
+        if ((pxTemplate->ucPatch & REPLAY_PATCH_DST_IP) != 0)
+        {
+            memcpy(pucFrame + REPLAY_IP_DST, &xHostAddr, sizeof(Ipv4Addr));
+        }
+        if ((pxTemplate->ucPatch & REPLAY_PATCH_ARP_TARGET) != 0)
+        {
+            memcpy(pucFrame + REPLAY_ARP_TARGET, &xHostAddr, sizeof(Ipv4Addr));
+        }
+        prvStoreChecksums(pucFrame, pxTemplate->usFrameLength);
+
+        usPoolOffset[pxMix->pucSequence[i]] = (uint16_t) xOffset;
+        xOffset += (pxTemplate->usFrameLength + 3u) & ~3u;
+    }
+
+    return pdPASS;
+}
+
+/* Hand a frame to the stack, as the driver would; netMutex held */
+static void prvInject(NetInterface *pxInterface, ReplayType_t eType, ReplayFrameStats_t *pxStats)
+{
+    const ReplayTemplate_t *pxTemplate = &xTemplates[eType];
+    NetRxAncillary xAncillary;
+    uint32_t ulStart;
+    uint32_t ulCycles;
+
+    memcpy(ucRxFrame, ucPool + usPoolOffset[eType], pxTemplate->usFrameLength);
+    xAncillary = NET_DEFAULT_RX_ANCILLARY;
+
+    ulStart = DWT->CYCCNT;
+    nicProcessPacket(pxInterface, ucRxFrame, pxTemplate->usFrameLength, &xAncillary);
+    ulCycles = DWT->CYCCNT - ulStart;
+
+    pxStats->ulFrames++;
+    pxStats->ullCycles += ulCycles;
+    if (ulCycles < pxStats->ulMinCycles)
+    {
+        pxStats->ulMinCycles = ulCycles;
+    }
+    if (ulCycles > pxStats->ulMaxCycles)
+    {
+        pxStats->ulMaxCycles = ulCycles;
+    }
+}
+
+/* Growth of a counter over the run */
+static uint32_t prvDelta(uint32_t ulEnd, uint32_t ulStart)
+{
+    return ulEnd - ulStart;
+}
+
+static void prvReplayRun(void)
+{
+    NetInterface *pxInterface = &netInterface[0];
+    const ReplayMix_t *pxMix = xRequest.pxMix;
+    ReplayResult_t xResult;
+    RunTimeLoadSample_t xStartLoad;
+    RunTimeLoadSample_t xEndLoad;
+    NetProtocolStats xProtocolStart;
+    NetProtocolStats xProtocolEnd;
+    NetInterfaceStats xInterfaceStart;
+    NetInterfaceStats xInterfaceEnd;
+    uint64_t ullStartUs;
+    uint64_t ullNowUs;
+    uint64_t ullDueUs;
+    uint32_t ulDue;
+    uint32_t ulLateUs;
+    uint32_t ulBatch;
+    BaseType_t xReady;
+    UBaseType_t i;
+
+    memset(&xResult, 0, sizeof(xResult));
+    xResult.pxMix = pxMix;
+    xResult.ulRate = xRequest.ulRate;
+    xResult.ulCount = xRequest.ulCount;
+    for (i = 0; i < eReplayTypeCount; i++)
+    {
+        xResult.xFrames[i].ulMinCycles = UINT32_MAX;
+    }
+
+    osAcquireMutex(&netMutex);
+    xReady = prvMaterialize(pxInterface, pxMix);
+    osReleaseMutex(&netMutex);
+
+    if (xReady != pdPASS)
+    {
+        xLastResult = xResult;
+        ulRunCount++;
+        return;
+    }
+
+    netStatsGetProtocolStats(&xProtocolStart);
+    netStatsGetInterfaceStats(pxInterface->index, &xInterfaceStart);
+    vRunTimeStatsGetLoadSample(&xStartLoad);
+    ullStartUs = ullMonoClockNowUs();
+
+    while (xStopRequested == pdFALSE && xResult.ulInjected < xRequest.ulCount)
+    {
+        ullNowUs = ullMonoClockNowUs();
+
+        /* Frames due by now, and how late the oldest of them is */
+        if (xRequest.ulRate > 0)
+        {
+            ulDue = (uint32_t) MIN(((ullNowUs - ullStartUs) * xRequest.ulRate) / 1000000u, xRequest.ulCount);
+            if (ulDue <= xResult.ulInjected)
+            {
+                vTaskDelay(1);
+                continue;
+            }
+
+            ullDueUs = ullStartUs + ((uint64_t) xResult.ulInjected * 1000000u) / xRequest.ulRate;
+            ulLateUs = (uint32_t) (ullNowUs - ullDueUs);
+            xResult.ullLateSumUs += ulLateUs;
+            xResult.ulLateMaxUs = MAX(xResult.ulLateMaxUs, ulLateUs);
+            xResult.ulWakeups++;
+        }
+        else
+        {
+            ulDue = xRequest.ulCount;
+        }
+
+        ulBatch = MIN(ulDue - xResult.ulInjected, NET_REPLAY_BATCH);
+        if (xRequest.ulRate > 0 && ulDue - xResult.ulInjected > NET_REPLAY_BATCH)
+        {
+            xResult.ulOverruns++;
+        }
+
+        osAcquireMutex(&netMutex);
+        nicBeginRxBatch(pxInterface);
+
+        for (i = 0; i < ulBatch; i++)
+        {
+            ReplayType_t eType = (ReplayType_t) pxMix->pucSequence[xResult.ulInjected % pxMix->ucLength];
+
+            prvInject(pxInterface, eType, &xResult.xFrames[eType]);
+            xResult.ulInjected++;
+        }
+
+        nicEndRxBatch(pxInterface);
+        osReleaseMutex(&netMutex);
+
+        ulProgress = xResult.ulInjected;
+
+        /* Let the stack send what the batch produced, and the other tasks run */
+        taskYIELD();
+    }
+
+    xResult.ullElapsedUs = ullMonoClockNowUs() - ullStartUs;
+    vRunTimeStatsGetLoadSample(&xEndLoad);
+    xResult.ulCpuPermille = ulRunTimeStatsLoadPermille(&xStartLoad, &xEndLoad);
+
+    netStatsGetProtocolStats(&xProtocolEnd);
+    netStatsGetInterfaceStats(pxInterface->index, &xInterfaceEnd);
+    xResult.xProtocolDrops.udpNoPorts = prvDelta(xProtocolEnd.udpNoPorts, xProtocolStart.udpNoPorts);
+    xResult.xProtocolDrops.udpQueueFullDrops = prvDelta(xProtocolEnd.udpQueueFullDrops, xProtocolStart.udpQueueFullDrops);
+    xResult.xProtocolDrops.udpNoBufferDrops = prvDelta(xProtocolEnd.udpNoBufferDrops, xProtocolStart.udpNoBufferDrops);
+    xResult.xProtocolDrops.udpInErrors = prvDelta(xProtocolEnd.udpInErrors, xProtocolStart.udpInErrors);
+    xResult.xProtocolDrops.tcpInErrs = prvDelta(xProtocolEnd.tcpInErrs, xProtocolStart.tcpInErrs);
+    xResult.xProtocolDrops.ipv4InHdrErrors = prvDelta(xProtocolEnd.ipv4InHdrErrors, xProtocolStart.ipv4InHdrErrors);
+    xResult.xInterfaceDrops.rxMacFiltered = prvDelta(xInterfaceEnd.rxMacFiltered, xInterfaceStart.rxMacFiltered);
+    xResult.xInterfaceDrops.rxMcastFiltered = prvDelta(xInterfaceEnd.rxMcastFiltered, xInterfaceStart.rxMcastFiltered);
+
+    xLastResult = xResult;
+    ulRunCount++;
+}
+
+static void prvNetReplayTask(void *pvParameters)
+{
+    (void) pvParameters;
+
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        prvReplayRun();
+        xReplayRunning = pdFALSE;
+    }
+}
+
+BaseType_t xNetReplayStart(UBaseType_t uxPriority)
+{
+    return xAppTaskCreate(xReplayTask, prvNetReplayTask, "NetReplay", NET_REPLAY_STACK_SIZE, NULL, uxPriority, &xReplayTask);
+}
+
+void vNetReplayRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xReplay);
+}
+
+/* Cycles in hundredths of a microsecond */
+static uint32_t prvCentiUs(uint64_t ullCycles)
+{
+    uint32_t ulPerUs = SystemCoreClock / 1000000u;
+
+    return (ulPerUs > 0) ? (uint32_t) ((ullCycles * 100u) / ulPerUs) : 0;
+}
+
+/* Line uxLine of the report of the last run; pdFALSE after the last one */
+static BaseType_t prvReportLine(char *pcWriteBuffer, size_t xWriteBufferLen, UBaseType_t uxLine)
+{
+    const ReplayResult_t *pxResult = &xLastResult;
+    const ReplayFrameStats_t *pxStats;
+    uint32_t ulAverage;
+    uint32_t ulCentiUs;
+    UBaseType_t i;
+
+    if (pxResult->pxMix == NULL)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "No run yet\r\n");
+        return pdFALSE;
+    }
+
+    switch (uxLine)
+    {
+    case 0:
+        if (pxResult->ulInjected == 0)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "replay %s: nothing injected (no IPv4 address?)\r\n",
+                     pxResult->pxMix->pcName);
+            return pdFALSE;
+        }
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "replay %s: %lu/%lu frames in %lu ms, %lu pkt/s (%lu requested), CPU %lu.%lu%%\r\n",
+                 pxResult->pxMix->pcName, (unsigned long) pxResult->ulInjected, (unsigned long) pxResult->ulCount,
+                 (unsigned long) (pxResult->ullElapsedUs / 1000u),
+                 (unsigned long) ((pxResult->ullElapsedUs > 0) ?
+                                  ((uint64_t) pxResult->ulInjected * 1000000u) / pxResult->ullElapsedUs : 0),
+                 (unsigned long) pxResult->ulRate,
+                 (unsigned long) (pxResult->ulCpuPermille / 10), (unsigned long) (pxResult->ulCpuPermille % 10));
+        return pdTRUE;
+    case 1:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "schedule: late avg %lu us, max %lu us, %lu overruns\r\n",
+                 (unsigned long) ((pxResult->ulWakeups > 0) ? pxResult->ullLateSumUs / pxResult->ulWakeups : 0),
+                 (unsigned long) pxResult->ulLateMaxUs, (unsigned long) pxResult->ulOverruns);
+        return pdTRUE;
+    case 2:
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "drops: udp no port %lu, udp queue %lu, udp errors %lu, tcp errors %lu, ip header %lu, "
+                 "mac filter %lu, mcast filter %lu\r\n",
+                 (unsigned long) pxResult->xProtocolDrops.udpNoPorts,
+                 (unsigned long) (pxResult->xProtocolDrops.udpQueueFullDrops + pxResult->xProtocolDrops.udpNoBufferDrops),
+                 (unsigned long) pxResult->xProtocolDrops.udpInErrors,
+                 (unsigned long) pxResult->xProtocolDrops.tcpInErrs,
+                 (unsigned long) pxResult->xProtocolDrops.ipv4InHdrErrors,
+                 (unsigned long) pxResult->xInterfaceDrops.rxMacFiltered,
+                 (unsigned long) pxResult->xInterfaceDrops.rxMcastFiltered);
+        return pdTRUE;
+    default:
+        break;
+    }
+
+    /* One line per frame type; empty for the types not in the mix */
+    i = uxLine - 3;
+    pxStats = &pxResult->xFrames[i];
+    pcWriteBuffer[0] = '\0';
+
+    if (pxStats->ulFrames > 0)
+    {
+        ulAverage = (uint32_t) (pxStats->ullCycles / pxStats->ulFrames);
+        ulCentiUs = prvCentiUs(ulAverage);
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "  %-6s %7lu frames, cycles min %lu avg %lu max %lu (%lu.%02lu us avg)\r\n",
+                 xTemplates[i].pcName, (unsigned long) pxStats->ulFrames,
+                 (unsigned long) pxStats->ulMinCycles, (unsigned long) ulAverage,
+                 (unsigned long) pxStats->ulMaxCycles,
+                 (unsigned long) (ulCentiUs / 100), (unsigned long) (ulCentiUs % 100));
+    }
+
+    return (i + 1 < eReplayTypeCount) ? pdTRUE : pdFALSE;
+}
+
+/* Console job: a progress line while the run lasts, then its report */
+static eConsoleJobResult prvReplayMonitorJob(char *pcWriteBuffer, size_t xWriteBufferLen, void *pvContext)
+{
+    ReplayMonitor_t *pxMonitor = (ReplayMonitor_t *) pvContext;
+
+    if (ulRunCount == pxMonitor->ulRun)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "  %lu/%lu frames\r\n",
+                 (unsigned long) ulProgress, (unsigned long) xRequest.ulCount);
+        return eConsoleJobWait;
+    }
+
+    if (prvReportLine(pcWriteBuffer, xWriteBufferLen, pxMonitor->uxLine++) == pdFALSE)
+    {
+        return eConsoleJobDone;
+    }
+
+    return eConsoleJobMore;
+}
+
+static const ReplayMix_t *prvFindMix(const char *pcName, BaseType_t xLength)
+{
+    UBaseType_t i;
+
+    for (i = 0; i < REPLAY_MIX_COUNT; i++)
+    {
+        if (strlen(xMixes[i].pcName) == (size_t) xLength && strncmp(xMixes[i].pcName, pcName, xLength) == 0)
+        {
+            return &xMixes[i];
+        }
+    }
+
+    return NULL;
+}
+
+static BaseType_t prvReplayCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    ReplayMonitor_t xMonitor;
+    const char *pcParameter;
+    BaseType_t xParameterLength;
+    BaseType_t xNext;
+    const ReplayMix_t *pxMix;
+    uint32_t ulRate = NET_REPLAY_DEFAULT_RATE;
+    uint32_t ulCount = NET_REPLAY_DEFAULT_COUNT;
+    UBaseType_t i;
+
+    /* Remaining lines of "replay show" */
+    if (uxShowLine > 0)
+    {
+        xNext = prvReportLine(pcWriteBuffer, xWriteBufferLen, uxShowLine);
+        uxShowLine = (xNext != pdFALSE) ? uxShowLine + 1 : 0;
+        return xNext;
+    }
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterLength);
+    if (pcParameter == NULL)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: replay <mix> [pkt/s] [count] | stop | show\r\n");
+        return pdFALSE;
+    }
+
+    if (xParameterLength == 4 && strncmp(pcParameter, "stop", 4) == 0)
+    {
+        xStopRequested = pdTRUE;
+        for (i = 0; i < 10 && xReplayRunning != pdFALSE; i++)
+        {
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Stopped\r\n");
+        return pdFALSE;
+    }
+
+    if (xParameterLength == 4 && strncmp(pcParameter, "show", 4) == 0)
+    {
+        xNext = prvReportLine(pcWriteBuffer, xWriteBufferLen, 0);
+        uxShowLine = (xNext == pdFALSE) ? 0 : 1;
+        return xNext;
+    }
+
+    pxMix = prvFindMix(pcParameter, xParameterLength);
+    if (pxMix == NULL)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Unknown mix\r\n");
+        return pdFALSE;
+    }
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterLength);
+    if (pcParameter != NULL)
+    {
+        ulRate = strtoul(pcParameter, NULL, 10);
+    }
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 3, &xParameterLength);
+    if (pcParameter != NULL)
+    {
+        ulCount = strtoul(pcParameter, NULL, 10);
+    }
+    if (ulCount == 0)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid count\r\n");
+        return pdFALSE;
+    }
+
+    if (xReplayTask == NULL || xReplayRunning != pdFALSE)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "A replay is already running, stop it first\r\n");
+        return pdFALSE;
+    }
+
+    xRequest.pxMix = pxMix;
+    xRequest.ulRate = ulRate;
+    xRequest.ulCount = ulCount;
+    xStopRequested = pdFALSE;
+    ulProgress = 0;
+
+    memset(&xMonitor, 0, sizeof(xMonitor));
+    xMonitor.ulRun = ulRunCount;
+
+    xReplayRunning = pdTRUE;
+    xTaskNotifyGive(xReplayTask);
+
+    uxCommandConsoleJobStart("replay", prvReplayMonitorJob, &xMonitor, sizeof(xMonitor),
+                             pdMS_TO_TICKS(NET_REPLAY_REPORT_MS));
+
+    snprintf(pcWriteBuffer, xWriteBufferLen, "Replaying %s, %lu frames at %lu pkt/s%s\r\n",
+             pxMix->pcName, (unsigned long) ulCount, (unsigned long) ulRate,
+             (ulRate == 0) ? " (unpaced)" : "");
+    return pdFALSE;
+}
@@ -0,0 +1,246 @@
+/* NetStatsExport.c
+ *
+ * Text rendering of the CycloneTCP counters (NET_STATS_SUPPORT), shared by
+ * the "netstat" command and a periodic UDP export. Each datagram holds the
+ * whole report, one "name: key=value ..." line per group, so a collector can
+ * be as simple as "nc -ul <port>".
+ */
+#include "NetStatsExport.h"
+#include "task.h"
+#include "core/socket.h"
+#include "StaticAlloc.h"
+#include <stdio.h>
+#include <string.h>
+
+#if (NET_STATS_SUPPORT == ENABLED)
+
+/* Lines per interface (rx, tx, mac, offload, filter), then ipv4, ipv4-reasm, tcp, tcp-listen and udp */
+#define NET_STATS_LINES_PER_IF   5
+#define NET_STATS_PROTO_LINES    5
+
+static TaskHandle_t xExportTask = NULL;
+APP_TASK_STORAGE(xExportTask, NET_STATS_EXPORT_STACK_SIZE);
+
+/* Collector, changed by vNetStatsExportConfigure() */
+static IpAddr xExportAddr;
+static uint16_t usExportPort = 0;
+static volatile uint32_t ulExportPeriod = 0;
+
+static NetStats xExportStats;
+static char cExportBuffer[NET_STATS_EXPORT_BUFFER_SIZE];
+
+static void prvNetStatsExportTask(void *pvParameters);
+
+#endif
+
+void vNetStatsSnapshot(NetStats *pxStats)
+{
+#if (NET_STATS_SUPPORT == ENABLED)
+    uint_t i;
+
+    for (i = 0; i < NET_INTERFACE_COUNT; i++)
+    {
+        netStatsGetInterfaceStats(i, &pxStats->interfaces[i]);
+    }
+    netStatsGetProtocolStats(&pxStats->protocols);
+#else
+    memset(pxStats, 0, sizeof(*pxStats));
+#endif
+}
+
+UBaseType_t uxNetStatsLineCount(void)
+{
+#if (NET_STATS_SUPPORT == ENABLED)
+    return NET_INTERFACE_COUNT * NET_STATS_LINES_PER_IF + NET_STATS_PROTO_LINES;
+#else
+    return 0;
+#endif
+}
+
+BaseType_t xNetStatsFormatLine(const NetStats *pxStats, UBaseType_t uxLine, char *pcBuffer, size_t xLength)
+{
+#if (NET_STATS_SUPPORT == ENABLED)
+    const NetInterfaceStats *pxIf;
+    const NetProtocolStats *pxProto = &pxStats->protocols;
+    UBaseType_t uxIf;
+
+    if (uxLine < NET_INTERFACE_COUNT * NET_STATS_LINES_PER_IF)
+    {
+        uxIf = uxLine / NET_STATS_LINES_PER_IF;
+        pxIf = &pxStats->interfaces[uxIf];
+
+        if ((uxLine % NET_STATS_LINES_PER_IF) == 0)
+        {
+            snprintf(pcBuffer, xLength, "%s rx: frames=%lu octets=%lu errors=%lu missed=%lu nobuf=%lu\r\n",
+                     netInterface[uxIf].name,
+                     (unsigned long) pxIf->rxFrames, (unsigned long) pxIf->rxOctets,
+                     (unsigned long) pxIf->rxErrors, (unsigned long) pxIf->rxMissed,
+                     (unsigned long) pxIf->rxBufferUnavailable);
+        }
+        else if ((uxLine % NET_STATS_LINES_PER_IF) == 1)
+        {
+            snprintf(pcBuffer, xLength, "%s tx: frames=%lu octets=%lu drops=%lu errors=%lu\r\n",
+                     netInterface[uxIf].name,
+                     (unsigned long) pxIf->txFrames, (unsigned long) pxIf->txOctets,
+                     (unsigned long) pxIf->txDrops, (unsigned long) pxIf->txErrors);
+        }
+        else if ((uxLine % NET_STATS_LINES_PER_IF) == 2)
+        {
+            snprintf(pcBuffer, xLength, "%s mac: crc=%lu align=%lu overflow=%lu restart=%lu underflow=%lu coll=%lu buserr=%lu\r\n",
+                     netInterface[uxIf].name,
+                     (unsigned long) pxIf->rxCrcErrors, (unsigned long) pxIf->rxAlignErrors,
+                     (unsigned long) pxIf->rxFifoOverflows, (unsigned long) pxIf->rxDmaRestarts,
+                     (unsigned long) pxIf->txUnderflows, (unsigned long) pxIf->txCollisions,
+                     (unsigned long) pxIf->dmaBusErrors);
+        }
+        else if ((uxLine % NET_STATS_LINES_PER_IF) == 3)
+        {
+            snprintf(pcBuffer, xLength, "%s offload: arp=%lu echo=%lu busy=%lu\r\n",
+                     netInterface[uxIf].name,
+                     (unsigned long) pxIf->offloadArpReplies, (unsigned long) pxIf->offloadEchoReplies,
+                     (unsigned long) pxIf->offloadTxBusy);
+        }
+        else
+        {
+            snprintf(pcBuffer, xLength, "%s filter: mac=%lu mcast=%lu\r\n",
+                     netInterface[uxIf].name,
+                     (unsigned long) pxIf->rxMacFiltered, (unsigned long) pxIf->rxMcastFiltered);
+        }
+        return pdTRUE;
+    }
+
+    switch (uxLine - NET_INTERFACE_COUNT * NET_STATS_LINES_PER_IF)
+    {
+    case 0:
+        snprintf(pcBuffer, xLength, "ipv4: in=%lu hdrerr=%lu cksum=%lu deliver=%lu out=%lu\r\n",
+                 (unsigned long) pxProto->ipv4InReceives, (unsigned long) pxProto->ipv4InHdrErrors,
+                 (unsigned long) pxProto->ipv4InChecksumErrors, (unsigned long) pxProto->ipv4InDelivers,
+                 (unsigned long) pxProto->ipv4OutRequests);
+        return pdTRUE;
+    case 1:
+        snprintf(pcBuffer, xLength, "ipv4-reasm: ok=%lu timeout=%lu qfull=%lu fail=%lu\r\n",
+                 (unsigned long) pxProto->ipv4ReasmOks, (unsigned long) pxProto->ipv4ReasmTimeouts,
+                 (unsigned long) pxProto->ipv4ReasmQueueFull, (unsigned long) pxProto->ipv4ReasmFails);
+        return pdTRUE;
+    case 2:
+        snprintf(pcBuffer, xLength, "tcp: in=%lu err=%lu cksum=%lu out=%lu retrans=%lu\r\n",
+                 (unsigned long) pxProto->tcpInSegs, (unsigned long) pxProto->tcpInErrs,
+                 (unsigned long) pxProto->tcpInChecksumErrors, (unsigned long) pxProto->tcpOutSegs,
+                 (unsigned long) pxProto->tcpRetransSegs);
+        return pdTRUE;
+    case 3:
+        snprintf(pcBuffer, xLength, "tcp-listen: syn=%lu qfull=%lu cookie-sent=%lu cookie-ok=%lu cookie-bad=%lu\r\n",
+                 (unsigned long) pxProto->tcpListenSyns, (unsigned long) pxProto->tcpListenOverflows,
+                 (unsigned long) pxProto->tcpSynCookiesSent, (unsigned long) pxProto->tcpSynCookiesRecv,
+                 (unsigned long) pxProto->tcpSynCookiesFailed);
+        return pdTRUE;
+    case 4:
+        snprintf(pcBuffer, xLength, "udp: in=%lu fast=%lu shared=%lu err=%lu cksum=%lu noport=%lu qfull=%lu nobuf=%lu out=%lu\r\n",
+                 (unsigned long) pxProto->udpInDatagrams, (unsigned long) pxProto->udpInFastPath,
+                 (unsigned long) pxProto->udpInShared,
+                 (unsigned long) pxProto->udpInErrors, (unsigned long) pxProto->udpInChecksumErrors,
+                 (unsigned long) pxProto->udpNoPorts, (unsigned long) pxProto->udpQueueFullDrops,
+                 (unsigned long) pxProto->udpNoBufferDrops, (unsigned long) pxProto->udpOutDatagrams);
+        return pdTRUE;
+    default:
+        break;
+    }
+#else
+    (void) pxStats;
+    (void) uxLine;
+    (void) pcBuffer;
+    (void) xLength;
+#endif
+
+    return pdFALSE;
+}
+
+void vNetStatsExportConfigure(const IpAddr *pxAddr, uint16_t usPort, uint32_t ulPeriod)
+{
+#if (NET_STATS_SUPPORT == ENABLED)
+    /* Stop first so the task never sends to a half-updated collector */
+    ulExportPeriod = 0;
+
+    if (ulPeriod > 0 && pxAddr != NULL)
+    {
+        xExportAddr = *pxAddr;
+        usExportPort = usPort;
+        ulExportPeriod = ulPeriod;
+    }
+
+    if (xExportTask != NULL)
+    {
+        xTaskNotifyGive(xExportTask);
+    }
+#else
+    (void) pxAddr;
+    (void) usPort;
+    (void) ulPeriod;
+#endif
+}
+
+BaseType_t xNetStatsExportStart(UBaseType_t uxPriority)
+{
+#if (NET_STATS_SUPPORT == ENABLED)
+    return xAppTaskCreate(xExportTask, prvNetStatsExportTask, "NetStats", NET_STATS_EXPORT_STACK_SIZE,
+                          NULL, uxPriority, &xExportTask);
+#else
+    (void) uxPriority;
+    return pdPASS;
+#endif
+}
+
+#if (NET_STATS_SUPPORT == ENABLED)
+
+static void prvNetStatsExportTask(void *pvParameters)
+{
+    Socket *pxSocket = NULL;
+    UBaseType_t uxLine;
+    size_t xUsed;
+    uint32_t ulPeriod;
+
+    (void) pvParameters;
+
+    for (;;)
+    {
+        /* Sleep until configured, or for one period; reconfiguring wakes us up */
+        ulPeriod = ulExportPeriod;
+        if (ulTaskNotifyTake(pdTRUE, (ulPeriod > 0) ? pdMS_TO_TICKS(ulPeriod) : portMAX_DELAY) != 0)
+        {
+            continue;
+        }
+
+        if (ulExportPeriod == 0)
+        {
+            continue;
+        }
+
+        if (pxSocket == NULL)
+        {
+            pxSocket = socketOpen(SOCKET_TYPE_DGRAM, SOCKET_IP_PROTO_UDP);
+            if (pxSocket == NULL)
+            {
+                continue;
+            }
+        }
+
+        vNetStatsSnapshot(&xExportStats);
+
+        xUsed = snprintf(cExportBuffer, sizeof(cExportBuffer), "netstat uptime=%lu\r\n",
+                         (unsigned long) (xTaskGetTickCount() * portTICK_PERIOD_MS));
+        for (uxLine = 0; xUsed < sizeof(cExportBuffer); uxLine++)
+        {
+            if (xNetStatsFormatLine(&xExportStats, uxLine, cExportBuffer + xUsed,
+                                    sizeof(cExportBuffer) - xUsed) == pdFALSE)
+            {
+                break;
+            }
+            xUsed += strlen(cExportBuffer + xUsed);
+        }
+
+        socketSendTo(pxSocket, &xExportAddr, usExportPort, cExportBuffer,
+                     MIN(xUsed, sizeof(cExportBuffer) - 1), NULL, 0);
+    }
+}
+
+#endif
@@ -0,0 +1,697 @@
+/* PacketCapture.c
+ *
+ * pcapng capture server (see PacketCapture.h): compiles the filter
+ * expression into a BPF program for the tap of the stack, and turns the
+ * frames of its ring into Enhanced Packet Blocks.
+ */
+#include "PacketCapture.h"
+#include "StaticAlloc.h"
+#include "task.h"
+#include "semphr.h"
+#include "FreeRTOS_CLI.h"
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/net_capture.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if (NET_CAPTURE_SUPPORT == ENABLED)
+
+/* pcapng block types and options */
+#define PCAPNG_SHB                     0x0A0D0D0Au
+#define PCAPNG_IDB                     0x00000001u
+#define PCAPNG_EPB                     0x00000006u
+#define PCAPNG_BYTE_ORDER_MAGIC        0x1A2B3C4Du
+#define PCAPNG_LINKTYPE_ETHERNET       1u
+#define PCAPNG_OPT_END                 0u
+#define PCAPNG_OPT_IF_NAME             2u
+#define PCAPNG_OPT_EPB_FLAGS           2u
+
+/* Enhanced Packet Block without its data: header, flags option, end of
+ * options and trailing length */
+#define PCAPNG_EPB_OVERHEAD            44u
+
+/* Jump targets of the filter templates, besides instruction counts */
+#define CAPTURE_PASS                   (-1)    /* The primitive matches */
+#define CAPTURE_FAIL                   (-2)    /* It does not */
+
+/* Operand of a template instruction */
+#define CAPTURE_K                      0u      /* ulK itself */
+#define CAPTURE_ARG1                   1u
+#define CAPTURE_ARG2                   2u
+#define CAPTURE_ARG3                   3u
+
+/* Instruction of a filter template */
+typedef struct
+{
+    uint16_t usCode;
+    int8_t cJt;
+    int8_t cJf;
+    uint8_t ucArg;
+    uint32_t ulK;
+} CaptureOp_t;
+
+#define OP_LDH(k)                      { BPF_LD | BPF_H | BPF_ABS, 0, 0, CAPTURE_K, (k) }
+#define OP_LDB(k)                      { BPF_LD | BPF_B | BPF_ABS, 0, 0, CAPTURE_K, (k) }
+#define OP_LDW(k)                      { BPF_LD | BPF_W | BPF_ABS, 0, 0, CAPTURE_K, (k) }
+#define OP_LDHX(k)                     { BPF_LD | BPF_H | BPF_IND, 0, 0, CAPTURE_K, (k) }
+#define OP_LDXIHL(k)                   { BPF_LDX | BPF_B | BPF_MSH, 0, 0, CAPTURE_K, (k) }
+#define OP_JEQ(k, jt, jf)              { BPF_JMP | BPF_JEQ | BPF_K, (jt), (jf), CAPTURE_K, (k) }
+#define OP_JEQ_ARG(a, jt, jf)          { BPF_JMP | BPF_JEQ | BPF_K, (jt), (jf), (a), 0 }
+#define OP_JSET(k, jt, jf)             { BPF_JMP | BPF_JSET | BPF_K, (jt), (jf), CAPTURE_K, (k) }
+
+/* Ethernet type ARG1 */
+static const CaptureOp_t xEtherTypeOps[] =
+{
+    OP_LDH(12),
+    OP_JEQ_ARG(CAPTURE_ARG1, CAPTURE_PASS, CAPTURE_FAIL)
+};
+
+/* IPv4 protocol ARG1, or IPv6 next header ARG2 */
+static const CaptureOp_t xProtoOps[] =
+{
+    OP_LDH(12),
+    OP_JEQ(0x0800, 0, 2),
+    OP_LDB(23),
+    OP_JEQ_ARG(CAPTURE_ARG1, CAPTURE_PASS, CAPTURE_FAIL),
+    OP_JEQ(0x86DD, 0, CAPTURE_FAIL),
+    OP_LDB(20),
+    OP_JEQ_ARG(CAPTURE_ARG2, CAPTURE_PASS, CAPTURE_FAIL)
+};
+
+/* Source or destination port ARG3 of a segment of protocol ARG1 or ARG2,
+ * first IPv4 fragments only */
+static const CaptureOp_t xPortOps[] =
+{
+    OP_LDH(12),
+    OP_JEQ(0x0800, 0, 10),
+    OP_LDB(23),
+    OP_JEQ_ARG(CAPTURE_ARG1, 1, 0),
+    OP_JEQ_ARG(CAPTURE_ARG2, 0, CAPTURE_FAIL),
+    OP_LDH(20),
+    OP_JSET(0x1FFF, CAPTURE_FAIL, 0),
+    OP_LDXIHL(14),
+    OP_LDHX(14),
+    OP_JEQ_ARG(CAPTURE_ARG3, CAPTURE_PASS, 0),
+    OP_LDHX(16),
+    OP_JEQ_ARG(CAPTURE_ARG3, CAPTURE_PASS, CAPTURE_FAIL),
+    OP_JEQ(0x86DD, 0, CAPTURE_FAIL),
+    OP_LDB(20),
+    OP_JEQ_ARG(CAPTURE_ARG1, 1, 0),
+    OP_JEQ_ARG(CAPTURE_ARG2, 0, CAPTURE_FAIL),
+    OP_LDH(54),
+    OP_JEQ_ARG(CAPTURE_ARG3, CAPTURE_PASS, 0),
+    OP_LDH(56),
+    OP_JEQ_ARG(CAPTURE_ARG3, CAPTURE_PASS, CAPTURE_FAIL)
+};
+
+/* IPv4 source or destination address ARG1 */
+static const CaptureOp_t xHostOps[] =
+{
+    OP_LDH(12),
+    OP_JEQ(0x0800, 0, CAPTURE_FAIL),
+    OP_LDW(26),
+    OP_JEQ_ARG(CAPTURE_ARG1, CAPTURE_PASS, 0),
+    OP_LDW(30),
+    OP_JEQ_ARG(CAPTURE_ARG1, CAPTURE_PASS, CAPTURE_FAIL)
+};
+
+/* Program being assembled; targets are absolute, -1 for the rejection */
+typedef struct
+{
+    NetCaptureInsn xInsn[NET_CAPTURE_MAX_INSNS];
+    int16_t sJt[NET_CAPTURE_MAX_INSNS];
+    int16_t sJf[NET_CAPTURE_MAX_INSNS];
+    uint_t uxLength;
+} CaptureProgram_t;
+
+APP_TASK_STORAGE(xCaptureTask, PACKET_CAPTURE_STACK_SIZE);
+APP_MUTEX_STORAGE(xCaptureMutex);
+
+/* Filter, changed by the CLI, taken by the task at each connection */
+static SemaphoreHandle_t xFilterMutex = NULL;
+static char cFilter[PACKET_CAPTURE_FILTER_SIZE];
+static uint32_t ulSnapLen = NET_CAPTURE_MAX_SNAP_LEN;
+static CaptureProgram_t xProgram;
+
+static volatile BaseType_t xStreaming = pdFALSE;
+static uint32_t ulSessions = 0;
+static uint32_t ulBlocksSent = 0;
+
+static uint8_t ucTxBuffer[PACKET_CAPTURE_TX_SIZE] __ALIGNED(4);
+static size_t xTxUsed;
+
+static BaseType_t prvCaptureCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xCapture =
+{
+    "capture",
+    "\r\ncapture [filter <expression> | snaplen <bytes>]:\r\n Packet capture state, filter and snaplen\r\n",
+    prvCaptureCommand,
+    -1
+};
+
+/* Append one template, PASS leading to the instruction after it */
+static BaseType_t prvEmit(CaptureProgram_t *pxProgram, const CaptureOp_t *pxOps, size_t xCount,
+                          BaseType_t xNegate, const uint32_t *pulArgs)
+{
+    size_t i;
+    uint_t uxIndex;
+    uint_t uxEnd = pxProgram->uxLength + xCount;
+    int8_t cTarget[2];
+    int16_t sTarget[2];
+    size_t j;
+
+    /* Keep room for the two return instructions */
+    if (uxEnd + 2u > NET_CAPTURE_MAX_INSNS)
+    {
+        return pdFAIL;
+    }
+
+    for (i = 0; i < xCount; i++)
+    {
+        uxIndex = pxProgram->uxLength++;
+        pxProgram->xInsn[uxIndex].code = pxOps[i].usCode;
+        pxProgram->xInsn[uxIndex].jt = 0;
+        pxProgram->xInsn[uxIndex].jf = 0;
+        pxProgram->xInsn[uxIndex].k = (pxOps[i].ucArg == CAPTURE_K) ? pxOps[i].ulK : pulArgs[pxOps[i].ucArg - 1u];
+
+        cTarget[0] = pxOps[i].cJt;
+        cTarget[1] = pxOps[i].cJf;
+        for (j = 0; j < 2u; j++)
+        {
+            if (cTarget[j] >= 0)
+            {
+                sTarget[j] = (int16_t) (uxIndex + 1u + (uint_t) cTarget[j]);
+            }
+            else if ((cTarget[j] == CAPTURE_PASS) != (xNegate != pdFALSE))
+            {
+                sTarget[j] = (int16_t) uxEnd;
+            }
+            else
+            {
+                sTarget[j] = -1;
+            }
+        }
+        pxProgram->sJt[uxIndex] = sTarget[0];
+        pxProgram->sJf[uxIndex] = sTarget[1];
+    }
+
+    return pdPASS;
+}
+
+/* The two return instructions, then the jumps made relative */
+static void prvFinish(CaptureProgram_t *pxProgram, uint32_t ulSnap)
+{
+    uint_t i;
+    uint_t uxReject;
+    int16_t sJt;
+    int16_t sJf;
+
+    pxProgram->xInsn[pxProgram->uxLength] = (NetCaptureInsn) BPF_STMT(BPF_RET | BPF_K, ulSnap);
+    pxProgram->uxLength++;
+    uxReject = pxProgram->uxLength;
+    pxProgram->xInsn[pxProgram->uxLength] = (NetCaptureInsn) BPF_STMT(BPF_RET | BPF_K, 0);
+    pxProgram->uxLength++;
+
+    for (i = 0; i < uxReject - 1u; i++)
+    {
+        if ((pxProgram->xInsn[i].code & 0x07u) != BPF_JMP)
+        {
+            continue;
+        }
+        sJt = (pxProgram->sJt[i] < 0) ? (int16_t) uxReject : pxProgram->sJt[i];
+        sJf = (pxProgram->sJf[i] < 0) ? (int16_t) uxReject : pxProgram->sJf[i];
+        pxProgram->xInsn[i].jt = (uint8_t) (sJt - (int16_t) (i + 1u));
+        pxProgram->xInsn[i].jf = (uint8_t) (sJf - (int16_t) (i + 1u));
+    }
+}
+
+static BaseType_t prvTokenIs(const char *pcToken, size_t xLength, const char *pcWord)
+{
+    return (strlen(pcWord) == xLength && strncmp(pcToken, pcWord, xLength) == 0) ? pdTRUE : pdFALSE;
+}
+
+/* Next token of the expression, NULL at its end */
+static const char *prvNextToken(const char **ppcCursor, size_t *pxLength)
+{
+    const char *pcStart = *ppcCursor;
+    const char *pcEnd;
+
+    while (*pcStart == ' ')
+    {
+        pcStart++;
+    }
+    if (*pcStart == '\0')
+    {
+        return NULL;
+    }
+
+    pcEnd = pcStart;
+    while (*pcEnd != ' ' && *pcEnd != '\0')
+    {
+        pcEnd++;
+    }
+
+    *pxLength = (size_t) (pcEnd - pcStart);
+    *ppcCursor = pcEnd;
+
+    return pcStart;
+}
+
+/* The capture connection is left out, then every primitive must match */
+static BaseType_t prvCompile(const char *pcFilter, uint32_t ulSnap, CaptureProgram_t *pxProgram)
+{
+    const char *pcCursor = pcFilter;
+    const char *pcToken;
+    size_t xLength;
+    BaseType_t xNegate;
+    uint32_t ulArgs[3];
+    char cWord[16];
+    char *pcEnd;
+    Ipv4Addr xAddr;
+
+    pxProgram->uxLength = 0;
+
+    ulArgs[0] = 6u;
+    ulArgs[1] = 6u;
+    ulArgs[2] = PACKET_CAPTURE_PORT;
+    (void) prvEmit(pxProgram, xPortOps, arraysize(xPortOps), pdTRUE, ulArgs);
+
+    while ((pcToken = prvNextToken(&pcCursor, &xLength)) != NULL)
+    {
+        xNegate = pdFALSE;
+        if (prvTokenIs(pcToken, xLength, "not"))
+        {
+            xNegate = pdTRUE;
+            pcToken = prvNextToken(&pcCursor, &xLength);
+            if (pcToken == NULL)
+            {
+                return pdFAIL;
+            }
+        }
+
+        /* "tcp port" and "udp port" are one primitive */
+        if (prvTokenIs(pcToken, xLength, "tcp") || prvTokenIs(pcToken, xLength, "udp"))
+        {
+            ulArgs[0] = (pcToken[0] == 't') ? 6u : 17u;
+            ulArgs[1] = ulArgs[0];
+
+            const char *pcSaved = pcCursor;
+            size_t xNextLength;
+            const char *pcNext = prvNextToken(&pcCursor, &xNextLength);
+
+            if (pcNext == NULL || !prvTokenIs(pcNext, xNextLength, "port"))
+            {
+                pcCursor = pcSaved;
+                if (prvEmit(pxProgram, xProtoOps, arraysize(xProtoOps), xNegate, ulArgs) != pdPASS)
+                {
+                    return pdFAIL;
+                }
+                continue;
+            }
+            pcToken = pcNext;
+            xLength = xNextLength;
+        }
+        else if (prvTokenIs(pcToken, xLength, "port"))
+        {
+            ulArgs[0] = 6u;
+            ulArgs[1] = 17u;
+        }
+
+        if (prvTokenIs(pcToken, xLength, "port") || prvTokenIs(pcToken, xLength, "host"))
+        {
+            BaseType_t xPort = (pcToken[0] == 'p') ? pdTRUE : pdFALSE;
+
+            pcToken = prvNextToken(&pcCursor, &xLength);
+            if (pcToken == NULL || xLength >= sizeof(cWord))
+            {
+                return pdFAIL;
+            }
+            memcpy(cWord, pcToken, xLength);
+            cWord[xLength] = '\0';
+
+            if (xPort != pdFALSE)
+            {
+                ulArgs[2] = strtoul(cWord, &pcEnd, 10);
+                if (*pcEnd != '\0' || ulArgs[2] > 65535u)
+                {
+                    return pdFAIL;
+                }
+                if (prvEmit(pxProgram, xPortOps, arraysize(xPortOps), xNegate, ulArgs) != pdPASS)
+                {
+                    return pdFAIL;
+                }
+            }
+            else
+            {
+                if (ipv4StringToAddr(cWord, &xAddr) != NO_ERROR)
+                {
+                    return pdFAIL;
+                }
+                ulArgs[0] = ntohl(xAddr);
+                if (prvEmit(pxProgram, xHostOps, arraysize(xHostOps), xNegate, ulArgs) != pdPASS)
+                {
+                    return pdFAIL;
+                }
+            }
+        }
+        else if (prvTokenIs(pcToken, xLength, "icmp"))
+        {
+            ulArgs[0] = 1u;
+            ulArgs[1] = 58u;
+            if (prvEmit(pxProgram, xProtoOps, arraysize(xProtoOps), xNegate, ulArgs) != pdPASS)
+            {
+                return pdFAIL;
+            }
+        }
+        else
+        {
+            if (prvTokenIs(pcToken, xLength, "ip"))
+            {
+                ulArgs[0] = 0x0800u;
+            }
+            else if (prvTokenIs(pcToken, xLength, "ip6"))
+            {
+                ulArgs[0] = 0x86DDu;
+            }
+            else if (prvTokenIs(pcToken, xLength, "arp"))
+            {
+                ulArgs[0] = 0x0806u;
+            }
+            else
+            {
+                return pdFAIL;
+            }
+            if (prvEmit(pxProgram, xEtherTypeOps, arraysize(xEtherTypeOps), xNegate, ulArgs) != pdPASS)
+            {
+                return pdFAIL;
+            }
+        }
+    }
+
+    prvFinish(pxProgram, ulSnap);
+
+    return (netCaptureCheckFilter(pxProgram->xInsn, pxProgram->uxLength) == NO_ERROR) ? pdPASS : pdFAIL;
+}
+
+static void prvPut32(uint32_t ulValue)
+{
+    memcpy(&ucTxBuffer[xTxUsed], &ulValue, 4u);
+    xTxUsed += 4u;
+}
+
+static void prvPut16(uint16_t usValue)
+{
+    memcpy(&ucTxBuffer[xTxUsed], &usValue, 2u);
+    xTxUsed += 2u;
+}
+
+/* Section Header Block, then one Interface Description Block per interface,
+ * their index being the interface ID of the packets */
+static void prvPutHeader(void)
+{
+    uint_t i;
+    size_t xName;
+    size_t xPadded;
+    uint32_t ulTotal;
+
+    xTxUsed = 0;
+
+    prvPut32(PCAPNG_SHB);
+    prvPut32(28u);
+    prvPut32(PCAPNG_BYTE_ORDER_MAGIC);
+    prvPut16(1u);
+    prvPut16(0u);
+    prvPut32(0xFFFFFFFFu);          /* Section length not given */
+    prvPut32(0xFFFFFFFFu);
+    prvPut32(28u);
+
+    for (i = 0; i < NET_INTERFACE_COUNT; i++)
+    {
+        xName = strlen(netInterface[i].name);
+        xPadded = (xName + 3u) & ~3u;
+        ulTotal = 20u + 4u + (uint32_t) xPadded + 4u + 4u;
+
+        prvPut32(PCAPNG_IDB);
+        prvPut32(ulTotal);
+        prvPut16(PCAPNG_LINKTYPE_ETHERNET);
+        prvPut16(0u);
+        prvPut32(NET_CAPTURE_MAX_SNAP_LEN);
+        prvPut16(PCAPNG_OPT_IF_NAME);
+        prvPut16((uint16_t) xName);
+        memset(&ucTxBuffer[xTxUsed], 0, xPadded);
+        memcpy(&ucTxBuffer[xTxUsed], netInterface[i].name, xName);
+        xTxUsed += xPadded;
+        prvPut32(PCAPNG_OPT_END);
+        prvPut32(ulTotal);
+    }
+}
+
+/* Enhanced Packet Block, with the direction of the frame in epb_flags */
+static void prvPutPacket(const NetCaptureRecord *pxRecord)
+{
+    size_t xPadded = (pxRecord->capLength + 3u) & ~3u;
+    uint32_t ulTotal = PCAPNG_EPB_OVERHEAD + (uint32_t) xPadded;
+
+    prvPut32(PCAPNG_EPB);
+    prvPut32(ulTotal);
+    prvPut32(pxRecord->interfaceIndex);
+    prvPut32((uint32_t) (pxRecord->timestamp >> 32));
+    prvPut32((uint32_t) pxRecord->timestamp);
+    prvPut32(pxRecord->capLength);
+    prvPut32(pxRecord->length);
+    memcpy(&ucTxBuffer[xTxUsed], pxRecord->data, pxRecord->capLength);
+    memset(&ucTxBuffer[xTxUsed + pxRecord->capLength], 0, xPadded - pxRecord->capLength);
+    xTxUsed += xPadded;
+    prvPut16(PCAPNG_OPT_EPB_FLAGS);
+    prvPut16(4u);
+    prvPut32((pxRecord->direction == NET_CAPTURE_DIR_RX) ? 1u : 2u);
+    prvPut32(PCAPNG_OPT_END);
+    prvPut32(ulTotal);
+}
+
+static error_t prvFlush(Socket *pxClient)
+{
+    error_t err = NO_ERROR;
+
+    if (xTxUsed > 0)
+    {
+        err = socketSend(pxClient, ucTxBuffer, xTxUsed, NULL, 0);
+        xTxUsed = 0;
+    }
+
+    return err;
+}
+
+static void prvServeClient(Socket *pxClient)
+{
+    const NetCaptureRecord *pxRecord;
+    uint8_t ucDiscard[16];
+    size_t xReceived;
+    error_t err;
+
+    socketSetTimeout(pxClient, PACKET_CAPTURE_TIMEOUT_MS);
+
+    xSemaphoreTake(xFilterMutex, portMAX_DELAY);
+    err = netCaptureStart(xProgram.xInsn, xProgram.uxLength);
+    xSemaphoreGive(xFilterMutex);
+    if (err != NO_ERROR)
+    {
+        return;
+    }
+
+    ulSessions++;
+    xStreaming = pdTRUE;
+
+    prvPutHeader();
+    err = prvFlush(pxClient);
+
+    while (err == NO_ERROR)
+    {
+        if (netCaptureWait(pdMS_TO_TICKS(PACKET_CAPTURE_FLUSH_MS)) == FALSE)
+        {
+            /* Nothing captured: only look for the client leaving */
+            err = socketReceive(pxClient, ucDiscard, sizeof(ucDiscard), &xReceived, SOCKET_FLAG_DONT_WAIT);
+            if (err == ERROR_TIMEOUT || err == ERROR_WOULD_BLOCK)
+            {
+                err = NO_ERROR;
+            }
+            continue;
+        }
+
+        while ((pxRecord = netCapturePeek()) != NULL &&
+               xTxUsed + PCAPNG_EPB_OVERHEAD + pxRecord->capLength + 3u <= sizeof(ucTxBuffer))
+        {
+            prvPutPacket(pxRecord);
+            netCaptureRelease();
+            ulBlocksSent++;
+        }
+
+        err = prvFlush(pxClient);
+    }
+
+    netCaptureStop();
+    xStreaming = pdFALSE;
+
+    /* What the client did not take is lost */
+    while (netCapturePeek() != NULL)
+    {
+        netCaptureRelease();
+    }
+}
+
+static void prvCaptureTask(void *pvParameters)
+{
+    Socket *pxListener;
+    Socket *pxClient;
+
+    (void) pvParameters;
+
+    pxListener = socketOpen(SOCKET_TYPE_STREAM, SOCKET_IP_PROTO_TCP);
+    if (pxListener == NULL)
+    {
+        vTaskDelete(NULL);
+        return;
+    }
+
+    socketBind(pxListener, &IP_ADDR_ANY, PACKET_CAPTURE_PORT);
+    socketListen(pxListener, 1);
+
+    for (;;)
+    {
+        pxClient = socketAccept(pxListener, NULL, NULL);
+        if (pxClient == NULL)
+        {
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+
+        prvServeClient(pxClient);
+        socketClose(pxClient);
+    }
+}
+
+static BaseType_t prvCaptureCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    const char *pcParameter;
+    BaseType_t xLength;
+    NetCaptureStats xStats;
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xLength);
+    if (pcParameter != NULL && xLength == 6 && strncmp(pcParameter, "filter", 6) == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xLength);
+        if (xPacketCaptureSetFilter((pcParameter != NULL) ? pcParameter : "") != pdPASS)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid or too long filter\r\n");
+            return pdFALSE;
+        }
+    }
+    else if (pcParameter != NULL && xLength == 7 && strncmp(pcParameter, "snaplen", 7) == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xLength);
+        if (pcParameter == NULL)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: capture snaplen <bytes>\r\n");
+            return pdFALSE;
+        }
+        vPacketCaptureSetSnapLen(strtoul(pcParameter, NULL, 10));
+    }
+    else if (pcParameter != NULL)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: capture [filter <expression> | snaplen <bytes>]\r\n");
+        return pdFALSE;
+    }
+
+    netCaptureGetStats(&xStats);
+    snprintf(pcWriteBuffer, xWriteBufferLen,
+             "capture: %s, port %u, filter \"%s\", snaplen %lu, %u insns\r\n"
+             "seen %lu captured %lu dropped %lu sent %lu sessions %lu\r\n",
+             (xStreaming != pdFALSE) ? "streaming" : "idle", (unsigned) PACKET_CAPTURE_PORT, cFilter,
+             (unsigned long) ulSnapLen, (unsigned) xProgram.uxLength,
+             (unsigned long) xStats.seen, (unsigned long) xStats.captured, (unsigned long) xStats.dropped,
+             (unsigned long) ulBlocksSent, (unsigned long) ulSessions);
+
+    return pdFALSE;
+}
+
+#endif
+
+BaseType_t xPacketCaptureSetFilter(const char *pcFilter)
+{
+#if (NET_CAPTURE_SUPPORT == ENABLED)
+    static CaptureProgram_t xCompiled;
+    BaseType_t xResult = pdFAIL;
+
+    if (xFilterMutex == NULL || strlen(pcFilter) >= sizeof(cFilter))
+    {
+        return pdFAIL;
+    }
+
+    xSemaphoreTake(xFilterMutex, portMAX_DELAY);
+    if (prvCompile(pcFilter, ulSnapLen, &xCompiled) == pdPASS)
+    {
+        xProgram = xCompiled;
+        strcpy(cFilter, pcFilter);
+        if (xStreaming != pdFALSE)
+        {
+            (void) netCaptureSetFilter(xProgram.xInsn, xProgram.uxLength);
+        }
+        xResult = pdPASS;
+    }
+    xSemaphoreGive(xFilterMutex);
+
+    return xResult;
+#else
+    (void) pcFilter;
+    return pdFAIL;
+#endif
+}
+
+void vPacketCaptureSetSnapLen(uint32_t ulSnap)
+{
+#if (NET_CAPTURE_SUPPORT == ENABLED)
+    char cCurrent[PACKET_CAPTURE_FILTER_SIZE];
+
+    ulSnapLen = (ulSnap == 0 || ulSnap > NET_CAPTURE_MAX_SNAP_LEN) ? NET_CAPTURE_MAX_SNAP_LEN : ulSnap;
+
+    /* The snaplen is the value returned by the program */
+    strcpy(cCurrent, cFilter);
+    (void) xPacketCaptureSetFilter(cCurrent);
+#else
+    (void) ulSnap;
+#endif
+}
+
+BaseType_t xPacketCaptureStart(UBaseType_t uxPriority)
+{
+#if (NET_CAPTURE_SUPPORT == ENABLED)
+    xFilterMutex = xAppSemaphoreCreateMutex(xCaptureMutex);
+    if (xFilterMutex == NULL)
+    {
+        return pdFAIL;
+    }
+
+    /* Every frame but those of the capture connection */
+    cFilter[0] = '\0';
+    if (xPacketCaptureSetFilter("") != pdPASS)
+    {
+        return pdFAIL;
+    }
+
+    return xAppTaskCreate(xCaptureTask, prvCaptureTask, "Capture", PACKET_CAPTURE_STACK_SIZE,
+                          NULL, uxPriority, NULL);
+#else
+    (void) uxPriority;
+    return pdPASS;
+#endif
+}
+
+void vPacketCaptureRegisterCLICommands(void)
+{
+#if (NET_CAPTURE_SUPPORT == ENABLED)
+    FreeRTOS_CLIRegisterCommand(&xCapture);
+#endif
+}
@@ -0,0 +1,70 @@
+/* PhyInterrupt.c
+ *
+ * nINT of the LAN8742 on an EXTI line (see PhyInterrupt.h). The line
+ * triggers on the falling edge: nINT stays low until the interrupt source
+ * register is read, so events latched while the TCP/IP task handles the
+ * previous one are merged into it, and the next edge comes after the read.
+ * An event pending before the line is enabled is not lost either, since
+ * lan8742Init() forces a first PHY event at start-up.
+ */
+#include "PhyInterrupt.h"
+#include "stm32h7xx_hal.h"
+
+static error_t prvPhyIntInit(void);
+static void prvPhyIntEnableIrq(void);
+static void prvPhyIntDisableIrq(void);
+
+const ExtIntDriver xPhyExtIntDriver =
+{
+    prvPhyIntInit,
+    prvPhyIntEnableIrq,
+    prvPhyIntDisableIrq
+};
+
+/* Called from lan8742Init(); the line stays masked in the NVIC until the
+ * TCP/IP task enables the interrupts of the interface */
+static error_t prvPhyIntInit(void)
+{
+    GPIO_InitTypeDef xGpio = {0};
+
+    PHY_INT_GPIO_CLK_ENABLE();
+
+    xGpio.Pin = PHY_INT_GPIO_PIN;
+    xGpio.Mode = GPIO_MODE_IT_FALLING;
+    xGpio.Pull = GPIO_PULLUP;
+    xGpio.Speed = GPIO_SPEED_FREQ_LOW;
+    HAL_GPIO_Init(PHY_INT_GPIO_PORT, &xGpio);
+
+    __HAL_GPIO_EXTI_CLEAR_IT(PHY_INT_GPIO_PIN);
+    HAL_NVIC_SetPriority(PHY_INT_IRQn, PHY_INT_IRQ_PRIORITY, 0);
+
+    return NO_ERROR;
+}
+
+static void prvPhyIntEnableIrq(void)
+{
+    HAL_NVIC_EnableIRQ(PHY_INT_IRQn);
+}
+
+static void prvPhyIntDisableIrq(void)
+{
+    HAL_NVIC_DisableIRQ(PHY_INT_IRQn);
+}
+
+/* nINT fell: flag a PHY event of the Ethernet interface to the TCP/IP task */
+void PHY_INT_IRQHandler(void)
+{
+    bool_t flag = FALSE;
+
+    osEnterIsr();
+
+    if (__HAL_GPIO_EXTI_GET_IT(PHY_INT_GPIO_PIN) != 0)
+    {
+        __HAL_GPIO_EXTI_CLEAR_IT(PHY_INT_GPIO_PIN);
+
+        netInterface[0].phyEvent = TRUE;
+        flag = osSetEventFromIsr(&netEvent);
+    }
+
+    osExitIsr(flag);
+}
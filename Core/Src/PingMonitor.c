@@ -0,0 +1,652 @@
+/* PingMonitor.c
+ *
+ * Probe scheduling, reply matching and statistics of the ping monitor (see
+ * PingMonitor.h). The targets, the probe table and the counters are guarded
+ * by netMutex: the Echo Reply callback runs with it held, in the network
+ * task, and the monitor task takes it to send a probe and register it in
+ * the same step, so that no reply can come before its probe is known.
+ *
+ * Sequence numbers are issued in order, so the outstanding probes are
+ * ordered by send time from usOldest to usNextSeq: the timeouts are found
+ * from the oldest forward, without scanning the table.
+ */
+#include "PingMonitor.h"
+#include "StaticAlloc.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "MonoClock.h"
+#include "MqttClient.h"
+#include "core/net.h"
+#include "ipv4/icmp.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PING_PROBE_MASK                (PING_MONITOR_MAX_PROBES - 1u)
+
+#define PING_NO_TARGET                 0xFFu
+
+typedef enum
+{
+    eProbeFree = 0,
+    eProbeOutstanding,
+    eProbeExpired                       /* Counted lost, a reply is late */
+} PingProbeState_t;
+
+typedef struct
+{
+    uint16_t usSeq;
+    uint8_t ucTarget;
+    uint8_t ucState;
+    uint32_t ulSentUs;                  /* Low bits of the monotonic clock */
+} PingProbe_t;
+
+typedef struct
+{
+    BaseType_t xUsed;
+    Ipv4Addr ulAddr;
+    uint32_t ulPeriodMs;
+    uint64_t ullDueUs;
+    BaseType_t xHaveRtt;                /* ulLastUs holds a previous RTT */
+    uint32_t ulJitter16;                /* Jitter in sixteenths of a microsecond */
+    PingMonitorStats_t xStats;
+} PingTarget_t;
+
+/* Guarded by netMutex */
+static PingTarget_t xTargets[PING_MONITOR_MAX_TARGETS];
+static PingProbe_t xProbes[PING_MONITOR_MAX_PROBES];
+static uint16_t usIdentifier = 0;
+static uint16_t usNextSeq = 0;
+static uint16_t usOldest = 0;
+static uint32_t ulEvicted = 0;
+static uint32_t ulUnmatched = 0;
+
+static const uint8_t ucPayload[PING_MONITOR_PAYLOAD_SIZE] =
+{
+    'p', 'i', 'n', 'g', 'm', 'o', 'n'
+};
+
+static TaskHandle_t xPingMonitorTask = NULL;
+APP_TASK_STORAGE(xPingMonitorTask, PING_MONITOR_TASK_STACK_SIZE);
+
+/* Copy of the target table made under netMutex, which the ping replies
+ * update from the stack task; the report walks it one target per line */
+static PingTarget_t xReport[PING_MONITOR_MAX_TARGETS];
+static uint32_t ulReportEvicted = 0;
+static uint32_t ulReportUnmatched = 0;
+static UBaseType_t uxReportTarget = 0;
+static UBaseType_t uxPingMonLine = 0;
+static BaseType_t xReportHist = pdFALSE;
+
+static BaseType_t prvPingMonitorCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xPingMon =
+{
+    "pingmon",
+    "\r\npingmon [add <ip> <period-ms> | del <n> | hist <n> | reset]:\r\n"
+    " Ping monitor targets, loss, RTT and jitter, histogram\r\n",
+    prvPingMonitorCommand,
+    -1
+};
+
+static UBaseType_t prvBucket(uint32_t ulUs)
+{
+    uint32_t ulUnits = ulUs >> 6;
+    UBaseType_t uxBucket;
+
+    uxBucket = (ulUnits < 2u) ? 0u : (UBaseType_t) (31u - (uint32_t) __builtin_clz(ulUnits));
+    return (uxBucket < PING_MONITOR_HIST_BUCKETS) ? uxBucket : PING_MONITOR_HIST_BUCKETS - 1u;
+}
+
+static void prvRecordRtt(PingTarget_t *pxTarget, uint32_t ulRttUs)
+{
+    PingMonitorStats_t *pxStats = &pxTarget->xStats;
+    uint32_t ulDelta;
+
+    /* RFC 3550, 6.4.1: J += (|D| - J) / 16, D the change of the RTT */
+    if (pxTarget->xHaveRtt != pdFALSE)
+    {
+        ulDelta = (ulRttUs > pxStats->ulLastUs) ? ulRttUs - pxStats->ulLastUs : pxStats->ulLastUs - ulRttUs;
+        pxTarget->ulJitter16 += ulDelta - ((pxTarget->ulJitter16 + 8u) >> 4);
+        pxStats->ulJitterUs = pxTarget->ulJitter16 >> 4;
+    }
+    pxTarget->xHaveRtt = pdTRUE;
+
+    if (pxStats->ulReceived == 0 || ulRttUs < pxStats->ulMinUs)
+    {
+        pxStats->ulMinUs = ulRttUs;
+    }
+    if (ulRttUs > pxStats->ulMaxUs)
+    {
+        pxStats->ulMaxUs = ulRttUs;
+    }
+    pxStats->ulLastUs = ulRttUs;
+    pxStats->ullSumUs += ulRttUs;
+    pxStats->ulReceived++;
+    pxStats->ulHist[prvBucket(ulRttUs)]++;
+}
+
+/* Called by the stack with netMutex held, for every Echo Reply */
+static void prvEchoReply(NetInterface *interface, Ipv4Addr srcIpAddr, uint16_t identifier,
+                         uint16_t sequenceNumber, void *param)
+{
+    PingProbe_t *pxProbe = &xProbes[sequenceNumber & PING_PROBE_MASK];
+    PingTarget_t *pxTarget;
+    uint32_t ulNowUs = (uint32_t) ullMonoClockNowUs();
+
+    (void) interface;
+    (void) param;
+
+    /* Replies to the ping command and to other hosts */
+    if (identifier != usIdentifier)
+    {
+        return;
+    }
+
+    if (pxProbe->usSeq != sequenceNumber || pxProbe->ucState == (uint8_t) eProbeFree ||
+        xTargets[pxProbe->ucTarget].ulAddr != srcIpAddr)
+    {
+        ulUnmatched++;
+        return;
+    }
+
+    pxTarget = &xTargets[pxProbe->ucTarget];
+    if (pxProbe->ucState == (uint8_t) eProbeExpired)
+    {
+        pxTarget->xStats.ulLate++;
+    }
+    else
+    {
+        prvRecordRtt(pxTarget, ulNowUs - pxProbe->ulSentUs);
+    }
+    pxProbe->ucState = (uint8_t) eProbeFree;
+}
+
+/* Probes past their timeout are lost; with netMutex held */
+static void prvExpire(uint32_t ulNowUs)
+{
+    PingProbe_t *pxProbe;
+
+    while (usOldest != usNextSeq)
+    {
+        pxProbe = &xProbes[usOldest & PING_PROBE_MASK];
+        if (pxProbe->ucState == (uint8_t) eProbeOutstanding)
+        {
+            if (ulNowUs - pxProbe->ulSentUs < PING_MONITOR_TIMEOUT_MS * 1000u)
+            {
+                break;
+            }
+            xTargets[pxProbe->ucTarget].xStats.ulLost++;
+            pxProbe->ucState = (uint8_t) eProbeExpired;
+        }
+        usOldest++;
+    }
+}
+
+/* Send one probe to a target; with netMutex held */
+static void prvSendProbe(uint8_t ucTarget)
+{
+    PingTarget_t *pxTarget = &xTargets[ucTarget];
+    PingProbe_t *pxProbe;
+
+    /* Table full: the oldest probe is given up before its timeout */
+    if ((uint16_t) (usNextSeq - usOldest) >= PING_MONITOR_MAX_PROBES)
+    {
+        pxProbe = &xProbes[usOldest & PING_PROBE_MASK];
+        if (pxProbe->ucState == (uint8_t) eProbeOutstanding)
+        {
+            xTargets[pxProbe->ucTarget].xStats.ulLost++;
+            ulEvicted++;
+        }
+        usOldest++;
+    }
+
+    pxProbe = &xProbes[usNextSeq & PING_PROBE_MASK];
+    pxProbe->usSeq = usNextSeq;
+    pxProbe->ucTarget = ucTarget;
+    pxProbe->ulSentUs = (uint32_t) ullMonoClockNowUs();
+
+    if (icmpSendEchoRequest(NULL, pxTarget->ulAddr, usIdentifier, usNextSeq, ucPayload, sizeof(ucPayload)) != NO_ERROR)
+    {
+        pxTarget->xStats.ulSendErrors++;
+        pxProbe->ucState = (uint8_t) eProbeFree;
+    }
+    else
+    {
+        pxTarget->xStats.ulSent++;
+        pxProbe->ucState = (uint8_t) eProbeOutstanding;
+    }
+    usNextSeq++;
+}
+
+/* Send the probes due, and return the next time there is work */
+static uint64_t prvRun(void)
+{
+    PingTarget_t *pxTarget;
+    uint64_t ullNowUs = ullMonoClockNowUs();
+    uint64_t ullWakeUs = UINT64_MAX;
+    int32_t lLeftUs;
+    UBaseType_t i;
+
+    osAcquireMutex(&netMutex);
+
+    prvExpire((uint32_t) ullNowUs);
+
+    for (i = 0; i < PING_MONITOR_MAX_TARGETS; i++)
+    {
+        pxTarget = &xTargets[i];
+        if (pxTarget->xUsed == pdFALSE)
+        {
+            continue;
+        }
+
+        if (pxTarget->ullDueUs <= ullNowUs)
+        {
+            prvSendProbe((uint8_t) i);
+
+            /* Keep the cadence, unless more than a period behind */
+            pxTarget->ullDueUs += (uint64_t) pxTarget->ulPeriodMs * 1000u;
+            if (pxTarget->ullDueUs <= ullNowUs)
+            {
+                pxTarget->ullDueUs = ullNowUs + (uint64_t) pxTarget->ulPeriodMs * 1000u;
+            }
+        }
+
+        if (pxTarget->ullDueUs < ullWakeUs)
+        {
+            ullWakeUs = pxTarget->ullDueUs;
+        }
+    }
+
+    /* Timeout of the oldest probe, which may have been sent just now */
+    if (usOldest != usNextSeq)
+    {
+        lLeftUs = (int32_t) (xProbes[usOldest & PING_PROBE_MASK].ulSentUs + PING_MONITOR_TIMEOUT_MS * 1000u -
+                             (uint32_t) ullNowUs);
+        ullWakeUs = MIN(ullWakeUs, ullNowUs + (uint64_t) MAX(lLeftUs, 0));
+    }
+
+    osReleaseMutex(&netMutex);
+
+    return ullWakeUs;
+}
+
+#if (PING_MONITOR_PUBLISH_S > 0)
+static void prvPublish(void)
+{
+    PingMonitorStats_t xStats;
+    char cTopic[sizeof(PING_MONITOR_TOPIC) + 16];
+    char cPayload[160];
+    Ipv4Addr ulAddr;
+    BaseType_t xUsed;
+    int lLength;
+    UBaseType_t i;
+
+    if (xMqttClientIsConnected() == pdFALSE)
+    {
+        return;
+    }
+
+    for (i = 0; i < PING_MONITOR_MAX_TARGETS; i++)
+    {
+        osAcquireMutex(&netMutex);
+        xUsed = xTargets[i].xUsed;
+        ulAddr = xTargets[i].ulAddr;
+        xStats = xTargets[i].xStats;
+        osReleaseMutex(&netMutex);
+
+        if (xUsed == pdFALSE || xStats.ulSent == 0)
+        {
+            continue;
+        }
+
+        snprintf(cTopic, sizeof(cTopic), PING_MONITOR_TOPIC "%s", ipv4AddrToString(ulAddr, NULL));
+        lLength = snprintf(cPayload, sizeof(cPayload),
+                           "{\"sent\":%lu,\"recv\":%lu,\"lost\":%lu,\"late\":%lu,"
+                           "\"min_us\":%lu,\"avg_us\":%lu,\"max_us\":%lu,\"jitter_us\":%lu}",
+                           (unsigned long) xStats.ulSent, (unsigned long) xStats.ulReceived,
+                           (unsigned long) xStats.ulLost, (unsigned long) xStats.ulLate,
+                           (unsigned long) xStats.ulMinUs,
+                           (unsigned long) ((xStats.ulReceived > 0) ? xStats.ullSumUs / xStats.ulReceived : 0),
+                           (unsigned long) xStats.ulMaxUs, (unsigned long) xStats.ulJitterUs);
+        if (lLength > 0 && (size_t) lLength < sizeof(cPayload))
+        {
+            (void) xMqttClientPublish(cTopic, cPayload, (size_t) lLength, 0, 0);
+        }
+    }
+}
+#endif
+
+static void prvPingMonitorTask(void *pvParameters)
+{
+    uint64_t ullWakeUs;
+    uint64_t ullNowUs;
+    uint64_t ullPublishUs;
+    TickType_t xWait;
+
+    (void) pvParameters;
+
+    ullPublishUs = ullMonoClockNowUs() + (uint64_t) PING_MONITOR_PUBLISH_S * 1000000u;
+
+    for (;;)
+    {
+        ullWakeUs = prvRun();
+
+        ullNowUs = ullMonoClockNowUs();
+#if (PING_MONITOR_PUBLISH_S > 0)
+        if (ullNowUs >= ullPublishUs)
+        {
+            prvPublish();
+            ullPublishUs += (uint64_t) PING_MONITOR_PUBLISH_S * 1000000u;
+        }
+        ullWakeUs = MIN(ullWakeUs, ullPublishUs);
+#endif
+
+        /* Rounded up to the tick: a probe is never sent early */
+        if (ullWakeUs == UINT64_MAX)
+        {
+            xWait = portMAX_DELAY;
+        }
+        else if (ullWakeUs <= ullNowUs)
+        {
+            continue;
+        }
+        else
+        {
+            xWait = pdMS_TO_TICKS((uint32_t) ((ullWakeUs - ullNowUs + 999u) / 1000u));
+            xWait = (xWait > 0) ? xWait : 1;
+        }
+
+        (void) ulTaskNotifyTake(pdTRUE, xWait);
+    }
+}
+
+BaseType_t xPingMonitorStart(UBaseType_t uxPriority)
+{
+    UBaseType_t i;
+
+    for (i = 0; i < PING_MONITOR_MAX_PROBES; i++)
+    {
+        xProbes[i].ucTarget = PING_NO_TARGET;
+    }
+
+    usIdentifier = (uint16_t) netGetRandRange(ICMP_QUERY_ID_MIN, ICMP_QUERY_ID_MAX);
+    if (icmpRegisterEchoReplyCallback(prvEchoReply, NULL) != NO_ERROR)
+    {
+        return pdFAIL;
+    }
+
+    return xAppTaskCreate(xPingMonitorTask,
+                          prvPingMonitorTask,
+                          "PingMon",
+                          PING_MONITOR_TASK_STACK_SIZE,
+                          NULL,
+                          uxPriority,
+                          &xPingMonitorTask);
+}
+
+int32_t lPingMonitorAddTarget(const char *pcAddress, uint32_t ulPeriodMs)
+{
+    PingTarget_t *pxTarget;
+    Ipv4Addr ulAddr;
+    int32_t lTarget = -1;
+    UBaseType_t i;
+
+    if (ulPeriodMs < PING_MONITOR_MIN_PERIOD_MS || ipv4StringToAddr(pcAddress, &ulAddr) != NO_ERROR)
+    {
+        return -1;
+    }
+
+    osAcquireMutex(&netMutex);
+    for (i = 0; i < PING_MONITOR_MAX_TARGETS; i++)
+    {
+        pxTarget = &xTargets[i];
+        if (pxTarget->xUsed == pdFALSE)
+        {
+            memset(pxTarget, 0, sizeof(*pxTarget));
+            pxTarget->ulAddr = ulAddr;
+            pxTarget->ulPeriodMs = ulPeriodMs;
+            pxTarget->ullDueUs = ullMonoClockNowUs();
+            pxTarget->xUsed = pdTRUE;
+            lTarget = (int32_t) i;
+            break;
+        }
+    }
+    osReleaseMutex(&netMutex);
+
+    if (lTarget >= 0 && xPingMonitorTask != NULL)
+    {
+        xTaskNotifyGive(xPingMonitorTask);
+    }
+    return lTarget;
+}
+
+BaseType_t xPingMonitorRemoveTarget(int32_t lTarget)
+{
+    UBaseType_t i;
+
+    if (lTarget < 0 || lTarget >= PING_MONITOR_MAX_TARGETS)
+    {
+        return pdFAIL;
+    }
+
+    osAcquireMutex(&netMutex);
+    xTargets[lTarget].xUsed = pdFALSE;
+    xTargets[lTarget].ulAddr = IPV4_UNSPECIFIED_ADDR;
+    for (i = 0; i < PING_MONITOR_MAX_PROBES; i++)
+    {
+        if (xProbes[i].ucTarget == (uint8_t) lTarget)
+        {
+            xProbes[i].ucState = (uint8_t) eProbeFree;
+        }
+    }
+    osReleaseMutex(&netMutex);
+
+    return pdPASS;
+}
+
+BaseType_t xPingMonitorGetStats(int32_t lTarget, PingMonitorStats_t *pxStats)
+{
+    BaseType_t xResult = pdFAIL;
+
+    if (lTarget < 0 || lTarget >= PING_MONITOR_MAX_TARGETS)
+    {
+        return pdFAIL;
+    }
+
+    osAcquireMutex(&netMutex);
+    if (xTargets[lTarget].xUsed != pdFALSE)
+    {
+        *pxStats = xTargets[lTarget].xStats;
+        xResult = pdPASS;
+    }
+    osReleaseMutex(&netMutex);
+
+    return xResult;
+}
+
+static unsigned long prvNumber(const char *pcCommandString, UBaseType_t uxIndex, unsigned long ulDefault)
+{
+    const char *pcParameter;
+    BaseType_t xLength;
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, uxIndex, &xLength);
+    return (pcParameter != NULL) ? strtoul(pcParameter, NULL, 0) : ulDefault;
+}
+
+/* Next target of the report from uxReportTarget, PING_MONITOR_MAX_TARGETS if none */
+static UBaseType_t prvNextReportTarget(UBaseType_t uxFrom)
+{
+    while (uxFrom < PING_MONITOR_MAX_TARGETS && xReport[uxFrom].xUsed == pdFALSE)
+    {
+        uxFrom++;
+    }
+    return uxFrom;
+}
+
+static BaseType_t prvPingMonitorCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    const PingMonitorStats_t *pxStats;
+    const char *pcParameter;
+    BaseType_t xLength;
+    unsigned long ulTarget;
+    uint32_t ulLoss;
+    int32_t lTarget;
+    char cAddr[20];
+    UBaseType_t i;
+
+    if (uxPingMonLine == 0)
+    {
+        xReportHist = pdFALSE;
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xLength);
+        ulTarget = prvNumber(pcCommandString, 2, ~0ul);
+
+        if (pcParameter != NULL && xLength == 3 && strncmp(pcParameter, "add", 3) == 0)
+        {
+            pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xLength);
+            if (pcParameter == NULL || (size_t) xLength >= sizeof(cAddr))
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: pingmon add <ip> <period-ms>\r\n");
+                return pdFALSE;
+            }
+            memcpy(cAddr, pcParameter, (size_t) xLength);
+            cAddr[xLength] = '\0';
+            lTarget = lPingMonitorAddTarget(cAddr, (uint32_t) prvNumber(pcCommandString, 3, 1000u));
+            if (lTarget < 0)
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid address, period below %u ms, or table full\r\n",
+                         PING_MONITOR_MIN_PERIOD_MS);
+            }
+            else
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Target %ld\r\n", (long) lTarget);
+            }
+            return pdFALSE;
+        }
+
+        if (pcParameter != NULL && xLength == 3 && strncmp(pcParameter, "del", 3) == 0)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen,
+                     (xPingMonitorRemoveTarget((int32_t) ulTarget) == pdPASS) ? "Removed\r\n" : "No such target\r\n");
+            return pdFALSE;
+        }
+
+        if (pcParameter != NULL && xLength == 5 && strncmp(pcParameter, "reset", 5) == 0)
+        {
+            osAcquireMutex(&netMutex);
+            for (i = 0; i < PING_MONITOR_MAX_TARGETS; i++)
+            {
+                memset(&xTargets[i].xStats, 0, sizeof(xTargets[i].xStats));
+                xTargets[i].xHaveRtt = pdFALSE;
+                xTargets[i].ulJitter16 = 0;
+            }
+            ulEvicted = 0;
+            ulUnmatched = 0;
+            osReleaseMutex(&netMutex);
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Counters cleared\r\n");
+            return pdFALSE;
+        }
+
+        osAcquireMutex(&netMutex);
+        memcpy(xReport, xTargets, sizeof(xReport));
+        ulReportEvicted = ulEvicted;
+        ulReportUnmatched = ulUnmatched;
+        osReleaseMutex(&netMutex);
+
+        if (pcParameter != NULL && xLength == 4 && strncmp(pcParameter, "hist", 4) == 0)
+        {
+            if (ulTarget >= PING_MONITOR_MAX_TARGETS || xReport[ulTarget].xUsed == pdFALSE)
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "No such target\r\n");
+                return pdFALSE;
+            }
+            xReportHist = pdTRUE;
+            uxReportTarget = ulTarget;
+            snprintf(pcWriteBuffer, xWriteBufferLen, "rtt (us)           probes\r\n");
+            uxPingMonLine++;
+            return pdTRUE;
+        }
+
+        if (pcParameter != NULL)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: pingmon [add | del | hist | reset]\r\n");
+            return pdFALSE;
+        }
+
+        uxReportTarget = prvNextReportTarget(0);
+        snprintf(pcWriteBuffer, xWriteBufferLen, "identifier 0x%04x, %u probes, timeout %u ms, evicted %lu unmatched %lu\r\n",
+                 usIdentifier, PING_MONITOR_MAX_PROBES, PING_MONITOR_TIMEOUT_MS,
+                 (unsigned long) ulReportEvicted, (unsigned long) ulReportUnmatched);
+        if (uxReportTarget >= PING_MONITOR_MAX_TARGETS)
+        {
+            return pdFALSE;
+        }
+        uxPingMonLine++;
+        return pdTRUE;
+    }
+
+    /* "pingmon hist": one line per bucket */
+    if (xReportHist != pdFALSE)
+    {
+        i = uxPingMonLine - 1u;
+        pxStats = &xReport[uxReportTarget].xStats;
+        if (i == 0)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "        < %6lu  %10lu\r\n",
+                     128ul, (unsigned long) pxStats->ulHist[0]);
+        }
+        else if (i + 1u < PING_MONITOR_HIST_BUCKETS)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "%7lu - %6lu  %10lu\r\n",
+                     64ul << i, (128ul << i) - 1u, (unsigned long) pxStats->ulHist[i]);
+        }
+        else
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "     >= %6lu  %10lu\r\n",
+                     64ul << i, (unsigned long) pxStats->ulHist[i]);
+        }
+
+        if (++uxPingMonLine > PING_MONITOR_HIST_BUCKETS)
+        {
+            uxPingMonLine = 0;
+            return pdFALSE;
+        }
+        return pdTRUE;
+    }
+
+    if (uxPingMonLine == 1u)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "n  address         period     sent   recv   lost  late  loss%%   min-us   avg-us   max-us jitter\r\n");
+        uxPingMonLine++;
+        return pdTRUE;
+    }
+
+    /* One line per target */
+    pxStats = &xReport[uxReportTarget].xStats;
+    ipv4AddrToString(xReport[uxReportTarget].ulAddr, cAddr);
+    ulLoss = (pxStats->ulSent > 0) ? (uint32_t) (((uint64_t) pxStats->ulLost * 1000u) / pxStats->ulSent) : 0;
+    snprintf(pcWriteBuffer, xWriteBufferLen, "%-2lu %-15s %6lu %8lu %6lu %6lu %5lu %3lu.%lu %8lu %8lu %8lu %6lu\r\n",
+             (unsigned long) uxReportTarget, cAddr, (unsigned long) xReport[uxReportTarget].ulPeriodMs,
+             (unsigned long) pxStats->ulSent, (unsigned long) pxStats->ulReceived,
+             (unsigned long) pxStats->ulLost, (unsigned long) pxStats->ulLate,
+             (unsigned long) (ulLoss / 10u), (unsigned long) (ulLoss % 10u),
+             (unsigned long) pxStats->ulMinUs,
+             (unsigned long) ((pxStats->ulReceived > 0) ? pxStats->ullSumUs / pxStats->ulReceived : 0),
+             (unsigned long) pxStats->ulMaxUs, (unsigned long) pxStats->ulJitterUs);
+
+    uxReportTarget = prvNextReportTarget(uxReportTarget + 1u);
+    if (uxReportTarget < PING_MONITOR_MAX_TARGETS)
+    {
+        uxPingMonLine++;
+        return pdTRUE;
+    }
+
+    uxPingMonLine = 0;
+    return pdFALSE;
+}
+
+void vPingMonitorRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xPingMon);
+}
@@ -0,0 +1,532 @@
+/* PppModem.c
+ *
+ * USART2 driver of the PPP interface and dial task (see PppModem.h).
+ *
+ * The UART and its DMA streams are set up here rather than by CubeMX: the
+ * HAL UART callbacks are those of the console (SerialTask.c), so the
+ * streams are started with HAL_DMA_Start_IT() and complete through the
+ * callbacks of their own DMA handles; the USART requests are switched by
+ * hand in CR3.
+ */
+#include "PppModem.h"
+#include "RunTimeStats.h"
+#include "StaticAlloc.h"
+#include "stm32h7xx_hal.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "ppp/ppp.h"
+#include "ppp/ppp_hdlc.h"
+#include <stdio.h>
+#include <string.h>
+
+/* The real-time node profile builds the stack without PPP (net_config.h) */
+#if (PPP_SUPPORT == ENABLED)
+
+#define PPP_MODEM_CACHE_LINE           32u
+
+static UART_HandleTypeDef huart2;
+static DMA_HandleTypeDef hdma_usart2_rx;
+static DMA_HandleTypeDef hdma_usart2_tx;
+
+static NetInterface *pxPppInterface = NULL;
+
+/* Circular RX buffer; only the DMA writes it, so its cache lines are never
+ * dirty and can be invalidated before each read */
+static uint8_t ucRxDma[PPP_MODEM_RX_DMA_SIZE] __attribute__((aligned(PPP_MODEM_CACHE_LINE)));
+static uint32_t ulRxTail = 0;
+
+/* Bytes of the TX queue the running transfer sends, 0 when idle */
+static volatile size_t xTxLength = 0;
+
+/* Set by the DMA callbacks when a task was woken, for osExitIsr() */
+static bool_t xIsrFlag = FALSE;
+
+static PppModemStats_t xStats;
+
+static TaskHandle_t xPppTask = NULL;
+APP_TASK_STORAGE(xPppTask, PPP_MODEM_TASK_STACK_SIZE);
+
+static error_t prvUartInit(void);
+static void prvUartEnableIrq(void);
+static void prvUartDisableIrq(void);
+static void prvUartStartTx(void);
+
+const UartDriver xPppModemUartDriver =
+{
+    prvUartInit,
+    prvUartEnableIrq,
+    prvUartDisableIrq,
+    prvUartStartTx
+};
+
+static BaseType_t prvPppCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xPpp =
+{
+    "ppp",
+    "\r\nppp:\r\n PPP modem state and counters\r\n",
+    prvPppCommand,
+    -1
+};
+
+/* Move what the RX DMA wrote since the last call to the PPP RX queue; called
+ * from the USART2 and RX stream interrupts, which do not preempt each other */
+static bool_t prvRxDrain(void)
+{
+    uint32_t ulHead = PPP_MODEM_RX_DMA_SIZE - __HAL_DMA_GET_COUNTER(&hdma_usart2_rx);
+    uint32_t ulEnd;
+    uint32_t ulLength;
+    uint32_t ulStart;
+    size_t xFree;
+    bool_t flag = FALSE;
+
+    if (ulHead >= PPP_MODEM_RX_DMA_SIZE)
+    {
+        ulHead = 0;
+    }
+
+    while (ulRxTail != ulHead)
+    {
+        ulEnd = (ulHead > ulRxTail) ? ulHead : PPP_MODEM_RX_DMA_SIZE;
+        ulLength = ulEnd - ulRxTail;
+
+        /* Whole lines of the buffer, which is line aligned */
+        ulStart = ulRxTail & ~(PPP_MODEM_CACHE_LINE - 1u);
+        SCB_InvalidateDCache_by_Addr(&ucRxDma[ulStart], (int32_t) (ulEnd - ulStart));
+
+        xFree = PPP_RX_BUFFER_SIZE - pxPppInterface->pppContext->rxBufferLen;
+        if (ulLength > xFree)
+        {
+            xStats.ulRxDropped += ulLength - xFree;
+        }
+        xStats.ulRxBytes += ulLength;
+
+        flag |= pppHdlcDriverWriteRxQueueEx(pxPppInterface, &ucRxDma[ulRxTail], ulLength);
+
+        ulRxTail = (ulEnd == PPP_MODEM_RX_DMA_SIZE) ? 0 : ulEnd;
+    }
+
+    return flag;
+}
+
+static void prvRxStart(void)
+{
+    ulRxTail = 0;
+    (void) HAL_DMA_Start_IT(&hdma_usart2_rx, (uint32_t) &USART2->RDR, (uint32_t) ucRxDma, PPP_MODEM_RX_DMA_SIZE);
+    SET_BIT(USART2->CR3, USART_CR3_DMAR);
+}
+
+static void prvRxEvent(DMA_HandleTypeDef *hdma)
+{
+    (void) hdma;
+
+    xIsrFlag |= prvRxDrain();
+}
+
+/* The stream disables itself on a transfer error */
+static void prvRxError(DMA_HandleTypeDef *hdma)
+{
+    (void) hdma;
+
+    xStats.ulErrors++;
+    CLEAR_BIT(USART2->CR3, USART_CR3_DMAR);
+    prvRxStart();
+}
+
+/* Start a transfer of the TX queue if none is running; called by the HDLC
+ * driver after queuing a frame and on completion of the previous transfer */
+static void prvUartStartTx(void)
+{
+    const uint8_t *pucData;
+    uint32_t ulStart;
+    size_t xLength;
+
+    prvUartDisableIrq();
+
+    if (xTxLength == 0)
+    {
+        xLength = pppHdlcDriverPeekTxQueue(pxPppInterface, &pucData);
+        xLength = MIN(xLength, 0xFFFFu);
+
+        if (xLength > 0)
+        {
+            /* The DMA reads the memory, not the data cache */
+            ulStart = (uint32_t) pucData & ~(PPP_MODEM_CACHE_LINE - 1u);
+            SCB_CleanDCache_by_Addr((uint32_t *) ulStart, (int32_t) ((uint32_t) pucData + xLength - ulStart));
+
+            xTxLength = xLength;
+            if (HAL_DMA_Start_IT(&hdma_usart2_tx, (uint32_t) pucData, (uint32_t) &USART2->TDR, xLength) == HAL_OK)
+            {
+                SET_BIT(USART2->CR3, USART_CR3_DMAT);
+            }
+            else
+            {
+                xTxLength = 0;
+                xStats.ulErrors++;
+            }
+        }
+    }
+
+    prvUartEnableIrq();
+}
+
+static void prvTxDone(DMA_HandleTypeDef *hdma)
+{
+    size_t xLength = xTxLength;
+
+    CLEAR_BIT(USART2->CR3, USART_CR3_DMAT);
+    if (hdma->ErrorCode != HAL_DMA_ERROR_NONE)
+    {
+        xStats.ulErrors++;
+    }
+
+    /* Released even on an error: the frame is lost, the FCS of the peer
+     * catches it, and the queue moves on */
+    xTxLength = 0;
+    xStats.ulTxBytes += xLength;
+    xIsrFlag |= pppHdlcDriverConsumeTxQueue(pxPppInterface, xLength);
+
+    prvUartStartTx();
+}
+
+/* Called from pppHdlcDriverInit(); the lines stay masked in the NVIC until
+ * the TCP/IP task enables the interrupts of the interface */
+static error_t prvUartInit(void)
+{
+    GPIO_InitTypeDef xGpio = {0};
+    uint_t i;
+
+    for (i = 0; i < NET_INTERFACE_COUNT; i++)
+    {
+        if (netInterface[i].uartDriver == &xPppModemUartDriver)
+        {
+            pxPppInterface = &netInterface[i];
+        }
+    }
+    if (pxPppInterface == NULL)
+    {
+        return ERROR_FAILURE;
+    }
+
+    __HAL_RCC_USART2_CLK_ENABLE();
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_GPIOD_CLK_ENABLE();
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    /* PD4 RTS, PD5 TX, PD6 RX */
+    xGpio.Pin = GPIO_PIN_4 | GPIO_PIN_5 | GPIO_PIN_6;
+    xGpio.Mode = GPIO_MODE_AF_PP;
+    xGpio.Pull = GPIO_NOPULL;
+    xGpio.Speed = GPIO_SPEED_FREQ_HIGH;
+    xGpio.Alternate = GPIO_AF7_USART2;
+    HAL_GPIO_Init(GPIOD, &xGpio);
+
+    /* PA0 CTS */
+    xGpio.Pin = GPIO_PIN_0;
+    HAL_GPIO_Init(GPIOA, &xGpio);
+
+    /* HAL_UART_MspInit() only knows USART3: nothing more is done there */
+    huart2.Instance = USART2;
+    huart2.Init.BaudRate = PPP_MODEM_BAUD_RATE;
+    huart2.Init.WordLength = UART_WORDLENGTH_8B;
+    huart2.Init.StopBits = UART_STOPBITS_1;
+    huart2.Init.Parity = UART_PARITY_NONE;
+    huart2.Init.Mode = UART_MODE_TX_RX;
+    huart2.Init.HwFlowCtl = UART_HWCONTROL_RTS_CTS;
+    huart2.Init.OverSampling = UART_OVERSAMPLING_16;
+    huart2.Init.OneBitSampling = UART_ONE_BIT_SAMPLE_DISABLE;
+    huart2.Init.ClockPrescaler = UART_PRESCALER_DIV1;
+    huart2.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_NO_INIT;
+    if (HAL_UART_Init(&huart2) != HAL_OK)
+    {
+        return ERROR_FAILURE;
+    }
+
+    hdma_usart2_rx.Instance = DMA1_Stream2;
+    hdma_usart2_rx.Init.Request = DMA_REQUEST_USART2_RX;
+    hdma_usart2_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_usart2_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart2_rx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart2_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart2_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart2_rx.Init.Mode = DMA_CIRCULAR;
+    hdma_usart2_rx.Init.Priority = DMA_PRIORITY_HIGH;
+    hdma_usart2_rx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(&hdma_usart2_rx) != HAL_OK)
+    {
+        return ERROR_FAILURE;
+    }
+
+    hdma_usart2_tx.Instance = DMA1_Stream3;
+    hdma_usart2_tx.Init = hdma_usart2_rx.Init;
+    hdma_usart2_tx.Init.Request = DMA_REQUEST_USART2_TX;
+    hdma_usart2_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_usart2_tx.Init.Mode = DMA_NORMAL;
+    hdma_usart2_tx.Init.Priority = DMA_PRIORITY_MEDIUM;
+    if (HAL_DMA_Init(&hdma_usart2_tx) != HAL_OK)
+    {
+        return ERROR_FAILURE;
+    }
+
+    hdma_usart2_rx.XferHalfCpltCallback = prvRxEvent;
+    hdma_usart2_rx.XferCpltCallback = prvRxEvent;
+    hdma_usart2_rx.XferErrorCallback = prvRxError;
+    hdma_usart2_tx.XferCpltCallback = prvTxDone;
+    hdma_usart2_tx.XferErrorCallback = prvTxDone;
+
+    xTxLength = 0;
+    prvRxStart();
+
+    /* Drain on line idle; count overrun, framing and noise errors */
+    __HAL_UART_CLEAR_FLAG(&huart2, UART_CLEAR_IDLEF | UART_CLEAR_OREF | UART_CLEAR_FEF | UART_CLEAR_NEF);
+    SET_BIT(USART2->CR1, USART_CR1_IDLEIE);
+    SET_BIT(USART2->CR3, USART_CR3_EIE);
+
+    HAL_NVIC_SetPriority(USART2_IRQn, PPP_MODEM_IRQ_PRIORITY, 0);
+    HAL_NVIC_SetPriority(DMA1_Stream2_IRQn, PPP_MODEM_IRQ_PRIORITY, 0);
+    HAL_NVIC_SetPriority(DMA1_Stream3_IRQn, PPP_MODEM_IRQ_PRIORITY, 0);
+
+    return NO_ERROR;
+}
+
+static void prvUartEnableIrq(void)
+{
+    HAL_NVIC_EnableIRQ(USART2_IRQn);
+    HAL_NVIC_EnableIRQ(DMA1_Stream2_IRQn);
+    HAL_NVIC_EnableIRQ(DMA1_Stream3_IRQn);
+}
+
+static void prvUartDisableIrq(void)
+{
+    HAL_NVIC_DisableIRQ(USART2_IRQn);
+    HAL_NVIC_DisableIRQ(DMA1_Stream2_IRQn);
+    HAL_NVIC_DisableIRQ(DMA1_Stream3_IRQn);
+}
+
+void USART2_IRQHandler(void)
+{
+    uint32_t ulIsr;
+    bool_t flag = FALSE;
+
+    osEnterIsr();
+    vRunTimeStatsIsrEnter(RUN_TIME_STATS_ISR_USART2);
+
+    ulIsr = USART2->ISR;
+    if ((ulIsr & USART_ISR_ORE) != 0)
+    {
+        xStats.ulOverruns++;
+    }
+    if ((ulIsr & (USART_ISR_FE | USART_ISR_NE)) != 0)
+    {
+        xStats.ulErrors++;
+    }
+    USART2->ICR = USART_ICR_IDLECF | USART_ICR_ORECF | USART_ICR_FECF | USART_ICR_NECF;
+
+    if ((ulIsr & USART_ISR_IDLE) != 0)
+    {
+        flag = prvRxDrain();
+    }
+
+    vRunTimeStatsIsrExit(RUN_TIME_STATS_ISR_USART2);
+    osExitIsr(flag);
+}
+
+void DMA1_Stream2_IRQHandler(void)
+{
+    osEnterIsr();
+    vRunTimeStatsIsrEnter(RUN_TIME_STATS_ISR_USART2);
+
+    xIsrFlag = FALSE;
+    HAL_DMA_IRQHandler(&hdma_usart2_rx);
+
+    vRunTimeStatsIsrExit(RUN_TIME_STATS_ISR_USART2);
+    osExitIsr(xIsrFlag);
+}
+
+void DMA1_Stream3_IRQHandler(void)
+{
+    osEnterIsr();
+    vRunTimeStatsIsrEnter(RUN_TIME_STATS_ISR_USART2);
+
+    xIsrFlag = FALSE;
+    HAL_DMA_IRQHandler(&hdma_usart2_tx);
+
+    vRunTimeStatsIsrExit(RUN_TIME_STATS_ISR_USART2);
+    osExitIsr(xIsrFlag);
+}
+
+/* Link of ppp0, driven by IPCP; called by the stack with netMutex held */
+static void prvLinkChange(NetInterface *pxInterface, bool_t xLinkState, void *pvParam)
+{
+    (void) pxInterface;
+    (void) pvParam;
+
+    if (xLinkState)
+    {
+        xStats.ulConnects++;
+    }
+    else
+    {
+        xTaskNotifyGive(xPppTask);
+    }
+}
+
+/* Send an AT command and wait for its final result code */
+static error_t prvAtCommand(const char *pcCommand, const char *pcExpected)
+{
+    char cLine[64];
+    error_t err;
+
+    err = pppSendAtCommand(pxPppInterface, pcCommand);
+
+    while (err == NO_ERROR)
+    {
+        err = pppReceiveAtCommand(pxPppInterface, cLine, sizeof(cLine));
+        if (err != NO_ERROR)
+        {
+            break;
+        }
+
+        if (strstr(cLine, pcExpected) != NULL)
+        {
+            break;
+        }
+        if (strstr(cLine, "ERROR") != NULL || strstr(cLine, "NO CARRIER") != NULL ||
+            strstr(cLine, "BUSY") != NULL || strstr(cLine, "NO DIALTONE") != NULL)
+        {
+            err = ERROR_FAILURE;
+        }
+        /* Anything else is an echo or an intermediate result: read on */
+    }
+
+    return err;
+}
+
+static error_t prvDial(void)
+{
+    error_t err;
+
+    xStats.ulDials++;
+    pppSetTimeout(pxPppInterface, PPP_MODEM_AT_TIMEOUT_MS);
+
+    err = prvAtCommand("AT\r", "OK");
+    if (err == NO_ERROR)
+    {
+        err = prvAtCommand("ATE0\r", "OK");
+    }
+    if (err == NO_ERROR)
+    {
+        err = prvAtCommand("AT+CGDCONT=1,\"IP\",\"" PPP_MODEM_APN "\"\r", "OK");
+    }
+    if (err == NO_ERROR)
+    {
+        err = prvAtCommand("ATD*99#\r", "CONNECT");
+    }
+
+    /* The modem is in data mode: negotiate LCP, PAP and IPCP */
+    if (err == NO_ERROR)
+    {
+        pppSetTimeout(pxPppInterface, PPP_MODEM_CONNECT_TIMEOUT_MS);
+        err = pppConnect(pxPppInterface);
+    }
+
+    return err;
+}
+
+/* Back to command mode, then hang up; the escape sequence needs a second
+ * of silence on each side */
+static void prvHangUp(void)
+{
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    (void) pppSendAtCommand(pxPppInterface, "+++");
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    pppSetTimeout(pxPppInterface, PPP_MODEM_AT_TIMEOUT_MS);
+    (void) prvAtCommand("ATH\r", "OK");
+}
+
+static void prvPppTask(void *pvParameters)
+{
+    (void) pvParameters;
+
+    for (;;)
+    {
+        (void) ulTaskNotifyTake(pdTRUE, 0);
+
+        if (prvDial() == NO_ERROR)
+        {
+            /* Until IPCP or LCP goes down */
+            (void) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+
+        (void) pppClose(pxPppInterface);
+        prvHangUp();
+
+        vTaskDelay(pdMS_TO_TICKS(PPP_MODEM_REDIAL_DELAY_MS));
+    }
+}
+
+BaseType_t xPppModemStart(NetInterface *pxInterface, UBaseType_t uxPriority)
+{
+    error_t err;
+
+    if (pxInterface == NULL || pxInterface != pxPppInterface)
+    {
+        return pdFAIL;
+    }
+
+    if (pppSetAuthInfo(pxInterface, PPP_MODEM_USERNAME, PPP_MODEM_PASSWORD) != NO_ERROR)
+    {
+        return pdFAIL;
+    }
+
+    if (xAppTaskCreate(xPppTask,
+                       prvPppTask,
+                       "PPP",
+                       PPP_MODEM_TASK_STACK_SIZE,
+                       NULL,
+                       uxPriority,
+                       &xPppTask) != pdPASS)
+    {
+        return pdFAIL;
+    }
+
+    osAcquireMutex(&netMutex);
+    err = netAttachLinkChangeCallback(pxInterface, prvLinkChange, NULL);
+    osReleaseMutex(&netMutex);
+
+    return (err == NO_ERROR) ? pdPASS : pdFAIL;
+}
+
+void vPppModemGetStats(PppModemStats_t *pxStats)
+{
+    *pxStats = xStats;
+}
+
+static BaseType_t prvPppCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    static const char * const pcPhases[] = {"dead", "establish", "auth", "network", "terminate"};
+    PppModemStats_t xSnapshot;
+    uint_t uPhase = PPP_PHASE_DEAD;
+
+    (void) pcCommandString;
+
+    if (pxPppInterface != NULL)
+    {
+        uPhase = pxPppInterface->pppContext->pppPhase;
+    }
+    vPppModemGetStats(&xSnapshot);
+    snprintf(pcWriteBuffer, xWriteBufferLen, "%s dials %lu up %lu rx %lu drop %lu tx %lu ore %lu err %lu\r\n",
+             (uPhase < 5u) ? pcPhases[uPhase] : "?", (unsigned long) xSnapshot.ulDials,
+             (unsigned long) xSnapshot.ulConnects, (unsigned long) xSnapshot.ulRxBytes,
+             (unsigned long) xSnapshot.ulRxDropped, (unsigned long) xSnapshot.ulTxBytes,
+             (unsigned long) xSnapshot.ulOverruns, (unsigned long) xSnapshot.ulErrors);
+
+    return pdFALSE;
+}
+
+void vPppModemRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xPpp);
+}
+
+#endif
@@ -0,0 +1,856 @@
+/* PtpSlave.c
+ *
+ * IEEE 1588-2008 (PTPv2) ordinary clock, slave only, over UDP/IPv4 with the
+ * end-to-end delay mechanism. It disciplines the PTP clock of the Ethernet
+ * MAC (stm32h7xx_eth_driver.c), which time stamps the Sync messages on
+ * reception and the Delay_Req messages on transmission. The master provides
+ * the two other times: the transmit time of its Sync, in the Follow_Up
+ * message (two-step) or in the Sync itself (one-step), and the receive time
+ * of the Delay_Req, in the Delay_Resp message:
+ *
+ *     offset = (t2 - t1) - delay              (slave minus master)
+ *     delay  = ((t2 - t1) + (t4 - t3)) / 2
+ *
+ * The master is picked from the Announce messages with the dataset
+ * comparison of the standard, reduced to what a slave-only clock needs. A
+ * PI servo trims the frequency of the PTP clock from each offset; an offset
+ * beyond PTP_STEP_THRESHOLD_NS steps the clock instead, as on the first
+ * Sync. Losing the master leaves the last frequency in place (holdover).
+ *
+ * Once locked, the PTP time is sampled against the microsecond clock after
+ * every Sync and published as its reference timescale (MonoClock.c), so that
+ * any task can convert a local time stamp to the network time. That mapping
+ * has the resolution of the microsecond clock; only the PTP clock itself
+ * holds the sub-microsecond alignment.
+ */
+#include "PtpSlave.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "MonoClock.h"
+#include "core/net.h"
+#include "core/socket.h"
+#include "drivers/mac/stm32h7xx_eth_driver.h"
+#include "StaticAlloc.h"
+#include <stdio.h>
+#include <string.h>
+
+#if (ETH_TIMESTAMP_SUPPORT != ENABLED)
+#error The PTP slave requires ETH_TIMESTAMP_SUPPORT
+#endif
+
+/* PTP over UDP/IPv4 (IEEE 1588-2008 annex D) */
+#define PTP_EVENT_PORT                 319
+#define PTP_GENERAL_PORT               320
+#define PTP_PRIMARY_GROUP              IPV4_ADDR(224, 0, 1, 129)
+
+/* Event messages are sent as expedited forwarding, ahead of bulk traffic
+ * in the TX queue of the NIC */
+#define PTP_EVENT_DSCP                 46
+
+/* Message types */
+#define PTP_MSG_SYNC                   0x0
+#define PTP_MSG_DELAY_REQ              0x1
+#define PTP_MSG_FOLLOW_UP              0x8
+#define PTP_MSG_DELAY_RESP             0x9
+#define PTP_MSG_ANNOUNCE               0xB
+
+/* Common header */
+#define PTP_OFFSET_LENGTH              2
+#define PTP_OFFSET_DOMAIN              4
+#define PTP_OFFSET_FLAGS               6
+#define PTP_OFFSET_CORRECTION          8
+#define PTP_OFFSET_SOURCE              20
+#define PTP_OFFSET_SEQUENCE            30
+#define PTP_OFFSET_CONTROL             32
+#define PTP_OFFSET_INTERVAL            33
+#define PTP_OFFSET_BODY                34
+#define PTP_HEADER_SIZE                34
+
+#define PTP_VERSION                    2
+#define PTP_FLAG_TWO_STEP              0x0200
+#define PTP_CONTROL_DELAY_REQ          1
+#define PTP_INTERVAL_NONE              0x7F
+
+/* Sync, Delay_Req and Follow_Up: a time stamp */
+#define PTP_SYNC_SIZE                  44
+
+/* Delay_Resp: receive time stamp, requesting port identity */
+#define PTP_OFFSET_REQUESTING_PORT     44
+#define PTP_DELAY_RESP_SIZE            54
+
+/* Announce */
+#define PTP_OFFSET_PRIORITY1           47
+#define PTP_OFFSET_CLOCK_CLASS         48
+#define PTP_OFFSET_CLOCK_ACCURACY      49
+#define PTP_OFFSET_CLOCK_VARIANCE      50
+#define PTP_OFFSET_PRIORITY2           52
+#define PTP_OFFSET_GRANDMASTER         53
+#define PTP_OFFSET_STEPS_REMOVED       61
+#define PTP_ANNOUNCE_SIZE              64
+
+#define PTP_CLOCK_IDENTITY_SIZE        8
+#define PTP_PORT_IDENTITY_SIZE         10
+
+/* Log intervals are clamped to this range, 128 s / 8 ms */
+#define PTP_LOG_INTERVAL_MAX           7
+
+/* Dataset of the master, from its last Announce message */
+typedef struct
+{
+    uint8_t ucPort[PTP_PORT_IDENTITY_SIZE];
+    uint8_t ucGrandmaster[PTP_CLOCK_IDENTITY_SIZE];
+    uint8_t ucPriority1;
+    uint8_t ucClass;
+    uint8_t ucAccuracy;
+    uint16_t usVariance;
+    uint8_t ucPriority2;
+    uint16_t usStepsRemoved;
+    int8_t cLogAnnounceInterval;
+    Ipv4Addr xAddr;
+    systime_t xLastAnnounce;
+} PtpMaster_t;
+
+static TaskHandle_t xPtpTask = NULL;
+APP_TASK_STORAGE(xPtpTask, PTP_SLAVE_STACK_SIZE);
+static Socket *pxEventSocket = NULL;
+static Socket *pxGeneralSocket = NULL;
+
+/* Port identity of the slave: EUI-64 of the MAC address, port 1 */
+static uint8_t ucIdentity[PTP_PORT_IDENTITY_SIZE];
+
+static PtpMaster_t xMaster;
+static PtpSlaveStats_t xStats;
+
+/* Two-step Sync waiting for its Follow_Up */
+static BaseType_t xSyncPending = pdFALSE;
+static uint16_t usSyncSeq;
+static int64_t llSyncRxNs;
+static int64_t llSyncCorrectionNs;
+static int8_t cLogSyncInterval = 0;
+
+/* Master to slave delay (t2 - t1) of the last Sync */
+static BaseType_t xLastSyncValid = pdFALSE;
+static int64_t llLastSyncNs;
+
+/* Delay request in progress, t2 - t1 being that of the Sync before it */
+static BaseType_t xDelayReqPending = pdFALSE;
+static uint16_t usDelayReqSeq = 0;
+static int64_t llDelayReqSyncNs;
+static systime_t xDelayReqDue;
+static int8_t cLogDelayReqInterval = 0;
+static BaseType_t xDelayValid = pdFALSE;
+
+/* Transmit time of the last Delay_Req, from the TCP/IP task */
+static volatile int32_t lTxStampId = -1;
+static volatile int64_t llTxStampNs;
+
+/* Servo */
+static int64_t llIntegralPpb = 0;
+static UBaseType_t uxLockCount = 0;
+
+/* Last sample of the PTP time against the microsecond clock */
+static BaseType_t xSampleValid = pdFALSE;
+static uint64_t ullSampleLocalUs;
+static int64_t llSamplePtpNs;
+static int32_t lRatePpb = 0;
+
+static uint8_t ucRxBuffer[128];
+static uint8_t ucTxBuffer[PTP_SYNC_SIZE];
+
+static void prvPtpSlaveTask(void *pvParameters);
+
+static int64_t prvLoadTimestampNs(const uint8_t *pucTimestamp)
+{
+    return (int64_t) LOAD48BE(pucTimestamp) * 1000000000 + (int64_t) LOAD32BE(pucTimestamp + 6);
+}
+
+static int64_t prvTimestampNs(const NetTimestamp *pxTimestamp)
+{
+    return (int64_t) pxTimestamp->s * 1000000000 + (int64_t) pxTimestamp->ns;
+}
+
+/* The correction field counts 2^-16 ns */
+static int64_t prvCorrectionNs(const uint8_t *pucMessage)
+{
+    return (int64_t) LOAD64BE(pucMessage + PTP_OFFSET_CORRECTION) / 65536;
+}
+
+static int8_t prvClampLog(int8_t cLog)
+{
+    if (cLog > PTP_LOG_INTERVAL_MAX)
+    {
+        return PTP_LOG_INTERVAL_MAX;
+    }
+    if (cLog < -PTP_LOG_INTERVAL_MAX)
+    {
+        return -PTP_LOG_INTERVAL_MAX;
+    }
+    return cLog;
+}
+
+static systime_t prvIntervalMs(int8_t cLog)
+{
+    cLog = prvClampLog(cLog);
+    return (cLog >= 0) ? (1000u << cLog) : (1000u >> -cLog);
+}
+
+/* Offset accumulated over a Sync interval, as a rate in ns per second */
+static int64_t prvPerSecond(int64_t llOffsetNs, int8_t cLog)
+{
+    cLog = prvClampLog(cLog);
+    return (cLog >= 0) ? llOffsetNs / (1 << cLog) : llOffsetNs * (1 << -cLog);
+}
+
+static BaseType_t prvFromMaster(const uint8_t *pucMessage)
+{
+    return xStats.eState != ePtpListening &&
+           memcmp(pucMessage + PTP_OFFSET_SOURCE, xMaster.ucPort, PTP_PORT_IDENTITY_SIZE) == 0;
+}
+
+/* Negative if pxA is the better master */
+static int prvCompareMasters(const PtpMaster_t *pxA, const PtpMaster_t *pxB)
+{
+    int iResult;
+
+    /* Same grandmaster: the shorter path wins, then the port identity */
+    iResult = memcmp(pxA->ucGrandmaster, pxB->ucGrandmaster, PTP_CLOCK_IDENTITY_SIZE);
+    if (iResult == 0)
+    {
+        if (pxA->usStepsRemoved != pxB->usStepsRemoved)
+        {
+            return (int) pxA->usStepsRemoved - (int) pxB->usStepsRemoved;
+        }
+        return memcmp(pxA->ucPort, pxB->ucPort, PTP_PORT_IDENTITY_SIZE);
+    }
+
+    if (pxA->ucPriority1 != pxB->ucPriority1)
+    {
+        return (int) pxA->ucPriority1 - (int) pxB->ucPriority1;
+    }
+    if (pxA->ucClass != pxB->ucClass)
+    {
+        return (int) pxA->ucClass - (int) pxB->ucClass;
+    }
+    if (pxA->ucAccuracy != pxB->ucAccuracy)
+    {
+        return (int) pxA->ucAccuracy - (int) pxB->ucAccuracy;
+    }
+    if (pxA->usVariance != pxB->usVariance)
+    {
+        return (int) pxA->usVariance - (int) pxB->usVariance;
+    }
+    if (pxA->ucPriority2 != pxB->ucPriority2)
+    {
+        return (int) pxA->ucPriority2 - (int) pxB->ucPriority2;
+    }
+    return iResult;
+}
+
+/* The PTP time no longer tracks a master: drop the measurements, and the
+ * reference of the microsecond clock if it is ours (else it may be the UTC
+ * of the SNTP client) */
+static void prvUnlock(void)
+{
+    if (xSampleValid)
+    {
+        vMonoClockClearReference();
+    }
+    xSyncPending = pdFALSE;
+    xLastSyncValid = pdFALSE;
+    xDelayReqPending = pdFALSE;
+    xSampleValid = pdFALSE;
+    uxLockCount = 0;
+}
+
+static void prvSelectMaster(const PtpMaster_t *pxMaster)
+{
+    taskENTER_CRITICAL();
+    xMaster = *pxMaster;
+    xStats.eState = ePtpUncalibrated;
+    memcpy(xStats.ucMasterIdentity, pxMaster->ucPort, PTP_CLOCK_IDENTITY_SIZE);
+    xStats.usMasterPort = LOAD16BE(pxMaster->ucPort + PTP_CLOCK_IDENTITY_SIZE);
+    xStats.ulMasterAddr = pxMaster->xAddr;
+    taskEXIT_CRITICAL();
+
+    prvUnlock();
+    xDelayValid = pdFALSE;
+    xDelayReqDue = osGetSystemTime();
+}
+
+/* Sample the PTP time against the microsecond clock and publish it as its
+ * reference; the relative rate is averaged over successive samples */
+static void prvPublishReference(void)
+{
+    NetTimestamp xPtpTime;
+    uint64_t ullLocalUs;
+    int64_t llPtpNs;
+    int64_t llLocalNs;
+    int32_t lSamplePpb;
+
+    taskENTER_CRITICAL();
+    ullLocalUs = ullMonoClockNowUs();
+    stm32h7xxEthGetPtpTime(&xPtpTime);
+    taskEXIT_CRITICAL();
+
+    llPtpNs = prvTimestampNs(&xPtpTime);
+
+    if (xSampleValid)
+    {
+        llLocalNs = (int64_t) (ullLocalUs - ullSampleLocalUs) * 1000;
+        if (llLocalNs > 0)
+        {
+            lSamplePpb = (int32_t) (((llPtpNs - llSamplePtpNs) - llLocalNs) * 1000000000 / llLocalNs);
+            lRatePpb += (lSamplePpb - lRatePpb) / (1 << PTP_FILTER_SHIFT);
+        }
+    }
+    else
+    {
+        lRatePpb = 0;
+    }
+
+    xSampleValid = pdTRUE;
+    ullSampleLocalUs = ullLocalUs;
+    llSamplePtpNs = llPtpNs;
+
+    vMonoClockSetReference(ullLocalUs, (uint64_t) llPtpNs / 1000u, lRatePpb);
+}
+
+static void prvServo(int64_t llOffsetNs)
+{
+    int64_t llRate;
+    int64_t llAdjust;
+
+    xStats.llOffsetNs = llOffsetNs;
+
+    /* Too far off for the servo: step, keeping the frequency */
+    if (llOffsetNs > PTP_STEP_THRESHOLD_NS || llOffsetNs < -PTP_STEP_THRESHOLD_NS)
+    {
+        stm32h7xxEthAdjustPtpTime(-llOffsetNs);
+        xStats.ulSteps++;
+        xStats.eState = ePtpUncalibrated;
+        prvUnlock();
+        return;
+    }
+
+    llRate = prvPerSecond(llOffsetNs, cLogSyncInterval);
+
+    llIntegralPpb += llRate * PTP_SERVO_KI_PERMILLE / 1000;
+    if (llIntegralPpb > STM32H7XX_ETH_PTP_MAX_ADJ)
+    {
+        llIntegralPpb = STM32H7XX_ETH_PTP_MAX_ADJ;
+    }
+    else if (llIntegralPpb < -STM32H7XX_ETH_PTP_MAX_ADJ)
+    {
+        llIntegralPpb = -STM32H7XX_ETH_PTP_MAX_ADJ;
+    }
+
+    llAdjust = llRate * PTP_SERVO_KP_PERMILLE / 1000 + llIntegralPpb;
+    if (llAdjust > STM32H7XX_ETH_PTP_MAX_ADJ)
+    {
+        llAdjust = STM32H7XX_ETH_PTP_MAX_ADJ;
+    }
+    else if (llAdjust < -STM32H7XX_ETH_PTP_MAX_ADJ)
+    {
+        llAdjust = -STM32H7XX_ETH_PTP_MAX_ADJ;
+    }
+
+    /* A clock ahead of the master is slowed down */
+    xStats.lFreqPpb = (int32_t) -llAdjust;
+    stm32h7xxEthAdjustPtpFreq(xStats.lFreqPpb);
+
+    if (llOffsetNs < PTP_LOCK_THRESHOLD_NS && llOffsetNs > -PTP_LOCK_THRESHOLD_NS)
+    {
+        if (uxLockCount < PTP_LOCK_COUNT)
+        {
+            uxLockCount++;
+        }
+    }
+    else
+    {
+        uxLockCount = 0;
+    }
+
+    /* Locked once the path delay is known as well */
+    if (xStats.eState == ePtpUncalibrated && uxLockCount >= PTP_LOCK_COUNT && xDelayValid)
+    {
+        xStats.eState = ePtpSlave;
+    }
+
+    if (xStats.eState == ePtpSlave)
+    {
+        prvPublishReference();
+    }
+}
+
+static void prvSendDelayReq(void)
+{
+    SocketMsg xMessage;
+
+    memset(ucTxBuffer, 0, sizeof(ucTxBuffer));
+    ucTxBuffer[0] = PTP_MSG_DELAY_REQ;
+    ucTxBuffer[1] = PTP_VERSION;
+    STORE16BE(PTP_SYNC_SIZE, ucTxBuffer + PTP_OFFSET_LENGTH);
+    ucTxBuffer[PTP_OFFSET_DOMAIN] = PTP_DOMAIN;
+    memcpy(ucTxBuffer + PTP_OFFSET_SOURCE, ucIdentity, PTP_PORT_IDENTITY_SIZE);
+    STORE16BE(++usDelayReqSeq, ucTxBuffer + PTP_OFFSET_SEQUENCE);
+    ucTxBuffer[PTP_OFFSET_CONTROL] = PTP_CONTROL_DELAY_REQ;
+    ucTxBuffer[PTP_OFFSET_INTERVAL] = PTP_INTERVAL_NONE;
+
+    xMessage = SOCKET_DEFAULT_MSG;
+    xMessage.data = ucTxBuffer;
+    xMessage.length = PTP_SYNC_SIZE;
+    xMessage.destIpAddr.length = sizeof(Ipv4Addr);
+    xMessage.destIpAddr.ipv4Addr = PTP_PRIMARY_GROUP;
+    xMessage.destPort = PTP_EVENT_PORT;
+
+    /* The MAC reports the transmit time under the sequence number */
+    xMessage.timestampId = usDelayReqSeq;
+
+    if (socketSendMsg(pxEventSocket, &xMessage, 0) == NO_ERROR)
+    {
+        xDelayReqPending = pdTRUE;
+        llDelayReqSyncNs = llLastSyncNs;
+        xStats.ulDelayReqs++;
+    }
+}
+
+/* t1 corrected by the master, t2 from the MAC */
+static void prvSyncComplete(int64_t llT1Ns, int64_t llT2Ns)
+{
+    systime_t xNow;
+
+    llLastSyncNs = llT2Ns - llT1Ns;
+    xLastSyncValid = pdTRUE;
+
+    /* The path delay is taken as zero until measured, which is enough for
+     * the first step */
+    prvServo(llLastSyncNs - (xDelayValid ? xStats.llMeanPathDelayNs : 0));
+
+    /* A step drops the measurement */
+    xNow = osGetSystemTime();
+    if (xLastSyncValid && timeCompare(xNow, xDelayReqDue) >= 0)
+    {
+        xDelayReqDue = xNow + prvIntervalMs(cLogDelayReqInterval);
+        prvSendDelayReq();
+    }
+}
+
+static void prvAnnounce(const uint8_t *pucMessage, size_t xLength, Ipv4Addr xAddr)
+{
+    PtpMaster_t xCandidate;
+
+    if (xLength < PTP_ANNOUNCE_SIZE)
+    {
+        xStats.ulDropped++;
+        return;
+    }
+
+    xStats.ulAnnounces++;
+
+    memcpy(xCandidate.ucPort, pucMessage + PTP_OFFSET_SOURCE, PTP_PORT_IDENTITY_SIZE);
+    memcpy(xCandidate.ucGrandmaster, pucMessage + PTP_OFFSET_GRANDMASTER, PTP_CLOCK_IDENTITY_SIZE);
+    xCandidate.ucPriority1 = pucMessage[PTP_OFFSET_PRIORITY1];
+    xCandidate.ucClass = pucMessage[PTP_OFFSET_CLOCK_CLASS];
+    xCandidate.ucAccuracy = pucMessage[PTP_OFFSET_CLOCK_ACCURACY];
+    xCandidate.usVariance = LOAD16BE(pucMessage + PTP_OFFSET_CLOCK_VARIANCE);
+    xCandidate.ucPriority2 = pucMessage[PTP_OFFSET_PRIORITY2];
+    xCandidate.usStepsRemoved = LOAD16BE(pucMessage + PTP_OFFSET_STEPS_REMOVED);
+    xCandidate.cLogAnnounceInterval = (int8_t) pucMessage[PTP_OFFSET_INTERVAL];
+    xCandidate.xAddr = xAddr;
+    xCandidate.xLastAnnounce = osGetSystemTime();
+
+    if (prvFromMaster(pucMessage))
+    {
+        /* Same master: refresh its dataset and its timeout */
+        xMaster = xCandidate;
+    }
+    else if (xStats.eState == ePtpListening || prvCompareMasters(&xCandidate, &xMaster) < 0)
+    {
+        prvSelectMaster(&xCandidate);
+    }
+}
+
+static void prvSync(const uint8_t *pucMessage, size_t xLength, const NetTimestamp *pxRxTime)
+{
+    if (!prvFromMaster(pucMessage))
+    {
+        return;
+    }
+
+    if (xLength < PTP_SYNC_SIZE)
+    {
+        xStats.ulDropped++;
+        return;
+    }
+
+    xStats.ulSyncs++;
+    xSyncPending = pdFALSE;
+
+    /* No time stamp: the receive descriptor ran out, or the MAC filter
+     * does not match the message */
+    if (pxRxTime->s == 0 && pxRxTime->ns == 0)
+    {
+        xStats.ulRxStampMissed++;
+        return;
+    }
+
+    cLogSyncInterval = (int8_t) pucMessage[PTP_OFFSET_INTERVAL];
+
+    if ((LOAD16BE(pucMessage + PTP_OFFSET_FLAGS) & PTP_FLAG_TWO_STEP) != 0)
+    {
+        xSyncPending = pdTRUE;
+        usSyncSeq = LOAD16BE(pucMessage + PTP_OFFSET_SEQUENCE);
+        llSyncRxNs = prvTimestampNs(pxRxTime);
+        llSyncCorrectionNs = prvCorrectionNs(pucMessage);
+    }
+    else
+    {
+        prvSyncComplete(prvLoadTimestampNs(pucMessage + PTP_OFFSET_BODY) + prvCorrectionNs(pucMessage),
+                        prvTimestampNs(pxRxTime));
+    }
+}
+
+static void prvFollowUp(const uint8_t *pucMessage, size_t xLength)
+{
+    if (!prvFromMaster(pucMessage))
+    {
+        return;
+    }
+
+    if (xLength < PTP_SYNC_SIZE)
+    {
+        xStats.ulDropped++;
+        return;
+    }
+
+    xStats.ulFollowUps++;
+
+    if (!xSyncPending || LOAD16BE(pucMessage + PTP_OFFSET_SEQUENCE) != usSyncSeq)
+    {
+        xStats.ulDropped++;
+        return;
+    }
+
+    xSyncPending = pdFALSE;
+    prvSyncComplete(prvLoadTimestampNs(pucMessage + PTP_OFFSET_BODY) + llSyncCorrectionNs +
+                    prvCorrectionNs(pucMessage), llSyncRxNs);
+}
+
+static void prvDelayResp(const uint8_t *pucMessage, size_t xLength)
+{
+    int32_t lStampId;
+    int64_t llT3Ns;
+    int64_t llT4Ns;
+    int64_t llDelayNs;
+
+    if (!prvFromMaster(pucMessage))
+    {
+        return;
+    }
+
+    if (xLength < PTP_DELAY_RESP_SIZE)
+    {
+        xStats.ulDropped++;
+        return;
+    }
+
+    /* Answer to another slave */
+    if (memcmp(pucMessage + PTP_OFFSET_REQUESTING_PORT, ucIdentity, PTP_PORT_IDENTITY_SIZE) != 0)
+    {
+        return;
+    }
+
+    xStats.ulDelayResps++;
+    cLogDelayReqInterval = (int8_t) pucMessage[PTP_OFFSET_INTERVAL];
+
+    if (!xDelayReqPending || LOAD16BE(pucMessage + PTP_OFFSET_SEQUENCE) != usDelayReqSeq)
+    {
+        xStats.ulDropped++;
+        return;
+    }
+
+    xDelayReqPending = pdFALSE;
+
+    taskENTER_CRITICAL();
+    lStampId = lTxStampId;
+    llT3Ns = llTxStampNs;
+    taskEXIT_CRITICAL();
+
+    if (lStampId != (int32_t) usDelayReqSeq)
+    {
+        xStats.ulTxStampMissed++;
+        return;
+    }
+
+    llT4Ns = prvLoadTimestampNs(pucMessage + PTP_OFFSET_BODY) - prvCorrectionNs(pucMessage);
+    llDelayNs = (llDelayReqSyncNs + (llT4Ns - llT3Ns)) / 2;
+
+    if (xDelayValid)
+    {
+        xStats.llMeanPathDelayNs += (llDelayNs - xStats.llMeanPathDelayNs) / (1 << PTP_FILTER_SHIFT);
+    }
+    else
+    {
+        xStats.llMeanPathDelayNs = llDelayNs;
+        xDelayValid = pdTRUE;
+    }
+}
+
+static void prvReceive(Socket *pxSocket)
+{
+    SocketMsg xMessage;
+    const uint8_t *pucMessage = ucRxBuffer;
+
+    for (;;)
+    {
+        xMessage = SOCKET_DEFAULT_MSG;
+        xMessage.data = ucRxBuffer;
+        xMessage.size = sizeof(ucRxBuffer);
+        if (socketReceiveMsg(pxSocket, &xMessage, SOCKET_FLAG_DONT_WAIT) != NO_ERROR)
+        {
+            return;
+        }
+
+        if (xMessage.length < PTP_HEADER_SIZE ||
+            (pucMessage[1] & 0x0F) != PTP_VERSION ||
+            (size_t) LOAD16BE(pucMessage + PTP_OFFSET_LENGTH) > xMessage.length)
+        {
+            xStats.ulDropped++;
+            continue;
+        }
+
+        /* Other domains, and our own Delay_Req looped back */
+        if (pucMessage[PTP_OFFSET_DOMAIN] != PTP_DOMAIN ||
+            memcmp(pucMessage + PTP_OFFSET_SOURCE, ucIdentity, PTP_CLOCK_IDENTITY_SIZE) == 0)
+        {
+            continue;
+        }
+
+        /* Management, signaling and peer delay messages are ignored, as
+         * are the Delay_Req of other slaves */
+        switch (pucMessage[0] & 0x0F)
+        {
+        case PTP_MSG_ANNOUNCE:
+            prvAnnounce(pucMessage, xMessage.length, xMessage.srcIpAddr.ipv4Addr);
+            break;
+        case PTP_MSG_SYNC:
+            prvSync(pucMessage, xMessage.length, &xMessage.timestamp);
+            break;
+        case PTP_MSG_FOLLOW_UP:
+            prvFollowUp(pucMessage, xMessage.length);
+            break;
+        case PTP_MSG_DELAY_RESP:
+            prvDelayResp(pucMessage, xMessage.length);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/* Drop a master whose Announce messages stopped */
+static void prvCheckMaster(void)
+{
+    systime_t xTimeout;
+
+    if (xStats.eState == ePtpListening)
+    {
+        return;
+    }
+
+    xTimeout = PTP_ANNOUNCE_RECEIPT_TIMEOUT * prvIntervalMs(xMaster.cLogAnnounceInterval);
+    if (timeCompare(osGetSystemTime(), xMaster.xLastAnnounce + xTimeout) > 0)
+    {
+        xStats.eState = ePtpListening;
+        prvUnlock();
+    }
+}
+
+static void prvPtpSlaveTask(void *pvParameters)
+{
+    SocketEventDesc xEvents[2];
+    UBaseType_t i;
+
+    (void) pvParameters;
+
+    for (;;)
+    {
+        xEvents[0].socket = pxEventSocket;
+        xEvents[0].eventMask = SOCKET_EVENT_RX_READY;
+        xEvents[1].socket = pxGeneralSocket;
+        xEvents[1].eventMask = SOCKET_EVENT_RX_READY;
+
+        if (socketPoll(xEvents, 2, NULL, PTP_POLL_MS) == NO_ERROR)
+        {
+            for (i = 0; i < 2; i++)
+            {
+                if ((xEvents[i].eventFlags & SOCKET_EVENT_RX_READY) != 0)
+                {
+                    prvReceive(xEvents[i].socket);
+                }
+            }
+        }
+
+        prvCheckMaster();
+    }
+}
+
+void vPtpSlaveTxTimestamp(int32_t lTimestampId, uint32_t ulSeconds, uint32_t ulNanoseconds)
+{
+    taskENTER_CRITICAL();
+    llTxStampNs = (int64_t) ulSeconds * 1000000000 + (int64_t) ulNanoseconds;
+    lTxStampId = lTimestampId;
+    taskEXIT_CRITICAL();
+}
+
+static Socket *prvOpenSocket(NetInterface *pxInterface, uint16_t usPort)
+{
+    Socket *pxSocket;
+    IpAddr xGroup;
+
+    pxSocket = socketOpen(SOCKET_TYPE_DGRAM, SOCKET_IP_PROTO_UDP);
+    if (pxSocket == NULL)
+    {
+        return NULL;
+    }
+
+    xGroup.length = sizeof(Ipv4Addr);
+    xGroup.ipv4Addr = PTP_PRIMARY_GROUP;
+
+    /* PTP messages are not forwarded by routers */
+    if (socketSetInterface(pxSocket, pxInterface) != NO_ERROR ||
+        socketSetMulticastTtl(pxSocket, 1) != NO_ERROR ||
+        socketBind(pxSocket, &IP_ADDR_ANY, usPort) != NO_ERROR ||
+        socketJoinMulticastGroup(pxSocket, &xGroup) != NO_ERROR)
+    {
+        socketClose(pxSocket);
+        return NULL;
+    }
+
+    return pxSocket;
+}
+
+BaseType_t xPtpSlaveStart(UBaseType_t uxInterface, UBaseType_t uxPriority)
+{
+    NetInterface *pxInterface;
+    const uint8_t *pucMac;
+
+    if (uxInterface >= NET_INTERFACE_COUNT)
+    {
+        return pdFAIL;
+    }
+
+    pxInterface = &netInterface[uxInterface];
+    pucMac = pxInterface->macAddr.b;
+
+    /* EUI-64 from the EUI-48 */
+    ucIdentity[0] = pucMac[0];
+    ucIdentity[1] = pucMac[1];
+    ucIdentity[2] = pucMac[2];
+    ucIdentity[3] = 0xFF;
+    ucIdentity[4] = 0xFE;
+    ucIdentity[5] = pucMac[3];
+    ucIdentity[6] = pucMac[4];
+    ucIdentity[7] = pucMac[5];
+    STORE16BE(1, ucIdentity + PTP_CLOCK_IDENTITY_SIZE);
+
+    memset(&xStats, 0, sizeof(xStats));
+    xStats.eState = ePtpListening;
+
+    pxEventSocket = prvOpenSocket(pxInterface, PTP_EVENT_PORT);
+    pxGeneralSocket = prvOpenSocket(pxInterface, PTP_GENERAL_PORT);
+    if (pxEventSocket == NULL || pxGeneralSocket == NULL ||
+        socketSetDscp(pxEventSocket, PTP_EVENT_DSCP) != NO_ERROR)
+    {
+        return pdFAIL;
+    }
+
+    return xAppTaskCreate(xPtpTask, prvPtpSlaveTask, "PTP", PTP_SLAVE_STACK_SIZE, NULL, uxPriority, &xPtpTask);
+}
+
+void vPtpSlaveGetStats(PtpSlaveStats_t *pxStats)
+{
+    taskENTER_CRITICAL();
+    *pxStats = xStats;
+    taskEXIT_CRITICAL();
+}
+
+static BaseType_t prvPtpCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xPtp =
+{
+    "ptp",
+    "\r\nptp:\r\n PTP slave state, offset from the master, path delay and message counters\r\n",
+    prvPtpCommand,
+    0
+};
+
+/* Servo state copied in a critical section on the first line, so that the
+ * offset, path delay and frequency printed apart come from the same sync */
+static PtpSlaveStats_t xPtpReport;
+static UBaseType_t uxPtpLine = 0;
+
+static const char * const pcPtpStateNames[] = { "listening", "uncalibrated", "slave" };
+
+static BaseType_t prvPtpCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    const uint8_t *pucId = xPtpReport.ucMasterIdentity;
+    char cAddr[16];
+    NetTimestamp xPtpTime;
+    uint64_t ullReferenceUs;
+
+    (void) pcCommandString;
+
+    if (uxPtpLine == 0)
+    {
+        if (xPtpTask == NULL)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "PTP slave not running\r\n");
+            return pdFALSE;
+        }
+
+        vPtpSlaveGetStats(&xPtpReport);
+    }
+
+    switch (uxPtpLine++)
+    {
+    case 0:
+        ipv4AddrToString(xPtpReport.ulMasterAddr, cAddr);
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "ptp: state=%s domain=%u master=%02x%02x%02x%02x%02x%02x%02x%02x-%u addr=%s\r\n",
+                 pcPtpStateNames[xPtpReport.eState], (unsigned int) PTP_DOMAIN,
+                 pucId[0], pucId[1], pucId[2], pucId[3], pucId[4], pucId[5], pucId[6], pucId[7],
+                 (unsigned int) xPtpReport.usMasterPort, cAddr);
+        return pdTRUE;
+    case 1:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "servo: offset=%ld ns path-delay=%ld ns freq=%ld ppb steps=%lu\r\n",
+                 (long) xPtpReport.llOffsetNs, (long) xPtpReport.llMeanPathDelayNs,
+                 (long) xPtpReport.lFreqPpb, (unsigned long) xPtpReport.ulSteps);
+        return pdTRUE;
+    case 2:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "msgs: announce=%lu sync=%lu follow-up=%lu delay-req=%lu delay-resp=%lu\r\n",
+                 (unsigned long) xPtpReport.ulAnnounces, (unsigned long) xPtpReport.ulSyncs,
+                 (unsigned long) xPtpReport.ulFollowUps, (unsigned long) xPtpReport.ulDelayReqs,
+                 (unsigned long) xPtpReport.ulDelayResps);
+        return pdTRUE;
+    case 3:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "errors: rx-stamp=%lu tx-stamp=%lu dropped=%lu\r\n",
+                 (unsigned long) xPtpReport.ulRxStampMissed, (unsigned long) xPtpReport.ulTxStampMissed,
+                 (unsigned long) xPtpReport.ulDropped);
+        return pdTRUE;
+    default:
+        /* The reference reads 0 until the slave is locked */
+        stm32h7xxEthGetPtpTime(&xPtpTime);
+        ullReferenceUs = ullMonoClockToReferenceUs(ullMonoClockNowUs());
+        snprintf(pcWriteBuffer, xWriteBufferLen, "time: ptp=%lu.%09lu reference=%lu.%06lu\r\n",
+                 (unsigned long) xPtpTime.s, (unsigned long) xPtpTime.ns,
+                 (unsigned long) (ullReferenceUs / 1000000u), (unsigned long) (ullReferenceUs % 1000000u));
+        uxPtpLine = 0;
+        return pdFALSE;
+    }
+}
+
+void vPtpSlaveRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xPtp);
+}
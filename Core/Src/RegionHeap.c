@@ -0,0 +1,319 @@
+/* RegionHeap.c
+ *
+ * Heaps of the DTCM and of the D3 SRAM, next to the FreeRTOS heap of the D1
+ * SRAM (see RegionHeap.h).
+ *
+ * Each region runs the scheme of heap_4: a free list ordered by address,
+ * first fit, blocks split when the remainder can hold a block of its own and
+ * merged with their neighbours when freed. The header in front of an
+ * allocated block marks it with the top bit of its size, so a free of a
+ * block not allocated here, or freed twice, is caught. As in heap_4 the
+ * scheduler is suspended around list updates: the heaps are not usable from
+ * interrupts.
+ */
+#include "RegionHeap.h"
+#include "task.h"
+#include <string.h>
+
+/* Bounds of the AXI SRAM, which holds the FreeRTOS heap */
+#define REGION_HEAP_AXI_START          0x24000000u
+#define REGION_HEAP_AXI_END            0x24050000u
+
+/* Header of a block, free or allocated */
+typedef struct RegionBlock
+{
+    struct RegionBlock *pxNext;     /* Next free block, by address */
+    size_t xSize;                   /* Including the header; top bit set when allocated */
+} RegionBlock_t;
+
+typedef struct
+{
+    HeapRegion_t xRegion;           /* Memory of the heap, as described to heap_5 */
+    RegionBlock_t xStart;           /* Head of the free list */
+    RegionBlock_t *pxEnd;           /* End marker, at the top of the region */
+    size_t xFree;
+    size_t xMinFree;
+    size_t xAllocations;
+    size_t xFrees;
+} RegionHeapState_t;
+
+#define REGION_HEAP_HEADER_SIZE \
+    ((sizeof(RegionBlock_t) + (portBYTE_ALIGNMENT - 1)) & ~((size_t) portBYTE_ALIGNMENT_MASK))
+#define REGION_HEAP_MIN_BLOCK          (REGION_HEAP_HEADER_SIZE * 2)
+#define REGION_HEAP_ALLOCATED          ((size_t) 1 << ((sizeof(size_t) * 8) - 1))
+
+static uint8_t ucDtcmHeap[REGION_HEAP_DTCM_SIZE]
+    __attribute__((section(REGION_HEAP_DTCM_SECTION), aligned(portBYTE_ALIGNMENT)));
+static uint8_t ucD3Heap[REGION_HEAP_D3_SIZE]
+    __attribute__((section(REGION_HEAP_D3_SECTION), aligned(portBYTE_ALIGNMENT)));
+
+/* The heaps of the DTCM and of the D3 SRAM; the D1 one is heap_4 */
+static RegionHeapState_t xDtcmHeap = { .xRegion = { ucDtcmHeap, sizeof(ucDtcmHeap) } };
+static RegionHeapState_t xD3Heap = { .xRegion = { ucD3Heap, sizeof(ucD3Heap) } };
+
+static const char * const pcRegionNames[eRegionHeapCount] = { "dtcm", "d1-axi", "d3-sram4" };
+
+static RegionHeapState_t *prvHeap(RegionHeapId_t eRegion)
+{
+    switch (eRegion)
+    {
+    case eRegionHeapDtcm:
+        return &xDtcmHeap;
+    case eRegionHeapD3:
+        return &xD3Heap;
+    default:
+        return NULL;
+    }
+}
+
+/* One free block spanning the region, then the end marker. The sections
+ * are not zeroed at start, so nothing is assumed of their content */
+static void prvHeapInit(RegionHeapState_t *pxHeap)
+{
+    uintptr_t xStart = (uintptr_t) pxHeap->xRegion.pucStartAddress;
+    uintptr_t xEnd = xStart + pxHeap->xRegion.xSizeInBytes;
+    RegionBlock_t *pxFirst;
+
+    xStart = (xStart + portBYTE_ALIGNMENT_MASK) & ~((uintptr_t) portBYTE_ALIGNMENT_MASK);
+    xEnd = (xEnd - REGION_HEAP_HEADER_SIZE) & ~((uintptr_t) portBYTE_ALIGNMENT_MASK);
+
+    pxHeap->pxEnd = (RegionBlock_t *) xEnd;
+    pxHeap->pxEnd->pxNext = NULL;
+    pxHeap->pxEnd->xSize = 0;
+
+    pxFirst = (RegionBlock_t *) xStart;
+    pxFirst->xSize = xEnd - xStart;
+    pxFirst->pxNext = pxHeap->pxEnd;
+
+    pxHeap->xStart.pxNext = pxFirst;
+    pxHeap->xStart.xSize = 0;
+    pxHeap->xFree = pxFirst->xSize;
+    pxHeap->xMinFree = pxFirst->xSize;
+}
+
+/* Insert a block in the free list, merged with the blocks it touches */
+static void prvInsertFree(RegionHeapState_t *pxHeap, RegionBlock_t *pxBlock)
+{
+    RegionBlock_t *pxPrev = &pxHeap->xStart;
+
+    while (pxPrev->pxNext < pxBlock)
+    {
+        pxPrev = pxPrev->pxNext;
+    }
+
+    if (pxPrev != &pxHeap->xStart && ((uint8_t *) pxPrev + pxPrev->xSize) == (uint8_t *) pxBlock)
+    {
+        pxPrev->xSize += pxBlock->xSize;
+        pxBlock = pxPrev;
+    }
+
+    if (((uint8_t *) pxBlock + pxBlock->xSize) == (uint8_t *) pxPrev->pxNext && pxPrev->pxNext != pxHeap->pxEnd)
+    {
+        pxBlock->xSize += pxPrev->pxNext->xSize;
+        pxBlock->pxNext = pxPrev->pxNext->pxNext;
+    }
+    else
+    {
+        pxBlock->pxNext = pxPrev->pxNext;
+    }
+
+    if (pxPrev != pxBlock)
+    {
+        pxPrev->pxNext = pxBlock;
+    }
+}
+
+void *pvRegionHeapAlloc(RegionHeapId_t eRegion, size_t xSize)
+{
+    RegionHeapState_t *pxHeap;
+    RegionBlock_t *pxPrev;
+    RegionBlock_t *pxBlock;
+    RegionBlock_t *pxRest;
+    size_t xWanted;
+    void *pvBlock = NULL;
+
+    if (eRegion == eRegionHeapD1)
+    {
+        return pvPortMalloc(xSize);
+    }
+
+    pxHeap = prvHeap(eRegion);
+    if (pxHeap == NULL || xSize == 0 || xSize > pxHeap->xRegion.xSizeInBytes)
+    {
+        return NULL;
+    }
+
+    xWanted = (xSize + REGION_HEAP_HEADER_SIZE + portBYTE_ALIGNMENT_MASK) & ~((size_t) portBYTE_ALIGNMENT_MASK);
+
+    vTaskSuspendAll();
+    {
+        if (pxHeap->pxEnd == NULL)
+        {
+            prvHeapInit(pxHeap);
+        }
+
+        if (xWanted <= pxHeap->xFree)
+        {
+            /* First fit */
+            pxPrev = &pxHeap->xStart;
+            pxBlock = pxHeap->xStart.pxNext;
+            while (pxBlock->xSize < xWanted && pxBlock->pxNext != NULL)
+            {
+                pxPrev = pxBlock;
+                pxBlock = pxBlock->pxNext;
+            }
+
+            if (pxBlock != pxHeap->pxEnd)
+            {
+                pxPrev->pxNext = pxBlock->pxNext;
+
+                /* Split off what the request leaves, if it makes a block */
+                if ((pxBlock->xSize - xWanted) > REGION_HEAP_MIN_BLOCK)
+                {
+                    pxRest = (RegionBlock_t *) ((uint8_t *) pxBlock + xWanted);
+                    pxRest->xSize = pxBlock->xSize - xWanted;
+                    pxBlock->xSize = xWanted;
+                    prvInsertFree(pxHeap, pxRest);
+                }
+
+                pxHeap->xFree -= pxBlock->xSize;
+                if (pxHeap->xFree < pxHeap->xMinFree)
+                {
+                    pxHeap->xMinFree = pxHeap->xFree;
+                }
+
+                pxBlock->xSize |= REGION_HEAP_ALLOCATED;
+                pxBlock->pxNext = NULL;
+                pxHeap->xAllocations++;
+                pvBlock = (uint8_t *) pxBlock + REGION_HEAP_HEADER_SIZE;
+            }
+        }
+    }
+    (void) xTaskResumeAll();
+
+    return pvBlock;
+}
+
+void vRegionHeapFree(void *pv)
+{
+    RegionHeapState_t *pxHeap;
+    RegionBlock_t *pxBlock;
+
+    if (pv == NULL)
+    {
+        return;
+    }
+
+    pxHeap = prvHeap(eRegionHeapOf(pv));
+    if (pxHeap == NULL)
+    {
+        vPortFree(pv);
+        return;
+    }
+
+    pxBlock = (RegionBlock_t *) ((uint8_t *) pv - REGION_HEAP_HEADER_SIZE);
+    configASSERT((pxBlock->xSize & REGION_HEAP_ALLOCATED) != 0);
+    configASSERT(pxBlock->pxNext == NULL);
+
+    if ((pxBlock->xSize & REGION_HEAP_ALLOCATED) != 0 && pxBlock->pxNext == NULL)
+    {
+        pxBlock->xSize &= ~REGION_HEAP_ALLOCATED;
+
+        vTaskSuspendAll();
+        {
+            pxHeap->xFree += pxBlock->xSize;
+            prvInsertFree(pxHeap, pxBlock);
+            pxHeap->xFrees++;
+        }
+        (void) xTaskResumeAll();
+    }
+}
+
+RegionHeapId_t eRegionHeapOf(const void *pv)
+{
+    const uint8_t *puc = (const uint8_t *) pv;
+
+    if (puc >= ucDtcmHeap && puc < ucDtcmHeap + sizeof(ucDtcmHeap))
+    {
+        return eRegionHeapDtcm;
+    }
+    else if (puc >= ucD3Heap && puc < ucD3Heap + sizeof(ucD3Heap))
+    {
+        return eRegionHeapD3;
+    }
+    else if ((uintptr_t) puc >= REGION_HEAP_AXI_START && (uintptr_t) puc < REGION_HEAP_AXI_END)
+    {
+        return eRegionHeapD1;
+    }
+
+    return eRegionHeapCount;
+}
+
+void vRegionHeapGetStats(RegionHeapId_t eRegion, HeapStats_t *pxStats)
+{
+    RegionHeapState_t *pxHeap;
+    RegionBlock_t *pxBlock;
+
+    if (eRegion == eRegionHeapD1)
+    {
+        vPortGetHeapStats(pxStats);
+        return;
+    }
+
+    memset(pxStats, 0, sizeof(*pxStats));
+
+    pxHeap = prvHeap(eRegion);
+    if (pxHeap == NULL)
+    {
+        return;
+    }
+
+    vTaskSuspendAll();
+    {
+        if (pxHeap->pxEnd == NULL)
+        {
+            prvHeapInit(pxHeap);
+        }
+
+        pxStats->xSizeOfSmallestFreeBlockInBytes = SIZE_MAX;
+        for (pxBlock = pxHeap->xStart.pxNext; pxBlock != pxHeap->pxEnd; pxBlock = pxBlock->pxNext)
+        {
+            pxStats->xNumberOfFreeBlocks++;
+            if (pxBlock->xSize > pxStats->xSizeOfLargestFreeBlockInBytes)
+            {
+                pxStats->xSizeOfLargestFreeBlockInBytes = pxBlock->xSize;
+            }
+            if (pxBlock->xSize < pxStats->xSizeOfSmallestFreeBlockInBytes)
+            {
+                pxStats->xSizeOfSmallestFreeBlockInBytes = pxBlock->xSize;
+            }
+        }
+        if (pxStats->xNumberOfFreeBlocks == 0)
+        {
+            pxStats->xSizeOfSmallestFreeBlockInBytes = 0;
+        }
+
+        pxStats->xAvailableHeapSpaceInBytes = pxHeap->xFree;
+        pxStats->xMinimumEverFreeBytesRemaining = pxHeap->xMinFree;
+        pxStats->xNumberOfSuccessfulAllocations = pxHeap->xAllocations;
+        pxStats->xNumberOfSuccessfulFrees = pxHeap->xFrees;
+    }
+    (void) xTaskResumeAll();
+}
+
+size_t xRegionHeapGetSize(RegionHeapId_t eRegion)
+{
+    RegionHeapState_t *pxHeap = prvHeap(eRegion);
+
+    if (eRegion == eRegionHeapD1)
+    {
+        return configTOTAL_HEAP_SIZE;
+    }
+
+    return (pxHeap != NULL) ? pxHeap->xRegion.xSizeInBytes : 0;
+}
+
+const char *pcRegionHeapName(RegionHeapId_t eRegion)
+{
+    return (eRegion < eRegionHeapCount) ? pcRegionNames[eRegion] : "none";
+}
@@ -0,0 +1,366 @@
+/* ResourceMonitor.c
+ *
+ * Periodic sampling of stacks, heaps, network pool, sockets and serial
+ * streams (see ResourceMonitor.h). The sample is built in the monitor task
+ * and copied under a mutex, so that "resources" prints a consistent one.
+ */
+#include "ResourceMonitor.h"
+#include "task.h"
+#include "semphr.h"
+#include "stream_buffer.h"
+#include "FreeRTOS_CLI.h"
+#include "StaticAlloc.h"
+#include "RegionHeap.h"
+#include "TlsfHeap.h"
+#include "SerialTask.h"
+#include "CyphalNode.h"
+#include "core/net.h"
+#include "core/socket.h"
+#include <stdio.h>
+#include <string.h>
+
+/* uavcan.diagnostic.Severity.1.0 */
+#define DIAGNOSTIC_SEVERITY_INFO       2u
+#define DIAGNOSTIC_SEVERITY_WARNING    4u
+
+/* Text of a diagnostic record, at most; the type allows 255 bytes */
+#define DIAGNOSTIC_TEXT_SIZE           112u
+
+/* Timestamp (uint56), severity, text length, then the text */
+#define DIAGNOSTIC_HEADER_SIZE         9u
+
+/* Serial stream buffer and TX ring, in the order of xStreams */
+#define RESOURCE_STREAM_SERIAL_RX      0
+#define RESOURCE_STREAM_SERIAL_TX      1
+#define RESOURCE_STREAM_COUNT          2
+
+typedef struct
+{
+    char cName[configMAX_TASK_NAME_LEN];
+    uint32_t ulFreeWords;       /* Stack high-water mark */
+} ResourceTask_t;
+
+typedef struct
+{
+    size_t xSize;
+    size_t xFree;
+    size_t xMinFree;
+} ResourceHeap_t;
+
+typedef struct
+{
+    size_t xSize;
+    size_t xUsed;
+    size_t xPeak;
+} ResourceGauge_t;
+
+typedef struct
+{
+    uint32_t ulSamples;
+    UBaseType_t uxTasks;
+    ResourceTask_t xTasks[RESOURCE_MONITOR_MAX_TASKS];
+    ResourceHeap_t xHeaps[eRegionHeapCount];
+    ResourceHeap_t xTlsf;
+    ResourceGauge_t xPool;      /* Blocks of the network memory pool */
+    ResourceGauge_t xSockets;
+    ResourceGauge_t xStreams[RESOURCE_STREAM_COUNT];
+} ResourceSample_t;
+
+static const char * const pcStreamNames[RESOURCE_STREAM_COUNT] = { "serial-rx", "serial-tx" };
+
+static TaskHandle_t xMonitorTask = NULL;
+APP_TASK_STORAGE(xMonitorTask, RESOURCE_MONITOR_STACK_SIZE);
+static SemaphoreHandle_t xSampleMutex = NULL;
+APP_MUTEX_STORAGE(xSampleMutex);
+
+/* Last sample, and the one being built and printed */
+static ResourceSample_t xSample;
+static ResourceSample_t xWork;
+static TaskStatus_t xTaskStatus[RESOURCE_MONITOR_MAX_TASKS];
+
+/* Peaks seen by sampling, kept across samples */
+static size_t xSocketPeak = 0;
+static size_t xStreamPeak[RESOURCE_STREAM_COUNT];
+
+static UBaseType_t uxResourcesLine = 0;
+
+static BaseType_t prvResourcesCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xResources =
+{
+    "resources",
+    "\r\nresources:\r\n Stack high-water marks, heaps, network pool, sockets and stream buffers\r\n",
+    prvResourcesCommand,
+    0
+};
+
+static void prvSampleTasks(ResourceSample_t *pxSample)
+{
+    ResourceTask_t xTask;
+    UBaseType_t uxCount;
+    UBaseType_t i, j;
+
+    uxCount = uxTaskGetSystemState(xTaskStatus, RESOURCE_MONITOR_MAX_TASKS, NULL);
+
+    /* Insertion sort, least stack left first */
+    for (i = 0; i < uxCount; i++)
+    {
+        strncpy(xTask.cName, xTaskStatus[i].pcTaskName, sizeof(xTask.cName) - 1);
+        xTask.cName[sizeof(xTask.cName) - 1] = '\0';
+        xTask.ulFreeWords = xTaskStatus[i].usStackHighWaterMark;
+
+        for (j = i; j > 0 && pxSample->xTasks[j - 1].ulFreeWords > xTask.ulFreeWords; j--)
+        {
+            pxSample->xTasks[j] = pxSample->xTasks[j - 1];
+        }
+        pxSample->xTasks[j] = xTask;
+    }
+    pxSample->uxTasks = uxCount;
+}
+
+static void prvSampleHeaps(ResourceSample_t *pxSample)
+{
+    HeapStats_t xStats;
+    TlsfHeapStats_t xTlsf;
+    UBaseType_t i;
+
+    for (i = 0; i < eRegionHeapCount; i++)
+    {
+        vRegionHeapGetStats((RegionHeapId_t) i, &xStats);
+        pxSample->xHeaps[i].xSize = xRegionHeapGetSize((RegionHeapId_t) i);
+        pxSample->xHeaps[i].xFree = xStats.xAvailableHeapSpaceInBytes;
+        pxSample->xHeaps[i].xMinFree = xStats.xMinimumEverFreeBytesRemaining;
+    }
+
+    vTlsfHeapGetStats(&xTlsf);
+    pxSample->xTlsf.xSize = xTlsf.xSize;
+    pxSample->xTlsf.xFree = xTlsf.xFree;
+    pxSample->xTlsf.xMinFree = xTlsf.xMinFree;
+}
+
+static void prvSampleNetwork(ResourceSample_t *pxSample)
+{
+    uint_t uxCurrent;
+    uint_t uxPeak;
+    uint_t uxSize;
+    size_t xSockets = 0;
+    UBaseType_t i;
+
+    memPoolGetStats(&uxCurrent, &uxPeak, &uxSize);
+    pxSample->xPool.xUsed = uxCurrent;
+    pxSample->xPool.xPeak = uxPeak;
+    pxSample->xPool.xSize = uxSize;
+
+    osAcquireMutex(&netMutex);
+    for (i = 0; i < SOCKET_MAX_COUNT; i++)
+    {
+        if (socketTable[i].type != SOCKET_TYPE_UNUSED)
+        {
+            xSockets++;
+        }
+    }
+    osReleaseMutex(&netMutex);
+
+    xSocketPeak = MAX(xSocketPeak, xSockets);
+    pxSample->xSockets.xUsed = xSockets;
+    pxSample->xSockets.xPeak = xSocketPeak;
+    pxSample->xSockets.xSize = SOCKET_MAX_COUNT;
+}
+
+static void prvSampleStreams(ResourceSample_t *pxSample)
+{
+    StreamBufferHandle_t xStream = xSerialTaskGetRxStreamHandle();
+    ResourceGauge_t *pxGauge = &pxSample->xStreams[RESOURCE_STREAM_SERIAL_RX];
+    SerialTxStats_t xTxStats;
+    size_t xUsed;
+
+    memset(pxGauge, 0, sizeof(*pxGauge));
+    if (xStream != NULL)
+    {
+        xUsed = xStreamBufferBytesAvailable(xStream);
+        xStreamPeak[RESOURCE_STREAM_SERIAL_RX] = MAX(xStreamPeak[RESOURCE_STREAM_SERIAL_RX], xUsed);
+        pxGauge->xUsed = xUsed;
+        pxGauge->xPeak = xStreamPeak[RESOURCE_STREAM_SERIAL_RX];
+        pxGauge->xSize = xUsed + xStreamBufferSpacesAvailable(xStream);
+    }
+
+    /* The TX ring is no stream buffer; the TX task keeps its own peak */
+    vSerialTaskGetTxStats(&xTxStats);
+    pxGauge = &pxSample->xStreams[RESOURCE_STREAM_SERIAL_TX];
+    xStreamPeak[RESOURCE_STREAM_SERIAL_TX] = MAX(xStreamPeak[RESOURCE_STREAM_SERIAL_TX],
+                                                 MAX(xTxStats.xUsed, xTxStats.xPeak));
+    pxGauge->xUsed = xTxStats.xUsed;
+    pxGauge->xPeak = xStreamPeak[RESOURCE_STREAM_SERIAL_TX];
+    pxGauge->xSize = SERIAL_TASK_TX_RING_SIZE;
+}
+
+/* A one-line summary: the task with the least stack left, the lowest free
+ * bytes of the FreeRTOS heap and the peaks of the pool and of the sockets */
+static BaseType_t prvSummary(const ResourceSample_t *pxSample, char *pcBuffer, size_t xLength)
+{
+    const ResourceTask_t *pxTask = &pxSample->xTasks[0];
+    BaseType_t xWarning;
+
+    xWarning = (pxSample->uxTasks > 0 && pxTask->ulFreeWords < RESOURCE_MONITOR_STACK_MARGIN) ||
+               (pxSample->xPool.xPeak >= pxSample->xPool.xSize);
+
+    snprintf(pcBuffer, xLength, "stack %s %luw, heap min %lu/%lu, pool peak %lu/%lu, sockets peak %lu/%lu",
+             (pxSample->uxTasks > 0) ? pxTask->cName : "-",
+             (unsigned long) ((pxSample->uxTasks > 0) ? pxTask->ulFreeWords : 0),
+             (unsigned long) pxSample->xHeaps[eRegionHeapD1].xMinFree,
+             (unsigned long) pxSample->xHeaps[eRegionHeapD1].xSize,
+             (unsigned long) pxSample->xPool.xPeak, (unsigned long) pxSample->xPool.xSize,
+             (unsigned long) pxSample->xSockets.xPeak, (unsigned long) pxSample->xSockets.xSize);
+
+    return xWarning;
+}
+
+/* uavcan.diagnostic.Record.1.1, with an unknown timestamp */
+static void prvPublish(const ResourceSample_t *pxSample)
+{
+    static UdpardTransferID xTransferId = 0;
+    uint8_t ucRecord[DIAGNOSTIC_HEADER_SIZE + DIAGNOSTIC_TEXT_SIZE];
+    char cText[DIAGNOSTIC_TEXT_SIZE + 1];
+    BaseType_t xWarning;
+    size_t xText;
+
+    xWarning = prvSummary(pxSample, cText, sizeof(cText));
+    xText = strlen(cText);
+
+    memset(ucRecord, 0, 7);
+    ucRecord[7] = (xWarning != pdFALSE) ? DIAGNOSTIC_SEVERITY_WARNING : DIAGNOSTIC_SEVERITY_INFO;
+    ucRecord[8] = (uint8_t) xText;
+    memcpy(&ucRecord[DIAGNOSTIC_HEADER_SIZE], cText, xText);
+
+    (void) xCyphalNodePublish(RESOURCE_MONITOR_SUBJECT_ID, UdpardPriorityOptional, &xTransferId,
+                              ucRecord, DIAGNOSTIC_HEADER_SIZE + xText,
+                              RESOURCE_MONITOR_PERIOD_MS * 1000u);
+}
+
+static void prvResourceMonitorTask(void *pvParameters)
+{
+    TickType_t xLastWake = xTaskGetTickCount();
+
+    (void) pvParameters;
+
+    for (;;)
+    {
+        memset(&xWork, 0, sizeof(xWork));
+        prvSampleTasks(&xWork);
+        prvSampleHeaps(&xWork);
+        prvSampleNetwork(&xWork);
+        prvSampleStreams(&xWork);
+
+        xSemaphoreTake(xSampleMutex, portMAX_DELAY);
+        xWork.ulSamples = xSample.ulSamples + 1;
+        xSample = xWork;
+        xSemaphoreGive(xSampleMutex);
+
+        if (RESOURCE_MONITOR_PUBLISH_EVERY > 0 && ((xWork.ulSamples - 1) % RESOURCE_MONITOR_PUBLISH_EVERY) == 0)
+        {
+            prvPublish(&xWork);
+        }
+
+        vTaskDelayUntil(&xLastWake, pdMS_TO_TICKS(RESOURCE_MONITOR_PERIOD_MS));
+    }
+}
+
+BaseType_t xResourceMonitorStart(UBaseType_t uxPriority)
+{
+    xSampleMutex = xAppSemaphoreCreateMutex(xSampleMutex);
+    if (xSampleMutex == NULL)
+    {
+        return pdFAIL;
+    }
+
+    return xAppTaskCreate(xMonitorTask, prvResourceMonitorTask, "Resources", RESOURCE_MONITOR_STACK_SIZE,
+                          NULL, uxPriority, &xMonitorTask);
+}
+
+void vResourceMonitorRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xResources);
+}
+
+/* Bytes used of a heap, as a percentage of its size */
+static unsigned long prvPercent(size_t xUsed, size_t xSize)
+{
+    return (xSize > 0) ? (unsigned long) ((xUsed * 100u) / xSize) : 0;
+}
+
+/* "resources": the header, a line per task, then heaps, pool, sockets and
+ * streams. The sample is copied at the first line */
+static BaseType_t prvResourcesCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    static ResourceSample_t xShown;
+    const ResourceHeap_t *pxHeap;
+    const ResourceGauge_t *pxGauge;
+    UBaseType_t uxLine;
+    UBaseType_t uxLast;
+    char cSummary[DIAGNOSTIC_TEXT_SIZE + 1];
+
+    (void) pcCommandString;
+
+    if (uxResourcesLine == 0)
+    {
+        if (xSampleMutex == NULL || xSemaphoreTake(xSampleMutex, pdMS_TO_TICKS(100)) != pdTRUE)
+        {
+            snprintf(pcWriteBuffer, xWriteBufferLen, "No sample\r\n");
+            return pdFALSE;
+        }
+        xShown = xSample;
+        xSemaphoreGive(xSampleMutex);
+
+        (void) prvSummary(&xShown, cSummary, sizeof(cSummary));
+        snprintf(pcWriteBuffer, xWriteBufferLen, "\r\nSample %lu: %s\r\nTask             Stack free (words)\r\n",
+                 (unsigned long) xShown.ulSamples, cSummary);
+        uxResourcesLine++;
+        return pdTRUE;
+    }
+
+    uxLine = uxResourcesLine - 1;
+    uxLast = xShown.uxTasks + eRegionHeapCount + 1 + 2 + RESOURCE_STREAM_COUNT;
+
+    if (uxLine < xShown.uxTasks)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "%-16s %5lu%s\r\n", xShown.xTasks[uxLine].cName,
+                 (unsigned long) xShown.xTasks[uxLine].ulFreeWords,
+                 (xShown.xTasks[uxLine].ulFreeWords < RESOURCE_MONITOR_STACK_MARGIN) ? "  LOW" : "");
+    }
+    else if ((uxLine -= xShown.uxTasks) <= eRegionHeapCount)
+    {
+        pxHeap = (uxLine < eRegionHeapCount) ? &xShown.xHeaps[uxLine] : &xShown.xTlsf;
+        snprintf(pcWriteBuffer, xWriteBufferLen, "heap %-6s %6lu free, %6lu lowest of %6lu (%lu%% peak use)\r\n",
+                 (uxLine < eRegionHeapCount) ? pcRegionHeapName((RegionHeapId_t) uxLine) : "tlsf",
+                 (unsigned long) pxHeap->xFree, (unsigned long) pxHeap->xMinFree, (unsigned long) pxHeap->xSize,
+                 prvPercent(pxHeap->xSize - pxHeap->xMinFree, pxHeap->xSize));
+    }
+    else
+    {
+        uxLine -= eRegionHeapCount + 1;
+        if (uxLine == 0)
+        {
+            pxGauge = &xShown.xPool;
+        }
+        else if (uxLine == 1)
+        {
+            pxGauge = &xShown.xSockets;
+        }
+        else
+        {
+            pxGauge = &xShown.xStreams[uxLine - 2];
+        }
+
+        snprintf(pcWriteBuffer, xWriteBufferLen, "%-11s %6lu used, %6lu peak of %6lu\r\n",
+                 (uxLine == 0) ? "net-pool" : (uxLine == 1) ? "sockets" : pcStreamNames[uxLine - 2],
+                 (unsigned long) pxGauge->xUsed, (unsigned long) pxGauge->xPeak, (unsigned long) pxGauge->xSize);
+    }
+
+    if (uxResourcesLine++ >= uxLast)
+    {
+        uxResourcesLine = 0;
+        return pdFALSE;
+    }
+
+    return pdTRUE;
+}
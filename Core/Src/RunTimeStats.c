@@ -0,0 +1,301 @@
+/* RunTimeStats.c
+ *
+ * Run-time statistics based on the Cortex-M7 DWT cycle counter. CYCCNT is
+ * extended to 64 bits in software; FreeRTOS gets a RUN_TIME_STATS_COUNTER_HZ
+ * view of it for per-task accounting, and instrumented interrupt handlers
+ * accumulate their own cycle counts.
+ *
+ * The core clock may change at run time (ClockGovernor.h): the FreeRTOS
+ * counter is then folded at the change, so that it keeps counting time
+ * rather than cycles. Interrupt shares are ratios of cycles, weighted by
+ * the clock of the moment.
+ */
+#include "RunTimeStats.h"
+#include "TraceRecorderHooks.h"
+#include "stm32h7xx_hal.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Software extension of the 32-bit cycle counter */
+static uint32_t ulCyclesHigh = 0;
+static uint32_t ulCyclesLast = 0;
+
+/* CPU cycles per FreeRTOS run-time counter unit, at the current clock */
+static uint32_t ulCyclesPerCount = 1;
+
+/* Counter value and cycle count at the last change of the clock */
+static uint64_t ullCountBase = 0;
+static uint64_t ullCyclesBase = 0;
+
+/* Interrupt accounting, each source is only written by its own handler */
+static uint32_t ulIsrStart[RUN_TIME_STATS_ISR_COUNT];
+static volatile uint64_t ullIsrCycles[RUN_TIME_STATS_ISR_COUNT];
+static volatile uint32_t ulIsrCount[RUN_TIME_STATS_ISR_COUNT];
+
+static const char * const pcIsrNames[RUN_TIME_STATS_ISR_COUNT] =
+{
+    "ISR ETH",
+    "ISR USART3",
+    "ISR TIM23",
+    "ISR USART2",
+    "ISR USART6",
+    "ISR ADC"
+};
+
+/* "cpu-stats" state: the previous snapshot and the report being printed */
+static struct
+{
+    UBaseType_t uxTaskNumber;
+    uint32_t ulRunTime;
+} xPrevTasks[RUN_TIME_STATS_MAX_TASKS];
+static UBaseType_t uxPrevTaskCount = 0;
+static uint64_t ullPrevCycles = 0;
+static uint32_t ulPrevCounts = 0;
+static uint64_t ullPrevIsrCycles[RUN_TIME_STATS_ISR_COUNT];
+static uint32_t ulPrevIsrCount[RUN_TIME_STATS_ISR_COUNT];
+
+static TaskStatus_t xTaskStatus[RUN_TIME_STATS_MAX_TASKS];
+static uint32_t ulTaskPermille[RUN_TIME_STATS_MAX_TASKS];
+static uint32_t ulIsrPermille[RUN_TIME_STATS_ISR_COUNT];
+static uint32_t ulIsrEvents[RUN_TIME_STATS_ISR_COUNT];
+static UBaseType_t uxReportTasks = 0;
+static UBaseType_t uxReportLine = 0;
+static uint32_t ulReportWindowMs = 0;
+
+static BaseType_t prvCpuStatsCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xCpuStats =
+{
+    "cpu-stats",
+    "\r\ncpu-stats:\r\n CPU usage per task and interrupt since the previous cpu-stats\r\n",
+    prvCpuStatsCommand,
+    0
+};
+
+void configureTimerForRunTimeStats(void)
+{
+    /* Enable the trace block, unlock and start the cycle counter */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->LAR = 0xC5ACCE55;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    ulCyclesHigh = 0;
+    ulCyclesLast = 0;
+    ullCountBase = 0;
+    ullCyclesBase = 0;
+
+    ulCyclesPerCount = SystemCoreClock / RUN_TIME_STATS_COUNTER_HZ;
+    if (ulCyclesPerCount == 0)
+    {
+        ulCyclesPerCount = 1;
+    }
+}
+
+void vRunTimeStatsClockChanged(void)
+{
+    uint64_t ullCycles = ullRunTimeStatsGetCycles();
+
+    /* The cycles since the last change counted at the former rate */
+    ullCountBase += (ullCycles - ullCyclesBase) / ulCyclesPerCount;
+    ullCyclesBase = ullCycles;
+
+    ulCyclesPerCount = SystemCoreClock / RUN_TIME_STATS_COUNTER_HZ;
+    if (ulCyclesPerCount == 0)
+    {
+        ulCyclesPerCount = 1;
+    }
+}
+
+uint64_t ullRunTimeStatsGetCycles(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint32_t now;
+    uint64_t value;
+
+    /* Usable from tasks, interrupts and the kernel's own critical sections */
+    __disable_irq();
+
+    now = DWT->CYCCNT;
+    if (now < ulCyclesLast)
+    {
+        ulCyclesHigh++;
+    }
+    ulCyclesLast = now;
+    value = ((uint64_t) ulCyclesHigh << 32) | now;
+
+    __set_PRIMASK(primask);
+
+    return value;
+}
+
+unsigned long getRunTimeCounterValue(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint64_t value;
+
+    __disable_irq();
+    value = ullCountBase + (ullRunTimeStatsGetCycles() - ullCyclesBase) / ulCyclesPerCount;
+    __set_PRIMASK(primask);
+
+    return (unsigned long) value;
+}
+
+void vRunTimeStatsTickHook(void)
+{
+    /* Observe every wrap of CYCCNT (every ~7.8 s at 550 MHz) */
+    (void) ullRunTimeStatsGetCycles();
+}
+
+void vRunTimeStatsIsrEnter(uint32_t ulSource)
+{
+#if (TRACE_RECORDER == 1)
+    vTraceRecorderIsrEnter(ulSource);
+#endif
+    ulIsrStart[ulSource] = DWT->CYCCNT;
+}
+
+void vRunTimeStatsIsrExit(uint32_t ulSource)
+{
+    ullIsrCycles[ulSource] += DWT->CYCCNT - ulIsrStart[ulSource];
+    ulIsrCount[ulSource]++;
+#if (TRACE_RECORDER == 1)
+    vTraceRecorderIsrExit(ulSource);
+#endif
+}
+
+void vRunTimeStatsRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xCpuStats);
+}
+
+/* Share of a window, in tenths of a percent */
+static uint32_t prvPermille(uint64_t ullPart, uint64_t ullWhole)
+{
+    return (ullWhole > 0) ? (uint32_t) ((ullPart * 1000u) / ullWhole) : 0;
+}
+
+void vRunTimeStatsGetLoadSample(RunTimeLoadSample_t *pxSample)
+{
+    taskENTER_CRITICAL();
+    pxSample->ulTotal = getRunTimeCounterValue();
+    pxSample->ulIdle = ulTaskGetIdleRunTimeCounter();
+    taskEXIT_CRITICAL();
+}
+
+uint32_t ulRunTimeStatsLoadPermille(const RunTimeLoadSample_t *pxStart, const RunTimeLoadSample_t *pxEnd)
+{
+    uint32_t ulTotal = pxEnd->ulTotal - pxStart->ulTotal;
+    uint32_t ulIdle = pxEnd->ulIdle - pxStart->ulIdle;
+
+    if (ulTotal == 0 || ulIdle > ulTotal)
+    {
+        return 0;
+    }
+
+    return 1000u - prvPermille(ulIdle, ulTotal);
+}
+
+/* Take a snapshot, compute the usage since the previous one and keep it as the new reference */
+static void prvCpuStatsSnapshot(void)
+{
+    uint64_t ullNow;
+    uint64_t ullWindow;
+    uint64_t ullIsr[RUN_TIME_STATS_ISR_COUNT];
+    uint32_t ulCount[RUN_TIME_STATS_ISR_COUNT];
+    uint32_t ulWindowCounts;
+    uint32_t ulNowCounts;
+    uint32_t ulPrev;
+    UBaseType_t i, j;
+
+    uxReportTasks = uxTaskGetSystemState(xTaskStatus, RUN_TIME_STATS_MAX_TASKS, NULL);
+
+    taskENTER_CRITICAL();
+    ullNow = ullRunTimeStatsGetCycles();
+    ulNowCounts = (uint32_t) getRunTimeCounterValue();
+    for (i = 0; i < RUN_TIME_STATS_ISR_COUNT; i++)
+    {
+        ullIsr[i] = ullIsrCycles[i];
+        ulCount[i] = ulIsrCount[i];
+    }
+    taskEXIT_CRITICAL();
+
+    ullWindow = ullNow - ullPrevCycles;
+    ulWindowCounts = ulNowCounts - ulPrevCounts;
+    ulReportWindowMs = ulWindowCounts / (RUN_TIME_STATS_COUNTER_HZ / 1000u);
+
+    /* Tasks: run time accumulated since the previous snapshot */
+    for (i = 0; i < uxReportTasks; i++)
+    {
+        ulPrev = 0;
+        for (j = 0; j < uxPrevTaskCount; j++)
+        {
+            if (xPrevTasks[j].uxTaskNumber == xTaskStatus[i].xTaskNumber)
+            {
+                ulPrev = xPrevTasks[j].ulRunTime;
+                break;
+            }
+        }
+        ulTaskPermille[i] = prvPermille(xTaskStatus[i].ulRunTimeCounter - ulPrev, ulWindowCounts);
+    }
+
+    for (i = 0; i < RUN_TIME_STATS_ISR_COUNT; i++)
+    {
+        ulIsrPermille[i] = prvPermille(ullIsr[i] - ullPrevIsrCycles[i], ullWindow);
+        ulIsrEvents[i] = ulCount[i] - ulPrevIsrCount[i];
+        ullPrevIsrCycles[i] = ullIsr[i];
+        ulPrevIsrCount[i] = ulCount[i];
+    }
+
+    for (i = 0; i < uxReportTasks; i++)
+    {
+        xPrevTasks[i].uxTaskNumber = xTaskStatus[i].xTaskNumber;
+        xPrevTasks[i].ulRunTime = xTaskStatus[i].ulRunTimeCounter;
+    }
+    uxPrevTaskCount = uxReportTasks;
+    ullPrevCycles = ullNow;
+    ulPrevCounts = ulNowCounts;
+}
+
+/* "cpu-stats": one line per call, tasks first, then interrupt sources */
+static BaseType_t prvCpuStatsCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    UBaseType_t i;
+
+    (void) pcCommandString;
+
+    if (uxReportLine == 0)
+    {
+        prvCpuStatsSnapshot();
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "\r\nCPU usage over %lu ms\r\nName             CPU%%   Events\r\n",
+                 (unsigned long) ulReportWindowMs);
+    }
+    else if (uxReportLine <= uxReportTasks)
+    {
+        i = uxReportLine - 1;
+        snprintf(pcWriteBuffer, xWriteBufferLen, "%-16s %3lu.%lu\r\n",
+                 xTaskStatus[i].pcTaskName,
+                 (unsigned long) (ulTaskPermille[i] / 10), (unsigned long) (ulTaskPermille[i] % 10));
+    }
+    else
+    {
+        i = uxReportLine - 1 - uxReportTasks;
+        snprintf(pcWriteBuffer, xWriteBufferLen, "%-16s %3lu.%lu   %lu\r\n",
+                 pcIsrNames[i],
+                 (unsigned long) (ulIsrPermille[i] / 10), (unsigned long) (ulIsrPermille[i] % 10),
+                 (unsigned long) ulIsrEvents[i]);
+    }
+
+    /* Done after the last interrupt source */
+    if (++uxReportLine > uxReportTasks + RUN_TIME_STATS_ISR_COUNT)
+    {
+        uxReportLine = 0;
+        return pdFALSE;
+    }
+
+    return pdTRUE;
+}
@@ -32,6 +32,8 @@
 ******************************************************************************/
 
 #include "Sample-CLI-commands.h"
+#include "RegionHeap.h"
+#include "TraceRecorder.h"
 
 #include "stm32h7xx_nucleo.h"
 
@@ -148,7 +150,7 @@ static const CLI_Command_Definition_t xParameterEcho =
     static const CLI_Command_Definition_t xQueryHeap =
     {
         "query-heap",
-        "\r\nquery-heap:\r\n Displays the free heap space, and minimum ever free heap space.\r\n",
+        "\r\nquery-heap:\r\n Displays the free space, minimum ever free space and fragmentation of each heap region.\r\n",
         prvQueryHeapCommand, /* The function to run. */
         0                    /* The user can enter any number of commands. */
     };
@@ -156,14 +158,15 @@ static const CLI_Command_Definition_t xParameterEcho =
 
 #if configINCLUDE_TRACE_RELATED_CLI_COMMANDS == 1
 
-/* Structure that defines the "trace" command line command.  This takes a single
- * parameter, which can be either "start" or "stop". */
+/* Structure that defines the "trace" command line command.  The first
+ * parameter is either "start" or "stop"; "start" may be followed by the address
+ * and UDP port of the host the trace is streamed to. */
     static const CLI_Command_Definition_t xStartStopTrace =
     {
         "trace",
-        "\r\ntrace [start | stop]:\r\n Starts or stops a trace recording for viewing in FreeRTOS+Trace\r\n",
+        "\r\ntrace [start [<ip> [<port>]] | stop]:\r\n Starts or stops a binary event trace streamed over UDP (Tools/trace_decode.py)\r\n",
         prvStartStopTraceCommand, /* The function to run. */
-        1                         /* One parameter is expected.  Valid values are "start" and "stop". */
+        -1                        /* "start" takes an optional host and port. */
     };
 #endif /* configINCLUDE_TRACE_RELATED_CLI_COMMANDS */
 
@@ -179,7 +182,8 @@ void vRegisterSampleCLICommands( void )
 
     #if ( configGENERATE_RUN_TIME_STATS == 1 )
     {
-        FreeRTOS_CLIRegisterCommand( &xRunTimeStats );
+        /* vTaskGetRunTimeStats() ignores xWriteBufferLen; "cpu-stats" (RunTimeStats.c) replaces it */
+        //FreeRTOS_CLIRegisterCommand( &xRunTimeStats );
     }
     #endif
 
@@ -263,17 +267,31 @@ static BaseType_t prvTaskStatsCommand( char * pcWriteBuffer,
                                            size_t xWriteBufferLen,
                                            const char * pcCommandString )
     {
-        /* Remove compile time warnings about unused parameters, and check the
-         * write buffer is not NULL.  NOTE - for simplicity, this example assumes the
-         * write buffer length is adequate, so does not check for buffer overflows. */
+        /* One line per region: the DTCM, D1 (FreeRTOS heap) and D3 heaps */
+        static UBaseType_t uxRegion = 0;
+        HeapStats_t xStats;
+
         ( void ) pcCommandString;
-        ( void ) xWriteBufferLen;
         configASSERT( pcWriteBuffer );
 
-        sprintf( pcWriteBuffer, "Current free heap %d bytes, minimum ever free heap %d bytes\r\n", ( int ) xPortGetFreeHeapSize(), ( int ) xPortGetMinimumEverFreeHeapSize() );
+        vRegionHeapGetStats( ( RegionHeapId_t ) uxRegion, &xStats );
+        snprintf( pcWriteBuffer, xWriteBufferLen,
+                  "%-8s size=%lu free=%lu min-free=%lu largest=%lu free-blocks=%lu allocs=%lu frees=%lu\r\n",
+                  pcRegionHeapName( ( RegionHeapId_t ) uxRegion ),
+                  ( unsigned long ) xRegionHeapGetSize( ( RegionHeapId_t ) uxRegion ),
+                  ( unsigned long ) xStats.xAvailableHeapSpaceInBytes,
+                  ( unsigned long ) xStats.xMinimumEverFreeBytesRemaining,
+                  ( unsigned long ) xStats.xSizeOfLargestFreeBlockInBytes,
+                  ( unsigned long ) xStats.xNumberOfFreeBlocks,
+                  ( unsigned long ) xStats.xNumberOfSuccessfulAllocations,
+                  ( unsigned long ) xStats.xNumberOfSuccessfulFrees );
+
+        if( ++uxRegion < eRegionHeapCount )
+        {
+            return pdTRUE;
+        }
 
-        /* There is no more data to return after this single string, so return
-         * pdFALSE. */
+        uxRegion = 0;
         return pdFALSE;
     }
 
@@ -471,12 +489,9 @@ static BaseType_t prvParameterEchoCommand( char * pcWriteBuffer,
     {
         const char * pcParameter;
         BaseType_t lParameterStringLength;
+        char cAddress[ 16 ];
+        unsigned long ulPort = 0;
 
-        /* Remove compile time warnings about unused parameters, and check the
-         * write buffer is not NULL.  NOTE - for simplicity, this example assumes the
-         * write buffer length is adequate, so does not check for buffer overflows. */
-        ( void ) pcCommandString;
-        ( void ) xWriteBufferLen;
         configASSERT( pcWriteBuffer );
 
         /* Obtain the parameter string. */
@@ -487,28 +502,67 @@ static BaseType_t prvParameterEchoCommand( char * pcWriteBuffer,
             &lParameterStringLength /* Store the parameter string length. */
                       );
 
-        /* Sanity check something was returned. */
-        configASSERT( pcParameter );
-
-        /* There are only two valid parameter values. */
-        if( strncmp( pcParameter, "start", strlen( "start" ) ) == 0 )
+        if( pcParameter == NULL )
         {
+            snprintf( pcWriteBuffer, xWriteBufferLen, "Valid parameters are 'start' and 'stop'.\r\n" );
+        }
+        else if( strncmp( pcParameter, "start", strlen( "start" ) ) == 0 )
+        {
+            /* An optional host, then an optional port. */
+            pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 2, &lParameterStringLength );
+
+            if( pcParameter != NULL )
+            {
+                if( ( size_t ) lParameterStringLength >= sizeof( cAddress ) )
+                {
+                    snprintf( pcWriteBuffer, xWriteBufferLen, "Invalid address.\r\n" );
+                    return pdFALSE;
+                }
+
+                memcpy( cAddress, pcParameter, lParameterStringLength );
+                cAddress[ lParameterStringLength ] = '\0';
+
+                pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 3, &lParameterStringLength );
+                if( pcParameter != NULL )
+                {
+                    ulPort = strtoul( pcParameter, NULL, 10 );
+                    if( ( ulPort == 0 ) || ( ulPort > 65535 ) )
+                    {
+                        snprintf( pcWriteBuffer, xWriteBufferLen, "Invalid port.\r\n" );
+                        return pdFALSE;
+                    }
+                }
+
+                if( xTraceRecorderSetHost( cAddress, ( uint16_t ) ulPort ) != pdPASS )
+                {
+                    snprintf( pcWriteBuffer, xWriteBufferLen, "Invalid address.\r\n" );
+                    return pdFALSE;
+                }
+            }
+
+            if( xTraceRecorderHasHost() == pdFALSE )
+            {
+                snprintf( pcWriteBuffer, xWriteBufferLen, "No host: trace start <ip> [<port>]\r\n" );
+                return pdFALSE;
+            }
+
             /* Start or restart the trace. */
             vTraceStop();
             vTraceClear();
             vTraceStart();
 
-            sprintf( pcWriteBuffer, "Trace recording (re)started.\r\n" );
+            snprintf( pcWriteBuffer, xWriteBufferLen, "Trace recording (re)started.\r\n" );
         }
         else if( strncmp( pcParameter, "stop", strlen( "stop" ) ) == 0 )
         {
             /* End the trace, if one is running. */
             vTraceStop();
-            sprintf( pcWriteBuffer, "Stopping trace recording.\r\n" );
+            snprintf( pcWriteBuffer, xWriteBufferLen, "Stopping trace recording, %lu events dropped.\r\n",
+                      ( unsigned long ) ulTraceRecorderDropped() );
         }
         else
         {
-            sprintf( pcWriteBuffer, "Valid parameters are 'start' and 'stop'.\r\n" );
+            snprintf( pcWriteBuffer, xWriteBufferLen, "Valid parameters are 'start' and 'stop'.\r\n" );
         }
 
         /* There is no more data to return after this single string, so return
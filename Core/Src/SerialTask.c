@@ -1,23 +1,72 @@
 /* SerialTask.c */
 #include "SerialTask.h"
 #include "FreeRTOS_CLI.h"  /* for configCOMMAND_INT_MAX_* */
+#include "RunTimeStats.h"
+#include "StaticAlloc.h"
+#include "MemoryLayout.h"
+#include "Watchdog.h"
 #include <string.h>
 
 /* External HAL handles */
 extern UART_HandleTypeDef huart3;
 extern DMA_HandleTypeDef  hdma_usart3_rx;
 
-/* Stream buffer handles */
+/* RX stream buffer handle */
 static StreamBufferHandle_t xSerialRxStream = NULL;
-static StreamBufferHandle_t xSerialTxStream = NULL;
 
-/* DMA circular buffer for RX */
-static volatile uint8_t dma_buf[SERIAL_TASK_RX_BUFFER_SIZE];
+/* TX ring: the writers move ulTxReserve, then ulTxCommit once their bytes
+   are in; the TX task moves ulTxTail. Free running indexes */
+static uint8_t ucTxRing[SERIAL_TASK_TX_RING_SIZE];
+static volatile uint32_t ulTxReserve = 0;
+static volatile uint32_t ulTxCommit = 0;
+static volatile uint32_t ulTxTail = 0;
+
+/* TX statistics, counted by the writers (atomic) and the TX task */
+static volatile uint32_t ulTxQueued = 0;
+static volatile uint32_t ulTxDropped = 0;
+static volatile uint32_t ulTxOverflows = 0;
+static size_t xTxPeak = 0;
+
+/* The TX task, woken by the writers running in a task */
+static TaskHandle_t xSerialTxTaskHandle = NULL;
+
+/* DMA circular buffer for RX, read while the DMA writes it: not cached */
+static volatile uint8_t dma_buf[SERIAL_TASK_RX_DMA_SIZE] MEMORY_NO_CACHE;
 static volatile size_t dma_head = 0;
 
-/* Mutex for UART TX (blocking HAL transmit) */
+/* RX statistics, updated from the UART and DMA interrupts */
+static volatile SerialRxStats_t xRxStats;
+
+/* DMA buffer for TX; filled from the TX ring, one transfer at a time */
+static uint8_t dma_tx_buf[SERIAL_TASK_TX_DMA_SIZE];
+
+/* DMA buffer of vSerialTaskWrite(), for data in the TCM */
+static uint8_t dma_bounce_buf[SERIAL_TASK_TX_BOUNCE_SIZE];
+
+/* Given by the ISR when a DMA transfer has completed */
+static SemaphoreHandle_t xSerialTxDone = NULL;
+
+/* Mutex for UART TX (exclusive use of the transmitter) */
 static SemaphoreHandle_t xUSART3TxMutex = NULL;
 
+/* Memories the UART DMA has no access to */
+#define SERIAL_TASK_ITCM_END         0x08000000u
+#define SERIAL_TASK_DTCM_BASE        0x20000000u
+#define SERIAL_TASK_DTCM_END         0x20020000u
+
+/* Most bytes per DMA transfer (16-bit counter) */
+#define SERIAL_TASK_DMA_MAX          0xFFFFu
+
+/* Storage of the static allocation profile */
+APP_STREAM_STORAGE(xSerialRxStream, SERIAL_TASK_RX_BUFFER_SIZE);
+APP_MUTEX_STORAGE(xUSART3TxMutex);
+APP_MUTEX_STORAGE(xSerialTxDone);
+APP_TASK_STORAGE(xSerialRxTask, configMINIMAL_STACK_SIZE);
+APP_TASK_STORAGE(xSerialTxTask, configMINIMAL_STACK_SIZE);
+#ifdef SERIAL_TASK_LOOPBACK
+APP_TASK_STORAGE(xSerialLoopTask, configMINIMAL_STACK_SIZE);
+#endif
+
 /* Internal RX/TX tasks */
 static void vSerialRxTask(void *pvParameters);
 static void vSerialTxTask(void *pvParameters);
@@ -28,23 +77,23 @@ static void vSerialLoopbackTask(void *pvParameters);
 void vSerialTaskInit(UBaseType_t xTxPriority, UBaseType_t xRxPriority)
 {
     /* Create byte-stream buffers */
-    xSerialRxStream = xStreamBufferCreate(
+    xSerialRxStream = xAppStreamBufferCreate(
+        xSerialRxStream,
         SERIAL_TASK_RX_BUFFER_SIZE,
         SERIAL_TASK_TRIGGER_LEVEL);
     configASSERT(xSerialRxStream != NULL);
 
-    xSerialTxStream = xStreamBufferCreate(
-        SERIAL_TASK_TX_BUFFER_SIZE,
-        SERIAL_TASK_TRIGGER_LEVEL);
-    configASSERT(xSerialTxStream != NULL);
-
     /* Mutex for exclusive UART access */
-    xUSART3TxMutex = xSemaphoreCreateMutex();
+    xUSART3TxMutex = xAppSemaphoreCreateMutex(xUSART3TxMutex);
     configASSERT(xUSART3TxMutex != NULL);
 
+    xSerialTxDone = xAppSemaphoreCreateBinary(xSerialTxDone);
+    configASSERT(xSerialTxDone != NULL);
+
     /* Start the RX and TX tasks */
     BaseType_t ret;
-    ret = xTaskCreate(
+    ret = xAppTaskCreate(
+        xSerialRxTask,
         vSerialRxTask,
         "SerialRx",
         configMINIMAL_STACK_SIZE,
@@ -53,13 +102,14 @@ void vSerialTaskInit(UBaseType_t xTxPriority, UBaseType_t xRxPriority)
         NULL);
     configASSERT(ret == pdPASS);
 
-    ret = xTaskCreate(
+    ret = xAppTaskCreate(
+        xSerialTxTask,
         vSerialTxTask,
         "SerialTx",
         configMINIMAL_STACK_SIZE,
         NULL,
         xTxPriority,
-        NULL);
+        &xSerialTxTaskHandle);
     configASSERT(ret == pdPASS);
 
 #ifdef SERIAL_TASK_LOOPBACK
@@ -71,7 +121,8 @@ void vSerialTaskInit(UBaseType_t xTxPriority, UBaseType_t xRxPriority)
 #ifdef SERIAL_TASK_LOOPBACK
 void vSerialLoopbackTestStart(UBaseType_t uxPriority)
 {
-    BaseType_t ret = xTaskCreate(
+    BaseType_t ret = xAppTaskCreate(
+        xSerialLoopTask,
         vSerialLoopbackTask,
         "SerialLoop",
         configMINIMAL_STACK_SIZE,
@@ -87,74 +138,442 @@ StreamBufferHandle_t xSerialTaskGetRxStreamHandle(void)
     return xSerialRxStream;
 }
 
-StreamBufferHandle_t xSerialTaskGetTxStreamHandle(void)
+static void prvAtomicAdd(volatile uint32_t *pulValue, uint32_t ulAdd)
+{
+    uint32_t ulValue;
+
+    do
+    {
+        ulValue = __LDREXW(pulValue);
+    } while (__STREXW(ulValue + ulAdd, pulValue) != 0u);
+}
+
+/* Reserve up to ulLength bytes of the TX ring, all of them or none if
+   xWhole; returns the bytes reserved, from *pulHead */
+static uint32_t prvSerialTxReserve(uint32_t ulLength, BaseType_t xWhole, uint32_t *pulHead)
+{
+    uint32_t ulHead;
+    uint32_t ulFree;
+    uint32_t ulTake;
+
+    for (;;)
+    {
+        ulHead = __LDREXW(&ulTxReserve);
+        ulFree = SERIAL_TASK_TX_RING_SIZE - (ulHead - ulTxTail);
+        ulTake = (ulLength > ulFree) ? ((xWhole != pdFALSE) ? 0u : ulFree) : ulLength;
+        if (ulTake == 0u)
+        {
+            __CLREX();
+            break;
+        }
+        if (__STREXW(ulHead + ulTake, &ulTxReserve) == 0u)
+        {
+            break;
+        }
+    }
+
+    /* The span is free once the tail read above is: no write before it */
+    __DMB();
+    *pulHead = ulHead;
+    return ulTake;
+}
+
+/* Copy a reserved span into the ring and commit it */
+static void prvSerialTxCommit(uint32_t ulHead, const uint8_t *pucData, uint32_t ulLength)
+{
+    uint32_t ulPos = ulHead & (SERIAL_TASK_TX_RING_SIZE - 1u);
+    uint32_t ulFirst = SERIAL_TASK_TX_RING_SIZE - ulPos;
+
+    if (ulFirst >= ulLength)
+    {
+        memcpy(&ucTxRing[ulPos], pucData, ulLength);
+    }
+    else
+    {
+        memcpy(&ucTxRing[ulPos], pucData, ulFirst);
+        memcpy(ucTxRing, pucData + ulFirst, ulLength - ulFirst);
+    }
+
+    /* The bytes before the count */
+    __DMB();
+    prvAtomicAdd(&ulTxCommit, ulLength);
+    prvAtomicAdd(&ulTxQueued, ulLength);
+}
+
+/* Wake the TX task; interrupts, and tasks with the scheduler suspended,
+   leave it to its next poll */
+static void prvSerialTxWake(void)
+{
+    if (xSerialTxTaskHandle != NULL && __get_IPSR() == 0u && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+    {
+        xTaskNotifyGive(xSerialTxTaskHandle);
+    }
+}
+
+size_t xSerialTaskPut(const void *pvData, size_t xLength, TickType_t xTicksToWait)
 {
-    return xSerialTxStream;
+    const uint8_t *pucData = (const uint8_t *) pvData;
+    TickType_t xStart = 0;
+    BaseType_t xWait;
+    BaseType_t xWhole;
+    uint32_t ulHead;
+    uint32_t ulTake;
+    size_t xQueued = 0;
+
+    xWait = (xTicksToWait != 0) && __get_IPSR() == 0u && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING;
+    if (xWait)
+    {
+        xStart = xTaskGetTickCount();
+    }
+
+    while (xQueued < xLength)
+    {
+        /* A waiting write stays in one span as long as the ring can hold it */
+        xWhole = xWait && (xLength - xQueued) <= SERIAL_TASK_TX_RING_SIZE;
+
+        ulTake = prvSerialTxReserve((uint32_t) (xLength - xQueued), xWhole, &ulHead);
+        if (ulTake > 0u)
+        {
+            prvSerialTxCommit(ulHead, pucData + xQueued, ulTake);
+            xQueued += ulTake;
+            prvSerialTxWake();
+            continue;
+        }
+
+        if (!xWait || (xTaskGetTickCount() - xStart) >= xTicksToWait)
+        {
+            break;
+        }
+        vTaskDelay(1);
+    }
+
+    if (xQueued < xLength)
+    {
+        prvAtomicAdd(&ulTxDropped, (uint32_t) (xLength - xQueued));
+        prvAtomicAdd(&ulTxOverflows, 1u);
+    }
+    return xQueued;
 }
 
 void vSerialPutChar(char c)
 {
-    xStreamBufferSend(xSerialTxStream, &c, 1, 0);
+    (void) xSerialTaskPut(&c, 1, 0);
 }
 
 void vSerialPutString(const char * buf, size_t len)
 {
-    xStreamBufferSend(xSerialTxStream, buf, len, 0);
+    (void) xSerialTaskPut(buf, len, 0);
 }
 
 int __io_putchar(int ch)
 {
     char c = (char) ch;
-    xStreamBufferSend(xSerialTxStream, &c, 1, 0);
+    (void) xSerialTaskPut(&c, 1, 0);
     return ch;
 }
 
-/* Task: Drain TX stream and physically send bytes */
+/* Replaces the byte loop of syscalls.c: one span per write, so that the
+   output of concurrent printf() calls does not interleave byte by byte */
+int _write(int file, char *ptr, int len)
+{
+    (void) file;
+    (void) xSerialTaskPut(ptr, (size_t) len, 0);
+    return len;
+}
+
+void vSerialTaskGetTxStats(SerialTxStats_t *pxStats)
+{
+    pxStats->ulQueued = ulTxQueued;
+    pxStats->ulDropped = ulTxDropped;
+    pxStats->ulOverflows = ulTxOverflows;
+    pxStats->xUsed = (size_t) (ulTxReserve - ulTxTail);
+    pxStats->xPeak = xTxPeak;
+}
+
+/* Take the committed bytes of the TX ring, up to xMax; TX task only */
+static size_t prvSerialTxTake(uint8_t *pucDest, size_t xMax)
+{
+    static uint32_t ulReady = 0;
+    uint32_t ulCommit;
+    uint32_t ulReserve;
+    uint32_t ulTail = ulTxTail;
+    uint32_t ulPos;
+    uint32_t ulFirst;
+    size_t len;
+
+    /* Commit first: if the reserve index still equals it, every span
+       reserved up to there is complete */
+    ulCommit = ulTxCommit;
+    __DMB();
+    ulReserve = ulTxReserve;
+    if (ulCommit == ulReserve)
+    {
+        ulReady = ulCommit;
+    }
+
+    len = (size_t) (ulReady - ulTail);
+    if (len > xTxPeak)
+    {
+        xTxPeak = len;
+    }
+    if (len > xMax)
+    {
+        len = xMax;
+    }
+
+    ulPos = ulTail & (SERIAL_TASK_TX_RING_SIZE - 1u);
+    ulFirst = SERIAL_TASK_TX_RING_SIZE - ulPos;
+    if (ulFirst >= len)
+    {
+        memcpy(pucDest, &ucTxRing[ulPos], len);
+    }
+    else
+    {
+        memcpy(pucDest, &ucTxRing[ulPos], ulFirst);
+        memcpy(pucDest + ulFirst, ucTxRing, len - ulFirst);
+    }
+
+    /* The bytes out before the room is given back */
+    __DMB();
+    ulTxTail = ulTail + (uint32_t) len;
+    return len;
+}
+
+/* Send one DMA transfer and wait for its completion; xUSART3TxMutex held */
+static void prvSerialTransmit(const uint8_t *pucData, size_t len)
+{
+    /* Line time of the burst plus margin, in case the completion is lost */
+    TickType_t xTimeout = pdMS_TO_TICKS((len * 10u * 1000u) / huart3.Init.BaudRate + SERIAL_TASK_TX_TIMEOUT_MS);
+
+    (void) xSemaphoreTake(xSerialTxDone, 0);
+
+    /* The DMA reads the memory, not the data cache */
+    SCB_CleanDCache_by_Addr((uint32_t *) pucData, (int32_t) len);
+
+    if (HAL_UART_Transmit_DMA(&huart3, (uint8_t *) pucData, (uint16_t) len) == HAL_OK)
+    {
+        /* Sleep until HAL_UART_TxCpltCallback */
+        if (xSemaphoreTake(xSerialTxDone, xTimeout) != pdTRUE)
+        {
+            HAL_UART_AbortTransmit(&huart3);
+        }
+    }
+    else
+    {
+        /* DMA unavailable: fall back to a polled transmit */
+        HAL_UART_Transmit(&huart3, (uint8_t *) pucData, (uint16_t) len, HAL_MAX_DELAY);
+    }
+}
+
+/* Task: Drain the TX ring and send it by DMA, as many bytes per transfer as are queued */
 static void vSerialTxTask(void *pvParameters)
 {
-    uint8_t c;
+    size_t len;
+    TickType_t xWait;
+
+    /* A writer that keeps the UART, or a transmit stuck in the driver,
+       resets the board */
+    configASSERT(xWatchdogRegister(NULL, WATCHDOG_DEADLINE_MS) == pdPASS);
+
     for (;;)
     {
-        if (xStreamBufferReceive(xSerialTxStream, &c, 1, portMAX_DELAY) > 0)
+        vWatchdogKick();
+
+        /* Whatever accumulated while the previous transfer was running goes
+           out in one burst */
+        len = prvSerialTxTake(dma_tx_buf, sizeof(dma_tx_buf));
+        if (len == 0)
+        {
+            /* A writer half way through its span holds back the bytes after
+               it: look again on the next tick */
+            xWait = (ulTxReserve != ulTxTail) ? 1 : pdMS_TO_TICKS(SERIAL_TASK_TX_POLL_MS);
+            (void) ulTaskNotifyTake(pdTRUE, xWait);
+            continue;
+        }
+
+        if (xSemaphoreTake(xUSART3TxMutex, portMAX_DELAY) == pdTRUE)
         {
-            if (xSemaphoreTake(xUSART3TxMutex, portMAX_DELAY) == pdTRUE)
-            {
-                HAL_UART_Transmit(&huart3, &c, 1, HAL_MAX_DELAY);
-                xSemaphoreGive(xUSART3TxMutex);
-            }
+            prvSerialTransmit(dma_tx_buf, len);
+            xSemaphoreGive(xUSART3TxMutex);
         }
     }
 }
 
-/* UART3 ISR: push DMA-received bytes into RX stream */
-void USART3_IRQHandler(void)
+void vSerialTaskWrite(const void *pvData, size_t xLength)
+{
+    const uint8_t *pucData = (const uint8_t *) pvData;
+    uint32_t ulAddress = (uint32_t) pucData;
+    BaseType_t xDirect;
+    size_t len;
+
+    /* The DMA masters cannot reach the ITCM nor the DTCM */
+    xDirect = (ulAddress >= SERIAL_TASK_ITCM_END) &&
+              (ulAddress + xLength <= SERIAL_TASK_DTCM_BASE || ulAddress >= SERIAL_TASK_DTCM_END);
+
+    if (xSemaphoreTake(xUSART3TxMutex, portMAX_DELAY) != pdTRUE)
+    {
+        return;
+    }
+
+    while (xLength > 0)
+    {
+        if (xDirect)
+        {
+            len = (xLength > SERIAL_TASK_DMA_MAX) ? SERIAL_TASK_DMA_MAX : xLength;
+            prvSerialTransmit(pucData, len);
+        }
+        else
+        {
+            len = (xLength > sizeof(dma_bounce_buf)) ? sizeof(dma_bounce_buf) : xLength;
+            memcpy(dma_bounce_buf, pucData, len);
+            prvSerialTransmit(dma_bounce_buf, len);
+        }
+
+        pucData += len;
+        xLength -= len;
+    }
+
+    xSemaphoreGive(xUSART3TxMutex);
+}
+
+/* HAL callback: TX DMA transfer (and the last stop bit) complete */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
 {
     BaseType_t xWoken = pdFALSE;
-    size_t head = SERIAL_TASK_RX_BUFFER_SIZE - __HAL_DMA_GET_COUNTER(&hdma_usart3_rx);
-    size_t cnt  = (head >= dma_head)
-                ? (head - dma_head)
-                : (SERIAL_TASK_RX_BUFFER_SIZE - dma_head + head);
 
-    if (cnt > 0)
+    if (huart == &huart3 && xSerialTxDone != NULL)
     {
-        for (size_t i = 0; i < cnt; ++i)
+        xSemaphoreGiveFromISR(xSerialTxDone, &xWoken);
+    }
+    portYIELD_FROM_ISR(xWoken);
+}
+
+void vSerialTaskGetRxStats(SerialRxStats_t *pxStats)
+{
+    taskENTER_CRITICAL();
+    *pxStats = xRxStats;
+    taskEXIT_CRITICAL();
+}
+
+/* Copy one contiguous piece of the DMA ring into the RX stream */
+static void prvSerialRxPush(size_t offset, size_t len, BaseType_t *pxWoken)
+{
+    size_t sent = xStreamBufferSendFromISR(xSerialRxStream, (const void *) &dma_buf[offset], len, pxWoken);
+
+    xRxStats.ulReceived += len;
+    xRxStats.ulDropped += len - sent;
+}
+
+/* Move everything the DMA wrote since the last call into the RX stream;
+   called on UART IDLE and on DMA half / full transfer, so the ring is drained
+   at least twice per lap even without gaps in the input */
+static void prvSerialRxDrainFromISR(BaseType_t *pxWoken)
+{
+    size_t head = SERIAL_TASK_RX_DMA_SIZE - __HAL_DMA_GET_COUNTER(&hdma_usart3_rx);
+
+    if (head == SERIAL_TASK_RX_DMA_SIZE)
+    {
+        head = 0;
+    }
+
+    if (head > dma_head)
+    {
+        prvSerialRxPush(dma_head, head - dma_head, pxWoken);
+    }
+    else if (head < dma_head)
+    {
+        /* Wrapped: tail of the ring, then its beginning */
+        prvSerialRxPush(dma_head, SERIAL_TASK_RX_DMA_SIZE - dma_head, pxWoken);
+        if (head > 0)
         {
-            uint8_t c = dma_buf[(dma_head + i) % SERIAL_TASK_RX_BUFFER_SIZE];
-            xStreamBufferSendFromISR(xSerialRxStream, &c, 1, &xWoken);
+            prvSerialRxPush(0, head, pxWoken);
         }
-        dma_head = head;
     }
-    __HAL_UART_CLEAR_IDLEFLAG(&huart3);
+    dma_head = head;
+}
+
+/* Start (or restart) circular DMA reception */
+static void prvSerialRxStart(void)
+{
+    dma_head = 0;
+    HAL_UART_Receive_DMA(&huart3, (uint8_t *)dma_buf, SERIAL_TASK_RX_DMA_SIZE);
+    __HAL_UART_ENABLE_IT(&huart3, UART_IT_IDLE);
+}
+
+/* UART3 ISR: push DMA-received bytes into RX stream when the line goes idle */
+void USART3_IRQHandler(void)
+{
+    BaseType_t xWoken = pdFALSE;
+
+    vRunTimeStatsIsrEnter(RUN_TIME_STATS_ISR_USART3);
+
+    if (__HAL_UART_GET_FLAG(&huart3, UART_FLAG_IDLE))
+    {
+        __HAL_UART_CLEAR_IDLEFLAG(&huart3);
+        prvSerialRxDrainFromISR(&xWoken);
+    }
     HAL_UART_IRQHandler(&huart3);
+
+    vRunTimeStatsIsrExit(RUN_TIME_STATS_ISR_USART3);
+    portYIELD_FROM_ISR(xWoken);
+}
+
+/* HAL callbacks: RX DMA reached the middle / the end of the ring */
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart)
+{
+    BaseType_t xWoken = pdFALSE;
+
+    if (huart == &huart3)
+    {
+        prvSerialRxDrainFromISR(&xWoken);
+    }
     portYIELD_FROM_ISR(xWoken);
 }
 
-/* Setup DMA RX and IDLE interrupt */
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+    BaseType_t xWoken = pdFALSE;
+
+    if (huart == &huart3)
+    {
+        prvSerialRxDrainFromISR(&xWoken);
+    }
+    portYIELD_FROM_ISR(xWoken);
+}
+
+/* HAL callback: a receive error stopped the DMA; count it and restart */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    BaseType_t xWoken = pdFALSE;
+
+    if (huart != &huart3)
+    {
+        return;
+    }
+
+    if (huart->ErrorCode & HAL_UART_ERROR_ORE)
+    {
+        xRxStats.ulOverruns++;
+    }
+    if (huart->ErrorCode & (HAL_UART_ERROR_PE | HAL_UART_ERROR_NE | HAL_UART_ERROR_FE))
+    {
+        xRxStats.ulErrors++;
+    }
+
+    /* Keep what was received before the error */
+    prvSerialRxDrainFromISR(&xWoken);
+
+    if (huart->RxState == HAL_UART_STATE_READY)
+    {
+        prvSerialRxStart();
+    }
+    portYIELD_FROM_ISR(xWoken);
+}
+
+/* Setup DMA RX (half / full transfer interrupts) and IDLE interrupt */
 static void vSerialRxTask(void *pvParameters)
 {
-    HAL_UART_Receive_DMA(&huart3, (uint8_t *)dma_buf, SERIAL_TASK_RX_BUFFER_SIZE);
-    __HAL_DMA_DISABLE_IT(&hdma_usart3_rx, DMA_IT_TC | DMA_IT_HT);
-    __HAL_UART_ENABLE_IT(&huart3, UART_IT_IDLE);
+    prvSerialRxStart();
 
     /* This task simply sleeps; ISR does the work */
     for (;;)
@@ -172,7 +591,7 @@ static void vSerialLoopbackTask(void *pvParameters)
     {
         if (xStreamBufferReceive(xSerialRxStream, &c, 1, portMAX_DELAY) > 0)
         {
-            xStreamBufferSend(xSerialTxStream, &c, 1, portMAX_DELAY);
+            (void) xSerialTaskPut(&c, 1, portMAX_DELAY);
         }
     }
 }
@@ -0,0 +1,1394 @@
+/* SnmpAgent.c
+ *
+ * Message codec, object table and request handling of the SNMP agent (see
+ * SnmpAgent.h). Everything belongs to the agent task; the counters are read
+ * by the CLI without a lock, a value at a time.
+ */
+#include "SnmpAgent.h"
+#include "StaticAlloc.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/tcp.h"
+#include "core/net_stats.h"
+#include "ipv4/ipv4.h"
+#include "snmp/snmp_common.h"
+#include "mibs/mib2_module.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+/* BER tags (X.690) and SNMP application types (RFC 2578) */
+#define BER_INTEGER                    0x02u
+#define BER_OCTET_STRING               0x04u
+#define BER_NULL                       0x05u
+#define BER_OID                        0x06u
+#define BER_SEQUENCE                   0x30u
+#define BER_IP_ADDRESS                 0x40u
+#define BER_COUNTER32                  0x41u
+#define BER_GAUGE32                    0x42u
+#define BER_TIME_TICKS                 0x43u
+#define BER_CONTEXT_PDU                0xA0u
+#define BER_CONTEXT_EXCEPTION          0x80u
+
+/* Sub-identifiers of a request name, and of an object of the table */
+#define SNMP_MAX_SUBIDS                32u
+#define SNMP_MAX_PREFIX                10u
+
+/* sysServices: internet and end-to-end layers (RFC 1213) */
+#define SNMP_SYS_SERVICES              72u
+
+/* tcpRtoAlgorithm: vanj */
+#define SNMP_TCP_RTO_VANJ              4u
+
+/* Longest encoded name or value of a variable */
+#define SNMP_MAX_TLV                   96u
+
+/* How the instances of an object are indexed */
+typedef enum
+{
+    eSnmpScalar = 0,                /* .0 */
+    eSnmpIfRow,                     /* .ifIndex */
+    eSnmpTcpRow                     /* .localAddress.localPort.remAddress.remPort */
+} SnmpIndex_t;
+
+typedef enum
+{
+    eSysDescr = 0,
+    eSysObjectId,
+    eSysUpTime,
+    eSysContact,
+    eSysName,
+    eSysLocation,
+    eSysServices,
+    eIfNumber,
+    eIfIndex,
+    eIfDescr,
+    eIfType,
+    eIfMtu,
+    eIfSpeed,
+    eIfPhysAddress,
+    eIfAdminStatus,
+    eIfOperStatus,
+    eIfLastChange,
+    eIfInOctets,
+    eIfInUcastPkts,
+    eIfInDiscards,
+    eIfInErrors,
+    eIfOutOctets,
+    eIfOutUcastPkts,
+    eIfOutDiscards,
+    eIfOutErrors,
+    eIpForwarding,
+    eIpDefaultTtl,
+    eIpInReceives,
+    eIpInHdrErrors,
+    eIpInDelivers,
+    eIpOutRequests,
+    eIpReasmOks,
+    eIpReasmFails,
+    eTcpRtoAlgorithm,
+    eTcpRtoMin,
+    eTcpRtoMax,
+    eTcpMaxConn,
+    eTcpCurrEstab,
+    eTcpInSegs,
+    eTcpOutSegs,
+    eTcpRetransSegs,
+    eTcpConnState,
+    eTcpConnLocalAddress,
+    eTcpConnLocalPort,
+    eTcpConnRemAddress,
+    eTcpConnRemPort,
+    eTcpInErrs,
+    eUdpInDatagrams,
+    eUdpNoPorts,
+    eUdpInErrors,
+    eUdpOutDatagrams
+} SnmpValueId_t;
+
+typedef struct
+{
+    uint8_t ucIndex;                /* SnmpIndex_t */
+    uint8_t ucValue;                /* SnmpValueId_t */
+    uint8_t ucLength;
+    uint32_t ulOid[SNMP_MAX_PREFIX];
+} SnmpObject_t;
+
+typedef struct
+{
+    uint8_t ucType;                 /* BER tag */
+    uint32_t ulValue;               /* Integers */
+    const void *pvData;             /* Octet strings, IP addresses */
+    size_t xLength;
+    const uint32_t *pulOid;         /* Object identifiers */
+} SnmpValue_t;
+
+typedef struct
+{
+    uint32_t ulIndex[10];
+    uint8_t ucState;
+} SnmpTcpRow_t;
+
+/* Interface values read once per request */
+typedef struct
+{
+    char cName[NET_MAX_IF_NAME_LEN + 1];
+    MacAddr xMacAddr;
+    uint32_t ulMtu;
+    uint32_t ulSpeed;
+    BaseType_t xAdminUp;
+    BaseType_t xLinkUp;
+    systime_t xLastChange;
+    NetInterfaceStats xStats;
+} SnmpIfSnapshot_t;
+
+typedef struct
+{
+    uint32_t ulSubIds[SNMP_MAX_SUBIDS];
+    size_t xLength;
+} SnmpName_t;
+
+#define MIB2(...)                      { 1, 3, 6, 1, 2, 1, __VA_ARGS__ }
+#define SNMP_OBJECT(index, value, length, oid) { (index), (value), (length), oid }
+
+/* In OID order: the lookups are binary searches (checked at start) */
+static const SnmpObject_t xObjects[] =
+{
+    SNMP_OBJECT(eSnmpScalar, eSysDescr,            8, MIB2(1, 1)),
+    SNMP_OBJECT(eSnmpScalar, eSysObjectId,         8, MIB2(1, 2)),
+    SNMP_OBJECT(eSnmpScalar, eSysUpTime,           8, MIB2(1, 3)),
+    SNMP_OBJECT(eSnmpScalar, eSysContact,          8, MIB2(1, 4)),
+    SNMP_OBJECT(eSnmpScalar, eSysName,             8, MIB2(1, 5)),
+    SNMP_OBJECT(eSnmpScalar, eSysLocation,         8, MIB2(1, 6)),
+    SNMP_OBJECT(eSnmpScalar, eSysServices,         8, MIB2(1, 7)),
+    SNMP_OBJECT(eSnmpScalar, eIfNumber,            8, MIB2(2, 1)),
+    SNMP_OBJECT(eSnmpIfRow,  eIfIndex,            10, MIB2(2, 2, 1, 1)),
+    SNMP_OBJECT(eSnmpIfRow,  eIfDescr,            10, MIB2(2, 2, 1, 2)),
+    SNMP_OBJECT(eSnmpIfRow,  eIfType,             10, MIB2(2, 2, 1, 3)),
+    SNMP_OBJECT(eSnmpIfRow,  eIfMtu,              10, MIB2(2, 2, 1, 4)),
+    SNMP_OBJECT(eSnmpIfRow,  eIfSpeed,            10, MIB2(2, 2, 1, 5)),
+    SNMP_OBJECT(eSnmpIfRow,  eIfPhysAddress,      10, MIB2(2, 2, 1, 6)),
+    SNMP_OBJECT(eSnmpIfRow,  eIfAdminStatus,      10, MIB2(2, 2, 1, 7)),
+    SNMP_OBJECT(eSnmpIfRow,  eIfOperStatus,       10, MIB2(2, 2, 1, 8)),
+    SNMP_OBJECT(eSnmpIfRow,  eIfLastChange,       10, MIB2(2, 2, 1, 9)),
+    SNMP_OBJECT(eSnmpIfRow,  eIfInOctets,         10, MIB2(2, 2, 1, 10)),
+    SNMP_OBJECT(eSnmpIfRow,  eIfInUcastPkts,      10, MIB2(2, 2, 1, 11)),
+    SNMP_OBJECT(eSnmpIfRow,  eIfInDiscards,       10, MIB2(2, 2, 1, 13)),
+    SNMP_OBJECT(eSnmpIfRow,  eIfInErrors,         10, MIB2(2, 2, 1, 14)),
+    SNMP_OBJECT(eSnmpIfRow,  eIfOutOctets,        10, MIB2(2, 2, 1, 16)),
+    SNMP_OBJECT(eSnmpIfRow,  eIfOutUcastPkts,     10, MIB2(2, 2, 1, 17)),
+    SNMP_OBJECT(eSnmpIfRow,  eIfOutDiscards,      10, MIB2(2, 2, 1, 19)),
+    SNMP_OBJECT(eSnmpIfRow,  eIfOutErrors,        10, MIB2(2, 2, 1, 20)),
+    SNMP_OBJECT(eSnmpScalar, eIpForwarding,        8, MIB2(4, 1)),
+    SNMP_OBJECT(eSnmpScalar, eIpDefaultTtl,        8, MIB2(4, 2)),
+    SNMP_OBJECT(eSnmpScalar, eIpInReceives,        8, MIB2(4, 3)),
+    SNMP_OBJECT(eSnmpScalar, eIpInHdrErrors,       8, MIB2(4, 4)),
+    SNMP_OBJECT(eSnmpScalar, eIpInDelivers,        8, MIB2(4, 9)),
+    SNMP_OBJECT(eSnmpScalar, eIpOutRequests,       8, MIB2(4, 10)),
+    SNMP_OBJECT(eSnmpScalar, eIpReasmOks,          8, MIB2(4, 15)),
+    SNMP_OBJECT(eSnmpScalar, eIpReasmFails,        8, MIB2(4, 16)),
+    SNMP_OBJECT(eSnmpScalar, eTcpRtoAlgorithm,     8, MIB2(6, 1)),
+    SNMP_OBJECT(eSnmpScalar, eTcpRtoMin,           8, MIB2(6, 2)),
+    SNMP_OBJECT(eSnmpScalar, eTcpRtoMax,           8, MIB2(6, 3)),
+    SNMP_OBJECT(eSnmpScalar, eTcpMaxConn,          8, MIB2(6, 4)),
+    SNMP_OBJECT(eSnmpScalar, eTcpCurrEstab,        8, MIB2(6, 9)),
+    SNMP_OBJECT(eSnmpScalar, eTcpInSegs,           8, MIB2(6, 10)),
+    SNMP_OBJECT(eSnmpScalar, eTcpOutSegs,          8, MIB2(6, 11)),
+    SNMP_OBJECT(eSnmpScalar, eTcpRetransSegs,      8, MIB2(6, 12)),
+    SNMP_OBJECT(eSnmpTcpRow, eTcpConnState,       10, MIB2(6, 13, 1, 1)),
+    SNMP_OBJECT(eSnmpTcpRow, eTcpConnLocalAddress, 10, MIB2(6, 13, 1, 2)),
+    SNMP_OBJECT(eSnmpTcpRow, eTcpConnLocalPort,   10, MIB2(6, 13, 1, 3)),
+    SNMP_OBJECT(eSnmpTcpRow, eTcpConnRemAddress,  10, MIB2(6, 13, 1, 4)),
+    SNMP_OBJECT(eSnmpTcpRow, eTcpConnRemPort,     10, MIB2(6, 13, 1, 5)),
+    SNMP_OBJECT(eSnmpScalar, eTcpInErrs,           8, MIB2(6, 14)),
+    SNMP_OBJECT(eSnmpScalar, eUdpInDatagrams,      8, MIB2(7, 1)),
+    SNMP_OBJECT(eSnmpScalar, eUdpNoPorts,          8, MIB2(7, 2)),
+    SNMP_OBJECT(eSnmpScalar, eUdpInErrors,         8, MIB2(7, 3)),
+    SNMP_OBJECT(eSnmpScalar, eUdpOutDatagrams,     8, MIB2(7, 4))
+};
+
+#define SNMP_OBJECT_COUNT              (sizeof(xObjects) / sizeof(xObjects[0]))
+
+/* zeroDotZero: no vendor registration for this device */
+static const uint32_t ulSysObjectId[2] = { 0, 0 };
+
+/* tcpConnState of each TcpState */
+static const uint8_t ucTcpStates[] =
+{
+    MIB2_TCP_CONN_STATE_CLOSED,
+    MIB2_TCP_CONN_STATE_LISTEN,
+    MIB2_TCP_CONN_STATE_SYN_SENT,
+    MIB2_TCP_CONN_STATE_SYN_RECEIVED,
+    MIB2_TCP_CONN_STATE_ESTABLISHED,
+    MIB2_TCP_CONN_STATE_CLOSE_WAIT,
+    MIB2_TCP_CONN_STATE_LAST_ACK,
+    MIB2_TCP_CONN_STATE_FIN_WAIT_1,
+    MIB2_TCP_CONN_STATE_FIN_WAIT_2,
+    MIB2_TCP_CONN_STATE_CLOSING,
+    MIB2_TCP_CONN_STATE_TIME_WAIT
+};
+
+/* Owned by the agent task */
+static uint8_t ucRx[SNMP_MAX_MSG_SIZE];
+static uint8_t ucTx[SNMP_AGENT_MAX_RESPONSE];
+static uint8_t ucVarbinds[SNMP_AGENT_MAX_RESPONSE];
+static SnmpName_t xNames[SNMP_AGENT_MAX_VARBINDS];
+static SnmpName_t xNext;
+
+/* Snapshot of the values, taken for each request */
+static SnmpIfSnapshot_t xIfSnapshot[NET_INTERFACE_COUNT];
+static NetProtocolStats xProtocolSnapshot;
+static SnmpTcpRow_t xTcpRows[SOCKET_MAX_COUNT];
+static UBaseType_t uxTcpRows = 0;
+static uint32_t ulTcpEstablished = 0;
+static char cSysName[NET_MAX_HOSTNAME_LEN + 1];
+
+static SnmpAgentStats_t xStats;
+
+APP_TASK_STORAGE(xSnmpTask, SNMP_AGENT_TASK_STACK_SIZE);
+
+static BaseType_t prvSnmpCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xSnmp =
+{
+    "snmp",
+    "\r\nsnmp:\r\n SNMP agent counters\r\n",
+    prvSnmpCommand,
+    -1
+};
+
+/* Lexicographic order of object identifiers, a prefix first */
+static int prvCompare(const uint32_t *pulA, size_t xA, const uint32_t *pulB, size_t xB)
+{
+    size_t i;
+
+    for (i = 0; i < xA && i < xB; i++)
+    {
+        if (pulA[i] != pulB[i])
+        {
+            return (pulA[i] < pulB[i]) ? -1 : 1;
+        }
+    }
+
+    return (xA == xB) ? 0 : (xA < xB) ? -1 : 1;
+}
+
+/* Take the values out of the stack, once per request */
+static void prvSnapshot(void)
+{
+    NetInterface *pxInterface;
+    SnmpTcpRow_t xRow;
+    Socket *pxSocket;
+    const uint8_t *pucAddr;
+    UBaseType_t i;
+    UBaseType_t j;
+
+    (void) netStatsGetProtocolStats(&xProtocolSnapshot);
+    uxTcpRows = 0;
+    ulTcpEstablished = 0;
+
+    osAcquireMutex(&netMutex);
+
+    for (i = 0; i < NET_INTERFACE_COUNT; i++)
+    {
+        pxInterface = &netInterface[i];
+        memcpy(xIfSnapshot[i].cName, pxInterface->name, sizeof(xIfSnapshot[i].cName));
+        xIfSnapshot[i].xMacAddr = pxInterface->macAddr;
+        xIfSnapshot[i].ulMtu = (pxInterface->nicDriver != NULL) ? (uint32_t) pxInterface->nicDriver->mtu : 0u;
+        xIfSnapshot[i].ulSpeed = pxInterface->linkSpeed;
+        xIfSnapshot[i].xAdminUp = (pxInterface->adminLinkState != NIC_LINK_STATE_DOWN) ? pdTRUE : pdFALSE;
+        xIfSnapshot[i].xLinkUp = pxInterface->linkState ? pdTRUE : pdFALSE;
+        xIfSnapshot[i].xLastChange = pxInterface->linkUpTime;
+    }
+    memcpy(cSysName, netInterface[0].hostname, sizeof(cSysName));
+
+    /* IPv4 connections only: tcpConnTable has no room for others */
+    for (i = 0; i < SOCKET_MAX_COUNT; i++)
+    {
+        pxSocket = &socketTable[i];
+        if (pxSocket->type != SOCKET_TYPE_STREAM || pxSocket->tcb->state == TCP_STATE_CLOSED ||
+            (pxSocket->localIpAddr.length != 0 && pxSocket->localIpAddr.length != sizeof(Ipv4Addr)))
+        {
+            continue;
+        }
+
+        pucAddr = (const uint8_t *) &pxSocket->localIpAddr.ipv4Addr;
+        for (j = 0; j < 4u; j++)
+        {
+            xRow.ulIndex[j] = (pxSocket->localIpAddr.length != 0) ? pucAddr[j] : 0u;
+        }
+        xRow.ulIndex[4] = pxSocket->localPort;
+        pucAddr = (const uint8_t *) &pxSocket->remoteIpAddr.ipv4Addr;
+        for (j = 0; j < 4u; j++)
+        {
+            xRow.ulIndex[5u + j] = (pxSocket->remoteIpAddr.length == sizeof(Ipv4Addr)) ? pucAddr[j] : 0u;
+        }
+        xRow.ulIndex[9] = pxSocket->remotePort;
+        xRow.ucState = (pxSocket->tcb->state < sizeof(ucTcpStates)) ? ucTcpStates[pxSocket->tcb->state] :
+                       MIB2_TCP_CONN_STATE_CLOSED;
+
+        if (pxSocket->tcb->state == TCP_STATE_ESTABLISHED || pxSocket->tcb->state == TCP_STATE_CLOSE_WAIT)
+        {
+            ulTcpEstablished++;
+        }
+
+        /* Insertion in index order */
+        for (j = uxTcpRows; j > 0 && prvCompare(xTcpRows[j - 1u].ulIndex, 10, xRow.ulIndex, 10) > 0; j--)
+        {
+            xTcpRows[j] = xTcpRows[j - 1u];
+        }
+        xTcpRows[j] = xRow;
+        uxTcpRows++;
+    }
+
+    osReleaseMutex(&netMutex);
+
+    for (i = 0; i < NET_INTERFACE_COUNT; i++)
+    {
+        (void) netStatsGetInterfaceStats(i, &xIfSnapshot[i].xStats);
+    }
+}
+
+static UBaseType_t prvInstanceCount(uint8_t ucIndex)
+{
+    switch (ucIndex)
+    {
+    case eSnmpScalar:
+        return 1u;
+    case eSnmpIfRow:
+        return NET_INTERFACE_COUNT;
+    default:
+        return uxTcpRows;
+    }
+}
+
+/* Index of instance uxNth of an object, in ascending order */
+static const uint32_t *prvInstance(uint8_t ucIndex, UBaseType_t uxNth, size_t *pxLength, uint32_t *pulScratch)
+{
+    switch (ucIndex)
+    {
+    case eSnmpScalar:
+        *pulScratch = 0;
+        *pxLength = 1u;
+        return pulScratch;
+    case eSnmpIfRow:
+        *pulScratch = (uint32_t) uxNth + 1u;
+        *pxLength = 1u;
+        return pulScratch;
+    default:
+        *pxLength = 10u;
+        return xTcpRows[uxNth].ulIndex;
+    }
+}
+
+/* First instance of an object at or after (xStrict pdFALSE), or after
+   (pdTRUE), this index; binary search, the instances being in order */
+static UBaseType_t prvSeekInstance(uint8_t ucIndex, const uint32_t *pulIndex, size_t xLength, BaseType_t xStrict)
+{
+    UBaseType_t uxLow = 0;
+    UBaseType_t uxHigh = prvInstanceCount(ucIndex);
+    UBaseType_t uxMid;
+    const uint32_t *pulInstance;
+    uint32_t ulScratch;
+    size_t xInstance;
+    int lOrder;
+
+    while (uxLow < uxHigh)
+    {
+        uxMid = (uxLow + uxHigh) / 2u;
+        pulInstance = prvInstance(ucIndex, uxMid, &xInstance, &ulScratch);
+        lOrder = prvCompare(pulInstance, xInstance, pulIndex, xLength);
+        if (lOrder > 0 || (lOrder == 0 && xStrict == pdFALSE))
+        {
+            uxHigh = uxMid;
+        }
+        else
+        {
+            uxLow = uxMid + 1u;
+        }
+    }
+
+    return uxLow;
+}
+
+/* Last object whose OID is at most this name, or -1 */
+static int32_t prvFindObject(const SnmpName_t *pxName)
+{
+    int32_t lLow = 0;
+    int32_t lHigh = (int32_t) SNMP_OBJECT_COUNT;
+    int32_t lMid;
+
+    while (lLow < lHigh)
+    {
+        lMid = (lLow + lHigh) / 2;
+        if (prvCompare(xObjects[lMid].ulOid, xObjects[lMid].ucLength, pxName->ulSubIds, pxName->xLength) <= 0)
+        {
+            lLow = lMid + 1;
+        }
+        else
+        {
+            lHigh = lMid;
+        }
+    }
+
+    return lLow - 1;
+}
+
+static BaseType_t prvIsPrefix(const SnmpObject_t *pxObject, const SnmpName_t *pxName)
+{
+    return (pxName->xLength >= pxObject->ucLength &&
+            memcmp(pxObject->ulOid, pxName->ulSubIds, pxObject->ucLength * sizeof(uint32_t)) == 0) ? pdTRUE : pdFALSE;
+}
+
+static void prvMakeName(const SnmpObject_t *pxObject, UBaseType_t uxNth, SnmpName_t *pxName)
+{
+    const uint32_t *pulInstance;
+    uint32_t ulScratch;
+    size_t xInstance;
+
+    pulInstance = prvInstance(pxObject->ucIndex, uxNth, &xInstance, &ulScratch);
+    memcpy(pxName->ulSubIds, pxObject->ulOid, pxObject->ucLength * sizeof(uint32_t));
+    memcpy(&pxName->ulSubIds[pxObject->ucLength], pulInstance, xInstance * sizeof(uint32_t));
+    pxName->xLength = pxObject->ucLength + xInstance;
+}
+
+/* Object and instance of a name, for Get; NULL if none */
+static const SnmpObject_t *prvLookup(const SnmpName_t *pxName, UBaseType_t *puxNth, BaseType_t *pxNoInstance)
+{
+    const SnmpObject_t *pxObject;
+    const uint32_t *pulIndex;
+    int32_t lObject = prvFindObject(pxName);
+    size_t xIndex;
+    UBaseType_t uxNth;
+    SnmpName_t xFound;
+
+    *pxNoInstance = pdFALSE;
+    if (lObject < 0 || prvIsPrefix(&xObjects[lObject], pxName) == pdFALSE)
+    {
+        return NULL;
+    }
+
+    pxObject = &xObjects[lObject];
+    pulIndex = &pxName->ulSubIds[pxObject->ucLength];
+    xIndex = pxName->xLength - pxObject->ucLength;
+    uxNth = prvSeekInstance(pxObject->ucIndex, pulIndex, xIndex, pdFALSE);
+    if (uxNth < prvInstanceCount(pxObject->ucIndex))
+    {
+        prvMakeName(pxObject, uxNth, &xFound);
+        if (prvCompare(xFound.ulSubIds, xFound.xLength, pxName->ulSubIds, pxName->xLength) == 0)
+        {
+            *puxNth = uxNth;
+            return pxObject;
+        }
+    }
+
+    *pxNoInstance = pdTRUE;
+    return NULL;
+}
+
+/* Object and instance following a name, for GetNext; NULL past the end */
+static const SnmpObject_t *prvLookupNext(const SnmpName_t *pxName, UBaseType_t *puxNth)
+{
+    const SnmpObject_t *pxObject;
+    int32_t lObject = prvFindObject(pxName);
+    UBaseType_t uxNth;
+
+    /* Within an object, the instance after the index asked */
+    if (lObject >= 0 && prvIsPrefix(&xObjects[lObject], pxName) != pdFALSE)
+    {
+        pxObject = &xObjects[lObject];
+        uxNth = prvSeekInstance(pxObject->ucIndex, &pxName->ulSubIds[pxObject->ucLength],
+                                pxName->xLength - pxObject->ucLength, pdTRUE);
+        if (uxNth < prvInstanceCount(pxObject->ucIndex))
+        {
+            *puxNth = uxNth;
+            return pxObject;
+        }
+    }
+
+    /* Otherwise the first instance of the next object which has one */
+    for (lObject++; lObject < (int32_t) SNMP_OBJECT_COUNT; lObject++)
+    {
+        if (prvInstanceCount(xObjects[lObject].ucIndex) > 0)
+        {
+            *puxNth = 0;
+            return &xObjects[lObject];
+        }
+    }
+
+    return NULL;
+}
+
+static void prvValue(const SnmpObject_t *pxObject, UBaseType_t uxNth, SnmpValue_t *pxValue)
+{
+    const SnmpIfSnapshot_t *pxIf = &xIfSnapshot[(pxObject->ucIndex == eSnmpIfRow) ? uxNth : 0u];
+    const SnmpTcpRow_t *pxRow = &xTcpRows[(pxObject->ucIndex == eSnmpTcpRow) ? uxNth : 0u];
+    static uint8_t ucAddress[4];
+    UBaseType_t i;
+
+    memset(pxValue, 0, sizeof(*pxValue));
+    pxValue->ucType = BER_COUNTER32;
+
+    switch (pxObject->ucValue)
+    {
+    case eSysDescr:
+        pxValue->ucType = BER_OCTET_STRING;
+        pxValue->pvData = SNMP_AGENT_SYS_DESCR;
+        pxValue->xLength = strlen(SNMP_AGENT_SYS_DESCR);
+        break;
+    case eSysObjectId:
+        pxValue->ucType = BER_OID;
+        pxValue->pulOid = ulSysObjectId;
+        pxValue->xLength = 2u;
+        break;
+    case eSysUpTime:
+        pxValue->ucType = BER_TIME_TICKS;
+        pxValue->ulValue = (uint32_t) (osGetSystemTime() / 10u);
+        break;
+    case eSysContact:
+        pxValue->ucType = BER_OCTET_STRING;
+        pxValue->pvData = SNMP_AGENT_SYS_CONTACT;
+        pxValue->xLength = strlen(SNMP_AGENT_SYS_CONTACT);
+        break;
+    case eSysName:
+        pxValue->ucType = BER_OCTET_STRING;
+        pxValue->pvData = cSysName;
+        pxValue->xLength = strlen(cSysName);
+        break;
+    case eSysLocation:
+        pxValue->ucType = BER_OCTET_STRING;
+        pxValue->pvData = SNMP_AGENT_SYS_LOCATION;
+        pxValue->xLength = strlen(SNMP_AGENT_SYS_LOCATION);
+        break;
+    case eSysServices:
+        pxValue->ucType = BER_INTEGER;
+        pxValue->ulValue = SNMP_SYS_SERVICES;
+        break;
+    case eIfNumber:
+        pxValue->ucType = BER_INTEGER;
+        pxValue->ulValue = NET_INTERFACE_COUNT;
+        break;
+    case eIfIndex:
+        pxValue->ucType = BER_INTEGER;
+        pxValue->ulValue = (uint32_t) uxNth + 1u;
+        break;
+    case eIfDescr:
+        pxValue->ucType = BER_OCTET_STRING;
+        pxValue->pvData = pxIf->cName;
+        pxValue->xLength = strlen(pxIf->cName);
+        break;
+    case eIfType:
+        pxValue->ucType = BER_INTEGER;
+        pxValue->ulValue = MIB2_IF_TYPE_ETHERNET_CSMACD;
+        break;
+    case eIfMtu:
+        pxValue->ucType = BER_INTEGER;
+        pxValue->ulValue = pxIf->ulMtu;
+        break;
+    case eIfSpeed:
+        pxValue->ucType = BER_GAUGE32;
+        pxValue->ulValue = pxIf->ulSpeed;
+        break;
+    case eIfPhysAddress:
+        pxValue->ucType = BER_OCTET_STRING;
+        pxValue->pvData = &pxIf->xMacAddr;
+        pxValue->xLength = sizeof(MacAddr);
+        break;
+    case eIfAdminStatus:
+        pxValue->ucType = BER_INTEGER;
+        pxValue->ulValue = (pxIf->xAdminUp != pdFALSE) ? MIB2_IF_ADMIN_STATUS_UP : MIB2_IF_ADMIN_STATUS_DOWN;
+        break;
+    case eIfOperStatus:
+        pxValue->ucType = BER_INTEGER;
+        pxValue->ulValue = (pxIf->xLinkUp != pdFALSE) ? MIB2_IF_OPER_STATUS_UP : MIB2_IF_OPER_STATUS_DOWN;
+        break;
+    case eIfLastChange:
+        pxValue->ucType = BER_TIME_TICKS;
+        pxValue->ulValue = (uint32_t) (pxIf->xLastChange / 10u);
+        break;
+    case eIfInOctets:
+        pxValue->ulValue = pxIf->xStats.rxOctets;
+        break;
+    case eIfInUcastPkts:
+        pxValue->ulValue = pxIf->xStats.rxFrames;
+        break;
+    case eIfInDiscards:
+        pxValue->ulValue = pxIf->xStats.rxMissed + pxIf->xStats.rxBufferUnavailable;
+        break;
+    case eIfInErrors:
+        pxValue->ulValue = pxIf->xStats.rxErrors + pxIf->xStats.rxCrcErrors + pxIf->xStats.rxAlignErrors;
+        break;
+    case eIfOutOctets:
+        pxValue->ulValue = pxIf->xStats.txOctets;
+        break;
+    case eIfOutUcastPkts:
+        pxValue->ulValue = pxIf->xStats.txFrames;
+        break;
+    case eIfOutDiscards:
+        pxValue->ulValue = pxIf->xStats.txDrops;
+        break;
+    case eIfOutErrors:
+        pxValue->ulValue = pxIf->xStats.txErrors + pxIf->xStats.txUnderflows;
+        break;
+    case eIpForwarding:
+        /* notForwarding */
+        pxValue->ucType = BER_INTEGER;
+        pxValue->ulValue = 2u;
+        break;
+    case eIpDefaultTtl:
+        pxValue->ucType = BER_INTEGER;
+        pxValue->ulValue = IPV4_DEFAULT_TTL;
+        break;
+    case eIpInReceives:
+        pxValue->ulValue = xProtocolSnapshot.ipv4InReceives;
+        break;
+    case eIpInHdrErrors:
+        pxValue->ulValue = xProtocolSnapshot.ipv4InHdrErrors + xProtocolSnapshot.ipv4InChecksumErrors;
+        break;
+    case eIpInDelivers:
+        pxValue->ulValue = xProtocolSnapshot.ipv4InDelivers;
+        break;
+    case eIpOutRequests:
+        pxValue->ulValue = xProtocolSnapshot.ipv4OutRequests;
+        break;
+    case eIpReasmOks:
+        pxValue->ulValue = xProtocolSnapshot.ipv4ReasmOks;
+        break;
+    case eIpReasmFails:
+        pxValue->ulValue = xProtocolSnapshot.ipv4ReasmTimeouts + xProtocolSnapshot.ipv4ReasmQueueFull +
+                           xProtocolSnapshot.ipv4ReasmFails;
+        break;
+    case eTcpRtoAlgorithm:
+        pxValue->ucType = BER_INTEGER;
+        pxValue->ulValue = SNMP_TCP_RTO_VANJ;
+        break;
+    case eTcpRtoMin:
+        pxValue->ucType = BER_INTEGER;
+        pxValue->ulValue = TCP_MIN_RTO;
+        break;
+    case eTcpRtoMax:
+        pxValue->ucType = BER_INTEGER;
+        pxValue->ulValue = TCP_MAX_RTO;
+        break;
+    case eTcpMaxConn:
+        pxValue->ucType = BER_INTEGER;
+        pxValue->ulValue = SOCKET_MAX_COUNT;
+        break;
+    case eTcpCurrEstab:
+        pxValue->ucType = BER_GAUGE32;
+        pxValue->ulValue = ulTcpEstablished;
+        break;
+    case eTcpInSegs:
+        pxValue->ulValue = xProtocolSnapshot.tcpInSegs;
+        break;
+    case eTcpOutSegs:
+        pxValue->ulValue = xProtocolSnapshot.tcpOutSegs;
+        break;
+    case eTcpRetransSegs:
+        pxValue->ulValue = xProtocolSnapshot.tcpRetransSegs;
+        break;
+    case eTcpConnState:
+        pxValue->ucType = BER_INTEGER;
+        pxValue->ulValue = pxRow->ucState;
+        break;
+    case eTcpConnLocalAddress:
+    case eTcpConnRemAddress:
+        for (i = 0; i < 4u; i++)
+        {
+            ucAddress[i] = (uint8_t) pxRow->ulIndex[(pxObject->ucValue == eTcpConnLocalAddress) ? i : 5u + i];
+        }
+        pxValue->ucType = BER_IP_ADDRESS;
+        pxValue->pvData = ucAddress;
+        pxValue->xLength = sizeof(ucAddress);
+        break;
+    case eTcpConnLocalPort:
+        pxValue->ucType = BER_INTEGER;
+        pxValue->ulValue = pxRow->ulIndex[4];
+        break;
+    case eTcpConnRemPort:
+        pxValue->ucType = BER_INTEGER;
+        pxValue->ulValue = pxRow->ulIndex[9];
+        break;
+    case eTcpInErrs:
+        pxValue->ulValue = xProtocolSnapshot.tcpInErrs + xProtocolSnapshot.tcpInChecksumErrors;
+        break;
+    case eUdpInDatagrams:
+        pxValue->ulValue = xProtocolSnapshot.udpInDatagrams;
+        break;
+    case eUdpNoPorts:
+        pxValue->ulValue = xProtocolSnapshot.udpNoPorts;
+        break;
+    case eUdpInErrors:
+        pxValue->ulValue = xProtocolSnapshot.udpInErrors + xProtocolSnapshot.udpInChecksumErrors +
+                           xProtocolSnapshot.udpQueueFullDrops + xProtocolSnapshot.udpNoBufferDrops;
+        break;
+    default:
+        pxValue->ulValue = xProtocolSnapshot.udpOutDatagrams;
+        break;
+    }
+}
+
+/* ---- BER codec ---- */
+
+static BaseType_t prvReadTlv(const uint8_t **ppucPos, const uint8_t *pucEnd, uint8_t *pucTag, size_t *pxLength)
+{
+    const uint8_t *pucPos = *ppucPos;
+    size_t xLength;
+
+    if (pucEnd - pucPos < 2)
+    {
+        return pdFALSE;
+    }
+
+    *pucTag = *pucPos++;
+    xLength = *pucPos++;
+    if (xLength == 0x81u && pucPos < pucEnd)
+    {
+        xLength = *pucPos++;
+    }
+    else if (xLength == 0x82u && pucEnd - pucPos >= 2)
+    {
+        xLength = ((size_t) pucPos[0] << 8) | pucPos[1];
+        pucPos += 2;
+    }
+    else if (xLength >= 0x80u)
+    {
+        return pdFALSE;
+    }
+
+    if ((size_t) (pucEnd - pucPos) < xLength)
+    {
+        return pdFALSE;
+    }
+
+    *ppucPos = pucPos;
+    *pxLength = xLength;
+    return pdTRUE;
+}
+
+static BaseType_t prvReadInteger(const uint8_t *pucValue, size_t xLength, int32_t *plValue)
+{
+    uint32_t ulValue;
+    size_t i;
+
+    if (xLength == 0 || xLength > 4u)
+    {
+        return pdFALSE;
+    }
+
+    ulValue = ((pucValue[0] & 0x80u) != 0) ? 0xFFFFFFFFu : 0u;
+    for (i = 0; i < xLength; i++)
+    {
+        ulValue = (ulValue << 8) | pucValue[i];
+    }
+
+    *plValue = (int32_t) ulValue;
+    return pdTRUE;
+}
+
+static BaseType_t prvReadOid(const uint8_t *pucValue, size_t xLength, SnmpName_t *pxName)
+{
+    uint32_t ulSubId = 0;
+    size_t i;
+
+    pxName->xLength = 0;
+    for (i = 0; i < xLength; i++)
+    {
+        if (ulSubId > (0xFFFFFFFFu >> 7))
+        {
+            return pdFALSE;
+        }
+        ulSubId = (ulSubId << 7) | (pucValue[i] & 0x7Fu);
+        if ((pucValue[i] & 0x80u) != 0)
+        {
+            continue;
+        }
+
+        /* The first value holds the first two sub-identifiers */
+        if (pxName->xLength == 0)
+        {
+            pxName->ulSubIds[0] = (ulSubId < 80u) ? ulSubId / 40u : 2u;
+            pxName->ulSubIds[1] = ulSubId - 40u * pxName->ulSubIds[0];
+            pxName->xLength = 2u;
+        }
+        else if (pxName->xLength < SNMP_MAX_SUBIDS)
+        {
+            pxName->ulSubIds[pxName->xLength++] = ulSubId;
+        }
+        else
+        {
+            return pdFALSE;
+        }
+        ulSubId = 0;
+    }
+
+    return (pxName->xLength >= 2u && (pucValue[xLength - 1u] & 0x80u) == 0) ? pdTRUE : pdFALSE;
+}
+
+static size_t prvLengthSize(size_t xLength)
+{
+    return (xLength < 0x80u) ? 1u : (xLength < 0x100u) ? 2u : 3u;
+}
+
+static uint8_t *prvPutHeader(uint8_t *pucOut, uint8_t ucTag, size_t xLength)
+{
+    *pucOut++ = ucTag;
+    if (xLength >= 0x100u)
+    {
+        *pucOut++ = 0x82u;
+        *pucOut++ = (uint8_t) (xLength >> 8);
+    }
+    else if (xLength >= 0x80u)
+    {
+        *pucOut++ = 0x81u;
+    }
+    *pucOut++ = (uint8_t) xLength;
+
+    return pucOut;
+}
+
+/* Unsigned value as INTEGER or an application type, in as few bytes as it
+   takes, with a leading zero when the top bit is set */
+static uint8_t *prvPutUnsigned(uint8_t *pucOut, uint8_t ucTag, uint32_t ulValue)
+{
+    uint8_t ucBytes[5];
+    size_t xLength = 0;
+    int32_t i;
+
+    for (i = 3; i >= 0; i--)
+    {
+        if (xLength > 0 || ((ulValue >> (8 * i)) & 0xFFu) != 0 || i == 0)
+        {
+            if (xLength == 0 && ((ulValue >> (8 * i)) & 0x80u) != 0)
+            {
+                ucBytes[xLength++] = 0;
+            }
+            ucBytes[xLength++] = (uint8_t) (ulValue >> (8 * i));
+        }
+    }
+
+    pucOut = prvPutHeader(pucOut, ucTag, xLength);
+    memcpy(pucOut, ucBytes, xLength);
+
+    return pucOut + xLength;
+}
+
+static uint8_t *prvPutOid(uint8_t *pucOut, const uint32_t *pulSubIds, size_t xSubIds)
+{
+    uint8_t ucBytes[SNMP_MAX_TLV];
+    uint32_t ulSubId;
+    size_t xLength = 0;
+    size_t i;
+    int32_t lShift;
+
+    for (i = 1; i < xSubIds; i++)
+    {
+        ulSubId = (i == 1u) ? pulSubIds[0] * 40u + pulSubIds[1] : pulSubIds[i];
+        for (lShift = 28; lShift > 0 && (ulSubId >> lShift) == 0; lShift -= 7)
+        {
+        }
+        for (; lShift > 0; lShift -= 7)
+        {
+            ucBytes[xLength++] = (uint8_t) (0x80u | ((ulSubId >> lShift) & 0x7Fu));
+        }
+        ucBytes[xLength++] = (uint8_t) (ulSubId & 0x7Fu);
+    }
+
+    pucOut = prvPutHeader(pucOut, BER_OID, xLength);
+    memcpy(pucOut, ucBytes, xLength);
+
+    return pucOut + xLength;
+}
+
+/* Variable binding of a name and a value, or of an exception when pxValue is
+   NULL; returns NULL if it does not fit before pucLimit */
+static uint8_t *prvPutVarbind(uint8_t *pucOut, const uint8_t *pucLimit, const SnmpName_t *pxName,
+                              const SnmpValue_t *pxValue, uint8_t ucException)
+{
+    uint8_t ucName[SNMP_MAX_TLV + 4u];
+    uint8_t ucValue[SNMP_MAX_TLV + 4u];
+    size_t xName;
+    size_t xValue;
+    size_t xLength;
+    uint8_t *pucEnd;
+
+    xName = (size_t) (prvPutOid(ucName, pxName->ulSubIds, pxName->xLength) - ucName);
+
+    if (pxValue == NULL)
+    {
+        pucEnd = prvPutHeader(ucValue, ucException, 0);
+    }
+    else if (pxValue->ucType == BER_OCTET_STRING || pxValue->ucType == BER_IP_ADDRESS)
+    {
+        pucEnd = prvPutHeader(ucValue, pxValue->ucType, MIN(pxValue->xLength, SNMP_MAX_TLV));
+        memcpy(pucEnd, pxValue->pvData, MIN(pxValue->xLength, SNMP_MAX_TLV));
+        pucEnd += MIN(pxValue->xLength, SNMP_MAX_TLV);
+    }
+    else if (pxValue->ucType == BER_OID)
+    {
+        pucEnd = prvPutOid(ucValue, pxValue->pulOid, pxValue->xLength);
+    }
+    else
+    {
+        pucEnd = prvPutUnsigned(ucValue, pxValue->ucType, pxValue->ulValue);
+    }
+    xValue = (size_t) (pucEnd - ucValue);
+
+    xLength = xName + xValue;
+    if ((size_t) (pucLimit - pucOut) < 1u + prvLengthSize(xLength) + xLength)
+    {
+        return NULL;
+    }
+
+    pucOut = prvPutHeader(pucOut, BER_SEQUENCE, xLength);
+    memcpy(pucOut, ucName, xName);
+    memcpy(pucOut + xName, ucValue, xValue);
+
+    return pucOut + xLength;
+}
+
+/* ---- Request handling ---- */
+
+typedef struct
+{
+    int32_t lVersion;
+    const uint8_t *pucCommunity;
+    size_t xCommunityLength;
+    uint8_t ucPduType;
+    const uint8_t *pucRequestId;    /* INTEGER value, echoed as received */
+    size_t xRequestIdLength;
+    int32_t lErrorStatus;           /* Non-repeaters of a GetBulk */
+    int32_t lErrorIndex;            /* Max-repetitions of a GetBulk */
+    const uint8_t *pucVarbinds;     /* The list, echoed on errors */
+    size_t xVarbindsLength;
+    UBaseType_t uxNames;
+} SnmpRequest_t;
+
+/* pdFALSE if the message is malformed */
+static BaseType_t prvParseRequest(const uint8_t *pucData, size_t xLength, SnmpRequest_t *pxRequest)
+{
+    const uint8_t *pucPos = pucData;
+    const uint8_t *pucEnd = pucData + xLength;
+    const uint8_t *pucListEnd;
+    const uint8_t *pucValue;
+    uint8_t ucTag;
+    size_t xValue;
+
+    memset(pxRequest, 0, sizeof(*pxRequest));
+
+    if (prvReadTlv(&pucPos, pucEnd, &ucTag, &xValue) == pdFALSE || ucTag != BER_SEQUENCE)
+    {
+        return pdFALSE;
+    }
+    pucEnd = pucPos + xValue;
+
+    if (prvReadTlv(&pucPos, pucEnd, &ucTag, &xValue) == pdFALSE || ucTag != BER_INTEGER ||
+        prvReadInteger(pucPos, xValue, &pxRequest->lVersion) == pdFALSE)
+    {
+        return pdFALSE;
+    }
+    pucPos += xValue;
+
+    if (prvReadTlv(&pucPos, pucEnd, &ucTag, &xValue) == pdFALSE || ucTag != BER_OCTET_STRING)
+    {
+        return pdFALSE;
+    }
+    pxRequest->pucCommunity = pucPos;
+    pxRequest->xCommunityLength = xValue;
+    pucPos += xValue;
+
+    if (prvReadTlv(&pucPos, pucEnd, &ucTag, &xValue) == pdFALSE || (ucTag & 0xE0u) != BER_CONTEXT_PDU)
+    {
+        return pdFALSE;
+    }
+    pxRequest->ucPduType = ucTag & 0x1Fu;
+    pucEnd = pucPos + xValue;
+
+    if (prvReadTlv(&pucPos, pucEnd, &ucTag, &xValue) == pdFALSE || ucTag != BER_INTEGER ||
+        xValue == 0 || xValue > 4u)
+    {
+        return pdFALSE;
+    }
+    pxRequest->pucRequestId = pucPos;
+    pxRequest->xRequestIdLength = xValue;
+    pucPos += xValue;
+
+    if (prvReadTlv(&pucPos, pucEnd, &ucTag, &xValue) == pdFALSE || ucTag != BER_INTEGER ||
+        prvReadInteger(pucPos, xValue, &pxRequest->lErrorStatus) == pdFALSE)
+    {
+        return pdFALSE;
+    }
+    pucPos += xValue;
+
+    if (prvReadTlv(&pucPos, pucEnd, &ucTag, &xValue) == pdFALSE || ucTag != BER_INTEGER ||
+        prvReadInteger(pucPos, xValue, &pxRequest->lErrorIndex) == pdFALSE)
+    {
+        return pdFALSE;
+    }
+    pucPos += xValue;
+
+    if (prvReadTlv(&pucPos, pucEnd, &ucTag, &xValue) == pdFALSE || ucTag != BER_SEQUENCE)
+    {
+        return pdFALSE;
+    }
+    pxRequest->pucVarbinds = pucPos;
+    pxRequest->xVarbindsLength = xValue;
+    pucListEnd = pucPos + xValue;
+
+    while (pucPos < pucListEnd)
+    {
+        if (pxRequest->uxNames == SNMP_AGENT_MAX_VARBINDS ||
+            prvReadTlv(&pucPos, pucListEnd, &ucTag, &xValue) == pdFALSE || ucTag != BER_SEQUENCE)
+        {
+            return pdFALSE;
+        }
+        pucEnd = pucPos + xValue;
+
+        pucValue = pucPos;
+        if (prvReadTlv(&pucValue, pucEnd, &ucTag, &xValue) == pdFALSE || ucTag != BER_OID ||
+            prvReadOid(pucValue, xValue, &xNames[pxRequest->uxNames]) == pdFALSE)
+        {
+            return pdFALSE;
+        }
+        pxRequest->uxNames++;
+        pucPos = pucEnd;
+    }
+
+    return pdTRUE;
+}
+
+/* Message around a variable binding list; returns its length */
+static size_t prvPutResponse(const SnmpRequest_t *pxRequest, uint32_t ulErrorStatus, uint32_t ulErrorIndex,
+                             const uint8_t *pucVarbinds, size_t xVarbindsLength)
+{
+    size_t xPdu;
+    size_t xMessage;
+    uint8_t ucFields[16];
+    size_t xFields;
+    uint8_t *pucOut = ucTx;
+
+    /* Error status and index, after the request identifier */
+    xFields = (size_t) (prvPutUnsigned(prvPutUnsigned(ucFields, BER_INTEGER, ulErrorStatus), BER_INTEGER,
+                                       ulErrorIndex) - ucFields);
+
+    xPdu = 2u + pxRequest->xRequestIdLength + xFields + 1u + prvLengthSize(xVarbindsLength) + xVarbindsLength;
+    xMessage = 3u + 1u + prvLengthSize(pxRequest->xCommunityLength) + pxRequest->xCommunityLength +
+               1u + prvLengthSize(xPdu) + xPdu;
+    if (1u + prvLengthSize(xMessage) + xMessage > sizeof(ucTx))
+    {
+        return 0;
+    }
+
+    pucOut = prvPutHeader(pucOut, BER_SEQUENCE, xMessage);
+    pucOut = prvPutUnsigned(pucOut, BER_INTEGER, (uint32_t) pxRequest->lVersion);
+    pucOut = prvPutHeader(pucOut, BER_OCTET_STRING, pxRequest->xCommunityLength);
+    memcpy(pucOut, pxRequest->pucCommunity, pxRequest->xCommunityLength);
+    pucOut += pxRequest->xCommunityLength;
+    pucOut = prvPutHeader(pucOut, BER_CONTEXT_PDU | SNMP_PDU_GET_RESPONSE, xPdu);
+    pucOut = prvPutHeader(pucOut, BER_INTEGER, pxRequest->xRequestIdLength);
+    memcpy(pucOut, pxRequest->pucRequestId, pxRequest->xRequestIdLength);
+    pucOut += pxRequest->xRequestIdLength;
+    memcpy(pucOut, ucFields, xFields);
+    pucOut += xFields;
+    pucOut = prvPutHeader(pucOut, BER_SEQUENCE, xVarbindsLength);
+    memcpy(pucOut, pucVarbinds, xVarbindsLength);
+    pucOut += xVarbindsLength;
+
+    return (size_t) (pucOut - ucTx);
+}
+
+/* Room left for the variable bindings of a response */
+static const uint8_t *prvVarbindLimit(const SnmpRequest_t *pxRequest)
+{
+    /* Message, version, community, PDU, request identifier, error fields
+       and list headers, at their longest */
+    size_t xOverhead = 4u + 3u + 3u + pxRequest->xCommunityLength + 4u + 6u + 12u + 4u;
+
+    return &ucVarbinds[sizeof(ucVarbinds) - MIN(xOverhead, sizeof(ucVarbinds))];
+}
+
+/* Response to a Get, GetNext or GetBulk; returns its length */
+static size_t prvHandleRead(const SnmpRequest_t *pxRequest)
+{
+    const uint8_t *pucLimit = prvVarbindLimit(pxRequest);
+    const SnmpObject_t *pxObject;
+    SnmpValue_t xValue;
+    uint8_t *pucOut = ucVarbinds;
+    uint8_t *pucNext;
+    uint8_t ucException;
+    UBaseType_t uxNonRepeaters = pxRequest->uxNames;
+    UBaseType_t uxRepetitions = 0;
+    UBaseType_t uxNth = 0;
+    UBaseType_t uxEnded;
+    UBaseType_t uxRep;
+    UBaseType_t i;
+    BaseType_t xNoInstance;
+    BaseType_t xV1 = (pxRequest->lVersion == SNMP_VERSION_1) ? pdTRUE : pdFALSE;
+
+    prvSnapshot();
+
+    if (pxRequest->ucPduType == SNMP_PDU_GET_BULK_REQUEST)
+    {
+        uxNonRepeaters = (UBaseType_t) MIN(MAX(pxRequest->lErrorStatus, 0), (int32_t) pxRequest->uxNames);
+        uxRepetitions = (UBaseType_t) MIN(MAX(pxRequest->lErrorIndex, 0), (int32_t) SNMP_AGENT_MAX_REPETITIONS);
+    }
+
+    /* Get and GetNext, and the non-repeaters of a GetBulk */
+    for (i = 0; i < uxNonRepeaters; i++)
+    {
+        ucException = 0;
+        if (pxRequest->ucPduType == SNMP_PDU_GET_REQUEST)
+        {
+            pxObject = prvLookup(&xNames[i], &uxNth, &xNoInstance);
+            xNext = xNames[i];
+            ucException = (xNoInstance != pdFALSE) ? SNMP_EXCEPTION_NO_SUCH_INSTANCE : SNMP_EXCEPTION_NO_SUCH_OBJECT;
+        }
+        else
+        {
+            pxObject = prvLookupNext(&xNames[i], &uxNth);
+            xNext = xNames[i];
+            ucException = SNMP_EXCEPTION_END_OF_MIB_VIEW;
+        }
+
+        if (pxObject == NULL)
+        {
+            if (xV1 != pdFALSE)
+            {
+                return prvPutResponse(pxRequest, SNMP_ERROR_NO_SUCH_NAME, (uint32_t) i + 1u,
+                                      pxRequest->pucVarbinds, pxRequest->xVarbindsLength);
+            }
+            pucNext = prvPutVarbind(pucOut, pucLimit, &xNext, NULL, (uint8_t) (BER_CONTEXT_EXCEPTION | ucException));
+        }
+        else
+        {
+            prvMakeName(pxObject, uxNth, &xNext);
+            prvValue(pxObject, uxNth, &xValue);
+            pucNext = prvPutVarbind(pucOut, pucLimit, &xNext, &xValue, 0);
+        }
+
+        if (pucNext == NULL)
+        {
+            xStats.ulTooBigs++;
+            return prvPutResponse(pxRequest, SNMP_ERROR_TOO_BIG, 0, NULL, 0);
+        }
+        pucOut = pucNext;
+        xStats.ulVarbindsOut++;
+    }
+
+    /* Repetitions of a GetBulk: each step from the last name returned for its
+       column; the response ends early, at a whole step, when it is full or
+       every column is past the end */
+    for (uxRep = 0; uxRep < uxRepetitions; uxRep++)
+    {
+        uxEnded = 0;
+        for (i = uxNonRepeaters; i < pxRequest->uxNames; i++)
+        {
+            pxObject = prvLookupNext(&xNames[i], &uxNth);
+            if (pxObject == NULL)
+            {
+                pucNext = prvPutVarbind(pucOut, pucLimit, &xNames[i], NULL,
+                                        BER_CONTEXT_EXCEPTION | SNMP_EXCEPTION_END_OF_MIB_VIEW);
+                uxEnded++;
+            }
+            else
+            {
+                prvMakeName(pxObject, uxNth, &xNames[i]);
+                prvValue(pxObject, uxNth, &xValue);
+                pucNext = prvPutVarbind(pucOut, pucLimit, &xNames[i], &xValue, 0);
+            }
+
+            if (pucNext == NULL)
+            {
+                break;
+            }
+            pucOut = pucNext;
+            xStats.ulVarbindsOut++;
+        }
+
+        if (i < pxRequest->uxNames || uxEnded == pxRequest->uxNames - uxNonRepeaters)
+        {
+            break;
+        }
+    }
+
+    return prvPutResponse(pxRequest, SNMP_ERROR_NONE, 0, ucVarbinds, (size_t) (pucOut - ucVarbinds));
+}
+
+/* Response to a message, 0 if there is none to send */
+static size_t prvHandleMessage(const uint8_t *pucData, size_t xLength)
+{
+    SnmpRequest_t xRequest;
+
+    if (prvParseRequest(pucData, xLength, &xRequest) == pdFALSE)
+    {
+        xStats.ulParseErrors++;
+        return 0;
+    }
+
+    if (xRequest.lVersion != SNMP_VERSION_1 && xRequest.lVersion != SNMP_VERSION_2C)
+    {
+        xStats.ulBadVersions++;
+        return 0;
+    }
+
+    if (xRequest.xCommunityLength != strlen(SNMP_AGENT_COMMUNITY) ||
+        memcmp(xRequest.pucCommunity, SNMP_AGENT_COMMUNITY, xRequest.xCommunityLength) != 0)
+    {
+        xStats.ulBadCommunities++;
+        return 0;
+    }
+
+    switch (xRequest.ucPduType)
+    {
+    case SNMP_PDU_GET_REQUEST:
+        xStats.ulGets++;
+        return prvHandleRead(&xRequest);
+    case SNMP_PDU_GET_NEXT_REQUEST:
+        xStats.ulGetNexts++;
+        return prvHandleRead(&xRequest);
+    case SNMP_PDU_GET_BULK_REQUEST:
+        if (xRequest.lVersion == SNMP_VERSION_1)
+        {
+            xStats.ulParseErrors++;
+            return 0;
+        }
+        xStats.ulGetBulks++;
+        return prvHandleRead(&xRequest);
+    case SNMP_PDU_SET_REQUEST:
+        /* Read-only: noSuchName in SNMPv1 (RFC 2576, 4.3) */
+        xStats.ulSets++;
+        return prvPutResponse(&xRequest, (xRequest.lVersion == SNMP_VERSION_1) ? SNMP_ERROR_NO_SUCH_NAME :
+                              SNMP_ERROR_NOT_WRITABLE, (xRequest.uxNames > 0) ? 1u : 0u,
+                              xRequest.pucVarbinds, xRequest.xVarbindsLength);
+    default:
+        xStats.ulParseErrors++;
+        return 0;
+    }
+}
+
+/* Token bucket: pdFALSE if the request is over the rate */
+static BaseType_t prvAdmit(void)
+{
+    static systime_t xLastRefill = 0;
+    static uint32_t ulTokensMilli = SNMP_AGENT_BURST * 1000u;
+    systime_t xNow = osGetSystemTime();
+    uint32_t ulElapsed = (uint32_t) MIN(xNow - xLastRefill, 1000u * SNMP_AGENT_BURST);
+
+    xLastRefill = xNow;
+    ulTokensMilli = MIN(ulTokensMilli + ulElapsed * SNMP_AGENT_MAX_RATE, SNMP_AGENT_BURST * 1000u);
+    if (ulTokensMilli < 1000u)
+    {
+        return pdFALSE;
+    }
+
+    ulTokensMilli -= 1000u;
+    return pdTRUE;
+}
+
+static void prvSnmpTask(void *pvParameters)
+{
+    Socket *pxSocket;
+    IpAddr xPeer;
+    uint16_t usPeerPort;
+    size_t xReceived;
+    size_t xLength;
+    error_t err;
+
+    (void) pvParameters;
+
+    pxSocket = socketOpen(SOCKET_TYPE_DGRAM, SOCKET_IP_PROTO_UDP);
+    if (pxSocket == NULL || socketBind(pxSocket, &IP_ADDR_ANY, SNMP_PORT) != NO_ERROR)
+    {
+        vTaskDelete(NULL);
+        return;
+    }
+    socketSetTimeout(pxSocket, INFINITE_DELAY);
+
+    for (;;)
+    {
+        err = socketReceiveFrom(pxSocket, &xPeer, &usPeerPort, ucRx, sizeof(ucRx), &xReceived, 0);
+        if (err != NO_ERROR)
+        {
+            continue;
+        }
+
+        xStats.ulInPkts++;
+        if (prvAdmit() == pdFALSE)
+        {
+            xStats.ulRateLimited++;
+            continue;
+        }
+
+        xLength = prvHandleMessage(ucRx, xReceived);
+        if (xLength > 0 && socketSendTo(pxSocket, &xPeer, usPeerPort, ucTx, xLength, NULL, 0) == NO_ERROR)
+        {
+            xStats.ulOutPkts++;
+        }
+    }
+}
+
+BaseType_t xSnmpAgentStart(UBaseType_t uxPriority)
+{
+    size_t i;
+
+    /* The lookups rely on the order of the table */
+    for (i = 1; i < SNMP_OBJECT_COUNT; i++)
+    {
+        if (prvCompare(xObjects[i - 1u].ulOid, xObjects[i - 1u].ucLength, xObjects[i].ulOid,
+                       xObjects[i].ucLength) >= 0)
+        {
+            return pdFAIL;
+        }
+    }
+
+    return xAppTaskCreate(xSnmpTask,
+                          prvSnmpTask,
+                          "SNMP",
+                          SNMP_AGENT_TASK_STACK_SIZE,
+                          NULL,
+                          uxPriority,
+                          NULL);
+}
+
+void vSnmpAgentGetStats(SnmpAgentStats_t *pxStats)
+{
+    *pxStats = xStats;
+}
+
+static BaseType_t prvSnmpCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    static UBaseType_t uxLine = 0;
+    SnmpAgentStats_t xSnapshot;
+
+    (void) pcCommandString;
+
+    vSnmpAgentGetStats(&xSnapshot);
+
+    switch (uxLine++)
+    {
+    case 0:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "in %lu out %lu rate-limited %lu objects %lu\r\n",
+                 (unsigned long) xSnapshot.ulInPkts, (unsigned long) xSnapshot.ulOutPkts,
+                 (unsigned long) xSnapshot.ulRateLimited, (unsigned long) SNMP_OBJECT_COUNT);
+        return pdTRUE;
+    case 1:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "get %lu getnext %lu getbulk %lu set %lu varbinds %lu\r\n",
+                 (unsigned long) xSnapshot.ulGets, (unsigned long) xSnapshot.ulGetNexts,
+                 (unsigned long) xSnapshot.ulGetBulks, (unsigned long) xSnapshot.ulSets,
+                 (unsigned long) xSnapshot.ulVarbindsOut);
+        return pdTRUE;
+    default:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "bad version %lu bad community %lu parse %lu too big %lu\r\n",
+                 (unsigned long) xSnapshot.ulBadVersions, (unsigned long) xSnapshot.ulBadCommunities,
+                 (unsigned long) xSnapshot.ulParseErrors, (unsigned long) xSnapshot.ulTooBigs);
+        uxLine = 0;
+        return pdFALSE;
+    }
+}
+
+void vSnmpAgentRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xSnmp);
+}
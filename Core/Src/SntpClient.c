@@ -0,0 +1,481 @@
+/* SntpClient.c
+ *
+ * SNTP client (see SntpClient.h). The task owns the socket, the samples and
+ * the map it publishes to MonoClock; the server is changed through
+ * xSntpClientConfigure(), and the statistics are copied out under a critical
+ * section.
+ */
+#include "SntpClient.h"
+#include "StaticAlloc.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "MonoClock.h"
+#include "PtpSlave.h"
+#include "core/net.h"
+#include "core/socket.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+/* NTP packet header (RFC 5905, 7.3) */
+#define NTP_PACKET_SIZE                48u
+#define NTP_OFFSET_STRATUM             1u
+#define NTP_OFFSET_ORIGINATE           24u
+#define NTP_OFFSET_RECEIVE             32u
+#define NTP_OFFSET_TRANSMIT            40u
+
+#define NTP_LI_UNSYNCHRONIZED          3u
+#define NTP_MODE_CLIENT                3u
+#define NTP_MODE_SERVER                4u
+#define NTP_VERSION                    4u
+#define NTP_MAX_STRATUM                15u
+
+/* Seconds from 1900 (NTP era 0) to 1970 */
+#define NTP_UNIX_OFFSET_S              2208988800ull
+
+#define SNTP_POLL_US                   ((int64_t) SNTP_CLIENT_POLL_S * 1000000)
+
+typedef struct
+{
+    int64_t llOffsetUs;
+    int64_t llDelayUs;
+} SntpSample_t;
+
+/* Server, changed by xSntpClientConfigure() */
+static IpAddr xServer;
+static volatile BaseType_t xServerSet = pdFALSE;
+
+/* Linear map of the local clock onto UTC, as published to MonoClock */
+static BaseType_t xMapValid = pdFALSE;
+static uint64_t ullMapLocalUs = 0;
+static uint64_t ullMapUtcUs = 0;
+static int32_t lFreqPpb = 0;
+static int32_t lSlewPpb = 0;
+
+/* Offset still to be absorbed by the slew, and when it was measured */
+static int64_t llPendingUs = 0;
+static uint64_t ullLastMeasureUs = 0;
+
+static uint8_t ucPacket[NTP_PACKET_SIZE + 4u];
+static SntpSample_t xSamples[SNTP_CLIENT_BURST];
+static uint32_t ulNonce = 0;
+
+static SntpClientStats_t xStats;
+
+static TaskHandle_t xSntpTask = NULL;
+APP_TASK_STORAGE(xSntpTask, SNTP_CLIENT_TASK_STACK_SIZE);
+
+static BaseType_t prvSntpCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xSntp =
+{
+    "sntp",
+    "\r\nsntp [<ip> | off]:\r\n SNTP server, offset, jitter and counters\r\n",
+    prvSntpCommand,
+    -1
+};
+
+/* UTC of a local time; the local time itself until the first sync */
+static uint64_t prvToUtc(uint64_t ullLocalUs)
+{
+    int64_t llDeltaUs = (int64_t) (ullLocalUs - ullMapLocalUs);
+
+    if (xMapValid == pdFALSE)
+    {
+        return ullLocalUs;
+    }
+
+    return ullMapUtcUs + (uint64_t) (llDeltaUs + llDeltaUs * (lFreqPpb + lSlewPpb) / 1000000000);
+}
+
+/* NTP timestamp of a packet to microseconds since 1970; a clear top bit is
+   taken as era 1 (after 2036, RFC 4330, 3) */
+static uint64_t prvNtpToUs(const uint8_t *pucTimestamp)
+{
+    uint64_t ullSeconds = LOAD32BE(pucTimestamp);
+    uint64_t ullFraction = LOAD32BE(pucTimestamp + 4);
+
+    if ((ullSeconds & 0x80000000u) == 0)
+    {
+        ullSeconds += 0x100000000ull;
+    }
+
+    return (ullSeconds - NTP_UNIX_OFFSET_S) * 1000000u + ((ullFraction * 1000000u) >> 32);
+}
+
+static uint32_t prvSqrt(uint64_t ullValue)
+{
+    uint64_t ullRoot = 0;
+    uint64_t ullBit = 1ull << 62;
+
+    while (ullBit > ullValue)
+    {
+        ullBit >>= 2;
+    }
+    while (ullBit != 0)
+    {
+        if (ullValue >= ullRoot + ullBit)
+        {
+            ullValue -= ullRoot + ullBit;
+            ullRoot = (ullRoot >> 1) + ullBit;
+        }
+        else
+        {
+            ullRoot >>= 1;
+        }
+        ullBit >>= 2;
+    }
+
+    return (uint32_t) ullRoot;
+}
+
+static void prvPublish(void)
+{
+    PtpSlaveStats_t xPtp;
+
+    /* The PTP time, when locked, is the finer reference */
+    vPtpSlaveGetStats(&xPtp);
+    if (xPtp.eState == ePtpSlave)
+    {
+        xStats.xPublished = pdFALSE;
+        return;
+    }
+
+    vMonoClockSetReference(ullMapLocalUs, ullMapUtcUs, lFreqPpb + lSlewPpb);
+    xStats.xPublished = pdTRUE;
+}
+
+/* Restart the map where it stands, accounting for the offset the slew
+   absorbed since its last start */
+static void prvAdvance(uint64_t ullNowUs)
+{
+    int64_t llElapsedUs = (int64_t) (ullNowUs - ullMapLocalUs);
+
+    ullMapUtcUs = prvToUtc(ullNowUs);
+    ullMapLocalUs = ullNowUs;
+    llPendingUs -= llElapsedUs * lSlewPpb / 1000000000;
+}
+
+static int32_t prvClampPpb(int64_t llPpb)
+{
+    return (int32_t) MAX(MIN(llPpb, (int64_t) SNTP_CLIENT_MAX_SLEW_PPM * 1000), -(int64_t) SNTP_CLIENT_MAX_SLEW_PPM * 1000);
+}
+
+/* Correct the map by an offset measured now */
+static void prvDiscipline(int64_t llOffsetUs, uint64_t ullNowUs)
+{
+    int64_t llElapsedUs = (int64_t) (ullNowUs - ullLastMeasureUs);
+    int64_t llErrorPpb;
+
+    if (xMapValid == pdFALSE || llOffsetUs > SNTP_CLIENT_STEP_THRESHOLD_US ||
+        llOffsetUs < -SNTP_CLIENT_STEP_THRESHOLD_US)
+    {
+        ullMapUtcUs = prvToUtc(ullNowUs) + (uint64_t) llOffsetUs;
+        ullMapLocalUs = ullNowUs;
+        lSlewPpb = 0;
+        llPendingUs = 0;
+        xMapValid = pdTRUE;
+        xStats.ulSteps++;
+    }
+    else
+    {
+        prvAdvance(ullNowUs);
+
+        /* What the slew left over beyond its plan is the frequency error */
+        if (llElapsedUs > 0)
+        {
+            llErrorPpb = (llOffsetUs - llPendingUs) * 1000000000 / llElapsedUs;
+            lFreqPpb = prvClampPpb(lFreqPpb + (llErrorPpb >> SNTP_CLIENT_FREQ_SHIFT));
+        }
+
+        /* Absorb the offset by the next poll */
+        lSlewPpb = prvClampPpb(lFreqPpb + llOffsetUs * 1000000000 / SNTP_POLL_US) - lFreqPpb;
+        llPendingUs = llOffsetUs;
+    }
+
+    ullLastMeasureUs = ullNowUs;
+    prvPublish();
+}
+
+/* One request and its answer: pdFALSE if none valid came in time */
+static BaseType_t prvSample(Socket *pxSocket, const IpAddr *pxServer, SntpSample_t *pxSample)
+{
+    SocketMsg xMessage;
+    uint64_t ullT1;
+    uint64_t ullT2;
+    uint64_t ullT3;
+    uint64_t ullT4;
+    uint8_t ucNonce[8];
+    uint8_t ucMode;
+
+    /* The transmit timestamp is only echoed back: a nonce, not the time */
+    ulNonce++;
+    STORE32BE(ulNonce, ucNonce);
+    STORE32BE((uint32_t) ullMonoClockNowUs(), ucNonce + 4);
+
+    memset(ucPacket, 0, NTP_PACKET_SIZE);
+    ucPacket[0] = (uint8_t) ((NTP_VERSION << 3) | NTP_MODE_CLIENT);
+    memcpy(ucPacket + NTP_OFFSET_TRANSMIT, ucNonce, sizeof(ucNonce));
+
+    ullT1 = ullMonoClockNowUs();
+    if (socketSendTo(pxSocket, pxServer, SNTP_CLIENT_PORT, ucPacket, NTP_PACKET_SIZE, NULL, 0) != NO_ERROR)
+    {
+        return pdFALSE;
+    }
+    xStats.ulRequests++;
+
+    for (;;)
+    {
+        xMessage = SOCKET_DEFAULT_MSG;
+        xMessage.data = ucPacket;
+        xMessage.size = sizeof(ucPacket);
+        if (socketReceiveMsg(pxSocket, &xMessage, 0) != NO_ERROR)
+        {
+            xStats.ulTimeouts++;
+            return pdFALSE;
+        }
+
+        /* Late answers to an earlier request, or another sender */
+        if (xMessage.length < NTP_PACKET_SIZE || !ipCompAddr(&xMessage.srcIpAddr, pxServer) ||
+            memcmp(ucPacket + NTP_OFFSET_ORIGINATE, ucNonce, sizeof(ucNonce)) != 0)
+        {
+            continue;
+        }
+        break;
+    }
+    xStats.ulResponses++;
+
+    /* Stratum 0 is a kiss-o'-death */
+    ucMode = ucPacket[0] & 0x07u;
+    if (ucMode != NTP_MODE_SERVER || (ucPacket[0] >> 6) == NTP_LI_UNSYNCHRONIZED ||
+        ucPacket[NTP_OFFSET_STRATUM] == 0 || ucPacket[NTP_OFFSET_STRATUM] > NTP_MAX_STRATUM ||
+        LOAD32BE(ucPacket + NTP_OFFSET_TRANSMIT) == 0)
+    {
+        xStats.ulRejected++;
+        return pdFALSE;
+    }
+
+    /* The driver's receive time, else the time the task got the answer */
+    ullT4 = (xMessage.rxTime != 0) ? xMessage.rxTime : ullMonoClockNowUs();
+    ullT1 = prvToUtc(ullT1);
+    ullT4 = prvToUtc(ullT4);
+    ullT2 = prvNtpToUs(ucPacket + NTP_OFFSET_RECEIVE);
+    ullT3 = prvNtpToUs(ucPacket + NTP_OFFSET_TRANSMIT);
+
+    pxSample->llOffsetUs = ((int64_t) (ullT2 - ullT1) + (int64_t) (ullT3 - ullT4)) / 2;
+    pxSample->llDelayUs = MAX((int64_t) (ullT4 - ullT1) - (int64_t) (ullT3 - ullT2), 0);
+    xStats.ucStratum = ucPacket[NTP_OFFSET_STRATUM];
+
+    return pdTRUE;
+}
+
+static void prvPoll(Socket *pxSocket)
+{
+    IpAddr xAddr;
+    UBaseType_t uxSamples = 0;
+    UBaseType_t uxBest = 0;
+    UBaseType_t i;
+    uint64_t ullSquares = 0;
+    int64_t llDeviation;
+    SocketMsg xMessage;
+
+    taskENTER_CRITICAL();
+    xAddr = xServer;
+    taskEXIT_CRITICAL();
+
+    /* Answers which came after their request timed out */
+    do
+    {
+        xMessage = SOCKET_DEFAULT_MSG;
+        xMessage.data = ucPacket;
+        xMessage.size = sizeof(ucPacket);
+    } while (socketReceiveMsg(pxSocket, &xMessage, SOCKET_FLAG_DONT_WAIT) == NO_ERROR);
+
+    xStats.ulPolls++;
+    for (i = 0; i < SNTP_CLIENT_BURST; i++)
+    {
+        if (i > 0)
+        {
+            vTaskDelay(pdMS_TO_TICKS(SNTP_CLIENT_BURST_SPACING_MS));
+        }
+
+        if (prvSample(pxSocket, &xAddr, &xSamples[uxSamples]) != pdFALSE)
+        {
+            if (xSamples[uxSamples].llDelayUs < xSamples[uxBest].llDelayUs)
+            {
+                uxBest = uxSamples;
+            }
+            uxSamples++;
+        }
+    }
+
+    if (uxSamples == 0)
+    {
+        /* End the slew, which was planned for one poll only */
+        if (xMapValid != pdFALSE)
+        {
+            prvAdvance(ullMonoClockNowUs());
+            lSlewPpb = 0;
+            prvPublish();
+        }
+        return;
+    }
+
+    for (i = 0; i < uxSamples; i++)
+    {
+        llDeviation = xSamples[i].llOffsetUs - xSamples[uxBest].llOffsetUs;
+        ullSquares += (uint64_t) (llDeviation * llDeviation);
+    }
+
+    prvDiscipline(xSamples[uxBest].llOffsetUs, ullMonoClockNowUs());
+
+    taskENTER_CRITICAL();
+    xStats.xSynchronized = pdTRUE;
+    xStats.ulServerAddr = xAddr.ipv4Addr;
+    xStats.llOffsetUs = xSamples[uxBest].llOffsetUs;
+    xStats.ulDelayUs = (uint32_t) xSamples[uxBest].llDelayUs;
+    xStats.ulJitterUs = (uxSamples > 1u) ? prvSqrt(ullSquares / (uxSamples - 1u)) : 0u;
+    xStats.lFreqPpb = lFreqPpb;
+    xStats.lRatePpb = lFreqPpb + lSlewPpb;
+    taskEXIT_CRITICAL();
+}
+
+static void prvSntpTask(void *pvParameters)
+{
+    Socket *pxSocket;
+
+    (void) pvParameters;
+
+    pxSocket = socketOpen(SOCKET_TYPE_DGRAM, SOCKET_IP_PROTO_UDP);
+    if (pxSocket == NULL)
+    {
+        vTaskDelete(NULL);
+        return;
+    }
+    socketSetTimeout(pxSocket, SNTP_CLIENT_TIMEOUT_MS);
+
+    for (;;)
+    {
+        if (xServerSet == pdFALSE)
+        {
+            (void) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        prvPoll(pxSocket);
+        (void) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SNTP_CLIENT_POLL_S * 1000u));
+    }
+}
+
+BaseType_t xSntpClientStart(UBaseType_t uxPriority)
+{
+    return xAppTaskCreate(xSntpTask,
+                          prvSntpTask,
+                          "SNTP",
+                          SNTP_CLIENT_TASK_STACK_SIZE,
+                          NULL,
+                          uxPriority,
+                          &xSntpTask);
+}
+
+BaseType_t xSntpClientConfigure(const char *pcAddress)
+{
+    IpAddr xAddr;
+
+    if (pcAddress == NULL)
+    {
+        xServerSet = pdFALSE;
+        return pdPASS;
+    }
+
+    if (ipStringToAddr(pcAddress, &xAddr) != NO_ERROR || xAddr.length != sizeof(Ipv4Addr))
+    {
+        return pdFAIL;
+    }
+
+    taskENTER_CRITICAL();
+    xServer = xAddr;
+    taskEXIT_CRITICAL();
+
+    xServerSet = pdTRUE;
+    if (xSntpTask != NULL)
+    {
+        xTaskNotifyGive(xSntpTask);
+    }
+    return pdPASS;
+}
+
+void vSntpClientGetStats(SntpClientStats_t *pxStats)
+{
+    taskENTER_CRITICAL();
+    *pxStats = xStats;
+    taskEXIT_CRITICAL();
+}
+
+static BaseType_t prvSntpCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    static UBaseType_t uxLine = 0;
+    static SntpClientStats_t xReport;
+    const char *pcParameter;
+    BaseType_t xLength;
+    char cAddr[40];
+
+    if (uxLine == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xLength);
+        if (pcParameter != NULL)
+        {
+            if (xLength == 3 && strncmp(pcParameter, "off", 3) == 0)
+            {
+                (void) xSntpClientConfigure(NULL);
+                snprintf(pcWriteBuffer, xWriteBufferLen, "SNTP stopped\r\n");
+                return pdFALSE;
+            }
+
+            if ((size_t) xLength >= sizeof(cAddr))
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid address\r\n");
+                return pdFALSE;
+            }
+            memcpy(cAddr, pcParameter, xLength);
+            cAddr[xLength] = '\0';
+
+            if (xSntpClientConfigure(cAddr) != pdPASS)
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid address\r\n");
+                return pdFALSE;
+            }
+            snprintf(pcWriteBuffer, xWriteBufferLen, "SNTP server %s\r\n", cAddr);
+            return pdFALSE;
+        }
+
+        vSntpClientGetStats(&xReport);
+    }
+
+    switch (uxLine++)
+    {
+    case 0:
+        ipv4AddrToString(xReport.ulServerAddr, cAddr);
+        snprintf(pcWriteBuffer, xWriteBufferLen, "sntp: %s server=%s stratum=%u reference=%s\r\n",
+                 (xServerSet == pdFALSE) ? "off" : (xReport.xSynchronized != pdFALSE) ? "synchronized" : "unsynchronized",
+                 cAddr, (unsigned int) xReport.ucStratum, (xReport.xPublished != pdFALSE) ? "utc" : "none/ptp");
+        return pdTRUE;
+    case 1:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "offset=%ld us delay=%lu us jitter=%lu us freq=%ld ppb rate=%ld ppb\r\n",
+                 (long) xReport.llOffsetUs, (unsigned long) xReport.ulDelayUs, (unsigned long) xReport.ulJitterUs,
+                 (long) xReport.lFreqPpb, (long) xReport.lRatePpb);
+        return pdTRUE;
+    default:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "polls=%lu requests=%lu responses=%lu timeouts=%lu rejected=%lu steps=%lu\r\n",
+                 (unsigned long) xReport.ulPolls, (unsigned long) xReport.ulRequests,
+                 (unsigned long) xReport.ulResponses, (unsigned long) xReport.ulTimeouts,
+                 (unsigned long) xReport.ulRejected, (unsigned long) xReport.ulSteps);
+        uxLine = 0;
+        return pdFALSE;
+    }
+}
+
+void vSntpClientRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xSntp);
+}
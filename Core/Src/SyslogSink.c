@@ -0,0 +1,458 @@
+/* SyslogSink.c
+ *
+ * Batching, rate limiting and sending of the remote log (see SyslogSink.h).
+ * Everything but the configuration runs in the log task, so that the batch
+ * and the token buckets need no lock.
+ */
+#include "SyslogSink.h"
+#include "DeferredLog.h"
+#include "MonoClock.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "core/net.h"
+#include "core/socket.h"
+#include "syslog/syslog_client.h"
+#include "date_time.h"
+#include "debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if (SYSLOG_SINK == 1)
+
+/* Token bucket of a source, in thousandths of a message */
+typedef struct
+{
+    char cName[configMAX_TASK_NAME_LEN];
+    uint32_t ulCredit;
+    TickType_t xLastRefill;
+    uint32_t ulSuppressed;          /* Messages dropped since the last one sent */
+} SyslogSource_t;
+
+/* Collector, changed by xSyslogSinkConfigure() */
+static IpAddr xSinkHost;
+static uint16_t usSinkPort = 0;
+static volatile BaseType_t xSinkEnabled = pdFALSE;
+static volatile BaseType_t xSinkReset = pdFALSE;
+
+static volatile uint32_t ulSinkRate = SYSLOG_SINK_RATE;
+static volatile uint32_t ulSinkBurst = SYSLOG_SINK_BURST;
+
+static SyslogSource_t xSources[SYSLOG_SINK_MAX_SOURCES];
+static SyslogSinkStats_t xSinkStats;
+static uint32_t ulSinkSequence = 0;
+
+static Socket *pxSinkSocket = NULL;
+static char cBatch[SYSLOG_SINK_DATAGRAM_SIZE];
+static size_t xBatchUsed = 0;
+static uint32_t ulBatchCount = 0;
+static TickType_t xBatchStart = 0;
+static char cMessage[LOG_LINE_MAX + 128];
+
+/* Date and time of day of the last timestamp */
+static DateTimeCache xSinkDateCache = { -1, -1, "", "" };
+static char cTimestamp[DATE_TIME_TIMESTAMP_SIZE];
+
+static BaseType_t prvSyslogCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xSyslog =
+{
+    "syslog",
+    "\r\nsyslog [<ip> [<port>] | off | rate <per-second> [<burst>]]:\r\n Remote log collector, rate limit and counters\r\n",
+    prvSyslogCommand,
+    -1
+};
+
+/* Severity of a TRACE_LEVEL_xxx */
+static uint32_t prvSeverity(uint8_t ucLevel)
+{
+    switch (ucLevel)
+    {
+    case TRACE_LEVEL_FATAL:
+        return SYSLOG_SEVERITY_CRITICAL;
+    case TRACE_LEVEL_ERROR:
+        return SYSLOG_SEVERITY_ERROR;
+    case TRACE_LEVEL_WARNING:
+        return SYSLOG_SEVERITY_WARNING;
+    case TRACE_LEVEL_INFO:
+        return SYSLOG_SEVERITY_INFO;
+    default:
+        return SYSLOG_SEVERITY_DEBUG;
+    }
+}
+
+static SyslogSource_t *prvSource(const char *pcName, size_t xLength)
+{
+    SyslogSource_t *pxSource;
+    int i;
+
+    xLength = MIN(xLength, sizeof(xSources[0].cName) - 1u);
+
+    for (i = 0; i < SYSLOG_SINK_MAX_SOURCES; i++)
+    {
+        pxSource = &xSources[i];
+        if (pxSource->cName[0] == '\0')
+        {
+            memcpy(pxSource->cName, pcName, xLength);
+            pxSource->cName[xLength] = '\0';
+            pxSource->ulCredit = ulSinkBurst * 1000u;
+            pxSource->xLastRefill = xTaskGetTickCount();
+            return pxSource;
+        }
+        if (strlen(pxSource->cName) == xLength && strncmp(pxSource->cName, pcName, xLength) == 0)
+        {
+            return pxSource;
+        }
+    }
+
+    /* Sources past the table share the last bucket */
+    return &xSources[SYSLOG_SINK_MAX_SOURCES - 1];
+}
+
+/* Take one message from the bucket of a source */
+static BaseType_t prvAdmit(SyslogSource_t *pxSource)
+{
+    TickType_t xNow = xTaskGetTickCount();
+    uint32_t ulElapsed = (uint32_t) ((xNow - pxSource->xLastRefill) * portTICK_PERIOD_MS);
+    uint32_t ulRate = ulSinkRate;
+    uint32_t ulCap = ulSinkBurst * 1000u;
+
+    if (ulRate == 0)
+    {
+        return pdTRUE;
+    }
+
+    /* One message per second and per unit of rate, up to the burst */
+    if (ulElapsed > 0)
+    {
+        pxSource->xLastRefill = xNow;
+        if (ulElapsed >= ulCap / ulRate)
+        {
+            pxSource->ulCredit = ulCap;
+        }
+        else
+        {
+            pxSource->ulCredit = MIN(ulCap, pxSource->ulCredit + ulElapsed * ulRate);
+        }
+    }
+
+    if (pxSource->ulCredit < 1000u)
+    {
+        return pdFALSE;
+    }
+
+    pxSource->ulCredit -= 1000u;
+    return pdTRUE;
+}
+
+static void prvSend(void)
+{
+    IpAddr xHost;
+    uint16_t usPort;
+    error_t xError = ERROR_FAILURE;
+
+    if (pxSinkSocket == NULL)
+    {
+        pxSinkSocket = socketOpen(SOCKET_TYPE_DGRAM, SOCKET_IP_PROTO_UDP);
+    }
+
+    taskENTER_CRITICAL();
+    xHost = xSinkHost;
+    usPort = usSinkPort;
+    taskEXIT_CRITICAL();
+
+    if (pxSinkSocket != NULL)
+    {
+        /* Without the line end of the last message */
+        xError = socketSendTo(pxSinkSocket, &xHost, usPort, cBatch, xBatchUsed - 1u, NULL, 0);
+    }
+
+    if (xError == NO_ERROR)
+    {
+        xSinkStats.ulSent += ulBatchCount;
+        xSinkStats.ulDatagrams++;
+    }
+    else
+    {
+        xSinkStats.ulDropped += ulBatchCount;
+        xSinkStats.ulSendErrors++;
+    }
+
+    xBatchUsed = 0;
+    ulBatchCount = 0;
+}
+
+/* RFC 5424 TIMESTAMP of the tick a message was written at, or the NILVALUE
+ * if the clock has no reference yet */
+static const char *prvTimestamp(uint32_t ulTick)
+{
+    uint64_t ullAgeUs = (uint64_t) (xTaskGetTickCount() - ulTick) * portTICK_PERIOD_MS * 1000u;
+    uint64_t ullNowUs = ullMonoClockNowUs();
+    uint64_t ullUnixUs;
+
+    ullUnixUs = ullMonoClockToReferenceUs((ullNowUs > ullAgeUs) ? ullNowUs - ullAgeUs : 0u);
+    if (ullUnixUs == 0)
+    {
+        return "-";
+    }
+
+    (void) formatTimestamp(&xSinkDateCache, ullUnixUs, DATE_TIME_FORMAT_RFC5424, 3, cTimestamp);
+    return cTimestamp;
+}
+
+/* Format one RFC 5424 message and add it to the batch */
+static void prvAppend(uint32_t ulSeverity, const SyslogSource_t *pxSource, uint32_t ulTick,
+                      const char *pcText, size_t xLength)
+{
+    const char *pcHost = netInterface[0].hostname;
+    size_t xUsed;
+    size_t i;
+    int iLength;
+
+    if (++ulSinkSequence > 2147483647u)
+    {
+        ulSinkSequence = 1;
+    }
+
+    iLength = snprintf(cMessage, sizeof(cMessage),
+                       "<%lu>1 %s %s %s - - [meta sequenceId=\"%lu\" sysUpTime=\"%lu\"] ",
+                       (unsigned long) (SYSLOG_SINK_FACILITY * 8u + ulSeverity), prvTimestamp(ulTick),
+                       (pcHost[0] != '\0') ? pcHost : "-", pxSource->cName,
+                       (unsigned long) ulSinkSequence, (unsigned long) ((ulTick * portTICK_PERIOD_MS) / 10u));
+    if (iLength <= 0)
+    {
+        return;
+    }
+    xUsed = MIN((size_t) iLength, sizeof(cMessage) - 1u);
+
+    /* One line per message: line ends inside the text become spaces */
+    xLength = MIN(xLength, sizeof(cMessage) - 1u - xUsed);
+    for (i = 0; i < xLength; i++)
+    {
+        cMessage[xUsed++] = (pcText[i] == '\r' || pcText[i] == '\n') ? ' ' : pcText[i];
+    }
+    cMessage[xUsed++] = '\n';
+    xUsed = MIN(xUsed, sizeof(cBatch));
+
+    if (xBatchUsed + xUsed > sizeof(cBatch))
+    {
+        prvSend();
+    }
+
+    if (xBatchUsed == 0)
+    {
+        xBatchStart = xTaskGetTickCount();
+    }
+    memcpy(cBatch + xBatchUsed, cMessage, xUsed);
+    xBatchUsed += xUsed;
+    ulBatchCount++;
+
+#if (SYSLOG_SINK_BATCH == 0)
+    prvSend();
+#endif
+}
+
+void vSyslogSinkSubmit(uint8_t ucLevel, const char *pcSource, size_t xSourceLength,
+                       uint32_t ulTick, const char *pcText, size_t xLength)
+{
+    SyslogSource_t *pxSource;
+    char cNote[40];
+
+    if (xSinkReset != pdFALSE)
+    {
+        /* The collector changed: what was batched for the previous one goes */
+        xSinkReset = pdFALSE;
+        xBatchUsed = 0;
+        ulBatchCount = 0;
+    }
+
+    if (xSinkEnabled == pdFALSE)
+    {
+        return;
+    }
+
+    /* Nothing but line ends, as the end of a message cut in pieces */
+    while (xLength > 0 && (pcText[xLength - 1u] == '\r' || pcText[xLength - 1u] == '\n'))
+    {
+        xLength--;
+    }
+    if (xLength == 0)
+    {
+        return;
+    }
+
+    xSinkStats.ulSubmitted++;
+    pxSource = prvSource(pcSource, xSourceLength);
+
+    if (prvAdmit(pxSource) == pdFALSE)
+    {
+        pxSource->ulSuppressed++;
+        xSinkStats.ulRateLimited++;
+        return;
+    }
+
+    if (pxSource->ulSuppressed > 0)
+    {
+        snprintf(cNote, sizeof(cNote), "%lu messages suppressed", (unsigned long) pxSource->ulSuppressed);
+        pxSource->ulSuppressed = 0;
+        prvAppend(SYSLOG_SEVERITY_NOTICE, pxSource, ulTick, cNote, strlen(cNote));
+    }
+
+    prvAppend(prvSeverity(ucLevel), pxSource, ulTick, pcText, xLength);
+}
+
+TickType_t xSyslogSinkFlush(BaseType_t xForce)
+{
+    TickType_t xAge;
+
+    if (xBatchUsed == 0 || xSinkEnabled == pdFALSE)
+    {
+        return portMAX_DELAY;
+    }
+
+    xAge = xTaskGetTickCount() - xBatchStart;
+    if (xForce == pdFALSE && xAge < pdMS_TO_TICKS(SYSLOG_SINK_FLUSH_MS) &&
+        xBatchUsed < (sizeof(cBatch) * 3u) / 4u)
+    {
+        return pdMS_TO_TICKS(SYSLOG_SINK_FLUSH_MS) - xAge;
+    }
+
+    prvSend();
+    return portMAX_DELAY;
+}
+
+BaseType_t xSyslogSinkConfigure(const char *pcAddress, uint16_t usPort)
+{
+    IpAddr xAddr;
+
+    if (pcAddress == NULL)
+    {
+        xSinkEnabled = pdFALSE;
+        xSinkReset = pdTRUE;
+        return pdPASS;
+    }
+
+    if (ipStringToAddr(pcAddress, &xAddr) != NO_ERROR || xAddr.length != sizeof(Ipv4Addr))
+    {
+        return pdFAIL;
+    }
+
+    taskENTER_CRITICAL();
+    xSinkHost = xAddr;
+    usSinkPort = (usPort != 0) ? usPort : SYSLOG_SINK_PORT;
+    taskEXIT_CRITICAL();
+
+    xSinkReset = pdTRUE;
+    xSinkEnabled = pdTRUE;
+    return pdPASS;
+}
+
+void vSyslogSinkSetRate(uint32_t ulRate, uint32_t ulBurst)
+{
+    ulSinkBurst = MAX(ulBurst, 1u);
+    ulSinkRate = ulRate;
+}
+
+void vSyslogSinkGetStats(SyslogSinkStats_t *pxStats)
+{
+    *pxStats = xSinkStats;
+}
+
+static BaseType_t prvSyslogCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    static UBaseType_t uxLine = 0;
+    const char *pcParameter;
+    BaseType_t xLength;
+    char cAddr[40];
+    unsigned long ulValue;
+    unsigned long ulBurst;
+    IpAddr xHost;
+
+    if (uxLine == 0)
+    {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xLength);
+        if (pcParameter != NULL)
+        {
+            if (xLength == 3 && strncmp(pcParameter, "off", 3) == 0)
+            {
+                (void) xSyslogSinkConfigure(NULL, 0);
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Remote log stopped\r\n");
+                return pdFALSE;
+            }
+
+            if (xLength == 4 && strncmp(pcParameter, "rate", 4) == 0)
+            {
+                pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xLength);
+                if (pcParameter == NULL)
+                {
+                    snprintf(pcWriteBuffer, xWriteBufferLen, "Usage: syslog rate <per-second> [<burst>]\r\n");
+                    return pdFALSE;
+                }
+                ulValue = strtoul(pcParameter, NULL, 10);
+                pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 3, &xLength);
+                ulBurst = (pcParameter != NULL) ? strtoul(pcParameter, NULL, 10) : ulSinkBurst;
+                vSyslogSinkSetRate(ulValue, ulBurst);
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Rate limit: %lu/s, burst %lu\r\n",
+                         ulValue, (unsigned long) ulSinkBurst);
+                return pdFALSE;
+            }
+
+            if ((size_t) xLength >= sizeof(cAddr))
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid address\r\n");
+                return pdFALSE;
+            }
+            memcpy(cAddr, pcParameter, xLength);
+            cAddr[xLength] = '\0';
+
+            pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xLength);
+            ulValue = (pcParameter != NULL) ? strtoul(pcParameter, NULL, 10) : 0;
+            if (ulValue > 65535 || (pcParameter != NULL && ulValue == 0))
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid port\r\n");
+                return pdFALSE;
+            }
+
+            if (xSyslogSinkConfigure(cAddr, (uint16_t) ulValue) != pdPASS)
+            {
+                snprintf(pcWriteBuffer, xWriteBufferLen, "Invalid address\r\n");
+                return pdFALSE;
+            }
+            snprintf(pcWriteBuffer, xWriteBufferLen, "Remote log to %s port %u\r\n", cAddr, usSinkPort);
+            return pdFALSE;
+        }
+
+        if (xSinkEnabled != pdFALSE)
+        {
+            taskENTER_CRITICAL();
+            xHost = xSinkHost;
+            taskEXIT_CRITICAL();
+            ipAddrToString(&xHost, cAddr);
+        }
+        else
+        {
+            strcpy(cAddr, "off");
+        }
+
+        snprintf(pcWriteBuffer, xWriteBufferLen, "collector: %s port %u, rate %lu/s burst %lu, %s\r\n",
+                 cAddr, usSinkPort, (unsigned long) ulSinkRate, (unsigned long) ulSinkBurst,
+                 (SYSLOG_SINK_BATCH == 1) ? "batched" : "one message per datagram");
+        uxLine++;
+        return pdTRUE;
+    }
+
+    snprintf(pcWriteBuffer, xWriteBufferLen,
+             "submitted=%lu sent=%lu datagrams=%lu rate-limited=%lu dropped=%lu send-errors=%lu\r\n",
+             (unsigned long) xSinkStats.ulSubmitted, (unsigned long) xSinkStats.ulSent,
+             (unsigned long) xSinkStats.ulDatagrams, (unsigned long) xSinkStats.ulRateLimited,
+             (unsigned long) xSinkStats.ulDropped, (unsigned long) xSinkStats.ulSendErrors);
+    uxLine = 0;
+    return pdFALSE;
+}
+
+void vSyslogSinkRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xSyslog);
+}
+
+#endif
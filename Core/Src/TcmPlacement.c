@@ -0,0 +1,211 @@
+/* TcmPlacement.c
+ *
+ * "tcm" command: use of the ITCM and the DTCM, memory each function of the
+ * hot path runs from, and cycle counts of a few hot path operations, to
+ * compare the TCM layout with the flash one (see TcmPlacement.h).
+ *
+ * The counts come from the DWT cycle counter started by RunTimeStats. The
+ * checksums run with interrupts masked and the best of TCM_BENCH_RUNS is
+ * kept, so that they show the cost of the code rather than of whatever
+ * preempted it; the yield goes through PendSV and the scheduler, and is
+ * measured with interrupts enabled as the kernel requires.
+ */
+#include "TcmPlacement.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "stm32h7xx_hal.h"
+#include "core/net.h"
+#include "core/ip.h"
+#include "core/socket.h"
+#include "core/tcp_fsm.h"
+#include "core/udp.h"
+#include "udpard.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Sizes of the TCMs, as in the linker scripts */
+#define TCM_ITCM_SIZE                  (64u * 1024u)
+#define TCM_DTCM_SIZE                  (128u * 1024u)
+
+/* Checksum lengths: a minimal segment and a full UDP payload */
+#define TCM_BENCH_SHORT_SIZE           64u
+#define TCM_BENCH_LONG_SIZE            1472u
+
+/* Defined by the linker scripts */
+extern uint32_t _sitcm_text;
+extern uint32_t _eitcm_text;
+extern uint32_t _sdtcm_bss;
+extern uint32_t _edtcm_bss;
+
+/* Ethernet MAC vector, defined by the CycloneTCP driver */
+void ETH_IRQHandler(void);
+
+/* Functions of the hot path whose placement is reported */
+typedef struct
+{
+    const char *pcName;
+    uintptr_t xAddress;
+} TcmSymbol_t;
+
+static const TcmSymbol_t xCodeSymbols[] =
+{
+    { "ipCalcChecksum", (uintptr_t) ipCalcChecksum },
+    { "tcpProcessSegment", (uintptr_t) tcpProcessSegment },
+    { "udpProcessDatagram", (uintptr_t) udpProcessDatagram },
+    { "ETH_IRQHandler", (uintptr_t) ETH_IRQHandler },
+    { "vTaskSwitchContext", (uintptr_t) vTaskSwitchContext },
+    { "udpardTxPublish", (uintptr_t) udpardTxPublish }
+};
+
+#define TCM_CODE_SYMBOLS               (sizeof(xCodeSymbols) / sizeof(xCodeSymbols[0]))
+
+static uint8_t ucBenchData[TCM_BENCH_LONG_SIZE];
+
+static BaseType_t prvTcmCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xTcm =
+{
+    "tcm",
+    "\r\ntcm:\r\n ITCM and DTCM use, placement and cycle counts of the hot path\r\n",
+    prvTcmCommand,
+    0
+};
+
+/* Cycle counts measured on the first line, before the CLI output of the
+ * other lines can disturb the caches and the bus */
+static uint32_t ulShortCycles;
+static uint32_t ulLongCycles;
+static uint32_t ulYieldCycles;
+static UBaseType_t uxTcmLine = 0;
+
+static const char *prvRegionName(uintptr_t xAddress)
+{
+    if (xAddress < TCM_ITCM_SIZE)
+    {
+        return "itcm";
+    }
+    else if (xAddress >= 0x08000000u && xAddress < 0x08100000u)
+    {
+        return "flash";
+    }
+    else if (xAddress >= 0x20000000u && xAddress < 0x20000000u + TCM_DTCM_SIZE)
+    {
+        return "dtcm";
+    }
+    else if (xAddress >= 0x24000000u && xAddress < 0x24050000u)
+    {
+        return "axi-sram";
+    }
+    else if (xAddress >= 0x30000000u && xAddress < 0x30008000u)
+    {
+        return "d2-sram";
+    }
+
+    return "other";
+}
+
+static uint32_t prvChecksumCycles(size_t xLength)
+{
+    uint32_t ulBest = UINT32_MAX;
+    uint32_t ulStart;
+    uint32_t ulCycles;
+    volatile uint16_t usSink;
+    int i;
+
+    for (i = 0; i < TCM_BENCH_RUNS; i++)
+    {
+        taskENTER_CRITICAL();
+        ulStart = DWT->CYCCNT;
+        usSink = ipCalcChecksum(ucBenchData, xLength);
+        ulCycles = DWT->CYCCNT - ulStart;
+        taskEXIT_CRITICAL();
+
+        (void) usSink;
+        if (ulCycles < ulBest)
+        {
+            ulBest = ulCycles;
+        }
+    }
+
+    return ulBest;
+}
+
+static uint32_t prvYieldCycles(void)
+{
+    uint32_t ulBest = UINT32_MAX;
+    uint32_t ulStart;
+    uint32_t ulCycles;
+    int i;
+
+    for (i = 0; i < TCM_BENCH_RUNS; i++)
+    {
+        ulStart = DWT->CYCCNT;
+        taskYIELD();
+        ulCycles = DWT->CYCCNT - ulStart;
+
+        if (ulCycles < ulBest)
+        {
+            ulBest = ulCycles;
+        }
+    }
+
+    return ulBest;
+}
+
+static BaseType_t prvTcmCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    uint32_t ulItcmUsed = (uint32_t) ((uintptr_t) &_eitcm_text - (uintptr_t) &_sitcm_text);
+    uint32_t ulDtcmUsed = (uint32_t) ((uintptr_t) &_edtcm_bss - (uintptr_t) &_sdtcm_bss);
+    const TcmSymbol_t *pxSymbol;
+
+    (void) pcCommandString;
+
+    if (uxTcmLine == 0)
+    {
+        memset(ucBenchData, 0xA5, sizeof(ucBenchData));
+        ulShortCycles = prvChecksumCycles(TCM_BENCH_SHORT_SIZE);
+        ulLongCycles = prvChecksumCycles(TCM_BENCH_LONG_SIZE);
+        ulYieldCycles = prvYieldCycles();
+
+        snprintf(pcWriteBuffer, xWriteBufferLen, "layout: %s, itcm code=%lu of %lu bytes, dtcm-bss=%lu bytes\r\n",
+                 (TCM_PLACEMENT == 1) ? "tcm" : "default",
+                 (unsigned long) ulItcmUsed, (unsigned long) TCM_ITCM_SIZE, (unsigned long) ulDtcmUsed);
+        uxTcmLine++;
+        return pdTRUE;
+    }
+    else if (uxTcmLine <= TCM_CODE_SYMBOLS)
+    {
+        /* Thumb function addresses carry bit 0 */
+        pxSymbol = &xCodeSymbols[uxTcmLine - 1];
+        snprintf(pcWriteBuffer, xWriteBufferLen, "code: %-20s 0x%08lx %s\r\n", pxSymbol->pcName,
+                 (unsigned long) (pxSymbol->xAddress & ~1u), prvRegionName(pxSymbol->xAddress & ~1u));
+        uxTcmLine++;
+        return pdTRUE;
+    }
+
+    switch (uxTcmLine++ - TCM_CODE_SYMBOLS)
+    {
+    case 1:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "data: %-20s 0x%08lx %s\r\n", "socketTable",
+                 (unsigned long) (uintptr_t) socketTable, prvRegionName((uintptr_t) socketTable));
+        return pdTRUE;
+    case 2:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "checksum: %u bytes=%lu cycles, %u bytes=%lu cycles (%lu.%02lu per byte)\r\n",
+                 (unsigned int) TCM_BENCH_SHORT_SIZE, (unsigned long) ulShortCycles,
+                 (unsigned int) TCM_BENCH_LONG_SIZE, (unsigned long) ulLongCycles,
+                 (unsigned long) (ulLongCycles / TCM_BENCH_LONG_SIZE),
+                 (unsigned long) (((ulLongCycles % TCM_BENCH_LONG_SIZE) * 100u) / TCM_BENCH_LONG_SIZE));
+        return pdTRUE;
+    default:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "yield: %lu cycles (best of %u)\r\n",
+                 (unsigned long) ulYieldCycles, (unsigned int) TCM_BENCH_RUNS);
+        uxTcmLine = 0;
+        return pdFALSE;
+    }
+}
+
+void vTcmPlacementRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xTcm);
+}
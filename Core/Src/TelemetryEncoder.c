@@ -0,0 +1,590 @@
+/* TelemetryEncoder.c
+ *
+ * CBOR and compact JSON encoder of TelemetryEncoder.h.
+ *
+ * The state of the open containers is a set of bit masks indexed by depth:
+ * whether an element was written (the JSON separators), whether it is a map
+ * (the JSON closing character) and whether its length is indefinite (the
+ * CBOR break). Numbers are converted two digits at a time, and on 32 bits
+ * while they fit, the 64-bit division being a library call on the M7.
+ */
+#include "TelemetryEncoder.h"
+#include "core/net.h"
+#include "http/http_client.h"
+#include <string.h>
+
+/* CBOR major types (RFC 8949, 3.1) */
+#define CBOR_UINT                      0u
+#define CBOR_NEGINT                    1u
+#define CBOR_BYTES                     2u
+#define CBOR_TEXT                      3u
+#define CBOR_ARRAY                     4u
+#define CBOR_MAP                       5u
+#define CBOR_TAG                       6u
+
+#define CBOR_FALSE                     0xF4u
+#define CBOR_TRUE                      0xF5u
+#define CBOR_NULL                      0xF6u
+#define CBOR_INDEFINITE                0x1Fu
+#define CBOR_BREAK                     0xFFu
+
+/* Decimal fraction: [exponent, mantissa] (RFC 8949, 3.4.4) */
+#define CBOR_TAG_DECIMAL               4u
+
+/* Longest unsigned 64-bit number */
+#define TELEMETRY_DIGITS_SIZE          20u
+
+static const char cDigitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const char cHexDigits[] = "0123456789abcdef";
+
+static void prvFlush(TelemetryEncoder_t *pxEnc)
+{
+    if (pxEnc->pxFlush == NULL || pxEnc->pxFlush(pxEnc->pvContext, pxEnc->pucBuffer, pxEnc->xUsed) != pdPASS)
+    {
+        pxEnc->xError = pdTRUE;
+        return;
+    }
+    pxEnc->xFlushed += pxEnc->xUsed;
+    pxEnc->xUsed = 0;
+}
+
+static void prvByte(TelemetryEncoder_t *pxEnc, uint8_t ucByte)
+{
+    if (pxEnc->xUsed == pxEnc->xSize)
+    {
+        prvFlush(pxEnc);
+    }
+    if (pxEnc->xError == pdFALSE)
+    {
+        pxEnc->pucBuffer[pxEnc->xUsed++] = ucByte;
+    }
+}
+
+static void prvWrite(TelemetryEncoder_t *pxEnc, const void *pvData, size_t xLength)
+{
+    const uint8_t *pucData = (const uint8_t *) pvData;
+    size_t xChunk;
+
+    while (xLength > 0 && pxEnc->xError == pdFALSE)
+    {
+        if (pxEnc->xUsed == pxEnc->xSize)
+        {
+            prvFlush(pxEnc);
+            continue;
+        }
+
+        xChunk = pxEnc->xSize - pxEnc->xUsed;
+        if (xChunk > xLength)
+        {
+            xChunk = xLength;
+        }
+        memcpy(&pxEnc->pucBuffer[pxEnc->xUsed], pucData, xChunk);
+        pxEnc->xUsed += xChunk;
+        pucData += xChunk;
+        xLength -= xChunk;
+    }
+}
+
+/* Decimal digits of ullValue, ending at pcEnd; returns the first one */
+static char *prvDigits(uint64_t ullValue, char *pcEnd)
+{
+    uint32_t ulValue;
+    uint32_t ulPair;
+
+    while (ullValue > UINT32_MAX)
+    {
+        ulPair = (uint32_t) (ullValue % 100u);
+        ullValue /= 100u;
+        pcEnd -= 2;
+        memcpy(pcEnd, &cDigitPairs[2u * ulPair], 2);
+    }
+
+    ulValue = (uint32_t) ullValue;
+    while (ulValue >= 100u)
+    {
+        ulPair = ulValue % 100u;
+        ulValue /= 100u;
+        pcEnd -= 2;
+        memcpy(pcEnd, &cDigitPairs[2u * ulPair], 2);
+    }
+    if (ulValue >= 10u)
+    {
+        pcEnd -= 2;
+        memcpy(pcEnd, &cDigitPairs[2u * ulValue], 2);
+    }
+    else
+    {
+        *--pcEnd = (char) ('0' + ulValue);
+    }
+
+    return pcEnd;
+}
+
+/* Initial byte and argument of a CBOR data item */
+static void prvCborHead(TelemetryEncoder_t *pxEnc, uint32_t ulMajor, uint64_t ullArgument)
+{
+    uint8_t ucHead[9];
+    size_t xLength;
+    size_t i;
+
+    ulMajor <<= 5;
+    if (ullArgument < 24u)
+    {
+        prvByte(pxEnc, (uint8_t) (ulMajor | (uint32_t) ullArgument));
+        return;
+    }
+
+    if (ullArgument <= 0xFFu)
+    {
+        ucHead[0] = (uint8_t) (ulMajor | 24u);
+        xLength = 1;
+    }
+    else if (ullArgument <= 0xFFFFu)
+    {
+        ucHead[0] = (uint8_t) (ulMajor | 25u);
+        xLength = 2;
+    }
+    else if (ullArgument <= 0xFFFFFFFFu)
+    {
+        ucHead[0] = (uint8_t) (ulMajor | 26u);
+        xLength = 4;
+    }
+    else
+    {
+        ucHead[0] = (uint8_t) (ulMajor | 27u);
+        xLength = 8;
+    }
+
+    /* Network byte order */
+    for (i = xLength; i > 0; i--)
+    {
+        ucHead[i] = (uint8_t) ullArgument;
+        ullArgument >>= 8;
+    }
+    prvWrite(pxEnc, ucHead, xLength + 1u);
+}
+
+/* JSON string, escaped as RFC 8259 requires */
+static void prvJsonString(TelemetryEncoder_t *pxEnc, const char *pcValue, size_t xLength)
+{
+    const char *pcRun = pcValue;
+    const char *pcEnd = pcValue + xLength;
+    char cEscape[6] = { '\\', 'u', '0', '0', 0, 0 };
+    uint8_t ucChar;
+
+    prvByte(pxEnc, '"');
+    for (; pcValue < pcEnd; pcValue++)
+    {
+        ucChar = (uint8_t) *pcValue;
+        if (ucChar >= 0x20u && ucChar != '"' && ucChar != '\\')
+        {
+            continue;
+        }
+
+        /* The plain characters so far in one copy */
+        prvWrite(pxEnc, pcRun, (size_t) (pcValue - pcRun));
+        pcRun = pcValue + 1;
+
+        if (ucChar == '"' || ucChar == '\\')
+        {
+            cEscape[1] = (char) ucChar;
+            prvWrite(pxEnc, cEscape, 2);
+            cEscape[1] = 'u';
+        }
+        else
+        {
+            cEscape[4] = cHexDigits[ucChar >> 4];
+            cEscape[5] = cHexDigits[ucChar & 0x0Fu];
+            prvWrite(pxEnc, cEscape, 6);
+        }
+    }
+    prvWrite(pxEnc, pcRun, (size_t) (pcEnd - pcRun));
+    prvByte(pxEnc, '"');
+}
+
+/* Separator in front of a value or a key; pdFALSE once an error occurred */
+static BaseType_t prvBeginItem(TelemetryEncoder_t *pxEnc)
+{
+    uint32_t ulBit = 1u << pxEnc->ulDepth;
+
+    if (pxEnc->xError != pdFALSE)
+    {
+        return pdFALSE;
+    }
+
+    if (pxEnc->xAfterKey != pdFALSE)
+    {
+        pxEnc->xAfterKey = pdFALSE;
+        return pdTRUE;
+    }
+
+    if (pxEnc->eFormat == eTelemetryJson && (pxEnc->ulNotEmpty & ulBit) != 0)
+    {
+        prvByte(pxEnc, (pxEnc->ulDepth > 0) ? ',' : '\n');
+    }
+    pxEnc->ulNotEmpty |= ulBit;
+
+    return (pxEnc->xError == pdFALSE) ? pdTRUE : pdFALSE;
+}
+
+static void prvBegin(TelemetryEncoder_t *pxEnc, BaseType_t xMap, uint32_t ulCount)
+{
+    uint32_t ulBit;
+
+    if (prvBeginItem(pxEnc) == pdFALSE)
+    {
+        return;
+    }
+    if (pxEnc->ulDepth >= TELEMETRY_MAX_DEPTH)
+    {
+        pxEnc->xError = pdTRUE;
+        return;
+    }
+
+    pxEnc->ulDepth++;
+    ulBit = 1u << pxEnc->ulDepth;
+    pxEnc->ulNotEmpty &= ~ulBit;
+    pxEnc->ulMaps = (xMap != pdFALSE) ? (pxEnc->ulMaps | ulBit) : (pxEnc->ulMaps & ~ulBit);
+    pxEnc->ulIndefinite &= ~ulBit;
+
+    if (pxEnc->eFormat == eTelemetryJson)
+    {
+        prvByte(pxEnc, (xMap != pdFALSE) ? '{' : '[');
+    }
+    else if (ulCount == TELEMETRY_INDEFINITE)
+    {
+        pxEnc->ulIndefinite |= ulBit;
+        prvByte(pxEnc, (uint8_t) ((((xMap != pdFALSE) ? CBOR_MAP : CBOR_ARRAY) << 5) | CBOR_INDEFINITE));
+    }
+    else
+    {
+        prvCborHead(pxEnc, (xMap != pdFALSE) ? CBOR_MAP : CBOR_ARRAY, ulCount);
+    }
+}
+
+void vTelemetryInit(TelemetryEncoder_t *pxEnc, TelemetryFormat_t eFormat, uint8_t *pucBuffer, size_t xSize,
+                    TelemetryFlush_t pxFlush, void *pvContext)
+{
+    memset(pxEnc, 0, sizeof(*pxEnc));
+    pxEnc->eFormat = eFormat;
+    pxEnc->pucBuffer = pucBuffer;
+    pxEnc->xSize = xSize;
+    pxEnc->pxFlush = pxFlush;
+    pxEnc->pvContext = pvContext;
+    pxEnc->xError = (pucBuffer == NULL || xSize == 0) ? pdTRUE : pdFALSE;
+}
+
+void vTelemetryBeginMap(TelemetryEncoder_t *pxEnc, uint32_t ulCount)
+{
+    prvBegin(pxEnc, pdTRUE, ulCount);
+}
+
+void vTelemetryBeginArray(TelemetryEncoder_t *pxEnc, uint32_t ulCount)
+{
+    prvBegin(pxEnc, pdFALSE, ulCount);
+}
+
+void vTelemetryEnd(TelemetryEncoder_t *pxEnc)
+{
+    uint32_t ulBit = 1u << pxEnc->ulDepth;
+
+    if (pxEnc->xError != pdFALSE)
+    {
+        return;
+    }
+    if (pxEnc->ulDepth == 0 || pxEnc->xAfterKey != pdFALSE)
+    {
+        pxEnc->xError = pdTRUE;
+        return;
+    }
+
+    if (pxEnc->eFormat == eTelemetryJson)
+    {
+        prvByte(pxEnc, ((pxEnc->ulMaps & ulBit) != 0) ? '}' : ']');
+    }
+    else if ((pxEnc->ulIndefinite & ulBit) != 0)
+    {
+        prvByte(pxEnc, CBOR_BREAK);
+    }
+    pxEnc->ulDepth--;
+}
+
+void vTelemetryKey(TelemetryEncoder_t *pxEnc, const char *pcKey)
+{
+    size_t xLength = strlen(pcKey);
+
+    if (prvBeginItem(pxEnc) == pdFALSE)
+    {
+        return;
+    }
+
+    if (pxEnc->eFormat == eTelemetryJson)
+    {
+        prvJsonString(pxEnc, pcKey, xLength);
+        prvByte(pxEnc, ':');
+    }
+    else
+    {
+        prvCborHead(pxEnc, CBOR_TEXT, xLength);
+        prvWrite(pxEnc, pcKey, xLength);
+    }
+    pxEnc->xAfterKey = pdTRUE;
+}
+
+void vTelemetryUint(TelemetryEncoder_t *pxEnc, uint64_t ullValue)
+{
+    char cDigits[TELEMETRY_DIGITS_SIZE];
+    char *pcFirst;
+
+    if (prvBeginItem(pxEnc) == pdFALSE)
+    {
+        return;
+    }
+
+    if (pxEnc->eFormat == eTelemetryJson)
+    {
+        pcFirst = prvDigits(ullValue, &cDigits[sizeof(cDigits)]);
+        prvWrite(pxEnc, pcFirst, (size_t) (&cDigits[sizeof(cDigits)] - pcFirst));
+    }
+    else
+    {
+        prvCborHead(pxEnc, CBOR_UINT, ullValue);
+    }
+}
+
+/* Integer of a CBOR item or a JSON text, without separator */
+static void prvInt(TelemetryEncoder_t *pxEnc, int64_t llValue)
+{
+    /* -1 - n, without overflow for INT64_MIN */
+    uint64_t ullMagnitude = (llValue < 0) ? (uint64_t) -(llValue + 1) : (uint64_t) llValue;
+    char cDigits[TELEMETRY_DIGITS_SIZE + 1u];
+    char *pcFirst;
+
+    if (pxEnc->eFormat == eTelemetryCbor)
+    {
+        prvCborHead(pxEnc, (llValue < 0) ? CBOR_NEGINT : CBOR_UINT, ullMagnitude);
+        return;
+    }
+
+    pcFirst = prvDigits((llValue < 0) ? ullMagnitude + 1u : ullMagnitude, &cDigits[sizeof(cDigits)]);
+    if (llValue < 0)
+    {
+        *--pcFirst = '-';
+    }
+    prvWrite(pxEnc, pcFirst, (size_t) (&cDigits[sizeof(cDigits)] - pcFirst));
+}
+
+void vTelemetryInt(TelemetryEncoder_t *pxEnc, int64_t llValue)
+{
+    if (prvBeginItem(pxEnc) != pdFALSE)
+    {
+        prvInt(pxEnc, llValue);
+    }
+}
+
+void vTelemetryDecimal(TelemetryEncoder_t *pxEnc, int64_t llMantissa, uint32_t ulDecimals)
+{
+    /* Sign, digits, point and leading zeros */
+    char cText[TELEMETRY_DIGITS_SIZE + TELEMETRY_MAX_DECIMALS + 3u];
+    char *pcEnd = &cText[sizeof(cText)];
+    char *pcFirst;
+    uint64_t ullMagnitude;
+    size_t xDigits;
+    size_t xIntegral;
+
+    if (prvBeginItem(pxEnc) == pdFALSE)
+    {
+        return;
+    }
+    if (ulDecimals > TELEMETRY_MAX_DECIMALS)
+    {
+        pxEnc->xError = pdTRUE;
+        return;
+    }
+    if (ulDecimals == 0)
+    {
+        prvInt(pxEnc, llMantissa);
+        return;
+    }
+
+    if (pxEnc->eFormat == eTelemetryCbor)
+    {
+        prvCborHead(pxEnc, CBOR_TAG, CBOR_TAG_DECIMAL);
+        prvCborHead(pxEnc, CBOR_ARRAY, 2u);
+        prvCborHead(pxEnc, CBOR_NEGINT, ulDecimals - 1u);
+        prvInt(pxEnc, llMantissa);
+        return;
+    }
+
+    ullMagnitude = (llMantissa < 0) ? (uint64_t) -(llMantissa + 1) + 1u : (uint64_t) llMantissa;
+    pcFirst = prvDigits(ullMagnitude, pcEnd - TELEMETRY_MAX_DECIMALS - 2u);
+    xDigits = (size_t) (pcEnd - TELEMETRY_MAX_DECIMALS - 2u - pcFirst);
+
+    /* At least one digit before the point */
+    while (xDigits <= ulDecimals)
+    {
+        *--pcFirst = '0';
+        xDigits++;
+    }
+
+    /* The decimals move right by one, after the integral part */
+    xIntegral = xDigits - ulDecimals;
+    memmove(pcFirst + xIntegral + 1, pcFirst + xIntegral, ulDecimals);
+    pcFirst[xIntegral] = '.';
+    if (llMantissa < 0)
+    {
+        *--pcFirst = '-';
+        xIntegral++;
+    }
+    prvWrite(pxEnc, pcFirst, xIntegral + 1u + ulDecimals);
+}
+
+void vTelemetryBool(TelemetryEncoder_t *pxEnc, BaseType_t xValue)
+{
+    if (prvBeginItem(pxEnc) == pdFALSE)
+    {
+        return;
+    }
+
+    if (pxEnc->eFormat == eTelemetryJson)
+    {
+        if (xValue != pdFALSE)
+        {
+            prvWrite(pxEnc, "true", 4);
+        }
+        else
+        {
+            prvWrite(pxEnc, "false", 5);
+        }
+    }
+    else
+    {
+        prvByte(pxEnc, (xValue != pdFALSE) ? CBOR_TRUE : CBOR_FALSE);
+    }
+}
+
+void vTelemetryNull(TelemetryEncoder_t *pxEnc)
+{
+    if (prvBeginItem(pxEnc) == pdFALSE)
+    {
+        return;
+    }
+
+    if (pxEnc->eFormat == eTelemetryJson)
+    {
+        prvWrite(pxEnc, "null", 4);
+    }
+    else
+    {
+        prvByte(pxEnc, CBOR_NULL);
+    }
+}
+
+void vTelemetryString(TelemetryEncoder_t *pxEnc, const char *pcValue)
+{
+    size_t xLength = strlen(pcValue);
+
+    if (prvBeginItem(pxEnc) == pdFALSE)
+    {
+        return;
+    }
+
+    if (pxEnc->eFormat == eTelemetryJson)
+    {
+        prvJsonString(pxEnc, pcValue, xLength);
+    }
+    else
+    {
+        prvCborHead(pxEnc, CBOR_TEXT, xLength);
+        prvWrite(pxEnc, pcValue, xLength);
+    }
+}
+
+void vTelemetryBytes(TelemetryEncoder_t *pxEnc, const uint8_t *pucData, size_t xLength)
+{
+    size_t i;
+
+    if (prvBeginItem(pxEnc) == pdFALSE)
+    {
+        return;
+    }
+
+    if (pxEnc->eFormat == eTelemetryCbor)
+    {
+        prvCborHead(pxEnc, CBOR_BYTES, xLength);
+        prvWrite(pxEnc, pucData, xLength);
+        return;
+    }
+
+    prvByte(pxEnc, '"');
+    for (i = 0; i < xLength; i++)
+    {
+        prvByte(pxEnc, (uint8_t) cHexDigits[pucData[i] >> 4]);
+        prvByte(pxEnc, (uint8_t) cHexDigits[pucData[i] & 0x0Fu]);
+    }
+    prvByte(pxEnc, '"');
+}
+
+void vTelemetryFieldUint(TelemetryEncoder_t *pxEnc, const char *pcKey, uint64_t ullValue)
+{
+    vTelemetryKey(pxEnc, pcKey);
+    vTelemetryUint(pxEnc, ullValue);
+}
+
+void vTelemetryFieldInt(TelemetryEncoder_t *pxEnc, const char *pcKey, int64_t llValue)
+{
+    vTelemetryKey(pxEnc, pcKey);
+    vTelemetryInt(pxEnc, llValue);
+}
+
+void vTelemetryFieldDecimal(TelemetryEncoder_t *pxEnc, const char *pcKey, int64_t llMantissa, uint32_t ulDecimals)
+{
+    vTelemetryKey(pxEnc, pcKey);
+    vTelemetryDecimal(pxEnc, llMantissa, ulDecimals);
+}
+
+void vTelemetryFieldBool(TelemetryEncoder_t *pxEnc, const char *pcKey, BaseType_t xValue)
+{
+    vTelemetryKey(pxEnc, pcKey);
+    vTelemetryBool(pxEnc, xValue);
+}
+
+void vTelemetryFieldString(TelemetryEncoder_t *pxEnc, const char *pcKey, const char *pcValue)
+{
+    vTelemetryKey(pxEnc, pcKey);
+    vTelemetryString(pxEnc, pcValue);
+}
+
+BaseType_t xTelemetryFinish(TelemetryEncoder_t *pxEnc)
+{
+    if (pxEnc->ulDepth != 0 || pxEnc->xAfterKey != pdFALSE)
+    {
+        pxEnc->xError = pdTRUE;
+    }
+
+    /* Without a callback, the document stays in the buffer */
+    if (pxEnc->xError == pdFALSE && pxEnc->pxFlush != NULL && pxEnc->xUsed > 0)
+    {
+        prvFlush(pxEnc);
+    }
+
+    return (pxEnc->xError == pdFALSE) ? pdPASS : pdFAIL;
+}
+
+size_t xTelemetryLength(const TelemetryEncoder_t *pxEnc)
+{
+    return pxEnc->xFlushed + pxEnc->xUsed;
+}
+
+BaseType_t xTelemetryHttpFlush(void *pvContext, const uint8_t *pucData, size_t xLength)
+{
+    error_t xError;
+
+    xError = httpClientWriteBody((HttpClientContext *) pvContext, pucData, xLength, NULL, 0);
+
+    return (xError == NO_ERROR) ? pdPASS : pdFAIL;
+}
@@ -1,25 +1,30 @@
-
 // TelnetTask.c
 #include "FreeRTOS.h"
 #include "stream_buffer.h"
+#include "semphr.h"
 #include "task.h"
 
 // CycloneTCP core includes
 #include "core/net.h"
 #include "core/socket.h"
 #include "core/tcp.h"
+#include "core/socket_reactor.h"
 #include "ipv4/ipv4.h"
 #include "error.h"
 
 #include "TelnetTask.h"
+#include "StaticAlloc.h"
 #include <string.h>
 #include <stdint.h>
 
 #include "SerialTask.h" //debug
 
 #define TELNET_PORT              23
-#define TELNET_TASK_STACK_SIZE   512
-#define CLI_BUFFER_SIZE          128
+#define TELNET_STREAM_SIZE       256
+
+// How long a writer waits for room in the socket before re-checking that the
+// session is alive (socket timeout of the client)
+#define TELNET_WRITE_RETRY_MS    100
 
 // Telnet IAC command and option codes
 #define TELNET_IAC               255u
@@ -28,140 +33,299 @@
 #define TELNET_ECHO              1u
 #define TELNET_SUPPRESS_GO_AHEAD 3u
 
-// Static stream buffer handles
-static StreamBufferHandle_t xRxStream = NULL;
-static StreamBufferHandle_t xTxStream = NULL;
+/**
+ * Per-session state. The bytes received on the client socket are moved to
+ * the Rx stream buffer by the readable handler of the session, run by the
+ * socket reactor; console output is written by the console tasks straight
+ * into the TX buffer of the socket.
+ */
+typedef struct
+{
+    Socket *pxClient;                     // Connected client, NULL when idle
+    volatile BaseType_t xActive;          // pdTRUE while a client is attached
+    StreamBufferHandle_t xRxStream;       // Telnet => CLI
+    SemaphoreHandle_t xTxMutex;           // Serializes the writers of the socket
+} TelnetSession_t;
+
+static TelnetSession_t xSessions[TELNET_MAX_SESSIONS];
+
+// Storage of the static allocation profile
+APP_STREAM_STORAGE_ARRAY(xSessionRx, TELNET_MAX_SESSIONS, TELNET_STREAM_SIZE);
+APP_MUTEX_STORAGE_ARRAY(xSessionTxMutex, TELNET_MAX_SESSIONS);
+
+// Task notified (one bit per session) whenever a session receives input
+static TaskHandle_t xConsoleTask = NULL;
+
+// Reactor running the handlers of the listener and of the sessions
+static SocketReactorContext *pxTelnetReactor = NULL;
+
+// Forward declaration of the socket handlers
+static void prvTelnetAccept(Socket *listener, void *pvParam);
+static void prvTelnetReadable(Socket *client, void *pvParam);
+static void prvTelnetClosed(Socket *client, void *pvParam);
+static void prvTelnetHangUp(TelnetSession_t *pxSession);
+static void prvTelnetNotifyConsole(uint32_t ulBits);
+
+static const SocketReactorHandlers xListenerHandlers =
+{
+    prvTelnetAccept,
+    NULL,
+    NULL,
+    NULL
+};
+
+static const SocketReactorHandlers xSessionHandlers =
+{
+    NULL,
+    prvTelnetReadable,
+    NULL,
+    prvTelnetClosed
+};
 
-// Forward declaration of the task function
-static void prvTelnetTask(void *pvParameters);
+StreamBufferHandle_t xTelnetTaskGetRxStreamHandle(UBaseType_t uxSession)
+{
+    configASSERT(uxSession < TELNET_MAX_SESSIONS);
+    return xSessions[uxSession].xRxStream;
+}
 
-StreamBufferHandle_t xTelnetTaskGetRxStreamHandle(void)
+void vTelnetTaskSetConsoleTask(TaskHandle_t xTask)
 {
-    return xRxStream;
+    xConsoleTask = xTask;
 }
 
-StreamBufferHandle_t xTelnetTaskGetTxStreamHandle(void)
+size_t xTelnetTaskWrite(UBaseType_t uxSession, const void *pvData, size_t xLength)
 {
-    return xTxStream;
+    TelnetSession_t *pxSession;
+    const uint8_t *pucData = (const uint8_t *) pvData;
+    size_t xTotal = xLength;
+    size_t xSent;
+    error_t err;
+
+    configASSERT(uxSession < TELNET_MAX_SESSIONS);
+    pxSession = &xSessions[uxSession];
+
+    // The line editor and the CLI workers all write to the same session;
+    // the mutex also keeps the session from closing the socket under a writer
+    xSemaphoreTake(pxSession->xTxMutex, portMAX_DELAY);
+
+    while (xLength > 0 && pxSession->xActive == pdTRUE) {
+        // Copy into the TX buffer of the socket, blocking while the peer's
+        // window keeps it full. Each write is a complete piece of output
+        // (a keystroke echo, the whole output of a command): push it out
+        xSent = 0;
+        err = socketSend(pxSession->pxClient, pucData, xLength, &xSent,
+                         SOCKET_FLAG_NO_DELAY);
+
+        pucData += xSent;
+        xLength -= xSent;
+
+        // A timeout is also what a wait cut short by a hang-up looks like:
+        // retry while the session lives. Any other error means the
+        // connection is gone, which the reactor reports on its side
+        if (err != NO_ERROR && err != ERROR_TIMEOUT) {
+            break;
+        }
+    }
+
+    xSemaphoreGive(pxSession->xTxMutex);
+
+    // Output for a session without a client is silently discarded
+    return xTotal;
 }
 
 BaseType_t xTelnetTaskStart(UBaseType_t uxPriority)
 {
-    // Create stream buffers if not already created
-    if (xRxStream == NULL) {
-        xRxStream = xStreamBufferCreate(256, 1);
+    UBaseType_t i;
+    TelnetSession_t *pxSession;
+
+    // The sessions are served by the socket reactor (xTelnetTaskListen)
+    (void) uxPriority;
+
+    for (i = 0; i < TELNET_MAX_SESSIONS; i++) {
+        pxSession = &xSessions[i];
+
+        // Create the session resources if not already created
+        if (pxSession->xRxStream == NULL) {
+            pxSession->xRxStream = xAppStreamBufferCreateAt(xSessionRx, i, TELNET_STREAM_SIZE, 1);
+        }
+        if (pxSession->xTxMutex == NULL) {
+            pxSession->xTxMutex = xAppSemaphoreCreateMutexAt(xSessionTxMutex, i);
+        }
+        if (pxSession->xRxStream == NULL || pxSession->xTxMutex == NULL) {
+            return pdFAIL;
+        }
+    }
+
+    return pdPASS;
+}
+
+BaseType_t xTelnetTaskListen(SocketReactorContext *pxReactor)
+{
+    Socket *listener;
+
+    // Open a TCP listening socket
+    listener = socketOpen(SOCKET_TYPE_STREAM, IP_PROTOCOL_TCP);
+    if (!listener) {
+        return pdFAIL;
     }
-    if (xTxStream == NULL) {
-        xTxStream = xStreamBufferCreate(256, 1);
+
+    // The handlers never wait on the socket
+    socketSetTimeout(listener, 0);
+
+    if (socketBind(listener, &IP_ADDR_ANY, TELNET_PORT) != NO_ERROR ||
+        socketListen(listener, TELNET_MAX_SESSIONS) != NO_ERROR) {
+        socketClose(listener);
+        return pdFAIL;
     }
-    if (xRxStream == NULL || xTxStream == NULL) {
+
+    // Connection requests are accepted by the reactor
+    pxTelnetReactor = pxReactor;
+    if (socketReactorAdd(pxReactor, listener, &xListenerHandlers, NULL) != NO_ERROR) {
+        socketClose(listener);
         return pdFAIL;
     }
 
-    // Start the Telnet listener task
-    return xTaskCreate(prvTelnetTask,
-                       "TelnetCLI",
-                       TELNET_TASK_STACK_SIZE,
-                       NULL,
-                       uxPriority,
-                       NULL);
+    return pdPASS;
 }
 
-static void prvTelnetTask(void *pvParameters)
+static void prvTelnetAccept(Socket *listener, void *pvParam)
 {
-    error_t err;
+    UBaseType_t i;
+    TelnetSession_t *pxSession;
+    Socket *client;
+
+    (void) pvParam;
+
+    // A connection request is pending: the call does not wait
+    client = socketAccept(listener, NULL, 0);
+    if (!client) {
+        return;
+    }
+
+    // Find an idle session
+    for (i = 0; i < TELNET_MAX_SESSIONS; i++) {
+        if (xSessions[i].pxClient == NULL) {
+            break;
+        }
+    }
+
+    if (i >= TELNET_MAX_SESSIONS) {
+        // All sessions are in use: tell the client and hang up
+        static const char pcBusy[] = "\r\nAll Telnet sessions are in use\r\n";
+        size_t written;
+        socketSend(client, pcBusy, sizeof(pcBusy) - 1, &written,
+                   SOCKET_FLAG_NO_DELAY | SOCKET_FLAG_DONT_WAIT);
+        socketClose(client);
+        return;
+    }
+
+    pxSession = &xSessions[i];
+    pxSession->pxClient = client;
+
+//    // 1) Negotiate Telnet options: server WILL ECHO, WILL SUPPRESS-GO-AHEAD
+//    {
+//        const uint8_t serverOpts[] = {
+//            TELNET_IAC, TELNET_WILL, TELNET_ECHO,
+//            TELNET_IAC, TELNET_WILL, TELNET_SUPPRESS_GO_AHEAD
+//        };
+//        //socketSend(client, serverOpts, sizeof(serverOpts), &written, 0);
+//    }
+
+    // Writers blocked on a full TX buffer re-check the session this often
+    socketSetTimeout(client, TELNET_WRITE_RETRY_MS);
+
+    // The session is now ready to carry console output
+    pxSession->xActive = pdTRUE;
+
+    /**
+     * Tell the console that a new session started (it resets the line
+     * editor), then send a CR to have CLI display the prompt
+     */
+    prvTelnetNotifyConsole(TELNET_NOTIFY_OPEN(i));
+
+    const uint8_t CR = 0x0D;
+    xStreamBufferSend(pxSession->xRxStream, &CR, 1, portMAX_DELAY);
+    prvTelnetNotifyConsole(TELNET_NOTIFY_RX(i));
+
+    /**
+     * Recall the dataflow:
+     * 	Telnet => xRxStream => CLI => socket TX buffer
+     *
+     * Received data is moved by prvTelnetReadable. The reactor waits on
+     * a poll set of its own, so the writers blocked in socketSend no longer
+     * take the events of the socket away from the reader.
+     */
+    if (socketReactorAdd(pxTelnetReactor, client, &xSessionHandlers, pxSession) != NO_ERROR) {
+        prvTelnetHangUp(pxSession);
+    }
+}
+
+static void prvTelnetReadable(Socket *client, void *pvParam)
+{
+    TelnetSession_t *pxSession = (TelnetSession_t *) pvParam;
+    UBaseType_t uxSession = (UBaseType_t) (pxSession - xSessions);
+    uint8_t *pucSpace;
+    size_t xSpace;
     size_t received;
-    size_t written;
+    error_t err;
 
-    // Open a TCP listening socket
-    Socket *listener = socketOpen(SOCKET_TYPE_STREAM, IP_PROTOCOL_TCP);
-    if (!listener) {
-        vTaskDelete(NULL);
+    /**
+     * Receive straight into the stream of the session, which is the
+     * interface to the CLI. The console drains the stream as it goes, so a
+     * full stream holds the reactor briefly.
+     */
+    xSpace = xStreamBufferSendReserve(pxSession->xRxStream, &pucSpace, portMAX_DELAY);
+    if (xSpace == 0) {
         return;
     }
 
-    socketBind(listener, &IP_ADDR_ANY, TELNET_PORT);
-    socketListen(listener, 1);
+    // Receive data from client, without blocking
+    err = socketReceive(client, pucSpace, xSpace, &received,
+                        SOCKET_FLAG_DONT_WAIT);
+    if (err == ERROR_TIMEOUT) {
+        return; // nothing to read after all
+    }
+    if (err != NO_ERROR || received == 0) {
+        // Client closed or error
+        socketReactorRemove(pxTelnetReactor, client);
+        prvTelnetHangUp(pxSession);
+        return;
+    }
 
-    for (;;) {
+    /**
+     * DEBUG to send bytes received via telnet out the serial port
+     */
+//    for(uint16_t j=0; j<received; j++){
+//    	vSerialPutChar(pucSpace[j]);
+//    }
 
-        // Wait for a client to connect
-        Socket *client = socketAccept(listener, NULL, 0);
-        if (!client) {
-            vTaskDelay(pdMS_TO_TICKS(100));
-            continue;
-        }
+    (void) xStreamBufferSendCommit(pxSession->xRxStream, received);
+    prvTelnetNotifyConsole(TELNET_NOTIFY_RX(uxSession));
+}
 
-//        // 1) Negotiate Telnet options: server WILL ECHO, WILL SUPPRESS-GO-AHEAD
-//        {
-//            const uint8_t serverOpts[] = {
-//                TELNET_IAC, TELNET_WILL, TELNET_ECHO,
-//                TELNET_IAC, TELNET_WILL, TELNET_SUPPRESS_GO_AHEAD
-//            };
-//            //socketSend(client, serverOpts, sizeof(serverOpts), &written, 0);
-//        }
-
-        // 3) Prepare relay buffers, zero-initialized
-        uint8_t inBuf[CLI_BUFFER_SIZE] = {0};
-        uint8_t outBuf[CLI_BUFFER_SIZE] = {0};
-
-
-        //Flush the socket; input buffer should be empty as we just displayed the CLI prompt
-        socketReceive(client, inBuf, sizeof(inBuf), &received, 0);
-
-        /**
-         * Send a CR to have CLI display the prompt
-         */
-        const uint8_t CR = 0x0D;
-        xStreamBufferSend( xRxStream, &CR, 1, portMAX_DELAY );
-
-        // 4) Relay loop: shuttle bytes between socket and stream buffers
-        /**
-         * Recall the dataflow:
-         * 	Telnet => xRxStream => CLI => xTxStream
-         */
-        for (;;) {
-
-            // a) Receive data from client
-            err = socketReceive(client, inBuf, sizeof(inBuf), &received, 0);
-            if (err != NO_ERROR || received == 0) {
-                break; // client closed or error
-            }
-
-            /**
-             * DEBUG to send bytes received via telnet out the serial port
-             */
-//            for(uint16_t j=0; j<received; j++){
-//            	vSerialPutChar(inBuf[j]);
-//            }
-
-            /**
-             * This call is the interface to the CLI.
-             */
-            xStreamBufferSend(xRxStream, inBuf, received, portMAX_DELAY);
-
-            vTaskDelay(10);
-
-            // b) Drain console output (which includes console-driven echo) back to socket
-            size_t avail = xStreamBufferBytesAvailable(xTxStream);
-
-            while (avail > 0) {
-
-                size_t chunk = (avail > sizeof(outBuf)) ? sizeof(outBuf) : avail;
-
-                size_t n = xStreamBufferReceive(xTxStream, outBuf, chunk, 0);
-
-                if (n > 0) {
-                    err = socketSend(client, outBuf, n, &written, 0);
-                    if (err != NO_ERROR) {
-                        break;
-                    }
-                }
-                avail = xStreamBufferBytesAvailable(xTxStream);
-            }
-        }
+static void prvTelnetClosed(Socket *client, void *pvParam)
+{
+    // The reactor has already removed the socket
+    (void) client;
+    prvTelnetHangUp((TelnetSession_t *) pvParam);
+}
 
-        // Clean up client socket
-        socketClose(client);
+static void prvTelnetHangUp(TelnetSession_t *pxSession)
+{
+    // Detach the client; writers blocked on a full buffer give up
+    pxSession->xActive = pdFALSE;
+
+    // Wait for the writers to leave the socket, which they do within
+    // a socket timeout, then clean it up
+    xSemaphoreTake(pxSession->xTxMutex, portMAX_DELAY);
+    socketClose(pxSession->pxClient);
+    pxSession->pxClient = NULL;
+    xSemaphoreGive(pxSession->xTxMutex);
+}
+
+static void prvTelnetNotifyConsole(uint32_t ulBits)
+{
+    if (xConsoleTask != NULL) {
+        xTaskNotify(xConsoleTask, ulBits, eSetBits);
     }
 }
@@ -0,0 +1,722 @@
+/* TftpServer.c
+ *
+ * Requests, option negotiation and transfers of the TFTP server (see
+ * TftpServer.h). The transfer state is shared by the fast path handler of
+ * the transfer port, in the TCP/IP task, and the server task, which takes
+ * netMutex to read or change it; the acknowledgments are sent under it too,
+ * from either side. The ring is the exception: the handler alone moves its
+ * head, the task alone its tail.
+ */
+#include "TftpServer.h"
+#include "StaticAlloc.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/udp.h"
+#include "tftp/tftp_common.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Block size without the option, the smallest with it (RFC 2348), and the
+ * largest request or OACK */
+#define TFTP_DEFAULT_BLOCK_SIZE        512u
+#define TFTP_MIN_BLOCK_SIZE            8u
+#define TFTP_MAX_PACKET                512u
+
+#define TFTP_RING_MASK                 (TFTP_SERVER_RING_SIZE - 1u)
+
+#if (TFTP_SERVER_RING_SIZE & TFTP_RING_MASK) != 0
+#error "TFTP_SERVER_RING_SIZE must be a power of two"
+#endif
+
+typedef enum
+{
+    eTftpIdle = 0,
+    eTftpReceiving,                 /* Blocks taken by the fast path */
+    eTftpComplete,                  /* Last block in the ring, not acknowledged yet */
+    eTftpDallying                   /* Last block acknowledged, a repeat is answered */
+} TftpState_t;
+
+typedef struct
+{
+    TftpState_t eState;
+    IpAddr xPeer;
+    uint16_t usPeerPort;
+    uint16_t usPort;                /* Ours, the transfer identifier */
+    uint16_t usBlockSize;
+    uint16_t usWindow;
+    uint32_t ulTimeoutMs;
+    uint32_t ulBlocks;              /* Received in order */
+    uint32_t ulAcked;               /* Block of the last ACK */
+    uint32_t ulBytes;
+    BaseType_t xAckDeferred;        /* A window is complete, the ring too full for the next */
+    BaseType_t xRepeated;           /* The last ACK was repeated for a block out of order */
+    BaseType_t xPeerError;          /* The client gave up */
+    UBaseType_t uxRetries;
+    systime_t xLastRx;
+    systime_t xStart;
+    uint8_t ucReply[TFTP_MAX_PACKET];  /* Last ACK or OACK, for retransmissions */
+    size_t xReplyLength;
+} TftpTransfer_t;
+
+static const TftpSink_t *pxTftpSink = NULL;
+static Socket *pxListener = NULL;
+static Socket *pxTransferSocket = NULL;   /* Holds the port; its datagrams go to the fast path */
+static TftpTransfer_t xXfer;
+static OsEvent xTftpEvent;
+
+static uint8_t ucRing[TFTP_SERVER_RING_SIZE] __ALIGNED(32);
+static volatile uint32_t ulRingHead = 0;
+static volatile uint32_t ulRingTail = 0;
+static uint32_t ulWritten;
+
+static uint8_t ucRequest[TFTP_MAX_PACKET];
+
+static TftpServerStats_t xStats;
+
+static TaskHandle_t xTftpTask = NULL;
+APP_TASK_STORAGE(xTftpTask, TFTP_SERVER_TASK_STACK_SIZE);
+
+static BaseType_t prvTftpCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xTftp =
+{
+    "tftp",
+    "\r\ntftp:\r\n TFTP server state and counters\r\n",
+    prvTftpCommand,
+    -1
+};
+
+static uint32_t prvRingRoom(void)
+{
+    return TFTP_SERVER_RING_SIZE - (ulRingHead - ulRingTail);
+}
+
+static size_t prvFormatError(uint8_t *pucOut, uint16_t usCode, const char *pcMessage)
+{
+    size_t xLength = strlen(pcMessage) + 1u;
+
+    STORE16BE(TFTP_OPCODE_ERROR, pucOut);
+    STORE16BE(usCode, pucOut + 2);
+    memcpy(pucOut + 4, pcMessage, xLength);
+
+    return 4u + xLength;
+}
+
+/* From the transfer port; netMutex held */
+static void prvSendReply(NetInterface *pxInterface)
+{
+    NetTxAncillary xAncillary = NET_DEFAULT_TX_ANCILLARY;
+    NetBuffer *pxBuffer;
+    size_t xOffset;
+
+    pxBuffer = udpAllocBuffer(xXfer.xReplyLength, &xOffset);
+    if (pxBuffer == NULL)
+    {
+        return;
+    }
+
+    (void) netBufferWrite(pxBuffer, xOffset, xXfer.ucReply, xXfer.xReplyLength);
+    (void) udpSendBuffer(pxInterface, NULL, xXfer.usPort, &xXfer.xPeer, xXfer.usPeerPort,
+                         pxBuffer, xOffset, &xAncillary);
+    netBufferFree(pxBuffer);
+}
+
+/* netMutex held */
+static void prvAck(NetInterface *pxInterface, uint32_t ulBlock)
+{
+    STORE16BE(TFTP_OPCODE_ACK, xXfer.ucReply);
+    STORE16BE((uint16_t) ulBlock, xXfer.ucReply + 2);
+    xXfer.xReplyLength = 4u;
+    xXfer.ulAcked = ulBlock;
+
+    prvSendReply(pxInterface);
+}
+
+/* Fast path handler of the transfer port, in the TCP/IP task */
+static void prvTftpRx(NetInterface *interface, const IpPseudoHeader *pseudoHeader, const UdpHeader *header,
+                      const NetBuffer *buffer, size_t offset, const NetRxAncillary *ancillary, void *param)
+{
+    uint8_t ucHeader[4];
+    size_t xLength;
+    size_t xFirst;
+    uint32_t ulHead;
+    uint16_t usOpcode;
+    uint16_t usBlock;
+
+    (void) ancillary;
+    (void) param;
+
+    /* Datagrams from another transfer identifier are dropped */
+    if (pseudoHeader->length != sizeof(Ipv4PseudoHeader) || xXfer.eState == eTftpIdle ||
+        pseudoHeader->ipv4Data.srcAddr != xXfer.xPeer.ipv4Addr || ntohs(header->srcPort) != xXfer.usPeerPort)
+    {
+        return;
+    }
+
+    xLength = netBufferGetLength(buffer) - offset;
+    if (xLength < sizeof(ucHeader) || netBufferRead(ucHeader, buffer, offset, sizeof(ucHeader)) != sizeof(ucHeader))
+    {
+        return;
+    }
+    usOpcode = LOAD16BE(ucHeader);
+    usBlock = LOAD16BE(ucHeader + 2);
+    xLength -= sizeof(ucHeader);
+
+    if (usOpcode == TFTP_OPCODE_ERROR)
+    {
+        xXfer.xPeerError = pdTRUE;
+        osSetEvent(&xTftpEvent);
+        return;
+    }
+    if (usOpcode != TFTP_OPCODE_DATA || xLength > xXfer.usBlockSize)
+    {
+        return;
+    }
+
+    /* The client did not get the last ACK */
+    if (xXfer.eState != eTftpReceiving)
+    {
+        if (xXfer.eState == eTftpDallying && usBlock == (uint16_t) xXfer.ulBlocks)
+        {
+            prvSendReply(interface);
+        }
+        return;
+    }
+
+    /* Out of order: the client resumes after the last block in order (RFC
+     * 7440, 4), which is told once per gap, and not while a window waits */
+    if (usBlock != (uint16_t) (xXfer.ulBlocks + 1u))
+    {
+        xStats.ulOutOfOrder++;
+        if (xXfer.xAckDeferred == pdFALSE && xXfer.xRepeated == pdFALSE)
+        {
+            xXfer.xRepeated = pdTRUE;
+            prvAck(interface, xXfer.ulBlocks);
+        }
+        return;
+    }
+
+    /* Only a client ignoring the window overruns the ring */
+    if (xLength > prvRingRoom())
+    {
+        return;
+    }
+
+    ulHead = ulRingHead;
+    xFirst = MIN(xLength, TFTP_SERVER_RING_SIZE - (ulHead & TFTP_RING_MASK));
+    (void) netBufferRead(&ucRing[ulHead & TFTP_RING_MASK], buffer, offset + sizeof(ucHeader), xFirst);
+    if (xFirst < xLength)
+    {
+        (void) netBufferRead(ucRing, buffer, offset + sizeof(ucHeader) + xFirst, xLength - xFirst);
+    }
+    ulRingHead = ulHead + (uint32_t) xLength;
+
+    xXfer.ulBlocks++;
+    xXfer.ulBytes += (uint32_t) xLength;
+    xXfer.xRepeated = pdFALSE;
+    xXfer.uxRetries = 0;
+    xXfer.xLastRx = osGetSystemTime();
+
+    /* The last block is acknowledged by the task, once stored */
+    if (xLength < xXfer.usBlockSize)
+    {
+        xXfer.eState = eTftpComplete;
+    }
+    else if (xXfer.ulBlocks - xXfer.ulAcked >= xXfer.usWindow)
+    {
+        if (prvRingRoom() >= (uint32_t) xXfer.usWindow * xXfer.usBlockSize)
+        {
+            prvAck(interface, xXfer.ulBlocks);
+        }
+        else
+        {
+            xXfer.xAckDeferred = pdTRUE;
+            xStats.ulDeferredAcks++;
+        }
+    }
+
+    osSetEvent(&xTftpEvent);
+}
+
+/* Refusal of a request, from the server port */
+static void prvRefuse(const SocketMsg *pxMessage, uint16_t usCode, const char *pcMessage)
+{
+    uint8_t ucError[64];
+    size_t xLength;
+
+    xStats.ulRefused++;
+    xLength = prvFormatError(ucError, usCode, pcMessage);
+    (void) socketSendTo(pxListener, &pxMessage->srcIpAddr, pxMessage->srcPort, ucError, xLength, NULL, 0);
+}
+
+/* The option, followed by its value, if granted */
+static uint8_t *prvPutOption(uint8_t *pucOut, const char *pcName, uint32_t ulValue)
+{
+    int lLength;
+
+    lLength = snprintf((char *) pucOut, 32, "%s%c%lu", pcName, '\0', (unsigned long) ulValue);
+
+    return pucOut + lLength + 1;
+}
+
+/* Option values are decimal, without sign */
+static BaseType_t prvParseValue(const char *pcValue, uint32_t ulMin, uint32_t ulMax, uint32_t *pulValue)
+{
+    char *pcEnd;
+    unsigned long ulValue;
+
+    if (pcValue[0] < '0' || pcValue[0] > '9')
+    {
+        return pdFALSE;
+    }
+    ulValue = strtoul(pcValue, &pcEnd, 10);
+    if (*pcEnd != '\0' || ulValue < ulMin || ulValue > ulMax)
+    {
+        return pdFALSE;
+    }
+
+    *pulValue = (uint32_t) ulValue;
+    return pdTRUE;
+}
+
+/* Stop taking blocks, then free the port */
+static void prvEndTransfer(BaseType_t xCompleted)
+{
+    osAcquireMutex(&netMutex);
+    xXfer.eState = eTftpIdle;
+    osReleaseMutex(&netMutex);
+
+    (void) udpUnregisterFastPath(NULL, xXfer.usPort);
+    socketClose(pxTransferSocket);
+    pxTransferSocket = NULL;
+
+    xStats.ulLastBytes = ulWritten;
+    xStats.ulLastMs = (uint32_t) (osGetSystemTime() - xXfer.xStart);
+    if (xCompleted != pdFALSE)
+    {
+        xStats.ulCompleted++;
+        xStats.ulBytes += ulWritten;
+    }
+    else
+    {
+        xStats.ulFailed++;
+    }
+}
+
+/* Give up, telling the client unless it gave up first */
+static void prvAbort(uint16_t usCode, const char *pcMessage)
+{
+    (void) pxTftpSink->pxClose(pdFALSE);
+
+    osAcquireMutex(&netMutex);
+    if (xXfer.xPeerError == pdFALSE)
+    {
+        xXfer.xReplyLength = prvFormatError(xXfer.ucReply, usCode, pcMessage);
+        prvSendReply(NULL);
+    }
+    osReleaseMutex(&netMutex);
+
+    prvEndTransfer(pdFALSE);
+}
+
+/* Write request: options, sink, transfer port, then the OACK (or ACK 0) */
+static void prvRequest(const SocketMsg *pxMessage)
+{
+    const char *pcName;
+    const char *pcMode;
+    const char *pcOption;
+    const char *pcValue;
+    const char *pcEnd = (const char *) ucRequest + pxMessage->length;
+    uint8_t *pucOut;
+    uint32_t ulBlockSize = 0;
+    uint32_t ulWindow = 0;
+    uint32_t ulTimeout = 0;
+    uint32_t ulSize = 0;
+    BaseType_t xSizeSet = pdFALSE;
+    uint32_t ulValue;
+    uint16_t usPort;
+
+    if (pxMessage->length < 4 || pxMessage->srcIpAddr.length != sizeof(Ipv4Addr))
+    {
+        return;
+    }
+
+    switch (LOAD16BE(ucRequest))
+    {
+    case TFTP_OPCODE_WRQ:
+        break;
+    case TFTP_OPCODE_RRQ:
+        prvRefuse(pxMessage, TFTP_ERROR_ACCESS_VIOLATION, "Write only");
+        return;
+    default:
+        return;
+    }
+
+    if (xXfer.eState != eTftpIdle)
+    {
+        /* The client repeating its request while the sink was opened */
+        if (!ipCompAddr(&pxMessage->srcIpAddr, &xXfer.xPeer) || pxMessage->srcPort != xXfer.usPeerPort)
+        {
+            prvRefuse(pxMessage, TFTP_ERROR_NOT_DEFINED, "Busy");
+        }
+        return;
+    }
+
+    /* Strings must be terminated within the datagram */
+    if (ucRequest[pxMessage->length - 1u] != '\0')
+    {
+        prvRefuse(pxMessage, TFTP_ERROR_ILLEGAL_OPERATION, "Malformed request");
+        return;
+    }
+    pcName = (const char *) ucRequest + 2;
+    pcMode = pcName + strlen(pcName) + 1;
+    if (pcMode >= pcEnd || osStrcasecmp(pcMode, "octet") != 0)
+    {
+        prvRefuse(pxMessage, TFTP_ERROR_ILLEGAL_OPERATION, "Octet mode only");
+        return;
+    }
+
+    /* Unknown options, and invalid values, are not granted (RFC 2347) */
+    for (pcOption = pcMode + strlen(pcMode) + 1; pcOption < pcEnd; pcOption = pcValue + strlen(pcValue) + 1)
+    {
+        pcValue = pcOption + strlen(pcOption) + 1;
+        if (pcValue >= pcEnd)
+        {
+            break;
+        }
+
+        if (osStrcasecmp(pcOption, "blksize") == 0 && prvParseValue(pcValue, TFTP_MIN_BLOCK_SIZE, 65464u, &ulValue))
+        {
+            ulBlockSize = MIN(ulValue, TFTP_SERVER_MAX_BLOCK_SIZE);
+        }
+        else if (osStrcasecmp(pcOption, "windowsize") == 0 && prvParseValue(pcValue, 1u, 65535u, &ulValue))
+        {
+            ulWindow = ulValue;
+        }
+        else if (osStrcasecmp(pcOption, "timeout") == 0 && prvParseValue(pcValue, 1u, 255u, &ulValue))
+        {
+            ulTimeout = ulValue;
+        }
+        else if (osStrcasecmp(pcOption, "tsize") == 0 && prvParseValue(pcValue, 0u, UINT32_MAX, &ulValue))
+        {
+            ulSize = ulValue;
+            xSizeSet = pdTRUE;
+        }
+    }
+
+    if (ulSize > pxTftpSink->ulCapacity)
+    {
+        prvRefuse(pxMessage, TFTP_ERROR_DISK_FULL, "File too large");
+        return;
+    }
+
+    memset(&xXfer, 0, sizeof(xXfer));
+    xXfer.xPeer = pxMessage->srcIpAddr;
+    xXfer.usPeerPort = pxMessage->srcPort;
+    xXfer.usBlockSize = (ulBlockSize != 0) ? (uint16_t) ulBlockSize : TFTP_DEFAULT_BLOCK_SIZE;
+    xXfer.usWindow = (uint16_t) MIN(MAX(ulWindow, 1u), TFTP_SERVER_MAX_WINDOW);
+    xXfer.usWindow = (uint16_t) MAX(MIN(xXfer.usWindow, (TFTP_SERVER_RING_SIZE / 2u) / xXfer.usBlockSize), 1u);
+    xXfer.ulTimeoutMs = ((ulTimeout != 0) ? ulTimeout : TFTP_SERVER_TIMEOUT_S) * 1000u;
+
+    /* May erase the flash for seconds; a repeated request is ignored meanwhile */
+    xStats.ulTransfers++;
+    if (pxTftpSink->pxOpen(pcName, ulSize) != pdPASS)
+    {
+        xStats.ulFailed++;
+        prvRefuse(pxMessage, TFTP_ERROR_ACCESS_VIOLATION, "Cannot store file");
+        return;
+    }
+
+    osAcquireMutex(&netMutex);
+    usPort = udpGetDynamicPort();
+    osReleaseMutex(&netMutex);
+
+    pxTransferSocket = socketOpen(SOCKET_TYPE_DGRAM, SOCKET_IP_PROTO_UDP);
+    if (pxTransferSocket == NULL || socketBind(pxTransferSocket, &IP_ADDR_ANY, usPort) != NO_ERROR ||
+        udpRegisterFastPath(NULL, usPort, prvTftpRx, NULL) != NO_ERROR)
+    {
+        socketClose(pxTransferSocket);
+        pxTransferSocket = NULL;
+        (void) pxTftpSink->pxClose(pdFALSE);
+        xStats.ulFailed++;
+        prvRefuse(pxMessage, TFTP_ERROR_NOT_DEFINED, "Out of resources");
+        return;
+    }
+
+    ulRingHead = 0;
+    ulRingTail = 0;
+    ulWritten = 0;
+    xStats.ulLastBlockSize = xXfer.usBlockSize;
+    xStats.ulLastWindow = xXfer.usWindow;
+
+    osAcquireMutex(&netMutex);
+    xXfer.usPort = usPort;
+    xXfer.xStart = osGetSystemTime();
+    xXfer.xLastRx = xXfer.xStart;
+    if (ulBlockSize != 0 || ulWindow != 0 || ulTimeout != 0 || xSizeSet != pdFALSE)
+    {
+        pucOut = xXfer.ucReply;
+        STORE16BE(TFTP_OPCODE_OACK, pucOut);
+        pucOut += 2;
+        if (ulBlockSize != 0)
+        {
+            pucOut = prvPutOption(pucOut, "blksize", xXfer.usBlockSize);
+        }
+        if (ulWindow != 0)
+        {
+            pucOut = prvPutOption(pucOut, "windowsize", xXfer.usWindow);
+        }
+        if (ulTimeout != 0)
+        {
+            pucOut = prvPutOption(pucOut, "timeout", ulTimeout);
+        }
+        if (xSizeSet != pdFALSE)
+        {
+            pucOut = prvPutOption(pucOut, "tsize", ulSize);
+        }
+        xXfer.xReplyLength = (size_t) (pucOut - xXfer.ucReply);
+        xXfer.eState = eTftpReceiving;
+        prvSendReply(NULL);
+    }
+    else
+    {
+        xXfer.eState = eTftpReceiving;
+        prvAck(NULL, 0);
+    }
+    osReleaseMutex(&netMutex);
+}
+
+/* Drain the ring into the sink, acknowledging a window held back for room */
+static BaseType_t prvDrain(void)
+{
+    uint32_t ulTail;
+    size_t xChunk;
+
+    for (;;)
+    {
+        ulTail = ulRingTail;
+        if (ulRingHead == ulTail)
+        {
+            return pdPASS;
+        }
+        xChunk = MIN(ulRingHead - ulTail, TFTP_SERVER_RING_SIZE - (ulTail & TFTP_RING_MASK));
+
+        if (ulWritten + xChunk > pxTftpSink->ulCapacity)
+        {
+            prvAbort(TFTP_ERROR_DISK_FULL, "File too large");
+            return pdFAIL;
+        }
+        if (pxTftpSink->pxWrite(&ucRing[ulTail & TFTP_RING_MASK], xChunk) != pdPASS)
+        {
+            prvAbort(TFTP_ERROR_NOT_DEFINED, "Write failed");
+            return pdFAIL;
+        }
+        ulWritten += (uint32_t) xChunk;
+        ulRingTail = ulTail + (uint32_t) xChunk;
+
+        osAcquireMutex(&netMutex);
+        if (xXfer.xAckDeferred != pdFALSE && prvRingRoom() >= (uint32_t) xXfer.usWindow * xXfer.usBlockSize)
+        {
+            xXfer.xAckDeferred = pdFALSE;
+            xXfer.xLastRx = osGetSystemTime();
+            prvAck(NULL, xXfer.ulBlocks);
+        }
+        osReleaseMutex(&netMutex);
+    }
+}
+
+/* Time until the server has to act on its own, INFINITE_DELAY if idle */
+static systime_t prvService(void)
+{
+    systime_t xNow;
+    systime_t xDeadline;
+    TftpState_t eState;
+    BaseType_t xCommitted;
+
+    if (xXfer.eState == eTftpIdle)
+    {
+        return INFINITE_DELAY;
+    }
+    if (xXfer.xPeerError != pdFALSE)
+    {
+        prvAbort(TFTP_ERROR_NOT_DEFINED, "");
+        return INFINITE_DELAY;
+    }
+
+    if (xXfer.eState != eTftpDallying && prvDrain() != pdPASS)
+    {
+        return INFINITE_DELAY;
+    }
+
+    osAcquireMutex(&netMutex);
+    eState = xXfer.eState;
+    osReleaseMutex(&netMutex);
+
+    /* Everything stored: the last ACK tells the client it is */
+    if (eState == eTftpComplete)
+    {
+        xCommitted = pxTftpSink->pxClose(pdTRUE);
+
+        osAcquireMutex(&netMutex);
+        if (xCommitted == pdPASS)
+        {
+            xXfer.eState = eTftpDallying;
+            xXfer.xLastRx = osGetSystemTime();
+            prvAck(NULL, xXfer.ulBlocks);
+        }
+        else
+        {
+            xXfer.xReplyLength = prvFormatError(xXfer.ucReply, TFTP_ERROR_NOT_DEFINED, "Write failed");
+            prvSendReply(NULL);
+        }
+        osReleaseMutex(&netMutex);
+
+        if (xCommitted != pdPASS)
+        {
+            prvEndTransfer(pdFALSE);
+            return INFINITE_DELAY;
+        }
+    }
+
+    xNow = osGetSystemTime();
+
+    osAcquireMutex(&netMutex);
+    eState = xXfer.eState;
+    if (xXfer.xAckDeferred != pdFALSE)
+    {
+        xXfer.xLastRx = xNow;
+    }
+    xDeadline = xXfer.xLastRx + ((eState == eTftpDallying) ? 2u * xXfer.ulTimeoutMs : xXfer.ulTimeoutMs);
+    if (timeCompare(xNow, xDeadline) >= 0 && eState == eTftpReceiving && xXfer.uxRetries < TFTP_SERVER_RETRIES)
+    {
+        xXfer.uxRetries++;
+        xXfer.xLastRx = xNow;
+        xDeadline = xNow + xXfer.ulTimeoutMs;
+        xStats.ulTimeouts++;
+        prvSendReply(NULL);
+    }
+    osReleaseMutex(&netMutex);
+
+    if (timeCompare(xNow, xDeadline) < 0)
+    {
+        return xDeadline - xNow;
+    }
+
+    if (eState == eTftpDallying)
+    {
+        prvEndTransfer(pdTRUE);
+    }
+    else
+    {
+        prvAbort(TFTP_ERROR_NOT_DEFINED, "Timeout");
+    }
+    return INFINITE_DELAY;
+}
+
+static void prvTftpTask(void *pvParameters)
+{
+    SocketEventDesc xEvents[1];
+    SocketMsg xMessage;
+    systime_t xWait = INFINITE_DELAY;
+
+    (void) pvParameters;
+
+    pxListener = socketOpen(SOCKET_TYPE_DGRAM, SOCKET_IP_PROTO_UDP);
+    if (pxListener == NULL || socketBind(pxListener, &IP_ADDR_ANY, TFTP_PORT) != NO_ERROR)
+    {
+        vTaskDelete(NULL);
+        return;
+    }
+
+    for (;;)
+    {
+        xEvents[0].socket = pxListener;
+        xEvents[0].eventMask = SOCKET_EVENT_RX_READY;
+        xEvents[0].eventFlags = 0;
+
+        if (socketPoll(xEvents, 1, &xTftpEvent, xWait) == NO_ERROR &&
+            (xEvents[0].eventFlags & SOCKET_EVENT_RX_READY) != 0)
+        {
+            xMessage = SOCKET_DEFAULT_MSG;
+            xMessage.data = ucRequest;
+            xMessage.size = sizeof(ucRequest);
+            if (socketReceiveMsg(pxListener, &xMessage, SOCKET_FLAG_DONT_WAIT) == NO_ERROR)
+            {
+                prvRequest(&xMessage);
+            }
+        }
+
+        xWait = prvService();
+    }
+}
+
+BaseType_t xTftpServerStart(UBaseType_t uxPriority, const TftpSink_t *pxSink)
+{
+    if (pxSink == NULL || !osCreateEvent(&xTftpEvent))
+    {
+        return pdFAIL;
+    }
+    pxTftpSink = pxSink;
+
+    return xAppTaskCreate(xTftpTask,
+                          prvTftpTask,
+                          "TFTP",
+                          TFTP_SERVER_TASK_STACK_SIZE,
+                          NULL,
+                          uxPriority,
+                          &xTftpTask);
+}
+
+void vTftpServerGetStats(TftpServerStats_t *pxStats)
+{
+    taskENTER_CRITICAL();
+    *pxStats = xStats;
+    taskEXIT_CRITICAL();
+}
+
+static BaseType_t prvTftpCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    static UBaseType_t uxLine = 0;
+    static TftpServerStats_t xReport;
+    uint32_t ulKbps;
+
+    (void) pcCommandString;
+
+    if (uxLine == 0)
+    {
+        vTftpServerGetStats(&xReport);
+    }
+
+    switch (uxLine++)
+    {
+    case 0:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "tftp: %s, %lu B received, %lu B stored\r\n",
+                 (xXfer.eState == eTftpIdle) ? "idle" : "receiving",
+                 (unsigned long) xXfer.ulBytes, (unsigned long) ulWritten);
+        return pdTRUE;
+    case 1:
+        ulKbps = (xReport.ulLastMs != 0) ? (uint32_t) (((uint64_t) xReport.ulLastBytes * 8u) / xReport.ulLastMs) : 0u;
+        snprintf(pcWriteBuffer, xWriteBufferLen, "last: %lu B in %lu ms (%lu kbit/s), blksize %lu, window %lu\r\n",
+                 (unsigned long) xReport.ulLastBytes, (unsigned long) xReport.ulLastMs, (unsigned long) ulKbps,
+                 (unsigned long) xReport.ulLastBlockSize, (unsigned long) xReport.ulLastWindow);
+        return pdTRUE;
+    default:
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "transfers %lu completed %lu failed %lu refused %lu out-of-order %lu deferred %lu timeouts %lu\r\n",
+                 (unsigned long) xReport.ulTransfers, (unsigned long) xReport.ulCompleted,
+                 (unsigned long) xReport.ulFailed, (unsigned long) xReport.ulRefused,
+                 (unsigned long) xReport.ulOutOfOrder, (unsigned long) xReport.ulDeferredAcks,
+                 (unsigned long) xReport.ulTimeouts);
+        uxLine = 0;
+        return pdFALSE;
+    }
+}
+
+void vTftpServerRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xTftp);
+}
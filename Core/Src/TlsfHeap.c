@@ -0,0 +1,554 @@
+/* TlsfHeap.c
+ *
+ * Two-level segregated fit allocator (see TlsfHeap.h).
+ *
+ * Every block starts with a header holding the previous block in memory and
+ * the size of the block's payload; the two low bits of the size, always 0
+ * otherwise, flag the block as free and the previous block as free. A free
+ * block links into the list of its class through two pointers kept in its
+ * payload. A sentinel block of size 0, never free, ends the pool, so that
+ * every block has a next block and merging needs no bound check.
+ *
+ * Classes: sizes below TLSF_SMALL_SIZE share first level 0, split in
+ * TLSF_SL_COUNT steps of TLSF_SMALL_SIZE / TLSF_SL_COUNT bytes; above, first
+ * level f covers [2^(f + TLSF_FL_SHIFT - 1), 2^(f + TLSF_FL_SHIFT)). An
+ * allocation rounds its size up to the next class boundary so that any block
+ * of the class found serves it, then takes the first non-empty class at or
+ * above it from the bitmaps: a count-leading-zeros per level.
+ */
+#include "TlsfHeap.h"
+#include "task.h"
+#include "FreeRTOS_CLI.h"
+#include "stm32h7xx_hal.h"
+#include "os_port.h"
+#include "MemTag.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TLSF_ALIGN_LOG2                3
+#define TLSF_ALIGN                     (1u << TLSF_ALIGN_LOG2)
+#define TLSF_SL_COUNT                  (1u << TLSF_SL_LOG2)
+#define TLSF_FL_SHIFT                  (TLSF_SL_LOG2 + TLSF_ALIGN_LOG2)
+#define TLSF_FL_COUNT                  (TLSF_FL_MAX - TLSF_FL_SHIFT + 1)
+#define TLSF_SMALL_SIZE                (1u << TLSF_FL_SHIFT)
+
+/* Flags in the low bits of xSize */
+#define TLSF_BLOCK_FREE                0x1u
+#define TLSF_PREV_FREE                 0x2u
+#define TLSF_SIZE_MASK                 (~(size_t) (TLSF_ALIGN - 1))
+
+#if (TLSF_HEAP_SIZE > (1u << TLSF_FL_MAX))
+#error "TLSF_HEAP_SIZE exceeds the largest block class"
+#endif
+
+typedef struct TlsfBlock
+{
+    struct TlsfBlock *pxPrevPhys;   /* Previous block in memory, NULL for the first */
+    size_t xSize;                   /* Payload bytes, with the flags */
+    /* Payload; while the block is free it starts with the list links */
+    struct TlsfBlock *pxNextFree;
+    struct TlsfBlock *pxPrevFree;
+} TlsfBlock_t;
+
+#define TLSF_HEADER_SIZE               offsetof(TlsfBlock_t, pxNextFree)
+#define TLSF_MIN_PAYLOAD               (sizeof(TlsfBlock_t) - TLSF_HEADER_SIZE)
+#define TLSF_MAX_PAYLOAD               (TLSF_HEAP_SIZE - (2 * TLSF_HEADER_SIZE))
+
+static uint8_t ucTlsfPool[TLSF_HEAP_SIZE] __attribute__((aligned(TLSF_ALIGN)));
+
+static uint32_t ulFlBitmap;
+static uint32_t ulSlBitmap[TLSF_FL_COUNT];
+static TlsfBlock_t *pxFreeLists[TLSF_FL_COUNT][TLSF_SL_COUNT];
+static TlsfBlock_t *pxFirstBlock = NULL;
+
+static TlsfHeapStats_t xStats;
+
+static inline size_t prvSize(const TlsfBlock_t *pxBlock)
+{
+    return pxBlock->xSize & TLSF_SIZE_MASK;
+}
+
+static inline TlsfBlock_t *prvNextPhys(const TlsfBlock_t *pxBlock)
+{
+    return (TlsfBlock_t *) ((uint8_t *) pxBlock + TLSF_HEADER_SIZE + prvSize(pxBlock));
+}
+
+static inline uint32_t prvFls(uint32_t ulValue)
+{
+    return 31u - (uint32_t) __builtin_clz(ulValue);
+}
+
+static inline uint32_t prvFfs(uint32_t ulValue)
+{
+    return (uint32_t) __builtin_ctz(ulValue);
+}
+
+/* Class of a block of xSize bytes */
+static void prvMapping(size_t xSize, uint32_t *pulFl, uint32_t *pulSl)
+{
+    uint32_t ulFl;
+
+    if (xSize < TLSF_SMALL_SIZE)
+    {
+        *pulFl = 0;
+        *pulSl = (uint32_t) xSize / (TLSF_SMALL_SIZE / TLSF_SL_COUNT);
+    }
+    else
+    {
+        ulFl = prvFls((uint32_t) xSize);
+        *pulSl = (uint32_t) (xSize >> (ulFl - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+        *pulFl = ulFl - (TLSF_FL_SHIFT - 1);
+    }
+}
+
+static void prvInsertFree(TlsfBlock_t *pxBlock)
+{
+    uint32_t ulFl;
+    uint32_t ulSl;
+
+    prvMapping(prvSize(pxBlock), &ulFl, &ulSl);
+
+    pxBlock->pxPrevFree = NULL;
+    pxBlock->pxNextFree = pxFreeLists[ulFl][ulSl];
+    if (pxBlock->pxNextFree != NULL)
+    {
+        pxBlock->pxNextFree->pxPrevFree = pxBlock;
+    }
+    pxFreeLists[ulFl][ulSl] = pxBlock;
+
+    ulFlBitmap |= 1u << ulFl;
+    ulSlBitmap[ulFl] |= 1u << ulSl;
+
+    xStats.xFree += prvSize(pxBlock);
+    xStats.ulFreeBlocks++;
+}
+
+static void prvRemoveFree(TlsfBlock_t *pxBlock)
+{
+    uint32_t ulFl;
+    uint32_t ulSl;
+
+    prvMapping(prvSize(pxBlock), &ulFl, &ulSl);
+
+    if (pxBlock->pxPrevFree != NULL)
+    {
+        pxBlock->pxPrevFree->pxNextFree = pxBlock->pxNextFree;
+    }
+    else
+    {
+        pxFreeLists[ulFl][ulSl] = pxBlock->pxNextFree;
+        if (pxBlock->pxNextFree == NULL)
+        {
+            ulSlBitmap[ulFl] &= ~(1u << ulSl);
+            if (ulSlBitmap[ulFl] == 0)
+            {
+                ulFlBitmap &= ~(1u << ulFl);
+            }
+        }
+    }
+    if (pxBlock->pxNextFree != NULL)
+    {
+        pxBlock->pxNextFree->pxPrevFree = pxBlock->pxPrevFree;
+    }
+
+    xStats.xFree -= prvSize(pxBlock);
+    xStats.ulFreeBlocks--;
+}
+
+/* One free block spanning the pool, then the sentinel */
+static void prvHeapInit(void)
+{
+    TlsfBlock_t *pxSentinel;
+
+    pxFirstBlock = (TlsfBlock_t *) ucTlsfPool;
+    pxFirstBlock->pxPrevPhys = NULL;
+    pxFirstBlock->xSize = TLSF_MAX_PAYLOAD | TLSF_BLOCK_FREE;
+
+    pxSentinel = prvNextPhys(pxFirstBlock);
+    pxSentinel->pxPrevPhys = pxFirstBlock;
+    pxSentinel->xSize = TLSF_PREV_FREE;
+
+    xStats.xSize = TLSF_MAX_PAYLOAD;
+    prvInsertFree(pxFirstBlock);
+    xStats.xMinFree = xStats.xFree;
+}
+
+/* First free block of the class of xSize or above, NULL if none */
+static TlsfBlock_t *prvFindFree(size_t xSize)
+{
+    uint32_t ulFl;
+    uint32_t ulSl;
+    uint32_t ulMap;
+
+    /* Round up to the next class boundary: any block of the class fits */
+    if (xSize >= TLSF_SMALL_SIZE)
+    {
+        xSize += (1u << (prvFls((uint32_t) xSize) - TLSF_SL_LOG2)) - 1u;
+    }
+    prvMapping(xSize, &ulFl, &ulSl);
+    if (ulFl >= TLSF_FL_COUNT)
+    {
+        return NULL;
+    }
+
+    ulMap = ulSlBitmap[ulFl] & (~0u << ulSl);
+    if (ulMap == 0)
+    {
+        ulMap = (ulFl + 1 < 32) ? (ulFlBitmap & (~0u << (ulFl + 1))) : 0;
+        if (ulMap == 0)
+        {
+            return NULL;
+        }
+        ulFl = prvFfs(ulMap);
+        ulMap = ulSlBitmap[ulFl];
+    }
+    ulSl = prvFfs(ulMap);
+
+    return pxFreeLists[ulFl][ulSl];
+}
+
+static BaseType_t prvCheck(void)
+{
+    const TlsfBlock_t *pxBlock;
+    const TlsfBlock_t *pxPrev = NULL;
+    const TlsfBlock_t *pxFree;
+    uint32_t ulFl;
+    uint32_t ulSl;
+    uint32_t ulMapFl;
+    uint32_t ulMapSl;
+    uint32_t ulFreeBlocks = 0;
+    uint32_t ulListed = 0;
+    size_t xFree = 0;
+    BaseType_t xPrevFree = pdFALSE;
+
+    /* Physical chain: links, flags and no two free neighbours */
+    for (pxBlock = pxFirstBlock; prvSize(pxBlock) != 0; pxBlock = prvNextPhys(pxBlock))
+    {
+        if (pxBlock->pxPrevPhys != pxPrev
+            || ((pxBlock->xSize & TLSF_PREV_FREE) != 0) != (xPrevFree != pdFALSE)
+            || (uint8_t *) prvNextPhys(pxBlock) > ucTlsfPool + TLSF_HEAP_SIZE - TLSF_HEADER_SIZE)
+        {
+            return pdFAIL;
+        }
+
+        if ((pxBlock->xSize & TLSF_BLOCK_FREE) != 0)
+        {
+            if (xPrevFree != pdFALSE)
+            {
+                return pdFAIL;
+            }
+            ulFreeBlocks++;
+            xFree += prvSize(pxBlock);
+        }
+
+        xPrevFree = ((pxBlock->xSize & TLSF_BLOCK_FREE) != 0) ? pdTRUE : pdFALSE;
+        pxPrev = pxBlock;
+    }
+
+    /* Sentinel */
+    if (pxBlock->pxPrevPhys != pxPrev || ((pxBlock->xSize & TLSF_PREV_FREE) != 0) != (xPrevFree != pdFALSE)
+        || (pxBlock->xSize & TLSF_BLOCK_FREE) != 0)
+    {
+        return pdFAIL;
+    }
+
+    /* Free lists: every block free and of its list's class, bitmaps set
+     * exactly for the non-empty lists */
+    for (ulFl = 0; ulFl < TLSF_FL_COUNT; ulFl++)
+    {
+        if (((ulFlBitmap >> ulFl) & 1u) != (ulSlBitmap[ulFl] != 0 ? 1u : 0u))
+        {
+            return pdFAIL;
+        }
+
+        for (ulSl = 0; ulSl < TLSF_SL_COUNT; ulSl++)
+        {
+            if (((ulSlBitmap[ulFl] >> ulSl) & 1u) != (pxFreeLists[ulFl][ulSl] != NULL ? 1u : 0u))
+            {
+                return pdFAIL;
+            }
+
+            for (pxFree = pxFreeLists[ulFl][ulSl]; pxFree != NULL; pxFree = pxFree->pxNextFree)
+            {
+                if ((pxFree->xSize & TLSF_BLOCK_FREE) == 0 || ulListed++ > ulFreeBlocks)
+                {
+                    return pdFAIL;
+                }
+
+                prvMapping(prvSize(pxFree), &ulMapFl, &ulMapSl);
+                if (ulMapFl != ulFl || ulMapSl != ulSl)
+                {
+                    return pdFAIL;
+                }
+            }
+        }
+    }
+
+    if (ulListed != ulFreeBlocks || ulFreeBlocks != xStats.ulFreeBlocks || xFree != xStats.xFree)
+    {
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+
+void *pvTlsfHeapAlloc(size_t xSize)
+{
+    TlsfBlock_t *pxBlock = NULL;
+    TlsfBlock_t *pxRest;
+    TlsfBlock_t *pxNext;
+    UBaseType_t uxMask;
+    uint32_t ulStart = DWT->CYCCNT;
+    uint32_t ulCycles;
+
+    /* A size beyond the pool is refused below, as no class holds it */
+    if (xSize > TLSF_MAX_PAYLOAD)
+    {
+        xSize = TLSF_HEAP_SIZE;
+    }
+    xSize = (xSize < TLSF_MIN_PAYLOAD) ? TLSF_MIN_PAYLOAD : ((xSize + TLSF_ALIGN - 1) & TLSF_SIZE_MASK);
+
+    uxMask = taskENTER_CRITICAL_FROM_ISR();
+    {
+        if (pxFirstBlock == NULL)
+        {
+            prvHeapInit();
+        }
+
+        pxBlock = prvFindFree(xSize);
+        if (pxBlock != NULL)
+        {
+            prvRemoveFree(pxBlock);
+            pxNext = prvNextPhys(pxBlock);
+
+            /* Split off what the request leaves, if it makes a block */
+            if (prvSize(pxBlock) >= xSize + TLSF_HEADER_SIZE + TLSF_MIN_PAYLOAD)
+            {
+                pxRest = (TlsfBlock_t *) ((uint8_t *) pxBlock + TLSF_HEADER_SIZE + xSize);
+                pxRest->pxPrevPhys = pxBlock;
+                pxRest->xSize = (prvSize(pxBlock) - xSize - TLSF_HEADER_SIZE) | TLSF_BLOCK_FREE;
+                pxNext->pxPrevPhys = pxRest;
+                pxBlock->xSize = xSize | (pxBlock->xSize & TLSF_PREV_FREE);
+                prvInsertFree(pxRest);
+            }
+            else
+            {
+                pxBlock->xSize &= ~(size_t) TLSF_BLOCK_FREE;
+                pxNext->xSize &= ~(size_t) TLSF_PREV_FREE;
+            }
+
+            xStats.ulUsedBlocks++;
+            xStats.ulAllocations++;
+            if (xStats.xFree < xStats.xMinFree)
+            {
+                xStats.xMinFree = xStats.xFree;
+            }
+        }
+        else
+        {
+            xStats.ulFailures++;
+        }
+
+#if (TLSF_HEAP_CHECK == 1)
+        configASSERT(prvCheck() == pdPASS);
+#endif
+
+        ulCycles = DWT->CYCCNT - ulStart;
+        if (ulCycles > xStats.ulMaxAllocCycles)
+        {
+            xStats.ulMaxAllocCycles = ulCycles;
+        }
+    }
+    taskEXIT_CRITICAL_FROM_ISR(uxMask);
+
+    return (pxBlock != NULL) ? (uint8_t *) pxBlock + TLSF_HEADER_SIZE : NULL;
+}
+
+void vTlsfHeapFree(void *pv)
+{
+    TlsfBlock_t *pxBlock;
+    TlsfBlock_t *pxNeighbour;
+    UBaseType_t uxMask;
+    uint32_t ulStart = DWT->CYCCNT;
+    uint32_t ulCycles;
+
+    if (pv == NULL)
+    {
+        return;
+    }
+
+    pxBlock = (TlsfBlock_t *) ((uint8_t *) pv - TLSF_HEADER_SIZE);
+    configASSERT((uint8_t *) pxBlock >= ucTlsfPool && (uint8_t *) pv < ucTlsfPool + TLSF_HEAP_SIZE);
+    configASSERT((pxBlock->xSize & TLSF_BLOCK_FREE) == 0);
+
+    uxMask = taskENTER_CRITICAL_FROM_ISR();
+    {
+        xStats.ulUsedBlocks--;
+        xStats.ulFrees++;
+
+        /* Merge with the previous block */
+        if ((pxBlock->xSize & TLSF_PREV_FREE) != 0)
+        {
+            pxNeighbour = pxBlock->pxPrevPhys;
+            prvRemoveFree(pxNeighbour);
+            pxNeighbour->xSize += TLSF_HEADER_SIZE + prvSize(pxBlock);
+            pxBlock = pxNeighbour;
+            prvNextPhys(pxBlock)->pxPrevPhys = pxBlock;
+        }
+
+        /* Merge with the next block */
+        pxNeighbour = prvNextPhys(pxBlock);
+        if ((pxNeighbour->xSize & TLSF_BLOCK_FREE) != 0)
+        {
+            prvRemoveFree(pxNeighbour);
+            pxBlock->xSize += TLSF_HEADER_SIZE + prvSize(pxNeighbour);
+            prvNextPhys(pxBlock)->pxPrevPhys = pxBlock;
+        }
+
+        pxBlock->xSize |= TLSF_BLOCK_FREE;
+        prvNextPhys(pxBlock)->xSize |= TLSF_PREV_FREE;
+        prvInsertFree(pxBlock);
+
+#if (TLSF_HEAP_CHECK == 1)
+        configASSERT(prvCheck() == pdPASS);
+#endif
+
+        ulCycles = DWT->CYCCNT - ulStart;
+        if (ulCycles > xStats.ulMaxFreeCycles)
+        {
+            xStats.ulMaxFreeCycles = ulCycles;
+        }
+    }
+    taskEXIT_CRITICAL_FROM_ISR(uxMask);
+}
+
+void vTlsfHeapGetStats(TlsfHeapStats_t *pxStats)
+{
+    const TlsfBlock_t *pxBlock;
+    uint32_t ulFl;
+    uint32_t ulSl;
+    size_t xLargest = 0;
+    UBaseType_t uxMask;
+
+    uxMask = taskENTER_CRITICAL_FROM_ISR();
+    {
+        if (pxFirstBlock == NULL)
+        {
+            prvHeapInit();
+        }
+
+        /* The largest block is in the highest non-empty class */
+        if (ulFlBitmap != 0)
+        {
+            ulFl = prvFls(ulFlBitmap);
+            ulSl = prvFls(ulSlBitmap[ulFl]);
+            for (pxBlock = pxFreeLists[ulFl][ulSl]; pxBlock != NULL; pxBlock = pxBlock->pxNextFree)
+            {
+                if (prvSize(pxBlock) > xLargest)
+                {
+                    xLargest = prvSize(pxBlock);
+                }
+            }
+        }
+
+        *pxStats = xStats;
+    }
+    taskEXIT_CRITICAL_FROM_ISR(uxMask);
+
+    pxStats->xLargestFree = xLargest;
+    pxStats->ulFragmentationPermille = (pxStats->xFree > 0)
+        ? (uint32_t) (1000u - (uint32_t) (((uint64_t) xLargest * 1000u) / pxStats->xFree)) : 0;
+}
+
+BaseType_t xTlsfHeapCheck(void)
+{
+    UBaseType_t uxMask;
+    BaseType_t xResult;
+
+    uxMask = taskENTER_CRITICAL_FROM_ISR();
+    {
+        if (pxFirstBlock == NULL)
+        {
+            prvHeapInit();
+        }
+
+        xResult = prvCheck();
+    }
+    taskEXIT_CRITICAL_FROM_ISR(uxMask);
+
+    return xResult;
+}
+
+#if (TLSF_HEAP_SUPPORT == 1) && (MEM_TAG_SUPPORT == 0)
+
+/* Strong definitions over the weak ones of os_port_freertos.c; MemTag.c
+   takes their place while allocations are tagged */
+void *osAllocMem(size_t size)
+{
+    return pvTlsfHeapAlloc(size);
+}
+
+void osFreeMem(void *p)
+{
+    vTlsfHeapFree(p);
+}
+
+#endif /* TLSF_HEAP_SUPPORT */
+
+static BaseType_t prvTlsfCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xTlsf =
+{
+    "tlsf",
+    "\r\ntlsf:\r\n TLSF heap usage, fragmentation, worst-case latencies and integrity check\r\n",
+    prvTlsfCommand,
+    0
+};
+
+/* Heap statistics and the result of the consistency walk, taken on the
+ * first line: the walk is too long to repeat for each line of the CLI */
+static TlsfHeapStats_t xTlsfReport;
+static BaseType_t xTlsfReportCheck;
+static UBaseType_t uxTlsfLine = 0;
+
+static BaseType_t prvTlsfCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    (void) pcCommandString;
+
+    if (uxTlsfLine == 0)
+    {
+        vTlsfHeapGetStats(&xTlsfReport);
+        xTlsfReportCheck = xTlsfHeapCheck();
+    }
+
+    switch (uxTlsfLine++)
+    {
+    case 0:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "tlsf: %s, size=%lu free=%lu min-free=%lu largest=%lu\r\n",
+                 (TLSF_HEAP_SUPPORT == 1) ? "serves osAllocMem" : "unused (heap_4)",
+                 (unsigned long) xTlsfReport.xSize, (unsigned long) xTlsfReport.xFree,
+                 (unsigned long) xTlsfReport.xMinFree, (unsigned long) xTlsfReport.xLargestFree);
+        return pdTRUE;
+    case 1:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "blocks: used=%lu free=%lu fragmentation=%lu.%lu%%\r\n",
+                 (unsigned long) xTlsfReport.ulUsedBlocks, (unsigned long) xTlsfReport.ulFreeBlocks,
+                 (unsigned long) (xTlsfReport.ulFragmentationPermille / 10u),
+                 (unsigned long) (xTlsfReport.ulFragmentationPermille % 10u));
+        return pdTRUE;
+    case 2:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "calls: alloc=%lu free=%lu failed=%lu max-alloc=%lu cycles max-free=%lu cycles\r\n",
+                 (unsigned long) xTlsfReport.ulAllocations, (unsigned long) xTlsfReport.ulFrees,
+                 (unsigned long) xTlsfReport.ulFailures, (unsigned long) xTlsfReport.ulMaxAllocCycles,
+                 (unsigned long) xTlsfReport.ulMaxFreeCycles);
+        return pdTRUE;
+    default:
+        snprintf(pcWriteBuffer, xWriteBufferLen, "check: %s\r\n", (xTlsfReportCheck == pdPASS) ? "ok" : "CORRUPTED");
+        uxTlsfLine = 0;
+        return pdFALSE;
+    }
+}
+
+void vTlsfHeapRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xTlsf);
+}
@@ -0,0 +1,384 @@
+/* TraceRecorder.c
+ *
+ * Ring buffer of trace events and its UDP streamer (see TraceRecorder.h).
+ *
+ * Producers reserve a slot by moving the head index with LDREX / STREX, the
+ * cycle count being read inside the reservation so that slot order is time
+ * order; an exception between the two clears the exclusive monitor and the
+ * reservation starts again. The type is written last and commits the
+ * record: the streamer stops at the first slot still of type
+ * TRACE_EVENT_NONE, which a preempted producer has reserved but not filled
+ * yet, and sets the type of every slot it consumes back to it. Only the
+ * streamer moves the tail index.
+ */
+#include "TraceRecorder.h"
+#include "task.h"
+#include "stm32h7xx.h"
+#include "core/net.h"
+#include "core/socket.h"
+#include "RunTimeStats.h"
+#include "StaticAlloc.h"
+#include "TcmPlacement.h"
+#include <string.h>
+
+#define TRACE_RING_MASK                (TRACE_RECORDER_EVENTS - 1u)
+
+#if ((TRACE_RECORDER_EVENTS & TRACE_RING_MASK) != 0)
+#error TRACE_RECORDER_EVENTS must be a power of two
+#endif
+
+/* Ring buffer, in the DTCM: the CPU alone touches it */
+static TraceEvent_t xTraceRing[TRACE_RECORDER_EVENTS] TCM_BSS;
+static volatile uint32_t ulTraceHead = 0;
+static volatile uint32_t ulTraceTail = 0;
+static volatile uint32_t ulTraceDropped = 0;
+static volatile uint32_t ulTraceRunning = 0;
+
+/* Records before this index are discarded (vTraceClear) */
+static volatile uint32_t ulTraceClearUntil = 0;
+static volatile uint32_t ulTraceClearPending = 0;
+
+/* Host, changed by xTraceRecorderSetHost() */
+static IpAddr xTraceHost;
+static uint16_t usTracePort = 0;
+
+static TaskHandle_t xStreamTask = NULL;
+APP_TASK_STORAGE(xStreamTask, TRACE_STREAM_STACK_SIZE);
+
+static uint32_t ulStreamSequence = 0;
+static uint32_t ulStreamPacket[(sizeof(TraceStreamHeader_t) +
+                                TRACE_STREAM_MAX_EVENTS * sizeof(TraceEvent_t) + 3u) / 4u];
+static TaskStatus_t xStreamTasks[TRACE_STREAM_MAX_TASKS];
+
+static void prvTraceStreamTask(void *pvParameters);
+
+static TCM_CODE void prvAtomicIncrement(volatile uint32_t *pulValue)
+{
+    uint32_t ulValue;
+
+    do
+    {
+        ulValue = __LDREXW(pulValue);
+    } while (__STREXW(ulValue + 1u, pulValue) != 0u);
+}
+
+static TCM_CODE void prvRecord(uint8_t ucType, uint8_t ucId, uint16_t usArg, uint32_t ulObject)
+{
+    TraceEvent_t *pxEvent;
+    uint32_t ulHead;
+    uint32_t ulCycles;
+
+    do
+    {
+        ulHead = __LDREXW(&ulTraceHead);
+        ulCycles = DWT->CYCCNT;
+
+        if ((ulHead - ulTraceTail) >= TRACE_RECORDER_EVENTS)
+        {
+            __CLREX();
+            prvAtomicIncrement(&ulTraceDropped);
+            return;
+        }
+    } while (__STREXW(ulHead + 1u, &ulTraceHead) != 0u);
+
+    pxEvent = &xTraceRing[ulHead & TRACE_RING_MASK];
+    pxEvent->ulCycles = ulCycles;
+    pxEvent->ucId = ucId;
+    pxEvent->usArg = usArg;
+    pxEvent->ulObject = ulObject;
+
+    /* The type commits the record, once the rest is in place */
+    __DMB();
+    pxEvent->ucType = ucType;
+}
+
+#if (TRACE_RECORDER == 1)
+
+TCM_CODE void vTraceRecorderTaskSwitchedIn(uint32_t ulTaskNumber)
+{
+    if (ulTraceRunning != 0)
+    {
+        prvRecord(TRACE_EVENT_TASK_SWITCH, (uint8_t) ulTaskNumber, 0, 0);
+    }
+}
+
+TCM_CODE void vTraceRecorderQueue(uint8_t ucType, const void *pvQueue, uint8_t ucQueueType)
+{
+    if (ulTraceRunning != 0)
+    {
+        prvRecord(ucType, ucQueueType, 0, (uint32_t) (uintptr_t) pvQueue);
+    }
+}
+
+TCM_CODE void vTraceRecorderStream(uint8_t ucType, const void *pvStreamBuffer, size_t xBytes)
+{
+    if (ulTraceRunning != 0)
+    {
+        prvRecord(ucType, 0, (uint16_t) MIN(xBytes, UINT16_MAX), (uint32_t) (uintptr_t) pvStreamBuffer);
+    }
+}
+
+TCM_CODE void vTraceRecorderIsrEnter(uint32_t ulSource)
+{
+    if (ulTraceRunning != 0)
+    {
+        prvRecord(TRACE_EVENT_ISR_ENTER, (uint8_t) ulSource, 0, 0);
+    }
+}
+
+TCM_CODE void vTraceRecorderIsrExit(uint32_t ulSource)
+{
+    if (ulTraceRunning != 0)
+    {
+        prvRecord(TRACE_EVENT_ISR_EXIT, (uint8_t) ulSource, 0, 0);
+    }
+}
+
+TCM_CODE void vTraceRecorderUserEvent(uint8_t ucId, uint16_t usArg, uint32_t ulObject)
+{
+    if (ulTraceRunning != 0)
+    {
+        prvRecord(TRACE_EVENT_USER, ucId, usArg, ulObject);
+    }
+}
+
+#endif
+
+BaseType_t xTraceRecorderSetHost(const char *pcAddress, uint16_t usPort)
+{
+    IpAddr xAddr;
+
+    if (pcAddress != NULL)
+    {
+        if (ipStringToAddr(pcAddress, &xAddr) != NO_ERROR || xAddr.length != sizeof(Ipv4Addr))
+        {
+            return pdFAIL;
+        }
+
+        taskENTER_CRITICAL();
+        xTraceHost = xAddr;
+        taskEXIT_CRITICAL();
+    }
+
+    if (usPort != 0 || usTracePort == 0)
+    {
+        usTracePort = (usPort != 0) ? usPort : TRACE_STREAM_PORT;
+    }
+
+    return pdPASS;
+}
+
+BaseType_t xTraceRecorderHasHost(void)
+{
+    return (xTraceHost.length != 0) ? pdTRUE : pdFALSE;
+}
+
+void vTraceStart(void)
+{
+    ulTraceRunning = 1;
+
+    if (xStreamTask != NULL)
+    {
+        xTaskNotifyGive(xStreamTask);
+    }
+}
+
+void vTraceStop(void)
+{
+    /* What is in the ring is still streamed */
+    ulTraceRunning = 0;
+}
+
+void vTraceClear(void)
+{
+    /* The streamer owns the tail: it discards up to the current head */
+    taskENTER_CRITICAL();
+    ulTraceClearUntil = ulTraceHead;
+    ulTraceClearPending = 1;
+    ulTraceDropped = 0;
+    ulStreamSequence = 0;
+    taskEXIT_CRITICAL();
+
+    if (xStreamTask != NULL)
+    {
+        xTaskNotifyGive(xStreamTask);
+    }
+}
+
+uint32_t ulTraceRecorderDropped(void)
+{
+    return ulTraceDropped;
+}
+
+/* Reads the ring only: the slots keep their type, the tail does not move */
+UBaseType_t uxTraceRecorderLatest(TraceEvent_t *pxOut, UBaseType_t uxMax)
+{
+    const TraceEvent_t *pxEvent;
+    uint32_t ulHead = ulTraceHead;
+    uint32_t ulIndex = ulTraceTail;
+    UBaseType_t uxCount = 0;
+
+    if (ulHead - ulIndex > uxMax)
+    {
+        ulIndex = ulHead - (uint32_t) uxMax;
+    }
+
+    for (; ulIndex != ulHead; ulIndex++)
+    {
+        pxEvent = &xTraceRing[ulIndex & TRACE_RING_MASK];
+        if (pxEvent->ucType != TRACE_EVENT_NONE)
+        {
+            memcpy(&pxOut[uxCount++], pxEvent, sizeof(*pxEvent));
+        }
+    }
+
+    return uxCount;
+}
+
+BaseType_t xTraceRecorderStart(UBaseType_t uxPriority)
+{
+    return xAppTaskCreate(xStreamTask, prvTraceStreamTask, "TraceStream", TRACE_STREAM_STACK_SIZE,
+                          NULL, uxPriority, &xStreamTask);
+}
+
+/* Move up to uxMax committed records from the ring to pxOut, or drop them if
+ * pxOut is NULL; stops at ulUntil or at a record not committed yet */
+static UBaseType_t prvRingTake(TraceEvent_t *pxOut, UBaseType_t uxMax, uint32_t ulUntil)
+{
+    TraceEvent_t *pxEvent;
+    uint32_t ulTail = ulTraceTail;
+    UBaseType_t uxCount = 0;
+
+    while (uxCount < uxMax && ulTail != ulUntil)
+    {
+        pxEvent = &xTraceRing[ulTail & TRACE_RING_MASK];
+        if (pxEvent->ucType == TRACE_EVENT_NONE)
+        {
+            break;
+        }
+        __DMB();
+
+        if (pxOut != NULL)
+        {
+            memcpy(&pxOut[uxCount], pxEvent, sizeof(*pxEvent));
+        }
+        uxCount++;
+
+        /* Free the slot before the producers can see it as such */
+        pxEvent->ucType = TRACE_EVENT_NONE;
+        __DMB();
+        ulTail++;
+        ulTraceTail = ulTail;
+    }
+
+    return uxCount;
+}
+
+static TraceStreamHeader_t *prvPacketHeader(uint16_t usKind, uint16_t usCount)
+{
+    TraceStreamHeader_t *pxHeader = (TraceStreamHeader_t *) ulStreamPacket;
+
+    pxHeader->ulMagic = TRACE_STREAM_MAGIC;
+    pxHeader->usKind = usKind;
+    pxHeader->usCount = usCount;
+    pxHeader->ulSequence = ulStreamSequence++;
+    pxHeader->ulDropped = ulTraceDropped;
+    pxHeader->ullCycles = ullRunTimeStatsGetCycles();
+    pxHeader->ulCpuHz = SystemCoreClock;
+
+    return pxHeader;
+}
+
+static size_t prvBuildTaskList(void)
+{
+    TraceTaskEntry_t *pxEntries = (TraceTaskEntry_t *) ((uint8_t *) ulStreamPacket + sizeof(TraceStreamHeader_t));
+    UBaseType_t uxCount;
+    UBaseType_t i;
+
+    /* Returns 0 when there are more tasks than entries */
+    uxCount = uxTaskGetSystemState(xStreamTasks, TRACE_STREAM_MAX_TASKS, NULL);
+
+    for (i = 0; i < uxCount; i++)
+    {
+        pxEntries[i].usNumber = (uint16_t) xStreamTasks[i].xTaskNumber;
+        pxEntries[i].ucPriority = (uint8_t) xStreamTasks[i].uxCurrentPriority;
+        pxEntries[i].ucState = (uint8_t) xStreamTasks[i].eCurrentState;
+        strncpy(pxEntries[i].cName, xStreamTasks[i].pcTaskName, sizeof(pxEntries[i].cName));
+    }
+
+    (void) prvPacketHeader(TRACE_STREAM_TASKS, (uint16_t) uxCount);
+
+    return sizeof(TraceStreamHeader_t) + uxCount * sizeof(TraceTaskEntry_t);
+}
+
+static void prvTraceStreamTask(void *pvParameters)
+{
+    TraceEvent_t *pxEvents = (TraceEvent_t *) ((uint8_t *) ulStreamPacket + sizeof(TraceStreamHeader_t));
+    Socket *pxSocket = NULL;
+    TickType_t xLastTasks = 0;
+    UBaseType_t uxCount;
+    IpAddr xHost;
+    size_t xLength;
+
+    (void) pvParameters;
+
+    for (;;)
+    {
+        /* Poll while the trace runs or the ring holds records */
+        (void) ulTaskNotifyTake(pdTRUE, (ulTraceRunning != 0 || ulTraceTail != ulTraceHead)
+                                        ? pdMS_TO_TICKS(TRACE_STREAM_PERIOD_MS) : portMAX_DELAY);
+
+        if (ulTraceClearPending != 0)
+        {
+            ulTraceClearPending = 0;
+            while (prvRingTake(NULL, TRACE_RECORDER_EVENTS, ulTraceClearUntil) > 0)
+            {
+            }
+            xLastTasks = 0;
+        }
+
+        /* No host: the ring is a flight recorder, the oldest records are
+         * discarded so that the latest remain for a crash dump */
+        if (xTraceRecorderHasHost() == pdFALSE)
+        {
+            if (ulTraceHead - ulTraceTail > TRACE_RECORDER_EVENTS / 2u)
+            {
+                (void) prvRingTake(NULL, (ulTraceHead - ulTraceTail) - TRACE_RECORDER_EVENTS / 2u, ulTraceHead);
+            }
+            continue;
+        }
+
+        if (pxSocket == NULL)
+        {
+            pxSocket = socketOpen(SOCKET_TYPE_DGRAM, SOCKET_IP_PROTO_UDP);
+            if (pxSocket == NULL)
+            {
+                continue;
+            }
+        }
+
+        taskENTER_CRITICAL();
+        xHost = xTraceHost;
+        taskEXIT_CRITICAL();
+
+        /* The task list names the task numbers of the switch events */
+        if (ulTraceRunning != 0 &&
+            (xLastTasks == 0 || (xTaskGetTickCount() - xLastTasks) >= pdMS_TO_TICKS(TRACE_STREAM_TASKS_PERIOD_MS)))
+        {
+            xLastTasks = xTaskGetTickCount();
+            xLength = prvBuildTaskList();
+            socketSendTo(pxSocket, &xHost, usTracePort, ulStreamPacket, xLength, NULL, 0);
+        }
+
+        do
+        {
+            uxCount = prvRingTake(pxEvents, TRACE_STREAM_MAX_EVENTS, ulTraceHead);
+            if (uxCount > 0)
+            {
+                (void) prvPacketHeader(TRACE_STREAM_EVENTS, (uint16_t) uxCount);
+                socketSendTo(pxSocket, &xHost, usTracePort, ulStreamPacket,
+                             sizeof(TraceStreamHeader_t) + uxCount * sizeof(TraceEvent_t), NULL, 0);
+            }
+        } while (uxCount == TRACE_STREAM_MAX_EVENTS);
+    }
+}
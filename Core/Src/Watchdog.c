@@ -0,0 +1,284 @@
+/* Watchdog.c
+ *
+ * Task supervision on IWDG1 (see Watchdog.h). The IWDG is driven through
+ * its registers: it has four of them and no HAL module is built. A kick
+ * takes no lock: the table only grows, and each entry is written by its
+ * own task, the supervisor only reading it.
+ */
+#include "Watchdog.h"
+#include "CrashDump.h"
+#include "StaticAlloc.h"
+#include "FreeRTOS_CLI.h"
+#include "stm32h7xx.h"
+#include "debug.h"
+#include <stdio.h>
+
+/* Keys of IWDG_KR */
+#define WATCHDOG_KEY_START             0xCCCCu
+#define WATCHDOG_KEY_ACCESS            0x5555u
+#define WATCHDOG_KEY_RELOAD            0xAAAAu
+
+/* LSI at 32 kHz divided by 64: a count every 2 ms */
+#define WATCHDOG_PRESCALER             4u
+#define WATCHDOG_COUNT_MS              2u
+#define WATCHDOG_RELOAD                (WATCHDOG_TIMEOUT_MS / WATCHDOG_COUNT_MS)
+
+#if (WATCHDOG_RELOAD > 0xFFFu)
+#error WATCHDOG_TIMEOUT_MS exceeds the reload register
+#endif
+
+typedef struct
+{
+    TaskHandle_t xTask;
+    TickType_t xDeadline;
+    volatile TickType_t xLastKick;
+    volatile TickType_t xWorstGap;  /* Longest time between two kicks */
+    volatile uint32_t ulKicks;
+} WatchdogTask_t;
+
+static WatchdogTask_t xTasks[WATCHDOG_MAX_TASKS];
+static volatile UBaseType_t uxTaskCount = 0;
+
+static TaskHandle_t xSupervisorTask = NULL;
+APP_TASK_STORAGE(xSupervisorTask, WATCHDOG_STACK_SIZE);
+
+static volatile uint32_t ulFeeds = 0;
+static volatile BaseType_t xReporting = pdFALSE;
+
+static UBaseType_t uxWatchdogLine = 0;
+
+static BaseType_t prvWatchdogCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xWatchdog =
+{
+    "watchdog",
+    "\r\nwatchdog:\r\n Heartbeats of the supervised tasks and state of the IWDG\r\n",
+    prvWatchdogCommand,
+    0
+};
+
+static void prvIwdgStart(void)
+{
+    uint32_t ulSpins = 0;
+
+    /* Counting stops while a debugger halts the core */
+    DBGMCU->APB4FZ1 |= DBGMCU_APB4FZ1_DBG_IWDG1;
+
+    IWDG1->KR = WATCHDOG_KEY_START;
+    IWDG1->KR = WATCHDOG_KEY_ACCESS;
+    IWDG1->PR = WATCHDOG_PRESCALER;
+    IWDG1->RLR = WATCHDOG_RELOAD;
+
+    /* The registers cross to the LSI domain in a few LSI cycles */
+    while (IWDG1->SR != 0 && ulSpins++ < 100000u)
+    {
+    }
+
+    IWDG1->KR = WATCHDOG_KEY_RELOAD;
+}
+
+/* Time since the last kick of a started task, 0 before its first kick */
+static TickType_t prvAge(const WatchdogTask_t *pxEntry, TickType_t xNow)
+{
+    if (pxEntry->ulKicks == 0)
+    {
+        return 0;
+    }
+
+    return xNow - pxEntry->xLastKick;
+}
+
+/* Most overdue task, NULL if all are within their deadline */
+static WatchdogTask_t *prvFindLate(TickType_t xNow, TickType_t *pxOverdue)
+{
+    WatchdogTask_t *pxLate = NULL;
+    TickType_t xAge;
+    UBaseType_t i;
+
+    *pxOverdue = 0;
+    for (i = 0; i < uxTaskCount; i++)
+    {
+        xAge = prvAge(&xTasks[i], xNow);
+        if (xAge > xTasks[i].xDeadline && xAge - xTasks[i].xDeadline > *pxOverdue)
+        {
+            *pxOverdue = xAge - xTasks[i].xDeadline;
+            pxLate = &xTasks[i];
+        }
+    }
+
+    return pxLate;
+}
+
+static void prvReport(const WatchdogTask_t *pxLate, TickType_t xNow)
+{
+    const WatchdogTask_t *pxEntry;
+    UBaseType_t i;
+
+    TRACE_ERROR("Watchdog: %s missed its %lu ms deadline, reset in %lu ms\r\n",
+                pcTaskGetName(pxLate->xTask), (unsigned long) (pxLate->xDeadline * portTICK_PERIOD_MS),
+                (unsigned long) WATCHDOG_REPORT_MS);
+
+    for (i = 0; i < uxTaskCount; i++)
+    {
+        pxEntry = &xTasks[i];
+        TRACE_ERROR("Watchdog: %-12s deadline %5lu ms, last kick %5lu ms ago, worst gap %5lu ms, %lu kicks\r\n",
+                    pcTaskGetName(pxEntry->xTask), (unsigned long) (pxEntry->xDeadline * portTICK_PERIOD_MS),
+                    (unsigned long) (prvAge(pxEntry, xNow) * portTICK_PERIOD_MS),
+                    (unsigned long) (pxEntry->xWorstGap * portTICK_PERIOD_MS),
+                    (unsigned long) pxEntry->ulKicks);
+    }
+}
+
+static void prvSupervisorTask(void *pvParameters)
+{
+    WatchdogTask_t *pxLate;
+    WatchdogTask_t *pxReported = NULL;
+    TickType_t xReportedOverdue = 0;
+    TickType_t xLastWake;
+    TickType_t xReportTime = 0;
+    TickType_t xOverdue;
+    TickType_t xNow;
+
+    (void) pvParameters;
+
+    prvIwdgStart();
+    xLastWake = xTaskGetTickCount();
+
+    for (;;)
+    {
+        vTaskDelayUntil(&xLastWake, pdMS_TO_TICKS(WATCHDOG_PERIOD_MS));
+        xNow = xTaskGetTickCount();
+
+        pxLate = prvFindLate(xNow, &xOverdue);
+
+        if (xReporting == pdFALSE)
+        {
+            if (pxLate == NULL)
+            {
+                IWDG1->KR = WATCHDOG_KEY_RELOAD;
+                ulFeeds++;
+                continue;
+            }
+
+            /* No more feeds from here: a reset follows in any case */
+            xReporting = pdTRUE;
+            xReportTime = xNow;
+            pxReported = pxLate;
+            xReportedOverdue = xOverdue;
+            prvReport(pxLate, xNow);
+        }
+        else if (xNow - xReportTime >= pdMS_TO_TICKS(WATCHDOG_REPORT_MS))
+        {
+            /* The task may have come back meanwhile: the dump is then of
+             * the one reported, as it is now */
+            if (pxLate == NULL)
+            {
+                pxLate = pxReported;
+                xOverdue = xReportedOverdue;
+            }
+            vCrashDumpTaskStall(pxLate->xTask, (uint32_t) (xOverdue * portTICK_PERIOD_MS));
+        }
+    }
+}
+
+BaseType_t xWatchdogStart(UBaseType_t uxPriority)
+{
+    return xAppTaskCreate(xSupervisorTask, prvSupervisorTask, "Watchdog", WATCHDOG_STACK_SIZE,
+                          NULL, uxPriority, &xSupervisorTask);
+}
+
+BaseType_t xWatchdogRegister(TaskHandle_t xTask, uint32_t ulDeadlineMs)
+{
+    BaseType_t xResult = pdFAIL;
+    UBaseType_t i;
+
+    if (xTask == NULL)
+    {
+        xTask = xTaskGetCurrentTaskHandle();
+    }
+
+    taskENTER_CRITICAL();
+    for (i = 0; i < uxTaskCount && xTasks[i].xTask != xTask; i++)
+    {
+    }
+    if (i < WATCHDOG_MAX_TASKS)
+    {
+        xTasks[i].xDeadline = pdMS_TO_TICKS(ulDeadlineMs);
+        if (i == uxTaskCount)
+        {
+            xTasks[i].xTask = xTask;
+            xTasks[i].xLastKick = 0;
+            xTasks[i].xWorstGap = 0;
+            xTasks[i].ulKicks = 0;
+            uxTaskCount = i + 1;
+        }
+        xResult = pdPASS;
+    }
+    taskEXIT_CRITICAL();
+
+    return xResult;
+}
+
+void vWatchdogKick(void)
+{
+    TaskHandle_t xSelf = xTaskGetCurrentTaskHandle();
+    TickType_t xNow = xTaskGetTickCount();
+    WatchdogTask_t *pxEntry;
+    UBaseType_t uxCount = uxTaskCount;
+    UBaseType_t i;
+
+    for (i = 0; i < uxCount; i++)
+    {
+        pxEntry = &xTasks[i];
+        if (pxEntry->xTask == xSelf)
+        {
+            if (pxEntry->ulKicks != 0 && xNow - pxEntry->xLastKick > pxEntry->xWorstGap)
+            {
+                pxEntry->xWorstGap = xNow - pxEntry->xLastKick;
+            }
+            /* The time first: the supervisor takes the count as the sign
+             * that it is valid */
+            pxEntry->xLastKick = xNow;
+            pxEntry->ulKicks++;
+            return;
+        }
+    }
+}
+
+void vWatchdogRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xWatchdog);
+}
+
+static BaseType_t prvWatchdogCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    const WatchdogTask_t *pxEntry;
+    UBaseType_t uxCount = uxTaskCount;
+    TickType_t xNow = xTaskGetTickCount();
+
+    (void) pcCommandString;
+
+    if (uxWatchdogLine == 0)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen,
+                 "\r\nIWDG %lu ms, %lu feeds%s\r\nTask          Deadline  Last kick  Worst gap      Kicks\r\n",
+                 (unsigned long) WATCHDOG_TIMEOUT_MS, (unsigned long) ulFeeds,
+                 (xReporting == pdTRUE) ? ", reset pending" : "");
+        uxWatchdogLine = (uxCount > 0) ? 1 : 0;
+        return (uxCount > 0) ? pdTRUE : pdFALSE;
+    }
+
+    pxEntry = &xTasks[uxWatchdogLine - 1];
+    snprintf(pcWriteBuffer, xWriteBufferLen, "%-12s %6lu ms  %6lu ms  %6lu ms %10lu\r\n",
+             pcTaskGetName(pxEntry->xTask), (unsigned long) (pxEntry->xDeadline * portTICK_PERIOD_MS),
+             (unsigned long) (prvAge(pxEntry, xNow) * portTICK_PERIOD_MS),
+             (unsigned long) (pxEntry->xWorstGap * portTICK_PERIOD_MS), (unsigned long) pxEntry->ulKicks);
+
+    if (uxWatchdogLine++ >= uxCount)
+    {
+        uxWatchdogLine = 0;
+        return pdFALSE;
+    }
+
+    return pdTRUE;
+}
@@ -0,0 +1,90 @@
+/* WebAssets.c
+ *
+ * Web UI served by the HTTP server, gzip-compressed. Generated by
+ * Tools/pack_webui.py from Tools/webui: do not edit.
+ */
+#include "WebAssets.h"
+
+static const uint8_t ucAsset_app_js[508] =
+{
+    0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x6D, 0x53, 0xC1, 0x6E, 0xDB, 0x30,
+    0x0C, 0xBD, 0xE7, 0x2B, 0x08, 0x9D, 0x24, 0xC4, 0x55, 0x9C, 0x0C, 0x18, 0x82, 0x06, 0x3D, 0x6C,
+    0xC3, 0x0E, 0x05, 0xBA, 0x53, 0x3A, 0xEC, 0x2C, 0x3B, 0x4C, 0xEC, 0xCE, 0x96, 0x02, 0x89, 0x4E,
+    0x6A, 0x0C, 0xF9, 0xF7, 0x49, 0x96, 0xE3, 0x3A, 0x6E, 0x74, 0x30, 0x6C, 0xFA, 0xF1, 0xF1, 0xF1,
+    0x89, 0x5C, 0x2C, 0xE0, 0xA5, 0x3C, 0x21, 0x10, 0x56, 0x58, 0x23, 0xD9, 0x16, 0xF6, 0xD6, 0xD4,
+    0x40, 0x05, 0xC2, 0x1F, 0xCC, 0xB6, 0x26, 0xFF, 0x8B, 0x04, 0x0E, 0xED, 0x09, 0x2D, 0xF0, 0x21,
+    0xB2, 0xED, 0x02, 0xB2, 0x10, 0x33, 0xBE, 0x6F, 0x74, 0x4E, 0xA5, 0xD1, 0xC0, 0x05, 0xFC, 0x9B,
+    0x81, 0x3F, 0x27, 0x65, 0x3D, 0x89, 0xAA, 0xD1, 0xC1, 0x13, 0xA4, 0x9B, 0x21, 0x96, 0x9B, 0x46,
+    0x13, 0xEE, 0x62, 0xB0, 0x8B, 0x0E, 0xB9, 0xAE, 0x30, 0x67, 0x5E, 0xEE, 0x12, 0x2F, 0xE3, 0x9D,
+    0xAE, 0x3C, 0xE1, 0xEC, 0x4C, 0xDE, 0xD4, 0xA8, 0x49, 0x1E, 0x90, 0x7E, 0x06, 0x85, 0x9A, 0xBE,
+    0xB7, 0xCF, 0x3B, 0x8F, 0x15, 0x32, 0x60, 0x7F, 0x18, 0x4F, 0xA9, 0xC9, 0x73, 0x86, 0xAF, 0x58,
+    0xEB, 0x32, 0x21, 0x2F, 0xF0, 0x9D, 0x67, 0xCD, 0x7E, 0x8F, 0x76, 0xCC, 0x1C, 0x14, 0x65, 0x2D,
+    0x75, 0x22, 0x35, 0x9E, 0xE1, 0x77, 0xA9, 0x69, 0xFD, 0xCD, 0x5A, 0xD5, 0xF6, 0xE0, 0x04, 0xD2,
+    0x04, 0x7E, 0x29, 0x2A, 0x64, 0x5D, 0xEA, 0x3E, 0x26, 0x43, 0xC6, 0x0B, 0xEA, 0x03, 0x15, 0x09,
+    0x7C, 0x59, 0x09, 0xB1, 0x19, 0xF8, 0x2C, 0x52, 0x63, 0x35, 0x74, 0x0C, 0xF2, 0x68, 0x0D, 0x19,
+    0x6A, 0x8F, 0x28, 0x6B, 0x75, 0x94, 0xB9, 0xAA, 0x2A, 0xDE, 0xD5, 0x4A, 0x3E, 0x54, 0xF1, 0x6C,
+    0xAC, 0x66, 0xC4, 0xC0, 0x59, 0xCA, 0x60, 0x0E, 0x99, 0x24, 0xB3, 0x25, 0x5B, 0xEA, 0x03, 0x5F,
+    0x7E, 0x15, 0x42, 0xBA, 0xAA, 0xCC, 0x91, 0x3F, 0xAC, 0x46, 0x25, 0x2F, 0x42, 0xBE, 0x19, 0xAF,
+    0x8D, 0x01, 0x13, 0xF7, 0x5B, 0xCF, 0x8D, 0xD6, 0x98, 0x13, 0x9F, 0x36, 0x7E, 0xBE, 0x76, 0x3D,
+    0xDC, 0x28, 0x67, 0x67, 0xF7, 0xB8, 0x58, 0x84, 0xCA, 0x95, 0xC9, 0x55, 0xC8, 0x96, 0x85, 0x71,
+    0xA4, 0xFD, 0x3D, 0xFA, 0x18, 0x7B, 0x5C, 0xA7, 0xEB, 0xE5, 0x62, 0x98, 0x12, 0x36, 0x92, 0x71,
+    0x76, 0x32, 0x2B, 0xB5, 0xB2, 0xED, 0xAB, 0x6F, 0xD8, 0xF3, 0x32, 0x15, 0x3C, 0x88, 0x86, 0xB1,
+    0x1B, 0x98, 0xD1, 0xE6, 0x88, 0xDA, 0x43, 0x6E, 0x86, 0x26, 0xDE, 0x3E, 0x73, 0xA4, 0x08, 0x59,
+    0x02, 0x2C, 0x60, 0x3C, 0x3F, 0x5C, 0x26, 0xB9, 0x79, 0x65, 0x1C, 0x4E, 0x93, 0x6F, 0x1C, 0x9C,
+    0x10, 0x75, 0x09, 0x7E, 0xA8, 0x6C, 0x50, 0xEC, 0x8D, 0x1C, 0x8B, 0xEE, 0xE0, 0x48, 0xAF, 0x65,
+    0x8D, 0xA6, 0x21, 0xDE, 0x1B, 0x95, 0xC0, 0x2A, 0x4D, 0xD3, 0xB1, 0xC5, 0x13, 0x0D, 0x7E, 0xA8,
+    0x9D, 0x3A, 0xDC, 0xAA, 0xC0, 0x93, 0x9F, 0xC0, 0xA9, 0x94, 0xB8, 0x00, 0xF3, 0xF9, 0xE6, 0x8E,
+    0xC0, 0xF8, 0xCF, 0x2B, 0x8C, 0x2F, 0xE2, 0x1E, 0xA6, 0x52, 0x8E, 0x3C, 0x22, 0xCC, 0x6E, 0xC7,
+    0x2F, 0x77, 0x8A, 0x94, 0xF8, 0xAC, 0xAC, 0xBF, 0x71, 0xDF, 0xCA, 0xB3, 0xDF, 0x04, 0x7B, 0x52,
+    0x15, 0xBF, 0xEF, 0x4F, 0xA4, 0xB5, 0xD1, 0x9A, 0x7E, 0x3D, 0x1F, 0xAE, 0x3B, 0x39, 0xE2, 0xFD,
+    0xD8, 0xD2, 0x08, 0xEA, 0xCB, 0x24, 0xB0, 0x8C, 0xCE, 0xCC, 0x22, 0xA8, 0x9F, 0xAB, 0xCD, 0xEC,
+    0x22, 0xC2, 0xF3, 0x3F, 0x55, 0xB1, 0x31, 0x36, 0x47, 0x04, 0x00, 0x00,
+};
+
+static const uint8_t ucAsset_index_html[305] =
+{
+    0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x75, 0x51, 0x3B, 0x4F, 0x03, 0x31,
+    0x0C, 0xDE, 0xFB, 0x2B, 0x42, 0x66, 0xDA, 0xA3, 0x30, 0xC0, 0x70, 0xC9, 0xC2, 0x43, 0x0C, 0x48,
+    0x30, 0x74, 0x61, 0x74, 0x13, 0xB7, 0x49, 0xC9, 0xA5, 0xA7, 0xD8, 0x6D, 0xD5, 0x7F, 0x8F, 0x73,
+    0x6D, 0x05, 0x27, 0xC1, 0x12, 0x2B, 0x9F, 0xBF, 0x87, 0x9D, 0xB4, 0x57, 0x4F, 0xEF, 0x8F, 0x8B,
+    0xCF, 0x8F, 0x67, 0x15, 0xB8, 0x4B, 0x76, 0xD2, 0xD6, 0xA2, 0x12, 0xE4, 0xB5, 0xD1, 0x98, 0x75,
+    0x05, 0x10, 0xBC, 0x94, 0x0E, 0x19, 0x94, 0x0B, 0x50, 0x08, 0xD9, 0xE8, 0x1D, 0xAF, 0xA6, 0x0F,
+    0xFA, 0x02, 0x67, 0xE8, 0xD0, 0xE8, 0x7D, 0xC4, 0x43, 0xBF, 0x2D, 0xAC, 0x95, 0xDB, 0x66, 0xC6,
+    0x2C, 0xB4, 0x43, 0xF4, 0x1C, 0x8C, 0xC7, 0x7D, 0x74, 0x38, 0x1D, 0x2E, 0xD7, 0x2A, 0xE6, 0xC8,
+    0x11, 0xD2, 0x94, 0x1C, 0x24, 0x34, 0xF3, 0x6A, 0xC2, 0x91, 0x13, 0xDA, 0xD7, 0xFB, 0xDB, 0x3B,
+    0x45, 0x0C, 0xBC, 0xA3, 0xB6, 0x39, 0x41, 0x93, 0x36, 0xC5, 0xFC, 0xA5, 0x0A, 0x26, 0xA3, 0x89,
+    0x8F, 0x09, 0x29, 0x20, 0x4A, 0x40, 0x28, 0xB8, 0x32, 0xBA, 0x19, 0xA0, 0x99, 0x23, 0xAA, 0x26,
+    0xCD, 0x79, 0xD0, 0xE5, 0xD6, 0x1F, 0xEB, 0xD8, 0xF3, 0xB1, 0xA1, 0xDC, 0x25, 0x08, 0x96, 0x83,
+    0x2B, 0x17, 0xDB, 0x72, 0xB0, 0x0B, 0x4C, 0x28, 0x0B, 0x94, 0xA3, 0xB0, 0x0A, 0x42, 0x27, 0xB1,
+    0x41, 0x1A, 0x5E, 0x45, 0x5F, 0xF3, 0x80, 0x51, 0x5B, 0xD9, 0x25, 0xA3, 0xE3, 0x98, 0xD7, 0xD2,
+    0xF5, 0x56, 0x8E, 0xF2, 0x63, 0xF0, 0x52, 0x64, 0x73, 0x92, 0xF9, 0x1C, 0xC6, 0x3D, 0xFA, 0x91,
+    0x7E, 0x35, 0xF4, 0xB4, 0xBD, 0xF9, 0x5F, 0xD7, 0x63, 0x51, 0x84, 0x92, 0x30, 0x56, 0x96, 0x21,
+    0xF8, 0x2F, 0xDD, 0x1B, 0x10, 0xAB, 0xC1, 0x78, 0x24, 0x48, 0x02, 0x6B, 0xFB, 0x9B, 0xDF, 0x5C,
+    0x36, 0x25, 0x57, 0x62, 0xCF, 0x8A, 0x8A, 0x93, 0xF7, 0x82, 0xBE, 0x9F, 0x6D, 0xA8, 0x32, 0x4F,
+    0x70, 0x25, 0x9E, 0x9F, 0xAB, 0x39, 0x7D, 0xFF, 0x37, 0xD4, 0xCB, 0x7D, 0xC5, 0x0F, 0x02, 0x00,
+    0x00,
+};
+
+static const uint8_t ucAsset_style_css[164] =
+{
+    0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x5D, 0x8E, 0xC1, 0x0E, 0xC2, 0x20,
+    0x10, 0x44, 0xEF, 0x7E, 0xC5, 0x26, 0x5E, 0xC5, 0x58, 0xBC, 0xC1, 0xD7, 0x6C, 0xBB, 0x4B, 0x25,
+    0x01, 0x96, 0xC0, 0x1E, 0xDA, 0x18, 0xFF, 0x5D, 0x6C, 0xF4, 0xE2, 0x6D, 0x92, 0x99, 0x37, 0x33,
+    0xB3, 0xD0, 0x0E, 0x4F, 0x08, 0x52, 0xD4, 0x04, 0xCC, 0x31, 0xED, 0x0E, 0x3A, 0x96, 0x6E, 0x3A,
+    0xB7, 0x18, 0x3C, 0x64, 0x6C, 0x6B, 0x2C, 0x0E, 0x2C, 0x67, 0x0F, 0x8B, 0x24, 0x69, 0x0E, 0xCE,
+    0xD6, 0x5A, 0x0F, 0xAF, 0x93, 0xE2, 0x9C, 0x78, 0xC0, 0xB3, 0x34, 0xE2, 0x66, 0x86, 0x9B, 0xB0,
+    0x76, 0x76, 0xF0, 0x53, 0x47, 0xE8, 0x71, 0x01, 0xA5, 0x91, 0xAA, 0x48, 0x14, 0xCB, 0xEA, 0xE0,
+    0x76, 0xBD, 0x73, 0x86, 0xE9, 0x53, 0xF8, 0x25, 0x67, 0x51, 0x95, 0xEC, 0x60, 0xAA, 0x1B, 0x74,
+    0x49, 0x91, 0xE0, 0x4C, 0x44, 0x1E, 0x94, 0x37, 0x35, 0x98, 0xE2, 0x3A, 0x0E, 0x24, 0x0E, 0x7A,
+    0xF4, 0xD1, 0xFF, 0xDD, 0x2C, 0x45, 0x7A, 0xC5, 0xE5, 0x98, 0x7B, 0x03, 0x8A, 0x89, 0xCA, 0x7A,
+    0xD0, 0x00, 0x00, 0x00,
+};
+
+const HttpAsset_t xWebAssets[] =
+{
+    { "/app.js", "application/javascript", "max-age=3600", "\"5fb485b93089f6e5\"", ucAsset_app_js, sizeof(ucAsset_app_js) },
+    { "/index.html", "text/html; charset=utf-8", "no-cache", "\"84615fe475ce474c\"", ucAsset_index_html, sizeof(ucAsset_index_html) },
+    { "/style.css", "text/css", "max-age=3600", "\"3aa9eea00b610f80\"", ucAsset_style_css, sizeof(ucAsset_style_css) },
+};
+
+const size_t xWebAssetCount = sizeof(xWebAssets) / sizeof(xWebAssets[0]);
@@ -0,0 +1,907 @@
+/* WebSocketServer.c
+ *
+ * Opening handshake, framing, frame ring and client queues of the WebSocket
+ * server (see WebSocketServer.h). The ring is shared with the publishers
+ * under xRingMutex; the clients belong to the server task.
+ */
+#include "WebSocketServer.h"
+#include "StaticAlloc.h"
+#include "task.h"
+#include "semphr.h"
+#include "FreeRTOS_CLI.h"
+#include "core/net.h"
+#include "core/socket.h"
+#include "web_socket/web_socket.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Longest header of a frame sent: WS_SERVER_MAX_PAYLOAD takes a 16-bit length */
+#define WS_FRAME_HEADER_SIZE           4u
+#define WS_MAX_CONTROL_PAYLOAD         125u
+#define WS_FIN                         0x80u
+#define WS_MASK                        0x80u
+
+#define WS_GUID                        "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WS_SHA1_SIZE                   20u
+
+typedef enum
+{
+    eWsFree = 0,
+    eWsHandshake,                   /* Waiting for the opening handshake */
+    eWsOpen,
+    eWsClosing                      /* Sending the last frame, then closed */
+} WsState_t;
+
+typedef struct
+{
+    uint16_t usLength;              /* Header included */
+    uint8_t ucFrame[WS_FRAME_HEADER_SIZE + WS_SERVER_MAX_PAYLOAD];
+} WsRingFrame_t;
+
+typedef struct
+{
+    WsState_t eState;
+    Socket *pxSocket;
+    IpAddr xPeer;
+    uint16_t usPeerPort;
+    systime_t xLastRx;
+    systime_t xLastPing;
+    uint32_t ulNext;                /* Sequence number of the next frame to send */
+    uint32_t ulSent;
+    uint32_t ulDropped;
+    size_t xTxLength;               /* Of the frame being sent */
+    size_t xTxOffset;
+    uint8_t ucTx[WS_FRAME_HEADER_SIZE + WS_SERVER_MAX_PAYLOAD];
+    size_t xControlLength;          /* Pong waiting for the frame being sent */
+    uint8_t ucControl[2u + WS_MAX_CONTROL_PAYLOAD];
+    size_t xRxUsed;
+    uint8_t ucRx[WS_SERVER_RX_SIZE + 1u];
+} WsClient_t;
+
+/* Shared under xRingMutex */
+static WsRingFrame_t xRing[WS_SERVER_RING_FRAMES];
+static uint32_t ulPublished = 0;
+static WebSocketServerStats_t xStats;
+static SemaphoreHandle_t xRingMutex = NULL;
+static OsEvent xWsEvent;
+static volatile UBaseType_t uxOpen = 0;
+
+/* Owned by the server task */
+static WsClient_t xClients[WS_SERVER_MAX_CLIENTS];
+
+APP_TASK_STORAGE(xWebSocketTask, WS_SERVER_TASK_STACK_SIZE);
+APP_MUTEX_STORAGE(xRingMutex);
+
+static BaseType_t prvWsCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString);
+
+static const CLI_Command_Definition_t xWs =
+{
+    "ws",
+    "\r\nws:\r\n WebSocket telemetry clients and counters\r\n",
+    prvWsCommand,
+    -1
+};
+
+static uint32_t prvRotl(uint32_t ulValue, uint32_t ulBits)
+{
+    return (ulValue << ulBits) | (ulValue >> (32u - ulBits));
+}
+
+/* SHA-1 (FIPS 180-4), for Sec-WebSocket-Accept only; the message is short */
+static void prvSha1(const uint8_t *pucData, size_t xLength, uint8_t *pucDigest)
+{
+    uint32_t ulH[5] = { 0x67452301u, 0xEFCDAB89u, 0x98BADCFEu, 0x10325476u, 0xC3D2E1F0u };
+    uint32_t ulW[80];
+    uint8_t ucBlock[64];
+    uint32_t a, b, c, d, e, f, k, t;
+    size_t xBlocks = (xLength + 9u + 63u) / 64u;
+    size_t xBlock;
+    size_t i;
+    size_t j;
+
+    for (xBlock = 0; xBlock < xBlocks; xBlock++)
+    {
+        /* Message, a 1 bit, zeros, then the length in bits */
+        for (i = 0; i < 64u; i++)
+        {
+            j = xBlock * 64u + i;
+            ucBlock[i] = (j < xLength) ? pucData[j] : (j == xLength) ? 0x80u : 0u;
+        }
+        if (xBlock == xBlocks - 1u)
+        {
+            for (i = 0; i < 8u; i++)
+            {
+                ucBlock[63u - i] = (uint8_t) ((uint64_t) xLength * 8u >> (8u * i));
+            }
+        }
+
+        for (i = 0; i < 16u; i++)
+        {
+            ulW[i] = ((uint32_t) ucBlock[4u * i] << 24) | ((uint32_t) ucBlock[4u * i + 1u] << 16) |
+                     ((uint32_t) ucBlock[4u * i + 2u] << 8) | ucBlock[4u * i + 3u];
+        }
+        for (i = 16u; i < 80u; i++)
+        {
+            ulW[i] = prvRotl(ulW[i - 3u] ^ ulW[i - 8u] ^ ulW[i - 14u] ^ ulW[i - 16u], 1u);
+        }
+
+        a = ulH[0];
+        b = ulH[1];
+        c = ulH[2];
+        d = ulH[3];
+        e = ulH[4];
+        for (i = 0; i < 80u; i++)
+        {
+            if (i < 20u)
+            {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999u;
+            }
+            else if (i < 40u)
+            {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1u;
+            }
+            else if (i < 60u)
+            {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDCu;
+            }
+            else
+            {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6u;
+            }
+            t = prvRotl(a, 5u) + f + e + k + ulW[i];
+            e = d;
+            d = c;
+            c = prvRotl(b, 30u);
+            b = a;
+            a = t;
+        }
+        ulH[0] += a;
+        ulH[1] += b;
+        ulH[2] += c;
+        ulH[3] += d;
+        ulH[4] += e;
+    }
+
+    for (i = 0; i < 5u; i++)
+    {
+        pucDigest[4u * i] = (uint8_t) (ulH[i] >> 24);
+        pucDigest[4u * i + 1u] = (uint8_t) (ulH[i] >> 16);
+        pucDigest[4u * i + 2u] = (uint8_t) (ulH[i] >> 8);
+        pucDigest[4u * i + 3u] = (uint8_t) ulH[i];
+    }
+}
+
+/* Base64 of a short buffer, NUL terminated */
+static void prvBase64(const uint8_t *pucData, size_t xLength, char *pcOut)
+{
+    static const char cAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    uint32_t ulGroup;
+    size_t i;
+
+    for (i = 0; i < xLength; i += 3u)
+    {
+        ulGroup = (uint32_t) pucData[i] << 16;
+        if (i + 1u < xLength)
+        {
+            ulGroup |= (uint32_t) pucData[i + 1u] << 8;
+        }
+        if (i + 2u < xLength)
+        {
+            ulGroup |= pucData[i + 2u];
+        }
+
+        *pcOut++ = cAlphabet[(ulGroup >> 18) & 0x3Fu];
+        *pcOut++ = cAlphabet[(ulGroup >> 12) & 0x3Fu];
+        *pcOut++ = (i + 1u < xLength) ? cAlphabet[(ulGroup >> 6) & 0x3Fu] : '=';
+        *pcOut++ = (i + 2u < xLength) ? cAlphabet[ulGroup & 0x3Fu] : '=';
+    }
+
+    *pcOut = '\0';
+}
+
+/* XOR with the masking key, in place. The payload is taken a 32-bit word at a
+   time once aligned, with the key rotated to the alignment offset */
+static void prvUnmask(uint8_t *pucData, size_t xLength, const uint8_t *pucKey)
+{
+    uint8_t ucKey[4];
+    uint32_t ulKey;
+    uint32_t *pulWord;
+    size_t i = 0;
+
+    while (i < xLength && ((uintptr_t) &pucData[i] & 3u) != 0)
+    {
+        pucData[i] ^= pucKey[i & 3u];
+        i++;
+    }
+
+    ucKey[0] = pucKey[i & 3u];
+    ucKey[1] = pucKey[(i + 1u) & 3u];
+    ucKey[2] = pucKey[(i + 2u) & 3u];
+    ucKey[3] = pucKey[(i + 3u) & 3u];
+    memcpy(&ulKey, ucKey, sizeof(ulKey));
+
+    for (pulWord = (uint32_t *) (void *) &pucData[i]; i + 4u <= xLength; i += 4u)
+    {
+        *pulWord++ ^= ulKey;
+    }
+
+    for (; i < xLength; i++)
+    {
+        pucData[i] ^= pucKey[i & 3u];
+    }
+}
+
+/* Server frames are not masked; returns the header length */
+static size_t prvFrameHeader(uint8_t *pucOut, uint8_t ucOpcode, size_t xLength)
+{
+    pucOut[0] = (uint8_t) (WS_FIN | ucOpcode);
+    if (xLength < 126u)
+    {
+        pucOut[1] = (uint8_t) xLength;
+        return 2u;
+    }
+
+    pucOut[1] = 126u;
+    pucOut[2] = (uint8_t) (xLength >> 8);
+    pucOut[3] = (uint8_t) (xLength & 0xFFu);
+    return 4u;
+}
+
+BaseType_t xWebSocketServerPublish(const void *pvData, size_t xLength)
+{
+    WsRingFrame_t *pxFrame;
+    size_t xHeader;
+
+    if (xRingMutex == NULL || xLength > WS_SERVER_MAX_PAYLOAD)
+    {
+        return pdFAIL;
+    }
+
+    /* Nobody to send it to */
+    if (uxOpen == 0)
+    {
+        return pdPASS;
+    }
+
+    xSemaphoreTake(xRingMutex, portMAX_DELAY);
+
+    pxFrame = &xRing[ulPublished % WS_SERVER_RING_FRAMES];
+    xHeader = prvFrameHeader(pxFrame->ucFrame, WS_FRAME_TYPE_BINARY, xLength);
+    memcpy(&pxFrame->ucFrame[xHeader], pvData, xLength);
+    pxFrame->usLength = (uint16_t) (xHeader + xLength);
+    ulPublished++;
+    xStats.ulPublished++;
+
+    xSemaphoreGive(xRingMutex);
+
+    osSetEvent(&xWsEvent);
+
+    return pdPASS;
+}
+
+UBaseType_t uxWebSocketServerClients(void)
+{
+    return uxOpen;
+}
+
+void vWebSocketServerGetStats(WebSocketServerStats_t *pxStats)
+{
+    xSemaphoreTake(xRingMutex, portMAX_DELAY);
+    *pxStats = xStats;
+    xSemaphoreGive(xRingMutex);
+}
+
+static void prvClose(WsClient_t *pxClient)
+{
+    if (pxClient->eState == eWsOpen || pxClient->eState == eWsClosing)
+    {
+        uxOpen--;
+    }
+
+    socketClose(pxClient->pxSocket);
+    pxClient->pxSocket = NULL;
+    pxClient->eState = eWsFree;
+}
+
+/* Send a close frame with this status once the frame being sent is complete */
+static void prvStartClose(WsClient_t *pxClient, uint16_t usStatus)
+{
+    size_t xHeader = prvFrameHeader(pxClient->ucControl, WS_FRAME_TYPE_CLOSE, 2u);
+
+    pxClient->ucControl[xHeader] = (uint8_t) (usStatus >> 8);
+    pxClient->ucControl[xHeader + 1u] = (uint8_t) (usStatus & 0xFFu);
+    pxClient->xControlLength = xHeader + 2u;
+    pxClient->eState = eWsClosing;
+}
+
+/* Header fields of the handshake which are needed: each line is terminated
+   in place and its value trimmed */
+typedef struct
+{
+    char *pcKey;
+    char *pcVersion;
+    char *pcUpgrade;
+    char *pcConnection;
+} WsHandshakeFields_t;
+
+static void prvParseFields(char *pcLine, WsHandshakeFields_t *pxFields)
+{
+    static const char *const pcNames[] = { "Sec-WebSocket-Key", "Sec-WebSocket-Version", "Upgrade", "Connection" };
+    char **ppcValues[] = { &pxFields->pcKey, &pxFields->pcVersion, &pxFields->pcUpgrade, &pxFields->pcConnection };
+    char *pcNext;
+    char *pcEnd;
+    char *pcValue;
+    size_t xName;
+    size_t i;
+
+    memset(pxFields, 0, sizeof(*pxFields));
+
+    for (; pcLine != NULL && *pcLine != '\0'; pcLine = pcNext)
+    {
+        pcEnd = strstr(pcLine, "\r\n");
+        if (pcEnd == NULL)
+        {
+            break;
+        }
+        *pcEnd = '\0';
+        pcNext = pcEnd + 2;
+
+        for (i = 0; i < sizeof(pcNames) / sizeof(pcNames[0]); i++)
+        {
+            xName = strlen(pcNames[i]);
+            if (osStrncasecmp(pcLine, pcNames[i], xName) == 0 && pcLine[xName] == ':')
+            {
+                pcValue = &pcLine[xName + 1u];
+                while (*pcValue == ' ' || *pcValue == '\t')
+                {
+                    pcValue++;
+                }
+                while (pcEnd > pcValue && (pcEnd[-1] == ' ' || pcEnd[-1] == '\t'))
+                {
+                    *--pcEnd = '\0';
+                }
+                *ppcValues[i] = pcValue;
+            }
+        }
+    }
+}
+
+/* pdTRUE if pcList, a comma separated header value, holds pcToken */
+static BaseType_t prvHasToken(const char *pcList, const char *pcToken)
+{
+    size_t xToken = strlen(pcToken);
+
+    while (pcList != NULL && *pcList != '\0')
+    {
+        while (*pcList == ' ' || *pcList == ',')
+        {
+            pcList++;
+        }
+        if (osStrncasecmp(pcList, pcToken, xToken) == 0 &&
+            (pcList[xToken] == '\0' || pcList[xToken] == ',' || pcList[xToken] == ' '))
+        {
+            return pdTRUE;
+        }
+        pcList = strchr(pcList, ',');
+    }
+
+    return pdFALSE;
+}
+
+/* Answer the opening handshake once the request is complete; pdFALSE if it is
+   not a WebSocket request for the telemetry stream */
+static BaseType_t prvHandshake(WsClient_t *pxClient)
+{
+    uint8_t ucKey[WEB_SOCKET_CLIENT_KEY_SIZE + sizeof(WS_GUID)];
+    uint8_t ucDigest[WS_SHA1_SIZE];
+    char cAccept[WEB_SOCKET_SERVER_KEY_SIZE + 1u];
+    char *pcRequest = (char *) pxClient->ucRx;
+    char *pcEnd;
+    WsHandshakeFields_t xFields;
+    size_t xPath = strlen(WS_SERVER_PATH);
+
+    pxClient->ucRx[pxClient->xRxUsed] = '\0';
+    pcEnd = strstr(pcRequest, "\r\n\r\n");
+    if (pcEnd == NULL)
+    {
+        /* Incomplete, unless the buffer is full */
+        return (pxClient->xRxUsed < WS_SERVER_RX_SIZE) ? pdTRUE : pdFALSE;
+    }
+    pcEnd[2] = '\0';
+
+    if (strncmp(pcRequest, "GET ", 4) != 0 || strncmp(&pcRequest[4], WS_SERVER_PATH, xPath) != 0 ||
+        (pcRequest[4u + xPath] != ' ' && pcRequest[4u + xPath] != '?'))
+    {
+        return pdFALSE;
+    }
+
+    prvParseFields(strstr(pcRequest, "\r\n") + 2, &xFields);
+
+    if (xFields.pcKey == NULL || strlen(xFields.pcKey) != WEB_SOCKET_CLIENT_KEY_SIZE || xFields.pcVersion == NULL ||
+        strcmp(xFields.pcVersion, "13") != 0 || prvHasToken(xFields.pcUpgrade, "websocket") == pdFALSE ||
+        prvHasToken(xFields.pcConnection, "Upgrade") == pdFALSE)
+    {
+        return pdFALSE;
+    }
+
+    memcpy(ucKey, xFields.pcKey, WEB_SOCKET_CLIENT_KEY_SIZE);
+    memcpy(&ucKey[WEB_SOCKET_CLIENT_KEY_SIZE], WS_GUID, sizeof(WS_GUID) - 1u);
+    prvSha1(ucKey, WEB_SOCKET_CLIENT_KEY_SIZE + sizeof(WS_GUID) - 1u, ucDigest);
+    prvBase64(ucDigest, sizeof(ucDigest), cAccept);
+
+    pxClient->xTxLength = (size_t) snprintf((char *) pxClient->ucTx, sizeof(pxClient->ucTx),
+                                            "HTTP/1.1 101 Switching Protocols\r\n"
+                                            "Upgrade: websocket\r\n"
+                                            "Connection: Upgrade\r\n"
+                                            "Sec-WebSocket-Accept: %s\r\n\r\n", cAccept);
+    pxClient->xTxOffset = 0;
+    pxClient->xRxUsed = 0;
+    pxClient->xLastPing = osGetSystemTime();
+    pxClient->eState = eWsOpen;
+
+    /* Start with the next frame published */
+    xSemaphoreTake(xRingMutex, portMAX_DELAY);
+    pxClient->ulNext = ulPublished;
+    xStats.ulAccepted++;
+    xSemaphoreGive(xRingMutex);
+    uxOpen++;
+
+    return pdTRUE;
+}
+
+/* Handle the complete frames received; pdFALSE on a protocol error */
+static BaseType_t prvProcessFrames(WsClient_t *pxClient)
+{
+    uint8_t *pucFrame = pxClient->ucRx;
+    uint8_t *pucPayload;
+    size_t xOffset = 0;
+    size_t xHeader;
+    size_t xLength;
+    uint8_t ucOpcode;
+
+    while (pxClient->xRxUsed - xOffset >= 2u)
+    {
+        pucFrame = &pxClient->ucRx[xOffset];
+        ucOpcode = pucFrame[0] & 0x0Fu;
+        xLength = pucFrame[1] & 0x7Fu;
+        xHeader = 2u;
+
+        /* Frames from a client are masked (RFC 6455, 5.1) */
+        if ((pucFrame[1] & WS_MASK) == 0)
+        {
+            prvStartClose(pxClient, WS_STATUS_CODE_PROTOCOL_ERROR);
+            return pdTRUE;
+        }
+
+        if (xLength == 126u)
+        {
+            if (pxClient->xRxUsed - xOffset < 4u)
+            {
+                break;
+            }
+            xLength = ((size_t) pucFrame[2] << 8) | pucFrame[3];
+            xHeader = 4u;
+        }
+        else if (xLength == 127u)
+        {
+            /* Nothing this large is expected from a dashboard */
+            prvStartClose(pxClient, WS_STATUS_CODE_MESSAGE_TOO_BIG);
+            return pdTRUE;
+        }
+
+        if (xHeader + 4u + xLength > WS_SERVER_RX_SIZE)
+        {
+            prvStartClose(pxClient, WS_STATUS_CODE_MESSAGE_TOO_BIG);
+            return pdTRUE;
+        }
+        if (pxClient->xRxUsed - xOffset < xHeader + 4u + xLength)
+        {
+            break;
+        }
+
+        pucPayload = &pucFrame[xHeader + 4u];
+        prvUnmask(pucPayload, xLength, &pucFrame[xHeader]);
+
+        switch (ucOpcode)
+        {
+        case WS_FRAME_TYPE_PING:
+            if (xLength > WS_MAX_CONTROL_PAYLOAD)
+            {
+                return pdFALSE;
+            }
+            /* A pong not sent yet is replaced by the newer one */
+            if (pxClient->eState == eWsOpen)
+            {
+                xHeader = prvFrameHeader(pxClient->ucControl, WS_FRAME_TYPE_PONG, xLength);
+                memcpy(&pxClient->ucControl[xHeader], pucPayload, xLength);
+                pxClient->xControlLength = xHeader + xLength;
+            }
+            break;
+        case WS_FRAME_TYPE_CLOSE:
+            if (pxClient->eState == eWsClosing)
+            {
+                /* Answer to our close frame */
+                return pdFALSE;
+            }
+            prvStartClose(pxClient, WS_STATUS_CODE_NORMAL_CLOSURE);
+            break;
+        default:
+            /* Pongs, and messages from the dashboard, are not used */
+            break;
+        }
+
+        xOffset += xHeader + 4u + xLength;
+    }
+
+    memmove(pxClient->ucRx, &pxClient->ucRx[xOffset], pxClient->xRxUsed - xOffset);
+    pxClient->xRxUsed -= xOffset;
+
+    return pdTRUE;
+}
+
+static void prvReceive(WsClient_t *pxClient)
+{
+    size_t xReceived = 0;
+    BaseType_t xOk;
+    error_t err;
+
+    err = socketReceive(pxClient->pxSocket, &pxClient->ucRx[pxClient->xRxUsed],
+                        WS_SERVER_RX_SIZE - pxClient->xRxUsed, &xReceived, SOCKET_FLAG_DONT_WAIT);
+    if (err == ERROR_TIMEOUT)
+    {
+        return;
+    }
+    if (err != NO_ERROR || xReceived == 0)
+    {
+        prvClose(pxClient);
+        return;
+    }
+
+    pxClient->xRxUsed += xReceived;
+    pxClient->xLastRx = osGetSystemTime();
+
+    if (pxClient->eState == eWsHandshake)
+    {
+        xOk = prvHandshake(pxClient);
+        if (xOk == pdFALSE)
+        {
+            xSemaphoreTake(xRingMutex, portMAX_DELAY);
+            xStats.ulRejected++;
+            xSemaphoreGive(xRingMutex);
+            pxClient->xTxLength = (size_t) snprintf((char *) pxClient->ucTx, sizeof(pxClient->ucTx),
+                                                    "HTTP/1.1 400 Bad Request\r\n"
+                                                    "Connection: close\r\n\r\n");
+            pxClient->xTxOffset = 0;
+            pxClient->xControlLength = 0;
+            pxClient->eState = eWsClosing;
+        }
+    }
+    else
+    {
+        xOk = prvProcessFrames(pxClient);
+        if (xOk == pdFALSE)
+        {
+            prvClose(pxClient);
+        }
+    }
+}
+
+/* Write as much as the socket takes without waiting: the frame being sent,
+   then a pending control frame, then the next telemetry frames */
+static void prvPump(WsClient_t *pxClient)
+{
+    size_t xWritten;
+    uint32_t ulBehind;
+    WsRingFrame_t *pxFrame;
+    error_t err;
+
+    for (;;)
+    {
+        if (pxClient->xTxOffset < pxClient->xTxLength)
+        {
+            xWritten = 0;
+            err = socketSend(pxClient->pxSocket, &pxClient->ucTx[pxClient->xTxOffset],
+                             pxClient->xTxLength - pxClient->xTxOffset, &xWritten, SOCKET_FLAG_NO_DELAY);
+            pxClient->xTxOffset += xWritten;
+            if (err == ERROR_TIMEOUT)
+            {
+                /* The send buffer is full; the rest goes once it drains */
+                return;
+            }
+            if (err != NO_ERROR)
+            {
+                prvClose(pxClient);
+                return;
+            }
+            continue;
+        }
+
+        if (pxClient->xControlLength > 0)
+        {
+            memcpy(pxClient->ucTx, pxClient->ucControl, pxClient->xControlLength);
+            pxClient->xTxLength = pxClient->xControlLength;
+            pxClient->xTxOffset = 0;
+            pxClient->xControlLength = 0;
+            continue;
+        }
+
+        if (pxClient->eState == eWsClosing)
+        {
+            prvClose(pxClient);
+            return;
+        }
+        if (pxClient->eState != eWsOpen)
+        {
+            return;
+        }
+
+        xSemaphoreTake(xRingMutex, portMAX_DELAY);
+        ulBehind = ulPublished - pxClient->ulNext;
+        if (ulBehind > WS_SERVER_CLIENT_QUEUE)
+        {
+            /* Too slow: skip to the newest frames rather than wait */
+            pxClient->ulDropped += ulBehind - WS_SERVER_CLIENT_QUEUE;
+            xStats.ulDropped += ulBehind - WS_SERVER_CLIENT_QUEUE;
+            pxClient->ulNext = ulPublished - WS_SERVER_CLIENT_QUEUE;
+            ulBehind = WS_SERVER_CLIENT_QUEUE;
+        }
+        if (ulBehind > 0)
+        {
+            pxFrame = &xRing[pxClient->ulNext % WS_SERVER_RING_FRAMES];
+            memcpy(pxClient->ucTx, pxFrame->ucFrame, pxFrame->usLength);
+            pxClient->xTxLength = pxFrame->usLength;
+            pxClient->xTxOffset = 0;
+            pxClient->ulNext++;
+            pxClient->ulSent++;
+            xStats.ulSent++;
+        }
+        xSemaphoreGive(xRingMutex);
+
+        if (ulBehind == 0)
+        {
+            return;
+        }
+    }
+}
+
+static void prvAccept(Socket *pxListener)
+{
+    WsClient_t *pxClient = NULL;
+    Socket *pxSocket;
+    IpAddr xPeer;
+    uint16_t usPeerPort;
+    UBaseType_t i;
+
+    pxSocket = socketAccept(pxListener, &xPeer, &usPeerPort);
+    if (pxSocket == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < WS_SERVER_MAX_CLIENTS; i++)
+    {
+        if (xClients[i].eState == eWsFree)
+        {
+            pxClient = &xClients[i];
+            break;
+        }
+    }
+
+    if (pxClient == NULL)
+    {
+        /* The dashboards connected keep their stream */
+        socketClose(pxSocket);
+        xSemaphoreTake(xRingMutex, portMAX_DELAY);
+        xStats.ulRejected++;
+        xSemaphoreGive(xRingMutex);
+        return;
+    }
+
+    /* Never block on a client */
+    socketSetTimeout(pxSocket, 0);
+
+    pxClient->pxSocket = pxSocket;
+    pxClient->xPeer = xPeer;
+    pxClient->usPeerPort = usPeerPort;
+    pxClient->xLastRx = osGetSystemTime();
+    pxClient->ulSent = 0;
+    pxClient->ulDropped = 0;
+    pxClient->xTxLength = 0;
+    pxClient->xTxOffset = 0;
+    pxClient->xControlLength = 0;
+    pxClient->xRxUsed = 0;
+    pxClient->eState = eWsHandshake;
+}
+
+/* Handshake and inactivity timeouts, and keepalive pings */
+static void prvCheckTimers(WsClient_t *pxClient)
+{
+    systime_t xNow = osGetSystemTime();
+
+    if ((pxClient->eState == eWsHandshake && xNow - pxClient->xLastRx >= WS_SERVER_HANDSHAKE_TIMEOUT_MS) ||
+        xNow - pxClient->xLastRx >= WS_SERVER_TIMEOUT_MS)
+    {
+        xSemaphoreTake(xRingMutex, portMAX_DELAY);
+        xStats.ulTimedOut++;
+        xSemaphoreGive(xRingMutex);
+        prvClose(pxClient);
+        return;
+    }
+
+    if (pxClient->eState == eWsOpen && pxClient->xControlLength == 0 &&
+        xNow - pxClient->xLastPing >= WS_SERVER_PING_INTERVAL_MS)
+    {
+        pxClient->xControlLength = prvFrameHeader(pxClient->ucControl, WS_FRAME_TYPE_PING, 0);
+        pxClient->xLastPing = xNow;
+    }
+}
+
+static void prvWebSocketTask(void *pvParameters)
+{
+    SocketEventDesc xEvents[1 + WS_SERVER_MAX_CLIENTS];
+    WsClient_t *pxOwners[1 + WS_SERVER_MAX_CLIENTS];
+    WsClient_t *pxClient;
+    Socket *pxListener;
+    UBaseType_t uxCount;
+    UBaseType_t i;
+
+    (void) pvParameters;
+
+    pxListener = socketOpen(SOCKET_TYPE_STREAM, SOCKET_IP_PROTO_TCP);
+    if (pxListener == NULL)
+    {
+        vTaskDelete(NULL);
+        return;
+    }
+
+    socketBind(pxListener, &IP_ADDR_ANY, WS_SERVER_PORT);
+    socketListen(pxListener, WS_SERVER_MAX_CLIENTS);
+
+    for (;;)
+    {
+        /* The listener, then every client; those with data waiting to go
+           out also wait for room in their send buffer */
+        xEvents[0].socket = pxListener;
+        xEvents[0].eventMask = SOCKET_EVENT_ACCEPT;
+        pxOwners[0] = NULL;
+        uxCount = 1;
+
+        for (i = 0; i < WS_SERVER_MAX_CLIENTS; i++)
+        {
+            pxClient = &xClients[i];
+            if (pxClient->eState != eWsFree)
+            {
+                xEvents[uxCount].socket = pxClient->pxSocket;
+                xEvents[uxCount].eventMask = SOCKET_EVENT_RX_READY;
+                if (pxClient->xTxOffset < pxClient->xTxLength)
+                {
+                    xEvents[uxCount].eventMask |= SOCKET_EVENT_TX_READY;
+                }
+                pxOwners[uxCount++] = pxClient;
+            }
+        }
+
+        for (i = 0; i < uxCount; i++)
+        {
+            xEvents[i].eventFlags = 0;
+        }
+
+        /* Publications set the event; wake up once a second at least, for
+           the timeouts and keepalives */
+        if (socketPoll(xEvents, uxCount, &xWsEvent, 1000) == NO_ERROR)
+        {
+            for (i = 1; i < uxCount; i++)
+            {
+                if ((xEvents[i].eventFlags & SOCKET_EVENT_RX_READY) != 0)
+                {
+                    prvReceive(pxOwners[i]);
+                }
+            }
+
+            if ((xEvents[0].eventFlags & SOCKET_EVENT_ACCEPT) != 0)
+            {
+                prvAccept(pxListener);
+            }
+        }
+
+        for (i = 0; i < WS_SERVER_MAX_CLIENTS; i++)
+        {
+            pxClient = &xClients[i];
+            if (pxClient->eState != eWsFree)
+            {
+                prvCheckTimers(pxClient);
+            }
+            if (pxClient->eState != eWsFree)
+            {
+                prvPump(pxClient);
+            }
+        }
+    }
+}
+
+BaseType_t xWebSocketServerStart(UBaseType_t uxPriority)
+{
+    xRingMutex = xAppSemaphoreCreateMutex(xRingMutex);
+    if (xRingMutex == NULL || !osCreateEvent(&xWsEvent))
+    {
+        return pdFAIL;
+    }
+
+    return xAppTaskCreate(xWebSocketTask,
+                          prvWebSocketTask,
+                          "WebSocket",
+                          WS_SERVER_TASK_STACK_SIZE,
+                          NULL,
+                          uxPriority,
+                          NULL);
+}
+
+static BaseType_t prvWsCommand(char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString)
+{
+    static UBaseType_t uxLine = 0;
+    WebSocketServerStats_t xSnapshot;
+    WsClient_t *pxClient;
+    char cPeer[40];
+
+    (void) pcCommandString;
+
+    if (xRingMutex == NULL)
+    {
+        snprintf(pcWriteBuffer, xWriteBufferLen, "WebSocket server not started\r\n");
+        return pdFALSE;
+    }
+
+    if (uxLine == 0)
+    {
+        vWebSocketServerGetStats(&xSnapshot);
+        snprintf(pcWriteBuffer, xWriteBufferLen, "clients %lu published %lu sent %lu dropped %lu\r\n",
+                 (unsigned long) uxOpen, (unsigned long) xSnapshot.ulPublished, (unsigned long) xSnapshot.ulSent,
+                 (unsigned long) xSnapshot.ulDropped);
+        uxLine++;
+        return pdTRUE;
+    }
+
+    if (uxLine == 1u)
+    {
+        vWebSocketServerGetStats(&xSnapshot);
+        snprintf(pcWriteBuffer, xWriteBufferLen, "accepted %lu rejected %lu timeouts %lu\r\n",
+                 (unsigned long) xSnapshot.ulAccepted, (unsigned long) xSnapshot.ulRejected,
+                 (unsigned long) xSnapshot.ulTimedOut);
+        uxLine++;
+        return pdTRUE;
+    }
+
+    /* One line per open client; read racily, as the task owns them */
+    pcWriteBuffer[0] = '\0';
+    for (; uxLine - 2u < WS_SERVER_MAX_CLIENTS; uxLine++)
+    {
+        pxClient = &xClients[uxLine - 2u];
+        if (pxClient->eState == eWsOpen)
+        {
+            ipAddrToString(&pxClient->xPeer, cPeer);
+            snprintf(pcWriteBuffer, xWriteBufferLen, "%s:%u behind %lu sent %lu dropped %lu\r\n", cPeer,
+                     pxClient->usPeerPort, (unsigned long) (ulPublished - pxClient->ulNext),
+                     (unsigned long) pxClient->ulSent, (unsigned long) pxClient->ulDropped);
+            uxLine++;
+            break;
+        }
+    }
+
+    if (uxLine - 2u < WS_SERVER_MAX_CLIENTS)
+    {
+        return pdTRUE;
+    }
+
+    uxLine = 0;
+    return pdFALSE;
+}
+
+void vWebSocketServerRegisterCLICommands(void)
+{
+    FreeRTOS_CLIRegisterCommand(&xWs);
+}
@@ -41,19 +41,78 @@
 #include "Sample-CLI-commands.h"
 
 #include "CommandConsoleDualTask.h"
+#include "RunTimeStats.h"
+#include "NetCLICommands.h"
+#include "NetStatsExport.h"
+#include "NetBench.h"
+#include "NetReplay.h"
+#include "ResourceMonitor.h"
+#include "DhcpLeaseStore.h"
+#include "DhcpServerLeaseStore.h"
+#include "CyphalNode.h"
+#include "CyphalServices.h"
+#include "CyphalPnp.h"
+#include "AdcStream.h"
+#include "PtpSlave.h"
+#include "MonoClock.h"
+#include "StaticAlloc.h"
+#include "TcmPlacement.h"
+#include "MemoryLayout.h"
+#include "TlsfHeap.h"
+#include "MemTag.h"
+#include "LowPower.h"
+#include "TraceRecorder.h"
+#include "DeferredLog.h"
+#include "SyslogSink.h"
+#include "BatchConsole.h"
+#include "MqttClient.h"
+#include "MqttSnClient.h"
+#include "ModbusServer.h"
+#include "ModbusClient.h"
+#include "ModbusRtuGateway.h"
+#include "CoapServer.h"
+#include "WebSocketServer.h"
+#include "HttpServer.h"
+#include "WebAssets.h"
+#include "SnmpAgent.h"
+#include "LldpAgent.h"
+#include "SntpClient.h"
+#include "PingMonitor.h"
+#include "TftpServer.h"
+#include "PacketCapture.h"
+#include "FlashSink.h"
+#include "FlashStore.h"
+#include "PhyInterrupt.h"
+#include "PppModem.h"
+#include "BootProfile.h"
+#include "CrashDump.h"
+#include "Watchdog.h"
+#include "HwRng.h"
+#include "MdmaCopy.h"
+#include "MicroBench.h"
+#include "FleetTest.h"
+#include "ClockGovernor.h"
+#include "TelemetryEncoder.h"
 
 #include "core/net.h"
+#include "core/socket_reactor.h"
 #include "drivers/mac/stm32h7xx_eth_driver.h"
 #include "drivers/phy/lan8742_driver.h"
+#include "drivers/loopback/loopback_driver.h"
 #include "dhcp/dhcp_client.h"
+#include "dhcp/dhcp_server.h"
+#include "nat/nat.h"
+#include "ppp/ppp.h"
+#include "ppp/ppp_hdlc.h"
 #include "ipv6/slaac.h"
 #include "mdns/mdns_responder.h"
+#include "dns_sd/dns_sd_responder.h"
 #include "http/http_client.h"
+#include "http/http_client_pool.h"
+#include "http/http_client_inflate.h"
 #include "icmp.h"
 #include "debug.h"
 
-#include "udpard.h"
-
 
 /* USER CODE END Includes */
 
@@ -70,14 +129,57 @@
 #define APP_HOST_NAME "http-client-demo"
 #define APP_MAC_ADDR "00-AB-CD-EF-07-43"
 
-//#define APP_USE_DHCP_CLIENT ENABLED
-#define APP_USE_DHCP_CLIENT DISABLED
+//Link changes signalled by the nINT pin of the PHY rather than polled over
+//MDIO every NIC_TICK_INTERVAL; needs nINT wired to PHY_INT_GPIO_PIN
+#define APP_USE_PHY_INTERRUPT DISABLED
+//#define APP_USE_PHY_INTERRUPT ENABLED
+
+//Second Cyphal/UDP interface, a VLAN of the Ethernet port: the node sends
+//every frame on both and keeps the first copy received
+#define APP_IF2_NAME "eth0.2"
+#define APP_IF2_VLAN_ID 2
+#define APP_IF2_IPV4_HOST_ADDR "192.168.2.20"
+#define APP_IF2_IPV4_SUBNET_MASK "255.255.255.0"
+
+//NAT between the VLAN and the network of the first interface: machines on
+//eth0.2 reach the outside through the address obtained on eth0
+#define APP_USE_NAT ENABLED
+//#define APP_USE_NAT DISABLED
+#define APP_NAT_SESSION_COUNT 256
+
+//Cellular modem on USART2, the uplink while eth0 has no address: eth0 comes
+//first in the interface table and is preferred by source address selection
+//whenever its lease is valid
+#define APP_USE_PPP ENABLED
+//#define APP_USE_PPP DISABLED
+#define APP_PPP_IF_NAME "ppp0"
+#define APP_PPP_IF_INDEX 2
+
+//Loopback interface, carrying the traffic to 127.0.0.0/8 and to the
+//addresses of the other interfaces between local components
+#define APP_LO_NAME "lo"
+
+//The lease is saved in flash and requested again at boot (INIT-REBOOT), so
+//the address is usually restored with a single DHCPREQUEST/DHCPACK exchange
+#define APP_USE_DHCP_CLIENT ENABLED
+//#define APP_USE_DHCP_CLIENT DISABLED
 #define APP_IPV4_HOST_ADDR "192.168.0.20"
 #define APP_IPV4_SUBNET_MASK "255.255.255.0"
 #define APP_IPV4_DEFAULT_GATEWAY "192.168.0.254"
 #define APP_IPV4_PRIMARY_DNS "8.8.8.8"
 #define APP_IPV4_SECONDARY_DNS "8.8.4.4"
 
+//DHCP server for a machine-internal network, on top of the static address
+//above; leases are saved in flash and survive a reboot of the server
+#define APP_USE_DHCP_SERVER DISABLED
+//#define APP_USE_DHCP_SERVER ENABLED
+#define APP_DHCP_SERVER_IP_ADDR_MIN "192.168.0.100"
+#define APP_DHCP_SERVER_IP_ADDR_MAX "192.168.0.249"
+
+#if (APP_USE_DHCP_CLIENT == ENABLED && APP_USE_DHCP_SERVER == ENABLED)
+   #error The DHCP client and the DHCP server cannot share the interface
+#endif
+
 #define APP_USE_SLAAC DISABLED
 //#define APP_IPV6_LINK_LOCAL_ADDR "fe80::743"
 //#define APP_IPV6_PREFIX "2001:db8::"
@@ -92,6 +194,9 @@
 #define APP_HTTP_SERVER_PORT 80
 #define APP_HTTP_URI "/anything"
 
+//Number of services advertised with DNS-SD
+#define APP_DNS_SD_SERVICE_COUNT 3
+
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -108,11 +213,43 @@ __IO uint32_t BspButtonState = BUTTON_RELEASED;
 //Global variables
 DhcpClientSettings dhcpClientSettings;
 DhcpClientContext dhcpClientContext;
+DhcpServerSettings dhcpServerSettings;
+DhcpServerContext dhcpServerContext;
 SlaacSettings slaacSettings;
 SlaacContext slaacContext;
 MdnsResponderSettings mdnsResponderSettings;
 MdnsResponderContext mdnsResponderContext;
-HttpClientContext httpClientContext;
+DnsSdResponderSettings dnsSdResponderSettings;
+DnsSdResponderContext dnsSdResponderContext;
+DnsSdResponderService dnsSdResponderServices[APP_DNS_SD_SERVICE_COUNT];
+HttpClientPool httpClientPool;
+HttpClientInflateContext httpInflateContext;
+SocketReactorSettings socketReactorSettings;
+SocketReactorContext socketReactorContext;
+#if (APP_USE_NAT == ENABLED)
+NatSettings natSettings;
+NatContext natContext;
+NatSession natSessions[APP_NAT_SESSION_COUNT];
+#endif
+#if (PPP_SUPPORT == ENABLED && APP_USE_PPP == ENABLED)
+PppSettings pppSettings;
+PppContext pppContext;
+#endif
+
+//Storage of the TCP/IP tasks, of the socket reactor and of the LED tasks
+//(static allocation profile).
+//The stack of the TCP/IP task is in the DTCM: nothing on it is handed to a DMA
+#if (TCM_PLACEMENT == 1)
+APP_TASK_STORAGE_IN(xNetTask, NET_TASK_STACK_SIZE, TCM_DATA_SECTION);
+#else
+APP_TASK_STORAGE(xNetTask, NET_TASK_STACK_SIZE);
+#endif
+#if (NET_CONTROL_TASK_SUPPORT == ENABLED)
+APP_TASK_STORAGE(xNetControlTask, NET_CONTROL_TASK_STACK_SIZE);
+#endif
+APP_TASK_STORAGE(xSocketReactorTask, SOCKET_REACTOR_STACK_SIZE);
+APP_TASK_STORAGE(xGreenLedTask, 128);
+APP_TASK_STORAGE(xRedLedTask, configMINIMAL_STACK_SIZE);
 
 //static xComPortHandle comPortHandle = NULL;
 
@@ -126,23 +263,17 @@ void MX_FREERTOS_Init(void);
 /* USER CODE BEGIN PFP */
 
 
+void netBringUp(void);
 void initTask(void);
+error_t httpClientPoolInitCallback(HttpClientContext *context);
 error_t httpClientTest(void);
 void userTask(void *param);
 void ledTask(void *param);
 
 
 #ifdef configUSE_TICK_HOOK
-static volatile uint64_t xTickCount64 = 0;
 void vApplicationTickHook( void ){
-	xTickCount64++;
-}
-uint64_t xTaskGetTickCount64(void){
-	uint64_t value;
-	taskENTER_CRITICAL();
-	value = xTickCount64;
-	taskEXIT_CRITICAL();
-	return value;
+	vRunTimeStatsTickHook();
 }
 #endif // configUSE_TICK_HOOK
 
@@ -191,7 +322,7 @@ void pvRedLEDTask(void *pvParams){
 	   {
 	      BSP_LED_Toggle(LED_RED);
 	      osDelayTask(200);
-	      //printf("%0.3f\r\n", (float)xTaskGetTickCount64()/(float)configTICK_RATE_HZ );
+	      //printf("%0.6f\r\n", (double)ullMonoClockNowUs()/(double)MONO_CLOCK_HZ );
 	   }
 }
 
@@ -199,23 +330,41 @@ void pvRedLEDTask(void *pvParams){
 
 
 /**
- * @brief Initialization task
- * @param[in] param Unused parameter
+ * @brief Bring up the TCP/IP stack and the Ethernet interface
+ *
+ * Called first thing after the peripheral initialization: configuring the
+ * interface resets the PHY and starts auto-negotiation, which then runs
+ * while the tasks, the CLI and the services of initTask() are set up
  **/
 
-void initTask(void)
+void netBringUp(void)
 {
    error_t error;
-
+   uint8_t seed[NET_RAND_SEED_SIZE];
+   NetSettings netSettings;
    NetInterface *interface;
    MacAddr macAddr;
 
-   #if (APP_USE_DHCP_CLIENT == DISABLED)
-      Ipv4Addr ipv4Addr;
-   #endif
-
    //TCP/IP stack initialization
-   error = netInit();
+   netGetDefaultSettings(&netSettings);
+#if (APP_STATIC_ALLOCATION == 1)
+   //The TCP/IP task runs on its static TCB and stack
+   netSettings.task.tcb = &xNetTaskTcb;
+   netSettings.task.stack = xNetTaskStack;
+#if (NET_CONTROL_TASK_SUPPORT == ENABLED)
+   netSettings.controlTask.tcb = &xNetControlTaskTcb;
+   netSettings.controlTask.stack = xNetControlTaskStack;
+#endif
+#endif
+   error = netInitEx(&netContext, &netSettings);
+   configASSERT(NO_ERROR==error);
+
+   //Key of the software generator, used by a host build and by
+   //TCP_SECURE_ISN_SUPPORT; the stack draws from the RNG otherwise
+   vHwRngGetData(seed, sizeof(seed));
+   error = netSeedRand(seed, sizeof(seed));
+   configASSERT(NO_ERROR==error);
+   error = netStart(&netContext);
    configASSERT(NO_ERROR==error);
    TRACE_INFO("Initialized TCP/IP Stack...\r\n");
 
@@ -243,11 +392,136 @@ void initTask(void)
    error = netSetPhyDriver(interface, &lan8742PhyDriver);
    configASSERT(NO_ERROR==error);
    TRACE_INFO("Set PHY driver...\r\n");
+#if (APP_USE_PHY_INTERRUPT == ENABLED)
+   error = netSetExtIntDriver(interface, &xPhyExtIntDriver);
+   configASSERT(NO_ERROR==error);
+   TRACE_INFO("Set PHY interrupt line...\r\n");
+#endif
 
    //Initialize network interface
    error = netConfigInterface(interface);
    configASSERT(NO_ERROR==error);
    TRACE_INFO("Configured network interface...\r\n");
+   vBootProfileMark("phy an started");
+} // netBringUp
+
+
+/**
+ * @brief Initialization task
+ * @param[in] param Unused parameter
+ **/
+
+void initTask(void)
+{
+   error_t error;
+   BaseType_t ret;
+
+   NetInterface *interface;
+#if (ETH_VLAN_SUPPORT == ENABLED)
+   NetInterface *interface2;
+#endif
+#if (PPP_SUPPORT == ENABLED && APP_USE_PPP == ENABLED)
+   NetInterface *pppInterface;
+#endif
+#if (NET_LOOPBACK_IF_SUPPORT == ENABLED)
+   NetInterface *loopbackInterface;
+#endif
+   MacAddr macAddr;
+#if (ETH_VLAN_SUPPORT == ENABLED || APP_USE_DHCP_CLIENT == DISABLED)
+   Ipv4Addr ipv4Addr;
+#endif
+
+   //The Ethernet interface is configured by netBringUp()
+   interface = &netInterface[0];
+   macStringToAddr(APP_MAC_ADDR, &macAddr);
+
+   ret = xBootProfileWatchLink(interface);
+   configASSERT(pdPASS==ret);
+
+#if (ETH_VLAN_SUPPORT == ENABLED)
+   //Configure the redundant Cyphal/UDP interface on top of the first one
+   interface2 = &netInterface[1];
+
+   error = netSetInterfaceName(interface2, APP_IF2_NAME);
+   configASSERT(NO_ERROR==error);
+   error = netSetMacAddr(interface2, &macAddr);
+   configASSERT(NO_ERROR==error);
+   error = netSetParentInterface(interface2, interface);
+   configASSERT(NO_ERROR==error);
+   error = netSetVlanId(interface2, APP_IF2_VLAN_ID);
+   configASSERT(NO_ERROR==error);
+
+   error = netConfigInterface(interface2);
+   configASSERT(NO_ERROR==error);
+
+   //Static address, the network of the VLAN carrying Cyphal only
+   ipv4StringToAddr(APP_IF2_IPV4_HOST_ADDR, &ipv4Addr);
+   ipv4SetHostAddr(interface2, ipv4Addr);
+   ipv4StringToAddr(APP_IF2_IPV4_SUBNET_MASK, &ipv4Addr);
+   ipv4SetSubnetMask(interface2, ipv4Addr);
+   TRACE_INFO("Configured interface %s (VLAN %u)...\r\n", APP_IF2_NAME, APP_IF2_VLAN_ID);
+#endif
+
+#if (ETH_VLAN_SUPPORT == ENABLED && APP_USE_NAT == ENABLED && NAT_SUPPORT == ENABLED)
+   //Translate the traffic of the VLAN to the address of the first interface
+   natGetDefaultSettings(&natSettings);
+   natSettings.publicInterface = interface;
+   natSettings.privateInterfaces[0] = interface2;
+   natSettings.numPrivateInterfaces = 1;
+   natSettings.sessions = natSessions;
+   natSettings.numSessions = APP_NAT_SESSION_COUNT;
+
+   error = natInit(&natContext, &natSettings);
+   configASSERT(NO_ERROR==error);
+
+   //Packets are only translated once the address of eth0 is valid
+   error = natStart(&natContext);
+   configASSERT(NO_ERROR==error);
+   TRACE_INFO("Started NAT %s -> %s...\r\n", APP_IF2_NAME, APP_IF_NAME);
+#endif
+
+#if (PPP_SUPPORT == ENABLED && APP_USE_PPP == ENABLED)
+   //Configure the PPP interface; the address, the gateway and the DNS
+   //servers are those negotiated by IPCP
+   pppInterface = &netInterface[APP_PPP_IF_INDEX];
+
+   error = netSetInterfaceName(pppInterface, APP_PPP_IF_NAME);
+   configASSERT(NO_ERROR==error);
+   netSetDriver(pppInterface, &pppHdlcDriver);
+   netSetUartDriver(pppInterface, &xPppModemUartDriver);
+
+   //The peer is asked to escape no control character: the link is 8-bit
+   //clean, and the HDLC stuffing only has the flag and escape bytes to find
+   pppGetDefaultSettings(&pppSettings);
+   pppSettings.interface = pppInterface;
+   pppSettings.accm = 0x00000000;
+
+   //Binds the context to the interface, before the driver starts
+   error = pppInit(&pppContext, &pppSettings);
+   configASSERT(NO_ERROR==error);
+   error = netConfigInterface(pppInterface);
+   configASSERT(NO_ERROR==error);
+
+   ret = xPppModemStart(pppInterface, tskIDLE_PRIORITY+1);
+   configASSERT(pdPASS==ret);
+   TRACE_INFO("Configured interface %s...\r\n", APP_PPP_IF_NAME);
+#endif
+
+#if (NET_LOOPBACK_IF_SUPPORT == ENABLED)
+   //Configure the loopback interface, the last one
+   loopbackInterface = &netInterface[NET_INTERFACE_COUNT - 1];
+
+   error = netSetInterfaceName(loopbackInterface, APP_LO_NAME);
+   configASSERT(NO_ERROR==error);
+   netSetDriver(loopbackInterface, &loopbackDriver);
+
+   error = netConfigInterface(loopbackInterface);
+   configASSERT(NO_ERROR==error);
+
+   ipv4SetHostAddr(loopbackInterface, IPV4_LOOPBACK_ADDR);
+   ipv4SetSubnetMask(loopbackInterface, IPV4_LOOPBACK_MASK);
+   TRACE_INFO("Configured interface %s...\r\n", APP_LO_NAME);
+#endif
 
    #if (IPV4_SUPPORT == ENABLED)
 
@@ -257,8 +531,15 @@ void initTask(void)
 	   dhcpClientGetDefaultSettings(&dhcpClientSettings);
 	   //Set the network interface to be configured by DHCP
 	   dhcpClientSettings.interface = interface;
-	   //Disable rapid commit option
-	   dhcpClientSettings.rapidCommit = FALSE;
+	   //Enable rapid commit option
+	   dhcpClientSettings.rapidCommit = TRUE;
+	   //Probe the saved address while waiting for the DHCPACK
+	   dhcpClientSettings.parallelProbe = TRUE;
+	   //Keep the lease across power cycles
+	   dhcpClientSettings.loadLeaseCallback = xDhcpLeaseStoreLoad;
+	   dhcpClientSettings.storeLeaseCallback = vDhcpLeaseStoreSave;
+	   //First request and lease on the boot timeline
+	   dhcpClientSettings.stateChangeEvent = vBootProfileDhcpStateChange;
 
 	   //DHCP client initialization
 	   error = dhcpClientInit(&dhcpClientContext, &dhcpClientSettings);
@@ -289,6 +570,37 @@ void initTask(void)
 		   ipv4StringToAddr(APP_IPV4_SECONDARY_DNS, &ipv4Addr);
 		   ipv4SetDnsServer(interface, 1, ipv4Addr);
 
+		   #if (APP_USE_DHCP_SERVER == ENABLED)
+
+		   //Get default settings
+		   dhcpServerGetDefaultSettings(&dhcpServerSettings);
+		   //Bind the DHCP server to the interface
+		   dhcpServerSettings.interface = interface;
+		   //Lowest and highest addresses of the pool
+		   ipv4StringToAddr(APP_DHCP_SERVER_IP_ADDR_MIN, &dhcpServerSettings.ipAddrRangeMin);
+		   ipv4StringToAddr(APP_DHCP_SERVER_IP_ADDR_MAX, &dhcpServerSettings.ipAddrRangeMax);
+		   //Configuration handed out to the clients
+		   ipv4StringToAddr(APP_IPV4_SUBNET_MASK, &dhcpServerSettings.subnetMask);
+		   ipv4StringToAddr(APP_IPV4_DEFAULT_GATEWAY, &dhcpServerSettings.defaultGateway);
+		   ipv4StringToAddr(APP_IPV4_PRIMARY_DNS, &dhcpServerSettings.dnsServer[0]);
+		   ipv4StringToAddr(APP_IPV4_SECONDARY_DNS, &dhcpServerSettings.dnsServer[1]);
+		   //Save the lease table once it settles
+		   dhcpServerSettings.storeLeasesCallback = vDhcpServerLeaseStoreNotify;
+
+		   //DHCP server initialization
+		   error = dhcpServerInit(&dhcpServerContext, &dhcpServerSettings);
+		   configASSERT(NO_ERROR==error);
+		   TRACE_INFO("Initialized DHCP server...\r\n");
+
+		   //Restore the leases granted before the last reset
+		   xDhcpServerLeaseStoreStart(&dhcpServerContext, tskIDLE_PRIORITY+1);
+
+		   error = dhcpServerStart(&dhcpServerContext);
+		   configASSERT(NO_ERROR==error);
+		   TRACE_INFO("Started DHCP server...\r\n");
+
+		   #endif
+
 	   #endif
 
    #endif
@@ -313,12 +625,187 @@ void initTask(void)
    configASSERT(NO_ERROR==error);
    TRACE_INFO("Started mDNS responder...\r\n");
 
+   //Get default settings
+   dnsSdResponderGetDefaultSettings(&dnsSdResponderSettings);
+   //Underlying network interface
+   dnsSdResponderSettings.interface = &netInterface[0];
+   //DNS-SD services
+   dnsSdResponderSettings.numServices = APP_DNS_SD_SERVICE_COUNT;
+   dnsSdResponderSettings.services = dnsSdResponderServices;
+
+   //DNS-SD responder initialization
+   error = dnsSdResponderInit(&dnsSdResponderContext, &dnsSdResponderSettings);
+   configASSERT(NO_ERROR==error);
+   TRACE_INFO("Initialized DNS-SD responder...\r\n");
+
+   //Telnet console
+   error = dnsSdResponderRegisterService(&dnsSdResponderContext, 0,
+      APP_HOST_NAME, "_telnet._tcp", 0, 0, 23, "");
+   configASSERT(NO_ERROR==error);
+
+   //UDP telemetry (the statistics are pushed to a collector, so no port
+   //is listened to)
+   error = dnsSdResponderRegisterService(&dnsSdResponderContext, 1,
+      APP_HOST_NAME, "_netstats._udp", 0, 0, 0, "txtvers=1;mode=push");
+   configASSERT(NO_ERROR==error);
+
+   //HTTP
+   error = dnsSdResponderRegisterService(&dnsSdResponderContext, 2,
+      APP_HOST_NAME, "_http._tcp", 0, 0, 80, "path=/");
+   configASSERT(NO_ERROR==error);
+   TRACE_INFO("Registered DNS-SD services...\r\n");
+
+   //Start DNS-SD responder
+   error = dnsSdResponderStart(&dnsSdResponderContext);
+   configASSERT(NO_ERROR==error);
+   TRACE_INFO("Started DNS-SD responder...\r\n");
+
    error = icmpEnableEchoRequests(interface, TRUE);
    configASSERT(NO_ERROR==error);
    TRACE_INFO("Enabled ICMP requests...\r\n");
 
+   //Keep-alive connections are reused across uploads
+   error = httpClientPoolInit(&httpClientPool, httpClientPoolInitCallback);
+   configASSERT(NO_ERROR==error);
+   TRACE_INFO("Initialized HTTP client connection pool...\r\n");
+
+   //Cyphal/UDP node, scheduled alongside the TCP/IP stack task
+   ret = xCyphalNodeStart(tskIDLE_PRIORITY+2);
+   configASSERT(pdPASS==ret);
+   TRACE_INFO("Started Cyphal/UDP node...\r\n");
+
+   //GetInfo, registers and port list of the node
+   ret = xCyphalServicesStart();
+   configASSERT(pdPASS==ret);
+   TRACE_INFO("Started Cyphal services...\r\n");
+
+   //Node-ID from the plug-and-play allocator, the cached one first
+   ret = xCyphalPnpStart(tskIDLE_PRIORITY+2);
+   configASSERT(pdPASS==ret);
+   TRACE_INFO("Started Cyphal PnP...\r\n");
+
+   //ADC blocks published as they fill, above the node task
+   ret = xAdcStreamStart(tskIDLE_PRIORITY+3);
+   configASSERT(pdPASS==ret);
+   TRACE_INFO("Started ADC stream...\r\n");
+
+   //PTP slave on the physical interface, disciplining the MAC clock
+   ret = xPtpSlaveStart(0, tskIDLE_PRIORITY+2);
+   configASSERT(pdPASS==ret);
+   TRACE_INFO("Started PTP slave...\r\n");
+
+   //LLDP advertisement of the physical interface to the switch
+   ret = xLldpAgentStart(0, tskIDLE_PRIORITY+1);
+   configASSERT(pdPASS==ret);
+   TRACE_INFO("Started LLDP agent...\r\n");
+
+   //Socket reactor, serving the connections of the servers without a task
+   //per connection
+   socketReactorGetDefaultSettings(&socketReactorSettings);
+   socketReactorSettings.task[0].priority = tskIDLE_PRIORITY+1;
+#if (APP_STATIC_ALLOCATION == 1)
+   socketReactorSettings.task[0].tcb = &xSocketReactorTaskTcb;
+   socketReactorSettings.task[0].stack = xSocketReactorTaskStack;
+#endif
+   error = socketReactorInit(&socketReactorContext, &socketReactorSettings);
+   configASSERT(NO_ERROR==error);
+   error = socketReactorStart(&socketReactorContext);
+   configASSERT(NO_ERROR==error);
+   TRACE_INFO("Started socket reactor...\r\n");
+
+   //Telnet sessions
+   ret = xTelnetTaskListen(&socketReactorContext);
+   configASSERT(pdPASS==ret);
+   TRACE_INFO("Started Telnet server...\r\n");
+
+   //Crash dump readout
+   ret = xCrashDumpListen(&socketReactorContext);
+   configASSERT(pdPASS==ret);
+   TRACE_INFO("Started crash dump service...\r\n");
+
+   //Supervise the TCP/IP tasks (NET_TASK_ALIVE_HOOK)
+   ret = xWatchdogRegister(netContext.taskId, WATCHDOG_DEADLINE_MS);
+   configASSERT(pdPASS==ret);
+#if (NET_CONTROL_TASK_SUPPORT == ENABLED)
+   ret = xWatchdogRegister(netContext.controlTaskId, WATCHDOG_DEADLINE_MS);
+   configASSERT(pdPASS==ret);
+#endif
+   TRACE_INFO("Supervising the TCP/IP tasks...\r\n");
+
+   vBootProfileMark("services");
 } // initTask
 
+/**
+ * @brief Set up a new pooled HTTP client connection
+ * @param[in] context Pointer to the HTTP client context
+ * @return Error code
+ **/
+
+error_t httpClientPoolInitCallback(HttpClientContext *context)
+{
+   error_t error;
+
+   //Select HTTP protocol version (persistent connections)
+   error = httpClientSetVersion(context, HTTP_VERSION_1_1);
+   //Any error to report?
+   if(error)
+      return error;
+
+   //Set timeout value for blocking operations
+   error = httpClientSetTimeout(context, 20000);
+   //Any error to report?
+   if(error)
+      return error;
+
+   //Carry the request in the SYN segment once the server issued a cookie
+   error = httpClientEnableFastOpen(context, TRUE);
+
+   //Return status code
+   return error;
+}
+
+/**
+ * @brief Write the status document posted by the HTTP client test
+ * @param[in] encoder Telemetry encoder
+ **/
+
+static void httpClientEncodeStatus(TelemetryEncoder_t *encoder)
+{
+   NetInterface *interface;
+   TlsfHeapStats_t heapStats;
+   Ipv4Addr ipv4Addr;
+   char_t text[16];
+
+   //Point to the first network interface
+   interface = &netInterface[0];
+
+   //Take the values first, the fields are written on the fly
+   vTlsfHeapGetStats(&heapStats);
+   ipv4Addr = IPV4_UNSPECIFIED_ADDR;
+   ipv4GetHostAddr(interface, &ipv4Addr);
+
+   vTelemetryBeginMap(encoder, TELEMETRY_INDEFINITE);
+   vTelemetryFieldUint(encoder, "uptime_us", ullMonoClockNowUs());
+   vTelemetryFieldUint(encoder, "tasks", uxTaskGetNumberOfTasks());
+
+   vTelemetryKey(encoder, "net");
+   vTelemetryBeginMap(encoder, 3);
+   vTelemetryFieldString(encoder, "interface", interface->name);
+   vTelemetryFieldBool(encoder, "link", interface->linkState ? pdTRUE : pdFALSE);
+   vTelemetryFieldString(encoder, "ipv4", ipv4AddrToString(ipv4Addr, text));
+   vTelemetryEnd(encoder);
+
+   vTelemetryKey(encoder, "heap");
+   vTelemetryBeginMap(encoder, 4);
+   vTelemetryFieldUint(encoder, "free", heapStats.xFree);
+   vTelemetryFieldUint(encoder, "min_free", heapStats.xMinFree);
+   vTelemetryFieldUint(encoder, "largest_free", heapStats.xLargestFree);
+   vTelemetryFieldUint(encoder, "failures", heapStats.ulFailures);
+   vTelemetryEnd(encoder);
+
+   vTelemetryEnd(encoder);
+}
+
 /**
  * @brief HTTP client test routine
  * @return Error code
@@ -330,75 +817,49 @@ error_t httpClientTest(void)
    size_t length;
    uint_t status;
    const char_t *value;
-   IpAddr ipAddr;
+   HttpClientContext *context;
+   TelemetryEncoder_t encoder;
    char_t buffer[128];
 
-   //Initialize HTTP client context
-   httpClientInit(&httpClientContext);
+   //Debug message
+   TRACE_INFO("\r\n\r\nConnecting to HTTP server %s...\r\n",
+      APP_HTTP_SERVER_NAME);
 
-   //Start of exception handling block
-   do
+   //Reuse an idle connection to the server, or resolve its name and connect
+   error = httpClientPoolAcquire(&httpClientPool, APP_HTTP_SERVER_NAME,
+      APP_HTTP_SERVER_PORT, &context);
+   //Any error to report?
+   if(error)
    {
       //Debug message
-      TRACE_INFO("\r\n\r\nResolving server name...\r\n");
-
-      //Resolve HTTP server name
-      error = getHostByName(NULL, APP_HTTP_SERVER_NAME, &ipAddr, 0);
-      //Any error to report?
-      if(error)
-      {
-         //Debug message
-         TRACE_INFO("Failed to resolve server name!\r\n");
-         break;
-      }
-
-      //Select HTTP protocol version
-      error = httpClientSetVersion(&httpClientContext, HTTP_VERSION_1_1);
-      //Any error to report?
-      if(error)
-         break;
-
-      //Set timeout value for blocking operations
-      error = httpClientSetTimeout(&httpClientContext, 20000);
-      //Any error to report?
-      if(error)
-         break;
-
-      //Debug message
-      TRACE_INFO("Connecting to HTTP server %s...\r\n",
-         ipAddrToString(&ipAddr, NULL));
-
-      //Connect to the HTTP server
-      error = httpClientConnect(&httpClientContext, &ipAddr,
-         APP_HTTP_SERVER_PORT);
-      //Any error to report?
-      if(error)
-      {
-         //Debug message
-         TRACE_INFO("Failed to connect to HTTP server!\r\n");
-         break;
-      }
+      TRACE_INFO("Failed to connect to HTTP server!\r\n");
+      return error;
+   }
 
+   //Start of exception handling block
+   do
+   {
       //Create an HTTP request
-      httpClientCreateRequest(&httpClientContext);
-      httpClientSetMethod(&httpClientContext, "POST");
-      httpClientSetUri(&httpClientContext, APP_HTTP_URI);
+      httpClientCreateRequest(context);
+      httpClientSetMethod(context, "POST");
+      httpClientSetUri(context, APP_HTTP_URI);
 
       //Set the hostname and port number of the resource being requested
-      httpClientSetHost(&httpClientContext, APP_HTTP_SERVER_NAME,
+      httpClientSetHost(context, APP_HTTP_SERVER_NAME,
          APP_HTTP_SERVER_PORT);
 
       //Set query string
-      httpClientAddQueryParam(&httpClientContext, "param1", "value1");
-      httpClientAddQueryParam(&httpClientContext, "param2", "value2");
+      httpClientAddQueryParam(context, "param1", "value1");
+      httpClientAddQueryParam(context, "param2", "value2");
 
       //Add HTTP header fields
-      httpClientAddHeaderField(&httpClientContext, "User-Agent", "Mozilla/5.0");
-      httpClientAddHeaderField(&httpClientContext, "Content-Type", "text/plain");
-      httpClientAddHeaderField(&httpClientContext, "Transfer-Encoding", "chunked");
+      httpClientAddHeaderField(context, "User-Agent", "Mozilla/5.0");
+      httpClientAddHeaderField(context, "Content-Type", "application/json");
+      httpClientAddHeaderField(context, "Transfer-Encoding", "chunked");
+      httpClientAddHeaderField(context, "Accept-Encoding", "gzip, deflate");
 
       //Send HTTP request header
-      error = httpClientWriteHeader(&httpClientContext);
+      error = httpClientWriteHeader(context);
       //Any error to report?
       if(error)
       {
@@ -407,9 +868,11 @@ error_t httpClientTest(void)
          break;
       }
 
-      //Send HTTP request body
-      error = httpClientWriteBody(&httpClientContext, "Hello World!", 12,
-         NULL, 0);
+      //Send HTTP request body, one chunk each time the buffer fills up
+      vTelemetryInit(&encoder, eTelemetryJson, (uint8_t *) buffer,
+         sizeof(buffer), xTelemetryHttpFlush, context);
+      httpClientEncodeStatus(&encoder);
+      error = (xTelemetryFinish(&encoder) == pdPASS) ? NO_ERROR : ERROR_FAILURE;
       //Any error to report?
       if(error)
       {
@@ -419,7 +882,7 @@ error_t httpClientTest(void)
       }
 
       //Receive HTTP response header
-      error = httpClientReadHeader(&httpClientContext);
+      error = httpClientReadHeader(context);
       //Any error to report?
       if(error)
       {
@@ -429,12 +892,12 @@ error_t httpClientTest(void)
       }
 
       //Retrieve HTTP status code
-      status = httpClientGetStatus(&httpClientContext);
+      status = httpClientGetStatus(context);
       //Debug message
       TRACE_INFO("HTTP status code: %u\r\n", status);
 
       //Retrieve the value of the Content-Type header field
-      value = httpClientGetHeaderField(&httpClientContext, "Content-Type");
+      value = httpClientGetHeaderField(context, "Content-Type");
 
       //Header field found?
       if(value != NULL)
@@ -448,12 +911,22 @@ error_t httpClientTest(void)
          TRACE_INFO("Content-Type header field not found!\r\n");
       }
 
+      //The response body may be compressed
+      error = httpClientInflateInit(&httpInflateContext, context);
+      //Any error to report?
+      if(error)
+      {
+         //Debug message
+         TRACE_INFO("Unsupported HTTP content coding!\r\n");
+         break;
+      }
+
       //Receive HTTP response body
       while(!error)
       {
-         //Read data
-         error = httpClientReadBody(&httpClientContext, buffer,
-            sizeof(buffer) - 1, &length, 0);
+         //Read and decode data
+         error = httpClientInflateRead(&httpInflateContext, buffer,
+            sizeof(buffer) - 1, &length);
 
          //Check status code
          if(!error)
@@ -473,7 +946,7 @@ error_t httpClientTest(void)
          break;
 
       //Close HTTP response body
-      error = httpClientCloseBody(&httpClientContext);
+      error = httpClientCloseBody(context);
       //Any error to report?
       if(error)
       {
@@ -482,17 +955,11 @@ error_t httpClientTest(void)
          break;
       }
 
-      //Gracefully disconnect from the HTTP server
-      httpClientDisconnect(&httpClientContext);
-
-      //Debug message
-      TRACE_INFO("Connection closed\r\n");
-
       //End of exception handling block
    } while(0);
 
-   //Release HTTP client context
-   httpClientDeinit(&httpClientContext);
+   //Keep the connection open for the next upload unless an error occurred
+   httpClientPoolRelease(&httpClientPool, context, error == NO_ERROR);
 
    //Return status code
    return error;
@@ -562,6 +1029,12 @@ int main(void)
   HAL_Init();
 
   /* USER CODE BEGIN Init */
+  /* Backup SRAM holding the last crash dump, reset flags, fault exceptions */
+  vCrashDumpInit();
+
+  /* MPU regions of the SRAMs, then I-cache and D-cache, before any DMA runs */
+  vMemoryLayoutInit();
+  configASSERT(pdPASS == xMemoryLayoutCheck());
 
   /* USER CODE END Init */
 
@@ -569,6 +1042,18 @@ int main(void)
   SystemClock_Config();
 
   /* USER CODE BEGIN SysInit */
+  /* The D2 SRAMs hold the non-cacheable DMA region and the large TCP
+   * buffers; their clocks are off at reset */
+  __HAL_RCC_D2SRAM1_CLK_ENABLE();
+  __HAL_RCC_D2SRAM2_CLK_ENABLE();
+
+  /* Microsecond time base of the stack and of the Cyphal node, read as soon
+   * as the first task runs */
+  vMonoClockInit();
+  vBootProfileMark("clock");
+
+  /* True random numbers of the TCP/IP stack, needed from netBringUp() */
+  vHwRngInit();
 
   /* USER CODE END SysInit */
 
@@ -578,16 +1063,27 @@ int main(void)
   MX_ETH_Init();
   MX_USART3_UART_Init();
   /* USER CODE BEGIN 2 */
+  /* Bulk copies of the TCP/IP stack, from netBringUp() */
+  vMdmaCopyInit();
+  vBootProfileMark("peripherals");
+
+  /* PHY reset and auto-negotiation first, the rest of the start-up runs
+   * while the link comes up */
+  netBringUp();
 
   taskParams = OS_TASK_DEFAULT_PARAMS;
   taskParams.stackSize = 128;
   taskParams.priority = OS_TASK_PRIORITY_NORMAL+1;
+#if (APP_STATIC_ALLOCATION == 1)
+  taskParams.tcb = &xGreenLedTaskTcb;
+  taskParams.stack = xGreenLedTaskStack;
+#endif
 
   taskId = osCreateTask( "GRN", pvGreenLEDTask, NULL, &taskParams);
   //taskId = osCreateTask( "RED", pvRedLEDTask, NULL, &taskParams );
 
   BaseType_t ret;
-  ret = xTaskCreate( pvRedLEDTask, "RED", configMINIMAL_STACK_SIZE, NULL, 4, NULL );
+  ret = xAppTaskCreate( xRedLedTask, pvRedLEDTask, "RED", configMINIMAL_STACK_SIZE, NULL, 4, NULL );
   configASSERT(ret == pdPASS);
 
   //xUARTCommandConsoleStart( configUART_COMMAND_CONSOLE_STACK, 2 );
@@ -597,21 +1093,98 @@ int main(void)
 
   //xSerialPortInitMinimal(115200);
 
+  /* First: moves the vector table and indexes the records read by the
+     DHCP lease stores in initTask() */
+  xFlashStoreStart( tskIDLE_PRIORITY+1 );
+
   vSerialTaskInit( tskIDLE_PRIORITY+1, tskIDLE_PRIORITY+1 );
 
+  xDeferredLogStart( tskIDLE_PRIORITY+1 );
+
 
   xTelnetTaskStart( tskIDLE_PRIORITY+1 );
 
+  xNetStatsExportStart( tskIDLE_PRIORITY+1 );
+
+  xNetBenchStart( tskIDLE_PRIORITY+1 );
+  xNetReplayStart( tskIDLE_PRIORITY+1 );
+  xResourceMonitorStart( tskIDLE_PRIORITY+1 );
+
+  xMqttClientStart( tskIDLE_PRIORITY+1 );
+  xMqttSnClientStart( tskIDLE_PRIORITY+1 );
+
+  xModbusServerStart( tskIDLE_PRIORITY+2 );
+  xModbusClientStart( tskIDLE_PRIORITY+2 );
+  xModbusRtuGatewayStart( tskIDLE_PRIORITY+2 );
+  xCoapServerStart( tskIDLE_PRIORITY+2 );
+  xWebSocketServerStart( tskIDLE_PRIORITY+2 );
+  xHttpServerStart( tskIDLE_PRIORITY+2, xWebAssets, xWebAssetCount );
+  xSnmpAgentStart( tskIDLE_PRIORITY+1 );
+  xSntpClientStart( tskIDLE_PRIORITY+1 );
+  xPingMonitorStart( tskIDLE_PRIORITY+2 );
+  xFleetTestStart( tskIDLE_PRIORITY+2 );
+  /* Above the network tasks, so that it samples on time under load */
+  xClockGovernorStart( tskIDLE_PRIORITY+3 );
+  xTftpServerStart( tskIDLE_PRIORITY+1, &xFlashSink );
+  xPacketCaptureStart( tskIDLE_PRIORITY+1 );
+
+  xTraceRecorderStart( tskIDLE_PRIORITY+1 );
+
+  /* Above the supervised tasks, so that it sees them stall */
+  xWatchdogStart( tskIDLE_PRIORITY+3 );
+
   //vCommandConsoleInit(xSerialTaskGetRxStreamHandle(), xSerialTaskGetTxStreamHandle(), 0, 0);
-  //vCommandConsoleInit(xTelnetTaskGetRxStreamHandle(), xTelnetTaskGetTxStreamHandle(), 0, 0);
+  //vCommandConsoleInit(xTelnetTaskGetRxStreamHandle(0), xTelnetTaskGetTxStreamHandle(0), 0, 0);
 
-  vCommandConsoleDualInit(	xSerialTaskGetRxStreamHandle(),
-		  	  	  	  	  	xSerialTaskGetTxStreamHandle(),
-							xTelnetTaskGetRxStreamHandle(),
-							xTelnetTaskGetTxStreamHandle() );
+  vCommandConsoleDualInit(	xSerialTaskGetRxStreamHandle() );
+  xBatchConsoleStart( tskIDLE_PRIORITY+1 );
+  vBootProfileMark("tasks");
 
 
   vRegisterSampleCLICommands();
+  vRunTimeStatsRegisterCLICommands();
+  vRegisterNetCLICommands();
+  vNetBenchRegisterCLICommands();
+  vCyphalNodeRegisterCLICommands();
+  vCyphalServicesRegisterCLICommands();
+  vCyphalPnpRegisterCLICommands();
+  vAdcStreamRegisterCLICommands();
+  vPtpSlaveRegisterCLICommands();
+  vTcmPlacementRegisterCLICommands();
+  vTlsfHeapRegisterCLICommands();
+  vMemTagRegisterCLICommands();
+  vLowPowerRegisterCLICommands();
+  vDeferredLogRegisterCLICommands();
+  vSyslogSinkRegisterCLICommands();
+  vMqttClientRegisterCLICommands();
+  vMqttSnClientRegisterCLICommands();
+  vModbusServerRegisterCLICommands();
+  vModbusClientRegisterCLICommands();
+  vModbusRtuGatewayRegisterCLICommands();
+  vCoapServerRegisterCLICommands();
+  vWebSocketServerRegisterCLICommands();
+  vHttpServerRegisterCLICommands();
+  vSnmpAgentRegisterCLICommands();
+  vLldpAgentRegisterCLICommands();
+#if (PPP_SUPPORT == ENABLED && APP_USE_PPP == ENABLED)
+  vPppModemRegisterCLICommands();
+#endif
+  vSntpClientRegisterCLICommands();
+  vPingMonitorRegisterCLICommands();
+  vTftpServerRegisterCLICommands();
+  vPacketCaptureRegisterCLICommands();
+  vMemoryLayoutRegisterCLICommands();
+  vNetReplayRegisterCLICommands();
+  vResourceMonitorRegisterCLICommands();
+  vBootProfileRegisterCLICommands();
+  vFlashStoreRegisterCLICommands();
+  vCrashDumpRegisterCLICommands();
+  vWatchdogRegisterCLICommands();
+  vHwRngRegisterCLICommands();
+  vMdmaCopyRegisterCLICommands();
+  vMicroBenchRegisterCLICommands();
+  vFleetTestRegisterCLICommands();
+  vClockGovernorRegisterCLICommands();
 
 
 
@@ -658,6 +1231,7 @@ int main(void)
   /* USER CODE END BSP */
 
   /* Start scheduler */
+  vBootProfileMark("scheduler");
   osKernelStart();
 
   /* We should never get here as control is now taken by the scheduler */
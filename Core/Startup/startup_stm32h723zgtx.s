@@ -43,6 +43,11 @@ defined in linker script */
 .word  _sbss
 /* end address for the .bss section. defined in linker script */
 .word  _ebss
+/* load address, start and end addresses of the .itcm_text section.
+defined in linker script */
+.word  _siitcm_text
+.word  _sitcm_text
+.word  _eitcm_text
 /* stack used for SystemInit_ExtMemCtl; always internal RAM used */
 
 /**
@@ -81,6 +86,22 @@ LoopCopyDataInit:
   adds r4, r0, r3
   cmp r4, r1
   bcc CopyDataInit
+/* Copy the hot path code from its load address to the ITCM */
+  ldr r0, =_sitcm_text
+  ldr r1, =_eitcm_text
+  ldr r2, =_siitcm_text
+  movs r3, #0
+  b LoopCopyItcmInit
+
+CopyItcmInit:
+  ldr r4, [r2, r3]
+  str r4, [r0, r3]
+  adds r3, r3, #4
+
+LoopCopyItcmInit:
+  adds r4, r0, r3
+  cmp r4, r1
+  bcc CopyItcmInit
 /* Zero fill the bss segment. */
   ldr r2, =_sbss
   ldr r4, =_ebss
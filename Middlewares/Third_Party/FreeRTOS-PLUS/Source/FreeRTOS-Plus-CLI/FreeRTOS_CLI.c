@@ -45,6 +45,16 @@
     #define configAPPLICATION_PROVIDES_cOutputBuffer    0
 #endif
 
+/* Size of the command table, the help command included. */
+#ifndef configCOMMAND_INT_MAX_COMMANDS
+    #define configCOMMAND_INT_MAX_COMMANDS    64
+#endif
+
+/* Set to 1 to accept an unambiguous prefix of a command name as the command. */
+#ifndef configCOMMAND_INT_PREFIX_MATCH
+    #define configCOMMAND_INT_PREFIX_MATCH    0
+#endif
+
 /*
  * Register the command passed in using the pxCommandToRegister parameter
  * and using pxCliDefinitionListItemBuffer as the memory for command line
@@ -52,8 +62,7 @@
  * commands that are handled by the command interpreter.  Once a command
  * has been registered it can be executed from the command line.
  */
-static void prvRegisterCommand( const CLI_Command_Definition_t * const pxCommandToRegister,
-                                CLI_Definition_List_Item_t * pxCliDefinitionListItemBuffer );
+static BaseType_t prvRegisterCommand( const CLI_Command_Definition_t * const pxCommandToRegister );
 
 /*
  * The callback function that is executed when "help" is entered.  This is the
@@ -68,6 +77,21 @@ static BaseType_t prvHelpCommand( char * pcWriteBuffer,
  */
 static int8_t prvGetNumberOfParameters( const char * pcCommandString );
 
+/*
+ * Search the list of registered commands for the command in pcCommandInput.
+ * *pxParametersValid is set to pdFALSE if the command was found but has the
+ * wrong number of parameters.
+ */
+static const CLI_Command_Definition_t * prvFindCommand( const char * const pcCommandInput,
+                                                        BaseType_t * pxParametersValid );
+
+static int prvCompareName( const char * pcName,
+                           const char * pcWord,
+                           size_t xWordLength );
+
+static UBaseType_t prvLowerBound( const char * pcWord,
+                                  size_t xWordLength );
+
 /* The definition of the "help" command.  This command is always at the front
  * of the list of registered commands. */
 static const CLI_Command_Definition_t xHelpCommand =
@@ -80,11 +104,14 @@ static const CLI_Command_Definition_t xHelpCommand =
 
 /* The definition of the list of commands.  Commands that are registered are
  * added to this list. */
-static CLI_Definition_List_Item_t xRegisteredCommands =
+/* The registered commands, sorted by name so that a lookup is a binary search
+ * rather than a walk of every command.  The help command, defined in this
+ * file, is always registered. */
+static const CLI_Command_Definition_t * pxRegisteredCommands[ configCOMMAND_INT_MAX_COMMANDS ] =
 {
-    &xHelpCommand, /* The first command in the list is always the help command, defined in this file. */
-    NULL           /* The next pointer is initialised to NULL, as there are no other registered commands yet. */
+    &xHelpCommand
 };
+static UBaseType_t uxRegisteredCommands = 1;
 
 /* A buffer into which command outputs can be written is declared here, rather
 * than in the command console implementation, to allow multiple command consoles
@@ -110,23 +137,11 @@ static CLI_Definition_List_Item_t xRegisteredCommands =
 
     BaseType_t FreeRTOS_CLIRegisterCommand( const CLI_Command_Definition_t * const pxCommandToRegister )
     {
-        BaseType_t xReturn = pdFAIL;
-        CLI_Definition_List_Item_t * pxNewListItem;
-
         /* Check the parameter is not NULL. */
         configASSERT( pxCommandToRegister != NULL );
 
-        /* Create a new list item that will reference the command being registered. */
-        pxNewListItem = ( CLI_Definition_List_Item_t * ) pvPortMalloc( sizeof( CLI_Definition_List_Item_t ) );
-        configASSERT( pxNewListItem != NULL );
-
-        if( pxNewListItem != NULL )
-        {
-            prvRegisterCommand( pxCommandToRegister, pxNewListItem );
-            xReturn = pdPASS;
-        }
-
-        return xReturn;
+        /* The command table is static: nothing is allocated. */
+        return prvRegisterCommand( pxCommandToRegister );
     }
 
 #endif /* #if ( configSUPPORT_DYNAMIC_ALLOCATION == 1 ) */
@@ -137,13 +152,12 @@ static CLI_Definition_List_Item_t xRegisteredCommands =
     BaseType_t FreeRTOS_CLIRegisterCommandStatic( const CLI_Command_Definition_t * const pxCommandToRegister,
                                                   CLI_Definition_List_Item_t * pxCliDefinitionListItemBuffer )
     {
-        /* Check the parameters are not NULL. */
+        /* Check the parameter is not NULL.  The list item is no longer
+         * needed, as commands are kept in a table. */
         configASSERT( pxCommandToRegister != NULL );
-        configASSERT( pxCliDefinitionListItemBuffer != NULL );
+        ( void ) pxCliDefinitionListItemBuffer;
 
-        prvRegisterCommand( pxCommandToRegister, pxCliDefinitionListItemBuffer );
-
-        return pdPASS;
+        return prvRegisterCommand( pxCommandToRegister );
     }
 
 #endif /* #if ( configSUPPORT_STATIC_ALLOCATION == 1 ) */
@@ -153,10 +167,8 @@ BaseType_t FreeRTOS_CLIProcessCommand( const char * const pcCommandInput,
                                        char * pcWriteBuffer,
                                        size_t xWriteBufferLen )
 {
-    static const CLI_Definition_List_Item_t * pxCommand = NULL;
+    static const CLI_Command_Definition_t * pxCommand = NULL;
     BaseType_t xReturn = pdTRUE;
-    const char * pcRegisteredCommandString;
-    size_t xCommandStringLength;
 
     /* Note:  This function is not re-entrant.  It must not be called from more
      * thank one task. */
@@ -164,35 +176,7 @@ BaseType_t FreeRTOS_CLIProcessCommand( const char * const pcCommandInput,
     if( pxCommand == NULL )
     {
         /* Search for the command string in the list of registered commands. */
-        for( pxCommand = &xRegisteredCommands; pxCommand != NULL; pxCommand = pxCommand->pxNext )
-        {
-            pcRegisteredCommandString = pxCommand->pxCommandLineDefinition->pcCommand;
-            xCommandStringLength = strlen( pcRegisteredCommandString );
-
-            /* To ensure the string lengths match exactly, so as not to pick up
-             * a sub-string of a longer command, check the byte after the expected
-             * end of the string is either the end of the string or a space before
-             * a parameter. */
-            if( strncmp( pcCommandInput, pcRegisteredCommandString, xCommandStringLength ) == 0 )
-            {
-                if( ( pcCommandInput[ xCommandStringLength ] == ' ' ) || ( pcCommandInput[ xCommandStringLength ] == 0x00 ) )
-                {
-                    /* The command has been found.  Check it has the expected
-                     * number of parameters.  If cExpectedNumberOfParameters is -1,
-                     * then there could be a variable number of parameters and no
-                     * check is made. */
-                    if( pxCommand->pxCommandLineDefinition->cExpectedNumberOfParameters >= 0 )
-                    {
-                        if( prvGetNumberOfParameters( pcCommandInput ) != pxCommand->pxCommandLineDefinition->cExpectedNumberOfParameters )
-                        {
-                            xReturn = pdFALSE;
-                        }
-                    }
-
-                    break;
-                }
-            }
-        }
+        pxCommand = prvFindCommand( pcCommandInput, &xReturn );
     }
 
     if( ( pxCommand != NULL ) && ( xReturn == pdFALSE ) )
@@ -205,7 +189,7 @@ BaseType_t FreeRTOS_CLIProcessCommand( const char * const pcCommandInput,
     else if( pxCommand != NULL )
     {
         /* Call the callback function that is registered to this command. */
-        xReturn = pxCommand->pxCommandLineDefinition->pxCommandInterpreter( pcWriteBuffer, xWriteBufferLen, pcCommandInput );
+        xReturn = pxCommand->pxCommandInterpreter( pcWriteBuffer, xWriteBufferLen, pcCommandInput );
 
         /* If xReturn is pdFALSE, then no further strings will be returned
          * after this one, and	pxCommand can be reset to NULL ready to search
@@ -226,6 +210,184 @@ BaseType_t FreeRTOS_CLIProcessCommand( const char * const pcCommandInput,
 }
 /*-----------------------------------------------------------*/
 
+const CLI_Command_Definition_t * FreeRTOS_CLILookupCommand( const char * const pcCommandInput,
+                                                           char * pcWriteBuffer,
+                                                           size_t xWriteBufferLen )
+{
+    const CLI_Command_Definition_t * pxCommand;
+    BaseType_t xParametersValid = pdTRUE;
+
+    pxCommand = prvFindCommand( pcCommandInput, &xParametersValid );
+
+    if( ( pxCommand != NULL ) && ( xParametersValid == pdFALSE ) )
+    {
+        /* The command was found, but the number of parameters with the command
+         * was incorrect. */
+        strncpy( pcWriteBuffer, "Incorrect command parameter(s).  Enter \"help\" to view a list of available commands.\r\n\r\n", xWriteBufferLen );
+        pxCommand = NULL;
+    }
+    else if( pxCommand == NULL )
+    {
+        strncpy( pcWriteBuffer, "Command not recognised.  Enter 'help' to view a list of available commands.\r\n\r\n", xWriteBufferLen );
+    }
+
+    return pxCommand;
+}
+/*-----------------------------------------------------------*/
+
+const CLI_Command_Definition_t * FreeRTOS_CLIFindCommand( const char * const pcCommandInput,
+                                                         BaseType_t * pxParametersValid )
+{
+    return prvFindCommand( pcCommandInput, pxParametersValid );
+}
+/*-----------------------------------------------------------*/
+
+UBaseType_t FreeRTOS_CLICompleteCommand( const char * pcPrefix,
+                                         size_t xPrefixLength,
+                                         UBaseType_t * puxFirst,
+                                         size_t * pxCommonLength )
+{
+    UBaseType_t uxFirst;
+    UBaseType_t uxLast;
+    const char * pcFirstName;
+    const char * pcName;
+    size_t xCommon;
+
+    /* The commands starting with the prefix follow each other in the
+     * table, from the first name not sorting before the prefix. */
+    uxFirst = prvLowerBound( pcPrefix, xPrefixLength );
+
+    for( uxLast = uxFirst; uxLast < uxRegisteredCommands; uxLast++ )
+    {
+        if( strncmp( pxRegisteredCommands[ uxLast ]->pcCommand, pcPrefix, xPrefixLength ) != 0 )
+        {
+            break;
+        }
+    }
+
+    *puxFirst = uxFirst;
+    *pxCommonLength = 0;
+
+    if( uxLast == uxFirst )
+    {
+        return 0;
+    }
+
+    /* Being sorted, the first and the last matches share the prefix common
+     * to all of them. */
+    pcFirstName = pxRegisteredCommands[ uxFirst ]->pcCommand;
+    pcName = pxRegisteredCommands[ uxLast - 1 ]->pcCommand;
+
+    for( xCommon = xPrefixLength; ( pcFirstName[ xCommon ] != 0x00 ) && ( pcFirstName[ xCommon ] == pcName[ xCommon ] ); xCommon++ )
+    {
+    }
+
+    *pxCommonLength = xCommon;
+
+    return uxLast - uxFirst;
+}
+/*-----------------------------------------------------------*/
+
+const CLI_Command_Definition_t * FreeRTOS_CLIGetCommand( UBaseType_t uxIndex )
+{
+    return ( uxIndex < uxRegisteredCommands ) ? pxRegisteredCommands[ uxIndex ] : NULL;
+}
+/*-----------------------------------------------------------*/
+
+static int prvCompareName( const char * pcName,
+                           const char * pcWord,
+                           size_t xWordLength )
+{
+    int iResult = strncmp( pcName, pcWord, xWordLength );
+
+    /* The word is not nul terminated: a name it is a prefix of sorts after
+     * it. */
+    if( ( iResult == 0 ) && ( pcName[ xWordLength ] != 0x00 ) )
+    {
+        iResult = 1;
+    }
+
+    return iResult;
+}
+/*-----------------------------------------------------------*/
+
+static UBaseType_t prvLowerBound( const char * pcWord,
+                                  size_t xWordLength )
+{
+    UBaseType_t uxLow = 0;
+    UBaseType_t uxHigh = uxRegisteredCommands;
+    UBaseType_t uxMiddle;
+
+    /* Index of the first command whose name does not sort before the word. */
+    while( uxLow < uxHigh )
+    {
+        uxMiddle = ( uxLow + uxHigh ) / 2;
+
+        if( prvCompareName( pxRegisteredCommands[ uxMiddle ]->pcCommand, pcWord, xWordLength ) < 0 )
+        {
+            uxLow = uxMiddle + 1;
+        }
+        else
+        {
+            uxHigh = uxMiddle;
+        }
+    }
+
+    return uxLow;
+}
+/*-----------------------------------------------------------*/
+
+static const CLI_Command_Definition_t * prvFindCommand( const char * const pcCommandInput,
+                                                        BaseType_t * pxParametersValid )
+{
+    const CLI_Command_Definition_t * pxCommand = NULL;
+    size_t xCommandStringLength;
+    UBaseType_t uxIndex;
+
+    /* The command is the first word of the input, so as not to pick up a
+     * sub-string of a longer command. */
+    xCommandStringLength = strcspn( pcCommandInput, " " );
+
+    if( xCommandStringLength == 0 )
+    {
+        return NULL;
+    }
+
+    uxIndex = prvLowerBound( pcCommandInput, xCommandStringLength );
+
+    if( uxIndex < uxRegisteredCommands )
+    {
+        if( prvCompareName( pxRegisteredCommands[ uxIndex ]->pcCommand, pcCommandInput, xCommandStringLength ) == 0 )
+        {
+            pxCommand = pxRegisteredCommands[ uxIndex ];
+        }
+
+        #if ( configCOMMAND_INT_PREFIX_MATCH == 1 )
+            else if( ( strncmp( pxRegisteredCommands[ uxIndex ]->pcCommand, pcCommandInput, xCommandStringLength ) == 0 ) &&
+                     ( ( ( uxIndex + 1 ) >= uxRegisteredCommands ) ||
+                       ( strncmp( pxRegisteredCommands[ uxIndex + 1 ]->pcCommand, pcCommandInput, xCommandStringLength ) != 0 ) ) )
+            {
+                /* The word starts a single command name. */
+                pxCommand = pxRegisteredCommands[ uxIndex ];
+            }
+        #endif
+    }
+
+    /* The command has been found.  Check it has the expected number of
+     * parameters.  If cExpectedNumberOfParameters is -1, then there could be
+     * a variable number of parameters and no check is made. */
+    if( ( pxCommand != NULL ) && ( pxCommand->cExpectedNumberOfParameters >= 0 ) )
+    {
+        if( prvGetNumberOfParameters( pcCommandInput ) != pxCommand->cExpectedNumberOfParameters )
+        {
+            *pxParametersValid = pdFALSE;
+        }
+    }
+
+    return pxCommand;
+}
+/*-----------------------------------------------------------*/
+
 char * FreeRTOS_CLIGetOutputBuffer( void )
 {
     return cOutputBuffer;
@@ -291,33 +453,36 @@ const char * FreeRTOS_CLIGetParameter( const char * pcCommandString,
 }
 /*-----------------------------------------------------------*/
 
-static void prvRegisterCommand( const CLI_Command_Definition_t * const pxCommandToRegister,
-                                CLI_Definition_List_Item_t * pxCliDefinitionListItemBuffer )
+static BaseType_t prvRegisterCommand( const CLI_Command_Definition_t * const pxCommandToRegister )
 {
-    static CLI_Definition_List_Item_t * pxLastCommandInList = &xRegisteredCommands;
-
-    /* Check the parameters are not NULL. */
-    configASSERT( pxCommandToRegister != NULL );
-    configASSERT( pxCliDefinitionListItemBuffer != NULL );
+    BaseType_t xReturn = pdFAIL;
+    UBaseType_t uxIndex;
+    const char * pcName = pxCommandToRegister->pcCommand;
 
     taskENTER_CRITICAL();
     {
-        /* Reference the command being registered from the newly created
-         * list item. */
-        pxCliDefinitionListItemBuffer->pxCommandLineDefinition = pxCommandToRegister;
-
-        /* The new list item will get added to the end of the list, so
-         * pxNext has nowhere to point. */
-        pxCliDefinitionListItemBuffer->pxNext = NULL;
-
-        /* Add the newly created list item to the end of the already existing
-         * list. */
-        pxLastCommandInList->pxNext = pxCliDefinitionListItemBuffer;
+        /* Insert the command at its place in the table; commands are
+         * registered at start up, so the cost of moving the entries after it
+         * is paid once rather than on every lookup. */
+        uxIndex = prvLowerBound( pcName, strlen( pcName ) );
 
-        /* Set the end of list marker to the new list item. */
-        pxLastCommandInList = pxCliDefinitionListItemBuffer;
+        if( ( uxRegisteredCommands < configCOMMAND_INT_MAX_COMMANDS ) &&
+            ( ( uxIndex >= uxRegisteredCommands ) || ( strcmp( pxRegisteredCommands[ uxIndex ]->pcCommand, pcName ) != 0 ) ) )
+        {
+            memmove( &pxRegisteredCommands[ uxIndex + 1 ], &pxRegisteredCommands[ uxIndex ],
+                     ( uxRegisteredCommands - uxIndex ) * sizeof( pxRegisteredCommands[ 0 ] ) );
+            pxRegisteredCommands[ uxIndex ] = pxCommandToRegister;
+            uxRegisteredCommands++;
+            xReturn = pdPASS;
+        }
     }
     taskEXIT_CRITICAL();
+
+    /* The table is full (raise configCOMMAND_INT_MAX_COMMANDS), or a command
+     * of that name is already registered. */
+    configASSERT( xReturn == pdPASS );
+
+    return xReturn;
 }
 /*-----------------------------------------------------------*/
 
@@ -325,24 +490,20 @@ static BaseType_t prvHelpCommand( char * pcWriteBuffer,
                                   size_t xWriteBufferLen,
                                   const char * pcCommandString )
 {
-    static const CLI_Definition_List_Item_t * pxCommand = NULL;
+    static UBaseType_t uxCommand = 0;
     BaseType_t xReturn;
 
     ( void ) pcCommandString;
 
-    if( pxCommand == NULL )
-    {
-        /* Reset the pxCommand pointer back to the start of the list. */
-        pxCommand = &xRegisteredCommands;
-    }
-
-    /* Return the next command help string, before moving the pointer on to
-     * the next command in the list. */
-    strncpy( pcWriteBuffer, pxCommand->pxCommandLineDefinition->pcHelpString, xWriteBufferLen );
-    pxCommand = pxCommand->pxNext;
+    /* Return the next command help string, in name order, before moving the
+     * index on to the next command in the table. */
+    strncpy( pcWriteBuffer, pxRegisteredCommands[ uxCommand ]->pcHelpString, xWriteBufferLen );
+    uxCommand++;
 
-    if( pxCommand == NULL )
+    if( uxCommand >= uxRegisteredCommands )
     {
+        uxCommand = 0;
+
         /* There are no more commands in the list, so there will be no more
          *  strings to return after this one and pdFALSE should be returned. */
         xReturn = pdFALSE;
@@ -64,17 +64,21 @@ typedef struct xCOMMAND_INPUT_LIST
 
 /*
  * Register the command passed in using the pxCommandToRegister parameter.
- * Registering a command adds the command to the list of commands that are
+ * Registering a command adds the command to the table of commands that are
  * handled by the command interpreter.  Once a command has been registered it
  * can be executed from the command line.
+ *
+ * The table holds up to configCOMMAND_INT_MAX_COMMANDS commands, sorted by
+ * name; pdFAIL is returned when it is full or when a command of the same name
+ * is already registered.
  */
 #if ( configSUPPORT_DYNAMIC_ALLOCATION == 1 )
     BaseType_t FreeRTOS_CLIRegisterCommand( const CLI_Command_Definition_t * const pxCommandToRegister );
 #endif
 
 /*
- * Static version of the above function which allows the application writer
- * to supply the memory used for a command line list entry.
+ * Static version of the above function.  The command table is static in any
+ * case, so pxCliDefinitionListItemBuffer is not used.
  */
 #if ( configSUPPORT_STATIC_ALLOCATION == 1 )
     BaseType_t FreeRTOS_CLIRegisterCommandStatic( const CLI_Command_Definition_t * const pxCommandToRegister,
@@ -96,6 +100,51 @@ BaseType_t FreeRTOS_CLIProcessCommand( const char * const pcCommandInput,
                                        char * pcWriteBuffer,
                                        size_t xWriteBufferLen );
 
+/*
+ * Look up the command in "pcCommandInput" without executing it.  Returns the
+ * command definition, or NULL if the command is not registered or was given
+ * the wrong number of parameters, in which case an error message is placed
+ * into pcWriteBuffer.
+ *
+ * Unlike FreeRTOS_CLIProcessCommand(), this keeps no state between calls:
+ * the caller invokes pxCommandInterpreter itself until it returns pdFALSE,
+ * so several tasks may execute commands at the same time.  Lookups must
+ * still not run concurrently with command registration.
+ */
+const CLI_Command_Definition_t * FreeRTOS_CLILookupCommand( const char * const pcCommandInput,
+                                                           char * pcWriteBuffer,
+                                                           size_t xWriteBufferLen );
+
+/*
+ * Same lookup without any message: NULL if the command is not registered, and
+ * *pxParametersValid set to pdFALSE (left untouched otherwise) if it was given
+ * the wrong number of parameters.  For callers reporting errors their own way.
+ */
+const CLI_Command_Definition_t * FreeRTOS_CLIFindCommand( const char * const pcCommandInput,
+                                                         BaseType_t * pxParametersValid );
+
+/*
+ * With configCOMMAND_INT_PREFIX_MATCH set to 1, both lookups also accept the
+ * beginning of a command name that no other command starts with.
+ */
+
+/*
+ * Find the commands whose name starts with the xPrefixLength characters of
+ * pcPrefix, for command completion.  Returns their number; they are the
+ * commands at indexes *puxFirst onwards of FreeRTOS_CLIGetCommand(), and
+ * *pxCommonLength is set to the length of the beginning their names share.
+ */
+UBaseType_t FreeRTOS_CLICompleteCommand( const char * pcPrefix,
+                                         size_t xPrefixLength,
+                                         UBaseType_t * puxFirst,
+                                         size_t * pxCommonLength );
+
+/*
+ * Return the uxIndex'th registered command in name order, or NULL past the
+ * last one.
+ */
+const CLI_Command_Definition_t * FreeRTOS_CLIGetCommand( UBaseType_t uxIndex );
+
 /*-----------------------------------------------------------*/
 
 /*
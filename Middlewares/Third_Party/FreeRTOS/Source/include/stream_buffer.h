@@ -833,6 +833,102 @@ BaseType_t xStreamBufferReceiveCompletedFromISR( StreamBufferHandle_t xStreamBuf
  */
 BaseType_t xStreamBufferReceiveCompletedFromISR( StreamBufferHandle_t xStreamBuffer, BaseType_t *pxHigherPriorityTaskWoken ) PRIVILEGED_FUNCTION;
 
+/**
+ * stream_buffer.h
+ *
+<pre>
+size_t xStreamBufferSendReserve( StreamBufferHandle_t xStreamBuffer,
+                                 uint8_t **ppucSpace,
+                                 TickType_t xTicksToWait );
+size_t xStreamBufferSendCommit( StreamBufferHandle_t xStreamBuffer,
+                                size_t xDataLengthBytes );
+</pre>
+ *
+ * Writes to a stream buffer in place, without copying the data through a
+ * buffer of the writer: xStreamBufferSendReserve() returns the free space
+ * that follows the data in the buffer storage, the writer produces its data
+ * there, then xStreamBufferSendCommit() adds the bytes written to the stream
+ * and unblocks a task waiting for them as xStreamBufferSend() does.
+ *
+ * The space returned is contiguous, so it may stop at the end of the storage
+ * area while more space is free at its beginning: that space is returned by
+ * the next reservation, once the first has been committed.
+ *
+ * As with xStreamBufferSend(), there must be a single writer, and it must
+ * be a task. Not for message buffers.
+ *
+ * @param xStreamBuffer The handle of the stream buffer being written.
+ *
+ * @param ppucSpace Set to the start of the free space.
+ *
+ * @param xTicksToWait The maximum time the task should wait in the Blocked
+ * state for the stream buffer to have free space.
+ *
+ * @param xDataLengthBytes The number of bytes written into the space, at
+ * most the size returned by the last reservation.
+ *
+ * @return xStreamBufferSendReserve() returns the size of the space, 0 if the
+ * stream buffer stayed full. xStreamBufferSendCommit() returns the number of
+ * bytes added to the stream.
+ *
+ * \defgroup xStreamBufferSendReserve xStreamBufferSendReserve
+ * \ingroup StreamBufferManagement
+ */
+size_t xStreamBufferSendReserve( StreamBufferHandle_t xStreamBuffer,
+								 uint8_t **ppucSpace,
+								 TickType_t xTicksToWait ) PRIVILEGED_FUNCTION;
+
+size_t xStreamBufferSendCommit( StreamBufferHandle_t xStreamBuffer,
+								size_t xDataLengthBytes ) PRIVILEGED_FUNCTION;
+
+/**
+ * stream_buffer.h
+ *
+<pre>
+size_t xStreamBufferReceivePeek( StreamBufferHandle_t xStreamBuffer,
+                                 uint8_t **ppucData,
+                                 TickType_t xTicksToWait );
+size_t xStreamBufferReceiveConsume( StreamBufferHandle_t xStreamBuffer,
+                                    size_t xDataLengthBytes );
+</pre>
+ *
+ * Reads from a stream buffer in place, without copying the data out:
+ * xStreamBufferReceivePeek() returns the data at the front of the stream
+ * where it is stored, the reader processes it there, then
+ * xStreamBufferReceiveConsume() removes the bytes processed from the stream
+ * and unblocks a task waiting for space as xStreamBufferReceive() does.
+ *
+ * The data returned is contiguous, so it may stop at the end of the storage
+ * area while the stream goes on at its beginning: the rest is returned by
+ * the next peek, once the first part has been consumed.
+ *
+ * As with xStreamBufferReceive(), there must be a single reader, and it
+ * must be a task. Not for message buffers.
+ *
+ * @param xStreamBuffer The handle of the stream buffer being read.
+ *
+ * @param ppucData Set to the start of the data.
+ *
+ * @param xTicksToWait The maximum time the task should wait in the Blocked
+ * state for data, up to the trigger level as for xStreamBufferReceive().
+ *
+ * @param xDataLengthBytes The number of bytes to remove, at most the size
+ * returned by the last peek.
+ *
+ * @return xStreamBufferReceivePeek() returns the number of bytes at
+ * *ppucData, 0 if the stream buffer stayed empty.
+ * xStreamBufferReceiveConsume() returns the number of bytes removed.
+ *
+ * \defgroup xStreamBufferReceivePeek xStreamBufferReceivePeek
+ * \ingroup StreamBufferManagement
+ */
+size_t xStreamBufferReceivePeek( StreamBufferHandle_t xStreamBuffer,
+								 uint8_t **ppucData,
+								 TickType_t xTicksToWait ) PRIVILEGED_FUNCTION;
+
+size_t xStreamBufferReceiveConsume( StreamBufferHandle_t xStreamBuffer,
+									size_t xDataLengthBytes ) PRIVILEGED_FUNCTION;
+
 /* Functions below here are not part of the public API. */
 StreamBufferHandle_t xStreamBufferGenericCreate( size_t xBufferSizeBytes,
 												 size_t xTriggerLevelBytes,
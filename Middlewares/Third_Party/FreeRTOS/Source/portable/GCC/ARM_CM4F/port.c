@@ -697,6 +697,41 @@ __attribute__(( weak )) void vPortSetupTimerInterrupt( void )
 }
 /*-----------------------------------------------------------*/
 
+void vPortRetimeTickInterrupt( void )
+{
+uint32_t ulCountsForOneTick, ulRemaining, ulLoad, ulFirst;
+
+	ulCountsForOneTick = ( configSYSTICK_CLOCK_HZ / configTICK_RATE_HZ );
+
+	#if( configUSE_TICKLESS_IDLE == 1 )
+	{
+		ulTimerCountsForOneTick = ulCountsForOneTick;
+		xMaximumPossibleSuppressedTicks = portMAX_24_BIT_NUMBER / ulTimerCountsForOneTick;
+		ulStoppedTimerCompensation = portMISSED_COUNTS_FACTOR / ( configCPU_CLOCK_HZ / configSYSTICK_CLOCK_HZ );
+	}
+	#endif /* configUSE_TICKLESS_IDLE */
+
+	/* What is left of the current tick period, in counts of the new clock. */
+	ulLoad = portNVIC_SYSTICK_LOAD_REG + 1UL;
+	ulRemaining = portNVIC_SYSTICK_CURRENT_VALUE_REG;
+	ulFirst = ( uint32_t ) ( ( ( uint64_t ) ulRemaining * ulCountsForOneTick ) / ulLoad );
+	if( ulFirst < 2UL )
+	{
+		ulFirst = 2UL;
+	}
+
+	/* Clearing the current value reloads the counter on its next clock,
+	without an interrupt.  The full period is only loaded once that reload
+	has happened, to apply from the next tick on. */
+	portNVIC_SYSTICK_LOAD_REG = ulFirst - 1UL;
+	portNVIC_SYSTICK_CURRENT_VALUE_REG = 0UL;
+	while( portNVIC_SYSTICK_CURRENT_VALUE_REG == 0UL )
+	{
+	}
+	portNVIC_SYSTICK_LOAD_REG = ulCountsForOneTick - 1UL;
+}
+/*-----------------------------------------------------------*/
+
 /* This is a naked function. */
 static void vPortEnableVFP( void )
 {
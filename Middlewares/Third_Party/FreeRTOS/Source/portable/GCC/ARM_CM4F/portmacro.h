@@ -117,6 +117,11 @@ not necessary for to use this port.  They are defined so the common demo files
 	extern void vPortSuppressTicksAndSleep( TickType_t xExpectedIdleTime );
 	#define portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime ) vPortSuppressTicksAndSleep( xExpectedIdleTime )
 #endif
+
+/* Follow a change of the core clock: the SysTick reload is derived again
+from configSYSTICK_CLOCK_HZ, keeping the phase of the current tick.  To be
+called with interrupts disabled. */
+extern void vPortRetimeTickInterrupt( void );
 /*-----------------------------------------------------------*/
 
 /* Architecture specific optimisations. */
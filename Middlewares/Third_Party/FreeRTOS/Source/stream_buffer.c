@@ -1085,6 +1085,228 @@ UBaseType_t uxSavedInterruptStatus;
 }
 /*-----------------------------------------------------------*/
 
+size_t xStreamBufferSendReserve( StreamBufferHandle_t xStreamBuffer,
+								 uint8_t **ppucSpace,
+								 TickType_t xTicksToWait )
+{
+StreamBuffer_t * const pxStreamBuffer = xStreamBuffer;
+size_t xSpace, xHead, xTail;
+TimeOut_t xTimeOut;
+
+	configASSERT( ppucSpace );
+	configASSERT( pxStreamBuffer );
+	configASSERT( ( pxStreamBuffer->ucFlags & sbFLAGS_IS_MESSAGE_BUFFER ) == ( uint8_t ) 0 );
+
+	if( xTicksToWait != ( TickType_t ) 0 )
+	{
+		vTaskSetTimeOutState( &xTimeOut );
+
+		do
+		{
+			/* Wait until at least one byte is free, as xStreamBufferSend()
+			does for the whole of its data. */
+			taskENTER_CRITICAL();
+			{
+				if( xStreamBufferSpacesAvailable( pxStreamBuffer ) == ( size_t ) 0 )
+				{
+					( void ) xTaskNotifyStateClear( NULL );
+					configASSERT( pxStreamBuffer->xTaskWaitingToSend == NULL );
+					pxStreamBuffer->xTaskWaitingToSend = xTaskGetCurrentTaskHandle();
+				}
+				else
+				{
+					taskEXIT_CRITICAL();
+					break;
+				}
+			}
+			taskEXIT_CRITICAL();
+
+			traceBLOCKING_ON_STREAM_BUFFER_SEND( xStreamBuffer );
+			( void ) xTaskNotifyWait( ( uint32_t ) 0, ( uint32_t ) 0, NULL, xTicksToWait );
+			pxStreamBuffer->xTaskWaitingToSend = NULL;
+
+		} while( xTaskCheckForTimeOut( &xTimeOut, &xTicksToWait ) == pdFALSE );
+	}
+	else
+	{
+		mtCOVERAGE_TEST_MARKER();
+	}
+
+	/* The free bytes from the head up to the tail or the end of the storage,
+	leaving out the byte before the tail that tells a full buffer from an
+	empty one. */
+	xHead = pxStreamBuffer->xHead;
+	xTail = pxStreamBuffer->xTail;
+	if( xTail > xHead )
+	{
+		xSpace = xTail - xHead - ( size_t ) 1;
+	}
+	else
+	{
+		xSpace = pxStreamBuffer->xLength - xHead;
+		if( xTail == ( size_t ) 0 )
+		{
+			xSpace -= ( size_t ) 1;
+		}
+		else
+		{
+			mtCOVERAGE_TEST_MARKER();
+		}
+	}
+
+	*ppucSpace = &( pxStreamBuffer->pucBuffer[ xHead ] );
+
+	return xSpace;
+}
+/*-----------------------------------------------------------*/
+
+size_t xStreamBufferSendCommit( StreamBufferHandle_t xStreamBuffer,
+								size_t xDataLengthBytes )
+{
+StreamBuffer_t * const pxStreamBuffer = xStreamBuffer;
+size_t xNextHead;
+
+	configASSERT( pxStreamBuffer );
+	configASSERT( xDataLengthBytes <= xStreamBufferSpacesAvailable( pxStreamBuffer ) );
+
+	if( xDataLengthBytes > ( size_t ) 0 )
+	{
+		xNextHead = pxStreamBuffer->xHead + xDataLengthBytes;
+		configASSERT( xNextHead <= pxStreamBuffer->xLength );
+		if( xNextHead >= pxStreamBuffer->xLength )
+		{
+			xNextHead -= pxStreamBuffer->xLength;
+		}
+		else
+		{
+			mtCOVERAGE_TEST_MARKER();
+		}
+
+		/* The data must be in the storage before the reader can see it. */
+		portMEMORY_BARRIER();
+		pxStreamBuffer->xHead = xNextHead;
+
+		traceSTREAM_BUFFER_SEND( xStreamBuffer, xDataLengthBytes );
+
+		/* Was a task waiting for the data? */
+		if( prvBytesInBuffer( pxStreamBuffer ) >= pxStreamBuffer->xTriggerLevelBytes )
+		{
+			sbSEND_COMPLETED( pxStreamBuffer );
+		}
+		else
+		{
+			mtCOVERAGE_TEST_MARKER();
+		}
+	}
+	else
+	{
+		mtCOVERAGE_TEST_MARKER();
+	}
+
+	return xDataLengthBytes;
+}
+/*-----------------------------------------------------------*/
+
+size_t xStreamBufferReceivePeek( StreamBufferHandle_t xStreamBuffer,
+								 uint8_t **ppucData,
+								 TickType_t xTicksToWait )
+{
+StreamBuffer_t * const pxStreamBuffer = xStreamBuffer;
+size_t xBytesAvailable, xTail;
+
+	configASSERT( ppucData );
+	configASSERT( pxStreamBuffer );
+	configASSERT( ( pxStreamBuffer->ucFlags & sbFLAGS_IS_MESSAGE_BUFFER ) == ( uint8_t ) 0 );
+
+	if( xTicksToWait != ( TickType_t ) 0 )
+	{
+		/* Checking if there is data and clearing the notification state must be
+		performed atomically. */
+		taskENTER_CRITICAL();
+		{
+			xBytesAvailable = prvBytesInBuffer( pxStreamBuffer );
+
+			if( xBytesAvailable == ( size_t ) 0 )
+			{
+				( void ) xTaskNotifyStateClear( NULL );
+				configASSERT( pxStreamBuffer->xTaskWaitingToReceive == NULL );
+				pxStreamBuffer->xTaskWaitingToReceive = xTaskGetCurrentTaskHandle();
+			}
+			else
+			{
+				mtCOVERAGE_TEST_MARKER();
+			}
+		}
+		taskEXIT_CRITICAL();
+
+		if( xBytesAvailable == ( size_t ) 0 )
+		{
+			traceBLOCKING_ON_STREAM_BUFFER_RECEIVE( xStreamBuffer );
+			( void ) xTaskNotifyWait( ( uint32_t ) 0, ( uint32_t ) 0, NULL, xTicksToWait );
+			pxStreamBuffer->xTaskWaitingToReceive = NULL;
+
+			xBytesAvailable = prvBytesInBuffer( pxStreamBuffer );
+		}
+		else
+		{
+			mtCOVERAGE_TEST_MARKER();
+		}
+	}
+	else
+	{
+		xBytesAvailable = prvBytesInBuffer( pxStreamBuffer );
+	}
+
+	/* The data from the tail up to the head or the end of the storage. */
+	xTail = pxStreamBuffer->xTail;
+	xBytesAvailable = configMIN( xBytesAvailable, pxStreamBuffer->xLength - xTail );
+
+	/* The data is read after the head that covers it. */
+	portMEMORY_BARRIER();
+	*ppucData = &( pxStreamBuffer->pucBuffer[ xTail ] );
+
+	return xBytesAvailable;
+}
+/*-----------------------------------------------------------*/
+
+size_t xStreamBufferReceiveConsume( StreamBufferHandle_t xStreamBuffer,
+									size_t xDataLengthBytes )
+{
+StreamBuffer_t * const pxStreamBuffer = xStreamBuffer;
+size_t xNextTail;
+
+	configASSERT( pxStreamBuffer );
+	configASSERT( xDataLengthBytes <= prvBytesInBuffer( pxStreamBuffer ) );
+
+	if( xDataLengthBytes > ( size_t ) 0 )
+	{
+		xNextTail = pxStreamBuffer->xTail + xDataLengthBytes;
+		configASSERT( xNextTail <= pxStreamBuffer->xLength );
+		if( xNextTail >= pxStreamBuffer->xLength )
+		{
+			xNextTail -= pxStreamBuffer->xLength;
+		}
+		else
+		{
+			mtCOVERAGE_TEST_MARKER();
+		}
+
+		/* The reader is done with the data before the writer reuses it. */
+		portMEMORY_BARRIER();
+		pxStreamBuffer->xTail = xNextTail;
+
+		traceSTREAM_BUFFER_RECEIVE( xStreamBuffer, xDataLengthBytes );
+		sbRECEIVE_COMPLETED( pxStreamBuffer );
+	}
+	else
+	{
+		mtCOVERAGE_TEST_MARKER();
+	}
+
+	return xDataLengthBytes;
+}
+/*-----------------------------------------------------------*/
+
 static size_t prvWriteBytesToBuffer( StreamBuffer_t * const pxStreamBuffer, const uint8_t *pucData, size_t xCount )
 {
 size_t xNextHead, xFirstLength;
@@ -161,6 +161,146 @@ const char_t *formatDate(const DateTime *date, char_t *str)
 }
 
 
+/**
+ * @brief Write a number as a fixed count of decimal digits
+ * @param[out] str Output buffer
+ * @param[in] value Number to write
+ * @param[in] n Number of digits, leading zeros included
+ **/
+
+static void formatDigits(char_t *str, uint32_t value, uint_t n)
+{
+   //Least significant digit first
+   while(n-- > 0)
+   {
+      str[n] = '0' + (value % 10);
+      value /= 10;
+   }
+}
+
+
+/**
+ * @brief Initialize a timestamp cache
+ * @param[out] cache Cache to initialize
+ **/
+
+void initDateTimeCache(DateTimeCache *cache)
+{
+   //Nothing cached yet
+   cache->day = -1;
+   cache->second = -1;
+   cache->date[0] = '\0';
+   cache->time[0] = '\0';
+}
+
+
+/**
+ * @brief Format a timestamp, reusing the parts of the previous one
+ *
+ * The calendar arithmetic only runs when the day changes and the time of
+ * day is only split when the second changes, so that formatting the time of
+ * every log line costs a few divisions
+ *
+ * @param[in,out] cache Parts of the previous timestamp
+ * @param[in] unixTimeUs Microseconds since January 1st, 1970
+ * @param[in] format Timestamp format
+ * @param[in] digits Digits of the fraction of second (0 to 6)
+ * @param[out] str Output buffer of DATE_TIME_TIMESTAMP_SIZE bytes
+ * @return Length of the timestamp, terminating NULL excluded
+ **/
+
+size_t formatTimestamp(DateTimeCache *cache, uint64_t unixTimeUs,
+   DateTimeFormat format, uint_t digits, char_t *str)
+{
+   time_t t;
+   int32_t day;
+   uint32_t secondOfDay;
+   uint32_t fraction;
+   uint_t i;
+   size_t n;
+   DateTime date;
+
+   //Microseconds is the resolution of the input
+   digits = MIN(digits, 6);
+
+   //Split the timestamp
+   t = (time_t) (unixTimeUs / 1000000);
+   fraction = (uint32_t) (unixTimeUs % 1000000);
+   day = (int32_t) (t / 86400);
+
+   //New day?
+   if(day != cache->day)
+   {
+      //Convert Unix timestamp to date
+      convertUnixTimeToDate((time_t) day * 86400, &date);
+
+      //Format the date once for the whole day
+      formatDigits(cache->date, MIN(date.year, 9999), 4);
+      cache->date[4] = '-';
+      formatDigits(cache->date + 5, date.month, 2);
+      cache->date[7] = '-';
+      formatDigits(cache->date + 8, date.day, 2);
+      cache->date[10] = '\0';
+
+      cache->day = day;
+   }
+
+   //New second?
+   if(t != cache->second)
+   {
+      secondOfDay = (uint32_t) (t - (time_t) day * 86400);
+
+      //Format the time of day once for the whole second
+      formatDigits(cache->time, secondOfDay / 3600, 2);
+      cache->time[2] = ':';
+      formatDigits(cache->time + 3, (secondOfDay / 60) % 60, 2);
+      cache->time[5] = ':';
+      formatDigits(cache->time + 6, secondOfDay % 60, 2);
+      cache->time[8] = '\0';
+
+      cache->second = t;
+   }
+
+   n = 0;
+
+   //The date is omitted from the time of day
+   if(format != DATE_TIME_FORMAT_TIME_OF_DAY)
+   {
+      osMemcpy(str, cache->date, 10);
+      str[10] = 'T';
+      n = 11;
+   }
+
+   osMemcpy(str + n, cache->time, 8);
+   n += 8;
+
+   //Fraction of second, truncated to the requested digits
+   if(digits > 0)
+   {
+      for(i = digits; i < 6; i++)
+      {
+         fraction /= 10;
+      }
+
+      str[n++] = '.';
+      formatDigits(str + n, fraction, digits);
+      n += digits;
+   }
+
+   //Both ISO 8601 and RFC 5424 timestamps are given in UTC
+   if(format != DATE_TIME_FORMAT_TIME_OF_DAY)
+   {
+      str[n++] = 'Z';
+   }
+
+   //Properly terminate the string with a NULL character
+   str[n] = '\0';
+
+   //Return the length of the timestamp
+   return n;
+}
+
+
 /**
  * @brief Get current date and time
  * @param[out] date Pointer to a structure representing the date and time
@@ -56,10 +56,47 @@ typedef struct
 } DateTime;
 
 
+//Size of the buffer of formatTimestamp, terminating NULL included
+#define DATE_TIME_TIMESTAMP_SIZE 32
+
+
+/**
+ * @brief Timestamp formats
+ **/
+
+typedef enum
+{
+   DATE_TIME_FORMAT_ISO8601     = 0, ///<2025-01-31T23:59:59.123456Z
+   DATE_TIME_FORMAT_RFC5424     = 1, ///<Syslog TIMESTAMP (RFC 3339 profile of ISO 8601)
+   DATE_TIME_FORMAT_TIME_OF_DAY = 2  ///<23:59:59.123456
+} DateTimeFormat;
+
+
+/**
+ * @brief Cached parts of the last formatted timestamp
+ *
+ * The date is computed again only when the day changes, and the time of
+ * day only when the second changes. A cache belongs to one caller
+ **/
+
+typedef struct
+{
+   int32_t day;      ///<Day of the cached date, since 1970 (-1 if none)
+   time_t second;    ///<Second of the cached time of day
+   char_t date[11];  ///<YYYY-MM-DD
+   char_t time[9];   ///<HH:MM:SS
+} DateTimeCache;
+
+
 //Date and time management
 const char_t *formatSystemTime(systime_t time, char_t *str);
 const char_t *formatDate(const DateTime *date, char_t *str);
 
+void initDateTimeCache(DateTimeCache *cache);
+
+size_t formatTimestamp(DateTimeCache *cache, uint64_t unixTimeUs,
+   DateTimeFormat format, uint_t digits, char_t *str);
+
 void getCurrentDate(DateTime *date);
 time_t getCurrentUnixTime(void);
 
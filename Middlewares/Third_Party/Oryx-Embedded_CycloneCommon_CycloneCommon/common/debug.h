@@ -52,6 +52,11 @@
    #define TRACE_PRINTF(...) osSuspendAllTasks(), fprintf(stderr, __VA_ARGS__), osResumeAllTasks()
 #endif
 
+//Output of a message of a given level
+#ifndef TRACE_PRINTF_LEVEL
+   #define TRACE_PRINTF_LEVEL(level, ...) TRACE_PRINTF(__VA_ARGS__)
+#endif
+
 #ifndef TRACE_ARRAY
    #define TRACE_ARRAY(p, a, n) osSuspendAllTasks(), debugDisplayArray(stderr, p, a, n), osResumeAllTasks()
 #endif
@@ -66,7 +71,7 @@
 
 //Debugging macros
 #if (TRACE_LEVEL >= TRACE_LEVEL_FATAL)
-   #define TRACE_FATAL(...) TRACE_PRINTF(__VA_ARGS__)
+   #define TRACE_FATAL(...) TRACE_PRINTF_LEVEL(TRACE_LEVEL_FATAL, __VA_ARGS__)
    #define TRACE_FATAL_ARRAY(p, a, n) TRACE_ARRAY(p, a, n)
    #define TRACE_FATAL_MPI(p, a) TRACE_MPI(p, a)
    #define TRACE_FATAL_EC_SCALAR(p, a, n) TRACE_EC_SCALAR(p, a, n)
@@ -78,7 +83,7 @@
 #endif
 
 #if (TRACE_LEVEL >= TRACE_LEVEL_ERROR)
-   #define TRACE_ERROR(...) TRACE_PRINTF(__VA_ARGS__)
+   #define TRACE_ERROR(...) TRACE_PRINTF_LEVEL(TRACE_LEVEL_ERROR, __VA_ARGS__)
    #define TRACE_ERROR_ARRAY(p, a, n) TRACE_ARRAY(p, a, n)
    #define TRACE_ERROR_MPI(p, a) TRACE_MPI(p, a)
    #define TRACE_ERROR_EC_SCALAR(p, a, n) TRACE_EC_SCALAR(p, a, n)
@@ -90,7 +95,7 @@
 #endif
 
 #if (TRACE_LEVEL >= TRACE_LEVEL_WARNING)
-   #define TRACE_WARNING(...) TRACE_PRINTF(__VA_ARGS__)
+   #define TRACE_WARNING(...) TRACE_PRINTF_LEVEL(TRACE_LEVEL_WARNING, __VA_ARGS__)
    #define TRACE_WARNING_ARRAY(p, a, n) TRACE_ARRAY(p, a, n)
    #define TRACE_WARNING_MPI(p, a) TRACE_MPI(p, a)
    #define TRACE_WARNING_EC_SCALAR(p, a, n) TRACE_EC_SCALAR(p, a, n)
@@ -102,7 +107,7 @@
 #endif
 
 #if (TRACE_LEVEL >= TRACE_LEVEL_INFO)
-   #define TRACE_INFO(...) TRACE_PRINTF(__VA_ARGS__)
+   #define TRACE_INFO(...) TRACE_PRINTF_LEVEL(TRACE_LEVEL_INFO, __VA_ARGS__)
    #define TRACE_INFO_ARRAY(p, a, n) TRACE_ARRAY(p, a, n)
    #define TRACE_INFO_NET_BUFFER(p, b, o, n)
    #define TRACE_INFO_MPI(p, a) TRACE_MPI(p, a)
@@ -116,7 +121,7 @@
 #endif
 
 #if (TRACE_LEVEL >= TRACE_LEVEL_DEBUG)
-   #define TRACE_DEBUG(...) TRACE_PRINTF(__VA_ARGS__)
+   #define TRACE_DEBUG(...) TRACE_PRINTF_LEVEL(TRACE_LEVEL_DEBUG, __VA_ARGS__)
    #define TRACE_DEBUG_ARRAY(p, a, n) TRACE_ARRAY(p, a, n)
    #define TRACE_DEBUG_NET_BUFFER(p, b, o, n)
    #define TRACE_DEBUG_MPI(p, a) TRACE_MPI(p, a)
@@ -130,7 +135,7 @@
 #endif
 
 #if (TRACE_LEVEL >= TRACE_LEVEL_VERBOSE)
-   #define TRACE_VERBOSE(...) TRACE_PRINTF(__VA_ARGS__)
+   #define TRACE_VERBOSE(...) TRACE_PRINTF_LEVEL(TRACE_LEVEL_VERBOSE, __VA_ARGS__)
    #define TRACE_VERBOSE_ARRAY(p, a, n) TRACE_ARRAY(p, a, n)
    #define TRACE_VERBOSE_NET_BUFFER(p, b, o, n)
    #define TRACE_VERBOSE_MPI(p, a) TRACE_MPI(p, a)
@@ -132,6 +132,11 @@
    #include "os_port_custom.h"
 #endif
 
+//Mutex statistics are only provided by some ports
+#ifndef OS_MUTEX_STATS_SUPPORT
+   #define OS_MUTEX_STATS_SUPPORT DISABLED
+#endif
+
 //Fill block of memory
 #ifndef osMemset
    #include <string.h>
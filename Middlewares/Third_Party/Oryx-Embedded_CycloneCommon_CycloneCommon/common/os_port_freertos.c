@@ -185,6 +185,307 @@ void osResumeAllTasks(void)
 }
 
 
+#if (OS_EVENT_TASK_NOTIFY_SUPPORT == ENABLED)
+
+/**
+ * @brief Create an event object
+ *
+ * The task blocked on the event waits on its own notification, which the
+ * setter gives directly, without any kernel object. A semaphore is only
+ * created when a second task waits on the event while the first one is
+ * still blocked
+ *
+ * @param[in] event Pointer to the event object
+ * @return The function returns TRUE if the event object was successfully
+ *   created. Otherwise, FALSE is returned
+ **/
+
+bool_t osCreateEvent(OsEvent *event)
+{
+   //The event is initially in the nonsignaled state
+   event->waiter = NULL;
+   event->handle = NULL;
+   event->signaled = FALSE;
+
+   //Successful processing
+   return TRUE;
+}
+
+
+/**
+ * @brief Delete an event object
+ * @param[in] event Pointer to the event object
+ **/
+
+void osDeleteEvent(OsEvent *event)
+{
+   //Any task waiting at the same time as another one?
+   if(event->handle != NULL)
+   {
+      //Properly dispose the semaphore of the additional waiters
+      vSemaphoreDelete(event->handle);
+      event->handle = NULL;
+   }
+}
+
+
+/**
+ * @brief Set the specified event object to the signaled state
+ * @param[in] event Pointer to the event object
+ **/
+
+void osSetEvent(OsEvent *event)
+{
+   //Enter critical section
+   taskENTER_CRITICAL();
+
+   //Set the specified event to the signaled state
+   event->signaled = TRUE;
+
+   //Wake up the task blocked on the event. The notification is given within
+   //the critical section so that a waiter timing out cannot miss it
+   if(event->waiter != NULL)
+   {
+      xTaskNotifyGive(event->waiter);
+      event->waiter = NULL;
+   }
+
+   //Wake up the additional waiters, if any
+   if(event->handle != NULL)
+   {
+      xSemaphoreGive(event->handle);
+   }
+
+   //Exit critical section
+   taskEXIT_CRITICAL();
+}
+
+
+/**
+ * @brief Set the specified event object to the nonsignaled state
+ * @param[in] event Pointer to the event object
+ **/
+
+void osResetEvent(OsEvent *event)
+{
+   //Enter critical section
+   taskENTER_CRITICAL();
+   //Force the specified event to the nonsignaled state
+   event->signaled = FALSE;
+   //Exit critical section
+   taskEXIT_CRITICAL();
+}
+
+
+/**
+ * @brief Wait until the specified event is in the signaled state
+ * @param[in] event Pointer to the event object
+ * @param[in] timeout Timeout interval
+ * @return The function returns TRUE if the state of the specified object is
+ *   signaled. FALSE is returned if the timeout interval elapsed
+ **/
+
+bool_t osWaitForEvent(OsEvent *event, systime_t timeout)
+{
+   bool_t ret;
+   bool_t registered;
+   bool_t shared;
+   uint32_t value;
+   uint32_t pending;
+   TaskHandle_t task;
+   TickType_t ticks;
+   TimeOut_t timeOut;
+   SemaphoreHandle_t handle;
+
+   //Initialize variables
+   ret = FALSE;
+   registered = FALSE;
+   value = 0;
+   pending = 0;
+   task = xTaskGetCurrentTaskHandle();
+
+   //Convert the timeout interval to ticks
+   if(timeout == INFINITE_DELAY)
+   {
+      ticks = portMAX_DELAY;
+   }
+   else
+   {
+      ticks = OS_MS_TO_SYSTICKS(timeout);
+   }
+
+   //Record the start of the wait
+   vTaskSetTimeOutState(&timeOut);
+
+   //A wakeup does not tell which event the notification was given for, so
+   //the state of the event is checked again after each one
+   while(1)
+   {
+      //Enter critical section
+      taskENTER_CRITICAL();
+
+      //Check whether the task waited for a notification
+      if(registered)
+      {
+         //Take the notifications given since the wait returned. This does not
+         //block, hence can be done within the critical section
+         value += ulTaskNotifyTake(pdTRUE, 0);
+
+         //The setter of the event gives one notification and unregisters the
+         //task at once; the others were meant for something else
+         if(event->waiter != task)
+         {
+            value--;
+            registered = FALSE;
+         }
+
+         //Keep the notifications of other senders until the function returns
+         pending |= value;
+         value = 0;
+      }
+
+      //The event is in the signaled state?
+      if(event->signaled)
+      {
+         //Consume the event
+         event->signaled = FALSE;
+         ret = TRUE;
+      }
+
+      //The event is signaled or the timeout interval has elapsed?
+      if(ret || ticks == 0)
+      {
+         //Release the event
+         if(event->waiter == task)
+         {
+            event->waiter = NULL;
+         }
+
+         //Exit critical section
+         taskEXIT_CRITICAL();
+         break;
+      }
+
+      //No other task blocked on the event?
+      if(event->waiter == NULL || event->waiter == task)
+      {
+         //Wait for a notification
+         event->waiter = task;
+         registered = TRUE;
+         shared = FALSE;
+      }
+      else
+      {
+         //Wait on the semaphore of the additional waiters
+         shared = TRUE;
+      }
+
+      //Semaphore of the additional waiters
+      handle = event->handle;
+
+      //Exit critical section
+      taskEXIT_CRITICAL();
+
+      //Check whether the task waits for a notification
+      if(!shared)
+      {
+         //Block until a setter notifies the task or the timeout elapses
+         value = ulTaskNotifyTake(pdTRUE, ticks);
+      }
+      else if(handle != NULL)
+      {
+         //Block until the event is set or the timeout elapses
+         xSemaphoreTake(handle, ticks);
+      }
+      else
+      {
+         //Create the semaphore of the additional waiters
+         handle = xSemaphoreCreateBinary();
+
+         //Enter critical section
+         taskENTER_CRITICAL();
+
+         //Another task may have created it meanwhile
+         if(event->handle == NULL)
+         {
+            event->handle = handle;
+            handle = NULL;
+         }
+
+         //Exit critical section
+         taskEXIT_CRITICAL();
+
+         //Release the semaphore that is not used
+         if(handle != NULL)
+         {
+            vSemaphoreDelete(handle);
+         }
+         else if(event->handle == NULL)
+         {
+            //Out of memory: poll the event on every tick
+            vTaskDelay(1);
+         }
+      }
+
+      //Update the remaining time
+      xTaskCheckForTimeOut(&timeOut, &ticks);
+   }
+
+   //Give back the notifications of other senders, such as a request given
+   //to the task while it was blocked on a socket. They are set again as bits
+   //rather than given one by one: the console task receives bit masks from
+   //the Telnet sessions and runs CLI commands that wait on sockets, while the
+   //tasks counting gives all take them with clear on exit
+   if(pending != 0)
+   {
+      xTaskNotify(task, pending, eSetBits);
+   }
+
+   //The return value tells whether the event is set
+   return ret;
+}
+
+
+/**
+ * @brief Set an event object to the signaled state from an interrupt service routine
+ * @param[in] event Pointer to the event object
+ * @return TRUE if setting the event to signaled state caused a task to unblock
+ *   and the unblocked task has a priority higher than the currently running task
+ **/
+
+bool_t osSetEventFromIsr(OsEvent *event)
+{
+   UBaseType_t mask;
+   portBASE_TYPE flag = FALSE;
+
+   //Enter critical section
+   mask = taskENTER_CRITICAL_FROM_ISR();
+
+   //Set the specified event to the signaled state
+   event->signaled = TRUE;
+
+   //Wake up the task blocked on the event
+   if(event->waiter != NULL)
+   {
+      vTaskNotifyGiveFromISR(event->waiter, &flag);
+      event->waiter = NULL;
+   }
+
+   //Wake up the additional waiters, if any
+   if(event->handle != NULL)
+   {
+      xSemaphoreGiveFromISR(event->handle, &flag);
+   }
+
+   //Exit critical section
+   taskEXIT_CRITICAL_FROM_ISR(mask);
+
+   //A higher priority task has been woken?
+   return flag;
+}
+
+#else
+
 /**
  * @brief Create an event object
  * @param[in] event Pointer to the event object
@@ -302,6 +603,8 @@ bool_t osSetEventFromIsr(OsEvent *event)
    return flag;
 }
 
+#endif
+
 
 /**
  * @brief Create a semaphore object
@@ -409,6 +712,11 @@ bool_t osCreateMutex(OsMutex *mutex)
    mutex->handle = xSemaphoreCreateMutex();
 #endif
 
+#if (OS_MUTEX_STATS_SUPPORT == ENABLED)
+   //The mutex is not counted until osSetMutexStats is called
+   mutex->stats = NULL;
+#endif
+
    //Check whether the returned handle is valid
    if(mutex->handle != NULL)
    {
@@ -444,8 +752,68 @@ void osDeleteMutex(OsMutex *mutex)
 
 void osAcquireMutex(OsMutex *mutex)
 {
-   //Obtain ownership of the mutex object
-   xSemaphoreTake(mutex->handle, portMAX_DELAY);
+#if (OS_MUTEX_STATS_SUPPORT == ENABLED)
+   bool_t contended;
+   bool_t inversion;
+   uint32_t start;
+   uint32_t wait;
+   UBaseType_t priority;
+
+   //Is the mutex counted?
+   if(mutex->stats != NULL)
+   {
+      //Initialize variables
+      contended = FALSE;
+      inversion = FALSE;
+      wait = 0;
+      priority = uxTaskPriorityGet(NULL);
+
+      //Only the acquisitions that cannot be satisfied at once are timed
+      if(xSemaphoreTake(mutex->handle, 0) != pdTRUE)
+      {
+         //The holder is raised to the priority of the caller meanwhile
+         contended = TRUE;
+         inversion = (mutex->priority < priority) ? TRUE : FALSE;
+         start = (uint32_t) OS_GET_SYSTEM_TIME_US();
+
+         //Obtain ownership of the mutex object
+         xSemaphoreTake(mutex->handle, portMAX_DELAY);
+
+         //Time spent waiting for the holder
+         wait = (uint32_t) OS_GET_SYSTEM_TIME_US() - start;
+      }
+
+      //Save the state of the holder
+      mutex->acquiredUs = (uint32_t) OS_GET_SYSTEM_TIME_US();
+      mutex->priority = priority;
+
+      //The statistics may be shared by several mutexes
+      taskENTER_CRITICAL();
+
+      mutex->stats->acquisitions++;
+
+      //Any wait?
+      if(contended)
+      {
+         mutex->stats->contended++;
+         mutex->stats->totalWaitUs += wait;
+         mutex->stats->maxWaitUs = MAX(mutex->stats->maxWaitUs, wait);
+
+         //The caller was held back by a lower priority task
+         if(inversion)
+         {
+            mutex->stats->inversions++;
+         }
+      }
+
+      taskEXIT_CRITICAL();
+   }
+   else
+#endif
+   {
+      //Obtain ownership of the mutex object
+      xSemaphoreTake(mutex->handle, portMAX_DELAY);
+   }
 }
 
 
@@ -456,11 +824,83 @@ void osAcquireMutex(OsMutex *mutex)
 
 void osReleaseMutex(OsMutex *mutex)
 {
+#if (OS_MUTEX_STATS_SUPPORT == ENABLED)
+   uint32_t hold;
+
+   //Is the mutex counted?
+   if(mutex->stats != NULL)
+   {
+      //Time the mutex was held for, read before another task may take it
+      hold = (uint32_t) OS_GET_SYSTEM_TIME_US() - mutex->acquiredUs;
+
+      //The statistics may be shared by several mutexes
+      taskENTER_CRITICAL();
+      mutex->stats->totalHoldUs += hold;
+      mutex->stats->maxHoldUs = MAX(mutex->stats->maxHoldUs, hold);
+      taskEXIT_CRITICAL();
+   }
+#endif
+
    //Release ownership of the mutex object
    xSemaphoreGive(mutex->handle);
 }
 
 
+#if (OS_MUTEX_STATS_SUPPORT == ENABLED)
+
+/**
+ * @brief Count a mutex in the specified statistics
+ *
+ * Several mutexes may share the same statistics, such as the locks of all
+ * the sockets. The mutex must not be held
+ *
+ * @param[in] mutex Pointer to the mutex object
+ * @param[in] stats Statistics to update, or NULL to stop counting the mutex
+ **/
+
+void osSetMutexStats(OsMutex *mutex, OsMutexStats *stats)
+{
+   //Save the statistics the mutex is counted in
+   mutex->priority = 0;
+   mutex->stats = stats;
+}
+
+
+/**
+ * @brief Get a consistent copy of mutex statistics
+ * @param[in] stats Statistics updated by the mutexes
+ * @param[out] copy Copy of the statistics
+ **/
+
+void osGetMutexStats(const OsMutexStats *stats, OsMutexStats *copy)
+{
+   //Enter critical section
+   taskENTER_CRITICAL();
+   //Copy the statistics
+   *copy = *stats;
+   //Exit critical section
+   taskEXIT_CRITICAL();
+}
+
+
+/**
+ * @brief Clear mutex statistics
+ * @param[in] stats Statistics updated by the mutexes
+ **/
+
+void osResetMutexStats(OsMutexStats *stats)
+{
+   //Enter critical section
+   taskENTER_CRITICAL();
+   //Clear the statistics
+   osMemset(stats, 0, sizeof(OsMutexStats));
+   //Exit critical section
+   taskEXIT_CRITICAL();
+}
+
+#endif
+
+
 /**
  * @brief Retrieve system time
  * @return Number of milliseconds elapsed since the system was last started
@@ -468,6 +908,11 @@ void osReleaseMutex(OsMutex *mutex)
 
 systime_t osGetSystemTime(void)
 {
+#ifdef OS_GET_SYSTEM_TIME_US
+   //Derive the time from the microsecond clock of the application, which
+   //is finer than the tick and readable without a critical section
+   return (systime_t) (OS_GET_SYSTEM_TIME_US() / 1000);
+#else
    systime_t time;
 
    //Get current tick count
@@ -475,6 +920,7 @@ systime_t osGetSystemTime(void)
 
    //Convert system ticks to milliseconds
    return OS_SYSTICKS_TO_MS(time);
+#endif
 }
 
 
@@ -485,7 +931,7 @@ systime_t osGetSystemTime(void)
  *   there is insufficient memory available
  **/
 
-__weak_func void *osAllocMem(size_t size)
+__weak_func void *(osAllocMem)(size_t size)
 {
    void *p;
 
@@ -65,9 +65,34 @@
    #define OS_SYSTICKS_TO_MS(n) (n)
 #endif
 
-//Retrieve 64-bit system time (not implemented)
+//Event objects based on direct-to-task notifications
+#ifndef OS_EVENT_TASK_NOTIFY_SUPPORT
+   #define OS_EVENT_TASK_NOTIFY_SUPPORT DISABLED
+#elif (OS_EVENT_TASK_NOTIFY_SUPPORT != ENABLED && OS_EVENT_TASK_NOTIFY_SUPPORT != DISABLED)
+   #error OS_EVENT_TASK_NOTIFY_SUPPORT parameter is not valid
+#endif
+
+//Contention and hold time statistics of selected mutexes
+#ifndef OS_MUTEX_STATS_SUPPORT
+   #define OS_MUTEX_STATS_SUPPORT DISABLED
+#elif (OS_MUTEX_STATS_SUPPORT != ENABLED && OS_MUTEX_STATS_SUPPORT != DISABLED)
+   #error OS_MUTEX_STATS_SUPPORT parameter is not valid
+#elif (OS_MUTEX_STATS_SUPPORT == ENABLED && !defined(OS_GET_SYSTEM_TIME_US))
+   #error OS_MUTEX_STATS_SUPPORT requires OS_GET_SYSTEM_TIME_US
+#endif
+
+//Retrieve 64-bit system time, from the microsecond clock when available
 #ifndef osGetSystemTime64
-   #define osGetSystemTime64() osGetSystemTime()
+   #ifdef OS_GET_SYSTEM_TIME_US
+      #define osGetSystemTime64() (OS_GET_SYSTEM_TIME_US() / 1000)
+   #else
+      #define osGetSystemTime64() osGetSystemTime()
+   #endif
+#endif
+
+//Retrieve the system time in microseconds
+#ifdef OS_GET_SYSTEM_TIME_US
+   #define osGetSystemTimeUs() OS_GET_SYSTEM_TIME_US()
 #endif
 
 //Task prologue
@@ -152,6 +177,17 @@ typedef struct
  * @brief Event object
  **/
 
+#if (OS_EVENT_TASK_NOTIFY_SUPPORT == ENABLED)
+
+typedef struct
+{
+   TaskHandle_t waiter;      ///<Task blocked on the notification of the event
+   SemaphoreHandle_t handle; ///<Created when a second task waits at the same time
+   volatile bool_t signaled; ///<State of the event
+} OsEvent;
+
+#else
+
 typedef struct
 {
    SemaphoreHandle_t handle;
@@ -160,6 +196,8 @@ typedef struct
 #endif
 } OsEvent;
 
+#endif
+
 
 /**
  * @brief Semaphore object
@@ -174,6 +212,22 @@ typedef struct
 } OsSemaphore;
 
 
+/**
+ * @brief Statistics of one or more mutexes
+ **/
+
+typedef struct
+{
+   uint32_t acquisitions; ///<Number of times the mutexes were taken
+   uint32_t contended;    ///<Acquisitions that had to wait for the holder
+   uint32_t inversions;   ///<Waits on a holder of lower priority
+   uint32_t maxWaitUs;    ///<Longest wait
+   uint32_t maxHoldUs;    ///<Longest time a mutex was held
+   uint64_t totalWaitUs;
+   uint64_t totalHoldUs;
+} OsMutexStats;
+
+
 /**
  * @brief Mutex object
  **/
@@ -184,6 +238,11 @@ typedef struct
 #if (configSUPPORT_STATIC_ALLOCATION == 1)
    StaticSemaphore_t buffer;
 #endif
+#if (OS_MUTEX_STATS_SUPPORT == ENABLED)
+   OsMutexStats *stats;   ///<Statistics the mutex is counted in, if any
+   uint32_t acquiredUs;   ///<Time at which the holder took it
+   UBaseType_t priority;  ///<Priority of the holder
+#endif
 } OsMutex;
 
 
@@ -231,6 +290,12 @@ void osDeleteMutex(OsMutex *mutex);
 void osAcquireMutex(OsMutex *mutex);
 void osReleaseMutex(OsMutex *mutex);
 
+#if (OS_MUTEX_STATS_SUPPORT == ENABLED)
+void osSetMutexStats(OsMutex *mutex, OsMutexStats *stats);
+void osGetMutexStats(const OsMutexStats *stats, OsMutexStats *copy);
+void osResetMutexStats(OsMutexStats *stats);
+#endif
+
 //System time
 systime_t osGetSystemTime(void);
 
@@ -238,6 +303,11 @@ systime_t osGetSystemTime(void);
 void *osAllocMem(size_t size);
 void osFreeMem(void *p);
 
+//Allocations charged to the subsystem of the caller?
+#if (MEM_TAG_SUPPORT == 1)
+   #define osAllocMem(size) osAllocMemTagged(size, MEM_TAG_SITE())
+#endif
+
 //C++ guard
 #ifdef __cplusplus
 }
@@ -39,8 +39,34 @@
    #define USE_CMSIS_RTOS2
 #elif defined(RTE_RTOS_FreeRTOS_CORE)
    #define USE_FREERTOS
+#elif defined(__linux__) || defined(__FreeBSD__)
+   //Host build, tasks run as POSIX threads (os_port_posix.h)
+   #define USE_POSIX
 #else
    #define USE_NO_RTOS
 #endif
 
+#ifndef USE_POSIX
+
+//Microsecond time base of the system (TIM5), osGetSystemTime() included
+#include "MonoClock.h"
+#define OS_GET_SYSTEM_TIME_US() ullMonoClockNowUs()
+
+//Event objects set by notifying the waiting task directly (netEvent from the
+//Ethernet interrupt, nicTxEvent, socket events) rather than through a binary
+//semaphore each
+#define OS_EVENT_TASK_NOTIFY_SUPPORT ENABLED
+
+//Contention and hold times of the netMutex and of the socket locks, printed
+//by the net-locks command (NetCLICommands.c)
+#define OS_MUTEX_STATS_SUPPORT ENABLED
+
+//Allocations charged to the subsystem of the caller (MemTag.h)
+#include "MemTag.h"
+
+#endif
+
+//Backend of the TRACE_xxx messages, with runtime levels (DeferredLog.h)
+#include "DeferredLog.h"
+
 #endif
@@ -34,13 +34,55 @@
 //Dependencies
 #include "RTE_Components.h"
 
+//Build profiles
+#define NET_PROFILE_GATEWAY 0
+#define NET_PROFILE_RT_NODE 1
+#define NET_PROFILE_DEBUG 2
+
 //*** <<< Use Configuration Wizard in Context Menu >>> ***
 
+// <o>Build profile
+// <i>Gateway: Ethernet port, Cyphal VLAN, PPP modem and loopback interfaces
+// <i>Real-time node: the Ethernet port alone, the frame path specialized
+// <i>for it (no interface lookup, no VLAN or virtual interface checks)
+// <i>Debug: the gateway with the trace messages of the stack
+// <i>Default: Gateway
+// <0=>Gateway
+// <1=>Single-interface real-time node
+// <2=>Debug
+#ifndef NET_PROFILE
+   #define NET_PROFILE NET_PROFILE_GATEWAY
+#endif
+
 // <o>Number of network adapters
 // <i>Number of network adapters
 // <i>Default: 1
 // <1-16>
-#define NET_INTERFACE_COUNT 1
+#if (NET_PROFILE == NET_PROFILE_RT_NODE)
+   #define NET_INTERFACE_COUNT 1
+#else
+   #define NET_INTERFACE_COUNT 4
+#endif
+
+// <q>Loopback interface support
+// <i>Deliver the packets sent to 127.0.0.0/8 and to the host addresses
+// <i>through the loopback interface, without copy
+// <i>Default: Disabled
+#if (NET_PROFILE == NET_PROFILE_RT_NODE)
+   #define NET_LOOPBACK_IF_SUPPORT 0
+#else
+   #define NET_LOOPBACK_IF_SUPPORT 1
+#endif
+
+// <o>Trace level of the debug profile
+// <i>Applies to every module of the stack below; the others build with
+// <i>the trace messages removed
+// <i>Default: Info
+#if (NET_PROFILE == NET_PROFILE_DEBUG)
+   #define NET_PROFILE_TRACE_LEVEL 4
+#else
+   #define NET_PROFILE_TRACE_LEVEL 0
+#endif
 
 // <h>Trace level
 
@@ -54,7 +96,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define MEM_TRACE_LEVEL 0
+#define MEM_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>NIC Trace level
 // <i>Set the desired debugging level
@@ -66,7 +108,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define NIC_TRACE_LEVEL 0
+#define NIC_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>Ethernet Trace level
 // <i>Set the desired debugging level
@@ -78,7 +120,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define ETH_TRACE_LEVEL 0
+#define ETH_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>LLDP Trace level
 // <i>Set the desired debugging level
@@ -90,7 +132,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define LLDP_TRACE_LEVEL 0
+#define LLDP_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>ARP Trace level
 // <i>Set the desired debugging level
@@ -102,7 +144,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define ARP_TRACE_LEVEL 0
+#define ARP_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>IP Trace level
 // <i>Set the desired debugging level
@@ -114,7 +156,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define IP_TRACE_LEVEL 0
+#define IP_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>IPv4 Trace level
 // <i>Set the desired debugging level
@@ -126,7 +168,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define IPV4_TRACE_LEVEL 0
+#define IPV4_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>IPv6 Trace level
 // <i>Set the desired debugging level
@@ -138,7 +180,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define IPV6_TRACE_LEVEL 0
+#define IPV6_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>ICMP Trace level
 // <i>Set the desired debugging level
@@ -150,7 +192,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define ICMP_TRACE_LEVEL 0
+#define ICMP_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>IGMP Trace level
 // <i>Set the desired debugging level
@@ -162,7 +204,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define IGMP_TRACE_LEVEL 0
+#define IGMP_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>NAT Trace level
 // <i>Set the desired debugging level
@@ -174,7 +216,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define NAT_TRACE_LEVEL 0
+#define NAT_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>ICMPv6 Trace level
 // <i>Set the desired debugging level
@@ -186,7 +228,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define ICMPV6_TRACE_LEVEL 0
+#define ICMPV6_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>MLD Trace level
 // <i>Set the desired debugging level
@@ -198,7 +240,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define MLD_TRACE_LEVEL 0
+#define MLD_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>NDP Trace level
 // <i>Set the desired debugging level
@@ -210,7 +252,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define NDP_TRACE_LEVEL 0
+#define NDP_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>PPP Trace level
 // <i>Set the desired debugging level
@@ -222,7 +264,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define PPP_TRACE_LEVEL 0
+#define PPP_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>UDP Trace level
 // <i>Set the desired debugging level
@@ -234,7 +276,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define UDP_TRACE_LEVEL 0
+#define UDP_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>TCP Trace level
 // <i>Set the desired debugging level
@@ -246,7 +288,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define TCP_TRACE_LEVEL 0
+#define TCP_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>Socket Trace level
 // <i>Set the desired debugging level
@@ -258,7 +300,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define SOCKET_TRACE_LEVEL 0
+#define SOCKET_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>Raw socket Trace level
 // <i>Set the desired debugging level
@@ -270,7 +312,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define RAW_SOCKET_TRACE_LEVEL 0
+#define RAW_SOCKET_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>BSD socket Trace level
 // <i>Set the desired debugging level
@@ -282,7 +324,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define BSD_SOCKET_TRACE_LEVEL 0
+#define BSD_SOCKET_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>WebSocket Trace level
 // <i>Set the desired debugging level
@@ -294,7 +336,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define WEB_SOCKET_TRACE_LEVEL 0
+#define WEB_SOCKET_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>Auto-IP Trace level
 // <i>Set the desired debugging level
@@ -306,7 +348,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define AUTO_IP_TRACE_LEVEL 0
+#define AUTO_IP_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>SLAAC Trace level
 // <i>Set the desired debugging level
@@ -318,7 +360,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define SLAAC_TRACE_LEVEL 0
+#define SLAAC_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>DHCP Trace level
 // <i>Set the desired debugging level
@@ -330,7 +372,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define DHCP_TRACE_LEVEL 0
+#define DHCP_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>DHCPv6 Trace level
 // <i>Set the desired debugging level
@@ -342,7 +384,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define DHCPV6_TRACE_LEVEL 0
+#define DHCPV6_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>DNS Trace level
 // <i>Set the desired debugging level
@@ -354,7 +396,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define DNS_TRACE_LEVEL 0
+#define DNS_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>mDNS Trace level
 // <i>Set the desired debugging level
@@ -366,7 +408,19 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define MDNS_TRACE_LEVEL 0
+#define MDNS_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
+
+// <o>DNS-SD Trace level
+// <i>Set the desired debugging level
+// <i>Default: Info
+// <0=>Off
+// <1=>Fatal
+// <2=>Error
+// <3=>Warning
+// <4=>Info
+// <5=>Debug
+// <6=>Verbose
+#define DNS_SD_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>NBNS Trace level
 // <i>Set the desired debugging level
@@ -378,7 +432,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define NBNS_TRACE_LEVEL 0
+#define NBNS_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>LLMNR Trace level
 // <i>Set the desired debugging level
@@ -390,7 +444,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define LLMNR_TRACE_LEVEL 0
+#define LLMNR_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>CoAP Trace level
 // <i>Set the desired debugging level
@@ -402,7 +456,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define COAP_TRACE_LEVEL 0
+#define COAP_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>FTP Trace level
 // <i>Set the desired debugging level
@@ -414,7 +468,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define FTP_TRACE_LEVEL 0
+#define FTP_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>HTTP Trace level
 // <i>Set the desired debugging level
@@ -426,7 +480,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define HTTP_TRACE_LEVEL 0
+#define HTTP_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>MQTT Trace level
 // <i>Set the desired debugging level
@@ -438,7 +492,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define MQTT_TRACE_LEVEL 0
+#define MQTT_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>MQTT-SN Trace level
 // <i>Set the desired debugging level
@@ -450,7 +504,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define MQTT_SN_TRACE_LEVEL 0
+#define MQTT_SN_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>SMTP Trace level
 // <i>Set the desired debugging level
@@ -462,7 +516,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define SMTP_TRACE_LEVEL 0
+#define SMTP_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>SNMP Trace level
 // <i>Set the desired debugging level
@@ -474,7 +528,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define SNMP_TRACE_LEVEL 0
+#define SNMP_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>SNTP Trace level
 // <i>Set the desired debugging level
@@ -486,7 +540,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define SNTP_TRACE_LEVEL 0
+#define SNTP_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>NTP Trace level
 // <i>Set the desired debugging level
@@ -498,7 +552,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define NTP_TRACE_LEVEL 0
+#define NTP_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>NTS Trace level
 // <i>Set the desired debugging level
@@ -510,7 +564,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define NTS_TRACE_LEVEL 0
+#define NTS_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>TFTP Trace level
 // <i>Set the desired debugging level
@@ -522,7 +576,7 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define TFTP_TRACE_LEVEL 0
+#define TFTP_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
 
 // <o>Modbus/TCP Trace level
 // <i>Set the desired debugging level
@@ -534,7 +588,45 @@
 // <4=>Info
 // <5=>Debug
 // <6=>Verbose
-#define MODBUS_TRACE_LEVEL 0
+#define MODBUS_TRACE_LEVEL NET_PROFILE_TRACE_LEVEL
+
+// </h>
+// <h>Memory pool
+
+// <q>Fixed-size blocks allocation
+// <i>Allocate network buffers from static block classes instead of the heap
+// <i>Default: Disabled
+#define NET_MEM_POOL_SUPPORT 1
+
+// <o>Number of small blocks
+// <i>Default: 0
+// <0-256>
+#define NET_MEM_POOL_SMALL_BUFFER_COUNT 32
+
+// <o>Size of the small blocks
+// <i>Default: 128
+// <16-512>
+#define NET_MEM_POOL_SMALL_BUFFER_SIZE 128
+
+// <o>Number of medium blocks
+// <i>Default: 0
+// <0-256>
+#define NET_MEM_POOL_MEDIUM_BUFFER_COUNT 32
+
+// <o>Size of the medium blocks
+// <i>Default: 512
+// <128-1024>
+#define NET_MEM_POOL_MEDIUM_BUFFER_SIZE 512
+
+// <o>Number of large blocks
+// <i>Default: 32
+// <1-256>
+#define NET_MEM_POOL_BUFFER_COUNT 32
+
+// <o>Size of the large blocks
+// <i>Default: 1536
+// <128-2048>
+#define NET_MEM_POOL_BUFFER_SIZE 1536
 
 // </h>
 // <h>Ethernet
@@ -542,12 +634,20 @@
 // <q>Virtual interface support
 // <i>Enable support for virtual interfaces
 // <i>Default: Disabled
-#define ETH_VIRTUAL_IF_SUPPORT 0
+#if (NET_PROFILE == NET_PROFILE_RT_NODE)
+   #define ETH_VIRTUAL_IF_SUPPORT 0
+#else
+   #define ETH_VIRTUAL_IF_SUPPORT 1
+#endif
 
 // <q>VLAN support
 // <i>Enable VLAN support (IEEE 802.1q)
 // <i>Default: Disabled
-#define ETH_VLAN_SUPPORT 0
+#if (NET_PROFILE == NET_PROFILE_RT_NODE)
+   #define ETH_VLAN_SUPPORT 0
+#else
+   #define ETH_VLAN_SUPPORT 1
+#endif
 
 // <q>LLC support
 // <i>Enable LLC (IEEE 802.2)
@@ -559,12 +659,266 @@
 // <i>Default: Disabled
 #define ETH_PORT_TAGGING_SUPPORT 0
 
+// <q>Hardware checksum offload
+// <i>Let the Ethernet controller insert and verify IP/TCP/UDP/ICMP checksums
+// <i>Default: Disabled
+#define ETH_CHECKSUM_OFFLOAD_SUPPORT 1
+
+// <q>Hardware time stamping
+// <i>Time stamp PTP event messages in the Ethernet controller
+// <i>Default: Disabled
+#define ETH_TIMESTAMP_SUPPORT 1
+
+// <q>Time-triggered transmission
+// <i>Hold frames in the Ethernet controller until a given PTP time
+// <i>Default: Disabled
+#define ETH_LAUNCH_TIME_SUPPORT 1
+
 // <o>Size of the multicast MAC filter
 // <i>Maximum number of entries in the multicast MAC filter
 // <i>Default: 12
 // <1-100>
 #define MAC_MULTICAST_FILTER_SIZE 12
 
+// <o>Depth of the TX queue
+// <i>Number of frames queued while the transmitter is busy (0 to disable)
+// <i>Default: 0
+// <0-32>
+#define NIC_TX_QUEUE_SIZE 4
+
+// <o>Number of TX priority bands
+// <i>Queued frames are sent by decreasing DSCP class selector or VLAN
+// <i>priority (1 for a single FIFO)
+// <i>Default: 1
+// <1-8>
+#define NIC_TX_PRIORITY_COUNT 3
+
+// <q>TX deadlines
+// <i>Frames sent with a deadline are queued ahead of the frames of their
+// <i>band due later, and dropped rather than sent once it has passed
+// <i>Default: Disabled
+#define NIC_TX_DEADLINE_SUPPORT 1
+
+// <q>Receive time stamps
+// <i>Stamp each received frame with NIC_RX_TIME_US(), a microsecond clock,
+// <i>and return it with the datagrams received (SocketMsg.rxTime)
+// <i>Default: Disabled
+#define NIC_RX_TIME_SUPPORT 1
+
+// <q>Batched RX delivery
+// <i>Defer socket notifications until a batch of received frames is processed
+// <i>Default: Disabled
+#define NIC_RX_BATCH_SUPPORT 1
+
+// <q>Batched TX kick
+// <i>Notify the Ethernet DMA once per batch of datagrams sent with
+// <i>socketSendMsgBatch, instead of once per frame
+// <i>Default: Disabled
+#define NIC_TX_BATCH_SUPPORT 1
+
+// <q>Generic segmentation offload
+// <i>Send runs of full-sized TCP segments through the stack as one packet,
+// <i>split into segments right before the Ethernet driver
+// <i>Default: Disabled
+#define NIC_GSO_SUPPORT 1
+
+// <o>Maximum number of segments per GSO packet
+// <i>Default: 4
+// <2-6>
+#define NIC_GSO_MAX_SEGMENTS 4
+
+// <q>Early RX classification
+// <i>Process the frames matching a class 0 rule before the rest of their
+// <i>RX batch (requires batched RX delivery)
+// <i>Default: Disabled
+#define NIC_RX_CLASS_SUPPORT 1
+
+// <o>Number of RX traffic classes
+// <i>Class 0 is processed first, the other classes at the end of the batch
+// <i>Default: 3
+// <2-8>
+#define NIC_RX_CLASS_COUNT 3
+
+// <o>Maximum number of RX classification rules
+// <i>Default: 8
+// <1-32>
+#define NIC_RX_CLASS_RULE_COUNT 8
+
+// <q>Packet capture
+// <i>Copy the Ethernet frames received and sent that pass a BPF filter
+// <i>into a ring, read by the capture server
+// <i>Default: Disabled
+#define NET_CAPTURE_SUPPORT 1
+
+// <o>Packet capture ring size
+// <i>Size of the capture ring, in bytes
+// <i>Default: 16384
+// <2048-262144:8>
+#define NET_CAPTURE_RING_SIZE 32768
+
+// <q>Zero-copy reception
+// <i>Let the NIC driver loan its receive buffers to the UDP layer
+// <i>Default: Disabled
+#define NET_MEM_RX_LOAN_SUPPORT 1
+
+// <q>Zero-copy transmission
+// <i>Let the NIC driver send TCP segments and UDP datagrams without
+// <i>copying them
+// <i>Default: Disabled
+#define NET_MEM_TX_ZERO_COPY_SUPPORT 1
+
+// <q>Zero-copy transmission of loaned payloads
+// <i>Let the application loan the payload of outgoing UDP datagrams
+// <i>Default: Disabled
+#define NET_MEM_TX_LOAN_SUPPORT 1
+
+// <o>Maximum number of loaned memory regions
+// <i>One for the receive buffers of the NIC driver, one for the Cyphal
+// <i>TX item pool, one for the TCP large buffer pool
+// <i>Default: 1
+// <1-8>
+#define NET_MEM_MAX_LOAN_REGIONS 3
+
+// <q>Shared buffers
+// <i>Let several buffers reference the data of a single buffer, which is
+// <i>freed along with the last reference
+// <i>Default: Disabled
+#define NET_MEM_SHARED_BUFFER_SUPPORT 1
+
+// <o>Maximum number of references to shared buffers
+// <i>A datagram fanned out to N sockets uses N references until read
+// <i>Default: 16
+// <1-128>
+#define NET_MEM_MAX_SHARED_REFS 32
+
+// </h>
+// <h>STM32H7 Ethernet MAC
+
+// <o>Number of TX descriptors
+// <i>Maximum depth of the transmit descriptor ring
+// <i>Default: 8
+// <1-64>
+#define STM32H7XX_ETH_TX_BUFFER_COUNT 8
+
+// <o>Number of RX descriptors
+// <i>Maximum depth of the receive descriptor ring
+// <i>Default: 8
+// <1-64>
+#define STM32H7XX_ETH_RX_BUFFER_COUNT 24
+
+// <q>Jumbo frames
+// <i>Frames larger than 1518 bytes, spanning several descriptors. Both ends
+// <i>and the switch must support them. TX checksums are then computed in
+// <i>software, and TCP_MAX_MSS should be raised to match the MTU
+// <i>Default: Disabled
+#define STM32H7XX_ETH_JUMBO_SUPPORT 0
+
+// <o>Jumbo frame MTU
+// <i>MTU of the interface when jumbo frames are enabled
+// <i>Default: 9000
+// <1500-9000>
+#define STM32H7XX_ETH_JUMBO_MTU 9000
+
+// <q>Cache maintenance
+// <i>Place DMA buffers in cacheable AXI SRAM and maintain coherency in software
+// <i>Default: Disabled
+#define STM32H7XX_ETH_CACHE_MAINTENANCE 1
+
+// <q>ARP and ICMP echo offload
+// <i>Answer ARP and small ICMP echo requests from the Ethernet interrupt handler
+// <i>Default: Disabled
+#define STM32H7XX_ETH_OFFLOAD_SUPPORT 1
+
+// <q>VLAN tag offload
+// <i>Insert, strip and filter 802.1Q tags in the Ethernet MAC
+// <i>Default: Disabled
+#define STM32H7XX_ETH_VLAN_OFFLOAD_SUPPORT 1
+
+// <q>Wake-on-LAN
+// <i>Power-down mode of the MAC, left on a magic packet or a unicast frame
+// <i>through the ETH wakeup line of the EXTI, which also ends Stop mode
+// <i>Default: Disabled
+#define STM32H7XX_ETH_WOL_SUPPORT 1
+
+// <q>LAN8742 energy detect power-down
+// <i>Power down the PHY analog front end while the cable is unplugged
+// <i>Default: Disabled
+#define LAN8742_EDPD_SUPPORT 1
+
+// <o>Largest offloaded echo request
+// <i>Largest ICMP message answered by the offload responder, in bytes
+// <i>Default: 128
+// <8-1502>
+#define STM32H7XX_ETH_OFFLOAD_MAX_ECHO_SIZE 128
+
+// <o>PTP clock increment
+// <i>Nanoseconds added to the PTP clock on each update (50 MHz)
+// <i>Default: 20
+// <1-255>
+#define STM32H7XX_ETH_PTP_INCREMENT 20
+
+// <o>Largest PTP frequency correction
+// <i>Range of the fine adjustment of the PTP clock, in parts per billion
+// <i>Default: 500000
+// <1-10000000>
+#define STM32H7XX_ETH_PTP_MAX_ADJ 500000
+
+// <o>Largest launch lead
+// <i>Furthest launch time accepted ahead of the PTP time, in milliseconds
+// <i>Default: 100
+// <1-1000>
+#define STM32H7XX_ETH_MAX_LAUNCH_LEAD 100
+
+// </h>
+// <h>Diagnostics
+
+// <q>Network statistics
+// <i>Per-interface and per-protocol counters (frames, drops, errors)
+// <i>Default: Disabled
+#define NET_STATS_SUPPORT 1
+
+// <q>Receive path latency histograms
+// <i>Timestamp received frames from the interrupt up to socket delivery
+// <i>Default: Disabled
+#if (NET_PROFILE == NET_PROFILE_RT_NODE)
+   #define NET_LATENCY_SUPPORT 0
+#else
+   #define NET_LATENCY_SUPPORT 1
+#endif
+
+// </h>
+// <h>Link-up fast recovery
+// <i>Industrial profile: cable swap recovery in hundreds of milliseconds
+
+// <q>Coordinated link-up sequence
+// <i>Announce manual addresses at once and run DHCP, ARP and mDNS probing at the stack tick rate after link-up
+// <i>Default: Disabled
+#define NET_LINK_UP_FAST_PATH_SUPPORT 1
+
+// <o>Fast path window (ms)
+// <i>Time after link-up during which address configuration runs at the stack tick rate
+// <i>Default: 5000
+// <0-60000>
+#define NET_LINK_UP_FAST_PATH_WINDOW 3000
+
+// <o>PHY polling interval (ms)
+// <i>Period at which the link state is read from the PHY
+// <i>Default: 1000
+// <100-10000>
+#define NIC_TICK_INTERVAL 100
+
+// <o>mDNS start-up delay (ms)
+// <i>Added to the 0-250 ms random delay RFC 6762 requires before the first probe
+// <i>Default: 1000
+// <0-10000>
+#define MDNS_INIT_DELAY 0
+
+// <o>DHCP ARP probe wait (ms)
+// <i>Time waited for a conflicting ARP reply after probing the leased address
+// <i>Default: 1000
+// <100-10000>
+#define DHCP_CLIENT_PROBE_DELAY 200
+
 // </h>
 // <h>LLDP
 
@@ -603,7 +957,12 @@
 // <i>Maximum number of entries in the IPv4 multicast filter
 // <i>Default: 4
 // <1-100>
-#define IPV4_MULTICAST_FILTER_SIZE 4
+#define IPV4_MULTICAST_FILTER_SIZE 8
+
+// <q>Early multicast filtering
+// <i>Drop datagrams of unsubscribed groups and excluded sources before IPv4 processing
+// <i>Default: Disabled
+#define IPV4_MULTICAST_PREFILTER_SUPPORT 1
 
 // <q>IPv4 fragmentation support
 // <i>Enable IPv4 fragmentation and reassembly support
@@ -622,17 +981,145 @@
 // <576-65536>
 #define IPV4_MAX_FRAG_DATAGRAM_SIZE 8192
 
+// <o>Maximum number of holes per datagram
+// <i>Holes tracked per datagram being reassembled. Fragments that would
+// <i>leave more holes cause the datagram to be dropped
+// <i>Default: 16
+// <2-256>
+#define IPV4_FRAG_MAX_HOLES 16
+
+// <q>IPv4 path MTU discovery
+// <i>Send unicast datagrams with DF set and lower the MTU of a destination
+// <i>when a router reports it with an ICMP "fragmentation needed" error
+// <i>Default: Disabled
+#define IPV4_PMTU_SUPPORT 1
+
+// <o>Size of the path MTU cache
+// <i>Number of destinations whose path MTU estimate is remembered
+// <i>Default: 8
+// <1-100>
+#define IPV4_PMTU_CACHE_SIZE 8
+
+// <o>Path MTU estimate lifetime (ms)
+// <i>Time after which a lowered estimate is forgotten and the link MTU is
+// <i>tried again
+// <i>Default: 600000
+// <1000-3600000>
+#define IPV4_PMTU_TIMEOUT 600000
+
+// <q>IPv4 routing support
+// <i>Forward unicast packets between the interfaces where routing is enabled
+// <i>Default: Disabled
+#define IPV4_ROUTING_SUPPORT 1
+
+// <o>Size of the IPv4 routing table
+// <i>Default: 8
+// <1-100>
+#define IPV4_ROUTING_TABLE_SIZE 8
+
+// <o>Size of the forwarding cache
+// <i>Number of destinations whose route is remembered (power of two)
+// <i>Default: 16
+// <1-256>
+#define IPV4_ROUTING_CACHE_SIZE 16
+
+// <q>IPv4 firewall support
+// <i>Check the incoming packets against a rule table, in the MAC when it can
+// <i>express the policy
+// <i>Default: Disabled
+#define IPV4_FIREWALL_SUPPORT 1
+
+// <o>Size of the firewall rule table
+// <i>Default: 16
+// <1-64>
+#define IPV4_FIREWALL_MAX_RULES 16
+
+// <q>ICMP rate limiting support
+// <i>Limit the Echo Reply and error messages with token buckets, per type
+// <i>and per source
+// <i>Default: Disabled
+#define ICMP_RATE_LIMIT_SUPPORT 1
+
+// <o>Number of sources limited individually
+// <i>Default: 16
+// <1-64>
+#define ICMP_RATE_LIMIT_SOURCE_COUNT 16
+
 // <o>Size of ARP cache
 // <i>Size of ARP cache
 // <i>Default: 8
-// <1-100>
-#define ARP_CACHE_SIZE 8
+// <1-1024>
+#define ARP_CACHE_SIZE 64
+
+// <o>Number of ARP hash buckets
+// <i>Number of hash buckets the ARP cache entries are chained in (power of two)
+// <i>Default: 8
+// <1-1024>
+#define ARP_HASH_TABLE_SIZE 32
 
 // <o>Maximum number of pending packets
 // <i>Maximum number of packets waiting for address resolution to complete
 // <i>Default: 2
 // <1-100>
-#define ARP_MAX_PENDING_PACKETS 2
+#define ARP_MAX_PENDING_PACKETS 8
+
+// <o>Size of the ARP queue pool
+// <i>Packets waiting for address resolution, shared by all the ARP entries
+// <i>Default: 8
+// <1-256>
+#define ARP_QUEUE_POOL_SIZE 32
+
+// </h>
+// <h>IGMP Host
+
+// <q>Report aggregation
+// <i>Send the IGMPv3 state changes of one tick, and the responses to the group-specific queries, in shared reports
+// <i>Default: Disabled
+#define IGMP_HOST_REPORT_AGGREGATION_SUPPORT 1
+
+// </h>
+// <h>NAT
+// <o>Number of NAT hash buckets
+// <i>Number of hash buckets the sessions are chained in, for each direction
+// <i>(power of two)
+// <i>Default: 64
+// <1-4096>
+#define NAT_HASH_TABLE_SIZE 256
+
+// <o>Number of slots of the NAT timer wheel
+// <i>Each slot is checked once per NAT tick (power of two)
+// <i>Default: 128
+// <2-4096>
+#define NAT_TIMER_WHEEL_SIZE 128
+
+// <o>TCP session timeout (ms)
+// <i>Default: 120000
+// <1000-86400000>
+#define NAT_TCP_SESSION_TIMEOUT 300000
+
+// <o>UDP session timeout (ms)
+// <i>Default: 120000
+// <1000-86400000>
+#define NAT_UDP_SESSION_TIMEOUT 120000
+
+// <o>ICMP query session timeout (ms)
+// <i>Default: 10000
+// <1000-86400000>
+#define NAT_ICMP_SESSION_TIMEOUT 30000
+
+// </h>
+// <h>PPP
+// <o>TX buffer size
+// <i>Ring of the HDLC encoded frames, sent from by the UART DMA. A frame
+// <i>is queued only when its worst-case encoding fits
+// <i>Default: 4096
+// <3006-65536>
+#define PPP_TX_BUFFER_SIZE 8192
+
+// <o>RX buffer size
+// <i>Default: 8192
+// <3006-65536>
+#define PPP_RX_BUFFER_SIZE 8192
 
 // </h>
 // <h>IPv6
@@ -690,6 +1177,13 @@
 // <1-100>
 #define NDP_NEIGHBOR_CACHE_SIZE 8
 
+// <o>Number of Neighbor Cache hash buckets
+// <i>Number of hash buckets the Neighbor Cache entries are chained in
+// <i>(power of two)
+// <i>Default: 8
+// <1-1024>
+#define NDP_HASH_TABLE_SIZE 8
+
 // <o>Size of the Destination Cache size
 // <i>Size of the Destination Cache size
 // <i>Default: 8
@@ -732,13 +1226,138 @@
 // <q>SACK support
 // <i>Enable selective acknowledgment support
 // <i>Default: Disabled
-#define TCP_SACK_SUPPORT 0
+#define TCP_SACK_SUPPORT 1
+
+// <o>Number of out-of-order ranges per connection
+// <i>Ranges of out-of-order data held in the receive buffer
+// <i>Default: 8
+// <4-32>
+#define TCP_MAX_OOO_BLOCKS 8
+
+// <q>Timestamps option support
+// <i>Enable the TCP Timestamps option (RTT measurement and PAWS)
+// <i>Default: Disabled
+#define TCP_TIMESTAMPS_SUPPORT 1
+
+// <q>TCP Fast Open support
+// <i>Carry the first data in the SYN segment of connections to servers
+// <i>that issued a cookie (client side, RFC 7413)
+// <i>Default: Disabled
+#define TCP_FAST_OPEN_SUPPORT 1
+
+// <o>Number of Fast Open cookies cached
+// <i>One entry per server
+// <i>Default: 8
+// <1-64>
+#define TCP_FAST_OPEN_CACHE_SIZE 8
+
+// <q>SYN cookie support
+// <i>Answer SYN segments with a cookie when the SYN queue is full
+// <i>Default: Disabled
+#define TCP_SYN_COOKIE_SUPPORT 1
 
 // <q>TCP keep-alive support
 // <i>Enable TCP keep-alive support
 // <i>Default: Disabled
 #define TCP_KEEP_ALIVE_SUPPORT 0
 
+// <q>Delayed ACK support
+// <i>Hold ACKs so that they can be piggybacked on outgoing data
+// <i>Default: Disabled
+#define TCP_DELAYED_ACK_SUPPORT 1
+
+// <o>Delayed ACK timeout (ms)
+// <i>Maximum time an ACK is held, rounded up to the TCP tick
+// <i>Default: 40
+// <0-400>
+#define TCP_DELAYED_ACK_TIMEOUT 40
+
+// <o>Segments per delayed ACK
+// <i>Full-sized segments that trigger an immediate ACK
+// <i>Default: 2
+// <1-8>
+#define TCP_DELAYED_ACK_SEGMENTS 2
+
+// <o>Receiver SWS avoidance divisor
+// <i>The receive window reopens once the smaller of the MSS and the
+// <i>buffer size divided by this value is free
+// <i>Default: 2
+// <1-8>
+#define TCP_RX_SWS_DIVISOR 2
+
+// <q>TCP receive coalescing
+// <i>Merge the in-order data segments of a flow received in the same RX
+// <i>batch before TCP processing (requires batched RX delivery)
+// <i>Default: Disabled
+#define TCP_GRO_SUPPORT 1
+
+// <o>Number of flows coalesced at the same time
+// <i>Default: 4
+// <1-16>
+#define TCP_GRO_FLOW_COUNT 4
+
+// <o>Maximum number of segments coalesced into one
+// <i>Default: 4
+// <2-8>
+#define TCP_GRO_MAX_SEGMENTS 4
+
+// <o>TCP timer resolution (ms)
+// <i>Slot width of the timer wheel, sockets are only visited when one of their timers is due
+// <i>Default: 100
+// <10-100>
+#define TCP_TICK_INTERVAL 10
+
+// <o>TCP timer wheel size
+// <i>Number of slots, deadlines beyond one turn are revisited once per turn
+// <i>Default: 64
+// <8-256>
+#define TCP_TIMER_WHEEL_SIZE 64
+
+// <q>TCP pacing
+// <i>Spread the segments of a window over the round-trip time instead of
+// <i>sending them back-to-back
+// <i>Default: Disabled
+#define TCP_PACING_SUPPORT 1
+
+// <o>TIME-WAIT table size
+// <i>Connections in TIME-WAIT tracked without a socket (0 keeps the socket)
+// <i>Default: 0
+// <0-256>
+#define TCP_TIME_WAIT_TABLE_SIZE 32
+
+// <q>Window scale support
+// <i>Enable TCP window scale option
+// <i>Default: Disabled
+#define TCP_WINDOW_SCALE_SUPPORT 1
+
+// <q>Large buffer support
+// <i>Allow sockets to use large buffers from a dedicated pool
+// <i>Default: Disabled
+#define TCP_LARGE_BUFFER_SUPPORT 1
+
+// <o>Block size of the large buffer pool
+// <i>Block size of the large buffer pool
+// <i>Default: 8192
+// <1536-32768>
+#define TCP_LARGE_BUFFER_BLOCK_SIZE 7680
+
+// <o>Number of blocks in the large buffer pool
+// <i>Number of blocks in the large buffer pool
+// <i>Default: 4
+// <1-32>
+#define TCP_LARGE_BUFFER_BLOCK_COUNT 4
+
+// <q>Buffer auto-tuning support
+// <i>Size the TX and RX buffers after the measured bandwidth-delay product
+// <i>Default: Disabled
+#define TCP_AUTO_TUNE_SUPPORT 1
+
+// <o>Auto-tuning memory budget
+// <i>Memory shared by all sockets to grow their buffers
+// <i>Default: 24576
+// <0-1048576>
+#define TCP_AUTO_TUNE_BUDGET 24576
+
 // </h>
 // <h>UDP
 
@@ -748,6 +1367,19 @@
 // <1-100>
 #define UDP_RX_QUEUE_SIZE 4
 
+// <o>Fast path dispatch table size
+// <i>Number of per-port handlers that receive datagrams before the socket
+// <i>lookup (0 to disable, power of 2)
+// <i>Default: 0
+// <0-64>
+#define UDP_FAST_PATH_TABLE_SIZE 8
+
+// <q>Shared ports
+// <i>Deliver multicast and broadcast datagrams to every socket bound to
+// <i>the port with SO_REUSEPORT, by reference to a single buffer
+// <i>Default: Disabled
+#define UDP_SHARED_PORT_SUPPORT 1
+
 // </h>
 // <h>Socket
 
@@ -756,18 +1388,286 @@
 // <i>Default: 16
 // <1-100>
 //Number of sockets that can be opened simultaneously
-#define SOCKET_MAX_COUNT 16
+#define SOCKET_MAX_COUNT 32
+
+// <o>Maximum number of TCP sockets
+// <i>Number of TCP control blocks shared by the stream sockets; datagram and
+// <i>raw sockets do not take one
+// <i>Default: SOCKET_MAX_COUNT
+// <1-100>
+#define SOCKET_MAX_TCP_COUNT 24
+
+// <o>Socket demultiplexing cache size
+// <i>Number of entries of the hash-indexed demultiplexing cache (0 to disable)
+// <i>Default: 0
+// <0-256>
+#define SOCKET_HASH_TABLE_SIZE 32
 
 // <q>BSD socket support
 // <i>Enable BSD socket support
 // <i>Default: Disabled
-#define BSD_SOCKET_SUPPORT 0
+#define BSD_SOCKET_SUPPORT 1
+
+// <o>BSD socket poll batch size
+// <i>Number of ready sockets select and poll collect at a time
+// <i>Default: 4
+// <1-32>
+#define BSD_SOCKET_POLL_BATCH_SIZE 8
 
 // <q>Raw socket support
 // <i>Enable raw socket support
 // <i>Default: Disabled
 #define RAW_SOCKET_SUPPORT 0
 
+// <q>Per-socket lock
+// <i>Serialize data-path calls on each socket with its own mutex
+// <i>Default: Disabled
+#define SOCKET_LOCK_SUPPORT 1
+
+// <q>Per-socket route cache
+// <i>Cache the outgoing interface, source address and next-hop MAC address of each socket
+// <i>Default: Disabled
+#define SOCKET_ROUTE_CACHE_SUPPORT 1
+
+// <q>Poll sets
+// <i>Persistent sets of sockets whose waits only visit the ready sockets
+// <i>Default: Disabled
+#define SOCKET_POLL_SUPPORT 1
+
+// <q>Socket reactor
+// <i>Callback-driven sockets served by a few worker tasks
+// <i>Default: Disabled
+#define SOCKET_REACTOR_SUPPORT 1
+
+// <o>Socket reactor stack size (words)
+// <i>Stack of each worker task, which runs the handlers
+// <i>Default: 500
+#define SOCKET_REACTOR_STACK_SIZE 512
+
+// <q>Token-bucket shaping
+// <i>Rate limits per socket and per DSCP class selector, applied to the
+// <i>TCP sender and to the UDP send path
+// <i>Default: Disabled
+#define NET_SHAPER_SUPPORT 1
+
+// </h>
+// <h>DHCP Client
+
+// <o>INIT-REBOOT delay (ms)
+// <i>Upper bound of the random delay before requesting a saved lease again
+// <i>Default: 2000
+// <0-10000>
+#define DHCP_CLIENT_INIT_REBOOT_DELAY 0
+
+// </h>
+// <h>DHCP Server
+
+// <o>Maximum number of clients
+// <i>Number of bindings, sized for a machine-internal network
+// <i>Default: 16
+// <1-1024>
+#define DHCP_SERVER_MAX_CLIENTS 128
+
+// <o>Hash table size
+// <i>Buckets of the MAC and IP address lookup tables, power of two
+// <i>Default: 16
+// <1-1024>
+#define DHCP_SERVER_HASH_TABLE_SIZE 64
+
+// <o>Offer rate limit (offers/s)
+// <i>Pace of DHCPOFFER messages during a mass power-on, 0 for no limit
+// <i>Default: 0
+// <0-1000>
+#define DHCP_SERVER_OFFER_RATE_LIMIT 50
+
+// <o>Offer burst
+// <i>DHCPOFFER messages that can be sent back to back
+// <i>Default: 8
+// <1-256>
+#define DHCP_SERVER_OFFER_BURST 16
+
+// <o>Offer holdoff (ms)
+// <i>Retransmitted DHCPDISCOVER messages are ignored this long after an offer
+// <i>Default: 0
+// <0-4000>
+#define DHCP_SERVER_OFFER_HOLDOFF 500
+
+// <o>Lease table store delay (ms)
+// <i>Changes are saved once the lease table is stable for this long
+// <i>Default: 5000
+// <0-60000>
+#define DHCP_SERVER_STORE_DELAY 10000
+
+// </h>
+// <h>DNS Client
+
+// <o>DNS cache size
+// <i>Number of entries of the DNS cache
+// <i>Default: 8
+// <1-255>
+#define DNS_CACHE_SIZE 24
+
+// <o>DNS cache hash buckets
+// <i>Number of hash buckets the DNS cache entries are distributed into
+// <i>Default: 16
+// <1-256>
+#define DNS_CACHE_HASH_SIZE 16
+
+// <q>Negative caching
+// <i>Remember non-existent names and unanswered queries
+// <i>Default: Disabled
+#define DNS_NEGATIVE_CACHE_SUPPORT 1
+
+// <o>Negative entry lifetime (ms)
+// <i>Lifetime of the negative DNS cache entries
+// <i>Default: 30000
+// <1000-3600000>
+#define DNS_NEGATIVE_LIFETIME 30000
+
+// <q>Refresh-ahead
+// <i>Query again the names in use shortly before their TTL expires
+// <i>Default: Disabled
+#define DNS_CACHE_PREFETCH_SUPPORT 1
+
+// <o>Refresh-ahead threshold (ms)
+// <i>Remaining lifetime below which a DNS cache entry in use is refreshed
+// <i>Default: 10000
+// <1000-3600000>
+#define DNS_CACHE_PREFETCH_THRESHOLD 10000
+
+// <q>Parallel queries
+// <i>Query all the DNS servers at once and keep the first valid answer
+// <i>Default: Disabled
+#define DNS_CLIENT_PARALLEL_SUPPORT 1
+
+// <o>Tracked DNS servers
+// <i>Number of DNS servers whose round-trip time is tracked to prefer the fastest
+// <i>Default: 4
+// <1-16>
+#define DNS_CLIENT_RTT_TABLE_SIZE 4
+
+// </h>
+// <h>mDNS Client
+
+// <q>Passive caching
+// <i>Cache the A and AAAA records of the .local names seen on the link
+// <i>Default: Disabled
+#define MDNS_CLIENT_PASSIVE_CACHE_SUPPORT 1
+
+// </h>
+// <h>mDNS Responder
+
+// <q>Precomputed answers
+// <i>Answer host name queries with records serialized once per host name or address change
+// <i>Default: Disabled
+#define MDNS_RESPONDER_ANSWER_CACHE_SUPPORT 1
+
+// <o>Precomputed answer size
+// <i>Size of the buffer holding the precomputed records, in bytes
+// <i>Default: 256
+// <64-1024>
+#define MDNS_RESPONDER_ANSWER_CACHE_SIZE 256
+
+// <o>Answer interval (ms)
+// <i>A question answered by multicast less than this long ago is not answered again
+// <i>Default: 1000
+// <0-10000>
+#define MDNS_RESPONDER_ANSWER_INTERVAL 1000
+
+// </h>
+// <h>HTTP Client
+
+// <q>Connection pool
+// <i>Keep HTTP/1.1 connections open across requests to the same server
+// <i>Default: Disabled
+#define HTTP_CLIENT_POOL_SUPPORT 1
+
+// <o>Number of pooled connections
+// <i>Each connection holds a complete HTTP client context
+// <i>Default: 2
+// <1-8>
+#define HTTP_CLIENT_POOL_SIZE 2
+
+// <o>Idle timeout
+// <i>Time after which an idle connection is closed (in milliseconds),
+// <i>shorter than the keep-alive timeout of the server
+// <i>Default: 30000
+// <1000-600000>
+#define HTTP_CLIENT_POOL_IDLE_TIMEOUT 4000
+
+// <q>Request pipelining
+// <i>Send several requests on a connection before reading the responses
+// <i>Default: Disabled
+#define HTTP_CLIENT_PIPELINING_SUPPORT 1
+
+// <o>Maximum number of pipelined requests
+// <i>Requests sent and awaiting a response on one connection
+// <i>Default: 4
+// <1-16>
+#define HTTP_CLIENT_MAX_PIPELINED_REQUESTS 4
+
+// <q>Streaming body API
+// <i>Produce the request body into the client buffer and consume the
+// <i>response body from the TCP receive buffer
+// <i>Default: Disabled
+#define HTTP_CLIENT_STREAMING_SUPPORT 1
+
+// <o>Maximum number of indexed header fields
+// <i>Response header fields located without scanning the buffer
+// <i>Default: 24
+// <1-64>
+#define HTTP_CLIENT_MAX_HEADER_FIELDS 24
+
+// <q>Content decoding
+// <i>Decompress responses sent with Content-Encoding gzip or deflate
+// <i>Default: Disabled
+#define HTTP_CLIENT_INFLATE_SUPPORT 1
+
+// <o>Decoding window size
+// <i>Farthest distance a compressed match can refer to (in bytes).
+// <i>Streams compressed with a larger window are rejected
+// <i>Default: 32768
+// <256-32768>
+#define HTTP_CLIENT_INFLATE_WINDOW_SIZE 32768
+
+// <q>Resumable download
+// <i>Fetch large files with range requests, resuming after a failure
+// <i>Default: Disabled
+#define HTTP_CLIENT_DOWNLOAD_SUPPORT 1
+
+// <o>Download block size
+// <i>Length of each range request (in bytes). Two buffers of this
+// <i>size are held by the download context
+// <i>Default: 4096
+// <256-65536>
+#define HTTP_CLIENT_DOWNLOAD_BLOCK_SIZE 4096
+
+// <o>Maximum number of download retries
+// <i>Consecutive failed attempts before the download is abandoned
+// <i>Default: 10
+// <0-100>
+#define HTTP_CLIENT_DOWNLOAD_MAX_RETRIES 10
+
+// <o>TLS TX buffer size
+// <i>Used once HTTP over TLS is enabled (in bytes)
+// <i>Default: 2048
+// <512-16384>
+#define HTTP_CLIENT_TLS_TX_BUFFER_SIZE 2048
+
+// <o>TLS RX buffer size
+// <i>Largest TLS record accepted (in bytes). TLS 1.3 servers are held to
+// <i>it by the record_size_limit extension
+// <i>Default: 16384
+// <512-16384>
+#define HTTP_CLIENT_TLS_RX_BUFFER_SIZE 4096
+
+// <o>TLS maximum fragment length
+// <i>Requested from the server with the max_fragment_length extension
+// <i>(in bytes), for the servers without record size limit. 0 to disable
+// <i>Default: 0
+// <0=> Disabled <512=> 512 <1024=> 1024 <2048=> 2048 <4096=> 4096
+#define HTTP_CLIENT_TLS_MAX_FRAG_LEN 4096
+
 // </h>
 // <h>HTTP Server
 
@@ -1367,8 +2267,8 @@
    #define PING_SUPPORT DISABLED
 #endif
 
-//PPP support
-#ifdef RTE_CYCLONE_TCP_PPP
+//PPP support (the modem is an uplink of the gateway profiles)
+#if defined(RTE_CYCLONE_TCP_PPP) && (NET_PROFILE != NET_PROFILE_RT_NODE)
    #define PPP_SUPPORT ENABLED
 #else
    #define PPP_SUPPORT DISABLED
@@ -1388,4 +2288,86 @@
    #define CHAP_SUPPORT DISABLED
 #endif
 
+//Hooks and memory placement of the target. A host build (os_port_posix.h,
+//pcap_driver.c) runs the stack with the defaults
+#ifndef USE_POSIX
+
+//Ethernet interrupt timing for the application's run-time statistics
+#include "RunTimeStats.h"
+#define STM32H7XX_ETH_IRQ_ENTER_HOOK() vRunTimeStatsIsrEnter(RUN_TIME_STATS_ISR_ETH)
+#define STM32H7XX_ETH_IRQ_EXIT_HOOK() vRunTimeStatsIsrExit(RUN_TIME_STATS_ISR_ETH)
+
+//Events of the TCP/IP task and periodic operations in the binary trace
+#include "TraceRecorderHooks.h"
+#if (TRACE_RECORDER == 1)
+#define NET_EVENT_ENTER_HOOK() vTraceRecorderUserEvent(TRACE_USER_NET_EVENT_ENTER, 0, 0)
+#define NET_EVENT_EXIT_HOOK() vTraceRecorderUserEvent(TRACE_USER_NET_EVENT_EXIT, 0, 0)
+#define NET_TICK_ENTER_HOOK() vTraceRecorderUserEvent(TRACE_USER_NET_TICK_ENTER, 0, 0)
+#define NET_TICK_EXIT_HOOK(timeout) \
+   vTraceRecorderUserEvent(TRACE_USER_NET_TICK_EXIT, (uint16_t) MIN(timeout, UINT16_MAX), 0)
+#endif
+
+//Random numbers from the RNG peripheral, drawn without taking netMutex
+#include "HwRng.h"
+#define NET_RAND_SOURCE() ulHwRngGet()
+#define NET_RAND_DATA_SOURCE(data, length) vHwRngGetData(data, length)
+
+//Heartbeats of the TCP/IP and control tasks, supervised by the watchdog
+#include "Watchdog.h"
+#define NET_TASK_ALIVE_HOOK() vWatchdogKick()
+#define NET_TASK_ALIVE_INTERVAL WATCHDOG_IDLE_WAIT_MS
+
+//Bulk copies of the socket buffers and of the driver TX path on the MDMA
+#include "MdmaCopy.h"
+#define NET_BULK_COPY(dest, src, length) vMdmaCopy(dest, src, length)
+
+//Receive path latency is measured with the DWT cycle counter
+#include "stm32h7xx.h"
+#define NET_LATENCY_TIMESTAMP() (DWT->CYCCNT)
+#define NET_LATENCY_CLOCK_HZ SystemCoreClock
+
+//Received frames are stamped with the microsecond clock (TIM5)
+#include "MonoClock.h"
+#define NIC_RX_TIME_US() ullMonoClockNowUs()
+#define NET_CAPTURE_TIME_US() ullMonoClockNowUs()
+
+//Transmit time stamps of the PTP slave (Delay_Req)
+#include "PtpSlave.h"
+#define ETH_TX_TIMESTAMP_HOOK(interface, timestampId, timestamp) \
+   vPtpSlaveTxTimestamp(timestampId, (timestamp)->s, (timestamp)->ns)
+
+//Large TCP buffers are placed in the AHB SRAM of the D2 domain, after the
+//non-cacheable region (4 blocks of 7.5 KB fill the remaining 30 KB)
+#define TCP_LARGE_BUFFER_SECTION ".ram_d2"
+
+//Functions of the packet path (checksums, TCP and UDP input, Ethernet driver
+//interrupt, RX and TX) run from the ITCM, copied there at start
+#define NET_FAST_CODE_SECTION ".itcm_text"
+
+//The rest of the packet path is grouped in flash for the instruction cache,
+//the debug dumps and error replies are moved away from it
+#define NET_HOT_COLD_SUPPORT ENABLED
+
+//The socket table is placed in the DTCM. The memory pool stays in the AXI
+//SRAM: the Ethernet DMA reads and writes its buffers (zero-copy TX, RX loans)
+#define SOCKET_TABLE_SECTION ".dtcm_bss"
+
+#else
+
+//Time stamps of the host, in milliseconds
+#define NET_LATENCY_TIMESTAMP() ((uint32_t) osGetSystemTime())
+#define NET_LATENCY_CLOCK_HZ 1000
+#define NIC_RX_TIME_US() ((uint64_t) osGetSystemTime() * 1000)
+#define NET_CAPTURE_TIME_US() ((uint64_t) osGetSystemTime() * 1000)
+
+#endif
+
+//Periodic operations are gathered into one deadline for the net task, for
+//the tickless idle of FreeRTOS (see LowPower.h)
+#define NET_TICKLESS_SUPPORT ENABLED
+
+//Periodic operations (DHCP, mDNS, DNS, ARP and link polling) run in a task of
+//their own, below the TCP/IP task that handles the driver and the packet path
+#define NET_CONTROL_TASK_SUPPORT ENABLED
+
 #endif
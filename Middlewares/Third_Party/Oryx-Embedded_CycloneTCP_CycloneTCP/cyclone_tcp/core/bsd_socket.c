@@ -44,6 +44,7 @@
 //Dependencies
 #include "core/bsd_socket_options.h"
 #include "core/bsd_socket_misc.h"
+#include "core/socket_poll.h"
 
 //Common IPv6 addresses
 const struct in6_addr in6addr_any =
@@ -482,10 +483,17 @@ int_t send(int_t s, const void *data, size_t length, int_t flags)
       socketFlags |= SOCKET_FLAG_DONT_ROUTE;
    }
 
-   //The TCP_NODELAY option disables the Nagle algorithm for TCP sockets
-   if((sock->options & SOCKET_OPTION_TCP_NO_DELAY) != 0)
+   //The MSG_MORE flag indicates that more data is about to be sent (the
+   //TCP_NODELAY and TCP_CORK options are applied by the TCP layer)
+   if((flags & MSG_MORE) != 0)
    {
-      socketFlags |= SOCKET_FLAG_NO_DELAY;
+      socketFlags |= SOCKET_FLAG_MORE;
+   }
+
+   //The MSG_DONTWAIT flag enables non-blocking operation
+   if((flags & MSG_DONTWAIT) != 0)
+   {
+      socketFlags |= SOCKET_FLAG_DONT_WAIT;
    }
 
    //Send data
@@ -561,10 +569,17 @@ int_t sendto(int_t s, const void *data, size_t length, int_t flags,
       socketFlags |= SOCKET_FLAG_DONT_ROUTE;
    }
 
-   //The TCP_NODELAY option disables the Nagle algorithm for TCP sockets
-   if((sock->options & SOCKET_OPTION_TCP_NO_DELAY) != 0)
+   //The MSG_MORE flag indicates that more data is about to be sent (the
+   //TCP_NODELAY and TCP_CORK options are applied by the TCP layer)
+   if((flags & MSG_MORE) != 0)
+   {
+      socketFlags |= SOCKET_FLAG_MORE;
+   }
+
+   //The MSG_DONTWAIT flag enables non-blocking operation
+   if((flags & MSG_DONTWAIT) != 0)
    {
-      socketFlags |= SOCKET_FLAG_NO_DELAY;
+      socketFlags |= SOCKET_FLAG_DONT_WAIT;
    }
 
    //Check the length of the address
@@ -616,9 +631,34 @@ int_t sendto(int_t s, const void *data, size_t length, int_t flags,
       return SOCKET_ERROR;
    }
 
-   //Send data
-   error = socketSendTo(sock, &ipAddr, port, data, length, &written,
-      socketFlags);
+   //With MSG_ZEROCOPY, a datagram payload lying in a loaned memory region is
+   //sent in place and given back through the callback of the region
+   if((flags & MSG_ZEROCOPY) != 0 && sock->type == SOCKET_TYPE_DGRAM)
+   {
+      SocketMsg message;
+
+      //Describe the datagram
+      message = SOCKET_DEFAULT_MSG;
+      message.data = (void *) data;
+      message.length = length;
+      message.destIpAddr = ipAddr;
+      message.destPort = port;
+
+      //Send the payload without copying it
+      error = socketSendLoanedMsg(sock, &message, socketFlags);
+      written = (error == NO_ERROR) ? length : 0;
+   }
+   else
+   {
+      error = ERROR_NOT_IMPLEMENTED;
+   }
+
+   //Otherwise the payload is copied
+   if(error == ERROR_NOT_IMPLEMENTED || error == ERROR_INVALID_ADDRESS)
+   {
+      error = socketSendTo(sock, &ipAddr, port, data, length, &written,
+         socketFlags);
+   }
 
    //Any error to report?
    if(error == ERROR_TIMEOUT)
@@ -881,14 +921,35 @@ int_t sendmsg(int_t s, struct msghdr *msg, int_t flags)
       socketFlags |= SOCKET_FLAG_DONT_ROUTE;
    }
 
-   //The TCP_NODELAY option disables the Nagle algorithm for TCP sockets
-   if((sock->options & SOCKET_OPTION_TCP_NO_DELAY) != 0)
+   //The MSG_MORE flag indicates that more data is about to be sent (the
+   //TCP_NODELAY and TCP_CORK options are applied by the TCP layer)
+   if((flags & MSG_MORE) != 0)
+   {
+      socketFlags |= SOCKET_FLAG_MORE;
+   }
+
+   //The MSG_DONTWAIT flag enables non-blocking operation
+   if((flags & MSG_DONTWAIT) != 0)
    {
-      socketFlags |= SOCKET_FLAG_NO_DELAY;
+      socketFlags |= SOCKET_FLAG_DONT_WAIT;
    }
 
-   //Send message
-   error = socketSendMsg(sock, &message, socketFlags);
+   //With MSG_ZEROCOPY, a datagram payload lying in a loaned memory region is
+   //sent in place and given back through the callback of the region
+   if((flags & MSG_ZEROCOPY) != 0 && sock->type == SOCKET_TYPE_DGRAM)
+   {
+      error = socketSendLoanedMsg(sock, &message, socketFlags);
+   }
+   else
+   {
+      error = ERROR_NOT_IMPLEMENTED;
+   }
+
+   //Otherwise the payload is copied
+   if(error == ERROR_NOT_IMPLEMENTED || error == ERROR_INVALID_ADDRESS)
+   {
+      error = socketSendMsg(sock, &message, socketFlags);
+   }
 
    //Any error to report?
    if(error != NO_ERROR)
@@ -1701,6 +1762,11 @@ int_t setsockopt(int_t s, int_t level, int_t optname, const void *optval,
             //Set SO_BROADCAST option
             ret = socketSetSoBroadcastOption(sock, optval, optlen);
          }
+         else if(optname == SO_REUSEPORT)
+         {
+            //Set SO_REUSEPORT option
+            ret = socketSetSoReusePortOption(sock, optval, optlen);
+         }
          else if(optname == SO_SNDTIMEO)
          {
             //Set SO_SNDTIMEO option
@@ -1982,6 +2048,16 @@ int_t setsockopt(int_t s, int_t level, int_t optname, const void *optval,
             //Set TCP_KEEPCNT option
             ret = socketSetTcpKeepCntOption(sock, optval, optlen);
          }
+         else if(optname == TCP_QUICKACK)
+         {
+            //Set TCP_QUICKACK option
+            ret = socketSetTcpQuickAckOption(sock, optval, optlen);
+         }
+         else if(optname == TCP_CORK)
+         {
+            //Set TCP_CORK option
+            ret = socketSetTcpCorkOption(sock, optval, optlen);
+         }
          else
          {
             //Unknown option
@@ -2066,6 +2142,11 @@ int_t getsockopt(int_t s, int_t level, int_t optname, void *optval,
             //Get SO_BROADCAST option
             ret = socketGetSoBroadcastOption(sock, optval, optlen);
          }
+         else if(optname == SO_REUSEPORT)
+         {
+            //Get SO_REUSEPORT option
+            ret = socketGetSoReusePortOption(sock, optval, optlen);
+         }
          else if(optname == SO_SNDTIMEO)
          {
             //Get SO_SNDTIMEO option
@@ -2268,6 +2349,16 @@ int_t getsockopt(int_t s, int_t level, int_t optname, void *optval,
             //Get TCP_KEEPCNT option
             ret = socketGetTcpKeepCntOption(sock, optval, optlen);
          }
+         else if(optname == TCP_QUICKACK)
+         {
+            //Get TCP_QUICKACK option
+            ret = socketGetTcpQuickAckOption(sock, optval, optlen);
+         }
+         else if(optname == TCP_CORK)
+         {
+            //Get TCP_CORK option
+            ret = socketGetTcpCorkOption(sock, optval, optlen);
+         }
          else
          {
             //Unknown option
@@ -2872,7 +2963,7 @@ int_t ioctlsocket(int_t s, uint32_t cmd, void *arg)
          //Cast the parameter to the relevant type
          val = (uint_t *) arg;
          //Return the actual value
-         *val = sock->rcvUser;
+         *val = (sock->type == SOCKET_TYPE_STREAM) ? sock->tcb->rcvUser : 0;
          //Successful processing
          ret = SOCKET_SUCCESS;
          break;
@@ -2883,7 +2974,8 @@ int_t ioctlsocket(int_t s, uint32_t cmd, void *arg)
          //Cast the parameter to the relevant type
          val = (uint_t *) arg;
          //Return the actual value
-         *val = sock->sndUser + sock->sndNxt - sock->sndUna;
+         *val = (sock->type == SOCKET_TYPE_STREAM) ? sock->tcb->sndUser +
+            sock->tcb->sndNxt - sock->tcb->sndUna : 0;
          //Successful processing
          ret = SOCKET_SUCCESS;
          break;
@@ -2893,8 +2985,8 @@ int_t ioctlsocket(int_t s, uint32_t cmd, void *arg)
          //Cast the parameter to the relevant type
          val = (uint_t *) arg;
          //Return the actual value
-         *val = sock->txBufferSize - (sock->sndUser + sock->sndNxt -
-            sock->sndUna);
+         *val = (sock->type == SOCKET_TYPE_STREAM) ? sock->tcb->txBufferSize -
+            (sock->tcb->sndUser + sock->tcb->sndNxt - sock->tcb->sndUna) : 0;
          //Successful processing
          ret = SOCKET_SUCCESS;
          break;
@@ -3047,6 +3139,160 @@ int_t closesocket(int_t s)
 }
 
 
+#if (SOCKET_POLL_SUPPORT == ENABLED)
+
+/**
+ * @brief Wait for events on a set of descriptors
+ *
+ * The sockets are added to a poll set for the duration of the call. The wait
+ * costs a single event object whatever the number of descriptors, and only
+ * the sockets that have become ready are visited afterwards
+ *
+ * @param[in,out] fds Array of descriptors, with the events to check
+ * @param[in] nfds Number of entries in the array
+ * @param[in] timeout Maximum time to wait
+ * @return Number of descriptors with events to report, or SOCKET_ERROR
+ **/
+
+static int_t socketPollFds(struct pollfd *fds, nfds_t nfds, systime_t timeout)
+{
+   error_t error;
+   nfds_t i;
+   uint_t j;
+   uint_t count;
+   uint_t eventMask;
+   int_t n;
+   int16_t revents;
+   Socket *sock;
+   SocketPollSet set;
+   SocketEventDesc eventDesc[BSD_SOCKET_POLL_BATCH_SIZE];
+
+   //Create the poll set
+   if(socketPollCreate(&set))
+   {
+      BSD_SOCKET_SET_ERRNO(ENOBUFS);
+      return SOCKET_ERROR;
+   }
+
+   //Number of descriptors with events to report
+   n = 0;
+
+   //Add the sockets to the set
+   for(i = 0; i < nfds; i++)
+   {
+      //No events reported yet
+      fds[i].revents = 0;
+
+      //Negative descriptors are ignored
+      if(fds[i].fd < 0)
+         continue;
+
+      //Point to the socket structure
+      sock = (fds[i].fd < SOCKET_MAX_COUNT) ? &socketTable[fds[i].fd] : NULL;
+
+      //Invalid or closed descriptor?
+      if(sock == NULL || sock->type == SOCKET_TYPE_UNUSED)
+      {
+         fds[i].revents = POLLNVAL;
+         n++;
+         continue;
+      }
+
+      //Closure is always reported
+      eventMask = SOCKET_EVENT_CLOSED;
+
+      if((fds[i].events & POLLIN) != 0)
+      {
+         eventMask |= SOCKET_EVENT_RX_READY;
+      }
+
+      if((fds[i].events & POLLOUT) != 0)
+      {
+         eventMask |= SOCKET_EVENT_TX_READY;
+      }
+
+      //Edge-triggered, so that each ready socket is collected once
+      error = socketPollAdd(&set, sock, eventMask, SOCKET_POLL_MODE_EDGE);
+
+      //The same descriptor may appear more than once in the array
+      if(error == ERROR_ALREADY_CONFIGURED && sock->pollSet == &set)
+      {
+         error = socketPollModify(&set, sock, sock->pollMask | eventMask,
+            SOCKET_POLL_MODE_EDGE);
+      }
+
+      //The socket may already belong to another poll set
+      if(error)
+      {
+         fds[i].revents = POLLNVAL;
+         n++;
+      }
+   }
+
+   //Descriptors in error are reported without waiting
+   if(n > 0)
+   {
+      timeout = 0;
+   }
+
+   //Collect the ready sockets
+   do
+   {
+      //Only the first wait blocks
+      error = socketPollWait(&set, eventDesc, arraysize(eventDesc), &count,
+         timeout);
+      timeout = 0;
+
+      //Report the events to the matching descriptors
+      for(j = 0; j < count; j++)
+      {
+         for(i = 0; i < nfds; i++)
+         {
+            if(fds[i].fd != (int_t) eventDesc[j].socket->descriptor)
+               continue;
+
+            revents = 0;
+
+            if((eventDesc[j].eventFlags & SOCKET_EVENT_RX_READY) != 0 &&
+               (fds[i].events & POLLIN) != 0)
+            {
+               revents |= POLLIN;
+            }
+
+            if((eventDesc[j].eventFlags & SOCKET_EVENT_TX_READY) != 0 &&
+               (fds[i].events & POLLOUT) != 0)
+            {
+               revents |= POLLOUT;
+            }
+
+            if((eventDesc[j].eventFlags & SOCKET_EVENT_CLOSED) != 0)
+            {
+               revents |= POLLHUP;
+            }
+
+            //Count each descriptor once
+            if(fds[i].revents == 0 && revents != 0)
+            {
+               n++;
+            }
+
+            fds[i].revents |= revents;
+         }
+      }
+
+      //A full batch means more sockets may be ready
+   } while(!error && count == arraysize(eventDesc));
+
+   //Remove the sockets and delete the poll set
+   socketPollDelete(&set);
+
+   //Return the number of descriptors with events to report
+   return n;
+}
+
+#endif
+
+
 /**
  * @brief Determine the status of one or more sockets
  *
@@ -3071,6 +3317,165 @@ int_t closesocket(int_t s)
 int_t select(int_t nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
    const struct timeval *timeout)
 {
+#if (SOCKET_POLL_SUPPORT == ENABLED)
+   int_t i;
+   int_t j;
+   int_t n;
+   int_t s;
+   nfds_t k;
+   nfds_t count;
+   systime_t time;
+   int16_t events;
+   fd_set *fds;
+   struct pollfd pollFds[MIN(3 * FD_SETSIZE, SOCKET_MAX_COUNT)];
+
+   //Number of distinct descriptors
+   count = 0;
+
+   //Parse all the descriptor sets
+   for(i = 0; i < 3; i++)
+   {
+      //Select the suitable descriptor set
+      switch(i)
+      {
+      case 0:
+         //Set of sockets to be checked for readability
+         fds = readfds;
+         events = POLLIN;
+         break;
+
+      case 1:
+         //Set of sockets to be checked for writability
+         fds = writefds;
+         events = POLLOUT;
+         break;
+
+      default:
+         //Set of sockets to be checked for errors
+         fds = exceptfds;
+         events = 0;
+         break;
+      }
+
+      //Each descriptor is optional and may be omitted
+      if(fds != NULL)
+      {
+         //Parse the current set of sockets
+         for(j = 0; j < fds->fd_count; j++)
+         {
+            //Get the descriptor associated with the current entry
+            s = fds->fd_array[j];
+
+            //Invalid socket descriptor?
+            if(s < 0 || s >= SOCKET_MAX_COUNT)
+            {
+               //Report an error
+               return SOCKET_ERROR;
+            }
+
+            //A socket listed in several sets is checked once
+            for(k = 0; k < count && pollFds[k].fd != s; k++)
+            {
+            }
+
+            //New descriptor?
+            if(k == count)
+            {
+               pollFds[count].fd = s;
+               pollFds[count].events = 0;
+               count++;
+            }
+
+            //Add the events to check for this set
+            pollFds[k].events |= events;
+         }
+      }
+   }
+
+   //Retrieve timeout value
+   if(timeout != NULL)
+   {
+      time = timeout->tv_sec * 1000 + timeout->tv_usec / 1000;
+   }
+   else
+   {
+      time = INFINITE_DELAY;
+   }
+
+   //Wait for the sockets to become ready
+   if(socketPollFds(pollFds, count, time) < 0)
+   {
+      return SOCKET_ERROR;
+   }
+
+   //Count the number of events in the signaled state
+   n = 0;
+
+   //Parse all the descriptor sets
+   for(i = 0; i < 3; i++)
+   {
+      //Select the suitable descriptor set
+      switch(i)
+      {
+      case 0:
+         //Set of sockets to be checked for readability
+         fds = readfds;
+         events = POLLIN;
+         break;
+
+      case 1:
+         //Set of sockets to be checked for writability
+         fds = writefds;
+         events = POLLOUT;
+         break;
+
+      default:
+         //Set of sockets to be checked for errors
+         fds = exceptfds;
+         events = POLLHUP;
+         break;
+      }
+
+      //Each descriptor is optional and may be omitted
+      if(fds != NULL)
+      {
+         //Parse the current set of sockets
+         for(j = 0; j < fds->fd_count; )
+         {
+            //Get the descriptor associated with the current entry
+            s = fds->fd_array[j];
+
+            //Retrieve the events reported for the socket
+            for(k = 0; pollFds[k].fd != s; k++)
+            {
+            }
+
+            //A closed or unusable descriptor is an error
+            if((pollFds[k].revents & POLLNVAL) != 0)
+            {
+               return SOCKET_ERROR;
+            }
+
+            //Event flag is set?
+            if((pollFds[k].revents & events) != 0)
+            {
+               //Track the number of events in the signaled state
+               n++;
+               //Jump to the next socket descriptor
+               j++;
+            }
+            else
+            {
+               //Remove descriptor from the current set
+               socketFdClr(fds, s);
+            }
+         }
+      }
+   }
+
+   //Return the number of events in the signaled state
+   return n;
+#else
    int_t i;
    int_t j;
    int_t n;
@@ -3240,6 +3645,53 @@ int_t select(int_t nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
    osDeleteEvent(&event);
    //Return the number of events in the signaled state
    return n;
+#endif
+}
+
+
+/**
+ * @brief Wait for events on a set of sockets
+ *
+ * Unlike select, the events of each socket are given and returned in its own
+ * pollfd entry, and the number of sockets is not bounded by FD_SETSIZE
+ *
+ * @param[in,out] fds Array of descriptors, with the events to check
+ * @param[in] nfds Number of entries in the array
+ * @param[in] timeout The maximum time to wait, in milliseconds. A negative
+ *   value means an infinite timeout
+ * @return The number of descriptors whose revents field is non-zero, zero if
+ *   the time limit expired, or SOCKET_ERROR if an error occurred
+ **/
+
+int_t poll(struct pollfd *fds, nfds_t nfds, int_t timeout)
+{
+#if (SOCKET_POLL_SUPPORT == ENABLED)
+   systime_t time;
+
+   //Check parameters
+   if(fds == NULL && nfds != 0)
+   {
+      BSD_SOCKET_SET_ERRNO(EFAULT);
+      return SOCKET_ERROR;
+   }
+
+   //Retrieve timeout value
+   if(timeout >= 0)
+   {
+      time = timeout;
+   }
+   else
+   {
+      time = INFINITE_DELAY;
+   }
+
+   //Wait for the sockets to become ready
+   return socketPollFds(fds, nfds, time);
+#else
+   //Poll sets are required
+   BSD_SOCKET_SET_ERRNO(EOPNOTSUPP);
+   return SOCKET_ERROR;
+#endif
 }
 
 
@@ -45,6 +45,13 @@
    #error FD_SETSIZE parameter is not valid
 #endif
 
+//Number of ready sockets collected at a time by select and poll
+#ifndef BSD_SOCKET_POLL_BATCH_SIZE
+   #define BSD_SOCKET_POLL_BATCH_SIZE 4
+#elif (BSD_SOCKET_POLL_BATCH_SIZE < 1)
+   #error BSD_SOCKET_POLL_BATCH_SIZE parameter is not valid
+#endif
+
 //Set errno variable
 #ifndef BSD_SOCKET_SET_ERRNO
    #define BSD_SOCKET_SET_ERRNO(e)
@@ -74,6 +81,16 @@
 //Dependencies
 #include "os_port.h"
 
+//The C library may already declare fd_set and select, through sys/types.h
+//(newlib and glibc do unless compiling strict ISO C). The ones of this layer
+//are given other names so that they do not conflict
+#undef FD_ZERO
+#undef FD_SET
+#undef FD_CLR
+#undef FD_ISSET
+#define fd_set socket_fd_set
+#define select socketSelect
+
 //Address families
 #define AF_UNSPEC 0
 #define AF_INET   2
@@ -122,6 +139,16 @@
 #define MSG_CTRUNC    0x0008
 #define MSG_DONTWAIT  0x0040
 #define MSG_WAITALL   0x0100
+#define MSG_MORE      0x8000
+#define MSG_ZEROCOPY  0x4000000
+
+//Events used by poll function
+#define POLLIN   0x0001
+#define POLLPRI  0x0002
+#define POLLOUT  0x0004
+#define POLLERR  0x0008
+#define POLLHUP  0x0010
+#define POLLNVAL 0x0020
 
 //Flags used by shutdown function
 #define SD_RECEIVE 0
@@ -144,6 +171,7 @@
 #define SO_KEEPALIVE    9
 #define SO_NO_CHECK     11
 #define SO_LINGER       13
+#define SO_REUSEPORT    15
 #define SO_SNDTIMEO     20
 #define SO_RCVTIMEO     21
 #define SO_BINDTODEVICE 25
@@ -191,9 +219,11 @@
 //TCP level options
 #define TCP_NODELAY   1
 #define TCP_MAXSEG    2
+#define TCP_CORK      3
 #define TCP_KEEPIDLE  4
 #define TCP_KEEPINTVL 5
 #define TCP_KEEPCNT   6
+#define TCP_QUICKACK  12
 
 //IP TOS option
 #define IPTOS_LOWDELAY    0x10
@@ -533,6 +563,25 @@ typedef struct fd_set
 } fd_set, FD_SET, *PFD_SET;
 
 
+/**
+ * @brief Descriptor to be checked by poll
+ **/
+
+typedef struct pollfd
+{
+   int_t fd;
+   int16_t events;
+   int16_t revents;
+} POLLFD, *PPOLLFD;
+
+
+/**
+ * @brief Number of entries of a pollfd array
+ **/
+
+typedef uint_t nfds_t;
+
+
 /**
  * @brief Information about a given host
  **/
@@ -562,7 +611,7 @@ typedef struct addrinfo
 } ADDRINFO, *PADDRINFO;
 
 
-#ifndef _TIMEVAL_DEFINED
+#if !defined(_TIMEVAL_DEFINED) && !defined(__timeval_defined)
 
 /**
  * @brief Timeout structure
@@ -657,6 +706,8 @@ int_t closesocket(int_t s);
 int_t select(int_t nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
    const struct timeval *timeout);
 
+int_t poll(struct pollfd *fds, nfds_t nfds, int_t timeout);
+
 int_t gethostname(char_t *name, size_t len);
 struct hostent *gethostbyname(const char_t *name);
 
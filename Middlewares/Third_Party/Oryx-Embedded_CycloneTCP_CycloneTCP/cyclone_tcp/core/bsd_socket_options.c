@@ -131,6 +131,43 @@ int_t socketSetSoBroadcastOption(Socket *socket, const int_t *optval,
 }
 
 
+/**
+ * @brief Set SO_REUSEPORT option
+ * @param[in] socket Handle referencing the socket
+ * @param[in] optval A pointer to the buffer in which the value for the
+ *   requested option is specified
+ * @param[in] optlen The size, in bytes, of the buffer pointed to by the optval
+ *   parameter
+ * @return Error code (SOCKET_SUCCESS or SOCKET_ERROR)
+ **/
+
+int_t socketSetSoReusePortOption(Socket *socket, const int_t *optval,
+   socklen_t optlen)
+{
+   int_t ret;
+
+   //Check the length of the option
+   if(optlen >= (socklen_t) sizeof(int_t))
+   {
+      //This option specifies whether multicast and broadcast datagrams are
+      //delivered to every socket bound to the same port
+      socketEnableReusePort(socket, *optval);
+
+      //Successful processing
+      ret = SOCKET_SUCCESS;
+   }
+   else
+   {
+      //The option length is not valid
+      socketSetErrnoCode(socket, EFAULT);
+      ret = SOCKET_ERROR;
+   }
+
+   //Return status code
+   return ret;
+}
+
+
 /**
  * @brief Set SO_SNDTIMEO option
  * @param[in] socket Handle referencing the socket
@@ -2313,22 +2350,8 @@ int_t socketSetTcpNoDelayOption(Socket *socket, const int_t *optval,
    //Check the length of the option
    if(optlen >= (socklen_t) sizeof(int_t))
    {
-      //Get exclusive access
-      osAcquireMutex(&netMutex);
-
       //The option enables or disables the Nagle algorithm for TCP sockets
-      if(*optval != 0)
-      {
-         socket->options |= SOCKET_OPTION_TCP_NO_DELAY;
-      }
-      else
-      {
-         socket->options &= ~SOCKET_OPTION_TCP_NO_DELAY;
-      }
-
-      //Release exclusive access
-      osReleaseMutex(&netMutex);
-
+      socketEnableNoDelay(socket, (*optval != 0) ? TRUE : FALSE);
       //Successful processing
       ret = SOCKET_SUCCESS;
    }
@@ -2409,11 +2432,18 @@ int_t socketSetTcpKeepIdleOption(Socket *socket, const int_t *optval,
    int_t ret;
 
 #if (TCP_SUPPORT == ENABLED && TCP_KEEP_ALIVE_SUPPORT == ENABLED)
+   //This option only applies to TCP sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+   {
+      //The option is not supported at this level
+      socketSetErrnoCode(socket, ENOPROTOOPT);
+      ret = SOCKET_ERROR;
+   }
    //Check the length of the option
-   if(optlen >= (socklen_t) sizeof(int_t))
+   else if(optlen >= (socklen_t) sizeof(int_t))
    {
       //Convert the time interval to milliseconds
-      socket->keepAliveIdle = *optval * 1000;
+      socket->tcb->keepAliveIdle = *optval * 1000;
       //Successful processing
       ret = SOCKET_SUCCESS;
    }
@@ -2450,11 +2480,18 @@ int_t socketSetTcpKeepIntvlOption(Socket *socket, const int_t *optval,
    int_t ret;
 
 #if (TCP_SUPPORT == ENABLED && TCP_KEEP_ALIVE_SUPPORT == ENABLED)
+   //This option only applies to TCP sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+   {
+      //The option is not supported at this level
+      socketSetErrnoCode(socket, ENOPROTOOPT);
+      ret = SOCKET_ERROR;
+   }
    //Check the length of the option
-   if(optlen >= (socklen_t) sizeof(int_t))
+   else if(optlen >= (socklen_t) sizeof(int_t))
    {
       //Convert the time interval to milliseconds
-      socket->keepAliveInterval = *optval * 1000;
+      socket->tcb->keepAliveInterval = *optval * 1000;
       //Successful processing
       ret = SOCKET_SUCCESS;
    }
@@ -2491,11 +2528,18 @@ int_t socketSetTcpKeepCntOption(Socket *socket, const int_t *optval,
    int_t ret;
 
 #if (TCP_SUPPORT == ENABLED && TCP_KEEP_ALIVE_SUPPORT == ENABLED)
+   //This option only applies to TCP sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+   {
+      //The option is not supported at this level
+      socketSetErrnoCode(socket, ENOPROTOOPT);
+      ret = SOCKET_ERROR;
+   }
    //Check the length of the option
-   if(optlen >= (socklen_t) sizeof(int_t))
+   else if(optlen >= (socklen_t) sizeof(int_t))
    {
       //Save parameter value
-      socket->keepAliveMaxProbes = *optval;
+      socket->tcb->keepAliveMaxProbes = *optval;
       //Successful processing
       ret = SOCKET_SUCCESS;
    }
@@ -2516,6 +2560,88 @@ int_t socketSetTcpKeepCntOption(Socket *socket, const int_t *optval,
 }
 
 
+/**
+ * @brief Set TCP_QUICKACK option
+ * @param[in] socket Handle referencing the socket
+ * @param[in] optval A pointer to the buffer in which the value for the
+ *   requested option is specified
+ * @param[in] optlen The size, in bytes, of the buffer pointed to by the optval
+ *   parameter
+ * @return Error code (SOCKET_SUCCESS or SOCKET_ERROR)
+ **/
+
+int_t socketSetTcpQuickAckOption(Socket *socket, const int_t *optval,
+   socklen_t optlen)
+{
+   int_t ret;
+
+#if (TCP_SUPPORT == ENABLED && TCP_DELAYED_ACK_SUPPORT == ENABLED)
+   //Check the length of the option
+   if(optlen >= (socklen_t) sizeof(int_t))
+   {
+      //The option disables delayed ACKs for TCP sockets
+      socketEnableQuickAck(socket, (*optval != 0) ? TRUE : FALSE);
+      //Successful processing
+      ret = SOCKET_SUCCESS;
+   }
+   else
+   {
+      //The option length is not valid
+      socketSetErrnoCode(socket, EFAULT);
+      ret = SOCKET_ERROR;
+   }
+#else
+   //Delayed ACK is not supported
+   socketSetErrnoCode(socket, ENOPROTOOPT);
+   ret = SOCKET_ERROR;
+#endif
+
+   //Return status code
+   return ret;
+}
+
+
+/**
+ * @brief Set TCP_CORK option
+ * @param[in] socket Handle referencing the socket
+ * @param[in] optval A pointer to the buffer in which the value for the
+ *   requested option is specified
+ * @param[in] optlen The size, in bytes, of the buffer pointed to by the optval
+ *   parameter
+ * @return Error code (SOCKET_SUCCESS or SOCKET_ERROR)
+ **/
+
+int_t socketSetTcpCorkOption(Socket *socket, const int_t *optval,
+   socklen_t optlen)
+{
+   int_t ret;
+
+#if (TCP_SUPPORT == ENABLED)
+   //Check the length of the option
+   if(optlen >= (socklen_t) sizeof(int_t))
+   {
+      //The option holds back partial segments until the socket is uncorked
+      socketEnableCork(socket, (*optval != 0) ? TRUE : FALSE);
+      //Successful processing
+      ret = SOCKET_SUCCESS;
+   }
+   else
+   {
+      //The option length is not valid
+      socketSetErrnoCode(socket, EFAULT);
+      ret = SOCKET_ERROR;
+   }
+#else
+   //Not implemented
+   socketSetErrnoCode(socket, ENOPROTOOPT);
+   ret = SOCKET_ERROR;
+#endif
+
+   //Return status code
+   return ret;
+}
+
+
 /**
  * @brief Get SO_REUSEADDR option
  * @param[in] socket Handle referencing the socket
@@ -2701,6 +2827,53 @@ int_t socketGetSoBroadcastOption(Socket *socket, int_t *optval,
 }
 
 
+/**
+ * @brief Get SO_REUSEPORT option
+ * @param[in] socket Handle referencing the socket
+ * @param[out] optval A pointer to the buffer in which the value for the
+ *   requested option is to be returned
+ * @param[in,out] optlen The size, in bytes, of the buffer pointed to by the
+ *   optval parameter
+ * @return Error code (SOCKET_SUCCESS or SOCKET_ERROR)
+ **/
+
+int_t socketGetSoReusePortOption(Socket *socket, int_t *optval,
+   socklen_t *optlen)
+{
+   int_t ret;
+
+   //Check the length of the option
+   if(*optlen >= (socklen_t) sizeof(int_t))
+   {
+      //This option specifies whether multicast and broadcast datagrams are
+      //delivered to every socket bound to the same port
+      if((socket->options & SOCKET_OPTION_REUSE_PORT) != 0)
+      {
+         *optval = TRUE;
+      }
+      else
+      {
+         *optval = FALSE;
+      }
+
+      //Return the actual length of the option
+      *optlen = sizeof(int_t);
+
+      //Successful processing
+      ret = SOCKET_SUCCESS;
+   }
+   else
+   {
+      //The option length is not valid
+      socketSetErrnoCode(socket, EFAULT);
+      ret = SOCKET_ERROR;
+   }
+
+   //Return status code
+   return ret;
+}
+
+
 /**
  * @brief Get SO_SNDTIMEO option
  * @param[in] socket Handle referencing the socket
@@ -2811,11 +2984,18 @@ int_t socketGetSoSndBufOption(Socket *socket, int_t *optval,
    int_t ret;
 
 #if (TCP_SUPPORT == ENABLED)
+   //This option only applies to TCP sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+   {
+      //The option is not supported at this level
+      socketSetErrnoCode(socket, ENOPROTOOPT);
+      ret = SOCKET_ERROR;
+   }
    //Check the length of the option
-   if(*optlen >= (socklen_t) sizeof(int_t))
+   else if(*optlen >= (socklen_t) sizeof(int_t))
    {
       //Return the size of the send buffer
-      *optval = socket->txBufferSize;
+      *optval = socket->tcb->txBufferSize;
       //Return the actual length of the option
       *optlen = sizeof(int_t);
       //Successful processing
@@ -2854,11 +3034,18 @@ int_t socketGetSoRcvBufOption(Socket *socket, int_t *optval,
    int_t ret;
 
 #if (TCP_SUPPORT == ENABLED)
+   //This option only applies to TCP sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+   {
+      //The option is not supported at this level
+      socketSetErrnoCode(socket, ENOPROTOOPT);
+      ret = SOCKET_ERROR;
+   }
    //Check the length of the option
-   if(*optlen >= (socklen_t) sizeof(int_t))
+   else if(*optlen >= (socklen_t) sizeof(int_t))
    {
       //Return the size of the receive buffer
-      *optval = socket->rxBufferSize;
+      *optval = socket->tcb->rxBufferSize;
       //Return the actual length of the option
       *optlen = sizeof(int_t);
       //Successful processing
@@ -2897,11 +3084,18 @@ int_t socketGetSoKeepAliveOption(Socket *socket, int_t *optval,
    int_t ret;
 
 #if (TCP_SUPPORT == ENABLED && TCP_KEEP_ALIVE_SUPPORT == ENABLED)
+   //This option only applies to TCP sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+   {
+      //The option is not supported at this level
+      socketSetErrnoCode(socket, ENOPROTOOPT);
+      ret = SOCKET_ERROR;
+   }
    //Check the length of the option
-   if(*optlen >= (socklen_t) sizeof(int_t))
+   else if(*optlen >= (socklen_t) sizeof(int_t))
    {
       //This option specifies whether TCP keep-alive is enabled
-      *optval = socket->keepAliveEnabled;
+      *optval = socket->tcb->keepAliveEnabled;
       //Successful processing
       ret = SOCKET_SUCCESS;
    }
@@ -3894,21 +4088,28 @@ int_t socketGetTcpMaxSegOption(Socket *socket, int_t *optval,
    int_t ret;
 
 #if (TCP_SUPPORT == ENABLED)
+   //This option only applies to TCP sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+   {
+      //The option is not supported at this level
+      socketSetErrnoCode(socket, ENOPROTOOPT);
+      ret = SOCKET_ERROR;
+   }
    //Check the length of the option
-   if(*optlen >= (socklen_t) sizeof(int_t))
+   else if(*optlen >= (socklen_t) sizeof(int_t))
    {
       //Get exclusive access
       osAcquireMutex(&netMutex);
 
       //Return the maximum segment size for outgoing TCP packets
-      if(socket->state == TCP_STATE_CLOSED ||
-         socket->state == TCP_STATE_LISTEN)
+      if(socket->tcb->state == TCP_STATE_CLOSED ||
+         socket->tcb->state == TCP_STATE_LISTEN)
       {
-         *optval = socket->mss;
+         *optval = socket->tcb->mss;
       }
       else
       {
-         *optval = socket->smss;
+         *optval = socket->tcb->smss;
       }
 
       //Release exclusive access
@@ -3950,11 +4151,18 @@ int_t socketGetTcpKeepIdleOption(Socket *socket, int_t *optval,
    int_t ret;
 
 #if (TCP_SUPPORT == ENABLED && TCP_KEEP_ALIVE_SUPPORT == ENABLED)
+   //This option only applies to TCP sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+   {
+      //The option is not supported at this level
+      socketSetErrnoCode(socket, ENOPROTOOPT);
+      ret = SOCKET_ERROR;
+   }
    //Check the length of the option
-   if(*optlen >= (socklen_t) sizeof(int_t))
+   else if(*optlen >= (socklen_t) sizeof(int_t))
    {
       //Convert the time interval to seconds
-      *optval = socket->keepAliveIdle / 1000;
+      *optval = socket->tcb->keepAliveIdle / 1000;
       //Successful processing
       ret = SOCKET_SUCCESS;
    }
@@ -3991,11 +4199,18 @@ int_t socketGetTcpKeepIntvlOption(Socket *socket, int_t *optval,
    int_t ret;
 
 #if (TCP_SUPPORT == ENABLED && TCP_KEEP_ALIVE_SUPPORT == ENABLED)
+   //This option only applies to TCP sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+   {
+      //The option is not supported at this level
+      socketSetErrnoCode(socket, ENOPROTOOPT);
+      ret = SOCKET_ERROR;
+   }
    //Check the length of the option
-   if(*optlen >= (socklen_t) sizeof(int_t))
+   else if(*optlen >= (socklen_t) sizeof(int_t))
    {
       //Convert the time interval to seconds
-      *optval = socket->keepAliveInterval / 1000;
+      *optval = socket->tcb->keepAliveInterval / 1000;
       //Successful processing
       ret = SOCKET_SUCCESS;
    }
@@ -4033,11 +4248,18 @@ int_t socketGetTcpKeepCntOption(Socket *socket, int_t *optval,
    int_t ret;
 
 #if (TCP_SUPPORT == ENABLED && TCP_KEEP_ALIVE_SUPPORT == ENABLED)
+   //This option only applies to TCP sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+   {
+      //The option is not supported at this level
+      socketSetErrnoCode(socket, ENOPROTOOPT);
+      ret = SOCKET_ERROR;
+   }
    //Check the length of the option
-   if(*optlen >= (socklen_t) sizeof(int_t))
+   else if(*optlen >= (socklen_t) sizeof(int_t))
    {
       //Return parameter value
-      *optval = socket->keepAliveMaxProbes;
+      *optval = socket->tcb->keepAliveMaxProbes;
       //Successful processing
       ret = SOCKET_SUCCESS;
    }
@@ -4058,4 +4280,111 @@ int_t socketGetTcpKeepCntOption(Socket *socket, int_t *optval,
    return ret;
 }
 
+
+/**
+ * @brief Get TCP_QUICKACK option
+ * @param[in] socket Handle referencing the socket
+ * @param[out] optval A pointer to the buffer in which the value for the
+ *   requested option is to be returned
+ * @param[in,out] optlen The size, in bytes, of the buffer pointed to by the
+ *   optval parameter
+ * @return Error code (SOCKET_SUCCESS or SOCKET_ERROR)
+ **/
+
+int_t socketGetTcpQuickAckOption(Socket *socket, int_t *optval,
+   socklen_t *optlen)
+{
+   int_t ret;
+
+#if (TCP_SUPPORT == ENABLED && TCP_DELAYED_ACK_SUPPORT == ENABLED)
+   //This option only applies to TCP sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+   {
+      //The option is not supported at this level
+      socketSetErrnoCode(socket, ENOPROTOOPT);
+      ret = SOCKET_ERROR;
+   }
+   //Check the length of the option
+   else if(*optlen >= (socklen_t) sizeof(int_t))
+   {
+      //Return the ACK mode
+      *optval = socket->tcb->quickAck ? TRUE : FALSE;
+      //Return the actual length of the option
+      *optlen = sizeof(int_t);
+      //Successful processing
+      ret = SOCKET_SUCCESS;
+   }
+   else
+   {
+      //The option length is not valid
+      socketSetErrnoCode(socket, EFAULT);
+      ret = SOCKET_ERROR;
+   }
+#else
+   //Delayed ACK is not supported
+   socketSetErrnoCode(socket, ENOPROTOOPT);
+   ret = SOCKET_ERROR;
+#endif
+
+   //Return status code
+   return ret;
+}
+
+
+/**
+ * @brief Get TCP_CORK option
+ * @param[in] socket Handle referencing the socket
+ * @param[out] optval A pointer to the buffer in which the value for the
+ *   requested option is to be returned
+ * @param[in,out] optlen The size, in bytes, of the buffer pointed to by the
+ *   optval parameter
+ * @return Error code (SOCKET_SUCCESS or SOCKET_ERROR)
+ **/
+
+int_t socketGetTcpCorkOption(Socket *socket, int_t *optval,
+   socklen_t *optlen)
+{
+   int_t ret;
+
+#if (TCP_SUPPORT == ENABLED)
+   //Check the length of the option
+   if(*optlen >= (socklen_t) sizeof(int_t))
+   {
+      //Get exclusive access
+      osAcquireMutex(&netMutex);
+
+      //Return the current state of the socket
+      if((socket->options & SOCKET_OPTION_TCP_CORK) != 0)
+      {
+         *optval = TRUE;
+      }
+      else
+      {
+         *optval = FALSE;
+      }
+
+      //Release exclusive access
+      osReleaseMutex(&netMutex);
+
+      //Return the actual length of the option
+      *optlen = sizeof(int_t);
+      //Successful processing
+      ret = SOCKET_SUCCESS;
+   }
+   else
+   {
+      //The option length is not valid
+      socketSetErrnoCode(socket, EFAULT);
+      ret = SOCKET_ERROR;
+   }
+#else
+   //Not implemented
+   socketSetErrnoCode(socket, ENOPROTOOPT);
+   ret = SOCKET_ERROR;
+#endif
+
+   //Return status code
+   return ret;
+}
+
 #endif
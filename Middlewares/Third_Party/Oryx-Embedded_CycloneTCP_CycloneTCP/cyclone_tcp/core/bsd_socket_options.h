@@ -47,6 +47,9 @@ int_t socketSetSoReuseAddrOption(Socket *socket, const int_t *optval,
 int_t socketSetSoBroadcastOption(Socket *socket, const int_t *optval,
    socklen_t optlen);
 
+int_t socketSetSoReusePortOption(Socket *socket, const int_t *optval,
+   socklen_t optlen);
+
 int_t socketSetSoSndTimeoOption(Socket *socket, const struct timeval *optval,
    socklen_t optlen);
 
@@ -179,6 +182,12 @@ int_t socketSetTcpKeepIntvlOption(Socket *socket, const int_t *optval,
 int_t socketSetTcpKeepCntOption(Socket *socket, const int_t *optval,
    socklen_t optlen);
 
+int_t socketSetTcpQuickAckOption(Socket *socket, const int_t *optval,
+   socklen_t optlen);
+
+int_t socketSetTcpCorkOption(Socket *socket, const int_t *optval,
+   socklen_t optlen);
+
 int_t socketGetSoReuseAddrOption(Socket *socket, int_t *optval,
    socklen_t *optlen);
 
@@ -191,6 +200,9 @@ int_t socketGetSoErrorOption(Socket *socket, int_t *optval,
 int_t socketGetSoBroadcastOption(Socket *socket, int_t *optval,
    socklen_t *optlen);
 
+int_t socketGetSoReusePortOption(Socket *socket, int_t *optval,
+   socklen_t *optlen);
+
 int_t socketGetSoSndTimeoOption(Socket *socket, struct timeval *optval,
    socklen_t *optlen);
 
@@ -275,6 +287,12 @@ int_t socketGetTcpKeepIntvlOption(Socket *socket, int_t *optval,
 int_t socketGetTcpKeepCntOption(Socket *socket, int_t *optval,
    socklen_t *optlen);
 
+int_t socketGetTcpQuickAckOption(Socket *socket, int_t *optval,
+   socklen_t *optlen);
+
+int_t socketGetTcpCorkOption(Socket *socket, int_t *optval,
+   socklen_t *optlen);
+
 //C++ guard
 #ifdef __cplusplus
 }
@@ -41,6 +41,7 @@
 #include "core/tcp_timer.h"
 #include "ipv4/arp.h"
 #include "ipv4/ipv4.h"
+#include "ipv4/ipv4_multicast.h"
 #include "ipv6/ipv6.h"
 #include "mibs/mib2_module.h"
 #include "mibs/if_mib_module.h"
@@ -81,7 +82,7 @@ error_t ethInit(NetInterface *interface)
  *   the packet
  **/
 
-void ethProcessFrame(NetInterface *interface, uint8_t *frame, size_t length,
+__net_hot_func void ethProcessFrame(NetInterface *interface, uint8_t *frame, size_t length,
    NetRxAncillary *ancillary)
 {
    error_t error;
@@ -205,6 +206,11 @@ void ethProcessFrame(NetInterface *interface, uint8_t *frame, size_t length,
          data += sizeof(VlanTag);
          length -= sizeof(VlanTag);
       }
+      else if(ancillary->vlanTci != 0)
+      {
+         //The VLAN tag has been stripped by the NIC
+         vlanId = ancillary->vlanTci & VLAN_VID_MASK;
+      }
 #endif
 
       //End of exception handling block
@@ -241,6 +247,14 @@ void ethProcessFrame(NetInterface *interface, uint8_t *frame, size_t length,
    }
 #endif
 
+#if (ETH_SINGLE_INTERFACE == ENABLED)
+   //The frame is for the interface it was received on, no lookup needed
+   virtualInterface = interface;
+
+   //Single pass over the body below
+   for(i = 0; i < 1; i++)
+   {
+#else
    //802.1Q allows a single physical interface to be bound to multiple
    //virtual interfaces
    for(i = 0; i < NET_INTERFACE_COUNT; i++)
@@ -252,6 +266,7 @@ void ethProcessFrame(NetInterface *interface, uint8_t *frame, size_t length,
       //physical interface where the packet was received
       if(nicGetPhysicalInterface(virtualInterface) != interface)
          continue;
+#endif
 
 #if (ETH_PORT_TAGGING_SUPPORT == ENABLED)
       //Retrieve switch port identifier
@@ -297,6 +312,13 @@ void ethProcessFrame(NetInterface *interface, uint8_t *frame, size_t length,
          //address does not correspond to the physical interface through which
          //it was received
          error = ethCheckDestAddr(virtualInterface, &header->destAddr);
+
+         //Multicast frame passed by the MAC hash filter for another group?
+         if(error && macIsMulticastAddr(&header->destAddr))
+         {
+            //Update statistics
+            NET_STATS_IF_INC(virtualInterface, rxMacFiltered, 1);
+         }
       }
 
       //Valid destination address?
@@ -344,6 +366,17 @@ void ethProcessFrame(NetInterface *interface, uint8_t *frame, size_t length,
 
          //IPv4 packet received?
          case ETH_TYPE_IPV4:
+#if (IPV4_MULTICAST_PREFILTER_SUPPORT == ENABLED)
+            //Drop unwanted multicast traffic before any IPv4 processing
+            if(macIsMulticastAddr(&header->destAddr) &&
+               ipv4MulticastPreFilter(virtualInterface, (Ipv4Header *) data,
+               length) != NO_ERROR)
+            {
+               //Drop the received frame
+               error = ERROR_INVALID_ADDRESS;
+               break;
+            }
+#endif
             //Process incoming IPv4 packet
             ipv4ProcessPacket(virtualInterface, (Ipv4Header *) data, length,
                ancillary);
@@ -396,11 +429,12 @@ void ethProcessFrame(NetInterface *interface, uint8_t *frame, size_t length,
  * @return Error code
  **/
 
-error_t ethSendFrame(NetInterface *interface, const MacAddr *destAddr,
+__net_hot_func error_t ethSendFrame(NetInterface *interface, const MacAddr *destAddr,
    uint16_t type, NetBuffer *buffer, size_t offset, NetTxAncillary *ancillary)
 {
    error_t error;
    uint32_t crc;
+   uint8_t *p;
    size_t length;
    EthHeader *header;
    NetInterface *physicalInterface;
@@ -426,22 +460,39 @@ error_t ethSendFrame(NetInterface *interface, const MacAddr *destAddr,
    }
 #endif
 
+   //Point to the physical interface
+   physicalInterface = nicGetPhysicalInterface(interface);
+
 #if (ETH_VLAN_SUPPORT == ENABLED)
    //Get the VLAN identifier assigned to the interface
    vlanId = nicGetVlanId(interface);
+   //The NIC does not insert any tag unless requested
+   ancillary->vlanTci = 0;
 
    //Valid VLAN identifier?
    if(vlanId != 0)
    {
-      //The VLAN tag is inserted in the Ethernet frame
-      error = ethEncodeVlanTag(buffer, &offset, vlanId, ancillary->vlanPcp,
-         ancillary->vlanDei, type);
-      //Any error to report?
-      if(error)
-         return error;
+      //The NIC can only insert the outermost tag
+      if(physicalInterface->nicDriver != NULL &&
+         physicalInterface->nicDriver->vlanTagInsertion &&
+         nicGetVmanId(interface) == 0)
+      {
+         //The VLAN tag is inserted by the NIC while the frame is sent
+         ancillary->vlanTci = ethFormatVlanTci(vlanId, ancillary->vlanPcp,
+            ancillary->vlanDei);
+      }
+      else
+      {
+         //The VLAN tag is inserted in the Ethernet frame
+         error = ethEncodeVlanTag(buffer, &offset, vlanId, ancillary->vlanPcp,
+            ancillary->vlanDei, type);
+         //Any error to report?
+         if(error)
+            return error;
 
-      //A distinct EtherType has been allocated for use in the TPID field
-      type = ETH_TYPE_VLAN;
+         //A distinct EtherType has been allocated for use in the TPID field
+         type = ETH_TYPE_VLAN;
+      }
    }
 #endif
 
@@ -476,18 +527,15 @@ error_t ethSendFrame(NetInterface *interface, const MacAddr *destAddr,
       ancillary->srcMacAddr = logicalInterface->macAddr;
    }
 
-   //Sanity check
-   if(offset < sizeof(EthHeader))
+   //Make room for the Ethernet header
+   header = netBufferPush(buffer, &offset, sizeof(EthHeader));
+   //Not enough headroom?
+   if(header == NULL)
       return ERROR_INVALID_PARAMETER;
 
-   //Make room for the Ethernet header
-   offset -= sizeof(EthHeader);
    //Calculate the length of the frame
    length = netBufferGetLength(buffer) - offset;
 
-   //Point to the beginning of the frame
-   header = netBufferAt(buffer, offset, 0);
-
    //Format Ethernet header
    header->destAddr = *destAddr;
    header->srcAddr = ancillary->srcMacAddr;
@@ -523,9 +571,6 @@ error_t ethSendFrame(NetInterface *interface, const MacAddr *destAddr,
    }
 #endif
 
-   //Point to the physical interface
-   physicalInterface = nicGetPhysicalInterface(interface);
-
 #if (ETH_PORT_TAGGING_SUPPORT == ENABLED)
    //Check whether port tagging is supported by the switch
    if(physicalInterface->switchDriver != NULL &&
@@ -565,11 +610,21 @@ error_t ethSendFrame(NetInterface *interface, const MacAddr *destAddr,
          //Convert from host byte order to little-endian byte order
          crc = htole32(crc);
 
-         //Append the calculated CRC value
-         error = netBufferAppend(buffer, &crc, sizeof(crc));
-         //Any error to report?
-         if(error)
-            return error;
+         //Append the calculated CRC value, within the tailroom if possible
+         p = netBufferPut(buffer, sizeof(crc));
+
+         //Successful processing?
+         if(p != NULL)
+         {
+            osMemcpy(p, &crc, sizeof(crc));
+         }
+         else
+         {
+            error = netBufferAppend(buffer, &crc, sizeof(crc));
+            //Any error to report?
+            if(error)
+               return error;
+         }
 
          //Adjust the length of the frame
          length += sizeof(crc);
@@ -770,11 +825,12 @@ error_t ethDetachLlcRxCalback(NetInterface *interface)
  * @brief Allocate a buffer to hold an Ethernet frame
  * @param[in] length Desired payload length
  * @param[out] offset Offset to the first byte of the payload
+ * @param[in] tag Subsystem the buffer is charged to
  * @return The function returns a pointer to the newly allocated
  *   buffer. If the system is out of resources, NULL is returned
  **/
 
-NetBuffer *ethAllocBuffer(size_t length, size_t *offset)
+NetBuffer *ethAllocBufferTagged(size_t length, size_t *offset, uint8_t tag)
 {
    size_t n;
    NetBuffer *buffer;
@@ -797,12 +853,20 @@ NetBuffer *ethAllocBuffer(size_t length, size_t *offset)
    n += ETH_PORT_TAG_SIZE;
 #endif
 
-   //Allocate a buffer to hold the Ethernet header and the payload
-   buffer = netBufferAlloc(length + n);
+   //Encapsulations the stack does not account for
+   n += NET_MEM_HEADROOM;
+
+   //Allocate a buffer to hold the Ethernet header and the payload, with
+   //room behind for the padding of short frames and the trailers
+   buffer = netBufferAllocTagged(n + MAX(length, ETH_MIN_FRAME_SIZE) +
+      NET_MEM_TAILROOM, tag);
    //Failed to allocate buffer?
    if(buffer == NULL)
       return NULL;
 
+   //The room behind the payload is kept in the last chunk
+   netBufferSetLength(buffer, length + n);
+
    //Offset to the first byte of the payload
    *offset = n;
 
@@ -970,7 +1034,7 @@ void macAddrToEui64(const MacAddr *macAddr, Eui64 *interfaceId)
  * @param[in] ethHeader Pointer to the Ethernet header
  **/
 
-void ethDumpHeader(const EthHeader *ethHeader)
+__net_cold_func void ethDumpHeader(const EthHeader *ethHeader)
 {
    //Dump Ethernet header contents
    TRACE_DEBUG("  Dest Addr = %s\r\n", macAddrToString(&ethHeader->destAddr, NULL));
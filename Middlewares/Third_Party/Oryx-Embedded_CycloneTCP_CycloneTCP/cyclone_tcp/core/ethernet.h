@@ -76,6 +76,16 @@
    #error ETH_PORT_TAGGING_SUPPORT parameter is not valid
 #endif
 
+//Frames of the physical interface are only ever delivered to it: a single
+//interface, with no virtual, VLAN or tagged interface on top of it
+#if (NET_INTERFACE_COUNT == 1 && ETH_VIRTUAL_IF_SUPPORT == DISABLED && \
+   ETH_VLAN_SUPPORT == DISABLED && ETH_VMAN_SUPPORT == DISABLED && \
+   ETH_PORT_TAGGING_SUPPORT == DISABLED)
+   #define ETH_SINGLE_INTERFACE ENABLED
+#else
+   #define ETH_SINGLE_INTERFACE DISABLED
+#endif
+
 //Size of tags used for switch port tagging
 #ifndef ETH_PORT_TAG_SIZE
    #define ETH_PORT_TAG_SIZE 4
@@ -90,6 +100,28 @@
    #error ETH_TIMESTAMP_SUPPORT parameter is not valid
 #endif
 
+//Hook invoked with the transmit time stamp of a frame sent with a valid
+//time stamping identifier (NetTxAncillary.timestampId)
+#ifndef ETH_TX_TIMESTAMP_HOOK
+   #define ETH_TX_TIMESTAMP_HOOK(interface, timestampId, timestamp)
+#endif
+
+//Time-triggered transmission (frames sent at a given PTP time)
+#ifndef ETH_LAUNCH_TIME_SUPPORT
+   #define ETH_LAUNCH_TIME_SUPPORT DISABLED
+#elif (ETH_LAUNCH_TIME_SUPPORT != ENABLED && ETH_LAUNCH_TIME_SUPPORT != DISABLED)
+   #error ETH_LAUNCH_TIME_SUPPORT parameter is not valid
+#elif (ETH_LAUNCH_TIME_SUPPORT == ENABLED && ETH_TIMESTAMP_SUPPORT != ENABLED)
+   #error ETH_LAUNCH_TIME_SUPPORT requires ETH_TIMESTAMP_SUPPORT
+#endif
+
+//Hardware checksum offload support
+#ifndef ETH_CHECKSUM_OFFLOAD_SUPPORT
+   #define ETH_CHECKSUM_OFFLOAD_SUPPORT DISABLED
+#elif (ETH_CHECKSUM_OFFLOAD_SUPPORT != ENABLED && ETH_CHECKSUM_OFFLOAD_SUPPORT != DISABLED)
+   #error ETH_CHECKSUM_OFFLOAD_SUPPORT parameter is not valid
+#endif
+
 //Size of the MAC address filter
 #ifndef MAC_ADDR_FILTER_SIZE
    #define MAC_ADDR_FILTER_SIZE 12
@@ -138,6 +170,9 @@
 //Compare EUI-64 addresses
 #define eui64CompAddr(eui64Addr1, eui64Addr2) (!osMemcmp(eui64Addr1, eui64Addr2, sizeof(Eui64)))
 
+//Buffer allocation charged to the subsystem of the caller (net_mem.h)
+#define ethAllocBuffer(length, offset) ethAllocBufferTagged(length, offset, NET_MEM_TAG())
+
 //C++ guard
 #ifdef __cplusplus
 extern "C" {
@@ -299,7 +334,7 @@ error_t ethAttachLlcRxCalback(NetInterface *interface, LlcRxCallback callback,
 
 error_t ethDetachLlcRxCalback(NetInterface *interface);
 
-NetBuffer *ethAllocBuffer(size_t length, size_t *offset);
+NetBuffer *ethAllocBufferTagged(size_t length, size_t *offset, uint8_t tag);
 
 error_t macStringToAddr(const char_t *str, MacAddr *macAddr);
 char_t *macAddrToString(const MacAddr *macAddr, char_t *str);
@@ -148,6 +148,7 @@ error_t ethPadFrame(NetBuffer *buffer, size_t *length)
 {
    error_t error;
    size_t n;
+   uint8_t *p;
 
    //Ethernet frames have a minimum length of 64 byte
    if(*length < (ETH_MIN_FRAME_SIZE - ETH_CRC_SIZE))
@@ -155,8 +156,20 @@ error_t ethPadFrame(NetBuffer *buffer, size_t *length)
       //Add padding as necessary
       n = (ETH_MIN_FRAME_SIZE - ETH_CRC_SIZE) - *length;
 
-      //Append padding bytes
-      error = netBufferAppend(buffer, ethPadding, n);
+      //Pad within the tailroom if possible
+      p = netBufferPut(buffer, n);
+
+      //Successful processing?
+      if(p != NULL)
+      {
+         osMemset(p, 0, n);
+         error = NO_ERROR;
+      }
+      else
+      {
+         //Append padding bytes
+         error = netBufferAppend(buffer, ethPadding, n);
+      }
 
       //Check status code
       if(!error)
@@ -192,10 +205,34 @@ error_t ethEncodeVlanTag(NetBuffer *buffer, size_t *offset, uint16_t vlanId,
 {
    VlanTag *vlanTag;
 
-   //Sanity check
-   if(*offset < sizeof(VlanTag))
+   //Make room for the VLAN tag
+   vlanTag = netBufferPush(buffer, offset, sizeof(VlanTag));
+   //Not enough headroom?
+   if(vlanTag == NULL)
       return ERROR_INVALID_PARAMETER;
 
+   //The TCI field is divided into PCP, DEI, and VID
+   vlanTag->tci = htons(ethFormatVlanTci(vlanId, vlanPcp, vlanDei));
+
+   //The EtherType field indicates which protocol is encapsulated in the
+   //payload
+   vlanTag->type = htons(type);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Format the TCI field of a VLAN tag
+ * @param[in] vlanId VLAN identifier
+ * @param[in] vlanPcp VLAN priority
+ * @param[in] vlanDei Drop eligible indicator
+ * @return Tag control information
+ **/
+
+uint16_t ethFormatVlanTci(uint16_t vlanId, int8_t vlanPcp, int8_t vlanDei)
+{
    //Valid PCP value?
    if(vlanPcp >= 0)
    {
@@ -214,20 +251,8 @@ error_t ethEncodeVlanTag(NetBuffer *buffer, size_t *offset, uint16_t vlanId,
          (vlanId & ~VLAN_DEI_MASK);
    }
 
-   //Make room for the VLAN tag
-   *offset -= sizeof(VlanTag);
-   //Point to the VLAN tag
-   vlanTag = netBufferAt(buffer, *offset, 0);
-
-   //The TCI field is divided into PCP, DEI, and VID
-   vlanTag->tci = htons(vlanId);
-
-   //The EtherType field indicates which protocol is encapsulated in the
-   //payload
-   vlanTag->type = htons(type);
-
-   //Successful processing
-   return NO_ERROR;
+   //Return the TCI field
+   return vlanId;
 }
 
 
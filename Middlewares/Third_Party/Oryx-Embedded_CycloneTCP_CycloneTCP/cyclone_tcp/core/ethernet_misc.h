@@ -49,6 +49,8 @@ error_t ethPadFrame(NetBuffer *buffer, size_t *length);
 error_t ethEncodeVlanTag(NetBuffer *buffer, size_t *offset, uint16_t vlanId,
    int8_t vlanPcp, int8_t vlanDei, uint16_t type);
 
+uint16_t ethFormatVlanTci(uint16_t vlanId, int8_t vlanPcp, int8_t vlanDei);
+
 error_t ethDecodeVlanTag(const uint8_t *frame, size_t length, uint16_t *vlanId,
    uint16_t *type);
 
@@ -462,7 +462,7 @@ void ipUpdateMulticastFilter(NetInterface *interface, const IpAddr *groupAddr)
  * @return Checksum value
  **/
 
-uint16_t ipCalcChecksum(const void *data, size_t length)
+__net_fast_func uint16_t ipCalcChecksum(const void *data, size_t length)
 {
    uint32_t temp;
    uint32_t checksum;
@@ -508,6 +508,36 @@ uint16_t ipCalcChecksum(const void *data, size_t length)
       }
    }
 
+#if defined(__GNUC__) && defined(__ARM_ARCH_7EM__)
+   //Process the data 16 bytes at a time, as one ADDS/ADCS carry chain per
+   //block, the final carry being added back at its end (the Cortex-M7 issues
+   //the doubleword loads alongside the additions)
+   while(length >= 16)
+   {
+      uint32_t a;
+      uint32_t b;
+      uint32_t c;
+      uint32_t d;
+
+      __asm__("ldrd %[a], %[b], [%[p]]\n\t"
+         "ldrd %[c], %[d], [%[p], #8]\n\t"
+         "adds %[sum], %[sum], %[a]\n\t"
+         "adcs %[sum], %[sum], %[b]\n\t"
+         "adcs %[sum], %[sum], %[c]\n\t"
+         "adcs %[sum], %[sum], %[d]\n\t"
+         "adc %[sum], %[sum], #0"
+         : [sum] "+r" (checksum), [a] "=&r" (a), [b] "=&r" (b),
+           [c] "=&r" (c), [d] "=&r" (d)
+         : [p] "r" (p)
+         : "cc", "memory");
+
+      //Point to the next block
+      p += 16;
+      //Number of bytes left to process
+      length -= 16;
+   }
+#endif
+
    //Process the data 4 bytes at a time
    while(length >= 4)
    {
@@ -574,6 +604,111 @@ uint16_t ipCalcChecksum(const void *data, size_t length)
 }
 
 
+/**
+ * @brief Copy data and calculate its IP checksum in the same pass
+ *
+ * The data is read once, with 32-bit accesses whatever the alignment of
+ * either pointer, instead of being copied and then read again by
+ * ipCalcChecksum(). The carries are kept in a 64-bit sum and folded at the
+ * end
+ *
+ * @param[out] dest Destination of the copy
+ * @param[in] src Data over which to calculate the IP checksum
+ * @param[in] length Number of bytes to copy
+ * @return Checksum value, as ipCalcChecksum(dest, length) would return it
+ **/
+
+__net_fast_func uint16_t ipCopyChecksum(void *dest, const void *src,
+   size_t length)
+{
+   uint_t i;
+   uint16_t half;
+   uint32_t word;
+   uint32_t checksum;
+   uint64_t sum;
+   uint8_t *d;
+   const uint8_t *s;
+
+   //Checksum preset value
+   sum = 0;
+
+   //Point to the data to copy
+   d = (uint8_t *) dest;
+   s = (const uint8_t *) src;
+
+   //Copy the data 16 bytes at a time (the compiler turns each 4-byte copy
+   //into a single load or store, unaligned accesses being allowed)
+   while(length >= 16)
+   {
+      for(i = 0; i < 4; i++)
+      {
+         osMemcpy(&word, s + 4 * i, 4);
+         osMemcpy(d + 4 * i, &word, 4);
+         sum += word;
+      }
+
+      //Point to the next block
+      s += 16;
+      d += 16;
+      //Number of bytes left to process
+      length -= 16;
+   }
+
+   //Copy the remaining 32-bit words
+   while(length >= 4)
+   {
+      osMemcpy(&word, s, 4);
+      osMemcpy(d, &word, 4);
+      sum += word;
+
+      s += 4;
+      d += 4;
+      length -= 4;
+   }
+
+   //Fold 64-bit sum to 32 bits
+   sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+   sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+   checksum = (uint32_t) sum;
+
+   //Fold 32-bit sum to 16 bits
+   checksum = (checksum & 0xFFFF) + (checksum >> 16);
+
+   //Copy left-over 16-bit word, if any
+   if(length >= 2)
+   {
+      osMemcpy(&half, s, 2);
+      osMemcpy(d, &half, 2);
+      checksum += half;
+
+      s += 2;
+      d += 2;
+      length -= 2;
+   }
+
+   //Copy left-over byte, if any
+   if(length >= 1)
+   {
+      *d = *s;
+#ifdef _CPU_BIG_ENDIAN
+      //Update checksum value
+      checksum += (uint32_t) *s << 8;
+#else
+      //Update checksum value
+      checksum += (uint32_t) *s;
+#endif
+   }
+
+   //Fold 32-bit sum to 16 bits (first pass)
+   checksum = (checksum & 0xFFFF) + (checksum >> 16);
+   //Fold 32-bit sum to 16 bits (second pass)
+   checksum = (checksum & 0xFFFF) + (checksum >> 16);
+
+   //Return 1's complement value
+   return checksum ^ 0xFFFF;
+}
+
+
 /**
  * @brief Calculate IP checksum over a multi-part buffer
  * @param[in] buffer Pointer to the multi-part buffer
@@ -582,7 +717,7 @@ uint16_t ipCalcChecksum(const void *data, size_t length)
  * @return Checksum value
  **/
 
-uint16_t ipCalcChecksumEx(const NetBuffer *buffer, size_t offset, size_t length)
+__net_fast_func uint16_t ipCalcChecksumEx(const NetBuffer *buffer, size_t offset, size_t length)
 {
    uint_t i;
    uint_t n;
@@ -703,11 +838,12 @@ uint16_t ipCalcUpperLayerChecksumEx(const void *pseudoHeader,
  * @brief Allocate a buffer to hold an IP packet
  * @param[in] length Desired payload length
  * @param[out] offset Offset to the first byte of the payload
+ * @param[in] tag Subsystem the buffer is charged to
  * @return The function returns a pointer to the newly allocated
  *   buffer. If the system is out of resources, NULL is returned
  **/
 
-NetBuffer *ipAllocBuffer(size_t length, size_t *offset)
+NetBuffer *ipAllocBufferTagged(size_t length, size_t *offset, uint8_t tag)
 {
    size_t headerLen;
    NetBuffer *buffer;
@@ -727,13 +863,13 @@ NetBuffer *ipAllocBuffer(size_t length, size_t *offset)
 
 #if (ETH_SUPPORT == ENABLED)
    //Allocate a buffer to hold the Ethernet header and the IP packet
-   buffer = ethAllocBuffer(length + headerLen, offset);
+   buffer = ethAllocBufferTagged(length + headerLen, offset, tag);
 #elif (PPP_SUPPORT == ENABLED)
    //Allocate a buffer to hold the PPP header and the IP packet
-   buffer = pppAllocBuffer(length + headerLen, offset);
+   buffer = pppAllocBufferTagged(length + headerLen, offset, tag);
 #else
    //Allocate a buffer to hold the IP packet
-   buffer = netBufferAlloc(length + headerLen);
+   buffer = netBufferAllocTagged(length + headerLen, tag);
    //Clear offset value
    *offset = 0;
 #endif
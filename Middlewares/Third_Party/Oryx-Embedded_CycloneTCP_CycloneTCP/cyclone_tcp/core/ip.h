@@ -42,6 +42,9 @@
    #error IP_DEFAULT_DF parameter is not valid
 #endif
 
+//Buffer allocation charged to the subsystem of the caller (net_mem.h)
+#define ipAllocBuffer(length, offset) ipAllocBufferTagged(length, offset, NET_MEM_TAG())
+
 //C++ guard
 #ifdef __cplusplus
 extern "C" {
@@ -147,6 +150,7 @@ bool_t ipCompPrefix(const IpAddr *ipAddr1, const IpAddr *ipAddr2,
 void ipUpdateMulticastFilter(NetInterface *interface, const IpAddr *groupAddr);
 
 uint16_t ipCalcChecksum(const void *data, size_t length);
+uint16_t ipCopyChecksum(void *dest, const void *src, size_t length);
 uint16_t ipCalcChecksumEx(const NetBuffer *buffer, size_t offset, size_t length);
 
 uint16_t ipCalcUpperLayerChecksum(const void *pseudoHeader,
@@ -155,7 +159,7 @@ uint16_t ipCalcUpperLayerChecksum(const void *pseudoHeader,
 uint16_t ipCalcUpperLayerChecksumEx(const void *pseudoHeader,
    size_t pseudoHeaderLen, const NetBuffer *buffer, size_t offset, size_t length);
 
-NetBuffer *ipAllocBuffer(size_t length, size_t *offset);
+NetBuffer *ipAllocBufferTagged(size_t length, size_t *offset, uint8_t tag);
 
 error_t ipStringToAddr(const char_t *str, IpAddr *ipAddr);
 char_t *ipAddrToString(const IpAddr *ipAddr, char_t *str);
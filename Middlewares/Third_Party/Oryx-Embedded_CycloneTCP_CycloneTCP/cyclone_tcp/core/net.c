@@ -86,6 +86,13 @@ void netGetDefaultSettings(NetSettings *settings)
    settings->task = OS_TASK_DEFAULT_PARAMS;
    settings->task.stackSize = NET_TASK_STACK_SIZE;
    settings->task.priority = NET_TASK_PRIORITY;
+
+#if (NET_CONTROL_TASK_SUPPORT == ENABLED)
+   //Default parameters of the control task
+   settings->controlTask = OS_TASK_DEFAULT_PARAMS;
+   settings->controlTask.stackSize = NET_CONTROL_TASK_STACK_SIZE;
+   settings->controlTask.priority = NET_CONTROL_TASK_PRIORITY;
+#endif
 }
 
 
@@ -137,11 +144,23 @@ error_t netInitEx(NetContext *context, const NetSettings *settings)
    context->taskParams = settings->task;
    context->taskId = OS_INVALID_TASK_ID;
 
+#if (NET_CONTROL_TASK_SUPPORT == ENABLED)
+   //Initialize the parameters of the control task
+   context->controlTaskParams = settings->controlTask;
+   context->controlTaskId = OS_INVALID_TASK_ID;
+#endif
+
    //The TCP/IP process is currently suspended
    netTaskRunning = FALSE;
    //Get current time
    netTimestamp = osGetSystemTime();
 
+#if (NET_TICKLESS_SUPPORT == ENABLED)
+   //No periodic operation has run yet
+   context->tickTime = netTimestamp;
+   context->tickTimeout = NET_TICK_INTERVAL;
+#endif
+
    //Create a mutex to prevent simultaneous access to the TCP/IP stack
    if(!osCreateMutex(&netMutex))
    {
@@ -149,6 +168,11 @@ error_t netInitEx(NetContext *context, const NetSettings *settings)
       return ERROR_OUT_OF_RESOURCES;
    }
 
+#if (OS_MUTEX_STATS_SUPPORT == ENABLED)
+   //Measure the contention on the stack-wide lock
+   osSetMutexStats(&netMutex, &context->mutexStats);
+#endif
+
    //Create a event object to receive notifications from device drivers
    if(!osCreateEvent(&netEvent))
    {
@@ -156,6 +180,15 @@ error_t netInitEx(NetContext *context, const NetSettings *settings)
       return ERROR_OUT_OF_RESOURCES;
    }
 
+#if (NET_CONTROL_TASK_SUPPORT == ENABLED)
+   //Create an event object to wake up the control task
+   if(!osCreateEvent(&context->controlEvent))
+   {
+      //Failed to create event
+      return ERROR_OUT_OF_RESOURCES;
+   }
+#endif
+
    //Memory pool initialization
    error = memPoolInit();
    //Any error to report?
@@ -284,9 +317,6 @@ error_t netInitEx(NetContext *context, const NetSettings *settings)
 #if (IPV6_SUPPORT == ENABLED && DHCPV6_CLIENT_SUPPORT == ENABLED)
    dhcpv6ClientTickCounter = 0;
 #endif
-#if (TCP_SUPPORT == ENABLED)
-   tcpTickCounter = 0;
-#endif
 #if (DNS_CLIENT_SUPPORT == ENABLED || MDNS_CLIENT_SUPPORT == ENABLED || \
    NBNS_CLIENT_SUPPORT == ENABLED)
    dnsTickCounter = 0;
@@ -319,6 +349,16 @@ error_t netStart(NetContext *context)
    if(context->taskId == OS_INVALID_TASK_ID)
       return ERROR_OUT_OF_RESOURCES;
 
+#if (NET_CONTROL_TASK_SUPPORT == ENABLED)
+   //Create the control task
+   context->controlTaskId = osCreateTask("TCP/IP ctrl",
+      (OsTaskCode) netControlTask, context, &context->controlTaskParams);
+
+   //Unable to create the task?
+   if(context->controlTaskId == OS_INVALID_TASK_ID)
+      return ERROR_OUT_OF_RESOURCES;
+#endif
+
 #if (NET_RTOS_SUPPORT == DISABLED)
    //The TCP/IP process is now running
    netTaskRunning = TRUE;
@@ -387,6 +427,10 @@ uint32_t netGetRand(void)
 {
    uint32_t value;
 
+#if defined(NET_RAND_SOURCE)
+   //The generator of the target takes no lock of the stack
+   value = netGenerateRand();
+#else
    //Get exclusive access
    if(netTaskRunning)
    {
@@ -401,6 +445,7 @@ uint32_t netGetRand(void)
    {
       osReleaseMutex(&netMutex);
    }
+#endif
 
    //Return the random value
    return value;
@@ -418,6 +463,10 @@ uint32_t netGetRandRange(uint32_t min, uint32_t max)
 {
    uint32_t value;
 
+#if defined(NET_RAND_SOURCE)
+   //The generator of the target takes no lock of the stack
+   value = netGenerateRandRange(min, max);
+#else
    //Get exclusive access
    if(netTaskRunning)
    {
@@ -432,6 +481,7 @@ uint32_t netGetRandRange(uint32_t min, uint32_t max)
    {
       osReleaseMutex(&netMutex);
    }
+#endif
 
    //Return the random value
    return value;
@@ -446,6 +496,10 @@ uint32_t netGetRandRange(uint32_t min, uint32_t max)
 
 void netGetRandData(uint8_t *data, size_t length)
 {
+#if defined(NET_RAND_DATA_SOURCE)
+   //The generator of the target takes no lock of the stack
+   netGenerateRandData(data, length);
+#else
    //Get exclusive access
    if(netTaskRunning)
    {
@@ -460,6 +514,7 @@ void netGetRandData(uint8_t *data, size_t length)
    {
       osReleaseMutex(&netMutex);
    }
+#endif
 }
 
 
@@ -1416,6 +1471,16 @@ error_t netStartInterface(NetInterface *interface)
             //the virtual interface
             error = ethAcceptMacAddr(physicalInterface, &interface->macAddr);
          }
+
+#if (ETH_VLAN_SUPPORT == ENABLED)
+         //The physical interface may filter the tagged frames on their VLAN
+         //identifier
+         if(!error && nicGetVlanId(interface) != 0)
+         {
+            //Update the MAC filter of the physical interface
+            error = nicUpdateMacAddrFilter(physicalInterface);
+         }
+#endif
       }
       else
       {
@@ -1534,6 +1599,7 @@ void netTaskEx(NetContext *context)
 {
    uint_t i;
    bool_t status;
+   bool_t polling;
    systime_t time;
    systime_t timeout;
    NetInterface *interface;
@@ -1575,6 +1641,10 @@ void netTaskEx(NetContext *context)
       //Get current time
       time = osGetSystemTime();
 
+#if (NET_CONTROL_TASK_SUPPORT == ENABLED)
+      //The periodic operations are run by the control task
+      timeout = INFINITE_DELAY;
+#else
       //Compute the maximum blocking time when waiting for an event
       if(timeCompare(time, netTimestamp) < 0)
       {
@@ -1584,17 +1654,36 @@ void netTaskEx(NetContext *context)
       {
          timeout = 0;
       }
+#endif
+
+#if (TCP_SUPPORT == ENABLED)
+      //Wake up in time for the next TCP timer event
+      timeout = MIN(timeout, tcpGetTimerTimeout(time));
+#endif
+
+#if defined(NET_TASK_ALIVE_HOOK)
+      //Heartbeat of the task, given at least every NET_TASK_ALIVE_INTERVAL
+      NET_TASK_ALIVE_HOOK();
+      timeout = MIN(timeout, NET_TASK_ALIVE_INTERVAL);
+#endif
 
       //Receive notifications when a frame has been received, or the
       //link state of any network interfaces has changed
       status = osWaitForEvent(&netEvent, timeout);
 
+      //No NIC is in polling mode for the moment
+      polling = FALSE;
+
       //Check whether the specified event is in signaled state
       if(status)
       {
          //Get exclusive access
          osAcquireMutex(&netMutex);
 
+#if defined(NET_EVENT_ENTER_HOOK)
+         NET_EVENT_ENTER_HOOK();
+#endif
+
          //Process events
          for(i = 0; i < NET_INTERFACE_COUNT; i++)
          {
@@ -1617,6 +1706,14 @@ void netTaskEx(NetContext *context)
                   //Re-enable hardware interrupts
                   interface->nicDriver->enableIrq(interface);
                }
+
+               //The driver exhausted its RX budget and will be polled again
+               polling |= interface->nicPolling;
+
+#if (NIC_TX_QUEUE_SIZE > 0)
+               //Hand queued frames over to the transmitter
+               nicFlushTxQueue(interface);
+#endif
             }
 
 #if (ETH_SUPPORT == ENABLED)
@@ -1655,6 +1752,10 @@ void netTaskEx(NetContext *context)
 #endif
          }
 
+#if defined(NET_EVENT_EXIT_HOOK)
+         NET_EVENT_EXIT_HOOK();
+#endif
+
          //Release exclusive access
          osReleaseMutex(&netMutex);
       }
@@ -1662,6 +1763,7 @@ void netTaskEx(NetContext *context)
       //Get current time
       time = osGetSystemTime();
 
+#if (NET_CONTROL_TASK_SUPPORT == DISABLED)
       //Check current time
       if(timeCompare(time, netTimestamp) >= 0)
       {
@@ -1669,13 +1771,121 @@ void netTaskEx(NetContext *context)
          osAcquireMutex(&netMutex);
          //Handle periodic operations
          netTick();
-         //Release exclusive access
-         osReleaseMutex(&netMutex);
 
+#if (NET_TICKLESS_SUPPORT == ENABLED)
+         //Wake up when the next periodic operation is due rather than on
+         //every tick interval. The time is updated before the mutex is
+         //released, as netScheduleTick() may move it earlier
+         netTimestamp = time + netContext.tickTimeout;
+#else
          //Next event
          netTimestamp = time + NET_TICK_INTERVAL;
+#endif
+
+         //Release exclusive access
+         osReleaseMutex(&netMutex);
       }
+#endif
+
+#if (TCP_SUPPORT == ENABLED)
+      //TCP timers are handled on their own deadlines rather than on every
+      //tick, so that only the sockets whose timers expire are visited
+      if(tcpTimerPending(time))
+      {
+         //Get exclusive access
+         osAcquireMutex(&netMutex);
+         //Handle TCP related timers
+         tcpTick();
+         //Release exclusive access
+         osReleaseMutex(&netMutex);
+      }
+#endif
+
+#if (NET_RTOS_SUPPORT == ENABLED && NET_RX_POLL_DELAY > 0)
+      //Frames are still pending, but lower priority tasks must be given a
+      //chance to run before the next batch is processed
+      if(polling)
+      {
+         osDelayTask(NET_RX_POLL_DELAY);
+      }
+#endif
 #if (NET_RTOS_SUPPORT == ENABLED)
    }
 #endif
 }
+
+
+#if (NET_CONTROL_TASK_SUPPORT == ENABLED)
+
+/**
+ * @brief Control task of the TCP/IP stack
+ *
+ * The periodic operations (link polling, address configuration, name
+ * services, caches) run here at NET_CONTROL_TASK_PRIORITY, while the TCP/IP
+ * task is left with the drivers, the packet path and the TCP timers. The
+ * mutex is released before each module is ticked (see netTickDue()), so
+ * the TCP/IP task waits for one module at most, not for a whole tick
+ *
+ * @param[in] context Pointer to the TCP/IP stack context
+ **/
+
+void netControlTask(NetContext *context)
+{
+   systime_t time;
+   systime_t timeout;
+
+   //Task prologue
+   osEnterTask();
+
+   //Main loop
+   while(1)
+   {
+      //Get current time
+      time = osGetSystemTime();
+
+      //Compute the time until the next periodic operation
+      if(timeCompare(time, netTimestamp) < 0)
+      {
+         timeout = netTimestamp - time;
+      }
+      else
+      {
+         timeout = 0;
+      }
+
+#if defined(NET_TASK_ALIVE_HOOK)
+      //Heartbeat of the task, given at least every NET_TASK_ALIVE_INTERVAL
+      NET_TASK_ALIVE_HOOK();
+      timeout = MIN(timeout, NET_TASK_ALIVE_INTERVAL);
+#endif
+
+      //Wait for the next periodic operation, or for a module to report an
+      //earlier deadline
+      osWaitForEvent(&context->controlEvent, timeout);
+
+      //Get current time
+      time = osGetSystemTime();
+
+      //Check current time
+      if(timeCompare(time, netTimestamp) >= 0)
+      {
+         //Get exclusive access
+         osAcquireMutex(&netMutex);
+         //Handle periodic operations
+         netTick();
+
+#if (NET_TICKLESS_SUPPORT == ENABLED)
+         //Wake up when the next periodic operation is due
+         netTimestamp = time + context->tickTimeout;
+#else
+         //Next event
+         netTimestamp = time + NET_TICK_INTERVAL;
+#endif
+
+         //Release exclusive access
+         osReleaseMutex(&netMutex);
+      }
+   }
+}
+
+#endif
@@ -40,6 +40,8 @@ struct _NetInterface;
 #include "net_config.h"
 #include "core/net_legacy.h"
 #include "core/net_mem.h"
+#include "core/net_latency.h"
+#include "core/net_stats.h"
 #include "core/net_misc.h"
 #include "core/nic.h"
 #include "core/ethernet.h"
@@ -111,6 +113,27 @@ struct _NetInterface;
    #error NET_MAX_TIMER_CALLBACKS parameter is not valid
 #endif
 
+//Maximum number of network ready callback functions that can be registered
+#ifndef NET_MAX_READY_CALLBACKS
+   #define NET_MAX_READY_CALLBACKS (2 * NET_INTERFACE_COUNT)
+#elif (NET_MAX_READY_CALLBACKS < 1)
+   #error NET_MAX_READY_CALLBACKS parameter is not valid
+#endif
+
+//Coordinated link-up sequence
+#ifndef NET_LINK_UP_FAST_PATH_SUPPORT
+   #define NET_LINK_UP_FAST_PATH_SUPPORT DISABLED
+#elif (NET_LINK_UP_FAST_PATH_SUPPORT != ENABLED && NET_LINK_UP_FAST_PATH_SUPPORT != DISABLED)
+   #error NET_LINK_UP_FAST_PATH_SUPPORT parameter is not valid
+#endif
+
+//Time after link-up during which address configuration runs at the stack tick rate
+#ifndef NET_LINK_UP_FAST_PATH_WINDOW
+   #define NET_LINK_UP_FAST_PATH_WINDOW 5000
+#elif (NET_LINK_UP_FAST_PATH_WINDOW < 0)
+   #error NET_LINK_UP_FAST_PATH_WINDOW parameter is not valid
+#endif
+
 //Maximum length of interface name
 #ifndef NET_MAX_IF_NAME_LEN
    #define NET_MAX_IF_NAME_LEN 8
@@ -144,6 +167,25 @@ struct _NetInterface;
    #define NET_TASK_PRIORITY OS_TASK_PRIORITY_HIGH
 #endif
 
+//Separate task for the periodic operations (control plane)
+#ifndef NET_CONTROL_TASK_SUPPORT
+   #define NET_CONTROL_TASK_SUPPORT DISABLED
+#elif (NET_CONTROL_TASK_SUPPORT != ENABLED && NET_CONTROL_TASK_SUPPORT != DISABLED)
+   #error NET_CONTROL_TASK_SUPPORT parameter is not valid
+#endif
+
+//Stack size required to run the control task
+#ifndef NET_CONTROL_TASK_STACK_SIZE
+   #define NET_CONTROL_TASK_STACK_SIZE 650
+#elif (NET_CONTROL_TASK_STACK_SIZE < 1)
+   #error NET_CONTROL_TASK_STACK_SIZE parameter is not valid
+#endif
+
+//Priority at which the control task should run
+#ifndef NET_CONTROL_TASK_PRIORITY
+   #define NET_CONTROL_TASK_PRIORITY OS_TASK_PRIORITY_NORMAL
+#endif
+
 //TCP/IP stack tick interval
 #ifndef NET_TICK_INTERVAL
    #define NET_TICK_INTERVAL 100
@@ -151,6 +193,58 @@ struct _NetInterface;
    #error NET_TICK_INTERVAL parameter is not valid
 #endif
 
+//Tickless operation of the TCP/IP stack
+#ifndef NET_TICKLESS_SUPPORT
+   #define NET_TICKLESS_SUPPORT DISABLED
+#elif (NET_TICKLESS_SUPPORT != ENABLED && NET_TICKLESS_SUPPORT != DISABLED)
+   #error NET_TICKLESS_SUPPORT parameter is not valid
+#endif
+
+//Periodic operations due within this time are run together (tickless mode)
+#ifndef NET_TICKLESS_SLACK
+   #define NET_TICKLESS_SLACK 50
+#elif (NET_TICKLESS_SLACK < 0)
+   #error NET_TICKLESS_SLACK parameter is not valid
+#endif
+
+//CPU time left to lower priority tasks while a NIC is in polling mode
+#ifndef NET_RX_POLL_DELAY
+   #define NET_RX_POLL_DELAY 1
+#elif (NET_RX_POLL_DELAY < 0)
+   #error NET_RX_POLL_DELAY parameter is not valid
+#endif
+
+//Section where to place the functions of the packet path (the default code
+//section is used when this parameter is not defined)
+#ifdef _DOXYGEN_
+   #define NET_FAST_CODE_SECTION ".itcm_text"
+#endif
+
+//Placement of the functions of the packet path
+#if defined(NET_FAST_CODE_SECTION) && defined(__GNUC__)
+   #define __net_fast_func __attribute__((__section__(NET_FAST_CODE_SECTION)))
+#else
+   #define __net_fast_func
+#endif
+
+//Hot/cold layout of the code left in flash
+#ifndef NET_HOT_COLD_SUPPORT
+   #define NET_HOT_COLD_SUPPORT DISABLED
+#elif (NET_HOT_COLD_SUPPORT != ENABLED && NET_HOT_COLD_SUPPORT != DISABLED)
+   #error NET_HOT_COLD_SUPPORT parameter is not valid
+#endif
+
+//Functions of the packet path that do not fit in the fast code section are
+//grouped in ".text.hot", and the debug dumps and error replies are moved to
+//".text.unlikely", away from them (the linker scripts place both groups)
+#if (NET_HOT_COLD_SUPPORT == ENABLED && defined(__GNUC__))
+   #define __net_hot_func __attribute__((__hot__, __section__(".text.hot.net")))
+   #define __net_cold_func __attribute__((__cold__, __section__(".text.unlikely.net")))
+#else
+   #define __net_hot_func
+   #define __net_cold_func
+#endif
+
 //Get system tick count
 #ifndef netGetSystemTickCount
    #define netGetSystemTickCount() osGetSystemTime()
@@ -180,8 +274,31 @@ struct _NetInterface
    uint8_t nicContext[NIC_CONTEXT_SIZE];          ///<Driver specific context
    OsEvent nicTxEvent;                            ///<Network controller TX event
    bool_t nicEvent;                               ///<A NIC event is pending
+   bool_t nicPolling;                             ///<The NIC driver is in polling mode
+#if (NIC_RX_BATCH_SUPPORT == ENABLED)
+   bool_t nicRxBatch;                             ///<A batch of frames is being delivered
+#endif
+#if (NIC_TX_BATCH_SUPPORT == ENABLED)
+   bool_t nicTxBatch;                             ///<Frames are sent as part of a batch
+#endif
+#if (NIC_GSO_SUPPORT == ENABLED)
+   uint32_t nicGsoPackets;                        ///<GSO packets split into TCP segments
+   uint32_t nicGsoSegments;                       ///<TCP segments cut out of GSO packets
+#endif
+#if (NIC_TX_QUEUE_SIZE > 0)
+   NicTxQueueItem nicTxQueue[NIC_TX_PRIORITY_COUNT][NIC_TX_QUEUE_SIZE + 1]; ///<Frames waiting for the transmitter, per band
+   volatile uint_t nicTxQueueHead[NIC_TX_PRIORITY_COUNT]; ///<Index of the oldest frame
+   volatile uint_t nicTxQueueTail[NIC_TX_PRIORITY_COUNT]; ///<Index of the next free entry
+   uint32_t nicTxQueueDrops;                      ///<Frames dropped because the queue was full
+#if (NIC_TX_DEADLINE_SUPPORT == ENABLED)
+   uint32_t nicTxDeadlineDrops;                   ///<Frames dropped past their deadline
+#endif
+#endif
    NicLinkState adminLinkState;                   ///<Administrative link state
    bool_t linkState;                              ///<Link state
+   systime_t linkUpTime;                          ///<Time at which the link came up
+   bool_t ready;                                  ///<The link is up and a usable address is assigned
+   systime_t readyTime;                           ///<Time at which the network became ready
    uint32_t linkSpeed;                            ///<Link speed
    NicDuplexMode duplexMode;                      ///<Duplex mode
    bool_t configured;                             ///<Configuration done
@@ -223,6 +340,9 @@ struct _NetInterface
    systime_t arpReachableTime;                    ///<ARP reachable time
    systime_t arpProbeTimeout;                     ///<ARP probe timeout
    ArpCacheEntry arpCache[ARP_CACHE_SIZE];        ///<ARP cache
+   ArpCacheEntry *arpHashTable[ARP_HASH_TABLE_SIZE]; ///<Hash buckets of the ARP cache
+   ArpQueueItem arpQueuePool[ARP_QUEUE_POOL_SIZE]; ///<Packets waiting for address resolution
+   ArpQueueItem *arpQueueFree;                    ///<Free queue items
 #endif
 #if (IGMP_HOST_SUPPORT == ENABLED)
    IgmpHostContext igmpHostContext;               ///<IGMP host context
@@ -283,7 +403,10 @@ struct _NetInterface
 
 typedef struct
 {
-   OsTaskParameters task; ///<Task parameters
+   OsTaskParameters task;        ///<Task parameters
+#if (NET_CONTROL_TASK_SUPPORT == ENABLED)
+   OsTaskParameters controlTask; ///<Parameters of the control task
+#endif
 } NetSettings;
 
 
@@ -298,13 +421,33 @@ typedef struct
    bool_t running;                               ///<The TCP/IP stack is currently running
    OsTaskParameters taskParams;                  ///<Task parameters
    OsTaskId taskId;                              ///<Task identifier
+#if (NET_CONTROL_TASK_SUPPORT == ENABLED)
+   OsEvent controlEvent;                         ///<Event object to wake up the control task
+   OsTaskParameters controlTaskParams;           ///<Parameters of the control task
+   OsTaskId controlTaskId;                       ///<Identifier of the control task
+#endif
    uint32_t entropy;
    systime_t timestamp;
+#if (NET_TICKLESS_SUPPORT == ENABLED)
+   systime_t tickTime;                           ///<Time at which the periodic operations last ran
+   systime_t tickTimeout;                        ///<Time until the next periodic operation is due
+#endif
    uint8_t randSeed[NET_RAND_SEED_SIZE];         ///<Random seed
    NetRandState randState;                       ///<Pseudo-random number generator state
    NetInterface interfaces[NET_INTERFACE_COUNT]; ///<Network interfaces
    NetLinkChangeCallbackEntry linkChangeCallbacks[NET_MAX_LINK_CHANGE_CALLBACKS];
    NetTimerCallbackEntry timerCallbacks[NET_MAX_TIMER_CALLBACKS];
+   NetTickDeadline tickDeadlines[NET_TICK_MODULE_COUNT]; ///<Next wakeup needed by each module
+   NetReadyCallbackEntry readyCallbacks[NET_MAX_READY_CALLBACKS];
+#if (NET_LINK_UP_FAST_PATH_SUPPORT == ENABLED)
+   bool_t fastPath;                              ///<A link came up recently
+   systime_t fastPathTime;                       ///<Time at which the last link came up
+#endif
+   uint32_t routeGeneration;                     ///<Incremented whenever a route or a neighbor changes
+#if (OS_MUTEX_STATS_SUPPORT == ENABLED)
+   OsMutexStats mutexStats;                      ///<Contention on the netMutex
+   OsMutexStats socketLockStats;                 ///<Contention on the locks of all the sockets
+#endif
 #if (NAT_SUPPORT == ENABLED)
    NatContext *natContext;                       ///<NAT context
 #endif
@@ -375,6 +518,7 @@ error_t netStopInterface(NetInterface *interface);
 
 void netTask(void);
 void netTaskEx(NetContext *context);
+void netControlTask(NetContext *context);
 
 //C++ guard
 #ifdef __cplusplus
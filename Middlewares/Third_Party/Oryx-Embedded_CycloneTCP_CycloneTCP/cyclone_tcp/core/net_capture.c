@@ -0,0 +1,907 @@
+/**
+ * @file net_capture.c
+ * @brief Packet capture tap
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * The frames received and sent on the Ethernet interfaces are run through a
+ * filter program, a subset of the classic BPF instruction set. The program
+ * returns the number of bytes of the frame to keep, 0 to ignore it. The
+ * accepted frames are copied into a ring, from the TCP/IP task with netMutex
+ * held, and read back by a single consumer task. When the ring is full the
+ * frames are dropped and counted, so that a capture never slows down the
+ * stack
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL NIC_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/net_capture.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (NET_CAPTURE_SUPPORT == ENABLED)
+
+//The ring must hold two records of the largest size
+#if (NET_CAPTURE_RING_SIZE <= (2 * (NET_CAPTURE_MAX_SNAP_LEN + 24)))
+   #error NET_CAPTURE_RING_SIZE parameter is not valid
+#endif
+
+//Size of a ring record holding n bytes of frame
+#define NET_CAPTURE_RECORD_SIZE(n) \
+   ((sizeof(NetCaptureRecord) + (n) + 7) & ~((size_t) 7))
+
+//Capture context
+NetCaptureContext netCaptureContext;
+
+//IAR EWARM compiler?
+#if defined(__ICCARM__) && defined(NET_CAPTURE_RING_SECTION)
+#pragma location = NET_CAPTURE_RING_SECTION
+static uint64_t netCaptureRing[NET_CAPTURE_RING_SIZE / 8];
+//Keil MDK-ARM or GCC compiler?
+#elif defined(NET_CAPTURE_RING_SECTION)
+static uint64_t netCaptureRing[NET_CAPTURE_RING_SIZE / 8]
+   __attribute__((__section__(NET_CAPTURE_RING_SECTION)));
+//Default data section
+#else
+static uint64_t netCaptureRing[NET_CAPTURE_RING_SIZE / 8];
+#endif
+
+
+/**
+ * @brief Check a filter program
+ *
+ * Only forward jumps are allowed and the program must end with a return
+ * instruction, so that every program terminates. Scratch memory accesses
+ * are checked against BPF_MEMWORDS
+ *
+ * @param[in] program Filter instructions
+ * @param[in] length Number of instructions
+ * @return Error code
+ **/
+
+error_t netCaptureCheckFilter(const NetCaptureInsn *program, uint_t length)
+{
+   uint_t i;
+   uint16_t code;
+   uint32_t k;
+   bool_t valid;
+
+   //Check parameters
+   if(program == NULL || length == 0 || length > NET_CAPTURE_MAX_INSNS)
+      return ERROR_INVALID_PARAMETER;
+
+   //The last instruction must return
+   if((program[length - 1].code & 0x07) != BPF_RET)
+      return ERROR_INVALID_SYNTAX;
+
+   //Check each instruction
+   for(i = 0; i < length; i++)
+   {
+      code = program[i].code;
+      k = program[i].k;
+
+      //Check opcode
+      switch(code)
+      {
+      case BPF_LD | BPF_W | BPF_ABS:
+      case BPF_LD | BPF_H | BPF_ABS:
+      case BPF_LD | BPF_B | BPF_ABS:
+      case BPF_LD | BPF_W | BPF_IND:
+      case BPF_LD | BPF_H | BPF_IND:
+      case BPF_LD | BPF_B | BPF_IND:
+      case BPF_LD | BPF_W | BPF_LEN:
+      case BPF_LD | BPF_IMM:
+      case BPF_LDX | BPF_W | BPF_LEN:
+      case BPF_LDX | BPF_IMM:
+      case BPF_LDX | BPF_B | BPF_MSH:
+      case BPF_ALU | BPF_ADD | BPF_K:
+      case BPF_ALU | BPF_SUB | BPF_K:
+      case BPF_ALU | BPF_MUL | BPF_K:
+      case BPF_ALU | BPF_OR | BPF_K:
+      case BPF_ALU | BPF_AND | BPF_K:
+      case BPF_ALU | BPF_LSH | BPF_K:
+      case BPF_ALU | BPF_RSH | BPF_K:
+      case BPF_ALU | BPF_XOR | BPF_K:
+      case BPF_ALU | BPF_ADD | BPF_X:
+      case BPF_ALU | BPF_SUB | BPF_X:
+      case BPF_ALU | BPF_MUL | BPF_X:
+      case BPF_ALU | BPF_DIV | BPF_X:
+      case BPF_ALU | BPF_MOD | BPF_X:
+      case BPF_ALU | BPF_OR | BPF_X:
+      case BPF_ALU | BPF_AND | BPF_X:
+      case BPF_ALU | BPF_LSH | BPF_X:
+      case BPF_ALU | BPF_RSH | BPF_X:
+      case BPF_ALU | BPF_XOR | BPF_X:
+      case BPF_ALU | BPF_NEG:
+      case BPF_RET | BPF_K:
+      case BPF_RET | BPF_A:
+      case BPF_MISC | BPF_TAX:
+      case BPF_MISC | BPF_TXA:
+         valid = TRUE;
+         break;
+
+      case BPF_ALU | BPF_DIV | BPF_K:
+      case BPF_ALU | BPF_MOD | BPF_K:
+         //Division by a null constant
+         valid = (k != 0) ? TRUE : FALSE;
+         break;
+
+      case BPF_LD | BPF_MEM:
+      case BPF_LDX | BPF_MEM:
+      case BPF_ST:
+      case BPF_STX:
+         //Scratch memory index
+         valid = (k < BPF_MEMWORDS) ? TRUE : FALSE;
+         break;
+
+      case BPF_JMP | BPF_JA:
+         //The target must lie within the program
+         valid = (k < (length - i - 1)) ? TRUE : FALSE;
+         break;
+
+      case BPF_JMP | BPF_JEQ | BPF_K:
+      case BPF_JMP | BPF_JGT | BPF_K:
+      case BPF_JMP | BPF_JGE | BPF_K:
+      case BPF_JMP | BPF_JSET | BPF_K:
+      case BPF_JMP | BPF_JEQ | BPF_X:
+      case BPF_JMP | BPF_JGT | BPF_X:
+      case BPF_JMP | BPF_JGE | BPF_X:
+      case BPF_JMP | BPF_JSET | BPF_X:
+         //Both targets must lie within the program
+         valid = ((i + 1 + program[i].jt) < length &&
+            (i + 1 + program[i].jf) < length) ? TRUE : FALSE;
+         break;
+
+      default:
+         //Unsupported instruction
+         valid = FALSE;
+         break;
+      }
+
+      //Invalid instruction?
+      if(!valid)
+         return ERROR_INVALID_SYNTAX;
+   }
+
+   //The program is valid
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Load a big-endian value from a frame
+ * @param[in] buffer Multi-part buffer containing the frame
+ * @param[in] offset Offset of the frame in the buffer
+ * @param[in] length Length of the frame
+ * @param[in] pos Position of the value in the frame
+ * @param[in] size Size of the value (1, 2 or 4 bytes)
+ * @param[out] value Value read
+ * @return TRUE if the value lies within the frame, else FALSE
+ **/
+
+static bool_t netCaptureLoad(const NetBuffer *buffer, size_t offset,
+   size_t length, uint32_t pos, size_t size, uint32_t *value)
+{
+   uint8_t temp[4];
+   const uint8_t *p;
+
+   //Out of bounds access?
+   if(pos >= length || size > (length - pos))
+      return FALSE;
+
+   //The value usually lies in a single chunk
+   p = netBufferAt(buffer, offset + pos, size);
+
+   //Straddling two chunks?
+   if(p == NULL)
+   {
+      netBufferRead(temp, buffer, offset + pos, size);
+      p = temp;
+   }
+
+   //Convert the value to host byte order
+   if(size == 4)
+   {
+      *value = LOAD32BE(p);
+   }
+   else if(size == 2)
+   {
+      *value = LOAD16BE(p);
+   }
+   else
+   {
+      *value = p[0];
+   }
+
+   //Successful processing
+   return TRUE;
+}
+
+
+/**
+ * @brief Run a filter program on a frame
+ * @param[in] program Filter instructions, checked with netCaptureCheckFilter()
+ * @param[in] length Number of instructions
+ * @param[in] buffer Multi-part buffer containing the frame
+ * @param[in] offset Offset of the frame in the buffer
+ * @return Number of bytes of the frame to keep (0 to ignore the frame)
+ **/
+
+uint_t netCaptureRunFilter(const NetCaptureInsn *program,
+   uint_t length, const NetBuffer *buffer, size_t offset)
+{
+   uint_t i;
+   uint32_t a;
+   uint32_t x;
+   uint32_t k;
+   uint32_t value;
+   size_t frameLength;
+   const NetCaptureInsn *insn;
+   uint32_t mem[BPF_MEMWORDS];
+
+   //Length of the frame
+   frameLength = netBufferGetLength(buffer) - offset;
+
+   //Initialize registers
+   a = 0;
+   x = 0;
+   osMemset(mem, 0, sizeof(mem));
+
+   //Execute the program
+   for(i = 0; i < length; i++)
+   {
+      insn = &program[i];
+      k = insn->k;
+
+      //Decode the current instruction
+      switch(insn->code)
+      {
+      case BPF_LD | BPF_W | BPF_ABS:
+         if(!netCaptureLoad(buffer, offset, frameLength, k, 4, &a))
+            return 0;
+         break;
+
+      case BPF_LD | BPF_H | BPF_ABS:
+         if(!netCaptureLoad(buffer, offset, frameLength, k, 2, &a))
+            return 0;
+         break;
+
+      case BPF_LD | BPF_B | BPF_ABS:
+         if(!netCaptureLoad(buffer, offset, frameLength, k, 1, &a))
+            return 0;
+         break;
+
+      case BPF_LD | BPF_W | BPF_IND:
+         if(!netCaptureLoad(buffer, offset, frameLength, x + k, 4, &a))
+            return 0;
+         break;
+
+      case BPF_LD | BPF_H | BPF_IND:
+         if(!netCaptureLoad(buffer, offset, frameLength, x + k, 2, &a))
+            return 0;
+         break;
+
+      case BPF_LD | BPF_B | BPF_IND:
+         if(!netCaptureLoad(buffer, offset, frameLength, x + k, 1, &a))
+            return 0;
+         break;
+
+      case BPF_LD | BPF_W | BPF_LEN:
+         a = frameLength;
+         break;
+
+      case BPF_LDX | BPF_W | BPF_LEN:
+         x = frameLength;
+         break;
+
+      case BPF_LD | BPF_IMM:
+         a = k;
+         break;
+
+      case BPF_LDX | BPF_IMM:
+         x = k;
+         break;
+
+      case BPF_LD | BPF_MEM:
+         a = mem[k];
+         break;
+
+      case BPF_LDX | BPF_MEM:
+         x = mem[k];
+         break;
+
+      case BPF_LDX | BPF_B | BPF_MSH:
+         //Length of the IP header, in bytes
+         if(!netCaptureLoad(buffer, offset, frameLength, k, 1, &value))
+            return 0;
+         x = (value & 0x0F) << 2;
+         break;
+
+      case BPF_ST:
+         mem[k] = a;
+         break;
+
+      case BPF_STX:
+         mem[k] = x;
+         break;
+
+      case BPF_ALU | BPF_ADD | BPF_K:
+         a += k;
+         break;
+
+      case BPF_ALU | BPF_SUB | BPF_K:
+         a -= k;
+         break;
+
+      case BPF_ALU | BPF_MUL | BPF_K:
+         a *= k;
+         break;
+
+      case BPF_ALU | BPF_DIV | BPF_K:
+         a /= k;
+         break;
+
+      case BPF_ALU | BPF_MOD | BPF_K:
+         a %= k;
+         break;
+
+      case BPF_ALU | BPF_OR | BPF_K:
+         a |= k;
+         break;
+
+      case BPF_ALU | BPF_AND | BPF_K:
+         a &= k;
+         break;
+
+      case BPF_ALU | BPF_LSH | BPF_K:
+         a = (k < 32) ? (a << k) : 0;
+         break;
+
+      case BPF_ALU | BPF_RSH | BPF_K:
+         a = (k < 32) ? (a >> k) : 0;
+         break;
+
+      case BPF_ALU | BPF_XOR | BPF_K:
+         a ^= k;
+         break;
+
+      case BPF_ALU | BPF_ADD | BPF_X:
+         a += x;
+         break;
+
+      case BPF_ALU | BPF_SUB | BPF_X:
+         a -= x;
+         break;
+
+      case BPF_ALU | BPF_MUL | BPF_X:
+         a *= x;
+         break;
+
+      case BPF_ALU | BPF_DIV | BPF_X:
+         //A division by zero rejects the frame
+         if(x == 0)
+            return 0;
+         a /= x;
+         break;
+
+      case BPF_ALU | BPF_MOD | BPF_X:
+         if(x == 0)
+            return 0;
+         a %= x;
+         break;
+
+      case BPF_ALU | BPF_OR | BPF_X:
+         a |= x;
+         break;
+
+      case BPF_ALU | BPF_AND | BPF_X:
+         a &= x;
+         break;
+
+      case BPF_ALU | BPF_LSH | BPF_X:
+         a = (x < 32) ? (a << x) : 0;
+         break;
+
+      case BPF_ALU | BPF_RSH | BPF_X:
+         a = (x < 32) ? (a >> x) : 0;
+         break;
+
+      case BPF_ALU | BPF_XOR | BPF_X:
+         a ^= x;
+         break;
+
+      case BPF_ALU | BPF_NEG:
+         a = (uint32_t) -(int32_t) a;
+         break;
+
+      case BPF_JMP | BPF_JA:
+         i += k;
+         break;
+
+      case BPF_JMP | BPF_JEQ | BPF_K:
+         i += (a == k) ? insn->jt : insn->jf;
+         break;
+
+      case BPF_JMP | BPF_JGT | BPF_K:
+         i += (a > k) ? insn->jt : insn->jf;
+         break;
+
+      case BPF_JMP | BPF_JGE | BPF_K:
+         i += (a >= k) ? insn->jt : insn->jf;
+         break;
+
+      case BPF_JMP | BPF_JSET | BPF_K:
+         i += ((a & k) != 0) ? insn->jt : insn->jf;
+         break;
+
+      case BPF_JMP | BPF_JEQ | BPF_X:
+         i += (a == x) ? insn->jt : insn->jf;
+         break;
+
+      case BPF_JMP | BPF_JGT | BPF_X:
+         i += (a > x) ? insn->jt : insn->jf;
+         break;
+
+      case BPF_JMP | BPF_JGE | BPF_X:
+         i += (a >= x) ? insn->jt : insn->jf;
+         break;
+
+      case BPF_JMP | BPF_JSET | BPF_X:
+         i += ((a & x) != 0) ? insn->jt : insn->jf;
+         break;
+
+      case BPF_RET | BPF_K:
+         return k;
+
+      case BPF_RET | BPF_A:
+         return a;
+
+      case BPF_MISC | BPF_TAX:
+         x = a;
+         break;
+
+      case BPF_MISC | BPF_TXA:
+         a = x;
+         break;
+
+      default:
+         //Not reached with a checked program
+         return 0;
+      }
+   }
+
+   //Not reached with a checked program
+   return 0;
+}
+
+
+/**
+ * @brief Install a new filter program
+ * @param[in] program Filter instructions (NULL to accept every frame)
+ * @param[in] length Number of instructions
+ * @return Error code
+ **/
+
+error_t netCaptureSetFilter(const NetCaptureInsn *program, uint_t length)
+{
+   error_t error;
+
+   //Check the program, if any
+   if(program != NULL)
+   {
+      error = netCaptureCheckFilter(program, length);
+      //Invalid program?
+      if(error)
+         return error;
+   }
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Save the program
+   if(program != NULL)
+   {
+      osMemcpy(netCaptureContext.program, program,
+         length * sizeof(NetCaptureInsn));
+      netCaptureContext.programLength = length;
+   }
+   else
+   {
+      netCaptureContext.programLength = 0;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Start capturing
+ *
+ * The ring and the statistics are reset
+ *
+ * @param[in] program Filter instructions (NULL to accept every frame)
+ * @param[in] length Number of instructions
+ * @return Error code
+ **/
+
+error_t netCaptureStart(const NetCaptureInsn *program, uint_t length)
+{
+   error_t error;
+
+   //Create the event object on the first start
+   if(!netCaptureContext.eventCreated)
+   {
+      if(!osCreateEvent(&netCaptureContext.event))
+         return ERROR_OUT_OF_RESOURCES;
+
+      netCaptureContext.eventCreated = TRUE;
+   }
+
+   //Install the filter
+   error = netCaptureSetFilter(program, length);
+   //Invalid program?
+   if(error)
+      return error;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Empty the ring
+   netCaptureContext.head = 0;
+   netCaptureContext.tail = 0;
+   osMemset(&netCaptureContext.stats, 0, sizeof(NetCaptureStats));
+
+   //Enable the capture hooks
+   netCaptureContext.running = TRUE;
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Stop capturing
+ *
+ * The frames already in the ring can still be read
+ **/
+
+void netCaptureStop(void)
+{
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Disable the capture hooks
+   netCaptureContext.running = FALSE;
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Wake up the consumer
+   if(netCaptureContext.eventCreated)
+   {
+      osSetEvent(&netCaptureContext.event);
+   }
+}
+
+
+/**
+ * @brief Wait for frames to be captured
+ * @param[in] timeout Maximum time to wait
+ * @return TRUE if the ring holds a frame, else FALSE
+ **/
+
+bool_t netCaptureWait(systime_t timeout)
+{
+   //Frames waiting?
+   if(netCaptureContext.head != netCaptureContext.tail)
+      return TRUE;
+
+   //Never started?
+   if(!netCaptureContext.eventCreated)
+      return FALSE;
+
+   //The event is signaled by the next frame stored into the empty ring
+   osResetEvent(&netCaptureContext.event);
+
+   //The ring may not have been empty anymore when the event was reset
+   if(netCaptureContext.head == netCaptureContext.tail)
+   {
+      osWaitForEvent(&netCaptureContext.event, timeout);
+   }
+
+   //Frames waiting?
+   return (netCaptureContext.head != netCaptureContext.tail) ? TRUE : FALSE;
+}
+
+
+/**
+ * @brief Get the oldest frame of the ring
+ *
+ * The record stays valid until netCaptureRelease() is called. Only one task
+ * may read the ring
+ *
+ * @return Pointer to the record, or NULL if the ring is empty
+ **/
+
+const NetCaptureRecord *netCapturePeek(void)
+{
+   size_t tail;
+   const NetCaptureRecord *record;
+
+   //Read offset
+   tail = netCaptureContext.tail;
+
+   //Empty ring?
+   if(tail == netCaptureContext.head)
+      return NULL;
+
+   //Point to the oldest record
+   record = (const NetCaptureRecord *) ((uint8_t *) netCaptureRing + tail);
+
+   //The next record lies at the start of the ring?
+   if(record->size == 0)
+   {
+      //Skip the end of the ring
+      tail = 0;
+      netCaptureContext.tail = tail;
+
+      //Empty ring?
+      if(tail == netCaptureContext.head)
+         return NULL;
+
+      //Point to the record
+      record = (const NetCaptureRecord *) netCaptureRing;
+   }
+
+   //Return a pointer to the record
+   return record;
+}
+
+
+/**
+ * @brief Remove the oldest frame from the ring
+ **/
+
+void netCaptureRelease(void)
+{
+   size_t tail;
+   const NetCaptureRecord *record;
+
+   //Point to the record returned by netCapturePeek()
+   record = netCapturePeek();
+
+   //Any record?
+   if(record != NULL)
+   {
+      //Offset of the next record
+      tail = ((const uint8_t *) record - (uint8_t *) netCaptureRing) +
+         record->size;
+
+      //Wrap around if necessary
+      if(tail >= NET_CAPTURE_RING_SIZE)
+      {
+         tail = 0;
+      }
+
+      //Free the record
+      netCaptureContext.tail = tail;
+   }
+}
+
+
+/**
+ * @brief Get capture statistics
+ * @param[out] stats Capture statistics
+ **/
+
+void netCaptureGetStats(NetCaptureStats *stats)
+{
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Copy statistics
+   *stats = netCaptureContext.stats;
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+}
+
+
+/**
+ * @brief Filter a frame and store it into the ring
+ * @param[in] interface Underlying network interface
+ * @param[in] buffer Multi-part buffer containing the frame
+ * @param[in] offset Offset of the frame in the buffer
+ * @param[in] direction Direction of the frame
+ * @param[in] timestamp Time the frame was captured, in microseconds
+ **/
+
+static void netCaptureFrame(NetInterface *interface, const NetBuffer *buffer,
+   size_t offset, NetCaptureDir direction, uint64_t timestamp)
+{
+   uint_t n;
+   size_t length;
+   size_t size;
+   size_t head;
+   size_t tail;
+   size_t pos;
+   NetCaptureRecord *record;
+
+   //Only Ethernet frames are captured
+   if(interface->nicDriver == NULL ||
+      interface->nicDriver->type != NIC_TYPE_ETHERNET)
+   {
+      return;
+   }
+
+   //Length of the frame
+   length = netBufferGetLength(buffer) - offset;
+
+   //Update statistics
+   netCaptureContext.stats.seen++;
+
+   //Run the filter
+   if(netCaptureContext.programLength > 0)
+   {
+      n = netCaptureRunFilter(netCaptureContext.program,
+         netCaptureContext.programLength, buffer, offset);
+   }
+   else
+   {
+      n = NET_CAPTURE_MAX_SNAP_LEN;
+   }
+
+   //Frame ignored?
+   if(n == 0)
+      return;
+
+   //Number of bytes to store
+   n = MIN(n, length);
+   n = MIN(n, NET_CAPTURE_MAX_SNAP_LEN);
+
+   //Size of the record
+   size = NET_CAPTURE_RECORD_SIZE(n);
+
+   //Current offsets of the ring
+   head = netCaptureContext.head;
+   tail = netCaptureContext.tail;
+
+   //The write offset must never catch up with the read offset, which would
+   //make the ring look empty
+   if(head >= tail)
+   {
+      if((head + size) < NET_CAPTURE_RING_SIZE ||
+         ((head + size) == NET_CAPTURE_RING_SIZE && tail > 0))
+      {
+         pos = head;
+      }
+      else if(size < tail)
+      {
+         //Mark the end of the ring
+         ((NetCaptureRecord *) ((uint8_t *) netCaptureRing + head))->size = 0;
+         pos = 0;
+      }
+      else
+      {
+         pos = SIZE_MAX;
+      }
+   }
+   else
+   {
+      pos = ((head + size) < tail) ? head : SIZE_MAX;
+   }
+
+   //Ring full?
+   if(pos == SIZE_MAX)
+   {
+      netCaptureContext.stats.dropped++;
+      return;
+   }
+
+   //Fill in the record
+   record = (NetCaptureRecord *) ((uint8_t *) netCaptureRing + pos);
+   record->size = (uint16_t) size;
+   record->interfaceIndex = (uint8_t) interface->index;
+   record->direction = (uint8_t) direction;
+   record->length = (uint16_t) MIN(length, UINT16_MAX);
+   record->capLength = (uint16_t) n;
+   record->timestamp = timestamp;
+
+   //Copy the first bytes of the frame
+   netBufferRead(record->data, buffer, offset, n);
+
+   //Offset of the next record
+   pos += size;
+
+   //Wrap around if necessary
+   if(pos >= NET_CAPTURE_RING_SIZE)
+   {
+      pos = 0;
+   }
+
+   //Publish the record, once written
+   netCaptureContext.head = pos;
+
+   //Update statistics
+   netCaptureContext.stats.captured++;
+
+   //Wake up the consumer if the ring was empty
+   if(head == tail)
+   {
+      osSetEvent(&netCaptureContext.event);
+   }
+}
+
+
+/**
+ * @brief Capture hook of the receive path
+ * @param[in] interface Underlying network interface
+ * @param[in] packet Incoming frame
+ * @param[in] length Length of the frame
+ **/
+
+void netCaptureRxFrame(NetInterface *interface, const uint8_t *packet,
+   size_t length)
+{
+   NetBuffer1 buffer;
+
+   //The incoming frame fits in a single chunk
+   buffer.chunkCount = 1;
+   buffer.maxChunkCount = 1;
+   buffer.chunk[0].address = (void *) packet;
+   buffer.chunk[0].length = (uint16_t) length;
+   buffer.chunk[0].size = 0;
+
+   //Filter and store the frame
+   netCaptureFrame(interface, (NetBuffer *) &buffer, 0, NET_CAPTURE_DIR_RX,
+      NET_CAPTURE_TIME_US());
+}
+
+
+/**
+ * @brief Capture hook of the transmit path
+ * @param[in] interface Underlying network interface
+ * @param[in] buffer Multi-part buffer containing the frame
+ * @param[in] offset Offset of the frame in the buffer
+ **/
+
+void netCaptureTxFrame(NetInterface *interface, const NetBuffer *buffer,
+   size_t offset)
+{
+   //Filter and store the frame
+   netCaptureFrame(interface, buffer, offset, NET_CAPTURE_DIR_TX,
+      NET_CAPTURE_TIME_US());
+}
+
+#endif
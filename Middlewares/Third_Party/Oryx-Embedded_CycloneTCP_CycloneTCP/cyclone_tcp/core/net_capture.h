@@ -0,0 +1,257 @@
+/**
+ * @file net_capture.h
+ * @brief Packet capture tap
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+#ifndef _NET_CAPTURE_H
+#define _NET_CAPTURE_H
+
+//Dependencies
+#include "core/net.h"
+
+//Packet capture support
+#ifndef NET_CAPTURE_SUPPORT
+   #define NET_CAPTURE_SUPPORT DISABLED
+#elif (NET_CAPTURE_SUPPORT != ENABLED && NET_CAPTURE_SUPPORT != DISABLED)
+   #error NET_CAPTURE_SUPPORT parameter is not valid
+#endif
+
+//Size of the capture ring, in bytes
+#ifndef NET_CAPTURE_RING_SIZE
+   #define NET_CAPTURE_RING_SIZE 16384
+#elif (NET_CAPTURE_RING_SIZE < 2048 || (NET_CAPTURE_RING_SIZE % 8) != 0)
+   #error NET_CAPTURE_RING_SIZE parameter is not valid
+#endif
+
+//Maximum number of bytes captured per frame
+#ifndef NET_CAPTURE_MAX_SNAP_LEN
+   #define NET_CAPTURE_MAX_SNAP_LEN 1536
+#elif (NET_CAPTURE_MAX_SNAP_LEN < 64 || NET_CAPTURE_MAX_SNAP_LEN > 65535)
+   #error NET_CAPTURE_MAX_SNAP_LEN parameter is not valid
+#endif
+
+//Maximum number of instructions of a filter program
+#ifndef NET_CAPTURE_MAX_INSNS
+   #define NET_CAPTURE_MAX_INSNS 64
+#elif (NET_CAPTURE_MAX_INSNS < 1 || NET_CAPTURE_MAX_INSNS > 256)
+   #error NET_CAPTURE_MAX_INSNS parameter is not valid
+#endif
+
+//Microsecond clock the frames are stamped with
+#ifndef NET_CAPTURE_TIME_US
+   #define NET_CAPTURE_TIME_US() ((uint64_t) osGetSystemTime64() * 1000)
+#endif
+
+//Section where to place the capture ring (the default data section is used
+//when this parameter is not defined)
+#ifdef _DOXYGEN_
+   #define NET_CAPTURE_RING_SECTION ".ram_d2"
+#endif
+
+//Capture hooks (a load and a branch while no capture is running)
+#if (NET_CAPTURE_SUPPORT == ENABLED)
+   #define NET_CAPTURE_RX(interface, packet, length) \
+      if(netCaptureContext.running) netCaptureRxFrame(interface, packet, length)
+   #define NET_CAPTURE_TX(interface, buffer, offset) \
+      if(netCaptureContext.running) netCaptureTxFrame(interface, buffer, offset)
+#else
+   #define NET_CAPTURE_RX(interface, packet, length)
+   #define NET_CAPTURE_TX(interface, buffer, offset)
+#endif
+
+//Instruction classes of the filter programs (classic BPF encoding)
+#define BPF_LD   0x00
+#define BPF_LDX  0x01
+#define BPF_ST   0x02
+#define BPF_STX  0x03
+#define BPF_ALU  0x04
+#define BPF_JMP  0x05
+#define BPF_RET  0x06
+#define BPF_MISC 0x07
+
+//Load sizes
+#define BPF_W 0x00
+#define BPF_H 0x08
+#define BPF_B 0x10
+
+//Load modes
+#define BPF_IMM 0x00
+#define BPF_ABS 0x20
+#define BPF_IND 0x40
+#define BPF_MEM 0x60
+#define BPF_LEN 0x80
+#define BPF_MSH 0xA0
+
+//ALU operations
+#define BPF_ADD 0x00
+#define BPF_SUB 0x10
+#define BPF_MUL 0x20
+#define BPF_DIV 0x30
+#define BPF_OR  0x40
+#define BPF_AND 0x50
+#define BPF_LSH 0x60
+#define BPF_RSH 0x70
+#define BPF_NEG 0x80
+#define BPF_MOD 0x90
+#define BPF_XOR 0xA0
+
+//Jump conditions
+#define BPF_JA   0x00
+#define BPF_JEQ  0x10
+#define BPF_JGT  0x20
+#define BPF_JGE  0x30
+#define BPF_JSET 0x40
+
+//Operand sources
+#define BPF_K 0x00
+#define BPF_X 0x08
+#define BPF_A 0x10
+
+//Register transfers
+#define BPF_TAX 0x00
+#define BPF_TXA 0x80
+
+//Number of words of the scratch memory
+#define BPF_MEMWORDS 16
+
+//Instruction builders
+#define BPF_STMT(code, k) {(uint16_t) (code), 0, 0, (uint32_t) (k)}
+#define BPF_JUMP(code, k, jt, jf) {(uint16_t) (code), (jt), (jf), (uint32_t) (k)}
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Direction of a captured frame
+ **/
+
+typedef enum
+{
+   NET_CAPTURE_DIR_RX = 1, ///<Received frame
+   NET_CAPTURE_DIR_TX = 2  ///<Transmitted frame
+} NetCaptureDir;
+
+
+/**
+ * @brief Filter instruction
+ *
+ * The layout is the one of the classic BPF instructions, so that a program
+ * generated by "tcpdump -dd" can be used as is
+ **/
+
+typedef struct
+{
+   uint16_t code; ///<Opcode
+   uint8_t jt;    ///<Offset of the instruction run if the condition is true
+   uint8_t jf;    ///<Offset of the instruction run if the condition is false
+   uint32_t k;    ///<Generic operand
+} NetCaptureInsn;
+
+
+/**
+ * @brief Captured frame, as stored in the ring
+ **/
+
+typedef struct
+{
+   uint16_t size;           ///<Size of the record, header included (0 marks the end of the ring)
+   uint8_t interfaceIndex;  ///<Index of the network interface
+   uint8_t direction;       ///<NET_CAPTURE_DIR_RX or NET_CAPTURE_DIR_TX
+   uint16_t length;         ///<Length of the frame
+   uint16_t capLength;      ///<Number of bytes stored
+   uint64_t timestamp;      ///<Time the frame was captured, in microseconds
+   uint8_t data[];          ///<First capLength bytes of the frame
+} NetCaptureRecord;
+
+
+/**
+ * @brief Capture statistics
+ **/
+
+typedef struct
+{
+   uint32_t seen;     ///<Frames the filter was run on
+   uint32_t captured; ///<Frames stored in the ring
+   uint32_t dropped;  ///<Frames accepted by the filter but lost, ring full
+} NetCaptureStats;
+
+
+/**
+ * @brief Capture context
+ *
+ * The filter and the producer side of the ring are only used with netMutex
+ * held. The ring has a single consumer
+ **/
+
+typedef struct
+{
+   volatile bool_t running;                        ///<Capture in progress
+   bool_t eventCreated;                            ///<The event object exists
+   OsEvent event;                                  ///<Signaled when the ring becomes non empty
+   NetCaptureInsn program[NET_CAPTURE_MAX_INSNS];  ///<Filter program
+   uint_t programLength;                           ///<Number of instructions (0 accepts every frame)
+   volatile size_t head;                           ///<Write offset of the ring
+   volatile size_t tail;                           ///<Read offset of the ring
+   NetCaptureStats stats;                          ///<Capture statistics
+} NetCaptureContext;
+
+
+//Global variables
+extern NetCaptureContext netCaptureContext;
+
+//Packet capture related functions
+error_t netCaptureCheckFilter(const NetCaptureInsn *program, uint_t length);
+error_t netCaptureSetFilter(const NetCaptureInsn *program, uint_t length);
+
+error_t netCaptureStart(const NetCaptureInsn *program, uint_t length);
+void netCaptureStop(void);
+
+bool_t netCaptureWait(systime_t timeout);
+const NetCaptureRecord *netCapturePeek(void);
+void netCaptureRelease(void);
+
+void netCaptureGetStats(NetCaptureStats *stats);
+
+uint_t netCaptureRunFilter(const NetCaptureInsn *program, uint_t length,
+   const NetBuffer *buffer, size_t offset);
+
+void netCaptureRxFrame(NetInterface *interface, const uint8_t *packet,
+   size_t length);
+
+void netCaptureTxFrame(NetInterface *interface, const NetBuffer *buffer,
+   size_t offset);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
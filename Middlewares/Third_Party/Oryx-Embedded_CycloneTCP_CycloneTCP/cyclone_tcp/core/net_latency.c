@@ -0,0 +1,278 @@
+/**
+ * @file net_latency.c
+ * @brief Receive path latency instrumentation
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * Each received frame is timestamped at fixed points of the receive path,
+ * from the Ethernet interrupt up to socket delivery. The time elapsed
+ * between two consecutive points feeds the histogram of the corresponding
+ * stage. All points but the interrupt are reached from the TCP/IP task
+ * with netMutex held, so a single set of timestamps is sufficient
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL NIC_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/net_latency.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (NET_LATENCY_SUPPORT == ENABLED)
+
+//Upper bounds of the histogram buckets, in microseconds
+static const uint32_t netLatencyBucketLimits[NET_LATENCY_BUCKET_COUNT] =
+{
+   1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, UINT32_MAX
+};
+
+//Stage names, each stage being named after the work it measures
+static const char_t *const netLatencyStageNames[NET_LATENCY_STAGE_COUNT] =
+{
+   "irq",
+   "irq-to-task",
+   "ring-wait",
+   "driver",
+   "ethernet",
+   "ipv4",
+   "transport",
+   "total"
+};
+
+//Timestamp of the first receive interrupt not yet handled by the task
+static volatile uint32_t netLatencyIrqTimestamp;
+static volatile bool_t netLatencyIrqPending;
+
+//Timestamps of the frame being processed
+static uint32_t netLatencyTimestamps[NET_LATENCY_POINT_COUNT];
+static uint_t netLatencyValidPoints;
+static uint32_t netLatencyOrigin;
+static bool_t netLatencyOriginValid;
+
+//Latency histograms
+static NetLatencyHistogram netLatencyHistograms[NET_LATENCY_STAGE_COUNT];
+
+
+/**
+ * @brief Add a sample to the histogram of a stage
+ * @param[in] stage Stage index
+ * @param[in] delta Elapsed time, in timestamp counter ticks
+ **/
+
+static void netLatencyRecord(uint_t stage, uint32_t delta)
+{
+   uint_t i;
+   uint32_t ticksPerUs;
+   uint32_t us;
+   NetLatencyHistogram *histogram;
+
+   //Convert the elapsed time to microseconds
+   ticksPerUs = MAX(NET_LATENCY_CLOCK_HZ / 1000000, 1);
+   us = delta / ticksPerUs;
+
+   //Point to the histogram of the stage
+   histogram = &netLatencyHistograms[stage];
+
+   //Search for the matching bucket
+   for(i = 0; i < (NET_LATENCY_BUCKET_COUNT - 1); i++)
+   {
+      if(us < netLatencyBucketLimits[i])
+         break;
+   }
+
+   //Update the histogram
+   histogram->buckets[i]++;
+   histogram->sum += us;
+   histogram->min = (histogram->count == 0) ? us : MIN(histogram->min, us);
+   histogram->max = MAX(histogram->max, us);
+   histogram->count++;
+}
+
+
+/**
+ * @brief Timestamp a receive interrupt
+ *
+ * This function is called from the NIC interrupt handler when a frame has
+ * been received
+ **/
+
+void netLatencyMarkIrq(void)
+{
+   //Only the first interrupt of a batch is considered
+   if(!netLatencyIrqPending)
+   {
+      netLatencyIrqTimestamp = NET_LATENCY_TIMESTAMP();
+      netLatencyIrqPending = TRUE;
+   }
+}
+
+
+/**
+ * @brief Timestamp a point of the receive path
+ * @param[in] point Point reached by the frame being processed
+ **/
+
+void netLatencyMark(NetLatencyPoint point)
+{
+   int_t i;
+   uint32_t now;
+
+   //Capture the current time
+   now = NET_LATENCY_TIMESTAMP();
+
+   //The event handler starts a new batch of frames
+   if(point == NET_LATENCY_POINT_EVENT)
+   {
+      //Forget the timestamps of the previous batch
+      netLatencyValidPoints = 0;
+
+      //Check whether the batch was triggered by a receive interrupt
+      if(netLatencyIrqPending)
+      {
+         netLatencyTimestamps[NET_LATENCY_POINT_IRQ] = netLatencyIrqTimestamp;
+         netLatencyValidPoints = 1U << NET_LATENCY_POINT_IRQ;
+         netLatencyIrqPending = FALSE;
+
+         //The total latency of the batch is measured from the interrupt
+         netLatencyOrigin = netLatencyTimestamps[NET_LATENCY_POINT_IRQ];
+      }
+      else
+      {
+         //The driver is polled
+         netLatencyOrigin = now;
+      }
+
+      //The origin of the batch is now known
+      netLatencyOriginValid = TRUE;
+   }
+   else
+   {
+      //Timestamps beyond this point belong to a previous frame
+      netLatencyValidPoints &= (1U << point) - 1;
+   }
+
+   //Search for the latest earlier point the frame went through
+   for(i = (int_t) point - 1; i >= 0; i--)
+   {
+      if((netLatencyValidPoints & (1U << i)) != 0)
+      {
+         //Record the duration of the stage
+         netLatencyRecord(point, now - netLatencyTimestamps[i]);
+         break;
+      }
+   }
+
+   //Save the timestamp of the current point
+   netLatencyTimestamps[point] = now;
+   netLatencyValidPoints |= 1U << point;
+
+   //Data delivered to a socket?
+   if(point == NET_LATENCY_POINT_SOCKET && netLatencyOriginValid)
+   {
+      //Record the end-to-end latency
+      netLatencyRecord(NET_LATENCY_STAGE_TOTAL, now - netLatencyOrigin);
+   }
+}
+
+
+/**
+ * @brief Get the latency histogram of a stage
+ * @param[in] stage Stage index
+ * @param[out] histogram Snapshot of the histogram
+ * @return Error code
+ **/
+
+error_t netLatencyGetStats(uint_t stage, NetLatencyHistogram *histogram)
+{
+   //Check parameters
+   if(stage >= NET_LATENCY_STAGE_COUNT || histogram == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Enter critical section
+   osSuspendAllTasks();
+   //Copy the histogram
+   *histogram = netLatencyHistograms[stage];
+   //Exit critical section
+   osResumeAllTasks();
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Clear all latency histograms
+ **/
+
+void netLatencyReset(void)
+{
+   //Enter critical section
+   osSuspendAllTasks();
+   //Clear histograms
+   osMemset(netLatencyHistograms, 0, sizeof(netLatencyHistograms));
+   //Exit critical section
+   osResumeAllTasks();
+}
+
+
+/**
+ * @brief Get the name of a stage
+ * @param[in] stage Stage index
+ * @return Stage name
+ **/
+
+const char_t *netLatencyGetStageName(uint_t stage)
+{
+   //Check stage index
+   if(stage >= NET_LATENCY_STAGE_COUNT)
+      return "unknown";
+
+   //Return the name of the stage
+   return netLatencyStageNames[stage];
+}
+
+
+/**
+ * @brief Get the upper bound of a histogram bucket
+ * @param[in] index Bucket index
+ * @return Upper bound in microseconds (UINT32_MAX for the last bucket)
+ **/
+
+uint32_t netLatencyGetBucketLimit(uint_t index)
+{
+   //Check bucket index
+   if(index >= NET_LATENCY_BUCKET_COUNT)
+      return 0;
+
+   //Return the upper bound of the bucket
+   return netLatencyBucketLimits[index];
+}
+
+#endif
@@ -0,0 +1,134 @@
+/**
+ * @file net_latency.h
+ * @brief Receive path latency instrumentation
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+#ifndef _NET_LATENCY_H
+#define _NET_LATENCY_H
+
+//Dependencies
+#include "net_config.h"
+#include "os_port.h"
+#include "error.h"
+
+//Receive path latency instrumentation
+#ifndef NET_LATENCY_SUPPORT
+   #define NET_LATENCY_SUPPORT DISABLED
+#elif (NET_LATENCY_SUPPORT != ENABLED && NET_LATENCY_SUPPORT != DISABLED)
+   #error NET_LATENCY_SUPPORT parameter is not valid
+#endif
+
+//Free-running 32-bit timestamp counter (for instance DWT->CYCCNT)
+#if (NET_LATENCY_SUPPORT == ENABLED)
+   #ifndef NET_LATENCY_TIMESTAMP
+      #error NET_LATENCY_TIMESTAMP macro is not defined
+   #endif
+#endif
+
+//Frequency of the timestamp counter, in Hz
+#ifndef NET_LATENCY_CLOCK_HZ
+   #define NET_LATENCY_CLOCK_HZ 1000000
+#endif
+
+//Number of histogram buckets
+#define NET_LATENCY_BUCKET_COUNT 13
+
+//Instrumentation hooks
+#if (NET_LATENCY_SUPPORT == ENABLED)
+   #define NET_LATENCY_MARK(point) netLatencyMark(point)
+   #define NET_LATENCY_MARK_IRQ() netLatencyMarkIrq()
+#else
+   #define NET_LATENCY_MARK(point)
+   #define NET_LATENCY_MARK_IRQ()
+#endif
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Points of the receive path where a frame is timestamped
+ **/
+
+typedef enum
+{
+   NET_LATENCY_POINT_IRQ       = 0, ///<Receive interrupt
+   NET_LATENCY_POINT_EVENT     = 1, ///<NIC event handler, TCP/IP task with netMutex held
+   NET_LATENCY_POINT_DRIVER    = 2, ///<Frame picked from the RX descriptor ring
+   NET_LATENCY_POINT_NIC       = 3, ///<Frame handed to the stack
+   NET_LATENCY_POINT_IPV4      = 4, ///<IPv4 processing
+   NET_LATENCY_POINT_TRANSPORT = 5, ///<TCP or UDP processing
+   NET_LATENCY_POINT_SOCKET    = 6, ///<Data delivered to the socket
+   NET_LATENCY_POINT_COUNT     = 7
+} NetLatencyPoint;
+
+
+/**
+ * @brief Measured stages
+ *
+ * Stage n ends at point n and starts at the latest earlier point the frame
+ * went through. The total stage spans from the interrupt (or from the event
+ * handler when the driver is polled) to socket delivery
+ **/
+
+#define NET_LATENCY_STAGE_TOTAL NET_LATENCY_POINT_COUNT
+#define NET_LATENCY_STAGE_COUNT (NET_LATENCY_POINT_COUNT + 1)
+
+
+/**
+ * @brief Latency histogram of a stage
+ **/
+
+typedef struct
+{
+   uint32_t count;                             ///<Number of samples
+   uint32_t min;                               ///<Shortest latency, in microseconds
+   uint32_t max;                               ///<Longest latency, in microseconds
+   uint64_t sum;                               ///<Sum of the latencies, in microseconds
+   uint32_t buckets[NET_LATENCY_BUCKET_COUNT]; ///<Samples per bucket
+} NetLatencyHistogram;
+
+
+//Latency instrumentation related functions
+void netLatencyMarkIrq(void);
+void netLatencyMark(NetLatencyPoint point);
+
+error_t netLatencyGetStats(uint_t stage, NetLatencyHistogram *histogram);
+void netLatencyReset(void);
+
+const char_t *netLatencyGetStageName(uint_t stage);
+uint32_t netLatencyGetBucketLimit(uint_t index);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
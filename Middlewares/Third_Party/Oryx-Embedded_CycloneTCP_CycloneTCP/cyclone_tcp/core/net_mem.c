@@ -48,16 +48,128 @@
 //Use fixed-size blocks allocation?
 #if (NET_MEM_POOL_SUPPORT == ENABLED)
 
+/**
+ * @brief Block class of the memory pool
+ **/
+
+typedef struct
+{
+   uint8_t *base;
+   size_t blockSize;
+   uint_t blockCount;
+   void *freeList;
+   MemPoolClassStats stats;
+#if (MEM_TAG_SUPPORT == 1)
+   uint8_t *tags;
+#endif
+} MemPoolClass;
+
+//IAR EWARM compiler?
+#if defined(__ICCARM__) && defined(NET_MEM_POOL_SECTION)
+
+//Small blocks
+#if (NET_MEM_POOL_SMALL_BUFFER_COUNT > 0)
+#pragma location = NET_MEM_POOL_SECTION
+static uint32_t memPoolSmall[NET_MEM_POOL_SMALL_BUFFER_COUNT][NET_MEM_POOL_SMALL_BUFFER_SIZE / 4];
+#endif
+//Medium blocks
+#if (NET_MEM_POOL_MEDIUM_BUFFER_COUNT > 0)
+#pragma location = NET_MEM_POOL_SECTION
+static uint32_t memPoolMedium[NET_MEM_POOL_MEDIUM_BUFFER_COUNT][NET_MEM_POOL_MEDIUM_BUFFER_SIZE / 4];
+#endif
+//Large blocks
+#pragma location = NET_MEM_POOL_SECTION
+static uint32_t memPool[NET_MEM_POOL_BUFFER_COUNT][NET_MEM_POOL_BUFFER_SIZE / 4];
+
+//Keil MDK-ARM or GCC compiler?
+#elif defined(NET_MEM_POOL_SECTION)
+
+//Small blocks
+#if (NET_MEM_POOL_SMALL_BUFFER_COUNT > 0)
+static uint32_t memPoolSmall[NET_MEM_POOL_SMALL_BUFFER_COUNT][NET_MEM_POOL_SMALL_BUFFER_SIZE / 4]
+   __attribute__((__section__(NET_MEM_POOL_SECTION)));
+#endif
+//Medium blocks
+#if (NET_MEM_POOL_MEDIUM_BUFFER_COUNT > 0)
+static uint32_t memPoolMedium[NET_MEM_POOL_MEDIUM_BUFFER_COUNT][NET_MEM_POOL_MEDIUM_BUFFER_SIZE / 4]
+   __attribute__((__section__(NET_MEM_POOL_SECTION)));
+#endif
+//Large blocks
+static uint32_t memPool[NET_MEM_POOL_BUFFER_COUNT][NET_MEM_POOL_BUFFER_SIZE / 4]
+   __attribute__((__section__(NET_MEM_POOL_SECTION)));
+
+//Default data section
+#else
+
+//Small blocks
+#if (NET_MEM_POOL_SMALL_BUFFER_COUNT > 0)
+static uint32_t memPoolSmall[NET_MEM_POOL_SMALL_BUFFER_COUNT][NET_MEM_POOL_SMALL_BUFFER_SIZE / 4];
+#endif
+//Medium blocks
+#if (NET_MEM_POOL_MEDIUM_BUFFER_COUNT > 0)
+static uint32_t memPoolMedium[NET_MEM_POOL_MEDIUM_BUFFER_COUNT][NET_MEM_POOL_MEDIUM_BUFFER_SIZE / 4];
+#endif
+//Large blocks
+static uint32_t memPool[NET_MEM_POOL_BUFFER_COUNT][NET_MEM_POOL_BUFFER_SIZE / 4];
+
+#endif
+
+//Allocations charged to the subsystem of the caller?
+#if (MEM_TAG_SUPPORT == 1)
+
+//Tag of each block, beside the pool
+#if (NET_MEM_POOL_SMALL_BUFFER_COUNT > 0)
+static uint8_t memPoolSmallTags[NET_MEM_POOL_SMALL_BUFFER_COUNT];
+#endif
+#if (NET_MEM_POOL_MEDIUM_BUFFER_COUNT > 0)
+static uint8_t memPoolMediumTags[NET_MEM_POOL_MEDIUM_BUFFER_COUNT];
+#endif
+static uint8_t memPoolTags[NET_MEM_POOL_BUFFER_COUNT];
+
+#endif
+
 //Mutex preventing simultaneous access to the memory pool
 static OsMutex memPoolMutex;
-//Memory pool
-static uint32_t memPool[NET_MEM_POOL_BUFFER_COUNT][NET_MEM_POOL_BUFFER_SIZE / 4];
-//Allocation table
-static bool_t memPoolAllocTable[NET_MEM_POOL_BUFFER_COUNT];
-//Number of buffers currently allocated
-uint_t memPoolCurrentUsage;
-//Maximum number of buffers that have been allocated so far
-uint_t memPoolMaxUsage;
+//Block classes, sorted by increasing block size
+static MemPoolClass memPoolClasses[NET_MEM_POOL_CLASS_COUNT];
+
+#endif
+//Loaned memory regions?
+#if (NET_MEM_RX_LOAN_SUPPORT == ENABLED || NET_MEM_TX_LOAN_SUPPORT == ENABLED)
+
+//Memory regions loaned by NIC drivers and applications
+static NetMemLoanRegion memPoolLoanRegions[NET_MEM_MAX_LOAN_REGIONS];
+
+#endif
+//Zero-copy reception?
+#if (NET_MEM_RX_LOAN_SUPPORT == ENABLED)
+
+//Frame currently offered for loan
+static const uint8_t *netBufferLoanData;
+//Length of the frame currently offered for loan
+static size_t netBufferLoanLength;
+//The offered frame has been accepted by the upper layer
+static bool_t netBufferLoanAccepted;
+
+#endif
+
+//Zero-copy transmission?
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+
+//Buffers held by NIC drivers
+static NetBufferHold netBufferHoldTable[NET_MEM_MAX_TX_HOLDS];
+//Number of buffers currently held
+static uint_t netBufferHoldCount;
+
+#endif
+
+//Shared buffers?
+#if (NET_MEM_SHARED_BUFFER_SUPPORT == ENABLED)
+
+//References to shared buffers
+static NetBufferShare netBufferShareTable[NET_MEM_MAX_SHARED_REFS];
+//Number of references currently in use
+static uint_t netBufferShareCount;
 
 #endif
 
@@ -71,6 +183,11 @@ error_t memPoolInit(void)
 {
 //Use fixed-size blocks allocation?
 #if (NET_MEM_POOL_SUPPORT == ENABLED)
+   uint_t i;
+   uint_t j;
+   uint8_t *p;
+   MemPoolClass *poolClass;
+
    //Create a mutex to prevent simultaneous access to the memory pool
    if(!osCreateMutex(&memPoolMutex))
    {
@@ -78,12 +195,56 @@ error_t memPoolInit(void)
       return ERROR_OUT_OF_RESOURCES;
    }
 
-   //Clear allocation table
-   osMemset(memPoolAllocTable, 0, sizeof(memPoolAllocTable));
+   //Clear block classes
+   osMemset(memPoolClasses, 0, sizeof(memPoolClasses));
 
-   //Clear statistics
-   memPoolCurrentUsage = 0;
-   memPoolMaxUsage = 0;
+#if (NET_MEM_POOL_SMALL_BUFFER_COUNT > 0)
+   //Small blocks
+   memPoolClasses[0].base = (uint8_t *) memPoolSmall;
+   memPoolClasses[0].blockCount = NET_MEM_POOL_SMALL_BUFFER_COUNT;
+#if (MEM_TAG_SUPPORT == 1)
+   memPoolClasses[0].tags = memPoolSmallTags;
+#endif
+#endif
+   memPoolClasses[0].blockSize = NET_MEM_POOL_SMALL_BUFFER_SIZE;
+
+#if (NET_MEM_POOL_MEDIUM_BUFFER_COUNT > 0)
+   //Medium blocks
+   memPoolClasses[1].base = (uint8_t *) memPoolMedium;
+   memPoolClasses[1].blockCount = NET_MEM_POOL_MEDIUM_BUFFER_COUNT;
+#if (MEM_TAG_SUPPORT == 1)
+   memPoolClasses[1].tags = memPoolMediumTags;
+#endif
+#endif
+   memPoolClasses[1].blockSize = NET_MEM_POOL_MEDIUM_BUFFER_SIZE;
+
+   //Large blocks
+   memPoolClasses[2].base = (uint8_t *) memPool;
+   memPoolClasses[2].blockCount = NET_MEM_POOL_BUFFER_COUNT;
+   memPoolClasses[2].blockSize = NET_MEM_POOL_BUFFER_SIZE;
+#if (MEM_TAG_SUPPORT == 1)
+   memPoolClasses[2].tags = memPoolTags;
+#endif
+
+   //Loop through block classes
+   for(i = 0; i < NET_MEM_POOL_CLASS_COUNT; i++)
+   {
+      //Point to the current class
+      poolClass = &memPoolClasses[i];
+
+      //Link the blocks of the class together, the first word of a free
+      //block pointing to the next free block
+      for(j = poolClass->blockCount; j > 0; j--)
+      {
+         p = poolClass->base + (j - 1) * poolClass->blockSize;
+         *(void **) p = poolClass->freeList;
+         poolClass->freeList = p;
+      }
+
+      //Initialize statistics
+      poolClass->stats.blockSize = poolClass->blockSize;
+      poolClass->stats.blockCount = poolClass->blockCount;
+   }
 #endif
 
    //Successful initialization
@@ -93,14 +254,19 @@ error_t memPoolInit(void)
 
 /**
  * @brief Allocate a memory block
+ *
+ * memPoolAlloc() expands to this function with the tag of the caller
+ *
  * @param[in] size Bytes to allocate
+ * @param[in] tag Subsystem the block is charged to (MemTag.h)
  * @return Pointer to the allocated space or NULL if there is insufficient memory available
  **/
 
-void *memPoolAlloc(size_t size)
+void *memPoolAllocTagged(size_t size, uint8_t tag)
 {
 #if (NET_MEM_POOL_SUPPORT == ENABLED)
    uint_t i;
+   MemPoolClass *poolClass;
 #endif
 
    //Pointer to the allocated memory block
@@ -114,35 +280,62 @@ void *memPoolAlloc(size_t size)
    //Acquire exclusive access to the memory pool
    osAcquireMutex(&memPoolMutex);
 
-   //Enforce block size
-   if(size <= NET_MEM_POOL_BUFFER_SIZE)
+   //Loop through block classes, from the smallest to the largest
+   for(i = 0; i < NET_MEM_POOL_CLASS_COUNT; i++)
    {
-      //Loop through allocation table
-      for(i = 0; i < NET_MEM_POOL_BUFFER_COUNT; i++)
-      {
-         //Check whether the current block is free
-         if(!memPoolAllocTable[i])
-         {
-            //Mark the current entry as used
-            memPoolAllocTable[i] = TRUE;
-            //Point to the corresponding memory block
-            p = memPool[i];
+      //Point to the current class
+      poolClass = &memPoolClasses[i];
 
-            //Update statistics
-            memPoolCurrentUsage++;
-            //Maximum number of buffers that have been allocated so far
-            memPoolMaxUsage = MAX(memPoolCurrentUsage, memPoolMaxUsage);
+      //Skip the classes whose blocks are too small
+      if(size > poolClass->blockSize)
+         continue;
 
-            //Exit immediately
-            break;
-         }
+      //Any free block in the current class?
+      if(poolClass->freeList != NULL)
+      {
+         //Unlink the first free block
+         p = poolClass->freeList;
+         poolClass->freeList = *(void **) p;
+
+         //Update statistics
+         poolClass->stats.currentUsage++;
+         //Maximum number of blocks that have been allocated so far
+         poolClass->stats.maxUsage = MAX(poolClass->stats.currentUsage,
+            poolClass->stats.maxUsage);
+
+#if (MEM_TAG_SUPPORT == 1)
+         //Charge the whole block to the subsystem of the caller
+         poolClass->tags[((uint8_t *) p - poolClass->base) /
+            poolClass->blockSize] = tag;
+         vMemTagCharge(tag, poolClass->blockSize);
+#endif
+         //We are done
+         break;
       }
+
+      //The request is passed on to the next larger class
+      poolClass->stats.fallbacks++;
+   }
+
+   //Failed to allocate memory?
+   if(p == NULL)
+   {
+      //Count the failure against the largest class
+      memPoolClasses[NET_MEM_POOL_CLASS_COUNT - 1].stats.failures++;
+
+#if (MEM_TAG_SUPPORT == 1)
+      vMemTagFailure(tag);
+#endif
    }
 
    //Release exclusive access to the memory pool
    osReleaseMutex(&memPoolMutex);
+#elif (MEM_TAG_SUPPORT == 1)
+   //Allocate a memory block, charged to the caller
+   p = osAllocMemTagged(size, tag);
 #else
    //Allocate a memory block
+   (void) tag;
    p = osAllocMem(size);
 #endif
 
@@ -165,23 +358,58 @@ void *memPoolAlloc(size_t size)
 
 void memPoolFree(void *p)
 {
-//Use fixed-size blocks allocation?
-#if (NET_MEM_POOL_SUPPORT == ENABLED)
+#if (NET_MEM_POOL_SUPPORT == ENABLED || NET_MEM_RX_LOAN_SUPPORT == ENABLED || \
+   NET_MEM_TX_LOAN_SUPPORT == ENABLED)
    uint_t i;
+#endif
+#if (NET_MEM_POOL_SUPPORT == ENABLED)
+   MemPoolClass *poolClass;
+#endif
 
+//Loaned memory regions?
+#if (NET_MEM_RX_LOAN_SUPPORT == ENABLED || NET_MEM_TX_LOAN_SUPPORT == ENABLED)
+   //Loop through the loaned memory regions
+   for(i = 0; i < NET_MEM_MAX_LOAN_REGIONS; i++)
+   {
+      //Does the memory block belong to the current region?
+      if(memPoolLoanRegions[i].callback != NULL &&
+         (uint8_t *) p >= memPoolLoanRegions[i].base &&
+         (uint8_t *) p < (memPoolLoanRegions[i].base + memPoolLoanRegions[i].size))
+      {
+         //Give the memory block back to its owner
+         memPoolLoanRegions[i].callback(p);
+         //We are done
+         return;
+      }
+   }
+#endif
+
+//Use fixed-size blocks allocation?
+#if (NET_MEM_POOL_SUPPORT == ENABLED)
    //Acquire exclusive access to the memory pool
    osAcquireMutex(&memPoolMutex);
 
-   //Loop through allocation table
-   for(i = 0; i < NET_MEM_POOL_BUFFER_COUNT; i++)
+   //Loop through block classes
+   for(i = 0; i < NET_MEM_POOL_CLASS_COUNT; i++)
    {
-      if(memPool[i] == p)
+      //Point to the current class
+      poolClass = &memPoolClasses[i];
+
+      //Does the memory block belong to the current class?
+      if((uint8_t *) p >= poolClass->base && (uint8_t *) p <
+         (poolClass->base + poolClass->blockCount * poolClass->blockSize))
       {
-         //Mark the current block as free
-         memPoolAllocTable[i] = FALSE;
+         //Put the block back at the head of the free list
+         *(void **) p = poolClass->freeList;
+         poolClass->freeList = p;
 
          //Update statistics
-         memPoolCurrentUsage--;
+         poolClass->stats.currentUsage--;
+
+#if (MEM_TAG_SUPPORT == 1)
+         vMemTagCredit(poolClass->tags[((uint8_t *) p - poolClass->base) /
+            poolClass->blockSize], poolClass->blockSize);
+#endif
 
          //Exit immediately
          break;
@@ -197,6 +425,78 @@ void memPoolFree(void *p)
 }
 
 
+/**
+ * @brief Get the usable size of a memory block
+ * @param[in] p Memory block returned by memPoolAlloc
+ * @return Size of the block, in bytes
+ **/
+
+size_t memPoolGetBlockSize(const void *p)
+{
+//Use fixed-size blocks allocation?
+#if (NET_MEM_POOL_SUPPORT == ENABLED)
+   uint_t i;
+   const MemPoolClass *poolClass;
+
+   //Loop through block classes
+   for(i = 0; i < NET_MEM_POOL_CLASS_COUNT; i++)
+   {
+      //Point to the current class
+      poolClass = &memPoolClasses[i];
+
+      //Does the memory block belong to the current class?
+      if((const uint8_t *) p >= poolClass->base && (const uint8_t *) p <
+         (poolClass->base + poolClass->blockCount * poolClass->blockSize))
+      {
+         return poolClass->blockSize;
+      }
+   }
+#endif
+
+   //Blocks allocated from the heap are requested with the default size
+   return NET_MEM_POOL_BUFFER_SIZE;
+}
+
+
+/**
+ * @brief Get the subsystem a memory block is charged to
+ * @param[in] p Memory block returned by memPoolAlloc
+ * @return Tag of the block (MemTag.h)
+ **/
+
+static uint8_t memPoolGetTag(const void *p)
+{
+#if (MEM_TAG_SUPPORT == 1 && NET_MEM_POOL_SUPPORT == ENABLED)
+   uint_t i;
+   const MemPoolClass *poolClass;
+
+   //Loop through block classes
+   for(i = 0; i < NET_MEM_POOL_CLASS_COUNT; i++)
+   {
+      //Point to the current class
+      poolClass = &memPoolClasses[i];
+
+      //Does the memory block belong to the current class?
+      if((const uint8_t *) p >= poolClass->base && (const uint8_t *) p <
+         (poolClass->base + poolClass->blockCount * poolClass->blockSize))
+      {
+         return poolClass->tags[((const uint8_t *) p - poolClass->base) /
+            poolClass->blockSize];
+      }
+   }
+
+   //Loaned memory
+   return eMemTagNet;
+#elif (MEM_TAG_SUPPORT == 1)
+   //Blocks allocated from the heap carry their tag
+   return ucMemTagOfBlock(p);
+#else
+   (void) p;
+   return 0;
+#endif
+}
+
+
 /**
  * @brief Get memory pool usage
  * @param[out] currentUsage Number of buffers currently allocated
@@ -208,17 +508,31 @@ void memPoolGetStats(uint_t *currentUsage, uint_t *maxUsage, uint_t *size)
 {
 //Use fixed-size blocks allocation?
 #if (NET_MEM_POOL_SUPPORT == ENABLED)
+   uint_t i;
+   uint_t n;
+   uint_t m;
+   uint_t total;
+
+   //Sum the statistics of all block classes
+   for(n = 0, m = 0, total = 0, i = 0; i < NET_MEM_POOL_CLASS_COUNT; i++)
+   {
+      n += memPoolClasses[i].stats.currentUsage;
+      m += memPoolClasses[i].stats.maxUsage;
+      total += memPoolClasses[i].stats.blockCount;
+   }
+
    //Number of buffers currently allocated
    if(currentUsage != NULL)
-      *currentUsage = memPoolCurrentUsage;
+      *currentUsage = n;
 
-   //Maximum number of buffers that have been allocated so far
+   //Maximum number of buffers that have been allocated so far (sum of the
+   //per-class peaks)
    if(maxUsage != NULL)
-      *maxUsage = memPoolMaxUsage;
+      *maxUsage = m;
 
    //Total number of buffers in the memory pool
    if(size != NULL)
-      *size = NET_MEM_POOL_BUFFER_COUNT;
+      *size = total;
 #else
    //Memory pool is not used...
    if(currentUsage != NULL)
@@ -233,20 +547,732 @@ void memPoolGetStats(uint_t *currentUsage, uint_t *maxUsage, uint_t *size)
 }
 
 
+/**
+ * @brief Get the statistics of a block class
+ * @param[in] index Index of the class (0 for the smallest blocks)
+ * @param[out] stats Snapshot of the class statistics
+ * @return Error code
+ **/
+
+error_t memPoolGetClassStats(uint_t index, MemPoolClassStats *stats)
+{
+//Use fixed-size blocks allocation?
+#if (NET_MEM_POOL_SUPPORT == ENABLED)
+   //Check parameters
+   if(index >= NET_MEM_POOL_CLASS_COUNT || stats == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Acquire exclusive access to the memory pool
+   osAcquireMutex(&memPoolMutex);
+   //Copy statistics
+   *stats = memPoolClasses[index].stats;
+   //Release exclusive access to the memory pool
+   osReleaseMutex(&memPoolMutex);
+
+   //Successful processing
+   return NO_ERROR;
+#else
+   //Memory pool is not used...
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Register a memory region whose blocks can be loaned to the stack
+ *
+ * Blocks belonging to a registered region are never returned to the heap.
+ * Instead, the callback function is invoked as soon as the last reference
+ * to the block is released
+ *
+ * @param[in] base Start address of the memory region
+ * @param[in] size Size of the memory region, in bytes
+ * @param[in] callback Function to invoke when a loaned block is released
+ * @return Error code
+ **/
+
+error_t memPoolRegisterLoanRegion(const void *base, size_t size,
+   NetMemLoanReleaseCallback callback)
+{
+//Loaned memory regions?
+#if (NET_MEM_RX_LOAN_SUPPORT == ENABLED || NET_MEM_TX_LOAN_SUPPORT == ENABLED)
+   uint_t i;
+
+   //Check parameters
+   if(base == NULL || size == 0 || callback == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Loop through the loaned memory regions
+   for(i = 0; i < NET_MEM_MAX_LOAN_REGIONS; i++)
+   {
+      //The region may already be registered (interface re-initialization)
+      if(memPoolLoanRegions[i].base == base)
+         break;
+   }
+
+   //Region not found?
+   if(i >= NET_MEM_MAX_LOAN_REGIONS)
+   {
+      //Loop through the loaned memory regions
+      for(i = 0; i < NET_MEM_MAX_LOAN_REGIONS; i++)
+      {
+         //Free entry?
+         if(memPoolLoanRegions[i].callback == NULL)
+            break;
+      }
+   }
+
+   //The table runs out of space?
+   if(i >= NET_MEM_MAX_LOAN_REGIONS)
+      return ERROR_OUT_OF_RESOURCES;
+
+   //Save region parameters
+   memPoolLoanRegions[i].base = base;
+   memPoolLoanRegions[i].size = size;
+   memPoolLoanRegions[i].callback = callback;
+
+   //Successful processing
+   return NO_ERROR;
+#else
+   //Loaned memory regions are not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Offer the frame being processed for loan to the upper layers
+ *
+ * This function is called by the NIC driver before passing a received frame
+ * to the stack. The frame must reside in a registered loan region
+ *
+ * @param[in] data Pointer to the received frame
+ * @param[in] length Length of the frame, in bytes
+ **/
+
+void netBufferOfferLoan(const void *data, size_t length)
+{
+//Zero-copy reception?
+#if (NET_MEM_RX_LOAN_SUPPORT == ENABLED)
+   //Save the location of the frame
+   netBufferLoanData = (const uint8_t *) data;
+   netBufferLoanLength = length;
+   //The frame has not been accepted yet
+   netBufferLoanAccepted = FALSE;
+#endif
+}
+
+
+/**
+ * @brief Withdraw the offer made for the frame being processed
+ * @return TRUE if the frame has been taken over by the upper layers, in which
+ *   case the driver must not reuse the underlying buffer
+ **/
+
+bool_t netBufferWithdrawLoan(void)
+{
+//Zero-copy reception?
+#if (NET_MEM_RX_LOAN_SUPPORT == ENABLED)
+   bool_t accepted;
+
+   //Check whether the frame has been taken over
+   accepted = netBufferLoanAccepted;
+
+   //The offer is no longer valid
+   netBufferLoanData = NULL;
+   netBufferLoanLength = 0;
+   netBufferLoanAccepted = FALSE;
+
+   //Return TRUE if the buffer is now owned by the stack
+   return accepted;
+#else
+   //Zero-copy reception is not implemented
+   return FALSE;
+#endif
+}
+
+
+/**
+ * @brief Append a segment of the loaned frame to a multi-part buffer
+ *
+ * On success, the destination buffer takes ownership of the underlying
+ * driver buffer, which is given back to the driver when the chunk is freed.
+ * The caller should fall back to copying the data if an error is returned
+ *
+ * @param[out] dest Pointer to a multi-part buffer
+ * @param[in] data Pointer to the data segment (must reside in the loaned frame)
+ * @param[in] length Length of the data segment
+ * @return Error code
+ **/
+
+error_t netBufferAcceptLoan(NetBuffer *dest, const void *data, size_t length)
+{
+//Zero-copy reception?
+#if (NET_MEM_RX_LOAN_SUPPORT == ENABLED)
+   uint_t i;
+   const uint8_t *p;
+
+   //Point to the data segment
+   p = (const uint8_t *) data;
+
+   //Any frame currently offered for loan?
+   if(netBufferLoanData == NULL || netBufferLoanAccepted)
+      return ERROR_NOT_FOUND;
+
+   //The data segment must lie within the loaned frame
+   if(p == NULL || p < netBufferLoanData ||
+      (p + length) > (netBufferLoanData + netBufferLoanLength))
+   {
+      return ERROR_NOT_FOUND;
+   }
+
+   //Make sure there is enough space to add an extra chunk
+   if(dest->chunkCount >= dest->maxChunkCount)
+      return ERROR_FAILURE;
+
+   //Position to the end of the buffer
+   i = dest->chunkCount;
+
+   //A non-zero size tells netBufferSetLength that the chunk must be freed
+   dest->chunk[i].address = (void *) p;
+   dest->chunk[i].length = (uint16_t) length;
+   dest->chunk[i].size = (uint16_t) MAX(length, 1);
+
+   //Increment the number of chunks
+   dest->chunkCount++;
+
+   //The driver must re-arm its descriptor with a fresh buffer
+   netBufferLoanAccepted = TRUE;
+
+   //Successful processing
+   return NO_ERROR;
+#else
+   //Zero-copy reception is not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Append a memory block loaned by the application to a multi-part buffer
+ *
+ * The data is referenced rather than copied. It must lie within a region
+ * registered with memPoolRegisterLoanRegion(), whose callback is invoked
+ * once the chunk is freed. Until then, the application must not modify or
+ * reuse the block
+ *
+ * @param[out] dest Pointer to a multi-part buffer
+ * @param[in] data Pointer to the data to append
+ * @param[in] length Number of bytes to append
+ * @return Error code
+ **/
+
+error_t netBufferAppendLoan(NetBuffer *dest, const void *data, size_t length)
+{
+//Zero-copy transmission of loaned payloads?
+#if (NET_MEM_TX_LOAN_SUPPORT == ENABLED)
+   uint_t i;
+   const uint8_t *p;
+
+   //Point to the data to append
+   p = (const uint8_t *) data;
+
+   //Check parameters
+   if(p == NULL || length > UINT16_MAX)
+      return ERROR_INVALID_PARAMETER;
+
+   //Loop through the loaned memory regions
+   for(i = 0; i < NET_MEM_MAX_LOAN_REGIONS; i++)
+   {
+      //Does the data lie within the current region?
+      if(memPoolLoanRegions[i].callback != NULL &&
+         p >= memPoolLoanRegions[i].base &&
+         (p + length) <= (memPoolLoanRegions[i].base + memPoolLoanRegions[i].size))
+      {
+         break;
+      }
+   }
+
+   //Only a registered region can be given back to its owner
+   if(i >= NET_MEM_MAX_LOAN_REGIONS)
+      return ERROR_INVALID_ADDRESS;
+
+   //Make sure there is enough space to add an extra chunk
+   if(dest->chunkCount >= dest->maxChunkCount)
+      return ERROR_FAILURE;
+
+   //Position to the end of the buffer
+   i = dest->chunkCount;
+
+   //A non-zero size tells netBufferSetLength that the chunk must be freed
+   dest->chunk[i].address = (void *) p;
+   dest->chunk[i].length = (uint16_t) length;
+   dest->chunk[i].size = (uint16_t) MAX(length, 1);
+
+   //Increment the number of chunks
+   dest->chunkCount++;
+
+   //Successful processing
+   return NO_ERROR;
+#else
+   //Zero-copy transmission of loaned payloads is not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Prevent a buffer from being freed while the DMA is reading it
+ *
+ * This function is called by NIC drivers that transmit the chunks of a
+ * buffer directly. A subsequent call to netBufferFree is deferred until the
+ * driver invokes netBufferRelease. The hold table is protected by the
+ * netMutex, like every other access to the stack's buffers
+ *
+ * @param[in] buffer Pointer to the multi-part buffer
+ * @return Error code
+ **/
+
+error_t netBufferHold(const NetBuffer *buffer)
+{
+//Zero-copy transmission?
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+   uint_t i;
+
+   //Loop through the hold table
+   for(i = 0; i < NET_MEM_MAX_TX_HOLDS; i++)
+   {
+      //Free entry?
+      if(netBufferHoldTable[i].buffer == NULL)
+      {
+         //Reference the buffer
+         netBufferHoldTable[i].buffer = buffer;
+         netBufferHoldTable[i].freePending = FALSE;
+
+         //Update the number of held buffers
+         netBufferHoldCount++;
+
+         //Successful processing
+         return NO_ERROR;
+      }
+   }
+
+   //The hold table runs out of space
+   return ERROR_OUT_OF_RESOURCES;
+#else
+   //Zero-copy transmission is not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Release a buffer previously held by a NIC driver
+ *
+ * The buffer is freed if netBufferFree was called while it was held
+ *
+ * @param[in] buffer Pointer to the multi-part buffer
+ **/
+
+void netBufferRelease(const NetBuffer *buffer)
+{
+//Zero-copy transmission?
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+   uint_t i;
+   bool_t freePending;
+
+   //Loop through the hold table
+   for(i = 0; i < NET_MEM_MAX_TX_HOLDS; i++)
+   {
+      //Matching entry?
+      if(netBufferHoldTable[i].buffer == buffer)
+      {
+         //Check whether the owner has already disposed of the buffer
+         freePending = netBufferHoldTable[i].freePending;
+
+         //Release the entry
+         netBufferHoldTable[i].buffer = NULL;
+         netBufferHoldTable[i].freePending = FALSE;
+
+         //Update the number of held buffers
+         netBufferHoldCount--;
+
+         //Deferred release?
+         if(freePending)
+         {
+            netBufferFree((NetBuffer *) buffer);
+         }
+
+         //We are done
+         break;
+      }
+   }
+#endif
+}
+
+
+//Zero-copy transmission?
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+
+/**
+ * @brief Check whether a buffer references the memory of a chunk
+ * @param[in] buffer Pointer to the multi-part buffer
+ * @param[in] chunk Chunk descriptor
+ * @return TRUE if one of the chunks of the buffer overlaps the chunk
+ **/
+
+static bool_t netBufferReferencesChunk(const NetBuffer *buffer,
+   const ChunkDesc *chunk)
+{
+   uint_t i;
+   const uint8_t *p;
+   const uint8_t *start;
+   const uint8_t *end;
+
+   //Memory spanned by the chunk
+   start = (const uint8_t *) chunk->address;
+   end = start + MAX(chunk->size, chunk->length);
+
+   //Loop through the chunks of the buffer
+   for(i = 0; i < buffer->chunkCount; i++)
+   {
+      //Point to the data of the current chunk
+      p = (const uint8_t *) buffer->chunk[i].address;
+
+      //Overlapping memory?
+      if(p < end && (p + buffer->chunk[i].length) > start)
+         return TRUE;
+   }
+
+   //The buffer does not reference the chunk
+   return FALSE;
+}
+
+#endif
+
+
+/**
+ * @brief Check whether the DMA may still read the data of a buffer
+ *
+ * Returns TRUE when a buffer held by a NIC driver references one of the
+ * chunks of the specified buffer, which must then be neither modified nor
+ * freed. This happens when a buffer is sent by reference, like the payload
+ * of a TCP segment taken from the send buffer of its socket
+ *
+ * @param[in] buffer Pointer to the multi-part buffer
+ * @return TRUE if the data is referenced by a held buffer, else FALSE
+ **/
+
+bool_t netBufferIsHeld(const NetBuffer *buffer)
+{
+//Zero-copy transmission?
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+   uint_t i;
+   uint_t j;
+
+   //Any buffer currently held by a NIC driver?
+   if(netBufferHoldCount > 0)
+   {
+      //Loop through the hold table
+      for(i = 0; i < NET_MEM_MAX_TX_HOLDS; i++)
+      {
+         //Valid entry?
+         if(netBufferHoldTable[i].buffer != NULL)
+         {
+            //Loop through the chunks of the buffer
+            for(j = 0; j < buffer->chunkCount; j++)
+            {
+               //Does the held buffer reference the current chunk?
+               if(netBufferReferencesChunk(netBufferHoldTable[i].buffer,
+                  &buffer->chunk[j]))
+               {
+                  return TRUE;
+               }
+            }
+         }
+      }
+   }
+#endif
+
+   //The data is not referenced by the DMA
+   return FALSE;
+}
+
+
+/**
+ * @brief Release the chunks of a buffer, sparing those read by the DMA
+ *
+ * A chunk still referenced by a buffer held by a NIC driver is handed over
+ * to a new buffer, shared by all such held buffers, so that it is freed
+ * along with the last of them. The other chunks are freed right away
+ *
+ * @param[in] buffer Pointer to the multi-part buffer
+ **/
+
+void netBufferReleaseChunks(NetBuffer *buffer)
+{
+//Zero-copy transmission and shared buffers?
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED && NET_MEM_SHARED_BUFFER_SUPPORT == ENABLED)
+   uint_t i;
+   uint_t j;
+   uint_t k;
+   bool_t referenced;
+   ChunkDesc *chunk;
+   NetBuffer *orphan;
+
+   //Any buffer currently held by a NIC driver?
+   if(netBufferHoldCount > 0)
+   {
+      //Loop through data chunks
+      for(i = 0; i < buffer->chunkCount; i++)
+      {
+         //Point to the chunk descriptor
+         chunk = &buffer->chunk[i];
+
+         //Only the memory owned by the buffer is released
+         if(chunk->size == 0)
+            continue;
+
+         //Search the hold table for a buffer referencing the chunk
+         for(j = 0; j < NET_MEM_MAX_TX_HOLDS; j++)
+         {
+            if(netBufferHoldTable[j].buffer != NULL &&
+               netBufferReferencesChunk(netBufferHoldTable[j].buffer, chunk))
+            {
+               break;
+            }
+         }
+
+         //The chunk can be freed right away?
+         if(j >= NET_MEM_MAX_TX_HOLDS)
+            continue;
+
+         //Allocate a buffer that takes over the chunk
+         orphan = netBufferAlloc(0);
+         //Failed to allocate memory?
+         if(orphan == NULL)
+            break;
+
+         //Move the chunk
+         orphan->chunk[0] = *chunk;
+         orphan->chunkCount = 1;
+         chunk->size = 0;
+
+         //No reference recorded so far
+         referenced = FALSE;
+
+         //Each held buffer referencing the chunk keeps it alive
+         for(; j < NET_MEM_MAX_TX_HOLDS; j++)
+         {
+            //Matching entry?
+            if(netBufferHoldTable[j].buffer != NULL &&
+               netBufferReferencesChunk(netBufferHoldTable[j].buffer,
+               orphan->chunk))
+            {
+               //Loop through the reference table
+               for(k = 0; k < NET_MEM_MAX_SHARED_REFS; k++)
+               {
+                  //Free entry?
+                  if(netBufferShareTable[k].holder == NULL)
+                     break;
+               }
+
+               //The table runs out of space? The remaining held buffers are
+               //not tracked
+               if(k >= NET_MEM_MAX_SHARED_REFS)
+                  break;
+
+               //Record the reference
+               netBufferShareTable[k].holder = netBufferHoldTable[j].buffer;
+               netBufferShareTable[k].shared = orphan;
+
+               //Update the number of references
+               netBufferShareCount++;
+               referenced = TRUE;
+            }
+         }
+
+         //The chunk is released at once if no reference could be recorded
+         if(!referenced)
+         {
+            netBufferFree(orphan);
+         }
+      }
+   }
+#endif
+
+   //Release the remaining chunks
+   netBufferSetLength(buffer, 0);
+}
+
+
+/**
+ * @brief Reference the data of a shared buffer from another buffer
+ *
+ * The chunks of the shared buffer covering the data segment are appended to
+ * the destination buffer without being copied. The shared buffer is freed
+ * along with the last buffer referencing it, hence the caller must free it
+ * only if no reference could be created. References are protected by the
+ * netMutex, like every other access to the stack's buffers
+ *
+ * @param[out] dest Pointer to the multi-part buffer that references the data
+ * @param[in] shared Pointer to the multi-part buffer holding the data
+ * @param[in] offset Offset to the data segment within the shared buffer
+ * @param[in] length Length of the data segment
+ * @return Error code
+ **/
+
+error_t netBufferShare(NetBuffer *dest, NetBuffer *shared, size_t offset,
+   size_t length)
+{
+//Shared buffers?
+#if (NET_MEM_SHARED_BUFFER_SUPPORT == ENABLED)
+   uint_t i;
+   uint_t j;
+   uint_t k;
+   size_t n;
+
+   //Loop through the reference table
+   for(k = 0; k < NET_MEM_MAX_SHARED_REFS; k++)
+   {
+      //Free entry?
+      if(netBufferShareTable[k].holder == NULL)
+         break;
+   }
+
+   //The table runs out of space?
+   if(k >= NET_MEM_MAX_SHARED_REFS)
+      return ERROR_OUT_OF_RESOURCES;
+
+   //Skip the beginning of the shared buffer
+   for(i = 0; i < shared->chunkCount && offset >= shared->chunk[i].length; i++)
+   {
+      offset -= shared->chunk[i].length;
+   }
+
+   //Position to the end of the destination buffer
+   j = dest->chunkCount;
+
+   //Reference the chunks covering the data segment
+   while(i < shared->chunkCount && length > 0)
+   {
+      //Make sure there is enough space to add an extra chunk
+      if(j >= dest->maxChunkCount)
+         return ERROR_FAILURE;
+
+      //Number of bytes to reference in the current chunk
+      n = MIN(length, shared->chunk[i].length - offset);
+
+      //A zero size tells netBufferSetLength that the chunk is not owned
+      dest->chunk[j].address = (uint8_t *) shared->chunk[i].address + offset;
+      dest->chunk[j].length = (uint16_t) n;
+      dest->chunk[j].size = 0;
+
+      //Next chunk
+      length -= n;
+      offset = 0;
+      i++;
+      j++;
+   }
+
+   //The data segment exceeds the shared buffer?
+   if(length > 0)
+      return ERROR_INVALID_LENGTH;
+
+   //Commit the new chunks
+   dest->chunkCount = j;
+
+   //Record the reference
+   netBufferShareTable[k].holder = dest;
+   netBufferShareTable[k].shared = shared;
+
+   //Update the number of references
+   netBufferShareCount++;
+
+   //Successful processing
+   return NO_ERROR;
+#else
+   //Shared buffers are not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+//Shared buffers?
+#if (NET_MEM_SHARED_BUFFER_SUPPORT == ENABLED)
+
+/**
+ * @brief Drop the references held by a buffer that is being freed
+ * @param[in] buffer Pointer to the multi-part buffer
+ **/
+
+static void netBufferDropShares(const NetBuffer *buffer)
+{
+   uint_t i;
+   uint_t j;
+   NetBuffer *shared;
+
+   //Loop through the reference table
+   for(i = 0; i < NET_MEM_MAX_SHARED_REFS; i++)
+   {
+      //Reference held by the buffer?
+      if(netBufferShareTable[i].holder == buffer)
+      {
+         //Point to the shared buffer
+         shared = netBufferShareTable[i].shared;
+
+         //Release the entry
+         netBufferShareTable[i].holder = NULL;
+         netBufferShareTable[i].shared = NULL;
+
+         //Update the number of references
+         netBufferShareCount--;
+
+         //Look for another reference to the same buffer
+         for(j = 0; j < NET_MEM_MAX_SHARED_REFS; j++)
+         {
+            if(netBufferShareTable[j].shared == shared)
+               break;
+         }
+
+         //Last reference dropped?
+         if(j >= NET_MEM_MAX_SHARED_REFS)
+         {
+            netBufferFree(shared);
+         }
+      }
+   }
+}
+
+#endif
+
+
 /**
  * @brief Allocate a multi-part buffer
+ *
+ * netBufferAlloc() expands to this function with the tag of the caller. The
+ * chunks added as the buffer grows are charged to the same tag
+ *
  * @param[in] length Desired length
+ * @param[in] tag Subsystem the buffer is charged to (MemTag.h)
  * @return Pointer to the allocated buffer or NULL if there is
  *   insufficient memory available
  **/
 
-NetBuffer *netBufferAlloc(size_t length)
+NetBuffer *netBufferAllocTagged(size_t length, uint8_t tag)
 {
    error_t error;
    NetBuffer *buffer;
 
+#if (NET_MEM_POOL_SUPPORT == ENABLED)
+   //Use the smallest block that can hold the requested length
+   buffer = memPoolAllocTagged(MIN(CHUNKED_BUFFER_HEADER_SIZE + length,
+      NET_MEM_POOL_BUFFER_SIZE), tag);
+#else
    //Allocate memory to hold the multi-part buffer
-   buffer = memPoolAlloc(NET_MEM_POOL_BUFFER_SIZE);
+   buffer = memPoolAllocTagged(NET_MEM_POOL_BUFFER_SIZE, tag);
+#endif
+
    //Failed to allocate memory?
    if(buffer == NULL)
       return NULL;
@@ -255,7 +1281,7 @@ NetBuffer *netBufferAlloc(size_t length)
    buffer->chunkCount = 1;
    buffer->maxChunkCount = MAX_CHUNK_COUNT;
    buffer->chunk[0].address = (uint8_t *) buffer + CHUNKED_BUFFER_HEADER_SIZE;
-   buffer->chunk[0].length = NET_MEM_POOL_BUFFER_SIZE - CHUNKED_BUFFER_HEADER_SIZE;
+   buffer->chunk[0].length = memPoolGetBlockSize(buffer) - CHUNKED_BUFFER_HEADER_SIZE;
    buffer->chunk[0].size = 0;
 
    //Adjust the length of the buffer
@@ -281,6 +1307,38 @@ NetBuffer *netBufferAlloc(size_t length)
 
 void netBufferFree(NetBuffer *buffer)
 {
+//Zero-copy transmission?
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+   //Any buffer currently held by a NIC driver?
+   if(netBufferHoldCount > 0)
+   {
+      uint_t i;
+
+      //Loop through the hold table
+      for(i = 0; i < NET_MEM_MAX_TX_HOLDS; i++)
+      {
+         //Is the buffer still referenced by the DMA?
+         if(netBufferHoldTable[i].buffer == buffer)
+         {
+            //The buffer will be released when the transmission completes
+            netBufferHoldTable[i].freePending = TRUE;
+            //We are done
+            return;
+         }
+      }
+   }
+#endif
+
+//Shared buffers?
+#if (NET_MEM_SHARED_BUFFER_SUPPORT == ENABLED)
+   //Any reference currently in use?
+   if(netBufferShareCount > 0)
+   {
+      //The shared data is freed along with its last reference
+      netBufferDropShares(buffer);
+   }
+#endif
+
    //Properly dispose data chunks
    netBufferSetLength(buffer, 0);
    //Release multi-part buffer
@@ -384,8 +1442,9 @@ error_t netBufferSetLength(NetBuffer *buffer, size_t length)
          //Point to the chunk descriptor;
          chunk = &buffer->chunk[i];
 
-         //Allocate memory to hold a new chunk
-         chunk->address = memPoolAlloc(NET_MEM_POOL_BUFFER_SIZE);
+         //Allocate memory to hold a new chunk, charged as the buffer is
+         chunk->address = memPoolAllocTagged(NET_MEM_POOL_BUFFER_SIZE,
+            memPoolGetTag(buffer));
          //Failed to allocate memory?
          if(!chunk->address)
             return ERROR_OUT_OF_MEMORY;
@@ -569,7 +1628,7 @@ error_t netBufferCopy(NetBuffer *dest, size_t destOffset,
       n = MIN(n, src->chunk[j].length - srcOffset);
 
       //Copy data
-      osMemcpy(p, q, n);
+      NET_BULK_COPY(p, q, n);
 
       destOffset += n;
       srcOffset += n;
@@ -625,6 +1684,141 @@ error_t netBufferAppend(NetBuffer *dest, const void *src, size_t length)
 }
 
 
+/**
+ * @brief Make room for a header in front of the data
+ *
+ * The headroom is the part of the buffer that precedes the offset. The
+ * header is taken from it without allocating nor moving any data, provided
+ * it is contiguous
+ *
+ * @param[in] buffer Pointer to a multi-part buffer
+ * @param[in,out] offset Offset to the first data byte, moved back to the
+ *   header on success
+ * @param[in] length Length of the header
+ * @return Pointer to the header, NULL if the headroom is too small
+ **/
+
+void *netBufferPush(NetBuffer *buffer, size_t *offset, size_t length)
+{
+   void *header;
+
+   //Not enough headroom?
+   if(*offset < length)
+      return NULL;
+
+   //The header must not span several chunks
+   header = netBufferAt(buffer, *offset - length, length);
+
+   //Successful processing?
+   if(header != NULL)
+   {
+      //The header is now the first data byte
+      *offset -= length;
+   }
+
+   //Return a pointer to the header
+   return header;
+}
+
+
+/**
+ * @brief Remove a header from the front of the data
+ * @param[in] buffer Pointer to a multi-part buffer
+ * @param[in,out] offset Offset to the header, moved past it on success
+ * @param[in] length Length of the header
+ * @return Pointer to the header, NULL if it is truncated or not contiguous
+ **/
+
+void *netBufferPull(const NetBuffer *buffer, size_t *offset, size_t length)
+{
+   void *header;
+
+   //The header must not span several chunks
+   header = netBufferAt(buffer, *offset, length);
+
+   //Successful processing?
+   if(header != NULL)
+   {
+      //Skip the header
+      *offset += length;
+   }
+
+   //Return a pointer to the header
+   return header;
+}
+
+
+/**
+ * @brief Get the room left behind the data of a multi-part buffer
+ * @param[in] buffer Pointer to a multi-part buffer
+ * @return Number of bytes that can be added to the last chunk
+ **/
+
+size_t netBufferGetTailroom(const NetBuffer *buffer)
+{
+   size_t n;
+   const ChunkDesc *chunk;
+
+   //Empty buffer?
+   if(buffer->chunkCount == 0)
+      return 0;
+
+   //Point to the last chunk
+   chunk = &buffer->chunk[buffer->chunkCount - 1];
+
+   //Check whether the chunk is part of a memory block
+   if(buffer->chunkCount == 1 && chunk->size == 0 &&
+      chunk->address == (uint8_t *) buffer + CHUNKED_BUFFER_HEADER_SIZE)
+   {
+      //The first chunk follows the header of the block
+      n = memPoolGetBlockSize(buffer) - CHUNKED_BUFFER_HEADER_SIZE;
+   }
+   else if(chunk->size == NET_MEM_POOL_BUFFER_SIZE)
+   {
+      //Additional chunks are whole blocks (loaned chunks never grow, since
+      //their size is their length)
+      n = chunk->size;
+   }
+   else
+   {
+      //The chunk references external data
+      n = chunk->length;
+   }
+
+   //Return the number of bytes available
+   return (n > chunk->length) ? n - chunk->length : 0;
+}
+
+
+/**
+ * @brief Add data behind the end of a multi-part buffer, within its tailroom
+ * @param[in] buffer Pointer to a multi-part buffer
+ * @param[in] length Number of bytes to add
+ * @return Pointer to the bytes added, NULL if the tailroom is too small
+ **/
+
+void *netBufferPut(NetBuffer *buffer, size_t length)
+{
+   uint8_t *p;
+   ChunkDesc *chunk;
+
+   //Not enough tailroom?
+   if(length > netBufferGetTailroom(buffer))
+      return NULL;
+
+   //Point to the last chunk
+   chunk = &buffer->chunk[buffer->chunkCount - 1];
+   //Point to the first byte added
+   p = (uint8_t *) chunk->address + chunk->length;
+
+   //Extend the chunk
+   chunk->length += (uint16_t) length;
+
+   //Return a pointer to the bytes added
+   return p;
+}
+
+
 /**
  * @brief Write data to a multi-part buffer
  * @param[out] dest Pointer to a multi-part buffer
@@ -657,7 +1851,7 @@ size_t netBufferWrite(NetBuffer *dest,
          n = MIN(length - totalLength, dest->chunk[i].length - destOffset);
 
          //Copy data
-         osMemcpy(p, src, n);
+         NET_BULK_COPY(p, src, n);
 
          //Advance read pointer
          src = (uint8_t *) src + n;
@@ -710,7 +1904,7 @@ size_t netBufferRead(void *dest, const NetBuffer *src,
          n = MIN(length - totalLength, src->chunk[i].length - srcOffset);
 
          //Copy data
-         osMemcpy(dest, p, n);
+         NET_BULK_COPY(dest, p, n);
 
          //Advance write pointer
          dest = (uint8_t *) dest + n;
@@ -729,3 +1923,311 @@ size_t netBufferRead(void *dest, const NetBuffer *src,
    //Return the actual number of bytes copied
    return totalLength;
 }
+
+
+/**
+ * @brief Initialize a cursor at the beginning of a multi-part buffer
+ * @param[out] cursor Cursor to initialize
+ * @param[in] buffer Multi-part buffer the cursor moves in
+ **/
+
+void netBufferInitCursor(NetBufferCursor *cursor, const NetBuffer *buffer)
+{
+   cursor->buffer = buffer;
+   cursor->index = 0;
+   cursor->base = 0;
+}
+
+
+/**
+ * @brief Locate a byte in a multi-part buffer from the position of a cursor
+ *
+ * The cursor moves backward or forward from the chunk it was left on, so
+ * that accesses in sequence take a constant time whatever the number of
+ * chunks. It stays on the last chunk when the offset is past the end
+ *
+ * @param[in,out] cursor Position in the multi-part buffer
+ * @param[in] offset Offset from the beginning of the buffer
+ * @param[out] length Number of contiguous bytes from that byte to the end
+ *   of its chunk (optional parameter)
+ * @return Pointer to the byte, NULL if the offset is past the end of the data
+ **/
+
+__net_fast_func void *netBufferCursorSeek(NetBufferCursor *cursor,
+   size_t offset, size_t *length)
+{
+   const NetBuffer *buffer;
+   const ChunkDesc *chunk;
+
+   //Point to the multi-part buffer
+   buffer = cursor->buffer;
+
+   //The buffer may have been trimmed since the last access, and a circular
+   //buffer wraps around to its first chunk
+   if(cursor->index >= buffer->chunkCount ||
+      (offset < buffer->chunk[0].length && offset < cursor->base))
+   {
+      cursor->index = 0;
+      cursor->base = 0;
+   }
+
+   //Move backward to the chunk holding the byte
+   while(offset < cursor->base && cursor->index > 0)
+   {
+      cursor->index--;
+      cursor->base -= buffer->chunk[cursor->index].length;
+   }
+
+   //Move forward to the chunk holding the byte
+   while(cursor->index < buffer->chunkCount)
+   {
+      //Point to the current chunk
+      chunk = &buffer->chunk[cursor->index];
+
+      //Does the byte reside in the current chunk?
+      if((offset - cursor->base) < chunk->length)
+      {
+         //Number of contiguous bytes available
+         if(length != NULL)
+         {
+            *length = chunk->length - (offset - cursor->base);
+         }
+
+         //Return a pointer to the byte
+         return (uint8_t *) chunk->address + (offset - cursor->base);
+      }
+
+      //The end of the buffer has been reached?
+      if((cursor->index + 1) >= buffer->chunkCount)
+         break;
+
+      //Jump to the next chunk
+      cursor->base += chunk->length;
+      cursor->index++;
+   }
+
+   //The offset is past the end of the data
+   return NULL;
+}
+
+
+/**
+ * @brief Returns a pointer to a data segment, from the position of a cursor
+ * @param[in,out] cursor Position in the multi-part buffer
+ * @param[in] offset Offset from the beginning of the buffer
+ * @param[in] length Length of the data segment
+ * @return Pointer the data segment (NULL if it spans several chunks)
+ **/
+
+void *netBufferCursorAt(NetBufferCursor *cursor, size_t offset,
+   size_t length)
+{
+   void *data;
+   size_t n;
+
+   //Locate the first byte of the data segment
+   data = netBufferCursorSeek(cursor, offset, &n);
+
+   //Check whether the whole data segment fits the chunk
+   if(data != NULL && length > n)
+   {
+      data = NULL;
+   }
+
+   //Return a pointer to the data segment
+   return data;
+}
+
+
+/**
+ * @brief Concatenate two multi-part buffers, from the position of a cursor
+ * @param[out] dest Pointer to the destination buffer
+ * @param[in,out] src Position in the source buffer
+ * @param[in] srcOffset Read offset
+ * @param[in] length Number of bytes to read from the source buffer
+ * @return Error code
+ **/
+
+error_t netBufferCursorConcat(NetBuffer *dest, NetBufferCursor *src,
+   size_t srcOffset, size_t length)
+{
+   uint_t i;
+   size_t n;
+   uint8_t *p;
+
+   //Invalid offset?
+   if(netBufferCursorSeek(src, srcOffset, NULL) == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Position to the end of the destination data
+   i = dest->chunkCount;
+
+   //Copy data blocks
+   while(length > 0 && i < dest->maxChunkCount)
+   {
+      //Locate the next block
+      p = netBufferCursorSeek(src, srcOffset, &n);
+      //End of the source data?
+      if(p == NULL)
+         break;
+
+      //Limit the number of bytes to copy
+      n = MIN(n, length);
+
+      //Copy current block
+      dest->chunk[i].address = p;
+      dest->chunk[i].length = (uint16_t) n;
+      dest->chunk[i].size = 0;
+
+      //Increment the number of chunks
+      dest->chunkCount++;
+      i++;
+
+      //Adjust variables
+      srcOffset += n;
+      length -= n;
+   }
+
+   //Return status code
+   return (length > 0) ? ERROR_FAILURE : NO_ERROR;
+}
+
+
+/**
+ * @brief Copy data between multi-part buffers, to the position of a cursor
+ * @param[in,out] dest Position in the destination buffer
+ * @param[in] destOffset Write offset
+ * @param[in] src Pointer to the source buffer
+ * @param[in] srcOffset Read offset
+ * @param[in] length Number of bytes to be copied
+ * @return Error code
+ **/
+
+error_t netBufferCursorCopy(NetBufferCursor *dest, size_t destOffset,
+   const NetBuffer *src, size_t srcOffset, size_t length)
+{
+   size_t m;
+   size_t n;
+   uint8_t *p;
+   uint8_t *q;
+   NetBufferCursor cursor;
+
+   //The source is read once, in sequence
+   netBufferInitCursor(&cursor, src);
+
+   //Invalid offset?
+   if(netBufferCursorSeek(dest, destOffset, NULL) == NULL ||
+      netBufferCursorSeek(&cursor, srcOffset, NULL) == NULL)
+   {
+      return ERROR_INVALID_PARAMETER;
+   }
+
+   while(length > 0)
+   {
+      //Point to the first data byte
+      p = netBufferCursorSeek(dest, destOffset, &m);
+      q = netBufferCursorSeek(&cursor, srcOffset, &n);
+
+      //End of either buffer?
+      if(p == NULL || q == NULL)
+         break;
+
+      //Compute the number of bytes to copy
+      n = MIN(n, m);
+      n = MIN(n, length);
+
+      //Copy data
+      NET_BULK_COPY(p, q, n);
+
+      destOffset += n;
+      srcOffset += n;
+      length -= n;
+   }
+
+   //Return status code
+   return (length > 0) ? ERROR_FAILURE : NO_ERROR;
+}
+
+
+/**
+ * @brief Write data to a multi-part buffer, at the position of a cursor
+ * @param[in,out] dest Position in the multi-part buffer
+ * @param[in] destOffset Offset from the beginning of the multi-part buffer
+ * @param[in] src User buffer containing the data to be written
+ * @param[in] length Number of bytes to copy
+ * @return Actual number of bytes copied
+ **/
+
+size_t netBufferCursorWrite(NetBufferCursor *dest,
+   size_t destOffset, const void *src, size_t length)
+{
+   size_t n;
+   size_t totalLength;
+   uint8_t *p;
+
+   //Total number of bytes written
+   totalLength = 0;
+
+   //Loop through data chunks
+   while(totalLength < length)
+   {
+      //Point to the first byte to be written
+      p = netBufferCursorSeek(dest, destOffset + totalLength, &n);
+      //End of the buffer?
+      if(p == NULL)
+         break;
+
+      //Compute the number of bytes to copy at a time
+      n = MIN(n, length - totalLength);
+
+      //Copy data
+      NET_BULK_COPY(p, (const uint8_t *) src + totalLength, n);
+      //Total number of bytes written
+      totalLength += n;
+   }
+
+   //Return the actual number of bytes written
+   return totalLength;
+}
+
+
+/**
+ * @brief Read data from a multi-part buffer, at the position of a cursor
+ * @param[out] dest Pointer to the buffer where to return the data
+ * @param[in,out] src Position in the multi-part buffer
+ * @param[in] srcOffset Offset from the beginning of the multi-part buffer
+ * @param[in] length Number of bytes to copy
+ * @return Actual number of bytes copied
+ **/
+
+size_t netBufferCursorRead(void *dest, NetBufferCursor *src,
+   size_t srcOffset, size_t length)
+{
+   size_t n;
+   size_t totalLength;
+   uint8_t *p;
+
+   //Total number of bytes copied
+   totalLength = 0;
+
+   //Loop through data chunks
+   while(totalLength < length)
+   {
+      //Point to the first byte to be read
+      p = netBufferCursorSeek(src, srcOffset + totalLength, &n);
+      //End of the buffer?
+      if(p == NULL)
+         break;
+
+      //Compute the number of bytes to copy at a time
+      n = MIN(n, length - totalLength);
+
+      //Copy data
+      NET_BULK_COPY((uint8_t *) dest + totalLength, p, n);
+      //Total number of bytes copied
+      totalLength += n;
+   }
+
+   //Return the actual number of bytes copied
+   return totalLength;
+}
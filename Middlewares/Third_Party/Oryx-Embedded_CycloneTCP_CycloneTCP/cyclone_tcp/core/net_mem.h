@@ -53,16 +53,136 @@
 //Size of the buffers
 #ifndef NET_MEM_POOL_BUFFER_SIZE
    #define NET_MEM_POOL_BUFFER_SIZE 1536
-#elif (NET_MEM_POOL_BUFFER_SIZE < 128)
+#elif (NET_MEM_POOL_BUFFER_SIZE < 128 || (NET_MEM_POOL_BUFFER_SIZE % 4) != 0)
    #error NET_MEM_POOL_BUFFER_SIZE parameter is not valid
 #endif
 
+//Number of small buffers available (0 to disable the class)
+#ifndef NET_MEM_POOL_SMALL_BUFFER_COUNT
+   #define NET_MEM_POOL_SMALL_BUFFER_COUNT 0
+#elif (NET_MEM_POOL_SMALL_BUFFER_COUNT < 0)
+   #error NET_MEM_POOL_SMALL_BUFFER_COUNT parameter is not valid
+#endif
+
+//Size of the small buffers
+#ifndef NET_MEM_POOL_SMALL_BUFFER_SIZE
+   #define NET_MEM_POOL_SMALL_BUFFER_SIZE 128
+#elif (NET_MEM_POOL_SMALL_BUFFER_SIZE < 16 || (NET_MEM_POOL_SMALL_BUFFER_SIZE % 4) != 0)
+   #error NET_MEM_POOL_SMALL_BUFFER_SIZE parameter is not valid
+#endif
+
+//Number of medium buffers available (0 to disable the class)
+#ifndef NET_MEM_POOL_MEDIUM_BUFFER_COUNT
+   #define NET_MEM_POOL_MEDIUM_BUFFER_COUNT 0
+#elif (NET_MEM_POOL_MEDIUM_BUFFER_COUNT < 0)
+   #error NET_MEM_POOL_MEDIUM_BUFFER_COUNT parameter is not valid
+#endif
+
+//Size of the medium buffers
+#ifndef NET_MEM_POOL_MEDIUM_BUFFER_SIZE
+   #define NET_MEM_POOL_MEDIUM_BUFFER_SIZE 512
+#elif (NET_MEM_POOL_MEDIUM_BUFFER_SIZE <= NET_MEM_POOL_SMALL_BUFFER_SIZE || \
+   NET_MEM_POOL_MEDIUM_BUFFER_SIZE >= NET_MEM_POOL_BUFFER_SIZE || \
+   (NET_MEM_POOL_MEDIUM_BUFFER_SIZE % 4) != 0)
+   #error NET_MEM_POOL_MEDIUM_BUFFER_SIZE parameter is not valid
+#endif
+
+//Number of block classes in the memory pool
+#define NET_MEM_POOL_CLASS_COUNT 3
+
+//Section where to place the memory pool (the default data section is used
+//when this parameter is not defined)
+#ifdef _DOXYGEN_
+   #define NET_MEM_POOL_SECTION ".dtcm_bss"
+#endif
+
+//Zero-copy reception using buffers loaned by the NIC driver
+#ifndef NET_MEM_RX_LOAN_SUPPORT
+   #define NET_MEM_RX_LOAN_SUPPORT DISABLED
+#elif (NET_MEM_RX_LOAN_SUPPORT != ENABLED && NET_MEM_RX_LOAN_SUPPORT != DISABLED)
+   #error NET_MEM_RX_LOAN_SUPPORT parameter is not valid
+#endif
+
+//Zero-copy transmission of payloads loaned by the application
+#ifndef NET_MEM_TX_LOAN_SUPPORT
+   #define NET_MEM_TX_LOAN_SUPPORT DISABLED
+#elif (NET_MEM_TX_LOAN_SUPPORT != ENABLED && NET_MEM_TX_LOAN_SUPPORT != DISABLED)
+   #error NET_MEM_TX_LOAN_SUPPORT parameter is not valid
+#endif
+
+//Maximum number of memory regions that can be loaned to the stack
+#ifndef NET_MEM_MAX_LOAN_REGIONS
+   #define NET_MEM_MAX_LOAN_REGIONS 1
+#elif (NET_MEM_MAX_LOAN_REGIONS < 1)
+   #error NET_MEM_MAX_LOAN_REGIONS parameter is not valid
+#endif
+
+//Zero-copy transmission using buffers held by the NIC driver
+#ifndef NET_MEM_TX_ZERO_COPY_SUPPORT
+   #define NET_MEM_TX_ZERO_COPY_SUPPORT DISABLED
+#elif (NET_MEM_TX_ZERO_COPY_SUPPORT != ENABLED && NET_MEM_TX_ZERO_COPY_SUPPORT != DISABLED)
+   #error NET_MEM_TX_ZERO_COPY_SUPPORT parameter is not valid
+#endif
+
+//Maximum number of buffers that can be held by NIC drivers
+#ifndef NET_MEM_MAX_TX_HOLDS
+   #define NET_MEM_MAX_TX_HOLDS 8
+#elif (NET_MEM_MAX_TX_HOLDS < 1)
+   #error NET_MEM_MAX_TX_HOLDS parameter is not valid
+#endif
+
+//Buffers shared by reference between several owners
+#ifndef NET_MEM_SHARED_BUFFER_SUPPORT
+   #define NET_MEM_SHARED_BUFFER_SUPPORT DISABLED
+#elif (NET_MEM_SHARED_BUFFER_SUPPORT != ENABLED && NET_MEM_SHARED_BUFFER_SUPPORT != DISABLED)
+   #error NET_MEM_SHARED_BUFFER_SUPPORT parameter is not valid
+#endif
+
+//Maximum number of references to shared buffers
+#ifndef NET_MEM_MAX_SHARED_REFS
+   #define NET_MEM_MAX_SHARED_REFS 16
+#elif (NET_MEM_MAX_SHARED_REFS < 1)
+   #error NET_MEM_MAX_SHARED_REFS parameter is not valid
+#endif
+
+//Extra headroom reserved in front of the headers of the outgoing frames, for
+//encapsulations the stack does not account for (tunnels, redundancy tags)
+#ifndef NET_MEM_HEADROOM
+   #define NET_MEM_HEADROOM 0
+#elif (NET_MEM_HEADROOM < 0)
+   #error NET_MEM_HEADROOM parameter is not valid
+#endif
+
+//Tailroom reserved behind the data of the outgoing frames, for trailers
+#ifndef NET_MEM_TAILROOM
+   #define NET_MEM_TAILROOM 0
+#elif (NET_MEM_TAILROOM < 0)
+   #error NET_MEM_TAILROOM parameter is not valid
+#endif
+
+//Copy of the bulk data moved between multi-part buffers and flat buffers
+//(socket buffers, frames handed to the driver)
+#ifndef NET_BULK_COPY
+   #define NET_BULK_COPY(dest, src, length) osMemcpy(dest, src, length)
+#endif
+
 //Size of the header part of the buffer
 #define CHUNKED_BUFFER_HEADER_SIZE (sizeof(NetBuffer) + MAX_CHUNK_COUNT * sizeof(ChunkDesc))
 
 //Helper macro for defining a buffer
 #define N(size) (((size) + NET_MEM_POOL_BUFFER_SIZE - 1) / NET_MEM_POOL_BUFFER_SIZE)
 
+//Subsystem of the caller, which allocations are charged to (MemTag.h)
+#if (MEM_TAG_SUPPORT == 1)
+   #define NET_MEM_TAG() MEM_TAG_SITE()
+#else
+   #define NET_MEM_TAG() 0
+#endif
+
+//Allocators passing the subsystem of their caller down
+#define memPoolAlloc(size) memPoolAllocTagged(size, NET_MEM_TAG())
+#define netBufferAlloc(length) netBufferAllocTagged(length, NET_MEM_TAG())
+
 //C++ guard
 #ifdef __cplusplus
 extern "C" {
@@ -101,13 +221,102 @@ typedef struct
 } NetBuffer1;
 
 
+/**
+ * @brief Position in a multi-part buffer
+ *
+ * Remembers the chunk accessed last, so that a sequence of accesses at
+ * nearby offsets does not walk the chunk list from the start every time
+ **/
+
+typedef struct
+{
+   const NetBuffer *buffer; ///<Multi-part buffer
+   uint_t index;            ///<Index of the current chunk
+   size_t base;             ///<Offset of the current chunk in the buffer
+} NetBufferCursor;
+
+
+/**
+ * @brief Statistics of a block class of the memory pool
+ **/
+
+typedef struct
+{
+   size_t blockSize;      ///<Size of the blocks, in bytes
+   uint_t blockCount;     ///<Total number of blocks in the class
+   uint_t currentUsage;   ///<Number of blocks currently allocated
+   uint_t maxUsage;       ///<Maximum number of blocks allocated so far
+   uint_t fallbacks;      ///<Requests served by a larger class
+   uint_t failures;       ///<Requests that could not be served
+} MemPoolClassStats;
+
+
+/**
+ * @brief Buffer held by a NIC driver until transmission completes
+ **/
+
+typedef struct
+{
+   const NetBuffer *buffer;
+   bool_t freePending;
+} NetBufferHold;
+
+
+/**
+ * @brief Reference from a buffer to the shared buffer holding its data
+ **/
+
+typedef struct
+{
+   const NetBuffer *holder;
+   NetBuffer *shared;
+} NetBufferShare;
+
+
+/**
+ * @brief Callback invoked when a loaned memory block is released
+ **/
+
+typedef void (*NetMemLoanReleaseCallback)(void *p);
+
+
+/**
+ * @brief Memory region owned by a driver and loaned to the stack
+ **/
+
+typedef struct
+{
+   const uint8_t *base;
+   size_t size;
+   NetMemLoanReleaseCallback callback;
+} NetMemLoanRegion;
+
+
 //Memory management functions
 error_t memPoolInit(void);
-void *memPoolAlloc(size_t size);
+void *memPoolAllocTagged(size_t size, uint8_t tag);
 void memPoolFree(void *p);
+size_t memPoolGetBlockSize(const void *p);
 void memPoolGetStats(uint_t *currentUsage, uint_t *maxUsage, uint_t *size);
+error_t memPoolGetClassStats(uint_t index, MemPoolClassStats *stats);
 
-NetBuffer *netBufferAlloc(size_t length);
+error_t memPoolRegisterLoanRegion(const void *base, size_t size,
+   NetMemLoanReleaseCallback callback);
+
+void netBufferOfferLoan(const void *data, size_t length);
+bool_t netBufferWithdrawLoan(void);
+error_t netBufferAcceptLoan(NetBuffer *dest, const void *data, size_t length);
+error_t netBufferAppendLoan(NetBuffer *dest, const void *data, size_t length);
+
+error_t netBufferHold(const NetBuffer *buffer);
+void netBufferRelease(const NetBuffer *buffer);
+bool_t netBufferIsHeld(const NetBuffer *buffer);
+void netBufferReleaseChunks(NetBuffer *buffer);
+
+error_t netBufferShare(NetBuffer *dest, NetBuffer *shared, size_t offset,
+   size_t length);
+
+NetBuffer *netBufferAllocTagged(size_t length, uint8_t tag);
 void netBufferFree(NetBuffer *buffer);
 
 size_t netBufferGetLength(const NetBuffer *buffer);
@@ -123,12 +332,38 @@ error_t netBufferCopy(NetBuffer *dest, size_t destOffset,
 
 error_t netBufferAppend(NetBuffer *dest, const void *src, size_t length);
 
+void *netBufferPush(NetBuffer *buffer, size_t *offset, size_t length);
+void *netBufferPull(const NetBuffer *buffer, size_t *offset, size_t length);
+
+size_t netBufferGetTailroom(const NetBuffer *buffer);
+void *netBufferPut(NetBuffer *buffer, size_t length);
+
 size_t netBufferWrite(NetBuffer *dest,
    size_t destOffset, const void *src, size_t length);
 
 size_t netBufferRead(void *dest, const NetBuffer *src,
    size_t srcOffset, size_t length);
 
+void netBufferInitCursor(NetBufferCursor *cursor, const NetBuffer *buffer);
+
+void *netBufferCursorSeek(NetBufferCursor *cursor, size_t offset,
+   size_t *length);
+
+void *netBufferCursorAt(NetBufferCursor *cursor, size_t offset,
+   size_t length);
+
+error_t netBufferCursorConcat(NetBuffer *dest, NetBufferCursor *src,
+   size_t srcOffset, size_t length);
+
+error_t netBufferCursorCopy(NetBufferCursor *dest, size_t destOffset,
+   const NetBuffer *src, size_t srcOffset, size_t length);
+
+size_t netBufferCursorWrite(NetBufferCursor *dest,
+   size_t destOffset, const void *src, size_t length);
+
+size_t netBufferCursorRead(void *dest, NetBufferCursor *src,
+   size_t srcOffset, size_t length);
+
 //C++ guard
 #ifdef __cplusplus
 }
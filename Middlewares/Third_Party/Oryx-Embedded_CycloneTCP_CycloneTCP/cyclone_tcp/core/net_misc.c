@@ -86,6 +86,7 @@ const NetTxAncillary NET_DEFAULT_TX_ANCILLARY =
 #if (ETH_VLAN_SUPPORT == ENABLED)
    -1,            //VLAN priority (802.1Q)
    -1,            //Drop eligible indicator
+   0,             //VLAN tag to be inserted by the NIC
 #endif
 #if (ETH_VMAN_SUPPORT == ENABLED)
    -1,            //VMAN priority (802.1ad)
@@ -99,6 +100,18 @@ const NetTxAncillary NET_DEFAULT_TX_ANCILLARY =
 #if (ETH_TIMESTAMP_SUPPORT == ENABLED)
    -1,            //Unique identifier for hardware time stamping
 #endif
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+   {0},           //PTP time at which the frame is sent
+#endif
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+   FALSE,         //The buffer is freed right after being sent
+#endif
+#if (NIC_TX_DEADLINE_SUPPORT == ENABLED)
+   0,             //Time past which the frame is dropped
+#endif
+#if (NIC_GSO_SUPPORT == ENABLED)
+   0,             //Data of the TCP segments the packet is split into
+#endif
 };
 
 //Default options passed to the stack (RX path)
@@ -111,12 +124,22 @@ const NetRxAncillary NET_DEFAULT_RX_ANCILLARY =
    {{{0}}}, //Destination MAC address
    0,       //Ethernet type field
 #endif
+#if (ETH_VLAN_SUPPORT == ENABLED)
+   0,       //VLAN tag stripped by the NIC
+#endif
 #if (ETH_PORT_TAGGING_SUPPORT == ENABLED)
    0,       //Ingress port identifier
 #endif
 #if (ETH_TIMESTAMP_SUPPORT == ENABLED)
    {0},     //Captured time stamp
 #endif
+#if (ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
+   FALSE,   //IP header checksum verified by the NIC
+   FALSE,   //TCP/UDP/ICMP checksum verified by the NIC
+#endif
+#if (NIC_RX_TIME_SUPPORT == ENABLED)
+   0,       //Time the frame was received
+#endif
 };
 
 
@@ -194,6 +217,238 @@ error_t netDetachLinkChangeCallback(NetInterface *interface,
 }
 
 
+/**
+ * @brief Register network ready callback
+ * @param[in] interface Underlying network interface
+ * @param[in] callback Callback function to be called when the network is ready
+ * @param[in] param Callback function parameter
+ * @return Error code
+ **/
+
+error_t netAttachReadyCallback(NetInterface *interface,
+   NetReadyCallback callback, void *param)
+{
+   uint_t i;
+   NetReadyCallbackEntry *entry;
+
+   //Loop through the table
+   for(i = 0; i < NET_MAX_READY_CALLBACKS; i++)
+   {
+      //Point to the current entry
+      entry = &netContext.readyCallbacks[i];
+
+      //Check whether the entry is available
+      if(entry->callback == NULL)
+      {
+         //Create a new entry
+         entry->interface = interface;
+         entry->callback = callback;
+         entry->param = param;
+
+         //Successful processing
+         return NO_ERROR;
+      }
+   }
+
+   //The table runs out of space
+   return ERROR_OUT_OF_RESOURCES;
+}
+
+
+/**
+ * @brief Unregister network ready callback
+ * @param[in] interface Underlying network interface
+ * @param[in] callback Callback function to be unregistered
+ * @param[in] param Callback function parameter
+ * @return Error code
+ **/
+
+error_t netDetachReadyCallback(NetInterface *interface,
+   NetReadyCallback callback, void *param)
+{
+   uint_t i;
+   NetReadyCallbackEntry *entry;
+
+   //Loop through the table
+   for(i = 0; i < NET_MAX_READY_CALLBACKS; i++)
+   {
+      //Point to the current entry
+      entry = &netContext.readyCallbacks[i];
+
+      //Check whether the current entry matches the specified callback function
+      if(entry->interface == interface && entry->callback == callback &&
+         entry->param == param)
+      {
+         //Unregister callback function
+         entry->interface = NULL;
+         entry->callback = NULL;
+         entry->param = NULL;
+      }
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Check whether the network has become ready
+ *
+ * The network is ready once the link is up and an address can be used as
+ * source address. The registered callbacks are notified only once per
+ * link-up
+ *
+ * @param[in] interface Underlying network interface
+ **/
+
+void netUpdateReadyState(NetInterface *interface)
+{
+   uint_t i;
+   bool_t ready;
+   NetReadyCallbackEntry *entry;
+
+   //Already reported, or link down?
+   if(interface->ready || !interface->linkState)
+      return;
+
+   //Initialize flag
+   ready = FALSE;
+
+#if (IPV4_SUPPORT == ENABLED)
+   //Loop through the list of IPv4 addresses assigned to the interface
+   for(i = 0; i < IPV4_ADDR_LIST_SIZE && !ready; i++)
+   {
+      //Tentative addresses are not usable yet
+      if(interface->ipv4Context.addrList[i].state == IPV4_ADDR_STATE_VALID)
+      {
+         ready = TRUE;
+      }
+   }
+#endif
+
+#if (IPV6_SUPPORT == ENABLED)
+   //Loop through the list of IPv6 addresses assigned to the interface
+   for(i = 0; i < IPV6_ADDR_LIST_SIZE && !ready; i++)
+   {
+      //Only a preferred global address allows off-link communication
+      if(interface->ipv6Context.addrList[i].state == IPV6_ADDR_STATE_PREFERRED &&
+         !ipv6IsLinkLocalUnicastAddr(&interface->ipv6Context.addrList[i].addr))
+      {
+         ready = TRUE;
+      }
+   }
+#endif
+
+   //No usable address yet?
+   if(!ready)
+      return;
+
+   //Save the time at which the network became ready
+   interface->ready = TRUE;
+   interface->readyTime = osGetSystemTime();
+
+   //Debug message
+   TRACE_INFO("Network is ready (%s) %" PRIu32 " ms after link-up\r\n",
+      interface->name, (uint32_t) (interface->readyTime - interface->linkUpTime));
+
+   //Loop through the network ready callback table
+   for(i = 0; i < NET_MAX_READY_CALLBACKS; i++)
+   {
+      //Point to the current entry
+      entry = &netContext.readyCallbacks[i];
+
+      //Any registered callback?
+      if(entry->callback != NULL)
+      {
+         //Check whether the network interface matches the current entry
+         if(entry->interface == NULL || entry->interface == interface)
+         {
+            //Invoke user callback function
+            entry->callback(interface, interface->linkUpTime,
+               interface->readyTime, entry->param);
+         }
+      }
+   }
+}
+
+
+#if (NET_LINK_UP_FAST_PATH_SUPPORT == ENABLED)
+
+/**
+ * @brief Start the coordinated link-up sequence
+ *
+ * Addresses that survived the link change are announced immediately, and
+ * the address configuration services are ticked at the stack tick rate for
+ * a while, so that DHCP, ARP probing and mDNS probing proceed in parallel
+ * instead of waiting for their own, slower, tick
+ *
+ * @param[in] interface Underlying network interface
+ **/
+
+void netStartLinkUpFastPath(NetInterface *interface)
+{
+#if (IPV4_SUPPORT == ENABLED && ETH_SUPPORT == ENABLED)
+   uint_t i;
+   Ipv4AddrEntry *entry;
+
+   //Loop through the list of IPv4 addresses assigned to the interface
+   for(i = 0; i < IPV4_ADDR_LIST_SIZE; i++)
+   {
+      //Point to the current entry
+      entry = &interface->ipv4Context.addrList[i];
+
+      //Manually configured addresses remain valid across link changes
+      if(entry->state == IPV4_ADDR_STATE_VALID)
+      {
+         //A gratuitous ARP updates the caches of the peers and the
+         //forwarding tables of the switches after a cable swap
+         arpSendRequest(interface, entry->addr, &MAC_BROADCAST_ADDR);
+      }
+   }
+#endif
+
+   //Enter the fast path window
+   netContext.fastPath = TRUE;
+   netContext.fastPathTime = osGetSystemTime();
+}
+
+
+/**
+ * @brief Run the address configuration services on the next tick
+ **/
+
+void netUpdateLinkUpFastPath(void)
+{
+   //Check whether a link came up recently
+   if(netContext.fastPath)
+   {
+      //The window is over?
+      if(timeCompare(osGetSystemTime(), netContext.fastPathTime +
+         NET_LINK_UP_FAST_PATH_WINDOW) >= 0)
+      {
+         netContext.fastPath = FALSE;
+      }
+      else
+      {
+#if (AUTO_IP_SUPPORT == ENABLED)
+         autoIpTickCounter = AUTO_IP_TICK_INTERVAL;
+#endif
+#if (IPV4_SUPPORT == ENABLED && DHCP_CLIENT_SUPPORT == ENABLED)
+         dhcpClientTickCounter = DHCP_CLIENT_TICK_INTERVAL;
+#endif
+#if (MDNS_RESPONDER_SUPPORT == ENABLED)
+         mdnsResponderTickCounter = MDNS_RESPONDER_TICK_INTERVAL;
+#endif
+#if (DNS_SD_RESPONDER_SUPPORT == ENABLED)
+         dnsSdResponderTickCounter = DNS_SD_RESPONDER_TICK_INTERVAL;
+#endif
+      }
+   }
+}
+
+#endif
+
+
 /**
  * @brief Process link state change event
  * @param[in] interface Underlying network interface
@@ -204,12 +459,21 @@ void netProcessLinkChange(NetInterface *interface)
    uint_t i;
    Socket *socket;
 
+   //Routes through the interface must be selected again
+   netInvalidateRoutes();
+
+   //The network is not ready until an address is usable on the new link
+   interface->ready = FALSE;
+
    //Check link state
    if(interface->linkState)
    {
       //Display link state
       TRACE_INFO("Link is up (%s)...\r\n", interface->name);
 
+      //Save the time at which the link came up
+      interface->linkUpTime = osGetSystemTime();
+
       //Display link speed
       if(interface->linkSpeed == NIC_LINK_SPEED_1GBPS)
       {
@@ -262,6 +526,14 @@ void netProcessLinkChange(NetInterface *interface)
    ipv4LinkChangeEvent(interface);
 #endif
 
+#if (NET_LINK_UP_FAST_PATH_SUPPORT == ENABLED)
+   //Coordinated link-up sequence
+   if(interface->linkState)
+   {
+      netStartLinkUpFastPath(interface);
+   }
+#endif
+
 #if (IPV6_SUPPORT == ENABLED)
    //Notify IPv6 of link state changes
    ipv6LinkChangeEvent(interface);
@@ -337,6 +609,20 @@ void netProcessLinkChange(NetInterface *interface)
 }
 
 
+/**
+ * @brief Invalidate the routes cached by the sockets
+ *
+ * This function must be called whenever the result of source address
+ * selection, default gateway selection or address resolution may change
+ **/
+
+void netInvalidateRoutes(void)
+{
+   //Cached routes older than this generation are stale
+   netContext.routeGeneration++;
+}
+
+
 /**
  * @brief Register timer callback
  * @param[in] period Timer reload value, in milliseconds
@@ -417,13 +703,40 @@ error_t netDetachTimerCallback(NetTimerCallback callback, void *param)
 void netTick(void)
 {
    uint_t i;
+   systime_t time;
+   systime_t delay;
+   systime_t timeout;
    NetTimerCallbackEntry *entry;
 
+#if defined(NET_TICK_ENTER_HOOK)
+   NET_TICK_ENTER_HOOK();
+#endif
+
+   //Get current time
+   time = osGetSystemTime();
+
+#if (NET_TICKLESS_SUPPORT == ENABLED)
+   //Time elapsed since the periodic operations last ran
+   delay = time - netContext.tickTime;
+   netContext.tickTime = time;
+#else
+   //The periodic operations run on every tick interval
+   delay = NET_TICK_INTERVAL;
+#endif
+
+   //Time until the next periodic operation is due
+   timeout = MAX_DELAY;
+
+#if (NET_LINK_UP_FAST_PATH_SUPPORT == ENABLED)
+   //Speed up address configuration after a link-up
+   netUpdateLinkUpFastPath();
+#endif
+
    //Increment tick counter
-   nicTickCounter += NET_TICK_INTERVAL;
+   nicTickCounter += delay;
 
    //Handle periodic operations such as polling the link state
-   if(nicTickCounter >= NIC_TICK_INTERVAL)
+   if(netTickDue(nicTickCounter, NIC_TICK_INTERVAL, &timeout))
    {
       //Loop through network interfaces
       for(i = 0; i < NET_INTERFACE_COUNT; i++)
@@ -439,10 +752,10 @@ void netTick(void)
 
 #if (PPP_SUPPORT == ENABLED)
    //Increment tick counter
-   pppTickCounter += NET_TICK_INTERVAL;
+   pppTickCounter += delay;
 
    //Manage PPP related timers
-   if(pppTickCounter >= PPP_TICK_INTERVAL)
+   if(netTickDue(pppTickCounter, PPP_TICK_INTERVAL, &timeout))
    {
       //Loop through network interfaces
       for(i = 0; i < NET_INTERFACE_COUNT; i++)
@@ -458,11 +771,8 @@ void netTick(void)
 #endif
 
 #if (IPV4_SUPPORT == ENABLED && ETH_SUPPORT == ENABLED)
-   //Increment tick counter
-   arpTickCounter += NET_TICK_INTERVAL;
-
-   //Manage ARP cache
-   if(arpTickCounter >= ARP_TICK_INTERVAL)
+   //Manage ARP cache, when an entry is waiting for a timeout
+   if(netTickDeadlineDue(NET_TICK_MODULE_ARP, time))
    {
       //Loop through network interfaces
       for(i = 0; i < NET_INTERFACE_COUNT; i++)
@@ -471,18 +781,13 @@ void netTick(void)
          if(netInterface[i].configured)
             arpTick(&netInterface[i]);
       }
-
-      //Reset tick counter
-      arpTickCounter = 0;
    }
 #endif
 
 #if (IPV4_SUPPORT == ENABLED && IPV4_FRAG_SUPPORT == ENABLED)
-   //Increment tick counter
-   ipv4FragTickCounter += NET_TICK_INTERVAL;
-
-   //Handle IPv4 fragment reassembly timeout
-   if(ipv4FragTickCounter >= IPV4_FRAG_TICK_INTERVAL)
+   //Handle IPv4 fragment reassembly timeout, when a datagram is being
+   //reassembled
+   if(netTickDeadlineDue(NET_TICK_MODULE_IPV4_FRAG, time))
    {
       //Loop through network interfaces
       for(i = 0; i < NET_INTERFACE_COUNT; i++)
@@ -491,19 +796,16 @@ void netTick(void)
          if(netInterface[i].configured)
             ipv4FragTick(&netInterface[i]);
       }
-
-      //Reset tick counter
-      ipv4FragTickCounter = 0;
    }
 #endif
 
 #if (IPV4_SUPPORT == ENABLED && (IGMP_HOST_SUPPORT == ENABLED || \
    IGMP_ROUTER_SUPPORT == ENABLED || IGMP_SNOOPING_SUPPORT == ENABLED))
    //Increment tick counter
-   igmpTickCounter += NET_TICK_INTERVAL;
+   igmpTickCounter += delay;
 
    //Handle IGMP related timers
-   if(igmpTickCounter >= IGMP_TICK_INTERVAL)
+   if(netTickDue(igmpTickCounter, IGMP_TICK_INTERVAL, &timeout))
    {
       //Loop through network interfaces
       for(i = 0; i < NET_INTERFACE_COUNT; i++)
@@ -520,10 +822,10 @@ void netTick(void)
 
 #if (IPV4_SUPPORT == ENABLED && AUTO_IP_SUPPORT == ENABLED)
    //Increment tick counter
-   autoIpTickCounter += NET_TICK_INTERVAL;
+   autoIpTickCounter += delay;
 
    //Handle Auto-IP related timers
-   if(autoIpTickCounter >= AUTO_IP_TICK_INTERVAL)
+   if(netTickDue(autoIpTickCounter, AUTO_IP_TICK_INTERVAL, &timeout))
    {
       //Loop through network interfaces
       for(i = 0; i < NET_INTERFACE_COUNT; i++)
@@ -538,10 +840,10 @@ void netTick(void)
 
 #if (IPV4_SUPPORT == ENABLED && DHCP_CLIENT_SUPPORT == ENABLED)
    //Increment tick counter
-   dhcpClientTickCounter += NET_TICK_INTERVAL;
+   dhcpClientTickCounter += delay;
 
    //Handle DHCP client related timers
-   if(dhcpClientTickCounter >= DHCP_CLIENT_TICK_INTERVAL)
+   if(netTickDue(dhcpClientTickCounter, DHCP_CLIENT_TICK_INTERVAL, &timeout))
    {
       //Loop through network interfaces
       for(i = 0; i < NET_INTERFACE_COUNT; i++)
@@ -556,10 +858,10 @@ void netTick(void)
 
 #if (IPV4_SUPPORT == ENABLED && DHCP_SERVER_SUPPORT == ENABLED)
    //Increment tick counter
-   dhcpServerTickCounter += NET_TICK_INTERVAL;
+   dhcpServerTickCounter += delay;
 
    //Handle DHCP server related timers
-   if(dhcpServerTickCounter >= DHCP_SERVER_TICK_INTERVAL)
+   if(netTickDue(dhcpServerTickCounter, DHCP_SERVER_TICK_INTERVAL, &timeout))
    {
       //Loop through network interfaces
       for(i = 0; i < NET_INTERFACE_COUNT; i++)
@@ -574,10 +876,10 @@ void netTick(void)
 
 #if (IPV4_SUPPORT == ENABLED && NAT_SUPPORT == ENABLED)
    //Increment tick counter
-   natTickCounter += NET_TICK_INTERVAL;
+   natTickCounter += delay;
 
    //Manage NAT related timers
-   if(natTickCounter >= NAT_TICK_INTERVAL)
+   if(netTickDue(natTickCounter, NAT_TICK_INTERVAL, &timeout))
    {
       //NAT timer handler
       natTick(netContext.natContext);
@@ -588,10 +890,10 @@ void netTick(void)
 
 #if (IPV6_SUPPORT == ENABLED && IPV6_FRAG_SUPPORT == ENABLED)
    //Increment tick counter
-   ipv6FragTickCounter += NET_TICK_INTERVAL;
+   ipv6FragTickCounter += delay;
 
    //Handle IPv6 fragment reassembly timeout
-   if(ipv6FragTickCounter >= IPV6_FRAG_TICK_INTERVAL)
+   if(netTickDue(ipv6FragTickCounter, IPV6_FRAG_TICK_INTERVAL, &timeout))
    {
       //Loop through network interfaces
       for(i = 0; i < NET_INTERFACE_COUNT; i++)
@@ -608,10 +910,10 @@ void netTick(void)
 
 #if (IPV6_SUPPORT == ENABLED && MLD_NODE_SUPPORT == ENABLED)
    //Increment tick counter
-   mldTickCounter += NET_TICK_INTERVAL;
+   mldTickCounter += delay;
 
    //Handle MLD related timers
-   if(mldTickCounter >= MLD_TICK_INTERVAL)
+   if(netTickDue(mldTickCounter, MLD_TICK_INTERVAL, &timeout))
    {
       //Loop through network interfaces
       for(i = 0; i < NET_INTERFACE_COUNT; i++)
@@ -628,10 +930,10 @@ void netTick(void)
 
 #if (IPV6_SUPPORT == ENABLED && NDP_SUPPORT == ENABLED)
    //Increment tick counter
-   ndpTickCounter += NET_TICK_INTERVAL;
+   ndpTickCounter += delay;
 
    //Handle NDP related timers
-   if(ndpTickCounter >= NDP_TICK_INTERVAL)
+   if(netTickDue(ndpTickCounter, NDP_TICK_INTERVAL, &timeout))
    {
       //Loop through network interfaces
       for(i = 0; i < NET_INTERFACE_COUNT; i++)
@@ -648,10 +950,10 @@ void netTick(void)
 
 #if (IPV6_SUPPORT == ENABLED && NDP_ROUTER_ADV_SUPPORT == ENABLED)
    //Increment tick counter
-   ndpRouterAdvTickCounter += NET_TICK_INTERVAL;
+   ndpRouterAdvTickCounter += delay;
 
    //Handle RA service related timers
-   if(ndpRouterAdvTickCounter >= NDP_ROUTER_ADV_TICK_INTERVAL)
+   if(netTickDue(ndpRouterAdvTickCounter, NDP_ROUTER_ADV_TICK_INTERVAL, &timeout))
    {
       //Loop through network interfaces
       for(i = 0; i < NET_INTERFACE_COUNT; i++)
@@ -666,10 +968,10 @@ void netTick(void)
 
 #if (IPV6_SUPPORT == ENABLED && DHCPV6_CLIENT_SUPPORT == ENABLED)
    //Increment tick counter
-   dhcpv6ClientTickCounter += NET_TICK_INTERVAL;
+   dhcpv6ClientTickCounter += delay;
 
    //Handle DHCPv6 client related timers
-   if(dhcpv6ClientTickCounter >= DHCPV6_CLIENT_TICK_INTERVAL)
+   if(netTickDue(dhcpv6ClientTickCounter, DHCPV6_CLIENT_TICK_INTERVAL, &timeout))
    {
       //Loop through network interfaces
       for(i = 0; i < NET_INTERFACE_COUNT; i++)
@@ -682,41 +984,22 @@ void netTick(void)
    }
 #endif
 
-#if (TCP_SUPPORT == ENABLED)
-   //Increment tick counter
-   tcpTickCounter += NET_TICK_INTERVAL;
-
-   //Manage TCP related timers
-   if(tcpTickCounter >= TCP_TICK_INTERVAL)
-   {
-      //TCP timer handler
-      tcpTick();
-      //Reset tick counter
-      tcpTickCounter = 0;
-   }
-#endif
-
 #if (DNS_CLIENT_SUPPORT == ENABLED || MDNS_CLIENT_SUPPORT == ENABLED || \
    NBNS_CLIENT_SUPPORT == ENABLED || LLMNR_CLIENT_SUPPORT == ENABLED)
-   //Increment tick counter
-   dnsTickCounter += NET_TICK_INTERVAL;
-
-   //Manage DNS cache
-   if(dnsTickCounter >= DNS_TICK_INTERVAL)
+   //Manage DNS cache, when it holds any entry
+   if(netTickDeadlineDue(NET_TICK_MODULE_DNS, time))
    {
       //DNS timer handler
       dnsTick();
-      //Reset tick counter
-      dnsTickCounter = 0;
    }
 #endif
 
 #if (MDNS_RESPONDER_SUPPORT == ENABLED)
    //Increment tick counter
-   mdnsResponderTickCounter += NET_TICK_INTERVAL;
+   mdnsResponderTickCounter += delay;
 
    //Manage mDNS probing and announcing
-   if(mdnsResponderTickCounter >= MDNS_RESPONDER_TICK_INTERVAL)
+   if(netTickDue(mdnsResponderTickCounter, MDNS_RESPONDER_TICK_INTERVAL, &timeout))
    {
       //Loop through network interfaces
       for(i = 0; i < NET_INTERFACE_COUNT; i++)
@@ -731,10 +1014,10 @@ void netTick(void)
 
 #if (DNS_SD_RESPONDER_SUPPORT == ENABLED)
    //Increment tick counter
-   dnsSdResponderTickCounter += NET_TICK_INTERVAL;
+   dnsSdResponderTickCounter += delay;
 
    //Manage DNS-SD probing and announcing
-   if(dnsSdResponderTickCounter >= DNS_SD_RESPONDER_TICK_INTERVAL)
+   if(netTickDue(dnsSdResponderTickCounter, DNS_SD_RESPONDER_TICK_INTERVAL, &timeout))
    {
       //Loop through network interfaces
       for(i = 0; i < NET_INTERFACE_COUNT; i++)
@@ -747,6 +1030,14 @@ void netTick(void)
    }
 #endif
 
+   //Loop through network interfaces
+   for(i = 0; i < NET_INTERFACE_COUNT; i++)
+   {
+      //Report the network ready event
+      if(netInterface[i].configured)
+         netUpdateReadyState(&netInterface[i]);
+   }
+
    //Loop through the timer callback table
    for(i = 0; i < NET_MAX_TIMER_CALLBACKS; i++)
    {
@@ -757,10 +1048,10 @@ void netTick(void)
       if(entry->callback != NULL)
       {
          //Increment timer value
-         entry->timerValue += NET_TICK_INTERVAL;
+         entry->timerValue += delay;
 
          //Timer period elapsed?
-         if(entry->timerValue >= entry->timerPeriod)
+         if(netTickDue(entry->timerValue, entry->timerPeriod, &timeout))
          {
             //Invoke user callback function
             entry->callback(entry->param);
@@ -769,6 +1060,191 @@ void netTick(void)
          }
       }
    }
+
+   //Loop through the deadlines reported by the modules
+   for(i = 0; i < NET_TICK_MODULE_COUNT; i++)
+   {
+      //Any pending work?
+      if(netContext.tickDeadlines[i].armed)
+      {
+         //Next time at which the module is due
+         if(timeCompare(netContext.tickDeadlines[i].deadline, time) > 0)
+         {
+            timeout = MIN(timeout, netContext.tickDeadlines[i].deadline - time);
+         }
+         else
+         {
+            timeout = 0;
+         }
+      }
+   }
+
+#if defined(NET_TICK_EXIT_HOOK)
+   NET_TICK_EXIT_HOOK(timeout);
+#endif
+
+#if (NET_TICKLESS_SUPPORT == ENABLED)
+   //Save the time until the next periodic operation
+   netContext.tickTimeout = timeout;
+#else
+   //Not used
+   (void) timeout;
+#endif
+}
+
+
+/**
+ * @brief Check whether a periodic operation is due
+ *
+ * In tickless mode, an operation due within NET_TICKLESS_SLACK is run
+ * along with the current one, so that operations of different periods
+ * share the same wakeups
+ *
+ * @param[in] counter Time elapsed since the operation last ran
+ * @param[in] interval Period of the operation
+ * @param[in,out] timeout Time until the next periodic operation is due
+ * @return TRUE if the operation is due, else FALSE
+ **/
+
+bool_t netTickDue(systime_t counter, systime_t interval, systime_t *timeout)
+{
+   bool_t due;
+
+#if (NET_TICKLESS_SUPPORT == ENABLED)
+   //Run the operation now if it would be due shortly
+   due = (counter + NET_TICKLESS_SLACK >= interval);
+#else
+   //Run the operation once its period has elapsed
+   due = (counter >= interval);
+#endif
+
+   //Next time at which the operation is due
+   if(due)
+   {
+      *timeout = MIN(*timeout, interval);
+
+#if (NET_CONTROL_TASK_SUPPORT == ENABLED)
+      //Let the TCP/IP task in before the operation runs
+      netTickYield();
+#endif
+   }
+   else
+   {
+      *timeout = MIN(*timeout, interval - counter);
+   }
+
+   //Return TRUE if the operation is due
+   return due;
+}
+
+
+#if (NET_CONTROL_TASK_SUPPORT == ENABLED)
+
+/**
+ * @brief Hand the TCP/IP stack over to a waiting task during a tick
+ *
+ * Called by the control task, which holds the mutex, between two modules.
+ * Releasing the mutex lets the TCP/IP task, of higher priority, take it
+ * and run at once if it was waiting
+ **/
+
+void netTickYield(void)
+{
+   //The state of the stack is consistent between two modules
+   osReleaseMutex(&netMutex);
+   osAcquireMutex(&netMutex);
+}
+
+#endif
+
+
+/**
+ * @brief Request a tick of a module
+ *
+ * A module with pending work reports when it next needs to be ticked; a
+ * module with none is not ticked at all. The deadline is only moved
+ * earlier, so several pending operations of a module share one request
+ *
+ * @param[in] module Module to be ticked
+ * @param[in] delay Time from now at which the module must be ticked
+ **/
+
+void netScheduleTick(NetTickModule module, systime_t delay)
+{
+   systime_t deadline;
+   NetTickDeadline *entry;
+
+   //Point to the deadline of the module
+   entry = &netContext.tickDeadlines[module];
+   //Time at which the module must be ticked
+   deadline = osGetSystemTime() + delay;
+
+   //Keep the earliest request
+   if(!entry->armed || timeCompare(deadline, entry->deadline) < 0)
+   {
+      entry->deadline = deadline;
+      entry->armed = TRUE;
+
+#if (NET_TICKLESS_SUPPORT == ENABLED && NET_RTOS_SUPPORT == ENABLED)
+      //Wake up the TCP/IP task if the deadline is due before its next
+      //wakeup
+      if(netTaskRunning && timeCompare(deadline, netTimestamp) < 0)
+      {
+         netTimestamp = deadline;
+#if (NET_CONTROL_TASK_SUPPORT == ENABLED)
+         osSetEvent(&netContext.controlEvent);
+#else
+         osSetEvent(&netEvent);
+#endif
+      }
+#endif
+   }
+}
+
+
+/**
+ * @brief Check whether the deadline of a module is due
+ *
+ * The deadline is consumed when due: the module reports a new one when it
+ * still has pending work
+ *
+ * @param[in] module Module to check
+ * @param[in] time Current time
+ * @return TRUE if the module must be ticked, else FALSE
+ **/
+
+bool_t netTickDeadlineDue(NetTickModule module, systime_t time)
+{
+   bool_t due;
+   NetTickDeadline *entry;
+
+   //Point to the deadline of the module
+   entry = &netContext.tickDeadlines[module];
+
+#if (NET_TICKLESS_SUPPORT == ENABLED)
+   //Tick the module now if it would be due shortly
+   time += NET_TICKLESS_SLACK;
+#endif
+
+   //Check whether the module has pending work that is due
+   if(entry->armed && timeCompare(time, entry->deadline) >= 0)
+   {
+      //Consume the deadline
+      entry->armed = FALSE;
+      due = TRUE;
+
+#if (NET_CONTROL_TASK_SUPPORT == ENABLED)
+      //Let the TCP/IP task in before the module runs
+      netTickYield();
+#endif
+   }
+   else
+   {
+      due = FALSE;
+   }
+
+   //Return TRUE if the module must be ticked
+   return due;
 }
 
 
@@ -936,6 +1412,10 @@ void netInitRand(void)
 
 uint32_t netGenerateRand(void)
 {
+#if defined(NET_RAND_SOURCE)
+   //Draw from the random number generator of the target
+   return NET_RAND_SOURCE();
+#else
    uint_t i;
    uint32_t value;
 
@@ -950,6 +1430,7 @@ uint32_t netGenerateRand(void)
 
    //Return the random value
    return value + netContext.entropy;
+#endif
 }
 
 
@@ -989,6 +1470,10 @@ uint32_t netGenerateRandRange(uint32_t min, uint32_t max)
 
 void netGenerateRandData(uint8_t *data, size_t length)
 {
+#if defined(NET_RAND_DATA_SOURCE)
+   //Draw from the random number generator of the target
+   NET_RAND_DATA_SOURCE(data, length);
+#else
    size_t i;
    size_t j;
 
@@ -1006,6 +1491,7 @@ void netGenerateRandData(uint8_t *data, size_t length)
 
       data[i] += netContext.entropy;
    }
+#endif
 }
 
 
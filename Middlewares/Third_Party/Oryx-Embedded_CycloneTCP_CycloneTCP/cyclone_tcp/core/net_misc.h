@@ -51,6 +51,15 @@ struct _NetRxAncillary;
 #define NET_RAND_STATE_SET_BIT(s, n, v) s[(n - 1) / 8] = \
    (s[(n - 1) / 8] & ~(1 << ((n - 1) % 8))) | (v) << ((n - 1) % 8)
 
+//Check whether the NIC has already verified the checksums of a packet
+#if (ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
+   #define NET_RX_IP_CHECKSUM_VALID(ancillary) ((ancillary)->ipChecksumValid)
+   #define NET_RX_PAYLOAD_CHECKSUM_VALID(ancillary) ((ancillary)->payloadChecksumValid)
+#else
+   #define NET_RX_IP_CHECKSUM_VALID(ancillary) FALSE
+   #define NET_RX_PAYLOAD_CHECKSUM_VALID(ancillary) FALSE
+#endif
+
 //C++ guard
 #ifdef __cplusplus
 extern "C" {
@@ -77,6 +86,26 @@ typedef struct
 } NetLinkChangeCallbackEntry;
 
 
+/**
+ * @brief Network ready callback
+ **/
+
+typedef void (*NetReadyCallback)(NetInterface *interface,
+   systime_t linkUpTime, systime_t readyTime, void *param);
+
+
+/**
+ * @brief Network ready callback entry
+ **/
+
+typedef struct
+{
+   NetInterface *interface;
+   NetReadyCallback callback;
+   void *param;
+} NetReadyCallbackEntry;
+
+
 /**
  * @brief Timer callback
  **/
@@ -97,6 +126,30 @@ typedef struct
 } NetTimerCallbackEntry;
 
 
+/**
+ * @brief Modules whose periodic operations run on a reported deadline
+ **/
+
+typedef enum
+{
+   NET_TICK_MODULE_ARP       = 0,
+   NET_TICK_MODULE_IPV4_FRAG = 1,
+   NET_TICK_MODULE_DNS       = 2,
+   NET_TICK_MODULE_COUNT     = 3
+} NetTickModule;
+
+
+/**
+ * @brief Next wakeup needed by a module
+ **/
+
+typedef struct
+{
+   bool_t armed;       ///<The module has pending work
+   systime_t deadline; ///<Time at which the module must be ticked
+} NetTickDeadline;
+
+
 /**
  * @brief Timestamp
  **/
@@ -129,6 +182,7 @@ struct _NetTxAncillary
 #if (ETH_VLAN_SUPPORT == ENABLED)
    int8_t vlanPcp;      ///<VLAN priority (802.1Q)
    int8_t vlanDei;      ///<Drop eligible indicator
+   uint16_t vlanTci;    ///<VLAN tag to be inserted by the NIC (0 for none)
 #endif
 #if (ETH_VMAN_SUPPORT == ENABLED)
    int8_t vmanPcp;      ///<VMAN priority (802.1ad)
@@ -142,6 +196,18 @@ struct _NetTxAncillary
 #if (ETH_TIMESTAMP_SUPPORT == ENABLED)
    int32_t timestampId; ///<Unique identifier for hardware time stamping
 #endif
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+   NetTimestamp launchTime; ///<PTP time at which the frame is sent (0 for none)
+#endif
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+   bool_t zeroCopy;     ///<The buffer is freed right after being sent
+#endif
+#if (NIC_TX_DEADLINE_SUPPORT == ENABLED)
+   systime_t deadline;  ///<Time past which the frame is dropped (0 for none)
+#endif
+#if (NIC_GSO_SUPPORT == ENABLED)
+   uint16_t gsoSize;    ///<Data of the TCP segments the packet is split into (0 for none)
+#endif
 };
 
 
@@ -158,12 +224,22 @@ struct _NetRxAncillary
    MacAddr destMacAddr;    ///<Destination MAC address
    uint16_t ethType;       ///<Ethernet type field
 #endif
+#if (ETH_VLAN_SUPPORT == ENABLED)
+   uint16_t vlanTci;       ///<VLAN tag stripped by the NIC (0 for none)
+#endif
 #if (ETH_PORT_TAGGING_SUPPORT == ENABLED)
    uint8_t port;           ///<Ingress port identifier
 #endif
 #if (ETH_TIMESTAMP_SUPPORT == ENABLED)
    NetTimestamp timestamp; ///<Captured time stamp
 #endif
+#if (ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
+   bool_t ipChecksumValid;      ///<IP header checksum verified by the NIC
+   bool_t payloadChecksumValid; ///<TCP/UDP/ICMP checksum verified by the NIC
+#endif
+#if (NIC_RX_TIME_SUPPORT == ENABLED)
+   uint64_t rxTime;        ///<Time the frame was received, in microseconds
+#endif
 };
 
 
@@ -203,12 +279,28 @@ error_t netDetachLinkChangeCallback(NetInterface *interface,
 
 void netProcessLinkChange(NetInterface *interface);
 
+error_t netAttachReadyCallback(NetInterface *interface,
+   NetReadyCallback callback, void *param);
+
+error_t netDetachReadyCallback(NetInterface *interface,
+   NetReadyCallback callback, void *param);
+
+void netUpdateReadyState(NetInterface *interface);
+
+void netStartLinkUpFastPath(NetInterface *interface);
+void netUpdateLinkUpFastPath(void);
+void netInvalidateRoutes(void);
+
 error_t netAttachTimerCallback(systime_t period, NetTimerCallback callback,
    void *param);
 
 error_t netDetachTimerCallback(NetTimerCallback callback, void *param);
 
 void netTick(void);
+bool_t netTickDue(systime_t counter, systime_t interval, systime_t *timeout);
+void netTickYield(void);
+void netScheduleTick(NetTickModule module, systime_t delay);
+bool_t netTickDeadlineDue(NetTickModule module, systime_t time);
 
 void netStartTimer(NetTimer *timer, systime_t interval);
 void netStopTimer(NetTimer *timer);
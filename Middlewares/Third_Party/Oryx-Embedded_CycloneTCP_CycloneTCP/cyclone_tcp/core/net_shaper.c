@@ -0,0 +1,377 @@
+/**
+ * @file net_shaper.c
+ * @brief Token-bucket shaping of the outgoing traffic
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * The payload sent by a socket is charged to two token buckets: the bucket
+ * of the socket and the bucket of its traffic class, selected by the DSCP
+ * class selector of the packet. A packet leaves once both buckets hold its
+ * length (or their depth, if the packet is larger). The TCP sender holds the
+ * segment back and resumes when the pace timer expires; a UDP sender waits,
+ * or has its datagram refused if it cannot wait. Retransmissions are never
+ * delayed, but are charged, so the bucket may go into debt. All the buckets
+ * are protected by netMutex
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL SOCKET_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/net_shaper.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (NET_SHAPER_SUPPORT == ENABLED)
+
+//Buckets of the traffic classes
+static NetShaperBucket netShaperClasses[NET_SHAPER_CLASS_COUNT];
+
+
+/**
+ * @brief Add the tokens earned since the last refill
+ * @param[in] bucket Token bucket
+ * @param[in] time Current time
+ **/
+
+static void netShaperRefill(NetShaperBucket *bucket, systime_t time)
+{
+   uint64_t credit;
+   systime_t elapsed;
+
+   //Unshaped bucket?
+   if(bucket->rate == 0)
+      return;
+
+   //Time elapsed since the last refill
+   elapsed = time - bucket->timestamp;
+   //Tokens earned meanwhile
+   credit = ((uint64_t) elapsed * bucket->rate) / 1000;
+
+   //Full bucket?
+   if((int64_t) bucket->tokens + (int64_t) credit >= (int64_t) bucket->burst)
+   {
+      bucket->tokens = bucket->burst;
+      bucket->timestamp = time;
+   }
+   else if(credit > 0)
+   {
+      bucket->tokens += (int32_t) credit;
+      //Only the time matching whole tokens is consumed, so that the
+      //fractions add up at low rates
+      bucket->timestamp += (systime_t) ((credit * 1000) / bucket->rate);
+   }
+   else
+   {
+      //Not a single token yet
+   }
+}
+
+
+/**
+ * @brief Time to wait before a bucket can let a packet through
+ * @param[in] bucket Token bucket
+ * @param[in] time Current time
+ * @param[in] length Length of the payload
+ * @return Delay, in milliseconds (0 if the packet can leave now)
+ **/
+
+static systime_t netShaperGetBucketDelay(NetShaperBucket *bucket,
+   systime_t time, size_t length)
+{
+   uint64_t deficit;
+
+   //Unshaped bucket?
+   if(bucket->rate == 0)
+      return 0;
+
+   //Add the tokens earned since the last call
+   netShaperRefill(bucket, time);
+
+   //A packet larger than the bucket only waits for a full bucket
+   length = MIN(length, bucket->burst);
+
+   //Enough tokens?
+   if(bucket->tokens >= (int32_t) length)
+      return 0;
+
+   //Tokens missing
+   deficit = (uint64_t) ((int64_t) length - bucket->tokens);
+
+   //Time needed to earn them, rounded up
+   return (systime_t) ((deficit * 1000 + bucket->rate - 1) / bucket->rate);
+}
+
+
+/**
+ * @brief Initialize a token bucket
+ * @param[in] bucket Token bucket
+ * @param[in] rate Sustained rate, in bytes per second (0 to disable shaping)
+ * @param[in] burst Depth of the bucket, in bytes (0 for the smallest one)
+ **/
+
+void netShaperInitBucket(NetShaperBucket *bucket, uint32_t rate,
+   uint32_t burst)
+{
+   uint32_t minBurst;
+
+   //The bucket must hold a full-sized packet and the tokens earned over the
+   //resolution of the waits
+   minBurst = (uint32_t) (((uint64_t) rate * NET_SHAPER_MIN_BURST_TIME) / 1000);
+   minBurst = MAX(minBurst, NET_SHAPER_MIN_BURST);
+
+   //Tokens are counted on 31 bits
+   burst = MAX(burst, minBurst);
+   burst = MIN(burst, (uint32_t) INT32_MAX);
+
+   //Start with a full bucket
+   bucket->rate = rate;
+   bucket->burst = burst;
+   bucket->tokens = (int32_t) burst;
+   bucket->timestamp = osGetSystemTime();
+}
+
+
+/**
+ * @brief Set the rate limit of a traffic class
+ * @param[in] classIndex DSCP class selector (0 to 7)
+ * @param[in] rate Sustained rate, in bytes per second (0 to disable shaping)
+ * @param[in] burst Depth of the bucket, in bytes (0 for the smallest one)
+ * @return Error code
+ **/
+
+error_t netShaperSetClassRate(uint_t classIndex, uint32_t rate,
+   uint32_t burst)
+{
+   //Check parameters
+   if(classIndex >= NET_SHAPER_CLASS_COUNT)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //The counters are kept across reconfigurations
+   netShaperInitBucket(&netShaperClasses[classIndex], rate, burst);
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Time to wait before a packet can be sent
+ * @param[in] socket Handle referencing the socket
+ * @param[in] tos ToS value of the packet
+ * @param[in] length Length of the payload
+ * @return Delay, in milliseconds (0 if the packet can leave now)
+ **/
+
+systime_t netShaperGetDelay(Socket *socket, uint8_t tos, size_t length)
+{
+   systime_t time;
+   systime_t delay;
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //The packet must wait for the slowest of the two buckets
+   delay = netShaperGetBucketDelay(&socket->shaper, time, length);
+   delay = MAX(delay, netShaperGetBucketDelay(
+      &netShaperClasses[NET_SHAPER_CLASS(tos)], time, length));
+
+   //Return the delay
+   return delay;
+}
+
+
+/**
+ * @brief Charge a packet to the buckets of its socket and class
+ * @param[in] socket Handle referencing the socket
+ * @param[in] tos ToS value of the packet
+ * @param[in] length Length of the payload
+ **/
+
+void netShaperConsume(Socket *socket, uint8_t tos, size_t length)
+{
+   uint_t i;
+   systime_t time;
+   NetShaperBucket *bucket;
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //Charge both buckets
+   for(i = 0; i < 2; i++)
+   {
+      //Point to the current bucket
+      bucket = (i == 0) ? &socket->shaper :
+         &netShaperClasses[NET_SHAPER_CLASS(tos)];
+
+      //Shaped bucket?
+      if(bucket->rate != 0)
+      {
+         //Bring the bucket up to date before charging it
+         netShaperRefill(bucket, time);
+
+         //The debt is bounded by the depth of the bucket
+         if((int64_t) bucket->tokens - (int64_t) length > -(int64_t) bucket->burst)
+         {
+            bucket->tokens -= (int32_t) length;
+         }
+         else
+         {
+            bucket->tokens = -(int32_t) bucket->burst;
+         }
+      }
+
+      //Update statistics
+      bucket->bytes += (uint32_t) length;
+      bucket->packets++;
+   }
+}
+
+
+/**
+ * @brief Count a packet held back by the buckets it is short of
+ * @param[in] socket Handle referencing the socket
+ * @param[in] tos ToS value of the packet
+ * @param[in] length Length of the payload
+ **/
+
+void netShaperCountDelayed(Socket *socket, uint8_t tos, size_t length)
+{
+   systime_t time;
+   NetShaperBucket *bucket;
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //Socket bucket
+   bucket = &socket->shaper;
+   if(netShaperGetBucketDelay(bucket, time, length) != 0)
+   {
+      bucket->delayed++;
+   }
+
+   //Class bucket
+   bucket = &netShaperClasses[NET_SHAPER_CLASS(tos)];
+   if(netShaperGetBucketDelay(bucket, time, length) != 0)
+   {
+      bucket->delayed++;
+   }
+}
+
+
+/**
+ * @brief Count a datagram refused by the buckets it is short of
+ * @param[in] socket Handle referencing the socket
+ * @param[in] tos ToS value of the datagram
+ * @param[in] length Length of the payload
+ **/
+
+void netShaperCountDropped(Socket *socket, uint8_t tos, size_t length)
+{
+   systime_t time;
+   NetShaperBucket *bucket;
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //Socket bucket
+   bucket = &socket->shaper;
+   if(netShaperGetBucketDelay(bucket, time, length) != 0)
+   {
+      bucket->dropped++;
+   }
+
+   //Class bucket
+   bucket = &netShaperClasses[NET_SHAPER_CLASS(tos)];
+   if(netShaperGetBucketDelay(bucket, time, length) != 0)
+   {
+      bucket->dropped++;
+   }
+}
+
+
+/**
+ * @brief Get the state and the counters of a traffic class
+ * @param[in] classIndex DSCP class selector (0 to 7)
+ * @param[out] info Copy of the bucket, refilled up to the current time
+ * @return Error code
+ **/
+
+error_t netShaperGetClassInfo(uint_t classIndex, NetShaperBucket *info)
+{
+   //Check parameters
+   if(classIndex >= NET_SHAPER_CLASS_COUNT || info == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Bring the bucket up to date
+   netShaperRefill(&netShaperClasses[classIndex], osGetSystemTime());
+   //Copy the bucket
+   *info = netShaperClasses[classIndex];
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Get the state and the counters of the bucket of a socket
+ * @param[in] socket Handle referencing the socket
+ * @param[out] info Copy of the bucket, refilled up to the current time
+ * @return Error code
+ **/
+
+error_t netShaperGetSocketInfo(Socket *socket, NetShaperBucket *info)
+{
+   //Check parameters
+   if(socket == NULL || info == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Bring the bucket up to date
+   netShaperRefill(&socket->shaper, osGetSystemTime());
+   //Copy the bucket
+   *info = socket->shaper;
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+#endif
@@ -0,0 +1,114 @@
+/**
+ * @file net_shaper.h
+ * @brief Token-bucket shaping of the outgoing traffic
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+#ifndef _NET_SHAPER_H
+#define _NET_SHAPER_H
+
+//Dependencies
+#include "net_config.h"
+#include "os_port.h"
+#include "error.h"
+
+//Token-bucket shaping support
+#ifndef NET_SHAPER_SUPPORT
+   #define NET_SHAPER_SUPPORT DISABLED
+#elif (NET_SHAPER_SUPPORT != ENABLED && NET_SHAPER_SUPPORT != DISABLED)
+   #error NET_SHAPER_SUPPORT parameter is not valid
+#endif
+
+//Smallest bucket depth, in bytes (a full-sized segment must fit)
+#ifndef NET_SHAPER_MIN_BURST
+   #define NET_SHAPER_MIN_BURST 1500
+#elif (NET_SHAPER_MIN_BURST < 1)
+   #error NET_SHAPER_MIN_BURST parameter is not valid
+#endif
+
+//The bucket holds at least the tokens earned over this time, in ms, so that
+//the resolution of the waits does not lower the rate
+#ifndef NET_SHAPER_MIN_BURST_TIME
+   #define NET_SHAPER_MIN_BURST_TIME 20
+#elif (NET_SHAPER_MIN_BURST_TIME < 0)
+   #error NET_SHAPER_MIN_BURST_TIME parameter is not valid
+#endif
+
+//Number of traffic classes (one per DSCP class selector)
+#define NET_SHAPER_CLASS_COUNT 8
+
+//Class of a ToS value
+#define NET_SHAPER_CLASS(tos) ((uint_t) (tos) >> 5)
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Token bucket
+ *
+ * Tokens are bytes of payload. A bucket whose rate is zero does not shape
+ * the traffic but still counts it
+ **/
+
+typedef struct
+{
+   uint32_t rate;       ///<Sustained rate, in bytes per second (0 if unshaped)
+   uint32_t burst;      ///<Depth of the bucket, in bytes
+   int32_t tokens;      ///<Available tokens, negative after a retransmission
+   systime_t timestamp; ///<Time at which the tokens were last refilled
+   uint32_t bytes;      ///<Bytes let through
+   uint32_t packets;    ///<Packets let through
+   uint32_t delayed;    ///<Packets held back until enough tokens accumulated
+   uint32_t dropped;    ///<Datagrams refused to senders that cannot wait
+} NetShaperBucket;
+
+
+//Token-bucket shaping related functions
+void netShaperInitBucket(NetShaperBucket *bucket, uint32_t rate,
+   uint32_t burst);
+
+error_t netShaperSetClassRate(uint_t classIndex, uint32_t rate,
+   uint32_t burst);
+
+systime_t netShaperGetDelay(Socket *socket, uint8_t tos, size_t length);
+void netShaperConsume(Socket *socket, uint8_t tos, size_t length);
+
+void netShaperCountDelayed(Socket *socket, uint8_t tos, size_t length);
+void netShaperCountDropped(Socket *socket, uint8_t tos, size_t length);
+
+error_t netShaperGetClassInfo(uint_t classIndex, NetShaperBucket *info);
+error_t netShaperGetSocketInfo(Socket *socket, NetShaperBucket *info);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
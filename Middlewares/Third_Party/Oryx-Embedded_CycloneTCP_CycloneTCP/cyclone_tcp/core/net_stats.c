@@ -0,0 +1,107 @@
+/**
+ * @file net_stats.c
+ * @brief Lightweight network statistics
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * A flat set of 32-bit counters, updated with atomic increments from the
+ * NIC driver and the protocol layers. Unlike the MIB modules, no per-table
+ * bookkeeping is involved, so they can be kept in every build
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL NIC_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/net_stats.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (NET_STATS_SUPPORT == ENABLED)
+
+//Network statistics
+NetStats netStats;
+
+
+/**
+ * @brief Get the counters of a network interface
+ * @param[in] index Interface index
+ * @param[out] stats Snapshot of the counters
+ * @return Error code
+ **/
+
+error_t netStatsGetInterfaceStats(uint_t index, NetInterfaceStats *stats)
+{
+   //Check parameters
+   if(index >= NET_INTERFACE_COUNT || stats == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Each counter is read atomically
+   *stats = netStats.interfaces[index];
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Get the protocol counters
+ * @param[out] stats Snapshot of the counters
+ * @return Error code
+ **/
+
+error_t netStatsGetProtocolStats(NetProtocolStats *stats)
+{
+   //Check parameters
+   if(stats == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Each counter is read atomically
+   *stats = netStats.protocols;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Clear all counters
+ **/
+
+void netStatsReset(void)
+{
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Clear counters
+   osMemset(&netStats, 0, sizeof(netStats));
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+}
+
+#endif
@@ -0,0 +1,164 @@
+/**
+ * @file net_stats.h
+ * @brief Lightweight network statistics
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+#ifndef _NET_STATS_H
+#define _NET_STATS_H
+
+//Dependencies
+#include "net_config.h"
+#include "os_port.h"
+#include "error.h"
+
+//Lightweight network statistics
+#ifndef NET_STATS_SUPPORT
+   #define NET_STATS_SUPPORT DISABLED
+#elif (NET_STATS_SUPPORT != ENABLED && NET_STATS_SUPPORT != DISABLED)
+   #error NET_STATS_SUPPORT parameter is not valid
+#endif
+
+//Atomic increment of a 32-bit counter
+#ifndef NET_STATS_ATOMIC_ADD
+   #if defined(__GNUC__) || defined(__clang__)
+      #define NET_STATS_ATOMIC_ADD(p, n) \
+         (void) __atomic_fetch_add((p), (uint32_t) (n), __ATOMIC_RELAXED)
+   #else
+      #define NET_STATS_ATOMIC_ADD(p, n) (*(p) += (uint32_t) (n))
+   #endif
+#endif
+
+//Counter update macros
+#if (NET_STATS_SUPPORT == ENABLED)
+   #define NET_STATS_IF_INC(interface, name, value) \
+      NET_STATS_ATOMIC_ADD(&netStats.interfaces[(interface)->index].name, value)
+   #define NET_STATS_INC(name, value) \
+      NET_STATS_ATOMIC_ADD(&netStats.protocols.name, value)
+#else
+   #define NET_STATS_IF_INC(interface, name, value)
+   #define NET_STATS_INC(name, value)
+#endif
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Per-interface counters
+ **/
+
+typedef struct
+{
+   uint32_t rxFrames;            ///<Frames passed to the stack
+   uint32_t rxOctets;            ///<Octets passed to the stack
+   uint32_t rxErrors;            ///<Frames discarded by the driver because of errors
+   uint32_t rxMissed;            ///<Frames dropped by the MAC (FIFO overflow, no descriptor)
+   uint32_t rxBufferUnavailable; ///<Times the DMA found the RX descriptor ring full
+   uint32_t rxFifoOverflows;     ///<Frames dropped because the receive FIFO overflowed (included in rxMissed)
+   uint32_t rxCrcErrors;         ///<Frames received with a CRC error
+   uint32_t rxAlignErrors;       ///<Frames received with an alignment error
+   uint32_t rxDmaRestarts;       ///<Times the receive DMA had stopped and was restarted by the driver
+   uint32_t dmaBusErrors;        ///<Fatal bus errors reported by the DMA
+   uint32_t txFrames;            ///<Frames handed to the driver successfully
+   uint32_t txOctets;            ///<Octets handed to the driver successfully
+   uint32_t txDrops;             ///<Frames dropped because the transmitter was busy
+   uint32_t txErrors;            ///<Frames rejected by the driver
+   uint32_t txUnderflows;        ///<Frames aborted because the transmit FIFO ran dry
+   uint32_t txCollisions;        ///<Frames sent after one or more collisions (half duplex)
+   uint32_t offloadArpReplies;   ///<ARP requests answered by the driver offload responder
+   uint32_t offloadEchoReplies;  ///<ICMP echo requests answered by the driver offload responder
+   uint32_t offloadTxBusy;       ///<Offload replies not sent because the TX ring was full
+   uint32_t rxMacFiltered;       ///<Multicast frames passed by the MAC hash filter but not subscribed
+   uint32_t rxMcastFiltered;     ///<IPv4 multicast datagrams dropped by the early group and source filter
+} NetInterfaceStats;
+
+
+/**
+ * @brief Per-protocol counters
+ **/
+
+typedef struct
+{
+   uint32_t ipv4InReceives;      ///<IPv4 datagrams received
+   uint32_t ipv4InHdrErrors;     ///<IPv4 datagrams with an invalid header
+   uint32_t ipv4InChecksumErrors; ///<IPv4 datagrams with a bad header checksum
+   uint32_t ipv4InDelivers;      ///<IPv4 datagrams delivered to upper layers
+   uint32_t ipv4OutRequests;     ///<IPv4 datagrams sent
+   uint32_t ipv4ReasmOks;        ///<IPv4 datagrams successfully reassembled
+   uint32_t ipv4ReasmTimeouts;   ///<IPv4 datagrams whose reassembly timed out
+   uint32_t ipv4ReasmQueueFull;  ///<IPv4 fragments dropped on a full reassembly queue
+   uint32_t ipv4ReasmFails;      ///<IPv4 fragments dropped for any other reason
+   uint32_t tcpInSegs;           ///<TCP segments received
+   uint32_t tcpInErrs;           ///<TCP segments received in error
+   uint32_t tcpInChecksumErrors; ///<TCP segments with a bad checksum
+   uint32_t tcpOutSegs;          ///<TCP segments sent
+   uint32_t tcpRetransSegs;      ///<TCP segments retransmitted
+   uint32_t tcpListenSyns;       ///<SYN segments received by listening sockets
+   uint32_t tcpListenOverflows;  ///<SYN segments received with a full SYN queue
+   uint32_t tcpSynCookiesSent;   ///<SYN/ACK segments carrying a cookie
+   uint32_t tcpSynCookiesRecv;   ///<Connections established with a valid cookie
+   uint32_t tcpSynCookiesFailed; ///<ACK segments with an invalid cookie
+   uint32_t udpInDatagrams;      ///<UDP datagrams delivered
+   uint32_t udpInFastPath;       ///<UDP datagrams delivered to a fast path handler
+   uint32_t udpInShared;         ///<UDP datagrams delivered by reference to a shared port
+   uint32_t udpInErrors;         ///<UDP datagrams received in error
+   uint32_t udpInChecksumErrors; ///<UDP datagrams with a bad checksum
+   uint32_t udpNoPorts;          ///<UDP datagrams for a port with no listener
+   uint32_t udpQueueFullDrops;   ///<UDP datagrams dropped on a full receive queue
+   uint32_t udpNoBufferDrops;    ///<UDP datagrams dropped for lack of memory
+   uint32_t udpOutDatagrams;     ///<UDP datagrams sent
+} NetProtocolStats;
+
+
+/**
+ * @brief Network statistics
+ **/
+
+typedef struct
+{
+   NetInterfaceStats interfaces[NET_INTERFACE_COUNT];
+   NetProtocolStats protocols;
+} NetStats;
+
+
+//Global variables
+extern NetStats netStats;
+
+//Network statistics related functions
+error_t netStatsGetInterfaceStats(uint_t index, NetInterfaceStats *stats);
+error_t netStatsGetProtocolStats(NetProtocolStats *stats);
+void netStatsReset(void);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
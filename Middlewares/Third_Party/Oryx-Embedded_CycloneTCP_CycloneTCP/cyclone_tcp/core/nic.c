@@ -34,7 +34,13 @@
 //Dependencies
 #include "core/net.h"
 #include "core/nic.h"
+#include "core/nic_rx_class.h"
+#include "core/net_capture.h"
 #include "core/ethernet.h"
+#include "core/udp.h"
+#include "core/tcp.h"
+#include "core/tcp_gro.h"
+#include "ipv4/ipv4.h"
 #include "ipv4/ipv4_multicast.h"
 #include "ipv4/ipv4_misc.h"
 #include "ipv6/ipv6_misc.h"
@@ -283,6 +289,9 @@ error_t nicSendPacket(NetInterface *interface, const NetBuffer *buffer,
 {
    error_t error;
    bool_t status;
+#if (NIC_TX_QUEUE_SIZE > 0)
+   uint_t band;
+#endif
 
 #if (TRACE_LEVEL >= TRACE_LEVEL_DEBUG)
    //Retrieve the length of the packet
@@ -299,6 +308,18 @@ error_t nicSendPacket(NetInterface *interface, const NetBuffer *buffer,
    //Check whether the interface is enabled for operation
    if(interface->configured && interface->nicDriver != NULL)
    {
+#if (NIC_GSO_SUPPORT == ENABLED && IPV4_SUPPORT == ENABLED)
+      //Several TCP segments gathered into a single packet?
+      if(ancillary->gsoSize != 0)
+      {
+         //Split the packet and send the segments one by one
+         return nicSendGsoPacket(interface, buffer, offset, ancillary);
+      }
+#endif
+
+      //Copy the frame to the capture ring if it passes the filter
+      NET_CAPTURE_TX(interface, buffer, offset);
+
       //Loopback interface?
       if(interface->nicDriver->type == NIC_TYPE_LOOPBACK)
       {
@@ -307,8 +328,46 @@ error_t nicSendPacket(NetInterface *interface, const NetBuffer *buffer,
       }
       else
       {
+#if (NIC_TX_DEADLINE_SUPPORT == ENABLED)
+         //The deadline of the frame has already passed?
+         if(nicIsTxExpired(ancillary))
+         {
+            //Update statistics
+            interface->nicTxDeadlineDrops++;
+            NET_STATS_IF_INC(interface, txDrops, 1);
+            //A stale frame is dropped rather than sent late
+            return NO_ERROR;
+         }
+#endif
+
+#if (NIC_TX_QUEUE_SIZE > 0)
+         //Priority band of the frame
+         band = nicGetTxPriority(ancillary);
+
+         //Frames of the same or a higher priority queued earlier must be
+         //sent first. Frames of lower priority are overtaken
+         nicFlushTxBands(interface, band + 1);
+
+         //Check whether the transmitter is ready, without blocking
+         if(nicIsTxBandsEmpty(interface, band + 1))
+         {
+            status = osWaitForEvent(&interface->nicTxEvent, 0);
+         }
+         else
+         {
+            status = FALSE;
+         }
+
+         //The transmitter is busy?
+         if(!status)
+         {
+            //Queue a copy of the frame and let the caller proceed
+            return nicEnqueuePacket(interface, buffer, offset, ancillary);
+         }
+#else
          //Wait for the transmitter to be ready to send
          status = osWaitForEvent(&interface->nicTxEvent, NIC_MAX_BLOCKING_TIME);
+#endif
       }
 
       //Check whether the specified event is in signaled state
@@ -326,9 +385,23 @@ error_t nicSendPacket(NetInterface *interface, const NetBuffer *buffer,
          {
             interface->nicDriver->enableIrq(interface);
          }
+
+         //Update statistics
+         nicUpdateTxStats(interface, buffer, offset, error);
+
+#if (NIC_TX_QUEUE_SIZE > 0)
+         //Frames of lower priority may still fit in the transmitter
+         if(interface->nicDriver->type != NIC_TYPE_LOOPBACK)
+         {
+            nicFlushTxQueue(interface);
+         }
+#endif
       }
       else
       {
+         //Update statistics
+         NET_STATS_IF_INC(interface, txDrops, 1);
+
          //If the transmitter is busy, then drop the packet
          error = NO_ERROR;
       }
@@ -344,6 +417,637 @@ error_t nicSendPacket(NetInterface *interface, const NetBuffer *buffer,
 }
 
 
+/**
+ * @brief Queue a packet until the transmitter becomes ready
+ *
+ * The packet is copied to a newly allocated buffer, so that the caller can
+ * release its own buffer immediately
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] buffer Multi-part buffer containing the data to send
+ * @param[in] offset Offset to the first data byte
+ * @param[in] ancillary Additional options passed to the stack along with
+ *   the packet
+ * @return Error code
+ **/
+
+error_t nicEnqueuePacket(NetInterface *interface, const NetBuffer *buffer,
+   size_t offset, NetTxAncillary *ancillary)
+{
+#if (NIC_TX_QUEUE_SIZE > 0)
+   error_t error;
+   uint_t band;
+   uint_t next;
+   uint_t i;
+   size_t length;
+   NetBuffer *copy;
+   NicTxQueueItem *item;
+#if (NIC_TX_DEADLINE_SUPPORT == ENABLED)
+   uint_t prev;
+   NicTxQueueItem *prevItem;
+#endif
+
+   //Each priority band has its own queue
+   band = nicGetTxPriority(ancillary);
+
+   //Index of the entry following the tail
+   next = (interface->nicTxQueueTail[band] + 1) % (NIC_TX_QUEUE_SIZE + 1);
+
+   //The queue is full?
+   if(next == interface->nicTxQueueHead[band])
+   {
+      //Update statistics
+      interface->nicTxQueueDrops++;
+      NET_STATS_IF_INC(interface, txDrops, 1);
+      //If the transmitter is busy, then drop the packet
+      return NO_ERROR;
+   }
+
+   //Retrieve the length of the packet
+   length = netBufferGetLength(buffer) - offset;
+
+   //Allocate a buffer to hold a copy of the packet
+   copy = netBufferAlloc(length);
+
+   //Failed to allocate memory?
+   if(copy == NULL)
+   {
+      //Update statistics
+      NET_STATS_IF_INC(interface, txDrops, 1);
+      //Report an error
+      return ERROR_OUT_OF_MEMORY;
+   }
+
+   //Copy the packet
+   error = netBufferCopy(copy, 0, buffer, offset, length);
+
+   //Check status code
+   if(!error)
+   {
+      //Point to the tail of the queue
+      i = interface->nicTxQueueTail[band];
+
+#if (NIC_TX_DEADLINE_SUPPORT == ENABLED)
+      //A frame with a deadline overtakes the frames of its band due later
+      //or without a deadline, so that each band is served earliest deadline
+      //first. Frames sharing a deadline, or without one, keep their order
+      if(ancillary->deadline != 0)
+      {
+         while(i != interface->nicTxQueueHead[band])
+         {
+            //Point to the preceding entry
+            prev = (i + NIC_TX_QUEUE_SIZE) % (NIC_TX_QUEUE_SIZE + 1);
+            prevItem = &interface->nicTxQueue[band][prev];
+
+            //Due no later than the new frame?
+            if(prevItem->ancillary.deadline != 0 &&
+               timeCompare(prevItem->ancillary.deadline, ancillary->deadline) <= 0)
+            {
+               break;
+            }
+
+            //Move the entry one place back
+            interface->nicTxQueue[band][i] = *prevItem;
+            i = prev;
+         }
+      }
+#endif
+
+      item = &interface->nicTxQueue[band][i];
+
+      //Save the packet and the associated options
+      item->buffer = copy;
+      item->ancillary = *ancillary;
+
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+      //The copy is freed as soon as it has been sent
+      item->ancillary.zeroCopy = TRUE;
+#endif
+
+      //Publish the new entry
+      interface->nicTxQueueTail[band] = next;
+   }
+   else
+   {
+      //Clean up side effects
+      netBufferFree(copy);
+   }
+
+   //Return status code
+   return error;
+#else
+   //The TX queue is not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Check whether the queues of the highest priority bands are empty
+ * @param[in] interface Underlying network interface
+ * @param[in] count Number of bands to check, starting from band 0
+ * @return TRUE if no packet of these bands is waiting, else FALSE
+ **/
+
+bool_t nicIsTxBandsEmpty(NetInterface *interface, uint_t count)
+{
+#if (NIC_TX_QUEUE_SIZE > 0)
+   uint_t i;
+
+   //Loop through the priority bands
+   for(i = 0; i < count; i++)
+   {
+      //The queue is empty when both indexes are equal
+      if(interface->nicTxQueueHead[i] != interface->nicTxQueueTail[i])
+         return FALSE;
+   }
+#endif
+
+   //No packet is waiting
+   return TRUE;
+}
+
+
+/**
+ * @brief Send the queued packets of the highest priority bands
+ *
+ * Packets are sent in priority order, then in queue order (earliest deadline
+ * first, then arrival), as long as the transmitter is ready. Packets whose
+ * deadline has passed are dropped
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] count Number of bands to serve, starting from band 0
+ **/
+
+void nicFlushTxBands(NetInterface *interface, uint_t count)
+{
+#if (NIC_TX_QUEUE_SIZE > 0)
+   error_t error;
+   uint_t band;
+   NicTxQueueItem *item;
+
+   //Serve the bands in priority order
+   for(band = 0; band < count; band++)
+   {
+      //Send as many packets as the transmitter can accept
+      while(interface->nicTxQueueHead[band] != interface->nicTxQueueTail[band] &&
+         interface->configured && interface->nicDriver != NULL)
+      {
+         //Point to the oldest packet of the band
+         item = &interface->nicTxQueue[band][interface->nicTxQueueHead[band]];
+
+#if (NIC_TX_DEADLINE_SUPPORT == ENABLED)
+         //The packet waited past its deadline?
+         if(nicIsTxExpired(&item->ancillary))
+         {
+            //Update statistics
+            interface->nicTxDeadlineDrops++;
+            NET_STATS_IF_INC(interface, txDrops, 1);
+         }
+         else
+#endif
+         {
+            //Check whether the transmitter is ready to send
+            if(!osWaitForEvent(&interface->nicTxEvent, 0))
+               return;
+
+            //Disable interrupts
+            interface->nicDriver->disableIrq(interface);
+
+            //Send the packet
+            error = interface->nicDriver->sendPacket(interface, item->buffer, 0,
+               &item->ancillary);
+
+            //Re-enable interrupts if necessary
+            if(interface->configured)
+            {
+               interface->nicDriver->enableIrq(interface);
+            }
+
+            //Update statistics
+            nicUpdateTxStats(interface, item->buffer, 0, error);
+         }
+
+         //Release the copy of the packet
+         netBufferFree(item->buffer);
+         item->buffer = NULL;
+
+         //Remove the packet from the queue
+         interface->nicTxQueueHead[band] = (interface->nicTxQueueHead[band] +
+            1) % (NIC_TX_QUEUE_SIZE + 1);
+      }
+   }
+#endif
+}
+
+
+/**
+ * @brief Send queued packets while the transmitter is ready
+ * @param[in] interface Underlying network interface
+ **/
+
+void nicFlushTxQueue(NetInterface *interface)
+{
+   //Serve all the priority bands
+   nicFlushTxBands(interface, NIC_TX_PRIORITY_COUNT);
+}
+
+
+/**
+ * @brief Check whether the TX queue is empty
+ * @param[in] interface Underlying network interface
+ * @return TRUE if no packet is waiting for the transmitter, else FALSE
+ **/
+
+bool_t nicIsTxQueueEmpty(NetInterface *interface)
+{
+   //Check all the priority bands
+   return nicIsTxBandsEmpty(interface, NIC_TX_PRIORITY_COUNT);
+}
+
+
+/**
+ * @brief Get the TX priority band of a packet
+ *
+ * The VLAN priority is used when set, else the class selector of the DSCP
+ * (the three most significant bits of the ToS field). Priority 7 maps to
+ * band 0 and priority 0 to the last band
+ *
+ * @param[in] ancillary Additional options passed to the stack along with
+ *   the packet
+ * @return Priority band
+ **/
+
+uint_t nicGetTxPriority(const NetTxAncillary *ancillary)
+{
+   uint_t priority;
+
+#if (ETH_VLAN_SUPPORT == ENABLED)
+   //VLAN priority set by the socket?
+   if(ancillary->vlanPcp >= 0)
+   {
+      priority = ancillary->vlanPcp & 0x07;
+   }
+   else
+#endif
+   {
+      //Class selector of the DSCP
+      priority = ancillary->tos >> 5;
+   }
+
+   //Map the priority onto the bands
+   return ((7 - priority) * NIC_TX_PRIORITY_COUNT) / 8;
+}
+
+
+/**
+ * @brief Check whether the deadline of a packet has passed
+ * @param[in] ancillary Additional options passed to the stack along with
+ *   the packet
+ * @return TRUE if the packet is to be dropped rather than sent, else FALSE
+ **/
+
+bool_t nicIsTxExpired(const NetTxAncillary *ancillary)
+{
+#if (NIC_TX_DEADLINE_SUPPORT == ENABLED)
+   //A null deadline means that the packet is never stale
+   if(ancillary->deadline != 0 &&
+      timeCompare(osGetSystemTime(), ancillary->deadline) > 0)
+   {
+      return TRUE;
+   }
+#endif
+
+   //The packet is to be sent
+   return FALSE;
+}
+
+
+/**
+ * @brief Account a frame handed to the NIC driver
+ * @param[in] interface Underlying network interface
+ * @param[in] buffer Multi-part buffer containing the frame
+ * @param[in] offset Offset to the first byte of the frame
+ * @param[in] error Status code returned by the driver
+ **/
+
+void nicUpdateTxStats(NetInterface *interface, const NetBuffer *buffer,
+   size_t offset, error_t error)
+{
+#if (NET_STATS_SUPPORT == ENABLED)
+   //Check status code
+   if(!error)
+   {
+      //Frame accepted by the driver
+      NET_STATS_IF_INC(interface, txFrames, 1);
+      NET_STATS_IF_INC(interface, txOctets, netBufferGetLength(buffer) - offset);
+   }
+   else
+   {
+      //Frame rejected by the driver
+      NET_STATS_IF_INC(interface, txErrors, 1);
+   }
+#endif
+}
+
+
+/**
+ * @brief Check whether GSO packets can be sent over a given interface
+ *
+ * The TCP segments are cut out of the Ethernet frame as it is handed over to
+ * the driver, so that nothing may follow the payload (CRC or tail tag)
+ *
+ * @param[in] interface Underlying network interface
+ * @return TRUE if GSO packets can be sent, else FALSE
+ **/
+
+bool_t nicIsGsoCapable(NetInterface *interface)
+{
+   bool_t capable;
+
+   //GSO is not available by default
+   capable = FALSE;
+
+#if (NIC_GSO_SUPPORT == ENABLED && IPV4_SUPPORT == ENABLED)
+   //Valid interface?
+   if(interface != NULL)
+   {
+      NetInterface *physicalInterface;
+
+      //Point to the physical interface
+      physicalInterface = nicGetPhysicalInterface(interface);
+
+      //The CRC must be appended to each segment by the hardware
+      if(physicalInterface->nicDriver != NULL &&
+         physicalInterface->nicDriver->type == NIC_TYPE_ETHERNET &&
+         physicalInterface->nicDriver->autoCrcCalc)
+      {
+         capable = TRUE;
+      }
+
+#if (ETH_PORT_TAGGING_SUPPORT == ENABLED)
+      //Some switches append a tail tag to the frames
+      if(physicalInterface->switchDriver != NULL &&
+         physicalInterface->switchDriver->tagFrame != NULL)
+      {
+         capable = FALSE;
+      }
+#endif
+   }
+#endif
+
+   //Return TRUE if GSO packets can be sent
+   return capable;
+}
+
+
+#if (NIC_GSO_SUPPORT == ENABLED && IPV4_SUPPORT == ENABLED)
+
+/**
+ * @brief Adjust a checksum after a 16-bit word has changed
+ * @param[in] checksum Checksum covering the old value
+ * @param[in] oldValue Old value of the word
+ * @param[in] newValue New value of the word
+ * @return Checksum covering the new value
+ **/
+
+static uint16_t nicAdjustChecksum(uint16_t checksum, uint16_t oldValue,
+   uint16_t newValue)
+{
+   uint32_t sum;
+
+   //Incremental update of the one's complement sum (refer to RFC 1624,
+   //section 3)
+   sum = (uint16_t) ~checksum + (uint16_t) ~oldValue + newValue;
+   sum = (sum & 0xFFFF) + (sum >> 16);
+   sum = (sum & 0xFFFF) + (sum >> 16);
+
+   //Return the updated checksum
+   return (uint16_t) ~sum;
+}
+
+
+/**
+ * @brief Split a GSO packet into TCP segments
+ *
+ * The headers of the packet serve as a template. Each segment gets a copy,
+ * with its own IP length, identification and sequence number, the PSH and
+ * FIN flags being left to the last segment, and references its share of the
+ * data in place. The IP header checksum is adjusted rather than recomputed.
+ * The segments are sent as one TX batch
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] buffer Multi-part buffer containing the Ethernet frame
+ * @param[in] offset Offset to the first byte of the frame
+ * @param[in] ancillary Additional options passed to the stack along with
+ *   the packet
+ * @return Error code
+ **/
+
+error_t nicSendGsoPacket(NetInterface *interface, const NetBuffer *buffer,
+   size_t offset, NetTxAncillary *ancillary)
+{
+   error_t error;
+   uint_t i;
+   uint16_t type;
+   uint16_t id;
+   uint16_t totalLength;
+   uint16_t checksum;
+   uint32_t seqNum;
+   uint8_t flags;
+   size_t n;
+   size_t length;
+   size_t ipOffset;
+   size_t tcpOffset;
+   size_t headerLength;
+   size_t dataOffset;
+   Ipv4Header *ipHeader;
+   TcpHeader *tcpHeader;
+   Ipv4PseudoHeader pseudoHeader;
+   NetTxAncillary segmentAncillary;
+   NicGsoBuffer segment;
+   uint8_t header[sizeof(EthHeader) + 2 * sizeof(VlanTag) +
+      IPV4_MAX_HEADER_LENGTH + TCP_MAX_HEADER_LENGTH];
+#if (NIC_TX_BATCH_SUPPORT == ENABLED)
+   bool_t batch;
+#endif
+
+   //Retrieve the length of the packet
+   length = netBufferGetLength(buffer) - offset;
+   //Copy the headers, as far as the longest ones may reach
+   n = netBufferRead(header, buffer, offset, MIN(length, sizeof(header)));
+
+   //Malformed frame?
+   if(interface->nicDriver->type != NIC_TYPE_ETHERNET || n < sizeof(EthHeader))
+      return ERROR_INVALID_PACKET;
+
+   //Skip the Ethernet header and the VLAN tags
+   type = ntohs(((EthHeader *) header)->type);
+   ipOffset = sizeof(EthHeader);
+
+   //VLAN or VMAN tag?
+   while((type == ETH_TYPE_VLAN || type == ETH_TYPE_VMAN) &&
+      (ipOffset + sizeof(VlanTag)) <= n)
+   {
+      type = ntohs(((VlanTag *) (header + ipOffset))->type);
+      ipOffset += sizeof(VlanTag);
+   }
+
+   //Only TCP segments carried by IPv4 can be split
+   if(type != ETH_TYPE_IPV4 || (ipOffset + sizeof(Ipv4Header)) > n)
+      return ERROR_INVALID_PACKET;
+
+   //Point to the IPv4 header
+   ipHeader = (Ipv4Header *) (header + ipOffset);
+   tcpOffset = ipOffset + ipHeader->headerLength * 4;
+
+   //Check the IPv4 header
+   if(ipHeader->protocol != IPV4_PROTOCOL_TCP ||
+      (tcpOffset + sizeof(TcpHeader)) > n)
+   {
+      return ERROR_INVALID_PACKET;
+   }
+
+   //Point to the TCP header
+   tcpHeader = (TcpHeader *) (header + tcpOffset);
+   headerLength = tcpOffset + tcpHeader->dataOffset * 4;
+
+   //Check the TCP header
+   if(headerLength > n || headerLength >= length)
+      return ERROR_INVALID_PACKET;
+
+   //Save the fields that differ from one segment to the next
+   totalLength = ipHeader->totalLength;
+   id = ipHeader->identification;
+   checksum = ipHeader->headerChecksum;
+   seqNum = ntohl(tcpHeader->seqNum);
+   flags = tcpHeader->flags;
+
+   //Format IPv4 pseudo header
+   pseudoHeader.srcAddr = ipHeader->srcAddr;
+   pseudoHeader.destAddr = ipHeader->destAddr;
+   pseudoHeader.reserved = 0;
+   pseudoHeader.protocol = IPV4_PROTOCOL_TCP;
+
+#if (NIC_TX_BATCH_SUPPORT == ENABLED)
+   //The DMA is notified once all the segments are queued, unless the caller
+   //already sends a batch
+   batch = interface->nicTxBatch;
+   interface->nicTxBatch = TRUE;
+#endif
+
+   //Initialize status code
+   error = NO_ERROR;
+
+   //Cut the data into segments
+   for(i = 0, dataOffset = headerLength; dataOffset < length && !error; i++)
+   {
+      //Length of the data carried by the current segment
+      n = MIN(length - dataOffset, ancillary->gsoSize);
+
+      //The segment starts with the headers
+      segment.chunkCount = 1;
+      segment.maxChunkCount = arraysize(segment.chunk);
+      segment.chunk[0].address = header;
+      segment.chunk[0].length = (uint16_t) headerLength;
+      segment.chunk[0].size = 0;
+
+      //The data is referenced in place
+      error = netBufferConcat((NetBuffer *) &segment, buffer,
+         offset + dataOffset, n);
+      //Any error to report?
+      if(error)
+         break;
+
+      //Format the IPv4 header of the segment
+      ipHeader->totalLength = htons(headerLength - ipOffset + n);
+      ipHeader->identification = htons(ntohs(id) + i);
+
+      //The IP header checksum is inserted by the NIC when offload is active
+      if(!ipv4IsChecksumOffloadEnabled(interface, 0))
+      {
+         ipHeader->headerChecksum = nicAdjustChecksum(nicAdjustChecksum(
+            checksum, totalLength, ipHeader->totalLength), id,
+            ipHeader->identification);
+      }
+
+      //Format the TCP header of the segment
+      tcpHeader->seqNum = htonl(seqNum + dataOffset - headerLength);
+
+      //The PSH and FIN flags are carried by the last segment
+      if((dataOffset + n) < length)
+      {
+         tcpHeader->flags = flags & (uint8_t) ~(TCP_FLAG_PSH | TCP_FLAG_FIN);
+      }
+      else
+      {
+         tcpHeader->flags = flags;
+      }
+
+      //The checksum is inserted by the NIC when offload is active
+      tcpHeader->checksum = 0;
+
+      //Check whether the TCP checksum must be calculated by software
+      if(!ipv4IsChecksumOffloadEnabled(interface, headerLength - tcpOffset + n))
+      {
+         //Calculate TCP header checksum
+         pseudoHeader.length = htons(headerLength - tcpOffset + n);
+
+         tcpHeader->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader,
+            sizeof(Ipv4PseudoHeader), (NetBuffer *) &segment, tcpOffset,
+            headerLength - tcpOffset + n);
+      }
+
+      //The segment is copied by the driver before the headers are reused
+      segmentAncillary = *ancillary;
+      segmentAncillary.gsoSize = 0;
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+      segmentAncillary.zeroCopy = FALSE;
+#endif
+
+      //Send the segment
+      error = nicSendPacket(interface, (NetBuffer *) &segment, 0,
+         &segmentAncillary);
+
+      //Next segment
+      dataOffset += n;
+   }
+
+   //Update statistics
+   interface->nicGsoPackets++;
+   interface->nicGsoSegments += i;
+
+#if (NIC_TX_BATCH_SUPPORT == ENABLED)
+   //End of the batch?
+   if(!batch)
+   {
+      interface->nicTxBatch = FALSE;
+
+      //Check whether the driver defers the start of the transmission
+      if(interface->configured && interface->nicDriver->flushTx != NULL)
+      {
+         //Disable interrupts
+         interface->nicDriver->disableIrq(interface);
+
+         //Notify the DMA of the segments queued during the batch
+         interface->nicDriver->flushTx(interface);
+
+         //Re-enable interrupts if necessary
+         if(interface->configured)
+         {
+            interface->nicDriver->enableIrq(interface);
+         }
+      }
+   }
+#endif
+
+   //Return status code
+   return error;
+}
+
+#endif
+
+
 /**
  * @brief Configure MAC address filtering
  * @param[in] interface Underlying network interface
@@ -380,6 +1084,116 @@ error_t nicUpdateMacAddrFilter(NetInterface *interface)
 }
 
 
+/**
+ * @brief Start the delivery of a batch of received frames
+ *
+ * The NIC driver brackets the frames it drains in one call to its event
+ * handler with nicBeginRxBatch and nicEndRxBatch. Socket notifications are
+ * deferred until the end of the batch, so that a burst of datagrams for the
+ * same socket results in a single hand-off to the application
+ *
+ * @param[in] interface Underlying network interface
+ **/
+
+void nicBeginRxBatch(NetInterface *interface)
+{
+#if (NIC_RX_BATCH_SUPPORT == ENABLED)
+   //Frames are now delivered as part of a batch
+   interface->nicRxBatch = TRUE;
+#endif
+}
+
+
+/**
+ * @brief Complete the delivery of a batch of received frames
+ * @param[in] interface Underlying network interface
+ **/
+
+void nicEndRxBatch(NetInterface *interface)
+{
+#if (NIC_RX_BATCH_SUPPORT == ENABLED)
+   //End of the batch
+   interface->nicRxBatch = FALSE;
+
+   //Process the TCP segments held for coalescing
+   TCP_GRO_FLUSH();
+
+   //Process the frames of the lower priority classes
+   NIC_RX_CLASS_FLUSH();
+
+#if (UDP_SUPPORT == ENABLED)
+   //Notify the sockets that received datagrams during the batch
+   udpFlushPendingEvents();
+#endif
+#endif
+}
+
+
+/**
+ * @brief Start sending a batch of frames
+ *
+ * Between nicBeginTxBatch and nicEndTxBatch, NIC drivers that support it
+ * queue the frames in their descriptor ring without notifying the DMA, so
+ * that a burst of frames costs a single doorbell write. The batch applies to
+ * all interfaces, since the caller does not know in advance where the frames
+ * are routed
+ **/
+
+void nicBeginTxBatch(void)
+{
+#if (NIC_TX_BATCH_SUPPORT == ENABLED)
+   uint_t i;
+
+   //Loop through network interfaces
+   for(i = 0; i < NET_INTERFACE_COUNT; i++)
+   {
+      //Frames are now sent as part of a batch
+      netInterface[i].nicTxBatch = TRUE;
+   }
+#endif
+}
+
+
+/**
+ * @brief Complete a batch of frames and start their transmission
+ **/
+
+void nicEndTxBatch(void)
+{
+#if (NIC_TX_BATCH_SUPPORT == ENABLED)
+   uint_t i;
+   NetInterface *interface;
+
+   //Loop through network interfaces
+   for(i = 0; i < NET_INTERFACE_COUNT; i++)
+   {
+      //Point to the current interface
+      interface = &netInterface[i];
+
+      //End of the batch
+      interface->nicTxBatch = FALSE;
+
+      //Check whether the driver defers the start of the transmission
+      if(interface->configured && interface->nicDriver != NULL &&
+         interface->nicDriver->flushTx != NULL)
+      {
+         //Disable interrupts
+         interface->nicDriver->disableIrq(interface);
+
+         //Notify the DMA of the frames queued during the batch
+         interface->nicDriver->flushTx(interface);
+
+         //Re-enable interrupts if necessary
+         if(interface->configured)
+         {
+            interface->nicDriver->enableIrq(interface);
+         }
+      }
+   }
+#endif
+}
+
+
 /**
  * @brief Handle a packet received by the network controller
  * @param[in] interface Underlying network interface
@@ -394,9 +1208,21 @@ void nicProcessPacket(NetInterface *interface, uint8_t *packet, size_t length,
 {
    NicType type;
 
+   //Frame handed to the stack (latency instrumentation)
+   NET_LATENCY_MARK(NET_LATENCY_POINT_NIC);
+
+#if (NIC_RX_TIME_SUPPORT == ENABLED)
+   //Stamp the frame before it is possibly deferred to the end of the batch
+   ancillary->rxTime = NIC_RX_TIME_US();
+#endif
+
    //Gather entropy
    netContext.entropy += netGetSystemTickCount();
 
+   //Update statistics
+   NET_STATS_IF_INC(interface, rxFrames, 1);
+   NET_STATS_IF_INC(interface, rxOctets, length);
+
    //Check whether the interface is enabled for operation
    if(interface->configured)
    {
@@ -407,6 +1233,9 @@ void nicProcessPacket(NetInterface *interface, uint8_t *packet, size_t length,
       TRACE_DEBUG("Packet received (%" PRIuSIZE " bytes)...\r\n", length);
       TRACE_DEBUG_ARRAY("  ", packet, length);
 
+      //Copy the frame to the capture ring if it passes the filter
+      NET_CAPTURE_RX(interface, packet, length);
+
       //Retrieve network interface type
       type = interface->nicDriver->type;
 
@@ -414,8 +1243,13 @@ void nicProcessPacket(NetInterface *interface, uint8_t *packet, size_t length,
       //Ethernet interface?
       if(type == NIC_TYPE_ETHERNET)
       {
-         //Process incoming Ethernet frame
-         ethProcessFrame(interface, packet, length, ancillary);
+         //Frames of the lower priority classes are held until the end of
+         //the batch
+         if(!NIC_RX_CLASS_DEFER_FRAME(interface, packet, length, ancillary))
+         {
+            //Process incoming Ethernet frame
+            ethProcessFrame(interface, packet, length, ancillary);
+         }
       }
       else
 #endif
@@ -48,6 +48,69 @@
    #error NIC_MAX_BLOCKING_TIME parameter is not valid
 #endif
 
+//Depth of the per-interface TX queue (0 to disable)
+#ifndef NIC_TX_QUEUE_SIZE
+   #define NIC_TX_QUEUE_SIZE 0
+#elif (NIC_TX_QUEUE_SIZE < 0)
+   #error NIC_TX_QUEUE_SIZE parameter is not valid
+#endif
+
+//Number of TX priority bands, each with its own queue (band 0 first)
+#ifndef NIC_TX_PRIORITY_COUNT
+   #define NIC_TX_PRIORITY_COUNT 1
+#elif (NIC_TX_PRIORITY_COUNT < 1 || NIC_TX_PRIORITY_COUNT > 8)
+   #error NIC_TX_PRIORITY_COUNT parameter is not valid
+#endif
+
+//TX deadlines
+#ifndef NIC_TX_DEADLINE_SUPPORT
+   #define NIC_TX_DEADLINE_SUPPORT DISABLED
+#elif (NIC_TX_DEADLINE_SUPPORT != ENABLED && NIC_TX_DEADLINE_SUPPORT != DISABLED)
+   #error NIC_TX_DEADLINE_SUPPORT parameter is not valid
+#endif
+
+//Receive time of each frame, in microseconds
+#ifndef NIC_RX_TIME_SUPPORT
+   #define NIC_RX_TIME_SUPPORT DISABLED
+#elif (NIC_RX_TIME_SUPPORT != ENABLED && NIC_RX_TIME_SUPPORT != DISABLED)
+   #error NIC_RX_TIME_SUPPORT parameter is not valid
+#endif
+
+//64-bit microsecond clock stamping received frames
+#if (NIC_RX_TIME_SUPPORT == ENABLED)
+   #ifndef NIC_RX_TIME_US
+      #error NIC_RX_TIME_US macro is not defined
+   #endif
+#endif
+
+//Batched RX delivery
+#ifndef NIC_RX_BATCH_SUPPORT
+   #define NIC_RX_BATCH_SUPPORT DISABLED
+#elif (NIC_RX_BATCH_SUPPORT != ENABLED && NIC_RX_BATCH_SUPPORT != DISABLED)
+   #error NIC_RX_BATCH_SUPPORT parameter is not valid
+#endif
+
+//Batched TX kick
+#ifndef NIC_TX_BATCH_SUPPORT
+   #define NIC_TX_BATCH_SUPPORT DISABLED
+#elif (NIC_TX_BATCH_SUPPORT != ENABLED && NIC_TX_BATCH_SUPPORT != DISABLED)
+   #error NIC_TX_BATCH_SUPPORT parameter is not valid
+#endif
+
+//Generic segmentation offload (TCP segments split in software at the NIC)
+#ifndef NIC_GSO_SUPPORT
+   #define NIC_GSO_SUPPORT DISABLED
+#elif (NIC_GSO_SUPPORT != ENABLED && NIC_GSO_SUPPORT != DISABLED)
+   #error NIC_GSO_SUPPORT parameter is not valid
+#endif
+
+//Maximum number of TCP segments gathered into a GSO packet
+#ifndef NIC_GSO_MAX_SEGMENTS
+   #define NIC_GSO_MAX_SEGMENTS 4
+#elif (NIC_GSO_MAX_SEGMENTS < 2)
+   #error NIC_GSO_MAX_SEGMENTS parameter is not valid
+#endif
+
 //Size of the NIC driver context
 #ifndef NIC_CONTEXT_SIZE
    #define NIC_CONTEXT_SIZE 16
@@ -177,6 +240,8 @@ typedef void (*NicEventHandler)(NetInterface *interface);
 typedef error_t (*NicSendPacket)(NetInterface *interface,
    const NetBuffer *buffer, size_t offset, NetTxAncillary *ancillary);
 
+typedef void (*NicFlushTx)(NetInterface *interface);
+
 typedef error_t (*NicUpdateMacAddrFilter)(NetInterface *interface);
 typedef error_t (*NicUpdateMacConfig)(NetInterface *interface);
 
@@ -278,6 +343,32 @@ typedef void (*ExtIntEnableIrq)(void);
 typedef void (*ExtIntDisableIrq)(void);
 
 
+/**
+ * @brief Frame waiting in the TX queue
+ **/
+
+typedef struct
+{
+   NetBuffer *buffer;
+   NetTxAncillary ancillary;
+} NicTxQueueItem;
+
+
+/**
+ * @brief TCP segment cut out of a GSO packet
+ *
+ * The first chunk holds the headers, the next ones reference the data of
+ * the packet, which spans at most three chunks of the send buffer
+ **/
+
+typedef struct
+{
+   uint_t chunkCount;
+   uint_t maxChunkCount;
+   ChunkDesc chunk[4];
+} NicGsoBuffer;
+
+
 /**
  * @brief NIC driver
  **/
@@ -300,6 +391,14 @@ typedef struct
    bool_t autoCrcCalc;
    bool_t autoCrcVerif;
    bool_t autoCrcStrip;
+#if (ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
+   bool_t txChecksumOffload;
+   bool_t rxChecksumOffload;
+#endif
+   NicFlushTx flushTx;
+#if (ETH_VLAN_SUPPORT == ENABLED)
+   bool_t vlanTagInsertion;
+#endif
 } NicDriver;
 
 
@@ -419,8 +518,32 @@ void nicTick(NetInterface *interface);
 error_t nicSendPacket(NetInterface *interface, const NetBuffer *buffer,
    size_t offset, NetTxAncillary *ancillary);
 
+error_t nicEnqueuePacket(NetInterface *interface, const NetBuffer *buffer,
+   size_t offset, NetTxAncillary *ancillary);
+
+error_t nicSendGsoPacket(NetInterface *interface, const NetBuffer *buffer,
+   size_t offset, NetTxAncillary *ancillary);
+
+void nicFlushTxBands(NetInterface *interface, uint_t count);
+void nicFlushTxQueue(NetInterface *interface);
+bool_t nicIsTxBandsEmpty(NetInterface *interface, uint_t count);
+bool_t nicIsTxQueueEmpty(NetInterface *interface);
+uint_t nicGetTxPriority(const NetTxAncillary *ancillary);
+bool_t nicIsTxExpired(const NetTxAncillary *ancillary);
+
+void nicUpdateTxStats(NetInterface *interface, const NetBuffer *buffer,
+   size_t offset, error_t error);
+
+bool_t nicIsGsoCapable(NetInterface *interface);
+
 error_t nicUpdateMacAddrFilter(NetInterface *interface);
 
+void nicBeginRxBatch(NetInterface *interface);
+void nicEndRxBatch(NetInterface *interface);
+
+void nicBeginTxBatch(void);
+void nicEndTxBatch(void);
+
 void nicProcessPacket(NetInterface *interface, uint8_t *packet, size_t length,
    NetRxAncillary *ancillary);
 
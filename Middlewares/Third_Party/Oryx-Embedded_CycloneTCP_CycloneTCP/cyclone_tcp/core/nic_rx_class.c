@@ -0,0 +1,520 @@
+/**
+ * @file nic_rx_class.c
+ * @brief Early classification of received frames
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * Received Ethernet frames are matched against a small rule table (EtherType,
+ * IP protocol, TCP/UDP destination port, DSCP) before any protocol processing.
+ * Frames of class 0 are processed as soon as the driver hands them over. The
+ * frames of the other classes are held until the end of the RX batch, then
+ * processed class by class. A frame of the real-time control stream is thus
+ * no longer processed behind the bulk TCP frames that precede it in the
+ * descriptor ring. Held frames keep the driver buffer when it can be loaned,
+ * and are copied otherwise. The frames of a class are always processed in
+ * their arrival order
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL NIC_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/nic_rx_class.h"
+#include "core/ethernet.h"
+#include "ipv4/ipv4.h"
+#include "ipv6/ipv6.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (NIC_RX_CLASS_SUPPORT == ENABLED && ETH_SUPPORT == ENABLED)
+
+
+/**
+ * @brief Frame held until the end of the batch
+ *
+ * The descriptor is stored at the head of the buffer that holds the frame
+ **/
+
+typedef struct _NicRxClassItem
+{
+   struct _NicRxClassItem *next;
+   NetInterface *interface;
+   NetBuffer *buffer;
+   uint8_t *frame;
+   size_t length;
+   NetRxAncillary ancillary;
+} NicRxClassItem;
+
+
+/**
+ * @brief Frames of a class, in arrival order
+ **/
+
+typedef struct
+{
+   NicRxClassItem *head;
+   NicRxClassItem *tail;
+   uint_t count;
+} NicRxClassQueue;
+
+
+//Classification rules
+static NicRxClassRule nicRxClassRules[NIC_RX_CLASS_RULE_COUNT];
+static uint_t nicRxClassRuleCount;
+
+//Held frames (the queue of class 0 is not used)
+static NicRxClassQueue nicRxClassQueues[NIC_RX_CLASS_COUNT];
+//Statistics
+static NicRxClassStats nicRxClassStats[NIC_RX_CLASS_COUNT];
+
+
+/**
+ * @brief Add a classification rule
+ * @param[in] rule Rule to append to the table
+ * @return Error code
+ **/
+
+error_t nicRxClassAddRule(const NicRxClassRule *rule)
+{
+   error_t error;
+
+   //Check parameters
+   if(rule == NULL || rule->classIndex >= NIC_RX_CLASS_COUNT)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Check whether the table is full
+   if(nicRxClassRuleCount < NIC_RX_CLASS_RULE_COUNT)
+   {
+      //Append the rule
+      nicRxClassRules[nicRxClassRuleCount++] = *rule;
+      //Successful processing
+      error = NO_ERROR;
+   }
+   else
+   {
+      //The table is full
+      error = ERROR_OUT_OF_RESOURCES;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Remove all classification rules
+ *
+ * Without any rule, frames are processed in their arrival order
+ **/
+
+void nicRxClassClearRules(void)
+{
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Clear the table
+   nicRxClassRuleCount = 0;
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+}
+
+
+/**
+ * @brief Determine the class of a received frame
+ * @param[in] frame Incoming Ethernet frame
+ * @param[in] length Length of the frame
+ * @return Class index
+ **/
+
+static uint_t nicRxClassifyFrame(const uint8_t *frame, size_t length)
+{
+   uint_t i;
+   uint_t fields;
+   size_t n;
+   uint16_t ethType;
+   uint8_t ipProtocol;
+   uint8_t dscp;
+   uint16_t destPort;
+   bool_t transport;
+   const NicRxClassRule *rule;
+
+   //Malformed frame?
+   if(length < sizeof(EthHeader))
+      return NIC_RX_CLASS_DEFAULT;
+
+   //Retrieve the EtherType
+   ethType = LOAD16BE(frame + 12);
+   n = sizeof(EthHeader);
+
+   //Skip the VLAN tag, if any
+   if(ethType == ETH_TYPE_VLAN && length >= (n + 4))
+   {
+      ethType = LOAD16BE(frame + n + 2);
+      n += 4;
+   }
+
+   //The EtherType is always known
+   fields = NIC_RX_CLASS_MATCH_ETH_TYPE;
+   ipProtocol = 0;
+   dscp = 0;
+   destPort = 0;
+   transport = FALSE;
+
+#if (IPV4_SUPPORT == ENABLED)
+   //IPv4 packet?
+   if(ethType == ETH_TYPE_IPV4 && length >= (n + sizeof(Ipv4Header)))
+   {
+      const Ipv4Header *header;
+
+      //Point to the IPv4 header
+      header = (const Ipv4Header *) (frame + n);
+
+      //Retrieve the protocol and the DSCP
+      ipProtocol = header->protocol;
+      dscp = header->typeOfService >> 2;
+      fields |= NIC_RX_CLASS_MATCH_IP_PROTOCOL | NIC_RX_CLASS_MATCH_DSCP;
+
+      //Only the first fragment carries the transport header
+      if((ntohs(header->fragmentOffset) & IPV4_OFFSET_MASK) == 0)
+      {
+         n += header->headerLength * 4;
+         transport = TRUE;
+      }
+   }
+#endif
+
+#if (IPV6_SUPPORT == ENABLED)
+   //IPv6 packet?
+   if(ethType == ETH_TYPE_IPV6 && length >= (n + sizeof(Ipv6Header)))
+   {
+      const Ipv6Header *header;
+
+      //Point to the IPv6 header
+      header = (const Ipv6Header *) (frame + n);
+
+      //Retrieve the next header and the DSCP (extension headers are not
+      //walked through)
+      ipProtocol = header->nextHeader;
+      dscp = ((header->trafficClassH << 4) | header->trafficClassL) >> 2;
+      fields |= NIC_RX_CLASS_MATCH_IP_PROTOCOL | NIC_RX_CLASS_MATCH_DSCP;
+
+      n += sizeof(Ipv6Header);
+      transport = TRUE;
+   }
+#endif
+
+   //TCP segment or UDP datagram?
+   if(transport && (ipProtocol == IPV4_PROTOCOL_TCP ||
+      ipProtocol == IPV4_PROTOCOL_UDP) && length >= (n + 4))
+   {
+      //The destination port follows the source port in both headers
+      destPort = LOAD16BE(frame + n + 2);
+      fields |= NIC_RX_CLASS_MATCH_DEST_PORT;
+   }
+
+   //Loop through the rules
+   for(i = 0; i < nicRxClassRuleCount; i++)
+   {
+      //Point to the current rule
+      rule = &nicRxClassRules[i];
+
+      //All the selected fields must be present in the frame
+      if((rule->match & ~fields) != 0)
+         continue;
+
+      //Compare the selected fields
+      if((rule->match & NIC_RX_CLASS_MATCH_ETH_TYPE) != 0 &&
+         rule->ethType != ethType)
+      {
+         continue;
+      }
+
+      if((rule->match & NIC_RX_CLASS_MATCH_IP_PROTOCOL) != 0 &&
+         rule->ipProtocol != ipProtocol)
+      {
+         continue;
+      }
+
+      if((rule->match & NIC_RX_CLASS_MATCH_DEST_PORT) != 0 &&
+         rule->destPort != destPort)
+      {
+         continue;
+      }
+
+      if((rule->match & NIC_RX_CLASS_MATCH_DSCP) != 0 &&
+         rule->dscp != dscp)
+      {
+         continue;
+      }
+
+      //The first matching rule determines the class
+      return rule->classIndex;
+   }
+
+   //The frame matches no rule
+   return NIC_RX_CLASS_DEFAULT;
+}
+
+
+/**
+ * @brief Hold a frame, taking over its buffer when it can be loaned
+ * @param[in] frame Incoming Ethernet frame
+ * @param[in] length Length of the frame
+ * @return Descriptor of the held frame, or NULL on failure
+ **/
+
+static NicRxClassItem *nicRxClassHoldFrame(uint8_t *frame, size_t length)
+{
+   NetBuffer *buffer;
+   NicRxClassItem *item;
+
+#if (NET_MEM_RX_LOAN_SUPPORT == ENABLED)
+   //Allocate a memory buffer to hold the descriptor only
+   buffer = netBufferAlloc(sizeof(NicRxClassItem));
+
+   //Successful memory allocation?
+   if(buffer != NULL)
+   {
+      //Take over the driver buffer
+      if(!netBufferAcceptLoan(buffer, frame, length))
+      {
+         //Point to the descriptor
+         item = netBufferAt(buffer, 0, sizeof(NicRxClassItem));
+         item->buffer = buffer;
+         //The frame stays where the DMA wrote it
+         item->frame = frame;
+
+         //Return the descriptor
+         return item;
+      }
+
+      //The loan was refused
+      netBufferFree(buffer);
+   }
+#endif
+
+   //Allocate a memory buffer to hold the descriptor and the frame
+   buffer = netBufferAlloc(sizeof(NicRxClassItem) + length);
+   //Failed to allocate memory?
+   if(buffer == NULL)
+      return NULL;
+
+   //Point to the descriptor
+   item = netBufferAt(buffer, 0, sizeof(NicRxClassItem));
+   //The frame must be contiguous so that it can be processed in place
+   item->frame = netBufferAt(buffer, sizeof(NicRxClassItem), length);
+
+   //The frame does not fit in a single chunk?
+   if(item == NULL || item->frame == NULL)
+   {
+      //Clean up side effects
+      netBufferFree(buffer);
+      //Report an error
+      return NULL;
+   }
+
+   //Copy the frame
+   osMemcpy(item->frame, frame, length);
+   item->buffer = buffer;
+
+   //Return the descriptor
+   return item;
+}
+
+
+/**
+ * @brief Process the held frames of a class
+ * @param[in] queue Frames of the class
+ **/
+
+static void nicRxClassFlushQueue(NicRxClassQueue *queue)
+{
+   NicRxClassItem *item;
+
+   //Process the frames in arrival order
+   while(queue->head != NULL)
+   {
+      //Remove the first frame from the queue
+      item = queue->head;
+      queue->head = item->next;
+      queue->count--;
+
+      //Process the Ethernet frame
+      ethProcessFrame(item->interface, item->frame, item->length,
+         &item->ancillary);
+
+      //Release the frame (the descriptor is part of the buffer)
+      netBufferFree(item->buffer);
+   }
+
+   //The queue is now empty
+   queue->tail = NULL;
+   queue->count = 0;
+}
+
+
+/**
+ * @brief Hold a received frame if it belongs to a deferred class
+ *
+ * This function is called by nicProcessPacket for each Ethernet frame.
+ * Frames are only held while a batch is being delivered, and as long as
+ * at least one rule is defined
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] frame Incoming Ethernet frame
+ * @param[in] length Length of the frame
+ * @param[in] ancillary Additional options passed to the stack along with
+ *   the packet
+ * @return TRUE if the frame has been held, FALSE if it must be processed
+ *   right away
+ **/
+
+bool_t nicRxClassDeferFrame(NetInterface *interface, uint8_t *frame,
+   size_t length, NetRxAncillary *ancillary)
+{
+   uint_t classIndex;
+   NicRxClassQueue *queue;
+   NicRxClassItem *item;
+
+   //Frames are processed in their arrival order when no rule is defined or
+   //when the driver does not deliver frames in batches
+   if(nicRxClassRuleCount == 0 || !interface->nicRxBatch)
+      return FALSE;
+
+   //Determine the class of the frame
+   classIndex = nicRxClassifyFrame(frame, length);
+   //Update statistics
+   nicRxClassStats[classIndex].frames++;
+
+   //Frames of the highest priority class are never held
+   if(classIndex == 0)
+      return FALSE;
+
+   //Point to the queue of the class
+   queue = &nicRxClassQueues[classIndex];
+
+   //Make room for the frame, without reordering the class
+   if(queue->count >= NIC_RX_CLASS_QUEUE_SIZE)
+   {
+      nicRxClassFlushQueue(queue);
+   }
+
+   //Hold the frame
+   item = nicRxClassHoldFrame(frame, length);
+
+   //Failed to hold the frame?
+   if(item == NULL)
+   {
+      //The frames of the class received earlier must be processed first
+      nicRxClassFlushQueue(queue);
+      //Update statistics
+      nicRxClassStats[classIndex].direct++;
+
+      //The frame is processed right away
+      return FALSE;
+   }
+
+   //Save the context of the frame
+   item->next = NULL;
+   item->interface = interface;
+   item->length = length;
+   item->ancillary = *ancillary;
+
+   //Append the frame to the queue
+   if(queue->tail != NULL)
+   {
+      queue->tail->next = item;
+   }
+   else
+   {
+      queue->head = item;
+   }
+
+   //Update the queue
+   queue->tail = item;
+   queue->count++;
+
+   //Update statistics
+   nicRxClassStats[classIndex].deferred++;
+
+   //The frame will be processed at the end of the batch
+   return TRUE;
+}
+
+
+/**
+ * @brief Process the frames held during a batch
+ *
+ * Classes are processed in priority order. This function is called by
+ * nicEndRxBatch
+ **/
+
+void nicRxClassFlush(void)
+{
+   uint_t i;
+
+   //Loop through the deferred classes
+   for(i = 1; i < NIC_RX_CLASS_COUNT; i++)
+   {
+      //Process the frames of the current class
+      nicRxClassFlushQueue(&nicRxClassQueues[i]);
+   }
+}
+
+
+/**
+ * @brief Get the statistics of a class
+ * @param[in] classIndex Class index
+ * @param[out] stats Snapshot of the counters
+ * @return Error code
+ **/
+
+error_t nicRxClassGetStats(uint_t classIndex, NicRxClassStats *stats)
+{
+   //Check parameters
+   if(classIndex >= NIC_RX_CLASS_COUNT || stats == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Enter critical section
+   osSuspendAllTasks();
+   //Copy the counters
+   *stats = nicRxClassStats[classIndex];
+   //Exit critical section
+   osResumeAllTasks();
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+#endif
@@ -0,0 +1,152 @@
+/**
+ * @file nic_rx_class.h
+ * @brief Early classification of received frames
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+#ifndef _NIC_RX_CLASS_H
+#define _NIC_RX_CLASS_H
+
+//Dependencies
+#include "core/net.h"
+
+//Early classification of received frames
+#ifndef NIC_RX_CLASS_SUPPORT
+   #define NIC_RX_CLASS_SUPPORT DISABLED
+#elif (NIC_RX_CLASS_SUPPORT != ENABLED && NIC_RX_CLASS_SUPPORT != DISABLED)
+   #error NIC_RX_CLASS_SUPPORT parameter is not valid
+#endif
+
+//Frames can only be reordered within a batch
+#if (NIC_RX_CLASS_SUPPORT == ENABLED && NIC_RX_BATCH_SUPPORT == DISABLED)
+   #error NIC_RX_CLASS_SUPPORT requires NIC_RX_BATCH_SUPPORT
+#endif
+
+//Number of traffic classes (class 0 has the highest priority)
+#ifndef NIC_RX_CLASS_COUNT
+   #define NIC_RX_CLASS_COUNT 3
+#elif (NIC_RX_CLASS_COUNT < 2 || NIC_RX_CLASS_COUNT > 8)
+   #error NIC_RX_CLASS_COUNT parameter is not valid
+#endif
+
+//Class of the frames that match no rule
+#ifndef NIC_RX_CLASS_DEFAULT
+   #define NIC_RX_CLASS_DEFAULT 1
+#elif (NIC_RX_CLASS_DEFAULT >= NIC_RX_CLASS_COUNT)
+   #error NIC_RX_CLASS_DEFAULT parameter is not valid
+#endif
+
+//Maximum number of classification rules
+#ifndef NIC_RX_CLASS_RULE_COUNT
+   #define NIC_RX_CLASS_RULE_COUNT 8
+#elif (NIC_RX_CLASS_RULE_COUNT < 1)
+   #error NIC_RX_CLASS_RULE_COUNT parameter is not valid
+#endif
+
+//Maximum number of deferred frames per class
+#ifndef NIC_RX_CLASS_QUEUE_SIZE
+   #define NIC_RX_CLASS_QUEUE_SIZE 8
+#elif (NIC_RX_CLASS_QUEUE_SIZE < 1)
+   #error NIC_RX_CLASS_QUEUE_SIZE parameter is not valid
+#endif
+
+//Classification hook
+#if (NIC_RX_CLASS_SUPPORT == ENABLED)
+   #define NIC_RX_CLASS_DEFER_FRAME(interface, frame, length, ancillary) \
+      nicRxClassDeferFrame(interface, frame, length, ancillary)
+   #define NIC_RX_CLASS_FLUSH() nicRxClassFlush()
+#else
+   #define NIC_RX_CLASS_DEFER_FRAME(interface, frame, length, ancillary) FALSE
+   #define NIC_RX_CLASS_FLUSH()
+#endif
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Fields matched by a classification rule
+ **/
+
+typedef enum
+{
+   NIC_RX_CLASS_MATCH_ETH_TYPE    = 0x01,
+   NIC_RX_CLASS_MATCH_IP_PROTOCOL = 0x02,
+   NIC_RX_CLASS_MATCH_DEST_PORT   = 0x04,
+   NIC_RX_CLASS_MATCH_DSCP        = 0x08
+} NicRxClassMatch;
+
+
+/**
+ * @brief Classification rule
+ *
+ * A frame matches the rule when all the selected fields match. Rules are
+ * evaluated in the order they were added
+ **/
+
+typedef struct
+{
+   uint_t match;        ///<Fields to match (NIC_RX_CLASS_MATCH_xxx flags)
+   uint16_t ethType;    ///<EtherType, after any VLAN tag
+   uint8_t ipProtocol;  ///<IPv4 protocol or IPv6 next header
+   uint16_t destPort;   ///<TCP or UDP destination port
+   uint8_t dscp;        ///<Differentiated services code point
+   uint_t classIndex;   ///<Class assigned to the matching frames
+} NicRxClassRule;
+
+
+/**
+ * @brief Per-class statistics
+ **/
+
+typedef struct
+{
+   uint32_t frames;     ///<Frames assigned to the class
+   uint32_t deferred;   ///<Frames held until the end of their batch
+   uint32_t direct;     ///<Frames of a deferred class processed in place
+} NicRxClassStats;
+
+
+//Classification related functions
+error_t nicRxClassAddRule(const NicRxClassRule *rule);
+void nicRxClassClearRules(void);
+
+bool_t nicRxClassDeferFrame(NetInterface *interface, uint8_t *frame,
+   size_t length, NetRxAncillary *ancillary);
+
+void nicRxClassFlush(void);
+
+error_t nicRxClassGetStats(uint_t classIndex, NicRxClassStats *stats);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
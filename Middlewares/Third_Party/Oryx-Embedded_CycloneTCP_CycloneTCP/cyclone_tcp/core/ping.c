@@ -258,8 +258,17 @@ error_t pingSendRequest(PingContext *context,
 
       //ICMP Echo Request message
       message->type = ICMP_TYPE_ECHO_REQUEST;
-      //Message checksum calculation
-      message->checksum = ipCalcChecksum(message, length);
+
+      //The checksum is inserted by the NIC when offload is active
+      if(ipv4IsChecksumOffloadEnabled(interface, length))
+      {
+         message->checksum = 0;
+      }
+      else
+      {
+         //Message checksum calculation
+         message->checksum = ipCalcChecksum(message, length);
+      }
 
       //Open a raw socket
       context->socket = socketOpen(SOCKET_TYPE_RAW_IP, SOCKET_IP_PROTO_ICMP);
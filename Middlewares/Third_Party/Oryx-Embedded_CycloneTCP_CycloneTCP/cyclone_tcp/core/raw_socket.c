@@ -40,6 +40,7 @@
 #include "core/net.h"
 #include "core/socket.h"
 #include "core/socket_misc.h"
+#include "core/socket_poll.h"
 #include "core/raw_socket.h"
 #include "core/ethernet_misc.h"
 #include "ipv4/ipv4.h"
@@ -703,6 +704,11 @@ error_t rawSocketSendIpPacket(Socket *socket, const SocketMsg *message,
       ancillary.timestampId = message->timestampId;
 #endif
 
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+      //Time-triggered transmission
+      ancillary.launchTime = message->launchTime;
+#endif
+
       //Send raw IP datagram
       error = ipSendDatagram(interface, &pseudoHeader, buffer, offset,
          &ancillary);
@@ -790,6 +796,11 @@ error_t rawSocketSendEthPacket(Socket *socket, const SocketMsg *message,
          //Unique identifier for hardware time stamping
          ancillary.timestampId = message->timestampId;
 #endif
+
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+         //Time-triggered transmission
+         ancillary.launchTime = message->launchTime;
+#endif
          //Debug message
          TRACE_DEBUG("Sending raw Ethernet frame (%" PRIuSIZE " bytes)...\r\n", length);
 
@@ -834,18 +845,8 @@ error_t rawSocketReceiveIpPacket(Socket *socket, SocketMsg *message,
       //Check whether the receive queue is empty
       if(socket->receiveQueue == NULL)
       {
-         //Set the events the application is interested in
-         socket->eventMask = SOCKET_EVENT_RX_READY;
-
-         //Reset the event object
-         osResetEvent(&socket->event);
-
-         //Release exclusive access
-         osReleaseMutex(&netMutex);
          //Wait until an event is triggered
-         osWaitForEvent(&socket->event, socket->timeout);
-         //Get exclusive access
-         osAcquireMutex(&netMutex);
+         socketWaitForEvent(socket, SOCKET_EVENT_RX_READY, socket->timeout);
       }
    }
 
@@ -940,18 +941,8 @@ error_t rawSocketReceiveEthPacket(Socket *socket, SocketMsg *message,
       //Check whether the receive queue is empty
       if(socket->receiveQueue == NULL)
       {
-         //Set the events the application is interested in
-         socket->eventMask = SOCKET_EVENT_RX_READY;
-
-         //Reset the event object
-         osResetEvent(&socket->event);
-
-         //Release exclusive access
-         osReleaseMutex(&netMutex);
          //Wait until an event is triggered
-         osWaitForEvent(&socket->event, socket->timeout);
-         //Get exclusive access
-         osAcquireMutex(&netMutex);
+         socketWaitForEvent(socket, SOCKET_EVENT_RX_READY, socket->timeout);
       }
    }
 
@@ -1046,6 +1037,11 @@ void rawSocketUpdateEvents(Socket *socket)
       }
    }
 
+#if (SOCKET_POLL_SUPPORT == ENABLED)
+   //Queue the socket on the ready list of its poll set, if any
+   socketPollUpdate(socket, socket->eventFlags);
+#endif
+
    //Mask unused events
    socket->eventFlags &= socket->eventMask;
 
@@ -1054,6 +1050,7 @@ void rawSocketUpdateEvents(Socket *socket)
    {
       //Unblock I/O operations currently in waiting state
       osSetEvent(&socket->event);
+      socketNotifyWaiters(socket);
 
       //Set user event to signaled state if necessary
       if(socket->userEvent != NULL)
@@ -35,18 +35,52 @@
 #include "core/net.h"
 #include "core/socket.h"
 #include "core/socket_misc.h"
+#include "core/socket_poll.h"
 #include "core/raw_socket.h"
 #include "core/udp.h"
 #include "core/tcp.h"
 #include "core/tcp_misc.h"
+#include "core/tcp_timer.h"
+#include "core/tcp_congest.h"
 #include "dns/dns_client.h"
 #include "mdns/mdns_client.h"
 #include "netbios/nbns_client.h"
 #include "llmnr/llmnr_client.h"
 #include "debug.h"
 
+//IAR EWARM compiler?
+#if defined(__ICCARM__) && defined(SOCKET_TABLE_SECTION)
 //Socket table
+#pragma location = SOCKET_TABLE_SECTION
 Socket socketTable[SOCKET_MAX_COUNT];
+//Keil MDK-ARM or GCC compiler?
+#elif defined(SOCKET_TABLE_SECTION)
+//Socket table
+Socket socketTable[SOCKET_MAX_COUNT]
+   __attribute__((__section__(SOCKET_TABLE_SECTION)));
+//Default data section
+#else
+//Socket table
+Socket socketTable[SOCKET_MAX_COUNT];
+#endif
+
+#if (TCP_SUPPORT == ENABLED)
+//IAR EWARM compiler?
+#if defined(__ICCARM__) && defined(SOCKET_TABLE_SECTION)
+//TCP control blocks
+#pragma location = SOCKET_TABLE_SECTION
+TcpControlBlock tcpControlBlockTable[SOCKET_MAX_TCP_COUNT];
+//Keil MDK-ARM or GCC compiler?
+#elif defined(SOCKET_TABLE_SECTION)
+//TCP control blocks
+TcpControlBlock tcpControlBlockTable[SOCKET_MAX_TCP_COUNT]
+   __attribute__((__section__(SOCKET_TABLE_SECTION)));
+//Default data section
+#else
+//TCP control blocks
+TcpControlBlock tcpControlBlockTable[SOCKET_MAX_TCP_COUNT];
+#endif
+#endif
 
 //Default socket message
 const SocketMsg SOCKET_DEFAULT_MSG =
@@ -74,6 +108,15 @@ const SocketMsg SOCKET_DEFAULT_MSG =
    -1,            //Unique identifier for hardware time stamping
    {0},           //Captured time stamp
 #endif
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+   {0},           //PTP time at which the datagram is sent
+#endif
+#if (NIC_TX_DEADLINE_SUPPORT == ENABLED)
+   0,             //Time past which the datagram is dropped
+#endif
+#if (NIC_RX_TIME_SUPPORT == ENABLED)
+   0,             //Time the datagram was received
+#endif
 };
 
 
@@ -90,6 +133,11 @@ error_t socketInit(void)
    //Initialize socket descriptors
    osMemset(socketTable, 0, sizeof(socketTable));
 
+#if (TCP_SUPPORT == ENABLED)
+   //Initialize TCP control blocks
+   osMemset(tcpControlBlockTable, 0, sizeof(tcpControlBlockTable));
+#endif
+
    //Loop through socket descriptors
    for(i = 0; i < SOCKET_MAX_COUNT; i++)
    {
@@ -103,11 +151,37 @@ error_t socketInit(void)
          for(j = 0; j < i; j++)
          {
             osDeleteEvent(&socketTable[j].event);
+#if (SOCKET_LOCK_SUPPORT == ENABLED)
+            osDeleteMutex(&socketTable[j].mutex);
+#endif
+         }
+
+         //Report an error
+         return ERROR_OUT_OF_RESOURCES;
+      }
+
+#if (SOCKET_LOCK_SUPPORT == ENABLED)
+      //Create a mutex to serialize data-path operations on the socket
+      if(!osCreateMutex(&socketTable[i].mutex))
+      {
+         //Clean up side effects
+         osDeleteEvent(&socketTable[i].event);
+
+         for(j = 0; j < i; j++)
+         {
+            osDeleteEvent(&socketTable[j].event);
+            osDeleteMutex(&socketTable[j].mutex);
          }
 
          //Report an error
          return ERROR_OUT_OF_RESOURCES;
       }
+
+#if (OS_MUTEX_STATS_SUPPORT == ENABLED)
+      //The locks of all the sockets are measured together
+      osSetMutexStats(&socketTable[i].mutex, &netContext.socketLockStats);
+#endif
+#endif
    }
 
    //Successful initialization
@@ -242,6 +316,44 @@ error_t socketSetDscp(Socket *socket, uint8_t dscp)
 }
 
 
+/**
+ * @brief Limit the rate at which a socket sends data
+ *
+ * The payload is shaped by a token bucket that holds a burst of bytes and
+ * is refilled at the given rate. TCP segments are held back until the bucket
+ * allows them. UDP datagrams wait for it within the socket timeout, and are
+ * refused with ERROR_WOULD_BLOCK otherwise. The traffic class of the socket
+ * may have a rate limit of its own (refer to netShaperSetClassRate)
+ *
+ * @param[in] socket Handle to a socket
+ * @param[in] rate Sustained rate, in bytes per second (0 to remove the limit)
+ * @param[in] burst Depth of the bucket, in bytes (0 for the smallest one)
+ * @return Error code
+ **/
+
+error_t socketSetRateLimit(Socket *socket, uint32_t rate, uint32_t burst)
+{
+#if (NET_SHAPER_SUPPORT == ENABLED)
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Reconfigure the bucket of the socket, starting full
+   netShaperInitBucket(&socket->shaper, rate, burst);
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //No error to report
+   return NO_ERROR;
+#else
+   //Not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
 /**
  * @brief Set VLAN priority
  * @param[in] socket Handle to a socket
@@ -416,6 +528,44 @@ error_t socketEnableBroadcast(Socket *socket, bool_t enabled)
 }
 
 
+/**
+ * @brief Share the local port with other sockets
+ *
+ * A multicast or broadcast datagram received on a port shared by several
+ * sockets is delivered to each of them rather than to the first match
+ *
+ * @param[in] socket Handle to a socket
+ * @param[in] enabled Specifies whether the local port is shared
+ * @return Error code
+ **/
+
+error_t socketEnableReusePort(Socket *socket, bool_t enabled)
+{
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Check whether the local port is shared
+   if(enabled)
+   {
+      socket->options |= SOCKET_OPTION_REUSE_PORT;
+   }
+   else
+   {
+      socket->options &= ~SOCKET_OPTION_REUSE_PORT;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
 /**
  * @brief Join the specified host group
  * @param[in] socket Handle to a socket
@@ -1077,6 +1227,10 @@ error_t socketEnableKeepAlive(Socket *socket, bool_t enabled)
    if(socket == NULL)
       return ERROR_INVALID_PARAMETER;
 
+   //This function is only applicable to TCP sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+      return ERROR_INVALID_PARAMETER;
+
    //Get exclusive access
    osAcquireMutex(&netMutex);
 
@@ -1084,18 +1238,21 @@ error_t socketEnableKeepAlive(Socket *socket, bool_t enabled)
    if(enabled)
    {
       //Enable TCP keep-alive mechanism
-      socket->keepAliveEnabled = TRUE;
+      socket->tcb->keepAliveEnabled = TRUE;
       //Reset keep-alive probe counter
-      socket->keepAliveProbeCount = 0;
+      socket->tcb->keepAliveProbeCount = 0;
       //Start keep-alive timer
-      socket->keepAliveTimestamp = osGetSystemTime();
+      socket->tcb->keepAliveTimestamp = osGetSystemTime();
    }
    else
    {
       //Disable TCP keep-alive mechanism
-      socket->keepAliveEnabled = FALSE;
+      socket->tcb->keepAliveEnabled = FALSE;
    }
 
+   //Update the deadline of the keep-alive timer
+   tcpScheduleTimers(socket);
+
    //Release exclusive access
    osReleaseMutex(&netMutex);
 
@@ -1109,38 +1266,40 @@ error_t socketEnableKeepAlive(Socket *socket, bool_t enabled)
 
 
 /**
- * @brief Set TCP keep-alive parameters
+ * @brief Enable TCP quick ACK mode
+ *
+ * In quick ACK mode, every data segment is acknowledged immediately instead
+ * of waiting for outgoing data to carry the ACK
+ *
  * @param[in] socket Handle to a socket
- * @param[in] idle Time interval between last data packet sent and first
- *   keep-alive probe
- * @param[in] interval Time interval between subsequent keep-alive probes
- * @param[in] maxProbes Number of unacknowledged keep-alive probes to send before
- *   considering the connection is dead
+ * @param[in] enabled Specifies whether quick ACK mode is enabled
  * @return Error code
  **/
 
-error_t socketSetKeepAliveParams(Socket *socket, systime_t idle,
-   systime_t interval, uint_t maxProbes)
+error_t socketEnableQuickAck(Socket *socket, bool_t enabled)
 {
-#if (TCP_SUPPORT == ENABLED && TCP_KEEP_ALIVE_SUPPORT == ENABLED)
-   //Check parameters
-   if(socket == NULL || idle == 0 || interval == 0 || maxProbes == 0)
-   {
+#if (TCP_SUPPORT == ENABLED && TCP_DELAYED_ACK_SUPPORT == ENABLED)
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //This function is only applicable to TCP sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
       return ERROR_INVALID_PARAMETER;
-   }
 
    //Get exclusive access
    osAcquireMutex(&netMutex);
 
-   //Time interval between last data packet sent and first keep-alive probe
-   socket->keepAliveIdle = idle;
-
-   //Time interval between subsequent keep-alive probes
-   socket->keepAliveInterval = interval;
+   //Save the ACK mode
+   socket->tcb->quickAck = enabled;
 
-   //Number of unacknowledged keep-alive probes to send before considering
-   //the connection is dead
-   socket->keepAliveMaxProbes = maxProbes;
+   //Any ACK currently delayed?
+   if(enabled && socket->tcb->delayedAckBytes > 0)
+   {
+      //Acknowledge the received data without further delay
+      tcpSendSegment(socket, TCP_FLAG_ACK, socket->tcb->sndNxt, socket->tcb->rcvNxt, 0,
+         FALSE);
+   }
 
    //Release exclusive access
    osReleaseMutex(&netMutex);
@@ -1155,175 +1314,702 @@ error_t socketSetKeepAliveParams(Socket *socket, systime_t idle,
 
 
 /**
- * @brief Specify the maximum segment size for outgoing TCP packets
+ * @brief Enable or disable the Nagle algorithm
+ *
+ * When TCP_NODELAY is set, data is sent as soon as possible instead of
+ * being coalesced while previously sent data is unacknowledged
+ *
  * @param[in] socket Handle to a socket
- * @param[in] mss Maximum segment size, in bytes
+ * @param[in] enabled Specifies whether the Nagle algorithm is disabled
  * @return Error code
  **/
 
-error_t socketSetMaxSegmentSize(Socket *socket, size_t mss)
+error_t socketEnableNoDelay(Socket *socket, bool_t enabled)
 {
 #if (TCP_SUPPORT == ENABLED)
    //Make sure the socket handle is valid
    if(socket == NULL)
       return ERROR_INVALID_PARAMETER;
 
+   //This function is only applicable to TCP sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+      return ERROR_INVALID_PARAMETER;
+
    //Get exclusive access
    osAcquireMutex(&netMutex);
 
-   //TCP imposes its minimum and maximum bounds over the value provided
-   mss = MIN(mss, TCP_MAX_MSS);
-   mss = MAX(mss, TCP_MIN_MSS);
+   //Update socket options
+   if(enabled)
+   {
+      socket->options |= SOCKET_OPTION_TCP_NO_DELAY;
+   }
+   else
+   {
+      socket->options &= ~SOCKET_OPTION_TCP_NO_DELAY;
+   }
 
-   //Set the maximum segment size for outgoing TCP packets. If this option
-   //is set before connection establishment, it also change the MSS value
-   //announced to the other end in the initial SYN packet
-   socket->mss = mss;
+   //Data held back by the Nagle algorithm can now be sent
+   if(enabled && socket->tcb->state != TCP_STATE_CLOSED)
+   {
+      tcpNagleAlgo(socket, SOCKET_FLAG_NO_DELAY);
+   }
 
    //Release exclusive access
    osReleaseMutex(&netMutex);
 
-   //No error to report
+   //Successful processing
    return NO_ERROR;
 #else
+   //Not implemented
    return ERROR_NOT_IMPLEMENTED;
 #endif
 }
 
 
 /**
- * @brief Specify the size of the TCP send buffer
+ * @brief Cork or uncork a TCP socket
+ *
+ * While a socket is corked, small writes are coalesced and only full-sized
+ * segments are sent. Pending data is flushed when the socket is uncorked or
+ * when TCP_CORK_TIMEOUT elapses
+ *
  * @param[in] socket Handle to a socket
- * @param[in] size Desired buffer size, in bytes
+ * @param[in] enabled Specifies whether the socket is corked
  * @return Error code
  **/
 
-error_t socketSetTxBufferSize(Socket *socket, size_t size)
+error_t socketEnableCork(Socket *socket, bool_t enabled)
 {
 #if (TCP_SUPPORT == ENABLED)
    //Make sure the socket handle is valid
    if(socket == NULL)
       return ERROR_INVALID_PARAMETER;
 
-   //This function shall be used with connection-oriented sockets
+   //This function is only applicable to TCP sockets
    if(socket->type != SOCKET_TYPE_STREAM)
-      return ERROR_INVALID_SOCKET;
+      return ERROR_INVALID_PARAMETER;
 
-   //The buffer size cannot be changed when the connection is established
-   if(tcpGetState(socket) != TCP_STATE_CLOSED)
-      return ERROR_INVALID_SOCKET;
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
 
-   //Check parameter value
-   if(size < 1 || size > TCP_MAX_TX_BUFFER_SIZE)
-      return ERROR_INVALID_PARAMETER;
+   //Update socket options
+   if(enabled)
+   {
+      socket->options |= SOCKET_OPTION_TCP_CORK;
+   }
+   else
+   {
+      socket->options &= ~SOCKET_OPTION_TCP_CORK;
 
-   //Use the specified buffer size
-   socket->txBufferSize = size;
+      //Flush the partial segment left behind, if any
+      if(socket->tcb->state != TCP_STATE_CLOSED)
+      {
+         tcpNagleAlgo(socket, SOCKET_FLAG_NO_DELAY);
+      }
+   }
 
-   //No error to report
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
    return NO_ERROR;
 #else
+   //Not implemented
    return ERROR_NOT_IMPLEMENTED;
 #endif
 }
 
 
 /**
- * @brief Specify the size of the TCP receive buffer
+ * @brief Enable TCP Fast Open
+ *
+ * When a cookie is cached for the server, socketConnect returns at once and
+ * the SYN segment is only sent with the first data written to the socket
+ *
  * @param[in] socket Handle to a socket
- * @param[in] size Desired buffer size, in bytes
+ * @param[in] enabled Specifies whether Fast Open is attempted on connection
  * @return Error code
  **/
 
-error_t socketSetRxBufferSize(Socket *socket, size_t size)
+error_t socketEnableFastOpen(Socket *socket, bool_t enabled)
 {
-#if (TCP_SUPPORT == ENABLED)
+#if (TCP_SUPPORT == ENABLED && TCP_FAST_OPEN_SUPPORT == ENABLED)
    //Make sure the socket handle is valid
    if(socket == NULL)
       return ERROR_INVALID_PARAMETER;
 
-   //This function shall be used with connection-oriented sockets
-   if(socket->type != SOCKET_TYPE_STREAM)
-      return ERROR_INVALID_SOCKET;
-
-   //The buffer size cannot be changed when the connection is established
-   if(tcpGetState(socket) != TCP_STATE_CLOSED)
-      return ERROR_INVALID_SOCKET;
-
-   //Check parameter value
-   if(size < 1 || size > TCP_MAX_RX_BUFFER_SIZE)
-      return ERROR_INVALID_PARAMETER;
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
 
-   //Use the specified buffer size
-   socket->rxBufferSize = size;
+   //Update socket options
+   if(enabled)
+   {
+      socket->options |= SOCKET_OPTION_TCP_FAST_OPEN;
+   }
+   else
+   {
+      socket->options &= ~SOCKET_OPTION_TCP_FAST_OPEN;
+   }
 
-   //Compute the window scale factor to use for the receive window
-   tcpComputeWindowScaleFactor(socket);
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
 
-   //No error to report
+   //Successful processing
    return NO_ERROR;
 #else
+   //Not implemented
    return ERROR_NOT_IMPLEMENTED;
 #endif
 }
 
 
 /**
- * @brief Bind a socket to a particular network interface
+ * @brief Retrieve TCP connection information
+ *
+ * The state of the connection is copied while holding the netMutex, so that
+ * the snapshot is consistent; the connection keeps running meanwhile
+ *
  * @param[in] socket Handle to a socket
- * @param[in] interface Network interface to be used
+ * @param[out] info Round-trip time estimator, congestion state, windows,
+ *   queued data and negotiated options
  * @return Error code
  **/
 
-error_t socketSetInterface(Socket *socket, NetInterface *interface)
+error_t socketGetTcpInfo(Socket *socket, SocketTcpInfo *info)
 {
-   //Make sure the socket handle is valid
-   if(socket == NULL)
+#if (TCP_SUPPORT == ENABLED)
+   //Check parameters
+   if(socket == NULL || info == NULL)
       return ERROR_INVALID_PARAMETER;
 
-   //Explicitly associate the socket with the specified interface
-   socket->interface = interface;
+   //This function is only applicable to TCP sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+      return ERROR_INVALID_PARAMETER;
 
-   //No error to report
-   return NO_ERROR;
-}
+   //Clear structure
+   osMemset(info, 0, sizeof(SocketTcpInfo));
 
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
 
-/**
- * @brief Retrieve the underlying interface
- * @param[in] socket Handle to a socket
- * @return Pointer to the underlying network interface
- **/
+   //Connection state and segment sizes
+   info->state = socket->tcb->state;
+   info->smss = socket->tcb->smss;
+   info->rmss = socket->tcb->rmss;
 
-NetInterface *socketGetInterface(Socket *socket)
-{
-   NetInterface *interface = NULL;
+   //Round-trip time estimator
+   info->srtt = socket->tcb->srtt;
+   info->rttvar = socket->tcb->rttvar;
+   info->rttSample = socket->tcb->rttSample;
+   info->rto = socket->tcb->rto;
+   info->retransmitCount = socket->tcb->retransmitCount;
+   info->retransmitTotal = socket->tcb->retransmitTotal;
 
-   //Make sure the socket handle is valid
-   if(socket != NULL)
+#if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
+   //Congestion control state
+   info->cwnd = socket->tcb->cwnd;
+   info->ssthresh = socket->tcb->ssthresh;
+   info->congestState = socket->tcb->congestState;
+   info->dupAckCount = socket->tcb->dupAckCount;
+
+   //Algorithm attached to the connection
+   if(socket->tcb->congestAlgo != NULL)
    {
-      interface = socket->interface;
+      info->congestAlgo = socket->tcb->congestAlgo->name;
    }
+#endif
 
-   //Return a pointer to the underlying network interface
-   return interface;
-}
-
+   //Current windows
+   info->sndWnd = socket->tcb->sndWnd;
+   info->rcvWnd = socket->tcb->rcvWnd;
 
-/**
- * @brief Associate a local address with a socket
- * @param[in] socket Handle to a socket
- * @param[in] localIpAddr Local address to assign to the bound socket
- * @param[in] localPort Local port number to assign to the bound socket
- * @return Error code
- **/
+   //Data queued in the send and receive buffers
+   info->unacked = socket->tcb->sndNxt - socket->tcb->sndUna;
+   info->sndQueue = socket->tcb->sndUser;
+   info->rcvQueue = socket->tcb->rcvUser;
+   info->txBufferSize = socket->tcb->txBufferSize;
+   info->rxBufferSize = socket->tcb->rxBufferSize;
 
-error_t socketBind(Socket *socket, const IpAddr *localIpAddr,
-   uint16_t localPort)
-{
-   //Check input parameters
-   if(socket == NULL || localIpAddr == NULL)
-      return ERROR_INVALID_PARAMETER;
+#if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
+   //Window scaling is in use when both ends sent the option
+   info->wndScale = socket->tcb->wndScaleOptionReceived;
+
+   //Scale factors of the windows
+   if(info->wndScale)
+   {
+      info->sndWndShift = socket->tcb->sndWndShift;
+      info->rcvWndShift = socket->tcb->rcvWndShift;
+   }
+#endif
+
+#if (TCP_SACK_SUPPORT == ENABLED)
+   //SACK is in use when the peer sent the SACK Permitted option
+   info->sack = socket->tcb->sackPermitted;
+#endif
+
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   //Timestamps negotiated during the handshake
+   info->timestamps = socket->tcb->tsEnabled;
+#endif
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+#else
+   //Not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Set TCP keep-alive parameters
+ * @param[in] socket Handle to a socket
+ * @param[in] idle Time interval between last data packet sent and first
+ *   keep-alive probe
+ * @param[in] interval Time interval between subsequent keep-alive probes
+ * @param[in] maxProbes Number of unacknowledged keep-alive probes to send before
+ *   considering the connection is dead
+ * @return Error code
+ **/
+
+error_t socketSetKeepAliveParams(Socket *socket, systime_t idle,
+   systime_t interval, uint_t maxProbes)
+{
+#if (TCP_SUPPORT == ENABLED && TCP_KEEP_ALIVE_SUPPORT == ENABLED)
+   //Check parameters
+   if(socket == NULL || idle == 0 || interval == 0 || maxProbes == 0)
+   {
+      return ERROR_INVALID_PARAMETER;
+   }
+
+   //This function is only applicable to TCP sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Time interval between last data packet sent and first keep-alive probe
+   socket->tcb->keepAliveIdle = idle;
+
+   //Time interval between subsequent keep-alive probes
+   socket->tcb->keepAliveInterval = interval;
+
+   //Number of unacknowledged keep-alive probes to send before considering
+   //the connection is dead
+   socket->tcb->keepAliveMaxProbes = maxProbes;
+
+   //Update the deadline of the keep-alive timer
+   tcpScheduleTimers(socket);
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+#else
+   //Not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Select the TCP congestion control algorithm
+ * @param[in] socket Handle to a socket
+ * @param[in] algo Congestion control algorithm (Reno, CUBIC or BBR-lite)
+ * @return Error code
+ **/
+
+error_t socketSetCongestionControl(Socket *socket, TcpCongestAlgoType algo)
+{
+#if (TCP_SUPPORT == ENABLED && TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
+   error_t error;
+
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //This function shall be used with connection-oriented sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+      return ERROR_INVALID_SOCKET;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //The algorithm can be changed at any time, the congestion window and
+   //ssthresh are left unchanged
+   error = tcpSetCongestAlgo(socket, algo);
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return status code
+   return error;
+#else
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Specify the maximum segment size for outgoing TCP packets
+ * @param[in] socket Handle to a socket
+ * @param[in] mss Maximum segment size, in bytes
+ * @return Error code
+ **/
+
+error_t socketSetMaxSegmentSize(Socket *socket, size_t mss)
+{
+#if (TCP_SUPPORT == ENABLED)
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //This function is only applicable to TCP sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //TCP imposes its minimum and maximum bounds over the value provided
+   mss = MIN(mss, TCP_MAX_MSS);
+   mss = MAX(mss, TCP_MIN_MSS);
+
+   //Set the maximum segment size for outgoing TCP packets. If this option
+   //is set before connection establishment, it also change the MSS value
+   //announced to the other end in the initial SYN packet
+   socket->tcb->mss = mss;
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //No error to report
+   return NO_ERROR;
+#else
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Enable or disable the large buffer mode of a TCP socket
+ *
+ * Sockets operating in large buffer mode draw their TX and RX buffers from a
+ * dedicated pool and may use buffers up to TCP_LARGE_BUFFER_MAX_SIZE bytes.
+ * Window scaling is only negotiated for these sockets
+ *
+ * @param[in] socket Handle to a socket
+ * @param[in] enabled Specifies whether the large buffer mode is enabled
+ * @return Error code
+ **/
+
+error_t socketEnableLargeBuffers(Socket *socket, bool_t enabled)
+{
+#if (TCP_SUPPORT == ENABLED && TCP_LARGE_BUFFER_SUPPORT == ENABLED)
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //This function shall be used with connection-oriented sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+      return ERROR_INVALID_SOCKET;
+
+   //The buffer mode cannot be changed when the connection is established
+   if(tcpGetState(socket) != TCP_STATE_CLOSED)
+      return ERROR_INVALID_SOCKET;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Save the buffer mode
+   socket->tcb->largeBuffers = enabled;
+
+   //Regular sockets are limited to the regular maximum buffer sizes
+   if(!enabled)
+   {
+      socket->tcb->txBufferSize = MIN(socket->tcb->txBufferSize, TCP_MAX_TX_BUFFER_SIZE);
+      socket->tcb->rxBufferSize = MIN(socket->tcb->rxBufferSize, TCP_MAX_RX_BUFFER_SIZE);
+
+      //Compute the window scale factor to use for the receive window
+      tcpComputeWindowScaleFactor(socket);
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //No error to report
+   return NO_ERROR;
+#else
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Specify the size of the TCP send buffer
+ *
+ * Setting the size of the buffer disables its auto-tuning
+ *
+ * @param[in] socket Handle to a socket
+ * @param[in] size Desired buffer size, in bytes
+ * @return Error code
+ **/
+
+error_t socketSetTxBufferSize(Socket *socket, size_t size)
+{
+#if (TCP_SUPPORT == ENABLED)
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //This function shall be used with connection-oriented sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+      return ERROR_INVALID_SOCKET;
+
+   //The buffer size cannot be changed when the connection is established
+   if(tcpGetState(socket) != TCP_STATE_CLOSED)
+      return ERROR_INVALID_SOCKET;
+
+#if (TCP_LARGE_BUFFER_SUPPORT == ENABLED)
+   //Check parameter value
+   if(size < 1 || size > (socket->tcb->largeBuffers ? TCP_LARGE_BUFFER_MAX_SIZE :
+      TCP_MAX_TX_BUFFER_SIZE))
+   {
+      return ERROR_INVALID_PARAMETER;
+   }
+#else
+   //Check parameter value
+   if(size < 1 || size > TCP_MAX_TX_BUFFER_SIZE)
+      return ERROR_INVALID_PARAMETER;
+#endif
+
+   //Use the specified buffer size
+   socket->tcb->txBufferSize = size;
+
+#if (TCP_AUTO_TUNE_SUPPORT == ENABLED)
+   //The size of the send buffer is set by the user
+   socket->tcb->autoTune.txEnabled = FALSE;
+#endif
+
+   //No error to report
+   return NO_ERROR;
+#else
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Specify the size of the TCP receive buffer
+ *
+ * Setting the size of the buffer disables its auto-tuning
+ *
+ * @param[in] socket Handle to a socket
+ * @param[in] size Desired buffer size, in bytes
+ * @return Error code
+ **/
+
+error_t socketSetRxBufferSize(Socket *socket, size_t size)
+{
+#if (TCP_SUPPORT == ENABLED)
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //This function shall be used with connection-oriented sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+      return ERROR_INVALID_SOCKET;
+
+   //The buffer size cannot be changed when the connection is established
+   if(tcpGetState(socket) != TCP_STATE_CLOSED)
+      return ERROR_INVALID_SOCKET;
+
+#if (TCP_LARGE_BUFFER_SUPPORT == ENABLED)
+   //Check parameter value
+   if(size < 1 || size > (socket->tcb->largeBuffers ? TCP_LARGE_BUFFER_MAX_SIZE :
+      TCP_MAX_RX_BUFFER_SIZE))
+   {
+      return ERROR_INVALID_PARAMETER;
+   }
+#else
+   //Check parameter value
+   if(size < 1 || size > TCP_MAX_RX_BUFFER_SIZE)
+      return ERROR_INVALID_PARAMETER;
+#endif
+
+   //Use the specified buffer size
+   socket->tcb->rxBufferSize = size;
+
+#if (TCP_AUTO_TUNE_SUPPORT == ENABLED)
+   //The size of the receive buffer is set by the user
+   socket->tcb->autoTune.rxEnabled = FALSE;
+#endif
+
+   //Compute the window scale factor to use for the receive window
+   tcpComputeWindowScaleFactor(socket);
+
+   //No error to report
+   return NO_ERROR;
+#else
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Set the low watermark of the TCP send buffer
+ *
+ * The socket becomes writable once the specified number of bytes is free
+ * in the send buffer, so that the application hands over its data in
+ * larger pieces. The default value of 1 byte is restored with 0
+ *
+ * @param[in] socket Handle to a socket
+ * @param[in] size Free space, in bytes (capped at the size of the buffer)
+ * @return Error code
+ **/
+
+error_t socketSetTxLowWatermark(Socket *socket, size_t size)
+{
+#if (TCP_SUPPORT == ENABLED)
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //This function shall be used with connection-oriented sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+      return ERROR_INVALID_SOCKET;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Save the low watermark
+   socket->tcb->txLowWatermark = size;
+
+   //The watermark may be changed while the connection is open
+   if(socket->tcb->state != TCP_STATE_CLOSED && socket->tcb->state != TCP_STATE_LISTEN)
+   {
+      tcpUpdateEvents(socket);
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //No error to report
+   return NO_ERROR;
+#else
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Set the low watermark of the TCP receive buffer
+ *
+ * The socket becomes readable once the specified number of bytes has been
+ * received, or the peer has closed the connection, so that tiny reads do
+ * not wake up the application for every segment. A read whose wait expires
+ * returns the data on hand. The default value of 1 byte is restored with 0
+ *
+ * @param[in] socket Handle to a socket
+ * @param[in] size Buffered data, in bytes (capped at the size of the buffer)
+ * @return Error code
+ **/
+
+error_t socketSetRxLowWatermark(Socket *socket, size_t size)
+{
+#if (TCP_SUPPORT == ENABLED)
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //This function shall be used with connection-oriented sockets
+   if(socket->type != SOCKET_TYPE_STREAM)
+      return ERROR_INVALID_SOCKET;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Save the low watermark
+   socket->tcb->rxLowWatermark = size;
+
+   //The watermark may be changed while the connection is open
+   if(socket->tcb->state != TCP_STATE_CLOSED && socket->tcb->state != TCP_STATE_LISTEN)
+   {
+      tcpUpdateEvents(socket);
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //No error to report
+   return NO_ERROR;
+#else
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Bind a socket to a particular network interface
+ * @param[in] socket Handle to a socket
+ * @param[in] interface Network interface to be used
+ * @return Error code
+ **/
+
+error_t socketSetInterface(Socket *socket, NetInterface *interface)
+{
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Explicitly associate the socket with the specified interface
+   socket->interface = interface;
+   //The endpoints of the socket have changed
+   socketHashEvict(socket);
+
+   //No error to report
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Retrieve the underlying interface
+ * @param[in] socket Handle to a socket
+ * @return Pointer to the underlying network interface
+ **/
+
+NetInterface *socketGetInterface(Socket *socket)
+{
+   NetInterface *interface = NULL;
+
+   //Make sure the socket handle is valid
+   if(socket != NULL)
+   {
+      interface = socket->interface;
+   }
+
+   //Return a pointer to the underlying network interface
+   return interface;
+}
+
+
+/**
+ * @brief Associate a local address with a socket
+ * @param[in] socket Handle to a socket
+ * @param[in] localIpAddr Local address to assign to the bound socket
+ * @param[in] localPort Local port number to assign to the bound socket
+ * @return Error code
+ **/
+
+error_t socketBind(Socket *socket, const IpAddr *localIpAddr,
+   uint16_t localPort)
+{
+   //Check input parameters
+   if(socket == NULL || localIpAddr == NULL)
+      return ERROR_INVALID_PARAMETER;
 
    //Make sure the socket type is correct
    if(socket->type != SOCKET_TYPE_STREAM &&
@@ -1336,6 +2022,8 @@ error_t socketBind(Socket *socket, const IpAddr *localIpAddr,
    //Associate the specified IP address and port number
    socket->localIpAddr = *localIpAddr;
    socket->localPort = localPort;
+   //The endpoints of the socket have changed
+   socketHashEvict(socket);
 
    //No error to report
    return NO_ERROR;
@@ -1381,6 +2069,8 @@ error_t socketConnect(Socket *socket, const IpAddr *remoteIpAddr,
       //Save port number and IP address of the remote host
       socket->remoteIpAddr = *remoteIpAddr;
       socket->remotePort = remotePort;
+      //The endpoints of the socket have changed
+      socketHashEvict(socket);
       //No error to report
       error = NO_ERROR;
    }
@@ -1524,8 +2214,8 @@ error_t socketSendTo(Socket *socket, const IpAddr *destIpAddr, uint16_t destPort
    if(socket == NULL)
       return ERROR_INVALID_PARAMETER;
 
-   //Get exclusive access
-   osAcquireMutex(&netMutex);
+   //Get exclusive access to the socket and to the stack
+   socketAcquireLock(socket);
 
 #if (TCP_SUPPORT == ENABLED)
    //Connection-oriented socket?
@@ -1613,75 +2303,217 @@ error_t socketSendTo(Socket *socket, const IpAddr *destIpAddr, uint16_t destPort
          error = ERROR_INVALID_SOCKET;
       }
 
-      //Check status code
-      if(!error)
-      {
-         //Total number of data bytes successfully transmitted
-         if(written != NULL)
-         {
-            *written = message.length;
-         }
-      }
-   }
+      //Check status code
+      if(!error)
+      {
+         //Total number of data bytes successfully transmitted
+         if(written != NULL)
+         {
+            *written = message.length;
+         }
+      }
+   }
+
+   //Release exclusive access
+   socketReleaseLock(socket);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Send a message
+ * @param[in] socket Handle that identifies a socket
+ * @param[in] message Pointer to the structure describing the message
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t socketSendMsg(Socket *socket, const SocketMsg *message, uint_t flags)
+{
+   error_t error;
+
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access to the socket and to the stack
+   socketAcquireLock(socket);
+
+#if (TCP_SUPPORT == ENABLED)
+   //Connection-oriented socket?
+   if(socket->type == SOCKET_TYPE_STREAM)
+   {
+      //The data is appended to the stream. SOCKET_FLAG_MORE can be used to
+      //coalesce several messages into full-sized segments
+      error = tcpSend(socket, message->data, message->length, NULL, flags);
+   }
+   else
+#endif
+#if (UDP_SUPPORT == ENABLED)
+   //Connectionless socket?
+   if(socket->type == SOCKET_TYPE_DGRAM)
+   {
+      //Send UDP datagram
+      error = udpSendDatagram(socket, message, flags);
+   }
+   else
+#endif
+#if (RAW_SOCKET_SUPPORT == ENABLED)
+   //Raw socket?
+   if(socket->type == SOCKET_TYPE_RAW_IP)
+   {
+      //Send a raw IP packet
+      error = rawSocketSendIpPacket(socket, message, flags);
+   }
+   else if(socket->type == SOCKET_TYPE_RAW_ETH)
+   {
+      //Send a raw Ethernet packet
+      error = rawSocketSendEthPacket(socket, message, flags);
+   }
+   else
+#endif
+   //Invalid socket type?
+   {
+      //Report an error
+      error = ERROR_INVALID_SOCKET;
+   }
+
+   //Release exclusive access
+   socketReleaseLock(socket);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Send a datagram whose payload is loaned by the application
+ *
+ * Unlike socketSendMsg(), the payload is not copied. It must lie within a
+ * memory region registered with memPoolRegisterLoanRegion(), and is given
+ * back through the callback of the region once the frame has been sent (the
+ * Ethernet DMA reads it in place when the NIC driver supports zero-copy
+ * transmission). The callback may run from the TCP/IP stack task, with
+ * netMutex held, so it must not block. If an error is returned, the payload
+ * remains owned by the caller
+ *
+ * @param[in] socket Handle that identifies a connectionless socket
+ * @param[in] message Pointer to the structure describing the datagram
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t socketSendLoanedMsg(Socket *socket, const SocketMsg *message,
+   uint_t flags)
+{
+#if (UDP_SUPPORT == ENABLED && NET_MEM_TX_LOAN_SUPPORT == ENABLED)
+   error_t error;
+
+   //Make sure the socket handle is valid
+   if(socket == NULL || message == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Only datagrams can be loaned
+   if(socket->type != SOCKET_TYPE_DGRAM)
+      return ERROR_INVALID_SOCKET;
+
+   //Get exclusive access to the socket and to the stack
+   socketAcquireLock(socket);
+
+   //Send UDP datagram
+   error = udpSendLoanedDatagram(socket, message, flags);
 
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   socketReleaseLock(socket);
 
    //Return status code
    return error;
+#else
+   //Not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
 }
 
 
 /**
- * @brief Send a message to a connectionless socket
- * @param[in] socket Handle that identifies a socket
- * @param[in] message Pointer to the structure describing the message
+ * @brief Send a batch of datagrams
+ *
+ * The datagrams are sent in order, with a single acquisition of the socket
+ * lock and of netMutex. The Ethernet DMA is notified once the whole batch
+ * has been queued. The function stops at the first datagram that cannot be
+ * sent
+ *
+ * @param[in] socket Handle that identifies a connectionless socket
+ * @param[in] messages Array of structures describing the datagrams to send
+ * @param[in] count Number of entries in the array
+ * @param[out] sent Number of datagrams that have been sent (optional)
  * @param[in] flags Set of flags that influences the behavior of this function
- * @return Error code
+ * @return Error code. An error is reported only if no datagram could be sent
  **/
 
-error_t socketSendMsg(Socket *socket, const SocketMsg *message, uint_t flags)
+error_t socketSendMsgBatch(Socket *socket, const SocketMsg *messages,
+   uint_t count, uint_t *sent, uint_t flags)
 {
    error_t error;
+   uint_t i;
 
-   //Make sure the socket handle is valid
-   if(socket == NULL)
+   //No datagram has been sent yet
+   if(sent != NULL)
+   {
+      *sent = 0;
+   }
+
+   //Check parameters
+   if(socket == NULL || (messages == NULL && count != 0))
       return ERROR_INVALID_PARAMETER;
 
-   //Get exclusive access
-   osAcquireMutex(&netMutex);
+   //Connectionless socket?
+   if(socket->type != SOCKET_TYPE_DGRAM)
+      return ERROR_INVALID_SOCKET;
+
+   //Initialize status code
+   error = NO_ERROR;
 
 #if (UDP_SUPPORT == ENABLED)
-   //Connectionless socket?
-   if(socket->type == SOCKET_TYPE_DGRAM)
+   //Get exclusive access to the socket and to the stack
+   socketAcquireLock(socket);
+
+   //Defer the notification of the DMA until the end of the batch
+   nicBeginTxBatch();
+
+   //Send the datagrams in order
+   for(i = 0; i < count; i++)
    {
       //Send UDP datagram
-      error = udpSendDatagram(socket, message, flags);
+      error = udpSendDatagram(socket, &messages[i], flags);
+      //Any error to report?
+      if(error)
+         break;
    }
-   else
-#endif
-#if (RAW_SOCKET_SUPPORT == ENABLED)
-   //Raw socket?
-   if(socket->type == SOCKET_TYPE_RAW_IP)
+
+   //Start the transmission of the queued frames
+   nicEndTxBatch();
+
+   //Release exclusive access
+   socketReleaseLock(socket);
+
+   //Total number of datagrams that have been sent
+   if(sent != NULL)
    {
-      //Send a raw IP packet
-      error = rawSocketSendIpPacket(socket, message, flags);
+      *sent = i;
    }
-   else if(socket->type == SOCKET_TYPE_RAW_ETH)
+
+   //Errors are only reported when the first datagram fails
+   if(i > 0)
    {
-      //Send a raw Ethernet packet
-      error = rawSocketSendEthPacket(socket, message, flags);
+      error = NO_ERROR;
    }
-   else
+#else
+   //Not implemented
+   error = ERROR_NOT_IMPLEMENTED;
 #endif
-   //Invalid socket type?
-   {
-      //Report an error
-      error = ERROR_INVALID_SOCKET;
-   }
-
-   //Release exclusive access
-   osReleaseMutex(&netMutex);
 
    //Return status code
    return error;
@@ -1755,8 +2587,8 @@ error_t socketReceiveEx(Socket *socket, IpAddr *srcIpAddr, uint16_t *srcPort,
    if(socket == NULL)
       return ERROR_INVALID_PARAMETER;
 
-   //Get exclusive access
-   osAcquireMutex(&netMutex);
+   //Get exclusive access to the socket and to the stack
+   socketAcquireLock(socket);
 
 #if (TCP_SUPPORT == ENABLED)
    //Connection-oriented socket?
@@ -1885,7 +2717,7 @@ error_t socketReceiveEx(Socket *socket, IpAddr *srcIpAddr, uint16_t *srcPort,
    }
 
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   socketReleaseLock(socket);
 
    //Return status code
    return error;
@@ -1911,8 +2743,8 @@ error_t socketReceiveMsg(Socket *socket, SocketMsg *message, uint_t flags)
    if(socket == NULL)
       return ERROR_INVALID_PARAMETER;
 
-   //Get exclusive access
-   osAcquireMutex(&netMutex);
+   //Get exclusive access to the socket and to the stack
+   socketAcquireLock(socket);
 
 #if (UDP_SUPPORT == ENABLED)
    //Connectionless socket?
@@ -1944,7 +2776,266 @@ error_t socketReceiveMsg(Socket *socket, SocketMsg *message, uint_t flags)
    }
 
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   socketReleaseLock(socket);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Receive a batch of datagrams
+ *
+ * The function waits for the first datagram as socketReceiveMsg does, then
+ * drains the datagrams already queued without blocking, with a single
+ * acquisition of the socket lock and of netMutex. Each entry of the array
+ * must provide its own data buffer and size. With SOCKET_FLAG_PEEK, at most
+ * one datagram is returned
+ *
+ * @param[in] socket Handle that identifies a connectionless socket
+ * @param[in,out] messages Array of structures describing the datagrams
+ * @param[in] count Number of entries in the array
+ * @param[out] received Number of datagrams that have been received
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t socketReceiveMsgBatch(Socket *socket, SocketMsg *messages,
+   uint_t count, uint_t *received, uint_t flags)
+{
+   error_t error;
+   uint_t i;
+
+   //Check parameters
+   if(socket == NULL || messages == NULL || count == 0 || received == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //No datagram has been received yet
+   *received = 0;
+
+   //Connectionless socket?
+   if(socket->type != SOCKET_TYPE_DGRAM)
+      return ERROR_INVALID_SOCKET;
+
+#if (UDP_SUPPORT == ENABLED)
+   //Peeked datagrams remain at the head of the queue
+   if((flags & SOCKET_FLAG_PEEK) != 0)
+   {
+      count = 1;
+   }
+
+   //Get exclusive access to the socket and to the stack
+   socketAcquireLock(socket);
+
+   //Wait for the first datagram
+   error = udpReceiveDatagram(socket, &messages[0], flags);
+
+   //Any datagram received?
+   if(!error)
+   {
+      //Drain the datagrams that are already queued
+      for(i = 1; i < count; i++)
+      {
+         //Stop as soon as the receive queue is empty
+         if(udpReceiveDatagram(socket, &messages[i],
+            flags | SOCKET_FLAG_DONT_WAIT))
+         {
+            break;
+         }
+      }
+
+      //Total number of datagrams that have been received
+      *received = i;
+   }
+
+   //Release exclusive access
+   socketReleaseLock(socket);
+#else
+   //Not implemented
+   error = ERROR_NOT_IMPLEMENTED;
+#endif
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Receive a datagram from a UDP socket without copying it
+ *
+ * The buffer holding the datagram is handed to the application, which must
+ * release it with socketReleaseBuffer(). While held, the buffer still takes
+ * memory from the buffer pool (or an RX descriptor of the driver when the
+ * frame was loaned), but no longer counts against UDP_RX_QUEUE_SIZE
+ *
+ * @param[in] socket Handle that identifies a socket
+ * @param[out] message Addresses and ancillary data of the datagram. The data
+ *   field points to the payload when it is contiguous, else it is NULL and
+ *   the payload must be read with netBufferRead()
+ * @param[out] buffer Multi-part buffer holding the datagram
+ * @param[out] offset Offset to the payload within the buffer
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t socketReceiveBuffer(Socket *socket, SocketMsg *message,
+   NetBuffer **buffer, size_t *offset, uint_t flags)
+{
+   error_t error;
+
+   //Check parameters
+   if(message == NULL || buffer == NULL || offset == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //No data has been received yet
+   message->length = 0;
+   *buffer = NULL;
+
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access to the socket and to the stack
+   socketAcquireLock(socket);
+
+#if (UDP_SUPPORT == ENABLED)
+   //Connectionless socket?
+   if(socket->type == SOCKET_TYPE_DGRAM)
+   {
+      //Take the first UDP datagram from the receive queue
+      error = udpReceiveBuffer(socket, message, buffer, offset, flags);
+   }
+   else
+#endif
+   //Invalid socket type?
+   {
+      //Report an error
+      error = ERROR_INVALID_SOCKET;
+   }
+
+   //Release exclusive access
+   socketReleaseLock(socket);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Release a buffer obtained from socketReceiveBuffer()
+ * @param[in] buffer Multi-part buffer to release
+ **/
+
+void socketReleaseBuffer(NetBuffer *buffer)
+{
+   //Valid buffer?
+   if(buffer != NULL)
+   {
+      //Loaned buffers are given back to the driver, which requires exclusive
+      //access to the stack
+      osAcquireMutex(&netMutex);
+      //Free the buffer
+      netBufferFree(buffer);
+      //Release exclusive access
+      osReleaseMutex(&netMutex);
+   }
+}
+
+
+/**
+ * @brief Access the data received on a TCP socket without copying it
+ *
+ * The data pointer designates a contiguous block of unread data within the
+ * receive buffer of the connection. The block remains valid, and is not
+ * consumed, until the application calls socketReleaseInPlace()
+ *
+ * @param[in] socket Handle that identifies a socket
+ * @param[out] data Pointer to the first byte of unread data
+ * @param[out] length Number of contiguous bytes available
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t socketReceiveInPlace(Socket *socket, const uint8_t **data,
+   size_t *length, uint_t flags)
+{
+   error_t error;
+
+   //Check parameters
+   if(data == NULL || length == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //No data has been received yet
+   *data = NULL;
+   *length = 0;
+
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access to the socket and to the stack
+   socketAcquireLock(socket);
+
+#if (TCP_SUPPORT == ENABLED)
+   //Connection-oriented socket?
+   if(socket->type == SOCKET_TYPE_STREAM)
+   {
+      //Locate the unread data
+      error = tcpReceiveInPlace(socket, data, length, flags);
+   }
+   else
+#endif
+   //Invalid socket type?
+   {
+      //Report an error
+      error = ERROR_INVALID_SOCKET;
+   }
+
+   //Release exclusive access
+   socketReleaseLock(socket);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Consume data obtained from socketReceiveInPlace()
+ * @param[in] socket Handle that identifies a socket
+ * @param[in] length Number of bytes the application has processed
+ * @return Error code
+ **/
+
+error_t socketReleaseInPlace(Socket *socket, size_t length)
+{
+   error_t error;
+
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access to the socket and to the stack
+   socketAcquireLock(socket);
+
+#if (TCP_SUPPORT == ENABLED)
+   //Connection-oriented socket?
+   if(socket->type == SOCKET_TYPE_STREAM)
+   {
+      //The space held by the data can be reused for incoming segments
+      tcpReleaseRxData(socket, length);
+      //Successful processing
+      error = NO_ERROR;
+   }
+   else
+#endif
+   //Invalid socket type?
+   {
+      //Report an error
+      error = ERROR_INVALID_SOCKET;
+   }
+
+   //Release exclusive access
+   socketReleaseLock(socket);
 
    //Return status code
    return error;
@@ -2077,6 +3168,11 @@ void socketClose(Socket *socket)
    //Get exclusive access
    osAcquireMutex(&netMutex);
 
+#if (SOCKET_POLL_SUPPORT == ENABLED)
+   //The socket leaves its poll set, if any
+   socketPollDetach(socket);
+#endif
+
 #if (SOCKET_MAX_MULTICAST_GROUPS > 0)
    //Connectionless or raw socket?
    if(socket->type == SOCKET_TYPE_DGRAM ||
@@ -2397,6 +3493,14 @@ error_t getHostByName(NetInterface *interface, const char_t *name,
       //Use DNS protocol?
       if(protocol == HOST_NAME_RESOLVER_DNS)
       {
+#if (DNS_CLIENT_PARALLEL_SUPPORT == ENABLED && IPV4_SUPPORT == ENABLED && \
+   IPV6_SUPPORT == ENABLED)
+         //Without a hint, A and AAAA records are queried at once
+         if((flags & (HOST_TYPE_IPV4 | HOST_TYPE_IPV6)) == 0)
+         {
+            type = HOST_TYPE_ANY;
+         }
+#endif
          //Perform host name resolution
          error = dnsResolve(interface, name, type, ipAddr);
       }
@@ -40,6 +40,7 @@ struct _Socket;
 #include "core/ethernet.h"
 #include "core/ip.h"
 #include "core/tcp.h"
+#include "core/net_shaper.h"
 
 //Number of sockets that can be opened simultaneously
 #ifndef SOCKET_MAX_COUNT
@@ -48,6 +49,40 @@ struct _Socket;
    #error SOCKET_MAX_COUNT parameter is not valid
 #endif
 
+//Number of sockets that can be TCP sockets simultaneously
+#ifndef SOCKET_MAX_TCP_COUNT
+   #define SOCKET_MAX_TCP_COUNT SOCKET_MAX_COUNT
+#elif (SOCKET_MAX_TCP_COUNT < 1 || SOCKET_MAX_TCP_COUNT > SOCKET_MAX_COUNT)
+   #error SOCKET_MAX_TCP_COUNT parameter is not valid
+#endif
+
+//Section where to place the socket table (the default data section is used
+//when this parameter is not defined)
+#ifdef _DOXYGEN_
+   #define SOCKET_TABLE_SECTION ".dtcm_bss"
+#endif
+
+//Per-socket lock support
+#ifndef SOCKET_LOCK_SUPPORT
+   #define SOCKET_LOCK_SUPPORT DISABLED
+#elif (SOCKET_LOCK_SUPPORT != ENABLED && SOCKET_LOCK_SUPPORT != DISABLED)
+   #error SOCKET_LOCK_SUPPORT parameter is not valid
+#endif
+
+//Size of the socket demultiplexing cache
+#ifndef SOCKET_HASH_TABLE_SIZE
+   #define SOCKET_HASH_TABLE_SIZE 0
+#elif (SOCKET_HASH_TABLE_SIZE < 0)
+   #error SOCKET_HASH_TABLE_SIZE parameter is not valid
+#endif
+
+//Per-socket route cache support
+#ifndef SOCKET_ROUTE_CACHE_SUPPORT
+   #define SOCKET_ROUTE_CACHE_SUPPORT DISABLED
+#elif (SOCKET_ROUTE_CACHE_SUPPORT != ENABLED && SOCKET_ROUTE_CACHE_SUPPORT != DISABLED)
+   #error SOCKET_ROUTE_CACHE_SUPPORT parameter is not valid
+#endif
+
 //Maximum number of multicast groups
 #ifndef SOCKET_MAX_MULTICAST_GROUPS
    #define SOCKET_MAX_MULTICAST_GROUPS 1
@@ -76,6 +111,13 @@ struct _Socket;
    #error SOCKET_EPHEMERAL_PORT_MAX parameter is not valid
 #endif
 
+//Persistent poll sets with ready lists
+#ifndef SOCKET_POLL_SUPPORT
+   #define SOCKET_POLL_SUPPORT DISABLED
+#elif (SOCKET_POLL_SUPPORT != ENABLED && SOCKET_POLL_SUPPORT != DISABLED)
+   #error SOCKET_POLL_SUPPORT parameter is not valid
+#endif
+
 //C++ guard
 #ifdef __cplusplus
 extern "C" {
@@ -149,6 +191,10 @@ typedef enum
 //data whenever the specified break character is encountered
 #define SOCKET_FLAG_BREAK(c) (SOCKET_FLAG_BREAK_CHAR | LSB(c))
 
+//The SOCKET_FLAG_MORE flag indicates that more data is about to be sent,
+//so that partial segments are held back (same as MSG_MORE)
+#define SOCKET_FLAG_MORE SOCKET_FLAG_DELAY
+
 
 /**
  * @brief Flags used by shutdown function
@@ -203,7 +249,10 @@ typedef enum
    SOCKET_OPTION_IPV6_RECV_TRAFFIC_CLASS = 0x0800,
    SOCKET_OPTION_IPV6_RECV_HOP_LIMIT     = 0x1000,
    SOCKET_OPTION_TCP_NO_DELAY            = 0x2000,
-   SOCKET_OPTION_UDP_NO_CHECKSUM         = 0x4000
+   SOCKET_OPTION_UDP_NO_CHECKSUM         = 0x4000,
+   SOCKET_OPTION_TCP_CORK                = 0x8000,
+   SOCKET_OPTION_REUSE_PORT              = 0x10000,
+   SOCKET_OPTION_TCP_FAST_OPEN           = 0x20000
 } SocketOptions;
 
 
@@ -262,6 +311,15 @@ typedef struct
    int32_t timestampId;     ///<Unique identifier for hardware time stamping
    NetTimestamp timestamp;  ///<Captured time stamp
 #endif
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+   NetTimestamp launchTime; ///<PTP time at which the datagram is sent (0 for none)
+#endif
+#if (NIC_TX_DEADLINE_SUPPORT == ENABLED)
+   systime_t deadline;      ///<Time past which the datagram is dropped (0 for none)
+#endif
+#if (NIC_RX_TIME_SUPPORT == ENABLED)
+   uint64_t rxTime;         ///<Time the datagram was received, in microseconds
+#endif
 } SocketMsg;
 
 
@@ -280,6 +338,27 @@ typedef struct
 } SocketMulticastGroup;
 
 
+/**
+ * @brief Route cache entry
+ *
+ * Outgoing interface, source address and next-hop MAC address last used to
+ * reach the destination. The entry is valid as long as the route generation
+ * of the TCP/IP stack has not changed
+ **/
+
+typedef struct
+{
+   bool_t valid;              ///<The entry is valid
+   uint32_t generation;       ///<Route generation at the time the entry was filled
+   NetInterface *interface;   ///<Outgoing interface
+   IpAddr srcIpAddr;          ///<Source IP address
+   IpAddr destIpAddr;         ///<Destination IP address
+#if (ETH_SUPPORT == ENABLED)
+   MacAddr destMacAddr;       ///<Next-hop MAC address
+#endif
+} SocketRouteCache;
+
+
 /**
  * @brief Receive queue item
  **/
@@ -298,43 +377,51 @@ typedef struct _SocketQueueItem
 
 
 /**
- * @brief Structure describing a socket
+ * @brief Task blocked on a socket
+ *
+ * Each task waiting on a socket has its own event object, so that a task
+ * waiting to receive and another one waiting to send are each woken up by
+ * their own events
  **/
 
-struct _Socket
+typedef struct _SocketWaiter
 {
-   uint_t descriptor;
-   uint_t type;
-   uint_t protocol;
-   NetInterface *interface;
-   IpAddr localIpAddr;
-   uint16_t localPort;
-   IpAddr remoteIpAddr;
-   uint16_t remotePort;
-   uint32_t options;              ///<Socket options
-   systime_t timeout;
-   uint8_t tos;                   ///<Type-of-service value
-   uint8_t ttl;                   ///<Time-to-live value for unicast datagrams
-   uint8_t multicastTtl;          ///<Time-to-live value for multicast datagrams
-#if (SOCKET_MAX_MULTICAST_GROUPS > 0)
-   SocketMulticastGroup multicastGroups[SOCKET_MAX_MULTICAST_GROUPS]; ///<Multicast groups
-#endif
-#if (ETH_VLAN_SUPPORT == ENABLED)
-   int8_t vlanPcp;                ///<VLAN priority (802.1Q)
-   int8_t vlanDei;                ///<Drop eligible indicator
-#endif
-#if (ETH_VMAN_SUPPORT == ENABLED)
-   int8_t vmanPcp;                ///<VMAN priority (802.1ad)
-   int8_t vmanDei;                ///<Drop eligible indicator
-#endif
-   int_t errnoCode;
-   OsEvent event;
-   uint_t eventMask;
-   uint_t eventFlags;
-   OsEvent *userEvent;
+   struct _SocketWaiter *next;
+   uint_t eventMask; ///<Events the task is waiting for
+   OsEvent event;    ///<Set when one of them is signaled
+} SocketWaiter;
+
+
+/**
+ * @brief Poll set
+ *
+ * Sockets stay in the set between waits. The TCP/IP stack queues a socket
+ * on the ready list when one of its events of interest is signaled, so
+ * that a wait only visits the sockets that are ready
+ **/
+
+typedef struct
+{
+   OsEvent event;             ///<Signaled when the ready list is not empty
+   Socket *readyHead;         ///<First socket of the ready list
+   Socket *readyTail;         ///<Last socket of the ready list
+   uint_t count;              ///<Number of sockets in the set
+} SocketPollSet;
+
+
+/**
+ * @brief TCP control block
+ *
+ * Only stream sockets carry a TCP control block, taken from a table of
+ * SOCKET_MAX_TCP_COUNT entries when the socket is allocated and returned
+ * when it is released
+ **/
 
-//TCP specific variables
 #if (TCP_SUPPORT == ENABLED)
+
+typedef struct
+{
+   bool_t used;                   ///<The entry is in use
    TcpState state;                ///<Current state of the TCP finite state machine
    bool_t ownedFlag;              ///<The user is the owner of the TCP socket
    bool_t closedFlag;             ///<The connection has been closed properly
@@ -364,6 +451,7 @@ struct _Socket
    systime_t srtt;                ///<Smoothed round-trip time
    systime_t rttvar;              ///<Round-trip time variation
    systime_t rto;                 ///<Retransmission timeout
+   systime_t rttSample;           ///<Latest round-trip time measurement
 
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
    TcpCongestState congestState;  ///<Congestion state
@@ -372,6 +460,8 @@ struct _Socket
    uint_t dupAckCount;            ///<Number of consecutive duplicate ACKs
    uint32_t n;                    ///<Number of bytes acknowledged during the whole round-trip
    uint32_t recover;              ///<NewReno modification to TCP's fast recovery algorithm
+   const TcpCongestAlgo *congestAlgo;     ///<Congestion control algorithm
+   TcpCongestAlgoState congestAlgoState;  ///<Algorithm specific state
 #endif
 
 #if (TCP_KEEP_ALIVE_SUPPORT == ENABLED)
@@ -383,6 +473,12 @@ struct _Socket
    systime_t keepAliveTimestamp;  ///<Keep-alive timestamp
 #endif
 
+#if (TCP_DELAYED_ACK_SUPPORT == ENABLED)
+   bool_t quickAck;               ///<Acknowledge every data segment immediately
+   uint32_t delayedAckBytes;      ///<Number of bytes received but not yet acknowledged
+   NetTimer delayedAckTimer;      ///<Delayed ACK timer
+#endif
+
 #if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
    uint8_t sndWndShift;           ///<Send window scale factor
    uint8_t rcvWndShift;           ///<Receive window scale factor
@@ -393,17 +489,50 @@ struct _Socket
    bool_t sackPermitted;          ///<SACK Permitted option received
 #endif
 
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   bool_t tsEnabled;              ///<Timestamps are exchanged on this connection
+   uint32_t tsOffset;             ///<Random offset of the timestamp clock
+   uint32_t tsRecent;             ///<Latest timestamp received from the peer (TS.Recent)
+   systime_t tsRecentTime;        ///<Time at which TS.Recent was last updated
+   uint32_t tsLastAckSent;        ///<Last acknowledgment number sent (Last.ACK.sent)
+#endif
+
+#if (TCP_FAST_OPEN_SUPPORT == ENABLED)
+   bool_t fastOpenOption;         ///<The SYN segment carries a Fast Open option
+   bool_t fastOpenPending;        ///<The SYN segment is held until data is written
+   uint8_t fastOpenCookie[TCP_FAST_OPEN_MAX_COOKIE_SIZE]; ///<Cookie sent in the SYN segment
+   size_t fastOpenCookieLen;      ///<Length of the cookie (0 to request one)
+   size_t fastOpenLength;         ///<Number of data bytes carried by the SYN segment
+#endif
+
+#if (TCP_LARGE_BUFFER_SUPPORT == ENABLED)
+   bool_t largeBuffers;           ///<Buffers are allocated from the large buffer pool
+#endif
+
    TcpSackBlock sackBlock[TCP_MAX_SACK_BLOCKS]; ///<List of non-contiguous blocks that have been received
    uint_t sackBlockCount;                       ///<Number of non-contiguous blocks that have been received
+   TcpSackBlock oooBlock[TCP_MAX_OOO_BLOCKS];   ///<Ranges of out-of-order data held in the receive buffer
+   uint_t oooBlockCount;                        ///<Number of ranges of out-of-order data
 
    TcpTxBuffer txBuffer;          ///<Send buffer
    size_t txBufferSize;           ///<Size of the send buffer
+   size_t txLowWatermark;         ///<Free space that makes the socket writable
+   uint32_t txBufferOffset;       ///<Sequence number offset of the send buffer
+   NetBufferCursor txCursor;      ///<Last chunk accessed in the send buffer
    TcpRxBuffer rxBuffer;          ///<Receive buffer
    size_t rxBufferSize;           ///<Size of the receive buffer
+   size_t rxLowWatermark;         ///<Buffered data that makes the socket readable
+   uint32_t rxBufferOffset;       ///<Sequence number offset of the receive buffer
+   NetBufferCursor rxCursor;      ///<Last chunk accessed in the receive buffer
+
+#if (TCP_AUTO_TUNE_SUPPORT == ENABLED)
+   TcpAutoTuneState autoTune;     ///<Buffer auto-tuning state
+#endif
 
    TcpQueueItem *retransmitQueue; ///<Retransmission queue
    NetTimer retransmitTimer;      ///<Retransmission timer
    uint_t retransmitCount;        ///<Number of retransmissions
+   uint32_t retransmitTotal;      ///<Segments retransmitted over the life of the connection
 
    TcpSynQueueItem *synQueue;     ///<SYN queue for listening sockets
    uint_t synQueueSize;           ///<Maximum number of pending connections for listening sockets
@@ -413,17 +542,135 @@ struct _Socket
 
    NetTimer persistTimer;         ///<Persist timer
    NetTimer overrideTimer;        ///<Override timer
+#if (NET_SHAPER_SUPPORT == ENABLED || TCP_PACING_SUPPORT == ENABLED)
+   NetTimer paceTimer;            ///<Resumes the data held back by pacing or the rate limits
+   Socket *paceNext;              ///<Next socket waiting on its pace timer
+   bool_t paceScheduled;          ///<The socket waits on its pace timer
+#endif
+#if (TCP_PACING_SUPPORT == ENABLED)
+   int32_t paceCredit;            ///<Bytes that may be sent before the next pacing delay
+   systime_t paceTime;            ///<Time at which the pacing credit was last updated
+#endif
    NetTimer finWait2Timer;        ///<FIN-WAIT-2 timer
    NetTimer timeWaitTimer;        ///<2MSL timer
+
+   Socket *timerNext;             ///<Next socket in the same timer wheel slot
+   Socket *timerPrev;             ///<Previous socket in the same timer wheel slot
+   uint_t timerSlot;              ///<Timer wheel slot
+   bool_t timerScheduled;         ///<The socket is linked into the timer wheel
+   systime_t timerDeadline;       ///<Earliest time at which a timer may expire
+} TcpControlBlock;
+
+#endif
+
+
+/**
+ * @brief Structure describing a socket
+ **/
+
+struct _Socket
+{
+   uint_t descriptor;
+   uint_t type;
+   uint_t protocol;
+   NetInterface *interface;
+   IpAddr localIpAddr;
+   uint16_t localPort;
+   IpAddr remoteIpAddr;
+   uint16_t remotePort;
+   uint32_t options;              ///<Socket options
+   systime_t timeout;
+   uint8_t tos;                   ///<Type-of-service value
+   uint8_t ttl;                   ///<Time-to-live value for unicast datagrams
+   uint8_t multicastTtl;          ///<Time-to-live value for multicast datagrams
+#if (SOCKET_MAX_MULTICAST_GROUPS > 0)
+   SocketMulticastGroup multicastGroups[SOCKET_MAX_MULTICAST_GROUPS]; ///<Multicast groups
+#endif
+#if (ETH_VLAN_SUPPORT == ENABLED)
+   int8_t vlanPcp;                ///<VLAN priority (802.1Q)
+   int8_t vlanDei;                ///<Drop eligible indicator
+#endif
+#if (ETH_VMAN_SUPPORT == ENABLED)
+   int8_t vmanPcp;                ///<VMAN priority (802.1ad)
+   int8_t vmanDei;                ///<Drop eligible indicator
+#endif
+   int_t errnoCode;
+#if (SOCKET_ROUTE_CACHE_SUPPORT == ENABLED)
+   SocketRouteCache routeCache;   ///<Route to the last destination
+#endif
+#if (NET_SHAPER_SUPPORT == ENABLED)
+   NetShaperBucket shaper;        ///<Rate limit of the socket
+#endif
+   OsEvent event;
+#if (SOCKET_LOCK_SUPPORT == ENABLED)
+   OsMutex mutex;                 ///<Serializes data-path calls on the socket
+   bool_t lockHeld;               ///<The owner of the socket lock holds the netMutex
+   SocketWaiter *waiters;         ///<Tasks blocked on the socket
+#endif
+   uint_t eventMask;
+   uint_t eventFlags;
+   OsEvent *userEvent;
+#if (SOCKET_POLL_SUPPORT == ENABLED)
+   SocketPollSet *pollSet;        ///<Poll set the socket belongs to
+   uint_t pollMask;               ///<Events of interest to the poll set
+   uint_t pollMode;               ///<Level-triggered or edge-triggered
+   uint_t pollLevel;              ///<Events of interest currently signaled
+   uint_t pollPending;            ///<Events not yet reported (edge-triggered)
+   bool_t pollQueued;             ///<The socket is on the ready list
+   Socket *pollPrev;              ///<Previous socket of the ready list
+   Socket *pollNext;              ///<Next socket of the ready list
+#endif
+
+//TCP specific variables
+#if (TCP_SUPPORT == ENABLED)
+   TcpControlBlock *tcb;          ///<TCP control block (stream sockets only)
 #endif
 
 //UDP specific variables
 #if (UDP_SUPPORT == ENABLED || RAW_SOCKET_SUPPORT == ENABLED)
    SocketQueueItem *receiveQueue;
 #endif
+#if (UDP_SUPPORT == ENABLED && NIC_RX_BATCH_SUPPORT == ENABLED)
+   bool_t rxEventPending;         ///<Notification deferred until the end of the RX batch
+#endif
 };
 
 
+/**
+ * @brief TCP connection information
+ **/
+
+typedef struct
+{
+   TcpState state;              ///<Current state of the connection
+   uint16_t smss;               ///<Sender maximum segment size
+   uint16_t rmss;               ///<Receiver maximum segment size
+   systime_t srtt;              ///<Smoothed round-trip time
+   systime_t rttvar;            ///<Round-trip time variation
+   systime_t rttSample;         ///<Latest round-trip time measurement
+   systime_t rto;               ///<Retransmission timeout
+   uint_t retransmitCount;      ///<Number of retransmissions of the oldest segment
+   uint32_t retransmitTotal;    ///<Segments retransmitted over the life of the connection
+   uint32_t cwnd;               ///<Congestion window
+   uint32_t ssthresh;           ///<Slow start threshold
+   TcpCongestState congestState; ///<Congestion state (recovery phases)
+   uint_t dupAckCount;          ///<Number of consecutive duplicate ACKs
+   const char_t *congestAlgo;   ///<Name of the congestion control algorithm
+   uint32_t sndWnd;             ///<Send window
+   uint32_t rcvWnd;             ///<Receive window
+   uint8_t sndWndShift;         ///<Send window scale factor
+   uint8_t rcvWndShift;         ///<Receive window scale factor
+   uint32_t unacked;            ///<Bytes sent and not yet acknowledged
+   uint32_t sndQueue;           ///<Bytes written and not yet sent
+   uint32_t rcvQueue;           ///<Bytes received and not yet read
+   size_t txBufferSize;         ///<Size of the send buffer
+   size_t rxBufferSize;         ///<Size of the receive buffer
+   bool_t wndScale;             ///<Window scaling is in use
+   bool_t sack;                 ///<SACK is in use
+   bool_t timestamps;           ///<Timestamps are in use
+} SocketTcpInfo;
+
+
 /**
  * @brief Structure describing socket events
  **/
@@ -442,6 +689,10 @@ extern const SocketMsg SOCKET_DEFAULT_MSG;
 //Global variables
 extern Socket socketTable[SOCKET_MAX_COUNT];
 
+#if (TCP_SUPPORT == ENABLED)
+extern TcpControlBlock tcpControlBlockTable[SOCKET_MAX_TCP_COUNT];
+#endif
+
 //Socket related functions
 error_t socketInit(void);
 
@@ -453,6 +704,7 @@ error_t socketSetTtl(Socket *socket, uint8_t ttl);
 error_t socketSetMulticastTtl(Socket *socket, uint8_t ttl);
 
 error_t socketSetDscp(Socket *socket, uint8_t dscp);
+error_t socketSetRateLimit(Socket *socket, uint32_t rate, uint32_t burst);
 
 error_t socketSetVlanPcp(Socket *socket, uint8_t pcp);
 error_t socketSetVlanDei(Socket *socket, bool_t dei);
@@ -460,6 +712,7 @@ error_t socketSetVmanPcp(Socket *socket, uint8_t pcp);
 error_t socketSetVmanDei(Socket *socket, bool_t dei);
 
 error_t socketEnableBroadcast(Socket *socket, bool_t enabled);
+error_t socketEnableReusePort(Socket *socket, bool_t enabled);
 
 error_t socketJoinMulticastGroup(Socket *socket, const IpAddr *groupAddr);
 error_t socketLeaveMulticastGroup(Socket *socket, const IpAddr *groupAddr);
@@ -483,14 +736,23 @@ error_t socketUnblockMulticastSource(Socket *socket, const IpAddr *groupAddr,
    const IpAddr *srcAddr);
 
 error_t socketEnableKeepAlive(Socket *socket, bool_t enabled);
+error_t socketEnableQuickAck(Socket *socket, bool_t enabled);
+error_t socketEnableNoDelay(Socket *socket, bool_t enabled);
+error_t socketEnableCork(Socket *socket, bool_t enabled);
+error_t socketEnableFastOpen(Socket *socket, bool_t enabled);
+error_t socketGetTcpInfo(Socket *socket, SocketTcpInfo *info);
 
 error_t socketSetKeepAliveParams(Socket *socket, systime_t idle,
    systime_t interval, uint_t maxProbes);
 
+error_t socketSetCongestionControl(Socket *socket, TcpCongestAlgoType algo);
 error_t socketSetMaxSegmentSize(Socket *socket, size_t mss);
 
+error_t socketEnableLargeBuffers(Socket *socket, bool_t enabled);
 error_t socketSetTxBufferSize(Socket *socket, size_t size);
 error_t socketSetRxBufferSize(Socket *socket, size_t size);
+error_t socketSetTxLowWatermark(Socket *socket, size_t size);
+error_t socketSetRxLowWatermark(Socket *socket, size_t size);
 
 error_t socketSetInterface(Socket *socket, NetInterface *interface);
 NetInterface *socketGetInterface(Socket *socket);
@@ -514,6 +776,12 @@ error_t socketSendTo(Socket *socket, const IpAddr *destIpAddr, uint16_t destPort
 
 error_t socketSendMsg(Socket *socket, const SocketMsg *message, uint_t flags);
 
+error_t socketSendLoanedMsg(Socket *socket, const SocketMsg *message,
+   uint_t flags);
+
+error_t socketSendMsgBatch(Socket *socket, const SocketMsg *messages,
+   uint_t count, uint_t *sent, uint_t flags);
+
 error_t socketReceive(Socket *socket, void *data,
    size_t size, size_t *received, uint_t flags);
 
@@ -525,6 +793,19 @@ error_t socketReceiveEx(Socket *socket, IpAddr *srcIpAddr, uint16_t *srcPort,
 
 error_t socketReceiveMsg(Socket *socket, SocketMsg *message, uint_t flags);
 
+error_t socketReceiveMsgBatch(Socket *socket, SocketMsg *messages,
+   uint_t count, uint_t *received, uint_t flags);
+
+error_t socketReceiveBuffer(Socket *socket, SocketMsg *message,
+   NetBuffer **buffer, size_t *offset, uint_t flags);
+
+void socketReleaseBuffer(NetBuffer *buffer);
+
+error_t socketReceiveInPlace(Socket *socket, const uint8_t **data,
+   size_t *length, uint_t flags);
+
+error_t socketReleaseInPlace(Socket *socket, size_t length);
+
 error_t socketGetLocalAddr(Socket *socket, IpAddr *localIpAddr,
    uint16_t *localPort);
 
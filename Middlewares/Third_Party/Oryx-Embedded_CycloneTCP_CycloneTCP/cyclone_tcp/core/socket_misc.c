@@ -39,8 +39,16 @@
 #include "core/udp.h"
 #include "core/tcp.h"
 #include "core/tcp_misc.h"
+#include "core/tcp_congest.h"
 #include "debug.h"
 
+#if (SOCKET_HASH_TABLE_SIZE > 0)
+
+//Socket demultiplexing cache
+static Socket *socketHashTable[SOCKET_HASH_TABLE_SIZE];
+
+#endif
+
 
 /**
  * @brief Allocate a socket
@@ -55,9 +63,16 @@ Socket *socketAllocate(uint_t type, uint_t protocol)
    uint_t i;
    uint16_t port;
    Socket *socket;
+#if (TCP_SUPPORT == ENABLED)
+   Socket *oldestSocket;
+   TcpControlBlock *tcb;
+#endif
 
    //Initialize socket handle
    socket = NULL;
+#if (TCP_SUPPORT == ENABLED)
+   tcb = NULL;
+#endif
 
 #if (TCP_SUPPORT == ENABLED)
    //Connection-oriented socket?
@@ -118,12 +133,35 @@ Socket *socketAllocate(uint_t type, uint_t protocol)
       }
 
 #if (TCP_SUPPORT == ENABLED)
-      //No more sockets available?
-      if(socket == NULL)
+      //Connection-oriented sockets also need a TCP control block
+      if(type == SOCKET_TYPE_STREAM)
+      {
+         tcb = tcpGetFreeControlBlock();
+      }
+
+      //No more sockets or TCP control blocks available?
+      if(socket == NULL || (type == SOCKET_TYPE_STREAM && tcb == NULL))
       {
          //Kill the oldest connection in the TIME-WAIT state whenever the
-         //socket table runs out of space
-         socket = tcpKillOldestConnection();
+         //socket table or the TCP control block table runs out of space
+         oldestSocket = tcpKillOldestConnection();
+
+         //Reuse the entries released by the connection
+         if(socket == NULL)
+         {
+            socket = oldestSocket;
+         }
+
+         if(type == SOCKET_TYPE_STREAM && tcb == NULL)
+         {
+            tcb = tcpGetFreeControlBlock();
+         }
+      }
+
+      //A TCP socket cannot be opened without a TCP control block
+      if(type == SOCKET_TYPE_STREAM && tcb == NULL)
+      {
+         socket = NULL;
       }
 #endif
 
@@ -133,11 +171,19 @@ Socket *socketAllocate(uint_t type, uint_t protocol)
          //Save socket descriptor
          i = socket->descriptor;
 
+#if (SOCKET_LOCK_SUPPORT == ENABLED)
+         //Clear the structure keeping the event and lock fields untouched
+         osMemset(socket, 0, offsetof(Socket, event));
+
+         osMemset((uint8_t *) socket + offsetof(Socket, mutex) + sizeof(OsMutex),
+            0, sizeof(Socket) - offsetof(Socket, mutex) - sizeof(OsMutex));
+#else
          //Clear the structure keeping the event field untouched
          osMemset(socket, 0, offsetof(Socket, event));
 
          osMemset((uint8_t *) socket + offsetof(Socket, event) + sizeof(OsEvent),
             0, sizeof(Socket) - offsetof(Socket, event) - sizeof(OsEvent));
+#endif
 
          //Save socket characteristics
          socket->descriptor = i;
@@ -146,6 +192,9 @@ Socket *socketAllocate(uint_t type, uint_t protocol)
          socket->localPort = port;
          socket->timeout = INFINITE_DELAY;
 
+         //The endpoints of the socket have changed
+         socketHashEvict(socket);
+
 #if (ETH_VLAN_SUPPORT == ENABLED)
          //Default VLAN PCP and DEI fields
          socket->vlanPcp = -1;
@@ -158,27 +207,51 @@ Socket *socketAllocate(uint_t type, uint_t protocol)
          socket->vmanDei = -1;
 #endif
 
-#if (TCP_SUPPORT == ENABLED && TCP_KEEP_ALIVE_SUPPORT == ENABLED)
-         //TCP keep-alive mechanism must be disabled by default (refer to
-         //RFC 1122, section 4.2.3.6)
-         socket->keepAliveEnabled = FALSE;
-
-         //Default TCP keep-alive parameters
-         socket->keepAliveIdle = TCP_DEFAULT_KEEP_ALIVE_IDLE;
-         socket->keepAliveInterval = TCP_DEFAULT_KEEP_ALIVE_INTERVAL;
-         socket->keepAliveMaxProbes = TCP_DEFAULT_KEEP_ALIVE_PROBES;
+#if (TCP_SUPPORT == ENABLED)
+         //Connection-oriented socket?
+         if(type == SOCKET_TYPE_STREAM)
+         {
+            //Attach the TCP control block to the socket
+            osMemset(tcb, 0, sizeof(TcpControlBlock));
+            tcb->used = TRUE;
+            socket->tcb = tcb;
+
+#if (TCP_KEEP_ALIVE_SUPPORT == ENABLED)
+            //TCP keep-alive mechanism must be disabled by default (refer to
+            //RFC 1122, section 4.2.3.6)
+            socket->tcb->keepAliveEnabled = FALSE;
+
+            //Default TCP keep-alive parameters
+            socket->tcb->keepAliveIdle = TCP_DEFAULT_KEEP_ALIVE_IDLE;
+            socket->tcb->keepAliveInterval = TCP_DEFAULT_KEEP_ALIVE_INTERVAL;
+            socket->tcb->keepAliveMaxProbes = TCP_DEFAULT_KEEP_ALIVE_PROBES;
 #endif
 
-#if (TCP_SUPPORT == ENABLED)
-         //Default MSS value
-         socket->mss = TCP_MAX_MSS;
+            //Default MSS value
+            socket->tcb->mss = TCP_MAX_MSS;
+
+            //Default TX and RX buffer size
+            socket->tcb->txBufferSize = MIN(TCP_DEFAULT_TX_BUFFER_SIZE, TCP_MAX_TX_BUFFER_SIZE);
+            socket->tcb->rxBufferSize = MIN(TCP_DEFAULT_RX_BUFFER_SIZE, TCP_MAX_RX_BUFFER_SIZE);
+
+            //Compute the window scale factor to use for the receive window
+            tcpComputeWindowScaleFactor(socket);
 
-         //Default TX and RX buffer size
-         socket->txBufferSize = MIN(TCP_DEFAULT_TX_BUFFER_SIZE, TCP_MAX_TX_BUFFER_SIZE);
-         socket->rxBufferSize = MIN(TCP_DEFAULT_RX_BUFFER_SIZE, TCP_MAX_RX_BUFFER_SIZE);
+#if (TCP_AUTO_TUNE_SUPPORT == ENABLED)
+            //Buffers are sized automatically until the user sets their size
+            socket->tcb->autoTune.txEnabled = TRUE;
+            socket->tcb->autoTune.rxEnabled = TRUE;
+#endif
 
-         //Compute the window scale factor to use for the receive window
-         tcpComputeWindowScaleFactor(socket);
+#if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
+            //Default congestion control algorithm
+            if(tcpSetCongestAlgo(socket, TCP_DEFAULT_CONGEST_ALGO))
+            {
+               //The default algorithm is not supported, fall back to Reno
+               tcpSetCongestAlgo(socket, TCP_CONGEST_ALGO_RENO);
+            }
+#endif
+         }
 #endif
       }
    }
@@ -188,6 +261,503 @@ Socket *socketAllocate(uint_t type, uint_t protocol)
 }
 
 
+/**
+ * @brief Get exclusive access to the data path of a socket
+ *
+ * Tasks sharing a socket queue up on the per-socket lock instead of the
+ * netMutex, so that they do not contend with the TCP/IP stack task or with
+ * tasks operating on other sockets. The socket lock is always acquired
+ * before the netMutex, both of which are taken here. Neither is held while
+ * the task blocks (refer to socketWaitForEvent)
+ *
+ * @param[in] socket Handle that identifies a socket
+ **/
+
+void socketAcquireLock(Socket *socket)
+{
+#if (SOCKET_LOCK_SUPPORT == ENABLED)
+   //Serialize data-path operations on this socket
+   osAcquireMutex(&socket->mutex);
+#endif
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+#if (SOCKET_LOCK_SUPPORT == ENABLED)
+   //The socket lock is released whenever the netMutex is
+   socket->lockHeld = TRUE;
+#endif
+}
+
+
+/**
+ * @brief Release exclusive access to the data path of a socket
+ * @param[in] socket Handle that identifies a socket
+ **/
+
+void socketReleaseLock(Socket *socket)
+{
+#if (SOCKET_LOCK_SUPPORT == ENABLED)
+   socket->lockHeld = FALSE;
+#endif
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+#if (SOCKET_LOCK_SUPPORT == ENABLED)
+   //Allow other tasks to operate on this socket
+   osReleaseMutex(&socket->mutex);
+#endif
+}
+
+
+/**
+ * @brief Release the netMutex, and the socket lock if held, before blocking
+ *
+ * The flag set by socketAcquireLock tells whether the socket lock belongs
+ * to the calling task: only the owner of the netMutex can see it set. A task
+ * calling connect, accept or close takes the netMutex alone
+ *
+ * @param[in] socket Handle that identifies a socket
+ * @return TRUE if the socket lock was released
+ **/
+
+bool_t socketSuspendLock(Socket *socket)
+{
+   bool_t held;
+
+#if (SOCKET_LOCK_SUPPORT == ENABLED)
+   held = socket->lockHeld;
+   socket->lockHeld = FALSE;
+#else
+   held = FALSE;
+#endif
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+#if (SOCKET_LOCK_SUPPORT == ENABLED)
+   //Let another task send or receive on the socket meanwhile
+   if(held)
+   {
+      osReleaseMutex(&socket->mutex);
+   }
+#endif
+
+   //Return the state of the socket lock
+   return held;
+}
+
+
+/**
+ * @brief Get back the locks released by socketSuspendLock
+ * @param[in] socket Handle that identifies a socket
+ * @param[in] held Value returned by socketSuspendLock
+ **/
+
+void socketResumeLock(Socket *socket, bool_t held)
+{
+#if (SOCKET_LOCK_SUPPORT == ENABLED)
+   //The socket lock is acquired first
+   if(held)
+   {
+      osAcquireMutex(&socket->mutex);
+   }
+#endif
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+#if (SOCKET_LOCK_SUPPORT == ENABLED)
+   socket->lockHeld = held;
+#endif
+}
+
+
+#if (SOCKET_LOCK_SUPPORT == ENABLED)
+
+/**
+ * @brief Events awaited by the tasks blocked on a socket
+ * @param[in] socket Handle that identifies a socket
+ * @return Logic OR of their event masks
+ **/
+
+static uint_t socketGetWaitMask(Socket *socket)
+{
+   uint_t eventMask;
+   SocketWaiter *waiter;
+
+   //Merge the events of all the tasks
+   for(eventMask = 0, waiter = socket->waiters; waiter != NULL;
+      waiter = waiter->next)
+   {
+      eventMask |= waiter->eventMask;
+   }
+
+   //Return the resulting mask
+   return eventMask;
+}
+
+#endif
+
+
+/**
+ * @brief Wait for events on a socket
+ *
+ * The caller holds the netMutex and has checked that none of the events is
+ * signaled. The netMutex and the socket lock are released while waiting.
+ * With SOCKET_LOCK_SUPPORT, several tasks may wait at the same time, each
+ * on an event object of its own: the event mask of the socket covers those
+ * of all of them, and socketNotifyWaiters wakes up the ones concerned
+ *
+ * @param[in] socket Handle that identifies a socket
+ * @param[in] eventMask Events the task is waiting for
+ * @param[in] timeout Maximum time to wait
+ **/
+
+void socketWaitForEvent(Socket *socket, uint_t eventMask, systime_t timeout)
+{
+   bool_t held;
+#if (SOCKET_LOCK_SUPPORT == ENABLED)
+   SocketWaiter waiter;
+   SocketWaiter **p;
+
+   //Register the task
+   waiter.eventMask = eventMask;
+   waiter.next = socket->waiters;
+
+   //The event object is only created if the port requires it
+   if(!osCreateEvent(&waiter.event))
+      return;
+
+   socket->waiters = &waiter;
+
+   //Set the events the tasks are interested in
+   socket->eventMask = socketGetWaitMask(socket);
+
+   //Release the locks
+   held = socketSuspendLock(socket);
+   //Wait until an event is triggered
+   osWaitForEvent(&waiter.event, timeout);
+   //Get them back
+   socketResumeLock(socket, held);
+
+   //Unregister the task. The socket may have been released and allocated
+   //again meanwhile, in which case the task is no longer on the list
+   for(p = &socket->waiters; *p != NULL; p = &(*p)->next)
+   {
+      if(*p == &waiter)
+      {
+         *p = waiter.next;
+         break;
+      }
+   }
+
+   //The events of the other tasks are still needed. Otherwise the mask
+   //is left as is, so that the event flags keep their meaning
+   if(socket->waiters != NULL)
+   {
+      socket->eventMask = socketGetWaitMask(socket);
+   }
+
+   //Dispose the event object
+   osDeleteEvent(&waiter.event);
+#else
+   //Set the events the application is interested in
+   socket->eventMask = eventMask;
+   //Reset the event object
+   osResetEvent(&socket->event);
+
+   //Release exclusive access
+   held = socketSuspendLock(socket);
+   //Wait until an event is triggered
+   osWaitForEvent(&socket->event, timeout);
+   //Get exclusive access
+   socketResumeLock(socket, held);
+#endif
+}
+
+
+/**
+ * @brief Wake up the tasks waiting for the events signaled on a socket
+ * @param[in] socket Handle that identifies a socket
+ **/
+
+void socketNotifyWaiters(Socket *socket)
+{
+#if (SOCKET_LOCK_SUPPORT == ENABLED)
+   SocketWaiter *waiter;
+
+   //Only the tasks concerned are woken up
+   for(waiter = socket->waiters; waiter != NULL; waiter = waiter->next)
+   {
+      if((socket->eventFlags & waiter->eventMask) != 0)
+      {
+         osSetEvent(&waiter->event);
+      }
+   }
+#endif
+}
+
+
+/**
+ * @brief Retrieve the cached route to a destination
+ *
+ * On a hit, the outgoing interface, the source address and the next-hop MAC
+ * address are filled in, so that neither source address selection nor
+ * address resolution has to be performed again. The interface and source
+ * address, when already specified by the caller, must match the cached route
+ *
+ * @param[in] socket Handle that identifies a socket
+ * @param[in] destIpAddr Destination IP address
+ * @param[in,out] interface Outgoing interface
+ * @param[in,out] srcIpAddr Source IP address
+ * @param[in,out] ancillary Additional options passed to the stack along with
+ *   the packet
+ * @return TRUE if the cached route can be used, else FALSE
+ **/
+
+bool_t socketGetCachedRoute(Socket *socket, const IpAddr *destIpAddr,
+   NetInterface **interface, IpAddr *srcIpAddr, NetTxAncillary *ancillary)
+{
+#if (SOCKET_ROUTE_CACHE_SUPPORT == ENABLED && (IPV4_SUPPORT == ENABLED || \
+   IPV6_SUPPORT == ENABLED))
+   SocketRouteCache *cache;
+
+   //Point to the route cache of the socket
+   cache = &socket->routeCache;
+
+   //Routes have changed since the entry was filled?
+   if(!cache->valid || cache->generation != netContext.routeGeneration)
+      return FALSE;
+
+   //The entry must describe the route to the same destination
+   if(!ipCompAddr(destIpAddr, &cache->destIpAddr))
+      return FALSE;
+
+   //Check the outgoing interface
+   if(*interface != NULL && *interface != cache->interface)
+      return FALSE;
+
+   //Check the source address
+   if(srcIpAddr->length != 0 && !ipCompAddr(srcIpAddr, &cache->srcIpAddr))
+      return FALSE;
+
+   //Use the cached route
+   *interface = cache->interface;
+   *srcIpAddr = cache->srcIpAddr;
+
+#if (ETH_SUPPORT == ENABLED)
+   //The next-hop MAC address is already resolved
+   ancillary->destMacAddr = cache->destMacAddr;
+#endif
+
+   //The cached route can be used
+   return TRUE;
+#else
+   //Route caching is not supported
+   return FALSE;
+#endif
+}
+
+
+/**
+ * @brief Save the route used to reach a destination
+ *
+ * Packets waiting for address resolution do not carry a next-hop MAC
+ * address. In that case nothing is cached and the next send will go
+ * through address resolution again
+ *
+ * @param[in] socket Handle that identifies a socket
+ * @param[in] interface Outgoing interface
+ * @param[in] srcIpAddr Source IP address
+ * @param[in] destIpAddr Destination IP address
+ * @param[in] ancillary Additional options the packet was sent with
+ **/
+
+void socketUpdateCachedRoute(Socket *socket, NetInterface *interface,
+   const IpAddr *srcIpAddr, const IpAddr *destIpAddr,
+   const NetTxAncillary *ancillary)
+{
+#if (SOCKET_ROUTE_CACHE_SUPPORT == ENABLED && (IPV4_SUPPORT == ENABLED || \
+   IPV6_SUPPORT == ENABLED))
+   SocketRouteCache *cache;
+#if (ETH_SUPPORT == ENABLED)
+   NetInterface *physicalInterface;
+#endif
+
+   //Point to the route cache of the socket
+   cache = &socket->routeCache;
+
+   //The source and destination addresses must belong to the same family
+   if(interface == NULL || destIpAddr->length == 0 ||
+      srcIpAddr->length != destIpAddr->length)
+   {
+      return;
+   }
+
+#if (ETH_SUPPORT == ENABLED)
+   //Point to the physical interface
+   physicalInterface = nicGetPhysicalInterface(interface);
+
+   //Ethernet interface whose next hop is not resolved yet?
+   if(physicalInterface->nicDriver != NULL &&
+      physicalInterface->nicDriver->type == NIC_TYPE_ETHERNET &&
+      macCompAddr(&ancillary->destMacAddr, &MAC_UNSPECIFIED_ADDR))
+   {
+      //Do not cache an incomplete route
+      cache->valid = FALSE;
+      return;
+   }
+
+   //Save the next-hop MAC address
+   cache->destMacAddr = ancillary->destMacAddr;
+#endif
+
+   //Save the route
+   cache->interface = interface;
+   cache->srcIpAddr = *srcIpAddr;
+   cache->destIpAddr = *destIpAddr;
+
+   //The route remains valid until routes or neighbors change
+   cache->generation = netContext.routeGeneration;
+   cache->valid = TRUE;
+#endif
+}
+
+
+/**
+ * @brief Compute the demultiplexing hash of an incoming packet
+ * @param[in] protocol Transport protocol (TCP or UDP)
+ * @param[in] pseudoHeader Pseudo header of the incoming packet
+ * @param[in] srcPort Source port number
+ * @param[in] destPort Destination port number
+ * @return Index in the demultiplexing cache
+ **/
+
+uint_t socketComputeHash(uint_t protocol, const IpPseudoHeader *pseudoHeader,
+   uint16_t srcPort, uint16_t destPort)
+{
+#if (SOCKET_HASH_TABLE_SIZE > 0)
+   uint32_t h;
+
+   //Combine the protocol and the port numbers
+   h = (protocol << 24) ^ (srcPort << 16) ^ destPort;
+
+#if (IPV4_SUPPORT == ENABLED)
+   //IPv4 packet?
+   if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
+   {
+      //Mix the source and destination addresses
+      h ^= pseudoHeader->ipv4Data.srcAddr;
+      h ^= (pseudoHeader->ipv4Data.destAddr << 16) |
+         (pseudoHeader->ipv4Data.destAddr >> 16);
+   }
+   else
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   //IPv6 packet?
+   if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
+   {
+      //Mix the source address and the interface identifier of the
+      //destination address
+      h ^= pseudoHeader->ipv6Data.srcAddr.dw[0];
+      h ^= pseudoHeader->ipv6Data.srcAddr.dw[1];
+      h ^= pseudoHeader->ipv6Data.srcAddr.dw[2];
+      h ^= pseudoHeader->ipv6Data.srcAddr.dw[3];
+      h ^= (pseudoHeader->ipv6Data.destAddr.dw[3] << 16) |
+         (pseudoHeader->ipv6Data.destAddr.dw[3] >> 16);
+   }
+#endif
+
+   //Final avalanche so that every input bit affects the index
+   h ^= h >> 16;
+   h *= 0x85EBCA6B;
+   h ^= h >> 13;
+   h *= 0xC2B2AE35;
+   h ^= h >> 16;
+
+   //Return the index in the demultiplexing cache
+   return h % SOCKET_HASH_TABLE_SIZE;
+#else
+   //The demultiplexing cache is not implemented
+   return 0;
+#endif
+}
+
+
+/**
+ * @brief Look up the demultiplexing cache
+ *
+ * The returned socket is only a hint. The caller must check that it still
+ * matches the incoming packet before using it
+ *
+ * @param[in] index Index in the demultiplexing cache
+ * @return Candidate socket, or NULL if the entry is empty
+ **/
+
+Socket *socketHashLookup(uint_t index)
+{
+#if (SOCKET_HASH_TABLE_SIZE > 0)
+   //Return the socket that matched the last packet hashed to this entry
+   return socketHashTable[index];
+#else
+   //The demultiplexing cache is not implemented
+   return NULL;
+#endif
+}
+
+
+/**
+ * @brief Save a socket in the demultiplexing cache
+ * @param[in] index Index in the demultiplexing cache
+ * @param[in] socket Socket found by scanning the socket table
+ **/
+
+void socketHashInsert(uint_t index, Socket *socket)
+{
+#if (SOCKET_HASH_TABLE_SIZE > 0)
+   //Colliding flows simply overwrite each other
+   socketHashTable[index] = socket;
+#endif
+}
+
+
+/**
+ * @brief Remove a socket from the demultiplexing cache
+ *
+ * Must be called once the endpoints of a socket have changed. The entries
+ * that refer to the socket are removed, together with those of the sockets
+ * bound to the same port, which the socket may now shadow in a scan of the
+ * socket table. The rest of the cache is left alone
+ *
+ * @param[in] socket Socket whose endpoints have changed
+ **/
+
+void socketHashEvict(Socket *socket)
+{
+#if (SOCKET_HASH_TABLE_SIZE > 0)
+   uint_t i;
+   Socket *entry;
+
+   //Loop through the demultiplexing cache
+   for(i = 0; i < SOCKET_HASH_TABLE_SIZE; i++)
+   {
+      //Point to the current entry
+      entry = socketHashTable[i];
+
+      //Clear the entries that may no longer yield the same socket as a scan
+      if(entry == socket || (entry != NULL &&
+         entry->protocol == socket->protocol &&
+         entry->localPort == socket->localPort))
+      {
+         socketHashTable[i] = NULL;
+      }
+   }
+#endif
+}
+
+
 /**
  * @brief Subscribe to the specified socket events
  * @param[in] socket Handle that identifies a socket
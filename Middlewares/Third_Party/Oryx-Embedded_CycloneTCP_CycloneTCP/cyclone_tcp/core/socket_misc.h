@@ -43,6 +43,28 @@ extern "C" {
 //Socket related functions
 Socket *socketAllocate(uint_t type, uint_t protocol);
 
+void socketAcquireLock(Socket *socket);
+void socketReleaseLock(Socket *socket);
+bool_t socketSuspendLock(Socket *socket);
+void socketResumeLock(Socket *socket, bool_t held);
+
+void socketWaitForEvent(Socket *socket, uint_t eventMask, systime_t timeout);
+void socketNotifyWaiters(Socket *socket);
+
+bool_t socketGetCachedRoute(Socket *socket, const IpAddr *destIpAddr,
+   NetInterface **interface, IpAddr *srcIpAddr, NetTxAncillary *ancillary);
+
+void socketUpdateCachedRoute(Socket *socket, NetInterface *interface,
+   const IpAddr *srcIpAddr, const IpAddr *destIpAddr,
+   const NetTxAncillary *ancillary);
+
+uint_t socketComputeHash(uint_t protocol, const IpPseudoHeader *pseudoHeader,
+   uint16_t srcPort, uint16_t destPort);
+
+Socket *socketHashLookup(uint_t index);
+void socketHashInsert(uint_t index, Socket *socket);
+void socketHashEvict(Socket *socket);
+
 void socketRegisterEvents(Socket *socket, OsEvent *event, uint_t eventMask);
 void socketUnregisterEvents(Socket *socket);
 uint_t socketGetEvents(Socket *socket);
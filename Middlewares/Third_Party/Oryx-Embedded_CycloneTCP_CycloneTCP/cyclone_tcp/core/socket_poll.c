@@ -0,0 +1,579 @@
+/**
+ * @file socket_poll.c
+ * @brief Persistent poll sets with ready lists
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ *
+ * @section Description
+ *
+ * socketPoll registers its events on every socket at each call and checks
+ * every socket again when it wakes up. A poll set keeps its sockets and
+ * their events of interest between waits instead. The TCP, UDP and raw
+ * socket event updates queue a socket on the ready list of its set as soon
+ * as one of these events is signaled, so a wait only visits the sockets that
+ * are ready, whatever the size of the set
+ *
+ * A level-triggered socket is reported by every wait as long as its events
+ * are signaled. An edge-triggered socket is reported once each time one of
+ * its events goes from clear to signaled
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL SOCKET_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/socket_poll.h"
+#include "core/tcp_misc.h"
+#include "core/udp.h"
+#include "core/raw_socket.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (SOCKET_POLL_SUPPORT == ENABLED)
+
+
+/**
+ * @brief Create a poll set
+ * @param[out] set Poll set to initialize
+ * @return Error code
+ **/
+
+error_t socketPollCreate(SocketPollSet *set)
+{
+   //Check parameters
+   if(set == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //The set is empty
+   set->readyHead = NULL;
+   set->readyTail = NULL;
+   set->count = 0;
+
+   //Create the event object the waits block on
+   if(!osCreateEvent(&set->event))
+      return ERROR_OUT_OF_RESOURCES;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Delete a poll set
+ * @param[in] set Poll set to delete
+ **/
+
+void socketPollDelete(SocketPollSet *set)
+{
+   uint_t i;
+
+   //Valid poll set?
+   if(set != NULL)
+   {
+      //Get exclusive access
+      osAcquireMutex(&netMutex);
+
+      //Remove the sockets still in the set
+      for(i = 0; i < SOCKET_MAX_COUNT && set->count > 0; i++)
+      {
+         if(socketTable[i].pollSet == set)
+         {
+            socketPollDetach(&socketTable[i]);
+         }
+      }
+
+      //Release exclusive access
+      osReleaseMutex(&netMutex);
+
+      //Delete the event object
+      osDeleteEvent(&set->event);
+   }
+}
+
+
+/**
+ * @brief Compute the current events of a socket
+ * @param[in] socket Handle referencing the socket
+ **/
+
+static void socketPollRefresh(Socket *socket)
+{
+#if (TCP_SUPPORT == ENABLED)
+   //Handle TCP specific events
+   if(socket->type == SOCKET_TYPE_STREAM)
+   {
+      tcpUpdateEvents(socket);
+   }
+#endif
+#if (UDP_SUPPORT == ENABLED)
+   //Handle UDP specific events
+   if(socket->type == SOCKET_TYPE_DGRAM)
+   {
+      udpUpdateEvents(socket);
+   }
+#endif
+#if (RAW_SOCKET_SUPPORT == ENABLED)
+   //Handle events that are specific to raw sockets
+   if(socket->type == SOCKET_TYPE_RAW_IP ||
+      socket->type == SOCKET_TYPE_RAW_ETH)
+   {
+      rawSocketUpdateEvents(socket);
+   }
+#endif
+}
+
+
+/**
+ * @brief Remove a socket from the ready list of its poll set
+ * @param[in] socket Handle referencing the socket
+ **/
+
+static void socketPollUnlink(Socket *socket)
+{
+   SocketPollSet *set;
+
+   //Point to the poll set
+   set = socket->pollSet;
+
+   //Queued socket?
+   if(socket->pollQueued)
+   {
+      if(socket->pollPrev != NULL)
+      {
+         socket->pollPrev->pollNext = socket->pollNext;
+      }
+      else
+      {
+         set->readyHead = socket->pollNext;
+      }
+
+      if(socket->pollNext != NULL)
+      {
+         socket->pollNext->pollPrev = socket->pollPrev;
+      }
+      else
+      {
+         set->readyTail = socket->pollPrev;
+      }
+
+      socket->pollPrev = NULL;
+      socket->pollNext = NULL;
+      socket->pollQueued = FALSE;
+   }
+}
+
+
+/**
+ * @brief Append a socket to the ready list of its poll set
+ * @param[in] socket Handle referencing the socket
+ **/
+
+static void socketPollLink(Socket *socket)
+{
+   SocketPollSet *set;
+
+   //Point to the poll set
+   set = socket->pollSet;
+
+   //Not yet queued?
+   if(!socket->pollQueued)
+   {
+      socket->pollPrev = set->readyTail;
+      socket->pollNext = NULL;
+
+      if(set->readyTail != NULL)
+      {
+         set->readyTail->pollNext = socket;
+      }
+      else
+      {
+         set->readyHead = socket;
+      }
+
+      set->readyTail = socket;
+      socket->pollQueued = TRUE;
+   }
+}
+
+
+/**
+ * @brief Add a socket to a poll set
+ * @param[in] set Poll set
+ * @param[in] socket Handle referencing the socket
+ * @param[in] eventMask Logic OR of the events of interest
+ * @param[in] mode Level-triggered or edge-triggered
+ * @return Error code
+ **/
+
+error_t socketPollAdd(SocketPollSet *set, Socket *socket, uint_t eventMask,
+   SocketPollMode mode)
+{
+   error_t error;
+
+   //Check parameters
+   if(set == NULL || socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //A socket belongs to one poll set at most
+   if(socket->pollSet == NULL)
+   {
+      socket->pollSet = set;
+      socket->pollMask = eventMask;
+      socket->pollMode = mode;
+      socket->pollLevel = 0;
+      socket->pollPending = 0;
+      socket->pollQueued = FALSE;
+      socket->pollPrev = NULL;
+      socket->pollNext = NULL;
+      set->count++;
+
+      //Events already signaled are reported by the next wait
+      socketPollRefresh(socket);
+
+      //Successful processing
+      error = NO_ERROR;
+   }
+   else
+   {
+      //Report an error
+      error = ERROR_ALREADY_CONFIGURED;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Change the events of interest of a socket in a poll set
+ * @param[in] set Poll set
+ * @param[in] socket Handle referencing the socket
+ * @param[in] eventMask Logic OR of the events of interest
+ * @param[in] mode Level-triggered or edge-triggered
+ * @return Error code
+ **/
+
+error_t socketPollModify(SocketPollSet *set, Socket *socket, uint_t eventMask,
+   SocketPollMode mode)
+{
+   error_t error;
+
+   //Check parameters
+   if(set == NULL || socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Make sure the socket belongs to the set
+   if(socket->pollSet == set)
+   {
+      socket->pollMask = eventMask;
+      socket->pollMode = mode;
+      socket->pollLevel = 0;
+      socket->pollPending = 0;
+
+      //Pending reports are computed again against the new mask
+      socketPollUnlink(socket);
+      socketPollRefresh(socket);
+
+      //Successful processing
+      error = NO_ERROR;
+   }
+   else
+   {
+      //Report an error
+      error = ERROR_NOT_FOUND;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Remove a socket from a poll set
+ * @param[in] set Poll set
+ * @param[in] socket Handle referencing the socket
+ * @return Error code
+ **/
+
+error_t socketPollRemove(SocketPollSet *set, Socket *socket)
+{
+   error_t error;
+
+   //Check parameters
+   if(set == NULL || socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Make sure the socket belongs to the set
+   if(socket->pollSet == set)
+   {
+      socketPollDetach(socket);
+      error = NO_ERROR;
+   }
+   else
+   {
+      error = ERROR_NOT_FOUND;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Report the ready sockets of a poll set
+ * @param[in] set Poll set
+ * @param[out] eventDesc Array receiving the sockets and their events
+ * @param[in] size Number of entries in the array
+ * @return Number of entries filled
+ **/
+
+static uint_t socketPollCollect(SocketPollSet *set, SocketEventDesc *eventDesc,
+   uint_t size)
+{
+   uint_t n;
+   uint_t eventFlags;
+   Socket *socket;
+   Socket *last;
+
+   //Sockets queued again by this call are left for the next one
+   last = set->readyTail;
+
+   //Loop through the ready list
+   for(n = 0; n < size && set->readyHead != NULL; )
+   {
+      //Remove the first socket from the list
+      socket = set->readyHead;
+      socketPollUnlink(socket);
+
+      //Events to report
+      if(socket->pollMode == SOCKET_POLL_MODE_EDGE)
+      {
+         eventFlags = socket->pollPending;
+         socket->pollPending = 0;
+      }
+      else
+      {
+         eventFlags = socket->pollLevel;
+      }
+
+      //The events may have been cleared since the socket was queued
+      if(eventFlags != 0)
+      {
+         eventDesc[n].socket = socket;
+         eventDesc[n].eventMask = socket->pollMask;
+         eventDesc[n].eventFlags = eventFlags;
+         n++;
+
+         //A level-triggered socket stays ready until its events are cleared
+         if(socket->pollMode == SOCKET_POLL_MODE_LEVEL)
+         {
+            socketPollLink(socket);
+         }
+      }
+
+      //End of the sockets that were ready on entry?
+      if(socket == last)
+         break;
+   }
+
+   //Return the number of ready sockets
+   return n;
+}
+
+
+/**
+ * @brief Wait for sockets of a poll set to become ready
+ * @param[in] set Poll set
+ * @param[out] eventDesc Array receiving the ready sockets and their events
+ * @param[in] size Number of entries in the array
+ * @param[out] count Number of entries filled
+ * @param[in] timeout Maximum time to wait
+ * @return Error code
+ **/
+
+error_t socketPollWait(SocketPollSet *set, SocketEventDesc *eventDesc,
+   uint_t size, uint_t *count, systime_t timeout)
+{
+   error_t error;
+   uint_t n;
+
+   //Check parameters
+   if(set == NULL || eventDesc == NULL || size == 0 || count == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Report the sockets that are already ready
+   n = socketPollCollect(set, eventDesc, size);
+
+   //The event is signaled again by the next socket that becomes ready
+   if(n == 0)
+   {
+      osResetEvent(&set->event);
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Any socket ready?
+   if(n > 0)
+   {
+      error = NO_ERROR;
+   }
+   else if(timeout == 0)
+   {
+      error = ERROR_TIMEOUT;
+   }
+   else if(osWaitForEvent(&set->event, timeout))
+   {
+      //Get exclusive access
+      osAcquireMutex(&netMutex);
+      //Report the sockets that became ready
+      n = socketPollCollect(set, eventDesc, size);
+      //Release exclusive access
+      osReleaseMutex(&netMutex);
+
+      //The wait may have been cancelled by socketPollWakeUp
+      error = (n > 0) ? NO_ERROR : ERROR_WAIT_CANCELED;
+   }
+   else
+   {
+      //Report a timeout error
+      error = ERROR_TIMEOUT;
+   }
+
+   //Return the number of ready sockets
+   *count = n;
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Cancel the wait on a poll set
+ * @param[in] set Poll set
+ **/
+
+void socketPollWakeUp(SocketPollSet *set)
+{
+   //Valid poll set?
+   if(set != NULL)
+   {
+      osSetEvent(&set->event);
+   }
+}
+
+
+/**
+ * @brief Queue a socket whose events of interest are signaled
+ *
+ * Called by the event updates of the TCP, UDP and raw sockets, with the
+ * TCP/IP stack mutex held
+ *
+ * @param[in] socket Handle referencing the socket
+ * @param[in] eventFlags Events currently signaled on the socket
+ **/
+
+void socketPollUpdate(Socket *socket, uint_t eventFlags)
+{
+   //Not in a poll set?
+   if(socket->pollSet == NULL)
+      return;
+
+   //Keep the events of interest
+   eventFlags &= socket->pollMask;
+
+   //Edge-triggered socket?
+   if(socket->pollMode == SOCKET_POLL_MODE_EDGE)
+   {
+      //Only the events that have just been signaled are reported
+      socket->pollPending |= eventFlags & ~socket->pollLevel;
+   }
+
+   //Save the events currently signaled
+   socket->pollLevel = eventFlags;
+
+   //Anything to report?
+   if((socket->pollMode == SOCKET_POLL_MODE_EDGE && socket->pollPending != 0) ||
+      (socket->pollMode == SOCKET_POLL_MODE_LEVEL && socket->pollLevel != 0))
+   {
+      //Wake up the task waiting on the set once per socket
+      if(!socket->pollQueued)
+      {
+         socketPollLink(socket);
+         osSetEvent(&socket->pollSet->event);
+      }
+   }
+}
+
+
+/**
+ * @brief Remove a socket from its poll set
+ *
+ * Called with the TCP/IP stack mutex held, when the socket is removed from
+ * the set or closed
+ *
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void socketPollDetach(Socket *socket)
+{
+   //In a poll set?
+   if(socket->pollSet != NULL)
+   {
+      //Remove the socket from the ready list
+      socketPollUnlink(socket);
+
+      //Update the number of sockets in the set
+      socket->pollSet->count--;
+      socket->pollSet = NULL;
+   }
+}
+
+#endif
@@ -0,0 +1,80 @@
+/**
+ * @file socket_poll.h
+ * @brief Persistent poll sets with ready lists
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+#ifndef _SOCKET_POLL_H
+#define _SOCKET_POLL_H
+
+//Dependencies
+#include "core/net.h"
+#include "core/socket.h"
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Poll modes
+ **/
+
+typedef enum
+{
+   SOCKET_POLL_MODE_LEVEL = 0, ///<Reported as long as the events are signaled
+   SOCKET_POLL_MODE_EDGE  = 1  ///<Reported once each time the events rise
+} SocketPollMode;
+
+
+//Poll set related functions
+error_t socketPollCreate(SocketPollSet *set);
+void socketPollDelete(SocketPollSet *set);
+
+error_t socketPollAdd(SocketPollSet *set, Socket *socket, uint_t eventMask,
+   SocketPollMode mode);
+
+error_t socketPollModify(SocketPollSet *set, Socket *socket, uint_t eventMask,
+   SocketPollMode mode);
+
+error_t socketPollRemove(SocketPollSet *set, Socket *socket);
+
+error_t socketPollWait(SocketPollSet *set, SocketEventDesc *eventDesc,
+   uint_t size, uint_t *count, systime_t timeout);
+
+void socketPollWakeUp(SocketPollSet *set);
+
+void socketPollUpdate(Socket *socket, uint_t eventFlags);
+void socketPollDetach(Socket *socket);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
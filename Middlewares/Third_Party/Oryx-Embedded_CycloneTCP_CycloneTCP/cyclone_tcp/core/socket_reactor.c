@@ -0,0 +1,421 @@
+/**
+ * @file socket_reactor.c
+ * @brief Callback-driven socket reactor
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ *
+ * @section Description
+ *
+ * A blocking server needs one task, and one stack, per connection. The
+ * reactor serves many sockets from a few worker tasks instead: each worker
+ * owns a poll set, waits on it and runs the handlers of the sockets that
+ * are ready. A socket is assigned to the least loaded worker when it is
+ * added, and stays with it, so that its handlers never run concurrently
+ *
+ * The handlers run in the worker tasks rather than in the TCP/IP task, so
+ * that they can call the socket API, which takes the TCP/IP stack mutex
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL SOCKET_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/socket_poll.h"
+#include "core/socket_reactor.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (SOCKET_REACTOR_SUPPORT == ENABLED && SOCKET_POLL_SUPPORT == ENABLED)
+
+
+/**
+ * @brief Initialize settings with default values
+ * @param[out] settings Structure that contains socket reactor settings
+ **/
+
+void socketReactorGetDefaultSettings(SocketReactorSettings *settings)
+{
+   uint_t i;
+
+   //Default task parameters
+   for(i = 0; i < SOCKET_REACTOR_MAX_WORKERS; i++)
+   {
+      settings->task[i] = OS_TASK_DEFAULT_PARAMS;
+      settings->task[i].stackSize = SOCKET_REACTOR_STACK_SIZE;
+      settings->task[i].priority = SOCKET_REACTOR_PRIORITY;
+   }
+
+   //A single worker serves all the sockets
+   settings->numWorkers = 1;
+}
+
+
+/**
+ * @brief Socket reactor initialization
+ * @param[in] context Pointer to the socket reactor context
+ * @param[in] settings Socket reactor specific settings
+ * @return Error code
+ **/
+
+error_t socketReactorInit(SocketReactorContext *context,
+   const SocketReactorSettings *settings)
+{
+   error_t error;
+   uint_t i;
+
+   //Check parameters
+   if(context == NULL || settings == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Invalid number of workers?
+   if(settings->numWorkers < 1 ||
+      settings->numWorkers > SOCKET_REACTOR_MAX_WORKERS)
+   {
+      return ERROR_INVALID_PARAMETER;
+   }
+
+   //Clear the socket reactor context
+   osMemset(context, 0, sizeof(SocketReactorContext));
+
+   //Number of worker tasks
+   context->numWorkers = settings->numWorkers;
+
+   //Initialize worker tasks
+   for(error = NO_ERROR, i = 0; i < context->numWorkers && !error; i++)
+   {
+      context->workers[i].context = context;
+      context->workers[i].taskParams = settings->task[i];
+      context->workers[i].taskId = OS_INVALID_TASK_ID;
+
+      //Create the poll set of the worker
+      error = socketPollCreate(&context->workers[i].set);
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Start the worker tasks
+ * @param[in] context Pointer to the socket reactor context
+ * @return Error code
+ **/
+
+error_t socketReactorStart(SocketReactorContext *context)
+{
+   uint_t i;
+   SocketReactorWorker *worker;
+
+   //Make sure the socket reactor context is valid
+   if(context == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Loop through worker tasks
+   for(i = 0; i < context->numWorkers; i++)
+   {
+      //Point to the current worker
+      worker = &context->workers[i];
+
+      //Already running?
+      if(worker->taskId != OS_INVALID_TASK_ID)
+         continue;
+
+      //Create a task
+      worker->taskId = osCreateTask("Reactor", (OsTaskCode) socketReactorTask,
+         worker, &worker->taskParams);
+
+      //Unable to create the task?
+      if(worker->taskId == OS_INVALID_TASK_ID)
+         return ERROR_OUT_OF_RESOURCES;
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Events of interest of a socket
+ * @param[in] writable Report the room in the send buffer
+ * @return Logic OR of the socket events
+ **/
+
+static uint_t socketReactorGetEventMask(bool_t writable)
+{
+   uint_t eventMask;
+
+   //Connection requests, incoming data and end of the connection
+   eventMask = SOCKET_EVENT_ACCEPT | SOCKET_EVENT_RX_READY |
+      SOCKET_EVENT_CLOSED;
+
+   //The send buffer is rarely full, so that room is only reported on demand
+   if(writable)
+   {
+      eventMask |= SOCKET_EVENT_TX_READY;
+   }
+
+   //Return the events of interest
+   return eventMask;
+}
+
+
+/**
+ * @brief Add a socket to the reactor
+ *
+ * A TCP socket is added once it is listening or connected, since a socket
+ * in the CLOSED state would be reported closed at once
+ *
+ * @param[in] context Pointer to the socket reactor context
+ * @param[in] socket Handle referencing the socket
+ * @param[in] handlers Handlers of the socket
+ * @param[in] param Opaque parameter passed to the handlers
+ * @return Error code
+ **/
+
+error_t socketReactorAdd(SocketReactorContext *context, Socket *socket,
+   const SocketReactorHandlers *handlers, void *param)
+{
+   error_t error;
+   uint_t i;
+   uint_t worker;
+   SocketReactorEntry *entry;
+
+   //Check parameters
+   if(context == NULL || socket == NULL || handlers == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Make sure the socket handle is valid
+   if(socket < socketTable || socket >= (socketTable + SOCKET_MAX_COUNT))
+      return ERROR_INVALID_PARAMETER;
+
+   //Assign the socket to the least loaded worker
+   for(worker = 0, i = 1; i < context->numWorkers; i++)
+   {
+      if(context->workers[i].set.count < context->workers[worker].set.count)
+      {
+         worker = i;
+      }
+   }
+
+   //Point to the entry of the socket
+   entry = &context->entries[socket - socketTable];
+
+   //The entry is set before the socket can be reported ready
+   entry->handlers = handlers;
+   entry->param = param;
+   entry->worker = worker;
+
+   //Add the socket to the poll set of the worker
+   error = socketPollAdd(&context->workers[worker].set, socket,
+      socketReactorGetEventMask(FALSE), SOCKET_POLL_MODE_LEVEL);
+
+   //Any error to report?
+   if(error)
+   {
+      entry->handlers = NULL;
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Enable or disable the writable handler of a socket
+ * @param[in] context Pointer to the socket reactor context
+ * @param[in] socket Handle referencing the socket
+ * @param[in] enabled The writable handler runs while the send buffer has
+ *   room, until disabled
+ * @return Error code
+ **/
+
+error_t socketReactorSetWritable(SocketReactorContext *context,
+   Socket *socket, bool_t enabled)
+{
+   SocketReactorEntry *entry;
+
+   //Check parameters
+   if(context == NULL || socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Make sure the socket handle is valid
+   if(socket < socketTable || socket >= (socketTable + SOCKET_MAX_COUNT))
+      return ERROR_INVALID_PARAMETER;
+
+   //Point to the entry of the socket
+   entry = &context->entries[socket - socketTable];
+
+   //Update the events of interest
+   return socketPollModify(&context->workers[entry->worker].set, socket,
+      socketReactorGetEventMask(enabled), SOCKET_POLL_MODE_LEVEL);
+}
+
+
+/**
+ * @brief Remove a socket from the reactor
+ *
+ * Called from a handler of the socket, or from another task when no handler
+ * of the socket can be running. A socket is removed before it is closed
+ *
+ * @param[in] context Pointer to the socket reactor context
+ * @param[in] socket Handle referencing the socket
+ * @return Error code
+ **/
+
+error_t socketReactorRemove(SocketReactorContext *context, Socket *socket)
+{
+   error_t error;
+   SocketReactorEntry *entry;
+
+   //Check parameters
+   if(context == NULL || socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Make sure the socket handle is valid
+   if(socket < socketTable || socket >= (socketTable + SOCKET_MAX_COUNT))
+      return ERROR_INVALID_PARAMETER;
+
+   //Point to the entry of the socket
+   entry = &context->entries[socket - socketTable];
+
+   //Remove the socket from the poll set of its worker
+   error = socketPollRemove(&context->workers[entry->worker].set, socket);
+
+   //The pending reports of the socket are no longer dispatched
+   entry->handlers = NULL;
+   entry->param = NULL;
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Run the handlers of a ready socket
+ * @param[in] context Pointer to the socket reactor context
+ * @param[in] eventDesc Socket and events to dispatch
+ **/
+
+static void socketReactorDispatch(SocketReactorContext *context,
+   const SocketEventDesc *eventDesc)
+{
+   Socket *socket;
+   SocketReactorEntry *entry;
+   const SocketReactorHandlers *handlers;
+
+   //Point to the entry of the socket
+   socket = eventDesc->socket;
+   entry = &context->entries[socket - socketTable];
+
+   //Removed by a handler of another socket of the same batch?
+   if(entry->handlers == NULL)
+      return;
+
+   //Point to the handlers
+   handlers = entry->handlers;
+
+   //A listening socket is also readable when a connection request is pending
+   if((eventDesc->eventFlags & SOCKET_EVENT_ACCEPT) != 0)
+   {
+      if(handlers->acceptCallback != NULL)
+      {
+         handlers->acceptCallback(socket, entry->param);
+      }
+   }
+   else if((eventDesc->eventFlags & SOCKET_EVENT_RX_READY) != 0)
+   {
+      if(handlers->readableCallback != NULL)
+      {
+         handlers->readableCallback(socket, entry->param);
+      }
+   }
+
+   //Room in the send buffer?
+   if(entry->handlers != NULL &&
+      (eventDesc->eventFlags & SOCKET_EVENT_TX_READY) != 0)
+   {
+      if(handlers->writableCallback != NULL)
+      {
+         handlers->writableCallback(socket, entry->param);
+      }
+   }
+
+   //Closed connection? It stays closed, so the socket leaves the reactor
+   //before its last handler runs
+   if(entry->handlers != NULL &&
+      (eventDesc->eventFlags & SOCKET_EVENT_CLOSED) != 0)
+   {
+      void *param = entry->param;
+
+      //Remove the socket from the reactor
+      socketReactorRemove(context, socket);
+
+      if(handlers->closedCallback != NULL)
+      {
+         handlers->closedCallback(socket, param);
+      }
+   }
+}
+
+
+/**
+ * @brief Worker task
+ * @param[in] worker Pointer to the worker
+ **/
+
+void socketReactorTask(SocketReactorWorker *worker)
+{
+   error_t error;
+   uint_t i;
+   uint_t n;
+
+   //Task prologue
+   osEnterTask();
+
+   //Process events
+   while(1)
+   {
+      //Wait for sockets of the worker to become ready
+      error = socketPollWait(&worker->set, worker->eventDesc,
+         SOCKET_REACTOR_MAX_EVENTS, &n, INFINITE_DELAY);
+
+      //Any socket ready?
+      if(!error)
+      {
+         //Run their handlers
+         for(i = 0; i < n; i++)
+         {
+            socketReactorDispatch(worker->context, &worker->eventDesc[i]);
+         }
+      }
+   }
+}
+
+#endif
@@ -0,0 +1,174 @@
+/**
+ * @file socket_reactor.h
+ * @brief Callback-driven socket reactor
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+#ifndef _SOCKET_REACTOR_H
+#define _SOCKET_REACTOR_H
+
+//Dependencies
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/socket_poll.h"
+
+//Socket reactor support
+#ifndef SOCKET_REACTOR_SUPPORT
+   #define SOCKET_REACTOR_SUPPORT DISABLED
+#elif (SOCKET_REACTOR_SUPPORT != ENABLED && SOCKET_REACTOR_SUPPORT != DISABLED)
+   #error SOCKET_REACTOR_SUPPORT parameter is not valid
+#endif
+
+//Maximum number of worker tasks
+#ifndef SOCKET_REACTOR_MAX_WORKERS
+   #define SOCKET_REACTOR_MAX_WORKERS 1
+#elif (SOCKET_REACTOR_MAX_WORKERS < 1)
+   #error SOCKET_REACTOR_MAX_WORKERS parameter is not valid
+#endif
+
+//Stack size required to run a worker task
+#ifndef SOCKET_REACTOR_STACK_SIZE
+   #define SOCKET_REACTOR_STACK_SIZE 500
+#elif (SOCKET_REACTOR_STACK_SIZE < 1)
+   #error SOCKET_REACTOR_STACK_SIZE parameter is not valid
+#endif
+
+//Priority at which the worker tasks should run
+#ifndef SOCKET_REACTOR_PRIORITY
+   #define SOCKET_REACTOR_PRIORITY OS_TASK_PRIORITY_NORMAL
+#endif
+
+//Number of ready sockets a worker dispatches per wait
+#ifndef SOCKET_REACTOR_MAX_EVENTS
+   #define SOCKET_REACTOR_MAX_EVENTS 4
+#elif (SOCKET_REACTOR_MAX_EVENTS < 1)
+   #error SOCKET_REACTOR_MAX_EVENTS parameter is not valid
+#endif
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Socket reactor callback
+ **/
+
+typedef void (*SocketReactorCallback)(Socket *socket, void *param);
+
+
+/**
+ * @brief Socket reactor handlers
+ *
+ * Unused handlers are left NULL. The handlers run in the worker task the
+ * socket is assigned to, one at a time, and must not block: the I/O calls
+ * they make use SOCKET_FLAG_DONT_WAIT
+ **/
+
+typedef struct
+{
+   SocketReactorCallback acceptCallback;   ///<A connection request is pending on a listening socket
+   SocketReactorCallback readableCallback; ///<Data, or the end of the stream, can be read
+   SocketReactorCallback writableCallback; ///<There is room in the send buffer (see socketReactorSetWritable)
+   SocketReactorCallback closedCallback;   ///<The connection is closed; the socket has left the reactor
+} SocketReactorHandlers;
+
+
+/**
+ * @brief Socket reactor settings
+ **/
+
+typedef struct
+{
+   OsTaskParameters task[SOCKET_REACTOR_MAX_WORKERS]; ///<Task parameters of the workers
+   uint_t numWorkers;                                 ///<Number of worker tasks
+} SocketReactorSettings;
+
+
+/**
+ * @brief Socket registered with the reactor
+ **/
+
+typedef struct
+{
+   const SocketReactorHandlers *handlers; ///<Handlers of the socket (NULL if unused)
+   void *param;                           ///<Opaque parameter passed to the handlers
+   uint_t worker;                         ///<Worker the socket is assigned to
+} SocketReactorEntry;
+
+
+/**
+ * @brief Worker task
+ **/
+
+typedef struct
+{
+   struct _SocketReactorContext *context;                ///<Reactor the worker belongs to
+   OsTaskParameters taskParams;                          ///<Task parameters
+   OsTaskId taskId;                                      ///<Task identifier
+   SocketPollSet set;                                    ///<Sockets served by the worker
+   SocketEventDesc eventDesc[SOCKET_REACTOR_MAX_EVENTS]; ///<Ready sockets
+} SocketReactorWorker;
+
+
+/**
+ * @brief Socket reactor context
+ **/
+
+typedef struct _SocketReactorContext
+{
+   uint_t numWorkers;                                       ///<Number of worker tasks
+   SocketReactorWorker workers[SOCKET_REACTOR_MAX_WORKERS]; ///<Worker tasks
+   SocketReactorEntry entries[SOCKET_MAX_COUNT];            ///<Registered sockets, by socket descriptor
+} SocketReactorContext;
+
+
+//Socket reactor related functions
+void socketReactorGetDefaultSettings(SocketReactorSettings *settings);
+
+error_t socketReactorInit(SocketReactorContext *context,
+   const SocketReactorSettings *settings);
+
+error_t socketReactorStart(SocketReactorContext *context);
+
+error_t socketReactorAdd(SocketReactorContext *context, Socket *socket,
+   const SocketReactorHandlers *handlers, void *param);
+
+error_t socketReactorSetWritable(SocketReactorContext *context,
+   Socket *socket, bool_t enabled);
+
+error_t socketReactorRemove(SocketReactorContext *context, Socket *socket);
+
+void socketReactorTask(SocketReactorWorker *worker);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -35,9 +35,13 @@
 #include "core/net.h"
 #include "core/socket.h"
 #include "core/socket_misc.h"
+#include "core/socket_poll.h"
 #include "core/tcp.h"
 #include "core/tcp_misc.h"
+#include "core/tcp_auto_tune.h"
 #include "core/tcp_timer.h"
+#include "core/tcp_time_wait.h"
+#include "core/tcp_fast_open.h"
 #include "mibs/mib2_module.h"
 #include "mibs/tcp_mib_module.h"
 #include "debug.h"
@@ -45,9 +49,6 @@
 //Check TCP/IP stack configuration
 #if (TCP_SUPPORT == ENABLED)
 
-//Tick counter to handle periodic operations
-systime_t tcpTickCounter;
-
 //Ephemeral ports are used for dynamic port assignment
 static uint16_t tcpDynamicPort;
 
@@ -59,8 +60,23 @@ static uint16_t tcpDynamicPort;
 
 error_t tcpInit(void)
 {
+   error_t error;
+
    //Reset ephemeral port number
    tcpDynamicPort = 0;
+   //Initialize the timer wheel
+   tcpTimerInit();
+
+   //Initialize the large buffer pool
+   error = tcpInitLargeBuffers();
+   //Any error to report?
+   if(error)
+      return error;
+
+#if (TCP_TIME_WAIT_TABLE_SIZE > 0)
+   //Initialize the TIME-WAIT table
+   tcpTimeWaitInit();
+#endif
 
    //Successful initialization
    return NO_ERROR;
@@ -148,9 +164,13 @@ error_t tcpConnect(Socket *socket, const IpAddr *remoteIpAddr,
 {
    error_t error;
    uint_t event;
+   bool_t deferred;
+
+   //The SYN segment is normally sent right away
+   deferred = FALSE;
 
    //Check current TCP state
-   if(socket->state == TCP_STATE_CLOSED && !socket->resetFlag)
+   if(socket->tcb->state == TCP_STATE_CLOSED && !socket->tcb->resetFlag)
    {
       //Make sure the destination address is a valid unicast address
       if(ipIsUnspecifiedAddr(remoteIpAddr) || ipIsMulticastAddr(remoteIpAddr) ||
@@ -169,6 +189,8 @@ error_t tcpConnect(Socket *socket, const IpAddr *remoteIpAddr,
       //Save port number and IP address of the remote host
       socket->remoteIpAddr = *remoteIpAddr;
       socket->remotePort = remotePort;
+      //The endpoints of the socket have changed
+      socketHashEvict(socket);
 
       //Unspecified source address?
       if(ipIsUnspecifiedAddr(&socket->localIpAddr))
@@ -183,21 +205,25 @@ error_t tcpConnect(Socket *socket, const IpAddr *remoteIpAddr,
       }
 
       //The user owns the socket
-      socket->ownedFlag = TRUE;
+      socket->tcb->ownedFlag = TRUE;
 
       //Number of chunks that comprise the TX and the RX buffers
-      socket->txBuffer.maxChunkCount = arraysize(socket->txBuffer.chunk);
-      socket->rxBuffer.maxChunkCount = arraysize(socket->rxBuffer.chunk);
+      socket->tcb->txBuffer.maxChunkCount = arraysize(socket->tcb->txBuffer.chunk);
+      socket->tcb->rxBuffer.maxChunkCount = arraysize(socket->tcb->rxBuffer.chunk);
+
+      //Accesses to the buffers start from their first chunk
+      netBufferInitCursor(&socket->tcb->txCursor, (NetBuffer *) &socket->tcb->txBuffer);
+      netBufferInitCursor(&socket->tcb->rxCursor, (NetBuffer *) &socket->tcb->rxBuffer);
 
       //Allocate transmit buffer
-      error = netBufferSetLength((NetBuffer *) &socket->txBuffer,
-         socket->txBufferSize);
+      error = tcpAllocBuffer(socket, (NetBuffer *) &socket->tcb->txBuffer,
+         socket->tcb->txBufferSize);
 
       //Allocate receive buffer
       if(!error)
       {
-         error = netBufferSetLength((NetBuffer *) &socket->rxBuffer,
-            socket->rxBufferSize);
+         error = tcpAllocBuffer(socket, (NetBuffer *) &socket->tcb->rxBuffer,
+            socket->tcb->rxBufferSize);
       }
 
       //Failed to allocate memory?
@@ -209,47 +235,72 @@ error_t tcpConnect(Socket *socket, const IpAddr *remoteIpAddr,
          return error;
       }
 
+#if (TCP_AUTO_TUNE_SUPPORT == ENABLED)
+      //The buffers grow from their current size
+      tcpAutoTuneInit(socket);
+#endif
+
       //The SMSS is the size of the largest segment that the sender can
       //transmit
-      socket->smss = MIN(socket->mss, TCP_DEFAULT_MSS);
+      socket->tcb->smss = MIN(socket->tcb->mss, TCP_DEFAULT_MSS);
 
       //The RMSS is the size of the largest segment the receiver is willing
       //to accept
-      socket->rmss = MIN(socket->mss, socket->rxBufferSize);
+      socket->tcb->rmss = MIN(socket->tcb->mss, socket->tcb->rxBufferSize);
 
       //Generate the initial sequence number
-      socket->iss = tcpGenerateInitialSeqNum(&socket->localIpAddr,
+      socket->tcb->iss = tcpGenerateInitialSeqNum(&socket->localIpAddr,
          socket->localPort, &socket->remoteIpAddr, socket->remotePort);
 
       //Initialize TCP control block
-      socket->sndUna = socket->iss;
-      socket->sndNxt = socket->iss + 1;
-      socket->rcvNxt = 0;
-      socket->rcvUser = 0;
-      socket->rcvWnd = socket->rxBufferSize;
+      socket->tcb->sndUna = socket->tcb->iss;
+      socket->tcb->sndNxt = socket->tcb->iss + 1;
+      socket->tcb->rcvNxt = 0;
+      socket->tcb->rcvUser = 0;
+      socket->tcb->rcvWnd = socket->tcb->rxBufferSize;
 
       //Set initial retransmission timeout
-      socket->rto = socket->interface->initialRto;
+      socket->tcb->rto = socket->interface->initialRto;
+
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+      //The timestamp clock starts from a random offset
+      socket->tcb->tsOffset = netGenerateRand();
+      //The option is only used if the peer includes it in its SYN segment
+      socket->tcb->tsEnabled = FALSE;
+#endif
 
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
       //Default congestion state
-      socket->congestState = TCP_CONGEST_STATE_IDLE;
+      socket->tcb->congestState = TCP_CONGEST_STATE_IDLE;
 
       //Initial congestion window
-      socket->cwnd = MIN((uint32_t) socket->smss * TCP_INITIAL_WINDOW,
-         socket->txBufferSize);
+      socket->tcb->cwnd = MIN((uint32_t) socket->tcb->smss * TCP_INITIAL_WINDOW,
+         socket->tcb->txBufferSize);
 
       //Slow start threshold should be set arbitrarily high
-      socket->ssthresh = UINT32_MAX;
+      socket->tcb->ssthresh = UINT32_MAX;
       //Recover is set to the initial send sequence number
-      socket->recover = socket->iss;
+      socket->tcb->recover = socket->tcb->iss;
+
+      //Initialize the congestion control algorithm
+      socket->tcb->congestAlgo->init(socket);
 #endif
 
-      //Send a SYN segment
-      error = tcpSendSegment(socket, TCP_FLAG_SYN, socket->iss, 0, 0, TRUE);
-      //Failed to send TCP segment?
-      if(error)
-         return error;
+#if (TCP_FAST_OPEN_SUPPORT == ENABLED)
+      //With a cookie cached for the server, the SYN segment is held until
+      //the first data can be sent along with it
+      deferred = tcpFastOpenConnect(socket);
+#endif
+
+      //SYN segment sent right away?
+      if(!deferred)
+      {
+         //Send a SYN segment
+         error = tcpSendSegment(socket, TCP_FLAG_SYN, socket->tcb->iss, 0, 0, TRUE);
+         //Failed to send TCP segment?
+         if(error)
+            return error;
+      }
 
       //Switch to the SYN-SENT state
       tcpChangeState(socket, TCP_STATE_SYN_SENT);
@@ -260,6 +311,10 @@ error_t tcpConnect(Socket *socket, const IpAddr *remoteIpAddr,
       TCP_MIB_INC_COUNTER32(tcpActiveOpens, 1);
    }
 
+   //The connection completes once the deferred SYN segment has been sent
+   if(deferred)
+      return NO_ERROR;
+
    //Wait for the connection to be established
    event = tcpWaitForEvents(socket, SOCKET_EVENT_CONNECTED |
       SOCKET_EVENT_CLOSED, socket->timeout);
@@ -297,13 +352,13 @@ error_t tcpConnect(Socket *socket, const IpAddr *remoteIpAddr,
 error_t tcpListen(Socket *socket, uint_t backlog)
 {
    //Socket already connected?
-   if(socket->state != TCP_STATE_CLOSED)
+   if(socket->tcb->state != TCP_STATE_CLOSED)
       return ERROR_ALREADY_CONNECTED;
 
    //Set the size of the SYN queue
-   socket->synQueueSize = (backlog > 0) ? backlog : TCP_DEFAULT_SYN_QUEUE_SIZE;
+   socket->tcb->synQueueSize = (backlog > 0) ? backlog : TCP_DEFAULT_SYN_QUEUE_SIZE;
    //Limit the number of pending connections
-   socket->synQueueSize = MIN(socket->synQueueSize, TCP_MAX_SYN_QUEUE_SIZE);
+   socket->tcb->synQueueSize = MIN(socket->tcb->synQueueSize, TCP_MAX_SYN_QUEUE_SIZE);
 
    //Place the socket in the listening state
    tcpChangeState(socket, TCP_STATE_LISTEN);
@@ -338,23 +393,14 @@ Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort)
    while(1)
    {
       //The SYN queue is empty?
-      if(socket->synQueue == NULL)
+      if(socket->tcb->synQueue == NULL)
       {
-         //Set the events the application is interested in
-         socket->eventMask = SOCKET_EVENT_RX_READY;
-         //Reset the event object
-         osResetEvent(&socket->event);
-
-         //Release exclusive access
-         osReleaseMutex(&netMutex);
          //Wait until a SYN message is received from a client
-         osWaitForEvent(&socket->event, socket->timeout);
-         //Get exclusive access
-         osAcquireMutex(&netMutex);
+         socketWaitForEvent(socket, SOCKET_EVENT_RX_READY, socket->timeout);
       }
 
       //Check whether the queue is still empty
-      if(socket->synQueue == NULL)
+      if(socket->tcb->synQueue == NULL)
       {
          //Timeout error
          newSocket = NULL;
@@ -363,7 +409,7 @@ Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort)
       }
 
       //Point to the first item in the SYN queue
-      queueItem = socket->synQueue;
+      queueItem = socket->tcb->synQueue;
 
       //The function optionally returns the IP address of the client
       if(clientIpAddr != NULL)
@@ -384,44 +430,73 @@ Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort)
       if(newSocket != NULL)
       {
          //The user owns the socket
-         newSocket->ownedFlag = TRUE;
+         newSocket->tcb->ownedFlag = TRUE;
 
          //Inherit parameters from the listening socket
-         newSocket->mss = socket->mss;
-         newSocket->txBufferSize = socket->txBufferSize;
-         newSocket->rxBufferSize = socket->rxBufferSize;
+         newSocket->tcb->mss = socket->tcb->mss;
+         newSocket->tcb->txBufferSize = socket->tcb->txBufferSize;
+         newSocket->tcb->rxBufferSize = socket->tcb->rxBufferSize;
+         newSocket->tcb->txLowWatermark = socket->tcb->txLowWatermark;
+         newSocket->tcb->rxLowWatermark = socket->tcb->rxLowWatermark;
 
 #if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
          //Save the window scale factor to use for the receive window
-         newSocket->rcvWndShift = socket->rcvWndShift;
+         newSocket->tcb->rcvWndShift = socket->tcb->rcvWndShift;
+#endif
+
+#if (TCP_LARGE_BUFFER_SUPPORT == ENABLED)
+         //Inherit the buffer mode from the listening socket
+         newSocket->tcb->largeBuffers = socket->tcb->largeBuffers;
+#endif
+
+#if (TCP_DELAYED_ACK_SUPPORT == ENABLED)
+         //Inherit the ACK mode from the listening socket
+         newSocket->tcb->quickAck = socket->tcb->quickAck;
+#endif
+
+#if (TCP_AUTO_TUNE_SUPPORT == ENABLED)
+         //Inherit auto-tuning settings from the listening socket
+         newSocket->tcb->autoTune.txEnabled = socket->tcb->autoTune.txEnabled;
+         newSocket->tcb->autoTune.rxEnabled = socket->tcb->autoTune.rxEnabled;
 #endif
 
 #if (TCP_KEEP_ALIVE_SUPPORT == ENABLED)
          //Inherit keep-alive parameters from the listening socket
-         newSocket->keepAliveEnabled = socket->keepAliveEnabled;
-         newSocket->keepAliveIdle = socket->keepAliveIdle;
-         newSocket->keepAliveInterval = socket->keepAliveInterval;
-         newSocket->keepAliveMaxProbes = socket->keepAliveMaxProbes;
+         newSocket->tcb->keepAliveEnabled = socket->tcb->keepAliveEnabled;
+         newSocket->tcb->keepAliveIdle = socket->tcb->keepAliveIdle;
+         newSocket->tcb->keepAliveInterval = socket->tcb->keepAliveInterval;
+         newSocket->tcb->keepAliveMaxProbes = socket->tcb->keepAliveMaxProbes;
 #endif
          //Number of chunks that comprise the TX and the RX buffers
-         newSocket->txBuffer.maxChunkCount = arraysize(newSocket->txBuffer.chunk);
-         newSocket->rxBuffer.maxChunkCount = arraysize(newSocket->rxBuffer.chunk);
+         newSocket->tcb->txBuffer.maxChunkCount = arraysize(newSocket->tcb->txBuffer.chunk);
+         newSocket->tcb->rxBuffer.maxChunkCount = arraysize(newSocket->tcb->rxBuffer.chunk);
+
+         //Accesses to the buffers start from their first chunk
+         netBufferInitCursor(&newSocket->tcb->txCursor,
+            (NetBuffer *) &newSocket->tcb->txBuffer);
+         netBufferInitCursor(&newSocket->tcb->rxCursor,
+            (NetBuffer *) &newSocket->tcb->rxBuffer);
 
          //Allocate transmit buffer
-         error = netBufferSetLength((NetBuffer *) &newSocket->txBuffer,
-            newSocket->txBufferSize);
+         error = tcpAllocBuffer(newSocket, (NetBuffer *) &newSocket->tcb->txBuffer,
+            newSocket->tcb->txBufferSize);
 
          //Check status code
          if(!error)
          {
             //Allocate receive buffer
-            error = netBufferSetLength((NetBuffer *) &newSocket->rxBuffer,
-               newSocket->rxBufferSize);
+            error = tcpAllocBuffer(newSocket, (NetBuffer *) &newSocket->tcb->rxBuffer,
+               newSocket->tcb->rxBufferSize);
          }
 
          //Transmit and receive buffers successfully allocated?
          if(!error)
          {
+#if (TCP_AUTO_TUNE_SUPPORT == ENABLED)
+            //The buffers grow from their current size
+            tcpAutoTuneInit(newSocket);
+#endif
+
             //Bind the newly created socket to the appropriate interface
             newSocket->interface = queueItem->interface;
 
@@ -432,59 +507,136 @@ Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort)
             //Save the port number and the IP address of the remote host
             newSocket->remoteIpAddr = queueItem->srcAddr;
             newSocket->remotePort = queueItem->srcPort;
+            //The endpoints of the socket have changed
+            socketHashEvict(newSocket);
 
             //The SMSS is the size of the largest segment that the sender can
             //transmit
-            newSocket->smss = queueItem->mss;
+            newSocket->tcb->smss = queueItem->mss;
+
+#if (IPV4_SUPPORT == ENABLED && IPV4_PMTU_SUPPORT == ENABLED)
+            //Segments must also fit the path MTU known for the remote host
+            tcpApplyPathMtu(newSocket);
+#endif
 
             //The RMSS is the size of the largest segment the receiver is
             //willing to accept
-            newSocket->rmss = MIN(newSocket->mss, newSocket->rxBufferSize);
+            newSocket->tcb->rmss = MIN(newSocket->tcb->mss, newSocket->tcb->rxBufferSize);
 
             //Generate the initial sequence number
-            newSocket->iss = tcpGenerateInitialSeqNum(&newSocket->localIpAddr,
+            newSocket->tcb->iss = tcpGenerateInitialSeqNum(&newSocket->localIpAddr,
                newSocket->localPort, &newSocket->remoteIpAddr,
                newSocket->remotePort);
 
             //Initialize TCP control block
-            newSocket->irs = queueItem->isn;
-            newSocket->sndUna = newSocket->iss;
-            newSocket->sndNxt = newSocket->iss + 1;
-            newSocket->rcvNxt = newSocket->irs + 1;
-            newSocket->rcvUser = 0;
-            newSocket->rcvWnd = newSocket->rxBufferSize;
+            newSocket->tcb->irs = queueItem->isn;
+            newSocket->tcb->sndUna = newSocket->tcb->iss;
+            newSocket->tcb->sndNxt = newSocket->tcb->iss + 1;
+            newSocket->tcb->rcvNxt = newSocket->tcb->irs + 1;
+            newSocket->tcb->rcvUser = 0;
+            newSocket->tcb->rcvWnd = newSocket->tcb->rxBufferSize;
 
             //Set initial retransmission timeout
-            newSocket->rto = newSocket->interface->initialRto;
+            newSocket->tcb->rto = newSocket->interface->initialRto;
+
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+            //The timestamp clock starts from a random offset
+            newSocket->tcb->tsOffset = netGenerateRand();
+
+            //Timestamps are used if the SYN segment carried the option
+            if(queueItem->tsOptionReceived)
+            {
+               tcpEnableTimestamps(newSocket, queueItem->tsVal);
+            }
+            else
+            {
+               newSocket->tcb->tsEnabled = FALSE;
+            }
+#endif
 
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
             //Default congestion state
-            newSocket->congestState = TCP_CONGEST_STATE_IDLE;
+            newSocket->tcb->congestState = TCP_CONGEST_STATE_IDLE;
 
             //Initial congestion window
-            newSocket->cwnd = MIN((uint32_t) newSocket->smss * TCP_INITIAL_WINDOW,
-               newSocket->txBufferSize);
+            newSocket->tcb->cwnd = MIN((uint32_t) newSocket->tcb->smss * TCP_INITIAL_WINDOW,
+               newSocket->tcb->txBufferSize);
 
             //Slow start threshold should be set arbitrarily high
-            newSocket->ssthresh = UINT32_MAX;
+            newSocket->tcb->ssthresh = UINT32_MAX;
             //Recover is set to the initial send sequence number
-            newSocket->recover = newSocket->iss;
+            newSocket->tcb->recover = newSocket->tcb->iss;
+
+            //The connection inherits the congestion control algorithm of
+            //the listening socket
+            newSocket->tcb->congestAlgo = socket->tcb->congestAlgo;
+            newSocket->tcb->congestAlgo->init(newSocket);
 #endif
 
 #if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
             //If a Window Scale option is received with a shift.cnt value larger
             //than 14, the TCP should log the error but must use 14 instead of
             //the specified value (refer to RFC 7323, section 2.3)
-            newSocket->wndScaleOptionReceived = queueItem->wndScaleOptionReceived;
-            newSocket->sndWndShift = MIN(queueItem->wndScaleFactor, 14);
+            if(tcpIsWindowScaleEnabled(newSocket))
+            {
+               newSocket->tcb->wndScaleOptionReceived = queueItem->wndScaleOptionReceived;
+               newSocket->tcb->sndWndShift = MIN(queueItem->wndScaleFactor, 14);
+            }
+            else
+            {
+               //Window scaling is not negotiated for this connection
+               newSocket->tcb->wndScaleOptionReceived = FALSE;
+               newSocket->tcb->sndWndShift = 0;
+            }
 #endif
 
 #if (TCP_SACK_SUPPORT == ENABLED)
             //The SACK Permitted option can be sent in a SYN segment to
             //indicate that the SACK option can be used once the connection
             //is established
-            newSocket->sackPermitted = queueItem->sackPermitted;
+            newSocket->tcb->sackPermitted = queueItem->sackPermitted;
+#endif
+
+#if (TCP_SYN_COOKIE_SUPPORT == ENABLED)
+            //The handshake has already been completed with a SYN cookie?
+            if(queueItem->cookie)
+            {
+               //The cookie was used as initial sequence number, and the
+               //client has acknowledged our SYN
+               newSocket->tcb->iss = queueItem->iss;
+               newSocket->tcb->sndUna = newSocket->tcb->iss + 1;
+               newSocket->tcb->sndNxt = newSocket->tcb->iss + 1;
+
+               //Initialize the send window from the final ACK
+               newSocket->tcb->sndWnd = queueItem->window;
+               newSocket->tcb->sndWl1 = newSocket->tcb->irs + 1;
+               newSocket->tcb->sndWl2 = newSocket->tcb->sndUna;
+               newSocket->tcb->maxSndWnd = queueItem->window;
+
+#if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
+               //Recover is set to the initial send sequence number
+               newSocket->tcb->recover = newSocket->tcb->iss;
+#endif
+               //Enter ESTABLISHED state
+               tcpChangeState(newSocket, TCP_STATE_ESTABLISHED);
+
+               //Number of times TCP connections have made a direct transition
+               //to the SYN-RECEIVED state from the LISTEN state
+               MIB2_TCP_INC_COUNTER32(tcpPassiveOpens, 1);
+               TCP_MIB_INC_COUNTER32(tcpPassiveOpens, 1);
+
+               //Remove the item from the SYN queue
+               socket->tcb->synQueue = queueItem->next;
+               //Deallocate memory buffer
+               memPoolFree(queueItem);
+               //Update the state of events
+               tcpUpdateEvents(socket);
+
+               //We are done
+               break;
+            }
 #endif
+
             //The connection state should be changed to SYN-RECEIVED
             tcpChangeState(newSocket, TCP_STATE_SYN_RECEIVED);
 
@@ -495,13 +647,13 @@ Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort)
 
             //Send a SYN/ACK control segment
             error = tcpSendSegment(newSocket, TCP_FLAG_SYN | TCP_FLAG_ACK,
-               newSocket->iss, newSocket->rcvNxt, 0, TRUE);
+               newSocket->tcb->iss, newSocket->tcb->rcvNxt, 0, TRUE);
 
             //TCP segment successfully sent?
             if(!error)
             {
                //Remove the item from the SYN queue
-               socket->synQueue = queueItem->next;
+               socket->tcb->synQueue = queueItem->next;
                //Deallocate memory buffer
                memPoolFree(queueItem);
                //Update the state of events
@@ -520,7 +672,7 @@ Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort)
       TRACE_WARNING("Cannot accept TCP connection!\r\n");
 
       //Remove the item from the SYN queue
-      socket->synQueue = queueItem->next;
+      socket->tcb->synQueue = queueItem->next;
       //Deallocate memory buffer
       memPoolFree(queueItem);
 
@@ -551,9 +703,13 @@ error_t tcpSend(Socket *socket, const uint8_t *data, size_t length,
    uint_t n;
    uint_t totalLength;
    uint_t event;
+#if (TCP_FAST_OPEN_SUPPORT == ENABLED)
+   error_t error;
+   size_t synLength;
+#endif
 
    //Check whether the socket is in the listening state
-   if(socket->state == TCP_STATE_LISTEN)
+   if(socket->tcb->state == TCP_STATE_LISTEN)
       return ERROR_NOT_CONNECTED;
 
    //Actual number of bytes written
@@ -562,6 +718,32 @@ error_t tcpSend(Socket *socket, const uint8_t *data, size_t length,
    //Send as much data as possible
    do
    {
+#if (TCP_FAST_OPEN_SUPPORT == ENABLED)
+      //Deferred SYN segment of a Fast Open connection?
+      if(socket->tcb->state == TCP_STATE_SYN_SENT && socket->tcb->fastOpenPending)
+      {
+         //Send the SYN segment along with the beginning of the data
+         error = tcpFastOpenSendSyn(socket, data, length, &synLength);
+         //Any error to report?
+         if(error)
+            return error;
+
+         //Advance data pointer
+         data += synLength;
+         //Update byte counter
+         totalLength += synLength;
+
+         //Total number of data that have been written
+         if(written != NULL)
+         {
+            *written = totalLength;
+         }
+
+         //The rest of the data is sent once the connection is established
+         continue;
+      }
+#endif
+
       //Wait until there is more room in the send buffer
       event = tcpWaitForEvents(socket, SOCKET_EVENT_TX_READY, socket->timeout);
 
@@ -570,7 +752,7 @@ error_t tcpSend(Socket *socket, const uint8_t *data, size_t length,
          return ERROR_TIMEOUT;
 
       //Check current TCP state
-      switch(socket->state)
+      switch(socket->tcb->state)
       {
       //ESTABLISHED or CLOSE-WAIT state?
       case TCP_STATE_ESTABLISHED:
@@ -590,17 +772,17 @@ error_t tcpSend(Socket *socket, const uint8_t *data, size_t length,
       //CLOSED state?
       default:
          //The connection was reset by remote side?
-         return (socket->resetFlag) ? ERROR_CONNECTION_RESET : ERROR_NOT_CONNECTED;
+         return (socket->tcb->resetFlag) ? ERROR_CONNECTION_RESET : ERROR_NOT_CONNECTED;
       }
 
       //Determine the actual number of bytes in the send buffer
-      n = socket->sndUser + socket->sndNxt - socket->sndUna;
+      n = socket->tcb->sndUser + socket->tcb->sndNxt - socket->tcb->sndUna;
       //Exit immediately if the transmission buffer is full (sanity check)
-      if(n >= socket->txBufferSize)
+      if(n >= socket->tcb->txBufferSize)
          return ERROR_FAILURE;
 
       //Number of bytes available for writing
-      n = socket->txBufferSize - n;
+      n = socket->tcb->txBufferSize - n;
       //Calculate the number of bytes to copy at a time
       n = MIN(n, length - totalLength);
 
@@ -608,10 +790,10 @@ error_t tcpSend(Socket *socket, const uint8_t *data, size_t length,
       if(n > 0)
       {
          //Copy user data to send buffer
-         tcpWriteTxBuffer(socket, socket->sndNxt + socket->sndUser, data, n);
+         tcpWriteTxBuffer(socket, socket->tcb->sndNxt + socket->tcb->sndUser, data, n);
 
          //Update the number of data buffered but not yet sent
-         socket->sndUser += n;
+         socket->tcb->sndUser += n;
          //Advance data pointer
          data += n;
          //Update byte counter
@@ -630,9 +812,18 @@ error_t tcpSend(Socket *socket, const uint8_t *data, size_t length,
          //transmission of data, overriding the SWS avoidance algorithm. In
          //practice, this timeout should seldom occur (refer to RFC 1122,
          //section 4.2.3.4)
-         if(socket->sndUser == n)
+         if(socket->tcb->sndUser == n)
          {
-            netStartTimer(&socket->overrideTimer, TCP_OVERRIDE_TIMEOUT);
+            //Data held back on purpose is flushed after a shorter delay
+            if((socket->options & SOCKET_OPTION_TCP_CORK) != 0 ||
+               (flags & SOCKET_FLAG_DELAY) != 0)
+            {
+               tcpStartTimer(socket, &socket->tcb->overrideTimer, TCP_CORK_TIMEOUT);
+            }
+            else
+            {
+               tcpStartTimer(socket, &socket->tcb->overrideTimer, TCP_OVERRIDE_TIMEOUT);
+            }
          }
       }
 
@@ -655,7 +846,7 @@ error_t tcpSend(Socket *socket, const uint8_t *data, size_t length,
          return ERROR_TIMEOUT;
 
       //The connection closed before an acknowledgment was received?
-      if(socket->state != TCP_STATE_ESTABLISHED && socket->state != TCP_STATE_CLOSE_WAIT)
+      if(socket->tcb->state != TCP_STATE_ESTABLISHED && socket->tcb->state != TCP_STATE_CLOSE_WAIT)
          return ERROR_NOT_CONNECTED;
    }
 
@@ -689,7 +880,7 @@ error_t tcpReceive(Socket *socket, uint8_t *data, size_t size,
    *received = 0;
 
    //Check whether the socket is in the listening state
-   if(socket->state == TCP_STATE_LISTEN)
+   if(socket->tcb->state == TCP_STATE_LISTEN)
       return ERROR_NOT_CONNECTED;
 
    //Read as much data as possible
@@ -700,19 +891,20 @@ error_t tcpReceive(Socket *socket, uint8_t *data, size_t size,
       //Wait for data to be available for reading
       event = tcpWaitForEvents(socket, SOCKET_EVENT_RX_READY, timeout);
 
-      //A timeout exception occurred?
-      if(event != SOCKET_EVENT_RX_READY)
+      //A timeout exception occurred? The data below the low watermark is
+      //returned once the wait is over
+      if(event != SOCKET_EVENT_RX_READY && socket->tcb->rcvUser == 0)
          return ERROR_TIMEOUT;
 
       //Check current TCP state
-      switch(socket->state)
+      switch(socket->tcb->state)
       {
       //ESTABLISHED, FIN-WAIT-1 or FIN-WAIT-2 state?
       case TCP_STATE_ESTABLISHED:
       case TCP_STATE_FIN_WAIT_1:
       case TCP_STATE_FIN_WAIT_2:
          //Sequence number of the first byte to read
-         seqNum = socket->rcvNxt - socket->rcvUser;
+         seqNum = socket->tcb->rcvNxt - socket->tcb->rcvUser;
          //Data is available in the receive buffer
          break;
 
@@ -722,7 +914,7 @@ error_t tcpReceive(Socket *socket, uint8_t *data, size_t size,
       case TCP_STATE_CLOSING:
       case TCP_STATE_TIME_WAIT:
          //The user must be satisfied with data already on hand
-         if(socket->rcvUser == 0)
+         if(socket->tcb->rcvUser == 0)
          {
             if(*received > 0)
             {
@@ -735,22 +927,22 @@ error_t tcpReceive(Socket *socket, uint8_t *data, size_t size,
          }
 
          //Sequence number of the first byte to read
-         seqNum = (socket->rcvNxt - 1) - socket->rcvUser;
+         seqNum = (socket->tcb->rcvNxt - 1) - socket->tcb->rcvUser;
          //Data is available in the receive buffer
          break;
 
       //CLOSED state?
       default:
          //The connection was reset by remote side?
-         if(socket->resetFlag)
+         if(socket->tcb->resetFlag)
             return ERROR_CONNECTION_RESET;
 
          //The connection has not yet been established?
-         if(!socket->closedFlag)
+         if(!socket->tcb->closedFlag)
             return ERROR_NOT_CONNECTED;
 
          //The user must be satisfied with data already on hand
-         if(socket->rcvUser == 0)
+         if(socket->tcb->rcvUser == 0)
          {
             if(*received > 0)
             {
@@ -763,17 +955,17 @@ error_t tcpReceive(Socket *socket, uint8_t *data, size_t size,
          }
 
          //Sequence number of the first byte to read
-         seqNum = (socket->rcvNxt - 1) - socket->rcvUser;
+         seqNum = (socket->tcb->rcvNxt - 1) - socket->tcb->rcvUser;
          //Data is available in the receive buffer
          break;
       }
 
       //Sanity check
-      if(socket->rcvUser == 0)
+      if(socket->tcb->rcvUser == 0)
          return ERROR_FAILURE;
 
       //Calculate the number of bytes to read at a time
-      n = MIN(socket->rcvUser, size - *received);
+      n = MIN(socket->tcb->rcvUser, size - *received);
       //Copy data from circular buffer
       tcpReadRxBuffer(socket, seqNum, data, n);
 
@@ -792,7 +984,7 @@ error_t tcpReceive(Socket *socket, uint8_t *data, size_t size,
       //Total number of data that have been read
       *received += n;
       //Remaining data still available in the receive buffer
-      socket->rcvUser -= n;
+      socket->tcb->rcvUser -= n;
 
       //Update the receive window
       tcpUpdateReceiveWindow(socket);
@@ -823,6 +1015,150 @@ error_t tcpReceive(Socket *socket, uint8_t *data, size_t size,
 }
 
 
+/**
+ * @brief Access the data received on a connection without copying it
+ *
+ * The data pointer designates the first contiguous block of unread data in
+ * the receive buffer. The block stays in the buffer, and the receive window
+ * stays closed over it, until the user releases it with tcpReleaseRxData
+ *
+ * @param[in] socket Handle referencing the socket
+ * @param[out] data Pointer to the first byte of unread data
+ * @param[out] length Number of contiguous bytes available
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t tcpReceiveInPlace(Socket *socket, const uint8_t **data,
+   size_t *length, uint_t flags)
+{
+   uint_t event;
+   uint32_t seqNum;
+   size_t offset;
+   size_t n;
+   size_t m;
+   uint8_t *p;
+   systime_t timeout;
+
+   //No data is available yet
+   *data = NULL;
+   *length = 0;
+
+   //Check whether the socket is in the listening state
+   if(socket->tcb->state == TCP_STATE_LISTEN)
+      return ERROR_NOT_CONNECTED;
+
+   //The SOCKET_FLAG_DONT_WAIT enables non-blocking operation
+   timeout = (flags & SOCKET_FLAG_DONT_WAIT) ? 0 : socket->timeout;
+   //Wait for data to be available for reading
+   event = tcpWaitForEvents(socket, SOCKET_EVENT_RX_READY, timeout);
+
+   //A timeout exception occurred? The data below the low watermark is
+   //returned once the wait is over
+   if(event != SOCKET_EVENT_RX_READY && socket->tcb->rcvUser == 0)
+      return ERROR_TIMEOUT;
+
+   //Check current TCP state
+   switch(socket->tcb->state)
+   {
+   //ESTABLISHED, FIN-WAIT-1 or FIN-WAIT-2 state?
+   case TCP_STATE_ESTABLISHED:
+   case TCP_STATE_FIN_WAIT_1:
+   case TCP_STATE_FIN_WAIT_2:
+      //Sequence number of the first byte to read
+      seqNum = socket->tcb->rcvNxt - socket->tcb->rcvUser;
+      //Data is available in the receive buffer
+      break;
+
+   //CLOSE-WAIT, LAST-ACK, CLOSING or TIME-WAIT state?
+   case TCP_STATE_CLOSE_WAIT:
+   case TCP_STATE_LAST_ACK:
+   case TCP_STATE_CLOSING:
+   case TCP_STATE_TIME_WAIT:
+      //The user must be satisfied with data already on hand
+      if(socket->tcb->rcvUser == 0)
+         return ERROR_END_OF_STREAM;
+
+      //Sequence number of the first byte to read
+      seqNum = (socket->tcb->rcvNxt - 1) - socket->tcb->rcvUser;
+      //Data is available in the receive buffer
+      break;
+
+   //CLOSED state?
+   default:
+      //The connection was reset by remote side?
+      if(socket->tcb->resetFlag)
+         return ERROR_CONNECTION_RESET;
+
+      //The connection has not yet been established?
+      if(!socket->tcb->closedFlag)
+         return ERROR_NOT_CONNECTED;
+
+      //The user must be satisfied with data already on hand
+      if(socket->tcb->rcvUser == 0)
+         return ERROR_END_OF_STREAM;
+
+      //Sequence number of the first byte to read
+      seqNum = (socket->tcb->rcvNxt - 1) - socket->tcb->rcvUser;
+      //Data is available in the receive buffer
+      break;
+   }
+
+   //Sanity check
+   if(socket->tcb->rcvUser == 0)
+      return ERROR_FAILURE;
+
+   //Offset of the first byte to read in the circular buffer
+   offset = (seqNum - socket->tcb->irs - 1 - socket->tcb->rxBufferOffset) %
+      socket->tcb->rxBufferSize;
+
+   //The block ends where the circular buffer wraps around
+   n = MIN(socket->tcb->rcvUser, socket->tcb->rxBufferSize - offset);
+
+   //Locate the chunk holding the first byte
+   p = netBufferCursorSeek(&socket->tcb->rxCursor, offset, &m);
+
+   //Sanity check
+   if(p == NULL)
+      return ERROR_FAILURE;
+
+   //The block cannot span several chunks
+   n = MIN(n, m);
+
+   //Return the location of the block
+   *data = p;
+   *length = n;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Release data accessed with tcpReceiveInPlace
+ * @param[in] socket Handle referencing the socket
+ * @param[in] length Number of bytes the user has consumed
+ **/
+
+void tcpReleaseRxData(Socket *socket, size_t length)
+{
+   //The user cannot release more data than is available
+   length = MIN(length, socket->tcb->rcvUser);
+
+   //Any data consumed?
+   if(length > 0)
+   {
+      //Remaining data still available in the receive buffer
+      socket->tcb->rcvUser -= length;
+
+      //Update the receive window
+      tcpUpdateReceiveWindow(socket);
+      //Update RX event state
+      tcpUpdateEvents(socket);
+   }
+}
+
+
 /**
  * @brief Shutdown gracefully reception, transmission, or both
  *
@@ -850,18 +1186,18 @@ error_t tcpShutdown(Socket *socket, uint_t how)
       while(!error)
       {
          //LISTEN state?
-         if(socket->state == TCP_STATE_LISTEN)
+         if(socket->tcb->state == TCP_STATE_LISTEN)
          {
             //The connection does not exist
             error = ERROR_NOT_CONNECTED;
          }
          //SYN-RECEIVED, ESTABLISHED or CLOSE-WAIT state?
-         else if(socket->state == TCP_STATE_SYN_RECEIVED ||
-            socket->state == TCP_STATE_ESTABLISHED ||
-            socket->state == TCP_STATE_CLOSE_WAIT)
+         else if(socket->tcb->state == TCP_STATE_SYN_RECEIVED ||
+            socket->tcb->state == TCP_STATE_ESTABLISHED ||
+            socket->tcb->state == TCP_STATE_CLOSE_WAIT)
          {
             //Any data pending in the send buffer?
-            if(socket->sndUser > 0)
+            if(socket->tcb->sndUser > 0)
             {
                //Flush the send buffer
                tcpNagleAlgo(socket, SOCKET_FLAG_NO_DELAY);
@@ -880,17 +1216,17 @@ error_t tcpShutdown(Socket *socket, uint_t how)
             {
                //Send a FIN segment
                error = tcpSendSegment(socket, TCP_FLAG_FIN | TCP_FLAG_ACK,
-                  socket->sndNxt, socket->rcvNxt, 0, TRUE);
+                  socket->tcb->sndNxt, socket->tcb->rcvNxt, 0, TRUE);
 
                //Check status code
                if(!error)
                {
                   //Sequence number expected to be received
-                  socket->sndNxt++;
+                  socket->tcb->sndNxt++;
 
                   //Switch to the FIN-WAIT1 or LAST-ACK state
-                  if(socket->state == TCP_STATE_SYN_RECEIVED ||
-                     socket->state == TCP_STATE_ESTABLISHED)
+                  if(socket->tcb->state == TCP_STATE_SYN_RECEIVED ||
+                     socket->tcb->state == TCP_STATE_ESTABLISHED)
                   {
                      tcpChangeState(socket, TCP_STATE_FIN_WAIT_1);
                   }
@@ -902,9 +1238,9 @@ error_t tcpShutdown(Socket *socket, uint_t how)
             }
          }
          //FIN-WAIT-1, CLOSING or LAST-ACK state?
-         else if(socket->state == TCP_STATE_FIN_WAIT_1 ||
-            socket->state == TCP_STATE_CLOSING ||
-            socket->state == TCP_STATE_LAST_ACK)
+         else if(socket->tcb->state == TCP_STATE_FIN_WAIT_1 ||
+            socket->tcb->state == TCP_STATE_CLOSING ||
+            socket->tcb->state == TCP_STATE_LAST_ACK)
          {
             //Wait for the FIN to be acknowledged
             event = tcpWaitForEvents(socket, SOCKET_EVENT_TX_SHUTDOWN,
@@ -932,17 +1268,17 @@ error_t tcpShutdown(Socket *socket, uint_t how)
       if(how == SOCKET_SD_RECEIVE || how == SOCKET_SD_BOTH)
       {
          //LISTEN state?
-         if(socket->state == TCP_STATE_LISTEN)
+         if(socket->tcb->state == TCP_STATE_LISTEN)
          {
             //The connection does not exist
             error = ERROR_NOT_CONNECTED;
          }
          //SYN-SENT, SYN-RECEIVED, ESTABLISHED, FIN-WAIT-1 or FIN-WAIT-2 state?
-         else if(socket->state == TCP_STATE_SYN_SENT ||
-            socket->state == TCP_STATE_SYN_RECEIVED ||
-            socket->state == TCP_STATE_ESTABLISHED ||
-            socket->state == TCP_STATE_FIN_WAIT_1 ||
-            socket->state == TCP_STATE_FIN_WAIT_2)
+         else if(socket->tcb->state == TCP_STATE_SYN_SENT ||
+            socket->tcb->state == TCP_STATE_SYN_RECEIVED ||
+            socket->tcb->state == TCP_STATE_ESTABLISHED ||
+            socket->tcb->state == TCP_STATE_FIN_WAIT_1 ||
+            socket->tcb->state == TCP_STATE_FIN_WAIT_2)
          {
             //Wait for a FIN to be received
             event = tcpWaitForEvents(socket, SOCKET_EVENT_RX_SHUTDOWN,
@@ -978,7 +1314,7 @@ error_t tcpAbort(Socket *socket)
    error_t error;
 
    //Check current state
-   switch(socket->state)
+   switch(socket->tcb->state)
    {
    //SYN-RECEIVED, ESTABLISHED, FIN-WAIT-1, FIN-WAIT-2 or CLOSE-WAIT state?
    case TCP_STATE_SYN_RECEIVED:
@@ -987,11 +1323,12 @@ error_t tcpAbort(Socket *socket)
    case TCP_STATE_FIN_WAIT_2:
    case TCP_STATE_CLOSE_WAIT:
       //Send a reset segment
-      error = tcpSendResetSegment(socket, socket->sndNxt);
+      error = tcpSendResetSegment(socket, socket->tcb->sndNxt);
       //Enter CLOSED state
       tcpChangeState(socket, TCP_STATE_CLOSED);
       //Delete TCB
       tcpDeleteControlBlock(socket);
+      tcpReleaseControlBlock(socket);
       //Mark the socket as closed
       socket->type = SOCKET_TYPE_UNUSED;
       //Return status code
@@ -1001,7 +1338,7 @@ error_t tcpAbort(Socket *socket)
    case TCP_STATE_TIME_WAIT:
 #if (TCP_2MSL_TIMER > 0)
       //The user doe not own the socket anymore...
-      socket->ownedFlag = FALSE;
+      socket->tcb->ownedFlag = FALSE;
       //TCB will be deleted and socket will be closed
       //when the 2MSL timer will elapse
       return NO_ERROR;
@@ -1010,6 +1347,7 @@ error_t tcpAbort(Socket *socket)
       tcpChangeState(socket, TCP_STATE_CLOSED);
       //Delete TCB
       tcpDeleteControlBlock(socket);
+      tcpReleaseControlBlock(socket);
       //Mark the socket as closed
       socket->type = SOCKET_TYPE_UNUSED;
       //No error to report
@@ -1022,6 +1360,7 @@ error_t tcpAbort(Socket *socket)
       tcpChangeState(socket, TCP_STATE_CLOSED);
       //Delete TCB
       tcpDeleteControlBlock(socket);
+      tcpReleaseControlBlock(socket);
       //Mark the socket as closed
       socket->type = SOCKET_TYPE_UNUSED;
       //No error to report
@@ -1043,8 +1382,8 @@ TcpState tcpGetState(Socket *socket)
    //Get exclusive access
    osAcquireMutex(&netMutex);
 
-   //Get TCP FSM current state
-   state = socket->state;
+   //Get TCP FSM current state (sockets other than TCP sockets have none)
+   state = (socket->tcb != NULL) ? socket->tcb->state : TCP_STATE_CLOSED;
 
    //Release exclusive access
    osReleaseMutex(&netMutex);
@@ -1083,7 +1422,7 @@ Socket *tcpKillOldestConnection(void)
       if(socket->type == SOCKET_TYPE_STREAM)
       {
          //Check current state
-         if(socket->state == TCP_STATE_TIME_WAIT)
+         if(socket->tcb->state == TCP_STATE_TIME_WAIT)
          {
             //Keep track of the oldest socket in the TIME-WAIT state
             if(oldestSocket == NULL)
@@ -1091,8 +1430,8 @@ Socket *tcpKillOldestConnection(void)
                //Save socket handle
                oldestSocket = socket;
             }
-            if((time - socket->timeWaitTimer.startTime) >
-               (time - oldestSocket->timeWaitTimer.startTime))
+            if((time - socket->tcb->timeWaitTimer.startTime) >
+               (time - oldestSocket->tcb->timeWaitTimer.startTime))
             {
                //Save socket handle
                oldestSocket = socket;
@@ -1104,10 +1443,16 @@ Socket *tcpKillOldestConnection(void)
    //Any connection in the TIME-WAIT state?
    if(oldestSocket != NULL)
    {
+#if (SOCKET_POLL_SUPPORT == ENABLED)
+      //The socket leaves its poll set, if any
+      socketPollDetach(oldestSocket);
+#endif
+
       //Enter CLOSED state
       tcpChangeState(oldestSocket, TCP_STATE_CLOSED);
       //Delete TCB
       tcpDeleteControlBlock(oldestSocket);
+      tcpReleaseControlBlock(oldestSocket);
       //Mark the socket as closed
       oldestSocket->type = SOCKET_TYPE_UNUSED;
    }
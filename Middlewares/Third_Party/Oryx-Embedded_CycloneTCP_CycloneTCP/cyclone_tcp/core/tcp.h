@@ -42,13 +42,20 @@
    #error TCP_SUPPORT parameter is not valid
 #endif
 
-//TCP tick interval
+//TCP tick interval (resolution of the timer wheel)
 #ifndef TCP_TICK_INTERVAL
    #define TCP_TICK_INTERVAL 100
 #elif (TCP_TICK_INTERVAL < 10)
    #error TCP_TICK_INTERVAL parameter is not valid
 #endif
 
+//Number of slots of the timer wheel
+#ifndef TCP_TIMER_WHEEL_SIZE
+   #define TCP_TIMER_WHEEL_SIZE 64
+#elif (TCP_TIMER_WHEEL_SIZE < 1)
+   #error TCP_TIMER_WHEEL_SIZE parameter is not valid
+#endif
+
 //Maximum segment size
 #ifndef TCP_MAX_MSS
    #define TCP_MAX_MSS 1430
@@ -91,6 +98,44 @@
    #error TCP_MAX_RX_BUFFER_SIZE parameter is not valid
 #endif
 
+//Large buffer mode for sockets on high bandwidth-delay product paths
+#ifndef TCP_LARGE_BUFFER_SUPPORT
+   #define TCP_LARGE_BUFFER_SUPPORT DISABLED
+#elif (TCP_LARGE_BUFFER_SUPPORT != ENABLED && TCP_LARGE_BUFFER_SUPPORT != DISABLED)
+   #error TCP_LARGE_BUFFER_SUPPORT parameter is not valid
+#endif
+
+//Size of the blocks of the large buffer pool
+#ifndef TCP_LARGE_BUFFER_BLOCK_SIZE
+   #define TCP_LARGE_BUFFER_BLOCK_SIZE 8192
+#elif (TCP_LARGE_BUFFER_BLOCK_SIZE < 1536 || TCP_LARGE_BUFFER_BLOCK_SIZE > 32768 || \
+   (TCP_LARGE_BUFFER_BLOCK_SIZE % 4) != 0)
+   #error TCP_LARGE_BUFFER_BLOCK_SIZE parameter is not valid
+#endif
+
+//Number of blocks in the large buffer pool
+#ifndef TCP_LARGE_BUFFER_BLOCK_COUNT
+   #define TCP_LARGE_BUFFER_BLOCK_COUNT 4
+#elif (TCP_LARGE_BUFFER_BLOCK_COUNT < 1 || TCP_LARGE_BUFFER_BLOCK_COUNT > 32)
+   #error TCP_LARGE_BUFFER_BLOCK_COUNT parameter is not valid
+#endif
+
+//Maximum buffer size of a socket using large buffers
+#define TCP_LARGE_BUFFER_MAX_SIZE (TCP_LARGE_BUFFER_BLOCK_SIZE * TCP_LARGE_BUFFER_BLOCK_COUNT)
+
+//Section where to place the large buffer pool (the default data section is
+//used when this parameter is not defined)
+#ifdef _DOXYGEN_
+   #define TCP_LARGE_BUFFER_SECTION ".ram_d2"
+#endif
+
+//Buffer auto-tuning
+#ifndef TCP_AUTO_TUNE_SUPPORT
+   #define TCP_AUTO_TUNE_SUPPORT DISABLED
+#elif (TCP_AUTO_TUNE_SUPPORT != ENABLED && TCP_AUTO_TUNE_SUPPORT != DISABLED)
+   #error TCP_AUTO_TUNE_SUPPORT parameter is not valid
+#endif
+
 //Default SYN queue size for listening sockets
 #ifndef TCP_DEFAULT_SYN_QUEUE_SIZE
    #define TCP_DEFAULT_SYN_QUEUE_SIZE 4
@@ -98,6 +143,13 @@
    #error TCP_DEFAULT_SYN_QUEUE_SIZE parameter is not valid
 #endif
 
+//SYN cookies (used when the SYN queue of a listening socket is full)
+#ifndef TCP_SYN_COOKIE_SUPPORT
+   #define TCP_SYN_COOKIE_SUPPORT DISABLED
+#elif (TCP_SYN_COOKIE_SUPPORT != ENABLED && TCP_SYN_COOKIE_SUPPORT != DISABLED)
+   #error TCP_SYN_COOKIE_SUPPORT parameter is not valid
+#endif
+
 //Maximum SYN queue size for listening sockets
 #ifndef TCP_MAX_SYN_QUEUE_SIZE
    #define TCP_MAX_SYN_QUEUE_SIZE 16
@@ -147,6 +199,65 @@
    #error TCP_CONGEST_CONTROL_SUPPORT parameter is not valid
 #endif
 
+//CUBIC congestion control
+#ifndef TCP_CUBIC_SUPPORT
+   #define TCP_CUBIC_SUPPORT ENABLED
+#elif (TCP_CUBIC_SUPPORT != ENABLED && TCP_CUBIC_SUPPORT != DISABLED)
+   #error TCP_CUBIC_SUPPORT parameter is not valid
+#endif
+
+//TCP pacing
+#ifndef TCP_PACING_SUPPORT
+   #define TCP_PACING_SUPPORT DISABLED
+#elif (TCP_PACING_SUPPORT != ENABLED && TCP_PACING_SUPPORT != DISABLED)
+   #error TCP_PACING_SUPPORT parameter is not valid
+#endif
+
+//The pacing rate is derived from the congestion window
+#if (TCP_PACING_SUPPORT == ENABLED && TCP_CONGEST_CONTROL_SUPPORT == DISABLED)
+   #error TCP_PACING_SUPPORT requires TCP_CONGEST_CONTROL_SUPPORT
+#endif
+
+//Pacing gain during slow start, in percent of cwnd/SRTT
+#ifndef TCP_PACING_SS_GAIN
+   #define TCP_PACING_SS_GAIN 200
+#elif (TCP_PACING_SS_GAIN < 100)
+   #error TCP_PACING_SS_GAIN parameter is not valid
+#endif
+
+//Pacing gain during congestion avoidance, in percent of cwnd/SRTT
+#ifndef TCP_PACING_CA_GAIN
+   #define TCP_PACING_CA_GAIN 120
+#elif (TCP_PACING_CA_GAIN < 100)
+   #error TCP_PACING_CA_GAIN parameter is not valid
+#endif
+
+//Shortest smoothed RTT for which segments are paced, in milliseconds
+#ifndef TCP_PACING_MIN_RTT
+   #define TCP_PACING_MIN_RTT 2
+#elif (TCP_PACING_MIN_RTT < 1)
+   #error TCP_PACING_MIN_RTT parameter is not valid
+#endif
+
+//Number of full-sized segments that may always be sent back-to-back
+#ifndef TCP_PACING_MIN_QUANTUM
+   #define TCP_PACING_MIN_QUANTUM 2
+#elif (TCP_PACING_MIN_QUANTUM < 1)
+   #error TCP_PACING_MIN_QUANTUM parameter is not valid
+#endif
+
+//Rate-based congestion control (BBR-lite)
+#ifndef TCP_BBR_LITE_SUPPORT
+   #define TCP_BBR_LITE_SUPPORT ENABLED
+#elif (TCP_BBR_LITE_SUPPORT != ENABLED && TCP_BBR_LITE_SUPPORT != DISABLED)
+   #error TCP_BBR_LITE_SUPPORT parameter is not valid
+#endif
+
+//Default congestion control algorithm
+#ifndef TCP_DEFAULT_CONGEST_ALGO
+   #define TCP_DEFAULT_CONGEST_ALGO TCP_CONGEST_ALGO_RENO
+#endif
+
 //Number of duplicate ACKs that triggers fast retransmit algorithm
 #ifndef TCP_FAST_RETRANSMIT_THRES
    #define TCP_FAST_RETRANSMIT_THRES 3
@@ -189,6 +300,13 @@
    #error TCP_OVERRIDE_TIMEOUT parameter is not valid
 #endif
 
+//Maximum time partial segments are held back on a corked socket
+#ifndef TCP_CORK_TIMEOUT
+   #define TCP_CORK_TIMEOUT 200
+#elif (TCP_CORK_TIMEOUT < TCP_TICK_INTERVAL)
+   #error TCP_CORK_TIMEOUT parameter is not valid
+#endif
+
 //FIN-WAIT-2 timer
 #ifndef TCP_FIN_WAIT_2_TIMER
    #define TCP_FIN_WAIT_2_TIMER 4000
@@ -203,6 +321,14 @@
    #error TCP_2MSL_TIMER parameter is not valid
 #endif
 
+//Number of connections tracked in the compact TIME-WAIT table (0 keeps the
+//connections in their sockets for the whole 2MSL period)
+#ifndef TCP_TIME_WAIT_TABLE_SIZE
+   #define TCP_TIME_WAIT_TABLE_SIZE 0
+#elif (TCP_TIME_WAIT_TABLE_SIZE < 0)
+   #error TCP_TIME_WAIT_TABLE_SIZE parameter is not valid
+#endif
+
 //TCP keep-alive support
 #ifndef TCP_KEEP_ALIVE_SUPPORT
    #define TCP_KEEP_ALIVE_SUPPORT DISABLED
@@ -231,6 +357,38 @@
    #error TCP_DEFAULT_KEEP_ALIVE_PROBES parameter is not valid
 #endif
 
+//Delayed ACK support
+#ifndef TCP_DELAYED_ACK_SUPPORT
+   #define TCP_DELAYED_ACK_SUPPORT DISABLED
+#elif (TCP_DELAYED_ACK_SUPPORT != ENABLED && TCP_DELAYED_ACK_SUPPORT != DISABLED)
+   #error TCP_DELAYED_ACK_SUPPORT parameter is not valid
+#endif
+
+//Delayed ACK timeout. The timer is checked every TCP_TICK_INTERVAL and an ACK
+//must not be delayed for more than 0.5 seconds (refer to RFC 1122, section
+//4.2.3.2)
+#ifndef TCP_DELAYED_ACK_TIMEOUT
+   #define TCP_DELAYED_ACK_TIMEOUT 40
+#elif (TCP_DELAYED_ACK_TIMEOUT < 0 || (TCP_DELAYED_ACK_TIMEOUT + TCP_TICK_INTERVAL) > 500)
+   #error TCP_DELAYED_ACK_TIMEOUT parameter is not valid
+#endif
+
+//Number of full-sized segments that triggers an immediate ACK
+#ifndef TCP_DELAYED_ACK_SEGMENTS
+   #define TCP_DELAYED_ACK_SEGMENTS 2
+#elif (TCP_DELAYED_ACK_SEGMENTS < 1)
+   #error TCP_DELAYED_ACK_SEGMENTS parameter is not valid
+#endif
+
+//Receiver side SWS avoidance: the window is only reopened once the space
+//available reaches the smaller of the MSS and the buffer size divided by
+//this value (refer to RFC 1122, section 4.2.3.3)
+#ifndef TCP_RX_SWS_DIVISOR
+   #define TCP_RX_SWS_DIVISOR 2
+#elif (TCP_RX_SWS_DIVISOR < 1)
+   #error TCP_RX_SWS_DIVISOR parameter is not valid
+#endif
+
 //TCP window scale option support
 #ifndef TCP_WINDOW_SCALE_SUPPORT
    #define TCP_WINDOW_SCALE_SUPPORT DISABLED
@@ -245,6 +403,42 @@
    #error TCP_SACK_SUPPORT parameter is not valid
 #endif
 
+//Timestamps option support
+#ifndef TCP_TIMESTAMPS_SUPPORT
+   #define TCP_TIMESTAMPS_SUPPORT DISABLED
+#elif (TCP_TIMESTAMPS_SUPPORT != ENABLED && TCP_TIMESTAMPS_SUPPORT != DISABLED)
+   #error TCP_TIMESTAMPS_SUPPORT parameter is not valid
+#endif
+
+//TCP Fast Open support (client side)
+#ifndef TCP_FAST_OPEN_SUPPORT
+   #define TCP_FAST_OPEN_SUPPORT DISABLED
+#elif (TCP_FAST_OPEN_SUPPORT != ENABLED && TCP_FAST_OPEN_SUPPORT != DISABLED)
+   #error TCP_FAST_OPEN_SUPPORT parameter is not valid
+#endif
+
+//Number of servers whose Fast Open cookie is cached
+#ifndef TCP_FAST_OPEN_CACHE_SIZE
+   #define TCP_FAST_OPEN_CACHE_SIZE 8
+#elif (TCP_FAST_OPEN_CACHE_SIZE < 1)
+   #error TCP_FAST_OPEN_CACHE_SIZE parameter is not valid
+#endif
+
+//Maximum length of a Fast Open cookie (refer to RFC 7413, section 4.1.1)
+#ifndef TCP_FAST_OPEN_MAX_COOKIE_SIZE
+   #define TCP_FAST_OPEN_MAX_COOKIE_SIZE 16
+#elif (TCP_FAST_OPEN_MAX_COOKIE_SIZE < 4 || TCP_FAST_OPEN_MAX_COOKIE_SIZE > 16)
+   #error TCP_FAST_OPEN_MAX_COOKIE_SIZE parameter is not valid
+#endif
+
+//Time during which Fast Open is no longer attempted with a server after a
+//SYN carrying data went unanswered (refer to RFC 7413, section 4.1.3.1)
+#ifndef TCP_FAST_OPEN_BACKOFF
+   #define TCP_FAST_OPEN_BACKOFF 600000
+#elif (TCP_FAST_OPEN_BACKOFF < 0)
+   #error TCP_FAST_OPEN_BACKOFF parameter is not valid
+#endif
+
 //Number of SACK blocks
 #ifndef TCP_MAX_SACK_BLOCKS
    #define TCP_MAX_SACK_BLOCKS 4
@@ -252,8 +446,19 @@
    #error TCP_MAX_SACK_BLOCKS parameter is not valid
 #endif
 
+//Number of ranges of out-of-order data held in the receive buffer
+#ifndef TCP_MAX_OOO_BLOCKS
+   #define TCP_MAX_OOO_BLOCKS 8
+#elif (TCP_MAX_OOO_BLOCKS < TCP_MAX_SACK_BLOCKS)
+   #error TCP_MAX_OOO_BLOCKS parameter is not valid
+#endif
+
 //Maximum TCP header length
 #define TCP_MAX_HEADER_LENGTH 60
+//Length of the Timestamps option, including padding
+#define TCP_TIMESTAMPS_OPTION_LENGTH 12
+//TS.Recent is no longer valid after 24 days of idle time (RFC 7323, 5.5)
+#define TCP_PAWS_IDLE_TIMEOUT 2073600000
 //Default maximum segment size
 #define TCP_DEFAULT_MSS 536
 
@@ -298,6 +503,18 @@ typedef enum
 } TcpCongestState;
 
 
+/**
+ * @brief TCP congestion control algorithms
+ **/
+
+typedef enum
+{
+   TCP_CONGEST_ALGO_RENO     = 0,
+   TCP_CONGEST_ALGO_CUBIC    = 1,
+   TCP_CONGEST_ALGO_BBR_LITE = 2
+} TcpCongestAlgoType;
+
+
 /**
  * @brief TCP control flags
  **/
@@ -325,7 +542,8 @@ typedef enum
    TCP_OPTION_WINDOW_SCALE_FACTOR = 3,
    TCP_OPTION_SACK_PERMITTED      = 4,
    TCP_OPTION_SACK                = 5,
-   TCP_OPTION_TIMESTAMP           = 8
+   TCP_OPTION_TIMESTAMP           = 8,
+   TCP_OPTION_FAST_OPEN_COOKIE    = 34
 } TcpOptionKind;
 
 
@@ -394,6 +612,7 @@ typedef struct _TcpQueueItem
    struct _TcpQueueItem *next;
    uint_t length;
    uint_t sacked;
+   uint_t retransmitted;
    IpPseudoHeader pseudoHeader;
    uint8_t header[TCP_MAX_HEADER_LENGTH];
 } TcpQueueItem;
@@ -419,6 +638,15 @@ typedef struct _TcpSynQueueItem
 #if (TCP_SACK_SUPPORT == ENABLED)
    bool_t sackPermitted;
 #endif
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   bool_t tsOptionReceived;
+   uint32_t tsVal;
+#endif
+#if (TCP_SYN_COOKIE_SUPPORT == ENABLED)
+   bool_t cookie;
+   uint32_t iss;
+   uint16_t window;
+#endif
 } TcpSynQueueItem;
 
 
@@ -433,6 +661,93 @@ typedef struct
 } TcpSackBlock;
 
 
+/**
+ * @brief CUBIC state
+ **/
+
+typedef struct
+{
+   uint32_t wMax;         ///<Window size just before the last reduction
+   uint32_t wLastMax;     ///<Previous value of wMax (fast convergence)
+   uint32_t origin;       ///<Origin point of the cubic function
+   uint32_t k;            ///<Time to reach the origin point, in milliseconds
+   uint32_t wEst;         ///<Reno-friendly window estimate
+   systime_t epochStart;  ///<Beginning of the current congestion avoidance epoch
+   bool_t epochValid;     ///<A congestion avoidance epoch is in progress
+} TcpCubicState;
+
+
+/**
+ * @brief BBR-lite state
+ **/
+
+typedef struct
+{
+   uint32_t btlBw;        ///<Bottleneck bandwidth estimate, in bytes per second
+   uint32_t minRtt;       ///<Minimum round-trip time, in milliseconds
+   systime_t minRttTime;  ///<Time at which minRtt was measured
+   uint32_t delivered;    ///<Bytes acknowledged during the current round
+   systime_t roundStart;  ///<Beginning of the current round
+   uint32_t fullBw;       ///<Bandwidth reference used to detect a full pipe
+   uint_t fullBwCount;    ///<Rounds without significant bandwidth growth
+   bool_t fullPipe;       ///<The bottleneck bandwidth has been reached
+} TcpBbrLiteState;
+
+
+/**
+ * @brief Congestion control algorithm state
+ **/
+
+typedef union
+{
+   TcpCubicState cubic;
+   TcpBbrLiteState bbrLite;
+} TcpCongestAlgoState;
+
+
+/**
+ * @brief Congestion control algorithm initialization
+ **/
+
+typedef void (*TcpCongestInit)(Socket *socket);
+
+
+/**
+ * @brief Incoming ACK acknowledging new data, outside fast recovery
+ **/
+
+typedef void (*TcpCongestOnAck)(Socket *socket, uint32_t n, bool_t rttFlag);
+
+
+/**
+ * @brief Loss detected by duplicate ACKs
+ **/
+
+typedef void (*TcpCongestOnLoss)(Socket *socket);
+
+
+/**
+ * @brief Loss detected by the retransmission timer
+ **/
+
+typedef void (*TcpCongestOnRto)(Socket *socket);
+
+
+/**
+ * @brief Congestion control algorithm
+ **/
+
+typedef struct
+{
+   TcpCongestAlgoType type;
+   const char_t *name;
+   TcpCongestInit init;
+   TcpCongestOnAck onAck;
+   TcpCongestOnLoss onLoss;
+   TcpCongestOnRto onRto;
+} TcpCongestAlgo;
+
+
 /**
  * @brief Transmit buffer
  **/
@@ -457,8 +772,23 @@ typedef struct
 } TcpRxBuffer;
 
 
-//Tick counter to handle periodic operations
-extern systime_t tcpTickCounter;
+/**
+ * @brief Buffer auto-tuning state
+ **/
+
+typedef struct
+{
+   bool_t txEnabled;       ///<The send buffer is sized automatically
+   bool_t rxEnabled;       ///<The receive buffer is sized automatically
+   bool_t started;         ///<Measurements have started
+   size_t txMinSize;       ///<Initial size of the send buffer
+   size_t rxMinSize;       ///<Initial size of the receive buffer
+   systime_t timestamp;    ///<Time of the last throughput measurement
+   systime_t lastActivity; ///<Time data was last acknowledged or received
+   uint32_t sndUna;        ///<SND.UNA at the last measurement
+   uint32_t rcvNxt;        ///<RCV.NXT at the last measurement
+} TcpAutoTuneState;
+
 
 //TCP related functions
 error_t tcpInit(void);
@@ -479,6 +809,11 @@ error_t tcpSend(Socket *socket, const uint8_t *data, size_t length,
 error_t tcpReceive(Socket *socket, uint8_t *data, size_t size,
    size_t *received, uint_t flags);
 
+error_t tcpReceiveInPlace(Socket *socket, const uint8_t **data,
+   size_t *length, uint_t flags);
+
+void tcpReleaseRxData(Socket *socket, size_t length);
+
 error_t tcpShutdown(Socket *socket, uint_t how);
 error_t tcpAbort(Socket *socket);
 
@@ -0,0 +1,537 @@
+/**
+ * @file tcp_auto_tune.c
+ * @brief TCP buffer auto-tuning
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ *
+ * @section Description
+ *
+ * The send and receive buffers of a connection start at the size configured
+ * for the socket and grow toward TCP_MAX_TX_BUFFER_SIZE and
+ * TCP_MAX_RX_BUFFER_SIZE as the measured bandwidth-delay product requires.
+ * Throughput is sampled every TCP_AUTO_TUNE_INTERVAL, and a buffer is sized to
+ * twice the amount of data acknowledged or received per round-trip time. The
+ * memory added beyond the initial sizes comes from a budget shared by all
+ * sockets, and is given back when a connection stays idle or is closed
+ *
+ * The circular buffers are indexed by sequence number. A buffer is resized
+ * in place: the chunks are appended or trimmed at the end, the part of the
+ * pending data that wrapped around is moved after the old end, and the
+ * sequence number offset of the buffer is updated so that pending data keeps
+ * its position
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL TCP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/tcp.h"
+#include "core/tcp_misc.h"
+#include "core/tcp_auto_tune.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (TCP_SUPPORT == ENABLED && TCP_AUTO_TUNE_SUPPORT == ENABLED)
+
+//Memory currently drawn from the shared budget (protected by netMutex)
+static size_t tcpAutoTuneUsage = 0;
+
+
+/**
+ * @brief Compute the buffer size matching a throughput measurement
+ * @param[in] length Number of bytes acknowledged or received
+ * @param[in] rtt Round-trip time, in milliseconds
+ * @param[in] interval Measurement interval, in milliseconds
+ * @return Buffer size, in bytes
+ **/
+
+static size_t tcpAutoTuneComputeSize(uint32_t length, systime_t rtt,
+   systime_t interval)
+{
+   uint64_t size;
+
+   //The buffer must hold twice the bandwidth-delay product so that the
+   //window does not close while the application catches up
+   size = ((uint64_t) length * rtt * 2) / interval;
+
+   //Round up to a whole number of memory pool blocks
+   size = (size + NET_MEM_POOL_BUFFER_SIZE - 1) / NET_MEM_POOL_BUFFER_SIZE;
+   size = MIN(size, 256) * NET_MEM_POOL_BUFFER_SIZE;
+
+   //Return the buffer size
+   return (size_t) size;
+}
+
+
+/**
+ * @brief Resize a circular buffer holding pending data
+ * @param[in] buffer Multi-part buffer to resize
+ * @param[in,out] bufferSize Size of the buffer
+ * @param[in,out] bufferOffset Sequence number offset of the buffer
+ * @param[in] origin Sequence number of the first data byte of the connection
+ * @param[in] seqNum Sequence number of the first pending byte
+ * @param[in] length Number of pending bytes
+ * @param[in] newSize Desired buffer size
+ * @return Error code
+ **/
+
+static error_t tcpAutoTuneResizeBuffer(NetBuffer *buffer, size_t *bufferSize,
+   uint32_t *bufferOffset, uint32_t origin, uint32_t seqNum, size_t length,
+   size_t newSize)
+{
+   error_t error;
+   size_t offset;
+
+   //Position of the pending data in the circular buffer
+   if(length > 0)
+   {
+      offset = (seqNum - origin - *bufferOffset) % *bufferSize;
+   }
+   else
+   {
+      offset = 0;
+   }
+
+   //The pending data must fit in the resized buffer
+   if((offset + length) > newSize)
+      return ERROR_BUFFER_OVERFLOW;
+
+   //The size of the buffer should be increased?
+   if(newSize > *bufferSize)
+   {
+      //Append chunks at the end of the buffer
+      error = netBufferSetLength(buffer, newSize);
+
+      //Failed to allocate memory?
+      if(error)
+      {
+         //Release the chunks that were allocated
+         netBufferSetLength(buffer, *bufferSize);
+         //Report an error
+         return error;
+      }
+
+      //Any pending data wrapped around the end of the old buffer?
+      if((offset + length) > *bufferSize)
+      {
+         //Move it after the old end so that the data is contiguous
+         netBufferCopy(buffer, *bufferSize, buffer, 0,
+            offset + length - *bufferSize);
+      }
+   }
+   else
+   {
+      //The pending data does not wrap around, trim the end of the buffer
+      netBufferSetLength(buffer, newSize);
+   }
+
+   //Pending data keeps its position in the buffer
+   *bufferOffset = seqNum - origin - offset;
+   *bufferSize = newSize;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Resize the send buffer of a connection
+ * @param[in] socket Handle referencing the socket
+ * @param[in] size Desired buffer size
+ **/
+
+static void tcpAutoTuneResizeTxBuffer(Socket *socket, size_t size)
+{
+   error_t error;
+   size_t oldSize;
+
+   //Save the current size of the buffer
+   oldSize = socket->tcb->txBufferSize;
+
+   //Limit the size of the buffer
+   size = MIN(size, TCP_MAX_TX_BUFFER_SIZE);
+   size = MAX(size, socket->tcb->autoTune.txMinSize);
+
+   //Growing the buffer draws from the shared budget
+   if(size > oldSize)
+   {
+      size = MIN(size, oldSize + TCP_AUTO_TUNE_BUDGET - tcpAutoTuneUsage);
+   }
+
+   //Nothing to do?
+   if(size == oldSize)
+      return;
+
+   //The data cannot move while segments referencing it are read by the DMA.
+   //The buffer is resized on a later call
+   if(netBufferIsHeld((NetBuffer *) &socket->tcb->txBuffer))
+      return;
+
+   //Pending data spans from SND.UNA to the last byte written by the user
+   error = tcpAutoTuneResizeBuffer((NetBuffer *) &socket->tcb->txBuffer,
+      &socket->tcb->txBufferSize, &socket->tcb->txBufferOffset, socket->tcb->iss + 1,
+      socket->tcb->sndUna, socket->tcb->sndUser + socket->tcb->sndNxt - socket->tcb->sndUna, size);
+
+   //The chunks have moved
+   netBufferInitCursor(&socket->tcb->txCursor, (NetBuffer *) &socket->tcb->txBuffer);
+
+   //Check status code
+   if(!error)
+   {
+      //Update the shared budget
+      tcpAutoTuneUsage = tcpAutoTuneUsage + size - oldSize;
+
+      //Debug message
+      TRACE_DEBUG("TCP send buffer resized from %" PRIuSIZE " to %" PRIuSIZE
+         " bytes\r\n", oldSize, size);
+
+      //The user may write more data
+      tcpUpdateEvents(socket);
+   }
+}
+
+
+/**
+ * @brief Resize the receive buffer of a connection
+ * @param[in] socket Handle referencing the socket
+ * @param[in] size Desired buffer size
+ **/
+
+static void tcpAutoTuneResizeRxBuffer(Socket *socket, size_t size)
+{
+   error_t error;
+   size_t oldSize;
+
+   //Out-of-order data may be held beyond RCV.NXT
+   if(socket->tcb->oooBlockCount > 0)
+      return;
+
+   //Save the current size of the buffer
+   oldSize = socket->tcb->rxBufferSize;
+
+   //Limit the size of the buffer
+   size = MIN(size, TCP_MAX_RX_BUFFER_SIZE);
+
+#if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
+   //The receive window must be representable with the negotiated scale
+   if(socket->tcb->wndScaleOptionReceived)
+   {
+      size = MIN(size, (size_t) UINT16_MAX << socket->tcb->rcvWndShift);
+   }
+   else
+#endif
+   {
+      size = MIN(size, UINT16_MAX);
+   }
+
+   //The buffer never shrinks below its initial size
+   size = MAX(size, socket->tcb->autoTune.rxMinSize);
+
+   //Growing the buffer draws from the shared budget
+   if(size > oldSize)
+   {
+      size = MIN(size, oldSize + TCP_AUTO_TUNE_BUDGET - tcpAutoTuneUsage);
+   }
+
+   //Nothing to do?
+   if(size == oldSize)
+      return;
+
+   //Pending data spans from the first byte not yet read by the user to
+   //RCV.NXT
+   error = tcpAutoTuneResizeBuffer((NetBuffer *) &socket->tcb->rxBuffer,
+      &socket->tcb->rxBufferSize, &socket->tcb->rxBufferOffset, socket->tcb->irs + 1,
+      socket->tcb->rcvNxt - socket->tcb->rcvUser, socket->tcb->rcvUser, size);
+
+   //The chunks have moved
+   netBufferInitCursor(&socket->tcb->rxCursor, (NetBuffer *) &socket->tcb->rxBuffer);
+
+   //Check status code
+   if(!error)
+   {
+      //Update the shared budget
+      tcpAutoTuneUsage = tcpAutoTuneUsage + size - oldSize;
+
+      //Debug message
+      TRACE_DEBUG("TCP receive buffer resized from %" PRIuSIZE " to %" PRIuSIZE
+         " bytes\r\n", oldSize, size);
+
+      //Check whether the buffer has grown
+      if(size > oldSize)
+      {
+         //Open the receive window
+         tcpUpdateReceiveWindow(socket);
+      }
+      else
+      {
+         //The receive window cannot exceed the free space of the buffer
+         socket->tcb->rcvWnd = MIN(socket->tcb->rcvWnd, size - socket->tcb->rcvUser);
+      }
+   }
+}
+
+
+/**
+ * @brief Start buffer auto-tuning for a connection
+ *
+ * This function is called once the buffers of the connection have been
+ * allocated. Their current size is the lower bound of the auto-tuning
+ *
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpAutoTuneInit(Socket *socket)
+{
+   //Save the initial size of the buffers
+   socket->tcb->autoTune.txMinSize = socket->tcb->txBufferSize;
+   socket->tcb->autoTune.rxMinSize = socket->tcb->rxBufferSize;
+
+   //Measurements start once the connection is established
+   socket->tcb->autoTune.started = FALSE;
+}
+
+
+/**
+ * @brief Adjust the buffers of a connection to the measured throughput
+ *
+ * This function is called from the TCP timer handler, at the time returned
+ * by tcpAutoTuneGetNextRun
+ *
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpAutoTuneBuffers(Socket *socket)
+{
+   systime_t time;
+   systime_t interval;
+   systime_t rtt;
+   uint32_t acked;
+   uint32_t received;
+   size_t size;
+
+   //Data can only be exchanged on synchronized connections
+   if(socket->tcb->state != TCP_STATE_ESTABLISHED &&
+      socket->tcb->state != TCP_STATE_CLOSE_WAIT)
+   {
+      return;
+   }
+
+#if (TCP_LARGE_BUFFER_SUPPORT == ENABLED)
+   //Large buffers are sized by the application
+   if(socket->tcb->largeBuffers)
+      return;
+#endif
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //First call since the connection was established?
+   if(!socket->tcb->autoTune.started)
+   {
+      //Start the first measurement
+      socket->tcb->autoTune.started = TRUE;
+      socket->tcb->autoTune.timestamp = time;
+      socket->tcb->autoTune.lastActivity = time;
+      socket->tcb->autoTune.sndUna = socket->tcb->sndUna;
+      socket->tcb->autoTune.rcvNxt = socket->tcb->rcvNxt;
+      return;
+   }
+
+   //Time elapsed since the last measurement
+   interval = time - socket->tcb->autoTune.timestamp;
+
+   //Measurement in progress?
+   if(interval < TCP_AUTO_TUNE_INTERVAL)
+      return;
+
+   //Amount of data acknowledged and received during the interval
+   acked = socket->tcb->sndUna - socket->tcb->autoTune.sndUna;
+   received = socket->tcb->rcvNxt - socket->tcb->autoTune.rcvNxt;
+
+   //Start a new measurement
+   socket->tcb->autoTune.timestamp = time;
+   socket->tcb->autoTune.sndUna = socket->tcb->sndUna;
+   socket->tcb->autoTune.rcvNxt = socket->tcb->rcvNxt;
+
+   //Any data exchanged?
+   if(acked > 0 || received > 0)
+   {
+      socket->tcb->autoTune.lastActivity = time;
+   }
+
+   //Short RTTs are dominated by the scheduling latency of the application
+   rtt = MAX(socket->tcb->srtt, TCP_AUTO_TUNE_MIN_RTT);
+
+   //The send buffer limits the throughput only when the user keeps it full
+   if(socket->tcb->autoTune.txEnabled && acked > 0 &&
+      (socket->tcb->sndUser + socket->tcb->sndNxt - socket->tcb->sndUna + socket->tcb->smss) >
+      socket->tcb->txBufferSize)
+   {
+      //Size of the buffer matching the measured throughput
+      size = tcpAutoTuneComputeSize(acked, rtt, interval);
+
+      //Grow the send buffer if necessary
+      if(size > socket->tcb->txBufferSize)
+      {
+         tcpAutoTuneResizeTxBuffer(socket, size);
+      }
+   }
+
+   //Adjust the receive buffer to the rate at which data arrives
+   if(socket->tcb->autoTune.rxEnabled && received > 0)
+   {
+      //Size of the buffer matching the measured throughput
+      size = tcpAutoTuneComputeSize(received, rtt, interval);
+
+      //Grow the receive buffer if necessary
+      if(size > socket->tcb->rxBufferSize)
+      {
+         tcpAutoTuneResizeRxBuffer(socket, size);
+      }
+   }
+
+   //Idle connection?
+   if(timeCompare(time, socket->tcb->autoTune.lastActivity +
+      TCP_AUTO_TUNE_IDLE_TIMEOUT) >= 0)
+   {
+      //Give the memory back to the shared budget
+      if(socket->tcb->txBufferSize > socket->tcb->autoTune.txMinSize)
+      {
+         tcpAutoTuneResizeTxBuffer(socket, socket->tcb->autoTune.txMinSize);
+      }
+
+      if(socket->tcb->rxBufferSize > socket->tcb->autoTune.rxMinSize)
+      {
+         tcpAutoTuneResizeRxBuffer(socket, socket->tcb->autoTune.rxMinSize);
+      }
+   }
+}
+
+
+/**
+ * @brief Get the time of the next measurement of a connection
+ * @param[in] socket Handle referencing the socket
+ * @param[out] time Time at which tcpAutoTuneBuffers must be called
+ * @return TRUE if the buffers of the connection are being tuned, else FALSE
+ **/
+
+bool_t tcpAutoTuneGetNextRun(Socket *socket, systime_t *time)
+{
+   //Auto-tuning disabled for both buffers?
+   if(!socket->tcb->autoTune.txEnabled && !socket->tcb->autoTune.rxEnabled)
+      return FALSE;
+
+   //Data can only be exchanged on synchronized connections
+   if(socket->tcb->state != TCP_STATE_ESTABLISHED &&
+      socket->tcb->state != TCP_STATE_CLOSE_WAIT)
+   {
+      return FALSE;
+   }
+
+#if (TCP_LARGE_BUFFER_SUPPORT == ENABLED)
+   //Large buffers are sized by the application
+   if(socket->tcb->largeBuffers)
+      return FALSE;
+#endif
+
+   //The first measurement starts as soon as possible
+   if(socket->tcb->autoTune.started)
+   {
+      *time = socket->tcb->autoTune.timestamp + TCP_AUTO_TUNE_INTERVAL;
+   }
+   else
+   {
+      *time = osGetSystemTime();
+   }
+
+   //The buffers of the connection are being tuned
+   return TRUE;
+}
+
+
+/**
+ * @brief Give the memory of a connection back to the shared budget
+ *
+ * This function is called before the buffers of the connection are released.
+ * The initial buffer sizes are restored so that a later connection on the
+ * same socket starts from them
+ *
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpAutoTuneRelease(Socket *socket)
+{
+   //Send buffer grown beyond its initial size?
+   if(socket->tcb->autoTune.txMinSize > 0 &&
+      socket->tcb->txBufferSize > socket->tcb->autoTune.txMinSize)
+   {
+      tcpAutoTuneUsage -= socket->tcb->txBufferSize - socket->tcb->autoTune.txMinSize;
+      socket->tcb->txBufferSize = socket->tcb->autoTune.txMinSize;
+   }
+
+   //Receive buffer grown beyond its initial size?
+   if(socket->tcb->autoTune.rxMinSize > 0 &&
+      socket->tcb->rxBufferSize > socket->tcb->autoTune.rxMinSize)
+   {
+      tcpAutoTuneUsage -= socket->tcb->rxBufferSize - socket->tcb->autoTune.rxMinSize;
+      socket->tcb->rxBufferSize = socket->tcb->autoTune.rxMinSize;
+   }
+
+   //Forget the initial sizes
+   socket->tcb->autoTune.txMinSize = 0;
+   socket->tcb->autoTune.rxMinSize = 0;
+   socket->tcb->autoTune.started = FALSE;
+
+   //The buffers of the next connection start at offset zero
+   socket->tcb->txBufferOffset = 0;
+   socket->tcb->rxBufferOffset = 0;
+}
+
+
+/**
+ * @brief Get the amount of memory drawn from the shared budget
+ * @return Number of bytes added to the buffers beyond their initial size
+ **/
+
+size_t tcpAutoTuneGetUsage(void)
+{
+   size_t usage;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Read the current usage
+   usage = tcpAutoTuneUsage;
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return the number of bytes in use
+   return usage;
+}
+
+#endif
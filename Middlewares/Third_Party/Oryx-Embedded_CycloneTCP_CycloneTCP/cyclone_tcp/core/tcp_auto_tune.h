@@ -0,0 +1,83 @@
+/**
+ * @file tcp_auto_tune.h
+ * @brief TCP buffer auto-tuning
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+#ifndef _TCP_AUTO_TUNE_H
+#define _TCP_AUTO_TUNE_H
+
+//Dependencies
+#include "core/tcp.h"
+
+//Memory shared by all sockets to grow their buffers beyond their initial size
+#ifndef TCP_AUTO_TUNE_BUDGET
+   #define TCP_AUTO_TUNE_BUDGET 24576
+#elif (TCP_AUTO_TUNE_BUDGET < 0)
+   #error TCP_AUTO_TUNE_BUDGET parameter is not valid
+#endif
+
+//Interval between two throughput measurements
+#ifndef TCP_AUTO_TUNE_INTERVAL
+   #define TCP_AUTO_TUNE_INTERVAL 200
+#elif (TCP_AUTO_TUNE_INTERVAL < TCP_TICK_INTERVAL)
+   #error TCP_AUTO_TUNE_INTERVAL parameter is not valid
+#endif
+
+//Lower bound of the RTT used to compute the bandwidth-delay product
+#ifndef TCP_AUTO_TUNE_MIN_RTT
+   #define TCP_AUTO_TUNE_MIN_RTT 20
+#elif (TCP_AUTO_TUNE_MIN_RTT < 1)
+   #error TCP_AUTO_TUNE_MIN_RTT parameter is not valid
+#endif
+
+//Idle time after which buffers shrink back to their initial size
+#ifndef TCP_AUTO_TUNE_IDLE_TIMEOUT
+   #define TCP_AUTO_TUNE_IDLE_TIMEOUT 5000
+#elif (TCP_AUTO_TUNE_IDLE_TIMEOUT < TCP_AUTO_TUNE_INTERVAL)
+   #error TCP_AUTO_TUNE_IDLE_TIMEOUT parameter is not valid
+#endif
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//TCP buffer auto-tuning related functions
+void tcpAutoTuneInit(Socket *socket);
+void tcpAutoTuneBuffers(Socket *socket);
+bool_t tcpAutoTuneGetNextRun(Socket *socket, systime_t *time);
+void tcpAutoTuneRelease(Socket *socket);
+
+size_t tcpAutoTuneGetUsage(void);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
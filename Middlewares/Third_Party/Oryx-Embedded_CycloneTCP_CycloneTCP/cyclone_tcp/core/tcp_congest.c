@@ -0,0 +1,555 @@
+/**
+ * @file tcp_congest.c
+ * @brief TCP congestion control algorithms
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ *
+ * @section Description
+ *
+ * The congestion window is managed by the algorithm attached to each socket.
+ * The common code handles fast retransmit, window inflation during fast
+ * recovery and the loss window after a timeout, and calls the algorithm to
+ * grow the window on new acknowledgments and to set ssthresh when a loss is
+ * detected. Three algorithms are provided:
+ * - Reno (RFC 5681), the default
+ * - CUBIC (RFC 8312), for high bandwidth-delay product paths
+ * - BBR-lite, which sizes the window after the measured delivery rate and
+ *   minimum RTT instead of probing until loss, and does not halve it on
+ *   isolated losses. It suits long paths with small send buffers
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL TCP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/tcp.h"
+#include "core/tcp_congest.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (TCP_SUPPORT == ENABLED && TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
+
+//Reno algorithm
+const TcpCongestAlgo tcpRenoAlgo =
+{
+   TCP_CONGEST_ALGO_RENO,
+   "reno",
+   tcpRenoInit,
+   tcpRenoOnAck,
+   tcpRenoOnLoss,
+   tcpRenoOnLoss
+};
+
+#if (TCP_CUBIC_SUPPORT == ENABLED)
+
+//CUBIC algorithm
+const TcpCongestAlgo tcpCubicAlgo =
+{
+   TCP_CONGEST_ALGO_CUBIC,
+   "cubic",
+   tcpCubicInit,
+   tcpCubicOnAck,
+   tcpCubicOnLoss,
+   tcpCubicOnLoss
+};
+
+#endif
+#if (TCP_BBR_LITE_SUPPORT == ENABLED)
+
+//BBR-lite algorithm
+const TcpCongestAlgo tcpBbrLiteAlgo =
+{
+   TCP_CONGEST_ALGO_BBR_LITE,
+   "bbr-lite",
+   tcpBbrLiteInit,
+   tcpBbrLiteOnAck,
+   tcpBbrLiteOnLoss,
+   tcpBbrLiteOnLoss
+};
+
+#endif
+
+
+/**
+ * @brief Get a congestion control algorithm
+ * @param[in] type Algorithm identifier
+ * @return Pointer to the algorithm, or NULL if it is not supported
+ **/
+
+const TcpCongestAlgo *tcpGetCongestAlgo(TcpCongestAlgoType type)
+{
+   const TcpCongestAlgo *algo;
+
+   //Check algorithm identifier
+   if(type == TCP_CONGEST_ALGO_RENO)
+   {
+      algo = &tcpRenoAlgo;
+   }
+#if (TCP_CUBIC_SUPPORT == ENABLED)
+   else if(type == TCP_CONGEST_ALGO_CUBIC)
+   {
+      algo = &tcpCubicAlgo;
+   }
+#endif
+#if (TCP_BBR_LITE_SUPPORT == ENABLED)
+   else if(type == TCP_CONGEST_ALGO_BBR_LITE)
+   {
+      algo = &tcpBbrLiteAlgo;
+   }
+#endif
+   else
+   {
+      algo = NULL;
+   }
+
+   //Return the algorithm
+   return algo;
+}
+
+
+/**
+ * @brief Select the congestion control algorithm of a socket
+ *
+ * The state of the algorithm is initialized. The congestion window and
+ * ssthresh are preserved, so that the algorithm can be changed while the
+ * connection is established
+ *
+ * @param[in] socket Handle referencing the socket
+ * @param[in] type Algorithm identifier
+ * @return Error code
+ **/
+
+error_t tcpSetCongestAlgo(Socket *socket, TcpCongestAlgoType type)
+{
+   const TcpCongestAlgo *algo;
+
+   //Retrieve the algorithm
+   algo = tcpGetCongestAlgo(type);
+   //Not supported?
+   if(algo == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Attach the algorithm to the socket
+   socket->tcb->congestAlgo = algo;
+   //Initialize its state
+   algo->init(socket);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Reno initialization
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpRenoInit(Socket *socket)
+{
+   //Reno has no state of its own
+   osMemset(&socket->tcb->congestAlgoState, 0, sizeof(TcpCongestAlgoState));
+}
+
+
+/**
+ * @brief Reno window update
+ * @param[in] socket Handle referencing the socket
+ * @param[in] n Number of bytes acknowledged by the incoming ACK
+ * @param[in] rttFlag An RTT measurement has just completed
+ **/
+
+void tcpRenoOnAck(Socket *socket, uint32_t n, bool_t rttFlag)
+{
+   //Slow start algorithm is used when cwnd is lower than ssthresh
+   if(socket->tcb->cwnd < socket->tcb->ssthresh)
+   {
+      //During slow start, TCP increments cwnd by at most SMSS bytes for
+      //each ACK received that cumulatively acknowledges new data
+      socket->tcb->cwnd += MIN(n, socket->tcb->smss);
+   }
+   //Congestion avoidance algorithm is used when cwnd exceeds ssthres
+   else
+   {
+      //Congestion window is updated once per RTT
+      if(rttFlag)
+      {
+         //TCP must not increment cwnd by more than SMSS bytes
+         socket->tcb->cwnd += MIN(socket->tcb->n, socket->tcb->smss);
+      }
+   }
+}
+
+
+/**
+ * @brief Reno reaction to a loss
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpRenoOnLoss(Socket *socket)
+{
+   uint32_t flightSize;
+
+   //Amount of data that has been sent but not yet acknowledged
+   flightSize = socket->tcb->sndNxt - socket->tcb->sndUna;
+   //ssthresh is set to half the flight size (refer to RFC 5681, section 3.1)
+   socket->tcb->ssthresh = MAX(flightSize / 2, (uint32_t) socket->tcb->smss * 2);
+}
+
+
+#if (TCP_CUBIC_SUPPORT == ENABLED)
+
+/**
+ * @brief CUBIC initialization
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpCubicInit(Socket *socket)
+{
+   //Clear state
+   osMemset(&socket->tcb->congestAlgoState, 0, sizeof(TcpCongestAlgoState));
+}
+
+
+/**
+ * @brief CUBIC window update
+ * @param[in] socket Handle referencing the socket
+ * @param[in] n Number of bytes acknowledged by the incoming ACK
+ * @param[in] rttFlag An RTT measurement has just completed
+ **/
+
+void tcpCubicOnAck(Socket *socket, uint32_t n, bool_t rttFlag)
+{
+   int64_t t;
+   int64_t offset;
+   int64_t target;
+   uint32_t cwnd;
+   systime_t time;
+   TcpCubicState *state;
+
+   //Point to the CUBIC state
+   state = &socket->tcb->congestAlgoState.cubic;
+   //Current congestion window
+   cwnd = socket->tcb->cwnd;
+
+   //Slow start is the same as Reno's
+   if(cwnd < socket->tcb->ssthresh)
+   {
+      socket->tcb->cwnd += MIN(n, socket->tcb->smss);
+      return;
+   }
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //Start of a congestion avoidance epoch?
+   if(!state->epochValid)
+   {
+      state->epochStart = time;
+      state->epochValid = TRUE;
+      state->wEst = cwnd;
+
+      //The window grows back to wMax in K milliseconds, where
+      //K^3 = (wMax - cwnd) / C with C = 0.4 segment/s^3
+      if(cwnd < state->wMax)
+      {
+         state->k = tcpCubicRoot(((uint64_t) (state->wMax - cwnd) *
+            10000000000ULL) / (4 * socket->tcb->smss));
+         state->origin = state->wMax;
+      }
+      else
+      {
+         state->k = 0;
+         state->origin = cwnd;
+      }
+   }
+
+   //Time elapsed since the beginning of the epoch, one RTT ahead
+   t = (int64_t) (time - state->epochStart) + socket->tcb->srtt - state->k;
+   t = MAX(t, -TCP_CUBIC_MAX_TIME);
+   t = MIN(t, TCP_CUBIC_MAX_TIME);
+
+   //Evaluate W(t) = C * (t - K)^3 + Wmax (refer to RFC 8312, section 4.1)
+   offset = (t * t * t * 4 * socket->tcb->smss) / 10000000000LL;
+   target = (int64_t) state->origin + offset;
+
+   //The window may not grow by more than half of its size per RTT
+   target = MIN(target, (int64_t) cwnd + cwnd / 2);
+   target = MAX(target, (int64_t) socket->tcb->smss);
+
+   //Estimate the window of a Reno flow with the same beta (refer to RFC 8312,
+   //section 4.2). The additive increase is 3 * (1 - beta) / (1 + beta)
+   state->wEst += (uint32_t) (((uint64_t) n * socket->tcb->smss * 9) / (17 * (uint64_t) cwnd));
+
+   //The TCP-friendly region takes precedence
+   target = MAX(target, (int64_t) state->wEst);
+
+   //Move toward the target, proportionally to the acknowledged data
+   if(target > cwnd)
+   {
+      socket->tcb->cwnd += MAX((uint32_t) (((target - cwnd) * n) / cwnd), 1);
+   }
+   else
+   {
+      //Very slow growth in the plateau region
+      socket->tcb->cwnd += ((uint64_t) n * socket->tcb->smss) / (100 * (uint64_t) cwnd);
+   }
+
+   //The RTT is already accounted for through SRTT
+   (void) rttFlag;
+}
+
+
+/**
+ * @brief CUBIC reaction to a loss
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpCubicOnLoss(Socket *socket)
+{
+   uint32_t cwnd;
+   TcpCubicState *state;
+
+   //Point to the CUBIC state
+   state = &socket->tcb->congestAlgoState.cubic;
+   //Congestion window at the time of the loss
+   cwnd = socket->tcb->cwnd;
+
+   //Fast convergence releases bandwidth to new flows (refer to RFC 8312,
+   //section 4.6)
+   if(cwnd < state->wLastMax)
+   {
+      state->wLastMax = cwnd;
+      state->wMax = (cwnd * (TCP_CUBIC_BETA_DEN + TCP_CUBIC_BETA_NUM)) /
+         (2 * TCP_CUBIC_BETA_DEN);
+   }
+   else
+   {
+      state->wLastMax = cwnd;
+      state->wMax = cwnd;
+   }
+
+   //Multiplicative decrease
+   socket->tcb->ssthresh = MAX((cwnd / TCP_CUBIC_BETA_DEN) * TCP_CUBIC_BETA_NUM,
+      (uint32_t) socket->tcb->smss * 2);
+
+   //A new epoch starts with the next window increase
+   state->epochValid = FALSE;
+}
+
+
+/**
+ * @brief Integer cube root
+ * @param[in] value Input value
+ * @return Largest integer whose cube does not exceed the value
+ **/
+
+uint32_t tcpCubicRoot(uint64_t value)
+{
+   int_t i;
+   uint64_t x;
+   uint64_t b;
+
+   //Digit-by-digit computation, 3 bits at a time
+   x = 0;
+
+   for(i = 63; i >= 0; i -= 3)
+   {
+      x <<= 1;
+      b = (3 * x * (x + 1) + 1) << i;
+
+      //Check whether the next bit can be set
+      if(value >= b && (b >> i) == (3 * x * (x + 1) + 1))
+      {
+         value -= b;
+         x++;
+      }
+   }
+
+   //Return the cube root
+   return (uint32_t) x;
+}
+
+#endif
+#if (TCP_BBR_LITE_SUPPORT == ENABLED)
+
+/**
+ * @brief BBR-lite initialization
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpBbrLiteInit(Socket *socket)
+{
+   TcpBbrLiteState *state;
+
+   //Point to the BBR-lite state
+   state = &socket->tcb->congestAlgoState.bbrLite;
+
+   //Clear state
+   osMemset(state, 0, sizeof(TcpBbrLiteState));
+
+   //No RTT sample yet
+   state->minRtt = UINT32_MAX;
+   state->roundStart = osGetSystemTime();
+}
+
+
+/**
+ * @brief BBR-lite window update
+ * @param[in] socket Handle referencing the socket
+ * @param[in] n Number of bytes acknowledged by the incoming ACK
+ * @param[in] rttFlag An RTT measurement has just completed
+ **/
+
+void tcpBbrLiteOnAck(Socket *socket, uint32_t n, bool_t rttFlag)
+{
+   uint32_t rtt;
+   uint32_t bdp;
+   uint32_t target;
+   uint64_t sample;
+   systime_t time;
+   systime_t interval;
+   TcpBbrLiteState *state;
+
+   //Point to the BBR-lite state
+   state = &socket->tcb->congestAlgoState.bbrLite;
+
+   //Count delivered data
+   state->delivered += n;
+
+   //A round ends with each RTT measurement
+   if(rttFlag)
+   {
+      //Get current time
+      time = osGetSystemTime();
+      //Duration of the round
+      interval = time - state->roundStart;
+
+      //Delivery rate of the round
+      if(interval > 0)
+      {
+         sample = ((uint64_t) state->delivered * 1000) / interval;
+         sample = MIN(sample, UINT32_MAX);
+
+         //Max filter, older samples fade by 1/8 per round
+         state->btlBw = MAX((uint32_t) sample, state->btlBw - state->btlBw / 8);
+
+         //The pipe is full once the rate stops growing by 25% for 3 rounds
+         if(!state->fullPipe)
+         {
+            if(sample >= (uint64_t) state->fullBw + state->fullBw / 4)
+            {
+               state->fullBw = (uint32_t) sample;
+               state->fullBwCount = 0;
+            }
+            else if(++state->fullBwCount >= 3)
+            {
+               state->fullPipe = TRUE;
+               //Debug message
+               TRACE_DEBUG("BBR-lite full pipe at %" PRIu32 " bytes/s\r\n",
+                  state->btlBw);
+            }
+         }
+      }
+
+      //Start a new round
+      state->delivered = 0;
+      state->roundStart = time;
+
+      //Minimum RTT filter, refreshed periodically to follow route changes
+      rtt = MAX(socket->tcb->rttSample, 1);
+
+      if(rtt <= state->minRtt ||
+         timeCompare(time, state->minRttTime + TCP_BBR_LITE_MIN_RTT_WINDOW) >= 0)
+      {
+         state->minRtt = rtt;
+         state->minRttTime = time;
+      }
+   }
+
+   //Startup phase?
+   if(!state->fullPipe || state->minRtt == UINT32_MAX)
+   {
+      //Double the window every round trip
+      socket->tcb->cwnd += n;
+   }
+   else
+   {
+      //Bandwidth-delay product
+      bdp = (uint32_t) MIN(((uint64_t) state->btlBw * state->minRtt) / 1000,
+         UINT32_MAX);
+
+      //Target window, large enough to keep the pipe full
+      target = (uint32_t) MIN((uint64_t) bdp * TCP_BBR_LITE_CWND_GAIN, UINT32_MAX);
+      target = MAX(target, (uint32_t) socket->tcb->smss * TCP_BBR_LITE_MIN_CWND);
+
+      //Grow quickly toward the target, but never overshoot it
+      if(socket->tcb->cwnd < target)
+      {
+         socket->tcb->cwnd += MIN(n, target - socket->tcb->cwnd);
+      }
+      else
+      {
+         socket->tcb->cwnd = target;
+      }
+   }
+}
+
+
+/**
+ * @brief BBR-lite reaction to a loss
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpBbrLiteOnLoss(Socket *socket)
+{
+   uint32_t bdp;
+   TcpBbrLiteState *state;
+
+   //Point to the BBR-lite state
+   state = &socket->tcb->congestAlgoState.bbrLite;
+
+   //Valid path model?
+   if(state->btlBw > 0 && state->minRtt != UINT32_MAX)
+   {
+      //The pipe is able to hold one bandwidth-delay product
+      bdp = (uint32_t) MIN(((uint64_t) state->btlBw * state->minRtt) / 1000,
+         UINT32_MAX);
+
+      //Isolated losses do not halve the window
+      socket->tcb->ssthresh = MAX(bdp, (uint32_t) socket->tcb->smss * TCP_BBR_LITE_MIN_CWND);
+   }
+   else
+   {
+      //Fall back to Reno until the path has been measured
+      tcpRenoOnLoss(socket);
+   }
+}
+
+#endif
+#endif
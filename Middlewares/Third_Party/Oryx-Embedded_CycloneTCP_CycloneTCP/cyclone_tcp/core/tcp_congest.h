@@ -0,0 +1,97 @@
+/**
+ * @file tcp_congest.h
+ * @brief TCP congestion control algorithms
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+#ifndef _TCP_CONGEST_H
+#define _TCP_CONGEST_H
+
+//Dependencies
+#include "core/tcp.h"
+
+//CUBIC multiplicative decrease factor (0.7 = 7/10)
+#define TCP_CUBIC_BETA_NUM 7
+#define TCP_CUBIC_BETA_DEN 10
+
+//Largest time offset used to evaluate the cubic function, in milliseconds
+#define TCP_CUBIC_MAX_TIME 60000
+
+//BBR-lite congestion window gain
+#ifndef TCP_BBR_LITE_CWND_GAIN
+   #define TCP_BBR_LITE_CWND_GAIN 2
+#elif (TCP_BBR_LITE_CWND_GAIN < 1)
+   #error TCP_BBR_LITE_CWND_GAIN parameter is not valid
+#endif
+
+//BBR-lite minimum congestion window, in segments
+#ifndef TCP_BBR_LITE_MIN_CWND
+   #define TCP_BBR_LITE_MIN_CWND 4
+#elif (TCP_BBR_LITE_MIN_CWND < 2)
+   #error TCP_BBR_LITE_MIN_CWND parameter is not valid
+#endif
+
+//Lifetime of the BBR-lite minimum RTT estimate, in milliseconds
+#ifndef TCP_BBR_LITE_MIN_RTT_WINDOW
+   #define TCP_BBR_LITE_MIN_RTT_WINDOW 10000
+#elif (TCP_BBR_LITE_MIN_RTT_WINDOW < 1000)
+   #error TCP_BBR_LITE_MIN_RTT_WINDOW parameter is not valid
+#endif
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Congestion control algorithms
+extern const TcpCongestAlgo tcpRenoAlgo;
+extern const TcpCongestAlgo tcpCubicAlgo;
+extern const TcpCongestAlgo tcpBbrLiteAlgo;
+
+//TCP congestion control related functions
+const TcpCongestAlgo *tcpGetCongestAlgo(TcpCongestAlgoType type);
+error_t tcpSetCongestAlgo(Socket *socket, TcpCongestAlgoType type);
+
+void tcpRenoInit(Socket *socket);
+void tcpRenoOnAck(Socket *socket, uint32_t n, bool_t rttFlag);
+void tcpRenoOnLoss(Socket *socket);
+
+void tcpCubicInit(Socket *socket);
+void tcpCubicOnAck(Socket *socket, uint32_t n, bool_t rttFlag);
+void tcpCubicOnLoss(Socket *socket);
+uint32_t tcpCubicRoot(uint64_t value);
+
+void tcpBbrLiteInit(Socket *socket);
+void tcpBbrLiteOnAck(Socket *socket, uint32_t n, bool_t rttFlag);
+void tcpBbrLiteOnLoss(Socket *socket);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
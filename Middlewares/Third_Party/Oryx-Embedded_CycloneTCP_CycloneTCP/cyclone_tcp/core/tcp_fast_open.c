@@ -0,0 +1,413 @@
+/**
+ * @file tcp_fast_open.c
+ * @brief TCP Fast Open (client side)
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * A server supporting Fast Open hands out a cookie in the SYN/ACK of a
+ * regular handshake when the SYN segment carries an empty Fast Open option.
+ * On the next connections to that server, the cookie is sent back in the SYN
+ * segment together with the first data, which the server may process before
+ * the handshake completes (refer to RFC 7413). The SYN segment is therefore
+ * deferred until the application writes its first data. Data the server did
+ * not acknowledge in its SYN/ACK is sent again once the connection is
+ * established. When a SYN segment carrying data goes unanswered, the SYN is
+ * retransmitted without data nor option and Fast Open is no longer attempted
+ * with that server for TCP_FAST_OPEN_BACKOFF. The cache is protected by
+ * netMutex
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL TCP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/tcp.h"
+#include "core/tcp_misc.h"
+#include "core/tcp_fast_open.h"
+#include "core/ip.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (TCP_SUPPORT == ENABLED && TCP_FAST_OPEN_SUPPORT == ENABLED)
+
+//Cookies of the most recently contacted servers
+static TcpFastOpenCacheEntry tcpFastOpenCache[TCP_FAST_OPEN_CACHE_SIZE];
+
+
+/**
+ * @brief Search the cache for a server
+ * @param[in] serverIpAddr IP address of the server
+ * @return Pointer to the matching entry, if any
+ **/
+
+static TcpFastOpenCacheEntry *tcpFastOpenFindEntry(const IpAddr *serverIpAddr)
+{
+   uint_t i;
+   TcpFastOpenCacheEntry *entry;
+
+   //Loop through the cache
+   for(i = 0; i < TCP_FAST_OPEN_CACHE_SIZE; i++)
+   {
+      //Point to the current entry
+      entry = &tcpFastOpenCache[i];
+
+      //Matching server?
+      if(entry->serverIpAddr.length != 0 &&
+         ipCompAddr(&entry->serverIpAddr, serverIpAddr))
+      {
+         return entry;
+      }
+   }
+
+   //The server is not in the cache
+   return NULL;
+}
+
+
+/**
+ * @brief Get the cache entry of a server, creating it if necessary
+ * @param[in] serverIpAddr IP address of the server
+ * @return Pointer to the entry
+ **/
+
+static TcpFastOpenCacheEntry *tcpFastOpenCreateEntry(const IpAddr *serverIpAddr)
+{
+   uint_t i;
+   TcpFastOpenCacheEntry *entry;
+   TcpFastOpenCacheEntry *oldestEntry;
+
+   //Known server?
+   entry = tcpFastOpenFindEntry(serverIpAddr);
+
+   //Otherwise, reuse a free entry or the least recently used one
+   if(entry == NULL)
+   {
+      //Keep track of the oldest entry
+      oldestEntry = &tcpFastOpenCache[0];
+
+      //Loop through the cache
+      for(i = 0; i < TCP_FAST_OPEN_CACHE_SIZE; i++)
+      {
+         //Point to the current entry
+         entry = &tcpFastOpenCache[i];
+
+         //Free entry?
+         if(entry->serverIpAddr.length == 0)
+         {
+            oldestEntry = entry;
+            break;
+         }
+
+         //Keep track of the least recently used entry
+         if(timeCompare(entry->timestamp, oldestEntry->timestamp) < 0)
+         {
+            oldestEntry = entry;
+         }
+      }
+
+      //Initialize the entry
+      entry = oldestEntry;
+      osMemset(entry, 0, sizeof(TcpFastOpenCacheEntry));
+      entry->serverIpAddr = *serverIpAddr;
+      entry->mss = TCP_DEFAULT_MSS;
+   }
+
+   //Refresh the entry
+   entry->timestamp = osGetSystemTime();
+
+   //Return a pointer to the entry
+   return entry;
+}
+
+
+/**
+ * @brief Prepare the SYN segment of an active open
+ *
+ * The SYN segment requests a cookie when none is cached for the server. When
+ * a cookie is cached, the SYN segment is deferred so that it carries the
+ * first data written to the socket
+ *
+ * @param[in] socket Handle referencing the socket
+ * @return TRUE if the SYN segment is deferred, else FALSE
+ **/
+
+bool_t tcpFastOpenConnect(Socket *socket)
+{
+   TcpFastOpenCacheEntry *entry;
+
+   //By default, the connection is opened with a regular handshake
+   socket->tcb->fastOpenOption = FALSE;
+   socket->tcb->fastOpenPending = FALSE;
+   socket->tcb->fastOpenCookieLen = 0;
+   socket->tcb->fastOpenLength = 0;
+
+   //Fast Open is only attempted on request
+   if((socket->options & SOCKET_OPTION_TCP_FAST_OPEN) == 0)
+      return FALSE;
+
+   //Search the cache for the server
+   entry = tcpFastOpenFindEntry(&socket->remoteIpAddr);
+
+   //Did a previous attempt with this server fail?
+   if(entry != NULL && entry->failed)
+   {
+      //Fast Open is not attempted again for a while, as the path probably
+      //drops SYN segments carrying data
+      if(timeCompare(osGetSystemTime(), entry->failureTime +
+         TCP_FAST_OPEN_BACKOFF) < 0)
+      {
+         return FALSE;
+      }
+
+      //The back-off period has elapsed
+      entry->failed = FALSE;
+   }
+
+   //The SYN segment carries a Fast Open option
+   socket->tcb->fastOpenOption = TRUE;
+
+   //No cookie known for the server?
+   if(entry == NULL || entry->cookieLen == 0)
+   {
+      //Request a cookie with an empty option
+      return FALSE;
+   }
+
+   //Send the cached cookie back to the server
+   osMemcpy(socket->tcb->fastOpenCookie, entry->cookie, entry->cookieLen);
+   socket->tcb->fastOpenCookieLen = entry->cookieLen;
+
+   //The data carried by the SYN segment is sized after the MSS announced by
+   //the server on the previous connection
+   socket->tcb->smss = MIN(entry->mss, socket->tcb->mss);
+   socket->tcb->smss = MAX(socket->tcb->smss, TCP_MIN_MSS);
+
+   //Debug message
+   TRACE_DEBUG("TCP Fast Open: SYN segment deferred (%" PRIuSIZE "-byte cookie)\r\n",
+      socket->tcb->fastOpenCookieLen);
+
+   //Hold the SYN segment until the first data is written
+   socket->tcb->fastOpenPending = TRUE;
+
+   //The SYN segment is deferred
+   return TRUE;
+}
+
+
+/**
+ * @brief Send the deferred SYN segment of a Fast Open connection
+ * @param[in] socket Handle referencing the socket
+ * @param[in] data Pointer to the data to be carried by the SYN segment
+ * @param[in] length Number of data bytes
+ * @param[out] written Number of data bytes carried by the SYN segment
+ * @return Error code
+ **/
+
+error_t tcpFastOpenSendSyn(Socket *socket, const uint8_t *data,
+   size_t length, size_t *written)
+{
+   error_t error;
+   size_t n;
+
+   //The SYN segment is no longer deferred
+   socket->tcb->fastOpenPending = FALSE;
+
+   //The data must fit in the segment along with the largest options
+   if(socket->tcb->smss > (TCP_MAX_HEADER_LENGTH - sizeof(TcpHeader)))
+   {
+      n = socket->tcb->smss - (TCP_MAX_HEADER_LENGTH - sizeof(TcpHeader));
+   }
+   else
+   {
+      n = 0;
+   }
+
+   //Number of data bytes carried by the SYN segment
+   n = MIN(n, length);
+   n = MIN(n, socket->tcb->txBufferSize);
+
+   //The data follows the SYN, which occupies the initial sequence number
+   if(n > 0)
+   {
+      tcpWriteTxBuffer(socket, socket->tcb->iss + 1, data, n);
+   }
+
+   //Send the SYN segment
+   error = tcpSendSegment(socket, TCP_FLAG_SYN, socket->tcb->iss, 0, n, TRUE);
+
+   //Check status code
+   if(!error)
+   {
+      //The data is now in flight
+      socket->tcb->sndNxt = socket->tcb->iss + 1 + n;
+      socket->tcb->fastOpenLength = n;
+   }
+   else
+   {
+      //The connection cannot be opened
+      tcpChangeState(socket, TCP_STATE_CLOSED);
+      n = 0;
+   }
+
+   //Number of data bytes carried by the SYN segment
+   if(written != NULL)
+   {
+      *written = n;
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Process the SYN/ACK segment answering a Fast Open SYN segment
+ * @param[in] socket Handle referencing the socket
+ * @param[in] segment Incoming SYN/ACK segment
+ **/
+
+void tcpFastOpenProcessSynAck(Socket *socket, const TcpHeader *segment)
+{
+   size_t n;
+   bool_t accepted;
+   const TcpOption *option;
+   TcpFastOpenCacheEntry *entry;
+
+   //The acknowledgment must cover the SYN and at most the data sent with it
+   if(TCP_CMP_SEQ(segment->ackNum, socket->tcb->iss + 1) < 0 ||
+      TCP_CMP_SEQ(segment->ackNum, socket->tcb->sndNxt) > 0)
+   {
+      return;
+   }
+
+   //Data sent in the SYN segment that the server did not accept
+   n = socket->tcb->sndNxt - segment->ackNum;
+   //Check whether the cookie was accepted
+   accepted = (socket->tcb->fastOpenLength > 0 && n == 0);
+
+   //Any data to take back?
+   if(n > 0)
+   {
+      //Debug message
+      TRACE_DEBUG("TCP Fast Open: %" PRIuSIZE " data bytes not accepted\r\n", n);
+
+      //The segment carrying the data will not be acknowledged as a whole
+      tcpFlushRetransmitQueue(socket);
+
+      //The data is sent again once the connection is established
+      socket->tcb->sndNxt = segment->ackNum;
+      socket->tcb->sndUser += n;
+   }
+
+   //No more data in flight in the SYN segment
+   socket->tcb->fastOpenLength = 0;
+
+   //The cached MSS only applies to the SYN segment
+   socket->tcb->smss = MIN(TCP_DEFAULT_MSS, socket->tcb->mss);
+
+   //Get the cache entry of the server
+   entry = tcpFastOpenCreateEntry(&socket->remoteIpAddr);
+
+   //Get the Fast Open option
+   option = tcpGetOption(segment, TCP_OPTION_FAST_OPEN_COOKIE);
+
+   //A cookie is made of 4 to 16 bytes, with an even length (refer to RFC 7413,
+   //section 4.1.1)
+   if(option != NULL && option->length >= 6 && (option->length % 2) == 0 &&
+      option->length <= (TCP_FAST_OPEN_MAX_COOKIE_SIZE + 2))
+   {
+      //Save the cookie for the next connections
+      osMemcpy(entry->cookie, option->value, option->length - 2);
+      entry->cookieLen = option->length - 2;
+   }
+   else if(!accepted && socket->tcb->fastOpenCookieLen > 0)
+   {
+      //The cookie is no longer valid, or the option was stripped on the way.
+      //The next connection requests a new cookie
+      entry->cookieLen = 0;
+   }
+   else
+   {
+      //The server accepted the cookie, or did not issue one
+   }
+
+   //Get the Maximum Segment Size option
+   option = tcpGetOption(segment, TCP_OPTION_MAX_SEGMENT_SIZE);
+
+   //Remember the MSS of the server to size the next SYN segment
+   if(option != NULL && option->length == 4)
+   {
+      entry->mss = LOAD16BE(option->value);
+   }
+   else
+   {
+      entry->mss = TCP_DEFAULT_MSS;
+   }
+}
+
+
+/**
+ * @brief Fall back to a regular handshake
+ *
+ * Called when the SYN segment carrying data has not been acknowledged within
+ * the retransmission timeout
+ *
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpFastOpenFallback(Socket *socket)
+{
+   TcpFastOpenCacheEntry *entry;
+
+   //Debug message
+   TRACE_INFO("TCP Fast Open: SYN segment with data unanswered, falling back...\r\n");
+
+   //Do not attempt Fast Open with this server for a while
+   entry = tcpFastOpenCreateEntry(&socket->remoteIpAddr);
+   entry->failed = TRUE;
+   entry->failureTime = osGetSystemTime();
+
+   //Discard the SYN segment carrying data
+   tcpFlushRetransmitQueue(socket);
+
+   //The data is sent again once the connection is established
+   socket->tcb->sndUser += socket->tcb->sndNxt - (socket->tcb->iss + 1);
+   socket->tcb->sndNxt = socket->tcb->iss + 1;
+   socket->tcb->fastOpenLength = 0;
+
+   //The SYN segment no longer carries the option
+   socket->tcb->fastOpenOption = FALSE;
+   socket->tcb->smss = MIN(TCP_DEFAULT_MSS, socket->tcb->mss);
+
+   //Retransmit a regular SYN segment
+   tcpSendSegment(socket, TCP_FLAG_SYN, socket->tcb->iss, 0, 0, TRUE);
+}
+
+#endif
@@ -0,0 +1,73 @@
+/**
+ * @file tcp_fast_open.h
+ * @brief TCP Fast Open (client side)
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+#ifndef _TCP_FAST_OPEN_H
+#define _TCP_FAST_OPEN_H
+
+//Dependencies
+#include "core/tcp.h"
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Fast Open cookie of a server
+ **/
+
+typedef struct
+{
+   IpAddr serverIpAddr;                                ///<IP address of the server (unspecified if the entry is free)
+   uint8_t cookie[TCP_FAST_OPEN_MAX_COOKIE_SIZE];      ///<Cookie issued by the server
+   size_t cookieLen;                                   ///<Length of the cookie (0 if none is known)
+   uint16_t mss;                                       ///<MSS announced by the server
+   systime_t timestamp;                                ///<Time at which the entry was last used
+   bool_t failed;                                      ///<A SYN segment carrying data went unanswered
+   systime_t failureTime;                              ///<Time at which Fast Open failed
+} TcpFastOpenCacheEntry;
+
+
+//TCP Fast Open related functions
+bool_t tcpFastOpenConnect(Socket *socket);
+
+error_t tcpFastOpenSendSyn(Socket *socket, const uint8_t *data,
+   size_t length, size_t *written);
+
+void tcpFastOpenProcessSynAck(Socket *socket, const TcpHeader *segment);
+void tcpFastOpenFallback(Socket *socket);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
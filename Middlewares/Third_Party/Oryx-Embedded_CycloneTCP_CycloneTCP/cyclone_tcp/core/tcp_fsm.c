@@ -44,10 +44,14 @@
 #include "core/net.h"
 #include "core/ip.h"
 #include "core/socket.h"
+#include "core/socket_misc.h"
 #include "core/tcp.h"
 #include "core/tcp_fsm.h"
 #include "core/tcp_misc.h"
 #include "core/tcp_timer.h"
+#include "core/tcp_time_wait.h"
+#include "core/tcp_syn_cookie.h"
+#include "core/tcp_fast_open.h"
 #include "ipv4/ipv4.h"
 #include "ipv4/ipv4_misc.h"
 #include "ipv6/ipv6.h"
@@ -70,18 +74,25 @@
  *   the packet
  **/
 
-void tcpProcessSegment(NetInterface *interface,
+__net_fast_func void tcpProcessSegment(NetInterface *interface,
    const IpPseudoHeader *pseudoHeader, const NetBuffer *buffer, size_t offset,
    const NetRxAncillary *ancillary)
 {
    uint_t i;
+#if (SOCKET_HASH_TABLE_SIZE > 0)
+   uint_t hashIndex;
+#endif
    size_t length;
    Socket *socket;
    Socket *passiveSocket;
    TcpHeader *segment;
 
+   //Start of TCP processing (latency instrumentation)
+   NET_LATENCY_MARK(NET_LATENCY_POINT_TRANSPORT);
+
    //Total number of segments received, including those received in error
    MIB2_TCP_INC_COUNTER32(tcpInSegs, 1);
+   NET_STATS_INC(tcpInSegs, 1);
    TCP_MIB_INC_COUNTER32(tcpInSegs, 1);
    TCP_MIB_INC_COUNTER64(tcpHCInSegs, 1);
 
@@ -132,6 +143,7 @@ void tcpProcessSegment(NetInterface *interface,
 
       //Total number of segments received in error
       MIB2_TCP_INC_COUNTER32(tcpInErrs, 1);
+      NET_STATS_INC(tcpInErrs, 1);
       TCP_MIB_INC_COUNTER32(tcpInErrs, 1);
 
       //Exit immediately
@@ -146,147 +158,95 @@ void tcpProcessSegment(NetInterface *interface,
 
       //Total number of segments received in error
       MIB2_TCP_INC_COUNTER32(tcpInErrs, 1);
+      NET_STATS_INC(tcpInErrs, 1);
       TCP_MIB_INC_COUNTER32(tcpInErrs, 1);
 
       //Exit immediately
       return;
    }
 
-   //Verify TCP checksum
-   if(ipCalcUpperLayerChecksumEx(pseudoHeader->data,
+   //Verify TCP checksum, unless the NIC has already done so
+   if(!NET_RX_PAYLOAD_CHECKSUM_VALID(ancillary) &&
+      ipCalcUpperLayerChecksumEx(pseudoHeader->data,
       pseudoHeader->length, buffer, offset, length) != 0x0000)
    {
       //Debug message
       TRACE_WARNING("Wrong TCP header checksum!\r\n");
+      //Update statistics
+      NET_STATS_INC(tcpInChecksumErrors, 1);
 
       //Total number of segments received in error
       MIB2_TCP_INC_COUNTER32(tcpInErrs, 1);
+      NET_STATS_INC(tcpInErrs, 1);
       TCP_MIB_INC_COUNTER32(tcpInErrs, 1);
 
       //Exit immediately
       return;
    }
 
+   //Initialize socket handle
+   socket = NULL;
    //No matching socket in the LISTEN state for the moment
    passiveSocket = NULL;
 
-   //Look through opened sockets
-   for(i = 0; i < SOCKET_MAX_COUNT; i++)
-   {
-      //Point to the current socket
-      socket = &socketTable[i];
-
-      //TCP socket found?
-      if(socket->type != SOCKET_TYPE_STREAM)
-         continue;
+#if (SOCKET_HASH_TABLE_SIZE > 0)
+   //Compute the hash value of the connection identifier
+   hashIndex = socketComputeHash(SOCKET_IP_PROTO_TCP, pseudoHeader,
+      ntohs(segment->srcPort), ntohs(segment->destPort));
 
-      //Check whether the socket is bound to a particular interface
-      if(socket->interface != NULL && socket->interface != interface)
-         continue;
+   //Check the demultiplexing cache first
+   socket = socketHashLookup(hashIndex);
 
-      //Check destination port number
-      if(socket->localPort == 0 || socket->localPort != ntohs(segment->destPort))
-         continue;
+   //Cached entries are only hints and must be validated
+   if(socket != NULL)
+   {
+      //Discard the entry if the socket no longer matches the connection
+      if(!tcpMatchSocket(socket, interface, pseudoHeader, segment) ||
+         socket->remotePort != ntohs(segment->srcPort))
+      {
+         socket = NULL;
+      }
+   }
+#endif
 
-#if (IPV4_SUPPORT == ENABLED)
-      //IPv4 packet received?
-      if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
+   //No connection found in the demultiplexing cache?
+   if(socket == NULL)
+   {
+      //Look through opened sockets
+      for(i = 0; i < SOCKET_MAX_COUNT; i++)
       {
-         //Check whether the socket is restricted to IPv6 communications only
-         if((socket->options & SOCKET_OPTION_IPV6_ONLY) != 0)
+         //Point to the current socket
+         socket = &socketTable[i];
+
+         //Check whether the socket can accept the segment
+         if(!tcpMatchSocket(socket, interface, pseudoHeader, segment))
             continue;
 
-         //Destination IP address filtering
-         if(socket->localIpAddr.length != 0)
-         {
-            //An IPv4 address is expected
-            if(socket->localIpAddr.length != sizeof(Ipv4Addr))
-               continue;
-
-            //Filter out non-matching addresses
-            if(socket->localIpAddr.ipv4Addr != IPV4_UNSPECIFIED_ADDR &&
-               socket->localIpAddr.ipv4Addr != pseudoHeader->ipv4Data.destAddr)
-            {
-               continue;
-            }
-         }
+         //Keep track of the first matching socket in the LISTEN state
+         if(socket->tcb->state == TCP_STATE_LISTEN && passiveSocket == NULL)
+            passiveSocket = socket;
 
-         //Source IP address filtering
-         if(socket->remoteIpAddr.length != 0)
-         {
-            //An IPv4 address is expected
-            if(socket->remoteIpAddr.length != sizeof(Ipv4Addr))
-               continue;
-
-            //Filter out non-matching addresses
-            if(socket->remoteIpAddr.ipv4Addr != IPV4_UNSPECIFIED_ADDR &&
-               socket->remoteIpAddr.ipv4Addr != pseudoHeader->ipv4Data.srcAddr)
-            {
-               continue;
-            }
-         }
+         //Source port filtering
+         if(socket->remotePort != ntohs(segment->srcPort))
+            continue;
+
+         //A matching socket has been found
+         break;
       }
-      else
-#endif
-#if (IPV6_SUPPORT == ENABLED)
-      //IPv6 packet received?
-      if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
-      {
-         //Destination IP address filtering
-         if(socket->localIpAddr.length != 0)
-         {
-            //An IPv6 address is expected
-            if(socket->localIpAddr.length != sizeof(Ipv6Addr))
-               continue;
-
-            //Filter out non-matching addresses
-            if(!ipv6CompAddr(&socket->localIpAddr.ipv6Addr, &IPV6_UNSPECIFIED_ADDR) &&
-               !ipv6CompAddr(&socket->localIpAddr.ipv6Addr, &pseudoHeader->ipv6Data.destAddr))
-            {
-               continue;
-            }
-         }
 
-         //Source IP address filtering
-         if(socket->remoteIpAddr.length != 0)
-         {
-            //An IPv6 address is expected
-            if(socket->remoteIpAddr.length != sizeof(Ipv6Addr))
-               continue;
-
-            //Filter out non-matching addresses
-            if(!ipv6CompAddr(&socket->remoteIpAddr.ipv6Addr, &IPV6_UNSPECIFIED_ADDR) &&
-               !ipv6CompAddr(&socket->remoteIpAddr.ipv6Addr, &pseudoHeader->ipv6Data.srcAddr))
-            {
-               continue;
-            }
-         }
+      //If no matching socket has been found then try to use the first
+      //matching socket in the LISTEN state
+      if(i >= SOCKET_MAX_COUNT)
+      {
+         socket = passiveSocket;
       }
+#if (SOCKET_HASH_TABLE_SIZE > 0)
       else
-#endif
-      //Invalid packet received?
       {
-         //This should never occur...
-         continue;
+         //Save the connection in the demultiplexing cache
+         socketHashInsert(hashIndex, socket);
       }
-
-      //Keep track of the first matching socket in the LISTEN state
-      if(socket->state == TCP_STATE_LISTEN && passiveSocket == NULL)
-         passiveSocket = socket;
-
-      //Source port filtering
-      if(socket->remotePort != ntohs(segment->srcPort))
-         continue;
-
-      //A matching socket has been found
-      break;
-   }
-
-   //If no matching socket has been found then try to use the first matching
-   //socket in the LISTEN state
-   if(i >= SOCKET_MAX_COUNT)
-   {
-      socket = passiveSocket;
+#endif
    }
 
    //Offset to the first data byte
@@ -305,7 +265,7 @@ void tcpProcessSegment(NetInterface *interface,
    }
    else
    {
-      tcpDumpHeader(segment, length, socket->irs, socket->iss);
+      tcpDumpHeader(segment, length, socket->tcb->irs, socket->tcb->iss);
    }
 
    //Convert from network byte order to host byte order
@@ -316,6 +276,16 @@ void tcpProcessSegment(NetInterface *interface,
    segment->window = ntohs(segment->window);
    segment->urgentPointer = ntohs(segment->urgentPointer);
 
+#if (TCP_TIME_WAIT_TABLE_SIZE > 0)
+   //Connections in the TIME-WAIT state no longer have a socket
+   if(socket == NULL || socket->tcb->state == TCP_STATE_LISTEN)
+   {
+      //Check whether the segment belongs to one of them
+      if(tcpTimeWaitProcessSegment(interface, pseudoHeader, segment, length))
+         return;
+   }
+#endif
+
    //Specified port unreachable?
    if(socket == NULL)
    {
@@ -331,7 +301,7 @@ void tcpProcessSegment(NetInterface *interface,
    }
 
    //Check current state
-   switch(socket->state)
+   switch(socket->tcb->state)
    {
    //Process CLOSED state
    case TCP_STATE_CLOSED:
@@ -470,6 +440,12 @@ void tcpStateListen(Socket *socket, NetInterface *interface,
    uint_t i;
    const TcpOption *option;
    TcpSynQueueItem *queueItem;
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   uint32_t tsEcr;
+#endif
+#if (TCP_SYN_COOKIE_SUPPORT == ENABLED)
+   uint16_t mss;
+#endif
 
    //Debug message
    TRACE_DEBUG("TCP FSM: LISTEN state\r\n");
@@ -482,6 +458,21 @@ void tcpStateListen(Socket *socket, NetInterface *interface,
    //LISTEN state
    if((segment->flags & TCP_FLAG_ACK) != 0)
    {
+#if (TCP_SYN_COOKIE_SUPPORT == ENABLED)
+      //The ACK may complete a handshake whose SYN/ACK carried a cookie
+      if(!tcpCheckSynCookie(socket, pseudoHeader, segment, &mss))
+      {
+         //Queue the connection, unless it is already pending
+         if(!tcpIsDuplicateSyn(socket, pseudoHeader, segment))
+         {
+            tcpQueueSynCookie(socket, interface, pseudoHeader, segment, mss);
+         }
+
+         //Return immediately
+         return;
+      }
+#endif
+
       //A reset segment should be formed for any arriving ACK-bearing segment
       tcpRejectSegment(interface, pseudoHeader, segment, length);
       //Return immediately
@@ -491,15 +482,18 @@ void tcpStateListen(Socket *socket, NetInterface *interface,
    //Check the SYN bit
    if((segment->flags & TCP_FLAG_SYN) != 0)
    {
+      //Number of connection requests received by listening sockets
+      NET_STATS_INC(tcpListenSyns, 1);
+
       //Silently drop duplicate SYN segments
       if(tcpIsDuplicateSyn(socket, pseudoHeader, segment))
          return;
 
       //Check whether the SYN queue is empty or not
-      if(socket->synQueue != NULL)
+      if(socket->tcb->synQueue != NULL)
       {
          //Point to the very first item
-         queueItem = socket->synQueue;
+         queueItem = socket->tcb->synQueue;
 
          //Reach the last item in the SYN queue
          for(i = 1; queueItem->next != NULL; i++)
@@ -508,28 +502,39 @@ void tcpStateListen(Socket *socket, NetInterface *interface,
          }
 
          //Check whether the SYN queue is full
-         if(i >= socket->synQueueSize)
+         if(i >= socket->tcb->synQueueSize)
          {
+            //Number of connection requests received with a full SYN queue
+            NET_STATS_INC(tcpListenOverflows, 1);
+
+#if (TCP_SYN_COOKIE_SUPPORT == ENABLED)
+            //Answer with a cookie instead of keeping state for the request,
+            //so that pending requests are not evicted by a SYN flood
+            tcpSendSynCookie(socket, interface, pseudoHeader, segment);
+            //Return immediately
+            return;
+#else
             //Remove the first item if the SYN queue runs out of space
-            queueItem = socket->synQueue;
-            socket->synQueue = queueItem->next;
+            queueItem = socket->tcb->synQueue;
+            socket->tcb->synQueue = queueItem->next;
             //Deallocate memory buffer
             memPoolFree(queueItem);
+#endif
          }
       }
 
       //Check whether the SYN queue is empty or not
-      if(socket->synQueue == NULL)
+      if(socket->tcb->synQueue == NULL)
       {
          //Allocate memory to save incoming data
          queueItem = memPoolAlloc(sizeof(TcpSynQueueItem));
          //Add the newly created item to the queue
-         socket->synQueue = queueItem;
+         socket->tcb->synQueue = queueItem;
       }
       else
       {
          //Point to the very first item
-         queueItem = socket->synQueue;
+         queueItem = socket->tcb->synQueue;
 
          //Reach the last item in the SYN queue
          for(i = 1; queueItem->next != NULL; i++)
@@ -545,7 +550,14 @@ void tcpStateListen(Socket *socket, NetInterface *interface,
 
       //Failed to allocate memory?
       if(queueItem == NULL)
+      {
+#if (TCP_SYN_COOKIE_SUPPORT == ENABLED)
+         //Fall back to a cookie
+         tcpSendSynCookie(socket, interface, pseudoHeader, segment);
+#endif
+         //Return immediately
          return;
+      }
 
 #if (IPV4_SUPPORT == ENABLED)
       //IPv4 is currently used?
@@ -583,6 +595,10 @@ void tcpStateListen(Socket *socket, NetInterface *interface,
 
       //Initialize next field
       queueItem->next = NULL;
+#if (TCP_SYN_COOKIE_SUPPORT == ENABLED)
+      //The SYN/ACK will be sent when the connection is accepted
+      queueItem->cookie = FALSE;
+#endif
       //Underlying network interface
       queueItem->interface = interface;
       //Save the port number of the client
@@ -603,13 +619,13 @@ void tcpStateListen(Socket *socket, NetInterface *interface,
          TRACE_DEBUG("Remote host MSS = %" PRIu16 "\r\n", queueItem->mss);
 
          //Make sure that the MSS advertised by the peer is acceptable
-         queueItem->mss = MIN(queueItem->mss, socket->mss);
+         queueItem->mss = MIN(queueItem->mss, socket->tcb->mss);
          queueItem->mss = MAX(queueItem->mss, TCP_MIN_MSS);
       }
       else
       {
          //If the option is not received, TCP must assume the default MSS
-         queueItem->mss = MIN(socket->mss, TCP_DEFAULT_MSS);
+         queueItem->mss = MIN(socket->tcb->mss, TCP_DEFAULT_MSS);
       }
 
 #if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
@@ -647,6 +663,12 @@ void tcpStateListen(Socket *socket, NetInterface *interface,
       }
 #endif
 
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+      //Get the Timestamps option
+      queueItem->tsOptionReceived = tcpGetTimestampOption(segment,
+         &queueItem->tsVal, &tsEcr);
+#endif
+
       //Notify user that a connection request is pending
       tcpUpdateEvents(socket);
 
@@ -670,15 +692,30 @@ void tcpStateListen(Socket *socket, NetInterface *interface,
 void tcpStateSynSent(Socket *socket, const TcpHeader *segment, size_t length)
 {
    const TcpOption *option;
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   uint32_t tsVal;
+   uint32_t tsEcr;
+#endif
 
    //Debug message
    TRACE_DEBUG("TCP FSM: SYN-SENT state\r\n");
 
+#if (TCP_FAST_OPEN_SUPPORT == ENABLED)
+   //SYN/ACK segment answering a Fast Open SYN segment?
+   if((segment->flags & (TCP_FLAG_SYN | TCP_FLAG_ACK | TCP_FLAG_RST)) ==
+      (TCP_FLAG_SYN | TCP_FLAG_ACK) && socket->tcb->fastOpenOption)
+   {
+      //Update the cookie cache and take back the data the server did not
+      //accept in the SYN segment
+      tcpFastOpenProcessSynAck(socket, segment);
+   }
+#endif
+
    //Check the ACK bit
    if((segment->flags & TCP_FLAG_ACK) != 0)
    {
       //Make sure the acknowledgment number is valid
-      if(segment->ackNum != socket->sndNxt)
+      if(segment->ackNum != socket->tcb->sndNxt)
       {
          //Send a reset segment unless the RST bit is set
          if((segment->flags & TCP_FLAG_RST) == 0)
@@ -714,14 +751,14 @@ void tcpStateSynSent(Socket *socket, const TcpHeader *segment, size_t length)
    if((segment->flags & TCP_FLAG_SYN) != 0)
    {
       //Save initial receive sequence number
-      socket->irs = segment->seqNum;
+      socket->tcb->irs = segment->seqNum;
       //Initialize RCV.NXT pointer
-      socket->rcvNxt = segment->seqNum + 1;
+      socket->tcb->rcvNxt = segment->seqNum + 1;
 
       //If there is an ACK, SND.UNA should be advanced to equal SEG.ACK
       if((segment->flags & TCP_FLAG_ACK) != 0)
       {
-         socket->sndUna = segment->ackNum;
+         socket->tcb->sndUna = segment->ackNum;
       }
 
       //Compute retransmission timeout
@@ -738,34 +775,41 @@ void tcpStateSynSent(Socket *socket, const TcpHeader *segment, size_t length)
       if(option != NULL && option->length == 4)
       {
          //Retrieve MSS value
-         socket->smss = LOAD16BE(option->value);
+         socket->tcb->smss = LOAD16BE(option->value);
 
          //Debug message
-         TRACE_DEBUG("Remote host MSS = %" PRIu16 "\r\n", socket->smss);
+         TRACE_DEBUG("Remote host MSS = %" PRIu16 "\r\n", socket->tcb->smss);
 
          //Make sure that the MSS advertised by the peer is acceptable
-         socket->smss = MIN(socket->smss, socket->mss);
-         socket->smss = MAX(socket->smss, TCP_MIN_MSS);
+         socket->tcb->smss = MIN(socket->tcb->smss, socket->tcb->mss);
+         socket->tcb->smss = MAX(socket->tcb->smss, TCP_MIN_MSS);
       }
 
+#if (IPV4_SUPPORT == ENABLED && IPV4_PMTU_SUPPORT == ENABLED)
+      //Segments must also fit the path MTU known for the remote host
+      tcpApplyPathMtu(socket);
+#endif
+
 #if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
       //Get the TCP Window Scale option
       option = tcpGetOption(segment, TCP_OPTION_WINDOW_SCALE_FACTOR);
 
       //This option may be sent in an initial SYN segment to enable window
-      //scaling (refer to RFC 7323, section 2.2)
-      if(option != NULL && option->length == 3)
+      //scaling (refer to RFC 7323, section 2.2). It is ignored when the
+      //initial SYN segment did not carry the option
+      if(option != NULL && option->length == 3 &&
+         tcpIsWindowScaleEnabled(socket))
       {
          //The maximum scale exponent is limited to 14 for a maximum permissible
          //receive window size of 1 GiB
-         socket->wndScaleOptionReceived = TRUE;
-         socket->sndWndShift = MIN(option->value[0], 14);
+         socket->tcb->wndScaleOptionReceived = TRUE;
+         socket->tcb->sndWndShift = MIN(option->value[0], 14);
       }
       else
       {
          //The TCP Window Scale option is not present
-         socket->wndScaleOptionReceived = FALSE;
-         socket->sndWndShift = 0;
+         socket->tcb->wndScaleOptionReceived = FALSE;
+         socket->tcb->sndWndShift = 0;
       }
 #endif
 
@@ -779,40 +823,67 @@ void tcpStateSynSent(Socket *socket, const TcpHeader *segment, size_t length)
          //This option can be sent in a SYN segment to indicate that the SACK
          //option can be used once the connection is established (refer to
          //RFC 2018, section 1)
-         socket->sackPermitted = TRUE;
+         socket->tcb->sackPermitted = TRUE;
+      }
+      else
+      {
+         //The peer does not send SACK options on this connection
+         socket->tcb->sackPermitted = FALSE;
+      }
+#endif
+
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+      //Timestamps are used on the connection if the SYN segment received
+      //carries the option (refer to RFC 7323, section 3.2)
+      if(tcpGetTimestampOption(segment, &tsVal, &tsEcr))
+      {
+         tcpEnableTimestamps(socket, tsVal);
+      }
+      else
+      {
+         socket->tcb->tsEnabled = FALSE;
       }
 #endif
 
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
       //Initial congestion window
-      socket->cwnd = MIN((uint32_t) socket->smss * TCP_INITIAL_WINDOW,
-         socket->txBufferSize);
+      socket->tcb->cwnd = MIN((uint32_t) socket->tcb->smss * TCP_INITIAL_WINDOW,
+         socket->tcb->txBufferSize);
 #endif
 
       //Check whether our SYN has been acknowledged (SND.UNA > ISS)
-      if(TCP_CMP_SEQ(socket->sndUna, socket->iss) > 0)
+      if(TCP_CMP_SEQ(socket->tcb->sndUna, socket->tcb->iss) > 0)
       {
          //Update the send window before entering ESTABLISHED state (refer to
          //RFC 1122, section 4.2.2.20)
-         socket->sndWnd = segment->window;
-         socket->sndWl1 = segment->seqNum;
-         socket->sndWl2 = segment->ackNum;
+         socket->tcb->sndWnd = segment->window;
+         socket->tcb->sndWl1 = segment->seqNum;
+         socket->tcb->sndWl2 = segment->ackNum;
 
          //Maximum send window it has seen so far on the connection
-         socket->maxSndWnd = segment->window;
+         socket->tcb->maxSndWnd = segment->window;
 
          //Form an ACK segment and send it
-         tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt, socket->rcvNxt,
+         tcpSendSegment(socket, TCP_FLAG_ACK, socket->tcb->sndNxt, socket->tcb->rcvNxt,
             0, FALSE);
 
          //Switch to the ESTABLISHED state
          tcpChangeState(socket, TCP_STATE_ESTABLISHED);
+
+#if (TCP_FAST_OPEN_SUPPORT == ENABLED)
+         //Data written before the connection was established, and not
+         //carried by the SYN segment, can be sent now
+         if(socket->tcb->sndUser > 0)
+         {
+            tcpNagleAlgo(socket, SOCKET_FLAG_NO_DELAY);
+         }
+#endif
       }
       else
       {
          //Form an SYN/ACK segment and send it
-         tcpSendSegment(socket, TCP_FLAG_SYN | TCP_FLAG_ACK, socket->iss,
-            socket->rcvNxt, 0, TRUE);
+         tcpSendSegment(socket, TCP_FLAG_SYN | TCP_FLAG_ACK, socket->tcb->iss,
+            socket->tcb->rcvNxt, 0, TRUE);
 
          //Enter SYN-RECEIVED state
          tcpChangeState(socket, TCP_STATE_SYN_RECEIVED);
@@ -850,7 +921,7 @@ void tcpStateSynReceived(Socket *socket, const TcpHeader *segment,
 
    //Check the SYN bit
    if((segment->flags & TCP_FLAG_SYN) != 0 &&
-      segment->seqNum == socket->irs)
+      segment->seqNum == socket->tcb->irs)
    {
       //Check the ACK bit
       if((segment->flags & TCP_FLAG_ACK) != 0)
@@ -862,8 +933,8 @@ void tcpStateSynReceived(Socket *socket, const TcpHeader *segment,
       else
       {
          //A retransmitted SYN means our SYN/ACK was lost
-         tcpSendSegment(socket, TCP_FLAG_SYN | TCP_FLAG_ACK, socket->iss,
-            socket->rcvNxt, 0, FALSE);
+         tcpSendSegment(socket, TCP_FLAG_SYN | TCP_FLAG_ACK, socket->tcb->iss,
+            socket->tcb->rcvNxt, 0, FALSE);
 
          //We are done
          return;
@@ -898,7 +969,7 @@ void tcpStateSynReceived(Socket *socket, const TcpHeader *segment,
       return;
 
    //Make sure the acknowledgment number is valid
-   if(segment->ackNum != socket->sndNxt)
+   if(segment->ackNum != socket->tcb->sndNxt)
    {
       //If the segment acknowledgment is not acceptable, form a reset segment
       //and send it
@@ -912,7 +983,7 @@ void tcpStateSynReceived(Socket *socket, const TcpHeader *segment,
    //The window field (SEG.WND) in the header of every incoming segment, with
    //the exception of SYN segments, MUST be left-shifted by Snd.Wind.Shift bits
    //before updating SND.WND (refer to RFC 7323, section 2.3)
-   window = (uint32_t) segment->window << socket->sndWndShift;
+   window = (uint32_t) segment->window << socket->tcb->sndWndShift;
 #else
    //The maximum unscaled window is 2^16 - 1
    window = segment->window;
@@ -920,12 +991,12 @@ void tcpStateSynReceived(Socket *socket, const TcpHeader *segment,
 
    //Update the send window before entering ESTABLISHED state (refer to
    //RFC 1122, section 4.2.2.20)
-   socket->sndWnd = window;
-   socket->sndWl1 = segment->seqNum;
-   socket->sndWl2 = segment->ackNum;
+   socket->tcb->sndWnd = window;
+   socket->tcb->sndWl1 = segment->seqNum;
+   socket->tcb->sndWl2 = segment->ackNum;
 
    //Maximum send window it has seen so far on the connection
-   socket->maxSndWnd = window;
+   socket->tcb->maxSndWnd = window;
 
    //Enter ESTABLISHED state
    tcpChangeState(socket, TCP_STATE_ESTABLISHED);
@@ -993,13 +1064,13 @@ void tcpStateEstablished(Socket *socket, const TcpHeader *segment,
    {
       //The FIN can only be acknowledged if all the segment data has been
       //successfully transferred to the receive buffer
-      if(socket->rcvNxt == (segment->seqNum + length))
+      if(socket->tcb->rcvNxt == (segment->seqNum + length))
       {
          //Advance RCV.NXT over the FIN
-         socket->rcvNxt++;
+         socket->tcb->rcvNxt++;
 
          //Send an acknowledgment for the FIN
-         tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt, socket->rcvNxt, 0,
+         tcpSendSegment(socket, TCP_FLAG_ACK, socket->tcb->sndNxt, socket->tcb->rcvNxt, 0,
             FALSE);
 
          //Switch to the CLOSE-WAIT state
@@ -1009,7 +1080,7 @@ void tcpStateEstablished(Socket *socket, const TcpHeader *segment,
 
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
    //Duplicate ACK received?
-   if(socket->dupAckCount > 0)
+   if(socket->tcb->dupAckCount > 0)
    {
       flags = SOCKET_FLAG_NO_DELAY;
    }
@@ -1069,7 +1140,7 @@ void tcpStateCloseWait(Socket *socket, const TcpHeader *segment, size_t length)
 
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
    //Duplicate ACK received?
-   if(socket->dupAckCount > 0)
+   if(socket->tcb->dupAckCount > 0)
    {
       flags = SOCKET_FLAG_NO_DELAY;
    }
@@ -1120,7 +1191,7 @@ void tcpStateLastAck(Socket *socket, const TcpHeader *segment, size_t length)
 
    //The only thing that can arrive in this state is an acknowledgment of
    //our FIN
-   if(segment->ackNum == socket->sndNxt)
+   if(segment->ackNum == socket->tcb->sndNxt)
    {
       //Enter CLOSED state
       tcpChangeState(socket, TCP_STATE_CLOSED);
@@ -1169,11 +1240,11 @@ void tcpStateFinWait1(Socket *socket, const TcpHeader *segment,
       return;
 
    //Check whether our FIN is now acknowledged
-   if(segment->ackNum == socket->sndNxt)
+   if(segment->ackNum == socket->tcb->sndNxt)
    {
       //Start the FIN-WAIT-2 timer to prevent the connection from staying in
       //the FIN-WAIT-2 state forever
-      netStartTimer(&socket->finWait2Timer, TCP_FIN_WAIT_2_TIMER);
+      tcpStartTimer(socket, &socket->tcb->finWait2Timer, TCP_FIN_WAIT_2_TIMER);
 
       //enter FIN-WAIT-2 and continue processing in that state
       tcpChangeState(socket, TCP_STATE_FIN_WAIT_2);
@@ -1190,24 +1261,20 @@ void tcpStateFinWait1(Socket *socket, const TcpHeader *segment,
    {
       //The FIN can only be acknowledged if all the segment data has been
       //successfully transferred to the receive buffer
-      if(socket->rcvNxt == (segment->seqNum + length))
+      if(socket->tcb->rcvNxt == (segment->seqNum + length))
       {
          //Advance RCV.NXT over the FIN
-         socket->rcvNxt++;
+         socket->tcb->rcvNxt++;
 
          //Send an acknowledgment for the FIN
-         tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt, socket->rcvNxt, 0,
+         tcpSendSegment(socket, TCP_FLAG_ACK, socket->tcb->sndNxt, socket->tcb->rcvNxt, 0,
             FALSE);
 
          //Check if our FIN has been acknowledged
-         if(segment->ackNum == socket->sndNxt)
+         if(segment->ackNum == socket->tcb->sndNxt)
          {
-            //Release previously allocated resources
-            tcpDeleteControlBlock(socket);
-            //Start the 2MSL timer
-            netStartTimer(&socket->timeWaitTimer, TCP_2MSL_TIMER);
-            //Switch to the TIME-WAIT state
-            tcpChangeState(socket, TCP_STATE_TIME_WAIT);
+            //Release resources and enter the TIME-WAIT state
+            tcpEnterTimeWait(socket);
          }
          else
          {
@@ -1270,21 +1337,17 @@ void tcpStateFinWait2(Socket *socket, const TcpHeader *segment,
    {
       //The FIN can only be acknowledged if all the segment data has been
       //successfully transferred to the receive buffer
-      if(socket->rcvNxt == (segment->seqNum + length))
+      if(socket->tcb->rcvNxt == (segment->seqNum + length))
       {
          //Advance RCV.NXT over the FIN
-         socket->rcvNxt++;
+         socket->tcb->rcvNxt++;
 
          //Send an acknowledgment for the FIN
-         tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt, socket->rcvNxt, 0,
+         tcpSendSegment(socket, TCP_FLAG_ACK, socket->tcb->sndNxt, socket->tcb->rcvNxt, 0,
             FALSE);
 
-         //Release previously allocated resources
-         tcpDeleteControlBlock(socket);
-         //Start the 2MSL timer
-         netStartTimer(&socket->timeWaitTimer, TCP_2MSL_TIMER);
-         //Switch to the TIME_WAIT state
-         tcpChangeState(socket, TCP_STATE_TIME_WAIT);
+         //Release resources and enter the TIME-WAIT state
+         tcpEnterTimeWait(socket);
       }
    }
 }
@@ -1329,14 +1392,10 @@ void tcpStateClosing(Socket *socket, const TcpHeader *segment, size_t length)
 
    //If the ACK acknowledges our FIN then enter the TIME-WAIT state, otherwise
    //ignore the segment
-   if(segment->ackNum == socket->sndNxt)
+   if(segment->ackNum == socket->tcb->sndNxt)
    {
-      //Release previously allocated resources
-      tcpDeleteControlBlock(socket);
-      //Start the 2MSL timer
-      netStartTimer(&socket->timeWaitTimer, TCP_2MSL_TIMER);
-      //Switch to the TIME-WAIT state
-      tcpChangeState(socket, TCP_STATE_TIME_WAIT);
+      //Release resources and enter the TIME-WAIT state
+      tcpEnterTimeWait(socket);
    }
 }
 
@@ -1380,11 +1439,11 @@ void tcpStateTimeWait(Socket *socket, const TcpHeader *segment, size_t length)
    if((segment->flags & TCP_FLAG_FIN) != 0)
    {
       //Send an acknowledgment for the FIN
-      tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt, socket->rcvNxt, 0,
+      tcpSendSegment(socket, TCP_FLAG_ACK, socket->tcb->sndNxt, socket->tcb->rcvNxt, 0,
          FALSE);
 
       //Restart the 2MSL timer
-      netStartTimer(&socket->timeWaitTimer, TCP_2MSL_TIMER);
+      tcpStartTimer(socket, &socket->tcb->timeWaitTimer, TCP_2MSL_TIMER);
    }
 }
 
@@ -0,0 +1,509 @@
+/**
+ * @file tcp_gro.c
+ * @brief Coalescing of in-order TCP segments received in a batch
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * While the NIC driver delivers a batch of frames, the IPv4 layer hands the
+ * TCP segments to this module before TCP processing. Consecutive data
+ * segments of a flow are chained into one segment, which runs through the
+ * TCP state machine once when the batch ends, when the flow receives a
+ * segment that cannot extend it, or when it reaches TCP_GRO_MAX_SEGMENTS.
+ * Only plain ACK segments are coalesced: same acknowledgment number, same
+ * options, no SYN, FIN, RST, URG nor ECN flag. A PSH segment closes the
+ * flow. The payload of each segment is taken over from the driver when the
+ * frame is offered for loan, and copied otherwise
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL TCP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/ip.h"
+#include "core/tcp.h"
+#include "core/tcp_fsm.h"
+#include "core/tcp_gro.h"
+#include "ipv4/ipv4.h"
+#include "mibs/mib2_module.h"
+#include "mibs/tcp_mib_module.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (TCP_SUPPORT == ENABLED && TCP_GRO_SUPPORT == ENABLED && \
+   IPV4_SUPPORT == ENABLED)
+
+//Flows being coalesced
+static TcpGroFlow tcpGroFlows[TCP_GRO_FLOW_COUNT];
+//Next entry to evict when the table is full
+static uint_t tcpGroVictim;
+//Statistics
+static TcpGroStats tcpGroStats;
+
+
+/**
+ * @brief Check whether a segment belongs to a flow
+ * @param[in] flow Flow being coalesced
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader TCP pseudo header
+ * @param[in] segment TCP header of the segment
+ * @return TRUE if the segment belongs to the flow, else FALSE
+ **/
+
+static bool_t tcpGroMatchFlow(const TcpGroFlow *flow, NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const TcpHeader *segment)
+{
+   const TcpHeader *header;
+
+   //Free entry?
+   if(flow->interface != interface)
+      return FALSE;
+
+   //Compare the IPv4 addresses
+   if(flow->pseudoHeader.ipv4Data.srcAddr != pseudoHeader->ipv4Data.srcAddr ||
+      flow->pseudoHeader.ipv4Data.destAddr != pseudoHeader->ipv4Data.destAddr)
+   {
+      return FALSE;
+   }
+
+   //Point to the TCP header of the flow
+   header = netBufferAt(flow->buffer, 0, 0);
+
+   //Compare the port numbers
+   return (header->srcPort == segment->srcPort &&
+      header->destPort == segment->destPort) ? TRUE : FALSE;
+}
+
+
+/**
+ * @brief Check whether a segment can be coalesced
+ * @param[in] pseudoHeader TCP pseudo header
+ * @param[in] buffer Multi-part buffer that holds the segment
+ * @param[in] offset Offset to the first byte of the TCP header
+ * @param[in] segment TCP header of the segment
+ * @param[in] length Length of the segment, header included
+ * @param[in] ancillary Additional options passed along with the segment
+ * @return TRUE if the segment can be coalesced, else FALSE
+ **/
+
+static bool_t tcpGroCheckSegment(const IpPseudoHeader *pseudoHeader,
+   const NetBuffer *buffer, size_t offset, const TcpHeader *segment,
+   size_t length, const NetRxAncillary *ancillary)
+{
+   //Plain ACK segment carrying data?
+   if((segment->flags & ~TCP_FLAG_PSH) != TCP_FLAG_ACK ||
+      segment->reserved2 != 0 || length <= (size_t) segment->dataOffset * 4)
+   {
+      return FALSE;
+   }
+
+   //The checksum of each segment is verified here, since TCP only sees the
+   //coalesced one
+   if(!NET_RX_PAYLOAD_CHECKSUM_VALID(ancillary) &&
+      ipCalcUpperLayerChecksumEx(pseudoHeader->data, pseudoHeader->length,
+      buffer, offset, length) != 0x0000)
+   {
+      //Let TCP discard the segment
+      return FALSE;
+   }
+
+   //The segment can be coalesced
+   return TRUE;
+}
+
+
+/**
+ * @brief Append the payload of a segment to a flow
+ * @param[in] flow Flow being coalesced
+ * @param[in] buffer Multi-part buffer that holds the segment
+ * @param[in] offset Offset to the first byte of the payload
+ * @param[in] length Length of the payload
+ * @return Error code
+ **/
+
+static error_t tcpGroAppend(TcpGroFlow *flow, const NetBuffer *buffer,
+   size_t offset, size_t length)
+{
+   error_t error;
+   size_t n;
+   void *data;
+
+   //Contiguous payload?
+   data = netBufferAt(buffer, offset, length);
+
+   //Take over the frame if the driver offers it for loan
+   if(data != NULL && !netBufferAcceptLoan(flow->buffer, data, length))
+      return NO_ERROR;
+
+   //Current length of the flow
+   n = netBufferGetLength(flow->buffer);
+
+   //Copy the payload
+   error = netBufferSetLength(flow->buffer, n + length);
+
+   //Check status code
+   if(!error)
+   {
+      error = netBufferCopy(flow->buffer, n, buffer, offset, length);
+   }
+
+   //Check status code
+   if(!error)
+   {
+      //Update statistics
+      tcpGroStats.copies++;
+   }
+   else
+   {
+      //Clean up side effects
+      netBufferSetLength(flow->buffer, n);
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Start a new flow with a segment
+ * @param[in] flow Free entry
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader TCP pseudo header
+ * @param[in] buffer Multi-part buffer that holds the segment
+ * @param[in] offset Offset to the first byte of the TCP header
+ * @param[in] length Length of the segment, header included
+ * @param[in] ancillary Additional options passed along with the segment
+ * @return Error code
+ **/
+
+static error_t tcpGroStartFlow(TcpGroFlow *flow, NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const NetBuffer *buffer, size_t offset,
+   size_t length, const NetRxAncillary *ancillary)
+{
+   error_t error;
+   size_t headerLength;
+   const TcpHeader *segment;
+
+   //Point to the TCP header
+   segment = netBufferAt(buffer, offset, 0);
+   //Length of the TCP header
+   headerLength = segment->dataOffset * 4;
+
+   //Allocate a buffer to hold a copy of the TCP header
+   flow->buffer = netBufferAlloc(headerLength);
+   //Failed to allocate memory?
+   if(flow->buffer == NULL)
+      return ERROR_OUT_OF_MEMORY;
+
+   //Copy the TCP header
+   error = netBufferCopy(flow->buffer, 0, buffer, offset, headerLength);
+
+   //Check status code
+   if(!error)
+   {
+      //Append the payload
+      error = tcpGroAppend(flow, buffer, offset + headerLength,
+         length - headerLength);
+   }
+
+   //Check status code
+   if(!error)
+   {
+      //Save the parameters of the flow
+      flow->interface = interface;
+      flow->pseudoHeader = *pseudoHeader;
+      flow->ancillary = *ancillary;
+      flow->headerLength = headerLength;
+      flow->length = length - headerLength;
+      flow->nextSeqNum = ntohl(segment->seqNum) + flow->length;
+      flow->count = 1;
+   }
+   else
+   {
+      //Clean up side effects
+      netBufferFree(flow->buffer);
+      flow->buffer = NULL;
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Hand the coalesced segment of a flow to TCP
+ * @param[in] flow Flow being coalesced
+ **/
+
+static void tcpGroFlushFlow(TcpGroFlow *flow)
+{
+   NetInterface *interface;
+   NetBuffer *buffer;
+   IpPseudoHeader pseudoHeader;
+   NetRxAncillary ancillary;
+
+   //Free entry?
+   if(flow->interface == NULL)
+      return;
+
+   //Detach the segment from the entry
+   interface = flow->interface;
+   buffer = flow->buffer;
+   pseudoHeader = flow->pseudoHeader;
+   ancillary = flow->ancillary;
+
+   //The pseudo header covers the whole coalesced segment
+   pseudoHeader.ipv4Data.length = htons(flow->headerLength + flow->length);
+   //The checksum of each segment has been verified already
+   ancillary.payloadChecksumValid = TRUE;
+
+   //Several segments coalesced?
+   if(flow->count > 1)
+   {
+      //TCP counts the coalesced segment once
+      MIB2_TCP_INC_COUNTER32(tcpInSegs, flow->count - 1);
+      NET_STATS_INC(tcpInSegs, flow->count - 1);
+      TCP_MIB_INC_COUNTER32(tcpInSegs, flow->count - 1);
+      TCP_MIB_INC_COUNTER64(tcpHCInSegs, flow->count - 1);
+
+      //Update statistics
+      tcpGroStats.packets++;
+   }
+
+   //Release the entry
+   flow->interface = NULL;
+   flow->buffer = NULL;
+
+   //Process the coalesced segment
+   tcpProcessSegment(interface, &pseudoHeader, buffer, 0, &ancillary);
+
+   //Release the buffer, which gives the loaned frames back to the driver
+   netBufferFree(buffer);
+}
+
+
+/**
+ * @brief Coalesce an incoming TCP segment
+ *
+ * The segment is not held when no batch is in progress, or when it cannot
+ * be coalesced. The data of its flow held so far is then handed to TCP
+ * first, so that the segments of a flow are processed in order
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader TCP pseudo header
+ * @param[in] buffer Multi-part buffer that holds the incoming TCP segment
+ * @param[in] offset Offset to the first byte of the TCP header
+ * @param[in] ancillary Additional options passed to the stack along with
+ *   the packet
+ * @return TRUE if the segment is held, FALSE if the caller must process it
+ **/
+
+bool_t tcpGroProcessSegment(NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const NetBuffer *buffer, size_t offset,
+   const NetRxAncillary *ancillary)
+{
+   uint_t i;
+   size_t length;
+   size_t headerLength;
+   bool_t eligible;
+   TcpHeader *header;
+   const TcpHeader *segment;
+   TcpGroFlow *flow;
+   TcpGroFlow *freeFlow;
+
+   //Segments are only held within a batch
+   if(!interface->nicRxBatch)
+      return FALSE;
+
+   //IPv4 segment?
+   if(pseudoHeader->length != sizeof(Ipv4PseudoHeader))
+      return FALSE;
+
+   //Retrieve the length of the TCP segment
+   length = netBufferGetLength(buffer) - offset;
+
+   //Malformed segments are left to TCP
+   if(length < sizeof(TcpHeader))
+      return FALSE;
+
+   //Point to the TCP header
+   segment = netBufferAt(buffer, offset, sizeof(TcpHeader));
+   //Sanity check
+   if(segment == NULL)
+      return FALSE;
+
+   //Length of the TCP header
+   headerLength = segment->dataOffset * 4;
+
+   //The header must be valid and contiguous
+   if(headerLength < sizeof(TcpHeader) || headerLength > length ||
+      netBufferAt(buffer, offset, headerLength) == NULL)
+   {
+      return FALSE;
+   }
+
+   //Initialize pointers
+   flow = NULL;
+   freeFlow = NULL;
+
+   //Look for the flow of the segment
+   for(i = 0; i < TCP_GRO_FLOW_COUNT; i++)
+   {
+      //Keep track of the first free entry
+      if(tcpGroFlows[i].interface == NULL)
+      {
+         if(freeFlow == NULL)
+         {
+            freeFlow = &tcpGroFlows[i];
+         }
+      }
+      else if(tcpGroMatchFlow(&tcpGroFlows[i], interface, pseudoHeader,
+         segment))
+      {
+         flow = &tcpGroFlows[i];
+         break;
+      }
+   }
+
+   //Check whether the segment can be coalesced at all
+   eligible = tcpGroCheckSegment(pseudoHeader, buffer, offset, segment, length,
+      ancillary);
+
+   //The flow has data held?
+   if(flow != NULL)
+   {
+      //Point to the TCP header of the flow
+      header = netBufferAt(flow->buffer, 0, 0);
+
+      //Does the segment extend the flow?
+      if(eligible && ntohl(segment->seqNum) == flow->nextSeqNum &&
+         segment->ackNum == header->ackNum &&
+         headerLength == flow->headerLength &&
+         !osMemcmp(segment->options, header->options,
+         headerLength - sizeof(TcpHeader)) &&
+         flow->count < TCP_GRO_MAX_SEGMENTS &&
+         (headerLength + flow->length + length) <= UINT16_MAX)
+      {
+         //Append the payload of the segment
+         if(!tcpGroAppend(flow, buffer, offset + headerLength,
+            length - headerLength))
+         {
+            //The most recent window advertisement prevails
+            header->window = segment->window;
+            header->flags |= segment->flags;
+
+            //Update the flow
+            flow->length += length - headerLength;
+            flow->nextSeqNum += length - headerLength;
+            flow->count++;
+
+            //Update statistics
+            tcpGroStats.segments++;
+
+            //The sender asks for the data to be delivered
+            if((segment->flags & TCP_FLAG_PSH) != 0 ||
+               flow->count >= TCP_GRO_MAX_SEGMENTS)
+            {
+               tcpGroFlushFlow(flow);
+            }
+
+            //The segment is held
+            return TRUE;
+         }
+      }
+
+      //The data held so far must reach TCP before the segment
+      tcpGroFlushFlow(flow);
+      //The entry can be reused
+      freeFlow = flow;
+   }
+
+   //A segment that closes its flow is not worth holding
+   if(!eligible || (segment->flags & TCP_FLAG_PSH) != 0)
+      return FALSE;
+
+   //No free entry?
+   if(freeFlow == NULL)
+   {
+      //Evict the entries in turn
+      freeFlow = &tcpGroFlows[tcpGroVictim];
+      tcpGroVictim = (tcpGroVictim + 1) % TCP_GRO_FLOW_COUNT;
+
+      //Hand its data to TCP
+      tcpGroFlushFlow(freeFlow);
+   }
+
+   //Start a new flow with the segment
+   if(tcpGroStartFlow(freeFlow, interface, pseudoHeader, buffer, offset,
+      length, ancillary))
+   {
+      return FALSE;
+   }
+
+   //Update statistics
+   tcpGroStats.segments++;
+
+   //The segment is held
+   return TRUE;
+}
+
+
+/**
+ * @brief Hand the data of all the flows to TCP
+ *
+ * This function is called at the end of every batch
+ **/
+
+void tcpGroFlush(void)
+{
+   uint_t i;
+
+   //Loop through the flows
+   for(i = 0; i < TCP_GRO_FLOW_COUNT; i++)
+   {
+      tcpGroFlushFlow(&tcpGroFlows[i]);
+   }
+}
+
+
+/**
+ * @brief Get coalescing statistics
+ * @param[out] stats Copy of the counters
+ **/
+
+void tcpGroGetStats(TcpGroStats *stats)
+{
+   //Enter critical section
+   osSuspendAllTasks();
+   //Copy the counters
+   *stats = tcpGroStats;
+   //Exit critical section
+   osResumeAllTasks();
+}
+
+#endif
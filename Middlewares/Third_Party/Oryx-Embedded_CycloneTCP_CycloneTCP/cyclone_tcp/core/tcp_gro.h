@@ -0,0 +1,132 @@
+/**
+ * @file tcp_gro.h
+ * @brief Coalescing of in-order TCP segments received in a batch
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+#ifndef _TCP_GRO_H
+#define _TCP_GRO_H
+
+//Dependencies
+#include "core/net.h"
+#include "core/ethernet.h"
+#include "core/ip.h"
+
+//Receive coalescing of TCP segments
+#ifndef TCP_GRO_SUPPORT
+   #define TCP_GRO_SUPPORT DISABLED
+#elif (TCP_GRO_SUPPORT != ENABLED && TCP_GRO_SUPPORT != DISABLED)
+   #error TCP_GRO_SUPPORT parameter is not valid
+#endif
+
+//Segments can only be held within a batch
+#if (TCP_GRO_SUPPORT == ENABLED && NIC_RX_BATCH_SUPPORT == DISABLED)
+   #error TCP_GRO_SUPPORT requires NIC_RX_BATCH_SUPPORT
+#endif
+
+//The coalesced segment is handed to TCP with its checksum marked as verified
+#if (TCP_GRO_SUPPORT == ENABLED && ETH_CHECKSUM_OFFLOAD_SUPPORT == DISABLED)
+   #error TCP_GRO_SUPPORT requires ETH_CHECKSUM_OFFLOAD_SUPPORT
+#endif
+
+//Number of flows that can be coalesced at the same time
+#ifndef TCP_GRO_FLOW_COUNT
+   #define TCP_GRO_FLOW_COUNT 4
+#elif (TCP_GRO_FLOW_COUNT < 1)
+   #error TCP_GRO_FLOW_COUNT parameter is not valid
+#endif
+
+//Maximum number of segments coalesced into one
+#ifndef TCP_GRO_MAX_SEGMENTS
+   #define TCP_GRO_MAX_SEGMENTS 4
+#elif (TCP_GRO_MAX_SEGMENTS < 2 || TCP_GRO_MAX_SEGMENTS > 8)
+   #error TCP_GRO_MAX_SEGMENTS parameter is not valid
+#endif
+
+//Coalescing hooks
+#if (TCP_GRO_SUPPORT == ENABLED && IPV4_SUPPORT == ENABLED)
+   #define TCP_GRO_PROCESS_SEGMENT(interface, pseudoHeader, buffer, offset, ancillary) \
+      tcpGroProcessSegment(interface, pseudoHeader, buffer, offset, ancillary)
+   #define TCP_GRO_FLUSH() tcpGroFlush()
+#else
+   #define TCP_GRO_PROCESS_SEGMENT(interface, pseudoHeader, buffer, offset, ancillary) FALSE
+   #define TCP_GRO_FLUSH()
+#endif
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Flow being coalesced
+ *
+ * The buffer holds a copy of the TCP header of the first segment, followed
+ * by the payload of all the segments
+ **/
+
+typedef struct
+{
+   NetInterface *interface;     ///<Underlying network interface (NULL if the entry is free)
+   IpPseudoHeader pseudoHeader; ///<Pseudo header of the first segment
+   NetRxAncillary ancillary;    ///<Ancillary data of the first segment
+   NetBuffer *buffer;           ///<TCP header and coalesced payload
+   size_t headerLength;         ///<Length of the TCP header
+   size_t length;               ///<Length of the coalesced payload
+   uint32_t nextSeqNum;         ///<Sequence number of the next segment of the flow
+   uint_t count;                ///<Number of segments coalesced so far
+} TcpGroFlow;
+
+
+/**
+ * @brief Coalescing statistics
+ **/
+
+typedef struct
+{
+   uint32_t segments;   ///<Segments held for coalescing
+   uint32_t packets;    ///<Segments handed to TCP after coalescing two or more
+   uint32_t copies;     ///<Payloads copied because the frame could not be loaned
+} TcpGroStats;
+
+
+//TCP receive coalescing related functions
+bool_t tcpGroProcessSegment(NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const NetBuffer *buffer, size_t offset,
+   const NetRxAncillary *ancillary);
+
+void tcpGroFlush(void);
+
+void tcpGroGetStats(TcpGroStats *stats);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
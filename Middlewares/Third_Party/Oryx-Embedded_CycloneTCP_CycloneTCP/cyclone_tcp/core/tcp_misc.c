@@ -34,11 +34,18 @@
 //Dependencies
 #include "core/net.h"
 #include "core/socket.h"
+#include "core/socket_misc.h"
+#include "core/socket_poll.h"
 #include "core/tcp.h"
 #include "core/tcp_misc.h"
 #include "core/tcp_timer.h"
+#include "core/tcp_auto_tune.h"
+#include "core/tcp_time_wait.h"
+#include "core/tcp_fast_open.h"
 #include "core/ip.h"
 #include "ipv4/ipv4.h"
+#include "ipv4/ipv4_misc.h"
+#include "ipv4/ipv4_pmtu.h"
 #include "ipv6/ipv6.h"
 #include "mibs/mib2_module.h"
 #include "mibs/tcp_mib_module.h"
@@ -53,6 +60,42 @@
 //Check TCP/IP stack configuration
 #if (TCP_SUPPORT == ENABLED)
 
+//Large buffer mode?
+#if (TCP_LARGE_BUFFER_SUPPORT == ENABLED)
+
+//A large buffer must fit in the chunk descriptors of the TX and RX buffers
+#if (TCP_LARGE_BUFFER_BLOCK_COUNT > N(TCP_MAX_TX_BUFFER_SIZE) || \
+   TCP_LARGE_BUFFER_BLOCK_COUNT > N(TCP_MAX_RX_BUFFER_SIZE))
+   #error TCP_LARGE_BUFFER_BLOCK_COUNT parameter is not valid
+#endif
+
+//IAR EWARM compiler?
+#if defined(__ICCARM__) && defined(TCP_LARGE_BUFFER_SECTION)
+#pragma location = TCP_LARGE_BUFFER_SECTION
+static uint32_t tcpLargeBufferPool[TCP_LARGE_BUFFER_BLOCK_COUNT][TCP_LARGE_BUFFER_BLOCK_SIZE / 4];
+//Keil MDK-ARM or GCC compiler?
+#elif defined(TCP_LARGE_BUFFER_SECTION)
+static uint32_t tcpLargeBufferPool[TCP_LARGE_BUFFER_BLOCK_COUNT][TCP_LARGE_BUFFER_BLOCK_SIZE / 4]
+   __attribute__((__section__(TCP_LARGE_BUFFER_SECTION)));
+//Default data section
+#else
+static uint32_t tcpLargeBufferPool[TCP_LARGE_BUFFER_BLOCK_COUNT][TCP_LARGE_BUFFER_BLOCK_SIZE / 4];
+#endif
+
+//Allocation table of the large buffer pool (protected by netMutex)
+static uint32_t tcpLargeBufferMap;
+
+//Blocks are returned to the pool like loaned memory, so that a block still
+//read by the DMA when its socket releases it is only reused afterwards
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED && \
+   (NET_MEM_RX_LOAN_SUPPORT == ENABLED || NET_MEM_TX_LOAN_SUPPORT == ENABLED))
+   #define TCP_LARGE_BUFFER_LOAN ENABLED
+#else
+   #define TCP_LARGE_BUFFER_LOAN DISABLED
+#endif
+
+#endif
+
 
 /**
  * @brief Send a TCP segment
@@ -65,21 +108,31 @@
  * @return Error code
  **/
 
-error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
+__net_hot_func error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
    uint32_t ackNum, size_t length, bool_t addToQueue)
 {
    error_t error;
    uint16_t mss;
+   uint_t count;
+   size_t n;
+   size_t i;
    size_t offset;
    size_t totalLength;
    NetBuffer *buffer;
    TcpHeader *segment;
+   TcpQueueItem *item;
    TcpQueueItem *queueItem;
+   TcpQueueItem *lastItem;
    IpPseudoHeader pseudoHeader;
    NetTxAncillary ancillary;
+#if (SOCKET_ROUTE_CACHE_SUPPORT == ENABLED)
+   bool_t cached;
+   NetInterface *interface;
+   IpAddr srcIpAddr;
+#endif
 
    //Maximum segment size
-   mss = HTONS(socket->rmss);
+   mss = HTONS(socket->tcb->rmss);
 
    //Allocate a memory buffer to hold the TCP segment
    buffer = ipAllocBuffer(TCP_MAX_HEADER_LENGTH, &offset);
@@ -110,6 +163,18 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
          sizeof(uint16_t));
    }
 
+#if (TCP_FAST_OPEN_SUPPORT == ENABLED)
+   //Initial SYN segment of a Fast Open connection?
+   if((flags & TCP_FLAG_SYN) != 0 && (flags & TCP_FLAG_ACK) == 0 &&
+      socket->tcb->fastOpenOption)
+   {
+      //The option carries the cached cookie, or is empty to request one
+      //(refer to RFC 7413, section 4.1.1)
+      tcpAddOption(segment, TCP_OPTION_FAST_OPEN_COOKIE,
+         socket->tcb->fastOpenCookie, (uint8_t) socket->tcb->fastOpenCookieLen);
+   }
+#endif
+
 #if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
    //SYN flag set?
    if((flags & TCP_FLAG_SYN) != 0)
@@ -119,45 +184,65 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
       {
          //The TCP Window Scale option may be sent in an initial SYN segment
          //(refer to RFC 7323, section 2.2)
-         tcpAddOption(segment, TCP_OPTION_WINDOW_SCALE_FACTOR,
-            &socket->rcvWndShift, sizeof(uint8_t));
+         if(tcpIsWindowScaleEnabled(socket))
+         {
+            tcpAddOption(segment, TCP_OPTION_WINDOW_SCALE_FACTOR,
+               &socket->tcb->rcvWndShift, sizeof(uint8_t));
+         }
       }
       else
       {
          //If a Window Scale option was received in the initial SYN segment,
          //then this option may be sent in the SYN/ACK segment
-         if(socket->wndScaleOptionReceived)
+         if(socket->tcb->wndScaleOptionReceived)
          {
             tcpAddOption(segment, TCP_OPTION_WINDOW_SCALE_FACTOR,
-               &socket->rcvWndShift, sizeof(uint8_t));
+               &socket->tcb->rcvWndShift, sizeof(uint8_t));
          }
       }
 
       //The window field in a segment where the SYN bit is set must not be
       //scaled (refer to RFC 7323, section 2.2)
-      segment->window = htons(MIN(socket->rcvWnd, UINT16_MAX));
+      segment->window = htons(MIN(socket->tcb->rcvWnd, UINT16_MAX));
    }
    else
    {
       //Check whether window scaling is enabled
-      if(socket->wndScaleOptionReceived)
+      if(socket->tcb->wndScaleOptionReceived)
       {
          //The window field (SEG.WND) of every outgoing segment, with the
          //exception of SYN segments, must be right-shifted by Rcv.Wind.Shift
          //bits (refer to RFC 7323, section 2.3)
-         segment->window = htons(socket->rcvWnd >> socket->rcvWndShift);
+         segment->window = htons(socket->tcb->rcvWnd >> socket->tcb->rcvWndShift);
       }
       else
       {
          //The maximum unscaled window is 2^16 - 1
-         segment->window = htons(MIN(socket->rcvWnd, UINT16_MAX));
+         segment->window = htons(MIN(socket->tcb->rcvWnd, UINT16_MAX));
       }
    }
 #else
    //The window field indicates the number of data octets beginning with the
    //one indicated in the acknowledgment field that the sender of this segment
    //is willing to accept (refer to RFC 793, section 3.1)
-   segment->window = htons(MIN(socket->rcvWnd, UINT16_MAX));
+   segment->window = htons(MIN(socket->tcb->rcvWnd, UINT16_MAX));
+#endif
+
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   //The Timestamps option may be sent in an initial SYN segment. Once it has
+   //been negotiated, it must be sent in every non-RST segment (refer to
+   //RFC 7323, section 3.2)
+   if(((flags & TCP_FLAG_SYN) != 0 && (flags & TCP_FLAG_ACK) == 0) ||
+      socket->tcb->tsEnabled)
+   {
+      tcpAddTimestampOption(socket, segment);
+   }
+
+   //Keep track of the last acknowledgment number sent (Last.ACK.sent)
+   if((flags & TCP_FLAG_ACK) != 0)
+   {
+      socket->tcb->tsLastAckSent = ackNum;
+   }
 #endif
 
 #if (TCP_SACK_SUPPORT == ENABLED)
@@ -173,29 +258,35 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
    {
       //If the data receiver has not received a SACK Permitted option for a
       //given connection, it must not send SACK options on that connection
-      if(socket->sackPermitted)
+      if(socket->tcb->sackPermitted)
       {
          //SACK options should be included in all ACKs which do not ACK the
          //highest sequence number in the data receiver's queue. In this
          //situation the network has lost or mis-ordered data, such that the
          //receiver holds non-contiguous data in its queue
-         if(socket->sackBlockCount > 0 &&
-            socket->sackBlockCount <= TCP_MAX_SACK_BLOCKS)
+         if(socket->tcb->sackBlockCount > 0 &&
+            socket->tcb->sackBlockCount <= TCP_MAX_SACK_BLOCKS)
          {
             uint_t i;
+            uint_t n;
             uint32_t data[TCP_MAX_SACK_BLOCKS * 2];
 
+            //Limit the number of blocks to the room left in the header (the
+            //first block reports the most recently received segment)
+            n = (TCP_MAX_HEADER_LENGTH - segment->dataOffset * 4 - 4) / 8;
+            n = MIN(n, socket->tcb->sackBlockCount);
+
             //This option contains a list of some of the blocks of contiguous
             //sequence space occupied by data that has been received and queued
             //within the window
-            for(i = 0; i < socket->sackBlockCount; i++)
+            for(i = 0; i < n; i++)
             {
-               data[i * 2] = htonl(socket->sackBlock[i].leftEdge);
-               data[i * 2 + 1] = htonl(socket->sackBlock[i].rightEdge);
+               data[i * 2] = htonl(socket->tcb->sackBlock[i].leftEdge);
+               data[i * 2 + 1] = htonl(socket->tcb->sackBlock[i].rightEdge);
             }
 
             //Append SACK option
-            tcpAddOption(segment, TCP_OPTION_SACK, data, socket->sackBlockCount * 8);
+            tcpAddOption(segment, TCP_OPTION_SACK, data, n * 8);
          }
       }
    }
@@ -207,8 +298,10 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
    //Any data to send?
    if(length > 0)
    {
-      //Copy data
-      error = tcpReadTxBuffer(socket, seqNum, buffer, length);
+      //Copy data (the data of a SYN segment follows the SYN, which occupies
+      //the first sequence number)
+      error = tcpReadTxBuffer(socket, ((flags & TCP_FLAG_SYN) != 0) ?
+         seqNum + 1 : seqNum, buffer, length);
       //Any error to report?
       if(error)
       {
@@ -234,9 +327,25 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
       pseudoHeader.ipv4Data.protocol = IPV4_PROTOCOL_TCP;
       pseudoHeader.ipv4Data.length = htons(totalLength);
 
-      //Calculate TCP header checksum
-      segment->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader.ipv4Data,
-         sizeof(Ipv4PseudoHeader), buffer, offset, totalLength);
+#if (NIC_GSO_SUPPORT == ENABLED)
+      //The segments of a GSO packet are checksummed once split
+      if(length > socket->tcb->smss)
+      {
+         segment->checksum = 0;
+      }
+      else
+#endif
+      //The checksum is inserted by the NIC when offload is active
+      if(ipv4IsChecksumOffloadEnabled(socket->interface, totalLength))
+      {
+         segment->checksum = 0;
+      }
+      else
+      {
+         //Calculate TCP header checksum
+         segment->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader.ipv4Data,
+            sizeof(Ipv4PseudoHeader), buffer, offset, totalLength);
+      }
    }
    else
 #endif
@@ -271,99 +380,175 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
    //Add current segment to retransmission queue?
    if(addToQueue)
    {
-      //Empty retransmission queue?
-      if(socket->retransmitQueue == NULL)
+      //Point to the last item of the retransmission queue
+      lastItem = socket->tcb->retransmitQueue;
+
+      //Reach the last item of the retransmission queue
+      while(lastItem != NULL && lastItem->next != NULL)
       {
-         //Create a new item
-         queueItem = memPoolAlloc(sizeof(TcpQueueItem));
-         //Add the newly created item to the queue
-         socket->retransmitQueue = queueItem;
+         lastItem = lastItem->next;
       }
-      else
+
+      //The full-sized segments of a GSO packet are queued separately, so that
+      //they are acknowledged and retransmitted one by one
+      queueItem = lastItem;
+      i = 0;
+
+      do
       {
-         //Point to the very first item
-         queueItem = socket->retransmitQueue;
+         //Length of the data carried by the current segment
+         n = MIN(length - i, socket->tcb->smss);
+
+         //Create a new item
+         item = memPoolAlloc(sizeof(TcpQueueItem));
 
-         //Reach the last item of the retransmission queue
-         while(queueItem->next != NULL)
+         //Failed to allocate memory?
+         if(item == NULL)
          {
-            queueItem = queueItem->next;
+            //Remove the items created for the previous segments
+            item = (lastItem != NULL) ? lastItem->next : socket->tcb->retransmitQueue;
+
+            while(item != NULL)
+            {
+               queueItem = item->next;
+               memPoolFree(item);
+               item = queueItem;
+            }
+
+            //Restore the end of the queue
+            if(lastItem != NULL)
+            {
+               lastItem->next = NULL;
+            }
+            else
+            {
+               socket->tcb->retransmitQueue = NULL;
+            }
+
+            //Free previously allocated memory
+            netBufferFree(buffer);
+            //Return status
+            return ERROR_OUT_OF_MEMORY;
+         }
+
+         //Add the newly created item to the queue
+         if(queueItem == NULL)
+         {
+            socket->tcb->retransmitQueue = item;
+         }
+         else
+         {
+            queueItem->next = item;
          }
 
-         //Create a new item
-         queueItem->next = memPoolAlloc(sizeof(TcpQueueItem));
          //Point to the newly created item
-         queueItem = queueItem->next;
-      }
+         queueItem = item;
+
+         //Retransmission mechanism requires additional information
+         queueItem->next = NULL;
+         queueItem->length = n;
+         queueItem->sacked = FALSE;
+         queueItem->retransmitted = FALSE;
+
+         //Save TCP header
+         osMemcpy(queueItem->header, segment, segment->dataOffset * 4);
+         //Save pseudo header
+         queueItem->pseudoHeader = pseudoHeader;
+
+#if (NIC_GSO_SUPPORT == ENABLED)
+         //Segment cut out of a GSO packet?
+         if(length > socket->tcb->smss)
+         {
+            TcpHeader *header;
 
-      //Failed to allocate memory?
-      if(queueItem == NULL)
-      {
-         //Free previously allocated memory
-         netBufferFree(buffer);
-         //Return status
-         return ERROR_OUT_OF_MEMORY;
-      }
+            //Point to the saved header
+            header = (TcpHeader *) queueItem->header;
+            header->seqNum = htonl(seqNum + i);
 
-      //Retransmission mechanism requires additional information
-      queueItem->next = NULL;
-      queueItem->length = length;
-      queueItem->sacked = FALSE;
+            //The PSH and FIN flags are carried by the last segment
+            if((i + n) < length)
+            {
+               header->flags &= (uint8_t) ~(TCP_FLAG_PSH | TCP_FLAG_FIN);
+            }
 
-      //Save TCP header
-      osMemcpy(queueItem->header, segment, segment->dataOffset * 4);
-      //Save pseudo header
-      queueItem->pseudoHeader = pseudoHeader;
+            //The pseudo header covers the segment alone
+            queueItem->pseudoHeader.ipv4Data.length = htons(
+               header->dataOffset * 4 + n);
+         }
+#endif
+
+         //Next segment
+         i += n;
+      } while(i < length);
 
       //Take one RTT measurement at a time
-      if(!socket->rttBusy)
+      if(!socket->tcb->rttBusy)
       {
          //Save round-trip start time
-         socket->rttStartTime = osGetSystemTime();
+         socket->tcb->rttStartTime = osGetSystemTime();
          //Record current sequence number
-         socket->rttSeqNum = ntohl(segment->seqNum);
+         socket->tcb->rttSeqNum = ntohl(segment->seqNum);
          //Wait for an acknowledgment that covers that sequence number...
-         socket->rttBusy = TRUE;
+         socket->tcb->rttBusy = TRUE;
 
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
          //Reset the byte counter
-         socket->n = 0;
+         socket->tcb->n = 0;
 #endif
       }
 
       //Check whether the RTO timer is running or not
-      if(!netTimerRunning(&socket->retransmitTimer))
+      if(!netTimerRunning(&socket->tcb->retransmitTimer))
       {
          //If the timer is not running, start it running so that it will expire
          //after RTO seconds
-         netStartTimer(&socket->retransmitTimer, socket->rto);
+         tcpStartTimer(socket, &socket->tcb->retransmitTimer, socket->tcb->rto);
 
          //Reset retransmission counter
-         socket->retransmitCount = 0;
+         socket->tcb->retransmitCount = 0;
       }
    }
 
 #if (TCP_KEEP_ALIVE_SUPPORT == ENABLED)
    //Check whether TCP keep-alive mechanism is enabled
-   if(socket->keepAliveEnabled)
+   if(socket->tcb->keepAliveEnabled)
    {
       //Idle condition?
-      if(socket->keepAliveProbeCount == 0)
+      if(socket->tcb->keepAliveProbeCount == 0)
       {
          //SYN or data packet?
          if((flags & TCP_FLAG_SYN) != 0 || length > 0)
          {
             //Restart keep-alive timer
-            socket->keepAliveTimestamp = osGetSystemTime();
+            socket->tcb->keepAliveTimestamp = osGetSystemTime();
          }
       }
    }
 #endif
 
+#if (TCP_DELAYED_ACK_SUPPORT == ENABLED)
+   //Any segment carrying an ACK acknowledges all the data received so far
+   if((flags & TCP_FLAG_ACK) != 0 && ackNum == socket->tcb->rcvNxt)
+   {
+      //The delayed ACK is piggybacked on this segment
+      socket->tcb->delayedAckBytes = 0;
+      netStopTimer(&socket->tcb->delayedAckTimer);
+   }
+#endif
+
+#if (NIC_GSO_SUPPORT == ENABLED)
+   //A GSO packet counts as the segments it is split into
+   count = (length > socket->tcb->smss) ? (length + socket->tcb->smss - 1) / socket->tcb->smss : 1;
+#else
+   //Single segment
+   count = 1;
+#endif
+
    //Total number of segments sent
-   MIB2_TCP_INC_COUNTER32(tcpOutSegs, 1);
-   TCP_MIB_INC_COUNTER32(tcpOutSegs, 1);
-   TCP_MIB_INC_COUNTER64(tcpHCOutSegs, 1);
+   MIB2_TCP_INC_COUNTER32(tcpOutSegs, count);
+   NET_STATS_INC(tcpOutSegs, count);
+   TCP_MIB_INC_COUNTER32(tcpOutSegs, count);
+   TCP_MIB_INC_COUNTER64(tcpHCOutSegs, count);
 
    //RST flag set?
    if((flags & TCP_FLAG_RST) != 0)
@@ -378,7 +563,7 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
       formatSystemTime(osGetSystemTime(), NULL), length);
 
    //Dump TCP header contents for debugging purpose
-   tcpDumpHeader(segment, length, socket->iss, socket->irs);
+   tcpDumpHeader(segment, length, socket->tcb->iss, socket->tcb->irs);
 
    //Additional options can be passed to the stack along with the packet
    ancillary = NET_DEFAULT_TX_ANCILLARY;
@@ -399,10 +584,59 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
    ancillary.vmanDei = socket->vmanDei;
 #endif
 
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+   //The segment is freed as soon as it has been sent
+   ancillary.zeroCopy = TRUE;
+#endif
+
+#if (NIC_GSO_SUPPORT == ENABLED)
+   //The packet is split into full-sized segments at the NIC
+   if(length > socket->tcb->smss)
+   {
+      ancillary.gsoSize = (uint16_t) socket->tcb->smss;
+   }
+#endif
+
+#if (SOCKET_ROUTE_CACHE_SUPPORT == ENABLED)
+   //The interface and the source address of a connection never change, so
+   //that only the next hop has to be retrieved from the cache
+   interface = socket->interface;
+   srcIpAddr = socket->localIpAddr;
+
+   //Reuse the next hop of the previous segment, if still valid
+   cached = socketGetCachedRoute(socket, &socket->remoteIpAddr, &interface,
+      &srcIpAddr, &ancillary);
+#endif
+
    //Send TCP segment
-   (void) ipSendDatagram(socket->interface, &pseudoHeader, buffer, offset,
+   error = ipSendDatagram(socket->interface, &pseudoHeader, buffer, offset,
       &ancillary);
 
+#if (SOCKET_ROUTE_CACHE_SUPPORT == ENABLED)
+   //Save the next hop resolved while sending the segment
+   if(!error && !cached)
+   {
+      socketUpdateCachedRoute(socket, socket->interface, &socket->localIpAddr,
+         &socket->remoteIpAddr, &ancillary);
+   }
+#endif
+
+#if (TCP_PACING_SUPPORT == ENABLED)
+   //Charge the payload to the pacing credit
+   if(!error && length > 0)
+   {
+      tcpConsumePacingCredit(socket, length);
+   }
+#endif
+
+#if (NET_SHAPER_SUPPORT == ENABLED)
+   //Charge the payload to the rate limits of the socket and its class
+   if(!error && length > 0)
+   {
+      netShaperConsume(socket, socket->tos, length);
+   }
+#endif
+
    //Free previously allocated memory
    netBufferFree(buffer);
 
@@ -426,12 +660,12 @@ error_t tcpSendResetSegment(Socket *socket, uint32_t seqNum)
    error = NO_ERROR;
 
    //Check current state
-   if(socket->state == TCP_STATE_SYN_SENT ||
-      socket->state == TCP_STATE_SYN_RECEIVED ||
-      socket->state == TCP_STATE_ESTABLISHED ||
-      socket->state == TCP_STATE_FIN_WAIT_1 ||
-      socket->state == TCP_STATE_FIN_WAIT_2 ||
-      socket->state == TCP_STATE_CLOSE_WAIT)
+   if(socket->tcb->state == TCP_STATE_SYN_SENT ||
+      socket->tcb->state == TCP_STATE_SYN_RECEIVED ||
+      socket->tcb->state == TCP_STATE_ESTABLISHED ||
+      socket->tcb->state == TCP_STATE_FIN_WAIT_1 ||
+      socket->tcb->state == TCP_STATE_FIN_WAIT_2 ||
+      socket->tcb->state == TCP_STATE_CLOSE_WAIT)
    {
       //Send a reset segment
       error = tcpSendSegment(socket, TCP_FLAG_RST, seqNum, 0, 0, FALSE);
@@ -451,7 +685,7 @@ error_t tcpSendResetSegment(Socket *socket, uint32_t seqNum)
  * @return Error code
  **/
 
-error_t tcpRejectSegment(NetInterface *interface,
+__net_cold_func error_t tcpRejectSegment(NetInterface *interface,
    const IpPseudoHeader *pseudoHeader, const TcpHeader *segment, size_t length)
 {
    error_t error;
@@ -527,9 +761,17 @@ error_t tcpRejectSegment(NetInterface *interface,
       pseudoHeader2.ipv4Data.protocol = IPV4_PROTOCOL_TCP;
       pseudoHeader2.ipv4Data.length = HTONS(sizeof(TcpHeader));
 
-      //Calculate TCP header checksum
-      segment2->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader2.ipv4Data,
-         sizeof(Ipv4PseudoHeader), buffer, offset, sizeof(TcpHeader));
+      //The checksum is inserted by the NIC when offload is active
+      if(ipv4IsChecksumOffloadEnabled(interface, sizeof(TcpHeader)))
+      {
+         segment2->checksum = 0;
+      }
+      else
+      {
+         //Calculate TCP header checksum
+         segment2->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader2.ipv4Data,
+            sizeof(Ipv4PseudoHeader), buffer, offset, sizeof(TcpHeader));
+      }
    }
    else
 #endif
@@ -563,6 +805,7 @@ error_t tcpRejectSegment(NetInterface *interface,
 
    //Total number of segments sent
    MIB2_TCP_INC_COUNTER32(tcpOutSegs, 1);
+   NET_STATS_INC(tcpOutSegs, 1);
    TCP_MIB_INC_COUNTER32(tcpOutSegs, 1);
    TCP_MIB_INC_COUNTER64(tcpHCOutSegs, 1);
 
@@ -774,17 +1017,37 @@ uint32_t tcpGenerateInitialSeqNum(const IpAddr *localIpAddr,
  * @return NO_ERROR if the incoming segment is acceptable, ERROR_FAILURE otherwise
  **/
 
-error_t tcpCheckSeqNum(Socket *socket, const TcpHeader *segment, size_t length)
+__net_hot_func error_t tcpCheckSeqNum(Socket *socket, const TcpHeader *segment, size_t length)
 {
    bool_t acceptable;
 
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   //Protection against wrapped sequence numbers (refer to RFC 7323,
+   //section 5.3)
+   if(!tcpCheckPaws(socket, segment))
+   {
+      //Debug message
+      TRACE_WARNING("TCP segment rejected by PAWS!\r\n");
+
+      //An acknowledgment is sent in reply (unless the RST bit is set)
+      if((segment->flags & TCP_FLAG_RST) == 0)
+      {
+         tcpSendSegment(socket, TCP_FLAG_ACK, socket->tcb->sndNxt, socket->tcb->rcvNxt,
+            0, FALSE);
+      }
+
+      //Drop the segment
+      return ERROR_FAILURE;
+   }
+#endif
+
    //Due to zero windows and zero length segments, we have four cases for the
    //acceptability of an incoming segment (refer to RFC 793, section 3.3)
-   if(length == 0 && socket->rcvWnd == 0)
+   if(length == 0 && socket->tcb->rcvWnd == 0)
    {
       //If both segment length and receive window are zero, then test if
       //SEG.SEQ = RCV.NXT
-      if(segment->seqNum == socket->rcvNxt)
+      if(segment->seqNum == socket->tcb->rcvNxt)
       {
          acceptable = TRUE;
       }
@@ -793,12 +1056,12 @@ error_t tcpCheckSeqNum(Socket *socket, const TcpHeader *segment, size_t length)
          acceptable = FALSE;
       }
    }
-   else if(length == 0 && socket->rcvWnd != 0)
+   else if(length == 0 && socket->tcb->rcvWnd != 0)
    {
       //If segment length is zero and receive window is non zero, then test if
       //RCV.NXT <= SEG.SEQ < RCV.NXT+RCV.WND
-      if(TCP_CMP_SEQ(segment->seqNum, socket->rcvNxt) >= 0 &&
-         TCP_CMP_SEQ(segment->seqNum, socket->rcvNxt + socket->rcvWnd) < 0)
+      if(TCP_CMP_SEQ(segment->seqNum, socket->tcb->rcvNxt) >= 0 &&
+         TCP_CMP_SEQ(segment->seqNum, socket->tcb->rcvNxt + socket->tcb->rcvWnd) < 0)
       {
          acceptable = TRUE;
       }
@@ -807,7 +1070,7 @@ error_t tcpCheckSeqNum(Socket *socket, const TcpHeader *segment, size_t length)
          acceptable = FALSE;
       }
    }
-   else if(length != 0 && socket->rcvWnd == 0)
+   else if(length != 0 && socket->tcb->rcvWnd == 0)
    {
       //If segment length is non zero and receive window is zero, then the
       //sequence number is not acceptable
@@ -818,13 +1081,13 @@ error_t tcpCheckSeqNum(Socket *socket, const TcpHeader *segment, size_t length)
       //If both segment length and receive window are non zero, then test if
       //RCV.NXT <= SEG.SEQ < RCV.NXT+RCV.WND or
       //RCV.NXT <= SEG.SEQ+SEG.LEN-1 < RCV.NXT+RCV.WND
-      if(TCP_CMP_SEQ(segment->seqNum, socket->rcvNxt) >= 0 &&
-         TCP_CMP_SEQ(segment->seqNum, socket->rcvNxt + socket->rcvWnd) < 0)
+      if(TCP_CMP_SEQ(segment->seqNum, socket->tcb->rcvNxt) >= 0 &&
+         TCP_CMP_SEQ(segment->seqNum, socket->tcb->rcvNxt + socket->tcb->rcvWnd) < 0)
       {
          acceptable = TRUE;
       }
-      else if(TCP_CMP_SEQ(segment->seqNum + length - 1, socket->rcvNxt) >= 0 &&
-         TCP_CMP_SEQ(segment->seqNum + length - 1, socket->rcvNxt + socket->rcvWnd) < 0)
+      else if(TCP_CMP_SEQ(segment->seqNum + length - 1, socket->tcb->rcvNxt) >= 0 &&
+         TCP_CMP_SEQ(segment->seqNum + length - 1, socket->tcb->rcvNxt + socket->tcb->rcvWnd) < 0)
       {
          acceptable = TRUE;
       }
@@ -844,7 +1107,7 @@ error_t tcpCheckSeqNum(Socket *socket, const TcpHeader *segment, size_t length)
       //be sent in reply (unless the RST bit is set)
       if((segment->flags & TCP_FLAG_RST) == 0)
       {
-         tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt, socket->rcvNxt,
+         tcpSendSegment(socket, TCP_FLAG_ACK, socket->tcb->sndNxt, socket->tcb->rcvNxt,
             0, FALSE);
       }
 
@@ -852,6 +1115,11 @@ error_t tcpCheckSeqNum(Socket *socket, const TcpHeader *segment, size_t length)
       return ERROR_FAILURE;
    }
 
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   //Record the timestamp of the segment if necessary
+   tcpUpdateTsRecent(socket, segment);
+#endif
+
    //Sequence number is acceptable
    return NO_ERROR;
 }
@@ -899,10 +1167,11 @@ error_t tcpCheckSyn(Socket *socket, const TcpHeader *segment, size_t length)
  * @return NO_ERROR if the acknowledgment is acceptable, ERROR_FAILURE otherwise
  **/
 
-error_t tcpCheckAck(Socket *socket, const TcpHeader *segment, size_t length)
+__net_hot_func error_t tcpCheckAck(Socket *socket, const TcpHeader *segment, size_t length)
 {
    bool_t duplicateFlag;
    bool_t updateFlag;
+   bool_t sackFlag;
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
    uint32_t n;
    uint32_t ownd;
@@ -915,25 +1184,25 @@ error_t tcpCheckAck(Socket *socket, const TcpHeader *segment, size_t length)
 
 #if (TCP_KEEP_ALIVE_SUPPORT == ENABLED)
    //Check whether TCP keep-alive mechanism is enabled
-   if(socket->keepAliveEnabled)
+   if(socket->tcb->keepAliveEnabled)
    {
       //Reset keep-alive probe counter
-      socket->keepAliveProbeCount = 0;
+      socket->tcb->keepAliveProbeCount = 0;
    }
 #endif
 
    //Test the case where SEG.ACK < SND.UNA
-   if(TCP_CMP_SEQ(segment->ackNum, socket->sndUna) < 0)
+   if(TCP_CMP_SEQ(segment->ackNum, socket->tcb->sndUna) < 0)
    {
       //An old duplicate ACK has been received
       return NO_ERROR;
    }
    //Test the case where SEG.ACK > SND.NXT
-   else if(TCP_CMP_SEQ(segment->ackNum, socket->sndNxt) > 0)
+   else if(TCP_CMP_SEQ(segment->ackNum, socket->tcb->sndNxt) > 0)
    {
       //Send an ACK segment indicating the current send sequence number
       //and the acknowledgment number expected to be received
-      tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt, socket->rcvNxt, 0,
+      tcpSendSegment(socket, TCP_FLAG_ACK, socket->tcb->sndNxt, socket->tcb->rcvNxt, 0,
          FALSE);
 
       //The ACK segment acknowledges something not yet sent
@@ -947,24 +1216,34 @@ error_t tcpCheckAck(Socket *socket, const TcpHeader *segment, size_t length)
    //The send window should be updated
    tcpUpdateSendWindow(socket, segment);
 
+   //Record the segments that the receiver holds beyond SND.UNA
+   sackFlag = tcpUpdateSackScoreboard(socket, segment);
+   (void) sackFlag;
+
    //The incoming ACK segment acknowledges new data?
-   if(TCP_CMP_SEQ(segment->ackNum, socket->sndUna) > 0)
+   if(TCP_CMP_SEQ(segment->ackNum, socket->tcb->sndUna) > 0)
    {
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
       //Compute the number of bytes acknowledged by the incoming ACK
-      n = segment->ackNum - socket->sndUna;
+      n = segment->ackNum - socket->tcb->sndUna;
 
       //Check whether the ACK segment acknowledges our SYN
-      if(socket->sndUna == socket->iss)
+      if(socket->tcb->sndUna == socket->tcb->iss)
       {
          n--;
       }
 
       //Total number of bytes acknowledged during the whole round-trip
-      socket->n += n;
+      socket->tcb->n += n;
 #endif
       //Update SND.UNA pointer
-      socket->sndUna = segment->ackNum;
+      socket->tcb->sndUna = segment->ackNum;
+
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+      //Every ACK that acknowledges new data provides an RTT sample when
+      //timestamps are in use (refer to RFC 7323, section 4)
+      tcpMeasureRttTimestamp(socket, segment);
+#endif
 
       //Compute retransmission timeout
       updateFlag = tcpComputeRto(socket);
@@ -976,7 +1255,7 @@ error_t tcpCheckAck(Socket *socket, const TcpHeader *segment, size_t length)
 
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
       //Check congestion state
-      if(socket->congestState == TCP_CONGEST_STATE_RECOVERY)
+      if(socket->tcb->congestState == TCP_CONGEST_STATE_RECOVERY)
       {
          //Invoke fast recovery (refer to RFC 6582)
          tcpFastRecovery(socket, segment, n);
@@ -984,36 +1263,21 @@ error_t tcpCheckAck(Socket *socket, const TcpHeader *segment, size_t length)
       else
       {
          //Reset duplicate ACK counter
-         socket->dupAckCount = 0;
+         socket->tcb->dupAckCount = 0;
 
          //Check congestion state
-         if(socket->congestState == TCP_CONGEST_STATE_LOSS_RECOVERY)
+         if(socket->tcb->congestState == TCP_CONGEST_STATE_LOSS_RECOVERY)
          {
             //Invoke fast loss recovery
             tcpFastLossRecovery(socket, segment);
          }
 
-         //Slow start algorithm is used when cwnd is lower than ssthresh
-         if(socket->cwnd < socket->ssthresh)
-         {
-            //During slow start, TCP increments cwnd by at most SMSS bytes
-            //for each ACK received that cumulatively acknowledges new data
-            socket->cwnd += MIN(n, socket->smss);
-         }
-         //Congestion avoidance algorithm is used when cwnd exceeds ssthres
-         else
-         {
-            //Congestion window is updated once per RTT
-            if(updateFlag)
-            {
-               //TCP must not increment cwnd by more than SMSS bytes
-               socket->cwnd += MIN(socket->n, socket->smss);
-            }
-         }
+         //The congestion control algorithm grows the congestion window
+         socket->tcb->congestAlgo->onAck(socket, n, updateFlag);
       }
 
       //Limit the size of the congestion window
-      socket->cwnd = MIN(socket->cwnd, socket->txBufferSize);
+      socket->tcb->cwnd = MIN(socket->tcb->cwnd, socket->tcb->txBufferSize);
 #endif
    }
    //The incoming ACK segment does not acknowledge new data?
@@ -1024,36 +1288,36 @@ error_t tcpCheckAck(Socket *socket, const TcpHeader *segment, size_t length)
       if(duplicateFlag)
       {
          //Increment duplicate ACK counter
-         socket->dupAckCount++;
+         socket->tcb->dupAckCount++;
          //Debug message
-         TRACE_INFO("TCP duplicate ACK #%u\r\n", socket->dupAckCount);
+         TRACE_INFO("TCP duplicate ACK #%u\r\n", socket->tcb->dupAckCount);
       }
       else
       {
          //Reset duplicate ACK counter
-         socket->dupAckCount = 0;
+         socket->tcb->dupAckCount = 0;
       }
 
       //Check congestion state
-      if(socket->congestState == TCP_CONGEST_STATE_IDLE)
+      if(socket->tcb->congestState == TCP_CONGEST_STATE_IDLE)
       {
          //Use default duplicate ACK threshold
          thresh = TCP_FAST_RETRANSMIT_THRES;
          //Amount of data sent but not yet acknowledged
-         ownd = socket->sndNxt - socket->sndUna;
+         ownd = socket->tcb->sndNxt - socket->tcb->sndUna;
 
          //Test if there is either no unsent data ready for transmission at
          //the sender, or the advertised receive window does not permit new
          //segments to be transmitted (refer to RFC 5827 section 3.1)
-         if(socket->sndUser == 0 || socket->sndWnd <= (socket->sndNxt - socket->sndUna))
+         if(socket->tcb->sndUser == 0 || socket->tcb->sndWnd <= (socket->tcb->sndNxt - socket->tcb->sndUna))
          {
             //Compute the duplicate ACK threshold used to trigger a
             //retransmission
-            if(ownd <= ((uint32_t) socket->smss * 3))
+            if(ownd <= ((uint32_t) socket->tcb->smss * 3))
             {
                thresh = 1;
             }
-            else if(ownd <= ((uint32_t) socket->smss * 4))
+            else if(ownd <= ((uint32_t) socket->tcb->smss * 4))
             {
                thresh = 2;
             }
@@ -1063,11 +1327,11 @@ error_t tcpCheckAck(Socket *socket, const TcpHeader *segment, size_t length)
          }
 
          //Check the number of duplicate ACKs that have been received
-         if(socket->dupAckCount >= thresh)
+         if(socket->tcb->dupAckCount >= thresh)
          {
             //The TCP sender first checks the value of recover to see if the
             //cumulative acknowledgment field covers more than recover
-            if(TCP_CMP_SEQ(segment->ackNum, socket->recover + 1) > 0)
+            if(TCP_CMP_SEQ(segment->ackNum, socket->tcb->recover + 1) > 0)
             {
                //Invoke Fast Retransmit (refer to RFC 6582)
                tcpFastRetransmit(socket);
@@ -1079,7 +1343,7 @@ error_t tcpCheckAck(Socket *socket, const TcpHeader *segment, size_t length)
             }
          }
       }
-      else if(socket->congestState == TCP_CONGEST_STATE_RECOVERY)
+      else if(socket->tcb->congestState == TCP_CONGEST_STATE_RECOVERY)
       {
          //Duplicate ACK received?
          if(duplicateFlag)
@@ -1088,12 +1352,20 @@ error_t tcpCheckAck(Socket *socket, const TcpHeader *segment, size_t length)
             //cwnd must be incremented by SMSS. This artificially inflates
             //the congestion window in order to reflect the additional
             //segment that has left the network
-            socket->cwnd += socket->smss;
+            socket->tcb->cwnd += socket->tcb->smss;
          }
+
+#if (TCP_SACK_SUPPORT == ENABLED)
+         //New SACK information may reveal further holes
+         if(socket->tcb->sackPermitted && sackFlag)
+         {
+            tcpSackRetransmit(socket);
+         }
+#endif
       }
 
       //Limit the size of the congestion window
-      socket->cwnd = MIN(socket->cwnd, socket->txBufferSize);
+      socket->tcb->cwnd = MIN(socket->tcb->cwnd, socket->tcb->txBufferSize);
 #endif
    }
 
@@ -1105,6 +1377,127 @@ error_t tcpCheckAck(Socket *socket, const TcpHeader *segment, size_t length)
 }
 
 
+/**
+ * @brief Check whether a socket can accept an incoming TCP segment
+ *
+ * The local endpoint and the remote address are checked. The remote port is
+ * left to the caller, so that sockets in the LISTEN state can be identified
+ *
+ * @param[in] socket Handle referencing the socket
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader TCP pseudo header
+ * @param[in] segment Incoming TCP segment
+ * @return TRUE if the socket matches the segment, else FALSE
+ **/
+
+bool_t tcpMatchSocket(Socket *socket, NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const TcpHeader *segment)
+{
+   //TCP socket found?
+   if(socket->type != SOCKET_TYPE_STREAM)
+      return FALSE;
+
+   //A closed socket takes no segment. Once its connection has moved to the
+   //TIME-WAIT table, it may still hold the 4-tuple until the user releases
+   //it, and must not hide the table entry or a listening socket
+   if(socket->tcb->state == TCP_STATE_CLOSED)
+      return FALSE;
+
+   //Check whether the socket is bound to a particular interface
+   if(socket->interface != NULL && socket->interface != interface)
+      return FALSE;
+
+   //Check destination port number
+   if(socket->localPort == 0 || socket->localPort != ntohs(segment->destPort))
+      return FALSE;
+
+#if (IPV4_SUPPORT == ENABLED)
+   //IPv4 packet received?
+   if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
+   {
+      //Check whether the socket is restricted to IPv6 communications only
+      if((socket->options & SOCKET_OPTION_IPV6_ONLY) != 0)
+         return FALSE;
+
+      //Destination IP address filtering
+      if(socket->localIpAddr.length != 0)
+      {
+         //An IPv4 address is expected
+         if(socket->localIpAddr.length != sizeof(Ipv4Addr))
+            return FALSE;
+
+         //Filter out non-matching addresses
+         if(socket->localIpAddr.ipv4Addr != IPV4_UNSPECIFIED_ADDR &&
+            socket->localIpAddr.ipv4Addr != pseudoHeader->ipv4Data.destAddr)
+         {
+            return FALSE;
+         }
+      }
+
+      //Source IP address filtering
+      if(socket->remoteIpAddr.length != 0)
+      {
+         //An IPv4 address is expected
+         if(socket->remoteIpAddr.length != sizeof(Ipv4Addr))
+            return FALSE;
+
+         //Filter out non-matching addresses
+         if(socket->remoteIpAddr.ipv4Addr != IPV4_UNSPECIFIED_ADDR &&
+            socket->remoteIpAddr.ipv4Addr != pseudoHeader->ipv4Data.srcAddr)
+         {
+            return FALSE;
+         }
+      }
+   }
+   else
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   //IPv6 packet received?
+   if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
+   {
+      //Destination IP address filtering
+      if(socket->localIpAddr.length != 0)
+      {
+         //An IPv6 address is expected
+         if(socket->localIpAddr.length != sizeof(Ipv6Addr))
+            return FALSE;
+
+         //Filter out non-matching addresses
+         if(!ipv6CompAddr(&socket->localIpAddr.ipv6Addr, &IPV6_UNSPECIFIED_ADDR) &&
+            !ipv6CompAddr(&socket->localIpAddr.ipv6Addr, &pseudoHeader->ipv6Data.destAddr))
+         {
+            return FALSE;
+         }
+      }
+
+      //Source IP address filtering
+      if(socket->remoteIpAddr.length != 0)
+      {
+         //An IPv6 address is expected
+         if(socket->remoteIpAddr.length != sizeof(Ipv6Addr))
+            return FALSE;
+
+         //Filter out non-matching addresses
+         if(!ipv6CompAddr(&socket->remoteIpAddr.ipv6Addr, &IPV6_UNSPECIFIED_ADDR) &&
+            !ipv6CompAddr(&socket->remoteIpAddr.ipv6Addr, &pseudoHeader->ipv6Data.srcAddr))
+         {
+            return FALSE;
+         }
+      }
+   }
+   else
+#endif
+   //Invalid packet received?
+   {
+      //This should never occur...
+      return FALSE;
+   }
+
+   //The socket meets all the criteria
+   return TRUE;
+}
+
+
 /**
  * @brief Test whether the incoming SYN segment is a duplicate
  * @param[in] socket Handle referencing the current socket
@@ -1123,7 +1516,7 @@ bool_t tcpIsDuplicateSyn(Socket *socket, const IpPseudoHeader *pseudoHeader,
    flag = FALSE;
 
    //Point to the very first item
-   queueItem = socket->synQueue;
+   queueItem = socket->tcb->synQueue;
 
    //Loop through the SYN queue
    while(queueItem != NULL)
@@ -1198,7 +1591,7 @@ bool_t tcpIsDuplicateAck(Socket *socket, const TcpHeader *segment,
    flag = FALSE;
 
    //The receiver of the ACK has outstanding data
-   if(socket->retransmitQueue != NULL)
+   if(socket->tcb->retransmitQueue != NULL)
    {
       //The incoming acknowledgment carries no data
       if(length == 0)
@@ -1208,11 +1601,11 @@ bool_t tcpIsDuplicateAck(Socket *socket, const TcpHeader *segment,
          {
             //The acknowledgment number is equal to the greatest acknowledgment
             //received on the given connection
-            if(segment->ackNum == socket->sndUna)
+            if(segment->ackNum == socket->tcb->sndUna)
             {
                //The advertised window in the incoming acknowledgment equals
                //the advertised window in the last incoming acknowledgment
-               if(segment->window == socket->sndWnd)
+               if(segment->window == socket->tcb->sndWnd)
                {
                   //Duplicate ACK
                   flag = TRUE;
@@ -1235,31 +1628,29 @@ bool_t tcpIsDuplicateAck(Socket *socket, const TcpHeader *segment,
 void tcpFastRetransmit(Socket *socket)
 {
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
-   uint32_t flightSize;
-
-   //Amount of data that has been sent but not yet acknowledged
-   flightSize = socket->sndNxt - socket->sndUna;
-   //After receiving 3 duplicate ACKs, ssthresh must be adjusted
-   socket->ssthresh = MAX(flightSize / 2, (uint32_t) socket->smss * 2);
+   //After receiving 3 duplicate ACKs, ssthresh must be adjusted by the
+   //congestion control algorithm
+   socket->tcb->congestAlgo->onLoss(socket);
 
    //The value of recover is incremented to the value of the highest
    //sequence number transmitted by the TCP so far
-   socket->recover = socket->sndNxt - 1;
+   socket->tcb->recover = socket->tcb->sndNxt - 1;
 
    //Debug message
    TRACE_INFO("TCP fast retransmit...\r\n");
 
-   //TCP performs a retransmission of what appears to be the missing segment,
-   //without waiting for the retransmission timer to expire
-   tcpRetransmitSegment(socket);
-
    //cwnd must set to ssthresh plus 3*SMSS. This artificially inflates the
    //congestion window by the number of segments (three) that have left the
    //network and which the receiver has buffered
-   socket->cwnd = socket->ssthresh + (socket->smss * TCP_FAST_RETRANSMIT_THRES);
+   socket->tcb->cwnd = socket->tcb->ssthresh + (socket->tcb->smss * TCP_FAST_RETRANSMIT_THRES);
 
    //Enter the fast recovery procedure
-   socket->congestState = TCP_CONGEST_STATE_RECOVERY;
+   socket->tcb->congestState = TCP_CONGEST_STATE_RECOVERY;
+
+   //TCP performs a retransmission of what appears to be the missing segment,
+   //without waiting for the retransmission timer to expire. When the peer
+   //sends SACK options, every segment known to be lost is retransmitted
+   tcpSackRetransmit(socket);
 #endif
 }
 
@@ -1276,15 +1667,15 @@ void tcpFastRecovery(Socket *socket, const TcpHeader *segment, uint32_t n)
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
    //Check whether this ACK acknowledges all of the data up to and including
    //recover
-   if(TCP_CMP_SEQ(segment->ackNum, socket->recover) > 0)
+   if(TCP_CMP_SEQ(segment->ackNum, socket->tcb->recover) > 0)
    {
       //This is a full acknowledgment
       TRACE_INFO("TCP full acknowledgment\r\n");
 
       //Set cwnd to ssthresh
-      socket->cwnd = socket->ssthresh;
+      socket->tcb->cwnd = socket->tcb->ssthresh;
       //Exit the fast recovery procedure
-      socket->congestState = TCP_CONGEST_STATE_IDLE;
+      socket->tcb->congestState = TCP_CONGEST_STATE_IDLE;
    }
    else
    {
@@ -1292,23 +1683,24 @@ void tcpFastRecovery(Socket *socket, const TcpHeader *segment, uint32_t n)
       //recover, then this is a partial ACK
       TRACE_INFO("TCP partial acknowledgment\r\n");
 
-      //Retransmit the first unacknowledged segment
-      tcpRetransmitSegment(socket);
+      //Retransmit the first unacknowledged segment, along with the holes
+      //reported by the SACK scoreboard
+      tcpSackRetransmit(socket);
 
       //Deflate the congestion window by the amount of new data acknowledged
       //by the cumulative acknowledgment field
-      if(socket->cwnd > n)
-         socket->cwnd -= n;
+      if(socket->tcb->cwnd > n)
+         socket->tcb->cwnd -= n;
 
       //If the partial ACK acknowledges at least one SMSS of new data, then
       //add back SMSS bytes to the congestion window. This artificially
       //inflates the congestion window in order to reflect the additional
       //segment that has left the network
-      if(n >= socket->smss)
-         socket->cwnd += socket->smss;
+      if(n >= socket->tcb->smss)
+         socket->tcb->cwnd += socket->tcb->smss;
 
       //Do not exit the fast recovery procedure...
-      socket->congestState = TCP_CONGEST_STATE_RECOVERY;
+      socket->tcb->congestState = TCP_CONGEST_STATE_RECOVERY;
    }
 #endif
 }
@@ -1325,13 +1717,13 @@ void tcpFastLossRecovery(Socket *socket, const TcpHeader *segment)
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
    //Check whether this ACK acknowledges all of the data up to and
    //including recover
-   if(TCP_CMP_SEQ(segment->ackNum, socket->recover) > 0)
+   if(TCP_CMP_SEQ(segment->ackNum, socket->tcb->recover) > 0)
    {
       //This is a full acknowledgment
       TRACE_INFO("TCP full acknowledgment\r\n");
 
       //Exit the fast loss recovery procedure
-      socket->congestState = TCP_CONGEST_STATE_IDLE;
+      socket->tcb->congestState = TCP_CONGEST_STATE_IDLE;
    }
    else
    {
@@ -1339,64 +1731,353 @@ void tcpFastLossRecovery(Socket *socket, const TcpHeader *segment)
       //recover, then this is a partial ACK
       TRACE_INFO("TCP partial acknowledgment\r\n");
 
-      //Retransmit the first unacknowledged segment
-      tcpRetransmitSegment(socket);
+      //Retransmit the first unacknowledged segment, along with the holes
+      //reported by the SACK scoreboard
+      tcpSackRetransmit(socket);
 
       //Do not exit the fast loss recovery procedure...
-      socket->congestState = TCP_CONGEST_STATE_LOSS_RECOVERY;
+      socket->tcb->congestState = TCP_CONGEST_STATE_LOSS_RECOVERY;
    }
 #endif
 }
 
 
 /**
- * @brief Process the segment text
+ * @brief Update the SACK scoreboard with the blocks of an incoming ACK
  * @param[in] socket Handle referencing the current socket
- * @param[in] segment Pointer to the TCP header
- * @param[in] buffer Multi-part buffer containing the incoming TCP segment
- * @param[in] offset Offset to the first data byte
- * @param[in] length Length of the segment data
+ * @param[in] segment Pointer to the incoming TCP segment
+ * @return TRUE if the ACK selectively acknowledges new data, else FALSE
  **/
 
-void tcpProcessSegmentData(Socket *socket, const TcpHeader *segment,
-   const NetBuffer *buffer, size_t offset, size_t length)
+bool_t tcpUpdateSackScoreboard(Socket *socket, const TcpHeader *segment)
 {
+   bool_t flag;
+#if (TCP_SACK_SUPPORT == ENABLED)
+   uint_t i;
+   uint_t n;
    uint32_t leftEdge;
    uint32_t rightEdge;
+   uint32_t seqNum;
+   const TcpOption *option;
+   TcpQueueItem *queueItem;
+   TcpHeader *header;
+#endif
 
-   //First sequence number occupied by the incoming segment
-   leftEdge = segment->seqNum;
-   //Sequence number immediately following the incoming segment
-   rightEdge = segment->seqNum + length;
+   //Initialize flag
+   flag = FALSE;
 
-   //Check whether some data falls outside the receive window
-   if(TCP_CMP_SEQ(leftEdge, socket->rcvNxt) < 0)
+#if (TCP_SACK_SUPPORT == ENABLED)
+   //The SACK option is only meaningful if both ends agreed to use it
+   if(socket->tcb->sackPermitted)
    {
-      //Position of the first byte to be read
-      offset += socket->rcvNxt - leftEdge;
-      //Ignore the data that falls outside the receive window
-      leftEdge = socket->rcvNxt;
-   }
+      //Get the SACK option
+      option = tcpGetOption(segment, TCP_OPTION_SACK);
 
-   if(TCP_CMP_SEQ(rightEdge, socket->rcvNxt + socket->rcvWnd) > 0)
-   {
-      //Ignore the data that falls outside the receive window
-      rightEdge = socket->rcvNxt + socket->rcvWnd;
-   }
+      //Specified option found?
+      if(option != NULL && option->length >= 10)
+      {
+         //Each block occupies 8 bytes (refer to RFC 2018, section 3)
+         n = (option->length - 2) / 8;
 
-   //Copy the incoming data to the receive buffer
-   tcpWriteRxBuffer(socket, leftEdge, buffer, offset, rightEdge - leftEdge);
+         //Loop through the SACK blocks
+         for(i = 0; i < n; i++)
+         {
+            //Each block reports a contiguous range of received data
+            leftEdge = LOAD32BE(option->value + i * 8);
+            rightEdge = LOAD32BE(option->value + i * 8 + 4);
+
+            //Blocks that do not describe outstanding data are ignored (this
+            //includes D-SACK blocks below SND.UNA)
+            if(TCP_CMP_SEQ(leftEdge, rightEdge) >= 0 ||
+               TCP_CMP_SEQ(leftEdge, socket->tcb->sndUna) < 0 ||
+               TCP_CMP_SEQ(rightEdge, socket->tcb->sndNxt) > 0)
+            {
+               continue;
+            }
 
-   //Update the list of non-contiguous blocks of data that have been received
-   //and queued
-   tcpUpdateSackBlocks(socket, &leftEdge, &rightEdge);
+            //Loop through retransmission queue
+            for(queueItem = socket->tcb->retransmitQueue; queueItem != NULL;
+               queueItem = queueItem->next)
+            {
+               //Point to the TCP header
+               header = (TcpHeader *) queueItem->header;
+               //Sequence number of the first data byte
+               seqNum = ntohl(header->seqNum);
+
+               //Segments are selectively acknowledged as a whole
+               if(!queueItem->sacked && queueItem->length > 0 &&
+                  TCP_CMP_SEQ(seqNum, leftEdge) >= 0 &&
+                  TCP_CMP_SEQ(seqNum + queueItem->length, rightEdge) <= 0)
+               {
+                  //The receiver holds this segment
+                  queueItem->sacked = TRUE;
+                  flag = TRUE;
+               }
+            }
+         }
+      }
+   }
+#endif
 
-   //Check whether the segment was received out of order
-   if(TCP_CMP_SEQ(leftEdge, socket->rcvNxt) > 0)
+   //Return TRUE if the scoreboard has changed
+   return flag;
+}
+
+
+/**
+ * @brief Discard the SACK scoreboard
+ *
+ * After a retransmission timeout, the sender must ignore prior SACK
+ * information, since the receiver is allowed to discard data it has
+ * selectively acknowledged (refer to RFC 2018, section 8)
+ *
+ * @param[in] socket Handle referencing the current socket
+ **/
+
+void tcpClearSackScoreboard(Socket *socket)
+{
+   TcpQueueItem *queueItem;
+
+   //Loop through retransmission queue
+   for(queueItem = socket->tcb->retransmitQueue; queueItem != NULL;
+      queueItem = queueItem->next)
+   {
+      //Reset the state of the segment
+      queueItem->sacked = FALSE;
+      queueItem->retransmitted = FALSE;
+   }
+}
+
+
+/**
+ * @brief SACK based loss recovery
+ *
+ * Only the segments that the scoreboard deems lost are retransmitted, in
+ * sequence order and within the congestion window. The amount of data in
+ * flight is estimated as in RFC 6675 (pipe), the congestion window being
+ * ssthresh during fast recovery
+ *
+ * @param[in] socket Handle referencing the current socket
+ * @return Error code
+ **/
+
+error_t tcpSackRetransmit(Socket *socket)
+{
+   error_t error;
+#if (TCP_SACK_SUPPORT == ENABLED && TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
+   bool_t first;
+   uint32_t cwnd;
+   uint32_t pipe;
+   uint32_t sackedBytes;
+   uint32_t sackedAbove;
+   TcpQueueItem *queueItem;
+
+   //Fall back to NewReno if the peer does not send SACK options
+   if(!socket->tcb->sackPermitted)
+      return tcpRetransmitSegment(socket);
+
+   //Initialize status code
+   error = NO_ERROR;
+
+   //Total number of bytes selectively acknowledged
+   sackedBytes = 0;
+
+   //Loop through retransmission queue
+   for(queueItem = socket->tcb->retransmitQueue; queueItem != NULL;
+      queueItem = queueItem->next)
+   {
+      if(queueItem->sacked)
+         sackedBytes += queueItem->length;
+   }
+
+   //Estimate the number of bytes still in the network. A segment is lost if
+   //the receiver holds at least DupThresh segments beyond it, the first hole
+   //being lost as soon as recovery has started
+   pipe = 0;
+   first = TRUE;
+   sackedAbove = sackedBytes;
+
+   //Loop through retransmission queue
+   for(queueItem = socket->tcb->retransmitQueue; queueItem != NULL;
+      queueItem = queueItem->next)
+   {
+      if(queueItem->sacked)
+      {
+         sackedAbove -= queueItem->length;
+      }
+      else
+      {
+         //Segments not deemed lost are still in flight
+         if(!tcpIsSackLost(socket, first, sackedAbove))
+            pipe += queueItem->length;
+
+         //So are their retransmissions
+         if(queueItem->retransmitted)
+            pipe += queueItem->length;
+
+         first = FALSE;
+      }
+   }
+
+   //The congestion window is ssthresh during fast recovery
+   if(socket->tcb->congestState == TCP_CONGEST_STATE_RECOVERY)
+      cwnd = socket->tcb->ssthresh;
+   else
+      cwnd = socket->tcb->cwnd;
+
+   //Retransmit lost segments in sequence order
+   first = TRUE;
+   sackedAbove = sackedBytes;
+
+   //Loop through retransmission queue
+   for(queueItem = socket->tcb->retransmitQueue; queueItem != NULL;
+      queueItem = queueItem->next)
+   {
+      if(queueItem->sacked)
+      {
+         sackedAbove -= queueItem->length;
+         continue;
+      }
+
+      //Nothing beyond this point is known to be lost
+      if(!tcpIsSackLost(socket, first, sackedAbove))
+         break;
+
+      //Each hole is retransmitted once per recovery episode
+      if(!queueItem->retransmitted)
+      {
+         //The first hole is always repaired, further ones must fit in the
+         //congestion window
+         if(!first && (pipe + queueItem->length) > cwnd)
+            break;
+
+         //Debug message
+         TRACE_INFO("TCP SACK retransmission (%u data bytes)...\r\n",
+            queueItem->length);
+
+         //Retransmit the missing segment
+         error = tcpRetransmitQueueItem(socket, queueItem);
+         //Any error to report?
+         if(error)
+            break;
+
+         //The retransmission is now in flight
+         queueItem->retransmitted = TRUE;
+         pipe += queueItem->length;
+      }
+
+      first = FALSE;
+   }
+#else
+   //Fall back to NewReno
+   error = tcpRetransmitSegment(socket);
+#endif
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Determine whether the SACK scoreboard reports a segment as lost
+ * @param[in] socket Handle referencing the current socket
+ * @param[in] first The segment is the first hole of the scoreboard
+ * @param[in] sackedAbove Number of bytes selectively acknowledged beyond
+ *   the segment
+ * @return TRUE if the segment is deemed lost, else FALSE
+ **/
+
+bool_t tcpIsSackLost(Socket *socket, bool_t first, uint32_t sackedAbove)
+{
+   bool_t flag;
+
+   //The first hole is the segment that triggered the loss recovery
+   if(first)
+   {
+      flag = TRUE;
+   }
+   //Nothing beyond the segment has been received
+   else if(sackedAbove == 0)
+   {
+      flag = FALSE;
+   }
+   //DupThresh segments have been received beyond the segment (refer to
+   //RFC 6675, section 4)
+   else
+   {
+      flag = (sackedAbove >= ((uint32_t) socket->tcb->smss * TCP_FAST_RETRANSMIT_THRES));
+   }
+
+   //Return TRUE if the segment is lost
+   return flag;
+}
+
+
+/**
+ * @brief Process the segment text
+ * @param[in] socket Handle referencing the current socket
+ * @param[in] segment Pointer to the TCP header
+ * @param[in] buffer Multi-part buffer containing the incoming TCP segment
+ * @param[in] offset Offset to the first data byte
+ * @param[in] length Length of the segment data
+ **/
+
+__net_hot_func void tcpProcessSegmentData(Socket *socket, const TcpHeader *segment,
+   const NetBuffer *buffer, size_t offset, size_t length)
+{
+   bool_t gap;
+   uint32_t leftEdge;
+   uint32_t rightEdge;
+
+   //First sequence number occupied by the incoming segment
+   leftEdge = segment->seqNum;
+   //Sequence number immediately following the incoming segment
+   rightEdge = segment->seqNum + length;
+
+   //Check whether some data falls outside the receive window
+   if(TCP_CMP_SEQ(leftEdge, socket->tcb->rcvNxt) < 0)
+   {
+      //Position of the first byte to be read
+      offset += socket->tcb->rcvNxt - leftEdge;
+      //Ignore the data that falls outside the receive window
+      leftEdge = socket->tcb->rcvNxt;
+   }
+
+   if(TCP_CMP_SEQ(rightEdge, socket->tcb->rcvNxt + socket->tcb->rcvWnd) > 0)
+   {
+      //Ignore the data that falls outside the receive window
+      rightEdge = socket->tcb->rcvNxt + socket->tcb->rcvWnd;
+   }
+
+   //Copy the incoming data to the receive buffer
+   tcpWriteRxBuffer(socket, leftEdge, buffer, offset, rightEdge - leftEdge);
+
+   //Check whether out-of-order data is already queued
+   gap = (socket->tcb->oooBlockCount > 0) ? TRUE : FALSE;
+
+   //Record the data in the reassembly queue. The range grows to cover the
+   //queued data it overlaps or abuts
+   if(!tcpUpdateOooBlocks(socket, &leftEdge, &rightEdge))
+   {
+      //The queue is full and the data lies beyond all the queued ranges. It
+      //is not kept and the peer is told what is missing
+      tcpSendSegment(socket, TCP_FLAG_ACK, socket->tcb->sndNxt, socket->tcb->rcvNxt, 0,
+         FALSE);
+      return;
+   }
+
+   //Update the list of non-contiguous blocks of data that have been received
+   //and queued
+   tcpUpdateSackBlocks(socket, &leftEdge, &rightEdge);
+   //Report the ranges that no longer appear in the list
+   tcpCompleteSackBlocks(socket);
+
+   //Check whether the segment was received out of order
+   if(TCP_CMP_SEQ(leftEdge, socket->tcb->rcvNxt) > 0)
    {
       //Out of order data segments should be acknowledged immediately, in order
       //to accelerate loss recovery
-      tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt, socket->rcvNxt, 0,
+      tcpSendSegment(socket, TCP_FLAG_ACK, socket->tcb->sndNxt, socket->tcb->rcvNxt, 0,
          FALSE);
    }
    else
@@ -1405,15 +2086,18 @@ void tcpProcessSegmentData(Socket *socket, const TcpHeader *segment,
       length = rightEdge - leftEdge;
 
       //Next sequence number expected on incoming segments
-      socket->rcvNxt += length;
+      socket->tcb->rcvNxt += length;
       //Number of data available in the receive buffer
-      socket->rcvUser += length;
+      socket->tcb->rcvUser += length;
       //Update the receive window
-      socket->rcvWnd -= length;
+      socket->tcb->rcvWnd -= length;
 
-      //Acknowledge the received data (delayed ACK not supported)
-      tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt, socket->rcvNxt, 0,
-         FALSE);
+      //Data delivered to the socket (latency instrumentation)
+      NET_LATENCY_MARK(NET_LATENCY_POINT_SOCKET);
+
+      //Acknowledge the received data. A segment that fills in all or part
+      //of a gap in the sequence space is acknowledged immediately
+      tcpDelayAck(socket, length, gap);
 
       //Notify user task that data is available
       tcpUpdateEvents(socket);
@@ -1421,6 +2105,287 @@ void tcpProcessSegmentData(Socket *socket, const TcpHeader *segment,
 }
 
 
+/**
+ * @brief Acknowledge in-order data, possibly after a delay
+ *
+ * The ACK is held until outgoing data can carry it, the delayed ACK timer
+ * expires, or TCP_DELAYED_ACK_SEGMENTS full-sized segments have been received
+ *
+ * @param[in] socket Handle referencing the current socket
+ * @param[in] length Number of bytes that have been received
+ * @param[in] immediate The ACK must not be delayed
+ **/
+
+void tcpDelayAck(Socket *socket, uint32_t length, bool_t immediate)
+{
+#if (TCP_DELAYED_ACK_SUPPORT == ENABLED)
+   uint32_t threshold;
+
+   //Number of bytes received but not yet acknowledged
+   socket->tcb->delayedAckBytes += length;
+
+   //An ACK should be generated for at least every second full-sized segment
+   //(refer to RFC 5681, section 4.2)
+   threshold = MIN(socket->tcb->rmss, socket->tcb->smss) * TCP_DELAYED_ACK_SEGMENTS;
+
+   //Check whether the ACK can be delayed
+   if(immediate || socket->tcb->quickAck || TCP_DELAYED_ACK_TIMEOUT == 0 ||
+      socket->tcb->delayedAckBytes >= threshold)
+   {
+      //Acknowledge the received data
+      tcpSendSegment(socket, TCP_FLAG_ACK, socket->tcb->sndNxt, socket->tcb->rcvNxt, 0,
+         FALSE);
+   }
+   else if(!netTimerRunning(&socket->tcb->delayedAckTimer))
+   {
+      //Start the delayed ACK timer
+      tcpStartTimer(socket, &socket->tcb->delayedAckTimer, TCP_DELAYED_ACK_TIMEOUT);
+   }
+#else
+   //Acknowledge the received data (delayed ACK not supported)
+   tcpSendSegment(socket, TCP_FLAG_ACK, socket->tcb->sndNxt, socket->tcb->rcvNxt, 0,
+      FALSE);
+#endif
+}
+
+
+/**
+ * @brief Allocate the TX or RX buffer of a socket
+ *
+ * Sockets operating in large buffer mode draw their buffers from a dedicated
+ * pool of large blocks. The regular memory pool is used otherwise, or when
+ * the large buffer pool is exhausted and the requested size allows it
+ *
+ * @param[in] socket Handle referencing the socket
+ * @param[in] buffer Multi-part buffer to allocate
+ * @param[in] size Size of the buffer, in bytes
+ * @return Error code
+ **/
+
+error_t tcpAllocBuffer(Socket *socket, NetBuffer *buffer, size_t size)
+{
+#if (TCP_LARGE_BUFFER_SUPPORT == ENABLED)
+   uint_t i;
+   uint_t n;
+   uint32_t blocks;
+   ChunkDesc *chunk;
+
+   //Large buffer mode?
+   if(socket->tcb->largeBuffers && buffer->chunkCount == 0)
+   {
+      //Number of blocks needed to hold the buffer
+      n = (size + TCP_LARGE_BUFFER_BLOCK_SIZE - 1) / TCP_LARGE_BUFFER_BLOCK_SIZE;
+
+      //Search the allocation table for free blocks
+      for(blocks = 0, i = 0; i < TCP_LARGE_BUFFER_BLOCK_COUNT && n > 0; i++)
+      {
+         if((tcpLargeBufferMap & (1U << i)) == 0)
+         {
+            blocks |= 1U << i;
+            n--;
+         }
+      }
+
+      //Enough free blocks?
+      if(n == 0 && blocks != 0 && size > 0)
+      {
+         //Reserve the blocks
+         tcpLargeBufferMap |= blocks;
+
+         //Each block makes up a chunk of the buffer
+         for(i = 0; i < TCP_LARGE_BUFFER_BLOCK_COUNT && size > 0; i++)
+         {
+            if((blocks & (1U << i)) != 0)
+            {
+               //Point to the next chunk descriptor
+               chunk = &buffer->chunk[buffer->chunkCount++];
+
+               //A size of zero keeps the block out of the regular memory pool
+               chunk->address = tcpLargeBufferPool[i];
+               chunk->length = MIN(size, TCP_LARGE_BUFFER_BLOCK_SIZE);
+               chunk->size = 0;
+
+               //Remaining bytes to allocate
+               size -= chunk->length;
+            }
+         }
+
+         //Successful processing
+         return NO_ERROR;
+      }
+
+      //The large buffer pool cannot serve the request
+      if(size > buffer->maxChunkCount * NET_MEM_POOL_BUFFER_SIZE)
+         return ERROR_OUT_OF_MEMORY;
+   }
+#endif
+
+   //Allocate the buffer from the regular memory pool
+   return netBufferSetLength(buffer, size);
+}
+
+
+#if (TCP_LARGE_BUFFER_SUPPORT == ENABLED && TCP_LARGE_BUFFER_LOAN == ENABLED)
+
+/**
+ * @brief Return a block to the large buffer pool
+ * @param[in] p Pointer to the block
+ **/
+
+static void tcpReleaseLargeBlock(void *p)
+{
+   uint_t i;
+
+   //Index of the block
+   i = ((uint8_t *) p - (uint8_t *) tcpLargeBufferPool) /
+      TCP_LARGE_BUFFER_BLOCK_SIZE;
+
+   //Return the block to the pool
+   tcpLargeBufferMap &= ~(1U << i);
+}
+
+#endif
+
+
+/**
+ * @brief Initialize the large buffer pool
+ * @return Error code
+ **/
+
+error_t tcpInitLargeBuffers(void)
+{
+   error_t error;
+
+   //Initialize status code
+   error = NO_ERROR;
+
+#if (TCP_LARGE_BUFFER_SUPPORT == ENABLED)
+   //All the blocks are free
+   tcpLargeBufferMap = 0;
+
+#if (TCP_LARGE_BUFFER_LOAN == ENABLED)
+   //Freed blocks are handed to tcpReleaseLargeBlock by the memory pool
+   error = memPoolRegisterLoanRegion(tcpLargeBufferPool,
+      sizeof(tcpLargeBufferPool), tcpReleaseLargeBlock);
+#endif
+#endif
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Release the TX or RX buffer of a socket
+ *
+ * The payload of the segments sent by the socket references the send buffer.
+ * The chunks still read by the DMA are only freed once the transmission of
+ * the segments completes
+ *
+ * @param[in] socket Handle referencing the socket
+ * @param[in] buffer Multi-part buffer to release
+ **/
+
+void tcpFreeBuffer(Socket *socket, NetBuffer *buffer)
+{
+#if (TCP_LARGE_BUFFER_SUPPORT == ENABLED)
+   uint_t i;
+   uint_t j;
+
+   //Loop through data chunks
+   for(i = 0; i < buffer->chunkCount; i++)
+   {
+      //Search the large buffer pool for the block backing the chunk
+      for(j = 0; j < TCP_LARGE_BUFFER_BLOCK_COUNT; j++)
+      {
+         if(buffer->chunk[i].address == tcpLargeBufferPool[j])
+         {
+#if (TCP_LARGE_BUFFER_LOAN == ENABLED)
+            //The block now belongs to the chunk, and returns to the pool
+            //when the chunk is freed
+            buffer->chunk[i].size = MAX(buffer->chunk[i].length, 1);
+#else
+            //Return the block to the pool
+            tcpLargeBufferMap &= ~(1U << j);
+#endif
+            break;
+         }
+      }
+   }
+#endif
+
+   //Release the chunks, sparing those still read by the DMA
+   netBufferReleaseChunks(buffer);
+}
+
+
+/**
+ * @brief Check whether window scaling may be negotiated for a connection
+ * @param[in] socket Handle referencing the socket
+ * @return TRUE if the Window Scale option is to be used, else FALSE
+ **/
+
+bool_t tcpIsWindowScaleEnabled(Socket *socket)
+{
+#if (TCP_WINDOW_SCALE_SUPPORT == ENABLED && TCP_LARGE_BUFFER_SUPPORT == ENABLED)
+   //Only sockets operating in large buffer mode can advertise a receive
+   //window wider than 64 KB, so that the option is kept off for the others
+   return socket->tcb->largeBuffers;
+#elif (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
+   //Window scaling is used for all connections
+   return TRUE;
+#else
+   //Window scaling is not supported
+   return FALSE;
+#endif
+}
+
+
+/**
+ * @brief Find a free entry in the TCP control block table
+ * @return Pointer to the TCP control block, or NULL if the table is full
+ **/
+
+TcpControlBlock *tcpGetFreeControlBlock(void)
+{
+   uint_t i;
+
+   //Loop through TCP control blocks
+   for(i = 0; i < SOCKET_MAX_TCP_COUNT; i++)
+   {
+      //Unused entry found?
+      if(!tcpControlBlockTable[i].used)
+      {
+         return &tcpControlBlockTable[i];
+      }
+   }
+
+   //The table runs out of space
+   return NULL;
+}
+
+
+/**
+ * @brief Return the TCP control block of a socket to the table
+ *
+ * The socket keeps pointing to the entry until it is allocated again, so
+ * that the processing of the current segment or timer may still read the
+ * state of the connection after the socket has been marked as closed
+ *
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpReleaseControlBlock(Socket *socket)
+{
+   //Any TCP control block attached to the socket?
+   if(socket->tcb != NULL)
+   {
+      //The entry can be reused by another TCP socket
+      socket->tcb->used = FALSE;
+   }
+}
+
+
 /**
  * @brief Delete TCB structure
  * @param[in] socket Handle referencing the socket
@@ -1428,17 +2393,67 @@ void tcpProcessSegmentData(Socket *socket, const TcpHeader *segment,
 
 void tcpDeleteControlBlock(Socket *socket)
 {
+   //Remove the socket from the timer wheel
+   tcpCancelTimers(socket);
+
+#if (NET_SHAPER_SUPPORT == ENABLED || TCP_PACING_SUPPORT == ENABLED)
+   //Remove the socket from the list of paced sockets
+   tcpCancelPaceTimer(socket);
+#endif
+
    //Delete retransmission queue
    tcpFlushRetransmitQueue(socket);
 
    //Delete SYN queue
    tcpFlushSynQueue(socket);
 
+#if (TCP_AUTO_TUNE_SUPPORT == ENABLED)
+   //Give auto-tuned memory back to the shared budget
+   tcpAutoTuneRelease(socket);
+#endif
+
    //Release transmit buffer
-   netBufferSetLength((NetBuffer *) &socket->txBuffer, 0);
+   tcpFreeBuffer(socket, (NetBuffer *) &socket->tcb->txBuffer);
 
    //Release receive buffer
-   netBufferSetLength((NetBuffer *) &socket->rxBuffer, 0);
+   tcpFreeBuffer(socket, (NetBuffer *) &socket->tcb->rxBuffer);
+}
+
+
+/**
+ * @brief Enter the TIME-WAIT state once the connection has been closed
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpEnterTimeWait(Socket *socket)
+{
+   //Release previously allocated resources
+   tcpDeleteControlBlock(socket);
+
+#if (TCP_TIME_WAIT_TABLE_SIZE > 0)
+   //Switch to the TIME-WAIT state
+   tcpChangeState(socket, TCP_STATE_TIME_WAIT);
+
+   //The connection is tracked by the TIME-WAIT table for the 2MSL period
+   tcpTimeWaitAdd(socket);
+
+   //The socket itself is no longer needed
+   tcpChangeState(socket, TCP_STATE_CLOSED);
+
+   //Dispose the socket if the user does not have the ownership anymore
+   if(!socket->tcb->ownedFlag)
+   {
+      //Release the TCP control block
+      tcpReleaseControlBlock(socket);
+      //Mark the socket as closed
+      socket->type = SOCKET_TYPE_UNUSED;
+   }
+#else
+   //Start the 2MSL timer
+   tcpStartTimer(socket, &socket->tcb->timeWaitTimer, TCP_2MSL_TIMER);
+   //Switch to the TIME-WAIT state
+   tcpChangeState(socket, TCP_STATE_TIME_WAIT);
+#endif
 }
 
 
@@ -1447,7 +2462,7 @@ void tcpDeleteControlBlock(Socket *socket)
  * @param[in] socket Handle referencing the socket
  **/
 
-void tcpUpdateRetransmitQueue(Socket *socket)
+__net_hot_func void tcpUpdateRetransmitQueue(Socket *socket)
 {
    size_t length;
    TcpQueueItem *prevQueueItem;
@@ -1456,7 +2471,7 @@ void tcpUpdateRetransmitQueue(Socket *socket)
 
    //Point to the first item of the retransmission queue
    prevQueueItem = NULL;
-   queueItem = socket->retransmitQueue;
+   queueItem = socket->tcb->retransmitQueue;
 
    //Loop through retransmission queue
    while(queueItem != NULL)
@@ -1480,17 +2495,17 @@ void tcpUpdateRetransmitQueue(Socket *socket)
 
       //If an acknowledgment is received for a segment before its timer
       //expires, the segment is removed from the retransmission queue
-      if(TCP_CMP_SEQ(socket->sndUna, ntohl(header->seqNum) + length) >= 0)
+      if(TCP_CMP_SEQ(socket->tcb->sndUna, ntohl(header->seqNum) + length) >= 0)
       {
          //First item of the queue?
          if(prevQueueItem == NULL)
          {
             //Remove the current item from the queue
-            socket->retransmitQueue = queueItem->next;
+            socket->tcb->retransmitQueue = queueItem->next;
             //The item can now be safely deleted
             memPoolFree(queueItem);
             //Point to the next item
-            queueItem = socket->retransmitQueue;
+            queueItem = socket->tcb->retransmitQueue;
          }
          else
          {
@@ -1504,9 +2519,9 @@ void tcpUpdateRetransmitQueue(Socket *socket)
 
          //When an ACK is received that acknowledges new data, restart the
          //retransmission timer so that it will expire after RTO seconds
-         netStartTimer(&socket->retransmitTimer, socket->rto);
+         tcpStartTimer(socket, &socket->tcb->retransmitTimer, socket->tcb->rto);
          //Reset retransmission counter
-         socket->retransmitCount = 0;
+         socket->tcb->retransmitCount = 0;
       }
       //No acknowledgment received for the current segment...
       else
@@ -1519,8 +2534,8 @@ void tcpUpdateRetransmitQueue(Socket *socket)
 
    //When all outstanding data has been acknowledged,
    //turn off the retransmission timer
-   if(socket->retransmitQueue == NULL)
-      netStopTimer(&socket->retransmitTimer);
+   if(socket->tcb->retransmitQueue == NULL)
+      netStopTimer(&socket->tcb->retransmitTimer);
 }
 
 
@@ -1532,7 +2547,7 @@ void tcpUpdateRetransmitQueue(Socket *socket)
 void tcpFlushRetransmitQueue(Socket *socket)
 {
    //Point to the first item in the retransmission queue
-   TcpQueueItem *queueItem = socket->retransmitQueue;
+   TcpQueueItem *queueItem = socket->tcb->retransmitQueue;
 
    //Loop through retransmission queue
    while(queueItem != NULL)
@@ -1546,10 +2561,10 @@ void tcpFlushRetransmitQueue(Socket *socket)
    }
 
    //The retransmission queue is now flushed
-   socket->retransmitQueue = NULL;
+   socket->tcb->retransmitQueue = NULL;
 
    //Turn off the retransmission timer
-   netStopTimer(&socket->retransmitTimer);
+   netStopTimer(&socket->tcb->retransmitTimer);
 }
 
 
@@ -1561,7 +2576,7 @@ void tcpFlushRetransmitQueue(Socket *socket)
 void tcpFlushSynQueue(Socket *socket)
 {
    //Point to the first item in the SYN queue
-   TcpSynQueueItem *queueItem = socket->synQueue;
+   TcpSynQueueItem *queueItem = socket->tcb->synQueue;
 
    //Loop through SYN queue
    while(queueItem != NULL)
@@ -1575,7 +2590,7 @@ void tcpFlushSynQueue(Socket *socket)
    }
 
    //SYN queue was successfully flushed
-   socket->synQueue = NULL;
+   socket->tcb->synQueue = NULL;
 }
 
 
@@ -1593,7 +2608,7 @@ void tcpComputeWindowScaleFactor(Socket *socket)
    //The window scale extension expands the definition of the TCP window to
    //30 bits and then uses an implicit scale factor to carry this 30-bit
    //value in the 16-bit window field of the TCP header
-   window = socket->rxBufferSize;
+   window = socket->tcb->rxBufferSize;
 
    //The scale factor is determined by the maximum receive buffer space
    for(n = 0; window > UINT16_MAX; n++)
@@ -1602,7 +2617,7 @@ void tcpComputeWindowScaleFactor(Socket *socket)
    }
 
    //The window scale is fixed in each direction when a connection is opened
-   socket->rcvWndShift = n;
+   socket->tcb->rcvWndShift = n;
 #endif
 }
 
@@ -1619,22 +2634,22 @@ void tcpUpdateSackBlocks(Socket *socket, uint32_t *leftEdge, uint32_t *rightEdge
    uint_t i = 0;
 
    //Loop through the blocks
-   while(i < socket->sackBlockCount)
+   while(i < socket->tcb->sackBlockCount)
    {
       //Find each block that overlaps the specified one
-      if(TCP_CMP_SEQ(*rightEdge, socket->sackBlock[i].leftEdge) >= 0 &&
-         TCP_CMP_SEQ(*leftEdge, socket->sackBlock[i].rightEdge) <= 0)
+      if(TCP_CMP_SEQ(*rightEdge, socket->tcb->sackBlock[i].leftEdge) >= 0 &&
+         TCP_CMP_SEQ(*leftEdge, socket->tcb->sackBlock[i].rightEdge) <= 0)
       {
          //Merge blocks to form a contiguous one
-         *leftEdge = MIN(*leftEdge, socket->sackBlock[i].leftEdge);
-         *rightEdge = MAX(*rightEdge, socket->sackBlock[i].rightEdge);
+         *leftEdge = MIN(*leftEdge, socket->tcb->sackBlock[i].leftEdge);
+         *rightEdge = MAX(*rightEdge, socket->tcb->sackBlock[i].rightEdge);
 
          //Delete current block
-         osMemmove(socket->sackBlock + i, socket->sackBlock + i + 1,
+         osMemmove(socket->tcb->sackBlock + i, socket->tcb->sackBlock + i + 1,
             (TCP_MAX_SACK_BLOCKS - i - 1) * sizeof(TcpSackBlock));
 
          //Decrement the number of non-contiguous blocks
-         socket->sackBlockCount--;
+         socket->tcb->sackBlockCount--;
       }
       else
       {
@@ -1643,21 +2658,199 @@ void tcpUpdateSackBlocks(Socket *socket, uint32_t *leftEdge, uint32_t *rightEdge
       }
    }
 
-   //Check whether the incoming segment was received out of order
-   if(TCP_CMP_SEQ(*leftEdge, socket->rcvNxt) > 0)
+   //Check whether the incoming segment was received out of order
+   if(TCP_CMP_SEQ(*leftEdge, socket->tcb->rcvNxt) > 0)
+   {
+      //Make room for the new non-contiguous block
+      osMemmove(socket->tcb->sackBlock + 1, socket->tcb->sackBlock,
+         (TCP_MAX_SACK_BLOCKS - 1) * sizeof(TcpSackBlock));
+
+      //Insert the element in the list
+      socket->tcb->sackBlock[0].leftEdge = *leftEdge;
+      socket->tcb->sackBlock[0].rightEdge = *rightEdge;
+
+      //Increment the number of non-contiguous blocks
+      if(socket->tcb->sackBlockCount < TCP_MAX_SACK_BLOCKS)
+      {
+         socket->tcb->sackBlockCount++;
+      }
+   }
+}
+
+
+/**
+ * @brief Update the reassembly queue of a connection
+ *
+ * Out-of-order data is written to the receive buffer at its sequence offset.
+ * The reassembly queue only keeps track of the ranges that have been filled,
+ * sorted by sequence number. A segment that fills a hole is merged with all
+ * the data queued behind it, so that the whole range can be delivered at
+ * once without any copy. The receive buffer bounds the queued data, and
+ * TCP_MAX_OOO_BLOCKS bounds the number of ranges
+ *
+ * @param[in] socket Handle referencing the socket
+ * @param[in,out] leftEdge First sequence number occupied by the incoming data
+ * @param[in,out] rightEdge Sequence number immediately following the incoming data
+ * @return TRUE if the data is kept, FALSE if the queue has no room for it
+ **/
+
+bool_t tcpUpdateOooBlocks(Socket *socket, uint32_t *leftEdge, uint32_t *rightEdge)
+{
+   uint_t i;
+   uint_t j;
+   uint_t k;
+   uint_t n;
+   TcpSackBlock *block;
+
+   //Number of ranges in the queue
+   n = socket->tcb->oooBlockCount;
+
+   //Skip the ranges that end before the incoming data
+   for(i = 0; i < n; i++)
+   {
+      if(TCP_CMP_SEQ(socket->tcb->oooBlock[i].rightEdge, *leftEdge) >= 0)
+         break;
+   }
+
+   //Merge the ranges that overlap or abut the incoming data
+   for(j = i; j < n; j++)
+   {
+      //Point to the current range
+      block = &socket->tcb->oooBlock[j];
+
+      //Past the incoming data?
+      if(TCP_CMP_SEQ(block->leftEdge, *rightEdge) > 0)
+         break;
+
+      //Extend the incoming data over the queued range
+      if(TCP_CMP_SEQ(block->leftEdge, *leftEdge) < 0)
+      {
+         *leftEdge = block->leftEdge;
+      }
+
+      if(TCP_CMP_SEQ(block->rightEdge, *rightEdge) > 0)
+      {
+         *rightEdge = block->rightEdge;
+      }
+   }
+
+   //In-order data?
+   if(TCP_CMP_SEQ(*leftEdge, socket->tcb->rcvNxt) <= 0)
+   {
+      //The merged ranges are delivered along with the incoming data
+      osMemmove(socket->tcb->oooBlock, socket->tcb->oooBlock + j,
+         (n - j) * sizeof(TcpSackBlock));
+
+      //Update the number of ranges
+      socket->tcb->oooBlockCount = n - j;
+   }
+   else if(j > i)
+   {
+      //The merged ranges are replaced with a single one
+      socket->tcb->oooBlock[i].leftEdge = *leftEdge;
+      socket->tcb->oooBlock[i].rightEdge = *rightEdge;
+
+      //Delete the other ones
+      osMemmove(socket->tcb->oooBlock + i + 1, socket->tcb->oooBlock + j,
+         (n - j) * sizeof(TcpSackBlock));
+
+      //Update the number of ranges
+      socket->tcb->oooBlockCount = n - (j - i - 1);
+   }
+   else
+   {
+      //A new range is needed
+      if(n >= TCP_MAX_OOO_BLOCKS)
+      {
+         //The data farthest from RCV.NXT is the last to be delivered and
+         //the first to be given up
+         if(i >= n)
+            return FALSE;
+
+         //Point to the last range
+         block = &socket->tcb->oooBlock[n - 1];
+
+         //Stop reporting the data given up (refer to RFC 2018, section 8).
+         //The sender keeps it until it is cumulatively acknowledged
+         for(k = 0; k < socket->tcb->sackBlockCount; )
+         {
+            if(TCP_CMP_SEQ(socket->tcb->sackBlock[k].leftEdge, block->leftEdge) >= 0)
+            {
+               //Delete current block
+               osMemmove(socket->tcb->sackBlock + k, socket->tcb->sackBlock + k + 1,
+                  (TCP_MAX_SACK_BLOCKS - k - 1) * sizeof(TcpSackBlock));
+
+               //Decrement the number of non-contiguous blocks
+               socket->tcb->sackBlockCount--;
+            }
+            else
+            {
+               //Point to the next block
+               k++;
+            }
+         }
+
+         //Drop the last range
+         n--;
+      }
+
+      //Make room for the new range
+      osMemmove(socket->tcb->oooBlock + i + 1, socket->tcb->oooBlock + i,
+         (n - i) * sizeof(TcpSackBlock));
+
+      //Insert the range in the queue
+      socket->tcb->oooBlock[i].leftEdge = *leftEdge;
+      socket->tcb->oooBlock[i].rightEdge = *rightEdge;
+
+      //Update the number of ranges
+      socket->tcb->oooBlockCount = n + 1;
+   }
+
+   //The data is kept
+   return TRUE;
+}
+
+
+/**
+ * @brief Fill the list of SACK blocks with the queued ranges it lacks
+ *
+ * The list holds the most recently received blocks. The reassembly queue may
+ * hold more ranges than the list can report, and the older ones are reported
+ * again as soon as there is room, so that the sender learns about all the
+ * queued data (refer to RFC 2018, section 4)
+ *
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpCompleteSackBlocks(Socket *socket)
+{
+   uint_t i;
+   uint_t k;
+   TcpSackBlock *block;
+
+   //Loop through the queued ranges
+   for(i = 0; i < socket->tcb->oooBlockCount &&
+      socket->tcb->sackBlockCount < TCP_MAX_SACK_BLOCKS; i++)
    {
-      //Make room for the new non-contiguous block
-      osMemmove(socket->sackBlock + 1, socket->sackBlock,
-         (TCP_MAX_SACK_BLOCKS - 1) * sizeof(TcpSackBlock));
+      //Point to the current range
+      block = &socket->tcb->oooBlock[i];
 
-      //Insert the element in the list
-      socket->sackBlock[0].leftEdge = *leftEdge;
-      socket->sackBlock[0].rightEdge = *rightEdge;
+      //Every block of the list falls within a single queued range
+      for(k = 0; k < socket->tcb->sackBlockCount; k++)
+      {
+         if(TCP_CMP_SEQ(socket->tcb->sackBlock[k].leftEdge, block->leftEdge) >= 0 &&
+            TCP_CMP_SEQ(socket->tcb->sackBlock[k].rightEdge, block->rightEdge) <= 0)
+         {
+            break;
+         }
+      }
 
-      //Increment the number of non-contiguous blocks
-      if(socket->sackBlockCount < TCP_MAX_SACK_BLOCKS)
+      //Range not reported yet?
+      if(k >= socket->tcb->sackBlockCount)
       {
-         socket->sackBlockCount++;
+         //Append it to the list
+         socket->tcb->sackBlock[k] = *block;
+         socket->tcb->sackBlockCount++;
       }
    }
 }
@@ -1669,7 +2862,7 @@ void tcpUpdateSackBlocks(Socket *socket, uint32_t *leftEdge, uint32_t *rightEdge
  * @param[in] segment Pointer to the incoming TCP segment
  **/
 
-void tcpUpdateSendWindow(Socket *socket, const TcpHeader *segment)
+__net_hot_func void tcpUpdateSendWindow(Socket *socket, const TcpHeader *segment)
 {
    uint32_t window;
 
@@ -1677,51 +2870,51 @@ void tcpUpdateSendWindow(Socket *socket, const TcpHeader *segment)
    //The window field (SEG.WND) in the header of every incoming segment, with
    //the exception of SYN segments, MUST be left-shifted by Snd.Wind.Shift bits
    //before updating SND.WND (refer to RFC 7323, section 2.3)
-   window = (uint32_t) segment->window << socket->sndWndShift;
+   window = (uint32_t) segment->window << socket->tcb->sndWndShift;
 #else
    //The maximum unscaled window is 2^16 - 1
    window = segment->window;
 #endif
 
    //Case where neither the sequence nor the acknowledgment number is increased
-   if(segment->seqNum == socket->sndWl1 && segment->ackNum == socket->sndWl2)
+   if(segment->seqNum == socket->tcb->sndWl1 && segment->ackNum == socket->tcb->sndWl2)
    {
       //TCP may ignore a window update with a smaller window than previously
       //offered if neither the sequence number nor the acknowledgment number
       //is increased (refer to RFC 1122, section 4.2.2.16)
-      if(window > socket->sndWnd)
+      if(window > socket->tcb->sndWnd)
       {
          //Update the send window and record the sequence number and the
          //acknowledgment number used to update SND.WND
-         socket->sndWnd = window;
-         socket->sndWl1 = segment->seqNum;
-         socket->sndWl2 = segment->ackNum;
+         socket->tcb->sndWnd = window;
+         socket->tcb->sndWl1 = segment->seqNum;
+         socket->tcb->sndWl2 = segment->ackNum;
 
          //Maximum send window it has seen so far on the connection
-         socket->maxSndWnd = MAX(socket->maxSndWnd, window);
+         socket->tcb->maxSndWnd = MAX(socket->tcb->maxSndWnd, window);
       }
    }
    //Case where the sequence or the acknowledgment number is increased
-   else if(TCP_CMP_SEQ(segment->seqNum, socket->sndWl1) >= 0 &&
-      TCP_CMP_SEQ(segment->ackNum, socket->sndWl2) >= 0)
+   else if(TCP_CMP_SEQ(segment->seqNum, socket->tcb->sndWl1) >= 0 &&
+      TCP_CMP_SEQ(segment->ackNum, socket->tcb->sndWl2) >= 0)
    {
       //Check whether the remote host advertises a zero window
-      if(window == 0 && socket->sndWnd != 0)
+      if(window == 0 && socket->tcb->sndWnd != 0)
       {
          //Start the persist timer
-         socket->wndProbeCount = 0;
-         socket->wndProbeInterval = TCP_DEFAULT_PROBE_INTERVAL;
-         netStartTimer(&socket->persistTimer, socket->wndProbeInterval);
+         socket->tcb->wndProbeCount = 0;
+         socket->tcb->wndProbeInterval = TCP_DEFAULT_PROBE_INTERVAL;
+         tcpStartTimer(socket, &socket->tcb->persistTimer, socket->tcb->wndProbeInterval);
       }
 
       //Update the send window and record the sequence number and the
       //acknowledgment number used to update SND.WND
-      socket->sndWnd = window;
-      socket->sndWl1 = segment->seqNum;
-      socket->sndWl2 = segment->ackNum;
+      socket->tcb->sndWnd = window;
+      socket->tcb->sndWl1 = segment->seqNum;
+      socket->tcb->sndWl2 = segment->ackNum;
 
       //Maximum send window it has seen so far on the connection
-      socket->maxSndWnd = MAX(socket->maxSndWnd, window);
+      socket->tcb->maxSndWnd = MAX(socket->tcb->maxSndWnd, window);
    }
    else
    {
@@ -1735,34 +2928,38 @@ void tcpUpdateSendWindow(Socket *socket, const TcpHeader *segment)
  * @param[in] socket Handle referencing the socket
  **/
 
-void tcpUpdateReceiveWindow(Socket *socket)
+__net_hot_func void tcpUpdateReceiveWindow(Socket *socket)
 {
    uint32_t reduction;
+   uint32_t threshold;
 
    //Space available but not yet advertised
-   reduction = socket->rxBufferSize - socket->rcvUser - socket->rcvWnd;
+   reduction = socket->tcb->rxBufferSize - socket->tcb->rcvUser - socket->tcb->rcvWnd;
+   //Smallest window worth advertising
+   threshold = MIN(socket->tcb->rmss, socket->tcb->rxBufferSize / TCP_RX_SWS_DIVISOR);
 
    //To avoid SWS, the receiver should not advertise small windows
-   if((socket->rcvWnd + reduction) >= MIN(socket->rmss, socket->rxBufferSize / 2))
+   if((socket->tcb->rcvWnd + reduction) >= threshold)
    {
-      //Check whether a window update should be sent
-      if(socket->rcvWnd < MIN(socket->rmss, socket->rxBufferSize / 2))
+      //A window update is only sent when the window reopens, so that reads
+      //into an already open window do not generate pure ACKs
+      if(socket->tcb->rcvWnd < threshold)
       {
          //Debug message
          TRACE_INFO("%s: TCP sending window update...\r\n",
             formatSystemTime(osGetSystemTime(), NULL));
 
          //Update the receive window
-         socket->rcvWnd += reduction;
+         socket->tcb->rcvWnd += reduction;
 
          //Send an ACK segment to advertise the new window size
-         tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt, socket->rcvNxt,
+         tcpSendSegment(socket, TCP_FLAG_ACK, socket->tcb->sndNxt, socket->tcb->rcvNxt,
             0, FALSE);
       }
       else
       {
          //The receive window can be updated
-         socket->rcvWnd += reduction;
+         socket->tcb->rcvWnd += reduction;
       }
    }
 }
@@ -1778,55 +2975,31 @@ bool_t tcpComputeRto(Socket *socket)
 {
    bool_t flag;
    systime_t r;
-   systime_t delta;
 
    //Clear flag
    flag = FALSE;
 
    //TCP implementation takes one RTT measurement at a time
-   if(socket->rttBusy)
+   if(socket->tcb->rttBusy)
    {
       //Ensure the incoming ACK number covers the expected sequence number
-      if(TCP_CMP_SEQ(socket->sndUna, socket->rttSeqNum) > 0)
+      if(TCP_CMP_SEQ(socket->tcb->sndUna, socket->tcb->rttSeqNum) > 0)
       {
          //Calculate round-time trip
-         r = osGetSystemTime() - socket->rttStartTime;
+         r = osGetSystemTime() - socket->tcb->rttStartTime;
 
-         //First RTT measurement?
-         if(socket->srtt == 0 && socket->rttvar == 0)
-         {
-            //Initialize RTO calculation algorithm
-            socket->srtt = r;
-            socket->rttvar = r / 2;
-         }
-         else
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+         //When timestamps are in use, the estimator is updated on every ACK
+         //and the measurement only delimits round trips
+         if(!socket->tcb->tsEnabled)
+#endif
          {
-            //Calculate the difference between the measured value and the
-            //current RTT estimator
-            delta = (r > socket->srtt) ? (r - socket->srtt) : (socket->srtt - r);
-
-            //Implement Van Jacobson's algorithm (as specified in RFC 6298 2.3)
-            socket->rttvar = ((socket->rttvar * 3) + delta) / 4;
-            socket->srtt = ((socket->srtt * 7) + r) / 8;
+            //Update the RTO estimator
+            tcpUpdateRto(socket, r);
          }
 
-         //Calculate the next retransmission timeout
-         socket->rto = socket->srtt + (socket->rttvar * 4);
-
-         //Whenever RTO is computed, if it is less than 1 second, then the RTO
-         //should be rounded up to 1 second
-         socket->rto = MAX(socket->rto, TCP_MIN_RTO);
-
-         //A maximum value may be placed on RTO provided it is at least 60
-         //seconds
-         socket->rto = MIN(socket->rto, TCP_MAX_RTO);
-
-         //Debug message
-         TRACE_DEBUG("R=%" PRIu32 ", SRTT=%" PRIu32 ", RTTVAR=%" PRIu32 ", RTO=%" PRIu32 "\r\n",
-            r, socket->srtt, socket->rttvar, socket->rto);
-
          //RTT measurement is complete
-         socket->rttBusy = FALSE;
+         socket->tcb->rttBusy = FALSE;
          //Set flag
          flag = TRUE;
       }
@@ -1837,6 +3010,270 @@ bool_t tcpComputeRto(Socket *socket)
 }
 
 
+/**
+ * @brief Update the RTO estimator with a round-trip time measurement
+ * @param[in] socket Handle referencing the socket
+ * @param[in] r Round-trip time measurement
+ **/
+
+void tcpUpdateRto(Socket *socket, systime_t r)
+{
+   systime_t delta;
+
+   //Keep the raw sample for the congestion control algorithm
+   socket->tcb->rttSample = r;
+
+   //First RTT measurement?
+   if(socket->tcb->srtt == 0 && socket->tcb->rttvar == 0)
+   {
+      //Initialize RTO calculation algorithm
+      socket->tcb->srtt = r;
+      socket->tcb->rttvar = r / 2;
+   }
+   else
+   {
+      //Calculate the difference between the measured value and the
+      //current RTT estimator
+      delta = (r > socket->tcb->srtt) ? (r - socket->tcb->srtt) : (socket->tcb->srtt - r);
+
+      //Implement Van Jacobson's algorithm (as specified in RFC 6298 2.3)
+      socket->tcb->rttvar = ((socket->tcb->rttvar * 3) + delta) / 4;
+      socket->tcb->srtt = ((socket->tcb->srtt * 7) + r) / 8;
+   }
+
+   //Calculate the next retransmission timeout
+   socket->tcb->rto = socket->tcb->srtt + (socket->tcb->rttvar * 4);
+
+   //Whenever RTO is computed, if it is less than 1 second, then the RTO
+   //should be rounded up to 1 second
+   socket->tcb->rto = MAX(socket->tcb->rto, TCP_MIN_RTO);
+
+   //A maximum value may be placed on RTO provided it is at least 60
+   //seconds
+   socket->tcb->rto = MIN(socket->tcb->rto, TCP_MAX_RTO);
+
+   //Debug message
+   TRACE_DEBUG("R=%" PRIu32 ", SRTT=%" PRIu32 ", RTTVAR=%" PRIu32 ", RTO=%" PRIu32 "\r\n",
+      r, socket->tcb->srtt, socket->tcb->rttvar, socket->tcb->rto);
+}
+
+
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+
+/**
+ * @brief Get the current value of the timestamp clock
+ * @param[in] socket Handle referencing the socket
+ * @return Timestamp value (TSval)
+ **/
+
+uint32_t tcpGetTimestamp(Socket *socket)
+{
+   //The clock ticks every millisecond, with a random offset per connection
+   return (uint32_t) osGetSystemTime() + socket->tcb->tsOffset;
+}
+
+
+/**
+ * @brief Append a Timestamps option to the TCP header
+ * @param[in] socket Handle referencing the socket
+ * @param[in] segment Pointer to the TCP header
+ **/
+
+void tcpAddTimestampOption(Socket *socket, TcpHeader *segment)
+{
+   uint32_t value[2];
+
+   //TSval contains the current value of the timestamp clock
+   value[0] = htonl(tcpGetTimestamp(socket));
+
+   //TSecr echoes TS.Recent. It is only valid when the ACK bit is set, and is
+   //set to zero in an initial SYN segment
+   value[1] = socket->tcb->tsEnabled ? htonl(socket->tcb->tsRecent) : 0;
+
+   //Append Timestamps option
+   tcpAddOption(segment, TCP_OPTION_TIMESTAMP, value, sizeof(value));
+}
+
+
+/**
+ * @brief Refresh the Timestamps option of a segment being retransmitted
+ * @param[in] socket Handle referencing the socket
+ * @param[in] segment Pointer to the TCP header
+ **/
+
+void tcpRefreshTimestampOption(Socket *socket, TcpHeader *segment)
+{
+   TcpOption *option;
+
+   //Search the TCP header for the Timestamps option
+   option = (TcpOption *) tcpGetOption(segment, TCP_OPTION_TIMESTAMP);
+
+   //Specified option found?
+   if(option != NULL && option->length == 10)
+   {
+      //The retransmission carries the current time, so that its
+      //acknowledgment gives a valid RTT sample
+      STORE32BE(tcpGetTimestamp(socket), option->value);
+      STORE32BE(socket->tcb->tsEnabled ? socket->tcb->tsRecent : 0, option->value + 4);
+   }
+}
+
+
+/**
+ * @brief Retrieve the Timestamps option of an incoming segment
+ * @param[in] segment Pointer to the TCP header
+ * @param[out] tsVal Timestamp value
+ * @param[out] tsEcr Timestamp echo reply
+ * @return TRUE if the option is present, else FALSE
+ **/
+
+bool_t tcpGetTimestampOption(const TcpHeader *segment, uint32_t *tsVal,
+   uint32_t *tsEcr)
+{
+   const TcpOption *option;
+
+   //Search the TCP header for the Timestamps option
+   option = tcpGetOption(segment, TCP_OPTION_TIMESTAMP);
+
+   //Malformed or missing option?
+   if(option == NULL || option->length != 10)
+      return FALSE;
+
+   //Retrieve TSval and TSecr fields
+   *tsVal = LOAD32BE(option->value);
+   *tsEcr = LOAD32BE(option->value + 4);
+
+   //The option is present
+   return TRUE;
+}
+
+
+/**
+ * @brief Enable timestamps once the option has been negotiated
+ * @param[in] socket Handle referencing the socket
+ * @param[in] tsVal Timestamp value of the SYN segment received
+ **/
+
+void tcpEnableTimestamps(Socket *socket, uint32_t tsVal)
+{
+   //Timestamps are exchanged on this connection
+   socket->tcb->tsEnabled = TRUE;
+
+   //Initialize TS.Recent with the timestamp of the SYN segment
+   socket->tcb->tsRecent = tsVal;
+   socket->tcb->tsRecentTime = osGetSystemTime();
+
+   //The MSS does not account for TCP options, so the room taken by the
+   //option is subtracted from the amount of data per segment
+   socket->tcb->smss = MAX(socket->tcb->smss - TCP_TIMESTAMPS_OPTION_LENGTH,
+      TCP_MIN_MSS);
+}
+
+
+/**
+ * @brief PAWS check of an incoming segment
+ * @param[in] socket Handle referencing the socket
+ * @param[in] segment Incoming TCP segment
+ * @return FALSE if the segment carries an old timestamp and must be
+ *   discarded, else TRUE
+ **/
+
+bool_t tcpCheckPaws(Socket *socket, const TcpHeader *segment)
+{
+   uint32_t tsVal;
+   uint32_t tsEcr;
+
+   //Timestamps not negotiated?
+   if(!socket->tcb->tsEnabled)
+      return TRUE;
+
+   //Segments without the option are accepted (RST segments are never
+   //subject to the PAWS check)
+   if(!tcpGetTimestampOption(segment, &tsVal, &tsEcr) ||
+      (segment->flags & TCP_FLAG_RST) != 0)
+   {
+      return TRUE;
+   }
+
+   //TS.Recent is no longer valid after a long idle period
+   if((osGetSystemTime() - socket->tcb->tsRecentTime) >= TCP_PAWS_IDLE_TIMEOUT)
+      return TRUE;
+
+   //A segment whose timestamp is older than TS.Recent is a duplicate from an
+   //earlier incarnation of the sequence space
+   return (TCP_CMP_SEQ(tsVal, socket->tcb->tsRecent) >= 0) ? TRUE : FALSE;
+}
+
+
+/**
+ * @brief Update TS.Recent from an acceptable segment
+ * @param[in] socket Handle referencing the socket
+ * @param[in] segment Incoming TCP segment
+ **/
+
+void tcpUpdateTsRecent(Socket *socket, const TcpHeader *segment)
+{
+   uint32_t tsVal;
+   uint32_t tsEcr;
+
+   //Timestamps not negotiated?
+   if(!socket->tcb->tsEnabled)
+      return;
+
+   //Retrieve the Timestamps option
+   if(tcpGetTimestampOption(segment, &tsVal, &tsEcr))
+   {
+      //The timestamp is recorded if the segment covers the left edge of the
+      //window, i.e. SEG.SEQ <= Last.ACK.sent (refer to RFC 7323, section 4.3)
+      if(TCP_CMP_SEQ(segment->seqNum, socket->tcb->tsLastAckSent) <= 0)
+      {
+         //Only newer timestamps are recorded, unless TS.Recent has expired
+         if(TCP_CMP_SEQ(tsVal, socket->tcb->tsRecent) >= 0 ||
+            (osGetSystemTime() - socket->tcb->tsRecentTime) >= TCP_PAWS_IDLE_TIMEOUT)
+         {
+            socket->tcb->tsRecent = tsVal;
+            socket->tcb->tsRecentTime = osGetSystemTime();
+         }
+      }
+   }
+}
+
+
+/**
+ * @brief RTT measurement based on the echoed timestamp
+ * @param[in] socket Handle referencing the socket
+ * @param[in] segment Incoming ACK segment that acknowledges new data
+ **/
+
+void tcpMeasureRttTimestamp(Socket *socket, const TcpHeader *segment)
+{
+   uint32_t r;
+   uint32_t tsVal;
+   uint32_t tsEcr;
+
+   //Timestamps not negotiated?
+   if(!socket->tcb->tsEnabled)
+      return;
+
+   //Retrieve the Timestamps option
+   if(tcpGetTimestampOption(segment, &tsVal, &tsEcr))
+   {
+      //TSecr echoes the timestamp of the segment that triggered the ACK,
+      //retransmissions included
+      r = tcpGetTimestamp(socket) - tsEcr;
+
+      //Discard bogus echoes
+      if(r <= TCP_MAX_RTO)
+      {
+         //Update the RTO estimator
+         tcpUpdateRto(socket, r);
+      }
+   }
+}
+
+#endif
+
+
 /**
  * @brief TCP segment retransmission
  * @param[in] socket Handle referencing the socket
@@ -1846,12 +3283,8 @@ bool_t tcpComputeRto(Socket *socket)
 error_t tcpRetransmitSegment(Socket *socket)
 {
    error_t error;
-   size_t offset;
    size_t length;
-   NetBuffer *buffer;
    TcpQueueItem *queueItem;
-   TcpHeader *segment;
-   NetTxAncillary ancillary;
 
    //Initialize error code
    error = NO_ERROR;
@@ -1859,7 +3292,7 @@ error_t tcpRetransmitSegment(Socket *socket)
    length = 0;
 
    //Point to the retransmission queue
-   queueItem = socket->retransmitQueue;
+   queueItem = socket->tcb->retransmitQueue;
 
    //Any segment in the retransmission queue?
    while(queueItem != NULL)
@@ -1868,7 +3301,7 @@ error_t tcpRetransmitSegment(Socket *socket)
       length += queueItem->length;
 
       //The amount of data that can be sent cannot exceed the MSS
-      if(length > socket->smss)
+      if(length > socket->tcb->smss)
       {
          //We are done
          error = NO_ERROR;
@@ -1876,137 +3309,220 @@ error_t tcpRetransmitSegment(Socket *socket)
          break;
       }
 
-      //Allocate a memory buffer to hold the TCP segment
-      buffer = ipAllocBuffer(TCP_MAX_HEADER_LENGTH, &offset);
-      //Failed to allocate memory?
-      if(buffer == NULL)
+      //Retransmit the current segment
+      error = tcpRetransmitQueueItem(socket, queueItem);
+
+      //Any error to report?
+      if(error)
       {
-         //Report an error
-         error = ERROR_OUT_OF_MEMORY;
          //Exit immediately
          break;
       }
 
-      //Start of exception handling block
-      do
-      {
-         //Point to the beginning of the TCP segment
-         segment = netBufferAt(buffer, offset, 0);
+      //Point to the next segment in the queue
+      queueItem = queueItem->next;
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Retransmit a segment of the retransmission queue
+ * @param[in] socket Handle referencing the socket
+ * @param[in] queueItem Segment to be retransmitted
+ * @return Error code
+ **/
+
+error_t tcpRetransmitQueueItem(Socket *socket, TcpQueueItem *queueItem)
+{
+   error_t error;
+   size_t offset;
+   NetBuffer *buffer;
+   TcpHeader *segment;
+   NetTxAncillary ancillary;
+#if (SOCKET_ROUTE_CACHE_SUPPORT == ENABLED)
+   bool_t cached;
+   NetInterface *interface;
+   IpAddr srcIpAddr;
+#endif
+
+   //Allocate a memory buffer to hold the TCP segment
+   buffer = ipAllocBuffer(TCP_MAX_HEADER_LENGTH, &offset);
+   //Failed to allocate memory?
+   if(buffer == NULL)
+      return ERROR_OUT_OF_MEMORY;
 
-         //Copy TCP header
-         osMemcpy(segment, queueItem->header, TCP_MAX_HEADER_LENGTH);
+   //Start of exception handling block
+   do
+   {
+      //Point to the beginning of the TCP segment
+      segment = netBufferAt(buffer, offset, 0);
+
+      //Copy TCP header
+      osMemcpy(segment, queueItem->header, TCP_MAX_HEADER_LENGTH);
 
-         //Update ACK number
-         segment->ackNum = htonl(socket->rcvNxt);
+      //Update ACK number
+      segment->ackNum = htonl(socket->tcb->rcvNxt);
+
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+      //Update the Timestamps option
+      tcpRefreshTimestampOption(socket, segment);
+#endif
 
 #if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
-         //The window field in a segment where the SYN bit is set must not be
-         //scaled (refer to RFC 7323, section 2.2)
-         if((segment->flags & TCP_FLAG_SYN) == 0 &&
-            socket->wndScaleOptionReceived)
-         {
-            //The window field (SEG.WND) of every outgoing segment, with the
-            //exception of SYN segments, must be right-shifted by Rcv.Wind.Shift
-            //bits (refer to RFC 7323, section 2.3)
-            segment->window = htons(socket->rcvWnd >> socket->rcvWndShift);
-         }
-         else
-         {
-            //The maximum unscaled window is 2^16 - 1
-            segment->window = htons(MIN(socket->rcvWnd, UINT16_MAX));
-         }
+      //The window field in a segment where the SYN bit is set must not be
+      //scaled (refer to RFC 7323, section 2.2)
+      if((segment->flags & TCP_FLAG_SYN) == 0 &&
+         socket->tcb->wndScaleOptionReceived)
+      {
+         //The window field (SEG.WND) of every outgoing segment, with the
+         //exception of SYN segments, must be right-shifted by Rcv.Wind.Shift
+         //bits (refer to RFC 7323, section 2.3)
+         segment->window = htons(socket->tcb->rcvWnd >> socket->tcb->rcvWndShift);
+      }
+      else
+      {
+         //The maximum unscaled window is 2^16 - 1
+         segment->window = htons(MIN(socket->tcb->rcvWnd, UINT16_MAX));
+      }
 #else
-         //The window field indicates the number of data octets beginning with
-         //the one indicated in the acknowledgment field that the sender of
-         //this segment is willing to accept (refer to RFC 793, section 3.1)
-         segment->window = htons(MIN(socket->rcvWnd, UINT16_MAX));
+      //The window field indicates the number of data octets beginning with
+      //the one indicated in the acknowledgment field that the sender of
+      //this segment is willing to accept (refer to RFC 793, section 3.1)
+      segment->window = htons(MIN(socket->tcb->rcvWnd, UINT16_MAX));
 #endif
-         //The checksum field is replaced with zeros
-         segment->checksum = 0;
+      //The checksum field is replaced with zeros
+      segment->checksum = 0;
 
-         //Adjust the length of the multi-part buffer
-         netBufferSetLength(buffer, offset + segment->dataOffset * 4);
+      //Adjust the length of the multi-part buffer
+      netBufferSetLength(buffer, offset + segment->dataOffset * 4);
 
-         //Copy data from send buffer
-         error = tcpReadTxBuffer(socket, ntohl(segment->seqNum), buffer,
-            queueItem->length);
-         //Any error to report?
-         if(error)
-            break;
+      //Copy data from send buffer
+      error = tcpReadTxBuffer(socket, ((segment->flags & TCP_FLAG_SYN) != 0) ?
+         ntohl(segment->seqNum) + 1 : ntohl(segment->seqNum), buffer,
+         queueItem->length);
+      //Any error to report?
+      if(error)
+         break;
 
 #if (IPV4_SUPPORT == ENABLED)
-         //Destination address is an IPv4 address?
-         if(queueItem->pseudoHeader.length == sizeof(Ipv4PseudoHeader))
+      //Destination address is an IPv4 address?
+      if(queueItem->pseudoHeader.length == sizeof(Ipv4PseudoHeader))
+      {
+         //The checksum is inserted by the NIC when offload is active
+         if(ipv4IsChecksumOffloadEnabled(socket->interface,
+            segment->dataOffset * 4 + queueItem->length))
          {
-            //Calculate TCP header checksum
-            segment->checksum = ipCalcUpperLayerChecksumEx(
-               &queueItem->pseudoHeader.ipv4Data, sizeof(Ipv4PseudoHeader),
-               buffer, offset, segment->dataOffset * 4 + queueItem->length);
+            segment->checksum = 0;
          }
          else
-#endif
-#if (IPV6_SUPPORT == ENABLED)
-         //Destination address is an IPv6 address?
-         if(queueItem->pseudoHeader.length == sizeof(Ipv6PseudoHeader))
          {
             //Calculate TCP header checksum
             segment->checksum = ipCalcUpperLayerChecksumEx(
-               &queueItem->pseudoHeader.ipv6Data, sizeof(Ipv6PseudoHeader),
+               &queueItem->pseudoHeader.ipv4Data, sizeof(Ipv4PseudoHeader),
                buffer, offset, segment->dataOffset * 4 + queueItem->length);
          }
-         else
+      }
+      else
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+      //Destination address is an IPv6 address?
+      if(queueItem->pseudoHeader.length == sizeof(Ipv6PseudoHeader))
+      {
+         //Calculate TCP header checksum
+         segment->checksum = ipCalcUpperLayerChecksumEx(
+            &queueItem->pseudoHeader.ipv6Data, sizeof(Ipv6PseudoHeader),
+            buffer, offset, segment->dataOffset * 4 + queueItem->length);
+      }
+      else
+#endif
+      //Destination address is not valid?
+      {
+         //This should never occur...
+         error = ERROR_INVALID_ADDRESS;
+         break;
+      }
+
+      //Total number of segments retransmitted
+      MIB2_TCP_INC_COUNTER32(tcpRetransSegs, 1);
+      NET_STATS_INC(tcpRetransSegs, 1);
+      TCP_MIB_INC_COUNTER32(tcpRetransSegs, 1);
+
+      //Segments retransmitted on this connection
+      socket->tcb->retransmitTotal++;
+
+      //Dump TCP header contents for debugging purpose
+      tcpDumpHeader(segment, queueItem->length, socket->tcb->iss, socket->tcb->irs);
+
+      //Additional options can be passed to the stack along with the packet
+      ancillary = NET_DEFAULT_TX_ANCILLARY;
+      //Set the TTL value to be used
+      ancillary.ttl = socket->ttl;
+
+#if (ETH_VLAN_SUPPORT == ENABLED)
+      //Set VLAN PCP and DEI fields
+      ancillary.vlanPcp = socket->vlanPcp;
+      ancillary.vlanDei = socket->vlanDei;
+#endif
+
+#if (ETH_VMAN_SUPPORT == ENABLED)
+      //Set VMAN PCP and DEI fields
+      ancillary.vmanPcp = socket->vmanPcp;
+      ancillary.vmanDei = socket->vmanDei;
 #endif
-         //Destination address is not valid?
-         {
-            //This should never occur...
-            error = ERROR_INVALID_ADDRESS;
-            break;
-         }
 
-         //Total number of segments retransmitted
-         MIB2_TCP_INC_COUNTER32(tcpRetransSegs, 1);
-         TCP_MIB_INC_COUNTER32(tcpRetransSegs, 1);
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+      //The segment is freed as soon as it has been sent
+      ancillary.zeroCopy = TRUE;
+#endif
 
-         //Dump TCP header contents for debugging purpose
-         tcpDumpHeader(segment, queueItem->length, socket->iss, socket->irs);
+#if (SOCKET_ROUTE_CACHE_SUPPORT == ENABLED)
+      //Reuse the next hop of the previous segment, if still valid
+      interface = socket->interface;
+      srcIpAddr = socket->localIpAddr;
+      cached = socketGetCachedRoute(socket, &socket->remoteIpAddr, &interface,
+         &srcIpAddr, &ancillary);
+#endif
 
-         //Additional options can be passed to the stack along with the packet
-         ancillary = NET_DEFAULT_TX_ANCILLARY;
-         //Set the TTL value to be used
-         ancillary.ttl = socket->ttl;
+      //Retransmit the lost segment without waiting for the retransmission
+      //timer to expire
+      error = ipSendDatagram(socket->interface, &queueItem->pseudoHeader,
+         buffer, offset, &ancillary);
 
-#if (ETH_VLAN_SUPPORT == ENABLED)
-         //Set VLAN PCP and DEI fields
-         ancillary.vlanPcp = socket->vlanPcp;
-         ancillary.vlanDei = socket->vlanDei;
+#if (SOCKET_ROUTE_CACHE_SUPPORT == ENABLED)
+      //Save the next hop resolved while sending the segment
+      if(!error && !cached)
+      {
+         socketUpdateCachedRoute(socket, socket->interface,
+            &socket->localIpAddr, &socket->remoteIpAddr, &ancillary);
+      }
 #endif
 
-#if (ETH_VMAN_SUPPORT == ENABLED)
-         //Set VMAN PCP and DEI fields
-         ancillary.vmanPcp = socket->vmanPcp;
-         ancillary.vmanDei = socket->vmanDei;
+#if (TCP_PACING_SUPPORT == ENABLED)
+      //Retransmissions are not delayed, but they are charged, so that the
+      //segments that follow are spaced out
+      if(!error && queueItem->length > 0)
+      {
+         tcpConsumePacingCredit(socket, queueItem->length);
+      }
 #endif
-         //Retransmit the lost segment without waiting for the retransmission
-         //timer to expire
-         error = ipSendDatagram(socket->interface, &queueItem->pseudoHeader,
-            buffer, offset, &ancillary);
 
-         //End of exception handling block
-      } while(0);
-
-      //Free previously allocated memory
-      netBufferFree(buffer);
-
-      //Any error to report?
-      if(error)
+#if (NET_SHAPER_SUPPORT == ENABLED)
+      //Retransmissions are not delayed, but they are charged, so that the
+      //rate limits still hold over time
+      if(!error && queueItem->length > 0)
       {
-         //Exit immediately
-         break;
+         netShaperConsume(socket, socket->tos, queueItem->length);
       }
+#endif
 
-      //Point to the next segment in the queue
-      queueItem = queueItem->next;
-   }
+      //End of exception handling block
+   } while(0);
+
+   //Free previously allocated memory
+   netBufferFree(buffer);
 
    //Return status code
    return error;
@@ -2020,7 +3536,7 @@ error_t tcpRetransmitSegment(Socket *socket)
  * @return Error code
  **/
 
-error_t tcpNagleAlgo(Socket *socket, uint_t flags)
+__net_hot_func error_t tcpNagleAlgo(Socket *socket, uint_t flags)
 {
    error_t error;
    uint32_t n;
@@ -2029,21 +3545,40 @@ error_t tcpNagleAlgo(Socket *socket, uint_t flags)
    //Initialize status code
    error = NO_ERROR;
 
+   //A corked socket only sends full-sized segments until it is uncorked or
+   //the override timer expires
+   if((socket->options & SOCKET_OPTION_TCP_CORK) != 0)
+   {
+      if((flags & SOCKET_FLAG_NO_DELAY) == 0)
+      {
+         flags |= SOCKET_FLAG_DELAY;
+      }
+   }
+   else if((socket->options & SOCKET_OPTION_TCP_NO_DELAY) != 0)
+   {
+      //The TCP_NODELAY option disables the Nagle algorithm, unless the
+      //caller indicated that more data is about to be sent
+      if((flags & SOCKET_FLAG_DELAY) == 0)
+      {
+         flags |= SOCKET_FLAG_NO_DELAY;
+      }
+   }
+
    //The amount of data that can be sent at any given time is limited by the
    //receiver window and the congestion window
-   n = MIN(socket->sndWnd, socket->txBufferSize);
+   n = MIN(socket->tcb->sndWnd, socket->tcb->txBufferSize);
 
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
    //Check the congestion window
-   n = MIN(n, socket->cwnd);
+   n = MIN(n, socket->tcb->cwnd);
 #endif
 
    //Retrieve the size of the usable window
-   u = n - (socket->sndNxt - socket->sndUna);
+   u = n - (socket->tcb->sndNxt - socket->tcb->sndUna);
 
    //The Nagle algorithm discourages sending tiny segments when the data to be
    //sent increases in small increments
-   while(socket->sndUser > 0 && !error)
+   while(socket->tcb->sndUser > 0 && !error)
    {
       //The usable window size may become zero or negative, preventing packet
       //transmission
@@ -2051,8 +3586,22 @@ error_t tcpNagleAlgo(Socket *socket, uint_t flags)
          break;
 
       //Calculate the number of bytes to send at a time
-      n = MIN(u, socket->sndUser);
-      n = MIN(n, socket->smss);
+      n = MIN(u, socket->tcb->sndUser);
+      n = MIN(n, socket->tcb->smss);
+
+#if (NIC_GSO_SUPPORT == ENABLED)
+      //Several full-sized segments may be sent as a single GSO packet
+      if(n == socket->tcb->smss)
+      {
+         n = tcpGetGsoLength(socket, MIN(u, socket->tcb->sndUser));
+      }
+#endif
+
+#if (NET_SHAPER_SUPPORT == ENABLED || TCP_PACING_SUPPORT == ENABLED)
+      //Hold the data back until pacing and the rate limits allow the segment
+      if(n > 0 && tcpPaceSegment(socket, n))
+         break;
+#endif
 
       //Disable Nagle algorithm?
       if((flags & SOCKET_FLAG_NO_DELAY) != 0)
@@ -2062,7 +3611,7 @@ error_t tcpNagleAlgo(Socket *socket, uint_t flags)
          {
             //Send TCP segment
             error = tcpSendSegment(socket, TCP_FLAG_PSH | TCP_FLAG_ACK,
-               socket->sndNxt, socket->rcvNxt, n, TRUE);
+               socket->tcb->sndNxt, socket->tcb->rcvNxt, n, TRUE);
          }
          else
          {
@@ -2073,11 +3622,11 @@ error_t tcpNagleAlgo(Socket *socket, uint_t flags)
       else if((flags & SOCKET_FLAG_DELAY) != 0)
       {
          //Transmit data if a maximum-sized segment can be sent
-         if(MIN(socket->sndUser, u) >= socket->smss)
+         if(MIN(socket->tcb->sndUser, u) >= socket->tcb->smss)
          {
             //Send TCP segment
             error = tcpSendSegment(socket, TCP_FLAG_PSH | TCP_FLAG_ACK,
-               socket->sndNxt, socket->rcvNxt, n, TRUE);
+               socket->tcb->sndNxt, socket->tcb->rcvNxt, n, TRUE);
          }
          else
          {
@@ -2088,25 +3637,25 @@ error_t tcpNagleAlgo(Socket *socket, uint_t flags)
       else
       {
          //Transmit data if a maximum-sized segment can be sent
-         if(MIN(socket->sndUser, u) >= socket->smss)
+         if(MIN(socket->tcb->sndUser, u) >= socket->tcb->smss)
          {
             //Send TCP segment
             error = tcpSendSegment(socket, TCP_FLAG_PSH | TCP_FLAG_ACK,
-               socket->sndNxt, socket->rcvNxt, n, TRUE);
+               socket->tcb->sndNxt, socket->tcb->rcvNxt, n, TRUE);
          }
          //Or if all queued data can be sent now
-         else if(socket->sndNxt == socket->sndUna && socket->sndUser <= u)
+         else if(socket->tcb->sndNxt == socket->tcb->sndUna && socket->tcb->sndUser <= u)
          {
             //Send TCP segment
             error = tcpSendSegment(socket, TCP_FLAG_PSH | TCP_FLAG_ACK,
-               socket->sndNxt, socket->rcvNxt, n, TRUE);
+               socket->tcb->sndNxt, socket->tcb->rcvNxt, n, TRUE);
          }
          //Or if at least a fraction of the maximum window can be sent
-         else if(MIN(socket->sndUser, u) >= (socket->maxSndWnd / 2))
+         else if(MIN(socket->tcb->sndUser, u) >= (socket->tcb->maxSndWnd / 2))
          {
             //Send TCP segment
             error = tcpSendSegment(socket, TCP_FLAG_PSH | TCP_FLAG_ACK,
-               socket->sndNxt, socket->rcvNxt, n, TRUE);
+               socket->tcb->sndNxt, socket->tcb->rcvNxt, n, TRUE);
          }
          else
          {
@@ -2119,9 +3668,9 @@ error_t tcpNagleAlgo(Socket *socket, uint_t flags)
       if(!error)
       {
          //Advance SND.NXT pointer
-         socket->sndNxt += n;
+         socket->tcb->sndNxt += n;
          //Update the number of data buffered but not yet sent
-         socket->sndUser -= n;
+         socket->tcb->sndUser -= n;
          //Update the size of the usable window
          u -= n;
       }
@@ -2135,6 +3684,393 @@ error_t tcpNagleAlgo(Socket *socket, uint_t flags)
 }
 
 
+#if (NIC_GSO_SUPPORT == ENABLED)
+
+/**
+ * @brief Get the amount of data to send as a single GSO packet
+ *
+ * Full-sized segments are gathered into a packet that goes through the
+ * TCP/IP stack once and is split at the NIC. The packet is no longer than the
+ * largest datagram the stack reassembles, which multi-part buffers are sized
+ * for, and is shortened rather than held back by pacing and the rate limits
+ *
+ * @param[in] socket Handle referencing the socket
+ * @param[in] length Number of bytes that may be sent (at least the SMSS)
+ * @return Number of bytes to send, a multiple of the SMSS
+ **/
+
+size_t tcpGetGsoLength(Socket *socket, size_t length)
+{
+   uint_t k;
+
+   //Number of full-sized segments
+   k = length / socket->tcb->smss;
+   k = MIN(k, NIC_GSO_MAX_SEGMENTS);
+   k = MIN(k, (IPV4_MAX_FRAG_DATAGRAM_SIZE - TCP_MAX_HEADER_LENGTH) / socket->tcb->smss);
+
+   //GSO packets are sent over IPv4, to a NIC whose frames can be split
+   if(k < 2 || socket->remoteIpAddr.length != sizeof(Ipv4Addr) ||
+      !nicIsGsoCapable(socket->interface))
+   {
+      return socket->tcb->smss;
+   }
+
+#if (IPV4_SUPPORT == ENABLED)
+   //The loopback interface does not split packets
+   if(ipv4IsLocalHostAddr(socket->remoteIpAddr.ipv4Addr))
+      return socket->tcb->smss;
+#endif
+
+   //Send fewer segments rather than none
+   for(; k > 1; k--)
+   {
+#if (TCP_PACING_SUPPORT == ENABLED)
+      //Not enough pacing credit?
+      if(tcpGetPacingDelay(socket, k * socket->tcb->smss) != 0)
+         continue;
+#endif
+
+#if (NET_SHAPER_SUPPORT == ENABLED)
+      //Not enough tokens?
+      if(netShaperGetDelay(socket, socket->tos, k * socket->tcb->smss) != 0)
+         continue;
+#endif
+
+      //The segments can be sent now
+      break;
+   }
+
+   //Return the length of the packet
+   return k * socket->tcb->smss;
+}
+
+#endif
+
+
+#if (TCP_PACING_SUPPORT == ENABLED)
+
+/**
+ * @brief Get the pacing rate of a connection
+ *
+ * The segments of a congestion window are spread over the smoothed RTT. The
+ * rate is raised by a gain, larger in slow start, so that the pace does not
+ * hold back the growth of the window
+ *
+ * @param[in] socket Handle referencing the socket
+ * @return Rate in bytes per second (0 if the connection is not paced)
+ **/
+
+uint32_t tcpGetPacingRate(Socket *socket)
+{
+   uint_t gain;
+   uint64_t rate;
+
+   //Connections whose round trip is shorter than the resolution of the pace
+   //timer are not paced (no RTT sample yet either)
+   if(socket->tcb->srtt < TCP_PACING_MIN_RTT)
+      return 0;
+
+   //Select the gain that matches the congestion state
+   if(socket->tcb->cwnd < socket->tcb->ssthresh)
+   {
+      gain = TCP_PACING_SS_GAIN;
+   }
+   else
+   {
+      gain = TCP_PACING_CA_GAIN;
+   }
+
+   //Bytes per second, the gain being given in percent
+   rate = ((uint64_t) socket->tcb->cwnd * gain * 10) / socket->tcb->srtt;
+
+   //Return the pacing rate
+   return (uint32_t) MIN(rate, UINT32_MAX);
+}
+
+
+/**
+ * @brief Get the number of bytes that may be sent back-to-back
+ * @param[in] socket Handle referencing the socket
+ * @param[in] rate Pacing rate, in bytes per second
+ * @return Pacing quantum, in bytes
+ **/
+
+static int32_t tcpGetPacingQuantum(Socket *socket, uint32_t rate)
+{
+   uint32_t quantum;
+
+   //The pace timer has a resolution of one millisecond, so the bytes due
+   //within a millisecond are sent together
+   quantum = rate / 1000;
+   quantum = MAX(quantum, TCP_PACING_MIN_QUANTUM * (uint32_t) socket->tcb->smss);
+
+   //Return the pacing quantum
+   return (int32_t) MIN(quantum, (uint32_t) INT32_MAX);
+}
+
+
+/**
+ * @brief Add the pacing credit earned since the last update
+ * @param[in] socket Handle referencing the socket
+ * @param[in] rate Pacing rate, in bytes per second
+ * @param[in] time Current time
+ **/
+
+static void tcpRefillPacingCredit(Socket *socket, uint32_t rate, systime_t time)
+{
+   int32_t quantum;
+   uint64_t credit;
+
+   //Maximum credit
+   quantum = tcpGetPacingQuantum(socket, rate);
+   //Credit earned since the last update
+   credit = ((uint64_t) (time - socket->tcb->paceTime) * rate) / 1000;
+
+   //The credit does not build up while the connection is idle
+   if((int64_t) socket->tcb->paceCredit + (int64_t) credit >= quantum)
+   {
+      socket->tcb->paceCredit = quantum;
+      socket->tcb->paceTime = time;
+   }
+   else if(credit > 0)
+   {
+      socket->tcb->paceCredit += (int32_t) credit;
+      //Only the time matching whole bytes is consumed
+      socket->tcb->paceTime += (systime_t) ((credit * 1000) / rate);
+   }
+   else
+   {
+      //Not a single byte yet
+   }
+}
+
+
+/**
+ * @brief Get the time to wait before a segment can be sent
+ * @param[in] socket Handle referencing the socket
+ * @param[in] length Length of the segment data
+ * @return Delay, in milliseconds (0 if the segment can be sent now)
+ **/
+
+systime_t tcpGetPacingDelay(Socket *socket, size_t length)
+{
+   uint32_t rate;
+   uint64_t deficit;
+
+   //Get the pacing rate
+   rate = tcpGetPacingRate(socket);
+
+   //Connection not paced?
+   if(rate == 0)
+      return 0;
+
+   //Add the credit earned since the last update
+   tcpRefillPacingCredit(socket, rate, osGetSystemTime());
+
+   //Enough credit?
+   if(socket->tcb->paceCredit >= (int32_t) length)
+      return 0;
+
+   //Bytes missing
+   deficit = (uint64_t) ((int64_t) length - socket->tcb->paceCredit);
+
+   //Time needed to earn them, rounded up
+   return (systime_t) ((deficit * 1000 + rate - 1) / rate);
+}
+
+
+/**
+ * @brief Charge a segment to the pacing credit
+ * @param[in] socket Handle referencing the socket
+ * @param[in] length Length of the segment data
+ **/
+
+void tcpConsumePacingCredit(Socket *socket, size_t length)
+{
+   uint32_t rate;
+   int32_t quantum;
+
+   //Get the pacing rate
+   rate = tcpGetPacingRate(socket);
+
+   //Connection not paced?
+   if(rate == 0)
+      return;
+
+   //Bring the credit up to date before charging it
+   tcpRefillPacingCredit(socket, rate, osGetSystemTime());
+   quantum = tcpGetPacingQuantum(socket, rate);
+
+   //The debt left by retransmissions is bounded by the quantum
+   if((int64_t) socket->tcb->paceCredit - (int64_t) length > -(int64_t) quantum)
+   {
+      socket->tcb->paceCredit -= (int32_t) length;
+   }
+   else
+   {
+      socket->tcb->paceCredit = -quantum;
+   }
+}
+
+#endif
+
+
+#if (NET_SHAPER_SUPPORT == ENABLED || TCP_PACING_SUPPORT == ENABLED)
+
+/**
+ * @brief Hold a segment back until pacing and the rate limits allow it
+ *
+ * The segment is sent when the pace timer expires. Pace timers are kept
+ * apart from the timer wheel and expire with a resolution of one
+ * millisecond
+ *
+ * @param[in] socket Handle referencing the socket
+ * @param[in] length Length of the segment data
+ * @return TRUE if the segment must be held back, else FALSE
+ **/
+
+bool_t tcpPaceSegment(Socket *socket, size_t length)
+{
+   systime_t delay;
+#if (NET_SHAPER_SUPPORT == ENABLED)
+   systime_t shaperDelay;
+#endif
+
+#if (TCP_PACING_SUPPORT == ENABLED)
+   //Time before the pacing credit allows the segment
+   delay = tcpGetPacingDelay(socket, length);
+#else
+   //The connection is not paced
+   delay = 0;
+#endif
+
+#if (NET_SHAPER_SUPPORT == ENABLED)
+   //Time before the rate limits allow the segment
+   shaperDelay = netShaperGetDelay(socket, socket->tos, length);
+
+   //The segment is held back by the rate limits?
+   if(shaperDelay > 0 && !netTimerRunning(&socket->tcb->paceTimer))
+   {
+      netShaperCountDelayed(socket, socket->tos, length);
+   }
+
+   //Wait for the longest delay
+   delay = MAX(delay, shaperDelay);
+#endif
+
+   //The segment can be sent now?
+   if(delay == 0)
+      return FALSE;
+
+   //Resume transmission once the delay has elapsed
+   if(!netTimerRunning(&socket->tcb->paceTimer))
+   {
+      tcpStartPaceTimer(socket, delay);
+   }
+
+   //The segment is held back
+   return TRUE;
+}
+
+#endif
+
+
+#if (IPV4_SUPPORT == ENABLED && IPV4_PMTU_SUPPORT == ENABLED)
+
+/**
+ * @brief Limit the segment size to the path MTU of the connection
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpApplyPathMtu(Socket *socket)
+{
+   error_t error;
+   NetInterface *interface;
+   Ipv4Addr srcAddr;
+
+   //IPv4 connection?
+   if(socket->remoteIpAddr.length == sizeof(Ipv4Addr))
+   {
+      //Select the interface used to reach the remote host
+      interface = socket->interface;
+      error = ipv4SelectSourceAddr(&interface, socket->remoteIpAddr.ipv4Addr,
+         &srcAddr);
+
+      //Check status code
+      if(!error)
+      {
+         tcpUpdatePathMtu(socket, ipv4GetPathMtu(interface,
+            socket->remoteIpAddr.ipv4Addr));
+      }
+   }
+}
+
+
+/**
+ * @brief Adjust the SMSS of a connection to a new path MTU
+ * @param[in] socket Handle referencing the socket
+ * @param[in] pathMtu Path MTU to the remote host
+ **/
+
+void tcpUpdatePathMtu(Socket *socket, size_t pathMtu)
+{
+   size_t mss;
+
+   //The MSS excludes the IP and TCP headers (refer to RFC 1191, section 6.3)
+   mss = pathMtu - sizeof(Ipv4Header) - sizeof(TcpHeader);
+
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   //The room taken by the Timestamps option is not available for data
+   if(socket->tcb->tsEnabled)
+   {
+      mss -= TCP_TIMESTAMPS_OPTION_LENGTH;
+   }
+#endif
+
+   //The SMSS can only decrease
+   if(mss < socket->tcb->smss)
+   {
+      //Debug message
+      TRACE_INFO("TCP SMSS lowered to %" PRIuSIZE " bytes (path MTU)\r\n",
+         mss);
+
+      socket->tcb->smss = MAX(mss, TCP_MIN_MSS);
+   }
+}
+
+
+/**
+ * @brief Path MTU to a remote host has decreased
+ * @param[in] remoteIpAddr IP address of the remote host
+ * @param[in] pathMtu New path MTU
+ **/
+
+void tcpProcessPathMtuChange(const IpAddr *remoteIpAddr, size_t pathMtu)
+{
+   uint_t i;
+   Socket *socket;
+
+   //Loop through opened sockets
+   for(i = 0; i < SOCKET_MAX_COUNT; i++)
+   {
+      //Point to the current socket
+      socket = &socketTable[i];
+
+      //Connection to the remote host?
+      if(socket->type == SOCKET_TYPE_STREAM &&
+         socket->tcb->state != TCP_STATE_CLOSED &&
+         socket->tcb->state != TCP_STATE_LISTEN &&
+         ipCompAddr(&socket->remoteIpAddr, remoteIpAddr))
+      {
+         //Subsequent segments must fit the new path MTU
+         tcpUpdatePathMtu(socket, pathMtu);
+      }
+   }
+}
+
+#endif
+
+
 /**
  * @brief Update TCP FSM current state
  * @param[in] socket Handle referencing the socket
@@ -2147,23 +4083,26 @@ void tcpChangeState(Socket *socket, TcpState newState)
    if(newState == TCP_STATE_CLOSED)
    {
       //Check previous state
-      if(socket->state == TCP_STATE_LAST_ACK ||
-         socket->state == TCP_STATE_TIME_WAIT)
+      if(socket->tcb->state == TCP_STATE_LAST_ACK ||
+         socket->tcb->state == TCP_STATE_TIME_WAIT)
       {
          //The connection has been closed properly
-         socket->closedFlag = TRUE;
+         socket->tcb->closedFlag = TRUE;
       }
       else
       {
          //The connection has been reset by the peer
-         socket->resetFlag = TRUE;
+         socket->tcb->resetFlag = TRUE;
       }
    }
 
    //Enter the desired state
-   socket->state = newState;
+   socket->tcb->state = newState;
    //Update TCP related events
    tcpUpdateEvents(socket);
+
+   //The set of running timers depends on the state of the connection
+   tcpScheduleTimers(socket);
 }
 
 
@@ -2174,11 +4113,13 @@ void tcpChangeState(Socket *socket, TcpState newState)
 
 void tcpUpdateEvents(Socket *socket)
 {
+   size_t n;
+
    //Clear event flags
    socket->eventFlags = 0;
 
    //Check current TCP state
-   switch(socket->state)
+   switch(socket->tcb->state)
    {
    //ESTABLISHED or FIN-WAIT-1 state?
    case TCP_STATE_ESTABLISHED:
@@ -2214,36 +4155,47 @@ void tcpUpdateEvents(Socket *socket)
    }
 
    //Handle TX specific events
-   if(socket->state == TCP_STATE_SYN_SENT ||
-      socket->state == TCP_STATE_SYN_RECEIVED)
+   if(socket->tcb->state == TCP_STATE_SYN_SENT ||
+      socket->tcb->state == TCP_STATE_SYN_RECEIVED)
    {
       //Disallow write operations until the connection is established
       socket->eventFlags |= SOCKET_EVENT_TX_DONE;
       socket->eventFlags |= SOCKET_EVENT_TX_ACKED;
+
+#if (TCP_FAST_OPEN_SUPPORT == ENABLED)
+      //The first write of a Fast Open connection sends the SYN segment
+      if(socket->tcb->fastOpenPending)
+      {
+         socket->eventFlags |= SOCKET_EVENT_TX_READY;
+      }
+#endif
    }
-   else if(socket->state == TCP_STATE_ESTABLISHED ||
-      socket->state == TCP_STATE_CLOSE_WAIT)
+   else if(socket->tcb->state == TCP_STATE_ESTABLISHED ||
+      socket->tcb->state == TCP_STATE_CLOSE_WAIT)
    {
-      //Check whether the send buffer is full or not
-      if((socket->sndUser + socket->sndNxt - socket->sndUna) < socket->txBufferSize)
+      //Free space that makes the socket writable
+      n = MIN(MAX(socket->tcb->txLowWatermark, 1), socket->tcb->txBufferSize);
+
+      //Check whether the send buffer has enough room
+      if((socket->tcb->sndUser + socket->tcb->sndNxt - socket->tcb->sndUna + n) <= socket->tcb->txBufferSize)
       {
          socket->eventFlags |= SOCKET_EVENT_TX_READY;
       }
 
       //Check whether all the data in the send buffer has been transmitted
-      if(socket->sndUser == 0)
+      if(socket->tcb->sndUser == 0)
       {
          //All the pending data has been sent out
          socket->eventFlags |= SOCKET_EVENT_TX_DONE;
 
          //Check whether an acknowledgment has been received
-         if(TCP_CMP_SEQ(socket->sndUna, socket->sndNxt) >= 0)
+         if(TCP_CMP_SEQ(socket->tcb->sndUna, socket->tcb->sndNxt) >= 0)
          {
             socket->eventFlags |= SOCKET_EVENT_TX_ACKED;
          }
       }
    }
-   else if(socket->state != TCP_STATE_LISTEN)
+   else if(socket->tcb->state != TCP_STATE_LISTEN)
    {
       //Unblock user task if the connection is being closed
       socket->eventFlags |= SOCKET_EVENT_TX_READY;
@@ -2252,28 +4204,31 @@ void tcpUpdateEvents(Socket *socket)
    }
 
    //Handle RX specific events
-   if(socket->state == TCP_STATE_ESTABLISHED ||
-      socket->state == TCP_STATE_FIN_WAIT_1 ||
-      socket->state == TCP_STATE_FIN_WAIT_2)
+   if(socket->tcb->state == TCP_STATE_ESTABLISHED ||
+      socket->tcb->state == TCP_STATE_FIN_WAIT_1 ||
+      socket->tcb->state == TCP_STATE_FIN_WAIT_2)
    {
-      //Data is available for reading?
-      if(socket->rcvUser > 0)
+      //Buffered data that makes the socket readable
+      n = MIN(MAX(socket->tcb->rxLowWatermark, 1), socket->tcb->rxBufferSize);
+
+      //Enough data available for reading?
+      if(socket->tcb->rcvUser >= n)
       {
          socket->eventFlags |= SOCKET_EVENT_RX_READY;
       }
    }
-   else if(socket->state == TCP_STATE_LISTEN)
+   else if(socket->tcb->state == TCP_STATE_LISTEN)
    {
       //If the socket is currently in the listen state, it will be marked
       //as readable if an incoming connection request has been received
-      if(socket->synQueue != NULL)
+      if(socket->tcb->synQueue != NULL)
       {
          socket->eventFlags |= SOCKET_EVENT_ACCEPT;
          socket->eventFlags |= SOCKET_EVENT_RX_READY;
       }
    }
-   else if(socket->state != TCP_STATE_SYN_SENT &&
-      socket->state != TCP_STATE_SYN_RECEIVED)
+   else if(socket->tcb->state != TCP_STATE_SYN_SENT &&
+      socket->tcb->state != TCP_STATE_SYN_RECEIVED)
    {
       //Readability can also indicate that a request to close
       //the socket has been received from the peer
@@ -2294,6 +4249,11 @@ void tcpUpdateEvents(Socket *socket)
       }
    }
 
+#if (SOCKET_POLL_SUPPORT == ENABLED)
+   //Queue the socket on the ready list of its poll set, if any
+   socketPollUpdate(socket, socket->eventFlags);
+#endif
+
    //Mask unused events
    socket->eventFlags &= socket->eventMask;
 
@@ -2302,6 +4262,7 @@ void tcpUpdateEvents(Socket *socket)
    {
       //Unblock I/O operations currently in waiting state
       osSetEvent(&socket->event);
+      socketNotifyWaiters(socket);
 
       //Set user event to signaled state if necessary
       if(socket->userEvent != NULL)
@@ -2326,27 +4287,41 @@ uint_t tcpWaitForEvents(Socket *socket, uint_t eventMask, systime_t timeout)
    if(socket == NULL)
       return 0;
 
-   //Only one of the events listed here may complete the wait
-   socket->eventMask = eventMask;
+#if (TCP_FAST_OPEN_SUPPORT == ENABLED)
+   //A task waiting for anything but write readiness would never see the
+   //connection complete while the SYN segment is deferred
+   if(socket->tcb->fastOpenPending && (eventMask & SOCKET_EVENT_TX_READY) == 0)
+   {
+      //Send the SYN segment without data
+      tcpFastOpenSendSyn(socket, NULL, 0, NULL);
+   }
+#endif
+
+   //Only one of the events listed here may complete the wait. Those of
+   //the other tasks blocked on the socket, if any, are still needed
+#if (SOCKET_LOCK_SUPPORT == ENABLED)
+   if(socket->waiters != NULL)
+   {
+      socket->eventMask |= eventMask;
+   }
+   else
+#endif
+   {
+      socket->eventMask = eventMask;
+   }
+
    //Update TCP related events
    tcpUpdateEvents(socket);
 
    //No event is signaled?
-   if(socket->eventFlags == 0)
+   if((socket->eventFlags & eventMask) == 0)
    {
-      //Reset the event object
-      osResetEvent(&socket->event);
-
-      //Release exclusive access
-      osReleaseMutex(&netMutex);
       //Wait until an event is triggered
-      osWaitForEvent(&socket->event, timeout);
-      //Get exclusive access
-      osAcquireMutex(&netMutex);
+      socketWaitForEvent(socket, eventMask, timeout);
    }
 
    //Return the list of TCP events that satisfied the wait
-   return socket->eventFlags;
+   return socket->eventFlags & eventMask;
 }
 
 
@@ -2362,25 +4337,26 @@ void tcpWriteTxBuffer(Socket *socket, uint32_t seqNum,
    const uint8_t *data, size_t length)
 {
    //Offset of the first byte to write in the circular buffer
-   size_t offset = (seqNum - socket->iss - 1) % socket->txBufferSize;
+   size_t offset = (seqNum - socket->tcb->iss - 1 - socket->tcb->txBufferOffset) %
+      socket->tcb->txBufferSize;
 
    //Check whether the specified data crosses buffer boundaries
-   if((offset + length) <= socket->txBufferSize)
+   if((offset + length) <= socket->tcb->txBufferSize)
    {
       //Copy the payload
-      netBufferWrite((NetBuffer *) &socket->txBuffer,
+      netBufferCursorWrite(&socket->tcb->txCursor,
          offset, data, length);
    }
    else
    {
       //Copy the first part of the payload
-      netBufferWrite((NetBuffer *) &socket->txBuffer,
-         offset, data, socket->txBufferSize - offset);
+      netBufferCursorWrite(&socket->tcb->txCursor,
+         offset, data, socket->tcb->txBufferSize - offset);
 
       //Wrap around to the beginning of the circular buffer
-      netBufferWrite((NetBuffer *) &socket->txBuffer, 0,
-         data + socket->txBufferSize - offset,
-         length - socket->txBufferSize + offset);
+      netBufferCursorWrite(&socket->tcb->txCursor, 0,
+         data + socket->tcb->txBufferSize - offset,
+         length - socket->tcb->txBufferSize + offset);
    }
 }
 
@@ -2400,27 +4376,28 @@ error_t tcpReadTxBuffer(Socket *socket, uint32_t seqNum,
    error_t error;
 
    //Offset of the first byte to read in the circular buffer
-   size_t offset = (seqNum - socket->iss - 1) % socket->txBufferSize;
+   size_t offset = (seqNum - socket->tcb->iss - 1 - socket->tcb->txBufferOffset) %
+      socket->tcb->txBufferSize;
 
    //Check whether the specified data crosses buffer boundaries
-   if((offset + length) <= socket->txBufferSize)
+   if((offset + length) <= socket->tcb->txBufferSize)
    {
       //Copy the payload
-      error = netBufferConcat(buffer, (NetBuffer *) &socket->txBuffer,
+      error = netBufferCursorConcat(buffer, &socket->tcb->txCursor,
          offset, length);
    }
    else
    {
       //Copy the first part of the payload
-      error = netBufferConcat(buffer, (NetBuffer *) &socket->txBuffer,
-         offset, socket->txBufferSize - offset);
+      error = netBufferCursorConcat(buffer, &socket->tcb->txCursor,
+         offset, socket->tcb->txBufferSize - offset);
 
       //Check status code
       if(!error)
       {
          //Wrap around to the beginning of the circular buffer
-         error = netBufferConcat(buffer, (NetBuffer *) &socket->txBuffer,
-            0, length - socket->txBufferSize + offset);
+         error = netBufferCursorConcat(buffer, &socket->tcb->txCursor,
+            0, length - socket->tcb->txBufferSize + offset);
       }
    }
 
@@ -2442,25 +4419,26 @@ void tcpWriteRxBuffer(Socket *socket, uint32_t seqNum,
    const NetBuffer *data, size_t dataOffset, size_t length)
 {
    //Offset of the first byte to write in the circular buffer
-   size_t offset = (seqNum - socket->irs - 1) % socket->rxBufferSize;
+   size_t offset = (seqNum - socket->tcb->irs - 1 - socket->tcb->rxBufferOffset) %
+      socket->tcb->rxBufferSize;
 
    //Check whether the specified data crosses buffer boundaries
-   if((offset + length) <= socket->rxBufferSize)
+   if((offset + length) <= socket->tcb->rxBufferSize)
    {
       //Copy the payload
-      netBufferCopy((NetBuffer *) &socket->rxBuffer,
+      netBufferCursorCopy(&socket->tcb->rxCursor,
          offset, data, dataOffset, length);
    }
    else
    {
       //Copy the first part of the payload
-      netBufferCopy((NetBuffer *) &socket->rxBuffer,
-         offset, data, dataOffset, socket->rxBufferSize - offset);
+      netBufferCursorCopy(&socket->tcb->rxCursor,
+         offset, data, dataOffset, socket->tcb->rxBufferSize - offset);
 
       //Wrap around to the beginning of the circular buffer
-      netBufferCopy((NetBuffer *) &socket->rxBuffer, 0, data,
-         dataOffset + socket->rxBufferSize - offset,
-         length - socket->rxBufferSize + offset);
+      netBufferCursorCopy(&socket->tcb->rxCursor, 0, data,
+         dataOffset + socket->tcb->rxBufferSize - offset,
+         length - socket->tcb->rxBufferSize + offset);
    }
 }
 
@@ -2477,25 +4455,26 @@ void tcpReadRxBuffer(Socket *socket, uint32_t seqNum, uint8_t *data,
    size_t length)
 {
    //Offset of the first byte to read in the circular buffer
-   size_t offset = (seqNum - socket->irs - 1) % socket->rxBufferSize;
+   size_t offset = (seqNum - socket->tcb->irs - 1 - socket->tcb->rxBufferOffset) %
+      socket->tcb->rxBufferSize;
 
    //Check whether the specified data crosses buffer boundaries
-   if((offset + length) <= socket->rxBufferSize)
+   if((offset + length) <= socket->tcb->rxBufferSize)
    {
       //Copy the payload
-      netBufferRead(data, (NetBuffer *) &socket->rxBuffer,
+      netBufferCursorRead(data, &socket->tcb->rxCursor,
          offset, length);
    }
    else
    {
       //Copy the first part of the payload
-      netBufferRead(data, (NetBuffer *) &socket->rxBuffer,
-         offset, socket->rxBufferSize - offset);
+      netBufferCursorRead(data, &socket->tcb->rxCursor,
+         offset, socket->tcb->rxBufferSize - offset);
 
       //Wrap around to the beginning of the circular buffer
-      netBufferRead(data + socket->rxBufferSize - offset,
-         (NetBuffer *) &socket->rxBuffer, 0,
-         length - socket->rxBufferSize + offset);
+      netBufferCursorRead(data + socket->tcb->rxBufferSize - offset,
+         &socket->tcb->rxCursor, 0,
+         length - socket->tcb->rxBufferSize + offset);
    }
 }
 
@@ -2508,7 +4487,7 @@ void tcpReadRxBuffer(Socket *socket, uint32_t seqNum, uint8_t *data,
  * @param[in] irs Initial receive sequence number (needed to compute relative ACK number)
  **/
 
-void tcpDumpHeader(const TcpHeader *segment, size_t length, uint32_t iss,
+__net_cold_func void tcpDumpHeader(const TcpHeader *segment, size_t length, uint32_t iss,
    uint32_t irs)
 {
    //Dump TCP header contents
@@ -60,6 +60,9 @@ error_t tcpCheckSeqNum(Socket *socket, const TcpHeader *segment, size_t length);
 error_t tcpCheckSyn(Socket *socket, const TcpHeader *segment, size_t length);
 error_t tcpCheckAck(Socket *socket, const TcpHeader *segment, size_t length);
 
+bool_t tcpMatchSocket(Socket *socket, NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const TcpHeader *segment);
+
 bool_t tcpIsDuplicateSyn(Socket *socket, const IpPseudoHeader *pseudoHeader,
    const TcpHeader *segment);
 
@@ -70,10 +73,24 @@ void tcpFastRetransmit(Socket *socket);
 void tcpFastRecovery(Socket *socket, const TcpHeader *segment, uint32_t n);
 void tcpFastLossRecovery(Socket *socket, const TcpHeader *segment);
 
+bool_t tcpUpdateSackScoreboard(Socket *socket, const TcpHeader *segment);
+void tcpClearSackScoreboard(Socket *socket);
+error_t tcpSackRetransmit(Socket *socket);
+bool_t tcpIsSackLost(Socket *socket, bool_t first, uint32_t sackedAbove);
+
 void tcpProcessSegmentData(Socket *socket, const TcpHeader *segment,
    const NetBuffer *buffer, size_t offset, size_t length);
 
+void tcpDelayAck(Socket *socket, uint32_t length, bool_t immediate);
+
+error_t tcpAllocBuffer(Socket *socket, NetBuffer *buffer, size_t size);
+void tcpFreeBuffer(Socket *socket, NetBuffer *buffer);
+error_t tcpInitLargeBuffers(void);
+bool_t tcpIsWindowScaleEnabled(Socket *socket);
+TcpControlBlock *tcpGetFreeControlBlock(void);
+void tcpReleaseControlBlock(Socket *socket);
 void tcpDeleteControlBlock(Socket *socket);
+void tcpEnterTimeWait(Socket *socket);
 
 void tcpUpdateRetransmitQueue(Socket *socket);
 void tcpFlushRetransmitQueue(Socket *socket);
@@ -83,12 +100,39 @@ void tcpFlushSynQueue(Socket *socket);
 void tcpComputeWindowScaleFactor(Socket *socket);
 
 void tcpUpdateSackBlocks(Socket *socket, uint32_t *leftEdge, uint32_t *rightEdge);
+bool_t tcpUpdateOooBlocks(Socket *socket, uint32_t *leftEdge, uint32_t *rightEdge);
+void tcpCompleteSackBlocks(Socket *socket);
 void tcpUpdateSendWindow(Socket *socket, const TcpHeader *segment);
 void tcpUpdateReceiveWindow(Socket *socket);
 
 bool_t tcpComputeRto(Socket *socket);
+void tcpUpdateRto(Socket *socket, systime_t r);
+
+uint32_t tcpGetTimestamp(Socket *socket);
+void tcpAddTimestampOption(Socket *socket, TcpHeader *segment);
+void tcpRefreshTimestampOption(Socket *socket, TcpHeader *segment);
+
+bool_t tcpGetTimestampOption(const TcpHeader *segment, uint32_t *tsVal,
+   uint32_t *tsEcr);
+
+void tcpEnableTimestamps(Socket *socket, uint32_t tsVal);
+bool_t tcpCheckPaws(Socket *socket, const TcpHeader *segment);
+void tcpUpdateTsRecent(Socket *socket, const TcpHeader *segment);
+void tcpMeasureRttTimestamp(Socket *socket, const TcpHeader *segment);
+
 error_t tcpRetransmitSegment(Socket *socket);
+error_t tcpRetransmitQueueItem(Socket *socket, TcpQueueItem *queueItem);
 error_t tcpNagleAlgo(Socket *socket, uint_t flags);
+size_t tcpGetGsoLength(Socket *socket, size_t length);
+
+uint32_t tcpGetPacingRate(Socket *socket);
+systime_t tcpGetPacingDelay(Socket *socket, size_t length);
+void tcpConsumePacingCredit(Socket *socket, size_t length);
+bool_t tcpPaceSegment(Socket *socket, size_t length);
+
+void tcpApplyPathMtu(Socket *socket);
+void tcpUpdatePathMtu(Socket *socket, size_t pathMtu);
+void tcpProcessPathMtuChange(const IpAddr *remoteIpAddr, size_t pathMtu);
 
 void tcpChangeState(Socket *socket, TcpState newState);
 
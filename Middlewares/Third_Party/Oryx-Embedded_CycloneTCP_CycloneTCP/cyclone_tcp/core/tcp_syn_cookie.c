@@ -0,0 +1,575 @@
+/**
+ * @file tcp_syn_cookie.c
+ * @brief SYN cookies
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ *
+ * @section Description
+ *
+ * When the SYN queue of a listening socket is full, the SYN/ACK is sent right
+ * away and no state is kept. The connection parameters are encoded in the
+ * initial sequence number instead (refer to RFC 4987, section 3.6):
+ * - 5 bits: counter incremented every TCP_SYN_COOKIE_PERIOD
+ * - 3 bits: index of the MSS in a table of common values
+ * - 24 bits: keyed hash of the connection identifier, the client ISN and
+ *   the counter
+ *
+ * The final ACK of the handshake echoes the cookie. Once validated, the
+ * connection is queued as an established connection pending acceptance.
+ * Options that do not fit in the cookie (window scaling, SACK, timestamps)
+ * are not used on such connections
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL TCP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/tcp.h"
+#include "core/tcp_misc.h"
+#include "core/tcp_syn_cookie.h"
+#include "core/ip.h"
+#include "ipv4/ipv4.h"
+#include "ipv4/ipv4_misc.h"
+#include "ipv6/ipv6.h"
+#include "mibs/mib2_module.h"
+#include "mibs/tcp_mib_module.h"
+#include "date_time.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (TCP_SUPPORT == ENABLED && TCP_SYN_COOKIE_SUPPORT == ENABLED)
+
+//Rotate a 32-bit word to the left
+#define TCP_SYN_COOKIE_ROL32(a, n) (((a) << (n)) | ((a) >> (32 - (n))))
+
+//HalfSipHash round
+#define TCP_SYN_COOKIE_ROUND(v) \
+{ \
+   v[0] += v[1]; v[1] = TCP_SYN_COOKIE_ROL32(v[1], 5); v[1] ^= v[0]; \
+   v[0] = TCP_SYN_COOKIE_ROL32(v[0], 16); \
+   v[2] += v[3]; v[3] = TCP_SYN_COOKIE_ROL32(v[3], 8); v[3] ^= v[2]; \
+   v[0] += v[3]; v[3] = TCP_SYN_COOKIE_ROL32(v[3], 7); v[3] ^= v[0]; \
+   v[2] += v[1]; v[1] = TCP_SYN_COOKIE_ROL32(v[1], 13); v[1] ^= v[2]; \
+   v[2] = TCP_SYN_COOKIE_ROL32(v[2], 16); \
+}
+
+//MSS values that can be encoded in a cookie
+static const uint16_t tcpSynCookieMssTable[8] =
+{
+   64, 256, 536, 1024, 1220, 1300, 1380, 1460
+};
+
+//Secret key
+static uint32_t tcpSynCookieKey[2];
+static bool_t tcpSynCookieKeyValid = FALSE;
+
+
+/**
+ * @brief Keyed hash of the connection identifier (HalfSipHash-2-4)
+ * @param[in] pseudoHeader TCP pseudo header of the client segment
+ * @param[in] segment Client segment (host byte order)
+ * @param[in] isn Initial sequence number of the client
+ * @param[in] counter Cookie counter value
+ * @return 32-bit hash value
+ **/
+
+static uint32_t tcpSynCookieHash(const IpPseudoHeader *pseudoHeader,
+   const TcpHeader *segment, uint32_t isn, uint32_t counter)
+{
+   uint_t i;
+   uint_t n;
+   uint32_t v[4];
+   uint32_t m[11];
+
+   //The key is generated on first use, once the PRNG has been seeded
+   if(!tcpSynCookieKeyValid)
+   {
+      tcpSynCookieKey[0] = netGenerateRand();
+      tcpSynCookieKey[1] = netGenerateRand();
+      tcpSynCookieKeyValid = TRUE;
+   }
+
+   //Number of input words
+   n = 0;
+
+#if (IPV4_SUPPORT == ENABLED)
+   //IPv4 segment?
+   if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
+   {
+      m[n++] = pseudoHeader->ipv4Data.srcAddr;
+      m[n++] = pseudoHeader->ipv4Data.destAddr;
+   }
+   else
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   //IPv6 segment?
+   if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
+   {
+      for(i = 0; i < 4; i++)
+      {
+         m[n++] = pseudoHeader->ipv6Data.srcAddr.dw[i];
+         m[n++] = pseudoHeader->ipv6Data.destAddr.dw[i];
+      }
+   }
+   else
+#endif
+   //Invalid pseudo header?
+   {
+      //Only the port numbers and sequence numbers are relevant
+   }
+
+   //Port numbers, client ISN and counter
+   m[n++] = ((uint32_t) segment->srcPort << 16) | segment->destPort;
+   m[n++] = isn;
+   m[n++] = counter;
+
+   //Initialization
+   v[0] = tcpSynCookieKey[0];
+   v[1] = tcpSynCookieKey[1];
+   v[2] = 0x6C796765 ^ tcpSynCookieKey[0];
+   v[3] = 0x74656462 ^ tcpSynCookieKey[1];
+
+   //Compression
+   for(i = 0; i < n; i++)
+   {
+      v[3] ^= m[i];
+      TCP_SYN_COOKIE_ROUND(v);
+      TCP_SYN_COOKIE_ROUND(v);
+      v[0] ^= m[i];
+   }
+
+   //The last block holds the message length
+   v[3] ^= (uint32_t) (n * 4) << 24;
+   TCP_SYN_COOKIE_ROUND(v);
+   TCP_SYN_COOKIE_ROUND(v);
+   v[0] ^= (uint32_t) (n * 4) << 24;
+
+   //Finalization
+   v[2] ^= 0xFF;
+   TCP_SYN_COOKIE_ROUND(v);
+   TCP_SYN_COOKIE_ROUND(v);
+   TCP_SYN_COOKIE_ROUND(v);
+   TCP_SYN_COOKIE_ROUND(v);
+
+   //Return the hash value
+   return v[1] ^ v[3];
+}
+
+
+/**
+ * @brief Compute the cookie of a connection request
+ * @param[in] pseudoHeader TCP pseudo header of the client segment
+ * @param[in] segment Client segment (host byte order)
+ * @param[in] isn Initial sequence number of the client
+ * @param[in] counter Cookie counter value
+ * @param[in] mssIndex Index of the MSS in the table
+ * @return Initial sequence number to use in the SYN/ACK
+ **/
+
+static uint32_t tcpSynCookieCompute(const IpPseudoHeader *pseudoHeader,
+   const TcpHeader *segment, uint32_t isn, uint32_t counter, uint_t mssIndex)
+{
+   uint32_t hash;
+
+   //Only the 5 least significant bits of the counter are encoded
+   counter &= 0x1F;
+
+   //Calculate the keyed hash
+   hash = tcpSynCookieHash(pseudoHeader, segment, isn, counter);
+
+   //Format the cookie
+   return (counter << 27) | ((uint32_t) mssIndex << 24) | (hash & 0x00FFFFFF);
+}
+
+
+/**
+ * @brief Send a SYN/ACK carrying a cookie in response to a SYN segment
+ * @param[in] socket Handle referencing the listening socket
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader TCP pseudo header of the incoming SYN
+ * @param[in] segment Incoming SYN segment (host byte order)
+ * @return Error code
+ **/
+
+error_t tcpSendSynCookie(Socket *socket, NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const TcpHeader *segment)
+{
+   error_t error;
+   uint_t i;
+   size_t offset;
+   size_t length;
+   uint16_t mss;
+   uint16_t rmss;
+   uint32_t iss;
+   NetBuffer *buffer;
+   TcpHeader *segment2;
+   const TcpOption *option;
+   IpPseudoHeader pseudoHeader2;
+   NetTxAncillary ancillary;
+
+   //Get the Maximum Segment Size option
+   option = tcpGetOption(segment, TCP_OPTION_MAX_SEGMENT_SIZE);
+
+   //Determine the MSS of the connection, as for a queued request
+   if(option != NULL && option->length == 4)
+   {
+      mss = LOAD16BE(option->value);
+      mss = MIN(mss, socket->tcb->mss);
+      mss = MAX(mss, TCP_MIN_MSS);
+   }
+   else
+   {
+      mss = MIN(socket->tcb->mss, TCP_DEFAULT_MSS);
+   }
+
+   //Select the largest encodable value that does not exceed the MSS
+   for(i = arraysize(tcpSynCookieMssTable) - 1; i > 0; i--)
+   {
+      if(tcpSynCookieMssTable[i] <= mss)
+         break;
+   }
+
+   //Generate the cookie
+   iss = tcpSynCookieCompute(pseudoHeader, segment, segment->seqNum,
+      osGetSystemTime() / TCP_SYN_COOKIE_PERIOD, i);
+
+   //Allocate a memory buffer to hold the SYN/ACK segment
+   buffer = ipAllocBuffer(TCP_MAX_HEADER_LENGTH, &offset);
+   //Failed to allocate memory?
+   if(buffer == NULL)
+      return ERROR_OUT_OF_MEMORY;
+
+   //Point to the beginning of the TCP segment
+   segment2 = netBufferAt(buffer, offset, 0);
+
+   //Format TCP header
+   segment2->srcPort = htons(segment->destPort);
+   segment2->destPort = htons(segment->srcPort);
+   segment2->seqNum = htonl(iss);
+   segment2->ackNum = htonl(segment->seqNum + 1);
+   segment2->reserved1 = 0;
+   segment2->dataOffset = sizeof(TcpHeader) / 4;
+   segment2->flags = TCP_FLAG_SYN | TCP_FLAG_ACK;
+   segment2->reserved2 = 0;
+   segment2->window = htons(MIN(socket->tcb->rxBufferSize, UINT16_MAX));
+   segment2->checksum = 0;
+   segment2->urgentPointer = 0;
+
+   //The RMSS is the size of the largest segment the receiver is willing
+   //to accept
+   rmss = HTONS(MIN(socket->tcb->mss, socket->tcb->rxBufferSize));
+
+   //Append Maximum Segment Size option
+   tcpAddOption(segment2, TCP_OPTION_MAX_SEGMENT_SIZE, &rmss,
+      sizeof(uint16_t));
+
+   //Calculate the length of the TCP segment
+   length = segment2->dataOffset * 4;
+   //Adjust the length of the multi-part buffer
+   netBufferSetLength(buffer, offset + length);
+
+#if (IPV4_SUPPORT == ENABLED)
+   //Destination address is an IPv4 address?
+   if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
+   {
+      //Format IPv4 pseudo header
+      pseudoHeader2.length = sizeof(Ipv4PseudoHeader);
+      pseudoHeader2.ipv4Data.srcAddr = pseudoHeader->ipv4Data.destAddr;
+      pseudoHeader2.ipv4Data.destAddr = pseudoHeader->ipv4Data.srcAddr;
+      pseudoHeader2.ipv4Data.reserved = 0;
+      pseudoHeader2.ipv4Data.protocol = IPV4_PROTOCOL_TCP;
+      pseudoHeader2.ipv4Data.length = htons(length);
+
+      //The checksum is inserted by the NIC when offload is active
+      if(!ipv4IsChecksumOffloadEnabled(interface, length))
+      {
+         //Calculate TCP header checksum
+         segment2->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader2.ipv4Data,
+            sizeof(Ipv4PseudoHeader), buffer, offset, length);
+      }
+   }
+   else
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   //Destination address is an IPv6 address?
+   if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
+   {
+      //Format IPv6 pseudo header
+      pseudoHeader2.length = sizeof(Ipv6PseudoHeader);
+      pseudoHeader2.ipv6Data.srcAddr = pseudoHeader->ipv6Data.destAddr;
+      pseudoHeader2.ipv6Data.destAddr = pseudoHeader->ipv6Data.srcAddr;
+      pseudoHeader2.ipv6Data.length = htonl(length);
+      pseudoHeader2.ipv6Data.reserved[0] = 0;
+      pseudoHeader2.ipv6Data.reserved[1] = 0;
+      pseudoHeader2.ipv6Data.reserved[2] = 0;
+      pseudoHeader2.ipv6Data.nextHeader = IPV6_TCP_HEADER;
+
+      //Calculate TCP header checksum
+      segment2->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader2.ipv6Data,
+         sizeof(Ipv6PseudoHeader), buffer, offset, length);
+   }
+   else
+#endif
+   //Destination address is not valid?
+   {
+      //Free previously allocated memory
+      netBufferFree(buffer);
+      //This should never occur...
+      return ERROR_INVALID_ADDRESS;
+   }
+
+   //Total number of segments sent
+   MIB2_TCP_INC_COUNTER32(tcpOutSegs, 1);
+   NET_STATS_INC(tcpOutSegs, 1);
+   TCP_MIB_INC_COUNTER32(tcpOutSegs, 1);
+   TCP_MIB_INC_COUNTER64(tcpHCOutSegs, 1);
+
+   //Number of SYN/ACK segments carrying a cookie
+   NET_STATS_INC(tcpSynCookiesSent, 1);
+
+   //Debug message
+   TRACE_DEBUG("%s: Sending TCP SYN cookie...\r\n",
+      formatSystemTime(osGetSystemTime(), NULL));
+
+   //Dump TCP header contents for debugging purpose
+   tcpDumpHeader(segment2, 0, iss, 0);
+
+   //Additional options can be passed to the stack along with the packet
+   ancillary = NET_DEFAULT_TX_ANCILLARY;
+   //Set the TTL value to be used
+   ancillary.ttl = socket->ttl;
+   //Set ToS field
+   ancillary.tos = socket->tos;
+
+   //Send TCP segment
+   error = ipSendDatagram(interface, &pseudoHeader2, buffer, offset,
+      &ancillary);
+
+   //Free previously allocated memory
+   netBufferFree(buffer);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Validate the cookie echoed by the final ACK of a handshake
+ * @param[in] socket Handle referencing the listening socket
+ * @param[in] pseudoHeader TCP pseudo header of the incoming segment
+ * @param[in] segment Incoming ACK segment (host byte order)
+ * @param[out] mss MSS encoded in the cookie
+ * @return NO_ERROR if the cookie is valid, else ERROR_FAILURE
+ **/
+
+error_t tcpCheckSynCookie(Socket *socket, const IpPseudoHeader *pseudoHeader,
+   const TcpHeader *segment, uint16_t *mss)
+{
+   uint_t i;
+   uint32_t cookie;
+   uint32_t isn;
+   uint32_t counter;
+
+   //Only a plain ACK can complete a handshake
+   if((segment->flags & (TCP_FLAG_SYN | TCP_FLAG_RST | TCP_FLAG_ACK)) !=
+      TCP_FLAG_ACK)
+   {
+      return ERROR_FAILURE;
+   }
+
+   //The ACK acknowledges the SYN of the SYN/ACK
+   cookie = segment->ackNum - 1;
+   //The ACK is the first segment following the SYN of the client
+   isn = segment->seqNum - 1;
+
+   //Current value of the counter
+   counter = osGetSystemTime() / TCP_SYN_COOKIE_PERIOD;
+
+   //The cookie is valid for one to two periods
+   for(i = 0; i < 2; i++)
+   {
+      //Matching counter?
+      if((cookie >> 27) == ((counter - i) & 0x1F))
+      {
+         //Recompute the cookie
+         if(tcpSynCookieCompute(pseudoHeader, segment, isn, counter - i,
+            (cookie >> 24) & 0x07) == cookie)
+         {
+            //Retrieve the MSS of the connection
+            *mss = tcpSynCookieMssTable[(cookie >> 24) & 0x07];
+            *mss = MIN(*mss, socket->tcb->mss);
+
+            //Number of valid cookies received
+            NET_STATS_INC(tcpSynCookiesRecv, 1);
+
+            //The cookie is valid
+            return NO_ERROR;
+         }
+      }
+   }
+
+   //Number of ACK segments with an invalid cookie
+   NET_STATS_INC(tcpSynCookiesFailed, 1);
+
+   //The cookie is not valid
+   return ERROR_FAILURE;
+}
+
+
+/**
+ * @brief Queue a connection established with a cookie
+ * @param[in] socket Handle referencing the listening socket
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader TCP pseudo header of the incoming ACK
+ * @param[in] segment Incoming ACK segment (host byte order)
+ * @param[in] mss MSS encoded in the cookie
+ * @return Error code
+ **/
+
+error_t tcpQueueSynCookie(Socket *socket, NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const TcpHeader *segment, uint16_t mss)
+{
+   uint_t n;
+   TcpSynQueueItem *queueItem;
+   TcpSynQueueItem **link;
+   TcpSynQueueItem **victimLink;
+
+   //Number of items in the SYN queue
+   n = 0;
+   //Oldest request that has not been answered yet
+   victimLink = NULL;
+
+   //Loop through the SYN queue
+   for(link = &socket->tcb->synQueue; *link != NULL; link = &(*link)->next)
+   {
+      //Connection requests still waiting for their SYN/ACK can be evicted
+      if(!(*link)->cookie && victimLink == NULL)
+      {
+         victimLink = link;
+      }
+
+      //Count the items
+      n++;
+   }
+
+   //Check whether the SYN queue is full
+   if(n >= socket->tcb->synQueueSize)
+   {
+      //Established connections take precedence over pending requests, whose
+      //client will retransmit its SYN and receive a cookie
+      if(victimLink == NULL)
+      {
+         //Number of connection requests received with a full SYN queue
+         NET_STATS_INC(tcpListenOverflows, 1);
+         //The accept queue is full of established connections
+         return ERROR_OUT_OF_RESOURCES;
+      }
+
+      //Remove the oldest pending request
+      queueItem = *victimLink;
+      *victimLink = queueItem->next;
+
+      //Deallocate memory buffer
+      memPoolFree(queueItem);
+   }
+
+   //Allocate memory to save the connection parameters
+   queueItem = memPoolAlloc(sizeof(TcpSynQueueItem));
+   //Failed to allocate memory?
+   if(queueItem == NULL)
+      return ERROR_OUT_OF_MEMORY;
+
+   //Clear the item
+   osMemset(queueItem, 0, sizeof(TcpSynQueueItem));
+
+#if (IPV4_SUPPORT == ENABLED)
+   //IPv4 is currently used?
+   if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
+   {
+      //Save the source and destination IPv4 addresses
+      queueItem->srcAddr.length = sizeof(Ipv4Addr);
+      queueItem->srcAddr.ipv4Addr = pseudoHeader->ipv4Data.srcAddr;
+      queueItem->destAddr.length = sizeof(Ipv4Addr);
+      queueItem->destAddr.ipv4Addr = pseudoHeader->ipv4Data.destAddr;
+   }
+   else
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   //IPv6 is currently used?
+   if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
+   {
+      //Save the source and destination IPv6 addresses
+      queueItem->srcAddr.length = sizeof(Ipv6Addr);
+      queueItem->srcAddr.ipv6Addr = pseudoHeader->ipv6Data.srcAddr;
+      queueItem->destAddr.length = sizeof(Ipv6Addr);
+      queueItem->destAddr.ipv6Addr = pseudoHeader->ipv6Data.destAddr;
+   }
+   else
+#endif
+   //Invalid pseudo header?
+   {
+      //Deallocate memory buffer
+      memPoolFree(queueItem);
+      //This should never occur...
+      return ERROR_INVALID_ADDRESS;
+   }
+
+   //Underlying network interface
+   queueItem->interface = interface;
+   //Save the port number of the client
+   queueItem->srcPort = segment->srcPort;
+
+   //The handshake is complete
+   queueItem->cookie = TRUE;
+   queueItem->isn = segment->seqNum - 1;
+   queueItem->iss = segment->ackNum - 1;
+   queueItem->mss = mss;
+   queueItem->window = segment->window;
+
+   //Reach the end of the SYN queue
+   link = &socket->tcb->synQueue;
+   while(*link != NULL)
+   {
+      link = &(*link)->next;
+   }
+
+   //Append the item to the SYN queue
+   *link = queueItem;
+
+   //Debug message
+   TRACE_INFO("TCP connection established with a SYN cookie\r\n");
+
+   //Notify user that a connection request is pending
+   tcpUpdateEvents(socket);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+#endif
@@ -0,0 +1,64 @@
+/**
+ * @file tcp_syn_cookie.h
+ * @brief SYN cookies
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+#ifndef _TCP_SYN_COOKIE_H
+#define _TCP_SYN_COOKIE_H
+
+//Dependencies
+#include "core/tcp.h"
+
+//Lifetime of a cookie counter value, in milliseconds
+#ifndef TCP_SYN_COOKIE_PERIOD
+   #define TCP_SYN_COOKIE_PERIOD 64000
+#elif (TCP_SYN_COOKIE_PERIOD < 1000)
+   #error TCP_SYN_COOKIE_PERIOD parameter is not valid
+#endif
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//SYN cookie related functions
+error_t tcpSendSynCookie(Socket *socket, NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const TcpHeader *segment);
+
+error_t tcpCheckSynCookie(Socket *socket, const IpPseudoHeader *pseudoHeader,
+   const TcpHeader *segment, uint16_t *mss);
+
+error_t tcpQueueSynCookie(Socket *socket, NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const TcpHeader *segment, uint16_t mss);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,440 @@
+/**
+ * @file tcp_time_wait.c
+ * @brief Compact TIME-WAIT table
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ *
+ * @section Description
+ *
+ * A connection entering the TIME-WAIT state only needs its 4-tuple and its
+ * sequence numbers to acknowledge a retransmitted FIN and to reject old
+ * duplicates. That state is moved to a small table so that the socket and
+ * its buffers can be released immediately, instead of being held for the
+ * whole 2MSL period. When the table is full, the oldest entry is reused
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL TCP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/tcp.h"
+#include "core/tcp_misc.h"
+#include "core/tcp_time_wait.h"
+#include "core/ip.h"
+#include "ipv4/ipv4.h"
+#include "ipv4/ipv4_misc.h"
+#include "ipv6/ipv6.h"
+#include "mibs/mib2_module.h"
+#include "mibs/tcp_mib_module.h"
+#include "date_time.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (TCP_SUPPORT == ENABLED && TCP_TIME_WAIT_TABLE_SIZE > 0)
+
+//Connections in the TIME-WAIT state
+static TcpTimeWaitEntry tcpTimeWaitTable[TCP_TIME_WAIT_TABLE_SIZE];
+
+
+/**
+ * @brief Initialize the TIME-WAIT table
+ **/
+
+void tcpTimeWaitInit(void)
+{
+   //Clear the table
+   osMemset(tcpTimeWaitTable, 0, sizeof(tcpTimeWaitTable));
+}
+
+
+/**
+ * @brief Move a connection entering the TIME-WAIT state to the table
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpTimeWaitAdd(Socket *socket)
+{
+   uint_t i;
+   systime_t time;
+   TcpTimeWaitEntry *entry;
+   TcpTimeWaitEntry *oldestEntry;
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //Keep track of the oldest entry
+   oldestEntry = &tcpTimeWaitTable[0];
+
+   //Search the table for a free or expired entry
+   for(i = 0; i < TCP_TIME_WAIT_TABLE_SIZE; i++)
+   {
+      //Point to the current entry
+      entry = &tcpTimeWaitTable[i];
+
+      //Free entry or 2MSL period elapsed?
+      if(!entry->used || (time - entry->startTime) >= TCP_2MSL_TIMER)
+      {
+         oldestEntry = entry;
+         break;
+      }
+
+      //Keep track of the oldest entry
+      if((time - entry->startTime) > (time - oldestEntry->startTime))
+      {
+         oldestEntry = entry;
+      }
+   }
+
+   //The oldest connection is dropped when the table runs out of space
+   if(i >= TCP_TIME_WAIT_TABLE_SIZE)
+   {
+      //Debug message
+      TRACE_INFO("TCP TIME-WAIT table full, dropping oldest entry...\r\n");
+   }
+
+   //Point to the selected entry
+   entry = oldestEntry;
+
+   //Save the connection identifier
+   entry->interface = socket->interface;
+   entry->localIpAddr = socket->localIpAddr;
+   entry->localPort = socket->localPort;
+   entry->remoteIpAddr = socket->remoteIpAddr;
+   entry->remotePort = socket->remotePort;
+
+   //Save the sequence numbers
+   entry->sndNxt = socket->tcb->sndNxt;
+   entry->rcvNxt = socket->tcb->rcvNxt;
+
+#if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
+   //Check whether window scaling is enabled
+   if(socket->tcb->wndScaleOptionReceived)
+   {
+      entry->window = MIN(socket->tcb->rcvWnd >> socket->tcb->rcvWndShift, UINT16_MAX);
+   }
+   else
+#endif
+   {
+      entry->window = MIN(socket->tcb->rcvWnd, UINT16_MAX);
+   }
+
+   //Save the IP header fields of the outgoing segments
+   entry->ttl = socket->ttl;
+   entry->tos = socket->tos;
+
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   //Save the timestamp state
+   entry->tsEnabled = socket->tcb->tsEnabled;
+   entry->tsOffset = socket->tcb->tsOffset;
+   entry->tsRecent = socket->tcb->tsRecent;
+#endif
+
+   //Start the 2MSL period
+   entry->startTime = time;
+   //The entry is now in use
+   entry->used = TRUE;
+}
+
+
+/**
+ * @brief Send an acknowledgment on behalf of a connection in TIME-WAIT state
+ * @param[in] entry Pointer to the TIME-WAIT entry
+ * @return Error code
+ **/
+
+static error_t tcpTimeWaitSendAck(TcpTimeWaitEntry *entry)
+{
+   error_t error;
+   size_t offset;
+   size_t length;
+   NetBuffer *buffer;
+   TcpHeader *segment;
+   IpPseudoHeader pseudoHeader;
+   NetTxAncillary ancillary;
+
+   //Allocate a memory buffer to hold the ACK segment
+   buffer = ipAllocBuffer(TCP_MAX_HEADER_LENGTH, &offset);
+   //Failed to allocate memory?
+   if(buffer == NULL)
+      return ERROR_OUT_OF_MEMORY;
+
+   //Point to the beginning of the TCP segment
+   segment = netBufferAt(buffer, offset, 0);
+
+   //Format TCP header
+   segment->srcPort = htons(entry->localPort);
+   segment->destPort = htons(entry->remotePort);
+   segment->seqNum = htonl(entry->sndNxt);
+   segment->ackNum = htonl(entry->rcvNxt);
+   segment->reserved1 = 0;
+   segment->dataOffset = sizeof(TcpHeader) / 4;
+   segment->flags = TCP_FLAG_ACK;
+   segment->reserved2 = 0;
+   segment->window = htons(entry->window);
+   segment->checksum = 0;
+   segment->urgentPointer = 0;
+
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   //The Timestamps option must be sent in every segment once negotiated
+   if(entry->tsEnabled)
+   {
+      uint32_t value[2];
+
+      //TSval and TSecr fields
+      value[0] = htonl((uint32_t) osGetSystemTime() + entry->tsOffset);
+      value[1] = htonl(entry->tsRecent);
+
+      //Append Timestamps option
+      tcpAddOption(segment, TCP_OPTION_TIMESTAMP, value, sizeof(value));
+   }
+#endif
+
+   //Calculate the length of the TCP segment
+   length = segment->dataOffset * 4;
+   //Adjust the length of the multi-part buffer
+   netBufferSetLength(buffer, offset + length);
+
+#if (IPV4_SUPPORT == ENABLED)
+   //Destination address is an IPv4 address?
+   if(entry->remoteIpAddr.length == sizeof(Ipv4Addr))
+   {
+      //Format IPv4 pseudo header
+      pseudoHeader.length = sizeof(Ipv4PseudoHeader);
+      pseudoHeader.ipv4Data.srcAddr = entry->localIpAddr.ipv4Addr;
+      pseudoHeader.ipv4Data.destAddr = entry->remoteIpAddr.ipv4Addr;
+      pseudoHeader.ipv4Data.reserved = 0;
+      pseudoHeader.ipv4Data.protocol = IPV4_PROTOCOL_TCP;
+      pseudoHeader.ipv4Data.length = htons(length);
+
+      //The checksum is inserted by the NIC when offload is active
+      if(!ipv4IsChecksumOffloadEnabled(entry->interface, length))
+      {
+         //Calculate TCP header checksum
+         segment->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader.ipv4Data,
+            sizeof(Ipv4PseudoHeader), buffer, offset, length);
+      }
+   }
+   else
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   //Destination address is an IPv6 address?
+   if(entry->remoteIpAddr.length == sizeof(Ipv6Addr))
+   {
+      //Format IPv6 pseudo header
+      pseudoHeader.length = sizeof(Ipv6PseudoHeader);
+      pseudoHeader.ipv6Data.srcAddr = entry->localIpAddr.ipv6Addr;
+      pseudoHeader.ipv6Data.destAddr = entry->remoteIpAddr.ipv6Addr;
+      pseudoHeader.ipv6Data.length = htonl(length);
+      pseudoHeader.ipv6Data.reserved[0] = 0;
+      pseudoHeader.ipv6Data.reserved[1] = 0;
+      pseudoHeader.ipv6Data.reserved[2] = 0;
+      pseudoHeader.ipv6Data.nextHeader = IPV6_TCP_HEADER;
+
+      //Calculate TCP header checksum
+      segment->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader.ipv6Data,
+         sizeof(Ipv6PseudoHeader), buffer, offset, length);
+   }
+   else
+#endif
+   //Destination address is not valid?
+   {
+      //Free previously allocated memory
+      netBufferFree(buffer);
+      //This should never occur...
+      return ERROR_INVALID_ADDRESS;
+   }
+
+   //Total number of segments sent
+   MIB2_TCP_INC_COUNTER32(tcpOutSegs, 1);
+   NET_STATS_INC(tcpOutSegs, 1);
+   TCP_MIB_INC_COUNTER32(tcpOutSegs, 1);
+   TCP_MIB_INC_COUNTER64(tcpHCOutSegs, 1);
+
+   //Debug message
+   TRACE_DEBUG("%s: Sending TCP TIME-WAIT acknowledgment...\r\n",
+      formatSystemTime(osGetSystemTime(), NULL));
+
+   //Dump TCP header contents for debugging purpose
+   tcpDumpHeader(segment, 0, 0, 0);
+
+   //Additional options can be passed to the stack along with the packet
+   ancillary = NET_DEFAULT_TX_ANCILLARY;
+   //Set the TTL value to be used
+   ancillary.ttl = entry->ttl;
+   //Set ToS field
+   ancillary.tos = entry->tos;
+
+   //Send TCP segment
+   error = ipSendDatagram(entry->interface, &pseudoHeader, buffer, offset,
+      &ancillary);
+
+   //Free previously allocated memory
+   netBufferFree(buffer);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Check whether an entry matches an incoming segment
+ * @param[in] entry Pointer to the TIME-WAIT entry
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader TCP pseudo header
+ * @param[in] segment Incoming TCP segment (host byte order)
+ * @return TRUE if the segment belongs to the connection, else FALSE
+ **/
+
+static bool_t tcpTimeWaitMatch(const TcpTimeWaitEntry *entry,
+   NetInterface *interface, const IpPseudoHeader *pseudoHeader,
+   const TcpHeader *segment)
+{
+   //Check the interface and the port numbers
+   if(entry->interface != interface ||
+      entry->localPort != segment->destPort ||
+      entry->remotePort != segment->srcPort)
+   {
+      return FALSE;
+   }
+
+#if (IPV4_SUPPORT == ENABLED)
+   //IPv4 segment?
+   if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
+   {
+      //Compare IPv4 addresses
+      return entry->remoteIpAddr.length == sizeof(Ipv4Addr) &&
+         entry->localIpAddr.ipv4Addr == pseudoHeader->ipv4Data.destAddr &&
+         entry->remoteIpAddr.ipv4Addr == pseudoHeader->ipv4Data.srcAddr;
+   }
+#endif
+
+#if (IPV6_SUPPORT == ENABLED)
+   //IPv6 segment?
+   if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
+   {
+      //Compare IPv6 addresses
+      return entry->remoteIpAddr.length == sizeof(Ipv6Addr) &&
+         ipv6CompAddr(&entry->localIpAddr.ipv6Addr,
+         &pseudoHeader->ipv6Data.destAddr) &&
+         ipv6CompAddr(&entry->remoteIpAddr.ipv6Addr,
+         &pseudoHeader->ipv6Data.srcAddr);
+   }
+#endif
+
+   //Unknown address family
+   return FALSE;
+}
+
+
+/**
+ * @brief Deliver an incoming segment to a connection in TIME-WAIT state
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader TCP pseudo header
+ * @param[in] segment Incoming TCP segment (host byte order)
+ * @param[in] length Length of the segment data
+ * @return TRUE if the segment has been consumed, FALSE if it does not belong
+ *   to a connection in TIME-WAIT state
+ **/
+
+bool_t tcpTimeWaitProcessSegment(NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const TcpHeader *segment,
+   size_t length)
+{
+   uint_t i;
+   systime_t time;
+   TcpTimeWaitEntry *entry;
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //Loop through the table
+   for(i = 0; i < TCP_TIME_WAIT_TABLE_SIZE; i++)
+   {
+      //Point to the current entry
+      entry = &tcpTimeWaitTable[i];
+
+      //Skip free entries
+      if(!entry->used)
+         continue;
+
+      //The connection goes to the CLOSED state when the 2MSL period elapses
+      if((time - entry->startTime) >= TCP_2MSL_TIMER)
+      {
+         entry->used = FALSE;
+         continue;
+      }
+
+      //Matching connection?
+      if(tcpTimeWaitMatch(entry, interface, pseudoHeader, segment))
+         break;
+   }
+
+   //No connection in TIME-WAIT state?
+   if(i >= TCP_TIME_WAIT_TABLE_SIZE)
+      return FALSE;
+
+   //Debug message
+   TRACE_DEBUG("TCP FSM: TIME-WAIT state (compact)\r\n");
+
+   //Ignore RST segments in TIME-WAIT state (refer to RFC 1337, section 3)
+   if((segment->flags & TCP_FLAG_RST) != 0)
+      return TRUE;
+
+   //A new SYN with a sequence number beyond the end of the old connection
+   //may reopen it (refer to RFC 1122, section 4.2.2.13)
+   if((segment->flags & (TCP_FLAG_SYN | TCP_FLAG_ACK)) == TCP_FLAG_SYN &&
+      TCP_CMP_SEQ(segment->seqNum, entry->rcvNxt) > 0)
+   {
+      //Release the entry and let a listening socket accept the connection
+      entry->used = FALSE;
+      return FALSE;
+   }
+
+   //The only thing that can arrive in this state is a retransmission of the
+   //remote FIN. Acknowledge it and restart the 2 MSL timeout
+   if((segment->flags & TCP_FLAG_FIN) != 0)
+   {
+      //Restart the 2MSL period
+      entry->startTime = time;
+      //Send an acknowledgment for the FIN
+      tcpTimeWaitSendAck(entry);
+   }
+   else if((segment->flags & TCP_FLAG_SYN) != 0 || length > 0 ||
+      segment->seqNum != entry->rcvNxt)
+   {
+      //If an incoming segment is not acceptable, an acknowledgment should be
+      //sent in reply
+      tcpTimeWaitSendAck(entry);
+   }
+
+   //The segment has been consumed
+   return TRUE;
+}
+
+#endif
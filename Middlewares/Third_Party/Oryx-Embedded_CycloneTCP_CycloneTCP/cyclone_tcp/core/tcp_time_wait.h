@@ -0,0 +1,82 @@
+/**
+ * @file tcp_time_wait.h
+ * @brief Compact TIME-WAIT table
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+#ifndef _TCP_TIME_WAIT_H
+#define _TCP_TIME_WAIT_H
+
+//Dependencies
+#include "core/tcp.h"
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Connection in the TIME-WAIT state
+ **/
+
+typedef struct
+{
+   bool_t used;              ///<The entry is in use
+   NetInterface *interface;  ///<Underlying network interface
+   IpAddr localIpAddr;       ///<Local IP address
+   uint16_t localPort;       ///<Local port number
+   IpAddr remoteIpAddr;      ///<Remote IP address
+   uint16_t remotePort;      ///<Remote port number
+   uint32_t sndNxt;          ///<Send next sequence number
+   uint32_t rcvNxt;          ///<Receive next sequence number
+   uint16_t window;          ///<Window field of the ACK segments
+   uint8_t ttl;              ///<Time-to-live value
+   uint8_t tos;              ///<Type-of-service value
+   systime_t startTime;      ///<Time at which the 2MSL period started
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   bool_t tsEnabled;         ///<Timestamps are used on the connection
+   uint32_t tsOffset;        ///<Offset of the timestamp clock
+   uint32_t tsRecent;        ///<Timestamp to be echoed (TS.Recent)
+#endif
+} TcpTimeWaitEntry;
+
+
+//Compact TIME-WAIT table related functions
+void tcpTimeWaitInit(void);
+void tcpTimeWaitAdd(Socket *socket);
+
+bool_t tcpTimeWaitProcessSegment(NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const TcpHeader *segment,
+   size_t length);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
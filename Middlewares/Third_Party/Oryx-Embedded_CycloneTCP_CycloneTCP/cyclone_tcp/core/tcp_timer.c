@@ -37,6 +37,8 @@
 #include "core/tcp.h"
 #include "core/tcp_misc.h"
 #include "core/tcp_timer.h"
+#include "core/tcp_auto_tune.h"
+#include "core/tcp_fast_open.h"
 #include "date_time.h"
 #include "debug.h"
 
@@ -44,11 +46,56 @@
 #if (TCP_SUPPORT == ENABLED)
 
 
+//Timer wheel, each slot spanning TCP_TICK_INTERVAL milliseconds (the extra
+//entry holds the sockets of the slot being processed)
+static Socket *tcpTimerWheel[TCP_TIMER_WHEEL_SIZE + 1];
+//Index of the next slot to be processed
+static uint_t tcpTimerWheelIndex;
+//Time at which the next slot is due
+static systime_t tcpTimerWheelTime;
+//Number of sockets linked into the timer wheel
+static uint_t tcpTimerWheelCount;
+//Time at which the TCP/IP task is expected to process the wheel
+static systime_t tcpTimerWakeTime;
+
+#if (NET_SHAPER_SUPPORT == ENABLED || TCP_PACING_SUPPORT == ENABLED)
+//Sockets waiting on their pace timer. Pacing delays are shorter than a slot
+//of the wheel, so these timers are kept apart, with the resolution of the
+//system time
+static Socket *tcpPaceList;
+//Earliest deadline of the pace timers
+static systime_t tcpPaceWakeTime;
+#endif
+
+
+/**
+ * @brief Initialize the TCP timer wheel
+ **/
+
+void tcpTimerInit(void)
+{
+   //Clear the timer wheel
+   osMemset(tcpTimerWheel, 0, sizeof(tcpTimerWheel));
+
+   //Initialize the current position
+   tcpTimerWheelIndex = 0;
+   tcpTimerWheelTime = osGetSystemTime();
+   tcpTimerWheelCount = 0;
+   tcpTimerWakeTime = tcpTimerWheelTime;
+
+#if (NET_SHAPER_SUPPORT == ENABLED || TCP_PACING_SUPPORT == ENABLED)
+   //No socket is paced yet
+   tcpPaceList = NULL;
+#endif
+}
+
+
 /**
  * @brief TCP timer handler
  *
- * This routine must be periodically called by the TCP/IP stack to
- * handle retransmissions and TCP related timers (persist timer,
+ * This routine is called by the TCP/IP stack whenever a slot of the timer
+ * wheel is due. Only the sockets whose timers may have expired are visited
+ * to handle retransmissions and TCP related timers (persist timer,
  * FIN-WAIT-2 timer and TIME-WAIT timer)
  *
  **/
@@ -56,33 +103,455 @@
 void tcpTick(void)
 {
    uint_t i;
+   systime_t time;
    Socket *socket;
 
-   //Loop through opened sockets
-   for(i = 0; i < SOCKET_MAX_COUNT; i++)
+   //Get current time
+   time = osGetSystemTime();
+
+#if (NET_SHAPER_SUPPORT == ENABLED || TCP_PACING_SUPPORT == ENABLED)
+   //Resume the sockets whose pace timer has expired
+   tcpTickPaceTimers(time);
+#endif
+
+   //Process the slots that are due, at most one full turn of the wheel
+   for(i = 0; i < TCP_TIMER_WHEEL_SIZE && tcpTimerWheelCount > 0; i++)
    {
-      //Point to the current socket
-      socket = &socketTable[i];
+      //Next slot not due yet?
+      if(timeCompare(time, tcpTimerWheelTime) < 0)
+         break;
+
+      //Move the sockets of the current slot to the list being processed, so
+      //that sockets rescheduled to the same slot are not visited twice
+      tcpTimerWheel[TCP_TIMER_WHEEL_SIZE] = tcpTimerWheel[tcpTimerWheelIndex];
+      tcpTimerWheel[tcpTimerWheelIndex] = NULL;
 
-      //TCP socket?
-      if(socket->type == SOCKET_TYPE_STREAM)
+      for(socket = tcpTimerWheel[TCP_TIMER_WHEEL_SIZE]; socket != NULL;
+         socket = socket->tcb->timerNext)
       {
-         //Check current TCP state
-         if(socket->state != TCP_STATE_CLOSED)
+         socket->tcb->timerSlot = TCP_TIMER_WHEEL_SIZE;
+      }
+
+      //Move to the next slot before the sockets are rescheduled
+      tcpTimerWheelIndex = (tcpTimerWheelIndex + 1) % TCP_TIMER_WHEEL_SIZE;
+      tcpTimerWheelTime += TCP_TICK_INTERVAL;
+
+      //Loop through the sockets of the slot
+      while((socket = tcpTimerWheel[TCP_TIMER_WHEEL_SIZE]) != NULL)
+      {
+         //Unlink the socket
+         tcpCancelTimers(socket);
+
+         //Deadline reached?
+         if(timeCompare(time, socket->tcb->timerDeadline) >= 0)
          {
-            //Check retransmission timer
-            tcpCheckRetransmitTimer(socket);
-            //Check persist timer
-            tcpCheckPersistTimer(socket);
-            //Check TCP keep-alive timer
-            tcpCheckKeepAliveTimer(socket);
-            //Check override timer
-            tcpCheckOverrideTimer(socket);
-            //Check FIN-WAIT-2 timer
-            tcpCheckFinWait2Timer(socket);
-            //Check 2MSL timer
-            tcpCheckTimeWaitTimer(socket);
+            //Check the TCP timers of the socket
+            tcpCheckTimers(socket);
          }
+
+         //Reschedule the socket (its deadline may belong to a later turn)
+         tcpScheduleTimers(socket);
+      }
+   }
+
+   //Resynchronize the wheel with the current time after a long idle period
+   if(timeCompare(time, tcpTimerWheelTime) >= 0)
+   {
+      tcpTimerWheelTime = time;
+   }
+}
+
+
+/**
+ * @brief Get the time to wait before the timer wheel must be processed
+ * @param[in] time Current time
+ * @return Timeout value, in milliseconds (INFINITE_DELAY if no TCP timer
+ *   is running)
+ **/
+
+systime_t tcpGetTimerTimeout(systime_t time)
+{
+   uint_t i;
+   systime_t timeout;
+
+   //No TCP timer running?
+   if(tcpTimerWheelCount == 0)
+   {
+      tcpTimerWakeTime = time + NET_TICK_INTERVAL;
+      timeout = INFINITE_DELAY;
+   }
+   else
+   {
+      //Search for the next slot holding a socket
+      for(i = 0; i < TCP_TIMER_WHEEL_SIZE; i++)
+      {
+         if(tcpTimerWheel[(tcpTimerWheelIndex + i) % TCP_TIMER_WHEEL_SIZE] != NULL)
+            break;
+      }
+
+      //Time at which the slot is due
+      tcpTimerWakeTime = tcpTimerWheelTime + i * TCP_TICK_INTERVAL;
+
+      //Compute the remaining time
+      if(timeCompare(tcpTimerWakeTime, time) > 0)
+      {
+         timeout = tcpTimerWakeTime - time;
+      }
+      else
+      {
+         timeout = 0;
+      }
+   }
+
+#if (NET_SHAPER_SUPPORT == ENABLED || TCP_PACING_SUPPORT == ENABLED)
+   //A pace timer may expire before the next slot
+   if(tcpPaceList != NULL && timeCompare(tcpPaceWakeTime, tcpTimerWakeTime) < 0)
+   {
+      tcpTimerWakeTime = tcpPaceWakeTime;
+
+      //Compute the remaining time
+      if(timeCompare(tcpTimerWakeTime, time) > 0)
+      {
+         timeout = tcpTimerWakeTime - time;
+      }
+      else
+      {
+         timeout = 0;
+      }
+   }
+#endif
+
+   //Return the timeout value
+   return timeout;
+}
+
+
+/**
+ * @brief Check whether a slot of the timer wheel is due
+ * @param[in] time Current time
+ * @return TRUE if tcpTick must be called, else FALSE
+ **/
+
+bool_t tcpTimerPending(systime_t time)
+{
+   //The next slot is due?
+   if(tcpTimerWheelCount > 0 && timeCompare(time, tcpTimerWheelTime) >= 0)
+   {
+      return TRUE;
+   }
+#if (NET_SHAPER_SUPPORT == ENABLED || TCP_PACING_SUPPORT == ENABLED)
+   //A pace timer is due?
+   else if(tcpPaceList != NULL && timeCompare(time, tcpPaceWakeTime) >= 0)
+   {
+      return TRUE;
+   }
+#endif
+   else
+   {
+      return FALSE;
+   }
+}
+
+
+/**
+ * @brief Start a TCP timer
+ * @param[in] socket Handle referencing the socket
+ * @param[in] timer Timer belonging to the socket
+ * @param[in] interval Time interval
+ **/
+
+void tcpStartTimer(Socket *socket, NetTimer *timer, systime_t interval)
+{
+   systime_t deadline;
+
+   //Start the timer
+   netStartTimer(timer, interval);
+
+   //Time at which the timer expires
+   deadline = timer->startTime + interval;
+
+   //The socket must be visited no later than the new deadline
+   if(!socket->tcb->timerScheduled ||
+      timeCompare(deadline, socket->tcb->timerDeadline) < 0)
+   {
+      //Remove the socket from its current slot
+      tcpCancelTimers(socket);
+      //Link the socket into the slot matching the new deadline
+      tcpTimerWheelInsert(socket, deadline);
+   }
+}
+
+
+/**
+ * @brief Schedule the next visit of a socket
+ *
+ * The earliest deadline of the running timers is computed and the socket is
+ * linked into the matching slot of the timer wheel. A deadline may be earlier
+ * than necessary (the keep-alive timestamp is refreshed lazily, for
+ * instance), in which case the socket is simply rescheduled when visited
+ *
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpScheduleTimers(Socket *socket)
+{
+   bool_t armed;
+   systime_t deadline;
+#if (TCP_KEEP_ALIVE_SUPPORT == ENABLED || TCP_AUTO_TUNE_SUPPORT == ENABLED)
+   systime_t time;
+#endif
+
+   //Remove the socket from its current slot
+   tcpCancelTimers(socket);
+
+   //Closed sockets do not run any timer
+   if(socket->type != SOCKET_TYPE_STREAM || socket->tcb->state == TCP_STATE_CLOSED)
+      return;
+
+   //No deadline yet
+   armed = FALSE;
+   deadline = 0;
+
+   //Timers are only considered under the conditions their handlers check,
+   //so that a timer left running does not cause the socket to be visited
+   //on every tick
+   if(socket->tcb->retransmitQueue != NULL)
+   {
+      //Retransmission timer
+      tcpTimerMinDeadline(&socket->tcb->retransmitTimer, &armed, &deadline);
+   }
+
+   if(socket->tcb->sndWnd == 0 && socket->tcb->wndProbeInterval != 0)
+   {
+      //Persist timer
+      tcpTimerMinDeadline(&socket->tcb->persistTimer, &armed, &deadline);
+   }
+
+   if(socket->tcb->sndUser > 0 && (socket->tcb->state == TCP_STATE_ESTABLISHED ||
+      socket->tcb->state == TCP_STATE_CLOSE_WAIT))
+   {
+      //Override timer
+      tcpTimerMinDeadline(&socket->tcb->overrideTimer, &armed, &deadline);
+   }
+
+   if(socket->tcb->state == TCP_STATE_FIN_WAIT_2)
+   {
+      //FIN-WAIT-2 timer
+      tcpTimerMinDeadline(&socket->tcb->finWait2Timer, &armed, &deadline);
+   }
+
+   if(socket->tcb->state == TCP_STATE_TIME_WAIT)
+   {
+      //2MSL timer
+      tcpTimerMinDeadline(&socket->tcb->timeWaitTimer, &armed, &deadline);
+   }
+
+#if (TCP_DELAYED_ACK_SUPPORT == ENABLED)
+   if(socket->tcb->delayedAckBytes > 0)
+   {
+      //Delayed ACK timer
+      tcpTimerMinDeadline(&socket->tcb->delayedAckTimer, &armed, &deadline);
+   }
+#endif
+
+#if (TCP_KEEP_ALIVE_SUPPORT == ENABLED)
+   //TCP keep-alive timer
+   if(socket->tcb->state == TCP_STATE_ESTABLISHED && socket->tcb->keepAliveEnabled)
+   {
+      //Idle condition?
+      if(socket->tcb->keepAliveProbeCount == 0)
+      {
+         time = socket->tcb->keepAliveTimestamp + socket->tcb->keepAliveIdle;
+      }
+      else
+      {
+         time = socket->tcb->keepAliveTimestamp +
+            MIN(socket->tcb->keepAliveInterval, socket->tcb->keepAliveIdle);
+      }
+
+      //Keep track of the earliest deadline
+      if(!armed || timeCompare(time, deadline) < 0)
+      {
+         deadline = time;
+         armed = TRUE;
+      }
+   }
+#endif
+
+#if (TCP_AUTO_TUNE_SUPPORT == ENABLED)
+   //Buffer auto-tuning measurement
+   if(tcpAutoTuneGetNextRun(socket, &time))
+   {
+      //Keep track of the earliest deadline
+      if(!armed || timeCompare(time, deadline) < 0)
+      {
+         deadline = time;
+         armed = TRUE;
+      }
+   }
+#endif
+
+   //Any timer running?
+   if(armed)
+   {
+      //Link the socket into the slot matching the deadline
+      tcpTimerWheelInsert(socket, deadline);
+   }
+}
+
+
+/**
+ * @brief Remove a socket from the timer wheel
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpCancelTimers(Socket *socket)
+{
+   //Make sure the socket is linked into the wheel
+   if(socket->tcb->timerScheduled)
+   {
+      //Unlink the socket
+      if(socket->tcb->timerPrev != NULL)
+      {
+         socket->tcb->timerPrev->tcb->timerNext = socket->tcb->timerNext;
+      }
+      else
+      {
+         tcpTimerWheel[socket->tcb->timerSlot] = socket->tcb->timerNext;
+      }
+
+      if(socket->tcb->timerNext != NULL)
+      {
+         socket->tcb->timerNext->tcb->timerPrev = socket->tcb->timerPrev;
+      }
+
+      //The socket is no longer linked into the wheel
+      socket->tcb->timerNext = NULL;
+      socket->tcb->timerPrev = NULL;
+      socket->tcb->timerScheduled = FALSE;
+      tcpTimerWheelCount--;
+   }
+}
+
+
+/**
+ * @brief Link a socket into the timer wheel
+ * @param[in] socket Handle referencing the socket
+ * @param[in] deadline Time at which the socket must be visited
+ **/
+
+void tcpTimerWheelInsert(Socket *socket, systime_t deadline)
+{
+   uint_t n;
+   systime_t delta;
+
+   //The wheel is not advanced while empty
+   if(tcpTimerWheelCount == 0)
+   {
+      tcpTimerWheelTime = osGetSystemTime();
+   }
+
+   //Number of slots between the current position and the deadline. Deadlines
+   //beyond one full turn wrap around and are checked again when reached
+   if(timeCompare(deadline, tcpTimerWheelTime) > 0)
+   {
+      delta = deadline - tcpTimerWheelTime;
+      n = (delta + TCP_TICK_INTERVAL - 1) / TCP_TICK_INTERVAL;
+      n %= TCP_TIMER_WHEEL_SIZE;
+   }
+   else
+   {
+      n = 0;
+   }
+
+   //Save the deadline
+   socket->tcb->timerDeadline = deadline;
+   socket->tcb->timerSlot = (tcpTimerWheelIndex + n) % TCP_TIMER_WHEEL_SIZE;
+
+   //Insert the socket at the head of the slot
+   socket->tcb->timerPrev = NULL;
+   socket->tcb->timerNext = tcpTimerWheel[socket->tcb->timerSlot];
+
+   if(socket->tcb->timerNext != NULL)
+   {
+      socket->tcb->timerNext->tcb->timerPrev = socket;
+   }
+
+   tcpTimerWheel[socket->tcb->timerSlot] = socket;
+   socket->tcb->timerScheduled = TRUE;
+   tcpTimerWheelCount++;
+
+#if (NET_RTOS_SUPPORT == ENABLED)
+   //Wake up the TCP/IP task if the slot is due before its next wake-up
+   if(timeCompare(tcpTimerWheelTime + n * TCP_TICK_INTERVAL,
+      tcpTimerWakeTime) < 0)
+   {
+      tcpTimerWakeTime = tcpTimerWheelTime + n * TCP_TICK_INTERVAL;
+      osSetEvent(&netEvent);
+   }
+#endif
+}
+
+
+/**
+ * @brief Keep track of the earliest deadline of the running timers
+ * @param[in] timer Timer to consider
+ * @param[in,out] armed TRUE if a deadline has already been found
+ * @param[in,out] deadline Earliest deadline found so far
+ **/
+
+void tcpTimerMinDeadline(NetTimer *timer, bool_t *armed, systime_t *deadline)
+{
+   systime_t time;
+
+   //Check whether the timer is running
+   if(timer->running)
+   {
+      //Time at which the timer expires
+      time = timer->startTime + timer->interval;
+
+      //Keep track of the earliest deadline
+      if(!*armed || timeCompare(time, *deadline) < 0)
+      {
+         *deadline = time;
+         *armed = TRUE;
+      }
+   }
+}
+
+
+/**
+ * @brief Check the TCP timers of a socket
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpCheckTimers(Socket *socket)
+{
+   //TCP socket?
+   if(socket->type == SOCKET_TYPE_STREAM)
+   {
+      //Check current TCP state
+      if(socket->tcb->state != TCP_STATE_CLOSED)
+      {
+         //Check retransmission timer
+         tcpCheckRetransmitTimer(socket);
+         //Check persist timer
+         tcpCheckPersistTimer(socket);
+         //Check TCP keep-alive timer
+         tcpCheckKeepAliveTimer(socket);
+         //Check override timer
+         tcpCheckOverrideTimer(socket);
+         //Check FIN-WAIT-2 timer
+         tcpCheckFinWait2Timer(socket);
+         //Check 2MSL timer
+         tcpCheckTimeWaitTimer(socket);
+         //Check delayed ACK timer
+         tcpCheckDelayedAckTimer(socket);
+
+#if (TCP_AUTO_TUNE_SUPPORT == ENABLED)
+         //Adjust the buffers to the measured throughput
+         tcpAutoTuneBuffers(socket);
+#endif
       }
    }
 }
@@ -96,74 +565,87 @@ void tcpTick(void)
 void tcpCheckRetransmitTimer(Socket *socket)
 {
    //Check current TCP state
-   if(socket->state != TCP_STATE_CLOSED)
+   if(socket->tcb->state != TCP_STATE_CLOSED)
    {
       //Any packet in the retransmission queue?
-      if(socket->retransmitQueue != NULL)
+      if(socket->tcb->retransmitQueue != NULL)
       {
          //Retransmission timeout?
-         if(netTimerExpired(&socket->retransmitTimer))
+         if(netTimerExpired(&socket->tcb->retransmitTimer))
          {
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
             //When a TCP sender detects segment loss using the retransmission
             //timer and the given segment has not yet been resent by way of
             //the retransmission timer, the value of ssthresh must be updated
-            if(socket->retransmitCount == 0)
+            if(socket->tcb->retransmitCount == 0)
             {
-               uint32_t flightSize;
-
-               //Amount of data that has been sent but not yet acknowledged
-               flightSize = socket->sndNxt - socket->sndUna;
                //Adjust ssthresh value
-               socket->ssthresh = MAX(flightSize / 2, (uint32_t) socket->smss * 2);
+               socket->tcb->congestAlgo->onRto(socket);
             }
 
             //Furthermore, upon a timeout cwnd must be set to no more than the
             //loss window, LW, which equals 1 full-sized segment
-            socket->cwnd = MIN((uint32_t) socket->smss * TCP_LOSS_WINDOW,
-               socket->txBufferSize);
+            socket->tcb->cwnd = MIN((uint32_t) socket->tcb->smss * TCP_LOSS_WINDOW,
+               socket->tcb->txBufferSize);
 
             //After a retransmit timeout, record the highest sequence number
             //transmitted in the variable recover
-            socket->recover = socket->sndNxt - 1;
+            socket->tcb->recover = socket->tcb->sndNxt - 1;
 
             //Enter the fast loss recovery procedure
-            socket->congestState = TCP_CONGEST_STATE_LOSS_RECOVERY;
+            socket->tcb->congestState = TCP_CONGEST_STATE_LOSS_RECOVERY;
 #endif
             //Make sure the maximum number of retransmissions has not been
             //reached
-            if(socket->retransmitCount < TCP_MAX_RETRIES)
+            if(socket->tcb->retransmitCount < TCP_MAX_RETRIES)
             {
                //Debug message
                TRACE_INFO("%s: TCP segment retransmission #%u (%u data bytes)...\r\n",
                   formatSystemTime(osGetSystemTime(), NULL),
-                  socket->retransmitCount + 1,
-                  socket->retransmitQueue->length);
+                  socket->tcb->retransmitCount + 1,
+                  socket->tcb->retransmitQueue->length);
 
-               //Retransmit the earliest segment that has not been acknowledged
-               //by the TCP receiver
-               tcpRetransmitSegment(socket);
+#if (TCP_SACK_SUPPORT == ENABLED)
+               //Prior SACK information must be ignored after a timeout
+               tcpClearSackScoreboard(socket);
+#endif
+
+#if (TCP_FAST_OPEN_SUPPORT == ENABLED)
+               //A SYN segment carrying data may be dropped by middleboxes
+               if(socket->tcb->state == TCP_STATE_SYN_SENT &&
+                  socket->tcb->fastOpenLength > 0)
+               {
+                  //Retry with a regular SYN segment
+                  tcpFastOpenFallback(socket);
+               }
+               else
+#endif
+               {
+                  //Retransmit the earliest segment that has not been
+                  //acknowledged by the TCP receiver
+                  tcpRetransmitSegment(socket);
+               }
 
                //Use exponential back-off algorithm to calculate the new RTO
-               socket->rto = MIN(socket->rto * 2, TCP_MAX_RTO);
+               socket->tcb->rto = MIN(socket->tcb->rto * 2, TCP_MAX_RTO);
                //Restart retransmission timer
-               netStartTimer(&socket->retransmitTimer, socket->rto);
+               tcpStartTimer(socket, &socket->tcb->retransmitTimer, socket->tcb->rto);
                //Increment retransmission counter
-               socket->retransmitCount++;
+               socket->tcb->retransmitCount++;
             }
             else
             {
                //Send a reset segment
-               tcpSendResetSegment(socket, socket->sndNxt);
+               tcpSendResetSegment(socket, socket->tcb->sndNxt);
                //Turn off the retransmission timer
-               netStopTimer(&socket->retransmitTimer);
+               netStopTimer(&socket->tcb->retransmitTimer);
                //The maximum number of retransmissions has been exceeded
                tcpChangeState(socket, TCP_STATE_CLOSED);
             }
 
             //TCP must use Karn's algorithm for taking RTT samples. That is, RTT
             //samples must not be made using segments that were retransmitted
-            socket->rttBusy = FALSE;
+            socket->tcb->rttBusy = FALSE;
          }
       }
    }
@@ -183,41 +665,41 @@ void tcpCheckRetransmitTimer(Socket *socket)
 void tcpCheckPersistTimer(Socket *socket)
 {
    //Check current TCP state
-   if(socket->state != TCP_STATE_CLOSED)
+   if(socket->tcb->state != TCP_STATE_CLOSED)
    {
       //Check whether the remote host advertises a window size of zero
-      if(socket->sndWnd == 0 && socket->wndProbeInterval != 0)
+      if(socket->tcb->sndWnd == 0 && socket->tcb->wndProbeInterval != 0)
       {
          //Persist timer expired?
-         if(netTimerExpired(&socket->persistTimer))
+         if(netTimerExpired(&socket->tcb->persistTimer))
          {
             //Make sure the maximum number of retransmissions has not been
             //reached
-            if(socket->wndProbeCount < TCP_MAX_RETRIES)
+            if(socket->tcb->wndProbeCount < TCP_MAX_RETRIES)
             {
                //Debug message
                TRACE_INFO("%s: TCP zero window probe #%u...\r\n",
-                  formatSystemTime(osGetSystemTime(), NULL), socket->wndProbeCount + 1);
+                  formatSystemTime(osGetSystemTime(), NULL), socket->tcb->wndProbeCount + 1);
 
                //Zero window probes usually have the sequence number one less
                //than expected
-               tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndUna - 1,
-                  socket->rcvNxt, 0, FALSE);
+               tcpSendSegment(socket, TCP_FLAG_ACK, socket->tcb->sndUna - 1,
+                  socket->tcb->rcvNxt, 0, FALSE);
 
                //The interval between successive probes should be increased
                //exponentially
-               socket->wndProbeInterval = MIN(socket->wndProbeInterval * 2,
+               socket->tcb->wndProbeInterval = MIN(socket->tcb->wndProbeInterval * 2,
                   TCP_MAX_PROBE_INTERVAL);
 
                //Restart the persist timer
-               netStartTimer(&socket->persistTimer, socket->wndProbeInterval);
+               tcpStartTimer(socket, &socket->tcb->persistTimer, socket->tcb->wndProbeInterval);
                //Increment window probe counter
-               socket->wndProbeCount++;
+               socket->tcb->wndProbeCount++;
             }
             else
             {
                //Send a reset segment
-               tcpSendResetSegment(socket, socket->sndNxt);
+               tcpSendResetSegment(socket, socket->tcb->sndNxt);
                //Enter CLOSED state
                tcpChangeState(socket, TCP_STATE_CLOSED);
             }
@@ -243,50 +725,50 @@ void tcpCheckKeepAliveTimer(Socket *socket)
    systime_t time;
 
    //Check current TCP state
-   if(socket->state == TCP_STATE_ESTABLISHED)
+   if(socket->tcb->state == TCP_STATE_ESTABLISHED)
    {
       //Check whether TCP keep-alive mechanism is enabled
-      if(socket->keepAliveEnabled)
+      if(socket->tcb->keepAliveEnabled)
       {
          //Get current time
          time = osGetSystemTime();
 
          //Idle condition?
-         if(socket->keepAliveProbeCount == 0)
+         if(socket->tcb->keepAliveProbeCount == 0)
          {
             //Check keep-alive idle timer
-            if(timeCompare(time, socket->keepAliveTimestamp +
-               socket->keepAliveIdle) >= 0)
+            if(timeCompare(time, socket->tcb->keepAliveTimestamp +
+               socket->tcb->keepAliveIdle) >= 0)
             {
                //Keep-alive probes are sent with a sequence number one less than
                //the sequence number the receiver is expecting
-               tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndUna - 1,
-                  socket->rcvNxt, 0, FALSE);
+               tcpSendSegment(socket, TCP_FLAG_ACK, socket->tcb->sndUna - 1,
+                  socket->tcb->rcvNxt, 0, FALSE);
 
                //Initialize window probe counter
-               socket->keepAliveProbeCount = 1;
+               socket->tcb->keepAliveProbeCount = 1;
                //Restart keep-alive timer
-               socket->keepAliveTimestamp = time;
+               socket->tcb->keepAliveTimestamp = time;
             }
          }
          else
          {
             //Check keep-alive probe timer
-            if(timeCompare(time, socket->keepAliveTimestamp +
-               MIN(socket->keepAliveInterval, socket->keepAliveIdle)) >= 0)
+            if(timeCompare(time, socket->tcb->keepAliveTimestamp +
+               MIN(socket->tcb->keepAliveInterval, socket->tcb->keepAliveIdle)) >= 0)
             {
                //Check the number of unacknowledged keep-alive probes
-               if(socket->keepAliveProbeCount < socket->keepAliveMaxProbes)
+               if(socket->tcb->keepAliveProbeCount < socket->tcb->keepAliveMaxProbes)
                {
                   //Keep-alive probes are sent with a sequence number one less
                   //than the sequence number the receiver is expecting
-                  tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndUna - 1,
-                     socket->rcvNxt, 0, FALSE);
+                  tcpSendSegment(socket, TCP_FLAG_ACK, socket->tcb->sndUna - 1,
+                     socket->tcb->rcvNxt, 0, FALSE);
 
                   //Increment window probe counter
-                  socket->keepAliveProbeCount++;
+                  socket->tcb->keepAliveProbeCount++;
                   //Restart keep-alive timer
-                  socket->keepAliveTimestamp = time;
+                  socket->tcb->keepAliveTimestamp = time;
                }
                else
                {
@@ -295,7 +777,7 @@ void tcpCheckKeepAliveTimer(Socket *socket)
                      formatSystemTime(osGetSystemTime(), NULL));
 
                   //Send a reset segment
-                  tcpSendResetSegment(socket, socket->sndNxt);
+                  tcpSendResetSegment(socket, socket->tcb->sndNxt);
                   //The TCP connection is dead
                   tcpChangeState(socket, TCP_STATE_CLOSED);
                }
@@ -324,25 +806,25 @@ void tcpCheckOverrideTimer(Socket *socket)
    uint32_t u;
 
    //Check current TCP state
-   if(socket->state == TCP_STATE_ESTABLISHED ||
-      socket->state == TCP_STATE_CLOSE_WAIT)
+   if(socket->tcb->state == TCP_STATE_ESTABLISHED ||
+      socket->tcb->state == TCP_STATE_CLOSE_WAIT)
    {
       //Override timer expired?
-      if(socket->sndUser && netTimerExpired(&socket->overrideTimer))
+      if(socket->tcb->sndUser && netTimerExpired(&socket->tcb->overrideTimer))
       {
          //The amount of data that can be sent at any given time is limited by
          //the receiver window and the congestion window
-         n = MIN(socket->sndWnd, socket->txBufferSize);
+         n = MIN(socket->tcb->sndWnd, socket->tcb->txBufferSize);
 
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
          //Check the congestion window
-         n = MIN(n, socket->cwnd);
+         n = MIN(n, socket->tcb->cwnd);
 #endif
          //Retrieve the size of the usable window
-         u = n - (socket->sndNxt - socket->sndUna);
+         u = n - (socket->tcb->sndNxt - socket->tcb->sndUna);
 
          //Send as much data as possible
-         while(socket->sndUser > 0)
+         while(socket->tcb->sndUser > 0)
          {
             //The usable window size may become zero or negative, preventing
             //packet transmission
@@ -350,20 +832,26 @@ void tcpCheckOverrideTimer(Socket *socket)
                break;
 
             //Calculate the number of bytes to send at a time
-            n = MIN(u, socket->sndUser);
-            n = MIN(n, socket->smss);
+            n = MIN(u, socket->tcb->sndUser);
+            n = MIN(n, socket->tcb->smss);
+
+#if (NET_SHAPER_SUPPORT == ENABLED || TCP_PACING_SUPPORT == ENABLED)
+            //Pacing and the rate limits still apply
+            if(tcpPaceSegment(socket, n))
+               break;
+#endif
 
             //Send TCP segment
             error = tcpSendSegment(socket, TCP_FLAG_PSH | TCP_FLAG_ACK,
-               socket->sndNxt, socket->rcvNxt, n, TRUE);
+               socket->tcb->sndNxt, socket->tcb->rcvNxt, n, TRUE);
             //Failed to send TCP segment?
             if(error)
                break;
 
             //Advance SND.NXT pointer
-            socket->sndNxt += n;
+            socket->tcb->sndNxt += n;
             //Adjust the number of bytes buffered but not yet sent
-            socket->sndUser -= n;
+            socket->tcb->sndUser -= n;
             //Update the size of the usable window
             u -= n;
          }
@@ -372,15 +860,188 @@ void tcpCheckOverrideTimer(Socket *socket)
          tcpUpdateEvents(socket);
 
          //Restart override timer if necessary
-         if(socket->sndUser > 0)
+         if(socket->tcb->sndUser > 0)
          {
-            netStartTimer(&socket->overrideTimer, TCP_OVERRIDE_TIMEOUT);
+            tcpStartTimer(socket, &socket->tcb->overrideTimer, TCP_OVERRIDE_TIMEOUT);
          }
       }
    }
 }
 
 
+#if (NET_SHAPER_SUPPORT == ENABLED || TCP_PACING_SUPPORT == ENABLED)
+
+/**
+ * @brief Link a socket into the list of paced sockets
+ * @param[in] socket Handle referencing the socket
+ * @param[in] deadline Time at which the pace timer expires
+ **/
+
+static void tcpLinkPaceTimer(Socket *socket, systime_t deadline)
+{
+   //Link the socket into the list of paced sockets
+   if(!socket->tcb->paceScheduled)
+   {
+      socket->tcb->paceNext = tcpPaceList;
+      socket->tcb->paceScheduled = TRUE;
+
+      //Keep track of the earliest deadline
+      if(tcpPaceList == NULL || timeCompare(deadline, tcpPaceWakeTime) < 0)
+      {
+         tcpPaceWakeTime = deadline;
+      }
+
+      tcpPaceList = socket;
+   }
+   else if(timeCompare(deadline, tcpPaceWakeTime) < 0)
+   {
+      tcpPaceWakeTime = deadline;
+   }
+   else
+   {
+      //The earliest deadline is unchanged
+   }
+
+#if (NET_RTOS_SUPPORT == ENABLED)
+   //Wake up the TCP/IP task if the timer expires before its next wake-up
+   if(timeCompare(deadline, tcpTimerWakeTime) < 0)
+   {
+      tcpTimerWakeTime = deadline;
+      osSetEvent(&netEvent);
+   }
+#endif
+}
+
+
+/**
+ * @brief Start the pace timer of a socket
+ * @param[in] socket Handle referencing the socket
+ * @param[in] interval Time interval
+ **/
+
+void tcpStartPaceTimer(Socket *socket, systime_t interval)
+{
+   //Start the timer
+   netStartTimer(&socket->tcb->paceTimer, interval);
+
+   //The socket must be visited no later than the deadline of the timer
+   tcpLinkPaceTimer(socket, socket->tcb->paceTimer.startTime + interval);
+}
+
+
+/**
+ * @brief Stop the pace timer of a socket
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpCancelPaceTimer(Socket *socket)
+{
+   Socket **p;
+
+   //Stop the timer
+   netStopTimer(&socket->tcb->paceTimer);
+
+   //Make sure the socket is linked into the list
+   if(socket->tcb->paceScheduled)
+   {
+      //Search the list for the socket (only a few sockets are paced at a
+      //time)
+      for(p = &tcpPaceList; *p != NULL; p = &(*p)->tcb->paceNext)
+      {
+         //Matching socket?
+         if(*p == socket)
+         {
+            //Unlink the socket
+            *p = socket->tcb->paceNext;
+            break;
+         }
+      }
+
+      //The socket is no longer linked into the list
+      socket->tcb->paceNext = NULL;
+      socket->tcb->paceScheduled = FALSE;
+   }
+}
+
+
+/**
+ * @brief Resume the sockets whose pace timer has expired
+ * @param[in] time Current time
+ **/
+
+void tcpTickPaceTimers(systime_t time)
+{
+   Socket *socket;
+   Socket *next;
+   Socket *pending;
+
+   //No pace timer due yet?
+   if(tcpPaceList == NULL || timeCompare(time, tcpPaceWakeTime) < 0)
+      return;
+
+   //Take the whole list, so that the sockets paced again while the list is
+   //processed are not visited twice
+   pending = tcpPaceList;
+   tcpPaceList = NULL;
+
+   //Loop through the paced sockets
+   for(socket = pending; socket != NULL; socket = next)
+   {
+      //Unlink the socket
+      next = socket->tcb->paceNext;
+      socket->tcb->paceNext = NULL;
+      socket->tcb->paceScheduled = FALSE;
+
+      //Pace timer expired?
+      if(netTimerExpired(&socket->tcb->paceTimer))
+      {
+         //Send the data held back
+         tcpCheckPaceTimer(socket);
+      }
+      else if(netTimerRunning(&socket->tcb->paceTimer))
+      {
+         //Link the socket again
+         tcpLinkPaceTimer(socket, socket->tcb->paceTimer.startTime +
+            socket->tcb->paceTimer.interval);
+      }
+      else
+      {
+         //The timer was stopped
+      }
+   }
+}
+
+
+/**
+ * @brief Check pace timer
+ *
+ * The data held back by pacing or by the rate limits of the socket or its
+ * traffic class is sent once the delay it was waiting for has elapsed
+ *
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpCheckPaceTimer(Socket *socket)
+{
+   //Stop the timer, so that it can be restarted if the data is held back
+   //again
+   netStopTimer(&socket->tcb->paceTimer);
+
+   //Check current TCP state
+   if(socket->tcb->state == TCP_STATE_ESTABLISHED ||
+      socket->tcb->state == TCP_STATE_CLOSE_WAIT)
+   {
+      //Send as much data as the Nagle algorithm and the pace allow
+      if(socket->tcb->sndUser > 0)
+      {
+         tcpNagleAlgo(socket, 0);
+      }
+   }
+}
+
+#endif
+
+
 /**
  * @brief Check FIN-WAIT-2 timer
  *
@@ -393,10 +1054,10 @@ void tcpCheckOverrideTimer(Socket *socket)
 void tcpCheckFinWait2Timer(Socket *socket)
 {
    //Check current TCP state
-   if(socket->state == TCP_STATE_FIN_WAIT_2)
+   if(socket->tcb->state == TCP_STATE_FIN_WAIT_2)
    {
       //FIN-WAIT-2 timer expired?
-      if(netTimerExpired(&socket->finWait2Timer))
+      if(netTimerExpired(&socket->tcb->finWait2Timer))
       {
          //Debug message
          TRACE_INFO("TCP FIN-WAIT-2 timer elapsed...\r\n");
@@ -419,10 +1080,10 @@ void tcpCheckFinWait2Timer(Socket *socket)
 void tcpCheckTimeWaitTimer(Socket *socket)
 {
    //Check current TCP state
-   if(socket->state == TCP_STATE_TIME_WAIT)
+   if(socket->tcb->state == TCP_STATE_TIME_WAIT)
    {
       //2MSL timer expired?
-      if(netTimerExpired(&socket->timeWaitTimer))
+      if(netTimerExpired(&socket->tcb->timeWaitTimer))
       {
          //Debug message
          TRACE_INFO("TCP 2MSL timer elapsed...\r\n");
@@ -430,10 +1091,11 @@ void tcpCheckTimeWaitTimer(Socket *socket)
          tcpChangeState(socket, TCP_STATE_CLOSED);
 
          //Dispose the socket if the user does not have the ownership anymore
-         if(!socket->ownedFlag)
+         if(!socket->tcb->ownedFlag)
          {
             //Delete the TCB
             tcpDeleteControlBlock(socket);
+            tcpReleaseControlBlock(socket);
             //Mark the socket as closed
             socket->type = SOCKET_TYPE_UNUSED;
          }
@@ -441,4 +1103,31 @@ void tcpCheckTimeWaitTimer(Socket *socket)
    }
 }
 
+
+/**
+ * @brief Check delayed ACK timer
+ *
+ * An ACK that could not be piggybacked on outgoing data before the delayed
+ * ACK timer expires is sent on its own
+ *
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpCheckDelayedAckTimer(Socket *socket)
+{
+#if (TCP_DELAYED_ACK_SUPPORT == ENABLED)
+   //Any data waiting for an acknowledgment?
+   if(socket->tcb->delayedAckBytes > 0)
+   {
+      //Delayed ACK timeout?
+      if(netTimerExpired(&socket->tcb->delayedAckTimer))
+      {
+         //Acknowledge the received data
+         tcpSendSegment(socket, TCP_FLAG_ACK, socket->tcb->sndNxt, socket->tcb->rcvNxt,
+            0, FALSE);
+      }
+   }
+#endif
+}
+
 #endif
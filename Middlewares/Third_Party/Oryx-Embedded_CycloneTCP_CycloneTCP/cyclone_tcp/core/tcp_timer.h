@@ -37,14 +37,33 @@ extern "C" {
 #endif
 
 //TCP timer related functions
+void tcpTimerInit(void);
 void tcpTick(void);
 
+systime_t tcpGetTimerTimeout(systime_t time);
+bool_t tcpTimerPending(systime_t time);
+
+void tcpStartTimer(Socket *socket, NetTimer *timer, systime_t interval);
+void tcpScheduleTimers(Socket *socket);
+void tcpCancelTimers(Socket *socket);
+
+void tcpTimerWheelInsert(Socket *socket, systime_t deadline);
+void tcpTimerMinDeadline(NetTimer *timer, bool_t *armed, systime_t *deadline);
+
+void tcpCheckTimers(Socket *socket);
+
+void tcpStartPaceTimer(Socket *socket, systime_t interval);
+void tcpCancelPaceTimer(Socket *socket);
+void tcpTickPaceTimers(systime_t time);
+
 void tcpCheckRetransmitTimer(Socket *socket);
 void tcpCheckPersistTimer(Socket *socket);
 void tcpCheckKeepAliveTimer(Socket *socket);
 void tcpCheckOverrideTimer(Socket *socket);
+void tcpCheckPaceTimer(Socket *socket);
 void tcpCheckFinWait2Timer(Socket *socket);
 void tcpCheckTimeWaitTimer(Socket *socket);
+void tcpCheckDelayedAckTimer(Socket *socket);
 
 //C++ guard
 #ifdef __cplusplus
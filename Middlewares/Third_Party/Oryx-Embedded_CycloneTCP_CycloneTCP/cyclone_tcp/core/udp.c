@@ -37,6 +37,7 @@
 #include "core/udp.h"
 #include "core/socket.h"
 #include "core/socket_misc.h"
+#include "core/socket_poll.h"
 #include "ipv4/ipv4.h"
 #include "ipv4/ipv4_misc.h"
 #include "ipv6/ipv6.h"
@@ -54,6 +55,11 @@ static uint16_t udpDynamicPort;
 //Table that holds the registered user callbacks
 UdpRxCallbackEntry udpCallbackTable[UDP_CALLBACK_TABLE_SIZE];
 
+#if (UDP_FAST_PATH_TABLE_SIZE > 0)
+//Per-port dispatch table, indexed by the low bits of the port number
+static UdpFastPathEntry udpFastPathTable[UDP_FAST_PATH_TABLE_SIZE];
+#endif
+
 
 /**
  * @brief UDP related initialization
@@ -68,6 +74,11 @@ error_t udpInit(void)
    //Initialize callback table
    osMemset(udpCallbackTable, 0, sizeof(udpCallbackTable));
 
+#if (UDP_FAST_PATH_TABLE_SIZE > 0)
+   //Initialize dispatch table
+   osMemset(udpFastPathTable, 0, sizeof(udpFastPathTable));
+#endif
+
    //Successful initialization
    return NO_ERROR;
 }
@@ -121,7 +132,7 @@ uint16_t udpGetDynamicPort(void)
  * @return Error code
  **/
 
-error_t udpProcessDatagram(NetInterface *interface,
+__net_fast_func error_t udpProcessDatagram(NetInterface *interface,
    const IpPseudoHeader *pseudoHeader, const NetBuffer *buffer, size_t offset,
    const NetRxAncillary *ancillary)
 {
@@ -130,8 +141,14 @@ error_t udpProcessDatagram(NetInterface *interface,
    size_t length;
    UdpHeader *header;
    Socket *socket;
-   SocketQueueItem *queueItem;
    NetBuffer *p;
+   bool_t loaned;
+#if (SOCKET_HASH_TABLE_SIZE > 0)
+   uint_t hashIndex;
+#endif
+
+   //Start of UDP processing (latency instrumentation)
+   NET_LATENCY_MARK(NET_LATENCY_POINT_TRANSPORT);
 
    //Retrieve the length of the UDP datagram
    length = netBufferGetLength(buffer) - offset;
@@ -142,6 +159,7 @@ error_t udpProcessDatagram(NetInterface *interface,
       //Number of received UDP datagrams that could not be delivered for
       //reasons other than the lack of an application at the destination port
       MIB2_UDP_INC_COUNTER32(udpInErrors, 1);
+      NET_STATS_INC(udpInErrors, 1);
       UDP_MIB_INC_COUNTER32(udpInErrors, 1);
 
       //Report an error
@@ -166,6 +184,7 @@ error_t udpProcessDatagram(NetInterface *interface,
       //Number of received UDP datagrams that could not be delivered for
       //reasons other than the lack of an application at the destination port
       MIB2_UDP_INC_COUNTER32(udpInErrors, 1);
+      NET_STATS_INC(udpInErrors, 1);
       UDP_MIB_INC_COUNTER32(udpInErrors, 1);
 
       //Report an error
@@ -179,16 +198,20 @@ error_t udpProcessDatagram(NetInterface *interface,
    if(header->checksum != 0x0000 ||
       pseudoHeader->length == sizeof(Ipv6PseudoHeader))
    {
-      //Verify UDP checksum
-      if(ipCalcUpperLayerChecksumEx(pseudoHeader->data,
+      //Verify UDP checksum, unless the NIC has already done so
+      if(!NET_RX_PAYLOAD_CHECKSUM_VALID(ancillary) &&
+         ipCalcUpperLayerChecksumEx(pseudoHeader->data,
          pseudoHeader->length, buffer, offset, length) != 0x0000)
       {
          //Debug message
          TRACE_WARNING("Wrong UDP header checksum!\r\n");
+         //Update statistics
+         NET_STATS_INC(udpInChecksumErrors, 1);
 
          //Number of received UDP datagrams that could not be delivered for
          //reasons other than the lack of an application at the destination port
          MIB2_UDP_INC_COUNTER32(udpInErrors, 1);
+         NET_STATS_INC(udpInErrors, 1);
          UDP_MIB_INC_COUNTER32(udpInErrors, 1);
 
          //Report an error
@@ -196,170 +219,55 @@ error_t udpProcessDatagram(NetInterface *interface,
       }
    }
 
-   //Loop through opened sockets
-   for(i = 0; i < SOCKET_MAX_COUNT; i++)
+#if (UDP_FAST_PATH_TABLE_SIZE > 0)
+   //Protocol handlers registered on the destination port get the datagram
+   //in place, before any socket lookup
+   if(udpInvokeFastPath(interface, pseudoHeader, header, buffer,
+      offset + sizeof(UdpHeader), ancillary))
    {
-      //Point to the current socket
-      socket = &socketTable[i];
+      return NO_ERROR;
+   }
+#endif
 
-      //UDP socket found?
-      if(socket->type != SOCKET_TYPE_DGRAM)
-         continue;
+   //Initialize socket handle
+   socket = NULL;
 
-      //Check whether the socket is bound to a particular interface
-      if(socket->interface != NULL && socket->interface != interface)
-         continue;
+#if (SOCKET_HASH_TABLE_SIZE > 0)
+   //Compute the hash value of the datagram's endpoints
+   hashIndex = socketComputeHash(SOCKET_IP_PROTO_UDP, pseudoHeader,
+      ntohs(header->srcPort), ntohs(header->destPort));
 
-      //Check destination port number
-      if(socket->localPort == 0 || socket->localPort != ntohs(header->destPort))
-         continue;
+   //Check the demultiplexing cache first
+   socket = socketHashLookup(hashIndex);
 
-      //Source port number filtering
-      if(socket->remotePort != 0 && socket->remotePort != ntohs(header->srcPort))
-         continue;
+   //Cached entries are only hints and must be validated
+   if(socket != NULL && !udpMatchSocket(socket, interface, pseudoHeader,
+      header))
+   {
+      socket = NULL;
+   }
+#endif
 
-#if (IPV4_SUPPORT == ENABLED)
-      //IPv4 packet received?
-      if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
+   //No socket found in the demultiplexing cache?
+   if(socket == NULL)
+   {
+      //Loop through opened sockets
+      for(i = 0; i < SOCKET_MAX_COUNT; i++)
       {
-         //Check whether the socket is restricted to IPv6 communications only
-         if((socket->options & SOCKET_OPTION_IPV6_ONLY) != 0)
-            continue;
-
-         //Check whether the destination address is a unicast, broadcast or
-         //multicast address
-         if(ipv4IsBroadcastAddr(interface, pseudoHeader->ipv4Data.destAddr))
-         {
-            //Check whether broadcast datagrams are accepted or not
-            if((socket->options & SOCKET_OPTION_BROADCAST) == 0)
-               continue;
-         }
-         else if(ipv4IsMulticastAddr(pseudoHeader->ipv4Data.destAddr))
-         {
-            IpAddr srcAddr;
-            IpAddr destAddr;
-
-            //Get source IPv4 address
-            srcAddr.length = sizeof(Ipv4Addr);
-            srcAddr.ipv4Addr = pseudoHeader->ipv4Data.srcAddr;
-
-            //Get destination IPv4 address
-            destAddr.length = sizeof(Ipv4Addr);
-            destAddr.ipv4Addr = pseudoHeader->ipv4Data.destAddr;
-
-            //Multicast address filtering
-            if(!socketMulticastFilter(socket, &destAddr, &srcAddr))
-            {
-               continue;
-            }
-         }
-         else
-         {
-            //Destination IP address filtering
-            if(socket->localIpAddr.length != 0)
-            {
-               //An IPv4 address is expected
-               if(socket->localIpAddr.length != sizeof(Ipv4Addr))
-                  continue;
-
-               //Filter out non-matching addresses
-               if(socket->localIpAddr.ipv4Addr != IPV4_UNSPECIFIED_ADDR &&
-                  socket->localIpAddr.ipv4Addr != pseudoHeader->ipv4Data.destAddr)
-               {
-                  continue;
-               }
-            }
-         }
-
-         //Source IP address filtering
-         if(socket->remoteIpAddr.length != 0)
+         //Check whether the current socket meets all the criteria
+         if(udpMatchSocket(&socketTable[i], interface, pseudoHeader, header))
          {
-            //An IPv4 address is expected
-            if(socket->remoteIpAddr.length != sizeof(Ipv4Addr))
-               continue;
+            //Point to the matching socket
+            socket = &socketTable[i];
 
-            //Filter out non-matching addresses
-            if(socket->remoteIpAddr.ipv4Addr != IPV4_UNSPECIFIED_ADDR &&
-               socket->remoteIpAddr.ipv4Addr != pseudoHeader->ipv4Data.srcAddr)
-            {
-               continue;
-            }
-         }
-      }
-      else
+#if (SOCKET_HASH_TABLE_SIZE > 0)
+            //Save the socket in the demultiplexing cache
+            socketHashInsert(hashIndex, socket);
 #endif
-#if (IPV6_SUPPORT == ENABLED)
-      //IPv6 packet received?
-      if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
-      {
-         //Check whether the destination address is a unicast or multicast
-         //address
-         if(ipv6IsMulticastAddr(&pseudoHeader->ipv6Data.destAddr))
-         {
-            IpAddr srcAddr;
-            IpAddr destAddr;
-
-            //Get source IPv6 address
-            srcAddr.length = sizeof(Ipv6Addr);
-            srcAddr.ipv6Addr = pseudoHeader->ipv6Data.srcAddr;
-
-            //Get destination IPv6 address
-            destAddr.length = sizeof(Ipv6Addr);
-            destAddr.ipv6Addr = pseudoHeader->ipv6Data.destAddr;
-
-            //Multicast address filtering
-            if(!socketMulticastFilter(socket, &destAddr, &srcAddr))
-            {
-               continue;
-            }
-         }
-         else
-         {
-            //Destination IP address filtering
-            if(socket->localIpAddr.length != 0)
-            {
-               //An IPv6 address is expected
-               if(socket->localIpAddr.length != sizeof(Ipv6Addr))
-                  continue;
-
-               //Filter out non-matching addresses
-               if(!ipv6CompAddr(&socket->localIpAddr.ipv6Addr,
-                  &IPV6_UNSPECIFIED_ADDR) &&
-                  !ipv6CompAddr(&socket->localIpAddr.ipv6Addr,
-                  &pseudoHeader->ipv6Data.destAddr))
-               {
-                  continue;
-               }
-            }
-         }
-
-         //Source IP address filtering
-         if(socket->remoteIpAddr.length != 0)
-         {
-            //An IPv6 address is expected
-            if(socket->remoteIpAddr.length != sizeof(Ipv6Addr))
-               continue;
-
-            //Filter out non-matching addresses
-            if(!ipv6CompAddr(&socket->remoteIpAddr.ipv6Addr,
-               &IPV6_UNSPECIFIED_ADDR) &&
-               !ipv6CompAddr(&socket->remoteIpAddr.ipv6Addr,
-               &pseudoHeader->ipv6Data.srcAddr))
-            {
-               continue;
-            }
+            //We are done
+            break;
          }
       }
-      else
-#endif
-      //Invalid packet received?
-      {
-         //This should never occur...
-         continue;
-      }
-
-      //The current socket meets all the criteria
-      break;
    }
 
    //Point to the payload
@@ -367,7 +275,7 @@ error_t udpProcessDatagram(NetInterface *interface,
    length -= sizeof(UdpHeader);
 
    //No matching socket found?
-   if(i >= SOCKET_MAX_COUNT)
+   if(socket == NULL)
    {
       //Invoke user callback, if any
       error = udpInvokeRxCallback(interface, pseudoHeader, header, buffer,
@@ -376,81 +284,299 @@ error_t udpProcessDatagram(NetInterface *interface,
       return error;
    }
 
-   //Empty receive queue?
-   if(socket->receiveQueue == NULL)
+#if (UDP_SHARED_PORT_SUPPORT == ENABLED)
+   //Multicast or broadcast datagram received on a shared port?
+   if((socket->options & SOCKET_OPTION_REUSE_PORT) != 0 &&
+      udpIsGroupDatagram(interface, pseudoHeader))
    {
-      //Allocate a memory buffer to hold the data and the associated descriptor
-      p = netBufferAlloc(sizeof(SocketQueueItem) + length);
+      //Deliver the datagram to every socket sharing the port
+      error = udpDeliverSharedDatagram(interface, pseudoHeader, header,
+         buffer, offset, length, ancillary);
+      //Return status code
+      return error;
+   }
+#endif
 
-      //Successful memory allocation?
-      if(p != NULL)
-      {
-         //Point to the newly created item
-         queueItem = netBufferAt(p, 0, 0);
-         queueItem->buffer = p;
-         //Add the newly created item to the queue
-         socket->receiveQueue = queueItem;
-      }
-      else
-      {
-         //Memory allocation failed
-         queueItem = NULL;
-      }
+   //Check whether the receive queue is full
+   if(udpGetRxQueueLength(socket) >= UDP_RX_QUEUE_SIZE)
+   {
+      //Number of inbound packets which were chosen to be discarded even
+      //though no errors had been detected
+      MIB2_IF_INC_COUNTER32(ifTable[interface->index].ifInDiscards, 1);
+      IF_MIB_INC_COUNTER32(ifTable[interface->index].ifInDiscards, 1);
+      NET_STATS_INC(udpQueueFullDrops, 1);
+
+      //Report an error
+      return ERROR_RECEIVE_QUEUE_FULL;
    }
-   else
+
+   //Allocate a memory buffer to hold the data and the associated descriptor
+   p = udpAllocRxBuffer(buffer, offset, length, &loaned);
+
+   //Not enough resources to properly handle the packet?
+   if(p == NULL)
    {
-      //Point to the very first item
-      queueItem = socket->receiveQueue;
+      //Number of inbound packets which were chosen to be discarded even
+      //though no errors had been detected
+      MIB2_IF_INC_COUNTER32(ifTable[interface->index].ifInDiscards, 1);
+      IF_MIB_INC_COUNTER32(ifTable[interface->index].ifInDiscards, 1);
+      NET_STATS_INC(udpNoBufferDrops, 1);
 
-      //Reach the last item in the receive queue
-      for(i = 1; queueItem->next; i++)
-      {
-         queueItem = queueItem->next;
-      }
+      //Report an error
+      return ERROR_OUT_OF_MEMORY;
+   }
+
+   //The payload has to be copied unless the driver buffer was taken over
+   if(!loaned)
+   {
+      //Copy the payload
+      netBufferCopy(p, sizeof(SocketQueueItem), buffer, offset, length);
+   }
+
+   //Add the datagram to the receive queue of the socket
+   udpQueueDatagram(socket, interface, pseudoHeader, header, p, ancillary);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+#if (UDP_SHARED_PORT_SUPPORT == ENABLED)
+
+/**
+ * @brief Check whether a datagram is sent to a multicast or broadcast address
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader UDP pseudo header
+ * @return TRUE if the datagram is addressed to a group of hosts, else FALSE
+ **/
+
+bool_t udpIsGroupDatagram(NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader)
+{
+#if (IPV4_SUPPORT == ENABLED)
+   //IPv4 packet received?
+   if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
+   {
+      //Check whether the destination address is a multicast or broadcast
+      //address
+      return ipv4IsMulticastAddr(pseudoHeader->ipv4Data.destAddr) ||
+         ipv4IsBroadcastAddr(interface, pseudoHeader->ipv4Data.destAddr);
+   }
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   //IPv6 packet received?
+   if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
+   {
+      //Check whether the destination address is a multicast address
+      return ipv6IsMulticastAddr(&pseudoHeader->ipv6Data.destAddr);
+   }
+#endif
+
+   //Invalid packet received
+   return FALSE;
+}
+
+
+/**
+ * @brief Deliver a datagram to every socket sharing the destination port
+ *
+ * The payload is held by a single buffer. Each socket gets a descriptor that
+ * references the payload, which is released along with the last descriptor.
+ * A socket whose descriptor cannot reference the payload gets a private copy
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader UDP pseudo header
+ * @param[in] header UDP header
+ * @param[in] buffer Multi-part buffer containing the incoming UDP packet
+ * @param[in] offset Offset to the payload
+ * @param[in] length Length of the payload
+ * @param[in] ancillary Additional options passed to the stack along with
+ *   the packet
+ * @return Error code
+ **/
+
+error_t udpDeliverSharedDatagram(NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const UdpHeader *header,
+   const NetBuffer *buffer, size_t offset, size_t length,
+   const NetRxAncillary *ancillary)
+{
+   error_t error;
+   uint_t i;
+   uint_t n;
+   uint_t refCount;
+   Socket *socket;
+   NetBuffer *shared;
+   NetBuffer *p;
+   bool_t loaned;
+
+   //Initialize status code
+   error = NO_ERROR;
+
+   //Number of sockets the datagram has been delivered to
+   n = 0;
+   //Number of descriptors referencing the shared payload
+   refCount = 0;
+
+   //Allocate the buffer that holds the payload on behalf of all the sockets
+   shared = udpAllocRxBuffer(buffer, offset, length, &loaned);
+
+   //The payload has to be copied unless the driver buffer was taken over
+   if(shared != NULL && !loaned)
+   {
+      //Copy the payload
+      netBufferCopy(shared, sizeof(SocketQueueItem), buffer, offset, length);
+   }
+
+   //Loop through opened sockets
+   for(i = 0; i < SOCKET_MAX_COUNT; i++)
+   {
+      //Point to the current socket
+      socket = &socketTable[i];
+
+      //Only the sockets that share the port get a copy of the datagram
+      if((socket->options & SOCKET_OPTION_REUSE_PORT) == 0)
+         continue;
+
+      //Check whether the current socket meets all the criteria
+      if(!udpMatchSocket(socket, interface, pseudoHeader, header))
+         continue;
 
       //Check whether the receive queue is full
-      if(i >= UDP_RX_QUEUE_SIZE)
+      if(udpGetRxQueueLength(socket) >= UDP_RX_QUEUE_SIZE)
       {
          //Number of inbound packets which were chosen to be discarded even
          //though no errors had been detected
          MIB2_IF_INC_COUNTER32(ifTable[interface->index].ifInDiscards, 1);
          IF_MIB_INC_COUNTER32(ifTable[interface->index].ifInDiscards, 1);
+         NET_STATS_INC(udpQueueFullDrops, 1);
 
-         //Report an error
-         return ERROR_RECEIVE_QUEUE_FULL;
+         //Process the next socket
+         error = ERROR_RECEIVE_QUEUE_FULL;
+         continue;
       }
 
-      //Allocate a memory buffer to hold the data and the associated descriptor
-      p = netBufferAlloc(sizeof(SocketQueueItem) + length);
+      //Initialize pointer
+      p = NULL;
+
+      //Valid shared payload?
+      if(shared != NULL)
+      {
+         //Allocate a memory buffer to hold the descriptor only
+         p = netBufferAlloc(sizeof(SocketQueueItem));
+
+         //Successful memory allocation?
+         if(p != NULL)
+         {
+            //Reference the payload
+            if(!netBufferShare(p, shared, sizeof(SocketQueueItem), length))
+            {
+               //The payload is now referenced by one more descriptor
+               refCount++;
+               NET_STATS_INC(udpInShared, 1);
+            }
+            else
+            {
+               //No more references are available
+               netBufferFree(p);
+               p = NULL;
+            }
+         }
+      }
 
-      //Successful memory allocation?
-      if(p != NULL)
+      //Fall back to a private copy of the payload?
+      if(p == NULL)
       {
-         //Add the newly created item to the queue
-         queueItem->next = netBufferAt(p, 0, 0);
-         //Point to the newly created item
-         queueItem = queueItem->next;
-         queueItem->buffer = p;
+         //Allocate a memory buffer to hold the data and the descriptor
+         p = netBufferAlloc(sizeof(SocketQueueItem) + length);
+
+         //Successful memory allocation?
+         if(p != NULL)
+         {
+            //Copy the payload
+            netBufferCopy(p, sizeof(SocketQueueItem), buffer, offset, length);
+         }
       }
-      else
+
+      //Not enough resources to properly handle the packet?
+      if(p == NULL)
       {
-         //Memory allocation failed
-         queueItem = NULL;
+         //Number of inbound packets which were chosen to be discarded even
+         //though no errors had been detected
+         MIB2_IF_INC_COUNTER32(ifTable[interface->index].ifInDiscards, 1);
+         IF_MIB_INC_COUNTER32(ifTable[interface->index].ifInDiscards, 1);
+         NET_STATS_INC(udpNoBufferDrops, 1);
+
+         //Process the next socket
+         error = ERROR_OUT_OF_MEMORY;
+         continue;
       }
+
+      //Add the datagram to the receive queue of the socket
+      udpQueueDatagram(socket, interface, pseudoHeader, header, p, ancillary);
+      //One more socket has been served
+      n++;
    }
 
-   //Not enough resources to properly handle the packet?
-   if(queueItem == NULL)
+   //The shared payload is owned by its descriptors, if any
+   if(shared != NULL && refCount == 0)
    {
-      //Number of inbound packets which were chosen to be discarded even
-      //though no errors had been detected
-      MIB2_IF_INC_COUNTER32(ifTable[interface->index].ifInDiscards, 1);
-      IF_MIB_INC_COUNTER32(ifTable[interface->index].ifInDiscards, 1);
+      netBufferFree(shared);
+   }
 
-      //Report an error
-      return ERROR_OUT_OF_MEMORY;
+   //Return status code
+   return (n > 0) ? NO_ERROR : error;
+}
+
+#endif
+
+
+/**
+ * @brief Get the number of datagrams waiting in the receive queue of a socket
+ * @param[in] socket Handle referencing the socket
+ * @return Number of queued datagrams
+ **/
+
+uint_t udpGetRxQueueLength(Socket *socket)
+{
+   uint_t n;
+   SocketQueueItem *queueItem;
+
+   //Point to the very first item
+   queueItem = socket->receiveQueue;
+
+   //Loop through the receive queue
+   for(n = 0; queueItem != NULL; n++)
+   {
+      queueItem = queueItem->next;
    }
 
+   //Return the number of queued datagrams
+   return n;
+}
+
+
+/**
+ * @brief Add a received datagram to the receive queue of a socket
+ * @param[in] socket Handle referencing the socket
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader UDP pseudo header
+ * @param[in] header UDP header
+ * @param[in] p Buffer holding the descriptor, followed by the payload
+ * @param[in] ancillary Additional options passed to the stack along with
+ *   the packet
+ **/
+
+__net_hot_func void udpQueueDatagram(Socket *socket, NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const UdpHeader *header,
+   NetBuffer *p, const NetRxAncillary *ancillary)
+{
+   SocketQueueItem *queueItem;
+   SocketQueueItem *lastItem;
+
+   //Point to the descriptor
+   queueItem = netBufferAt(p, 0, 0);
+   queueItem->buffer = p;
+
    //Initialize next field
    queueItem->next = NULL;
    //Network interface where the packet was received
@@ -487,150 +613,737 @@ error_t udpProcessDatagram(NetInterface *interface,
 
    //Offset to the payload
    queueItem->offset = sizeof(SocketQueueItem);
-   //Copy the payload
-   netBufferCopy(queueItem->buffer, queueItem->offset, buffer, offset, length);
-
    //Additional options can be passed to the stack along with the packet
    queueItem->ancillary = *ancillary;
 
-   //Notify user that data is available
-   udpUpdateEvents(socket);
+   //Empty receive queue?
+   if(socket->receiveQueue == NULL)
+   {
+      //Add the newly created item to the queue
+      socket->receiveQueue = queueItem;
+   }
+   else
+   {
+      //Point to the very first item
+      lastItem = socket->receiveQueue;
 
-   //Total number of UDP datagrams delivered to UDP users
-   MIB2_UDP_INC_COUNTER32(udpInDatagrams, 1);
-   UDP_MIB_INC_COUNTER32(udpInDatagrams, 1);
-   UDP_MIB_INC_COUNTER64(udpHCInDatagrams, 1);
+      //Reach the last item in the receive queue
+      while(lastItem->next != NULL)
+      {
+         lastItem = lastItem->next;
+      }
 
-   //Successful processing
-   return NO_ERROR;
+      //Add the newly created item to the queue
+      lastItem->next = queueItem;
+   }
+
+   //Datagram delivered to the socket (latency instrumentation)
+   NET_LATENCY_MARK(NET_LATENCY_POINT_SOCKET);
+
+#if (NIC_RX_BATCH_SUPPORT == ENABLED)
+   //Frame delivered as part of a batch?
+   if(interface->nicRxBatch)
+   {
+      //Notify user once the whole batch has been processed
+      socket->rxEventPending = TRUE;
+   }
+   else
+#endif
+   {
+      //Notify user that data is available
+      udpUpdateEvents(socket);
+   }
+
+   //Total number of UDP datagrams delivered to UDP users
+   MIB2_UDP_INC_COUNTER32(udpInDatagrams, 1);
+   NET_STATS_INC(udpInDatagrams, 1);
+   UDP_MIB_INC_COUNTER32(udpInDatagrams, 1);
+   UDP_MIB_INC_COUNTER64(udpHCInDatagrams, 1);
 }
 
 
 /**
- * @brief Send a UDP datagram
+ * @brief Check whether a socket can accept an incoming UDP datagram
  * @param[in] socket Handle referencing the socket
- * @param[in] message Pointer to the structure describing the datagram
- * @param[in] flags Set of flags that influences the behavior of this function
- * @return Error code
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader UDP pseudo header
+ * @param[in] header UDP header
+ * @return TRUE if the socket matches the datagram, else FALSE
  **/
 
-error_t udpSendDatagram(Socket *socket, const SocketMsg *message, uint_t flags)
+bool_t udpMatchSocket(Socket *socket, NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const UdpHeader *header)
 {
-   error_t error;
-   size_t offset;
-   NetBuffer *buffer;
-   NetInterface *interface;
-   NetTxAncillary ancillary;
+   //UDP socket found?
+   if(socket->type != SOCKET_TYPE_DGRAM)
+      return FALSE;
 
-   //Select the relevant network interface
-   if(message->interface != NULL)
-   {
-      interface = message->interface;
-   }
-   else
-   {
-      interface = socket->interface;
-   }
+   //Check whether the socket is bound to a particular interface
+   if(socket->interface != NULL && socket->interface != interface)
+      return FALSE;
 
-   //Allocate a memory buffer to hold the UDP datagram
-   buffer = udpAllocBuffer(0, &offset);
-   //Failed to allocate buffer?
-   if(buffer == NULL)
-      return ERROR_OUT_OF_MEMORY;
+   //Check destination port number
+   if(socket->localPort == 0 || socket->localPort != ntohs(header->destPort))
+      return FALSE;
 
-   //Copy data payload
-   error = netBufferAppend(buffer, message->data, message->length);
+   //Source port number filtering
+   if(socket->remotePort != 0 && socket->remotePort != ntohs(header->srcPort))
+      return FALSE;
 
-   //Successful processing?
-   if(!error)
+#if (IPV4_SUPPORT == ENABLED)
+   //IPv4 packet received?
+   if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
    {
-      //Additional options can be passed to the stack along with the packet
-      ancillary = NET_DEFAULT_TX_ANCILLARY;
+      //Check whether the socket is restricted to IPv6 communications only
+      if((socket->options & SOCKET_OPTION_IPV6_ONLY) != 0)
+         return FALSE;
 
-      //This option allows UDP checksum generation to be bypassed
-      if((socket->options & SOCKET_OPTION_UDP_NO_CHECKSUM) != 0)
+      //Check whether the destination address is a unicast, broadcast or
+      //multicast address
+      if(ipv4IsBroadcastAddr(interface, pseudoHeader->ipv4Data.destAddr))
       {
-         ancillary.noChecksum = TRUE;
+         //Check whether broadcast datagrams are accepted or not
+         if((socket->options & SOCKET_OPTION_BROADCAST) == 0)
+            return FALSE;
       }
+      else if(ipv4IsMulticastAddr(pseudoHeader->ipv4Data.destAddr))
+      {
+         IpAddr srcAddr;
+         IpAddr destAddr;
+
+         //Get source IPv4 address
+         srcAddr.length = sizeof(Ipv4Addr);
+         srcAddr.ipv4Addr = pseudoHeader->ipv4Data.srcAddr;
+
+         //Get destination IPv4 address
+         destAddr.length = sizeof(Ipv4Addr);
+         destAddr.ipv4Addr = pseudoHeader->ipv4Data.destAddr;
 
-      //Set the TTL value to be used
-      if(message->ttl != 0)
+         //Multicast address filtering
+         if(!socketMulticastFilter(socket, &destAddr, &srcAddr))
+         {
+            return FALSE;
+         }
+      }
+      else
       {
-         ancillary.ttl = message->ttl;
+         //Destination IP address filtering
+         if(socket->localIpAddr.length != 0)
+         {
+            //An IPv4 address is expected
+            if(socket->localIpAddr.length != sizeof(Ipv4Addr))
+               return FALSE;
+
+            //Filter out non-matching addresses
+            if(socket->localIpAddr.ipv4Addr != IPV4_UNSPECIFIED_ADDR &&
+               socket->localIpAddr.ipv4Addr != pseudoHeader->ipv4Data.destAddr)
+            {
+               return FALSE;
+            }
+         }
+      }
+
+      //Source IP address filtering
+      if(socket->remoteIpAddr.length != 0)
+      {
+         //An IPv4 address is expected
+         if(socket->remoteIpAddr.length != sizeof(Ipv4Addr))
+            return FALSE;
+
+         //Filter out non-matching addresses
+         if(socket->remoteIpAddr.ipv4Addr != IPV4_UNSPECIFIED_ADDR &&
+            socket->remoteIpAddr.ipv4Addr != pseudoHeader->ipv4Data.srcAddr)
+         {
+            return FALSE;
+         }
       }
-      else if(ipIsMulticastAddr(&message->destIpAddr))
+   }
+   else
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   //IPv6 packet received?
+   if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
+   {
+      //Check whether the destination address is a unicast or multicast
+      //address
+      if(ipv6IsMulticastAddr(&pseudoHeader->ipv6Data.destAddr))
       {
-         ancillary.ttl = socket->multicastTtl;
+         IpAddr srcAddr;
+         IpAddr destAddr;
+
+         //Get source IPv6 address
+         srcAddr.length = sizeof(Ipv6Addr);
+         srcAddr.ipv6Addr = pseudoHeader->ipv6Data.srcAddr;
+
+         //Get destination IPv6 address
+         destAddr.length = sizeof(Ipv6Addr);
+         destAddr.ipv6Addr = pseudoHeader->ipv6Data.destAddr;
+
+         //Multicast address filtering
+         if(!socketMulticastFilter(socket, &destAddr, &srcAddr))
+         {
+            return FALSE;
+         }
       }
       else
       {
-         ancillary.ttl = socket->ttl;
+         //Destination IP address filtering
+         if(socket->localIpAddr.length != 0)
+         {
+            //An IPv6 address is expected
+            if(socket->localIpAddr.length != sizeof(Ipv6Addr))
+               return FALSE;
+
+            //Filter out non-matching addresses
+            if(!ipv6CompAddr(&socket->localIpAddr.ipv6Addr,
+               &IPV6_UNSPECIFIED_ADDR) &&
+               !ipv6CompAddr(&socket->localIpAddr.ipv6Addr,
+               &pseudoHeader->ipv6Data.destAddr))
+            {
+               return FALSE;
+            }
+         }
       }
 
-      //Set ToS field
-      if(message->tos != 0)
+      //Source IP address filtering
+      if(socket->remoteIpAddr.length != 0)
       {
-         ancillary.tos = message->tos;
+         //An IPv6 address is expected
+         if(socket->remoteIpAddr.length != sizeof(Ipv6Addr))
+            return FALSE;
+
+         //Filter out non-matching addresses
+         if(!ipv6CompAddr(&socket->remoteIpAddr.ipv6Addr,
+            &IPV6_UNSPECIFIED_ADDR) &&
+            !ipv6CompAddr(&socket->remoteIpAddr.ipv6Addr,
+            &pseudoHeader->ipv6Data.srcAddr))
+         {
+            return FALSE;
+         }
       }
-      else
+   }
+   else
+#endif
+   //Invalid packet received?
+   {
+      //This should never occur...
+      return FALSE;
+   }
+
+   //The socket meets all the criteria
+   return TRUE;
+}
+
+
+/**
+ * @brief Allocate a buffer to hold an incoming datagram
+ *
+ * When the NIC driver offered the frame for loan, the payload is attached to
+ * the buffer without being copied. Otherwise a buffer large enough to hold the
+ * descriptor and the payload is allocated
+ *
+ * @param[in] buffer Multi-part buffer containing the incoming UDP packet
+ * @param[in] offset Offset to the payload
+ * @param[in] length Length of the payload
+ * @param[out] loaned TRUE if the payload has been attached without copy
+ * @return Pointer to the newly allocated buffer
+ **/
+
+NetBuffer *udpAllocRxBuffer(const NetBuffer *buffer, size_t offset,
+   size_t length, bool_t *loaned)
+{
+   NetBuffer *p;
+
+   //The payload is copied by default
+   *loaned = FALSE;
+
+#if (NET_MEM_RX_LOAN_SUPPORT == ENABLED)
+   //Non-empty payload?
+   if(length > 0)
+   {
+      void *data;
+
+      //The payload must be contiguous in order to be loaned
+      data = netBufferAt(buffer, offset, length);
+
+      //Valid payload pointer?
+      if(data != NULL)
       {
-         ancillary.tos = socket->tos;
+         //Allocate a memory buffer to hold the descriptor only
+         p = netBufferAlloc(sizeof(SocketQueueItem));
+
+         //Successful memory allocation?
+         if(p != NULL)
+         {
+            //Take over the driver buffer
+            if(!netBufferAcceptLoan(p, data, length))
+            {
+               //The payload does not need to be copied
+               *loaned = TRUE;
+               //Return a pointer to the buffer
+               return p;
+            }
+
+            //The loan was refused
+            netBufferFree(p);
+         }
       }
+   }
+#endif
+
+   //Allocate a memory buffer to hold the data and the associated descriptor
+   p = netBufferAlloc(sizeof(SocketQueueItem) + length);
+
+   //Return a pointer to the buffer
+   return p;
+}
+
+
+#if (NET_SHAPER_SUPPORT == ENABLED)
+
+/**
+ * @brief Wait until the rate limits allow a datagram
+ *
+ * The netMutex and the socket lock are released while waiting. A socket
+ * that cannot wait (zero timeout or SOCKET_FLAG_DONT_WAIT) has its datagram
+ * refused, as has one whose timeout would expire before enough tokens
+ * accumulate
+ *
+ * @param[in] socket Handle referencing the socket
+ * @param[in] tos ToS value of the datagram
+ * @param[in] length Length of the payload
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+static error_t udpWaitForShaper(Socket *socket, uint8_t tos, size_t length,
+   uint_t flags)
+{
+   bool_t held;
+   systime_t delay;
+   systime_t elapsed;
+#if (NIC_TX_BATCH_SUPPORT == ENABLED)
+   bool_t batch;
+#endif
 
-      //This flag can be used to send IP packets without fragmentation
-      if(message->destIpAddr.length == sizeof(Ipv4Addr) &&
-         (socket->options & SOCKET_OPTION_IPV4_DONT_FRAG) != 0)
+   //Time spent waiting so far
+   elapsed = 0;
+
+   //Wait for the tokens of both the socket and its class
+   while(1)
+   {
+      //Time before the rate limits allow the datagram
+      delay = netShaperGetDelay(socket, tos, length);
+      //The datagram can be sent now?
+      if(delay == 0)
+         break;
+
+      //Check whether the sender can wait
+      if((flags & SOCKET_FLAG_DONT_WAIT) != 0 || socket->timeout == 0 ||
+         (socket->timeout != INFINITE_DELAY &&
+         elapsed + delay > socket->timeout))
       {
-         ancillary.dontFrag = TRUE;
+         //The datagram is refused
+         netShaperCountDropped(socket, tos, length);
+         return ERROR_WOULD_BLOCK;
       }
-      else if(message->destIpAddr.length == sizeof(Ipv6Addr) &&
-         (socket->options & SOCKET_OPTION_IPV6_DONT_FRAG) != 0)
+
+      //Count the datagram once
+      if(elapsed == 0)
       {
-         ancillary.dontFrag = TRUE;
+         netShaperCountDelayed(socket, tos, length);
       }
-      else
+
+#if (NIC_TX_BATCH_SUPPORT == ENABLED)
+      //The frames of a batch are not left behind while waiting
+      batch = netInterface[0].nicTxBatch;
+
+      if(batch)
       {
-         ancillary.dontFrag = message->dontFrag;
+         nicEndTxBatch();
       }
+#endif
+
+      //Let the other tasks use the stack and the socket meanwhile
+      held = socketSuspendLock(socket);
+      osDelayTask(delay);
+      socketResumeLock(socket, held);
 
-      //This flag tells the stack that the destination is on a locally attached
-      //network and not to perform a lookup of the routing table
-      if((flags & SOCKET_FLAG_DONT_ROUTE) != 0)
+#if (NIC_TX_BATCH_SUPPORT == ENABLED)
+      //Resume the batch
+      if(batch)
       {
-         ancillary.dontRoute = TRUE;
+         nicBeginTxBatch();
       }
+#endif
+
+      //Update the time spent waiting
+      elapsed += delay;
+   }
+
+   //Charge the datagram
+   netShaperConsume(socket, tos, length);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+#endif
+
+
+/**
+ * @brief Send a UDP datagram held in a multi-part buffer
+ * @param[in] socket Handle referencing the socket
+ * @param[in] interface Underlying network interface (optional parameter)
+ * @param[in] message Pointer to the structure describing the datagram
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @param[in] buffer Multi-part buffer containing the payload
+ * @param[in] offset Offset to the first payload byte
+ * @return Error code
+ **/
+
+static error_t udpSendDatagramBuffer(Socket *socket, NetInterface *interface,
+   const SocketMsg *message, uint_t flags, NetBuffer *buffer, size_t offset)
+{
+   error_t error;
+   IpAddr srcIpAddr;
+   NetTxAncillary ancillary;
+#if (SOCKET_ROUTE_CACHE_SUPPORT == ENABLED && (IPV4_SUPPORT == ENABLED || \
+   IPV6_SUPPORT == ENABLED))
+   bool_t cacheable;
+#endif
+
+   //Additional options can be passed to the stack along with the packet
+   ancillary = NET_DEFAULT_TX_ANCILLARY;
+
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+   //The buffer is freed as soon as the datagram has been sent, so the NIC
+   //driver may transmit it in place
+   ancillary.zeroCopy = TRUE;
+#endif
+
+   //This option allows UDP checksum generation to be bypassed
+   if((socket->options & SOCKET_OPTION_UDP_NO_CHECKSUM) != 0)
+   {
+      ancillary.noChecksum = TRUE;
+   }
+
+   //Set the TTL value to be used
+   if(message->ttl != 0)
+   {
+      ancillary.ttl = message->ttl;
+   }
+   else if(ipIsMulticastAddr(&message->destIpAddr))
+   {
+      ancillary.ttl = socket->multicastTtl;
+   }
+   else
+   {
+      ancillary.ttl = socket->ttl;
+   }
+
+   //Set ToS field
+   if(message->tos != 0)
+   {
+      ancillary.tos = message->tos;
+   }
+   else
+   {
+      ancillary.tos = socket->tos;
+   }
+
+#if (NET_SHAPER_SUPPORT == ENABLED)
+   //Enforce the rate limits of the socket and its traffic class
+   error = udpWaitForShaper(socket, ancillary.tos,
+      netBufferGetLength(buffer) - offset, flags);
+   //The datagram cannot be sent?
+   if(error)
+      return error;
+#endif
+
+   //This flag can be used to send IP packets without fragmentation
+   if(message->destIpAddr.length == sizeof(Ipv4Addr) &&
+      (socket->options & SOCKET_OPTION_IPV4_DONT_FRAG) != 0)
+   {
+      ancillary.dontFrag = TRUE;
+   }
+   else if(message->destIpAddr.length == sizeof(Ipv6Addr) &&
+      (socket->options & SOCKET_OPTION_IPV6_DONT_FRAG) != 0)
+   {
+      ancillary.dontFrag = TRUE;
+   }
+   else
+   {
+      ancillary.dontFrag = message->dontFrag;
+   }
+
+   //This flag tells the stack that the destination is on a locally attached
+   //network and not to perform a lookup of the routing table
+   if((flags & SOCKET_FLAG_DONT_ROUTE) != 0)
+   {
+      ancillary.dontRoute = TRUE;
+   }
 
 #if (ETH_SUPPORT == ENABLED)
-      //Set source and destination MAC addresses
-      ancillary.srcMacAddr = message->srcMacAddr;
-      ancillary.destMacAddr = message->destMacAddr;
+   //Set source and destination MAC addresses
+   ancillary.srcMacAddr = message->srcMacAddr;
+   ancillary.destMacAddr = message->destMacAddr;
 #endif
 
 #if (ETH_VLAN_SUPPORT == ENABLED)
-      //Set VLAN PCP and DEI fields
-      ancillary.vlanPcp = socket->vlanPcp;
-      ancillary.vlanDei = socket->vlanDei;
+   //Set VLAN PCP and DEI fields
+   ancillary.vlanPcp = socket->vlanPcp;
+   ancillary.vlanDei = socket->vlanDei;
+#endif
+
+#if (ETH_VMAN_SUPPORT == ENABLED)
+   //Set VMAN PCP and DEI fields
+   ancillary.vmanPcp = socket->vmanPcp;
+   ancillary.vmanDei = socket->vmanDei;
+#endif
+
+#if (ETH_PORT_TAGGING_SUPPORT == ENABLED)
+   //Set switch port identifier
+   ancillary.port = message->switchPort;
+#endif
+
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+   //Unique identifier for hardware time stamping
+   ancillary.timestampId = message->timestampId;
+#endif
+
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+   //The frame is held by the NIC until the PTP time reaches its launch time
+   ancillary.launchTime = message->launchTime;
+#endif
+
+#if (NIC_TX_DEADLINE_SUPPORT == ENABLED)
+   //Stale datagrams are dropped before they reach the transmitter
+   ancillary.deadline = message->deadline;
+#endif
+
+   //Source IP address specified by the caller, if any
+   srcIpAddr = message->srcIpAddr;
+
+#if (SOCKET_ROUTE_CACHE_SUPPORT == ENABLED && (IPV4_SUPPORT == ENABLED || \
+   IPV6_SUPPORT == ENABLED))
+   //The route to a unicast destination can be cached, unless the caller
+   //selects the next hop by itself
+   cacheable = FALSE;
+
+#if (IPV4_SUPPORT == ENABLED)
+   //Unicast IPv4 destination?
+   if(message->destIpAddr.length == sizeof(Ipv4Addr) &&
+      !ipv4IsMulticastAddr(message->destIpAddr.ipv4Addr) &&
+      message->destIpAddr.ipv4Addr != IPV4_BROADCAST_ADDR)
+   {
+      cacheable = TRUE;
+   }
+#endif
+
+#if (IPV6_SUPPORT == ENABLED)
+   //Unicast IPv6 destination?
+   if(message->destIpAddr.length == sizeof(Ipv6Addr) &&
+      !ipv6IsMulticastAddr(&message->destIpAddr.ipv6Addr))
+   {
+      cacheable = TRUE;
+   }
+#endif
+
+   //The next hop is selected by the caller?
+   if(ancillary.dontRoute)
+   {
+      cacheable = FALSE;
+   }
+
+#if (ETH_SUPPORT == ENABLED)
+   //Destination MAC address specified by the caller?
+   if(!macCompAddr(&ancillary.destMacAddr, &MAC_UNSPECIFIED_ADDR))
+   {
+      cacheable = FALSE;
+   }
+#endif
+
+   //Check whether the route can be cached
+   if(cacheable)
+   {
+      //Reuse the route of the previous datagram, if still valid
+      if(socketGetCachedRoute(socket, &message->destIpAddr, &interface,
+         &srcIpAddr, &ancillary))
+      {
+         //The cache is up to date
+         cacheable = FALSE;
+      }
+      else if(srcIpAddr.length == 0)
+      {
+         //Select the source address and the outgoing interface here, so
+         //that they can be saved along with the next hop
+         if(ipSelectSourceAddr(&interface, &message->destIpAddr,
+            &srcIpAddr))
+         {
+            //Let udpSendBuffer handle the failure
+            srcIpAddr = message->srcIpAddr;
+            cacheable = FALSE;
+         }
+      }
+      else if(interface == NULL)
+      {
+         //Use default network interface
+         interface = netGetDefaultInterface();
+      }
+   }
+#endif
+
+   //Send UDP datagram
+   error = udpSendBuffer(interface, &srcIpAddr, socket->localPort,
+      &message->destIpAddr, message->destPort, buffer, offset, &ancillary);
+
+#if (SOCKET_ROUTE_CACHE_SUPPORT == ENABLED && (IPV4_SUPPORT == ENABLED || \
+   IPV6_SUPPORT == ENABLED))
+   //Save the next-hop MAC address resolved while sending the datagram
+   if(!error && cacheable)
+   {
+      socketUpdateCachedRoute(socket, interface, &srcIpAddr,
+         &message->destIpAddr, &ancillary);
+   }
+#endif
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Send a UDP datagram
+ * @param[in] socket Handle referencing the socket
+ * @param[in] message Pointer to the structure describing the datagram
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t udpSendDatagram(Socket *socket, const SocketMsg *message, uint_t flags)
+{
+   error_t error;
+   size_t offset;
+   NetBuffer *buffer;
+   NetInterface *interface;
+
+   //Select the relevant network interface
+   if(message->interface != NULL)
+   {
+      interface = message->interface;
+   }
+   else
+   {
+      interface = socket->interface;
+   }
+
+#if (SOCKET_LOCK_SUPPORT == ENABLED)
+   //The socket lock is held by the caller, so the payload can be copied
+   //without blocking the TCP/IP stack (the memory pool has its own lock)
+   socket->lockHeld = FALSE;
+   osReleaseMutex(&netMutex);
+#endif
+
+   //Allocate a memory buffer to hold the UDP datagram
+   buffer = udpAllocBuffer(0, &offset);
+
+   //Successful memory allocation?
+   if(buffer != NULL)
+   {
+      //Copy data payload
+      error = netBufferAppend(buffer, message->data, message->length);
+   }
+   else
+   {
+      //Report an error
+      error = ERROR_OUT_OF_MEMORY;
+   }
+
+#if (SOCKET_LOCK_SUPPORT == ENABLED)
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   socket->lockHeld = TRUE;
 #endif
 
-#if (ETH_VMAN_SUPPORT == ENABLED)
-      //Set VMAN PCP and DEI fields
-      ancillary.vmanPcp = socket->vmanPcp;
-      ancillary.vmanDei = socket->vmanDei;
-#endif
+   //Failed to allocate buffer?
+   if(buffer == NULL)
+      return error;
+
+   //Successful processing?
+   if(!error)
+   {
+      //Send UDP datagram
+      error = udpSendDatagramBuffer(socket, interface, message, flags, buffer,
+         offset);
+   }
+
+   //Free previously allocated memory
+   netBufferFree(buffer);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Send a UDP datagram whose payload is loaned by the application
+ *
+ * The payload is referenced by the outgoing frame rather than copied. It
+ * must lie within a region registered with memPoolRegisterLoanRegion(), and
+ * is given back through the callback of the region once the frame no longer
+ * needs it. If an error is returned, the payload remains owned by the caller
+ *
+ * @param[in] socket Handle referencing the socket
+ * @param[in] message Pointer to the structure describing the datagram
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t udpSendLoanedDatagram(Socket *socket, const SocketMsg *message,
+   uint_t flags)
+{
+#if (NET_MEM_TX_LOAN_SUPPORT == ENABLED)
+   error_t error;
+   uint_t i;
+   size_t offset;
+   NetBuffer *buffer;
+   NetInterface *interface;
+
+   //Select the relevant network interface
+   if(message->interface != NULL)
+   {
+      interface = message->interface;
+   }
+   else
+   {
+      interface = socket->interface;
+   }
+
+   //Allocate a memory buffer to hold the UDP, IP and Ethernet headers
+   buffer = udpAllocBuffer(0, &offset);
+   //Failed to allocate buffer?
+   if(buffer == NULL)
+      return ERROR_OUT_OF_MEMORY;
 
-#if (ETH_PORT_TAGGING_SUPPORT == ENABLED)
-      //Set switch port identifier
-      ancillary.port = message->switchPort;
-#endif
+   //Index of the chunk that references the payload
+   i = buffer->chunkCount;
 
-#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
-      //Unique identifier for hardware time stamping
-      ancillary.timestampId = message->timestampId;
-#endif
+   //Append the payload without copying it
+   error = netBufferAppendLoan(buffer, message->data, message->length);
 
+   //Successful processing?
+   if(!error)
+   {
       //Send UDP datagram
-      error = udpSendBuffer(interface, &message->srcIpAddr, socket->localPort,
-         &message->destIpAddr, message->destPort, buffer, offset, &ancillary);
+      error = udpSendDatagramBuffer(socket, interface, message, flags, buffer,
+         offset);
+
+      //The payload must not be given back if the datagram was not sent
+      if(error)
+      {
+         buffer->chunk[i].size = 0;
+      }
    }
 
    //Free previously allocated memory
@@ -638,6 +1351,10 @@ error_t udpSendDatagram(Socket *socket, const SocketMsg *message, uint_t flags)
 
    //Return status code
    return error;
+#else
+   //Zero-copy transmission of loaned payloads is not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
 }
 
 
@@ -655,7 +1372,7 @@ error_t udpSendDatagram(Socket *socket, const SocketMsg *message, uint_t flags)
  * @return Error code
  **/
 
-error_t udpSendBuffer(NetInterface *interface, const IpAddr *srcIpAddr,
+__net_hot_func error_t udpSendBuffer(NetInterface *interface, const IpAddr *srcIpAddr,
    uint16_t srcPort, const IpAddr *destIpAddr, uint16_t destPort,
    NetBuffer *buffer, size_t offset, NetTxAncillary *ancillary)
 {
@@ -665,7 +1382,11 @@ error_t udpSendBuffer(NetInterface *interface, const IpAddr *srcIpAddr,
    IpPseudoHeader pseudoHeader;
 
    //Make room for the UDP header
-   offset -= sizeof(UdpHeader);
+   header = netBufferPush(buffer, &offset, sizeof(UdpHeader));
+   //Sanity check
+   if(header == NULL)
+      return ERROR_FAILURE;
+
    //Retrieve the length of the datagram
    length = netBufferGetLength(buffer) - offset;
 
@@ -673,12 +1394,6 @@ error_t udpSendBuffer(NetInterface *interface, const IpAddr *srcIpAddr,
    if(length > UINT16_MAX)
       return ERROR_INVALID_LENGTH;
 
-   //Point to the UDP header
-   header = netBufferAt(buffer, offset, sizeof(UdpHeader));
-   //Sanity check
-   if(header == NULL)
-      return ERROR_FAILURE;
-
    //Format UDP header
    header->srcPort = htons(srcPort);
    header->destPort = htons(destPort);
@@ -743,16 +1458,24 @@ error_t udpSendBuffer(NetInterface *interface, const IpAddr *srcIpAddr,
       //UDP checksum is optional for IPv4
       if(!ancillary->noChecksum)
       {
-         //Calculate UDP header checksum
-         header->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader.ipv4Data,
-            sizeof(Ipv4PseudoHeader), buffer, offset, length);
-
-         //If the computed checksum is zero, it is transmitted as all ones.
-         //An all zero transmitted checksum value means that the transmitter
-         //generated no checksum (refer to RFC 768)
-         if(header->checksum == 0)
+         //The checksum is inserted by the NIC when offload is active
+         if(ipv4IsChecksumOffloadEnabled(interface, length))
+         {
+            header->checksum = 0;
+         }
+         else
          {
-            header->checksum = 0xFFFF;
+            //Calculate UDP header checksum
+            header->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader.ipv4Data,
+               sizeof(Ipv4PseudoHeader), buffer, offset, length);
+
+            //If the computed checksum is zero, it is transmitted as all ones.
+            //An all zero transmitted checksum value means that the transmitter
+            //generated no checksum (refer to RFC 768)
+            if(header->checksum == 0)
+            {
+               header->checksum = 0xFFFF;
+            }
          }
       }
    }
@@ -816,6 +1539,7 @@ error_t udpSendBuffer(NetInterface *interface, const IpAddr *srcIpAddr,
 
    //Total number of UDP datagrams sent from this entity
    MIB2_UDP_INC_COUNTER32(udpOutDatagrams, 1);
+   NET_STATS_INC(udpOutDatagrams, 1);
    UDP_MIB_INC_COUNTER32(udpOutDatagrams, 1);
    UDP_MIB_INC_COUNTER64(udpHCOutDatagrams, 1);
 
@@ -833,85 +1557,133 @@ error_t udpSendBuffer(NetInterface *interface, const IpAddr *srcIpAddr,
 
 
 /**
- * @brief Receive data from a UDP socket
+ * @brief Wait for a datagram to be queued
  * @param[in] socket Handle referencing the socket
- * @param[out] message Received UDP datagram and ancillary data
  * @param[in] flags Set of flags that influences the behavior of this function
- * @return Error code
  **/
 
-error_t udpReceiveDatagram(Socket *socket, SocketMsg *message, uint_t flags)
+static void udpWaitForDatagram(Socket *socket, uint_t flags)
 {
-   error_t error;
-   SocketQueueItem *queueItem;
-
    //The SOCKET_FLAG_DONT_WAIT enables non-blocking operation
    if((flags & SOCKET_FLAG_DONT_WAIT) == 0)
    {
       //Check whether the receive queue is empty
       if(socket->receiveQueue == NULL)
       {
-         //Set the events the application is interested in
-         socket->eventMask = SOCKET_EVENT_RX_READY;
-
-         //Reset the event object
-         osResetEvent(&socket->event);
-
-         //Release exclusive access
-         osReleaseMutex(&netMutex);
          //Wait until an event is triggered
-         osWaitForEvent(&socket->event, socket->timeout);
-         //Get exclusive access
-         osAcquireMutex(&netMutex);
+         socketWaitForEvent(socket, SOCKET_EVENT_RX_READY, socket->timeout);
       }
    }
+}
 
-   //Any datagram received?
-   if(socket->receiveQueue != NULL)
-   {
-      //Point to the first item in the receive queue
-      queueItem = socket->receiveQueue;
-
-      //Copy data to user buffer
-      message->length = netBufferRead(message->data, queueItem->buffer,
-         queueItem->offset, message->size);
 
-      //Network interface where the packet was received
-      message->interface = queueItem->interface;
-      //Save the source IP address
-      message->srcIpAddr = queueItem->srcIpAddr;
-      //Save the source port number
-      message->srcPort = queueItem->srcPort;
-      //Save the destination IP address
-      message->destIpAddr = queueItem->destIpAddr;
+/**
+ * @brief Retrieve the addresses and ancillary data of a queued datagram
+ * @param[out] message Structure describing the datagram
+ * @param[in] queueItem Receive queue item
+ **/
 
-      //Save TTL value
-      message->ttl = queueItem->ancillary.ttl;
-      //Save ToS field
-      message->tos = queueItem->ancillary.tos;
+static void udpGetDatagramInfo(SocketMsg *message,
+   const SocketQueueItem *queueItem)
+{
+   //Network interface where the packet was received
+   message->interface = queueItem->interface;
+   //Save the source IP address
+   message->srcIpAddr = queueItem->srcIpAddr;
+   //Save the source port number
+   message->srcPort = queueItem->srcPort;
+   //Save the destination IP address
+   message->destIpAddr = queueItem->destIpAddr;
+
+   //Save TTL value
+   message->ttl = queueItem->ancillary.ttl;
+   //Save ToS field
+   message->tos = queueItem->ancillary.tos;
 
 #if (ETH_SUPPORT == ENABLED)
-      //Save source and destination MAC addresses
-      message->srcMacAddr = queueItem->ancillary.srcMacAddr;
-      message->destMacAddr = queueItem->ancillary.destMacAddr;
+   //Save source and destination MAC addresses
+   message->srcMacAddr = queueItem->ancillary.srcMacAddr;
+   message->destMacAddr = queueItem->ancillary.destMacAddr;
 #endif
 
 #if (ETH_PORT_TAGGING_SUPPORT == ENABLED)
-      //Save switch port identifier
-      message->switchPort = queueItem->ancillary.port;
+   //Save switch port identifier
+   message->switchPort = queueItem->ancillary.port;
 #endif
 
 #if (ETH_TIMESTAMP_SUPPORT == ENABLED)
-      //Save captured time stamp
-      message->timestamp = queueItem->ancillary.timestamp;
+   //Save captured time stamp
+   message->timestamp = queueItem->ancillary.timestamp;
+#endif
+
+#if (NIC_RX_TIME_SUPPORT == ENABLED)
+   //Save the receive time
+   message->rxTime = queueItem->ancillary.rxTime;
+#endif
+}
+
+
+/**
+ * @brief Receive data from a UDP socket
+ * @param[in] socket Handle referencing the socket
+ * @param[out] message Received UDP datagram and ancillary data
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t udpReceiveDatagram(Socket *socket, SocketMsg *message, uint_t flags)
+{
+   error_t error;
+   SocketQueueItem *queueItem;
+
+   //Wait for a datagram unless non-blocking operation is requested
+   udpWaitForDatagram(socket, flags);
+
+   //Any datagram received?
+   if(socket->receiveQueue != NULL)
+   {
+      //Point to the first item in the receive queue
+      queueItem = socket->receiveQueue;
+
+#if (SOCKET_LOCK_SUPPORT == ENABLED)
+      //Unless the data is only peeked, the item is unlinked from the receive
+      //queue before it is copied, so that the copy runs without the netMutex
+      if((flags & SOCKET_FLAG_PEEK) == 0)
+      {
+         //Remove the item from the receive queue
+         socket->receiveQueue = queueItem->next;
+
+         //Release exclusive access, keeping the socket lock
+         socket->lockHeld = FALSE;
+         osReleaseMutex(&netMutex);
+
+         //Copy data to user buffer
+         message->length = netBufferRead(message->data, queueItem->buffer,
+            queueItem->offset, message->size);
+
+         //Get exclusive access
+         osAcquireMutex(&netMutex);
+         socket->lockHeld = TRUE;
+      }
+      else
 #endif
+      {
+         //Copy data to user buffer
+         message->length = netBufferRead(message->data, queueItem->buffer,
+            queueItem->offset, message->size);
+      }
+
+      //Retrieve addresses and ancillary data
+      udpGetDatagramInfo(message, queueItem);
 
       //If the SOCKET_FLAG_PEEK flag is set, the data is copied into the
       //buffer but is not removed from the input queue
       if((flags & SOCKET_FLAG_PEEK) == 0)
       {
+#if (SOCKET_LOCK_SUPPORT == DISABLED)
          //Remove the item from the receive queue
          socket->receiveQueue = queueItem->next;
+#endif
 
          //Deallocate memory buffer
          netBufferFree(queueItem->buffer);
@@ -937,20 +1709,80 @@ error_t udpReceiveDatagram(Socket *socket, SocketMsg *message, uint_t flags)
 }
 
 
+/**
+ * @brief Take a datagram from a UDP socket without copying it
+ *
+ * The buffer holding the datagram is removed from the receive queue and
+ * handed to the caller, who must release it with socketReleaseBuffer() once
+ * the payload has been processed
+ *
+ * @param[in] socket Handle referencing the socket
+ * @param[out] message Addresses and ancillary data of the datagram. The data
+ *   field points to the payload when it is contiguous, else it is NULL
+ * @param[out] buffer Multi-part buffer holding the datagram
+ * @param[out] offset Offset to the payload within the buffer
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t udpReceiveBuffer(Socket *socket, SocketMsg *message,
+   NetBuffer **buffer, size_t *offset, uint_t flags)
+{
+   SocketQueueItem *queueItem;
+
+   //Wait for a datagram unless non-blocking operation is requested
+   udpWaitForDatagram(socket, flags);
+
+   //Empty receive queue?
+   if(socket->receiveQueue == NULL)
+   {
+      //Total number of data that have been received
+      message->length = 0;
+      //Report a timeout error
+      return ERROR_TIMEOUT;
+   }
+
+   //Remove the first item from the receive queue
+   queueItem = socket->receiveQueue;
+   socket->receiveQueue = queueItem->next;
+
+   //Retrieve addresses and ancillary data
+   udpGetDatagramInfo(message, queueItem);
+
+   //Length of the payload
+   message->length = netBufferGetLength(queueItem->buffer) - queueItem->offset;
+   message->size = message->length;
+   //Point to the payload, if contiguous
+   message->data = netBufferAt(queueItem->buffer, queueItem->offset,
+      message->length);
+
+   //The caller takes over the buffer
+   *buffer = queueItem->buffer;
+   *offset = queueItem->offset;
+
+   //Update the state of events
+   udpUpdateEvents(socket);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
 /**
  * @brief Allocate a buffer to hold a UDP packet
  * @param[in] length Desired payload length
  * @param[out] offset Offset to the first byte of the payload
+ * @param[in] tag Subsystem the buffer is charged to
  * @return The function returns a pointer to the newly allocated
  *   buffer. If the system is out of resources, NULL is returned
  **/
 
-NetBuffer *udpAllocBuffer(size_t length, size_t *offset)
+NetBuffer *udpAllocBufferTagged(size_t length, size_t *offset, uint8_t tag)
 {
    NetBuffer *buffer;
 
    //Allocate a buffer to hold the UDP header and the payload
-   buffer = ipAllocBuffer(length + sizeof(UdpHeader), offset);
+   buffer = ipAllocBufferTagged(length + sizeof(UdpHeader), offset, tag);
    //Failed to allocate buffer?
    if(buffer == NULL)
       return NULL;
@@ -991,6 +1823,11 @@ void udpUpdateEvents(Socket *socket)
       }
    }
 
+#if (SOCKET_POLL_SUPPORT == ENABLED)
+   //Queue the socket on the ready list of its poll set, if any
+   socketPollUpdate(socket, socket->eventFlags);
+#endif
+
    //Mask unused events
    socket->eventFlags &= socket->eventMask;
 
@@ -999,6 +1836,7 @@ void udpUpdateEvents(Socket *socket)
    {
       //Unblock I/O operations currently in waiting state
       osSetEvent(&socket->event);
+      socketNotifyWaiters(socket);
 
       //Set user event to signaled state if necessary
       if(socket->userEvent != NULL)
@@ -1009,6 +1847,40 @@ void udpUpdateEvents(Socket *socket)
 }
 
 
+/**
+ * @brief Signal the datagrams queued during an RX batch
+ **/
+
+void udpFlushPendingEvents(void)
+{
+#if (NIC_RX_BATCH_SUPPORT == ENABLED)
+   uint_t i;
+   Socket *socket;
+
+   //Loop through opened sockets
+   for(i = 0; i < SOCKET_MAX_COUNT; i++)
+   {
+      //Point to the current socket
+      socket = &socketTable[i];
+
+      //Any notification deferred?
+      if(socket->rxEventPending)
+      {
+         //Clear flag
+         socket->rxEventPending = FALSE;
+
+         //The socket may have been closed in the meantime
+         if(socket->type == SOCKET_TYPE_DGRAM)
+         {
+            //Notify user that data is available
+            udpUpdateEvents(socket);
+         }
+      }
+   }
+#endif
+}
+
+
 /**
  * @brief Register user callback
  * @param[in] interface Underlying network interface
@@ -1093,6 +1965,192 @@ error_t udpDetachRxCallback(NetInterface *interface, uint16_t port)
 }
 
 
+/**
+ * @brief Register a fast path handler
+ *
+ * Datagrams received on the specified port are passed to the handler in the
+ * context of the TCP/IP task, before the socket lookup and without being
+ * queued. The handler must not keep a reference to the buffer
+ *
+ * @param[in] interface Underlying network interface (NULL for any interface)
+ * @param[in] port UDP port number
+ * @param[in] callback Callback function to be called when a datagram is received
+ * @param[in] param Callback function parameter (optional)
+ * @return Error code
+ **/
+
+error_t udpRegisterFastPath(NetInterface *interface, uint16_t port,
+   UdpRxCallback callback, void *param)
+{
+#if (UDP_FAST_PATH_TABLE_SIZE > 0)
+   uint_t i;
+   uint_t index;
+   UdpFastPathEntry *entry;
+
+   //Check parameters
+   if(port == 0 || callback == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Follow the probe sequence of the port number
+   for(i = 0; i < UDP_FAST_PATH_TABLE_SIZE; i++)
+   {
+      //Point to the current entry
+      index = (port + i) & (UDP_FAST_PATH_TABLE_SIZE - 1);
+      entry = &udpFastPathTable[index];
+
+      //Unused or unregistered entry?
+      if(entry->callback == NULL)
+      {
+         //Create a new entry
+         entry->interface = interface;
+         entry->port = port;
+         entry->param = param;
+         entry->callback = callback;
+         //We are done
+         break;
+      }
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Failed to register the handler?
+   if(i >= UDP_FAST_PATH_TABLE_SIZE)
+      return ERROR_OUT_OF_RESOURCES;
+
+   //Successful processing
+   return NO_ERROR;
+#else
+   //Not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Unregister a fast path handler
+ * @param[in] interface Underlying network interface (NULL for any interface)
+ * @param[in] port UDP port number
+ * @return Error code
+ **/
+
+error_t udpUnregisterFastPath(NetInterface *interface, uint16_t port)
+{
+#if (UDP_FAST_PATH_TABLE_SIZE > 0)
+   error_t error;
+   uint_t i;
+   uint_t index;
+   UdpFastPathEntry *entry;
+
+   //Initialize status code
+   error = ERROR_FAILURE;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Follow the probe sequence of the port number
+   for(i = 0; i < UDP_FAST_PATH_TABLE_SIZE; i++)
+   {
+      //Point to the current entry
+      index = (port + i) & (UDP_FAST_PATH_TABLE_SIZE - 1);
+      entry = &udpFastPathTable[index];
+
+      //The end of the probe sequence has been reached?
+      if(entry->port == 0)
+         break;
+
+      //Matching entry?
+      if(entry->callback != NULL && entry->port == port &&
+         entry->interface == interface)
+      {
+         //Unregister the handler, the port number is kept so that entries
+         //further along the probe sequence can still be found
+         entry->callback = NULL;
+         //A matching entry has been found
+         error = NO_ERROR;
+      }
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return status code
+   return error;
+#else
+   //Not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Pass a datagram to the fast path handler of its destination port
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader UDP pseudo header
+ * @param[in] header UDP header
+ * @param[in] buffer Multi-part buffer containing the payload
+ * @param[in] offset Offset to the first byte of the payload
+ * @param[in] ancillary Additional options passed to the stack along with
+ *   the packet
+ * @return TRUE if the datagram has been consumed by a handler, else FALSE
+ **/
+
+bool_t udpInvokeFastPath(NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const UdpHeader *header,
+   const NetBuffer *buffer, size_t offset, const NetRxAncillary *ancillary)
+{
+#if (UDP_FAST_PATH_TABLE_SIZE > 0)
+   uint_t i;
+   uint_t index;
+   uint16_t port;
+   UdpFastPathEntry *entry;
+
+   //Get the destination port
+   port = ntohs(header->destPort);
+
+   //Follow the probe sequence of the port number
+   for(i = 0; i < UDP_FAST_PATH_TABLE_SIZE; i++)
+   {
+      //Point to the current entry
+      index = (port + i) & (UDP_FAST_PATH_TABLE_SIZE - 1);
+      entry = &udpFastPathTable[index];
+
+      //The end of the probe sequence has been reached?
+      if(entry->port == 0)
+         break;
+
+      //Matching entry?
+      if(entry->callback != NULL && entry->port == port &&
+         (entry->interface == NULL || entry->interface == interface))
+      {
+         //Data delivered to the application (latency instrumentation)
+         NET_LATENCY_MARK(NET_LATENCY_POINT_SOCKET);
+
+         //Invoke the handler
+         entry->callback(interface, pseudoHeader, header, buffer, offset,
+            ancillary, entry->param);
+
+         //Total number of UDP datagrams delivered to UDP users
+         MIB2_UDP_INC_COUNTER32(udpInDatagrams, 1);
+         NET_STATS_INC(udpInDatagrams, 1);
+         NET_STATS_INC(udpInFastPath, 1);
+         UDP_MIB_INC_COUNTER32(udpInDatagrams, 1);
+         UDP_MIB_INC_COUNTER64(udpHCInDatagrams, 1);
+
+         //The datagram has been consumed
+         return TRUE;
+      }
+   }
+#endif
+
+   //No handler registered on the destination port
+   return FALSE;
+}
+
+
 /**
  * @brief Invoke user callback
  * @param[in] interface Underlying network interface
@@ -1148,12 +2206,14 @@ error_t udpInvokeRxCallback(NetInterface *interface,
       //Total number of received UDP datagrams for which there was
       //no application at the destination port
       MIB2_UDP_INC_COUNTER32(udpNoPorts, 1);
+      NET_STATS_INC(udpNoPorts, 1);
       UDP_MIB_INC_COUNTER32(udpNoPorts, 1);
    }
    else
    {
       //Total number of UDP datagrams delivered to UDP users
       MIB2_UDP_INC_COUNTER32(udpInDatagrams, 1);
+      NET_STATS_INC(udpInDatagrams, 1);
       UDP_MIB_INC_COUNTER32(udpInDatagrams, 1);
       UDP_MIB_INC_COUNTER64(udpHCInDatagrams, 1);
    }
@@ -1168,7 +2228,7 @@ error_t udpInvokeRxCallback(NetInterface *interface,
  * @param[in] datagram Pointer to the UDP header
  **/
 
-void udpDumpHeader(const UdpHeader *datagram)
+__net_cold_func void udpDumpHeader(const UdpHeader *datagram)
 {
    //Dump UDP header contents
    TRACE_DEBUG("  Source Port = %" PRIu16 "\r\n", ntohs(datagram->srcPort));
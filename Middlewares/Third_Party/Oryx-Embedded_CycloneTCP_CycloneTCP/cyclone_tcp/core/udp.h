@@ -50,6 +50,21 @@
    #error UDP_CALLBACK_TABLE_SIZE parameter is not valid
 #endif
 
+//Size of the per-port fast path dispatch table (0 to disable)
+#ifndef UDP_FAST_PATH_TABLE_SIZE
+   #define UDP_FAST_PATH_TABLE_SIZE 0
+#elif (UDP_FAST_PATH_TABLE_SIZE < 0 || \
+   (UDP_FAST_PATH_TABLE_SIZE & (UDP_FAST_PATH_TABLE_SIZE - 1)) != 0)
+   #error UDP_FAST_PATH_TABLE_SIZE parameter is not valid
+#endif
+
+//Delivery of multicast datagrams to every socket sharing a port
+#ifndef UDP_SHARED_PORT_SUPPORT
+   #define UDP_SHARED_PORT_SUPPORT DISABLED
+#elif (UDP_SHARED_PORT_SUPPORT != ENABLED && UDP_SHARED_PORT_SUPPORT != DISABLED)
+   #error UDP_SHARED_PORT_SUPPORT parameter is not valid
+#endif
+
 //Receive queue depth for connectionless sockets
 #ifndef UDP_RX_QUEUE_SIZE
    #define UDP_RX_QUEUE_SIZE 4
@@ -57,6 +72,9 @@
    #error UDP_RX_QUEUE_SIZE parameter is not valid
 #endif
 
+//Buffer allocation charged to the subsystem of the caller (net_mem.h)
+#define udpAllocBuffer(length, offset) udpAllocBufferTagged(length, offset, NET_MEM_TAG())
+
 //C++ guard
 #ifdef __cplusplus
 extern "C" {
@@ -116,6 +134,22 @@ typedef struct
 } UdpRxCallbackEntry;
 
 
+/**
+ * @brief UDP fast path entry
+ *
+ * An entry whose port is set but callback is NULL has been unregistered and
+ * keeps the probe sequence of the following entries intact
+ **/
+
+typedef struct
+{
+   NetInterface *interface;
+   uint16_t port;
+   UdpRxCallback callback;
+   void *param;
+} UdpFastPathEntry;
+
+
 //Global variables
 extern UdpRxCallbackEntry udpCallbackTable[UDP_CALLBACK_TABLE_SIZE];
 
@@ -127,23 +161,59 @@ error_t udpProcessDatagram(NetInterface *interface,
    const IpPseudoHeader *pseudoHeader, const NetBuffer *buffer, size_t offset,
    const NetRxAncillary *ancillary);
 
+bool_t udpMatchSocket(Socket *socket, NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const UdpHeader *header);
+
+NetBuffer *udpAllocRxBuffer(const NetBuffer *buffer, size_t offset,
+   size_t length, bool_t *loaned);
+
+bool_t udpIsGroupDatagram(NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader);
+
+error_t udpDeliverSharedDatagram(NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const UdpHeader *header,
+   const NetBuffer *buffer, size_t offset, size_t length,
+   const NetRxAncillary *ancillary);
+
+uint_t udpGetRxQueueLength(Socket *socket);
+
+void udpQueueDatagram(Socket *socket, NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const UdpHeader *header,
+   NetBuffer *p, const NetRxAncillary *ancillary);
+
 error_t udpSendDatagram(Socket *socket, const SocketMsg *message, uint_t flags);
 
+error_t udpSendLoanedDatagram(Socket *socket, const SocketMsg *message,
+   uint_t flags);
+
 error_t udpSendBuffer(NetInterface *interface, const IpAddr *srcIpAddr,
    uint16_t srcPort, const IpAddr *destIpAddr, uint16_t destPort,
    NetBuffer *buffer, size_t offset, NetTxAncillary *ancillary);
 
 error_t udpReceiveDatagram(Socket *socket, SocketMsg *message, uint_t flags);
 
-NetBuffer *udpAllocBuffer(size_t length, size_t *offset);
+error_t udpReceiveBuffer(Socket *socket, SocketMsg *message,
+   NetBuffer **buffer, size_t *offset, uint_t flags);
+
+NetBuffer *udpAllocBufferTagged(size_t length, size_t *offset, uint8_t tag);
 
 void udpUpdateEvents(Socket *socket);
+void udpFlushPendingEvents(void);
 
 error_t udpAttachRxCallback(NetInterface *interface, uint16_t port,
    UdpRxCallback callback, void *param);
 
 error_t udpDetachRxCallback(NetInterface *interface, uint16_t port);
 
+error_t udpRegisterFastPath(NetInterface *interface, uint16_t port,
+   UdpRxCallback callback, void *param);
+
+error_t udpUnregisterFastPath(NetInterface *interface, uint16_t port);
+
+bool_t udpInvokeFastPath(NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const UdpHeader *header,
+   const NetBuffer *buffer, size_t offset, const NetRxAncillary *ancillary);
+
 error_t udpInvokeRxCallback(NetInterface *interface,
    const IpPseudoHeader *pseudoHeader, const UdpHeader *header,
    const NetBuffer *buffer, size_t offset, const NetRxAncillary *ancillary);
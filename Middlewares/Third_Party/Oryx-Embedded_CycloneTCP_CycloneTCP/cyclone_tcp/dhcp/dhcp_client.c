@@ -65,6 +65,8 @@ void dhcpClientGetDefaultSettings(DhcpClientSettings *settings)
    settings->rapidCommit = FALSE;
    //Use the DNS servers provided by the DHCP server
    settings->manualDnsConfig = FALSE;
+   //Probe the requested address only once the DHCPACK has been received
+   settings->parallelProbe = FALSE;
    //DHCP configuration timeout
    settings->timeout = 0;
 
@@ -79,6 +81,11 @@ void dhcpClientGetDefaultSettings(DhcpClientSettings *settings)
    settings->addOptionsCallback = NULL;
    //Parse DHCP options callback
    settings->parseOptionsCallback = NULL;
+
+   //Load DHCP lease callback
+   settings->loadLeaseCallback = NULL;
+   //Store DHCP lease callback
+   settings->storeLeaseCallback = NULL;
 }
 
 
@@ -135,6 +142,8 @@ error_t dhcpClientInit(DhcpClientContext *context,
 error_t dhcpClientStart(DhcpClientContext *context)
 {
    error_t error;
+   bool_t validLease;
+   DhcpClientLease lease;
    NetInterface *interface;
 
    //Make sure the DHCP client context is valid
@@ -144,6 +153,23 @@ error_t dhcpClientStart(DhcpClientContext *context)
    //Debug message
    TRACE_INFO("Starting DHCP client...\r\n");
 
+   //No saved lease yet
+   validLease = FALSE;
+
+   //Any registered callback?
+   if(context->settings.loadLeaseCallback != NULL)
+   {
+      //Retrieve the lease obtained before the last power-down or reboot
+      error = context->settings.loadLeaseCallback(context,
+         context->settings.interface, &lease);
+
+      //Check status code
+      if(!error && lease.ipAddr != IPV4_UNSPECIFIED_ADDR)
+      {
+         validLease = TRUE;
+      }
+   }
+
    //Get exclusive access
    osAcquireMutex(&netMutex);
 
@@ -156,8 +182,23 @@ error_t dhcpClientStart(DhcpClientContext *context)
       //Reset DHCP configuration
       dhcpClientResetConfig(context);
 
-      //Initialize state machine
-      context->state = DHCP_STATE_INIT;
+      //Client that already has a valid lease?
+      if(validLease)
+      {
+         //Request the previously allocated network address
+         context->requestedIpAddr = lease.ipAddr;
+         context->serverIpAddr = lease.serverIpAddr;
+         context->leaseTime = lease.leaseTime;
+
+         //The client starts in INIT-REBOOT state instead of INIT state
+         //(refer to RFC 2131, section 3.2)
+         context->state = DHCP_STATE_INIT_REBOOT;
+      }
+      else
+      {
+         //Initialize state machine
+         context->state = DHCP_STATE_INIT;
+      }
 
       //Register the callback function to be called whenever a UDP datagram
       //is received on port 68
@@ -268,6 +309,8 @@ error_t dhcpClientRelease(DhcpClientContext *context)
 
          //The host address is no longer valid
          dhcpClientResetConfig(context);
+         //The lease must not be requested again after a reboot
+         dhcpClientStoreLease(context, FALSE);
       }
 
       //Unregister callback function
@@ -58,6 +58,13 @@
    #error DHCP_CLIENT_INIT_DELAY parameter is not valid
 #endif
 
+//Random delay before sending the first message in INIT-REBOOT state
+#ifndef DHCP_CLIENT_INIT_REBOOT_DELAY
+   #define DHCP_CLIENT_INIT_REBOOT_DELAY DHCP_CLIENT_INIT_DELAY
+#elif (DHCP_CLIENT_INIT_REBOOT_DELAY < 0)
+   #error DHCP_CLIENT_INIT_REBOOT_DELAY parameter is not valid
+#endif
+
 //Initial retransmission timeout (DHCPDISCOVER)
 #ifndef DHCP_CLIENT_DISCOVER_INIT_RT
    #define DHCP_CLIENT_DISCOVER_INIT_RT 4000
@@ -169,6 +176,18 @@ typedef enum
 } DhcpState;
 
 
+/**
+ * @brief Saved DHCP lease
+ **/
+
+typedef struct
+{
+   Ipv4Addr ipAddr;       ///<Leased IPv4 address
+   Ipv4Addr serverIpAddr; ///<IPv4 address of the DHCP server
+   uint32_t leaseTime;    ///<Lease time, in seconds
+} DhcpClientLease;
+
+
 /**
  * @brief DHCP configuration timeout callback
  **/
@@ -209,6 +228,23 @@ typedef error_t (*DhcpClientParseOptionsCallback)(DhcpClientContext *context,
    const DhcpMessage *message, size_t length, DhcpMessageType type);
 
 
+/**
+ * @brief Load DHCP lease callback
+ **/
+
+typedef error_t (*DhcpClientLoadLeaseCallback)(DhcpClientContext *context,
+   NetInterface *interface, DhcpClientLease *lease);
+
+
+/**
+ * @brief Store DHCP lease callback (a NULL lease means the lease is no
+ *   longer valid)
+ **/
+
+typedef void (*DhcpClientStoreLeaseCallback)(DhcpClientContext *context,
+   NetInterface *interface, const DhcpClientLease *lease);
+
+
 /**
  * @brief DHCP client settings
  **/
@@ -219,12 +255,15 @@ typedef struct
    uint_t ipAddrIndex;                                  ///<Index of the IP address to be configured
    bool_t rapidCommit;                                  ///<Quick configuration using rapid commit
    bool_t manualDnsConfig;                              ///<Force manual DNS configuration
+   bool_t parallelProbe;                                ///<Probe the requested address while waiting for the DHCPACK
    systime_t timeout;                                   ///<DHCP configuration timeout
    DhcpClientTimeoutCallback timeoutEvent;              ///<DHCP configuration timeout event
    DhcpClientLinkChangeCallback linkChangeEvent;        ///<Link state change event
    DhcpClientStateChangeCallback stateChangeEvent;      ///<FSM state change event
    DhcpClientAddOptionsCallback addOptionsCallback;     ///<Add DHCP options callback
    DhcpClientParseOptionsCallback parseOptionsCallback; ///<Parse DHCP options callback
+   DhcpClientLoadLeaseCallback loadLeaseCallback;       ///<Load DHCP lease callback
+   DhcpClientStoreLeaseCallback storeLeaseCallback;     ///<Store DHCP lease callback
 } DhcpClientSettings;
 
 
@@ -250,6 +289,8 @@ struct _DhcpClientContext
    uint32_t leaseTime;          ///<Lease time
    uint32_t t1;                 ///<Time at which the client enters the RENEWING state
    uint32_t t2;                 ///<Time at which the client enters the REBINDING state
+   systime_t probeTimestamp;    ///<Time at which the ARP probe was sent in REBOOTING state
+   uint_t probeCount;           ///<Number of ARP probes sent in REBOOTING state
    DHCP_CLIENT_PRIVATE_CONTEXT  ///<Application specific context
 };
 
@@ -252,9 +252,9 @@ void dhcpClientStateInitReboot(DhcpClientContext *context)
       //Wait for the link to be up before starting DHCP configuration
       if(interface->linkState)
       {
-         //The client should wait for a random time to desynchronize
-         //the use of DHCP at startup
-         delay = netGenerateRandRange(0, DHCP_CLIENT_INIT_DELAY);
+         //The client already knows the address it wants to use, hence the
+         //random delay can be shorter than in INIT state
+         delay = netGenerateRandRange(0, DHCP_CLIENT_INIT_REBOOT_DELAY);
 
          //Record the time at which the client started the address
          //acquisition process
@@ -280,7 +280,14 @@ void dhcpClientStateInitReboot(DhcpClientContext *context)
 
 void dhcpClientStateRebooting(DhcpClientContext *context)
 {
+   uint_t i;
    systime_t time;
+   NetInterface *interface;
+
+   //Point to the underlying network interface
+   interface = context->settings.interface;
+   //Index of the IP address in the list of addresses assigned to the interface
+   i = context->settings.ipAddrIndex;
 
    //Get current time
    time = osGetSystemTime();
@@ -298,6 +305,29 @@ void dhcpClientStateRebooting(DhcpClientContext *context)
          //Send a DHCPREQUEST message
          dhcpClientSendRequest(context);
 
+         //No ARP probe has been sent yet
+         context->probeCount = 0;
+
+         //Probe the requested address while waiting for the DHCPACK?
+         if(context->settings.parallelProbe && DHCP_CLIENT_PROBE_NUM > 0)
+         {
+            //Use the requested address as a tentative address, so that any
+            //conflicting ARP packet is detected
+            interface->ipv4Context.addrList[i].addr = context->requestedIpAddr;
+            interface->ipv4Context.addrList[i].state = IPV4_ADDR_STATE_TENTATIVE;
+
+            //Clear conflict flag
+            interface->ipv4Context.addrList[i].conflict = FALSE;
+
+            //Conflict detection is done using ARP probes
+            arpSendProbe(interface, context->requestedIpAddr);
+
+            //Save the time at which the probe was sent
+            context->probeTimestamp = time;
+            //Increment probe counter
+            context->probeCount++;
+         }
+
          //Initial timeout value
          context->retransmitTimeout = DHCP_CLIENT_REQUEST_INIT_RT;
 
@@ -341,6 +371,12 @@ void dhcpClientStateRebooting(DhcpClientContext *context)
       }
       else
       {
+         //Discard the tentative address
+         if(context->probeCount > 0)
+         {
+            dhcpClientResetConfig(context);
+         }
+
          //If the client does not receive a response within a reasonable
          //period of time, then it restarts the initialization procedure
          dhcpClientChangeState(context, DHCP_STATE_INIT, 0);
@@ -387,6 +423,8 @@ void dhcpClientStateProbing(DhcpClientContext *context)
          //client must send a DHCPDECLINE message to the server and
          //restarts the configuration process
          dhcpClientSendDecline(context);
+         //The saved lease must not be requested again
+         dhcpClientStoreLease(context, FALSE);
 
          //The client should wait a minimum of ten seconds before
          //restarting the configuration process to avoid excessive
@@ -411,6 +449,8 @@ void dhcpClientStateProbing(DhcpClientContext *context)
       {
          //The use of the IPv4 address is now unrestricted
          interface->ipv4Context.addrList[i].state = IPV4_ADDR_STATE_VALID;
+         //Routes must be selected again
+         netInvalidateRoutes();
 
          //The client transitions to the ANNOUNCING state
          dhcpClientChangeState(context, DHCP_STATE_ANNOUNCING, 0);
@@ -470,6 +510,8 @@ void dhcpClientStateAnnouncing(DhcpClientContext *context)
 #endif
          //Dump current DHCP configuration for debugging purpose
          dhcpClientDumpConfig(context);
+         //Save the lease so that it can be reused after a reboot
+         dhcpClientStoreLease(context, TRUE);
 
          //The client transitions to the BOUND state
          dhcpClientChangeState(context, DHCP_STATE_BOUND, 0);
@@ -664,6 +706,8 @@ void dhcpClientStateRebinding(DhcpClientContext *context)
       {
          //The host address is no longer valid
          dhcpClientResetConfig(context);
+         //The saved lease has expired as well
+         dhcpClientStoreLease(context, FALSE);
 
 #if (MDNS_RESPONDER_SUPPORT == ENABLED)
          //Restart mDNS probing process
@@ -1097,7 +1097,21 @@ void dhcpClientParseAck(DhcpClientContext *context,
    context->leaseStartTime = osGetSystemTime();
 
    //Check current state
-   if(context->state == DHCP_STATE_REQUESTING ||
+   if(context->state == DHCP_STATE_REBOOTING && context->probeCount > 0 &&
+      message->yiaddr == interface->ipv4Context.addrList[i].addr)
+   {
+      //The requested address has been probed while waiting for the DHCPACK.
+      //The client resumes the probing process where it stands, instead of
+      //starting it over
+      dhcpClientChangeState(context, DHCP_STATE_PROBING, 0);
+
+      //Remaining time until the end of the current probe
+      context->timestamp = context->probeTimestamp;
+      context->timeout = DHCP_CLIENT_PROBE_DELAY;
+      //Number of probes already sent
+      context->retransmitCount = context->probeCount;
+   }
+   else if(context->state == DHCP_STATE_REQUESTING ||
       context->state == DHCP_STATE_REBOOTING)
    {
       //Use the IP address as a tentative address
@@ -1116,6 +1130,13 @@ void dhcpClientParseAck(DhcpClientContext *context,
       interface->ipv4Context.addrList[i].addr = message->yiaddr;
       interface->ipv4Context.addrList[i].state = IPV4_ADDR_STATE_VALID;
 
+      //New lease obtained through rapid commit?
+      if(context->state == DHCP_STATE_SELECTING)
+      {
+         //Save the lease so that it can be reused after a reboot
+         dhcpClientStoreLease(context, TRUE);
+      }
+
 #if (MDNS_RESPONDER_SUPPORT == ENABLED)
       //Restart mDNS probing process
       mdnsResponderStartProbing(interface->mdnsResponderContext);
@@ -1123,6 +1144,9 @@ void dhcpClientParseAck(DhcpClientContext *context,
       //The client transitions to the BOUND state
       dhcpClientChangeState(context, DHCP_STATE_BOUND, 0);
    }
+
+   //Routes must be selected again
+   netInvalidateRoutes();
 }
 
 
@@ -1193,6 +1217,8 @@ void dhcpClientParseNak(DhcpClientContext *context,
 
    //The host address is no longer appropriate for the link
    dhcpClientResetConfig(context);
+   //The saved lease must not be requested again
+   dhcpClientStoreLease(context, FALSE);
 
 #if (MDNS_RESPONDER_SUPPORT == ENABLED)
    //Restart mDNS probing process
@@ -1363,6 +1389,9 @@ void dhcpClientResetConfig(DhcpClientContext *context)
    //The default gateway is no longer valid
    interface->ipv4Context.addrList[i].defaultGateway = IPV4_UNSPECIFIED_ADDR;
 
+   //Routes must be selected again
+   netInvalidateRoutes();
+
    //Automatic DNS server configuration?
    if(!context->settings.manualDnsConfig)
    {
@@ -1376,6 +1405,40 @@ void dhcpClientResetConfig(DhcpClientContext *context)
 }
 
 
+/**
+ * @brief Save or invalidate the current lease
+ * @param[in] context Pointer to the DHCP client context
+ * @param[in] valid TRUE if the current lease is valid, FALSE if the saved
+ *   lease must be discarded
+ **/
+
+void dhcpClientStoreLease(DhcpClientContext *context, bool_t valid)
+{
+   DhcpClientLease lease;
+   NetInterface *interface;
+
+   //Any registered callback?
+   if(context->settings.storeLeaseCallback != NULL)
+   {
+      //Point to the underlying network interface
+      interface = context->settings.interface;
+
+      //Save the address that will be requested in INIT-REBOOT state
+      lease.ipAddr = context->requestedIpAddr;
+      lease.serverIpAddr = context->serverIpAddr;
+      lease.leaseTime = context->leaseTime;
+
+      //Release exclusive access
+      osReleaseMutex(&netMutex);
+      //Invoke user callback function
+      context->settings.storeLeaseCallback(context, interface,
+         valid ? &lease : NULL);
+      //Get exclusive access
+      osAcquireMutex(&netMutex);
+   }
+}
+
+
 /**
  * @brief Dump DHCP configuration for debugging purpose
  * @param[in] context Pointer to the DHCP client context
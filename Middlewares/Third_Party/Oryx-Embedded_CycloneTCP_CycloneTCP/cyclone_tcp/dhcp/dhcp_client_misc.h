@@ -74,6 +74,7 @@ void dhcpClientChangeState(DhcpClientContext *context,
    DhcpState newState, systime_t delay);
 
 void dhcpClientResetConfig(DhcpClientContext *context);
+void dhcpClientStoreLease(DhcpClientContext *context, bool_t valid);
 void dhcpClientDumpConfig(DhcpClientContext *context);
 
 //C++ guard
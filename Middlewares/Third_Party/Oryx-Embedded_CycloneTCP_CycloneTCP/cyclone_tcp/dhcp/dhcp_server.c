@@ -89,6 +89,8 @@ void dhcpServerGetDefaultSettings(DhcpServerSettings *settings)
    settings->addOptionsCallback = NULL;
    //Parse DHCP options callback
    settings->parseOptionsCallback = NULL;
+   //Store lease table callback
+   settings->storeLeasesCallback = NULL;
 }
 
 
@@ -128,6 +130,11 @@ error_t dhcpServerInit(DhcpServerContext *context,
 
    //Next IP address that will be assigned by the DHCP server
    context->nextIpAddr = settings->ipAddrRangeMin;
+
+   //The offer rate limit allows an initial burst
+   context->offerTokens = DHCP_SERVER_OFFER_BURST;
+   context->offerTokenTimestamp = osGetSystemTime();
+
    //DHCP server is currently suspended
    context->running = FALSE;
 
@@ -236,6 +243,208 @@ error_t dhcpServerStop(DhcpServerContext *context)
 }
 
 
+/**
+ * @brief Restore the leases saved before the last shutdown
+ *
+ * This function is typically called after dhcpServerInit, before the
+ * DHCP server is started, so that returning clients get the same address
+ * and that no address still leased is offered to another client
+ *
+ * @param[in] context Pointer to the DHCP server context
+ * @param[in] leases List of leases
+ * @param[in] count Number of entries in the list
+ * @return Error code
+ **/
+
+error_t dhcpServerImportLeases(DhcpServerContext *context,
+   const DhcpServerLease *leases, uint_t count)
+{
+   uint_t i;
+   systime_t time;
+   uint32_t elapsed;
+   DhcpServerBinding *binding;
+
+   //Check parameters
+   if(context == NULL || (leases == NULL && count != 0))
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //Loop through the list of leases
+   for(i = 0; i < count; i++)
+   {
+      //Skip expired leases and addresses that no longer belong to the pool
+      if(leases[i].remainingTime == 0 ||
+         macCompAddr(&leases[i].macAddr, &MAC_UNSPECIFIED_ADDR) ||
+         ntohl(leases[i].ipAddr) < ntohl(context->settings.ipAddrRangeMin) ||
+         ntohl(leases[i].ipAddr) > ntohl(context->settings.ipAddrRangeMax))
+      {
+         continue;
+      }
+
+      //Skip duplicate entries
+      if(dhcpServerFindBindingByMacAddr(context, &leases[i].macAddr) != NULL ||
+         dhcpServerFindBindingByIpAddr(context, leases[i].ipAddr) != NULL)
+      {
+         continue;
+      }
+
+      //Create a new binding
+      binding = dhcpServerCreateBinding(context, &leases[i].macAddr,
+         leases[i].ipAddr);
+
+      //No more room in the list?
+      if(binding == NULL)
+         break;
+
+      //The time spent while the system was down is unknown, so the lease is
+      //considered valid for its remaining time
+      elapsed = context->settings.leaseTime - MIN(leases[i].remainingTime,
+         context->settings.leaseTime);
+
+      //Commit network address
+      binding->validLease = TRUE;
+      binding->timestamp = time - MIN(elapsed, MAX_DELAY / 1000) * 1000;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Retrieve the committed leases
+ *
+ * This function is typically called from the context of the application
+ * after the store lease table callback has been invoked
+ *
+ * @param[in] context Pointer to the DHCP server context
+ * @param[out] leases List of leases
+ * @param[in] maxLeases Maximum number of entries in the list
+ * @param[out] count Number of leases written to the list
+ * @return Error code
+ **/
+
+error_t dhcpServerExportLeases(DhcpServerContext *context,
+   DhcpServerLease *leases, uint_t maxLeases, uint_t *count)
+{
+   uint_t i;
+   uint_t n;
+   systime_t time;
+   uint32_t elapsed;
+   DhcpServerBinding *binding;
+
+   //Check parameters
+   if(context == NULL || leases == NULL || count == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //Loop through the list of bindings
+   for(n = 0, i = 0; i < DHCP_SERVER_MAX_CLIENTS && n < maxLeases; i++)
+   {
+      //Point to the current binding
+      binding = &context->clientBinding[i];
+
+      //Only committed leases are saved
+      if(!macCompAddr(&binding->macAddr, &MAC_UNSPECIFIED_ADDR) &&
+         binding->validLease)
+      {
+         //Time elapsed since the lease was granted, in seconds
+         elapsed = (time - binding->timestamp) / 1000;
+
+         //Save the lease
+         leases[n].macAddr = binding->macAddr;
+         leases[n].ipAddr = binding->ipAddr;
+
+         //Remaining lease time
+         if(elapsed < context->settings.leaseTime)
+         {
+            leases[n].remainingTime = context->settings.leaseTime - elapsed;
+         }
+         else
+         {
+            leases[n].remainingTime = 0;
+         }
+
+         //Next entry
+         n++;
+      }
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return the number of leases
+   *count = n;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Retrieve DHCP server statistics
+ * @param[in] context Pointer to the DHCP server context
+ * @param[out] stats Snapshot of the statistics
+ * @return Error code
+ **/
+
+error_t dhcpServerGetStats(DhcpServerContext *context, DhcpServerStats *stats)
+{
+   uint_t i;
+   DhcpServerBinding *binding;
+
+   //Check parameters
+   if(context == NULL || stats == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Copy the counters
+   *stats = context->stats;
+   stats->bindings = 0;
+   stats->validLeases = 0;
+
+   //Loop through the list of bindings
+   for(i = 0; i < DHCP_SERVER_MAX_CLIENTS; i++)
+   {
+      //Point to the current binding
+      binding = &context->clientBinding[i];
+
+      //Valid binding?
+      if(!macCompAddr(&binding->macAddr, &MAC_UNSPECIFIED_ADDR))
+      {
+         //Count bindings and committed leases
+         stats->bindings++;
+
+         if(binding->validLease)
+         {
+            stats->validLeases++;
+         }
+      }
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
 /**
  * @brief Release DHCP server context
  * @param[in] context Pointer to the DHCP server context
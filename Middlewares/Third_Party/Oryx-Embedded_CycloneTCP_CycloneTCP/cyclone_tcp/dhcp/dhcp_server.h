@@ -69,6 +69,42 @@
    #error DHCP_SERVER_MAX_DNS_SERVERS parameter is not valid
 #endif
 
+//Size of the hash tables used to look up bindings
+#ifndef DHCP_SERVER_HASH_TABLE_SIZE
+   #define DHCP_SERVER_HASH_TABLE_SIZE 16
+#elif (DHCP_SERVER_HASH_TABLE_SIZE < 1 || \
+   (DHCP_SERVER_HASH_TABLE_SIZE & (DHCP_SERVER_HASH_TABLE_SIZE - 1)) != 0)
+   #error DHCP_SERVER_HASH_TABLE_SIZE parameter is not valid
+#endif
+
+//Maximum rate of DHCPOFFER messages, per second (0 means no limit)
+#ifndef DHCP_SERVER_OFFER_RATE_LIMIT
+   #define DHCP_SERVER_OFFER_RATE_LIMIT 0
+#elif (DHCP_SERVER_OFFER_RATE_LIMIT < 0)
+   #error DHCP_SERVER_OFFER_RATE_LIMIT parameter is not valid
+#endif
+
+//Number of DHCPOFFER messages that can be sent in a burst
+#ifndef DHCP_SERVER_OFFER_BURST
+   #define DHCP_SERVER_OFFER_BURST 8
+#elif (DHCP_SERVER_OFFER_BURST < 1)
+   #error DHCP_SERVER_OFFER_BURST parameter is not valid
+#endif
+
+//Minimum interval between two DHCPOFFER messages sent to the same client
+#ifndef DHCP_SERVER_OFFER_HOLDOFF
+   #define DHCP_SERVER_OFFER_HOLDOFF 0
+#elif (DHCP_SERVER_OFFER_HOLDOFF < 0)
+   #error DHCP_SERVER_OFFER_HOLDOFF parameter is not valid
+#endif
+
+//Delay before the lease table is stored after a change
+#ifndef DHCP_SERVER_STORE_DELAY
+   #define DHCP_SERVER_STORE_DELAY 5000
+#elif (DHCP_SERVER_STORE_DELAY < 0)
+   #error DHCP_SERVER_STORE_DELAY parameter is not valid
+#endif
+
 //Application specific context
 #ifndef DHCP_SERVER_PRIVATE_CONTEXT
    #define DHCP_SERVER_PRIVATE_CONTEXT
@@ -100,6 +136,13 @@ typedef error_t (*DhcpServerParseOptionsCallback)(DhcpServerContext *context,
    const DhcpMessage *message, size_t length, DhcpMessageType type);
 
 
+/**
+ * @brief Store lease table callback
+ **/
+
+typedef void (*DhcpServerStoreLeasesCallback)(DhcpServerContext *context);
+
+
 /**
  * @brief DHCP binding
  *
@@ -108,15 +151,54 @@ typedef error_t (*DhcpServerParseOptionsCallback)(DhcpServerContext *context,
  *
  **/
 
-typedef struct
+typedef struct _DhcpServerBinding
 {
-   MacAddr macAddr;     ///<Client's MAC address
-   Ipv4Addr ipAddr;     ///<Client's IPv4 address
-   bool_t validLease;   ///<Valid lease
-   systime_t timestamp; ///<Timestamp
+   MacAddr macAddr;                             ///<Client's MAC address
+   Ipv4Addr ipAddr;                             ///<Client's IPv4 address
+   bool_t validLease;                           ///<Valid lease
+   systime_t timestamp;                         ///<Timestamp
+   bool_t offerSent;                            ///<A DHCPOFFER message has been sent to the client
+   systime_t offerTimestamp;                    ///<Time at which the last DHCPOFFER message was sent
+   struct _DhcpServerBinding *nextByMacAddr;    ///<Next binding in the same MAC address hash bucket
+   struct _DhcpServerBinding *nextByIpAddr;     ///<Next binding in the same IP address hash bucket
 } DhcpServerBinding;
 
 
+/**
+ * @brief Lease, as saved to non-volatile memory
+ **/
+
+typedef struct
+{
+   MacAddr macAddr;        ///<Client's MAC address
+   Ipv4Addr ipAddr;        ///<Client's IPv4 address
+   uint32_t remainingTime; ///<Remaining lease time, in seconds
+} DhcpServerLease;
+
+
+/**
+ * @brief DHCP server statistics
+ **/
+
+typedef struct
+{
+   uint32_t discoverReceived;  ///<Number of DHCPDISCOVER messages received
+   uint32_t requestReceived;   ///<Number of DHCPREQUEST messages received
+   uint32_t declineReceived;   ///<Number of DHCPDECLINE messages received
+   uint32_t releaseReceived;   ///<Number of DHCPRELEASE messages received
+   uint32_t informReceived;    ///<Number of DHCPINFORM messages received
+   uint32_t offerSent;         ///<Number of DHCPOFFER messages sent
+   uint32_t ackSent;           ///<Number of DHCPACK messages sent
+   uint32_t nakSent;           ///<Number of DHCPNAK messages sent
+   uint32_t offerRateLimited;  ///<DHCPDISCOVER messages dropped by the offer rate limit
+   uint32_t offerHoldoff;      ///<Retransmitted DHCPDISCOVER messages dropped during the holdoff period
+   uint32_t poolExhausted;     ///<DHCPDISCOVER messages dropped for lack of address or binding
+   uint32_t leaseStores;       ///<Number of times the lease table was handed over for storage
+   uint_t bindings;            ///<Number of bindings in use
+   uint_t validLeases;         ///<Number of committed leases
+} DhcpServerStats;
+
+
 /**
  * @brief DHCP server settings
  **/
@@ -134,6 +216,7 @@ typedef struct
    Ipv4Addr dnsServer[DHCP_SERVER_MAX_DNS_SERVERS];     ///<DNS servers
    DhcpServerAddOptionsCallback addOptionsCallback;     ///<Add DHCP options callback
    DhcpServerParseOptionsCallback parseOptionsCallback; ///<Parse DHCP options callback
+   DhcpServerStoreLeasesCallback storeLeasesCallback;   ///<Store lease table callback
 } DhcpServerSettings;
 
 
@@ -147,6 +230,13 @@ struct _DhcpServerContext
    bool_t running;                                           ///<This flag tells whether the DHCP server is running or not
    Ipv4Addr nextIpAddr;                                      ///<Next IP address to be assigned
    DhcpServerBinding clientBinding[DHCP_SERVER_MAX_CLIENTS]; ///<List of bindings
+   DhcpServerBinding *macAddrTable[DHCP_SERVER_HASH_TABLE_SIZE]; ///<Bindings hashed by MAC address
+   DhcpServerBinding *ipAddrTable[DHCP_SERVER_HASH_TABLE_SIZE];  ///<Bindings hashed by IP address
+   uint_t offerTokens;                                       ///<DHCPOFFER messages that can be sent right now
+   systime_t offerTokenTimestamp;                            ///<Time at which the offer tokens were last refilled
+   bool_t leasesChanged;                                     ///<The lease table needs to be stored
+   systime_t leasesChangeTimestamp;                          ///<Time of the last change of the lease table
+   DhcpServerStats stats;                                    ///<Statistics
    DHCP_SERVER_PRIVATE_CONTEXT                               ///<Application specific context
 };
 
@@ -160,6 +250,14 @@ error_t dhcpServerInit(DhcpServerContext *context,
 error_t dhcpServerStart(DhcpServerContext *context);
 error_t dhcpServerStop(DhcpServerContext *context);
 
+error_t dhcpServerImportLeases(DhcpServerContext *context,
+   const DhcpServerLease *leases, uint_t count);
+
+error_t dhcpServerExportLeases(DhcpServerContext *context,
+   DhcpServerLease *leases, uint_t maxLeases, uint_t *count);
+
+error_t dhcpServerGetStats(DhcpServerContext *context, DhcpServerStats *stats);
+
 void dhcpServerDeinit(DhcpServerContext *context);
 
 //C++ guard
@@ -97,10 +97,34 @@ void dhcpServerTick(DhcpServerContext *context)
             {
                //The address lease is not more valid
                binding->validLease = FALSE;
+               //The lease table has changed
+               dhcpServerLeasesChanged(context);
             }
          }
       }
    }
+
+   //Changes are accumulated for a while, so that a burst of new leases
+   //(typically a mass power-on) results in a single write
+   if(context->leasesChanged &&
+      timeCompare(time, context->leasesChangeTimestamp + DHCP_SERVER_STORE_DELAY) >= 0)
+   {
+      //Any registered callback?
+      if(context->settings.storeLeasesCallback != NULL)
+      {
+         //The lease table is about to be stored
+         context->leasesChanged = FALSE;
+         //Update statistics
+         context->stats.leaseStores++;
+
+         //Release exclusive access
+         osReleaseMutex(&netMutex);
+         //Invoke user callback function
+         context->settings.storeLeasesCallback(context);
+         //Get exclusive access
+         osAcquireMutex(&netMutex);
+      }
+   }
 }
 
 
@@ -163,6 +187,9 @@ void dhcpServerProcessMessage(NetInterface *interface,
    //Check magic cookie
    if(message->magicCookie != HTONL(DHCP_MAGIC_COOKIE))
       return;
+   //The client hardware address identifies the binding
+   if(macCompAddr(&message->chaddr, &MAC_UNSPECIFIED_ADDR))
+      return;
 
    //Retrieve DHCP Message Type option
    option = dhcpGetOption(message, length, DHCP_OPT_DHCP_MESSAGE_TYPE);
@@ -189,26 +216,36 @@ void dhcpServerProcessMessage(NetInterface *interface,
    switch(type)
    {
    case DHCP_MSG_TYPE_DISCOVER:
+      //Update statistics
+      context->stats.discoverReceived++;
       //Parse DHCPDISCOVER message
       dhcpServerParseDiscover(context, message, length);
       break;
 
    case DHCP_MSG_TYPE_REQUEST:
+      //Update statistics
+      context->stats.requestReceived++;
       //Parse DHCPREQUEST message
       dhcpServerParseRequest(context, message, length);
       break;
 
    case DHCP_MSG_TYPE_DECLINE:
+      //Update statistics
+      context->stats.declineReceived++;
       //Parse DHCPDECLINE message
       dhcpServerParseDecline(context, message, length);
       break;
 
    case DHCP_MSG_TYPE_RELEASE:
+      //Update statistics
+      context->stats.releaseReceived++;
       //Parse DHCPRELEASE message
       dhcpServerParseRelease(context, message, length);
       break;
 
    case DHCP_MSG_TYPE_INFORM:
+      //Update statistics
+      context->stats.informReceived++;
       //Parse DHCPINFORM message
       dhcpServerParseInform(context, message, length);
       break;
@@ -232,7 +269,9 @@ void dhcpServerParseDiscover(DhcpServerContext *context,
 {
    error_t error;
    uint_t i;
+   systime_t time;
    NetInterface *interface;
+   Ipv4Addr ipAddr;
    Ipv4Addr requestedIpAddr;
    DhcpOption *option;
    DhcpServerBinding *binding;
@@ -267,9 +306,39 @@ void dhcpServerParseDiscover(DhcpServerContext *context,
       requestedIpAddr = IPV4_UNSPECIFIED_ADDR;
    }
 
+   //Get current time
+   time = osGetSystemTime();
+
    //Search the list for a matching binding
    binding = dhcpServerFindBindingByMacAddr(context, &message->chaddr);
 
+#if (DHCP_SERVER_OFFER_HOLDOFF > 0)
+   //A client that retransmits its DHCPDISCOVER message before the previous
+   //DHCPOFFER could reach it does not need another offer
+   if(binding != NULL && binding->offerSent)
+   {
+      //Check whether the holdoff period has elapsed
+      if(timeCompare(time, binding->offerTimestamp + DHCP_SERVER_OFFER_HOLDOFF) < 0)
+      {
+         //Update statistics
+         context->stats.offerHoldoff++;
+         //Drop the retransmitted message
+         return;
+      }
+   }
+#endif
+
+   //DHCPOFFER messages are paced so that, during a mass power-on, the
+   //DHCPREQUEST messages of the clients that already received an offer
+   //are not starved (DHCPREQUEST messages are never rate limited)
+   if(!dhcpServerCheckOfferRate(context))
+   {
+      //Update statistics
+      context->stats.offerRateLimited++;
+      //The client will retransmit its DHCPDISCOVER message
+      return;
+   }
+
    //Matching binding found?
    if(binding != NULL)
    {
@@ -283,10 +352,17 @@ void dhcpServerParseDiscover(DhcpServerContext *context,
             //Make sure the IP address is not already allocated
             if(!dhcpServerFindBindingByIpAddr(context, requestedIpAddr))
             {
+               //Committed lease?
+               if(binding->validLease)
+               {
+                  //The lease table has changed
+                  dhcpServerLeasesChanged(context);
+               }
+
                //Record IP address
-               binding->ipAddr = requestedIpAddr;
-               //Get current time
-               binding->timestamp = osGetSystemTime();
+               dhcpServerSetBindingIpAddr(context, binding, requestedIpAddr);
+               //Save current time
+               binding->timestamp = time;
             }
          }
       }
@@ -297,42 +373,40 @@ void dhcpServerParseDiscover(DhcpServerContext *context,
    else
    {
       //Create a new binding
-      binding = dhcpServerCreateBinding(context);
+      binding = dhcpServerCreateBinding(context, &message->chaddr,
+         IPV4_UNSPECIFIED_ADDR);
 
       //Binding successfully created
       if(binding != NULL)
       {
          //Ensure the IP address is in the server's pool of available addresses
          if(ntohl(requestedIpAddr) >= ntohl(context->settings.ipAddrRangeMin) &&
-            ntohl(requestedIpAddr) <= ntohl(context->settings.ipAddrRangeMax))
+            ntohl(requestedIpAddr) <= ntohl(context->settings.ipAddrRangeMax) &&
+            !dhcpServerFindBindingByIpAddr(context, requestedIpAddr))
          {
-            //Make sure the IP address is not already allocated
-            if(!dhcpServerFindBindingByIpAddr(context, requestedIpAddr))
-            {
-               //Record IP address
-               binding->ipAddr = requestedIpAddr;
-               //Successful processing
-               error = NO_ERROR;
-            }
-            else
-            {
-               //Retrieve the next available IP address from the pool of addresses
-               error = dhcpServerGetNextIpAddr(context, &binding->ipAddr);
-            }
+            //The requested IP address is available
+            ipAddr = requestedIpAddr;
+            //Successful processing
+            error = NO_ERROR;
          }
          else
          {
             //Retrieve the next available IP address from the pool of addresses
-            error = dhcpServerGetNextIpAddr(context, &binding->ipAddr);
+            error = dhcpServerGetNextIpAddr(context, &ipAddr);
          }
 
          //Check status code
          if(!error)
          {
-            //Record MAC address
-            binding->macAddr = message->chaddr;
-            //Get current time
-            binding->timestamp = osGetSystemTime();
+            //Record IP address
+            dhcpServerSetBindingIpAddr(context, binding, ipAddr);
+            //Save current time
+            binding->timestamp = time;
+         }
+         else
+         {
+            //Release the binding
+            dhcpServerDeleteBinding(context, binding);
          }
       }
       else
@@ -348,8 +422,21 @@ void dhcpServerParseDiscover(DhcpServerContext *context,
       //The server responds with a DHCPOFFER message that includes an
       //available network address in the 'yiaddr' field (and other
       //configuration parameters in DHCP options)
-      dhcpServerSendReply(context, DHCP_MSG_TYPE_OFFER, binding->ipAddr,
-         message, length);
+      error = dhcpServerSendReply(context, DHCP_MSG_TYPE_OFFER,
+         binding->ipAddr, message, length);
+
+      //Check status code
+      if(!error)
+      {
+         //Start the holdoff period
+         binding->offerSent = TRUE;
+         binding->offerTimestamp = time;
+      }
+   }
+   else
+   {
+      //Update statistics
+      context->stats.poolExhausted++;
    }
 }
 
@@ -420,6 +507,13 @@ void dhcpServerParseRequest(DhcpServerContext *context,
          //Make sure the client's IP address is valid
          if(clientIpAddr == binding->ipAddr)
          {
+            //New lease?
+            if(!binding->validLease)
+            {
+               //The lease table has changed
+               dhcpServerLeasesChanged(context);
+            }
+
             //Commit network address
             binding->validLease = TRUE;
             //Save lease start time
@@ -444,19 +538,18 @@ void dhcpServerParseRequest(DhcpServerContext *context,
             if(!dhcpServerFindBindingByIpAddr(context, clientIpAddr))
             {
                //Create a new binding
-               binding = dhcpServerCreateBinding(context);
+               binding = dhcpServerCreateBinding(context, &message->chaddr,
+                  clientIpAddr);
 
                //Binding successfully created
                if(binding != NULL)
                {
-                  //Record MAC address
-                  binding->macAddr = message->chaddr;
-                  //Record IP address
-                  binding->ipAddr = clientIpAddr;
                   //Commit network address
                   binding->validLease = TRUE;
                   //Get current time
                   binding->timestamp = osGetSystemTime();
+                  //The lease table has changed
+                  dhcpServerLeasesChanged(context);
 
                   //The server responds with a DHCPACK message containing the
                   //configuration parameters for the requesting client
@@ -510,8 +603,15 @@ void dhcpServerParseDecline(DhcpServerContext *context,
          //Check the IP address against the requested IP address
          if(binding->ipAddr == requestedIpAddr)
          {
-            //Remote the binding from the list
-            osMemset(binding, 0, sizeof(DhcpServerBinding));
+            //Committed lease?
+            if(binding->validLease)
+            {
+               //The lease table has changed
+               dhcpServerLeasesChanged(context);
+            }
+
+            //Remove the binding from the list
+            dhcpServerDeleteBinding(context, binding);
          }
       }
    }
@@ -537,10 +637,12 @@ void dhcpServerParseRelease(DhcpServerContext *context,
    if(binding != NULL)
    {
       //Check the IP address against the client IP address
-      if(binding->ipAddr == message->ciaddr)
+      if(binding->ipAddr == message->ciaddr && binding->validLease)
       {
          //Release the network address and cancel remaining lease
          binding->validLease = FALSE;
+         //The lease table has changed
+         dhcpServerLeasesChanged(context);
       }
    }
 }
@@ -781,6 +883,24 @@ error_t dhcpServerSendReply(DhcpServerContext *context, uint8_t type,
    error = udpSendBuffer(interface, &srcIpAddr, DHCP_SERVER_PORT, &destIpAddr,
       destPort, buffer, offset, &ancillary);
 
+   //Check status code
+   if(!error)
+   {
+      //Update statistics
+      if(type == DHCP_MSG_TYPE_OFFER)
+      {
+         context->stats.offerSent++;
+      }
+      else if(type == DHCP_MSG_TYPE_ACK)
+      {
+         context->stats.ackSent++;
+      }
+      else
+      {
+         context->stats.nakSent++;
+      }
+   }
+
    //Free previously allocated memory
    netBufferFree(buffer);
 
@@ -789,23 +909,98 @@ error_t dhcpServerSendReply(DhcpServerContext *context, uint8_t type,
 }
 
 
+/**
+ * @brief Check whether a DHCPOFFER message can be sent right now
+ * @param[in] context Pointer to the DHCP server context
+ * @return TRUE if the offer rate limit allows it, else FALSE
+ **/
+
+bool_t dhcpServerCheckOfferRate(DhcpServerContext *context)
+{
+#if (DHCP_SERVER_OFFER_RATE_LIMIT > 0)
+   uint_t n;
+   systime_t time;
+   systime_t delay;
+
+   //Get current time
+   time = osGetSystemTime();
+   //Time elapsed since the last refill
+   delay = time - context->offerTokenTimestamp;
+
+   //Token bucket algorithm
+   if(delay >= (DHCP_SERVER_OFFER_BURST * 1000 / DHCP_SERVER_OFFER_RATE_LIMIT))
+   {
+      //The bucket is full
+      context->offerTokens = DHCP_SERVER_OFFER_BURST;
+      context->offerTokenTimestamp = time;
+   }
+   else
+   {
+      //Number of tokens earned since the last refill
+      n = delay * DHCP_SERVER_OFFER_RATE_LIMIT / 1000;
+
+      //Any token earned?
+      if(n > 0)
+      {
+         //Refill the bucket
+         context->offerTokens = MIN(context->offerTokens + n,
+            DHCP_SERVER_OFFER_BURST);
+
+         //The remainder of the interval counts towards the next token
+         context->offerTokenTimestamp += n * 1000 / DHCP_SERVER_OFFER_RATE_LIMIT;
+      }
+   }
+
+   //No token left?
+   if(context->offerTokens == 0)
+      return FALSE;
+
+   //Consume one token
+   context->offerTokens--;
+#endif
+
+   //The DHCPOFFER message can be sent
+   return TRUE;
+}
+
+
+/**
+ * @brief Record a change of the lease table
+ * @param[in] context Pointer to the DHCP server context
+ **/
+
+void dhcpServerLeasesChanged(DhcpServerContext *context)
+{
+   //The lease table will be stored once it has not changed for
+   //DHCP_SERVER_STORE_DELAY milliseconds
+   context->leasesChanged = TRUE;
+   context->leasesChangeTimestamp = osGetSystemTime();
+}
+
+
 /**
  * @brief Create a new binding
  * @param[in] context Pointer to the DHCP server context
+ * @param[in] macAddr Client's MAC address
+ * @param[in] ipAddr Client's IP address (may be unspecified)
  * @return Pointer to the newly created binding
  **/
 
-DhcpServerBinding *dhcpServerCreateBinding(DhcpServerContext *context)
+DhcpServerBinding *dhcpServerCreateBinding(DhcpServerContext *context,
+   const MacAddr *macAddr, Ipv4Addr ipAddr)
 {
    uint_t i;
+   uint_t index;
    systime_t time;
    DhcpServerBinding *binding;
+   DhcpServerBinding *newBinding;
    DhcpServerBinding *oldestBinding;
 
    //Get current time
    time = osGetSystemTime();
 
    //Keep track of the oldest binding
+   newBinding = NULL;
    oldestBinding = NULL;
 
    //Loop through the list of bindings
@@ -819,8 +1014,9 @@ DhcpServerBinding *dhcpServerCreateBinding(DhcpServerContext *context)
       {
          //Erase contents
          osMemset(binding, 0, sizeof(DhcpServerBinding));
-         //Return a pointer to the newly created binding
-         return binding;
+         //This binding can be used
+         newBinding = binding;
+         break;
       }
       else
       {
@@ -840,15 +1036,116 @@ DhcpServerBinding *dhcpServerCreateBinding(DhcpServerContext *context)
       }
    }
 
-   //Any binding available in the list?
-   if(oldestBinding != NULL)
+   //No free binding in the list?
+   if(newBinding == NULL && oldestBinding != NULL)
+   {
+      //Reuse the oldest binding
+      dhcpServerDeleteBinding(context, oldestBinding);
+      newBinding = oldestBinding;
+   }
+
+   //Binding successfully created?
+   if(newBinding != NULL)
+   {
+      //Record MAC address
+      newBinding->macAddr = *macAddr;
+
+      //Insert the binding in the MAC address hash table
+      index = dhcpServerHashMacAddr(macAddr);
+      newBinding->nextByMacAddr = context->macAddrTable[index];
+      context->macAddrTable[index] = newBinding;
+
+      //Record IP address
+      dhcpServerSetBindingIpAddr(context, newBinding, ipAddr);
+   }
+
+   //Return a pointer to the newly created binding
+   return newBinding;
+}
+
+
+/**
+ * @brief Remove a binding from the list
+ * @param[in] context Pointer to the DHCP server context
+ * @param[in] binding Binding to be removed
+ **/
+
+void dhcpServerDeleteBinding(DhcpServerContext *context,
+   DhcpServerBinding *binding)
+{
+   DhcpServerBinding **p;
+
+   //Valid binding?
+   if(!macCompAddr(&binding->macAddr, &MAC_UNSPECIFIED_ADDR))
+   {
+      //Point to the relevant bucket of the MAC address hash table
+      p = &context->macAddrTable[dhcpServerHashMacAddr(&binding->macAddr)];
+
+      //Search the bucket for the binding
+      while(*p != NULL && *p != binding)
+      {
+         p = &(*p)->nextByMacAddr;
+      }
+
+      //Unlink the binding
+      if(*p != NULL)
+      {
+         *p = binding->nextByMacAddr;
+      }
+   }
+
+   //Remove the binding from the IP address hash table
+   dhcpServerSetBindingIpAddr(context, binding, IPV4_UNSPECIFIED_ADDR);
+
+   //Erase contents
+   osMemset(binding, 0, sizeof(DhcpServerBinding));
+}
+
+
+/**
+ * @brief Change the IP address associated with a binding
+ * @param[in] context Pointer to the DHCP server context
+ * @param[in] binding Pointer to the binding
+ * @param[in] ipAddr New IP address (may be unspecified)
+ **/
+
+void dhcpServerSetBindingIpAddr(DhcpServerContext *context,
+   DhcpServerBinding *binding, Ipv4Addr ipAddr)
+{
+   uint_t index;
+   DhcpServerBinding **p;
+
+   //The binding is currently associated with an IP address?
+   if(binding->ipAddr != IPV4_UNSPECIFIED_ADDR)
    {
-      //Erase contents
-      osMemset(oldestBinding, 0, sizeof(DhcpServerBinding));
+      //Point to the relevant bucket of the IP address hash table
+      p = &context->ipAddrTable[dhcpServerHashIpAddr(binding->ipAddr)];
+
+      //Search the bucket for the binding
+      while(*p != NULL && *p != binding)
+      {
+         p = &(*p)->nextByIpAddr;
+      }
+
+      //Unlink the binding
+      if(*p != NULL)
+      {
+         *p = binding->nextByIpAddr;
+      }
    }
 
-   //Return a pointer to the oldest binding
-   return oldestBinding;
+   //Record IP address
+   binding->ipAddr = ipAddr;
+   binding->nextByIpAddr = NULL;
+
+   //Valid IP address?
+   if(ipAddr != IPV4_UNSPECIFIED_ADDR)
+   {
+      //Insert the binding in the IP address hash table
+      index = dhcpServerHashIpAddr(ipAddr);
+      binding->nextByIpAddr = context->ipAddrTable[index];
+      context->ipAddrTable[index] = binding;
+   }
 }
 
 
@@ -862,25 +1159,23 @@ DhcpServerBinding *dhcpServerCreateBinding(DhcpServerContext *context)
 DhcpServerBinding *dhcpServerFindBindingByMacAddr(DhcpServerContext *context,
    const MacAddr *macAddr)
 {
-   uint_t i;
    DhcpServerBinding *binding;
 
-   //Loop through the list of bindings
-   for(i = 0; i < DHCP_SERVER_MAX_CLIENTS; i++)
-   {
-      //Point to the current binding
-      binding = &context->clientBinding[i];
+   //Point to the relevant bucket of the MAC address hash table
+   binding = context->macAddrTable[dhcpServerHashMacAddr(macAddr)];
 
-      //Valid binding?
-      if(!macCompAddr(&binding->macAddr, &MAC_UNSPECIFIED_ADDR))
+   //Loop through the bindings of the bucket
+   while(binding != NULL)
+   {
+      //Check whether the current binding matches the specified MAC address
+      if(macCompAddr(&binding->macAddr, macAddr))
       {
-         //Check whether the current binding matches the specified MAC address
-         if(macCompAddr(&binding->macAddr, macAddr))
-         {
-            //Return the pointer to the corresponding binding
-            return binding;
-         }
+         //Return the pointer to the corresponding binding
+         return binding;
       }
+
+      //Next binding
+      binding = binding->nextByMacAddr;
    }
 
    //No matching binding...
@@ -898,25 +1193,23 @@ DhcpServerBinding *dhcpServerFindBindingByMacAddr(DhcpServerContext *context,
 DhcpServerBinding *dhcpServerFindBindingByIpAddr(DhcpServerContext *context,
    Ipv4Addr ipAddr)
 {
-   uint_t i;
    DhcpServerBinding *binding;
 
-   //Loop through the list of bindings
-   for(i = 0; i < DHCP_SERVER_MAX_CLIENTS; i++)
-   {
-      //Point to the current binding
-      binding = &context->clientBinding[i];
+   //Point to the relevant bucket of the IP address hash table
+   binding = context->ipAddrTable[dhcpServerHashIpAddr(ipAddr)];
 
-      //Valid binding?
-      if(!macCompAddr(&binding->macAddr, &MAC_UNSPECIFIED_ADDR))
+   //Loop through the bindings of the bucket
+   while(binding != NULL)
+   {
+      //Check whether the current binding matches the specified IP address
+      if(binding->ipAddr == ipAddr)
       {
-         //Check whether the current binding matches the specified IP address
-         if(binding->ipAddr == ipAddr)
-         {
-            //Return the pointer to the corresponding binding
-            return binding;
-         }
+         //Return the pointer to the corresponding binding
+         return binding;
       }
+
+      //Next binding
+      binding = binding->nextByIpAddr;
    }
 
    //No matching binding...
@@ -924,6 +1217,43 @@ DhcpServerBinding *dhcpServerFindBindingByIpAddr(DhcpServerContext *context,
 }
 
 
+/**
+ * @brief Compute the hash of a MAC address
+ * @param[in] macAddr MAC address
+ * @return Index in the MAC address hash table
+ **/
+
+uint_t dhcpServerHashMacAddr(const MacAddr *macAddr)
+{
+   uint_t i;
+   uint32_t h;
+
+   //The last octets vary the most, they end up in the low-order bits, so
+   //that consecutive MAC addresses fall in different buckets
+   for(h = 0, i = 0; i < sizeof(MacAddr); i++)
+   {
+      h = (h * 33) + macAddr->b[i];
+   }
+
+   //Return the index of the bucket
+   return h & (DHCP_SERVER_HASH_TABLE_SIZE - 1);
+}
+
+
+/**
+ * @brief Compute the hash of an IP address
+ * @param[in] ipAddr IP address
+ * @return Index in the IP address hash table
+ **/
+
+uint_t dhcpServerHashIpAddr(Ipv4Addr ipAddr)
+{
+   //Addresses of the pool are allocated sequentially, hence the host part
+   //is a perfect hash
+   return ntohl(ipAddr) & (DHCP_SERVER_HASH_TABLE_SIZE - 1);
+}
+
+
 /**
  * @brief Retrieve the next IP address to be used
  * @param[in] context Pointer to the DHCP server context
@@ -69,7 +69,17 @@ void dhcpServerParseInform(DhcpServerContext *context,
 error_t dhcpServerSendReply(DhcpServerContext *context, uint8_t type,
    Ipv4Addr yourIpAddr, const DhcpMessage *request, size_t requestLen);
 
-DhcpServerBinding *dhcpServerCreateBinding(DhcpServerContext *context);
+bool_t dhcpServerCheckOfferRate(DhcpServerContext *context);
+void dhcpServerLeasesChanged(DhcpServerContext *context);
+
+DhcpServerBinding *dhcpServerCreateBinding(DhcpServerContext *context,
+   const MacAddr *macAddr, Ipv4Addr ipAddr);
+
+void dhcpServerDeleteBinding(DhcpServerContext *context,
+   DhcpServerBinding *binding);
+
+void dhcpServerSetBindingIpAddr(DhcpServerContext *context,
+   DhcpServerBinding *binding, Ipv4Addr ipAddr);
 
 DhcpServerBinding *dhcpServerFindBindingByMacAddr(DhcpServerContext *context,
    const MacAddr *macAddr);
@@ -79,6 +89,9 @@ DhcpServerBinding *dhcpServerFindBindingByIpAddr(DhcpServerContext *context,
 
 error_t dhcpServerGetNextIpAddr(DhcpServerContext *context, Ipv4Addr *ipAddr);
 
+uint_t dhcpServerHashMacAddr(const MacAddr *macAddr);
+uint_t dhcpServerHashIpAddr(Ipv4Addr ipAddr);
+
 //C++ guard
 #ifdef __cplusplus
 }
@@ -49,6 +49,91 @@
 systime_t dnsTickCounter;
 //DNS cache
 DnsCacheEntry dnsCache[DNS_CACHE_SIZE];
+//Hash buckets of the DNS cache (index of the first entry + 1)
+static uint8_t dnsHashTable[DNS_CACHE_HASH_SIZE];
+
+#if (NET_RTOS_SUPPORT == ENABLED)
+//Event signaled whenever a name resolution completes
+OsEvent dnsEvent;
+#endif
+
+
+/**
+ * @brief Compute the hash bucket of a domain name
+ * @param[in] name Domain name
+ * @return Index of the hash bucket
+ **/
+
+static uint_t dnsHashName(const char_t *name)
+{
+   uint32_t h;
+
+   //Domain names are case-insensitive (FNV-1a over lowercase characters)
+   for(h = 2166136261U; *name != '\0'; name++)
+   {
+      h = (h ^ (uint8_t) osTolower(*name)) * 16777619U;
+   }
+
+   //Return the index of the bucket
+   return h % DNS_CACHE_HASH_SIZE;
+}
+
+
+/**
+ * @brief Remove an entry from its hash bucket
+ * @param[in] entry Pointer to a DNS cache entry
+ **/
+
+static void dnsUnlinkEntry(DnsCacheEntry *entry)
+{
+   uint8_t *link;
+
+   //Point to the head of the bucket the entry belongs to
+   link = &dnsHashTable[dnsHashName(entry->name)];
+
+   //Search the bucket for the entry
+   while(*link != 0)
+   {
+      //Matching entry?
+      if(&dnsCache[*link - 1] == entry)
+      {
+         *link = entry->next;
+         entry->next = 0;
+         break;
+      }
+
+      //Point to the next link
+      link = &dnsCache[*link - 1].next;
+   }
+}
+
+
+/**
+ * @brief Notify the end of a name resolution
+ * @param[in] entry Pointer to a DNS cache entry
+ * @param[in] error Status of the name resolution
+ **/
+
+static void dnsNotifyEntry(DnsCacheEntry *entry, error_t error)
+{
+   DnsResolveCallback callback;
+
+   //The completion callback is invoked only once
+   callback = entry->callback;
+   entry->callback = NULL;
+
+   //Any registered callback?
+   if(callback != NULL)
+   {
+      callback(entry->interface, entry->name, entry->type, error,
+         (error == NO_ERROR) ? &entry->ipAddr : NULL, entry->param);
+   }
+
+#if (NET_RTOS_SUPPORT == ENABLED)
+   //Wake up a task waiting for a name resolution
+   osSetEvent(&dnsEvent);
+#endif
+}
 
 
 /**
@@ -60,6 +145,16 @@ error_t dnsInit(void)
 {
    //Initialize DNS cache
    osMemset(dnsCache, 0, sizeof(dnsCache));
+   osMemset(dnsHashTable, 0, sizeof(dnsHashTable));
+
+#if (NET_RTOS_SUPPORT == ENABLED)
+   //Create an event object to notify the completion of name resolutions
+   if(!osCreateEvent(&dnsEvent))
+   {
+      //Failed to create event
+      return ERROR_OUT_OF_RESOURCES;
+   }
+#endif
 
    //Successful initialization
    return NO_ERROR;
@@ -97,50 +192,117 @@ void dnsFlushCache(NetInterface *interface)
 
 /**
  * @brief Create a new entry in the DNS cache
+ * @param[in] name Domain name
  * @return Pointer to the newly created entry
  **/
 
-DnsCacheEntry *dnsCreateEntry(void)
+DnsCacheEntry *dnsCreateEntry(const char_t *name)
+{
+   //The entry is created for a lookup
+   return dnsCreateEntryEx(name, FALSE);
+}
+
+
+/**
+ * @brief Create a new entry in the DNS cache
+ *
+ * When the table is full, the oldest passive entry nobody has looked up is
+ * reused first. A passive entry (one created from an unsolicited answer)
+ * only ever replaces another such entry, so that the traffic seen on the
+ * link cannot evict the names the application resolves
+ *
+ * @param[in] name Domain name
+ * @param[in] passive The entry is created from an unsolicited answer
+ * @return Pointer to the newly created entry, or NULL if a passive entry
+ *   found no room
+ **/
+
+DnsCacheEntry *dnsCreateEntryEx(const char_t *name, bool_t passive)
 {
    uint_t i;
+   uint_t k;
    systime_t time;
    DnsCacheEntry *entry;
    DnsCacheEntry *oldestEntry;
+   DnsCacheEntry *oldestPassiveEntry;
 
    //Get current time
    time = osGetSystemTime();
 
-   //Keep track of the oldest entry
+   //Keep track of the oldest entries
    oldestEntry = &dnsCache[0];
+   oldestPassiveEntry = NULL;
+   entry = NULL;
 
    //Loop through DNS cache entries
    for(i = 0; i < DNS_CACHE_SIZE; i++)
    {
-      //Point to the current entry
-      entry = &dnsCache[i];
-
       //Check whether the entry is currently in use or not
-      if(entry->state == DNS_STATE_NONE)
+      if(dnsCache[i].state == DNS_STATE_NONE)
       {
-         //Erase contents
-         osMemset(entry, 0, sizeof(DnsCacheEntry));
-         //Return a pointer to the DNS entry
-         return entry;
+         entry = &dnsCache[i];
+         break;
       }
 
       //Keep track of the oldest entry in the table
-      if((time - entry->timestamp) > (time - oldestEntry->timestamp))
+      if((time - dnsCache[i].timestamp) > (time - oldestEntry->timestamp))
+      {
+         oldestEntry = &dnsCache[i];
+      }
+
+      //Keep track of the oldest passive entry not looked up
+      if(dnsCache[i].state == DNS_STATE_RESOLVED && dnsCache[i].passive &&
+         !dnsCache[i].used)
+      {
+         if(oldestPassiveEntry == NULL || (time - dnsCache[i].timestamp) >
+            (time - oldestPassiveEntry->timestamp))
+         {
+            oldestPassiveEntry = &dnsCache[i];
+         }
+      }
+   }
+
+   //An entry is removed whenever the table runs out of space
+   if(entry == NULL)
+   {
+      if(oldestPassiveEntry != NULL)
       {
-         oldestEntry = entry;
+         entry = oldestPassiveEntry;
       }
+      else if(!passive)
+      {
+         entry = oldestEntry;
+      }
+      else
+      {
+         //No room for a passive entry
+         return NULL;
+      }
+
+      dnsDeleteEntry(entry);
    }
 
-   //The oldest entry is removed whenever the table runs out of space
-   dnsDeleteEntry(oldestEntry);
+   //Free entries may still be linked to a hash bucket
+   dnsUnlinkEntry(entry);
+
    //Erase contents
-   osMemset(oldestEntry, 0, sizeof(DnsCacheEntry));
+   osMemset(entry, 0, sizeof(DnsCacheEntry));
+   //Record the host name
+   osStrncpy(entry->name, name, DNS_MAX_NAME_LEN);
+   entry->name[DNS_MAX_NAME_LEN] = '\0';
+   //Remember how the entry was created
+   entry->passive = passive;
+
+   //Insert the entry at the head of its hash bucket
+   k = dnsHashName(entry->name);
+   entry->next = dnsHashTable[k];
+   dnsHashTable[k] = (uint8_t) (entry - dnsCache + 1);
+
+   //The DNS cache must be ticked while it holds any entry
+   netScheduleTick(NET_TICK_MODULE_DNS, DNS_TICK_INTERVAL);
+
    //Return a pointer to the DNS entry
-   return oldestEntry;
+   return entry;
 }
 
 
@@ -152,27 +314,87 @@ DnsCacheEntry *dnsCreateEntry(void)
 void dnsDeleteEntry(DnsCacheEntry *entry)
 {
    //Make sure the specified entry is valid
-   if(entry != NULL)
+   if(entry != NULL && entry->state != DNS_STATE_NONE)
    {
-#if (DNS_CLIENT_SUPPORT == ENABLED || LLMNR_CLIENT_SUPPORT == ENABLED)
-      //DNS or LLMNR resolver?
-      if(entry->protocol == HOST_NAME_RESOLVER_DNS ||
-         entry->protocol == HOST_NAME_RESOLVER_LLMNR)
+      //Name resolution in progress?
+      if(entry->state == DNS_STATE_IN_PROGRESS)
       {
-         //Name resolution in progress?
-         if(entry->state == DNS_STATE_IN_PROGRESS)
+#if (DNS_CLIENT_SUPPORT == ENABLED || LLMNR_CLIENT_SUPPORT == ENABLED)
+         //DNS or LLMNR resolver?
+         if(entry->protocol == HOST_NAME_RESOLVER_DNS ||
+            entry->protocol == HOST_NAME_RESOLVER_LLMNR)
          {
             //Unregister user callback
             udpDetachRxCallback(entry->interface, entry->port);
          }
-      }
 #endif
+         //The pending name resolution is aborted
+         dnsNotifyEntry(entry, ERROR_FAILURE);
+      }
+
+      //Remove the entry from its hash bucket
+      dnsUnlinkEntry(entry);
+
       //Delete DNS cache entry
       entry->state = DNS_STATE_NONE;
    }
 }
 
 
+/**
+ * @brief Terminate the name resolution of a DNS cache entry
+ *
+ * On success, the entry must already hold the resolved address. On failure,
+ * DNS entries are kept as negative entries when the name does not exist or
+ * the servers did not answer, so that subsequent lookups fail immediately;
+ * other entries are deleted
+ *
+ * @param[in] entry Pointer to a DNS cache entry
+ * @param[in] error Status of the name resolution
+ **/
+
+void dnsCompleteEntry(DnsCacheEntry *entry, error_t error)
+{
+   //Successful name resolution?
+   if(!error)
+   {
+      //The refreshed address replaces the stale one
+      entry->stale = FALSE;
+      entry->used = FALSE;
+      //Notify the completion of the name resolution
+      dnsNotifyEntry(entry, NO_ERROR);
+   }
+#if (DNS_NEGATIVE_CACHE_SUPPORT == ENABLED && DNS_CLIENT_SUPPORT == ENABLED)
+   //Negative response or no response from the DNS servers?
+   else if(entry->protocol == HOST_NAME_RESOLVER_DNS && !entry->stale &&
+      (error == ERROR_NOT_FOUND || error == ERROR_TIMEOUT))
+   {
+      //Unregister user callback
+      if(entry->state == DNS_STATE_IN_PROGRESS)
+      {
+         udpDetachRxCallback(entry->interface, entry->port);
+      }
+
+      //Remember the failure for a while
+      entry->state = DNS_STATE_NEGATIVE;
+      entry->error = error;
+      entry->timestamp = osGetSystemTime();
+      entry->timeout = DNS_NEGATIVE_LIFETIME;
+
+      //Notify the completion of the name resolution
+      dnsNotifyEntry(entry, error);
+   }
+#endif
+   else
+   {
+      //Notify the completion of the name resolution
+      dnsNotifyEntry(entry, error);
+      //The entry should be deleted since name resolution has failed
+      dnsDeleteEntry(entry);
+   }
+}
+
+
 /**
  * @brief Search the DNS cache for a given domain name
  * @param[in] interface Underlying network interface
@@ -187,13 +409,26 @@ DnsCacheEntry *dnsFindEntry(NetInterface *interface,
    const char_t *name, HostType type, HostnameResolver protocol)
 {
    uint_t i;
+   uint_t n;
    DnsCacheEntry *entry;
 
-   //Loop through DNS cache entries
-   for(i = 0; i < DNS_CACHE_SIZE; i++)
+   //Without a domain name, the whole table must be searched
+   n = (name == NULL) ? DNS_CACHE_SIZE : dnsHashTable[dnsHashName(name)];
+
+   //Loop through the candidate DNS cache entries
+   for(i = 0; n != 0; )
    {
       //Point to the current entry
-      entry = &dnsCache[i];
+      if(name == NULL)
+      {
+         entry = &dnsCache[i++];
+         n--;
+      }
+      else
+      {
+         entry = &dnsCache[n - 1];
+         n = entry->next;
+      }
 
       //Make sure that the entry is currently in use
       if(entry->state == DNS_STATE_NONE)
@@ -230,6 +465,7 @@ void dnsTick(void)
    error_t error;
    uint_t i;
    systime_t time;
+   systime_t deadline;
    DnsCacheEntry *entry;
 
    //Get current time
@@ -303,8 +539,8 @@ void dnsTick(void)
                }
                else
                {
-                  //The entry should be deleted since name resolution has failed
-                  dnsDeleteEntry(entry);
+                  //The name resolution has failed
+                  dnsCompleteEntry(entry, error);
                }
             }
 #if (DNS_CLIENT_SUPPORT == ENABLED)
@@ -318,12 +554,13 @@ void dnsTick(void)
             else
             {
                //The maximum number of retransmissions has been exceeded
-               dnsDeleteEntry(entry);
+               dnsCompleteEntry(entry, ERROR_TIMEOUT);
             }
          }
       }
-      //Name successfully resolved?
-      else if(entry->state == DNS_STATE_RESOLVED)
+      //Name successfully resolved or negative entry?
+      else if(entry->state == DNS_STATE_RESOLVED ||
+         entry->state == DNS_STATE_NEGATIVE)
       {
          //Check the lifetime of the current DNS cache entry
          if(timeCompare(time, entry->timestamp + entry->timeout) >= 0)
@@ -331,6 +568,51 @@ void dnsTick(void)
             //Periodically time out DNS cache entries
             dnsDeleteEntry(entry);
          }
+#if (DNS_CACHE_PREFETCH_SUPPORT == ENABLED && DNS_CLIENT_SUPPORT == ENABLED)
+         //Entry in use and about to expire?
+         else if(entry->state == DNS_STATE_RESOLVED &&
+            entry->protocol == HOST_NAME_RESOLVER_DNS && entry->used &&
+            entry->timeout >= (2 * DNS_CACHE_PREFETCH_THRESHOLD) &&
+            timeCompare(time + DNS_CACHE_PREFETCH_THRESHOLD,
+            entry->timestamp + entry->timeout) >= 0)
+         {
+            //The current address is still served while it is refreshed
+            entry->stale = TRUE;
+
+            //Send a new DNS query ahead of expiry
+            if(dnsStartQuery(entry) != NO_ERROR)
+            {
+               //The entry will simply expire
+               entry->stale = FALSE;
+               entry->used = FALSE;
+            }
+         }
+#endif
+      }
+
+      //Any entry left in the cache?
+      if(entry->state != DNS_STATE_NONE)
+      {
+         //Time at which the entry times out or expires
+         deadline = entry->timestamp + entry->timeout;
+
+#if (DNS_CACHE_PREFETCH_SUPPORT == ENABLED && DNS_CLIENT_SUPPORT == ENABLED)
+         //Entries in use are refreshed ahead of expiry
+         if(entry->state == DNS_STATE_RESOLVED && entry->used &&
+            entry->timeout >= (2 * DNS_CACHE_PREFETCH_THRESHOLD))
+         {
+            deadline -= DNS_CACHE_PREFETCH_THRESHOLD;
+         }
+#endif
+         //Wake up when the earliest entry is due
+         if(timeCompare(deadline, time) > 0)
+         {
+            netScheduleTick(NET_TICK_MODULE_DNS, deadline - time);
+         }
+         else
+         {
+            netScheduleTick(NET_TICK_MODULE_DNS, DNS_TICK_INTERVAL);
+         }
       }
    }
 }
@@ -45,10 +45,45 @@
 //Size of DNS cache
 #ifndef DNS_CACHE_SIZE
    #define DNS_CACHE_SIZE 8
-#elif (DNS_CACHE_SIZE < 1)
+#elif (DNS_CACHE_SIZE < 1 || DNS_CACHE_SIZE > 255)
    #error DNS_CACHE_SIZE parameter is not valid
 #endif
 
+//Number of hash buckets of the DNS cache
+#ifndef DNS_CACHE_HASH_SIZE
+   #define DNS_CACHE_HASH_SIZE 16
+#elif (DNS_CACHE_HASH_SIZE < 1)
+   #error DNS_CACHE_HASH_SIZE parameter is not valid
+#endif
+
+//Negative caching support
+#ifndef DNS_NEGATIVE_CACHE_SUPPORT
+   #define DNS_NEGATIVE_CACHE_SUPPORT DISABLED
+#elif (DNS_NEGATIVE_CACHE_SUPPORT != ENABLED && DNS_NEGATIVE_CACHE_SUPPORT != DISABLED)
+   #error DNS_NEGATIVE_CACHE_SUPPORT parameter is not valid
+#endif
+
+//Lifetime of negative DNS cache entries
+#ifndef DNS_NEGATIVE_LIFETIME
+   #define DNS_NEGATIVE_LIFETIME 30000
+#elif (DNS_NEGATIVE_LIFETIME < 1000)
+   #error DNS_NEGATIVE_LIFETIME parameter is not valid
+#endif
+
+//Refresh-ahead (prefetch) support
+#ifndef DNS_CACHE_PREFETCH_SUPPORT
+   #define DNS_CACHE_PREFETCH_SUPPORT DISABLED
+#elif (DNS_CACHE_PREFETCH_SUPPORT != ENABLED && DNS_CACHE_PREFETCH_SUPPORT != DISABLED)
+   #error DNS_CACHE_PREFETCH_SUPPORT parameter is not valid
+#endif
+
+//Remaining lifetime below which a DNS cache entry is refreshed
+#ifndef DNS_CACHE_PREFETCH_THRESHOLD
+   #define DNS_CACHE_PREFETCH_THRESHOLD 10000
+#elif (DNS_CACHE_PREFETCH_THRESHOLD < 1000)
+   #error DNS_CACHE_PREFETCH_THRESHOLD parameter is not valid
+#endif
+
 //Maximum length of domain names
 #ifndef DNS_MAX_NAME_LEN
    #define DNS_MAX_NAME_LEN 63
@@ -85,10 +120,24 @@ typedef enum
    DNS_STATE_NONE        = 0,
    DNS_STATE_IN_PROGRESS = 1,
    DNS_STATE_RESOLVED    = 2,
-   DNS_STATE_PERMANENT   = 3
+   DNS_STATE_PERMANENT   = 3,
+   DNS_STATE_NEGATIVE    = 4
 } DnsState;
 
 
+/**
+ * @brief Name resolution completion callback
+ *
+ * The callback is invoked from the TCP/IP task with netMutex held. It must
+ * neither call blocking functions of the stack nor start a new resolution
+ *
+ **/
+
+typedef void (*DnsResolveCallback)(NetInterface *interface,
+   const char_t *name, HostType type, error_t error, const IpAddr *ipAddr,
+   void *param);
+
+
 /**
  * @brief DNS cache entry
  **/
@@ -100,6 +149,7 @@ typedef struct
    HostnameResolver protocol;         ///<Name resolution protocol
    NetInterface *interface;           ///<Underlying network interface
    uint_t dnsServerIndex;             ///<This parameter selects between the primary and secondary DNS server
+   uint32_t serverMask;               ///<DNS servers already queried
    uint16_t port;                     ///<Port number used by the resolver
    uint16_t id;                       ///<Identifier used to match queries and responses
    char_t name[DNS_MAX_NAME_LEN + 1]; ///<Domain name
@@ -108,20 +158,30 @@ typedef struct
    systime_t timeout;                 ///<Retransmission timeout
    systime_t maxTimeout;              ///<Maximum retransmission timeout
    uint_t retransmitCount;            ///<Retransmission counter
+   error_t error;                     ///<Cached error (negative entries)
+   bool_t stale;                      ///<The IP address is being refreshed
+   bool_t used;                       ///<The entry has been looked up since it was resolved
+   bool_t passive;                    ///<Created from an unsolicited answer
+   uint8_t next;                      ///<Next entry in the hash bucket (index + 1)
+   DnsResolveCallback callback;       ///<Completion callback
+   void *param;                       ///<Completion callback parameter
 } DnsCacheEntry;
 
 
 //Global variables
 extern systime_t dnsTickCounter;
 extern DnsCacheEntry dnsCache[DNS_CACHE_SIZE];
+extern OsEvent dnsEvent;
 
 //DNS related functions
 error_t dnsInit(void);
 
 void dnsFlushCache(NetInterface *interface);
 
-DnsCacheEntry *dnsCreateEntry(void);
+DnsCacheEntry *dnsCreateEntry(const char_t *name);
+DnsCacheEntry *dnsCreateEntryEx(const char_t *name, bool_t passive);
 void dnsDeleteEntry(DnsCacheEntry *entry);
+void dnsCompleteEntry(DnsCacheEntry *entry, error_t error);
 
 DnsCacheEntry *dnsFindEntry(NetInterface *interface,
    const char_t *name, HostType type, HostnameResolver protocol);
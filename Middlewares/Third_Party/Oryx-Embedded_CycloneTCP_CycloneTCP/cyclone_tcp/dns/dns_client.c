@@ -42,31 +42,288 @@
 //Check TCP/IP stack configuration
 #if (DNS_CLIENT_SUPPORT == ENABLED)
 
+//Number of IPv4 DNS servers
+#if (IPV4_SUPPORT == ENABLED)
+   #define DNS_IPV4_SERVER_COUNT IPV4_DNS_SERVER_LIST_SIZE
+#else
+   #define DNS_IPV4_SERVER_COUNT 0
+#endif
+
+//Number of IPv6 DNS servers
+#if (IPV6_SUPPORT == ENABLED)
+   #define DNS_IPV6_SERVER_COUNT IPV6_DNS_SERVER_LIST_SIZE
+#else
+   #define DNS_IPV6_SERVER_COUNT 0
+#endif
+
+//DNS servers are indexed with IPv4 servers first, then IPv6 servers
+#define DNS_SERVER_COUNT (DNS_IPV4_SERVER_COUNT + DNS_IPV6_SERVER_COUNT)
+
+//Round-trip time statistics of the DNS servers
+static DnsServerRtt dnsServerRttTable[DNS_CLIENT_RTT_TABLE_SIZE];
+
 
 /**
- * @brief Resolve a host name using DNS
+ * @brief Get the address of a DNS server
+ * @param[in] entry Pointer to a valid DNS cache entry
+ * @param[in] index Index of the DNS server
+ * @param[out] ipAddr IP address of the DNS server
+ * @return TRUE if the DNS server is configured and suits the entry
+ **/
+
+static bool_t dnsGetServerAddr(DnsCacheEntry *entry, uint_t index,
+   IpAddr *ipAddr)
+{
+#if (IPV4_SUPPORT == ENABLED)
+   //IPv4 DNS server?
+   if(index < DNS_IPV4_SERVER_COUNT)
+   {
+      //IPv4 DNS servers are queried for A records
+      if(entry->type != HOST_TYPE_IPV4 && entry->type != HOST_TYPE_ANY)
+         return FALSE;
+
+      //Copy the address of the DNS server
+      ipAddr->length = sizeof(Ipv4Addr);
+      ipAddr->ipv4Addr = entry->interface->ipv4Context.dnsServerList[index];
+
+      //Make sure the IP address is valid
+      return (ipAddr->ipv4Addr != IPV4_UNSPECIFIED_ADDR);
+   }
+#endif
+
+#if (IPV6_SUPPORT == ENABLED)
+   //IPv6 DNS server?
+   if(index >= DNS_IPV4_SERVER_COUNT && index < DNS_SERVER_COUNT)
+   {
+      //IPv6 DNS servers are queried for AAAA records
+      if(entry->type != HOST_TYPE_IPV6 && entry->type != HOST_TYPE_ANY)
+         return FALSE;
+
+      //Copy the address of the DNS server
+      ipAddr->length = sizeof(Ipv6Addr);
+      ipAddr->ipv6Addr = entry->interface->ipv6Context.dnsServerList[index -
+         DNS_IPV4_SERVER_COUNT];
+
+      //Make sure the IP address is valid
+      return !ipv6CompAddr(&ipAddr->ipv6Addr, &IPV6_UNSPECIFIED_ADDR);
+   }
+#endif
+
+   //Out of range index
+   return FALSE;
+}
+
+
+/**
+ * @brief Get the smoothed round-trip time of a DNS server
+ * @param[in] ipAddr IP address of the DNS server
+ * @return Smoothed round-trip time, in milliseconds
+ **/
+
+static systime_t dnsGetServerRtt(const IpAddr *ipAddr)
+{
+   uint_t i;
+   DnsServerRtt *stats;
+
+   //Loop through the round-trip time statistics
+   for(i = 0; i < DNS_CLIENT_RTT_TABLE_SIZE; i++)
+   {
+      //Point to the current entry
+      stats = &dnsServerRttTable[i];
+
+      //Recent measurement for this DNS server?
+      if(stats->srtt != 0 && ipCompAddr(&stats->ipAddr, ipAddr) &&
+         timeCompare(osGetSystemTime(), stats->timestamp +
+         DNS_CLIENT_RTT_LIFETIME) < 0)
+      {
+         return stats->srtt;
+      }
+   }
+
+   //Servers with an unknown round-trip time rank behind servers known to
+   //answer quickly, and ahead of servers known to time out
+   return DNS_CLIENT_INIT_TIMEOUT / 2;
+}
+
+
+/**
+ * @brief Update the smoothed round-trip time of a DNS server
+ * @param[in] ipAddr IP address of the DNS server
+ * @param[in] rtt Round-trip time sample, or timeout value
+ * @param[in] timeout The DNS server did not answer in time
+ **/
+
+static void dnsUpdateServerRtt(const IpAddr *ipAddr, systime_t rtt,
+   bool_t timeout)
+{
+   uint_t i;
+   systime_t time;
+   DnsServerRtt *stats;
+   DnsServerRtt *oldestStats;
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //Keep track of the oldest entry
+   oldestStats = &dnsServerRttTable[0];
+
+   //Search the table for the DNS server
+   for(i = 0; i < DNS_CLIENT_RTT_TABLE_SIZE; i++)
+   {
+      //Point to the current entry
+      stats = &dnsServerRttTable[i];
+
+      //Matching entry?
+      if(stats->srtt != 0 && ipCompAddr(&stats->ipAddr, ipAddr))
+         break;
+
+      //Unused entries are reused first, then the oldest one
+      if(oldestStats->srtt != 0 && (stats->srtt == 0 ||
+         (time - stats->timestamp) > (time - oldestStats->timestamp)))
+      {
+         oldestStats = stats;
+      }
+   }
+
+   //DNS server with a recent measurement?
+   if(i < DNS_CLIENT_RTT_TABLE_SIZE &&
+      timeCompare(time, stats->timestamp + DNS_CLIENT_RTT_LIFETIME) < 0)
+   {
+      //A timeout at least doubles the estimate, whereas a sample is
+      //smoothed with a gain of 1/8 (refer to RFC 6298)
+      if(timeout)
+      {
+         stats->srtt = MIN(MAX(stats->srtt * 2, rtt), DNS_CLIENT_RTT_LIFETIME);
+      }
+      else
+      {
+         stats->srtt = (7 * stats->srtt + rtt) / 8;
+      }
+   }
+   else
+   {
+      //Point to the entry to be (re)initialized
+      if(i >= DNS_CLIENT_RTT_TABLE_SIZE)
+      {
+         stats = oldestStats;
+      }
+
+      //The first sample initializes the estimate
+      stats->ipAddr = *ipAddr;
+      stats->srtt = rtt;
+   }
+
+   //Zero is reserved for unused entries
+   stats->srtt = MAX(stats->srtt, 1);
+   //Save the time of the update
+   stats->timestamp = time;
+}
+
+
+/**
+ * @brief Retrieve the address a DNS response was sent from
+ * @param[in] pseudoHeader UDP pseudo header
+ * @param[out] ipAddr Source IP address
+ * @return TRUE on success, FALSE otherwise
+ **/
+
+static bool_t dnsGetResponseAddr(const IpPseudoHeader *pseudoHeader,
+   IpAddr *ipAddr)
+{
+#if (IPV4_SUPPORT == ENABLED)
+   //IPv4 response?
+   if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
+   {
+      ipAddr->length = sizeof(Ipv4Addr);
+      ipAddr->ipv4Addr = pseudoHeader->ipv4Data.srcAddr;
+      return TRUE;
+   }
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   //IPv6 response?
+   if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
+   {
+      ipAddr->length = sizeof(Ipv6Addr);
+      ipAddr->ipv6Addr = pseudoHeader->ipv6Data.srcAddr;
+      return TRUE;
+   }
+#endif
+
+   //Unknown pseudo header
+   return FALSE;
+}
+
+
+/**
+ * @brief Select the fastest DNS server not yet queried
+ * @param[in] entry Pointer to a valid DNS cache entry
+ * @return Error code
+ **/
+
+static error_t dnsSelectServer(DnsCacheEntry *entry)
+{
+   uint_t i;
+   systime_t rtt;
+   systime_t bestRtt;
+   IpAddr ipAddr;
+   error_t error;
+
+   //Initialize status code
+   error = ERROR_NO_DNS_SERVER;
+   bestRtt = 0;
+
+   //Loop through the DNS servers, in list order for equal round-trip times
+   for(i = 0; i < DNS_SERVER_COUNT; i++)
+   {
+      //Skip the DNS servers that have already been queried
+      if((entry->serverMask & (1U << i)) != 0)
+         continue;
+
+      //Skip the DNS servers that are not configured
+      if(!dnsGetServerAddr(entry, i, &ipAddr))
+         continue;
+
+      //Keep track of the fastest DNS server
+      rtt = dnsGetServerRtt(&ipAddr);
+
+      if(error || rtt < bestRtt)
+      {
+         entry->dnsServerIndex = i;
+         bestRtt = rtt;
+         error = NO_ERROR;
+      }
+   }
+
+   //Check status code
+   if(!error)
+   {
+      //The DNS server is now queried
+      entry->serverMask |= 1U << entry->dnsServerIndex;
+   }
+
+   //Return status code
+   return error;
+}
+
+
+
+/**
+ * @brief Look up the DNS cache and start a name resolution if necessary
  * @param[in] interface Underlying network interface
  * @param[in] name Name of the host to be resolved
  * @param[in] type Host type (IPv4 or IPv6)
  * @param[out] ipAddr IP address corresponding to the specified host name
+ * @param[in] callback Completion callback (optional)
+ * @param[in] param Callback function parameter
+ * @return Error code
  **/
 
-error_t dnsResolve(NetInterface *interface, const char_t *name,
-   HostType type, IpAddr *ipAddr)
+static error_t dnsLookup(NetInterface *interface, const char_t *name,
+   HostType type, IpAddr *ipAddr, DnsResolveCallback callback, void *param)
 {
    error_t error;
    DnsCacheEntry *entry;
 
-#if (NET_RTOS_SUPPORT == ENABLED)
-   systime_t delay;
-
-   //Debug message
-   TRACE_INFO("Resolving host name %s (DNS resolver)...\r\n", name);
-#endif
-
-   //Get exclusive access
-   osAcquireMutex(&netMutex);
-
    //Search the DNS cache for the specified host name
    entry = dnsFindEntry(interface, name, type, HOST_NAME_RESOLVER_DNS);
 
@@ -75,15 +332,35 @@ error_t dnsResolve(NetInterface *interface, const char_t *name,
    {
       //Host name already resolved?
       if(entry->state == DNS_STATE_RESOLVED ||
-         entry->state == DNS_STATE_PERMANENT)
+         entry->state == DNS_STATE_PERMANENT ||
+         (entry->state == DNS_STATE_IN_PROGRESS && entry->stale))
       {
          //Return the corresponding IP address
          *ipAddr = entry->ipAddr;
+         //The entry is worth refreshing before it expires
+         entry->used = TRUE;
          //Successful host name resolution
          error = NO_ERROR;
       }
+      else if(entry->state == DNS_STATE_NEGATIVE)
+      {
+         //The name resolution failed recently
+         error = entry->error;
+      }
+      else if(callback != NULL && entry->callback != NULL)
+      {
+         //Only one completion callback can be registered per entry
+         error = ERROR_ALREADY_RUNNING;
+      }
       else
       {
+         //Register the completion callback, if any
+         if(callback != NULL)
+         {
+            entry->callback = callback;
+            entry->param = param;
+         }
+
          //Host name resolution is in progress
          error = ERROR_IN_PROGRESS;
       }
@@ -91,62 +368,58 @@ error_t dnsResolve(NetInterface *interface, const char_t *name,
    else
    {
       //If no entry exists, then create a new one
-      entry = dnsCreateEntry();
-
-      //Record the host name whose IP address is unknown
-      osStrcpy(entry->name, name);
+      entry = dnsCreateEntry(name);
 
       //Initialize DNS cache entry
       entry->type = type;
       entry->protocol = HOST_NAME_RESOLVER_DNS;
       entry->interface = interface;
 
-      //Select primary DNS server
-      entry->dnsServerIndex = 0;
-
-      //Get an ephemeral port number
-      entry->port = udpGetDynamicPort();
+      //Send DNS query
+      error = dnsStartQuery(entry);
 
-      //An identifier is used by the DNS client to match replies with
-      //corresponding requests
-      entry->id = (uint16_t) netGenerateRand();
-
-      //Callback function to be called when a DNS response is received
-      error = udpAttachRxCallback(interface, entry->port, dnsProcessResponse,
-         NULL);
-
-      //Check status code
+      //DNS message successfully sent?
       if(!error)
       {
-         //Initialize retransmission counter
-         entry->retransmitCount = DNS_CLIENT_MAX_RETRIES;
-         //Send DNS query
-         error = dnsSendQuery(entry);
+         //Register the completion callback, if any
+         entry->callback = callback;
+         entry->param = param;
 
-         //DNS message successfully sent?
-         if(!error)
-         {
-            //Save the time at which the query message was sent
-            entry->timestamp = osGetSystemTime();
-            //Set timeout value
-            entry->timeout = DNS_CLIENT_INIT_TIMEOUT;
-            entry->maxTimeout = DNS_CLIENT_MAX_TIMEOUT;
-            //Decrement retransmission counter
-            entry->retransmitCount--;
-
-            //Switch state
-            entry->state = DNS_STATE_IN_PROGRESS;
-            //Host name resolution is in progress
-            error = ERROR_IN_PROGRESS;
-         }
-         else
-         {
-            //Unregister callback function
-            udpDetachRxCallback(interface, entry->port);
-         }
+         //Host name resolution is in progress
+         error = ERROR_IN_PROGRESS;
       }
    }
 
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Resolve a host name using DNS
+ * @param[in] interface Underlying network interface
+ * @param[in] name Name of the host to be resolved
+ * @param[in] type Host type (IPv4 or IPv6)
+ * @param[out] ipAddr IP address corresponding to the specified host name
+ **/
+
+error_t dnsResolve(NetInterface *interface, const char_t *name,
+   HostType type, IpAddr *ipAddr)
+{
+   error_t error;
+
+#if (NET_RTOS_SUPPORT == ENABLED)
+   systime_t delay;
+   DnsCacheEntry *entry;
+
+   //Debug message
+   TRACE_INFO("Resolving host name %s (DNS resolver)...\r\n", name);
+#endif
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Search the DNS cache and send a DNS query if necessary
+   error = dnsLookup(interface, name, type, ipAddr, NULL, NULL);
    //Release exclusive access
    osReleaseMutex(&netMutex);
 
@@ -157,8 +430,9 @@ error_t dnsResolve(NetInterface *interface, const char_t *name,
    //Wait the host name resolution to complete
    while(error == ERROR_IN_PROGRESS)
    {
-      //Wait until the next polling period
-      osDelayTask(delay);
+      //Wait for a name resolution to complete. Several tasks may be waiting,
+      //so the polling period bounds the delay of those not woken up
+      osWaitForEvent(&dnsEvent, delay);
 
       //Get exclusive access
       osAcquireMutex(&netMutex);
@@ -170,13 +444,19 @@ error_t dnsResolve(NetInterface *interface, const char_t *name,
       if(entry != NULL)
       {
          //Host name successfully resolved?
-         if(entry->state == DNS_STATE_RESOLVED)
+         if(entry->state == DNS_STATE_RESOLVED ||
+            (entry->state == DNS_STATE_IN_PROGRESS && entry->stale))
          {
             //Return the corresponding IP address
             *ipAddr = entry->ipAddr;
             //Successful host name resolution
             error = NO_ERROR;
          }
+         else if(entry->state == DNS_STATE_NEGATIVE)
+         {
+            //Host name resolution failed
+            error = entry->error;
+         }
       }
       else
       {
@@ -210,84 +490,140 @@ error_t dnsResolve(NetInterface *interface, const char_t *name,
 
 
 /**
- * @brief Send a DNS query message
- * @param[in] entry Pointer to a valid DNS cache entry
+ * @brief Resolve a host name using DNS without blocking
+ *
+ * If the DNS cache can answer, the IP address is returned at once and the
+ * callback is not invoked. Otherwise ERROR_IN_PROGRESS is returned and the
+ * callback is invoked from the TCP/IP task when the name resolution completes
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] name Name of the host to be resolved
+ * @param[in] type Host type (IPv4 or IPv6)
+ * @param[out] ipAddr IP address corresponding to the specified host name
+ * @param[in] callback Completion callback
+ * @param[in] param Callback function parameter
  * @return Error code
  **/
 
-error_t dnsSendQuery(DnsCacheEntry *entry)
+error_t dnsResolveAsync(NetInterface *interface, const char_t *name,
+   HostType type, IpAddr *ipAddr, DnsResolveCallback callback, void *param)
 {
    error_t error;
-   size_t length;
-   size_t offset;
-   NetBuffer *buffer;
-   DnsHeader *message;
-   DnsQuestion *dnsQuestion;
-   IpAddr destIpAddr;
-   NetTxAncillary ancillary;
 
-#if (IPV4_SUPPORT == ENABLED)
-   //An IPv4 address is expected?
-   if(entry->type == HOST_TYPE_IPV4)
+   //Check parameters
+   if(name == NULL || ipAddr == NULL || callback == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Use default network interface?
+   if(interface == NULL)
    {
-      //Point to the IPv4 context
-      Ipv4Context *ipv4Context = &entry->interface->ipv4Context;
+      interface = netGetDefaultInterface();
+   }
 
-      //Select the relevant DNS server
-      while(1)
-      {
-         //Out of range index?
-         if(entry->dnsServerIndex >= IPV4_DNS_SERVER_LIST_SIZE)
-            return ERROR_NO_DNS_SERVER;
+   //Make sure the host name fits in a DNS cache entry
+   if(osStrlen(name) > DNS_MAX_NAME_LEN)
+      return ERROR_INVALID_NAME;
 
-         //Copy the address of the DNS server
-         destIpAddr.length = sizeof(Ipv4Addr);
-         destIpAddr.ipv4Addr = ipv4Context->dnsServerList[entry->dnsServerIndex];
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Search the DNS cache and send a DNS query if necessary
+   error = dnsLookup(interface, name, type, ipAddr, callback, param);
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
 
-         //Make sure the IP address is valid
-         if(destIpAddr.ipv4Addr != IPV4_UNSPECIFIED_ADDR)
-            break;
+   //Return status code
+   return error;
+}
 
-         //Select the next DNS server in the list
-         entry->dnsServerIndex++;
-      }
-   }
-   else
-#endif
-#if (IPV6_SUPPORT == ENABLED)
-   //An IPv6 address is expected?
-   if(entry->type == HOST_TYPE_IPV6)
-   {
-      //Point to the IPv6 context
-      Ipv6Context *ipv6Context = &entry->interface->ipv6Context;
 
-      //Select the relevant DNS server
-      while(1)
-      {
-         //Out of range index?
-         if(entry->dnsServerIndex >= IPV6_DNS_SERVER_LIST_SIZE)
-            return ERROR_NO_DNS_SERVER;
+/**
+ * @brief Start the name resolution of a DNS cache entry
+ * @param[in] entry Pointer to a valid DNS cache entry
+ * @return Error code
+ **/
 
-         //Copy the address of the DNS server
-         destIpAddr.length = sizeof(Ipv6Addr);
-         destIpAddr.ipv6Addr = ipv6Context->dnsServerList[entry->dnsServerIndex];
+error_t dnsStartQuery(DnsCacheEntry *entry)
+{
+   error_t error;
 
-         //Make sure the IP address is valid
-         if(!ipv6CompAddr(&destIpAddr.ipv6Addr, &IPV6_UNSPECIFIED_ADDR))
-            break;
+   //No DNS server has been queried yet
+   entry->serverMask = 0;
 
-         //Select the next DNS server in the list
-         entry->dnsServerIndex++;
-      }
-   }
-   else
+#if (DNS_CLIENT_PARALLEL_SUPPORT == DISABLED)
+   //Select the fastest DNS server
+   error = dnsSelectServer(entry);
+   //No DNS server available?
+   if(error)
+      return error;
 #endif
-   //Invalid host type?
+
+   //Get an ephemeral port number
+   entry->port = udpGetDynamicPort();
+
+   //An identifier is used by the DNS client to match replies with
+   //corresponding requests
+   entry->id = (uint16_t) netGenerateRand();
+
+   //Callback function to be called when a DNS response is received
+   error = udpAttachRxCallback(entry->interface, entry->port,
+      dnsProcessResponse, NULL);
+
+   //Check status code
+   if(!error)
    {
-      //Report an error
-      return ERROR_INVALID_PARAMETER;
+      //Initialize retransmission counter
+      entry->retransmitCount = DNS_CLIENT_MAX_RETRIES;
+      //Send DNS query
+      error = dnsSendQuery(entry);
+
+      //DNS message successfully sent?
+      if(!error)
+      {
+         //Save the time at which the query message was sent
+         entry->timestamp = osGetSystemTime();
+         //Set timeout value
+         entry->timeout = DNS_CLIENT_INIT_TIMEOUT;
+         entry->maxTimeout = DNS_CLIENT_MAX_TIMEOUT;
+         //Decrement retransmission counter
+         entry->retransmitCount--;
+
+         //Switch state
+         entry->state = DNS_STATE_IN_PROGRESS;
+      }
+      else
+      {
+         //Unregister callback function
+         udpDetachRxCallback(entry->interface, entry->port);
+      }
    }
 
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Send a DNS query message to a given DNS server
+ * @param[in] entry Pointer to a valid DNS cache entry
+ * @param[in] index Index of the DNS server
+ * @return Error code
+ **/
+
+static error_t dnsSendQueryTo(DnsCacheEntry *entry, uint_t index)
+{
+   error_t error;
+   size_t length;
+   size_t offset;
+   NetBuffer *buffer;
+   DnsHeader *message;
+   DnsQuestion *dnsQuestion;
+   IpAddr destIpAddr;
+   NetTxAncillary ancillary;
+
+   //Retrieve the address of the DNS server
+   if(!dnsGetServerAddr(entry, index, &destIpAddr))
+      return ERROR_NO_DNS_SERVER;
+
    //Allocate a memory buffer to hold the DNS query message
    buffer = udpAllocBuffer(DNS_MESSAGE_MAX_SIZE, &offset);
    //Failed to allocate buffer?
@@ -323,24 +659,20 @@ error_t dnsSendQuery(DnsCacheEntry *entry)
    //Point to the corresponding question structure
    dnsQuestion = DNS_GET_QUESTION(message, length);
 
-#if (IPV4_SUPPORT == ENABLED)
-   //An IPv4 address is expected?
-   if(entry->type == HOST_TYPE_IPV4)
+   //IPv4 DNS servers are queried for A records and IPv6 DNS servers for
+   //AAAA records
+   if(index < DNS_IPV4_SERVER_COUNT)
    {
       //Fill in question structure
       dnsQuestion->qtype = HTONS(DNS_RR_TYPE_A);
       dnsQuestion->qclass = HTONS(DNS_RR_CLASS_IN);
    }
-#endif
-#if (IPV6_SUPPORT == ENABLED)
-   //An IPv6 address is expected?
-   if(entry->type == HOST_TYPE_IPV6)
+   else
    {
       //Fill in question structure
       dnsQuestion->qtype = HTONS(DNS_RR_TYPE_AAAA);
       dnsQuestion->qclass = HTONS(DNS_RR_CLASS_IN);
    }
-#endif
 
    //Update the length of the DNS query message
    length += sizeof(DnsQuestion);
@@ -368,6 +700,97 @@ error_t dnsSendQuery(DnsCacheEntry *entry)
 }
 
 
+/**
+ * @brief Send a DNS query message
+ *
+ * In parallel mode, the query is sent to all the DNS servers at once, the
+ * fastest first, and the first valid answer is kept. Otherwise it is sent
+ * to the selected DNS server only
+ *
+ * @param[in] entry Pointer to a valid DNS cache entry
+ * @return Error code
+ **/
+
+error_t dnsSendQuery(DnsCacheEntry *entry)
+{
+#if (DNS_CLIENT_PARALLEL_SUPPORT == ENABLED)
+   error_t error;
+   uint_t i;
+   uint_t j;
+   uint_t n;
+   systime_t r;
+   uint8_t order[DNS_SERVER_COUNT];
+   systime_t rtt[DNS_SERVER_COUNT];
+   IpAddr ipAddr;
+
+   //Number of configured DNS servers
+   n = 0;
+
+   //Sort the DNS servers by round-trip time
+   for(i = 0; i < DNS_SERVER_COUNT; i++)
+   {
+      //Skip the DNS servers that are not configured
+      if(!dnsGetServerAddr(entry, i, &ipAddr))
+         continue;
+
+      //Retransmission? The DNS server did not answer in time
+      if(entry->retransmitCount < DNS_CLIENT_MAX_RETRIES &&
+         (entry->serverMask & (1U << i)) != 0)
+      {
+         dnsUpdateServerRtt(&ipAddr, entry->timeout, TRUE);
+      }
+
+      //Get the round-trip time of the DNS server
+      r = dnsGetServerRtt(&ipAddr);
+
+      //Insertion sort, stable for equal round-trip times
+      for(j = n; j > 0 && rtt[j - 1] > r; j--)
+      {
+         order[j] = order[j - 1];
+         rtt[j] = rtt[j - 1];
+      }
+
+      order[j] = (uint8_t) i;
+      rtt[j] = r;
+      n++;
+   }
+
+   //Initialize status code
+   error = ERROR_NO_DNS_SERVER;
+   //Keep track of the DNS servers that have been queried
+   entry->serverMask = 0;
+
+   //Send the query to all the DNS servers
+   for(i = 0; i < n; i++)
+   {
+      //Send DNS query
+      error = dnsSendQueryTo(entry, order[i]);
+
+      //DNS message successfully sent?
+      if(!error)
+      {
+         entry->serverMask |= 1U << order[i];
+      }
+   }
+
+   //The query is successful as long as one DNS server has been queried
+   return (entry->serverMask != 0) ? NO_ERROR : error;
+#else
+   IpAddr ipAddr;
+
+   //Retransmission? The DNS server did not answer in time
+   if(entry->retransmitCount < DNS_CLIENT_MAX_RETRIES &&
+      dnsGetServerAddr(entry, entry->dnsServerIndex, &ipAddr))
+   {
+      dnsUpdateServerRtt(&ipAddr, entry->timeout, TRUE);
+   }
+
+   //Send the query to the selected DNS server
+   return dnsSendQueryTo(entry, entry->dnsServerIndex);
+#endif
+}
+
+
 /**
  * @brief Process incoming DNS response message
  * @param[in] interface Underlying network interface
@@ -389,6 +812,11 @@ void dnsProcessResponse(NetInterface *interface,
    uint_t j;
    size_t pos;
    size_t length;
+   bool_t valid;
+   IpAddr srcIpAddr;
+#if (DNS_CLIENT_PARALLEL_SUPPORT == ENABLED)
+   IpAddr ipAddr;
+#endif
    DnsHeader *message;
    DnsQuestion *question;
    DnsResourceRecord *record;
@@ -473,11 +901,59 @@ void dnsProcessResponse(NetInterface *interface,
                break;
             }
 
+            if(ntohs(question->qtype) != DNS_RR_TYPE_A &&
+               ntohs(question->qtype) != DNS_RR_TYPE_AAAA)
+            {
+               break;
+            }
+
+            //Retrieve the address of the DNS server
+            valid = dnsGetResponseAddr(pseudoHeader, &srcIpAddr);
+
+            //Karn's algorithm: only an answer to the first transmission of
+            //the query gives a valid round-trip time sample
+            if(valid && entry->retransmitCount == (DNS_CLIENT_MAX_RETRIES - 1) &&
+               (message->rcode == DNS_RCODE_NOERROR ||
+               message->rcode == DNS_RCODE_NXDOMAIN))
+            {
+               dnsUpdateServerRtt(&srcIpAddr,
+                  osGetSystemTime() - entry->timestamp, FALSE);
+            }
+
+            //The domain name does not exist?
+            if(message->rcode == DNS_RCODE_NXDOMAIN)
+            {
+               //The answer is authoritative, there is no need to query
+               //another DNS server
+               dnsCompleteEntry(entry, ERROR_NOT_FOUND);
+               //Exit immediately
+               break;
+            }
+
             //Check response code
             if(message->rcode != DNS_RCODE_NOERROR)
             {
+#if (DNS_CLIENT_PARALLEL_SUPPORT == ENABLED)
+               //The other DNS servers may still give a valid answer
+               for(j = 0; j < DNS_SERVER_COUNT && valid; j++)
+               {
+                  //Matching DNS server?
+                  if(dnsGetServerAddr(entry, j, &ipAddr) &&
+                     ipCompAddr(&ipAddr, &srcIpAddr))
+                  {
+                     entry->serverMask &= ~(1U << j);
+                  }
+               }
+
+               //Give up when all the DNS servers have failed
+               if(entry->serverMask == 0)
+               {
+                  dnsSelectNextServer(entry);
+               }
+#else
                //Select the next DNS server
                dnsSelectNextServer(entry);
+#endif
                //Exit immediately
                break;
             }
@@ -507,7 +983,7 @@ void dnsProcessResponse(NetInterface *interface,
 
 #if (IPV4_SUPPORT == ENABLED)
                //IPv4 address expected?
-               if(entry->type == HOST_TYPE_IPV4)
+               if(entry->type == HOST_TYPE_IPV4 || entry->type == HOST_TYPE_ANY)
                {
                   //A resource record found?
                   if(ntohs(record->rtype) == DNS_RR_TYPE_A &&
@@ -532,6 +1008,8 @@ void dnsProcessResponse(NetInterface *interface,
                      udpDetachRxCallback(interface, entry->port);
                      //Host name successfully resolved
                      entry->state = DNS_STATE_RESOLVED;
+                     //Notify the completion of the name resolution
+                     dnsCompleteEntry(entry, NO_ERROR);
                      //Exit immediately
                      break;
                   }
@@ -539,7 +1017,7 @@ void dnsProcessResponse(NetInterface *interface,
 #endif
 #if (IPV6_SUPPORT == ENABLED)
                //IPv6 address expected?
-               if(entry->type == HOST_TYPE_IPV6)
+               if(entry->type == HOST_TYPE_IPV6 || entry->type == HOST_TYPE_ANY)
                {
                   //AAAA resource record found?
                   if(ntohs(record->rtype) == DNS_RR_TYPE_AAAA &&
@@ -564,6 +1042,8 @@ void dnsProcessResponse(NetInterface *interface,
                      udpDetachRxCallback(interface, entry->port);
                      //Host name successfully resolved
                      entry->state = DNS_STATE_RESOLVED;
+                     //Notify the completion of the name resolution
+                     dnsCompleteEntry(entry, NO_ERROR);
                      //Exit immediately
                      break;
                   }
@@ -573,6 +1053,16 @@ void dnsProcessResponse(NetInterface *interface,
                pos += ntohs(record->rdlength);
             }
 
+            //The name exists but has no address of the requested type? When
+            //both A and AAAA records are queried, the other answer may not
+            if(j >= ntohs(message->ancount) && !message->tc &&
+               (entry->type != HOST_TYPE_ANY || DNS_IPV6_SERVER_COUNT == 0 ||
+               DNS_IPV4_SERVER_COUNT == 0))
+            {
+               //Negative response (refer to RFC 2308, section 2.2)
+               dnsCompleteEntry(entry, ERROR_NOT_FOUND);
+            }
+
             //We are done
             break;
          }
@@ -589,22 +1079,51 @@ void dnsProcessResponse(NetInterface *interface,
 void dnsSelectNextServer(DnsCacheEntry *entry)
 {
    error_t error;
+   IpAddr ipAddr;
+#if (DNS_CLIENT_PARALLEL_SUPPORT == ENABLED)
+   uint_t i;
+#endif
 
 #if defined(DNS_SELECT_NEXT_SERVER_HOOK)
    DNS_SELECT_NEXT_SERVER_HOOK(entry);
 #endif
 
-   //Select the next DNS server
-   entry->dnsServerIndex++;
+#if (DNS_CLIENT_PARALLEL_SUPPORT == ENABLED)
+   //The DNS servers that have not answered are penalized
+   for(i = 0; i < DNS_SERVER_COUNT; i++)
+   {
+      if((entry->serverMask & (1U << i)) != 0 &&
+         dnsGetServerAddr(entry, i, &ipAddr))
+      {
+         dnsUpdateServerRtt(&ipAddr, entry->timeout, TRUE);
+      }
+   }
 
-   //An identifier is used by the DNS client to match replies with
-   //corresponding requests
-   entry->id = (uint16_t) netGenerateRand();
+   //All the DNS servers have already been queried
+   error = ERROR_NO_DNS_SERVER;
+#else
+   //The current DNS server is penalized
+   if(dnsGetServerAddr(entry, entry->dnsServerIndex, &ipAddr))
+   {
+      dnsUpdateServerRtt(&ipAddr, entry->timeout, TRUE);
+   }
 
-   //Initialize retransmission counter
-   entry->retransmitCount = DNS_CLIENT_MAX_RETRIES;
-   //Send DNS query
-   error = dnsSendQuery(entry);
+   //Select the fastest DNS server not yet queried
+   error = dnsSelectServer(entry);
+
+   //Any DNS server left?
+   if(!error)
+   {
+      //An identifier is used by the DNS client to match replies with
+      //corresponding requests
+      entry->id = (uint16_t) netGenerateRand();
+
+      //Initialize retransmission counter
+      entry->retransmitCount = DNS_CLIENT_MAX_RETRIES;
+      //Send DNS query
+      error = dnsSendQuery(entry);
+   }
+#endif
 
    //DNS message successfully sent?
    if(!error)
@@ -618,8 +1137,14 @@ void dnsSelectNextServer(DnsCacheEntry *entry)
    }
    else
    {
-      //The entry should be deleted since name resolution has failed
-      dnsDeleteEntry(entry);
+      //All the DNS servers have been tried without success
+      if(error == ERROR_NO_DNS_SERVER)
+      {
+         error = ERROR_TIMEOUT;
+      }
+
+      //The name resolution has failed
+      dnsCompleteEntry(entry, error);
    }
 }
 
@@ -79,15 +79,53 @@
    #error DNS_MAX_LIFETIME parameter is not valid
 #endif
 
+//Parallel queries to all the DNS servers
+#ifndef DNS_CLIENT_PARALLEL_SUPPORT
+   #define DNS_CLIENT_PARALLEL_SUPPORT DISABLED
+#elif (DNS_CLIENT_PARALLEL_SUPPORT != ENABLED && DNS_CLIENT_PARALLEL_SUPPORT != DISABLED)
+   #error DNS_CLIENT_PARALLEL_SUPPORT parameter is not valid
+#endif
+
+//Number of DNS servers whose round-trip time is tracked
+#ifndef DNS_CLIENT_RTT_TABLE_SIZE
+   #define DNS_CLIENT_RTT_TABLE_SIZE 4
+#elif (DNS_CLIENT_RTT_TABLE_SIZE < 1)
+   #error DNS_CLIENT_RTT_TABLE_SIZE parameter is not valid
+#endif
+
+//Lifetime of round-trip time measurements
+#ifndef DNS_CLIENT_RTT_LIFETIME
+   #define DNS_CLIENT_RTT_LIFETIME 60000
+#elif (DNS_CLIENT_RTT_LIFETIME < 1000)
+   #error DNS_CLIENT_RTT_LIFETIME parameter is not valid
+#endif
+
 //C++ guard
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+
+/**
+ * @brief Round-trip time statistics of a DNS server
+ **/
+
+typedef struct
+{
+   IpAddr ipAddr;       ///<IP address of the DNS server
+   systime_t srtt;      ///<Smoothed round-trip time (0 if the entry is unused)
+   systime_t timestamp; ///<Time of the last update
+} DnsServerRtt;
+
+
 //DNS related functions
 error_t dnsResolve(NetInterface *interface, const char_t *name,
    HostType type, IpAddr *ipAddr);
 
+error_t dnsResolveAsync(NetInterface *interface, const char_t *name,
+   HostType type, IpAddr *ipAddr, DnsResolveCallback callback, void *param);
+
+error_t dnsStartQuery(DnsCacheEntry *entry);
 error_t dnsSendQuery(DnsCacheEntry *entry);
 
 void dnsProcessResponse(NetInterface *interface,
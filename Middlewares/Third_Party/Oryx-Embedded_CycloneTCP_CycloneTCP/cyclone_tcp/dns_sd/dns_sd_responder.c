@@ -0,0 +1,713 @@
+/**
+ * @file dns_sd_responder.c
+ * @brief DNS-SD responder (DNS-Based Service Discovery)
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * DNS-SD allows clients to discover a list of named instances of that
+ * desired service, using standard DNS queries. Refer to the following
+ * RFCs for complete details:
+ * - RFC 6763: DNS-Based Service Discovery
+ * - RFC 2782: A DNS RR for specifying the location of services (DNS SRV)
+ *
+ * The records of all the services that are due at the same time are
+ * aggregated into as few probe, announcement and goodbye packets as
+ * possible
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL DNS_SD_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "mdns/mdns_responder.h"
+#include "dns_sd/dns_sd_responder.h"
+#include "dns_sd/dns_sd_responder_misc.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (DNS_SD_RESPONDER_SUPPORT == ENABLED)
+
+//Tick counter to handle periodic operations
+systime_t dnsSdResponderTickCounter;
+
+
+/**
+ * @brief Initialize settings with default values
+ * @param[out] settings Structure that contains DNS-SD responder settings
+ **/
+
+void dnsSdResponderGetDefaultSettings(DnsSdResponderSettings *settings)
+{
+   //Use default interface
+   settings->interface = netGetDefaultInterface();
+
+   //DNS-SD services
+   settings->numServices = 0;
+   settings->services = NULL;
+
+   //Number of announcement packets
+   settings->numAnnouncements = MDNS_ANNOUNCE_NUM;
+   //TTL resource record
+   settings->ttl = DNS_SD_DEFAULT_RR_TTL;
+   //FSM state change event
+   settings->stateChangeEvent = NULL;
+}
+
+
+/**
+ * @brief DNS-SD responder initialization
+ * @param[in] context Pointer to the DNS-SD responder context
+ * @param[in] settings DNS-SD responder specific settings
+ * @return Error code
+ **/
+
+error_t dnsSdResponderInit(DnsSdResponderContext *context,
+   const DnsSdResponderSettings *settings)
+{
+   uint_t i;
+   NetInterface *interface;
+
+   //Debug message
+   TRACE_INFO("Initializing DNS-SD responder...\r\n");
+
+   //Ensure the parameters are valid
+   if(context == NULL || settings == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Invalid network interface?
+   if(settings->interface == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Invalid DNS-SD services?
+   if(settings->numServices > 0 && settings->services == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Point to the underlying network interface
+   interface = settings->interface;
+
+   //Clear the DNS-SD responder context
+   osMemset(context, 0, sizeof(DnsSdResponderContext));
+
+   //Save user settings
+   context->interface = settings->interface;
+   context->numServices = settings->numServices;
+   context->services = settings->services;
+   context->numAnnouncements = settings->numAnnouncements;
+   context->ttl = settings->ttl;
+   context->stateChangeEvent = settings->stateChangeEvent;
+
+   //Clear the list of DNS-SD services
+   osMemset(context->services, 0, context->numServices *
+      sizeof(DnsSdResponderService));
+
+   //Loop through the list of DNS-SD services
+   for(i = 0; i < context->numServices; i++)
+   {
+      //Attach the DNS-SD responder context to the service
+      context->services[i].context = context;
+      //Initialize state machine
+      context->services[i].state = MDNS_STATE_INIT;
+   }
+
+   //DNS-SD responder is currently suspended
+   context->running = FALSE;
+
+   //Attach the DNS-SD responder context to the network interface
+   interface->dnsSdResponderContext = context;
+
+   //Successful initialization
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Start DNS-SD responder
+ * @param[in] context Pointer to the DNS-SD responder context
+ * @return Error code
+ **/
+
+error_t dnsSdResponderStart(DnsSdResponderContext *context)
+{
+   uint_t i;
+
+   //Make sure the DNS-SD responder context is valid
+   if(context == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Debug message
+   TRACE_INFO("Starting DNS-SD responder...\r\n");
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Start DNS-SD responder
+   context->running = TRUE;
+
+   //Loop through the list of DNS-SD services
+   for(i = 0; i < context->numServices; i++)
+   {
+      //Initialize state machine
+      context->services[i].state = MDNS_STATE_INIT;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Stop DNS-SD responder
+ * @param[in] context Pointer to the DNS-SD responder context
+ * @return Error code
+ **/
+
+error_t dnsSdResponderStop(DnsSdResponderContext *context)
+{
+   uint_t i;
+   DnsSdResponderService *service;
+
+   //Make sure the DNS-SD responder context is valid
+   if(context == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Debug message
+   TRACE_INFO("Stopping DNS-SD responder...\r\n");
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Check whether the link is up
+   if(context->interface->linkState)
+   {
+      //Loop through the list of DNS-SD services
+      for(i = 0; i < context->numServices; i++)
+      {
+         //Point to the current service
+         service = &context->services[i];
+
+         //Only the records that have been announced need a goodbye
+         service->pending = (service->state == MDNS_STATE_ANNOUNCING ||
+            service->state == MDNS_STATE_IDLE);
+      }
+
+      //Send goodbye packets for all the services at once
+      dnsSdResponderSendGoodbye(context);
+   }
+
+   //Suspend DNS-SD responder
+   context->running = FALSE;
+
+   //Loop through the list of DNS-SD services
+   for(i = 0; i < context->numServices; i++)
+   {
+      //Reinitialize state machine
+      context->services[i].state = MDNS_STATE_INIT;
+      context->services[i].pending = FALSE;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Register a DNS-SD service
+ * @param[in] context Pointer to the DNS-SD responder context
+ * @param[in] index Zero-based index identifying a slot
+ * @param[in] instanceName NULL-terminated string that contains the service
+ *   instance name
+ * @param[in] serviceName NULL-terminated string that contains the name of
+ *   the service to be registered
+ * @param[in] priority Priority field
+ * @param[in] weight Weight field
+ * @param[in] port Port number
+ * @param[in] metadata NULL-terminated string that contains the discovery-time
+ *   metadata (TXT record), as a list of key=value pairs separated by
+ *   semicolons
+ * @return Error code
+ **/
+
+error_t dnsSdResponderRegisterService(DnsSdResponderContext *context,
+   uint_t index, const char_t *instanceName, const char_t *serviceName,
+   uint16_t priority, uint16_t weight, uint16_t port, const char_t *metadata)
+{
+   size_t i;
+   size_t j;
+   size_t k;
+   size_t n;
+   DnsSdResponderService *service;
+
+   //Check parameters
+   if(context == NULL || instanceName == NULL || serviceName == NULL ||
+      metadata == NULL)
+   {
+      return ERROR_INVALID_PARAMETER;
+   }
+
+   //The index must be a valid slot
+   if(index >= context->numServices)
+      return ERROR_INVALID_PARAMETER;
+
+   //Make sure the length of the instance name is acceptable
+   if(osStrlen(instanceName) > DNS_SD_MAX_INSTANCE_NAME_LEN)
+      return ERROR_INVALID_LENGTH;
+
+   //Make sure the length of the service name is acceptable
+   if(osStrlen(serviceName) > DNS_SD_MAX_SERVICE_NAME_LEN)
+      return ERROR_INVALID_LENGTH;
+
+   //Make sure the length of the metadata is acceptable
+   if(osStrlen(metadata) > DNS_SD_MAX_METADATA_LEN)
+      return ERROR_INVALID_LENGTH;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Point to the specified slot
+   service = &context->services[index];
+
+   //Check whether the records of a previous service have been announced
+   if((service->state == MDNS_STATE_ANNOUNCING ||
+      service->state == MDNS_STATE_IDLE) && context->interface->linkState)
+   {
+      //Send a goodbye packet
+      service->pending = TRUE;
+      dnsSdResponderSendGoodbye(context);
+      service->pending = FALSE;
+   }
+
+   //Set instance name
+   osStrcpy(service->instanceName, instanceName);
+   //Set service name
+   osStrcpy(service->serviceName, serviceName);
+
+   //Priority field
+   service->priority = priority;
+   //Weight field
+   service->weight = weight;
+   //Port number
+   service->port = port;
+
+   //Clear the discovery-time metadata
+   service->metadataLen = 0;
+
+   //Each key=value pair is encoded as a length-prefixed string
+   for(i = 0, k = 0; metadata[i] != '\0'; i = j)
+   {
+      //Search for the next separator
+      for(j = i; metadata[j] != ';' && metadata[j] != '\0'; j++)
+      {
+      }
+
+      //Length of the current pair
+      n = j - i;
+
+      //Empty pairs are discarded
+      if(n > 0 && n <= UINT8_MAX && (k + n + 1) <= DNS_SD_MAX_METADATA_LEN)
+      {
+         //Write the length of the string
+         service->metadata[k++] = (uint8_t) n;
+         //Copy the key=value pair
+         osMemcpy(service->metadata + k, metadata + i, n);
+         k += n;
+      }
+
+      //Skip the separator
+      if(metadata[j] == ';')
+      {
+         j++;
+      }
+   }
+
+   //Length of the TXT record data
+   service->metadataLen = k;
+
+   //Clear flags
+   service->conflict = FALSE;
+   service->tieBreakLost = FALSE;
+   service->pending = FALSE;
+
+   //Probe the new service, along with the other services that are due
+   dnsSdResponderChangeState(service, MDNS_STATE_INIT, 0);
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Unregister a DNS-SD service
+ * @param[in] context Pointer to the DNS-SD responder context
+ * @param[in] index Zero-based index identifying a slot
+ * @return Error code
+ **/
+
+error_t dnsSdResponderUnregisterService(DnsSdResponderContext *context,
+   uint_t index)
+{
+   DnsSdResponderService *service;
+
+   //Make sure the DNS-SD responder context is valid
+   if(context == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //The index must be a valid slot
+   if(index >= context->numServices)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Point to the specified slot
+   service = &context->services[index];
+
+   //Check whether the records of the service have been announced
+   if((service->state == MDNS_STATE_ANNOUNCING ||
+      service->state == MDNS_STATE_IDLE) && context->interface->linkState)
+   {
+      //Send a goodbye packet
+      service->pending = TRUE;
+      dnsSdResponderSendGoodbye(context);
+   }
+
+   //Remove the service from the list
+   service->instanceName[0] = '\0';
+   service->serviceName[0] = '\0';
+   service->metadataLen = 0;
+   service->pending = FALSE;
+
+   //Reinitialize state machine
+   service->state = MDNS_STATE_INIT;
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Restart probing process
+ * @param[in] context Pointer to the DNS-SD responder context
+ * @return Error code
+ **/
+
+error_t dnsSdResponderStartProbing(DnsSdResponderContext *context)
+{
+   uint_t i;
+
+   //Check whether the DNS-SD responder has been properly instantiated
+   if(context == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Loop through the list of DNS-SD services
+   for(i = 0; i < context->numServices; i++)
+   {
+      //Force the DNS-SD responder to start probing again
+      context->services[i].state = MDNS_STATE_INIT;
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief DNS-SD responder timer handler
+ *
+ * This routine must be periodically called by the TCP/IP stack to
+ * manage DNS-SD operation. The services share the same timestamp, so that
+ * the services that are probed or announced together stay in lockstep
+ * and their records travel in the same packets
+ *
+ * @param[in] context Pointer to the DNS-SD responder context
+ **/
+
+void dnsSdResponderTick(DnsSdResponderContext *context)
+{
+   uint_t i;
+   bool_t hostProbing;
+   bool_t hostReady;
+   bool_t probe;
+   bool_t announce;
+   systime_t time;
+   NetInterface *interface;
+   MdnsResponderContext *mdnsResponderContext;
+   DnsSdResponderService *service;
+
+   //Make sure the DNS-SD responder has been properly instantiated
+   if(context == NULL)
+      return;
+
+   //Point to the underlying network interface
+   interface = context->interface;
+   //Point to the mDNS responder context
+   mdnsResponderContext = interface->mdnsResponderContext;
+
+   //The DNS-SD responder relies on the mDNS responder
+   if(mdnsResponderContext == NULL)
+      return;
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //The host name is unique once the mDNS responder has completed probing
+   hostReady = (mdnsResponderContext->state == MDNS_STATE_ANNOUNCING ||
+      mdnsResponderContext->state == MDNS_STATE_IDLE);
+
+   //The service instance names are probed along with the host name, as
+   //soon as the mDNS responder has sent its first probe
+   hostProbing = hostReady ||
+      (mdnsResponderContext->state == MDNS_STATE_PROBING &&
+      mdnsResponderContext->retransmitCount > 0);
+
+   //No packet is due yet
+   probe = FALSE;
+   announce = FALSE;
+
+   //Loop through the list of DNS-SD services
+   for(i = 0; i < context->numServices; i++)
+   {
+      //Point to the current service
+      service = &context->services[i];
+
+      //Skip the slots that do not hold any service
+      if(service->instanceName[0] == '\0' || service->serviceName[0] == '\0')
+         continue;
+
+      //The states are checked in turn, so that a service moving to the next
+      //state is handled within the same tick
+      if(service->state == MDNS_STATE_INIT)
+      {
+         //Wait for the link to be up before starting DNS-SD responder
+         if(context->running && interface->linkState && hostProbing)
+         {
+            //Start probing
+            dnsSdResponderChangeState(service, MDNS_STATE_PROBING, 0);
+            //Align the timer with the other services
+            service->timestamp = time;
+         }
+      }
+
+      if(service->state == MDNS_STATE_PROBING)
+      {
+         //Probing failed?
+         if(service->conflict && service->retransmitCount > 0)
+         {
+            //Programmatically change the service instance name
+            dnsSdResponderChangeInstanceName(service);
+
+            //Probe again, and repeat as necessary until a unique name is found
+            dnsSdResponderChangeState(service, MDNS_STATE_PROBING,
+               MDNS_PROBE_CONFLICT_DELAY);
+
+            //Align the timer with the other services
+            service->timestamp = time;
+         }
+         //Tie-break lost?
+         else if(service->tieBreakLost && service->retransmitCount > 0)
+         {
+            //The host defers to the winning host by waiting one second, and
+            //then begins probing for this record again
+            dnsSdResponderChangeState(service, MDNS_STATE_PROBING,
+               MDNS_PROBE_DEFER_DELAY);
+
+            //Align the timer with the other services
+            service->timestamp = time;
+         }
+         //Check current time
+         else if(timeCompare(time, service->timestamp + service->timeout) >= 0)
+         {
+            //Probing is on-going?
+            if(service->retransmitCount < MDNS_PROBE_NUM)
+            {
+               //First probe?
+               if(service->retransmitCount == 0)
+               {
+                  //Apparently conflicting mDNS responses received before the
+                  //first probe packet is sent must be silently ignored
+                  service->conflict = FALSE;
+                  service->tieBreakLost = FALSE;
+               }
+
+               //The records of the service are part of the next probe packet
+               service->pending = TRUE;
+               probe = TRUE;
+
+               //Save the time at which the packet was sent
+               service->timestamp = time;
+               //Time interval between subsequent probe packets
+               service->timeout = MDNS_PROBE_DELAY;
+               //Increment retransmission counter
+               service->retransmitCount++;
+            }
+            //Probing is complete and the SRV record can point to a unique
+            //host name?
+            else if(hostReady)
+            {
+               //The DNS-SD responder must send unsolicited mDNS responses
+               //containing all of its newly registered resource records
+               if(context->numAnnouncements > 0)
+               {
+                  dnsSdResponderChangeState(service, MDNS_STATE_ANNOUNCING, 0);
+               }
+               else
+               {
+                  dnsSdResponderChangeState(service, MDNS_STATE_IDLE, 0);
+               }
+
+               //Align the timer with the other services
+               service->timestamp = time;
+            }
+            else
+            {
+               //Wait for the mDNS responder to complete probing
+            }
+         }
+      }
+
+      if(service->state == MDNS_STATE_ANNOUNCING)
+      {
+         //Whenever a mDNS responder receives any mDNS response (solicited or
+         //otherwise) containing a conflicting resource record, the conflict
+         //must be resolved
+         if(service->conflict)
+         {
+            //Probe again, and repeat as necessary until a unique name is found
+            dnsSdResponderChangeState(service, MDNS_STATE_PROBING, 0);
+            //Align the timer with the other services
+            service->timestamp = time;
+         }
+         //Check current time
+         else if(timeCompare(time, service->timestamp + service->timeout) >= 0)
+         {
+            //The records of the service are part of the next announcement
+            service->pending = TRUE;
+            announce = TRUE;
+
+            //Save the time at which the packet was sent
+            service->timestamp = time;
+            //Increment retransmission counter
+            service->retransmitCount++;
+
+            //First announcement packet?
+            if(service->retransmitCount == 1)
+            {
+               //The mDNS responder must send at least two unsolicited
+               //responses, one second apart
+               service->timeout = MDNS_ANNOUNCE_DELAY;
+            }
+            else
+            {
+               //To provide increased robustness against packet loss, a mDNS
+               //responder may send up to eight unsolicited responses, provided
+               //that the interval between unsolicited responses increases by
+               //at least a factor of two with every response sent
+               service->timeout *= 2;
+            }
+
+            //Last announcement packet?
+            if(service->retransmitCount >= context->numAnnouncements)
+            {
+               //A mDNS responder must not send regular periodic announcements
+               dnsSdResponderChangeState(service, MDNS_STATE_IDLE, 0);
+            }
+         }
+      }
+      else if(service->state == MDNS_STATE_IDLE)
+      {
+         //Whenever a mDNS responder receives any mDNS response (solicited or
+         //otherwise) containing a conflicting resource record, the conflict
+         //must be resolved
+         if(service->conflict)
+         {
+            //Probe again, and repeat as necessary until a unique name is found
+            dnsSdResponderChangeState(service, MDNS_STATE_PROBING, 0);
+            //Align the timer with the other services
+            service->timestamp = time;
+         }
+      }
+   }
+
+   //Any probe due?
+   if(probe)
+   {
+      //Send the probes of all the services at once
+      dnsSdResponderSendProbe(context);
+   }
+
+   //Any announcement due?
+   if(announce)
+   {
+      //Send the announcements of all the services at once
+      dnsSdResponderSendAnnouncement(context);
+   }
+
+   //Loop through the list of DNS-SD services
+   for(i = 0; i < context->numServices; i++)
+   {
+      //The records have been sent
+      context->services[i].pending = FALSE;
+   }
+}
+
+
+/**
+ * @brief Callback function for link change event
+ * @param[in] context Pointer to the DNS-SD responder context
+ **/
+
+void dnsSdResponderLinkChangeEvent(DnsSdResponderContext *context)
+{
+   uint_t i;
+
+   //Make sure the DNS-SD responder has been properly instantiated
+   if(context == NULL)
+      return;
+
+   //Loop through the list of DNS-SD services
+   for(i = 0; i < context->numServices; i++)
+   {
+      //Whenever a mDNS responder receives an indication of a link
+      //change event, it must perform probing and announcing
+      dnsSdResponderChangeState(&context->services[i], MDNS_STATE_INIT, 0);
+   }
+}
+
+#endif
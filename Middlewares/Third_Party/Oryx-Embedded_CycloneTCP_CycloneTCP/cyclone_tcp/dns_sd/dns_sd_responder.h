@@ -135,6 +135,7 @@ struct _DnsSdResponderService
    systime_t timestamp;                                   ///<Timestamp to manage retransmissions
    systime_t timeout;                                     ///<Timeout value
    uint_t retransmitCount;                                ///<Retransmission counter
+   bool_t pending;                                        ///<The records are due in the next batched packet
 };
 
 
@@ -0,0 +1,1552 @@
+/**
+ * @file dns_sd_responder_misc.c
+ * @brief Helper functions for DNS-SD responder
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL DNS_SD_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "mdns/mdns_responder.h"
+#include "mdns/mdns_responder_misc.h"
+#include "dns_sd/dns_sd_responder.h"
+#include "dns_sd/dns_sd_responder_misc.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (DNS_SD_RESPONDER_SUPPORT == ENABLED)
+
+//Service type enumeration (refer to RFC 6763, section 9)
+#define DNS_SD_SERVICE_ENUM_NAME "_services._dns-sd._udp"
+
+
+/**
+ * @brief Format the records of a range of services
+ **/
+
+typedef error_t (*DnsSdResponderFormatBatch)(DnsSdResponderContext *context,
+   MdnsMessage *message, uint_t first, uint_t last);
+
+
+/**
+ * @brief Update FSM state
+ * @param[in] service Pointer to a DNS-SD service
+ * @param[in] newState New state to switch to
+ * @param[in] delay Initial delay
+ **/
+
+void dnsSdResponderChangeState(DnsSdResponderService *service,
+   MdnsState newState, systime_t delay)
+{
+   DnsSdResponderContext *context;
+
+   //Point to the DNS-SD responder context
+   context = service->context;
+
+   //Set time stamp
+   service->timestamp = osGetSystemTime();
+   //Set initial delay
+   service->timeout = delay;
+   //Reset retransmission counter
+   service->retransmitCount = 0;
+   //Switch to the new state
+   service->state = newState;
+
+   //Any registered callback?
+   if(context->stateChangeEvent != NULL)
+   {
+      //Release exclusive access
+      osReleaseMutex(&netMutex);
+      //Invoke user callback function
+      context->stateChangeEvent(service, context->interface, newState);
+      //Get exclusive access
+      osAcquireMutex(&netMutex);
+   }
+}
+
+
+/**
+ * @brief Programmatically change the service instance name
+ *
+ * A number between parentheses is appended to the name, or incremented if
+ * already present (refer to RFC 6762, section 9)
+ *
+ * @param[in] service Pointer to a DNS-SD service
+ **/
+
+void dnsSdResponderChangeInstanceName(DnsSdResponderService *service)
+{
+   size_t i;
+   size_t m;
+   size_t n;
+   uint32_t index;
+   char_t s[16];
+
+   //Retrieve the length of the string
+   n = osStrlen(service->instanceName);
+
+   //Append the number "2" to the name
+   index = 2;
+
+   //Check whether the name ends with a closing parenthesis
+   if(n > 0 && service->instanceName[n - 1] == ')')
+   {
+      //Parse the string backwards
+      for(i = n - 1; i > 0; i--)
+      {
+         //Check whether the current character is a digit
+         if(!osIsdigit(service->instanceName[i - 1]))
+            break;
+      }
+
+      //Any number between parentheses following the name?
+      if(i < (n - 1) && i >= 2 && service->instanceName[i - 1] == '(' &&
+         service->instanceName[i - 2] == ' ')
+      {
+         //Retrieve the number at the end of the name
+         index = atoi(service->instanceName + i);
+         //Increment the value
+         index++;
+
+         //Strip the number
+         n = i - 2;
+      }
+   }
+
+   //Convert the number to a string of characters
+   m = osSprintf(s, " (%" PRIu32 ")", index);
+
+   //Shorten the name if necessary
+   if((n + m) > DNS_SD_MAX_INSTANCE_NAME_LEN)
+   {
+      n = DNS_SD_MAX_INSTANCE_NAME_LEN - m;
+   }
+
+   //Properly terminate the string
+   service->instanceName[n] = '\0';
+   //Programmatically change the service instance name
+   osStrcat(service->instanceName, s);
+}
+
+
+/**
+ * @brief Empty a message that is being formatted
+ * @param[in,out] message Pointer to the mDNS message
+ **/
+
+static void dnsSdResponderResetMessage(MdnsMessage *message)
+{
+   //Discard the questions and the resource records
+   message->length = sizeof(DnsHeader);
+   message->dnsHeader->qdcount = 0;
+   message->dnsHeader->ancount = 0;
+   message->dnsHeader->nscount = 0;
+   message->dnsHeader->arcount = 0;
+}
+
+
+/**
+ * @brief Format the probe records of a range of services
+ * @param[in] context Pointer to the DNS-SD responder context
+ * @param[in,out] message Pointer to the mDNS message
+ * @param[in] first Index of the first service
+ * @param[in] last Index of the last service
+ * @return Error code
+ **/
+
+static error_t dnsSdResponderFormatProbe(DnsSdResponderContext *context,
+   MdnsMessage *message, uint_t first, uint_t last)
+{
+   error_t error;
+   uint_t i;
+   size_t n;
+   size_t offset;
+   DnsQuestion *dnsQuestion;
+   DnsSdResponderService *service;
+
+   //The Question Section lists the names of all the services
+   for(i = first; i <= last; i++)
+   {
+      //Point to the current service
+      service = &context->services[i];
+
+      //Skip the services that are not being probed
+      if(!service->pending || service->state != MDNS_STATE_PROBING)
+         continue;
+
+      //Set the position to the end of the buffer
+      offset = message->length;
+
+      //The first pass calculates the length of the DNS encoded name
+      n = mdnsEncodeName(service->instanceName, service->serviceName,
+         ".local", NULL);
+
+      //Check the length of the resulting mDNS message
+      if((offset + n + sizeof(DnsQuestion)) > MDNS_MESSAGE_MAX_SIZE)
+         return ERROR_MESSAGE_TOO_LONG;
+
+      //The second pass encodes the name using the DNS name notation
+      offset += mdnsEncodeName(service->instanceName, service->serviceName,
+         ".local", (uint8_t *) message->dnsHeader + offset);
+
+      //Point to the corresponding question structure
+      dnsQuestion = DNS_GET_QUESTION(message->dnsHeader, offset);
+
+      //The probes should be sent as QU questions with the unicast-response
+      //bit set, to allow a defending host to respond immediately via unicast
+      dnsQuestion->qtype = HTONS(DNS_RR_TYPE_ANY);
+      dnsQuestion->qclass = HTONS(MDNS_QCLASS_QU | DNS_RR_CLASS_IN);
+
+      //Update the length of the mDNS query message
+      message->length = offset + sizeof(DnsQuestion);
+      //Number of questions in the Question Section
+      message->dnsHeader->qdcount++;
+   }
+
+   //The Authority Section holds the proposed records of all the services
+   for(i = first; i <= last; i++)
+   {
+      //Point to the current service
+      service = &context->services[i];
+
+      //Skip the services that are not being probed
+      if(!service->pending || service->state != MDNS_STATE_PROBING)
+         continue;
+
+      //Format SRV resource record
+      error = dnsSdResponderFormatSrvRecord(context->interface, message,
+         service, FALSE, context->ttl);
+      //Any error to report?
+      if(error)
+         return error;
+
+      //Format TXT resource record
+      error = dnsSdResponderFormatTxtRecord(context->interface, message,
+         service, FALSE, context->ttl);
+      //Any error to report?
+      if(error)
+         return error;
+   }
+
+   //Number of resource records in the Authority Section
+   message->dnsHeader->nscount = message->dnsHeader->ancount;
+   //Number of resource records in the Answer Section
+   message->dnsHeader->ancount = 0;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Format the announcement records of a range of services
+ * @param[in] context Pointer to the DNS-SD responder context
+ * @param[in,out] message Pointer to the mDNS message
+ * @param[in] first Index of the first service
+ * @param[in] last Index of the last service
+ * @return Error code
+ **/
+
+static error_t dnsSdResponderFormatAnnouncement(DnsSdResponderContext *context,
+   MdnsMessage *message, uint_t first, uint_t last)
+{
+   error_t error;
+   uint_t i;
+   DnsSdResponderService *service;
+
+   //Loop through the services
+   for(i = first; i <= last; i++)
+   {
+      //Point to the current service
+      service = &context->services[i];
+
+      //Skip the services that are not being announced
+      if(!service->pending || (service->state != MDNS_STATE_ANNOUNCING &&
+         service->state != MDNS_STATE_IDLE))
+      {
+         continue;
+      }
+
+      //Format PTR resource record (service type enumeration)
+      error = dnsSdResponderFormatServiceEnumPtrRecord(context->interface,
+         message, service, context->ttl);
+      //Any error to report?
+      if(error)
+         return error;
+
+      //Format PTR resource record
+      error = dnsSdResponderFormatPtrRecord(context->interface, message,
+         service, context->ttl);
+      //Any error to report?
+      if(error)
+         return error;
+
+      //Format SRV resource record
+      error = dnsSdResponderFormatSrvRecord(context->interface, message,
+         service, TRUE, context->ttl);
+      //Any error to report?
+      if(error)
+         return error;
+
+      //Format TXT resource record
+      error = dnsSdResponderFormatTxtRecord(context->interface, message,
+         service, TRUE, context->ttl);
+      //Any error to report?
+      if(error)
+         return error;
+   }
+
+   //Any record to announce?
+   if(message->dnsHeader->ancount > 0)
+   {
+      //The address records of the host are placed in the Additional Section,
+      //so that the services can be reached without any further query
+      mdnsResponderGenerateAdditionalRecords(
+         context->interface->mdnsResponderContext, message, FALSE);
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Format the goodbye records of a range of services
+ * @param[in] context Pointer to the DNS-SD responder context
+ * @param[in,out] message Pointer to the mDNS message
+ * @param[in] first Index of the first service
+ * @param[in] last Index of the last service
+ * @return Error code
+ **/
+
+static error_t dnsSdResponderFormatGoodbye(DnsSdResponderContext *context,
+   MdnsMessage *message, uint_t first, uint_t last)
+{
+   error_t error;
+   uint_t i;
+   DnsSdResponderService *service;
+
+   //Loop through the services
+   for(i = first; i <= last; i++)
+   {
+      //Point to the current service
+      service = &context->services[i];
+
+      //Skip the services that are not being removed
+      if(!service->pending)
+         continue;
+
+      //A PTR record with a TTL of zero removes the service instance from the
+      //caches of the browsers
+      error = dnsSdResponderFormatPtrRecord(context->interface, message,
+         service, 0);
+      //Any error to report?
+      if(error)
+         return error;
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Send the records of all pending services in as few packets as possible
+ *
+ * Starting from the first pending service, the following services are
+ * added one at a time for as long as the whole message fits within
+ * MDNS_MESSAGE_MAX_SIZE
+ *
+ * @param[in] context Pointer to the DNS-SD responder context
+ * @param[in] format Function that formats the records of a range of services
+ * @param[in] queryResponse This flag specifies whether the message is a query
+ *   or a response
+ * @return Error code
+ **/
+
+static error_t dnsSdResponderSendBatch(DnsSdResponderContext *context,
+   DnsSdResponderFormatBatch format, bool_t queryResponse)
+{
+   error_t error;
+   uint_t first;
+   uint_t last;
+   uint_t next;
+   MdnsMessage message;
+
+   //Initialize status code
+   error = NO_ERROR;
+
+   //Loop through the services
+   for(first = 0; first < context->numServices; first = last + 1)
+   {
+      //By default, the packet holds a single service
+      last = first;
+
+      //Skip the services that have nothing to send
+      if(!context->services[first].pending)
+         continue;
+
+      //Create an empty mDNS message
+      error = mdnsCreateMessage(&message, queryResponse);
+      //Any error to report?
+      if(error)
+         break;
+
+      //Format the records of the first service
+      error = format(context, &message, first, first);
+
+      //Check status code
+      if(!error)
+      {
+         //Aggregate the records of the following services
+         for(next = first + 1; next < context->numServices; next++)
+         {
+            //Skip the services that have nothing to send
+            if(!context->services[next].pending)
+               continue;
+
+            //Format the records of the extended range
+            dnsSdResponderResetMessage(&message);
+            error = format(context, &message, first, next);
+
+            //The extended range does not fit in a single packet?
+            if(error)
+               break;
+
+            //Save the index of the last service of the packet
+            last = next;
+         }
+
+         //The last attempt failed?
+         if(error)
+         {
+            //Format the records of the range that fits
+            dnsSdResponderResetMessage(&message);
+            error = format(context, &message, first, last);
+         }
+
+         //Any record to send?
+         if(!error && (message.dnsHeader->qdcount > 0 ||
+            message.dnsHeader->ancount > 0))
+         {
+            //Send mDNS message
+            error = mdnsSendMessage(context->interface, &message, NULL,
+               MDNS_PORT);
+         }
+      }
+
+      //Free previously allocated memory
+      mdnsDeleteMessage(&message);
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Send probe packets
+ *
+ * The probes of all the pending services are aggregated
+ *
+ * @param[in] context Pointer to the DNS-SD responder context
+ * @return Error code
+ **/
+
+error_t dnsSdResponderSendProbe(DnsSdResponderContext *context)
+{
+   //Send mDNS queries
+   return dnsSdResponderSendBatch(context, dnsSdResponderFormatProbe, FALSE);
+}
+
+
+/**
+ * @brief Send announcement packets
+ *
+ * The announcements of all the pending services are aggregated
+ *
+ * @param[in] context Pointer to the DNS-SD responder context
+ * @return Error code
+ **/
+
+error_t dnsSdResponderSendAnnouncement(DnsSdResponderContext *context)
+{
+   //Send mDNS responses
+   return dnsSdResponderSendBatch(context, dnsSdResponderFormatAnnouncement,
+      TRUE);
+}
+
+
+/**
+ * @brief Send goodbye packets
+ *
+ * The goodbyes of all the pending services are aggregated
+ *
+ * @param[in] context Pointer to the DNS-SD responder context
+ * @return Error code
+ **/
+
+error_t dnsSdResponderSendGoodbye(DnsSdResponderContext *context)
+{
+   //Send mDNS responses
+   return dnsSdResponderSendBatch(context, dnsSdResponderFormatGoodbye, TRUE);
+}
+
+
+/**
+ * @brief Repeat the question in a legacy unicast response
+ * @param[in] query Incoming mDNS query message
+ * @param[in] question Pointer to the question
+ * @param[in] instance Instance name
+ * @param[in] service Service name
+ * @param[in,out] response mDNS response message
+ **/
+
+static void dnsSdResponderRepeatQuestion(const MdnsMessage *query,
+   const DnsQuestion *question, const char_t *instance, const char_t *service,
+   MdnsMessage *response)
+{
+   size_t n;
+   DnsQuestion *dnsQuestion;
+
+   //Check whether the querier originating the query is a simple resolver
+   if(ntohs(query->udpHeader->srcPort) != MDNS_PORT)
+   {
+      //The question must precede the answers
+      if(response->dnsHeader->qdcount == 0 && response->dnsHeader->ancount == 0)
+      {
+         //The first pass calculates the length of the DNS encoded name
+         n = mdnsEncodeName(instance, service, ".local", NULL);
+
+         //Check the length of the resulting mDNS message
+         if((response->length + n + sizeof(DnsQuestion)) <= MDNS_MESSAGE_MAX_SIZE)
+         {
+            //This unicast response must be a conventional unicast response as
+            //would be generated by a conventional unicast DNS server. It must
+            //repeat the question given in the query message (refer to RFC 6762,
+            //section 6.7)
+            response->length += mdnsEncodeName(instance, service, ".local",
+               (uint8_t *) response->dnsHeader + response->length);
+
+            //Point to the corresponding question structure
+            dnsQuestion = DNS_GET_QUESTION(response->dnsHeader, response->length);
+
+            //Fill in question structure
+            dnsQuestion->qtype = question->qtype;
+            dnsQuestion->qclass = htons(ntohs(question->qclass) & ~MDNS_QCLASS_QU);
+
+            //Update the length of the mDNS response message
+            response->length += sizeof(DnsQuestion);
+            //Number of questions in the Question Section
+            response->dnsHeader->qdcount++;
+         }
+      }
+   }
+}
+
+
+/**
+ * @brief Parse a question
+ * @param[in] interface Underlying network interface
+ * @param[in] query Incoming mDNS query message
+ * @param[in] offset Offset to first byte of the question
+ * @param[in] question Pointer to the question
+ * @param[in,out] response mDNS response message
+ * @return Error code
+ **/
+
+error_t dnsSdResponderParseQuestion(NetInterface *interface,
+   const MdnsMessage *query, size_t offset, const DnsQuestion *question,
+   MdnsMessage *response)
+{
+   error_t error;
+   uint_t i;
+   uint16_t qclass;
+   uint16_t qtype;
+   uint32_t ttl;
+   bool_t cacheFlush;
+   DnsSdResponderContext *context;
+   DnsSdResponderService *service;
+
+   //Point to the DNS-SD responder context
+   context = interface->dnsSdResponderContext;
+   //Make sure the DNS-SD responder has been properly instantiated
+   if(context == NULL)
+      return NO_ERROR;
+
+   //Convert the query class to host byte order
+   qclass = ntohs(question->qclass);
+   //Discard QU flag
+   qclass &= ~MDNS_QCLASS_QU;
+
+   //Convert the query type to host byte order
+   qtype = ntohs(question->qtype);
+
+   //Get the TTL resource record
+   ttl = context->ttl;
+
+   //Check whether the querier originating the query is a simple resolver
+   if(ntohs(query->udpHeader->srcPort) != MDNS_PORT)
+   {
+      //The resource record TTL given in a legacy unicast response should
+      //not be greater than ten seconds, even if the true TTL of the mDNS
+      //resource record is higher
+      ttl = MIN(ttl, MDNS_LEGACY_UNICAST_RR_TTL);
+
+      //The cache-flush bit must not be set in legacy unicast responses
+      cacheFlush = FALSE;
+   }
+   else
+   {
+      //The cache-bit should be set for unique resource records
+      cacheFlush = TRUE;
+   }
+
+   //Check the class of the query
+   if(qclass != DNS_RR_CLASS_IN && qclass != DNS_RR_CLASS_ANY)
+      return NO_ERROR;
+
+   //Loop through the list of DNS-SD services
+   for(i = 0; i < context->numServices; i++)
+   {
+      //Point to the current service
+      service = &context->services[i];
+
+      //Do not respond to mDNS queries during probing
+      if(service->state != MDNS_STATE_ANNOUNCING &&
+         service->state != MDNS_STATE_IDLE)
+      {
+         continue;
+      }
+
+      //Service type enumeration?
+      if(!mdnsCompareName(query->dnsHeader, query->length, offset,
+         "", DNS_SD_SERVICE_ENUM_NAME, ".local", 0))
+      {
+         //PTR query?
+         if(qtype == DNS_RR_TYPE_PTR || qtype == DNS_RR_TYPE_ANY)
+         {
+            //Repeat the question in legacy unicast responses
+            dnsSdResponderRepeatQuestion(query, question, "",
+               DNS_SD_SERVICE_ENUM_NAME, response);
+
+            //Format PTR resource record (service type enumeration)
+            error = dnsSdResponderFormatServiceEnumPtrRecord(interface,
+               response, service, ttl);
+            //Any error to report?
+            if(error)
+               return error;
+
+            //The PTR record is shared with the other services of that type
+            response->sharedRecordCount++;
+         }
+      }
+      //Service instance enumeration (browsing)?
+      else if(!mdnsCompareName(query->dnsHeader, query->length, offset,
+         "", service->serviceName, ".local", 0))
+      {
+         //PTR query?
+         if(qtype == DNS_RR_TYPE_PTR || qtype == DNS_RR_TYPE_ANY)
+         {
+            //Repeat the question in legacy unicast responses
+            dnsSdResponderRepeatQuestion(query, question, "",
+               service->serviceName, response);
+
+            //Format PTR resource record
+            error = dnsSdResponderFormatPtrRecord(interface, response,
+               service, ttl);
+            //Any error to report?
+            if(error)
+               return error;
+
+            //The PTR record is shared with the other instances of the service
+            response->sharedRecordCount++;
+         }
+      }
+      //Service instance resolution?
+      else if(!mdnsCompareName(query->dnsHeader, query->length, offset,
+         service->instanceName, service->serviceName, ".local", 0))
+      {
+         //Repeat the question in legacy unicast responses
+         dnsSdResponderRepeatQuestion(query, question, service->instanceName,
+            service->serviceName, response);
+
+         //SRV query?
+         if(qtype == DNS_RR_TYPE_SRV)
+         {
+            //Format SRV resource record
+            error = dnsSdResponderFormatSrvRecord(interface, response,
+               service, cacheFlush, ttl);
+            //Any error to report?
+            if(error)
+               return error;
+         }
+         //TXT query?
+         else if(qtype == DNS_RR_TYPE_TXT)
+         {
+            //Format TXT resource record
+            error = dnsSdResponderFormatTxtRecord(interface, response,
+               service, cacheFlush, ttl);
+            //Any error to report?
+            if(error)
+               return error;
+         }
+         //ANY query?
+         else if(qtype == DNS_RR_TYPE_ANY)
+         {
+            //Format SRV resource record
+            error = dnsSdResponderFormatSrvRecord(interface, response,
+               service, cacheFlush, ttl);
+            //Any error to report?
+            if(error)
+               return error;
+
+            //Format TXT resource record
+            error = dnsSdResponderFormatTxtRecord(interface, response,
+               service, cacheFlush, ttl);
+            //Any error to report?
+            if(error)
+               return error;
+
+            //Format NSEC resource record
+            error = dnsSdResponderFormatNsecRecord(interface, response,
+               service, cacheFlush, ttl);
+            //Any error to report?
+            if(error)
+               return error;
+         }
+         else
+         {
+            //Format NSEC resource record
+            error = dnsSdResponderFormatNsecRecord(interface, response,
+               service, cacheFlush, ttl);
+            //Any error to report?
+            if(error)
+               return error;
+         }
+      }
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Parse the Authority Section
+ * @param[in] interface Underlying network interface
+ * @param[in] query Incoming mDNS query message
+ * @param[in] offset Offset to first byte of the Authority Section
+ **/
+
+void dnsSdResponderParseNsRecords(NetInterface *interface,
+   const MdnsMessage *query, size_t offset)
+{
+   uint_t i;
+   uint_t j;
+   int_t res;
+   DnsResourceRecord *record;
+   DnsSdResponderContext *context;
+   DnsSdResponderService *service;
+
+   //Point to the DNS-SD responder context
+   context = interface->dnsSdResponderContext;
+   //Make sure the DNS-SD responder has been properly instantiated
+   if(context == NULL)
+      return;
+
+   //Loop through the list of DNS-SD services
+   for(i = 0; i < context->numServices; i++)
+   {
+      //Point to the current service
+      service = &context->services[i];
+
+      //Only the services that are being probed are concerned
+      if(service->state != MDNS_STATE_PROBING)
+         continue;
+
+      //Get the first tiebreaker record in lexicographical order
+      record = dnsSdResponderGetNextTiebreakerRecord(service, query, offset,
+         NULL);
+
+      //The records of the service, sorted in lexicographical order, are the
+      //TXT record (type 16) followed by the SRV record (type 33)
+      for(j = 0; ; j++)
+      {
+         //The records are compared pairwise
+         if(record == NULL && j >= 2)
+         {
+            //If both lists run out of records at the same time without any
+            //difference being found, then this indicates that two devices are
+            //advertising identical sets of records, as is sometimes done for
+            //fault tolerance, and there is, in fact, no conflict
+            break;
+         }
+         else if(record != NULL && j >= 2)
+         {
+            //If either list of records runs out of records before any
+            //difference is found, then the list with records remaining is
+            //deemed to have won the tiebreak
+            service->tieBreakLost = TRUE;
+            break;
+         }
+         else if(record == NULL)
+         {
+            //The host has won the tiebreak
+            break;
+         }
+         else
+         {
+            //The two records are compared and the lexicographically later
+            //data wins
+            if(j == 0)
+            {
+               res = dnsSdResponderCompareTxtRecord(service, query, record);
+            }
+            else
+            {
+               res = dnsSdResponderCompareSrvRecord(interface, service, query,
+                  record);
+            }
+
+            //Check comparison result
+            if(res > 0)
+            {
+               //If the host finds that its own data is lexicographically
+               //earlier, then it defers to the winning host by waiting one
+               //second, and then begins probing for this record again
+               service->tieBreakLost = TRUE;
+               break;
+            }
+            else if(res < 0)
+            {
+               //If the host finds that its own data is lexicographically
+               //later, it simply ignores the other host's probe
+               break;
+            }
+            else
+            {
+               //When comparing the records, if the first records match
+               //perfectly, then the second records are compared, and so on
+            }
+         }
+
+         //Get the next tiebreaker record in lexicographical order
+         record = dnsSdResponderGetNextTiebreakerRecord(service, query, offset,
+            record);
+      }
+   }
+}
+
+
+/**
+ * @brief Parse a resource record from the Answer Section
+ * @param[in] interface Underlying network interface
+ * @param[in] response Incoming mDNS response message
+ * @param[in] offset Offset to first byte of the resource record to be checked
+ * @param[in] record Pointer to the resource record
+ **/
+
+void dnsSdResponderParseAnRecord(NetInterface *interface,
+   const MdnsMessage *response, size_t offset, const DnsResourceRecord *record)
+{
+   uint_t i;
+   uint16_t rclass;
+   DnsSdResponderContext *context;
+   DnsSdResponderService *service;
+
+   //Point to the DNS-SD responder context
+   context = interface->dnsSdResponderContext;
+   //Make sure the DNS-SD responder has been properly instantiated
+   if(context == NULL)
+      return;
+
+   //Convert the class to host byte order
+   rclass = ntohs(record->rclass);
+   //Discard Cache Flush flag
+   rclass &= ~MDNS_RCLASS_CACHE_FLUSH;
+
+   //Check the class of the resource record
+   if(rclass != DNS_RR_CLASS_IN)
+      return;
+
+   //Loop through the list of DNS-SD services
+   for(i = 0; i < context->numServices; i++)
+   {
+      //Point to the current service
+      service = &context->services[i];
+
+      //Skip the services that are not probed or announced
+      if(service->state == MDNS_STATE_INIT)
+         continue;
+
+      //Check for conflicts
+      if(!mdnsCompareName(response->dnsHeader, response->length, offset,
+         service->instanceName, service->serviceName, ".local", 0))
+      {
+         //A conflict occurs when a mDNS responder has a unique record for
+         //which it is currently authoritative, and it receives a mDNS
+         //response message containing a record with the same name, rrtype
+         //and rrclass, but inconsistent rdata
+         if(ntohs(record->rtype) == DNS_RR_TYPE_SRV)
+         {
+            //Compare the contents of the SRV resource records
+            if(dnsSdResponderCompareSrvRecord(interface, service, response,
+               record))
+            {
+               //The service instance name is already in use by some other host
+               service->conflict = TRUE;
+            }
+         }
+         else if(ntohs(record->rtype) == DNS_RR_TYPE_TXT)
+         {
+            //Compare the contents of the TXT resource records
+            if(dnsSdResponderCompareTxtRecord(service, response, record))
+            {
+               //The service instance name is already in use by some other host
+               service->conflict = TRUE;
+            }
+         }
+      }
+   }
+}
+
+
+/**
+ * @brief Generate additional records
+ * @param[in] interface Underlying network interface
+ * @param[in,out] response mDNS response message
+ * @param[in] legacyUnicast This flag is set for legacy unicast responses
+ **/
+
+void dnsSdResponderGenerateAdditionalRecords(NetInterface *interface,
+   MdnsMessage *response, bool_t legacyUnicast)
+{
+#if (DNS_SD_ADDITIONAL_RECORDS_SUPPORT == ENABLED)
+   uint_t i;
+   uint_t j;
+   uint_t k;
+   size_t n;
+   size_t offset;
+   uint_t ancount;
+   uint16_t rclass;
+   uint32_t ttl;
+   bool_t cacheFlush;
+   DnsResourceRecord *record;
+   DnsSdResponderContext *context;
+   DnsSdResponderService *service;
+
+   //Point to the DNS-SD responder context
+   context = interface->dnsSdResponderContext;
+   //Make sure the DNS-SD responder has been properly instantiated
+   if(context == NULL)
+      return;
+
+   //Get the TTL resource record
+   ttl = context->ttl;
+
+   //Check whether the querier originating the query is a simple resolver
+   if(legacyUnicast)
+   {
+      //The resource record TTL given in a legacy unicast response should
+      //not be greater than ten seconds, even if the true TTL of the mDNS
+      //resource record is higher
+      ttl = MIN(ttl, MDNS_LEGACY_UNICAST_RR_TTL);
+
+      //The cache-flush bit must not be set in legacy unicast responses
+      cacheFlush = FALSE;
+   }
+   else
+   {
+      //The cache-bit should be set for unique resource records
+      cacheFlush = TRUE;
+   }
+
+   //Point to the first question
+   offset = sizeof(DnsHeader);
+
+   //Skip the question section
+   for(i = 0; i < response->dnsHeader->qdcount; i++)
+   {
+      //Parse domain name
+      offset = dnsParseName(response->dnsHeader, response->length, offset, NULL, 0);
+      //Invalid name?
+      if(!offset)
+         break;
+
+      //Point to the next question
+      offset += sizeof(DnsQuestion);
+      //Make sure the mDNS message is valid
+      if(offset > response->length)
+         break;
+   }
+
+   //Save the number of resource records in the Answer Section
+   ancount = response->dnsHeader->ancount;
+
+   //Compute the total number of resource records
+   k = response->dnsHeader->ancount + response->dnsHeader->nscount +
+      response->dnsHeader->arcount;
+
+   //Loop through the resource records
+   for(i = 0; i < k; i++)
+   {
+      //Parse resource record name
+      n = dnsParseName(response->dnsHeader, response->length, offset, NULL, 0);
+      //Invalid name?
+      if(!n)
+         break;
+
+      //Point to the associated resource record
+      record = DNS_GET_RESOURCE_RECORD(response->dnsHeader, n);
+      //Point to the resource data
+      n += sizeof(DnsResourceRecord);
+
+      //Make sure the resource record is valid
+      if(n > response->length)
+         break;
+      if((n + ntohs(record->rdlength)) > response->length)
+         break;
+
+      //Convert the record class to host byte order
+      rclass = ntohs(record->rclass);
+      //Discard the cache-flush bit
+      rclass &= ~MDNS_RCLASS_CACHE_FLUSH;
+
+      //PTR record?
+      if(rclass == DNS_RR_CLASS_IN && ntohs(record->rtype) == DNS_RR_TYPE_PTR)
+      {
+         //Loop through the list of DNS-SD services
+         for(j = 0; j < context->numServices; j++)
+         {
+            //Point to the current service
+            service = &context->services[j];
+
+            //Skip the services that are not announced
+            if(service->state != MDNS_STATE_ANNOUNCING &&
+               service->state != MDNS_STATE_IDLE)
+            {
+               continue;
+            }
+
+            //Does the PTR record point to the service instance?
+            if(!mdnsCompareName(response->dnsHeader, response->length, offset,
+               "", service->serviceName, ".local", 0) &&
+               !mdnsCompareName(response->dnsHeader, response->length, n,
+               service->instanceName, service->serviceName, ".local", 0))
+            {
+               //When including a PTR record in a response packet, the server
+               //should include the SRV and TXT records named in the PTR rdata
+               //(refer to RFC 6763, section 12.1)
+               dnsSdResponderFormatSrvRecord(interface, response, service,
+                  cacheFlush, ttl);
+
+               dnsSdResponderFormatTxtRecord(interface, response, service,
+                  cacheFlush, ttl);
+            }
+         }
+      }
+
+      //Point to the next resource record
+      offset = n + ntohs(record->rdlength);
+   }
+
+   //Number of resource records in the Additional Section
+   response->dnsHeader->arcount += response->dnsHeader->ancount - ancount;
+   //Number of resource records in the Answer Section
+   response->dnsHeader->ancount = ancount;
+#endif
+}
+
+
+/**
+ * @brief Append a resource record to a mDNS message
+ * @param[in,out] message Pointer to the mDNS message
+ * @param[in] instance Instance name
+ * @param[in] service Service name
+ * @param[in] rtype Resource record type
+ * @param[in] rdata Resource record data
+ * @param[in] rdlength Length of the resource record data, in bytes
+ * @param[in] cacheFlush Cache-flush bit
+ * @param[in] ttl Resource record TTL (cache lifetime)
+ * @return Error code
+ **/
+
+static error_t dnsSdResponderFormatRecord(MdnsMessage *message,
+   const char_t *instance, const char_t *service, uint16_t rtype,
+   const uint8_t *rdata, size_t rdlength, bool_t cacheFlush, uint32_t ttl)
+{
+   size_t n;
+   size_t offset;
+   bool_t duplicate;
+   DnsResourceRecord *record;
+
+   //Check whether the resource record is already present in the Answer
+   //Section of the message
+   duplicate = mdnsCheckDuplicateRecord(message, instance, service, ".local",
+      rtype, rdata, rdlength);
+
+   //The duplicates should be suppressed and the resource record should
+   //appear only once in the list
+   if(!duplicate)
+   {
+      //Set the position to the end of the buffer
+      offset = message->length;
+
+      //The first pass calculates the length of the DNS encoded name
+      n = mdnsEncodeName(instance, service, ".local", NULL);
+
+      //Check the length of the resulting mDNS message
+      if((offset + n + sizeof(DnsResourceRecord) + rdlength) > MDNS_MESSAGE_MAX_SIZE)
+         return ERROR_MESSAGE_TOO_LONG;
+
+      //The second pass encodes the name using the DNS name notation
+      offset += mdnsEncodeName(instance, service, ".local",
+         (uint8_t *) message->dnsHeader + offset);
+
+      //Point to the corresponding resource record
+      record = DNS_GET_RESOURCE_RECORD(message->dnsHeader, offset);
+
+      //Fill in resource record
+      record->rtype = htons(rtype);
+      record->rclass = HTONS(DNS_RR_CLASS_IN);
+      record->ttl = htonl(ttl);
+      record->rdlength = htons(rdlength);
+
+      //Check whether the cache-flush bit should be set
+      if(cacheFlush)
+      {
+         record->rclass |= HTONS(MDNS_RCLASS_CACHE_FLUSH);
+      }
+
+      //Copy the resource record data
+      osMemcpy(record->rdata, rdata, rdlength);
+
+      //Number of resource records in the answer section
+      message->dnsHeader->ancount++;
+      //Update the length of the mDNS message
+      message->length = offset + sizeof(DnsResourceRecord) + rdlength;
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Format PTR resource record (service type enumeration)
+ * @param[in] interface Underlying network interface
+ * @param[in,out] message Pointer to the mDNS message
+ * @param[in] service Pointer to a DNS-SD service
+ * @param[in] ttl Resource record TTL (cache lifetime)
+ * @return Error code
+ **/
+
+error_t dnsSdResponderFormatServiceEnumPtrRecord(NetInterface *interface,
+   MdnsMessage *message, const DnsSdResponderService *service, uint32_t ttl)
+{
+   size_t n;
+   uint8_t rdata[DNS_NAME_MAX_SIZE];
+
+   //The PTR record points to the service type
+   n = mdnsEncodeName("", service->serviceName, ".local", rdata);
+
+   //The PTR record is a shared resource record
+   return dnsSdResponderFormatRecord(message, "", DNS_SD_SERVICE_ENUM_NAME,
+      DNS_RR_TYPE_PTR, rdata, n, FALSE, ttl);
+}
+
+
+/**
+ * @brief Format PTR resource record
+ * @param[in] interface Underlying network interface
+ * @param[in,out] message Pointer to the mDNS message
+ * @param[in] service Pointer to a DNS-SD service
+ * @param[in] ttl Resource record TTL (cache lifetime)
+ * @return Error code
+ **/
+
+error_t dnsSdResponderFormatPtrRecord(NetInterface *interface,
+   MdnsMessage *message, const DnsSdResponderService *service, uint32_t ttl)
+{
+   size_t n;
+   uint8_t rdata[DNS_NAME_MAX_SIZE];
+
+   //The PTR record points to the service instance
+   n = mdnsEncodeName(service->instanceName, service->serviceName, ".local",
+      rdata);
+
+   //The PTR record is a shared resource record
+   return dnsSdResponderFormatRecord(message, "", service->serviceName,
+      DNS_RR_TYPE_PTR, rdata, n, FALSE, ttl);
+}
+
+
+/**
+ * @brief Format SRV resource record
+ * @param[in] interface Underlying network interface
+ * @param[in,out] message Pointer to the mDNS message
+ * @param[in] service Pointer to a DNS-SD service
+ * @param[in] cacheFlush Cache-flush bit
+ * @param[in] ttl Resource record TTL (cache lifetime)
+ * @return Error code
+ **/
+
+error_t dnsSdResponderFormatSrvRecord(NetInterface *interface,
+   MdnsMessage *message, const DnsSdResponderService *service,
+   bool_t cacheFlush, uint32_t ttl)
+{
+   size_t n;
+   MdnsResponderContext *mdnsResponderContext;
+   uint8_t rdata[6 + DNS_NAME_MAX_SIZE];
+
+   //Point to the mDNS responder context
+   mdnsResponderContext = interface->mdnsResponderContext;
+
+   //Priority, weight and port fields
+   STORE16BE(service->priority, rdata);
+   STORE16BE(service->weight, rdata + 2);
+   STORE16BE(service->port, rdata + 4);
+
+   //The target field holds the host name
+   n = mdnsEncodeName(mdnsResponderContext->hostname, "", ".local", rdata + 6);
+
+   //Format SRV resource record
+   return dnsSdResponderFormatRecord(message, service->instanceName,
+      service->serviceName, DNS_RR_TYPE_SRV, rdata, n + 6, cacheFlush, ttl);
+}
+
+
+/**
+ * @brief Format TXT resource record
+ * @param[in] interface Underlying network interface
+ * @param[in,out] message Pointer to the mDNS message
+ * @param[in] service Pointer to a DNS-SD service
+ * @param[in] cacheFlush Cache-flush bit
+ * @param[in] ttl Resource record TTL (cache lifetime)
+ * @return Error code
+ **/
+
+error_t dnsSdResponderFormatTxtRecord(NetInterface *interface,
+   MdnsMessage *message, const DnsSdResponderService *service,
+   bool_t cacheFlush, uint32_t ttl)
+{
+   static const uint8_t emptyTxt[1] = {0};
+
+   //Any discovery-time metadata?
+   if(service->metadataLen > 0)
+   {
+      //Format TXT resource record
+      return dnsSdResponderFormatRecord(message, service->instanceName,
+         service->serviceName, DNS_RR_TYPE_TXT, service->metadata,
+         service->metadataLen, cacheFlush, ttl);
+   }
+   else
+   {
+      //An empty TXT record contains a single zero byte (refer to RFC 6763,
+      //section 6.1)
+      return dnsSdResponderFormatRecord(message, service->instanceName,
+         service->serviceName, DNS_RR_TYPE_TXT, emptyTxt, sizeof(emptyTxt),
+         cacheFlush, ttl);
+   }
+}
+
+
+/**
+ * @brief Format NSEC resource record
+ * @param[in] interface Underlying network interface
+ * @param[in,out] message Pointer to the mDNS message
+ * @param[in] service Pointer to a DNS-SD service
+ * @param[in] cacheFlush Cache-flush bit
+ * @param[in] ttl Resource record TTL (cache lifetime)
+ * @return Error code
+ **/
+
+error_t dnsSdResponderFormatNsecRecord(NetInterface *interface,
+   MdnsMessage *message, const DnsSdResponderService *service,
+   bool_t cacheFlush, uint32_t ttl)
+{
+   size_t n;
+   uint8_t bitmap[8];
+   uint8_t rdata[DNS_NAME_MAX_SIZE + 2 + 5];
+
+   //The bitmap identifies the resource record types that exist
+   osMemset(bitmap, 0, sizeof(bitmap));
+
+   //The service instance has TXT and SRV records
+   DNS_SET_NSEC_BITMAP(bitmap, DNS_RR_TYPE_TXT);
+   DNS_SET_NSEC_BITMAP(bitmap, DNS_RR_TYPE_SRV);
+
+   //The Next Domain Name field contains the record's own name
+   n = mdnsEncodeName(service->instanceName, service->serviceName, ".local",
+      rdata);
+
+   //DNS NSEC record is limited to Window Block number zero
+   rdata[n++] = 0;
+   //Trailing zero octets in the bitmap must be omitted
+   rdata[n++] = 5;
+
+   //The Bitmap data identifies the resource record types that exist
+   osMemcpy(rdata + n, bitmap, 5);
+
+   //Format NSEC resource record
+   return dnsSdResponderFormatRecord(message, service->instanceName,
+      service->serviceName, DNS_RR_TYPE_NSEC, rdata, n + 5, cacheFlush, ttl);
+}
+
+
+/**
+ * @brief Sort the tiebreaker records in lexicographical order
+ * @param[in] service Pointer to a DNS-SD service
+ * @param[in] query Incoming mDNS query message
+ * @param[in] offset Offset to first byte of the Authority Section
+ * @param[in] record Pointer to the current record
+ * @return Pointer to the next record, if any
+ **/
+
+DnsResourceRecord *dnsSdResponderGetNextTiebreakerRecord(
+   DnsSdResponderService *service, const MdnsMessage *query, size_t offset,
+   DnsResourceRecord *record)
+{
+   uint_t i;
+   size_t n;
+   int_t res;
+   DnsResourceRecord *curRecord;
+   DnsResourceRecord *nextRecord;
+
+   //Initialize record pointer
+   nextRecord = NULL;
+
+   //Parse Authority Section
+   for(i = 0; i < ntohs(query->dnsHeader->nscount); i++)
+   {
+      //Parse resource record name
+      n = dnsParseName(query->dnsHeader, query->length, offset, NULL, 0);
+      //Invalid name?
+      if(!n)
+         break;
+
+      //Point to the associated resource record
+      curRecord = DNS_GET_RESOURCE_RECORD(query->dnsHeader, n);
+      //Point to the resource data
+      n += sizeof(DnsResourceRecord);
+
+      //Make sure the resource record is valid
+      if(n > query->length)
+         break;
+      if((n + ntohs(curRecord->rdlength)) > query->length)
+         break;
+
+      //Matching service instance name?
+      if(!mdnsCompareName(query->dnsHeader, query->length, offset,
+         service->instanceName, service->serviceName, ".local", 0))
+      {
+         //Perform lexicographical comparison
+         if(record != NULL)
+         {
+            res = mdnsCompareRecord(query, curRecord, query, record);
+         }
+         else
+         {
+            res = 1;
+         }
+
+         //Check whether the record is lexicographically later
+         if(res > 0)
+         {
+            if(nextRecord == NULL)
+            {
+               nextRecord = curRecord;
+            }
+            else if(mdnsCompareRecord(query, curRecord, query, nextRecord) < 0)
+            {
+               nextRecord = curRecord;
+            }
+         }
+      }
+
+      //Point to the next resource record
+      offset = n + ntohs(curRecord->rdlength);
+   }
+
+   //Return the pointer to the next record
+   return nextRecord;
+}
+
+
+/**
+ * @brief Compare a resource record with the SRV record of a service
+ * @param[in] interface Underlying network interface
+ * @param[in] service Pointer to a DNS-SD service
+ * @param[in] message Pointer to the received mDNS message
+ * @param[in] record Pointer to the resource record
+ * @return The function returns 0 if the resource records match, -1 if the
+ *   received record lexicographically precedes the host's record, or 1 if
+ *   the host's record lexicographically precedes the received record
+ **/
+
+int_t dnsSdResponderCompareSrvRecord(NetInterface *interface,
+   DnsSdResponderService *service, const MdnsMessage *message,
+   const DnsResourceRecord *record)
+{
+   int_t res;
+   size_t n;
+   uint16_t value;
+   uint8_t rdata[6];
+   MdnsResponderContext *mdnsResponderContext;
+
+   //Point to the mDNS responder context
+   mdnsResponderContext = interface->mdnsResponderContext;
+
+   //Convert the record class to host byte order
+   value = ntohs(record->rclass);
+   //Discard cache-flush bit
+   value &= ~MDNS_RCLASS_CACHE_FLUSH;
+
+   //The determination of lexicographically later record is performed by
+   //first comparing the record class (excluding the cache-flush bit)
+   if(value != DNS_RR_CLASS_IN)
+      return (value < DNS_RR_CLASS_IN) ? -1 : 1;
+
+   //Convert the record type to host byte order
+   value = ntohs(record->rtype);
+
+   //Then compare the record type
+   if(value != DNS_RR_TYPE_SRV)
+      return (value < DNS_RR_TYPE_SRV) ? -1 : 1;
+
+   //Retrieve the length of the rdata field
+   n = ntohs(record->rdlength);
+
+   //Priority, weight and port fields of the host's record
+   STORE16BE(service->priority, rdata);
+   STORE16BE(service->weight, rdata + 2);
+   STORE16BE(service->port, rdata + 4);
+
+   //Compare the fixed part of the rdata
+   res = osMemcmp(record->rdata, rdata, MIN(n, sizeof(rdata)));
+
+   //The received record runs out of rdata?
+   if(res == 0 && n <= sizeof(rdata))
+      res = -1;
+
+   //The fixed parts match?
+   if(res == 0)
+   {
+      //Offset of the target field
+      n = record->rdata + sizeof(rdata) - (uint8_t *) message->dnsHeader;
+
+      //The target may be compressed in the received message
+      res = mdnsCompareName(message->dnsHeader, message->length, n,
+         mdnsResponderContext->hostname, "", ".local", 0);
+
+      //Malformed name?
+      if(res < -1)
+         res = -1;
+   }
+
+   //Return comparison result
+   return (res < 0) ? -1 : ((res > 0) ? 1 : 0);
+}
+
+
+/**
+ * @brief Compare a resource record with the TXT record of a service
+ * @param[in] service Pointer to a DNS-SD service
+ * @param[in] message Pointer to the received mDNS message
+ * @param[in] record Pointer to the resource record
+ * @return The function returns 0 if the resource records match, -1 if the
+ *   received record lexicographically precedes the host's record, or 1 if
+ *   the host's record lexicographically precedes the received record
+ **/
+
+int_t dnsSdResponderCompareTxtRecord(DnsSdResponderService *service,
+   const MdnsMessage *message, const DnsResourceRecord *record)
+{
+   int_t res;
+   size_t n1;
+   size_t n2;
+   uint16_t value;
+   const uint8_t *data;
+   static const uint8_t emptyTxt[1] = {0};
+
+   //Convert the record class to host byte order
+   value = ntohs(record->rclass);
+   //Discard cache-flush bit
+   value &= ~MDNS_RCLASS_CACHE_FLUSH;
+
+   //The determination of lexicographically later record is performed by
+   //first comparing the record class (excluding the cache-flush bit)
+   if(value != DNS_RR_CLASS_IN)
+      return (value < DNS_RR_CLASS_IN) ? -1 : 1;
+
+   //Convert the record type to host byte order
+   value = ntohs(record->rtype);
+
+   //Then compare the record type
+   if(value != DNS_RR_TYPE_TXT)
+      return (value < DNS_RR_TYPE_TXT) ? -1 : 1;
+
+   //Retrieve the length of the rdata fields
+   n1 = ntohs(record->rdlength);
+
+   //Any discovery-time metadata?
+   if(service->metadataLen > 0)
+   {
+      data = service->metadata;
+      n2 = service->metadataLen;
+   }
+   else
+   {
+      data = emptyTxt;
+      n2 = sizeof(emptyTxt);
+   }
+
+   //The bytes of the raw uncompressed rdata are compared in turn
+   res = osMemcmp(record->rdata, data, MIN(n1, n2));
+
+   //The resource record which still has remaining data first is deemed
+   //lexicographically later
+   if(res == 0)
+   {
+      if(n1 < n2)
+      {
+         res = -1;
+      }
+      else if(n1 > n2)
+      {
+         res = 1;
+      }
+   }
+
+   //Return comparison result
+   return (res < 0) ? -1 : ((res > 0) ? 1 : 0);
+}
+
+#endif
@@ -46,9 +46,9 @@ void dnsSdResponderChangeState(DnsSdResponderService *service,
 
 void dnsSdResponderChangeInstanceName(DnsSdResponderService *service);
 
-error_t dnsSdResponderSendProbe(DnsSdResponderService *service);
-error_t dnsSdResponderSendAnnouncement(DnsSdResponderService *service);
-error_t dnsSdResponderSendGoodbye(DnsSdResponderService *service);
+error_t dnsSdResponderSendProbe(DnsSdResponderContext *context);
+error_t dnsSdResponderSendAnnouncement(DnsSdResponderContext *context);
+error_t dnsSdResponderSendGoodbye(DnsSdResponderContext *context);
 
 error_t dnsSdResponderParseQuestion(NetInterface *interface,
    const MdnsMessage *query, size_t offset, const DnsQuestion *question,
@@ -0,0 +1,403 @@
+/**
+ * @file loopback_driver.c
+ * @brief Loopback interface driver
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * Packets sent to an address of the host are moved from the transmit side
+ * to the receive side of the stack without leaving the device. The buffer
+ * passed by the sender is held and queued by reference, then delivered by
+ * the TCP/IP task, so that the receive path never runs nested in the
+ * transmit path. Since the packet cannot be corrupted on the way, the
+ * checksums are neither inserted nor verified
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL NIC_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "drivers/loopback/loopback_driver.h"
+#include "debug.h"
+
+//Packet queue
+static LoopbackDriverQueueEntry loopbackDriverQueue[LOOPBACK_DRIVER_QUEUE_SIZE];
+static uint_t loopbackDriverQueueLength;
+static uint_t loopbackDriverQueueIndex;
+
+//Packets split across several chunks are flattened here before delivery
+static uint8_t loopbackDriverFrame[ETH_MTU];
+
+//Statistics
+static LoopbackDriverStats loopbackDriverStats;
+
+
+/**
+ * @brief Loopback interface driver
+ **/
+
+const NicDriver loopbackDriver =
+{
+   NIC_TYPE_LOOPBACK,
+   ETH_MTU,
+   loopbackDriverInit,
+   loopbackDriverTick,
+   loopbackDriverEnableIrq,
+   loopbackDriverDisableIrq,
+   loopbackDriverEventHandler,
+   loopbackDriverSendPacket,
+   loopbackDriverUpdateMacAddrFilter,
+   NULL,
+   NULL,
+   NULL,
+   TRUE,
+   TRUE,
+   TRUE,
+   TRUE,
+#if (ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
+   TRUE,
+   TRUE,
+#endif
+   NULL,
+#if (ETH_VLAN_SUPPORT == ENABLED)
+   FALSE
+#endif
+};
+
+
+/**
+ * @brief Loopback interface initialization
+ * @param[in] interface Underlying network interface
+ * @return Error code
+ **/
+
+error_t loopbackDriverInit(NetInterface *interface)
+{
+   //Debug message
+   TRACE_INFO("Initializing loopback interface...\r\n");
+
+   //The queue is initially empty
+   loopbackDriverQueueLength = 0;
+   loopbackDriverQueueIndex = 0;
+
+   //The loopback interface is always up
+   interface->linkState = TRUE;
+   interface->linkSpeed = NIC_LINK_SPEED_UNKNOWN;
+   interface->duplexMode = NIC_UNKNOWN_DUPLEX_MODE;
+
+   //Process link state change event
+   nicNotifyLinkChange(interface);
+
+   //Accept any packets from the upper layer
+   osSetEvent(&interface->nicTxEvent);
+
+   //Successful initialization
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Loopback interface timer handler
+ *
+ * This routine is periodically called by the TCP/IP stack to handle periodic
+ * operations such as polling the link state
+ *
+ * @param[in] interface Underlying network interface
+ **/
+
+void loopbackDriverTick(NetInterface *interface)
+{
+}
+
+
+/**
+ * @brief Enable interrupts
+ * @param[in] interface Underlying network interface
+ **/
+
+void loopbackDriverEnableIrq(NetInterface *interface)
+{
+}
+
+
+/**
+ * @brief Disable interrupts
+ * @param[in] interface Underlying network interface
+ **/
+
+void loopbackDriverDisableIrq(NetInterface *interface)
+{
+}
+
+
+/**
+ * @brief Loopback interface event handler
+ * @param[in] interface Underlying network interface
+ **/
+
+void loopbackDriverEventHandler(NetInterface *interface)
+{
+   uint_t n;
+   error_t error;
+
+   //The packets drained below are delivered as a single batch
+   nicBeginRxBatch(interface);
+
+   //Process queued packets, within the limit of the RX budget
+   for(n = 0; n < LOOPBACK_DRIVER_RX_BUDGET; n++)
+   {
+      //Deliver the oldest packet
+      error = loopbackDriverReceivePacket(interface);
+
+      //No more packets in the queue?
+      if(error == ERROR_BUFFER_EMPTY)
+         break;
+   }
+
+   //Notify the sockets that received data during the batch
+   nicEndRxBatch(interface);
+
+   //Packets are still pending (possibly queued while processing the others)?
+   if(loopbackDriverQueueLength > 0)
+   {
+      //The TCP/IP stack will call the event handler again
+      interface->nicEvent = TRUE;
+      osSetEvent(&netEvent);
+   }
+}
+
+
+/**
+ * @brief Send a packet
+ * @param[in] interface Underlying network interface
+ * @param[in] buffer Multi-part buffer containing the data to send
+ * @param[in] offset Offset to the first data byte
+ * @param[in] ancillary Additional options passed to the stack along with
+ *   the packet
+ * @return Error code
+ **/
+
+error_t loopbackDriverSendPacket(NetInterface *interface,
+   const NetBuffer *buffer, size_t offset, NetTxAncillary *ancillary)
+{
+   error_t error;
+   uint_t i;
+   size_t length;
+   NetBuffer *copy;
+   LoopbackDriverQueueEntry *entry;
+
+   //Retrieve the length of the packet
+   length = netBufferGetLength(buffer) - offset;
+
+   //Check the frame length
+   if(length > ETH_MTU)
+   {
+      //Report an error
+      return ERROR_INVALID_LENGTH;
+   }
+
+   //Make sure the queue is not full
+   if(loopbackDriverQueueLength >= LOOPBACK_DRIVER_QUEUE_SIZE)
+   {
+      //Update statistics
+      loopbackDriverStats.dropped++;
+      //Report an error
+      return ERROR_FAILURE;
+   }
+
+   //Point to the next free entry
+   i = (loopbackDriverQueueIndex + loopbackDriverQueueLength) %
+      LOOPBACK_DRIVER_QUEUE_SIZE;
+
+   entry = &loopbackDriverQueue[i];
+
+   //The sender frees the buffer right after the call and does not modify it
+   //in the meantime?
+   if(ancillary->zeroCopy)
+   {
+      //Defer the release of the buffer until the packet is delivered
+      error = netBufferHold(buffer);
+   }
+   else
+   {
+      //The buffer must be copied
+      error = ERROR_NOT_IMPLEMENTED;
+   }
+
+   //Check status code
+   if(!error)
+   {
+      //Queue the buffer of the sender
+      entry->buffer = buffer;
+      entry->offset = offset;
+      entry->held = TRUE;
+
+      //Update statistics
+      loopbackDriverStats.zeroCopy++;
+   }
+   else
+   {
+      //Allocate a buffer the driver owns
+      copy = netBufferAlloc(length);
+      //Failed to allocate memory?
+      if(copy == NULL)
+         return ERROR_OUT_OF_MEMORY;
+
+      //Copy the packet
+      error = netBufferCopy(copy, 0, buffer, offset, length);
+      //Any error to report?
+      if(error)
+      {
+         netBufferFree(copy);
+         return error;
+      }
+
+      //Queue the copy
+      entry->buffer = copy;
+      entry->offset = 0;
+      entry->held = FALSE;
+
+      //Update statistics
+      loopbackDriverStats.copied++;
+   }
+
+   //Save the length of the packet
+   entry->length = length;
+
+   //Update the length of the queue
+   loopbackDriverQueueLength++;
+
+   //The packet is delivered by the TCP/IP task
+   interface->nicEvent = TRUE;
+   osSetEvent(&netEvent);
+
+   //The transmitter can accept another packet
+   osSetEvent(&interface->nicTxEvent);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Deliver the oldest queued packet
+ * @param[in] interface Underlying network interface
+ * @return Error code
+ **/
+
+error_t loopbackDriverReceivePacket(NetInterface *interface)
+{
+   uint8_t *packet;
+   LoopbackDriverQueueEntry entry;
+   NetRxAncillary ancillary;
+
+   //The queue is empty?
+   if(loopbackDriverQueueLength == 0)
+      return ERROR_BUFFER_EMPTY;
+
+   //Remove the oldest entry from the queue. The queue may be refilled by the
+   //replies sent while the packet is processed
+   entry = loopbackDriverQueue[loopbackDriverQueueIndex];
+
+   loopbackDriverQueueIndex = (loopbackDriverQueueIndex + 1) %
+      LOOPBACK_DRIVER_QUEUE_SIZE;
+
+   loopbackDriverQueueLength--;
+
+   //The packet is usually contiguous, since the headers are pushed into the
+   //headroom of the chunk holding the payload
+   packet = netBufferAt(entry.buffer, entry.offset, entry.length);
+
+   //The packet is split across several chunks?
+   if(packet == NULL)
+   {
+      //Flatten the packet
+      netBufferRead(loopbackDriverFrame, entry.buffer, entry.offset,
+         entry.length);
+
+      packet = loopbackDriverFrame;
+
+      //Update statistics
+      loopbackDriverStats.linearized++;
+   }
+
+   //Additional options can be passed to the stack along with the packet
+   ancillary = NET_DEFAULT_RX_ANCILLARY;
+
+#if (ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
+   //The checksums were not inserted by the sender, and the packet has not
+   //left the host
+   ancillary.ipChecksumValid = TRUE;
+   ancillary.payloadChecksumValid = TRUE;
+#endif
+
+   //Pass the packet to the upper layer
+   nicProcessPacket(interface, packet, entry.length, &ancillary);
+
+   //Give the buffer back
+   if(entry.held)
+   {
+      netBufferRelease(entry.buffer);
+   }
+   else
+   {
+      netBufferFree((NetBuffer *) entry.buffer);
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Configure MAC address filtering
+ * @param[in] interface Underlying network interface
+ * @return Error code
+ **/
+
+error_t loopbackDriverUpdateMacAddrFilter(NetInterface *interface)
+{
+   //Not implemented
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Get loopback interface statistics
+ * @param[out] stats Statistics of the loopback interface
+ **/
+
+void loopbackDriverGetStats(LoopbackDriverStats *stats)
+{
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Copy the statistics
+   *stats = loopbackDriverStats;
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+}
@@ -41,18 +41,44 @@
    #error LOOPBACK_DRIVER_QUEUE_SIZE parameter is not valid
 #endif
 
+//Maximum number of packets delivered per call to the event handler
+#ifndef LOOPBACK_DRIVER_RX_BUDGET
+   #define LOOPBACK_DRIVER_RX_BUDGET 8
+#elif (LOOPBACK_DRIVER_RX_BUDGET < 1)
+   #error LOOPBACK_DRIVER_RX_BUDGET parameter is not valid
+#endif
+
 
 /**
  * @brief Loopback interface queue entry
+ *
+ * The entry references the buffer passed to the driver, which is held until
+ * the packet has been delivered. A copy is made only when the owner of the
+ * buffer keeps using it after the call
  **/
 
 typedef struct
 {
-   size_t length;
-   uint8_t data[ETH_MTU];
+   const NetBuffer *buffer; ///<Buffer holding the packet
+   size_t offset;           ///<Offset to the first byte of the packet
+   size_t length;           ///<Length of the packet
+   bool_t held;             ///<The buffer belongs to the sender and is held
 } LoopbackDriverQueueEntry;
 
 
+/**
+ * @brief Loopback interface statistics
+ **/
+
+typedef struct
+{
+   uint32_t zeroCopy;   ///<Packets queued by reference
+   uint32_t copied;     ///<Packets whose buffer had to be copied
+   uint32_t linearized; ///<Packets split across chunks, flattened on delivery
+   uint32_t dropped;    ///<Packets dropped, queue full
+} LoopbackDriverStats;
+
+
 //Loopback interface driver
 extern const NicDriver loopbackDriver;
 
@@ -72,4 +98,6 @@ error_t loopbackDriverReceivePacket(NetInterface *interface);
 
 error_t loopbackDriverUpdateMacAddrFilter(NetInterface *interface);
 
+void loopbackDriverGetStats(LoopbackDriverStats *stats);
+
 #endif
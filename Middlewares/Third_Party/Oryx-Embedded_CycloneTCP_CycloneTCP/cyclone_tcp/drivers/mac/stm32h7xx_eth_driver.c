@@ -35,54 +35,194 @@
 #include "stm32h7xx.h"
 #include "stm32h7xx_hal.h"
 #include "core/net.h"
+#include "ipv4/arp.h"
+#include "ipv4/icmp.h"
+#include "ipv4/ipv4_misc.h"
+#include "ipv4/ipv4_firewall.h"
 #include "drivers/mac/stm32h7xx_eth_driver.h"
 #include "debug.h"
 
 //Underlying network interface
 static NetInterface *nicDriverInterface;
 
+//Receive interrupt coalescing?
+#if (STM32H7XX_ETH_RX_IRQ_WATCHDOG > 0)
+   //Frames are reported by the RX interrupt watchdog timer
+   #define STM32H7XX_ETH_RDES3_IOC 0
+#else
+   //An interrupt is generated for every received frame
+   #define STM32H7XX_ETH_RDES3_IOC ETH_RDES3_IOC
+#endif
+
+//Cache maintenance of DMA buffers?
+#if (STM32H7XX_ETH_CACHE_MAINTENANCE == ENABLED)
+   //Write back data before the DMA reads it
+   #define STM32H7XX_ETH_CLEAN_DCACHE(p, n) \
+      SCB_CleanDCache_by_Addr((uint32_t *) (p), (int32_t) (n))
+   //Discard stale lines before the CPU reads data written by the DMA
+   #define STM32H7XX_ETH_INVALIDATE_DCACHE(p, n) \
+      SCB_InvalidateDCache_by_Addr((void *) (p), (int32_t) (n))
+#else
+   #define STM32H7XX_ETH_CLEAN_DCACHE(p, n)
+   #define STM32H7XX_ETH_INVALIDATE_DCACHE(p, n)
+#endif
+
+//Hardware checksum offload? Checksums can only be inserted in frames held
+//in full by the TX FIFO, which jumbo frames do not fit in
+#if (ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED && STM32H7XX_ETH_JUMBO_SUPPORT == DISABLED)
+   //Insert IP header checksum and TCP/UDP/ICMP checksum, pseudo-header included
+   #define STM32H7XX_ETH_TDES3_CIC ETH_TDES3_CIC
+   #define STM32H7XX_ETH_TX_CHECKSUM_OFFLOAD TRUE
+#else
+   #define STM32H7XX_ETH_TDES3_CIC 0
+   #define STM32H7XX_ETH_TX_CHECKSUM_OFFLOAD FALSE
+#endif
+
+//State of a received frame with regard to the offload responder
+#define STM32H7XX_ETH_RX_OFFLOAD_NONE    0
+#define STM32H7XX_ETH_RX_OFFLOAD_SCANNED 1
+#define STM32H7XX_ETH_RX_OFFLOAD_REPLIED 2
+
+//Zero-copy reception?
+#if (NET_MEM_RX_LOAN_SUPPORT == ENABLED)
+   //Spare buffers are used to re-arm descriptors whose buffer is on loan
+   #define STM32H7XX_ETH_RX_POOL_SIZE (STM32H7XX_ETH_RX_BUFFER_COUNT + \
+      STM32H7XX_ETH_RX_LOAN_BUFFER_COUNT)
+#else
+   #define STM32H7XX_ETH_RX_POOL_SIZE STM32H7XX_ETH_RX_BUFFER_COUNT
+#endif
+
 //IAR EWARM compiler?
 #if defined(__ICCARM__)
 
 //Transmit buffer
-#pragma data_alignment = 4
-#pragma location = STM32H7XX_ETH_RAM_SECTION
+#pragma data_alignment = 32
+#pragma location = STM32H7XX_ETH_BUFFER_SECTION
 static uint8_t txBuffer[STM32H7XX_ETH_TX_BUFFER_COUNT][STM32H7XX_ETH_TX_BUFFER_SIZE];
 //Receive buffer
-#pragma data_alignment = 4
-#pragma location = STM32H7XX_ETH_RAM_SECTION
-static uint8_t rxBuffer[STM32H7XX_ETH_RX_BUFFER_COUNT][STM32H7XX_ETH_RX_BUFFER_SIZE];
+#pragma data_alignment = 32
+#pragma location = STM32H7XX_ETH_BUFFER_SECTION
+static uint8_t rxBuffer[STM32H7XX_ETH_RX_POOL_SIZE][STM32H7XX_ETH_RX_BUFFER_SIZE];
 //Transmit DMA descriptors
 #pragma data_alignment = 4
-#pragma location = STM32H7XX_ETH_RAM_SECTION
+#pragma location = STM32H7XX_ETH_DESC_SECTION
 static Stm32h7xxTxDmaDesc txDmaDesc[STM32H7XX_ETH_TX_BUFFER_COUNT];
 //Receive DMA descriptors
 #pragma data_alignment = 4
-#pragma location = STM32H7XX_ETH_RAM_SECTION
+#pragma location = STM32H7XX_ETH_DESC_SECTION
 static Stm32h7xxRxDmaDesc rxDmaDesc[STM32H7XX_ETH_RX_BUFFER_COUNT];
 
+#if (STM32H7XX_ETH_JUMBO_SUPPORT == ENABLED)
+//Frame gathered from several receive descriptors
+#pragma data_alignment = 4
+static uint8_t rxFrameBuffer[STM32H7XX_ETH_MAX_FRAME_SIZE];
+#endif
+
 //Keil MDK-ARM or GCC compiler?
 #else
 
 //Transmit buffer
 static uint8_t txBuffer[STM32H7XX_ETH_TX_BUFFER_COUNT][STM32H7XX_ETH_TX_BUFFER_SIZE]
-   __attribute__((aligned(4), __section__(STM32H7XX_ETH_RAM_SECTION)));
+   __attribute__((aligned(32), __section__(STM32H7XX_ETH_BUFFER_SECTION)));
 //Receive buffer
-static uint8_t rxBuffer[STM32H7XX_ETH_RX_BUFFER_COUNT][STM32H7XX_ETH_RX_BUFFER_SIZE]
-   __attribute__((aligned(4), __section__(STM32H7XX_ETH_RAM_SECTION)));
+static uint8_t rxBuffer[STM32H7XX_ETH_RX_POOL_SIZE][STM32H7XX_ETH_RX_BUFFER_SIZE]
+   __attribute__((aligned(32), __section__(STM32H7XX_ETH_BUFFER_SECTION)));
 //Transmit DMA descriptors
 static Stm32h7xxTxDmaDesc txDmaDesc[STM32H7XX_ETH_TX_BUFFER_COUNT]
-   __attribute__((aligned(4), __section__(STM32H7XX_ETH_RAM_SECTION)));
+   __attribute__((aligned(4), __section__(STM32H7XX_ETH_DESC_SECTION)));
 //Receive DMA descriptors
 static Stm32h7xxRxDmaDesc rxDmaDesc[STM32H7XX_ETH_RX_BUFFER_COUNT]
-   __attribute__((aligned(4), __section__(STM32H7XX_ETH_RAM_SECTION)));
+   __attribute__((aligned(4), __section__(STM32H7XX_ETH_DESC_SECTION)));
+
+#if (STM32H7XX_ETH_JUMBO_SUPPORT == ENABLED)
+//Frame gathered from several receive descriptors
+static uint8_t rxFrameBuffer[STM32H7XX_ETH_MAX_FRAME_SIZE]
+   __attribute__((aligned(4)));
+#endif
 
 #endif
 
+//Number of TX descriptors in use
+static uint_t txRingSize = STM32H7XX_ETH_TX_BUFFER_COUNT;
+//Number of RX descriptors in use
+static uint_t rxRingSize = STM32H7XX_ETH_RX_BUFFER_COUNT;
+
 //Current transmit descriptor
 static uint_t txIndex;
 //Current receive descriptor
 static uint_t rxIndex;
+//Descriptors written but not yet notified to the DMA
+static bool_t txKickPending;
+//Receive path statistics
+static Stm32h7xxEthRxStats rxStats;
+//The receive DMA has stopped and must be restarted
+static volatile bool_t rxDmaRestartPending;
+
+//Hardware VLAN tagging?
+#if (ETH_VLAN_SUPPORT == ENABLED && STM32H7XX_ETH_VLAN_OFFLOAD_SUPPORT == ENABLED)
+//VLAN tag last passed to the MAC through a context descriptor
+static uint16_t txVlanTag;
+#endif
+
+//Zero-copy transmission?
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+//Buffer to release once the descriptor has been processed by the DMA
+static const NetBuffer *txDescNetBuffer[STM32H7XX_ETH_TX_BUFFER_COUNT];
+//Number of buffers currently referenced by the DMA
+static volatile uint_t txHeldCount;
+#endif
+
+//Hardware time stamping?
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+//Identifier of the frame whose transmit time stamp is awaited, or -1
+static int32_t txTimestampId[STM32H7XX_ETH_TX_BUFFER_COUNT];
+//Number of transmit time stamps awaited
+static volatile uint_t txTimestampCount;
+//Addend of the PTP clock at its nominal frequency
+static uint32_t ptpNominalAddend;
+//Frequency correction applied on top of the nominal addend (ppb)
+static int32_t ptpFreqAdj;
+#endif
+
+//Time-triggered transmission?
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+//The DMA is not notified of new descriptors until the launch time
+static volatile bool_t txLaunchPending;
+//PTP time at which the held frames are sent
+static NetTimestamp txLaunchTime;
+//Time-triggered transmission statistics
+static Stm32h7xxEthLaunchStats launchStats;
+#endif
+
+//Zero-copy reception?
+#if (NET_MEM_RX_LOAN_SUPPORT == ENABLED)
+//Buffer currently attached to each receive descriptor
+static uint8_t *rxDescBuffer[STM32H7XX_ETH_RX_BUFFER_COUNT];
+//Spare receive buffers
+static uint8_t *rxSpareBuffer[STM32H7XX_ETH_RX_LOAN_BUFFER_COUNT];
+//Number of spare receive buffers
+static uint_t rxSpareCount;
+#endif
+
+//Jumbo frames?
+#if (STM32H7XX_ETH_JUMBO_SUPPORT == ENABLED)
+//Number of bytes gathered so far (0 if no frame is being gathered)
+static size_t rxFrameLength;
+#endif
+
+//Wake-on-LAN?
+#if (STM32H7XX_ETH_WOL_SUPPORT == ENABLED)
+//PMT status latched by the wakeup interrupt
+static volatile uint32_t pmtStatus;
+//Wake-on-LAN statistics
+static Stm32h7xxEthWolStats wolStats;
+#endif
+
+//Offload responder?
+#if (STM32H7XX_ETH_OFFLOAD_SUPPORT == ENABLED)
+//Whether each received frame has been inspected or answered by the responder
+static volatile uint8_t rxOffloadState[STM32H7XX_ETH_RX_BUFFER_COUNT];
+#endif
 
 
 /**
@@ -92,7 +232,7 @@ static uint_t rxIndex;
 const NicDriver stm32h7xxEthDriver =
 {
    NIC_TYPE_ETHERNET,
-   ETH_MTU,
+   STM32H7XX_ETH_MTU,
    stm32h7xxEthInit,
    stm32h7xxEthTick,
    stm32h7xxEthEnableIrq,
@@ -106,7 +246,19 @@ const NicDriver stm32h7xxEthDriver =
    TRUE,
    TRUE,
    TRUE,
+   FALSE,
+#if (ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
+   STM32H7XX_ETH_TX_CHECKSUM_OFFLOAD,
+   TRUE,
+#endif
+   stm32h7xxEthFlushTx,
+#if (ETH_VLAN_SUPPORT == ENABLED)
+#if (STM32H7XX_ETH_VLAN_OFFLOAD_SUPPORT == ENABLED)
+   TRUE
+#else
    FALSE
+#endif
+#endif
 };
 
 
@@ -175,9 +327,26 @@ error_t stm32h7xxEthInit(NetInterface *interface)
    //Use default MAC configuration
    ETH->MACCR = ETH_MACCR_GPSLCE | ETH_MACCR_RESERVED15 | ETH_MACCR_DO;
 
+#if (ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
+   //Enable IPv4 header and TCP/UDP/ICMP checksum verification
+   ETH->MACCR |= ETH_MACCR_IPC;
+#endif
+
+#if (STM32H7XX_ETH_JUMBO_SUPPORT == ENABLED)
+   //Accept jumbo frames. The watchdog and jabber timers are raised to
+   //10240 bytes accordingly
+   ETH->MACCR |= ETH_MACCR_JE;
+#endif
+
    //Set the maximum packet size that can be accepted
    temp = ETH->MACECR & ~ETH_MACECR_GPSL;
-   ETH->MACECR = temp | STM32H7XX_ETH_RX_BUFFER_SIZE;
+   ETH->MACECR = temp | STM32H7XX_ETH_MAX_FRAME_SIZE;
+
+#if (ETH_VLAN_SUPPORT == ENABLED && STM32H7XX_ETH_VLAN_OFFLOAD_SUPPORT == ENABLED)
+   //The VLAN tag to be inserted in a transmitted frame is given by the
+   //context descriptors
+   ETH->MACVIR = ETH_MACVIR_VLTI;
+#endif
 
    //Configure MAC address filtering
    stm32h7xxEthUpdateMacAddrFilter(interface);
@@ -186,6 +355,11 @@ error_t stm32h7xxEthInit(NetInterface *interface)
    ETH->MACTFCR = 0;
    ETH->MACRFCR = 0;
 
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+   //Start the PTP clock
+   stm32h7xxEthInitPtp(interface);
+#endif
+
    //Configure DMA operating mode
    ETH->DMAMR = ETH_DMAMR_INTM_0 | ETH_DMAMR_PR_1_1;
    //Configure system bus mode
@@ -200,13 +374,36 @@ error_t stm32h7xxEthInit(NetInterface *interface)
    ETH->DMACRCR = ETH_DMACRCR_RPBL_32PBL;
    ETH->DMACRCR |= (STM32H7XX_ETH_RX_BUFFER_SIZE << 1) & ETH_DMACRCR_RBSZ;
 
+#if (STM32H7XX_ETH_JUMBO_SUPPORT == ENABLED)
+   //Jumbo frames do not fit in the 2 KB FIFOs, which are therefore operated
+   //in threshold mode
+   temp = ETH->MTLTQOMR & ~(ETH_MTLTQOMR_TSF | ETH_MTLTQOMR_TTC);
+   ETH->MTLTQOMR = temp | ETH_MTLTQOMR_TTC_512BITS;
+   temp = ETH->MTLRQOMR & ~(ETH_MTLRQOMR_RSF | ETH_MTLRQOMR_RTC);
+   ETH->MTLRQOMR = temp | ETH_MTLRQOMR_RTC_128BITS;
+#else
    //Enable store and forward mode
    ETH->MTLTQOMR |= ETH_MTLTQOMR_TSF;
    ETH->MTLRQOMR |= ETH_MTLRQOMR_RSF;
+#endif
 
    //Initialize DMA descriptor lists
    stm32h7xxEthInitDmaDesc(interface);
 
+#if (NET_MEM_RX_LOAN_SUPPORT == ENABLED)
+   //Receive buffers can be loaned to the stack
+   error = memPoolRegisterLoanRegion(rxBuffer, sizeof(rxBuffer),
+      stm32h7xxEthReleaseRxBuffer);
+   //Any error to report?
+   if(error)
+   {
+      return error;
+   }
+#endif
+
+   //The statistic counters are harvested periodically and cleared on read
+   ETH->MMCCR = ETH_MMCCR_RSTONRD | ETH_MMCCR_CNTRST;
+
    //Prevent interrupts from being generated when the transmit statistic
    //counters reach half their maximum value
    ETH->MMCTIMR = ETH_MMCTIMR_TXLPITRCIM | ETH_MMCTIMR_TXLPIUSCIM |
@@ -219,8 +416,16 @@ error_t stm32h7xxEthInit(NetInterface *interface)
 
    //Disable MAC interrupts
    ETH->MACIER = 0;
-   //Enable the desired DMA interrupts
-   ETH->DMACIER = ETH_DMACIER_NIE | ETH_DMACIER_RIE | ETH_DMACIER_TIE;
+   //Enable the desired DMA interrupts. The abnormal ones report a full RX
+   //descriptor ring, a stopped receive process and fatal bus errors
+   ETH->DMACIER = ETH_DMACIER_NIE | ETH_DMACIER_RIE | ETH_DMACIER_TIE |
+      ETH_DMACIER_AIE | ETH_DMACIER_RBUE | ETH_DMACIER_RSE | ETH_DMACIER_FBEE;
+
+   //Configure the RX interrupt watchdog timer
+   ETH->DMACRIWTR = STM32H7XX_ETH_RX_IRQ_WATCHDOG & ETH_DMACRIWTR_RWT;
+
+   //The interface is initially interrupt-driven
+   interface->nicPolling = FALSE;
 
    //Set priority grouping (4 bits for pre-emption priority, no bits for subpriority)
    NVIC_SetPriorityGrouping(STM32H7XX_ETH_IRQ_PRIORITY_GROUPING);
@@ -427,40 +632,141 @@ void stm32h7xxEthInitDmaDesc(NetInterface *interface)
    uint_t i;
 
    //Initialize TX DMA descriptor list
-   for(i = 0; i < STM32H7XX_ETH_TX_BUFFER_COUNT; i++)
+   for(i = 0; i < txRingSize; i++)
    {
       //The descriptor is initially owned by the application
       txDmaDesc[i].tdes0 = 0;
       txDmaDesc[i].tdes1 = 0;
       txDmaDesc[i].tdes2 = 0;
       txDmaDesc[i].tdes3 = 0;
+
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+      //Release any buffer still attached to the descriptor
+      if(txDescNetBuffer[i] != NULL)
+      {
+         netBufferRelease(txDescNetBuffer[i]);
+         txDescNetBuffer[i] = NULL;
+      }
+#endif
+
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+      //No time stamp is awaited for the descriptor
+      txTimestampId[i] = -1;
+#endif
    }
 
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+   //No buffer is referenced by the DMA
+   txHeldCount = 0;
+#endif
+
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+   //No transmit time stamp is awaited
+   txTimestampCount = 0;
+#endif
+
+#if (ETH_VLAN_SUPPORT == ENABLED && STM32H7XX_ETH_VLAN_OFFLOAD_SUPPORT == ENABLED)
+   //No VLAN tag has been passed to the MAC yet
+   txVlanTag = 0;
+#endif
+
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+   //No frame is held until a launch time
+   txLaunchPending = FALSE;
+   ETH->MACIER &= ~ETH_MACIER_TSIE;
+#endif
+
    //Initialize TX descriptor index
    txIndex = 0;
+   //No descriptor is waiting for the DMA to be notified
+   txKickPending = FALSE;
+
+#if (NET_MEM_RX_LOAN_SUPPORT == ENABLED)
+   //Each descriptor is initially attached to its own buffer
+   for(i = 0; i < rxRingSize; i++)
+   {
+      rxDescBuffer[i] = rxBuffer[i];
+   }
+
+   //The remaining buffers are kept in reserve
+   for(i = 0; i < STM32H7XX_ETH_RX_LOAN_BUFFER_COUNT; i++)
+   {
+      rxSpareBuffer[i] = rxBuffer[STM32H7XX_ETH_RX_BUFFER_COUNT + i];
+   }
+
+   //Number of spare buffers
+   rxSpareCount = STM32H7XX_ETH_RX_LOAN_BUFFER_COUNT;
+#endif
+
+   //Make sure no dirty line can be evicted over data written by the DMA
+   STM32H7XX_ETH_INVALIDATE_DCACHE(rxBuffer, sizeof(rxBuffer));
 
    //Initialize RX DMA descriptor list
-   for(i = 0; i < STM32H7XX_ETH_RX_BUFFER_COUNT; i++)
+   for(i = 0; i < rxRingSize; i++)
    {
       //The descriptor is initially owned by the DMA
       rxDmaDesc[i].rdes0 = (uint32_t) rxBuffer[i];
       rxDmaDesc[i].rdes1 = 0;
       rxDmaDesc[i].rdes2 = 0;
-      rxDmaDesc[i].rdes3 = ETH_RDES3_OWN | ETH_RDES3_IOC | ETH_RDES3_BUF1V;
+      rxDmaDesc[i].rdes3 = ETH_RDES3_OWN | STM32H7XX_ETH_RDES3_IOC |
+         ETH_RDES3_BUF1V;
    }
 
    //Initialize RX descriptor index
    rxIndex = 0;
 
+#if (STM32H7XX_ETH_JUMBO_SUPPORT == ENABLED)
+   //No frame is being gathered
+   rxFrameLength = 0;
+#endif
+
+#if (STM32H7XX_ETH_OFFLOAD_SUPPORT == ENABLED)
+   //No frame has been inspected by the offload responder
+   for(i = 0; i < STM32H7XX_ETH_RX_BUFFER_COUNT; i++)
+   {
+      rxOffloadState[i] = STM32H7XX_ETH_RX_OFFLOAD_NONE;
+   }
+#endif
+
    //Start location of the TX descriptor list
    ETH->DMACTDLAR = (uint32_t) &txDmaDesc[0];
    //Length of the transmit descriptor ring
-   ETH->DMACTDRLR = STM32H7XX_ETH_TX_BUFFER_COUNT - 1;
+   ETH->DMACTDRLR = txRingSize - 1;
 
    //Start location of the RX descriptor list
    ETH->DMACRDLAR = (uint32_t) &rxDmaDesc[0];
    //Length of the receive descriptor ring
-   ETH->DMACRDRLR = STM32H7XX_ETH_RX_BUFFER_COUNT - 1;
+   ETH->DMACRDRLR = rxRingSize - 1;
+}
+
+
+/**
+ * @brief Set the number of descriptors of the TX and RX rings
+ *
+ * This function must be called before the interface is initialized. The
+ * number of descriptors cannot exceed the compile-time limits set by
+ * STM32H7XX_ETH_TX_BUFFER_COUNT and STM32H7XX_ETH_RX_BUFFER_COUNT
+ *
+ * @param[in] txCount Number of TX descriptors
+ * @param[in] rxCount Number of RX descriptors
+ * @return Error code
+ **/
+
+error_t stm32h7xxEthSetRingSize(uint_t txCount, uint_t rxCount)
+{
+   //Check parameters
+   if(txCount < 1 || txCount > STM32H7XX_ETH_TX_BUFFER_COUNT)
+      return ERROR_INVALID_PARAMETER;
+
+   if(rxCount < 1 || rxCount > STM32H7XX_ETH_RX_BUFFER_COUNT)
+      return ERROR_INVALID_PARAMETER;
+
+   //Save the size of the descriptor rings
+   txRingSize = txCount;
+   rxRingSize = rxCount;
+
+   //Successful processing
+   return NO_ERROR;
 }
 
 
@@ -475,6 +781,16 @@ void stm32h7xxEthInitDmaDesc(NetInterface *interface)
 
 void stm32h7xxEthTick(NetInterface *interface)
 {
+   //Collect the drop counters of the MAC before they saturate
+   stm32h7xxEthUpdateDropStats(interface);
+   //Collect the error counters of the MMC
+   stm32h7xxEthUpdateMmcStats(interface);
+
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+   //Release held frames whose launch time moved out of range
+   stm32h7xxEthCheckLaunch(interface);
+#endif
+
    //Valid Ethernet PHY or switch driver?
    if(interface->phyDriver != NULL)
    {
@@ -553,7 +869,7 @@ void stm32h7xxEthDisableIrq(NetInterface *interface)
  * @brief STM32H7 Ethernet MAC interrupt service routine
  **/
 
-void ETH_IRQHandler(void)
+__net_fast_func void ETH_IRQHandler(void)
 {
    bool_t flag;
    uint32_t status;
@@ -561,6 +877,9 @@ void ETH_IRQHandler(void)
    //Interrupt service routine prologue
    osEnterIsr();
 
+   //Start of the interrupt handler (timing hook)
+   STM32H7XX_ETH_IRQ_ENTER_HOOK();
+
    //This flag will be set if a higher priority task must be woken
    flag = FALSE;
 
@@ -579,6 +898,39 @@ void ETH_IRQHandler(void)
          //Notify the TCP/IP stack that the transmitter is ready to send
          flag |= osSetEventFromIsr(&nicDriverInterface->nicTxEvent);
       }
+
+#if (NIC_TX_QUEUE_SIZE > 0)
+      //Frames waiting in the TX queue can now be sent
+      if(!nicIsTxQueueEmpty(nicDriverInterface))
+      {
+         //Set event flag
+         nicDriverInterface->nicEvent = TRUE;
+         //Notify the TCP/IP stack of the event
+         flag |= osSetEventFromIsr(&netEvent);
+      }
+#endif
+
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+      //Buffers transmitted without copy must be given back to the stack
+      if(txHeldCount > 0)
+      {
+         //Set event flag
+         nicDriverInterface->nicEvent = TRUE;
+         //Notify the TCP/IP stack of the event
+         flag |= osSetEventFromIsr(&netEvent);
+      }
+#endif
+
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+      //Transmit time stamps must be reported to the stack
+      if(txTimestampCount > 0)
+      {
+         //Set event flag
+         nicDriverInterface->nicEvent = TRUE;
+         //Notify the TCP/IP stack of the event
+         flag |= osSetEventFromIsr(&netEvent);
+      }
+#endif
    }
 
    //Packet received?
@@ -587,15 +939,91 @@ void ETH_IRQHandler(void)
       //Clear RI interrupt flag
       ETH->DMACSR = ETH_DMACSR_RI;
 
+      //Timestamp the receive interrupt
+      NET_LATENCY_MARK_IRQ();
+
       //Set event flag
       nicDriverInterface->nicEvent = TRUE;
       //Notify the TCP/IP stack of the event
       flag |= osSetEventFromIsr(&netEvent);
    }
 
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+   //Launch time of the held frames reached?
+   if(txLaunchPending && (ETH->MACISR & ETH_MACISR_TSIS) != 0)
+   {
+      //Reading the time stamp status register clears the interrupt
+      status = ETH->MACTSSR;
+
+      //The target time may also have passed while it was being programmed
+      if((status & ETH_MACTSSR_TSTRGTERR0) != 0)
+      {
+         launchStats.late++;
+         stm32h7xxEthLaunch();
+      }
+      else if((status & ETH_MACTSSR_TSTARGT0) != 0)
+      {
+         launchStats.launched++;
+         stm32h7xxEthLaunch();
+      }
+   }
+#endif
+
+   //Abnormal interrupt?
+   if((status & ETH_DMACSR_AIS) != 0)
+   {
+      //The DMA ran out of free descriptors?
+      if((status & ETH_DMACSR_RBU) != 0)
+      {
+         //Clear RBU interrupt flag
+         ETH->DMACSR = ETH_DMACSR_RBU;
+         //Update statistics
+         NET_STATS_IF_INC(nicDriverInterface, rxBufferUnavailable, 1);
+      }
+
+      //Fatal bus error?
+      if((status & ETH_DMACSR_FBE) != 0)
+      {
+         //Clear FBE interrupt flag
+         ETH->DMACSR = ETH_DMACSR_FBE;
+         //Update statistics
+         NET_STATS_IF_INC(nicDriverInterface, dmaBusErrors, 1);
+      }
+
+      //Receive process stopped? The DMA is restarted from the TCP/IP task
+      if((status & (ETH_DMACSR_RPS | ETH_DMACSR_FBE)) != 0)
+      {
+         //Clear RPS interrupt flag
+         ETH->DMACSR = ETH_DMACSR_RPS;
+         rxDmaRestartPending = TRUE;
+      }
+
+      //The TCP/IP stack drains the ring, which resumes a suspended DMA
+      if((status & (ETH_DMACSR_RBU | ETH_DMACSR_RPS | ETH_DMACSR_FBE)) != 0)
+      {
+         //Set event flag
+         nicDriverInterface->nicEvent = TRUE;
+         //Notify the TCP/IP stack of the event
+         flag |= osSetEventFromIsr(&netEvent);
+      }
+
+      //Clear AIS interrupt flag
+      ETH->DMACSR = ETH_DMACSR_AIS;
+   }
+
+#if (STM32H7XX_ETH_OFFLOAD_SUPPORT == ENABLED)
+   //Answer ARP and echo requests without waiting for the TCP/IP stack. The
+   //ring is inspected on every interrupt, so that frames are still answered
+   //while RX interrupts are masked in polling mode
+   stm32h7xxEthOffloadRx(nicDriverInterface);
+#endif
+
    //Clear NIS interrupt flag
    ETH->DMACSR = ETH_DMACSR_NIS;
 
+   //End of the interrupt handler (timing hook)
+   STM32H7XX_ETH_IRQ_EXIT_HOOK();
+
    //Interrupt service routine epilogue
    osExitIsr(flag);
 }
@@ -606,449 +1034,3017 @@ void ETH_IRQHandler(void)
  * @param[in] interface Underlying network interface
  **/
 
-void stm32h7xxEthEventHandler(NetInterface *interface)
+__net_fast_func void stm32h7xxEthEventHandler(NetInterface *interface)
 {
    error_t error;
+   uint_t n;
 
-   //Process all pending packets
-   do
+   //Start of the batch (latency instrumentation)
+   NET_LATENCY_MARK(NET_LATENCY_POINT_EVENT);
+
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+   //Release the buffers whose transmission is complete
+   stm32h7xxEthReclaimTxBuffers(interface);
+#endif
+
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+   //Report the transmit time stamps captured by the MAC
+   stm32h7xxEthCollectTxTimestamps(interface);
+#endif
+
+#if (STM32H7XX_ETH_WOL_SUPPORT == ENABLED)
+   //Wakeup frame received?
+   if(pmtStatus != 0)
+   {
+      stm32h7xxEthExitPowerDown(interface);
+   }
+#endif
+
+   //The receive DMA has stopped?
+   if(rxDmaRestartPending)
+   {
+      rxDmaRestartPending = FALSE;
+      stm32h7xxEthRestartRxDma(interface);
+   }
+
+   //The frames drained below are delivered as a single batch
+   nicBeginRxBatch(interface);
+
+   //Process pending packets, within the limit of the RX budget
+   for(n = 0; n < STM32H7XX_ETH_RX_BUDGET; n++)
    {
       //Read incoming packet
       error = stm32h7xxEthReceivePacket(interface);
 
       //No more data in the receive buffer?
-   } while(error != ERROR_BUFFER_EMPTY);
-}
-
+      if(error == ERROR_BUFFER_EMPTY)
+         break;
+   }
 
-/**
- * @brief Send a packet
- * @param[in] interface Underlying network interface
- * @param[in] buffer Multi-part buffer containing the data to send
- * @param[in] offset Offset to the first data byte
- * @param[in] ancillary Additional options passed to the stack along with
- *   the packet
- * @return Error code
- **/
+   //Notify the sockets that received data during the batch
+   nicEndRxBatch(interface);
 
-error_t stm32h7xxEthSendPacket(NetInterface *interface,
-   const NetBuffer *buffer, size_t offset, NetTxAncillary *ancillary)
-{
-   size_t length;
+   //Collect the drop counters of the MAC
+   stm32h7xxEthUpdateDropStats(interface);
 
-   //Retrieve the length of the packet
-   length = netBufferGetLength(buffer) - offset;
+   //Update statistics
+   rxStats.wakeups++;
+   rxStats.frames += n;
+   rxStats.maxFramesPerWakeup = MAX(rxStats.maxFramesPerWakeup, n);
 
-   //Check the frame length
-   if(length > STM32H7XX_ETH_TX_BUFFER_SIZE)
+   //Budget exhausted while frames are still pending?
+   if(n >= STM32H7XX_ETH_RX_BUDGET &&
+      (rxDmaDesc[rxIndex].rdes3 & ETH_RDES3_OWN) == 0)
    {
-      //The transmitter can accept another packet
-      osSetEvent(&interface->nicTxEvent);
-      //Report an error
-      return ERROR_INVALID_LENGTH;
-   }
+      //Entering polling mode?
+      if(!interface->nicPolling)
+      {
+         //Mask RX interrupts until the ring has been drained
+         ETH->DMACIER &= ~ETH_DMACIER_RIE;
+         interface->nicPolling = TRUE;
 
-   //Make sure the current buffer is available for writing
-   if((txDmaDesc[txIndex].tdes3 & ETH_TDES3_OWN) != 0)
-   {
-      return ERROR_FAILURE;
+         //Update statistics
+         rxStats.budgetExhausted++;
+      }
+
+      //The TCP/IP stack will call the event handler again
+      interface->nicEvent = TRUE;
+      osSetEvent(&netEvent);
    }
+   else if(interface->nicPolling)
+   {
+      //Leave polling mode
+      interface->nicPolling = FALSE;
 
-   //Copy user data to the transmit buffer
-   netBufferRead(txBuffer[txIndex], buffer, offset, length);
+      //Clear any RI flag raised while the interrupt was masked, then
+      //re-enable RX interrupts
+      ETH->DMACSR = ETH_DMACSR_RI;
+      ETH->DMACIER |= ETH_DMACIER_RIE;
 
-   //Set the start address of the buffer
-   txDmaDesc[txIndex].tdes0 = (uint32_t) txBuffer[txIndex];
-   //Write the number of bytes to send
-   txDmaDesc[txIndex].tdes2 = ETH_TDES2_IOC | (length & ETH_TDES2_B1L);
-   //Give the ownership of the descriptor to the DMA
-   txDmaDesc[txIndex].tdes3 = ETH_TDES3_OWN | ETH_TDES3_FD | ETH_TDES3_LD;
+      //A frame may have been received in the meantime
+      if((rxDmaDesc[rxIndex].rdes3 & ETH_RDES3_OWN) == 0)
+      {
+         interface->nicEvent = TRUE;
+         osSetEvent(&netEvent);
+      }
+   }
+}
 
-   //Data synchronization barrier
-   __DSB();
 
-   //Clear TBU flag to resume processing
-   ETH->DMACSR = ETH_DMACSR_TBU;
-   //Instruct the DMA to poll the transmit descriptor list
-   ETH->DMACTDTPR = 0;
+/**
+ * @brief Collect the frames dropped by the MAC
+ *
+ * The MTL missed, overflow and underflow packet counters are 11 bits wide
+ * and cleared on read, so they are folded into the interface statistics at
+ * each wakeup and on every tick
+ *
+ * @param[in] interface Underlying network interface
+ **/
 
-   //Increment index and wrap around if necessary
-   if(++txIndex >= STM32H7XX_ETH_TX_BUFFER_COUNT)
-   {
-      txIndex = 0;
-   }
+void stm32h7xxEthUpdateDropStats(NetInterface *interface)
+{
+#if (NET_STATS_SUPPORT == ENABLED)
+   uint32_t value;
+   uint32_t overflows;
+
+   //Read and clear the missed packet and overflow counters
+   value = ETH->MTLRQMPOCR;
+   //Frames dropped because the receive FIFO overflowed
+   overflows = (value & ETH_MTLRQMPOCR_OVFPKTCNT) >> ETH_MTLRQMPOCR_OVFPKTCNT_Pos;
+
+   //Frames dropped because no RX descriptor was available, or because the
+   //receive FIFO overflowed
+   NET_STATS_IF_INC(interface, rxMissed, overflows +
+      ((value & ETH_MTLRQMPOCR_MISPKTCNT) >> ETH_MTLRQMPOCR_MISPKTCNT_Pos));
+   NET_STATS_IF_INC(interface, rxFifoOverflows, overflows);
+
+   //Read and clear the underflow counter
+   value = ETH->MTLTQUR;
+
+   //Frames aborted because the transmit FIFO ran dry
+   NET_STATS_IF_INC(interface, txUnderflows,
+      (value & ETH_MTLTQUR_UFPKTCNT) >> ETH_MTLTQUR_UFPKTCNT_Pos);
+#endif
+}
 
-   //Check whether the next buffer is available for writing
-   if((txDmaDesc[txIndex].tdes3 & ETH_TDES3_OWN) == 0)
-   {
-      //The transmitter can accept another packet
-      osSetEvent(&interface->nicTxEvent);
-   }
 
-   //Data successfully written
-   return NO_ERROR;
+/**
+ * @brief Collect the error counters of the MMC
+ *
+ * The counters are 32 bits wide and cleared on read, and are folded into
+ * the interface statistics on every tick. Frames with a CRC or alignment
+ * error are dropped by the MAC and never reach the driver
+ *
+ * @param[in] interface Underlying network interface
+ **/
+
+void stm32h7xxEthUpdateMmcStats(NetInterface *interface)
+{
+#if (NET_STATS_SUPPORT == ENABLED)
+   //Frames received with a CRC or an alignment error
+   NET_STATS_IF_INC(interface, rxCrcErrors, ETH->MMCRCRCEPR);
+   NET_STATS_IF_INC(interface, rxAlignErrors, ETH->MMCRAEPR);
+
+   //Frames sent after one or more collisions
+   NET_STATS_IF_INC(interface, txCollisions, ETH->MMCTSCGPR);
+   NET_STATS_IF_INC(interface, txCollisions, ETH->MMCTMCGPR);
+#endif
 }
 
 
 /**
- * @brief Receive a packet
+ * @brief Restart the receive DMA after it has stopped
+ *
+ * The frames left in the ring are dropped. Each descriptor is given back to
+ * the DMA along with the buffer currently attached to it, so that the
+ * buffers on loan to the stack are not disturbed
+ *
  * @param[in] interface Underlying network interface
- * @return Error code
  **/
 
-error_t stm32h7xxEthReceivePacket(NetInterface *interface)
+void stm32h7xxEthRestartRxDma(NetInterface *interface)
 {
-   error_t error;
-   size_t n;
-   uint32_t status;
-   NetRxAncillary ancillary;
+   uint_t i;
+   uint8_t *buffer;
 
-   //Current buffer available for reading?
-   if((rxDmaDesc[rxIndex].rdes3 & ETH_RDES3_OWN) == 0)
+   //Debug message
+   TRACE_WARNING("STM32H7 Ethernet RX DMA stopped, restarting...\r\n");
+
+   //Stop the receive DMA
+   ETH->DMACRCR &= ~ETH_DMACRCR_SR;
+
+   //Wait for the receive process to stop
+   for(i = 0; i < 10000; i++)
    {
-      //FD and LD flags should be set
-      if((rxDmaDesc[rxIndex].rdes3 & ETH_RDES3_FD) != 0 &&
-         (rxDmaDesc[rxIndex].rdes3 & ETH_RDES3_LD) != 0)
+      if((ETH->DMADSR & ETH_DMADSR_RPS) == ETH_DMADSR_RPS_STOPPED)
+         break;
+   }
+
+   //Loop through the RX descriptors
+   for(i = 0; i < rxRingSize; i++)
+   {
+#if (NET_MEM_RX_LOAN_SUPPORT == ENABLED)
+      //Point to the buffer attached to the descriptor
+      buffer = rxDescBuffer[i];
+#else
+      //Point to the buffer attached to the descriptor
+      buffer = rxBuffer[i];
+#endif
+
+      //Make sure no dirty line can be evicted over data written by the DMA
+      STM32H7XX_ETH_INVALIDATE_DCACHE(buffer, STM32H7XX_ETH_RX_BUFFER_SIZE);
+
+      //Give the ownership of the descriptor back to the DMA
+      rxDmaDesc[i].rdes0 = (uint32_t) buffer;
+      rxDmaDesc[i].rdes1 = 0;
+      rxDmaDesc[i].rdes2 = 0;
+      rxDmaDesc[i].rdes3 = ETH_RDES3_OWN | STM32H7XX_ETH_RDES3_IOC |
+         ETH_RDES3_BUF1V;
+
+#if (STM32H7XX_ETH_OFFLOAD_SUPPORT == ENABLED)
+      //The next frame written to the descriptor has not been inspected
+      rxOffloadState[i] = STM32H7XX_ETH_RX_OFFLOAD_NONE;
+#endif
+   }
+
+   //Initialize RX descriptor index
+   rxIndex = 0;
+
+#if (STM32H7XX_ETH_JUMBO_SUPPORT == ENABLED)
+   //No frame is being gathered
+   rxFrameLength = 0;
+#endif
+
+   //Data synchronization barrier
+   __DSB();
+
+   //Start location of the RX descriptor list
+   ETH->DMACRDLAR = (uint32_t) &rxDmaDesc[0];
+   //Length of the receive descriptor ring
+   ETH->DMACRDRLR = rxRingSize - 1;
+
+   //Clear the status flags raised while the DMA was stopped
+   ETH->DMACSR = ETH_DMACSR_RPS | ETH_DMACSR_RBU;
+
+   //Restart the receive DMA
+   ETH->DMACRCR |= ETH_DMACRCR_SR;
+   //Instruct the DMA to poll the receive descriptor list
+   ETH->DMACRDTPR = 0;
+
+   //Update statistics
+   NET_STATS_IF_INC(interface, rxDmaRestarts, 1);
+}
+
+
+/**
+ * @brief Get receive path statistics
+ * @param[out] stats Snapshot of the RX counters
+ **/
+
+void stm32h7xxEthGetRxStats(Stm32h7xxEthRxStats *stats)
+{
+   //Enter critical section
+   osSuspendAllTasks();
+   //Copy statistics
+   *stats = rxStats;
+   //Exit critical section
+   osResumeAllTasks();
+}
+
+
+/**
+ * @brief Get the number of received frames waiting in the ring
+ *
+ * The ring is scanned without locking, from the descriptor the driver
+ * reads next, so the count may be off by the frames received or processed
+ * meanwhile. It is meant for load estimation
+ *
+ * @return Number of descriptors handed back by the DMA
+ **/
+
+uint_t stm32h7xxEthGetRxBacklog(void)
+{
+   uint_t i;
+   uint_t n;
+
+   //Count the descriptors released by the DMA, in ring order
+   for(n = 0, i = rxIndex; n < rxRingSize; n++)
+   {
+      if((rxDmaDesc[i].rdes3 & ETH_RDES3_OWN) != 0)
+         break;
+
+      i = (i + 1) % rxRingSize;
+   }
+
+   //Return the number of pending descriptors
+   return n;
+}
+
+
+/**
+ * @brief Send a packet
+ * @param[in] interface Underlying network interface
+ * @param[in] buffer Multi-part buffer containing the data to send
+ * @param[in] offset Offset to the first data byte
+ * @param[in] ancillary Additional options passed to the stack along with
+ *   the packet
+ * @return Error code
+ **/
+
+__net_fast_func error_t stm32h7xxEthSendPacket(NetInterface *interface,
+   const NetBuffer *buffer, size_t offset, NetTxAncillary *ancillary)
+{
+   size_t length;
+
+   //Retrieve the length of the packet
+   length = netBufferGetLength(buffer) - offset;
+
+   //Check the frame length
+   if(length > STM32H7XX_ETH_MAX_FRAME_SIZE)
+   {
+      //The transmitter can accept another packet
+      osSetEvent(&interface->nicTxEvent);
+      //Report an error
+      return ERROR_INVALID_LENGTH;
+   }
+
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+   //The descriptors must not be reused before their time stamp is reported
+   stm32h7xxEthCollectTxTimestamps(interface);
+
+   //Time stamped frames are always copied, the capture being requested in
+   //the descriptor of the transmit buffer
+   if(ancillary->timestampId >= 0)
+   {
+      ancillary->zeroCopy = FALSE;
+   }
+#endif
+
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+   //Frame to be sent at a given PTP time? When a launch is already pending,
+   //the frame follows the held ones
+   if((ancillary->launchTime.s != 0 || ancillary->launchTime.ns != 0) &&
+      !txLaunchPending)
+   {
+      //The DMA is notified at the launch time rather than below
+      stm32h7xxEthArmLaunch(&ancillary->launchTime);
+   }
+#endif
+
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+   //Release the buffers whose transmission is complete
+   stm32h7xxEthReclaimTxBuffers(interface);
+#endif
+
+#if (ETH_VLAN_SUPPORT == ENABLED && STM32H7XX_ETH_VLAN_OFFLOAD_SUPPORT == ENABLED)
+   //VLAN tag to be inserted by the MAC?
+   if(ancillary->vlanTci != 0)
+   {
+      //Pass the tag to the MAC, unless it already holds it
+      if(stm32h7xxEthLoadVlanTag(interface, ancillary->vlanTci))
       {
-         //Check error bits
-         status = rxDmaDesc[rxIndex].rdes3 & (ETH_RDES3_CE | ETH_RDES3_GP |
-            ETH_RDES3_RWT | ETH_RDES3_OE | ETH_RDES3_RE | ETH_RDES3_DE);
+         return ERROR_FAILURE;
+      }
+   }
+#endif
 
-         //The dribble bit error is valid only in the MII mode
-         if((SYSCFG->PMCR & SYSCFG_PMCR_EPIS_SEL) != SYSCFG_ETH_MII)
-         {
-            status &= ~ETH_RDES3_DE;
-         }
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+   //Large frames whose buffer is freed right after the call can be sent
+   //without being copied
+   if(ancillary->zeroCopy && length >= STM32H7XX_ETH_TX_ZERO_COPY_THRESHOLD)
+   {
+      //Map the chunks of the buffer onto the DMA descriptors
+      if(!stm32h7xxEthSendPacketZeroCopy(interface, buffer, offset, ancillary))
+      {
+         //Data successfully written
+         return NO_ERROR;
+      }
+   }
+#endif
 
-         //Make sure no error occurred
-         if(status == 0)
-         {
-            //Retrieve the length of the frame
-            n = rxDmaDesc[rxIndex].rdes3 & ETH_RDES3_PL;
-            //Limit the number of data to read
-            n = MIN(n, STM32H7XX_ETH_RX_BUFFER_SIZE);
+#if (STM32H7XX_ETH_JUMBO_SUPPORT == ENABLED)
+   //Jumbo frames are copied to as many transmit buffers as needed
+   if(length > STM32H7XX_ETH_TX_BUFFER_SIZE)
+   {
+      return stm32h7xxEthSendJumboPacket(interface, buffer, offset, length,
+         ancillary);
+   }
+#endif
 
-            //Additional options can be passed to the stack along with the packet
-            ancillary = NET_DEFAULT_RX_ANCILLARY;
+   //Make sure the current buffer is available for writing
+   if((txDmaDesc[txIndex].tdes3 & ETH_TDES3_OWN) != 0)
+   {
+      return ERROR_FAILURE;
+   }
 
-            //Pass the packet to the upper layer
-            nicProcessPacket(interface, rxBuffer[rxIndex], n, &ancillary);
+   //Copy user data to the transmit buffer
+   netBufferRead(txBuffer[txIndex], buffer, offset, length);
+   //Write back the frame to memory before the DMA reads it
+   STM32H7XX_ETH_CLEAN_DCACHE(txBuffer[txIndex], length);
 
-            //Valid packet received
-            error = NO_ERROR;
-         }
-         else
-         {
-            //The received packet contains an error
-            error = ERROR_INVALID_PACKET;
-         }
+   //Set the start address of the buffer
+   txDmaDesc[txIndex].tdes0 = (uint32_t) txBuffer[txIndex];
+   txDmaDesc[txIndex].tdes1 = 0;
+   //Write the number of bytes to send
+   txDmaDesc[txIndex].tdes2 = ETH_TDES2_IOC | (length & ETH_TDES2_B1L);
+
+#if (ETH_VLAN_SUPPORT == ENABLED && STM32H7XX_ETH_VLAN_OFFLOAD_SUPPORT == ENABLED)
+   //Insert the VLAN tag held by the MAC?
+   if(ancillary->vlanTci != 0)
+   {
+      txDmaDesc[txIndex].tdes2 |= ETH_TDES2_VTIR_INSERT;
+   }
+#endif
+
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+   //Capture the transmit time of the frame?
+   if(ancillary->timestampId >= 0)
+   {
+      //Request a time stamp
+      txDmaDesc[txIndex].tdes2 |= ETH_TDES2_TTSE;
+
+      //The time stamp is reported once the frame has been sent
+      txTimestampId[txIndex] = ancillary->timestampId;
+      txTimestampCount++;
+   }
+#endif
+
+   //Give the ownership of the descriptor to the DMA
+   txDmaDesc[txIndex].tdes3 = ETH_TDES3_OWN | ETH_TDES3_FD | ETH_TDES3_LD |
+      STM32H7XX_ETH_TDES3_CIC;
+
+   //Data synchronization barrier
+   __DSB();
+
+   //Increment index and wrap around if necessary
+   if(++txIndex >= txRingSize)
+   {
+      txIndex = 0;
+   }
+
+   //Notify the DMA
+   stm32h7xxEthStartTx(interface);
+
+   //Check whether the next buffer is available for writing
+   if((txDmaDesc[txIndex].tdes3 & ETH_TDES3_OWN) == 0)
+   {
+      //The transmitter can accept another packet
+      osSetEvent(&interface->nicTxEvent);
+   }
+
+   //Data successfully written
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Send a packet without copying it to the transmit buffers
+ *
+ * Each DMA descriptor references up to two chunks of the buffer. The buffer
+ * is held until the DMA has processed the last descriptor of the frame
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] buffer Multi-part buffer containing the data to send
+ * @param[in] offset Offset to the first data byte
+ * @param[in] ancillary Additional options passed to the stack along with
+ *   the packet
+ * @return Error code
+ **/
+
+__net_fast_func error_t stm32h7xxEthSendPacketZeroCopy(NetInterface *interface,
+   const NetBuffer *buffer, size_t offset, NetTxAncillary *ancillary)
+{
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+   error_t error;
+   uint_t i;
+   uint_t j;
+   uint_t k;
+   uint_t n;
+   size_t length;
+   uint8_t *p;
+   uint8_t *segAddr[2 * STM32H7XX_ETH_TX_BUFFER_COUNT];
+   size_t segLength[2 * STM32H7XX_ETH_TX_BUFFER_COUNT];
+
+   //Number of data segments
+   n = 0;
+
+   //Loop through data chunks
+   for(i = 0; i < buffer->chunkCount; i++)
+   {
+      //Skip the beginning of the buffer
+      if(offset >= buffer->chunk[i].length)
+      {
+         offset -= buffer->chunk[i].length;
+         continue;
+      }
+
+      //Point to the data segment
+      p = (uint8_t *) buffer->chunk[i].address + offset;
+      length = buffer->chunk[i].length - offset;
+      offset = 0;
+
+      //The Ethernet DMA cannot access the tightly-coupled memories
+      if((uint32_t) p < D1_AXISRAM_BASE && (uint32_t) p >= D1_DTCMRAM_BASE)
+         return ERROR_FAILURE;
+
+      //Each descriptor holds at most two buffers
+      if(n >= arraysize(segAddr))
+         return ERROR_FAILURE;
+
+      //Save the data segment
+      segAddr[n] = p;
+      segLength[n] = length;
+      n++;
+   }
+
+   //Empty frame?
+   if(n == 0)
+      return ERROR_FAILURE;
+
+   //Number of descriptors required to send the frame
+   k = (n + 1) / 2;
+
+   //The frame must fit in the descriptor ring
+   if(k > txRingSize)
+      return ERROR_FAILURE;
+
+   //Make sure enough descriptors are available for writing
+   for(i = 0, j = txIndex; i < k; i++)
+   {
+      if((txDmaDesc[j].tdes3 & ETH_TDES3_OWN) != 0 ||
+         txDescNetBuffer[j] != NULL)
+      {
+         return ERROR_FAILURE;
+      }
+
+      //Increment index and wrap around if necessary
+      if(++j >= txRingSize)
+      {
+         j = 0;
+      }
+   }
+
+   //The buffer must not be released before the transmission completes
+   error = netBufferHold(buffer);
+   //Any error to report?
+   if(error)
+      return error;
+
+   //Write back the data segments to memory before the DMA reads them
+   for(i = 0; i < n; i++)
+   {
+      STM32H7XX_ETH_CLEAN_DCACHE(segAddr[i], segLength[i]);
+   }
+
+   //Fill the descriptors in reverse order, so that the DMA does not start
+   //processing the frame before all the descriptors are ready
+   for(i = k; i-- > 0; )
+   {
+      //Index of the current descriptor
+      j = (txIndex + i) % txRingSize;
+
+      //Set the start address of the first buffer
+      txDmaDesc[j].tdes0 = (uint32_t) segAddr[2 * i];
+      //Write the number of bytes in the first buffer
+      txDmaDesc[j].tdes2 = segLength[2 * i] & ETH_TDES2_B1L;
+
+      //Second buffer?
+      if((2 * i + 1) < n)
+      {
+         //Set the start address of the second buffer
+         txDmaDesc[j].tdes1 = (uint32_t) segAddr[2 * i + 1];
+         //Write the number of bytes in the second buffer
+         txDmaDesc[j].tdes2 |= (segLength[2 * i + 1] << 16) & ETH_TDES2_B2L;
+      }
+      else
+      {
+         //The second buffer is not used
+         txDmaDesc[j].tdes1 = 0;
+      }
+
+      //Last descriptor of the frame?
+      if(i == (k - 1))
+      {
+         //Generate an interrupt once the frame has been sent
+         txDmaDesc[j].tdes2 |= ETH_TDES2_IOC;
+         txDmaDesc[j].tdes3 = ETH_TDES3_LD;
+
+         //Release the buffer when this descriptor has been processed
+         txDescNetBuffer[j] = buffer;
+         txHeldCount++;
       }
       else
       {
-         //The packet is not valid
-         error = ERROR_INVALID_PACKET;
+         txDmaDesc[j].tdes3 = 0;
+      }
+
+      //First descriptor of the frame?
+      if(i == 0)
+      {
+         txDmaDesc[j].tdes3 |= ETH_TDES3_FD | STM32H7XX_ETH_TDES3_CIC;
+
+#if (ETH_VLAN_SUPPORT == ENABLED && STM32H7XX_ETH_VLAN_OFFLOAD_SUPPORT == ENABLED)
+         //Insert the VLAN tag held by the MAC?
+         if(ancillary->vlanTci != 0)
+         {
+            txDmaDesc[j].tdes2 |= ETH_TDES2_VTIR_INSERT;
+         }
+#endif
       }
 
-      //Set the start address of the buffer
-      rxDmaDesc[rxIndex].rdes0 = (uint32_t) rxBuffer[rxIndex];
-      //Give the ownership of the descriptor back to the DMA
-      rxDmaDesc[rxIndex].rdes3 = ETH_RDES3_OWN | ETH_RDES3_IOC | ETH_RDES3_BUF1V;
+      //Data synchronization barrier
+      __DSB();
+
+      //Give the ownership of the descriptor to the DMA
+      txDmaDesc[j].tdes3 |= ETH_TDES3_OWN;
+   }
+
+   //Data synchronization barrier
+   __DSB();
+
+   //Advance the index past the descriptors of the frame
+   txIndex = (txIndex + k) % txRingSize;
+
+   //Notify the DMA
+   stm32h7xxEthStartTx(interface);
+
+   //Check whether the next buffer is available for writing
+   if((txDmaDesc[txIndex].tdes3 & ETH_TDES3_OWN) == 0)
+   {
+      //The transmitter can accept another packet
+      osSetEvent(&interface->nicTxEvent);
+   }
+
+   //Data successfully written
+   return NO_ERROR;
+#else
+   //Zero-copy transmission is not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Send a frame larger than a transmit buffer
+ *
+ * The frame is copied to consecutive transmit buffers, one descriptor per
+ * buffer, the first and last descriptors being flagged with FD and LD
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] buffer Multi-part buffer containing the data to send
+ * @param[in] offset Offset to the first data byte
+ * @param[in] length Length of the frame
+ * @param[in] ancillary Additional options passed to the stack along with
+ *   the packet
+ * @return Error code
+ **/
+
+__net_fast_func error_t stm32h7xxEthSendJumboPacket(NetInterface *interface,
+   const NetBuffer *buffer, size_t offset, size_t length,
+   NetTxAncillary *ancillary)
+{
+#if (STM32H7XX_ETH_JUMBO_SUPPORT == ENABLED)
+   uint_t i;
+   uint_t j;
+   uint_t k;
+   size_t n;
+
+   //Number of descriptors required to send the frame
+   k = (length + STM32H7XX_ETH_TX_BUFFER_SIZE - 1) / STM32H7XX_ETH_TX_BUFFER_SIZE;
+
+   //The frame must fit in the descriptor ring
+   if(k > txRingSize)
+      return ERROR_INVALID_LENGTH;
+
+   //Make sure enough descriptors are available for writing
+   for(i = 0, j = txIndex; i < k; i++)
+   {
+      if((txDmaDesc[j].tdes3 & ETH_TDES3_OWN) != 0)
+         return ERROR_FAILURE;
+
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+      //The descriptor still references a buffer
+      if(txDescNetBuffer[j] != NULL)
+         return ERROR_FAILURE;
+#endif
+
+      //Increment index and wrap around if necessary
+      if(++j >= txRingSize)
+      {
+         j = 0;
+      }
+   }
+
+   //Fill the descriptors in reverse order, so that the DMA does not start
+   //processing the frame before all the descriptors are ready
+   for(i = k; i-- > 0; )
+   {
+      //Index of the current descriptor
+      j = (txIndex + i) % txRingSize;
+
+      //Number of bytes held by the current buffer
+      n = MIN(length - i * STM32H7XX_ETH_TX_BUFFER_SIZE,
+         STM32H7XX_ETH_TX_BUFFER_SIZE);
+
+      //Copy the corresponding part of the frame
+      netBufferRead(txBuffer[j], buffer,
+         offset + i * STM32H7XX_ETH_TX_BUFFER_SIZE, n);
+      //Write back the data to memory before the DMA reads it
+      STM32H7XX_ETH_CLEAN_DCACHE(txBuffer[j], n);
+
+      //Set the start address of the buffer
+      txDmaDesc[j].tdes0 = (uint32_t) txBuffer[j];
+      txDmaDesc[j].tdes1 = 0;
+      //Write the number of bytes in the buffer
+      txDmaDesc[j].tdes2 = n & ETH_TDES2_B1L;
+
+      //Last descriptor of the frame?
+      if(i == (k - 1))
+      {
+         //Generate an interrupt once the frame has been sent
+         txDmaDesc[j].tdes2 |= ETH_TDES2_IOC;
+         txDmaDesc[j].tdes3 = ETH_TDES3_LD;
+
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+         //The time stamp is written back to the last descriptor
+         if(ancillary->timestampId >= 0)
+         {
+            txTimestampId[j] = ancillary->timestampId;
+            txTimestampCount++;
+         }
+#endif
+      }
+      else
+      {
+         txDmaDesc[j].tdes3 = 0;
+      }
+
+      //First descriptor of the frame?
+      if(i == 0)
+      {
+         txDmaDesc[j].tdes3 |= ETH_TDES3_FD;
+
+#if (ETH_VLAN_SUPPORT == ENABLED && STM32H7XX_ETH_VLAN_OFFLOAD_SUPPORT == ENABLED)
+         //Insert the VLAN tag held by the MAC?
+         if(ancillary->vlanTci != 0)
+         {
+            txDmaDesc[j].tdes2 |= ETH_TDES2_VTIR_INSERT;
+         }
+#endif
+
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+         //Capture the transmit time of the frame?
+         if(ancillary->timestampId >= 0)
+         {
+            txDmaDesc[j].tdes2 |= ETH_TDES2_TTSE;
+         }
+#endif
+      }
+
+      //Data synchronization barrier
+      __DSB();
+
+      //Give the ownership of the descriptor to the DMA
+      txDmaDesc[j].tdes3 |= ETH_TDES3_OWN;
+   }
+
+   //Data synchronization barrier
+   __DSB();
+
+   //Advance the index past the descriptors of the frame
+   txIndex = (txIndex + k) % txRingSize;
+
+   //Notify the DMA
+   stm32h7xxEthStartTx(interface);
+
+   //Check whether the next buffer is available for writing
+   if((txDmaDesc[txIndex].tdes3 & ETH_TDES3_OWN) == 0)
+   {
+      //The transmitter can accept another packet
+      osSetEvent(&interface->nicTxEvent);
+   }
+
+   //Data successfully written
+   return NO_ERROR;
+#else
+   //Jumbo frames are not supported
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Pass the VLAN tag to be inserted to the MAC
+ *
+ * The tag is written to a context descriptor ahead of the frame, and kept by
+ * the MAC for the following frames. A context descriptor is therefore only
+ * needed when the frame does not belong to the same VLAN as the previous
+ * tagged one
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] tci Tag control information (PCP, DEI and VID)
+ * @return Error code
+ **/
+
+__net_fast_func error_t stm32h7xxEthLoadVlanTag(NetInterface *interface,
+   uint16_t tci)
+{
+#if (ETH_VLAN_SUPPORT == ENABLED && STM32H7XX_ETH_VLAN_OFFLOAD_SUPPORT == ENABLED)
+   uint_t i;
+
+   //The MAC already holds the tag?
+   if(tci == txVlanTag)
+      return NO_ERROR;
+
+   //Index of the descriptor following the context descriptor
+   i = (txIndex + 1) % txRingSize;
+
+   //The context descriptor must not take the last descriptor left for the
+   //frame itself
+   if((txDmaDesc[txIndex].tdes3 & ETH_TDES3_OWN) != 0 ||
+      (txDmaDesc[i].tdes3 & ETH_TDES3_OWN) != 0)
+   {
+      return ERROR_FAILURE;
+   }
+
+   //A context descriptor carries no data
+   txDmaDesc[txIndex].tdes0 = 0;
+   txDmaDesc[txIndex].tdes1 = 0;
+   txDmaDesc[txIndex].tdes2 = 0;
+
+   //Data synchronization barrier
+   __DSB();
+
+   //Give the ownership of the context descriptor to the DMA. The DMA is
+   //notified along with the frame
+   txDmaDesc[txIndex].tdes3 = ETH_TDES3_OWN | ETH_TDES3_CTXT | ETH_TDES3_VLTV |
+      (tci & ETH_TDES3_VT);
+
+   //Save the tag now held by the MAC
+   txVlanTag = tci;
+
+   //Increment index and wrap around if necessary
+   txIndex = i;
+
+   //Successful processing
+   return NO_ERROR;
+#else
+   //Hardware VLAN tagging is not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Notify the DMA of newly written transmit descriptors
+ *
+ * Within a TX batch, the doorbell write is deferred until the batch is
+ * complete, unless the descriptor ring is full
+ *
+ * @param[in] interface Underlying network interface
+ **/
+
+__net_fast_func void stm32h7xxEthStartTx(NetInterface *interface)
+{
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+   //Frames held until a launch time are ahead in the ring?
+   if(txLaunchPending)
+   {
+      //The DMA will be notified at the launch time
+      txKickPending = TRUE;
+      return;
+   }
+#endif
+
+#if (NIC_TX_BATCH_SUPPORT == ENABLED)
+   //Frame sent as part of a batch, with room left in the ring?
+   if(interface->nicTxBatch && (txDmaDesc[txIndex].tdes3 & ETH_TDES3_OWN) == 0)
+   {
+      //The DMA will be notified at the end of the batch
+      txKickPending = TRUE;
+   }
+   else
+#endif
+   {
+      //Clear TBU flag to resume processing
+      ETH->DMACSR = ETH_DMACSR_TBU;
+      //Instruct the DMA to poll the transmit descriptor list
+      ETH->DMACTDTPR = 0;
+
+      //All the descriptors have been notified
+      txKickPending = FALSE;
+   }
+}
+
+
+/**
+ * @brief Start the transmission of the frames queued during a TX batch
+ * @param[in] interface Underlying network interface
+ **/
+
+void stm32h7xxEthFlushTx(NetInterface *interface)
+{
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+   //The DMA will be notified at the launch time
+   if(txLaunchPending)
+   {
+      return;
+   }
+#endif
+
+   //Any descriptor not yet notified to the DMA?
+   if(txKickPending)
+   {
+      //Clear TBU flag to resume processing
+      ETH->DMACSR = ETH_DMACSR_TBU;
+      //Instruct the DMA to poll the transmit descriptor list
+      ETH->DMACTDTPR = 0;
+
+      //All the descriptors have been notified
+      txKickPending = FALSE;
+   }
+}
+
+
+/**
+ * @brief Release the buffers whose transmission is complete
+ * @param[in] interface Underlying network interface
+ **/
+
+void stm32h7xxEthReclaimTxBuffers(NetInterface *interface)
+{
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+   uint_t i;
+
+   //Any buffer referenced by the DMA?
+   if(txHeldCount > 0)
+   {
+      //Loop through the TX descriptors
+      for(i = 0; i < txRingSize; i++)
+      {
+         //The last descriptor of the frame has been processed?
+         if(txDescNetBuffer[i] != NULL &&
+            (txDmaDesc[i].tdes3 & ETH_TDES3_OWN) == 0)
+         {
+            //Give the buffer back to the stack
+            netBufferRelease(txDescNetBuffer[i]);
+            txDescNetBuffer[i] = NULL;
+
+            //Update the number of held buffers
+            txHeldCount--;
+         }
+      }
+   }
+#endif
+}
+
+
+/**
+ * @brief Receive a packet
+ * @param[in] interface Underlying network interface
+ * @return Error code
+ **/
+
+__net_fast_func error_t stm32h7xxEthReceivePacket(NetInterface *interface)
+{
+   error_t error;
+   size_t n;
+   bool_t ready;
+   uint32_t status;
+   uint8_t *buffer;
+   NetRxAncillary ancillary;
+#if (STM32H7XX_ETH_OFFLOAD_SUPPORT == ENABLED)
+   uint_t state;
+#endif
+
+#if (NET_MEM_RX_LOAN_SUPPORT == ENABLED)
+   //Point to the buffer attached to the current descriptor
+   buffer = rxDescBuffer[rxIndex];
+#else
+   //Point to the buffer attached to the current descriptor
+   buffer = rxBuffer[rxIndex];
+#endif
+
+   //Current buffer available for reading?
+   ready = (rxDmaDesc[rxIndex].rdes3 & ETH_RDES3_OWN) == 0;
+
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+   //The time stamp of a frame is written to the next descriptor, in the
+   //context format, after the frame has been closed
+   if(ready && (rxDmaDesc[rxIndex].rdes3 & (ETH_RDES3_CTXT | ETH_RDES3_LD |
+      ETH_RDES3_RS1V)) == (ETH_RDES3_LD | ETH_RDES3_RS1V) &&
+      (rxDmaDesc[rxIndex].rdes1 & ETH_RDES1_TSA) != 0)
+   {
+      //Wait for the context descriptor before passing the frame on
+      ready = (rxDmaDesc[(rxIndex + 1) % rxRingSize].rdes3 & ETH_RDES3_OWN) == 0;
+   }
+#endif
+
+   //Frame ready to be processed?
+   if(ready)
+   {
+      //Frame picked from the ring (latency instrumentation)
+      NET_LATENCY_MARK(NET_LATENCY_POINT_DRIVER);
+
+#if (STM32H7XX_ETH_OFFLOAD_SUPPORT == ENABLED)
+      //Ethernet interrupts are disabled while the stack calls the driver, so
+      //the offload responder cannot run concurrently
+      state = rxOffloadState[rxIndex];
+#endif
+
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+      //Context descriptor holding the time stamp of the previous frame?
+      if((rxDmaDesc[rxIndex].rdes3 & ETH_RDES3_CTXT) != 0)
+      {
+         //The time stamp has already been retrieved
+         error = NO_ERROR;
+      }
+      else
+#endif
+      //FD and LD flags should be set
+      if((rxDmaDesc[rxIndex].rdes3 & ETH_RDES3_FD) != 0 &&
+         (rxDmaDesc[rxIndex].rdes3 & ETH_RDES3_LD) != 0)
+      {
+         //Check error bits
+         status = rxDmaDesc[rxIndex].rdes3 & (ETH_RDES3_CE | ETH_RDES3_GP |
+            ETH_RDES3_RWT | ETH_RDES3_OE | ETH_RDES3_RE | ETH_RDES3_DE);
+
+         //The dribble bit error is valid only in the MII mode
+         if((SYSCFG->PMCR & SYSCFG_PMCR_EPIS_SEL) != SYSCFG_ETH_MII)
+         {
+            status &= ~ETH_RDES3_DE;
+         }
+
+#if (STM32H7XX_ETH_OFFLOAD_SUPPORT == ENABLED)
+         //Request already answered by the offload responder?
+         if(state == STM32H7XX_ETH_RX_OFFLOAD_REPLIED)
+         {
+            //The frame must not be answered a second time
+            error = NO_ERROR;
+         }
+         else
+#endif
+         //Make sure no error occurred
+         if(status == 0)
+         {
+            //Retrieve the length of the frame
+            n = rxDmaDesc[rxIndex].rdes3 & ETH_RDES3_PL;
+            //Limit the number of data to read
+            n = MIN(n, STM32H7XX_ETH_RX_BUFFER_SIZE);
+
+            //Discard any line fetched while the DMA was writing the frame
+            STM32H7XX_ETH_INVALIDATE_DCACHE(buffer, n);
+
+            //Additional options can be passed to the stack along with the packet
+            ancillary = NET_DEFAULT_RX_ANCILLARY;
+
+#if (ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
+            //Retrieve the checksum status reported by the MAC
+            stm32h7xxEthGetRxChecksumStatus(&rxDmaDesc[rxIndex], &ancillary);
+#endif
+
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+            //Retrieve the time stamp captured by the MAC, if any
+            stm32h7xxEthGetRxTimestamp(rxIndex, &ancillary);
+#endif
+
+#if (ETH_VLAN_SUPPORT == ENABLED && STM32H7XX_ETH_VLAN_OFFLOAD_SUPPORT == ENABLED)
+            //VLAN tag stripped by the MAC?
+            if((rxDmaDesc[rxIndex].rdes3 & ETH_RDES3_RS0V) != 0)
+            {
+               //The outer VLAN tag is reported in the descriptor
+               ancillary.vlanTci = rxDmaDesc[rxIndex].rdes0 & ETH_RDES0_OVT;
+            }
+#endif
+
+#if (NET_MEM_RX_LOAN_SUPPORT == ENABLED)
+            //The buffer can only be loaned if it can be replaced right away
+            if(rxSpareCount > 0)
+            {
+               //Offer the buffer to the upper layers
+               netBufferOfferLoan(buffer, n);
+            }
+
+            //Pass the packet to the upper layer
+            nicProcessPacket(interface, buffer, n, &ancillary);
+
+            //Check whether the buffer has been taken over by the stack
+            if(netBufferWithdrawLoan())
+            {
+               //Enter critical section
+               osSuspendAllTasks();
+               //Attach a spare buffer to the current descriptor
+               rxDescBuffer[rxIndex] = rxSpareBuffer[--rxSpareCount];
+               //Exit critical section
+               osResumeAllTasks();
+            }
+#else
+            //Pass the packet to the upper layer
+            nicProcessPacket(interface, buffer, n, &ancillary);
+#endif
+
+            //Valid packet received
+            error = NO_ERROR;
+         }
+         else
+         {
+            //The received packet contains an error
+            error = ERROR_INVALID_PACKET;
+         }
+      }
+      else
+      {
+         //The frame spans several descriptors
+         error = stm32h7xxEthReceiveFragment(interface, buffer);
+      }
+
+      //Update statistics
+      if(error)
+      {
+         NET_STATS_IF_INC(interface, rxErrors, 1);
+      }
+
+#if (NET_MEM_RX_LOAN_SUPPORT == ENABLED)
+      //Point to the buffer to be attached to the descriptor
+      buffer = rxDescBuffer[rxIndex];
+#else
+      //Point to the buffer to be attached to the descriptor
+      buffer = rxBuffer[rxIndex];
+#endif
+
+      //The buffer may have been modified in place by the upper layers
+      STM32H7XX_ETH_INVALIDATE_DCACHE(buffer, STM32H7XX_ETH_RX_BUFFER_SIZE);
+
+      //Set the start address of the buffer
+      rxDmaDesc[rxIndex].rdes0 = (uint32_t) buffer;
+      //Give the ownership of the descriptor back to the DMA
+      rxDmaDesc[rxIndex].rdes3 = ETH_RDES3_OWN | STM32H7XX_ETH_RDES3_IOC |
+         ETH_RDES3_BUF1V;
+
+#if (STM32H7XX_ETH_OFFLOAD_SUPPORT == ENABLED)
+      //The next frame written to the descriptor has not been inspected
+      rxOffloadState[rxIndex] = STM32H7XX_ETH_RX_OFFLOAD_NONE;
+#endif
+
+      //Increment index and wrap around if necessary
+      if(++rxIndex >= rxRingSize)
+      {
+         rxIndex = 0;
+      }
+   }
+   else
+   {
+      //No more data in the receive buffer
+      error = ERROR_BUFFER_EMPTY;
+   }
+
+#if (NET_STATS_SUPPORT == ENABLED)
+   //The DMA ran out of free descriptors?
+   if((ETH->DMACSR & ETH_DMACSR_RBU) != 0)
+   {
+      NET_STATS_IF_INC(interface, rxBufferUnavailable, 1);
+   }
+#endif
+
+   //Clear RBU flag to resume processing
+   ETH->DMACSR = ETH_DMACSR_RBU;
+   //Instruct the DMA to poll the receive descriptor list
+   ETH->DMACRDTPR = 0;
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Gather a frame that spans several receive descriptors
+ *
+ * The DMA writes a jumbo frame to as many descriptors as needed, the first
+ * and the last ones being flagged with FD and LD. The buffers are appended in
+ * turn to a contiguous frame, which is passed to the upper layer once the
+ * last descriptor has been received. The status, the length, the checksum
+ * status and the VLAN tag of the frame are reported in the last descriptor
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] buffer Buffer attached to the current descriptor
+ * @return Error code
+ **/
+
+__net_fast_func error_t stm32h7xxEthReceiveFragment(NetInterface *interface,
+   uint8_t *buffer)
+{
+#if (STM32H7XX_ETH_JUMBO_SUPPORT == ENABLED)
+   size_t n;
+   uint32_t rdes3;
+   uint32_t status;
+   NetRxAncillary ancillary;
+
+   //Status of the current descriptor
+   rdes3 = rxDmaDesc[rxIndex].rdes3;
+
+   //First descriptor of a frame?
+   if((rdes3 & ETH_RDES3_FD) != 0)
+   {
+      //Any incomplete frame is discarded
+      rxFrameLength = 0;
+   }
+   else if(rxFrameLength == 0)
+   {
+      //The beginning of the frame has been lost
+      return ERROR_INVALID_PACKET;
+   }
+   else
+   {
+      //Continuation of the current frame
+   }
+
+   //Last descriptor of the frame?
+   if((rdes3 & ETH_RDES3_LD) != 0)
+   {
+      //The length field reports the length of the whole frame
+      n = rdes3 & ETH_RDES3_PL;
+      n = (n > rxFrameLength) ? n - rxFrameLength : 0;
+   }
+   else
+   {
+      //The buffer has been filled
+      n = STM32H7XX_ETH_RX_BUFFER_SIZE;
+   }
+
+   //The frame must fit in the frame buffer
+   if((rxFrameLength + n) > sizeof(rxFrameBuffer))
+   {
+      rxFrameLength = 0;
+      return ERROR_INVALID_LENGTH;
+   }
+
+   //Discard any line fetched while the DMA was writing the buffer
+   STM32H7XX_ETH_INVALIDATE_DCACHE(buffer, n);
+   //Append the contents of the buffer to the frame
+   osMemcpy(rxFrameBuffer + rxFrameLength, buffer, n);
+   rxFrameLength += n;
+
+   //More descriptors to come?
+   if((rdes3 & ETH_RDES3_LD) == 0)
+      return NO_ERROR;
+
+   //Length of the frame
+   n = rxFrameLength;
+   //The frame is complete
+   rxFrameLength = 0;
+
+   //Check error bits
+   status = rdes3 & (ETH_RDES3_CE | ETH_RDES3_GP | ETH_RDES3_RWT |
+      ETH_RDES3_OE | ETH_RDES3_RE | ETH_RDES3_DE);
+
+   //The dribble bit error is valid only in the MII mode
+   if((SYSCFG->PMCR & SYSCFG_PMCR_EPIS_SEL) != SYSCFG_ETH_MII)
+   {
+      status &= ~ETH_RDES3_DE;
+   }
+
+   //The received packet contains an error
+   if(status != 0)
+      return ERROR_INVALID_PACKET;
+
+   //Additional options can be passed to the stack along with the packet
+   ancillary = NET_DEFAULT_RX_ANCILLARY;
+
+#if (ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
+   //Retrieve the checksum status reported by the MAC
+   stm32h7xxEthGetRxChecksumStatus(&rxDmaDesc[rxIndex], &ancillary);
+#endif
+
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+   //Retrieve the time stamp captured by the MAC, if any
+   stm32h7xxEthGetRxTimestamp(rxIndex, &ancillary);
+#endif
+
+#if (ETH_VLAN_SUPPORT == ENABLED && STM32H7XX_ETH_VLAN_OFFLOAD_SUPPORT == ENABLED)
+   //VLAN tag stripped by the MAC?
+   if((rdes3 & ETH_RDES3_RS0V) != 0)
+   {
+      //The outer VLAN tag is reported in the descriptor
+      ancillary.vlanTci = rxDmaDesc[rxIndex].rdes0 & ETH_RDES0_OVT;
+   }
+#endif
+
+   //Update statistics
+   rxStats.jumboFrames++;
+
+   //Pass the packet to the upper layer
+   nicProcessPacket(interface, rxFrameBuffer, n, &ancillary);
+
+   //Valid packet received
+   return NO_ERROR;
+#else
+   //Frames spanning several descriptors are not supported
+   return ERROR_INVALID_PACKET;
+#endif
+}
+
+
+/**
+ * @brief Answer ARP and ICMP echo requests from the interrupt handler
+ *
+ * Frames the TCP/IP task has not yet picked from the ring are inspected once.
+ * ARP requests and small ICMP echo requests for one of the addresses of the
+ * interface are answered right away and marked, so that the receive path
+ * drops them instead of answering them a second time. Everything else is
+ * left to the TCP/IP stack. The stack disables Ethernet interrupts whenever
+ * it calls the driver, so the rings are never accessed concurrently
+ *
+ * @param[in] interface Underlying network interface
+ **/
+
+void stm32h7xxEthOffloadRx(NetInterface *interface)
+{
+#if (STM32H7XX_ETH_OFFLOAD_SUPPORT == ENABLED)
+   uint_t i;
+   uint_t j;
+   size_t n;
+   uint32_t status;
+   uint8_t *buffer;
+   bool_t replied;
+
+   //Loop through the frames waiting in the ring
+   for(i = 0, j = rxIndex; i < rxRingSize; i++)
+   {
+      //Stop at the first descriptor still owned by the DMA
+      if((rxDmaDesc[j].rdes3 & ETH_RDES3_OWN) != 0)
+         break;
+
+      //Frame not yet inspected nor picked by the TCP/IP task?
+      if(rxOffloadState[j] == STM32H7XX_ETH_RX_OFFLOAD_NONE)
+      {
+         //Each frame is inspected only once
+         rxOffloadState[j] = STM32H7XX_ETH_RX_OFFLOAD_SCANNED;
+
+         //Only error-free frames held in a single buffer are considered. The
+         //frames whose VLAN tag has been stripped belong to a virtual
+         //interface and are left to the TCP/IP stack
+         status = rxDmaDesc[j].rdes3 & (ETH_RDES3_FD | ETH_RDES3_LD |
+            ETH_RDES3_ES | ETH_RDES3_RS0V);
+
+         //Valid frame?
+         if(status == (ETH_RDES3_FD | ETH_RDES3_LD))
+         {
+#if (NET_MEM_RX_LOAN_SUPPORT == ENABLED)
+            //Point to the buffer attached to the descriptor
+            buffer = rxDescBuffer[j];
+#else
+            //Point to the buffer attached to the descriptor
+            buffer = rxBuffer[j];
+#endif
+            //Retrieve the length of the frame
+            n = rxDmaDesc[j].rdes3 & ETH_RDES3_PL;
+            n = MIN(n, STM32H7XX_ETH_RX_BUFFER_SIZE);
+
+            //Discard any line fetched while the DMA was writing the frame
+            STM32H7XX_ETH_INVALIDATE_DCACHE(buffer, n);
+
+            //Check the type of the frame
+            if(n >= sizeof(EthHeader) &&
+               ((EthHeader *) buffer)->type == HTONS(ETH_TYPE_ARP))
+            {
+               //ARP request?
+               replied = stm32h7xxEthOffloadArp(interface, buffer, n);
+            }
+            else if(n >= sizeof(EthHeader) &&
+               ((EthHeader *) buffer)->type == HTONS(ETH_TYPE_IPV4))
+            {
+               //ICMP echo request?
+               replied = stm32h7xxEthOffloadEcho(interface, buffer, n);
+            }
+            else
+            {
+               //The frame is left to the TCP/IP stack
+               replied = FALSE;
+            }
+
+            //The receive path must drop the frames that have been answered
+            if(replied)
+            {
+               rxOffloadState[j] = STM32H7XX_ETH_RX_OFFLOAD_REPLIED;
+            }
+         }
+      }
+
+      //Increment index and wrap around if necessary
+      if(++j >= rxRingSize)
+      {
+         j = 0;
+      }
+   }
+#endif
+}
+
+
+/**
+ * @brief Answer an ARP request for one of the addresses of the interface
+ *
+ * Probes and announcements, whose sender address is unspecified or one of
+ * ours, are left to the TCP/IP stack for address conflict detection
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] frame Received Ethernet frame
+ * @param[in] length Length of the frame
+ * @return TRUE if the request has been answered, else FALSE
+ **/
+
+bool_t stm32h7xxEthOffloadArp(NetInterface *interface, const uint8_t *frame,
+   size_t length)
+{
+#if (STM32H7XX_ETH_OFFLOAD_SUPPORT == ENABLED)
+   uint_t i;
+   uint8_t *p;
+   const ArpPacket *request;
+   EthHeader *ethHeader;
+   ArpPacket *reply;
+
+   //Malformed ARP packet?
+   if(length < (sizeof(EthHeader) + sizeof(ArpPacket)))
+      return FALSE;
+
+   //Point to the ARP packet
+   request = (ArpPacket *) (frame + sizeof(EthHeader));
+
+   //Only Ethernet/IPv4 requests are answered
+   if(request->hrd != HTONS(ARP_HARDWARE_TYPE_ETH) ||
+      request->pro != HTONS(ARP_PROTOCOL_TYPE_IPV4) ||
+      request->hln != sizeof(MacAddr) || request->pln != sizeof(Ipv4Addr) ||
+      request->op != HTONS(ARP_OPCODE_ARP_REQUEST))
+   {
+      return FALSE;
+   }
+
+   //The target must be one of the addresses of the interface
+   if(!stm32h7xxEthOffloadIsHostAddr(interface, request->tpa))
+      return FALSE;
+
+   //Leave probes and announcements to the TCP/IP stack
+   if(request->spa == IPV4_UNSPECIFIED_ADDR ||
+      stm32h7xxEthOffloadIsHostAddr(interface, request->spa))
+   {
+      return FALSE;
+   }
+
+   //The sender must be a unicast station
+   if(macIsMulticastAddr(&request->sha))
+      return FALSE;
+
+   //Claim a transmit buffer
+   p = stm32h7xxEthOffloadClaimTxBuffer(interface, &i);
+   //No descriptor available?
+   if(p == NULL)
+      return FALSE;
+
+   //Format Ethernet header
+   ethHeader = (EthHeader *) p;
+   ethHeader->destAddr = request->sha;
+   ethHeader->srcAddr = interface->macAddr;
+   ethHeader->type = HTONS(ETH_TYPE_ARP);
+
+   //Format ARP reply
+   reply = (ArpPacket *) (p + sizeof(EthHeader));
+   reply->hrd = HTONS(ARP_HARDWARE_TYPE_ETH);
+   reply->pro = HTONS(ARP_PROTOCOL_TYPE_IPV4);
+   reply->hln = sizeof(MacAddr);
+   reply->pln = sizeof(Ipv4Addr);
+   reply->op = HTONS(ARP_OPCODE_ARP_REPLY);
+   reply->sha = interface->macAddr;
+   reply->spa = request->tpa;
+   reply->tha = request->sha;
+   reply->tpa = request->spa;
+
+   //Send the reply (the MAC pads the frame to the minimum length)
+   stm32h7xxEthOffloadSend(i, sizeof(EthHeader) + sizeof(ArpPacket));
+
+   //Update statistics
+   NET_STATS_IF_INC(interface, offloadArpReplies, 1);
+
+   //The request has been answered
+   return TRUE;
+#else
+   //Offload is not implemented
+   return FALSE;
+#endif
+}
+
+
+/**
+ * @brief Answer an ICMP echo request for one of the addresses of the interface
+ *
+ * Only unfragmented datagrams without IP options, whose ICMP message does not
+ * exceed STM32H7XX_ETH_OFFLOAD_MAX_ECHO_SIZE, are answered. Larger requests
+ * are left to the TCP/IP stack
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] frame Received Ethernet frame
+ * @param[in] length Length of the frame
+ * @return TRUE if the request has been answered, else FALSE
+ **/
+
+bool_t stm32h7xxEthOffloadEcho(NetInterface *interface, const uint8_t *frame,
+   size_t length)
+{
+#if (STM32H7XX_ETH_OFFLOAD_SUPPORT == ENABLED)
+   uint_t i;
+   size_t n;
+   uint8_t *p;
+   const EthHeader *ethHeader;
+   const Ipv4Header *ipHeader;
+   EthHeader *replyEthHeader;
+   Ipv4Header *replyIpHeader;
+   IcmpEchoMessage *replyMessage;
+
+   //Malformed packet?
+   if(length < (sizeof(EthHeader) + sizeof(Ipv4Header) +
+      sizeof(IcmpEchoMessage)))
+   {
+      return FALSE;
+   }
+
+   //Point to the headers
+   ethHeader = (EthHeader *) frame;
+   ipHeader = (Ipv4Header *) (frame + sizeof(EthHeader));
+
+   //IPv4 datagram without options, carrying an ICMP message?
+   if(ipHeader->version != IPV4_VERSION ||
+      ipHeader->headerLength != (sizeof(Ipv4Header) / 4) ||
+      ipHeader->protocol != IPV4_PROTOCOL_ICMP)
+   {
+      return FALSE;
+   }
+
+   //Fragments are left to the reassembly process
+   if((ntohs(ipHeader->fragmentOffset) & (IPV4_FLAG_MF | IPV4_OFFSET_MASK)) != 0)
+      return FALSE;
+
+   //Retrieve the length of the ICMP message
+   n = ntohs(ipHeader->totalLength);
+
+   //Check the length of the datagram
+   if(n < (sizeof(Ipv4Header) + sizeof(IcmpEchoMessage)) ||
+      n > (length - sizeof(EthHeader)))
+   {
+      return FALSE;
+   }
+
+   //Length of the ICMP message
+   n -= sizeof(Ipv4Header);
+
+   //Large requests go through the TCP/IP stack
+   if(n > STM32H7XX_ETH_OFFLOAD_MAX_ECHO_SIZE)
+      return FALSE;
+
+   //Echo request?
+   if(ipHeader->options[0] != ICMP_TYPE_ECHO_REQUEST || ipHeader->options[1] != 0)
+      return FALSE;
+
+#if (IPV4_FIREWALL_SUPPORT == ENABLED)
+   //The firewall rules are checked by the TCP/IP stack
+   if(ipv4FirewallIsActive())
+      return FALSE;
+#endif
+
+#if (ICMP_RATE_LIMIT_SUPPORT == ENABLED)
+   //The replies must go through the token buckets of the TCP/IP stack
+   if(icmpIsRateLimited(ICMP_RATE_CLASS_ECHO_REPLY))
+      return FALSE;
+#endif
+
+   //The destination must be one of the addresses of the interface, and the
+   //source a valid unicast address
+   if(!stm32h7xxEthOffloadIsHostAddr(interface, ipHeader->destAddr) ||
+      ipHeader->srcAddr == IPV4_UNSPECIFIED_ADDR ||
+      ipv4CheckSourceAddr(interface, ipHeader->srcAddr) != NO_ERROR ||
+      macIsMulticastAddr(&ethHeader->srcAddr))
+   {
+      return FALSE;
+   }
+
+   //Verify the IP header checksum and the ICMP checksum
+   if(ipCalcChecksum(ipHeader, sizeof(Ipv4Header)) != 0x0000 ||
+      ipCalcChecksum(ipHeader->options, n) != 0x0000)
+   {
+      return FALSE;
+   }
+
+   //Claim a transmit buffer
+   p = stm32h7xxEthOffloadClaimTxBuffer(interface, &i);
+   //No descriptor available?
+   if(p == NULL)
+      return FALSE;
+
+   //The reply is a copy of the request with the addresses swapped
+   osMemcpy(p, frame, sizeof(EthHeader) + sizeof(Ipv4Header) + n);
+
+   //Format Ethernet header
+   replyEthHeader = (EthHeader *) p;
+   replyEthHeader->destAddr = ethHeader->srcAddr;
+   replyEthHeader->srcAddr = interface->macAddr;
+
+   //Format IPv4 header
+   replyIpHeader = (Ipv4Header *) (p + sizeof(EthHeader));
+   replyIpHeader->typeOfService = 0;
+   replyIpHeader->identification = 0;
+   replyIpHeader->fragmentOffset = HTONS(IPV4_FLAG_DF);
+   replyIpHeader->timeToLive = IPV4_DEFAULT_TTL;
+   replyIpHeader->srcAddr = ipHeader->destAddr;
+   replyIpHeader->destAddr = ipHeader->srcAddr;
+   replyIpHeader->headerChecksum = 0;
+   replyIpHeader->headerChecksum = ipCalcChecksum(replyIpHeader,
+      sizeof(Ipv4Header));
+
+   //Format ICMP echo reply, identifier, sequence number and data are echoed
+   replyMessage = (IcmpEchoMessage *) replyIpHeader->options;
+   replyMessage->type = ICMP_TYPE_ECHO_REPLY;
+   replyMessage->checksum = 0;
+   replyMessage->checksum = ipCalcChecksum(replyMessage, n);
+
+   //Send the reply
+   stm32h7xxEthOffloadSend(i, sizeof(EthHeader) + sizeof(Ipv4Header) + n);
+
+   //Update statistics
+   NET_STATS_IF_INC(interface, offloadEchoReplies, 1);
+
+   //The request has been answered
+   return TRUE;
+#else
+   //Offload is not implemented
+   return FALSE;
+#endif
+}
+
+
+/**
+ * @brief Check whether an address is assigned to the interface
+ *
+ * Only addresses whose use is unrestricted are considered, so that tentative
+ * addresses are never defended by the offload responder
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] ipAddr IPv4 address to be checked
+ * @return TRUE if the address is one of the addresses of the interface
+ **/
+
+bool_t stm32h7xxEthOffloadIsHostAddr(NetInterface *interface, Ipv4Addr ipAddr)
+{
+#if (STM32H7XX_ETH_OFFLOAD_SUPPORT == ENABLED)
+   uint_t i;
+   Ipv4AddrEntry *entry;
+
+   //Loop through the list of IPv4 addresses assigned to the interface
+   for(i = 0; i < IPV4_ADDR_LIST_SIZE; i++)
+   {
+      //Point to the current entry
+      entry = &interface->ipv4Context.addrList[i];
+
+      //Matching valid address?
+      if(entry->state == IPV4_ADDR_STATE_VALID && entry->addr == ipAddr &&
+         ipAddr != IPV4_UNSPECIFIED_ADDR)
+      {
+         return TRUE;
+      }
+   }
+#endif
+
+   //The address is not assigned to the interface
+   return FALSE;
+}
+
+
+/**
+ * @brief Claim a transmit descriptor from the interrupt handler
+ * @param[in] interface Underlying network interface
+ * @param[out] index Index of the claimed descriptor
+ * @return Pointer to the transmit buffer, or NULL if the ring is full
+ **/
+
+uint8_t *stm32h7xxEthOffloadClaimTxBuffer(NetInterface *interface,
+   uint_t *index)
+{
+#if (STM32H7XX_ETH_OFFLOAD_SUPPORT == ENABLED)
+   //Make sure the current descriptor is available for writing
+   if((txDmaDesc[txIndex].tdes3 & ETH_TDES3_OWN) != 0)
+   {
+      //Update statistics
+      NET_STATS_IF_INC(interface, offloadTxBusy, 1);
+      //The ring is full
+      return NULL;
+   }
+
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+   //The buffer of a zero-copy frame has not been released yet?
+   if(txDescNetBuffer[txIndex] != NULL)
+   {
+      //Update statistics
+      NET_STATS_IF_INC(interface, offloadTxBusy, 1);
+      //The descriptor cannot be reused
+      return NULL;
+   }
+#endif
+
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+   //The time stamp of the previous frame has not been reported yet?
+   if(txTimestampId[txIndex] >= 0)
+   {
+      //Update statistics
+      NET_STATS_IF_INC(interface, offloadTxBusy, 1);
+      //The descriptor cannot be reused
+      return NULL;
+   }
+#endif
+
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+   //The reply would wait behind the frames held until their launch time
+   if(txLaunchPending)
+   {
+      //Update statistics
+      NET_STATS_IF_INC(interface, offloadTxBusy, 1);
+      //Leave the request to the TCP/IP stack
+      return NULL;
+   }
+#endif
+
+   //Claim the current descriptor. The stack disables Ethernet interrupts
+   //whenever it calls the driver, so the ring is not being written
+   *index = txIndex;
+
+   //Increment index and wrap around if necessary
+   if(++txIndex >= txRingSize)
+   {
+      txIndex = 0;
+   }
+
+   //Return a pointer to the transmit buffer
+   return txBuffer[*index];
+#else
+   //Offload is not implemented
+   return NULL;
+#endif
+}
+
+
+/**
+ * @brief Send a frame built by the offload responder
+ * @param[in] index Index of the descriptor claimed for the frame
+ * @param[in] length Length of the frame
+ **/
+
+void stm32h7xxEthOffloadSend(uint_t index, size_t length)
+{
+#if (STM32H7XX_ETH_OFFLOAD_SUPPORT == ENABLED)
+   //Write back the frame to memory before the DMA reads it
+   STM32H7XX_ETH_CLEAN_DCACHE(txBuffer[index], length);
+
+   //Set the start address of the buffer
+   txDmaDesc[index].tdes0 = (uint32_t) txBuffer[index];
+   txDmaDesc[index].tdes1 = 0;
+   //Write the number of bytes to send
+   txDmaDesc[index].tdes2 = ETH_TDES2_IOC | (length & ETH_TDES2_B1L);
+   //Give the ownership of the descriptor to the DMA
+   txDmaDesc[index].tdes3 = ETH_TDES3_OWN | ETH_TDES3_FD | ETH_TDES3_LD;
+
+   //Data synchronization barrier
+   __DSB();
+
+   //Clear TBU flag to resume processing
+   ETH->DMACSR = ETH_DMACSR_TBU;
+   //Instruct the DMA to poll the transmit descriptor list
+   ETH->DMACTDTPR = 0;
+#endif
+}
+
+
+/**
+ * @brief Retrieve the checksum status of a received frame
+ * @param[in] rxDesc Pointer to the RX DMA descriptor (write-back format)
+ * @param[out] ancillary Additional options passed to the stack
+ **/
+
+void stm32h7xxEthGetRxChecksumStatus(const Stm32h7xxRxDmaDesc *rxDesc,
+   NetRxAncillary *ancillary)
+{
+#if (ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
+   uint32_t status;
+
+   //The RDES1 field is only valid when the RS1V bit is set
+   if((rxDesc->rdes3 & ETH_RDES3_RS1V) != 0)
+   {
+      //Get checksum status
+      status = rxDesc->rdes1;
+
+      //IPv4 packet with a valid header checksum?
+      if((status & ETH_RDES1_IPV4) != 0 && (status & ETH_RDES1_IPHE) == 0)
+      {
+         ancillary->ipChecksumValid = TRUE;
+
+         //The payload checksum is bypassed for IP fragments and for
+         //protocols other than TCP, UDP and ICMP
+         if((status & (ETH_RDES1_IPCB | ETH_RDES1_IPCE)) == 0)
+         {
+            //Check payload type
+            if((status & ETH_RDES1_PT) == ETH_RDES1_PT_UDP ||
+               (status & ETH_RDES1_PT) == ETH_RDES1_PT_TCP ||
+               (status & ETH_RDES1_PT) == ETH_RDES1_PT_ICMP)
+            {
+               ancillary->payloadChecksumValid = TRUE;
+            }
+         }
+      }
+   }
+#endif
+}
+
+
+/**
+ * @brief Release a receive buffer previously loaned to the stack
+ * @param[in] p Pointer within the loaned buffer
+ **/
+
+void stm32h7xxEthReleaseRxBuffer(void *p)
+{
+#if (NET_MEM_RX_LOAN_SUPPORT == ENABLED)
+   uint_t i;
+
+   //Retrieve the index of the buffer
+   i = ((uint8_t *) p - rxBuffer[0]) / STM32H7XX_ETH_RX_BUFFER_SIZE;
+
+   //Enter critical section
+   osSuspendAllTasks();
+
+   //Return the buffer to the spare list
+   if(i < STM32H7XX_ETH_RX_POOL_SIZE &&
+      rxSpareCount < STM32H7XX_ETH_RX_LOAN_BUFFER_COUNT)
+   {
+      rxSpareBuffer[rxSpareCount++] = rxBuffer[i];
+   }
+
+   //Exit critical section
+   osResumeAllTasks();
+#endif
+}
+
+
+/**
+ * @brief Configure MAC address filtering
+ * @param[in] interface Underlying network interface
+ * @return Error code
+ **/
+
+error_t stm32h7xxEthUpdateMacAddrFilter(NetInterface *interface)
+{
+   uint_t i;
+   uint_t j;
+   uint_t k;
+   uint_t n;
+   uint32_t crc;
+   uint32_t hashTable[2];
+   MacAddr perfectMacAddr[3];
+   MacFilterEntry *entry;
+
+   //Debug message
+   TRACE_DEBUG("Updating MAC filter...\r\n");
+
+   //Promiscuous mode?
+   if(interface->promiscuous)
+   {
+      //Pass all incoming frames regardless of their destination address
+      ETH->MACPFR = ETH_MACPFR_PR;
+   }
+   else
+   {
+      //Set the MAC address of the station
+      ETH->MACA0LR = interface->macAddr.w[0] | (interface->macAddr.w[1] << 16);
+      ETH->MACA0HR = interface->macAddr.w[2];
+
+      //The MAC supports 3 additional addresses for perfect filtering
+      perfectMacAddr[0] = MAC_UNSPECIFIED_ADDR;
+      perfectMacAddr[1] = MAC_UNSPECIFIED_ADDR;
+      perfectMacAddr[2] = MAC_UNSPECIFIED_ADDR;
+
+      //The hash table is used for the multicast addresses that do not fit
+      //in the perfect filter
+      hashTable[0] = 0;
+      hashTable[1] = 0;
+
+      //Unicast addresses can only be matched by the perfect filter, so they
+      //are given the first slots
+      for(i = 0, j = 0; i < MAC_ADDR_FILTER_SIZE; i++)
+      {
+         //Point to the current entry
+         entry = &interface->macAddrFilter[i];
+
+         //Valid unicast entry?
+         if(entry->refCount > 0 && !macIsMulticastAddr(&entry->addr))
+         {
+            //Up to 3 additional MAC addresses can be specified
+            if(j < 3)
+            {
+               //Save the unicast address
+               perfectMacAddr[j++] = entry->addr;
+            }
+         }
+      }
+
+      //The remaining slots are used for exact matching of multicast
+      //addresses, so that unrelated groups sharing a hash bucket are not
+      //passed to the host
+      for(i = 0, n = 0; i < MAC_ADDR_FILTER_SIZE; i++)
+      {
+         //Point to the current entry
+         entry = &interface->macAddrFilter[i];
+
+         //Valid multicast entry?
+         if(entry->refCount > 0 && macIsMulticastAddr(&entry->addr))
+         {
+            //Any perfect filter slot left?
+            if(j < 3)
+            {
+               //Save the multicast address
+               perfectMacAddr[j++] = entry->addr;
+            }
+            else
+            {
+               //Compute CRC over the current MAC address
+               crc = stm32h7xxEthCalcCrc(&entry->addr, sizeof(MacAddr));
+
+               //The upper 6 bits in the CRC register are used to index the
+               //contents of the hash table
+               k = (crc >> 26) & 0x3F;
+
+               //Update hash table contents
+               hashTable[k / 32] |= (1 << (k % 32));
+
+               //Number of multicast addresses in the hash table
+               n++;
+            }
+         }
+      }
+
+      //Configure the first additional address filter
+      if(j >= 1)
+      {
+         //When the AE bit is set, the entry is used for perfect filtering
+         ETH->MACA1LR = perfectMacAddr[0].w[0] | (perfectMacAddr[0].w[1] << 16);
+         ETH->MACA1HR = perfectMacAddr[0].w[2] | ETH_MACAHR_AE;
+      }
+      else
+      {
+         //When the AE bit is cleared, the entry is ignored
+         ETH->MACA1LR = 0;
+         ETH->MACA1HR = 0;
+      }
+
+      //Configure the second additional address filter
+      if(j >= 2)
+      {
+         //When the AE bit is set, the entry is used for perfect filtering
+         ETH->MACA2LR = perfectMacAddr[1].w[0] | (perfectMacAddr[1].w[1] << 16);
+         ETH->MACA2HR = perfectMacAddr[1].w[2] | ETH_MACAHR_AE;
+      }
+      else
+      {
+         //When the AE bit is cleared, the entry is ignored
+         ETH->MACA2LR = 0;
+         ETH->MACA2HR = 0;
+      }
+
+      //Configure the third additional address filter
+      if(j >= 3)
+      {
+         //When the AE bit is set, the entry is used for perfect filtering
+         ETH->MACA3LR = perfectMacAddr[2].w[0] | (perfectMacAddr[2].w[1] << 16);
+         ETH->MACA3HR = perfectMacAddr[2].w[2] | ETH_MACAHR_AE;
+      }
+      else
+      {
+         //When the AE bit is cleared, the entry is ignored
+         ETH->MACA3LR = 0;
+         ETH->MACA3HR = 0;
+      }
+
+      //Check whether frames with a multicast destination address should be
+      //accepted
+      if(interface->acceptAllMulticast)
+      {
+         //Configure the receive filter
+         ETH->MACPFR = ETH_MACPFR_HPF | ETH_MACPFR_PM;
+      }
+      else if(n > 0)
+      {
+         //Multicast frames pass if they match either the perfect filter or
+         //the hash table
+         ETH->MACPFR = ETH_MACPFR_HPF | ETH_MACPFR_HMC;
+
+         //Configure the multicast hash table
+         ETH->MACHT0R = hashTable[0];
+         ETH->MACHT1R = hashTable[1];
+
+         //Debug message
+         TRACE_DEBUG("  MACHT0R = %08" PRIX32 "\r\n", ETH->MACHT0R);
+         TRACE_DEBUG("  MACHT1R = %08" PRIX32 "\r\n", ETH->MACHT1R);
+      }
+      else
+      {
+         //All the multicast addresses fit in the perfect filter
+         ETH->MACPFR = 0;
+
+         //Clear the multicast hash table
+         ETH->MACHT0R = 0;
+         ETH->MACHT1R = 0;
+      }
+   }
+
+#if (ETH_VLAN_SUPPORT == ENABLED && STM32H7XX_ETH_VLAN_OFFLOAD_SUPPORT == ENABLED)
+   //Configure VLAN tag stripping and filtering
+   stm32h7xxEthUpdateVlanFilter(interface);
+#endif
+
+#if (IPV4_FIREWALL_SUPPORT == ENABLED)
+   //Enforce the firewall policy in the MAC, when it fits
+   stm32h7xxEthUpdateL3L4Filter(interface);
+#endif
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Configure VLAN tag stripping and filtering
+ *
+ * The tag of the received frames is removed by the MAC and reported in the
+ * descriptor. Tagged frames are only accepted if their VLAN identifier matches
+ * one of the interfaces bound to the physical interface, which the MAC checks
+ * against a 16-entry hash table. Untagged frames are not filtered
+ *
+ * @param[in] interface Underlying network interface
+ **/
+
+void stm32h7xxEthUpdateVlanFilter(NetInterface *interface)
+{
+#if (ETH_VLAN_SUPPORT == ENABLED && STM32H7XX_ETH_VLAN_OFFLOAD_SUPPORT == ENABLED)
+   uint_t i;
+   uint_t j;
+   uint_t k;
+   uint32_t crc;
+   uint16_t vlanId;
+   uint32_t hashTable;
+
+   //Clear the VLAN hash table
+   hashTable = 0;
+
+   //Loop through the interfaces bound to the physical interface
+   for(i = 0; i < NET_INTERFACE_COUNT; i++)
+   {
+      //Check whether the current interface is attached to this one
+      if(nicGetPhysicalInterface(&netInterface[i]) != interface)
+         continue;
+
+      //Untagged interfaces also receive priority-tagged frames (VID 0)
+      vlanId = nicGetVlanId(&netInterface[i]) & VLAN_VID_MASK;
+
+      //Compute the CRC over the 12-bit VLAN identifier, LSB first
+      for(crc = 0xFFFFFFFF, j = 0; j < 12; j++)
+      {
+         //Update CRC value
+         if(((crc ^ (vlanId >> j)) & 0x01) != 0)
+         {
+            crc = (crc >> 1) ^ 0xEDB88320;
+         }
+         else
+         {
+            crc = crc >> 1;
+         }
+      }
+
+      //The hash table is indexed by the 4 least significant bits of the
+      //complemented CRC, in reverse order
+      crc = ~crc;
+      k = ((crc & 0x01) << 3) | ((crc & 0x02) << 1) | ((crc & 0x04) >> 1) |
+         ((crc & 0x08) >> 3);
+
+      //Update hash table contents
+      hashTable |= 1 << k;
+   }
+
+   //Configure the VLAN hash table
+   ETH->MACVHTR = hashTable;
+
+   //Always strip the VLAN tag and report it in the receive descriptor. The
+   //hash table is indexed by the 12-bit VLAN identifier
+   ETH->MACVTR = ETH_MACVTR_EVLS_ALWAYSSTRIP | ETH_MACVTR_EVLRXS |
+      ETH_MACVTR_VTHM | ETH_MACVTR_ETV;
+
+   //In promiscuous mode, frames of any VLAN are accepted
+   if(!interface->promiscuous)
+   {
+      ETH->MACPFR |= ETH_MACPFR_VTFE;
+   }
+
+   //Debug message
+   TRACE_DEBUG("  MACVHTR = %08" PRIX32 "\r\n", ETH->MACVHTR);
+#endif
+}
+
+
+/**
+ * @brief Configure the L3/L4 filters from the firewall policy
+ *
+ * The MAC provides two filters, each matching the IPv4 source and destination
+ * addresses on a prefix, and a TCP or UDP source and destination port. Once
+ * L3/L4 filtering is enabled, the IPv4 packets matching none of the filters
+ * are dropped by the MAC, before they reach the DMA. Other frames, such as
+ * ARP, are not filtered, but IPv6 packets would never match, so the filters
+ * are left unused when IPv6 is enabled. In promiscuous mode, all the packets
+ * are received and left to the software check
+ *
+ * @param[in] interface Underlying network interface
+ **/
+
+void stm32h7xxEthUpdateL3L4Filter(NetInterface *interface)
+{
+#if (IPV4_SUPPORT == ENABLED && IPV4_FIREWALL_SUPPORT == ENABLED && \
+   IPV6_SUPPORT == DISABLED)
+   uint_t i;
+   uint_t n;
+   uint32_t control[2];
+   uint32_t ports[2];
+   uint32_t srcAddr[2];
+   uint32_t destAddr[2];
+   Ipv4FirewallHwFilter filters[2];
+   const Ipv4FirewallHwFilter *filter;
+
+   //Get the filters enforcing the policy, if it fits in the MAC
+   n = ipv4FirewallGetHwFilters(filters, interface->promiscuous ? 0 : 2);
+
+   //Format the contents of the filter registers
+   for(i = 0; i < 2; i++)
+   {
+      //Unused filters do not match any field
+      control[i] = 0;
+      ports[i] = 0;
+      srcAddr[i] = 0;
+      destAddr[i] = 0;
+
+      //Valid filter?
+      if(i < n)
+      {
+         //Point to the current filter
+         filter = &filters[i];
+
+         //Match the source address on a prefix. The L3HSBM field gives the
+         //number of low-order bits that are ignored
+         if(filter->srcPrefixLength > 0)
+         {
+            control[i] |= ETH_MACL3L4CR_L3SAM |
+               ((32 - filter->srcPrefixLength) << ETH_MACL3L4CR_L3HSBM_Pos);
+            srcAddr[i] = ntohl(filter->srcAddr);
+
+            //Inverse match?
+            if(filter->inverse)
+            {
+               control[i] |= ETH_MACL3L4CR_L3SAIM;
+            }
+         }
+
+         //Match the destination address on a prefix
+         if(filter->destPrefixLength > 0)
+         {
+            control[i] |= ETH_MACL3L4CR_L3DAM |
+               ((32 - filter->destPrefixLength) << ETH_MACL3L4CR_L3HDBM_Pos);
+            destAddr[i] = ntohl(filter->destAddr);
+
+            //Inverse match?
+            if(filter->inverse)
+            {
+               control[i] |= ETH_MACL3L4CR_L3DAIM;
+            }
+         }
+
+         //The ports are those of UDP if the L4PEN bit is set, TCP otherwise
+         if(filter->protocol == IP_PROTOCOL_UDP)
+         {
+            control[i] |= ETH_MACL3L4CR_L4PEN;
+         }
+
+         //Match the source port
+         if(filter->srcPort != 0)
+         {
+            control[i] |= ETH_MACL3L4CR_L4SPM;
+            ports[i] |= (uint32_t) filter->srcPort << ETH_MACL4AR_L4SP_Pos;
+         }
+
+         //Match the destination port
+         if(filter->destPort != 0)
+         {
+            control[i] |= ETH_MACL3L4CR_L4DPM;
+            ports[i] |= (uint32_t) filter->destPort << ETH_MACL4AR_L4DP_Pos;
+         }
+      }
+   }
+
+   //Program the first filter
+   ETH->MACL3L4C0R = 0;
+   ETH->MACL4A0R = ports[0];
+   ETH->MACL3A0R0R = srcAddr[0];
+   ETH->MACL3A1R0R = destAddr[0];
+   ETH->MACL3L4C0R = control[0];
+
+   //Program the second filter
+   ETH->MACL3L4C1R = 0;
+   ETH->MACL4A1R = ports[1];
+   ETH->MACL3A0R1R = srcAddr[1];
+   ETH->MACL3A1R1R = destAddr[1];
+   ETH->MACL3L4C1R = control[1];
+
+   //Drop the IPv4 packets that match none of the filters
+   if(n > 0)
+   {
+      ETH->MACPFR |= ETH_MACPFR_IPFE;
+   }
+   else
+   {
+      ETH->MACPFR &= ~ETH_MACPFR_IPFE;
+   }
+
+   //Debug message
+   TRACE_DEBUG("  L3/L4 filters = %u\r\n", n);
+#endif
+}
+
+
+/**
+ * @brief Adjust MAC configuration parameters for proper operation
+ * @param[in] interface Underlying network interface
+ * @return Error code
+ **/
+
+error_t stm32h7xxEthUpdateMacConfig(NetInterface *interface)
+{
+   uint32_t config;
+
+   //Read current MAC configuration
+   config = ETH->MACCR;
+
+   //10BASE-T or 100BASE-TX operation mode?
+   if(interface->linkSpeed == NIC_LINK_SPEED_100MBPS)
+   {
+      config |= ETH_MACCR_FES;
+   }
+   else
+   {
+      config &= ~ETH_MACCR_FES;
+   }
+
+   //Half-duplex or full-duplex mode?
+   if(interface->duplexMode == NIC_FULL_DUPLEX_MODE)
+   {
+      config |= ETH_MACCR_DM;
+   }
+   else
+   {
+      config &= ~ETH_MACCR_DM;
+   }
+
+   //Update MAC configuration register
+   ETH->MACCR = config;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Write PHY register
+ * @param[in] opcode Access type (2 bits)
+ * @param[in] phyAddr PHY address (5 bits)
+ * @param[in] regAddr Register address (5 bits)
+ * @param[in] data Register value
+ **/
+
+void stm32h7xxEthWritePhyReg(uint8_t opcode, uint8_t phyAddr,
+   uint8_t regAddr, uint16_t data)
+{
+   uint32_t temp;
+
+   //Valid opcode?
+   if(opcode == SMI_OPCODE_WRITE)
+   {
+      //Take care not to alter MDC clock configuration
+      temp = ETH->MACMDIOAR & ETH_MACMDIOAR_CR;
+      //Set up a write operation
+      temp |= ETH_MACMDIOAR_MOC_WR | ETH_MACMDIOAR_MB;
+      //PHY address
+      temp |= (phyAddr << 21) & ETH_MACMDIOAR_PA;
+      //Register address
+      temp |= (regAddr << 16) & ETH_MACMDIOAR_RDA;
+
+      //Data to be written in the PHY register
+      ETH->MACMDIODR = data & ETH_MACMDIODR_MD;
+
+      //Start a write operation
+      ETH->MACMDIOAR = temp;
+      //Wait for the write to complete
+      while((ETH->MACMDIOAR & ETH_MACMDIOAR_MB) != 0)
+      {
+      }
+   }
+   else
+   {
+      //The MAC peripheral only supports standard Clause 22 opcodes
+   }
+}
+
+
+/**
+ * @brief Read PHY register
+ * @param[in] opcode Access type (2 bits)
+ * @param[in] phyAddr PHY address (5 bits)
+ * @param[in] regAddr Register address (5 bits)
+ * @return Register value
+ **/
+
+uint16_t stm32h7xxEthReadPhyReg(uint8_t opcode, uint8_t phyAddr,
+   uint8_t regAddr)
+{
+   uint16_t data;
+   uint32_t temp;
+
+   //Valid opcode?
+   if(opcode == SMI_OPCODE_READ)
+   {
+      //Take care not to alter MDC clock configuration
+      temp = ETH->MACMDIOAR & ETH_MACMDIOAR_CR;
+      //Set up a read operation
+      temp |= ETH_MACMDIOAR_MOC_RD | ETH_MACMDIOAR_MB;
+      //PHY address
+      temp |= (phyAddr << 21) & ETH_MACMDIOAR_PA;
+      //Register address
+      temp |= (regAddr << 16) & ETH_MACMDIOAR_RDA;
+
+      //Start a read operation
+      ETH->MACMDIOAR = temp;
+      //Wait for the read to complete
+      while((ETH->MACMDIOAR & ETH_MACMDIOAR_MB) != 0)
+      {
+      }
+
+      //Get register value
+      data = ETH->MACMDIODR & ETH_MACMDIODR_MD;
+   }
+   else
+   {
+      //The MAC peripheral only supports standard Clause 22 opcodes
+      data = 0;
+   }
+
+   //Return the value of the PHY register
+   return data;
+}
+
+
+/**
+ * @brief Retrieve the receive time stamp of a frame
+ *
+ * When the MAC has captured a time stamp, the DMA writes it to the
+ * descriptor that follows the last descriptor of the frame, in the context
+ * format
+ *
+ * @param[in] index Index of the last descriptor of the frame
+ * @param[out] ancillary Additional options passed to the stack
+ **/
+
+void stm32h7xxEthGetRxTimestamp(uint_t index, NetRxAncillary *ancillary)
+{
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+   const Stm32h7xxRxDmaDesc *rxDesc;
+
+   //The RDES1 field is only valid when the RS1V bit is set
+   if((rxDmaDesc[index].rdes3 & ETH_RDES3_RS1V) != 0 &&
+      (rxDmaDesc[index].rdes1 & ETH_RDES1_TSA) != 0)
+   {
+      //Point to the context descriptor
+      rxDesc = &rxDmaDesc[(index + 1) % rxRingSize];
+
+      //Both words are all ones if the time stamp is corrupted
+      if((rxDesc->rdes3 & (ETH_RDES3_OWN | ETH_RDES3_CTXT)) == ETH_RDES3_CTXT &&
+         (rxDesc->rdes0 != 0xFFFFFFFF || rxDesc->rdes1 != 0xFFFFFFFF))
+      {
+         //Save the captured time stamp
+         ancillary->timestamp.s = rxDesc->rdes1 & ETH_RDES1_RTSH;
+         ancillary->timestamp.ns = rxDesc->rdes0 & ETH_RDES0_RTSL;
+      }
+   }
+#endif
+}
+
+
+/**
+ * @brief Report the transmit time stamps captured by the MAC
+ *
+ * The time stamp of a frame sent with a valid identifier is written back to
+ * its descriptor, which is then held until the time stamp has been handed
+ * over to ETH_TX_TIMESTAMP_HOOK
+ *
+ * @param[in] interface Underlying network interface
+ **/
+
+void stm32h7xxEthCollectTxTimestamps(NetInterface *interface)
+{
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+   uint_t i;
+   NetTimestamp timestamp;
+
+   //Any time stamp awaited?
+   if(txTimestampCount > 0)
+   {
+      //Loop through the TX descriptors
+      for(i = 0; i < txRingSize; i++)
+      {
+         //The frame has been sent?
+         if(txTimestampId[i] >= 0 && (txDmaDesc[i].tdes3 & ETH_TDES3_OWN) == 0)
+         {
+            //The time stamp is only valid when the TTSS bit is set
+            if((txDmaDesc[i].tdes3 & ETH_TDES3_TTSS) != 0)
+            {
+               //Retrieve the captured time stamp
+               timestamp.s = txDmaDesc[i].tdes1 & ETH_TDES1_TTSH;
+               timestamp.ns = txDmaDesc[i].tdes0 & ETH_TDES0_TTSL;
+
+               //Hand the time stamp over to the upper layers
+               ETH_TX_TIMESTAMP_HOOK(interface, txTimestampId[i], &timestamp);
+            }
+
+            //The descriptor can be reused
+            txTimestampId[i] = -1;
+            txTimestampCount--;
+         }
+      }
+   }
+#endif
+}
+
+
+/**
+ * @brief Start the PTP clock
+ *
+ * The system time counts seconds and nanoseconds (digital rollover). It is
+ * advanced by STM32H7XX_ETH_PTP_INCREMENT nanoseconds every time a 32-bit
+ * accumulator, to which the addend is added at each HCLK cycle, overflows.
+ * The frequency of the clock is thus trimmed through the addend, by about
+ * one part per billion, without any step. The MAC captures the receive time
+ * of the Sync messages of PTPv2 over UDP/IPv4, and the transmit time of the
+ * frames for which it is requested
+ *
+ * @param[in] interface Underlying network interface
+ **/
+
+void stm32h7xxEthInitPtp(NetInterface *interface)
+{
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+   uint64_t addend;
+
+   //Enable time stamping, the sub-second field counting nanoseconds
+   ETH->MACTSCR = ETH_MACTSCR_TSENA | ETH_MACTSCR_TSCTRLSSR;
+
+   //Take snapshots of the event messages relevant to a slave (Sync) of
+   //PTPv2 over UDP/IPv4
+   ETH->MACTSCR |= ETH_MACTSCR_TSVER2ENA | ETH_MACTSCR_TSIPV4ENA |
+      ETH_MACTSCR_TSEVNTENA;
+
+   //Nanoseconds added at each overflow of the accumulator
+   ETH->MACSSIR = (STM32H7XX_ETH_PTP_INCREMENT << ETH_MACSSIR_SSINC_Pos) &
+      ETH_MACSSIR_SSINC;
+
+   //The accumulator must overflow 10^9 / increment times per second, which
+   //requires HCLK to run faster than that
+   addend = ((uint64_t) (1000000000 / STM32H7XX_ETH_PTP_INCREMENT) << 32) /
+      HAL_RCC_GetHCLKFreq();
+
+   //Save the nominal addend
+   ptpNominalAddend = (uint32_t) addend;
+   ptpFreqAdj = 0;
+
+   //Load the addend
+   ETH->MACTSAR = ptpNominalAddend;
+   ETH->MACTSCR |= ETH_MACTSCR_TSADDREG;
+
+   //Wait for the update to complete
+   while((ETH->MACTSCR & ETH_MACTSCR_TSADDREG) != 0)
+   {
+   }
+
+   //Select the fine correction method
+   ETH->MACTSCR |= ETH_MACTSCR_TSCFUPDT;
+
+   //The clock starts from zero until it is set by a master
+   ETH->MACSTSUR = 0;
+   ETH->MACSTNUR = 0;
+   ETH->MACTSCR |= ETH_MACTSCR_TSINIT;
+
+   //Wait for the initialization to complete
+   while((ETH->MACTSCR & ETH_MACTSCR_TSINIT) != 0)
+   {
+   }
+#endif
+}
+
+
+/**
+ * @brief Read the PTP clock
+ * @param[out] timestamp Current time
+ **/
+
+void stm32h7xxEthGetPtpTime(NetTimestamp *timestamp)
+{
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+   uint32_t s;
+
+   //Read the nanoseconds again if the seconds rolled over in between
+   do
+   {
+      s = ETH->MACSTSR;
+      timestamp->ns = ETH->MACSTNR & ETH_MACSTNR_TSSS;
+   } while(s != ETH->MACSTSR);
+
+   //Save the seconds
+   timestamp->s = s;
+#else
+   //Time stamping is not implemented
+   timestamp->s = 0;
+   timestamp->ns = 0;
+#endif
+}
+
+
+/**
+ * @brief Set the PTP clock
+ * @param[in] timestamp New time
+ **/
+
+void stm32h7xxEthSetPtpTime(const NetTimestamp *timestamp)
+{
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+   //Wait for any previous update to complete
+   while((ETH->MACTSCR & (ETH_MACTSCR_TSINIT | ETH_MACTSCR_TSUPDT)) != 0)
+   {
+   }
+
+   //Load the new time
+   ETH->MACSTSUR = timestamp->s;
+   ETH->MACSTNUR = timestamp->ns & ETH_MACSTNUR_TSSS;
+   ETH->MACTSCR |= ETH_MACTSCR_TSINIT;
+#endif
+}
+
+
+/**
+ * @brief Step the PTP clock
+ * @param[in] offset Signed offset to add to the clock, in nanoseconds
+ **/
+
+void stm32h7xxEthAdjustPtpTime(int64_t offset)
+{
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+   uint64_t value;
+   uint32_t s;
+   uint32_t ns;
+
+   //Magnitude of the offset
+   value = (offset < 0) ? (uint64_t) -offset : (uint64_t) offset;
+   s = (uint32_t) (value / 1000000000);
+   ns = (uint32_t) (value % 1000000000);
+
+   //Wait for any previous update to complete
+   while((ETH->MACTSCR & (ETH_MACTSCR_TSINIT | ETH_MACTSCR_TSUPDT)) != 0)
+   {
+   }
+
+   //Negative offset?
+   if(offset < 0)
+   {
+      //A value to subtract is written as its complement to 2^32 seconds
+      //and 10^9 nanoseconds (digital rollover)
+      ETH->MACSTSUR = (uint32_t) (0 - s);
+      ETH->MACSTNUR = ETH_MACSTNUR_ADDSUB | ((ns != 0) ? (1000000000 - ns) : 0);
+   }
+   else
+   {
+      //The value is added to the system time
+      ETH->MACSTSUR = s;
+      ETH->MACSTNUR = ns;
+   }
+
+   //Update the system time
+   ETH->MACTSCR |= ETH_MACTSCR_TSUPDT;
+#endif
+}
+
+
+/**
+ * @brief Trim the frequency of the PTP clock
+ * @param[in] ppb Frequency offset from the nominal rate, in parts per
+ *   billion (limited to STM32H7XX_ETH_PTP_MAX_ADJ)
+ **/
+
+void stm32h7xxEthAdjustPtpFreq(int32_t ppb)
+{
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+   int64_t addend;
+
+   //Limit the correction
+   ppb = MIN(ppb, STM32H7XX_ETH_PTP_MAX_ADJ);
+   ppb = MAX(ppb, -STM32H7XX_ETH_PTP_MAX_ADJ);
+
+   //Keep the correction for a change of HCLK
+   ptpFreqAdj = ppb;
+
+   //The rate of the clock is proportional to the addend
+   addend = (int64_t) ptpNominalAddend +
+      ((int64_t) ptpNominalAddend * ppb) / 1000000000;
+
+   //Wait for any previous update to complete
+   while((ETH->MACTSCR & ETH_MACTSCR_TSADDREG) != 0)
+   {
+   }
+
+   //Load the new addend
+   ETH->MACTSAR = (uint32_t) addend;
+   ETH->MACTSCR |= ETH_MACTSCR_TSADDREG;
+#endif
+}
+
+
+/**
+ * @brief Follow a change of HCLK
+ *
+ * The rate of the PTP clock is proportional to HCLK: the nominal addend is
+ * derived again from the new frequency, the frequency correction being
+ * kept, and the time lost or gained while HCLK ran at another rate is
+ * added back in one step
+ *
+ * @param[in] offset Time to add to the PTP clock, in nanoseconds
+ **/
+
+void stm32h7xxEthUpdatePtpClock(int64_t offset)
+{
+#if (ETH_TIMESTAMP_SUPPORT == ENABLED)
+   //PTP clock not started?
+   if(ptpNominalAddend == 0)
+      return;
+
+   //Nominal addend at the new HCLK frequency
+   ptpNominalAddend = (uint32_t) (((uint64_t) (1000000000 /
+      STM32H7XX_ETH_PTP_INCREMENT) << 32) / HAL_RCC_GetHCLKFreq());
+
+   //Load it, with the current correction
+   stm32h7xxEthAdjustPtpFreq(ptpFreqAdj);
+
+   //Make up for the time the clock ran at the wrong rate
+   if(offset != 0)
+   {
+      stm32h7xxEthAdjustPtpTime(offset);
+   }
+#endif
+}
+
+
+/**
+ * @brief Hold the transmission until the PTP time reaches a launch time
+ *
+ * The frames written to the ring from now on are not notified to the DMA
+ * until the PTP clock reaches the target time of the flexible PPS output 0,
+ * programmed in interrupt-only mode. The jitter is that of the interrupt,
+ * plus the frame on the wire, if any, when it fires. A launch time already
+ * passed, or further ahead than STM32H7XX_ETH_MAX_LAUNCH_LEAD, lets the
+ * frame go at once
+ *
+ * @param[in] launchTime PTP time at which the held frames are sent
+ **/
+
+void stm32h7xxEthArmLaunch(const NetTimestamp *launchTime)
+{
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+   NetTimestamp now;
+   int64_t lead;
+
+   //Time left until the launch, in nanoseconds
+   stm32h7xxEthGetPtpTime(&now);
+   lead = ((int64_t) launchTime->s - (int64_t) now.s) * 1000000000 +
+      ((int64_t) launchTime->ns - (int64_t) now.ns);
+
+   //Launch time already passed?
+   if(lead <= 0)
+   {
+      //The frame is sent at once
+      launchStats.late++;
+      return;
+   }
+
+   //The ring would be held too long, or the target time register is still
+   //being loaded
+   if(lead > (int64_t) STM32H7XX_ETH_MAX_LAUNCH_LEAD * 1000000 ||
+      (ETH->MACPPSTTNR & ETH_MACPPSTTNR_TRGTBUSY0) != 0)
+   {
+      //The frame is sent at once
+      launchStats.outOfRange++;
+      return;
+   }
+
+   //Program the target time
+   ETH->MACPPSTTSR = launchTime->s;
+   ETH->MACPPSTTNR = launchTime->ns & ETH_MACPPSTTNR_TTSL0;
+
+   //The target time only raises an interrupt, the PPS output is left alone
+   ETH->MACPPSCR &= ~ETH_MACPPSCR_TRGTMODSEL0;
+
+   //Clear any stale target time status
+   (void) ETH->MACTSSR;
+
+   //Hold the DMA notifications until the interrupt fires
+   txLaunchTime = *launchTime;
+   txLaunchPending = TRUE;
+
+   //Enable the time stamp interrupt
+   ETH->MACIER |= ETH_MACIER_TSIE;
+#endif
+}
+
+
+/**
+ * @brief Notify the DMA of the frames held until the launch time
+ **/
+
+void stm32h7xxEthLaunch(void)
+{
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+   //Disable the time stamp interrupt
+   ETH->MACIER &= ~ETH_MACIER_TSIE;
+   //The ring is no longer held
+   txLaunchPending = FALSE;
+
+   //Clear TBU flag to resume processing
+   ETH->DMACSR = ETH_DMACSR_TBU;
+   //Instruct the DMA to poll the transmit descriptor list
+   ETH->DMACTDTPR = 0;
+
+   //All the descriptors have been notified
+   txKickPending = FALSE;
+#endif
+}
+
+
+/**
+ * @brief Release the held frames if the launch time moved out of range
+ *
+ * Stepping the PTP clock back after a launch has been armed would hold the
+ * ring for as long as the step
+ *
+ * @param[in] interface Underlying network interface
+ **/
+
+void stm32h7xxEthCheckLaunch(NetInterface *interface)
+{
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+   NetTimestamp now;
+   int64_t lead;
 
-      //Increment index and wrap around if necessary
-      if(++rxIndex >= STM32H7XX_ETH_RX_BUFFER_COUNT)
+   //Any frame held?
+   if(txLaunchPending)
+   {
+      //Time left until the launch, in nanoseconds
+      stm32h7xxEthGetPtpTime(&now);
+      lead = ((int64_t) txLaunchTime.s - (int64_t) now.s) * 1000000000 +
+         ((int64_t) txLaunchTime.ns - (int64_t) now.ns);
+
+      //Further ahead than any launch accepted?
+      if(lead > (int64_t) STM32H7XX_ETH_MAX_LAUNCH_LEAD * 1000000)
       {
-         rxIndex = 0;
+         //Send the held frames now
+         launchStats.outOfRange++;
+         stm32h7xxEthLaunch();
       }
    }
-   else
-   {
-      //No more data in the receive buffer
-      error = ERROR_BUFFER_EMPTY;
-   }
+#endif
+}
 
-   //Clear RBU flag to resume processing
-   ETH->DMACSR = ETH_DMACSR_RBU;
-   //Instruct the DMA to poll the receive descriptor list
-   ETH->DMACRDTPR = 0;
 
-   //Return status code
-   return error;
+/**
+ * @brief Get time-triggered transmission statistics
+ * @param[out] stats Copy of the counters
+ **/
+
+void stm32h7xxEthGetLaunchStats(Stm32h7xxEthLaunchStats *stats)
+{
+#if (ETH_LAUNCH_TIME_SUPPORT == ENABLED)
+   //Copy the counters
+   *stats = launchStats;
+#else
+   //Time-triggered transmission is not implemented
+   osMemset(stats, 0, sizeof(Stm32h7xxEthLaunchStats));
+#endif
 }
 
 
 /**
- * @brief Configure MAC address filtering
+ * @brief Enter the power-down mode of the MAC
+ *
+ * The transmitter is stopped and the receiver discards every frame but the
+ * selected wakeup frames. The PMT unit raises the ETH wakeup line of the
+ * EXTI, which brings the MCU out of Stop mode. The function must be called
+ * with the TCP/IP stack locked
+ *
  * @param[in] interface Underlying network interface
+ * @param[in] events Wakeup events (STM32H7XX_ETH_WAKEUP_MAGIC_PACKET and/or
+ *   STM32H7XX_ETH_WAKEUP_UNICAST)
  * @return Error code
  **/
 
-error_t stm32h7xxEthUpdateMacAddrFilter(NetInterface *interface)
+error_t stm32h7xxEthEnterPowerDown(NetInterface *interface, uint_t events)
 {
+#if (STM32H7XX_ETH_WOL_SUPPORT == ENABLED)
    uint_t i;
-   uint_t j;
-   uint_t k;
-   uint32_t crc;
-   uint32_t hashTable[2];
-   MacAddr unicastMacAddr[3];
-   MacFilterEntry *entry;
-
-   //Debug message
-   TRACE_DEBUG("Updating MAC filter...\r\n");
+   uint32_t value;
 
-   //Promiscuous mode?
-   if(interface->promiscuous)
+   //At least one wakeup event must be selected
+   if((events & (STM32H7XX_ETH_WAKEUP_MAGIC_PACKET |
+      STM32H7XX_ETH_WAKEUP_UNICAST)) == 0)
    {
-      //Pass all incoming frames regardless of their destination address
-      ETH->MACPFR = ETH_MACPFR_PR;
+      return ERROR_INVALID_PARAMETER;
    }
-   else
-   {
-      //Set the MAC address of the station
-      ETH->MACA0LR = interface->macAddr.w[0] | (interface->macAddr.w[1] << 16);
-      ETH->MACA0HR = interface->macAddr.w[2];
 
-      //The MAC supports 3 additional addresses for unicast perfect filtering
-      unicastMacAddr[0] = MAC_UNSPECIFIED_ADDR;
-      unicastMacAddr[1] = MAC_UNSPECIFIED_ADDR;
-      unicastMacAddr[2] = MAC_UNSPECIFIED_ADDR;
+   //Already in power-down mode?
+   if(wolStats.powerDown)
+      return ERROR_WRONG_STATE;
 
-      //The hash table is used for multicast address filtering
-      hashTable[0] = 0;
-      hashTable[1] = 0;
+   //Debug message
+   TRACE_INFO("STM32H7 Ethernet MAC entering power-down mode...\r\n");
 
-      //The MAC address filter contains the list of MAC addresses to accept
-      //when receiving an Ethernet frame
-      for(i = 0, j = 0; i < MAC_ADDR_FILTER_SIZE; i++)
-      {
-         //Point to the current entry
-         entry = &interface->macAddrFilter[i];
+   //Stop the transmit DMA once the current frame has been fetched
+   ETH->DMACTCR &= ~ETH_DMACTCR_ST;
 
-         //Valid entry?
-         if(entry->refCount > 0)
-         {
-            //Multicast address?
-            if(macIsMulticastAddr(&entry->addr))
-            {
-               //Compute CRC over the current MAC address
-               crc = stm32h7xxEthCalcCrc(&entry->addr, sizeof(MacAddr));
+   //Wait for the transmit process to stop and the TX FIFO to drain
+   for(i = 0; i < 10000; i++)
+   {
+      if((ETH->DMADSR & ETH_DMADSR_TPS) == ETH_DMADSR_TPS_STOPPED &&
+         (ETH->MTLTQDR & (ETH_MTLTQDR_TXQSTS | ETH_MTLTQDR_TRCSTS)) == 0)
+      {
+         break;
+      }
+   }
 
-               //The upper 6 bits in the CRC register are used to index the
-               //contents of the hash table
-               k = (crc >> 26) & 0x3F;
+   //Disable the MAC transmitter and receiver
+   ETH->MACCR &= ~(ETH_MACCR_TE | ETH_MACCR_RE);
 
-               //Update hash table contents
-               hashTable[k / 32] |= (1 << (k % 32));
-            }
-            else
-            {
-               //Up to 3 additional MAC addresses can be specified
-               if(j < 3)
-               {
-                  //Save the unicast address
-                  unicastMacAddr[j++] = entry->addr;
-               }
-            }
-         }
-      }
+   //Let the receive DMA move the frames left in the RX FIFO to the ring
+   for(i = 0; i < 10000; i++)
+   {
+      if((ETH->MTLRQDR & (ETH_MTLRQDR_PRXQ | ETH_MTLRQDR_RXQSTS)) == 0)
+         break;
+   }
 
-      //Configure the first unicast address filter
-      if(j >= 1)
-      {
-         //When the AE bit is set, the entry is used for perfect filtering
-         ETH->MACA1LR = unicastMacAddr[0].w[0] | (unicastMacAddr[0].w[1] << 16);
-         ETH->MACA1HR = unicastMacAddr[0].w[2] | ETH_MACAHR_AE;
-      }
-      else
-      {
-         //When the AE bit is cleared, the entry is ignored
-         ETH->MACA1LR = 0;
-         ETH->MACA1HR = 0;
-      }
+   //Clear the status bits left by a previous wakeup
+   value = ETH->MACPCSR;
+   pmtStatus = 0;
 
-      //Configure the second unicast address filter
-      if(j >= 2)
-      {
-         //When the AE bit is set, the entry is used for perfect filtering
-         ETH->MACA2LR = unicastMacAddr[1].w[0] | (unicastMacAddr[1].w[1] << 16);
-         ETH->MACA2HR = unicastMacAddr[1].w[2] | ETH_MACAHR_AE;
-      }
-      else
-      {
-         //When the AE bit is cleared, the entry is ignored
-         ETH->MACA2LR = 0;
-         ETH->MACA2HR = 0;
-      }
+   //Unmask the ETH wakeup line of the EXTI
+   EXTI_D1->PR3 = EXTI_PR3_PR86;
+   EXTI_D1->IMR3 |= EXTI_IMR3_IM86;
 
-      //Configure the third unicast address filter
-      if(j >= 3)
-      {
-         //When the AE bit is set, the entry is used for perfect filtering
-         ETH->MACA3LR = unicastMacAddr[2].w[0] | (unicastMacAddr[2].w[1] << 16);
-         ETH->MACA3HR = unicastMacAddr[2].w[2] | ETH_MACAHR_AE;
-      }
-      else
-      {
-         //When the AE bit is cleared, the entry is ignored
-         ETH->MACA3LR = 0;
-         ETH->MACA3HR = 0;
-      }
+   //The wakeup interrupt shares the priority of the Ethernet interrupt
+   NVIC_SetPriority(ETH_WKUP_IRQn, NVIC_EncodePriority(STM32H7XX_ETH_IRQ_PRIORITY_GROUPING,
+      STM32H7XX_ETH_IRQ_GROUP_PRIORITY, STM32H7XX_ETH_IRQ_SUB_PRIORITY));
+   NVIC_ClearPendingIRQ(ETH_WKUP_IRQn);
+   NVIC_EnableIRQ(ETH_WKUP_IRQn);
 
-      //Check whether frames with a multicast destination address should be
-      //accepted
-      if(interface->acceptAllMulticast)
-      {
-         //Configure the receive filter
-         ETH->MACPFR = ETH_MACPFR_HPF | ETH_MACPFR_PM;
-      }
-      else
-      {
-         //Configure the receive filter
-         ETH->MACPFR = ETH_MACPFR_HPF | ETH_MACPFR_HMC;
+   //Select the wakeup frames
+   value = 0;
 
-         //Configure the multicast hash table
-         ETH->MACHT0R = hashTable[0];
-         ETH->MACHT1R = hashTable[1];
+   //Magic packet carrying the MAC address of the interface?
+   if((events & STM32H7XX_ETH_WAKEUP_MAGIC_PACKET) != 0)
+   {
+      value |= ETH_MACPCSR_MGKPKTEN;
+   }
 
-         //Debug message
-         TRACE_DEBUG("  MACHT0R = %08" PRIX32 "\r\n", ETH->MACHT0R);
-         TRACE_DEBUG("  MACHT1R = %08" PRIX32 "\r\n", ETH->MACHT1R);
-      }
+   //Any unicast frame accepted by the address filter?
+   if((events & STM32H7XX_ETH_WAKEUP_UNICAST) != 0)
+   {
+      value |= ETH_MACPCSR_RWKPKTEN | ETH_MACPCSR_GLBLUCAST;
    }
 
+   //The wakeup events must be enabled before the power-down mode
+   ETH->MACPCSR = value;
+   ETH->MACPCSR = value | ETH_MACPCSR_PWRDWN;
+
+   //The receiver only looks for wakeup frames from now on
+   ETH->MACCR |= ETH_MACCR_RE;
+
+   //Update statistics
+   wolStats.powerDown = TRUE;
+   wolStats.powerDowns++;
+
    //Successful processing
    return NO_ERROR;
+#else
+   //Wake-on-LAN is not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
 }
 
 
 /**
- * @brief Adjust MAC configuration parameters for proper operation
+ * @brief Leave the power-down mode of the MAC
+ *
+ * The function is invoked by the event handler once a wakeup frame has been
+ * received, or by the application (with the TCP/IP stack locked) to resume
+ * normal operation before any wakeup frame
+ *
  * @param[in] interface Underlying network interface
- * @return Error code
  **/
 
-error_t stm32h7xxEthUpdateMacConfig(NetInterface *interface)
+void stm32h7xxEthExitPowerDown(NetInterface *interface)
 {
-   uint32_t config;
+#if (STM32H7XX_ETH_WOL_SUPPORT == ENABLED)
+   uint32_t status;
 
-   //Read current MAC configuration
-   config = ETH->MACCR;
+   //Not in power-down mode?
+   if(!wolStats.powerDown)
+      return;
 
-   //10BASE-T or 100BASE-TX operation mode?
-   if(interface->linkSpeed == NIC_LINK_SPEED_100MBPS)
-   {
-      config |= ETH_MACCR_FES;
-   }
-   else
-   {
-      config &= ~ETH_MACCR_FES;
-   }
+   //Mask the ETH wakeup line
+   NVIC_DisableIRQ(ETH_WKUP_IRQn);
+   EXTI_D1->IMR3 &= ~EXTI_IMR3_IM86;
+   EXTI_D1->PR3 = EXTI_PR3_PR86;
 
-   //Half-duplex or full-duplex mode?
-   if(interface->duplexMode == NIC_FULL_DUPLEX_MODE)
+   //Get the wakeup status (reading the register clears the status bits)
+   status = pmtStatus | ETH->MACPCSR;
+   pmtStatus = 0;
+
+   //Update statistics
+   if((status & ETH_MACPCSR_MGKPRCVD) != 0)
    {
-      config |= ETH_MACCR_DM;
+      wolStats.magicPackets++;
    }
-   else
+
+   if((status & ETH_MACPCSR_RWKPRCVD) != 0)
    {
-      config &= ~ETH_MACCR_DM;
+      wolStats.unicastFrames++;
    }
 
-   //Update MAC configuration register
-   ETH->MACCR = config;
+   //The PWRDWN bit is cleared by hardware on a wakeup frame, and must be
+   //cleared by software otherwise
+   ETH->MACPCSR = 0;
 
-   //Successful processing
-   return NO_ERROR;
+   //Debug message
+   TRACE_INFO("STM32H7 Ethernet MAC leaving power-down mode...\r\n");
+
+   //Re-enable the MAC transmitter and restart the transmit DMA
+   ETH->MACCR |= ETH_MACCR_TE;
+   ETH->DMACTCR |= ETH_DMACTCR_ST;
+
+   //Frames queued meanwhile are sent now
+   ETH->DMACTDTPR = 0;
+
+   wolStats.powerDown = FALSE;
+
+   //The transmitter is ready to send
+   osSetEvent(&interface->nicTxEvent);
+#endif
 }
 
 
 /**
- * @brief Write PHY register
- * @param[in] opcode Access type (2 bits)
- * @param[in] phyAddr PHY address (5 bits)
- * @param[in] regAddr Register address (5 bits)
- * @param[in] data Register value
+ * @brief Get Wake-on-LAN statistics
+ * @param[out] stats Copy of the counters
  **/
 
-void stm32h7xxEthWritePhyReg(uint8_t opcode, uint8_t phyAddr,
-   uint8_t regAddr, uint16_t data)
+void stm32h7xxEthGetWolStats(Stm32h7xxEthWolStats *stats)
 {
-   uint32_t temp;
-
-   //Valid opcode?
-   if(opcode == SMI_OPCODE_WRITE)
-   {
-      //Take care not to alter MDC clock configuration
-      temp = ETH->MACMDIOAR & ETH_MACMDIOAR_CR;
-      //Set up a write operation
-      temp |= ETH_MACMDIOAR_MOC_WR | ETH_MACMDIOAR_MB;
-      //PHY address
-      temp |= (phyAddr << 21) & ETH_MACMDIOAR_PA;
-      //Register address
-      temp |= (regAddr << 16) & ETH_MACMDIOAR_RDA;
-
-      //Data to be written in the PHY register
-      ETH->MACMDIODR = data & ETH_MACMDIODR_MD;
-
-      //Start a write operation
-      ETH->MACMDIOAR = temp;
-      //Wait for the write to complete
-      while((ETH->MACMDIOAR & ETH_MACMDIOAR_MB) != 0)
-      {
-      }
-   }
-   else
-   {
-      //The MAC peripheral only supports standard Clause 22 opcodes
-   }
+#if (STM32H7XX_ETH_WOL_SUPPORT == ENABLED)
+   //Copy the counters
+   *stats = wolStats;
+#else
+   //Wake-on-LAN is not implemented
+   osMemset(stats, 0, sizeof(Stm32h7xxEthWolStats));
+#endif
 }
 
 
+#if (STM32H7XX_ETH_WOL_SUPPORT == ENABLED)
+
 /**
- * @brief Read PHY register
- * @param[in] opcode Access type (2 bits)
- * @param[in] phyAddr PHY address (5 bits)
- * @param[in] regAddr Register address (5 bits)
- * @return Register value
+ * @brief STM32H7 Ethernet wakeup interrupt service routine
  **/
 
-uint16_t stm32h7xxEthReadPhyReg(uint8_t opcode, uint8_t phyAddr,
-   uint8_t regAddr)
+void ETH_WKUP_IRQHandler(void)
 {
-   uint16_t data;
-   uint32_t temp;
+   bool_t flag;
 
-   //Valid opcode?
-   if(opcode == SMI_OPCODE_READ)
-   {
-      //Take care not to alter MDC clock configuration
-      temp = ETH->MACMDIOAR & ETH_MACMDIOAR_CR;
-      //Set up a read operation
-      temp |= ETH_MACMDIOAR_MOC_RD | ETH_MACMDIOAR_MB;
-      //PHY address
-      temp |= (phyAddr << 21) & ETH_MACMDIOAR_PA;
-      //Register address
-      temp |= (regAddr << 16) & ETH_MACMDIOAR_RDA;
+   //Interrupt service routine prologue
+   osEnterIsr();
 
-      //Start a read operation
-      ETH->MACMDIOAR = temp;
-      //Wait for the read to complete
-      while((ETH->MACMDIOAR & ETH_MACMDIOAR_MB) != 0)
-      {
-      }
+   //Clear the pending bit of the ETH wakeup line
+   EXTI_D1->PR3 = EXTI_PR3_PR86;
 
-      //Get register value
-      data = ETH->MACMDIODR & ETH_MACMDIODR_MD;
-   }
-   else
-   {
-      //The MAC peripheral only supports standard Clause 22 opcodes
-      data = 0;
-   }
+   //Reading the PMT status register acknowledges the wakeup event. The
+   //PWRDWN bit is added so that the latched status is never zero
+   pmtStatus |= ETH->MACPCSR | ETH_MACPCSR_PWRDWN;
 
-   //Return the value of the PHY register
-   return data;
+   //The TCP/IP stack leaves the power-down mode from its own context
+   nicDriverInterface->nicEvent = TRUE;
+   //Notify the TCP/IP stack of the event
+   flag = osSetEventFromIsr(&netEvent);
+
+   //Interrupt service routine epilogue
+   osExitIsr(flag);
 }
 
+#endif
+
 
 /**
  * @brief CRC calculation
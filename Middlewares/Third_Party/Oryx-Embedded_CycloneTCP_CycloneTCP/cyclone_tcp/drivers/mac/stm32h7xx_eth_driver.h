@@ -48,6 +48,13 @@
    #error STM32H7XX_ETH_TX_BUFFER_SIZE parameter is not valid
 #endif
 
+//Minimum frame length for zero-copy transmission
+#ifndef STM32H7XX_ETH_TX_ZERO_COPY_THRESHOLD
+   #define STM32H7XX_ETH_TX_ZERO_COPY_THRESHOLD 256
+#elif (STM32H7XX_ETH_TX_ZERO_COPY_THRESHOLD < 0)
+   #error STM32H7XX_ETH_TX_ZERO_COPY_THRESHOLD parameter is not valid
+#endif
+
 //Number of RX buffers
 #ifndef STM32H7XX_ETH_RX_BUFFER_COUNT
    #define STM32H7XX_ETH_RX_BUFFER_COUNT 8
@@ -62,6 +69,91 @@
    #error STM32H7XX_ETH_RX_BUFFER_SIZE parameter is not valid
 #endif
 
+//Jumbo frame support
+#ifndef STM32H7XX_ETH_JUMBO_SUPPORT
+   #define STM32H7XX_ETH_JUMBO_SUPPORT DISABLED
+#elif (STM32H7XX_ETH_JUMBO_SUPPORT != ENABLED && STM32H7XX_ETH_JUMBO_SUPPORT != DISABLED)
+   #error STM32H7XX_ETH_JUMBO_SUPPORT parameter is not valid
+#endif
+
+//MTU of the interface when jumbo frames are enabled
+#ifndef STM32H7XX_ETH_JUMBO_MTU
+   #define STM32H7XX_ETH_JUMBO_MTU 9000
+#elif (STM32H7XX_ETH_JUMBO_MTU < 1500 || STM32H7XX_ETH_JUMBO_MTU > 9000)
+   #error STM32H7XX_ETH_JUMBO_MTU parameter is not valid
+#endif
+
+//Number of spare RX buffers that can be loaned to the stack
+#ifndef STM32H7XX_ETH_RX_LOAN_BUFFER_COUNT
+   #define STM32H7XX_ETH_RX_LOAN_BUFFER_COUNT 4
+#elif (STM32H7XX_ETH_RX_LOAN_BUFFER_COUNT < 1)
+   #error STM32H7XX_ETH_RX_LOAN_BUFFER_COUNT parameter is not valid
+#endif
+
+//Maximum number of frames processed per wakeup
+#ifndef STM32H7XX_ETH_RX_BUDGET
+   #define STM32H7XX_ETH_RX_BUDGET 8
+#elif (STM32H7XX_ETH_RX_BUDGET < 1)
+   #error STM32H7XX_ETH_RX_BUDGET parameter is not valid
+#endif
+
+//RX interrupt watchdog (units of 256 AHB clock cycles, 0 to disable)
+#ifndef STM32H7XX_ETH_RX_IRQ_WATCHDOG
+   #define STM32H7XX_ETH_RX_IRQ_WATCHDOG 0
+#elif (STM32H7XX_ETH_RX_IRQ_WATCHDOG < 0 || STM32H7XX_ETH_RX_IRQ_WATCHDOG > 255)
+   #error STM32H7XX_ETH_RX_IRQ_WATCHDOG parameter is not valid
+#endif
+
+//ARP and ICMP echo offload responder
+#ifndef STM32H7XX_ETH_OFFLOAD_SUPPORT
+   #define STM32H7XX_ETH_OFFLOAD_SUPPORT DISABLED
+#elif (STM32H7XX_ETH_OFFLOAD_SUPPORT != ENABLED && STM32H7XX_ETH_OFFLOAD_SUPPORT != DISABLED)
+   #error STM32H7XX_ETH_OFFLOAD_SUPPORT parameter is not valid
+#endif
+
+//Hardware VLAN tag insertion, stripping and filtering
+#ifndef STM32H7XX_ETH_VLAN_OFFLOAD_SUPPORT
+   #define STM32H7XX_ETH_VLAN_OFFLOAD_SUPPORT DISABLED
+#elif (STM32H7XX_ETH_VLAN_OFFLOAD_SUPPORT != ENABLED && STM32H7XX_ETH_VLAN_OFFLOAD_SUPPORT != DISABLED)
+   #error STM32H7XX_ETH_VLAN_OFFLOAD_SUPPORT parameter is not valid
+#endif
+
+//Power-down mode with Wake-on-LAN
+#ifndef STM32H7XX_ETH_WOL_SUPPORT
+   #define STM32H7XX_ETH_WOL_SUPPORT DISABLED
+#elif (STM32H7XX_ETH_WOL_SUPPORT != ENABLED && STM32H7XX_ETH_WOL_SUPPORT != DISABLED)
+   #error STM32H7XX_ETH_WOL_SUPPORT parameter is not valid
+#endif
+
+//Largest ICMP echo request answered by the offload responder
+#ifndef STM32H7XX_ETH_OFFLOAD_MAX_ECHO_SIZE
+   #define STM32H7XX_ETH_OFFLOAD_MAX_ECHO_SIZE 128
+#elif (STM32H7XX_ETH_OFFLOAD_MAX_ECHO_SIZE < 8 || \
+   STM32H7XX_ETH_OFFLOAD_MAX_ECHO_SIZE > (STM32H7XX_ETH_TX_BUFFER_SIZE - 34))
+   #error STM32H7XX_ETH_OFFLOAD_MAX_ECHO_SIZE parameter is not valid
+#endif
+
+//Sub-second increment of the PTP clock, in nanoseconds
+#ifndef STM32H7XX_ETH_PTP_INCREMENT
+   #define STM32H7XX_ETH_PTP_INCREMENT 20
+#elif (STM32H7XX_ETH_PTP_INCREMENT < 1 || STM32H7XX_ETH_PTP_INCREMENT > 255)
+   #error STM32H7XX_ETH_PTP_INCREMENT parameter is not valid
+#endif
+
+//Largest frequency correction of the PTP clock, in parts per billion
+#ifndef STM32H7XX_ETH_PTP_MAX_ADJ
+   #define STM32H7XX_ETH_PTP_MAX_ADJ 500000
+#elif (STM32H7XX_ETH_PTP_MAX_ADJ < 1 || STM32H7XX_ETH_PTP_MAX_ADJ > 10000000)
+   #error STM32H7XX_ETH_PTP_MAX_ADJ parameter is not valid
+#endif
+
+//Largest lead of a launch time over the PTP time, in milliseconds
+#ifndef STM32H7XX_ETH_MAX_LAUNCH_LEAD
+   #define STM32H7XX_ETH_MAX_LAUNCH_LEAD 100
+#elif (STM32H7XX_ETH_MAX_LAUNCH_LEAD < 1 || STM32H7XX_ETH_MAX_LAUNCH_LEAD > 1000)
+   #error STM32H7XX_ETH_MAX_LAUNCH_LEAD parameter is not valid
+#endif
+
 //Interrupt priority grouping
 #ifndef STM32H7XX_ETH_IRQ_PRIORITY_GROUPING
    #define STM32H7XX_ETH_IRQ_PRIORITY_GROUPING 3
@@ -83,14 +175,67 @@
    #error STM32H7XX_ETH_IRQ_SUB_PRIORITY parameter is not valid
 #endif
 
+//Hook invoked on entry to the Ethernet interrupt handler
+#ifndef STM32H7XX_ETH_IRQ_ENTER_HOOK
+   #define STM32H7XX_ETH_IRQ_ENTER_HOOK()
+#endif
+
+//Hook invoked on exit from the Ethernet interrupt handler
+#ifndef STM32H7XX_ETH_IRQ_EXIT_HOOK
+   #define STM32H7XX_ETH_IRQ_EXIT_HOOK()
+#endif
+
 //Name of the section where to place DMA buffers
 #ifndef STM32H7XX_ETH_RAM_SECTION
    #define STM32H7XX_ETH_RAM_SECTION ".ram_no_cache"
 #endif
 
+//Explicit cache maintenance of DMA buffers
+#ifndef STM32H7XX_ETH_CACHE_MAINTENANCE
+   #define STM32H7XX_ETH_CACHE_MAINTENANCE DISABLED
+#elif (STM32H7XX_ETH_CACHE_MAINTENANCE != ENABLED && STM32H7XX_ETH_CACHE_MAINTENANCE != DISABLED)
+   #error STM32H7XX_ETH_CACHE_MAINTENANCE parameter is not valid
+#endif
+
+//Name of the section where to place DMA descriptors (must be non-cacheable)
+#ifndef STM32H7XX_ETH_DESC_SECTION
+   #define STM32H7XX_ETH_DESC_SECTION STM32H7XX_ETH_RAM_SECTION
+#endif
+
+//Name of the section where to place TX and RX buffers
+#ifndef STM32H7XX_ETH_BUFFER_SECTION
+   #if (STM32H7XX_ETH_CACHE_MAINTENANCE == ENABLED)
+      #define STM32H7XX_ETH_BUFFER_SECTION ".eth_buffer"
+   #else
+      #define STM32H7XX_ETH_BUFFER_SECTION STM32H7XX_ETH_RAM_SECTION
+   #endif
+#endif
+
+//MTU of the interface
+#if (STM32H7XX_ETH_JUMBO_SUPPORT == ENABLED)
+   #define STM32H7XX_ETH_MTU STM32H7XX_ETH_JUMBO_MTU
+#else
+   #define STM32H7XX_ETH_MTU ETH_MTU
+#endif
+
+//Largest frame accepted by the MAC (two VLAN tags and the CRC included)
+#if (STM32H7XX_ETH_JUMBO_SUPPORT == ENABLED)
+   #define STM32H7XX_ETH_MAX_FRAME_SIZE (STM32H7XX_ETH_JUMBO_MTU + 26)
+#else
+   #define STM32H7XX_ETH_MAX_FRAME_SIZE STM32H7XX_ETH_RX_BUFFER_SIZE
+#endif
+
 //ETH_MACCR register
 #define ETH_MACCR_RESERVED15 0x00008000
 
+//ETH_MACSSIR register
+#define ETH_MACSSIR_SSINC      0x00FF0000
+#define ETH_MACSSIR_SSINC_Pos  16
+
+//Wake-on-LAN events
+#define STM32H7XX_ETH_WAKEUP_MAGIC_PACKET 0x01
+#define STM32H7XX_ETH_WAKEUP_UNICAST      0x02
+
 //Transmit normal descriptor (read format)
 #define ETH_TDES0_BUF1AP        0xFFFFFFFF
 #define ETH_TDES1_BUF2AP        0xFFFFFFFF
@@ -98,6 +243,7 @@
 #define ETH_TDES2_TTSE          0x40000000
 #define ETH_TDES2_B2L           0x3FFF0000
 #define ETH_TDES2_VTIR          0x0000C000
+#define ETH_TDES2_VTIR_INSERT   0x00008000
 #define ETH_TDES2_B1L           0x00003FFF
 #define ETH_TDES3_OWN           0x80000000
 #define ETH_TDES3_CTXT          0x40000000
@@ -169,6 +315,9 @@
 #define ETH_RDES1_IPV4          0x00000010
 #define ETH_RDES1_IPHE          0x00000008
 #define ETH_RDES1_PT            0x00000007
+#define ETH_RDES1_PT_UDP        0x00000001
+#define ETH_RDES1_PT_TCP        0x00000002
+#define ETH_RDES1_PT_ICMP       0x00000003
 #define ETH_RDES2_L3L4FM        0xE0000000
 #define ETH_RDES2_L4FM          0x10000000
 #define ETH_RDES2_L3FM          0x08000000
@@ -233,6 +382,45 @@ typedef struct
 } Stm32h7xxRxDmaDesc;
 
 
+/**
+ * @brief Receive path statistics
+ **/
+
+typedef struct
+{
+   uint32_t wakeups;            ///<Number of calls to the event handler
+   uint32_t frames;             ///<Number of frames processed
+   uint32_t maxFramesPerWakeup; ///<Largest batch processed in one wakeup
+   uint32_t budgetExhausted;    ///<Number of times polling mode was entered
+   uint32_t jumboFrames;        ///<Number of frames spanning several descriptors
+} Stm32h7xxEthRxStats;
+
+
+/**
+ * @brief Time-triggered transmission statistics
+ **/
+
+typedef struct
+{
+   uint32_t launched;   ///<Number of launches at the requested time
+   uint32_t late;       ///<Launch time already passed, frame sent at once
+   uint32_t outOfRange; ///<Launch time too far ahead, frame sent at once
+} Stm32h7xxEthLaunchStats;
+
+
+/**
+ * @brief Wake-on-LAN statistics
+ **/
+
+typedef struct
+{
+   bool_t powerDown;       ///<The MAC is waiting for a wakeup frame
+   uint32_t powerDowns;    ///<Number of times the power-down mode was entered
+   uint32_t magicPackets;  ///<Wakeups on a magic packet
+   uint32_t unicastFrames; ///<Wakeups on a unicast frame
+} Stm32h7xxEthWolStats;
+
+
 //STM32H7 Ethernet MAC driver
 extern const NicDriver stm32h7xxEthDriver;
 
@@ -240,6 +428,7 @@ extern const NicDriver stm32h7xxEthDriver;
 error_t stm32h7xxEthInit(NetInterface *interface);
 void stm32h7xxEthInitGpio(NetInterface *interface);
 void stm32h7xxEthInitDmaDesc(NetInterface *interface);
+error_t stm32h7xxEthSetRingSize(uint_t txCount, uint_t rxCount);
 
 void stm32h7xxEthTick(NetInterface *interface);
 
@@ -250,9 +439,46 @@ void stm32h7xxEthEventHandler(NetInterface *interface);
 error_t stm32h7xxEthSendPacket(NetInterface *interface,
    const NetBuffer *buffer, size_t offset, NetTxAncillary *ancillary);
 
+error_t stm32h7xxEthSendPacketZeroCopy(NetInterface *interface,
+   const NetBuffer *buffer, size_t offset, NetTxAncillary *ancillary);
+
+error_t stm32h7xxEthSendJumboPacket(NetInterface *interface,
+   const NetBuffer *buffer, size_t offset, size_t length,
+   NetTxAncillary *ancillary);
+
+error_t stm32h7xxEthLoadVlanTag(NetInterface *interface, uint16_t tci);
+
+void stm32h7xxEthStartTx(NetInterface *interface);
+void stm32h7xxEthFlushTx(NetInterface *interface);
+void stm32h7xxEthReclaimTxBuffers(NetInterface *interface);
+
 error_t stm32h7xxEthReceivePacket(NetInterface *interface);
+error_t stm32h7xxEthReceiveFragment(NetInterface *interface, uint8_t *buffer);
+
+void stm32h7xxEthOffloadRx(NetInterface *interface);
+bool_t stm32h7xxEthOffloadArp(NetInterface *interface, const uint8_t *frame,
+   size_t length);
+bool_t stm32h7xxEthOffloadEcho(NetInterface *interface, const uint8_t *frame,
+   size_t length);
+bool_t stm32h7xxEthOffloadIsHostAddr(NetInterface *interface, Ipv4Addr ipAddr);
+uint8_t *stm32h7xxEthOffloadClaimTxBuffer(NetInterface *interface,
+   uint_t *index);
+void stm32h7xxEthOffloadSend(uint_t index, size_t length);
+
+void stm32h7xxEthUpdateDropStats(NetInterface *interface);
+void stm32h7xxEthUpdateMmcStats(NetInterface *interface);
+void stm32h7xxEthRestartRxDma(NetInterface *interface);
+void stm32h7xxEthGetRxStats(Stm32h7xxEthRxStats *stats);
+uint_t stm32h7xxEthGetRxBacklog(void);
+
+void stm32h7xxEthGetRxChecksumStatus(const Stm32h7xxRxDmaDesc *rxDesc,
+   NetRxAncillary *ancillary);
+
+void stm32h7xxEthReleaseRxBuffer(void *p);
 
 error_t stm32h7xxEthUpdateMacAddrFilter(NetInterface *interface);
+void stm32h7xxEthUpdateVlanFilter(NetInterface *interface);
+void stm32h7xxEthUpdateL3L4Filter(NetInterface *interface);
 error_t stm32h7xxEthUpdateMacConfig(NetInterface *interface);
 
 void stm32h7xxEthWritePhyReg(uint8_t opcode, uint8_t phyAddr,
@@ -263,6 +489,25 @@ uint16_t stm32h7xxEthReadPhyReg(uint8_t opcode, uint8_t phyAddr,
 
 uint32_t stm32h7xxEthCalcCrc(const void *data, size_t length);
 
+void stm32h7xxEthInitPtp(NetInterface *interface);
+void stm32h7xxEthGetPtpTime(NetTimestamp *timestamp);
+void stm32h7xxEthSetPtpTime(const NetTimestamp *timestamp);
+void stm32h7xxEthAdjustPtpTime(int64_t offset);
+void stm32h7xxEthAdjustPtpFreq(int32_t ppb);
+void stm32h7xxEthUpdatePtpClock(int64_t offset);
+
+void stm32h7xxEthGetRxTimestamp(uint_t index, NetRxAncillary *ancillary);
+void stm32h7xxEthCollectTxTimestamps(NetInterface *interface);
+
+void stm32h7xxEthArmLaunch(const NetTimestamp *launchTime);
+void stm32h7xxEthLaunch(void);
+void stm32h7xxEthCheckLaunch(NetInterface *interface);
+void stm32h7xxEthGetLaunchStats(Stm32h7xxEthLaunchStats *stats);
+
+error_t stm32h7xxEthEnterPowerDown(NetInterface *interface, uint_t events);
+void stm32h7xxEthExitPowerDown(NetInterface *interface);
+void stm32h7xxEthGetWolStats(Stm32h7xxEthWolStats *stats);
+
 //C++ guard
 #ifdef __cplusplus
 }
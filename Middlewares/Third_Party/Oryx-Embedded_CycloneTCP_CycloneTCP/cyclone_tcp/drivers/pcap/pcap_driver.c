@@ -0,0 +1,495 @@
+/**
+ * @file pcap_driver.c
+ * @brief PCAP driver
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * The interface is bound to an adapter of the host through libpcap, so that
+ * the stack can be run on a workstation (see os_port_posix.c) against real
+ * traffic. A thread of the host receives the frames and queues them, then the
+ * TCP/IP task processes them as it would the frames of a DMA ring. The adapter
+ * is selected by the PCAP_DRIVER_DEVICE environment variable, or else by the
+ * index of the interface in the list returned by pcap_findalldevs()
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL NIC_TRACE_LEVEL
+
+//Dependencies
+#include <stdlib.h>
+#include <pcap.h>
+#include "core/net.h"
+#include "drivers/pcap/pcap_driver.h"
+#include "debug.h"
+
+
+/**
+ * @brief Packet descriptor
+ **/
+
+typedef struct
+{
+   size_t length;
+   uint8_t data[PCAP_DRIVER_MAX_PACKET_SIZE];
+} PcapDriverPacket;
+
+
+/**
+ * @brief PCAP driver context
+ **/
+
+typedef struct
+{
+   pcap_t *handle;
+   OsMutex mutex;
+   uint_t writeIndex;
+   uint_t readIndex;
+   PcapDriverPacket queue[PCAP_DRIVER_QUEUE_SIZE];
+} PcapDriverContext;
+
+
+/**
+ * @brief PCAP driver
+ **/
+
+const NicDriver pcapDriver =
+{
+   NIC_TYPE_ETHERNET,
+   ETH_MTU,
+   pcapDriverInit,
+   pcapDriverTick,
+   pcapDriverEnableIrq,
+   pcapDriverDisableIrq,
+   pcapDriverEventHandler,
+   pcapDriverSendPacket,
+   pcapDriverUpdateMacAddrFilter,
+   NULL,
+   NULL,
+   NULL,
+   FALSE,
+   TRUE,
+   TRUE,
+   TRUE,
+#if (ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
+   FALSE,
+   FALSE,
+#endif
+   NULL,
+#if (ETH_VLAN_SUPPORT == ENABLED)
+   FALSE
+#endif
+};
+
+
+/**
+ * @brief PCAP driver initialization
+ * @param[in] interface Underlying network interface
+ * @return Error code
+ **/
+
+error_t pcapDriverInit(NetInterface *interface)
+{
+   int_t ret;
+   uint_t i;
+   const char_t *name;
+   pcap_if_t *device;
+   pcap_if_t *deviceList;
+   PcapDriverContext *context;
+   OsTaskId taskId;
+   char_t errorBuffer[PCAP_ERRBUF_SIZE];
+
+   //Debug message
+   TRACE_INFO("Initializing PCAP driver...\r\n");
+
+   //Allocate PCAP driver context
+   context = (PcapDriverContext *) osAllocMem(sizeof(PcapDriverContext));
+
+   //Failed to allocate memory?
+   if(context == NULL)
+   {
+      //Debug message
+      TRACE_ERROR("Failed to allocate context!\r\n");
+      //Report an error
+      return ERROR_FAILURE;
+   }
+
+   //Attach the PCAP driver context to the network interface
+   *((PcapDriverContext **) interface->nicContext) = context;
+   //Clear PCAP driver context
+   osMemset(context, 0, sizeof(PcapDriverContext));
+
+   //The queue is shared with the receive thread
+   if(!osCreateMutex(&context->mutex))
+   {
+      //Clean up side effects
+      osFreeMem(context);
+      //Report an error
+      return ERROR_OUT_OF_RESOURCES;
+   }
+
+   //Find all the devices
+   ret = pcap_findalldevs(&deviceList, errorBuffer);
+
+   //Any error to report?
+   if(ret != 0)
+   {
+      //Debug message
+      TRACE_ERROR("Failed to list devices!\r\n");
+      //Clean up side effects
+      osDeleteMutex(&context->mutex);
+      osFreeMem(context);
+      //Report an error
+      return ERROR_FAILURE;
+   }
+
+   //The adapter may be named by the environment
+   name = getenv("PCAP_DRIVER_DEVICE");
+
+   //Select the adapter
+   for(i = 0, device = deviceList; device != NULL; i++, device = device->next)
+   {
+      //Adapter named by the environment?
+      if(name != NULL)
+      {
+         if(osStrcmp(device->name, name) == 0)
+            break;
+      }
+      else
+      {
+         if(i == interface->index)
+            break;
+      }
+   }
+
+   //No matching adapter?
+   if(device == NULL)
+   {
+      //Debug message
+      TRACE_ERROR("No adapter for interface %s!\r\n", interface->name);
+      //Clean up side effects
+      pcap_freealldevs(deviceList);
+      osDeleteMutex(&context->mutex);
+      osFreeMem(context);
+      //Report an error
+      return ERROR_FAILURE;
+   }
+
+   //Debug message
+   TRACE_INFO("Using device %s...\r\n", device->name);
+
+   //Open the adapter in promiscuous mode, so that the frames sent to the MAC
+   //address of the interface are received
+   context->handle = pcap_open_live(device->name, PCAP_DRIVER_MAX_PACKET_SIZE,
+      TRUE, PCAP_DRIVER_TIMEOUT, errorBuffer);
+
+   //Release the device list
+   pcap_freealldevs(deviceList);
+
+   //Failed to open the adapter?
+   if(context->handle == NULL)
+   {
+      //Debug message
+      TRACE_ERROR("Failed to open device!\r\n");
+      //Clean up side effects
+      osDeleteMutex(&context->mutex);
+      osFreeMem(context);
+      //Report an error
+      return ERROR_FAILURE;
+   }
+
+   //Only the frames received from the network are of interest
+   pcap_setdirection(context->handle, PCAP_D_IN);
+
+   //Create the receive task
+   taskId = osCreateTask("PCAP", (OsTaskCode) pcapDriverTask, interface,
+      &OS_TASK_DEFAULT_PARAMS);
+
+   //Failed to create the task?
+   if(taskId == (OsTaskId) OS_INVALID_TASK_ID)
+   {
+      //Debug message
+      TRACE_ERROR("Failed to create task!\r\n");
+      //Clean up side effects
+      pcap_close(context->handle);
+      osDeleteMutex(&context->mutex);
+      osFreeMem(context);
+      //Report an error
+      return ERROR_FAILURE;
+   }
+
+   //The link of an adapter of the host is considered to be up
+   interface->linkState = TRUE;
+   interface->linkSpeed = NIC_LINK_SPEED_100MBPS;
+   interface->duplexMode = NIC_FULL_DUPLEX_MODE;
+
+   //Process link state change event
+   nicNotifyLinkChange(interface);
+
+   //Accept any packets from the upper layer
+   osSetEvent(&interface->nicTxEvent);
+
+   //Return status code
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief PCAP timer handler
+ *
+ * This routine is periodically called by the TCP/IP stack to handle periodic
+ * operations such as polling the link state
+ *
+ * @param[in] interface Underlying network interface
+ **/
+
+void pcapDriverTick(NetInterface *interface)
+{
+}
+
+
+/**
+ * @brief Enable interrupts
+ * @param[in] interface Underlying network interface
+ **/
+
+void pcapDriverEnableIrq(NetInterface *interface)
+{
+}
+
+
+/**
+ * @brief Disable interrupts
+ * @param[in] interface Underlying network interface
+ **/
+
+void pcapDriverDisableIrq(NetInterface *interface)
+{
+}
+
+
+/**
+ * @brief PCAP event handler
+ * @param[in] interface Underlying network interface
+ **/
+
+void pcapDriverEventHandler(NetInterface *interface)
+{
+   uint_t n;
+   PcapDriverContext *context;
+   NetRxAncillary ancillary;
+
+   //Point to the PCAP driver context
+   context = *((PcapDriverContext **) interface->nicContext);
+
+   //The packets drained below are delivered as a single batch
+   nicBeginRxBatch(interface);
+
+   //Process all the packets queued by the receive task
+   while(1)
+   {
+      //Get exclusive access to the queue
+      osAcquireMutex(&context->mutex);
+      //Number of packets that can be read
+      n = context->writeIndex - context->readIndex;
+      //Release exclusive access to the queue
+      osReleaseMutex(&context->mutex);
+
+      //The queue is empty?
+      if(n == 0)
+         break;
+
+      //Additional options can be passed to the stack along with the packet
+      ancillary = NET_DEFAULT_RX_ANCILLARY;
+
+      //The entry is not reused by the receive task until the read index moves
+      n = context->readIndex % PCAP_DRIVER_QUEUE_SIZE;
+
+      //Pass the packet to the upper layer
+      nicProcessPacket(interface, context->queue[n].data,
+         context->queue[n].length, &ancillary);
+
+      //Release the entry
+      osAcquireMutex(&context->mutex);
+      context->readIndex++;
+      osReleaseMutex(&context->mutex);
+   }
+
+   //Notify the sockets that received data during the batch
+   nicEndRxBatch(interface);
+}
+
+
+/**
+ * @brief Send a packet
+ * @param[in] interface Underlying network interface
+ * @param[in] buffer Multi-part buffer containing the data to send
+ * @param[in] offset Offset to the first data byte
+ * @param[in] ancillary Additional options passed to the stack along with
+ *   the packet
+ * @return Error code
+ **/
+
+error_t pcapDriverSendPacket(NetInterface *interface,
+   const NetBuffer *buffer, size_t offset, NetTxAncillary *ancillary)
+{
+   int_t ret;
+   size_t length;
+   PcapDriverContext *context;
+   uint8_t temp[PCAP_DRIVER_MAX_PACKET_SIZE];
+
+   //Point to the PCAP driver context
+   context = *((PcapDriverContext **) interface->nicContext);
+
+   //Retrieve the length of the packet
+   length = netBufferGetLength(buffer) - offset;
+
+   //Check the frame length
+   if(length > PCAP_DRIVER_MAX_PACKET_SIZE)
+   {
+      //The transmitter can accept another packet
+      osSetEvent(&interface->nicTxEvent);
+      //Report an error
+      return ERROR_INVALID_LENGTH;
+   }
+
+   //Copy the packet to the transmit buffer
+   netBufferRead(temp, buffer, offset, length);
+
+   //Small frames are padded by the host, if at all
+   if(length < ETH_MIN_FRAME_SIZE)
+   {
+      osMemset(temp + length, 0, ETH_MIN_FRAME_SIZE - length);
+      length = ETH_MIN_FRAME_SIZE;
+   }
+
+   //Send the packet
+   ret = pcap_sendpacket(context->handle, temp, length);
+
+   //The transmitter can accept another packet
+   osSetEvent(&interface->nicTxEvent);
+
+   //Return status code
+   if(ret < 0)
+   {
+      return ERROR_FAILURE;
+   }
+   else
+   {
+      return NO_ERROR;
+   }
+}
+
+
+/**
+ * @brief Configure MAC address filtering
+ * @param[in] interface Underlying network interface
+ * @return Error code
+ **/
+
+error_t pcapDriverUpdateMacAddrFilter(NetInterface *interface)
+{
+   //The adapter is opened in promiscuous mode, and the frames are filtered
+   //by the Ethernet layer
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief PCAP receive task
+ * @param[in] interface Underlying network interface
+ **/
+
+void pcapDriverTask(NetInterface *interface)
+{
+   int_t ret;
+   uint_t n;
+   uint_t length;
+   const uint8_t *data;
+   struct pcap_pkthdr *header;
+   PcapDriverContext *context;
+
+   //Point to the PCAP driver context
+   context = *((PcapDriverContext **) interface->nicContext);
+
+   //Process events
+   while(1)
+   {
+      //Wait for an incoming packet
+      ret = pcap_next_ex(context->handle, &header, &data);
+
+      //Any packet received?
+      if(ret > 0)
+      {
+         //Retrieve the length of the packet
+         length = header->caplen;
+
+         //Check the length of the received packet
+         if(length > 0 && length <= PCAP_DRIVER_MAX_PACKET_SIZE)
+         {
+            //Get exclusive access to the queue
+            osAcquireMutex(&context->mutex);
+            //Number of packets in the queue
+            n = context->writeIndex - context->readIndex;
+            //Release exclusive access to the queue
+            osReleaseMutex(&context->mutex);
+
+            //Check whether the receive queue is full
+            if(n < PCAP_DRIVER_QUEUE_SIZE)
+            {
+               //Point to the next free entry
+               n = context->writeIndex % PCAP_DRIVER_QUEUE_SIZE;
+
+               //Copy the incoming packet
+               osMemcpy(context->queue[n].data, data, length);
+               //Save the length of the packet
+               context->queue[n].length = length;
+
+               //Publish the entry
+               osAcquireMutex(&context->mutex);
+               context->writeIndex++;
+               osReleaseMutex(&context->mutex);
+
+               //Set event flag
+               interface->nicEvent = TRUE;
+               //Notify the TCP/IP stack of the event
+               osSetEvent(&netEvent);
+            }
+         }
+      }
+      else if(ret < 0)
+      {
+         //The adapter was closed or removed
+         TRACE_ERROR("PCAP receive failed: %s\r\n",
+            pcap_geterr(context->handle));
+         break;
+      }
+   }
+
+   //Kill ourselves
+   osDeleteTask(OS_SELF_TASK_ID);
+}
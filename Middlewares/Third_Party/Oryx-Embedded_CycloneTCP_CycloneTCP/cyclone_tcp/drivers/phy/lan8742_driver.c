@@ -97,6 +97,11 @@ error_t lan8742Init(NetInterface *interface)
    //Enable auto-negotiation
    lan8742WritePhyReg(interface, LAN8742_BMCR, LAN8742_BMCR_AN_EN);
 
+#if (LAN8742_EDPD_SUPPORT == ENABLED)
+   //Power down the analog front end while no cable energy is detected
+   lan8742SetEdpdMode(interface, TRUE);
+#endif
+
    //Dump PHY registers for debugging purpose
    lan8742DumpPhyReg(interface);
 
@@ -273,6 +278,39 @@ void lan8742EventHandler(NetInterface *interface)
 }
 
 
+/**
+ * @brief Enable or disable energy detect power-down mode
+ *
+ * The PHY powers down its analog front end while no energy is detected on
+ * the line, and wakes up on the first link pulse. An established link is not
+ * affected, since the link partner keeps the line busy
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] enable Enable or disable EDPD mode
+ **/
+
+void lan8742SetEdpdMode(NetInterface *interface, bool_t enable)
+{
+   uint16_t value;
+
+   //Read mode control/status register
+   value = lan8742ReadPhyReg(interface, LAN8742_MCSR);
+
+   //Set or clear the EDPWRDOWN bit
+   if(enable)
+   {
+      value |= LAN8742_MCSR_EDPWRDOWN;
+   }
+   else
+   {
+      value &= ~LAN8742_MCSR_EDPWRDOWN;
+   }
+
+   //Update mode control/status register
+   lan8742WritePhyReg(interface, LAN8742_MCSR, value);
+}
+
+
 /**
  * @brief Write PHY register
  * @param[in] interface Underlying network interface
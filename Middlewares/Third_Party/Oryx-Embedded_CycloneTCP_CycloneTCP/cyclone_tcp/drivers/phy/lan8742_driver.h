@@ -41,6 +41,13 @@
    #error LAN8742_PHY_ADDR parameter is not valid
 #endif
 
+//Energy detect power-down mode
+#ifndef LAN8742_EDPD_SUPPORT
+   #define LAN8742_EDPD_SUPPORT DISABLED
+#elif (LAN8742_EDPD_SUPPORT != ENABLED && LAN8742_EDPD_SUPPORT != DISABLED)
+   #error LAN8742_EDPD_SUPPORT parameter is not valid
+#endif
+
 //LAN8742 PHY registers
 #define LAN8742_BMCR                           0x00
 #define LAN8742_BMSR                           0x01
@@ -267,6 +274,8 @@ void lan8742DisableIrq(NetInterface *interface);
 
 void lan8742EventHandler(NetInterface *interface);
 
+void lan8742SetEdpdMode(NetInterface *interface, bool_t enable);
+
 void lan8742WritePhyReg(NetInterface *interface, uint8_t address,
    uint16_t data);
 
@@ -53,6 +53,24 @@
 #include "str.h"
 #include "debug.h"
 
+//Room kept in front of the data of a streamed chunk, for the CRLF ending the
+//previous chunk and the chunk-size field
+#define HTTP_CLIENT_CHUNK_PREFIX_SIZE 24
+
+//Receive flags used past the first chunk of a read operation
+#define httpClientChunkFlags(received, flags) \
+   (((received) > 0 && ((flags) & HTTP_FLAG_WAIT_ALL) == 0) ? HTTP_FLAG_DONT_WAIT : 0)
+
+//Names of the well-known header fields
+static const char_t *const httpClientKnownFieldNames[HTTP_CLIENT_NUM_KNOWN_FIELDS] =
+{
+   "Content-Length",
+   "Transfer-Encoding",
+   "Connection",
+   "Content-Type",
+   "Content-Encoding"
+};
+
 //Check TCP/IP stack configuration
 #if (HTTP_CLIENT_SUPPORT == ENABLED)
 
@@ -198,6 +216,31 @@ error_t httpClientSetTimeout(HttpClientContext *context, systime_t timeout)
 }
 
 
+/**
+ * @brief Enable TCP Fast Open
+ *
+ * Once a cookie has been obtained from the server, the request (or the TLS
+ * ClientHello) of the next connections is carried by the SYN segment
+ *
+ * @param[in] context Pointer to the HTTP client context
+ * @param[in] enabled Specifies whether Fast Open is attempted
+ * @return Error code
+ **/
+
+error_t httpClientEnableFastOpen(HttpClientContext *context, bool_t enabled)
+{
+   //Make sure the HTTP client context is valid
+   if(context == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Save the setting, applied to the next connections
+   context->fastOpen = enabled;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
 /**
  * @brief Set authentication information
  * @param[in] context Pointer to the HTTP client context
@@ -298,6 +341,12 @@ error_t httpClientConnect(HttpClientContext *context,
 #endif
          }
 
+#if (HTTP_CLIENT_PIPELINING_SUPPORT == ENABLED)
+         //Requests sent on a previous connection will not be answered
+         context->pipelineHead = 0;
+         context->pipelineCount = 0;
+#endif
+
          //Open network connection
          error = httpClientOpenConnection(context);
 
@@ -1286,6 +1335,170 @@ error_t httpClientWriteBody(HttpClientContext *context, const void *data,
 }
 
 
+#if (HTTP_CLIENT_STREAMING_SUPPORT == ENABLED)
+
+/**
+ * @brief Write HTTP request body from a producer callback
+ *
+ * The producer writes the body directly into the buffer of the HTTP client
+ * context. When chunked transfer encoding is used, room is kept in front of
+ * the data for the chunk-size field, so that each chunk leaves in a single
+ * send operation. The function returns once the producer has reported the
+ * end of the body, and the request is then completed with
+ * httpClientCloseBody, as with httpClientWriteBody
+ *
+ * @param[in] context Pointer to the HTTP client context
+ * @param[in] producer Callback function that generates the body
+ * @param[in] param Opaque parameter passed to the callback function
+ * @return Error code
+ **/
+
+error_t httpClientWriteBodyStream(HttpClientContext *context,
+   HttpClientBodyProducer producer, void *param)
+{
+   error_t error;
+   bool_t last;
+   size_t n;
+   size_t size;
+   size_t length;
+   uint8_t *data;
+   char_t prefix[HTTP_CLIENT_CHUNK_PREFIX_SIZE];
+
+   //Check parameters
+   if(context == NULL || producer == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Check HTTP connection state
+   if(context->state != HTTP_CLIENT_STATE_CONNECTED)
+      return ERROR_WRONG_STATE;
+
+   //Initialize status code
+   error = NO_ERROR;
+   //The body is not complete yet
+   last = FALSE;
+
+   //Send as much data as the producer generates
+   while(!last && !error)
+   {
+      //Check HTTP request state
+      if(context->requestState == HTTP_REQ_STATE_SEND_BODY ||
+         (context->requestState == HTTP_REQ_STATE_SEND_CHUNK_DATA &&
+         context->bodyPos == context->bodyLen))
+      {
+         //Chunked transfer encoding?
+         if(context->chunkedEncoding)
+         {
+            //Keep room for the chunk-size field in front of the data
+            data = (uint8_t *) context->buffer + HTTP_CLIENT_CHUNK_PREFIX_SIZE;
+            size = HTTP_CLIENT_BUFFER_SIZE - HTTP_CLIENT_CHUNK_PREFIX_SIZE;
+         }
+         else
+         {
+            //The length of the body shall not exceed the value specified in
+            //the Content-Length field
+            data = (uint8_t *) context->buffer;
+            size = MIN(HTTP_CLIENT_BUFFER_SIZE, context->bodyLen - context->bodyPos);
+
+            //The body is complete once Content-Length bytes have been sent
+            if(size == 0)
+               break;
+         }
+
+         //Retrieve the next part of the body
+         length = 0;
+         error = producer(context, data, size, &length, param);
+
+         //The producer reports the end of the body with its last data
+         if(error == ERROR_END_OF_STREAM)
+         {
+            last = TRUE;
+            error = NO_ERROR;
+         }
+
+         //Any data to send?
+         if(!error && length > 0)
+         {
+            //Check the length reported by the producer
+            if(length > size)
+            {
+               //Report an error
+               error = ERROR_INVALID_LENGTH;
+            }
+            else if(context->chunkedEncoding)
+            {
+               //The data of the previous chunk, if any, is terminated with a
+               //CRLF sequence, then comes the chunk-size field
+               n = osSprintf(prefix, "%s%" PRIXSIZE "\r\n",
+                  (context->requestState == HTTP_REQ_STATE_SEND_CHUNK_DATA) ?
+                  "\r\n" : "", length);
+
+               //Place the chunk-size field right before the data
+               data -= n;
+               length += n;
+               osMemcpy(data, prefix, n);
+
+               //The chunk is sent as a whole
+               context->bodyLen = length - n;
+               context->bodyPos = context->bodyLen;
+               httpClientChangeRequestState(context, HTTP_REQ_STATE_SEND_CHUNK_DATA);
+            }
+            else
+            {
+               //Update the position in the body
+               context->bodyPos += length;
+            }
+
+            //Send the data
+            while(length > 0 && !error)
+            {
+               //Send as much data as possible
+               error = httpClientSendData(context, data, length, &n, 0);
+
+               //Check status code
+               if(error == NO_ERROR || error == ERROR_TIMEOUT)
+               {
+                  //Any data transmitted?
+                  if(n > 0)
+                  {
+                     //Advance data pointer
+                     data += n;
+                     length -= n;
+
+                     //Save current time
+                     context->timestamp = osGetSystemTime();
+                  }
+               }
+
+               //A chunk cannot be left half-sent, since its data only lives
+               //in the buffer
+               if(error == ERROR_WOULD_BLOCK || error == ERROR_TIMEOUT)
+               {
+                  //Check whether the timeout has elapsed
+                  error = httpClientCheckTimeout(context);
+
+                  //Keep on trying until the timeout elapses
+                  if(error == ERROR_WOULD_BLOCK)
+                  {
+                     error = NO_ERROR;
+                  }
+               }
+            }
+         }
+      }
+      else
+      {
+         //Invalid state
+         error = ERROR_WRONG_STATE;
+      }
+   }
+
+   //Return status code
+   return error;
+}
+
+#endif
+
+
 /**
  * @brief Write HTTP trailer
  * @param[in] context Pointer to the HTTP client context
@@ -1374,7 +1587,6 @@ error_t httpClientWriteTrailer(HttpClientContext *context)
 error_t httpClientReadHeader(HttpClientContext *context)
 {
    error_t error;
-   size_t n;
 
    //Make sure the HTTP client context is valid
    if(context == NULL)
@@ -1457,26 +1669,10 @@ error_t httpClientReadHeader(HttpClientContext *context)
                }
             }
          }
-         else if(context->bufferLen < HTTP_CLIENT_BUFFER_SIZE)
-         {
-            //Receive more data
-            error = httpClientReceiveData(context, context->buffer +
-               context->bufferLen, HTTP_CLIENT_BUFFER_SIZE - context->bufferLen,
-               &n, HTTP_FLAG_BREAK_CRLF);
-
-            //Check status code
-            if(!error)
-            {
-               //Adjust the length of the buffer
-               context->bufferLen += n;
-               //Save current time
-               context->timestamp = osGetSystemTime();
-            }
-         }
          else
          {
-            //The client implementation limits the size of headers it accepts
-            error = ERROR_BUFFER_OVERFLOW;
+            //Receive more data
+            error = httpClientReceiveHeaderLine(context);
          }
       }
       else if(context->requestState == HTTP_REQ_STATE_PARSE_HEADER)
@@ -1556,6 +1752,40 @@ const char_t *httpClientGetHeaderField(HttpClientContext *context,
       if(context->requestState == HTTP_REQ_STATE_PARSE_HEADER ||
          context->requestState == HTTP_REQ_STATE_PARSE_TRAILER)
       {
+         //All the fields are indexed?
+         if(context->headerIndex.complete)
+         {
+            //Well-known fields are located directly
+            for(i = 0; i < HTTP_CLIENT_NUM_KNOWN_FIELDS; i++)
+            {
+               //Check the name of the field
+               if(osStrcasecmp(name, httpClientKnownFieldNames[i]) == 0)
+               {
+                  //Retrieve the value of the header field
+                  return httpClientGetKnownHeaderField(context,
+                     (HttpClientFieldId) i);
+               }
+            }
+
+            //Walk through the index
+            for(i = 0; i < context->headerIndex.fieldCount; i++)
+            {
+               //Check whether the current header field matches the name
+               if(osStrcasecmp(context->buffer +
+                  context->headerIndex.field[i], name) == 0)
+               {
+                  //Retrieve the value of the header field
+                  value = context->buffer + context->headerIndex.field[i] +
+                     osStrlen(context->buffer + context->headerIndex.field[i]) + 1;
+                  //Exit immediately
+                  break;
+               }
+            }
+
+            //Return the value of the header field
+            return value;
+         }
+
          //Point to the first header field of the response
          i = 0;
 
@@ -1587,6 +1817,58 @@ const char_t *httpClientGetHeaderField(HttpClientContext *context,
 }
 
 
+/**
+ * @brief Retrieve the value of a well-known header field
+ * @param[in] context Pointer to the HTTP client context
+ * @param[in] id Identifier of the header field
+ * @return Value of the header field, or NULL if the field is not present
+ **/
+
+const char_t *httpClientGetKnownHeaderField(HttpClientContext *context,
+   HttpClientFieldId id)
+{
+   const char_t *value;
+
+   //Initialize field value
+   value = NULL;
+
+   //Check parameters
+   if(context != NULL && id < HTTP_CLIENT_NUM_KNOWN_FIELDS)
+   {
+      //Check HTTP request state
+      if(context->requestState == HTTP_REQ_STATE_PARSE_HEADER ||
+         context->requestState == HTTP_REQ_STATE_PARSE_TRAILER)
+      {
+         //The index holds the offset of the value, plus one
+         if(context->headerIndex.known[id] != 0)
+         {
+            value = context->buffer + context->headerIndex.known[id] - 1;
+         }
+      }
+   }
+
+   //Return the value of the header field
+   return value;
+}
+
+
+/**
+ * @brief Get the number of header fields dropped for lack of room
+ * @param[in] context Pointer to the HTTP client context
+ * @return Number of header fields that could not be kept in the buffer
+ **/
+
+uint_t httpClientGetDiscardedHeaderFields(HttpClientContext *context)
+{
+   //Make sure the HTTP client context is valid
+   if(context == NULL)
+      return 0;
+
+   //Return the number of dropped header fields
+   return context->headerIndex.discarded;
+}
+
+
 /**
  * @brief Iterate through the HTTP response header
  * @param[in] context Pointer to the HTTP client context
@@ -1772,7 +2054,7 @@ error_t httpClientReadBody(HttpClientContext *context, void *data,
             //Receive more data
             error = httpClientReceiveData(context, context->buffer +
                context->bufferLen, HTTP_CLIENT_BUFFER_SIZE - context->bufferLen,
-               &n, HTTP_FLAG_BREAK_CRLF);
+               &n, HTTP_FLAG_BREAK_CRLF | httpClientChunkFlags(*received, flags));
 
             //Check status code
             if(!error)
@@ -1782,6 +2064,17 @@ error_t httpClientReadBody(HttpClientContext *context, void *data,
                //Save current time
                context->timestamp = osGetSystemTime();
             }
+            else if(*received > 0 && (error == ERROR_WOULD_BLOCK ||
+               error == ERROR_TIMEOUT))
+            {
+               //Return the data of the previous chunks without waiting
+               error = NO_ERROR;
+               break;
+            }
+            else
+            {
+               //Just for sanity
+            }
          }
          else
          {
@@ -1798,7 +2091,8 @@ error_t httpClientReadBody(HttpClientContext *context, void *data,
             n = MIN(size - *received, context->bodyLen - context->bodyPos);
 
             //Read chunk data
-            error = httpClientReceiveData(context, p, n, &n, flags);
+            error = httpClientReceiveData(context, p, n, &n,
+               flags | httpClientChunkFlags(*received, flags));
 
             //Check status code
             if(!error)
@@ -1823,8 +2117,14 @@ error_t httpClientReadBody(HttpClientContext *context, void *data,
                else if((flags & HTTP_FLAG_WAIT_ALL) == 0)
                {
                   //The HTTP_FLAG_WAIT_ALL flag causes the function to return
-                  //only when the requested number of bytes have been read
-                  break;
+                  //only when the requested number of bytes have been read.
+                  //Chunks already received are still decoded in the same
+                  //call, so that small chunks fill the output buffer
+                  if(context->bodyPos < context->bodyLen ||
+                     (char_t *) data == context->buffer)
+                  {
+                     break;
+                  }
                }
                else
                {
@@ -1834,6 +2134,17 @@ error_t httpClientReadBody(HttpClientContext *context, void *data,
                //Advance data pointer
                p += n;
             }
+            else if(*received > 0 && (error == ERROR_WOULD_BLOCK ||
+               error == ERROR_TIMEOUT))
+            {
+               //Return the data of the previous chunks without waiting
+               error = NO_ERROR;
+               break;
+            }
+            else
+            {
+               //Just for sanity
+            }
          }
          else
          {
@@ -1877,6 +2188,143 @@ error_t httpClientReadBody(HttpClientContext *context, void *data,
 }
 
 
+#if (HTTP_CLIENT_STREAMING_SUPPORT == ENABLED)
+
+/**
+ * @brief Read HTTP response body through a consumer callback
+ *
+ * Body data is handed over to the consumer straight from the receive buffer
+ * of the TCP connection, without being copied. Chunk-size fields and
+ * TLS-secured connections go through httpClientReadBody
+ *
+ * @param[in] context Pointer to the HTTP client context
+ * @param[in] consumer Callback function that processes the body
+ * @param[in] param Opaque parameter passed to the callback function
+ * @return ERROR_END_OF_STREAM once the whole body has been consumed, or
+ *   another error code
+ **/
+
+error_t httpClientReadBodyStream(HttpClientContext *context,
+   HttpClientBodyConsumer consumer, void *param)
+{
+   error_t error;
+   bool_t inPlace;
+   size_t n;
+   const uint8_t *data;
+
+   //Check parameters
+   if(context == NULL || consumer == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Check HTTP connection state
+   if(context->state != HTTP_CLIENT_STATE_CONNECTED)
+      return ERROR_WRONG_STATE;
+
+   //Initialize status code
+   error = NO_ERROR;
+
+   //Read the whole body
+   while(!error)
+   {
+      //Body data can be accessed in place when the connection is not
+      //TLS-secured and the receive position is within the body
+      inPlace = (context->requestState == HTTP_REQ_STATE_RECEIVE_BODY &&
+         !context->chunkedEncoding) ||
+         context->requestState == HTTP_REQ_STATE_RECEIVE_CHUNK_DATA;
+
+      inPlace = inPlace && context->bodyPos < context->bodyLen;
+
+#if (HTTP_CLIENT_TLS_SUPPORT == ENABLED)
+      //TLS-secured connection?
+      if(context->tlsContext != NULL)
+      {
+         //The data must be decrypted first
+         inPlace = FALSE;
+      }
+#endif
+
+      //Zero-copy path?
+      if(inPlace)
+      {
+         //Locate the data pending in the receive buffer of the socket
+         error = socketReceiveInPlace(context->socket, &data, &n, 0);
+
+         //Check status code
+         if(!error)
+         {
+            //Do not hand over data that belongs to the next part of the
+            //response
+            n = MIN(n, context->bodyLen - context->bodyPos);
+
+            //Process the data
+            error = consumer(context, data, n, param);
+
+            //The data is consumed, whatever the outcome of the callback
+            socketReleaseInPlace(context->socket, n);
+            context->bodyPos += n;
+
+            //Save current time
+            context->timestamp = osGetSystemTime();
+         }
+         else if(error != ERROR_WOULD_BLOCK && error != ERROR_TIMEOUT)
+         {
+            //End of stream and connection errors are handled by
+            //httpClientReadBody
+            error = httpClientReadBody(context, context->buffer, 1, &n, 0);
+
+            //Any data received?
+            if(!error && n > 0)
+            {
+               //Process the data
+               error = consumer(context, (uint8_t *) context->buffer, n, param);
+            }
+         }
+         else
+         {
+            //Just for sanity
+         }
+      }
+      else
+      {
+         //Parse the chunk-size field or go through the TLS layer. Only one
+         //byte is read without TLS, so that body data is then read in place
+#if (HTTP_CLIENT_TLS_SUPPORT == ENABLED)
+         if(context->tlsContext != NULL)
+         {
+            n = HTTP_CLIENT_BUFFER_SIZE;
+         }
+         else
+#endif
+         {
+            n = 1;
+         }
+
+         //Read body data
+         error = httpClientReadBody(context, context->buffer, n, &n, 0);
+
+         //Any data received?
+         if(!error && n > 0)
+         {
+            //Process the data
+            error = consumer(context, (uint8_t *) context->buffer, n, param);
+         }
+      }
+   }
+
+   //Check status code
+   if(error == ERROR_WOULD_BLOCK || error == ERROR_TIMEOUT)
+   {
+      //Check whether the timeout has elapsed
+      error = httpClientCheckTimeout(context);
+   }
+
+   //Return status code
+   return error;
+}
+
+#endif
+
+
 /**
  * @brief Read HTTP trailer
  * @param[in] context Pointer to the HTTP client context
@@ -1886,7 +2334,6 @@ error_t httpClientReadBody(HttpClientContext *context, void *data,
 error_t httpClientReadTrailer(HttpClientContext *context)
 {
    error_t error;
-   size_t n;
 
    //Make sure the HTTP client context is valid
    if(context == NULL)
@@ -1927,26 +2374,10 @@ error_t httpClientReadTrailer(HttpClientContext *context)
                      context->bufferPos, context->bufferLen - context->bufferPos);
                }
             }
-            else if(context->bufferLen < HTTP_CLIENT_BUFFER_SIZE)
-            {
-               //Receive more data
-               error = httpClientReceiveData(context, context->buffer +
-                  context->bufferLen, HTTP_CLIENT_BUFFER_SIZE - context->bufferLen,
-                  &n, HTTP_FLAG_BREAK_CRLF);
-
-               //Check status code
-               if(!error)
-               {
-                  //Adjust the length of the buffer
-                  context->bufferLen += n;
-                  //Save current time
-                  context->timestamp = osGetSystemTime();
-               }
-            }
             else
             {
-               //The client implementation limits the size of headers it accepts
-               error = ERROR_BUFFER_OVERFLOW;
+               //Receive more data
+               error = httpClientReceiveHeaderLine(context);
             }
          }
          else if(context->requestState == HTTP_REQ_STATE_PARSE_TRAILER ||
@@ -2142,6 +2573,140 @@ error_t httpClientCloseBody(HttpClientContext *context)
 }
 
 
+#if (HTTP_CLIENT_PIPELINING_SUPPORT == ENABLED)
+
+/**
+ * @brief Queue the current request and allow a new one to be created
+ *
+ * Once its header and body have been written, a request can be pipelined
+ * instead of waiting for its response. Further requests are then written on
+ * the same connection, and the responses are retrieved in the order the
+ * requests were sent, each one after a call to httpClientNextResponse
+ *
+ * @param[in] context Pointer to the HTTP client context
+ * @return Error code
+ **/
+
+error_t httpClientPipelineRequest(HttpClientContext *context)
+{
+   uint_t i;
+
+   //Make sure the HTTP client context is valid
+   if(context == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Check HTTP connection state
+   if(context->state != HTTP_CLIENT_STATE_CONNECTED)
+      return ERROR_WRONG_STATE;
+
+   //The request must have been sent completely
+   if(context->requestState != HTTP_REQ_STATE_RECEIVE_STATUS_LINE)
+      return ERROR_WRONG_STATE;
+
+   //Pipelining requires a persistent connection
+   if(!context->keepAlive)
+      return ERROR_WRONG_STATE;
+
+   //Make sure the pipeline is not full
+   if(context->pipelineCount >= HTTP_CLIENT_MAX_PIPELINED_REQUESTS)
+      return ERROR_BUFFER_OVERFLOW;
+
+   //The method of the request tells whether the response has a body
+   i = (context->pipelineHead + context->pipelineCount) %
+      HTTP_CLIENT_MAX_PIPELINED_REQUESTS;
+
+   osStrcpy(context->pipeline[i], context->method);
+   context->pipelineCount++;
+
+   //A new request can be created
+   httpClientChangeRequestState(context, HTTP_REQ_STATE_INIT);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Prepare for receiving the response to the oldest pipelined request
+ *
+ * The response is then read with httpClientReadHeader, httpClientReadBody and
+ * httpClientCloseBody. The previous response must have been read completely
+ *
+ * @param[in] context Pointer to the HTTP client context
+ * @return Error code
+ **/
+
+error_t httpClientNextResponse(HttpClientContext *context)
+{
+   //Make sure the HTTP client context is valid
+   if(context == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //No request awaiting a response?
+   if(context->pipelineCount == 0)
+      return ERROR_END_OF_STREAM;
+
+   //The server may have closed the connection after the previous response
+   if(context->state != HTTP_CLIENT_STATE_CONNECTED || !context->keepAlive)
+   {
+      //The pending requests will never be answered
+      context->pipelineHead = 0;
+      context->pipelineCount = 0;
+
+      //Report an error
+      return ERROR_NOT_CONNECTED;
+   }
+
+   //The previous response must be complete
+   if(context->requestState != HTTP_REQ_STATE_INIT &&
+      context->requestState != HTTP_REQ_STATE_PARSE_TRAILER &&
+      context->requestState != HTTP_REQ_STATE_COMPLETE)
+   {
+      return ERROR_WRONG_STATE;
+   }
+
+   //Restore the method of the request
+   osStrcpy(context->method, context->pipeline[context->pipelineHead]);
+
+   //Remove the request from the pipeline
+   context->pipelineHead = (context->pipelineHead + 1) %
+      HTTP_CLIENT_MAX_PIPELINED_REQUESTS;
+   context->pipelineCount--;
+
+   //Reset status code
+   context->statusCode = 0;
+
+   //Flush receive buffer
+   context->bufferLen = 0;
+   context->bufferPos = 0;
+
+   //Receive the HTTP response header
+   httpClientChangeRequestState(context, HTTP_REQ_STATE_RECEIVE_STATUS_LINE);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Get the number of pipelined requests awaiting a response
+ * @param[in] context Pointer to the HTTP client context
+ * @return Number of pending responses
+ **/
+
+uint_t httpClientGetPendingResponses(HttpClientContext *context)
+{
+   //Make sure the HTTP client context is valid
+   if(context == NULL)
+      return 0;
+
+   //Return the number of pending responses
+   return context->pipelineCount;
+}
+
+#endif
+
+
 /**
  * @brief Gracefully disconnect from the HTTP server
  * @param[in] context Pointer to the HTTP client context
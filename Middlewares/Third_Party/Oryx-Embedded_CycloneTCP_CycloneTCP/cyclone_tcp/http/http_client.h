@@ -98,6 +98,18 @@
    #error HTTP_CLIENT_BUFFER_SIZE parameter is not valid
 #endif
 
+//Maximum number of indexed header fields
+#ifndef HTTP_CLIENT_MAX_HEADER_FIELDS
+   #define HTTP_CLIENT_MAX_HEADER_FIELDS 24
+#elif (HTTP_CLIENT_MAX_HEADER_FIELDS < 1)
+   #error HTTP_CLIENT_MAX_HEADER_FIELDS parameter is not valid
+#endif
+
+//Header fields are indexed by 16-bit offsets into the buffer
+#if (HTTP_CLIENT_BUFFER_SIZE > 65534)
+   #error HTTP_CLIENT_BUFFER_SIZE parameter is not valid
+#endif
+
 //TX buffer size for TLS connections
 #ifndef HTTP_CLIENT_TLS_TX_BUFFER_SIZE
    #define HTTP_CLIENT_TLS_TX_BUFFER_SIZE 2048
@@ -112,6 +124,18 @@
    #error HTTP_CLIENT_TLS_RX_BUFFER_SIZE parameter is not valid
 #endif
 
+//Maximum fragment length requested from the server (0 to leave the
+//max_fragment_length extension out)
+#ifndef HTTP_CLIENT_TLS_MAX_FRAG_LEN
+   #define HTTP_CLIENT_TLS_MAX_FRAG_LEN 0
+#elif (HTTP_CLIENT_TLS_MAX_FRAG_LEN != 0 && HTTP_CLIENT_TLS_MAX_FRAG_LEN != 512 && \
+   HTTP_CLIENT_TLS_MAX_FRAG_LEN != 1024 && HTTP_CLIENT_TLS_MAX_FRAG_LEN != 2048 && \
+   HTTP_CLIENT_TLS_MAX_FRAG_LEN != 4096)
+   #error HTTP_CLIENT_TLS_MAX_FRAG_LEN parameter is not valid
+#elif (HTTP_CLIENT_TLS_MAX_FRAG_LEN > HTTP_CLIENT_TLS_RX_BUFFER_SIZE)
+   #error HTTP_CLIENT_TLS_MAX_FRAG_LEN exceeds HTTP_CLIENT_TLS_RX_BUFFER_SIZE
+#endif
+
 //Maximum length of HTTP method
 #ifndef HTTP_CLIENT_MAX_METHOD_LEN
    #define HTTP_CLIENT_MAX_METHOD_LEN 8
@@ -119,6 +143,27 @@
    #error HTTP_CLIENT_MAX_METHOD_LEN parameter is not valid
 #endif
 
+//HTTP request pipelining
+#ifndef HTTP_CLIENT_PIPELINING_SUPPORT
+   #define HTTP_CLIENT_PIPELINING_SUPPORT DISABLED
+#elif (HTTP_CLIENT_PIPELINING_SUPPORT != ENABLED && HTTP_CLIENT_PIPELINING_SUPPORT != DISABLED)
+   #error HTTP_CLIENT_PIPELINING_SUPPORT parameter is not valid
+#endif
+
+//Maximum number of requests awaiting a response
+#ifndef HTTP_CLIENT_MAX_PIPELINED_REQUESTS
+   #define HTTP_CLIENT_MAX_PIPELINED_REQUESTS 4
+#elif (HTTP_CLIENT_MAX_PIPELINED_REQUESTS < 1)
+   #error HTTP_CLIENT_MAX_PIPELINED_REQUESTS parameter is not valid
+#endif
+
+//Streaming body API
+#ifndef HTTP_CLIENT_STREAMING_SUPPORT
+   #define HTTP_CLIENT_STREAMING_SUPPORT DISABLED
+#elif (HTTP_CLIENT_STREAMING_SUPPORT != ENABLED && HTTP_CLIENT_STREAMING_SUPPORT != DISABLED)
+   #error HTTP_CLIENT_STREAMING_SUPPORT parameter is not valid
+#endif
+
 //Maximum length of the user name
 #ifndef HTTP_CLIENT_MAX_USERNAME_LEN
    #define HTTP_CLIENT_MAX_USERNAME_LEN 32
@@ -229,6 +274,41 @@ typedef error_t (*HttpClientTlsInitCallback)(HttpClientContext *context,
 #endif
 
 
+/**
+ * @brief Well-known header fields
+ **/
+
+typedef enum
+{
+   HTTP_CLIENT_FIELD_CONTENT_LENGTH    = 0,
+   HTTP_CLIENT_FIELD_TRANSFER_ENCODING = 1,
+   HTTP_CLIENT_FIELD_CONNECTION        = 2,
+   HTTP_CLIENT_FIELD_CONTENT_TYPE      = 3,
+   HTTP_CLIENT_FIELD_CONTENT_ENCODING  = 4,
+   HTTP_CLIENT_NUM_KNOWN_FIELDS        = 5
+} HttpClientFieldId;
+
+
+/**
+ * @brief Index of the header fields held in the buffer
+ *
+ * The index is built while the header is received. Well-known fields are
+ * located directly by their identifier
+ *
+ **/
+
+typedef struct
+{
+   uint16_t field[HTTP_CLIENT_MAX_HEADER_FIELDS]; ///<Offset of each field name
+   uint_t fieldCount;                             ///<Number of indexed fields
+   bool_t complete;                               ///<All the fields in the buffer are indexed
+   uint16_t known[HTTP_CLIENT_NUM_KNOWN_FIELDS];  ///<Offset of the value of each well-known field, plus one
+   uint_t discarded;                              ///<Fields dropped for lack of room in the buffer
+   bool_t skipLine;                               ///<The rest of the current line is dropped
+   bool_t skipFolded;                             ///<Continuation lines of the dropped field are dropped
+} HttpClientHeaderIndex;
+
+
 /**
  * @brief Random data generation callback function
  **/
@@ -236,6 +316,31 @@ typedef error_t (*HttpClientTlsInitCallback)(HttpClientContext *context,
 typedef error_t (*HttpClientRandCallback)(uint8_t *data, size_t length);
 
 
+//Streaming body API supported?
+#if (HTTP_CLIENT_STREAMING_SUPPORT == ENABLED)
+
+/**
+ * @brief Request body producer callback function
+ *
+ * The callback writes up to size bytes of body data at the location pointed
+ * to by data, and returns ERROR_END_OF_STREAM once the body is complete
+ *
+ **/
+
+typedef error_t (*HttpClientBodyProducer)(HttpClientContext *context,
+   uint8_t *data, size_t size, size_t *length, void *param);
+
+
+/**
+ * @brief Response body consumer callback function
+ **/
+
+typedef error_t (*HttpClientBodyConsumer)(HttpClientContext *context,
+   const uint8_t *data, size_t length, void *param);
+
+#endif
+
+
 /**
  * @brief HTTP authentication parameters
  **/
@@ -268,6 +373,7 @@ struct _HttpClientContext
    HttpVersion version;                           ///<HTTP protocol version
    NetInterface *interface;                       ///<Underlying network interface
    systime_t timeout;                             ///<Timeout value
+   bool_t fastOpen;                               ///<TCP Fast Open
    systime_t timestamp;                           ///<Timestamp to manage timeout
    Socket *socket;                                ///<Underlying socket
 #if (HTTP_CLIENT_TLS_SUPPORT == ENABLED)
@@ -290,9 +396,15 @@ struct _HttpClientContext
    char_t buffer[HTTP_CLIENT_BUFFER_SIZE + 1];    ///<Memory buffer for input/output operations
    size_t bufferLen;                              ///<Length of the buffer, in bytes
    size_t bufferPos;                              ///<Current position in the buffer
+   HttpClientHeaderIndex headerIndex;             ///<Index of the header fields
    size_t bodyLen;                                ///<Length of the body, in bytes
    size_t bodyPos;                                ///<Current position in the body
    uint_t statusCode;                             ///<HTTP status code
+#if (HTTP_CLIENT_PIPELINING_SUPPORT == ENABLED)
+   char_t pipeline[HTTP_CLIENT_MAX_PIPELINED_REQUESTS][HTTP_CLIENT_MAX_METHOD_LEN + 1]; ///<Methods of the requests awaiting a response
+   uint_t pipelineHead;                           ///<Oldest request awaiting a response
+   uint_t pipelineCount;                          ///<Number of requests awaiting a response
+#endif
    HTTP_CLIENT_PRIVATE_CONTEXT                    ///<Application specific context
 };
 
@@ -312,6 +424,7 @@ error_t httpClientRegisterRandCallback(HttpClientContext *context,
 
 error_t httpClientSetVersion(HttpClientContext *context, HttpVersion version);
 error_t httpClientSetTimeout(HttpClientContext *context, systime_t timeout);
+error_t httpClientEnableFastOpen(HttpClientContext *context, bool_t enabled);
 
 error_t httpClientSetAuthInfo(HttpClientContext *context,
    const char_t *username, const char_t *password);
@@ -349,21 +462,42 @@ error_t httpClientWriteBody(HttpClientContext *context, const void *data,
 
 error_t httpClientWriteTrailer(HttpClientContext *context);
 
+#if (HTTP_CLIENT_STREAMING_SUPPORT == ENABLED)
+error_t httpClientWriteBodyStream(HttpClientContext *context,
+   HttpClientBodyProducer producer, void *param);
+#endif
+
 error_t httpClientReadHeader(HttpClientContext *context);
 uint_t httpClientGetStatus(HttpClientContext *context);
 
 const char_t *httpClientGetHeaderField(HttpClientContext *context,
    const char_t *name);
 
+const char_t *httpClientGetKnownHeaderField(HttpClientContext *context,
+   HttpClientFieldId id);
+
+uint_t httpClientGetDiscardedHeaderFields(HttpClientContext *context);
+
 error_t httpClientGetNextHeaderField(HttpClientContext *context,
    const char_t **name, const char_t **value);
 
 error_t httpClientReadBody(HttpClientContext *context, void *data,
    size_t size, size_t *received, uint_t flags);
 
+#if (HTTP_CLIENT_STREAMING_SUPPORT == ENABLED)
+error_t httpClientReadBodyStream(HttpClientContext *context,
+   HttpClientBodyConsumer consumer, void *param);
+#endif
+
 error_t httpClientReadTrailer(HttpClientContext *context);
 error_t httpClientCloseBody(HttpClientContext *context);
 
+#if (HTTP_CLIENT_PIPELINING_SUPPORT == ENABLED)
+error_t httpClientPipelineRequest(HttpClientContext *context);
+error_t httpClientNextResponse(HttpClientContext *context);
+uint_t httpClientGetPendingResponses(HttpClientContext *context);
+#endif
+
 error_t httpClientDisconnect(HttpClientContext *context);
 error_t httpClientClose(HttpClientContext *context);
 
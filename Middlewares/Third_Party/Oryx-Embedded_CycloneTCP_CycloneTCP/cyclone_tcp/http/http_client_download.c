@@ -0,0 +1,658 @@
+/**
+ * @file http_client_download.c
+ * @brief Resumable HTTP download with range requests
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ * @section Description
+ *
+ * Large files, such as firmware images, are fetched as a sequence of range
+ * requests of HTTP_CLIENT_DOWNLOAD_BLOCK_SIZE bytes each. A block is handed
+ * over to the sink only once it has been received in full and verified, so
+ * that a dropped connection costs at most one block: the next attempt asks
+ * for the data that follows the last good block. The entity tag of the file
+ * is sent in an If-Range header field, so that a file replaced on the server
+ * in the middle of a download is fetched again from the start rather than
+ * spliced. Two block buffers let the sink program one block (typically an
+ * erase followed by a flash write) while the next one is being received.
+ * Refer to RFC 7233 for complete details
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL HTTP_TRACE_LEVEL
+
+//Dependencies
+#include <stdlib.h>
+#include "core/net.h"
+#include "http/http_client.h"
+#include "http/http_client_pool.h"
+#include "http/http_client_download.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (HTTP_CLIENT_SUPPORT == ENABLED && HTTP_CLIENT_POOL_SUPPORT == ENABLED && \
+   HTTP_CLIENT_DOWNLOAD_SUPPORT == ENABLED)
+
+
+/**
+ * @brief Parse the value of a Content-Range header field
+ * @param[in] value Value of the header field
+ * @param[out] first Offset of the first byte of the range
+ * @param[out] last Offset of the last byte of the range
+ * @param[out] totalLength Length of the file (0 if not specified)
+ * @return Error code
+ **/
+
+static error_t httpDownloadParseContentRange(const char_t *value,
+   uint32_t *first, uint32_t *last, uint32_t *totalLength)
+{
+   char_t *p;
+
+   //The only range unit defined is bytes
+   if(osStrncasecmp(value, "bytes ", 6))
+      return ERROR_INVALID_SYNTAX;
+
+   //Point to the byte range
+   value += 6;
+
+   //Unsatisfied range (416 response)?
+   if(*value == '*')
+   {
+      *first = 0;
+      *last = 0;
+      value++;
+   }
+   else
+   {
+      //Parse the offset of the first byte
+      *first = osStrtoul(value, &p, 10);
+      //Syntax error?
+      if(p == value || *p != '-')
+         return ERROR_INVALID_SYNTAX;
+
+      //Parse the offset of the last byte
+      value = p + 1;
+      *last = osStrtoul(value, &p, 10);
+      //Syntax error?
+      if(p == value || *last < *first)
+         return ERROR_INVALID_SYNTAX;
+
+      value = p;
+   }
+
+   //The range is followed by the complete length
+   if(*value != '/')
+      return ERROR_INVALID_SYNTAX;
+
+   //Point to the complete length
+   value++;
+
+   //The complete length may be unknown
+   if(*value == '*')
+   {
+      *totalLength = 0;
+   }
+   else
+   {
+      //Parse the complete length
+      *totalLength = osStrtoul(value, &p, 10);
+      //Syntax error?
+      if(p == value)
+         return ERROR_INVALID_SYNTAX;
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Restart the download from the beginning of the file
+ * @param[in] context Pointer to the download context
+ **/
+
+static void httpDownloadRestart(HttpDownloadContext *context)
+{
+   //Debug message
+   TRACE_INFO("HTTP download: file changed on the server, restarting...\r\n");
+
+   //Forget the previous version of the file
+   context->etag[0] = '\0';
+   context->totalLength = 0;
+   context->offset = 0;
+
+   //Update statistics
+   context->stats.restarts++;
+}
+
+
+/**
+ * @brief Fetch the next block of the file
+ * @param[in] context Pointer to the download context
+ * @param[out] length Length of the block
+ * @return Error code
+ **/
+
+static error_t httpDownloadFetchBlock(HttpDownloadContext *context,
+   size_t *length)
+{
+   error_t error;
+   uint_t status;
+   size_t n;
+   size_t received;
+   uint32_t first;
+   uint32_t last;
+   uint32_t totalLength;
+   const char_t *value;
+   HttpClientContext *httpClientContext;
+
+   //Number of bytes to request
+   n = HTTP_CLIENT_DOWNLOAD_BLOCK_SIZE;
+
+   //Do not ask for data past the end of the file
+   if(context->totalLength != 0)
+   {
+      n = MIN(n, context->totalLength - context->offset);
+   }
+
+   //Reuse an idle connection to the server, or resolve its name and connect
+   error = httpClientPoolAcquire(context->pool, context->host, context->port,
+      &httpClientContext);
+   //Any error to report?
+   if(error)
+      return error;
+
+   //Start of exception handling block
+   do
+   {
+      //Create an HTTP request
+      httpClientCreateRequest(httpClientContext);
+      httpClientSetMethod(httpClientContext, "GET");
+      httpClientSetUri(httpClientContext, context->uri);
+
+      //Set the hostname and port number of the resource being requested
+      httpClientSetHost(httpClientContext, context->host, context->port);
+
+      //Ask for the next block only
+      httpClientFormatHeaderField(httpClientContext, "Range", "bytes=%" PRIu32
+         "-%" PRIu32, context->offset, context->offset + (uint32_t) n - 1);
+
+      //The range is only meaningful for the version of the file whose first
+      //blocks have already been received (refer to RFC 7233, section 3.2)
+      if(context->etag[0] != '\0')
+      {
+         httpClientAddHeaderField(httpClientContext, "If-Range", context->etag);
+      }
+
+      //Send HTTP request header
+      error = httpClientWriteHeader(httpClientContext);
+      //Any error to report?
+      if(error)
+         break;
+
+      //Receive HTTP response header
+      error = httpClientReadHeader(httpClientContext);
+      //Any error to report?
+      if(error)
+         break;
+
+      //Retrieve HTTP status code
+      status = httpClientGetStatus(httpClientContext);
+
+      //Check status code
+      if(status == 206)
+      {
+         //Retrieve the range carried by the response
+         value = httpClientGetHeaderField(httpClientContext, "Content-Range");
+         //Missing header field?
+         if(value == NULL)
+         {
+            error = ERROR_INVALID_SYNTAX;
+            break;
+         }
+
+         //Parse the value of the header field
+         error = httpDownloadParseContentRange(value, &first, &last,
+            &totalLength);
+         //Any error to report?
+         if(error)
+            break;
+
+         //The server must send the requested range, or a shorter one that
+         //ends with the file
+         if(first != context->offset || (last - first + 1) > n ||
+            ((last - first + 1) < n && (last + 1) != totalLength))
+         {
+            error = ERROR_INCONSISTENT_VALUE;
+            break;
+         }
+
+         //The length of the file must not change during the download
+         if(context->totalLength != 0 && totalLength != context->totalLength)
+         {
+            error = ERROR_INCONSISTENT_VALUE;
+            break;
+         }
+
+         //Save the entity tag of the file on the first block. A weak entity
+         //tag must not be used in an If-Range header field
+         if(context->etag[0] == '\0')
+         {
+            value = httpClientGetHeaderField(httpClientContext, "ETag");
+
+            if(value != NULL && osStrncmp(value, "W/", 2) &&
+               osStrlen(value) <= HTTP_CLIENT_DOWNLOAD_MAX_ETAG_LEN)
+            {
+               osStrcpy(context->etag, value);
+            }
+         }
+
+         //Save the length of the file
+         context->totalLength = totalLength;
+         //Length of the block
+         n = last - first + 1;
+
+         //Receive the block
+         error = httpClientReadBody(httpClientContext,
+            context->buffer[context->current], n, &received,
+            HTTP_FLAG_WAIT_ALL);
+         //Any error to report?
+         if(error)
+            break;
+
+         //The connection may have been closed before the end of the block
+         if(received != n)
+         {
+            error = ERROR_INVALID_LENGTH;
+            break;
+         }
+
+         //Close HTTP response body
+         error = httpClientCloseBody(httpClientContext);
+         //Any error to report?
+         if(error)
+            break;
+
+         //Return the length of the block
+         *length = n;
+      }
+      else if(status == 200)
+      {
+         //The If-Range condition failed, so the server sends the complete
+         //representation of a file that has changed
+         if(context->etag[0] != '\0' && context->offset != 0)
+         {
+            //Download the new version of the file from its start
+            httpDownloadRestart(context);
+            error = ERROR_WRONG_IDENTIFIER;
+         }
+         else
+         {
+            //The server does not support range requests
+            error = ERROR_UNSUPPORTED_FEATURE;
+         }
+      }
+      else if(status == 416)
+      {
+         //Retrieve the length of the file
+         value = httpClientGetHeaderField(httpClientContext, "Content-Range");
+
+         //A range that starts at the end of the file cannot be satisfied,
+         //which happens when resuming a download that was already complete
+         if(value != NULL && !httpDownloadParseContentRange(value, &first,
+            &last, &totalLength) && totalLength == context->offset &&
+            totalLength != 0)
+         {
+            context->totalLength = totalLength;
+            error = ERROR_END_OF_STREAM;
+         }
+         else
+         {
+            error = ERROR_UNEXPECTED_STATUS;
+         }
+      }
+      else if(HTTP_STATUS_CODE_5YZ(status) || status == 408 || status == 429)
+      {
+         //Transient failure on the server side
+         error = ERROR_UNEXPECTED_RESPONSE;
+      }
+      else
+      {
+         //The request cannot succeed
+         error = ERROR_UNEXPECTED_STATUS;
+      }
+
+      //End of exception handling block
+   } while(0);
+
+   //Keep the connection open for the next block unless an error occurred
+   httpClientPoolRelease(context->pool, httpClientContext, error == NO_ERROR);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Initialize download context
+ * @param[in] context Pointer to the download context
+ * @param[in] pool Pool providing the connections to the server
+ * @return Error code
+ **/
+
+error_t httpDownloadInit(HttpDownloadContext *context, HttpClientPool *pool)
+{
+   //Check parameters
+   if(context == NULL || pool == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Clear download context
+   osMemset(context, 0, sizeof(HttpDownloadContext));
+
+   //Attach the connection pool
+   context->pool = pool;
+
+   //Successful initialization
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Set the location of the file to download
+ * @param[in] context Pointer to the download context
+ * @param[in] host Host name of the server
+ * @param[in] port TCP port number of the server
+ * @param[in] uri NULL-terminated string containing the URI of the file
+ * @return Error code
+ **/
+
+error_t httpDownloadSetUrl(HttpDownloadContext *context, const char_t *host,
+   uint16_t port, const char_t *uri)
+{
+   //Check parameters
+   if(context == NULL || host == NULL || uri == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Make sure the strings are not too long
+   if(osStrlen(host) > HTTP_CLIENT_POOL_MAX_HOST_LEN ||
+      osStrlen(uri) > HTTP_CLIENT_DOWNLOAD_MAX_URI_LEN)
+   {
+      return ERROR_INVALID_LENGTH;
+   }
+
+   //Save the location of the file
+   osStrcpy(context->host, host);
+   context->port = port;
+   osStrcpy(context->uri, uri);
+
+   //A different file is being downloaded
+   context->etag[0] = '\0';
+   context->totalLength = 0;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Register the sink callbacks
+ * @param[in] context Pointer to the download context
+ * @param[in] writeCallback Block write callback
+ * @param[in] waitCallback Wait callback
+ * @param[in] verifyCallback Block verification callback (optional)
+ * @param[in] param Opaque parameter passed to the callbacks
+ * @return Error code
+ **/
+
+error_t httpDownloadRegisterCallbacks(HttpDownloadContext *context,
+   HttpDownloadWriteCallback writeCallback,
+   HttpDownloadWaitCallback waitCallback,
+   HttpDownloadVerifyCallback verifyCallback, void *param)
+{
+   //Check parameters
+   if(context == NULL || writeCallback == NULL || waitCallback == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Save callback functions
+   context->writeCallback = writeCallback;
+   context->waitCallback = waitCallback;
+   context->verifyCallback = verifyCallback;
+   context->param = param;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Download the file
+ *
+ * The function returns once the whole file has been stored by the sink, or
+ * when the download cannot make progress. In the latter case, the offset
+ * returned by httpDownloadGetProgress can be passed to a later call to resume
+ * the download, even after a reset if the sink keeps what it has stored
+ *
+ * @param[in] context Pointer to the download context
+ * @param[in] offset Offset from which to download the file
+ * @return Error code
+ **/
+
+error_t httpDownloadRun(HttpDownloadContext *context, uint32_t offset)
+{
+   error_t error;
+   error_t status;
+   uint_t retries;
+   size_t length;
+   systime_t delay;
+
+   //Check parameters
+   if(context == NULL || context->writeCallback == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Start from the specified offset
+   context->offset = offset;
+   context->storedOffset = offset;
+   context->writePending = FALSE;
+
+   //Initialize retransmission parameters
+   retries = 0;
+   delay = HTTP_CLIENT_DOWNLOAD_RETRY_DELAY;
+
+   //Download the file block by block
+   while(1)
+   {
+      //The whole file has been received?
+      if(context->totalLength != 0 && context->offset >= context->totalLength)
+      {
+         error = NO_ERROR;
+         break;
+      }
+
+      //Fetch the next block
+      error = httpDownloadFetchBlock(context, &length);
+
+      //Check the integrity of the block
+      if(!error && context->verifyCallback != NULL)
+      {
+         error = context->verifyCallback(context, context->offset,
+            context->buffer[context->current], length, context->param);
+
+         //The block has been corrupted?
+         if(error)
+         {
+            //Update statistics
+            context->stats.verifyErrors++;
+         }
+      }
+
+      //Check status code
+      if(!error)
+      {
+         //The sink must be done with the previous block
+         if(context->writePending)
+         {
+            //Wait for the previous write operation to complete
+            context->writePending = FALSE;
+            error = context->waitCallback(context, context->param);
+            //Flash programming failure?
+            if(error)
+               break;
+
+            //The previous block is safely stored
+            context->storedOffset = context->offset;
+         }
+
+         //Hand the block over to the sink. Meanwhile, the next block is
+         //received in the other buffer
+         error = context->writeCallback(context, context->offset,
+            context->buffer[context->current], length, context->param);
+         //Flash programming failure?
+         if(error)
+            break;
+
+         //Switch to the other buffer
+         context->writePending = TRUE;
+         context->offset += length;
+         context->current ^= 1;
+
+         //Update statistics
+         context->stats.blocks++;
+
+         //The link is working again
+         retries = 0;
+         delay = HTTP_CLIENT_DOWNLOAD_RETRY_DELAY;
+      }
+      else if(error == ERROR_END_OF_STREAM)
+      {
+         //The file was already complete
+         error = NO_ERROR;
+         break;
+      }
+      else if(error == ERROR_WRONG_IDENTIFIER)
+      {
+         //The file changed on the server; fetch its first block at once
+      }
+      else if(error == ERROR_UNSUPPORTED_FEATURE ||
+         error == ERROR_UNEXPECTED_STATUS)
+      {
+         //The download cannot succeed
+         break;
+      }
+      else
+      {
+         //Too many consecutive failures?
+         if(retries >= HTTP_CLIENT_DOWNLOAD_MAX_RETRIES)
+            break;
+
+         //Debug message
+         TRACE_INFO("HTTP download: block at offset %" PRIu32 " failed (%d), "
+            "retrying in %" PRIu32 " ms...\r\n", context->offset, error, delay);
+
+         //Update statistics
+         context->stats.retries++;
+
+         //Back off, the link is likely to be down for a while
+         osDelayTask(delay);
+
+         //Double the delay after each failed attempt
+         retries++;
+         delay = MIN(delay * 2, HTTP_CLIENT_DOWNLOAD_MAX_RETRY_DELAY);
+      }
+   }
+
+   //Wait for the last write operation to complete
+   if(context->writePending)
+   {
+      context->writePending = FALSE;
+      status = context->waitCallback(context, context->param);
+
+      //Check status code
+      if(!status)
+      {
+         //The last block is safely stored
+         context->storedOffset = context->offset;
+      }
+      else if(!error)
+      {
+         //Report the flash programming failure
+         error = status;
+      }
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Get the progress of the download
+ * @param[in] context Pointer to the download context
+ * @param[out] offset Length of the data stored by the sink
+ * @param[out] totalLength Length of the file (0 if not known yet)
+ **/
+
+void httpDownloadGetProgress(HttpDownloadContext *context, uint32_t *offset,
+   uint32_t *totalLength)
+{
+   //Make sure the download context is valid
+   if(context != NULL)
+   {
+      //Only the data acknowledged by the wait callback is reported
+      if(offset != NULL)
+      {
+         *offset = context->storedOffset;
+      }
+
+      //Length of the file
+      if(totalLength != NULL)
+      {
+         *totalLength = context->totalLength;
+      }
+   }
+}
+
+
+/**
+ * @brief Retrieve download statistics
+ * @param[in] context Pointer to the download context
+ * @param[out] stats Statistics
+ * @return Error code
+ **/
+
+error_t httpDownloadGetStats(HttpDownloadContext *context,
+   HttpDownloadStats *stats)
+{
+   //Check parameters
+   if(context == NULL || stats == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Copy statistics
+   *stats = context->stats;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+#endif
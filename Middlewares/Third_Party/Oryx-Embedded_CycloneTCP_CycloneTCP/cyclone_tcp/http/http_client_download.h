@@ -0,0 +1,194 @@
+/**
+ * @file http_client_download.h
+ * @brief Resumable HTTP download with range requests
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+#ifndef _HTTP_CLIENT_DOWNLOAD_H
+#define _HTTP_CLIENT_DOWNLOAD_H
+
+//Dependencies
+#include "core/net.h"
+#include "http/http_client.h"
+#include "http/http_client_pool.h"
+
+//Resumable download support
+#ifndef HTTP_CLIENT_DOWNLOAD_SUPPORT
+   #define HTTP_CLIENT_DOWNLOAD_SUPPORT DISABLED
+#elif (HTTP_CLIENT_DOWNLOAD_SUPPORT != ENABLED && HTTP_CLIENT_DOWNLOAD_SUPPORT != DISABLED)
+   #error HTTP_CLIENT_DOWNLOAD_SUPPORT parameter is not valid
+#endif
+
+//Size of the blocks requested from the server
+#ifndef HTTP_CLIENT_DOWNLOAD_BLOCK_SIZE
+   #define HTTP_CLIENT_DOWNLOAD_BLOCK_SIZE 4096
+#elif (HTTP_CLIENT_DOWNLOAD_BLOCK_SIZE < 256)
+   #error HTTP_CLIENT_DOWNLOAD_BLOCK_SIZE parameter is not valid
+#endif
+
+//Maximum length of the URI
+#ifndef HTTP_CLIENT_DOWNLOAD_MAX_URI_LEN
+   #define HTTP_CLIENT_DOWNLOAD_MAX_URI_LEN 128
+#elif (HTTP_CLIENT_DOWNLOAD_MAX_URI_LEN < 1)
+   #error HTTP_CLIENT_DOWNLOAD_MAX_URI_LEN parameter is not valid
+#endif
+
+//Maximum length of the entity tag
+#ifndef HTTP_CLIENT_DOWNLOAD_MAX_ETAG_LEN
+   #define HTTP_CLIENT_DOWNLOAD_MAX_ETAG_LEN 64
+#elif (HTTP_CLIENT_DOWNLOAD_MAX_ETAG_LEN < 1)
+   #error HTTP_CLIENT_DOWNLOAD_MAX_ETAG_LEN parameter is not valid
+#endif
+
+//Number of consecutive failed attempts before the download is abandoned
+#ifndef HTTP_CLIENT_DOWNLOAD_MAX_RETRIES
+   #define HTTP_CLIENT_DOWNLOAD_MAX_RETRIES 10
+#elif (HTTP_CLIENT_DOWNLOAD_MAX_RETRIES < 0)
+   #error HTTP_CLIENT_DOWNLOAD_MAX_RETRIES parameter is not valid
+#endif
+
+//Delay before the first retry, doubled after each failed attempt
+#ifndef HTTP_CLIENT_DOWNLOAD_RETRY_DELAY
+   #define HTTP_CLIENT_DOWNLOAD_RETRY_DELAY 1000
+#elif (HTTP_CLIENT_DOWNLOAD_RETRY_DELAY < 0)
+   #error HTTP_CLIENT_DOWNLOAD_RETRY_DELAY parameter is not valid
+#endif
+
+//Maximum delay between two attempts
+#ifndef HTTP_CLIENT_DOWNLOAD_MAX_RETRY_DELAY
+   #define HTTP_CLIENT_DOWNLOAD_MAX_RETRY_DELAY 30000
+#elif (HTTP_CLIENT_DOWNLOAD_MAX_RETRY_DELAY < HTTP_CLIENT_DOWNLOAD_RETRY_DELAY)
+   #error HTTP_CLIENT_DOWNLOAD_MAX_RETRY_DELAY parameter is not valid
+#endif
+
+//Forward declaration of HttpDownloadContext structure
+struct _HttpDownloadContext;
+#define HttpDownloadContext struct _HttpDownloadContext
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Block write callback
+ *
+ * The sink may program the block asynchronously and return at once. The
+ * buffer stays untouched until the next call to the wait callback returns.
+ * Blocks come in increasing order, except that the offset goes back to zero
+ * when the file is replaced on the server during the download
+ *
+ **/
+
+typedef error_t (*HttpDownloadWriteCallback)(HttpDownloadContext *context,
+   uint32_t offset, const uint8_t *data, size_t length, void *param);
+
+
+/**
+ * @brief Wait callback
+ *
+ * Returns once the block passed to the last write callback has been stored,
+ * together with the outcome of the write operation
+ *
+ **/
+
+typedef error_t (*HttpDownloadWaitCallback)(HttpDownloadContext *context,
+   void *param);
+
+
+/**
+ * @brief Block verification callback
+ **/
+
+typedef error_t (*HttpDownloadVerifyCallback)(HttpDownloadContext *context,
+   uint32_t offset, const uint8_t *data, size_t length, void *param);
+
+
+/**
+ * @brief Download statistics
+ **/
+
+typedef struct
+{
+   uint32_t blocks;        ///<Blocks downloaded and handed over to the sink
+   uint32_t retries;       ///<Failed attempts that were retried
+   uint32_t restarts;      ///<Downloads restarted because the file changed
+   uint32_t verifyErrors;  ///<Blocks rejected by the verification callback
+} HttpDownloadStats;
+
+
+/**
+ * @brief Download context
+ **/
+
+struct _HttpDownloadContext
+{
+   HttpClientPool *pool;                                  ///<Pool providing the connections
+   char_t host[HTTP_CLIENT_POOL_MAX_HOST_LEN + 1];        ///<Host name of the server
+   uint16_t port;                                         ///<TCP port number of the server
+   char_t uri[HTTP_CLIENT_DOWNLOAD_MAX_URI_LEN + 1];      ///<URI of the file
+   char_t etag[HTTP_CLIENT_DOWNLOAD_MAX_ETAG_LEN + 1];    ///<Entity tag of the file
+   HttpDownloadWriteCallback writeCallback;               ///<Block write callback
+   HttpDownloadWaitCallback waitCallback;                 ///<Wait callback
+   HttpDownloadVerifyCallback verifyCallback;             ///<Block verification callback
+   void *param;                                           ///<Opaque parameter passed to the callbacks
+   uint32_t offset;                                       ///<Length of the data handed over to the sink
+   uint32_t storedOffset;                                 ///<Length of the data stored by the sink
+   uint32_t totalLength;                                  ///<Length of the file (0 if not known yet)
+   bool_t writePending;                                   ///<A block is being written by the sink
+   uint_t current;                                        ///<Buffer receiving the next block
+   uint8_t buffer[2][HTTP_CLIENT_DOWNLOAD_BLOCK_SIZE];    ///<Block buffers
+   HttpDownloadStats stats;                               ///<Statistics
+};
+
+
+//Resumable download related functions
+error_t httpDownloadInit(HttpDownloadContext *context, HttpClientPool *pool);
+
+error_t httpDownloadSetUrl(HttpDownloadContext *context, const char_t *host,
+   uint16_t port, const char_t *uri);
+
+error_t httpDownloadRegisterCallbacks(HttpDownloadContext *context,
+   HttpDownloadWriteCallback writeCallback,
+   HttpDownloadWaitCallback waitCallback,
+   HttpDownloadVerifyCallback verifyCallback, void *param);
+
+error_t httpDownloadRun(HttpDownloadContext *context, uint32_t offset);
+
+void httpDownloadGetProgress(HttpDownloadContext *context, uint32_t *offset,
+   uint32_t *totalLength);
+
+error_t httpDownloadGetStats(HttpDownloadContext *context,
+   HttpDownloadStats *stats);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,1294 @@
+/**
+ * @file http_client_inflate.c
+ * @brief HTTP content decoding (gzip and deflate)
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * Responses sent with Content-Encoding gzip or deflate are decompressed as
+ * they are read, one Huffman symbol at a time, so that the decoder never
+ * waits inside a block for data that has not arrived yet. The sliding window
+ * is bounded by HTTP_CLIENT_INFLATE_WINDOW_SIZE; a stream that refers further
+ * back is rejected. Refer to RFC 1950, 1951 and 1952 for complete details
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL HTTP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "http/http_client.h"
+#include "http/http_client_inflate.h"
+#include "str.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (HTTP_CLIENT_SUPPORT == ENABLED && HTTP_CLIENT_INFLATE_SUPPORT == ENABLED)
+
+//gzip header flags
+#define HTTP_GZIP_FLAG_FHCRC    0x02
+#define HTTP_GZIP_FLAG_FEXTRA   0x04
+#define HTTP_GZIP_FLAG_FNAME    0x08
+#define HTTP_GZIP_FLAG_FCOMMENT 0x10
+#define HTTP_GZIP_FLAG_RESERVED 0xE0
+
+//Largest prime smaller than 65536
+#define HTTP_ADLER32_MOD 65521
+
+//Order of the code length codes
+static const uint8_t httpInflateCodeLengthOrder[19] =
+{
+   16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+//Base lengths of the length codes 257 to 285
+static const uint16_t httpInflateLengthBase[29] =
+{
+   3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+   35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+//Extra bits of the length codes 257 to 285
+static const uint8_t httpInflateLengthExtra[29] =
+{
+   0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+   3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+//Base distances of the distance codes 0 to 29
+static const uint16_t httpInflateDistBase[30] =
+{
+   1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+   257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289,
+   16385, 24577
+};
+
+//Extra bits of the distance codes 0 to 29
+static const uint8_t httpInflateDistExtra[30] =
+{
+   0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+   7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+//CRC-32 lookup table, one entry per nibble
+static const uint32_t httpInflateCrc32Table[16] =
+{
+   0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+   0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+   0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+   0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+//Local functions
+static error_t httpInflateFill(HttpClientInflateContext *context);
+static uint_t httpInflateNeededBits(HttpClientInflateContext *context);
+static uint_t httpInflateGetBits(HttpClientInflateContext *context, uint_t n);
+static void httpInflateAlign(HttpClientInflateContext *context);
+
+static error_t httpInflateBuildTree(HttpInflateTree *tree,
+   const uint8_t *lengths, uint_t count);
+
+static int_t httpInflateDecodeSymbol(HttpClientInflateContext *context,
+   const HttpInflateTree *tree);
+
+static error_t httpInflateParseHeader(HttpClientInflateContext *context);
+static error_t httpInflateParseBlockHeader(HttpClientInflateContext *context);
+static error_t httpInflateParseLengths(HttpClientInflateContext *context);
+
+static error_t httpInflateParseSymbol(HttpClientInflateContext *context,
+   uint8_t *data);
+
+static error_t httpInflateCheckTrailer(HttpClientInflateContext *context);
+
+static void httpInflateOutputByte(HttpClientInflateContext *context,
+   uint8_t *data, uint8_t value);
+
+static void httpInflateUpdateChecksum(HttpClientInflateContext *context,
+   const uint8_t *data, size_t length);
+
+
+/**
+ * @brief Initialize content decoding for the current response
+ *
+ * The function must be called once the response header has been read, and
+ * the body is then read with httpClientInflateRead instead of
+ * httpClientReadBody
+ *
+ * @param[in] context Pointer to the content decoding context
+ * @param[in] httpContext Pointer to the HTTP client context
+ * @return Error code
+ **/
+
+error_t httpClientInflateInit(HttpClientInflateContext *context,
+   HttpClientContext *httpContext)
+{
+   size_t n;
+   const char_t *value;
+
+   //Check parameters
+   if(context == NULL || httpContext == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //The response header must have been read
+   if(httpContext->requestState != HTTP_REQ_STATE_PARSE_HEADER)
+      return ERROR_WRONG_STATE;
+
+   //Clear the decoder state, the sliding window excepted
+   osMemset(context, 0, offsetof(HttpClientInflateContext, window));
+
+   //Attach the HTTP client context
+   context->httpContext = httpContext;
+   //The decoder starts with the gzip or zlib header
+   context->state = HTTP_INFLATE_STATE_HEADER;
+
+   //Retrieve the value of the Content-Encoding header field
+   value = httpClientGetKnownHeaderField(httpContext,
+      HTTP_CLIENT_FIELD_CONTENT_ENCODING);
+
+   //Length of the content coding token
+   n = (value != NULL) ? osStrlen(value) : 0;
+
+   //Check the content coding
+   if(n == 0 || (n == 8 && osStrncasecmp(value, "identity", n) == 0))
+   {
+      //The body is not encoded
+      context->coding = HTTP_CONTENT_CODING_IDENTITY;
+   }
+   else if((n == 4 && osStrncasecmp(value, "gzip", n) == 0) ||
+      (n == 6 && osStrncasecmp(value, "x-gzip", n) == 0))
+   {
+      //gzip file format (refer to RFC 1952)
+      context->coding = HTTP_CONTENT_CODING_GZIP;
+      //The CRC-32 of the output is checked against the gzip trailer
+      context->checksum = 0;
+   }
+   else if(n == 7 && osStrncasecmp(value, "deflate", n) == 0)
+   {
+      //zlib format (refer to RFC 1950), or raw deflate data as sent by some
+      //servers
+      context->coding = HTTP_CONTENT_CODING_DEFLATE;
+      //The Adler-32 of the output is checked against the zlib trailer
+      context->checksum = 1;
+   }
+   else
+   {
+      //Debug message
+      TRACE_WARNING("Unsupported content coding: %s\r\n", value);
+      //Report an error
+      return ERROR_UNSUPPORTED_ALGO;
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Read and decode the response body
+ * @param[in] context Pointer to the content decoding context
+ * @param[out] data Buffer where to store the decoded data
+ * @param[in] size Maximum number of bytes that can be decoded
+ * @param[out] received Number of bytes that have been decoded
+ * @return Error code
+ **/
+
+error_t httpClientInflateRead(HttpClientInflateContext *context, void *data,
+   size_t size, size_t *received)
+{
+   error_t error;
+   size_t n;
+   size_t start;
+   uint8_t *p;
+
+   //Check parameters
+   if(context == NULL || data == NULL || received == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //No data has been decoded yet
+   *received = 0;
+
+   //The body is not encoded?
+   if(context->coding == HTTP_CONTENT_CODING_IDENTITY)
+   {
+      //Read the body as it is
+      return httpClientReadBody(context->httpContext, data, size, received, 0);
+   }
+
+   //Point to the output buffer
+   p = (uint8_t *) data;
+   //Beginning of the data whose checksum is still to be computed
+   start = 0;
+
+   //Initialize status code
+   error = NO_ERROR;
+
+   //Decode as much data as possible
+   while(*received < size && !error)
+   {
+      //The whole stream has been decoded?
+      if(context->state == HTTP_INFLATE_STATE_COMPLETE)
+      {
+         //The end of the body is reported once pending data is returned
+         if(*received == 0)
+         {
+            error = ERROR_END_OF_STREAM;
+         }
+
+         break;
+      }
+
+      //Make sure the next step can complete without waiting for data
+      if((context->inputLen - context->inputPos) * 8 + context->bitCount <
+         httpInflateNeededBits(context) && !context->inputEnd)
+      {
+         //Return the data decoded so far rather than wait
+         if(*received > 0)
+            break;
+
+         //Receive more compressed data
+         error = httpInflateFill(context);
+         continue;
+      }
+
+      //Check decoder state
+      switch(context->state)
+      {
+      //gzip or zlib header?
+      case HTTP_INFLATE_STATE_HEADER:
+         //An empty body carries no header
+         if(context->inputEnd && context->inputPos == context->inputLen)
+         {
+            context->state = HTTP_INFLATE_STATE_COMPLETE;
+         }
+         else
+         {
+            //Parse the header
+            error = httpInflateParseHeader(context);
+         }
+         break;
+
+      //Block header?
+      case HTTP_INFLATE_STATE_BLOCK_HEADER:
+         //Parse BFINAL and BTYPE fields
+         error = httpInflateParseBlockHeader(context);
+         break;
+
+      //Header of a stored block?
+      case HTTP_INFLATE_STATE_STORED_HEADER:
+         //The LEN and NLEN fields start on a byte boundary
+         httpInflateAlign(context);
+
+         //Get the number of data bytes in the block
+         context->copyLen = httpInflateGetBits(context, 16);
+
+         //NLEN is the one's complement of LEN
+         if((httpInflateGetBits(context, 16) ^ 0xFFFF) != context->copyLen)
+         {
+            error = ERROR_DECODING_FAILED;
+         }
+         else if(context->copyLen > 0)
+         {
+            //Copy the data of the block
+            context->state = HTTP_INFLATE_STATE_STORED_DATA;
+         }
+         else
+         {
+            //Empty block
+            context->state = context->finalBlock ?
+               HTTP_INFLATE_STATE_TRAILER : HTTP_INFLATE_STATE_BLOCK_HEADER;
+         }
+         break;
+
+      //Data of a stored block?
+      case HTTP_INFLATE_STATE_STORED_DATA:
+         //Bytes already loaded in the bit buffer come first
+         while(context->bitCount >= 8 && context->copyLen > 0 &&
+            *received < size)
+         {
+            httpInflateOutputByte(context, p + (*received)++,
+               (uint8_t) httpInflateGetBits(context, 8));
+
+            context->copyLen--;
+         }
+
+         //Then copy as much data as possible from the input buffer
+         n = MIN(context->copyLen, size - *received);
+         n = MIN(n, context->inputLen - context->inputPos);
+
+         //Copy the data
+         while(n-- > 0)
+         {
+            httpInflateOutputByte(context, p + (*received)++,
+               context->input[context->inputPos++]);
+
+            context->copyLen--;
+         }
+
+         //End of the block?
+         if(context->copyLen == 0)
+         {
+            context->state = context->finalBlock ?
+               HTTP_INFLATE_STATE_TRAILER : HTTP_INFLATE_STATE_BLOCK_HEADER;
+         }
+         else if(context->inputEnd && context->inputPos == context->inputLen &&
+            context->bitCount == 0)
+         {
+            //The stream is truncated
+            error = ERROR_DECODING_FAILED;
+         }
+         break;
+
+      //Header of a block with dynamic Huffman codes?
+      case HTTP_INFLATE_STATE_TABLE_HEADER:
+         //Get the number of codes of each type
+         context->hlit = httpInflateGetBits(context, 5) + 257;
+         context->hdist = httpInflateGetBits(context, 5) + 1;
+         context->hclen = httpInflateGetBits(context, 4) + 4;
+
+         //Check the numbers of codes
+         if(context->hlit > 286 || context->hdist > 30)
+         {
+            error = ERROR_DECODING_FAILED;
+         }
+         else
+         {
+            //Read the code lengths for the code length alphabet
+            osMemset(context->codeLengths, 0, sizeof(context->codeLengths));
+            context->index = 0;
+            context->state = HTTP_INFLATE_STATE_CODE_LENGTHS;
+         }
+         break;
+
+      //Code lengths for the code length alphabet?
+      case HTTP_INFLATE_STATE_CODE_LENGTHS:
+         //Each length is coded on 3 bits
+         context->codeLengths[httpInflateCodeLengthOrder[context->index++]] =
+            (uint8_t) httpInflateGetBits(context, 3);
+
+         //All the code lengths have been read?
+         if(context->index == context->hclen)
+         {
+            //The distance tree holds the code length code while the lengths
+            //of the other codes are decoded
+            error = httpInflateBuildTree(&context->distTree,
+               context->codeLengths, 19);
+
+            //Decode the code lengths of the literal/length and distance codes
+            context->index = 0;
+            context->state = HTTP_INFLATE_STATE_LENGTHS;
+         }
+         break;
+
+      //Code lengths for the literal/length and distance alphabets?
+      case HTTP_INFLATE_STATE_LENGTHS:
+         //Decode the next code length
+         error = httpInflateParseLengths(context);
+         break;
+
+      //Compressed data?
+      case HTTP_INFLATE_STATE_DATA:
+         //Decode the next literal or match
+         error = httpInflateParseSymbol(context, p + *received);
+
+         //Literal byte?
+         if(error == ERROR_BUFFER_OVERFLOW)
+         {
+            (*received)++;
+            error = NO_ERROR;
+         }
+         break;
+
+      //Match being copied?
+      case HTTP_INFLATE_STATE_COPY:
+         //Copy as much data as possible from the window
+         while(context->copyLen > 0 && *received < size)
+         {
+            httpInflateOutputByte(context, p + (*received)++,
+               context->window[(context->windowPos - context->copyDist) &
+               (HTTP_CLIENT_INFLATE_WINDOW_SIZE - 1)]);
+
+            context->copyLen--;
+         }
+
+         //End of the match?
+         if(context->copyLen == 0)
+         {
+            context->state = HTTP_INFLATE_STATE_DATA;
+         }
+         break;
+
+      //gzip or zlib trailer?
+      case HTTP_INFLATE_STATE_TRAILER:
+         //The checksum must cover the whole output
+         httpInflateUpdateChecksum(context, p + start, *received - start);
+         start = *received;
+
+         //Check the trailer
+         error = httpInflateCheckTrailer(context);
+         break;
+
+      //Invalid state?
+      default:
+         //Report an error
+         error = ERROR_WRONG_STATE;
+         break;
+      }
+
+      //Not enough data to complete the step?
+      if(!error && context->overrun)
+      {
+         //Debug message
+         TRACE_WARNING("Truncated compressed data\r\n");
+         //The stream is truncated
+         error = ERROR_DECODING_FAILED;
+      }
+   }
+
+   //Update the checksum of the output
+   httpInflateUpdateChecksum(context, p + start, *received - start);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Get the content coding of the response
+ * @param[in] context Pointer to the content decoding context
+ * @return Content coding
+ **/
+
+HttpContentCoding httpClientInflateGetCoding(HttpClientInflateContext *context)
+{
+   //Make sure the content decoding context is valid
+   if(context == NULL)
+      return HTTP_CONTENT_CODING_IDENTITY;
+
+   //Return the content coding
+   return context->coding;
+}
+
+
+/**
+ * @brief Receive more compressed data
+ * @param[in] context Pointer to the content decoding context
+ * @return Error code
+ **/
+
+static error_t httpInflateFill(HttpClientInflateContext *context)
+{
+   error_t error;
+   size_t n;
+
+   //Discard the data already consumed
+   n = context->inputLen - context->inputPos;
+   osMemmove(context->input, context->input + context->inputPos, n);
+
+   context->inputLen = n;
+   context->inputPos = 0;
+
+   //Read the response body
+   error = httpClientReadBody(context->httpContext, context->input + n,
+      HTTP_CLIENT_INFLATE_INPUT_SIZE - n, &n, 0);
+
+   //Check status code
+   if(!error)
+   {
+      //Adjust the length of the input buffer
+      context->inputLen += n;
+   }
+   else if(error == ERROR_END_OF_STREAM)
+   {
+      //The remaining steps must complete with the data on hand
+      context->inputEnd = TRUE;
+      error = NO_ERROR;
+   }
+   else
+   {
+      //Just for sanity
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Number of bits the next step may consume, at most
+ * @param[in] context Pointer to the content decoding context
+ * @return Number of bits
+ **/
+
+static uint_t httpInflateNeededBits(HttpClientInflateContext *context)
+{
+   uint_t n;
+
+   //Check decoder state
+   switch(context->state)
+   {
+   case HTTP_INFLATE_STATE_HEADER:
+      //Fixed part of the gzip header, zlib header, or one byte of the
+      //optional parts of the gzip header
+      if(context->coding == HTTP_CONTENT_CODING_GZIP)
+      {
+         n = (context->headerStep == 0) ? 80 : 16;
+      }
+      else
+      {
+         n = 16;
+      }
+      break;
+   case HTTP_INFLATE_STATE_BLOCK_HEADER:
+      //BFINAL and BTYPE fields
+      n = 3;
+      break;
+   case HTTP_INFLATE_STATE_STORED_HEADER:
+      //Padding, LEN and NLEN fields
+      n = 39;
+      break;
+   case HTTP_INFLATE_STATE_STORED_DATA:
+      //At least one byte
+      n = 8;
+      break;
+   case HTTP_INFLATE_STATE_TABLE_HEADER:
+      //HLIT, HDIST and HCLEN fields
+      n = 14;
+      break;
+   case HTTP_INFLATE_STATE_CODE_LENGTHS:
+      //One code length
+      n = 3;
+      break;
+   case HTTP_INFLATE_STATE_LENGTHS:
+      //Code and repeat count
+      n = 14;
+      break;
+   case HTTP_INFLATE_STATE_DATA:
+      //Length code, extra bits, distance code and extra bits
+      n = 48;
+      break;
+   case HTTP_INFLATE_STATE_TRAILER:
+      //Padding, then CRC-32 and ISIZE or Adler-32
+      n = context->zlib ? 39 : 71;
+      break;
+   default:
+      //No data is needed
+      n = 0;
+      break;
+   }
+
+   //Return the number of bits
+   return n;
+}
+
+
+/**
+ * @brief Extract bits from the compressed data
+ * @param[in] context Pointer to the content decoding context
+ * @param[in] n Number of bits to extract (at most 16)
+ * @return Value of the bits, least significant bit first
+ **/
+
+static uint_t httpInflateGetBits(HttpClientInflateContext *context, uint_t n)
+{
+   uint_t value;
+
+   //Load enough bytes into the bit buffer
+   while(context->bitCount < n)
+   {
+      //Any data left?
+      if(context->inputPos >= context->inputLen)
+      {
+         //The stream is truncated
+         context->overrun = TRUE;
+         return 0;
+      }
+
+      //Append the next byte
+      context->bitBuffer |= (uint32_t) context->input[context->inputPos++] <<
+         context->bitCount;
+
+      context->bitCount += 8;
+   }
+
+   //Extract the bits
+   value = context->bitBuffer & ((1U << n) - 1);
+
+   //Discard them from the bit buffer
+   context->bitBuffer >>= n;
+   context->bitCount -= n;
+
+   //Return the value of the bits
+   return value;
+}
+
+
+/**
+ * @brief Skip to the next byte boundary
+ * @param[in] context Pointer to the content decoding context
+ **/
+
+static void httpInflateAlign(HttpClientInflateContext *context)
+{
+   //Discard the remaining bits of the current byte
+   httpInflateGetBits(context, context->bitCount & 7);
+}
+
+
+/**
+ * @brief Build a canonical Huffman code from code lengths
+ * @param[out] tree Huffman code
+ * @param[in] lengths Length of the code of each symbol
+ * @param[in] count Number of symbols
+ * @return Error code
+ **/
+
+static error_t httpInflateBuildTree(HttpInflateTree *tree,
+   const uint8_t *lengths, uint_t count)
+{
+   uint_t i;
+   uint_t sum;
+   int_t left;
+   uint16_t offsets[16];
+
+   //Count the number of codes of each length
+   osMemset(tree->counts, 0, sizeof(tree->counts));
+
+   for(i = 0; i < count; i++)
+   {
+      tree->counts[lengths[i]]++;
+   }
+
+   //Symbols with a zero length are not used
+   tree->counts[0] = 0;
+
+   //Reject over-subscribed codes. Incomplete codes are allowed
+   for(left = 1, i = 1; i < 16; i++)
+   {
+      left = (left << 1) - tree->counts[i];
+
+      if(left < 0)
+         return ERROR_DECODING_FAILED;
+   }
+
+   //Offset of the first symbol of each length
+   for(sum = 0, i = 0; i < 16; i++)
+   {
+      offsets[i] = sum;
+      sum += tree->counts[i];
+   }
+
+   //Sort the symbols by code
+   for(i = 0; i < count; i++)
+   {
+      if(lengths[i] != 0)
+      {
+         tree->symbols[offsets[lengths[i]]++] = i;
+      }
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Decode a Huffman-coded symbol
+ * @param[in] context Pointer to the content decoding context
+ * @param[in] tree Huffman code
+ * @return Symbol, or -1 if the code is invalid
+ **/
+
+static int_t httpInflateDecodeSymbol(HttpClientInflateContext *context,
+   const HttpInflateTree *tree)
+{
+   uint_t length;
+   int_t sum;
+   int_t code;
+
+   //Huffman codes are packed starting with the most significant bit
+   for(sum = 0, code = 0, length = 1; length < 16; length++)
+   {
+      //Get the next bit of the code
+      code = (code << 1) | httpInflateGetBits(context, 1);
+
+      //Codes of the current length are numbered from sum
+      sum += tree->counts[length];
+      code -= tree->counts[length];
+
+      //Code found?
+      if(code < 0)
+         return tree->symbols[sum + code];
+   }
+
+   //Invalid code
+   return -1;
+}
+
+
+/**
+ * @brief Parse the gzip or zlib header
+ * @param[in] context Pointer to the content decoding context
+ * @return Error code
+ **/
+
+static error_t httpInflateParseHeader(HttpClientInflateContext *context)
+{
+   uint8_t *p;
+   uint_t b;
+   size_t n;
+
+   //Point to the header
+   p = context->input + context->inputPos;
+   //Number of bytes available
+   n = context->inputLen - context->inputPos;
+
+   //Number of bytes required by the current step
+   if(context->coding == HTTP_CONTENT_CODING_DEFLATE)
+   {
+      b = 2;
+   }
+   else if(context->headerStep == 0)
+   {
+      b = 10;
+   }
+   else if(context->headerStep == 1)
+   {
+      b = ((context->headerFlags & HTTP_GZIP_FLAG_FEXTRA) != 0) ? 2 : 0;
+   }
+   else if(context->headerStep == 2)
+   {
+      b = (context->extraLen > 0) ? 1 : 0;
+   }
+   else if(context->headerStep == 3)
+   {
+      b = ((context->headerFlags & HTTP_GZIP_FLAG_FNAME) != 0) ? 1 : 0;
+   }
+   else if(context->headerStep == 4)
+   {
+      b = ((context->headerFlags & HTTP_GZIP_FLAG_FCOMMENT) != 0) ? 1 : 0;
+   }
+   else
+   {
+      b = ((context->headerFlags & HTTP_GZIP_FLAG_FHCRC) != 0) ? 2 : 0;
+   }
+
+   //The body ends within the header?
+   if(n < b)
+   {
+      context->overrun = TRUE;
+      return NO_ERROR;
+   }
+
+   //zlib or raw deflate?
+   if(context->coding == HTTP_CONTENT_CODING_DEFLATE)
+   {
+      //The header check bits make CMF and FLG a multiple of 31. The window
+      //size is not checked, since distances are checked as they are decoded
+      if((p[0] & 0x0F) == 8 && (p[0] >> 4) <= 7 &&
+         ((p[0] << 8) | p[1]) % 31 == 0)
+      {
+         //A preset dictionary is not supported
+         if((p[1] & 0x20) != 0)
+            return ERROR_UNSUPPORTED_ALGO;
+
+         //zlib wrapper
+         context->zlib = TRUE;
+         context->inputPos += 2;
+      }
+      else
+      {
+         //Raw deflate data, without any header nor trailer
+         context->zlib = FALSE;
+      }
+
+      //Decode the first block
+      context->state = HTTP_INFLATE_STATE_BLOCK_HEADER;
+   }
+   else
+   {
+      //Check the progress through the gzip header
+      switch(context->headerStep)
+      {
+      case 0:
+         //Check ID1, ID2 and CM fields
+         if(p[0] != 0x1F || p[1] != 0x8B || p[2] != 8)
+            return ERROR_DECODING_FAILED;
+
+         //Reserved flags must be zero
+         if((p[3] & HTTP_GZIP_FLAG_RESERVED) != 0)
+            return ERROR_DECODING_FAILED;
+
+         //Save the flags. MTIME, XFL and OS fields are ignored
+         context->headerFlags = p[3];
+         context->inputPos += 10;
+         context->headerStep = 1;
+         break;
+
+      case 1:
+         //Optional extra field?
+         if((context->headerFlags & HTTP_GZIP_FLAG_FEXTRA) != 0)
+         {
+            //Get the length of the extra field
+            context->extraLen = p[0] | (p[1] << 8);
+            context->inputPos += 2;
+         }
+
+         context->headerStep = 2;
+         break;
+
+      case 2:
+         //Skip the extra field
+         b = MIN(context->extraLen, context->inputLen - context->inputPos);
+         context->inputPos += b;
+         context->extraLen -= b;
+
+         if(context->extraLen == 0)
+            context->headerStep = 3;
+         break;
+
+      case 3:
+      case 4:
+         //Optional file name and comment, zero-terminated
+         if((context->headerFlags & ((context->headerStep == 3) ?
+            HTTP_GZIP_FLAG_FNAME : HTTP_GZIP_FLAG_FCOMMENT)) != 0)
+         {
+            //Skip the string
+            do
+            {
+               b = context->input[context->inputPos++];
+            } while(b != 0 && context->inputPos < context->inputLen);
+
+            //The string is not terminated yet?
+            if(b != 0)
+               break;
+         }
+
+         context->headerStep++;
+         break;
+
+      default:
+         //Optional header CRC, not checked
+         if((context->headerFlags & HTTP_GZIP_FLAG_FHCRC) != 0)
+         {
+            context->inputPos += 2;
+         }
+
+         //Decode the first block
+         context->state = HTTP_INFLATE_STATE_BLOCK_HEADER;
+         break;
+      }
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Parse the header of a block
+ * @param[in] context Pointer to the content decoding context
+ * @return Error code
+ **/
+
+static error_t httpInflateParseBlockHeader(HttpClientInflateContext *context)
+{
+   error_t error;
+   uint_t i;
+
+   //Initialize status code
+   error = NO_ERROR;
+
+   //BFINAL is set for the last block of the stream
+   context->finalBlock = httpInflateGetBits(context, 1);
+
+   //Check block type
+   switch(httpInflateGetBits(context, 2))
+   {
+   //No compression?
+   case 0:
+      context->state = HTTP_INFLATE_STATE_STORED_HEADER;
+      break;
+
+   //Compressed with fixed Huffman codes?
+   case 1:
+      //Code lengths of the fixed literal/length code
+      for(i = 0; i < 144; i++)
+         context->lengths[i] = 8;
+      for(; i < 256; i++)
+         context->lengths[i] = 9;
+      for(; i < 280; i++)
+         context->lengths[i] = 7;
+      for(; i < 288; i++)
+         context->lengths[i] = 8;
+
+      //Code lengths of the fixed distance code
+      for(; i < 288 + 30; i++)
+         context->lengths[i] = 5;
+
+      //Build the codes
+      error = httpInflateBuildTree(&context->litTree, context->lengths, 288);
+
+      //Check status code
+      if(!error)
+      {
+         error = httpInflateBuildTree(&context->distTree,
+            context->lengths + 288, 30);
+      }
+
+      //Decode the compressed data
+      context->state = HTTP_INFLATE_STATE_DATA;
+      break;
+
+   //Compressed with dynamic Huffman codes?
+   case 2:
+      context->state = HTTP_INFLATE_STATE_TABLE_HEADER;
+      break;
+
+   //Reserved block type?
+   default:
+      error = ERROR_DECODING_FAILED;
+      break;
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Decode the next code length of a dynamic block
+ * @param[in] context Pointer to the content decoding context
+ * @return Error code
+ **/
+
+static error_t httpInflateParseLengths(HttpClientInflateContext *context)
+{
+   error_t error;
+   int_t symbol;
+   uint_t count;
+   uint8_t length;
+
+   //Initialize status code
+   error = NO_ERROR;
+
+   //The distance tree holds the code length code at this stage
+   symbol = httpInflateDecodeSymbol(context, &context->distTree);
+
+   //Literal code length?
+   if(symbol >= 0 && symbol < 16)
+   {
+      context->lengths[context->index++] = (uint8_t) symbol;
+   }
+   else
+   {
+      //Check the repeat code
+      if(symbol == 16 && context->index > 0)
+      {
+         //Copy the previous code length 3 to 6 times
+         length = context->lengths[context->index - 1];
+         count = 3 + httpInflateGetBits(context, 2);
+      }
+      else if(symbol == 17)
+      {
+         //Repeat a code length of 0 for 3 to 10 times
+         length = 0;
+         count = 3 + httpInflateGetBits(context, 3);
+      }
+      else if(symbol == 18)
+      {
+         //Repeat a code length of 0 for 11 to 138 times
+         length = 0;
+         count = 11 + httpInflateGetBits(context, 7);
+      }
+      else
+      {
+         //Invalid code
+         return ERROR_DECODING_FAILED;
+      }
+
+      //The repetition cannot go past the last code
+      if(context->index + count > context->hlit + context->hdist)
+         return ERROR_DECODING_FAILED;
+
+      //Repeat the code length
+      osMemset(context->lengths + context->index, length, count);
+      context->index += count;
+   }
+
+   //All the code lengths have been decoded?
+   if(context->index == context->hlit + context->hdist)
+   {
+      //The end-of-block code must be present
+      if(context->lengths[256] == 0)
+         return ERROR_DECODING_FAILED;
+
+      //Build the literal/length code
+      error = httpInflateBuildTree(&context->litTree, context->lengths,
+         context->hlit);
+
+      //Check status code
+      if(!error)
+      {
+         //Build the distance code
+         error = httpInflateBuildTree(&context->distTree,
+            context->lengths + context->hlit, context->hdist);
+      }
+
+      //Decode the compressed data
+      context->state = HTTP_INFLATE_STATE_DATA;
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Decode the next literal or match of a compressed block
+ * @param[in] context Pointer to the content decoding context
+ * @param[out] data Location where to store a literal byte
+ * @return ERROR_BUFFER_OVERFLOW when a literal byte has been stored,
+ *   or another error code
+ **/
+
+static error_t httpInflateParseSymbol(HttpClientInflateContext *context,
+   uint8_t *data)
+{
+   int_t symbol;
+   uint_t length;
+   uint_t dist;
+
+   //Decode a literal/length symbol
+   symbol = httpInflateDecodeSymbol(context, &context->litTree);
+
+   //Literal byte?
+   if(symbol >= 0 && symbol < 256)
+   {
+      //Copy the byte to the output
+      httpInflateOutputByte(context, data, (uint8_t) symbol);
+      //The caller accounts for the byte
+      return ERROR_BUFFER_OVERFLOW;
+   }
+
+   //End of block?
+   if(symbol == 256)
+   {
+      //Decode the next block, or check the trailer
+      context->state = context->finalBlock ?
+         HTTP_INFLATE_STATE_TRAILER : HTTP_INFLATE_STATE_BLOCK_HEADER;
+
+      return NO_ERROR;
+   }
+
+   //Invalid length code?
+   if(symbol < 257 || symbol > 285)
+      return ERROR_DECODING_FAILED;
+
+   //Decode the length of the match
+   symbol -= 257;
+   length = httpInflateLengthBase[symbol] +
+      httpInflateGetBits(context, httpInflateLengthExtra[symbol]);
+
+   //Decode the distance of the match
+   symbol = httpInflateDecodeSymbol(context, &context->distTree);
+
+   //Invalid distance code?
+   if(symbol < 0 || symbol > 29)
+      return ERROR_DECODING_FAILED;
+
+   dist = httpInflateDistBase[symbol] +
+      httpInflateGetBits(context, httpInflateDistExtra[symbol]);
+
+   //The match must lie within the data held by the window
+   if(dist > context->windowFill)
+   {
+      //Debug message
+      TRACE_WARNING("Deflate distance exceeds the window size\r\n");
+      //Report an error
+      return ERROR_DECODING_FAILED;
+   }
+
+   //Copy the match
+   context->copyLen = length;
+   context->copyDist = dist;
+   context->state = HTTP_INFLATE_STATE_COPY;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Check the gzip or zlib trailer
+ * @param[in] context Pointer to the content decoding context
+ * @return Error code
+ **/
+
+static error_t httpInflateCheckTrailer(HttpClientInflateContext *context)
+{
+   uint32_t value;
+
+   //Raw deflate data has no trailer
+   if(context->coding == HTTP_CONTENT_CODING_DEFLATE && !context->zlib)
+   {
+      context->state = HTTP_INFLATE_STATE_COMPLETE;
+      return NO_ERROR;
+   }
+
+   //The trailer starts on a byte boundary
+   httpInflateAlign(context);
+
+   //gzip trailer?
+   if(context->coding == HTTP_CONTENT_CODING_GZIP)
+   {
+      //CRC-32 of the uncompressed data, least significant byte first
+      value = httpInflateGetBits(context, 16);
+      value |= (uint32_t) httpInflateGetBits(context, 16) << 16;
+
+      //Check the CRC-32
+      if(value != context->checksum)
+         return ERROR_DECODING_FAILED;
+
+      //Size of the uncompressed data, modulo 2^32
+      value = httpInflateGetBits(context, 16);
+      value |= (uint32_t) httpInflateGetBits(context, 16) << 16;
+
+      //Check the size
+      if(value != context->outputLen)
+         return ERROR_DECODING_FAILED;
+   }
+   else
+   {
+      //Adler-32 of the uncompressed data, most significant byte first
+      value = (uint32_t) httpInflateGetBits(context, 8) << 24;
+      value |= (uint32_t) httpInflateGetBits(context, 8) << 16;
+      value |= (uint32_t) httpInflateGetBits(context, 8) << 8;
+      value |= (uint32_t) httpInflateGetBits(context, 8);
+
+      //Check the Adler-32
+      if(value != context->checksum)
+         return ERROR_DECODING_FAILED;
+   }
+
+   //The whole stream has been decoded
+   context->state = HTTP_INFLATE_STATE_COMPLETE;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Output a decoded byte
+ * @param[in] context Pointer to the content decoding context
+ * @param[out] data Output location
+ * @param[in] value Decoded byte
+ **/
+
+static void httpInflateOutputByte(HttpClientInflateContext *context,
+   uint8_t *data, uint8_t value)
+{
+   //Store the byte in the output buffer
+   *data = value;
+
+   //Keep a copy in the sliding window
+   context->window[context->windowPos] = value;
+   context->windowPos = (context->windowPos + 1) &
+      (HTTP_CLIENT_INFLATE_WINDOW_SIZE - 1);
+
+   //Number of bytes that matches can refer to
+   if(context->windowFill < HTTP_CLIENT_INFLATE_WINDOW_SIZE)
+   {
+      context->windowFill++;
+   }
+}
+
+
+/**
+ * @brief Update the checksum of the output
+ * @param[in] context Pointer to the content decoding context
+ * @param[in] data Decoded data
+ * @param[in] length Number of bytes
+ **/
+
+static void httpInflateUpdateChecksum(HttpClientInflateContext *context,
+   const uint8_t *data, size_t length)
+{
+   size_t n;
+   uint32_t a;
+   uint32_t b;
+   uint32_t crc;
+
+   //Size of the uncompressed data, modulo 2^32
+   context->outputLen += (uint32_t) length;
+
+   //gzip file format?
+   if(context->coding == HTTP_CONTENT_CODING_GZIP)
+   {
+      //Update CRC-32, one nibble at a time
+      crc = ~context->checksum;
+
+      while(length-- > 0)
+      {
+         crc ^= *(data++);
+         crc = (crc >> 4) ^ httpInflateCrc32Table[crc & 0x0F];
+         crc = (crc >> 4) ^ httpInflateCrc32Table[crc & 0x0F];
+      }
+
+      context->checksum = ~crc;
+   }
+   else if(context->zlib)
+   {
+      //Update Adler-32
+      a = context->checksum & 0xFFFF;
+      b = context->checksum >> 16;
+
+      while(length > 0)
+      {
+         //The modulo is deferred as long as the sums cannot overflow
+         n = MIN(length, 5552);
+         length -= n;
+
+         while(n-- > 0)
+         {
+            a += *(data++);
+            b += a;
+         }
+
+         a %= HTTP_ADLER32_MOD;
+         b %= HTTP_ADLER32_MOD;
+      }
+
+      context->checksum = (b << 16) | a;
+   }
+   else
+   {
+      //Raw deflate data has no checksum
+   }
+}
+
+#endif
@@ -0,0 +1,163 @@
+/**
+ * @file http_client_inflate.h
+ * @brief HTTP content decoding (gzip and deflate)
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+
+#ifndef _HTTP_CLIENT_INFLATE_H
+#define _HTTP_CLIENT_INFLATE_H
+
+//Dependencies
+#include "core/net.h"
+#include "http/http_client.h"
+
+//Content decoding support
+#ifndef HTTP_CLIENT_INFLATE_SUPPORT
+   #define HTTP_CLIENT_INFLATE_SUPPORT DISABLED
+#elif (HTTP_CLIENT_INFLATE_SUPPORT != ENABLED && HTTP_CLIENT_INFLATE_SUPPORT != DISABLED)
+   #error HTTP_CLIENT_INFLATE_SUPPORT parameter is not valid
+#endif
+
+//Size of the sliding window (power of two)
+#ifndef HTTP_CLIENT_INFLATE_WINDOW_SIZE
+   #define HTTP_CLIENT_INFLATE_WINDOW_SIZE 32768
+#elif (HTTP_CLIENT_INFLATE_WINDOW_SIZE < 256 || HTTP_CLIENT_INFLATE_WINDOW_SIZE > 32768 || \
+   (HTTP_CLIENT_INFLATE_WINDOW_SIZE & (HTTP_CLIENT_INFLATE_WINDOW_SIZE - 1)) != 0)
+   #error HTTP_CLIENT_INFLATE_WINDOW_SIZE parameter is not valid
+#endif
+
+//Size of the buffer holding compressed data
+#ifndef HTTP_CLIENT_INFLATE_INPUT_SIZE
+   #define HTTP_CLIENT_INFLATE_INPUT_SIZE 1024
+#elif (HTTP_CLIENT_INFLATE_INPUT_SIZE < 16)
+   #error HTTP_CLIENT_INFLATE_INPUT_SIZE parameter is not valid
+#endif
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Content codings
+ **/
+
+typedef enum
+{
+   HTTP_CONTENT_CODING_IDENTITY = 0,
+   HTTP_CONTENT_CODING_GZIP     = 1,
+   HTTP_CONTENT_CODING_DEFLATE  = 2
+} HttpContentCoding;
+
+
+/**
+ * @brief Decoder states
+ **/
+
+typedef enum
+{
+   HTTP_INFLATE_STATE_HEADER        = 0,
+   HTTP_INFLATE_STATE_BLOCK_HEADER  = 1,
+   HTTP_INFLATE_STATE_STORED_HEADER = 2,
+   HTTP_INFLATE_STATE_STORED_DATA   = 3,
+   HTTP_INFLATE_STATE_TABLE_HEADER  = 4,
+   HTTP_INFLATE_STATE_CODE_LENGTHS  = 5,
+   HTTP_INFLATE_STATE_LENGTHS       = 6,
+   HTTP_INFLATE_STATE_DATA          = 7,
+   HTTP_INFLATE_STATE_COPY          = 8,
+   HTTP_INFLATE_STATE_TRAILER       = 9,
+   HTTP_INFLATE_STATE_COMPLETE      = 10
+} HttpInflateState;
+
+
+/**
+ * @brief Canonical Huffman code
+ **/
+
+typedef struct
+{
+   uint16_t counts[16];   ///<Number of codes of each length
+   uint16_t symbols[288]; ///<Symbols ordered by code
+} HttpInflateTree;
+
+
+/**
+ * @brief Content decoding context
+ **/
+
+typedef struct
+{
+   HttpClientContext *httpContext;                   ///<HTTP client context
+   HttpContentCoding coding;                         ///<Content coding of the response
+   HttpInflateState state;                           ///<Decoder state
+   bool_t zlib;                                      ///<The deflate stream has a zlib wrapper
+   uint8_t input[HTTP_CLIENT_INFLATE_INPUT_SIZE];    ///<Compressed data
+   size_t inputLen;                                  ///<Number of bytes in the input buffer
+   size_t inputPos;                                  ///<Current position in the input buffer
+   bool_t inputEnd;                                  ///<The end of the response body has been reached
+   bool_t overrun;                                   ///<The compressed data is truncated
+   uint32_t bitBuffer;                               ///<Bits not consumed yet
+   uint_t bitCount;                                  ///<Number of bits in the bit buffer
+   uint_t headerStep;                                ///<Progress through the gzip header
+   uint8_t headerFlags;                              ///<Flags of the gzip header
+   uint_t extraLen;                                  ///<Length of the extra field of the gzip header
+   bool_t finalBlock;                                ///<The current block is the last one
+   uint_t hlit;                                      ///<Number of literal/length codes
+   uint_t hdist;                                     ///<Number of distance codes
+   uint_t hclen;                                     ///<Number of code length codes
+   uint_t index;                                     ///<Current code length
+   uint8_t codeLengths[19];                          ///<Lengths of the code length codes
+   uint8_t lengths[288 + 32];                        ///<Lengths of the literal/length and distance codes
+   HttpInflateTree litTree;                          ///<Literal/length code
+   HttpInflateTree distTree;                         ///<Distance code
+   size_t copyLen;                                   ///<Bytes left to copy
+   uint_t copyDist;                                  ///<Distance of the match being copied
+   uint32_t checksum;                                ///<CRC-32 or Adler-32 of the output
+   uint32_t outputLen;                               ///<Length of the output, modulo 2^32
+   uint8_t window[HTTP_CLIENT_INFLATE_WINDOW_SIZE];  ///<Sliding window
+   size_t windowPos;                                 ///<Current position in the window
+   size_t windowFill;                                ///<Number of valid bytes in the window
+} HttpClientInflateContext;
+
+
+//HTTP content decoding related functions
+error_t httpClientInflateInit(HttpClientInflateContext *context,
+   HttpClientContext *httpContext);
+
+error_t httpClientInflateRead(HttpClientInflateContext *context, void *data,
+   size_t size, size_t *received);
+
+HttpContentCoding httpClientInflateGetCoding(HttpClientInflateContext *context);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
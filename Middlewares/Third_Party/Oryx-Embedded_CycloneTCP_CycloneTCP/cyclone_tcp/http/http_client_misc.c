@@ -279,11 +279,106 @@ error_t httpClientParseStatusLine(HttpClientContext *context, char_t *line,
    context->bufferPos = 0;
    context->bodyPos = 0;
 
+   //The header fields are indexed as they are received
+   httpClientResetHeaderIndex(context);
+
    //Successful processing
    return NO_ERROR;
 }
 
 
+/**
+ * @brief Clear the index of the header fields
+ * @param[in] context Pointer to the HTTP client context
+ **/
+
+void httpClientResetHeaderIndex(HttpClientContext *context)
+{
+   //No header field has been received yet
+   osMemset(&context->headerIndex, 0, sizeof(HttpClientHeaderIndex));
+   context->headerIndex.complete = TRUE;
+}
+
+
+/**
+ * @brief Receive the next line of the HTTP response header or trailer
+ *
+ * A header field that does not fit in the buffer is dropped, together with
+ * its continuation lines, instead of failing the whole response. The fields
+ * received so far remain available
+ *
+ * @param[in] context Pointer to the HTTP client context
+ * @return Error code
+ **/
+
+error_t httpClientReceiveHeaderLine(HttpClientContext *context)
+{
+   error_t error;
+   size_t n;
+   HttpClientHeaderIndex *index;
+
+   //Point to the index of the header fields
+   index = &context->headerIndex;
+
+   //Any room left in the buffer?
+   if(context->bufferLen < HTTP_CLIENT_BUFFER_SIZE)
+   {
+      //Receive more data
+      error = httpClientReceiveData(context, context->buffer +
+         context->bufferLen, HTTP_CLIENT_BUFFER_SIZE - context->bufferLen,
+         &n, HTTP_FLAG_BREAK_CRLF);
+
+      //Check status code
+      if(!error)
+      {
+         //Dropping the rest of a line?
+         if(index->skipLine)
+         {
+            //The line ends with a LF character
+            if(n > 0 && context->buffer[context->bufferLen + n - 1] == '\n')
+            {
+               index->skipLine = FALSE;
+            }
+         }
+         else
+         {
+            //Adjust the length of the buffer
+            context->bufferLen += n;
+         }
+
+         //Save current time
+         context->timestamp = osGetSystemTime();
+      }
+   }
+   else if(context->requestState != HTTP_REQ_STATE_RECEIVE_STATUS_LINE &&
+      (context->bufferPos + 2) <= HTTP_CLIENT_BUFFER_SIZE)
+   {
+      //Drop the header field being received. The end of the header can
+      //still be detected since the empty line fits in the buffer
+      context->bufferLen = context->bufferPos;
+
+      //Drop the rest of the line and its continuation lines
+      index->skipLine = TRUE;
+      index->skipFolded = TRUE;
+      index->discarded++;
+
+      //Debug message
+      TRACE_INFO("HTTP header field too large, discarded\r\n");
+
+      //Successful processing
+      error = NO_ERROR;
+   }
+   else
+   {
+      //The client implementation limits the size of headers it accepts
+      error = ERROR_BUFFER_OVERFLOW;
+   }
+
+   //Return status code
+   return error;
+}
+
+
 /**
  * @brief Parse HTTP response header field
  * @param[in] context Pointer to the HTTP client context
@@ -301,6 +396,7 @@ error_t httpClientParseHeaderField(HttpClientContext *context, char_t *line,
    char_t *value;
    size_t valueLen;
    char_t *separator;
+   uint_t id;
 
    //Properly terminate the string with a NULL character
    line[length] = '\0';
@@ -318,6 +414,14 @@ error_t httpClientParseHeaderField(HttpClientContext *context, char_t *line,
    //line begins with a space or horizontal tab
    if(line[0] == ' ' || line[0] == '\t')
    {
+      //The field being continued has been dropped?
+      if(context->headerIndex.skipFolded)
+      {
+         //Drop the continuation line as well
+         context->bufferLen = context->bufferPos;
+         return NO_ERROR;
+      }
+
       //A continuation line cannot immediately follows the Status-Line
       if(context->bufferPos == 0)
          return ERROR_INVALID_SYNTAX;
@@ -367,21 +471,39 @@ error_t httpClientParseHeaderField(HttpClientContext *context, char_t *line,
       if(nameLen == 0)
          return ERROR_INVALID_SYNTAX;
 
+      //A new field starts
+      context->headerIndex.skipFolded = FALSE;
+      //The field does not belong to the well-known ones yet
+      id = HTTP_CLIENT_NUM_KNOWN_FIELDS;
+
       //Check header field name
       if(osStrcasecmp(name, "Connection") == 0)
       {
          //Parse Connection header field
          httpClientParseConnectionField(context, value);
+         id = HTTP_CLIENT_FIELD_CONNECTION;
       }
       else if(osStrcasecmp(name, "Transfer-Encoding") == 0)
       {
          //Parse Transfer-Encoding header field
          httpClientParseTransferEncodingField(context, value);
+         id = HTTP_CLIENT_FIELD_TRANSFER_ENCODING;
       }
       else if(osStrcasecmp(name, "Content-Length") == 0)
       {
          //Parse Content-Length header field
          httpClientParseContentLengthField(context, value);
+         id = HTTP_CLIENT_FIELD_CONTENT_LENGTH;
+      }
+      else if(osStrcasecmp(name, "Content-Type") == 0)
+      {
+         //Content-Type header field found
+         id = HTTP_CLIENT_FIELD_CONTENT_TYPE;
+      }
+      else if(osStrcasecmp(name, "Content-Encoding") == 0)
+      {
+         //Content-Encoding header field found
+         id = HTTP_CLIENT_FIELD_CONTENT_ENCODING;
       }
 #if (HTTP_CLIENT_AUTH_SUPPORT == ENABLED)
       //WWW-Authenticate header field found?
@@ -405,6 +527,26 @@ error_t httpClientParseHeaderField(HttpClientContext *context, char_t *line,
 
       //Update the size of the hash table
       context->bufferLen = context->bufferPos + nameLen + valueLen + 2;
+
+      //Index the field by the offset of its name
+      if(context->headerIndex.fieldCount < HTTP_CLIENT_MAX_HEADER_FIELDS)
+      {
+         context->headerIndex.field[context->headerIndex.fieldCount++] =
+            (uint16_t) context->bufferPos;
+      }
+      else
+      {
+         //Lookups must scan the buffer
+         context->headerIndex.complete = FALSE;
+      }
+
+      //The first occurrence of a well-known field is located directly
+      if(id < HTTP_CLIENT_NUM_KNOWN_FIELDS &&
+         context->headerIndex.known[id] == 0)
+      {
+         context->headerIndex.known[id] =
+            (uint16_t) (context->bufferPos + nameLen + 2);
+      }
    }
 
    //Decode the next header field
@@ -561,6 +703,9 @@ error_t httpClientParseChunkSize(HttpClientContext *context, char_t *line,
    //The chunked encoding is ended by any chunk whose size is zero
    if(context->bodyLen == 0)
    {
+      //The trailer fields are indexed as they are received
+      httpClientResetHeaderIndex(context);
+
       //The last chunk is followed by an optional trailer
       httpClientChangeRequestState(context, HTTP_REQ_STATE_RECEIVE_TRAILER);
    }
@@ -54,6 +54,9 @@ error_t httpClientFormatChunkSize(HttpClientContext *context, size_t length);
 error_t httpClientParseStatusLine(HttpClientContext *context, char_t *line,
    size_t length);
 
+void httpClientResetHeaderIndex(HttpClientContext *context);
+error_t httpClientReceiveHeaderLine(HttpClientContext *context);
+
 error_t httpClientParseHeaderField(HttpClientContext *context, char_t *line,
    size_t length);
 
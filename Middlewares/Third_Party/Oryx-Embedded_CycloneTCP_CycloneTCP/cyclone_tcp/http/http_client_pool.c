@@ -0,0 +1,652 @@
+/**
+ * @file http_client_pool.c
+ * @brief Pool of persistent HTTP client connections
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * HTTP/1.1 connections are persistent unless either side asks otherwise.
+ * The pool keeps the connections of completed requests open, keyed by the
+ * host name and port of the server, so that the next request to the same
+ * server skips the name resolution, the TCP handshake and slow start. An
+ * idle connection is checked before reuse and dropped once the server has
+ * closed it or once it has been idle for longer than the idle timeout. Refer
+ * to RFC 7230, section 6.3 for complete details
+ *
+ * Over TLS, each entry also keeps the session of its last connection, so
+ * that a new connection to the same server resumes it (session ID, ticket
+ * or PSK) instead of performing a full handshake
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL HTTP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/tcp.h"
+#include "http/http_client.h"
+#include "http/http_client_pool.h"
+#include "http/http_client_transport.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (HTTP_CLIENT_SUPPORT == ENABLED && HTTP_CLIENT_POOL_SUPPORT == ENABLED)
+
+
+/**
+ * @brief Check whether an idle connection can still carry a request
+ * @param[in] pool Pointer to the connection pool
+ * @param[in] entry Pointer to the idle connection
+ * @return TRUE if the connection can be reused, else FALSE
+ **/
+
+static bool_t httpClientPoolCheckEntry(HttpClientPool *pool,
+   HttpClientPoolEntry *entry)
+{
+   //The connection must be established
+   if(entry->context.state != HTTP_CLIENT_STATE_CONNECTED ||
+      entry->context.socket == NULL)
+   {
+      return FALSE;
+   }
+
+   //Check whether the idle timeout has elapsed
+   if(timeCompare(osGetSystemTime(), entry->timestamp + pool->idleTimeout) >= 0)
+   {
+      //Update statistics
+      pool->stats.idleCloses++;
+      return FALSE;
+   }
+
+   //A server that closes an idle connection sends a FIN or a RST segment
+   if(tcpGetState(entry->context.socket) != TCP_STATE_ESTABLISHED)
+   {
+      //Update statistics
+      pool->stats.staleCloses++;
+      return FALSE;
+   }
+
+   //The connection can be reused
+   return TRUE;
+}
+
+
+/**
+ * @brief Close a pooled connection
+ * @param[in] entry Pointer to the pooled connection
+ **/
+
+static void httpClientPoolCloseEntry(HttpClientPoolEntry *entry)
+{
+#if (HTTP_CLIENT_TLS_SUPPORT == ENABLED)
+   //Save the TLS session of a live connection, including the tickets the
+   //server sent after the handshake
+   httpClientSaveSession(&entry->context);
+
+   //The TLS session outlives the HTTP client context
+   tlsFreeSessionState(&entry->tlsSession);
+   entry->tlsSession = entry->context.tlsSession;
+   tlsInitSessionState(&entry->context.tlsSession);
+
+   //Remember the server the TLS session belongs to
+   osStrcpy(entry->sessionHost, entry->host);
+   entry->sessionPort = entry->port;
+#endif
+
+   //Close the connection and release the HTTP client context
+   httpClientDeinit(&entry->context);
+
+   //The entry is now free
+   entry->host[0] = '\0';
+   entry->port = 0;
+   entry->inUse = FALSE;
+}
+
+
+/**
+ * @brief Initialize a connection pool
+ * @param[in] pool Pointer to the connection pool
+ * @param[in] initCallback Connection initialization callback (optional)
+ * @return Error code
+ **/
+
+error_t httpClientPoolInit(HttpClientPool *pool,
+   HttpClientPoolInitCallback initCallback)
+{
+#if (HTTP_CLIENT_TLS_SUPPORT == ENABLED)
+   uint_t i;
+#endif
+
+   //Make sure the connection pool is valid
+   if(pool == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Clear the connection pool
+   osMemset(pool, 0, sizeof(HttpClientPool));
+
+   //Create a mutex to prevent simultaneous access to the pool
+   if(!osCreateMutex(&pool->mutex))
+      return ERROR_OUT_OF_RESOURCES;
+
+#if (HTTP_CLIENT_TLS_SUPPORT == ENABLED)
+   //Loop through the pooled connections
+   for(i = 0; i < HTTP_CLIENT_POOL_SIZE; i++)
+   {
+      //No TLS session saved yet
+      tlsInitSessionState(&pool->entries[i].tlsSession);
+   }
+#endif
+
+   //Default idle timeout
+   pool->idleTimeout = HTTP_CLIENT_POOL_IDLE_TIMEOUT;
+   //Connection initialization callback
+   pool->initCallback = initCallback;
+
+   //Successful initialization
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Bind the connections of the pool to a particular network interface
+ * @param[in] pool Pointer to the connection pool
+ * @param[in] interface Network interface to be used
+ * @return Error code
+ **/
+
+error_t httpClientPoolBindToInterface(HttpClientPool *pool,
+   NetInterface *interface)
+{
+   //Make sure the connection pool is valid
+   if(pool == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Explicitly associate the new connections with the specified interface
+   pool->interface = interface;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Set the time after which an idle connection is closed
+ *
+ * The idle timeout should be shorter than the keep-alive timeout of the
+ * server, so that the server rarely closes a connection the client is about
+ * to reuse
+ *
+ * @param[in] pool Pointer to the connection pool
+ * @param[in] idleTimeout Idle timeout, in milliseconds
+ * @return Error code
+ **/
+
+error_t httpClientPoolSetIdleTimeout(HttpClientPool *pool,
+   systime_t idleTimeout)
+{
+   //Make sure the connection pool is valid
+   if(pool == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Save idle timeout
+   pool->idleTimeout = idleTimeout;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Get a connection to the specified server
+ *
+ * An idle connection to the same server is reused when possible. Otherwise
+ * the host name is resolved and a new connection is established. The caller
+ * then issues requests as usual and returns the connection to the pool with
+ * httpClientPoolRelease
+ *
+ * @param[in] pool Pointer to the connection pool
+ * @param[in] host Host name of the server
+ * @param[in] port TCP port number of the server
+ * @param[out] context HTTP client context connected to the server
+ * @return Error code
+ **/
+
+error_t httpClientPoolAcquire(HttpClientPool *pool, const char_t *host,
+   uint16_t port, HttpClientContext **context)
+{
+   error_t error;
+   uint_t i;
+   IpAddr serverIpAddr;
+   HttpClientPoolEntry *entry;
+   HttpClientPoolEntry *oldestEntry;
+
+   //Check parameters
+   if(pool == NULL || host == NULL || context == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Make sure the host name is acceptable
+   if(osStrlen(host) > HTTP_CLIENT_POOL_MAX_HOST_LEN)
+      return ERROR_INVALID_PARAMETER;
+
+   //Initialize pointers
+   entry = NULL;
+   oldestEntry = NULL;
+
+   //Acquire exclusive access to the pool
+   osAcquireMutex(&pool->mutex);
+
+   //Loop through the pooled connections
+   for(i = 0; i < HTTP_CLIENT_POOL_SIZE; i++)
+   {
+      //Idle connection?
+      if(!pool->entries[i].inUse && pool->entries[i].host[0] != '\0')
+      {
+         //Drop the connections that can no longer be reused
+         if(!httpClientPoolCheckEntry(pool, &pool->entries[i]))
+         {
+            httpClientPoolCloseEntry(&pool->entries[i]);
+         }
+      }
+   }
+
+   //Look for an idle connection to the same server
+   for(i = 0; i < HTTP_CLIENT_POOL_SIZE && entry == NULL; i++)
+   {
+      if(!pool->entries[i].inUse && pool->entries[i].host[0] != '\0' &&
+         pool->entries[i].port == port &&
+         osStrcasecmp(pool->entries[i].host, host) == 0)
+      {
+         entry = &pool->entries[i];
+      }
+   }
+
+   //Idle connection found?
+   if(entry != NULL)
+   {
+      //The connection belongs to the caller until it is released
+      entry->inUse = TRUE;
+      //Update statistics
+      pool->stats.reuses++;
+
+      //Release exclusive access to the pool
+      osReleaseMutex(&pool->mutex);
+
+      //Debug message
+      TRACE_DEBUG("Reusing HTTP connection to %s:%" PRIu16 "\r\n", host, port);
+
+      //Return the connected HTTP client context
+      *context = &entry->context;
+      return NO_ERROR;
+   }
+
+#if (HTTP_CLIENT_TLS_SUPPORT == ENABLED)
+   //Prefer the free entry holding a TLS session of the same server
+   for(i = 0; i < HTTP_CLIENT_POOL_SIZE && entry == NULL; i++)
+   {
+      if(!pool->entries[i].inUse && pool->entries[i].host[0] == '\0' &&
+         pool->entries[i].sessionPort == port &&
+         osStrcasecmp(pool->entries[i].sessionHost, host) == 0)
+      {
+         entry = &pool->entries[i];
+      }
+   }
+#endif
+
+   //Loop through the pooled connections
+   for(i = 0; i < HTTP_CLIENT_POOL_SIZE && entry == NULL; i++)
+   {
+      //Free entry?
+      if(!pool->entries[i].inUse && pool->entries[i].host[0] == '\0')
+      {
+         entry = &pool->entries[i];
+      }
+      else if(!pool->entries[i].inUse)
+      {
+         //Keep track of the connection that has been idle for the longest time
+         if(oldestEntry == NULL || timeCompare(pool->entries[i].timestamp,
+            oldestEntry->timestamp) < 0)
+         {
+            oldestEntry = &pool->entries[i];
+         }
+      }
+   }
+
+   //No free entry?
+   if(entry == NULL && oldestEntry != NULL)
+   {
+      //Close the connection that has been idle for the longest time
+      httpClientPoolCloseEntry(oldestEntry);
+      //Update statistics
+      pool->stats.evictions++;
+
+      //Reuse the entry
+      entry = oldestEntry;
+   }
+
+   //Any entry available?
+   if(entry != NULL)
+   {
+      //The connection belongs to the caller until it is released
+      entry->inUse = TRUE;
+      //Save the key of the connection
+      osStrcpy(entry->host, host);
+      entry->port = port;
+   }
+
+   //Release exclusive access to the pool
+   osReleaseMutex(&pool->mutex);
+
+   //All the connections are owned by other callers?
+   if(entry == NULL)
+      return ERROR_OUT_OF_RESOURCES;
+
+   //Start of exception handling block
+   do
+   {
+      //Initialize HTTP client context
+      error = httpClientInit(&entry->context);
+      //Any error to report?
+      if(error)
+         break;
+
+      //Select the relevant network interface
+      error = httpClientBindToInterface(&entry->context, pool->interface);
+      //Any error to report?
+      if(error)
+         break;
+
+#if (HTTP_CLIENT_TLS_SUPPORT == ENABLED)
+      //TLS session of the same server?
+      if(entry->sessionPort == port &&
+         osStrcasecmp(entry->sessionHost, host) == 0)
+      {
+         //The session is resumed when the connection is established
+         tlsFreeSessionState(&entry->context.tlsSession);
+         entry->context.tlsSession = entry->tlsSession;
+         tlsInitSessionState(&entry->tlsSession);
+         //Update statistics
+         pool->stats.resumptions++;
+      }
+      else
+      {
+         //The session of another server is of no use
+         tlsFreeSessionState(&entry->tlsSession);
+      }
+
+      //The HTTP client context now holds the TLS session
+      entry->sessionHost[0] = '\0';
+      entry->sessionPort = 0;
+#endif
+
+      //Invoke user callback, if any
+      if(pool->initCallback != NULL)
+      {
+         //Set up the new HTTP client context
+         error = pool->initCallback(&entry->context);
+         //Any error to report?
+         if(error)
+            break;
+      }
+
+      //Resolve the host name of the server
+      error = getHostByName(pool->interface, host, &serverIpAddr, 0);
+      //Any error to report?
+      if(error)
+         break;
+
+      //Connect to the server
+      error = httpClientConnect(&entry->context, &serverIpAddr, port);
+      //Any error to report?
+      if(error)
+         break;
+
+      //End of exception handling block
+   } while(0);
+
+   //Acquire exclusive access to the pool
+   osAcquireMutex(&pool->mutex);
+
+   //Check status code
+   if(!error)
+   {
+      //Update statistics
+      pool->stats.connects++;
+      //Return the connected HTTP client context
+      *context = &entry->context;
+   }
+   else
+   {
+      //Release the entry
+      httpClientPoolCloseEntry(entry);
+
+#if (HTTP_CLIENT_TLS_SUPPORT == ENABLED)
+      //Do not offer the server a session it may have refused
+      tlsFreeSessionState(&entry->tlsSession);
+      entry->sessionHost[0] = '\0';
+      entry->sessionPort = 0;
+#endif
+   }
+
+   //Release exclusive access to the pool
+   osReleaseMutex(&pool->mutex);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Return a connection to the pool
+ *
+ * The connection is kept open if the caller read the whole response and
+ * both sides agreed on a persistent connection. Otherwise it is closed
+ *
+ * @param[in] pool Pointer to the connection pool
+ * @param[in] context HTTP client context returned by httpClientPoolAcquire
+ * @param[in] reusable FALSE if the connection must be closed (for instance
+ *   after a communication error)
+ * @return Error code
+ **/
+
+error_t httpClientPoolRelease(HttpClientPool *pool,
+   HttpClientContext *context, bool_t reusable)
+{
+   uint_t i;
+   HttpClientPoolEntry *entry;
+
+   //Check parameters
+   if(pool == NULL || context == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Initialize pointer
+   entry = NULL;
+
+   //Look for the entry holding the HTTP client context
+   for(i = 0; i < HTTP_CLIENT_POOL_SIZE && entry == NULL; i++)
+   {
+      if(&pool->entries[i].context == context && pool->entries[i].inUse)
+      {
+         entry = &pool->entries[i];
+      }
+   }
+
+   //The context does not belong to the pool?
+   if(entry == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //The connection can only carry another request once the response has
+   //been completely read
+   if(context->state != HTTP_CLIENT_STATE_CONNECTED || !context->keepAlive ||
+      (context->requestState != HTTP_REQ_STATE_PARSE_TRAILER &&
+      context->requestState != HTTP_REQ_STATE_COMPLETE))
+   {
+      reusable = FALSE;
+   }
+
+#if (HTTP_CLIENT_PIPELINING_SUPPORT == ENABLED)
+   //Responses to pipelined requests must not reach the next owner
+   if(context->pipelineCount > 0)
+   {
+      reusable = FALSE;
+   }
+#endif
+
+   //Connection to be closed?
+   if(!reusable)
+   {
+      //Gracefully disconnect from the server
+      httpClientDisconnect(context);
+   }
+
+   //Acquire exclusive access to the pool
+   osAcquireMutex(&pool->mutex);
+
+   //Persistent connection?
+   if(reusable)
+   {
+      //The connection is now idle
+      entry->inUse = FALSE;
+      entry->timestamp = osGetSystemTime();
+   }
+   else
+   {
+      //Release the entry
+      httpClientPoolCloseEntry(entry);
+   }
+
+   //Release exclusive access to the pool
+   osReleaseMutex(&pool->mutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Close the idle connections that can no longer be reused
+ *
+ * This function may be called periodically so that the server is not kept
+ * waiting on connections whose idle timeout has elapsed
+ *
+ * @param[in] pool Pointer to the connection pool
+ **/
+
+void httpClientPoolPurge(HttpClientPool *pool)
+{
+   uint_t i;
+
+   //Make sure the connection pool is valid
+   if(pool == NULL)
+      return;
+
+   //Acquire exclusive access to the pool
+   osAcquireMutex(&pool->mutex);
+
+   //Loop through the pooled connections
+   for(i = 0; i < HTTP_CLIENT_POOL_SIZE; i++)
+   {
+      //Idle connection?
+      if(!pool->entries[i].inUse && pool->entries[i].host[0] != '\0')
+      {
+         //Drop the connections that can no longer be reused
+         if(!httpClientPoolCheckEntry(pool, &pool->entries[i]))
+         {
+            httpClientPoolCloseEntry(&pool->entries[i]);
+         }
+      }
+   }
+
+   //Release exclusive access to the pool
+   osReleaseMutex(&pool->mutex);
+}
+
+
+/**
+ * @brief Get connection pool statistics
+ * @param[in] pool Pointer to the connection pool
+ * @param[out] stats Statistics
+ * @return Error code
+ **/
+
+error_t httpClientPoolGetStats(HttpClientPool *pool,
+   HttpClientPoolStats *stats)
+{
+   //Check parameters
+   if(pool == NULL || stats == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Acquire exclusive access to the pool
+   osAcquireMutex(&pool->mutex);
+   //Copy statistics
+   *stats = pool->stats;
+   //Release exclusive access to the pool
+   osReleaseMutex(&pool->mutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Release a connection pool
+ *
+ * All the connections are closed. None of them may be in use
+ *
+ * @param[in] pool Pointer to the connection pool
+ **/
+
+void httpClientPoolDeinit(HttpClientPool *pool)
+{
+   uint_t i;
+
+   //Make sure the connection pool is valid
+   if(pool != NULL)
+   {
+      //Loop through the pooled connections
+      for(i = 0; i < HTTP_CLIENT_POOL_SIZE; i++)
+      {
+         //Close the connection
+         if(pool->entries[i].host[0] != '\0')
+         {
+            httpClientPoolCloseEntry(&pool->entries[i]);
+         }
+
+#if (HTTP_CLIENT_TLS_SUPPORT == ENABLED)
+         //Release the saved TLS session
+         tlsFreeSessionState(&pool->entries[i].tlsSession);
+#endif
+      }
+
+      //Release previously allocated resources
+      osDeleteMutex(&pool->mutex);
+
+      //Clear the connection pool
+      osMemset(pool, 0, sizeof(HttpClientPool));
+   }
+}
+
+#endif
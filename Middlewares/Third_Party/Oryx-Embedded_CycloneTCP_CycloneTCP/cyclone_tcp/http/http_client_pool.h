@@ -0,0 +1,159 @@
+/**
+ * @file http_client_pool.h
+ * @brief Pool of persistent HTTP client connections
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+#ifndef _HTTP_CLIENT_POOL_H
+#define _HTTP_CLIENT_POOL_H
+
+//Dependencies
+#include "core/net.h"
+#include "http/http_client.h"
+
+//HTTP client connection pool support
+#ifndef HTTP_CLIENT_POOL_SUPPORT
+   #define HTTP_CLIENT_POOL_SUPPORT DISABLED
+#elif (HTTP_CLIENT_POOL_SUPPORT != ENABLED && HTTP_CLIENT_POOL_SUPPORT != DISABLED)
+   #error HTTP_CLIENT_POOL_SUPPORT parameter is not valid
+#endif
+
+//Number of connections in the pool
+#ifndef HTTP_CLIENT_POOL_SIZE
+   #define HTTP_CLIENT_POOL_SIZE 2
+#elif (HTTP_CLIENT_POOL_SIZE < 1)
+   #error HTTP_CLIENT_POOL_SIZE parameter is not valid
+#endif
+
+//Maximum length of the host name a connection is keyed by
+#ifndef HTTP_CLIENT_POOL_MAX_HOST_LEN
+   #define HTTP_CLIENT_POOL_MAX_HOST_LEN 64
+#elif (HTTP_CLIENT_POOL_MAX_HOST_LEN < 1)
+   #error HTTP_CLIENT_POOL_MAX_HOST_LEN parameter is not valid
+#endif
+
+//Time after which an idle connection is closed
+#ifndef HTTP_CLIENT_POOL_IDLE_TIMEOUT
+   #define HTTP_CLIENT_POOL_IDLE_TIMEOUT 30000
+#elif (HTTP_CLIENT_POOL_IDLE_TIMEOUT < 1000)
+   #error HTTP_CLIENT_POOL_IDLE_TIMEOUT parameter is not valid
+#endif
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Connection initialization callback
+ *
+ * Invoked on a fresh HTTP client context, before it connects to the server
+ * (protocol version, timeout, TLS initialization callback...)
+ **/
+
+typedef error_t (*HttpClientPoolInitCallback)(HttpClientContext *context);
+
+
+/**
+ * @brief Pooled HTTP client connection
+ **/
+
+typedef struct
+{
+   HttpClientContext context;                    ///<HTTP client context
+   char_t host[HTTP_CLIENT_POOL_MAX_HOST_LEN + 1]; ///<Host name of the server
+   uint16_t port;                                ///<TCP port number of the server
+   bool_t inUse;                                 ///<The connection is owned by a caller
+   systime_t timestamp;                          ///<Time at which the connection became idle
+#if (HTTP_CLIENT_TLS_SUPPORT == ENABLED)
+   TlsSessionState tlsSession;                   ///<TLS session of the last connection of the entry
+   char_t sessionHost[HTTP_CLIENT_POOL_MAX_HOST_LEN + 1]; ///<Host name the TLS session belongs to
+   uint16_t sessionPort;                         ///<TCP port number the TLS session belongs to
+#endif
+} HttpClientPoolEntry;
+
+
+/**
+ * @brief HTTP client connection pool statistics
+ **/
+
+typedef struct
+{
+   uint32_t connects;    ///<Connections established
+   uint32_t reuses;      ///<Requests served by an idle connection
+   uint32_t staleCloses; ///<Idle connections found closed by the server
+   uint32_t idleCloses;  ///<Idle connections closed by the idle timeout
+   uint32_t evictions;   ///<Idle connections closed to make room for another server
+   uint32_t resumptions; ///<Connections offered a saved TLS session
+} HttpClientPoolStats;
+
+
+/**
+ * @brief HTTP client connection pool
+ **/
+
+typedef struct
+{
+   OsMutex mutex;                                     ///<Mutex protecting the pool
+   NetInterface *interface;                           ///<Underlying network interface
+   systime_t idleTimeout;                             ///<Idle timeout
+   HttpClientPoolInitCallback initCallback;           ///<Connection initialization callback
+   HttpClientPoolEntry entries[HTTP_CLIENT_POOL_SIZE]; ///<Connections
+   HttpClientPoolStats stats;                         ///<Statistics
+} HttpClientPool;
+
+
+//HTTP client connection pool related functions
+error_t httpClientPoolInit(HttpClientPool *pool,
+   HttpClientPoolInitCallback initCallback);
+
+error_t httpClientPoolBindToInterface(HttpClientPool *pool,
+   NetInterface *interface);
+
+error_t httpClientPoolSetIdleTimeout(HttpClientPool *pool,
+   systime_t idleTimeout);
+
+error_t httpClientPoolAcquire(HttpClientPool *pool, const char_t *host,
+   uint16_t port, HttpClientContext **context);
+
+error_t httpClientPoolRelease(HttpClientPool *pool,
+   HttpClientContext *context, bool_t reusable);
+
+void httpClientPoolPurge(HttpClientPool *pool);
+
+error_t httpClientPoolGetStats(HttpClientPool *pool,
+   HttpClientPoolStats *stats);
+
+void httpClientPoolDeinit(HttpClientPool *pool);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
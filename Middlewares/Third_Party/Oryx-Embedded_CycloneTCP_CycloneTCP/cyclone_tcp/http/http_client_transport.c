@@ -69,6 +69,18 @@ error_t httpClientOpenConnection(HttpClientContext *context)
    if(error)
       return error;
 
+#if (TCP_FAST_OPEN_SUPPORT == ENABLED)
+   //Fast Open requested?
+   if(context->fastOpen)
+   {
+      //The connection completes with the first data sent to the server
+      error = socketEnableFastOpen(context->socket, TRUE);
+      //Any error to report?
+      if(error)
+         return error;
+   }
+#endif
+
 #if (HTTP_CLIENT_TLS_SUPPORT == ENABLED)
    //TLS-secured connection?
    if(context->tlsInitCallback != NULL)
@@ -99,6 +111,16 @@ error_t httpClientOpenConnection(HttpClientContext *context)
       if(error)
          return error;
 
+#if (TLS_MAX_FRAG_LEN_SUPPORT == ENABLED && HTTP_CLIENT_TLS_MAX_FRAG_LEN != 0)
+      //Ask the server for records that fit the RX buffer (the record size
+      //limit of TLS 1.3 is derived from the RX buffer size)
+      error = tlsSetMaxFragmentLength(context->tlsContext,
+         HTTP_CLIENT_TLS_MAX_FRAG_LEN);
+      //Any error to report?
+      if(error)
+         return error;
+#endif
+
       //Restore TLS session
       error = tlsRestoreSessionState(context->tlsContext, &context->tlsSession);
       //Any error to report?
@@ -94,6 +94,7 @@ typedef enum
 
 typedef enum
 {
+   HTTP_FLAG_DONT_WAIT  = 0x0100,
    HTTP_FLAG_WAIT_ALL   = 0x0800,
    HTTP_FLAG_BREAK_CHAR = 0x1000,
    HTTP_FLAG_BREAK_CRLF = 0x100A,
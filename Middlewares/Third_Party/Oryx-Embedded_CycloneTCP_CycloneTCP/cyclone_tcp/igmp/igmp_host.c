@@ -107,6 +107,9 @@ void igmpHostTick(IgmpHostContext *context)
    systime_t delay;
    IgmpHostGroup *group;
    NetInterface *interface;
+#if (IGMP_HOST_REPORT_AGGREGATION_SUPPORT == ENABLED)
+   bool_t pending = FALSE;
+#endif
 
    //Point to the underlying network interface
    interface = context->interface;
@@ -294,9 +297,15 @@ void igmpHostTick(IgmpHostContext *context)
             //Check whether the group timer has expired
             if(netTimerExpired(&group->timer))
             {
+#if (IGMP_HOST_REPORT_AGGREGATION_SUPPORT == ENABLED)
+               //The records of all the groups whose timer has expired are
+               //sent in the same report
+               group->reportPending = TRUE;
+               pending = TRUE;
+#else
                //Send Current-State report message
                igmpHostSendCurrentStateReport(context, group->addr);
-
+#endif
                //Stop group timer
                netStopTimer(&group->timer);
             }
@@ -307,6 +316,15 @@ void igmpHostTick(IgmpHostContext *context)
          }
       }
 
+#if (IGMP_HOST_REPORT_AGGREGATION_SUPPORT == ENABLED)
+      //Any group timer expired?
+      if(pending)
+      {
+         //Send a single Current-State report for the pending groups
+         igmpHostSendCurrentStateReport(context, IPV4_BROADCAST_ADDR);
+      }
+#endif
+
       //If the expired timer is the retransmission timer, then the State-Change
       //report is retransmitted
       if(netTimerExpired(&context->stateChangeReportTimer))
@@ -348,7 +366,9 @@ void igmpHostTick(IgmpHostContext *context)
 void igmpHostStateChangeEvent(IgmpHostContext *context, Ipv4Addr groupAddr,
    IpFilterMode newFilterMode, const Ipv4SrcAddrList *newFilter)
 {
+#if (IGMP_HOST_REPORT_AGGREGATION_SUPPORT == DISABLED)
    systime_t delay;
+#endif
    IgmpHostGroup *group;
    NetInterface *interface;
 
@@ -454,6 +474,12 @@ void igmpHostStateChangeEvent(IgmpHostContext *context, Ipv4Addr groupAddr,
             }
             else
             {
+#if (IGMP_HOST_REPORT_AGGREGATION_SUPPORT == ENABLED)
+               //The report is sent on the next tick, so that the changes made
+               //in a burst (several groups joined or left in a row) share the
+               //same State-Change report and the same retransmissions
+               netStartTimer(&context->stateChangeReportTimer, 0);
+#else
                //Send a State-Change report message
                igmpHostSendStateChangeReport(context);
 
@@ -476,6 +502,7 @@ void igmpHostStateChangeEvent(IgmpHostContext *context, Ipv4Addr groupAddr,
 
                //Delete groups in "non-existent" state
                igmpHostFlushUnusedGroups(context);
+#endif
             }
          }
       }
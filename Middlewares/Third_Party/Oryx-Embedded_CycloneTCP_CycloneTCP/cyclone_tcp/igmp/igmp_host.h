@@ -42,6 +42,13 @@
    #error IGMP_HOST_SUPPORT parameter is not valid
 #endif
 
+//Aggregation of IGMPv3 reports
+#ifndef IGMP_HOST_REPORT_AGGREGATION_SUPPORT
+   #define IGMP_HOST_REPORT_AGGREGATION_SUPPORT DISABLED
+#elif (IGMP_HOST_REPORT_AGGREGATION_SUPPORT != ENABLED && IGMP_HOST_REPORT_AGGREGATION_SUPPORT != DISABLED)
+   #error IGMP_HOST_REPORT_AGGREGATION_SUPPORT parameter is not valid
+#endif
+
 //C++ guard
 #ifdef __cplusplus
 extern "C" {
@@ -96,6 +103,9 @@ typedef struct
    bool_t flag;                    ///<We are the last host to send a report for this group
    uint_t retransmitCount;         ///<Filter mode retransmission counter
    NetTimer timer;                 ///<Report delay timer
+#if (IGMP_HOST_REPORT_AGGREGATION_SUPPORT == ENABLED)
+   bool_t reportPending;           ///<The group timer has expired and the record is not sent yet
+#endif
    IpFilterMode filterMode;        ///<Filter mode
    Ipv4SrcAddrList filter;         ///<Current-state record
 #if (IPV4_MAX_MULTICAST_SOURCES > 0)
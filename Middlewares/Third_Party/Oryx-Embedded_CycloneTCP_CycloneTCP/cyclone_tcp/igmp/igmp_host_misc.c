@@ -194,7 +194,8 @@ void igmpHostSendLeaveGroup(IgmpHostContext *context, Ipv4Addr groupAddr)
 /**
  * @brief Send Current-State Report message
  * @param[in] context Pointer to the IGMP host context
- * @param[in] groupAddr IPv4 address specifying the group address
+ * @param[in] groupAddr IPv4 address specifying the group address, or
+ *   IPV4_BROADCAST_ADDR to report the groups whose group timer has expired
  **/
 
 void igmpHostSendCurrentStateReport(IgmpHostContext *context,
@@ -202,6 +203,7 @@ void igmpHostSendCurrentStateReport(IgmpHostContext *context,
 {
    uint_t i;
    size_t n;
+   bool_t match;
    size_t length;
    size_t offset;
    NetBuffer *buffer;
@@ -234,8 +236,24 @@ void igmpHostSendCurrentStateReport(IgmpHostContext *context,
       //Point to the current group
       group = &context->groups[i];
 
+#if (IGMP_HOST_REPORT_AGGREGATION_SUPPORT == ENABLED)
+      //The broadcast address selects the groups whose group timer has expired
+      if(groupAddr == IPV4_BROADCAST_ADDR)
+      {
+         match = (group->state != IGMP_HOST_GROUP_STATE_NON_MEMBER &&
+            group->reportPending);
+
+         //The record is included in this report
+         group->reportPending = FALSE;
+      }
+      else
+#endif
+      {
+         match = igmpHostMatchGroup(group, groupAddr);
+      }
+
       //Matching group?
-      if(igmpHostMatchGroup(group, groupAddr))
+      if(match)
       {
 #if (IPV4_MAX_MULTICAST_SOURCES > 0)
          //Check whether the interface has reception state for that group
@@ -628,7 +646,7 @@ void igmpHostFlushReportRecords(IgmpHostContext *context, NetBuffer *buffer,
    IgmpMembershipReportV3 *message;
 
    //Any group records included in the message?
-   if(*length > 0)
+   if(*length > sizeof(IgmpMembershipReportV3))
    {
       //Point to the beginning of the report message
       message = netBufferAt(buffer, offset, 0);
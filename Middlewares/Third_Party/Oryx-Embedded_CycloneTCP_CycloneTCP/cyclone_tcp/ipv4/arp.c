@@ -59,6 +59,8 @@ systime_t arpTickCounter;
 
 error_t arpInit(NetInterface *interface)
 {
+   uint_t i;
+
    //Enable ARP protocol
    interface->enableArp = TRUE;
    //Set ARP reachable time
@@ -68,6 +70,16 @@ error_t arpInit(NetInterface *interface)
 
    //Initialize the ARP cache
    osMemset(interface->arpCache, 0, sizeof(interface->arpCache));
+   osMemset(interface->arpHashTable, 0, sizeof(interface->arpHashTable));
+
+   //Chain all the queue items in the free list
+   interface->arpQueueFree = NULL;
+
+   for(i = ARP_QUEUE_POOL_SIZE; i > 0; i--)
+   {
+      interface->arpQueuePool[i - 1].next = interface->arpQueueFree;
+      interface->arpQueueFree = &interface->arpQueuePool[i - 1];
+   }
 
    //Successful initialization
    return NO_ERROR;
@@ -237,7 +249,7 @@ error_t arpAddStaticEntry(NetInterface *interface, Ipv4Addr ipAddr,
       if(entry->state == ARP_STATE_INCOMPLETE)
       {
          //Record the corresponding MAC address
-         entry->macAddr = *macAddr;
+         arpSetMacAddr(entry, macAddr);
          //Send all the packets that are pending for transmission
          arpSendQueuedPackets(interface, entry);
       }
@@ -245,20 +257,18 @@ error_t arpAddStaticEntry(NetInterface *interface, Ipv4Addr ipAddr,
    else
    {
       //Create a new entry in the ARP cache
-      entry = arpCreateEntry(interface);
+      entry = arpCreateEntry(interface, ipAddr);
    }
 
    //ARP cache entry successfully created?
    if(entry != NULL)
    {
-      //Record the IPv4 address and the corresponding MAC address
-      entry->ipAddr = ipAddr;
-      entry->macAddr = *macAddr;
+      //Record the MAC address associated with the IPv4 address
+      arpSetMacAddr(entry, macAddr);
 
       //Unused parameters
       entry->timeout = 0;
       entry->retransmitCount = 0;
-      entry->queueSize = 0;
 
       //Update entry state
       arpChangeState(entry, ARP_STATE_PERMANENT);
@@ -306,7 +316,7 @@ error_t arpRemoveStaticEntry(NetInterface *interface, Ipv4Addr ipAddr)
    if(entry != NULL && entry->state == ARP_STATE_PERMANENT)
    {
       //Delete ARP entry
-      arpChangeState(entry, ARP_STATE_NONE);
+      arpDeleteEntry(interface, entry);
       //Successful processing
       error = NO_ERROR;
    }
@@ -332,7 +342,7 @@ error_t arpRemoveStaticEntry(NetInterface *interface, Ipv4Addr ipAddr)
  * @return Error code
  **/
 
-error_t arpResolve(NetInterface *interface, Ipv4Addr ipAddr, MacAddr *macAddr)
+__net_hot_func error_t arpResolve(NetInterface *interface, Ipv4Addr ipAddr, MacAddr *macAddr)
 {
    error_t error;
    ArpCacheEntry *entry;
@@ -343,6 +353,9 @@ error_t arpResolve(NetInterface *interface, Ipv4Addr ipAddr, MacAddr *macAddr)
    //Check whether a matching entry has been found
    if(entry != NULL)
    {
+      //Keep track of the least recently used entries
+      entry->lastUsed = osGetSystemTime();
+
       //Check the state of the ARP entry
       if(entry->state == ARP_STATE_INCOMPLETE)
       {
@@ -376,19 +389,15 @@ error_t arpResolve(NetInterface *interface, Ipv4Addr ipAddr, MacAddr *macAddr)
       //Check whether ARP is enabled
       if(interface->enableArp)
       {
-         //If no entry exists, then create a new one
-         entry = arpCreateEntry(interface);
+         //If no entry exists, then create a new one, recording the IPv4
+         //address whose MAC address is unknown
+         entry = arpCreateEntry(interface, ipAddr);
 
          //ARP cache entry successfully created?
          if(entry != NULL)
          {
-            //Record the IPv4 address whose MAC address is unknown
-            entry->ipAddr = ipAddr;
-
             //Reset retransmission counter
             entry->retransmitCount = 0;
-            //No packet are pending in the transmit queue
-            entry->queueSize = 0;
 
             //Send an ARP request
             arpSendRequest(interface, entry->ipAddr, &MAC_BROADCAST_ADDR);
@@ -419,6 +428,74 @@ error_t arpResolve(NetInterface *interface, Ipv4Addr ipAddr, MacAddr *macAddr)
 }
 
 
+/**
+ * @brief Lockless ARP cache lookup
+ *
+ * This function may be called without holding netMutex, for instance by a
+ * task that wants to know whether a destination is already resolved. It
+ * never waits for an update in progress and never changes the cache, hence
+ * STALE entries and entries being updated are reported as not found; the
+ * caller then falls back to the regular path
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] ipAddr IPv4 address
+ * @param[out] macAddr Physical address matching the specified IPv4 address
+ * @return Error code
+ **/
+
+error_t arpLookup(NetInterface *interface, Ipv4Addr ipAddr, MacAddr *macAddr)
+{
+   uint_t n;
+   uint32_t seqNum;
+   ArpState state;
+   MacAddr addr;
+   ArpCacheEntry *entry;
+
+   //Walk the hash bucket of the address. A concurrent update may move an
+   //entry to another bucket, so the walk is bounded
+   entry = interface->arpHashTable[arpHashAddr(ipAddr)];
+
+   for(n = 0; entry != NULL && n < ARP_CACHE_SIZE; n++)
+   {
+      //Sample the sequence number before reading the entry
+      seqNum = entry->seqNum;
+      ARP_MEMORY_BARRIER();
+
+      //Matching entry?
+      if(entry->ipAddr == ipAddr)
+      {
+         //Copy the contents of the entry
+         state = entry->state;
+         addr = entry->macAddr;
+
+         //Make sure the entry was not updated in the meantime
+         ARP_MEMORY_BARRIER();
+
+         if((seqNum & 1) != 0 || entry->seqNum != seqNum)
+            return ERROR_IN_PROGRESS;
+
+         //Only resolved entries that need no state change can be used
+         if(state != ARP_STATE_REACHABLE && state != ARP_STATE_DELAY &&
+            state != ARP_STATE_PROBE && state != ARP_STATE_PERMANENT)
+         {
+            return ERROR_NOT_FOUND;
+         }
+
+         //Return the MAC address associated with the IPv4 address
+         *macAddr = addr;
+         //Successful address resolution
+         return NO_ERROR;
+      }
+
+      //Next entry in the bucket
+      entry = entry->hashNext;
+   }
+
+   //No matching entry in ARP cache
+   return ERROR_NOT_FOUND;
+}
+
+
 /**
  * @brief Enqueue an IPv4 packet waiting for address resolution
  * @param[in] interface Underlying network interface
@@ -434,9 +511,9 @@ error_t arpEnqueuePacket(NetInterface *interface, Ipv4Addr ipAddr,
    NetBuffer *buffer, size_t offset, NetTxAncillary *ancillary)
 {
    error_t error;
-   uint_t i;
    size_t length;
    ArpCacheEntry *entry;
+   ArpQueueItem *item;
 
    //Retrieve the length of the multi-part buffer
    length = netBufferGetLength(buffer);
@@ -451,45 +528,84 @@ error_t arpEnqueuePacket(NetInterface *interface, Ipv4Addr ipAddr,
       if(entry->state == ARP_STATE_INCOMPLETE)
       {
          //Check whether the packet queue is full
-         if(entry->queueSize >= ARP_MAX_PENDING_PACKETS)
+         if(entry->queueSize >= ARP_MAX_PENDING_PACKETS ||
+            interface->arpQueueFree == NULL)
          {
-            //When the queue overflows, the new arrival should replace the oldest entry
-            netBufferFree(entry->queue[0].buffer);
+            //When the queue overflows, the new arrival should replace the
+            //oldest entry
+            item = entry->queueHead;
 
-            //Make room for the new packet
-            for(i = 1; i < ARP_MAX_PENDING_PACKETS; i++)
+            //Any packet queued for this entry?
+            if(item != NULL)
             {
-               entry->queue[i - 1] = entry->queue[i];
-            }
+               //Drop the oldest packet
+               entry->queueHead = item->next;
+               entry->queueSize--;
 
-            //Adjust the number of pending packets
-            entry->queueSize--;
-         }
+               if(entry->queueHead == NULL)
+               {
+                  entry->queueTail = NULL;
+               }
 
-         //Index of the entry to be filled in
-         i = entry->queueSize;
-         //Allocate a memory buffer to store the packet
-         entry->queue[i].buffer = netBufferAlloc(length);
+               netBufferFree(item->buffer);
+            }
+         }
+         else
+         {
+            //Take an item from the shared pool
+            item = interface->arpQueueFree;
+            interface->arpQueueFree = item->next;
+         }
 
-         //Successful memory allocation?
-         if(entry->queue[i].buffer != NULL)
+         //Any queue item available?
+         if(item != NULL)
          {
-            //Copy the contents of the IPv4 packet
-            netBufferCopy(entry->queue[i].buffer, 0, buffer, 0, length);
-            //Offset to the first byte of the IPv4 header
-            entry->queue[i].offset = offset;
-            //Additional options passed to the stack along with the packet
-            entry->queue[i].ancillary = *ancillary;
-
-            //Increment the number of queued packets
-            entry->queueSize++;
-            //The packet was successfully enqueued
-            error = NO_ERROR;
+            //Allocate a memory buffer to store the packet
+            item->buffer = netBufferAlloc(length);
+
+            //Successful memory allocation?
+            if(item->buffer != NULL)
+            {
+               //Copy the contents of the IPv4 packet
+               netBufferCopy(item->buffer, 0, buffer, 0, length);
+               //Offset to the first byte of the IPv4 header
+               item->offset = offset;
+               //Additional options passed to the stack along with the packet
+               item->ancillary = *ancillary;
+
+               //Append the packet to the queue of the entry
+               item->next = NULL;
+
+               if(entry->queueTail != NULL)
+               {
+                  entry->queueTail->next = item;
+               }
+               else
+               {
+                  entry->queueHead = item;
+               }
+
+               entry->queueTail = item;
+
+               //Increment the number of queued packets
+               entry->queueSize++;
+               //The packet was successfully enqueued
+               error = NO_ERROR;
+            }
+            else
+            {
+               //Return the item to the shared pool
+               item->next = interface->arpQueueFree;
+               interface->arpQueueFree = item;
+
+               //Failed to allocate memory
+               error = ERROR_OUT_OF_MEMORY;
+            }
          }
          else
          {
-            //Failed to allocate memory
-            error = ERROR_OUT_OF_MEMORY;
+            //All the queue items are in use by other entries
+            error = ERROR_OUT_OF_RESOURCES;
          }
       }
       else
@@ -563,7 +679,7 @@ void arpTick(NetInterface *interface)
                arpFlushQueuedPackets(interface, entry);
 
                //The entry should be deleted since address resolution has failed
-               arpChangeState(entry, ARP_STATE_NONE);
+               arpDeleteEntry(interface, entry);
             }
          }
       }
@@ -623,14 +739,35 @@ void arpTick(NetInterface *interface)
             {
                //The entry should be deleted since the host is not reachable
                //anymore
-               arpChangeState(entry, ARP_STATE_NONE);
+               arpDeleteEntry(interface, entry);
             }
          }
       }
+      else if(entry->state == ARP_STATE_NONE)
+      {
+         //Unused entry
+      }
       else
       {
          //Just for sanity
-         arpChangeState(entry, ARP_STATE_NONE);
+         arpDeleteEntry(interface, entry);
+      }
+
+      //Entries waiting for a timeout need the ARP cache to be ticked again
+      if(entry->state == ARP_STATE_INCOMPLETE ||
+         entry->state == ARP_STATE_REACHABLE ||
+         entry->state == ARP_STATE_DELAY || entry->state == ARP_STATE_PROBE)
+      {
+         //Wake up when the earliest entry times out
+         if(timeCompare(entry->timestamp + entry->timeout, time) > 0)
+         {
+            netScheduleTick(NET_TICK_MODULE_ARP,
+               entry->timestamp + entry->timeout - time);
+         }
+         else
+         {
+            netScheduleTick(NET_TICK_MODULE_ARP, ARP_TICK_INTERVAL);
+         }
       }
    }
 }
@@ -873,7 +1010,7 @@ void arpProcessReply(NetInterface *interface, ArpPacket *arpReply)
       if(entry->state == ARP_STATE_INCOMPLETE)
       {
          //Record the corresponding MAC address
-         entry->macAddr = arpReply->sha;
+         arpSetMacAddr(entry, &arpReply->sha);
 
          //Send all the packets that are pending for transmission
          arpSendQueuedPackets(interface, entry);
@@ -894,9 +1031,8 @@ void arpProcessReply(NetInterface *interface, ArpPacket *arpReply)
       }
       else if(entry->state == ARP_STATE_PROBE)
       {
-         //Record IPv4/MAC address pair
-         entry->ipAddr = arpReply->spa;
-         entry->macAddr = arpReply->sha;
+         //Record the MAC address of the IPv4/MAC address pair
+         arpSetMacAddr(entry, &arpReply->sha);
 
          //The validity of the ARP entry is limited in time
          entry->timeout = interface->arpReachableTime;
@@ -1105,7 +1241,7 @@ error_t arpSendReply(NetInterface *interface, Ipv4Addr senderIpAddr,
  * @param[in] arpPacket ARP header
  **/
 
-void arpDumpPacket(const ArpPacket *arpPacket)
+__net_cold_func void arpDumpPacket(const ArpPacket *arpPacket)
 {
    //Dump ARP packet contents
    TRACE_DEBUG("  Hardware Type (hrd) = 0x%04" PRIX16 "\r\n", ntohs(arpPacket->hrd));
@@ -48,6 +48,13 @@
    #error ARP_CACHE_SIZE parameter is not valid
 #endif
 
+//Number of hash buckets of the ARP cache (power of two)
+#ifndef ARP_HASH_TABLE_SIZE
+   #define ARP_HASH_TABLE_SIZE 8
+#elif (ARP_HASH_TABLE_SIZE < 1 || (ARP_HASH_TABLE_SIZE & (ARP_HASH_TABLE_SIZE - 1)) != 0)
+   #error ARP_HASH_TABLE_SIZE parameter is not valid
+#endif
+
 //Maximum number of packets waiting for address resolution to complete
 #ifndef ARP_MAX_PENDING_PACKETS
    #define ARP_MAX_PENDING_PACKETS 2
@@ -55,6 +62,22 @@
    #error ARP_MAX_PENDING_PACKETS parameter is not valid
 #endif
 
+//Number of queue items shared by all the entries of the ARP cache
+#ifndef ARP_QUEUE_POOL_SIZE
+   #define ARP_QUEUE_POOL_SIZE 8
+#elif (ARP_QUEUE_POOL_SIZE < 1)
+   #error ARP_QUEUE_POOL_SIZE parameter is not valid
+#endif
+
+//Memory barrier used by the lockless lookup
+#ifndef ARP_MEMORY_BARRIER
+   #if defined(__GNUC__) || defined(__clang__)
+      #define ARP_MEMORY_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+   #else
+      #define ARP_MEMORY_BARRIER()
+   #endif
+#endif
+
 //Maximum number of times that an ARP request will be retransmitted
 #ifndef ARP_MAX_REQUESTS
    #define ARP_MAX_REQUESTS 3
@@ -173,28 +196,37 @@ typedef __packed_struct
  * @brief ARP queue item
  **/
 
-typedef struct
+typedef struct _ArpQueueItem
 {
-   NetBuffer *buffer;        ///<Packet waiting for address resolution
-   size_t offset;            ///<Offset to the first byte of the packet
-   NetTxAncillary ancillary; ///<Additional options
+   struct _ArpQueueItem *next; ///<Next queued packet (or next free item)
+   NetBuffer *buffer;          ///<Packet waiting for address resolution
+   size_t offset;              ///<Offset to the first byte of the packet
+   NetTxAncillary ancillary;   ///<Additional options
 } ArpQueueItem;
 
 
 /**
  * @brief ARP cache entry
+ *
+ * Entries are chained in the hash bucket of their IPv4 address. The
+ * sequence number is odd while the address pair or the state is being
+ * updated, which lets arpLookup() read the entry without netMutex
  **/
 
-typedef struct
+typedef struct _ArpCacheEntry
 {
-   ArpState state;                              ///<Reachability state
-   Ipv4Addr ipAddr;                             ///<Unicast IPv4 address
-   MacAddr macAddr;                             ///<Link layer address associated with the IPv4 address
-   systime_t timestamp;                         ///<Timestamp to manage entry lifetime
-   systime_t timeout;                           ///<Timeout value
-   uint_t retransmitCount;                      ///<Retransmission counter
-   ArpQueueItem queue[ARP_MAX_PENDING_PACKETS]; ///<Packets waiting for address resolution to complete
-   uint_t queueSize;                            ///<Number of queued packets
+   ArpState state;                      ///<Reachability state
+   Ipv4Addr ipAddr;                     ///<Unicast IPv4 address
+   MacAddr macAddr;                     ///<Link layer address associated with the IPv4 address
+   volatile uint32_t seqNum;            ///<Update sequence number
+   struct _ArpCacheEntry *hashNext;     ///<Next entry in the same hash bucket
+   systime_t timestamp;                 ///<Timestamp to manage entry lifetime
+   systime_t timeout;                   ///<Timeout value
+   systime_t lastUsed;                  ///<Time of the last successful resolution, for LRU eviction
+   uint_t retransmitCount;              ///<Retransmission counter
+   ArpQueueItem *queueHead;             ///<Oldest packet waiting for address resolution to complete
+   ArpQueueItem *queueTail;             ///<Most recent packet waiting for address resolution
+   uint_t queueSize;                    ///<Number of queued packets
 } ArpCacheEntry;
 
 
@@ -214,6 +246,7 @@ error_t arpAddStaticEntry(NetInterface *interface, Ipv4Addr ipAddr,
 error_t arpRemoveStaticEntry(NetInterface *interface, Ipv4Addr ipAddr);
 
 error_t arpResolve(NetInterface *interface, Ipv4Addr ipAddr, MacAddr *macAddr);
+error_t arpLookup(NetInterface *interface, Ipv4Addr ipAddr, MacAddr *macAddr);
 
 error_t arpEnqueuePacket(NetInterface *interface, Ipv4Addr ipAddr,
    NetBuffer *buffer, size_t offset, NetTxAncillary *ancillary);
@@ -46,6 +46,26 @@
 #if (IPV4_SUPPORT == ENABLED && ETH_SUPPORT == ENABLED)
 
 
+/**
+ * @brief Compute the hash bucket of an IPv4 address
+ * @param[in] ipAddr IPv4 address
+ * @return Index of the hash bucket
+ **/
+
+uint_t arpHashAddr(Ipv4Addr ipAddr)
+{
+   uint32_t h;
+
+   //Fold the address so that every byte contributes to the index, hosts of
+   //the same subnet differing only in the last bytes
+   h = ipAddr ^ (ipAddr >> 16);
+   h ^= h >> 8;
+
+   //Return the index of the hash bucket
+   return h & (ARP_HASH_TABLE_SIZE - 1);
+}
+
+
 /**
  * @brief Update ARP cache entry state
  * @param[in] entry Pointer to a ARP cache entry
@@ -58,22 +78,67 @@ void arpChangeState(ArpCacheEntry *entry, ArpState newState)
    ARP_CHANGE_STATE_HOOK(entry, newState);
 #endif
 
+   //Lockless readers must not use the entry while it is updated
+   entry->seqNum++;
+   ARP_MEMORY_BARRIER();
+
    //Save current time
    entry->timestamp = osGetSystemTime();
    //Switch to the new state
    entry->state = newState;
+
+   //The entry is consistent again
+   ARP_MEMORY_BARRIER();
+   entry->seqNum++;
+
+   //States that time out need the ARP cache to be ticked
+   if(newState == ARP_STATE_INCOMPLETE || newState == ARP_STATE_REACHABLE ||
+      newState == ARP_STATE_DELAY || newState == ARP_STATE_PROBE)
+   {
+      netScheduleTick(NET_TICK_MODULE_ARP, ARP_TICK_INTERVAL);
+   }
+
+   //Routes through this neighbor must be resolved again
+   netInvalidateRoutes();
+}
+
+
+/**
+ * @brief Update the link-layer address of an ARP cache entry
+ * @param[in] entry Pointer to a ARP cache entry
+ * @param[in] macAddr MAC address associated with the IPv4 address
+ **/
+
+void arpSetMacAddr(ArpCacheEntry *entry, const MacAddr *macAddr)
+{
+   //Lockless readers must not use the entry while it is updated
+   entry->seqNum++;
+   ARP_MEMORY_BARRIER();
+
+   //Record the MAC address
+   entry->macAddr = *macAddr;
+
+   //The entry is consistent again
+   ARP_MEMORY_BARRIER();
+   entry->seqNum++;
+
+   //Routes through this neighbor must be resolved again
+   netInvalidateRoutes();
 }
 
 
 /**
  * @brief Create a new entry in the ARP cache
  * @param[in] interface Underlying network interface
+ * @param[in] ipAddr IPv4 address of the entry
  * @return Pointer to the newly created entry
  **/
 
-ArpCacheEntry *arpCreateEntry(NetInterface *interface)
+ArpCacheEntry *arpCreateEntry(NetInterface *interface, Ipv4Addr ipAddr)
 {
    uint_t i;
+   uint_t index;
+   uint32_t seqNum;
    systime_t time;
    ArpCacheEntry *entry;
    ArpCacheEntry *oldestEntry;
@@ -81,7 +146,7 @@ ArpCacheEntry *arpCreateEntry(NetInterface *interface)
    //Get current time
    time = osGetSystemTime();
 
-   //Keep track of the oldest entry
+   //Keep track of the least recently used entry
    oldestEntry = NULL;
 
    //Loop through ARP cache entries
@@ -93,11 +158,9 @@ ArpCacheEntry *arpCreateEntry(NetInterface *interface)
       //Check the state of the ARP entry
       if(entry->state == ARP_STATE_NONE)
       {
-         //Initialize ARP entry
-         osMemset(entry, 0, sizeof(ArpCacheEntry));
-
-         //Return a pointer to the ARP entry
-         return entry;
+         //Free entry found
+         oldestEntry = entry;
+         break;
       }
       else if(entry->state == ARP_STATE_PERMANENT)
       {
@@ -105,7 +168,7 @@ ArpCacheEntry *arpCreateEntry(NetInterface *interface)
       }
       else
       {
-         //Keep track of the oldest entry in the table
+         //Stale entries are evicted first, then the least recently used one
          if(oldestEntry == NULL)
          {
             oldestEntry = entry;
@@ -119,7 +182,7 @@ ArpCacheEntry *arpCreateEntry(NetInterface *interface)
             oldestEntry->state == ARP_STATE_STALE)
          {
          }
-         else if((time - entry->timestamp) > (time - oldestEntry->timestamp))
+         else if((time - entry->lastUsed) > (time - oldestEntry->lastUsed))
          {
             oldestEntry = entry;
          }
@@ -129,22 +192,76 @@ ArpCacheEntry *arpCreateEntry(NetInterface *interface)
       }
    }
 
-   //Any entry available in the ARP cache?
-   if(oldestEntry != NULL)
+   //The ARP cache is full of static entries?
+   if(oldestEntry == NULL)
+      return NULL;
+
+   //The least recently used entry is removed whenever the table runs out
+   //of space
+   if(oldestEntry->state != ARP_STATE_NONE)
    {
       //Drop any pending packets
       arpFlushQueuedPackets(interface, oldestEntry);
-      //The oldest entry is removed whenever the table runs out of space
-      arpChangeState(oldestEntry, ARP_STATE_NONE);
-      //Initialize ARP entry
-      osMemset(oldestEntry, 0, sizeof(ArpCacheEntry));
+      //Delete the entry
+      arpDeleteEntry(interface, oldestEntry);
    }
 
+   //Lockless readers must not use the entry while it is updated
+   seqNum = oldestEntry->seqNum + 1;
+   oldestEntry->seqNum = seqNum;
+   ARP_MEMORY_BARRIER();
+
+   //Initialize ARP entry
+   osMemset(oldestEntry, 0, sizeof(ArpCacheEntry));
+   oldestEntry->seqNum = seqNum;
+   oldestEntry->ipAddr = ipAddr;
+   oldestEntry->lastUsed = time;
+
+   //Insert the entry at the head of its hash bucket
+   index = arpHashAddr(ipAddr);
+   oldestEntry->hashNext = interface->arpHashTable[index];
+
+   //The entry is consistent again
+   ARP_MEMORY_BARRIER();
+   oldestEntry->seqNum = seqNum + 1;
+
+   //Make the entry visible to lockless readers
+   interface->arpHashTable[index] = oldestEntry;
+
    //Return a pointer to the ARP entry
    return oldestEntry;
 }
 
 
+/**
+ * @brief Delete an entry from the ARP cache
+ * @param[in] interface Underlying network interface
+ * @param[in] entry Pointer to a ARP cache entry
+ **/
+
+void arpDeleteEntry(NetInterface *interface, ArpCacheEntry *entry)
+{
+   ArpCacheEntry **p;
+
+   //Search the hash bucket for the entry
+   for(p = &interface->arpHashTable[arpHashAddr(entry->ipAddr)]; *p != NULL;
+      p = &(*p)->hashNext)
+   {
+      //Matching entry?
+      if(*p == entry)
+      {
+         //Unlink the entry. Its own link is left untouched, so that a
+         //lockless reader standing on it can still reach the next one
+         *p = entry->hashNext;
+         break;
+      }
+   }
+
+   //The entry is now free
+   arpChangeState(entry, ARP_STATE_NONE);
+}
+
+
 /**
  * @brief Search the ARP cache for a given IPv4 address
  * @param[in] interface Underlying network interface
@@ -155,23 +272,16 @@ ArpCacheEntry *arpCreateEntry(NetInterface *interface)
 
 ArpCacheEntry *arpFindEntry(NetInterface *interface, Ipv4Addr ipAddr)
 {
-   uint_t i;
    ArpCacheEntry *entry;
 
-   //Loop through ARP cache entries
-   for(i = 0; i < ARP_CACHE_SIZE; i++)
+   //Walk the hash bucket of the address
+   for(entry = interface->arpHashTable[arpHashAddr(ipAddr)]; entry != NULL;
+      entry = entry->hashNext)
    {
-      //Point to the current entry
-      entry = &interface->arpCache[i];
-
-      //Check whether the entry is currently in use
-      if(entry->state != ARP_STATE_NONE)
+      //Current entry matches the specified address?
+      if(entry->state != ARP_STATE_NONE && entry->ipAddr == ipAddr)
       {
-         //Current entry matches the specified address?
-         if(entry->ipAddr == ipAddr)
-         {
-            return entry;
-         }
+         return entry;
       }
    }
 
@@ -201,13 +311,17 @@ void arpFlushCache(NetInterface *interface)
       {
          //Static ARP entries are never updated
       }
-      else
+      else if(entry->state != ARP_STATE_NONE)
       {
          //Drop packets that are waiting for address resolution
          arpFlushQueuedPackets(interface, entry);
 
          //Delete ARP entry
-         arpChangeState(entry, ARP_STATE_NONE);
+         arpDeleteEntry(interface, entry);
+      }
+      else
+      {
+         //Unused entry
       }
    }
 }
@@ -221,19 +335,19 @@ void arpFlushCache(NetInterface *interface)
 
 void arpSendQueuedPackets(NetInterface *interface, ArpCacheEntry *entry)
 {
-   uint_t i;
    size_t length;
    ArpQueueItem *item;
 
-   //Check the state of the ARP entry
-   if(entry->state == ARP_STATE_INCOMPLETE)
+   //Loop through the queued packets, oldest first
+   while(entry->queueHead != NULL)
    {
-      //Loop through the queued packets
-      for(i = 0; i < entry->queueSize; i++)
-      {
-         //Point to the current queue item
-         item = &entry->queue[i];
+      //Remove the oldest packet from the queue
+      item = entry->queueHead;
+      entry->queueHead = item->next;
 
+      //Check the state of the ARP entry
+      if(entry->state == ARP_STATE_INCOMPLETE)
+      {
          //Retrieve the length of the IPv4 packet
          length = netBufferGetLength(item->buffer) - item->offset;
          //Update IP statistics
@@ -242,13 +356,18 @@ void arpSendQueuedPackets(NetInterface *interface, ArpCacheEntry *entry)
          //Send the IPv4 packet
          ethSendFrame(interface, &entry->macAddr, ETH_TYPE_IPV4, item->buffer,
             item->offset, &item->ancillary);
-
-         //Release memory buffer
-         netBufferFree(item->buffer);
       }
+
+      //Release memory buffer
+      netBufferFree(item->buffer);
+
+      //Return the item to the shared pool
+      item->next = interface->arpQueueFree;
+      interface->arpQueueFree = item;
    }
 
    //The queue is now empty
+   entry->queueTail = NULL;
    entry->queueSize = 0;
 }
 
@@ -261,20 +380,25 @@ void arpSendQueuedPackets(NetInterface *interface, ArpCacheEntry *entry)
 
 void arpFlushQueuedPackets(NetInterface *interface, ArpCacheEntry *entry)
 {
-   uint_t i;
+   ArpQueueItem *item;
 
-   //Check the state of the ARP entry
-   if(entry->state == ARP_STATE_INCOMPLETE)
+   //Drop packets that are waiting for address resolution
+   while(entry->queueHead != NULL)
    {
-      //Drop packets that are waiting for address resolution
-      for(i = 0; i < entry->queueSize; i++)
-      {
-         //Release memory buffer
-         netBufferFree(entry->queue[i].buffer);
-      }
+      //Remove the oldest packet from the queue
+      item = entry->queueHead;
+      entry->queueHead = item->next;
+
+      //Release memory buffer
+      netBufferFree(item->buffer);
+
+      //Return the item to the shared pool
+      item->next = interface->arpQueueFree;
+      interface->arpQueueFree = item;
    }
 
    //The queue is now empty
+   entry->queueTail = NULL;
    entry->queueSize = 0;
 }
 
@@ -41,9 +41,13 @@ extern "C" {
 #endif
 
 //ARP related functions
+uint_t arpHashAddr(Ipv4Addr ipAddr);
+
 void arpChangeState(ArpCacheEntry *entry, ArpState newState);
+void arpSetMacAddr(ArpCacheEntry *entry, const MacAddr *macAddr);
 
-ArpCacheEntry *arpCreateEntry(NetInterface *interface);
+ArpCacheEntry *arpCreateEntry(NetInterface *interface, Ipv4Addr ipAddr);
+void arpDeleteEntry(NetInterface *interface, ArpCacheEntry *entry);
 ArpCacheEntry *arpFindEntry(NetInterface *interface, Ipv4Addr ipAddr);
 
 void arpFlushCache(NetInterface *interface);
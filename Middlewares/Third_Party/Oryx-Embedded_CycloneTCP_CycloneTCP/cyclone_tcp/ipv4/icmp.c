@@ -36,6 +36,7 @@
 #include "core/ip.h"
 #include "ipv4/ipv4.h"
 #include "ipv4/ipv4_misc.h"
+#include "ipv4/ipv4_pmtu.h"
 #include "ipv4/icmp.h"
 #include "mibs/mib2_module.h"
 #include "mibs/ip_mib_module.h"
@@ -44,6 +45,31 @@
 //Check TCP/IP stack configuration
 #if (IPV4_SUPPORT == ENABLED)
 
+//Receiver of the Echo Reply messages
+static IcmpEchoReplyCallback icmpEchoReplyCallback = NULL;
+static void *icmpEchoReplyParam = NULL;
+
+#if (ICMP_RATE_LIMIT_SUPPORT == ENABLED)
+
+//Token buckets of the rate-limited classes, initially full
+static IcmpRateBucket icmpRateBuckets[ICMP_RATE_CLASS_COUNT] =
+{
+   {ICMP_ECHO_RATE_LIMIT, ICMP_ECHO_RATE_BURST, ICMP_ECHO_RATE_BURST * 1000, 0, 0, 0},
+   {ICMP_ERROR_RATE_LIMIT, ICMP_ERROR_RATE_BURST, ICMP_ERROR_RATE_BURST * 1000, 0, 0, 0},
+   {ICMP_ERROR_RATE_LIMIT, ICMP_ERROR_RATE_BURST, ICMP_ERROR_RATE_BURST * 1000, 0, 0, 0},
+   {ICMP_ERROR_RATE_LIMIT, ICMP_ERROR_RATE_BURST, ICMP_ERROR_RATE_BURST * 1000, 0, 0, 0},
+   {ICMP_SOURCE_RATE_LIMIT, ICMP_SOURCE_RATE_BURST, 0, 0, 0, 0}
+};
+
+//Token buckets of the most recent sources
+static IcmpRateSource icmpRateSources[ICMP_RATE_LIMIT_SOURCE_COUNT];
+
+//Forward declaration of functions
+static void icmpRefillTokens(uint32_t rate, uint32_t burst, uint32_t *credit,
+   systime_t *timestamp, systime_t time);
+
+#endif
+
 
 /**
  * @brief Enable support for ICMP Echo Request messages
@@ -172,6 +198,24 @@ void icmpProcessMessage(NetInterface *interface,
       icmpProcessEchoRequest(interface, requestPseudoHeader, buffer, offset);
       break;
 
+   //Echo Reply?
+   case ICMP_TYPE_ECHO_REPLY:
+      //Process Echo Reply message
+      icmpProcessEchoReply(interface, requestPseudoHeader, buffer, offset);
+      break;
+
+#if (IPV4_PMTU_SUPPORT == ENABLED)
+   //Destination Unreachable?
+   case ICMP_TYPE_DEST_UNREACHABLE:
+      //Routers report the next-hop MTU when a datagram with DF set is too
+      //large to be forwarded
+      if(header->code == ICMP_CODE_FRAG_NEEDED_AND_DF_SET)
+      {
+         ipv4ProcessFragNeeded(interface, buffer, offset);
+      }
+      break;
+#endif
+
    //Unknown type?
    default:
       //Debug message
@@ -255,6 +299,13 @@ void icmpProcessEchoRequest(NetInterface *interface,
       replyPseudoHeader.srcAddr = requestPseudoHeader->destAddr;
    }
 
+#if (ICMP_RATE_LIMIT_SUPPORT == ENABLED)
+   //Drop the request when the replies exceed their rate, so that a flood
+   //cannot use up the buffers and the transmit ring
+   if(!icmpCheckRateLimit(ICMP_TYPE_ECHO_REPLY, requestPseudoHeader->srcAddr))
+      return;
+#endif
+
    //Allocate memory to hold the Echo Reply message
    reply = ipAllocBuffer(sizeof(IcmpEchoMessage), &replyOffset);
    //Failed to allocate memory?
@@ -294,8 +345,17 @@ void icmpProcessEchoRequest(NetInterface *interface,
 
       //Get the length of the resulting message
       replyLength = netBufferGetLength(reply) - replyOffset;
-      //Calculate ICMP header checksum
-      replyHeader->checksum = ipCalcChecksumEx(reply, replyOffset, replyLength);
+      //The checksum is inserted by the NIC when offload is active
+      if(ipv4IsChecksumOffloadEnabled(interface, replyLength))
+      {
+         replyHeader->checksum = 0;
+      }
+      else
+      {
+         //Calculate ICMP header checksum
+         replyHeader->checksum = ipCalcChecksumEx(reply, replyOffset,
+            replyLength);
+      }
 
       //Format IPv4 pseudo header
       replyPseudoHeader.destAddr = requestPseudoHeader->srcAddr;
@@ -324,6 +384,164 @@ void icmpProcessEchoRequest(NetInterface *interface,
 }
 
 
+/**
+ * @brief Register the receiver of the Echo Reply messages
+ *
+ * The callback is invoked by the TCP/IP stack, with netMutex held, for each
+ * Echo Reply message received. It must not block
+ *
+ * @param[in] callback Callback function, NULL to stop receiving
+ * @param[in] param Opaque pointer passed to the callback
+ * @return Error code
+ **/
+
+error_t icmpRegisterEchoReplyCallback(IcmpEchoReplyCallback callback,
+   void *param)
+{
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Save the callback function
+   icmpEchoReplyCallback = callback;
+   icmpEchoReplyParam = param;
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Echo Reply message processing
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader IPv4 pseudo header
+ * @param[in] buffer Multi-part buffer containing the incoming Echo Reply message
+ * @param[in] offset Offset to the first byte of the Echo Reply message
+ **/
+
+void icmpProcessEchoReply(NetInterface *interface,
+   const Ipv4PseudoHeader *pseudoHeader, const NetBuffer *buffer,
+   size_t offset)
+{
+   size_t length;
+   IcmpEchoMessage *header;
+
+   //No receiver registered?
+   if(icmpEchoReplyCallback == NULL)
+      return;
+
+   //Retrieve the length of the Echo Reply message
+   length = netBufferGetLength(buffer) - offset;
+
+   //Ensure the packet length is correct
+   if(length < sizeof(IcmpEchoMessage))
+      return;
+
+   //Point to the Echo Reply header
+   header = netBufferAt(buffer, offset, sizeof(IcmpEchoMessage));
+   //Sanity check
+   if(header == NULL)
+      return;
+
+   //Hand the identifier and sequence number over to the receiver
+   icmpEchoReplyCallback(interface, pseudoHeader->srcAddr,
+      ntohs(header->identifier), ntohs(header->sequenceNumber),
+      icmpEchoReplyParam);
+}
+
+
+/**
+ * @brief Send an ICMP Echo Request message
+ *
+ * Unlike pingSendRequest(), no socket is used: the request is handed to the
+ * IPv4 layer directly, and the reply goes to the callback registered with
+ * icmpRegisterEchoReplyCallback(). The caller must hold netMutex
+ *
+ * @param[in] interface Underlying network interface, NULL to select it from
+ *   the destination address
+ * @param[in] destIpAddr IPv4 address of the host to reach
+ * @param[in] identifier Identifier field
+ * @param[in] sequenceNumber Sequence Number field
+ * @param[in] data Data payload, may be NULL if length is 0
+ * @param[in] length Size of the data payload, in bytes
+ * @return Error code
+ **/
+
+error_t icmpSendEchoRequest(NetInterface *interface, Ipv4Addr destIpAddr,
+   uint16_t identifier, uint16_t sequenceNumber, const void *data,
+   size_t length)
+{
+   error_t error;
+   size_t offset;
+   Ipv4Addr srcIpAddr;
+   NetBuffer *buffer;
+   IcmpEchoMessage *message;
+   Ipv4PseudoHeader pseudoHeader;
+   NetTxAncillary ancillary;
+
+   //Select the source address and the relevant network interface
+   error = ipv4SelectSourceAddr(&interface, destIpAddr, &srcIpAddr);
+   //Any error to report?
+   if(error)
+      return error;
+
+   //Allocate memory to hold the Echo Request message
+   buffer = ipAllocBuffer(sizeof(IcmpEchoMessage) + length, &offset);
+   //Failed to allocate memory?
+   if(buffer == NULL)
+      return ERROR_OUT_OF_MEMORY;
+
+   //Point to the Echo Request header
+   message = netBufferAt(buffer, offset, 0);
+
+   //Format Echo Request message
+   message->type = ICMP_TYPE_ECHO_REQUEST;
+   message->code = 0;
+   message->checksum = 0;
+   message->identifier = htons(identifier);
+   message->sequenceNumber = htons(sequenceNumber);
+
+   //Copy the data payload
+   if(length > 0)
+   {
+      osMemcpy(message->data, data, length);
+   }
+
+   //Length of the complete ICMP message including header and data
+   length += sizeof(IcmpEchoMessage);
+
+   //The checksum is inserted by the NIC when offload is active
+   if(!ipv4IsChecksumOffloadEnabled(interface, length))
+   {
+      //Message checksum calculation
+      message->checksum = ipCalcChecksum(message, length);
+   }
+
+   //Format IPv4 pseudo header
+   pseudoHeader.srcAddr = srcIpAddr;
+   pseudoHeader.destAddr = destIpAddr;
+   pseudoHeader.reserved = 0;
+   pseudoHeader.protocol = IPV4_PROTOCOL_ICMP;
+   pseudoHeader.length = htons(length);
+
+   //Update ICMP statistics
+   icmpUpdateOutStats(ICMP_TYPE_ECHO_REQUEST);
+
+   //Additional options can be passed to the stack along with the packet
+   ancillary = NET_DEFAULT_TX_ANCILLARY;
+
+   //Send Echo Request message
+   error = ipv4SendDatagram(interface, &pseudoHeader, buffer, offset,
+      &ancillary);
+
+   //Free previously allocated memory block
+   netBufferFree(buffer);
+
+   //Return status code
+   return error;
+}
+
+
 /**
  * @brief Send an ICMP Error message
  * @param[in] interface Underlying network interface
@@ -335,7 +553,7 @@ void icmpProcessEchoRequest(NetInterface *interface,
  * @return Error code
  **/
 
-error_t icmpSendErrorMessage(NetInterface *interface, uint8_t type,
+__net_cold_func error_t icmpSendErrorMessage(NetInterface *interface, uint8_t type,
    uint8_t code, uint8_t parameter, const NetBuffer *ipPacket,
    size_t ipPacketOffset)
 {
@@ -396,6 +614,13 @@ error_t icmpSendErrorMessage(NetInterface *interface, uint8_t type,
       return ERROR_INVALID_ADDRESS;
    }
 
+#if (ICMP_RATE_LIMIT_SUPPORT == ENABLED)
+   //Limit the rate at which error messages are originated (refer to
+   //RFC 1812, section 4.3.2.8)
+   if(!icmpCheckRateLimit(type, ipHeader->srcAddr))
+      return ERROR_OUT_OF_RESOURCES;
+#endif
+
    //Length of the data that will be returned along with the ICMP header
    length = MIN(length, (size_t) ipHeader->headerLength * 4 + 8);
 
@@ -425,8 +650,16 @@ error_t icmpSendErrorMessage(NetInterface *interface, uint8_t type,
    {
       //Get the length of the resulting message
       length = netBufferGetLength(icmpMessage) - offset;
-      //Message checksum calculation
-      icmpHeader->checksum = ipCalcChecksumEx(icmpMessage, offset, length);
+      //The checksum is inserted by the NIC when offload is active
+      if(ipv4IsChecksumOffloadEnabled(interface, length))
+      {
+         icmpHeader->checksum = 0;
+      }
+      else
+      {
+         //Message checksum calculation
+         icmpHeader->checksum = ipCalcChecksumEx(icmpMessage, offset, length);
+      }
 
       //Check whether the destination address of the invoking packet matches a
       //valid unicast address assigned to the interface
@@ -481,6 +714,285 @@ error_t icmpSendErrorMessage(NetInterface *interface, uint8_t type,
 }
 
 
+#if (ICMP_RATE_LIMIT_SUPPORT == ENABLED)
+
+/**
+ * @brief Set the rate limit of a class of messages
+ * @param[in] rateClass Class of messages. ICMP_RATE_CLASS_SOURCE sets the
+ *   limit applied to each source
+ * @param[in] rate Messages per second (0 for no limit)
+ * @param[in] burst Largest burst of messages
+ * @return Error code
+ **/
+
+error_t icmpSetRateLimit(IcmpRateClass rateClass, uint32_t rate,
+   uint32_t burst)
+{
+   uint_t i;
+
+   //Check parameters
+   if(rateClass >= ICMP_RATE_CLASS_COUNT || burst < 1 || burst > 65535)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Save the new limit
+   icmpRateBuckets[rateClass].rate = rate;
+   icmpRateBuckets[rateClass].burst = burst;
+
+   //Start again from a full bucket
+   if(rateClass == ICMP_RATE_CLASS_SOURCE)
+   {
+      //Forget the sources seen so far
+      for(i = 0; i < ICMP_RATE_LIMIT_SOURCE_COUNT; i++)
+      {
+         icmpRateSources[i].addr = IPV4_UNSPECIFIED_ADDR;
+      }
+   }
+   else
+   {
+      icmpRateBuckets[rateClass].credit = burst * 1000;
+      icmpRateBuckets[rateClass].timestamp = osGetSystemTime();
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Get the limit and the counters of a class of messages
+ * @param[in] rateClass Class of messages
+ * @param[out] info Limit and counters of the class
+ * @return Error code
+ **/
+
+error_t icmpGetRateLimitInfo(IcmpRateClass rateClass, IcmpRateBucket *info)
+{
+   //Check parameters
+   if(rateClass >= ICMP_RATE_CLASS_COUNT || info == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Copy the bucket
+   *info = icmpRateBuckets[rateClass];
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Consume a token before sending an ICMP message
+ *
+ * A message is sent only if both the bucket of its type and the bucket of
+ * its destination hold a token; the tokens are then taken from both. The
+ * sources are tracked in a small table, a new source replacing the one whose
+ * bucket is full or, failing that, the one seen least recently
+ *
+ * @param[in] type ICMP message type
+ * @param[in] destAddr Destination of the message, i.e. the source of the
+ *   invoking packet
+ * @return TRUE if the message can be sent, FALSE if it must be suppressed
+ **/
+
+bool_t icmpCheckRateLimit(uint8_t type, Ipv4Addr destAddr)
+{
+   uint_t i;
+   systime_t time;
+   IcmpRateBucket *bucket;
+   IcmpRateBucket *sourceBucket;
+   IcmpRateSource *source;
+   IcmpRateSource *entry;
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //Select the bucket of the message
+   if(type == ICMP_TYPE_ECHO_REPLY)
+   {
+      bucket = &icmpRateBuckets[ICMP_RATE_CLASS_ECHO_REPLY];
+   }
+   else if(type == ICMP_TYPE_DEST_UNREACHABLE)
+   {
+      bucket = &icmpRateBuckets[ICMP_RATE_CLASS_DEST_UNREACHABLE];
+   }
+   else if(type == ICMP_TYPE_TIME_EXCEEDED)
+   {
+      bucket = &icmpRateBuckets[ICMP_RATE_CLASS_TIME_EXCEEDED];
+   }
+   else
+   {
+      bucket = &icmpRateBuckets[ICMP_RATE_CLASS_OTHER_ERROR];
+   }
+
+   //Point to the per-source limit
+   sourceBucket = &icmpRateBuckets[ICMP_RATE_CLASS_SOURCE];
+   source = NULL;
+
+   //Any per-source limit?
+   if(sourceBucket->rate != 0)
+   {
+      //Look for the source in the table
+      for(i = 0; i < ICMP_RATE_LIMIT_SOURCE_COUNT; i++)
+      {
+         //Point to the current entry
+         entry = &icmpRateSources[i];
+
+         //Matching entry?
+         if(entry->addr == destAddr)
+         {
+            source = entry;
+            break;
+         }
+      }
+
+      //Unknown source?
+      if(source == NULL)
+      {
+         //Replace a free entry, an entry whose bucket has refilled, or the
+         //least recently updated entry
+         for(i = 0; i < ICMP_RATE_LIMIT_SOURCE_COUNT; i++)
+         {
+            //Point to the current entry
+            entry = &icmpRateSources[i];
+
+            //Free entry?
+            if(entry->addr == IPV4_UNSPECIFIED_ADDR)
+            {
+               source = entry;
+               break;
+            }
+
+            //Bring the bucket up to date
+            icmpRefillTokens(sourceBucket->rate, sourceBucket->burst,
+               &entry->credit, &entry->timestamp, time);
+
+            //Full bucket?
+            if(entry->credit >= sourceBucket->burst * 1000)
+            {
+               source = entry;
+               break;
+            }
+
+            //Keep track of the least recently updated entry
+            if(source == NULL || timeCompare(entry->timestamp,
+               source->timestamp) < 0)
+            {
+               source = entry;
+            }
+         }
+
+         //The new source starts with a full bucket
+         source->addr = destAddr;
+         source->credit = sourceBucket->burst * 1000;
+         source->timestamp = time;
+      }
+      else
+      {
+         //Bring the bucket of the source up to date
+         icmpRefillTokens(sourceBucket->rate, sourceBucket->burst,
+            &source->credit, &source->timestamp, time);
+      }
+   }
+
+   //Bring the bucket of the message type up to date
+   if(bucket->rate != 0)
+   {
+      icmpRefillTokens(bucket->rate, bucket->burst, &bucket->credit,
+         &bucket->timestamp, time);
+   }
+
+   //The message type has exceeded its rate?
+   if(bucket->rate != 0 && bucket->credit < 1000)
+   {
+      bucket->limited++;
+      return FALSE;
+   }
+
+   //The destination has exceeded its rate?
+   if(source != NULL && source->credit < 1000)
+   {
+      sourceBucket->limited++;
+      return FALSE;
+   }
+
+   //Take a token from both buckets
+   if(bucket->rate != 0)
+   {
+      bucket->credit -= 1000;
+   }
+
+   if(source != NULL)
+   {
+      source->credit -= 1000;
+      sourceBucket->sent++;
+   }
+
+   //The message can be sent
+   bucket->sent++;
+
+   return TRUE;
+}
+
+
+/**
+ * @brief Check whether a class of messages is rate-limited
+ * @param[in] rateClass Class of messages
+ * @return TRUE if a limit applies to the class, else FALSE
+ **/
+
+bool_t icmpIsRateLimited(IcmpRateClass rateClass)
+{
+   //Check parameter
+   if(rateClass >= ICMP_RATE_CLASS_COUNT)
+      return FALSE;
+
+   //The per-source limit also applies to the Echo Reply messages
+   if(rateClass == ICMP_RATE_CLASS_ECHO_REPLY &&
+      icmpRateBuckets[ICMP_RATE_CLASS_SOURCE].rate != 0)
+   {
+      return TRUE;
+   }
+
+   //A zero rate means no limit
+   return (icmpRateBuckets[rateClass].rate != 0) ? TRUE : FALSE;
+}
+
+
+/**
+ * @brief Add the tokens accumulated since the last refill
+ * @param[in] rate Messages per second
+ * @param[in] burst Depth of the bucket, in messages
+ * @param[in,out] credit Available tokens, in thousandths of a message
+ * @param[in,out] timestamp Time of the last refill
+ * @param[in] time Current time
+ **/
+
+static void icmpRefillTokens(uint32_t rate, uint32_t burst, uint32_t *credit,
+   systime_t *timestamp, systime_t time)
+{
+   uint64_t n;
+
+   //A system tick is one millisecond, and the rate is given in messages
+   //per second, i.e. thousandths of a message per millisecond
+   n = (uint64_t) (time - *timestamp) * rate + *credit;
+
+   //The bucket cannot hold more than a burst
+   *credit = (uint32_t) MIN(n, (uint64_t) burst * 1000);
+   *timestamp = time;
+}
+
+#endif
+
+
 /**
  * @brief Update ICMP input statistics
  * @param[in] type ICMP message type
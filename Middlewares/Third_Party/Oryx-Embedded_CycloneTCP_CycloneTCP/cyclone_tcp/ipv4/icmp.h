@@ -48,6 +48,62 @@
    #error ICMP_QUERY_ID_MAX parameter is not valid
 #endif
 
+//Rate limiting of the Echo Reply and error messages
+#ifndef ICMP_RATE_LIMIT_SUPPORT
+   #define ICMP_RATE_LIMIT_SUPPORT DISABLED
+#elif (ICMP_RATE_LIMIT_SUPPORT != ENABLED && ICMP_RATE_LIMIT_SUPPORT != DISABLED)
+   #error ICMP_RATE_LIMIT_SUPPORT parameter is not valid
+#endif
+
+//Number of sources whose messages are limited individually
+#ifndef ICMP_RATE_LIMIT_SOURCE_COUNT
+   #define ICMP_RATE_LIMIT_SOURCE_COUNT 16
+#elif (ICMP_RATE_LIMIT_SOURCE_COUNT < 1)
+   #error ICMP_RATE_LIMIT_SOURCE_COUNT parameter is not valid
+#endif
+
+//Echo Reply messages per second (0 for no limit)
+#ifndef ICMP_ECHO_RATE_LIMIT
+   #define ICMP_ECHO_RATE_LIMIT 500
+#elif (ICMP_ECHO_RATE_LIMIT < 0)
+   #error ICMP_ECHO_RATE_LIMIT parameter is not valid
+#endif
+
+//Largest burst of Echo Reply messages
+#ifndef ICMP_ECHO_RATE_BURST
+   #define ICMP_ECHO_RATE_BURST 50
+#elif (ICMP_ECHO_RATE_BURST < 1)
+   #error ICMP_ECHO_RATE_BURST parameter is not valid
+#endif
+
+//Error messages of each type per second (0 for no limit)
+#ifndef ICMP_ERROR_RATE_LIMIT
+   #define ICMP_ERROR_RATE_LIMIT 50
+#elif (ICMP_ERROR_RATE_LIMIT < 0)
+   #error ICMP_ERROR_RATE_LIMIT parameter is not valid
+#endif
+
+//Largest burst of error messages of each type
+#ifndef ICMP_ERROR_RATE_BURST
+   #define ICMP_ERROR_RATE_BURST 10
+#elif (ICMP_ERROR_RATE_BURST < 1)
+   #error ICMP_ERROR_RATE_BURST parameter is not valid
+#endif
+
+//Messages sent to a single destination per second (0 for no limit)
+#ifndef ICMP_SOURCE_RATE_LIMIT
+   #define ICMP_SOURCE_RATE_LIMIT 100
+#elif (ICMP_SOURCE_RATE_LIMIT < 0)
+   #error ICMP_SOURCE_RATE_LIMIT parameter is not valid
+#endif
+
+//Largest burst of messages sent to a single destination
+#ifndef ICMP_SOURCE_RATE_BURST
+   #define ICMP_SOURCE_RATE_BURST 20
+#elif (ICMP_SOURCE_RATE_BURST < 1)
+   #error ICMP_SOURCE_RATE_BURST parameter is not valid
+#endif
+
 //C++ guard
 #ifdef __cplusplus
 extern "C" {
@@ -226,6 +282,61 @@ typedef __packed_struct
    #pragma pack(pop)
 #endif
 
+/**
+ * @brief Classes of rate-limited messages
+ **/
+
+typedef enum
+{
+   ICMP_RATE_CLASS_ECHO_REPLY       = 0, ///<Echo Reply messages
+   ICMP_RATE_CLASS_DEST_UNREACHABLE = 1, ///<Destination Unreachable messages
+   ICMP_RATE_CLASS_TIME_EXCEEDED    = 2, ///<Time Exceeded messages
+   ICMP_RATE_CLASS_OTHER_ERROR      = 3, ///<Parameter Problem and other messages
+   ICMP_RATE_CLASS_SOURCE           = 4, ///<Per-source limit, shared by all types
+   ICMP_RATE_CLASS_COUNT            = 5
+} IcmpRateClass;
+
+
+/**
+ * @brief Token bucket of a class of messages
+ *
+ * Tokens are messages, counted in thousandths so that low rates refill
+ * smoothly. For ICMP_RATE_CLASS_SOURCE, the rate and the burst apply to
+ * each source, and the counters to all of them
+ **/
+
+typedef struct
+{
+   uint32_t rate;       ///<Messages per second (0 for no limit)
+   uint32_t burst;      ///<Depth of the bucket, in messages
+   uint32_t credit;     ///<Available tokens, in thousandths of a message
+   systime_t timestamp; ///<Time at which the tokens were last refilled
+   uint32_t sent;       ///<Messages let through
+   uint32_t limited;    ///<Messages suppressed by this bucket
+} IcmpRateBucket;
+
+
+/**
+ * @brief Token bucket of a source
+ **/
+
+typedef struct
+{
+   Ipv4Addr addr;       ///<Address of the source (unspecified if the entry is free)
+   uint32_t credit;     ///<Available tokens, in thousandths of a message
+   systime_t timestamp; ///<Time at which the tokens were last refilled
+} IcmpRateSource;
+
+
+/**
+ * @brief Echo Reply callback
+ **/
+
+typedef void (*IcmpEchoReplyCallback)(NetInterface *interface,
+   Ipv4Addr srcIpAddr, uint16_t identifier, uint16_t sequenceNumber,
+   void *param);
+
+
 //ICMP related functions
 error_t icmpEnableEchoRequests(NetInterface *interface, bool_t enable);
 
@@ -240,10 +351,28 @@ void icmpProcessEchoRequest(NetInterface *interface,
    const Ipv4PseudoHeader *requestPseudoHeader, const NetBuffer *request,
    size_t requestOffset);
 
+error_t icmpRegisterEchoReplyCallback(IcmpEchoReplyCallback callback,
+   void *param);
+
+void icmpProcessEchoReply(NetInterface *interface,
+   const Ipv4PseudoHeader *pseudoHeader, const NetBuffer *buffer,
+   size_t offset);
+
+error_t icmpSendEchoRequest(NetInterface *interface, Ipv4Addr destIpAddr,
+   uint16_t identifier, uint16_t sequenceNumber, const void *data,
+   size_t length);
+
 error_t icmpSendErrorMessage(NetInterface *interface, uint8_t type,
    uint8_t code, uint8_t parameter, const NetBuffer *ipPacket,
    size_t ipPacketOffset);
 
+error_t icmpSetRateLimit(IcmpRateClass rateClass, uint32_t rate,
+   uint32_t burst);
+
+error_t icmpGetRateLimitInfo(IcmpRateClass rateClass, IcmpRateBucket *info);
+bool_t icmpCheckRateLimit(uint8_t type, Ipv4Addr destAddr);
+bool_t icmpIsRateLimited(IcmpRateClass rateClass);
+
 void icmpUpdateInStats(uint8_t type);
 void icmpUpdateOutStats(uint8_t type);
 
@@ -43,12 +43,15 @@
 #include "core/ip.h"
 #include "core/udp.h"
 #include "core/tcp_fsm.h"
+#include "core/tcp_gro.h"
 #include "core/raw_socket.h"
 #include "ipv4/arp_cache.h"
 #include "ipv4/ipv4.h"
 #include "ipv4/ipv4_multicast.h"
 #include "ipv4/ipv4_routing.h"
+#include "ipv4/ipv4_firewall.h"
 #include "ipv4/ipv4_misc.h"
+#include "ipv4/ipv4_pmtu.h"
 #include "ipv4/icmp.h"
 #include "ipv4/auto_ip_misc.h"
 #include "igmp/igmp_host.h"
@@ -113,6 +116,13 @@ error_t ipv4Init(NetInterface *interface)
 #if (IPV4_FRAG_SUPPORT == ENABLED)
    //Initialize the reassembly queue
    osMemset(context->fragQueue, 0, sizeof(context->fragQueue));
+   //All the descriptors are initially free
+   ipv4FlushFragQueue(interface);
+#endif
+
+#if (IPV4_PMTU_SUPPORT == ENABLED)
+   //Clear the path MTU cache
+   ipv4FlushPmtuCache(interface);
 #endif
 
    //Successful initialization
@@ -206,6 +216,9 @@ error_t ipv4SetHostAddrEx(NetInterface *interface, uint_t index, Ipv4Addr addr)
       entry->state = IPV4_ADDR_STATE_INVALID;
    }
 
+   //Source address selection must be performed again
+   netInvalidateRoutes();
+
 #if (MDNS_RESPONDER_SUPPORT == ENABLED)
    //Restart mDNS probing process
    mdnsResponderStartProbing(interface->mdnsResponderContext);
@@ -322,6 +335,8 @@ error_t ipv4SetSubnetMaskEx(NetInterface *interface, uint_t index,
    osAcquireMutex(&netMutex);
    //Set up subnet mask
    interface->ipv4Context.addrList[index].subnetMask = mask;
+   //Routes must be selected again
+   netInvalidateRoutes();
    //Release exclusive access
    osReleaseMutex(&netMutex);
 
@@ -421,6 +436,8 @@ error_t ipv4SetDefaultGatewayEx(NetInterface *interface, uint_t index,
    osAcquireMutex(&netMutex);
    //Set up default gateway address
    interface->ipv4Context.addrList[index].defaultGateway = addr;
+   //Routes must be selected again
+   netInvalidateRoutes();
    //Release exclusive access
    osReleaseMutex(&netMutex);
 
@@ -577,6 +594,11 @@ void ipv4LinkChangeEvent(NetInterface *interface)
    ipv4FlushFragQueue(interface);
 #endif
 
+#if (IPV4_PMTU_SUPPORT == ENABLED)
+   //The path may have changed
+   ipv4FlushPmtuCache(interface);
+#endif
+
 #if (IGMP_HOST_SUPPORT == ENABLED || IGMP_ROUTER_SUPPORT == ENABLED || \
    IGMP_SNOOPING_SUPPORT == ENABLED)
    //Notify IGMP of link state changes
@@ -604,7 +626,7 @@ void ipv4LinkChangeEvent(NetInterface *interface)
  *   the packet
  **/
 
-void ipv4ProcessPacket(NetInterface *interface, Ipv4Header *packet,
+__net_hot_func void ipv4ProcessPacket(NetInterface *interface, Ipv4Header *packet,
    size_t length, NetRxAncillary *ancillary)
 {
    error_t error;
@@ -612,6 +634,12 @@ void ipv4ProcessPacket(NetInterface *interface, Ipv4Header *packet,
    //Initialize status code
    error = NO_ERROR;
 
+   //Start of IPv4 processing (latency instrumentation)
+   NET_LATENCY_MARK(NET_LATENCY_POINT_IPV4);
+
+   //Update statistics
+   NET_STATS_INC(ipv4InReceives, 1);
+
    //Total number of input datagrams received, including those received in error
    MIB2_IP_INC_COUNTER32(ipInReceives, 1);
    IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsInReceives, 1);
@@ -681,6 +709,15 @@ void ipv4ProcessPacket(NetInterface *interface, Ipv4Header *packet,
          break;
       }
 
+#if (IPV4_FIREWALL_SUPPORT == ENABLED)
+      //Check the packet against the firewall rules before any further
+      //processing
+      error = ipv4FirewallFilter(interface, packet, length);
+      //Any error to report?
+      if(error)
+         break;
+#endif
+
 #if (IGMP_ROUTER_SUPPORT == ENABLED)
       //Trap IGMP packets when IGMP router is enabled
       if(interface->igmpRouterContext != NULL && ipv4TrapIgmpPacket(packet))
@@ -704,17 +741,6 @@ void ipv4ProcessPacket(NetInterface *interface, Ipv4Header *packet,
       {
 #if defined(IPV4_PACKET_FORWARD_HOOK)
          IPV4_PACKET_FORWARD_HOOK(interface, packet, length);
-#elif (IPV4_ROUTING_SUPPORT == ENABLED)
-         NetBuffer1 buffer;
-
-         //Unfragmented datagrams fit in a single chunk
-         buffer.chunkCount = 1;
-         buffer.maxChunkCount = 1;
-         buffer.chunk[0].address = packet;
-         buffer.chunk[0].length = length;
-
-         //Forward the multicast packet
-         ipv4ForwardPacket(interface, (NetBuffer *) &buffer, 0);
 #endif
          //Multicast address filtering
          error = ipv4MulticastFilter(interface, packet->destAddr,
@@ -775,10 +801,13 @@ void ipv4ProcessPacket(NetInterface *interface, Ipv4Header *packet,
       //The host must verify the IP header checksum on every received datagram
       //and silently discard every datagram that has a bad checksum (refer to
       //RFC 1122, section 3.2.1.2)
-      if(ipCalcChecksum(packet, packet->headerLength * 4) != 0x0000)
+      if(!NET_RX_IP_CHECKSUM_VALID(ancillary) &&
+         ipCalcChecksum(packet, packet->headerLength * 4) != 0x0000)
       {
          //Debug message
          TRACE_WARNING("Wrong IP header checksum!\r\n");
+         //Update statistics
+         NET_STATS_INC(ipv4InChecksumErrors, 1);
 
          //Discard incoming packet
          error = ERROR_INVALID_HEADER;
@@ -834,7 +863,7 @@ void ipv4ProcessPacket(NetInterface *interface, Ipv4Header *packet,
  *   the packet
  **/
 
-void ipv4ProcessDatagram(NetInterface *interface, const NetBuffer *buffer,
+__net_hot_func void ipv4ProcessDatagram(NetInterface *interface, const NetBuffer *buffer,
    size_t offset, NetRxAncillary *ancillary)
 {
    error_t error;
@@ -936,8 +965,14 @@ void ipv4ProcessDatagram(NetInterface *interface, const NetBuffer *buffer,
 #if (TCP_SUPPORT == ENABLED)
    //TCP protocol?
    case IPV4_PROTOCOL_TCP:
-      //Process incoming TCP segment
-      tcpProcessSegment(interface, &pseudoHeader, buffer, offset, ancillary);
+      //Hold the segment if it can be coalesced with the next ones
+      if(!TCP_GRO_PROCESS_SEGMENT(interface, &pseudoHeader, buffer, offset,
+         ancillary))
+      {
+         //Process incoming TCP segment
+         tcpProcessSegment(interface, &pseudoHeader, buffer, offset, ancillary);
+      }
+
       //Continue processing
       break;
 #endif
@@ -1001,6 +1036,7 @@ void ipv4ProcessDatagram(NetInterface *interface, const NetBuffer *buffer,
       //Total number of input datagrams successfully delivered to IP
       //user-protocols
       MIB2_IP_INC_COUNTER32(ipInDelivers, 1);
+      NET_STATS_INC(ipv4InDelivers, 1);
       IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsInDelivers, 1);
       IP_MIB_INC_COUNTER64(ipv4SystemStats.ipSystemStatsHCInDelivers, 1);
       IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsInDelivers, 1);
@@ -1028,7 +1064,7 @@ void ipv4ProcessDatagram(NetInterface *interface, const NetBuffer *buffer,
  * @return Error code
  **/
 
-error_t ipv4SendDatagram(NetInterface *interface,
+__net_hot_func error_t ipv4SendDatagram(NetInterface *interface,
    const Ipv4PseudoHeader *pseudoHeader, NetBuffer *buffer, size_t offset,
    NetTxAncillary *ancillary)
 {
@@ -1041,6 +1077,7 @@ error_t ipv4SendDatagram(NetInterface *interface,
    //Total number of IP datagrams which local IP user-protocols supplied to IP
    //in requests for transmission
    MIB2_IP_INC_COUNTER32(ipOutRequests, 1);
+   NET_STATS_INC(ipv4OutRequests, 1);
    IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsOutRequests, 1);
    IP_MIB_INC_COUNTER64(ipv4SystemStats.ipSystemStatsHCOutRequests, 1);
    IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsOutRequests, 1);
@@ -1050,6 +1087,15 @@ error_t ipv4SendDatagram(NetInterface *interface,
    //original IP datagram
    id = interface->ipv4Context.identification++;
 
+#if (NIC_GSO_SUPPORT == ENABLED)
+   //Each TCP segment cut out of a GSO packet takes the next value
+   if(ancillary->gsoSize != 0)
+   {
+      interface->ipv4Context.identification += (uint16_t) ((netBufferGetLength(
+         buffer) - offset) / ancillary->gsoSize);
+   }
+#endif
+
 #if (IPV4_IPSEC_SUPPORT == ENABLED)
    //Process outbound IP traffic (protected-to-unprotected)
    error = ipsecProcessOutboundIpv4Packet(interface, pseudoHeader, id, buffer,
@@ -1065,8 +1111,23 @@ error_t ipv4SendDatagram(NetInterface *interface,
    //Retrieve the length of payload
    length = netBufferGetLength(buffer) - offset;
 
+#if (NIC_GSO_SUPPORT == ENABLED)
+   //A GSO packet is split into TCP segments that fit the MTU, rather than
+   //fragmented
+   if(ancillary->gsoSize != 0)
+   {
+      error = ipv4SendPacket(interface, pseudoHeader, id, 0, buffer,
+         offset, ancillary);
+   }
+   else
+#endif
    //Check the length of the payload
+#if (IPV4_PMTU_SUPPORT == ENABLED)
+   if((length + sizeof(Ipv4Header)) <= ipv4GetPathMtu(interface,
+      pseudoHeader->destAddr))
+#else
    if((length + sizeof(Ipv4Header)) <= interface->ipv4Context.linkMtu)
+#endif
    {
       //If the payload length is smaller than the network interface MTU
       //then no fragmentation is needed
@@ -1114,7 +1175,7 @@ error_t ipv4SendDatagram(NetInterface *interface,
  * @return Error code
  **/
 
-error_t ipv4SendPacket(NetInterface *interface,
+__net_hot_func error_t ipv4SendPacket(NetInterface *interface,
    const Ipv4PseudoHeader *pseudoHeader, uint16_t fragId, size_t fragOffset,
    NetBuffer *buffer, size_t offset, NetTxAncillary *ancillary)
 {
@@ -1135,18 +1196,15 @@ error_t ipv4SendPacket(NetInterface *interface,
          return error;
    }
 
-   //Sanity check
-   if(offset < sizeof(Ipv4Header))
+   //Make room for the IPv4 header
+   packet = netBufferPush(buffer, &offset, sizeof(Ipv4Header));
+   //Not enough headroom?
+   if(packet == NULL)
       return ERROR_INVALID_PARAMETER;
 
-   //Make room for the IPv4 header
-   offset -= sizeof(Ipv4Header);
    //Calculate the size of the entire packet, including header and data
    length = netBufferGetLength(buffer) - offset;
 
-   //Point to the IPv4 header
-   packet = netBufferAt(buffer, offset, 0);
-
    //Format IPv4 header
    packet->version = IPV4_VERSION;
    packet->headerLength = 5;
@@ -1175,6 +1233,15 @@ error_t ipv4SendPacket(NetInterface *interface,
       //circumstances (refer to RFC791, section 2.3)
       packet->fragmentOffset |= HTONS(IPV4_FLAG_DF);
    }
+#if (IPV4_PMTU_SUPPORT == ENABLED)
+   else if(fragOffset == 0 && !ipv4IsMulticastAddr(pseudoHeader->destAddr) &&
+      !ipv4IsBroadcastAddr(interface, pseudoHeader->destAddr))
+   {
+      //Unfragmented unicast datagrams are sent with DF set, so that routers
+      //report a smaller path MTU (refer to RFC 1191, section 3)
+      packet->fragmentOffset |= HTONS(IPV4_FLAG_DF);
+   }
+#endif
 
    //Check whether the TTL value is zero
    if(packet->timeToLive == 0)
@@ -1183,9 +1250,17 @@ error_t ipv4SendPacket(NetInterface *interface,
       packet->timeToLive = interface->ipv4Context.defaultTtl;
    }
 
-   //Calculate IP header checksum
-   packet->headerChecksum = ipCalcChecksumEx(buffer, offset,
-      packet->headerLength * 4);
+   //The IP header checksum is inserted by the NIC when offload is active
+   if(ipv4IsChecksumOffloadEnabled(interface, 0))
+   {
+      packet->headerChecksum = 0;
+   }
+   else
+   {
+      //Calculate IP header checksum
+      packet->headerChecksum = ipCalcChecksumEx(buffer, offset,
+         packet->headerLength * 4);
+   }
 
    //Ensure the source address is valid
    error = ipv4CheckSourceAddr(interface, pseudoHeader->srcAddr);
@@ -1499,7 +1574,7 @@ char_t *ipv4AddrToString(Ipv4Addr ipAddr, char_t *str)
  * @param[in] ipHeader Pointer to the IPv4 header
  **/
 
-void ipv4DumpHeader(const Ipv4Header *ipHeader)
+__net_cold_func void ipv4DumpHeader(const Ipv4Header *ipHeader)
 {
    //Dump IP header contents
    TRACE_DEBUG("  Version = %" PRIu8 "\r\n", ipHeader->version);
@@ -42,6 +42,7 @@ struct _Ipv4PseudoHeader;
 #include "core/net.h"
 #include "core/ethernet.h"
 #include "ipv4/ipv4_frag.h"
+#include "ipv4/ipv4_pmtu.h"
 
 //IPv4 support
 #ifndef IPV4_SUPPORT
@@ -92,6 +93,14 @@ struct _Ipv4PseudoHeader;
    #error IPV4_MAX_MULTICAST_SOURCES parameter is not valid
 #endif
 
+//Early filtering of multicast traffic at the Ethernet layer
+#ifndef IPV4_MULTICAST_PREFILTER_SUPPORT
+   #define IPV4_MULTICAST_PREFILTER_SUPPORT DISABLED
+#elif (IPV4_MULTICAST_PREFILTER_SUPPORT != ENABLED && \
+   IPV4_MULTICAST_PREFILTER_SUPPORT != DISABLED)
+   #error IPV4_MULTICAST_PREFILTER_SUPPORT parameter is not valid
+#endif
+
 //Version number for IPv4
 #define IPV4_VERSION 4
 //Minimum MTU
@@ -436,6 +445,12 @@ typedef struct
    Ipv4FilterEntry multicastFilter[IPV4_MULTICAST_FILTER_SIZE]; ///<Multicast filter table
 #if (IPV4_FRAG_SUPPORT == ENABLED)
    Ipv4FragDesc fragQueue[IPV4_MAX_FRAG_DATAGRAMS];             ///<IPv4 fragment reassembly queue
+   Ipv4FragDesc *fragOldest;                                    ///<Oldest datagram being reassembled
+   Ipv4FragDesc *fragNewest;                                    ///<Most recent datagram being reassembled
+   Ipv4FragDesc *fragFree;                                      ///<Free reassembly descriptors
+#endif
+#if (IPV4_PMTU_SUPPORT == ENABLED)
+   Ipv4PmtuEntry pmtuCache[IPV4_PMTU_CACHE_SIZE];               ///<Path MTU cache
 #endif
 } Ipv4Context;
 
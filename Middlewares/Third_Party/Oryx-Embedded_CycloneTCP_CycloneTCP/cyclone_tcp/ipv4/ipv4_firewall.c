@@ -0,0 +1,692 @@
+/**
+ * @file ipv4_firewall.c
+ * @brief IPv4 ingress firewall
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * The incoming IPv4 packets are checked against an ordered table of rules
+ * right after their header has been validated, before any forwarding,
+ * reassembly or delivery. The first matching rule decides whether the packet
+ * is accepted or dropped, and the default action applies when none matches.
+ * Every rule counts the packets it matched.
+ *
+ * When the policy can be expressed by the L3/L4 filters of the MAC, the
+ * driver programs them, so that the unwanted packets are dropped before
+ * they reach the DMA: either a default drop action with accepting rules, one
+ * filter per rule, or a default accept action with a single rule dropping
+ * the packets from (or to) one network, programmed as an inverse filter.
+ * A rule fits if it matches its addresses on a prefix and, for TCP and UDP,
+ * single ports; a port-less rule cannot name a protocol. The software check
+ * stays in place behind the MAC, so the rule counters only see the packets
+ * the MAC let through. Packets of other interfaces than the Ethernet ones
+ * and the packets of the loopback interface are not seen by the MAC; the
+ * latter are never filtered
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL IPV4_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/ip.h"
+#include "ipv4/ipv4.h"
+#include "ipv4/ipv4_misc.h"
+#include "ipv4/ipv4_firewall.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (IPV4_SUPPORT == ENABLED && IPV4_FIREWALL_SUPPORT == ENABLED)
+
+//Rule table, in evaluation order
+static Ipv4FirewallEntry ipv4FirewallTable[IPV4_FIREWALL_MAX_RULES];
+//Number of rules
+static uint_t ipv4FirewallRuleCount;
+//Action taken when no rule matches
+static Ipv4FirewallAction ipv4FirewallDefaultAction;
+//Number of filters programmed into the MAC
+static uint_t ipv4FirewallHwFilterCount;
+//Firewall statistics
+static Ipv4FirewallStats ipv4FirewallStats;
+
+
+/**
+ * @brief Check whether a mask is made of leading ones
+ * @param[in] mask Address mask
+ * @param[out] length Number of leading ones
+ * @return TRUE if the mask is a prefix, else FALSE
+ **/
+
+static bool_t ipv4FirewallGetPrefix(Ipv4Addr mask, uint_t *length)
+{
+   uint_t n;
+
+   //Count the leading ones
+   n = ipv4GetPrefixLength(mask);
+
+   //Save the prefix length
+   *length = n;
+
+   //The remaining bits must be cleared
+   return (mask == ((n == 0) ? 0 : htonl(0xFFFFFFFFU << (32 - n))));
+}
+
+
+/**
+ * @brief Translate a rule into a MAC filter
+ * @param[in] rule Firewall rule
+ * @param[out] filter MAC filter
+ * @return TRUE if the MAC can enforce the rule, else FALSE
+ **/
+
+static bool_t ipv4FirewallRuleToHwFilter(const Ipv4FirewallRule *rule,
+   Ipv4FirewallHwFilter *filter)
+{
+   //The MAC matches single ports only
+   if(rule->srcPortMin != rule->srcPortMax ||
+      rule->destPortMin != rule->destPortMax)
+   {
+      return FALSE;
+   }
+
+   //The protocol is only matched along with a port
+   if(rule->srcPortMax != 0 || rule->destPortMax != 0)
+   {
+      filter->protocol = rule->protocol;
+   }
+   else if(rule->protocol == 0)
+   {
+      filter->protocol = 0;
+   }
+   else
+   {
+      return FALSE;
+   }
+
+   //The MAC matches the addresses on a prefix
+   if(!ipv4FirewallGetPrefix(rule->srcMask, &filter->srcPrefixLength) ||
+      !ipv4FirewallGetPrefix(rule->destMask, &filter->destPrefixLength))
+   {
+      return FALSE;
+   }
+
+   //A filter must match at least one field
+   if(filter->protocol == 0 && filter->srcPrefixLength == 0 &&
+      filter->destPrefixLength == 0)
+   {
+      return FALSE;
+   }
+
+   //Save the fields of the filter
+   filter->srcAddr = rule->srcAddr;
+   filter->destAddr = rule->destAddr;
+   filter->srcPort = rule->srcPortMin;
+   filter->destPort = rule->destPortMin;
+   filter->inverse = FALSE;
+
+   //The MAC can enforce the rule
+   return TRUE;
+}
+
+
+/**
+ * @brief Reprogram the filters of the MACs after a change of policy
+ **/
+
+static void ipv4FirewallUpdateHw(void)
+{
+   uint_t i;
+   NetInterface *interface;
+
+   //The filters are programmed along with the MAC address filters
+   for(i = 0; i < NET_INTERFACE_COUNT; i++)
+   {
+      //Point to the current interface
+      interface = &netInterface[i];
+
+      //Physical Ethernet interface? Interfaces not configured yet pick up
+      //the policy when their MAC is initialized
+      if(interface->configured && interface->nicDriver != NULL &&
+         interface->nicDriver->type == NIC_TYPE_ETHERNET)
+      {
+         nicUpdateMacAddrFilter(interface);
+      }
+   }
+}
+
+
+/**
+ * @brief Check whether a packet matches a rule
+ * @param[in] rule Firewall rule
+ * @param[in] packet IPv4 header
+ * @param[in] ports TRUE if the ports of the packet are known
+ * @param[in] srcPort Source port
+ * @param[in] destPort Destination port
+ * @return TRUE if the packet matches the rule, else FALSE
+ **/
+
+static bool_t ipv4FirewallMatchRule(const Ipv4FirewallRule *rule,
+   const Ipv4Header *packet, bool_t ports, uint16_t srcPort, uint16_t destPort)
+{
+   //Check the protocol
+   if(rule->protocol != 0 && rule->protocol != packet->protocol)
+      return FALSE;
+
+   //Check the addresses
+   if((packet->srcAddr & rule->srcMask) != rule->srcAddr ||
+      (packet->destAddr & rule->destMask) != rule->destAddr)
+   {
+      return FALSE;
+   }
+
+   //Any port range?
+   if(rule->srcPortMax != 0 || rule->destPortMax != 0)
+   {
+      //Non-initial fragments carry no ports
+      if(!ports)
+         return FALSE;
+
+      //Check the source port
+      if(rule->srcPortMax != 0 &&
+         (srcPort < rule->srcPortMin || srcPort > rule->srcPortMax))
+      {
+         return FALSE;
+      }
+
+      //Check the destination port
+      if(rule->destPortMax != 0 &&
+         (destPort < rule->destPortMin || destPort > rule->destPortMax))
+      {
+         return FALSE;
+      }
+   }
+
+   //The packet matches the rule
+   return TRUE;
+}
+
+
+/**
+ * @brief Add a rule at the end of the table
+ * @param[in] rule Firewall rule
+ * @param[out] index Index of the rule (optional parameter)
+ * @return Error code
+ **/
+
+error_t ipv4FirewallAddRule(const Ipv4FirewallRule *rule, uint_t *index)
+{
+   error_t error;
+   Ipv4FirewallEntry *entry;
+
+   //Check parameters
+   if(rule == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Check the action
+   if(rule->action != IPV4_FIREWALL_ACTION_ACCEPT &&
+      rule->action != IPV4_FIREWALL_ACTION_DROP)
+   {
+      return ERROR_INVALID_PARAMETER;
+   }
+
+   //Check the port ranges
+   if(rule->srcPortMin > rule->srcPortMax ||
+      rule->destPortMin > rule->destPortMax)
+   {
+      return ERROR_INVALID_PARAMETER;
+   }
+
+   //Ports are only defined for TCP and UDP
+   if((rule->srcPortMax != 0 || rule->destPortMax != 0) &&
+      rule->protocol != IP_PROTOCOL_TCP && rule->protocol != IP_PROTOCOL_UDP)
+   {
+      return ERROR_INVALID_PARAMETER;
+   }
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Any room left in the table?
+   if(ipv4FirewallRuleCount < IPV4_FIREWALL_MAX_RULES)
+   {
+      //Point to the first free entry
+      entry = &ipv4FirewallTable[ipv4FirewallRuleCount];
+
+      //Save the rule, without the host bits of the addresses
+      osMemset(entry, 0, sizeof(Ipv4FirewallEntry));
+      entry->rule = *rule;
+      entry->rule.srcAddr &= rule->srcMask;
+      entry->rule.destAddr &= rule->destMask;
+
+      //Return the index of the rule, if requested
+      if(index != NULL)
+      {
+         *index = ipv4FirewallRuleCount;
+      }
+
+      //The rule is now part of the policy
+      ipv4FirewallRuleCount++;
+      ipv4FirewallUpdateHw();
+
+      //Successful processing
+      error = NO_ERROR;
+   }
+   else
+   {
+      //The rule table is full
+      error = ERROR_OUT_OF_RESOURCES;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Delete a rule
+ * @param[in] index Index of the rule; the following ones move up
+ * @return Error code
+ **/
+
+error_t ipv4FirewallDeleteRule(uint_t index)
+{
+   error_t error;
+   uint_t i;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Existing rule?
+   if(index < ipv4FirewallRuleCount)
+   {
+      //Keep the order of the following rules
+      for(i = index + 1; i < ipv4FirewallRuleCount; i++)
+      {
+         ipv4FirewallTable[i - 1] = ipv4FirewallTable[i];
+      }
+
+      //Update the policy
+      ipv4FirewallRuleCount--;
+      ipv4FirewallUpdateHw();
+
+      //Successful processing
+      error = NO_ERROR;
+   }
+   else
+   {
+      //The rule does not exist
+      error = ERROR_NOT_FOUND;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Delete all the rules
+ * @return Error code
+ **/
+
+error_t ipv4FirewallDeleteAllRules(void)
+{
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Only the default action is left
+   ipv4FirewallRuleCount = 0;
+   ipv4FirewallUpdateHw();
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Set the action taken on the packets matching no rule
+ * @param[in] action Default action
+ * @return Error code
+ **/
+
+error_t ipv4FirewallSetDefaultAction(Ipv4FirewallAction action)
+{
+   //Check parameters
+   if(action != IPV4_FIREWALL_ACTION_ACCEPT &&
+      action != IPV4_FIREWALL_ACTION_DROP)
+   {
+      return ERROR_INVALID_PARAMETER;
+   }
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Update the policy
+   ipv4FirewallDefaultAction = action;
+   ipv4FirewallUpdateHw();
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Check an incoming packet against the rules
+ * @param[in] interface Underlying network interface
+ * @param[in] packet Incoming IPv4 packet, whose header has been validated
+ * @param[in] length Length of the packet
+ * @return NO_ERROR if the packet is accepted, ERROR_ACCESS_DENIED if it
+ *   must be dropped
+ **/
+
+__net_hot_func error_t ipv4FirewallFilter(NetInterface *interface,
+   const Ipv4Header *packet, size_t length)
+{
+   uint_t i;
+   size_t headerLength;
+   bool_t ports;
+   uint16_t srcPort;
+   uint16_t destPort;
+   const uint8_t *payload;
+   Ipv4FirewallEntry *entry;
+   Ipv4FirewallAction action;
+
+   //No filtering without rules, unless everything is dropped
+   if(ipv4FirewallRuleCount == 0 &&
+      ipv4FirewallDefaultAction == IPV4_FIREWALL_ACTION_ACCEPT)
+   {
+      return NO_ERROR;
+   }
+
+   //The packets sent to the host itself are never filtered
+   if(interface->nicDriver != NULL &&
+      interface->nicDriver->type == NIC_TYPE_LOOPBACK)
+   {
+      return NO_ERROR;
+   }
+
+   //Length of the datagram
+   length = MIN(length, ntohs(packet->totalLength));
+   headerLength = packet->headerLength * 4;
+
+   //Both TCP and UDP headers start with the source and destination ports,
+   //which only the first fragment carries
+   if((packet->protocol == IPV4_PROTOCOL_TCP ||
+      packet->protocol == IPV4_PROTOCOL_UDP) &&
+      (ntohs(packet->fragmentOffset) & IPV4_OFFSET_MASK) == 0 &&
+      length >= (headerLength + 4))
+   {
+      payload = (const uint8_t *) packet + headerLength;
+      srcPort = LOAD16BE(payload);
+      destPort = LOAD16BE(payload + 2);
+      ports = TRUE;
+   }
+   else
+   {
+      srcPort = 0;
+      destPort = 0;
+      ports = FALSE;
+   }
+
+   //The first matching rule applies
+   for(i = 0; i < ipv4FirewallRuleCount; i++)
+   {
+      //Point to the current rule
+      entry = &ipv4FirewallTable[i];
+
+      //Matching rule?
+      if(ipv4FirewallMatchRule(&entry->rule, packet, ports, srcPort, destPort))
+         break;
+   }
+
+   //Any matching rule?
+   if(i < ipv4FirewallRuleCount)
+   {
+      //Update the counters of the rule
+      entry->packets++;
+      entry->bytes += length;
+      action = entry->rule.action;
+   }
+   else
+   {
+      //Update the counters of the default action
+      ipv4FirewallStats.defaultPackets++;
+      ipv4FirewallStats.defaultBytes += length;
+      action = ipv4FirewallDefaultAction;
+   }
+
+   //Drop the packet?
+   if(action == IPV4_FIREWALL_ACTION_DROP)
+   {
+      //Debug message
+      TRACE_DEBUG("IPv4 packet dropped by the firewall\r\n");
+
+      ipv4FirewallStats.dropped++;
+      return ERROR_ACCESS_DENIED;
+   }
+
+   ipv4FirewallStats.accepted++;
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Check whether the firewall may drop packets
+ *
+ * Offload engines that answer packets without going through the stack must
+ * leave them to the stack when the firewall is active
+ *
+ * @return TRUE if a policy is in place, else FALSE
+ **/
+
+bool_t ipv4FirewallIsActive(void)
+{
+   //Any rule or default drop action?
+   return (ipv4FirewallRuleCount > 0 ||
+      ipv4FirewallDefaultAction == IPV4_FIREWALL_ACTION_DROP);
+}
+
+
+/**
+ * @brief Get the filters enforcing the policy in the MAC
+ *
+ * This function is called by the NIC drivers able to filter on the IP
+ * addresses and ports, while the MAC address filters are updated (netMutex
+ * held). No filter is returned when the policy cannot be entirely enforced
+ * by maxFilters filters; the software check then does all the work
+ *
+ * @param[out] filters Filters to be programmed
+ * @param[in] maxFilters Number of filters the MAC provides
+ * @return Number of filters to be programmed (0 to disable L3/L4 filtering)
+ **/
+
+uint_t ipv4FirewallGetHwFilters(Ipv4FirewallHwFilter *filters,
+   uint_t maxFilters)
+{
+   uint_t i;
+   uint_t n;
+   const Ipv4FirewallRule *rule;
+
+   //Initialize the number of filters
+   n = 0;
+
+   //The MAC passes the packets matching one of the filters
+   if(ipv4FirewallDefaultAction == IPV4_FIREWALL_ACTION_DROP)
+   {
+      //Each accepting rule gives a filter
+      if(ipv4FirewallRuleCount <= maxFilters)
+      {
+         for(n = 0; n < ipv4FirewallRuleCount; n++)
+         {
+            //Point to the current rule
+            rule = &ipv4FirewallTable[n].rule;
+
+            //Rules dropping packets cannot be expressed
+            if(rule->action != IPV4_FIREWALL_ACTION_ACCEPT)
+               break;
+
+            //The MAC must be able to match the rule
+            if(!ipv4FirewallRuleToHwFilter(rule, &filters[n]))
+               break;
+         }
+
+         //Partial policies are not programmed
+         if(n < ipv4FirewallRuleCount)
+         {
+            n = 0;
+         }
+      }
+   }
+   else
+   {
+      //A single rule dropping the packets of one network becomes an inverse
+      //filter that passes everything else
+      if(ipv4FirewallRuleCount == 1 && maxFilters >= 1)
+      {
+         //Point to the rule
+         rule = &ipv4FirewallTable[0].rule;
+
+         //Only one address can be inverted
+         if(rule->action == IPV4_FIREWALL_ACTION_DROP &&
+            rule->protocol == 0 && (rule->srcMask == 0 || rule->destMask == 0) &&
+            ipv4FirewallRuleToHwFilter(rule, &filters[0]))
+         {
+            filters[0].inverse = TRUE;
+            n = 1;
+         }
+      }
+   }
+
+   //Keep track of the rules enforced by the MAC
+   for(i = 0; i < ipv4FirewallRuleCount; i++)
+   {
+      ipv4FirewallTable[i].hardware = (n > 0) ? TRUE : FALSE;
+   }
+
+   //Save the number of filters programmed
+   ipv4FirewallHwFilterCount = n;
+
+   //Return the number of filters
+   return n;
+}
+
+
+/**
+ * @brief Get a rule and its counters
+ * @param[in] index Index of the rule
+ * @param[out] entry Copy of the rule table entry
+ * @return Error code
+ **/
+
+error_t ipv4FirewallGetRule(uint_t index, Ipv4FirewallEntry *entry)
+{
+   error_t error;
+
+   //Check parameters
+   if(entry == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Existing rule?
+   if(index < ipv4FirewallRuleCount)
+   {
+      *entry = ipv4FirewallTable[index];
+      error = NO_ERROR;
+   }
+   else
+   {
+      error = ERROR_NOT_FOUND;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Get firewall statistics
+ * @param[out] stats Copy of the counters
+ **/
+
+void ipv4FirewallGetStats(Ipv4FirewallStats *stats)
+{
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Copy the counters
+   *stats = ipv4FirewallStats;
+   stats->defaultAction = ipv4FirewallDefaultAction;
+   stats->ruleCount = ipv4FirewallRuleCount;
+   stats->hwFilterCount = ipv4FirewallHwFilterCount;
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+}
+
+
+/**
+ * @brief Clear the counters of the firewall and of its rules
+ **/
+
+void ipv4FirewallClearStats(void)
+{
+   uint_t i;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Clear the global counters
+   osMemset(&ipv4FirewallStats, 0, sizeof(Ipv4FirewallStats));
+
+   //Clear the counters of the rules
+   for(i = 0; i < ipv4FirewallRuleCount; i++)
+   {
+      ipv4FirewallTable[i].packets = 0;
+      ipv4FirewallTable[i].bytes = 0;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+}
+
+#endif
@@ -0,0 +1,166 @@
+/**
+ * @file ipv4_firewall.h
+ * @brief IPv4 ingress firewall
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+#ifndef _IPV4_FIREWALL_H
+#define _IPV4_FIREWALL_H
+
+//Dependencies
+#include "core/net.h"
+#include "ipv4/ipv4.h"
+
+//IPv4 firewall support
+#ifndef IPV4_FIREWALL_SUPPORT
+   #define IPV4_FIREWALL_SUPPORT DISABLED
+#elif (IPV4_FIREWALL_SUPPORT != ENABLED && IPV4_FIREWALL_SUPPORT != DISABLED)
+   #error IPV4_FIREWALL_SUPPORT parameter is not valid
+#endif
+
+//Size of the rule table
+#ifndef IPV4_FIREWALL_MAX_RULES
+   #define IPV4_FIREWALL_MAX_RULES 16
+#elif (IPV4_FIREWALL_MAX_RULES < 1)
+   #error IPV4_FIREWALL_MAX_RULES parameter is not valid
+#endif
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Firewall actions
+ **/
+
+typedef enum
+{
+   IPV4_FIREWALL_ACTION_ACCEPT = 0,
+   IPV4_FIREWALL_ACTION_DROP   = 1
+} Ipv4FirewallAction;
+
+
+/**
+ * @brief Firewall rule
+ *
+ * A packet matches the rule when all of its fields match. A zero mask
+ * matches any address and a zero protocol any protocol. Port ranges can
+ * only be given for TCP and UDP; a range of 0-0 matches any port
+ **/
+
+typedef struct
+{
+   Ipv4FirewallAction action; ///<Action taken on the matching packets
+   uint8_t protocol;          ///<IP protocol (0 for any)
+   Ipv4Addr srcAddr;          ///<Source address
+   Ipv4Addr srcMask;          ///<Source address mask
+   Ipv4Addr destAddr;         ///<Destination address
+   Ipv4Addr destMask;         ///<Destination address mask
+   uint16_t srcPortMin;       ///<Lowest source port
+   uint16_t srcPortMax;       ///<Highest source port
+   uint16_t destPortMin;      ///<Lowest destination port
+   uint16_t destPortMax;      ///<Highest destination port
+} Ipv4FirewallRule;
+
+
+/**
+ * @brief Rule table entry
+ **/
+
+typedef struct
+{
+   Ipv4FirewallRule rule; ///<Rule
+   bool_t hardware;       ///<The rule is enforced by the MAC
+   uint32_t packets;      ///<Packets matching the rule, checked in software
+   uint32_t bytes;        ///<Bytes of these packets
+} Ipv4FirewallEntry;
+
+
+/**
+ * @brief Filter programmed into the MAC
+ *
+ * The MAC passes a packet if it matches one of its filters and drops the
+ * others. A zero prefix length matches any address and a zero port any port.
+ * When the inverse flag is set, the filter matches the packets whose
+ * addresses do not match (no port is then given)
+ **/
+
+typedef struct
+{
+   uint8_t protocol;         ///<IP_PROTOCOL_TCP or IP_PROTOCOL_UDP when a port is given
+   Ipv4Addr srcAddr;         ///<Source address
+   uint_t srcPrefixLength;   ///<Number of leading bits of the source address matched
+   Ipv4Addr destAddr;        ///<Destination address
+   uint_t destPrefixLength;  ///<Number of leading bits of the destination address matched
+   uint16_t srcPort;         ///<Source port
+   uint16_t destPort;        ///<Destination port
+   bool_t inverse;           ///<Match the packets whose addresses differ
+} Ipv4FirewallHwFilter;
+
+
+/**
+ * @brief Firewall statistics
+ **/
+
+typedef struct
+{
+   Ipv4FirewallAction defaultAction; ///<Action taken when no rule matches
+   uint_t ruleCount;                 ///<Number of rules
+   uint_t hwFilterCount;             ///<Number of filters programmed into the MAC
+   uint32_t defaultPackets;          ///<Packets matching no rule, checked in software
+   uint32_t defaultBytes;            ///<Bytes of these packets
+   uint32_t accepted;                ///<Packets accepted in software
+   uint32_t dropped;                 ///<Packets dropped in software
+} Ipv4FirewallStats;
+
+
+//IPv4 firewall related functions
+error_t ipv4FirewallAddRule(const Ipv4FirewallRule *rule, uint_t *index);
+error_t ipv4FirewallDeleteRule(uint_t index);
+error_t ipv4FirewallDeleteAllRules(void);
+error_t ipv4FirewallSetDefaultAction(Ipv4FirewallAction action);
+
+error_t ipv4FirewallFilter(NetInterface *interface, const Ipv4Header *packet,
+   size_t length);
+
+bool_t ipv4FirewallIsActive(void);
+
+uint_t ipv4FirewallGetHwFilters(Ipv4FirewallHwFilter *filters,
+   uint_t maxFilters);
+
+error_t ipv4FirewallGetRule(uint_t index, Ipv4FirewallEntry *entry);
+void ipv4FirewallGetStats(Ipv4FirewallStats *stats);
+void ipv4FirewallClearStats(void);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -43,6 +43,7 @@
 //Dependencies
 #include "core/net.h"
 #include "core/ip.h"
+#include "core/udp.h"
 #include "ipv4/ipv4.h"
 #include "ipv4/ipv4_frag.h"
 #include "ipv4/icmp.h"
@@ -89,6 +90,12 @@ error_t ipv4FragmentDatagram(NetInterface *interface,
    //Retrieve the length of the payload
    payloadLen = netBufferGetLength(payload) - payloadOffset;
 
+#if (NET_MEM_TX_ZERO_COPY_SUPPORT == ENABLED)
+   //The same buffer is reused for every fragment and references the payload
+   //without copying it, so it cannot be handed over to the NIC driver
+   ancillary->zeroCopy = FALSE;
+#endif
+
    //Allocate a memory buffer to hold IP fragments
    fragment = ipAllocBuffer(0, &fragmentOffset);
    //Failed to allocate memory?
@@ -96,7 +103,12 @@ error_t ipv4FragmentDatagram(NetInterface *interface,
       return ERROR_OUT_OF_MEMORY;
 
    //Determine the maximum payload size for fragmented packets
+#if (IPV4_PMTU_SUPPORT == ENABLED)
+   maxFragmentSize = ipv4GetPathMtu(interface, pseudoHeader->destAddr) -
+      sizeof(Ipv4Header);
+#else
    maxFragmentSize = interface->ipv4Context.linkMtu - sizeof(Ipv4Header);
+#endif
    //The size shall be a multiple of 8-byte blocks
    maxFragmentSize -= (maxFragmentSize % 8);
 
@@ -174,6 +186,11 @@ error_t ipv4FragmentDatagram(NetInterface *interface,
 
 /**
  * @brief IPv4 datagram reassembly algorithm
+ *
+ * The payload of each fragment is copied at its final place in the slab of
+ * the matching descriptor. Missing data is tracked by a sorted array of
+ * holes, so that a fragment only touches the holes it overlaps
+ *
  * @param[in] interface Underlying network interface
  * @param[in] packet Pointer to the IPv4 fragmented packet
  * @param[in] length Packet length including header and payload
@@ -184,21 +201,25 @@ error_t ipv4FragmentDatagram(NetInterface *interface,
 void ipv4ReassembleDatagram(NetInterface *interface, const Ipv4Header *packet,
    size_t length, NetRxAncillary *ancillary)
 {
-   error_t error;
+   uint_t i;
+   uint_t j;
+   uint_t n;
+   size_t headerLength;
    uint16_t offset;
    uint16_t dataFirst;
    uint16_t dataLast;
    Ipv4FragDesc *frag;
-   Ipv4HoleDesc *hole;
-   Ipv4HoleDesc *prevHole;
+   Ipv4HoleDesc pieces[2];
 
    //Number of IP fragments received which needed to be reassembled
    MIB2_IP_INC_COUNTER32(ipReasmReqds, 1);
    IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsReasmReqds, 1);
    IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsReasmReqds, 1);
 
+   //Calculate the length of the IP header including options
+   headerLength = packet->headerLength * 4;
    //Get the length of the payload
-   length -= packet->headerLength * 4;
+   length -= headerLength;
    //Convert the fragment offset from network byte order
    offset = ntohs(packet->fragmentOffset);
 
@@ -209,6 +230,7 @@ void ipv4ReassembleDatagram(NetInterface *interface, const Ipv4Header *packet,
       MIB2_IP_INC_COUNTER32(ipReasmFails, 1);
       IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsReasmFails, 1);
       IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsReasmFails, 1);
+      NET_STATS_INC(ipv4ReasmFails, 1);
 
       //Drop the incoming fragment
       return;
@@ -226,6 +248,7 @@ void ipv4ReassembleDatagram(NetInterface *interface, const Ipv4Header *packet,
       MIB2_IP_INC_COUNTER32(ipReasmFails, 1);
       IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsReasmFails, 1);
       IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsReasmFails, 1);
+      NET_STATS_INC(ipv4ReasmFails, 1);
 
       //Drop the incoming fragment
       return;
@@ -241,308 +264,286 @@ void ipv4ReassembleDatagram(NetInterface *interface, const Ipv4Header *packet,
       MIB2_IP_INC_COUNTER32(ipReasmFails, 1);
       IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsReasmFails, 1);
       IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsReasmFails, 1);
+      NET_STATS_INC(ipv4ReasmQueueFull, 1);
 
       //Drop the incoming fragment
       return;
    }
 
    //The very first fragment requires special handling
-   if((offset & IPV4_OFFSET_MASK) == 0)
+   if(dataFirst == 0)
    {
-      //Calculate the length of the IP header including options
-      frag->headerLength = packet->headerLength * 4;
-
-      //Enforce the size of the reconstructed datagram
-      if((frag->headerLength + frag->dataLen) > IPV4_MAX_FRAG_DATAGRAM_SIZE)
-      {
-         //Number of failures detected by the IP reassembly algorithm
-         MIB2_IP_INC_COUNTER32(ipReasmFails, 1);
-         IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsReasmFails, 1);
-         IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsReasmFails, 1);
-
-         //Drop the reconstructed datagram
-         netBufferSetLength((NetBuffer *) &frag->buffer, 0);
-         //Exit immediately
-         return;
-      }
-
-      //Make sure the IP header entirely fits in the first chunk
-      if(frag->headerLength > frag->buffer.chunk[0].size)
-      {
-         //Number of failures detected by the IP reassembly algorithm
-         MIB2_IP_INC_COUNTER32(ipReasmFails, 1);
-         IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsReasmFails, 1);
-         IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsReasmFails, 1);
-
-         //Drop the reconstructed datagram
-         netBufferSetLength((NetBuffer *) &frag->buffer, 0);
-         //Exit immediately
-         return;
-      }
-
-      //Fix the length of the first chunk
-      frag->buffer.chunk[0].length = (uint16_t) frag->headerLength;
       //Always take the IP header from the first fragment
-      netBufferWrite((NetBuffer *) &frag->buffer, 0, packet, frag->headerLength);
+      frag->headerLength = headerLength;
+      osMemcpy(frag->data + IPV4_MAX_HEADER_LENGTH - headerLength, packet,
+         headerLength);
    }
 
-   //It may be necessary to increase the size of the buffer
-   if(dataLast > frag->dataLen)
+   //Enforce the size of the reconstructed datagram
+   if((frag->headerLength + MAX(frag->dataLen, dataLast)) >
+      IPV4_MAX_FRAG_DATAGRAM_SIZE)
    {
-      //Enforce the size of the reconstructed datagram
-      if((frag->headerLength + dataLast) > IPV4_MAX_FRAG_DATAGRAM_SIZE)
-      {
-         //Number of failures detected by the IP reassembly algorithm
-         MIB2_IP_INC_COUNTER32(ipReasmFails, 1);
-         IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsReasmFails, 1);
-         IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsReasmFails, 1);
+      //Number of failures detected by the IP reassembly algorithm
+      MIB2_IP_INC_COUNTER32(ipReasmFails, 1);
+      IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsReasmFails, 1);
+      IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsReasmFails, 1);
+      NET_STATS_INC(ipv4ReasmFails, 1);
 
-         //Drop the reconstructed datagram
-         netBufferSetLength((NetBuffer *) &frag->buffer, 0);
-         //Exit immediately
-         return;
-      }
+      //Drop the reconstructed datagram
+      ipv4ReleaseFragDesc(interface, frag);
+      //Exit immediately
+      return;
+   }
 
-      //Adjust the size of the reconstructed datagram
-      error = netBufferSetLength((NetBuffer *) &frag->buffer,
-         frag->headerLength + dataLast + sizeof(Ipv4HoleDesc));
+   //Locate the first hole that ends after the beginning of the fragment
+   i = ipv4FindHole(frag, dataFirst);
 
-      //Any error to report?
-      if(error)
+   //Determine the range of holes the fragment interacts with
+   for(j = i; j < frag->holeCount && frag->holes[j].first < dataLast; j++)
+   {
+#if (IPV4_OVERLAPPING_FRAG_SUPPORT == DISABLED)
+      //Prevent overlapping fragment attacks (refer to RFC 8900, section 3.7)
+      if(dataFirst < frag->holes[j].first || dataLast > frag->holes[j].last)
       {
          //Number of failures detected by the IP reassembly algorithm
          MIB2_IP_INC_COUNTER32(ipReasmFails, 1);
          IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsReasmFails, 1);
          IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsReasmFails, 1);
+         NET_STATS_INC(ipv4ReasmFails, 1);
 
          //Drop the reconstructed datagram
-         netBufferSetLength((NetBuffer *) &frag->buffer, 0);
+         ipv4ReleaseFragDesc(interface, frag);
          //Exit immediately
          return;
       }
+#endif
+   }
 
-      //Actual length of the payload
-      frag->dataLen = dataLast;
+   //Duplicate fragments do not fill any hole
+   if(i == j)
+      return;
+
+   //A fragment which does not fit in a single hole overwrites data already
+   //summed, so the checksum of the payload must be computed again
+   if((j - i) != 1 || dataFirst < frag->holes[i].first ||
+      dataLast > frag->holes[i].last)
+   {
+      frag->checksumValid = FALSE;
    }
 
-   //Select the first hole descriptor from the list
-   hole = ipv4FindHole(frag, frag->firstHole);
-   //Keep track of the previous hole in the list
-   prevHole = NULL;
+   //Number of holes that replace the overlapped ones
+   n = 0;
 
-   //Iterate through the hole descriptors
-   while(hole != NULL)
+   //Is there still a hole at the beginning of the segment?
+   if(dataFirst > frag->holes[i].first)
    {
-      //Save lower and upper boundaries for later use
-      uint16_t holeFirst = hole->first;
-      uint16_t holeLast = hole->last;
+      pieces[n].first = frag->holes[i].first;
+      pieces[n++].last = dataFirst;
+   }
 
-      //Check whether the newly arrived fragment interacts with this hole in
-      //some way
-      if(dataFirst < holeLast && dataLast > holeFirst)
-      {
-#if (IPV4_OVERLAPPING_FRAG_SUPPORT == DISABLED)
-         //Prevent overlapping fragment attacks (refer to RFC 8900, section 3.7)
-         if(dataFirst < holeFirst || dataLast > holeLast)
-         {
-            //Number of failures detected by the IP reassembly algorithm
-            MIB2_IP_INC_COUNTER32(ipReasmFails, 1);
-            IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsReasmFails, 1);
-            IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsReasmFails, 1);
-
-            //Drop the reconstructed datagram
-            netBufferSetLength((NetBuffer *) &frag->buffer, 0);
-            //Exit immediately
-            return;
-         }
-#endif
-         //The current descriptor is no longer valid. We will destroy it, and in
-         //the next two steps, we will determine whether or not it is necessary
-         //to create any new hole descriptors
-         if(prevHole != NULL)
-         {
-            prevHole->next = hole->next;
-         }
-         else
-         {
-            frag->firstHole = hole->next;
-         }
-
-         //Is there still a hole at the beginning of the segment?
-         if(dataFirst > holeFirst)
-         {
-            //Create a new entry that describes this hole
-            hole = ipv4FindHole(frag, holeFirst);
-            hole->first = holeFirst;
-            hole->last = dataFirst;
-
-            //Insert the newly created entry into the hole descriptor list
-            if(prevHole != NULL)
-            {
-               hole->next = prevHole->next;
-               prevHole->next = hole->first;
-            }
-            else
-            {
-               hole->next = frag->firstHole;
-               frag->firstHole = hole->first;
-            }
-
-            //Always keep track of the previous hole
-            prevHole = hole;
-         }
-
-         //Is there still a hole at the end of the segment?
-         if(dataLast < holeLast && (offset & IPV4_FLAG_MF) != 0)
-         {
-            //Create a new entry that describes this hole
-            hole = ipv4FindHole(frag, dataLast);
-            hole->first = dataLast;
-            hole->last = holeLast;
-
-            //Insert the newly created entry into the hole descriptor list
-            if(prevHole != NULL)
-            {
-               hole->next = prevHole->next;
-               prevHole->next = hole->first;
-            }
-            else
-            {
-               hole->next = frag->firstHole;
-               frag->firstHole = hole->first;
-            }
-
-            //Always keep track of the previous hole
-            prevHole = hole;
-         }
-      }
-      else
-      {
-         //The newly arrived fragment does not interact with the current hole
-         prevHole = hole;
-      }
+   //Is there still a hole at the end of the segment?
+   if(dataLast < frag->holes[j - 1].last && (offset & IPV4_FLAG_MF) != 0)
+   {
+      pieces[n].first = dataLast;
+      pieces[n++].last = frag->holes[j - 1].last;
+   }
 
-      //Select the next hole descriptor from the list
-      hole = ipv4FindHole(frag, prevHole ? prevHole->next : frag->firstHole);
+   //Make sure the hole array can describe the resulting state
+   if((frag->holeCount - (j - i) + n) > IPV4_FRAG_MAX_HOLES)
+   {
+      //Number of failures detected by the IP reassembly algorithm
+      MIB2_IP_INC_COUNTER32(ipReasmFails, 1);
+      IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsReasmFails, 1);
+      IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsReasmFails, 1);
+      NET_STATS_INC(ipv4ReasmFails, 1);
+
+      //Drop the reconstructed datagram
+      ipv4ReleaseFragDesc(interface, frag);
+      //Exit immediately
+      return;
    }
 
-   //Copy data from the fragment to the reassembly buffer
-   netBufferWrite((NetBuffer *) &frag->buffer,
-      frag->headerLength + dataFirst, IPV4_DATA(packet), length);
+   //Replace the overlapped holes, keeping the array sorted
+   osMemmove(&frag->holes[i + n], &frag->holes[j],
+      (frag->holeCount - j) * sizeof(Ipv4HoleDesc));
+   osMemcpy(&frag->holes[i], pieces, n * sizeof(Ipv4HoleDesc));
+   frag->holeCount = frag->holeCount - (j - i) + n;
+
+   //Copy data from the fragment to the reassembly slab, summing it on the
+   //way (fragments start on 8-byte boundaries, so the partial sums simply
+   //add up)
+   frag->checksum += ipCopyChecksum(frag->data + IPV4_MAX_HEADER_LENGTH +
+      dataFirst, IPV4_DATA(packet), length) ^ 0xFFFF;
+   frag->checksum = (frag->checksum & 0xFFFF) + (frag->checksum >> 16);
+
+   //Actual length of the payload
+   frag->dataLen = MAX(frag->dataLen, dataLast);
 
    //Dump hole descriptor list
    ipv4DumpHoleList(frag);
 
    //If the hole descriptor list is empty, the reassembly process is now
    //complete
-   if(ipv4FindHole(frag, frag->firstHole) == NULL)
+   if(frag->holeCount == 0)
    {
-      //Discard the extra hole descriptor that follows the reconstructed
-      //datagram
-      error = netBufferSetLength((NetBuffer *) &frag->buffer,
-         frag->headerLength + frag->dataLen);
+      Ipv4Header *datagram;
+      NetBuffer1 buffer;
+
+      //Point to the IP header
+      datagram = (Ipv4Header *) (frag->data + IPV4_MAX_HEADER_LENGTH -
+         frag->headerLength);
+
+      //Fix IP header
+      datagram->totalLength = htons(frag->headerLength + frag->dataLen);
+      datagram->fragmentOffset = 0;
+      datagram->headerChecksum = 0;
+
+      //The reconstructed datagram is contiguous
+      buffer.chunkCount = 1;
+      buffer.maxChunkCount = 1;
+      buffer.chunk[0].address = datagram;
+      buffer.chunk[0].length = (uint16_t) (frag->headerLength + frag->dataLen);
+      buffer.chunk[0].size = 0;
+
+      //Number of IP datagrams successfully reassembled
+      MIB2_IP_INC_COUNTER32(ipReasmOKs, 1);
+      IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsReasmOKs, 1);
+      IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsReasmOKs, 1);
+      NET_STATS_INC(ipv4ReasmOks, 1);
+
+#if (ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
+      //The NIC does not verify the payload checksum of IP fragments, but the
+      //sum taken during the copies gives the TCP or UDP checksum without
+      //reading the datagram again
+      ancillary->payloadChecksumValid = ipv4CheckFragChecksum(frag);
+#endif
 
-      //Check status code
-      if(error)
-      {
-         //Number of failures detected by the IP reassembly algorithm
-         MIB2_IP_INC_COUNTER32(ipReasmFails, 1);
-         IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsReasmFails, 1);
-         IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsReasmFails, 1);
-      }
-      else
-      {
-         //Point to the IP header
-         Ipv4Header *datagram = netBufferAt((NetBuffer *) &frag->buffer, 0, 0);
-
-         //Fix IP header
-         datagram->totalLength = htons(frag->headerLength + frag->dataLen);
-         datagram->fragmentOffset = 0;
-         datagram->headerChecksum = 0;
-
-         //Number of IP datagrams successfully reassembled
-         MIB2_IP_INC_COUNTER32(ipReasmOKs, 1);
-         IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsReasmOKs, 1);
-         IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsReasmOKs, 1);
-
-         //Pass the original IPv4 datagram to the higher protocol layer
-         ipv4ProcessDatagram(interface, (NetBuffer *) &frag->buffer, 0,
-            ancillary);
-      }
+      //Pass the original IPv4 datagram to the higher protocol layer
+      ipv4ProcessDatagram(interface, (NetBuffer *) &buffer, 0, ancillary);
 
-      //Release previously allocated memory
-      netBufferSetLength((NetBuffer *) &frag->buffer, 0);
+      //The slab can now be reused
+      ipv4ReleaseFragDesc(interface, frag);
    }
 }
 
 
+/**
+ * @brief Verify the TCP or UDP checksum of a reassembled datagram
+ * @param[in] frag IP fragment descriptor, its payload complete
+ * @return TRUE if the checksum is known to be correct, FALSE if it is wrong
+ *   or must be verified by the upper layer
+ **/
+
+bool_t ipv4CheckFragChecksum(const Ipv4FragDesc *frag)
+{
+   uint32_t checksum;
+   Ipv4PseudoHeader pseudoHeader;
+   const UdpHeader *udpHeader;
+
+   //Overlapping fragments, or a protocol without pseudo header?
+   if(!frag->checksumValid)
+      return FALSE;
+
+   if(frag->protocol == IPV4_PROTOCOL_UDP)
+   {
+      //Malformed datagram, or trailing bytes after the UDP datagram?
+      if(frag->dataLen < sizeof(UdpHeader))
+         return FALSE;
+
+      udpHeader = (const UdpHeader *) (frag->data + IPV4_MAX_HEADER_LENGTH);
+
+      if(ntohs(udpHeader->length) != frag->dataLen)
+         return FALSE;
+   }
+   else if(frag->protocol != IPV4_PROTOCOL_TCP)
+   {
+      return FALSE;
+   }
+
+   //Format the pseudo header of the upper layer
+   pseudoHeader.srcAddr = frag->srcAddr;
+   pseudoHeader.destAddr = frag->destAddr;
+   pseudoHeader.reserved = 0;
+   pseudoHeader.protocol = frag->protocol;
+   pseudoHeader.length = htons(frag->dataLen);
+
+   //Add the pseudo header to the sum of the payload
+   checksum = ipCalcChecksum(&pseudoHeader, sizeof(Ipv4PseudoHeader)) ^ 0xFFFF;
+   checksum += frag->checksum;
+   //Fold 32-bit sum to 16 bits
+   checksum = (checksum & 0xFFFF) + (checksum >> 16);
+
+   //The sum of a correct datagram, checksum field included, is 0xFFFF
+   return (checksum == 0xFFFF) ? TRUE : FALSE;
+}
+
+
 /**
  * @brief Fragment reassembly timeout handler
  *
  * This routine must be periodically called by the TCP/IP stack to
- * handle IPv4 fragment reassembly timeout
+ * handle IPv4 fragment reassembly timeout. The age list is sorted by
+ * creation time, hence only the oldest entries need to be checked
  *
  * @param[in] interface Underlying network interface
  **/
 
 void ipv4FragTick(NetInterface *interface)
 {
-   error_t error;
-   uint_t i;
    systime_t time;
-   Ipv4HoleDesc *hole;
+   Ipv4FragDesc *frag;
+   Ipv4Header *datagram;
+   NetBuffer1 buffer;
 
    //Get current time
    time = osGetSystemTime();
 
-   //Loop through the reassembly queue
-   for(i = 0; i < IPV4_MAX_FRAG_DATAGRAMS; i++)
+   //If the timer runs out, the partially-reassembled datagram must be
+   //discarded and ICMP Time Exceeded message sent to the source host
+   while((frag = interface->ipv4Context.fragOldest) != NULL &&
+      (time - frag->timestamp) >= IPV4_FRAG_TIME_TO_LIVE)
    {
-      //Point to the current entry in the reassembly queue
-      Ipv4FragDesc *frag = &interface->ipv4Context.fragQueue[i];
+      //Point to the IP header
+      datagram = (Ipv4Header *) (frag->data + IPV4_MAX_HEADER_LENGTH -
+         frag->headerLength);
+
+      //Debug message
+      TRACE_INFO("IPv4 fragment reassembly timeout...\r\n");
+      //Dump IP header contents for debugging purpose
+      ipv4DumpHeader(datagram);
 
-      //Make sure the entry is currently in use
-      if(frag->buffer.chunkCount > 0)
+      //Number of failures detected by the IP reassembly algorithm
+      MIB2_IP_INC_COUNTER32(ipReasmFails, 1);
+      IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsReasmFails, 1);
+      IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsReasmFails, 1);
+      NET_STATS_INC(ipv4ReasmTimeouts, 1);
+
+      //Make sure the fragment zero has been received before sending an
+      //ICMP message
+      if(frag->holeCount > 0 && frag->holes[0].first > 0)
       {
-         //If the timer runs out, the partially-reassembled datagram must be
-         //discarded and ICMP Time Exceeded message sent to the source host
-         if((time - frag->timestamp) >= IPV4_FRAG_TIME_TO_LIVE)
-         {
-            //Debug message
-            TRACE_INFO("IPv4 fragment reassembly timeout...\r\n");
-            //Dump IP header contents for debugging purpose
-            ipv4DumpHeader(frag->buffer.chunk[0].address);
-
-            //Number of failures detected by the IP reassembly algorithm
-            MIB2_IP_INC_COUNTER32(ipReasmFails, 1);
-            IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsReasmFails, 1);
-            IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsReasmFails, 1);
-
-            //Point to the first hole descriptor
-            hole = ipv4FindHole(frag, frag->firstHole);
-
-            //Make sure the fragment zero has been received before sending an
-            //ICMP message
-            if(hole != NULL && hole->first > 0)
-            {
-               //Fix the size of the reconstructed datagram
-               error = netBufferSetLength((NetBuffer *) &frag->buffer,
-                  frag->headerLength + hole->first);
-
-               //Check status code
-               if(!error)
-               {
-                  //Send an ICMP Time Exceeded message
-                  icmpSendErrorMessage(interface, ICMP_TYPE_TIME_EXCEEDED,
-                     ICMP_CODE_REASSEMBLY_TIME_EXCEEDED, 0,
-                     (NetBuffer *) &frag->buffer, 0);
-               }
-            }
-
-            //Drop the partially reconstructed datagram
-            netBufferSetLength((NetBuffer *) &frag->buffer, 0);
-         }
+         //The received part of the datagram is contiguous
+         buffer.chunkCount = 1;
+         buffer.maxChunkCount = 1;
+         buffer.chunk[0].address = datagram;
+         buffer.chunk[0].length = (uint16_t) (frag->headerLength +
+            frag->holes[0].first);
+         buffer.chunk[0].size = 0;
+
+         //Send an ICMP Time Exceeded message
+         icmpSendErrorMessage(interface, ICMP_TYPE_TIME_EXCEEDED,
+            ICMP_CODE_REASSEMBLY_TIME_EXCEEDED, 0, (NetBuffer *) &buffer, 0);
       }
+
+      //Drop the partially reconstructed datagram
+      ipv4ReleaseFragDesc(interface, frag);
+   }
+
+   //Wake up when the oldest datagram being reassembled times out
+   if(frag != NULL)
+   {
+      netScheduleTick(NET_TICK_MODULE_IPV4_FRAG,
+         IPV4_FRAG_TIME_TO_LIVE - (time - frag->timestamp));
    }
 }
 
@@ -557,99 +558,127 @@ void ipv4FragTick(NetInterface *interface)
 Ipv4FragDesc *ipv4SearchFragQueue(NetInterface *interface,
    const Ipv4Header *packet)
 {
-   error_t error;
-   uint_t i;
-   Ipv4Header *datagram;
+   Ipv4Context *context;
    Ipv4FragDesc *frag;
-   Ipv4HoleDesc *hole;
+
+   //Point to the IPv4 context
+   context = &interface->ipv4Context;
 
    //Search for a matching IP datagram being reassembled
-   for(i = 0; i < IPV4_MAX_FRAG_DATAGRAMS; i++)
+   for(frag = context->fragOldest; frag != NULL; frag = frag->next)
    {
-      //Point to the current entry in the reassembly queue
-      frag = &interface->ipv4Context.fragQueue[i];
-
-      //Check whether the current entry is used?
-      if(frag->buffer.chunkCount > 0)
-      {
-         //Point to the corresponding datagram
-         datagram = netBufferAt((NetBuffer *) &frag->buffer, 0, 0);
-
-         //Check source and destination addresses
-         if(datagram->srcAddr != packet->srcAddr)
-            continue;
-         if(datagram->destAddr != packet->destAddr)
-            continue;
-
-         //Compare identification and protocol fields
-         if(datagram->identification != packet->identification)
-            continue;
-         if(datagram->protocol != packet->protocol)
-            continue;
-
-         //A matching entry has been found in the reassembly queue
-         return frag;
-      }
+      //Check source and destination addresses
+      if(frag->srcAddr != packet->srcAddr)
+         continue;
+      if(frag->destAddr != packet->destAddr)
+         continue;
+
+      //Compare identification and protocol fields
+      if(frag->identification != packet->identification)
+         continue;
+      if(frag->protocol != packet->protocol)
+         continue;
+
+      //A matching entry has been found in the reassembly queue
+      return frag;
    }
 
    //If the current packet does not match an existing entry in the reassembly
    //queue, then create a new entry
-   for(i = 0; i < IPV4_MAX_FRAG_DATAGRAMS; i++)
+   frag = context->fragFree;
+
+   //The reassembly queue is full?
+   if(frag == NULL)
+      return NULL;
+
+   //Remove the entry from the free list
+   context->fragFree = frag->next;
+
+   //Save the fields that identify the datagram
+   frag->srcAddr = packet->srcAddr;
+   frag->destAddr = packet->destAddr;
+   frag->identification = packet->identification;
+   frag->protocol = packet->protocol;
+
+   //Copy IPv4 header from the incoming fragment
+   frag->headerLength = packet->headerLength * 4;
+   osMemcpy(frag->data + IPV4_MAX_HEADER_LENGTH - frag->headerLength, packet,
+      frag->headerLength);
+
+   //Initial length of the reconstructed datagram
+   frag->dataLen = 0;
+   //Nothing summed yet
+   frag->checksum = 0;
+   frag->checksumValid = TRUE;
+   //Save current time
+   frag->timestamp = osGetSystemTime();
+   //The reassembly timeout must be checked
+   netScheduleTick(NET_TICK_MODULE_IPV4_FRAG, IPV4_FRAG_TIME_TO_LIVE);
+
+   //The entry describes the datagram as being completely missing
+   frag->holes[0].first = 0;
+   frag->holes[0].last = IPV4_INFINITY;
+   frag->holeCount = 1;
+
+   //Append the entry to the age list
+   frag->prev = context->fragNewest;
+   frag->next = NULL;
+
+   if(context->fragNewest != NULL)
+   {
+      context->fragNewest->next = frag;
+   }
+   else
    {
-      //Point to the current entry in the reassembly queue
-      frag = &interface->ipv4Context.fragQueue[i];
+      context->fragOldest = frag;
+   }
 
-      //The current entry is free?
-      if(!frag->buffer.chunkCount)
-      {
-         //Number of chunks that comprise the reassembly buffer
-         frag->buffer.maxChunkCount = arraysize(frag->buffer.chunk);
-
-         //Allocate sufficient memory to hold the IPv4 header and
-         //the first hole descriptor
-         error = netBufferSetLength((NetBuffer *) &frag->buffer,
-            NET_MEM_POOL_BUFFER_SIZE + sizeof(Ipv4HoleDesc));
-
-         //Failed to allocate memory?
-         if(error)
-         {
-            //Clean up side effects
-            netBufferSetLength((NetBuffer *) &frag->buffer, 0);
-            //Exit immediately
-            return NULL;
-         }
-
-         //Initial length of the reconstructed datagram
-         frag->headerLength = packet->headerLength * 4;
-         frag->dataLen = 0;
-
-         //Fix the length of the first chunk
-         frag->buffer.chunk[0].length = (uint16_t) frag->headerLength;
-         //Copy IPv4 header from the incoming fragment
-         netBufferWrite((NetBuffer *) &frag->buffer, 0, packet, frag->headerLength);
-
-         //Save current time
-         frag->timestamp = osGetSystemTime();
-         //Create a new entry in the hole descriptor list
-         frag->firstHole = 0;
-
-         //Point to first hole descriptor
-         hole = ipv4FindHole(frag, frag->firstHole);
-         //The entry describes the datagram as being completely missing
-         hole->first = 0;
-         hole->last = IPV4_INFINITY;
-         hole->next = IPV4_INFINITY;
-
-         //Dump hole descriptor list
-         ipv4DumpHoleList(frag);
-
-         //Return the matching fragment descriptor
-         return frag;
-      }
+   context->fragNewest = frag;
+
+   //Dump hole descriptor list
+   ipv4DumpHoleList(frag);
+
+   //Return the matching fragment descriptor
+   return frag;
+}
+
+
+/**
+ * @brief Release a reassembly descriptor
+ * @param[in] interface Underlying network interface
+ * @param[in] frag Descriptor to be returned to the free list
+ **/
+
+void ipv4ReleaseFragDesc(NetInterface *interface, Ipv4FragDesc *frag)
+{
+   Ipv4Context *context;
+
+   //Point to the IPv4 context
+   context = &interface->ipv4Context;
+
+   //Remove the entry from the age list
+   if(frag->prev != NULL)
+   {
+      frag->prev->next = frag->next;
+   }
+   else
+   {
+      context->fragOldest = frag->next;
    }
 
-   //The reassembly queue is full
-   return NULL;
+   if(frag->next != NULL)
+   {
+      frag->next->prev = frag->prev;
+   }
+   else
+   {
+      context->fragNewest = frag->prev;
+   }
+
+   //Insert the entry into the free list
+   frag->prev = NULL;
+   frag->next = context->fragFree;
+   context->fragFree = frag;
 }
 
 
@@ -661,12 +690,22 @@ Ipv4FragDesc *ipv4SearchFragQueue(NetInterface *interface,
 void ipv4FlushFragQueue(NetInterface *interface)
 {
    uint_t i;
+   Ipv4Context *context;
+
+   //Point to the IPv4 context
+   context = &interface->ipv4Context;
+
+   //Drop any partially reconstructed datagram
+   context->fragOldest = NULL;
+   context->fragNewest = NULL;
+   context->fragFree = NULL;
 
-   //Loop through the reassembly queue
-   for(i = 0; i < IPV4_MAX_FRAG_DATAGRAMS; i++)
+   //Chain all the descriptors in the free list
+   for(i = IPV4_MAX_FRAG_DATAGRAMS; i > 0; i--)
    {
-      //Drop any partially reconstructed datagram
-      netBufferSetLength((NetBuffer *) &interface->ipv4Context.fragQueue[i].buffer, 0);
+      context->fragQueue[i - 1].prev = NULL;
+      context->fragQueue[i - 1].next = context->fragFree;
+      context->fragFree = &context->fragQueue[i - 1];
    }
 }
 
@@ -674,15 +713,38 @@ void ipv4FlushFragQueue(NetInterface *interface)
 /**
  * @brief Retrieve hole descriptor
  * @param[in] frag IPv4 fragment descriptor
- * @param[in] offset Offset of the hole
- * @return A pointer to the hole descriptor is returned if the specified
- *   offset is valid. Otherwise NULL is returned
+ * @param[in] offset Offset within the datagram
+ * @return Index of the first hole that ends after the specified offset
+ *   (holeCount if there is no such hole)
  **/
 
-Ipv4HoleDesc *ipv4FindHole(Ipv4FragDesc *frag, uint16_t offset)
+uint_t ipv4FindHole(const Ipv4FragDesc *frag, uint16_t offset)
 {
-   //Return a pointer to the hole descriptor
-   return netBufferAt((NetBuffer *) &frag->buffer, frag->headerLength + offset, 0);
+   uint_t left;
+   uint_t right;
+   uint_t middle;
+
+   //The holes are sorted and do not overlap
+   left = 0;
+   right = frag->holeCount;
+
+   //Binary search
+   while(left < right)
+   {
+      middle = (left + right) / 2;
+
+      if(frag->holes[middle].last > offset)
+      {
+         right = middle;
+      }
+      else
+      {
+         left = middle + 1;
+      }
+   }
+
+   //Return the index of the hole
+   return left;
 }
 
 
@@ -691,24 +753,21 @@ Ipv4HoleDesc *ipv4FindHole(Ipv4FragDesc *frag, uint16_t offset)
  * @param[in] frag IPv4 fragment descriptor
  **/
 
-void ipv4DumpHoleList(Ipv4FragDesc *frag)
+void ipv4DumpHoleList(const Ipv4FragDesc *frag)
 {
 //Check debugging level
 #if (TRACE_LEVEL >= TRACE_LEVEL_DEBUG)
-   Ipv4HoleDesc *hole;
+   uint_t i;
 
    //Debug message
    TRACE_DEBUG("Hole descriptor list:\r\n");
-   //Select the first hole descriptor from the list
-   hole = ipv4FindHole(frag, frag->firstHole);
 
    //Loop through the hole descriptor list
-   while(hole != NULL)
+   for(i = 0; i < frag->holeCount; i++)
    {
       //Display current hole
-      TRACE_DEBUG("  %" PRIu16 " - %" PRIu16 "\r\n", hole->first, hole->last);
-      //Select the next hole descriptor from the list
-      hole = ipv4FindHole(frag, hole->next);
+      TRACE_DEBUG("  %" PRIu16 " - %" PRIu16 "\r\n", frag->holes[i].first,
+         frag->holes[i].last);
    }
 #endif
 }
@@ -78,6 +78,18 @@
    #error IPV4_FRAG_TIME_TO_LIVE parameter is not valid
 #endif
 
+//Maximum number of holes tracked per datagram
+#ifndef IPV4_FRAG_MAX_HOLES
+   #define IPV4_FRAG_MAX_HOLES 16
+#elif (IPV4_FRAG_MAX_HOLES < 2)
+   #error IPV4_FRAG_MAX_HOLES parameter is not valid
+#endif
+
+//Size of the reassembly slab. The payload is preceded by room for the
+//largest IP header (60 bytes) and cannot exceed the maximum datagram size
+//minus the minimum header length (20 bytes)
+#define IPV4_FRAG_SLAB_SIZE (IPV4_MAX_FRAG_DATAGRAM_SIZE + 40)
+
 //Infinity is implemented by a very large integer
 #define IPV4_INFINITY 0xFFFF
 
@@ -87,57 +99,42 @@ extern "C" {
 #endif
 
 
-//CC-RX, CodeWarrior or Win32 compiler?
-#if defined(__CCRX__)
-   #pragma pack
-#elif defined(__CWCC__) || defined(_WIN32)
-   #pragma pack(push, 1)
-#endif
-
-
 /**
  * @brief Hole descriptor
  **/
 
-typedef __packed_struct
-{
-   uint16_t first;
-   uint16_t last;
-   uint16_t next;
-} Ipv4HoleDesc;
-
-
-//CC-RX, CodeWarrior or Win32 compiler?
-#if defined(__CCRX__)
-   #pragma unpack
-#elif defined(__CWCC__) || defined(_WIN32)
-   #pragma pack(pop)
-#endif
-
-
-/**
- * @brief Reassembly buffer
- **/
-
 typedef struct
 {
-   uint_t chunkCount;
-   uint_t maxChunkCount;
-   ChunkDesc chunk[N(IPV4_MAX_FRAG_DATAGRAM_SIZE) + 1];
-} Ipv4ReassemblyBuffer;
+   uint16_t first; ///<Index of the first missing byte
+   uint16_t last;  ///<Index immediately following the last missing byte
+} Ipv4HoleDesc;
 
 
 /**
  * @brief Fragmented packet descriptor
+ *
+ * Each descriptor owns a slab large enough for the largest datagram the host
+ * accepts. The payload always starts at offset IPV4_MAX_HEADER_LENGTH and the
+ * IP header is stored right in front of it, so that the reconstructed
+ * datagram is contiguous whatever the length of the options
  **/
 
-typedef struct
+typedef struct _Ipv4FragDesc
 {
-   systime_t timestamp;         ///<Time at which the first fragment was received
-   size_t headerLength;         ///<Length of the header
-   size_t dataLen;              ///<Length of the payload
-   uint16_t firstHole;          ///<Index of the first hole
-   Ipv4ReassemblyBuffer buffer; ///<Buffer containing the reassembled datagram
+   struct _Ipv4FragDesc *prev;           ///<Previous entry in the age list
+   struct _Ipv4FragDesc *next;           ///<Next entry in the age list (or in the free list)
+   systime_t timestamp;                  ///<Time at which the first fragment was received
+   uint32_t srcAddr;                     ///<Source address
+   uint32_t destAddr;                    ///<Destination address
+   uint16_t identification;              ///<Identification field
+   uint8_t protocol;                     ///<Protocol field
+   size_t headerLength;                  ///<Length of the header
+   size_t dataLen;                       ///<Length of the payload
+   uint_t holeCount;                     ///<Number of holes
+   uint32_t checksum;                    ///<Sum of the payload, taken while copying it
+   bool_t checksumValid;                 ///<No fragment overwrote data already summed
+   Ipv4HoleDesc holes[IPV4_FRAG_MAX_HOLES]; ///<Holes, sorted by offset
+   uint8_t data[IPV4_FRAG_SLAB_SIZE];    ///<Reassembly slab
 } Ipv4FragDesc;
 
 
@@ -152,6 +149,8 @@ error_t ipv4FragmentDatagram(NetInterface *interface,
 void ipv4ReassembleDatagram(NetInterface *interface, const Ipv4Header *packet,
    size_t length, NetRxAncillary *ancillary);
 
+bool_t ipv4CheckFragChecksum(const Ipv4FragDesc *frag);
+
 void ipv4FragTick(NetInterface *interface);
 
 Ipv4FragDesc *ipv4SearchFragQueue(NetInterface *interface,
@@ -159,8 +158,10 @@ Ipv4FragDesc *ipv4SearchFragQueue(NetInterface *interface,
 
 void ipv4FlushFragQueue(NetInterface *interface);
 
-Ipv4HoleDesc *ipv4FindHole(Ipv4FragDesc *frag, uint16_t offset);
-void ipv4DumpHoleList(Ipv4FragDesc *frag);
+void ipv4ReleaseFragDesc(NetInterface *interface, Ipv4FragDesc *frag);
+
+uint_t ipv4FindHole(const Ipv4FragDesc *frag, uint16_t offset);
+void ipv4DumpHoleList(const Ipv4FragDesc *frag);
 
 //C++ guard
 #ifdef __cplusplus
@@ -35,6 +35,7 @@
 #include "core/net.h"
 #include "ipv4/ipv4.h"
 #include "ipv4/ipv4_misc.h"
+#include "ipv4/ipv4_pmtu.h"
 #include "mibs/mib2_module.h"
 #include "mibs/ip_mib_module.h"
 #include "debug.h"
@@ -55,14 +56,12 @@ error_t ipv4AddRouterAlertOption(NetBuffer *buffer, size_t *offset)
    error_t error;
    Ipv4RouterAlertOption *option;
 
+   //Make room for the option
+   option = netBufferPush(buffer, offset, sizeof(Ipv4RouterAlertOption));
+
    //Make sure there is sufficient space for the option
-   if(*offset >= sizeof(Ipv4RouterAlertOption))
+   if(option != NULL)
    {
-      //Make room for the option
-      *offset -= sizeof(Ipv4RouterAlertOption);
-      //Point to the option
-      option = netBufferAt(buffer, *offset, 0);
-
       //Format Router Alert option
       option->type = IPV4_OPTION_RTRALT;
       option->length = sizeof(Ipv4RouterAlertOption);
@@ -824,6 +823,57 @@ bool_t ipv4TrapIgmpPacket(Ipv4Header *header)
 }
 
 
+/**
+ * @brief Check whether checksums can be computed by the NIC
+ *
+ * The Ethernet controller is able to insert the IP header checksum and the
+ * TCP/UDP/ICMP checksum on the fly. The payload checksum is not inserted in
+ * IP fragments, so the software calculation is still required when the
+ * datagram has to be fragmented
+ *
+ * @param[in] interface Outgoing network interface
+ * @param[in] length Length of the IPv4 payload
+ * @return TRUE if the checksums are computed by the NIC, else FALSE
+ **/
+
+bool_t ipv4IsChecksumOffloadEnabled(NetInterface *interface, size_t length)
+{
+   bool_t enabled;
+
+   //Checksum offload is disabled by default
+   enabled = FALSE;
+
+#if (ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
+   //Valid interface?
+   if(interface != NULL)
+   {
+      NetInterface *physicalInterface;
+
+      //Point to the physical interface
+      physicalInterface = nicGetPhysicalInterface(interface);
+
+      //Check whether the NIC driver is able to compute checksums
+      if(physicalInterface->nicDriver != NULL &&
+         physicalInterface->nicDriver->txChecksumOffload)
+      {
+         //The datagram must not be fragmented
+#if (IPV4_PMTU_SUPPORT == ENABLED)
+         if((length + sizeof(Ipv4Header)) <= ipv4GetMinPathMtu(interface))
+#else
+         if((length + sizeof(Ipv4Header)) <= interface->ipv4Context.linkMtu)
+#endif
+         {
+            enabled = TRUE;
+         }
+      }
+   }
+#endif
+
+   //Return TRUE if the checksums are computed by the NIC
+   return enabled;
+}
+
+
 /**
  * @brief Update IPv4 input statistics
  * @param[in] interface Underlying network interface
@@ -934,6 +984,7 @@ void ipv4UpdateErrorStats(NetInterface *interface, error_t error)
    case ERROR_INVALID_HEADER:
       //Number of input datagrams discarded due to errors in their IP headers
       MIB2_IP_INC_COUNTER32(ipInHdrErrors, 1);
+      NET_STATS_INC(ipv4InHdrErrors, 1);
       IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsInHdrErrors, 1);
       IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsInHdrErrors, 1);
       break;
@@ -961,6 +1012,14 @@ void ipv4UpdateErrorStats(NetInterface *interface, error_t error)
       IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsInTruncatedPkts, 1);
       break;
 
+   case ERROR_ACCESS_DENIED:
+      //Number of input IP datagrams discarded by the firewall, for which no
+      //problems were encountered to prevent their continued processing
+      MIB2_IP_INC_COUNTER32(ipInDiscards, 1);
+      IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsInDiscards, 1);
+      IP_MIB_INC_COUNTER32(ipv4IfStatsTable[interface->index].ipIfStatsInDiscards, 1);
+      break;
+
    default:
       //Just for sanity
       break;
@@ -67,6 +67,8 @@ error_t ipv4GetBroadcastAddr(NetInterface *interface, Ipv4Addr *addr);
 
 bool_t ipv4TrapIgmpPacket(Ipv4Header *header);
 
+bool_t ipv4IsChecksumOffloadEnabled(NetInterface *interface, size_t length);
+
 void ipv4UpdateInStats(NetInterface *interface, Ipv4Addr destIpAddr,
    size_t length);
 
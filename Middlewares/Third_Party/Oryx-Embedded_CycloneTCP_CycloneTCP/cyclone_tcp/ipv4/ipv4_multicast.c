@@ -117,6 +117,63 @@ error_t ipv4MulticastFilter(NetInterface *interface, Ipv4Addr destAddr,
 }
 
 
+/**
+ * @brief Early filtering of incoming multicast traffic
+ *
+ * Datagrams sent to a group the host did not join (but whose MAC address or
+ * hash bucket is shared with a joined group), or from a source excluded by
+ * the IGMPv3 source filters, are dropped before any IPv4 processing. The
+ * verdict is the one ipv4ProcessPacket would reach; malformed packets are
+ * left to it
+ *
+ * @param[in] interface The interface on which the packet was received
+ * @param[in] packet Incoming IPv4 packet
+ * @param[in] length Packet length including header and payload
+ * @return Error code
+ **/
+
+error_t ipv4MulticastPreFilter(NetInterface *interface,
+   const Ipv4Header *packet, size_t length)
+{
+   error_t error;
+
+   //Initialize status code
+   error = NO_ERROR;
+
+#if !defined(IPV4_PACKET_FORWARD_HOOK)
+   //Well-formed multicast packet?
+   if(length >= sizeof(Ipv4Header) && packet->version == IPV4_VERSION &&
+      ipv4IsMulticastAddr(packet->destAddr))
+   {
+#if (IGMP_ROUTER_SUPPORT == ENABLED)
+      //IGMP router needs to see every multicast packet
+      if(interface->igmpRouterContext != NULL)
+         return NO_ERROR;
+#endif
+#if (IGMP_SNOOPING_SUPPORT == ENABLED)
+      //IGMP snooping switch needs to see every multicast packet
+      if(interface->igmpSnoopingContext != NULL)
+         return NO_ERROR;
+#endif
+
+      //Multicast address and source filtering
+      error = ipv4MulticastFilter(interface, packet->destAddr,
+         packet->srcAddr);
+
+      //Packet to be dropped?
+      if(error)
+      {
+         //Update statistics
+         NET_STATS_IF_INC(interface, rxMcastFiltered, 1);
+      }
+   }
+#endif
+
+   //Return status code
+   return error;
+}
+
+
 /**
  * @brief Join the specified host group
  * @param[in] interface Underlying network interface
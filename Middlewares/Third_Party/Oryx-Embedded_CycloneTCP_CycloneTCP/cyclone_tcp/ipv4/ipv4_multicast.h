@@ -44,6 +44,9 @@ extern "C" {
 error_t ipv4MulticastFilter(NetInterface *interface, Ipv4Addr destAddr,
    Ipv4Addr srcAddr);
 
+error_t ipv4MulticastPreFilter(NetInterface *interface,
+   const Ipv4Header *packet, size_t length);
+
 error_t ipv4JoinMulticastGroup(NetInterface *interface, Ipv4Addr groupAddr);
 error_t ipv4LeaveMulticastGroup(NetInterface *interface, Ipv4Addr groupAddr);
 
@@ -0,0 +1,304 @@
+/**
+ * @file ipv4_pmtu.c
+ * @brief Path MTU discovery for IPv4
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * Unfragmented unicast datagrams are sent with the DF bit set. Routers that
+ * cannot forward them report the MTU of the next hop in an ICMP Destination
+ * Unreachable message, which lowers the path MTU estimate cached for the
+ * destination. Estimates age out so that larger MTUs are discovered again
+ * if the path changes. Refer to RFC 1191 for complete details
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL IPV4_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/tcp_misc.h"
+#include "ipv4/ipv4.h"
+#include "ipv4/ipv4_misc.h"
+#include "ipv4/ipv4_pmtu.h"
+#include "ipv4/icmp.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (IPV4_SUPPORT == ENABLED && IPV4_PMTU_SUPPORT == ENABLED)
+
+//Common MTU values, used when a router does not report the next-hop MTU
+//(refer to RFC 1191, section 7)
+static const uint16_t ipv4MtuPlateaus[] =
+{
+   32000, 17914, 8166, 4352, 2002, 1492, 1006, 508, 296, IPV4_MINIMUM_MTU
+};
+
+
+/**
+ * @brief Retrieve the path MTU for a given destination
+ * @param[in] interface Underlying network interface
+ * @param[in] destAddr Destination IPv4 address
+ * @return Path MTU, never larger than the link MTU
+ **/
+
+size_t ipv4GetPathMtu(NetInterface *interface, Ipv4Addr destAddr)
+{
+   uint_t i;
+   size_t pathMtu;
+   systime_t time;
+   Ipv4PmtuEntry *entry;
+
+   //Default to the MTU of the link
+   pathMtu = interface->ipv4Context.linkMtu;
+   //Get current time
+   time = osGetSystemTime();
+
+   //Loop through the path MTU cache
+   for(i = 0; i < IPV4_PMTU_CACHE_SIZE; i++)
+   {
+      //Point to the current entry
+      entry = &interface->ipv4Context.pmtuCache[i];
+
+      //Matching entry?
+      if(entry->pathMtu != 0 && entry->destAddr == destAddr)
+      {
+         //Stale estimates are discarded so that a larger MTU can be
+         //discovered again
+         if((time - entry->timestamp) >= IPV4_PMTU_TIMEOUT)
+         {
+            entry->pathMtu = 0;
+         }
+         else
+         {
+            pathMtu = MIN(pathMtu, entry->pathMtu);
+         }
+
+         //We are done
+         break;
+      }
+   }
+
+   //Return the path MTU
+   return pathMtu;
+}
+
+
+/**
+ * @brief Retrieve the smallest path MTU in use on an interface
+ *
+ * The destination of a datagram is not known when the transport layer
+ * decides whether to leave the checksum to the NIC, so the smallest
+ * estimate tells which datagrams can never be fragmented
+ *
+ * @param[in] interface Underlying network interface
+ * @return Smallest path MTU, never larger than the link MTU
+ **/
+
+size_t ipv4GetMinPathMtu(NetInterface *interface)
+{
+   uint_t i;
+   size_t pathMtu;
+   Ipv4PmtuEntry *entry;
+
+   //Default to the MTU of the link
+   pathMtu = interface->ipv4Context.linkMtu;
+
+   //Loop through the path MTU cache
+   for(i = 0; i < IPV4_PMTU_CACHE_SIZE; i++)
+   {
+      //Point to the current entry
+      entry = &interface->ipv4Context.pmtuCache[i];
+
+      //Valid estimate?
+      if(entry->pathMtu != 0)
+      {
+         pathMtu = MIN(pathMtu, entry->pathMtu);
+      }
+   }
+
+   //Return the smallest path MTU
+   return pathMtu;
+}
+
+
+/**
+ * @brief Lower the path MTU estimate of a given destination
+ * @param[in] interface Underlying network interface
+ * @param[in] destAddr Destination IPv4 address
+ * @param[in] tentativePathMtu Path MTU reported by a router
+ **/
+
+void ipv4UpdatePathMtu(NetInterface *interface, Ipv4Addr destAddr,
+   size_t tentativePathMtu)
+{
+   uint_t i;
+   systime_t time;
+   Ipv4PmtuEntry *entry;
+#if (TCP_SUPPORT == ENABLED)
+   IpAddr remoteIpAddr;
+#endif
+
+   //A host must never reduce its estimate below the minimum MTU
+   tentativePathMtu = MAX(tentativePathMtu, IPV4_MINIMUM_MTU);
+
+   //A host must not increase its estimate in response to an ICMP message
+   if(tentativePathMtu >= ipv4GetPathMtu(interface, destAddr))
+      return;
+
+   //Get current time
+   time = osGetSystemTime();
+   //Entry to be updated
+   entry = NULL;
+
+   //Search the path MTU cache for the destination
+   for(i = 0; i < IPV4_PMTU_CACHE_SIZE && entry == NULL; i++)
+   {
+      if(interface->ipv4Context.pmtuCache[i].pathMtu != 0 &&
+         interface->ipv4Context.pmtuCache[i].destAddr == destAddr)
+      {
+         entry = &interface->ipv4Context.pmtuCache[i];
+      }
+   }
+
+   //No estimate for the destination yet?
+   if(entry == NULL)
+   {
+      //Use a free entry, or replace the oldest estimate
+      for(i = 0; i < IPV4_PMTU_CACHE_SIZE; i++)
+      {
+         if(interface->ipv4Context.pmtuCache[i].pathMtu == 0)
+         {
+            entry = &interface->ipv4Context.pmtuCache[i];
+            break;
+         }
+
+         if(entry == NULL || (time - interface->ipv4Context.pmtuCache[i].timestamp) >
+            (time - entry->timestamp))
+         {
+            entry = &interface->ipv4Context.pmtuCache[i];
+         }
+      }
+   }
+
+   //Debug message
+   TRACE_INFO("IPv4 path MTU to %s lowered to %" PRIuSIZE " bytes\r\n",
+      ipv4AddrToString(destAddr, NULL), tentativePathMtu);
+
+   //Save the new estimate
+   entry->destAddr = destAddr;
+   entry->pathMtu = tentativePathMtu;
+   entry->timestamp = time;
+
+#if (TCP_SUPPORT == ENABLED)
+   //Connections to the destination must use smaller segments from now on
+   remoteIpAddr.length = sizeof(Ipv4Addr);
+   remoteIpAddr.ipv4Addr = destAddr;
+   tcpProcessPathMtuChange(&remoteIpAddr, tentativePathMtu);
+#endif
+}
+
+
+/**
+ * @brief Flush path MTU cache
+ * @param[in] interface Underlying network interface
+ **/
+
+void ipv4FlushPmtuCache(NetInterface *interface)
+{
+   //Forget all the estimates
+   osMemset(interface->ipv4Context.pmtuCache, 0,
+      sizeof(interface->ipv4Context.pmtuCache));
+}
+
+
+/**
+ * @brief Process a Fragmentation Needed message
+ * @param[in] interface Underlying network interface
+ * @param[in] buffer Multi-part buffer containing the incoming ICMP message
+ * @param[in] offset Offset to the first byte of the ICMP message
+ **/
+
+void ipv4ProcessFragNeeded(NetInterface *interface, const NetBuffer *buffer,
+   size_t offset)
+{
+   uint_t i;
+   size_t length;
+   size_t pathMtu;
+   IcmpDestUnreachableMessage *message;
+   Ipv4Header *header;
+
+   //Retrieve the length of the message
+   length = netBufferGetLength(buffer) - offset;
+
+   //The message must contain the header of the original datagram
+   if(length < (sizeof(IcmpDestUnreachableMessage) + sizeof(Ipv4Header)))
+      return;
+
+   //Point to the ICMP message
+   message = netBufferAt(buffer, offset, length);
+   //Sanity check
+   if(message == NULL)
+      return;
+
+   //Point to the header of the original datagram
+   header = (Ipv4Header *) message->data;
+
+   //Check IP version number
+   if(header->version != IPV4_VERSION)
+      return;
+
+   //The original datagram must have been sent by the host
+   if(ipv4CheckDestAddr(interface, header->srcAddr) != NO_ERROR ||
+      ipv4IsBroadcastAddr(interface, header->srcAddr))
+   {
+      return;
+   }
+
+   //The next-hop MTU is carried in the low-order 16 bits of the unused
+   //field (refer to RFC 1191, section 4)
+   pathMtu = ntohl(message->unused) & 0xFFFF;
+
+   //Routers that predate RFC 1191 leave the field zero
+   if(pathMtu == 0)
+   {
+      //Use the largest plateau value that is less than the total length
+      //of the original datagram
+      for(i = 0; i < (arraysize(ipv4MtuPlateaus) - 1); i++)
+      {
+         if(ipv4MtuPlateaus[i] < ntohs(header->totalLength))
+            break;
+      }
+
+      pathMtu = ipv4MtuPlateaus[i];
+   }
+
+   //Update the path MTU estimate of the destination
+   ipv4UpdatePathMtu(interface, header->destAddr, pathMtu);
+}
+
+#endif
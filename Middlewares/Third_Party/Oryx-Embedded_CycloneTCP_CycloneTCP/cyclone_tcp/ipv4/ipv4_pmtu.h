@@ -0,0 +1,93 @@
+/**
+ * @file ipv4_pmtu.h
+ * @brief Path MTU discovery for IPv4
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+#ifndef _IPV4_PMTU_H
+#define _IPV4_PMTU_H
+
+//Dependencies
+#include "core/net.h"
+
+//Path MTU discovery support
+#ifndef IPV4_PMTU_SUPPORT
+   #define IPV4_PMTU_SUPPORT DISABLED
+#elif (IPV4_PMTU_SUPPORT != ENABLED && IPV4_PMTU_SUPPORT != DISABLED)
+   #error IPV4_PMTU_SUPPORT parameter is not valid
+#endif
+
+//Size of the path MTU cache
+#ifndef IPV4_PMTU_CACHE_SIZE
+   #define IPV4_PMTU_CACHE_SIZE 8
+#elif (IPV4_PMTU_CACHE_SIZE < 1)
+   #error IPV4_PMTU_CACHE_SIZE parameter is not valid
+#endif
+
+//Lifetime of a path MTU estimate (refer to RFC 1191, section 6.3)
+#ifndef IPV4_PMTU_TIMEOUT
+   #define IPV4_PMTU_TIMEOUT 600000
+#elif (IPV4_PMTU_TIMEOUT < 1000)
+   #error IPV4_PMTU_TIMEOUT parameter is not valid
+#endif
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Path MTU cache entry
+ **/
+
+typedef struct
+{
+   uint32_t destAddr;   ///<Destination address
+   size_t pathMtu;      ///<Path MTU reported for the destination
+   systime_t timestamp; ///<Time at which the estimate was last lowered
+} Ipv4PmtuEntry;
+
+
+//Path MTU discovery related functions
+size_t ipv4GetPathMtu(NetInterface *interface, uint32_t destAddr);
+size_t ipv4GetMinPathMtu(NetInterface *interface);
+
+void ipv4UpdatePathMtu(NetInterface *interface, uint32_t destAddr,
+   size_t tentativePathMtu);
+
+void ipv4FlushPmtuCache(NetInterface *interface);
+
+void ipv4ProcessFragNeeded(NetInterface *interface, const NetBuffer *buffer,
+   size_t offset);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,778 @@
+/**
+ * @file ipv4_routing.c
+ * @brief IPv4 routing
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * Unicast packets received on an interface where routing is enabled, and
+ * not addressed to the host, are forwarded to the network they belong to:
+ * directly if it is attached to another routing interface, through the
+ * next hop of the longest matching route otherwise. The route selected for
+ * a destination is kept in a small hashed cache, so that the packets of a
+ * flow skip the lookup. When the incoming and outgoing interfaces are both
+ * Ethernet, the packet is sent from the receive buffer, its Ethernet header
+ * rewritten in place and its TTL decremented with an incremental update of
+ * the header checksum (refer to RFC 1624). Multicast and broadcast packets
+ * are not forwarded
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL IPV4_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/ethernet.h"
+#include "ipv4/ipv4.h"
+#include "ipv4/ipv4_misc.h"
+#include "ipv4/ipv4_routing.h"
+#include "ipv4/icmp.h"
+#include "ipv4/arp.h"
+#include "mibs/mib2_module.h"
+#include "mibs/ip_mib_module.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (IPV4_SUPPORT == ENABLED && IPV4_ROUTING_SUPPORT == ENABLED)
+
+//IPv4 routing table
+static Ipv4RoutingTableEntry ipv4RoutingTable[IPV4_ROUTING_TABLE_SIZE];
+//Forwarding cache
+static Ipv4RoutingCacheEntry ipv4RoutingCache[IPV4_ROUTING_CACHE_SIZE];
+//Forwarding statistics
+static Ipv4RoutingStats ipv4RoutingStats;
+
+
+/**
+ * @brief Flush the forwarding cache
+ **/
+
+static void ipv4FlushRoutingCache(void)
+{
+   //The routes must be looked up again
+   osMemset(ipv4RoutingCache, 0, sizeof(ipv4RoutingCache));
+}
+
+
+/**
+ * @brief Index of a destination in the forwarding cache
+ * @param[in] destAddr Destination address
+ * @return Index of the cache entry
+ **/
+
+static uint_t ipv4GetRoutingCacheIndex(Ipv4Addr destAddr)
+{
+   uint32_t h;
+
+   //Fold the address onto the size of the cache
+   h = (uint32_t) destAddr;
+   h ^= h >> 16;
+   h ^= h >> 8;
+
+   //Return the index of the entry
+   return h & (IPV4_ROUTING_CACHE_SIZE - 1);
+}
+
+
+/**
+ * @brief Select the outgoing interface and the next hop of a destination
+ * @param[in] destAddr Destination address
+ * @param[out] interface Outgoing network interface
+ * @param[out] nextHop Next hop
+ * @return Error code
+ **/
+
+static error_t ipv4LookupRoute(Ipv4Addr destAddr, NetInterface **interface,
+   Ipv4Addr *nextHop)
+{
+   uint_t i;
+   NetInterface *destInterface;
+   Ipv4RoutingCacheEntry *cacheEntry;
+   Ipv4RoutingTableEntry *entry;
+   Ipv4RoutingTableEntry *bestEntry;
+
+   //Point to the cache entry of the destination
+   cacheEntry = &ipv4RoutingCache[ipv4GetRoutingCacheIndex(destAddr)];
+
+   //Route already known?
+   if(cacheEntry->interface != NULL && cacheEntry->destAddr == destAddr)
+   {
+      //Update statistics
+      ipv4RoutingStats.cacheHits++;
+
+      //Use the cached route
+      *interface = cacheEntry->interface;
+      *nextHop = cacheEntry->nextHop;
+
+      //Successful processing
+      return NO_ERROR;
+   }
+
+   //Update statistics
+   ipv4RoutingStats.cacheMisses++;
+
+   //Initialize variables
+   destInterface = NULL;
+   bestEntry = NULL;
+
+   //Networks attached to a routing interface are reached directly
+   for(i = 0; i < NET_INTERFACE_COUNT && destInterface == NULL; i++)
+   {
+      if(netInterface[i].ipv4Context.isRouter &&
+         ipv4IsOnLink(&netInterface[i], destAddr))
+      {
+         destInterface = &netInterface[i];
+         *nextHop = destAddr;
+      }
+   }
+
+   //Other networks are reached through the longest matching route, the
+   //lowest metric breaking ties
+   if(destInterface == NULL)
+   {
+      //Loop through the routing table
+      for(i = 0; i < IPV4_ROUTING_TABLE_SIZE; i++)
+      {
+         //Point to the current entry
+         entry = &ipv4RoutingTable[i];
+
+         //Matching route through a routing interface?
+         if(entry->valid && entry->interface->ipv4Context.isRouter &&
+            (destAddr & entry->networkMask) == entry->networkDest)
+         {
+            //Better than the best route so far?
+            if(bestEntry == NULL ||
+               ntohl(entry->networkMask) > ntohl(bestEntry->networkMask) ||
+               (entry->networkMask == bestEntry->networkMask &&
+               entry->metric < bestEntry->metric))
+            {
+               bestEntry = entry;
+            }
+         }
+      }
+
+      //No matching route?
+      if(bestEntry == NULL)
+         return ERROR_NO_ROUTE;
+
+      //Outgoing interface
+      destInterface = bestEntry->interface;
+
+      //Directly connected network?
+      if(bestEntry->nextHop == IPV4_UNSPECIFIED_ADDR)
+      {
+         *nextHop = destAddr;
+      }
+      else
+      {
+         *nextHop = bestEntry->nextHop;
+      }
+   }
+
+   //Save the route in the cache
+   cacheEntry->destAddr = destAddr;
+   cacheEntry->interface = destInterface;
+   cacheEntry->nextHop = *nextHop;
+
+   //Return the outgoing interface
+   *interface = destInterface;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Check whether a packet can be sent from its receive buffer
+ * @param[in] srcInterface Network interface on which the packet was received
+ * @param[in] destInterface Outgoing network interface
+ * @param[in] ipPacket Multi-part buffer that holds the IPv4 packet
+ * @param[in] ipPacketOffset Offset to the first byte of the IPv4 packet
+ * @return TRUE if the Ethernet header can be written in front of the packet
+ **/
+
+static bool_t ipv4CanForwardInPlace(NetInterface *srcInterface,
+   NetInterface *destInterface, const NetBuffer *ipPacket,
+   size_t ipPacketOffset)
+{
+   NetInterface *physicalInterface;
+
+   //The packet must lie in a single chunk
+   if(ipPacket->chunkCount != 1 || ipPacketOffset != 0)
+      return FALSE;
+
+   //A packet received on an Ethernet interface is preceded by the Ethernet
+   //header of its frame
+   physicalInterface = nicGetPhysicalInterface(srcInterface);
+
+   if(physicalInterface->nicDriver == NULL ||
+      physicalInterface->nicDriver->type != NIC_TYPE_ETHERNET)
+   {
+      return FALSE;
+   }
+
+   //The outgoing NIC must pad the frame and append the CRC, since there is
+   //no room behind the packet
+   physicalInterface = nicGetPhysicalInterface(destInterface);
+
+   if(!physicalInterface->nicDriver->autoPadding ||
+      !physicalInterface->nicDriver->autoCrcCalc)
+   {
+      return FALSE;
+   }
+
+#if (ETH_PORT_TAGGING_SUPPORT == ENABLED)
+   //Switch port tags need more headroom
+   if(physicalInterface->switchDriver != NULL &&
+      physicalInterface->switchDriver->tagFrame != NULL)
+   {
+      return FALSE;
+   }
+#endif
+
+#if (ETH_VMAN_SUPPORT == ENABLED)
+   //VMAN tags are inserted in the frame
+   if(nicGetVmanId(destInterface) != 0)
+      return FALSE;
+#endif
+
+#if (ETH_VLAN_SUPPORT == ENABLED)
+   //VLAN tags must be inserted by the NIC
+   if(nicGetVlanId(destInterface) != 0 &&
+      !physicalInterface->nicDriver->vlanTagInsertion)
+   {
+      return FALSE;
+   }
+#endif
+
+   //Only the Ethernet header has to be written
+   return TRUE;
+}
+
+
+/**
+ * @brief Initialize IPv4 routing table
+ * @return Error code
+ **/
+
+error_t ipv4InitRouting(void)
+{
+   //Clear the routing table
+   osMemset(ipv4RoutingTable, 0, sizeof(ipv4RoutingTable));
+   //Clear the forwarding cache
+   ipv4FlushRoutingCache();
+   //Clear statistics
+   osMemset(&ipv4RoutingStats, 0, sizeof(ipv4RoutingStats));
+
+   //Successful initialization
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Enable routing for the specified interface
+ * @param[in] interface Underlying network interface
+ * @param[in] enable When the flag is set to TRUE, routing is enabled on the
+ *   interface and the router can forward packets to or from the interface
+ * @return Error code
+ **/
+
+error_t ipv4EnableRouting(NetInterface *interface, bool_t enable)
+{
+   //Check parameters
+   if(interface == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Enable or disable routing
+   interface->ipv4Context.isRouter = enable;
+   //The cached routes may go through the interface
+   ipv4FlushRoutingCache();
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Add a new entry in the IPv4 routing table
+ * @param[in] networkDest Network destination
+ * @param[in] networkMask Subnet mask for this route
+ * @param[in] interface Outgoing network interface
+ * @param[in] nextHop Next hop (unspecified for a directly connected network)
+ * @param[in] metric Metric value
+ * @return Error code
+ **/
+
+error_t ipv4AddRoute(Ipv4Addr networkDest, Ipv4Addr networkMask,
+   NetInterface *interface, Ipv4Addr nextHop, uint_t metric)
+{
+   error_t error;
+   uint_t i;
+   Ipv4RoutingTableEntry *entry;
+   Ipv4RoutingTableEntry *firstFreeEntry;
+
+   //Check parameters
+   if(interface == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //The host bits of the destination are ignored
+   networkDest &= networkMask;
+
+   //Keep track of the first free entry
+   firstFreeEntry = NULL;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Loop through the routing table
+   for(i = 0; i < IPV4_ROUTING_TABLE_SIZE; i++)
+   {
+      //Point to the current entry
+      entry = &ipv4RoutingTable[i];
+
+      //Valid entry?
+      if(entry->valid)
+      {
+         //An existing route is updated
+         if(entry->networkDest == networkDest &&
+            entry->networkMask == networkMask)
+         {
+            break;
+         }
+      }
+      else
+      {
+         //Keep track of the first free entry
+         if(firstFreeEntry == NULL)
+         {
+            firstFreeEntry = entry;
+         }
+      }
+   }
+
+   //No existing route?
+   if(i >= IPV4_ROUTING_TABLE_SIZE)
+   {
+      entry = firstFreeEntry;
+   }
+
+   //Any entry available?
+   if(entry != NULL)
+   {
+      //Save the route
+      entry->networkDest = networkDest;
+      entry->networkMask = networkMask;
+      entry->interface = interface;
+      entry->nextHop = nextHop;
+      entry->metric = metric;
+      entry->valid = TRUE;
+
+      //The cached routes may be superseded
+      ipv4FlushRoutingCache();
+
+      //Successful processing
+      error = NO_ERROR;
+   }
+   else
+   {
+      //The routing table is full
+      error = ERROR_TABLE_FULL;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Remove an entry from the IPv4 routing table
+ * @param[in] networkDest Network destination
+ * @param[in] networkMask Subnet mask for this route
+ * @return Error code
+ **/
+
+error_t ipv4DeleteRoute(Ipv4Addr networkDest, Ipv4Addr networkMask)
+{
+   error_t error;
+   uint_t i;
+   Ipv4RoutingTableEntry *entry;
+
+   //The host bits of the destination are ignored
+   networkDest &= networkMask;
+   //Initialize status code
+   error = ERROR_NOT_FOUND;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Loop through the routing table
+   for(i = 0; i < IPV4_ROUTING_TABLE_SIZE; i++)
+   {
+      //Point to the current entry
+      entry = &ipv4RoutingTable[i];
+
+      //Matching route?
+      if(entry->valid && entry->networkDest == networkDest &&
+         entry->networkMask == networkMask)
+      {
+         //Delete the route
+         entry->valid = FALSE;
+         //The cached routes may go through it
+         ipv4FlushRoutingCache();
+
+         //Successful processing
+         error = NO_ERROR;
+         break;
+      }
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Delete all the routes from the IPv4 routing table
+ * @return Error code
+ **/
+
+error_t ipv4DeleteAllRoutes(void)
+{
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Clear the routing table
+   osMemset(ipv4RoutingTable, 0, sizeof(ipv4RoutingTable));
+   //Clear the forwarding cache
+   ipv4FlushRoutingCache();
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Forward an IPv4 packet
+ * @param[in] srcInterface Network interface on which the packet was received
+ * @param[in] ipPacket Multi-part buffer that holds the IPv4 packet
+ * @param[in] ipPacketOffset Offset to the first byte of the IPv4 packet
+ * @return Error code
+ **/
+
+error_t ipv4ForwardPacket(NetInterface *srcInterface, const NetBuffer *ipPacket,
+   size_t ipPacketOffset)
+{
+   error_t error;
+   size_t length;
+   size_t offset;
+   uint16_t word;
+   uint32_t checksum;
+   Ipv4Header *header;
+   Ipv4Addr destIpAddr;
+   Ipv4Addr nextHop;
+   NetInterface *destInterface;
+   NetInterface *physicalInterface;
+   NetBuffer *buffer;
+   NetBuffer1 frame;
+   NetTxAncillary ancillary;
+
+   //Routing must be enabled on the interface the packet came from
+   if(!srcInterface->ipv4Context.isRouter)
+      return ERROR_NOT_CONFIGURED;
+
+   //Point to the IPv4 header (the version, the header length and the total
+   //length have been checked already)
+   header = netBufferAt(ipPacket, ipPacketOffset, sizeof(Ipv4Header));
+   //Sanity check
+   if(header == NULL)
+      return ERROR_INVALID_LENGTH;
+
+   //The whole header must be contiguous
+   if(netBufferAt(ipPacket, ipPacketOffset, header->headerLength * 4) == NULL)
+      return ERROR_INVALID_LENGTH;
+
+   //Get the destination address
+   destIpAddr = header->destAddr;
+
+   //Only unicast packets are forwarded
+   if(ipv4IsMulticastAddr(destIpAddr) ||
+      ipv4IsBroadcastAddr(srcInterface, destIpAddr))
+   {
+      return ERROR_INVALID_ADDRESS;
+   }
+
+   //Packets with a link-local source or destination address must not be
+   //forwarded (refer to RFC 3927, section 2.7)
+   if(ipv4IsLinkLocalAddr(destIpAddr) || ipv4IsLinkLocalAddr(header->srcAddr))
+      return ERROR_INVALID_ADDRESS;
+
+   //The header checksum is verified by ipv4ProcessPacket() only once the
+   //forwarding decision is made
+   if(ipCalcChecksum(header, header->headerLength * 4) != 0x0000)
+   {
+      //Update statistics
+      ipv4RoutingStats.headerErrors++;
+      //Discard the packet
+      return ERROR_INVALID_HEADER;
+   }
+
+   //Length of the packet, without the padding of short frames
+   length = ntohs(header->totalLength);
+
+   //The packet must be discarded if its TTL would reach zero
+   if(header->timeToLive <= 1)
+   {
+      //Update statistics
+      ipv4RoutingStats.ttlExceeded++;
+      MIB2_IP_INC_COUNTER32(ipInHdrErrors, 1);
+      IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsInHdrErrors, 1);
+
+      //Report the discard to the source (refer to RFC 1812, section 5.3.1)
+      icmpSendErrorMessage(srcInterface, ICMP_TYPE_TIME_EXCEEDED,
+         ICMP_CODE_TTL_EXCEEDED, 0, ipPacket, ipPacketOffset);
+
+      //Discard the packet
+      return ERROR_INVALID_HEADER;
+   }
+
+   //Select the outgoing interface and the next hop
+   error = ipv4LookupRoute(destIpAddr, &destInterface, &nextHop);
+
+   //No route to the destination?
+   if(error)
+   {
+      //Update statistics
+      ipv4RoutingStats.noRoute++;
+      MIB2_IP_INC_COUNTER32(ipOutNoRoutes, 1);
+      IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsOutNoRoutes, 1);
+
+      //Report the discard to the source
+      icmpSendErrorMessage(srcInterface, ICMP_TYPE_DEST_UNREACHABLE,
+         ICMP_CODE_NET_UNREACHABLE, 0, ipPacket, ipPacketOffset);
+
+      //Discard the packet
+      return error;
+   }
+
+   //Point to the physical interface
+   physicalInterface = nicGetPhysicalInterface(destInterface);
+
+   //Packets are only forwarded to Ethernet interfaces
+   if(physicalInterface->nicDriver == NULL ||
+      physicalInterface->nicDriver->type != NIC_TYPE_ETHERNET)
+   {
+      //Update statistics
+      ipv4RoutingStats.noRoute++;
+      //Discard the packet
+      return ERROR_NO_ROUTE;
+   }
+
+   //Larger than the MTU of the outgoing link? Such packets are not
+   //fragmented by the router
+   if(length > destInterface->ipv4Context.linkMtu)
+   {
+      //Update statistics
+      ipv4RoutingStats.tooBig++;
+      MIB2_IP_INC_COUNTER32(ipFragFails, 1);
+      IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsOutFragFails, 1);
+
+      //The source of a packet marked "don't fragment" is told to lower its
+      //path MTU
+      if((ntohs(header->fragmentOffset) & IPV4_FLAG_DF) != 0)
+      {
+         icmpSendErrorMessage(srcInterface, ICMP_TYPE_DEST_UNREACHABLE,
+            ICMP_CODE_FRAG_NEEDED_AND_DF_SET, 0, ipPacket, ipPacketOffset);
+      }
+
+      //Discard the packet
+      return ERROR_MESSAGE_TOO_LONG;
+   }
+
+   //Decrement the TTL and update the header checksum incrementally, the TTL
+   //sharing a 16-bit word with the protocol field (refer to RFC 1624,
+   //section 3)
+   word = (header->timeToLive << 8) | header->protocol;
+   checksum = (uint16_t) ~ntohs(header->headerChecksum);
+   checksum += (uint16_t) ~word;
+   checksum += (uint16_t) (word - 0x0100);
+   checksum = (checksum & 0xFFFF) + (checksum >> 16);
+   checksum = (checksum & 0xFFFF) + (checksum >> 16);
+
+   header->timeToLive--;
+   header->headerChecksum = htons((uint16_t) ~checksum);
+
+   //Can the Ethernet header be written in front of the packet?
+   if(ipv4CanForwardInPlace(srcInterface, destInterface, ipPacket,
+      ipPacketOffset))
+   {
+      //The frame is sent from the receive buffer
+      frame.chunkCount = 1;
+      frame.maxChunkCount = 1;
+      frame.chunk[0].address = (uint8_t *) header - sizeof(EthHeader);
+      frame.chunk[0].length = (uint16_t) (length + sizeof(EthHeader));
+      frame.chunk[0].size = 0;
+
+      //Point to the packet
+      buffer = (NetBuffer *) &frame;
+      offset = sizeof(EthHeader);
+
+      //Update statistics
+      ipv4RoutingStats.inPlace++;
+   }
+   else
+   {
+      //Allocate a buffer with room for the link-layer headers
+      buffer = ethAllocBuffer(length, &offset);
+      //Failed to allocate memory?
+      if(buffer == NULL)
+      {
+         //Update statistics
+         ipv4RoutingStats.txErrors++;
+         //Discard the packet
+         return ERROR_OUT_OF_MEMORY;
+      }
+
+      //Copy the packet
+      netBufferCopy(buffer, offset, ipPacket, ipPacketOffset, length);
+   }
+
+   //Additional options passed to the stack along with the packet
+   ancillary = NET_DEFAULT_TX_ANCILLARY;
+   //The priority of the packet is kept
+   ancillary.tos = header->typeOfService;
+
+   //Resolve the next hop
+   error = arpResolve(destInterface, nextHop, &ancillary.destMacAddr);
+
+   //Successful address resolution?
+   if(error == NO_ERROR)
+   {
+      //Debug message
+      TRACE_DEBUG("Forwarding IPv4 packet (%" PRIuSIZE " bytes)...\r\n", length);
+
+      //Send Ethernet frame
+      error = ethSendFrame(destInterface, &ancillary.destMacAddr,
+         ETH_TYPE_IPV4, buffer, offset, &ancillary);
+   }
+   else if(error == ERROR_IN_PROGRESS)
+   {
+      //The packet is copied to the queue of the ARP entry
+      error = arpEnqueuePacket(destInterface, nextHop, buffer, offset,
+         &ancillary);
+   }
+   else
+   {
+      //Debug message
+      TRACE_WARNING("Cannot map IPv4 address to Ethernet address!\r\n");
+   }
+
+   //Update statistics
+   if(!error)
+   {
+      ipv4RoutingStats.forwarded++;
+      MIB2_IP_INC_COUNTER32(ipForwDatagrams, 1);
+      IP_MIB_INC_COUNTER32(ipv4SystemStats.ipSystemStatsOutForwDatagrams, 1);
+      IP_MIB_INC_COUNTER64(ipv4SystemStats.ipSystemStatsHCOutForwDatagrams, 1);
+   }
+   else
+   {
+      ipv4RoutingStats.txErrors++;
+   }
+
+   //Release the copy, if any
+   if(buffer != (NetBuffer *) &frame)
+   {
+      netBufferFree(buffer);
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Get an entry of the IPv4 routing table
+ * @param[in] index Index of the entry
+ * @param[out] entry Copy of the entry
+ * @return Error code
+ **/
+
+error_t ipv4GetRoute(uint_t index, Ipv4RoutingTableEntry *entry)
+{
+   error_t error;
+
+   //Check parameters
+   if(index >= IPV4_ROUTING_TABLE_SIZE || entry == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Copy the entry
+   *entry = ipv4RoutingTable[index];
+   //Free entry?
+   error = entry->valid ? NO_ERROR : ERROR_NOT_FOUND;
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Get forwarding statistics
+ * @param[out] stats Copy of the counters
+ **/
+
+void ipv4GetRoutingStats(Ipv4RoutingStats *stats)
+{
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Copy the counters
+   *stats = ipv4RoutingStats;
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+}
+
+#endif
@@ -49,6 +49,14 @@
    #error IPV4_ROUTING_TABLE_SIZE parameter is not valid
 #endif
 
+//Size of the forwarding cache (must be a power of two)
+#ifndef IPV4_ROUTING_CACHE_SIZE
+   #define IPV4_ROUTING_CACHE_SIZE 16
+#elif (IPV4_ROUTING_CACHE_SIZE < 1 || \
+   (IPV4_ROUTING_CACHE_SIZE & (IPV4_ROUTING_CACHE_SIZE - 1)) != 0)
+   #error IPV4_ROUTING_CACHE_SIZE parameter is not valid
+#endif
+
 //C++ guard
 #ifdef __cplusplus
 extern "C" {
@@ -70,6 +78,39 @@ typedef struct
 } Ipv4RoutingTableEntry;
 
 
+/**
+ * @brief Forwarding cache entry
+ *
+ * The route selected for a destination is remembered until the routing
+ * table changes
+ **/
+
+typedef struct
+{
+   Ipv4Addr destAddr;       ///<Destination address
+   NetInterface *interface; ///<Outgoing network interface (NULL if the entry is free)
+   Ipv4Addr nextHop;        ///<Next hop
+} Ipv4RoutingCacheEntry;
+
+
+/**
+ * @brief Forwarding statistics
+ **/
+
+typedef struct
+{
+   uint32_t forwarded;    ///<Packets forwarded
+   uint32_t inPlace;      ///<Packets sent from the receive buffer, without copy
+   uint32_t cacheHits;    ///<Routes found in the forwarding cache
+   uint32_t cacheMisses;  ///<Routes looked up in the routing table
+   uint32_t noRoute;      ///<Packets dropped because no route matched
+   uint32_t ttlExceeded;  ///<Packets dropped because their TTL expired
+   uint32_t tooBig;       ///<Packets dropped because they exceed the MTU
+   uint32_t headerErrors; ///<Packets dropped because of a bad header checksum
+   uint32_t txErrors;     ///<Packets that could not be sent
+} Ipv4RoutingStats;
+
+
 //IPv4 routing related functions
 error_t ipv4InitRouting(void);
 error_t ipv4EnableRouting(NetInterface *interface, bool_t enable);
@@ -83,6 +124,9 @@ error_t ipv4DeleteAllRoutes(void);
 error_t ipv4ForwardPacket(NetInterface *srcInterface, const NetBuffer *ipPacket,
    size_t ipPacketOffset);
 
+error_t ipv4GetRoute(uint_t index, Ipv4RoutingTableEntry *entry);
+void ipv4GetRoutingStats(Ipv4RoutingStats *stats);
+
 //C++ guard
 #ifdef __cplusplus
 }
@@ -55,6 +55,13 @@
    #error NDP_NEIGHBOR_CACHE_SIZE parameter is not valid
 #endif
 
+//Number of hash buckets of the Neighbor Cache (power of two)
+#ifndef NDP_HASH_TABLE_SIZE
+   #define NDP_HASH_TABLE_SIZE 8
+#elif (NDP_HASH_TABLE_SIZE < 1 || (NDP_HASH_TABLE_SIZE & (NDP_HASH_TABLE_SIZE - 1)) != 0)
+   #error NDP_HASH_TABLE_SIZE parameter is not valid
+#endif
+
 //Destination cache size
 #ifndef NDP_DEST_CACHE_SIZE
    #define NDP_DEST_CACHE_SIZE 8
@@ -543,16 +550,20 @@ typedef struct
 
 /**
  * @brief Neighbor cache entry
+ *
+ * Entries are chained in the hash bucket of their IPv6 address
  **/
 
-typedef struct
+typedef struct _NdpNeighborCacheEntry
 {
    NdpState state;                              ///<Reachability state
    Ipv6Addr ipAddr;                             ///<Unicast IPv6 address
    MacAddr macAddr;                             ///<Link layer address associated with the IPv6 address
    bool_t isRouter;                             ///<A flag indicating whether the neighbor is a router or a host
+   struct _NdpNeighborCacheEntry *hashNext;     ///<Next entry in the same hash bucket
    systime_t timestamp;                         ///<Timestamp to manage entry lifetime
    systime_t timeout;                           ///<Timeout value
+   systime_t lastUsed;                          ///<Time of the last successful resolution, for LRU eviction
    uint_t retransmitCount;                      ///<Retransmission counter
    NdpQueueItem queue[NDP_MAX_PENDING_PACKETS]; ///<Packets waiting for address resolution to complete
    uint_t queueSize;                            ///<Number of queued packets
@@ -591,6 +602,7 @@ typedef struct
    systime_t timeout;                                            ///<Timeout value
    bool_t enable;                                                ///<Enable address resolution using Neighbor Discovery protocol
    NdpNeighborCacheEntry neighborCache[NDP_NEIGHBOR_CACHE_SIZE]; ///<Neighbor cache
+   NdpNeighborCacheEntry *neighborHashTable[NDP_HASH_TABLE_SIZE]; ///<Hash buckets of the Neighbor Cache
    NdpDestCacheEntry destCache[NDP_DEST_CACHE_SIZE];             ///<Destination cache
 } NdpContext;
 
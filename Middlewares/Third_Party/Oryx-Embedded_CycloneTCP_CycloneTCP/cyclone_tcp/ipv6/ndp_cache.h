@@ -41,9 +41,12 @@ extern "C" {
 #endif
 
 //NDP related functions
+uint_t ndpHashAddr(const Ipv6Addr *ipAddr);
+
 void ndpChangeState(NdpNeighborCacheEntry *entry, NdpState newState);
 
-NdpNeighborCacheEntry *ndpCreateNeighborCacheEntry(NetInterface *interface);
+NdpNeighborCacheEntry *ndpCreateNeighborCacheEntry(NetInterface *interface,
+   const Ipv6Addr *ipAddr);
 
 NdpNeighborCacheEntry *ndpFindNeighborCacheEntry(NetInterface *interface,
    const Ipv6Addr *ipAddr);
@@ -80,6 +80,8 @@ error_t mdnsClientResolve(NetInterface *interface, const char_t *name,
       {
          //Return the corresponding IP address
          *ipAddr = entry->ipAddr;
+         //A passive entry in use is no longer evicted by other answers
+         entry->used = TRUE;
          //Successful host name resolution
          error = NO_ERROR;
       }
@@ -92,10 +94,8 @@ error_t mdnsClientResolve(NetInterface *interface, const char_t *name,
    else
    {
       //If no entry exists, then create a new one
-      entry = dnsCreateEntry();
-
-      //Record the host name whose IP address is unknown
-      osStrcpy(entry->name, name);
+      //and record the host name whose IP address is unknown
+      entry = dnsCreateEntry(name);
 
       //Initialize DNS cache entry
       entry->type = type;
@@ -246,8 +246,169 @@ error_t mdnsClientSendQuery(DnsCacheEntry *entry)
 }
 
 
+/**
+ * @brief Decode the name of a resource record
+ * @param[in] message Pointer to the mDNS message
+ * @param[in] pos Offset of the encoded name
+ * @param[out] name Buffer of DNS_MAX_NAME_LEN + 1 characters
+ * @return TRUE if the name was decoded, FALSE if it is malformed or too long
+ **/
+
+static bool_t mdnsClientParseName(const MdnsMessage *message, size_t pos,
+   char_t *name)
+{
+   size_t n;
+   size_t length;
+   uint_t pointers;
+   const uint8_t *src;
+
+   //Cast the mDNS message to byte array
+   src = (const uint8_t *) message->dnsHeader;
+
+   //Decode the labels, following the compression pointers
+   for(length = 0, pointers = 0; pos < message->length; )
+   {
+      //End marker found?
+      if(src[pos] == 0)
+      {
+         //Properly terminate the string
+         name[length] = '\0';
+         return (length > 0) ? TRUE : FALSE;
+      }
+      //Compression tag found?
+      else if(src[pos] >= DNS_COMPRESSION_TAG)
+      {
+         //Malformed mDNS message or pointer loop?
+         if((pos + 1) >= message->length || ++pointers > DNS_NAME_MAX_RECURSION)
+            return FALSE;
+
+         //Jump to the remaining part of the name
+         pos = ((src[pos] & ~DNS_COMPRESSION_TAG) << 8) | src[pos + 1];
+      }
+      //Valid label length?
+      else if(src[pos] < DNS_LABEL_MAX_SIZE)
+      {
+         //Get the length of the current label
+         n = src[pos++];
+
+         //Malformed mDNS message?
+         if((pos + n) > message->length)
+            return FALSE;
+
+         //Names longer than the cache entries are not cached
+         if((length + (length > 0 ? 1 : 0) + n) > DNS_MAX_NAME_LEN)
+            return FALSE;
+
+         //Append a separator if necessary
+         if(length > 0)
+            name[length++] = '.';
+
+         //Copy current label
+         osMemcpy(name + length, src + pos, n);
+         length += n;
+         pos += n;
+      }
+      //Invalid label length?
+      else
+      {
+         return FALSE;
+      }
+   }
+
+   //Malformed mDNS message
+   return FALSE;
+}
+
+
+/**
+ * @brief Apply an address record to a DNS cache entry
+ *
+ * The semantics of RFC 6762 are followed: a record with a zero TTL (goodbye
+ * packet) removes the address one second later (section 10.1), and a record
+ * with the cache-flush bit set replaces an address received more than one
+ * second earlier (section 10.2). A record of a shared set that carries
+ * another address leaves the entry as it is, since an entry holds one
+ * address only
+ *
+ * @param[in] entry Pointer to a DNS cache entry
+ * @param[in] ipAddr Address carried by the record
+ * @param[in] ttl TTL of the record, in seconds
+ * @param[in] cacheFlush The cache-flush bit of the record is set
+ **/
+
+static void mdnsClientUpdateEntry(DnsCacheEntry *entry, const IpAddr *ipAddr,
+   uint32_t ttl, bool_t cacheFlush)
+{
+   systime_t time;
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //mDNS name resolution in progress?
+   if(entry->state == DNS_STATE_IN_PROGRESS)
+   {
+      //A goodbye packet does not resolve the name
+      if(ttl == 0)
+         return;
+   }
+   //Name already resolved?
+   else if(entry->state == DNS_STATE_RESOLVED)
+   {
+      //Same address?
+      if(ipCompAddr(&entry->ipAddr, ipAddr))
+      {
+         //Goodbye packet?
+         if(ttl == 0)
+         {
+            //The record is deleted one second later
+            entry->timestamp = time;
+            entry->timeout = MDNS_CLIENT_GOODBYE_DELAY;
+            return;
+         }
+      }
+      else
+      {
+         //Another address of a shared record set?
+         if(!cacheFlush || ttl == 0)
+            return;
+
+         //Records received in the last second are not flushed
+         if(timeCompare(time, entry->timestamp + 1000) < 0)
+            return;
+      }
+   }
+   else
+   {
+      //Permanent entries are never updated
+      return;
+   }
+
+   //Save the IP address
+   entry->ipAddr = *ipAddr;
+   //Save current time
+   entry->timestamp = time;
+   //Save TTL value, limited to the lifetime of the mDNS cache entries
+   entry->timeout = MIN(ttl, MDNS_MAX_LIFETIME / 1000) * 1000;
+
+   //Name resolution in progress?
+   if(entry->state == DNS_STATE_IN_PROGRESS)
+   {
+      //Host name successfully resolved
+      entry->state = DNS_STATE_RESOLVED;
+      //Notify the completion of the name resolution
+      dnsCompleteEntry(entry, NO_ERROR);
+   }
+}
+
+
 /**
  * @brief Parse a resource record from the Answer Section
+ *
+ * Every A and AAAA record seen on the link updates the matching cache
+ * entry, whether a resolution is in progress or not. With passive caching,
+ * the records of the .local names not in the cache yet create new entries,
+ * so that later lookups are answered without a query
+ *
  * @param[in] interface Underlying network interface
  * @param[in] message Pointer to the mDNS message
  * @param[in] offset Offset to first byte of the resource record
@@ -257,89 +418,101 @@ error_t mdnsClientSendQuery(DnsCacheEntry *entry)
 void mdnsClientParseAnRecord(NetInterface *interface,
    const MdnsMessage *message, size_t offset, const DnsResourceRecord *record)
 {
-   uint_t i;
+#if (MDNS_CLIENT_PASSIVE_CACHE_SUPPORT == ENABLED)
+   size_t n;
+#endif
+   bool_t cacheFlush;
    uint16_t rclass;
+   uint16_t rtype;
+   uint32_t ttl;
+   HostType type;
+   IpAddr ipAddr;
    DnsCacheEntry *entry;
+   char_t name[DNS_MAX_NAME_LEN + 1];
 
-   //Loop through DNS cache entries
-   for(i = 0; i < DNS_CACHE_SIZE; i++)
-   {
-      //Point to the current entry
-      entry = &dnsCache[i];
+   //Convert the class to host byte order
+   rclass = ntohs(record->rclass);
+   //Extract the Cache Flush flag
+   cacheFlush = (rclass & MDNS_RCLASS_CACHE_FLUSH) ? TRUE : FALSE;
+   rclass &= ~MDNS_RCLASS_CACHE_FLUSH;
+
+   //Check the class of the resource record
+   if(rclass != DNS_RR_CLASS_IN)
+      return;
+
+   //Convert the type to host byte order
+   rtype = ntohs(record->rtype);
 
-      //mDNS name resolution in progress?
-      if(entry->state == DNS_STATE_IN_PROGRESS &&
-         entry->protocol == HOST_NAME_RESOLVER_MDNS)
-      {
-         //Compare resource record name
-         if(!dnsCompareName(message->dnsHeader, message->length, offset, entry->name, 0))
-         {
-            //Convert the class to host byte order
-            rclass = ntohs(record->rclass);
-            //Discard Cache Flush flag
-            rclass &= ~MDNS_RCLASS_CACHE_FLUSH;
-
-            //Check the class of the resource record
-            if(rclass == DNS_RR_CLASS_IN)
-            {
 #if (IPV4_SUPPORT == ENABLED)
-               //IPv4 address expected?
-               if(entry->type == HOST_TYPE_IPV4)
-               {
-                  //A resource record found?
-                  if(ntohs(record->rtype) == DNS_RR_TYPE_A)
-                  {
-                     //Verify the length of the data field
-                     if(ntohs(record->rdlength) == sizeof(Ipv4Addr))
-                     {
-                        //Copy the IPv4 address
-                        entry->ipAddr.length = sizeof(Ipv4Addr);
-                        ipv4CopyAddr(&entry->ipAddr.ipv4Addr, record->rdata);
-
-                        //Save current time
-                        entry->timestamp = osGetSystemTime();
-                        //Save TTL value
-                        entry->timeout = ntohl(record->ttl) * 1000;
-                        //Limit the lifetime of the mDNS cache entries
-                        entry->timeout = MIN(entry->timeout, MDNS_MAX_LIFETIME);
-
-                        //Host name successfully resolved
-                        entry->state = DNS_STATE_RESOLVED;
-                     }
-                  }
-               }
+   //A resource record found?
+   if(rtype == DNS_RR_TYPE_A && ntohs(record->rdlength) == sizeof(Ipv4Addr))
+   {
+      //Copy the IPv4 address
+      type = HOST_TYPE_IPV4;
+      ipAddr.length = sizeof(Ipv4Addr);
+      ipv4CopyAddr(&ipAddr.ipv4Addr, record->rdata);
+   }
+   else
 #endif
 #if (IPV6_SUPPORT == ENABLED)
-               //IPv6 address expected?
-               if(entry->type == HOST_TYPE_IPV6)
-               {
-                  //AAAA resource record found?
-                  if(ntohs(record->rtype) == DNS_RR_TYPE_AAAA)
-                  {
-                     //Verify the length of the data field
-                     if(ntohs(record->rdlength) == sizeof(Ipv6Addr))
-                     {
-                        //Copy the IPv6 address
-                        entry->ipAddr.length = sizeof(Ipv6Addr);
-                        ipv6CopyAddr(&entry->ipAddr.ipv6Addr, record->rdata);
-
-                        //Save current time
-                        entry->timestamp = osGetSystemTime();
-                        //Save TTL value
-                        entry->timeout = ntohl(record->ttl) * 1000;
-                        //Limit the lifetime of the mDNS cache entries
-                        entry->timeout = MIN(entry->timeout, MDNS_MAX_LIFETIME);
-
-                        //Host name successfully resolved
-                        entry->state = DNS_STATE_RESOLVED;
-                     }
-                  }
-               }
+   //AAAA resource record found?
+   if(rtype == DNS_RR_TYPE_AAAA && ntohs(record->rdlength) == sizeof(Ipv6Addr))
+   {
+      //Copy the IPv6 address
+      type = HOST_TYPE_IPV6;
+      ipAddr.length = sizeof(Ipv6Addr);
+      ipv6CopyAddr(&ipAddr.ipv6Addr, record->rdata);
+   }
+   else
 #endif
-            }
-         }
-      }
+   //Other resource record?
+   {
+      return;
    }
+
+   //Decode the name of the resource record
+   if(!mdnsClientParseName(message, offset, name))
+      return;
+
+   //Save TTL value
+   ttl = ntohl(record->ttl);
+
+   //Search the DNS cache for the name
+   entry = dnsFindEntry(interface, name, type, HOST_NAME_RESOLVER_MDNS);
+
+   //Check whether a matching entry has been found
+   if(entry != NULL)
+   {
+      //Update the entry
+      mdnsClientUpdateEntry(entry, &ipAddr, ttl, cacheFlush);
+   }
+#if (MDNS_CLIENT_PASSIVE_CACHE_SUPPORT == ENABLED)
+   else if(ttl > 0)
+   {
+      //Only the names of the local link are cached
+      n = osStrlen(name);
+      if(n < 6 || osStrcasecmp(name + n - 6, ".local") != 0)
+         return;
+
+      //Create a passive entry, if there is room for it
+      entry = dnsCreateEntryEx(name, TRUE);
+      //No room left?
+      if(entry == NULL)
+         return;
+
+      //Initialize DNS cache entry
+      entry->type = type;
+      entry->protocol = HOST_NAME_RESOLVER_MDNS;
+      entry->interface = interface;
+      entry->ipAddr = ipAddr;
+      //Save current time
+      entry->timestamp = osGetSystemTime();
+      //Save TTL value, limited to the lifetime of the mDNS cache entries
+      entry->timeout = MIN(ttl, MDNS_MAX_LIFETIME / 1000) * 1000;
+      //The name is resolved
+      entry->state = DNS_STATE_RESOLVED;
+   }
+#endif
 }
 
 #endif
@@ -73,6 +73,20 @@
    #error MDNS_MAX_LIFETIME parameter is not valid
 #endif
 
+//Passive caching of the answers seen on the link
+#ifndef MDNS_CLIENT_PASSIVE_CACHE_SUPPORT
+   #define MDNS_CLIENT_PASSIVE_CACHE_SUPPORT DISABLED
+#elif (MDNS_CLIENT_PASSIVE_CACHE_SUPPORT != ENABLED && MDNS_CLIENT_PASSIVE_CACHE_SUPPORT != DISABLED)
+   #error MDNS_CLIENT_PASSIVE_CACHE_SUPPORT parameter is not valid
+#endif
+
+//Delay before a record announced with a zero TTL is deleted
+#ifndef MDNS_CLIENT_GOODBYE_DELAY
+   #define MDNS_CLIENT_GOODBYE_DELAY 1000
+#elif (MDNS_CLIENT_GOODBYE_DELAY < 0)
+   #error MDNS_CLIENT_GOODBYE_DELAY parameter is not valid
+#endif
+
 //Additional record generation
 #ifndef MDNS_ADDITIONAL_RECORDS_SUPPORT
    #define MDNS_ADDITIONAL_RECORDS_SUPPORT ENABLED
@@ -121,6 +121,27 @@
    #error MDNS_ANNOUNCE_DELAY parameter is not valid
 #endif
 
+//Precomputed answers to host name queries
+#ifndef MDNS_RESPONDER_ANSWER_CACHE_SUPPORT
+   #define MDNS_RESPONDER_ANSWER_CACHE_SUPPORT DISABLED
+#elif (MDNS_RESPONDER_ANSWER_CACHE_SUPPORT != ENABLED && MDNS_RESPONDER_ANSWER_CACHE_SUPPORT != DISABLED)
+   #error MDNS_RESPONDER_ANSWER_CACHE_SUPPORT parameter is not valid
+#endif
+
+//Size of the precomputed answer buffer
+#ifndef MDNS_RESPONDER_ANSWER_CACHE_SIZE
+   #define MDNS_RESPONDER_ANSWER_CACHE_SIZE 256
+#elif (MDNS_RESPONDER_ANSWER_CACHE_SIZE < 64)
+   #error MDNS_RESPONDER_ANSWER_CACHE_SIZE parameter is not valid
+#endif
+
+//Minimum interval between two multicast answers to the same question
+#ifndef MDNS_RESPONDER_ANSWER_INTERVAL
+   #define MDNS_RESPONDER_ANSWER_INTERVAL 1000
+#elif (MDNS_RESPONDER_ANSWER_INTERVAL < 0)
+   #error MDNS_RESPONDER_ANSWER_INTERVAL parameter is not valid
+#endif
+
 //Additional record generation
 #ifndef DNS_SD_ADDITIONAL_RECORDS_SUPPORT
    #define DNS_SD_ADDITIONAL_RECORDS_SUPPORT ENABLED
@@ -222,6 +243,19 @@ struct _MdnsResponderContext
    MdnsIpv6AddrEntry ipv6AddrList[IPV6_ADDR_LIST_SIZE];       ///<IPv6 address list
    MdnsMessage ipv6Response;                                  ///<IPv6 response message
 #endif
+#if (MDNS_RESPONDER_ANSWER_CACHE_SUPPORT == ENABLED)
+   bool_t answerCacheValid;                                   ///<The precomputed answer is up to date
+   size_t answerCacheLength;                                  ///<Length of the precomputed answer
+   uint16_t answerCacheAncount;                               ///<Number of records in the Answer Section
+   uint16_t answerCacheArcount;                               ///<Number of records in the Additional Section
+   uint8_t answerCache[MDNS_RESPONDER_ANSWER_CACHE_SIZE];     ///<Precomputed answer to A queries for the host name
+#if (IPV4_SUPPORT == ENABLED)
+   systime_t ipv4AnswerTimestamp;                             ///<Time of the last precomputed answer sent over IPv4
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   systime_t ipv6AnswerTimestamp;                             ///<Time of the last precomputed answer sent over IPv6
+#endif
+#endif
 };
 
 
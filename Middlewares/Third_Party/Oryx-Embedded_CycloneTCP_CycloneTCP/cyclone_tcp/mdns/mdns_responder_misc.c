@@ -67,6 +67,11 @@ void mdnsResponderChangeState(MdnsResponderContext *context,
    //Switch to the new state
    context->state = newState;
 
+#if (MDNS_RESPONDER_ANSWER_CACHE_SUPPORT == ENABLED)
+   //The host name or the addresses may have changed
+   context->answerCacheValid = FALSE;
+#endif
+
    //Any registered callback?
    if(context->settings.stateChangeEvent != NULL)
    {
@@ -357,6 +362,7 @@ void mdnsResponderProcessQuery(NetInterface *interface, MdnsMessage *query)
    size_t n;
    size_t offset;
    uint16_t destPort;
+   bool_t pending;
    IpAddr destIpAddr;
    DnsQuestion *question;
    DnsResourceRecord *record;
@@ -438,6 +444,12 @@ void mdnsResponderProcessQuery(NetInterface *interface, MdnsMessage *query)
       return;
    }
 
+#if (MDNS_RESPONDER_ANSWER_CACHE_SUPPORT == ENABLED)
+   //Host name lookups are answered with the precomputed records
+   if(mdnsResponderProcessCachedQuery(context, query, response, &destIpAddr))
+      return;
+#endif
+
    //Check whether the querier originating the query is a simple resolver
    if(ntohs(query->udpHeader->srcPort) != MDNS_PORT)
    {
@@ -453,6 +465,10 @@ void mdnsResponderProcessQuery(NetInterface *interface, MdnsMessage *query)
       osMemset(response, 0, sizeof(MdnsMessage));
    }
 
+   //A response may already be scheduled, for instance when the query is
+   //the continuation of a truncated query
+   pending = (response->buffer != NULL);
+
    //When possible, a responder should, for the sake of network efficiency,
    //aggregate as many responses as possible into a single mDNS response message
    if(response->buffer == NULL)
@@ -594,6 +610,11 @@ void mdnsResponderProcessQuery(NetInterface *interface, MdnsMessage *query)
             //Save current time
             response->timestamp = osGetSystemTime();
          }
+         else if(pending)
+         {
+            //The scheduled response may still be reduced by the Known-Answer
+            //packets that follow, so it is sent when its delay elapses
+         }
          else if(response->sharedRecordCount > 0)
          {
             //In any case where there may be multiple responses, such as queries
@@ -629,6 +650,228 @@ void mdnsResponderProcessQuery(NetInterface *interface, MdnsMessage *query)
 }
 
 
+/**
+ * @brief Precompute the answer to A queries for the host name
+ *
+ * The A records and the matching additional records are serialized once,
+ * and kept until the host name or the addresses change
+ *
+ * @param[in] context Pointer to the mDNS responder context
+ * @return Error code
+ **/
+
+error_t mdnsResponderBuildAnswerCache(MdnsResponderContext *context)
+{
+#if (MDNS_RESPONDER_ANSWER_CACHE_SUPPORT == ENABLED)
+   error_t error;
+   size_t n;
+   MdnsMessage message;
+
+   //Discard the previous answer
+   context->answerCacheLength = 0;
+   context->answerCacheAncount = 0;
+   context->answerCacheArcount = 0;
+
+   //Create an empty mDNS response message
+   error = mdnsCreateMessage(&message, TRUE);
+   //Any error to report?
+   if(error)
+      return error;
+
+   //Generate A resource records
+   error = mdnsResponderGenerateIpv4AddrRecords(context, &message, TRUE,
+      context->settings.ttl);
+
+   //Any A resource record?
+   if(!error && message.dnsHeader->ancount > 0)
+   {
+      //Generate additional records (AAAA or NSEC resource records)
+      mdnsResponderGenerateAdditionalRecords(context, &message, FALSE);
+
+      //Length of the resource records
+      n = message.length - sizeof(DnsHeader);
+
+      //Make sure the resource records fit in the buffer
+      if(n <= MDNS_RESPONDER_ANSWER_CACHE_SIZE)
+      {
+         //Save the resource records
+         osMemcpy(context->answerCache, message.dnsHeader->questions, n);
+         context->answerCacheLength = n;
+         context->answerCacheAncount = message.dnsHeader->ancount;
+         context->answerCacheArcount = message.dnsHeader->arcount;
+      }
+   }
+
+   //Queries are served by the regular path when no answer could be
+   //precomputed, until the next change
+   context->answerCacheValid = TRUE;
+
+   //Free previously allocated memory
+   mdnsDeleteMessage(&message);
+
+   //Return status code
+   return error;
+#else
+   //Not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Answer a host name query with the precomputed records
+ *
+ * Only the common case is handled: a single A question for the host name
+ * from a fully compliant querier, with no known answers. Any other query
+ * goes through the regular path. A question already answered less than
+ * MDNS_RESPONDER_ANSWER_INTERVAL ago is not answered again (refer to
+ * RFC 6762, section 6)
+ *
+ * @param[in] context Pointer to the mDNS responder context
+ * @param[in] query Incoming mDNS query message
+ * @param[in] response Response message pending to be sent, if any
+ * @param[in] destIpAddr Destination address of the response
+ * @return TRUE if the query has been processed, else FALSE
+ **/
+
+bool_t mdnsResponderProcessCachedQuery(MdnsResponderContext *context,
+   const MdnsMessage *query, const MdnsMessage *response,
+   const IpAddr *destIpAddr)
+{
+#if (MDNS_RESPONDER_ANSWER_CACHE_SUPPORT == ENABLED)
+   error_t error;
+   size_t n;
+   systime_t time;
+   systime_t *timestamp;
+   DnsQuestion *question;
+   MdnsMessage message;
+
+   //Legacy unicast queries are answered by the regular path
+   if(ntohs(query->udpHeader->srcPort) != MDNS_PORT)
+      return FALSE;
+
+   //The query must consist of a single question, with no known answers
+   if(ntohs(query->dnsHeader->qdcount) != 1 ||
+      ntohs(query->dnsHeader->ancount) != 0 ||
+      ntohs(query->dnsHeader->nscount) != 0 ||
+      query->dnsHeader->tc)
+   {
+      return FALSE;
+   }
+
+   //Do not respond to mDNS queries during probing
+   if(context->state != MDNS_STATE_ANNOUNCING &&
+      context->state != MDNS_STATE_IDLE)
+   {
+      return FALSE;
+   }
+
+   //A response already pending aggregates the answers
+   if(response->buffer != NULL)
+      return FALSE;
+
+   //Parse the question name
+   n = dnsParseName(query->dnsHeader, query->length, sizeof(DnsHeader),
+      NULL, 0);
+
+   //Invalid name?
+   if(!n || (n + sizeof(DnsQuestion)) > query->length)
+      return FALSE;
+
+   //Point to the question
+   question = DNS_GET_QUESTION(query->dnsHeader, n);
+
+   //A query, class IN (the QU flag is ignored, as by the regular path)?
+   if(ntohs(question->qtype) != DNS_RR_TYPE_A ||
+      (ntohs(question->qclass) & ~MDNS_QCLASS_QU) != DNS_RR_CLASS_IN)
+   {
+      return FALSE;
+   }
+
+   //The question must be about the host name
+   if(mdnsCompareName(query->dnsHeader, query->length, sizeof(DnsHeader),
+      context->hostname, "", ".local", 0))
+   {
+      return FALSE;
+   }
+
+   //Rebuild the precomputed answer if necessary
+   if(!context->answerCacheValid)
+   {
+      mdnsResponderBuildAnswerCache(context);
+   }
+
+   //No precomputed answer?
+   if(context->answerCacheLength == 0)
+      return FALSE;
+
+#if (IPV4_SUPPORT == ENABLED)
+   //IPv4 response?
+   if(destIpAddr->length == sizeof(Ipv4Addr))
+   {
+      timestamp = &context->ipv4AnswerTimestamp;
+   }
+   else
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   //IPv6 response?
+   if(destIpAddr->length == sizeof(Ipv6Addr))
+   {
+      timestamp = &context->ipv6AnswerTimestamp;
+   }
+   else
+#endif
+   //Invalid destination address?
+   {
+      return FALSE;
+   }
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //The same question asked by several queriers is answered once
+   if((time - *timestamp) < MDNS_RESPONDER_ANSWER_INTERVAL)
+      return TRUE;
+
+   //Create an empty mDNS response message
+   error = mdnsCreateMessage(&message, TRUE);
+   //Any error to report?
+   if(error)
+      return FALSE;
+
+   //Copy the precomputed resource records
+   osMemcpy(message.dnsHeader->questions, context->answerCache,
+      context->answerCacheLength);
+
+   //Take the identifier from the query message
+   message.dnsHeader->id = query->dnsHeader->id;
+   message.dnsHeader->ancount = context->answerCacheAncount;
+   message.dnsHeader->arcount = context->answerCacheArcount;
+   message.length = sizeof(DnsHeader) + context->answerCacheLength;
+
+   //Send mDNS response message
+   error = mdnsSendMessage(context->settings.interface, &message, destIpAddr,
+      MDNS_PORT);
+
+   //Free previously allocated memory
+   mdnsDeleteMessage(&message);
+
+   //Check status code
+   if(!error)
+   {
+      //Save the time at which the answer was sent
+      *timestamp = time;
+   }
+
+   //The query has been processed
+   return TRUE;
+#else
+   //Not implemented
+   return FALSE;
+#endif
+}
+
+
 /**
  * @brief Parse a question
  * @param[in] interface Underlying network interface
@@ -909,7 +1152,7 @@ void mdnsResponderParseKnownAnRecord(NetInterface *interface,
                   response->dnsHeader->ancount--;
 
                   //Update the number of shared resource records
-                  if(ntohs(queryRecord->rclass) == DNS_RR_TYPE_PTR &&
+                  if(ntohs(queryRecord->rtype) == DNS_RR_TYPE_PTR &&
                      response->sharedRecordCount > 0)
                   {
                      response->sharedRecordCount--;
@@ -1036,7 +1279,7 @@ void mdnsResponderParseAnRecord(NetInterface *interface,
                   response2->dnsHeader->ancount--;
 
                   //Update the number of shared resource records
-                  if(ntohs(record->rclass) == DNS_RR_TYPE_PTR &&
+                  if(ntohs(record->rtype) == DNS_RR_TYPE_PTR &&
                      response2->sharedRecordCount > 0)
                   {
                      response2->sharedRecordCount--;
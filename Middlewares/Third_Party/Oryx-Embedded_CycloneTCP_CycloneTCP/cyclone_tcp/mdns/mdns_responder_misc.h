@@ -53,6 +53,12 @@ error_t mdnsResponderSendGoodbye(MdnsResponderContext *context);
 
 void mdnsResponderProcessQuery(NetInterface *interface, MdnsMessage *query);
 
+error_t mdnsResponderBuildAnswerCache(MdnsResponderContext *context);
+
+bool_t mdnsResponderProcessCachedQuery(MdnsResponderContext *context,
+   const MdnsMessage *query, const MdnsMessage *response,
+   const IpAddr *destIpAddr);
+
 error_t mdnsResponderParseQuestion(NetInterface *interface,
    const MdnsMessage *query, size_t offset, const DnsQuestion *question,
    MdnsMessage *response);
@@ -0,0 +1,438 @@
+/**
+ * @file nat.c
+ * @brief NAT (IP Network Address Translator)
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * Network Address Port Translation (NAPT) lets the hosts of one or more
+ * private networks share the address of the public interface. Sessions
+ * initiated from a private host are mapped to a public TCP or UDP port, or
+ * to a public ICMP query identifier, and incoming traffic is redirected to
+ * private hosts according to port forwarding rules. Refer to RFC 2663,
+ * RFC 3022 and RFC 5508 for more details
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL NAT_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "nat/nat.h"
+#include "nat/nat_misc.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (IPV4_SUPPORT == ENABLED && NAT_SUPPORT == ENABLED)
+
+
+/**
+ * @brief Initialize settings with default values
+ * @param[out] settings Structure that contains NAT settings
+ **/
+
+void natGetDefaultSettings(NatSettings *settings)
+{
+   uint_t i;
+
+   //Public interface
+   settings->publicInterface = NULL;
+   //Index of the public IP address to use
+   settings->publicIpAddrIndex = 0;
+
+   //Private interfaces
+   for(i = 0; i < NAT_MAX_PRIVATE_INTERFACES; i++)
+   {
+      settings->privateInterfaces[i] = NULL;
+   }
+
+   //Number of private interfaces
+   settings->numPrivateInterfaces = 0;
+
+   //Port redirection rules
+   settings->portFwdRules = NULL;
+   settings->numPortFwdRules = 0;
+
+   //NAT sessions (initiated from a private host)
+   settings->sessions = NULL;
+   settings->numSessions = 0;
+}
+
+
+/**
+ * @brief NAT initialization
+ * @param[in] context Pointer to the NAT context
+ * @param[in] settings NAT specific settings
+ * @return Error code
+ **/
+
+error_t natInit(NatContext *context, const NatSettings *settings)
+{
+   uint_t i;
+
+   //Debug message
+   TRACE_INFO("Initializing NAT...\r\n");
+
+   //Ensure the parameters are valid
+   if(context == NULL || settings == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Invalid number of private interfaces?
+   if(settings->numPrivateInterfaces == 0 ||
+      settings->numPrivateInterfaces > NAT_MAX_PRIVATE_INTERFACES)
+   {
+      return ERROR_INVALID_PARAMETER;
+   }
+
+   //Invalid port redirection rules?
+   if(settings->portFwdRules == NULL && settings->numPortFwdRules != 0)
+      return ERROR_INVALID_PARAMETER;
+
+   //Invalid NAT sessions?
+   if(settings->sessions == NULL || settings->numSessions == 0)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Clear the NAT context
+   osMemset(context, 0, sizeof(NatContext));
+
+   //Save user settings
+   context->publicInterface = settings->publicInterface;
+   context->publicIpAddrIndex = settings->publicIpAddrIndex;
+   context->numPrivateInterfaces = settings->numPrivateInterfaces;
+   context->portFwdRules = settings->portFwdRules;
+   context->numPortFwdRules = settings->numPortFwdRules;
+   context->sessions = settings->sessions;
+   context->numSessions = settings->numSessions;
+
+   //Save private interfaces
+   for(i = 0; i < context->numPrivateInterfaces; i++)
+   {
+      context->privateInterfaces[i] = settings->privateInterfaces[i];
+   }
+
+   //Invalidate port redirection rules
+   for(i = 0; i < context->numPortFwdRules; i++)
+   {
+      context->portFwdRules[i].protocol = IPV4_PROTOCOL_NONE;
+   }
+
+   //All the sessions are free
+   natFlushSessions(context);
+
+   //Public ports and ICMP query identifiers are allocated in turn
+   context->nextPort = NAT_TCP_UDP_PORT_MIN;
+   context->nextIcmpQueryId = NAT_ICMP_QUERY_ID_MIN;
+
+   //NAT operation is currently suspended
+   context->running = FALSE;
+
+   //Attach the NAT context to the TCP/IP stack
+   netContext.natContext = context;
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful initialization
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Specify the NAT public interface
+ * @param[in] context Pointer to the NAT context
+ * @param[in] publicInterface NAT public interface
+ * @return Error code
+ **/
+
+error_t natSetPublicInterface(NatContext *context,
+   NetInterface *publicInterface)
+{
+   //Check parameters
+   if(context == NULL || publicInterface == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //The sessions are bound to the address of the former interface
+   natFlushSessions(context);
+   //Save public interface
+   context->publicInterface = publicInterface;
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Add port redirection rule
+ * @param[in] context Pointer to the NAT context
+ * @param[in] index Zero-based index identifying a given entry
+ * @param[in] protocol Transport protocol (IPV4_PROTOCOL_TCP or IPV4_PROTOCOL_UDP)
+ * @param[in] publicPort Public port to be redirected
+ * @param[in] privateInterface Private interface
+ * @param[in] privateIpAddr Private IP address of the host
+ * @param[in] privatePort Private port
+ * @return Error code
+ **/
+
+error_t natSetPortFwdRule(NatContext *context, uint_t index,
+   Ipv4Protocol protocol, uint16_t publicPort, NetInterface *privateInterface,
+   Ipv4Addr privateIpAddr, uint16_t privatePort)
+{
+   //A single port is redirected
+   return natSetPortRangeFwdRule(context, index, protocol, publicPort,
+      publicPort, privateInterface, privateIpAddr, privatePort);
+}
+
+
+/**
+ * @brief Add port range redirection rule
+ * @param[in] context Pointer to the NAT context
+ * @param[in] index Zero-based index identifying a given entry
+ * @param[in] protocol Transport protocol (IPV4_PROTOCOL_TCP or IPV4_PROTOCOL_UDP)
+ * @param[in] publicPortMin Public port range to be redirected (lower value)
+ * @param[in] publicPortMax Public port range to be redirected (upper value)
+ * @param[in] privateInterface Private interface
+ * @param[in] privateIpAddr Private IP address of the host
+ * @param[in] privatePortMin Private port range (lower value)
+ * @return Error code
+ **/
+
+error_t natSetPortRangeFwdRule(NatContext *context, uint_t index,
+   Ipv4Protocol protocol, uint16_t publicPortMin, uint16_t publicPortMax,
+   NetInterface *privateInterface, Ipv4Addr privateIpAddr,
+   uint16_t privatePortMin)
+{
+   NatPortFwdRule *rule;
+
+   //Check parameters
+   if(context == NULL || privateInterface == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Only TCP and UDP traffic can be redirected
+   if(protocol != IPV4_PROTOCOL_TCP && protocol != IPV4_PROTOCOL_UDP)
+      return ERROR_INVALID_PROTOCOL;
+
+   //Check port ranges
+   if(publicPortMin == 0 || publicPortMax < publicPortMin ||
+      privatePortMin == 0 ||
+      (uint32_t) privatePortMin + publicPortMax - publicPortMin > 65535)
+   {
+      return ERROR_INVALID_PARAMETER;
+   }
+
+   //Make sure the index is valid
+   if(index >= context->numPortFwdRules)
+      return ERROR_OUT_OF_RANGE;
+
+   //Traffic can only be redirected to a private interface
+   if(!natIsPrivateInterface(context, privateInterface))
+      return ERROR_INVALID_INTERFACE;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Point to the specified rule
+   rule = &context->portFwdRules[index];
+
+   //Save the rule
+   rule->protocol = protocol;
+   rule->publicPortMin = publicPortMin;
+   rule->publicPortMax = publicPortMax;
+   rule->privateInterface = privateInterface;
+   rule->privateIpAddr = privateIpAddr;
+   rule->privatePortMin = privatePortMin;
+   rule->privatePortMax = privatePortMin + publicPortMax - publicPortMin;
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Remove port redirection rule
+ * @param[in] context Pointer to the NAT context
+ * @param[in] index Zero-based index identifying a given entry
+ * @return Error code
+ **/
+
+error_t natClearPortFwdRule(NatContext *context, uint_t index)
+{
+   //Check parameters
+   if(context == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Make sure the index is valid
+   if(index >= context->numPortFwdRules)
+      return ERROR_OUT_OF_RANGE;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Invalidate the rule
+   context->portFwdRules[index].protocol = IPV4_PROTOCOL_NONE;
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Start NAT operation
+ * @param[in] context Pointer to the NAT context
+ * @return Error code
+ **/
+
+error_t natStart(NatContext *context)
+{
+   //Make sure the NAT context is valid
+   if(context == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Debug message
+   TRACE_INFO("Starting NAT...\r\n");
+
+   //The public interface must be specified
+   if(context->publicInterface == NULL)
+      return ERROR_INVALID_INTERFACE;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Check whether NAT operation is already running
+   if(!context->running)
+   {
+      //The timer wheel starts turning now
+      context->timerWheelTime = osGetSystemTime();
+      //Start NAT operation
+      context->running = TRUE;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Stop NAT operation
+ * @param[in] context Pointer to the NAT context
+ * @return Error code
+ **/
+
+error_t natStop(NatContext *context)
+{
+   //Make sure the NAT context is valid
+   if(context == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Debug message
+   TRACE_INFO("Stopping NAT...\r\n");
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Check whether NAT operation is running
+   if(context->running)
+   {
+      //Delete all the sessions
+      natFlushSessions(context);
+      //Stop NAT operation
+      context->running = FALSE;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Get NAT statistics
+ * @param[in] context Pointer to the NAT context
+ * @param[out] stats Copy of the counters
+ * @param[out] activeSessions Number of sessions in use
+ **/
+
+void natGetStats(NatContext *context, NatStats *stats,
+   uint_t *activeSessions)
+{
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Copy the counters
+   *stats = context->stats;
+   *activeSessions = context->activeSessions;
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+}
+
+
+/**
+ * @brief Release NAT context
+ * @param[in] context Pointer to the NAT context
+ **/
+
+void natDeinit(NatContext *context)
+{
+   //Make sure the NAT context is valid
+   if(context != NULL)
+   {
+      //Get exclusive access
+      osAcquireMutex(&netMutex);
+
+      //Detach the NAT context from the TCP/IP stack
+      if(netContext.natContext == context)
+      {
+         netContext.natContext = NULL;
+      }
+
+      //Clear NAT context
+      osMemset(context, 0, sizeof(NatContext));
+
+      //Release exclusive access
+      osReleaseMutex(&netMutex);
+   }
+}
+
+#endif
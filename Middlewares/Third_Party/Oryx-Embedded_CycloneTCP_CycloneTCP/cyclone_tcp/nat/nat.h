@@ -104,6 +104,27 @@
    #error NAT_ICMP_QUERY_ID_MAX parameter is not valid
 #endif
 
+//Size of the session hash tables (must be a power of two)
+#ifndef NAT_HASH_TABLE_SIZE
+   #define NAT_HASH_TABLE_SIZE 64
+#elif (NAT_HASH_TABLE_SIZE < 1 || \
+   (NAT_HASH_TABLE_SIZE & (NAT_HASH_TABLE_SIZE - 1)) != 0)
+   #error NAT_HASH_TABLE_SIZE parameter is not valid
+#endif
+
+//Number of slots of the session timer wheel, each NAT_TICK_INTERVAL wide
+//(must be a power of two)
+#ifndef NAT_TIMER_WHEEL_SIZE
+   #define NAT_TIMER_WHEEL_SIZE 128
+#elif (NAT_TIMER_WHEEL_SIZE < 2 || \
+   (NAT_TIMER_WHEEL_SIZE & (NAT_TIMER_WHEEL_SIZE - 1)) != 0)
+   #error NAT_TIMER_WHEEL_SIZE parameter is not valid
+#endif
+
+//Forward declaration of NatSession structure
+struct _NatSession;
+#define NatSession struct _NatSession
+
 //C++ guard
 #ifdef __cplusplus
 extern "C" {
@@ -128,6 +149,12 @@ typedef struct
    uint16_t icmpQueryId;
    uint8_t ttl;
    uint8_t tos;
+   Ipv4Protocol innerProtocol;  ///<Protocol of the packet quoted by an ICMP error message
+   Ipv4Addr innerSrcIpAddr;     ///<Source address of the quoted packet
+   uint16_t innerSrcPort;       ///<Source port of the quoted packet
+   Ipv4Addr innerDestIpAddr;    ///<Destination address of the quoted packet
+   uint16_t innerDestPort;      ///<Destination port of the quoted packet
+   uint16_t innerIcmpQueryId;   ///<ICMP query identifier of the quoted packet
 } NatIpPacket;
 
 
@@ -149,9 +176,14 @@ typedef struct
 
 /**
  * @brief NAT session
+ *
+ * A session is chained in two hash tables, keyed on its private and on its
+ * public endpoint, so that the packets of either direction find it in
+ * constant time. It also sits in the slot of the timer wheel where its
+ * timeout is next checked
  **/
 
-typedef struct
+struct _NatSession
 {
    Ipv4Protocol protocol;          ///<IP protocol (TCP, UDP or ICMP)
    NetInterface *privateInterface; ///<Private interface
@@ -164,7 +196,27 @@ typedef struct
    Ipv4Addr remoteIpAddr;          ///<Remote IP address
    uint16_t remotePort;            ///<Remote TCP or UDP port number
    systime_t timestamp;            ///<Timestamp to manage session timeout
-} NatSession;
+   NatSession *nextPrivate;        ///<Next session of the private hash chain (or of the free list)
+   NatSession *nextPublic;         ///<Next session of the public hash chain
+   NatSession *nextTimer;          ///<Next session of the timer wheel slot
+};
+
+
+/**
+ * @brief NAT statistics
+ **/
+
+typedef struct
+{
+   uint32_t outboundPackets; ///<Packets translated from a private interface
+   uint32_t inboundPackets;  ///<Packets translated to a private interface
+   uint32_t icmpErrors;      ///<ICMP error messages whose quoted packet was translated
+   uint32_t sessionsCreated; ///<Sessions created
+   uint32_t sessionsExpired; ///<Sessions deleted after their timeout
+   uint32_t tableFull;       ///<Packets dropped because no session was available
+   uint32_t portExhausted;   ///<Packets dropped because no public port was available
+   uint32_t dropped;         ///<Other packets that could not be translated or sent
+} NatStats;
 
 
 /**
@@ -199,6 +251,16 @@ typedef struct
    uint_t numPortFwdRules;                                      ///<Number of port redirection rules
    NatSession *sessions;                                        ///<NAT sessions (initiated from a private host)
    uint_t numSessions;                                          ///<Number of NAT sessions
+   NatSession *privateHashTable[NAT_HASH_TABLE_SIZE];           ///<Sessions hashed on their private endpoint
+   NatSession *publicHashTable[NAT_HASH_TABLE_SIZE];            ///<Sessions hashed on their public endpoint
+   NatSession *timerWheel[NAT_TIMER_WHEEL_SIZE];                ///<Sessions whose timeout is checked in each slot
+   uint_t timerWheelIndex;                                      ///<Slot of the timer wheel checked last
+   systime_t timerWheelTime;                                    ///<Time at which that slot was checked
+   NatSession *freeSessions;                                    ///<Unused sessions
+   uint_t activeSessions;                                       ///<Number of sessions in use
+   uint16_t nextPort;                                           ///<Next public port to try
+   uint16_t nextIcmpQueryId;                                    ///<Next public ICMP query identifier to try
+   NatStats stats;                                              ///<Statistics
 } NatContext;
 
 
@@ -223,6 +285,9 @@ error_t natClearPortFwdRule(NatContext *context, uint_t index);
 error_t natStart(NatContext *context);
 error_t natStop(NatContext *context);
 
+void natGetStats(NatContext *context, NatStats *stats,
+   uint_t *activeSessions);
+
 void natDeinit(NatContext *context);
 
 //C++ guard
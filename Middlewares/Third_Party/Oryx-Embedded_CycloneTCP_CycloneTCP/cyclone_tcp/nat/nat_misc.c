@@ -0,0 +1,1885 @@
+/**
+ * @file nat_misc.c
+ * @brief Helper functions for NAT
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * Sessions are found through two hash tables, one keyed on the private
+ * endpoint for outbound packets and one keyed on the public port or query
+ * identifier for inbound packets. Their timeouts are managed by a timer
+ * wheel: a packet only refreshes the timestamp of its session, and when the
+ * slot of a session comes round, the session is either deleted or moved to
+ * the slot where its remaining time ends. The checksums of the translated
+ * packets are updated incrementally (refer to RFC 1624), so that a packet
+ * corrupted on the way in is still detected by its destination
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL NAT_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/ip.h"
+#include "core/tcp.h"
+#include "core/udp.h"
+#include "ipv4/ipv4.h"
+#include "ipv4/ipv4_misc.h"
+#include "ipv4/icmp.h"
+#include "nat/nat.h"
+#include "nat/nat_misc.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (IPV4_SUPPORT == ENABLED && NAT_SUPPORT == ENABLED)
+
+//Tick counter to handle periodic operations
+systime_t natTickCounter;
+
+
+/**
+ * @brief NAT timer handler
+ *
+ * This routine must be periodically called by the TCP/IP stack to expire
+ * the sessions whose slot of the timer wheel has come round
+ *
+ * @param[in] context Pointer to the NAT context
+ **/
+
+void natTick(NatContext *context)
+{
+   uint_t n;
+   uint_t index;
+   systime_t time;
+   systime_t elapsed;
+   systime_t timeout;
+   NatSession *session;
+   NatSession *next;
+
+   //Make sure the NAT context is valid
+   if(context == NULL)
+      return;
+
+   //Check whether NAT operation is running
+   if(!context->running)
+      return;
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //Check each slot whose time has come
+   for(n = 0; n < NAT_TIMER_WHEEL_SIZE &&
+      timeCompare(time, context->timerWheelTime + NAT_TICK_INTERVAL) >= 0; n++)
+   {
+      //Move to the next slot
+      index = (context->timerWheelIndex + 1) & (NAT_TIMER_WHEEL_SIZE - 1);
+      context->timerWheelIndex = index;
+      context->timerWheelTime += NAT_TICK_INTERVAL;
+
+      //Take the sessions off the slot
+      session = context->timerWheel[index];
+      context->timerWheel[index] = NULL;
+
+      //Loop through the sessions of the slot
+      while(session != NULL)
+      {
+         //The session may be moved to another slot
+         next = session->nextTimer;
+
+         //Time elapsed since the session was last used
+         elapsed = time - session->timestamp;
+         //Get the timeout value that applies to the session
+         timeout = natGetSessionTimeout(session->protocol);
+
+         //Check whether the session has expired
+         if(elapsed >= timeout)
+         {
+            //Debug message
+            TRACE_DEBUG("NAT session expired (public port/id %" PRIu16 ")\r\n",
+               (session->protocol == IPV4_PROTOCOL_ICMP) ?
+               session->publicIcmpQueryId : session->publicPort);
+
+            //Delete the session
+            natDeleteSession(context, session);
+            //Update statistics
+            context->stats.sessionsExpired++;
+         }
+         else
+         {
+            //Check the session again when its remaining time ends
+            natScheduleSession(context, session, timeout - elapsed);
+         }
+
+         //Next session of the slot
+         session = next;
+      }
+   }
+
+   //The wheel cannot catch up with more than one turn
+   if(n >= NAT_TIMER_WHEEL_SIZE)
+   {
+      context->timerWheelTime = time;
+   }
+}
+
+
+/**
+ * @brief Check whether a network interface is the NAT public interface
+ * @param[in] context Pointer to the NAT context
+ * @param[in] interface Pointer to the network interface
+ * @return TRUE if the specified interface is the NAT public interface, else
+ *   FALSE
+ **/
+
+bool_t natIsPublicInterface(NatContext *context, NetInterface *interface)
+{
+   //Make sure the NAT context is valid
+   if(context == NULL || interface == NULL)
+      return FALSE;
+
+   //Compare against the public interface
+   return (context->publicInterface == interface) ? TRUE : FALSE;
+}
+
+
+/**
+ * @brief Check whether a network interface is a NAT private interface
+ * @param[in] context Pointer to the NAT context
+ * @param[in] interface Pointer to the network interface
+ * @return TRUE if the specified interface is a NAT private interface, else
+ *   FALSE
+ **/
+
+bool_t natIsPrivateInterface(NatContext *context, NetInterface *interface)
+{
+   uint_t i;
+
+   //Make sure the NAT context is valid
+   if(context == NULL || interface == NULL)
+      return FALSE;
+
+   //Loop through the private interfaces
+   for(i = 0; i < context->numPrivateInterfaces; i++)
+   {
+      //Matching interface?
+      if(context->privateInterfaces[i] == interface)
+         return TRUE;
+   }
+
+   //The interface is not a private interface
+   return FALSE;
+}
+
+
+/**
+ * @brief Process IP packet
+ * @param[in] context Pointer to the NAT context
+ * @param[in] inInterface Interface on which the packet has been received
+ * @param[in] inPseudoHeader IPv4 pseudo header
+ * @param[in] inBuffer Multi-part buffer that holds the IP packet
+ * @param[in] inOffset Offset to the first byte of the IP packet
+ * @param[in] ancillary Additional options passed to the stack along with
+ *   the packet
+ * @return Error code (NO_ERROR if the packet has been consumed by the NAT)
+ **/
+
+error_t natProcessPacket(NatContext *context, NetInterface *inInterface,
+   const Ipv4PseudoHeader *inPseudoHeader, const NetBuffer *inBuffer,
+   size_t inOffset, NetRxAncillary *ancillary)
+{
+   error_t error;
+   uint_t i;
+   Ipv4Addr publicIpAddr;
+   NatIpPacket packet;
+
+   //Make sure the NAT context is valid
+   if(context == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Check whether NAT operation is running
+   if(!context->running)
+      return ERROR_WRONG_STATE;
+
+   //Save the relevant fields of the IP packet
+   osMemset(&packet, 0, sizeof(NatIpPacket));
+   packet.interface = inInterface;
+   packet.buffer = inBuffer;
+   packet.offset = inOffset;
+   packet.protocol = (Ipv4Protocol) inPseudoHeader->protocol;
+   packet.srcIpAddr = inPseudoHeader->srcAddr;
+   packet.destIpAddr = inPseudoHeader->destAddr;
+   packet.ttl = ancillary->ttl;
+   packet.tos = ancillary->tos;
+
+   //Inbound packet?
+   if(natIsPublicInterface(context, inInterface))
+   {
+      //Only the packets sent to the public address are translated
+      error = natGetPublicIpAddr(context, &publicIpAddr);
+      //Any error to report?
+      if(error)
+         return error;
+
+      //Check destination address
+      if(packet.destIpAddr != publicIpAddr)
+         return ERROR_INVALID_ADDRESS;
+
+      //Extract the ports or the ICMP query identifier
+      error = natParseTransportHeader(&packet);
+      //Any error to report?
+      if(error)
+         return error;
+
+      //Packets that match no session and no rule are for the host itself
+      error = natTranslateInboundPacket(context, &packet);
+      //Any error to report?
+      if(error)
+         return error;
+   }
+   else if(natIsPrivateInterface(context, inInterface))
+   {
+      //Packets sent to the host itself are left to the TCP/IP stack
+      for(i = 0; i < NET_INTERFACE_COUNT; i++)
+      {
+         if(ipv4CheckDestAddr(&netInterface[i], packet.destIpAddr) == NO_ERROR)
+            return ERROR_INVALID_ADDRESS;
+      }
+
+      //Extract the ports or the ICMP query identifier
+      error = natParseTransportHeader(&packet);
+
+      //Check status code
+      if(!error)
+      {
+         //Map the private endpoint to a public one
+         error = natTranslateOutboundPacket(context, &packet);
+      }
+
+      //The packet is not for the host, so it is dropped when it cannot be
+      //translated
+      if(error)
+      {
+         //Debug message
+         TRACE_DEBUG("NAT: outbound packet dropped (error %d)\r\n", error);
+
+         //Update statistics
+         if(error != ERROR_OUT_OF_RESOURCES)
+         {
+            context->stats.dropped++;
+         }
+
+         //The packet has been consumed
+         return NO_ERROR;
+      }
+   }
+   else
+   {
+      //The packet must be processed by the TCP/IP stack
+      return ERROR_INVALID_INTERFACE;
+   }
+
+   //The TTL must not reach zero (refer to RFC 1812, section 5.3.1)
+   if(packet.ttl <= 1)
+   {
+      //Update statistics
+      context->stats.dropped++;
+      //Discard the packet
+      return NO_ERROR;
+   }
+
+   //Dump the translated packet for debugging purpose
+   natDumpPacket(&packet);
+
+   //Send the translated packet
+   error = natForwardPacket(context, inPseudoHeader, &packet);
+
+   //Update statistics
+   if(error)
+   {
+      context->stats.dropped++;
+   }
+   else if(packet.interface == context->publicInterface)
+   {
+      context->stats.outboundPackets++;
+   }
+   else
+   {
+      context->stats.inboundPackets++;
+   }
+
+   //ICMP error message?
+   if(!error && packet.protocol == IPV4_PROTOCOL_ICMP &&
+      natIsIcmpErrorMessage(packet.icmpType))
+   {
+      context->stats.icmpErrors++;
+   }
+
+   //The packet has been consumed
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Translate the destination of an inbound packet
+ * @param[in] context Pointer to the NAT context
+ * @param[in,out] packet IP packet
+ * @return Error code
+ **/
+
+error_t natTranslateInboundPacket(NatContext *context, NatIpPacket *packet)
+{
+   bool_t icmpError;
+   NatPortFwdRule *rule;
+   NatSession *session;
+
+   //ICMP error message?
+   icmpError = (packet->protocol == IPV4_PROTOCOL_ICMP &&
+      natIsIcmpErrorMessage(packet->icmpType)) ? TRUE : FALSE;
+
+   //Check whether the packet matches a port redirection rule
+   rule = natMatchPortFwdRule(context, packet);
+
+   //Redirected traffic?
+   if(rule != NULL)
+   {
+      //The packet quoted by an ICMP error message was sent from the
+      //private host
+      if(icmpError)
+      {
+         packet->innerSrcIpAddr = rule->privateIpAddr;
+         packet->innerSrcPort = rule->privatePortMin +
+            packet->innerSrcPort - rule->publicPortMin;
+      }
+      else
+      {
+         packet->destPort = rule->privatePortMin +
+            packet->destPort - rule->publicPortMin;
+      }
+
+      //Redirect the packet to the private host
+      packet->interface = rule->privateInterface;
+      packet->destIpAddr = rule->privateIpAddr;
+   }
+   else
+   {
+      //Search the session the packet belongs to
+      session = natMatchSession(context, packet);
+      //No matching session?
+      if(session == NULL)
+         return ERROR_NO_MATCH;
+
+      //An ICMP error does not keep the session alive (refer to RFC 5508,
+      //section 3.2)
+      if(icmpError)
+      {
+         packet->innerSrcIpAddr = session->privateIpAddr;
+
+         if(packet->innerProtocol == IPV4_PROTOCOL_ICMP)
+         {
+            packet->innerIcmpQueryId = session->privateIcmpQueryId;
+         }
+         else
+         {
+            packet->innerSrcPort = session->privatePort;
+         }
+      }
+      else
+      {
+         //Refresh the session
+         session->timestamp = osGetSystemTime();
+
+         if(packet->protocol == IPV4_PROTOCOL_ICMP)
+         {
+            packet->icmpQueryId = session->privateIcmpQueryId;
+         }
+         else
+         {
+            packet->destPort = session->privatePort;
+         }
+      }
+
+      //Send the packet to the private host
+      packet->interface = session->privateInterface;
+      packet->destIpAddr = session->privateIpAddr;
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Translate the source of an outbound packet
+ * @param[in] context Pointer to the NAT context
+ * @param[in,out] packet IP packet
+ * @return Error code
+ **/
+
+error_t natTranslateOutboundPacket(NatContext *context, NatIpPacket *packet)
+{
+   error_t error;
+   bool_t icmpError;
+   uint16_t publicId;
+   Ipv4Addr publicIpAddr;
+   NatPortFwdRule *rule;
+   NatSession *session;
+
+   //Get the address of the public interface
+   error = natGetPublicIpAddr(context, &publicIpAddr);
+   //Any error to report?
+   if(error)
+      return error;
+
+   //ICMP error message?
+   icmpError = (packet->protocol == IPV4_PROTOCOL_ICMP &&
+      natIsIcmpErrorMessage(packet->icmpType)) ? TRUE : FALSE;
+
+   //Check whether the packet belongs to redirected traffic
+   rule = natMatchPortFwdRule(context, packet);
+
+   //Redirected traffic?
+   if(rule != NULL)
+   {
+      //The packet quoted by an ICMP error message was sent to the private
+      //host
+      if(icmpError)
+      {
+         packet->innerDestIpAddr = publicIpAddr;
+         packet->innerDestPort = rule->publicPortMin +
+            packet->innerDestPort - rule->privatePortMin;
+      }
+      else
+      {
+         packet->srcPort = rule->publicPortMin +
+            packet->srcPort - rule->privatePortMin;
+      }
+   }
+   else
+   {
+      //Search the session the packet belongs to
+      session = natMatchSession(context, packet);
+
+      //No matching session?
+      if(session == NULL)
+      {
+         //An ICMP error message cannot initiate a session
+         if(icmpError)
+            return ERROR_NO_MATCH;
+
+         //Allocate a public port or ICMP query identifier
+         if(packet->protocol == IPV4_PROTOCOL_ICMP)
+         {
+            publicId = natAllocateIcmpQueryId(context);
+         }
+         else
+         {
+            publicId = natAllocatePort(context, packet->protocol);
+         }
+
+         //No identifier available?
+         if(publicId == 0)
+         {
+            //Update statistics
+            context->stats.portExhausted++;
+            //Report an error
+            return ERROR_OUT_OF_RESOURCES;
+         }
+
+         //Take a free session
+         session = natCreateSession(context);
+
+         //No session available?
+         if(session == NULL)
+         {
+            //Update statistics
+            context->stats.tableFull++;
+            //Report an error
+            return ERROR_OUT_OF_RESOURCES;
+         }
+
+         //Save the endpoints of the session
+         session->protocol = packet->protocol;
+         session->privateInterface = packet->interface;
+         session->privateIpAddr = packet->srcIpAddr;
+         session->publicIpAddr = publicIpAddr;
+         session->remoteIpAddr = packet->destIpAddr;
+
+         if(packet->protocol == IPV4_PROTOCOL_ICMP)
+         {
+            session->privateIcmpQueryId = packet->icmpQueryId;
+            session->publicIcmpQueryId = publicId;
+         }
+         else
+         {
+            session->privatePort = packet->srcPort;
+            session->publicPort = publicId;
+            session->remotePort = packet->destPort;
+         }
+
+         //Make the session visible to both directions
+         natAddSession(context, session);
+
+         //Debug message
+         TRACE_DEBUG("NAT session created (public port/id %" PRIu16 ")\r\n",
+            publicId);
+      }
+      else if(!icmpError)
+      {
+         //Refresh the session
+         session->timestamp = osGetSystemTime();
+      }
+      else
+      {
+         //An ICMP error does not keep the session alive
+      }
+
+      //Rewrite the private endpoint
+      if(icmpError)
+      {
+         packet->innerDestIpAddr = publicIpAddr;
+
+         if(packet->innerProtocol == IPV4_PROTOCOL_ICMP)
+         {
+            packet->innerIcmpQueryId = session->publicIcmpQueryId;
+         }
+         else
+         {
+            packet->innerDestPort = session->publicPort;
+         }
+      }
+      else if(packet->protocol == IPV4_PROTOCOL_ICMP)
+      {
+         packet->icmpQueryId = session->publicIcmpQueryId;
+      }
+      else
+      {
+         packet->srcPort = session->publicPort;
+      }
+   }
+
+   //The packet leaves through the public interface
+   packet->interface = context->publicInterface;
+   packet->srcIpAddr = publicIpAddr;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Forward a translated packet
+ * @param[in] context Pointer to the NAT context
+ * @param[in] inPseudoHeader IPv4 pseudo header of the received packet
+ * @param[in] packet Translated IP packet
+ * @return Error code
+ **/
+
+error_t natForwardPacket(NatContext *context,
+   const Ipv4PseudoHeader *inPseudoHeader, const NatIpPacket *packet)
+{
+   error_t error;
+   size_t length;
+   size_t offset;
+   NetBuffer *buffer;
+   Ipv4PseudoHeader pseudoHeader;
+   NetTxAncillary ancillary;
+
+   //Retrieve the length of the payload
+   length = netBufferGetLength(packet->buffer) - packet->offset;
+
+   //Allocate a buffer to hold the translated payload
+   buffer = ipAllocBuffer(length, &offset);
+   //Failed to allocate memory?
+   if(buffer == NULL)
+      return ERROR_OUT_OF_MEMORY;
+
+   //Copy the payload
+   error = netBufferCopy(buffer, offset, packet->buffer, packet->offset,
+      length);
+
+   //Check status code
+   if(!error)
+   {
+      //Rewrite the ports and update the checksums
+      error = natTranslateTransportHeader(packet, inPseudoHeader, buffer,
+         offset);
+   }
+
+   //Check status code
+   if(!error)
+   {
+      //Format the IPv4 pseudo header of the translated packet
+      pseudoHeader.srcAddr = packet->srcIpAddr;
+      pseudoHeader.destAddr = packet->destIpAddr;
+      pseudoHeader.reserved = 0;
+      pseudoHeader.protocol = packet->protocol;
+      pseudoHeader.length = htons(length);
+
+      //Additional options passed to the stack along with the packet
+      ancillary = NET_DEFAULT_TX_ANCILLARY;
+      //Decrement the TTL and keep the ToS
+      ancillary.ttl = packet->ttl - 1;
+      ancillary.tos = packet->tos;
+
+      //Send the packet
+      error = ipv4SendDatagram(packet->interface, &pseudoHeader, buffer,
+         offset, &ancillary);
+   }
+
+   //Free previously allocated memory
+   netBufferFree(buffer);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Search the port redirection rules for a given packet
+ * @param[in] context Pointer to the NAT context
+ * @param[in] packet IP packet
+ * @return Pointer to the matching rule, if any
+ **/
+
+NatPortFwdRule *natMatchPortFwdRule(NatContext *context,
+   const NatIpPacket *packet)
+{
+   uint_t i;
+   bool_t inbound;
+   Ipv4Protocol protocol;
+   Ipv4Addr ipAddr;
+   uint16_t port;
+   NatPortFwdRule *rule;
+
+   //Direction of the packet
+   inbound = natIsPublicInterface(context, packet->interface);
+
+   //An ICMP error message is matched against the packet it quotes, which
+   //travelled in the opposite direction
+   if(packet->protocol == IPV4_PROTOCOL_ICMP &&
+      natIsIcmpErrorMessage(packet->icmpType))
+   {
+      protocol = packet->innerProtocol;
+      ipAddr = packet->innerDestIpAddr;
+      port = inbound ? packet->innerSrcPort : packet->innerDestPort;
+   }
+   else
+   {
+      protocol = packet->protocol;
+      ipAddr = packet->srcIpAddr;
+      port = inbound ? packet->destPort : packet->srcPort;
+   }
+
+   //Loop through the port redirection rules
+   for(i = 0; i < context->numPortFwdRules; i++)
+   {
+      //Point to the current rule
+      rule = &context->portFwdRules[i];
+
+      //Matching protocol?
+      if(rule->protocol != IPV4_PROTOCOL_NONE && rule->protocol == protocol)
+      {
+         //Inbound packet?
+         if(inbound)
+         {
+            //Check the public port range
+            if(port >= rule->publicPortMin && port <= rule->publicPortMax)
+               return rule;
+         }
+         else
+         {
+            //Check the private host and its port range
+            if(packet->interface == rule->privateInterface &&
+               ipAddr == rule->privateIpAddr &&
+               port >= rule->privatePortMin && port <= rule->privatePortMax)
+            {
+               return rule;
+            }
+         }
+      }
+   }
+
+   //No matching rule
+   return NULL;
+}
+
+
+/**
+ * @brief Search the session a given packet belongs to
+ * @param[in] context Pointer to the NAT context
+ * @param[in] packet IP packet
+ * @return Pointer to the matching session, if any
+ **/
+
+NatSession *natMatchSession(NatContext *context, const NatIpPacket *packet)
+{
+   NatSession *session;
+
+   //ICMP error message?
+   if(packet->protocol == IPV4_PROTOCOL_ICMP &&
+      natIsIcmpErrorMessage(packet->icmpType))
+   {
+      //The quoted packet travelled in the opposite direction
+      if(natIsPublicInterface(context, packet->interface))
+      {
+         //Outbound packet, from the public endpoint to the remote one
+         if(packet->innerProtocol == IPV4_PROTOCOL_ICMP)
+         {
+            session = natFindPublicSession(context, packet->innerProtocol,
+               packet->innerIcmpQueryId, packet->innerDestIpAddr, 0);
+         }
+         else
+         {
+            session = natFindPublicSession(context, packet->innerProtocol,
+               packet->innerSrcPort, packet->innerDestIpAddr,
+               packet->innerDestPort);
+         }
+      }
+      else
+      {
+         //Inbound packet, from the remote endpoint to the private one
+         if(packet->innerProtocol == IPV4_PROTOCOL_ICMP)
+         {
+            session = natFindPrivateSession(context, packet->innerProtocol,
+               packet->interface, packet->innerDestIpAddr,
+               packet->innerIcmpQueryId, packet->innerSrcIpAddr, 0);
+         }
+         else
+         {
+            session = natFindPrivateSession(context, packet->innerProtocol,
+               packet->interface, packet->innerDestIpAddr,
+               packet->innerDestPort, packet->innerSrcIpAddr,
+               packet->innerSrcPort);
+         }
+      }
+   }
+   else
+   {
+      //Inbound packet?
+      if(natIsPublicInterface(context, packet->interface))
+      {
+         //Search the session by public endpoint
+         if(packet->protocol == IPV4_PROTOCOL_ICMP)
+         {
+            session = natFindPublicSession(context, packet->protocol,
+               packet->icmpQueryId, packet->srcIpAddr, 0);
+         }
+         else
+         {
+            session = natFindPublicSession(context, packet->protocol,
+               packet->destPort, packet->srcIpAddr, packet->srcPort);
+         }
+      }
+      else
+      {
+         //Search the session by private endpoint
+         if(packet->protocol == IPV4_PROTOCOL_ICMP)
+         {
+            session = natFindPrivateSession(context, packet->protocol,
+               packet->interface, packet->srcIpAddr, packet->icmpQueryId,
+               packet->destIpAddr, 0);
+         }
+         else
+         {
+            session = natFindPrivateSession(context, packet->protocol,
+               packet->interface, packet->srcIpAddr, packet->srcPort,
+               packet->destIpAddr, packet->destPort);
+         }
+      }
+   }
+
+   //Return the matching session, if any
+   return session;
+}
+
+
+/**
+ * @brief Delete all the sessions
+ * @param[in] context Pointer to the NAT context
+ **/
+
+void natFlushSessions(NatContext *context)
+{
+   uint_t i;
+
+   //Clear the hash tables and the timer wheel
+   osMemset(context->privateHashTable, 0, sizeof(context->privateHashTable));
+   osMemset(context->publicHashTable, 0, sizeof(context->publicHashTable));
+   osMemset(context->timerWheel, 0, sizeof(context->timerWheel));
+
+   //Chain all the sessions in the free list
+   context->freeSessions = NULL;
+
+   for(i = context->numSessions; i > 0; i--)
+   {
+      context->sessions[i - 1].protocol = IPV4_PROTOCOL_NONE;
+      context->sessions[i - 1].nextPrivate = context->freeSessions;
+      context->freeSessions = &context->sessions[i - 1];
+   }
+
+   //No session is in use
+   context->activeSessions = 0;
+}
+
+
+/**
+ * @brief Take a free session
+ *
+ * Sessions are not recycled before their timeout: when they are all in use,
+ * new flows are refused until one expires
+ *
+ * @param[in] context Pointer to the NAT context
+ * @return Pointer to the session, if any
+ **/
+
+NatSession *natCreateSession(NatContext *context)
+{
+   NatSession *session;
+
+   //Point to the first free session
+   session = context->freeSessions;
+
+   //Any session available?
+   if(session != NULL)
+   {
+      //Remove it from the free list
+      context->freeSessions = session->nextPrivate;
+      //Clear the session
+      osMemset(session, 0, sizeof(NatSession));
+   }
+
+   //Return a pointer to the session
+   return session;
+}
+
+
+/**
+ * @brief Insert a new session in the hash tables and on the timer wheel
+ * @param[in] context Pointer to the NAT context
+ * @param[in] session Session whose endpoints have been set
+ **/
+
+void natAddSession(NatContext *context, NatSession *session)
+{
+   uint_t index;
+
+   //Chain the session on its private endpoint
+   if(session->protocol == IPV4_PROTOCOL_ICMP)
+   {
+      index = natHashPrivateEndpoint(session->protocol, session->privateIpAddr,
+         session->privateIcmpQueryId, session->remoteIpAddr, 0);
+   }
+   else
+   {
+      index = natHashPrivateEndpoint(session->protocol, session->privateIpAddr,
+         session->privatePort, session->remoteIpAddr, session->remotePort);
+   }
+
+   session->nextPrivate = context->privateHashTable[index];
+   context->privateHashTable[index] = session;
+
+   //Chain the session on its public endpoint
+   index = natHashPublicEndpoint(session->protocol,
+      (session->protocol == IPV4_PROTOCOL_ICMP) ?
+      session->publicIcmpQueryId : session->publicPort);
+
+   session->nextPublic = context->publicHashTable[index];
+   context->publicHashTable[index] = session;
+
+   //Start the timeout of the session
+   session->timestamp = osGetSystemTime();
+   natScheduleSession(context, session, natGetSessionTimeout(session->protocol));
+
+   //Update statistics
+   context->activeSessions++;
+   context->stats.sessionsCreated++;
+}
+
+
+/**
+ * @brief Delete a session
+ *
+ * The session must have been taken off the timer wheel already
+ *
+ * @param[in] context Pointer to the NAT context
+ * @param[in] session Session to be deleted
+ **/
+
+void natDeleteSession(NatContext *context, NatSession *session)
+{
+   uint_t index;
+   NatSession **p;
+
+   //Locate the session in its private hash chain
+   if(session->protocol == IPV4_PROTOCOL_ICMP)
+   {
+      index = natHashPrivateEndpoint(session->protocol, session->privateIpAddr,
+         session->privateIcmpQueryId, session->remoteIpAddr, 0);
+   }
+   else
+   {
+      index = natHashPrivateEndpoint(session->protocol, session->privateIpAddr,
+         session->privatePort, session->remoteIpAddr, session->remotePort);
+   }
+
+   //Unlink the session
+   for(p = &context->privateHashTable[index]; *p != NULL; p = &(*p)->nextPrivate)
+   {
+      if(*p == session)
+      {
+         *p = session->nextPrivate;
+         break;
+      }
+   }
+
+   //Locate the session in its public hash chain
+   index = natHashPublicEndpoint(session->protocol,
+      (session->protocol == IPV4_PROTOCOL_ICMP) ?
+      session->publicIcmpQueryId : session->publicPort);
+
+   //Unlink the session
+   for(p = &context->publicHashTable[index]; *p != NULL; p = &(*p)->nextPublic)
+   {
+      if(*p == session)
+      {
+         *p = session->nextPublic;
+         break;
+      }
+   }
+
+   //Return the session to the free list
+   session->protocol = IPV4_PROTOCOL_NONE;
+   session->nextPrivate = context->freeSessions;
+   context->freeSessions = session;
+
+   //Update statistics
+   context->activeSessions--;
+}
+
+
+/**
+ * @brief Place a session on the timer wheel
+ * @param[in] context Pointer to the NAT context
+ * @param[in] session Session whose timeout is to be checked
+ * @param[in] delay Time after which the timeout is checked
+ **/
+
+void natScheduleSession(NatContext *context, NatSession *session,
+   systime_t delay)
+{
+   uint_t n;
+   uint_t index;
+
+   //Number of slots to skip, rounded up
+   n = (delay + NAT_TICK_INTERVAL - 1) / NAT_TICK_INTERVAL;
+   //Longer delays take more than one turn of the wheel
+   n = MAX(n, 1);
+   n = MIN(n, NAT_TIMER_WHEEL_SIZE - 1);
+
+   //Point to the relevant slot
+   index = (context->timerWheelIndex + n) & (NAT_TIMER_WHEEL_SIZE - 1);
+
+   //Add the session to the slot
+   session->nextTimer = context->timerWheel[index];
+   context->timerWheel[index] = session;
+}
+
+
+/**
+ * @brief Search a session by private endpoint
+ * @param[in] context Pointer to the NAT context
+ * @param[in] protocol IP protocol
+ * @param[in] privateInterface Private interface
+ * @param[in] privateIpAddr Internal IP address
+ * @param[in] privateId Internal port or ICMP query identifier
+ * @param[in] remoteIpAddr Remote IP address
+ * @param[in] remotePort Remote port (0 for ICMP)
+ * @return Pointer to the matching session, if any
+ **/
+
+NatSession *natFindPrivateSession(NatContext *context, Ipv4Protocol protocol,
+   NetInterface *privateInterface, Ipv4Addr privateIpAddr, uint16_t privateId,
+   Ipv4Addr remoteIpAddr, uint16_t remotePort)
+{
+   uint_t index;
+   NatSession *session;
+
+   //Point to the relevant hash chain
+   index = natHashPrivateEndpoint(protocol, privateIpAddr, privateId,
+      remoteIpAddr, remotePort);
+
+   //Loop through the sessions of the chain
+   for(session = context->privateHashTable[index]; session != NULL;
+      session = session->nextPrivate)
+   {
+      //Matching endpoints?
+      if(session->protocol == protocol &&
+         session->privateInterface == privateInterface &&
+         session->privateIpAddr == privateIpAddr &&
+         session->remoteIpAddr == remoteIpAddr)
+      {
+         //ICMP sessions are identified by their query identifier
+         if(protocol == IPV4_PROTOCOL_ICMP)
+         {
+            if(session->privateIcmpQueryId == privateId)
+               break;
+         }
+         else
+         {
+            if(session->privatePort == privateId &&
+               session->remotePort == remotePort)
+            {
+               break;
+            }
+         }
+      }
+   }
+
+   //Return the matching session, if any
+   return session;
+}
+
+
+/**
+ * @brief Search a session by public endpoint
+ * @param[in] context Pointer to the NAT context
+ * @param[in] protocol IP protocol
+ * @param[in] publicId External port or ICMP query identifier
+ * @param[in] remoteIpAddr Remote IP address
+ * @param[in] remotePort Remote port (0 for ICMP)
+ * @return Pointer to the matching session, if any
+ **/
+
+NatSession *natFindPublicSession(NatContext *context, Ipv4Protocol protocol,
+   uint16_t publicId, Ipv4Addr remoteIpAddr, uint16_t remotePort)
+{
+   uint_t index;
+   NatSession *session;
+
+   //Point to the relevant hash chain
+   index = natHashPublicEndpoint(protocol, publicId);
+
+   //Loop through the sessions of the chain
+   for(session = context->publicHashTable[index]; session != NULL;
+      session = session->nextPublic)
+   {
+      //Matching endpoints?
+      if(session->protocol == protocol &&
+         session->remoteIpAddr == remoteIpAddr)
+      {
+         //ICMP sessions are identified by their query identifier
+         if(protocol == IPV4_PROTOCOL_ICMP)
+         {
+            if(session->publicIcmpQueryId == publicId)
+               break;
+         }
+         else
+         {
+            if(session->publicPort == publicId &&
+               session->remotePort == remotePort)
+            {
+               break;
+            }
+         }
+      }
+   }
+
+   //Return the matching session, if any
+   return session;
+}
+
+
+/**
+ * @brief Hash the private endpoint of a session
+ * @param[in] protocol IP protocol
+ * @param[in] privateIpAddr Internal IP address
+ * @param[in] privateId Internal port or ICMP query identifier
+ * @param[in] remoteIpAddr Remote IP address
+ * @param[in] remotePort Remote port (0 for ICMP)
+ * @return Index in the private hash table
+ **/
+
+uint_t natHashPrivateEndpoint(Ipv4Protocol protocol, Ipv4Addr privateIpAddr,
+   uint16_t privateId, Ipv4Addr remoteIpAddr, uint16_t remotePort)
+{
+   uint32_t h;
+
+   //Combine the fields of the endpoint
+   h = (uint32_t) privateIpAddr ^ ((uint32_t) remoteIpAddr * 0x9E3779B1U);
+   h ^= ((uint32_t) privateId << 16) | remotePort;
+   h ^= (uint32_t) protocol;
+
+   //Mix the bits before keeping the lower ones
+   h *= 0x9E3779B1U;
+   h ^= h >> 16;
+
+   //Return the index of the chain
+   return h & (NAT_HASH_TABLE_SIZE - 1);
+}
+
+
+/**
+ * @brief Hash the public endpoint of a session
+ * @param[in] protocol IP protocol
+ * @param[in] publicId External port or ICMP query identifier
+ * @return Index in the public hash table
+ **/
+
+uint_t natHashPublicEndpoint(Ipv4Protocol protocol, uint16_t publicId)
+{
+   uint32_t h;
+
+   //The public identifiers are allocated in turn, so that they spread
+   //evenly over the chains
+   h = ((uint32_t) protocol << 16) | publicId;
+
+   //Mix the bits before keeping the lower ones
+   h *= 0x9E3779B1U;
+   h ^= h >> 16;
+
+   //Return the index of the chain
+   return h & (NAT_HASH_TABLE_SIZE - 1);
+}
+
+
+/**
+ * @brief Get the timeout of a session
+ * @param[in] protocol IP protocol of the session
+ * @return Timeout value, in milliseconds
+ **/
+
+systime_t natGetSessionTimeout(Ipv4Protocol protocol)
+{
+   systime_t timeout;
+
+   //Check protocol
+   if(protocol == IPV4_PROTOCOL_TCP)
+   {
+      timeout = NAT_TCP_SESSION_TIMEOUT;
+   }
+   else if(protocol == IPV4_PROTOCOL_UDP)
+   {
+      timeout = NAT_UDP_SESSION_TIMEOUT;
+   }
+   else
+   {
+      timeout = NAT_ICMP_SESSION_TIMEOUT;
+   }
+
+   //Return the timeout value
+   return timeout;
+}
+
+
+/**
+ * @brief Get the address of the public interface
+ * @param[in] context Pointer to the NAT context
+ * @param[out] ipAddr Public IP address
+ * @return Error code
+ **/
+
+error_t natGetPublicIpAddr(NatContext *context, Ipv4Addr *ipAddr)
+{
+   Ipv4AddrEntry *entry;
+
+   //Make sure the index is valid
+   if(context->publicInterface == NULL ||
+      context->publicIpAddrIndex >= IPV4_ADDR_LIST_SIZE)
+   {
+      return ERROR_INVALID_INTERFACE;
+   }
+
+   //Point to the relevant address entry (the caller holds netMutex)
+   entry = &context->publicInterface->ipv4Context.addrList[
+      context->publicIpAddrIndex];
+
+   //The address may not be configured yet
+   if(entry->state != IPV4_ADDR_STATE_VALID)
+      return ERROR_NOT_CONFIGURED;
+
+   //Return the public IP address
+   *ipAddr = entry->addr;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Allocate a public TCP or UDP port
+ * @param[in] context Pointer to the NAT context
+ * @param[in] protocol Transport protocol
+ * @return Port number (0 if no port is available)
+ **/
+
+uint16_t natAllocatePort(NatContext *context, Ipv4Protocol protocol)
+{
+   uint_t i;
+   uint_t j;
+   uint_t n;
+   uint16_t port;
+   NatSession *session;
+   NatPortFwdRule *rule;
+
+   //Each session holds one port, and each redirected range is skipped at
+   //once, so that a free port is found within that many trials
+   n = context->numSessions + context->numPortFwdRules + 1;
+
+   //Candidate port
+   port = context->nextPort;
+
+   //Try the ports in turn
+   for(i = 0; i < n; i++)
+   {
+      //Ports redirected to a private host cannot be allocated
+      for(j = 0; j < context->numPortFwdRules; j++)
+      {
+         //Point to the current rule
+         rule = &context->portFwdRules[j];
+
+         //Redirected port?
+         if(rule->protocol == protocol && port >= rule->publicPortMin &&
+            port <= rule->publicPortMax)
+         {
+            break;
+         }
+      }
+
+      //Skip the redirected range
+      if(j < context->numPortFwdRules)
+      {
+         port = (rule->publicPortMax < NAT_TCP_UDP_PORT_MAX &&
+            rule->publicPortMax >= NAT_TCP_UDP_PORT_MIN) ?
+            rule->publicPortMax + 1 : NAT_TCP_UDP_PORT_MIN;
+
+         continue;
+      }
+
+      //Check whether a session already holds the port
+      session = context->publicHashTable[natHashPublicEndpoint(protocol, port)];
+
+      while(session != NULL)
+      {
+         if(session->protocol == protocol && session->publicPort == port)
+            break;
+
+         session = session->nextPublic;
+      }
+
+      //Next candidate
+      context->nextPort = (port < NAT_TCP_UDP_PORT_MAX) ? port + 1 :
+         NAT_TCP_UDP_PORT_MIN;
+
+      //Free port?
+      if(session == NULL)
+         return port;
+
+      //Try the next port
+      port = context->nextPort;
+   }
+
+   //No port is available
+   return 0;
+}
+
+
+/**
+ * @brief Allocate a public ICMP query identifier
+ * @param[in] context Pointer to the NAT context
+ * @return Query identifier (0 if no identifier is available)
+ **/
+
+uint16_t natAllocateIcmpQueryId(NatContext *context)
+{
+   uint_t i;
+   uint16_t id;
+   NatSession *session;
+
+   //Candidate identifier
+   id = context->nextIcmpQueryId;
+
+   //Each session holds one identifier
+   for(i = 0; i <= context->numSessions; i++)
+   {
+      //Check whether a session already holds the identifier
+      session = context->publicHashTable[natHashPublicEndpoint(
+         IPV4_PROTOCOL_ICMP, id)];
+
+      while(session != NULL)
+      {
+         if(session->protocol == IPV4_PROTOCOL_ICMP &&
+            session->publicIcmpQueryId == id)
+         {
+            break;
+         }
+
+         session = session->nextPublic;
+      }
+
+      //Next candidate
+      context->nextIcmpQueryId = (id < NAT_ICMP_QUERY_ID_MAX) ? id + 1 :
+         NAT_ICMP_QUERY_ID_MIN;
+
+      //Free identifier? (0 is reserved to report failures)
+      if(session == NULL && id != 0)
+         return id;
+
+      //Try the next identifier
+      id = context->nextIcmpQueryId;
+   }
+
+   //No identifier is available
+   return 0;
+}
+
+
+/**
+ * @brief Check whether an ICMP message is a query
+ * @param[in] type ICMP message type
+ * @return TRUE for query messages, which carry an identifier
+ **/
+
+bool_t natIsIcmpQueryMessage(uint8_t type)
+{
+   bool_t res;
+
+   //Check message type
+   if(type == ICMP_TYPE_ECHO_REQUEST || type == ICMP_TYPE_ECHO_REPLY ||
+      type == ICMP_TYPE_TIMESTAMP_REQUEST || type == ICMP_TYPE_TIMESTAMP_REPLY ||
+      type == ICMP_TYPE_INFO_REQUEST || type == ICMP_TYPE_INFO_REPLY ||
+      type == ICMP_TYPE_ADDR_MASK_REQUEST || type == ICMP_TYPE_ADDR_MASK_REPLY)
+   {
+      res = TRUE;
+   }
+   else
+   {
+      res = FALSE;
+   }
+
+   //Return TRUE for query messages
+   return res;
+}
+
+
+/**
+ * @brief Check whether an ICMP message is an error message
+ * @param[in] type ICMP message type
+ * @return TRUE for error messages, which quote the offending packet
+ **/
+
+bool_t natIsIcmpErrorMessage(uint8_t type)
+{
+   bool_t res;
+
+   //Check message type
+   if(type == ICMP_TYPE_DEST_UNREACHABLE || type == ICMP_TYPE_SOURCE_QUENCH ||
+      type == ICMP_TYPE_TIME_EXCEEDED || type == ICMP_TYPE_PARAM_PROBLEM)
+   {
+      res = TRUE;
+   }
+   else
+   {
+      res = FALSE;
+   }
+
+   //Return TRUE for error messages
+   return res;
+}
+
+
+/**
+ * @brief Extract the ports or the ICMP query identifier of a packet
+ * @param[in,out] packet IP packet
+ * @return Error code
+ **/
+
+error_t natParseTransportHeader(NatIpPacket *packet)
+{
+   error_t error;
+   TcpHeader *tcpHeader;
+   UdpHeader *udpHeader;
+   IcmpQueryMessage *icmpMessage;
+
+   //Check IP protocol
+   if(packet->protocol == IPV4_PROTOCOL_TCP)
+   {
+      //Point to the TCP header
+      tcpHeader = netBufferAt(packet->buffer, packet->offset,
+         sizeof(TcpHeader));
+
+      //Malformed packet?
+      if(tcpHeader == NULL)
+         return ERROR_INVALID_HEADER;
+
+      //Retrieve the ports
+      packet->srcPort = ntohs(tcpHeader->srcPort);
+      packet->destPort = ntohs(tcpHeader->destPort);
+
+      //Successful processing
+      error = NO_ERROR;
+   }
+   else if(packet->protocol == IPV4_PROTOCOL_UDP)
+   {
+      //Point to the UDP header
+      udpHeader = netBufferAt(packet->buffer, packet->offset,
+         sizeof(UdpHeader));
+
+      //Malformed packet?
+      if(udpHeader == NULL)
+         return ERROR_INVALID_HEADER;
+
+      //Retrieve the ports
+      packet->srcPort = ntohs(udpHeader->srcPort);
+      packet->destPort = ntohs(udpHeader->destPort);
+
+      //Successful processing
+      error = NO_ERROR;
+   }
+   else if(packet->protocol == IPV4_PROTOCOL_ICMP)
+   {
+      //Point to the ICMP header (query and error messages have the same
+      //length)
+      icmpMessage = netBufferAt(packet->buffer, packet->offset,
+         sizeof(IcmpQueryMessage));
+
+      //Malformed packet?
+      if(icmpMessage == NULL)
+         return ERROR_INVALID_HEADER;
+
+      //Save the message type
+      packet->icmpType = icmpMessage->type;
+
+      //Check message type
+      if(natIsIcmpQueryMessage(icmpMessage->type))
+      {
+         //Retrieve the query identifier
+         packet->icmpQueryId = ntohs(icmpMessage->identifier);
+         //Successful processing
+         error = NO_ERROR;
+      }
+      else if(natIsIcmpErrorMessage(icmpMessage->type))
+      {
+         //Parse the quoted packet
+         error = natParseIcmpErrorMessage(packet);
+      }
+      else
+      {
+         //Other messages are not translated
+         error = ERROR_INVALID_TYPE;
+      }
+   }
+   else
+   {
+      //Other protocols are not translated
+      error = ERROR_INVALID_PROTOCOL;
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Extract the endpoints of the packet quoted by an ICMP error message
+ * @param[in,out] packet IP packet
+ * @return Error code
+ **/
+
+error_t natParseIcmpErrorMessage(NatIpPacket *packet)
+{
+   size_t offset;
+   size_t headerLength;
+   Ipv4Header *header;
+   UdpHeader *udpHeader;
+   IcmpQueryMessage *icmpMessage;
+
+   //The quoted packet follows the ICMP header
+   offset = packet->offset + sizeof(IcmpErrorMessage);
+
+   //Point to its IP header
+   header = netBufferAt(packet->buffer, offset, sizeof(Ipv4Header));
+   //Malformed message?
+   if(header == NULL)
+      return ERROR_INVALID_HEADER;
+
+   //Check version and header length
+   if(header->version != IPV4_VERSION || header->headerLength < 5)
+      return ERROR_INVALID_HEADER;
+
+   //Get the length of the IP header
+   headerLength = header->headerLength * 4;
+
+   //The header is followed by at least 8 bytes of the original payload
+   //(refer to RFC 792)
+   if(netBufferAt(packet->buffer, offset, headerLength + 8) == NULL)
+      return ERROR_INVALID_HEADER;
+
+   //Only the first fragment carries the ports
+   if((ntohs(header->fragmentOffset) & IPV4_OFFSET_MASK) != 0)
+      return ERROR_INVALID_HEADER;
+
+   //Save the addresses of the quoted packet
+   packet->innerProtocol = (Ipv4Protocol) header->protocol;
+   packet->innerSrcIpAddr = header->srcAddr;
+   packet->innerDestIpAddr = header->destAddr;
+
+   //Point to the quoted payload
+   offset += headerLength;
+
+   //Check the protocol of the quoted packet
+   if(packet->innerProtocol == IPV4_PROTOCOL_TCP ||
+      packet->innerProtocol == IPV4_PROTOCOL_UDP)
+   {
+      //The ports are at the same location in TCP and UDP headers
+      udpHeader = netBufferAt(packet->buffer, offset, 4);
+
+      //Retrieve the ports
+      packet->innerSrcPort = ntohs(udpHeader->srcPort);
+      packet->innerDestPort = ntohs(udpHeader->destPort);
+   }
+   else if(packet->innerProtocol == IPV4_PROTOCOL_ICMP)
+   {
+      //Point to the quoted ICMP message
+      icmpMessage = netBufferAt(packet->buffer, offset,
+         sizeof(IcmpQueryMessage));
+
+      //Errors about an ICMP error message are not translated
+      if(!natIsIcmpQueryMessage(icmpMessage->type))
+         return ERROR_INVALID_TYPE;
+
+      //Retrieve the query identifier
+      packet->innerIcmpQueryId = ntohs(icmpMessage->identifier);
+   }
+   else
+   {
+      //Other protocols are not translated
+      return ERROR_INVALID_PROTOCOL;
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Rewrite the transport header of a translated packet
+ * @param[in] packet Translated IP packet
+ * @param[in] pseudoHeader IPv4 pseudo header of the received packet
+ * @param[in] buffer Multi-part buffer that holds a copy of the payload
+ * @param[in] offset Offset to the first byte of the payload
+ * @return Error code
+ **/
+
+error_t natTranslateTransportHeader(const NatIpPacket *packet,
+   const Ipv4PseudoHeader *pseudoHeader, const NetBuffer *buffer,
+   size_t offset)
+{
+   size_t headerLength;
+   uint16_t checksum;
+   Ipv4Header *header;
+   TcpHeader *tcpHeader;
+   UdpHeader *udpHeader;
+   IcmpQueryMessage *icmpMessage;
+
+   //Check IP protocol
+   if(packet->protocol == IPV4_PROTOCOL_TCP)
+   {
+      //Point to the TCP header
+      tcpHeader = netBufferAt(buffer, offset, sizeof(TcpHeader));
+      //Sanity check
+      if(tcpHeader == NULL)
+         return ERROR_INVALID_HEADER;
+
+      //The checksum covers the addresses of the pseudo header and the ports
+      checksum = tcpHeader->checksum;
+      checksum = natAdjustChecksum32(checksum, pseudoHeader->srcAddr,
+         packet->srcIpAddr);
+      checksum = natAdjustChecksum32(checksum, pseudoHeader->destAddr,
+         packet->destIpAddr);
+      checksum = natAdjustChecksum(checksum, tcpHeader->srcPort,
+         htons(packet->srcPort));
+      checksum = natAdjustChecksum(checksum, tcpHeader->destPort,
+         htons(packet->destPort));
+
+      //Rewrite the TCP header
+      tcpHeader->srcPort = htons(packet->srcPort);
+      tcpHeader->destPort = htons(packet->destPort);
+      tcpHeader->checksum = checksum;
+   }
+   else if(packet->protocol == IPV4_PROTOCOL_UDP)
+   {
+      //Point to the UDP header
+      udpHeader = netBufferAt(buffer, offset, sizeof(UdpHeader));
+      //Sanity check
+      if(udpHeader == NULL)
+         return ERROR_INVALID_HEADER;
+
+      //A zero checksum means that none was computed by the sender
+      if(udpHeader->checksum != 0x0000)
+      {
+         //The checksum covers the addresses of the pseudo header and the
+         //ports
+         checksum = udpHeader->checksum;
+         checksum = natAdjustChecksum32(checksum, pseudoHeader->srcAddr,
+            packet->srcIpAddr);
+         checksum = natAdjustChecksum32(checksum, pseudoHeader->destAddr,
+            packet->destIpAddr);
+         checksum = natAdjustChecksum(checksum, udpHeader->srcPort,
+            htons(packet->srcPort));
+         checksum = natAdjustChecksum(checksum, udpHeader->destPort,
+            htons(packet->destPort));
+
+         //A computed checksum of zero is transmitted as all ones (refer to
+         //RFC 768)
+         udpHeader->checksum = (checksum == 0x0000) ? 0xFFFF : checksum;
+      }
+
+      //Rewrite the ports
+      udpHeader->srcPort = htons(packet->srcPort);
+      udpHeader->destPort = htons(packet->destPort);
+   }
+   else if(packet->protocol == IPV4_PROTOCOL_ICMP)
+   {
+      //Point to the ICMP header
+      icmpMessage = netBufferAt(buffer, offset, sizeof(IcmpQueryMessage));
+      //Sanity check
+      if(icmpMessage == NULL)
+         return ERROR_INVALID_HEADER;
+
+      //Query message?
+      if(natIsIcmpQueryMessage(icmpMessage->type))
+      {
+         //The ICMP checksum does not cover the pseudo header
+         icmpMessage->checksum = natAdjustChecksum(icmpMessage->checksum,
+            icmpMessage->identifier, htons(packet->icmpQueryId));
+
+         //Rewrite the query identifier
+         icmpMessage->identifier = htons(packet->icmpQueryId);
+      }
+      else
+      {
+         //Point to the quoted IP header
+         offset += sizeof(IcmpErrorMessage);
+         header = netBufferAt(buffer, offset, sizeof(Ipv4Header));
+         //Sanity check
+         if(header == NULL)
+            return ERROR_INVALID_HEADER;
+
+         //Get the length of the quoted IP header
+         headerLength = header->headerLength * 4;
+
+         //Point to the quoted transport header
+         if(packet->innerProtocol == IPV4_PROTOCOL_TCP)
+         {
+            //The TCP checksum is only present if the error message quotes
+            //enough of the original segment
+            tcpHeader = netBufferAt(buffer, offset + headerLength,
+               sizeof(TcpHeader));
+
+            if(tcpHeader != NULL)
+            {
+               checksum = tcpHeader->checksum;
+               checksum = natAdjustChecksum32(checksum, header->srcAddr,
+                  packet->innerSrcIpAddr);
+               checksum = natAdjustChecksum32(checksum, header->destAddr,
+                  packet->innerDestIpAddr);
+               checksum = natAdjustChecksum(checksum, tcpHeader->srcPort,
+                  htons(packet->innerSrcPort));
+               checksum = natAdjustChecksum(checksum, tcpHeader->destPort,
+                  htons(packet->innerDestPort));
+               tcpHeader->checksum = checksum;
+            }
+
+            //The ports are always present
+            udpHeader = netBufferAt(buffer, offset + headerLength, 4);
+            //Sanity check
+            if(udpHeader == NULL)
+               return ERROR_INVALID_HEADER;
+
+            udpHeader->srcPort = htons(packet->innerSrcPort);
+            udpHeader->destPort = htons(packet->innerDestPort);
+         }
+         else if(packet->innerProtocol == IPV4_PROTOCOL_UDP)
+         {
+            //The quoted payload holds the whole UDP header
+            udpHeader = netBufferAt(buffer, offset + headerLength,
+               sizeof(UdpHeader));
+            //Sanity check
+            if(udpHeader == NULL)
+               return ERROR_INVALID_HEADER;
+
+            if(udpHeader->checksum != 0x0000)
+            {
+               checksum = udpHeader->checksum;
+               checksum = natAdjustChecksum32(checksum, header->srcAddr,
+                  packet->innerSrcIpAddr);
+               checksum = natAdjustChecksum32(checksum, header->destAddr,
+                  packet->innerDestIpAddr);
+               checksum = natAdjustChecksum(checksum, udpHeader->srcPort,
+                  htons(packet->innerSrcPort));
+               checksum = natAdjustChecksum(checksum, udpHeader->destPort,
+                  htons(packet->innerDestPort));
+               udpHeader->checksum = (checksum == 0x0000) ? 0xFFFF : checksum;
+            }
+
+            udpHeader->srcPort = htons(packet->innerSrcPort);
+            udpHeader->destPort = htons(packet->innerDestPort);
+         }
+         else
+         {
+            //The quoted ICMP query holds its identifier
+            icmpMessage = netBufferAt(buffer, offset + headerLength,
+               sizeof(IcmpQueryMessage));
+            //Sanity check
+            if(icmpMessage == NULL)
+               return ERROR_INVALID_HEADER;
+
+            icmpMessage->checksum = natAdjustChecksum(icmpMessage->checksum,
+               icmpMessage->identifier, htons(packet->innerIcmpQueryId));
+            icmpMessage->identifier = htons(packet->innerIcmpQueryId);
+         }
+
+         //Rewrite the quoted IP header
+         checksum = header->headerChecksum;
+         checksum = natAdjustChecksum32(checksum, header->srcAddr,
+            packet->innerSrcIpAddr);
+         checksum = natAdjustChecksum32(checksum, header->destAddr,
+            packet->innerDestIpAddr);
+
+         header->srcAddr = packet->innerSrcIpAddr;
+         header->destAddr = packet->innerDestIpAddr;
+         header->headerChecksum = checksum;
+
+         //Point to the ICMP header
+         offset -= sizeof(IcmpErrorMessage);
+         icmpMessage = netBufferAt(buffer, offset, sizeof(IcmpErrorMessage));
+
+         //Most of the message has changed, so the ICMP checksum is computed
+         //again over the whole message
+         icmpMessage->checksum = 0;
+         icmpMessage->checksum = ipCalcChecksumEx(buffer, offset,
+            netBufferGetLength(buffer) - offset);
+      }
+   }
+   else
+   {
+      //Other protocols are not translated
+      return ERROR_INVALID_PROTOCOL;
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Update a checksum after a 16-bit field has changed
+ *
+ * All the values are taken as they are stored in the packet, since the
+ * one's complement sum does not depend on the byte order
+ *
+ * @param[in] checksum Current checksum
+ * @param[in] oldValue Former value of the field
+ * @param[in] newValue New value of the field
+ * @return Updated checksum
+ **/
+
+uint16_t natAdjustChecksum(uint16_t checksum, uint16_t oldValue,
+   uint16_t newValue)
+{
+   uint32_t temp;
+
+   //HC' = ~(~HC + ~m + m') (refer to RFC 1624, section 3)
+   temp = (uint16_t) ~checksum;
+   temp += (uint16_t) ~oldValue;
+   temp += newValue;
+
+   //Fold 32-bit sum to 16 bits
+   temp = (temp & 0xFFFF) + (temp >> 16);
+   temp = (temp & 0xFFFF) + (temp >> 16);
+
+   //Return the updated checksum
+   return (uint16_t) ~temp;
+}
+
+
+/**
+ * @brief Update a checksum after a 32-bit field has changed
+ * @param[in] checksum Current checksum
+ * @param[in] oldValue Former value of the field
+ * @param[in] newValue New value of the field
+ * @return Updated checksum
+ **/
+
+uint16_t natAdjustChecksum32(uint16_t checksum, uint32_t oldValue,
+   uint32_t newValue)
+{
+   //Unchanged field?
+   if(oldValue == newValue)
+      return checksum;
+
+   //The field is made of two 16-bit words
+   checksum = natAdjustChecksum(checksum, (uint16_t) (oldValue >> 16),
+      (uint16_t) (newValue >> 16));
+   checksum = natAdjustChecksum(checksum, (uint16_t) oldValue,
+      (uint16_t) newValue);
+
+   //Return the updated checksum
+   return checksum;
+}
+
+
+/**
+ * @brief Dump a translated packet for debugging purpose
+ * @param[in] packet Translated IP packet
+ **/
+
+void natDumpPacket(const NatIpPacket *packet)
+{
+#if (NAT_TRACE_LEVEL >= TRACE_LEVEL_DEBUG)
+   //Debug message
+   TRACE_DEBUG("NAT: %s packet on %s\r\n",
+      (packet->protocol == IPV4_PROTOCOL_TCP) ? "TCP" :
+      (packet->protocol == IPV4_PROTOCOL_UDP) ? "UDP" : "ICMP",
+      packet->interface->name);
+
+   TRACE_DEBUG("  Source = %s:%" PRIu16 "\r\n",
+      ipv4AddrToString(packet->srcIpAddr, NULL), packet->srcPort);
+
+   TRACE_DEBUG("  Destination = %s:%" PRIu16 "\r\n",
+      ipv4AddrToString(packet->destIpAddr, NULL), packet->destPort);
+
+   //ICMP message?
+   if(packet->protocol == IPV4_PROTOCOL_ICMP)
+   {
+      TRACE_DEBUG("  ICMP type = %" PRIu16 ", identifier = %" PRIu16 "\r\n",
+         packet->icmpType, packet->icmpQueryId);
+   }
+#endif
+}
+
+#endif
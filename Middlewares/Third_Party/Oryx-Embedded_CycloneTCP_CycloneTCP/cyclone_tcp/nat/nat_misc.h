@@ -56,24 +56,56 @@ error_t natProcessPacket(NatContext *context, NetInterface *inInterface,
 error_t natTranslateInboundPacket(NatContext *context, NatIpPacket *packet);
 error_t natTranslateOutboundPacket(NatContext *context, NatIpPacket *packet);
 
-error_t natForwardPacket(NatContext *context, const NatIpPacket *packet);
+error_t natForwardPacket(NatContext *context,
+   const Ipv4PseudoHeader *inPseudoHeader, const NatIpPacket *packet);
 
 NatPortFwdRule *natMatchPortFwdRule(NatContext *context,
    const NatIpPacket *packet);
 
 NatSession *natMatchSession(NatContext *context, const NatIpPacket *packet);
 
+void natFlushSessions(NatContext *context);
+
 NatSession *natCreateSession(NatContext *context);
+void natAddSession(NatContext *context, NatSession *session);
+void natDeleteSession(NatContext *context, NatSession *session);
+void natScheduleSession(NatContext *context, NatSession *session,
+   systime_t delay);
+
+NatSession *natFindPrivateSession(NatContext *context, Ipv4Protocol protocol,
+   NetInterface *privateInterface, Ipv4Addr privateIpAddr, uint16_t privateId,
+   Ipv4Addr remoteIpAddr, uint16_t remotePort);
+
+NatSession *natFindPublicSession(NatContext *context, Ipv4Protocol protocol,
+   uint16_t publicId, Ipv4Addr remoteIpAddr, uint16_t remotePort);
+
+uint_t natHashPrivateEndpoint(Ipv4Protocol protocol, Ipv4Addr privateIpAddr,
+   uint16_t privateId, Ipv4Addr remoteIpAddr, uint16_t remotePort);
+
+uint_t natHashPublicEndpoint(Ipv4Protocol protocol, uint16_t publicId);
 
-uint16_t natAllocatePort(NatContext *context);
+systime_t natGetSessionTimeout(Ipv4Protocol protocol);
+error_t natGetPublicIpAddr(NatContext *context, Ipv4Addr *ipAddr);
+
+bool_t natIsIcmpQueryMessage(uint8_t type);
+bool_t natIsIcmpErrorMessage(uint8_t type);
+
+uint16_t natAllocatePort(NatContext *context, Ipv4Protocol protocol);
 uint16_t natAllocateIcmpQueryId(NatContext *context);
 
 error_t natParseTransportHeader(NatIpPacket *packet);
+error_t natParseIcmpErrorMessage(NatIpPacket *packet);
 
 error_t natTranslateTransportHeader(const NatIpPacket *packet,
    const Ipv4PseudoHeader *pseudoHeader, const NetBuffer *buffer,
    size_t offset);
 
+uint16_t natAdjustChecksum(uint16_t checksum, uint16_t oldValue,
+   uint16_t newValue);
+
+uint16_t natAdjustChecksum32(uint16_t checksum, uint32_t oldValue,
+   uint32_t newValue);
+
 void natDumpPacket(const NatIpPacket *packet);
 
 //C++ guard
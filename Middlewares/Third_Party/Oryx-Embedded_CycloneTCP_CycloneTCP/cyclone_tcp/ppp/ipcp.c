@@ -0,0 +1,1113 @@
+/**
+ * @file ipcp.c
+ * @brief IPCP (PPP Internet Protocol Control Protocol)
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * IPCP is responsible for configuring the IPv4 address of the local side
+ * and the addresses of the DNS servers, which are assigned by the peer
+ * through Configure-Nak packets. Refer to RFC 1332 and RFC 1877 for more
+ * details. IP header compression is not supported
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL PPP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "ppp/ppp_fsm.h"
+#include "ppp/ppp_misc.h"
+#include "ppp/ppp_debug.h"
+#include "ppp/ipcp.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (PPP_SUPPORT == ENABLED && IPV4_SUPPORT == ENABLED)
+
+
+/**
+ * @brief IPCP FSM callbacks
+ **/
+
+static const PppCallbacks ipcpCallbacks =
+{
+   ipcpThisLayerUp,
+   ipcpThisLayerDown,
+   ipcpThisLayerStarted,
+   ipcpThisLayerFinished,
+   ipcpInitRestartCount,
+   ipcpZeroRestartCount,
+   ipcpSendConfigureReq,
+   ipcpSendConfigureAck,
+   ipcpSendConfigureNak,
+   ipcpSendConfigureRej,
+   ipcpSendTerminateReq,
+   ipcpSendTerminateAck,
+   ipcpSendCodeRej,
+   NULL
+};
+
+
+/**
+ * @brief IPCP Open event
+ *
+ * LCP has reached the Opened state, hence the Up event is signaled right
+ * away
+ *
+ * @param[in] context PPP context
+ * @return Error code
+ **/
+
+error_t ipcpOpen(PppContext *context)
+{
+   //Debug message
+   TRACE_INFO("\r\nIPCP Open event\r\n");
+
+   //Advance the IPCP state machine
+   pppOpenEvent(context, &context->ipcpFsm, &ipcpCallbacks);
+   pppUpEvent(context, &context->ipcpFsm, &ipcpCallbacks);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief IPCP Close event
+ * @param[in] context PPP context
+ * @return Error code
+ **/
+
+error_t ipcpClose(PppContext *context)
+{
+   //Debug message
+   TRACE_INFO("\r\nIPCP Close event\r\n");
+
+   //The network layer is no longer available
+   pppCloseEvent(context, &context->ipcpFsm, &ipcpCallbacks);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief IPCP timer handler
+ *
+ * This routine must be periodically called by the TCP/IP stack to
+ * manage retransmissions
+ *
+ * @param[in] context PPP context
+ **/
+
+void ipcpTick(PppContext *context)
+{
+   systime_t time;
+
+   //The restart timer is running in the Closing, Stopping, Req-Sent,
+   //Ack-Rcvd and Ack-Sent states
+   if(context->ipcpFsm.state >= PPP_STATE_4_CLOSING &&
+      context->ipcpFsm.state <= PPP_STATE_8_ACK_SENT)
+   {
+      //Get current time
+      time = osGetSystemTime();
+
+      //Check whether the restart timer has expired
+      if(timeCompare(time, context->ipcpFsm.timestamp + PPP_RESTART_TIMER) >= 0)
+      {
+         //Debug message
+         TRACE_INFO("\r\nIPCP Timeout event\r\n");
+
+         //The restart timer is used to retransmit Configure-Request
+         //and Terminate-Request packets
+         pppTimeoutEvent(context, &context->ipcpFsm, &ipcpCallbacks);
+      }
+   }
+}
+
+
+/**
+ * @brief Process an incoming IPCP packet
+ * @param[in] context PPP context
+ * @param[in] packet IPCP packet received from the peer
+ * @param[in] length Length of the packet, in bytes
+ **/
+
+void ipcpProcessPacket(PppContext *context, const PppPacket *packet, size_t length)
+{
+   size_t n;
+
+   //Ensure the length of the incoming IPCP packet is valid
+   if(length < sizeof(PppPacket))
+      return;
+
+   //Retrieve the length field
+   n = ntohs(packet->length);
+
+   //Check the length field
+   if(n < sizeof(PppPacket) || n > length)
+      return;
+
+   //Octets outside the range of the length field are treated as padding
+   length = n;
+
+   //Debug message
+   TRACE_INFO("IPCP packet received (%" PRIuSIZE " bytes)...\r\n", length);
+   //Dump IPCP packet contents for debugging purpose
+   pppDumpPacket(packet, length, PPP_PROTOCOL_IPCP);
+
+   //Check IPCP code field
+   switch(packet->code)
+   {
+   //Configure-Request packet?
+   case PPP_CODE_CONFIGURE_REQ:
+      //Process Configure-Request packet
+      ipcpProcessConfigureReq(context, (PppConfigurePacket *) packet);
+      break;
+
+   //Configure-Ack packet?
+   case PPP_CODE_CONFIGURE_ACK:
+      //Process Configure-Ack packet
+      ipcpProcessConfigureAck(context, (PppConfigurePacket *) packet);
+      break;
+
+   //Configure-Nak packet?
+   case PPP_CODE_CONFIGURE_NAK:
+      //Process Configure-Nak packet
+      ipcpProcessConfigureNak(context, (PppConfigurePacket *) packet);
+      break;
+
+   //Configure-Reject packet?
+   case PPP_CODE_CONFIGURE_REJ:
+      //Process Configure-Reject packet
+      ipcpProcessConfigureReject(context, (PppConfigurePacket *) packet);
+      break;
+
+   //Terminate-Request packet?
+   case PPP_CODE_TERMINATE_REQ:
+      //Process Terminate-Request packet
+      ipcpProcessTerminateReq(context, (PppTerminatePacket *) packet);
+      break;
+
+   //Terminate-Ack packet?
+   case PPP_CODE_TERMINATE_ACK:
+      //Process Terminate-Ack packet
+      ipcpProcessTerminateAck(context, (PppTerminatePacket *) packet);
+      break;
+
+   //Code-Reject packet?
+   case PPP_CODE_CODE_REJ:
+      //Check the length of the packet
+      if(length >= sizeof(PppCodeRejPacket))
+      {
+         //Process Code-Reject packet
+         ipcpProcessCodeRej(context, (PppCodeRejPacket *) packet);
+      }
+      break;
+
+   //Unknown code field
+   default:
+      //The packet is un-interpretable
+      ipcpProcessUnknownCode(context, packet);
+      break;
+   }
+}
+
+
+/**
+ * @brief Process Configure-Request packet
+ * @param[in] context PPP context
+ * @param[in] configureReqPacket Packet received from the peer
+ * @return Error code
+ **/
+
+error_t ipcpProcessConfigureReq(PppContext *context,
+   const PppConfigurePacket *configureReqPacket)
+{
+   error_t error;
+   size_t length;
+   PppCode code;
+   PppOption *option;
+
+   //Debug message
+   TRACE_INFO("\r\nIPCP Receive-Configure-Request event\r\n");
+
+   //All the options are assumed to be acceptable
+   code = PPP_CODE_CONFIGURE_ACK;
+
+   //Retrieve the length of the option list
+   length = ntohs(configureReqPacket->length) - sizeof(PppConfigurePacket);
+   //Point to the first option
+   option = (PppOption *) configureReqPacket->options;
+
+   //Check the options without building any reply
+   while(length > 0)
+   {
+      //Parse current option
+      error = ipcpParseOption(context, option, length, NULL);
+
+      //Unrecognized option?
+      if(error == ERROR_INVALID_TYPE)
+      {
+         //Configure-Reject takes precedence over Configure-Nak
+         code = PPP_CODE_CONFIGURE_REJ;
+      }
+      //Unacceptable value?
+      else if(error == ERROR_INVALID_VALUE)
+      {
+         //A suggested value is sent back unless options are rejected
+         if(code == PPP_CODE_CONFIGURE_ACK)
+         {
+            code = PPP_CODE_CONFIGURE_NAK;
+         }
+      }
+      //Malformed option?
+      else if(error)
+      {
+         //The packet is silently discarded
+         return error;
+      }
+
+      //Remaining bytes to process
+      length -= option->length;
+      //Jump to the next option
+      option = (PppOption *) ((uint8_t *) option + option->length);
+   }
+
+   //The negotiation does not converge?
+   if(code == PPP_CODE_CONFIGURE_NAK &&
+      context->ipcpFsm.failureCounter >= PPP_MAX_FAILURE)
+   {
+      //Configure-Nak packets are converted to Configure-Reject packets
+      code = PPP_CODE_CONFIGURE_REJ;
+   }
+
+   //Advance the IPCP state machine
+   pppRcvConfigureReqEvent(context, &context->ipcpFsm, &ipcpCallbacks,
+      configureReqPacket, code);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Process Configure-Ack packet
+ * @param[in] context PPP context
+ * @param[in] configureAckPacket Packet received from the peer
+ * @return Error code
+ **/
+
+error_t ipcpProcessConfigureAck(PppContext *context,
+   const PppConfigurePacket *configureAckPacket)
+{
+   //Debug message
+   TRACE_INFO("\r\nIPCP Receive-Configure-Ack event\r\n");
+
+   //When a packet is received with an invalid Identifier field, the
+   //packet is silently discarded without affecting the automaton
+   if(configureAckPacket->identifier != context->ipcpFsm.identifier)
+      return ERROR_WRONG_IDENTIFIER;
+
+   //Advance the IPCP state machine
+   pppRcvConfigureAckEvent(context, &context->ipcpFsm, &ipcpCallbacks);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Process Configure-Nak packet
+ *
+ * The peer assigns the IP address of the local side and the addresses of
+ * the DNS servers by sending back the options with the values to use
+ *
+ * @param[in] context PPP context
+ * @param[in] configureNakPacket Packet received from the peer
+ * @return Error code
+ **/
+
+error_t ipcpProcessConfigureNak(PppContext *context,
+   const PppConfigurePacket *configureNakPacket)
+{
+   size_t length;
+   PppOption *option;
+
+   //Debug message
+   TRACE_INFO("\r\nIPCP Receive-Configure-Nak event\r\n");
+
+   //When a packet is received with an invalid Identifier field, the
+   //packet is silently discarded without affecting the automaton
+   if(configureNakPacket->identifier != context->ipcpFsm.identifier)
+      return ERROR_WRONG_IDENTIFIER;
+
+   //Retrieve the length of the option list
+   length = ntohs(configureNakPacket->length) - sizeof(PppConfigurePacket);
+   //Point to the first option
+   option = (PppOption *) configureNakPacket->options;
+
+   //Parse Configure-Nak packet
+   while(length > 0)
+   {
+      //Malformed IPCP packet?
+      if(length < sizeof(PppOption))
+         return ERROR_INVALID_LENGTH;
+
+      //Check option length
+      if(option->length < sizeof(PppOption) || option->length > length)
+         return ERROR_INVALID_LENGTH;
+
+      //All the supported options carry a single IPv4 address
+      if(option->length == sizeof(IpcpIpAddressOption))
+      {
+         //IP-Address option?
+         if(option->type == IPCP_OPTION_IP_ADDRESS)
+         {
+            //Save the IP address assigned by the peer
+            ipv4CopyAddr(&context->localConfig.ipAddr, option->data);
+         }
+         //Primary-DNS-Server-Address option?
+         else if(option->type == IPCP_OPTION_PRIMARY_DNS)
+         {
+            //Save primary DNS server address
+            ipv4CopyAddr(&context->localConfig.primaryDns, option->data);
+         }
+         //Secondary-DNS-Server-Address option?
+         else if(option->type == IPCP_OPTION_SECONDARY_DNS)
+         {
+            //Save secondary DNS server address
+            ipv4CopyAddr(&context->localConfig.secondaryDns, option->data);
+         }
+         else
+         {
+            //Unknown option
+         }
+      }
+
+      //Remaining bytes to process
+      length -= option->length;
+      //Jump to the next option
+      option = (PppOption *) ((uint8_t *) option + option->length);
+   }
+
+   //Advance the IPCP state machine
+   pppRcvConfigureNakEvent(context, &context->ipcpFsm, &ipcpCallbacks);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Process Configure-Reject packet
+ * @param[in] context PPP context
+ * @param[in] configureRejPacket Packet received from the peer
+ * @return Error code
+ **/
+
+error_t ipcpProcessConfigureReject(PppContext *context,
+   const PppConfigurePacket *configureRejPacket)
+{
+   size_t length;
+   PppOption *option;
+
+   //Debug message
+   TRACE_INFO("\r\nIPCP Receive-Configure-Reject event\r\n");
+
+   //When a packet is received with an invalid Identifier field, the
+   //packet is silently discarded without affecting the automaton
+   if(configureRejPacket->identifier != context->ipcpFsm.identifier)
+      return ERROR_WRONG_IDENTIFIER;
+
+   //Retrieve the length of the option list
+   length = ntohs(configureRejPacket->length) - sizeof(PppConfigurePacket);
+   //Point to the first option
+   option = (PppOption *) configureRejPacket->options;
+
+   //Parse Configure-Reject packet
+   while(length > 0)
+   {
+      //Malformed IPCP packet?
+      if(length < sizeof(PppOption))
+         return ERROR_INVALID_LENGTH;
+
+      //Check option length
+      if(option->length < sizeof(PppOption) || option->length > length)
+         return ERROR_INVALID_LENGTH;
+
+      //The rejected options are no longer sent in Configure-Request packets
+      if(option->type == IPCP_OPTION_IP_ADDRESS)
+      {
+         context->localConfig.ipAddrRejected = TRUE;
+      }
+      else if(option->type == IPCP_OPTION_PRIMARY_DNS)
+      {
+         context->localConfig.primaryDnsRejected = TRUE;
+      }
+      else if(option->type == IPCP_OPTION_SECONDARY_DNS)
+      {
+         context->localConfig.secondaryDnsRejected = TRUE;
+      }
+      else
+      {
+         //Unknown option
+      }
+
+      //Remaining bytes to process
+      length -= option->length;
+      //Jump to the next option
+      option = (PppOption *) ((uint8_t *) option + option->length);
+   }
+
+   //Advance the IPCP state machine
+   pppRcvConfigureNakEvent(context, &context->ipcpFsm, &ipcpCallbacks);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Process Terminate-Request packet
+ * @param[in] context PPP context
+ * @param[in] terminateReqPacket Packet received from the peer
+ * @return Error code
+ **/
+
+error_t ipcpProcessTerminateReq(PppContext *context,
+   const PppTerminatePacket *terminateReqPacket)
+{
+   //Debug message
+   TRACE_INFO("\r\nIPCP Receive-Terminate-Request event\r\n");
+
+   //The Terminate-Request indicates the desire of the peer to close the
+   //connection
+   pppRcvTerminateReqEvent(context, &context->ipcpFsm, &ipcpCallbacks,
+      terminateReqPacket);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Process Terminate-Ack packet
+ * @param[in] context PPP context
+ * @param[in] terminateAckPacket Packet received from the peer
+ * @return Error code
+ **/
+
+error_t ipcpProcessTerminateAck(PppContext *context,
+   const PppTerminatePacket *terminateAckPacket)
+{
+   //Debug message
+   TRACE_INFO("\r\nIPCP Receive-Terminate-Ack event\r\n");
+
+   //The Terminate-Ack packet is usually a response to a Terminate-Request
+   //packet
+   pppRcvTerminateAckEvent(context, &context->ipcpFsm, &ipcpCallbacks);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Process Code-Reject packet
+ * @param[in] context PPP context
+ * @param[in] codeRejPacket Packet received from the peer
+ * @return Error code
+ **/
+
+error_t ipcpProcessCodeRej(PppContext *context,
+   const PppCodeRejPacket *codeRejPacket)
+{
+   size_t length;
+   PppPacket *packet;
+
+   //Debug message
+   TRACE_INFO("\r\nIPCP Receive-Code-Reject event\r\n");
+
+   //Point to the rejected packet
+   packet = (PppPacket *) codeRejPacket->rejectedPacket;
+   //Retrieve the length of the rejected packet
+   length = ntohs(codeRejPacket->length) - sizeof(PppCodeRejPacket);
+
+   //Make sure the length of the rejected packet is valid
+   if(length < sizeof(uint8_t))
+      return ERROR_INVALID_LENGTH;
+
+   //IPCP uses the codes 1 through 7 of LCP
+   if(packet->code >= PPP_CODE_CONFIGURE_REQ &&
+      packet->code <= PPP_CODE_CODE_REJ)
+   {
+      //The rejected value is catastrophic (RXJ- event)
+      pppRcvCodeRejEvent(context, &context->ipcpFsm, &ipcpCallbacks, FALSE);
+   }
+   else
+   {
+      //The rejected value is acceptable (RXJ+ event)
+      pppRcvCodeRejEvent(context, &context->ipcpFsm, &ipcpCallbacks, TRUE);
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Process packet with unknown code
+ * @param[in] context PPP context
+ * @param[in] packet Un-interpretable packet received from the peer
+ * @return Error code
+ **/
+
+error_t ipcpProcessUnknownCode(PppContext *context,
+   const PppPacket *packet)
+{
+   //Debug message
+   TRACE_INFO("\r\nIPCP Receive-Unknown-Code event\r\n");
+
+   //This event occurs when an un-interpretable packet is received from
+   //the peer. A Code-Reject packet is sent in response
+   pppRcvUnknownCodeEvent(context, &context->ipcpFsm, &ipcpCallbacks, packet);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief This-Layer-Up callback function
+ *
+ * The address assigned to the local side is a host route. The peer is the
+ * default gateway of the link
+ *
+ * @param[in] context PPP context
+ **/
+
+void ipcpThisLayerUp(PppContext *context)
+{
+   NetInterface *interface;
+   Ipv4AddrEntry *entry;
+
+   //Debug message
+   TRACE_INFO("IPCP This-Layer-Up callback\r\n");
+
+   //Point to the underlying interface
+   interface = context->interface;
+   //Point to the IPv4 address entry of the interface
+   entry = &interface->ipv4Context.addrList[0];
+
+   //Debug message
+   TRACE_INFO("  Local IP Addr = %s\r\n", ipv4AddrToString(context->localConfig.ipAddr, NULL));
+   TRACE_INFO("  Peer IP Addr = %s\r\n", ipv4AddrToString(context->peerConfig.ipAddr, NULL));
+   TRACE_INFO("  Primary DNS = %s\r\n", ipv4AddrToString(context->localConfig.primaryDns, NULL));
+   TRACE_INFO("  Secondary DNS = %s\r\n", ipv4AddrToString(context->localConfig.secondaryDns, NULL));
+
+   //The network mutex is already held, hence the address is set directly
+   entry->addr = context->localConfig.ipAddr;
+   entry->state = IPV4_ADDR_STATE_VALID;
+   entry->conflict = FALSE;
+   entry->subnetMask = IPCP_DEFAULT_SUBNET_MASK;
+   entry->defaultGateway = context->peerConfig.ipAddr;
+
+#if (IPV4_DNS_SERVER_LIST_SIZE >= 1)
+   //Set primary DNS server
+   interface->ipv4Context.dnsServerList[0] = context->localConfig.primaryDns;
+#endif
+
+#if (IPV4_DNS_SERVER_LIST_SIZE >= 2)
+   //Set secondary DNS server
+   interface->ipv4Context.dnsServerList[1] = context->localConfig.secondaryDns;
+#endif
+
+   //The link is now available for IPv4 traffic
+   interface->linkState = TRUE;
+
+   //Disable interrupts
+   interface->nicDriver->disableIrq(interface);
+   //Process link state change event
+   nicNotifyLinkChange(interface);
+   //Re-enable interrupts
+   interface->nicDriver->enableIrq(interface);
+}
+
+
+/**
+ * @brief This-Layer-Down callback function
+ * @param[in] context PPP context
+ **/
+
+void ipcpThisLayerDown(PppContext *context)
+{
+   NetInterface *interface;
+
+   //Debug message
+   TRACE_INFO("IPCP This-Layer-Down callback\r\n");
+
+   //Point to the underlying interface
+   interface = context->interface;
+
+   //The address assigned by the peer is no longer valid
+   interface->ipv4Context.addrList[0].state = IPV4_ADDR_STATE_INVALID;
+
+   //The link is no longer available for IPv4 traffic
+   interface->linkState = FALSE;
+
+   //Disable interrupts
+   interface->nicDriver->disableIrq(interface);
+   //Process link state change event
+   nicNotifyLinkChange(interface);
+   //Re-enable interrupts
+   interface->nicDriver->enableIrq(interface);
+}
+
+
+/**
+ * @brief This-Layer-Started callback function
+ * @param[in] context PPP context
+ **/
+
+void ipcpThisLayerStarted(PppContext *context)
+{
+   //Debug message
+   TRACE_INFO("IPCP This-Layer-Started callback\r\n");
+}
+
+
+/**
+ * @brief This-Layer-Finished callback function
+ * @param[in] context PPP context
+ **/
+
+void ipcpThisLayerFinished(PppContext *context)
+{
+   //Debug message
+   TRACE_INFO("IPCP This-Layer-Finished callback\r\n");
+}
+
+
+/**
+ * @brief Initialize-Restart-Count callback function
+ * @param[in] context PPP context
+ * @param[in] value Restart counter value
+ **/
+
+void ipcpInitRestartCount(PppContext *context, uint_t value)
+{
+   //Debug message
+   TRACE_INFO("IPCP Initialize-Restart-Count callback\r\n");
+
+   //Initialize restart counter
+   context->ipcpFsm.restartCounter = value;
+}
+
+
+/**
+ * @brief Zero-Restart-Count callback function
+ * @param[in] context PPP context
+ **/
+
+void ipcpZeroRestartCount(PppContext *context)
+{
+   //Debug message
+   TRACE_INFO("IPCP Zero-Restart-Count callback\r\n");
+
+   //Zero restart counter
+   context->ipcpFsm.restartCounter = 0;
+
+   //The receiver of a Terminate-Request should wait for the peer to
+   //disconnect, and must not disconnect until at least one Restart time
+   //has passed after sending a Terminate-Ack
+   context->ipcpFsm.timestamp = osGetSystemTime();
+}
+
+
+/**
+ * @brief Send-Configure-Request callback function
+ * @param[in] context PPP context
+ * @return Error code
+ **/
+
+error_t ipcpSendConfigureReq(PppContext *context)
+{
+   error_t error;
+   size_t length;
+   size_t offset;
+   NetBuffer *buffer;
+   PppConfigurePacket *configureReqPacket;
+
+   //Debug message
+   TRACE_INFO("IPCP Send-Configure-Request callback\r\n");
+
+   //Calculate the maximum size of the Configure-Request packet
+   length = PPP_MAX_CONF_REQ_SIZE;
+
+   //Allocate a buffer memory to hold the packet
+   buffer = pppAllocBuffer(length, &offset);
+   //Failed to allocate memory?
+   if(buffer == NULL)
+      return ERROR_OUT_OF_MEMORY;
+
+   //Point to the Configure-Request packet
+   configureReqPacket = netBufferAt(buffer, offset, length);
+
+   //Valid pointer?
+   if(configureReqPacket != NULL)
+   {
+      //Format packet header
+      configureReqPacket->code = PPP_CODE_CONFIGURE_REQ;
+      configureReqPacket->identifier = ++context->ipcpFsm.identifier;
+      configureReqPacket->length = sizeof(PppConfigurePacket);
+
+      //Make sure the IP-Address option has not been previously rejected.
+      //An unspecified address asks the peer to assign one
+      if(!context->localConfig.ipAddrRejected)
+      {
+         //Add option
+         pppAddOption(configureReqPacket, IPCP_OPTION_IP_ADDRESS,
+            &context->localConfig.ipAddr, sizeof(Ipv4Addr));
+      }
+
+      //Make sure the Primary-DNS-Server-Address option has not been
+      //previously rejected
+      if(!context->localConfig.primaryDnsRejected)
+      {
+         //Add option
+         pppAddOption(configureReqPacket, IPCP_OPTION_PRIMARY_DNS,
+            &context->localConfig.primaryDns, sizeof(Ipv4Addr));
+      }
+
+      //Make sure the Secondary-DNS-Server-Address option has not been
+      //previously rejected
+      if(!context->localConfig.secondaryDnsRejected)
+      {
+         //Add option
+         pppAddOption(configureReqPacket, IPCP_OPTION_SECONDARY_DNS,
+            &context->localConfig.secondaryDns, sizeof(Ipv4Addr));
+      }
+
+      //Save packet length
+      length = configureReqPacket->length;
+      //Convert length field to network byte order
+      configureReqPacket->length = htons(length);
+
+      //Adjust the length of the multi-part buffer
+      netBufferSetLength(buffer, offset + length);
+
+      //Debug message
+      TRACE_INFO("Sending Configure-Request packet (%" PRIuSIZE " bytes)...\r\n", length);
+      //Dump packet contents for debugging purpose
+      pppDumpPacket((PppPacket *) configureReqPacket, length, PPP_PROTOCOL_IPCP);
+
+      //Send PPP frame
+      error = pppSendFrame(context->interface, buffer, offset, PPP_PROTOCOL_IPCP);
+
+      //The restart counter is decremented each time a Configure-Request
+      //is sent
+      if(context->ipcpFsm.restartCounter > 0)
+      {
+         context->ipcpFsm.restartCounter--;
+      }
+
+      //Save the time at which the packet was sent
+      context->ipcpFsm.timestamp = osGetSystemTime();
+   }
+   else
+   {
+      //Report an error
+      error = ERROR_FAILURE;
+   }
+
+   //Free previously allocated memory block
+   netBufferFree(buffer);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Send-Configure-Ack callback function
+ * @param[in] context PPP context
+ * @param[in] configureReqPacket Configure-Request packet received from the peer
+ * @return Error code
+ **/
+
+error_t ipcpSendConfigureAck(PppContext *context,
+   const PppConfigurePacket *configureReqPacket)
+{
+   //Debug message
+   TRACE_INFO("IPCP Send-Configure-Ack callback\r\n");
+
+   //The negotiation has converged
+   context->ipcpFsm.failureCounter = 0;
+
+   //Send Configure-Ack packet
+   return pppSendConfigureAckNak(context, configureReqPacket,
+      PPP_PROTOCOL_IPCP, PPP_CODE_CONFIGURE_ACK);
+}
+
+
+/**
+ * @brief Send-Configure-Nak callback function
+ * @param[in] context PPP context
+ * @param[in] configureReqPacket Configure-Request packet received from the peer
+ * @return Error code
+ **/
+
+error_t ipcpSendConfigureNak(PppContext *context,
+   const PppConfigurePacket *configureReqPacket)
+{
+   //Debug message
+   TRACE_INFO("IPCP Send-Configure-Nak callback\r\n");
+
+   //Number of Configure-Nak packets sent without an acknowledgment
+   context->ipcpFsm.failureCounter++;
+
+   //Send Configure-Nak packet
+   return pppSendConfigureAckNak(context, configureReqPacket,
+      PPP_PROTOCOL_IPCP, PPP_CODE_CONFIGURE_NAK);
+}
+
+
+/**
+ * @brief Send-Configure-Reject callback function
+ * @param[in] context PPP context
+ * @param[in] configureReqPacket Configure-Request packet received from the peer
+ * @return Error code
+ **/
+
+error_t ipcpSendConfigureRej(PppContext *context,
+   const PppConfigurePacket *configureReqPacket)
+{
+   //Debug message
+   TRACE_INFO("IPCP Send-Configure-Reject callback\r\n");
+
+   //Send Configure-Reject packet
+   return pppSendConfigureAckNak(context, configureReqPacket,
+      PPP_PROTOCOL_IPCP, PPP_CODE_CONFIGURE_REJ);
+}
+
+
+/**
+ * @brief Send-Terminate-Request callback function
+ * @param[in] context PPP context
+ * @return Error code
+ **/
+
+error_t ipcpSendTerminateReq(PppContext *context)
+{
+   error_t error;
+
+   //Debug message
+   TRACE_INFO("IPCP Send-Terminate-Request callback\r\n");
+
+   //On transmission, the Identifier field must be changed
+   context->ipcpFsm.identifier++;
+
+   //Send Terminate-Request packet
+   error = pppSendTerminateReq(context, context->ipcpFsm.identifier,
+      PPP_PROTOCOL_IPCP);
+
+   //The restart counter is decremented each time a Terminate-Request
+   //is sent
+   if(context->ipcpFsm.restartCounter > 0)
+   {
+      context->ipcpFsm.restartCounter--;
+   }
+
+   //Save the time at which the packet was sent
+   context->ipcpFsm.timestamp = osGetSystemTime();
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Send-Terminate-Ack callback function
+ * @param[in] context PPP context
+ * @param[in] terminateReqPacket Terminate-Request packet received from the
+ *   peer (NULL if the Terminate-Ack is not sent in response to a request)
+ * @return Error code
+ **/
+
+error_t ipcpSendTerminateAck(PppContext *context,
+   const PppTerminatePacket *terminateReqPacket)
+{
+   uint8_t identifier;
+
+   //Debug message
+   TRACE_INFO("IPCP Send-Terminate-Ack callback\r\n");
+
+   //Check whether this Terminate-Ack acknowledges the reception of a
+   //Terminate-Request packet
+   if(terminateReqPacket != NULL)
+   {
+      //The Identifier field of the Terminate-Request is copied into the
+      //Identifier field of the Terminate-Ack packet
+      identifier = terminateReqPacket->identifier;
+   }
+   else
+   {
+      //This Terminate-Ack packet serves to synchronize the automatons
+      identifier = ++context->ipcpFsm.identifier;
+   }
+
+   //Send Terminate-Ack packet
+   return pppSendTerminateAck(context, identifier, PPP_PROTOCOL_IPCP);
+}
+
+
+/**
+ * @brief Send-Code-Reject callback function
+ * @param[in] context PPP context
+ * @param[in] packet Un-interpretable packet received from the peer
+ * @return Error code
+ **/
+
+error_t ipcpSendCodeRej(PppContext *context, const PppPacket *packet)
+{
+   //Debug message
+   TRACE_INFO("IPCP Send-Code-Reject callback\r\n");
+
+   //Send Code-Reject packet
+   return pppSendCodeRej(context, packet, ++context->ipcpFsm.identifier,
+      PPP_PROTOCOL_IPCP);
+}
+
+
+/**
+ * @brief Parse IPCP configuration option
+ *
+ * Only the IP-Address option of the peer is accepted. The other options,
+ * including IP header compression, are rejected
+ *
+ * @param[in] context PPP context
+ * @param[in] option Option to be checked
+ * @param[in] inPacketLen Remaining bytes to process in the incoming packet
+ * @param[out] outPacket Pointer to the Configure-Ack, Nak or Reject packet
+ * @return Error code
+ **/
+
+error_t ipcpParseOption(PppContext *context, PppOption *option,
+   size_t inPacketLen, PppConfigurePacket *outPacket)
+{
+   error_t error;
+
+   //Malformed IPCP packet?
+   if(inPacketLen < sizeof(PppOption))
+      return ERROR_INVALID_LENGTH;
+
+   //Check option length
+   if(option->length < sizeof(PppOption) || option->length > inPacketLen)
+      return ERROR_INVALID_LENGTH;
+
+   //Check option type
+   switch(option->type)
+   {
+   case IPCP_OPTION_IP_ADDRESS:
+      //Check IP-Address option
+      error = ipcpParseIpAddressOption(context,
+         (IpcpIpAddressOption *) option, outPacket);
+      break;
+
+   default:
+      //Any Configure-Reject packet to build?
+      if(outPacket != NULL && outPacket->code == PPP_CODE_CONFIGURE_REJ)
+      {
+         //The option is not recognized
+         pppAddOption(outPacket, option->type, option->data,
+            option->length - sizeof(PppOption));
+      }
+
+      //Report an error
+      error = ERROR_INVALID_TYPE;
+      break;
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Parse IP-Address option
+ * @param[in] context PPP context
+ * @param[in] option Option to be checked
+ * @param[out] outPacket Pointer to the Configure-Ack, Nak or Reject packet
+ * @return Error code
+ **/
+
+error_t ipcpParseIpAddressOption(PppContext *context,
+   IpcpIpAddressOption *option, PppConfigurePacket *outPacket)
+{
+   error_t error;
+
+   //Check length field
+   if(option->length == sizeof(IpcpIpAddressOption))
+   {
+      //Any address chosen by the peer is acceptable
+      error = NO_ERROR;
+   }
+   else
+   {
+      //Invalid length field
+      error = ERROR_INVALID_LENGTH;
+   }
+
+   //Any packet to build?
+   if(outPacket != NULL)
+   {
+      //Configure-Ack packet?
+      if(outPacket->code == PPP_CODE_CONFIGURE_ACK && !error)
+      {
+         //Save the IP address of the peer
+         ipv4CopyAddr(&context->peerConfig.ipAddr, &option->ipAddr);
+
+         //The option is acknowledged
+         pppAddOption(outPacket, IPCP_OPTION_IP_ADDRESS, (void *) &option->ipAddr,
+            option->length - sizeof(PppOption));
+      }
+      //Configure-Reject packet?
+      else if(outPacket->code == PPP_CODE_CONFIGURE_REJ && error)
+      {
+         //The option cannot be accepted
+         pppAddOption(outPacket, IPCP_OPTION_IP_ADDRESS, (void *) &option->ipAddr,
+            option->length - sizeof(PppOption));
+      }
+   }
+
+   //Return status code
+   return error;
+}
+
+#endif
@@ -0,0 +1,1734 @@
+/**
+ * @file lcp.c
+ * @brief LCP (PPP Link Control Protocol)
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL PPP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "ppp/ppp_fsm.h"
+#include "ppp/ppp_misc.h"
+#include "ppp/ppp_debug.h"
+#include "ppp/lcp.h"
+#include "ppp/ipcp.h"
+#include "ppp/pap.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (PPP_SUPPORT == ENABLED)
+
+
+/**
+ * @brief LCP FSM callbacks
+ **/
+
+static const PppCallbacks lcpCallbacks =
+{
+   lcpThisLayerUp,
+   lcpThisLayerDown,
+   lcpThisLayerStarted,
+   lcpThisLayerFinished,
+   lcpInitRestartCount,
+   lcpZeroRestartCount,
+   lcpSendConfigureReq,
+   lcpSendConfigureAck,
+   lcpSendConfigureNak,
+   lcpSendConfigureRej,
+   lcpSendTerminateReq,
+   lcpSendTerminateAck,
+   lcpSendCodeRej,
+   lcpSendEchoRep
+};
+
+
+/**
+ * @brief LCP Open event
+ *
+ * The Up event is signaled right away, since the serial link is up as soon
+ * as the modem has entered data mode
+ *
+ * @param[in] context PPP context
+ * @return Error code
+ **/
+
+error_t lcpOpen(PppContext *context)
+{
+   //Debug message
+   TRACE_INFO("\r\nLCP Open event\r\n");
+
+   //Advance the LCP state machine
+   pppOpenEvent(context, &context->lcpFsm, &lcpCallbacks);
+   pppUpEvent(context, &context->lcpFsm, &lcpCallbacks);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief LCP Close event
+ * @param[in] context PPP context
+ * @return Error code
+ **/
+
+error_t lcpClose(PppContext *context)
+{
+   //Debug message
+   TRACE_INFO("\r\nLCP Close event\r\n");
+
+   //The link is no longer available for traffic
+   pppCloseEvent(context, &context->lcpFsm, &lcpCallbacks);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief LCP timer handler
+ *
+ * This routine must be periodically called by the TCP/IP stack to
+ * manage retransmissions
+ *
+ * @param[in] context PPP context
+ **/
+
+void lcpTick(PppContext *context)
+{
+   systime_t time;
+
+   //The restart timer is running in the Closing, Stopping, Req-Sent,
+   //Ack-Rcvd and Ack-Sent states
+   if(context->lcpFsm.state >= PPP_STATE_4_CLOSING &&
+      context->lcpFsm.state <= PPP_STATE_8_ACK_SENT)
+   {
+      //Get current time
+      time = osGetSystemTime();
+
+      //Check whether the restart timer has expired
+      if(timeCompare(time, context->lcpFsm.timestamp + PPP_RESTART_TIMER) >= 0)
+      {
+         //Debug message
+         TRACE_INFO("\r\nLCP Timeout event\r\n");
+
+         //The restart timer is used to retransmit Configure-Request
+         //and Terminate-Request packets
+         pppTimeoutEvent(context, &context->lcpFsm, &lcpCallbacks);
+      }
+   }
+}
+
+
+/**
+ * @brief Process an incoming LCP packet
+ * @param[in] context PPP context
+ * @param[in] packet LCP packet received from the peer
+ * @param[in] length Length of the packet, in bytes
+ **/
+
+void lcpProcessPacket(PppContext *context, const PppPacket *packet, size_t length)
+{
+   size_t n;
+
+   //Ensure the length of the incoming LCP packet is valid
+   if(length < sizeof(PppPacket))
+      return;
+
+   //Retrieve the length field
+   n = ntohs(packet->length);
+
+   //Check the length field
+   if(n < sizeof(PppPacket) || n > length)
+      return;
+
+   //Octets outside the range of the length field are treated as padding
+   length = n;
+
+   //Debug message
+   TRACE_INFO("LCP packet received (%" PRIuSIZE " bytes)...\r\n", length);
+   //Dump LCP packet contents for debugging purpose
+   pppDumpPacket(packet, length, PPP_PROTOCOL_LCP);
+
+   //Check LCP code field
+   switch(packet->code)
+   {
+   //Configure-Request packet?
+   case PPP_CODE_CONFIGURE_REQ:
+      //Process Configure-Request packet
+      lcpProcessConfigureReq(context, (PppConfigurePacket *) packet);
+      break;
+
+   //Configure-Ack packet?
+   case PPP_CODE_CONFIGURE_ACK:
+      //Process Configure-Ack packet
+      lcpProcessConfigureAck(context, (PppConfigurePacket *) packet);
+      break;
+
+   //Configure-Nak packet?
+   case PPP_CODE_CONFIGURE_NAK:
+      //Process Configure-Nak packet
+      lcpProcessConfigureNak(context, (PppConfigurePacket *) packet);
+      break;
+
+   //Configure-Reject packet?
+   case PPP_CODE_CONFIGURE_REJ:
+      //Process Configure-Reject packet
+      lcpProcessConfigureReject(context, (PppConfigurePacket *) packet);
+      break;
+
+   //Terminate-Request packet?
+   case PPP_CODE_TERMINATE_REQ:
+      //Process Terminate-Request packet
+      lcpProcessTerminateReq(context, (PppTerminatePacket *) packet);
+      break;
+
+   //Terminate-Ack packet?
+   case PPP_CODE_TERMINATE_ACK:
+      //Process Terminate-Ack packet
+      lcpProcessTerminateAck(context, (PppTerminatePacket *) packet);
+      break;
+
+   //Code-Reject packet?
+   case PPP_CODE_CODE_REJ:
+      //Check the length of the packet
+      if(length >= sizeof(PppCodeRejPacket))
+      {
+         //Process Code-Reject packet
+         lcpProcessCodeRej(context, (PppCodeRejPacket *) packet);
+      }
+      break;
+
+   //Protocol-Reject packet?
+   case PPP_CODE_PROTOCOL_REJ:
+      //Check the length of the packet
+      if(length >= sizeof(PppProtocolRejPacket))
+      {
+         //Process Protocol-Reject packet
+         lcpProcessProtocolRej(context, (PppProtocolRejPacket *) packet);
+      }
+      break;
+
+   //Echo-Request packet?
+   case PPP_CODE_ECHO_REQ:
+      //Check the length of the packet
+      if(length >= sizeof(PppEchoPacket))
+      {
+         //Process Echo-Request packet
+         lcpProcessEchoReq(context, (PppEchoPacket *) packet);
+      }
+      break;
+
+   //Echo-Reply packet?
+   case PPP_CODE_ECHO_REP:
+      //Check the length of the packet
+      if(length >= sizeof(PppEchoPacket))
+      {
+         //Process Echo-Reply packet
+         lcpProcessEchoRep(context, (PppEchoPacket *) packet);
+      }
+      break;
+
+   //Discard-Request packet?
+   case PPP_CODE_DISCARD_REQ:
+      //Check the length of the packet
+      if(length >= sizeof(PppDiscardReqPacket))
+      {
+         //Process Discard-Request packet
+         lcpProcessDiscardReq(context, (PppDiscardReqPacket *) packet);
+      }
+      break;
+
+   //Unknown code field
+   default:
+      //The packet is un-interpretable
+      lcpProcessUnknownCode(context, packet);
+      break;
+   }
+}
+
+
+/**
+ * @brief Process Configure-Request packet
+ * @param[in] context PPP context
+ * @param[in] configureReqPacket Packet received from the peer
+ * @return Error code
+ **/
+
+error_t lcpProcessConfigureReq(PppContext *context,
+   const PppConfigurePacket *configureReqPacket)
+{
+   error_t error;
+   size_t length;
+   PppCode code;
+   PppOption *option;
+
+   //Debug message
+   TRACE_INFO("\r\nLCP Receive-Configure-Request event\r\n");
+
+   //All the options are assumed to be acceptable
+   code = PPP_CODE_CONFIGURE_ACK;
+
+   //Retrieve the length of the option list
+   length = ntohs(configureReqPacket->length) - sizeof(PppConfigurePacket);
+   //Point to the first option
+   option = (PppOption *) configureReqPacket->options;
+
+   //Check the options without building any reply
+   while(length > 0)
+   {
+      //Parse current option
+      error = lcpParseOption(context, option, length, NULL);
+
+      //Unrecognized option?
+      if(error == ERROR_INVALID_TYPE)
+      {
+         //Configure-Reject takes precedence over Configure-Nak
+         code = PPP_CODE_CONFIGURE_REJ;
+      }
+      //Unacceptable value?
+      else if(error == ERROR_INVALID_VALUE)
+      {
+         //A suggested value is sent back unless options are rejected
+         if(code == PPP_CODE_CONFIGURE_ACK)
+         {
+            code = PPP_CODE_CONFIGURE_NAK;
+         }
+      }
+      //Malformed option?
+      else if(error)
+      {
+         //The packet is silently discarded
+         return error;
+      }
+
+      //Remaining bytes to process
+      length -= option->length;
+      //Jump to the next option
+      option = (PppOption *) ((uint8_t *) option + option->length);
+   }
+
+   //The negotiation does not converge?
+   if(code == PPP_CODE_CONFIGURE_NAK &&
+      context->lcpFsm.failureCounter >= PPP_MAX_FAILURE)
+   {
+      //Configure-Nak packets are converted to Configure-Reject packets
+      code = PPP_CODE_CONFIGURE_REJ;
+   }
+
+   //Advance the LCP state machine
+   pppRcvConfigureReqEvent(context, &context->lcpFsm, &lcpCallbacks,
+      configureReqPacket, code);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Process Configure-Ack packet
+ * @param[in] context PPP context
+ * @param[in] configureAckPacket Packet received from the peer
+ * @return Error code
+ **/
+
+error_t lcpProcessConfigureAck(PppContext *context,
+   const PppConfigurePacket *configureAckPacket)
+{
+   //Debug message
+   TRACE_INFO("\r\nLCP Receive-Configure-Ack event\r\n");
+
+   //When a packet is received with an invalid Identifier field, the
+   //packet is silently discarded without affecting the automaton
+   if(configureAckPacket->identifier != context->lcpFsm.identifier)
+      return ERROR_WRONG_IDENTIFIER;
+
+   //Advance the LCP state machine
+   pppRcvConfigureAckEvent(context, &context->lcpFsm, &lcpCallbacks);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Process Configure-Nak packet
+ * @param[in] context PPP context
+ * @param[in] configureNakPacket Packet received from the peer
+ * @return Error code
+ **/
+
+error_t lcpProcessConfigureNak(PppContext *context,
+   const PppConfigurePacket *configureNakPacket)
+{
+   size_t length;
+   PppOption *option;
+
+   //Debug message
+   TRACE_INFO("\r\nLCP Receive-Configure-Nak event\r\n");
+
+   //When a packet is received with an invalid Identifier field, the
+   //packet is silently discarded without affecting the automaton
+   if(configureNakPacket->identifier != context->lcpFsm.identifier)
+      return ERROR_WRONG_IDENTIFIER;
+
+   //Retrieve the length of the option list
+   length = ntohs(configureNakPacket->length) - sizeof(PppConfigurePacket);
+   //Point to the first option
+   option = (PppOption *) configureNakPacket->options;
+
+   //Parse Configure-Nak packet
+   while(length > 0)
+   {
+      //Malformed LCP packet?
+      if(length < sizeof(PppOption))
+         return ERROR_INVALID_LENGTH;
+
+      //Check option length
+      if(option->length < sizeof(PppOption) || option->length > length)
+         return ERROR_INVALID_LENGTH;
+
+      //Maximum-Receive-Unit option?
+      if(option->type == LCP_OPTION_MRU &&
+         option->length == sizeof(LcpMruOption))
+      {
+         uint16_t mru;
+
+         //Retrieve the MRU suggested by the peer
+         mru = LOAD16BE(option->data);
+
+         //The suggested value must fit in the receive buffer
+         mru = MAX(mru, PPP_MIN_MRU);
+         context->localConfig.mru = MIN(mru, PPP_MAX_MRU);
+      }
+      //Async-Control-Character-Map option?
+      else if(option->type == LCP_OPTION_ACCM &&
+         option->length == sizeof(LcpAccmOption))
+      {
+         //The peer needs the additional control characters to be escaped
+         context->localConfig.accm |= LOAD32BE(option->data);
+      }
+      //Magic-Number option?
+      else if(option->type == LCP_OPTION_MAGIC_NUMBER &&
+         option->length == sizeof(LcpMagicNumberOption))
+      {
+         //The link may be looped back. A different magic number is chosen
+         context->localConfig.magicNumber = netGenerateRand();
+      }
+      else
+      {
+         //Options that cannot be adjusted are ignored
+      }
+
+      //Remaining bytes to process
+      length -= option->length;
+      //Jump to the next option
+      option = (PppOption *) ((uint8_t *) option + option->length);
+   }
+
+   //Advance the LCP state machine
+   pppRcvConfigureNakEvent(context, &context->lcpFsm, &lcpCallbacks);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Process Configure-Reject packet
+ * @param[in] context PPP context
+ * @param[in] configureRejPacket Packet received from the peer
+ * @return Error code
+ **/
+
+error_t lcpProcessConfigureReject(PppContext *context,
+   const PppConfigurePacket *configureRejPacket)
+{
+   size_t length;
+   PppOption *option;
+
+   //Debug message
+   TRACE_INFO("\r\nLCP Receive-Configure-Reject event\r\n");
+
+   //When a packet is received with an invalid Identifier field, the
+   //packet is silently discarded without affecting the automaton
+   if(configureRejPacket->identifier != context->lcpFsm.identifier)
+      return ERROR_WRONG_IDENTIFIER;
+
+   //Retrieve the length of the option list
+   length = ntohs(configureRejPacket->length) - sizeof(PppConfigurePacket);
+   //Point to the first option
+   option = (PppOption *) configureRejPacket->options;
+
+   //Parse Configure-Reject packet
+   while(length > 0)
+   {
+      //Malformed LCP packet?
+      if(length < sizeof(PppOption))
+         return ERROR_INVALID_LENGTH;
+
+      //Check option length
+      if(option->length < sizeof(PppOption) || option->length > length)
+         return ERROR_INVALID_LENGTH;
+
+      //The rejected options are no longer sent in Configure-Request packets
+      if(option->type == LCP_OPTION_MRU)
+      {
+         //The peer uses the default MRU
+         context->localConfig.mru = PPP_DEFAULT_MRU;
+         context->localConfig.mruRejected = TRUE;
+      }
+      else if(option->type == LCP_OPTION_ACCM)
+      {
+         //The peer escapes all the control characters
+         context->localConfig.accm = PPP_DEFAULT_ACCM;
+         context->localConfig.accmRejected = TRUE;
+      }
+      else if(option->type == LCP_OPTION_AUTH_PROTOCOL)
+      {
+         //The peer refuses to authenticate itself
+         context->localConfig.authProtocol = 0;
+         context->localConfig.authProtocolRejected = TRUE;
+      }
+      else if(option->type == LCP_OPTION_MAGIC_NUMBER)
+      {
+         //Loopback detection is not available
+         context->localConfig.magicNumber = PPP_DEFAULT_MAGIC_NUMBER;
+         context->localConfig.magicNumberRejected = TRUE;
+      }
+      else if(option->type == LCP_OPTION_PFC)
+      {
+         //The Protocol field is always sent in full
+         context->localConfig.pfc = FALSE;
+         context->localConfig.pfcRejected = TRUE;
+      }
+      else if(option->type == LCP_OPTION_ACFC)
+      {
+         //The Address and Control fields are always sent
+         context->localConfig.acfc = FALSE;
+         context->localConfig.acfcRejected = TRUE;
+      }
+      else
+      {
+         //Unknown option
+      }
+
+      //Remaining bytes to process
+      length -= option->length;
+      //Jump to the next option
+      option = (PppOption *) ((uint8_t *) option + option->length);
+   }
+
+   //Advance the LCP state machine
+   pppRcvConfigureNakEvent(context, &context->lcpFsm, &lcpCallbacks);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Process Terminate-Request packet
+ * @param[in] context PPP context
+ * @param[in] terminateReqPacket Packet received from the peer
+ * @return Error code
+ **/
+
+error_t lcpProcessTerminateReq(PppContext *context,
+   const PppTerminatePacket *terminateReqPacket)
+{
+   //Debug message
+   TRACE_INFO("\r\nLCP Receive-Terminate-Request event\r\n");
+
+   //The Terminate-Request indicates the desire of the peer to close the
+   //connection
+   pppRcvTerminateReqEvent(context, &context->lcpFsm, &lcpCallbacks,
+      terminateReqPacket);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Process Terminate-Ack packet
+ * @param[in] context PPP context
+ * @param[in] terminateAckPacket Packet received from the peer
+ * @return Error code
+ **/
+
+error_t lcpProcessTerminateAck(PppContext *context,
+   const PppTerminatePacket *terminateAckPacket)
+{
+   //Debug message
+   TRACE_INFO("\r\nLCP Receive-Terminate-Ack event\r\n");
+
+   //The Terminate-Ack packet is usually a response to a Terminate-Request
+   //packet. This packet may also indicate that the peer is in Closed or
+   //Stopped states
+   pppRcvTerminateAckEvent(context, &context->lcpFsm, &lcpCallbacks);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Process Code-Reject packet
+ * @param[in] context PPP context
+ * @param[in] codeRejPacket Packet received from the peer
+ * @return Error code
+ **/
+
+error_t lcpProcessCodeRej(PppContext *context,
+   const PppCodeRejPacket *codeRejPacket)
+{
+   size_t length;
+   PppPacket *packet;
+
+   //Debug message
+   TRACE_INFO("\r\nLCP Receive-Code-Reject event\r\n");
+
+   //Point to the rejected packet
+   packet = (PppPacket *) codeRejPacket->rejectedPacket;
+   //Retrieve the length of the rejected packet
+   length = ntohs(codeRejPacket->length) - sizeof(PppCodeRejPacket);
+
+   //Make sure the length of the rejected packet is valid
+   if(length < sizeof(uint8_t))
+      return ERROR_INVALID_LENGTH;
+
+   //The codes defined by RFC 1661 are required for LCP to operate
+   if(packet->code >= PPP_CODE_CONFIGURE_REQ &&
+      packet->code <= PPP_CODE_DISCARD_REQ)
+   {
+      //The rejected value is catastrophic (RXJ- event)
+      pppRcvCodeRejEvent(context, &context->lcpFsm, &lcpCallbacks, FALSE);
+   }
+   else
+   {
+      //The rejected value is acceptable (RXJ+ event)
+      pppRcvCodeRejEvent(context, &context->lcpFsm, &lcpCallbacks, TRUE);
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Process Protocol-Reject packet
+ * @param[in] context PPP context
+ * @param[in] protocolRejPacket Packet received from the peer
+ * @return Error code
+ **/
+
+error_t lcpProcessProtocolRej(PppContext *context,
+   const PppProtocolRejPacket *protocolRejPacket)
+{
+   uint16_t protocol;
+
+   //Debug message
+   TRACE_INFO("\r\nLCP Receive-Protocol-Reject event\r\n");
+
+   //Retrieve the protocol that is not supported by the peer
+   protocol = ntohs(protocolRejPacket->rejectedProtocol);
+
+   //LCP itself cannot be rejected
+   if(protocol == PPP_PROTOCOL_LCP)
+   {
+      //The rejected value is catastrophic (RXJ- event)
+      pppRcvCodeRejEvent(context, &context->lcpFsm, &lcpCallbacks, FALSE);
+   }
+#if (IPV4_SUPPORT == ENABLED)
+   //The peer does not support IPv4?
+   else if(protocol == PPP_PROTOCOL_IP || protocol == PPP_PROTOCOL_IPCP)
+   {
+      //IPv4 cannot be carried over the link
+      context->ipRejected = TRUE;
+
+      //Stop IPCP (RXJ- event for the NCP)
+      if(context->ipcpFsm.state == PPP_STATE_9_OPENED)
+      {
+         ipcpThisLayerDown(context);
+      }
+
+      //Switch to the Stopped state
+      pppChangeState(&context->ipcpFsm, PPP_STATE_3_STOPPED);
+
+      //IPv4 is the only network protocol, hence the link is useless
+      lcpClose(context);
+   }
+#endif
+   else
+   {
+      //The rejected value is acceptable (RXJ+ event)
+      pppRcvCodeRejEvent(context, &context->lcpFsm, &lcpCallbacks, TRUE);
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Process Echo-Request packet
+ * @param[in] context PPP context
+ * @param[in] echoReqPacket Packet received from the peer
+ * @return Error code
+ **/
+
+error_t lcpProcessEchoReq(PppContext *context,
+   const PppEchoPacket *echoReqPacket)
+{
+   //Debug message
+   TRACE_INFO("\r\nLCP Receive-Echo-Request event\r\n");
+
+   //A request carrying our own magic number has been looped back
+   if(!context->localConfig.magicNumberRejected &&
+      context->localConfig.magicNumber != PPP_DEFAULT_MAGIC_NUMBER &&
+      ntohl(echoReqPacket->magicNumber) == context->localConfig.magicNumber)
+   {
+      //The packet is silently discarded
+      return ERROR_INVALID_PACKET;
+   }
+
+   //Advance the LCP state machine
+   pppRcvEchoReqEvent(context, &context->lcpFsm, &lcpCallbacks,
+      echoReqPacket);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Process Echo-Reply packet
+ * @param[in] context PPP context
+ * @param[in] echoRepPacket Packet received from the peer
+ * @return Error code
+ **/
+
+error_t lcpProcessEchoRep(PppContext *context,
+   const PppEchoPacket *echoRepPacket)
+{
+   //Debug message
+   TRACE_INFO("\r\nLCP Receive-Echo-Reply event\r\n");
+
+   //No Echo-Request is ever sent, hence the packet is discarded
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Process Discard-Request packet
+ * @param[in] context PPP context
+ * @param[in] discardReqPacket Packet received from the peer
+ * @return Error code
+ **/
+
+error_t lcpProcessDiscardReq(PppContext *context,
+   const PppDiscardReqPacket *discardReqPacket)
+{
+   //Debug message
+   TRACE_INFO("\r\nLCP Receive-Discard-Request event\r\n");
+
+   //The receiver must silently discard any Discard-Request that it receives
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Process packet with unknown code
+ * @param[in] context PPP context
+ * @param[in] packet Un-interpretable packet received from the peer
+ * @return Error code
+ **/
+
+error_t lcpProcessUnknownCode(PppContext *context,
+   const PppPacket *packet)
+{
+   //Debug message
+   TRACE_INFO("\r\nLCP Receive-Unknown-Code event\r\n");
+
+   //This event occurs when an un-interpretable packet is received from
+   //the peer. A Code-Reject packet is sent in response
+   pppRcvUnknownCodeEvent(context, &context->lcpFsm, &lcpCallbacks, packet);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Process PPP frame with unknown protocol
+ * @param[in] context PPP context
+ * @param[in] protocol Rejected protocol
+ * @param[in] information Rejected information
+ * @param[in] length Length of the rejected information
+ * @return Error code
+ **/
+
+error_t lcpProcessUnknownProtocol(PppContext *context,
+   uint16_t protocol, const uint8_t *information, size_t length)
+{
+   //Debug message
+   TRACE_INFO("\r\nLCP Receive-Unknown-Protocol event\r\n");
+
+   //Protocol-Reject packets can only be sent in the Opened state
+   if(context->lcpFsm.state != PPP_STATE_9_OPENED)
+      return ERROR_WRONG_STATE;
+
+   //Send Protocol-Reject packet
+   return pppSendProtocolRej(context, ++context->lcpFsm.identifier, protocol,
+      information, length);
+}
+
+
+/**
+ * @brief This-Layer-Up callback function
+ * @param[in] context PPP context
+ **/
+
+void lcpThisLayerUp(PppContext *context)
+{
+   //Debug message
+   TRACE_INFO("LCP This-Layer-Up callback\r\n");
+
+#if (IPV4_SUPPORT == ENABLED)
+   //The peer's MRU is the MTU of the link
+   context->interface->ipv4Context.linkMtu = context->peerConfig.mru;
+#endif
+
+   //The peer requires the local side to authenticate?
+   context->localAuthDone = (context->peerConfig.authProtocol == 0);
+   //The local side requires the peer to authenticate?
+   context->peerAuthDone = (context->localConfig.authProtocol == 0);
+
+#if (PAP_SUPPORT == ENABLED)
+   //Authentication is required by either side?
+   if(!context->localAuthDone || !context->peerAuthDone)
+   {
+      //Advance to the authentication phase
+      context->pppPhase = PPP_PHASE_AUTHENTICATE;
+
+      //Start PAP authentication process
+      papStartAuth(context);
+   }
+   else
+#endif
+   {
+      //Advance to the network-layer protocol phase
+      context->pppPhase = PPP_PHASE_NETWORK;
+
+#if (IPV4_SUPPORT == ENABLED)
+      //Open IPCP
+      ipcpOpen(context);
+#endif
+   }
+}
+
+
+/**
+ * @brief This-Layer-Down callback function
+ * @param[in] context PPP context
+ **/
+
+void lcpThisLayerDown(PppContext *context)
+{
+   //Debug message
+   TRACE_INFO("LCP This-Layer-Down callback\r\n");
+
+   //Advance to the link termination phase
+   context->pppPhase = PPP_PHASE_TERMINATE;
+
+#if (IPV4_SUPPORT == ENABLED)
+   //The network layer goes down along with the link
+   if(context->ipcpFsm.state == PPP_STATE_9_OPENED)
+   {
+      ipcpThisLayerDown(context);
+   }
+
+   //NCP packets cannot be exchanged until LCP is opened again
+   pppChangeState(&context->ipcpFsm, PPP_STATE_0_INITIAL);
+#endif
+
+#if (PAP_SUPPORT == ENABLED)
+   //Abort PAP authentication process
+   papAbortAuth(context);
+#endif
+}
+
+
+/**
+ * @brief This-Layer-Started callback function
+ * @param[in] context PPP context
+ **/
+
+void lcpThisLayerStarted(PppContext *context)
+{
+   //Debug message
+   TRACE_INFO("LCP This-Layer-Started callback\r\n");
+}
+
+
+/**
+ * @brief This-Layer-Finished callback function
+ * @param[in] context PPP context
+ **/
+
+void lcpThisLayerFinished(PppContext *context)
+{
+   //Debug message
+   TRACE_INFO("LCP This-Layer-Finished callback\r\n");
+
+   //The link is no longer available for traffic
+   context->pppPhase = PPP_PHASE_DEAD;
+
+#if (IPV4_SUPPORT == ENABLED)
+   //Reset IPCP finite state machine
+   context->ipcpFsm.state = PPP_STATE_0_INITIAL;
+#endif
+}
+
+
+/**
+ * @brief Initialize-Restart-Count callback function
+ * @param[in] context PPP context
+ * @param[in] value Restart counter value
+ **/
+
+void lcpInitRestartCount(PppContext *context, uint_t value)
+{
+   //Debug message
+   TRACE_INFO("LCP Initialize-Restart-Count callback\r\n");
+
+   //Initialize restart counter
+   context->lcpFsm.restartCounter = value;
+}
+
+
+/**
+ * @brief Zero-Restart-Count callback function
+ * @param[in] context PPP context
+ **/
+
+void lcpZeroRestartCount(PppContext *context)
+{
+   //Debug message
+   TRACE_INFO("LCP Zero-Restart-Count callback\r\n");
+
+   //Zero restart counter
+   context->lcpFsm.restartCounter = 0;
+
+   //The receiver of a Terminate-Request should wait for the peer to
+   //disconnect, and must not disconnect until at least one Restart time
+   //has passed after sending a Terminate-Ack
+   context->lcpFsm.timestamp = osGetSystemTime();
+}
+
+
+/**
+ * @brief Send-Configure-Request callback function
+ * @param[in] context PPP context
+ * @return Error code
+ **/
+
+error_t lcpSendConfigureReq(PppContext *context)
+{
+   error_t error;
+   size_t length;
+   size_t offset;
+   NetBuffer *buffer;
+   PppConfigurePacket *configureReqPacket;
+
+   //Debug message
+   TRACE_INFO("LCP Send-Configure-Request callback\r\n");
+
+   //Calculate the maximum size of the Configure-Request packet
+   length = PPP_MAX_CONF_REQ_SIZE;
+
+   //Allocate a buffer memory to hold the packet
+   buffer = pppAllocBuffer(length, &offset);
+   //Failed to allocate memory?
+   if(buffer == NULL)
+      return ERROR_OUT_OF_MEMORY;
+
+   //Point to the Configure-Request packet
+   configureReqPacket = netBufferAt(buffer, offset, length);
+
+   //Valid pointer?
+   if(configureReqPacket != NULL)
+   {
+      //Format packet header
+      configureReqPacket->code = PPP_CODE_CONFIGURE_REQ;
+      configureReqPacket->identifier = ++context->lcpFsm.identifier;
+      configureReqPacket->length = sizeof(PppConfigurePacket);
+
+      //Make sure the Maximum-Receive-Unit option has not been previously
+      //rejected. The default value does not need to be negotiated
+      if(!context->localConfig.mruRejected &&
+         context->localConfig.mru != PPP_DEFAULT_MRU)
+      {
+         //Convert MRU to network byte order
+         uint16_t value = htons(context->localConfig.mru);
+         //Add option
+         pppAddOption(configureReqPacket, LCP_OPTION_MRU, &value, sizeof(uint16_t));
+      }
+
+      //Make sure the Async-Control-Character-Map option has not been
+      //previously rejected
+      if(!context->localConfig.accmRejected &&
+         context->localConfig.accm != PPP_DEFAULT_ACCM)
+      {
+         //Convert ACCM to network byte order
+         uint32_t value = htonl(context->localConfig.accm);
+         //Add option
+         pppAddOption(configureReqPacket, LCP_OPTION_ACCM, &value, sizeof(uint32_t));
+      }
+
+      //Make sure the Authentication-Protocol option has not been previously
+      //rejected
+      if(!context->localConfig.authProtocolRejected &&
+         context->localConfig.authProtocol == PPP_PROTOCOL_PAP)
+      {
+         //Format Authentication-Protocol option
+         uint16_t value = HTONS(PPP_PROTOCOL_PAP);
+         //Add option
+         pppAddOption(configureReqPacket, LCP_OPTION_AUTH_PROTOCOL, &value,
+            sizeof(uint16_t));
+      }
+
+      //Make sure the Magic-Number option has not been previously rejected
+      if(!context->localConfig.magicNumberRejected)
+      {
+         //Convert magic number to network byte order
+         uint32_t value = htonl(context->localConfig.magicNumber);
+         //Add option
+         pppAddOption(configureReqPacket, LCP_OPTION_MAGIC_NUMBER, &value,
+            sizeof(uint32_t));
+      }
+
+      //Make sure the Protocol-Field-Compression option has not been
+      //previously rejected
+      if(!context->localConfig.pfcRejected && context->localConfig.pfc)
+      {
+         //Add option
+         pppAddOption(configureReqPacket, LCP_OPTION_PFC, NULL, 0);
+      }
+
+      //Make sure the Address-and-Control-Field-Compression option has not
+      //been previously rejected
+      if(!context->localConfig.acfcRejected && context->localConfig.acfc)
+      {
+         //Add option
+         pppAddOption(configureReqPacket, LCP_OPTION_ACFC, NULL, 0);
+      }
+
+      //Save packet length
+      length = configureReqPacket->length;
+      //Convert length field to network byte order
+      configureReqPacket->length = htons(length);
+
+      //Adjust the length of the multi-part buffer
+      netBufferSetLength(buffer, offset + length);
+
+      //Debug message
+      TRACE_INFO("Sending Configure-Request packet (%" PRIuSIZE " bytes)...\r\n", length);
+      //Dump packet contents for debugging purpose
+      pppDumpPacket((PppPacket *) configureReqPacket, length, PPP_PROTOCOL_LCP);
+
+      //Send PPP frame
+      error = pppSendFrame(context->interface, buffer, offset, PPP_PROTOCOL_LCP);
+
+      //The restart counter is decremented each time a Configure-Request
+      //is sent
+      if(context->lcpFsm.restartCounter > 0)
+      {
+         context->lcpFsm.restartCounter--;
+      }
+
+      //Save the time at which the packet was sent
+      context->lcpFsm.timestamp = osGetSystemTime();
+   }
+   else
+   {
+      //Report an error
+      error = ERROR_FAILURE;
+   }
+
+   //Free previously allocated memory block
+   netBufferFree(buffer);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Send-Configure-Ack callback function
+ * @param[in] context PPP context
+ * @param[in] configureReqPacket Configure-Request packet received from the peer
+ * @return Error code
+ **/
+
+error_t lcpSendConfigureAck(PppContext *context,
+   const PppConfigurePacket *configureReqPacket)
+{
+   //Debug message
+   TRACE_INFO("LCP Send-Configure-Ack callback\r\n");
+
+   //The options that are not part of the request take their default value
+   context->peerConfig.mru = PPP_DEFAULT_MRU;
+   context->peerConfig.accm = PPP_DEFAULT_ACCM;
+   context->peerConfig.authProtocol = 0;
+   context->peerConfig.magicNumber = PPP_DEFAULT_MAGIC_NUMBER;
+   context->peerConfig.pfc = FALSE;
+   context->peerConfig.acfc = FALSE;
+
+   //The negotiation has converged
+   context->lcpFsm.failureCounter = 0;
+
+   //Send Configure-Ack packet. The acknowledged options are applied while
+   //the reply is being built
+   return pppSendConfigureAckNak(context, configureReqPacket,
+      PPP_PROTOCOL_LCP, PPP_CODE_CONFIGURE_ACK);
+}
+
+
+/**
+ * @brief Send-Configure-Nak callback function
+ * @param[in] context PPP context
+ * @param[in] configureReqPacket Configure-Request packet received from the peer
+ * @return Error code
+ **/
+
+error_t lcpSendConfigureNak(PppContext *context,
+   const PppConfigurePacket *configureReqPacket)
+{
+   //Debug message
+   TRACE_INFO("LCP Send-Configure-Nak callback\r\n");
+
+   //Number of Configure-Nak packets sent without an acknowledgment
+   context->lcpFsm.failureCounter++;
+
+   //Send Configure-Nak packet
+   return pppSendConfigureAckNak(context, configureReqPacket,
+      PPP_PROTOCOL_LCP, PPP_CODE_CONFIGURE_NAK);
+}
+
+
+/**
+ * @brief Send-Configure-Reject callback function
+ * @param[in] context PPP context
+ * @param[in] configureReqPacket Configure-Request packet received from the peer
+ * @return Error code
+ **/
+
+error_t lcpSendConfigureRej(PppContext *context,
+   const PppConfigurePacket *configureReqPacket)
+{
+   //Debug message
+   TRACE_INFO("LCP Send-Configure-Reject callback\r\n");
+
+   //Send Configure-Reject packet
+   return pppSendConfigureAckNak(context, configureReqPacket,
+      PPP_PROTOCOL_LCP, PPP_CODE_CONFIGURE_REJ);
+}
+
+
+/**
+ * @brief Send-Terminate-Request callback function
+ * @param[in] context PPP context
+ * @return Error code
+ **/
+
+error_t lcpSendTerminateReq(PppContext *context)
+{
+   error_t error;
+
+   //Debug message
+   TRACE_INFO("LCP Send-Terminate-Request callback\r\n");
+
+   //On transmission, the Identifier field must be changed
+   context->lcpFsm.identifier++;
+
+   //Send Terminate-Request packet
+   error = pppSendTerminateReq(context, context->lcpFsm.identifier,
+      PPP_PROTOCOL_LCP);
+
+   //The restart counter is decremented each time a Terminate-Request
+   //is sent
+   if(context->lcpFsm.restartCounter > 0)
+   {
+      context->lcpFsm.restartCounter--;
+   }
+
+   //Save the time at which the packet was sent
+   context->lcpFsm.timestamp = osGetSystemTime();
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Send-Terminate-Ack callback function
+ * @param[in] context PPP context
+ * @param[in] terminateReqPacket Terminate-Request packet received from the
+ *   peer (NULL if the Terminate-Ack is not sent in response to a request)
+ * @return Error code
+ **/
+
+error_t lcpSendTerminateAck(PppContext *context,
+   const PppTerminatePacket *terminateReqPacket)
+{
+   uint8_t identifier;
+
+   //Debug message
+   TRACE_INFO("LCP Send-Terminate-Ack callback\r\n");
+
+   //Check whether this Terminate-Ack acknowledges the reception of a
+   //Terminate-Request packet
+   if(terminateReqPacket != NULL)
+   {
+      //The Identifier field of the Terminate-Request is copied into the
+      //Identifier field of the Terminate-Ack packet
+      identifier = terminateReqPacket->identifier;
+   }
+   else
+   {
+      //This Terminate-Ack packet serves to synchronize the automatons
+      identifier = ++context->lcpFsm.identifier;
+   }
+
+   //Send Terminate-Ack packet
+   return pppSendTerminateAck(context, identifier, PPP_PROTOCOL_LCP);
+}
+
+
+/**
+ * @brief Send-Code-Reject callback function
+ * @param[in] context PPP context
+ * @param[in] packet Un-interpretable packet received from the peer
+ * @return Error code
+ **/
+
+error_t lcpSendCodeRej(PppContext *context, const PppPacket *packet)
+{
+   //Debug message
+   TRACE_INFO("LCP Send-Code-Reject callback\r\n");
+
+   //Send Code-Reject packet
+   return pppSendCodeRej(context, packet, ++context->lcpFsm.identifier,
+      PPP_PROTOCOL_LCP);
+}
+
+
+/**
+ * @brief Send-Echo-Reply callback function
+ * @param[in] context PPP context
+ * @param[in] echoReqPacket Echo-Request packet received from the peer
+ * @return Error code
+ **/
+
+error_t lcpSendEchoRep(PppContext *context, const PppEchoPacket *echoReqPacket)
+{
+   //Debug message
+   TRACE_INFO("LCP Send-Echo-Reply callback\r\n");
+
+   //Send Echo-Reply packet
+   return pppSendEchoRep(context, echoReqPacket, PPP_PROTOCOL_LCP);
+}
+
+
+/**
+ * @brief Parse LCP configuration option
+ *
+ * When no output packet is specified, the option is only checked. Otherwise
+ * the option is appended to the reply when it matches the type of the
+ * reply: acknowledged options (Configure-Ack, in which case the option is
+ * also applied), negotiable options with a suggested value (Configure-Nak)
+ * or options that cannot be accepted (Configure-Reject)
+ *
+ * @param[in] context PPP context
+ * @param[in] option Option to be checked
+ * @param[in] inPacketLen Remaining bytes to process in the incoming packet
+ * @param[out] outPacket Pointer to the Configure-Ack, Nak or Reject packet
+ * @return Error code
+ **/
+
+error_t lcpParseOption(PppContext *context, PppOption *option,
+   size_t inPacketLen, PppConfigurePacket *outPacket)
+{
+   error_t error;
+
+   //Malformed LCP packet?
+   if(inPacketLen < sizeof(PppOption))
+      return ERROR_INVALID_LENGTH;
+
+   //Check option length
+   if(option->length < sizeof(PppOption) || option->length > inPacketLen)
+      return ERROR_INVALID_LENGTH;
+
+   //Check option type
+   switch(option->type)
+   {
+   case LCP_OPTION_MRU:
+      //Check Maximum-Receive-Unit option
+      error = lcpParseMruOption(context, (LcpMruOption *) option, outPacket);
+      break;
+
+   case LCP_OPTION_ACCM:
+      //Check Async-Control-Character-Map option
+      error = lcpParseAccmOption(context, (LcpAccmOption *) option, outPacket);
+      break;
+
+   case LCP_OPTION_AUTH_PROTOCOL:
+      //Check Authentication-Protocol option
+      error = lcpParseAuthProtocolOption(context,
+         (LcpAuthProtocolOption *) option, outPacket);
+      break;
+
+   case LCP_OPTION_MAGIC_NUMBER:
+      //Check Magic-Number option
+      error = lcpParseMagicNumberOption(context,
+         (LcpMagicNumberOption *) option, outPacket);
+      break;
+
+   case LCP_OPTION_PFC:
+      //Check Protocol-Field-Compression option
+      error = lcpParsePfcOption(context, (LcpPfcOption *) option, outPacket);
+      break;
+
+   case LCP_OPTION_ACFC:
+      //Check Address-and-Control-Field-Compression option
+      error = lcpParseAcfcOption(context, (LcpAcfcOption *) option, outPacket);
+      break;
+
+   default:
+      //Any Configure-Reject packet to build?
+      if(outPacket != NULL && outPacket->code == PPP_CODE_CONFIGURE_REJ)
+      {
+         //The option is not recognized
+         pppAddOption(outPacket, option->type, option->data,
+            option->length - sizeof(PppOption));
+      }
+
+      //Report an error
+      error = ERROR_INVALID_TYPE;
+      break;
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Parse Maximum-Receive-Unit option
+ * @param[in] context PPP context
+ * @param[in] option Option to be checked
+ * @param[out] outPacket Pointer to the Configure-Ack, Nak or Reject packet
+ * @return Error code
+ **/
+
+error_t lcpParseMruOption(PppContext *context,
+   LcpMruOption *option, PppConfigurePacket *outPacket)
+{
+   error_t error;
+   uint16_t value;
+
+   //Check length field
+   if(option->length == sizeof(LcpMruOption))
+   {
+      //Check whether the maximum receive unit is acceptable
+      if(ntohs(option->mru) >= PPP_MIN_MRU)
+      {
+         //The value is acceptable
+         error = NO_ERROR;
+      }
+      else
+      {
+         //The value is not acceptable
+         error = ERROR_INVALID_VALUE;
+      }
+   }
+   else
+   {
+      //Invalid length field
+      error = ERROR_INVALID_LENGTH;
+   }
+
+   //Any packet to build?
+   if(outPacket != NULL)
+   {
+      //Configure-Ack packet?
+      if(outPacket->code == PPP_CODE_CONFIGURE_ACK && !error)
+      {
+         //Frames sent to the peer never exceed the size of the local buffers
+         value = ntohs(option->mru);
+         context->peerConfig.mru = MIN(value, PPP_MAX_MRU);
+
+         //The option is acknowledged
+         pppAddOption(outPacket, LCP_OPTION_MRU, (void *) &option->mru,
+            option->length - sizeof(PppOption));
+      }
+      //Configure-Nak packet?
+      else if(outPacket->code == PPP_CODE_CONFIGURE_NAK &&
+         error == ERROR_INVALID_VALUE)
+      {
+         //Suggest the smallest acceptable value
+         value = HTONS(PPP_MIN_MRU);
+         pppAddOption(outPacket, LCP_OPTION_MRU, &value, sizeof(uint16_t));
+      }
+      //Configure-Reject packet?
+      else if(outPacket->code == PPP_CODE_CONFIGURE_REJ && error)
+      {
+         //The option cannot be accepted
+         pppAddOption(outPacket, LCP_OPTION_MRU, (void *) &option->mru,
+            option->length - sizeof(PppOption));
+      }
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Parse Async-Control-Character-Map option
+ * @param[in] context PPP context
+ * @param[in] option Option to be checked
+ * @param[out] outPacket Pointer to the Configure-Ack, Nak or Reject packet
+ * @return Error code
+ **/
+
+error_t lcpParseAccmOption(PppContext *context,
+   LcpAccmOption *option, PppConfigurePacket *outPacket)
+{
+   error_t error;
+
+   //Check length field
+   if(option->length == sizeof(LcpAccmOption))
+   {
+      //Any control character map is acceptable
+      error = NO_ERROR;
+   }
+   else
+   {
+      //Invalid length field
+      error = ERROR_INVALID_LENGTH;
+   }
+
+   //Any packet to build?
+   if(outPacket != NULL)
+   {
+      //Configure-Ack packet?
+      if(outPacket->code == PPP_CODE_CONFIGURE_ACK && !error)
+      {
+         //The control characters the peer does not wish to receive are
+         //escaped on transmission
+         context->peerConfig.accm = ntohl(option->accm);
+
+         //The option is acknowledged
+         pppAddOption(outPacket, LCP_OPTION_ACCM, (void *) &option->accm,
+            option->length - sizeof(PppOption));
+      }
+      //Configure-Reject packet?
+      else if(outPacket->code == PPP_CODE_CONFIGURE_REJ && error)
+      {
+         //The option cannot be accepted
+         pppAddOption(outPacket, LCP_OPTION_ACCM, (void *) &option->accm,
+            option->length - sizeof(PppOption));
+      }
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Parse Authentication-Protocol option
+ * @param[in] context PPP context
+ * @param[in] option Option to be checked
+ * @param[out] outPacket Pointer to the Configure-Ack, Nak or Reject packet
+ * @return Error code
+ **/
+
+error_t lcpParseAuthProtocolOption(PppContext *context,
+   LcpAuthProtocolOption *option, PppConfigurePacket *outPacket)
+{
+   error_t error;
+   bool_t papAllowed;
+
+#if (PAP_SUPPORT == ENABLED)
+   //The local side may authenticate itself with PAP
+   papAllowed = (context->settings.authProtocol & PPP_AUTH_PROTOCOL_PAP) != 0;
+#else
+   //PAP is not supported
+   papAllowed = FALSE;
+#endif
+
+   //Check length field
+   if(option->length >= sizeof(LcpAuthProtocolOption))
+   {
+      //PAP authentication protocol?
+      if(papAllowed && option->length == sizeof(LcpAuthProtocolOption) &&
+         ntohs(option->protocol) == PPP_PROTOCOL_PAP)
+      {
+         //The value is acceptable
+         error = NO_ERROR;
+      }
+      else if(papAllowed)
+      {
+         //PAP is suggested in place of the requested protocol
+         error = ERROR_INVALID_VALUE;
+      }
+      else
+      {
+         //The peer cannot be satisfied
+         error = ERROR_INVALID_TYPE;
+      }
+   }
+   else
+   {
+      //Invalid length field
+      error = ERROR_INVALID_LENGTH;
+   }
+
+   //Any packet to build?
+   if(outPacket != NULL)
+   {
+      //Configure-Ack packet?
+      if(outPacket->code == PPP_CODE_CONFIGURE_ACK && !error)
+      {
+         //The local side authenticates itself with PAP
+         context->peerConfig.authProtocol = PPP_PROTOCOL_PAP;
+
+         //The option is acknowledged
+         pppAddOption(outPacket, LCP_OPTION_AUTH_PROTOCOL,
+            (void *) &option->protocol, option->length - sizeof(PppOption));
+      }
+      //Configure-Nak packet?
+      else if(outPacket->code == PPP_CODE_CONFIGURE_NAK &&
+         error == ERROR_INVALID_VALUE)
+      {
+         //Suggest PAP authentication protocol
+         uint16_t value = HTONS(PPP_PROTOCOL_PAP);
+         pppAddOption(outPacket, LCP_OPTION_AUTH_PROTOCOL, &value,
+            sizeof(uint16_t));
+      }
+      //Configure-Reject packet?
+      else if(outPacket->code == PPP_CODE_CONFIGURE_REJ && error)
+      {
+         //The option cannot be accepted
+         pppAddOption(outPacket, LCP_OPTION_AUTH_PROTOCOL,
+            (void *) &option->protocol, option->length - sizeof(PppOption));
+      }
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Parse Magic-Number option
+ * @param[in] context PPP context
+ * @param[in] option Option to be checked
+ * @param[out] outPacket Pointer to the Configure-Ack, Nak or Reject packet
+ * @return Error code
+ **/
+
+error_t lcpParseMagicNumberOption(PppContext *context,
+   LcpMagicNumberOption *option, PppConfigurePacket *outPacket)
+{
+   error_t error;
+
+   //Check length field
+   if(option->length == sizeof(LcpMagicNumberOption))
+   {
+      //A magic number identical to the local one reveals a looped-back link
+      if(!context->localConfig.magicNumberRejected &&
+         ntohl(option->magicNumber) == context->localConfig.magicNumber)
+      {
+         //A different value is suggested
+         error = ERROR_INVALID_VALUE;
+      }
+      else
+      {
+         //The value is acceptable
+         error = NO_ERROR;
+      }
+   }
+   else
+   {
+      //Invalid length field
+      error = ERROR_INVALID_LENGTH;
+   }
+
+   //Any packet to build?
+   if(outPacket != NULL)
+   {
+      //Configure-Ack packet?
+      if(outPacket->code == PPP_CODE_CONFIGURE_ACK && !error)
+      {
+         //Save the magic number chosen by the peer
+         context->peerConfig.magicNumber = ntohl(option->magicNumber);
+
+         //The option is acknowledged
+         pppAddOption(outPacket, LCP_OPTION_MAGIC_NUMBER,
+            (void *) &option->magicNumber, option->length - sizeof(PppOption));
+      }
+      //Configure-Nak packet?
+      else if(outPacket->code == PPP_CODE_CONFIGURE_NAK &&
+         error == ERROR_INVALID_VALUE)
+      {
+         //Suggest a random value
+         uint32_t value = htonl(netGenerateRand());
+         pppAddOption(outPacket, LCP_OPTION_MAGIC_NUMBER, &value,
+            sizeof(uint32_t));
+      }
+      //Configure-Reject packet?
+      else if(outPacket->code == PPP_CODE_CONFIGURE_REJ && error)
+      {
+         //The option cannot be accepted
+         pppAddOption(outPacket, LCP_OPTION_MAGIC_NUMBER,
+            (void *) &option->magicNumber, option->length - sizeof(PppOption));
+      }
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Parse Protocol-Field-Compression option
+ * @param[in] context PPP context
+ * @param[in] option Option to be checked
+ * @param[out] outPacket Pointer to the Configure-Ack, Nak or Reject packet
+ * @return Error code
+ **/
+
+error_t lcpParsePfcOption(PppContext *context,
+   LcpPfcOption *option, PppConfigurePacket *outPacket)
+{
+   error_t error;
+
+   //Check length field
+   if(option->length == sizeof(LcpPfcOption))
+   {
+      //Compressed Protocol fields are always accepted on reception
+      error = NO_ERROR;
+   }
+   else
+   {
+      //Invalid length field
+      error = ERROR_INVALID_LENGTH;
+   }
+
+   //Any packet to build?
+   if(outPacket != NULL)
+   {
+      //Configure-Ack packet?
+      if(outPacket->code == PPP_CODE_CONFIGURE_ACK && !error)
+      {
+         //The Protocol field may be compressed on transmission
+         context->peerConfig.pfc = TRUE;
+
+         //The option is acknowledged
+         pppAddOption(outPacket, LCP_OPTION_PFC, NULL, 0);
+      }
+      //Configure-Reject packet?
+      else if(outPacket->code == PPP_CODE_CONFIGURE_REJ && error)
+      {
+         //The option cannot be accepted
+         pppAddOption(outPacket, LCP_OPTION_PFC, NULL, 0);
+      }
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Parse Address-and-Control-Field-Compression option
+ * @param[in] context PPP context
+ * @param[in] option Option to be checked
+ * @param[out] outPacket Pointer to the Configure-Ack, Nak or Reject packet
+ * @return Error code
+ **/
+
+error_t lcpParseAcfcOption(PppContext *context,
+   LcpAcfcOption *option, PppConfigurePacket *outPacket)
+{
+   error_t error;
+
+   //Check length field
+   if(option->length == sizeof(LcpAcfcOption))
+   {
+      //Compressed Address and Control fields are always accepted on
+      //reception
+      error = NO_ERROR;
+   }
+   else
+   {
+      //Invalid length field
+      error = ERROR_INVALID_LENGTH;
+   }
+
+   //Any packet to build?
+   if(outPacket != NULL)
+   {
+      //Configure-Ack packet?
+      if(outPacket->code == PPP_CODE_CONFIGURE_ACK && !error)
+      {
+         //The Address and Control fields may be omitted on transmission
+         context->peerConfig.acfc = TRUE;
+
+         //The option is acknowledged
+         pppAddOption(outPacket, LCP_OPTION_ACFC, NULL, 0);
+      }
+      //Configure-Reject packet?
+      else if(outPacket->code == PPP_CODE_CONFIGURE_REJ && error)
+      {
+         //The option cannot be accepted
+         pppAddOption(outPacket, LCP_OPTION_ACFC, NULL, 0);
+      }
+   }
+
+   //Return status code
+   return error;
+}
+
+#endif
@@ -0,0 +1,1157 @@
+/**
+ * @file ppp.c
+ * @brief PPP (Point-to-Point Protocol)
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * The Point-to-Point Protocol (PPP) provides a standard method for
+ * transporting multi-protocol datagrams over point-to-point links. Refer
+ * to RFC 1661 and RFC 1662 for more details
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL PPP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "ppp/ppp.h"
+#include "ppp/ppp_hdlc.h"
+#include "ppp/ppp_debug.h"
+#include "ppp/lcp.h"
+#include "ppp/ipcp.h"
+#include "ppp/pap.h"
+#include "str.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (PPP_SUPPORT == ENABLED)
+
+//Residue of the FCS computed over a frame and its own FCS field
+#define PPP_GOOD_FCS 0xF0B8
+
+//Tick counter to handle periodic operations
+systime_t pppTickCounter;
+
+//FCS lookup tables (slicing-by-4). Table k gives the contribution of a
+//byte followed by k other bytes, so that four bytes are folded into the
+//running FCS with a single 32-bit load
+static const uint16_t fcsTable[4][256] =
+{
+   {
+      0x0000, 0x1189, 0x2312, 0x329B, 0x4624, 0x57AD, 0x6536, 0x74BF,
+      0x8C48, 0x9DC1, 0xAF5A, 0xBED3, 0xCA6C, 0xDBE5, 0xE97E, 0xF8F7,
+      0x1081, 0x0108, 0x3393, 0x221A, 0x56A5, 0x472C, 0x75B7, 0x643E,
+      0x9CC9, 0x8D40, 0xBFDB, 0xAE52, 0xDAED, 0xCB64, 0xF9FF, 0xE876,
+      0x2102, 0x308B, 0x0210, 0x1399, 0x6726, 0x76AF, 0x4434, 0x55BD,
+      0xAD4A, 0xBCC3, 0x8E58, 0x9FD1, 0xEB6E, 0xFAE7, 0xC87C, 0xD9F5,
+      0x3183, 0x200A, 0x1291, 0x0318, 0x77A7, 0x662E, 0x54B5, 0x453C,
+      0xBDCB, 0xAC42, 0x9ED9, 0x8F50, 0xFBEF, 0xEA66, 0xD8FD, 0xC974,
+      0x4204, 0x538D, 0x6116, 0x709F, 0x0420, 0x15A9, 0x2732, 0x36BB,
+      0xCE4C, 0xDFC5, 0xED5E, 0xFCD7, 0x8868, 0x99E1, 0xAB7A, 0xBAF3,
+      0x5285, 0x430C, 0x7197, 0x601E, 0x14A1, 0x0528, 0x37B3, 0x263A,
+      0xDECD, 0xCF44, 0xFDDF, 0xEC56, 0x98E9, 0x8960, 0xBBFB, 0xAA72,
+      0x6306, 0x728F, 0x4014, 0x519D, 0x2522, 0x34AB, 0x0630, 0x17B9,
+      0xEF4E, 0xFEC7, 0xCC5C, 0xDDD5, 0xA96A, 0xB8E3, 0x8A78, 0x9BF1,
+      0x7387, 0x620E, 0x5095, 0x411C, 0x35A3, 0x242A, 0x16B1, 0x0738,
+      0xFFCF, 0xEE46, 0xDCDD, 0xCD54, 0xB9EB, 0xA862, 0x9AF9, 0x8B70,
+      0x8408, 0x9581, 0xA71A, 0xB693, 0xC22C, 0xD3A5, 0xE13E, 0xF0B7,
+      0x0840, 0x19C9, 0x2B52, 0x3ADB, 0x4E64, 0x5FED, 0x6D76, 0x7CFF,
+      0x9489, 0x8500, 0xB79B, 0xA612, 0xD2AD, 0xC324, 0xF1BF, 0xE036,
+      0x18C1, 0x0948, 0x3BD3, 0x2A5A, 0x5EE5, 0x4F6C, 0x7DF7, 0x6C7E,
+      0xA50A, 0xB483, 0x8618, 0x9791, 0xE32E, 0xF2A7, 0xC03C, 0xD1B5,
+      0x2942, 0x38CB, 0x0A50, 0x1BD9, 0x6F66, 0x7EEF, 0x4C74, 0x5DFD,
+      0xB58B, 0xA402, 0x9699, 0x8710, 0xF3AF, 0xE226, 0xD0BD, 0xC134,
+      0x39C3, 0x284A, 0x1AD1, 0x0B58, 0x7FE7, 0x6E6E, 0x5CF5, 0x4D7C,
+      0xC60C, 0xD785, 0xE51E, 0xF497, 0x8028, 0x91A1, 0xA33A, 0xB2B3,
+      0x4A44, 0x5BCD, 0x6956, 0x78DF, 0x0C60, 0x1DE9, 0x2F72, 0x3EFB,
+      0xD68D, 0xC704, 0xF59F, 0xE416, 0x90A9, 0x8120, 0xB3BB, 0xA232,
+      0x5AC5, 0x4B4C, 0x79D7, 0x685E, 0x1CE1, 0x0D68, 0x3FF3, 0x2E7A,
+      0xE70E, 0xF687, 0xC41C, 0xD595, 0xA12A, 0xB0A3, 0x8238, 0x93B1,
+      0x6B46, 0x7ACF, 0x4854, 0x59DD, 0x2D62, 0x3CEB, 0x0E70, 0x1FF9,
+      0xF78F, 0xE606, 0xD49D, 0xC514, 0xB1AB, 0xA022, 0x92B9, 0x8330,
+      0x7BC7, 0x6A4E, 0x58D5, 0x495C, 0x3DE3, 0x2C6A, 0x1EF1, 0x0F78
+   },
+   {
+      0x0000, 0x19D8, 0x33B0, 0x2A68, 0x6760, 0x7EB8, 0x54D0, 0x4D08,
+      0xCEC0, 0xD718, 0xFD70, 0xE4A8, 0xA9A0, 0xB078, 0x9A10, 0x83C8,
+      0x9591, 0x8C49, 0xA621, 0xBFF9, 0xF2F1, 0xEB29, 0xC141, 0xD899,
+      0x5B51, 0x4289, 0x68E1, 0x7139, 0x3C31, 0x25E9, 0x0F81, 0x1659,
+      0x2333, 0x3AEB, 0x1083, 0x095B, 0x4453, 0x5D8B, 0x77E3, 0x6E3B,
+      0xEDF3, 0xF42B, 0xDE43, 0xC79B, 0x8A93, 0x934B, 0xB923, 0xA0FB,
+      0xB6A2, 0xAF7A, 0x8512, 0x9CCA, 0xD1C2, 0xC81A, 0xE272, 0xFBAA,
+      0x7862, 0x61BA, 0x4BD2, 0x520A, 0x1F02, 0x06DA, 0x2CB2, 0x356A,
+      0x4666, 0x5FBE, 0x75D6, 0x6C0E, 0x2106, 0x38DE, 0x12B6, 0x0B6E,
+      0x88A6, 0x917E, 0xBB16, 0xA2CE, 0xEFC6, 0xF61E, 0xDC76, 0xC5AE,
+      0xD3F7, 0xCA2F, 0xE047, 0xF99F, 0xB497, 0xAD4F, 0x8727, 0x9EFF,
+      0x1D37, 0x04EF, 0x2E87, 0x375F, 0x7A57, 0x638F, 0x49E7, 0x503F,
+      0x6555, 0x7C8D, 0x56E5, 0x4F3D, 0x0235, 0x1BED, 0x3185, 0x285D,
+      0xAB95, 0xB24D, 0x9825, 0x81FD, 0xCCF5, 0xD52D, 0xFF45, 0xE69D,
+      0xF0C4, 0xE91C, 0xC374, 0xDAAC, 0x97A4, 0x8E7C, 0xA414, 0xBDCC,
+      0x3E04, 0x27DC, 0x0DB4, 0x146C, 0x5964, 0x40BC, 0x6AD4, 0x730C,
+      0x8CCC, 0x9514, 0xBF7C, 0xA6A4, 0xEBAC, 0xF274, 0xD81C, 0xC1C4,
+      0x420C, 0x5BD4, 0x71BC, 0x6864, 0x256C, 0x3CB4, 0x16DC, 0x0F04,
+      0x195D, 0x0085, 0x2AED, 0x3335, 0x7E3D, 0x67E5, 0x4D8D, 0x5455,
+      0xD79D, 0xCE45, 0xE42D, 0xFDF5, 0xB0FD, 0xA925, 0x834D, 0x9A95,
+      0xAFFF, 0xB627, 0x9C4F, 0x8597, 0xC89F, 0xD147, 0xFB2F, 0xE2F7,
+      0x613F, 0x78E7, 0x528F, 0x4B57, 0x065F, 0x1F87, 0x35EF, 0x2C37,
+      0x3A6E, 0x23B6, 0x09DE, 0x1006, 0x5D0E, 0x44D6, 0x6EBE, 0x7766,
+      0xF4AE, 0xED76, 0xC71E, 0xDEC6, 0x93CE, 0x8A16, 0xA07E, 0xB9A6,
+      0xCAAA, 0xD372, 0xF91A, 0xE0C2, 0xADCA, 0xB412, 0x9E7A, 0x87A2,
+      0x046A, 0x1DB2, 0x37DA, 0x2E02, 0x630A, 0x7AD2, 0x50BA, 0x4962,
+      0x5F3B, 0x46E3, 0x6C8B, 0x7553, 0x385B, 0x2183, 0x0BEB, 0x1233,
+      0x91FB, 0x8823, 0xA24B, 0xBB93, 0xF69B, 0xEF43, 0xC52B, 0xDCF3,
+      0xE999, 0xF041, 0xDA29, 0xC3F1, 0x8EF9, 0x9721, 0xBD49, 0xA491,
+      0x2759, 0x3E81, 0x14E9, 0x0D31, 0x4039, 0x59E1, 0x7389, 0x6A51,
+      0x7C08, 0x65D0, 0x4FB8, 0x5660, 0x1B68, 0x02B0, 0x28D8, 0x3100,
+      0xB2C8, 0xAB10, 0x8178, 0x98A0, 0xD5A8, 0xCC70, 0xE618, 0xFFC0
+   },
+   {
+      0x0000, 0x5ADC, 0xB5B8, 0xEF64, 0x6361, 0x39BD, 0xD6D9, 0x8C05,
+      0xC6C2, 0x9C1E, 0x737A, 0x29A6, 0xA5A3, 0xFF7F, 0x101B, 0x4AC7,
+      0x8595, 0xDF49, 0x302D, 0x6AF1, 0xE6F4, 0xBC28, 0x534C, 0x0990,
+      0x4357, 0x198B, 0xF6EF, 0xAC33, 0x2036, 0x7AEA, 0x958E, 0xCF52,
+      0x033B, 0x59E7, 0xB683, 0xEC5F, 0x605A, 0x3A86, 0xD5E2, 0x8F3E,
+      0xC5F9, 0x9F25, 0x7041, 0x2A9D, 0xA698, 0xFC44, 0x1320, 0x49FC,
+      0x86AE, 0xDC72, 0x3316, 0x69CA, 0xE5CF, 0xBF13, 0x5077, 0x0AAB,
+      0x406C, 0x1AB0, 0xF5D4, 0xAF08, 0x230D, 0x79D1, 0x96B5, 0xCC69,
+      0x0676, 0x5CAA, 0xB3CE, 0xE912, 0x6517, 0x3FCB, 0xD0AF, 0x8A73,
+      0xC0B4, 0x9A68, 0x750C, 0x2FD0, 0xA3D5, 0xF909, 0x166D, 0x4CB1,
+      0x83E3, 0xD93F, 0x365B, 0x6C87, 0xE082, 0xBA5E, 0x553A, 0x0FE6,
+      0x4521, 0x1FFD, 0xF099, 0xAA45, 0x2640, 0x7C9C, 0x93F8, 0xC924,
+      0x054D, 0x5F91, 0xB0F5, 0xEA29, 0x662C, 0x3CF0, 0xD394, 0x8948,
+      0xC38F, 0x9953, 0x7637, 0x2CEB, 0xA0EE, 0xFA32, 0x1556, 0x4F8A,
+      0x80D8, 0xDA04, 0x3560, 0x6FBC, 0xE3B9, 0xB965, 0x5601, 0x0CDD,
+      0x461A, 0x1CC6, 0xF3A2, 0xA97E, 0x257B, 0x7FA7, 0x90C3, 0xCA1F,
+      0x0CEC, 0x5630, 0xB954, 0xE388, 0x6F8D, 0x3551, 0xDA35, 0x80E9,
+      0xCA2E, 0x90F2, 0x7F96, 0x254A, 0xA94F, 0xF393, 0x1CF7, 0x462B,
+      0x8979, 0xD3A5, 0x3CC1, 0x661D, 0xEA18, 0xB0C4, 0x5FA0, 0x057C,
+      0x4FBB, 0x1567, 0xFA03, 0xA0DF, 0x2CDA, 0x7606, 0x9962, 0xC3BE,
+      0x0FD7, 0x550B, 0xBA6F, 0xE0B3, 0x6CB6, 0x366A, 0xD90E, 0x83D2,
+      0xC915, 0x93C9, 0x7CAD, 0x2671, 0xAA74, 0xF0A8, 0x1FCC, 0x4510,
+      0x8A42, 0xD09E, 0x3FFA, 0x6526, 0xE923, 0xB3FF, 0x5C9B, 0x0647,
+      0x4C80, 0x165C, 0xF938, 0xA3E4, 0x2FE1, 0x753D, 0x9A59, 0xC085,
+      0x0A9A, 0x5046, 0xBF22, 0xE5FE, 0x69FB, 0x3327, 0xDC43, 0x869F,
+      0xCC58, 0x9684, 0x79E0, 0x233C, 0xAF39, 0xF5E5, 0x1A81, 0x405D,
+      0x8F0F, 0xD5D3, 0x3AB7, 0x606B, 0xEC6E, 0xB6B2, 0x59D6, 0x030A,
+      0x49CD, 0x1311, 0xFC75, 0xA6A9, 0x2AAC, 0x7070, 0x9F14, 0xC5C8,
+      0x09A1, 0x537D, 0xBC19, 0xE6C5, 0x6AC0, 0x301C, 0xDF78, 0x85A4,
+      0xCF63, 0x95BF, 0x7ADB, 0x2007, 0xAC02, 0xF6DE, 0x19BA, 0x4366,
+      0x8C34, 0xD6E8, 0x398C, 0x6350, 0xEF55, 0xB589, 0x5AED, 0x0031,
+      0x4AF6, 0x102A, 0xFF4E, 0xA592, 0x2997, 0x734B, 0x9C2F, 0xC6F3
+   },
+   {
+      0x0000, 0x1CBB, 0x3976, 0x25CD, 0x72EC, 0x6E57, 0x4B9A, 0x5721,
+      0xE5D8, 0xF963, 0xDCAE, 0xC015, 0x9734, 0x8B8F, 0xAE42, 0xB2F9,
+      0xC3A1, 0xDF1A, 0xFAD7, 0xE66C, 0xB14D, 0xADF6, 0x883B, 0x9480,
+      0x2679, 0x3AC2, 0x1F0F, 0x03B4, 0x5495, 0x482E, 0x6DE3, 0x7158,
+      0x8F53, 0x93E8, 0xB625, 0xAA9E, 0xFDBF, 0xE104, 0xC4C9, 0xD872,
+      0x6A8B, 0x7630, 0x53FD, 0x4F46, 0x1867, 0x04DC, 0x2111, 0x3DAA,
+      0x4CF2, 0x5049, 0x7584, 0x693F, 0x3E1E, 0x22A5, 0x0768, 0x1BD3,
+      0xA92A, 0xB591, 0x905C, 0x8CE7, 0xDBC6, 0xC77D, 0xE2B0, 0xFE0B,
+      0x16B7, 0x0A0C, 0x2FC1, 0x337A, 0x645B, 0x78E0, 0x5D2D, 0x4196,
+      0xF36F, 0xEFD4, 0xCA19, 0xD6A2, 0x8183, 0x9D38, 0xB8F5, 0xA44E,
+      0xD516, 0xC9AD, 0xEC60, 0xF0DB, 0xA7FA, 0xBB41, 0x9E8C, 0x8237,
+      0x30CE, 0x2C75, 0x09B8, 0x1503, 0x4222, 0x5E99, 0x7B54, 0x67EF,
+      0x99E4, 0x855F, 0xA092, 0xBC29, 0xEB08, 0xF7B3, 0xD27E, 0xCEC5,
+      0x7C3C, 0x6087, 0x454A, 0x59F1, 0x0ED0, 0x126B, 0x37A6, 0x2B1D,
+      0x5A45, 0x46FE, 0x6333, 0x7F88, 0x28A9, 0x3412, 0x11DF, 0x0D64,
+      0xBF9D, 0xA326, 0x86EB, 0x9A50, 0xCD71, 0xD1CA, 0xF407, 0xE8BC,
+      0x2D6E, 0x31D5, 0x1418, 0x08A3, 0x5F82, 0x4339, 0x66F4, 0x7A4F,
+      0xC8B6, 0xD40D, 0xF1C0, 0xED7B, 0xBA5A, 0xA6E1, 0x832C, 0x9F97,
+      0xEECF, 0xF274, 0xD7B9, 0xCB02, 0x9C23, 0x8098, 0xA555, 0xB9EE,
+      0x0B17, 0x17AC, 0x3261, 0x2EDA, 0x79FB, 0x6540, 0x408D, 0x5C36,
+      0xA23D, 0xBE86, 0x9B4B, 0x87F0, 0xD0D1, 0xCC6A, 0xE9A7, 0xF51C,
+      0x47E5, 0x5B5E, 0x7E93, 0x6228, 0x3509, 0x29B2, 0x0C7F, 0x10C4,
+      0x619C, 0x7D27, 0x58EA, 0x4451, 0x1370, 0x0FCB, 0x2A06, 0x36BD,
+      0x8444, 0x98FF, 0xBD32, 0xA189, 0xF6A8, 0xEA13, 0xCFDE, 0xD365,
+      0x3BD9, 0x2762, 0x02AF, 0x1E14, 0x4935, 0x558E, 0x7043, 0x6CF8,
+      0xDE01, 0xC2BA, 0xE777, 0xFBCC, 0xACED, 0xB056, 0x959B, 0x8920,
+      0xF878, 0xE4C3, 0xC10E, 0xDDB5, 0x8A94, 0x962F, 0xB3E2, 0xAF59,
+      0x1DA0, 0x011B, 0x24D6, 0x386D, 0x6F4C, 0x73F7, 0x563A, 0x4A81,
+      0xB48A, 0xA831, 0x8DFC, 0x9147, 0xC666, 0xDADD, 0xFF10, 0xE3AB,
+      0x5152, 0x4DE9, 0x6824, 0x749F, 0x23BE, 0x3F05, 0x1AC8, 0x0673,
+      0x772B, 0x6B90, 0x4E5D, 0x52E6, 0x05C7, 0x197C, 0x3CB1, 0x200A,
+      0x92F3, 0x8E48, 0xAB85, 0xB73E, 0xE01F, 0xFCA4, 0xD969, 0xC5D2
+   }
+};
+
+
+/**
+ * @brief Initialize settings with default values
+ * @param[out] settings Structure that contains PPP settings
+ **/
+
+void pppGetDefaultSettings(PppSettings *settings)
+{
+   //Use default interface
+   settings->interface = NULL;
+
+   //Default MRU
+   settings->mru = PPP_DEFAULT_MRU;
+   //Default async control character map
+   settings->accm = PPP_DEFAULT_ACCM;
+   //Allowed authentication protocols
+   settings->authProtocol = PPP_AUTH_PROTOCOL_PAP | PPP_AUTH_PROTOCOL_CHAP_MD5;
+
+   //Random data generation callback function
+   settings->randCallback = NULL;
+   //PPP authentication callback function
+   settings->authCallback = NULL;
+}
+
+
+/**
+ * @brief PPP initialization
+ * @param[in] context Pointer to the PPP context
+ * @param[in] settings PPP configuration parameters
+ * @return Error code
+ **/
+
+error_t pppInit(PppContext *context, const PppSettings *settings)
+{
+   NetInterface *interface;
+
+   //Debug message
+   TRACE_INFO("PPP initialization\r\n");
+
+   //Check parameters
+   if(context == NULL || settings == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //The PPP context is bound to a network interface
+   interface = settings->interface;
+
+   //Make sure the interface is valid
+   if(interface == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Check the value of the MRU
+   if(settings->mru < PPP_MIN_MRU || settings->mru > PPP_MAX_MRU)
+      return ERROR_INVALID_PARAMETER;
+
+   //Clear the PPP context
+   osMemset(context, 0, sizeof(PppContext));
+
+   //Save user settings
+   context->settings = *settings;
+   //Underlying network interface
+   context->interface = interface;
+
+   //Default timeout
+   context->timeout = INFINITE_DELAY;
+
+   //Initialize PPP finite state machines
+   context->pppPhase = PPP_PHASE_DEAD;
+   context->lcpFsm.state = PPP_STATE_0_INITIAL;
+#if (IPV4_SUPPORT == ENABLED)
+   context->ipcpFsm.state = PPP_STATE_0_INITIAL;
+#endif
+#if (PAP_SUPPORT == ENABLED)
+   context->papFsm.localState = PAP_STATE_0_INITIAL;
+   context->papFsm.peerState = PAP_STATE_0_INITIAL;
+#endif
+
+   //Attach the PPP context to the network interface
+   interface->pppContext = context;
+
+   //Successful initialization
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Set timeout value for blocking operations
+ * @param[in] interface Underlying network interface
+ * @param[in] timeout Maximum time to wait
+ * @return Error code
+ **/
+
+error_t pppSetTimeout(NetInterface *interface, systime_t timeout)
+{
+   PppContext *context;
+
+   //Check parameters
+   if(interface == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //Make sure PPP has been properly configured
+   if(context == NULL)
+      return ERROR_NOT_CONFIGURED;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Set timeout value
+   context->timeout = timeout;
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Set PPP authentication information
+ * @param[in] interface Underlying network interface
+ * @param[in] username NULL-terminated string containing the user name
+ * @param[in] password NULL-terminated string containing the password
+ * @return Error code
+ **/
+
+error_t pppSetAuthInfo(NetInterface *interface, const char_t *username,
+   const char_t *password)
+{
+   PppContext *context;
+
+   //Check parameters
+   if(interface == NULL || username == NULL || password == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //Make sure PPP has been properly configured
+   if(context == NULL)
+      return ERROR_NOT_CONFIGURED;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Save user name
+   strSafeCopy(context->username, username, PPP_MAX_USERNAME_LEN);
+   //Save password
+   strSafeCopy(context->password, password, PPP_MAX_PASSWORD_LEN);
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Password verification
+ *
+ * This function is meant to be called from the authentication callback,
+ * with the password expected for the user name the peer has sent
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] password NULL-terminated string containing the password
+ * @return TRUE if the password is valid, else FALSE
+ **/
+
+bool_t pppCheckPassword(NetInterface *interface, const char_t *password)
+{
+   bool_t status;
+   PppContext *context;
+
+   //Debug message
+   TRACE_DEBUG("PPP password verification...\r\n");
+
+   //The password has not been verified yet
+   status = FALSE;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //Make sure PPP has been properly configured
+   if(context != NULL)
+   {
+#if (PAP_SUPPORT == ENABLED)
+      //PAP authentication protocol?
+      if(context->localConfig.authProtocol == PPP_PROTOCOL_PAP)
+      {
+         //Perform password verification
+         status = papCheckPassword(context, password);
+      }
+#endif
+   }
+
+   //Return TRUE is the password is valid, else FALSE
+   return status;
+}
+
+
+/**
+ * @brief Send AT command
+ * @param[in] interface Underlying network interface
+ * @param[in] data NULL-terminated string that contains the AT command to be sent
+ * @return Error code
+ **/
+
+error_t pppSendAtCommand(NetInterface *interface, const char_t *data)
+{
+   error_t error;
+   PppContext *context;
+
+   //Check parameters
+   if(interface == NULL || data == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //Make sure PPP has been properly configured
+   if(context == NULL)
+      return ERROR_NOT_CONFIGURED;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //AT commands can only be issued in Link Dead phase
+   if(context->pppPhase == PPP_PHASE_DEAD)
+   {
+      //Discard the responses to the previous commands
+      pppHdlcDriverPurgeRxBuffer(context);
+
+      //Send AT command
+      error = pppHdlcDriverSendAtCommand(interface, data);
+   }
+   else
+   {
+      //Report an error
+      error = ERROR_ALREADY_CONNECTED;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Wait for an incoming AT command
+ * @param[in] interface Underlying network interface
+ * @param[out] data Buffer where to store the incoming AT command
+ * @param[in] size Size of the buffer, in bytes
+ * @return Error code
+ **/
+
+error_t pppReceiveAtCommand(NetInterface *interface, char_t *data, size_t size)
+{
+   error_t error;
+   systime_t time;
+   systime_t startTime;
+   PppContext *context;
+
+   //Check parameters
+   if(interface == NULL || data == NULL || size == 0)
+      return ERROR_INVALID_PARAMETER;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //Make sure PPP has been properly configured
+   if(context == NULL)
+      return ERROR_NOT_CONFIGURED;
+
+   //Save current time
+   startTime = osGetSystemTime();
+
+   //Wait for an incoming AT command
+   while(1)
+   {
+      //Get exclusive access
+      osAcquireMutex(&netMutex);
+
+      //AT commands can only be received in Link Dead phase
+      if(context->pppPhase == PPP_PHASE_DEAD)
+      {
+         //Read the next line received from the modem, if any
+         error = pppHdlcDriverReceiveAtCommand(interface, data, size);
+      }
+      else
+      {
+         //Report an error
+         error = ERROR_ALREADY_CONNECTED;
+      }
+
+      //Release exclusive access
+      osReleaseMutex(&netMutex);
+
+      //No complete line received yet?
+      if(error != ERROR_BUFFER_EMPTY)
+         break;
+
+      //Get current time
+      time = osGetSystemTime();
+
+      //Check whether the timeout has elapsed
+      if(context->timeout != INFINITE_DELAY &&
+         timeCompare(time, startTime + context->timeout) >= 0)
+      {
+         //Report a timeout error
+         error = ERROR_TIMEOUT;
+         break;
+      }
+
+      //Poll the receive buffer at regular intervals
+      osDelayTask(PPP_POLLING_INTERVAL);
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Establish a PPP connection
+ *
+ * The modem is expected to be in data mode already (the dial sequence
+ * has returned CONNECT). The frames the peer may have sent right after the
+ * CONNECT message are still in the receive buffer and are processed once
+ * the link establishment phase has begun
+ *
+ * @param[in] interface Underlying network interface
+ * @return Error code
+ **/
+
+error_t pppConnect(NetInterface *interface)
+{
+   error_t error;
+   systime_t time;
+   systime_t startTime;
+   PppContext *context;
+
+   //Check parameters
+   if(interface == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //Make sure PPP has been properly configured
+   if(context == NULL)
+      return ERROR_NOT_CONFIGURED;
+
+   //Debug message
+   TRACE_INFO("Establishing PPP connection...\r\n");
+
+   //Save current time
+   startTime = osGetSystemTime();
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //The link must be dead
+   if(context->pppPhase != PPP_PHASE_DEAD)
+   {
+      //Release exclusive access
+      osReleaseMutex(&netMutex);
+      //Report an error
+      return ERROR_ALREADY_CONNECTED;
+   }
+
+   //Default local configuration
+   osMemset(&context->localConfig, 0, sizeof(PppConfig));
+   context->localConfig.mru = context->settings.mru;
+   context->localConfig.accm = context->settings.accm;
+   context->localConfig.magicNumber = netGenerateRand();
+   context->localConfig.pfc = TRUE;
+   context->localConfig.acfc = TRUE;
+
+   //Until the options are negotiated, the peer is assumed to use the
+   //default values
+   osMemset(&context->peerConfig, 0, sizeof(PppConfig));
+   context->peerConfig.mru = PPP_DEFAULT_MRU;
+   context->peerConfig.accm = PPP_DEFAULT_ACCM;
+
+   //Reset authentication status
+   context->localAuthDone = FALSE;
+   context->peerAuthDone = FALSE;
+   //All network protocols are assumed to be supported by the peer
+   context->ipRejected = FALSE;
+   context->ipv6Rejected = FALSE;
+
+   //Reset finite state machines
+   osMemset(&context->lcpFsm, 0, sizeof(PppFsm));
+   context->lcpFsm.state = PPP_STATE_0_INITIAL;
+#if (IPV4_SUPPORT == ENABLED)
+   osMemset(&context->ipcpFsm, 0, sizeof(PppFsm));
+   context->ipcpFsm.state = PPP_STATE_0_INITIAL;
+#endif
+#if (PAP_SUPPORT == ENABLED)
+   osMemset(&context->papFsm, 0, sizeof(PapFsm));
+   context->papFsm.localState = PAP_STATE_0_INITIAL;
+   context->papFsm.peerState = PAP_STATE_0_INITIAL;
+#endif
+
+   //Enter link establishment phase
+   context->pppPhase = PPP_PHASE_ESTABLISH;
+
+   //Open LCP. The serial link is up as soon as the modem is in data mode
+   lcpOpen(context);
+
+   //Process the frames received while the dial sequence was completing
+   interface->nicEvent = TRUE;
+   osSetEvent(&netEvent);
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Wait for the connection to be established
+   while(1)
+   {
+      //Check the state of the connection at regular intervals
+      osDelayTask(PPP_POLLING_INTERVAL);
+
+      //Get exclusive access
+      osAcquireMutex(&netMutex);
+
+#if (IPV4_SUPPORT == ENABLED)
+      //IPCP has reached the Opened state?
+      if(context->pppPhase == PPP_PHASE_NETWORK &&
+         context->ipcpFsm.state == PPP_STATE_9_OPENED)
+      {
+         //The connection is established
+         error = NO_ERROR;
+      }
+      else
+#endif
+      //The link has been terminated?
+      if(context->pppPhase == PPP_PHASE_DEAD)
+      {
+         //The peer refused the connection
+         error = ERROR_FAILURE;
+      }
+      else
+      {
+         //Get current time
+         time = osGetSystemTime();
+
+         //Check whether the timeout has elapsed
+         if(context->timeout != INFINITE_DELAY &&
+            timeCompare(time, startTime + context->timeout) >= 0)
+         {
+            //Abort the connection attempt
+            lcpClose(context);
+            //Report a timeout error
+            error = ERROR_TIMEOUT;
+         }
+         else
+         {
+            //The connection is in progress
+            error = ERROR_IN_PROGRESS;
+         }
+      }
+
+      //Release exclusive access
+      osReleaseMutex(&netMutex);
+
+      //Any result to report?
+      if(error != ERROR_IN_PROGRESS)
+         break;
+   }
+
+   //Successful connection?
+   if(!error)
+   {
+      //Debug message
+      TRACE_INFO("PPP connection established\r\n");
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Close a PPP connection
+ * @param[in] interface Underlying network interface
+ * @return Error code
+ **/
+
+error_t pppClose(NetInterface *interface)
+{
+   bool_t dead;
+   PppContext *context;
+
+   //Check parameters
+   if(interface == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //Make sure PPP has been properly configured
+   if(context == NULL)
+      return ERROR_NOT_CONFIGURED;
+
+   //Debug message
+   TRACE_INFO("Closing PPP connection...\r\n");
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Close LCP. The termination sequence is bounded by the restart timer
+   lcpClose(context);
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Wait for the link to be dead
+   do
+   {
+      //Check the state of the link at regular intervals
+      osDelayTask(PPP_POLLING_INTERVAL);
+
+      //Get exclusive access
+      osAcquireMutex(&netMutex);
+      //Check current phase
+      dead = (context->pppPhase == PPP_PHASE_DEAD);
+      //Release exclusive access
+      osReleaseMutex(&netMutex);
+
+   } while(!dead);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief PPP timer handler
+ *
+ * This routine must be periodically called by the TCP/IP stack to
+ * manage retransmissions
+ *
+ * @param[in] interface Underlying network interface
+ **/
+
+void pppTick(NetInterface *interface)
+{
+   PppContext *context;
+
+   //PPP driver?
+   if(interface->nicDriver != NULL &&
+      interface->nicDriver->type == NIC_TYPE_PPP)
+   {
+      //Point to the PPP context
+      context = interface->pppContext;
+
+      //Valid PPP context?
+      if(context != NULL)
+      {
+         //Handle LCP retransmission timer
+         lcpTick(context);
+
+#if (IPV4_SUPPORT == ENABLED)
+         //Handle IPCP retransmission timer
+         ipcpTick(context);
+#endif
+
+#if (PAP_SUPPORT == ENABLED)
+         //Handle PAP timer
+         papTick(context);
+#endif
+      }
+   }
+}
+
+
+/**
+ * @brief Process an incoming PPP frame
+ * @param[in] interface Underlying network interface
+ * @param[in] frame Incoming PPP frame to process
+ * @param[in] length Total frame length
+ * @param[in] ancillary Additional options passed to the stack along with
+ *   the packet
+ **/
+
+void pppProcessFrame(NetInterface *interface, uint8_t *frame, size_t length,
+   NetRxAncillary *ancillary)
+{
+   size_t n;
+   uint16_t protocol;
+   PppContext *context;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //Make sure PPP has been properly configured
+   if(context == NULL)
+      return;
+
+   //Check the length of the frame
+   if(length < (PPP_FCS_SIZE + 1))
+      return;
+
+   //Verify the FCS over the whole frame, including the FCS field
+   if(pppCalcFcs(frame, length) != PPP_GOOD_FCS)
+   {
+      //Debug message
+      TRACE_WARNING("PPP frame with invalid FCS!\r\n");
+      //Drop the received frame
+      return;
+   }
+
+   //Strip the FCS field
+   length -= PPP_FCS_SIZE;
+
+   //Parse the Address, Control and Protocol fields
+   n = pppParseFrameHeader(frame, length, &protocol);
+   //Malformed frame header?
+   if(n == 0)
+      return;
+
+   //Point to the information field
+   frame += n;
+   length -= n;
+
+#if (IPV4_SUPPORT == ENABLED)
+   //IPv4 packet?
+   if(protocol == PPP_PROTOCOL_IP)
+   {
+      //IP datagrams are only accepted once IPCP has reached the Opened state
+      if(context->pppPhase == PPP_PHASE_NETWORK &&
+         context->ipcpFsm.state == PPP_STATE_9_OPENED)
+      {
+         //Process incoming IPv4 packet
+         ipv4ProcessPacket(interface, (Ipv4Header *) frame, length, ancillary);
+      }
+   }
+   //IPCP packet?
+   else if(protocol == PPP_PROTOCOL_IPCP)
+   {
+      //NCP packets received outside the network-layer protocol phase are
+      //silently discarded
+      if(context->pppPhase == PPP_PHASE_NETWORK)
+      {
+         //Process incoming IPCP packet
+         ipcpProcessPacket(context, (PppPacket *) frame, length);
+      }
+   }
+   else
+#endif
+#if (PAP_SUPPORT == ENABLED)
+   //PAP packet?
+   if(protocol == PPP_PROTOCOL_PAP)
+   {
+      //PAP packets are only relevant in the authentication phase
+      if(context->pppPhase == PPP_PHASE_AUTHENTICATE)
+      {
+         //Process incoming PAP packet
+         papProcessPacket(context, (PppPacket *) frame, length);
+      }
+   }
+   else
+#endif
+   //LCP packet?
+   if(protocol == PPP_PROTOCOL_LCP)
+   {
+      //Process incoming LCP packet
+      lcpProcessPacket(context, (PppPacket *) frame, length);
+   }
+   //Unknown protocol?
+   else
+   {
+      //The peer is told that the protocol is not supported
+      lcpProcessUnknownProtocol(context, protocol, frame, length);
+   }
+}
+
+
+/**
+ * @brief Send a PPP frame
+ *
+ * The Address, Control and Protocol fields are prepended in the headroom
+ * of the buffer. The FCS is computed by the HDLC driver while the frame is
+ * being stuffed
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] buffer Multi-part buffer containing the data
+ * @param[in] offset Offset to the first data byte
+ * @param[in] protocol Protocol field value
+ * @return Error code
+ **/
+
+error_t pppSendFrame(NetInterface *interface, NetBuffer *buffer, size_t offset,
+   uint16_t protocol)
+{
+   error_t error;
+   uint8_t *p;
+   PppContext *context;
+   NetTxAncillary ancillary;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //Make sure PPP has been properly configured
+   if(context == NULL)
+      return ERROR_NOT_CONFIGURED;
+
+   //Check whether the protocol field can be compressed. LCP packets are
+   //always sent with the full header (refer to RFC 1661, section 6.5)
+   if(context->peerConfig.pfc && protocol < 0x0100 &&
+      protocol != PPP_PROTOCOL_LCP)
+   {
+      //Make room for the compressed Protocol field
+      p = netBufferPush(buffer, &offset, sizeof(uint8_t));
+      //Not enough headroom?
+      if(p == NULL)
+         return ERROR_INVALID_PARAMETER;
+
+      //Format Protocol field
+      p[0] = LSB(protocol);
+   }
+   else
+   {
+      //Make room for the Protocol field
+      p = netBufferPush(buffer, &offset, sizeof(uint16_t));
+      //Not enough headroom?
+      if(p == NULL)
+         return ERROR_INVALID_PARAMETER;
+
+      //Format Protocol field
+      STORE16BE(protocol, p);
+   }
+
+   //Check whether the Address and Control fields can be omitted
+   if(!context->peerConfig.acfc || protocol == PPP_PROTOCOL_LCP)
+   {
+      //Make room for the Address and Control fields
+      p = netBufferPush(buffer, &offset, 2 * sizeof(uint8_t));
+      //Not enough headroom?
+      if(p == NULL)
+         return ERROR_INVALID_PARAMETER;
+
+      //Format Address and Control fields
+      p[0] = PPP_ADDR_FIELD;
+      p[1] = PPP_CTRL_FIELD;
+   }
+
+   //Additional options passed to the stack along with the packet
+   ancillary = NET_DEFAULT_TX_ANCILLARY;
+
+   //Send the resulting frame over the specified link
+   error = nicSendPacket(interface, buffer, offset, &ancillary);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Parse PPP frame header
+ * @param[in] frame Pointer to the PPP frame
+ * @param[in] length Length of the frame
+ * @param[out] protocol Value of the Protocol field
+ * @return If the PPP header was successfully parsed, the function returns the size
+ *   of the PPP header. Otherwise, 0 is returned
+ **/
+
+size_t pppParseFrameHeader(const uint8_t *frame, size_t length, uint16_t *protocol)
+{
+   size_t n;
+
+   //Size of the PPP header
+   n = 0;
+
+   //The Address and Control fields may be compressed
+   if(length >= 2 && frame[0] == PPP_ADDR_FIELD && frame[1] == PPP_CTRL_FIELD)
+   {
+      //Skip the Address and Control fields
+      n = 2;
+   }
+
+   //Malformed frame?
+   if(length < (n + sizeof(uint8_t)))
+      return 0;
+
+   //The least significant bit of the least significant octet of the
+   //Protocol field is always set
+   if((frame[n] & 0x01) != 0)
+   {
+      //Compressed Protocol field
+      *protocol = frame[n];
+      n += sizeof(uint8_t);
+   }
+   else
+   {
+      //Malformed frame?
+      if(length < (n + sizeof(uint16_t)))
+         return 0;
+
+      //Uncompressed Protocol field
+      *protocol = LOAD16BE(frame + n);
+      n += sizeof(uint16_t);
+
+      //The least significant octet must be odd
+      if((*protocol & 0x0001) == 0)
+         return 0;
+   }
+
+   //Return the size of the PPP header
+   return n;
+}
+
+
+/**
+ * @brief Update the FCS with a block of data
+ *
+ * Four bytes are folded at a time, the remaining ones are processed one
+ * by one
+ *
+ * @param[in] fcs Current value of the FCS
+ * @param[in] data Pointer to the data
+ * @param[in] length Length of the data
+ * @return Updated value of the FCS
+ **/
+
+static uint16_t pppUpdateFcs(uint16_t fcs, const uint8_t *data, size_t length)
+{
+   uint32_t word;
+
+   //Process the data four bytes at a time
+   while(length >= 4)
+   {
+      //The FCS is transmitted least significant byte first
+      word = fcs ^ LOAD32LE(data);
+
+      //Fold the four bytes into the FCS
+      fcs = fcsTable[3][word & 0xFF] ^ fcsTable[2][(word >> 8) & 0xFF] ^
+         fcsTable[1][(word >> 16) & 0xFF] ^ fcsTable[0][word >> 24];
+
+      //Next four bytes
+      data += 4;
+      length -= 4;
+   }
+
+   //Process the remaining bytes
+   while(length > 0)
+   {
+      //Update FCS value
+      fcs = (fcs >> 8) ^ fcsTable[0][(fcs & 0xFF) ^ *data];
+
+      //Next byte
+      data++;
+      length--;
+   }
+
+   //Return the updated value of the FCS
+   return fcs;
+}
+
+
+/**
+ * @brief FCS calculation
+ * @param[in] data Pointer to the data over which to calculate the FCS
+ * @param[in] length Length of the data
+ * @return Resulting FCS value (not complemented)
+ **/
+
+uint16_t pppCalcFcs(const uint8_t *data, size_t length)
+{
+   //The FCS is initialized to all ones
+   return pppUpdateFcs(0xFFFF, data, length);
+}
+
+
+/**
+ * @brief Calculate FCS over a multi-part buffer
+ * @param[in] buffer Pointer to the multi-part buffer
+ * @param[in] offset Offset from the beginning of the buffer
+ * @param[in] length Number of bytes to process
+ * @return Resulting FCS value (not complemented)
+ **/
+
+uint16_t pppCalcFcsEx(const NetBuffer *buffer, size_t offset, size_t length)
+{
+   uint_t i;
+   uint_t n;
+   uint16_t fcs;
+   uint8_t *p;
+
+   //The FCS is initialized to all ones
+   fcs = 0xFFFF;
+
+   //Loop through data chunks
+   for(i = 0; i < buffer->chunkCount && length > 0; i++)
+   {
+      //Is there any data to process in the current chunk?
+      if(offset < buffer->chunk[i].length)
+      {
+         //Point to the first data byte
+         p = (uint8_t *) buffer->chunk[i].address + offset;
+         //Number of bytes available in the current chunk
+         n = buffer->chunk[i].length - offset;
+         //Limit the number of bytes to process
+         n = MIN(n, length);
+
+         //Update the FCS with the contents of the current chunk
+         fcs = pppUpdateFcs(fcs, p, n);
+
+         //Remaining bytes to process
+         length -= n;
+         //Process the next block from the start
+         offset = 0;
+      }
+      else
+      {
+         //Skip the current chunk
+         offset -= buffer->chunk[i].length;
+      }
+   }
+
+   //Return resulting FCS value
+   return fcs;
+}
+
+
+/**
+ * @brief Allocate a buffer to hold a PPP frame
+ * @param[in] length Desired payload length
+ * @param[out] offset Offset to the first byte of the payload
+ * @param[in] tag Subsystem the buffer is charged to
+ * @return The function returns a pointer to the newly allocated
+ *   buffer. If the system is out of resources, NULL is returned
+ **/
+
+NetBuffer *pppAllocBufferTagged(size_t length, size_t *offset, uint8_t tag)
+{
+   NetBuffer *buffer;
+
+   //Allocate a buffer to hold the PPP frame, with room for the header
+   buffer = netBufferAllocTagged(length + PPP_FRAME_HEADER_SIZE, tag);
+
+   //Valid buffer?
+   if(buffer != NULL)
+   {
+      //Offset to the first byte of the payload
+      *offset = PPP_FRAME_HEADER_SIZE;
+   }
+
+   //Return a pointer to the allocated buffer
+   return buffer;
+}
+
+#endif
@@ -151,6 +151,9 @@ struct _PppContext;
 ///PPP Control field
 #define PPP_CTRL_FIELD 0x03
 
+//Buffer allocation charged to the subsystem of the caller (net_mem.h)
+#define pppAllocBuffer(length, offset) pppAllocBufferTagged(length, offset, NET_MEM_TAG())
+
 //C++ guard
 #ifdef __cplusplus
 extern "C" {
@@ -524,7 +527,7 @@ size_t pppParseFrameHeader(const uint8_t *frame, size_t length, uint16_t *protoc
 uint16_t pppCalcFcs(const uint8_t *data, size_t length);
 uint16_t pppCalcFcsEx(const NetBuffer *buffer, size_t offset, size_t length);
 
-NetBuffer *pppAllocBuffer(size_t length, size_t *offset);
+NetBuffer *pppAllocBufferTagged(size_t length, size_t *offset, uint8_t tag);
 
 //C++ guard
 #ifdef __cplusplus
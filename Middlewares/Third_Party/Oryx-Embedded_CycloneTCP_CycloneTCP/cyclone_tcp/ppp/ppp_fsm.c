@@ -0,0 +1,822 @@
+/**
+ * @file ppp_fsm.c
+ * @brief PPP finite state machine
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * The option negotiation automaton shared by LCP and the network control
+ * protocols. Each event is handled as one row of the state transition
+ * table of RFC 1661, section 4.1. The actions are carried out through the
+ * callbacks of the protocol the automaton belongs to
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL PPP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "ppp/ppp_fsm.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (PPP_SUPPORT == ENABLED)
+
+
+/**
+ * @brief Process Up event
+ * @param[in] context PPP context
+ * @param[in,out] fsm Finite state machine
+ * @param[in] callbacks FSM actions
+ **/
+
+void pppUpEvent(PppContext *context, PppFsm *fsm,
+   const PppCallbacks *callbacks)
+{
+   //Check current state
+   switch(fsm->state)
+   {
+   case PPP_STATE_0_INITIAL:
+      //Switch to the Closed state
+      pppChangeState(fsm, PPP_STATE_2_CLOSED);
+      break;
+
+   case PPP_STATE_1_STARTING:
+      //Initialize restart counter
+      callbacks->initRestartCount(context, PPP_MAX_CONFIGURE);
+      //Send Configure-Request packet
+      callbacks->sendConfigureReq(context);
+      //Switch to the Req-Sent state
+      pppChangeState(fsm, PPP_STATE_6_REQ_SENT);
+      break;
+
+   default:
+      //This event cannot occur in a properly implemented automaton.
+      //No transition is taken, and the implementation should not
+      //reset or freeze
+      break;
+   }
+}
+
+
+/**
+ * @brief Process Down event
+ * @param[in] context PPP context
+ * @param[in,out] fsm Finite state machine
+ * @param[in] callbacks FSM actions
+ **/
+
+void pppDownEvent(PppContext *context, PppFsm *fsm,
+   const PppCallbacks *callbacks)
+{
+   //Check current state
+   switch(fsm->state)
+   {
+   case PPP_STATE_2_CLOSED:
+   case PPP_STATE_4_CLOSING:
+      //Switch to the Initial state
+      pppChangeState(fsm, PPP_STATE_0_INITIAL);
+      break;
+
+   case PPP_STATE_3_STOPPED:
+      //Switch to the Starting state
+      pppChangeState(fsm, PPP_STATE_1_STARTING);
+      //Indicate to the lower layers that the automaton is entering the
+      //Starting state
+      callbacks->thisLayerStarted(context);
+      break;
+
+   case PPP_STATE_5_STOPPING:
+   case PPP_STATE_6_REQ_SENT:
+   case PPP_STATE_7_ACK_RCVD:
+   case PPP_STATE_8_ACK_SENT:
+      //Switch to the Starting state
+      pppChangeState(fsm, PPP_STATE_1_STARTING);
+      break;
+
+   case PPP_STATE_9_OPENED:
+      //Switch to the Starting state
+      pppChangeState(fsm, PPP_STATE_1_STARTING);
+      //Indicate to the upper layers that the automaton is leaving the
+      //Opened state
+      callbacks->thisLayerDown(context);
+      break;
+
+   default:
+      //This event cannot occur in a properly implemented automaton
+      break;
+   }
+}
+
+
+/**
+ * @brief Process Open event
+ * @param[in] context PPP context
+ * @param[in,out] fsm Finite state machine
+ * @param[in] callbacks FSM actions
+ **/
+
+void pppOpenEvent(PppContext *context, PppFsm *fsm,
+   const PppCallbacks *callbacks)
+{
+   //Check current state
+   switch(fsm->state)
+   {
+   case PPP_STATE_0_INITIAL:
+      //Switch to the Starting state
+      pppChangeState(fsm, PPP_STATE_1_STARTING);
+      //Indicate to the lower layers that the automaton is entering the
+      //Starting state
+      callbacks->thisLayerStarted(context);
+      break;
+
+   case PPP_STATE_2_CLOSED:
+      //Initialize restart counter
+      callbacks->initRestartCount(context, PPP_MAX_CONFIGURE);
+      //Send Configure-Request packet
+      callbacks->sendConfigureReq(context);
+      //Switch to the Req-Sent state
+      pppChangeState(fsm, PPP_STATE_6_REQ_SENT);
+      break;
+
+   case PPP_STATE_4_CLOSING:
+      //Switch to the Stopping state
+      pppChangeState(fsm, PPP_STATE_5_STOPPING);
+      break;
+
+   default:
+      //The link is already being opened
+      break;
+   }
+}
+
+
+/**
+ * @brief Process Close event
+ * @param[in] context PPP context
+ * @param[in,out] fsm Finite state machine
+ * @param[in] callbacks FSM actions
+ **/
+
+void pppCloseEvent(PppContext *context, PppFsm *fsm,
+   const PppCallbacks *callbacks)
+{
+   //Check current state
+   switch(fsm->state)
+   {
+   case PPP_STATE_1_STARTING:
+      //Switch to the Initial state
+      pppChangeState(fsm, PPP_STATE_0_INITIAL);
+      //Indicate to the lower layers that the automaton is entering the
+      //Initial, Closed or Stopped states
+      callbacks->thisLayerFinished(context);
+      break;
+
+   case PPP_STATE_3_STOPPED:
+      //Switch to the Closed state
+      pppChangeState(fsm, PPP_STATE_2_CLOSED);
+      break;
+
+   case PPP_STATE_5_STOPPING:
+      //Switch to the Closing state
+      pppChangeState(fsm, PPP_STATE_4_CLOSING);
+      break;
+
+   case PPP_STATE_6_REQ_SENT:
+   case PPP_STATE_7_ACK_RCVD:
+   case PPP_STATE_8_ACK_SENT:
+      //Initialize restart counter
+      callbacks->initRestartCount(context, PPP_MAX_TERMINATE);
+      //Send Terminate-Request packet
+      callbacks->sendTerminateReq(context);
+      //Switch to the Closing state
+      pppChangeState(fsm, PPP_STATE_4_CLOSING);
+      break;
+
+   case PPP_STATE_9_OPENED:
+      //Switch to the Closing state
+      pppChangeState(fsm, PPP_STATE_4_CLOSING);
+      //Indicate to the upper layers that the automaton is leaving the
+      //Opened state
+      callbacks->thisLayerDown(context);
+      //Initialize restart counter
+      callbacks->initRestartCount(context, PPP_MAX_TERMINATE);
+      //Send Terminate-Request packet
+      callbacks->sendTerminateReq(context);
+      break;
+
+   default:
+      //The link is already closed or being closed
+      break;
+   }
+}
+
+
+/**
+ * @brief Process Timeout event
+ *
+ * The restart counter tells apart the TO+ event (the counter is greater
+ * than zero) from the TO- event (the counter has been exhausted)
+ *
+ * @param[in] context PPP context
+ * @param[in,out] fsm Finite state machine
+ * @param[in] callbacks FSM actions
+ **/
+
+void pppTimeoutEvent(PppContext *context, PppFsm *fsm,
+   const PppCallbacks *callbacks)
+{
+   //TO+ event?
+   if(fsm->restartCounter > 0)
+   {
+      //Check current state
+      switch(fsm->state)
+      {
+      case PPP_STATE_4_CLOSING:
+      case PPP_STATE_5_STOPPING:
+         //Send Terminate-Request packet
+         callbacks->sendTerminateReq(context);
+         break;
+
+      case PPP_STATE_6_REQ_SENT:
+      case PPP_STATE_7_ACK_RCVD:
+         //Send Configure-Request packet
+         callbacks->sendConfigureReq(context);
+         //Switch to the Req-Sent state
+         pppChangeState(fsm, PPP_STATE_6_REQ_SENT);
+         break;
+
+      case PPP_STATE_8_ACK_SENT:
+         //Send Configure-Request packet
+         callbacks->sendConfigureReq(context);
+         break;
+
+      default:
+         //The restart timer is not running in the other states
+         break;
+      }
+   }
+   //TO- event?
+   else
+   {
+      //Check current state
+      switch(fsm->state)
+      {
+      case PPP_STATE_4_CLOSING:
+         //Switch to the Closed state
+         pppChangeState(fsm, PPP_STATE_2_CLOSED);
+         //Indicate to the lower layers that the automaton is entering the
+         //Initial, Closed or Stopped states
+         callbacks->thisLayerFinished(context);
+         break;
+
+      case PPP_STATE_5_STOPPING:
+      case PPP_STATE_6_REQ_SENT:
+      case PPP_STATE_7_ACK_RCVD:
+      case PPP_STATE_8_ACK_SENT:
+         //Switch to the Stopped state
+         pppChangeState(fsm, PPP_STATE_3_STOPPED);
+         //Indicate to the lower layers that the automaton is entering the
+         //Initial, Closed or Stopped states
+         callbacks->thisLayerFinished(context);
+         break;
+
+      default:
+         //The restart timer is not running in the other states
+         break;
+      }
+   }
+}
+
+
+/**
+ * @brief Process Receive-Configure-Request event
+ * @param[in] context PPP context
+ * @param[in,out] fsm Finite state machine
+ * @param[in] callbacks FSM actions
+ * @param[in] configureReqPacket Configure-Request packet received from the peer
+ * @param[in] code Tells whether the configuration options are acceptable
+ *   (Configure-Ack) or not (Configure-Nak or Configure-Reject)
+ **/
+
+void pppRcvConfigureReqEvent(PppContext *context, PppFsm *fsm, const PppCallbacks *callbacks,
+   const PppConfigurePacket *configureReqPacket, PppCode code)
+{
+   //Check current state
+   switch(fsm->state)
+   {
+   case PPP_STATE_2_CLOSED:
+      //Send Terminate-Ack packet
+      callbacks->sendTerminateAck(context, NULL);
+      break;
+
+   case PPP_STATE_3_STOPPED:
+      //Initialize restart counter
+      callbacks->initRestartCount(context, PPP_MAX_CONFIGURE);
+      //Send Configure-Request packet
+      callbacks->sendConfigureReq(context);
+
+      //Acceptable options?
+      if(code == PPP_CODE_CONFIGURE_ACK)
+      {
+         //Send Configure-Ack packet
+         callbacks->sendConfigureAck(context, configureReqPacket);
+         //Switch to the Ack-Sent state
+         pppChangeState(fsm, PPP_STATE_8_ACK_SENT);
+      }
+      else
+      {
+         //Send Configure-Nak or Configure-Reject packet
+         if(code == PPP_CODE_CONFIGURE_NAK)
+         {
+            callbacks->sendConfigureNak(context, configureReqPacket);
+         }
+         else
+         {
+            callbacks->sendConfigureRej(context, configureReqPacket);
+         }
+
+         //Switch to the Req-Sent state
+         pppChangeState(fsm, PPP_STATE_6_REQ_SENT);
+      }
+      break;
+
+   case PPP_STATE_6_REQ_SENT:
+   case PPP_STATE_8_ACK_SENT:
+      //Acceptable options?
+      if(code == PPP_CODE_CONFIGURE_ACK)
+      {
+         //Send Configure-Ack packet
+         callbacks->sendConfigureAck(context, configureReqPacket);
+         //Switch to the Ack-Sent state
+         pppChangeState(fsm, PPP_STATE_8_ACK_SENT);
+      }
+      else
+      {
+         //Send Configure-Nak or Configure-Reject packet
+         if(code == PPP_CODE_CONFIGURE_NAK)
+         {
+            callbacks->sendConfigureNak(context, configureReqPacket);
+         }
+         else
+         {
+            callbacks->sendConfigureRej(context, configureReqPacket);
+         }
+
+         //Switch to the Req-Sent state
+         pppChangeState(fsm, PPP_STATE_6_REQ_SENT);
+      }
+      break;
+
+   case PPP_STATE_7_ACK_RCVD:
+      //Acceptable options?
+      if(code == PPP_CODE_CONFIGURE_ACK)
+      {
+         //Send Configure-Ack packet
+         callbacks->sendConfigureAck(context, configureReqPacket);
+         //Switch to the Opened state
+         pppChangeState(fsm, PPP_STATE_9_OPENED);
+         //Indicate to the upper layers that the automaton is entering the
+         //Opened state
+         callbacks->thisLayerUp(context);
+      }
+      else
+      {
+         //Send Configure-Nak or Configure-Reject packet
+         if(code == PPP_CODE_CONFIGURE_NAK)
+         {
+            callbacks->sendConfigureNak(context, configureReqPacket);
+         }
+         else
+         {
+            callbacks->sendConfigureRej(context, configureReqPacket);
+         }
+      }
+      break;
+
+   case PPP_STATE_9_OPENED:
+      //Indicate to the upper layers that the automaton is leaving the
+      //Opened state
+      callbacks->thisLayerDown(context);
+      //Send Configure-Request packet
+      callbacks->sendConfigureReq(context);
+
+      //Acceptable options?
+      if(code == PPP_CODE_CONFIGURE_ACK)
+      {
+         //Send Configure-Ack packet
+         callbacks->sendConfigureAck(context, configureReqPacket);
+         //Switch to the Ack-Sent state
+         pppChangeState(fsm, PPP_STATE_8_ACK_SENT);
+      }
+      else
+      {
+         //Send Configure-Nak or Configure-Reject packet
+         if(code == PPP_CODE_CONFIGURE_NAK)
+         {
+            callbacks->sendConfigureNak(context, configureReqPacket);
+         }
+         else
+         {
+            callbacks->sendConfigureRej(context, configureReqPacket);
+         }
+
+         //Switch to the Req-Sent state
+         pppChangeState(fsm, PPP_STATE_6_REQ_SENT);
+      }
+      break;
+
+   default:
+      //The packet is silently discarded in the Closing and Stopping
+      //states, or before the lower layer is up
+      break;
+   }
+}
+
+
+/**
+ * @brief Process Receive-Configure-Ack event
+ * @param[in] context PPP context
+ * @param[in,out] fsm Finite state machine
+ * @param[in] callbacks FSM actions
+ **/
+
+void pppRcvConfigureAckEvent(PppContext *context, PppFsm *fsm,
+   const PppCallbacks *callbacks)
+{
+   //Check current state
+   switch(fsm->state)
+   {
+   case PPP_STATE_2_CLOSED:
+   case PPP_STATE_3_STOPPED:
+      //Send Terminate-Ack packet
+      callbacks->sendTerminateAck(context, NULL);
+      break;
+
+   case PPP_STATE_6_REQ_SENT:
+      //Initialize restart counter
+      callbacks->initRestartCount(context, PPP_MAX_CONFIGURE);
+      //Switch to the Ack-Rcvd state
+      pppChangeState(fsm, PPP_STATE_7_ACK_RCVD);
+      break;
+
+   case PPP_STATE_7_ACK_RCVD:
+      //Crossed connection: send Configure-Request packet
+      callbacks->sendConfigureReq(context);
+      //Switch to the Req-Sent state
+      pppChangeState(fsm, PPP_STATE_6_REQ_SENT);
+      break;
+
+   case PPP_STATE_8_ACK_SENT:
+      //Initialize restart counter
+      callbacks->initRestartCount(context, PPP_MAX_CONFIGURE);
+      //Switch to the Opened state
+      pppChangeState(fsm, PPP_STATE_9_OPENED);
+      //Indicate to the upper layers that the automaton is entering the
+      //Opened state
+      callbacks->thisLayerUp(context);
+      break;
+
+   case PPP_STATE_9_OPENED:
+      //Indicate to the upper layers that the automaton is leaving the
+      //Opened state
+      callbacks->thisLayerDown(context);
+      //Send Configure-Request packet
+      callbacks->sendConfigureReq(context);
+      //Switch to the Req-Sent state
+      pppChangeState(fsm, PPP_STATE_6_REQ_SENT);
+      break;
+
+   default:
+      //The packet is silently discarded
+      break;
+   }
+}
+
+
+/**
+ * @brief Process Receive-Configure-Nak event
+ *
+ * Configure-Reject packets are handled through the same transitions
+ *
+ * @param[in] context PPP context
+ * @param[in,out] fsm Finite state machine
+ * @param[in] callbacks FSM actions
+ **/
+
+void pppRcvConfigureNakEvent(PppContext *context, PppFsm *fsm,
+   const PppCallbacks *callbacks)
+{
+   //Check current state
+   switch(fsm->state)
+   {
+   case PPP_STATE_2_CLOSED:
+   case PPP_STATE_3_STOPPED:
+      //Send Terminate-Ack packet
+      callbacks->sendTerminateAck(context, NULL);
+      break;
+
+   case PPP_STATE_6_REQ_SENT:
+   case PPP_STATE_8_ACK_SENT:
+      //Initialize restart counter
+      callbacks->initRestartCount(context, PPP_MAX_CONFIGURE);
+      //Send a new Configure-Request packet
+      callbacks->sendConfigureReq(context);
+      break;
+
+   case PPP_STATE_7_ACK_RCVD:
+      //Send a new Configure-Request packet
+      callbacks->sendConfigureReq(context);
+      //Switch to the Req-Sent state
+      pppChangeState(fsm, PPP_STATE_6_REQ_SENT);
+      break;
+
+   case PPP_STATE_9_OPENED:
+      //Indicate to the upper layers that the automaton is leaving the
+      //Opened state
+      callbacks->thisLayerDown(context);
+      //Send Configure-Request packet
+      callbacks->sendConfigureReq(context);
+      //Switch to the Req-Sent state
+      pppChangeState(fsm, PPP_STATE_6_REQ_SENT);
+      break;
+
+   default:
+      //The packet is silently discarded
+      break;
+   }
+}
+
+
+/**
+ * @brief Process Receive-Terminate-Req event
+ * @param[in] context PPP context
+ * @param[in,out] fsm Finite state machine
+ * @param[in] callbacks FSM actions
+ * @param[in] terminateReqPacket Terminate-Request packet received from the peer
+ **/
+
+void pppRcvTerminateReqEvent(PppContext *context, PppFsm *fsm,
+   const PppCallbacks *callbacks, const PppTerminatePacket *terminateReqPacket)
+{
+   //Check current state
+   switch(fsm->state)
+   {
+   case PPP_STATE_2_CLOSED:
+   case PPP_STATE_3_STOPPED:
+   case PPP_STATE_4_CLOSING:
+   case PPP_STATE_5_STOPPING:
+      //Send Terminate-Ack packet
+      callbacks->sendTerminateAck(context, terminateReqPacket);
+      break;
+
+   case PPP_STATE_6_REQ_SENT:
+   case PPP_STATE_7_ACK_RCVD:
+   case PPP_STATE_8_ACK_SENT:
+      //Send Terminate-Ack packet
+      callbacks->sendTerminateAck(context, terminateReqPacket);
+      //Switch to the Req-Sent state
+      pppChangeState(fsm, PPP_STATE_6_REQ_SENT);
+      break;
+
+   case PPP_STATE_9_OPENED:
+      //Indicate to the upper layers that the automaton is leaving the
+      //Opened state
+      callbacks->thisLayerDown(context);
+      //Zero restart counter
+      callbacks->zeroRestartCount(context);
+      //Send Terminate-Ack packet
+      callbacks->sendTerminateAck(context, terminateReqPacket);
+      //Switch to the Stopping state
+      pppChangeState(fsm, PPP_STATE_5_STOPPING);
+      break;
+
+   default:
+      //The packet is silently discarded
+      break;
+   }
+}
+
+
+/**
+ * @brief Process Receive-Terminate-Ack event
+ * @param[in] context PPP context
+ * @param[in,out] fsm Finite state machine
+ * @param[in] callbacks FSM actions
+ **/
+
+void pppRcvTerminateAckEvent(PppContext *context, PppFsm *fsm,
+   const PppCallbacks *callbacks)
+{
+   //Check current state
+   switch(fsm->state)
+   {
+   case PPP_STATE_4_CLOSING:
+      //Switch to the Closed state
+      pppChangeState(fsm, PPP_STATE_2_CLOSED);
+      //Indicate to the lower layers that the automaton is entering the
+      //Initial, Closed or Stopped states
+      callbacks->thisLayerFinished(context);
+      break;
+
+   case PPP_STATE_5_STOPPING:
+      //Switch to the Stopped state
+      pppChangeState(fsm, PPP_STATE_3_STOPPED);
+      //Indicate to the lower layers that the automaton is entering the
+      //Initial, Closed or Stopped states
+      callbacks->thisLayerFinished(context);
+      break;
+
+   case PPP_STATE_7_ACK_RCVD:
+      //Switch to the Req-Sent state
+      pppChangeState(fsm, PPP_STATE_6_REQ_SENT);
+      break;
+
+   case PPP_STATE_9_OPENED:
+      //Indicate to the upper layers that the automaton is leaving the
+      //Opened state
+      callbacks->thisLayerDown(context);
+      //Send Configure-Request packet
+      callbacks->sendConfigureReq(context);
+      //Switch to the Req-Sent state
+      pppChangeState(fsm, PPP_STATE_6_REQ_SENT);
+      break;
+
+   default:
+      //The packet is silently discarded
+      break;
+   }
+}
+
+
+/**
+ * @brief Process Receive-Unknown-Code event
+ * @param[in] context PPP context
+ * @param[in,out] fsm Finite state machine
+ * @param[in] callbacks FSM actions
+ * @param[in] packet Un-interpretable packet received from the peer
+ **/
+
+void pppRcvUnknownCodeEvent(PppContext *context, PppFsm *fsm,
+   const PppCallbacks *callbacks, const PppPacket *packet)
+{
+   //The packet is rejected in all the states where the link is up
+   if(fsm->state >= PPP_STATE_2_CLOSED)
+   {
+      //Send Code-Reject packet
+      callbacks->sendCodeRej(context, packet);
+   }
+}
+
+
+/**
+ * @brief Process Receive-Code-Reject or Receive-Protocol-Reject event
+ * @param[in] context PPP context
+ * @param[in,out] fsm Finite state machine
+ * @param[in] callbacks FSM actions
+ * @param[in] acceptable This parameter tells whether the rejected value
+ *   is acceptable (RXJ+ event) or catastrophic (RXJ- event)
+ **/
+
+void pppRcvCodeRejEvent(PppContext *context, PppFsm *fsm,
+   const PppCallbacks *callbacks, bool_t acceptable)
+{
+   //RXJ+ event?
+   if(acceptable)
+   {
+      //A crossed Configure-Request is no longer acknowledged
+      if(fsm->state == PPP_STATE_7_ACK_RCVD)
+      {
+         //Switch to the Req-Sent state
+         pppChangeState(fsm, PPP_STATE_6_REQ_SENT);
+      }
+   }
+   //RXJ- event?
+   else
+   {
+      //Check current state
+      switch(fsm->state)
+      {
+      case PPP_STATE_2_CLOSED:
+      case PPP_STATE_4_CLOSING:
+         //Switch to the Closed state
+         pppChangeState(fsm, PPP_STATE_2_CLOSED);
+         //Indicate to the lower layers that the automaton is entering the
+         //Initial, Closed or Stopped states
+         callbacks->thisLayerFinished(context);
+         break;
+
+      case PPP_STATE_3_STOPPED:
+      case PPP_STATE_5_STOPPING:
+      case PPP_STATE_6_REQ_SENT:
+      case PPP_STATE_7_ACK_RCVD:
+      case PPP_STATE_8_ACK_SENT:
+         //Switch to the Stopped state
+         pppChangeState(fsm, PPP_STATE_3_STOPPED);
+         //Indicate to the lower layers that the automaton is entering the
+         //Initial, Closed or Stopped states
+         callbacks->thisLayerFinished(context);
+         break;
+
+      case PPP_STATE_9_OPENED:
+         //Switch to the Stopping state
+         pppChangeState(fsm, PPP_STATE_5_STOPPING);
+         //Indicate to the upper layers that the automaton is leaving the
+         //Opened state
+         callbacks->thisLayerDown(context);
+         //Initialize restart counter
+         callbacks->initRestartCount(context, PPP_MAX_TERMINATE);
+         //Send Terminate-Request packet
+         callbacks->sendTerminateReq(context);
+         break;
+
+      default:
+         //The packet is silently discarded
+         break;
+      }
+   }
+}
+
+
+/**
+ * @brief Process Receive-Echo-Request event
+ * @param[in] context PPP context
+ * @param[in,out] fsm Finite state machine
+ * @param[in] callbacks FSM actions
+ * @param[in] echoReqPacket Echo-Request packet received from the peer
+ **/
+
+void pppRcvEchoReqEvent(PppContext *context, PppFsm *fsm,
+   const PppCallbacks *callbacks, const PppEchoPacket *echoReqPacket)
+{
+   //Echo-Request packets are only answered in the Opened state
+   if(fsm->state == PPP_STATE_9_OPENED)
+   {
+      //Send Echo-Reply packet
+      callbacks->sendEchoRep(context, echoReqPacket);
+   }
+}
+
+
+/**
+ * @brief Update PPP FSM state
+ * @param[in,out] fsm Finite state machine
+ * @param[in] newState New PPP state to switch to
+ **/
+
+void pppChangeState(PppFsm *fsm, PppState newState)
+{
+#if (PPP_TRACE_LEVEL >= TRACE_LEVEL_INFO)
+   //PPP FSM states
+   static const char_t *const stateLabel[] =
+   {
+      "INITIAL",  //0
+      "STARTING", //1
+      "CLOSED",   //2
+      "STOPPED",  //3
+      "CLOSING",  //4
+      "STOPPING", //5
+      "REQ_SENT", //6
+      "ACK_RCVD", //7
+      "ACK_SENT", //8
+      "OPENED"    //9
+   };
+
+   //Sanity check
+   if(fsm->state < arraysize(stateLabel) && newState < arraysize(stateLabel))
+   {
+      //Debug message
+      TRACE_INFO("PPP FSM: %s (%u) -> %s (%u)\r\n", stateLabel[fsm->state],
+         fsm->state, stateLabel[newState], newState);
+   }
+#endif
+
+   //Enter new state
+   fsm->state = newState;
+}
+
+#endif
@@ -0,0 +1,1088 @@
+/**
+ * @file ppp_hdlc.c
+ * @brief PPP HDLC driver
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * HDLC-like framing (RFC 1662) over an asynchronous serial link. Frames
+ * are stuffed into the TX ring and unstuffed from the RX ring using a
+ * 256-bit map of the characters that must be escaped, so that runs of
+ * plain data are copied in bulk. The rings can be drained and filled
+ * byte by byte from a UART interrupt, or in blocks by a DMA engine
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL NIC_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "ppp/ppp.h"
+#include "ppp/ppp_hdlc.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (PPP_SUPPORT == ENABLED)
+
+//Worst-case size of an encoded frame (every byte escaped, plus both flags)
+#define PPP_HDLC_DRIVER_MAX_ENCODED_SIZE (2 * PPP_MAX_FRAME_SIZE + 2)
+
+//Check whether a character is set in an escape map
+#define PPP_HDLC_MAP_TEST(map, c) (((map)[(c) >> 5] & (1U << ((c) & 0x1F))) != 0)
+//Add a character to an escape map
+#define PPP_HDLC_MAP_SET(map, c) ((map)[(c) >> 5] |= (1U << ((c) & 0x1F)))
+
+
+/**
+ * @brief PPP HDLC driver
+ **/
+
+const NicDriver pppHdlcDriver =
+{
+   NIC_TYPE_PPP,
+   PPP_MAX_MRU,
+   pppHdlcDriverInit,
+   pppHdlcDriverTick,
+   pppHdlcDriverEnableIrq,
+   pppHdlcDriverDisableIrq,
+   pppHdlcDriverEventHandler,
+   pppHdlcDriverSendPacket,
+   pppHdlcDriverUpdateMacAddrFilter,
+   NULL,
+   NULL,
+   NULL,
+   FALSE,
+   TRUE,
+   TRUE,
+   TRUE,
+#if (ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
+   FALSE,
+   FALSE,
+#endif
+   NULL,
+#if (ETH_VLAN_SUPPORT == ENABLED)
+   FALSE
+#endif
+};
+
+
+/**
+ * @brief Build the escape map used by the transmitter or the receiver
+ * @param[out] map 256-bit map of the characters to escape
+ * @param[in] accm Async control character map (characters 0x00 to 0x1F)
+ **/
+
+static void pppHdlcDriverBuildMap(uint32_t *map, uint32_t accm)
+{
+   //Characters 0x00 to 0x1F are escaped according to the ACCM
+   map[0] = accm;
+   map[1] = 0;
+   map[2] = 0;
+   map[3] = 0;
+   map[4] = 0;
+   map[5] = 0;
+   map[6] = 0;
+   map[7] = 0;
+
+   //The Control Escape and Flag Sequence characters are always escaped
+   PPP_HDLC_MAP_SET(map, PPP_ESC_CHAR);
+   PPP_HDLC_MAP_SET(map, PPP_FLAG_CHAR);
+}
+
+
+/**
+ * @brief Copy a block of data to the TX ring
+ *
+ * The length of the queue is not updated, so that the data becomes visible
+ * to the consumer only when the whole frame has been written
+ *
+ * @param[in] context Pointer to the PPP context
+ * @param[in,out] index Write index
+ * @param[in] data Pointer to the data to copy
+ * @param[in] length Number of bytes to copy
+ **/
+
+static void pppHdlcDriverCopyToTxRing(PppContext *context, uint_t *index,
+   const uint8_t *data, size_t length)
+{
+   size_t n;
+
+   //Number of bytes that can be written before wrapping around
+   n = MIN(length, PPP_TX_BUFFER_SIZE - *index);
+
+   //Copy the first part
+   osMemcpy(context->txBuffer + *index, data, n);
+
+   //Any remaining bytes?
+   if(n < length)
+   {
+      //Copy the second part at the beginning of the ring
+      osMemcpy(context->txBuffer, data + n, length - n);
+   }
+
+   //Advance write index
+   *index = (*index + length) % PPP_TX_BUFFER_SIZE;
+}
+
+
+/**
+ * @brief Stuff a block of data into the TX ring
+ * @param[in] context Pointer to the PPP context
+ * @param[in,out] index Write index
+ * @param[in] map 256-bit map of the characters to escape
+ * @param[in] data Pointer to the data to encode
+ * @param[in] length Number of bytes to encode
+ * @return Number of bytes written to the ring
+ **/
+
+static size_t pppHdlcDriverStuffData(PppContext *context, uint_t *index,
+   const uint32_t *map, const uint8_t *data, size_t length)
+{
+   size_t i;
+   size_t j;
+   size_t n;
+   uint8_t c;
+
+   //Number of bytes written to the ring
+   n = 0;
+
+   //Encode the data
+   for(i = 0; i < length; )
+   {
+      //Find the run of characters that do not require escaping
+      for(j = i; j < length && !PPP_HDLC_MAP_TEST(map, data[j]); j++)
+      {
+      }
+
+      //Copy the run as a whole
+      if(j > i)
+      {
+         pppHdlcDriverCopyToTxRing(context, index, data + i, j - i);
+         n += j - i;
+      }
+
+      //Special character?
+      if(j < length)
+      {
+         //Escape the character
+         context->txBuffer[*index] = PPP_ESC_CHAR;
+         *index = (*index + 1) % PPP_TX_BUFFER_SIZE;
+         c = data[j] ^ PPP_MASK_CHAR;
+         context->txBuffer[*index] = c;
+         *index = (*index + 1) % PPP_TX_BUFFER_SIZE;
+         n += 2;
+         j++;
+      }
+
+      //Next run
+      i = j;
+   }
+
+   //Return the number of bytes written
+   return n;
+}
+
+
+/**
+ * @brief PPP HDLC driver initialization
+ * @param[in] interface Underlying network interface
+ * @return Error code
+ **/
+
+error_t pppHdlcDriverInit(NetInterface *interface)
+{
+   PppContext *context;
+
+   //Debug message
+   TRACE_INFO("Initializing PPP HDLC driver...\r\n");
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //A UART driver is required
+   if(interface->uartDriver == NULL)
+      return ERROR_FAILURE;
+
+   //Initialize variables
+   context->txBufferLen = 0;
+   context->txWriteIndex = 0;
+   context->txReadIndex = 0;
+   context->rxBufferLen = 0;
+   context->rxWriteIndex = 0;
+   context->rxReadIndex = 0;
+   context->rxFrameCount = 0;
+
+   //Initialize UART
+   interface->uartDriver->init();
+
+   //Accept any packets from the upper layer
+   osSetEvent(&interface->nicTxEvent);
+
+   //Successful initialization
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief PPP HDLC driver timer handler
+ *
+ * This routine is periodically called by the TCP/IP stack to handle
+ * periodic operations such as polling the link state
+ *
+ * @param[in] interface Underlying network interface
+ **/
+
+void pppHdlcDriverTick(NetInterface *interface)
+{
+}
+
+
+/**
+ * @brief Enable interrupts
+ * @param[in] interface Underlying network interface
+ **/
+
+void pppHdlcDriverEnableIrq(NetInterface *interface)
+{
+   //Enable UART interrupts
+   interface->uartDriver->enableIrq();
+}
+
+
+/**
+ * @brief Disable interrupts
+ * @param[in] interface Underlying network interface
+ **/
+
+void pppHdlcDriverDisableIrq(NetInterface *interface)
+{
+   //Disable UART interrupts
+   interface->uartDriver->disableIrq();
+}
+
+
+/**
+ * @brief PPP HDLC driver event handler
+ * @param[in] interface Underlying network interface
+ **/
+
+void pppHdlcDriverEventHandler(NetInterface *interface)
+{
+   uint_t n;
+   error_t error;
+   PppContext *context;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //While the link is dead, the received data belongs to the AT command
+   //parser and must be left in the RX ring
+   if(context->pppPhase == PPP_PHASE_DEAD)
+      return;
+
+   //The frames drained below are delivered as a single batch
+   nicBeginRxBatch(interface);
+
+   //Process incoming frames, within the limit of the RX budget
+   for(n = 0; n < PPP_HDLC_DRIVER_RX_BUDGET; n++)
+   {
+      //Read incoming frame
+      error = pppHdlcDriverReceivePacket(interface);
+
+      //No more frames in the RX ring?
+      if(error == ERROR_BUFFER_EMPTY)
+         break;
+   }
+
+   //Notify the sockets that received data during the batch
+   nicEndRxBatch(interface);
+
+   //Frames are still pending?
+   if(context->rxFrameCount > 0)
+   {
+      //The TCP/IP stack will call the event handler again
+      interface->nicEvent = TRUE;
+      osSetEvent(&netEvent);
+   }
+}
+
+
+/**
+ * @brief Send a packet
+ * @param[in] interface Underlying network interface
+ * @param[in] buffer Multi-part buffer containing the data to send
+ * @param[in] offset Offset to the first data byte
+ * @param[in] ancillary Additional options passed to the stack along with
+ *   the packet
+ * @return Error code
+ **/
+
+error_t pppHdlcDriverSendPacket(NetInterface *interface,
+   const NetBuffer *buffer, size_t offset, NetTxAncillary *ancillary)
+{
+   uint_t i;
+   uint_t index;
+   size_t n;
+   size_t length;
+   size_t written;
+   uint16_t fcs;
+   uint32_t accm;
+   uint32_t map[8];
+   uint8_t header[4];
+   uint8_t data[2];
+   PppContext *context;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //Retrieve the length of the frame
+   length = netBufferGetLength(buffer) - offset;
+
+   //Check the frame length
+   if(length > (PPP_FRAME_HEADER_SIZE + (size_t) context->peerConfig.mru))
+   {
+      //The transmitter can accept another packet
+      osSetEvent(&interface->nicTxEvent);
+      //Report an error
+      return ERROR_INVALID_LENGTH;
+   }
+
+   //Make sure the TX ring can hold the encoded frame
+   if((PPP_TX_BUFFER_SIZE - context->txBufferLen) < PPP_HDLC_DRIVER_MAX_ENCODED_SIZE)
+      return ERROR_BUFFER_OVERFLOW;
+
+   //Compute the FCS over the address, control, protocol and information
+   //fields
+   fcs = pppCalcFcsEx(buffer, offset, length);
+   //The FCS is transmitted least significant octet first
+   fcs ^= 0xFFFF;
+   data[0] = fcs & 0xFF;
+   data[1] = (fcs >> 8) & 0xFF;
+
+   //Retrieve the first bytes of the frame
+   n = netBufferRead(header, buffer, offset, sizeof(header));
+
+   //LCP Configure-Request, Configure-Ack, Configure-Nak, Configure-Reject,
+   //Terminate-Request, Terminate-Ack, Code-Reject and Protocol-Reject are
+   //always sent with the default ACCM
+   if(n == sizeof(header) && header[0] == 0xFF && header[1] == 0x03 &&
+      header[2] == 0xC0 && header[3] == 0x21)
+   {
+      accm = PPP_DEFAULT_ACCM;
+   }
+   else
+   {
+      accm = context->peerConfig.accm;
+   }
+
+   //Build the 256-bit map of the characters to escape
+   pppHdlcDriverBuildMap(map, accm);
+
+   //Point to the tail of the TX ring
+   index = context->txWriteIndex;
+   written = 0;
+
+   //The opening flag may be omitted when frames are sent back to back
+   if(context->txBufferLen == 0)
+   {
+      context->txBuffer[index] = PPP_FLAG_CHAR;
+      index = (index + 1) % PPP_TX_BUFFER_SIZE;
+      written++;
+   }
+
+   //Encode the frame, one chunk at a time
+   for(i = 0; i < buffer->chunkCount && length > 0; i++)
+   {
+      //Skip the chunks that precede the frame
+      if(offset >= buffer->chunk[i].length)
+      {
+         offset -= buffer->chunk[i].length;
+         continue;
+      }
+
+      //Number of bytes to encode in the current chunk
+      n = MIN(buffer->chunk[i].length - offset, length);
+
+      //Stuff the data
+      written += pppHdlcDriverStuffData(context, &index, map,
+         (uint8_t *) buffer->chunk[i].address + offset, n);
+
+      //Process the next chunk
+      length -= n;
+      offset = 0;
+   }
+
+   //Append the FCS
+   written += pppHdlcDriverStuffData(context, &index, map, data, 2);
+
+   //Append the closing flag
+   context->txBuffer[index] = PPP_FLAG_CHAR;
+   index = (index + 1) % PPP_TX_BUFFER_SIZE;
+   written++;
+
+   //Save the new tail of the TX ring
+   context->txWriteIndex = index;
+
+   //The encoded frame becomes visible to the consumer as a whole
+   interface->uartDriver->disableIrq();
+   context->txBufferLen += written;
+
+   //Check whether the TX ring can accept another frame
+   if((PPP_TX_BUFFER_SIZE - context->txBufferLen) >= PPP_HDLC_DRIVER_MAX_ENCODED_SIZE)
+   {
+      //The transmitter can accept another packet
+      osSetEvent(&interface->nicTxEvent);
+   }
+
+   interface->uartDriver->enableIrq();
+
+   //Start transferring data
+   interface->uartDriver->startTx();
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Receive a packet
+ * @param[in] interface Underlying network interface
+ * @return Error code
+ **/
+
+error_t pppHdlcDriverReceivePacket(NetInterface *interface)
+{
+   size_t i;
+   size_t j;
+   size_t k;
+   size_t n;
+   size_t length;
+   size_t consumed;
+   uint_t index;
+   uint8_t c;
+   bool_t escape;
+   bool_t discard;
+   bool_t complete;
+   uint32_t accm;
+   uint32_t map[8];
+   const uint8_t *p;
+   PppContext *context;
+   NetRxAncillary ancillary;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //Check whether a complete frame has been received
+   if(context->rxFrameCount == 0)
+      return ERROR_BUFFER_EMPTY;
+
+   //The negotiated ACCM only applies once LCP has reached the Opened state
+   if(context->lcpFsm.state == PPP_STATE_9_OPENED)
+   {
+      accm = context->localConfig.accm;
+   }
+   else
+   {
+      accm = PPP_DEFAULT_ACCM;
+   }
+
+   //Control characters from the ACCM inserted by the DCE are discarded
+   pppHdlcDriverBuildMap(map, accm);
+
+   //The producer only appends data, hence a snapshot of the length is safe
+   length = context->rxBufferLen;
+   index = context->rxReadIndex;
+
+   //Initialize variables
+   n = 0;
+   consumed = 0;
+   escape = FALSE;
+   discard = FALSE;
+   complete = FALSE;
+
+   //Decode the frame, up to the closing flag
+   while(consumed < length && !complete)
+   {
+      //Contiguous data available before wrapping around
+      p = context->rxBuffer + index;
+      k = MIN(length - consumed, PPP_RX_BUFFER_SIZE - index);
+
+      //Process the contiguous block
+      for(i = 0; i < k && !complete; )
+      {
+         //Get current character
+         c = p[i];
+
+         //Flag Sequence?
+         if(c == PPP_FLAG_CHAR)
+         {
+            //A Control Escape followed by a Flag Sequence aborts the frame
+            if(escape)
+            {
+               discard = TRUE;
+            }
+
+            //End of frame
+            complete = TRUE;
+            i++;
+         }
+         //Control Escape?
+         else if(c == PPP_ESC_CHAR)
+         {
+            //The next character is complemented
+            escape = TRUE;
+            i++;
+         }
+         //Control character inserted by the DCE?
+         else if(PPP_HDLC_MAP_TEST(map, c))
+         {
+            //Discard the character
+            i++;
+         }
+         //Escaped character?
+         else if(escape)
+         {
+            //Check the length of the frame
+            if(n < PPP_MAX_FRAME_SIZE)
+            {
+               context->frame[n++] = c ^ PPP_MASK_CHAR;
+            }
+            else
+            {
+               discard = TRUE;
+            }
+
+            //Clear flag
+            escape = FALSE;
+            i++;
+         }
+         else
+         {
+            //Find the run of characters that do not require unescaping
+            for(j = i + 1; j < k && !PPP_HDLC_MAP_TEST(map, p[j]); j++)
+            {
+            }
+
+            //Check the length of the frame
+            if((n + j - i) <= PPP_MAX_FRAME_SIZE)
+            {
+               //Copy the run as a whole
+               osMemcpy(context->frame + n, p + i, j - i);
+               n += j - i;
+            }
+            else
+            {
+               discard = TRUE;
+            }
+
+            //Next run
+            i = j;
+         }
+      }
+
+      //Advance read index
+      consumed += i;
+      index = (index + i) % PPP_RX_BUFFER_SIZE;
+   }
+
+   //The frame counter and the ring contents are out of sync?
+   if(!complete)
+   {
+      //Purge the RX ring
+      pppHdlcDriverPurgeRxBuffer(context);
+      //Report an error
+      return ERROR_BUFFER_EMPTY;
+   }
+
+   //Release the consumed data
+   context->rxReadIndex = index;
+
+   interface->uartDriver->disableIrq();
+   context->rxBufferLen -= consumed;
+   context->rxFrameCount--;
+   interface->uartDriver->enableIrq();
+
+   //Empty frames (consecutive flags) and aborted frames are ignored
+   if(n > 0 && !discard)
+   {
+      //Additional options can be passed to the stack along with the packet
+      ancillary = NET_DEFAULT_RX_ANCILLARY;
+
+      //Pass the packet to the upper layer
+      nicProcessPacket(interface, context->frame, n, &ancillary);
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Configure MAC address filtering
+ * @param[in] interface Underlying network interface
+ * @return Error code
+ **/
+
+error_t pppHdlcDriverUpdateMacAddrFilter(NetInterface *interface)
+{
+   //Not implemented
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Send AT command
+ * @param[in] interface Underlying network interface
+ * @param[in] data NULL-terminated string that contains the AT command to be sent
+ * @return Error code
+ **/
+
+error_t pppHdlcDriverSendAtCommand(NetInterface *interface, const char_t *data)
+{
+   size_t length;
+   uint_t index;
+   PppContext *context;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //Retrieve the length of the AT command
+   length = osStrlen(data);
+
+   //Make sure the TX ring can hold the command
+   if(length > (PPP_TX_BUFFER_SIZE - context->txBufferLen))
+      return ERROR_BUFFER_OVERFLOW;
+
+   //Copy the command to the TX ring
+   index = context->txWriteIndex;
+   pppHdlcDriverCopyToTxRing(context, &index, (const uint8_t *) data, length);
+   context->txWriteIndex = index;
+
+   //The command becomes visible to the consumer as a whole
+   interface->uartDriver->disableIrq();
+   context->txBufferLen += length;
+   interface->uartDriver->enableIrq();
+
+   //Start transferring data
+   interface->uartDriver->startTx();
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Wait for an incoming AT command
+ * @param[in] interface Underlying network interface
+ * @param[out] data Buffer where to store the incoming AT command
+ * @param[in] size Size of the buffer, in bytes
+ * @return Error code
+ **/
+
+error_t pppHdlcDriverReceiveAtCommand(NetInterface *interface, char_t *data,
+   size_t size)
+{
+   size_t i;
+   size_t n;
+   size_t length;
+   size_t consumed;
+   uint_t flags;
+   uint8_t c;
+   bool_t found;
+   PppContext *context;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //The producer only appends data, hence a snapshot of the length is safe
+   length = context->rxBufferLen;
+
+   //Skip the line terminators left by the previous response
+   for(i = 0; i < length; i++)
+   {
+      c = context->rxBuffer[(context->rxReadIndex + i) % PPP_RX_BUFFER_SIZE];
+
+      if(c != '\r' && c != '\n')
+         break;
+   }
+
+   //Only the line terminators can be released if no line is complete
+   consumed = i;
+
+   //Initialize variables
+   n = 0;
+   flags = 0;
+   found = FALSE;
+
+   //Extract a complete line
+   for(; i < length && !found; i++)
+   {
+      c = context->rxBuffer[(context->rxReadIndex + i) % PPP_RX_BUFFER_SIZE];
+
+      //End of line?
+      if(c == '\r' || c == '\n')
+      {
+         found = TRUE;
+      }
+      else
+      {
+         //Flag characters were counted as frame delimiters
+         if(c == PPP_FLAG_CHAR)
+         {
+            flags++;
+         }
+
+         //Save the character, truncating the line if necessary
+         if(n < (size - 1))
+         {
+            data[n++] = c;
+         }
+      }
+   }
+
+   //Properly terminate the string with a NULL character
+   data[n] = '\0';
+
+   //Complete line?
+   if(found)
+   {
+      consumed = i;
+   }
+   else if(length >= PPP_RX_BUFFER_SIZE)
+   {
+      //The RX ring is full of garbage
+      pppHdlcDriverPurgeRxBuffer(context);
+      return ERROR_BUFFER_EMPTY;
+   }
+   else
+   {
+      //The flags have not been consumed
+      flags = 0;
+   }
+
+   //Release the consumed data
+   context->rxReadIndex = (context->rxReadIndex + consumed) % PPP_RX_BUFFER_SIZE;
+
+   interface->uartDriver->disableIrq();
+   context->rxBufferLen -= consumed;
+   context->rxFrameCount -= MIN(flags, context->rxFrameCount);
+   interface->uartDriver->enableIrq();
+
+   //Return status code
+   return found ? NO_ERROR : ERROR_BUFFER_EMPTY;
+}
+
+
+/**
+ * @brief Purge TX buffer
+ * @param[in] context Pointer to the PPP context
+ * @return Error code
+ **/
+
+error_t pppHdlcDriverPurgeTxBuffer(PppContext *context)
+{
+   //Enter critical section
+   context->interface->uartDriver->disableIrq();
+
+   //Purge TX buffer
+   context->txBufferLen = 0;
+   context->txWriteIndex = 0;
+   context->txReadIndex = 0;
+
+   //Exit critical section
+   context->interface->uartDriver->enableIrq();
+
+   //Successful operation
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Purge RX buffer
+ * @param[in] context Pointer to the PPP context
+ * @return Error code
+ **/
+
+error_t pppHdlcDriverPurgeRxBuffer(PppContext *context)
+{
+   //Enter critical section
+   context->interface->uartDriver->disableIrq();
+
+   //Purge RX buffer
+   context->rxBufferLen = 0;
+   context->rxWriteIndex = 0;
+   context->rxReadIndex = 0;
+   context->rxFrameCount = 0;
+
+   //Exit critical section
+   context->interface->uartDriver->enableIrq();
+
+   //Successful operation
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Write TX queue
+ * @param[in] context Pointer to the PPP context
+ * @param[in] c Character to be written
+ **/
+
+void pppHdlcDriverWriteTxQueue(PppContext *context, uint8_t c)
+{
+   //Enough space in the TX queue?
+   if(context->txBufferLen < PPP_TX_BUFFER_SIZE)
+   {
+      //Copy the character to the TX queue
+      context->txBuffer[context->txWriteIndex] = c;
+      context->txWriteIndex = (context->txWriteIndex + 1) % PPP_TX_BUFFER_SIZE;
+
+      //Update the length of the queue
+      context->interface->uartDriver->disableIrq();
+      context->txBufferLen++;
+      context->interface->uartDriver->enableIrq();
+   }
+}
+
+
+/**
+ * @brief Read RX queue
+ * @param[in] context Pointer to the PPP context
+ * @return Character read from the RX queue
+ **/
+
+uint8_t pppHdlcDriverReadRxQueue(PppContext *context)
+{
+   uint8_t c;
+
+   //Read a single character
+   c = context->rxBuffer[context->rxReadIndex];
+   context->rxReadIndex = (context->rxReadIndex + 1) % PPP_RX_BUFFER_SIZE;
+
+   //Update the length of the queue
+   context->interface->uartDriver->disableIrq();
+   context->rxBufferLen--;
+   context->interface->uartDriver->enableIrq();
+
+   //Return the character that has been read
+   return c;
+}
+
+
+/**
+ * @brief Read TX queue
+ *
+ * This function is intended to be called from the TX interrupt handler
+ *
+ * @param[in] interface Underlying network interface
+ * @param[out] c Character read from the TX queue (EOF if the queue is empty)
+ * @return TRUE if a context switch is required
+ **/
+
+bool_t pppHdlcDriverReadTxQueue(NetInterface *interface, int_t *c)
+{
+   PppContext *context;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //Any data pending in the TX queue?
+   if(context->txBufferLen > 0)
+   {
+      //Read a single character
+      *c = context->txBuffer[context->txReadIndex];
+   }
+   else
+   {
+      //The TX queue is empty
+      *c = EOF;
+   }
+
+   //Release the character and signal the stack when space frees up
+   return pppHdlcDriverConsumeTxQueue(interface, (*c != EOF) ? 1 : 0);
+}
+
+
+/**
+ * @brief Get the contiguous data pending in the TX queue
+ *
+ * This function is intended to be called from interrupt context, before
+ * starting a DMA transfer directly from the TX queue
+ *
+ * @param[in] interface Underlying network interface
+ * @param[out] data Pointer to the first pending byte
+ * @return Number of contiguous bytes that can be transferred
+ **/
+
+size_t pppHdlcDriverPeekTxQueue(NetInterface *interface, const uint8_t **data)
+{
+   PppContext *context;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //Point to the head of the TX queue
+   *data = context->txBuffer + context->txReadIndex;
+
+   //The transfer stops at the end of the ring
+   return MIN(context->txBufferLen, PPP_TX_BUFFER_SIZE - context->txReadIndex);
+}
+
+
+/**
+ * @brief Release data that has been transmitted
+ *
+ * This function is intended to be called from interrupt context
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] length Number of bytes to release
+ * @return TRUE if a context switch is required
+ **/
+
+bool_t pppHdlcDriverConsumeTxQueue(NetInterface *interface, size_t length)
+{
+   bool_t flag;
+   bool_t full;
+   PppContext *context;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //This flag will be set if a higher priority task must be woken
+   flag = FALSE;
+
+   //Sanity check
+   length = MIN(length, context->txBufferLen);
+
+   //Check whether the TX queue was unable to accept another frame
+   full = (PPP_TX_BUFFER_SIZE - context->txBufferLen) < PPP_HDLC_DRIVER_MAX_ENCODED_SIZE;
+
+   //Release the data
+   context->txReadIndex = (context->txReadIndex + length) % PPP_TX_BUFFER_SIZE;
+   context->txBufferLen -= length;
+
+   //Enough space for a worst-case frame has just been freed?
+   if(full && (PPP_TX_BUFFER_SIZE - context->txBufferLen) >=
+      PPP_HDLC_DRIVER_MAX_ENCODED_SIZE)
+   {
+      //Notify the TCP/IP stack that the transmitter is ready to send
+      flag |= osSetEventFromIsr(&interface->nicTxEvent);
+
+      //Packets may have been queued in the meantime
+      interface->nicEvent = TRUE;
+      flag |= osSetEventFromIsr(&netEvent);
+   }
+
+   //The return value tells whether a context switch is required
+   return flag;
+}
+
+
+/**
+ * @brief Write RX queue
+ *
+ * This function is intended to be called from the RX interrupt handler
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] c Character to be written
+ * @return TRUE if a context switch is required
+ **/
+
+bool_t pppHdlcDriverWriteRxQueue(NetInterface *interface, uint8_t c)
+{
+   //Append the character to the RX queue
+   return pppHdlcDriverWriteRxQueueEx(interface, &c, 1);
+}
+
+
+/**
+ * @brief Write a block of data to the RX queue
+ *
+ * This function is intended to be called from interrupt context. The data
+ * that does not fit in the RX queue is dropped
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] data Pointer to the received data
+ * @param[in] length Number of bytes received
+ * @return TRUE if a context switch is required
+ **/
+
+bool_t pppHdlcDriverWriteRxQueueEx(NetInterface *interface, const uint8_t *data,
+   size_t length)
+{
+   size_t n;
+   uint_t flags;
+   bool_t flag;
+   const uint8_t *p;
+   const uint8_t *end;
+   PppContext *context;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //This flag will be set if a higher priority task must be woken
+   flag = FALSE;
+
+   //Drop the data that does not fit in the RX queue
+   length = MIN(length, PPP_RX_BUFFER_SIZE - context->rxBufferLen);
+
+   //Count the flags, each of them terminates a frame
+   for(flags = 0, p = data, end = data + length; p < end; p++, flags++)
+   {
+      p = osMemchr(p, PPP_FLAG_CHAR, end - p);
+
+      if(p == NULL)
+         break;
+   }
+
+   //Number of bytes that can be written before wrapping around
+   n = MIN(length, PPP_RX_BUFFER_SIZE - context->rxWriteIndex);
+
+   //Copy the data to the RX queue
+   osMemcpy(context->rxBuffer + context->rxWriteIndex, data, n);
+   osMemcpy(context->rxBuffer, data + n, length - n);
+
+   //Update the RX queue
+   context->rxWriteIndex = (context->rxWriteIndex + length) % PPP_RX_BUFFER_SIZE;
+   context->rxBufferLen += length;
+
+   //Complete frames available?
+   if(flags > 0)
+   {
+      //Update frame counter
+      context->rxFrameCount += flags;
+
+      //Notify the TCP/IP stack that a new frame has been received
+      interface->nicEvent = TRUE;
+      flag = osSetEventFromIsr(&netEvent);
+   }
+
+   //The return value tells whether a context switch is required
+   return flag;
+}
+
+#endif
@@ -34,6 +34,13 @@
 //Dependencies
 #include "core/nic.h"
 
+//Maximum number of frames processed per call to the event handler
+#ifndef PPP_HDLC_DRIVER_RX_BUDGET
+   #define PPP_HDLC_DRIVER_RX_BUDGET 8
+#elif (PPP_HDLC_DRIVER_RX_BUDGET < 1)
+   #error PPP_HDLC_DRIVER_RX_BUDGET parameter is not valid
+#endif
+
 //C++ guard
 #ifdef __cplusplus
 extern "C" {
@@ -72,6 +79,12 @@ uint8_t pppHdlcDriverReadRxQueue(PppContext *context);
 bool_t pppHdlcDriverReadTxQueue(NetInterface *interface, int_t *c);
 bool_t pppHdlcDriverWriteRxQueue(NetInterface *interface, uint8_t c);
 
+size_t pppHdlcDriverPeekTxQueue(NetInterface *interface, const uint8_t **data);
+bool_t pppHdlcDriverConsumeTxQueue(NetInterface *interface, size_t length);
+
+bool_t pppHdlcDriverWriteRxQueueEx(NetInterface *interface, const uint8_t *data,
+   size_t length);
+
 //C++ guard
 #ifdef __cplusplus
 }
@@ -0,0 +1,510 @@
+/**
+ * @file ppp_misc.c
+ * @brief PPP miscellaneous functions
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2025 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 2.5.2
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL PPP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "ppp/ppp_misc.h"
+#include "ppp/ppp_debug.h"
+#include "ppp/lcp.h"
+#include "ppp/ipcp.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (PPP_SUPPORT == ENABLED)
+
+
+/**
+ * @brief Send Configure-Ack, Nak or Reject packet
+ *
+ * The options of the Configure-Request are parsed once more, and each
+ * parser appends to the reply the options that match the type of the
+ * reply (acknowledged, negotiated or unrecognized options)
+ *
+ * @param[in] context PPP context
+ * @param[in] configureReqPacket Incoming Configure-Request packet
+ * @param[in] protocol Protocol field
+ * @param[in] code Code field
+ * @return Error code
+ **/
+
+error_t pppSendConfigureAckNak(PppContext *context,
+   const PppConfigurePacket *configureReqPacket, PppProtocol protocol, PppCode code)
+{
+   error_t error;
+   size_t n;
+   size_t length;
+   size_t offset;
+   NetBuffer *buffer;
+   PppConfigurePacket *packet;
+   PppOption *option;
+
+   //Initialize status code
+   error = NO_ERROR;
+   //Retrieve the length of the Configure-Request packet
+   length = ntohs(configureReqPacket->length);
+
+   //The reply never grows beyond the request, except for suggested values
+   n = MAX(length, PPP_MAX_CONF_REQ_SIZE);
+
+   //Allocate a buffer memory to hold the reply
+   buffer = pppAllocBuffer(n, &offset);
+   //Failed to allocate memory?
+   if(buffer == NULL)
+      return ERROR_OUT_OF_MEMORY;
+
+   //Point to the Configure-Ack, Nak or Reject packet
+   packet = netBufferAt(buffer, offset, n);
+
+   //Valid pointer?
+   if(packet != NULL)
+   {
+      //Format packet header
+      packet->code = code;
+      packet->identifier = configureReqPacket->identifier;
+      packet->length = sizeof(PppConfigurePacket);
+
+      //Retrieve the length of the option list
+      length -= sizeof(PppConfigurePacket);
+      //Point to the first option
+      option = (PppOption *) configureReqPacket->options;
+
+      //Parse configuration options (the list has already been checked)
+      while(length > 0)
+      {
+#if (IPV4_SUPPORT == ENABLED)
+         //IPCP protocol?
+         if(protocol == PPP_PROTOCOL_IPCP)
+         {
+            //Parse current IPCP option
+            ipcpParseOption(context, option, length, packet);
+         }
+         else
+#endif
+         //LCP protocol?
+         if(protocol == PPP_PROTOCOL_LCP)
+         {
+            //Parse current LCP option
+            lcpParseOption(context, option, length, packet);
+         }
+         else
+         {
+            //Unknown protocol
+         }
+
+         //Remaining bytes to process
+         length -= option->length;
+         //Jump to the next option
+         option = (PppOption *) ((uint8_t *) option + option->length);
+      }
+
+      //Retrieve the actual length of the reply
+      n = packet->length;
+      //Convert length field to network byte order
+      packet->length = htons(n);
+
+      //Adjust the length of the multi-part buffer
+      netBufferSetLength(buffer, offset + n);
+
+      //Debug message
+      if(code == PPP_CODE_CONFIGURE_ACK)
+      {
+         TRACE_INFO("Sending Configure-Ack packet (%" PRIuSIZE " bytes)...\r\n", n);
+      }
+      else if(code == PPP_CODE_CONFIGURE_NAK)
+      {
+         TRACE_INFO("Sending Configure-Nak packet (%" PRIuSIZE " bytes)...\r\n", n);
+      }
+      else
+      {
+         TRACE_INFO("Sending Configure-Reject packet (%" PRIuSIZE " bytes)...\r\n", n);
+      }
+
+      //Dump packet contents for debugging purpose
+      pppDumpPacket((PppPacket *) packet, n, protocol);
+
+      //Send PPP frame
+      error = pppSendFrame(context->interface, buffer, offset, protocol);
+   }
+   else
+   {
+      //Report an error
+      error = ERROR_FAILURE;
+   }
+
+   //Free previously allocated memory block
+   netBufferFree(buffer);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Send Terminate-Request or Terminate-Ack packet
+ * @param[in] context PPP context
+ * @param[in] code Code field
+ * @param[in] identifier Identifier field
+ * @param[in] protocol Protocol field
+ * @return Error code
+ **/
+
+static error_t pppSendTerminatePacket(PppContext *context, PppCode code,
+   uint8_t identifier, PppProtocol protocol)
+{
+   error_t error;
+   size_t length;
+   size_t offset;
+   NetBuffer *buffer;
+   PppTerminatePacket *packet;
+
+   //Length of the Terminate-Request or Terminate-Ack packet
+   length = sizeof(PppTerminatePacket);
+
+   //Allocate a buffer memory to hold the packet
+   buffer = pppAllocBuffer(length, &offset);
+   //Failed to allocate memory?
+   if(buffer == NULL)
+      return ERROR_OUT_OF_MEMORY;
+
+   //Point to the Terminate-Request or Terminate-Ack packet
+   packet = netBufferAt(buffer, offset, length);
+
+   //Valid pointer?
+   if(packet != NULL)
+   {
+      //Format packet header
+      packet->code = code;
+      packet->identifier = identifier;
+      packet->length = htons(length);
+
+      //Debug message
+      if(code == PPP_CODE_TERMINATE_REQ)
+      {
+         TRACE_INFO("Sending Terminate-Request packet (%" PRIuSIZE " bytes)...\r\n", length);
+      }
+      else
+      {
+         TRACE_INFO("Sending Terminate-Ack packet (%" PRIuSIZE " bytes)...\r\n", length);
+      }
+
+      //Dump packet contents for debugging purpose
+      pppDumpPacket((PppPacket *) packet, length, protocol);
+
+      //Send PPP frame
+      error = pppSendFrame(context->interface, buffer, offset, protocol);
+   }
+   else
+   {
+      //Report an error
+      error = ERROR_FAILURE;
+   }
+
+   //Free previously allocated memory block
+   netBufferFree(buffer);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Send Terminate-Request packet
+ * @param[in] context PPP context
+ * @param[in] identifier Identifier field
+ * @param[in] protocol Protocol field
+ * @return Error code
+ **/
+
+error_t pppSendTerminateReq(PppContext *context,
+   uint8_t identifier, PppProtocol protocol)
+{
+   //Send Terminate-Request packet
+   return pppSendTerminatePacket(context, PPP_CODE_TERMINATE_REQ, identifier,
+      protocol);
+}
+
+
+/**
+ * @brief Send Terminate-Ack packet
+ * @param[in] context PPP context
+ * @param[in] identifier Identifier field
+ * @param[in] protocol Protocol field
+ * @return Error code
+ **/
+
+error_t pppSendTerminateAck(PppContext *context,
+   uint8_t identifier, PppProtocol protocol)
+{
+   //Send Terminate-Ack packet
+   return pppSendTerminatePacket(context, PPP_CODE_TERMINATE_ACK, identifier,
+      protocol);
+}
+
+
+/**
+ * @brief Send Code-Reject packet
+ * @param[in] context PPP context
+ * @param[in] packet Un-interpretable packet received from the peer
+ * @param[in] identifier Identifier field
+ * @param[in] protocol Protocol field
+ * @return Error code
+ **/
+
+error_t pppSendCodeRej(PppContext *context, const PppPacket *packet,
+   uint8_t identifier, PppProtocol protocol)
+{
+   error_t error;
+   size_t length;
+   size_t offset;
+   NetBuffer *buffer;
+   PppCodeRejPacket *codeRejPacket;
+
+   //Retrieve the length of the rejected packet
+   length = ntohs(packet->length);
+
+   //The rejected packet must be truncated to comply with the peer's MRU
+   length = MIN(length, context->peerConfig.mru - sizeof(PppCodeRejPacket));
+   //Total length of the Code-Reject packet
+   length += sizeof(PppCodeRejPacket);
+
+   //Allocate a buffer memory to hold the packet
+   buffer = pppAllocBuffer(length, &offset);
+   //Failed to allocate memory?
+   if(buffer == NULL)
+      return ERROR_OUT_OF_MEMORY;
+
+   //Point to the Code-Reject packet
+   codeRejPacket = netBufferAt(buffer, offset, length);
+
+   //Valid pointer?
+   if(codeRejPacket != NULL)
+   {
+      //Format packet header
+      codeRejPacket->code = PPP_CODE_CODE_REJ;
+      codeRejPacket->identifier = identifier;
+      codeRejPacket->length = htons(length);
+
+      //The Rejected-Packet field contains a copy of the packet being rejected
+      osMemcpy(codeRejPacket->rejectedPacket, packet,
+         length - sizeof(PppCodeRejPacket));
+
+      //Debug message
+      TRACE_INFO("Sending Code-Reject packet (%" PRIuSIZE " bytes)...\r\n", length);
+
+      //Send PPP frame
+      error = pppSendFrame(context->interface, buffer, offset, protocol);
+   }
+   else
+   {
+      //Report an error
+      error = ERROR_FAILURE;
+   }
+
+   //Free previously allocated memory block
+   netBufferFree(buffer);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Send Protocol-Reject packet
+ * @param[in] context PPP context
+ * @param[in] identifier Identifier field
+ * @param[in] protocol Rejected protocol
+ * @param[in] information Rejected information
+ * @param[in] length Length of the rejected information
+ * @return Error code
+ **/
+
+error_t pppSendProtocolRej(PppContext *context, uint8_t identifier,
+   uint16_t protocol, const uint8_t *information, size_t length)
+{
+   error_t error;
+   size_t offset;
+   NetBuffer *buffer;
+   PppProtocolRejPacket *protocolRejPacket;
+
+   //The rejected information must be truncated to comply with the peer's MRU
+   length = MIN(length, context->peerConfig.mru - sizeof(PppProtocolRejPacket));
+   //Total length of the Protocol-Reject packet
+   length += sizeof(PppProtocolRejPacket);
+
+   //Allocate a buffer memory to hold the packet
+   buffer = pppAllocBuffer(length, &offset);
+   //Failed to allocate memory?
+   if(buffer == NULL)
+      return ERROR_OUT_OF_MEMORY;
+
+   //Point to the Protocol-Reject packet
+   protocolRejPacket = netBufferAt(buffer, offset, length);
+
+   //Valid pointer?
+   if(protocolRejPacket != NULL)
+   {
+      //Format packet header
+      protocolRejPacket->code = PPP_CODE_PROTOCOL_REJ;
+      protocolRejPacket->identifier = identifier;
+      protocolRejPacket->length = htons(length);
+      protocolRejPacket->rejectedProtocol = htons(protocol);
+
+      //The Rejected-Information field contains a copy of the packet which
+      //is being rejected
+      osMemcpy(protocolRejPacket->rejectedInfo, information,
+         length - sizeof(PppProtocolRejPacket));
+
+      //Debug message
+      TRACE_INFO("Sending Protocol-Reject packet (%" PRIuSIZE " bytes)...\r\n", length);
+
+      //Send PPP frame
+      error = pppSendFrame(context->interface, buffer, offset, PPP_PROTOCOL_LCP);
+   }
+   else
+   {
+      //Report an error
+      error = ERROR_FAILURE;
+   }
+
+   //Free previously allocated memory block
+   netBufferFree(buffer);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Send Echo-Reply packet
+ * @param[in] context PPP context
+ * @param[in] echoReqPacket Echo-Request packet received from the peer
+ * @param[in] protocol Protocol field
+ * @return Error code
+ **/
+
+error_t pppSendEchoRep(PppContext *context,
+   const PppEchoPacket *echoReqPacket, PppProtocol protocol)
+{
+   error_t error;
+   size_t length;
+   size_t offset;
+   NetBuffer *buffer;
+   PppEchoPacket *echoRepPacket;
+
+   //Retrieve the length of the Echo-Request packet
+   length = ntohs(echoReqPacket->length);
+
+   //The Data field is truncated to comply with the peer's MRU
+   length = MIN(length, context->peerConfig.mru);
+
+   //Allocate a buffer memory to hold the packet
+   buffer = pppAllocBuffer(length, &offset);
+   //Failed to allocate memory?
+   if(buffer == NULL)
+      return ERROR_OUT_OF_MEMORY;
+
+   //Point to the Echo-Reply packet
+   echoRepPacket = netBufferAt(buffer, offset, length);
+
+   //Valid pointer?
+   if(echoRepPacket != NULL)
+   {
+      //Format packet header
+      echoRepPacket->code = PPP_CODE_ECHO_REP;
+      echoRepPacket->identifier = echoReqPacket->identifier;
+      echoRepPacket->length = htons(length);
+      echoRepPacket->magicNumber = htonl(context->localConfig.magicNumber);
+
+      //The data field of the Echo-Request is copied into the Echo-Reply
+      osMemcpy(echoRepPacket->data, echoReqPacket->data,
+         length - sizeof(PppEchoPacket));
+
+      //Debug message
+      TRACE_INFO("Sending Echo-Reply packet (%" PRIuSIZE " bytes)...\r\n", length);
+
+      //Send PPP frame
+      error = pppSendFrame(context->interface, buffer, offset, protocol);
+   }
+   else
+   {
+      //Report an error
+      error = ERROR_FAILURE;
+   }
+
+   //Free previously allocated memory block
+   netBufferFree(buffer);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Add an option to a Configure packet
+ *
+ * The length field of the packet is kept in host byte order while the
+ * packet is being built
+ *
+ * @param[in,out] packet Pointer to the Configure packet
+ * @param[in] optionType Option type
+ * @param[in] optionValue Option value
+ * @param[in] optionLen Length of the option value
+ * @return Error code
+ **/
+
+error_t pppAddOption(PppConfigurePacket *packet, uint8_t optionType,
+   const void *optionValue, uint8_t optionLen)
+{
+   PppOption *option;
+
+   //Make sure the length is valid
+   if(optionLen > (UINT8_MAX - sizeof(PppOption)))
+      return ERROR_INVALID_LENGTH;
+
+   //Point to the end of the Configure packet
+   option = (PppOption *) ((uint8_t *) packet + packet->length);
+
+   //Write specified option at current location
+   option->type = optionType;
+   option->length = optionLen + sizeof(PppOption);
+   //Copy option data
+   osMemcpy(option->data, optionValue, optionLen);
+
+   //Update the length of the Configure packet
+   packet->length += optionLen + sizeof(PppOption);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+#endif
@@ -194,6 +194,15 @@
 #include <stddef.h>
 #include <stdint.h>
 
+/// The build configuration header (see udpard.c) may also size the public structures, so it is included here too.
+/// This firmware keeps its configuration in Core/Inc/udpard_config.h, used unless the build names another header.
+#ifndef UDPARD_CONFIG_HEADER
+#    define UDPARD_CONFIG_HEADER "udpard_config.h"
+#endif
+#ifdef UDPARD_CONFIG_HEADER
+#    include UDPARD_CONFIG_HEADER
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -242,6 +251,33 @@ extern "C" {
 /// The library supports at most this many redundant network interfaces per Cyphal node.
 #define UDPARD_NETWORK_INTERFACE_COUNT_MAX 3U
 
+/// Sessions of remote nodes whose node-ID is below this value are also indexed directly by node-ID in each RX port,
+/// so that finding the session of a frame takes one memory access instead of a walk down the session tree.
+/// Each port grows by this many pointers. Zero disables the table; only the session tree is used then.
+/// Networks that use a small node-ID space (e.g., 0..127) may set this to match it.
+#ifndef UDPARD_RX_SESSION_TABLE_SIZE
+#    define UDPARD_RX_SESSION_TABLE_SIZE 0U
+#endif
+
+/// If nonzero, each TX queue keeps one FIFO per priority level and a bitmap of the non-empty levels instead of
+/// the AVL tree, so that udpardTxPublish/Request/Respond, udpardTxPeek, and udpardTxPop take constant time per frame.
+/// The transmission order is the same: by priority, then in the order of enqueueing.
+/// The API is unchanged; only the internal fields of UdpardTx differ.
+#ifndef UDPARD_TX_PRIORITY_FIFO
+#    define UDPARD_TX_PRIORITY_FIFO 0U
+#endif
+
+/// If nonzero, RX ports account for the fragments they hold in transfers being reassembled and enforce quotas on them:
+/// this value is the default per-port quota (UdpardRxPort.fragment_quota), and ports may also share a global quota
+/// (UdpardRxPort.shared_quota). When a new fragment would exceed either, the port evicts its oldest transfer in
+/// reassembly to make room, so that a remote node emitting partial transfers cannot pin the memory for good.
+/// Fragments of transfers that started a transfer-ID timeout ago are dropped early, as such transfers cannot complete.
+/// Each port also counts the transfers truncated to its extent, evicted, dropped late, or refused by a quota.
+/// Zero disables the accounting; the RX pipeline behaves as if the quotas were unlimited.
+#ifndef UDPARD_RX_FRAGMENT_QUOTA
+#    define UDPARD_RX_FRAGMENT_QUOTA 0U
+#endif
+
 typedef uint64_t UdpardMicrosecond;  ///< UINT64_MAX is not a valid timestamp value.
 typedef uint16_t UdpardPortID;
 typedef uint16_t UdpardNodeID;
@@ -378,7 +414,8 @@ struct UdpardMemoryResource
 /// Applications with redundant network interfaces are expected to have one instance of this type per interface.
 /// Applications that are not interested in transmission may have zero such instances.
 ///
-/// All operations are logarithmic in complexity on the number of enqueued items.
+/// All operations are logarithmic in complexity on the number of enqueued items
+/// (constant time with UDPARD_TX_PRIORITY_FIFO).
 /// There is exactly one memory allocation per element;
 /// the size of each allocation is sizeof(UdpardTxItem) plus the size of the datagram.
 ///
@@ -435,9 +472,18 @@ struct UdpardTx
     /// READ-ONLY
     size_t queue_size;
 
+#if UDPARD_TX_PRIORITY_FIFO
+    /// Internal use only: the oldest and the newest item per priority level, see UDPARD_TX_PRIORITY_FIFO.
+    /// Bit N of the mask is set while the FIFO of priority N is non-empty.
+    /// READ-ONLY
+    struct UdpardTxItem* fifo_head[UDPARD_PRIORITY_MAX + 1U];
+    struct UdpardTxItem* fifo_tail[UDPARD_PRIORITY_MAX + 1U];
+    uint_least8_t        fifo_mask;
+#else
     /// Internal use only.
     /// READ-ONLY
     struct UdpardTreeNode* root;
+#endif
 };
 
 /// One transport frame (UDP datagram) stored in the UdpardTx transmission queue along with its metadata.
@@ -553,7 +599,7 @@ int_fast8_t udpardTxInit(struct UdpardTx* const            self,
 /// smaller than the MTU.
 ///
 /// The time complexity is O(p + log e), where p is the amount of payload in the transfer, and e is the number of
-/// frames already enqueued in the transmission queue.
+/// frames already enqueued in the transmission queue; it is O(p) with UDPARD_TX_PRIORITY_FIFO.
 int32_t udpardTxPublish(struct UdpardTx* const     self,
                         const UdpardMicrosecond    deadline_usec,
                         const enum UdpardPriority  priority,
@@ -623,7 +669,8 @@ int32_t udpardTxRespond(struct UdpardTx* const     self,
 ///
 /// Calling functions that modify the queue may cause the next invocation to return a different pointer.
 ///
-/// The time complexity is logarithmic of the queue size. This function does not invoke the dynamic memory manager.
+/// The time complexity is logarithmic of the queue size, or constant with UDPARD_TX_PRIORITY_FIFO.
+/// This function does not invoke the dynamic memory manager.
 const struct UdpardTxItem* udpardTxPeek(const struct UdpardTx* const self);
 
 /// This function transfers the ownership of the specified item of the prioritized transmission queue from the queue
@@ -634,7 +681,8 @@ const struct UdpardTxItem* udpardTxPeek(const struct UdpardTx* const self);
 ///
 /// If any of the arguments are NULL, the function has no effect and returns NULL.
 ///
-/// The time complexity is logarithmic of the queue size. This function does not invoke the dynamic memory manager.
+/// The time complexity is logarithmic of the queue size, or constant with UDPARD_TX_PRIORITY_FIFO.
+/// This function does not invoke the dynamic memory manager.
 struct UdpardTxItem* udpardTxPop(struct UdpardTx* const self, const struct UdpardTxItem* const item);
 
 /// This is a simple helper that frees the memory allocated for the item with the correct size.
@@ -647,6 +695,34 @@ void udpardTxFree(const struct UdpardMemoryResource memory, struct UdpardTxItem*
 // =================================================    RX PIPELINE    =================================================
 // =====================================================================================================================
 
+#if UDPARD_RX_FRAGMENT_QUOTA > 0
+/// A fragment quota shared by several RX ports, see UdpardRxPort.shared_quota.
+/// The ports sharing it shall be served from the same thread.
+struct UdpardRxQuota
+{
+    /// The maximum number of fragments held by all ports sharing this quota; zero means unlimited.
+    /// This field can be adjusted at runtime arbitrarily.
+    size_t limit;
+
+    /// The number of fragments currently held by the ports sharing this quota.
+    /// READ-ONLY
+    size_t used;
+};
+
+/// Counters of an RX port, see UDPARD_RX_FRAGMENT_QUOTA. They are never reset by the library.
+struct UdpardRxPortStats
+{
+    /// Valid transfers whose payload exceeded the extent and was truncated to it.
+    uint64_t truncated_transfers;
+    /// Transfers in reassembly dropped to make room for a fragment of a newer one when a quota was reached.
+    uint64_t evicted_transfers;
+    /// Transfers in reassembly dropped because they did not complete within the transfer-ID timeout.
+    uint64_t late_transfers;
+    /// Frames dropped because a quota was reached and there was no other transfer in reassembly at the port to evict.
+    uint64_t quota_drops;
+};
+#endif
+
 /// This type represents an open input port, such as a subscription to a subject (topic), a service server port
 /// that accepts RPC-service requests, or a service client port that accepts RPC-service responses.
 ///
@@ -708,10 +784,46 @@ struct UdpardRxPort
     /// the application is guaranteed to never encounter an out-of-memory (OOM) error at runtime.
     /// High-integrity applications can optionally police ingress traffic for MTU violations and filter it before
     /// passing it to the library; alternatively, applications could limit memory consumption per port,
-    /// which is easy to implement since each port gets a dedicated set of memory resources.
+    /// which is easy to implement since each port gets a dedicated set of memory resources,
+    /// or enable UDPARD_RX_FRAGMENT_QUOTA to have the library enforce fragment quotas per port and across ports.
     ///
     /// READ-ONLY
     struct UdpardInternalRxSession* sessions;
+
+    /// The session that accepted the last frame. Consecutive frames of a multi-frame transfer come from the same
+    /// remote node, so this is checked before any other lookup. Since sessions are never freed before the port,
+    /// the pointer stays valid for the lifetime of the port.
+    /// READ-ONLY
+    struct UdpardInternalRxSession* last_session;
+
+#if UDPARD_RX_SESSION_TABLE_SIZE > 0
+    /// Direct index of the sessions by remote node-ID, see UDPARD_RX_SESSION_TABLE_SIZE.
+    /// The sessions are also kept in the tree above; this only speeds up the lookup.
+    /// READ-ONLY
+    struct UdpardInternalRxSession* session_table[UDPARD_RX_SESSION_TABLE_SIZE];
+#endif
+
+#if UDPARD_RX_FRAGMENT_QUOTA > 0
+    /// The maximum number of fragments held by the transfers in reassembly at this port; zero means unlimited.
+    /// By default, this is set to UDPARD_RX_FRAGMENT_QUOTA and it can be changed by the user at runtime.
+    /// A fragment is one received datagram, so this bounds the payload buffers the port keeps as well.
+    /// Fragments of transfers already handed over to the application are not counted.
+    /// The quota shall not be less than the number of frames of the largest transfer expected at the port,
+    /// or such transfers will never complete.
+    size_t fragment_quota;
+
+    /// The quota shared with other ports, NULL by default (none). If used, it shall be assigned before the
+    /// first frame is received and not changed afterwards, as the fragments held are accounted for in it.
+    /// A port that hits the shared quota evicts one of its own transfers, never one of another port.
+    struct UdpardRxQuota* shared_quota;
+
+    /// The number of fragments currently held by the transfers in reassembly at this port.
+    /// READ-ONLY
+    size_t fragment_count;
+
+    /// READ-ONLY
+    struct UdpardRxPortStats stats;
+#endif
 };
 
 /// The set of memory resources is used per an RX pipeline instance such as subscription or a service dispatcher.
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Client of the batch console (BatchConsole.h).
+
+Sends every command given on the command line (or read from stdin, one per
+line) without waiting for the answers, then prints the responses in order.
+Exits with status 1 if any command did not succeed.
+
+    batch_cli.py 192.168.1.50 "netstat" "log info"
+"""
+
+import argparse
+import json
+import socket
+import struct
+import sys
+
+STATUS_NAMES = {
+    0: "ok",
+    1: "unknown command",
+    2: "bad parameters",
+    3: "busy",
+    4: "too long",
+}
+
+
+def read_exact(sock, length):
+    data = b""
+    while len(data) < length:
+        chunk = sock.recv(length - len(data))
+        if not chunk:
+            raise ConnectionError("connection closed by the unit")
+        data += chunk
+    return data
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host")
+    parser.add_argument("commands", nargs="*")
+    parser.add_argument("--port", type=int, default=2323)
+    parser.add_argument("--json", action="store_true", help="print the raw responses")
+    args = parser.parse_args()
+
+    commands = args.commands or [line.rstrip("\r\n") for line in sys.stdin if line.strip()]
+
+    failed = False
+    with socket.create_connection((args.host, args.port), timeout=30) as sock:
+        # Pipeline: every request goes out before the first response is read
+        sock.sendall(b"".join(struct.pack(">H", len(c.encode())) + c.encode() for c in commands))
+
+        for command in commands:
+            (length,) = struct.unpack(">H", read_exact(sock, 2))
+            response = json.loads(read_exact(sock, length))
+
+            if args.json:
+                print(json.dumps(response))
+            else:
+                status = response["status"]
+                print("[%d] %s: %s%s" % (response["id"], command, STATUS_NAMES.get(status, status),
+                                         " (truncated)" if response.get("truncated") else ""))
+                sys.stdout.write(response["output"])
+            failed |= response["status"] != 0
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
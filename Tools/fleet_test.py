@@ -0,0 +1,250 @@
+#!/usr/bin/env python3
+"""Orchestrator of the fleet test (FleetTest.h).
+
+Drives every node over its batch console: configures the senders and the
+receivers of a topology, runs the traffic, collects the counters and prints
+the one-way latency and the loss of every pair, the aggregate throughput and
+the CPU load of every node, as CSV.
+
+    fleet_test.py 192.168.1.50 192.168.1.51 192.168.1.52 --rate 100 --bytes 256
+    fleet_test.py 192.168.1.5{0..9} --topology fan-in --gateway 192.168.1.50 --tcp
+    fleet_test.py 192.168.1.5{0..9} --sweep rate=10,100,500,1000
+
+Latency is only measured between synchronized nodes (PTP or SNTP); the
+script warns about the others, their messages are still counted.
+"""
+
+import argparse
+import json
+import socket
+import struct
+import sys
+import time
+
+from batch_cli import read_exact
+
+MAX_CONNECTIONS = 8      # FLEET_TEST_MAX_CONNECTIONS
+HIST_BUCKETS = 12        # FLEET_TEST_HIST_BUCKETS
+
+
+class Node:
+    """One board, through a connection to its batch console."""
+
+    def __init__(self, host, port):
+        self.host = host
+        self.sock = socket.create_connection((host, port), timeout=30)
+        self.node_id = None
+        self.ip = None
+
+    def run(self, command):
+        data = command.encode()
+        self.sock.sendall(struct.pack(">H", len(data)) + data)
+        (length,) = struct.unpack(">H", read_exact(self.sock, 2))
+        response = json.loads(read_exact(self.sock, length))
+        if response["status"] != 0:
+            raise RuntimeError("%s: '%s' failed with status %d" % (self.host, command, response["status"]))
+        return response["output"]
+
+    def lines(self, command, tag):
+        return [line.split(",") for line in self.run(command).splitlines() if line.startswith("fleet," + tag)]
+
+    def status(self):
+        fields = {}
+        for line in self.run("fleet").splitlines():
+            parts = line.strip().split(",")
+            if len(parts) > 2 and parts[0] == "fleet":
+                fields[parts[1]] = parts[2:]
+        node = fields["node"]
+        self.node_id, self.ip = int(node[0]), node[1]
+        return {
+            "synced": node[2] == "1",
+            "ptp_locked": node[3] == "1",
+            "ptp_offset_ns": int(node[4]),
+            "elapsed_us": int(node[5]),
+            "cpu_permille": int(node[6]),
+            "published": int(fields["tx"][0]),
+            "published_bytes": int(fields["tx"][1]),
+            "publish_errors": int(fields["tx"][2]),
+            "tcp_records": int(fields["tx"][3]),
+            "tcp_bytes": int(fields["tx"][4]),
+            "tcp_errors": int(fields["tx"][5]),
+            "tcp_blocked": int(fields["tx"][6]),
+            "unknown_peers": int(fields["rx"][0]),
+            "unsynced": int(fields["rx"][1]),
+            "clock_errors": int(fields["rx"][2]),
+            "malformed": int(fields["rx"][3]),
+        }
+
+    def peers(self):
+        peers = []
+        first = 0
+        while True:
+            page = [line.strip().split(",") for line in self.run("fleet peers %d" % first).splitlines()]
+            following = None
+            for parts in page:
+                if parts[:2] == ["fleet", "peer"]:
+                    peers.append({
+                        "kind": parts[3], "id": parts[4], "received": int(parts[5]), "bytes": int(parts[6]),
+                        "lost": int(parts[7]), "reordered": int(parts[8]), "latency_count": int(parts[9]),
+                        "min_us": int(parts[10]), "avg_us": int(parts[11]), "max_us": int(parts[12]),
+                    })
+                elif parts[:2] == ["fleet", "hist"]:
+                    peers[-1]["hist"] = [int(count) for count in parts[3:]]
+                elif parts[:2] == ["fleet", "more"]:
+                    following = int(parts[2])
+            if following is None:
+                return peers
+            first = following
+
+
+def percentile_us(hist, fraction):
+    """Upper bound of the bucket holding the given fraction of the samples."""
+    total = sum(hist)
+    if total == 0:
+        return 0
+    seen = 0
+    for bucket, count in enumerate(hist):
+        seen += count
+        if seen >= fraction * total:
+            return 64 << bucket if bucket < HIST_BUCKETS - 1 else -1
+    return -1
+
+
+def run_once(nodes, args, rate, publishers):
+    """One measurement; returns the pair and node reports."""
+    gateway = next((n for n in nodes if n.host == args.gateway), nodes[0])
+    for node in nodes:
+        node.run("fleet stop")
+        node.run("fleet reset")
+        state = node.status()
+        if not state["synced"]:
+            print("# warning: %s is not synchronized, no latency from or to it" % node.host, file=sys.stderr)
+
+    if args.topology == "all-to-all":
+        receivers = nodes
+        senders = nodes[:publishers]
+    else:
+        receivers = [gateway]
+        senders = [n for n in nodes if n is not gateway][:publishers]
+
+    for node in receivers:
+        node.run("fleet listen on")
+        if args.tcp:
+            node.run("fleet server on")
+
+    # The sink takes MAX_CONNECTIONS streams at once: larger fan-ins run in groups
+    if args.tcp and args.topology == "fan-in":
+        groups = [senders[i:i + MAX_CONNECTIONS] for i in range(0, len(senders), MAX_CONNECTIONS)]
+    else:
+        groups = [senders]
+
+    for group in groups:
+        for node in group:
+            if args.tcp:
+                targets = receivers if args.topology == "fan-in" else [receivers[(nodes.index(node) + 1) % len(nodes)]]
+                node.run("fleet tcp %s %d %d" % (targets[0].ip, args.tcp_rate, args.bytes))
+            else:
+                node.run("fleet publish %d %d" % (rate, args.bytes))
+        time.sleep(args.seconds)
+        for node in group:
+            node.run("fleet tcp off" if args.tcp else "fleet publish off")
+
+    # Let the queues drain before the counters are read
+    time.sleep(args.drain)
+
+    states = {node.host: node.status() for node in nodes}
+    by_id = {}
+    for node in nodes:
+        by_id[("cyphal", str(node.node_id))] = node
+        by_id[("tcp", node.ip)] = node
+
+    pairs = []
+    for receiver in receivers:
+        for peer in receiver.peers():
+            sender = by_id.get((peer["kind"], peer["id"]))
+            if sender is None:
+                continue
+            sent = states[sender.host]["tcp_records" if peer["kind"] == "tcp" else "published"]
+            pairs.append((sender, receiver, peer, sent))
+        receiver.run("fleet stop")
+
+    return states, pairs
+
+
+def print_pairs(pairs, seconds):
+    print("pair,src,dst,kind,sent,received,lost,reordered,loss_pct,lat_n,min_us,avg_us,p99_us,max_us,kbps")
+    for sender, receiver, peer, sent in pairs:
+        missing = max(sent - peer["received"], 0)
+        print("pair,%s,%s,%s,%d,%d,%d,%d,%.3f,%d,%d,%d,%d,%d,%.1f" % (
+            sender.host, receiver.host, peer["kind"], sent, peer["received"], peer["lost"], peer["reordered"],
+            100.0 * missing / sent if sent else 0.0, peer["latency_count"], peer["min_us"], peer["avg_us"],
+            percentile_us(peer.get("hist", []), 0.99), peer["max_us"], peer["bytes"] * 8 / 1000.0 / seconds))
+
+
+def print_nodes(nodes, states):
+    print("node,host,node_id,synced,ptp_offset_ns,cpu_permille,published,publish_errors,"
+          "tcp_records,tcp_errors,tcp_blocked,unknown_peers,unsynced,clock_errors,malformed")
+    for node in nodes:
+        s = states[node.host]
+        print("node,%s,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d" % (
+            node.host, node.node_id, s["synced"], s["ptp_offset_ns"], s["cpu_permille"], s["published"],
+            s["publish_errors"], s["tcp_records"], s["tcp_errors"], s["tcp_blocked"], s["unknown_peers"],
+            s["unsynced"], s["clock_errors"], s["malformed"]))
+
+
+def summary(states, pairs, seconds):
+    sent = sum(p[3] for p in pairs)
+    received = sum(p[2]["received"] for p in pairs)
+    latency_n = sum(p[2]["latency_count"] for p in pairs)
+    return {
+        "rx_kbps": sum(p[2]["bytes"] for p in pairs) * 8 / 1000.0 / seconds,
+        "loss_pct": 100.0 * max(sent - received, 0) / sent if sent else 0.0,
+        "avg_us": sum(p[2]["avg_us"] * p[2]["latency_count"] for p in pairs) / latency_n if latency_n else 0,
+        "max_us": max((p[2]["max_us"] for p in pairs), default=0),
+        "max_cpu_permille": max(s["cpu_permille"] for s in states.values()),
+        "publish_errors": sum(s["publish_errors"] for s in states.values()),
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("nodes", nargs="+", help="addresses of the boards")
+    parser.add_argument("--port", type=int, default=2323)
+    parser.add_argument("--topology", choices=["all-to-all", "fan-in"], default="all-to-all")
+    parser.add_argument("--gateway", help="receiver of the fan-in (default: first node)")
+    parser.add_argument("--rate", type=int, default=100, help="messages per second and sender")
+    parser.add_argument("--bytes", type=int, default=256, help="message size, header included")
+    parser.add_argument("--seconds", type=float, default=10.0, help="duration of a run")
+    parser.add_argument("--drain", type=float, default=1.0, help="wait before reading the counters")
+    parser.add_argument("--tcp", action="store_true", help="TCP streams instead of Cyphal messages")
+    parser.add_argument("--tcp-rate", type=int, default=0, help="records per second, 0 for saturation")
+    parser.add_argument("--sweep", help="rate=<list> or publishers=<list>: one summary row per value")
+    args = parser.parse_args()
+
+    nodes = [Node(host, args.port) for host in args.nodes]
+    for node in nodes:
+        node.status()
+
+    if not args.sweep:
+        states, pairs = run_once(nodes, args, args.rate, len(nodes))
+        print_pairs(pairs, args.seconds)
+        print_nodes(nodes, states)
+        return
+
+    key, _, values = args.sweep.partition("=")
+    if key not in ("rate", "publishers") or not values:
+        parser.error("--sweep takes rate=<list> or publishers=<list>")
+
+    print("sweep,%s,rx_kbps,loss_pct,avg_us,max_us,max_cpu_permille,publish_errors" % key)
+    for value in (int(v) for v in values.split(",")):
+        rate = value if key == "rate" else args.rate
+        publishers = value if key == "publishers" else len(nodes)
+        states, pairs = run_once(nodes, args, rate, publishers)
+        s = summary(states, pairs, args.seconds)
+        print("sweep,%d,%.1f,%.3f,%d,%d,%d,%d" % (value, s["rx_kbps"], s["loss_pct"], s["avg_us"], s["max_us"],
+                                                  s["max_cpu_permille"], s["publish_errors"]))
+        sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Pack the web UI into the flash image of the HTTP server (HttpServer.h).
+
+Every file of the directory is gzip-compressed and written, with its content
+type, cache policy and entity tag, to a C source of const tables which the
+linker leaves in flash. The entity tag is a digest of the compressed file, so
+that it only changes with the content. Run it again after editing the UI:
+
+    pack_webui.py Tools/webui Core/Src/WebAssets.c
+"""
+
+import argparse
+import gzip
+import hashlib
+import os
+
+CONTENT_TYPES = {
+    ".html": "text/html; charset=utf-8",
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".ico": "image/x-icon",
+}
+
+# Pages are revalidated on each load, which costs a 304; the files they
+# reference are reused for an hour without asking
+CACHE_PAGE = "no-cache"
+CACHE_STATIC = "max-age=3600"
+
+
+def c_name(path):
+    return "ucAsset_" + "".join(c if c.isalnum() else "_" for c in path.strip("/"))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source")
+    parser.add_argument("output")
+    args = parser.parse_args()
+
+    assets = []
+    for root, _, files in os.walk(args.source):
+        for name in sorted(files):
+            full = os.path.join(root, name)
+            path = "/" + os.path.relpath(full, args.source).replace(os.sep, "/")
+            ext = os.path.splitext(name)[1].lower()
+            with open(full, "rb") as f:
+                data = gzip.compress(f.read(), compresslevel=9, mtime=0)
+            assets.append({
+                "path": path,
+                "type": CONTENT_TYPES.get(ext, "application/octet-stream"),
+                "cache": CACHE_PAGE if ext == ".html" else CACHE_STATIC,
+                "etag": hashlib.sha1(data).hexdigest()[:16],
+                "data": data,
+            })
+    assets.sort(key=lambda a: a["path"])
+
+    out = []
+    out.append("/* WebAssets.c\n *\n * Web UI served by the HTTP server, gzip-compressed. Generated by\n"
+               " * Tools/pack_webui.py from Tools/webui: do not edit.\n */\n")
+    out.append('#include "WebAssets.h"\n')
+    for asset in assets:
+        out.append("\nstatic const uint8_t %s[%d] =\n{\n" % (c_name(asset["path"]), len(asset["data"])))
+        data = asset["data"]
+        for i in range(0, len(data), 16):
+            out.append("    " + ", ".join("0x%02X" % b for b in data[i:i + 16]) + ",\n")
+        out.append("};\n")
+    out.append("\nconst HttpAsset_t xWebAssets[] =\n{\n")
+    for asset in assets:
+        out.append('    { "%s", "%s", "%s", "\\"%s\\"", %s, sizeof(%s) },\n'
+                   % (asset["path"], asset["type"], asset["cache"], asset["etag"],
+                      c_name(asset["path"]), c_name(asset["path"])))
+    out.append("};\n")
+    out.append("\nconst size_t xWebAssetCount = sizeof(xWebAssets) / sizeof(xWebAssets[0]);\n")
+
+    with open(args.output, "w", newline="\n") as f:
+        f.write("".join(out))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""Decoder of the binary event trace streamed by TraceRecorder.c.
+
+Listens on the UDP port given to "trace start <ip> [<port>]" and prints one
+line per event, with its time in microseconds since the first event. With
+--json, the events are also written in the Chrome trace format, which
+Perfetto (ui.perfetto.dev) and chrome://tracing display as one track per
+task and per interrupt source.
+
+The layouts below follow TraceRecorder.h and TraceRecorderHooks.h.
+"""
+
+import argparse
+import json
+import socket
+import struct
+import sys
+
+MAGIC = 0x31435254
+KIND_EVENTS = 0
+KIND_TASKS = 1
+
+HEADER = struct.Struct("<IHHIIQI")
+EVENT = struct.Struct("<IBBHI")
+TASK = struct.Struct("<HBB16s")
+
+EVENT_NAMES = {
+    1: "switch",
+    2: "isr-enter",
+    3: "isr-exit",
+    4: "queue-send",
+    5: "queue-send-failed",
+    6: "queue-receive",
+    7: "queue-receive-failed",
+    8: "queue-block-send",
+    9: "queue-block-receive",
+    10: "stream-send",
+    11: "stream-receive",
+    12: "stream-block",
+    13: "user",
+}
+
+ISR_NAMES = {0: "ETH", 1: "USART3", 2: "TIM23"}
+
+# ucQueueType of queue.h
+QUEUE_TYPES = {0: "queue", 1: "mutex", 2: "counting", 3: "binary", 4: "recursive-mutex", 5: "set"}
+
+USER_NAMES = {0: "net-event-enter", 1: "net-event-exit", 2: "net-tick-enter", 3: "net-tick-exit"}
+
+
+class Decoder:
+    def __init__(self, json_out):
+        self.tasks = {}
+        self.origin = None
+        self.sequence = None
+        self.dropped = 0
+        self.current = None
+        self.json_out = json_out
+        self.json_events = []
+
+    def task_name(self, number):
+        return self.tasks.get(number, "task%d" % number)
+
+    def packet(self, data):
+        if len(data) < HEADER.size:
+            return
+        magic, kind, count, sequence, dropped, cycles, cpu_hz = HEADER.unpack_from(data)
+        if magic != MAGIC or cpu_hz == 0:
+            return
+
+        if self.sequence is not None and sequence != self.sequence + 1 and sequence != 0:
+            print("# %d datagram(s) lost" % ((sequence - self.sequence - 1) & 0xFFFFFFFF))
+        self.sequence = sequence
+        if dropped != self.dropped:
+            if dropped > self.dropped:
+                print("# %d event(s) dropped on the target" % (dropped - self.dropped))
+            self.dropped = dropped
+
+        if kind == KIND_TASKS:
+            for i in range(count):
+                number, priority, _, name = TASK.unpack_from(data, HEADER.size + i * TASK.size)
+                self.tasks[number] = "%s (p%d)" % (name.split(b"\0")[0].decode(errors="replace"), priority)
+            return
+
+        for i in range(count):
+            low, etype, eid, arg, obj = EVENT.unpack_from(data, HEADER.size + i * EVENT.size)
+            # Each record is older than the datagram by less than one wrap
+            # of the 32-bit counter: rebuild its 64-bit cycle count
+            full = cycles - ((cycles - low) & 0xFFFFFFFF)
+            if self.origin is None:
+                self.origin = full
+            self.event((full - self.origin) * 1e6 / cpu_hz, etype, eid, arg, obj)
+
+    def event(self, us, etype, eid, arg, obj):
+        name = EVENT_NAMES.get(etype, "type%d" % etype)
+        if etype == 1:
+            detail = self.task_name(eid)
+            self.switch(us, detail)
+        elif etype in (2, 3):
+            detail = ISR_NAMES.get(eid, "isr%d" % eid)
+            self.emit(us, "B" if etype == 2 else "E", "ISR " + detail, "isr")
+        elif 4 <= etype <= 9:
+            detail = "%s 0x%08x" % (QUEUE_TYPES.get(eid, "type%d" % eid), obj)
+            self.emit(us, "i", name, self.current or "?", {"object": "0x%08x" % obj})
+        elif etype in (10, 11, 12):
+            detail = "0x%08x %d" % (obj, arg)
+            self.emit(us, "i", name, self.current or "?", {"object": "0x%08x" % obj, "arg": arg})
+        elif etype == 13:
+            detail = "%s %d" % (USER_NAMES.get(eid, "id%d" % eid), arg)
+            if eid in (0, 2):
+                self.emit(us, "B", USER_NAMES[eid][:-6], "tcp/ip")
+            elif eid in (1, 3):
+                self.emit(us, "E", USER_NAMES[eid][:-5], "tcp/ip")
+        else:
+            detail = "%d %d 0x%08x" % (eid, arg, obj)
+        print("%14.3f %-20s %s" % (us, name, detail))
+
+    def switch(self, us, task):
+        if self.current is not None:
+            self.emit(us, "E", self.current, self.current)
+        self.current = task
+        self.emit(us, "B", task, task)
+
+    def emit(self, us, phase, name, track, args=None):
+        if self.json_out is None:
+            return
+        event = {"name": name, "ph": phase, "ts": us, "pid": 0, "tid": track}
+        if phase == "i":
+            event["s"] = "t"
+        if args:
+            event["args"] = args
+        self.json_events.append(event)
+
+    def close(self):
+        if self.json_out is not None:
+            json.dump({"traceEvents": self.json_events}, self.json_out)
+            self.json_out.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=17000, help="UDP port (default 17000)")
+    parser.add_argument("--json", type=argparse.FileType("w"), help="write a Chrome trace file")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("", args.port))
+    decoder = Decoder(args.json)
+    try:
+        while True:
+            data, _ = sock.recvfrom(2048)
+            decoder.packet(data)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        decoder.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
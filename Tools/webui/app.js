@@ -0,0 +1,38 @@
+// Live telemetry from the WebSocket server (WebSocketServer.h)
+(function () {
+    var frames = 0;
+    var counted = 0;
+
+    function show(id, text) {
+        document.getElementById(id).textContent = text;
+    }
+
+    function hex(buffer) {
+        var bytes = new Uint8Array(buffer, 0, Math.min(buffer.byteLength, 32));
+        return Array.prototype.map.call(bytes, function (b) {
+            return ("0" + b.toString(16)).slice(-2);
+        }).join(" ");
+    }
+
+    function connect() {
+        var ws = new WebSocket("ws://" + location.hostname + ":8081/telemetry");
+        ws.binaryType = "arraybuffer";
+        ws.onopen = function () { show("state", "open"); };
+        ws.onclose = function () {
+            show("state", "closed, retrying");
+            setTimeout(connect, 2000);
+        };
+        ws.onmessage = function (event) {
+            frames++;
+            show("frames", frames);
+            show("last", hex(event.data));
+        };
+    }
+
+    setInterval(function () {
+        show("rate", frames - counted);
+        counted = frames;
+    }, 1000);
+
+    connect();
+})();